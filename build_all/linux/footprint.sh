@@ -0,0 +1,175 @@
+#!/bin/bash
+#set -o pipefail
+#
+# Builds the device libraries in the configurations shipped on constrained devices (mbed, Arduino) and reports their
+# flash and RAM cost: text, data and bss of every object of every library, and the peak heap of a send cycle.
+
+set -e
+
+script_dir=$(cd "$(dirname "$0")" && pwd)
+build_root=$(cd "${script_dir}/../.." && pwd)
+footprint_folder=$build_root"/cmake/footprint"
+toolchainfile=" "
+size_tool=size
+extracloptions="-Os -ffunction-sections -fdata-sections"
+run_heap=ON
+configurations="mqtt mqtt_blob amqp http http_blob"
+
+usage ()
+{
+    echo "footprint.sh [options]"
+    echo "options"
+    echo " -cl, --compileoption <value>  specify a compile option to be passed to gcc (default is $extracloptions)"
+    echo "   Example: -cl -O2 -cl ..."
+    echo " --configuration <name>        only build the given configuration, can be repeated: $configurations"
+    echo " --toolchain-file <file>       pass cmake a toolchain file for cross compiling (the peak heap is then not measured)"
+    echo " --size-tool <tool>            the size of the toolchain, e.g. arm-none-eabi-size (default is size)"
+    echo " --no-heap                     do not build and run perf_tests for the peak heap of a send cycle"
+    echo ""
+    echo "The serializer is reported apart, the cost of a configuration with it is the sum of both."
+    echo "The reports are in $footprint_folder"
+    exit 1
+}
+
+process_args ()
+{
+    save_next_arg=0
+    selected_configurations=""
+    selected_cloptions=""
+
+    for arg in $*
+    do
+      if [ $save_next_arg == 1 ]
+      then
+        selected_cloptions="$arg $selected_cloptions"
+        save_next_arg=0
+      elif [ $save_next_arg == 2 ]
+      then
+        toolchainfile="$arg"
+        save_next_arg=0
+      elif [ $save_next_arg == 3 ]
+      then
+        size_tool="$arg"
+        save_next_arg=0
+      elif [ $save_next_arg == 4 ]
+      then
+        case " $configurations " in
+            *" $arg "* ) selected_configurations="$selected_configurations $arg";;
+            * ) usage;;
+        esac
+        save_next_arg=0
+      else
+          case "$arg" in
+              "-cl" | "--compileoption" ) save_next_arg=1;;
+              "--toolchain-file" ) save_next_arg=2;;
+              "--size-tool" ) save_next_arg=3;;
+              "--configuration" ) save_next_arg=4;;
+              "--no-heap" ) run_heap=OFF;;
+              * ) usage;;
+          esac
+      fi
+    done
+
+    if [ "$selected_configurations" != "" ]
+    then
+      configurations=$selected_configurations
+    fi
+
+    if [ "$selected_cloptions" != "" ]
+    then
+      extracloptions=$selected_cloptions
+    fi
+
+    if [ "$toolchainfile" != " " ]
+    then
+      toolchainfile=$(readlink -f $toolchainfile)
+      toolchainfile="-DCMAKE_TOOLCHAIN_FILE=$toolchainfile"
+      # perf_tests cannot run on the build machine
+      run_heap=OFF
+    fi
+}
+
+# the transports of a configuration, and the library of its transport
+configuration_options ()
+{
+    case "$1" in
+        "mqtt" ) echo "-Duse_mqtt:BOOL=ON -Duse_amqp:BOOL=OFF -Duse_http:BOOL=OFF";;
+        "mqtt_blob" ) echo "-Duse_mqtt:BOOL=ON -Duse_amqp:BOOL=OFF -Duse_http:BOOL=ON -Ddont_use_uploadtoblob:BOOL=OFF";;
+        "amqp" ) echo "-Duse_mqtt:BOOL=OFF -Duse_amqp:BOOL=ON -Duse_http:BOOL=OFF";;
+        "http" ) echo "-Duse_mqtt:BOOL=OFF -Duse_amqp:BOOL=OFF -Duse_http:BOOL=ON -Ddont_use_uploadtoblob:BOOL=ON";;
+        "http_blob" ) echo "-Duse_mqtt:BOOL=OFF -Duse_amqp:BOOL=OFF -Duse_http:BOOL=ON -Ddont_use_uploadtoblob:BOOL=OFF";;
+    esac
+}
+
+configuration_transport ()
+{
+    case "$1" in
+        "mqtt" | "mqtt_blob" ) echo "iothub_client_mqtt_transport";;
+        "amqp" ) echo "iothub_client_amqp_transport";;
+        "http" | "http_blob" ) echo "iothub_client_http_transport";;
+    esac
+}
+
+# the sizes of every object of a library, then the sum of them in the summary
+report_library ()
+{
+    configuration=$1
+    library=$2
+    report=$3
+    summary=$4
+
+    library_file=$(find . -name "lib$library.a" | head -n 1)
+    if [ "$library_file" == "" ]
+    then
+      echo "$library was not built" >> $report
+    else
+      echo "--- $library" >> $report
+      $size_tool -t $library_file >> $report
+      # the last line of size -t is the total: text data bss dec
+      $size_tool -t $library_file | tail -n 1 | awk -v c=$configuration -v l=$library '{ printf "%-10s %-30s %10s %10s %10s\n", c, l, $1, $2, $3 }' >> $summary
+    fi
+}
+
+process_args $*
+
+CORES=$(grep -c ^processor /proc/cpuinfo 2>/dev/null || sysctl -n hw.ncpu)
+
+rm -r -f $footprint_folder
+mkdir -p $footprint_folder
+summary=$footprint_folder/summary.txt
+printf "%-10s %-30s %10s %10s %10s\n" "config" "library" "text" "data" "bss" > $summary
+
+for configuration in $configurations
+do
+  transport=$(configuration_transport $configuration)
+  report=$footprint_folder/$configuration.txt
+  mkdir -p $footprint_folder/$configuration
+  pushd $footprint_folder/$configuration
+  cmake $toolchainfile -DCMAKE_BUILD_TYPE=MinSizeRel -DcompileOption_C:STRING="$extracloptions" -Dskip_samples:BOOL=ON -Dbuild_service_client:BOOL=OFF $(configuration_options $configuration) $build_root
+  make --jobs=$CORES iothub_client $transport serializer
+
+  echo "=== $configuration ($extracloptions)" > $report
+  for library in iothub_client $transport serializer aziotsharedutil umqtt uamqp
+  do
+    if [ "$library" == "umqtt" ] && [ "$transport" != "iothub_client_mqtt_transport" ]; then continue; fi
+    if [ "$library" == "uamqp" ] && [ "$transport" != "iothub_client_amqp_transport" ]; then continue; fi
+    report_library $configuration $library $report $summary
+  done
+  popd
+done
+
+if [ "$run_heap" == "ON" ]
+then
+  # only MQTT has a loopback broker in perf_tests (see iothub_client/tests/perf_tests), and gballoc measuring changes
+  # the sizes, so the heap is measured in a build of its own
+  mkdir -p $footprint_folder/heap
+  pushd $footprint_folder/heap
+  cmake $toolchainfile -DCMAKE_BUILD_TYPE=MinSizeRel -DcompileOption_C:STRING="$extracloptions" -Dskip_samples:BOOL=ON -Dbuild_service_client:BOOL=OFF -Drun_perf_tests:BOOL=ON $(configuration_options mqtt) $build_root
+  make --jobs=$CORES perf_tests_exe
+  echo "" >> $summary
+  echo "peak heap of a send cycle (perf_tests)" >> $summary
+  $(find . -name perf_tests_exe -type f | head -n 1) | tee -a $summary
+  popd
+fi
+
+cat $summary
@@ -15,6 +15,7 @@
 
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/buffer_.h"
+#include "iothub_client_ll.h"
 
 #ifdef __cplusplus
 #include <cstddef>
@@ -22,6 +23,7 @@ extern "C"
 {
 #else
 #include <stddef.h>
+#include <stdbool.h>
 #endif
 
 #include "azure_c_shared_utility/umock_c_prod.h"
@@ -31,7 +33,8 @@ extern "C"
     BLOB_ERROR,            \
     BLOB_NOT_IMPLEMENTED,  \
     BLOB_HTTP_ERROR,       \
-    BLOB_INVALID_ARG    
+    BLOB_INVALID_ARG,      \
+    BLOB_ABORTED
 
 DEFINE_ENUM(BLOB_RESULT, BLOB_RESULT_VALUES)
 
@@ -49,6 +52,44 @@ DEFINE_ENUM(BLOB_RESULT, BLOB_RESULT_VALUES)
 */
 MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadFromSasUri,const char*, SASURI, const unsigned char*, source, size_t, size, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates)
 
+/**
+* @brief	Synchronously uploads a byte array to blob storage, uploading the 4MB blocks of sizes of 64MB and more from several threads
+*
+* @param	SASURI	                    The URI to use to upload data
+* @param	size		                The size of the data to be uploaded (can be 0)
+* @param	source		                A pointer to the byte array to be uploaded (can be NULL, but then size needs to be zero)
+* @param    httpStatus                  A pointer to an out argument receiving the HTTP status (available only when the return value is BLOB_OK)
+* @param    httpResponse                A BUFFER_HANDLE that receives the HTTP response from the server (available only when the return value is BLOB_OK)
+* @param    certificates                A null terminated string containing CA certificates to be used
+* @param    blockUploadConcurrency      The number of blocks uploaded at the same time, each on its own connection to storage. 0 and 1 upload the blocks one after the other.
+*                                       At most blockUploadConcurrency blocks of 4MB are copied in memory at any time.
+* @param    blockRetryCount             The number of times a block that failed to reach storage or got a 408, 429 or 5xx status is put again, with the same block ID, before the upload fails.
+* @param    progressCallback            Told the progress after every block (can be NULL), returning non-zero cancels the upload before the next block with BLOB_ABORTED.
+* @param    progressContext             A user-provided context passed to progressCallback.
+* @param    computeBlockCrc64           When true every block is sent with its CRC64, storage refuses a block corrupted on the way and the block is put again as a failed block.
+*
+* @return	A @c BLOB_RESULT. BLOB_OK means the blob has been uploaded successfully. Any other value indicates an error
+*/
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadFromSasUri_Ex, const char*, SASURI, const unsigned char*, source, size_t, size, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, size_t, blockUploadConcurrency, size_t, blockRetryCount, IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK, progressCallback, void*, progressContext, bool, computeBlockCrc64)
+
+/**
+* @brief	Synchronously uploads to blob storage the blocks returned by getDataCallback, one "Put Block" per block
+*
+* @param	SASURI	            The URI to use to upload data
+* @param	getDataCallback	    A callback returning the next block (at most 4MB), a NULL data or a 0 size ends the upload
+* @param	context		        A user-provided context passed to getDataCallback
+* @param    httpStatus          A pointer to an out argument receiving the HTTP status (available only when the return value is BLOB_OK)
+* @param    httpResponse        A BUFFER_HANDLE that receives the HTTP response from the server (available only when the return value is BLOB_OK)
+* @param    certificates        A null terminated string containing CA certificates to be used
+* @param    blockRetryCount     The number of times a block that failed to reach storage or got a 408, 429 or 5xx status is put again, with the same block ID, before the upload fails.
+* @param    progressCallback    Told the progress after every block (can be NULL), returning non-zero cancels the upload before the next block with BLOB_ABORTED.
+* @param    progressContext     A user-provided context passed to progressCallback.
+* @param    computeBlockCrc64   When true every block is sent with its CRC64, storage refuses a block corrupted on the way and the block is put again as a failed block.
+*
+* @return	A @c BLOB_RESULT. BLOB_OK means the blob has been uploaded successfully. Any other value indicates an error
+*/
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksFromSasUri, const char*, SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK, getDataCallback, void*, context, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, size_t, blockRetryCount, IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK, progressCallback, void*, progressContext, bool, computeBlockCrc64)
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,6 +25,7 @@ typedef struct IOTHUB_CLIENT_INSTANCE_TAG* IOTHUB_CLIENT_HANDLE;
 #include <stdint.h>
 
 #include "iothub_client_ll.h"
+#include "iothub_client_connection_ramp.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
 
 #ifdef __cplusplus
@@ -32,12 +33,9 @@ extern "C"
 {
 #endif
 
-#define IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES \
-    FILE_UPLOAD_OK, \
-    FILE_UPLOAD_ERROR
-
-    DEFINE_ENUM(IOTHUB_CLIENT_FILE_UPLOAD_RESULT, IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES)
     typedef void(*IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK)(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, void* userContextCallback);
+    /*the callback owns payLoad, and gives it back with IoTHubClient_ReleaseDeviceTwinPayload*/
+    typedef void(*IOTHUB_CLIENT_DEVICE_TWIN_PAYLOAD_CALLBACK)(DEVICE_TWIN_UPDATE_STATE update_state, unsigned char* payLoad, size_t size, void* userContextCallback);
 
     /**
     * @brief	Creates a IoT Hub client for communication with an existing
@@ -71,6 +69,7 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_HANDLE, IoTHubClient_Create, const IOTHUB_CLIENT_CONFIG*, config);
 
+#ifndef DONT_USE_MULTIPLEXING
     /**
     * @brief	Creates a IoT Hub client for communication with an existing IoT
     * 			Hub using the specified parameters.
@@ -85,6 +84,7 @@ extern "C"
     * 			invoking other functions for IoT Hub client and @c NULL on failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_HANDLE, IoTHubClient_CreateWithTransport, TRANSPORT_HANDLE, transportHandle, const IOTHUB_CLIENT_CONFIG*, config);
+#endif /*DONT_USE_MULTIPLEXING*/
 
     /**
     * @brief	Disposes of resources allocated by the IoT Hub client. This is a
@@ -116,6 +116,55 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief	Asynchronous call to send the message specified by @p eventMessageHandle,
+    *			without making a copy of it.
+    *
+    *			Upon success the SDK owns @p eventMessageHandle and destroys it once the
+    *			confirmation callback has been called. The caller shall not use or destroy
+    *			the handle afterwards. Upon failure the caller keeps the ownership of
+    *			@p eventMessageHandle.
+    *
+    * @param	iotHubClientHandle		   	The handle created by a call to the create function.
+    * @param	eventMessageHandle		   	The handle to an IoT Hub message.
+    * @param	eventConfirmationCallback  	The callback specified by the device for receiving
+    * 										confirmation of the delivery of the IoT Hub message.
+    * 										The user can specify a @c NULL value here to
+    * 										indicate that no callback is required.
+    * @param	userContextCallback			User specified context that will be provided to the
+    * 										callback. This can be @c NULL.
+    *
+    *			@b NOTE: The application behavior is undefined if the user calls
+    *			the ::IoTHubClient_Destroy function from within any callback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsync_TakeOwnership, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief	Asynchronous call to send the @p eventMessageCount messages in @p eventMessageHandles
+    *			as one batch, taking the client lock once.
+    *
+    *			The messages are cloned and queued in order, all of them or none.
+    *
+    * @param	iotHubClientHandle		   	The handle created by a call to the create function.
+    * @param	eventMessageHandles		   	The array of handles to IoT Hub messages.
+    * @param	eventMessageCount		   	The number of handles in @p eventMessageHandles.
+    * @param	eventConfirmationCallback  	The callback called once all the messages of the batch
+    * 										have been confirmed. The result is IOTHUB_CLIENT_CONFIRMATION_OK
+    * 										if all the messages were delivered, otherwise the result of
+    * 										the first message that was not. The user can specify a
+    * 										@c NULL value here to indicate that no callback is required.
+    * @param	userContextCallback			User specified context that will be provided to the
+    * 										callback. This can be @c NULL.
+    *
+    *			@b NOTE: The application behavior is undefined if the user calls
+    *			the ::IoTHubClient_Destroy function from within any callback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventBatchAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
     /**
     * @brief	This function returns the current sending status for IoTHubClient.
     *
@@ -164,6 +213,23 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetConnectionStatusCallback, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK, connectionStatusCallback, void*, userContextCallback);
 
+    /**
+    * @brief	Starts connecting the device to IoT Hub in the background. Otherwise the
+    * 			connection is only started by the first call that needs it, for example
+    * 			::IoTHubClient_SendEventAsync, and the first message waits for the
+    * 			TLS handshake, the authentication and the links to be attached.
+    *
+    * @param	iotHubClientHandle		The handle created by a call to the create function.
+    *
+    *			@b NOTE: The connection is ready when the callback set by
+    *			::IoTHubClient_SetConnectionStatusCallback is called with
+    *			@c IOTHUB_CLIENT_CONNECTION_AUTHENTICATED. Set that callback before
+    *			calling this function.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_Connect, IOTHUB_CLIENT_HANDLE, iotHubClientHandle);
+
     /**
     * @brief	Sets up the connection status callback to be invoked representing the status of
     * the connection to IOT Hub. This is a blocking call.
@@ -210,6 +276,62 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetLastMessageReceiveTime, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, time_t*, lastMessageReceiveTime);
 
+    /**
+    * @brief	This function returns in the out parameter @p statistics the usage
+    * 			of the pool of send queue entries of the client.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	statistics			Out parameter receiving the pool statistics.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetMessagePoolStatistics, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS*, statistics);
+
+    /**
+    * @brief	This function returns in the out parameter @p statistics the counters,
+    * 			queue depths and latency histogram of the messages sent while the
+    * 			@c statistics option is enabled.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	statistics			Out parameter receiving the client statistics.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetStatistics, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics);
+
+    /**
+    * @brief	This function returns in the out parameter @p depth the number of user
+    * 			callbacks that are queued and not dispatched yet, including the ones the
+    * 			callback dispatcher thread (see @b callback_dispatch_queue_size) is running.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	depth				Out parameter receiving the number of queued callbacks.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetCallbackQueueDepth, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, size_t*, depth);
+
+    /**
+    * @brief	Stops receiving messages and method calls until ::IoTHubClient_ResumeReceive,
+    * 			without clearing their callbacks, see ::IoTHubClient_LL_PauseReceive. The
+    * 			callbacks already queued are still dispatched.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_PauseReceive, IOTHUB_CLIENT_HANDLE, iotHubClientHandle);
+
+    /**
+    * @brief	Receives the messages and method calls again after ::IoTHubClient_PauseReceive,
+    * 			unless @b inbound_callback_limit keeps the receive paused.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_ResumeReceive, IOTHUB_CLIENT_HANDLE, iotHubClientHandle);
+
     /**
     * @brief	This API sets a runtime option identified by parameter @p optionName
     * 			to a value pointed to by @p value. @p optionName and the data type
@@ -247,10 +369,34 @@ extern "C"
     *				- @b messageTimeout - the maximum time in milliseconds until a message
     *                 is timeouted. The time starts at IoTHubClient_SendEventAsync. By default,
     *                 messages do not expire. @p is a pointer to a uint64_t
+    *				- @b callback_dispatch_queue_size - runs the user callbacks on a dedicated
+    *				  thread instead of the thread calling IoTHubClient_LL_DoWork, so that slow
+    *				  callbacks do not delay the I/O of the client. @p value is a pointer to a
+    *				  @c size_t with the maximum number of callbacks handed off to that thread
+    *				  at a time. The callbacks keep their order.
+    *				- @b inbound_callback_limit - pauses the receive, as IoTHubClient_PauseReceive
+    *				  does, once that many message and method callbacks are queued and not
+    *				  dispatched yet, and resumes it once half of them are left at most. @p value
+    *				  is a pointer to a @c size_t, 0 (the default) queues them without limit.
+    *				- @b send_ingress_queue - when @c true, IoTHubClient_SendEventAsync and
+    *				  IoTHubClient_SendEventAsync_TakeOwnership push the message on a lock-free
+    *				  queue that the worker thread drains before each IoTHubClient_LL_DoWork,
+    *				  instead of waiting for the lock the worker holds during I/O. Errors of the
+    *				  send queue are then reported through the confirmation callback. @p value
+    *				  is a pointer to a @c bool. The queue cannot be disabled once enabled.
+    *				- @b blob_upload_workers - runs the uploads of IoTHubClient_UploadToBlobAsync
+    *				  and the other asynchronous uploads on that many threads, taking them in
+    *				  order from a queue, instead of a thread per upload. The workers reuse the
+    *				  connection to IoT Hub (@b blob_upload_keep_connection is turned on). @p value
+    *				  is a pointer to a @c size_t. The workers cannot be changed once started.
+    *				- @b statistics - when @c true, the messages sent afterwards are counted and
+    *				  their latency recorded, see IoTHubClient_GetStatistics. @p value is a
+    *				  pointer to a @c bool.
     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetOption, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value);
 
+#ifndef DONT_USE_DEVICE_TWIN
     /**
     * @brief	This API specifies a call back to be used when the device receives a state update.
     *
@@ -271,6 +417,36 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetDeviceTwinCallback, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
 
+    /**
+    * @brief	This API specifies a call back to be used when the device receives a state update,
+    *			to which the ownership of the payload is handed.
+    *
+    * @param	iotHubClientHandle		The handle created by a call to the create function.
+    * @param	deviceTwinPayloadCallback	The callback to be called, from the worker thread, with
+    *									the copy of the payload the client made when the transport
+    *									received it. The callback can keep the payload past its
+    *									return (to parse it on a thread of its own, say) and gives it
+    *									back with ::IoTHubClient_ReleaseDeviceTwinPayload, so the
+    *									payload is copied once from the receive buffer of the
+    *									transport to the application.
+    * @param	userContextCallback		User specified context that will be provided to the
+    * 									callback. This can be @c NULL.
+    *
+    *			It replaces the callback set by ::IoTHubClient_SetDeviceTwinCallback, and the other
+    *			way around.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetDeviceTwinPayloadCallback, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_PAYLOAD_CALLBACK, deviceTwinPayloadCallback, void*, userContextCallback);
+
+    /**
+    * @brief	Releases a payload handed to a ::IOTHUB_CLIENT_DEVICE_TWIN_PAYLOAD_CALLBACK. The payloads
+    *			come from the allocator of the SDK, so they cannot be given to free.
+    *
+    * @param	payLoad		The payload, it can be @c NULL.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_ReleaseDeviceTwinPayload, unsigned char*, payLoad);
+
     /**
     * @brief	This API sends a report of the device's properties and their current values.
     *
@@ -287,7 +463,9 @@ extern "C"
     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendReportedState, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const unsigned char*, reportedState, size_t, size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK, reportedStateCallback, void*, userContextCallback);
+#endif /*DONT_USE_DEVICE_TWIN*/
 
+#ifndef DONT_USE_DEVICE_METHODS
     /**
     * @brief	This API sets callback for cloud to device method call.
     *
@@ -325,11 +503,50 @@ extern "C"
     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_DeviceMethodResponse, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, METHOD_HANDLE, methodId, const unsigned char*, response, size_t, response_size, int, statusCode);
+#endif /*DONT_USE_DEVICE_METHODS*/
+
+    /**
+    * @brief	Creates a process wide pool of worker threads that serves all the
+    * 			clients created afterwards without a shared transport, instead of one
+    * 			thread per client. A client is never served by two threads at once.
+    *
+    * @param	threadCount	The number of worker threads, usually the number of cores.
+    *
+    *			This function is not thread safe and shall be called before
+    *			creating any client, in the same way as platform_init.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_WorkerPool_Init, size_t, threadCount);
+
+    /**
+    * @brief	Destroys the process wide worker pool. All the clients using it
+    * 			shall have been destroyed before calling this function.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_WorkerPool_Deinit);
+
+    /**
+    * @brief	Sets the connection ramp the clients served by the process wide worker
+    * 			pool wait for before their first connection, so that a gateway starting
+    * 			many of them does not authenticate them all at once.
+    *
+    * @param	connectionRamp	The connection ramp, or NULL to admit the clients right away.
+    * 							It is not owned and shall outlive the worker pool.
+    *
+    *			This function is not thread safe and shall be called after
+    *			IoTHubClient_WorkerPool_Init and before creating any client.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_WorkerPool_SetConnectionRamp, CONNECTION_RAMP_HANDLE, connectionRamp);
 
 #ifndef DONT_USE_UPLOADTOBLOB
     /**
     * @brief	IoTHubClient_UploadToBlobAsync uploads data from memory to a file in Azure Blob Storage.
     *
+    *			The progress of the upload is told, on the upload thread, to the callback set with the
+    *			@c blob_upload_progress option, see IoTHubClient_LL_SetOption.
+    *
     * @param	iotHubClientHandle	                The handle created by a call to the IoTHubClient_Create function.
     * @param	destinationFileName	                The name of the file to be created in Azure Blob Storage.
     * @param	source                              The source of data.
@@ -340,6 +557,34 @@ extern "C"
     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_UploadToBlobAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, destinationFileName, const unsigned char*, source, size_t, size, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK, iotHubClientFileUploadCallback, void*, context);
+
+    /**
+    * @brief	IoTHubClient_UploadMultipleBlocksToBlobAsync uploads to a file in Azure Blob Storage the blocks
+    *           returned by @p getDataCallback, without holding the whole file in memory.
+    *
+    * @param	iotHubClientHandle	    The handle created by a call to the IoTHubClient_Create function.
+    * @param	destinationFileName	    The name of the file to be created in Azure Blob Storage.
+    * @param	getDataCallback         A callback returning the blocks of the file one after the other, then told the
+    *                                   result of the upload. It is called from the uploading thread.
+    * @param    context                 A user-provided context passed to @p getDataCallback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_UploadMultipleBlocksToBlobAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK, getDataCallback, void*, context);
+
+    /**
+    * @brief	IoTHubClient_UploadFileToBlobAsync uploads to a file in Azure Blob Storage the content of the
+    *           local file @p filePath, read one block at a time by the uploading thread.
+    *
+    * @param	iotHubClientHandle	    The handle created by a call to the IoTHubClient_Create function.
+    * @param	destinationFileName	    The name of the file to be created in Azure Blob Storage.
+    * @param	filePath                The path of the local file to upload, it needs to stay unchanged until the upload completes.
+    * @param	iotHubClientFileUploadCallback	    A callback to be invoked when the file upload operation has finished.
+    * @param	context	                A user-provided context to be passed to the file upload callback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_UploadFileToBlobAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, destinationFileName, const char*, filePath, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK, iotHubClientFileUploadCallback, void*, context);
 #endif
 #ifdef __cplusplus
 }
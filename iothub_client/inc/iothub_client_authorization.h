@@ -13,6 +13,7 @@ extern "C" {
 
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_options.h"
 
 typedef struct IOTHUB_AUTHORIZATION_DATA_TAG* IOTHUB_AUTHORIZATION_HANDLE;
 
@@ -39,6 +40,8 @@ MOCKABLE_FUNCTION(, char*, IoTHubClient_Auth_Get_SasToken, IOTHUB_AUTHORIZATION_
 MOCKABLE_FUNCTION(, const char*, IoTHubClient_Auth_Get_DeviceId, IOTHUB_AUTHORIZATION_HANDLE, handle);
 MOCKABLE_FUNCTION(, const char*, IoTHubClient_Auth_Get_DeviceKey, IOTHUB_AUTHORIZATION_HANDLE, handle);
 MOCKABLE_FUNCTION(, SAS_TOKEN_STATUS, IoTHubClient_Auth_Is_SasToken_Valid, IOTHUB_AUTHORIZATION_HANDLE, handle);
+/* The tokens signed after it are signed by the HMAC-SHA256 of crypto_provider, in software again once it has none. */
+MOCKABLE_FUNCTION(, int, IoTHubClient_Auth_Set_Crypto_Provider, IOTHUB_AUTHORIZATION_HANDLE, handle, const IOTHUB_CRYPTO_PROVIDER*, crypto_provider);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_CHUNKING_H
+#define IOTHUB_CLIENT_CHUNKING_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define CHUNKING_ID_PROPERTY "chunk-id"
+#define CHUNKING_INDEX_PROPERTY "chunk-index"
+#define CHUNKING_TOTAL_PROPERTY "chunk-total"
+
+/*a generated chunk id is a UUID*/
+#define CHUNKING_GENERATED_ID_SIZE 37
+
+/* A message whose payload is larger than a chunk size is sent as chunk-total messages of at most that size, each with
+   the properties of the message and the application properties chunk-id, the same for all of them, and chunk-index,
+   from 0 to chunk-total - 1. The receiver concatenates the payloads of the chunk-total messages of a chunk-id in the
+   order of chunk-index, before undoing the content-encoding of the message, if any. */
+
+/* Returns the number of chunks of at most maxChunkSize bytes of the payload of message, 1 for an empty payload, 0 if
+   message is NULL, maxChunkSize is 0 or the payload cannot be read. */
+MOCKABLE_FUNCTION(, size_t, chunking_get_chunk_count, IOTHUB_MESSAGE_HANDLE, message, size_t, maxChunkSize);
+
+/* Returns the message id of message, or a UUID generated in generatedId, of CHUNKING_GENERATED_ID_SIZE bytes, if it has
+   none, NULL if it fails. */
+MOCKABLE_FUNCTION(, const char*, chunking_get_chunk_id, IOTHUB_MESSAGE_HANDLE, message, char*, generatedId);
+
+/* Returns a new message with the index-th chunk of maxChunkSize bytes of the payload of message, its properties and the
+   chunk properties, NULL if it fails. */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, chunking_create_chunk, IOTHUB_MESSAGE_HANDLE, message, const char*, chunkId, size_t, maxChunkSize, size_t, index, size_t, count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_CHUNKING_H */
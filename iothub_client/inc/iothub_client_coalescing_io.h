@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_COALESCING_IO_H
+#define IOTHUB_CLIENT_COALESCING_IO_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* bool*: true to hold the sends (corked), false to send what is held in one write and send the next sends as they come */
+#define COALESCING_IO_OPTION_CORK "coalescing_io_cork"
+
+/* Once OPTION_WRITE_COALESCING is set the transports put this IO on top of their TLS IO, which it does not own. While it
+   is corked, which the transports do for the length of their DoWork, the bytes sent accumulate in a buffer of
+   buffer_size bytes and go to the TLS IO in one xio_send, so it makes one TLS record and one socket write of them
+   instead of one per packet or frame. A send that does not fit in the buffer flushes it first; one larger than the
+   buffer is sent on its own. Opening, closing, receiving and the options other than COALESCING_IO_OPTION_CORK are those
+   of the TLS IO. */
+typedef struct COALESCING_IO_CONFIG_TAG
+{
+    XIO_HANDLE underlying_io;
+    size_t buffer_size;
+} COALESCING_IO_CONFIG;
+
+MOCKABLE_FUNCTION(, const IO_INTERFACE_DESCRIPTION*, coalescing_io_get_interface_description);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_COALESCING_IO_H */
@@ -0,0 +1,35 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_COMPRESSION_H
+#define IOTHUB_CLIENT_COMPRESSION_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define COMPRESSION_CONTENT_ENCODING_PROPERTY "content-encoding"
+#define COMPRESSION_CONTENT_ENCODING_GZIP "gzip"
+
+/* A compressor keeps one deflate stream and its output buffer for all the messages it compresses, so compressing a
+   message only allocates the new message once the output buffer has grown to the largest payload. It needs the SDK
+   built with use_compression (zlib), compressor_create fails otherwise.
+   A compressor is not thread safe. */
+typedef struct COMPRESSOR_TAG* COMPRESSOR_HANDLE;
+
+MOCKABLE_FUNCTION(, COMPRESSOR_HANDLE, compressor_create, int, level);
+MOCKABLE_FUNCTION(, void, compressor_destroy, COMPRESSOR_HANDLE, compressor);
+
+/* Returns a new message with the gzip payload of message, its properties and the application property content-encoding
+   set to gzip, or NULL if the payload cannot be compressed or its gzip is not smaller. */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, compressor_compress_message, COMPRESSOR_HANDLE, compressor, IOTHUB_MESSAGE_HANDLE, message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_COMPRESSION_H */
@@ -0,0 +1,51 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_CONNECTION_HEALTH_H
+#define IOTHUB_CLIENT_CONNECTION_HEALTH_H
+
+#include <stdbool.h>
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_client_options.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define CONNECTION_HEALTH_ACTION_VALUES     \
+    CONNECTION_HEALTH_ACTION_NONE,          \
+    CONNECTION_HEALTH_ACTION_PROBE,         \
+    CONNECTION_HEALTH_ACTION_RECONNECT
+
+DEFINE_ENUM(CONNECTION_HEALTH_ACTION, CONNECTION_HEALTH_ACTION_VALUES);
+
+/* A connection health monitor keeps the round trip time of the acknowledgements of a connection, smoothed as TCP does
+   (RFC 6298), and the timeout it gives: the smoothed round trip time and four times its variation, between the minimum
+   and the maximum of its options. Once the acknowledgements waited for are late by that timeout it asks for a probe,
+   a packet the hub answers at once, and once the probe is late as well it asks for a reconnection: the link died
+   without the socket knowing. The acknowledgements of packets sent again are not measured, their round trip is not
+   known. The monitor is given the current ms, it does not read a clock of its own.
+   A connection health monitor is not thread safe. */
+typedef struct CONNECTION_HEALTH_TAG* CONNECTION_HEALTH_HANDLE;
+
+MOCKABLE_FUNCTION(, CONNECTION_HEALTH_HANDLE, connection_health_create, const IOTHUB_CONNECTION_HEALTH_OPTIONS*, options);
+MOCKABLE_FUNCTION(, void, connection_health_destroy, CONNECTION_HEALTH_HANDLE, health);
+/* A new connection: what was waited for on the previous one is forgotten, its round trip time is kept. */
+MOCKABLE_FUNCTION(, void, connection_health_on_connected, CONNECTION_HEALTH_HANDLE, health);
+MOCKABLE_FUNCTION(, void, connection_health_on_sent, CONNECTION_HEALTH_HANDLE, health, tickcounter_ms_t, nowMs);
+MOCKABLE_FUNCTION(, void, connection_health_on_acked, CONNECTION_HEALTH_HANDLE, health, tickcounter_ms_t, sentMs, bool, isResent, tickcounter_ms_t, nowMs);
+MOCKABLE_FUNCTION(, void, connection_health_on_probe_acked, CONNECTION_HEALTH_HANDLE, health, tickcounter_ms_t, nowMs);
+/* isWaitingForAcks tells whether acknowledgements are still waited for. A probe asked for is taken as sent at nowMs. */
+MOCKABLE_FUNCTION(, CONNECTION_HEALTH_ACTION, connection_health_check, CONNECTION_HEALTH_HANDLE, health, bool, isWaitingForAcks, tickcounter_ms_t, nowMs);
+/* Returns true, with dueMs the time connection_health_check is to be called, while something is waited for. */
+MOCKABLE_FUNCTION(, bool, connection_health_get_due_time, CONNECTION_HEALTH_HANDLE, health, tickcounter_ms_t*, dueMs);
+MOCKABLE_FUNCTION(, unsigned int, connection_health_get_timeout, CONNECTION_HEALTH_HANDLE, health);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_CONNECTION_HEALTH_H */
@@ -0,0 +1,33 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_CONNECTION_RAMP_H
+#define IOTHUB_CLIENT_CONNECTION_RAMP_H
+
+#include <stdbool.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* A connection ramp is shared by the transports (set with the option "connection_ramp", the value being the
+   CONNECTION_RAMP_HANDLE itself) and by the process wide worker pool (IoTHubClient_WorkerPool_SetConnectionRamp), so
+   the devices of a gateway that starts do not all authenticate in the same second. Every connection takes a token from
+   a budget of burst tokens refilled by connections_per_sec each second. The devices with queued data go first: while
+   one of them was turned away in the last second, the devices without queued data are not admitted.
+   A connection ramp is thread safe and must outlive the transports and clients it is set on. */
+typedef struct CONNECTION_RAMP_TAG* CONNECTION_RAMP_HANDLE;
+
+MOCKABLE_FUNCTION(, CONNECTION_RAMP_HANDLE, connection_ramp_create, unsigned int, connections_per_sec, unsigned int, burst);
+MOCKABLE_FUNCTION(, void, connection_ramp_destroy, CONNECTION_RAMP_HANDLE, connection_ramp);
+/* Returns true when the connection can be made now. Otherwise it sets wait_time_in_ms to the time after which asking
+   again can be admitted. */
+MOCKABLE_FUNCTION(, bool, connection_ramp_admit, CONNECTION_RAMP_HANDLE, connection_ramp, bool, has_queued_data, unsigned int*, wait_time_in_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_CONNECTION_RAMP_H */
@@ -0,0 +1,552 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_cpp.h
+*	@brief	 Header only C++17 layer over IoTHubMessage and IoTHubClient_LL.
+*
+*	@details iothub::message and iothub::client_ll own their handle and are
+*			 move-only, destroying it when they go out of scope. The content
+*			 of a message is taken without a copy with iothub::message::take,
+*			 which moves a container into the message and frees it once the
+*			 message and all its clones are destroyed (see
+*			 IoTHubMessage_CreateFromBorrowedBuffer), or referred to with
+*			 iothub::message::borrow. The callbacks are std::function and get
+*			 the received content as an iothub::byte_span over the buffer of
+*			 the SDK, valid during the call only. An exception thrown by a
+*			 callback does not go through the C code calling it: it is caught
+*			 and the SDK gets a safe default (the message is abandoned, the
+*			 method fails with the status 500).
+*
+*			 The errors of the SDK are not turned into exceptions: a failed
+*			 creation gives an empty object (false in a boolean context) and
+*			 the other calls return the result of the C function they wrap.
+*			 The names and values given as std::string_view are copied once
+*			 to be NUL terminated, the C functions needing C strings.
+*
+*			 std::span<const unsigned char> is used as iothub::byte_span when
+*			 the standard library has it, a minimal equivalent otherwise.
+*/
+
+#ifndef IOTHUB_CLIENT_CPP_H
+#define IOTHUB_CLIENT_CPP_H
+
+#include "iothub_client_ll.h"
+#include "iothub_message.h"
+#include "azure_c_shared_utility/map.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if defined(_MSVC_LANG)
+#define IOTHUB_CLIENT_CPP_LANG _MSVC_LANG
+#else
+#define IOTHUB_CLIENT_CPP_LANG __cplusplus
+#endif
+
+#if (IOTHUB_CLIENT_CPP_LANG > 201703L) && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#define IOTHUB_CLIENT_CPP_HAS_SPAN
+#endif
+#endif
+
+namespace iothub
+{
+#ifdef IOTHUB_CLIENT_CPP_HAS_SPAN
+    using byte_span = std::span<const unsigned char>;
+#else
+    /*the part of std::span<const unsigned char> used by this layer*/
+    class byte_span
+    {
+    public:
+        constexpr byte_span() noexcept : data_(nullptr), size_(0) {}
+        constexpr byte_span(const unsigned char* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+        constexpr const unsigned char* data() const noexcept { return data_; }
+        constexpr std::size_t size() const noexcept { return size_; }
+        constexpr bool empty() const noexcept { return size_ == 0; }
+        constexpr const unsigned char* begin() const noexcept { return data_; }
+        constexpr const unsigned char* end() const noexcept { return data_ + size_; }
+        constexpr const unsigned char& operator[](std::size_t index) const noexcept { return data_[index]; }
+
+    private:
+        const unsigned char* data_;
+        std::size_t size_;
+    };
+#endif
+
+    inline byte_span as_bytes(std::string_view text) noexcept
+    {
+        return byte_span(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+    }
+
+    inline std::string_view as_string_view(byte_span bytes) noexcept
+    {
+        return std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    /*a message owned by someone else, for example the SDK during a message callback*/
+    class message_view
+    {
+    public:
+        explicit message_view(IOTHUB_MESSAGE_HANDLE handle) noexcept : handle_(handle) {}
+
+        IOTHUB_MESSAGE_HANDLE get() const noexcept { return handle_; }
+        explicit operator bool() const noexcept { return handle_ != NULL; }
+
+        /*the content, without a copy, whether the message is a byte array or a string*/
+        byte_span body() const noexcept
+        {
+            const unsigned char* buffer;
+            size_t size;
+            const char* text;
+            byte_span result;
+
+            if (IoTHubMessage_GetByteArray(handle_, &buffer, &size) == IOTHUB_MESSAGE_OK)
+            {
+                result = byte_span(buffer, size);
+            }
+            else if ((text = IoTHubMessage_GetString(handle_)) != NULL)
+            {
+                result = as_bytes(text);
+            }
+            return result;
+        }
+
+        std::string_view message_id() const noexcept { return to_string_view(IoTHubMessage_GetMessageId(handle_)); }
+        std::string_view correlation_id() const noexcept { return to_string_view(IoTHubMessage_GetCorrelationId(handle_)); }
+
+        /*the value of the application property name, empty if the message does not have it*/
+        std::string_view property(std::string_view name) const
+        {
+            MAP_HANDLE properties = IoTHubMessage_Properties(handle_);
+            return (properties == NULL) ? std::string_view() : to_string_view(Map_GetValueFromKey(properties, std::string(name).c_str()));
+        }
+
+    protected:
+        static std::string_view to_string_view(const char* text) noexcept
+        {
+            return (text == NULL) ? std::string_view() : std::string_view(text);
+        }
+
+        IOTHUB_MESSAGE_HANDLE handle_;
+    };
+
+    /*a message this object owns, destroyed with it*/
+    class message : public message_view
+    {
+    public:
+        message() noexcept : message_view(NULL) {}
+        /*takes the ownership of handle*/
+        explicit message(IOTHUB_MESSAGE_HANDLE handle) noexcept : message_view(handle) {}
+        message(message&& other) noexcept : message_view(other.release()) {}
+        message& operator=(message&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset(other.release());
+            }
+            return *this;
+        }
+        message(const message&) = delete;
+        message& operator=(const message&) = delete;
+        ~message() { reset(); }
+
+        /*a byte array message with a copy of text, without looking for its end as IoTHubMessage_CreateFromString does*/
+        static message from_string(std::string_view text) noexcept
+        {
+            return from_bytes(as_bytes(text));
+        }
+
+        static message from_bytes(byte_span bytes) noexcept
+        {
+            return message(IoTHubMessage_CreateFromByteArray(bytes.data(), bytes.size()));
+        }
+
+        /*refers to bytes without a copy: they shall not change until on_release is called, once the message and all
+          its clones are destroyed. on_release is not called if the message cannot be created*/
+        static message borrow(byte_span bytes, std::function<void()> on_release)
+        {
+            message result;
+            std::function<void()>* context = new (std::nothrow) std::function<void()>(std::move(on_release));
+
+            if (context != nullptr)
+            {
+                result.reset(IoTHubMessage_CreateFromBorrowedBuffer(bytes.data(), bytes.size(), call_and_delete_release, context));
+                if (!result)
+                {
+                    delete context;
+                }
+            }
+            return result;
+        }
+
+        /*moves container (a std::string, a std::vector of bytes...) into the message, the content being sent from
+          the container itself. It is destroyed once the message and all its clones are destroyed*/
+        template <typename CONTAINER>
+        static message take(CONTAINER&& container)
+        {
+            using OWNED_CONTAINER = typename std::decay<CONTAINER>::type;
+            static_assert(!std::is_lvalue_reference<CONTAINER>::value, "take moves the container, pass it with std::move");
+            static_assert(sizeof(*container.data()) == 1, "the container shall hold bytes");
+
+            message result;
+            OWNED_CONTAINER* owned = new (std::nothrow) OWNED_CONTAINER(std::forward<CONTAINER>(container));
+
+            if (owned != nullptr)
+            {
+                result.reset(IoTHubMessage_CreateFromBorrowedBuffer(reinterpret_cast<const unsigned char*>(owned->data()), owned->size(), delete_container<OWNED_CONTAINER>, owned));
+                if (!result)
+                {
+                    delete owned;
+                }
+            }
+            return result;
+        }
+
+        IOTHUB_MESSAGE_RESULT set_message_id(std::string_view message_id) { return IoTHubMessage_SetMessageId(handle_, std::string(message_id).c_str()); }
+        IOTHUB_MESSAGE_RESULT set_correlation_id(std::string_view correlation_id) { return IoTHubMessage_SetCorrelationId(handle_, std::string(correlation_id).c_str()); }
+
+        MAP_RESULT set_property(std::string_view name, std::string_view value)
+        {
+            MAP_HANDLE properties = IoTHubMessage_Properties(handle_);
+            return (properties == NULL) ? MAP_ERROR : Map_AddOrUpdate(properties, std::string(name).c_str(), std::string(value).c_str());
+        }
+
+        /*gives the handle up, the caller owning it afterwards*/
+        IOTHUB_MESSAGE_HANDLE release() noexcept
+        {
+            IOTHUB_MESSAGE_HANDLE result = handle_;
+            handle_ = NULL;
+            return result;
+        }
+
+        void reset(IOTHUB_MESSAGE_HANDLE handle = NULL) noexcept
+        {
+            if (handle_ != NULL)
+            {
+                IoTHubMessage_Destroy(handle_);
+            }
+            handle_ = handle;
+        }
+
+    private:
+        static void call_and_delete_release(const unsigned char* buffer, void* context)
+        {
+            std::function<void()>* on_release = static_cast<std::function<void()>*>(context);
+            (void)buffer;
+            if (*on_release)
+            {
+                try
+                {
+                    (*on_release)();
+                }
+                catch (...)
+                {
+                    /*the buffer is released anyway*/
+                }
+            }
+            delete on_release;
+        }
+
+        template <typename OWNED_CONTAINER>
+        static void delete_container(const unsigned char* buffer, void* context)
+        {
+            (void)buffer;
+            delete static_cast<OWNED_CONTAINER*>(context);
+        }
+    };
+
+    /*an IoTHubClient_LL this object owns, destroyed with it. The callbacks are called from do_work*/
+    class client_ll
+    {
+    public:
+        typedef std::function<void(IOTHUB_CLIENT_CONFIRMATION_RESULT)> confirmation_callback;
+        typedef std::function<IOTHUBMESSAGE_DISPOSITION_RESULT(const message_view&)> message_callback;
+        typedef std::function<void(DEVICE_TWIN_UPDATE_STATE, byte_span)> device_twin_callback;
+        typedef std::function<void(int)> reported_state_callback;
+        /*returns the status of the method, response being sent back with it*/
+        typedef std::function<int(std::string_view, byte_span, std::string&)> device_method_callback;
+        typedef std::function<void(IOTHUB_CLIENT_CONNECTION_STATUS, IOTHUB_CLIENT_CONNECTION_STATUS_REASON)> connection_status_callback;
+
+        client_ll() noexcept : handle_(NULL) {}
+        /*takes the ownership of handle*/
+        explicit client_ll(IOTHUB_CLIENT_LL_HANDLE handle) noexcept : handle_(NULL), callbacks_(new (std::nothrow) callbacks())
+        {
+            /*the callbacks are allocated before handle is adopted, so a failure destroys it instead of leaking it*/
+            if (!callbacks_)
+            {
+                if (handle != NULL)
+                {
+                    IoTHubClient_LL_Destroy(handle);
+                }
+            }
+            else
+            {
+                handle_ = handle;
+            }
+        }
+        client_ll(client_ll&& other) noexcept : handle_(other.handle_), callbacks_(std::move(other.callbacks_)) { other.handle_ = NULL; }
+        client_ll& operator=(client_ll&& other) noexcept
+        {
+            if (this != &other)
+            {
+                destroy();
+                handle_ = other.handle_;
+                callbacks_ = std::move(other.callbacks_);
+                other.handle_ = NULL;
+            }
+            return *this;
+        }
+        client_ll(const client_ll&) = delete;
+        client_ll& operator=(const client_ll&) = delete;
+        ~client_ll() { destroy(); }
+
+        static client_ll from_connection_string(std::string_view connection_string, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+        {
+            IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_CreateFromConnectionString(std::string(connection_string).c_str(), protocol);
+            return (handle == NULL) ? client_ll() : client_ll(handle);
+        }
+
+        IOTHUB_CLIENT_LL_HANDLE get() const noexcept { return handle_; }
+        explicit operator bool() const noexcept { return handle_ != NULL; }
+
+        /*sends event without a copy: on success the client owns it and event is left empty, otherwise event keeps it.
+          on_confirmation, if any, is called once, including with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY*/
+        IOTHUB_CLIENT_RESULT send_event(message& event, confirmation_callback on_confirmation = confirmation_callback())
+        {
+            IOTHUB_CLIENT_RESULT result;
+            confirmation_callback* context = NULL;
+
+            if (on_confirmation && ((context = new (std::nothrow) confirmation_callback(std::move(on_confirmation))) == nullptr))
+            {
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if ((result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle_, event.get(), (context == NULL) ? NULL : on_event_confirmation, context)) != IOTHUB_CLIENT_OK)
+            {
+                delete context;
+            }
+            else
+            {
+                (void)event.release();
+            }
+            return result;
+        }
+
+        IOTHUB_CLIENT_RESULT send_event(message&& event, confirmation_callback on_confirmation = confirmation_callback())
+        {
+            return send_event(event, std::move(on_confirmation));
+        }
+
+        IOTHUB_CLIENT_RESULT send_reported_state(byte_span reported_state, reported_state_callback on_reported = reported_state_callback())
+        {
+            IOTHUB_CLIENT_RESULT result;
+            reported_state_callback* context = NULL;
+
+            if (on_reported && ((context = new (std::nothrow) reported_state_callback(std::move(on_reported))) == nullptr))
+            {
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if ((result = IoTHubClient_LL_SendReportedState(handle_, reported_state.data(), reported_state.size(), (context == NULL) ? NULL : on_reported_state, context)) != IOTHUB_CLIENT_OK)
+            {
+                delete context;
+            }
+            return result;
+        }
+
+        IOTHUB_CLIENT_RESULT set_message_callback(message_callback on_message)
+        {
+            return set_callback(&callbacks::on_message, std::move(on_message), [this](bool is_set) {
+                return IoTHubClient_LL_SetMessageCallback(handle_, is_set ? on_message_received : NULL, callbacks_.get());
+            });
+        }
+
+        IOTHUB_CLIENT_RESULT set_device_twin_callback(device_twin_callback on_device_twin)
+        {
+            return set_callback(&callbacks::on_device_twin, std::move(on_device_twin), [this](bool is_set) {
+                return IoTHubClient_LL_SetDeviceTwinCallback(handle_, is_set ? on_device_twin_received : NULL, callbacks_.get());
+            });
+        }
+
+        IOTHUB_CLIENT_RESULT set_device_method_callback(device_method_callback on_device_method)
+        {
+            return set_callback(&callbacks::on_device_method, std::move(on_device_method), [this](bool is_set) {
+                return IoTHubClient_LL_SetDeviceMethodCallback(handle_, is_set ? on_device_method_received : NULL, callbacks_.get());
+            });
+        }
+
+        IOTHUB_CLIENT_RESULT set_connection_status_callback(connection_status_callback on_connection_status)
+        {
+            return set_callback(&callbacks::on_connection_status, std::move(on_connection_status), [this](bool is_set) {
+                return IoTHubClient_LL_SetConnectionStatusCallback(handle_, is_set ? on_connection_status_changed : NULL, callbacks_.get());
+            });
+        }
+
+        IOTHUB_CLIENT_RESULT set_option(const char* option_name, const void* value) { return IoTHubClient_LL_SetOption(handle_, option_name, value); }
+
+        IOTHUB_CLIENT_RESULT pause_receive() { return IoTHubClient_LL_PauseReceive(handle_); }
+
+        IOTHUB_CLIENT_RESULT resume_receive() { return IoTHubClient_LL_ResumeReceive(handle_); }
+
+        void do_work() { IoTHubClient_LL_DoWork(handle_); }
+
+    private:
+        /*kept apart from the object, so moving the client does not move the context the SDK holds*/
+        struct callbacks
+        {
+            message_callback on_message;
+            device_twin_callback on_device_twin;
+            device_method_callback on_device_method;
+            connection_status_callback on_connection_status;
+        };
+
+        template <typename CALLBACK, typename SET_FUNCTION>
+        IOTHUB_CLIENT_RESULT set_callback(CALLBACK callbacks::* saved_member, CALLBACK callback, SET_FUNCTION set_function)
+        {
+            IOTHUB_CLIENT_RESULT result;
+
+            if (!callbacks_)
+            {
+                /*moved from*/
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else if (!callback)
+            {
+                CALLBACK& saved = (*callbacks_).*saved_member;
+
+                /*the SDK stops calling it before it is cleared*/
+                if ((result = set_function(false)) == IOTHUB_CLIENT_OK)
+                {
+                    saved = CALLBACK();
+                }
+            }
+            else
+            {
+                CALLBACK& saved = (*callbacks_).*saved_member;
+                /*the SDK only calls it from do_work, so it can be replaced before the SDK is told*/
+                CALLBACK previous = std::move(saved);
+                saved = std::move(callback);
+                if ((result = set_function(true)) != IOTHUB_CLIENT_OK)
+                {
+                    saved = std::move(previous);
+                }
+            }
+            return result;
+        }
+
+        void destroy() noexcept
+        {
+            if (handle_ != NULL)
+            {
+                /*calls the confirmation callbacks of the events not confirmed yet*/
+                IoTHubClient_LL_Destroy(handle_);
+                handle_ = NULL;
+            }
+            callbacks_.reset();
+        }
+
+        static void on_event_confirmation(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* context)
+        {
+            confirmation_callback* on_confirmation = static_cast<confirmation_callback*>(context);
+            try
+            {
+                (*on_confirmation)(result);
+            }
+            catch (...)
+            {
+            }
+            delete on_confirmation;
+        }
+
+        static void on_reported_state(int status_code, void* context)
+        {
+            reported_state_callback* on_reported = static_cast<reported_state_callback*>(context);
+            try
+            {
+                (*on_reported)(status_code);
+            }
+            catch (...)
+            {
+            }
+            delete on_reported;
+        }
+
+        static IOTHUBMESSAGE_DISPOSITION_RESULT on_message_received(IOTHUB_MESSAGE_HANDLE received, void* context)
+        {
+            IOTHUBMESSAGE_DISPOSITION_RESULT result;
+            try
+            {
+                result = static_cast<callbacks*>(context)->on_message(message_view(received));
+            }
+            catch (...)
+            {
+                /*the message is delivered again instead of being lost*/
+                result = IOTHUBMESSAGE_ABANDONED;
+            }
+            return result;
+        }
+
+        static void on_device_twin_received(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payload, size_t size, void* context)
+        {
+            try
+            {
+                static_cast<callbacks*>(context)->on_device_twin(update_state, byte_span(payload, size));
+            }
+            catch (...)
+            {
+            }
+        }
+
+        static int on_device_method_received(const char* method_name, const unsigned char* payload, size_t size, unsigned char** response, size_t* response_size, void* context)
+        {
+            std::string response_text;
+            int result;
+            try
+            {
+                result = static_cast<callbacks*>(context)->on_device_method(method_name, byte_span(payload, size), response_text);
+            }
+            catch (...)
+            {
+                response_text.clear();
+                result = 500;
+            }
+
+            /*the SDK frees the response it is given*/
+            if ((*response = static_cast<unsigned char*>(malloc(response_text.size() + 1))) == NULL)
+            {
+                *response_size = 0;
+                result = 500;
+            }
+            else
+            {
+                (void)memcpy(*response, response_text.data(), response_text.size());
+                *response_size = response_text.size();
+            }
+            return result;
+        }
+
+        static void on_connection_status_changed(IOTHUB_CLIENT_CONNECTION_STATUS status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* context)
+        {
+            try
+            {
+                static_cast<callbacks*>(context)->on_connection_status(status, reason);
+            }
+            catch (...)
+            {
+            }
+        }
+
+        IOTHUB_CLIENT_LL_HANDLE handle_;
+        std::unique_ptr<callbacks> callbacks_;
+    };
+}
+
+#endif /* IOTHUB_CLIENT_CPP_H */
@@ -0,0 +1,340 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_cpp_async.h
+*	@brief	 Header only C++ layer over the IoTHubClient convenience layer,
+*		     whose sends and reported states return an awaitable operation.
+*
+*	@details iothub::client owns an IOTHUB_CLIENT_HANDLE and is move-only like
+*			 iothub::client_ll. iothub::client::send_event and
+*			 iothub::client::send_reported_state start the operation and
+*			 return an iothub::operation right away, so any number of them
+*			 can be in flight at once. An operation is completed by the
+*			 callback of the SDK. Its result is given by get(), which blocks,
+*			 or by co_await when the compiler has C++20 coroutines. A
+*			 coroutine awaiting an operation does not hold a thread: it is
+*			 resumed on the thread of the SDK calling the callback (the
+*			 thread of the client, of the worker pool or the callback
+*			 dispatch thread, see OPTION_CALLBACK_DISPATCH_QUEUE_SIZE), from
+*			 which it can start the next operations. IoTHubClient_Destroy
+*			 completes the operations still in flight with
+*			 IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.
+*
+*			 A method is handed to the application as an
+*			 iothub::method_request, answered with respond() whenever the
+*			 coroutine handling it is done, for example after awaiting a send.
+*/
+
+#ifndef IOTHUB_CLIENT_CPP_ASYNC_H
+#define IOTHUB_CLIENT_CPP_ASYNC_H
+
+#include "iothub_client.h"
+#include "iothub_client_cpp.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define IOTHUB_CLIENT_CPP_HAS_COROUTINES
+#endif
+#endif
+
+namespace iothub
+{
+    /*the result of an operation in flight, awaited once*/
+    template <typename RESULT>
+    class operation
+    {
+    public:
+        operation(operation&&) noexcept = default;
+        operation& operator=(operation&&) noexcept = default;
+        operation(const operation&) = delete;
+        operation& operator=(const operation&) = delete;
+
+        /*the result of starting the operation. If it is not IOTHUB_CLIENT_OK the operation is already done with the
+          failed result it was created with*/
+        IOTHUB_CLIENT_RESULT start_result() const noexcept { return start_result_; }
+
+        bool is_done() const
+        {
+            std::lock_guard<std::mutex> guard(state_->lock);
+            return state_->is_done;
+        }
+
+        /*blocks until the operation is done. It shall not be called from a callback of the client, which would then
+          wait for itself*/
+        RESULT get()
+        {
+            std::unique_lock<std::mutex> guard(state_->lock);
+            state_->done_condition.wait(guard, [this]() { return state_->is_done; });
+            return state_->result;
+        }
+
+#ifdef IOTHUB_CLIENT_CPP_HAS_COROUTINES
+        bool await_ready() const { return is_done(); }
+
+        bool await_suspend(std::coroutine_handle<> waiter)
+        {
+            std::lock_guard<std::mutex> guard(state_->lock);
+            /*not suspended if it was done since await_ready*/
+            if (!state_->is_done)
+            {
+                state_->waiter = waiter;
+            }
+            return !state_->is_done;
+        }
+
+        RESULT await_resume()
+        {
+            std::lock_guard<std::mutex> guard(state_->lock);
+            return state_->result;
+        }
+#endif
+
+    private:
+        friend class client;
+
+        struct state
+        {
+            std::mutex lock;
+            std::condition_variable done_condition;
+            bool is_done = false;
+            RESULT result;
+#ifdef IOTHUB_CLIENT_CPP_HAS_COROUTINES
+            std::coroutine_handle<> waiter;
+#endif
+
+            explicit state(RESULT failed_result) : result(failed_result) {}
+
+            void complete(RESULT completed_result)
+            {
+#ifdef IOTHUB_CLIENT_CPP_HAS_COROUTINES
+                std::coroutine_handle<> to_resume;
+#endif
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    result = completed_result;
+                    is_done = true;
+#ifdef IOTHUB_CLIENT_CPP_HAS_COROUTINES
+                    to_resume = waiter;
+                    waiter = nullptr;
+#endif
+                }
+                done_condition.notify_all();
+#ifdef IOTHUB_CLIENT_CPP_HAS_COROUTINES
+                /*the continuation runs here, on the thread of the SDK*/
+                if (to_resume)
+                {
+                    to_resume.resume();
+                }
+#endif
+            }
+        };
+
+        explicit operation(RESULT failed_result) : state_(std::make_shared<state>(failed_result)), start_result_(IOTHUB_CLIENT_ERROR) {}
+
+        /*the context given to the SDK, keeping the state alive until the callback*/
+        std::shared_ptr<state>* new_context() { return new (std::nothrow) std::shared_ptr<state>(state_); }
+
+        template <typename COMPLETED_RESULT>
+        static void complete_and_delete_context(COMPLETED_RESULT completed_result, void* context)
+        {
+            std::shared_ptr<state>* completed = static_cast<std::shared_ptr<state>*>(context);
+            (*completed)->complete(static_cast<RESULT>(completed_result));
+            delete completed;
+        }
+
+        void fail(IOTHUB_CLIENT_RESULT start_result) noexcept
+        {
+            start_result_ = start_result;
+            std::lock_guard<std::mutex> guard(state_->lock);
+            state_->is_done = true;
+        }
+
+        std::shared_ptr<state> state_;
+        IOTHUB_CLIENT_RESULT start_result_;
+    };
+
+    /*a method invoked on the device, answered once with respond. The name and payload are copies, they stay valid
+      after the callback returns*/
+    class method_request
+    {
+    public:
+        const std::string& method_name() const noexcept { return method_name_; }
+        byte_span payload() const noexcept { return byte_span(payload_.data(), payload_.size()); }
+
+        IOTHUB_CLIENT_RESULT respond(int status_code, byte_span response) const
+        {
+            return IoTHubClient_DeviceMethodResponse(client_handle_, method_id_, response.data(), response.size(), status_code);
+        }
+
+    private:
+        friend class client;
+
+        method_request(IOTHUB_CLIENT_HANDLE client_handle, METHOD_HANDLE method_id, const char* method_name, const unsigned char* payload, size_t size)
+            : client_handle_(client_handle), method_id_(method_id), method_name_(method_name), payload_(payload, payload + size) {}
+
+        IOTHUB_CLIENT_HANDLE client_handle_;
+        METHOD_HANDLE method_id_;
+        std::string method_name_;
+        std::vector<unsigned char> payload_;
+    };
+
+    /*an IoTHubClient this object owns, destroyed with it*/
+    class client
+    {
+    public:
+        typedef std::function<void(method_request)> device_method_callback;
+
+        client() noexcept : handle_(NULL) {}
+        /*takes the ownership of handle*/
+        explicit client(IOTHUB_CLIENT_HANDLE handle) : handle_(handle), callbacks_(new callbacks()) { callbacks_->handle = handle; }
+        client(client&& other) noexcept : handle_(other.handle_), callbacks_(std::move(other.callbacks_)) { other.handle_ = NULL; }
+        client& operator=(client&& other) noexcept
+        {
+            if (this != &other)
+            {
+                destroy();
+                handle_ = other.handle_;
+                callbacks_ = std::move(other.callbacks_);
+                other.handle_ = NULL;
+            }
+            return *this;
+        }
+        client(const client&) = delete;
+        client& operator=(const client&) = delete;
+        ~client() { destroy(); }
+
+        static client from_connection_string(std::string_view connection_string, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+        {
+            IOTHUB_CLIENT_HANDLE handle = IoTHubClient_CreateFromConnectionString(std::string(connection_string).c_str(), protocol);
+            return (handle == NULL) ? client() : client(handle);
+        }
+
+        IOTHUB_CLIENT_HANDLE get() const noexcept { return handle_; }
+        explicit operator bool() const noexcept { return handle_ != NULL; }
+
+        /*sends event without a copy: once started the client owns it and event is left empty, otherwise event keeps it
+          and the operation is done with IOTHUB_CLIENT_CONFIRMATION_ERROR*/
+        operation<IOTHUB_CLIENT_CONFIRMATION_RESULT> send_event(message& event)
+        {
+            operation<IOTHUB_CLIENT_CONFIRMATION_RESULT> result(IOTHUB_CLIENT_CONFIRMATION_ERROR);
+            std::shared_ptr<operation<IOTHUB_CLIENT_CONFIRMATION_RESULT>::state>* context = result.new_context();
+            IOTHUB_CLIENT_RESULT start_result;
+
+            if (context == nullptr)
+            {
+                result.fail(IOTHUB_CLIENT_ERROR);
+            }
+            else if ((start_result = IoTHubClient_SendEventAsync_TakeOwnership(handle_, event.get(), operation<IOTHUB_CLIENT_CONFIRMATION_RESULT>::complete_and_delete_context<IOTHUB_CLIENT_CONFIRMATION_RESULT>, context)) != IOTHUB_CLIENT_OK)
+            {
+                delete context;
+                result.fail(start_result);
+            }
+            else
+            {
+                (void)event.release();
+                result.start_result_ = IOTHUB_CLIENT_OK;
+            }
+            return result;
+        }
+
+        operation<IOTHUB_CLIENT_CONFIRMATION_RESULT> send_event(message&& event)
+        {
+            return send_event(event);
+        }
+
+        /*sends the reported state (copied by the SDK); the operation gives the status code of the hub, 0 if it could
+          not be started*/
+        operation<int> send_reported_state(byte_span reported_state)
+        {
+            operation<int> result(0);
+            std::shared_ptr<operation<int>::state>* context = result.new_context();
+            IOTHUB_CLIENT_RESULT start_result;
+
+            if (context == nullptr)
+            {
+                result.fail(IOTHUB_CLIENT_ERROR);
+            }
+            else if ((start_result = IoTHubClient_SendReportedState(handle_, reported_state.data(), reported_state.size(), operation<int>::complete_and_delete_context<int>, context)) != IOTHUB_CLIENT_OK)
+            {
+                delete context;
+                result.fail(start_result);
+            }
+            else
+            {
+                result.start_result_ = IOTHUB_CLIENT_OK;
+            }
+            return result;
+        }
+
+        /*on_device_method gets each method invoked on the device, to be answered with method_request::respond*/
+        IOTHUB_CLIENT_RESULT set_device_method_callback(device_method_callback on_device_method)
+        {
+            IOTHUB_CLIENT_RESULT result;
+
+            if (!callbacks_)
+            {
+                /*moved from*/
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else if (!on_device_method)
+            {
+                if ((result = IoTHubClient_SetDeviceMethodCallback_Ex(handle_, NULL, NULL)) == IOTHUB_CLIENT_OK)
+                {
+                    callbacks_->on_device_method = device_method_callback();
+                }
+            }
+            else
+            {
+                device_method_callback previous = std::move(callbacks_->on_device_method);
+                callbacks_->on_device_method = std::move(on_device_method);
+                if ((result = IoTHubClient_SetDeviceMethodCallback_Ex(handle_, on_device_method_received, callbacks_.get())) != IOTHUB_CLIENT_OK)
+                {
+                    callbacks_->on_device_method = std::move(previous);
+                }
+            }
+            return result;
+        }
+
+        IOTHUB_CLIENT_RESULT set_option(const char* option_name, const void* value) { return IoTHubClient_SetOption(handle_, option_name, value); }
+
+    private:
+        /*kept apart from the object, so moving the client does not move the context the SDK holds*/
+        struct callbacks
+        {
+            IOTHUB_CLIENT_HANDLE handle;
+            device_method_callback on_device_method;
+        };
+
+        void destroy() noexcept
+        {
+            if (handle_ != NULL)
+            {
+                /*completes the operations still in flight*/
+                IoTHubClient_Destroy(handle_);
+                handle_ = NULL;
+            }
+            callbacks_.reset();
+        }
+
+        static int on_device_method_received(const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id, void* context)
+        {
+            callbacks* client_callbacks = static_cast<callbacks*>(context);
+            client_callbacks->on_device_method(method_request(client_callbacks->handle, method_id, method_name, payload, size));
+            return 0;
+        }
+
+        IOTHUB_CLIENT_HANDLE handle_;
+        std::unique_ptr<callbacks> callbacks_;
+    };
+}
+
+#endif /* IOTHUB_CLIENT_CPP_ASYNC_H */
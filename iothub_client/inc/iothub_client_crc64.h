@@ -0,0 +1,26 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_CRC64_H
+#define IOTHUB_CLIENT_CRC64_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* The CRC64 storage checks in the x-ms-content-crc64 header of a "Put Block": polynomial 0x9A6C9329AC4BC9B5 (reflected),
+   initial value and final xor all ones. It is computed 8 bytes at a time from 8 tables (slicing-by-8), which keeps it
+   well above network throughput without relying on CPU extensions.
+   crc is the CRC64 of the bytes before data, 0 for the first bytes, so a CRC64 can be computed over several calls. */
+MOCKABLE_FUNCTION(, uint64_t, crc64_compute, uint64_t, crc, const unsigned char*, data, size_t, size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_CRC64_H */
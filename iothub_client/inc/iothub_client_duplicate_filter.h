@@ -0,0 +1,34 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_DUPLICATE_FILTER_H
+#define IOTHUB_CLIENT_DUPLICATE_FILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* A duplicate filter remembers the message ids it is given for a window of time in two bloom filters of fixed size,
+   the current one and the one of the previous window, so its memory does not grow with the messages received.
+   The current filter becomes the previous one when the window elapses or when it holds capacity ids: an id is
+   remembered for one to two windows. A bloom filter has false positives, an id never added being reported as seen
+   about once in 100 while the current filter is full.
+   A duplicate filter is not thread safe. */
+typedef struct DUPLICATE_FILTER_TAG* DUPLICATE_FILTER_HANDLE;
+
+MOCKABLE_FUNCTION(, DUPLICATE_FILTER_HANDLE, duplicate_filter_create, size_t, capacity, tickcounter_ms_t, windowInMs);
+MOCKABLE_FUNCTION(, void, duplicate_filter_destroy, DUPLICATE_FILTER_HANDLE, filter);
+MOCKABLE_FUNCTION(, bool, duplicate_filter_contains, DUPLICATE_FILTER_HANDLE, filter, const char*, messageId, tickcounter_ms_t, nowMs);
+MOCKABLE_FUNCTION(, void, duplicate_filter_add, DUPLICATE_FILTER_HANDLE, filter, const char*, messageId, tickcounter_ms_t, nowMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_DUPLICATE_FILTER_H */
@@ -0,0 +1,41 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_FEATURES_H
+#define IOTHUB_CLIENT_FEATURES_H
+
+/* The subsystems of the client that can be compiled out. A subsystem that is left out costs neither code nor per
+   client state, and its APIs are not declared, so an application using it fails to build instead of failing at run
+   time. cmake sets them from its options, a build without cmake defines them before including any header of the SDK:
+
+       DONT_USE_UPLOADTOBLOB      (-Ddont_use_uploadtoblob=ON)   IoTHubClient_UploadToBlob and the blob options
+       DONT_USE_DEVICE_TWIN       (-Ddont_use_device_twin=ON)    IoTHubClient_SetDeviceTwinCallback,
+                                                                 IoTHubClient_SendReportedState and the twin options
+       DONT_USE_DEVICE_METHODS    (-Ddont_use_device_methods=ON) IoTHubClient_SetDeviceMethodCallback(_Ex) and
+                                                                 IoTHubClient_DeviceMethodResponse
+       DONT_USE_MULTIPLEXING      (-Ddont_use_multiplexing=ON)   IoTHubClient_CreateWithTransport and the shared
+                                                                 transports (iothubtransport.c, the transport pool)
+
+   IOTHUB_CLIENT_TELEMETRY_ONLY (-Dtelemetry_only=ON) leaves out all of them, for devices that only send events and
+   receive messages.
+
+   The transports keep their part of the twin and of the methods: it is only driven once the client subscribes,
+   which a client built without them never does. The serializer twin glue (serializer_devicetwin.h) needs the
+   device twin and the device methods. */
+
+#ifdef IOTHUB_CLIENT_TELEMETRY_ONLY
+#ifndef DONT_USE_UPLOADTOBLOB
+#define DONT_USE_UPLOADTOBLOB
+#endif
+#ifndef DONT_USE_DEVICE_TWIN
+#define DONT_USE_DEVICE_TWIN
+#endif
+#ifndef DONT_USE_DEVICE_METHODS
+#define DONT_USE_DEVICE_METHODS
+#endif
+#ifndef DONT_USE_MULTIPLEXING
+#define DONT_USE_MULTIPLEXING
+#endif
+#endif /*IOTHUB_CLIENT_TELEMETRY_ONLY*/
+
+#endif /* IOTHUB_CLIENT_FEATURES_H */
@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_HAPPY_EYEBALLS_H
+#define IOTHUB_CLIENT_HAPPY_EYEBALLS_H
+
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HAPPY_EYEBALLS_DEFAULT_CONNECTION_ATTEMPT_DELAY_IN_MS 250
+#define HAPPY_EYEBALLS_MAX_HOSTS 8
+#define HAPPY_EYEBALLS_FAMILY_LIFETIME_IN_MS (10 * 60 * 1000)
+
+/* Happy eyeballs (RFC 8305) is shared by the transports (set with the option "happy_eyeballs", the value being the
+   HAPPY_EYEBALLS_HANDLE itself). The IPv6 and IPv4 attempts are raced by the platform socket adapter: the transports
+   give every new connection the delay between the attempts and the address family that last won for its host, so a
+   dual-stack device whose IPv6 route is broken does not pay the IPv6 timeout at each reconnect. The family that won is
+   remembered for HAPPY_EYEBALLS_FAMILY_LIFETIME_IN_MS and forgotten as soon as a connection to the host fails.
+   Happy eyeballs is thread safe and must outlive the transports it is set on. */
+typedef struct HAPPY_EYEBALLS_TAG* HAPPY_EYEBALLS_HANDLE;
+
+MOCKABLE_FUNCTION(, HAPPY_EYEBALLS_HANDLE, happy_eyeballs_create, unsigned int, connection_attempt_delay_in_ms);
+MOCKABLE_FUNCTION(, void, happy_eyeballs_destroy, HAPPY_EYEBALLS_HANDLE, happy_eyeballs);
+/* Called on every new xio of the transports, before it is opened. */
+MOCKABLE_FUNCTION(, void, happy_eyeballs_prepare_io, HAPPY_EYEBALLS_HANDLE, happy_eyeballs, XIO_HANDLE, xio, const char*, host);
+MOCKABLE_FUNCTION(, void, happy_eyeballs_on_connected, HAPPY_EYEBALLS_HANDLE, happy_eyeballs, XIO_HANDLE, xio, const char*, host);
+MOCKABLE_FUNCTION(, void, happy_eyeballs_on_connect_failed, HAPPY_EYEBALLS_HANDLE, happy_eyeballs, const char*, host);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_HAPPY_EYEBALLS_H */
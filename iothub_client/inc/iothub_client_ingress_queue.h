@@ -0,0 +1,34 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_INGRESS_QUEUE_H
+#define IOTHUB_CLIENT_INGRESS_QUEUE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* An ingress queue is a multi-producer/single-consumer FIFO of pointers.
+   ingress_queue_push can be called from any number of threads at the same time and does not take a lock
+   when the compiler provides atomic compare-and-swap. ingress_queue_pop and ingress_queue_is_empty shall
+   only be called by the single consumer.
+   was_empty (optional) tells the producer that its value is the first one the consumer has not taken yet,
+   which is when a consumer about to block needs to be woken up. */
+typedef struct INGRESS_QUEUE_TAG* INGRESS_QUEUE_HANDLE;
+
+MOCKABLE_FUNCTION(, INGRESS_QUEUE_HANDLE, ingress_queue_create);
+MOCKABLE_FUNCTION(, void, ingress_queue_destroy, INGRESS_QUEUE_HANDLE, ingress_queue);
+MOCKABLE_FUNCTION(, int, ingress_queue_push, INGRESS_QUEUE_HANDLE, ingress_queue, void*, value, bool*, was_empty);
+MOCKABLE_FUNCTION(, void*, ingress_queue_pop, INGRESS_QUEUE_HANDLE, ingress_queue);
+MOCKABLE_FUNCTION(, bool, ingress_queue_is_empty, INGRESS_QUEUE_HANDLE, ingress_queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_INGRESS_QUEUE_H */
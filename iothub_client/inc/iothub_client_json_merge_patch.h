@@ -0,0 +1,26 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_JSON_MERGE_PATCH_H
+#define IOTHUB_CLIENT_JSON_MERGE_PATCH_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/constbuffer.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Combines two JSON merge patches (RFC 7386) into one that has the same effect as applying first and then second.
+   Both patches have to be JSON objects. A member that first replaces by a value or removes (null) and that second
+   turns into an object cannot be combined: the merged object would be merged into the member of the document instead
+   of replacing it, so json_merge_patch_combine returns NULL and the patches have to be applied one after the other. */
+MOCKABLE_FUNCTION(, CONSTBUFFER_HANDLE, json_merge_patch_combine, CONSTBUFFER_HANDLE, first, const unsigned char*, second, size_t, second_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_JSON_MERGE_PATCH_H */
@@ -25,13 +25,16 @@
 
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_features.h"
+#include <stdint.h>
 
 #define IOTHUB_CLIENT_RESULT_VALUES       \
     IOTHUB_CLIENT_OK,                     \
     IOTHUB_CLIENT_INVALID_ARG,            \
     IOTHUB_CLIENT_ERROR,                  \
     IOTHUB_CLIENT_INVALID_SIZE,           \
-    IOTHUB_CLIENT_INDEFINITE_TIME
+    IOTHUB_CLIENT_INDEFINITE_TIME,        \
+    IOTHUB_CLIENT_QUEUE_FULL
 
 /** @brief Enumeration specifying the status of calls to various APIs in this module.
 */
@@ -45,7 +48,8 @@ DEFINE_ENUM(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
     IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF,      \
     IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF,                 \
     IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER,                 \
-    IOTHUB_CLIENT_RETRY_RANDOM
+    IOTHUB_CLIENT_RETRY_RANDOM,                 \
+    IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER
 
 /** @brief Enumeration passed in by the IoT Hub when the event confirmation
 *		   callback is invoked to indicate status of the event processing in
@@ -90,6 +94,19 @@ DEFINE_ENUM(IOTHUB_PROCESS_ITEM_RESULT, IOTHUB_PROCESS_ITEM_RESULT_VALUE);
 */
 DEFINE_ENUM(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_DISPOSITION_RESULT_VALUES);
 
+/*events of an IOTHUB_CLIENT_POLL_DESCRIPTOR*/
+#define IOTHUB_CLIENT_POLL_READABLE 0x01
+#define IOTHUB_CLIENT_POLL_WRITABLE 0x02
+
+/** @brief A socket of the transport of a client, and what to wait for on it before
+*		   calling ::IoTHubClient_LL_OnReadable or ::IoTHubClient_LL_OnWritable.
+*/
+typedef struct IOTHUB_CLIENT_POLL_DESCRIPTOR_TAG
+{
+    intptr_t descriptor; /*the file descriptor, or the SOCKET on Windows*/
+    unsigned int events; /*IOTHUB_CLIENT_POLL_READABLE and/or IOTHUB_CLIENT_POLL_WRITABLE*/
+} IOTHUB_CLIENT_POLL_DESCRIPTOR;
+
 #include "azure_c_shared_utility/agenttime.h"
 #include "azure_c_shared_utility/xio.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
@@ -162,16 +179,130 @@ extern "C"
 
     DEFINE_ENUM(DEVICE_TWIN_UPDATE_STATE, DEVICE_TWIN_UPDATE_STATE_VALUES);
 
+#define IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY_VALUES \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT,           \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST,      \
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK
+
+    /** @brief Enumeration specifying what happens to a message sent while the
+    *          send queue is at one of its limits (see @c IOTHUB_CLIENT_SEND_QUEUE_LIMITS).
+    *          @c IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK is only honored by the convenience
+    *          layer, the LL layer rejects the message instead.
+    */
+    DEFINE_ENUM(IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY, IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY_VALUES);
+
+#define IOTHUB_CLIENT_SEND_QUEUE_WATERMARK_VALUES \
+    IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK,      \
+    IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK
+
+    DEFINE_ENUM(IOTHUB_CLIENT_SEND_QUEUE_WATERMARK, IOTHUB_CLIENT_SEND_QUEUE_WATERMARK_VALUES);
+
+#define IOTHUB_MESSAGE_TRACE_STAGE_VALUES             \
+    IOTHUB_MESSAGE_TRACE_STAGE_ENQUEUED,             \
+    IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT,  \
+    IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN,              \
+    IOTHUB_MESSAGE_TRACE_STAGE_ACKED
+
+    /** @brief Enumeration of the stages a traced message goes through: queued by the
+    *          client, taken by the transport, given to the protocol library to be written
+    *          and acknowledged by the IoT Hub (PUBACK, AMQP disposition or HTTP 2xx).
+    */
+    DEFINE_ENUM(IOTHUB_MESSAGE_TRACE_STAGE, IOTHUB_MESSAGE_TRACE_STAGE_VALUES);
+
+/*timestamp of a stage the message has not reached*/
+#define IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE UINT64_MAX
+
+/*IoTHubClient_LL_GetNextWorkDeadlineMs when nothing the client or its transport does is due at a time*/
+#define IOTHUB_CLIENT_NO_WORK_DEADLINE UINT32_MAX
+
+    /** @brief	Milliseconds of the client tick counter at which a message reached each
+    *           stage, @c IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE for the stages it did not
+    *           reach. A message retried by the transport keeps the time of its last try. */
+    typedef struct IOTHUB_CLIENT_MESSAGE_TIMESTAMPS_TAG
+    {
+        uint64_t enqueued;
+        uint64_t handedToTransport;
+        uint64_t written;
+        uint64_t acked;
+    } IOTHUB_CLIENT_MESSAGE_TIMESTAMPS;
+
     typedef void(*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK)(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback);
+    typedef void(*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX)(IOTHUB_CLIENT_CONFIRMATION_RESULT result, const IOTHUB_CLIENT_MESSAGE_TIMESTAMPS* timestamps, void* userContextCallback);
+    typedef void(*IOTHUB_CLIENT_MESSAGE_TRACE_CALLBACK)(IOTHUB_MESSAGE_HANDLE message, IOTHUB_MESSAGE_TRACE_STAGE stage, uint64_t timestamp, void* userContextCallback);
     typedef void(*IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK)(IOTHUB_CLIENT_CONNECTION_STATUS result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* userContextCallback);
+    typedef void(*IOTHUB_CLIENT_SEND_QUEUE_WATERMARK_CALLBACK)(IOTHUB_CLIENT_SEND_QUEUE_WATERMARK watermark, size_t messageCount, size_t byteCount, void* userContextCallback);
     typedef IOTHUBMESSAGE_DISPOSITION_RESULT (*IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC)(IOTHUB_MESSAGE_HANDLE message, void* userContextCallback);
+    typedef IOTHUBMESSAGE_DISPOSITION_RESULT (*IOTHUB_CLIENT_MESSAGE_CHUNK_CALLBACK)(IOTHUB_MESSAGE_HANDLE message, const unsigned char* chunk, size_t size, size_t offset, bool isLast, void* userContextCallback);
     typedef const TRANSPORT_PROVIDER*(*IOTHUB_CLIENT_TRANSPORT_PROVIDER)(void);
 
     typedef void(*IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK)(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback);
+    typedef void(*IOTHUB_CLIENT_DEVICE_TWIN_CHUNK_CALLBACK)(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* chunk, size_t size, size_t offset, bool isLast, void* userContextCallback);
     typedef void(*IOTHUB_CLIENT_REPORTED_STATE_CALLBACK)(int status_code, void* userContextCallback);
     typedef int(*IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC)(const char* method_name, const unsigned char* payload, size_t size, unsigned char** response, size_t* response_size, void* userContextCallback);
     typedef int(*IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK)(const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id, void* userContextCallback);
 
+#define IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES \
+    FILE_UPLOAD_OK, \
+    FILE_UPLOAD_ERROR
+
+    DEFINE_ENUM(IOTHUB_CLIENT_FILE_UPLOAD_RESULT, IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES)
+
+    /** @brief Pulls the content of a file upload one block at a time. While @p data and @p size are non-NULL,
+    *		   the callback sets @p *data and @p *size to the next block (at most 4MB), a @c NULL @p *data or a 0 @p *size
+    *		   means there are no more blocks. The block only needs to stay valid until the next call.
+    *		   Once the upload finished, the callback is called one last time with @p data and @p size NULL and
+    *		   @p result telling whether the file was uploaded.
+    */
+    typedef void(*IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK)(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const ** data, size_t* size, void* context);
+
+    /** @brief	This struct captures the progress of a file upload, given to the
+    *           @c IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK after every block. */
+    typedef struct IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_TAG
+    {
+        /** @brief	Bytes of the file uploaded to storage so far. */
+        uint64_t bytesSent;
+
+        /** @brief	Size of the file, 0 when its blocks come from a @c IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK. */
+        uint64_t totalBytes;
+
+        /** @brief	Blocks uploaded to storage so far. They are committed together once the last one is uploaded. */
+        size_t blocksSent;
+
+        /** @brief	Blocks put again so far after a failure, see the @c blob_upload_block_retries option. */
+        size_t retries;
+
+        /** @brief	Average throughput of the upload so far, in bytes per second. */
+        uint64_t bytesPerSecond;
+    } IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS;
+
+    /** @brief Told the progress of a file upload after every block. Returning a non-zero value cancels the
+    *		   upload before its next block, the upload then fails. It is called from the thread uploading the
+    *		   block, which is not the calling thread when the blocks are uploaded in parallel.
+    */
+    typedef int(*IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK)(const IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS* progress, void* userContextCallback);
+
+    /** @brief	This struct is the value of the @c blob_upload_progress option. */
+    typedef struct IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_REPORTING_TAG
+    {
+        /** @brief	Called after every block of the next uploads, NULL stops the progress reports. */
+        IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK progressCallback;
+        void* progressUserContextCallback;
+    } IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_REPORTING;
+
+    /** @brief	A file of an @c IoTHubClient_LL_UploadMultipleToBlob batch. */
+    typedef struct IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM_TAG
+    {
+        /** @brief	Name of the file, uploaded under the blob name devicename/destinationFileName. */
+        const char* destinationFileName;
+
+        /** @brief	Content of the file, can be NULL when @c size is 0. */
+        const unsigned char* source;
+        size_t size;
+
+        /** @brief	Set by @c IoTHubClient_LL_UploadMultipleToBlob to the result of the upload of this file. */
+        IOTHUB_CLIENT_RESULT result;
+    } IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM;
+
     /** @brief	This struct captures IoTHub client configuration. */
     typedef struct IOTHUB_CLIENT_CONFIG_TAG
     {
@@ -225,6 +356,313 @@ extern "C"
         const char* deviceSasToken;
     } IOTHUB_CLIENT_DEVICE_CONFIG;
 
+    /** @brief	This struct captures the usage of the pool of send queue entries
+    *           (see the @c message_pool_size option). */
+    typedef struct IOTHUB_CLIENT_POOL_STATISTICS_TAG
+    {
+        /** @brief	Number of entries taken from the pool. */
+        size_t hits;
+
+        /** @brief	Number of entries that had to be allocated because the pool was empty. */
+        size_t misses;
+
+        /** @brief	Number of entries currently in the pool. */
+        size_t cached;
+
+        /** @brief	Highest number of entries the pool has held. */
+        size_t highWaterMark;
+    } IOTHUB_CLIENT_POOL_STATISTICS;
+
+#define IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKET_COUNT 16
+
+    /** @brief	This struct captures the traffic of the messages sent while the @c statistics
+    *           option is enabled. The counters are kept by IoTHubClient_LL and do not depend
+    *           on the transport. */
+    typedef struct IOTHUB_CLIENT_STATISTICS_TAG
+    {
+        /** @brief	Number of messages accepted by SendEventAsync. */
+        uint64_t messagesEnqueued;
+
+        /** @brief	Payload bytes of the messages accepted by SendEventAsync. */
+        uint64_t bytesEnqueued;
+
+        /** @brief	Number of messages picked up by the transport, including the ones not confirmed yet. */
+        uint64_t messagesSent;
+
+        /** @brief	Number of messages confirmed with IOTHUB_CLIENT_CONFIRMATION_OK. */
+        uint64_t messagesConfirmed;
+
+        /** @brief	Payload bytes of the messages confirmed with IOTHUB_CLIENT_CONFIRMATION_OK. */
+        uint64_t bytesConfirmed;
+
+        /** @brief	Number of messages completed with IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT. */
+        uint64_t messagesTimedOut;
+
+        /** @brief	Number of messages completed with any other confirmation result. */
+        uint64_t messagesFailed;
+
+        /** @brief	Number of counted messages not picked up by the transport yet. */
+        size_t waitingToSendDepth;
+
+        /** @brief	Number of counted messages picked up by the transport and not confirmed yet. */
+        size_t inProgressDepth;
+
+        /** @brief	Number of times the client authenticated again after losing the connection. */
+        size_t reconnectCount;
+
+        /** @brief	Milliseconds spent disconnected after the first connection, including the current disconnection. */
+        uint64_t msDisconnected;
+
+        /** @brief	Enqueue to confirmation latency of the confirmed messages. Bucket 0 counts the
+        *           latencies below 1 ms, bucket i the latencies in [2^(i-1), 2^i) ms and the last
+        *           bucket all the longer ones. */
+        uint64_t latencyHistogram[IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKET_COUNT];
+
+        /** @brief	Upper bounds, in milliseconds, of the histogram buckets holding the 50th, 95th and
+        *           99th percentile of the latency (the lower bound for the last bucket). 0 when no
+        *           message was confirmed. */
+        uint64_t msLatencyP50;
+        uint64_t msLatencyP95;
+        uint64_t msLatencyP99;
+    } IOTHUB_CLIENT_STATISTICS;
+
+    /** @brief	This struct is the value of the @c send_queue_limits option. The limits apply
+    *           to the messages accepted by SendEventAsync and not confirmed yet. A value of 0
+    *           means "no limit". */
+    typedef struct IOTHUB_CLIENT_SEND_QUEUE_LIMITS_TAG
+    {
+        /** @brief	Maximum number of messages waiting to be confirmed. */
+        size_t maxMessageCount;
+
+        /** @brief	Maximum number of payload bytes waiting to be confirmed. */
+        size_t maxByteCount;
+
+        /** @brief	What to do with a message that does not fit. */
+        IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY fullPolicy;
+
+        /** @brief	For @c IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, the longest time a send waits for room. */
+        unsigned int blockTimeoutInMilliseconds;
+
+        /** @brief	Number of messages at which @c watermarkCallback is called with
+        *           @c IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK, 0 disables the callback. */
+        size_t highWatermark;
+
+        /** @brief	Number of messages at which @c watermarkCallback is called with
+        *           @c IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK after the high watermark was reached. */
+        size_t lowWatermark;
+
+        IOTHUB_CLIENT_SEND_QUEUE_WATERMARK_CALLBACK watermarkCallback;
+        void* watermarkUserContextCallback;
+    } IOTHUB_CLIENT_SEND_QUEUE_LIMITS;
+
+    /** @brief	This struct is the value of the @c rate_limit option. The messages queued
+    *           are handed to the transport no faster than these rates, bursts of up to one
+    *           second of them going at once. The rates in use are halved when the sends fail,
+    *           as they do once the hub throttles the device, and raised back by a tenth of
+    *           them every second afterwards. A value of 0 means "no limit". */
+    typedef struct IOTHUB_CLIENT_RATE_LIMIT_TAG
+    {
+        /** @brief	Messages per second, e.g. the device-to-cloud send quota of the hub
+        *           (that of its tier times its number of units) divided among its devices. */
+        size_t messagesPerSecond;
+
+        /** @brief	Payload bytes per second. A message larger than one second of them
+        *           goes once there was nothing to send for a second. */
+        size_t bytesPerSecond;
+    } IOTHUB_CLIENT_RATE_LIMIT;
+
+    /** @brief	This struct is the value of the @c outbox option. The messages sent afterwards
+    *           are written to a file and sent from it, in order, until they are confirmed, so
+    *           they survive a restart of the device. */
+    typedef struct IOTHUB_CLIENT_OUTBOX_CONFIG_TAG
+    {
+        /** @brief	Name of the file, it is created if it does not exist. */
+        const char* fileName;
+
+        /** @brief	Largest size of the file in bytes, a message that does not fit is refused
+        *           with @c IOTHUB_CLIENT_QUEUE_FULL. The size of an existing file is kept. */
+        size_t maxFileSize;
+
+        /** @brief	Number of messages written or confirmed between two syncs of the file to
+        *           the disk, 0 syncs every change. */
+        size_t syncInterval;
+
+        /** @brief	Largest number of messages read from the file and not confirmed yet. */
+        size_t maxInFlight;
+    } IOTHUB_CLIENT_OUTBOX_CONFIG;
+
+    /** @brief	This struct is the value of the @c twin_window option. It bounds the number
+    *           of reported states given to the transport and not acknowledged yet, the
+    *           others wait in the client, where @c coalesce_reported_state can merge them. */
+    typedef struct IOTHUB_CLIENT_TWIN_WINDOW_TAG
+    {
+        /** @brief	Largest number of reported states waiting for their acknowledgement, 0
+        *           gives all of them to the transport as soon as possible. */
+        size_t maxInFlight;
+
+        /** @brief	Seconds after which a reported state that was not acknowledged is
+        *           completed with the status code 408 and leaves the window, 0 never. */
+        size_t ackTimeoutInSeconds;
+    } IOTHUB_CLIENT_TWIN_WINDOW;
+
+    /** @brief	This struct is the value of the @c twin_cache option. While it is enabled, the
+    *           complete twin document received again after a reconnection is given to the
+    *           device twin callback as a @c DEVICE_TWIN_UPDATE_PARTIAL patch of the desired
+    *           properties that changed since the last document or patch, or not at all if
+    *           their @c $version did not change. */
+    typedef struct IOTHUB_CLIENT_TWIN_CACHE_CONFIG_TAG
+    {
+        bool enabled;
+
+        /** @brief	File the desired properties are kept in across restarts, NULL keeps them in
+        *           memory only. With a file the first document after a restart is reduced too,
+        *           for applications that keep the desired properties they applied as well. */
+        const char* fileName;
+    } IOTHUB_CLIENT_TWIN_CACHE_CONFIG;
+
+    /** @brief	This struct is the value of the @c compression option. While it is set, the
+    *           payloads of the messages sent afterwards are compressed with gzip and sent
+    *           with the application property @c content-encoding set to @c gzip. */
+    typedef struct IOTHUB_CLIENT_COMPRESSION_TAG
+    {
+        /** @brief	zlib compression level, from 1 (fastest) to 9 (smallest), 0 disables
+        *           compression. */
+        int level;
+
+        /** @brief	Payloads smaller than this are sent as they are, unless the message asks
+        *           for IOTHUB_MESSAGE_COMPRESSION_GZIP. */
+        size_t minimumSizeInBytes;
+    } IOTHUB_CLIENT_COMPRESSION;
+
+    /** @brief	This struct is the value of the @c message_trace option. While it is set,
+    *           the messages sent afterwards are traced: @c callback is called every time one
+    *           of them reaches an IOTHUB_MESSAGE_TRACE_STAGE. A @c NULL callback stops tracing. */
+    typedef struct IOTHUB_CLIENT_MESSAGE_TRACE_TAG
+    {
+        /** @brief	Called from the thread running ::IoTHubClient_LL_DoWork with the message
+        *           being sent, which shall not be destroyed or kept. */
+        IOTHUB_CLIENT_MESSAGE_TRACE_CALLBACK callback;
+
+        /** @brief	Context given to @c callback. */
+        void* context;
+    } IOTHUB_CLIENT_MESSAGE_TRACE;
+
+#define IOTHUB_CLIENT_MESSAGE_STAGE_TYPE_VALUES \
+    IOTHUB_CLIENT_MESSAGE_STAGE_CUSTOM,         \
+    IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE,         \
+    IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND,       \
+    IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW
+
+    /** @brief Enumeration specifying what a stage of the @c message_pipeline option does
+    *          (see @c IOTHUB_CLIENT_MESSAGE_STAGE).
+    */
+    DEFINE_ENUM(IOTHUB_CLIENT_MESSAGE_STAGE_TYPE, IOTHUB_CLIENT_MESSAGE_STAGE_TYPE_VALUES);
+
+#define IOTHUB_CLIENT_MESSAGE_STAGE_RESULT_VALUES \
+    IOTHUB_CLIENT_MESSAGE_STAGE_KEEP,             \
+    IOTHUB_CLIENT_MESSAGE_STAGE_DROP
+
+    /** @brief Enumeration returned by a stage of the @c message_pipeline option: a kept
+    *          message goes on to the next stage and is sent after the last one, a dropped
+    *          message is not sent.
+    */
+    DEFINE_ENUM(IOTHUB_CLIENT_MESSAGE_STAGE_RESULT, IOTHUB_CLIENT_MESSAGE_STAGE_RESULT_VALUES);
+
+    typedef IOTHUB_CLIENT_MESSAGE_STAGE_RESULT(*IOTHUB_CLIENT_MESSAGE_STAGE_CALLBACK)(IOTHUB_MESSAGE_HANDLE message, void* userContextCallback);
+
+    /** @brief	One stage of the @c message_pipeline option. The stages see the message the
+    *           SDK is about to queue, its own copy unless it was given with
+    *           ::IoTHubClient_LL_SendEventAsync_TakeOwnership, so they can change its
+    *           properties in place. */
+    typedef struct IOTHUB_CLIENT_MESSAGE_STAGE_TAG
+    {
+        /** @brief	@c IOTHUB_CLIENT_MESSAGE_STAGE_CUSTOM calls @c callback.
+        *           @c IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE drops a message whose payload is the
+        *           one of the last message it kept.
+        *           @c IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND drops a message whose number in the
+        *           application property @c propertyName is less than @c deadband away from
+        *           the number of the last message it kept.
+        *           @c IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW keeps one message every
+        *           @c windowInMs and drops the others, the message kept getting the
+        *           application properties @c propertyName-count, -min, -max and -avg of the
+        *           numbers of the messages since the last one kept, itself included.
+        *           The messages without a number in @c propertyName go through the
+        *           deadband and window stages. */
+        IOTHUB_CLIENT_MESSAGE_STAGE_TYPE type;
+
+        /** @brief	Called from the thread sending the message, which shall not be destroyed
+        *           or kept. */
+        IOTHUB_CLIENT_MESSAGE_STAGE_CALLBACK callback;
+
+        /** @brief	Context given to @c callback. */
+        void* context;
+
+        /** @brief	Application property holding the number of the deadband and window
+        *           stages. */
+        const char* propertyName;
+
+        /** @brief	Smallest change of the number kept by the deadband stage. */
+        double deadband;
+
+        /** @brief	Duplicates dropped in a row after which the dedupe stage keeps one, 0
+        *           dropping them all. */
+        size_t maxSuppressedCount;
+
+        /** @brief	Time between two messages kept by the window stage. */
+        unsigned int windowInMs;
+    } IOTHUB_CLIENT_MESSAGE_STAGE;
+
+    /** @brief	This struct is the value of the @c message_pipeline option. While it is set,
+    *           the messages sent afterwards go through @c stages in order before they are
+    *           queued (and compressed). A dropped message is not queued: its confirmation
+    *           callback is called with IOTHUB_CLIENT_CONFIRMATION_OK before
+    *           ::IoTHubClient_LL_SendEventAsync returns. No stages removes the pipeline. */
+    typedef struct IOTHUB_CLIENT_MESSAGE_PIPELINE_TAG
+    {
+        /** @brief	The stages, copied by the option. */
+        const IOTHUB_CLIENT_MESSAGE_STAGE* stages;
+
+        /** @brief	Number of @c stages. */
+        size_t stageCount;
+    } IOTHUB_CLIENT_MESSAGE_PIPELINE;
+
+    /** @brief	This struct is the value of the @c c2d_duplicate_filter option. While it is
+    *           set, a cloud-to-device message whose message id was given to the application
+    *           in the last one to two windows is accepted without being given to it again.
+    *           The ids are kept in bloom filters of fixed size: about one message in 100
+    *           with a new id is taken for a duplicate while the ids of a window reach
+    *           @c capacity. A @c capacity of 0 removes the filter. */
+    typedef struct IOTHUB_CLIENT_DUPLICATE_FILTER_TAG
+    {
+        /** @brief	Message ids remembered per window, the filter taking 2.5 bytes per id. */
+        size_t capacity;
+
+        /** @brief	Time an id is remembered at least. */
+        unsigned int windowInSeconds;
+    } IOTHUB_CLIENT_DUPLICATE_FILTER;
+
+#define IOTHUB_CLIENT_PRIORITY_MAX_WEIGHT 1000
+
+    /** @brief	This struct is the value of the @c priority_weights option. While it is set,
+    *           the messages sent afterwards are queued by their IOTHUB_MESSAGE_PRIORITY: a
+    *           lane is sent in proportion to its weight, so messages of a larger weight go
+    *           ahead of a backlog of smaller ones without starving them. All weights 0
+    *           queue the messages in the order they are sent again. */
+    typedef struct IOTHUB_CLIENT_PRIORITY_WEIGHTS_TAG
+    {
+        /** @brief	Weight of the @c IOTHUB_MESSAGE_PRIORITY_LOW messages, between 1 and
+        *           IOTHUB_CLIENT_PRIORITY_MAX_WEIGHT. */
+        size_t lowWeight;
+
+        /** @brief	Weight of the @c IOTHUB_MESSAGE_PRIORITY_NORMAL messages, between 1 and
+        *           IOTHUB_CLIENT_PRIORITY_MAX_WEIGHT. */
+        size_t normalWeight;
+
+        /** @brief	Weight of the @c IOTHUB_MESSAGE_PRIORITY_HIGH messages, between 1 and
+        *           IOTHUB_CLIENT_PRIORITY_MAX_WEIGHT. */
+        size_t highWeight;
+    } IOTHUB_CLIENT_PRIORITY_WEIGHTS;
+
     /** @brief	This struct captures IoTHub transport configuration. */
     struct IOTHUBTRANSPORT_CONFIG_TAG
     {
@@ -309,6 +747,82 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief	Asynchronous call to send the message specified by @p eventMessageHandle,
+    *			without making a copy of it.
+    *
+    *			Upon success the SDK owns @p eventMessageHandle and destroys it once the
+    *			confirmation callback has been called. The caller shall not use or destroy
+    *			the handle afterwards. Upon failure the caller keeps the ownership of
+    *			@p eventMessageHandle.
+    *
+    * @param	iotHubClientHandle		   	The handle created by a call to the create function.
+    * @param	eventMessageHandle		   	The handle to an IoT Hub message.
+    * @param	eventConfirmationCallback  	The callback specified by the device for receiving
+    * 										confirmation of the delivery of the IoT Hub message.
+    * 										The user can specify a @c NULL value here to
+    * 										indicate that no callback is required.
+    * @param	userContextCallback			User specified context that will be provided to the
+    * 										callback. This can be @c NULL.
+    *
+    *			@b NOTE: The application behavior is undefined if the user calls
+    *			the ::IoTHubClient_LL_Destroy function from within any callback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync_TakeOwnership, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief	Asynchronous call to send the message specified by @p eventMessageHandle,
+    *			giving the confirmation callback the times the message reached each stage
+    *			of its delivery.
+    *
+    *			The message is traced as if the @c message_trace option was set. It cannot be
+    *			sent while the @c outbox option is set.
+    *
+    * @param	iotHubClientHandle		   	The handle created by a call to the create function.
+    * @param	eventMessageHandle		   	The handle to an IoT Hub message.
+    * @param	eventConfirmationCallback  	The callback specified by the device for receiving
+    * 										confirmation of the delivery of the IoT Hub message
+    * 										and its IOTHUB_CLIENT_MESSAGE_TIMESTAMPS. The user can
+    * 										specify a @c NULL value here to indicate that no
+    * 										callback is required.
+    * @param	userContextCallback			User specified context that will be provided to the
+    * 										callback. This can be @c NULL.
+    *
+    *			@b NOTE: The application behavior is undefined if the user calls
+    *			the ::IoTHubClient_LL_Destroy function from within any callback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync_Ex, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief	Asynchronous call to send the @p eventMessageCount messages in @p eventMessageHandles
+    *			as one batch.
+    *
+    *			The messages are cloned and queued in order, all of them or none. The transport
+    *			sends them as it sends any other queued messages (HTTP packs them in one request
+    *			when "Batching" is enabled).
+    *
+    * @param	iotHubClientHandle		   	The handle created by a call to the create function.
+    * @param	eventMessageHandles		   	The array of handles to IoT Hub messages.
+    * @param	eventMessageCount		   	The number of handles in @p eventMessageHandles.
+    * @param	eventConfirmationCallback  	The callback called once all the messages of the batch
+    * 										have been confirmed. The result is IOTHUB_CLIENT_CONFIRMATION_OK
+    * 										if all the messages were delivered, otherwise the result of
+    * 										the first message that was not. The user can specify a
+    * 										@c NULL value here to indicate that no callback is required.
+    * @param	userContextCallback			User specified context that will be provided to the
+    * 										callback. This can be @c NULL.
+    *
+    *			@b NOTE: The application behavior is undefined if the user calls
+    *			the ::IoTHubClient_LL_Destroy function from within any callback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventBatchAsync, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
     /**
     * @brief	This function returns the current sending status for IoTHubClient.
     *
@@ -340,6 +854,57 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetMessageCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC, messageCallback, void*, userContextCallback);
 
+    /**
+    * @brief	Sets up a callback that receives the body of the messages IoT Hub issues to the
+    * 			device in pieces of at most chunkSize bytes, instead of a whole message.
+    *
+    * @param	iotHubClientHandle		   	The handle created by a call to the create function.
+    * @param	chunkSize		   			The largest piece given to the callback, greater than 0.
+    * @param	messageChunkCallback	   	Called for every piece, in order: chunk and size are the piece,
+    * 										offset is where it starts in the body and isLast is true for
+    * 										the last one (once with size 0 for an empty body). message
+    * 										carries the properties of the message and has an empty body.
+    * 										Returning anything but IOTHUBMESSAGE_ACCEPTED stops the
+    * 										delivery of the message and is its disposition, otherwise the
+    * 										result for the last piece is. @c NULL unsubscribes.
+    * @param	userContextCallback			User specified context that will be provided to the
+    * 										callback. This can be @c NULL.
+    *
+    *			@b NOTE: With MQTT the body is not copied into a message before it is given to the
+    *			callback, the peak memory of a message is the read buffer of the transport. The AMQP
+    *			and HTTP transports build the message first and give its body in pieces.
+    *			Cannot be used together with ::IoTHubClient_LL_SetMessageCallback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetMessageChunkCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, size_t, chunkSize, IOTHUB_CLIENT_MESSAGE_CHUNK_CALLBACK, messageChunkCallback, void*, userContextCallback);
+
+    /**
+    * @brief	Stops receiving messages and method calls until ::IoTHubClient_LL_ResumeReceive,
+    * 			without clearing their callbacks.
+    *
+    * @param	iotHubClientHandle		   	The handle created by a call to the create function.
+    *
+    *			@b NOTE: The transport is unsubscribed: MQTT unsubscribes from the message and
+    *			method topics, AMQP closes the links that grant credit for them and HTTP stops
+    *			polling for messages. IoT Hub keeps the messages for the device meanwhile, the
+    *			method calls fail as for a device that is not listening. The messages already
+    *			on their way are still given to the callback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_PauseReceive, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
+
+    /**
+    * @brief	Receives the messages and method calls again after ::IoTHubClient_LL_PauseReceive.
+    *
+    * @param	iotHubClientHandle		   	The handle created by a call to the create function.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure, in which case the
+    * 			receive stays paused.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_ResumeReceive, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
+
     /**
     * @brief	Sets up the connection status callback to be invoked representing the status of
     * the connection to IOT Hub. This is a blocking call.
@@ -404,6 +969,69 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetLastMessageReceiveTime, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, time_t*, lastMessageReceiveTime);
 
+    /**
+    * @brief	This function returns in the out parameter @p statistics the usage
+    * 			of the pool of send queue entries of the client.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	statistics			Out parameter receiving the pool statistics.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetMessagePoolStatistics, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS*, statistics);
+
+    /**
+    * @brief	Frees what the client and its transport keep for reuse from the peak
+    * 			of a burst: the pooled send queue entries and the buffers of the
+    * 			transport kept at their largest size. They are allocated again
+    * 			when the traffic resumes.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    *
+    *			@b NOTE: the option "idle_trim_time" does the same once the client has
+    *			had nothing to send for that many seconds.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_TrimMemory, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
+
+    /**
+    * @brief	This function returns in the out parameter @p statistics the counters,
+    * 			queue depths and latency histogram of the messages sent while the
+    * 			@c statistics option is enabled.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	statistics			Out parameter receiving the client statistics.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetStatistics, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics);
+
+    /**
+    * @brief	This function returns in the out parameter @p keepAliveInterval the
+    * 			keepalive, in seconds, chosen by a transport that adapts it (see the
+    * 			@c mqtt_keepalive_max option), or 0 if the transport does not adapt it.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	keepAliveInterval	Out parameter receiving the keepalive in seconds.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetKeepAlive, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, int*, keepAliveInterval);
+
+    /**
+    * @brief	This function returns the transport of the client, to be given as
+    * 			the @c transportHandle of the clients created with
+    * 			@c IoTHubClient_LL_CreateWithTransport, such as the leaf devices of
+    * 			an MQTT gateway bridge (see the @c mqtt_gateway_bridge option).
+    * 			The clients sharing the transport are destroyed before this one.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    *
+    * @return	The transport of the client, or NULL if @p iotHubClientHandle is NULL.
+    */
+     MOCKABLE_FUNCTION(, void*, IoTHubClient_LL_GetTransportHandle, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
+
     /**
     * @brief	This function is meant to be called by the user when work
     * 			(sending/receiving) can be done by the IoTHubClient.
@@ -416,6 +1044,81 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, void, IoTHubClient_LL_DoWork, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
 
+    /**
+    * @brief	This function returns how long IoTHubClient_LL_DoWork can be left
+    * 			uncalled: the earliest of the message and reported state timeouts,
+    * 			the MQTT keepalive, connection retries, SAS token refreshes and
+    * 			HTTP polls, so a device can sleep until then instead of calling
+    * 			IoTHubClient_LL_DoWork periodically.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    *
+    *			Bytes arriving from the network are not a deadline: while
+    *			IoTHubClient_LL_IsWaitingForNetwork is @c true the device also wakes
+    *			when the socket of its platform becomes readable. Sending a message,
+    *			setting an option or any other call into the client can bring the
+    *			deadline forward, it is read again after each of them. A transport
+    *			that does not report its deadline (AMQP) makes it 0.
+    *
+    * @return	Milliseconds until IoTHubClient_LL_DoWork has to be called, 0 if it
+    * 			has work to do now, IOTHUB_CLIENT_NO_WORK_DEADLINE if no work is due
+    * 			at a time.
+    */
+     MOCKABLE_FUNCTION(, uint32_t, IoTHubClient_LL_GetNextWorkDeadlineMs, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
+
+    /**
+    * @brief	This function returns whether the transport of the client has a
+    * 			connection open or being opened, whose bytes IoTHubClient_LL_DoWork
+    * 			has to read as they arrive.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    *
+    * @return	@c true while the client waits for the network, @c false otherwise or
+    * 			if @p iotHubClientHandle is NULL.
+    */
+     MOCKABLE_FUNCTION(, bool, IoTHubClient_LL_IsWaitingForNetwork, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
+
+    /**
+    * @brief	This function gives the sockets of the transport of the client, for
+    * 			an application that waits for them in its own event loop (epoll,
+    * 			libuv) instead of calling IoTHubClient_LL_DoWork periodically.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	descriptors			Where the sockets are written.
+    * @param	descriptorCount		On input how many @p descriptors there is room
+    * 								for, on output how many were written.
+    *
+    *			The sockets are asked of the platform socket adapter under the
+    *			transport with the OPTION_XIO_SOCKET_DESCRIPTOR option; with an
+    *			adapter that does not answer it, or while there is no connection,
+    *			none is written. HTTP opens a connection for each request inside
+    *			IoTHubClient_LL_DoWork and never has one. The sockets change with
+    *			the connection: they are read again after every call into the
+    *			client, along with IoTHubClient_LL_GetNextWorkDeadlineMs, which
+    *			stays the time to call IoTHubClient_LL_DoWork without I/O. Clients
+    *			sharing a transport give the same socket.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetPollDescriptors, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_POLL_DESCRIPTOR*, descriptors, size_t*, descriptorCount);
+
+    /**
+    * @brief	This function is called by the event loop of the application when a
+    * 			socket given by IoTHubClient_LL_GetPollDescriptors is readable.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    */
+     MOCKABLE_FUNCTION(, void, IoTHubClient_LL_OnReadable, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
+
+    /**
+    * @brief	This function is called by the event loop of the application when a
+    * 			socket given by IoTHubClient_LL_GetPollDescriptors with
+    * 			IOTHUB_CLIENT_POLL_WRITABLE is writable.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    */
+     MOCKABLE_FUNCTION(, void, IoTHubClient_LL_OnWritable, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
+
     /**
     * @brief	This API sets a runtime option identified by parameter @p optionName
     * 			to a value pointed to by @p value. @p optionName and the data type
@@ -450,15 +1153,189 @@ extern "C"
     *				- @b CURLOPT_VERBOSE - only available for HTTP protocol and only
     *				  when CURL is used. It has the same meaning as CURL's option with the same
     *				  name. @p value is pointer to a long.
+    *				- @b c2d_poll_until_empty - only available for HTTP protocol. When @c true, a
+    *				  GET that returns a message is followed by another GET at the next DoWork
+    *				  instead of waiting @b MinimumPollingTime, so the messages queued by the
+    *				  service are received one after the other. @p value is a pointer to a
+    *				  @c bool. Defaults to @c false.
+    *				- @b c2d_polling_backoff_max - only available for HTTP protocol. When not 0,
+    *				  every GET that finds no message doubles the time until the next one,
+    *				  from @b MinimumPollingTime up to this many seconds, while a GET that
+    *				  returns a message is followed by another at the next DoWork and, like
+    *				  sending a message, brings the time back to @b MinimumPollingTime.
+    *				  @p value is a pointer to an @c unsigned @c int. Defaults to 0.
+    *				- @b c2d_defer_disposition - only available for HTTP protocol. When @c true,
+    *				  the accept, reject and abandon of received messages are queued and sent
+    *				  together at the next DoWork, before its GET, on the same connection and
+    *				  sharing their request headers. @p value is a pointer to a @c bool.
+    *				  Defaults to @c false.
+    *				- @b batching_send_binary_alone - only available for HTTP protocol with
+    *				  @b Batching. When @c true, byte array messages are not base64 encoded in
+    *				  the JSON batch but sent alone, as their raw bytes, while string messages
+    *				  keep being batched. @p value is a pointer to a @c bool. Defaults to @c false.
+    *				- @b batching_max_events, @b batching_max_bytes - only available for HTTP
+    *				  protocol with @b Batching. Largest number of messages and of bytes of a
+    *				  batch. @p value is a pointer to a @c size_t. Default to 0, a batch is
+    *				  then only limited by the 255KB the service accepts.
+    *				- @b batching_linger_time - only available for HTTP protocol with
+    *				  @b Batching. Seconds a batch that has not reached @b batching_max_events
+    *				  or @b batching_max_bytes waits for more messages before it is sent, a
+    *				  full batch being sent at once. @p value is a pointer to an
+    *				  @c unsigned @c int. Defaults to 0, what is queued is sent at each DoWork.
     *              - @b keepalive - available for MQTT protocol.  Integer value that sets the
     *                interval in seconds when pings are sent to the server.
     *              - @b logtrace - available for MQTT protocol.  Boolean value that turns on and
     *                off the diagnostic logging.
+    *              - @b mqtt_max_inflight - available for MQTT protocol.  @c size_t value that sets
+    *                how many telemetry messages may wait for their PUBACK, the others stay queued.
+    *                0 (the default) does not limit them.
+    *              - @b mqtt_telemetry_qos - available for MQTT protocol.  Integer value, 0 or 1 (the
+    *                default), the QoS of the messages whose delivery is @c IOTHUB_MESSAGE_DELIVERY_DEFAULT.
+    *                A message sent at QoS 0 is confirmed once written, it may be lost.
+    *              - @b mqtt_packing - available for MQTT protocol.  @c IOTHUB_MQTT_PACKING_OPTIONS
+    *                value; when its @c maxEnvelopeSize is not 0, the small messages queued together
+    *                with the same properties, no message id and no correlation id are published in
+    *                one envelope of up to that many bytes, waiting up to @c lingerTimeInMs for more
+    *                of them, and are confirmed together on its PUBACK. The envelope carries a
+    *                @c packed-count property and holds each payload after its 4 byte length.
+    *              - @b websocket_deflate - available for MQTT and AMQP over WebSockets.
+    *                @c IOTHUB_WEBSOCKET_DEFLATE_OPTIONS value; when its @c level is not 0 the next
+    *                connections offer permessage-deflate (RFC 7692) with its window bits and context
+    *                takeover, and the frames of the messages of @c minimumSizeInBytes or more are
+    *                compressed once the hub accepts it. It needs the SDK built with @c use_compression.
+    *              - @b mqtt_persistent_session - available for MQTT protocol.  Boolean value, when
+    *                @c true the topics are not subscribed again on a reconnect that finds the
+    *                session kept by the service. Defaults to @c false.
+    *              - @b mqtt_keepalive_max - available for MQTT protocol.  Integer value, when larger
+    *                than @b keepalive the keepalive starts at @b keepalive and, each time a
+    *                connection stays up for two intervals, it is doubled (up to this value) and the
+    *                client reconnects with it. A connection lost before the new interval was kept
+    *                twice brings it back to the last one kept, which is then kept. The value in
+    *                use is returned by IoTHubClient_LL_GetKeepAlive. 0 (the default) disables it.
+    *              - @b event_send_batch_max_count - available for AMQP protocol.  Size_t value,
+    *                when larger than 1 up to this many queued events are packed into one AMQP
+    *                transfer (bounded by the 256KB message size of the service), each event
+    *                still completing its own callback. 0 (the default) sends each event alone.
+    *              - @b event_send_batch_linger_secs - available for AMQP protocol.  Size_t value,
+    *                how long a batch that is not full waits for more events before it is sent.
+    *                Defaults to 0.
+    *              - @b c2d_link_credit - available for AMQP protocol.  Size_t value, the link
+    *                credit of the C2D receiver link, i.e. how many messages the service may
+    *                deliver before waiting for the client to grant more. Raise it for bursty C2D
+    *                traffic. 0 (the default) keeps the uAMQP default.
+    *              - @b sas_token_lifetime - available for AMQP and HTTP protocols.  Size_t value,
+    *                how many seconds the SAS tokens created from the device key are valid. On HTTP,
+    *                when not 0 the token is created once and reused by the requests of the device
+    *                until @b sas_token_refresh_time, instead of computing its HMAC for each request.
+    *                Defaults to 3600 on AMQP and 0 on HTTP.
+    *              - @b sas_token_refresh_time - available for AMQP and HTTP protocols.  Size_t value,
+    *                how many seconds after its creation a SAS token is created again. Defaults to 1800.
+    *              - @b sas_token_refresh_window_secs - available for AMQP protocol.  Size_t value,
+    *                when not 0 each device refreshes its SAS token earlier than @b sas_token_refresh_time
+    *                by an offset within this many seconds, derived from its device id, so devices
+    *                registered together on a transport do not all refresh at once. Defaults to 0.
+    *              - @b keep_underlying_io - available for MQTT and AMQP protocols.  Boolean value,
+    *                when @c true a reconnect reopens the same TLS I/O instead of creating a new one
+    *                and applying its options again, so an I/O that keeps its resolved address or
+    *                TLS session can reuse them. Defaults to @c false.
+    *              - @b happy_eyeballs - available for MQTT and AMQP protocols.  @c HAPPY_EYEBALLS_HANDLE
+    *                value shared by the transports; each new connection is given its connection
+    *                attempt delay and the address family that last won for the hub, for a platform
+    *                socket adapter that races IPv6 and IPv4 (RFC 8305) to try that family first.
+    *              - @b write_coalescing - available for MQTT and AMQP protocols.  Size_t value,
+    *                when not 0 the packets written during one DoWork are held, up to this many
+    *                bytes, and written to the TLS I/O at once at the end of the DoWork, so they
+    *                go out in one TLS record and socket write. Defaults to 0, used from the next
+    *                connection.
+    *              - @b connection_health - available for MQTT protocol.  @c IOTHUB_CONNECTION_HEALTH_OPTIONS
+    *                value; the round trip time of the PUBACKs is measured and, once they are late
+    *                for it, the hub is probed and the client reconnects when the probe is late as
+    *                well. A @c minimumTimeoutInMs of 0, the default, stops the monitoring.
+    *              - @b crypto_provider - @c IOTHUB_CRYPTO_PROVIDER value; the SAS tokens are signed
+    *                by its @c hmacSha256, a hardware engine or a secure element, and the TLS
+    *                adapters that support it use it for their handshake. A @c hmacSha256 of
+    *                NULL, the default, signs in software.
+    *				- @b statistics - when @c true, the messages sent afterwards are counted and
+    *				  their latency recorded, see IoTHubClient_LL_GetStatistics. @p value is a
+    *				  pointer to a @c bool.
+    *				- @b rate_limit - hands the queued messages to the transport no faster than
+    *				  the rates of the @c IOTHUB_CLIENT_RATE_LIMIT pointed to by @p value, lowered
+    *				  while the sends fail. Both rates 0 remove the limit.
+    *				- @b outbox - the messages sent afterwards are kept in a file until they are
+    *				  confirmed and sent again after a failure or a restart, see
+    *				  @c IOTHUB_CLIENT_OUTBOX_CONFIG. It can only be set once. @p value is a
+    *				  pointer to a @c IOTHUB_CLIENT_OUTBOX_CONFIG.
+    *				- @b priority_weights - the messages sent afterwards are sent by their
+    *				  priority, see IoTHubMessage_SetPriority. The messages of the outbox keep
+    *				  their order. @p value is a pointer to a @c IOTHUB_CLIENT_PRIORITY_WEIGHTS.
+    *
+    *				- @b coalesce_reported_state - while enabled, a reported state sent before the
+    *				  previous one went out is merged into it as a JSON merge patch, which is sent
+    *				  once; all their callbacks are called when it is acknowledged. @p value is a
+    *				  pointer to a @c bool.
+    *
+    *				- @b twin_window - bounds the number of reported states sent and not
+    *				  acknowledged yet. @p value is a pointer to a @c IOTHUB_CLIENT_TWIN_WINDOW.
+    *
+    *				- @b twin_cache - gives the application only the desired properties that
+    *				  changed when the twin document is received again after a reconnection. @p
+    *				  value is a pointer to a @c IOTHUB_CLIENT_TWIN_CACHE_CONFIG.
+    *
+    *				- @b compression - compresses the payloads of the messages sent afterwards with
+    *				  gzip, a message is sent as it is if its compressed payload is not smaller.
+    *				  It needs the SDK built with @c use_compression. @p value is a pointer to a
+    *				  @c IOTHUB_CLIENT_COMPRESSION.
+    *
+    *				- @b message_trace - calls a callback every time a message sent afterwards is
+    *				  queued, taken by the transport, written and acknowledged, with the time in
+    *				  milliseconds. @p value is a pointer to a @c IOTHUB_CLIENT_MESSAGE_TRACE.
+    *
+    *				- @b message_pipeline - filters, changes and aggregates the messages sent
+    *				  afterwards before they are queued, with the dedupe, deadband and window
+    *				  stages or application callbacks. @p value is a pointer to a
+    *				  @c IOTHUB_CLIENT_MESSAGE_PIPELINE.
+    *
+    *				- @b c2d_duplicate_filter - accepts the cloud-to-device messages redelivered
+    *				  with the message id of one given to the application recently, without
+    *				  giving them to it again. @p value is a pointer to a
+    *				  @c IOTHUB_CLIENT_DUPLICATE_FILTER.
+    *
+    *				- @b message_chunk_size - sends a message whose payload, once compressed,
+    *				  is larger than the size as messages of at most that size with the
+    *				  application properties @c chunk-id, @c chunk-index and @c chunk-total,
+    *				  confirmed once all of them are. The size shall leave room for the
+    *				  properties under the 256KB limit of IoT Hub. Messages are sent whole
+    *				  while an outbox is set. @p value is a pointer to a @c size_t, 0 by
+    *				  default, which sends them whole.
+    *
+    *				- @b blob_upload_keep_connection - when @c true, the connection to IoT Hub
+    *				  used by IoTHubClient_LL_UploadToBlob is kept open once an upload
+    *				  succeeded and reused by the next upload, sparing it the TLS handshake.
+    *				  @p value is a pointer to a @c bool. Defaults to @c false.
+    *
+    *				- @b blob_upload_concurrency - number of 4MB blocks of a file of 64MB
+    *				  or more that IoTHubClient_LL_UploadToBlob uploads to storage at the same
+    *				  time, each from its own thread and connection. At most that many blocks
+    *				  are copied in memory. @p value is a pointer to a @c size_t. Defaults to 1.
+    *
+    *				- @b blob_upload_block_retries - number of times a block that did not reach
+    *				  storage, or that storage answered with 408, 429 or 5xx, is put again before
+    *				  the upload fails. The blocks already uploaded are not sent again.
+    *				  @p value is a pointer to a @c size_t. Defaults to 0.
+    *
+    *				- @b blob_upload_progress - the callback told the progress of the next file
+    *				  uploads after every block, which can cancel them between two blocks.
+    *				  @p value is a pointer to a @c IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_REPORTING.
+    *
+    *				- @b blob_upload_block_crc64 - every block of 4MB is sent with its CRC64, so
+    *				  storage refuses a block corrupted on the way, which is then put again as
+    *				  a failed block. @p value is a pointer to a @c bool. Defaults to @c false.
     *
     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetOption, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value);
 
+#ifndef DONT_USE_DEVICE_TWIN
     /**
     * @brief	This API specifies a call back to be used when the device receives a desired state update.
     *
@@ -479,6 +1356,23 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetDeviceTwinCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
 
+    /**
+    * @brief	Like ::IoTHubClient_LL_SetDeviceTwinCallback, but the twin documents are given to the
+    * 			callback in pieces of at most chunkSize bytes, for a parser with a bounded buffer.
+    *
+    * @param	iotHubClientHandle		The handle created by a call to the create function.
+    * @param	chunkSize		   		The largest piece given to the callback, greater than 0.
+    * @param	deviceTwinChunkCallback	Called for every piece of a document, in order, with the offset of
+    * 									the piece and isLast true for the last one. The pieces point in the
+    * 									buffer of the transport and are valid during the call only.
+    * 									@c NULL unsubscribes.
+    * @param	userContextCallback		User specified context that will be provided to the
+    * 									callback. This can be @c NULL.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetDeviceTwinChunkCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, size_t, chunkSize, IOTHUB_CLIENT_DEVICE_TWIN_CHUNK_CALLBACK, deviceTwinChunkCallback, void*, userContextCallback);
+
     /**
     * @brief	This API sneds a report of the device's properties and their current values.
     *
@@ -495,7 +1389,9 @@ extern "C"
     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendReportedState, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const unsigned char*, reportedState, size_t, size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK, reportedStateCallback, void*, userContextCallback);
+#endif /*DONT_USE_DEVICE_TWIN*/
 
+#ifndef DONT_USE_DEVICE_METHODS
      /**
      * @brief	This API sets callback for cloud to device method call.
      *
@@ -532,6 +1428,7 @@ extern "C"
      * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_DeviceMethodResponse, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, METHOD_HANDLE, methodId, const unsigned char*, response, size_t, respSize, int, statusCode);
+#endif /*DONT_USE_DEVICE_METHODS*/
 
 #ifndef DONT_USE_UPLOADTOBLOB
     /**
@@ -547,6 +1444,46 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_UploadToBlob, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, const unsigned char*, source, size_t, size);
 
+    /**
+    * @brief	This API uploads to Azure Storage the blocks returned by @p getDataCallback under the blob
+    *           name devicename/@pdestinationFileName, only one block is held in memory at any time.
+    *
+    * @param	iotHubClientHandle	    The handle created by a call to the create function.
+    * @param	destinationFileName     name of the file.
+    * @param	getDataCallback         A callback returning the blocks of the file one after the other, then told the result of the upload.
+    * @param    context                 A user-provided context passed to @p getDataCallback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_UploadMultipleBlocksToBlob, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK, getDataCallback, void*, context);
+
+    /**
+    * @brief	This API uploads to Azure Storage the content of the local file @p filePath under the blob
+    *           name devicename/@pdestinationFileName. The file is read one block at a time, so its size
+    *           is not bounded by the available memory.
+    *
+    * @param	iotHubClientHandle	    The handle created by a call to the create function.
+    * @param	destinationFileName     name of the file.
+    * @param	filePath                path of the local file to upload.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_UploadFileToBlob, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, const char*, filePath);
+
+    /**
+    * @brief	This API uploads to Azure Storage the @p itemCount files of @p items as one batch. The SAS URIs
+    *           of up to 10 files (the number of file uploads IoTHub lets a device have in progress) are
+    *           requested ahead, the files are uploaded, then IoTHub is notified of their completion one
+    *           right after the other, all on a single connection to IoTHub.
+    *
+    * @param	iotHubClientHandle	    The handle created by a call to the create function.
+    * @param	items                   the files to upload, the result of every file is set in its @c result.
+    * @param    itemCount               the number of files in @p items.
+    *
+    * @return	IOTHUB_CLIENT_OK when all the files were uploaded or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_UploadMultipleToBlob, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM*, items, size_t, itemCount);
+
 #endif /*DONT_USE_UPLOADTOBLOB*/
 
 #ifdef __cplusplus
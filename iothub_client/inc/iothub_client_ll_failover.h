@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_ll_failover.h
+*	@brief	 APIs that send the events of a device registered in two IoT hubs
+*		     through whichever of its two clients is connected.
+*
+*	@details IoTHubClient_LL_Failover keeps two IoTHubClient_LL handles of
+*			 the same device, one per hub, connected at once. The events go
+*			 through the active one. When the active one loses its connection
+*			 while the standby one is connected, the standby one becomes the
+*			 active one right away and the events the lost one had not
+*			 confirmed are sent again through it, instead of waiting for a
+*			 connection to be made from scratch.
+*
+*			 An event moved to the other client can still be sent by the lost
+*			 one when it reconnects: the events are delivered at least once
+*			 across the two hubs.
+*/
+
+#ifndef IOTHUB_CLIENT_LL_FAILOVER_H
+#define IOTHUB_CLIENT_LL_FAILOVER_H
+
+#include "iothub_client_ll.h"
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA_TAG* IOTHUB_CLIENT_LL_FAILOVER_HANDLE;
+
+    /**
+    * @brief	Creates a failover client from the clients of a device in two hubs,
+    *           @p primaryHandle being the active one first.
+    *
+    * @param	primaryHandle	The client of the device in its primary hub.
+    * @param	standbyHandle	The client of the device in the other hub.
+    *
+    * @return	A non-NULL handle owning both clients, or NULL if it fails, the clients
+    *           staying with the caller. The connection status callback of the clients
+    *           belongs to the failover client afterwards, see
+    *           ::IoTHubClient_LL_Failover_SetConnectionStatusCallback.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_LL_FAILOVER_HANDLE, IoTHubClient_LL_Failover_Create, IOTHUB_CLIENT_LL_HANDLE, primaryHandle, IOTHUB_CLIENT_LL_HANDLE, standbyHandle);
+
+    /**
+    * @brief	Destroys the failover client and its two clients, the events not
+    *           confirmed yet being confirmed with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.
+    */
+     MOCKABLE_FUNCTION(, void, IoTHubClient_LL_Failover_Destroy, IOTHUB_CLIENT_LL_FAILOVER_HANDLE, failoverHandle);
+
+    /**
+    * @brief	Sends an event through the active client, as ::IoTHubClient_LL_SendEventAsync.
+    *           @p eventConfirmationCallback is called once, with the confirmation of the client
+    *           the event was sent through last.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_Failover_SendEventAsync, IOTHUB_CLIENT_LL_FAILOVER_HANDLE, failoverHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief	Sets the callback called with the connection status of the active client,
+    *           and with the one of the new active client when they are switched.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_Failover_SetConnectionStatusCallback, IOTHUB_CLIENT_LL_FAILOVER_HANDLE, failoverHandle, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK, connectionStatusCallback, void*, userContextCallback);
+
+    /**
+    * @brief	Does the work of both clients, so the standby one stays connected.
+    */
+     MOCKABLE_FUNCTION(, void, IoTHubClient_LL_Failover_DoWork, IOTHUB_CLIENT_LL_FAILOVER_HANDLE, failoverHandle);
+
+    /**
+    * @brief	Returns the active client, for the options, twin and methods of the device.
+    *           It shall not be destroyed.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_LL_HANDLE, IoTHubClient_LL_Failover_GetActiveHandle, IOTHUB_CLIENT_LL_FAILOVER_HANDLE, failoverHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_LL_FAILOVER_H */
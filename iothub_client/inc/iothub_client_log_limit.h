@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_LOG_LIMIT_H
+#define IOTHUB_CLIENT_LOG_LIMIT_H
+
+#include <stdint.h>
+#include "azure_c_shared_utility/xlogging.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+/* Rate limited LogError, for the errors that repeat per message or per DoWork while the connection or the service is
+   down. Every LogErrorLimited keeps its own limit: it logs at most IOTHUB_CLIENT_LOG_LIMIT_BURST messages every
+   IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS, drops the others without evaluating their arguments, and the first message it
+   logs after dropping some is preceded by "N similar messages suppressed".
+   The limits are not synchronized: call sites reached from several threads at once may log or count one message
+   more or less than the limit. */
+
+#ifndef IOTHUB_CLIENT_LOG_LIMIT_BURST
+#define IOTHUB_CLIENT_LOG_LIMIT_BURST           5
+#endif
+
+#ifndef IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS
+#define IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS     10000
+#endif
+
+typedef struct IOTHUB_CLIENT_LOG_LIMIT_TAG
+{
+    uint64_t intervalStart;
+    size_t loggedInInterval;
+    size_t suppressed;
+} IOTHUB_CLIENT_LOG_LIMIT;
+
+/* Used by LogErrorLimited only. */
+extern int iothub_client_log_limit_check(IOTHUB_CLIENT_LOG_LIMIT* limit, size_t* suppressed);
+
+#ifdef NO_LOGGING
+#define LogErrorLimited(...) LogError(__VA_ARGS__)
+#else
+#define LogErrorLimited(...) \
+    do \
+    { \
+        static IOTHUB_CLIENT_LOG_LIMIT log_limit_of_call_site = { 0, 0, 0 }; \
+        size_t log_limit_suppressed; \
+        if (iothub_client_log_limit_check(&log_limit_of_call_site, &log_limit_suppressed) != 0) \
+        { \
+            if (log_limit_suppressed != 0) \
+            { \
+                LogError("%lu similar messages suppressed", (unsigned long)log_limit_suppressed); \
+            } \
+            LogError(__VA_ARGS__); \
+        } \
+    } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_LOG_LIMIT_H */
@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_MEMORY_H
+#define IOTHUB_CLIENT_MEMORY_H
+
+#include "iothub_client_ll.h"
+#include "iothub_client_memory_tag.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+/* The heap of the SDK by subsystem, for sizing how many devices a gateway can hold. Built with use_memory_accounting
+   (cmake -Duse_memory_accounting=ON) the sources of each subsystem tag what they allocate, through gballoc when it is
+   used too:
+   CLIENT       iothub_client, iothub_client_ll, the messages and their queues, the outbox, the twin merge
+   MQTT         the MQTT transport
+   AMQP         the AMQP transport, its connection, devices, messengers and methods
+   HTTP         the HTTP transport
+   BLOB         upload to blob
+   SERIALIZER   the serializer, its models and transactions
+   What the libraries below allocate for them (c-utility STRING_HANDLEs, uAMQP and uMQTT objects, TLS) is not counted,
+   and memory allocated by a subsystem and freed by one of those libraries stays counted. */
+typedef struct IOTHUB_CLIENT_MEMORY_USAGE_TAG
+{
+    size_t currentBytes;
+    size_t peakBytes;
+    size_t currentAllocations;
+    size_t totalAllocations;
+} IOTHUB_CLIENT_MEMORY_USAGE;
+
+/* Fails with IOTHUB_CLIENT_ERROR unless the SDK is built with use_memory_accounting. */
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetMemoryUsage, IOTHUB_CLIENT_MEMORY_SUBSYSTEM, subsystem, IOTHUB_CLIENT_MEMORY_USAGE*, usage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_MEMORY_H */
@@ -0,0 +1,92 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_MEMORY_POOL_H
+#define IOTHUB_CLIENT_MEMORY_POOL_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_ll.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+/* Fixed capacity pools the SDK allocates from, for devices where the heap cannot be used after initialization. Built
+   with use_static_memory_pools (cmake -Duse_static_memory_pools=ON) the allocations tagged with
+   iothub_client_memory_tag.h (everything iothub_client, the transports, upload to blob and the serializer allocate
+   themselves) go to classes of fixed size blocks carved out of memory given to IoTHubClient_MemoryPool_Init:
+
+       IOTHUB_CLIENT_MEMORY_POOL_LIMITS limits = { 8, 1024, 4 };
+       IOTHUB_CLIENT_MEMORY_POOL_CLASS classes[IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES];
+       size_t classCount = IoTHubClient_MemoryPool_GetDefaultClasses(&limits, classes);
+       static unsigned char memory[...]; // IoTHubClient_MemoryPool_GetRequiredSize(classes, classCount)
+       IoTHubClient_MemoryPool_Init(classes, classCount, memory, sizeof(memory));
+       ... IoTHubClient_LL_Create, IoTHubClient_LL_SetOption ...
+       IoTHubClient_MemoryPool_EndInit();
+
+   An allocation takes a block of the smallest class that fits it and has one free, in constant time. Until
+   IoTHubClient_MemoryPool_EndInit an allocation the pools cannot serve comes from the heap; after it, it fails, is
+   logged and counted in the exhaustions of its class, and the API that needed it fails (IoTHubClient_LL_SendEventAsync
+   with IOTHUB_CLIENT_ERROR). Setting the send queue limits of the client to the same maxInFlightMessages makes
+   IoTHubClient_LL_SendEventAsync fail with IOTHUB_CLIENT_QUEUE_FULL before the pools run out.
+   What c-utility, uMQTT and uAMQP allocate (STRING_HANDLE, BUFFER_HANDLE, the properties MAP of a message, TLS) does
+   not go through the pools: on such devices they are built with their own allocator.
+
+   The default classes are a starting point: IoTHubClient_MemoryPool_GetStatistics gives the peak use of every class
+   under the real traffic, to size them. */
+
+#define IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES   8
+
+typedef struct IOTHUB_CLIENT_MEMORY_POOL_LIMITS_TAG
+{
+    /* The most messages queued or in flight at once. */
+    size_t maxInFlightMessages;
+    /* The largest payload sent. */
+    size_t maxMessageSize;
+    /* The most application properties of a message. */
+    size_t maxProperties;
+} IOTHUB_CLIENT_MEMORY_POOL_LIMITS;
+
+/* The classes are given by ascending blockSize. */
+typedef struct IOTHUB_CLIENT_MEMORY_POOL_CLASS_TAG
+{
+    size_t blockSize;
+    size_t blockCount;
+} IOTHUB_CLIENT_MEMORY_POOL_CLASS;
+
+typedef struct IOTHUB_CLIENT_MEMORY_POOL_STATISTICS_TAG
+{
+    size_t blockSize;
+    size_t blockCount;
+    size_t blocksInUse;
+    size_t peakBlocksInUse;
+    /* Allocations failed after IoTHubClient_MemoryPool_EndInit because no class from this one up had a free block. */
+    size_t exhaustions;
+} IOTHUB_CLIENT_MEMORY_POOL_STATISTICS;
+
+/* Fills classes (IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES of them) for limits and returns how many it filled, 0 if limits is invalid. */
+MOCKABLE_FUNCTION(, size_t, IoTHubClient_MemoryPool_GetDefaultClasses, const IOTHUB_CLIENT_MEMORY_POOL_LIMITS*, limits, IOTHUB_CLIENT_MEMORY_POOL_CLASS*, classes);
+/* The size of the memory IoTHubClient_MemoryPool_Init needs for classes, 0 if they are invalid. */
+MOCKABLE_FUNCTION(, size_t, IoTHubClient_MemoryPool_GetRequiredSize, const IOTHUB_CLIENT_MEMORY_POOL_CLASS*, classes, size_t, classCount);
+/* Before anything of the SDK is created. memory has to stay valid until IoTHubClient_MemoryPool_Deinit. */
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_MemoryPool_Init, const IOTHUB_CLIENT_MEMORY_POOL_CLASS*, classes, size_t, classCount, void*, memory, size_t, size);
+MOCKABLE_FUNCTION(, void, IoTHubClient_MemoryPool_EndInit);
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_MemoryPool_GetStatistics, size_t, classIndex, IOTHUB_CLIENT_MEMORY_POOL_STATISTICS*, statistics);
+/* After everything of the SDK is destroyed. */
+MOCKABLE_FUNCTION(, void, IoTHubClient_MemoryPool_Deinit);
+
+/* Used by iothub_client_memory.c only. */
+extern void* iothub_client_memory_pool_malloc(size_t size);
+extern void* iothub_client_memory_pool_calloc(size_t nmemb, size_t size);
+extern void* iothub_client_memory_pool_realloc(void* ptr, size_t size);
+extern void iothub_client_memory_pool_free(void* ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_MEMORY_POOL_H */
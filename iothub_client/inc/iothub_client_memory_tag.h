@@ -0,0 +1,60 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* Tags the allocations of a source file with the subsystem they are accounted to, see iothub_client_memory.h.
+   Like gballoc.h, it is included after the system headers, by a file that defines the subsystem first:
+
+       #define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT
+       #include "iothub_client_memory_tag.h"
+
+   Unless the SDK is built with use_memory_accounting or use_static_memory_pools (iothub_client_memory_pool.h), malloc,
+   calloc, realloc and free are left alone. */
+
+#ifndef IOTHUB_CLIENT_MEMORY_TAG_H
+#define IOTHUB_CLIENT_MEMORY_TAG_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_VALUES       \
+    IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT,          \
+    IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT,            \
+    IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP,            \
+    IOTHUB_CLIENT_MEMORY_SUBSYSTEM_HTTP,            \
+    IOTHUB_CLIENT_MEMORY_SUBSYSTEM_BLOB,            \
+    IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+
+DEFINE_ENUM(IOTHUB_CLIENT_MEMORY_SUBSYSTEM, IOTHUB_CLIENT_MEMORY_SUBSYSTEM_VALUES);
+
+#if defined(USE_MEMORY_ACCOUNTING) || defined(USE_STATIC_MEMORY_POOLS)
+extern void* iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, size_t size);
+extern void* iothub_client_memory_calloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, size_t nmemb, size_t size);
+extern void* iothub_client_memory_realloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, void* ptr, size_t size);
+extern void iothub_client_memory_free(void* ptr);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_MEMORY_TAG_H */
+
+#if (defined(USE_MEMORY_ACCOUNTING) || defined(USE_STATIC_MEMORY_POOLS)) && defined(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS)
+/* function-like, so "free" passed as a function pointer stays the free of gballoc or of the C runtime;
+   iothub_client_memory_free does not need to know how a pointer was allocated */
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+#define malloc(size) iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS, size)
+#define calloc(nmemb, size) iothub_client_memory_calloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS, nmemb, size)
+#define realloc(ptr, size) iothub_client_memory_realloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS, ptr, size)
+#define free(ptr) iothub_client_memory_free(ptr)
+#endif
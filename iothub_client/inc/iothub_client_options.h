@@ -4,6 +4,10 @@
 #ifndef IOTHUB_CLIENT_OPTIONS_H
 #define IOTHUB_CLIENT_OPTIONS_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -16,10 +20,128 @@ extern "C"
         const char* password;
     } IOTHUB_PROXY_OPTIONS;
 
+#define IOTHUB_MQTT_SESSION_STATE_VERSION 1
+#define IOTHUB_MQTT_SESSION_STATE_SAS_TOKEN_SIZE 384
+
+    /* What a sleepy device keeps of its MQTT session between two wakes. While "mqtt_sleepy_device" is set the
+       transport keeps it up to date; the application saves it (retained RAM, flash) before powering down and gives it
+       back on the next wake. A zeroed state, as on the first boot, is a state without a session. */
+    typedef struct IOTHUB_MQTT_SESSION_STATE_TAG
+    {
+        unsigned int version;
+        unsigned int subscribedTopics;
+        unsigned short packetId;
+        size_t sasTokenExpiry; /*seconds since the epoch, 0 when sasToken is not kept*/
+        char sasToken[IOTHUB_MQTT_SESSION_STATE_SAS_TOKEN_SIZE];
+    } IOTHUB_MQTT_SESSION_STATE;
+
+    typedef void(*IOTHUB_MQTT_POWER_DOWN_CALLBACK)(void* context);
+
+    typedef struct IOTHUB_MQTT_SLEEPY_DEVICE_OPTIONS_TAG
+    {
+        IOTHUB_MQTT_SESSION_STATE* sessionState; /*owned by the application, used for as long as the client lives*/
+        IOTHUB_MQTT_POWER_DOWN_CALLBACK powerDownCallback; /*called each time the client has nothing left to send or wait for*/
+        void* powerDownContext;
+    } IOTHUB_MQTT_SLEEPY_DEVICE_OPTIONS;
+
+    /* The small telemetry messages queued together with the same properties are published in one envelope while
+       "mqtt_packing" is set: each message is its length, 4 bytes in network order, followed by its payload. The
+       envelope is published on the topic of its first message with a "packed-count" property, its number of messages. */
+    typedef struct IOTHUB_MQTT_PACKING_OPTIONS_TAG
+    {
+        size_t maxEnvelopeSize; /*the most bytes of an envelope, 0 to publish the messages alone*/
+        unsigned int lingerTimeInMs; /*how long the messages of an envelope that is not full wait for more of them*/
+    } IOTHUB_MQTT_PACKING_OPTIONS;
+
+    /* While "websocket_deflate" has a level, the WebSocket transports offer permessage-deflate to the hub in the
+       upgrade of their next connections; once the hub accepts it the frames are compressed in both directions. */
+    typedef struct IOTHUB_WEBSOCKET_DEFLATE_OPTIONS_TAG
+    {
+        int level; /*zlib level from 1 (fastest) to 9 (smallest), 0 to not offer permessage-deflate*/
+        int clientMaxWindowBits; /*from 9 to 15, the device keeps 2^clientMaxWindowBits bytes of history to compress*/
+        int serverMaxWindowBits; /*from 9 to 15, the history the hub is asked to compress with, 0 to let it choose*/
+        bool noContextTakeover; /*every message is compressed on its own in both directions: less memory, less gain*/
+        size_t minimumSizeInBytes; /*the messages smaller than this are sent as they are*/
+    } IOTHUB_WEBSOCKET_DEFLATE_OPTIONS;
+
+    /* While "connection_health" is set the MQTT transport measures how long the hub takes to acknowledge its telemetry.
+       Once the acknowledgements are late for that round trip time it probes the connection, and reconnects when the
+       probe is not answered either, long before the keepalive notices a link that died silently. */
+    typedef struct IOTHUB_CONNECTION_HEALTH_OPTIONS_TAG
+    {
+        unsigned int minimumTimeoutInMs; /*the least an acknowledgement or a probe is waited for, 0 to stop monitoring*/
+        unsigned int maximumTimeoutInMs; /*the most, also waited for until a round trip time is measured*/
+    } IOTHUB_CONNECTION_HEALTH_OPTIONS;
+
+    /* While "crypto_provider" has an HMAC-SHA256, the client signs its SAS tokens with it instead of the software
+       HMAC-SHA256 of the SDK, so a hardware SHA engine or a secure element does the work. The transports offer it to the
+       TLS adapter of their connection with OPTION_XIO_CRYPTO_PROVIDER. */
+    typedef int(*IOTHUB_CRYPTO_HMAC_SHA256)(void* context, const unsigned char* key, size_t keyLength, const unsigned char* data, size_t dataLength, unsigned char* digest);
+
+    typedef struct IOTHUB_CRYPTO_PROVIDER_TAG
+    {
+        IOTHUB_CRYPTO_HMAC_SHA256 hmacSha256; /*writes the 32 bytes of the digest and returns 0, NULL to sign in software*/
+        void* context; /*owned by the application, used for as long as the client lives*/
+    } IOTHUB_CRYPTO_PROVIDER;
+
+    /* What OPTION_THREAD_ATTRIBUTES asks of the threads IoTHubClient starts (its worker, its callback dispatcher and the
+       thread of an upload), applied by each of them as it starts where the platform allows it: the affinity and the nice
+       value on Linux, the affinity and the priority on Windows. The name is set where the platform names threads, with
+       a suffix for the role of the thread, within the 15 characters Linux allows. A 0 or NULL field leaves that attribute
+       as the platform made it. */
+    typedef struct IOTHUB_CLIENT_THREAD_ATTRIBUTES_TAG
+    {
+        uint64_t affinity_mask; /*bit n allows CPU n*/
+        bool set_priority;
+        int priority; /*the nice value on Linux, a THREAD_PRIORITY_* value on Windows*/
+        const char* name; /*copied by IoTHubClient_SetOption*/
+    } IOTHUB_CLIENT_THREAD_ATTRIBUTES;
+
+    /* The address families of OPTION_XIO_PREFERRED_ADDRESS_FAMILY and OPTION_XIO_CONNECTED_ADDRESS_FAMILY. */
+    typedef enum IOTHUB_CLIENT_ADDRESS_FAMILY_TAG
+    {
+        IOTHUB_CLIENT_ADDRESS_FAMILY_ANY,
+        IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4,
+        IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6
+    } IOTHUB_CLIENT_ADDRESS_FAMILY;
+
     static const char* OPTION_LOG_TRACE = "logtrace";
     static const char* OPTION_X509_CERT = "x509certificate";
     static const char* OPTION_X509_PRIVATE_KEY = "x509privatekey";
     static const char* OPTION_KEEP_ALIVE = "keepalive";
+    static const char* OPTION_MQTT_KEEP_ALIVE_MAX = "mqtt_keepalive_max";
+    static const char* OPTION_MQTT_MAX_INFLIGHT = "mqtt_max_inflight";
+    static const char* OPTION_MQTT_TELEMETRY_QOS = "mqtt_telemetry_qos";
+    static const char* OPTION_MQTT_PERSISTENT_SESSION = "mqtt_persistent_session";
+    static const char* OPTION_MQTT_GATEWAY_BRIDGE = "mqtt_gateway_bridge";
+    static const char* OPTION_MQTT_SLEEPY_DEVICE = "mqtt_sleepy_device";
+    static const char* OPTION_MQTT_PACKING = "mqtt_packing";
+    static const char* OPTION_KEEP_UNDERLYING_IO = "keep_underlying_io";
+    static const char* OPTION_WEBSOCKET_DEFLATE = "websocket_deflate";
+    /* Not an option of the client: the transports give it to xio_setoption of their connection, with an intptr_t*,
+       for the platform socket adapter to write its socket there (and fail while it has none). */
+    static const char* OPTION_XIO_SOCKET_DESCRIPTOR = "xio_socket_descriptor";
+    /* Not options of the client either: while a happy eyeballs handle is set, the transports give the platform socket
+       adapter of every new connection the delay between its IPv6 and IPv4 attempts (a const unsigned int*, RFC 8305)
+       and the family that last won for the host (a const IOTHUB_CLIENT_ADDRESS_FAMILY*) to try first. Once connected
+       they ask it, with an IOTHUB_CLIENT_ADDRESS_FAMILY*, the family its socket connected with. */
+    static const char* OPTION_XIO_CONNECTION_ATTEMPT_DELAY = "xio_connection_attempt_delay";
+    static const char* OPTION_XIO_PREFERRED_ADDRESS_FAMILY = "xio_preferred_address_family";
+    static const char* OPTION_XIO_CONNECTED_ADDRESS_FAMILY = "xio_connected_address_family";
+    /* Not an option of the client: while the writes are coalesced the transports ask the platform socket adapter, with a
+       const bool*, to disable Nagle's algorithm (TCP_NODELAY) as the coalesced writes are already full. */
+    static const char* OPTION_XIO_TCP_NODELAY = "xio_tcp_nodelay";
+    /* Not an option of the client: the transports give the TLS adapter the const IOTHUB_CRYPTO_PROVIDER* of
+       OPTION_CRYPTO_PROVIDER for its handshake. An adapter that does not know the option keeps its software crypto. */
+    static const char* OPTION_XIO_CRYPTO_PROVIDER = "xio_crypto_provider";
+    static const char* OPTION_RETRY_COORDINATOR = "retry_coordinator";
+    static const char* OPTION_RETRY_INITIAL_WAIT_TIME_IN_MS = "retry_initial_wait_time_in_ms";
+    static const char* OPTION_CONNECTION_RAMP = "connection_ramp";
+    static const char* OPTION_HAPPY_EYEBALLS = "happy_eyeballs";
+    static const char* OPTION_WRITE_COALESCING = "write_coalescing";
+    static const char* OPTION_CONNECTION_HEALTH = "connection_health";
+    static const char* OPTION_CRYPTO_PROVIDER = "crypto_provider";
+    static const char* OPTION_DEVICE_QUANTUM = "device_quantum";
 
     static const char* OPTION_PROXY_HOST = "proxy_address";
     static const char* OPTION_PROXY_USERNAME = "proxy_username";
@@ -31,9 +153,46 @@ extern "C"
 
     static const char* OPTION_MIN_POLLING_TIME = "MinimumPollingTime";
     static const char* OPTION_BATCHING = "Batching";
+    static const char* OPTION_BATCHING_SEND_BINARY_ALONE = "batching_send_binary_alone";
+    static const char* OPTION_BATCHING_MAX_EVENTS = "batching_max_events";
+    static const char* OPTION_BATCHING_MAX_BYTES = "batching_max_bytes";
+    static const char* OPTION_BATCHING_LINGER_TIME = "batching_linger_time";
+    static const char* OPTION_C2D_POLL_UNTIL_EMPTY = "c2d_poll_until_empty";
+    static const char* OPTION_C2D_POLLING_BACKOFF_MAX = "c2d_polling_backoff_max";
+    static const char* OPTION_C2D_DEFER_DISPOSITION = "c2d_defer_disposition";
 
     static const char* OPTION_PRODUCT_INFO = "product_info";
 
+    static const char* OPTION_BLOB_UPLOAD_KEEP_CONNECTION = "blob_upload_keep_connection";
+    static const char* OPTION_BLOB_UPLOAD_CONCURRENCY = "blob_upload_concurrency";
+    static const char* OPTION_BLOB_UPLOAD_BLOCK_RETRIES = "blob_upload_block_retries";
+    static const char* OPTION_BLOB_UPLOAD_PROGRESS = "blob_upload_progress";
+    static const char* OPTION_BLOB_UPLOAD_BLOCK_CRC64 = "blob_upload_block_crc64";
+    static const char* OPTION_BLOB_UPLOAD_WORKERS = "blob_upload_workers";
+
+    static const char* OPTION_EVENT_DRIVEN_WORKER = "event_driven_worker";
+    static const char* OPTION_WORKER_MAX_IDLE_TIME = "worker_max_idle_time";
+    static const char* OPTION_CALLBACK_DISPATCH_QUEUE_SIZE = "callback_dispatch_queue_size";
+    static const char* OPTION_INBOUND_CALLBACK_LIMIT = "inbound_callback_limit";
+    static const char* OPTION_THREAD_ATTRIBUTES = "thread_attributes";
+
+    static const char* OPTION_MESSAGE_POOL_SIZE = "message_pool_size";
+    static const char* OPTION_IDLE_TRIM_TIME = "idle_trim_time";
+    static const char* OPTION_SEND_QUEUE_LIMITS = "send_queue_limits";
+    static const char* OPTION_RATE_LIMIT = "rate_limit";
+    static const char* OPTION_SEND_INGRESS_QUEUE = "send_ingress_queue";
+    static const char* OPTION_STATISTICS = "statistics";
+    static const char* OPTION_OUTBOX = "outbox";
+    static const char* OPTION_PRIORITY_WEIGHTS = "priority_weights";
+    static const char* OPTION_COALESCE_REPORTED_STATE = "coalesce_reported_state";
+    static const char* OPTION_TWIN_WINDOW = "twin_window";
+    static const char* OPTION_TWIN_CACHE = "twin_cache";
+    static const char* OPTION_COMPRESSION = "compression";
+    static const char* OPTION_MESSAGE_TRACE = "message_trace";
+    static const char* OPTION_MESSAGE_PIPELINE = "message_pipeline";
+    static const char* OPTION_C2D_DUPLICATE_FILTER = "c2d_duplicate_filter";
+    static const char* OPTION_MESSAGE_CHUNK_SIZE = "message_chunk_size";
+
 #ifdef __cplusplus
 }
 #endif
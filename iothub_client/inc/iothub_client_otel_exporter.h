@@ -0,0 +1,99 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_OTEL_EXPORTER_H
+#define IOTHUB_CLIENT_OTEL_EXPORTER_H
+
+#include <stdint.h>
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client.h"
+#include "iothub_client_ll.h"
+#include "iothub_client_trace.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+/* Exports the statistics of the clients (IoTHubClient_GetStatistics, the statistics option has to be set on them) as
+   OpenTelemetry metrics, and a span per message from its IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED trace event to its
+   IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, in the OTLP/JSON encoding.
+   Every intervalMs IoTHubClient_OTelExporter_DoWork hands an export of the metrics and one or more exports of the
+   ended spans to the sink, or posts them to https://otlpHost/v1/metrics and https://otlpHost/v1/traces.
+   Everything is allocated at create: a trace event takes a lock and walks the maxSpans slots, an export formats in
+   place. The spans carry the message id as messaging.message.id, which is what ties them to the cloud-side telemetry.
+
+   metric                                  kind                      attributes
+   iothub.client.messages.enqueued         sum, {message}            iothub.transport, iothub.device.id
+   iothub.client.messages.confirmed        sum, {message}            idem
+   iothub.client.messages.timed_out        sum, {message}            idem
+   iothub.client.messages.failed           sum, {message}            idem
+   iothub.client.bytes.sent                sum, By                   idem
+   iothub.client.reconnects                sum, {reconnect}          idem
+   iothub.client.disconnected.duration     sum, ms                   idem
+   iothub.client.queue.depth               gauge, {message}          idem, iothub.queue (waiting_to_send, in_progress)
+   iothub.client.send.latency              histogram, ms             idem
+   iothub.client.spans.dropped             sum, {span}               (none) */
+
+#define IOTHUB_CLIENT_OTEL_EXPORT_KIND_VALUES   \
+    IOTHUB_CLIENT_OTEL_EXPORT_METRICS,          \
+    IOTHUB_CLIENT_OTEL_EXPORT_SPANS
+
+DEFINE_ENUM(IOTHUB_CLIENT_OTEL_EXPORT_KIND, IOTHUB_CLIENT_OTEL_EXPORT_KIND_VALUES);
+
+#define IOTHUB_CLIENT_OTEL_DEFAULT_INTERVAL_MS      60000
+#define IOTHUB_CLIENT_OTEL_DEFAULT_EXPORT_SIZE      16384
+
+/* Spans whose message is not acknowledged after this long (it timed out, or its client was destroyed) are dropped. */
+#ifndef IOTHUB_CLIENT_OTEL_SPAN_MAX_AGE_MS
+#define IOTHUB_CLIENT_OTEL_SPAN_MAX_AGE_MS          600000
+#endif
+
+/* json is not 0 terminated, it is only valid during the call. */
+typedef void(*IOTHUB_CLIENT_OTEL_SINK)(void* context, IOTHUB_CLIENT_OTEL_EXPORT_KIND kind, const char* json, size_t length);
+
+typedef struct IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG_TAG
+{
+    /* service.name of the resource, required. */
+    const char* serviceName;
+    /* service.instance.id of the resource, NULL for none. */
+    const char* serviceInstanceId;
+    /* The aggregation interval, 0 for IOTHUB_CLIENT_OTEL_DEFAULT_INTERVAL_MS. */
+    unsigned int intervalMs;
+    /* The most spans open or ended and not exported yet, 0 exports no spans. */
+    size_t maxSpans;
+    /* The size of the buffer an export is formatted in, 0 for IOTHUB_CLIENT_OTEL_DEFAULT_EXPORT_SIZE. */
+    size_t maxExportSize;
+    /* Either a sink, */
+    IOTHUB_CLIENT_OTEL_SINK sink;
+    void* sinkContext;
+    /* or the host of an OTLP/HTTP collector listening on HTTPS, with the value of the Authorization header, if any. */
+    const char* otlpHost;
+    const char* otlpAuthorization;
+} IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG;
+
+typedef struct IOTHUB_CLIENT_OTEL_EXPORTER_TAG* IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE;
+
+/* With maxSpans set, create installs IoTHubClient_OTelExporter_OnTraceEvent with IoTHubClient_Trace_SetCallback, and
+   destroy removes it; an application with a trace callback of its own forwards the events to it instead. */
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE, IoTHubClient_OTelExporter_Create, const IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG*, config);
+MOCKABLE_FUNCTION(, void, IoTHubClient_OTelExporter_Destroy, IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE, exporter);
+/* The clients have to outlive the exporter. deviceId can be NULL. */
+MOCKABLE_FUNCTION(, int, IoTHubClient_OTelExporter_AddClient, IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE, exporter, IOTHUB_CLIENT_HANDLE, client, const char*, transportName, const char*, deviceId);
+/* IoTHubClient_OTelExporter_DoWork then has to be called on the thread calling IoTHubClient_LL_DoWork on client. */
+MOCKABLE_FUNCTION(, int, IoTHubClient_OTelExporter_AddClientLL, IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE, exporter, IOTHUB_CLIENT_LL_HANDLE, client, const char*, transportName, const char*, deviceId);
+/* Exports when intervalMs have passed since the last export. */
+MOCKABLE_FUNCTION(, void, IoTHubClient_OTelExporter_DoWork, IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE, exporter);
+/* Exports now. */
+MOCKABLE_FUNCTION(, int, IoTHubClient_OTelExporter_Export, IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE, exporter);
+MOCKABLE_FUNCTION(, void, IoTHubClient_OTelExporter_OnTraceEvent, void*, context, IOTHUB_CLIENT_TRACE_EVENT, trace_event, uint64_t, timestamp_ns, const void*, subject, uint64_t, value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_OTEL_EXPORTER_H */
@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_OUTBOX_H
+#define IOTHUB_CLIENT_OUTBOX_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* An outbox is a FIFO of messages kept in a ring file of a fixed maximum size, so that messages survive a restart
+   of the device. The messages are read in order without being removed, and removed in order once delivered.
+   The position of the records is written to the file every sync_interval appends or releases, after the records
+   themselves have been synced: a power failure loses at most the last sync_interval appends and may read again
+   the last sync_interval released messages.
+   An outbox is not thread safe. */
+typedef struct OUTBOX_TAG* OUTBOX_HANDLE;
+
+MOCKABLE_FUNCTION(, OUTBOX_HANDLE, outbox_create, const char*, file_name, size_t, max_file_size, size_t, sync_interval);
+MOCKABLE_FUNCTION(, void, outbox_destroy, OUTBOX_HANDLE, outbox);
+MOCKABLE_FUNCTION(, int, outbox_append, OUTBOX_HANDLE, outbox, IOTHUB_MESSAGE_HANDLE, message);
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, outbox_read_next, OUTBOX_HANDLE, outbox);
+MOCKABLE_FUNCTION(, int, outbox_release_oldest, OUTBOX_HANDLE, outbox);
+MOCKABLE_FUNCTION(, void, outbox_rewind, OUTBOX_HANDLE, outbox);
+MOCKABLE_FUNCTION(, size_t, outbox_get_count, OUTBOX_HANDLE, outbox);
+MOCKABLE_FUNCTION(, size_t, outbox_get_unread_count, OUTBOX_HANDLE, outbox);
+MOCKABLE_FUNCTION(, int, outbox_sync, OUTBOX_HANDLE, outbox);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_OUTBOX_H */
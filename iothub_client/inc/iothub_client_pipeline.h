@@ -0,0 +1,32 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_PIPELINE_H
+#define IOTHUB_CLIENT_PIPELINE_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_client_ll.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* A pipeline runs the stages of an IOTHUB_CLIENT_MESSAGE_PIPELINE on every message before it is queued. The stages work
+   on the message itself: they read its payload and properties in place and the window stage writes its aggregates in
+   the properties of the message it keeps, so going through the pipeline copies nothing.
+   A pipeline is not thread safe. */
+typedef struct MESSAGE_PIPELINE_TAG* MESSAGE_PIPELINE_HANDLE;
+
+MOCKABLE_FUNCTION(, MESSAGE_PIPELINE_HANDLE, message_pipeline_create, const IOTHUB_CLIENT_MESSAGE_PIPELINE*, config);
+MOCKABLE_FUNCTION(, void, message_pipeline_destroy, MESSAGE_PIPELINE_HANDLE, pipeline);
+
+/* Returns IOTHUB_CLIENT_MESSAGE_STAGE_DROP as soon as a stage drops the message, the later stages not seeing it. */
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_MESSAGE_STAGE_RESULT, message_pipeline_process, MESSAGE_PIPELINE_HANDLE, pipeline, IOTHUB_MESSAGE_HANDLE, message, tickcounter_ms_t, nowMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_PIPELINE_H */
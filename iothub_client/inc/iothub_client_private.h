@@ -37,9 +37,13 @@ typedef bool(*IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX)(MESSAGE_CALLBACK_INFO* me
 MOCKABLE_FUNCTION(, void, IoTHubClient_LL_SendComplete, IOTHUB_CLIENT_LL_HANDLE, handle, PDLIST_ENTRY, completed, IOTHUB_CLIENT_CONFIRMATION_RESULT, result);
 MOCKABLE_FUNCTION(, void, IoTHubClient_LL_ReportedStateComplete, IOTHUB_CLIENT_LL_HANDLE, handle, uint32_t, item_id, int, status_code);
 MOCKABLE_FUNCTION(, bool, IoTHubClient_LL_MessageCallback, IOTHUB_CLIENT_LL_HANDLE, handle, MESSAGE_CALLBACK_INFO*, message_data);
+/*0 when the messages are not received in chunks, then the transport gives the body with IoTHubClient_LL_MessageChunksCallback instead of copying it in messageHandle*/
+MOCKABLE_FUNCTION(, size_t, IoTHubClient_LL_GetMessageChunkSize, IOTHUB_CLIENT_LL_HANDLE, handle);
+MOCKABLE_FUNCTION(, bool, IoTHubClient_LL_MessageChunksCallback, IOTHUB_CLIENT_LL_HANDLE, handle, MESSAGE_CALLBACK_INFO*, message_data, const unsigned char*, payload, size_t, size);
 MOCKABLE_FUNCTION(, void, IoTHubClient_LL_RetrievePropertyComplete, IOTHUB_CLIENT_LL_HANDLE, handle, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, payLoad, size_t, size);
 MOCKABLE_FUNCTION(, int, IoTHubClient_LL_DeviceMethodComplete, IOTHUB_CLIENT_LL_HANDLE, handle, const char*, method_name, const unsigned char*, payLoad, size_t, size, METHOD_HANDLE, response_id);
 MOCKABLE_FUNCTION(, void, IoTHubClient_LL_ConnectionStatusCallBack, IOTHUB_CLIENT_LL_HANDLE, handle, IOTHUB_CLIENT_CONNECTION_STATUS, status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON, reason);
+MOCKABLE_FUNCTION(, void, IoTHubClient_LL_KeepAliveChanged, IOTHUB_CLIENT_LL_HANDLE, handle, int, keepAliveInterval);
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetMessageCallback_Ex, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX, messageCallback, void*, userContextCallback);
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendMessageDisposition, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, MESSAGE_CALLBACK_INFO*, messageData, IOTHUBMESSAGE_DISPOSITION_RESULT, disposition);
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetOption, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, optionName, void**, value);
@@ -51,8 +55,30 @@ typedef struct IOTHUB_MESSAGE_LIST_TAG
     void* context; 
     DLIST_ENTRY entry;
     tickcounter_ms_t ms_timesOutAfter; /* a value of "0" means "no timeout", if the IOTHUBCLIENT_LL's handle tickcounter > msTimesOutAfer then the message shall timeout*/
+    /*when the send queue limits or the statistics are in use, callback/context are replaced by IoTHubClient_LL so it sees the message complete, the user's are kept here*/
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK userCallback;
+    void* userContext;
+    IOTHUB_CLIENT_LL_HANDLE owner;
+    size_t byteCount;
+    bool countedInSendQueue;
+    bool countedInStatistics;
+    tickcounter_ms_t enqueuedAt; /*only set when countedInStatistics*/
+    uint64_t outboxSequence; /*position of the message in the outbox, only set for the messages read from it*/
+    uint64_t priorityTag; /*weighted fair tag ordering waitingToSend, 0 for the messages queued while the priority weights are not set*/
+    bool traced; /*the transports call IoTHubClient_LL_TraceMessage for the message, owner is set*/
+    IOTHUB_CLIENT_MESSAGE_TIMESTAMPS timestamps; /*only set when traced*/
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX userCallbackEx; /*called instead of userCallback when not NULL*/
 }IOTHUB_MESSAGE_LIST;
 
+MOCKABLE_FUNCTION(, void, IoTHubClient_LL_TraceMessage, IOTHUB_MESSAGE_LIST*, message, IOTHUB_MESSAGE_TRACE_STAGE, stage);
+
+typedef struct IOTHUB_REPORTED_STATE_CALLBACK_TAG
+{
+    IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback;
+    void* context;
+    struct IOTHUB_REPORTED_STATE_CALLBACK_TAG* next;
+} IOTHUB_REPORTED_STATE_CALLBACK;
+
 typedef struct IOTHUB_DEVICE_TWIN_TAG
 {
     uint32_t item_id;
@@ -60,6 +86,8 @@ typedef struct IOTHUB_DEVICE_TWIN_TAG
     IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback;
     CONSTBUFFER_HANDLE report_data_handle;
     void* context;
+    IOTHUB_REPORTED_STATE_CALLBACK* coalesced_callbacks; /*callbacks of the reported states merged into report_data_handle after the first one, in order*/
+    IOTHUB_REPORTED_STATE_CALLBACK* last_coalesced_callback;
     DLIST_ENTRY entry;
 } IOTHUB_DEVICE_TWIN;
 
@@ -16,8 +16,11 @@ extern "C"
 #endif
 
 static const char* RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS = "initial_wait_time_in_secs";
+static const char* RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS = "initial_wait_time_in_ms";
+static const char* RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS = "max_wait_time_in_ms";
 static const char* RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT = "max_jitter_percent";
 static const char* RETRY_CONTROL_OPTION_SAVED_OPTIONS = "retry_control_saved_options";
+static const char* RETRY_CONTROL_OPTION_RETRY_COORDINATOR = "retry_coordinator";
 
 typedef enum RETRY_ACTION_TAG
 {
@@ -29,13 +32,28 @@ typedef enum RETRY_ACTION_TAG
 struct RETRY_CONTROL_INSTANCE_TAG;
 typedef struct RETRY_CONTROL_INSTANCE_TAG* RETRY_CONTROL_HANDLE;
 
+/* A retry coordinator is shared by the retry controls of many connections (set with the option "retry_coordinator",
+   the value being the RETRY_COORDINATOR_HANDLE itself) so they do not all retry at once when the hub throttles or goes
+   down. Every retry takes a token from a budget of retry_budget tokens refilled by retries_per_sec each second; after
+   failure_threshold failed attempts without a success in between the circuit opens and no retry goes through for
+   open_time_in_secs, after which a single probe retry is let through. A successful connection (retry_control_reset)
+   closes the circuit. The coordinator must outlive the retry controls it is set on. */
+struct RETRY_COORDINATOR_INSTANCE_TAG;
+typedef struct RETRY_COORDINATOR_INSTANCE_TAG* RETRY_COORDINATOR_HANDLE;
+
 MOCKABLE_FUNCTION(, RETRY_CONTROL_HANDLE, retry_control_create, IOTHUB_CLIENT_RETRY_POLICY, policy, unsigned int, max_retry_time_in_secs);
 MOCKABLE_FUNCTION(, int, retry_control_should_retry, RETRY_CONTROL_HANDLE, retry_control_handle, RETRY_ACTION*, retry_action);
 MOCKABLE_FUNCTION(, void, retry_control_reset, RETRY_CONTROL_HANDLE, retry_control_handle);
+/* What retry_control_should_retry would answer now and, when that is RETRY_ACTION_RETRY_LATER, in how long it answers
+   RETRY_ACTION_RETRY_NOW, without taking the retry. */
+MOCKABLE_FUNCTION(, int, retry_control_get_wait_time, RETRY_CONTROL_HANDLE, retry_control_handle, RETRY_ACTION*, retry_action, unsigned int*, wait_time_in_ms);
 MOCKABLE_FUNCTION(, int, retry_control_set_option, RETRY_CONTROL_HANDLE, retry_control_handle, const char*, name, const void*, value);
 MOCKABLE_FUNCTION(, OPTIONHANDLER_HANDLE, retry_control_retrieve_options, RETRY_CONTROL_HANDLE, retry_control_handle);
 MOCKABLE_FUNCTION(, void, retry_control_destroy, RETRY_CONTROL_HANDLE, retry_control_handle);
 
+MOCKABLE_FUNCTION(, RETRY_COORDINATOR_HANDLE, retry_coordinator_create, unsigned int, retry_budget, unsigned int, retries_per_sec, unsigned int, failure_threshold, unsigned int, open_time_in_secs);
+MOCKABLE_FUNCTION(, void, retry_coordinator_destroy, RETRY_COORDINATOR_HANDLE, retry_coordinator_handle);
+
 MOCKABLE_FUNCTION(, int, is_timeout_reached, time_t, start_time, unsigned int, timeout_in_secs, bool*, is_timed_out);
 
 #ifdef __cplusplus
@@ -0,0 +1,24 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_THREAD_ATTRIBUTES_H
+#define IOTHUB_CLIENT_THREAD_ATTRIBUTES_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_options.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Applies the attributes of OPTION_THREAD_ATTRIBUTES to the calling thread. ThreadAPI_Create takes no attributes,
+   so each thread of IoTHubClient calls this as it starts. name_suffix is appended to the name, it tells the threads
+   of a client apart. Returns 0 when every attribute asked for was applied; when one cannot be, the others still are. */
+MOCKABLE_FUNCTION(, int, IoTHubClient_ThreadAttributes_ApplyToCurrentThread, const IOTHUB_CLIENT_THREAD_ATTRIBUTES*, attributes, const char*, name_suffix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_THREAD_ATTRIBUTES_H */
@@ -0,0 +1,47 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_TIMESERIES_H
+#define IOTHUB_CLIENT_TIMESERIES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TIMESERIES_CONTENT_TYPE_PROPERTY "content-type"
+#define TIMESERIES_CONTENT_TYPE_GORILLA "application/x-gorilla-timeseries"
+#define TIMESERIES_FORMAT_VERSION 1
+
+/* A time series builder appends (timestamp, value) samples to a Gorilla bit stream: the delta of delta of the
+   timestamps in 1 to 68 bits and the XOR of the values with the previous one in 1 to 77 bits, so a series sampled at a
+   fixed interval whose values change little takes a few bits per sample instead of the tens of bytes of its JSON.
+   timeseries_builder_to_message makes a binary message of the samples, with the application property content-type set
+   to application/x-gorilla-timeseries, and starts a new series. The format, for the decoder, is in
+   devdoc/requirement_docs/iothub_client_timeseries_requirements.md.
+   A time series builder is not thread safe. */
+typedef struct TIMESERIES_BUILDER_TAG* TIMESERIES_BUILDER_HANDLE;
+
+MOCKABLE_FUNCTION(, TIMESERIES_BUILDER_HANDLE, timeseries_builder_create);
+MOCKABLE_FUNCTION(, void, timeseries_builder_destroy, TIMESERIES_BUILDER_HANDLE, builder);
+
+/* The timestamps are any int64_t, in ms since the epoch for instance, best increasing by about the same interval. */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, timeseries_builder_append, TIMESERIES_BUILDER_HANDLE, builder, int64_t, timestamp, double, value);
+
+/* Number of samples and bytes of the series being built, to decide when to make its message. */
+MOCKABLE_FUNCTION(, size_t, timeseries_builder_get_sample_count, TIMESERIES_BUILDER_HANDLE, builder);
+MOCKABLE_FUNCTION(, size_t, timeseries_builder_get_size, TIMESERIES_BUILDER_HANDLE, builder);
+
+/* Returns NULL without samples. */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, timeseries_builder_to_message, TIMESERIES_BUILDER_HANDLE, builder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TIMESERIES_H */
@@ -0,0 +1,74 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_TRACE_H
+#define IOTHUB_CLIENT_TRACE_H
+
+#include <stdint.h>
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+/* Trace points on the hot paths of the client: a message queued, published and acknowledged, a connection state change,
+   a SAS token put on CBS. Unlike LogInfo nothing is formatted: every trace point hands an event, a subject (the message
+   or instance handle, which ties the events of a message together) and a number to the enabled backends.
+   - a user callback, set with IoTHubClient_Trace_SetCallback, gets a monotonic timestamp in nanoseconds
+   - LTTng (cmake -Duse_lttng_trace=ON, Linux) and ETW TraceLogging (cmake -Duse_etw_trace=ON, Windows) get the events once
+     IoTHubClient_Trace_EnablePlatformBackend has registered the provider, and timestamp them themselves
+   While no backend is enabled a trace point is a load and a branch. cmake -Dno_trace_hooks=ON removes them at compile time. */
+
+#define IOTHUB_CLIENT_TRACE_EVENT_VALUES                        \
+    IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED,                      \
+    IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH,                \
+    IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK,                    \
+    IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE,                 \
+    IOTHUB_CLIENT_TRACE_EVENT_CBS_PUT_TOKEN,                    \
+    IOTHUB_CLIENT_TRACE_EVENT_CBS_PUT_TOKEN_COMPLETE
+
+DEFINE_ENUM(IOTHUB_CLIENT_TRACE_EVENT, IOTHUB_CLIENT_TRACE_EVENT_VALUES);
+
+/* subject and value, by event:
+   SEND_QUEUED                 the IOTHUB_MESSAGE_HANDLE queued (the clone or gzip copy of the one given to
+                               IoTHubClient_LL_SendEventAsync, if any), 0 (the outbox sequence number for the outbox)
+   TRANSPORT_PUBLISH           the IOTHUB_MESSAGE_HANDLE, the MQTT packet id (0 over AMQP)
+   TRANSPORT_ACK               the IOTHUB_MESSAGE_HANDLE, the IOTHUB_CLIENT_CONFIRMATION_RESULT
+   CONNECTION_STATE            the transport instance, the new state of the transport (MQTT_CLIENT_STATUS, DEVICE_STATE)
+   CBS_PUT_TOKEN               the authentication instance, 0
+   CBS_PUT_TOKEN_COMPLETE      the authentication instance, the CBS status code */
+typedef void(*IOTHUB_CLIENT_TRACE_CALLBACK)(void* context, IOTHUB_CLIENT_TRACE_EVENT trace_event, uint64_t timestamp_ns, const void* subject, uint64_t value);
+
+/* Set before the clients are created: the callback is not synchronized with the threads tracing. NULL stops the calls. */
+MOCKABLE_FUNCTION(, int, IoTHubClient_Trace_SetCallback, IOTHUB_CLIENT_TRACE_CALLBACK, trace_callback, void*, context);
+/* Registers the LTTng or ETW provider, fails when none is built in. */
+MOCKABLE_FUNCTION(, int, IoTHubClient_Trace_EnablePlatformBackend);
+MOCKABLE_FUNCTION(, void, IoTHubClient_Trace_DisablePlatformBackend);
+
+/* Used by IOTHUB_CLIENT_TRACE only. */
+extern volatile int iothub_client_trace_enabled;
+extern void iothub_client_trace_emit(IOTHUB_CLIENT_TRACE_EVENT trace_event, const void* subject, uint64_t value);
+
+#ifdef NO_TRACE_HOOKS
+#define IOTHUB_CLIENT_TRACE(trace_event, subject, value)
+#else
+#define IOTHUB_CLIENT_TRACE(trace_event, subject, value) \
+    do \
+    { \
+        if (iothub_client_trace_enabled != 0) \
+        { \
+            iothub_client_trace_emit(trace_event, (const void*)(subject), (uint64_t)(value)); \
+        } \
+    } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TRACE_H */
@@ -0,0 +1,35 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_TRANSPORT_POOL_H
+#define IOTHUB_CLIENT_TRANSPORT_POOL_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothubtransport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* A transport pool shares a fixed number of transports (each its own connection, worker thread and reconnect logic)
+   between many devices. transport_pool_acquire picks the transport of a device by rendezvous hashing of its device id,
+   so a device always lands on the same transport, skipping the transports that already serve max_devices_per_transport
+   devices. The transport is given to IoTHubClient_CreateWithTransport and handed back with transport_pool_release once
+   the client is destroyed.
+   A transport runs the requests of its devices one after the other, which matters most for HTTP: pooling HTTP
+   transports gives transport_count keep-alive connections served concurrently, max_devices_per_transport bounding how
+   many devices wait on each. */
+typedef struct TRANSPORT_POOL_TAG* TRANSPORT_POOL_HANDLE;
+
+MOCKABLE_FUNCTION(, TRANSPORT_POOL_HANDLE, transport_pool_create, IOTHUB_CLIENT_TRANSPORT_PROVIDER, protocol, const char*, iotHubName, const char*, iotHubSuffix, size_t, transport_count, size_t, max_devices_per_transport);
+MOCKABLE_FUNCTION(, void, transport_pool_destroy, TRANSPORT_POOL_HANDLE, transport_pool);
+MOCKABLE_FUNCTION(, TRANSPORT_HANDLE, transport_pool_acquire, TRANSPORT_POOL_HANDLE, transport_pool, const char*, device_id);
+MOCKABLE_FUNCTION(, void, transport_pool_release, TRANSPORT_POOL_HANDLE, transport_pool, TRANSPORT_HANDLE, transport);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TRANSPORT_POOL_H */
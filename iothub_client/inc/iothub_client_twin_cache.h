@@ -0,0 +1,43 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_TWIN_CACHE_H
+#define IOTHUB_CLIENT_TWIN_CACHE_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/macro_utils.h"
+#include "iothub_client_ll.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Keeps the desired properties last given to the application and their $version, to turn the complete twin document
+   the transports get again after every reconnection into what changed since. The hub has no conditional get: the
+   document is still received, only the application is spared it. Given a file, the cache is loaded from it when created
+   and written to it after every change, so the first document after a restart is compared too. */
+typedef struct TWIN_CACHE_TAG* TWIN_CACHE_HANDLE;
+
+#define TWIN_CACHE_RESULT_VALUES \
+    TWIN_CACHE_DELIVER, \
+    TWIN_CACHE_DELIVER_PATCH, \
+    TWIN_CACHE_SKIP
+
+/* TWIN_CACHE_DELIVER: the document goes to the application as it came.
+   TWIN_CACHE_DELIVER_PATCH: the application gets *patch instead, as a DEVICE_TWIN_UPDATE_PARTIAL.
+   TWIN_CACHE_SKIP: the application has everything the document holds already. */
+DEFINE_ENUM(TWIN_CACHE_RESULT, TWIN_CACHE_RESULT_VALUES);
+
+/* file_name can be NULL, to keep the cache in memory only. */
+MOCKABLE_FUNCTION(, TWIN_CACHE_HANDLE, twin_cache_create, const char*, file_name);
+MOCKABLE_FUNCTION(, void, twin_cache_destroy, TWIN_CACHE_HANDLE, twin_cache);
+MOCKABLE_FUNCTION(, TWIN_CACHE_RESULT, twin_cache_update, TWIN_CACHE_HANDLE, twin_cache, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, payLoad, size_t, size, char**, patch);
+MOCKABLE_FUNCTION(, void, twin_cache_free_patch, char*, patch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TWIN_CACHE_H */
@@ -0,0 +1,33 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_WORKER_POOL_H
+#define IOTHUB_CLIENT_WORKER_POOL_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* A worker pool runs a set of registered work items on a fixed number of threads.
+   An item is never run by two threads at the same time. The work function returns the number of
+   milliseconds after which it wants to be run again; worker_pool_schedule makes it due immediately. */
+typedef unsigned int(*WORKER_POOL_WORK_FUNCTION)(void* work_context);
+
+typedef struct WORKER_POOL_TAG* WORKER_POOL_HANDLE;
+typedef struct WORKER_POOL_ITEM_TAG* WORKER_POOL_ITEM_HANDLE;
+
+MOCKABLE_FUNCTION(, WORKER_POOL_HANDLE, worker_pool_create, size_t, thread_count);
+MOCKABLE_FUNCTION(, void, worker_pool_destroy, WORKER_POOL_HANDLE, worker_pool);
+MOCKABLE_FUNCTION(, WORKER_POOL_ITEM_HANDLE, worker_pool_add, WORKER_POOL_HANDLE, worker_pool, WORKER_POOL_WORK_FUNCTION, work_function, void*, work_context);
+MOCKABLE_FUNCTION(, int, worker_pool_schedule, WORKER_POOL_ITEM_HANDLE, item);
+MOCKABLE_FUNCTION(, void, worker_pool_remove, WORKER_POOL_ITEM_HANDLE, item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_WORKER_POOL_H */
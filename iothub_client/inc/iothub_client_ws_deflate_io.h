@@ -0,0 +1,31 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_WS_DEFLATE_IO_H
+#define IOTHUB_CLIENT_WS_DEFLATE_IO_H
+
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* The WebSocket transports put this IO between the WebSocket IO and the TLS IO. Once OPTION_WEBSOCKET_DEFLATE is set
+   it offers permessage-deflate (RFC 7692) in the upgrade request of the WebSocket IO, and when the hub accepts it,
+   deflates the data frames the WebSocket IO sends and inflates the ones the hub sends before the WebSocket IO sees
+   them. Any other option and any other byte goes to the underlying IO as it is. */
+typedef struct WS_DEFLATE_IO_CONFIG_TAG
+{
+    const IO_INTERFACE_DESCRIPTION* underlying_io_interface;
+    void* underlying_io_parameters;
+} WS_DEFLATE_IO_CONFIG;
+
+MOCKABLE_FUNCTION(, const IO_INTERFACE_DESCRIPTION*, ws_deflate_io_get_interface_description);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_WS_DEFLATE_IO_H */
@@ -42,6 +42,40 @@ IOTHUBMESSAGE_UNKNOWN \
   */
 DEFINE_ENUM(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 
+#define IOTHUB_MESSAGE_PRIORITY_VALUES \
+IOTHUB_MESSAGE_PRIORITY_LOW, \
+IOTHUB_MESSAGE_PRIORITY_NORMAL, \
+IOTHUB_MESSAGE_PRIORITY_HIGH \
+
+/** @brief Enumeration specifying the priority of a message. It only decides the
+  * order in which the client sends the messages while the @c priority_weights
+  * option is set, it is not sent to the IoT hub.
+  */
+DEFINE_ENUM(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_VALUES);
+
+#define IOTHUB_MESSAGE_COMPRESSION_VALUES \
+IOTHUB_MESSAGE_COMPRESSION_DEFAULT, \
+IOTHUB_MESSAGE_COMPRESSION_NONE, \
+IOTHUB_MESSAGE_COMPRESSION_GZIP \
+
+/** @brief Enumeration specifying whether the client compresses the payload of a
+  * message while the @c compression option is set. @c IOTHUB_MESSAGE_COMPRESSION_DEFAULT
+  * compresses the payloads of at least @c minimumSizeInBytes.
+  */
+DEFINE_ENUM(IOTHUB_MESSAGE_COMPRESSION, IOTHUB_MESSAGE_COMPRESSION_VALUES);
+
+#define IOTHUB_MESSAGE_DELIVERY_VALUES \
+IOTHUB_MESSAGE_DELIVERY_DEFAULT, \
+IOTHUB_MESSAGE_DELIVERY_AT_LEAST_ONCE, \
+IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE \
+
+/** @brief Enumeration specifying how the MQTT transport publishes a message.
+  * @c IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE publishes it at QoS 0 and confirms it
+  * once written, @c IOTHUB_MESSAGE_DELIVERY_DEFAULT follows the @c mqtt_telemetry_qos
+  * option. The other transports always deliver the messages at least once.
+  */
+DEFINE_ENUM(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_VALUES);
+
 typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG* IOTHUB_MESSAGE_HANDLE;
 
 /**
@@ -56,6 +90,82 @@ typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG* IOTHUB_MESSAGE_HANDLE;
  */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArray, const unsigned char*, byteArray, size_t, size);
 
+/** @brief  Function called when a message created by
+  *         @c IoTHubMessage_CreateFromBorrowedBuffer and all its clones have
+  *         been destroyed, so that the application can release the buffer.
+  *         It can be called from any thread that destroys a message, including
+  *         the thread running @c IoTHubClient_LL_DoWork.
+  */
+typedef void(*IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK)(const unsigned char* buffer, void* context);
+
+/**
+ * @brief   Creates a new IoT hub message that refers to a byte array owned by
+ *          the caller instead of copying it. The type of the message will be
+ *          set to @c IOTHUBMESSAGE_BYTEARRAY and @c IoTHubMessage_GetByteArray
+ *          returns @p buffer itself.
+ *
+ * @param   buffer      The byte array holding the content of the message. It
+ *                      shall not change until @p freeCallback is called.
+ * @param   size        The size of the byte array.
+ * @param   freeCallback The function called once the message and all its
+ *                      clones are destroyed. Can be @c NULL.
+ * @param   context     The context passed to @p freeCallback.
+ *
+ * @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+ *          created or @c NULL in case an error occurs, in which case
+ *          @p freeCallback is not called.
+ */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromBorrowedBuffer, const unsigned char*, buffer, size_t, size, IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK, freeCallback, void*, context);
+
+/**
+ * @brief   Creates a new IoT hub message that takes ownership of a byte array
+ *          allocated with @c malloc, such as the output of @c SERIALIZE,
+ *          instead of copying it. The type of the message will be set to
+ *          @c IOTHUBMESSAGE_BYTEARRAY and @c IoTHubMessage_GetByteArray
+ *          returns @p buffer itself. The byte array is freed once the message
+ *          and all its clones are destroyed.
+ *
+ * @param   buffer      The byte array holding the content of the message.
+ * @param   size        The size of the byte array.
+ *
+ * @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+ *          created or @c NULL in case an error occurs, in which case
+ *          @p buffer still belongs to the caller.
+ */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromOwnedBuffer, unsigned char*, buffer, size_t, size);
+
+/** @brief  One segment of the content of a message created by
+  *         @c IoTHubMessage_CreateFromBorrowedSegments.
+  */
+typedef struct IOTHUB_MESSAGE_SEGMENT_TAG
+{
+    const unsigned char* buffer;
+    size_t size;
+} IOTHUB_MESSAGE_SEGMENT;
+
+/**
+ * @brief   Creates a new IoT hub message whose content is several byte arrays
+ *          owned by the caller, put one after the other, for example a header,
+ *          a body and a trailer. The byte arrays are not copied. The type of
+ *          the message will be set to @c IOTHUBMESSAGE_BYTEARRAY.
+ *          The transports need the content in one block: the segments are
+ *          copied once, the first time @c IoTHubMessage_GetByteArray is called
+ *          on the message or one of its clones.
+ *
+ * @param   segments    The segments of the content. The array itself is
+ *                      copied, the segments shall not change until
+ *                      @p freeCallback is called for them.
+ * @param   segmentCount The number of segments.
+ * @param   freeCallback The function called for each segment once the message
+ *                      and all its clones are destroyed. Can be @c NULL.
+ * @param   context     The context passed to @p freeCallback.
+ *
+ * @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+ *          created or @c NULL in case an error occurs, in which case
+ *          @p freeCallback is not called.
+ */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromBorrowedSegments, const IOTHUB_MESSAGE_SEGMENT*, segments, size_t, segmentCount, IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK, freeCallback, void*, context);
+
 /**
  * @brief   Creates a new IoT hub message from a null terminated string.  The
  *          type of the message will be set to @c IOTHUBMESSAGE_STRING.
@@ -68,6 +178,25 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArray, co
  */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromString, const char*, source);
 
+/**
+ * @brief   Creates a new IoT hub message from a byte array, with the
+ *          properties, message id, correlation id and priority of
+ *          @p prototype. The type of the message will be set to
+ *          @c IOTHUBMESSAGE_BYTEARRAY.
+ *          The properties are shared with the prototype instead of being
+ *          copied, until either message changes them: messages that always
+ *          carry the same properties do not allocate a properties map each.
+ *
+ * @param   prototype   Handle to the message whose properties are used. It can
+ *                      be destroyed before the new message.
+ * @param   byteArray   The byte array from which the message is to be created.
+ * @param   size        The size of the byte array.
+ *
+ * @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+ *          created or @c NULL in case an error occurs.
+ */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromPrototype, IOTHUB_MESSAGE_HANDLE, prototype, const unsigned char*, byteArray, size_t, size);
+
 /**
  * @brief   Creates a new IoT hub message with the content identical to that
  *          of the @p iotHubMessageHandle parameter.
@@ -96,6 +225,35 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_Clone, IOTHUB_MESSAGE_H
  */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const unsigned char**, buffer, size_t*, size);
 
+/**
+ * @brief   Returns the number of segments of a @c IOTHUBMESSAGE_BYTEARRAY
+ *          message: the number given to
+ *          @c IoTHubMessage_CreateFromBorrowedSegments, or 1.
+ *
+ * @param   iotHubMessageHandle Handle to the message.
+ *
+ * @return  The number of segments, 0 if the message is not a byte array.
+ */
+MOCKABLE_FUNCTION(, size_t, IoTHubMessage_GetSegmentCount, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
+/**
+ * @brief   Fetches a pointer and size for one segment of a
+ *          @c IOTHUBMESSAGE_BYTEARRAY message, without copying the segments
+ *          in one block.
+ *
+ * @param   iotHubMessageHandle Handle to the message.
+ * @param   index               The index of the segment, less than
+ *                              @c IoTHubMessage_GetSegmentCount.
+ * @param   buffer              Pointer to the memory location where the
+ *                              pointer to the segment will be written.
+ * @param   size                The size of the segment will be written to
+ *                              this address.
+ *
+ * @return  Returns IOTHUB_MESSAGE_OK if the segment was fetched successfully
+ *          or an error code otherwise.
+ */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetSegment, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, size_t, index, const unsigned char**, buffer, size_t*, size);
+
 /**
  * @brief   Returns the null terminated string stored in the message.
  *          If the content type of the message is not @c IOTHUBMESSAGE_STRING
@@ -167,6 +325,86 @@ MOCKABLE_FUNCTION(, const char*, IoTHubMessage_GetCorrelationId, IOTHUB_MESSAGE_
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetCorrelationId, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const char*, correlationId);
 
+/**
+* @brief   Gives a received message its application properties without adding
+*          them to its properties map yet, so that a message whose properties
+*          are never read does not pay for the map. They are added the first
+*          time the map is needed by IoTHubMessage_Properties.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   properties NUL terminated name and value pairs, one after the
+*          other. It shall be allocated with malloc; on success the message
+*          owns it and frees it.
+* @param   size The size of properties in bytes, including the last NUL.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the properties were taken
+*          or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetPendingProperties, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, char*, properties, size_t, size);
+
+/**
+* @brief   Sets the priority of the IOTHUB_MESSAGE_HANDLE, a new message has
+*          @c IOTHUB_MESSAGE_PRIORITY_NORMAL.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   priority The priority of the message.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the priority was set successfully
+*          or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetPriority, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, IOTHUB_MESSAGE_PRIORITY, priority);
+
+/**
+* @brief   Gets the priority of the IOTHUB_MESSAGE_HANDLE.
+*
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @return  The priority of the message.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_PRIORITY, IoTHubMessage_GetPriority, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
+/**
+* @brief   Sets whether the client compresses the payload of the IOTHUB_MESSAGE_HANDLE,
+*          a new message has @c IOTHUB_MESSAGE_COMPRESSION_DEFAULT.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   compression The compression of the message.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the compression was set successfully
+*          or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetCompression, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, IOTHUB_MESSAGE_COMPRESSION, compression);
+
+/**
+* @brief   Gets the compression of the IOTHUB_MESSAGE_HANDLE.
+*
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @return  The compression of the message.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_COMPRESSION, IoTHubMessage_GetCompression, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
+/**
+* @brief   Sets how the IOTHUB_MESSAGE_HANDLE is delivered, a new message has
+*          @c IOTHUB_MESSAGE_DELIVERY_DEFAULT.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   delivery The delivery of the message.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the delivery was set successfully
+*          or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetDelivery, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, IOTHUB_MESSAGE_DELIVERY, delivery);
+
+/**
+* @brief   Gets the delivery of the IOTHUB_MESSAGE_HANDLE.
+*
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @return  The delivery of the message.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_DELIVERY, IoTHubMessage_GetDelivery, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
 /**
  * @brief   Frees all resources associated with the given message handle.
  *
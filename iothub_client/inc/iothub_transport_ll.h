@@ -20,6 +20,8 @@ typedef void* METHOD_HANDLE;
 #include "azure_c_shared_utility/strings.h"
 #include "iothub_message.h"
 #include "iothub_client_authorization.h"
+#include <stdbool.h>
+#include <stdint.h>
 
 struct MESSAGE_DISPOSITION_CONTEXT_TAG;
 typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG* MESSAGE_DISPOSITION_CONTEXT_HANDLE;
@@ -65,10 +67,16 @@ extern "C"
     typedef int (*pfIoTHubTransport_Subscribe_DeviceTwin)(IOTHUB_DEVICE_HANDLE handle);
     typedef void (*pfIoTHubTransport_Unsubscribe_DeviceTwin)(IOTHUB_DEVICE_HANDLE handle);
     typedef IOTHUB_CLIENT_RESULT(*pfIotHubTransport_SendMessageDisposition)(MESSAGE_CALLBACK_INFO* messageData, IOTHUBMESSAGE_DISPOSITION_RESULT disposition);
-    typedef IOTHUB_PROCESS_ITEM_RESULT(*pfIoTHubTransport_ProcessItem)(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item);
+    typedef IOTHUB_PROCESS_ITEM_RESULT(*pfIoTHubTransport_ProcessItem)(IOTHUB_DEVICE_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item);
     typedef int(*pfIoTHubTransport_Subscribe_DeviceMethod)(IOTHUB_DEVICE_HANDLE handle);
     typedef void(*pfIoTHubTransport_Unsubscribe_DeviceMethod)(IOTHUB_DEVICE_HANDLE handle);
     typedef int(*pfIoTHubTransport_DeviceMethod_Response)(IOTHUB_DEVICE_HANDLE handle, METHOD_HANDLE methodId, const unsigned char* response, size_t response_size, int status_response);
+    /*milliseconds until the transport needs its DoWork called, IOTHUB_CLIENT_NO_WORK_DEADLINE for none; isWaitingForNetwork is set while a connection is open or being opened*/
+    typedef uint32_t(*pfIoTHubTransport_GetNextWorkDeadline)(TRANSPORT_LL_HANDLE handle, bool* isWaitingForNetwork);
+    /*writes at most descriptorCount sockets of the transport and returns how many it wrote*/
+    typedef size_t(*pfIoTHubTransport_GetPollDescriptors)(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_POLL_DESCRIPTOR* descriptors, size_t descriptorCount);
+    /*frees the buffers the transport keeps at their peak size for reuse, they are allocated again when needed*/
+    typedef void(*pfIoTHubTransport_TrimMemory)(TRANSPORT_LL_HANDLE handle);
 
 #define TRANSPORT_PROVIDER_FIELDS                                                   \
 pfIotHubTransport_SendMessageDisposition IoTHubTransport_SendMessageDisposition;  \
@@ -88,7 +96,10 @@ pfIoTHubTransport_Subscribe IoTHubTransport_Subscribe;
 pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;                          \
 pfIoTHubTransport_DoWork IoTHubTransport_DoWork;                                    \
 pfIoTHubTransport_SetRetryPolicy IoTHubTransport_SetRetryPolicy;                    \
-pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus  /*there's an intentional missing ; on this line*/
+pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;                     \
+pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline;          \
+pfIoTHubTransport_GetPollDescriptors IoTHubTransport_GetPollDescriptors;          \
+pfIoTHubTransport_TrimMemory IoTHubTransport_TrimMemory  /*there's an intentional missing ; on this line*/
 
     struct TRANSPORT_PROVIDER_TAG
     {
@@ -20,8 +20,12 @@ extern "C"
 // @brief    name of option to apply the instance obtained using device_retrieve_options
 static const char* DEVICE_OPTION_SAVED_OPTIONS = "saved_device_options";
 static const char* DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_secs";
+static const char* DEVICE_OPTION_EVENT_SEND_BATCH_MAX_COUNT = "event_send_batch_max_count";
+static const char* DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_SECS = "event_send_batch_linger_secs";
+static const char* DEVICE_OPTION_C2D_LINK_CREDIT = "c2d_link_credit";
 static const char* DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS = "cbs_request_timeout_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS = "sas_token_refresh_time_secs";
+static const char* DEVICE_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS = "sas_token_refresh_window_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_LIFETIME_SECS = "sas_token_lifetime_secs";
 
 typedef enum DEVICE_STATE_TAG
@@ -79,6 +83,7 @@ typedef struct DEVICE_CONFIG_TAG
 {
     const char* device_id;
     char* product_info;
+    // Owned by the transport and shared by all its devices, it must outlive the device
     char* iothub_host_fqdn;
     DEVICE_AUTH_MODE authentication_mode;
     ON_DEVICE_STATE_CHANGED on_state_changed_callback;
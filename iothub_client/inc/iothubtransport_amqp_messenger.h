@@ -16,6 +16,9 @@ extern "C"
 
 
 static const char* MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_secs";
+static const char* MESSENGER_OPTION_EVENT_SEND_BATCH_MAX_COUNT = "event_send_batch_max_count";
+static const char* MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_SECS = "event_send_batch_linger_secs";
+static const char* MESSENGER_OPTION_C2D_LINK_CREDIT = "c2d_link_credit";
 static const char* MESSENGER_OPTION_SAVED_OPTIONS = "saved_messenger_options";
 
 typedef struct MESSENGER_INSTANCE* MESSENGER_HANDLE;
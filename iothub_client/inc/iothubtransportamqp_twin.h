@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUBTRANSPORTAMQP_TWIN_H
+#define IOTHUBTRANSPORTAMQP_TWIN_H
+
+#include "azure_uamqp_c/session.h"
+#include "azure_c_shared_utility/constbuffer.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_ll.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+    /* The device twin of one device over the pair of twin links of an AMQP session. The requests (the GET of the twin
+       document, the subscription to the desired properties and the PATCHes of the reported properties) are sent as soon
+       as the sender link is open and are matched to their responses by correlation id, so any number of reported states
+       can wait for their response at once. */
+    typedef struct IOTHUBTRANSPORT_AMQP_TWIN_TAG* IOTHUBTRANSPORT_AMQP_TWIN_HANDLE;
+    typedef void(*ON_TWIN_ERROR)(void* context);
+    typedef void(*ON_TWIN_DOCUMENT_RECEIVED)(void* context, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* document, size_t document_size);
+    typedef void(*ON_TWIN_REPORTED_STATE_COMPLETE)(void* context, uint32_t item_id, int status_code);
+
+    MOCKABLE_FUNCTION(, IOTHUBTRANSPORT_AMQP_TWIN_HANDLE, iothubtransportamqp_twin_create, const char*, hostname, const char*, device_id);
+    MOCKABLE_FUNCTION(, void, iothubtransportamqp_twin_destroy, IOTHUBTRANSPORT_AMQP_TWIN_HANDLE, twin_handle);
+    MOCKABLE_FUNCTION(, int, iothubtransportamqp_twin_subscribe, IOTHUBTRANSPORT_AMQP_TWIN_HANDLE, twin_handle, SESSION_HANDLE, session_handle,
+        ON_TWIN_ERROR, on_twin_error, ON_TWIN_DOCUMENT_RECEIVED, on_document_received, ON_TWIN_REPORTED_STATE_COMPLETE, on_reported_state_complete, void*, context);
+    /* The reported states not answered yet when unsubscribing are sent again by the next subscribe. */
+    MOCKABLE_FUNCTION(, void, iothubtransportamqp_twin_unsubscribe, IOTHUBTRANSPORT_AMQP_TWIN_HANDLE, twin_handle);
+    MOCKABLE_FUNCTION(, int, iothubtransportamqp_twin_send_reported_state, IOTHUBTRANSPORT_AMQP_TWIN_HANDLE, twin_handle, uint32_t, item_id, CONSTBUFFER_HANDLE, reported_state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUBTRANSPORTAMQP_TWIN_H */
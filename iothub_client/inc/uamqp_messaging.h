@@ -16,6 +16,18 @@ extern "C"
 	MOCKABLE_FUNCTION(, int, IoTHubMessage_CreateFromUamqpMessage, MESSAGE_HANDLE, uamqp_message, IOTHUB_MESSAGE_HANDLE*, iothubclient_message);
 	MOCKABLE_FUNCTION(, int, message_create_from_iothub_message, IOTHUB_MESSAGE_HANDLE, iothub_message, MESSAGE_HANDLE*, uamqp_message);
 
+	/* Keeps the AMQP_VALUEs of the application property names most recently sent, so the names repeated from message to message
+	   are not created again. A cache shall only be used by one thread at a time. */
+	typedef struct UAMQP_PROPERTY_KEY_CACHE_TAG* UAMQP_PROPERTY_KEY_CACHE_HANDLE;
+
+	MOCKABLE_FUNCTION(, UAMQP_PROPERTY_KEY_CACHE_HANDLE, uamqp_property_key_cache_create);
+	MOCKABLE_FUNCTION(, void, uamqp_property_key_cache_destroy, UAMQP_PROPERTY_KEY_CACHE_HANDLE, key_cache);
+	MOCKABLE_FUNCTION(, int, message_create_from_iothub_message_with_key_cache, IOTHUB_MESSAGE_HANDLE, iothub_message, UAMQP_PROPERTY_KEY_CACHE_HANDLE, key_cache, MESSAGE_HANDLE*, uamqp_message);
+
+	/* Encodes iothub_message as a message of an AMQP batch (the body of a data section of a message with the batching format).
+	   The caller owns encoded_message->bytes and shall free them. */
+	MOCKABLE_FUNCTION(, int, message_create_uamqp_encoding_from_iothub_message, IOTHUB_MESSAGE_HANDLE, iothub_message, BINARY_DATA*, encoded_message);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,944 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* iothub_client_benchmark drives a configurable telemetry load through the _LL APIs of iothub_client, from one thread,
+and reports what a device application would see:
+- the sustained throughput (acknowledged messages per second), per report interval and for the whole run
+- the enqueue-to-ack latency percentiles, from IoTHubClient_LL_SendEventAsync to the confirmation callback
+- the CPU time per acknowledged message (clock, so the CPU of the whole process)
+- the resident set size over time (Linux only)
+- for gateway sizing: the time each device took to connect, how evenly the acks were spread over the devices (min, max
+  and Jain's fairness index, 1.0 when every device got the same share) and the resident set size per device
+
+Thousands of devices can be generated from one template connection string whose DeviceId holds a %u, for instance
+DeviceId=gateway%05u with --devices 5000, all of them having the same key.
+
+Every line printed after the first one is CSV with a fixed set of columns, the first column naming the record:
+    interval,elapsed_s,sent,acked,failed,in_flight,msgs_per_s,rss_kb
+    summary,elapsed_s,sent,acked,failed,msgs_per_s,p50_ms,p99_ms,p999_ms,max_ms,cpu_us_per_msg,peak_rss_kb
+    devices,count,connected,connect_p50_ms,connect_max_ms,acked_min,acked_max,fairness,rss_kb_per_device
+The first line starts with # and records the SDK version and every option, so runs on different SDK versions and
+hardware can be put side by side. */
+
+#include "iothub_client_ll.h"
+#include "iothub_client_version.h"
+#include "iothub_message.h"
+#include "iothubtransport.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/connection_string_parser.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/map.h"
+
+#ifdef USE_MQTT
+#include "iothubtransportmqtt.h"
+#include "iothubtransportmqtt_websockets.h"
+#endif
+#ifdef USE_HTTP
+#include "iothubtransporthttp.h"
+#endif
+#ifdef USE_AMQP
+#include "iothubtransportamqp.h"
+#include "iothubtransportamqp_websockets.h"
+#endif
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#define BENCHMARK_MAX_DEVICES           10000
+#define BENCHMARK_DRAIN_TIMEOUT_MS      30000
+#define BENCHMARK_MAX_CONNECTION_STRING 1024
+
+typedef struct BENCHMARK_PROTOCOL_TAG
+{
+    const char* name;
+    IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;
+} BENCHMARK_PROTOCOL;
+
+static const BENCHMARK_PROTOCOL BENCHMARK_PROTOCOLS[] =
+{
+#ifdef USE_MQTT
+    { "mqtt", MQTT_Protocol },
+    { "mqtt_ws", MQTT_WebSocket_Protocol },
+#endif
+#ifdef USE_AMQP
+    { "amqp", AMQP_Protocol },
+    { "amqp_ws", AMQP_Protocol_over_WebSocketsTls },
+#endif
+#ifdef USE_HTTP
+    { "http", HTTP_Protocol },
+#endif
+    { NULL, NULL }
+};
+
+typedef struct BENCHMARK_OPTIONS_TAG
+{
+    const BENCHMARK_PROTOCOL* protocol;
+    size_t message_rate;
+    size_t message_size;
+    size_t property_count;
+    size_t max_in_flight;
+    size_t duration_seconds;
+    size_t report_interval_seconds;
+    bool shared_transport;
+    const char* device_template;
+    size_t generated_device_count;
+    const char* connection_strings[BENCHMARK_MAX_DEVICES];
+    size_t device_count;
+} BENCHMARK_OPTIONS;
+
+typedef struct BENCHMARK_TAG BENCHMARK;
+
+typedef struct BENCHMARK_DEVICE_TAG
+{
+    STRING_HANDLE connection_string;
+    MAP_HANDLE connection_string_values;
+    IOTHUB_CLIENT_LL_HANDLE client;
+    BENCHMARK* benchmark;
+    size_t acked;
+    bool connected;
+    /*time from the creation of the devices to the first sign of a connection: the status callback or, for transports
+    that do not report one (http), the first ack*/
+    tickcounter_ms_t connect_ms;
+} BENCHMARK_DEVICE;
+
+struct BENCHMARK_TAG
+{
+    TICK_COUNTER_HANDLE tick_counter;
+    tickcounter_ms_t devices_created_ms;
+    long start_rss_kb;
+    size_t sent;
+    size_t acked;
+    size_t failed;
+    size_t in_flight;
+    tickcounter_ms_t* latencies_ms;
+    size_t latency_count;
+    size_t latency_capacity;
+    long peak_rss_kb;
+};
+
+typedef struct BENCHMARK_MESSAGE_TAG
+{
+    BENCHMARK* benchmark;
+    BENCHMARK_DEVICE* device;
+    tickcounter_ms_t enqueued_ms;
+} BENCHMARK_MESSAGE;
+
+static void print_usage(const char* program)
+{
+    size_t index;
+
+    (void)printf("usage: %s [options] --connection-string <device connection string> [--connection-string ...]\r\n", program);
+    (void)printf("  --protocol <name>             one of:");
+    for (index = 0; BENCHMARK_PROTOCOLS[index].name != NULL; index++)
+    {
+        (void)printf(" %s", BENCHMARK_PROTOCOLS[index].name);
+    }
+    (void)printf(" (default %s)\r\n", (BENCHMARK_PROTOCOLS[0].name == NULL) ? "none" : BENCHMARK_PROTOCOLS[0].name);
+    (void)printf("  --connection-strings-file <f> one device connection string per line, for many devices\r\n");
+    (void)printf("  --device-template <string>    connection string whose DeviceId holds a %%u, used with --devices\r\n");
+    (void)printf("  --devices <count>             devices generated from --device-template, numbered from 0\r\n");
+    (void)printf("  --shared                      share one transport between all the devices (amqp, amqp_ws, http)\r\n");
+    (void)printf("  --rate <messages/s>           target rate over all the devices, 0 for as fast as acks come (default 0)\r\n");
+    (void)printf("  --size <bytes>                payload size (default 256)\r\n");
+    (void)printf("  --properties <count>          application properties per message (default 0)\r\n");
+    (void)printf("  --max-in-flight <count>       messages sent and not yet acknowledged, over all the devices (default 1000)\r\n");
+    (void)printf("  --duration <seconds>          length of the send phase (default 60)\r\n");
+    (void)printf("  --report-interval <seconds>   time between two interval records (default 5)\r\n");
+}
+
+static int parse_size(const char* text, size_t* value)
+{
+    int result;
+    char* end;
+    unsigned long parsed = strtoul(text, &end, 10);
+
+    if ((end == text) || (*end != '\0'))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *value = (size_t)parsed;
+        result = 0;
+    }
+    return result;
+}
+
+static int add_connection_string(BENCHMARK_OPTIONS* options, const char* connection_string)
+{
+    int result;
+
+    if (options->device_count == BENCHMARK_MAX_DEVICES)
+    {
+        (void)printf("ERROR: at most %d devices are supported\r\n", BENCHMARK_MAX_DEVICES);
+        result = __FAILURE__;
+    }
+    else
+    {
+        options->connection_strings[options->device_count++] = connection_string;
+        result = 0;
+    }
+    return result;
+}
+
+static int read_connection_strings_file(BENCHMARK_OPTIONS* options, const char* file_name)
+{
+    int result = 0;
+    FILE* file = fopen(file_name, "r");
+
+    if (file == NULL)
+    {
+        (void)printf("ERROR: cannot open %s\r\n", file_name);
+        result = __FAILURE__;
+    }
+    else
+    {
+        char line[BENCHMARK_MAX_CONNECTION_STRING];
+
+        while ((result == 0) && (fgets(line, sizeof(line), file) != NULL))
+        {
+            char* copy;
+
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0')
+            {
+                continue;
+            }
+            /*the copies live as long as the process*/
+            if (mallocAndStrcpy_s(&copy, line) != 0)
+            {
+                (void)printf("ERROR: cannot copy a connection string\r\n");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = add_connection_string(options, copy);
+            }
+        }
+        (void)fclose(file);
+    }
+    return result;
+}
+
+static int generate_connection_strings(BENCHMARK_OPTIONS* options)
+{
+    int result = 0;
+    const char* marker = (options->device_template == NULL) ? NULL : strstr(options->device_template, "%u");
+
+    if ((marker == NULL) || (strchr(marker + 2, '%') != NULL) || (strchr(options->device_template, '%') != marker))
+    {
+        (void)printf("ERROR: --devices needs a --device-template holding exactly one %%u\r\n");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t index;
+        for (index = 0; (index < options->generated_device_count) && (result == 0); index++)
+        {
+            char line[BENCHMARK_MAX_CONNECTION_STRING];
+            char* copy;
+
+            if (sprintf_s(line, sizeof(line), options->device_template, (unsigned int)index) <= 0)
+            {
+                (void)printf("ERROR: the device template is too long\r\n");
+                result = __FAILURE__;
+            }
+            /*the copies live as long as the process*/
+            else if (mallocAndStrcpy_s(&copy, line) != 0)
+            {
+                (void)printf("ERROR: cannot copy a connection string\r\n");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = add_connection_string(options, copy);
+            }
+        }
+    }
+    return result;
+}
+
+static int parse_options(int argc, char** argv, BENCHMARK_OPTIONS* options)
+{
+    int result = 0;
+    int index;
+
+    (void)memset(options, 0, sizeof(BENCHMARK_OPTIONS));
+    options->protocol = &BENCHMARK_PROTOCOLS[0];
+    options->message_size = 256;
+    options->max_in_flight = 1000;
+    options->duration_seconds = 60;
+    options->report_interval_seconds = 5;
+
+    for (index = 1; (index < argc) && (result == 0); index++)
+    {
+        const char* option = argv[index];
+        const char* value = (index + 1 < argc) ? argv[index + 1] : NULL;
+
+        if (strcmp(option, "--shared") == 0)
+        {
+            options->shared_transport = true;
+            continue;
+        }
+
+        if (value == NULL)
+        {
+            (void)printf("ERROR: %s needs a value\r\n", option);
+            result = __FAILURE__;
+            break;
+        }
+        index++;
+
+        if (strcmp(option, "--protocol") == 0)
+        {
+            const BENCHMARK_PROTOCOL* protocol = BENCHMARK_PROTOCOLS;
+            while ((protocol->name != NULL) && (strcmp(protocol->name, value) != 0))
+            {
+                protocol++;
+            }
+            if (protocol->name == NULL)
+            {
+                (void)printf("ERROR: protocol %s is not built in\r\n", value);
+                result = __FAILURE__;
+            }
+            options->protocol = protocol;
+        }
+        else if (strcmp(option, "--connection-string") == 0)
+        {
+            result = add_connection_string(options, value);
+        }
+        else if (strcmp(option, "--connection-strings-file") == 0)
+        {
+            result = read_connection_strings_file(options, value);
+        }
+        else if (strcmp(option, "--device-template") == 0)
+        {
+            options->device_template = value;
+        }
+        else if (strcmp(option, "--devices") == 0)
+        {
+            result = parse_size(value, &options->generated_device_count);
+        }
+        else if (strcmp(option, "--rate") == 0)
+        {
+            result = parse_size(value, &options->message_rate);
+        }
+        else if (strcmp(option, "--size") == 0)
+        {
+            result = parse_size(value, &options->message_size);
+        }
+        else if (strcmp(option, "--properties") == 0)
+        {
+            result = parse_size(value, &options->property_count);
+        }
+        else if (strcmp(option, "--max-in-flight") == 0)
+        {
+            result = parse_size(value, &options->max_in_flight);
+        }
+        else if (strcmp(option, "--duration") == 0)
+        {
+            result = parse_size(value, &options->duration_seconds);
+        }
+        else if (strcmp(option, "--report-interval") == 0)
+        {
+            result = parse_size(value, &options->report_interval_seconds);
+        }
+        else
+        {
+            (void)printf("ERROR: unknown option %s\r\n", option);
+            result = __FAILURE__;
+        }
+
+        if (result != 0)
+        {
+            (void)printf("ERROR: invalid value %s for %s\r\n", value, option);
+        }
+    }
+
+    if ((result == 0) && (options->generated_device_count > 0))
+    {
+        result = generate_connection_strings(options);
+    }
+
+    if (result == 0)
+    {
+        if (options->protocol->name == NULL)
+        {
+            (void)printf("ERROR: no protocol is built in\r\n");
+            result = __FAILURE__;
+        }
+        else if (options->device_count == 0)
+        {
+            (void)printf("ERROR: at least one device connection string is needed\r\n");
+            result = __FAILURE__;
+        }
+        else if ((options->max_in_flight == 0) || (options->report_interval_seconds == 0))
+        {
+            (void)printf("ERROR: --max-in-flight and --report-interval cannot be 0\r\n");
+            result = __FAILURE__;
+        }
+    }
+
+    return result;
+}
+
+/*resident set size in KB, -1 where it cannot be read*/
+static long get_rss_kb(void)
+{
+    long result = -1;
+#ifdef __linux__
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL)
+    {
+        long total_pages;
+        long resident_pages;
+        if (fscanf(statm, "%ld %ld", &total_pages, &resident_pages) == 2)
+        {
+            result = resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+        }
+        (void)fclose(statm);
+    }
+#endif
+    return result;
+}
+
+static tickcounter_ms_t get_now_ms(BENCHMARK* benchmark)
+{
+    tickcounter_ms_t now = 0;
+    (void)tickcounter_get_current_ms(benchmark->tick_counter, &now);
+    return now;
+}
+
+static void record_latency(BENCHMARK* benchmark, tickcounter_ms_t latency_ms)
+{
+    if (benchmark->latency_count == benchmark->latency_capacity)
+    {
+        size_t new_capacity = (benchmark->latency_capacity == 0) ? 4096 : benchmark->latency_capacity * 2;
+        tickcounter_ms_t* latencies = (tickcounter_ms_t*)realloc(benchmark->latencies_ms, new_capacity * sizeof(tickcounter_ms_t));
+        if (latencies == NULL)
+        {
+            /*the latency is lost, the counters stay right*/
+            return;
+        }
+        benchmark->latencies_ms = latencies;
+        benchmark->latency_capacity = new_capacity;
+    }
+    benchmark->latencies_ms[benchmark->latency_count++] = latency_ms;
+}
+
+static void SendConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    BENCHMARK_MESSAGE* message = (BENCHMARK_MESSAGE*)userContextCallback;
+    BENCHMARK* benchmark = message->benchmark;
+
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        benchmark->acked++;
+        message->device->acked++;
+        if (!message->device->connected)
+        {
+            message->device->connected = true;
+            message->device->connect_ms = get_now_ms(benchmark) - benchmark->devices_created_ms;
+        }
+        record_latency(benchmark, get_now_ms(benchmark) - message->enqueued_ms);
+    }
+    else
+    {
+        benchmark->failed++;
+    }
+    benchmark->in_flight--;
+    free(message);
+}
+
+static void ConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* userContextCallback)
+{
+    BENCHMARK_DEVICE* device = (BENCHMARK_DEVICE*)userContextCallback;
+    (void)reason;
+
+    if ((result == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED) && !device->connected)
+    {
+        device->connected = true;
+        device->connect_ms = get_now_ms(device->benchmark) - device->benchmark->devices_created_ms;
+    }
+}
+
+static int send_message(BENCHMARK* benchmark, BENCHMARK_DEVICE* device, const BENCHMARK_OPTIONS* options, const unsigned char* payload)
+{
+    int result;
+    IOTHUB_MESSAGE_HANDLE message_handle;
+    BENCHMARK_MESSAGE* message;
+
+    if ((message = (BENCHMARK_MESSAGE*)malloc(sizeof(BENCHMARK_MESSAGE))) == NULL)
+    {
+        (void)printf("ERROR: malloc failed for the message context\r\n");
+        result = __FAILURE__;
+    }
+    else if ((message_handle = IoTHubMessage_CreateFromByteArray(payload, options->message_size)) == NULL)
+    {
+        (void)printf("ERROR: IoTHubMessage_CreateFromByteArray failed\r\n");
+        free(message);
+        result = __FAILURE__;
+    }
+    else
+    {
+        MAP_HANDLE properties = IoTHubMessage_Properties(message_handle);
+        size_t property_index;
+
+        result = 0;
+        for (property_index = 0; (property_index < options->property_count) && (result == 0); property_index++)
+        {
+            char key[32];
+            (void)sprintf_s(key, sizeof(key), "property%u", (unsigned int)property_index);
+            if (Map_AddOrUpdate(properties, key, "value") != MAP_OK)
+            {
+                (void)printf("ERROR: Map_AddOrUpdate failed\r\n");
+                result = __FAILURE__;
+            }
+        }
+
+        if (result == 0)
+        {
+            message->benchmark = benchmark;
+            message->device = device;
+            message->enqueued_ms = get_now_ms(benchmark);
+
+            if (IoTHubClient_LL_SendEventAsync(device->client, message_handle, SendConfirmationCallback, message) != IOTHUB_CLIENT_OK)
+            {
+                (void)printf("ERROR: IoTHubClient_LL_SendEventAsync failed\r\n");
+                result = __FAILURE__;
+            }
+            else
+            {
+                benchmark->sent++;
+                benchmark->in_flight++;
+            }
+        }
+
+        if (result != 0)
+        {
+            free(message);
+        }
+        IoTHubMessage_Destroy(message_handle);
+    }
+
+    return result;
+}
+
+static void print_interval(BENCHMARK* benchmark, tickcounter_ms_t elapsed_ms, size_t acked_in_interval, tickcounter_ms_t interval_ms)
+{
+    long rss_kb = get_rss_kb();
+
+    if (rss_kb > benchmark->peak_rss_kb)
+    {
+        benchmark->peak_rss_kb = rss_kb;
+    }
+    (void)printf("interval,%.3f,%lu,%lu,%lu,%lu,%.1f,%ld\r\n",
+        (double)elapsed_ms / 1000.0,
+        (unsigned long)benchmark->sent,
+        (unsigned long)benchmark->acked,
+        (unsigned long)benchmark->failed,
+        (unsigned long)benchmark->in_flight,
+        (interval_ms == 0) ? 0.0 : (double)acked_in_interval * 1000.0 / (double)interval_ms,
+        rss_kb);
+}
+
+static int compare_latencies(const void* left, const void* right)
+{
+    tickcounter_ms_t left_latency = *(const tickcounter_ms_t*)left;
+    tickcounter_ms_t right_latency = *(const tickcounter_ms_t*)right;
+    return (left_latency < right_latency) ? -1 : ((left_latency > right_latency) ? 1 : 0);
+}
+
+/*nearest rank percentile of the sorted latencies*/
+static unsigned long get_percentile(const BENCHMARK* benchmark, double percentile)
+{
+    unsigned long result;
+
+    if (benchmark->latency_count == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t rank = (size_t)(percentile * (double)benchmark->latency_count / 100.0 + 0.999999);
+        if (rank == 0)
+        {
+            rank = 1;
+        }
+        else if (rank > benchmark->latency_count)
+        {
+            rank = benchmark->latency_count;
+        }
+        result = (unsigned long)benchmark->latencies_ms[rank - 1];
+    }
+    return result;
+}
+
+static void print_summary(BENCHMARK* benchmark, tickcounter_ms_t elapsed_ms, double cpu_seconds)
+{
+    qsort(benchmark->latencies_ms, benchmark->latency_count, sizeof(tickcounter_ms_t), compare_latencies);
+
+    (void)printf("summary,elapsed_s,sent,acked,failed,msgs_per_s,p50_ms,p99_ms,p999_ms,max_ms,cpu_us_per_msg,peak_rss_kb\r\n");
+    (void)printf("summary,%.3f,%lu,%lu,%lu,%.1f,%lu,%lu,%lu,%lu,%.1f,%ld\r\n",
+        (double)elapsed_ms / 1000.0,
+        (unsigned long)benchmark->sent,
+        (unsigned long)benchmark->acked,
+        (unsigned long)benchmark->failed,
+        (elapsed_ms == 0) ? 0.0 : (double)benchmark->acked * 1000.0 / (double)elapsed_ms,
+        get_percentile(benchmark, 50.0),
+        get_percentile(benchmark, 99.0),
+        get_percentile(benchmark, 99.9),
+        get_percentile(benchmark, 100.0),
+        (benchmark->acked == 0) ? 0.0 : cpu_seconds * 1000000.0 / (double)benchmark->acked,
+        benchmark->peak_rss_kb);
+}
+
+static int compare_connect_times(const void* left, const void* right)
+{
+    tickcounter_ms_t left_ms = *(const tickcounter_ms_t*)left;
+    tickcounter_ms_t right_ms = *(const tickcounter_ms_t*)right;
+    return (left_ms < right_ms) ? -1 : ((left_ms > right_ms) ? 1 : 0);
+}
+
+/*Jain's index is (sum of x)^2 / (n * sum of x^2) over the acks per device, from 1/n (one device got everything) to 1.0*/
+static void print_device_summary(const BENCHMARK* benchmark, const BENCHMARK_DEVICE* devices, size_t device_count)
+{
+    tickcounter_ms_t* connect_times = (tickcounter_ms_t*)malloc(device_count * sizeof(tickcounter_ms_t));
+    size_t connected = 0;
+    size_t acked_min = SIZE_MAX;
+    size_t acked_max = 0;
+    double acked_sum = 0.0;
+    double acked_square_sum = 0.0;
+    size_t index;
+
+    for (index = 0; index < device_count; index++)
+    {
+        if (devices[index].connected && (connect_times != NULL))
+        {
+            connect_times[connected++] = devices[index].connect_ms;
+        }
+        acked_min = (devices[index].acked < acked_min) ? devices[index].acked : acked_min;
+        acked_max = (devices[index].acked > acked_max) ? devices[index].acked : acked_max;
+        acked_sum += (double)devices[index].acked;
+        acked_square_sum += (double)devices[index].acked * (double)devices[index].acked;
+    }
+
+    if (connected > 0)
+    {
+        qsort(connect_times, connected, sizeof(tickcounter_ms_t), compare_connect_times);
+    }
+
+    (void)printf("devices,count,connected,connect_p50_ms,connect_max_ms,acked_min,acked_max,fairness,rss_kb_per_device\r\n");
+    (void)printf("devices,%lu,%lu,%lu,%lu,%lu,%lu,%.3f,%.1f\r\n",
+        (unsigned long)device_count,
+        (unsigned long)connected,
+        (connected == 0) ? 0UL : (unsigned long)connect_times[connected / 2],
+        (connected == 0) ? 0UL : (unsigned long)connect_times[connected - 1],
+        (unsigned long)acked_min,
+        (unsigned long)acked_max,
+        (acked_square_sum == 0.0) ? 0.0 : (acked_sum * acked_sum) / ((double)device_count * acked_square_sum),
+        (benchmark->peak_rss_kb <= benchmark->start_rss_kb) ? 0.0 : (double)(benchmark->peak_rss_kb - benchmark->start_rss_kb) / (double)device_count);
+
+    free(connect_times);
+}
+
+static void do_work(BENCHMARK_DEVICE* devices, size_t device_count)
+{
+    size_t index;
+    for (index = 0; index < device_count; index++)
+    {
+        IoTHubClient_LL_DoWork(devices[index].client);
+    }
+}
+
+static int run_load(BENCHMARK* benchmark, BENCHMARK_DEVICE* devices, const BENCHMARK_OPTIONS* options)
+{
+    int result = 0;
+    unsigned char* payload;
+
+    if ((payload = (unsigned char*)malloc(options->message_size + 1)) == NULL)
+    {
+        (void)printf("ERROR: malloc failed for the payload\r\n");
+        result = __FAILURE__;
+    }
+    else
+    {
+        tickcounter_ms_t start_ms = get_now_ms(benchmark);
+        tickcounter_ms_t now_ms = start_ms;
+        tickcounter_ms_t duration_ms = (tickcounter_ms_t)options->duration_seconds * 1000;
+        tickcounter_ms_t report_interval_ms = (tickcounter_ms_t)options->report_interval_seconds * 1000;
+        tickcounter_ms_t last_report_ms = start_ms;
+        size_t acked_at_last_report = 0;
+        size_t next_device = 0;
+        clock_t cpu_start = clock();
+
+        (void)memset(payload, 'x', options->message_size + 1);
+
+        (void)printf("interval,elapsed_s,sent,acked,failed,in_flight,msgs_per_s,rss_kb\r\n");
+
+        /*send phase: keep to the rate, never more than max_in_flight messages waiting for their ack*/
+        while ((result == 0) && (now_ms - start_ms < duration_ms))
+        {
+            size_t due = (options->message_rate == 0) ? SIZE_MAX : (size_t)((now_ms - start_ms) * options->message_rate / 1000) + 1;
+            size_t sent_before = benchmark->sent;
+
+            while ((result == 0) && (benchmark->sent < due) && (benchmark->in_flight < options->max_in_flight))
+            {
+                result = send_message(benchmark, &devices[next_device], options, payload);
+                next_device = (next_device + 1) % options->device_count;
+            }
+
+            do_work(devices, options->device_count);
+            if (benchmark->sent == sent_before)
+            {
+                ThreadAPI_Sleep(1);
+            }
+
+            now_ms = get_now_ms(benchmark);
+            if (now_ms - last_report_ms >= report_interval_ms)
+            {
+                print_interval(benchmark, now_ms - start_ms, benchmark->acked - acked_at_last_report, now_ms - last_report_ms);
+                acked_at_last_report = benchmark->acked;
+                last_report_ms = now_ms;
+            }
+        }
+
+        /*drain phase: the messages in flight get their ack, or the drain times out*/
+        {
+            tickcounter_ms_t drain_start_ms = now_ms;
+            while ((benchmark->in_flight > 0) && (now_ms - drain_start_ms < BENCHMARK_DRAIN_TIMEOUT_MS))
+            {
+                do_work(devices, options->device_count);
+                ThreadAPI_Sleep(1);
+                now_ms = get_now_ms(benchmark);
+            }
+        }
+
+        print_interval(benchmark, now_ms - start_ms, benchmark->acked - acked_at_last_report, now_ms - last_report_ms);
+        print_summary(benchmark, now_ms - start_ms, (double)(clock() - cpu_start) / CLOCKS_PER_SEC);
+        print_device_summary(benchmark, devices, options->device_count);
+
+        free(payload);
+    }
+
+    return result;
+}
+
+static int create_device(BENCHMARK_DEVICE* device, const char* connection_string, const BENCHMARK_OPTIONS* options, TRANSPORT_HANDLE transport)
+{
+    int result;
+
+    if (transport == NULL)
+    {
+        if ((device->client = IoTHubClient_LL_CreateFromConnectionString(connection_string, options->protocol->protocol)) == NULL)
+        {
+            (void)printf("ERROR: IoTHubClient_LL_CreateFromConnectionString failed for %s\r\n", connection_string);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    else
+    {
+        IOTHUB_CLIENT_DEVICE_CONFIG config;
+
+        config.protocol = options->protocol->protocol;
+        config.transportHandle = IoTHubTransport_GetLLTransport(transport);
+        config.deviceId = Map_GetValueFromKey(device->connection_string_values, "DeviceId");
+        config.deviceKey = Map_GetValueFromKey(device->connection_string_values, "SharedAccessKey");
+        config.deviceSasToken = Map_GetValueFromKey(device->connection_string_values, "SharedAccessSignature");
+
+        if ((config.deviceId == NULL) || ((config.deviceKey == NULL) && (config.deviceSasToken == NULL)))
+        {
+            (void)printf("ERROR: %s has no DeviceId, SharedAccessKey or SharedAccessSignature\r\n", connection_string);
+            result = __FAILURE__;
+        }
+        else if ((device->client = IoTHubClient_LL_CreateWithTransport(&config)) == NULL)
+        {
+            (void)printf("ERROR: IoTHubClient_LL_CreateWithTransport failed for %s\r\n", config.deviceId);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/*the shared transport is created for the hub of the first device, HostName=<hub name>.<hub suffix>*/
+static TRANSPORT_HANDLE create_shared_transport(BENCHMARK_DEVICE* first_device, const BENCHMARK_OPTIONS* options)
+{
+    TRANSPORT_HANDLE result;
+    const char* host_name = Map_GetValueFromKey(first_device->connection_string_values, "HostName");
+    const char* suffix = (host_name == NULL) ? NULL : strchr(host_name, '.');
+
+    if (suffix == NULL)
+    {
+        (void)printf("ERROR: the first connection string has no HostName\r\n");
+        result = NULL;
+    }
+    else
+    {
+        char hub_name[256];
+        size_t hub_name_length = (size_t)(suffix - host_name);
+
+        if (hub_name_length >= sizeof(hub_name))
+        {
+            (void)printf("ERROR: the hub name is too long\r\n");
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(hub_name, host_name, hub_name_length);
+            hub_name[hub_name_length] = '\0';
+
+            if ((result = IoTHubTransport_Create(options->protocol->protocol, hub_name, suffix + 1)) == NULL)
+            {
+                (void)printf("ERROR: IoTHubTransport_Create failed, %s may not support shared transports\r\n", options->protocol->name);
+            }
+        }
+    }
+    return result;
+}
+
+static int iothub_client_benchmark_run(const BENCHMARK_OPTIONS* options)
+{
+    int result = 0;
+    BENCHMARK_DEVICE* devices;
+    BENCHMARK benchmark;
+
+    (void)memset(&benchmark, 0, sizeof(BENCHMARK));
+    benchmark.peak_rss_kb = get_rss_kb();
+    benchmark.start_rss_kb = benchmark.peak_rss_kb;
+
+    (void)printf("# iothub_client_benchmark sdk=%s protocol=%s devices=%lu shared=%d rate=%lu size=%lu properties=%lu max_in_flight=%lu duration_s=%lu\r\n",
+        IoTHubClient_GetVersionString(),
+        options->protocol->name,
+        (unsigned long)options->device_count,
+        options->shared_transport ? 1 : 0,
+        (unsigned long)options->message_rate,
+        (unsigned long)options->message_size,
+        (unsigned long)options->property_count,
+        (unsigned long)options->max_in_flight,
+        (unsigned long)options->duration_seconds);
+
+    if (platform_init() != 0)
+    {
+        (void)printf("ERROR: failed to initialize the platform\r\n");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((benchmark.tick_counter = tickcounter_create()) == NULL)
+        {
+            (void)printf("ERROR: tickcounter_create failed\r\n");
+            result = __FAILURE__;
+        }
+        else if ((devices = (BENCHMARK_DEVICE*)calloc(options->device_count, sizeof(BENCHMARK_DEVICE))) == NULL)
+        {
+            (void)printf("ERROR: calloc failed for the devices\r\n");
+            result = __FAILURE__;
+        }
+        else
+        {
+            TRANSPORT_HANDLE transport = NULL;
+            size_t index;
+
+            for (index = 0; (index < options->device_count) && (result == 0); index++)
+            {
+                if (((devices[index].connection_string = STRING_construct(options->connection_strings[index])) == NULL) ||
+                    ((devices[index].connection_string_values = connectionstringparser_parse(devices[index].connection_string)) == NULL))
+                {
+                    (void)printf("ERROR: cannot parse connection string %s\r\n", options->connection_strings[index]);
+                    result = __FAILURE__;
+                }
+            }
+
+            if ((result == 0) && options->shared_transport && ((transport = create_shared_transport(&devices[0], options)) == NULL))
+            {
+                result = __FAILURE__;
+            }
+
+            benchmark.devices_created_ms = get_now_ms(&benchmark);
+            for (index = 0; (index < options->device_count) && (result == 0); index++)
+            {
+                devices[index].benchmark = &benchmark;
+                if ((result = create_device(&devices[index], options->connection_strings[index], options, transport)) == 0)
+                {
+                    (void)IoTHubClient_LL_SetConnectionStatusCallback(devices[index].client, ConnectionStatusCallback, &devices[index]);
+                }
+            }
+
+            if (result == 0)
+            {
+                result = run_load(&benchmark, devices, options);
+            }
+
+            for (index = 0; index < options->device_count; index++)
+            {
+                if (devices[index].client != NULL)
+                {
+                    IoTHubClient_LL_Destroy(devices[index].client);
+                }
+                if (devices[index].connection_string_values != NULL)
+                {
+                    Map_Destroy(devices[index].connection_string_values);
+                }
+                if (devices[index].connection_string != NULL)
+                {
+                    STRING_delete(devices[index].connection_string);
+                }
+            }
+            if (transport != NULL)
+            {
+                IoTHubTransport_Destroy(transport);
+            }
+            free(devices);
+        }
+
+        if (benchmark.tick_counter != NULL)
+        {
+            tickcounter_destroy(benchmark.tick_counter);
+        }
+        free(benchmark.latencies_ms);
+        platform_deinit();
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    int result;
+    BENCHMARK_OPTIONS options;
+
+    if (parse_options(argc, argv, &options) != 0)
+    {
+        print_usage(argv[0]);
+        result = 1;
+    }
+    else if (iothub_client_benchmark_run(&options) != 0)
+    {
+        result = 1;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
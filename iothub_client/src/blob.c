@@ -3,17 +3,753 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
 #include "blob.h"
 
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_client_crc64.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_BLOB
+#include "iothub_client_memory_tag.h"
 
 /*a block has 4MB*/
 #define BLOCK_SIZE (4*1024*1024)
+/*a block blob can include a maximum of 50,000 blocks*/
+#define MAX_BLOCK_COUNT 50000
+/*the first retry of a block waits this long, every next retry waits twice as long up to BLOCK_RETRY_MAX_DELAY_MS*/
+#define BLOCK_RETRY_DELAY_MS 1000
+#define BLOCK_RETRY_MAX_DELAY_MS 32000
+/*the blocks of source shrink down to this size while they need retries, so that a retry sends less again*/
+#define MIN_ADAPTIVE_BLOCK_SIZE (256*1024)
+/*the blocks of source grow back after this many blocks in a row put without a retry*/
+#define ADAPTIVE_BLOCK_GROW_AFTER 4
+/*x-ms-content-crc64 is taken by storage from this version on*/
+#define BLOCK_CRC64_STORAGE_VERSION "2019-02-02"
+/*the error code storage answers with a 400 when the CRC64 of a block does not match its content*/
+#define BLOCK_CRC64_MISMATCH_ERROR "Crc64Mismatch"
 
-BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* source, size_t size, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates)
+/*where the blocks uploaded one after the other come from: either the byte array source or getDataCallback*/
+typedef struct BLOCK_SOURCE_TAG
+{
+    const unsigned char* source;
+    size_t toUpload;
+    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback;
+    void* context;
+    unsigned int blockCount;
+    size_t blockSize; /*size of the next blocks of source*/
+    size_t blocksWithoutRetry; /*blocks of source put in a row without a retry*/
+} BLOCK_SOURCE;
+
+/*sets blockData and blockSize to the next block to upload, blockSize is 0 once all the blocks have been given*/
+static int getNextBlock(BLOCK_SOURCE* blockSource, const unsigned char** blockData, size_t* blockSize)
+{
+    int result;
+    if (blockSource->getDataCallback == NULL)
+    {
+        *blockSize = (blockSource->toUpload > blockSource->blockSize) ? blockSource->blockSize : blockSource->toUpload;
+        *blockData = blockSource->source;
+        blockSource->source += *blockSize;
+        blockSource->toUpload -= *blockSize;
+        if (*blockSize > 0)
+        {
+            blockSource->blockCount++;
+        }
+        result = 0;
+    }
+    else
+    {
+        unsigned char const* data = NULL;
+        size_t size = 0;
+        /*Codes_SRS_BLOB_41_008: [ Blob_UploadMultipleBlocksFromSasUri shall get every block by calling getDataCallback with FILE_UPLOAD_OK, a NULL data or a size of 0 meaning there are no more blocks. ]*/
+        blockSource->getDataCallback(FILE_UPLOAD_OK, &data, &size, blockSource->context);
+        if ((data == NULL) || (size == 0))
+        {
+            *blockData = NULL;
+            *blockSize = 0;
+            result = 0;
+        }
+        /*Codes_SRS_BLOB_41_009: [ If getDataCallback returns a block bigger than 4MB or more than 50000 blocks, Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+        else if (size > BLOCK_SIZE)
+        {
+            LogError("block of %zu bytes is bigger than %d bytes", size, BLOCK_SIZE);
+            result = __FAILURE__;
+        }
+        else if (blockSource->blockCount >= MAX_BLOCK_COUNT)
+        {
+            LogError("more than %d blocks", MAX_BLOCK_COUNT);
+            result = __FAILURE__;
+        }
+        else
+        {
+            *blockData = data;
+            *blockSize = size;
+            blockSource->blockCount++;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*sizes the next blocks of source from the retries the last block needed: smaller blocks on a lossy link make every retry cheaper,
+the blocks grow back to BLOCK_SIZE once the link behaves. The blocks never get so small that the rest of source needs more than MAX_BLOCK_COUNT blocks*/
+static void adaptBlockSize(BLOCK_SOURCE* blockSource, size_t retries)
+{
+    if (blockSource->getDataCallback == NULL)
+    {
+        size_t previousBlockSize = blockSource->blockSize;
+        if (retries > 0)
+        {
+            /*Codes_SRS_BLOB_41_012: [ When a block of source needed a retry, the next blocks of source shall be half as big, down to 256KB and never smaller than what fits the rest of source in the 50000 blocks. ]*/
+            size_t remainingBlocks = MAX_BLOCK_COUNT - blockSource->blockCount;
+            size_t smallestBlockSize = (remainingBlocks == 0) ? BLOCK_SIZE : (blockSource->toUpload + remainingBlocks - 1) / remainingBlocks;
+            if (smallestBlockSize < MIN_ADAPTIVE_BLOCK_SIZE)
+            {
+                smallestBlockSize = MIN_ADAPTIVE_BLOCK_SIZE;
+            }
+            blockSource->blockSize = (blockSource->blockSize / 2 < smallestBlockSize) ? smallestBlockSize : blockSource->blockSize / 2;
+            if (blockSource->blockSize > BLOCK_SIZE)
+            {
+                blockSource->blockSize = BLOCK_SIZE;
+            }
+            blockSource->blocksWithoutRetry = 0;
+        }
+        /*Codes_SRS_BLOB_41_013: [ After 4 blocks in a row put without a retry, the next blocks of source shall be twice as big, up to 4MB. ]*/
+        else if (++blockSource->blocksWithoutRetry >= ADAPTIVE_BLOCK_GROW_AFTER)
+        {
+            blockSource->blockSize = (blockSource->blockSize > BLOCK_SIZE / 2) ? BLOCK_SIZE : blockSource->blockSize * 2;
+            blockSource->blocksWithoutRetry = 0;
+        }
+
+        if (blockSource->blockSize != previousBlockSize)
+        {
+            LogInfo("blocks of the upload are now %lu bytes", (unsigned long)blockSource->blockSize);
+        }
+    }
+}
+
+/*what is told to the progress callback of an upload, progress.bytesSent and progress.blocksSent only grow*/
+typedef struct UPLOAD_PROGRESS_TAG
+{
+    IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK callback;
+    void* context;
+    TICK_COUNTER_HANDLE tickCounter;
+    tickcounter_ms_t startTime;
+    IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS progress;
+} UPLOAD_PROGRESS;
+
+static void initUploadProgress(UPLOAD_PROGRESS* uploadProgress, IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK callback, void* context, uint64_t totalBytes)
+{
+    uploadProgress->callback = callback;
+    uploadProgress->context = context;
+    uploadProgress->tickCounter = NULL;
+    uploadProgress->startTime = 0;
+    uploadProgress->progress.bytesSent = 0;
+    uploadProgress->progress.totalBytes = totalBytes;
+    uploadProgress->progress.blocksSent = 0;
+    uploadProgress->progress.retries = 0;
+    uploadProgress->progress.bytesPerSecond = 0;
+
+    if (callback != NULL)
+    {
+        /*without a tick counter the progress is still reported, with a bytesPerSecond of 0*/
+        if ((uploadProgress->tickCounter = tickcounter_create()) == NULL)
+        {
+            LogError("unable to tickcounter_create, the progress of the upload has no throughput");
+        }
+        else if (tickcounter_get_current_ms(uploadProgress->tickCounter, &uploadProgress->startTime) != 0)
+        {
+            LogError("unable to tickcounter_get_current_ms, the progress of the upload has no throughput");
+            tickcounter_destroy(uploadProgress->tickCounter);
+            uploadProgress->tickCounter = NULL;
+        }
+    }
+}
+
+static void deinitUploadProgress(UPLOAD_PROGRESS* uploadProgress)
+{
+    if (uploadProgress->tickCounter != NULL)
+    {
+        tickcounter_destroy(uploadProgress->tickCounter);
+    }
+}
+
+/*counts a block put in storage and tells the progress callback about it. Returns 0 to continue the upload, __FAILURE__ when the
+callback cancels it*/
+static int reportBlockUploaded(UPLOAD_PROGRESS* uploadProgress, size_t blockSize, size_t retries)
+{
+    int result;
+    if (uploadProgress->callback == NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        tickcounter_ms_t now;
+        uploadProgress->progress.bytesSent += blockSize;
+        uploadProgress->progress.blocksSent++;
+        uploadProgress->progress.retries += retries;
+        if ((uploadProgress->tickCounter != NULL) &&
+            (tickcounter_get_current_ms(uploadProgress->tickCounter, &now) == 0) &&
+            (now > uploadProgress->startTime))
+        {
+            uploadProgress->progress.bytesPerSecond = uploadProgress->progress.bytesSent * 1000 / (now - uploadProgress->startTime);
+        }
+
+        /*Codes_SRS_BLOB_41_014: [ If progressCallback is not NULL, it shall be called with progressContext after every block put in storage, with the bytes and blocks sent so far, the retries they needed, the throughput since the upload started and the size of source (0 for getDataCallback). ]*/
+        if (uploadProgress->callback(&uploadProgress->progress, uploadProgress->context) != 0)
+        {
+            /*Codes_SRS_BLOB_41_015: [ If progressCallback returns non-zero, the upload shall put no more blocks, shall not put the block list and shall return BLOB_ABORTED. ]*/
+            LogInfo("upload cancelled by the progress callback after %lu blocks", (unsigned long)uploadProgress->progress.blocksSent);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*shared by the threads uploading the blocks of one blob, the next block to upload and the first failure are guarded by lock*/
+typedef struct BLOCK_UPLOAD_CONTEXT_TAG
+{
+    LOCK_HANDLE lock;
+    const char* hostname;
+    const char* certificates;
+    const char* relativePath;
+    const unsigned char* source;
+    size_t size;
+    unsigned int blockCount;
+    unsigned int nextBlockID;
+    int isError;
+    BLOB_RESULT result;
+    unsigned int* httpStatus;
+    BUFFER_HANDLE httpResponse;
+    size_t blockRetryCount;
+    bool computeBlockCrc64;
+    UPLOAD_PROGRESS* uploadProgress;
+} BLOCK_UPLOAD_CONTEXT;
+
+/*a block ID is the base64 of the 6 characters "%6u" gives its number, so every block ID has BLOCK_ID_LENGTH characters*/
+#define BLOCK_ID_LENGTH 8
+#define BLOCK_LIST_XML_BEGIN "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"
+#define BLOCK_LIST_XML_END "</BlockList>"
+#define BLOCK_LIST_XML_LATEST_BEGIN "<Latest>"
+#define BLOCK_LIST_XML_LATEST_END "</Latest>"
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*writes the BLOCK_ID_LENGTH characters of the block ID of blockID and a '\0' to encoded, as Base64_Encode_Bytes would, without allocating*/
+static int encodeBlockId(unsigned int blockID, char* encoded)
+{
+    int result;
+    char temp[7]; /*this will contain 000000... 049999*/
+    /*Codes_SRS_BLOB_02_020: [ Blob_UploadFromSasUri shall construct a BASE64 encoded string from the block ID (000000... 0499999) ]*/
+    if (sprintf(temp, "%6u", blockID) != 6) /*produces 000000... 049999*/
+    {
+        LogError("failed to sprintf");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < 6; i += 3)
+        {
+            uint32_t triplet = ((uint32_t)(unsigned char)temp[i] << 16) | ((uint32_t)(unsigned char)temp[i + 1] << 8) | (uint32_t)(unsigned char)temp[i + 2];
+            *encoded++ = base64Alphabet[(triplet >> 18) & 0x3F];
+            *encoded++ = base64Alphabet[(triplet >> 12) & 0x3F];
+            *encoded++ = base64Alphabet[(triplet >> 6) & 0x3F];
+            *encoded++ = base64Alphabet[triplet & 0x3F];
+        }
+        *encoded = '\0';
+        result = 0;
+    }
+    return result;
+}
+
+/*the relative path of the requests of the blocks: the relative path of the SAS URI and "&comp=block", followed either by
+"&blockid=" and a block ID for a "Put Block" or by "list" for the "Put Block List". It is allocated once per upload and per block
+upload thread, only its end is written again from one request to the next*/
+typedef struct BLOCK_RELATIVE_PATH_TAG
+{
+    char* path;
+    size_t prefixLength;
+} BLOCK_RELATIVE_PATH;
+
+static int initBlockRelativePath(BLOCK_RELATIVE_PATH* blockRelativePath, const char* relativePath)
+{
+    int result;
+    size_t relativePathLength = strlen(relativePath);
+    blockRelativePath->prefixLength = relativePathLength + sizeof("&comp=block") - 1;
+    if ((blockRelativePath->path = (char*)malloc(blockRelativePath->prefixLength + sizeof("&blockid=") - 1 + BLOCK_ID_LENGTH + 1)) == NULL)
+    {
+        LogError("unable to malloc");
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(blockRelativePath->path, relativePath, relativePathLength);
+        (void)memcpy(blockRelativePath->path + relativePathLength, "&comp=block", sizeof("&comp=block") - 1);
+        blockRelativePath->path[blockRelativePath->prefixLength] = '\0';
+        result = 0;
+    }
+    return result;
+}
+
+static void deinitBlockRelativePath(BLOCK_RELATIVE_PATH* blockRelativePath)
+{
+    free(blockRelativePath->path);
+}
+
+/*returns the relative path of the "Put Block" of blockID, NULL on failure*/
+static const char* setBlockRelativePath(BLOCK_RELATIVE_PATH* blockRelativePath, unsigned int blockID)
+{
+    const char* result;
+    char* blockIdBegin = blockRelativePath->path + blockRelativePath->prefixLength + sizeof("&blockid=") - 1;
+    /*Codes_SRS_BLOB_02_022: [ Blob_UploadFromSasUri shall construct a new relativePath from following string: base relativePath + "&comp=block&blockid=BASE64 encoded string of blockId" ]*/
+    (void)memcpy(blockRelativePath->path + blockRelativePath->prefixLength, "&blockid=", sizeof("&blockid=") - 1);
+    if (encodeBlockId(blockID, blockIdBegin) != 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = blockRelativePath->path;
+    }
+    return result;
+}
+
+/*returns the relative path of the "Put Block List"*/
+static const char* setBlockListRelativePath(BLOCK_RELATIVE_PATH* blockRelativePath)
+{
+    /*Codes_SRS_BLOB_02_029: [Blob_UploadFromSasUri shall construct a new relativePath from following string : base relativePath + "&comp=blocklist"]*/
+    (void)memcpy(blockRelativePath->path + blockRelativePath->prefixLength, "list", sizeof("list"));
+    return blockRelativePath->path;
+}
+
+/*creates the content of the "Put Block List" of the blocks 0 to blockCount-1. The block IDs all have the same length, so the XML is
+written once in an allocation of its exact size*/
+static BUFFER_HANDLE createBlockListXml(unsigned int blockCount)
+{
+    BUFFER_HANDLE result;
+    size_t latestLength = sizeof(BLOCK_LIST_XML_LATEST_BEGIN) - 1 + BLOCK_ID_LENGTH + sizeof(BLOCK_LIST_XML_LATEST_END) - 1;
+    size_t xmlLength = sizeof(BLOCK_LIST_XML_BEGIN) - 1 + (size_t)blockCount * latestLength + sizeof(BLOCK_LIST_XML_END) - 1;
+    /*+1 because the last block ID is followed by a '\0'*/
+    char* xml = (char*)malloc(xmlLength + 1);
+    if (xml == NULL)
+    {
+        LogError("unable to malloc");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_BLOB_02_028: [ Blob_UploadFromSasUri shall construct an XML string with the following content: ]*/
+        char* current = xml;
+        unsigned int blockID;
+        (void)memcpy(current, BLOCK_LIST_XML_BEGIN, sizeof(BLOCK_LIST_XML_BEGIN) - 1);
+        current += sizeof(BLOCK_LIST_XML_BEGIN) - 1;
+        for (blockID = 0; blockID < blockCount; blockID++)
+        {
+            (void)memcpy(current, BLOCK_LIST_XML_LATEST_BEGIN, sizeof(BLOCK_LIST_XML_LATEST_BEGIN) - 1);
+            current += sizeof(BLOCK_LIST_XML_LATEST_BEGIN) - 1;
+            if (encodeBlockId(blockID, current) != 0)
+            {
+                break;
+            }
+            current += BLOCK_ID_LENGTH;
+            (void)memcpy(current, BLOCK_LIST_XML_LATEST_END, sizeof(BLOCK_LIST_XML_LATEST_END) - 1);
+            current += sizeof(BLOCK_LIST_XML_LATEST_END) - 1;
+        }
+
+        if (blockID < blockCount)
+        {
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(current, BLOCK_LIST_XML_END, sizeof(BLOCK_LIST_XML_END) - 1);
+            if ((result = BUFFER_create((const unsigned char*)xml, xmlLength)) == NULL)
+            {
+                LogError("unable to BUFFER_create");
+            }
+        }
+        free(xml);
+    }
+    return result;
+}
+
+/*creates the request headers of a "Put Block", NULL when the CRC64 of the blocks is not sent. Returns 0 on success*/
+static int createBlockHttpHeaders(bool computeBlockCrc64, const unsigned char* block, size_t blockSize, HTTP_HEADERS_HANDLE* requestHttpHeaders)
+{
+    int result;
+    if (!computeBlockCrc64)
+    {
+        *requestHttpHeaders = NULL;
+        result = 0;
+    }
+    else if ((*requestHttpHeaders = HTTPHeaders_Alloc()) == NULL)
+    {
+        LogError("unable to HTTPHeaders_Alloc");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_BLOB_41_016: [ If computeBlockCrc64 is true, every "Put Block" shall have the header x-ms-content-crc64 with the base64 of the CRC64 of the block (little endian) and the header x-ms-version 2019-02-02. ]*/
+        uint64_t crc64 = crc64_compute(0, block, blockSize);
+        unsigned char crc64Bytes[8];
+        STRING_HANDLE crc64String;
+        size_t i;
+        for (i = 0; i < sizeof(crc64Bytes); i++)
+        {
+            crc64Bytes[i] = (unsigned char)(crc64 >> (8 * i));
+        }
+
+        if ((crc64String = Base64_Encode_Bytes(crc64Bytes, sizeof(crc64Bytes))) == NULL)
+        {
+            LogError("unable to Base64_Encode_Bytes");
+            result = __FAILURE__;
+        }
+        else
+        {
+            if ((HTTPHeaders_AddHeaderNameValuePair(*requestHttpHeaders, "x-ms-version", BLOCK_CRC64_STORAGE_VERSION) != HTTP_HEADERS_OK) ||
+                (HTTPHeaders_AddHeaderNameValuePair(*requestHttpHeaders, "x-ms-content-crc64", STRING_c_str(crc64String)) != HTTP_HEADERS_OK))
+            {
+                LogError("unable to HTTPHeaders_AddHeaderNameValuePair");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            STRING_delete(crc64String);
+        }
+
+        if (result != 0)
+        {
+            HTTPHeaders_Free(*requestHttpHeaders);
+            *requestHttpHeaders = NULL;
+        }
+    }
+    return result;
+}
+
+/*tells whether storage refused a block because its content does not match the CRC64 sent with it*/
+static int isCrc64Mismatch(unsigned int blockHttpStatus, BUFFER_HANDLE blockHttpResponse)
+{
+    int result = 0;
+    if ((blockHttpStatus == 400) && (blockHttpResponse != NULL))
+    {
+        const unsigned char* body = BUFFER_u_char(blockHttpResponse);
+        size_t bodySize = BUFFER_length(blockHttpResponse);
+        size_t errorSize = sizeof(BLOCK_CRC64_MISMATCH_ERROR) - 1;
+        size_t i;
+        for (i = 0; (body != NULL) && (i + errorSize <= bodySize) && !result; i++)
+        {
+            result = (memcmp(body + i, BLOCK_CRC64_MISMATCH_ERROR, errorSize) == 0);
+        }
+    }
+    return result;
+}
+
+/*a block that did not reach storage or that storage could not take for now (timeout, throttling, server error) can be put again,
+so can a block whose content got corrupted on the way*/
+static int isRetriableBlockFailure(HTTPAPIEX_RESULT requestResult, unsigned int blockHttpStatus, HTTP_HEADERS_HANDLE requestHttpHeaders, BUFFER_HANDLE blockHttpResponse)
+{
+    return (requestResult != HTTPAPIEX_OK) || (blockHttpStatus == 408) || (blockHttpStatus == 429) || (blockHttpStatus >= 500) ||
+        ((requestHttpHeaders != NULL) && isCrc64Mismatch(blockHttpStatus, blockHttpResponse));
+}
+
+/*puts a block, putting it again up to blockRetryCount times. Storage keeps the last content put for a block ID, so a block is never
+duplicated and the blocks already uploaded are not sent again*/
+static HTTPAPIEX_RESULT putBlockContent(HTTPAPIEX_HANDLE httpApiExHandle, const char* blockRelativePath, HTTP_HEADERS_HANDLE requestHttpHeaders, BUFFER_HANDLE requestContent, unsigned int* blockHttpStatus, BUFFER_HANDLE blockHttpResponse, size_t blockRetryCount, size_t* retries)
+{
+    HTTPAPIEX_RESULT result;
+    size_t retry = 0;
+    unsigned int delay = BLOCK_RETRY_DELAY_MS;
+    while (
+        ((result = HTTPAPIEX_ExecuteRequest(httpApiExHandle, HTTPAPI_REQUEST_PUT, blockRelativePath, requestHttpHeaders, requestContent, blockHttpStatus, NULL, blockHttpResponse)) != HTTPAPIEX_OK || (*blockHttpStatus >= 300)) &&
+        (retry < blockRetryCount) &&
+        isRetriableBlockFailure(result, *blockHttpStatus, requestHttpHeaders, blockHttpResponse)
+        )
+    {
+        /*Codes_SRS_BLOB_41_010: [ If putting a block fails or storage answers 408, 429 or a 5xx status, the upload shall put the block again with the same block ID, up to blockRetryCount times, waiting 1 second before the first retry and twice as long before every next one, up to 32 seconds. ]*/
+        /*Codes_SRS_BLOB_41_017: [ If computeBlockCrc64 is true and storage answers 400 with the error Crc64Mismatch, the upload shall put the block again as for SRS_BLOB_41_010. ]*/
+        retry++;
+        LogInfo("block upload failed, putting it again in %u ms (retry %lu of %lu)", delay, (unsigned long)retry, (unsigned long)blockRetryCount);
+        ThreadAPI_Sleep(delay);
+        delay = (delay >= BLOCK_RETRY_MAX_DELAY_MS / 2) ? BLOCK_RETRY_MAX_DELAY_MS : delay * 2;
+    }
+    *retries = retry;
+    return result;
+}
+
+/*keeps only the first failure, the HTTP status and response are kept when storage refused the block (result is BLOB_OK)*/
+static void setBlockUploadFailure(BLOCK_UPLOAD_CONTEXT* context, BLOB_RESULT result, unsigned int blockHttpStatus, BUFFER_HANDLE blockHttpResponse)
+{
+    if (Lock(context->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        context->isError = 1;
+    }
+    else
+    {
+        if (!context->isError)
+        {
+            context->isError = 1;
+            context->result = result;
+            if (result == BLOB_OK)
+            {
+                *context->httpStatus = blockHttpStatus;
+                if ((context->httpResponse != NULL) &&
+                    (BUFFER_build(context->httpResponse, BUFFER_u_char(blockHttpResponse), BUFFER_length(blockHttpResponse)) != 0))
+                {
+                    LogError("unable to BUFFER_build");
+                }
+            }
+        }
+        (void)Unlock(context->lock);
+    }
+}
+
+static void putBlock(BLOCK_UPLOAD_CONTEXT* context, HTTPAPIEX_HANDLE httpApiExHandle, BLOCK_RELATIVE_PATH* blockRelativePath, unsigned int blockID, BUFFER_HANDLE blockHttpResponse)
+{
+    const char* relativePath = setBlockRelativePath(blockRelativePath, blockID);
+    if (relativePath == NULL)
+    {
+        setBlockUploadFailure(context, BLOB_ERROR, 0, NULL);
+    }
+    else
+    {
+        size_t offset = (size_t)blockID * BLOCK_SIZE;
+        size_t thisBlockSize = (context->size - offset > BLOCK_SIZE) ? BLOCK_SIZE : context->size - offset;
+        /*the copy of the block is all the memory a thread needs*/
+        BUFFER_HANDLE requestContent = BUFFER_create(context->source + offset, thisBlockSize);
+        HTTP_HEADERS_HANDLE requestHttpHeaders;
+        if (requestContent == NULL)
+        {
+            LogError("unable to BUFFER_create");
+            setBlockUploadFailure(context, BLOB_ERROR, 0, NULL);
+        }
+        else if (createBlockHttpHeaders(context->computeBlockCrc64, context->source + offset, thisBlockSize, &requestHttpHeaders) != 0)
+        {
+            setBlockUploadFailure(context, BLOB_ERROR, 0, NULL);
+            BUFFER_delete(requestContent);
+        }
+        else
+        {
+            unsigned int blockHttpStatus;
+            size_t retries;
+            if (putBlockContent(httpApiExHandle, relativePath, requestHttpHeaders, requestContent, &blockHttpStatus, blockHttpResponse, context->blockRetryCount, &retries) != HTTPAPIEX_OK)
+            {
+                LogError("unable to HTTPAPIEX_ExecuteRequest");
+                setBlockUploadFailure(context, BLOB_HTTP_ERROR, 0, NULL);
+            }
+            else if (blockHttpStatus >= 300)
+            {
+                LogError("HTTP status from storage does not indicate success (%d)", (int)blockHttpStatus);
+                setBlockUploadFailure(context, BLOB_OK, blockHttpStatus, blockHttpResponse);
+            }
+            else if (context->uploadProgress->callback != NULL)
+            {
+                /*the block is uploaded, the progress is reported under lock since every thread counts in it*/
+                if (Lock(context->lock) != LOCK_OK)
+                {
+                    LogError("unable to Lock");
+                    setBlockUploadFailure(context, BLOB_ERROR, 0, NULL);
+                }
+                else
+                {
+                    int isCancelled = reportBlockUploaded(context->uploadProgress, thisBlockSize, retries);
+                    (void)Unlock(context->lock);
+                    if (isCancelled)
+                    {
+                        setBlockUploadFailure(context, BLOB_ABORTED, 0, NULL);
+                    }
+                }
+            }
+            else
+            {
+                /*the block is uploaded*/
+            }
+            if (requestHttpHeaders != NULL)
+            {
+                HTTPHeaders_Free(requestHttpHeaders);
+            }
+            BUFFER_delete(requestContent);
+        }
+    }
+}
+
+/*takes the next block to upload until there are none left or a block failed*/
+static void uploadBlocks(BLOCK_UPLOAD_CONTEXT* context, HTTPAPIEX_HANDLE httpApiExHandle)
+{
+    BUFFER_HANDLE blockHttpResponse;
+    BLOCK_RELATIVE_PATH blockRelativePath;
+    if ((blockHttpResponse = BUFFER_new()) == NULL)
+    {
+        LogError("unable to BUFFER_new");
+        setBlockUploadFailure(context, BLOB_ERROR, 0, NULL);
+    }
+    else if (initBlockRelativePath(&blockRelativePath, context->relativePath) != 0)
+    {
+        setBlockUploadFailure(context, BLOB_ERROR, 0, NULL);
+        BUFFER_delete(blockHttpResponse);
+    }
+    else
+    {
+        int hasBlock;
+        do
+        {
+            unsigned int blockID = 0;
+            if (Lock(context->lock) != LOCK_OK)
+            {
+                LogError("unable to Lock");
+                context->isError = 1;
+                hasBlock = 0;
+            }
+            else
+            {
+                hasBlock = !context->isError && (context->nextBlockID < context->blockCount);
+                if (hasBlock)
+                {
+                    blockID = context->nextBlockID++;
+                }
+                (void)Unlock(context->lock);
+            }
+
+            if (hasBlock)
+            {
+                putBlock(context, httpApiExHandle, &blockRelativePath, blockID, blockHttpResponse);
+            }
+        } while (hasBlock);
+        deinitBlockRelativePath(&blockRelativePath);
+        BUFFER_delete(blockHttpResponse);
+    }
+}
+
+/*a block upload thread has its own connection to storage, when it cannot connect it leaves its blocks to the other threads*/
+static int blockUploadThread(void* arg)
+{
+    BLOCK_UPLOAD_CONTEXT* context = (BLOCK_UPLOAD_CONTEXT*)arg;
+    HTTPAPIEX_HANDLE httpApiExHandle = HTTPAPIEX_Create(context->hostname);
+    if (httpApiExHandle == NULL)
+    {
+        LogError("unable to create a HTTPAPIEX_HANDLE for a block upload thread");
+    }
+    else
+    {
+        if ((context->certificates != NULL) && (HTTPAPIEX_SetOption(httpApiExHandle, "TrustedCerts", context->certificates) == HTTPAPIEX_ERROR))
+        {
+            LogError("failure in setting trusted certificates for a block upload thread");
+        }
+        else
+        {
+            uploadBlocks(context, httpApiExHandle);
+        }
+        HTTPAPIEX_Destroy(httpApiExHandle);
+    }
+    return 0;
+}
+
+/*uploads the blocks on the calling thread and on up to blockUploadConcurrency-1 threads, the block IDs are 0 to *blockCount-1.
+Returns 0 when all the blocks have been uploaded*/
+static int uploadBlocksInParallel(HTTPAPIEX_HANDLE httpApiExHandle, const char* hostname, const char* certificates, const char* relativePath, const unsigned char* source, size_t size, size_t blockUploadConcurrency, size_t blockRetryCount, bool computeBlockCrc64, UPLOAD_PROGRESS* uploadProgress, unsigned int* blockCount, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, BLOB_RESULT* result)
+{
+    int isError;
+    BLOCK_UPLOAD_CONTEXT context;
+    size_t threadCount;
+    THREAD_HANDLE* threads;
+
+    context.hostname = hostname;
+    context.certificates = certificates;
+    context.relativePath = relativePath;
+    context.source = source;
+    context.size = size;
+    context.blockCount = (unsigned int)((size - 1) / BLOCK_SIZE + 1);
+    context.nextBlockID = 0;
+    context.isError = 0;
+    context.result = BLOB_ERROR;
+    context.httpStatus = httpStatus;
+    context.httpResponse = httpResponse;
+    context.blockRetryCount = blockRetryCount;
+    context.computeBlockCrc64 = computeBlockCrc64;
+    context.uploadProgress = uploadProgress;
+
+    threadCount = blockUploadConcurrency - 1;
+    if (threadCount > context.blockCount - 1)
+    {
+        threadCount = context.blockCount - 1;
+    }
+
+    if ((context.lock = Lock_Init()) == NULL)
+    {
+        LogError("unable to Lock_Init");
+        *result = BLOB_ERROR;
+        isError = 1;
+    }
+    else
+    {
+        if ((threads = (THREAD_HANDLE*)malloc(threadCount * sizeof(THREAD_HANDLE))) == NULL)
+        {
+            LogError("oom - out of memory");
+            *result = BLOB_ERROR;
+            isError = 1;
+        }
+        else
+        {
+            size_t startedThreads;
+            size_t i;
+
+            /*Codes_SRS_BLOB_41_003: [ If a thread cannot be started, Blob_UploadFromSasUri_Ex shall upload the blocks with the threads already started. ]*/
+            for (startedThreads = 0; startedThreads < threadCount; startedThreads++)
+            {
+                if (ThreadAPI_Create(&threads[startedThreads], blockUploadThread, &context) != THREADAPI_OK)
+                {
+                    LogError("unable to start a block upload thread, continuing with %lu threads", (unsigned long)startedThreads);
+                    break;
+                }
+            }
+
+            uploadBlocks(&context, httpApiExHandle);
+
+            for (i = 0; i < startedThreads; i++)
+            {
+                int threadResult;
+                if (ThreadAPI_Join(threads[i], &threadResult) != THREADAPI_OK)
+                {
+                    LogError("unable to ThreadAPI_Join");
+                }
+            }
+            free(threads);
+
+            if (context.isError)
+            {
+                /*Codes_SRS_BLOB_41_004: [ If a block fails, the threads shall stop taking blocks and Blob_UploadFromSasUri_Ex shall report the first failure as the sequential upload does. ]*/
+                *result = context.result;
+                isError = 1;
+            }
+            else
+            {
+                /*Codes_SRS_BLOB_41_005: [ Once all the blocks have been uploaded, Blob_UploadFromSasUri_Ex shall add their block IDs to the XML in block ID order. ]*/
+                *blockCount = context.blockCount;
+                isError = 0;
+            }
+        }
+        (void)Lock_Deinit(context.lock);
+    }
+
+    return isError;
+}
+
+/*uploads source or, when getDataCallback is not NULL, the blocks it returns*/
+static BLOB_RESULT uploadToSasUri(const char* SASURI, const unsigned char* source, size_t size, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, size_t blockUploadConcurrency, size_t blockRetryCount, IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK progressCallback, void* progressContext, bool computeBlockCrc64)
 {
     BLOB_RESULT result;
     /*Codes_SRS_BLOB_02_001: [ If SASURI is NULL then Blob_UploadFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
@@ -104,8 +840,10 @@ BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* sourc
                                 /*Codes_SRS_BLOB_02_008: [ Blob_UploadFromSasUri shall compute the relative path of the request from the SASURI parameter. ]*/
                                 /*Codes_SRS_BLOB_02_019: [ Blob_UploadFromSasUri shall compute the base relative path of the request from the SASURI parameter. ]*/
                                 const char* relativePath = hostnameEnd; /*this is where the relative path begins in the SasUri*/
+                                UPLOAD_PROGRESS uploadProgress;
+                                initUploadProgress(&uploadProgress, progressCallback, progressContext, size);
 
-                                if (size < 64 * 1024 * 1024) /*code path for sizes <64MB*/
+                                if ((getDataCallback == NULL) && (size < 64 * 1024 * 1024)) /*code path for sizes <64MB*/
                                 {
                                     /*Codes_SRS_BLOB_02_010: [ Blob_UploadFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
                                     BUFFER_HANDLE requestBuffer = BUFFER_create(source, size);
@@ -146,6 +884,11 @@ BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* sourc
                                                 {
                                                     /*Codes_SRS_BLOB_02_015: [ Otherwise, HTTPAPIEX_ExecuteRequest shall succeed and return BLOB_OK. ]*/
                                                     result = BLOB_OK;
+                                                    if (*httpStatus < 300)
+                                                    {
+                                                        /*the blob is already committed, there is nothing left to cancel*/
+                                                        (void)reportBlockUploaded(&uploadProgress, size, 0);
+                                                    }
                                                 }
                                             }
                                             HTTPHeaders_Free(requestHttpHeaders);
@@ -153,138 +896,127 @@ BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* sourc
                                         BUFFER_delete(requestBuffer);
                                     }
                                 }
-                                else /*code path for size >= 64MB*/
+                                else /*code path for size >= 64MB and for the blocks of getDataCallback*/
                                 {
-                                    size_t toUpload = size;
-                                    /*Codes_SRS_BLOB_02_028: [ Blob_UploadFromSasUri shall construct an XML string with the following content: ]*/
-                                    STRING_HANDLE xml = STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"); /*the XML "build as we go"*/
-                                    if (xml == NULL)
+                                    /*Codes_SRS_BLOB_41_019: [ The relative path of the "Put Block"s and of the "Put Block List" shall be allocated once per upload and per block upload thread, only the block ID being written again for every block. ]*/
+                                    BLOCK_RELATIVE_PATH blockRelativePath;
+                                    if (initBlockRelativePath(&blockRelativePath, relativePath) != 0)
                                     {
                                         /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                        LogError("failed to STRING_construct");
-                                        result = BLOB_HTTP_ERROR;
+                                        result = BLOB_ERROR;
                                     }
                                     else
                                     {
                                         /*Codes_SRS_BLOB_02_021: [ For every block of 4MB the following operations shall happen: ]*/
-                                        unsigned int blockID = 0;
+                                        unsigned int blockCount = 0;
                                         result = BLOB_ERROR;
 
                                         int isError = 0; /*used to cleanly exit the loop*/
-                                        do
+                                        if ((getDataCallback == NULL) && (blockUploadConcurrency > 1))
+                                        {
+                                            /*Codes_SRS_BLOB_41_002: [ If blockUploadConcurrency is bigger than 1, Blob_UploadFromSasUri_Ex shall upload the blocks from up to blockUploadConcurrency threads, each thread having its own HTTPAPIEX_HANDLE to the same hostname and certificates. ]*/
+                                            isError = uploadBlocksInParallel(httpApiExHandle, hostname, certificates, relativePath, source, size, blockUploadConcurrency, blockRetryCount, computeBlockCrc64, &uploadProgress, &blockCount, httpStatus, httpResponse, &result);
+                                        }
+                                        else
                                         {
-                                            /*setting this block size*/
-                                            size_t thisBlockSize = (toUpload > BLOCK_SIZE) ? BLOCK_SIZE : toUpload;
-                                            /*Codes_SRS_BLOB_02_020: [ Blob_UploadFromSasUri shall construct a BASE64 encoded string from the block ID (000000... 0499999) ]*/
-                                            char temp[7]; /*this will contain 000000... 049999*/
-                                            if (sprintf(temp, "%6u", (unsigned int)blockID) != 6) /*produces 000000... 049999*/
+                                            BLOCK_SOURCE blockSource;
+                                            const unsigned char* blockData;
+                                            size_t thisBlockSize;
+                                            blockSource.source = source;
+                                            blockSource.toUpload = size;
+                                            blockSource.getDataCallback = getDataCallback;
+                                            blockSource.context = context;
+                                            blockSource.blockCount = 0;
+                                            blockSource.blockSize = BLOCK_SIZE;
+                                            blockSource.blocksWithoutRetry = 0;
+
+                                            if (getNextBlock(&blockSource, &blockData, &thisBlockSize) != 0)
                                             {
-                                                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                LogError("failed to sprintf");
-                                                result = BLOB_ERROR;
+                                                result = BLOB_INVALID_ARG;
                                                 isError = 1;
                                             }
-                                            else
+
+                                            while (!isError && (thisBlockSize > 0))
                                             {
-                                                STRING_HANDLE blockIdString = Base64_Encode_Bytes((const unsigned char*)temp, 6);
-                                                if (blockIdString == NULL)
+                                                const char* blockPath = setBlockRelativePath(&blockRelativePath, blockCount);
+                                                if (blockPath == NULL)
                                                 {
                                                     /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                    LogError("unable to Base64_Encode_Bytes");
                                                     result = BLOB_ERROR;
                                                     isError = 1;
                                                 }
                                                 else
                                                 {
-                                                    /*add the blockId base64 encoded to the XML*/
-                                                    if (!(
-                                                        (STRING_concat(xml, "<Latest>") == 0) &&
-                                                        (STRING_concat_with_STRING(xml, blockIdString) == 0) &&
-                                                        (STRING_concat(xml, "</Latest>") == 0)
-                                                        ))
+                                                    /*Codes_SRS_BLOB_02_023: [ Blob_UploadFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
+                                                    BUFFER_HANDLE requestContent = BUFFER_create(blockData, thisBlockSize);
+                                                    HTTP_HEADERS_HANDLE requestHttpHeaders;
+                                                    if (requestContent == NULL)
                                                     {
                                                         /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                        LogError("unable to STRING_concat");
+                                                        LogError("unable to BUFFER_create");
                                                         result = BLOB_ERROR;
                                                         isError = 1;
                                                     }
+                                                    else if (createBlockHttpHeaders(computeBlockCrc64, blockData, thisBlockSize, &requestHttpHeaders) != 0)
+                                                    {
+                                                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+                                                        result = BLOB_ERROR;
+                                                        isError = 1;
+                                                        BUFFER_delete(requestContent);
+                                                    }
                                                     else
                                                     {
-                                                        /*Codes_SRS_BLOB_02_022: [ Blob_UploadFromSasUri shall construct a new relativePath from following string: base relativePath + "&comp=block&blockid=BASE64 encoded string of blockId" ]*/
-                                                        STRING_HANDLE newRelativePath = STRING_construct(relativePath);
-                                                        if (newRelativePath == NULL)
+                                                        size_t retries;
+                                                        /*Codes_SRS_BLOB_02_024: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
+                                                        if (putBlockContent(
+                                                            httpApiExHandle,
+                                                            blockPath,
+                                                            requestHttpHeaders,
+                                                            requestContent,
+                                                            httpStatus,
+                                                            httpResponse,
+                                                            blockRetryCount,
+                                                            &retries) != HTTPAPIEX_OK
+                                                            )
                                                         {
-                                                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                            LogError("unable to STRING_construct");
-                                                            result = BLOB_ERROR;
+                                                            /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
+                                                            LogError("unable to HTTPAPIEX_ExecuteRequest");
+                                                            result = BLOB_HTTP_ERROR;
+                                                            isError = 1;
+                                                        }
+                                                        else if (*httpStatus >= 300)
+                                                        {
+                                                            /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
+                                                            LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
+                                                            result = BLOB_OK;
                                                             isError = 1;
                                                         }
                                                         else
                                                         {
-                                                            if (!(
-                                                                (STRING_concat(newRelativePath, "&comp=block&blockid=") == 0) &&
-                                                                (STRING_concat_with_STRING(newRelativePath, blockIdString) == 0)
-                                                                ))
+                                                            /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadFromSasUri shall continue execution. ]*/
+                                                            adaptBlockSize(&blockSource, retries);
+                                                            if (reportBlockUploaded(&uploadProgress, thisBlockSize, retries) != 0)
                                                             {
-                                                                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                                LogError("unable to STRING concatenate");
-                                                                result = BLOB_ERROR;
+                                                                result = BLOB_ABORTED;
                                                                 isError = 1;
                                                             }
-                                                            else
-                                                            {
-                                                                /*Codes_SRS_BLOB_02_023: [ Blob_UploadFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
-                                                                BUFFER_HANDLE requestContent = BUFFER_create(source + (size - toUpload), thisBlockSize);
-                                                                if (requestContent == NULL)
-                                                                {
-                                                                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                                    LogError("unable to BUFFER_create");
-                                                                    result = BLOB_ERROR;
-                                                                    isError = 1;
-                                                                }
-                                                                else
-                                                                {
-                                                                    /*Codes_SRS_BLOB_02_024: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
-                                                                    if (HTTPAPIEX_ExecuteRequest(
-                                                                        httpApiExHandle,
-                                                                        HTTPAPI_REQUEST_PUT,
-                                                                        STRING_c_str(newRelativePath),
-                                                                        NULL,
-                                                                        requestContent,
-                                                                        httpStatus,
-                                                                        NULL,
-                                                                        httpResponse) != HTTPAPIEX_OK
-                                                                        )
-                                                                    {
-                                                                        /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
-                                                                        LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                                                        result = BLOB_HTTP_ERROR;
-                                                                        isError = 1;
-                                                                    }
-                                                                    else if (*httpStatus >= 300)
-                                                                    {
-                                                                        /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
-                                                                        LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
-                                                                        result = BLOB_OK;
-                                                                        isError = 1;
-                                                                    }
-                                                                    else
-                                                                    {
-                                                                        /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadFromSasUri shall continue execution. ]*/
-                                                                    }
-                                                                    BUFFER_delete(requestContent);
-                                                                }
-                                                            }
-                                                            STRING_delete(newRelativePath);
                                                         }
+                                                        if (requestHttpHeaders != NULL)
+                                                        {
+                                                            HTTPHeaders_Free(requestHttpHeaders);
+                                                        }
+                                                        BUFFER_delete(requestContent);
                                                     }
-                                                    STRING_delete(blockIdString);
                                                 }
-                                            }
 
-                                            blockID++;
-                                            toUpload -= thisBlockSize;
-                                        } while ((toUpload > 0) && !isError);
+                                                blockCount++;
+                                                if (!isError && (getNextBlock(&blockSource, &blockData, &thisBlockSize) != 0))
+                                                {
+                                                    result = BLOB_INVALID_ARG;
+                                                    isError = 1;
+                                                }
+                                            }
+                                        }
 
                                         if (isError)
                                         {
@@ -292,74 +1024,44 @@ BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* sourc
                                         }
                                         else
                                         {
-                                            /*complete the XML*/
-                                            if (STRING_concat(xml, "</BlockList>") != 0)
+                                            /*Codes_SRS_BLOB_41_020: [ Once all the blocks have been put, the XML of the "Put Block List" shall be written in a single allocation of its exact size. ]*/
+                                            BUFFER_HANDLE xmlAsBuffer = createBlockListXml(blockCount);
+                                            if (xmlAsBuffer == NULL)
                                             {
                                                 /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                LogError("failed to STRING_concat");
                                                 result = BLOB_ERROR;
                                             }
                                             else
                                             {
-                                                /*Codes_SRS_BLOB_02_029: [Blob_UploadFromSasUri shall construct a new relativePath from following string : base relativePath + "&comp=blocklist"]*/
-                                                STRING_HANDLE newRelativePath = STRING_construct(relativePath);
-                                                if (newRelativePath == NULL)
+                                                /*Codes_SRS_BLOB_02_030: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing the new relativePath, httpStatus and httpResponse and the XML string as content. ]*/
+                                                /*Codes_SRS_BLOB_41_021: [ The "Put Block"s of the calling thread and the "Put Block List" shall be executed on the same HTTPAPIEX_HANDLE, which keeps its connection to storage from one request to the next. ]*/
+                                                if (HTTPAPIEX_ExecuteRequest(
+                                                    httpApiExHandle,
+                                                    HTTPAPI_REQUEST_PUT,
+                                                    setBlockListRelativePath(&blockRelativePath),
+                                                    NULL,
+                                                    xmlAsBuffer,
+                                                    httpStatus,
+                                                    NULL,
+                                                    httpResponse
+                                                ) != HTTPAPIEX_OK)
                                                 {
-                                                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                    LogError("failed to STRING_construct");
-                                                    result = BLOB_ERROR;
+                                                    /*Codes_SRS_BLOB_02_031: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
+                                                    LogError("unable to HTTPAPIEX_ExecuteRequest");
+                                                    result = BLOB_HTTP_ERROR;
                                                 }
                                                 else
                                                 {
-                                                    if (STRING_concat(newRelativePath, "&comp=blocklist") != 0)
-                                                    {
-                                                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                        LogError("failed to STRING_concat");
-                                                        result = BLOB_ERROR;
-                                                    }
-                                                    else
-                                                    {
-                                                        /*Codes_SRS_BLOB_02_030: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing the new relativePath, httpStatus and httpResponse and the XML string as content. ]*/
-                                                        const char* s = STRING_c_str(xml);
-                                                        BUFFER_HANDLE xmlAsBuffer = BUFFER_create((const unsigned char*)s, strlen(s));
-                                                        if (xmlAsBuffer == NULL)
-                                                        {
-                                                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                            LogError("failed to BUFFER_create");
-                                                            result = BLOB_ERROR;
-                                                        }
-                                                        else
-                                                        {
-                                                            if (HTTPAPIEX_ExecuteRequest(
-                                                                httpApiExHandle,
-                                                                HTTPAPI_REQUEST_PUT,
-                                                                STRING_c_str(newRelativePath),
-                                                                NULL,
-                                                                xmlAsBuffer,
-                                                                httpStatus,
-                                                                NULL,
-                                                                httpResponse
-                                                            ) != HTTPAPIEX_OK)
-                                                            {
-                                                                /*Codes_SRS_BLOB_02_031: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
-                                                                LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                                                result = BLOB_HTTP_ERROR;
-                                                            }
-                                                            else
-                                                            {
-                                                                /*Codes_SRS_BLOB_02_032: [ Otherwise, Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
-                                                                result = BLOB_OK;
-                                                            }
-                                                            BUFFER_delete(xmlAsBuffer);
-                                                        }
-                                                    }
-                                                    STRING_delete(newRelativePath);
+                                                    /*Codes_SRS_BLOB_02_032: [ Otherwise, Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
+                                                    result = BLOB_OK;
                                                 }
+                                                BUFFER_delete(xmlAsBuffer);
                                             }
                                         }
-                                        STRING_delete(xml);
+                                        deinitBlockRelativePath(&blockRelativePath);
                                     }
                                 }
+                                deinitUploadProgress(&uploadProgress);
                             }
                             HTTPAPIEX_Destroy(httpApiExHandle);
                         }
@@ -371,3 +1073,33 @@ BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* sourc
     }
     return result;
 }
+
+BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* source, size_t size, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates)
+{
+    /*Codes_SRS_BLOB_41_001: [ Blob_UploadFromSasUri shall call Blob_UploadFromSasUri_Ex with a blockUploadConcurrency of 1. ]*/
+    /*Codes_SRS_BLOB_41_011: [ Blob_UploadFromSasUri shall not retry the blocks. ]*/
+    /*Codes_SRS_BLOB_41_018: [ Blob_UploadFromSasUri shall not send the CRC64 of the blocks. ]*/
+    return Blob_UploadFromSasUri_Ex(SASURI, source, size, httpStatus, httpResponse, certificates, 1, 0, NULL, NULL, false);
+}
+
+BLOB_RESULT Blob_UploadFromSasUri_Ex(const char* SASURI, const unsigned char* source, size_t size, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, size_t blockUploadConcurrency, size_t blockRetryCount, IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK progressCallback, void* progressContext, bool computeBlockCrc64)
+{
+    return uploadToSasUri(SASURI, source, size, NULL, NULL, httpStatus, httpResponse, certificates, blockUploadConcurrency, blockRetryCount, progressCallback, progressContext, computeBlockCrc64);
+}
+
+BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, size_t blockRetryCount, IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK progressCallback, void* progressContext, bool computeBlockCrc64)
+{
+    BLOB_RESULT result;
+    /*Codes_SRS_BLOB_41_006: [ If SASURI or getDataCallback is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+    if ((SASURI == NULL) || (getDataCallback == NULL))
+    {
+        LogError("invalid argument SASURI=%p, getDataCallback=%p", SASURI, getDataCallback);
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_BLOB_41_007: [ Blob_UploadMultipleBlocksFromSasUri shall upload every block with a "Put Block" and commit them with a "Put Block List", whatever the size of the blob. ]*/
+        result = uploadToSasUri(SASURI, NULL, 0, getDataCallback, context, httpStatus, httpResponse, certificates, 1, blockRetryCount, progressCallback, progressContext, computeBlockCrc64);
+    }
+    return result;
+}
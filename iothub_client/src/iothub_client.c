@@ -7,43 +7,99 @@
 
 #include <signal.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothub_client.h"
 #include "iothub_client_ll.h"
 #include "iothub_client_private.h"
+#include "iothub_client_options.h"
 #include "iothubtransport.h"
+#include "iothub_client_worker_pool.h"
+#include "iothub_client_ingress_queue.h"
+#include "iothub_client_thread_attributes.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
 struct IOTHUB_QUEUE_CONTEXT_TAG;
+struct SEND_INGRESS_ITEM_TAG;
+
+#define DEFAULT_WORKER_MAX_IDLE_TIME_MS 100
+/*an idle upload worker looks at the waiting uploads this often, queuing an upload schedules the workers right away anyway*/
+#define UPLOAD_WORKER_IDLE_TIME_MS 1000
 
 typedef struct IOTHUB_CLIENT_INSTANCE_TAG
 {
     IOTHUB_CLIENT_LL_HANDLE IoTHubClientLLHandle;
+#ifndef DONT_USE_MULTIPLEXING
     TRANSPORT_HANDLE TransportHandle;
+#endif
     THREAD_HANDLE ThreadHandle;
     LOCK_HANDLE LockHandle;
     sig_atomic_t StopThread;
+    COND_HANDLE WorkCondition; /*only created when the event driven worker mode is enabled*/
+    int event_driven_worker;
+    int work_pending;
+    unsigned int worker_max_idle_time;
+    WORKER_POOL_ITEM_HANDLE WorkerPoolItem; /*only used when the process wide worker pool is initialized*/
+    int connection_admitted; /*set once the connection ramp of the worker pool, if any, let the client connect*/
+    COND_HANDLE SendQueueCondition; /*only created when the send queue full policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK*/
+    TICK_COUNTER_HANDLE SendQueueTickCounter;
+    IOTHUB_CLIENT_SEND_QUEUE_FULL_POLICY send_queue_full_policy;
+    unsigned int send_queue_block_timeout;
+    size_t blocked_senders;
+    IOTHUB_CLIENT_SEND_QUEUE_WATERMARK_CALLBACK send_queue_watermark_callback;
+    void* send_queue_watermark_user_context;
+    THREAD_HANDLE CallbackDispatchThreadHandle; /*only created when OPTION_CALLBACK_DISPATCH_QUEUE_SIZE is set*/
+    COND_HANDLE CallbackDispatchCondition;
+    sig_atomic_t StopCallbackDispatchThread;
+    VECTOR_HANDLE callback_dispatch_queue;
+    size_t callback_dispatch_in_flight;
+    size_t callback_dispatch_queue_size;
+    size_t inbound_callback_limit; /*0 while the message and method callbacks are queued without limit*/
+    int receive_paused_by_application;
+    int receive_paused_by_limit;
+    int receive_paused; /*what IoTHubClient_LL_PauseReceive and IoTHubClient_LL_ResumeReceive last did*/
+    int has_thread_attributes; /*set by OPTION_THREAD_ATTRIBUTES, the threads of the client apply thread_attributes as they start*/
+    IOTHUB_CLIENT_THREAD_ATTRIBUTES thread_attributes;
+    char* thread_name; /*the copy thread_attributes.name points to*/
+    INGRESS_QUEUE_HANDLE send_ingress_queue; /*only created when OPTION_SEND_INGRESS_QUEUE is set*/
+    struct SEND_INGRESS_ITEM_TAG* send_ingress_pending; /*taken from the ingress queue, waiting for room in the send queue*/
 #ifndef DONT_USE_UPLOADTOBLOB
     SINGLYLINKEDLIST_HANDLE savedDataToBeCleaned; /*list containing UPLOADTOBLOB_SAVED_DATA*/
+    WORKER_POOL_HANDLE uploadWorkerPool; /*only created when OPTION_BLOB_UPLOAD_WORKERS is set, runs the uploads instead of a thread per upload*/
+    WORKER_POOL_ITEM_HANDLE* uploadWorkerItems; /*one item per thread of uploadWorkerPool, so that every thread can run an upload*/
+    size_t uploadWorkerCount;
+    LOCK_HANDLE uploadQueueLock;
+    SINGLYLINKEDLIST_HANDLE pendingUploads; /*list containing the UPLOADTOBLOB_SAVED_DATA waiting for an upload worker*/
 #endif
     int created_with_transport_handle;
     VECTOR_HANDLE saved_user_callback_list;
+#ifndef DONT_USE_DEVICE_TWIN
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK desired_state_callback;
-    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK event_confirm_callback;
+    IOTHUB_CLIENT_DEVICE_TWIN_PAYLOAD_CALLBACK desired_state_payload_callback;
     IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback;
+    struct IOTHUB_QUEUE_CONTEXT_TAG* devicetwin_user_context;
+#endif
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK event_confirm_callback;
     IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connection_status_callback;
+#ifndef DONT_USE_DEVICE_METHODS
     IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback;
     IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inbound_device_method_callback;
+    struct IOTHUB_QUEUE_CONTEXT_TAG* method_user_context;
+#endif
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC message_callback;
-    struct IOTHUB_QUEUE_CONTEXT_TAG* devicetwin_user_context;
     struct IOTHUB_QUEUE_CONTEXT_TAG* connection_status_user_context;
     struct IOTHUB_QUEUE_CONTEXT_TAG* message_user_context;
-    struct IOTHUB_QUEUE_CONTEXT_TAG* method_user_context;
 } IOTHUB_CLIENT_INSTANCE;
 
 #ifndef DONT_USE_UPLOADTOBLOB
@@ -53,11 +109,14 @@ typedef struct UPLOADTOBLOB_SAVED_DATA_TAG
     size_t size;
     char* destinationFileName;
     IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK iotHubClientFileUploadCallback;
+    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback; /*when not NULL, the blocks of the file come from it instead of source*/
+    const char* filePath; /*when not NULL, the blocks of the file are read from this local file. Shares the allocation of destinationFileName*/
     void* context;
-    THREAD_HANDLE uploadingThreadHandle;
+    THREAD_HANDLE uploadingThreadHandle; /*NULL when an upload worker runs the upload*/
     IOTHUB_CLIENT_HANDLE iotHubClientHandle;
     LOCK_HANDLE lockGarbage;
     int canBeGarbageCollected; /*flag indicating that the UPLOADTOBLOB_SAVED_DATA structure can be freed because the thread deadling with it finished*/
+    int runsOnOwnThread; /*0 when an upload worker runs the upload, the thread then is not the upload's to change*/
 }UPLOADTOBLOB_SAVED_DATA;
 #endif
 
@@ -68,27 +127,32 @@ typedef struct UPLOADTOBLOB_SAVED_DATA_TAG
     CALLBACK_TYPE_CONNECTION_STATUS,    \
     CALLBACK_TYPE_DEVICE_METHOD,        \
     CALLBACK_TYPE_INBOUD_DEVICE_METHOD, \
-    CALLBACK_TYPE_MESSAGE
+    CALLBACK_TYPE_MESSAGE,              \
+    CALLBACK_TYPE_SEND_QUEUE_WATERMARK
 
 DEFINE_ENUM(USER_CALLBACK_TYPE, USER_CALLBACK_TYPE_VALUES)
 DEFINE_ENUM_STRINGS(USER_CALLBACK_TYPE, USER_CALLBACK_TYPE_VALUES)
 
+#ifndef DONT_USE_DEVICE_TWIN
 typedef struct DEVICE_TWIN_CALLBACK_INFO_TAG
 {
     DEVICE_TWIN_UPDATE_STATE update_state;
     unsigned char* payLoad;
     size_t size;
 } DEVICE_TWIN_CALLBACK_INFO;
+#endif
 
 typedef struct EVENT_CONFIRM_CALLBACK_INFO_TAG
 {
     IOTHUB_CLIENT_CONFIRMATION_RESULT confirm_result;
 } EVENT_CONFIRM_CALLBACK_INFO;
 
+#ifndef DONT_USE_DEVICE_TWIN
 typedef struct REPORTED_STATE_CALLBACK_INFO_TAG
 {
     int status_code;
 } REPORTED_STATE_CALLBACK_INFO;
+#endif
 
 typedef struct CONNECTION_STATUS_CALLBACK_INFO_TAG
 {
@@ -96,12 +160,23 @@ typedef struct CONNECTION_STATUS_CALLBACK_INFO_TAG
     IOTHUB_CLIENT_CONNECTION_STATUS_REASON status_reason;
 } CONNECTION_STATUS_CALLBACK_INFO;
 
+typedef struct SEND_QUEUE_WATERMARK_CALLBACK_INFO_TAG
+{
+    IOTHUB_CLIENT_SEND_QUEUE_WATERMARK watermark;
+    size_t message_count;
+    size_t byte_count;
+} SEND_QUEUE_WATERMARK_CALLBACK_INFO;
+
+#ifndef DONT_USE_DEVICE_METHODS
+/*method_name and payload are one allocation, the payload following the terminator of the name*/
 typedef struct METHOD_CALLBACK_INFO_TAG
 {
-    STRING_HANDLE method_name;
-    BUFFER_HANDLE payload;
+    char* method_name;
+    unsigned char* payload;
+    size_t size;
     METHOD_HANDLE method_id;
 } METHOD_CALLBACK_INFO;
+#endif
 
 typedef struct USER_CALLBACK_INFO_TAG
 {
@@ -109,12 +184,17 @@ typedef struct USER_CALLBACK_INFO_TAG
     void* userContextCallback;
     union IOTHUB_CALLBACK
     {
+#ifndef DONT_USE_DEVICE_TWIN
         DEVICE_TWIN_CALLBACK_INFO dev_twin_cb_info;
-        EVENT_CONFIRM_CALLBACK_INFO event_confirm_cb_info;
         REPORTED_STATE_CALLBACK_INFO reported_state_cb_info;
+#endif
+        EVENT_CONFIRM_CALLBACK_INFO event_confirm_cb_info;
         CONNECTION_STATUS_CALLBACK_INFO connection_status_cb_info;
+#ifndef DONT_USE_DEVICE_METHODS
         METHOD_CALLBACK_INFO method_cb_info;
+#endif
         MESSAGE_CALLBACK_INFO* message_cb_info;
+        SEND_QUEUE_WATERMARK_CALLBACK_INFO send_queue_watermark_cb_info;
     } iothub_callback;
 } USER_CALLBACK_INFO;
 
@@ -124,6 +204,19 @@ typedef struct IOTHUB_QUEUE_CONTEXT_TAG
     void* userContextCallback;
 } IOTHUB_QUEUE_CONTEXT;
 
+/*a message pushed on the ingress queue by IoTHubClient_SendEventAsync, the item owns the message*/
+typedef struct SEND_INGRESS_ITEM_TAG
+{
+    IOTHUB_MESSAGE_HANDLE message;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    void* userContextCallback;
+} SEND_INGRESS_ITEM;
+
+/*process wide worker pool, created by IoTHubClient_WorkerPool_Init*/
+static WORKER_POOL_HANDLE g_worker_pool = NULL;
+/*not owned, set by IoTHubClient_WorkerPool_SetConnectionRamp*/
+static CONNECTION_RAMP_HANDLE g_connection_ramp = NULL;
+
 /*used by unittests only*/
 const size_t IoTHubClient_ThreadTerminationOffset = offsetof(IOTHUB_CLIENT_INSTANCE, StopThread);
 
@@ -149,7 +242,8 @@ static void garbageCollectorImpl(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
             if (savedData->canBeGarbageCollected == 1)
             {
                 int notUsed;
-                if (ThreadAPI_Join(savedData->uploadingThreadHandle, &notUsed) != THREADAPI_OK)
+                if ((savedData->uploadingThreadHandle != NULL) &&
+                    (ThreadAPI_Join(savedData->uploadingThreadHandle, &notUsed) != THREADAPI_OK))
                 {
                     LogError("unable to ThreadAPI_Join");
                 }
@@ -174,7 +268,245 @@ static void garbageCollectorImpl(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
         }
     }
 }
+
+static int uploadingThread(void *data);
+
+static UPLOADTOBLOB_SAVED_DATA* takePendingUpload(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    UPLOADTOBLOB_SAVED_DATA* result;
+    if (Lock(iotHubClientInstance->uploadQueueLock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        result = NULL;
+    }
+    else
+    {
+        LIST_ITEM_HANDLE item = singlylinkedlist_get_head_item(iotHubClientInstance->pendingUploads);
+        if (item == NULL)
+        {
+            result = NULL;
+        }
+        else
+        {
+            result = (UPLOADTOBLOB_SAVED_DATA*)singlylinkedlist_item_get_value(item);
+            (void)singlylinkedlist_remove(iotHubClientInstance->pendingUploads, item);
+        }
+        (void)Unlock(iotHubClientInstance->uploadQueueLock);
+    }
+    return result;
+}
+
+/*work function of the upload workers, a thread of the pool is reused from one upload to the next*/
+static unsigned int uploadWorker(void* work_context)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)work_context;
+    UPLOADTOBLOB_SAVED_DATA* savedData;
+
+    /*Codes_SRS_IOTHUBCLIENT_41_071: [ An upload worker shall take the waiting uploads one at a time, in the order they were queued, and upload each of them as the uploading thread does. ]*/
+    while ((savedData = takePendingUpload(iotHubClientInstance)) != NULL)
+    {
+        (void)uploadingThread(savedData);
+    }
+
+    return UPLOAD_WORKER_IDLE_TIME_MS;
+}
+
+static int queuePendingUpload(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, UPLOADTOBLOB_SAVED_DATA* savedData)
+{
+    int result;
+    if (Lock(iotHubClientInstance->uploadQueueLock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (singlylinkedlist_add(iotHubClientInstance->pendingUploads, savedData) == NULL)
+        {
+            LogError("unable to singlylinkedlist_add");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        (void)Unlock(iotHubClientInstance->uploadQueueLock);
+
+        if (result == 0)
+        {
+            size_t i;
+            /*every worker is scheduled, the idle ones race for the upload and a busy one looks again once its upload is done*/
+            for (i = 0; i < iotHubClientInstance->uploadWorkerCount; i++)
+            {
+                if (worker_pool_schedule(iotHubClientInstance->uploadWorkerItems[i]) != 0)
+                {
+                    LogError("unable to worker_pool_schedule upload worker %lu", (unsigned long)i);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+/*tells the uploads that no worker took that they failed, the structures are then freed by garbageCollectorImpl*/
+static void failPendingUploads(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    UPLOADTOBLOB_SAVED_DATA* savedData;
+    while ((savedData = takePendingUpload(iotHubClientInstance)) != NULL)
+    {
+        if (savedData->getDataCallback != NULL)
+        {
+            savedData->getDataCallback(FILE_UPLOAD_ERROR, NULL, NULL, savedData->context);
+        }
+        else if (savedData->iotHubClientFileUploadCallback != NULL)
+        {
+            savedData->iotHubClientFileUploadCallback(FILE_UPLOAD_ERROR, savedData->context);
+        }
+
+        if (Lock(savedData->lockGarbage) != LOCK_OK)
+        {
+            LogError("unable to Lock - trying anyway");
+            savedData->canBeGarbageCollected = 1;
+        }
+        else
+        {
+            savedData->canBeGarbageCollected = 1;
+            (void)Unlock(savedData->lockGarbage);
+        }
+    }
+}
+
+/*stops the upload workers and frees what set_blob_upload_workers created, the uploads running are waited for*/
+static void destroy_blob_upload_workers(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->uploadWorkerPool != NULL)
+    {
+        /*the items not removed are freed by the pool*/
+        worker_pool_destroy(iotHubClientInstance->uploadWorkerPool);
+        iotHubClientInstance->uploadWorkerPool = NULL;
+    }
+    if (iotHubClientInstance->uploadWorkerItems != NULL)
+    {
+        free(iotHubClientInstance->uploadWorkerItems);
+        iotHubClientInstance->uploadWorkerItems = NULL;
+    }
+    if (iotHubClientInstance->pendingUploads != NULL)
+    {
+        singlylinkedlist_destroy(iotHubClientInstance->pendingUploads);
+        iotHubClientInstance->pendingUploads = NULL;
+    }
+    if (iotHubClientInstance->uploadQueueLock != NULL)
+    {
+        (void)Lock_Deinit(iotHubClientInstance->uploadQueueLock);
+        iotHubClientInstance->uploadQueueLock = NULL;
+    }
+    iotHubClientInstance->uploadWorkerCount = 0;
+}
+
+/*this function is called with the lock taken*/
+static IOTHUB_CLIENT_RESULT set_blob_upload_workers(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, size_t workerCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (workerCount == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_067: [ If optionName is OPTION_BLOB_UPLOAD_WORKERS and the value pointed to by value is 0 then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("invalid blob upload worker count (0)");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (iotHubClientInstance->uploadWorkerPool != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_068: [ If optionName is OPTION_BLOB_UPLOAD_WORKERS and the upload workers are already started then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("the blob upload workers are already started");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_069: [ Otherwise IoTHubClient_SetOption shall create the queue of the waiting uploads, a worker pool of workerCount threads with one upload worker per thread, and turn on OPTION_BLOB_UPLOAD_KEEP_CONNECTION so that the workers reuse the connection to IoT Hub, and fail with IOTHUB_CLIENT_ERROR if any of that fails. ]*/
+        bool keepConnection = true;
+        size_t i;
+
+        if ((workerCount > SIZE_MAX / sizeof(WORKER_POOL_ITEM_HANDLE)) ||
+            ((iotHubClientInstance->uploadWorkerItems = (WORKER_POOL_ITEM_HANDLE*)malloc(workerCount * sizeof(WORKER_POOL_ITEM_HANDLE))) == NULL))
+        {
+            LogError("unable to malloc %lu upload workers", (unsigned long)workerCount);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((iotHubClientInstance->uploadQueueLock = Lock_Init()) == NULL)
+        {
+            LogError("unable to Lock_Init");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((iotHubClientInstance->pendingUploads = singlylinkedlist_create()) == NULL)
+        {
+            LogError("unable to singlylinkedlist_create");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((iotHubClientInstance->uploadWorkerPool = worker_pool_create(workerCount)) == NULL)
+        {
+            LogError("unable to worker_pool_create");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            for (i = 0; i < workerCount; i++)
+            {
+                if ((iotHubClientInstance->uploadWorkerItems[i] = worker_pool_add(iotHubClientInstance->uploadWorkerPool, uploadWorker, iotHubClientInstance)) == NULL)
+                {
+                    LogError("unable to worker_pool_add upload worker %lu", (unsigned long)i);
+                    break;
+                }
+            }
+            iotHubClientInstance->uploadWorkerCount = i;
+
+            if (i < workerCount)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, OPTION_BLOB_UPLOAD_KEEP_CONNECTION, &keepConnection) != IOTHUB_CLIENT_OK)
+            {
+                LogError("unable to turn on %s for the upload workers", OPTION_BLOB_UPLOAD_KEEP_CONNECTION);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            destroy_blob_upload_workers(iotHubClientInstance);
+        }
+    }
+
+    return result;
+}
+#endif
+
+/*this function is called with the lock taken, it queues a user callback for the worker thread to call*/
+static int save_user_callback(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, const USER_CALLBACK_INFO* queue_cb_info)
+{
+    int result;
+
+    if (VECTOR_push_back(iotHubClientInstance->saved_user_callback_list, queue_cb_info, 1) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+#ifndef DONT_USE_MULTIPLEXING
+        if (iotHubClientInstance->TransportHandle != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_073: [ When the client uses a shared transport, queuing a user callback shall signal work for the client by calling IoTHubTransport_SignalClientWork. ]*/
+            IoTHubTransport_SignalClientWork(iotHubClientInstance->TransportHandle, iotHubClientInstance);
+        }
 #endif
+        result = 0;
+    }
+
+    return result;
+}
 
 static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void* userContextCallback)
 {
@@ -191,7 +523,7 @@ static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void*
         queue_cb_info.type = CALLBACK_TYPE_MESSAGE;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.message_cb_info = messageData;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) == 0)
+        if (save_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) == 0)
         {
             result = true;
         }
@@ -204,41 +536,45 @@ static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void*
     return result;
 }
 
+#ifndef DONT_USE_DEVICE_METHODS
 static int make_method_calback_queue_context(USER_CALLBACK_INFO* queue_cb_info, const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id, IOTHUB_QUEUE_CONTEXT* queue_context)
 {
     int result;
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_002: [ IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall copy the method_name and payload. ] */
+    size_t name_length = (method_name == NULL) ? 0 : strlen(method_name);
     queue_cb_info->userContextCallback = queue_context->userContextCallback;
     queue_cb_info->iothub_callback.method_cb_info.method_id = method_id;
-    if ((queue_cb_info->iothub_callback.method_cb_info.method_name = STRING_construct(method_name)) == NULL)
+    /*Codes_SRS_IOTHUBCLIENT_41_076: [ The method name and the payload shall be copied in a single allocation, the payload following the name. ]*/
+    if ((queue_cb_info->iothub_callback.method_cb_info.method_name = (char*)malloc(name_length + 1 + size)) == NULL)
     {
         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
-        LogError("STRING_construct failed");
+        LogError("failure allocating the method name and payload");
         result = __FAILURE__;
     }
     else
     {
-        if ((queue_cb_info->iothub_callback.method_cb_info.payload = BUFFER_create(payload, size)) == NULL)
+        if (name_length > 0)
         {
-            STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
-            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
-            LogError("BUFFER_create failed");
-            result = __FAILURE__;
+            (void)memcpy(queue_cb_info->iothub_callback.method_cb_info.method_name, method_name, name_length);
+        }
+        queue_cb_info->iothub_callback.method_cb_info.method_name[name_length] = '\0';
+        queue_cb_info->iothub_callback.method_cb_info.payload = (unsigned char*)queue_cb_info->iothub_callback.method_cb_info.method_name + name_length + 1;
+        queue_cb_info->iothub_callback.method_cb_info.size = size;
+        if (size > 0)
+        {
+            (void)memcpy(queue_cb_info->iothub_callback.method_cb_info.payload, payload, size);
+        }
+
+        if (save_user_callback(queue_context->iotHubClientHandle, queue_cb_info) == 0)
+        {
+            result = 0;
         }
         else
         {
-            if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, queue_cb_info, 1) == 0)
-            {
-                result = 0;
-            }
-            else
-            {
-                STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
-                BUFFER_delete(queue_cb_info->iothub_callback.method_cb_info.payload);
-                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
-                LogError("VECTOR_push_back failed");
-                result = __FAILURE__;
-            }
+            free(queue_cb_info->iothub_callback.method_cb_info.method_name);
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
+            LogError("VECTOR_push_back failed");
+            result = __FAILURE__;
         }
     }
     return result;
@@ -295,6 +631,7 @@ static int iothub_ll_inbound_device_method_callback(const char* method_name, con
     }
     return result;
 }
+#endif /*DONT_USE_DEVICE_METHODS*/
 
 static void iothub_ll_connection_status_callback(IOTHUB_CLIENT_CONNECTION_STATUS result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* userContextCallback)
 {
@@ -306,7 +643,7 @@ static void iothub_ll_connection_status_callback(IOTHUB_CLIENT_CONNECTION_STATUS
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.connection_status_cb_info.status_reason = reason;
         queue_cb_info.iothub_callback.connection_status_cb_info.connection_status = result;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (save_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("connection status callback vector push failed.");
         }
@@ -322,7 +659,7 @@ static void iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT r
         queue_cb_info.type = CALLBACK_TYPE_EVENT_CONFIRM;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.event_confirm_cb_info.confirm_result = result;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (save_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("event confirm callback vector push failed.");
         }
@@ -330,6 +667,24 @@ static void iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT r
     }
 }
 
+/*called by IoTHubClient_LL with the lock taken, userContextCallback is the IOTHUB_CLIENT_INSTANCE*/
+static void iothub_ll_send_queue_watermark_callback(IOTHUB_CLIENT_SEND_QUEUE_WATERMARK watermark, size_t messageCount, size_t byteCount, void* userContextCallback)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)userContextCallback;
+    USER_CALLBACK_INFO queue_cb_info;
+    /*Codes_SRS_IOTHUBCLIENT_41_028: [ The send queue watermark callback shall be queued and called by the worker thread, like the other user callbacks. ]*/
+    queue_cb_info.type = CALLBACK_TYPE_SEND_QUEUE_WATERMARK;
+    queue_cb_info.userContextCallback = iotHubClientInstance->send_queue_watermark_user_context;
+    queue_cb_info.iothub_callback.send_queue_watermark_cb_info.watermark = watermark;
+    queue_cb_info.iothub_callback.send_queue_watermark_cb_info.message_count = messageCount;
+    queue_cb_info.iothub_callback.send_queue_watermark_cb_info.byte_count = byteCount;
+    if (save_user_callback(iotHubClientInstance, &queue_cb_info) != 0)
+    {
+        LogError("send queue watermark callback vector push failed.");
+    }
+}
+
+#ifndef DONT_USE_DEVICE_TWIN
 static void iothub_ll_reported_state_callback(int status_code, void* userContextCallback)
 {
     IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)userContextCallback;
@@ -339,7 +694,7 @@ static void iothub_ll_reported_state_callback(int status_code, void* userContext
         queue_cb_info.type = CALLBACK_TYPE_REPORTED_STATE;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.reported_state_cb_info.status_code = status_code;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (save_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("reported state callback vector push failed.");
         }
@@ -366,6 +721,7 @@ static void iothub_ll_device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state
         }
         else
         {
+            /*the transport lends payLoad for the duration of the call, this copy is the only one: it is what the user callback gets, and owns with IoTHubClient_SetDeviceTwinPayloadCallback*/
             queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad = (unsigned char*)malloc(size);
             if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad == NULL)
             {
@@ -382,7 +738,7 @@ static void iothub_ll_device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state
         }
         if (push_to_vector == 0)
         {
-            if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+            if (save_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
             {
                 if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad != NULL)
                 {
@@ -397,6 +753,7 @@ static void iothub_ll_device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state
         LogError("device twin callback userContextCallback NULL");
     }
 }
+#endif /*DONT_USE_DEVICE_TWIN*/
 
 static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, VECTOR_HANDLE call_backs)
 {
@@ -413,42 +770,61 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
         {
             switch (queued_cb->type)
             {
+#ifndef DONT_USE_DEVICE_TWIN
                 case CALLBACK_TYPE_DEVICE_TWIN:
                 {
                     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK desired_state_callback;
+                    IOTHUB_CLIENT_DEVICE_TWIN_PAYLOAD_CALLBACK desired_state_payload_callback;
 
                     if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
                     {
                         LogError("failed locking for dispatch_user_callbacks");
                         desired_state_callback = NULL;
+                        desired_state_payload_callback = NULL;
                     }
                     else
                     {
                         desired_state_callback = iotHubClientInstance->desired_state_callback;
+                        desired_state_payload_callback = iotHubClientInstance->desired_state_payload_callback;
                         (void)Unlock(iotHubClientInstance->LockHandle);
                     }
 
-                    if (desired_state_callback)
+                    if (desired_state_payload_callback)
                     {
-                        desired_state_callback(queued_cb->iothub_callback.dev_twin_cb_info.update_state, queued_cb->iothub_callback.dev_twin_cb_info.payLoad, queued_cb->iothub_callback.dev_twin_cb_info.size, queued_cb->userContextCallback);
+                        /*Codes_SRS_IOTHUBCLIENT_41_078: [ The callback set by IoTHubClient_SetDeviceTwinPayloadCallback shall be handed the queued copy of the payload, which it owns from then on. ]*/
+                        desired_state_payload_callback(queued_cb->iothub_callback.dev_twin_cb_info.update_state, queued_cb->iothub_callback.dev_twin_cb_info.payLoad, queued_cb->iothub_callback.dev_twin_cb_info.size, queued_cb->userContextCallback);
                     }
-
-                    if (queued_cb->iothub_callback.dev_twin_cb_info.payLoad)
+                    else
                     {
-                        free(queued_cb->iothub_callback.dev_twin_cb_info.payLoad);
+                        if (desired_state_callback)
+                        {
+                            desired_state_callback(queued_cb->iothub_callback.dev_twin_cb_info.update_state, queued_cb->iothub_callback.dev_twin_cb_info.payLoad, queued_cb->iothub_callback.dev_twin_cb_info.size, queued_cb->userContextCallback);
+                        }
+
+                        if (queued_cb->iothub_callback.dev_twin_cb_info.payLoad)
+                        {
+                            free(queued_cb->iothub_callback.dev_twin_cb_info.payLoad);
+                        }
                     }
                     break;
                 }
+                case CALLBACK_TYPE_REPORTED_STATE:
+                    if (iotHubClientInstance->reported_state_callback)
+                    {
+                        iotHubClientInstance->reported_state_callback(queued_cb->iothub_callback.reported_state_cb_info.status_code, queued_cb->userContextCallback);
+                    }
+                    break;
+#endif /*DONT_USE_DEVICE_TWIN*/
                 case CALLBACK_TYPE_EVENT_CONFIRM:
                     if (iotHubClientInstance->event_confirm_callback)
                     {
                         iotHubClientInstance->event_confirm_callback(queued_cb->iothub_callback.event_confirm_cb_info.confirm_result, queued_cb->userContextCallback);
                     }
                     break;
-                case CALLBACK_TYPE_REPORTED_STATE:
-                    if (iotHubClientInstance->reported_state_callback)
+                case CALLBACK_TYPE_SEND_QUEUE_WATERMARK:
+                    if (iotHubClientInstance->send_queue_watermark_callback)
                     {
-                        iotHubClientInstance->reported_state_callback(queued_cb->iothub_callback.reported_state_cb_info.status_code, queued_cb->userContextCallback);
+                        iotHubClientInstance->send_queue_watermark_callback(queued_cb->iothub_callback.send_queue_watermark_cb_info.watermark, queued_cb->iothub_callback.send_queue_watermark_cb_info.message_count, queued_cb->iothub_callback.send_queue_watermark_cb_info.byte_count, queued_cb->userContextCallback);
                     }
                     break;
                 case CALLBACK_TYPE_CONNECTION_STATUS:
@@ -457,16 +833,13 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
                         iotHubClientInstance->connection_status_callback(queued_cb->iothub_callback.connection_status_cb_info.connection_status, queued_cb->iothub_callback.connection_status_cb_info.status_reason, queued_cb->userContextCallback);
                     }
                     break;
+#ifndef DONT_USE_DEVICE_METHODS
                 case CALLBACK_TYPE_DEVICE_METHOD:
                     if (iotHubClientInstance->device_method_callback)
                     {
-                        const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                        const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                        size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
-
                         unsigned char* payload_resp = NULL;
                         size_t response_size = 0;
-                        int status = iotHubClientInstance->device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, queued_cb->userContextCallback);
+                        int status = iotHubClientInstance->device_method_callback(queued_cb->iothub_callback.method_cb_info.method_name, queued_cb->iothub_callback.method_cb_info.payload, queued_cb->iothub_callback.method_cb_info.size, &payload_resp, &response_size, queued_cb->userContextCallback);
 
                         if (payload_resp && (response_size > 0))
                         {
@@ -478,28 +851,22 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
                             }
                         }
 
-                        BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                        STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
-                        
+
                         if (payload_resp)
                         {
                             free(payload_resp);
                         }
                     }
+                    free(queued_cb->iothub_callback.method_cb_info.method_name);
                     break;
                 case CALLBACK_TYPE_INBOUD_DEVICE_METHOD:
                     if (iotHubClientInstance->inbound_device_method_callback)
                     {
-                        const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                        const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                        size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
-
-                        iotHubClientInstance->inbound_device_method_callback(method_name, payload, payload_len, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
-
-                        BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                        STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+                        iotHubClientInstance->inbound_device_method_callback(queued_cb->iothub_callback.method_cb_info.method_name, queued_cb->iothub_callback.method_cb_info.payload, queued_cb->iothub_callback.method_cb_info.size, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
                     }
+                    free(queued_cb->iothub_callback.method_cb_info.method_name);
                     break;
+#endif /*DONT_USE_DEVICE_METHODS*/
                 case CALLBACK_TYPE_MESSAGE:
                     if (iotHubClientInstance->message_callback)
                     {
@@ -530,83 +897,682 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
     VECTOR_destroy(call_backs);
 }
 
-static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
+/*this function is called with the lock taken. It returns the queued user callbacks for the caller to dispatch, or NULL when they are handed off to the callback dispatcher thread*/
+static VECTOR_HANDLE take_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
 {
-    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
-
-#ifndef DONT_USE_UPLOADTOBLOB
-    garbageCollectorImpl(iotHubClientInstance);
-#endif
-    if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
+    VECTOR_HANDLE result;
+    if (iotHubClientInstance->CallbackDispatchThreadHandle == NULL)
     {
-        VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
-        (void)Unlock(iotHubClientInstance->LockHandle);
-
-        if (call_backs == NULL)
+        result = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+        if (result == NULL)
         {
-            LogError("Failed moving user callbacks");
-        }
-        else
-        {
-            dispatch_user_callbacks(iotHubClientInstance, call_backs);
+            LogError("VECTOR_move failed");
         }
     }
     else
     {
-        LogError("failed locking for ScheduleWork_Thread_ForMultiplexing");
-    }
-}
+        size_t queued = VECTOR_size(iotHubClientInstance->callback_dispatch_queue) + iotHubClientInstance->callback_dispatch_in_flight;
+        size_t count = VECTOR_size(iotHubClientInstance->saved_user_callback_list);
 
-static int ScheduleWork_Thread(void* threadArgument)
-{
-    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)threadArgument;
+        /*Codes_SRS_IOTHUBCLIENT_41_035: [ The worker shall hand off the queued user callbacks, in order, to the callback dispatcher thread as long as the dispatcher queue holds less than the size set by OPTION_CALLBACK_DISPATCH_QUEUE_SIZE, and keep the others queued for the next time. ]*/
+        if (queued >= iotHubClientInstance->callback_dispatch_queue_size)
+        {
+            count = 0;
+        }
+        else if (count > iotHubClientInstance->callback_dispatch_queue_size - queued)
+        {
+            count = iotHubClientInstance->callback_dispatch_queue_size - queued;
+        }
 
-    while (1)
-    {
-        if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
+        if (count != 0)
         {
-            /*Codes_SRS_IOTHUBCLIENT_01_038: [ The thread shall exit when IoTHubClient_Destroy is called. ]*/
-            if (iotHubClientInstance->StopThread)
+            if (VECTOR_push_back(iotHubClientInstance->callback_dispatch_queue, VECTOR_front(iotHubClientInstance->saved_user_callback_list), count) != 0)
             {
-                (void)Unlock(iotHubClientInstance->LockHandle);
-                break; /*gets out of the thread*/
+                LogError("unable to hand off the user callbacks");
             }
             else
             {
-                /* Codes_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_SendEvent or IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_DoWork every 1 ms.] */
-                /* Codes_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClient_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
-                IoTHubClient_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
-
-#ifndef DONT_USE_UPLOADTOBLOB
-                garbageCollectorImpl(iotHubClientInstance);
-#endif
-                VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
-                (void)Unlock(iotHubClientInstance->LockHandle);
-                if (call_backs == NULL)
-                {
-                    LogError("VECTOR_move failed");
-                }
-                else
+                VECTOR_erase(iotHubClientInstance->saved_user_callback_list, VECTOR_front(iotHubClientInstance->saved_user_callback_list), count);
+                if (Condition_Post(iotHubClientInstance->CallbackDispatchCondition) != COND_OK)
                 {
-                    dispatch_user_callbacks(iotHubClientInstance, call_backs);
+                    LogError("unable to Condition_Post");
+                }
+            }
+        }
+        result = NULL;
+    }
+    return result;
+}
+
+static size_t count_inbound_callbacks(VECTOR_HANDLE call_backs)
+{
+    size_t result = 0;
+    size_t count = (call_backs == NULL) ? 0 : VECTOR_size(call_backs);
+    size_t index;
+
+    for (index = 0; index < count; index++)
+    {
+        USER_CALLBACK_TYPE type = ((const USER_CALLBACK_INFO*)VECTOR_element(call_backs, index))->type;
+        if ((type == CALLBACK_TYPE_MESSAGE) || (type == CALLBACK_TYPE_DEVICE_METHOD) || (type == CALLBACK_TYPE_INBOUD_DEVICE_METHOD))
+        {
+            result++;
+        }
+    }
+    return result;
+}
+
+/*this function is called with the lock taken. The receive is paused while the application or the inbound callback limit pauses it*/
+static IOTHUB_CLIENT_RESULT apply_receive_pause(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    IOTHUB_CLIENT_RESULT result;
+    int paused = iotHubClientInstance->receive_paused_by_application || iotHubClientInstance->receive_paused_by_limit;
+
+    if (paused == iotHubClientInstance->receive_paused)
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if ((result = paused ? IoTHubClient_LL_PauseReceive(iotHubClientInstance->IoTHubClientLLHandle) : IoTHubClient_LL_ResumeReceive(iotHubClientInstance->IoTHubClientLLHandle)) != IOTHUB_CLIENT_OK)
+    {
+        LogError("unable to %s the receive", paused ? "pause" : "resume");
+    }
+    else
+    {
+        iotHubClientInstance->receive_paused = paused;
+    }
+    return result;
+}
+
+/*this function is called with the lock taken, right after IoTHubClient_LL_DoWork*/
+static void limit_inbound_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->inbound_callback_limit != 0)
+    {
+        size_t queued = count_inbound_callbacks(iotHubClientInstance->saved_user_callback_list) + count_inbound_callbacks(iotHubClientInstance->callback_dispatch_queue);
+        if (!iotHubClientInstance->receive_paused_by_limit && (queued >= iotHubClientInstance->inbound_callback_limit))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_089: [ After each IoTHubClient_LL_DoWork, once the message and method callbacks queued and not dispatched yet reach OPTION_INBOUND_CALLBACK_LIMIT, the worker shall pause the receive with IoTHubClient_LL_PauseReceive. ]*/
+            LogInfo("%lu inbound callbacks are queued, pausing the receive", (unsigned long)queued);
+            iotHubClientInstance->receive_paused_by_limit = 1;
+        }
+        else if (iotHubClientInstance->receive_paused_by_limit && (queued <= iotHubClientInstance->inbound_callback_limit / 2))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_090: [ Once at most half of OPTION_INBOUND_CALLBACK_LIMIT of them are left, the worker shall resume the receive with IoTHubClient_LL_ResumeReceive, unless IoTHubClient_PauseReceive paused it, trying again after the next IoTHubClient_LL_DoWork if it fails. ]*/
+            iotHubClientInstance->receive_paused_by_limit = 0;
+        }
+    }
+    (void)apply_receive_pause(iotHubClientInstance);
+}
+
+/*this function is called with the lock taken, right after IoTHubClient_LL_DoWork*/
+static void signal_blocked_senders(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    /*Codes_SRS_IOTHUBCLIENT_41_030: [ After each IoTHubClient_LL_DoWork the worker shall wake up the sends waiting for room in the send queue, if any. ]*/
+    if (iotHubClientInstance->blocked_senders != 0)
+    {
+        if (Condition_Post(iotHubClientInstance->SendQueueCondition) != COND_OK)
+        {
+            LogError("unable to Condition_Post");
+        }
+    }
+}
+
+static void post_work_condition(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (Condition_Post(iotHubClientInstance->WorkCondition) != COND_OK)
+    {
+        LogError("unable to Condition_Post");
+    }
+}
+
+/*wakes up the executor (worker pool or shared transport) that runs the worker when the client has no thread of its own*/
+static void schedule_worker(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->WorkerPoolItem != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_014: [ When the client is served by the worker pool, the operations that wake up the worker thread shall call worker_pool_schedule instead. ]*/
+        if (worker_pool_schedule(iotHubClientInstance->WorkerPoolItem) != 0)
+        {
+            LogError("unable to worker_pool_schedule");
+        }
+    }
+#ifndef DONT_USE_MULTIPLEXING
+    if (iotHubClientInstance->TransportHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_074: [ When the client uses a shared transport, the operations that wake up the worker thread shall call IoTHubTransport_SignalClientWork instead. ]*/
+        IoTHubTransport_SignalClientWork(iotHubClientInstance->TransportHandle, iotHubClientInstance);
+    }
+#endif
+}
+
+/*the producers of the ingress queue call this function without the lock*/
+static void wake_worker_thread_after_ingress_push(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, bool queue_was_empty)
+{
+    if ((iotHubClientInstance->WorkCondition != NULL) && queue_was_empty)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_094: [ When the push found the ingress queue empty and the worker waits on the work condition, the work condition shall be posted with the lock taken. ]*/
+        /*the worker checks the ingress queue and waits with the lock taken, a post without the lock could land between the two and be lost.
+        While the queue is not empty the worker does not wait, so the pushes that follow do not need the lock*/
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("unable to Lock");
+            post_work_condition(iotHubClientInstance);
+        }
+        else
+        {
+            post_work_condition(iotHubClientInstance);
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+    schedule_worker(iotHubClientInstance);
+}
+
+/*this function is called with the lock taken, it wakes up the worker thread when it is blocked waiting for work*/
+static void signal_worker_thread(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    iotHubClientInstance->work_pending = 1;
+    if (iotHubClientInstance->WorkCondition != NULL)
+    {
+        post_work_condition(iotHubClientInstance);
+    }
+    schedule_worker(iotHubClientInstance);
+}
+
+/*this function is called with the lock taken, which makes the caller the single consumer of the ingress queue*/
+static bool is_send_ingress_queue_empty(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    return (iotHubClientInstance->send_ingress_queue == NULL) ||
+        ((iotHubClientInstance->send_ingress_pending == NULL) && ingress_queue_is_empty(iotHubClientInstance->send_ingress_queue));
+}
+
+static void fail_send_ingress_item(SEND_INGRESS_ITEM* item, IOTHUB_CLIENT_CONFIRMATION_RESULT confirm_result)
+{
+    IoTHubMessage_Destroy(item->message);
+    if (item->eventConfirmationCallback != NULL)
+    {
+        item->eventConfirmationCallback(confirm_result, item->userContextCallback);
+    }
+    free(item);
+}
+
+/*this function is called with the lock taken, right before IoTHubClient_LL_DoWork*/
+static void drain_send_ingress_queue(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->send_ingress_queue != NULL)
+    {
+        while (1)
+        {
+            SEND_INGRESS_ITEM* item;
+            IOTHUB_CLIENT_RESULT send_result;
+
+            if (iotHubClientInstance->send_ingress_pending != NULL)
+            {
+                item = iotHubClientInstance->send_ingress_pending;
+                iotHubClientInstance->send_ingress_pending = NULL;
+            }
+            else if ((item = (SEND_INGRESS_ITEM*)ingress_queue_pop(iotHubClientInstance->send_ingress_queue)) == NULL)
+            {
+                break;
+            }
+
+            /*Codes_SRS_IOTHUBCLIENT_41_046: [ Before calling IoTHubClient_LL_DoWork the worker shall pass the messages of the ingress queue, in the order they were pushed, to IoTHubClient_LL_SendEventAsync_TakeOwnership. ]*/
+            send_result = IoTHubClient_LL_SendEventAsync_TakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, item->message, item->eventConfirmationCallback, item->userContextCallback);
+            if ((send_result == IOTHUB_CLIENT_QUEUE_FULL) && (iotHubClientInstance->send_queue_full_policy == IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_41_047: [ If IoTHubClient_LL_SendEventAsync_TakeOwnership returns IOTHUB_CLIENT_QUEUE_FULL and the send queue full policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, the worker shall keep the message and try again before the next IoTHubClient_LL_DoWork. ]*/
+                iotHubClientInstance->send_ingress_pending = item;
+                break;
+            }
+            else if (send_result != IOTHUB_CLIENT_OK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_41_048: [ Otherwise, if IoTHubClient_LL_SendEventAsync_TakeOwnership fails, the worker shall destroy the message and call the confirmation callback with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+                LogError("IoTHubClient_LL_SendEventAsync_TakeOwnership failed for a message of the ingress queue");
+                fail_send_ingress_item(item, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+            }
+            else
+            {
+                free(item);
+            }
+        }
+    }
+}
+
+#ifndef DONT_USE_MULTIPLEXING
+static bool is_client_idle(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance);
+
+/*this function is called with the lock taken. The shared transport only runs the work function of the clients that signaled work*/
+static bool is_multiplexed_client_busy(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    return (!is_client_idle(iotHubClientInstance)) ||
+        (VECTOR_size(iotHubClientInstance->saved_user_callback_list) != 0) ||
+#ifndef DONT_USE_UPLOADTOBLOB
+        (singlylinkedlist_get_head_item(iotHubClientInstance->savedDataToBeCleaned) != NULL) ||
+#endif
+        (iotHubClientInstance->blocked_senders != 0);
+}
+
+static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    garbageCollectorImpl(iotHubClientInstance);
+#endif
+    if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
+    {
+        VECTOR_HANDLE call_backs;
+        iotHubClientInstance->work_pending = 0;
+        signal_blocked_senders(iotHubClientInstance);
+        limit_inbound_callbacks(iotHubClientInstance);
+        /*the transport calls IoTHubClient_LL_DoWork before this function, the messages drained here are sent by the next one*/
+        drain_send_ingress_queue(iotHubClientInstance);
+        call_backs = take_user_callbacks(iotHubClientInstance);
+        if (is_multiplexed_client_busy(iotHubClientInstance))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_075: [ The shared transport work function shall signal work again for the client, by calling IoTHubTransport_SignalClientWork, while the client is busy or still has user callbacks or blocked sends waiting. ]*/
+            IoTHubTransport_SignalClientWork(iotHubClientInstance->TransportHandle, iotHubClientInstance);
+        }
+        (void)Unlock(iotHubClientInstance->LockHandle);
+
+        if (call_backs != NULL)
+        {
+            dispatch_user_callbacks(iotHubClientInstance, call_backs);
+        }
+    }
+    else
+    {
+        LogError("failed locking for ScheduleWork_Thread_ForMultiplexing");
+    }
+}
+#endif /*DONT_USE_MULTIPLEXING*/
+
+/*this function is called with the lock taken, right after IoTHubClient_LL_DoWork*/
+static bool is_client_idle(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    bool result;
+    IOTHUB_CLIENT_STATUS send_status;
+
+    if (iotHubClientInstance->work_pending != 0)
+    {
+        result = false;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_41_091: [ The worker shall not wait for work while the inbound callback limit pauses the receive. ]*/
+    else if (iotHubClientInstance->receive_paused_by_limit)
+    {
+        result = false;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_41_049: [ The worker shall not wait for work while the ingress queue is not empty. ]*/
+    else if (!is_send_ingress_queue_empty(iotHubClientInstance))
+    {
+        result = false;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_41_004: [ While IoTHubClient_LL_GetSendStatus reports IOTHUB_CLIENT_SEND_STATUS_BUSY the thread shall keep calling IoTHubClient_LL_DoWork every 1 ms. ]*/
+    else if ((IoTHubClient_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, &send_status) != IOTHUB_CLIENT_OK) ||
+        (send_status != IOTHUB_CLIENT_SEND_STATUS_IDLE))
+    {
+        result = false;
+    }
+    else
+    {
+        result = true;
+    }
+
+    return result;
+}
+
+/*this function is called with the lock taken, right after IoTHubClient_LL_DoWork*/
+static bool can_worker_thread_wait(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    return (iotHubClientInstance->event_driven_worker != 0) &&
+        (iotHubClientInstance->WorkCondition != NULL) &&
+        is_client_idle(iotHubClientInstance);
+}
+
+static void wait_for_work(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
+    {
+        /*a signal might have arrived while the callbacks were dispatched, in which case there is no waiting*/
+        if ((iotHubClientInstance->StopThread == 0) && (iotHubClientInstance->work_pending == 0) && is_send_ingress_queue_empty(iotHubClientInstance))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_005: [ Otherwise the thread shall wait on the work condition for at most the worker max idle time before calling IoTHubClient_LL_DoWork again. ]*/
+            /*the underlying XIOs do not expose readiness, so the max idle time bounds the latency of incoming data and of transport timers (keepalive, SAS token refresh)*/
+            COND_RESULT wait_result = Condition_Wait(iotHubClientInstance->WorkCondition, iotHubClientInstance->LockHandle, (int)iotHubClientInstance->worker_max_idle_time);
+            if ((wait_result != COND_OK) && (wait_result != COND_TIMEOUT))
+            {
+                LogError("Condition_Wait failed");
+            }
+        }
+        (void)Unlock(iotHubClientInstance->LockHandle);
+    }
+    else
+    {
+        LogError("unable to Lock");
+        (void)ThreadAPI_Sleep(1);
+    }
+}
+
+/*called with the lock held*/
+static void apply_thread_attributes(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, const char* name_suffix)
+{
+    /*Codes_SRS_IOTHUBCLIENT_41_093: [ The worker thread, the callback dispatcher thread and the thread of an upload shall apply the attributes of OPTION_THREAD_ATTRIBUTES, if set, as they start, and go on with the attributes they have if that fails. ]*/
+    if ((iotHubClientInstance->has_thread_attributes != 0) &&
+        (IoTHubClient_ThreadAttributes_ApplyToCurrentThread(&iotHubClientInstance->thread_attributes, name_suffix) != 0))
+    {
+        LogError("unable to apply all the thread attributes");
+    }
+}
+
+static int ScheduleWork_Thread(void* threadArgument)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)threadArgument;
+    bool thread_attributes_applied = false;
+
+    while (1)
+    {
+        bool wait_for_signal = false;
+
+        if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_01_038: [ The thread shall exit when IoTHubClient_Destroy is called. ]*/
+            if (iotHubClientInstance->StopThread)
+            {
+                (void)Unlock(iotHubClientInstance->LockHandle);
+                break; /*gets out of the thread*/
+            }
+            else
+            {
+                if (!thread_attributes_applied)
+                {
+                    apply_thread_attributes(iotHubClientInstance, "-work");
+                    thread_attributes_applied = true;
+                }
+
+                iotHubClientInstance->work_pending = 0;
+                drain_send_ingress_queue(iotHubClientInstance);
+
+                /* Codes_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_SendEvent or IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_DoWork every 1 ms.] */
+                /* Codes_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClient_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
+                IoTHubClient_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
+
+#ifndef DONT_USE_UPLOADTOBLOB
+                garbageCollectorImpl(iotHubClientInstance);
+#endif
+                signal_blocked_senders(iotHubClientInstance);
+                limit_inbound_callbacks(iotHubClientInstance);
+                wait_for_signal = can_worker_thread_wait(iotHubClientInstance);
+
+                VECTOR_HANDLE call_backs = take_user_callbacks(iotHubClientInstance);
+                (void)Unlock(iotHubClientInstance->LockHandle);
+                if (call_backs != NULL)
+                {
+                    dispatch_user_callbacks(iotHubClientInstance, call_backs);
+                }
+            }
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_01_040: [If acquiring the lock fails, IoTHubClient_LL_DoWork shall not be called.]*/
+            /*no code, shall retry*/
+        }
+
+        if (wait_for_signal)
+        {
+            wait_for_work(iotHubClientInstance);
+        }
+        else
+        {
+            (void)ThreadAPI_Sleep(1);
+        }
+    }
+
+    return 0;
+}
+
+/*work function of a client served by the process wide worker pool. The pool never runs it on two threads at once*/
+static unsigned int ScheduleWork_WorkerPool(void* work_context)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)work_context;
+    unsigned int result;
+
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        result = 1;
+    }
+    else
+    {
+        VECTOR_HANDLE call_backs;
+        unsigned int ramp_wait_time_in_ms = 0;
+
+        iotHubClientInstance->work_pending = 0;
+        drain_send_ingress_queue(iotHubClientInstance);
+
+        if (!iotHubClientInstance->connection_admitted)
+        {
+            IOTHUB_CLIENT_STATUS send_status;
+
+            /*Codes_SRS_IOTHUBCLIENT_41_082: [ Until the client is admitted, the worker pool work function shall call connection_ramp_admit on the connection ramp, if any, the client having queued data when IoTHubClient_LL_GetSendStatus says IOTHUB_CLIENT_SEND_STATUS_BUSY. ]*/
+            iotHubClientInstance->connection_admitted = (g_connection_ramp == NULL) ||
+                connection_ramp_admit(g_connection_ramp,
+                    (IoTHubClient_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, &send_status) == IOTHUB_CLIENT_OK) && (send_status == IOTHUB_CLIENT_SEND_STATUS_BUSY),
+                    &ramp_wait_time_in_ms);
+        }
+
+        if (!iotHubClientInstance->connection_admitted)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_083: [ If connection_ramp_admit returns false, the worker pool work function shall not call IoTHubClient_LL_DoWork and shall ask to be run again after the wait time it returned. ]*/
+            result = ramp_wait_time_in_ms;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_012: [ The worker pool work function shall call IoTHubClient_LL_DoWork and dispatch the user callbacks the same way the dedicated thread does. ]*/
+            IoTHubClient_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
+#ifndef DONT_USE_UPLOADTOBLOB
+            garbageCollectorImpl(iotHubClientInstance);
+#endif
+            signal_blocked_senders(iotHubClientInstance);
+            limit_inbound_callbacks(iotHubClientInstance);
+            /*Codes_SRS_IOTHUBCLIENT_41_013: [ The worker pool work function shall ask to be run again after 1 ms while the client is busy and after the worker max idle time otherwise. ]*/
+            result = is_client_idle(iotHubClientInstance) ? iotHubClientInstance->worker_max_idle_time : 1;
+        }
+
+        call_backs = take_user_callbacks(iotHubClientInstance);
+        (void)Unlock(iotHubClientInstance->LockHandle);
+        if (call_backs != NULL)
+        {
+            dispatch_user_callbacks(iotHubClientInstance, call_backs);
+        }
+    }
+
+    return result;
+}
+
+/*runs the user callbacks handed off by the worker, so that slow callbacks do not delay IoTHubClient_LL_DoWork*/
+static int CallbackDispatch_Thread(void* threadArgument)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)threadArgument;
+    bool thread_attributes_applied = false;
+
+    while (1)
+    {
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("unable to Lock");
+            (void)ThreadAPI_Sleep(1);
+        }
+        else
+        {
+            VECTOR_HANDLE call_backs;
+
+            if (!thread_attributes_applied)
+            {
+                apply_thread_attributes(iotHubClientInstance, "-cb");
+                thread_attributes_applied = true;
+            }
+
+            while ((iotHubClientInstance->StopCallbackDispatchThread == 0) &&
+                (VECTOR_size(iotHubClientInstance->callback_dispatch_queue) == 0))
+            {
+                COND_RESULT wait_result = Condition_Wait(iotHubClientInstance->CallbackDispatchCondition, iotHubClientInstance->LockHandle, (int)iotHubClientInstance->worker_max_idle_time);
+                if ((wait_result != COND_OK) && (wait_result != COND_TIMEOUT))
+                {
+                    LogError("Condition_Wait failed");
+                    break;
+                }
+            }
+
+            /*Codes_SRS_IOTHUBCLIENT_41_037: [ The callback dispatcher thread shall exit when IoTHubClient_Destroy is called, leaving the callbacks not dispatched yet to IoTHubClient_Destroy. ]*/
+            if (iotHubClientInstance->StopCallbackDispatchThread != 0)
+            {
+                (void)Unlock(iotHubClientInstance->LockHandle);
+                break;
+            }
+
+            call_backs = VECTOR_move(iotHubClientInstance->callback_dispatch_queue);
+            iotHubClientInstance->callback_dispatch_in_flight = (call_backs == NULL) ? 0 : VECTOR_size(call_backs);
+            (void)Unlock(iotHubClientInstance->LockHandle);
+
+            if (call_backs == NULL)
+            {
+                LogError("VECTOR_move failed");
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_41_036: [ The callback dispatcher thread shall call the user callbacks in the order they were handed off, without holding the lock. ]*/
+                dispatch_user_callbacks(iotHubClientInstance, call_backs);
+
+                if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+                {
+                    LogError("unable to Lock");
+                }
+                else
+                {
+                    iotHubClientInstance->callback_dispatch_in_flight = 0;
+                    if ((VECTOR_size(iotHubClientInstance->saved_user_callback_list) != 0) || iotHubClientInstance->receive_paused_by_limit)
+                    {
+                        /*there is room in the dispatcher queue again for the callbacks the worker kept, or the receive can be resumed*/
+                        signal_worker_thread(iotHubClientInstance);
+                    }
+                    (void)Unlock(iotHubClientInstance->LockHandle);
                 }
             }
         }
-        else
-        {
-            /*Codes_SRS_IOTHUBCLIENT_01_040: [If acquiring the lock fails, IoTHubClient_LL_DoWork shall not be called.]*/
-            /*no code, shall retry*/
-        }
-        (void)ThreadAPI_Sleep(1);
     }
 
     return 0;
 }
 
+/*this function is called with the lock taken*/
+static IOTHUB_CLIENT_RESULT set_callback_dispatch_queue_size(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, size_t queue_size)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (queue_size == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_033: [ If optionName is OPTION_CALLBACK_DISPATCH_QUEUE_SIZE and the value pointed to by value is 0 then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("invalid callback dispatch queue size (0)");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (iotHubClientInstance->CallbackDispatchThreadHandle != NULL)
+    {
+        iotHubClientInstance->callback_dispatch_queue_size = queue_size;
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_034: [ Otherwise IoTHubClient_SetOption shall store the queue size and start (once) the callback dispatcher thread, with its condition and queue, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+        if ((iotHubClientInstance->CallbackDispatchCondition = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((iotHubClientInstance->callback_dispatch_queue = VECTOR_create(sizeof(USER_CALLBACK_INFO))) == NULL)
+        {
+            LogError("VECTOR_create failed");
+            Condition_Deinit(iotHubClientInstance->CallbackDispatchCondition);
+            iotHubClientInstance->CallbackDispatchCondition = NULL;
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            iotHubClientInstance->callback_dispatch_queue_size = queue_size;
+            iotHubClientInstance->StopCallbackDispatchThread = 0;
+            if (ThreadAPI_Create(&iotHubClientInstance->CallbackDispatchThreadHandle, CallbackDispatch_Thread, iotHubClientInstance) != THREADAPI_OK)
+            {
+                LogError("ThreadAPI_Create failed");
+                iotHubClientInstance->CallbackDispatchThreadHandle = NULL;
+                VECTOR_destroy(iotHubClientInstance->callback_dispatch_queue);
+                iotHubClientInstance->callback_dispatch_queue = NULL;
+                Condition_Deinit(iotHubClientInstance->CallbackDispatchCondition);
+                iotHubClientInstance->CallbackDispatchCondition = NULL;
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void stop_callback_dispatch_thread(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    int res;
+
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("unable to Lock - - will still proceed to try to end the callback dispatcher thread without locking");
+    }
+
+    iotHubClientInstance->StopCallbackDispatchThread = 1;
+    if (Condition_Post(iotHubClientInstance->CallbackDispatchCondition) != COND_OK)
+    {
+        LogError("unable to Condition_Post");
+    }
+
+    (void)Unlock(iotHubClientInstance->LockHandle);
+
+    if (ThreadAPI_Join(iotHubClientInstance->CallbackDispatchThreadHandle, &res) != THREADAPI_OK)
+    {
+        LogError("ThreadAPI_Join failed");
+    }
+}
+
 static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
 {
     IOTHUB_CLIENT_RESULT result;
-    if (iotHubClientInstance->TransportHandle == NULL)
+#ifndef DONT_USE_MULTIPLEXING
+    if (iotHubClientInstance->TransportHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_17_012: [ If the transport connection is shared, the thread shall be started by calling IoTHubTransport_StartWorkerThread. ]*/
+        /*Codes_SRS_IOTHUBCLIENT_17_011: [ If the transport connection is shared, the thread shall be started by calling IoTHubTransport_StartWorkerThread*/
+        result = IoTHubTransport_StartWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientInstance, ScheduleWork_Thread_ForMultiplexing);
+    }
+    else
+#endif
+    if (g_worker_pool != NULL)
+    {
+        if (iotHubClientInstance->WorkerPoolItem == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_011: [ If the worker pool is initialized and the client does not use a shared transport, the client shall be added to the worker pool instead of starting a dedicated thread. ]*/
+            if ((iotHubClientInstance->WorkerPoolItem = worker_pool_add(g_worker_pool, ScheduleWork_WorkerPool, iotHubClientInstance)) == NULL)
+            {
+                LogError("worker_pool_add failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    else
     {
         if (iotHubClientInstance->ThreadHandle == NULL)
         {
@@ -627,12 +1593,6 @@ static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_INSTANCE* io
             result = IOTHUB_CLIENT_OK;
         }
     }
-    else
-    {
-        /*Codes_SRS_IOTHUBCLIENT_17_012: [ If the transport connection is shared, the thread shall be started by calling IoTHubTransport_StartWorkerThread. ]*/
-        /*Codes_SRS_IOTHUBCLIENT_17_011: [ If the transport connection is shared, the thread shall be started by calling IoTHubTransport_StartWorkerThread*/
-        result = IoTHubTransport_StartWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientInstance, ScheduleWork_Thread_ForMultiplexing);
-    }
     return result;
 }
 
@@ -665,10 +1625,15 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
             else
 #endif
             {
+#ifndef DONT_USE_MULTIPLEXING
                 result->TransportHandle = transportHandle;
+#else
+                (void)transportHandle;
+#endif
                 result->created_with_transport_handle = 0;
                 if (config != NULL)
                 {
+#ifndef DONT_USE_MULTIPLEXING
                     if (transportHandle != NULL)
                     {
                         /*Codes_SRS_IOTHUBCLIENT_17_005: [ IoTHubClient_CreateWithTransport shall call IoTHubTransport_GetLock to get the transport lock to be used later for serializing IoTHubClient calls. ]*/
@@ -715,6 +1680,7 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
                         }
                     }
                     else
+#endif /*DONT_USE_MULTIPLEXING*/
                     {
                         result->LockHandle = Lock_Init();
                         if (result->LockHandle == NULL)
@@ -768,15 +1734,54 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
                 else
                 {
                     result->ThreadHandle = NULL;
+                    result->WorkerPoolItem = NULL;
+                    result->connection_admitted = 0;
+                    result->WorkCondition = NULL;
+                    result->SendQueueCondition = NULL;
+                    result->SendQueueTickCounter = NULL;
+                    result->send_queue_full_policy = IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT;
+                    result->send_queue_block_timeout = 0;
+                    result->blocked_senders = 0;
+                    result->send_queue_watermark_callback = NULL;
+                    result->send_queue_watermark_user_context = NULL;
+                    result->CallbackDispatchThreadHandle = NULL;
+                    result->CallbackDispatchCondition = NULL;
+                    result->StopCallbackDispatchThread = 0;
+                    result->callback_dispatch_queue = NULL;
+                    result->callback_dispatch_in_flight = 0;
+                    result->callback_dispatch_queue_size = 0;
+                    result->inbound_callback_limit = 0;
+                    result->receive_paused_by_application = 0;
+                    result->receive_paused_by_limit = 0;
+                    result->receive_paused = 0;
+                    result->has_thread_attributes = 0;
+                    (void)memset(&result->thread_attributes, 0, sizeof(result->thread_attributes));
+                    result->thread_name = NULL;
+                    result->send_ingress_queue = NULL;
+                    result->send_ingress_pending = NULL;
+#ifndef DONT_USE_UPLOADTOBLOB
+                    result->uploadWorkerPool = NULL;
+                    result->uploadWorkerItems = NULL;
+                    result->uploadWorkerCount = 0;
+                    result->uploadQueueLock = NULL;
+                    result->pendingUploads = NULL;
+#endif
+                    result->event_driven_worker = 0;
+                    result->work_pending = 0;
+                    result->worker_max_idle_time = DEFAULT_WORKER_MAX_IDLE_TIME_MS;
+#ifndef DONT_USE_DEVICE_TWIN
                     result->desired_state_callback = NULL;
-                    result->event_confirm_callback = NULL;
                     result->reported_state_callback = NULL;
                     result->devicetwin_user_context = NULL;
+#endif
+                    result->event_confirm_callback = NULL;
                     result->connection_status_callback = NULL;
                     result->connection_status_user_context = NULL;
                     result->message_callback = NULL;
                     result->message_user_context = NULL;
+#ifndef DONT_USE_DEVICE_METHODS
                     result->method_user_context = NULL;
+#endif
                 }
             }
         }
@@ -784,6 +1789,68 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_WorkerPool_Init(size_t threadCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (threadCount == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_016: [ If threadCount is 0, IoTHubClient_WorkerPool_Init shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("invalid argument threadCount (0)");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (g_worker_pool != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_017: [ If the worker pool is already initialized, IoTHubClient_WorkerPool_Init shall return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("worker pool already initialized");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_41_018: [ IoTHubClient_WorkerPool_Init shall create the process wide worker pool by calling worker_pool_create with threadCount. ]*/
+    else if ((g_worker_pool = worker_pool_create(threadCount)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_019: [ If worker_pool_create fails, IoTHubClient_WorkerPool_Init shall return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("worker_pool_create failed");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+void IoTHubClient_WorkerPool_Deinit(void)
+{
+    /*Codes_SRS_IOTHUBCLIENT_41_020: [ IoTHubClient_WorkerPool_Deinit shall destroy the process wide worker pool, if any. ]*/
+    if (g_worker_pool != NULL)
+    {
+        worker_pool_destroy(g_worker_pool);
+        g_worker_pool = NULL;
+    }
+    g_connection_ramp = NULL;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_WorkerPool_SetConnectionRamp(CONNECTION_RAMP_HANDLE connectionRamp)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (g_worker_pool == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_081: [ If the worker pool is not initialized, IoTHubClient_WorkerPool_SetConnectionRamp shall return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("worker pool not initialized");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_084: [ IoTHubClient_WorkerPool_SetConnectionRamp shall save connectionRamp, NULL removing it, and return IOTHUB_CLIENT_OK. ]*/
+        g_connection_ramp = connectionRamp;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_HANDLE IoTHubClient_CreateFromConnectionString(const char* connectionString, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
 {
     IOTHUB_CLIENT_INSTANCE* result;
@@ -821,6 +1888,7 @@ IOTHUB_CLIENT_HANDLE IoTHubClient_Create(const IOTHUB_CLIENT_CONFIG* config)
     return result;
 }
 
+#ifndef DONT_USE_MULTIPLEXING
 IOTHUB_CLIENT_HANDLE IoTHubClient_CreateWithTransport(TRANSPORT_HANDLE transportHandle, const IOTHUB_CLIENT_CONFIG* config)
 {
     IOTHUB_CLIENT_INSTANCE* result;
@@ -837,6 +1905,7 @@ IOTHUB_CLIENT_HANDLE IoTHubClient_CreateWithTransport(TRANSPORT_HANDLE transport
     }
     return result;
 }
+#endif /*DONT_USE_MULTIPLEXING*/
 
 /* Codes_SRS_IOTHUBCLIENT_01_005: [IoTHubClient_Destroy shall free all resources associated with the iotHubClientHandle instance.] */
 void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
@@ -849,11 +1918,35 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
 
         IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
 
+        if (iotHubClientInstance->WorkerPoolItem != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_015: [ IoTHubClient_Destroy shall remove the client from the worker pool, waiting for a running work function to finish, before taking the lock. ]*/
+            worker_pool_remove(iotHubClientInstance->WorkerPoolItem);
+            iotHubClientInstance->WorkerPoolItem = NULL;
+        }
+
+        if (iotHubClientInstance->CallbackDispatchThreadHandle != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_038: [ IoTHubClient_Destroy shall stop and join the callback dispatcher thread, if any, before taking the lock. ]*/
+            stop_callback_dispatch_thread(iotHubClientInstance);
+        }
+
+#ifndef DONT_USE_UPLOADTOBLOB
+        if (iotHubClientInstance->uploadWorkerPool != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_072: [ IoTHubClient_Destroy shall fail the uploads still waiting for an upload worker, calling their callback with FILE_UPLOAD_ERROR, then stop the upload workers, waiting for the running uploads to finish, before taking the lock. ]*/
+            failPendingUploads(iotHubClientInstance);
+            destroy_blob_upload_workers(iotHubClientInstance);
+        }
+#endif
+
+#ifndef DONT_USE_MULTIPLEXING
         if (iotHubClientInstance->TransportHandle != NULL)
         {
             /*Codes_SRS_IOTHUBCLIENT_01_007: [ The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetNotificationMessageCallback shall be joined. ]*/
             okToJoin = IoTHubTransport_SignalEndWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
         }
+#endif
 
         /*Codes_SRS_IOTHUBCLIENT_02_043: [ IoTHubClient_Destroy shall lock the serializing lock and signal the worker thread (if any) to end ]*/
         if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
@@ -872,6 +1965,8 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
         if (iotHubClientInstance->ThreadHandle != NULL)
         {
             iotHubClientInstance->StopThread = 1;
+            /*Codes_SRS_IOTHUBCLIENT_41_007: [ IoTHubClient_Destroy shall wake up the worker thread if it is waiting for work. ]*/
+            signal_worker_thread(iotHubClientInstance);
             okToJoin = true;
         }
         else
@@ -882,6 +1977,21 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
         /* Codes_SRS_IOTHUBCLIENT_01_006: [That includes destroying the IoTHubClient_LL instance by calling IoTHubClient_LL_Destroy.] */
         IoTHubClient_LL_Destroy(iotHubClientInstance->IoTHubClientLLHandle);
 
+        if (iotHubClientInstance->send_ingress_queue != NULL)
+        {
+            SEND_INGRESS_ITEM* item;
+            /*Codes_SRS_IOTHUBCLIENT_41_051: [ IoTHubClient_Destroy shall destroy the messages left in the ingress queue and call their confirmation callbacks with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. ]*/
+            if (iotHubClientInstance->send_ingress_pending != NULL)
+            {
+                fail_send_ingress_item(iotHubClientInstance->send_ingress_pending, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+            }
+            while ((item = (SEND_INGRESS_ITEM*)ingress_queue_pop(iotHubClientInstance->send_ingress_queue)) != NULL)
+            {
+                fail_send_ingress_item(item, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+            }
+            ingress_queue_destroy(iotHubClientInstance->send_ingress_queue);
+        }
+
 #ifndef DONT_USE_UPLOADTOBLOB
         if (iotHubClientInstance->savedDataToBeCleaned != NULL)
         {
@@ -907,11 +2017,24 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
                 }
             }
 
+#ifndef DONT_USE_MULTIPLEXING
             if (iotHubClientInstance->TransportHandle != NULL)
             {
                 /*Codes_SRS_IOTHUBCLIENT_01_007: [ The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetNotificationMessageCallback shall be joined. ]*/
                 IoTHubTransport_JoinWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
             }
+#endif
+        }
+
+        if (iotHubClientInstance->callback_dispatch_queue != NULL)
+        {
+            /*the callbacks handed off but not dispatched are released like the ones the worker did not hand off*/
+            if ((VECTOR_size(iotHubClientInstance->callback_dispatch_queue) != 0) &&
+                (VECTOR_push_back(iotHubClientInstance->saved_user_callback_list, VECTOR_front(iotHubClientInstance->callback_dispatch_queue), VECTOR_size(iotHubClientInstance->callback_dispatch_queue)) != 0))
+            {
+                LogError("unable to release the callbacks left in the callback dispatcher queue");
+            }
+            VECTOR_destroy(iotHubClientInstance->callback_dispatch_queue);
         }
 
         vector_size = VECTOR_size(iotHubClientInstance->saved_user_callback_list);
@@ -921,19 +2044,24 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
             USER_CALLBACK_INFO* queue_cb_info = (USER_CALLBACK_INFO*)VECTOR_element(iotHubClientInstance->saved_user_callback_list, index);
             if (queue_cb_info != NULL)
             {
+#ifndef DONT_USE_DEVICE_METHODS
                 if ((queue_cb_info->type == CALLBACK_TYPE_DEVICE_METHOD) || (queue_cb_info->type == CALLBACK_TYPE_INBOUD_DEVICE_METHOD))
                 {
-                    STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
-                    BUFFER_delete(queue_cb_info->iothub_callback.method_cb_info.payload);
+                    free(queue_cb_info->iothub_callback.method_cb_info.method_name);
                 }
-                else if (queue_cb_info->type == CALLBACK_TYPE_DEVICE_TWIN)
+                else
+#endif
+#ifndef DONT_USE_DEVICE_TWIN
+                if (queue_cb_info->type == CALLBACK_TYPE_DEVICE_TWIN)
                 {
                     if (queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad != NULL)
                     {
                         free(queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad);
                     }
                 }
-                else if (queue_cb_info->type == CALLBACK_TYPE_EVENT_CONFIRM)
+                else
+#endif
+                if (queue_cb_info->type == CALLBACK_TYPE_EVENT_CONFIRM)
                 {
                     if (iotHubClientInstance->event_confirm_callback)
                     {
@@ -944,32 +2072,202 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
         }
         VECTOR_destroy(iotHubClientInstance->saved_user_callback_list);
 
-        if (iotHubClientInstance->TransportHandle == NULL)
+        if (iotHubClientInstance->WorkCondition != NULL)
+        {
+            Condition_Deinit(iotHubClientInstance->WorkCondition);
+        }
+        if (iotHubClientInstance->SendQueueCondition != NULL)
+        {
+            Condition_Deinit(iotHubClientInstance->SendQueueCondition);
+        }
+        if (iotHubClientInstance->SendQueueTickCounter != NULL)
+        {
+            tickcounter_destroy(iotHubClientInstance->SendQueueTickCounter);
+        }
+        if (iotHubClientInstance->CallbackDispatchCondition != NULL)
+        {
+            Condition_Deinit(iotHubClientInstance->CallbackDispatchCondition);
+        }
+#ifndef DONT_USE_MULTIPLEXING
+        if (iotHubClientInstance->TransportHandle == NULL)
+#endif
+        {
+            /* Codes_SRS_IOTHUBCLIENT_01_032: [If the lock was allocated in IoTHubClient_Create, it shall be also freed..] */
+            Lock_Deinit(iotHubClientInstance->LockHandle);
+        }
+#ifndef DONT_USE_DEVICE_TWIN
+        if (iotHubClientInstance->devicetwin_user_context != NULL)
+        {
+            free(iotHubClientInstance->devicetwin_user_context);
+        }
+#endif
+        if (iotHubClientInstance->connection_status_user_context != NULL)
+        {
+            free(iotHubClientInstance->connection_status_user_context);
+        }
+        if (iotHubClientInstance->message_user_context != NULL)
+        {
+            free(iotHubClientInstance->message_user_context);
+        }
+#ifndef DONT_USE_DEVICE_METHODS
+        if (iotHubClientInstance->method_user_context != NULL)
+        {
+            free(iotHubClientInstance->method_user_context);
+        }
+#endif
+        if (iotHubClientInstance->thread_name != NULL)
+        {
+            free(iotHubClientInstance->thread_name);
+        }
+        free(iotHubClientInstance);
+    }
+}
+
+typedef enum SEND_EVENT_KIND_TAG
+{
+    SEND_EVENT_CLONE,
+    SEND_EVENT_TAKE_OWNERSHIP,
+    SEND_EVENT_BATCH
+} SEND_EVENT_KIND;
+
+static IOTHUB_CLIENT_RESULT ll_send_event_async_once(IOTHUB_CLIENT_LL_HANDLE iotHubClientLLHandle, IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, SEND_EVENT_KIND kind)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (kind == SEND_EVENT_BATCH)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_032: [ IoTHubClient_SendEventBatchAsync shall call IoTHubClient_LL_SendEventBatchAsync instead of IoTHubClient_LL_SendEventAsync, passing eventMessageHandles and eventMessageCount. ]*/
+        result = IoTHubClient_LL_SendEventBatchAsync(iotHubClientLLHandle, eventMessageHandles, eventMessageCount, eventConfirmationCallback, userContextCallback);
+    }
+    else if (kind == SEND_EVENT_TAKE_OWNERSHIP)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_022: [ IoTHubClient_SendEventAsync_TakeOwnership shall call IoTHubClient_LL_SendEventAsync_TakeOwnership instead of IoTHubClient_LL_SendEventAsync. ]*/
+        result = IoTHubClient_LL_SendEventAsync_TakeOwnership(iotHubClientLLHandle, eventMessageHandles[0], eventConfirmationCallback, userContextCallback);
+    }
+    else
+    {
+        result = IoTHubClient_LL_SendEventAsync(iotHubClientLLHandle, eventMessageHandles[0], eventConfirmationCallback, userContextCallback);
+    }
+    return result;
+}
+
+/*this function is called with the lock taken*/
+static IOTHUB_CLIENT_RESULT ll_send_event_async(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, SEND_EVENT_KIND kind)
+{
+    IOTHUB_CLIENT_RESULT result = ll_send_event_async_once(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, eventMessageCount, eventConfirmationCallback, userContextCallback, kind);
+
+    if ((result == IOTHUB_CLIENT_QUEUE_FULL) &&
+        (iotHubClientInstance->send_queue_full_policy == IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK) &&
+        (iotHubClientInstance->SendQueueCondition != NULL))
+    {
+        tickcounter_ms_t start;
+        tickcounter_ms_t now;
+        if (tickcounter_get_current_ms(iotHubClientInstance->SendQueueTickCounter, &start) != 0)
+        {
+            LogError("unable to get the current ms, the send shall not wait for room in the send queue");
+        }
+        else
+        {
+            now = start;
+            /*Codes_SRS_IOTHUBCLIENT_41_029: [ If IoTHubClient_LL_SendEventAsync returns IOTHUB_CLIENT_QUEUE_FULL and the send queue full policy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, IoTHubClient_SendEventAsync shall wait on the send queue condition, releasing the lock, and try again until the message is accepted, the client is destroyed or blockTimeoutInMilliseconds elapse. ]*/
+            while ((result == IOTHUB_CLIENT_QUEUE_FULL) &&
+                (iotHubClientInstance->StopThread == 0) &&
+                (now - start < iotHubClientInstance->send_queue_block_timeout))
+            {
+                COND_RESULT wait_result;
+                iotHubClientInstance->blocked_senders++;
+                wait_result = Condition_Wait(iotHubClientInstance->SendQueueCondition, iotHubClientInstance->LockHandle, (int)(iotHubClientInstance->send_queue_block_timeout - (now - start)));
+                iotHubClientInstance->blocked_senders--;
+                if ((wait_result != COND_OK) && (wait_result != COND_TIMEOUT))
+                {
+                    LogError("Condition_Wait failed");
+                    break;
+                }
+
+                result = ll_send_event_async_once(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, eventMessageCount, eventConfirmationCallback, userContextCallback, kind);
+
+                if (tickcounter_get_current_ms(iotHubClientInstance->SendQueueTickCounter, &now) != 0)
+                {
+                    LogError("unable to get the current ms");
+                    break;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*called without the lock, so that producers do not wait for the worker while it runs IoTHubClient_LL_DoWork*/
+static IOTHUB_CLIENT_RESULT push_send_ingress_item(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, SEND_EVENT_KIND kind)
+{
+    IOTHUB_CLIENT_RESULT result;
+    SEND_INGRESS_ITEM* item = (SEND_INGRESS_ITEM*)malloc(sizeof(SEND_INGRESS_ITEM));
+    if (item == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_045: [ If creating or pushing the ingress item fails, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR and the caller keeps the ownership of the message. ]*/
+        LogError("Failed allocating SEND_INGRESS_ITEM");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((item->message = (kind == SEND_EVENT_CLONE) ? IoTHubMessage_Clone(eventMessageHandle) : eventMessageHandle) == NULL)
+    {
+        LogError("unable to clone the message");
+        free(item);
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        IOTHUB_QUEUE_CONTEXT* queue_context = NULL;
+
+        if ((iotHubClientInstance->created_with_transport_handle != 0) || (eventConfirmationCallback == NULL))
         {
-            /* Codes_SRS_IOTHUBCLIENT_01_032: [If the lock was allocated in IoTHubClient_Create, it shall be also freed..] */
-            Lock_Deinit(iotHubClientInstance->LockHandle);
+            item->eventConfirmationCallback = eventConfirmationCallback;
+            item->userContextCallback = userContextCallback;
+            result = IOTHUB_CLIENT_OK;
         }
-        if (iotHubClientInstance->devicetwin_user_context != NULL)
+        else if ((queue_context = (IOTHUB_QUEUE_CONTEXT*)malloc(sizeof(IOTHUB_QUEUE_CONTEXT))) == NULL)
         {
-            free(iotHubClientInstance->devicetwin_user_context);
+            LogError("Failed allocating QUEUE_CONTEXT");
+            result = IOTHUB_CLIENT_ERROR;
         }
-        if (iotHubClientInstance->connection_status_user_context != NULL)
+        else
         {
-            free(iotHubClientInstance->connection_status_user_context);
+            queue_context->iotHubClientHandle = iotHubClientInstance;
+            queue_context->userContextCallback = userContextCallback;
+            item->eventConfirmationCallback = iothub_ll_event_confirm_callback;
+            item->userContextCallback = queue_context;
+            result = IOTHUB_CLIENT_OK;
         }
-        if (iotHubClientInstance->message_user_context != NULL)
+
+        if (result == IOTHUB_CLIENT_OK)
         {
-            free(iotHubClientInstance->message_user_context);
+            /*Codes_SRS_IOTHUBCLIENT_41_044: [ When the ingress queue is enabled, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall not take the lock; they shall push the message (cloned by IoTHubClient_SendEventAsync) on the ingress queue, wake up the worker thread and return IOTHUB_CLIENT_OK. ]*/
+            bool queue_was_empty;
+            if (ingress_queue_push(iotHubClientInstance->send_ingress_queue, item, &queue_was_empty) != 0)
+            {
+                LogError("ingress_queue_push failed");
+                free(queue_context);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                wake_worker_thread_after_ingress_push(iotHubClientInstance, queue_was_empty);
+            }
         }
-        if (iotHubClientInstance->method_user_context != NULL)
+
+        if (result != IOTHUB_CLIENT_OK)
         {
-            free(iotHubClientInstance->method_user_context);
+            if (kind == SEND_EVENT_CLONE)
+            {
+                IoTHubMessage_Destroy(item->message);
+            }
+            free(item);
         }
-        free(iotHubClientInstance);
     }
+
+    return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+static IOTHUB_CLIENT_RESULT send_event_async(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, SEND_EVENT_KIND kind)
 {
     IOTHUB_CLIENT_RESULT result;
 
@@ -997,8 +2295,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
                 iotHubClientInstance->event_confirm_callback = eventConfirmationCallback;
             }
 
+            if ((kind != SEND_EVENT_BATCH) && (iotHubClientInstance->send_ingress_queue != NULL))
+            {
+                result = push_send_ingress_item(iotHubClientInstance, eventMessageHandles[0], eventConfirmationCallback, userContextCallback, kind);
+            }
             /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-            if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+            else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
             {
                 /* Codes_SRS_IOTHUBCLIENT_01_026: [If acquiring the lock fails, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR.] */
                 result = IOTHUB_CLIENT_ERROR;
@@ -1008,7 +2310,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
             {
                 if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
                 {
-                    result = IoTHubClient_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+                    result = ll_send_event_async(iotHubClientInstance, eventMessageHandles, eventMessageCount, eventConfirmationCallback, userContextCallback, kind);
                 }
                 else
                 {
@@ -1025,7 +2327,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
                         queue_context->userContextCallback = userContextCallback;
                         /* Codes_SRS_IOTHUBCLIENT_01_012: [IoTHubClient_SendEventAsync shall call IoTHubClient_LL_SendEventAsync, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback.] */
                         /* Codes_SRS_IOTHUBCLIENT_01_013: [When IoTHubClient_LL_SendEventAsync is called, IoTHubClient_SendEventAsync shall return the result of IoTHubClient_LL_SendEventAsync.] */
-                        result = IoTHubClient_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context);
+                        result = ll_send_event_async(iotHubClientInstance, eventMessageHandles, eventMessageCount, iothub_ll_event_confirm_callback, queue_context, kind);
                         if (result != IOTHUB_CLIENT_OK)
                         {
                             LogError("IoTHubClient_LL_SendEventAsync failed");
@@ -1034,6 +2336,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
                     }
                 }
 
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_41_006: [ IoTHubClient_SendEventAsync, IoTHubClient_SendReportedState and IoTHubClient_DeviceMethodResponse shall wake up the worker thread when they succeed. ]*/
+                    signal_worker_thread(iotHubClientInstance);
+                }
+
                 /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
@@ -1043,6 +2351,23 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, &eventMessageHandle, 1, eventConfirmationCallback, userContextCallback, SEND_EVENT_CLONE);
+}
+
+/*Codes_SRS_IOTHUBCLIENT_41_021: [ IoTHubClient_SendEventAsync_TakeOwnership shall behave as IoTHubClient_SendEventAsync, with the exception of the message handle being handed over to the SDK instead of being cloned. ]*/
+IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, &eventMessageHandle, 1, eventConfirmationCallback, userContextCallback, SEND_EVENT_TAKE_OWNERSHIP);
+}
+
+/*Codes_SRS_IOTHUBCLIENT_41_031: [ IoTHubClient_SendEventBatchAsync shall behave as IoTHubClient_SendEventAsync, enqueuing all the messages of eventMessageHandles under a single acquisition of the lock. ]*/
+IOTHUB_CLIENT_RESULT IoTHubClient_SendEventBatchAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandles, eventMessageCount, eventConfirmationCallback, userContextCallback, SEND_EVENT_BATCH);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1069,6 +2394,11 @@ IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus(IOTHUB_CLIENT_HANDLE iotHubClien
             /* Codes_SRS_IOTHUBCLIENT_01_022: [IoTHubClient_GetSendStatus shall call IoTHubClient_LL_GetSendStatus, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameter iotHubClientStatus.] */
             /* Codes_SRS_IOTHUBCLIENT_01_024: [Otherwise, IoTHubClient_GetSendStatus shall return the result of IoTHubClient_LL_GetSendStatus.] */
             result = IoTHubClient_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, iotHubClientStatus);
+            if ((result == IOTHUB_CLIENT_OK) && !is_send_ingress_queue_empty(iotHubClientInstance))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_41_050: [ IoTHubClient_GetSendStatus shall report IOTHUB_CLIENT_SEND_STATUS_BUSY while the ingress queue is not empty. ]*/
+                *iotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+            }
 
             /* Codes_SRS_IOTHUBCLIENT_01_033: [IoTHubClient_GetSendStatus shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
             (void)Unlock(iotHubClientInstance->LockHandle);
@@ -1238,6 +2568,32 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetConnectionStatusCallback(IOTHUB_CLIENT_HAND
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_Connect(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_41_055: [ If `iotHubClientHandle` is `NULL`, `IoTHubClient_Connect` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    /* Codes_SRS_IOTHUBCLIENT_41_056: [ `IoTHubClient_Connect` shall start the worker thread if it was not previously started, so that the transport connects and authenticates the device before the first message is sent. ]*/
+    else if (StartWorkerThreadIfNeeded((IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle) != IOTHUB_CLIENT_OK)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_41_057: [ If starting the thread fails, `IoTHubClient_Connect` shall return `IOTHUB_CLIENT_ERROR`. ]*/
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("Could not start worker thread");
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBCLIENT_41_058: [ Otherwise `IoTHubClient_Connect` shall return `IOTHUB_CLIENT_OK`. ]*/
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_SetRetryPolicy(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1358,6 +2714,294 @@ IOTHUB_CLIENT_RESULT IoTHubClient_GetLastMessageReceiveTime(IOTHUB_CLIENT_HANDLE
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_GetMessagePoolStatistics(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_023: [ If iotHubClientHandle is NULL, IoTHubClient_GetMessagePoolStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_024: [ If acquiring the lock fails, IoTHubClient_GetMessagePoolStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_025: [ IoTHubClient_GetMessagePoolStatistics shall return the result of IoTHubClient_LL_GetMessagePoolStatistics, called with the lock taken. ]*/
+            result = IoTHubClient_LL_GetMessagePoolStatistics(iotHubClientInstance->IoTHubClientLLHandle, statistics);
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_GetStatistics(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_052: [ If iotHubClientHandle is NULL, IoTHubClient_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_053: [ If acquiring the lock fails, IoTHubClient_GetStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_054: [ IoTHubClient_GetStatistics shall return the result of IoTHubClient_LL_GetStatistics, called with the lock taken. ]*/
+            result = IoTHubClient_LL_GetStatistics(iotHubClientInstance->IoTHubClientLLHandle, statistics);
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_GetCallbackQueueDepth(IOTHUB_CLIENT_HANDLE iotHubClientHandle, size_t* depth)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((iotHubClientHandle == NULL) || (depth == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_039: [ If iotHubClientHandle or depth are NULL, IoTHubClient_GetCallbackQueueDepth shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid arg (NULL)");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_040: [ If acquiring the lock fails, IoTHubClient_GetCallbackQueueDepth shall return IOTHUB_CLIENT_ERROR. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_041: [ IoTHubClient_GetCallbackQueueDepth shall set depth to the number of user callbacks queued and not dispatched yet, including the ones the callback dispatcher thread is running, and return IOTHUB_CLIENT_OK. ]*/
+            *depth = VECTOR_size(iotHubClientInstance->saved_user_callback_list);
+            if (iotHubClientInstance->callback_dispatch_queue != NULL)
+            {
+                *depth += VECTOR_size(iotHubClientInstance->callback_dispatch_queue) + iotHubClientInstance->callback_dispatch_in_flight;
+            }
+            result = IOTHUB_CLIENT_OK;
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT set_receive_paused_by_application(IOTHUB_CLIENT_HANDLE iotHubClientHandle, int paused)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_085: [ If iotHubClientHandle is NULL, IoTHubClient_PauseReceive and IoTHubClient_ResumeReceive shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_086: [ If acquiring the lock fails, IoTHubClient_PauseReceive and IoTHubClient_ResumeReceive shall return IOTHUB_CLIENT_ERROR. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_087: [ IoTHubClient_PauseReceive and IoTHubClient_ResumeReceive shall pause and resume the receive with IoTHubClient_LL_PauseReceive and IoTHubClient_LL_ResumeReceive, called with the lock taken, the receive staying paused while the inbound callback limit pauses it, and return their result. ]*/
+            int previous = iotHubClientInstance->receive_paused_by_application;
+            iotHubClientInstance->receive_paused_by_application = paused;
+            if ((result = apply_receive_pause(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+            {
+                iotHubClientInstance->receive_paused_by_application = previous;
+            }
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_PauseReceive(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
+{
+    return set_receive_paused_by_application(iotHubClientHandle, 1);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_ResumeReceive(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
+{
+    return set_receive_paused_by_application(iotHubClientHandle, 0);
+}
+
+/*this function is called with the lock taken*/
+static IOTHUB_CLIENT_RESULT set_send_queue_limits(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, const IOTHUB_CLIENT_SEND_QUEUE_LIMITS* limits)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((limits->fullPolicy == IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK) && (limits->blockTimeoutInMilliseconds == 0))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_026: [ If optionName is OPTION_SEND_QUEUE_LIMITS, fullPolicy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and blockTimeoutInMilliseconds is 0, IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("a block timeout is needed with IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if ((limits->fullPolicy == IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK) &&
+        (((iotHubClientInstance->SendQueueTickCounter == NULL) && ((iotHubClientInstance->SendQueueTickCounter = tickcounter_create()) == NULL)) ||
+        ((iotHubClientInstance->SendQueueCondition == NULL) && ((iotHubClientInstance->SendQueueCondition = Condition_Init()) == NULL))))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_027: [ If fullPolicy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, IoTHubClient_SetOption shall create (once) a tick counter and a condition used to wait for room in the send queue, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+        LogError("unable to create the send queue condition");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        IOTHUB_CLIENT_SEND_QUEUE_LIMITS ll_limits = *limits;
+
+        /*Codes_SRS_IOTHUBCLIENT_41_028: [ The send queue watermark callback shall be queued and called by the worker thread, like the other user callbacks. ]*/
+        if (limits->watermarkCallback != NULL)
+        {
+            ll_limits.watermarkCallback = iothub_ll_send_queue_watermark_callback;
+            ll_limits.watermarkUserContextCallback = iotHubClientInstance;
+        }
+
+        result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, OPTION_SEND_QUEUE_LIMITS, &ll_limits);
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            LogError("IoTHubClient_LL_SetOption failed");
+        }
+        else
+        {
+            iotHubClientInstance->send_queue_full_policy = limits->fullPolicy;
+            iotHubClientInstance->send_queue_block_timeout = limits->blockTimeoutInMilliseconds;
+            iotHubClientInstance->send_queue_watermark_callback = limits->watermarkCallback;
+            iotHubClientInstance->send_queue_watermark_user_context = limits->watermarkUserContextCallback;
+        }
+    }
+
+    return result;
+}
+
+/*this function is called with the lock taken*/
+static IOTHUB_CLIENT_RESULT set_thread_attributes(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, const IOTHUB_CLIENT_THREAD_ATTRIBUTES* attributes)
+{
+    IOTHUB_CLIENT_RESULT result;
+    char* thread_name = NULL;
+
+    /*Codes_SRS_IOTHUBCLIENT_41_092: [ If optionName is OPTION_THREAD_ATTRIBUTES, IoTHubClient_SetOption shall keep a copy of the attributes, name included, for the threads the client starts afterwards, and return IOTHUB_CLIENT_ERROR if copying the name fails. ]*/
+    if ((attributes->name != NULL) && (mallocAndStrcpy_s(&thread_name, attributes->name) != 0))
+    {
+        LogError("unable to copy the thread name");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        if (iotHubClientInstance->thread_name != NULL)
+        {
+            free(iotHubClientInstance->thread_name);
+        }
+        iotHubClientInstance->thread_attributes = *attributes;
+        iotHubClientInstance->thread_attributes.name = thread_name;
+        iotHubClientInstance->thread_name = thread_name;
+        iotHubClientInstance->has_thread_attributes = 1;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+/*this function is called with the lock taken*/
+/*this function is called with the lock taken*/
+static IOTHUB_CLIENT_RESULT set_send_ingress_queue(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, bool enable)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (!enable)
+    {
+        if (iotHubClientInstance->send_ingress_queue != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_043: [ If optionName is OPTION_SEND_INGRESS_QUEUE, the value pointed to by value is false and the ingress queue was created then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+            LogError("the send ingress queue cannot be disabled once enabled");
+            result = IOTHUB_CLIENT_INVALID_ARG;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    else if ((iotHubClientInstance->send_ingress_queue == NULL) &&
+        ((iotHubClientInstance->send_ingress_queue = ingress_queue_create()) == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_042: [ If optionName is OPTION_SEND_INGRESS_QUEUE and the value pointed to by value is true, IoTHubClient_SetOption shall create (once) the ingress queue and return IOTHUB_CLIENT_ERROR if that fails. ]*/
+        LogError("unable to ingress_queue_create");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT set_event_driven_worker(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, bool enable)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+#ifndef DONT_USE_MULTIPLEXING
+    if (iotHubClientInstance->TransportHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_001: [ If optionName is OPTION_EVENT_DRIVEN_WORKER and the client was created with a shared transport then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("event driven worker is not available for clients using a shared transport");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+#endif
+    if (enable && (iotHubClientInstance->WorkCondition == NULL) &&
+        ((iotHubClientInstance->WorkCondition = Condition_Init()) == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_003: [ If creating the condition fails, IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("unable to Condition_Init");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_002: [ If optionName is OPTION_EVENT_DRIVEN_WORKER, IoTHubClient_SetOption shall create (once) a condition used to wake up the worker thread and enable or disable the event driven mode as indicated by the bool pointed to by value. ]*/
+        iotHubClientInstance->event_driven_worker = enable ? 1 : 0;
+        signal_worker_thread(iotHubClientInstance);
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const char* optionName, const void* value)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1386,11 +3030,66 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHan
         }
         else
         {
-            /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
-            result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
-            if (result != IOTHUB_CLIENT_OK)
+            if (strcmp(optionName, OPTION_EVENT_DRIVEN_WORKER) == 0)
+            {
+                result = set_event_driven_worker(iotHubClientInstance, *(const bool*)value);
+            }
+            else if (strcmp(optionName, OPTION_WORKER_MAX_IDLE_TIME) == 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_41_008: [ If optionName is OPTION_WORKER_MAX_IDLE_TIME and the value pointed to by value is 0 then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                if (*(const unsigned int*)value == 0)
+                {
+                    LogError("invalid worker max idle time (0)");
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_41_009: [ Otherwise IoTHubClient_SetOption shall store the new max idle time and wake up the worker thread. ]*/
+                    iotHubClientInstance->worker_max_idle_time = *(const unsigned int*)value;
+                    signal_worker_thread(iotHubClientInstance);
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else if (strcmp(optionName, OPTION_SEND_QUEUE_LIMITS) == 0)
+            {
+                result = set_send_queue_limits(iotHubClientInstance, (const IOTHUB_CLIENT_SEND_QUEUE_LIMITS*)value);
+            }
+            else if (strcmp(optionName, OPTION_CALLBACK_DISPATCH_QUEUE_SIZE) == 0)
+            {
+                result = set_callback_dispatch_queue_size(iotHubClientInstance, *(const size_t*)value);
+            }
+            else if (strcmp(optionName, OPTION_INBOUND_CALLBACK_LIMIT) == 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_41_088: [ If optionName is OPTION_INBOUND_CALLBACK_LIMIT, IoTHubClient_SetOption shall keep the limit, 0 for none, resume the receive it paused when the limit is 0 and return IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR if resuming fails. ]*/
+                iotHubClientInstance->inbound_callback_limit = *(const size_t*)value;
+                if (iotHubClientInstance->inbound_callback_limit == 0)
+                {
+                    iotHubClientInstance->receive_paused_by_limit = 0;
+                }
+                result = apply_receive_pause(iotHubClientInstance);
+            }
+            else if (strcmp(optionName, OPTION_SEND_INGRESS_QUEUE) == 0)
+            {
+                result = set_send_ingress_queue(iotHubClientInstance, *(const bool*)value);
+            }
+            else if (strcmp(optionName, OPTION_THREAD_ATTRIBUTES) == 0)
+            {
+                result = set_thread_attributes(iotHubClientInstance, (const IOTHUB_CLIENT_THREAD_ATTRIBUTES*)value);
+            }
+#ifndef DONT_USE_UPLOADTOBLOB
+            else if (strcmp(optionName, OPTION_BLOB_UPLOAD_WORKERS) == 0)
+            {
+                result = set_blob_upload_workers(iotHubClientInstance, *(const size_t*)value);
+            }
+#endif
+            else
             {
-                LogError("IoTHubClient_LL_SetOption failed");
+                /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
+                result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
+                if (result != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubClient_LL_SetOption failed");
+                }
             }
 
             (void)Unlock(iotHubClientInstance->LockHandle);
@@ -1399,6 +3098,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHan
     return result;
 }
 
+#ifndef DONT_USE_DEVICE_TWIN
 IOTHUB_CLIENT_RESULT IoTHubClient_SetDeviceTwinCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1435,6 +3135,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetDeviceTwinCallback(IOTHUB_CLIENT_HANDLE iot
                 {
                     iotHubClientInstance->desired_state_callback = deviceTwinCallback;
                 }
+                iotHubClientInstance->desired_state_payload_callback = NULL;
 
                 if (iotHubClientInstance->created_with_transport_handle != 0 || deviceTwinCallback == NULL)
                 {
@@ -1477,6 +3178,88 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetDeviceTwinCallback(IOTHUB_CLIENT_HANDLE iot
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_SetDeviceTwinPayloadCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_PAYLOAD_CALLBACK deviceTwinPayloadCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_41_077: [ If iotHubClientHandle is NULL, IoTHubClient_SetDeviceTwinPayloadCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (iotHubClientHandle == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid arg (NULL)");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not start worker thread");
+        }
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_079: [ IoTHubClient_SetDeviceTwinPayloadCallback shall replace the callback set by IoTHubClient_SetDeviceTwinCallback. ]*/
+            iotHubClientInstance->desired_state_callback = NULL;
+            iotHubClientInstance->desired_state_payload_callback = deviceTwinPayloadCallback;
+
+            if (deviceTwinPayloadCallback == NULL)
+            {
+                result = IoTHubClient_LL_SetDeviceTwinCallback(iotHubClientInstance->IoTHubClientLLHandle, NULL, NULL);
+            }
+            else
+            {
+                if (iotHubClientInstance->devicetwin_user_context != NULL)
+                {
+                    free(iotHubClientInstance->devicetwin_user_context);
+                }
+
+                /*the payloads are queued whether the transport is shared or not, the callback is called by the thread dispatching the user callbacks*/
+                iotHubClientInstance->devicetwin_user_context = (IOTHUB_QUEUE_CONTEXT*)malloc(sizeof(IOTHUB_QUEUE_CONTEXT));
+                if (iotHubClientInstance->devicetwin_user_context == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Failed allocating QUEUE_CONTEXT");
+                }
+                else
+                {
+                    iotHubClientInstance->devicetwin_user_context->iotHubClientHandle = iotHubClientInstance;
+                    iotHubClientInstance->devicetwin_user_context->userContextCallback = userContextCallback;
+                    result = IoTHubClient_LL_SetDeviceTwinCallback(iotHubClientInstance->IoTHubClientLLHandle, iothub_ll_device_twin_callback, iotHubClientInstance->devicetwin_user_context);
+                    if (result != IOTHUB_CLIENT_OK)
+                    {
+                        LogError("IoTHubClient_LL_SetDeviceTwinCallback failed");
+                        free(iotHubClientInstance->devicetwin_user_context);
+                        iotHubClientInstance->devicetwin_user_context = NULL;
+                    }
+                }
+            }
+
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                iotHubClientInstance->desired_state_payload_callback = NULL;
+            }
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+    return result;
+}
+
+void IoTHubClient_ReleaseDeviceTwinPayload(unsigned char* payLoad)
+{
+    /*Codes_SRS_IOTHUBCLIENT_41_080: [ IoTHubClient_ReleaseDeviceTwinPayload shall free payLoad with the allocator of the SDK, and do nothing if it is NULL. ]*/
+    if (payLoad != NULL)
+    {
+        free(payLoad);
+    }
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_SendReportedState(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1544,13 +3327,20 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendReportedState(IOTHUB_CLIENT_HANDLE iotHubC
                     }
                 }
 
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signal_worker_thread(iotHubClientInstance);
+                }
+
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
     }
     return result;
 }
+#endif /*DONT_USE_DEVICE_TWIN*/
 
+#ifndef DONT_USE_DEVICE_METHODS
 IOTHUB_CLIENT_RESULT IoTHubClient_SetDeviceMethodCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC deviceMethodCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1745,11 +3535,16 @@ IOTHUB_CLIENT_RESULT IoTHubClient_DeviceMethodResponse(IOTHUB_CLIENT_HANDLE iotH
             {
                 LogError("IoTHubClient_LL_DeviceMethodResponse failed");
             }
+            else
+            {
+                signal_worker_thread(iotHubClientInstance);
+            }
             (void)Unlock(iotHubClientInstance->LockHandle);
         }
     }
     return result;
 }
+#endif /*DONT_USE_DEVICE_METHODS*/
 
 #ifndef DONT_USE_UPLOADTOBLOB
 static int uploadingThread(void *data)
@@ -1759,10 +3554,30 @@ static int uploadingThread(void *data)
     if (Lock(savedData->iotHubClientHandle->LockHandle) == LOCK_OK)
     {
         IOTHUB_CLIENT_FILE_UPLOAD_RESULT upload_result;
+        IOTHUB_CLIENT_RESULT ll_upload_result;
+        if (savedData->runsOnOwnThread != 0)
+        {
+            apply_thread_attributes(savedData->iotHubClientHandle, "-upload");
+        }
         /*it so happens that IoTHubClient_LL_UploadToBlob is thread-safe because there's no saved state in the handle and there are no globals, so no need to protect it*/
         /*not having it protected means multiple simultaneous uploads can happen*/
-        /*Codes_SRS_IOTHUBCLIENT_02_054: [ The thread shall call IoTHubClient_LL_UploadToBlob passing the information packed in the structure. ]*/
-        if (IoTHubClient_LL_UploadToBlob(savedData->iotHubClientHandle->IoTHubClientLLHandle, savedData->destinationFileName, savedData->source, savedData->size) == IOTHUB_CLIENT_OK)
+        if (savedData->filePath != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_066: [ The thread shall call IoTHubClient_LL_UploadFileToBlob passing destinationFileName and filePath. ]*/
+            ll_upload_result = IoTHubClient_LL_UploadFileToBlob(savedData->iotHubClientHandle->IoTHubClientLLHandle, savedData->destinationFileName, savedData->filePath);
+        }
+        else if (savedData->getDataCallback == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_02_054: [ The thread shall call IoTHubClient_LL_UploadToBlob passing the information packed in the structure. ]*/
+            ll_upload_result = IoTHubClient_LL_UploadToBlob(savedData->iotHubClientHandle->IoTHubClientLLHandle, savedData->destinationFileName, savedData->source, savedData->size);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_060: [ The thread shall call IoTHubClient_LL_UploadMultipleBlocksToBlob passing destinationFileName, getDataCallback and context. ]*/
+            ll_upload_result = IoTHubClient_LL_UploadMultipleBlocksToBlob(savedData->iotHubClientHandle->IoTHubClientLLHandle, savedData->destinationFileName, savedData->getDataCallback, savedData->context);
+        }
+
+        if (ll_upload_result == IOTHUB_CLIENT_OK)
         {
             upload_result = FILE_UPLOAD_OK;
         }
@@ -1803,6 +3618,101 @@ static int uploadingThread(void *data)
 }
 #endif
 
+#ifndef DONT_USE_UPLOADTOBLOB
+/*spawns the thread uploading savedData, savedData is freed when the thread cannot be spawned*/
+static IOTHUB_CLIENT_RESULT startUploadingThread(IOTHUB_CLIENT_HANDLE iotHubClientHandle, UPLOADTOBLOB_SAVED_DATA* savedData)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_INSTANCE* iotHubClientHandleData = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+    if ((result = StartWorkerThreadIfNeeded(iotHubClientHandleData)) != IOTHUB_CLIENT_OK)
+    {
+        free(savedData->source);
+        free(savedData->destinationFileName);
+        free(savedData);
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("Could not start worker thread");
+    }
+    else
+    {
+        if (Lock(iotHubClientHandleData->LockHandle) != LOCK_OK) /*locking because the next statement is changing blobThreadsToBeJoined*/
+        {
+            LogError("unable to lock");
+            free(savedData->source);
+            free(savedData->destinationFileName);
+            free(savedData);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_02_058: [ IoTHubClient_UploadToBlobAsync shall add the structure to the list of structures that need to be cleaned once file upload finishes. ]*/
+            LIST_ITEM_HANDLE item = singlylinkedlist_add(iotHubClientHandleData->savedDataToBeCleaned, savedData);
+            if (item == NULL)
+            {
+                LogError("unable to singlylinkedlist_add");
+                free(savedData->source);
+                free(savedData->destinationFileName);
+                free(savedData);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                savedData->iotHubClientHandle = iotHubClientHandle;
+                savedData->canBeGarbageCollected = 0;
+                if ((savedData->lockGarbage = Lock_Init()) == NULL)
+                {
+                    (void)singlylinkedlist_remove(iotHubClientHandleData->savedDataToBeCleaned, item);
+                    free(savedData->source);
+                    free(savedData->destinationFileName);
+                    free(savedData);
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("unable to Lock_Init");
+                }
+                else
+                {
+                    int startResult;
+                    savedData->runsOnOwnThread = (iotHubClientHandleData->uploadWorkerPool == NULL);
+                    if (iotHubClientHandleData->uploadWorkerPool != NULL)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_41_070: [ When the upload workers are started, IoTHubClient_UploadToBlobAsync shall queue the structure for them and schedule them instead of spawning a thread. ]*/
+                        savedData->uploadingThreadHandle = NULL;
+                        startResult = queuePendingUpload(iotHubClientHandleData, savedData);
+                    }
+                    /*Codes_SRS_IOTHUBCLIENT_02_052: [ IoTHubClient_UploadToBlobAsync shall spawn a thread passing the structure build in SRS IOTHUBCLIENT 02 051 as thread data.]*/
+                    else if (ThreadAPI_Create(&savedData->uploadingThreadHandle, uploadingThread, savedData) != THREADAPI_OK)
+                    {
+                        LogError("unablet to ThreadAPI_Create");
+                        startResult = __FAILURE__;
+                    }
+                    else
+                    {
+                        startResult = 0;
+                    }
+
+                    if (startResult != 0)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                        (void)Lock_Deinit(savedData->lockGarbage);
+                        (void)singlylinkedlist_remove(iotHubClientHandleData->savedDataToBeCleaned, item);
+                        free(savedData->source);
+                        free(savedData->destinationFileName);
+                        free(savedData);
+                        result = IOTHUB_CLIENT_ERROR;
+                    }
+                    else
+                    {
+                        result = IOTHUB_CLIENT_OK;
+                    }
+                }
+            }
+
+            (void)Unlock(iotHubClientHandleData->LockHandle);
+        }
+    }
+    return result;
+}
+#endif
+
 #ifndef DONT_USE_UPLOADTOBLOB
 IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const char* destinationFileName, const unsigned char* source, size_t size, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK iotHubClientFileUploadCallback, void* context)
 {
@@ -1877,79 +3787,13 @@ IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubC
                 }
                 else
                 {
-                    IOTHUB_CLIENT_INSTANCE* iotHubClientHandleData = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
-
                     savedData->iotHubClientFileUploadCallback = iotHubClientFileUploadCallback;
+                    savedData->getDataCallback = NULL;
+                    savedData->filePath = NULL;
                     savedData->context = context;
                     (void)memcpy(savedData->source, source, size);
 
-                    if ((result = StartWorkerThreadIfNeeded(iotHubClientHandleData)) != IOTHUB_CLIENT_OK)
-                    {
-                        free(savedData->source);
-                        free(savedData->destinationFileName);
-                        free(savedData);
-                        result = IOTHUB_CLIENT_ERROR;
-                        LogError("Could not start worker thread");
-                    }
-                    else
-                    {
-                        if (Lock(iotHubClientHandleData->LockHandle) != LOCK_OK) /*locking because the next statement is changing blobThreadsToBeJoined*/
-                        {
-                            LogError("unable to lock");
-                            free(savedData->source);
-                            free(savedData->destinationFileName);
-                            free(savedData);
-                            result = IOTHUB_CLIENT_ERROR;
-                        }
-                        else
-                        {
-                            /*Codes_SRS_IOTHUBCLIENT_02_058: [ IoTHubClient_UploadToBlobAsync shall add the structure to the list of structures that need to be cleaned once file upload finishes. ]*/
-                            LIST_ITEM_HANDLE item = singlylinkedlist_add(iotHubClientHandleData->savedDataToBeCleaned, savedData);
-                            if (item == NULL)
-                            {
-                                LogError("unable to singlylinkedlist_add");
-                                free(savedData->source);
-                                free(savedData->destinationFileName);
-                                free(savedData);
-                                result = IOTHUB_CLIENT_ERROR;
-                            }
-                            else
-                            {
-                                savedData->iotHubClientHandle = iotHubClientHandle;
-                                savedData->canBeGarbageCollected = 0;
-                                if ((savedData->lockGarbage = Lock_Init()) == NULL)
-                                {
-                                    (void)singlylinkedlist_remove(iotHubClientHandleData->savedDataToBeCleaned, item);
-                                    free(savedData->source);
-                                    free(savedData->destinationFileName);
-                                    free(savedData);
-                                    result = IOTHUB_CLIENT_ERROR;
-                                    LogError("unable to Lock_Init");
-                                }
-                                else
-                                {
-                                    /*Codes_SRS_IOTHUBCLIENT_02_052: [ IoTHubClient_UploadToBlobAsync shall spawn a thread passing the structure build in SRS IOTHUBCLIENT 02 051 as thread data.]*/
-                                    if (ThreadAPI_Create(&savedData->uploadingThreadHandle, uploadingThread, savedData) != THREADAPI_OK)
-                                    {
-                                        /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
-                                        LogError("unablet to ThreadAPI_Create");
-                                        (void)Lock_Deinit(savedData->lockGarbage);
-                                        (void)singlylinkedlist_remove(iotHubClientHandleData->savedDataToBeCleaned, item);
-                                        free(savedData->source);
-                                        free(savedData->destinationFileName);
-                                        free(savedData);
-                                        result = IOTHUB_CLIENT_ERROR;
-                                    }
-                                    else
-                                    {
-                                        result = IOTHUB_CLIENT_OK;
-                                    }
-                                }
-                            }
-
-                            (void)Unlock(iotHubClientHandleData->LockHandle);
-                        }
-                    }
+                    result = startUploadingThread(iotHubClientHandle, savedData);
                 }
             }
         }
@@ -1957,3 +3801,113 @@ IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubC
     return result;
 }
 #endif /*DONT_USE_UPLOADTOBLOB*/
+
+#ifndef DONT_USE_UPLOADTOBLOB
+IOTHUB_CLIENT_RESULT IoTHubClient_UploadMultipleBlocksToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_41_059: [ If iotHubClientHandle, destinationFileName or getDataCallback is NULL then IoTHubClient_UploadMultipleBlocksToBlobAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (getDataCallback == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_HANDLE iotHubClientHandle = %p , const char* destinationFileName = %s, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback = %p, void* context = %p",
+            iotHubClientHandle,
+            destinationFileName,
+            getDataCallback,
+            context
+        );
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_061: [ IoTHubClient_UploadMultipleBlocksToBlobAsync shall copy destinationFileName, getDataCallback and context into a structure and spawn a thread uploading it, without copying any of the file content. ]*/
+        UPLOADTOBLOB_SAVED_DATA *savedData = (UPLOADTOBLOB_SAVED_DATA *)malloc(sizeof(UPLOADTOBLOB_SAVED_DATA));
+        if (savedData == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_062: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadMultipleBlocksToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("unable to malloc - oom");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (mallocAndStrcpy_s((char**)&savedData->destinationFileName, destinationFileName) != 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_062: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadMultipleBlocksToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("unable to mallocAndStrcpy_s");
+            free(savedData);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            savedData->source = NULL;
+            savedData->size = 0;
+            savedData->iotHubClientFileUploadCallback = NULL;
+            savedData->getDataCallback = getDataCallback;
+            savedData->filePath = NULL;
+            savedData->context = context;
+
+            result = startUploadingThread(iotHubClientHandle, savedData);
+        }
+    }
+    return result;
+}
+#endif /*DONT_USE_UPLOADTOBLOB*/
+
+#ifndef DONT_USE_UPLOADTOBLOB
+IOTHUB_CLIENT_RESULT IoTHubClient_UploadFileToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const char* destinationFileName, const char* filePath, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK iotHubClientFileUploadCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_41_063: [ If iotHubClientHandle, destinationFileName or filePath is NULL then IoTHubClient_UploadFileToBlobAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (filePath == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_HANDLE iotHubClientHandle = %p , const char* destinationFileName = %s, const char* filePath = %s, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK iotHubClientFileUploadCallback = %p, void* context = %p",
+            iotHubClientHandle,
+            destinationFileName,
+            filePath,
+            iotHubClientFileUploadCallback,
+            context
+        );
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        size_t destinationFileNameLength = strlen(destinationFileName);
+        size_t filePathLength = strlen(filePath);
+        /*Codes_SRS_IOTHUBCLIENT_41_064: [ IoTHubClient_UploadFileToBlobAsync shall copy destinationFileName, filePath, iotHubClientFileUploadCallback and context into a structure and spawn a thread uploading it, without reading the file. ]*/
+        UPLOADTOBLOB_SAVED_DATA *savedData = (UPLOADTOBLOB_SAVED_DATA *)malloc(sizeof(UPLOADTOBLOB_SAVED_DATA));
+        if (savedData == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_065: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadFileToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("unable to malloc - oom");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        /*both strings in one allocation, so the structure is freed the same way for every kind of upload*/
+        else if ((savedData->destinationFileName = (char*)malloc(destinationFileNameLength + 1 + filePathLength + 1)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_065: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadFileToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("unable to malloc - oom");
+            free(savedData);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            (void)memcpy(savedData->destinationFileName, destinationFileName, destinationFileNameLength + 1);
+            (void)memcpy(savedData->destinationFileName + destinationFileNameLength + 1, filePath, filePathLength + 1);
+            savedData->filePath = savedData->destinationFileName + destinationFileNameLength + 1;
+            savedData->source = NULL;
+            savedData->size = 0;
+            savedData->iotHubClientFileUploadCallback = iotHubClientFileUploadCallback;
+            savedData->getDataCallback = NULL;
+            savedData->context = context;
+
+            result = startUploadingThread(iotHubClientHandle, savedData);
+        }
+    }
+    return result;
+}
+#endif /*DONT_USE_UPLOADTOBLOB*/
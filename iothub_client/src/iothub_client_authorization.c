@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
@@ -10,11 +12,19 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/sastoken.h"
+#include "azure_c_shared_utility/sha.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/urlencode.h"
 
 #include "iothub_client_authorization.h"
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
 #define DEFAULT_SAS_TOKEN_EXPIRY_TIME_SECS          3600
 #define INDEFINITE_TIME                             ((time_t)(-1))
+#define SAS_TOKEN_EXPIRY_TEXT_SIZE                  32
 
 typedef struct IOTHUB_AUTHORIZATION_DATA_TAG
 {
@@ -23,6 +33,12 @@ typedef struct IOTHUB_AUTHORIZATION_DATA_TAG
     char* device_id;
     size_t token_expiry_time_sec;
     IOTHUB_CREDENTIAL_TYPE cred_type;
+    /* HMAC-SHA256 state keyed with the decoded device key (inner pad already absorbed, outer pad kept),
+       built on the first token and copied for every token after it */
+    HMACContext* signing_context;
+    /* while crypto_provider has an HMAC-SHA256 it signs the tokens with signing_key, the decoded device key */
+    IOTHUB_CRYPTO_PROVIDER crypto_provider;
+    BUFFER_HANDLE signing_key;
 } IOTHUB_AUTHORIZATION_DATA;
 
 static int get_seconds_since_epoch(size_t* seconds)
@@ -42,6 +58,180 @@ static int get_seconds_since_epoch(size_t* seconds)
     return result;
 }
 
+static int create_signing_context(IOTHUB_AUTHORIZATION_DATA* handle)
+{
+    int result;
+    BUFFER_HANDLE decoded_key;
+
+    if ((decoded_key = Base64_Decoder(handle->device_key)) == NULL)
+    {
+        LogError("Failed decoding the device key");
+        result = __LINE__;
+    }
+    else
+    {
+        if ((handle->signing_context = (HMACContext*)malloc(sizeof(HMACContext))) == NULL)
+        {
+            LogError("Failed allocating the signing context");
+            result = __LINE__;
+        }
+        else
+        {
+            const unsigned char* key = BUFFER_u_char(decoded_key);
+            size_t key_length = BUFFER_length(decoded_key);
+
+            if (hmacReset(handle->signing_context, SHA256, key, (int)key_length) != shaSuccess)
+            {
+                LogError("Failed keying the signing context");
+                free(handle->signing_context);
+                handle->signing_context = NULL;
+                result = __LINE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+        BUFFER_delete(decoded_key);
+    }
+    return result;
+}
+
+static void destroy_signing_key(IOTHUB_AUTHORIZATION_DATA* handle)
+{
+    if (handle->signing_key != NULL)
+    {
+        unsigned char* key = BUFFER_u_char(handle->signing_key);
+        if (key != NULL)
+        {
+            (void)memset(key, 0, BUFFER_length(handle->signing_key));
+        }
+        BUFFER_delete(handle->signing_key);
+        handle->signing_key = NULL;
+    }
+}
+
+static int sign_with_signing_context(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* expiry_text, uint8_t* digest)
+{
+    int result;
+    HMACContext hmac_context;
+
+    /* the cached context is left keyed; only its copy absorbs the string to sign (scope + "\n" + expiry) */
+    hmac_context = *handle->signing_context;
+    if ((hmacInput(&hmac_context, (const unsigned char*)scope, (int)strlen(scope)) != shaSuccess) ||
+        (hmacInput(&hmac_context, (const unsigned char*)"\n", 1) != shaSuccess) ||
+        (hmacInput(&hmac_context, (const unsigned char*)expiry_text, (int)strlen(expiry_text)) != shaSuccess) ||
+        (hmacResult(&hmac_context, digest) != shaSuccess))
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    (void)memset(&hmac_context, 0, sizeof(hmac_context));
+    return result;
+}
+
+static int sign_with_crypto_provider(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* expiry_text, uint8_t* digest)
+{
+    int result;
+    size_t scope_length = strlen(scope);
+    size_t expiry_length = strlen(expiry_text);
+    unsigned char* string_to_sign;
+
+    if ((string_to_sign = (unsigned char*)malloc(scope_length + 1 + expiry_length)) == NULL)
+    {
+        LogError("Failed allocating the string to sign");
+        result = __LINE__;
+    }
+    else
+    {
+        const unsigned char* key = BUFFER_u_char(handle->signing_key);
+        size_t key_length = BUFFER_length(handle->signing_key);
+
+        (void)memcpy(string_to_sign, scope, scope_length);
+        string_to_sign[scope_length] = '\n';
+        (void)memcpy(string_to_sign + scope_length + 1, expiry_text, expiry_length);
+
+        /* Codes_SRS_IoTHub_Authorization_41_005: [ While a crypto provider is set, `IoTHubClient_Auth_Get_SasToken` shall sign the scope and expiry with its `hmacSha256`, given its context and the decoded device key, instead of the signing context. ] */
+        if (handle->crypto_provider.hmacSha256(handle->crypto_provider.context, key, key_length, string_to_sign, scope_length + 1 + expiry_length, digest) != 0)
+        {
+            LogError("The crypto provider failed signing");
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        free(string_to_sign);
+    }
+    return result;
+}
+
+static STRING_HANDLE create_sas_token(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* key_name, size_t expiry_time)
+{
+    STRING_HANDLE result;
+    char expiry_text[SAS_TOKEN_EXPIRY_TEXT_SIZE];
+    uint8_t digest[USHAMaxHashSize];
+
+    if (size_tToString(expiry_text, sizeof(expiry_text), expiry_time) != 0)
+    {
+        LogError("Failed converting the expiry time");
+        result = NULL;
+    }
+    else
+    {
+        if (((handle->crypto_provider.hmacSha256 != NULL) ? sign_with_crypto_provider(handle, scope, expiry_text, digest) : sign_with_signing_context(handle, scope, expiry_text, digest)) != 0)
+        {
+            LogError("Failed signing the sas token");
+            result = NULL;
+        }
+        else
+        {
+            STRING_HANDLE signature;
+            STRING_HANDLE url_encoded_signature;
+
+            if ((signature = Base64_Encode_Bytes(digest, SHA256HashSize)) == NULL)
+            {
+                LogError("Failed encoding the signature");
+                result = NULL;
+            }
+            else
+            {
+                if ((url_encoded_signature = URL_Encode(signature)) == NULL)
+                {
+                    LogError("Failed url encoding the signature");
+                    result = NULL;
+                }
+                else
+                {
+                    if ((result = STRING_construct("SharedAccessSignature sr=")) == NULL)
+                    {
+                        LogError("Failed allocating the sas token");
+                    }
+                    else if ((STRING_concat(result, scope) != 0) ||
+                        (STRING_concat(result, "&sig=") != 0) ||
+                        (STRING_concat_with_STRING(result, url_encoded_signature) != 0) ||
+                        (STRING_concat(result, "&se=") != 0) ||
+                        (STRING_concat(result, expiry_text) != 0) ||
+                        (STRING_concat(result, "&skn=") != 0) ||
+                        (STRING_concat(result, key_name) != 0))
+                    {
+                        LogError("Failed building the sas token");
+                        STRING_delete(result);
+                        result = NULL;
+                    }
+                    STRING_delete(url_encoded_signature);
+                }
+                STRING_delete(signature);
+            }
+        }
+        (void)memset(digest, 0, sizeof(digest));
+    }
+    return result;
+}
+
 IOTHUB_AUTHORIZATION_HANDLE IoTHubClient_Auth_Create(const char* device_key, const char* device_id, const char* device_sas_token)
 {
     IOTHUB_AUTHORIZATION_DATA* result;
@@ -124,6 +314,14 @@ void IoTHubClient_Auth_Destroy(IOTHUB_AUTHORIZATION_HANDLE handle)
         free(handle->device_key);
         free(handle->device_id);
         free(handle->device_sas_token);
+        if (handle->signing_context != NULL)
+        {
+            /* Codes_SRS_IoTHub_Authorization_41_003: [ IoTHubClient_Auth_Destroy shall clear the signing context before freeing it. ] */
+            (void)memset(handle->signing_context, 0, sizeof(HMACContext));
+            free(handle->signing_context);
+        }
+        /* Codes_SRS_IoTHub_Authorization_41_007: [ `IoTHubClient_Auth_Destroy` shall clear the decoded device key kept for the crypto provider before freeing it. ] */
+        destroy_signing_key(handle);
         free(handle);
     }
 }
@@ -216,11 +414,26 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
                 LogError("failure getting seconds from epoch");
                 result = NULL;
             }
+            /* Codes_SRS_IoTHub_Authorization_41_001: [ The first time `IoTHubClient_Auth_Get_SasToken` signs a token it shall base64 decode the device key and key an HMAC-SHA256 signing context with it, kept for the tokens after it. ] */
+            /* Codes_SRS_IoTHub_Authorization_41_006: [ The first time `IoTHubClient_Auth_Get_SasToken` signs a token with a crypto provider it shall base64 decode the device key, kept for the tokens after it, instead of keying a signing context. ] */
+            else if (handle->crypto_provider.hmacSha256 != NULL && handle->signing_key == NULL && (handle->signing_key = Base64_Decoder(handle->device_key)) == NULL)
+            {
+                /* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
+                LogError("failure decoding the device key");
+                result = NULL;
+            }
+            else if (handle->crypto_provider.hmacSha256 == NULL && handle->signing_context == NULL && create_signing_context(handle) != 0)
+            {
+                /* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
+                LogError("failure creating the signing context");
+                result = NULL;
+            }
             else 
             {
-                /* Codes_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall call SASToken_CreateString to construct the sas token. ] */
+                /* Codes_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall construct the sas token. ] */
+                /* Codes_SRS_IoTHub_Authorization_41_002: [ `IoTHubClient_Auth_Get_SasToken` shall sign the scope and expiry with a copy of the signing context, leaving the signing context unchanged. ] */
                 size_t expiry_time = sec_since_epoch+expire_time;
-                if ( (sas_token = SASToken_CreateString(handle->device_key, scope, key_name, expiry_time)) == NULL)
+                if ( (sas_token = create_sas_token(handle, scope, key_name, expiry_time)) == NULL)
                 {
                     /* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
                     LogError("Failed creating sas_token");
@@ -327,3 +540,29 @@ SAS_TOKEN_STATUS IoTHubClient_Auth_Is_SasToken_Valid(IOTHUB_AUTHORIZATION_HANDLE
     }
     return result;
 }
+
+int IoTHubClient_Auth_Set_Crypto_Provider(IOTHUB_AUTHORIZATION_HANDLE handle, const IOTHUB_CRYPTO_PROVIDER* crypto_provider)
+{
+    int result;
+    if (handle == NULL)
+    {
+        /* Codes_SRS_IoTHub_Authorization_41_004: [ if `handle` is NULL, `IoTHubClient_Auth_Set_Crypto_Provider` shall fail and return a non-zero value. ] */
+        LogError("Invalid Parameter handle: %p", handle);
+        result = __LINE__;
+    }
+    else
+    {
+        /* Codes_SRS_IoTHub_Authorization_41_008: [ `IoTHubClient_Auth_Set_Crypto_Provider` shall keep a copy of `crypto_provider`, none when it is NULL or has no `hmacSha256`, clear the decoded device key it kept for the previous one and return 0. ] */
+        destroy_signing_key(handle);
+        if ((crypto_provider == NULL) || (crypto_provider->hmacSha256 == NULL))
+        {
+            (void)memset(&handle->crypto_provider, 0, sizeof(handle->crypto_provider));
+        }
+        else
+        {
+            handle->crypto_provider = *crypto_provider;
+        }
+        result = 0;
+    }
+    return result;
+}
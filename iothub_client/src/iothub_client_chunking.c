@@ -0,0 +1,166 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/uniqueid.h"
+
+#include "iothub_client_chunking.h"
+
+/*the longest decimal size_t and its '\0'*/
+#define SIZE_TEXT_LENGTH 21
+
+static int get_payload(IOTHUB_MESSAGE_HANDLE message, const unsigned char** payload, size_t* size)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message);
+    if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        if (IoTHubMessage_GetByteArray(message, payload, size) != IOTHUB_MESSAGE_OK)
+        {
+            LogError("IoTHubMessage_GetByteArray failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    else if (contentType == IOTHUBMESSAGE_STRING)
+    {
+        const char* text = IoTHubMessage_GetString(message);
+        if (text == NULL)
+        {
+            LogError("IoTHubMessage_GetString failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            *payload = (const unsigned char*)text;
+            *size = strlen(text);
+            result = 0;
+        }
+    }
+    else
+    {
+        LogError("unknown message content type %d", (int)contentType);
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+size_t chunking_get_chunk_count(IOTHUB_MESSAGE_HANDLE message, size_t maxChunkSize)
+{
+    size_t result;
+    const unsigned char* payload;
+    size_t size;
+    /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_001: [ If message is NULL, maxChunkSize is 0 or the payload of message cannot be read, chunking_get_chunk_count shall return 0. ]*/
+    if ((message == NULL) || (maxChunkSize == 0))
+    {
+        LogError("invalid argument message=%p, maxChunkSize=%lu", message, (unsigned long)maxChunkSize);
+        result = 0;
+    }
+    else if (get_payload(message, &payload, &size) != 0)
+    {
+        result = 0;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_002: [ Otherwise chunking_get_chunk_count shall return the number of chunks of at most maxChunkSize bytes of the payload, 1 for an empty payload. ]*/
+    else if (size == 0)
+    {
+        result = 1;
+    }
+    else
+    {
+        result = (size / maxChunkSize) + (((size % maxChunkSize) == 0) ? 0 : 1);
+    }
+    return result;
+}
+
+const char* chunking_get_chunk_id(IOTHUB_MESSAGE_HANDLE message, char* generatedId)
+{
+    const char* result;
+    if ((message == NULL) || (generatedId == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_003: [ If message or generatedId is NULL, chunking_get_chunk_id shall fail and return NULL. ]*/
+        LogError("invalid argument message=%p, generatedId=%p", message, generatedId);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_004: [ chunking_get_chunk_id shall return the message id of message if it has one. ]*/
+    else if ((result = IoTHubMessage_GetMessageId(message)) != NULL)
+    {
+        /*the chunks share it*/
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_005: [ Otherwise chunking_get_chunk_id shall generate a UUID in generatedId with UniqueId_Generate and return generatedId, NULL if it fails. ]*/
+    else if (UniqueId_Generate(generatedId, CHUNKING_GENERATED_ID_SIZE) != UNIQUEID_OK)
+    {
+        LogError("UniqueId_Generate failed");
+        result = NULL;
+    }
+    else
+    {
+        result = generatedId;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_HANDLE chunking_create_chunk(IOTHUB_MESSAGE_HANDLE message, const char* chunkId, size_t maxChunkSize, size_t index, size_t count)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    const unsigned char* payload;
+    size_t size;
+    /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_006: [ If message or chunkId is NULL, maxChunkSize is 0 or index is not less than count, chunking_create_chunk shall fail and return NULL. ]*/
+    if ((message == NULL) || (chunkId == NULL) || (maxChunkSize == 0) || (index >= count))
+    {
+        LogError("invalid argument message=%p, chunkId=%p, maxChunkSize=%lu, index=%lu, count=%lu", message, chunkId, (unsigned long)maxChunkSize, (unsigned long)index, (unsigned long)count);
+        result = NULL;
+    }
+    else if (get_payload(message, &payload, &size) != 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_009: [ If any error occurs, chunking_create_chunk shall fail and return NULL. ]*/
+        result = NULL;
+    }
+    else if ((index > 0) && (index >= (size + maxChunkSize - 1) / maxChunkSize))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_006: [ If message or chunkId is NULL, maxChunkSize is 0 or index is not less than count, chunking_create_chunk shall fail and return NULL. ]*/
+        LogError("chunk %lu is past the payload of %lu bytes", (unsigned long)index, (unsigned long)size);
+        result = NULL;
+    }
+    else
+    {
+        size_t offset = index * maxChunkSize;
+        size_t chunkSize = (size - offset < maxChunkSize) ? size - offset : maxChunkSize;
+        /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_007: [ chunking_create_chunk shall create the chunk with IoTHubMessage_CreateFromPrototype, with the bytes of the payload of message from index times maxChunkSize, at most maxChunkSize of them, and the properties of message. ]*/
+        if ((result = IoTHubMessage_CreateFromPrototype(message, payload + offset, chunkSize)) == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_009: [ If any error occurs, chunking_create_chunk shall fail and return NULL. ]*/
+            LogError("IoTHubMessage_CreateFromPrototype failed");
+        }
+        else
+        {
+            char indexText[SIZE_TEXT_LENGTH];
+            char countText[SIZE_TEXT_LENGTH];
+            MAP_HANDLE properties;
+            (void)sprintf(indexText, "%lu", (unsigned long)index);
+            (void)sprintf(countText, "%lu", (unsigned long)count);
+
+            /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_008: [ chunking_create_chunk shall set the application properties chunk-id to chunkId, chunk-index to index and chunk-total to count, in decimal, of the chunk, the properties of message being left as they are. ]*/
+            if (((properties = IoTHubMessage_Properties(result)) == NULL) ||
+                (Map_AddOrUpdate(properties, CHUNKING_ID_PROPERTY, chunkId) != MAP_OK) ||
+                (Map_AddOrUpdate(properties, CHUNKING_INDEX_PROPERTY, indexText) != MAP_OK) ||
+                (Map_AddOrUpdate(properties, CHUNKING_TOTAL_PROPERTY, countText) != MAP_OK))
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_CHUNKING_41_009: [ If any error occurs, chunking_create_chunk shall fail and return NULL. ]*/
+                LogError("unable to set the chunk properties");
+                IoTHubMessage_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
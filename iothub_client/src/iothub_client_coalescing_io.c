@@ -0,0 +1,371 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <string.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/xio.h"
+
+#include "iothub_client_options.h"
+#include "iothub_client_coalescing_io.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+typedef struct HELD_SEND_TAG
+{
+    ON_SEND_COMPLETE on_send_complete;
+    void* callback_context;
+} HELD_SEND;
+
+/*the callbacks of the sends of one write, completed together when the underlying IO completes it*/
+typedef struct FLUSHED_SENDS_TAG
+{
+    size_t count;
+    HELD_SEND* sends;
+} FLUSHED_SENDS;
+
+typedef struct COALESCING_IO_INSTANCE_TAG
+{
+    XIO_HANDLE underlying_io;
+    size_t buffer_size;
+    bool is_corked;
+    unsigned char* buffer; /*allocated on the first send held*/
+    size_t held_size;
+    HELD_SEND* held_sends; /*the sends held that have a callback*/
+    size_t held_send_count;
+    size_t held_send_capacity;
+    ON_IO_ERROR on_io_error;
+    void* on_io_error_context;
+} COALESCING_IO_INSTANCE;
+
+static void complete_sends(HELD_SEND* sends, size_t count, IO_SEND_RESULT send_result)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        sends[i].on_send_complete(sends[i].callback_context, send_result);
+    }
+}
+
+static void on_flushed(void* context, IO_SEND_RESULT send_result)
+{
+    FLUSHED_SENDS* flushed_sends = (FLUSHED_SENDS*)context;
+    /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_011: [ When the underlying IO completes the write, the callbacks of all the sends it holds shall be called with its result, in the order of the sends. ]*/
+    complete_sends(flushed_sends->sends, flushed_sends->count, send_result);
+    free(flushed_sends);
+}
+
+static int flush(COALESCING_IO_INSTANCE* instance)
+{
+    int result;
+
+    if (instance->held_size == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t held_size = instance->held_size;
+        size_t held_send_count = instance->held_send_count;
+        FLUSHED_SENDS* flushed_sends = NULL;
+
+        // The callbacks may send again, the IO is empty before any of them is called
+        instance->held_size = 0;
+        instance->held_send_count = 0;
+
+        if ((held_send_count != 0) &&
+            ((flushed_sends = (FLUSHED_SENDS*)malloc(sizeof(FLUSHED_SENDS) + held_send_count * sizeof(HELD_SEND))) == NULL))
+        {
+            LogError("unable to malloc");
+            /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_012: [ If the flush fails, the callbacks of the sends held shall be called with IO_SEND_ERROR and the on_io_error of the open shall be called. ]*/
+            complete_sends(instance->held_sends, held_send_count, IO_SEND_ERROR);
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (flushed_sends != NULL)
+            {
+                flushed_sends->count = held_send_count;
+                flushed_sends->sends = (HELD_SEND*)(flushed_sends + 1);
+                (void)memcpy(flushed_sends->sends, instance->held_sends, held_send_count * sizeof(HELD_SEND));
+            }
+
+            /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_010: [ A flush shall send the bytes held to the underlying IO with one xio_send. ]*/
+            if (xio_send(instance->underlying_io, instance->buffer, held_size, (flushed_sends == NULL) ? NULL : on_flushed, flushed_sends) != 0)
+            {
+                LogError("xio_send failed");
+                if (flushed_sends != NULL)
+                {
+                    /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_012: [ If the flush fails, the callbacks of the sends held shall be called with IO_SEND_ERROR and the on_io_error of the open shall be called. ]*/
+                    on_flushed(flushed_sends, IO_SEND_ERROR);
+                }
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+
+        if ((result != 0) && (instance->on_io_error != NULL))
+        {
+            instance->on_io_error(instance->on_io_error_context);
+        }
+    }
+
+    return result;
+}
+
+static int hold(COALESCING_IO_INSTANCE* instance, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+
+    if ((instance->buffer == NULL) && ((instance->buffer = (unsigned char*)malloc(instance->buffer_size)) == NULL))
+    {
+        LogError("unable to malloc");
+        result = __FAILURE__;
+    }
+    else if ((on_send_complete != NULL) && (instance->held_send_count == instance->held_send_capacity))
+    {
+        size_t new_capacity = (instance->held_send_capacity == 0) ? 4 : instance->held_send_capacity * 2;
+        HELD_SEND* new_sends = (HELD_SEND*)realloc(instance->held_sends, new_capacity * sizeof(HELD_SEND));
+        if (new_sends == NULL)
+        {
+            LogError("unable to realloc");
+            result = __FAILURE__;
+        }
+        else
+        {
+            instance->held_sends = new_sends;
+            instance->held_send_capacity = new_capacity;
+            result = 0;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if (result == 0)
+    {
+        (void)memcpy(instance->buffer + instance->held_size, buffer, size);
+        instance->held_size += size;
+        if (on_send_complete != NULL)
+        {
+            instance->held_sends[instance->held_send_count].on_send_complete = on_send_complete;
+            instance->held_sends[instance->held_send_count].callback_context = callback_context;
+            instance->held_send_count++;
+        }
+    }
+
+    return result;
+}
+
+static CONCRETE_IO_HANDLE coalescing_io_create(void* io_create_parameters)
+{
+    COALESCING_IO_INSTANCE* result;
+    COALESCING_IO_CONFIG* config = (COALESCING_IO_CONFIG*)io_create_parameters;
+
+    /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_001: [ If io_create_parameters or its underlying_io is NULL, or its buffer_size is 0, coalescing_io_create shall fail and return NULL. ]*/
+    if ((config == NULL) || (config->underlying_io == NULL) || (config->buffer_size == 0))
+    {
+        LogError("invalid argument io_create_parameters(%p)", config);
+        result = NULL;
+    }
+    else if ((result = (COALESCING_IO_INSTANCE*)malloc(sizeof(COALESCING_IO_INSTANCE))) == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else
+    {
+        bool tcp_nodelay = true;
+
+        /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_002: [ coalescing_io_create shall return an uncorked IO over underlying_io, without allocating its buffer. ]*/
+        (void)memset(result, 0, sizeof(COALESCING_IO_INSTANCE));
+        result->underlying_io = config->underlying_io;
+        result->buffer_size = config->buffer_size;
+
+        /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_003: [ coalescing_io_create shall set OPTION_XIO_TCP_NODELAY to true on underlying_io, a failure being ignored. ]*/
+        if (xio_setoption(result->underlying_io, OPTION_XIO_TCP_NODELAY, &tcp_nodelay) != 0)
+        {
+            LogInfo("the underlying IO keeps its Nagle setting");
+        }
+    }
+    return result;
+}
+
+static void coalescing_io_destroy(CONCRETE_IO_HANDLE coalescing_io)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_004: [ If coalescing_io is NULL, coalescing_io_destroy shall do nothing, otherwise it shall call the callbacks of the sends still held with IO_SEND_CANCELLED and free the instance, leaving the underlying IO to its owner. ]*/
+    if (coalescing_io != NULL)
+    {
+        COALESCING_IO_INSTANCE* instance = (COALESCING_IO_INSTANCE*)coalescing_io;
+        complete_sends(instance->held_sends, instance->held_send_count, IO_SEND_CANCELLED);
+        free(instance->held_sends);
+        free(instance->buffer);
+        free(instance);
+    }
+}
+
+static int coalescing_io_open(CONCRETE_IO_HANDLE coalescing_io, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+    int result;
+    if (coalescing_io == NULL)
+    {
+        LogError("invalid argument coalescing_io(NULL)");
+        result = __FAILURE__;
+    }
+    else
+    {
+        COALESCING_IO_INSTANCE* instance = (COALESCING_IO_INSTANCE*)coalescing_io;
+        /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_005: [ coalescing_io_open shall uncork the IO and open the underlying IO with xio_open and the callbacks it was given. ]*/
+        instance->is_corked = false;
+        instance->on_io_error = on_io_error;
+        instance->on_io_error_context = on_io_error_context;
+        result = xio_open(instance->underlying_io, on_io_open_complete, on_io_open_complete_context, on_bytes_received, on_bytes_received_context, on_io_error, on_io_error_context);
+    }
+    return result;
+}
+
+static int coalescing_io_close(CONCRETE_IO_HANDLE coalescing_io, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+    int result;
+    if (coalescing_io == NULL)
+    {
+        LogError("invalid argument coalescing_io(NULL)");
+        result = __FAILURE__;
+    }
+    else
+    {
+        COALESCING_IO_INSTANCE* instance = (COALESCING_IO_INSTANCE*)coalescing_io;
+        /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_006: [ coalescing_io_close shall flush the bytes held, uncork the IO and close the underlying IO with xio_close. ]*/
+        instance->on_io_error = NULL;
+        (void)flush(instance);
+        instance->is_corked = false;
+        result = xio_close(instance->underlying_io, on_io_close_complete, callback_context);
+    }
+    return result;
+}
+
+static int coalescing_io_send(CONCRETE_IO_HANDLE coalescing_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+    if ((coalescing_io == NULL) || (buffer == NULL) || (size == 0))
+    {
+        LogError("invalid argument coalescing_io(%p), buffer(%p), size(%lu)", coalescing_io, buffer, (unsigned long)size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        COALESCING_IO_INSTANCE* instance = (COALESCING_IO_INSTANCE*)coalescing_io;
+
+        if (!instance->is_corked)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_007: [ While uncorked, coalescing_io_send shall send with xio_send on the underlying IO. ]*/
+            result = xio_send(instance->underlying_io, buffer, size, on_send_complete, callback_context);
+        }
+        /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_008: [ While corked, coalescing_io_send shall flush first if the bytes held and size exceed buffer_size, and fail if that flush fails. ]*/
+        else if ((size > instance->buffer_size - instance->held_size) && (flush(instance) != 0))
+        {
+            result = __FAILURE__;
+        }
+        else if (size >= instance->buffer_size)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_009: [ A send of buffer_size bytes or more shall then be sent with xio_send on the underlying IO, any other shall be copied to the buffer, held with its callback, and coalescing_io_send shall return 0. ]*/
+            result = xio_send(instance->underlying_io, buffer, size, on_send_complete, callback_context);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_009: [ A send of buffer_size bytes or more shall then be sent with xio_send on the underlying IO, any other shall be copied to the buffer, held with its callback, and coalescing_io_send shall return 0. ]*/
+            result = hold(instance, buffer, size, on_send_complete, callback_context);
+        }
+    }
+    return result;
+}
+
+static void coalescing_io_dowork(CONCRETE_IO_HANDLE coalescing_io)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_013: [ coalescing_io_dowork shall call xio_dowork on the underlying IO. ]*/
+    if (coalescing_io != NULL)
+    {
+        xio_dowork(((COALESCING_IO_INSTANCE*)coalescing_io)->underlying_io);
+    }
+}
+
+static int coalescing_io_setoption(CONCRETE_IO_HANDLE coalescing_io, const char* optionName, const void* value)
+{
+    int result;
+    if ((coalescing_io == NULL) || (optionName == NULL))
+    {
+        LogError("invalid argument coalescing_io(%p), optionName(%p)", coalescing_io, optionName);
+        result = __FAILURE__;
+    }
+    else
+    {
+        COALESCING_IO_INSTANCE* instance = (COALESCING_IO_INSTANCE*)coalescing_io;
+        if (strcmp(COALESCING_IO_OPTION_CORK, optionName) == 0)
+        {
+            if (value == NULL)
+            {
+                LogError("invalid %s (NULL)", COALESCING_IO_OPTION_CORK);
+                result = __FAILURE__;
+            }
+            else if (*(const bool*)value)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_014: [ If optionName is COALESCING_IO_OPTION_CORK and value is true, coalescing_io_setoption shall cork the IO and return 0. ]*/
+                instance->is_corked = true;
+                result = 0;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_015: [ If optionName is COALESCING_IO_OPTION_CORK and value is false, coalescing_io_setoption shall flush the bytes held, uncork the IO and return whether the flush succeeded. ]*/
+                result = flush(instance);
+                instance->is_corked = false;
+            }
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_016: [ Any other option shall be given to the underlying IO with xio_setoption. ]*/
+            result = xio_setoption(instance->underlying_io, optionName, value);
+        }
+    }
+    return result;
+}
+
+/*Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_017: [ coalescing_io_retrieveoptions shall return the options of the underlying IO with xio_retrieveoptions. ]*/
+static OPTIONHANDLER_HANDLE coalescing_io_retrieveoptions(CONCRETE_IO_HANDLE coalescing_io)
+{
+    OPTIONHANDLER_HANDLE result;
+    if (coalescing_io == NULL)
+    {
+        LogError("invalid argument coalescing_io(NULL)");
+        result = NULL;
+    }
+    else
+    {
+        result = xio_retrieveoptions(((COALESCING_IO_INSTANCE*)coalescing_io)->underlying_io);
+    }
+    return result;
+}
+
+static const IO_INTERFACE_DESCRIPTION coalescing_io_interface_description =
+{
+    coalescing_io_retrieveoptions,
+    coalescing_io_create,
+    coalescing_io_destroy,
+    coalescing_io_open,
+    coalescing_io_close,
+    coalescing_io_send,
+    coalescing_io_dowork,
+    coalescing_io_setoption
+};
+
+const IO_INTERFACE_DESCRIPTION* coalescing_io_get_interface_description(void)
+{
+    return &coalescing_io_interface_description;
+}
@@ -0,0 +1,241 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <string.h>
+#include <limits.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "iothub_client_compression.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+#ifdef USE_COMPRESSION
+
+#include "zlib.h"
+
+/*windowBits above 15 make deflate write a gzip header and trailer instead of a zlib one*/
+#define COMPRESSION_GZIP_WINDOW_BITS (15 + 16)
+#define COMPRESSION_MEMORY_LEVEL 8
+
+typedef struct COMPRESSOR_TAG
+{
+    z_stream stream;
+    unsigned char* output;
+    size_t outputSize;
+} COMPRESSOR;
+
+COMPRESSOR_HANDLE compressor_create(int level)
+{
+    COMPRESSOR* result;
+    /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_001: [ If level is not between 1 and 9, compressor_create shall fail and return NULL. ]*/
+    if ((level < 1) || (level > 9))
+    {
+        LogError("invalid compression level %d", level);
+        result = NULL;
+    }
+    else if ((result = (COMPRESSOR*)malloc(sizeof(COMPRESSOR))) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_003: [ If any error occurs, compressor_create shall fail and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_002: [ compressor_create shall initialize a deflate stream writing gzip with level and return a non-NULL handle. ]*/
+        (void)memset(&result->stream, 0, sizeof(result->stream));
+        if (deflateInit2(&result->stream, level, Z_DEFLATED, COMPRESSION_GZIP_WINDOW_BITS, COMPRESSION_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_003: [ If any error occurs, compressor_create shall fail and return NULL. ]*/
+            LogError("deflateInit2 failed");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->output = NULL;
+            result->outputSize = 0;
+        }
+    }
+    return result;
+}
+
+void compressor_destroy(COMPRESSOR_HANDLE compressor)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_004: [ If compressor is NULL, compressor_destroy shall do nothing. ]*/
+    if (compressor == NULL)
+    {
+        LogError("invalid argument compressor(NULL)");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_005: [ compressor_destroy shall end the deflate stream and free the output buffer and the compressor. ]*/
+        (void)deflateEnd(&compressor->stream);
+        free(compressor->output);
+        free(compressor);
+    }
+}
+
+static int get_payload(IOTHUB_MESSAGE_HANDLE message, const unsigned char** payload, size_t* size)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message);
+    if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        if (IoTHubMessage_GetByteArray(message, payload, size) != IOTHUB_MESSAGE_OK)
+        {
+            LogError("IoTHubMessage_GetByteArray failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    else if (contentType == IOTHUBMESSAGE_STRING)
+    {
+        const char* text = IoTHubMessage_GetString(message);
+        if (text == NULL)
+        {
+            LogError("IoTHubMessage_GetString failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            *payload = (const unsigned char*)text;
+            *size = strlen(text);
+            result = 0;
+        }
+    }
+    else
+    {
+        LogError("unknown content type %d", (int)contentType);
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+/*grows the output buffer to the largest size the payload can deflate to, it is kept for the next messages*/
+static int reserve_output(COMPRESSOR* compressor, size_t payloadSize)
+{
+    int result;
+    uLong bound = deflateBound(&compressor->stream, (uLong)payloadSize);
+    if (bound <= compressor->outputSize)
+    {
+        result = 0;
+    }
+    else
+    {
+        unsigned char* output = (unsigned char*)realloc(compressor->output, bound);
+        if (output == NULL)
+        {
+            LogError("unable to realloc");
+            result = __FAILURE__;
+        }
+        else
+        {
+            compressor->output = output;
+            compressor->outputSize = bound;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_HANDLE compressor_compress_message(COMPRESSOR_HANDLE compressor, IOTHUB_MESSAGE_HANDLE message)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    const unsigned char* payload;
+    size_t payloadSize;
+    /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_006: [ If compressor or message is NULL, compressor_compress_message shall fail and return NULL. ]*/
+    if ((compressor == NULL) || (message == NULL))
+    {
+        LogError("invalid argument compressor(%p), message(%p)", compressor, message);
+        result = NULL;
+    }
+    else if (get_payload(message, &payload, &payloadSize) != 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_010: [ If any error occurs, compressor_compress_message shall fail and return NULL. ]*/
+        LogError("unable to get the payload of the message");
+        result = NULL;
+    }
+    else if ((payloadSize > UINT_MAX) || (reserve_output(compressor, payloadSize) != 0) || (compressor->outputSize > UINT_MAX))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_010: [ If any error occurs, compressor_compress_message shall fail and return NULL. ]*/
+        LogError("unable to make room to compress %lu bytes", (unsigned long)payloadSize);
+        result = NULL;
+    }
+    else if (deflateReset(&compressor->stream) != Z_OK)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_010: [ If any error occurs, compressor_compress_message shall fail and return NULL. ]*/
+        LogError("deflateReset failed");
+        result = NULL;
+    }
+    else
+    {
+        int deflateResult;
+        /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_007: [ compressor_compress_message shall deflate the payload of message as gzip into the output buffer of the compressor, reusing the deflate stream and the buffer of the previous messages. ]*/
+        compressor->stream.next_in = (Bytef*)payload;
+        compressor->stream.avail_in = (uInt)payloadSize;
+        compressor->stream.next_out = compressor->output;
+        compressor->stream.avail_out = (uInt)compressor->outputSize;
+        deflateResult = deflate(&compressor->stream, Z_FINISH);
+        if (deflateResult != Z_STREAM_END)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_010: [ If any error occurs, compressor_compress_message shall fail and return NULL. ]*/
+            LogError("deflate failed with %d", deflateResult);
+            result = NULL;
+        }
+        else if (compressor->stream.total_out >= payloadSize)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_008: [ If the gzip payload is not smaller than the payload, compressor_compress_message shall return NULL. ]*/
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_009: [ compressor_compress_message shall return a message created by IoTHubMessage_CreateFromPrototype with message and the gzip payload, with the application property content-encoding set to gzip. ]*/
+        else if ((result = IoTHubMessage_CreateFromPrototype(message, compressor->output, (size_t)compressor->stream.total_out)) == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_010: [ If any error occurs, compressor_compress_message shall fail and return NULL. ]*/
+            LogError("IoTHubMessage_CreateFromPrototype failed");
+        }
+        else
+        {
+            MAP_HANDLE properties = IoTHubMessage_Properties(result);
+            if ((properties == NULL) ||
+                (Map_AddOrUpdate(properties, COMPRESSION_CONTENT_ENCODING_PROPERTY, COMPRESSION_CONTENT_ENCODING_GZIP) != MAP_OK))
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_010: [ If any error occurs, compressor_compress_message shall fail and return NULL. ]*/
+                LogError("unable to set the content encoding of the message");
+                IoTHubMessage_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
+
+#else /* USE_COMPRESSION */
+
+COMPRESSOR_HANDLE compressor_create(int level)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_COMPRESSION_41_011: [ If the SDK is built without use_compression, compressor_create shall fail and return NULL. ]*/
+    LogError("compression level %d requested, the SDK is built without use_compression", level);
+    return NULL;
+}
+
+void compressor_destroy(COMPRESSOR_HANDLE compressor)
+{
+    (void)compressor;
+}
+
+IOTHUB_MESSAGE_HANDLE compressor_compress_message(COMPRESSOR_HANDLE compressor, IOTHUB_MESSAGE_HANDLE message)
+{
+    (void)compressor;
+    (void)message;
+    return NULL;
+}
+
+#endif /* USE_COMPRESSION */
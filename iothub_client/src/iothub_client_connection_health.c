@@ -0,0 +1,224 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_connection_health.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+typedef struct CONNECTION_HEALTH_TAG
+{
+    unsigned int minimumTimeoutInMs;
+    unsigned int maximumTimeoutInMs;
+    bool isMeasured; /*srtt and rttvar hold a round trip time*/
+    tickcounter_ms_t srtt;
+    tickcounter_ms_t rttvar;
+    unsigned int timeoutInMs;
+    bool isWaiting; /*acknowledgements are waited for since waitingSince, the last time one came*/
+    tickcounter_ms_t waitingSince;
+    bool isProbing;
+    tickcounter_ms_t probeSentMs;
+} CONNECTION_HEALTH;
+
+static void forget_waiting(CONNECTION_HEALTH* health)
+{
+    health->isWaiting = false;
+    health->isProbing = false;
+}
+
+static void add_sample(CONNECTION_HEALTH* health, tickcounter_ms_t rtt)
+{
+    tickcounter_ms_t timeout;
+
+    if (!health->isMeasured)
+    {
+        health->srtt = rtt;
+        health->rttvar = rtt / 2;
+        health->isMeasured = true;
+    }
+    else
+    {
+        tickcounter_ms_t delta = (health->srtt > rtt) ? (health->srtt - rtt) : (rtt - health->srtt);
+        health->rttvar = (3 * health->rttvar + delta) / 4;
+        health->srtt = (7 * health->srtt + rtt) / 8;
+    }
+
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_007: [ Once measured, the timeout shall be the smoothed round trip time and four times its variation, no less than minimumTimeoutInMs and no more than maximumTimeoutInMs. ]*/
+    timeout = health->srtt + 4 * health->rttvar;
+    health->timeoutInMs = (timeout < health->minimumTimeoutInMs) ? health->minimumTimeoutInMs :
+        (timeout > health->maximumTimeoutInMs) ? health->maximumTimeoutInMs :
+        (unsigned int)timeout;
+}
+
+CONNECTION_HEALTH_HANDLE connection_health_create(const IOTHUB_CONNECTION_HEALTH_OPTIONS* options)
+{
+    CONNECTION_HEALTH* result;
+
+    if ((options == NULL) || (options->minimumTimeoutInMs == 0) || (options->maximumTimeoutInMs < options->minimumTimeoutInMs))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_001: [ If options is NULL, its minimumTimeoutInMs is 0 or its maximumTimeoutInMs is less than its minimumTimeoutInMs, connection_health_create shall fail and return NULL. ]*/
+        LogError("invalid argument options=%p", options);
+        result = NULL;
+    }
+    else if ((result = (CONNECTION_HEALTH*)malloc(sizeof(CONNECTION_HEALTH))) == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_002: [ connection_health_create shall return a monitor waiting for nothing, with no round trip time and a timeout of maximumTimeoutInMs. ]*/
+        (void)memset(result, 0, sizeof(CONNECTION_HEALTH));
+        result->minimumTimeoutInMs = options->minimumTimeoutInMs;
+        result->maximumTimeoutInMs = options->maximumTimeoutInMs;
+        result->timeoutInMs = options->maximumTimeoutInMs;
+    }
+    return result;
+}
+
+void connection_health_destroy(CONNECTION_HEALTH_HANDLE health)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_003: [ If health is NULL, connection_health_destroy shall do nothing, otherwise it shall free it. ]*/
+    if (health != NULL)
+    {
+        free(health);
+    }
+}
+
+void connection_health_on_connected(CONNECTION_HEALTH_HANDLE health)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_004: [ connection_health_on_connected shall forget the acknowledgements and the probe waited for and keep the round trip time. ]*/
+    if (health != NULL)
+    {
+        forget_waiting(health);
+    }
+}
+
+void connection_health_on_sent(CONNECTION_HEALTH_HANDLE health, tickcounter_ms_t nowMs)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_005: [ connection_health_on_sent shall start waiting for acknowledgements at nowMs, unless they are already waited for. ]*/
+    if ((health != NULL) && !health->isWaiting)
+    {
+        health->isWaiting = true;
+        health->waitingSince = nowMs;
+    }
+}
+
+void connection_health_on_acked(CONNECTION_HEALTH_HANDLE health, tickcounter_ms_t sentMs, bool isResent, tickcounter_ms_t nowMs)
+{
+    if (health != NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_006: [ connection_health_on_acked shall measure the round trip time from sentMs to nowMs, unless isResent is true, and the next acknowledgement shall be waited for from nowMs. ]*/
+        if (!isResent && (nowMs >= sentMs))
+        {
+            add_sample(health, nowMs - sentMs);
+        }
+        health->isWaiting = true;
+        health->waitingSince = nowMs;
+    }
+}
+
+void connection_health_on_probe_acked(CONNECTION_HEALTH_HANDLE health, tickcounter_ms_t nowMs)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_008: [ If a probe is waited for, connection_health_on_probe_acked shall measure its round trip time, stop waiting for it and wait for the next acknowledgement from nowMs; it shall do nothing otherwise. ]*/
+    if ((health != NULL) && health->isProbing)
+    {
+        if (nowMs >= health->probeSentMs)
+        {
+            add_sample(health, nowMs - health->probeSentMs);
+        }
+        health->isProbing = false;
+        health->isWaiting = true;
+        health->waitingSince = nowMs;
+    }
+}
+
+CONNECTION_HEALTH_ACTION connection_health_check(CONNECTION_HEALTH_HANDLE health, bool isWaitingForAcks, tickcounter_ms_t nowMs)
+{
+    CONNECTION_HEALTH_ACTION result;
+
+    if (health == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_012: [ If health is NULL, connection_health_check shall return CONNECTION_HEALTH_ACTION_NONE. ]*/
+        LogError("invalid argument health=NULL");
+        result = CONNECTION_HEALTH_ACTION_NONE;
+    }
+    else if (!isWaitingForAcks)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_009: [ If isWaitingForAcks is false, connection_health_check shall forget the acknowledgements and the probe waited for, if it is true while no acknowledgement was waited for, they shall be waited for from nowMs, and it shall return CONNECTION_HEALTH_ACTION_NONE. ]*/
+        forget_waiting(health);
+        result = CONNECTION_HEALTH_ACTION_NONE;
+    }
+    else if (health->isProbing)
+    {
+        if (nowMs - health->probeSentMs >= health->timeoutInMs)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_011: [ Once the probe has been waited for the timeout, connection_health_check shall forget the acknowledgements and the probe waited for and return CONNECTION_HEALTH_ACTION_RECONNECT. ]*/
+            forget_waiting(health);
+            result = CONNECTION_HEALTH_ACTION_RECONNECT;
+        }
+        else
+        {
+            result = CONNECTION_HEALTH_ACTION_NONE;
+        }
+    }
+    else if (!health->isWaiting)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_009: [ If isWaitingForAcks is false, connection_health_check shall forget the acknowledgements and the probe waited for, if it is true while no acknowledgement was waited for, they shall be waited for from nowMs, and it shall return CONNECTION_HEALTH_ACTION_NONE. ]*/
+        health->isWaiting = true;
+        health->waitingSince = nowMs;
+        result = CONNECTION_HEALTH_ACTION_NONE;
+    }
+    else if (nowMs - health->waitingSince >= health->timeoutInMs)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_010: [ Once acknowledgements have been waited for the timeout without a probe, connection_health_check shall wait for a probe sent at nowMs and return CONNECTION_HEALTH_ACTION_PROBE. ]*/
+        health->isProbing = true;
+        health->probeSentMs = nowMs;
+        result = CONNECTION_HEALTH_ACTION_PROBE;
+    }
+    else
+    {
+        result = CONNECTION_HEALTH_ACTION_NONE;
+    }
+    return result;
+}
+
+bool connection_health_get_due_time(CONNECTION_HEALTH_HANDLE health, tickcounter_ms_t* dueMs)
+{
+    bool result;
+
+    if ((health == NULL) || (dueMs == NULL))
+    {
+        LogError("invalid argument health=%p, dueMs=%p", health, dueMs);
+        result = false;
+    }
+    else if (health->isProbing)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_013: [ While a probe is waited for, connection_health_get_due_time shall set dueMs to the time it was sent and the timeout, while only acknowledgements are waited for, to the time they are waited for since and the timeout, and return true; it shall return false otherwise. ]*/
+        *dueMs = health->probeSentMs + health->timeoutInMs;
+        result = true;
+    }
+    else if (health->isWaiting)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_013: [ While a probe is waited for, connection_health_get_due_time shall set dueMs to the time it was sent and the timeout, while only acknowledgements are waited for, to the time they are waited for since and the timeout, and return true; it shall return false otherwise. ]*/
+        *dueMs = health->waitingSince + health->timeoutInMs;
+        result = true;
+    }
+    else
+    {
+        result = false;
+    }
+    return result;
+}
+
+unsigned int connection_health_get_timeout(CONNECTION_HEALTH_HANDLE health)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_014: [ connection_health_get_timeout shall return the timeout, 0 if health is NULL. ]*/
+    return (health == NULL) ? 0 : health->timeoutInMs;
+}
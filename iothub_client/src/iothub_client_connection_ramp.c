@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdint.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "iothub_client_connection_ramp.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+#define TOKEN 1000 /*the tokens are counted in thousandths, so ms times connections_per_sec adds whole ones*/
+#define PRIORITY_HOLD_TIME_IN_MS 1000
+
+typedef struct CONNECTION_RAMP_TAG
+{
+    LOCK_HANDLE lock;
+    TICK_COUNTER_HANDLE tick_counter;
+    unsigned int connections_per_sec;
+    uint64_t capacity;
+    uint64_t tokens;
+    tickcounter_ms_t last_refill_time;
+    bool is_priority_waiting; /*a device with queued data was turned away at priority_turned_away_time*/
+    tickcounter_ms_t priority_turned_away_time;
+} CONNECTION_RAMP;
+
+static void refill_tokens(CONNECTION_RAMP* connection_ramp, tickcounter_ms_t now)
+{
+    tickcounter_ms_t elapsed = now - connection_ramp->last_refill_time;
+    uint64_t missing = connection_ramp->capacity - connection_ramp->tokens;
+
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_006: [ connection_ramp_admit shall refill the budget by connections_per_sec tokens per second since it was last refilled, up to burst tokens. ]*/
+    if (elapsed > missing / connection_ramp->connections_per_sec)
+    {
+        connection_ramp->tokens = connection_ramp->capacity;
+    }
+    else
+    {
+        connection_ramp->tokens += elapsed * connection_ramp->connections_per_sec;
+    }
+    connection_ramp->last_refill_time = now;
+}
+
+static unsigned int get_token_wait_time(const CONNECTION_RAMP* connection_ramp)
+{
+    return (connection_ramp->tokens >= TOKEN) ? 0 :
+        (unsigned int)((TOKEN - connection_ramp->tokens + connection_ramp->connections_per_sec - 1) / connection_ramp->connections_per_sec);
+}
+
+CONNECTION_RAMP_HANDLE connection_ramp_create(unsigned int connections_per_sec, unsigned int burst)
+{
+    CONNECTION_RAMP* result;
+
+    if ((connections_per_sec == 0) || (burst == 0))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_001: [ If connections_per_sec or burst is 0, connection_ramp_create shall fail and return NULL. ]*/
+        LogError("invalid argument connections_per_sec=%u, burst=%u", connections_per_sec, burst);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_002: [ connection_ramp_create shall allocate the connection ramp, create its lock and tick counter, and return it with a budget of burst tokens. ]*/
+    else if ((result = (CONNECTION_RAMP*)malloc(sizeof(CONNECTION_RAMP))) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_003: [ If any of them fails, connection_ramp_create shall fail and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else if ((result->lock = Lock_Init()) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_003: [ If any of them fails, connection_ramp_create shall fail and return NULL. ]*/
+        LogError("unable to Lock_Init");
+        free(result);
+        result = NULL;
+    }
+    else if ((result->tick_counter = tickcounter_create()) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_003: [ If any of them fails, connection_ramp_create shall fail and return NULL. ]*/
+        LogError("unable to tickcounter_create");
+        (void)Lock_Deinit(result->lock);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->connections_per_sec = connections_per_sec;
+        result->capacity = (uint64_t)burst * TOKEN;
+        result->tokens = result->capacity;
+        result->last_refill_time = 0;
+        result->is_priority_waiting = false;
+        result->priority_turned_away_time = 0;
+    }
+
+    return result;
+}
+
+void connection_ramp_destroy(CONNECTION_RAMP_HANDLE connection_ramp)
+{
+    if (connection_ramp == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_010: [ If connection_ramp is NULL, connection_ramp_destroy shall return. ]*/
+        LogError("invalid argument connection_ramp (NULL)");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_011: [ connection_ramp_destroy shall destroy the tick counter and the lock and free the connection ramp. ]*/
+        tickcounter_destroy(connection_ramp->tick_counter);
+        (void)Lock_Deinit(connection_ramp->lock);
+        free(connection_ramp);
+    }
+}
+
+bool connection_ramp_admit(CONNECTION_RAMP_HANDLE connection_ramp, bool has_queued_data, unsigned int* wait_time_in_ms)
+{
+    bool result;
+
+    if ((connection_ramp == NULL) || (wait_time_in_ms == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_004: [ If connection_ramp or wait_time_in_ms is NULL, connection_ramp_admit shall return true, the connection not being held back. ]*/
+        LogError("invalid argument connection_ramp=%p, wait_time_in_ms=%p", connection_ramp, wait_time_in_ms);
+        result = true;
+    }
+    else if (Lock(connection_ramp->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_005: [ If Lock or tickcounter_get_current_ms fail, connection_ramp_admit shall return true. ]*/
+        LogError("Failed to consult the connection ramp (Lock failed); assuming the connection is admitted.");
+        result = true;
+    }
+    else
+    {
+        tickcounter_ms_t now;
+
+        if (tickcounter_get_current_ms(connection_ramp->tick_counter, &now) != 0)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_005: [ If Lock or tickcounter_get_current_ms fail, connection_ramp_admit shall return true. ]*/
+            LogError("Failed to consult the connection ramp (tickcounter_get_current_ms failed); assuming the connection is admitted.");
+            result = true;
+        }
+        else
+        {
+            refill_tokens(connection_ramp, now);
+            if (connection_ramp->is_priority_waiting && (now - connection_ramp->priority_turned_away_time >= PRIORITY_HOLD_TIME_IN_MS))
+            {
+                connection_ramp->is_priority_waiting = false;
+            }
+
+            if (!has_queued_data && connection_ramp->is_priority_waiting)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_008: [ While a device with queued data was turned away in the last second, connection_ramp_admit shall return false if has_queued_data is false and set wait_time_in_ms to the end of that second or the time until the next token, whichever is later. ]*/
+                unsigned int hold_time = (unsigned int)(PRIORITY_HOLD_TIME_IN_MS - (now - connection_ramp->priority_turned_away_time));
+                unsigned int token_wait_time = get_token_wait_time(connection_ramp);
+                *wait_time_in_ms = (token_wait_time > hold_time) ? token_wait_time : hold_time;
+                result = false;
+            }
+            else if (connection_ramp->tokens < TOKEN)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_007: [ If no token is left, connection_ramp_admit shall return false and set wait_time_in_ms to the time until the next token, remembering the time if has_queued_data is true. ]*/
+                *wait_time_in_ms = get_token_wait_time(connection_ramp);
+                if (has_queued_data)
+                {
+                    connection_ramp->is_priority_waiting = true;
+                    connection_ramp->priority_turned_away_time = now;
+                }
+                result = false;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_009: [ Otherwise connection_ramp_admit shall take a token and return true. ]*/
+                connection_ramp->tokens -= TOKEN;
+                result = true;
+            }
+        }
+
+        (void)Unlock(connection_ramp->lock);
+    }
+
+    return result;
+}
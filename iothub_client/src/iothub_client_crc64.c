@@ -0,0 +1,585 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_crc64.h"
+
+/*crc64Table[0] is the CRC64 of every byte, crc64Table[k][i] is the CRC64 of byte i followed by k zero bytes*/
+static const uint64_t crc64Table[8][256] =
+{
+    {
+        0x0000000000000000ULL, 0x7F6EF0C830358979ULL, 0xFEDDE190606B12F2ULL, 0x81B31158505E9B8BULL,
+        0xC962E5739841B68FULL, 0xB60C15BBA8743FF6ULL, 0x37BF04E3F82AA47DULL, 0x48D1F42BC81F2D04ULL,
+        0xA61CECB46814FE75ULL, 0xD9721C7C5821770CULL, 0x58C10D24087FEC87ULL, 0x27AFFDEC384A65FEULL,
+        0x6F7E09C7F05548FAULL, 0x1010F90FC060C183ULL, 0x91A3E857903E5A08ULL, 0xEECD189FA00BD371ULL,
+        0x78E0FF3B88BE6F81ULL, 0x078E0FF3B88BE6F8ULL, 0x863D1EABE8D57D73ULL, 0xF953EE63D8E0F40AULL,
+        0xB1821A4810FFD90EULL, 0xCEECEA8020CA5077ULL, 0x4F5FFBD87094CBFCULL, 0x30310B1040A14285ULL,
+        0xDEFC138FE0AA91F4ULL, 0xA192E347D09F188DULL, 0x2021F21F80C18306ULL, 0x5F4F02D7B0F40A7FULL,
+        0x179EF6FC78EB277BULL, 0x68F0063448DEAE02ULL, 0xE943176C18803589ULL, 0x962DE7A428B5BCF0ULL,
+        0xF1C1FE77117CDF02ULL, 0x8EAF0EBF2149567BULL, 0x0F1C1FE77117CDF0ULL, 0x7072EF2F41224489ULL,
+        0x38A31B04893D698DULL, 0x47CDEBCCB908E0F4ULL, 0xC67EFA94E9567B7FULL, 0xB9100A5CD963F206ULL,
+        0x57DD12C379682177ULL, 0x28B3E20B495DA80EULL, 0xA900F35319033385ULL, 0xD66E039B2936BAFCULL,
+        0x9EBFF7B0E12997F8ULL, 0xE1D10778D11C1E81ULL, 0x606216208142850AULL, 0x1F0CE6E8B1770C73ULL,
+        0x8921014C99C2B083ULL, 0xF64FF184A9F739FAULL, 0x77FCE0DCF9A9A271ULL, 0x08921014C99C2B08ULL,
+        0x4043E43F0183060CULL, 0x3F2D14F731B68F75ULL, 0xBE9E05AF61E814FEULL, 0xC1F0F56751DD9D87ULL,
+        0x2F3DEDF8F1D64EF6ULL, 0x50531D30C1E3C78FULL, 0xD1E00C6891BD5C04ULL, 0xAE8EFCA0A188D57DULL,
+        0xE65F088B6997F879ULL, 0x9931F84359A27100ULL, 0x1882E91B09FCEA8BULL, 0x67EC19D339C963F2ULL,
+        0xD75ADABD7A6E2D6FULL, 0xA8342A754A5BA416ULL, 0x29873B2D1A053F9DULL, 0x56E9CBE52A30B6E4ULL,
+        0x1E383FCEE22F9BE0ULL, 0x6156CF06D21A1299ULL, 0xE0E5DE5E82448912ULL, 0x9F8B2E96B271006BULL,
+        0x71463609127AD31AULL, 0x0E28C6C1224F5A63ULL, 0x8F9BD7997211C1E8ULL, 0xF0F5275142244891ULL,
+        0xB824D37A8A3B6595ULL, 0xC74A23B2BA0EECECULL, 0x46F932EAEA507767ULL, 0x3997C222DA65FE1EULL,
+        0xAFBA2586F2D042EEULL, 0xD0D4D54EC2E5CB97ULL, 0x5167C41692BB501CULL, 0x2E0934DEA28ED965ULL,
+        0x66D8C0F56A91F461ULL, 0x19B6303D5AA47D18ULL, 0x980521650AFAE693ULL, 0xE76BD1AD3ACF6FEAULL,
+        0x09A6C9329AC4BC9BULL, 0x76C839FAAAF135E2ULL, 0xF77B28A2FAAFAE69ULL, 0x8815D86ACA9A2710ULL,
+        0xC0C42C4102850A14ULL, 0xBFAADC8932B0836DULL, 0x3E19CDD162EE18E6ULL, 0x41773D1952DB919FULL,
+        0x269B24CA6B12F26DULL, 0x59F5D4025B277B14ULL, 0xD846C55A0B79E09FULL, 0xA72835923B4C69E6ULL,
+        0xEFF9C1B9F35344E2ULL, 0x90973171C366CD9BULL, 0x1124202993385610ULL, 0x6E4AD0E1A30DDF69ULL,
+        0x8087C87E03060C18ULL, 0xFFE938B633338561ULL, 0x7E5A29EE636D1EEAULL, 0x0134D92653589793ULL,
+        0x49E52D0D9B47BA97ULL, 0x368BDDC5AB7233EEULL, 0xB738CC9DFB2CA865ULL, 0xC8563C55CB19211CULL,
+        0x5E7BDBF1E3AC9DECULL, 0x21152B39D3991495ULL, 0xA0A63A6183C78F1EULL, 0xDFC8CAA9B3F20667ULL,
+        0x97193E827BED2B63ULL, 0xE877CE4A4BD8A21AULL, 0x69C4DF121B863991ULL, 0x16AA2FDA2BB3B0E8ULL,
+        0xF86737458BB86399ULL, 0x8709C78DBB8DEAE0ULL, 0x06BAD6D5EBD3716BULL, 0x79D4261DDBE6F812ULL,
+        0x3105D23613F9D516ULL, 0x4E6B22FE23CC5C6FULL, 0xCFD833A67392C7E4ULL, 0xB0B6C36E43A74E9DULL,
+        0x9A6C9329AC4BC9B5ULL, 0xE50263E19C7E40CCULL, 0x64B172B9CC20DB47ULL, 0x1BDF8271FC15523EULL,
+        0x530E765A340A7F3AULL, 0x2C608692043FF643ULL, 0xADD397CA54616DC8ULL, 0xD2BD67026454E4B1ULL,
+        0x3C707F9DC45F37C0ULL, 0x431E8F55F46ABEB9ULL, 0xC2AD9E0DA4342532ULL, 0xBDC36EC59401AC4BULL,
+        0xF5129AEE5C1E814FULL, 0x8A7C6A266C2B0836ULL, 0x0BCF7B7E3C7593BDULL, 0x74A18BB60C401AC4ULL,
+        0xE28C6C1224F5A634ULL, 0x9DE29CDA14C02F4DULL, 0x1C518D82449EB4C6ULL, 0x633F7D4A74AB3DBFULL,
+        0x2BEE8961BCB410BBULL, 0x548079A98C8199C2ULL, 0xD53368F1DCDF0249ULL, 0xAA5D9839ECEA8B30ULL,
+        0x449080A64CE15841ULL, 0x3BFE706E7CD4D138ULL, 0xBA4D61362C8A4AB3ULL, 0xC52391FE1CBFC3CAULL,
+        0x8DF265D5D4A0EECEULL, 0xF29C951DE49567B7ULL, 0x732F8445B4CBFC3CULL, 0x0C41748D84FE7545ULL,
+        0x6BAD6D5EBD3716B7ULL, 0x14C39D968D029FCEULL, 0x95708CCEDD5C0445ULL, 0xEA1E7C06ED698D3CULL,
+        0xA2CF882D2576A038ULL, 0xDDA178E515432941ULL, 0x5C1269BD451DB2CAULL, 0x237C997575283BB3ULL,
+        0xCDB181EAD523E8C2ULL, 0xB2DF7122E51661BBULL, 0x336C607AB548FA30ULL, 0x4C0290B2857D7349ULL,
+        0x04D364994D625E4DULL, 0x7BBD94517D57D734ULL, 0xFA0E85092D094CBFULL, 0x856075C11D3CC5C6ULL,
+        0x134D926535897936ULL, 0x6C2362AD05BCF04FULL, 0xED9073F555E26BC4ULL, 0x92FE833D65D7E2BDULL,
+        0xDA2F7716ADC8CFB9ULL, 0xA54187DE9DFD46C0ULL, 0x24F29686CDA3DD4BULL, 0x5B9C664EFD965432ULL,
+        0xB5517ED15D9D8743ULL, 0xCA3F8E196DA80E3AULL, 0x4B8C9F413DF695B1ULL, 0x34E26F890DC31CC8ULL,
+        0x7C339BA2C5DC31CCULL, 0x035D6B6AF5E9B8B5ULL, 0x82EE7A32A5B7233EULL, 0xFD808AFA9582AA47ULL,
+        0x4D364994D625E4DAULL, 0x3258B95CE6106DA3ULL, 0xB3EBA804B64EF628ULL, 0xCC8558CC867B7F51ULL,
+        0x8454ACE74E645255ULL, 0xFB3A5C2F7E51DB2CULL, 0x7A894D772E0F40A7ULL, 0x05E7BDBF1E3AC9DEULL,
+        0xEB2AA520BE311AAFULL, 0x944455E88E0493D6ULL, 0x15F744B0DE5A085DULL, 0x6A99B478EE6F8124ULL,
+        0x224840532670AC20ULL, 0x5D26B09B16452559ULL, 0xDC95A1C3461BBED2ULL, 0xA3FB510B762E37ABULL,
+        0x35D6B6AF5E9B8B5BULL, 0x4AB846676EAE0222ULL, 0xCB0B573F3EF099A9ULL, 0xB465A7F70EC510D0ULL,
+        0xFCB453DCC6DA3DD4ULL, 0x83DAA314F6EFB4ADULL, 0x0269B24CA6B12F26ULL, 0x7D0742849684A65FULL,
+        0x93CA5A1B368F752EULL, 0xECA4AAD306BAFC57ULL, 0x6D17BB8B56E467DCULL, 0x12794B4366D1EEA5ULL,
+        0x5AA8BF68AECEC3A1ULL, 0x25C64FA09EFB4AD8ULL, 0xA4755EF8CEA5D153ULL, 0xDB1BAE30FE90582AULL,
+        0xBCF7B7E3C7593BD8ULL, 0xC399472BF76CB2A1ULL, 0x422A5673A732292AULL, 0x3D44A6BB9707A053ULL,
+        0x759552905F188D57ULL, 0x0AFBA2586F2D042EULL, 0x8B48B3003F739FA5ULL, 0xF42643C80F4616DCULL,
+        0x1AEB5B57AF4DC5ADULL, 0x6585AB9F9F784CD4ULL, 0xE436BAC7CF26D75FULL, 0x9B584A0FFF135E26ULL,
+        0xD389BE24370C7322ULL, 0xACE74EEC0739FA5BULL, 0x2D545FB4576761D0ULL, 0x523AAF7C6752E8A9ULL,
+        0xC41748D84FE75459ULL, 0xBB79B8107FD2DD20ULL, 0x3ACAA9482F8C46ABULL, 0x45A459801FB9CFD2ULL,
+        0x0D75ADABD7A6E2D6ULL, 0x721B5D63E7936BAFULL, 0xF3A84C3BB7CDF024ULL, 0x8CC6BCF387F8795DULL,
+        0x620BA46C27F3AA2CULL, 0x1D6554A417C62355ULL, 0x9CD645FC4798B8DEULL, 0xE3B8B53477AD31A7ULL,
+        0xAB69411FBFB21CA3ULL, 0xD407B1D78F8795DAULL, 0x55B4A08FDFD90E51ULL, 0x2ADA5047EFEC8728ULL
+    },
+    {
+        0x0000000000000000ULL, 0x8776A97D73BDDF69ULL, 0x3A3474A9BFEC2DB9ULL, 0xBD42DDD4CC51F2D0ULL,
+        0x7468E9537FD85B72ULL, 0xF31E402E0C65841BULL, 0x4E5C9DFAC03476CBULL, 0xC92A3487B389A9A2ULL,
+        0xE8D1D2A6FFB0B6E4ULL, 0x6FA77BDB8C0D698DULL, 0xD2E5A60F405C9B5DULL, 0x55930F7233E14434ULL,
+        0x9CB93BF58068ED96ULL, 0x1BCF9288F3D532FFULL, 0xA68D4F5C3F84C02FULL, 0x21FBE6214C391F46ULL,
+        0xE57A831EA7F6FEA3ULL, 0x620C2A63D44B21CAULL, 0xDF4EF7B7181AD31AULL, 0x58385ECA6BA70C73ULL,
+        0x91126A4DD82EA5D1ULL, 0x1664C330AB937AB8ULL, 0xAB261EE467C28868ULL, 0x2C50B799147F5701ULL,
+        0x0DAB51B858464847ULL, 0x8ADDF8C52BFB972EULL, 0x379F2511E7AA65FEULL, 0xB0E98C6C9417BA97ULL,
+        0x79C3B8EB279E1335ULL, 0xFEB511965423CC5CULL, 0x43F7CC4298723E8CULL, 0xC481653FEBCFE1E5ULL,
+        0xFE2C206E177A6E2DULL, 0x795A891364C7B144ULL, 0xC41854C7A8964394ULL, 0x436EFDBADB2B9CFDULL,
+        0x8A44C93D68A2355FULL, 0x0D3260401B1FEA36ULL, 0xB070BD94D74E18E6ULL, 0x370614E9A4F3C78FULL,
+        0x16FDF2C8E8CAD8C9ULL, 0x918B5BB59B7707A0ULL, 0x2CC986615726F570ULL, 0xABBF2F1C249B2A19ULL,
+        0x62951B9B971283BBULL, 0xE5E3B2E6E4AF5CD2ULL, 0x58A16F3228FEAE02ULL, 0xDFD7C64F5B43716BULL,
+        0x1B56A370B08C908EULL, 0x9C200A0DC3314FE7ULL, 0x2162D7D90F60BD37ULL, 0xA6147EA47CDD625EULL,
+        0x6F3E4A23CF54CBFCULL, 0xE848E35EBCE91495ULL, 0x550A3E8A70B8E645ULL, 0xD27C97F70305392CULL,
+        0xF38771D64F3C266AULL, 0x74F1D8AB3C81F903ULL, 0xC9B3057FF0D00BD3ULL, 0x4EC5AC02836DD4BAULL,
+        0x87EF988530E47D18ULL, 0x009931F84359A271ULL, 0xBDDBEC2C8F0850A1ULL, 0x3AAD4551FCB58FC8ULL,
+        0xC881668F76634F31ULL, 0x4FF7CFF205DE9058ULL, 0xF2B51226C98F6288ULL, 0x75C3BB5BBA32BDE1ULL,
+        0xBCE98FDC09BB1443ULL, 0x3B9F26A17A06CB2AULL, 0x86DDFB75B65739FAULL, 0x01AB5208C5EAE693ULL,
+        0x2050B42989D3F9D5ULL, 0xA7261D54FA6E26BCULL, 0x1A64C080363FD46CULL, 0x9D1269FD45820B05ULL,
+        0x54385D7AF60BA2A7ULL, 0xD34EF40785B67DCEULL, 0x6E0C29D349E78F1EULL, 0xE97A80AE3A5A5077ULL,
+        0x2DFBE591D195B192ULL, 0xAA8D4CECA2286EFBULL, 0x17CF91386E799C2BULL, 0x90B938451DC44342ULL,
+        0x59930CC2AE4DEAE0ULL, 0xDEE5A5BFDDF03589ULL, 0x63A7786B11A1C759ULL, 0xE4D1D116621C1830ULL,
+        0xC52A37372E250776ULL, 0x425C9E4A5D98D81FULL, 0xFF1E439E91C92ACFULL, 0x7868EAE3E274F5A6ULL,
+        0xB142DE6451FD5C04ULL, 0x363477192240836DULL, 0x8B76AACDEE1171BDULL, 0x0C0003B09DACAED4ULL,
+        0x36AD46E16119211CULL, 0xB1DBEF9C12A4FE75ULL, 0x0C993248DEF50CA5ULL, 0x8BEF9B35AD48D3CCULL,
+        0x42C5AFB21EC17A6EULL, 0xC5B306CF6D7CA507ULL, 0x78F1DB1BA12D57D7ULL, 0xFF877266D29088BEULL,
+        0xDE7C94479EA997F8ULL, 0x590A3D3AED144891ULL, 0xE448E0EE2145BA41ULL, 0x633E499352F86528ULL,
+        0xAA147D14E171CC8AULL, 0x2D62D46992CC13E3ULL, 0x902009BD5E9DE133ULL, 0x1756A0C02D203E5AULL,
+        0xD3D7C5FFC6EFDFBFULL, 0x54A16C82B55200D6ULL, 0xE9E3B1567903F206ULL, 0x6E95182B0ABE2D6FULL,
+        0xA7BF2CACB93784CDULL, 0x20C985D1CA8A5BA4ULL, 0x9D8B580506DBA974ULL, 0x1AFDF1787566761DULL,
+        0x3B061759395F695BULL, 0xBC70BE244AE2B632ULL, 0x013263F086B344E2ULL, 0x8644CA8DF50E9B8BULL,
+        0x4F6EFE0A46873229ULL, 0xC8185777353AED40ULL, 0x755A8AA3F96B1F90ULL, 0xF22C23DE8AD6C0F9ULL,
+        0xA5DBEB4DB4510D09ULL, 0x22AD4230C7ECD260ULL, 0x9FEF9FE40BBD20B0ULL, 0x189936997800FFD9ULL,
+        0xD1B3021ECB89567BULL, 0x56C5AB63B8348912ULL, 0xEB8776B774657BC2ULL, 0x6CF1DFCA07D8A4ABULL,
+        0x4D0A39EB4BE1BBEDULL, 0xCA7C9096385C6484ULL, 0x773E4D42F40D9654ULL, 0xF048E43F87B0493DULL,
+        0x3962D0B83439E09FULL, 0xBE1479C547843FF6ULL, 0x0356A4118BD5CD26ULL, 0x84200D6CF868124FULL,
+        0x40A1685313A7F3AAULL, 0xC7D7C12E601A2CC3ULL, 0x7A951CFAAC4BDE13ULL, 0xFDE3B587DFF6017AULL,
+        0x34C981006C7FA8D8ULL, 0xB3BF287D1FC277B1ULL, 0x0EFDF5A9D3938561ULL, 0x898B5CD4A02E5A08ULL,
+        0xA870BAF5EC17454EULL, 0x2F0613889FAA9A27ULL, 0x9244CE5C53FB68F7ULL, 0x153267212046B79EULL,
+        0xDC1853A693CF1E3CULL, 0x5B6EFADBE072C155ULL, 0xE62C270F2C233385ULL, 0x615A8E725F9EECECULL,
+        0x5BF7CB23A32B6324ULL, 0xDC81625ED096BC4DULL, 0x61C3BF8A1CC74E9DULL, 0xE6B516F76F7A91F4ULL,
+        0x2F9F2270DCF33856ULL, 0xA8E98B0DAF4EE73FULL, 0x15AB56D9631F15EFULL, 0x92DDFFA410A2CA86ULL,
+        0xB32619855C9BD5C0ULL, 0x3450B0F82F260AA9ULL, 0x89126D2CE377F879ULL, 0x0E64C45190CA2710ULL,
+        0xC74EF0D623438EB2ULL, 0x403859AB50FE51DBULL, 0xFD7A847F9CAFA30BULL, 0x7A0C2D02EF127C62ULL,
+        0xBE8D483D04DD9D87ULL, 0x39FBE140776042EEULL, 0x84B93C94BB31B03EULL, 0x03CF95E9C88C6F57ULL,
+        0xCAE5A16E7B05C6F5ULL, 0x4D93081308B8199CULL, 0xF0D1D5C7C4E9EB4CULL, 0x77A77CBAB7543425ULL,
+        0x565C9A9BFB6D2B63ULL, 0xD12A33E688D0F40AULL, 0x6C68EE32448106DAULL, 0xEB1E474F373CD9B3ULL,
+        0x223473C884B57011ULL, 0xA542DAB5F708AF78ULL, 0x180007613B595DA8ULL, 0x9F76AE1C48E482C1ULL,
+        0x6D5A8DC2C2324238ULL, 0xEA2C24BFB18F9D51ULL, 0x576EF96B7DDE6F81ULL, 0xD01850160E63B0E8ULL,
+        0x19326491BDEA194AULL, 0x9E44CDECCE57C623ULL, 0x23061038020634F3ULL, 0xA470B94571BBEB9AULL,
+        0x858B5F643D82F4DCULL, 0x02FDF6194E3F2BB5ULL, 0xBFBF2BCD826ED965ULL, 0x38C982B0F1D3060CULL,
+        0xF1E3B637425AAFAEULL, 0x76951F4A31E770C7ULL, 0xCBD7C29EFDB68217ULL, 0x4CA16BE38E0B5D7EULL,
+        0x88200EDC65C4BC9BULL, 0x0F56A7A1167963F2ULL, 0xB2147A75DA289122ULL, 0x3562D308A9954E4BULL,
+        0xFC48E78F1A1CE7E9ULL, 0x7B3E4EF269A13880ULL, 0xC67C9326A5F0CA50ULL, 0x410A3A5BD64D1539ULL,
+        0x60F1DC7A9A740A7FULL, 0xE7877507E9C9D516ULL, 0x5AC5A8D3259827C6ULL, 0xDDB301AE5625F8AFULL,
+        0x14993529E5AC510DULL, 0x93EF9C5496118E64ULL, 0x2EAD41805A407CB4ULL, 0xA9DBE8FD29FDA3DDULL,
+        0x9376ADACD5482C15ULL, 0x140004D1A6F5F37CULL, 0xA942D9056AA401ACULL, 0x2E3470781919DEC5ULL,
+        0xE71E44FFAA907767ULL, 0x6068ED82D92DA80EULL, 0xDD2A3056157C5ADEULL, 0x5A5C992B66C185B7ULL,
+        0x7BA77F0A2AF89AF1ULL, 0xFCD1D67759454598ULL, 0x41930BA39514B748ULL, 0xC6E5A2DEE6A96821ULL,
+        0x0FCF96595520C183ULL, 0x88B93F24269D1EEAULL, 0x35FBE2F0EACCEC3AULL, 0xB28D4B8D99713353ULL,
+        0x760C2EB272BED2B6ULL, 0xF17A87CF01030DDFULL, 0x4C385A1BCD52FF0FULL, 0xCB4EF366BEEF2066ULL,
+        0x0264C7E10D6689C4ULL, 0x85126E9C7EDB56ADULL, 0x3850B348B28AA47DULL, 0xBF261A35C1377B14ULL,
+        0x9EDDFC148D0E6452ULL, 0x19AB5569FEB3BB3BULL, 0xA4E988BD32E249EBULL, 0x239F21C0415F9682ULL,
+        0xEAB51547F2D63F20ULL, 0x6DC3BC3A816BE049ULL, 0xD08161EE4D3A1299ULL, 0x57F7C8933E87CDF0ULL
+    },
+    {
+        0x0000000000000000ULL, 0xFF6E4E1F4E4038BEULL, 0xCA05BA6DC417E217ULL, 0x356BF4728A57DAA9ULL,
+        0xA0D25288D0B85745ULL, 0x5FBC1C979EF86FFBULL, 0x6AD7E8E514AFB552ULL, 0x95B9A6FA5AEF8DECULL,
+        0x757D8342F9E73DE1ULL, 0x8A13CD5DB7A7055FULL, 0xBF78392F3DF0DFF6ULL, 0x4016773073B0E748ULL,
+        0xD5AFD1CA295F6AA4ULL, 0x2AC19FD5671F521AULL, 0x1FAA6BA7ED4888B3ULL, 0xE0C425B8A308B00DULL,
+        0xEAFB0685F3CE7BC2ULL, 0x1595489ABD8E437CULL, 0x20FEBCE837D999D5ULL, 0xDF90F2F77999A16BULL,
+        0x4A29540D23762C87ULL, 0xB5471A126D361439ULL, 0x802CEE60E761CE90ULL, 0x7F42A07FA921F62EULL,
+        0x9F8685C70A294623ULL, 0x60E8CBD844697E9DULL, 0x55833FAACE3EA434ULL, 0xAAED71B5807E9C8AULL,
+        0x3F54D74FDA911166ULL, 0xC03A995094D129D8ULL, 0xF5516D221E86F371ULL, 0x0A3F233D50C6CBCFULL,
+        0xE12F2B58BF0B64EFULL, 0x1E416547F14B5C51ULL, 0x2B2A91357B1C86F8ULL, 0xD444DF2A355CBE46ULL,
+        0x41FD79D06FB333AAULL, 0xBE9337CF21F30B14ULL, 0x8BF8C3BDABA4D1BDULL, 0x74968DA2E5E4E903ULL,
+        0x9452A81A46EC590EULL, 0x6B3CE60508AC61B0ULL, 0x5E57127782FBBB19ULL, 0xA1395C68CCBB83A7ULL,
+        0x3480FA9296540E4BULL, 0xCBEEB48DD81436F5ULL, 0xFE8540FF5243EC5CULL, 0x01EB0EE01C03D4E2ULL,
+        0x0BD42DDD4CC51F2DULL, 0xF4BA63C202852793ULL, 0xC1D197B088D2FD3AULL, 0x3EBFD9AFC692C584ULL,
+        0xAB067F559C7D4868ULL, 0x5468314AD23D70D6ULL, 0x6103C538586AAA7FULL, 0x9E6D8B27162A92C1ULL,
+        0x7EA9AE9FB52222CCULL, 0x81C7E080FB621A72ULL, 0xB4AC14F27135C0DBULL, 0x4BC25AED3F75F865ULL,
+        0xDE7BFC17659A7589ULL, 0x2115B2082BDA4D37ULL, 0x147E467AA18D979EULL, 0xEB100865EFCDAF20ULL,
+        0xF68770E226815AB5ULL, 0x09E93EFD68C1620BULL, 0x3C82CA8FE296B8A2ULL, 0xC3EC8490ACD6801CULL,
+        0x5655226AF6390DF0ULL, 0xA93B6C75B879354EULL, 0x9C509807322EEFE7ULL, 0x633ED6187C6ED759ULL,
+        0x83FAF3A0DF666754ULL, 0x7C94BDBF91265FEAULL, 0x49FF49CD1B718543ULL, 0xB69107D25531BDFDULL,
+        0x2328A1280FDE3011ULL, 0xDC46EF37419E08AFULL, 0xE92D1B45CBC9D206ULL, 0x1643555A8589EAB8ULL,
+        0x1C7C7667D54F2177ULL, 0xE31238789B0F19C9ULL, 0xD679CC0A1158C360ULL, 0x291782155F18FBDEULL,
+        0xBCAE24EF05F77632ULL, 0x43C06AF04BB74E8CULL, 0x76AB9E82C1E09425ULL, 0x89C5D09D8FA0AC9BULL,
+        0x6901F5252CA81C96ULL, 0x966FBB3A62E82428ULL, 0xA3044F48E8BFFE81ULL, 0x5C6A0157A6FFC63FULL,
+        0xC9D3A7ADFC104BD3ULL, 0x36BDE9B2B250736DULL, 0x03D61DC03807A9C4ULL, 0xFCB853DF7647917AULL,
+        0x17A85BBA998A3E5AULL, 0xE8C615A5D7CA06E4ULL, 0xDDADE1D75D9DDC4DULL, 0x22C3AFC813DDE4F3ULL,
+        0xB77A09324932691FULL, 0x4814472D077251A1ULL, 0x7D7FB35F8D258B08ULL, 0x8211FD40C365B3B6ULL,
+        0x62D5D8F8606D03BBULL, 0x9DBB96E72E2D3B05ULL, 0xA8D06295A47AE1ACULL, 0x57BE2C8AEA3AD912ULL,
+        0xC2078A70B0D554FEULL, 0x3D69C46FFE956C40ULL, 0x0802301D74C2B6E9ULL, 0xF76C7E023A828E57ULL,
+        0xFD535D3F6A444598ULL, 0x023D132024047D26ULL, 0x3756E752AE53A78FULL, 0xC838A94DE0139F31ULL,
+        0x5D810FB7BAFC12DDULL, 0xA2EF41A8F4BC2A63ULL, 0x9784B5DA7EEBF0CAULL, 0x68EAFBC530ABC874ULL,
+        0x882EDE7D93A37879ULL, 0x77409062DDE340C7ULL, 0x422B641057B49A6EULL, 0xBD452A0F19F4A2D0ULL,
+        0x28FC8CF5431B2F3CULL, 0xD792C2EA0D5B1782ULL, 0xE2F93698870CCD2BULL, 0x1D977887C94CF595ULL,
+        0xD9D7C79715952601ULL, 0x26B989885BD51EBFULL, 0x13D27DFAD182C416ULL, 0xECBC33E59FC2FCA8ULL,
+        0x7905951FC52D7144ULL, 0x866BDB008B6D49FAULL, 0xB3002F72013A9353ULL, 0x4C6E616D4F7AABEDULL,
+        0xACAA44D5EC721BE0ULL, 0x53C40ACAA232235EULL, 0x66AFFEB82865F9F7ULL, 0x99C1B0A76625C149ULL,
+        0x0C78165D3CCA4CA5ULL, 0xF3165842728A741BULL, 0xC67DAC30F8DDAEB2ULL, 0x3913E22FB69D960CULL,
+        0x332CC112E65B5DC3ULL, 0xCC428F0DA81B657DULL, 0xF9297B7F224CBFD4ULL, 0x064735606C0C876AULL,
+        0x93FE939A36E30A86ULL, 0x6C90DD8578A33238ULL, 0x59FB29F7F2F4E891ULL, 0xA69567E8BCB4D02FULL,
+        0x465142501FBC6022ULL, 0xB93F0C4F51FC589CULL, 0x8C54F83DDBAB8235ULL, 0x733AB62295EBBA8BULL,
+        0xE68310D8CF043767ULL, 0x19ED5EC781440FD9ULL, 0x2C86AAB50B13D570ULL, 0xD3E8E4AA4553EDCEULL,
+        0x38F8ECCFAA9E42EEULL, 0xC796A2D0E4DE7A50ULL, 0xF2FD56A26E89A0F9ULL, 0x0D9318BD20C99847ULL,
+        0x982ABE477A2615ABULL, 0x6744F05834662D15ULL, 0x522F042ABE31F7BCULL, 0xAD414A35F071CF02ULL,
+        0x4D856F8D53797F0FULL, 0xB2EB21921D3947B1ULL, 0x8780D5E0976E9D18ULL, 0x78EE9BFFD92EA5A6ULL,
+        0xED573D0583C1284AULL, 0x1239731ACD8110F4ULL, 0x2752876847D6CA5DULL, 0xD83CC9770996F2E3ULL,
+        0xD203EA4A5950392CULL, 0x2D6DA45517100192ULL, 0x180650279D47DB3BULL, 0xE7681E38D307E385ULL,
+        0x72D1B8C289E86E69ULL, 0x8DBFF6DDC7A856D7ULL, 0xB8D402AF4DFF8C7EULL, 0x47BA4CB003BFB4C0ULL,
+        0xA77E6908A0B704CDULL, 0x58102717EEF73C73ULL, 0x6D7BD36564A0E6DAULL, 0x92159D7A2AE0DE64ULL,
+        0x07AC3B80700F5388ULL, 0xF8C2759F3E4F6B36ULL, 0xCDA981EDB418B19FULL, 0x32C7CFF2FA588921ULL,
+        0x2F50B77533147CB4ULL, 0xD03EF96A7D54440AULL, 0xE5550D18F7039EA3ULL, 0x1A3B4307B943A61DULL,
+        0x8F82E5FDE3AC2BF1ULL, 0x70ECABE2ADEC134FULL, 0x45875F9027BBC9E6ULL, 0xBAE9118F69FBF158ULL,
+        0x5A2D3437CAF34155ULL, 0xA5437A2884B379EBULL, 0x90288E5A0EE4A342ULL, 0x6F46C04540A49BFCULL,
+        0xFAFF66BF1A4B1610ULL, 0x059128A0540B2EAEULL, 0x30FADCD2DE5CF407ULL, 0xCF9492CD901CCCB9ULL,
+        0xC5ABB1F0C0DA0776ULL, 0x3AC5FFEF8E9A3FC8ULL, 0x0FAE0B9D04CDE561ULL, 0xF0C045824A8DDDDFULL,
+        0x6579E37810625033ULL, 0x9A17AD675E22688DULL, 0xAF7C5915D475B224ULL, 0x5012170A9A358A9AULL,
+        0xB0D632B2393D3A97ULL, 0x4FB87CAD777D0229ULL, 0x7AD388DFFD2AD880ULL, 0x85BDC6C0B36AE03EULL,
+        0x1004603AE9856DD2ULL, 0xEF6A2E25A7C5556CULL, 0xDA01DA572D928FC5ULL, 0x256F944863D2B77BULL,
+        0xCE7F9C2D8C1F185BULL, 0x3111D232C25F20E5ULL, 0x047A26404808FA4CULL, 0xFB14685F0648C2F2ULL,
+        0x6EADCEA55CA74F1EULL, 0x91C380BA12E777A0ULL, 0xA4A874C898B0AD09ULL, 0x5BC63AD7D6F095B7ULL,
+        0xBB021F6F75F825BAULL, 0x446C51703BB81D04ULL, 0x7107A502B1EFC7ADULL, 0x8E69EB1DFFAFFF13ULL,
+        0x1BD04DE7A54072FFULL, 0xE4BE03F8EB004A41ULL, 0xD1D5F78A615790E8ULL, 0x2EBBB9952F17A856ULL,
+        0x24849AA87FD16399ULL, 0xDBEAD4B731915B27ULL, 0xEE8120C5BBC6818EULL, 0x11EF6EDAF586B930ULL,
+        0x8456C820AF6934DCULL, 0x7B38863FE1290C62ULL, 0x4E53724D6B7ED6CBULL, 0xB13D3C52253EEE75ULL,
+        0x51F919EA86365E78ULL, 0xAE9757F5C87666C6ULL, 0x9BFCA3874221BC6FULL, 0x6492ED980C6184D1ULL,
+        0xF12B4B62568E093DULL, 0x0E45057D18CE3183ULL, 0x3B2EF10F9299EB2AULL, 0xC440BF10DCD9D394ULL
+    },
+    {
+        0x0000000000000000ULL, 0x8211147CBAF96306ULL, 0x30FB0EAA2D655567ULL, 0xB2EA1AD6979C3661ULL,
+        0x61F61D545ACAAACEULL, 0xE3E70928E033C9C8ULL, 0x510D13FE77AFFFA9ULL, 0xD31C0782CD569CAFULL,
+        0xC3EC3AA8B595559CULL, 0x41FD2ED40F6C369AULL, 0xF317340298F000FBULL, 0x7106207E220963FDULL,
+        0xA21A27FCEF5FFF52ULL, 0x200B338055A69C54ULL, 0x92E12956C23AAA35ULL, 0x10F03D2A78C3C933ULL,
+        0xB301530233BD3853ULL, 0x3110477E89445B55ULL, 0x83FA5DA81ED86D34ULL, 0x01EB49D4A4210E32ULL,
+        0xD2F74E566977929DULL, 0x50E65A2AD38EF19BULL, 0xE20C40FC4412C7FAULL, 0x601D5480FEEBA4FCULL,
+        0x70ED69AA86286DCFULL, 0xF2FC7DD63CD10EC9ULL, 0x40166700AB4D38A8ULL, 0xC207737C11B45BAEULL,
+        0x111B74FEDCE2C701ULL, 0x930A6082661BA407ULL, 0x21E07A54F1879266ULL, 0xA3F16E284B7EF160ULL,
+        0x52DB80573FEDE3CDULL, 0xD0CA942B851480CBULL, 0x62208EFD1288B6AAULL, 0xE0319A81A871D5ACULL,
+        0x332D9D0365274903ULL, 0xB13C897FDFDE2A05ULL, 0x03D693A948421C64ULL, 0x81C787D5F2BB7F62ULL,
+        0x9137BAFF8A78B651ULL, 0x1326AE833081D557ULL, 0xA1CCB455A71DE336ULL, 0x23DDA0291DE48030ULL,
+        0xF0C1A7ABD0B21C9FULL, 0x72D0B3D76A4B7F99ULL, 0xC03AA901FDD749F8ULL, 0x422BBD7D472E2AFEULL,
+        0xE1DAD3550C50DB9EULL, 0x63CBC729B6A9B898ULL, 0xD121DDFF21358EF9ULL, 0x5330C9839BCCEDFFULL,
+        0x802CCE01569A7150ULL, 0x023DDA7DEC631256ULL, 0xB0D7C0AB7BFF2437ULL, 0x32C6D4D7C1064731ULL,
+        0x2236E9FDB9C58E02ULL, 0xA027FD81033CED04ULL, 0x12CDE75794A0DB65ULL, 0x90DCF32B2E59B863ULL,
+        0x43C0F4A9E30F24CCULL, 0xC1D1E0D559F647CAULL, 0x733BFA03CE6A71ABULL, 0xF12AEE7F749312ADULL,
+        0xA5B700AE7FDBC79AULL, 0x27A614D2C522A49CULL, 0x954C0E0452BE92FDULL, 0x175D1A78E847F1FBULL,
+        0xC4411DFA25116D54ULL, 0x465009869FE80E52ULL, 0xF4BA135008743833ULL, 0x76AB072CB28D5B35ULL,
+        0x665B3A06CA4E9206ULL, 0xE44A2E7A70B7F100ULL, 0x56A034ACE72BC761ULL, 0xD4B120D05DD2A467ULL,
+        0x07AD2752908438C8ULL, 0x85BC332E2A7D5BCEULL, 0x375629F8BDE16DAFULL, 0xB5473D8407180EA9ULL,
+        0x16B653AC4C66FFC9ULL, 0x94A747D0F69F9CCFULL, 0x264D5D066103AAAEULL, 0xA45C497ADBFAC9A8ULL,
+        0x77404EF816AC5507ULL, 0xF5515A84AC553601ULL, 0x47BB40523BC90060ULL, 0xC5AA542E81306366ULL,
+        0xD55A6904F9F3AA55ULL, 0x574B7D78430AC953ULL, 0xE5A167AED496FF32ULL, 0x67B073D26E6F9C34ULL,
+        0xB4AC7450A339009BULL, 0x36BD602C19C0639DULL, 0x84577AFA8E5C55FCULL, 0x06466E8634A536FAULL,
+        0xF76C80F940362457ULL, 0x757D9485FACF4751ULL, 0xC7978E536D537130ULL, 0x45869A2FD7AA1236ULL,
+        0x969A9DAD1AFC8E99ULL, 0x148B89D1A005ED9FULL, 0xA66193073799DBFEULL, 0x2470877B8D60B8F8ULL,
+        0x3480BA51F5A371CBULL, 0xB691AE2D4F5A12CDULL, 0x047BB4FBD8C624ACULL, 0x866AA087623F47AAULL,
+        0x5576A705AF69DB05ULL, 0xD767B3791590B803ULL, 0x658DA9AF820C8E62ULL, 0xE79CBDD338F5ED64ULL,
+        0x446DD3FB738B1C04ULL, 0xC67CC787C9727F02ULL, 0x7496DD515EEE4963ULL, 0xF687C92DE4172A65ULL,
+        0x259BCEAF2941B6CAULL, 0xA78ADAD393B8D5CCULL, 0x1560C0050424E3ADULL, 0x9771D479BEDD80ABULL,
+        0x8781E953C61E4998ULL, 0x0590FD2F7CE72A9EULL, 0xB77AE7F9EB7B1CFFULL, 0x356BF38551827FF9ULL,
+        0xE677F4079CD4E356ULL, 0x6466E07B262D8050ULL, 0xD68CFAADB1B1B631ULL, 0x549DEED10B48D537ULL,
+        0x7FB7270FA7201C5FULL, 0xFDA633731DD97F59ULL, 0x4F4C29A58A454938ULL, 0xCD5D3DD930BC2A3EULL,
+        0x1E413A5BFDEAB691ULL, 0x9C502E274713D597ULL, 0x2EBA34F1D08FE3F6ULL, 0xACAB208D6A7680F0ULL,
+        0xBC5B1DA712B549C3ULL, 0x3E4A09DBA84C2AC5ULL, 0x8CA0130D3FD01CA4ULL, 0x0EB1077185297FA2ULL,
+        0xDDAD00F3487FE30DULL, 0x5FBC148FF286800BULL, 0xED560E59651AB66AULL, 0x6F471A25DFE3D56CULL,
+        0xCCB6740D949D240CULL, 0x4EA760712E64470AULL, 0xFC4D7AA7B9F8716BULL, 0x7E5C6EDB0301126DULL,
+        0xAD406959CE578EC2ULL, 0x2F517D2574AEEDC4ULL, 0x9DBB67F3E332DBA5ULL, 0x1FAA738F59CBB8A3ULL,
+        0x0F5A4EA521087190ULL, 0x8D4B5AD99BF11296ULL, 0x3FA1400F0C6D24F7ULL, 0xBDB05473B69447F1ULL,
+        0x6EAC53F17BC2DB5EULL, 0xECBD478DC13BB858ULL, 0x5E575D5B56A78E39ULL, 0xDC464927EC5EED3FULL,
+        0x2D6CA75898CDFF92ULL, 0xAF7DB32422349C94ULL, 0x1D97A9F2B5A8AAF5ULL, 0x9F86BD8E0F51C9F3ULL,
+        0x4C9ABA0CC207555CULL, 0xCE8BAE7078FE365AULL, 0x7C61B4A6EF62003BULL, 0xFE70A0DA559B633DULL,
+        0xEE809DF02D58AA0EULL, 0x6C91898C97A1C908ULL, 0xDE7B935A003DFF69ULL, 0x5C6A8726BAC49C6FULL,
+        0x8F7680A4779200C0ULL, 0x0D6794D8CD6B63C6ULL, 0xBF8D8E0E5AF755A7ULL, 0x3D9C9A72E00E36A1ULL,
+        0x9E6DF45AAB70C7C1ULL, 0x1C7CE0261189A4C7ULL, 0xAE96FAF0861592A6ULL, 0x2C87EE8C3CECF1A0ULL,
+        0xFF9BE90EF1BA6D0FULL, 0x7D8AFD724B430E09ULL, 0xCF60E7A4DCDF3868ULL, 0x4D71F3D866265B6EULL,
+        0x5D81CEF21EE5925DULL, 0xDF90DA8EA41CF15BULL, 0x6D7AC0583380C73AULL, 0xEF6BD4248979A43CULL,
+        0x3C77D3A6442F3893ULL, 0xBE66C7DAFED65B95ULL, 0x0C8CDD0C694A6DF4ULL, 0x8E9DC970D3B30EF2ULL,
+        0xDA0027A1D8FBDBC5ULL, 0x581133DD6202B8C3ULL, 0xEAFB290BF59E8EA2ULL, 0x68EA3D774F67EDA4ULL,
+        0xBBF63AF58231710BULL, 0x39E72E8938C8120DULL, 0x8B0D345FAF54246CULL, 0x091C202315AD476AULL,
+        0x19EC1D096D6E8E59ULL, 0x9BFD0975D797ED5FULL, 0x291713A3400BDB3EULL, 0xAB0607DFFAF2B838ULL,
+        0x781A005D37A42497ULL, 0xFA0B14218D5D4791ULL, 0x48E10EF71AC171F0ULL, 0xCAF01A8BA03812F6ULL,
+        0x690174A3EB46E396ULL, 0xEB1060DF51BF8090ULL, 0x59FA7A09C623B6F1ULL, 0xDBEB6E757CDAD5F7ULL,
+        0x08F769F7B18C4958ULL, 0x8AE67D8B0B752A5EULL, 0x380C675D9CE91C3FULL, 0xBA1D732126107F39ULL,
+        0xAAED4E0B5ED3B60AULL, 0x28FC5A77E42AD50CULL, 0x9A1640A173B6E36DULL, 0x180754DDC94F806BULL,
+        0xCB1B535F04191CC4ULL, 0x490A4723BEE07FC2ULL, 0xFBE05DF5297C49A3ULL, 0x79F1498993852AA5ULL,
+        0x88DBA7F6E7163808ULL, 0x0ACAB38A5DEF5B0EULL, 0xB820A95CCA736D6FULL, 0x3A31BD20708A0E69ULL,
+        0xE92DBAA2BDDC92C6ULL, 0x6B3CAEDE0725F1C0ULL, 0xD9D6B40890B9C7A1ULL, 0x5BC7A0742A40A4A7ULL,
+        0x4B379D5E52836D94ULL, 0xC9268922E87A0E92ULL, 0x7BCC93F47FE638F3ULL, 0xF9DD8788C51F5BF5ULL,
+        0x2AC1800A0849C75AULL, 0xA8D09476B2B0A45CULL, 0x1A3A8EA0252C923DULL, 0x982B9ADC9FD5F13BULL,
+        0x3BDAF4F4D4AB005BULL, 0xB9CBE0886E52635DULL, 0x0B21FA5EF9CE553CULL, 0x8930EE224337363AULL,
+        0x5A2CE9A08E61AA95ULL, 0xD83DFDDC3498C993ULL, 0x6AD7E70AA304FFF2ULL, 0xE8C6F37619FD9CF4ULL,
+        0xF836CE5C613E55C7ULL, 0x7A27DA20DBC736C1ULL, 0xC8CDC0F64C5B00A0ULL, 0x4ADCD48AF6A263A6ULL,
+        0x99C0D3083BF4FF09ULL, 0x1BD1C774810D9C0FULL, 0xA93BDDA21691AA6EULL, 0x2B2AC9DEAC68C968ULL
+    },
+    {
+        0x0000000000000000ULL, 0x373D15F784905D1EULL, 0x6E7A2BEF0920BA3CULL, 0x59473E188DB0E722ULL,
+        0xDCF457DE12417478ULL, 0xEBC9422996D12966ULL, 0xB28E7C311B61CE44ULL, 0x85B369C69FF1935AULL,
+        0x8D3189EF7C157B9BULL, 0xBA0C9C18F8852685ULL, 0xE34BA2007535C1A7ULL, 0xD476B7F7F1A59CB9ULL,
+        0x51C5DE316E540FE3ULL, 0x66F8CBC6EAC452FDULL, 0x3FBFF5DE6774B5DFULL, 0x0882E029E3E4E8C1ULL,
+        0x2EBA358DA0BD645DULL, 0x1987207A242D3943ULL, 0x40C01E62A99DDE61ULL, 0x77FD0B952D0D837FULL,
+        0xF24E6253B2FC1025ULL, 0xC57377A4366C4D3BULL, 0x9C3449BCBBDCAA19ULL, 0xAB095C4B3F4CF707ULL,
+        0xA38BBC62DCA81FC6ULL, 0x94B6A995583842D8ULL, 0xCDF1978DD588A5FAULL, 0xFACC827A5118F8E4ULL,
+        0x7F7FEBBCCEE96BBEULL, 0x4842FE4B4A7936A0ULL, 0x1105C053C7C9D182ULL, 0x2638D5A443598C9CULL,
+        0x5D746B1B417AC8BAULL, 0x6A497EECC5EA95A4ULL, 0x330E40F4485A7286ULL, 0x04335503CCCA2F98ULL,
+        0x81803CC5533BBCC2ULL, 0xB6BD2932D7ABE1DCULL, 0xEFFA172A5A1B06FEULL, 0xD8C702DDDE8B5BE0ULL,
+        0xD045E2F43D6FB321ULL, 0xE778F703B9FFEE3FULL, 0xBE3FC91B344F091DULL, 0x8902DCECB0DF5403ULL,
+        0x0CB1B52A2F2EC759ULL, 0x3B8CA0DDABBE9A47ULL, 0x62CB9EC5260E7D65ULL, 0x55F68B32A29E207BULL,
+        0x73CE5E96E1C7ACE7ULL, 0x44F34B616557F1F9ULL, 0x1DB47579E8E716DBULL, 0x2A89608E6C774BC5ULL,
+        0xAF3A0948F386D89FULL, 0x98071CBF77168581ULL, 0xC14022A7FAA662A3ULL, 0xF67D37507E363FBDULL,
+        0xFEFFD7799DD2D77CULL, 0xC9C2C28E19428A62ULL, 0x9085FC9694F26D40ULL, 0xA7B8E9611062305EULL,
+        0x220B80A78F93A304ULL, 0x153695500B03FE1AULL, 0x4C71AB4886B31938ULL, 0x7B4CBEBF02234426ULL,
+        0xBAE8D63682F59174ULL, 0x8DD5C3C10665CC6AULL, 0xD492FDD98BD52B48ULL, 0xE3AFE82E0F457656ULL,
+        0x661C81E890B4E50CULL, 0x5121941F1424B812ULL, 0x0866AA0799945F30ULL, 0x3F5BBFF01D04022EULL,
+        0x37D95FD9FEE0EAEFULL, 0x00E44A2E7A70B7F1ULL, 0x59A37436F7C050D3ULL, 0x6E9E61C173500DCDULL,
+        0xEB2D0807ECA19E97ULL, 0xDC101DF06831C389ULL, 0x855723E8E58124ABULL, 0xB26A361F611179B5ULL,
+        0x9452E3BB2248F529ULL, 0xA36FF64CA6D8A837ULL, 0xFA28C8542B684F15ULL, 0xCD15DDA3AFF8120BULL,
+        0x48A6B46530098151ULL, 0x7F9BA192B499DC4FULL, 0x26DC9F8A39293B6DULL, 0x11E18A7DBDB96673ULL,
+        0x19636A545E5D8EB2ULL, 0x2E5E7FA3DACDD3ACULL, 0x771941BB577D348EULL, 0x4024544CD3ED6990ULL,
+        0xC5973D8A4C1CFACAULL, 0xF2AA287DC88CA7D4ULL, 0xABED1665453C40F6ULL, 0x9CD00392C1AC1DE8ULL,
+        0xE79CBD2DC38F59CEULL, 0xD0A1A8DA471F04D0ULL, 0x89E696C2CAAFE3F2ULL, 0xBEDB83354E3FBEECULL,
+        0x3B68EAF3D1CE2DB6ULL, 0x0C55FF04555E70A8ULL, 0x5512C11CD8EE978AULL, 0x622FD4EB5C7ECA94ULL,
+        0x6AAD34C2BF9A2255ULL, 0x5D9021353B0A7F4BULL, 0x04D71F2DB6BA9869ULL, 0x33EA0ADA322AC577ULL,
+        0xB659631CADDB562DULL, 0x816476EB294B0B33ULL, 0xD82348F3A4FBEC11ULL, 0xEF1E5D04206BB10FULL,
+        0xC92688A063323D93ULL, 0xFE1B9D57E7A2608DULL, 0xA75CA34F6A1287AFULL, 0x9061B6B8EE82DAB1ULL,
+        0x15D2DF7E717349EBULL, 0x22EFCA89F5E314F5ULL, 0x7BA8F4917853F3D7ULL, 0x4C95E166FCC3AEC9ULL,
+        0x4417014F1F274608ULL, 0x732A14B89BB71B16ULL, 0x2A6D2AA01607FC34ULL, 0x1D503F579297A12AULL,
+        0x98E356910D663270ULL, 0xAFDE436689F66F6EULL, 0xF6997D7E0446884CULL, 0xC1A4688980D6D552ULL,
+        0x41088A3E5D7CB183ULL, 0x76359FC9D9ECEC9DULL, 0x2F72A1D1545C0BBFULL, 0x184FB426D0CC56A1ULL,
+        0x9DFCDDE04F3DC5FBULL, 0xAAC1C817CBAD98E5ULL, 0xF386F60F461D7FC7ULL, 0xC4BBE3F8C28D22D9ULL,
+        0xCC3903D12169CA18ULL, 0xFB041626A5F99706ULL, 0xA243283E28497024ULL, 0x957E3DC9ACD92D3AULL,
+        0x10CD540F3328BE60ULL, 0x27F041F8B7B8E37EULL, 0x7EB77FE03A08045CULL, 0x498A6A17BE985942ULL,
+        0x6FB2BFB3FDC1D5DEULL, 0x588FAA44795188C0ULL, 0x01C8945CF4E16FE2ULL, 0x36F581AB707132FCULL,
+        0xB346E86DEF80A1A6ULL, 0x847BFD9A6B10FCB8ULL, 0xDD3CC382E6A01B9AULL, 0xEA01D67562304684ULL,
+        0xE283365C81D4AE45ULL, 0xD5BE23AB0544F35BULL, 0x8CF91DB388F41479ULL, 0xBBC408440C644967ULL,
+        0x3E7761829395DA3DULL, 0x094A747517058723ULL, 0x500D4A6D9AB56001ULL, 0x67305F9A1E253D1FULL,
+        0x1C7CE1251C067939ULL, 0x2B41F4D298962427ULL, 0x7206CACA1526C305ULL, 0x453BDF3D91B69E1BULL,
+        0xC088B6FB0E470D41ULL, 0xF7B5A30C8AD7505FULL, 0xAEF29D140767B77DULL, 0x99CF88E383F7EA63ULL,
+        0x914D68CA601302A2ULL, 0xA6707D3DE4835FBCULL, 0xFF3743256933B89EULL, 0xC80A56D2EDA3E580ULL,
+        0x4DB93F14725276DAULL, 0x7A842AE3F6C22BC4ULL, 0x23C314FB7B72CCE6ULL, 0x14FE010CFFE291F8ULL,
+        0x32C6D4A8BCBB1D64ULL, 0x05FBC15F382B407AULL, 0x5CBCFF47B59BA758ULL, 0x6B81EAB0310BFA46ULL,
+        0xEE328376AEFA691CULL, 0xD90F96812A6A3402ULL, 0x8048A899A7DAD320ULL, 0xB775BD6E234A8E3EULL,
+        0xBFF75D47C0AE66FFULL, 0x88CA48B0443E3BE1ULL, 0xD18D76A8C98EDCC3ULL, 0xE6B0635F4D1E81DDULL,
+        0x63030A99D2EF1287ULL, 0x543E1F6E567F4F99ULL, 0x0D792176DBCFA8BBULL, 0x3A4434815F5FF5A5ULL,
+        0xFBE05C08DF8920F7ULL, 0xCCDD49FF5B197DE9ULL, 0x959A77E7D6A99ACBULL, 0xA2A762105239C7D5ULL,
+        0x27140BD6CDC8548FULL, 0x10291E2149580991ULL, 0x496E2039C4E8EEB3ULL, 0x7E5335CE4078B3ADULL,
+        0x76D1D5E7A39C5B6CULL, 0x41ECC010270C0672ULL, 0x18ABFE08AABCE150ULL, 0x2F96EBFF2E2CBC4EULL,
+        0xAA258239B1DD2F14ULL, 0x9D1897CE354D720AULL, 0xC45FA9D6B8FD9528ULL, 0xF362BC213C6DC836ULL,
+        0xD55A69857F3444AAULL, 0xE2677C72FBA419B4ULL, 0xBB20426A7614FE96ULL, 0x8C1D579DF284A388ULL,
+        0x09AE3E5B6D7530D2ULL, 0x3E932BACE9E56DCCULL, 0x67D415B464558AEEULL, 0x50E90043E0C5D7F0ULL,
+        0x586BE06A03213F31ULL, 0x6F56F59D87B1622FULL, 0x3611CB850A01850DULL, 0x012CDE728E91D813ULL,
+        0x849FB7B411604B49ULL, 0xB3A2A24395F01657ULL, 0xEAE59C5B1840F175ULL, 0xDDD889AC9CD0AC6BULL,
+        0xA69437139EF3E84DULL, 0x91A922E41A63B553ULL, 0xC8EE1CFC97D35271ULL, 0xFFD3090B13430F6FULL,
+        0x7A6060CD8CB29C35ULL, 0x4D5D753A0822C12BULL, 0x141A4B2285922609ULL, 0x23275ED501027B17ULL,
+        0x2BA5BEFCE2E693D6ULL, 0x1C98AB0B6676CEC8ULL, 0x45DF9513EBC629EAULL, 0x72E280E46F5674F4ULL,
+        0xF751E922F0A7E7AEULL, 0xC06CFCD57437BAB0ULL, 0x992BC2CDF9875D92ULL, 0xAE16D73A7D17008CULL,
+        0x882E029E3E4E8C10ULL, 0xBF131769BADED10EULL, 0xE6542971376E362CULL, 0xD1693C86B3FE6B32ULL,
+        0x54DA55402C0FF868ULL, 0x63E740B7A89FA576ULL, 0x3AA07EAF252F4254ULL, 0x0D9D6B58A1BF1F4AULL,
+        0x051F8B71425BF78BULL, 0x32229E86C6CBAA95ULL, 0x6B65A09E4B7B4DB7ULL, 0x5C58B569CFEB10A9ULL,
+        0xD9EBDCAF501A83F3ULL, 0xEED6C958D48ADEEDULL, 0xB791F740593A39CFULL, 0x80ACE2B7DDAA64D1ULL
+    },
+    {
+        0x0000000000000000ULL, 0xE9742A79EF04A5D4ULL, 0xE63172A0869ED8C3ULL, 0x0F4558D9699A7D17ULL,
+        0xF8BBC31255AA22EDULL, 0x11CFE96BBAAE8739ULL, 0x1E8AB1B2D334FA2EULL, 0xF7FE9BCB3C305FFAULL,
+        0xC5AEA077F3C3D6B1ULL, 0x2CDA8A0E1CC77365ULL, 0x239FD2D7755D0E72ULL, 0xCAEBF8AE9A59ABA6ULL,
+        0x3D156365A669F45CULL, 0xD461491C496D5188ULL, 0xDB2411C520F72C9FULL, 0x32503BBCCFF3894BULL,
+        0xBF8466BCBF103E09ULL, 0x56F04CC550149BDDULL, 0x59B5141C398EE6CAULL, 0xB0C13E65D68A431EULL,
+        0x473FA5AEEABA1CE4ULL, 0xAE4B8FD705BEB930ULL, 0xA10ED70E6C24C427ULL, 0x487AFD77832061F3ULL,
+        0x7A2AC6CB4CD3E8B8ULL, 0x935EECB2A3D74D6CULL, 0x9C1BB46BCA4D307BULL, 0x756F9E12254995AFULL,
+        0x829105D91979CA55ULL, 0x6BE52FA0F67D6F81ULL, 0x64A077799FE71296ULL, 0x8DD45D0070E3B742ULL,
+        0x4BD1EB2A26B7EF79ULL, 0xA2A5C153C9B34AADULL, 0xADE0998AA02937BAULL, 0x4494B3F34F2D926EULL,
+        0xB36A2838731DCD94ULL, 0x5A1E02419C196840ULL, 0x555B5A98F5831557ULL, 0xBC2F70E11A87B083ULL,
+        0x8E7F4B5DD57439C8ULL, 0x670B61243A709C1CULL, 0x684E39FD53EAE10BULL, 0x813A1384BCEE44DFULL,
+        0x76C4884F80DE1B25ULL, 0x9FB0A2366FDABEF1ULL, 0x90F5FAEF0640C3E6ULL, 0x7981D096E9446632ULL,
+        0xF4558D9699A7D170ULL, 0x1D21A7EF76A374A4ULL, 0x1264FF361F3909B3ULL, 0xFB10D54FF03DAC67ULL,
+        0x0CEE4E84CC0DF39DULL, 0xE59A64FD23095649ULL, 0xEADF3C244A932B5EULL, 0x03AB165DA5978E8AULL,
+        0x31FB2DE16A6407C1ULL, 0xD88F07988560A215ULL, 0xD7CA5F41ECFADF02ULL, 0x3EBE753803FE7AD6ULL,
+        0xC940EEF33FCE252CULL, 0x2034C48AD0CA80F8ULL, 0x2F719C53B950FDEFULL, 0xC605B62A5654583BULL,
+        0x97A3D6544D6FDEF2ULL, 0x7ED7FC2DA26B7B26ULL, 0x7192A4F4CBF10631ULL, 0x98E68E8D24F5A3E5ULL,
+        0x6F18154618C5FC1FULL, 0x866C3F3FF7C159CBULL, 0x892967E69E5B24DCULL, 0x605D4D9F715F8108ULL,
+        0x520D7623BEAC0843ULL, 0xBB795C5A51A8AD97ULL, 0xB43C04833832D080ULL, 0x5D482EFAD7367554ULL,
+        0xAAB6B531EB062AAEULL, 0x43C29F4804028F7AULL, 0x4C87C7916D98F26DULL, 0xA5F3EDE8829C57B9ULL,
+        0x2827B0E8F27FE0FBULL, 0xC1539A911D7B452FULL, 0xCE16C24874E13838ULL, 0x2762E8319BE59DECULL,
+        0xD09C73FAA7D5C216ULL, 0x39E8598348D167C2ULL, 0x36AD015A214B1AD5ULL, 0xDFD92B23CE4FBF01ULL,
+        0xED89109F01BC364AULL, 0x04FD3AE6EEB8939EULL, 0x0BB8623F8722EE89ULL, 0xE2CC484668264B5DULL,
+        0x1532D38D541614A7ULL, 0xFC46F9F4BB12B173ULL, 0xF303A12DD288CC64ULL, 0x1A778B543D8C69B0ULL,
+        0xDC723D7E6BD8318BULL, 0x3506170784DC945FULL, 0x3A434FDEED46E948ULL, 0xD33765A702424C9CULL,
+        0x24C9FE6C3E721366ULL, 0xCDBDD415D176B6B2ULL, 0xC2F88CCCB8ECCBA5ULL, 0x2B8CA6B557E86E71ULL,
+        0x19DC9D09981BE73AULL, 0xF0A8B770771F42EEULL, 0xFFEDEFA91E853FF9ULL, 0x1699C5D0F1819A2DULL,
+        0xE1675E1BCDB1C5D7ULL, 0x0813746222B56003ULL, 0x07562CBB4B2F1D14ULL, 0xEE2206C2A42BB8C0ULL,
+        0x63F65BC2D4C80F82ULL, 0x8A8271BB3BCCAA56ULL, 0x85C729625256D741ULL, 0x6CB3031BBD527295ULL,
+        0x9B4D98D081622D6FULL, 0x7239B2A96E6688BBULL, 0x7D7CEA7007FCF5ACULL, 0x9408C009E8F85078ULL,
+        0xA658FBB5270BD933ULL, 0x4F2CD1CCC80F7CE7ULL, 0x40698915A19501F0ULL, 0xA91DA36C4E91A424ULL,
+        0x5EE338A772A1FBDEULL, 0xB79712DE9DA55E0AULL, 0xB8D24A07F43F231DULL, 0x51A6607E1B3B86C9ULL,
+        0x1B9E8AFBC2482E8FULL, 0xF2EAA0822D4C8B5BULL, 0xFDAFF85B44D6F64CULL, 0x14DBD222ABD25398ULL,
+        0xE32549E997E20C62ULL, 0x0A51639078E6A9B6ULL, 0x05143B49117CD4A1ULL, 0xEC601130FE787175ULL,
+        0xDE302A8C318BF83EULL, 0x374400F5DE8F5DEAULL, 0x3801582CB71520FDULL, 0xD175725558118529ULL,
+        0x268BE99E6421DAD3ULL, 0xCFFFC3E78B257F07ULL, 0xC0BA9B3EE2BF0210ULL, 0x29CEB1470DBBA7C4ULL,
+        0xA41AEC477D581086ULL, 0x4D6EC63E925CB552ULL, 0x422B9EE7FBC6C845ULL, 0xAB5FB49E14C26D91ULL,
+        0x5CA12F5528F2326BULL, 0xB5D5052CC7F697BFULL, 0xBA905DF5AE6CEAA8ULL, 0x53E4778C41684F7CULL,
+        0x61B44C308E9BC637ULL, 0x88C06649619F63E3ULL, 0x87853E9008051EF4ULL, 0x6EF114E9E701BB20ULL,
+        0x990F8F22DB31E4DAULL, 0x707BA55B3435410EULL, 0x7F3EFD825DAF3C19ULL, 0x964AD7FBB2AB99CDULL,
+        0x504F61D1E4FFC1F6ULL, 0xB93B4BA80BFB6422ULL, 0xB67E137162611935ULL, 0x5F0A39088D65BCE1ULL,
+        0xA8F4A2C3B155E31BULL, 0x418088BA5E5146CFULL, 0x4EC5D06337CB3BD8ULL, 0xA7B1FA1AD8CF9E0CULL,
+        0x95E1C1A6173C1747ULL, 0x7C95EBDFF838B293ULL, 0x73D0B30691A2CF84ULL, 0x9AA4997F7EA66A50ULL,
+        0x6D5A02B4429635AAULL, 0x842E28CDAD92907EULL, 0x8B6B7014C408ED69ULL, 0x621F5A6D2B0C48BDULL,
+        0xEFCB076D5BEFFFFFULL, 0x06BF2D14B4EB5A2BULL, 0x09FA75CDDD71273CULL, 0xE08E5FB4327582E8ULL,
+        0x1770C47F0E45DD12ULL, 0xFE04EE06E14178C6ULL, 0xF141B6DF88DB05D1ULL, 0x18359CA667DFA005ULL,
+        0x2A65A71AA82C294EULL, 0xC3118D6347288C9AULL, 0xCC54D5BA2EB2F18DULL, 0x2520FFC3C1B65459ULL,
+        0xD2DE6408FD860BA3ULL, 0x3BAA4E711282AE77ULL, 0x34EF16A87B18D360ULL, 0xDD9B3CD1941C76B4ULL,
+        0x8C3D5CAF8F27F07DULL, 0x654976D6602355A9ULL, 0x6A0C2E0F09B928BEULL, 0x83780476E6BD8D6AULL,
+        0x74869FBDDA8DD290ULL, 0x9DF2B5C435897744ULL, 0x92B7ED1D5C130A53ULL, 0x7BC3C764B317AF87ULL,
+        0x4993FCD87CE426CCULL, 0xA0E7D6A193E08318ULL, 0xAFA28E78FA7AFE0FULL, 0x46D6A401157E5BDBULL,
+        0xB1283FCA294E0421ULL, 0x585C15B3C64AA1F5ULL, 0x57194D6AAFD0DCE2ULL, 0xBE6D671340D47936ULL,
+        0x33B93A133037CE74ULL, 0xDACD106ADF336BA0ULL, 0xD58848B3B6A916B7ULL, 0x3CFC62CA59ADB363ULL,
+        0xCB02F901659DEC99ULL, 0x2276D3788A99494DULL, 0x2D338BA1E303345AULL, 0xC447A1D80C07918EULL,
+        0xF6179A64C3F418C5ULL, 0x1F63B01D2CF0BD11ULL, 0x1026E8C4456AC006ULL, 0xF952C2BDAA6E65D2ULL,
+        0x0EAC5976965E3A28ULL, 0xE7D8730F795A9FFCULL, 0xE89D2BD610C0E2EBULL, 0x01E901AFFFC4473FULL,
+        0xC7ECB785A9901F04ULL, 0x2E989DFC4694BAD0ULL, 0x21DDC5252F0EC7C7ULL, 0xC8A9EF5CC00A6213ULL,
+        0x3F577497FC3A3DE9ULL, 0xD6235EEE133E983DULL, 0xD96606377AA4E52AULL, 0x30122C4E95A040FEULL,
+        0x024217F25A53C9B5ULL, 0xEB363D8BB5576C61ULL, 0xE4736552DCCD1176ULL, 0x0D074F2B33C9B4A2ULL,
+        0xFAF9D4E00FF9EB58ULL, 0x138DFE99E0FD4E8CULL, 0x1CC8A6408967339BULL, 0xF5BC8C396663964FULL,
+        0x7868D1391680210DULL, 0x911CFB40F98484D9ULL, 0x9E59A399901EF9CEULL, 0x772D89E07F1A5C1AULL,
+        0x80D3122B432A03E0ULL, 0x69A73852AC2EA634ULL, 0x66E2608BC5B4DB23ULL, 0x8F964AF22AB07EF7ULL,
+        0xBDC6714EE543F7BCULL, 0x54B25B370A475268ULL, 0x5BF703EE63DD2F7FULL, 0xB28329978CD98AABULL,
+        0x457DB25CB0E9D551ULL, 0xAC0998255FED7085ULL, 0xA34CC0FC36770D92ULL, 0x4A38EA85D973A846ULL
+    },
+    {
+        0x0000000000000000ULL, 0xFC5D27F6BF353971ULL, 0xCC6369BE26FDE189ULL, 0x303E4E4899C8D8F8ULL,
+        0xAC1FF52F156C5079ULL, 0x5042D2D9AA596908ULL, 0x607C9C913391B1F0ULL, 0x9C21BB678CA48881ULL,
+        0x6CE6CC0D724F3399ULL, 0x90BBEBFBCD7A0AE8ULL, 0xA085A5B354B2D210ULL, 0x5CD88245EB87EB61ULL,
+        0xC0F93922672363E0ULL, 0x3CA41ED4D8165A91ULL, 0x0C9A509C41DE8269ULL, 0xF0C7776AFEEBBB18ULL,
+        0xD9CD981AE49E6732ULL, 0x2590BFEC5BAB5E43ULL, 0x15AEF1A4C26386BBULL, 0xE9F3D6527D56BFCAULL,
+        0x75D26D35F1F2374BULL, 0x898F4AC34EC70E3AULL, 0xB9B1048BD70FD6C2ULL, 0x45EC237D683AEFB3ULL,
+        0xB52B541796D154ABULL, 0x497673E129E46DDAULL, 0x79483DA9B02CB522ULL, 0x85151A5F0F198C53ULL,
+        0x1934A13883BD04D2ULL, 0xE56986CE3C883DA3ULL, 0xD557C886A540E55BULL, 0x290AEF701A75DC2AULL,
+        0x8742166691AB5D0FULL, 0x7B1F31902E9E647EULL, 0x4B217FD8B756BC86ULL, 0xB77C582E086385F7ULL,
+        0x2B5DE34984C70D76ULL, 0xD700C4BF3BF23407ULL, 0xE73E8AF7A23AECFFULL, 0x1B63AD011D0FD58EULL,
+        0xEBA4DA6BE3E46E96ULL, 0x17F9FD9D5CD157E7ULL, 0x27C7B3D5C5198F1FULL, 0xDB9A94237A2CB66EULL,
+        0x47BB2F44F6883EEFULL, 0xBBE608B249BD079EULL, 0x8BD846FAD075DF66ULL, 0x7785610C6F40E617ULL,
+        0x5E8F8E7C75353A3DULL, 0xA2D2A98ACA00034CULL, 0x92ECE7C253C8DBB4ULL, 0x6EB1C034ECFDE2C5ULL,
+        0xF2907B5360596A44ULL, 0x0ECD5CA5DF6C5335ULL, 0x3EF312ED46A48BCDULL, 0xC2AE351BF991B2BCULL,
+        0x32694271077A09A4ULL, 0xCE346587B84F30D5ULL, 0xFE0A2BCF2187E82DULL, 0x02570C399EB2D15CULL,
+        0x9E76B75E121659DDULL, 0x622B90A8AD2360ACULL, 0x5215DEE034EBB854ULL, 0xAE48F9168BDE8125ULL,
+        0x3A5D0A9E7BC12975ULL, 0xC6002D68C4F41004ULL, 0xF63E63205D3CC8FCULL, 0x0A6344D6E209F18DULL,
+        0x9642FFB16EAD790CULL, 0x6A1FD847D198407DULL, 0x5A21960F48509885ULL, 0xA67CB1F9F765A1F4ULL,
+        0x56BBC693098E1AECULL, 0xAAE6E165B6BB239DULL, 0x9AD8AF2D2F73FB65ULL, 0x668588DB9046C214ULL,
+        0xFAA433BC1CE24A95ULL, 0x06F9144AA3D773E4ULL, 0x36C75A023A1FAB1CULL, 0xCA9A7DF4852A926DULL,
+        0xE39092849F5F4E47ULL, 0x1FCDB572206A7736ULL, 0x2FF3FB3AB9A2AFCEULL, 0xD3AEDCCC069796BFULL,
+        0x4F8F67AB8A331E3EULL, 0xB3D2405D3506274FULL, 0x83EC0E15ACCEFFB7ULL, 0x7FB129E313FBC6C6ULL,
+        0x8F765E89ED107DDEULL, 0x732B797F522544AFULL, 0x43153737CBED9C57ULL, 0xBF4810C174D8A526ULL,
+        0x2369ABA6F87C2DA7ULL, 0xDF348C50474914D6ULL, 0xEF0AC218DE81CC2EULL, 0x1357E5EE61B4F55FULL,
+        0xBD1F1CF8EA6A747AULL, 0x41423B0E555F4D0BULL, 0x717C7546CC9795F3ULL, 0x8D2152B073A2AC82ULL,
+        0x1100E9D7FF062403ULL, 0xED5DCE2140331D72ULL, 0xDD638069D9FBC58AULL, 0x213EA79F66CEFCFBULL,
+        0xD1F9D0F5982547E3ULL, 0x2DA4F70327107E92ULL, 0x1D9AB94BBED8A66AULL, 0xE1C79EBD01ED9F1BULL,
+        0x7DE625DA8D49179AULL, 0x81BB022C327C2EEBULL, 0xB1854C64ABB4F613ULL, 0x4DD86B921481CF62ULL,
+        0x64D284E20EF41348ULL, 0x988FA314B1C12A39ULL, 0xA8B1ED5C2809F2C1ULL, 0x54ECCAAA973CCBB0ULL,
+        0xC8CD71CD1B984331ULL, 0x3490563BA4AD7A40ULL, 0x04AE18733D65A2B8ULL, 0xF8F33F8582509BC9ULL,
+        0x083448EF7CBB20D1ULL, 0xF4696F19C38E19A0ULL, 0xC45721515A46C158ULL, 0x380A06A7E573F829ULL,
+        0xA42BBDC069D770A8ULL, 0x58769A36D6E249D9ULL, 0x6848D47E4F2A9121ULL, 0x9415F388F01FA850ULL,
+        0x74BA153CF78252EAULL, 0x88E732CA48B76B9BULL, 0xB8D97C82D17FB363ULL, 0x44845B746E4A8A12ULL,
+        0xD8A5E013E2EE0293ULL, 0x24F8C7E55DDB3BE2ULL, 0x14C689ADC413E31AULL, 0xE89BAE5B7B26DA6BULL,
+        0x185CD93185CD6173ULL, 0xE401FEC73AF85802ULL, 0xD43FB08FA33080FAULL, 0x286297791C05B98BULL,
+        0xB4432C1E90A1310AULL, 0x481E0BE82F94087BULL, 0x782045A0B65CD083ULL, 0x847D62560969E9F2ULL,
+        0xAD778D26131C35D8ULL, 0x512AAAD0AC290CA9ULL, 0x6114E49835E1D451ULL, 0x9D49C36E8AD4ED20ULL,
+        0x01687809067065A1ULL, 0xFD355FFFB9455CD0ULL, 0xCD0B11B7208D8428ULL, 0x315636419FB8BD59ULL,
+        0xC191412B61530641ULL, 0x3DCC66DDDE663F30ULL, 0x0DF2289547AEE7C8ULL, 0xF1AF0F63F89BDEB9ULL,
+        0x6D8EB404743F5638ULL, 0x91D393F2CB0A6F49ULL, 0xA1EDDDBA52C2B7B1ULL, 0x5DB0FA4CEDF78EC0ULL,
+        0xF3F8035A66290FE5ULL, 0x0FA524ACD91C3694ULL, 0x3F9B6AE440D4EE6CULL, 0xC3C64D12FFE1D71DULL,
+        0x5FE7F67573455F9CULL, 0xA3BAD183CC7066EDULL, 0x93849FCB55B8BE15ULL, 0x6FD9B83DEA8D8764ULL,
+        0x9F1ECF5714663C7CULL, 0x6343E8A1AB53050DULL, 0x537DA6E9329BDDF5ULL, 0xAF20811F8DAEE484ULL,
+        0x33013A78010A6C05ULL, 0xCF5C1D8EBE3F5574ULL, 0xFF6253C627F78D8CULL, 0x033F743098C2B4FDULL,
+        0x2A359B4082B768D7ULL, 0xD668BCB63D8251A6ULL, 0xE656F2FEA44A895EULL, 0x1A0BD5081B7FB02FULL,
+        0x862A6E6F97DB38AEULL, 0x7A77499928EE01DFULL, 0x4A4907D1B126D927ULL, 0xB61420270E13E056ULL,
+        0x46D3574DF0F85B4EULL, 0xBA8E70BB4FCD623FULL, 0x8AB03EF3D605BAC7ULL, 0x76ED1905693083B6ULL,
+        0xEACCA262E5940B37ULL, 0x169185945AA13246ULL, 0x26AFCBDCC369EABEULL, 0xDAF2EC2A7C5CD3CFULL,
+        0x4EE71FA28C437B9FULL, 0xB2BA3854337642EEULL, 0x8284761CAABE9A16ULL, 0x7ED951EA158BA367ULL,
+        0xE2F8EA8D992F2BE6ULL, 0x1EA5CD7B261A1297ULL, 0x2E9B8333BFD2CA6FULL, 0xD2C6A4C500E7F31EULL,
+        0x2201D3AFFE0C4806ULL, 0xDE5CF45941397177ULL, 0xEE62BA11D8F1A98FULL, 0x123F9DE767C490FEULL,
+        0x8E1E2680EB60187FULL, 0x724301765455210EULL, 0x427D4F3ECD9DF9F6ULL, 0xBE2068C872A8C087ULL,
+        0x972A87B868DD1CADULL, 0x6B77A04ED7E825DCULL, 0x5B49EE064E20FD24ULL, 0xA714C9F0F115C455ULL,
+        0x3B3572977DB14CD4ULL, 0xC7685561C28475A5ULL, 0xF7561B295B4CAD5DULL, 0x0B0B3CDFE479942CULL,
+        0xFBCC4BB51A922F34ULL, 0x07916C43A5A71645ULL, 0x37AF220B3C6FCEBDULL, 0xCBF205FD835AF7CCULL,
+        0x57D3BE9A0FFE7F4DULL, 0xAB8E996CB0CB463CULL, 0x9BB0D72429039EC4ULL, 0x67EDF0D29636A7B5ULL,
+        0xC9A509C41DE82690ULL, 0x35F82E32A2DD1FE1ULL, 0x05C6607A3B15C719ULL, 0xF99B478C8420FE68ULL,
+        0x65BAFCEB088476E9ULL, 0x99E7DB1DB7B14F98ULL, 0xA9D995552E799760ULL, 0x5584B2A3914CAE11ULL,
+        0xA543C5C96FA71509ULL, 0x591EE23FD0922C78ULL, 0x6920AC77495AF480ULL, 0x957D8B81F66FCDF1ULL,
+        0x095C30E67ACB4570ULL, 0xF5011710C5FE7C01ULL, 0xC53F59585C36A4F9ULL, 0x39627EAEE3039D88ULL,
+        0x106891DEF97641A2ULL, 0xEC35B628464378D3ULL, 0xDC0BF860DF8BA02BULL, 0x2056DF9660BE995AULL,
+        0xBC7764F1EC1A11DBULL, 0x402A4307532F28AAULL, 0x70140D4FCAE7F052ULL, 0x8C492AB975D2C923ULL,
+        0x7C8E5DD38B39723BULL, 0x80D37A25340C4B4AULL, 0xB0ED346DADC493B2ULL, 0x4CB0139B12F1AAC3ULL,
+        0xD091A8FC9E552242ULL, 0x2CCC8F0A21601B33ULL, 0x1CF2C142B8A8C3CBULL, 0xE0AFE6B4079DFABAULL
+    },
+    {
+        0x0000000000000000ULL, 0x21E9761E252621ACULL, 0x43D2EC3C4A4C4358ULL, 0x623B9A226F6A62F4ULL,
+        0x87A5D878949886B0ULL, 0xA64CAE66B1BEA71CULL, 0xC4773444DED4C5E8ULL, 0xE59E425AFBF2E444ULL,
+        0x3B9296A271A69E0BULL, 0x1A7BE0BC5480BFA7ULL, 0x78407A9E3BEADD53ULL, 0x59A90C801ECCFCFFULL,
+        0xBC374EDAE53E18BBULL, 0x9DDE38C4C0183917ULL, 0xFFE5A2E6AF725BE3ULL, 0xDE0CD4F88A547A4FULL,
+        0x77252D44E34D3C16ULL, 0x56CC5B5AC66B1DBAULL, 0x34F7C178A9017F4EULL, 0x151EB7668C275EE2ULL,
+        0xF080F53C77D5BAA6ULL, 0xD169832252F39B0AULL, 0xB35219003D99F9FEULL, 0x92BB6F1E18BFD852ULL,
+        0x4CB7BBE692EBA21DULL, 0x6D5ECDF8B7CD83B1ULL, 0x0F6557DAD8A7E145ULL, 0x2E8C21C4FD81C0E9ULL,
+        0xCB12639E067324ADULL, 0xEAFB158023550501ULL, 0x88C08FA24C3F67F5ULL, 0xA929F9BC69194659ULL,
+        0xEE4A5A89C69A782CULL, 0xCFA32C97E3BC5980ULL, 0xAD98B6B58CD63B74ULL, 0x8C71C0ABA9F01AD8ULL,
+        0x69EF82F15202FE9CULL, 0x4806F4EF7724DF30ULL, 0x2A3D6ECD184EBDC4ULL, 0x0BD418D33D689C68ULL,
+        0xD5D8CC2BB73CE627ULL, 0xF431BA35921AC78BULL, 0x960A2017FD70A57FULL, 0xB7E35609D85684D3ULL,
+        0x527D145323A46097ULL, 0x7394624D0682413BULL, 0x11AFF86F69E823CFULL, 0x30468E714CCE0263ULL,
+        0x996F77CD25D7443AULL, 0xB88601D300F16596ULL, 0xDABD9BF16F9B0762ULL, 0xFB54EDEF4ABD26CEULL,
+        0x1ECAAFB5B14FC28AULL, 0x3F23D9AB9469E326ULL, 0x5D184389FB0381D2ULL, 0x7CF13597DE25A07EULL,
+        0xA2FDE16F5471DA31ULL, 0x831497717157FB9DULL, 0xE12F0D531E3D9969ULL, 0xC0C67B4D3B1BB8C5ULL,
+        0x25583917C0E95C81ULL, 0x04B14F09E5CF7D2DULL, 0x668AD52B8AA51FD9ULL, 0x4763A335AF833E75ULL,
+        0xE84D9340D5A36333ULL, 0xC9A4E55EF085429FULL, 0xAB9F7F7C9FEF206BULL, 0x8A760962BAC901C7ULL,
+        0x6FE84B38413BE583ULL, 0x4E013D26641DC42FULL, 0x2C3AA7040B77A6DBULL, 0x0DD3D11A2E518777ULL,
+        0xD3DF05E2A405FD38ULL, 0xF23673FC8123DC94ULL, 0x900DE9DEEE49BE60ULL, 0xB1E49FC0CB6F9FCCULL,
+        0x547ADD9A309D7B88ULL, 0x7593AB8415BB5A24ULL, 0x17A831A67AD138D0ULL, 0x364147B85FF7197CULL,
+        0x9F68BE0436EE5F25ULL, 0xBE81C81A13C87E89ULL, 0xDCBA52387CA21C7DULL, 0xFD53242659843DD1ULL,
+        0x18CD667CA276D995ULL, 0x392410628750F839ULL, 0x5B1F8A40E83A9ACDULL, 0x7AF6FC5ECD1CBB61ULL,
+        0xA4FA28A64748C12EULL, 0x85135EB8626EE082ULL, 0xE728C49A0D048276ULL, 0xC6C1B2842822A3DAULL,
+        0x235FF0DED3D0479EULL, 0x02B686C0F6F66632ULL, 0x608D1CE2999C04C6ULL, 0x41646AFCBCBA256AULL,
+        0x0607C9C913391B1FULL, 0x27EEBFD7361F3AB3ULL, 0x45D525F559755847ULL, 0x643C53EB7C5379EBULL,
+        0x81A211B187A19DAFULL, 0xA04B67AFA287BC03ULL, 0xC270FD8DCDEDDEF7ULL, 0xE3998B93E8CBFF5BULL,
+        0x3D955F6B629F8514ULL, 0x1C7C297547B9A4B8ULL, 0x7E47B35728D3C64CULL, 0x5FAEC5490DF5E7E0ULL,
+        0xBA308713F60703A4ULL, 0x9BD9F10DD3212208ULL, 0xF9E26B2FBC4B40FCULL, 0xD80B1D31996D6150ULL,
+        0x7122E48DF0742709ULL, 0x50CB9293D55206A5ULL, 0x32F008B1BA386451ULL, 0x13197EAF9F1E45FDULL,
+        0xF6873CF564ECA1B9ULL, 0xD76E4AEB41CA8015ULL, 0xB555D0C92EA0E2E1ULL, 0x94BCA6D70B86C34DULL,
+        0x4AB0722F81D2B902ULL, 0x6B590431A4F498AEULL, 0x09629E13CB9EFA5AULL, 0x288BE80DEEB8DBF6ULL,
+        0xCD15AA57154A3FB2ULL, 0xECFCDC49306C1E1EULL, 0x8EC7466B5F067CEAULL, 0xAF2E30757A205D46ULL,
+        0xE44200D2F3D1550DULL, 0xC5AB76CCD6F774A1ULL, 0xA790ECEEB99D1655ULL, 0x86799AF09CBB37F9ULL,
+        0x63E7D8AA6749D3BDULL, 0x420EAEB4426FF211ULL, 0x203534962D0590E5ULL, 0x01DC42880823B149ULL,
+        0xDFD096708277CB06ULL, 0xFE39E06EA751EAAAULL, 0x9C027A4CC83B885EULL, 0xBDEB0C52ED1DA9F2ULL,
+        0x58754E0816EF4DB6ULL, 0x799C381633C96C1AULL, 0x1BA7A2345CA30EEEULL, 0x3A4ED42A79852F42ULL,
+        0x93672D96109C691BULL, 0xB28E5B8835BA48B7ULL, 0xD0B5C1AA5AD02A43ULL, 0xF15CB7B47FF60BEFULL,
+        0x14C2F5EE8404EFABULL, 0x352B83F0A122CE07ULL, 0x571019D2CE48ACF3ULL, 0x76F96FCCEB6E8D5FULL,
+        0xA8F5BB34613AF710ULL, 0x891CCD2A441CD6BCULL, 0xEB2757082B76B448ULL, 0xCACE21160E5095E4ULL,
+        0x2F50634CF5A271A0ULL, 0x0EB91552D084500CULL, 0x6C828F70BFEE32F8ULL, 0x4D6BF96E9AC81354ULL,
+        0x0A085A5B354B2D21ULL, 0x2BE12C45106D0C8DULL, 0x49DAB6677F076E79ULL, 0x6833C0795A214FD5ULL,
+        0x8DAD8223A1D3AB91ULL, 0xAC44F43D84F58A3DULL, 0xCE7F6E1FEB9FE8C9ULL, 0xEF961801CEB9C965ULL,
+        0x319ACCF944EDB32AULL, 0x1073BAE761CB9286ULL, 0x724820C50EA1F072ULL, 0x53A156DB2B87D1DEULL,
+        0xB63F1481D075359AULL, 0x97D6629FF5531436ULL, 0xF5EDF8BD9A3976C2ULL, 0xD4048EA3BF1F576EULL,
+        0x7D2D771FD6061137ULL, 0x5CC40101F320309BULL, 0x3EFF9B239C4A526FULL, 0x1F16ED3DB96C73C3ULL,
+        0xFA88AF67429E9787ULL, 0xDB61D97967B8B62BULL, 0xB95A435B08D2D4DFULL, 0x98B335452DF4F573ULL,
+        0x46BFE1BDA7A08F3CULL, 0x675697A38286AE90ULL, 0x056D0D81EDECCC64ULL, 0x24847B9FC8CAEDC8ULL,
+        0xC11A39C53338098CULL, 0xE0F34FDB161E2820ULL, 0x82C8D5F979744AD4ULL, 0xA321A3E75C526B78ULL,
+        0x0C0F93922672363EULL, 0x2DE6E58C03541792ULL, 0x4FDD7FAE6C3E7566ULL, 0x6E3409B0491854CAULL,
+        0x8BAA4BEAB2EAB08EULL, 0xAA433DF497CC9122ULL, 0xC878A7D6F8A6F3D6ULL, 0xE991D1C8DD80D27AULL,
+        0x379D053057D4A835ULL, 0x1674732E72F28999ULL, 0x744FE90C1D98EB6DULL, 0x55A69F1238BECAC1ULL,
+        0xB038DD48C34C2E85ULL, 0x91D1AB56E66A0F29ULL, 0xF3EA317489006DDDULL, 0xD203476AAC264C71ULL,
+        0x7B2ABED6C53F0A28ULL, 0x5AC3C8C8E0192B84ULL, 0x38F852EA8F734970ULL, 0x191124F4AA5568DCULL,
+        0xFC8F66AE51A78C98ULL, 0xDD6610B07481AD34ULL, 0xBF5D8A921BEBCFC0ULL, 0x9EB4FC8C3ECDEE6CULL,
+        0x40B82874B4999423ULL, 0x61515E6A91BFB58FULL, 0x036AC448FED5D77BULL, 0x2283B256DBF3F6D7ULL,
+        0xC71DF00C20011293ULL, 0xE6F486120527333FULL, 0x84CF1C306A4D51CBULL, 0xA5266A2E4F6B7067ULL,
+        0xE245C91BE0E84E12ULL, 0xC3ACBF05C5CE6FBEULL, 0xA1972527AAA40D4AULL, 0x807E53398F822CE6ULL,
+        0x65E011637470C8A2ULL, 0x4409677D5156E90EULL, 0x2632FD5F3E3C8BFAULL, 0x07DB8B411B1AAA56ULL,
+        0xD9D75FB9914ED019ULL, 0xF83E29A7B468F1B5ULL, 0x9A05B385DB029341ULL, 0xBBECC59BFE24B2EDULL,
+        0x5E7287C105D656A9ULL, 0x7F9BF1DF20F07705ULL, 0x1DA06BFD4F9A15F1ULL, 0x3C491DE36ABC345DULL,
+        0x9560E45F03A57204ULL, 0xB4899241268353A8ULL, 0xD6B2086349E9315CULL, 0xF75B7E7D6CCF10F0ULL,
+        0x12C53C27973DF4B4ULL, 0x332C4A39B21BD518ULL, 0x5117D01BDD71B7ECULL, 0x70FEA605F8579640ULL,
+        0xAEF272FD7203EC0FULL, 0x8F1B04E35725CDA3ULL, 0xED209EC1384FAF57ULL, 0xCCC9E8DF1D698EFBULL,
+        0x2957AA85E69B6ABFULL, 0x08BEDC9BC3BD4B13ULL, 0x6A8546B9ACD729E7ULL, 0x4B6C30A789F1084BULL
+    }
+};
+
+uint64_t crc64_compute(uint64_t crc, const unsigned char* data, size_t size)
+{
+    uint64_t result;
+    /*Codes_SRS_IOTHUB_CLIENT_CRC64_41_001: [ If data is NULL and size is not 0, crc64_compute shall fail and return crc. ]*/
+    if ((data == NULL) && (size > 0))
+    {
+        LogError("invalid argument data(NULL), size(%lu)", (unsigned long)size);
+        result = crc;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CRC64_41_002: [ crc64_compute shall return the CRC64 of the bytes before data, whose CRC64 is crc, followed by the size bytes of data. ]*/
+        result = ~crc;
+
+        /*the 8 bytes are read one by one so that the result does not depend on the endianness or the alignment of data*/
+        while (size >= 8)
+        {
+            result ^= (uint64_t)data[0] | ((uint64_t)data[1] << 8) | ((uint64_t)data[2] << 16) | ((uint64_t)data[3] << 24) |
+                ((uint64_t)data[4] << 32) | ((uint64_t)data[5] << 40) | ((uint64_t)data[6] << 48) | ((uint64_t)data[7] << 56);
+            result =
+                crc64Table[7][result & 0xFF] ^
+                crc64Table[6][(result >> 8) & 0xFF] ^
+                crc64Table[5][(result >> 16) & 0xFF] ^
+                crc64Table[4][(result >> 24) & 0xFF] ^
+                crc64Table[3][(result >> 32) & 0xFF] ^
+                crc64Table[2][(result >> 40) & 0xFF] ^
+                crc64Table[1][(result >> 48) & 0xFF] ^
+                crc64Table[0][result >> 56];
+            data += 8;
+            size -= 8;
+        }
+
+        while (size > 0)
+        {
+            result = crc64Table[0][(result ^ *data) & 0xFF] ^ (result >> 8);
+            data++;
+            size--;
+        }
+
+        result = ~result;
+    }
+    return result;
+}
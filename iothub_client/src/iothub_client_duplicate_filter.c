@@ -0,0 +1,169 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_duplicate_filter.h"
+#include "iothub_client_crc64.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+/*10 bits and 7 hashes per id give about 1% of false positives in a full filter*/
+#define BITS_PER_ID 10
+#define HASH_COUNT 7
+#define BITS_PER_WORD 64
+
+typedef struct DUPLICATE_FILTER_TAG
+{
+    size_t capacity;
+    tickcounter_ms_t windowInMs;
+    size_t bitCount;
+    size_t wordCount;
+    uint64_t* current; /*both filters follow the struct in the same allocation*/
+    uint64_t* previous;
+    size_t currentCount; /*ids added to current*/
+    tickcounter_ms_t currentStart;
+} DUPLICATE_FILTER;
+
+/*the HASH_COUNT bits of an id are h1 + i * h2 (double hashing), both halves of its CRC64*/
+static void get_hashes(const char* messageId, uint32_t* h1, uint32_t* h2)
+{
+    uint64_t crc = crc64_compute(0, (const unsigned char*)messageId, strlen(messageId));
+    *h1 = (uint32_t)crc;
+    *h2 = (uint32_t)(crc >> 32) | 1;
+}
+
+static size_t get_bit(const DUPLICATE_FILTER* filter, uint32_t h1, uint32_t h2, size_t i)
+{
+    return (size_t)((h1 + (uint64_t)i * h2) % filter->bitCount);
+}
+
+static bool has_all_bits(const DUPLICATE_FILTER* filter, const uint64_t* words, uint32_t h1, uint32_t h2)
+{
+    bool result = true;
+    size_t i;
+    for (i = 0; (i < HASH_COUNT) && result; i++)
+    {
+        size_t bit = get_bit(filter, h1, h2, i);
+        result = (words[bit / BITS_PER_WORD] & ((uint64_t)1 << (bit % BITS_PER_WORD))) != 0;
+    }
+    return result;
+}
+
+/*the current filter becomes the previous one, the ids of the previous one are forgotten*/
+static void start_current_filter(DUPLICATE_FILTER* filter, tickcounter_ms_t nowMs)
+{
+    uint64_t* forgotten = filter->previous;
+    filter->previous = filter->current;
+    filter->current = forgotten;
+    (void)memset(filter->current, 0, filter->wordCount * sizeof(uint64_t));
+    filter->currentCount = 0;
+    filter->currentStart = nowMs;
+}
+
+static void rotate_if_elapsed(DUPLICATE_FILTER* filter, tickcounter_ms_t nowMs)
+{
+    tickcounter_ms_t elapsed = nowMs - filter->currentStart;
+    if (elapsed >= filter->windowInMs)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_006: [ When windowInMs elapsed since the current filter was started, the current filter shall become the previous one, the ids older than two windows being forgotten, and an empty current filter shall be started. ]*/
+        start_current_filter(filter, nowMs);
+        if (elapsed >= 2 * filter->windowInMs)
+        {
+            start_current_filter(filter, nowMs);
+        }
+    }
+}
+
+DUPLICATE_FILTER_HANDLE duplicate_filter_create(size_t capacity, tickcounter_ms_t windowInMs)
+{
+    DUPLICATE_FILTER* result;
+    /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_001: [ If capacity or windowInMs is 0, or the filters of capacity ids do not fit a size_t, duplicate_filter_create shall fail and return NULL. ]*/
+    if ((capacity == 0) || (windowInMs == 0) || (capacity > (SIZE_MAX - sizeof(DUPLICATE_FILTER)) / (2 * BITS_PER_ID)))
+    {
+        LogError("invalid argument capacity=%lu, windowInMs=%lu", (unsigned long)capacity, (unsigned long)windowInMs);
+        result = NULL;
+    }
+    else
+    {
+        size_t wordCount = (capacity * BITS_PER_ID + BITS_PER_WORD - 1) / BITS_PER_WORD;
+        /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_002: [ duplicate_filter_create shall allocate, in one block, two empty bloom filters of BITS_PER_ID bits per id of capacity and return a non-NULL handle. ]*/
+        if ((result = (DUPLICATE_FILTER*)malloc(sizeof(DUPLICATE_FILTER) + 2 * wordCount * sizeof(uint64_t))) == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_003: [ If allocating fails, duplicate_filter_create shall fail and return NULL. ]*/
+            LogError("unable to malloc");
+        }
+        else
+        {
+            result->capacity = capacity;
+            result->windowInMs = windowInMs;
+            result->wordCount = wordCount;
+            result->bitCount = wordCount * BITS_PER_WORD;
+            result->current = (uint64_t*)(result + 1);
+            result->previous = result->current + wordCount;
+            (void)memset(result->current, 0, 2 * wordCount * sizeof(uint64_t));
+            result->currentCount = 0;
+            result->currentStart = 0;
+        }
+    }
+    return result;
+}
+
+void duplicate_filter_destroy(DUPLICATE_FILTER_HANDLE filter)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_004: [ duplicate_filter_destroy shall free the filter, doing nothing if filter is NULL. ]*/
+    free(filter);
+}
+
+bool duplicate_filter_contains(DUPLICATE_FILTER_HANDLE filter, const char* messageId, tickcounter_ms_t nowMs)
+{
+    bool result;
+    if ((filter == NULL) || (messageId == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_005: [ If filter or messageId is NULL, duplicate_filter_contains shall return false. ]*/
+        result = false;
+    }
+    else
+    {
+        uint32_t h1;
+        uint32_t h2;
+        rotate_if_elapsed(filter, nowMs);
+        get_hashes(messageId, &h1, &h2);
+        /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_007: [ duplicate_filter_contains shall return true if all the bits of messageId are set in the current or the previous filter, false otherwise. ]*/
+        result = has_all_bits(filter, filter->current, h1, h2) || has_all_bits(filter, filter->previous, h1, h2);
+    }
+    return result;
+}
+
+void duplicate_filter_add(DUPLICATE_FILTER_HANDLE filter, const char* messageId, tickcounter_ms_t nowMs)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_008: [ If filter or messageId is NULL, duplicate_filter_add shall do nothing. ]*/
+    if ((filter != NULL) && (messageId != NULL))
+    {
+        uint32_t h1;
+        uint32_t h2;
+        size_t i;
+        rotate_if_elapsed(filter, nowMs);
+        if (filter->currentCount >= filter->capacity)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_009: [ When the current filter holds capacity ids, duplicate_filter_add shall make it the previous one and start an empty current filter before adding messageId, bounding the false positives. ]*/
+            start_current_filter(filter, nowMs);
+        }
+
+        /*Codes_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_010: [ duplicate_filter_add shall set the HASH_COUNT bits of messageId, derived from its CRC64, in the current filter. ]*/
+        get_hashes(messageId, &h1, &h2);
+        for (i = 0; i < HASH_COUNT; i++)
+        {
+            size_t bit = get_bit(filter, h1, h2, i);
+            filter->current[bit / BITS_PER_WORD] |= ((uint64_t)1 << (bit % BITS_PER_WORD));
+        }
+        filter->currentCount++;
+    }
+}
@@ -0,0 +1,269 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "iothub_client_options.h"
+#include "iothub_client_happy_eyeballs.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+typedef struct HOST_FAMILY_TAG
+{
+    char* host; /*NULL while the entry is free*/
+    IOTHUB_CLIENT_ADDRESS_FAMILY family;
+    tickcounter_ms_t connected_time;
+} HOST_FAMILY;
+
+typedef struct HAPPY_EYEBALLS_TAG
+{
+    LOCK_HANDLE lock;
+    TICK_COUNTER_HANDLE tick_counter;
+    unsigned int connection_attempt_delay_in_ms;
+    bool is_unsupported_logged;
+    HOST_FAMILY hosts[HAPPY_EYEBALLS_MAX_HOSTS];
+} HAPPY_EYEBALLS;
+
+static HOST_FAMILY* find_host(HAPPY_EYEBALLS* happy_eyeballs, const char* host)
+{
+    HOST_FAMILY* result = NULL;
+    size_t i;
+
+    for (i = 0; i < HAPPY_EYEBALLS_MAX_HOSTS; i++)
+    {
+        if ((happy_eyeballs->hosts[i].host != NULL) && (strcmp(happy_eyeballs->hosts[i].host, host) == 0))
+        {
+            result = &happy_eyeballs->hosts[i];
+            break;
+        }
+    }
+
+    return result;
+}
+
+static void forget_host(HOST_FAMILY* host_family)
+{
+    free(host_family->host);
+    host_family->host = NULL;
+}
+
+/*the entry of host, else a free one, else the one that connected first*/
+static HOST_FAMILY* get_host_entry(HAPPY_EYEBALLS* happy_eyeballs, const char* host)
+{
+    HOST_FAMILY* result = find_host(happy_eyeballs, host);
+
+    if (result == NULL)
+    {
+        size_t i;
+
+        result = &happy_eyeballs->hosts[0];
+        for (i = 0; (i < HAPPY_EYEBALLS_MAX_HOSTS) && (result->host != NULL); i++)
+        {
+            if ((happy_eyeballs->hosts[i].host == NULL) || (happy_eyeballs->hosts[i].connected_time < result->connected_time))
+            {
+                result = &happy_eyeballs->hosts[i];
+            }
+        }
+
+        if (result->host != NULL)
+        {
+            forget_host(result);
+        }
+
+        if (mallocAndStrcpy_s(&result->host, host) != 0)
+        {
+            LogError("unable to copy the host name");
+            result->host = NULL;
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+HAPPY_EYEBALLS_HANDLE happy_eyeballs_create(unsigned int connection_attempt_delay_in_ms)
+{
+    HAPPY_EYEBALLS* result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_001: [ happy_eyeballs_create shall allocate the happy eyeballs, create its lock and tick counter, and return it with no family remembered. ]*/
+    if ((result = (HAPPY_EYEBALLS*)malloc(sizeof(HAPPY_EYEBALLS))) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_002: [ If any of them fails, happy_eyeballs_create shall fail and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else if ((result->lock = Lock_Init()) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_002: [ If any of them fails, happy_eyeballs_create shall fail and return NULL. ]*/
+        LogError("unable to Lock_Init");
+        free(result);
+        result = NULL;
+    }
+    else if ((result->tick_counter = tickcounter_create()) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_002: [ If any of them fails, happy_eyeballs_create shall fail and return NULL. ]*/
+        LogError("unable to tickcounter_create");
+        (void)Lock_Deinit(result->lock);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_003: [ If connection_attempt_delay_in_ms is 0, the connection attempt delay shall be HAPPY_EYEBALLS_DEFAULT_CONNECTION_ATTEMPT_DELAY_IN_MS. ]*/
+        result->connection_attempt_delay_in_ms = (connection_attempt_delay_in_ms == 0) ? HAPPY_EYEBALLS_DEFAULT_CONNECTION_ATTEMPT_DELAY_IN_MS : connection_attempt_delay_in_ms;
+        result->is_unsupported_logged = false;
+        memset(result->hosts, 0, sizeof(result->hosts));
+    }
+
+    return result;
+}
+
+void happy_eyeballs_destroy(HAPPY_EYEBALLS_HANDLE happy_eyeballs)
+{
+    if (happy_eyeballs == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_004: [ If happy_eyeballs is NULL, happy_eyeballs_destroy shall return. ]*/
+        LogError("invalid argument happy_eyeballs (NULL)");
+    }
+    else
+    {
+        size_t i;
+
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_005: [ happy_eyeballs_destroy shall free the remembered hosts, destroy the tick counter and the lock and free the happy eyeballs. ]*/
+        for (i = 0; i < HAPPY_EYEBALLS_MAX_HOSTS; i++)
+        {
+            free(happy_eyeballs->hosts[i].host);
+        }
+        tickcounter_destroy(happy_eyeballs->tick_counter);
+        (void)Lock_Deinit(happy_eyeballs->lock);
+        free(happy_eyeballs);
+    }
+}
+
+void happy_eyeballs_prepare_io(HAPPY_EYEBALLS_HANDLE happy_eyeballs, XIO_HANDLE xio, const char* host)
+{
+    if ((happy_eyeballs == NULL) || (xio == NULL) || (host == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_006: [ If happy_eyeballs, xio or host is NULL, happy_eyeballs_prepare_io shall return. ]*/
+        LogError("invalid argument happy_eyeballs=%p, xio=%p, host=%p", happy_eyeballs, xio, host);
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_007: [ happy_eyeballs_prepare_io shall set the connection attempt delay on xio with OPTION_XIO_CONNECTION_ATTEMPT_DELAY. ]*/
+    else if (xio_setoption(xio, OPTION_XIO_CONNECTION_ATTEMPT_DELAY, &happy_eyeballs->connection_attempt_delay_in_ms) != 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_008: [ If xio_setoption fails, happy_eyeballs_prepare_io shall return, the xio connecting with the policy of its platform. ]*/
+        if (!happy_eyeballs->is_unsupported_logged)
+        {
+            happy_eyeballs->is_unsupported_logged = true;
+            LogInfo("the platform socket adapter does not race the address families, it connects with its own policy");
+        }
+    }
+    else if (Lock(happy_eyeballs->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_009: [ If Lock or tickcounter_get_current_ms fail, happy_eyeballs_prepare_io shall return without a preferred family. ]*/
+        LogError("Failed to consult the remembered address families (Lock failed)");
+    }
+    else
+    {
+        IOTHUB_CLIENT_ADDRESS_FAMILY family = IOTHUB_CLIENT_ADDRESS_FAMILY_ANY;
+        HOST_FAMILY* host_family = find_host(happy_eyeballs, host);
+        tickcounter_ms_t now;
+
+        if (host_family == NULL)
+        {
+            // Nothing known of the host, the attempts are raced from its first address
+        }
+        else if (tickcounter_get_current_ms(happy_eyeballs->tick_counter, &now) != 0)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_009: [ If Lock or tickcounter_get_current_ms fail, happy_eyeballs_prepare_io shall return without a preferred family. ]*/
+            LogError("Failed to consult the remembered address families (tickcounter_get_current_ms failed)");
+        }
+        else if (now - host_family->connected_time >= HAPPY_EYEBALLS_FAMILY_LIFETIME_IN_MS)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_010: [ A family remembered for HAPPY_EYEBALLS_FAMILY_LIFETIME_IN_MS or more shall be forgotten. ]*/
+            forget_host(host_family);
+        }
+        else
+        {
+            family = host_family->family;
+        }
+
+        (void)Unlock(happy_eyeballs->lock);
+
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_011: [ If a family is remembered for host, happy_eyeballs_prepare_io shall set it on xio with OPTION_XIO_PREFERRED_ADDRESS_FAMILY, a failure being ignored. ]*/
+        if ((family != IOTHUB_CLIENT_ADDRESS_FAMILY_ANY) &&
+            (xio_setoption(xio, OPTION_XIO_PREFERRED_ADDRESS_FAMILY, &family) != 0))
+        {
+            LogError("unable to set the preferred address family of %s", host);
+        }
+    }
+}
+
+void happy_eyeballs_on_connected(HAPPY_EYEBALLS_HANDLE happy_eyeballs, XIO_HANDLE xio, const char* host)
+{
+    IOTHUB_CLIENT_ADDRESS_FAMILY family = IOTHUB_CLIENT_ADDRESS_FAMILY_ANY;
+
+    if ((happy_eyeballs == NULL) || (xio == NULL) || (host == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_012: [ If happy_eyeballs, xio or host is NULL, happy_eyeballs_on_connected shall return. ]*/
+        LogError("invalid argument happy_eyeballs=%p, xio=%p, host=%p", happy_eyeballs, xio, host);
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_013: [ happy_eyeballs_on_connected shall get the family xio connected with using xio_setoption with OPTION_XIO_CONNECTED_ADDRESS_FAMILY, and return if it fails or gives IOTHUB_CLIENT_ADDRESS_FAMILY_ANY. ]*/
+    else if ((xio_setoption(xio, OPTION_XIO_CONNECTED_ADDRESS_FAMILY, &family) != 0) || (family == IOTHUB_CLIENT_ADDRESS_FAMILY_ANY))
+    {
+        // The platform socket adapter does not say, nothing to remember
+    }
+    else if (Lock(happy_eyeballs->lock) != LOCK_OK)
+    {
+        LogError("Failed to remember the address family of %s (Lock failed)", host);
+    }
+    else
+    {
+        HOST_FAMILY* host_family;
+        tickcounter_ms_t now;
+
+        if (tickcounter_get_current_ms(happy_eyeballs->tick_counter, &now) != 0)
+        {
+            LogError("Failed to remember the address family of %s (tickcounter_get_current_ms failed)", host);
+        }
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_014: [ happy_eyeballs_on_connected shall remember the family for host with the current time, in place of the host that connected the longest ago when HAPPY_EYEBALLS_MAX_HOSTS hosts are remembered. ]*/
+        else if ((host_family = get_host_entry(happy_eyeballs, host)) != NULL)
+        {
+            host_family->family = family;
+            host_family->connected_time = now;
+        }
+
+        (void)Unlock(happy_eyeballs->lock);
+    }
+}
+
+void happy_eyeballs_on_connect_failed(HAPPY_EYEBALLS_HANDLE happy_eyeballs, const char* host)
+{
+    if ((happy_eyeballs == NULL) || (host == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_015: [ If happy_eyeballs or host is NULL, happy_eyeballs_on_connect_failed shall return. ]*/
+        LogError("invalid argument happy_eyeballs=%p, host=%p", happy_eyeballs, host);
+    }
+    else if (Lock(happy_eyeballs->lock) != LOCK_OK)
+    {
+        LogError("Failed to forget the address family of %s (Lock failed)", host);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_016: [ happy_eyeballs_on_connect_failed shall forget the family of host, so its next connection races both families again. ]*/
+        HOST_FAMILY* host_family = find_host(happy_eyeballs, host);
+        if (host_family != NULL)
+        {
+            forget_host(host_family);
+        }
+
+        (void)Unlock(happy_eyeballs->lock);
+    }
+}
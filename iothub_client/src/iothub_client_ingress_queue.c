@@ -0,0 +1,255 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_ingress_queue.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+/*the producers push on a lock-free LIFO stack. The consumer takes the whole stack at once and reverses it into a private FIFO list.
+Since the only operations on the stack are push and take all, the stack does not suffer from ABA*/
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define INGRESS_QUEUE_USE_C11_ATOMICS
+#define INGRESS_QUEUE_HEAD(type) _Atomic(type)
+#elif defined(_MSC_VER)
+#include <windows.h>
+#define INGRESS_QUEUE_USE_INTERLOCKED
+#define INGRESS_QUEUE_HEAD(type) type volatile
+#elif defined(__GNUC__)
+#define INGRESS_QUEUE_HEAD(type) type volatile
+#else
+/*no atomic compare-and-swap, the producers serialize on a lock owned by the queue (never on the lock of the client)*/
+#include "azure_c_shared_utility/lock.h"
+#define INGRESS_QUEUE_USE_LOCK
+#define INGRESS_QUEUE_HEAD(type) type
+#endif
+
+typedef struct INGRESS_QUEUE_NODE_TAG
+{
+    struct INGRESS_QUEUE_NODE_TAG* next;
+    void* value;
+} INGRESS_QUEUE_NODE;
+
+typedef struct INGRESS_QUEUE_TAG
+{
+    INGRESS_QUEUE_HEAD(INGRESS_QUEUE_NODE*) head; /*pushed by the producers, newest first*/
+    INGRESS_QUEUE_NODE* consumer_list; /*only touched by the consumer, oldest first*/
+#ifdef INGRESS_QUEUE_USE_LOCK
+    LOCK_HANDLE lock;
+#endif
+} INGRESS_QUEUE;
+
+static INGRESS_QUEUE_NODE* load_head(INGRESS_QUEUE* ingress_queue)
+{
+#ifdef INGRESS_QUEUE_USE_C11_ATOMICS
+    return atomic_load(&ingress_queue->head);
+#else
+    /*a stale value only makes the next compare-and-swap fail*/
+    return ingress_queue->head;
+#endif
+}
+
+static bool compare_and_swap_head(INGRESS_QUEUE* ingress_queue, INGRESS_QUEUE_NODE* expected, INGRESS_QUEUE_NODE* desired)
+{
+    bool result;
+#if defined(INGRESS_QUEUE_USE_LOCK)
+    if (Lock(ingress_queue->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        result = false;
+    }
+    else
+    {
+        if (ingress_queue->head == expected)
+        {
+            ingress_queue->head = desired;
+            result = true;
+        }
+        else
+        {
+            result = false;
+        }
+        (void)Unlock(ingress_queue->lock);
+    }
+#elif defined(INGRESS_QUEUE_USE_C11_ATOMICS)
+    result = atomic_compare_exchange_weak(&ingress_queue->head, &expected, desired);
+#elif defined(INGRESS_QUEUE_USE_INTERLOCKED)
+    result = (InterlockedCompareExchangePointer((PVOID volatile*)&ingress_queue->head, desired, expected) == expected);
+#else
+    result = __sync_bool_compare_and_swap(&ingress_queue->head, expected, desired);
+#endif
+    return result;
+}
+
+/*takes all the nodes pushed so far, newest first*/
+static INGRESS_QUEUE_NODE* take_all(INGRESS_QUEUE* ingress_queue)
+{
+    INGRESS_QUEUE_NODE* head;
+    do
+    {
+        head = load_head(ingress_queue);
+    } while ((head != NULL) && !compare_and_swap_head(ingress_queue, head, NULL));
+    return head;
+}
+
+INGRESS_QUEUE_HANDLE ingress_queue_create(void)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_001: [ ingress_queue_create shall allocate memory for an empty queue and return a handle to it. ]*/
+    INGRESS_QUEUE* result = (INGRESS_QUEUE*)malloc(sizeof(INGRESS_QUEUE));
+    if (result == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_002: [ If any error occurs, ingress_queue_create shall fail and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        result->consumer_list = NULL;
+#ifdef INGRESS_QUEUE_USE_LOCK
+        result->head = NULL;
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("unable to Lock_Init");
+            free(result);
+            result = NULL;
+        }
+#elif defined(INGRESS_QUEUE_USE_C11_ATOMICS)
+        atomic_init(&result->head, NULL);
+#else
+        result->head = NULL;
+#endif
+    }
+    return result;
+}
+
+void ingress_queue_destroy(INGRESS_QUEUE_HANDLE ingress_queue)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_003: [ If ingress_queue is NULL, ingress_queue_destroy shall return. ]*/
+    if (ingress_queue != NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_004: [ ingress_queue_destroy shall free the queue and the nodes of the values not popped yet. The values themselves are not freed. ]*/
+        INGRESS_QUEUE_NODE* node = ingress_queue->consumer_list;
+        while (node != NULL)
+        {
+            INGRESS_QUEUE_NODE* next = node->next;
+            free(node);
+            node = next;
+        }
+        node = take_all(ingress_queue);
+        while (node != NULL)
+        {
+            INGRESS_QUEUE_NODE* next = node->next;
+            free(node);
+            node = next;
+        }
+#ifdef INGRESS_QUEUE_USE_LOCK
+        Lock_Deinit(ingress_queue->lock);
+#endif
+        free(ingress_queue);
+    }
+}
+
+int ingress_queue_push(INGRESS_QUEUE_HANDLE ingress_queue, void* value, bool* was_empty)
+{
+    int result;
+    if ((ingress_queue == NULL) || (value == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_005: [ If ingress_queue or value are NULL, ingress_queue_push shall fail and return a non-zero value. ]*/
+        LogError("invalid argument INGRESS_QUEUE_HANDLE ingress_queue=%p, void* value=%p", ingress_queue, value);
+        result = __FAILURE__;
+    }
+    else
+    {
+        INGRESS_QUEUE_NODE* node = (INGRESS_QUEUE_NODE*)malloc(sizeof(INGRESS_QUEUE_NODE));
+        if (node == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_006: [ If allocating the node fails, ingress_queue_push shall fail and return a non-zero value. ]*/
+            LogError("unable to malloc");
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_007: [ ingress_queue_push shall add value to the queue with an atomic compare-and-swap, without taking a lock, and return 0. ]*/
+            node->value = value;
+            do
+            {
+                node->next = load_head(ingress_queue);
+            } while (!compare_and_swap_head(ingress_queue, node->next, node));
+
+            /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_014: [ If was_empty is not NULL, ingress_queue_push shall set it to true when no other value pushed before was left for the consumer to take, false otherwise. ]*/
+            if (was_empty != NULL)
+            {
+                *was_empty = (node->next == NULL);
+            }
+            result = 0;
+        }
+    }
+    return result;
+}
+
+void* ingress_queue_pop(INGRESS_QUEUE_HANDLE ingress_queue)
+{
+    void* result;
+    if (ingress_queue == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_008: [ If ingress_queue is NULL, ingress_queue_pop shall return NULL. ]*/
+        LogError("invalid argument INGRESS_QUEUE_HANDLE ingress_queue=%p", ingress_queue);
+        result = NULL;
+    }
+    else
+    {
+        INGRESS_QUEUE_NODE* node;
+        if (ingress_queue->consumer_list == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_009: [ When the values taken before are exhausted, ingress_queue_pop shall take all the values pushed since, in the order they were pushed. ]*/
+            INGRESS_QUEUE_NODE* taken = take_all(ingress_queue);
+            while (taken != NULL)
+            {
+                INGRESS_QUEUE_NODE* next = taken->next;
+                taken->next = ingress_queue->consumer_list;
+                ingress_queue->consumer_list = taken;
+                taken = next;
+            }
+        }
+
+        node = ingress_queue->consumer_list;
+        if (node == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_010: [ If the queue is empty, ingress_queue_pop shall return NULL. ]*/
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_011: [ ingress_queue_pop shall remove the oldest value from the queue, free its node and return the value. ]*/
+            ingress_queue->consumer_list = node->next;
+            result = node->value;
+            free(node);
+        }
+    }
+    return result;
+}
+
+bool ingress_queue_is_empty(INGRESS_QUEUE_HANDLE ingress_queue)
+{
+    bool result;
+    if (ingress_queue == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_012: [ If ingress_queue is NULL, ingress_queue_is_empty shall return true. ]*/
+        LogError("invalid argument INGRESS_QUEUE_HANDLE ingress_queue=%p", ingress_queue);
+        result = true;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_013: [ ingress_queue_is_empty shall return false if a value was pushed and not popped yet, true otherwise. ]*/
+        result = (ingress_queue->consumer_list == NULL) && (load_head(ingress_queue) == NULL);
+    }
+    return result;
+}
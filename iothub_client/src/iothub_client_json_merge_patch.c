@@ -0,0 +1,148 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/constbuffer.h"
+#include "parson.h"
+
+#include "iothub_client_json_merge_patch.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+static JSON_Value* parse_json(const unsigned char* buffer, size_t size)
+{
+    JSON_Value* result;
+    /*the patches are not null terminated*/
+    char* json_string = (char*)malloc(size + 1);
+    if (json_string == NULL)
+    {
+        LogError("unable to malloc");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(json_string, buffer, size);
+        json_string[size] = '\0';
+        result = json_parse_string(json_string);
+        free(json_string);
+    }
+    return result;
+}
+
+static int combine_objects(JSON_Object* target, const JSON_Object* patch)
+{
+    int result = 0;
+    size_t count = json_object_get_count(patch);
+    size_t index;
+    for (index = 0; (result == 0) && (index < count); index++)
+    {
+        const char* name = json_object_get_name(patch, index);
+        JSON_Value* patch_value = json_object_get_value(patch, name);
+        JSON_Value* target_value = json_object_get_value(target, name);
+        if ((json_value_get_type(patch_value) == JSONObject) && (target_value != NULL))
+        {
+            if (json_value_get_type(target_value) == JSONObject)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_004: [ A member that is an object in both patches shall be combined the same way. ]*/
+                result = combine_objects(json_value_get_object(target_value), json_value_get_object(patch_value));
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_005: [ If a member is a value or null in first and an object in second, json_merge_patch_combine shall return NULL. ]*/
+                result = __FAILURE__;
+            }
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_003: [ json_merge_patch_combine shall set every member of second that is not an object in both patches, null included, to its value in second. ]*/
+            JSON_Value* copy = json_value_deep_copy(patch_value);
+            if (copy == NULL)
+            {
+                LogError("unable to json_value_deep_copy");
+                result = __FAILURE__;
+            }
+            else if (json_object_set_value(target, name, copy) != JSONSuccess)
+            {
+                LogError("unable to json_object_set_value");
+                json_value_free(copy);
+                result = __FAILURE__;
+            }
+        }
+    }
+    return result;
+}
+
+CONSTBUFFER_HANDLE json_merge_patch_combine(CONSTBUFFER_HANDLE first, const unsigned char* second, size_t second_size)
+{
+    CONSTBUFFER_HANDLE result;
+    const CONSTBUFFER* first_content;
+    JSON_Value* first_value;
+    if ((first == NULL) || (second == NULL) || (second_size == 0))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_001: [ If first or second is NULL or second_size is 0, json_merge_patch_combine shall return NULL. ]*/
+        LogError("invalid argument CONSTBUFFER_HANDLE first=%p, const unsigned char* second=%p, size_t second_size=%lu", first, second, (unsigned long)second_size);
+        result = NULL;
+    }
+    else if ((first_content = CONSTBUFFER_GetContent(first)) == NULL)
+    {
+        LogError("unable to CONSTBUFFER_GetContent");
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_002: [ If first or second is not a JSON object, json_merge_patch_combine shall return NULL. ]*/
+    else if ((first_value = parse_json(first_content->buffer, first_content->size)) == NULL)
+    {
+        LogError("first is not JSON");
+        result = NULL;
+    }
+    else
+    {
+        JSON_Value* second_value = parse_json(second, second_size);
+        if (second_value == NULL)
+        {
+            LogError("second is not JSON");
+            result = NULL;
+        }
+        else
+        {
+            if ((json_value_get_type(first_value) != JSONObject) || (json_value_get_type(second_value) != JSONObject))
+            {
+                LogError("the patches are not JSON objects");
+                result = NULL;
+            }
+            else if (combine_objects(json_value_get_object(first_value), json_value_get_object(second_value)) != 0)
+            {
+                /*not an error, the patches are applied one after the other*/
+                result = NULL;
+            }
+            else
+            {
+                char* serialized = json_serialize_to_string(first_value);
+                if (serialized == NULL)
+                {
+                    /*Codes_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_007: [ If any error occurs, json_merge_patch_combine shall return NULL. ]*/
+                    LogError("unable to json_serialize_to_string");
+                    result = NULL;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_006: [ json_merge_patch_combine shall return a new CONSTBUFFER_HANDLE holding the combined patch, without null terminator, and leave first unchanged. ]*/
+                    result = CONSTBUFFER_Create((const unsigned char*)serialized, strlen(serialized));
+                    if (result == NULL)
+                    {
+                        LogError("unable to CONSTBUFFER_Create");
+                    }
+                    json_free_serialized_string(serialized);
+                }
+            }
+            json_value_free(second_value);
+        }
+        json_value_free(first_value);
+    }
+    return result;
+}
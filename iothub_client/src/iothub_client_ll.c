@@ -13,18 +13,32 @@
 #include "azure_c_shared_utility/platform.h"
 
 #include "iothub_client_authorization.h"
+#include "iothub_client_features.h"
 #include "iothub_client_ll.h"
 #include "iothub_transport_ll.h"
 #include "iothub_client_private.h"
 #include "iothub_client_options.h"
 #include "iothub_client_version.h"
+#include "iothub_client_outbox.h"
+#include "iothub_client_json_merge_patch.h"
+#include "iothub_client_twin_cache.h"
+#include "iothub_client_compression.h"
+#include "iothub_client_pipeline.h"
+#include "iothub_client_duplicate_filter.h"
+#include "iothub_client_chunking.h"
+#include "iothub_client_trace.h"
+#include "iothub_client_log_limit.h"
 #include <stdint.h>
 
 #ifndef DONT_USE_UPLOADTOBLOB
 #include "iothub_client_ll_uploadtoblob.h"
 #endif
 
-#define LOG_ERROR_RESULT LogError("result = %s", ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result));
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+/*the sends fail once per message while a queue is full or the heap is short, each of its uses is limited on its own*/
+#define LOG_ERROR_RESULT LogErrorLimited("result = %s", ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result))
 #define INDEFINITE_TIME ((time_t)(-1))
 
 DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
@@ -33,11 +47,13 @@ DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATIO
 #define CALLBACK_TYPE_VALUES \
     CALLBACK_TYPE_NONE,      \
     CALLBACK_TYPE_SYNC,    \
-    CALLBACK_TYPE_ASYNC
+    CALLBACK_TYPE_ASYNC,   \
+    CALLBACK_TYPE_CHUNKED
 
 DEFINE_ENUM(CALLBACK_TYPE, CALLBACK_TYPE_VALUES)
 DEFINE_ENUM_STRINGS(CALLBACK_TYPE, CALLBACK_TYPE_VALUES)
 
+#ifndef DONT_USE_DEVICE_METHODS
 typedef struct IOTHUB_METHOD_CALLBACK_DATA_TAG
 {
     CALLBACK_TYPE type;
@@ -45,41 +61,138 @@ typedef struct IOTHUB_METHOD_CALLBACK_DATA_TAG
     IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK callbackAsync;
     void* userContextCallback;
 }IOTHUB_METHOD_CALLBACK_DATA;
+#endif
 
 typedef struct IOTHUB_MESSAGE_CALLBACK_DATA_TAG
 {
     CALLBACK_TYPE type;
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC callbackSync;
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX callbackAsync;
+    IOTHUB_CLIENT_MESSAGE_CHUNK_CALLBACK callbackChunked;
+    size_t chunkSize;
     void* userContextCallback;
 }IOTHUB_MESSAGE_CALLBACK_DATA;
 
+/*confirmation callback of a message appended to the outbox during this session, in the order of the outbox*/
+typedef struct IOTHUB_OUTBOX_CALLBACK_TAG
+{
+    DLIST_ENTRY entry;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+} IOTHUB_OUTBOX_CALLBACK;
+
+#define OUTBOX_SLOT_PENDING 0
+#define OUTBOX_SLOT_DELIVERED 1
+#define OUTBOX_SLOT_UNREADABLE 2
+
+#define PRIORITY_LANE_COUNT (IOTHUB_MESSAGE_PRIORITY_HIGH + 1)
+#define PRIORITY_TAG_SCALE ((uint64_t)1 << 20) /*tag step of a message of weight 1*/
+
+#define RATE_LIMIT_TOKEN 1000 /*the tokens are counted in thousandths, so ms times a rate per second adds whole ones*/
+#define RATE_LIMIT_FULL_SCALE 1000000 /*millionths of the configured rates*/
+#define RATE_LIMIT_MIN_SCALE (RATE_LIMIT_FULL_SCALE / 16)
+#define RATE_LIMIT_RECOVERY_PER_MS (RATE_LIMIT_FULL_SCALE / 10 / 1000) /*a tenth of the configured rates per second*/
+#define RATE_LIMIT_SLOWDOWN_INTERVAL_MS 1000 /*the failures of one throttled burst halve the rates once*/
+
+#ifndef DONT_USE_DEVICE_TWIN
+#define TWIN_ACK_TIMEOUT_STATUS_CODE 408 /*what the MQTT transport reports for the reported states still waiting when it is destroyed*/
+#endif
+
 typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
 {
     DLIST_ENTRY waitingToSend;
+#ifndef DONT_USE_DEVICE_TWIN
     DLIST_ENTRY iot_msg_queue;
     DLIST_ENTRY iot_ack_queue;
+#endif
     TRANSPORT_LL_HANDLE transportHandle;
     bool isSharedTransport;
     IOTHUB_DEVICE_HANDLE deviceHandle;
     TRANSPORT_PROVIDER_FIELDS;
     IOTHUB_MESSAGE_CALLBACK_DATA messageCallback;
+#ifndef DONT_USE_DEVICE_METHODS
     IOTHUB_METHOD_CALLBACK_DATA methodCallback;
+#endif
     IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK conStatusCallback;
     void* conStatusUserContextCallback;
     time_t lastMessageReceiveTime;
     TICK_COUNTER_HANDLE tickCounter; /*shared tickcounter used to track message timeouts in waitingToSend list*/
     tickcounter_ms_t currentMessageTimeout;
+    tickcounter_ms_t nextMessageTimeout; /*no message in waitingToSend times out before this, 0 means no message can time out*/
+    tickcounter_ms_t lastMessageTimeout; /*latest timeout of the messages added to waitingToSend*/
+    bool waitingToSendOrderedByTimeout; /*true while the messages with a timeout appear in waitingToSend in the order they time out*/
+    IOTHUB_MESSAGE_LIST* messageListPool; /*released IOTHUB_MESSAGE_LIST entries kept for reuse, linked through entry.Flink*/
+    size_t messageListPoolMaxCount; /*0 means released entries are freed*/
+    IOTHUB_CLIENT_POOL_STATISTICS messageListPoolStatistics;
+    tickcounter_ms_t idleTrimTimeMs; /*"idle_trim_time", 0 when the memory is trimmed by IoTHubClient_LL_TrimMemory only*/
+    bool isIdle; /*no message or reported state was queued at the last DoWork*/
+    bool isIdleTrimmed; /*the memory was trimmed since the client became idle*/
+    tickcounter_ms_t idleSince;
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS sendQueueLimits;
+    bool sendQueueLimitsEnabled; /*messages sent while enabled are counted until they complete*/
+    size_t sendQueueMessageCount;
+    size_t sendQueueByteCount;
+    bool sendQueueAboveHighWatermark;
+    bool statisticsEnabled; /*messages sent while enabled are counted in statistics until they complete*/
+    IOTHUB_CLIENT_STATISTICS statistics; /*depths, percentiles and msDisconnected are computed by IoTHubClient_LL_GetStatistics*/
+    uint64_t statisticsCompletedByTransport;
+    bool statisticsConnected;
+    bool statisticsDisconnectedAfterConnected;
+    tickcounter_ms_t statisticsDisconnectedSince;
+    OUTBOX_HANDLE outbox; /*when set, SendEventAsync appends to it and DoWork moves its messages to waitingToSend*/
+    size_t outboxMaxInFlight;
+    size_t outboxInFlight; /*messages read from the outbox and not completed yet*/
+    bool outboxRewindPending; /*a message failed, the outbox is read again from its oldest message once nothing is in flight*/
+    uint64_t outboxReleasedSequence; /*sequence of the oldest message of the outbox*/
+    uint64_t outboxReadSequence; /*sequence of the next message read from the outbox*/
+    unsigned char* outboxSlots; /*OUTBOX_SLOT_* of the messages in flight, indexed by sequence modulo outboxMaxInFlight*/
+    DLIST_ENTRY outboxCallbacks; /*initialized with the outbox*/
+    size_t outboxRestoredCount; /*oldest messages of the outbox that were in the file already, they have no callback*/
+    IOTHUB_CLIENT_RATE_LIMIT rateLimit; /*both rates are 0 while waitingToSend is handed to the transport as it is*/
+    uint64_t rateLimitScale; /*RATE_LIMIT_FULL_SCALE unless the sends failed lately*/
+    uint64_t rateLimitMessageTokens;
+    uint64_t rateLimitByteTokens;
+    tickcounter_ms_t rateLimitRefilledAt;
+    tickcounter_ms_t rateLimitSlowedAt;
+    bool priorityEnabled; /*messages sent while enabled are placed in waitingToSend by their priorityTag*/
+    uint64_t priorityTagStep[PRIORITY_LANE_COUNT]; /*PRIORITY_TAG_SCALE divided by the weight of the lane*/
+    uint64_t priorityLastTag[PRIORITY_LANE_COUNT];
+    uint64_t priorityMaxTag;
+    uint64_t priorityVirtualTime; /*tag of the message at the head of waitingToSend, the lanes that fell behind start again from it*/
+#ifndef DONT_USE_DEVICE_TWIN
+    bool coalesceReportedState; /*reported states sent while enabled are merged into the last one of iot_msg_queue*/
+    size_t twinMaxInFlight; /*0 means the items of iot_msg_queue are all given to the transport*/
+    tickcounter_ms_t twinAckTimeoutMs;
+    size_t twinInFlight; /*items of iot_ack_queue*/
+    TWIN_CACHE_HANDLE twinCache; /*NULL while the complete twin documents go to the application as they come*/
+#endif
+    COMPRESSOR_HANDLE compressor; /*NULL while compression is disabled*/
+    size_t compressionMinimumSize;
+    MESSAGE_PIPELINE_HANDLE pipeline; /*NULL while the messages are queued as they are sent*/
+    DUPLICATE_FILTER_HANDLE duplicateFilter; /*NULL while every cloud-to-device message goes to the application*/
+    size_t messageChunkSize; /*0 while the messages are sent whole*/
+    bool isReceivePaused; /*the transport is unsubscribed from messages and methods while their callbacks are kept*/
+    IOTHUB_CLIENT_MESSAGE_TRACE_CALLBACK traceCallback; /*messages sent while it is set are traced*/
+    void* traceContext;
+    int keepAliveInterval; /*last keepalive reported by the transport, 0 while it does not adapt it*/
+#ifndef DONT_USE_DEVICE_TWIN
     uint64_t current_device_twin_timeout;
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback;
     void* deviceTwinContextCallback;
+    IOTHUB_CLIENT_DEVICE_TWIN_CHUNK_CALLBACK deviceTwinChunkCallback; /*deviceTwinCallback is deliver_twin_chunks while it is set*/
+    void* deviceTwinChunkContextCallback;
+    size_t deviceTwinChunkSize;
+#endif
     IOTHUB_CLIENT_RETRY_POLICY retryPolicy;
     size_t retryTimeoutLimitInSeconds;
 #ifndef DONT_USE_UPLOADTOBLOB
-    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE uploadToBlobHandle;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE uploadToBlobHandle; /*NULL until the first upload or upload option*/
+    IOTHUB_CLIENT_CONFIG* uploadToBlobConfig; /*what uploadToBlobHandle is created from, strings in the same allocation*/
 #endif
+#ifndef DONT_USE_DEVICE_TWIN
     uint32_t data_msg_id;
     bool complete_twin_update_encountered;
+#endif
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
     STRING_HANDLE product_info;
 }IOTHUB_CLIENT_LL_HANDLE_DATA;
@@ -112,170 +225,712 @@ static void setTransportProtocol(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, TRANS
     handleData->IoTHubTransport_Subscribe_DeviceMethod = protocol->IoTHubTransport_Subscribe_DeviceMethod;
     handleData->IoTHubTransport_Unsubscribe_DeviceMethod = protocol->IoTHubTransport_Unsubscribe_DeviceMethod;
     handleData->IoTHubTransport_DeviceMethod_Response = protocol->IoTHubTransport_DeviceMethod_Response;
+    handleData->IoTHubTransport_GetNextWorkDeadline = protocol->IoTHubTransport_GetNextWorkDeadline;
+    handleData->IoTHubTransport_GetPollDescriptors = protocol->IoTHubTransport_GetPollDescriptors;
+    handleData->IoTHubTransport_TrimMemory = protocol->IoTHubTransport_TrimMemory;
 }
 
+#ifndef DONT_USE_DEVICE_TWIN
 static void device_twin_data_destroy(IOTHUB_DEVICE_TWIN* client_item)
 {
+    while (client_item->coalesced_callbacks != NULL)
+    {
+        IOTHUB_REPORTED_STATE_CALLBACK* next = client_item->coalesced_callbacks->next;
+        free(client_item->coalesced_callbacks);
+        client_item->coalesced_callbacks = next;
+    }
     CONSTBUFFER_Destroy(client_item->report_data_handle);
     free(client_item);
 }
 
-static int create_blob_upload_module(IOTHUB_CLIENT_LL_HANDLE_DATA* handle_data, const IOTHUB_CLIENT_CONFIG* config)
+static void device_twin_data_complete(IOTHUB_DEVICE_TWIN* client_item, int status_code)
 {
-    int result;
-    (void)handle_data;
-    (void)config;
-#ifndef DONT_USE_UPLOADTOBLOB
-    handle_data->uploadToBlobHandle = IoTHubClient_LL_UploadToBlob_Create(config);
-    if (handle_data->uploadToBlobHandle == NULL)
+    IOTHUB_REPORTED_STATE_CALLBACK* coalesced_callback;
+    if (client_item->reported_state_callback != NULL)
     {
-        LogError("unable to IoTHubClient_LL_UploadToBlob_Create");
-        result = __FAILURE__;
+        client_item->reported_state_callback(status_code, client_item->context);
     }
-    else
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_049: [ IoTHubClient_LL_ReportedStateComplete shall then call, in the order they were sent, the callbacks of the reported states merged into the item with status_code. ]*/
+    for (coalesced_callback = client_item->coalesced_callbacks; coalesced_callback != NULL; coalesced_callback = coalesced_callback->next)
     {
-        result = 0;
+        coalesced_callback->reported_state_callback(status_code, coalesced_callback->context);
     }
-#else
-    result = 0;
+}
 #endif
+
+static IOTHUB_MESSAGE_LIST* message_list_pool_acquire(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    IOTHUB_MESSAGE_LIST* result;
+    if (handleData->messageListPool != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_008: [ IoTHubClient_LL_SendEventAsync shall reuse a released IOTHUB_MESSAGE_LIST entry if there is one in the pool instead of allocating a new one. ]*/
+        result = handleData->messageListPool;
+        handleData->messageListPool = (IOTHUB_MESSAGE_LIST*)result->entry.Flink;
+        handleData->messageListPoolStatistics.cached--;
+        handleData->messageListPoolStatistics.hits++;
+    }
+    else
+    {
+        result = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
+        if (result != NULL)
+        {
+            handleData->messageListPoolStatistics.misses++;
+        }
+    }
     return result;
 }
 
-static void destroy_blob_upload_module(IOTHUB_CLIENT_LL_HANDLE_DATA* handle_data)
+static void message_list_pool_release(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
 {
-    (void)handle_data;
-#ifndef DONT_USE_UPLOADTOBLOB
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_046: [ If creating the TICK_COUNTER_HANDLE fails then IoTHubClient_LL_Create shall fail and return NULL. ]*/
-    IoTHubClient_LL_UploadToBlob_Destroy(handle_data->uploadToBlobHandle);
-#endif
+    if (handleData->messageListPoolStatistics.cached < handleData->messageListPoolMaxCount)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_009: [ A released IOTHUB_MESSAGE_LIST entry shall be kept in the pool while the pool holds less than the maximum number of entries, and freed otherwise. ]*/
+        messageList->entry.Flink = (PDLIST_ENTRY)handleData->messageListPool;
+        handleData->messageListPool = messageList;
+        handleData->messageListPoolStatistics.cached++;
+        if (handleData->messageListPoolStatistics.cached > handleData->messageListPoolStatistics.highWaterMark)
+        {
+            handleData->messageListPoolStatistics.highWaterMark = handleData->messageListPoolStatistics.cached;
+        }
+    }
+    else
+    {
+        free(messageList);
+    }
 }
 
-/*Codes_SRS_IOTHUBCLIENT_LL_10_032: ["product_info" - takes a char string as an argument to specify the product information(e.g. `"ProductName/ProductVersion"`). ]*/
-/*Codes_SRS_IOTHUBCLIENT_LL_10_034: ["product_info" - shall store the given string concatenated with the sdk information and the platform information in the form(ProductInfo DeviceSDKName / DeviceSDKVersion(OSName OSVersion; Architecture). ]*/
-static STRING_HANDLE make_product_info(const char* product)
+static void message_list_pool_trim(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t maxCount)
 {
-    STRING_HANDLE result;
-    STRING_HANDLE pfi = platform_get_platform_info();
-    if (pfi == NULL)
+    while (handleData->messageListPoolStatistics.cached > maxCount)
     {
-        result = NULL;
+        IOTHUB_MESSAGE_LIST* messageList = handleData->messageListPool;
+        handleData->messageListPool = (IOTHUB_MESSAGE_LIST*)messageList->entry.Flink;
+        handleData->messageListPoolStatistics.cached--;
+        free(messageList);
     }
-    else
+}
+
+static void check_send_queue_watermarks(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    const IOTHUB_CLIENT_SEND_QUEUE_LIMITS* limits = &handleData->sendQueueLimits;
+    if ((limits->watermarkCallback != NULL) && (limits->highWatermark != 0))
     {
-        if (product == NULL)
+        if (!handleData->sendQueueAboveHighWatermark && (handleData->sendQueueMessageCount >= limits->highWatermark))
         {
-            result = STRING_construct_sprintf("%s %s", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION, STRING_c_str(pfi));
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_016: [ When the number of counted messages reaches highWatermark, watermarkCallback shall be called with IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK. ]*/
+            handleData->sendQueueAboveHighWatermark = true;
+            limits->watermarkCallback(IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK, handleData->sendQueueMessageCount, handleData->sendQueueByteCount, limits->watermarkUserContextCallback);
         }
-        else
+        else if (handleData->sendQueueAboveHighWatermark && (handleData->sendQueueMessageCount <= limits->lowWatermark))
         {
-            result = STRING_construct_sprintf("%s %s %s", product, CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION, STRING_c_str(pfi));
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_017: [ When the number of counted messages drops to lowWatermark after the high watermark was reached, watermarkCallback shall be called with IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK. ]*/
+            handleData->sendQueueAboveHighWatermark = false;
+            limits->watermarkCallback(IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK, handleData->sendQueueMessageCount, handleData->sendQueueByteCount, limits->watermarkUserContextCallback);
         }
-        STRING_delete(pfi);
     }
-    return result;
 }
 
-static IOTHUB_CLIENT_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_CLIENT_CONFIG* client_config, const IOTHUB_CLIENT_DEVICE_CONFIG* device_config)
+static void record_message_latency(IOTHUB_CLIENT_STATISTICS* statistics, tickcounter_ms_t latency)
 {
-    IOTHUB_CLIENT_LL_HANDLE_DATA* result;
-    STRING_HANDLE product_info = make_product_info(NULL);
-    if (product_info == NULL)
+    size_t bucket = 0;
+    while ((bucket < IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKET_COUNT - 1) && (latency >= ((tickcounter_ms_t)1 << bucket)))
     {
-        LogError("failed to initialize product info");
-        result = NULL;
+        bucket++;
     }
-    else
+    statistics->latencyHistogram[bucket]++;
+}
+
+static void record_message_complete(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    IOTHUB_CLIENT_STATISTICS* statistics = &handleData->statistics;
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
     {
-        result = (IOTHUB_CLIENT_LL_HANDLE_DATA*)malloc(sizeof(IOTHUB_CLIENT_LL_HANDLE_DATA));
-        if (result == NULL)
+        tickcounter_ms_t nowTick;
+        statistics->messagesConfirmed++;
+        statistics->bytesConfirmed += messageList->byteCount;
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_028: [ When a counted message is confirmed with IOTHUB_CLIENT_CONFIRMATION_OK, the time elapsed since it was enqueued shall be added to the latency histogram. ]*/
+        if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
         {
-            LogError("failure allocating IOTHUB_CLIENT_LL_HANDLE_DATA");
-            STRING_delete(product_info);
+            LogError("unable to get the current ms, the latency of the message is not recorded");
         }
         else
         {
-            IOTHUB_CLIENT_CONFIG actual_config;
-            const IOTHUB_CLIENT_CONFIG* config = NULL;
-            char* IoTHubName = NULL;
-            STRING_HANDLE transport_hostname = NULL;
+            record_message_latency(statistics, nowTick - messageList->enqueuedAt);
+        }
+    }
+    else if (result == IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT)
+    {
+        statistics->messagesTimedOut++;
+    }
+    else
+    {
+        statistics->messagesFailed++;
+    }
+}
 
-            memset(result, 0, sizeof(IOTHUB_CLIENT_LL_HANDLE_DATA));
+/*installed as the callback of the messages sent while the send queue limits or the statistics are in use or with IoTHubClient_LL_SendEventAsync_Ex, context is the IOTHUB_MESSAGE_LIST itself*/
+static void on_send_queue_message_complete(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* context)
+{
+    IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)context;
+    IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)messageList->owner;
 
-            const char* device_key;
-            const char* device_id;
-            const char* sas_token;
+    if (messageList->countedInSendQueue)
+    {
+        handleData->sendQueueMessageCount--;
+        handleData->sendQueueByteCount -= messageList->byteCount;
+    }
 
-            if (device_config == NULL)
-            {
-                device_key = client_config->deviceKey;
-                device_id = client_config->deviceId;
-                sas_token = client_config->deviceSasToken;
-            }
-            else
+    if (messageList->countedInStatistics)
+    {
+        record_message_complete(handleData, messageList, result);
+    }
+
+    if (messageList->userCallbackEx != NULL)
+    {
+        messageList->userCallbackEx(result, &messageList->timestamps, messageList->userContext);
+    }
+    else if (messageList->userCallback != NULL)
+    {
+        messageList->userCallback(result, messageList->userContext);
+    }
+
+    check_send_queue_watermarks(handleData);
+}
+
+static size_t get_message_byte_count(IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    size_t result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(messageHandle);
+    if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        const unsigned char* buffer;
+        if (IoTHubMessage_GetByteArray(messageHandle, &buffer, &result) != IOTHUB_MESSAGE_OK)
+        {
+            result = 0;
+        }
+    }
+    else if (contentType == IOTHUBMESSAGE_STRING)
+    {
+        const char* text = IoTHubMessage_GetString(messageHandle);
+        result = (text == NULL) ? 0 : strlen(text);
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static bool is_send_queue_full(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t byteCount)
+{
+    const IOTHUB_CLIENT_SEND_QUEUE_LIMITS* limits = &handleData->sendQueueLimits;
+    return ((limits->maxMessageCount != 0) && (handleData->sendQueueMessageCount >= limits->maxMessageCount)) ||
+        ((limits->maxByteCount != 0) && (handleData->sendQueueByteCount + byteCount > limits->maxByteCount));
+}
+
+/*returns 0 when a message of byteCount bytes fits in the send queue, dropping the oldest counted messages that have not been picked up by the transport if the policy says so*/
+static int make_room_in_send_queue(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t byteCount)
+{
+    int result;
+    if (!is_send_queue_full(handleData, byteCount))
+    {
+        result = 0;
+    }
+    else if (handleData->sendQueueLimits.fullPolicy != IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_014: [ If the message does not fit in the send queue and fullPolicy is not IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_QUEUE_FULL. ]*/
+        result = __FAILURE__;
+    }
+    else
+    {
+        DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
+        while ((currentItemInWaitingToSend != &(handleData->waitingToSend)) && is_send_queue_full(handleData, byteCount))
+        {
+            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
+            PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink;
+            if ((fullEntry->callback == on_send_queue_message_complete) && fullEntry->countedInSendQueue)
             {
-                device_key = device_config->deviceKey;
-                device_id = device_config->deviceId;
-                sas_token = device_config->deviceSasToken;
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_015: [ If fullPolicy is IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall complete the oldest counted messages still in waitingToSend with IOTHUB_CLIENT_CONFIRMATION_ERROR until the message fits, and fail with IOTHUB_CLIENT_QUEUE_FULL if it still does not fit. ]*/
+                DList_RemoveEntryList(currentItemInWaitingToSend);
+                fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, fullEntry->context);
+                IoTHubMessage_Destroy(fullEntry->messageHandle);
+                message_list_pool_release(handleData, fullEntry);
             }
+            currentItemInWaitingToSend = theNext;
+        }
+        result = is_send_queue_full(handleData, byteCount) ? __FAILURE__ : 0;
+    }
+    return result;
+}
 
-            /* Codes_SRS_IOTHUBCLIENT_LL_07_029: [ IoTHubClient_LL_Create shall create the Auth module with the device_key, device_id, and/or deviceSasToken values ] */
-            if ((result->authorization_module = IoTHubClient_Auth_Create(device_key, device_id, sas_token)) == NULL)
+/*calls the callback of the oldest message of the outbox, the messages restored from the file come first and have none*/
+static void complete_outbox_callback(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    if (handleData->outboxRestoredCount != 0)
+    {
+        handleData->outboxRestoredCount--;
+    }
+    else
+    {
+        PDLIST_ENTRY oldest = DList_RemoveHeadList(&(handleData->outboxCallbacks));
+        if (oldest != &(handleData->outboxCallbacks))
+        {
+            IOTHUB_OUTBOX_CALLBACK* outboxCallback = containingRecord(oldest, IOTHUB_OUTBOX_CALLBACK, entry);
+            if (outboxCallback->callback != NULL)
             {
-                LogError("Failed create authorization module");
-                free(result);
-                STRING_delete(product_info);
-                result = NULL;
+                outboxCallback->callback(result, outboxCallback->context);
             }
-            else if (client_config != NULL)
-            {
-                IOTHUBTRANSPORT_CONFIG lowerLayerConfig;
-                memset(&lowerLayerConfig, 0, sizeof(IOTHUBTRANSPORT_CONFIG));
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_006: [IoTHubClient_LL_Create shall populate a structure of type IOTHUBTRANSPORT_CONFIG with the information from config parameter and the previous DLIST and shall pass that to the underlying layer _Create function.]*/
-                lowerLayerConfig.upperConfig = client_config;
-                lowerLayerConfig.waitingToSend = &(result->waitingToSend);
-                lowerLayerConfig.auth_module_handle = result->authorization_module;
+            free(outboxCallback);
+        }
+    }
+}
 
-                setTransportProtocol(result, (TRANSPORT_PROVIDER*)client_config->protocol());
-                if ((result->transportHandle = result->IoTHubTransport_Create(&lowerLayerConfig)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_007: [If the underlaying layer _Create function fails them IoTHubClient_LL_Create shall fail and return NULL.] */
-                    LogError("underlying transport failed");
-                    destroy_blob_upload_module(result);
-                    tickcounter_destroy(result->tickCounter);
-                    IoTHubClient_Auth_Destroy(result->authorization_module);
-                    STRING_delete(product_info);
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_008: [Otherwise, IoTHubClient_LL_Create shall succeed and return a non-NULL handle.] */
-                    result->isSharedTransport = false;
-                    config = client_config;
-                }
+/*removes from the outbox the oldest messages that are done with, in order, so that a message is never removed before the ones sent earlier*/
+static void release_outbox_messages(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    while (handleData->outboxReleasedSequence != handleData->outboxReadSequence)
+    {
+        unsigned char* slot = &(handleData->outboxSlots[handleData->outboxReleasedSequence % handleData->outboxMaxInFlight]);
+        if (*slot == OUTBOX_SLOT_PENDING)
+        {
+            break;
+        }
+        else if (outbox_release_oldest(handleData->outbox) != 0)
+        {
+            LogError("unable to remove a message from the outbox, it will be sent again");
+            handleData->outboxRewindPending = true;
+            break;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_036: [ Once a message and all the messages appended to the outbox before it are confirmed, IoTHubClient_LL shall remove it from the outbox and call its confirmation callback with IOTHUB_CLIENT_CONFIRMATION_OK. ]*/
+            IOTHUB_CLIENT_CONFIRMATION_RESULT result = (*slot == OUTBOX_SLOT_DELIVERED) ? IOTHUB_CLIENT_CONFIRMATION_OK : IOTHUB_CLIENT_CONFIRMATION_ERROR;
+            *slot = OUTBOX_SLOT_PENDING;
+            handleData->outboxReleasedSequence++;
+            complete_outbox_callback(handleData, result);
+        }
+    }
+}
+
+/*installed as the callback of the messages read from the outbox, context is the IOTHUB_MESSAGE_LIST itself*/
+static void on_outbox_message_complete(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* context)
+{
+    IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)context;
+    IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)messageList->owner;
+
+    handleData->outboxInFlight--;
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        handleData->outboxSlots[messageList->outboxSequence % handleData->outboxMaxInFlight] = OUTBOX_SLOT_DELIVERED;
+        release_outbox_messages(handleData);
+    }
+    else if (result != IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_037: [ If a message read from the outbox is not confirmed with IOTHUB_CLIENT_CONFIRMATION_OK, IoTHubClient_LL_DoWork shall, once no message read from the outbox is in flight, read the outbox again from its oldest message. ]*/
+        handleData->outboxRewindPending = true;
+    }
+}
+
+/*moves the messages of the outbox to waitingToSend, keeping at most outboxMaxInFlight of them in flight*/
+/*a traced message keeps no timestamp until it reaches a stage, the first is being queued*/
+static void start_message_trace(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList, bool traced)
+{
+    messageList->traced = traced;
+    if (traced)
+    {
+        messageList->owner = handleData;
+        messageList->timestamps.enqueued = IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE;
+        messageList->timestamps.handedToTransport = IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE;
+        messageList->timestamps.written = IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE;
+        messageList->timestamps.acked = IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE;
+        IoTHubClient_LL_TraceMessage(messageList, IOTHUB_MESSAGE_TRACE_STAGE_ENQUEUED);
+    }
+}
+
+static void load_outbox_messages(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    if (handleData->outboxRewindPending && (handleData->outboxInFlight == 0))
+    {
+        outbox_rewind(handleData->outbox);
+        handleData->outboxReadSequence = handleData->outboxReleasedSequence;
+        (void)memset(handleData->outboxSlots, OUTBOX_SLOT_PENDING, handleData->outboxMaxInFlight);
+        handleData->outboxRewindPending = false;
+    }
+
+    while (!handleData->outboxRewindPending &&
+        (handleData->outboxReadSequence - handleData->outboxReleasedSequence < handleData->outboxMaxInFlight) &&
+        (outbox_get_unread_count(handleData->outbox) != 0))
+    {
+        size_t unreadCount = outbox_get_unread_count(handleData->outbox);
+        IOTHUB_MESSAGE_HANDLE messageHandle = outbox_read_next(handleData->outbox);
+        IOTHUB_MESSAGE_LIST* newEntry;
+        if (messageHandle == NULL)
+        {
+            if (outbox_get_unread_count(handleData->outbox) == unreadCount)
+            {
+                LogError("unable to read the outbox, it is tried again on the next DoWork");
+                break;
             }
             else
             {
-                result->transportHandle = device_config->transportHandle;
-                setTransportProtocol(result, (TRANSPORT_PROVIDER*)device_config->protocol());
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_038: [ A message of the outbox that cannot be read back shall be removed from the outbox in order and its confirmation callback called with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+                handleData->outboxSlots[handleData->outboxReadSequence % handleData->outboxMaxInFlight] = OUTBOX_SLOT_UNREADABLE;
+                handleData->outboxReadSequence++;
+                release_outbox_messages(handleData);
+            }
+        }
+        else if ((newEntry = message_list_pool_acquire(handleData)) == NULL)
+        {
+            LogError("unable to malloc, the outbox is read again later");
+            IoTHubMessage_Destroy(messageHandle);
+            handleData->outboxRewindPending = true;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_035: [ IoTHubClient_LL_DoWork shall, before calling the underlaying layer's _DoWork function, add the messages of the outbox to waitingToSend, in order and without a timeout, while less than maxInFlight of them are in flight. ]*/
+            newEntry->messageHandle = messageHandle;
+            newEntry->ms_timesOutAfter = 0;
+            newEntry->userCallback = NULL;
+            newEntry->userCallbackEx = NULL;
+            newEntry->userContext = NULL;
+            newEntry->owner = handleData;
+            newEntry->byteCount = 0;
+            newEntry->countedInSendQueue = false;
+            newEntry->countedInStatistics = false;
+            newEntry->enqueuedAt = 0;
+            newEntry->outboxSequence = handleData->outboxReadSequence;
+            newEntry->priorityTag = 0;
+            newEntry->callback = on_outbox_message_complete;
+            newEntry->context = newEntry;
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_066: [ While OPTION_MESSAGE_TRACE is set, the messages of the outbox added to waitingToSend shall be traced from then on. ]*/
+            start_message_trace(handleData, newEntry, (handleData->traceCallback != NULL));
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_106: [ IoTHubClient_LL_DoWork shall emit IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED with the message handle and the outbox sequence number of the messages of the outbox it adds to waitingToSend. ]*/
+            IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, newEntry->messageHandle, newEntry->outboxSequence);
+            DList_InsertTailList(&(handleData->waitingToSend), &(newEntry->entry));
+            handleData->outboxInFlight++;
+            handleData->outboxReadSequence++;
+        }
+    }
+}
 
-                transport_hostname = result->IoTHubTransport_GetHostname(result->transportHandle);
-                if (transport_hostname == NULL)
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClient_LL_CreateWithTransport shall fail and return NULL. ]*/
-                    LogError("unable to determine the transport IoTHub name");
-                    IoTHubClient_Auth_Destroy(result->authorization_module);
-                    STRING_delete(product_info);
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    const char* hostname = STRING_c_str(transport_hostname);
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_096: [ IoTHubClient_LL_CreateWithTransport shall create the data structures needed to instantiate a IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE. ]*/
-                    /*the first '.' says where the iothubname finishes*/
-                    const char* whereIsDot = strchr(hostname, '.');
+static IOTHUB_CLIENT_RESULT send_event_to_outbox(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_OUTBOX_CALLBACK* outboxCallback = (IOTHUB_OUTBOX_CALLBACK*)malloc(sizeof(IOTHUB_OUTBOX_CALLBACK));
+    if (outboxCallback == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if (outbox_append(handleData->outbox, eventMessageHandle) != 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_034: [ If the message cannot be appended to the outbox, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_QUEUE_FULL. ]*/
+        free(outboxCallback);
+        result = IOTHUB_CLIENT_QUEUE_FULL;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_033: [ While an outbox is set, IoTHubClient_LL_SendEventAsync shall append the message to the outbox instead of waitingToSend, keep the confirmation callback for when the message is removed from the outbox, and return IOTHUB_CLIENT_OK. ]*/
+        outboxCallback->callback = eventConfirmationCallback;
+        outboxCallback->context = userContextCallback;
+        DList_InsertTailList(&(handleData->outboxCallbacks), &(outboxCallback->entry));
+        if (takeOwnership)
+        {
+            /*the outbox keeps its own copy*/
+            IoTHubMessage_Destroy(eventMessageHandle);
+        }
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT set_outbox(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const IOTHUB_CLIENT_OUTBOX_CONFIG* config)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if ((handleData->outbox != NULL) || (config->fileName == NULL) || (config->maxInFlight == 0))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_031: [ If optionName is OPTION_OUTBOX and an outbox is already set, fileName is NULL or maxInFlight is 0, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("invalid outbox, an outbox is set already (%p), fileName=%p, maxInFlight=%lu", handleData->outbox, config->fileName, (unsigned long)config->maxInFlight);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if ((handleData->outboxSlots = (unsigned char*)malloc(config->maxInFlight)) == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if ((handleData->outbox = outbox_create(config->fileName, config->maxFileSize, config->syncInterval)) == NULL)
+    {
+        free(handleData->outboxSlots);
+        handleData->outboxSlots = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_032: [ Otherwise IoTHubClient_LL_SetOption shall open the outbox described by the IOTHUB_CLIENT_OUTBOX_CONFIG pointed to by value, whose messages from a previous run are sent again first, and return IOTHUB_CLIENT_OK. ]*/
+        (void)memset(handleData->outboxSlots, OUTBOX_SLOT_PENDING, config->maxInFlight);
+        DList_InitializeListHead(&(handleData->outboxCallbacks));
+        handleData->outboxMaxInFlight = config->maxInFlight;
+        handleData->outboxRestoredCount = outbox_get_count(handleData->outbox);
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+#ifndef DONT_USE_DEVICE_TWIN
+static IOTHUB_CLIENT_RESULT set_twin_cache(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const IOTHUB_CLIENT_TWIN_CACHE_CONFIG* config)
+{
+    IOTHUB_CLIENT_RESULT result;
+    TWIN_CACHE_HANDLE twinCache;
+    if (!config->enabled)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_144: [ If optionName is OPTION_TWIN_CACHE and enabled is false, IoTHubClient_LL_SetOption shall destroy the twin cache, if any, and return IOTHUB_CLIENT_OK. ]*/
+        twinCache = NULL;
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if ((twinCache = twin_cache_create(config->fileName)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_145: [ Otherwise IoTHubClient_LL_SetOption shall replace the twin cache by one created with twin_cache_create and fileName and return IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR if it fails. ]*/
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    if (result == IOTHUB_CLIENT_OK)
+    {
+        if (handleData->twinCache != NULL)
+        {
+            twin_cache_destroy(handleData->twinCache);
+        }
+        handleData->twinCache = twinCache;
+    }
+    return result;
+}
+#endif
+
+#ifndef DONT_USE_UPLOADTOBLOB
+static char* copy_config_string(char** position, const char* source)
+{
+    char* result;
+    if (source == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        size_t length = strlen(source) + 1;
+        result = *position;
+        (void)memcpy(result, source, length);
+        *position += length;
+    }
+    return result;
+}
+#endif
+
+/*the upload to blob module is only created by the first upload (or upload option), a client that never uploads
+only keeps the few strings it would be created from*/
+static int create_blob_upload_module(IOTHUB_CLIENT_LL_HANDLE_DATA* handle_data, const IOTHUB_CLIENT_CONFIG* config)
+{
+    int result;
+    (void)handle_data;
+    (void)config;
+#ifndef DONT_USE_UPLOADTOBLOB
+    size_t stringsSize =
+        ((config->deviceId == NULL) ? 0 : strlen(config->deviceId) + 1) +
+        ((config->deviceKey == NULL) ? 0 : strlen(config->deviceKey) + 1) +
+        ((config->deviceSasToken == NULL) ? 0 : strlen(config->deviceSasToken) + 1) +
+        ((config->iotHubName == NULL) ? 0 : strlen(config->iotHubName) + 1) +
+        ((config->iotHubSuffix == NULL) ? 0 : strlen(config->iotHubSuffix) + 1);
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_102: [ IoTHubClient_LL_Create and IoTHubClient_LL_CreateWithTransport shall not create the upload to blob module, they shall keep a copy of the configuration it is created from. ]*/
+    handle_data->uploadToBlobHandle = NULL;
+    if ((handle_data->uploadToBlobConfig = (IOTHUB_CLIENT_CONFIG*)malloc(sizeof(IOTHUB_CLIENT_CONFIG) + stringsSize)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_095: [ If copying the configuration of the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClient_LL_Create shall fail and return NULL. ]*/
+        LogError("unable to allocate the upload to blob configuration");
+        result = __FAILURE__;
+    }
+    else
+    {
+        char* position = (char*)(handle_data->uploadToBlobConfig + 1);
+        handle_data->uploadToBlobConfig->protocol = NULL; /*irrelevant to IoTHubClient_LL_UploadToBlob*/
+        handle_data->uploadToBlobConfig->protocolGatewayHostName = NULL; /*irrelevant to IoTHubClient_LL_UploadToBlob*/
+        handle_data->uploadToBlobConfig->deviceId = copy_config_string(&position, config->deviceId);
+        handle_data->uploadToBlobConfig->deviceKey = copy_config_string(&position, config->deviceKey);
+        handle_data->uploadToBlobConfig->deviceSasToken = copy_config_string(&position, config->deviceSasToken);
+        handle_data->uploadToBlobConfig->iotHubName = copy_config_string(&position, config->iotHubName);
+        handle_data->uploadToBlobConfig->iotHubSuffix = copy_config_string(&position, config->iotHubSuffix);
+        result = 0;
+    }
+#else
+    result = 0;
+#endif
+    return result;
+}
+
+#ifndef DONT_USE_UPLOADTOBLOB
+static IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE get_blob_upload_module(IOTHUB_CLIENT_LL_HANDLE_DATA* handle_data)
+{
+    if (handle_data->uploadToBlobHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_103: [ The upload to blob module shall be created by calling IoTHubClient_LL_UploadToBlob_Create the first time an upload function or an option given to it needs it, after which the copy of the configuration shall be freed. ]*/
+        if ((handle_data->uploadToBlobHandle = IoTHubClient_LL_UploadToBlob_Create(handle_data->uploadToBlobConfig)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_104: [ If IoTHubClient_LL_UploadToBlob_Create fails, the call that needed it shall fail and return IOTHUB_CLIENT_ERROR, and the module shall be created again by the next one. ]*/
+            LogError("unable to IoTHubClient_LL_UploadToBlob_Create");
+        }
+        else
+        {
+            free(handle_data->uploadToBlobConfig);
+            handle_data->uploadToBlobConfig = NULL;
+        }
+    }
+    return handle_data->uploadToBlobHandle;
+}
+#endif
+
+static void destroy_blob_upload_module(IOTHUB_CLIENT_LL_HANDLE_DATA* handle_data)
+{
+    (void)handle_data;
+#ifndef DONT_USE_UPLOADTOBLOB
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_046: [ If creating the TICK_COUNTER_HANDLE fails then IoTHubClient_LL_Create shall fail and return NULL. ]*/
+    if (handle_data->uploadToBlobHandle != NULL)
+    {
+        IoTHubClient_LL_UploadToBlob_Destroy(handle_data->uploadToBlobHandle);
+    }
+    free(handle_data->uploadToBlobConfig);
+#endif
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_10_032: ["product_info" - takes a char string as an argument to specify the product information(e.g. `"ProductName/ProductVersion"`). ]*/
+/*Codes_SRS_IOTHUBCLIENT_LL_10_034: ["product_info" - shall store the given string concatenated with the sdk information and the platform information in the form(ProductInfo DeviceSDKName / DeviceSDKVersion(OSName OSVersion; Architecture). ]*/
+static STRING_HANDLE make_product_info(const char* product)
+{
+    STRING_HANDLE result;
+    STRING_HANDLE pfi = platform_get_platform_info();
+    if (pfi == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        if (product == NULL)
+        {
+            result = STRING_construct_sprintf("%s %s", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION, STRING_c_str(pfi));
+        }
+        else
+        {
+            result = STRING_construct_sprintf("%s %s %s", product, CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION, STRING_c_str(pfi));
+        }
+        STRING_delete(pfi);
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_CLIENT_CONFIG* client_config, const IOTHUB_CLIENT_DEVICE_CONFIG* device_config)
+{
+    IOTHUB_CLIENT_LL_HANDLE_DATA* result;
+    STRING_HANDLE product_info = make_product_info(NULL);
+    if (product_info == NULL)
+    {
+        LogError("failed to initialize product info");
+        result = NULL;
+    }
+    else
+    {
+        result = (IOTHUB_CLIENT_LL_HANDLE_DATA*)malloc(sizeof(IOTHUB_CLIENT_LL_HANDLE_DATA));
+        if (result == NULL)
+        {
+            LogError("failure allocating IOTHUB_CLIENT_LL_HANDLE_DATA");
+            STRING_delete(product_info);
+        }
+        else
+        {
+            IOTHUB_CLIENT_CONFIG actual_config;
+            const IOTHUB_CLIENT_CONFIG* config = NULL;
+            char* IoTHubName = NULL;
+            STRING_HANDLE transport_hostname = NULL;
+
+            memset(result, 0, sizeof(IOTHUB_CLIENT_LL_HANDLE_DATA));
+
+            const char* device_key;
+            const char* device_id;
+            const char* sas_token;
+
+            if (device_config == NULL)
+            {
+                device_key = client_config->deviceKey;
+                device_id = client_config->deviceId;
+                sas_token = client_config->deviceSasToken;
+            }
+            else
+            {
+                device_key = device_config->deviceKey;
+                device_id = device_config->deviceId;
+                sas_token = device_config->deviceSasToken;
+            }
+
+            /* Codes_SRS_IOTHUBCLIENT_LL_07_029: [ IoTHubClient_LL_Create shall create the Auth module with the device_key, device_id, and/or deviceSasToken values ] */
+            if ((result->authorization_module = IoTHubClient_Auth_Create(device_key, device_id, sas_token)) == NULL)
+            {
+                LogError("Failed create authorization module");
+                free(result);
+                STRING_delete(product_info);
+                result = NULL;
+            }
+            else if (client_config != NULL)
+            {
+                IOTHUBTRANSPORT_CONFIG lowerLayerConfig;
+                memset(&lowerLayerConfig, 0, sizeof(IOTHUBTRANSPORT_CONFIG));
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_006: [IoTHubClient_LL_Create shall populate a structure of type IOTHUBTRANSPORT_CONFIG with the information from config parameter and the previous DLIST and shall pass that to the underlying layer _Create function.]*/
+                lowerLayerConfig.upperConfig = client_config;
+                lowerLayerConfig.waitingToSend = &(result->waitingToSend);
+                lowerLayerConfig.auth_module_handle = result->authorization_module;
+
+                setTransportProtocol(result, (TRANSPORT_PROVIDER*)client_config->protocol());
+                if ((result->transportHandle = result->IoTHubTransport_Create(&lowerLayerConfig)) == NULL)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_007: [If the underlaying layer _Create function fails them IoTHubClient_LL_Create shall fail and return NULL.] */
+                    LogError("underlying transport failed");
+                    destroy_blob_upload_module(result);
+                    tickcounter_destroy(result->tickCounter);
+                    IoTHubClient_Auth_Destroy(result->authorization_module);
+                    STRING_delete(product_info);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_008: [Otherwise, IoTHubClient_LL_Create shall succeed and return a non-NULL handle.] */
+                    result->isSharedTransport = false;
+                    config = client_config;
+                }
+            }
+            else
+            {
+                result->transportHandle = device_config->transportHandle;
+                setTransportProtocol(result, (TRANSPORT_PROVIDER*)device_config->protocol());
+
+                transport_hostname = result->IoTHubTransport_GetHostname(result->transportHandle);
+                if (transport_hostname == NULL)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClient_LL_CreateWithTransport shall fail and return NULL. ]*/
+                    LogError("unable to determine the transport IoTHub name");
+                    IoTHubClient_Auth_Destroy(result->authorization_module);
+                    STRING_delete(product_info);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    const char* hostname = STRING_c_str(transport_hostname);
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_096: [ IoTHubClient_LL_CreateWithTransport shall create the data structures needed to instantiate a IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE. ]*/
+                    /*the first '.' says where the iothubname finishes*/
+                    const char* whereIsDot = strchr(hostname, '.');
                     if (whereIsDot == NULL)
                     {
                         /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClient_LL_CreateWithTransport shall fail and return NULL. ]*/
@@ -345,11 +1000,13 @@ static IOTHUB_CLIENT_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_CLIEN
                     {
                         /*Codes_SRS_IOTHUBCLIENT_LL_02_004: [Otherwise IoTHubClient_LL_Create shall initialize a new DLIST (further called "waitingToSend") containing records with fields of the following types: IOTHUB_MESSAGE_HANDLE, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*.]*/
                         DList_InitializeListHead(&(result->waitingToSend));
+#ifndef DONT_USE_DEVICE_TWIN
                         DList_InitializeListHead(&(result->iot_msg_queue));
                         DList_InitializeListHead(&(result->iot_ack_queue));
+                        result->data_msg_id = 1;
+#endif
                         result->messageCallback.type = CALLBACK_TYPE_NONE;
                         result->lastMessageReceiveTime = INDEFINITE_TIME;
-                        result->data_msg_id = 1;
                         result->product_info = product_info;
 
                         IOTHUB_DEVICE_CONFIG deviceConfig;
@@ -374,7 +1031,59 @@ static IOTHUB_CLIENT_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_CLIEN
                         {
                             /*Codes_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
                             result->currentMessageTimeout = 0;
+                            result->nextMessageTimeout = 0;
+                            result->lastMessageTimeout = 0;
+                            result->waitingToSendOrderedByTimeout = true;
+                            result->messageListPool = NULL;
+                            result->messageListPoolMaxCount = 0;
+                            memset(&result->messageListPoolStatistics, 0, sizeof(IOTHUB_CLIENT_POOL_STATISTICS));
+                            memset(&result->sendQueueLimits, 0, sizeof(IOTHUB_CLIENT_SEND_QUEUE_LIMITS));
+                            result->sendQueueLimitsEnabled = false;
+                            result->sendQueueMessageCount = 0;
+                            result->sendQueueByteCount = 0;
+                            result->sendQueueAboveHighWatermark = false;
+                            result->statisticsEnabled = false;
+                            memset(&result->statistics, 0, sizeof(IOTHUB_CLIENT_STATISTICS));
+                            result->statisticsCompletedByTransport = 0;
+                            result->statisticsConnected = false;
+                            result->statisticsDisconnectedAfterConnected = false;
+                            result->statisticsDisconnectedSince = 0;
+                            result->outbox = NULL;
+                            result->outboxMaxInFlight = 0;
+                            result->outboxInFlight = 0;
+                            result->outboxRewindPending = false;
+                            result->outboxReleasedSequence = 0;
+                            result->outboxReadSequence = 0;
+                            result->outboxSlots = NULL;
+                            result->outboxRestoredCount = 0;
+                            memset(&result->rateLimit, 0, sizeof(IOTHUB_CLIENT_RATE_LIMIT));
+                            result->rateLimitScale = RATE_LIMIT_FULL_SCALE;
+                            result->rateLimitMessageTokens = 0;
+                            result->rateLimitByteTokens = 0;
+                            result->rateLimitRefilledAt = 0;
+                            result->rateLimitSlowedAt = 0;
+                            result->priorityEnabled = false;
+                            memset(result->priorityTagStep, 0, sizeof(result->priorityTagStep));
+                            memset(result->priorityLastTag, 0, sizeof(result->priorityLastTag));
+                            result->priorityMaxTag = 0;
+                            result->priorityVirtualTime = 0;
+#ifndef DONT_USE_DEVICE_TWIN
+                            result->coalesceReportedState = false;
+                            result->twinMaxInFlight = 0;
+                            result->twinAckTimeoutMs = 0;
+                            result->twinInFlight = 0;
+                            result->twinCache = NULL;
                             result->current_device_twin_timeout = 0;
+#endif
+                            result->compressor = NULL;
+                            result->compressionMinimumSize = 0;
+                            result->pipeline = NULL;
+                            result->duplicateFilter = NULL;
+                            result->messageChunkSize = 0;
+                            result->isReceivePaused = false;
+                            result->traceCallback = NULL;
+                            result->traceContext = NULL;
+                            result->keepAliveInterval = 0;
                             /*Codes_SRS_IOTHUBCLIENT_LL_25_124: [ `IoTHubClient_LL_Create` shall set the default retry policy as Exponential backoff with jitter and if succeed and return a `non-NULL` handle. ]*/
                             if (IoTHubClient_LL_SetRetryPolicy(result, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 0) != IOTHUB_CLIENT_OK)
                             {
@@ -405,6 +1114,7 @@ static IOTHUB_CLIENT_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_CLIEN
     return result;
 }
 
+#ifndef DONT_USE_DEVICE_TWIN
 static uint32_t get_next_item_id(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
 {    
     if (handleData->data_msg_id+1 >= UINT32_MAX)
@@ -443,6 +1153,8 @@ static IOTHUB_DEVICE_TWIN* dev_twin_data_create(IOTHUB_CLIENT_LL_HANDLE_DATA* ha
             result->ms_timesOutAfter = 0;
             result->context = userContextCallback;
             result->reported_state_callback = reportedStateCallback;
+            result->coalesced_callbacks = NULL;
+            result->last_coalesced_callback = NULL;
         }
     }
     else
@@ -451,6 +1163,7 @@ static IOTHUB_DEVICE_TWIN* dev_twin_data_create(IOTHUB_CLIENT_LL_HANDLE_DATA* ha
     }
     return result;
 }
+#endif
 
 IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateFromConnectionString(const char* connectionString, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
 {
@@ -787,6 +1500,8 @@ void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
             /*Codes_SRS_IOTHUBCLIENT_LL_02_010: [If iotHubClientHandle was not created by IoTHubClient_LL_CreateWithTransport, IoTHubClient_LL_Destroy  shall call the underlaying layer's _Destroy function.] */
             handleData->IoTHubTransport_Destroy(handleData->transportHandle);
         }
+        /*the messages completed below do not report watermarks*/
+        handleData->sendQueueLimits.watermarkCallback = NULL;
         /*if any, remove the items currently not send*/
         while ((unsend = DList_RemoveHeadList(&(handleData->waitingToSend))) != &(handleData->waitingToSend))
         {
@@ -799,25 +1514,63 @@ void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
             IoTHubMessage_Destroy(temp->messageHandle);
             free(temp);
         }
+        message_list_pool_trim(handleData, 0);
 
-        /* Codes_SRS_IOTHUBCLIENT_LL_07_007: [ IoTHubClient_LL_Destroy shall iterate the device twin queues and destroy any remaining items. ] */
-        while ((unsend = DList_RemoveHeadList(&(handleData->iot_msg_queue))) != &(handleData->iot_msg_queue))
+        if (handleData->outbox != NULL)
         {
-            IOTHUB_DEVICE_TWIN* temp = containingRecord(unsend, IOTHUB_DEVICE_TWIN, entry);
-            device_twin_data_destroy(temp);
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_039: [ IoTHubClient_LL_Destroy shall complete the callbacks of the messages still in the outbox with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY and close the outbox, which keeps the messages for the next run. ]*/
+            while ((unsend = DList_RemoveHeadList(&(handleData->outboxCallbacks))) != &(handleData->outboxCallbacks))
+            {
+                IOTHUB_OUTBOX_CALLBACK* temp = containingRecord(unsend, IOTHUB_OUTBOX_CALLBACK, entry);
+                if (temp->callback != NULL)
+                {
+                    temp->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, temp->context);
+                }
+                free(temp);
+            }
+            outbox_destroy(handleData->outbox);
+            free(handleData->outboxSlots);
         }
-        while ((unsend = DList_RemoveHeadList(&(handleData->iot_ack_queue))) != &(handleData->iot_ack_queue))
+
+        if (handleData->compressor != NULL)
         {
-            IOTHUB_DEVICE_TWIN* temp = containingRecord(unsend, IOTHUB_DEVICE_TWIN, entry);
-            device_twin_data_destroy(temp);
+            compressor_destroy(handleData->compressor);
         }
 
-        /*Codes_SRS_IOTHUBCLIENT_LL_17_011: [IoTHubClient_LL_Destroy  shall free the resources allocated by IoTHubClient (if any).] */
-        IoTHubClient_Auth_Destroy(handleData->authorization_module);
-        tickcounter_destroy(handleData->tickCounter);
-#ifndef DONT_USE_UPLOADTOBLOB
-        IoTHubClient_LL_UploadToBlob_Destroy(handleData->uploadToBlobHandle);
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_152: [ IoTHubClient_LL_Destroy shall destroy the pipeline set by OPTION_MESSAGE_PIPELINE. ]*/
+        if (handleData->pipeline != NULL)
+        {
+            message_pipeline_destroy(handleData->pipeline);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_157: [ IoTHubClient_LL_Destroy shall destroy the filter set by OPTION_C2D_DUPLICATE_FILTER. ]*/
+        if (handleData->duplicateFilter != NULL)
+        {
+            duplicate_filter_destroy(handleData->duplicateFilter);
+        }
+
+#ifndef DONT_USE_DEVICE_TWIN
+        /* Codes_SRS_IOTHUBCLIENT_LL_07_007: [ IoTHubClient_LL_Destroy shall iterate the device twin queues and destroy any remaining items. ] */
+        while ((unsend = DList_RemoveHeadList(&(handleData->iot_msg_queue))) != &(handleData->iot_msg_queue))
+        {
+            IOTHUB_DEVICE_TWIN* temp = containingRecord(unsend, IOTHUB_DEVICE_TWIN, entry);
+            device_twin_data_destroy(temp);
+        }
+        while ((unsend = DList_RemoveHeadList(&(handleData->iot_ack_queue))) != &(handleData->iot_ack_queue))
+        {
+            IOTHUB_DEVICE_TWIN* temp = containingRecord(unsend, IOTHUB_DEVICE_TWIN, entry);
+            device_twin_data_destroy(temp);
+        }
+        if (handleData->twinCache != NULL)
+        {
+            twin_cache_destroy(handleData->twinCache);
+        }
 #endif
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_17_011: [IoTHubClient_LL_Destroy  shall free the resources allocated by IoTHubClient (if any).] */
+        IoTHubClient_Auth_Destroy(handleData->authorization_module);
+        tickcounter_destroy(handleData->tickCounter);
+        destroy_blob_upload_module(handleData);
         STRING_delete(handleData->product_info);
         free(handleData);
     }
@@ -851,54 +1604,230 @@ static int attach_ms_timesOutAfter(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOT
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+/*keeps track of the earliest timeout in waitingToSend and of whether waitingToSend is still ordered by timeout, so that DoTimeouts does not need to look at every message*/
+static void track_ms_timesOutAfter(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, tickcounter_ms_t ms_timesOutAfter)
+{
+    if (ms_timesOutAfter != 0)
+    {
+        if ((handleData->nextMessageTimeout == 0) || (ms_timesOutAfter < handleData->nextMessageTimeout))
+        {
+            handleData->nextMessageTimeout = ms_timesOutAfter;
+        }
+
+        /*messages are only ever removed from waitingToSend by transports, which keeps the order. The order is lost when a message times out before one queued earlier (the "messageTimeout" option was lowered)*/
+        if (ms_timesOutAfter < handleData->lastMessageTimeout)
+        {
+            handleData->waitingToSendOrderedByTimeout = false;
+        }
+        else
+        {
+            handleData->lastMessageTimeout = ms_timesOutAfter;
+        }
+    }
+}
+
+/*self-clocked weighted fair queueing: the transports send waitingToSend from its head, so ordering it by tag sends each lane in proportion to its weight*/
+static void insert_by_priority(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry, IOTHUB_MESSAGE_PRIORITY priority)
+{
+    size_t lane = ((size_t)priority < PRIORITY_LANE_COUNT) ? (size_t)priority : (size_t)IOTHUB_MESSAGE_PRIORITY_NORMAL;
+    PDLIST_ENTRY previous = handleData->waitingToSend.Blink;
+    uint64_t start;
+
+    if (previous == &(handleData->waitingToSend))
+    {
+        /*all the messages were picked up by the transport, no lane is behind*/
+        handleData->priorityVirtualTime = handleData->priorityMaxTag;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_LIST* head = containingRecord(handleData->waitingToSend.Flink, IOTHUB_MESSAGE_LIST, entry);
+        if (head->priorityTag > handleData->priorityVirtualTime)
+        {
+            handleData->priorityVirtualTime = head->priorityTag;
+        }
+    }
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_044: [ While the priority weights are set, IoTHubClient_LL_SendEventAsync shall tag the message one step, inversely proportional to the weight of its IOTHUB_MESSAGE_PRIORITY, after the later of the last tag of that priority and the tag of the message at the head of waitingToSend. ]*/
+    start = (handleData->priorityLastTag[lane] > handleData->priorityVirtualTime) ? handleData->priorityLastTag[lane] : handleData->priorityVirtualTime;
+    newEntry->priorityTag = start + handleData->priorityTagStep[lane];
+    handleData->priorityLastTag[lane] = newEntry->priorityTag;
+    if (newEntry->priorityTag > handleData->priorityMaxTag)
+    {
+        handleData->priorityMaxTag = newEntry->priorityTag;
+    }
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_045: [ IoTHubClient_LL_SendEventAsync shall insert the message in waitingToSend after the last message whose tag is not larger than its own. ]*/
+    while ((previous != &(handleData->waitingToSend)) && (containingRecord(previous, IOTHUB_MESSAGE_LIST, entry)->priorityTag > newEntry->priorityTag))
+    {
+        previous = previous->Blink;
+    }
+    DList_InsertTailList(previous->Flink, &(newEntry->entry));
+
+    if ((newEntry->entry.Flink != &(handleData->waitingToSend)) && (newEntry->ms_timesOutAfter != 0))
+    {
+        /*it went ahead of messages that time out earlier*/
+        handleData->waitingToSendOrderedByTimeout = false;
+    }
+}
+
+static IOTHUB_CLIENT_RESULT set_priority_weights(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const IOTHUB_CLIENT_PRIORITY_WEIGHTS* weights)
 {
     IOTHUB_CLIENT_RESULT result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
-    if (
-        (iotHubClientHandle == NULL) ||
-        (eventMessageHandle == NULL) ||
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_012: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL.] */
-        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
-        )
+    size_t laneWeights[PRIORITY_LANE_COUNT];
+    size_t lane;
+    bool allZero = true;
+    bool valid = true;
+
+    laneWeights[IOTHUB_MESSAGE_PRIORITY_LOW] = weights->lowWeight;
+    laneWeights[IOTHUB_MESSAGE_PRIORITY_NORMAL] = weights->normalWeight;
+    laneWeights[IOTHUB_MESSAGE_PRIORITY_HIGH] = weights->highWeight;
+    for (lane = 0; lane < PRIORITY_LANE_COUNT; lane++)
+    {
+        allZero = allZero && (laneWeights[lane] == 0);
+        valid = valid && (laneWeights[lane] != 0) && (laneWeights[lane] <= IOTHUB_CLIENT_PRIORITY_MAX_WEIGHT);
+    }
+
+    if (allZero)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_042: [ If all the weights are 0, IoTHubClient_LL_SetOption shall add the messages sent afterwards at the end of waitingToSend again and return IOTHUB_CLIENT_OK. ]*/
+        handleData->priorityEnabled = false;
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if (!valid)
     {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_041: [ If optionName is OPTION_PRIORITY_WEIGHTS and not all the weights are 0 but one of them is 0 or larger than IOTHUB_CLIENT_PRIORITY_MAX_WEIGHT, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("invalid priority weights low=%lu, normal=%lu, high=%lu", (unsigned long)weights->lowWeight, (unsigned long)weights->normalWeight, (unsigned long)weights->highWeight);
         result = IOTHUB_CLIENT_INVALID_ARG;
-        LOG_ERROR_RESULT;
     }
     else
     {
-        IOTHUB_MESSAGE_LIST *newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
-        if (newEntry == NULL)
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_043: [ Otherwise IoTHubClient_LL_SetOption shall store the weights pointed to by value, which apply to the messages sent afterwards, and return IOTHUB_CLIENT_OK. ]*/
+        for (lane = 0; lane < PRIORITY_LANE_COUNT; lane++)
+        {
+            handleData->priorityTagStep[lane] = PRIORITY_TAG_SCALE / laneWeights[lane];
+        }
+        handleData->priorityEnabled = true;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT enqueue_event(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX eventConfirmationCallbackEx, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if ((handleData->outbox != NULL) && (eventConfirmationCallbackEx != NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_063: [ If an outbox is set, IoTHubClient_LL_SendEventAsync_Ex shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("the timestamps of a message are not kept in the outbox");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if (handleData->outbox != NULL)
+    {
+        result = send_event_to_outbox(handleData, eventMessageHandle, eventConfirmationCallback, userContextCallback, takeOwnership);
+    }
+    else
+    {
+        IOTHUB_MESSAGE_LIST *newEntry;
+        size_t byteCount = 0;
+        tickcounter_ms_t enqueuedAt = 0;
+
+        if ((handleData->sendQueueLimitsEnabled && (handleData->sendQueueLimits.maxByteCount != 0)) || handleData->statisticsEnabled)
+        {
+            byteCount = get_message_byte_count(eventMessageHandle);
+        }
+
+        if (handleData->sendQueueLimitsEnabled && (make_room_in_send_queue(handleData, byteCount) != 0))
+        {
+            result = IOTHUB_CLIENT_QUEUE_FULL;
+            LOG_ERROR_RESULT;
+        }
+        else if (handleData->statisticsEnabled && (tickcounter_get_current_ms(handleData->tickCounter, &enqueuedAt) != 0))
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LOG_ERROR_RESULT;
+        }
+        else if ((newEntry = message_list_pool_acquire(handleData)) == NULL)
         {
             result = IOTHUB_CLIENT_ERROR;
             LOG_ERROR_RESULT;
         }
         else
         {
-            IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
-
             if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
             {
                 result = IOTHUB_CLIENT_ERROR;
                 LOG_ERROR_RESULT;
-                free(newEntry);
+                message_list_pool_release(handleData, newEntry);
             }
             else
             {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
-                if ((newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
+                if (takeOwnership)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_005: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall add eventMessageHandle itself to waitingToSend, without cloning it. ]*/
+                    newEntry->messageHandle = eventMessageHandle;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
+                    newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle);
+                }
+
+                if (newEntry->messageHandle == NULL)
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
                     result = IOTHUB_CLIENT_ERROR;
-                    free(newEntry);
+                    message_list_pool_release(handleData, newEntry);
                     LOG_ERROR_RESULT;
                 }
                 else
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
-                    newEntry->callback = eventConfirmationCallback;
-                    newEntry->context = userContextCallback;
-                    DList_InsertTailList(&(iotHubClientHandle->waitingToSend), &(newEntry->entry));
+                    if (handleData->sendQueueLimitsEnabled || handleData->statisticsEnabled || (eventConfirmationCallbackEx != NULL))
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_LL_41_018: [ While the send queue limits are in use, IoTHubClient_LL_SendEventAsync shall count the message and its payload size until its confirmation callback is called. ]*/
+                        /*Codes_SRS_IOTHUBCLIENT_LL_41_027: [ While the statistics are enabled, IoTHubClient_LL_SendEventAsync shall count the message, its payload size and the time it was enqueued until its confirmation callback is called. ]*/
+                        newEntry->userCallback = eventConfirmationCallback;
+                        newEntry->userCallbackEx = eventConfirmationCallbackEx;
+                        newEntry->userContext = userContextCallback;
+                        newEntry->owner = handleData;
+                        newEntry->byteCount = byteCount;
+                        newEntry->countedInSendQueue = handleData->sendQueueLimitsEnabled;
+                        newEntry->countedInStatistics = handleData->statisticsEnabled;
+                        newEntry->enqueuedAt = enqueuedAt;
+                        newEntry->callback = on_send_queue_message_complete;
+                        newEntry->context = newEntry;
+                    }
+                    else
+                    {
+                        newEntry->callback = eventConfirmationCallback;
+                        newEntry->context = userContextCallback;
+                    }
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_062: [ IoTHubClient_LL_SendEventAsync_Ex shall behave as IoTHubClient_LL_SendEventAsync, tracing the message and calling eventConfirmationCallback with its IOTHUB_CLIENT_MESSAGE_TIMESTAMPS. ]*/
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_064: [ While OPTION_MESSAGE_TRACE is set, IoTHubClient_LL_SendEventAsync shall trace the message and call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_ENQUEUED. ]*/
+                    start_message_trace(handleData, newEntry, (handleData->traceCallback != NULL) || (eventConfirmationCallbackEx != NULL));
+                    if (handleData->priorityEnabled)
+                    {
+                        insert_by_priority(handleData, newEntry, IoTHubMessage_GetPriority(eventMessageHandle));
+                    }
+                    else
+                    {
+                        newEntry->priorityTag = 0;
+                        DList_InsertTailList(&(handleData->waitingToSend), &(newEntry->entry));
+                    }
+                    track_ms_timesOutAfter(handleData, newEntry->ms_timesOutAfter);
+                    if (handleData->sendQueueLimitsEnabled)
+                    {
+                        handleData->sendQueueMessageCount++;
+                        handleData->sendQueueByteCount += byteCount;
+                        check_send_queue_watermarks(handleData);
+                    }
+                    if (handleData->statisticsEnabled)
+                    {
+                        handleData->statistics.messagesEnqueued++;
+                        handleData->statistics.bytesEnqueued += byteCount;
+                    }
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_105: [ IoTHubClient_LL_SendEventAsync shall emit IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED with the message handle added to waitingToSend, the one the transport trace points carry, and 0. ]*/
+                    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, newEntry->messageHandle, 0);
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_015: [Otherwise IoTHubClient_LL_SendEventAsync shall succeed and return IOTHUB_CLIENT_OK.] */
                     result = IOTHUB_CLIENT_OK;
                 }
@@ -908,245 +1837,1570 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
+/*confirms a message that is not sent as it is, so without the timestamps of its own entry*/
+static void confirm_event_without_timestamps(IOTHUB_CLIENT_CONFIRMATION_RESULT result, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX eventConfirmationCallbackEx, void* userContextCallback)
 {
-    IOTHUB_CLIENT_RESULT result;
-    if (iotHubClientHandle == NULL)
+    if (eventConfirmationCallbackEx != NULL)
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_016: [IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.] */
-        LogError("Invalid argument - iotHubClientHandle is NULL");
-        result = IOTHUB_CLIENT_INVALID_ARG;
+        IOTHUB_CLIENT_MESSAGE_TIMESTAMPS timestamps;
+        timestamps.enqueued = IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE;
+        timestamps.handedToTransport = IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE;
+        timestamps.written = IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE;
+        timestamps.acked = IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE;
+        eventConfirmationCallbackEx(result, &timestamps, userContextCallback);
     }
-    else
+    else if (eventConfirmationCallback != NULL)
     {
-        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
-        if (messageCallback == NULL)
+        eventConfirmationCallback(result, userContextCallback);
+    }
+}
+
+/*counts the messages of one IoTHubClient_LL_SendEventBatchAsync call, or the chunks of one message, that are not confirmed yet, plus one reference held while the batch is being enqueued*/
+typedef struct IOTHUB_EVENT_BATCH_TAG
+{
+    size_t pendingCount;
+    IOTHUB_CLIENT_CONFIRMATION_RESULT result;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX eventConfirmationCallbackEx;
+    void* userContextCallback;
+} IOTHUB_EVENT_BATCH;
+
+static void on_event_batch_message_complete(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* context)
+{
+    IOTHUB_EVENT_BATCH* batch = (IOTHUB_EVENT_BATCH*)context;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_022: [ The batch shall be confirmed with IOTHUB_CLIENT_CONFIRMATION_OK if all its messages are confirmed with IOTHUB_CLIENT_CONFIRMATION_OK, and with the result of the first message that is not otherwise. ]*/
+    if ((batch->result == IOTHUB_CLIENT_CONFIRMATION_OK) && (result != IOTHUB_CLIENT_CONFIRMATION_OK))
+    {
+        batch->result = result;
+    }
+
+    batch->pendingCount--;
+    if (batch->pendingCount == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_021: [ eventConfirmationCallback, if not NULL, shall be called once, after all the messages of the batch have been confirmed. ]*/
+        confirm_event_without_timestamps(batch->result, batch->eventConfirmationCallback, batch->eventConfirmationCallbackEx, batch->userContextCallback);
+        free(batch);
+    }
+}
+
+static bool is_event_batch_entry(IOTHUB_MESSAGE_LIST* messageList, IOTHUB_EVENT_BATCH* batch)
+{
+    return ((messageList->callback == on_event_batch_message_complete) && (messageList->context == batch)) ||
+        ((messageList->callback == on_send_queue_message_complete) && (messageList->userCallback == on_event_batch_message_complete) && (messageList->userContext == batch));
+}
+
+/*removes the messages of a batch that could not be enqueued completely, without calling the batch callback*/
+static void remove_event_batch_entries(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_EVENT_BATCH* batch)
+{
+    PDLIST_ENTRY currentEntry = handleData->waitingToSend.Flink;
+    batch->eventConfirmationCallback = NULL;
+    batch->eventConfirmationCallbackEx = NULL;
+    while (currentEntry != &(handleData->waitingToSend))
+    {
+        IOTHUB_MESSAGE_LIST* messageList = containingRecord(currentEntry, IOTHUB_MESSAGE_LIST, entry);
+        PDLIST_ENTRY nextEntry = currentEntry->Flink;
+        if (is_event_batch_entry(messageList, batch))
         {
-            if (handleData->messageCallback.type == CALLBACK_TYPE_NONE)
-            {
-                /*Codes_SRS_IOTHUBCLIENT_LL_10_010: [If parameter messageCallback is NULL and the _SetMessageCallback had not been called to subscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
-                LogError("not currently set to accept or process incoming messages.");
-                result = IOTHUB_CLIENT_ERROR;
-            }
-            else if (handleData->messageCallback.type == CALLBACK_TYPE_ASYNC)
-            {
-                /*Codes_SRS_IOTHUBCLIENT_LL_10_010: [If parameter messageCallback is NULL and the _SetMessageCallback had not been called to subscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
-                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageCallback_Ex function.");
-                result = IOTHUB_CLIENT_ERROR;
-            }
-            else
-            {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
-                handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
-                handleData->messageCallback.type = CALLBACK_TYPE_NONE;
-                handleData->messageCallback.callbackSync = NULL;
-                handleData->messageCallback.callbackAsync = NULL;
-                handleData->messageCallback.userContextCallback = NULL;
-                result = IOTHUB_CLIENT_OK;
-            }
+            DList_RemoveEntryList(currentEntry);
+            /*the callback keeps the send queue counters and the batch reference count right*/
+            messageList->callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, messageList->context);
+            IoTHubMessage_Destroy(messageList->messageHandle);
+            message_list_pool_release(handleData, messageList);
         }
-        else
+        currentEntry = nextEntry;
+    }
+}
+
+/*the chunks are confirmed together, as a batch, and a chunk that cannot be added removes the ones added before it*/
+static IOTHUB_CLIENT_RESULT enqueue_event_chunks(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, size_t chunkCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX eventConfirmationCallbackEx, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    char generatedId[CHUNKING_GENERATED_ID_SIZE];
+    const char* chunkId;
+    IOTHUB_EVENT_BATCH* batch;
+    if ((chunkId = chunking_get_chunk_id(eventMessageHandle, generatedId)) == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if ((batch = (IOTHUB_EVENT_BATCH*)malloc(sizeof(IOTHUB_EVENT_BATCH))) == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        size_t i;
+        batch->pendingCount = 1;
+        batch->result = IOTHUB_CLIENT_CONFIRMATION_OK;
+        batch->eventConfirmationCallback = eventConfirmationCallback;
+        batch->eventConfirmationCallbackEx = eventConfirmationCallbackEx;
+        batch->userContextCallback = userContextCallback;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_161: [ IoTHubClient_LL_SendEventAsync shall add the chunks made by chunking_create_chunk with the chunk id of chunking_get_chunk_id to waitingToSend, in order, instead of the message, and call the confirmation callback once, after all of them have been confirmed, with IOTHUB_CLIENT_CONFIRMATION_OK if all of them are confirmed with IOTHUB_CLIENT_CONFIRMATION_OK and with the result of the first one that is not otherwise. ]*/
+        result = IOTHUB_CLIENT_OK;
+        for (i = 0; (i < chunkCount) && (result == IOTHUB_CLIENT_OK); i++)
         {
-            if (handleData->messageCallback.type == CALLBACK_TYPE_ASYNC)
+            IOTHUB_MESSAGE_HANDLE chunk = chunking_create_chunk(eventMessageHandle, chunkId, handleData->messageChunkSize, i, chunkCount);
+            if (chunk == NULL)
             {
-                /* Codes_SRS_IOTHUBCLIENT_LL_10_011: [If parameter messageCallback is non-NULL and the _SetMessageCallback_Ex had been used to susbscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
-                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageCallback_Ex function before subscribing with MessageCallback.");
                 result = IOTHUB_CLIENT_ERROR;
+                LOG_ERROR_RESULT;
             }
             else
             {
-                if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_017: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Subscribe function.]*/
-                    handleData->messageCallback.type = CALLBACK_TYPE_SYNC;
-                    handleData->messageCallback.callbackSync = messageCallback;
-                    handleData->messageCallback.userContextCallback = userContextCallback;
-                    result = IOTHUB_CLIENT_OK;
-                }
-                else
+                batch->pendingCount++;
+                if ((result = enqueue_event(handleData, chunk, on_event_batch_message_complete, NULL, batch, true)) != IOTHUB_CLIENT_OK)
                 {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_018: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.]*/
-                    LogError("IoTHubTransport_Subscribe failed");
-                    handleData->messageCallback.type = CALLBACK_TYPE_NONE;
-                    handleData->messageCallback.callbackSync = NULL;
-                    handleData->messageCallback.callbackAsync = NULL;
-                    handleData->messageCallback.userContextCallback = NULL;
-                    result = IOTHUB_CLIENT_ERROR;
+                    batch->pendingCount--;
+                    IoTHubMessage_Destroy(chunk);
                 }
             }
         }
+
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_162: [ If making or adding any of the chunks fails, IoTHubClient_LL_SendEventAsync shall remove the chunks already added, without calling the confirmation callback, and fail with the error of adding it, IOTHUB_CLIENT_ERROR for making it. ]*/
+            LogError("unable to add all the chunks of the message");
+            remove_event_batch_entries(handleData, batch);
+        }
+        else if (takeOwnership)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_163: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall destroy eventMessageHandle once its chunks are added. ]*/
+            IoTHubMessage_Destroy(eventMessageHandle);
+        }
+
+        /*releases the reference held while enqueuing*/
+        on_event_batch_message_complete(IOTHUB_CLIENT_CONFIRMATION_OK, batch);
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT chunk_and_enqueue_event(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX eventConfirmationCallbackEx, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    size_t chunkCount;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_160: [ While OPTION_MESSAGE_CHUNK_SIZE is set and no outbox is set, IoTHubClient_LL_SendEventAsync shall send a message, once compressed, in chunks if chunking_get_chunk_count returns more than 1 for it and the chunk size. ]*/
+    if ((handleData->messageChunkSize == 0) ||
+        (handleData->outbox != NULL) ||
+        ((chunkCount = chunking_get_chunk_count(eventMessageHandle, handleData->messageChunkSize)) <= 1))
+    {
+        result = enqueue_event(handleData, eventMessageHandle, eventConfirmationCallback, eventConfirmationCallbackEx, userContextCallback, takeOwnership);
+    }
+    else
+    {
+        result = enqueue_event_chunks(handleData, eventMessageHandle, chunkCount, eventConfirmationCallback, eventConfirmationCallbackEx, userContextCallback, takeOwnership);
     }
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback_Ex(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX messageCallback, void* userContextCallback)
+/*returns the gzip copy of the message to send instead of it, or NULL if the message is sent as it is*/
+static IOTHUB_MESSAGE_HANDLE compress_event(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    IOTHUB_MESSAGE_COMPRESSION compression = IoTHubMessage_GetCompression(eventMessageHandle);
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_057: [ While compression is enabled, IoTHubClient_LL_SendEventAsync shall send a message whose compression is IOTHUB_MESSAGE_COMPRESSION_NONE, or IOTHUB_MESSAGE_COMPRESSION_DEFAULT with a payload smaller than minimumSizeInBytes, as it is. ]*/
+    if ((compression == IOTHUB_MESSAGE_COMPRESSION_NONE) ||
+        ((compression == IOTHUB_MESSAGE_COMPRESSION_DEFAULT) && (get_message_byte_count(eventMessageHandle) < handleData->compressionMinimumSize)))
+    {
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_058: [ Otherwise IoTHubClient_LL_SendEventAsync shall send the gzip copy of the message made by compressor_compress_message instead of the message, and send the message as it is if compressor_compress_message returns NULL. ]*/
+        result = compressor_compress_message(handleData->compressor, eventMessageHandle);
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT compress_and_enqueue_event(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX eventConfirmationCallbackEx, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_MESSAGE_HANDLE compressedMessage;
+    if ((handleData->compressor == NULL) ||
+        ((compressedMessage = compress_event(handleData, eventMessageHandle)) == NULL))
+    {
+        result = chunk_and_enqueue_event(handleData, eventMessageHandle, eventConfirmationCallback, eventConfirmationCallbackEx, userContextCallback, takeOwnership);
+    }
+    else if ((result = chunk_and_enqueue_event(handleData, compressedMessage, eventConfirmationCallback, eventConfirmationCallbackEx, userContextCallback, true)) != IOTHUB_CLIENT_OK)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_059: [ If the gzip copy cannot be added, IoTHubClient_LL_SendEventAsync shall destroy it and fail with the error of adding it. ]*/
+        IoTHubMessage_Destroy(compressedMessage);
+        LOG_ERROR_RESULT;
+    }
+    else if (takeOwnership)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_060: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall destroy eventMessageHandle once its gzip copy is added. ]*/
+        IoTHubMessage_Destroy(eventMessageHandle);
+    }
+    return result;
+}
+
+/*the stages work on the message that is queued, so the message of the application is cloned before them and not after*/
+static IOTHUB_CLIENT_RESULT send_event_through_pipeline(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX eventConfirmationCallbackEx, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_MESSAGE_HANDLE message;
+    tickcounter_ms_t nowMs;
+    if (tickcounter_get_current_ms(handleData->tickCounter, &nowMs) != 0)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_150: [ While OPTION_MESSAGE_PIPELINE is set, IoTHubClient_LL_SendEventAsync shall give the message it queues, its clone or the message itself with IoTHubClient_LL_SendEventAsync_TakeOwnership, to message_pipeline_process with the current ms before compressing and queueing it. ]*/
+    else if ((message = (takeOwnership ? eventMessageHandle : IoTHubMessage_Clone(eventMessageHandle))) == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if (message_pipeline_process(handleData->pipeline, message, nowMs) == IOTHUB_CLIENT_MESSAGE_STAGE_DROP)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_151: [ If message_pipeline_process returns IOTHUB_CLIENT_MESSAGE_STAGE_DROP, IoTHubClient_LL_SendEventAsync shall destroy the message it would have queued, call the confirmation callback with IOTHUB_CLIENT_CONFIRMATION_OK and return IOTHUB_CLIENT_OK. ]*/
+        IoTHubMessage_Destroy(message);
+        confirm_event_without_timestamps(IOTHUB_CLIENT_CONFIRMATION_OK, eventConfirmationCallback, eventConfirmationCallbackEx, userContextCallback);
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if (((result = compress_and_enqueue_event(handleData, message, eventConfirmationCallback, eventConfirmationCallbackEx, userContextCallback, true)) != IOTHUB_CLIENT_OK) && !takeOwnership)
+    {
+        IoTHubMessage_Destroy(message);
+        LOG_ERROR_RESULT;
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT send_event_async(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX eventConfirmationCallbackEx, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (eventMessageHandle == NULL) ||
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_012: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL.] */
+        ((eventConfirmationCallback == NULL) && (eventConfirmationCallbackEx == NULL) && (userContextCallback != NULL))
+        )
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else if (iotHubClientHandle->pipeline != NULL)
+    {
+        result = send_event_through_pipeline(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, eventConfirmationCallbackEx, userContextCallback, takeOwnership);
+    }
+    else
+    {
+        result = compress_and_enqueue_event(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, eventConfirmationCallbackEx, userContextCallback, takeOwnership);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, NULL, userContextCallback, false);
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_41_004: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall behave as IoTHubClient_LL_SendEventAsync, with the exception of the message handle not being cloned. ]*/
+/*Codes_SRS_IOTHUBCLIENT_LL_41_006: [ If IoTHubClient_LL_SendEventAsync_TakeOwnership fails, the ownership of eventMessageHandle shall remain with the caller. ]*/
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, NULL, userContextCallback, true);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync_Ex(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK_EX eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_061: [ IoTHubClient_LL_SendEventAsync_Ex shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL, or if eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+    if ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else if (eventConfirmationCallback == NULL)
+    {
+        result = send_event_async(iotHubClientHandle, eventMessageHandle, NULL, NULL, NULL, false);
+    }
+    else
+    {
+        result = send_event_async(iotHubClientHandle, eventMessageHandle, NULL, eventConfirmationCallback, userContextCallback, false);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventBatchAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    size_t i = 0;
+
+    if ((eventMessageHandles != NULL) && (eventMessageCount != 0))
+    {
+        while ((i < eventMessageCount) && (eventMessageHandles[i] != NULL))
+        {
+            i++;
+        }
+    }
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_019: [ If iotHubClientHandle or eventMessageHandles are NULL, eventMessageCount is 0, any of the message handles is NULL, or eventConfirmationCallback is NULL and userContextCallback is not NULL, IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (eventMessageHandles == NULL) ||
+        (eventMessageCount == 0) ||
+        (i != eventMessageCount) ||
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
+        )
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        IOTHUB_EVENT_BATCH* batch = (IOTHUB_EVENT_BATCH*)malloc(sizeof(IOTHUB_EVENT_BATCH));
+        if (batch == NULL)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LOG_ERROR_RESULT;
+        }
+        else
+        {
+            batch->pendingCount = 1;
+            batch->result = IOTHUB_CLIENT_CONFIRMATION_OK;
+            batch->eventConfirmationCallback = eventConfirmationCallback;
+            batch->eventConfirmationCallbackEx = NULL;
+            batch->userContextCallback = userContextCallback;
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_020: [ IoTHubClient_LL_SendEventBatchAsync shall add a clone of every message to waitingToSend, in order, the same way IoTHubClient_LL_SendEventAsync does. ]*/
+            result = IOTHUB_CLIENT_OK;
+            for (i = 0; (i < eventMessageCount) && (result == IOTHUB_CLIENT_OK); i++)
+            {
+                batch->pendingCount++;
+                if ((result = send_event_async(iotHubClientHandle, eventMessageHandles[i], on_event_batch_message_complete, NULL, batch, false)) != IOTHUB_CLIENT_OK)
+                {
+                    batch->pendingCount--;
+                }
+            }
+
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_023: [ If adding any of the messages fails, IoTHubClient_LL_SendEventBatchAsync shall remove the messages of the batch already added, without calling eventConfirmationCallback, and return the error of IoTHubClient_LL_SendEventAsync. ]*/
+                LogError("unable to add all the messages of the batch");
+                remove_event_batch_entries(handleData, batch);
+            }
+
+            /*releases the reference held while enqueuing, the batch is freed here if none of its messages is pending*/
+            on_event_batch_message_complete(IOTHUB_CLIENT_CONFIRMATION_OK, batch);
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetMessagePoolStatistics(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_POOL_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_010: [ If iotHubClientHandle or statistics are NULL, IoTHubClient_LL_GetMessagePoolStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((iotHubClientHandle == NULL) || (statistics == NULL))
+    {
+        LogError("invalid argument iotHubClientHandle(%p), statistics(%p)", iotHubClientHandle, statistics);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_011: [ IoTHubClient_LL_GetMessagePoolStatistics shall copy the pool hits, misses, current number of cached entries and the highest number of cached entries to statistics and return IOTHUB_CLIENT_OK. ]*/
+        *statistics = iotHubClientHandle->messageListPoolStatistics;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+static void trim_memory(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_138: [ IoTHubClient_LL_TrimMemory shall free the IOTHUB_MESSAGE_LIST entries kept for reuse and call the underlying layer's _TrimMemory function if the transport has one and return IOTHUB_CLIENT_OK. ]*/
+    message_list_pool_trim(handleData, 0);
+    if (handleData->IoTHubTransport_TrimMemory != NULL)
+    {
+        handleData->IoTHubTransport_TrimMemory(handleData->transportHandle);
+    }
+}
+
+/*the pooled entries and the buffers of the transport grow with the traffic, they are given back once nothing was queued for idleTrimTimeMs*/
+static void trim_memory_when_idle(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    tickcounter_ms_t nowTick;
+    if (!DList_IsListEmpty(&handleData->waitingToSend)
+#ifndef DONT_USE_DEVICE_TWIN
+        || !DList_IsListEmpty(&handleData->iot_msg_queue)
+#endif
+        )
+    {
+        handleData->isIdle = false;
+        handleData->isIdleTrimmed = false;
+    }
+    else if (handleData->isIdleTrimmed)
+    {
+        /*trimmed already, until something is queued again*/
+    }
+    else if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        LogErrorLimited("unable to get the current ms, the memory is not trimmed");
+    }
+    else if (!handleData->isIdle)
+    {
+        handleData->isIdle = true;
+        handleData->idleSince = nowTick;
+    }
+    else if (nowTick - handleData->idleSince >= handleData->idleTrimTimeMs)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_140: [ While idle_trim_time is not 0, IoTHubClient_LL_DoWork shall trim the memory as IoTHubClient_LL_TrimMemory does once waitingToSend and iot_msg_queue have been empty for idle_trim_time seconds, and once only until a message or reported state is queued again. ]*/
+        trim_memory(handleData);
+        handleData->isIdleTrimmed = true;
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_TrimMemory(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_137: [ If iotHubClientHandle is NULL, IoTHubClient_LL_TrimMemory shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("invalid argument iotHubClientHandle(NULL)");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        trim_memory((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle);
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+/*returns the upper bound in ms of the histogram bucket holding the given percentile of the latencies, the lower bound for the last bucket*/
+static uint64_t get_latency_percentile(const IOTHUB_CLIENT_STATISTICS* statistics, uint64_t totalCount, unsigned int percentile)
+{
+    uint64_t result = 0;
+    if (totalCount != 0)
+    {
+        uint64_t rank = (totalCount * percentile + 99) / 100;
+        uint64_t count = 0;
+        size_t bucket = 0;
+        while ((bucket < IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKET_COUNT - 1) && (count + statistics->latencyHistogram[bucket] < rank))
+        {
+            count += statistics->latencyHistogram[bucket];
+            bucket++;
+        }
+        result = (bucket < IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKET_COUNT - 1) ? ((uint64_t)1 << bucket) : ((uint64_t)1 << (bucket - 1));
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetStatistics(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_024: [ If iotHubClientHandle or statistics are NULL, IoTHubClient_LL_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((iotHubClientHandle == NULL) || (statistics == NULL))
+    {
+        LogError("invalid argument iotHubClientHandle(%p), statistics(%p)", iotHubClientHandle, statistics);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        uint64_t latencyCount = 0;
+        uint64_t outstandingCount;
+        size_t waitingCount = 0;
+        size_t bucket;
+        PDLIST_ENTRY currentEntry;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_025: [ IoTHubClient_LL_GetStatistics shall copy the counters and the latency histogram of the counted messages to statistics, together with the number of them still in waitingToSend, the number of them picked up by the transport and not confirmed yet, and the percentiles of the latency. ]*/
+        *statistics = handleData->statistics;
+
+        for (currentEntry = handleData->waitingToSend.Flink; currentEntry != &(handleData->waitingToSend); currentEntry = currentEntry->Flink)
+        {
+            IOTHUB_MESSAGE_LIST* messageList = containingRecord(currentEntry, IOTHUB_MESSAGE_LIST, entry);
+            if ((messageList->callback == on_send_queue_message_complete) && messageList->countedInStatistics)
+            {
+                waitingCount++;
+            }
+        }
+        outstandingCount = statistics->messagesEnqueued - statistics->messagesConfirmed - statistics->messagesTimedOut - statistics->messagesFailed;
+        statistics->waitingToSendDepth = waitingCount;
+        statistics->inProgressDepth = (outstandingCount > waitingCount) ? (size_t)(outstandingCount - waitingCount) : 0;
+        statistics->messagesSent = handleData->statisticsCompletedByTransport + statistics->inProgressDepth;
+
+        for (bucket = 0; bucket < IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKET_COUNT; bucket++)
+        {
+            latencyCount += statistics->latencyHistogram[bucket];
+        }
+        statistics->msLatencyP50 = get_latency_percentile(statistics, latencyCount, 50);
+        statistics->msLatencyP95 = get_latency_percentile(statistics, latencyCount, 95);
+        statistics->msLatencyP99 = get_latency_percentile(statistics, latencyCount, 99);
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_026: [ If the client is disconnected, IoTHubClient_LL_GetStatistics shall add the time elapsed since the disconnection to msDisconnected. ]*/
+        if (handleData->statisticsDisconnectedAfterConnected)
+        {
+            tickcounter_ms_t nowTick;
+            if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+            {
+                LogError("unable to get the current ms, msDisconnected does not include the current disconnection");
+            }
+            else
+            {
+                statistics->msDisconnected += nowTick - handleData->statisticsDisconnectedSince;
+            }
+        }
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetKeepAlive(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, int* keepAliveInterval)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_071: [ If iotHubClientHandle or keepAliveInterval are NULL, IoTHubClient_LL_GetKeepAlive shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((iotHubClientHandle == NULL) || (keepAliveInterval == NULL))
+    {
+        LogError("invalid argument iotHubClientHandle(%p), keepAliveInterval(%p)", iotHubClientHandle, keepAliveInterval);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_072: [ IoTHubClient_LL_GetKeepAlive shall set keepAliveInterval to the last value reported by the transport with IoTHubClient_LL_KeepAliveChanged, 0 if none was reported, and return IOTHUB_CLIENT_OK. ]*/
+        *keepAliveInterval = ((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle)->keepAliveInterval;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+void* IoTHubClient_LL_GetTransportHandle(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    void* result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_100: [ If iotHubClientHandle is NULL, IoTHubClient_LL_GetTransportHandle shall return NULL. ]*/
+    if (iotHubClientHandle == NULL)
+    {
+        LogError("invalid argument iotHubClientHandle(NULL)");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_101: [ IoTHubClient_LL_GetTransportHandle shall return the lower layer transport of the client, created by it or given to IoTHubClient_LL_CreateWithTransport. ]*/
+        result = ((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle)->transportHandle;
+    }
+    return result;
+}
+
+/*while the receive is paused the callbacks are set and cleared without the transport, IoTHubClient_LL_ResumeReceive subscribes for them*/
+static int subscribe_messages(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    return handleData->isReceivePaused ? 0 : handleData->IoTHubTransport_Subscribe(handleData->deviceHandle);
+}
+
+static void unsubscribe_messages(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    if (!handleData->isReceivePaused)
+    {
+        handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+    }
+}
+
+#ifndef DONT_USE_DEVICE_METHODS
+static int subscribe_methods(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    return handleData->isReceivePaused ? 0 : handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle);
+}
+
+static void unsubscribe_methods(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    if (!handleData->isReceivePaused)
+    {
+        handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->transportHandle);
+    }
+}
+#endif /*DONT_USE_DEVICE_METHODS*/
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_016: [IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.] */
+        LogError("Invalid argument - iotHubClientHandle is NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (messageCallback == NULL)
+        {
+            if (handleData->messageCallback.type == CALLBACK_TYPE_NONE)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_010: [If parameter messageCallback is NULL and the _SetMessageCallback had not been called to subscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
+                LogError("not currently set to accept or process incoming messages.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_ASYNC)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_010: [If parameter messageCallback is NULL and the _SetMessageCallback had not been called to subscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageCallback_Ex function.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_CHUNKED)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_122: [ If IoTHubClient_LL_SetMessageChunkCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback and IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageChunkCallback function.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
+                unsubscribe_messages(handleData);
+                handleData->messageCallback.type = CALLBACK_TYPE_NONE;
+                handleData->messageCallback.callbackSync = NULL;
+                handleData->messageCallback.callbackAsync = NULL;
+                handleData->messageCallback.userContextCallback = NULL;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else
+        {
+            if (handleData->messageCallback.type == CALLBACK_TYPE_ASYNC)
+            {
+                /* Codes_SRS_IOTHUBCLIENT_LL_10_011: [If parameter messageCallback is non-NULL and the _SetMessageCallback_Ex had been used to susbscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageCallback_Ex function before subscribing with MessageCallback.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_CHUNKED)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_122: [ If IoTHubClient_LL_SetMessageChunkCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback and IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageChunkCallback function before subscribing with MessageCallback.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (subscribe_messages(handleData) == 0)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_017: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Subscribe function.]*/
+                    handleData->messageCallback.type = CALLBACK_TYPE_SYNC;
+                    handleData->messageCallback.callbackSync = messageCallback;
+                    handleData->messageCallback.userContextCallback = userContextCallback;
+                    result = IOTHUB_CLIENT_OK;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_018: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.]*/
+                    LogError("IoTHubTransport_Subscribe failed");
+                    handleData->messageCallback.type = CALLBACK_TYPE_NONE;
+                    handleData->messageCallback.callbackSync = NULL;
+                    handleData->messageCallback.callbackAsync = NULL;
+                    handleData->messageCallback.userContextCallback = NULL;
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback_Ex(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX messageCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_021: [IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
+        LogError("Invalid argument - iotHubClientHandle is NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (messageCallback == NULL)
+        {
+            if (handleData->messageCallback.type == CALLBACK_TYPE_NONE)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_018: [If parameter messageCallback is NULL and IoTHubClient_LL_SetMessageCallback_Ex had not been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
+                LogError("not currently set to accept or process incoming messages.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_SYNC)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_019: [If parameter messageCallback is NULL and IoTHubClient_LL_SetMessageCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageCallback function.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_CHUNKED)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_122: [ If IoTHubClient_LL_SetMessageChunkCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback and IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageChunkCallback function.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_023: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */ 
+                unsubscribe_messages(handleData);
+                handleData->messageCallback.type = CALLBACK_TYPE_NONE;
+                handleData->messageCallback.callbackSync = NULL;
+                handleData->messageCallback.callbackAsync = NULL;
+                handleData->messageCallback.userContextCallback = NULL;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else
+        {
+            if (handleData->messageCallback.type == CALLBACK_TYPE_SYNC)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_020: [If parameter messageCallback is non-NULL, and IoTHubClient_LL_SetMessageCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_MessageCallbackEx function before subscribing with MessageCallback.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_CHUNKED)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_122: [ If IoTHubClient_LL_SetMessageChunkCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback and IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageChunkCallback function before subscribing with MessageCallbackEx.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (subscribe_messages(handleData) == 0)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_10_024: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Subscribe function.]*/
+                    handleData->messageCallback.type = CALLBACK_TYPE_ASYNC;
+                    handleData->messageCallback.callbackAsync = messageCallback;
+                    handleData->messageCallback.userContextCallback = userContextCallback;
+                    result = IOTHUB_CLIENT_OK;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_10_025: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback_Ex shall succeed and return IOTHUB_CLIENT_OK.] */
+                    LogError("IoTHubTransport_Subscribe failed");
+                    handleData->messageCallback.type = CALLBACK_TYPE_NONE;
+                    handleData->messageCallback.callbackSync = NULL;
+                    handleData->messageCallback.callbackAsync = NULL;
+                    handleData->messageCallback.userContextCallback = NULL;
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageChunkCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, size_t chunkSize, IOTHUB_CLIENT_MESSAGE_CHUNK_CALLBACK messageChunkCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if ((iotHubClientHandle == NULL) || ((messageChunkCallback != NULL) && (chunkSize == 0)))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_119: [ If iotHubClientHandle is NULL, or messageChunkCallback is not NULL and chunkSize is 0, IoTHubClient_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("Invalid argument iotHubClientHandle=%p, chunkSize=%lu", iotHubClientHandle, (unsigned long)chunkSize);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (messageChunkCallback == NULL)
+        {
+            if (handleData->messageCallback.type != CALLBACK_TYPE_CHUNKED)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_120: [ If messageChunkCallback is NULL and IoTHubClient_LL_SetMessageChunkCallback had not been used to subscribe for messages, IoTHubClient_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("not currently set to receive messages in chunks.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_121: [ If messageChunkCallback is NULL, IoTHubClient_LL_SetMessageChunkCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK. ]*/
+                unsubscribe_messages(handleData);
+                handleData->messageCallback.type = CALLBACK_TYPE_NONE;
+                handleData->messageCallback.callbackChunked = NULL;
+                handleData->messageCallback.chunkSize = 0;
+                handleData->messageCallback.userContextCallback = NULL;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if ((handleData->messageCallback.type == CALLBACK_TYPE_SYNC) || (handleData->messageCallback.type == CALLBACK_TYPE_ASYNC))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_123: [ If messageChunkCallback is not NULL and IoTHubClient_LL_SetMessageCallback or IoTHubClient_LL_SetMessageCallback_Ex had been used to subscribe for messages, IoTHubClient_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("Invalid workflow sequence. Please unsubscribe using the function used to subscribe before subscribing with MessageChunkCallback.");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((handleData->messageCallback.type == CALLBACK_TYPE_NONE) && (subscribe_messages(handleData) != 0))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_124: [ If messageChunkCallback is not NULL, IoTHubClient_LL_SetMessageChunkCallback shall call the underlying layer's _Subscribe function unless it is subscribed already, and fail with IOTHUB_CLIENT_ERROR if it fails. ]*/
+            LogError("IoTHubTransport_Subscribe failed");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_125: [ Otherwise IoTHubClient_LL_SetMessageChunkCallback shall keep messageChunkCallback, chunkSize and userContextCallback and return IOTHUB_CLIENT_OK. ]*/
+            handleData->messageCallback.type = CALLBACK_TYPE_CHUNKED;
+            handleData->messageCallback.callbackChunked = messageChunkCallback;
+            handleData->messageCallback.chunkSize = chunkSize;
+            handleData->messageCallback.userContextCallback = userContextCallback;
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_PauseReceive(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_172: [ If iotHubClientHandle is NULL, IoTHubClient_LL_PauseReceive shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("Invalid argument - iotHubClientHandle is NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (!handleData->isReceivePaused)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_173: [ IoTHubClient_LL_PauseReceive shall call the underlying layer's _Unsubscribe function while a message callback is set and its IoTHubTransport_Unsubscribe_DeviceMethod function while a method callback is set, keeping the callbacks. ]*/
+            if (handleData->messageCallback.type != CALLBACK_TYPE_NONE)
+            {
+                handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+            }
+#ifndef DONT_USE_DEVICE_METHODS
+            if (handleData->methodCallback.type != CALLBACK_TYPE_NONE)
+            {
+                handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->transportHandle);
+            }
+#endif
+            handleData->isReceivePaused = true;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_174: [ While the receive is paused, the message and method callbacks shall be set and cleared without calling the underlying layer, and IoTHubClient_LL_PauseReceive shall return IOTHUB_CLIENT_OK. ]*/
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_ResumeReceive(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_175: [ If iotHubClientHandle is NULL, IoTHubClient_LL_ResumeReceive shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("Invalid argument - iotHubClientHandle is NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (!handleData->isReceivePaused)
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_176: [ IoTHubClient_LL_ResumeReceive shall call the underlying layer's _Subscribe function while a message callback is set and its IoTHubTransport_Subscribe_DeviceMethod function while a method callback is set, and return IOTHUB_CLIENT_OK. ]*/
+        else if ((handleData->messageCallback.type != CALLBACK_TYPE_NONE) && (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) != 0))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_177: [ If a subscription fails, IoTHubClient_LL_ResumeReceive shall undo the subscription it made, stay paused and return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("IoTHubTransport_Subscribe failed");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+#ifndef DONT_USE_DEVICE_METHODS
+        else if ((handleData->methodCallback.type != CALLBACK_TYPE_NONE) && (handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle) != 0))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_177: [ If a subscription fails, IoTHubClient_LL_ResumeReceive shall undo the subscription it made, stay paused and return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("IoTHubTransport_Subscribe_DeviceMethod failed");
+            if (handleData->messageCallback.type != CALLBACK_TYPE_NONE)
+            {
+                handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+            }
+            result = IOTHUB_CLIENT_ERROR;
+        }
+#endif
+        else
+        {
+            handleData->isReceivePaused = false;
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    return result;
+}
+
+static bool is_duplicate_message(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, MESSAGE_CALLBACK_INFO* messageData)
+{
+    bool result;
+    const char* messageId;
+    tickcounter_ms_t nowMs;
+    if ((handleData->duplicateFilter == NULL) || ((messageId = IoTHubMessage_GetMessageId(messageData->messageHandle)) == NULL))
+    {
+        result = false;
+    }
+    else if (tickcounter_get_current_ms(handleData->tickCounter, &nowMs) != 0)
+    {
+        LogError("unable to get the current ms, the message is not filtered");
+        result = false;
+    }
+    else
+    {
+        result = duplicate_filter_contains(handleData->duplicateFilter, messageId, nowMs);
+    }
+    return result;
+}
+
+/*the id of a message is remembered once the application settled it: the hub delivers an abandoned message again and the application shall get it*/
+static IOTHUB_CLIENT_RESULT send_message_disposition(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, MESSAGE_CALLBACK_INFO* messageData, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    const char* messageId;
+    tickcounter_ms_t nowMs;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_156: [ While OPTION_C2D_DUPLICATE_FILTER is set, the message id of a message whose disposition is sent to the underlying layer, other than IOTHUBMESSAGE_ABANDONED, shall be given to duplicate_filter_add before the disposition is sent. ]*/
+    if ((handleData->duplicateFilter != NULL) &&
+        (disposition != IOTHUBMESSAGE_ABANDONED) &&
+        (messageData->messageHandle != NULL) &&
+        ((messageId = IoTHubMessage_GetMessageId(messageData->messageHandle)) != NULL))
+    {
+        if (tickcounter_get_current_ms(handleData->tickCounter, &nowMs) != 0)
+        {
+            LogError("unable to get the current ms, the message id is not remembered");
+        }
+        else
+        {
+            duplicate_filter_add(handleData->duplicateFilter, messageId, nowMs);
+        }
+    }
+    return handleData->IoTHubTransport_SendMessageDisposition(messageData, disposition);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendMessageDisposition(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, MESSAGE_CALLBACK_INFO* message_data, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if ((iotHubClientHandle == NULL) || (message_data == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_026: [IoTHubClient_LL_SendMessageDisposition shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
+        LogError("Invalid argument handle=%p, message=%p", iotHubClientHandle, message_data);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_027: [IoTHubClient_LL_SendMessageDisposition shall return the result from calling the underlying layer's _Send_Message_Disposition.]*/
+        result = send_message_disposition(handleData, message_data, disposition);
+    }
+    return result;
+}
+
+static void DoTimeouts(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    tickcounter_ms_t nowTick;
+    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        LogErrorLimited("unable to get the current ms, timeouts will not be processed");
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_001: [ If no message in waitingToSend can have timed out yet, IoTHubClient_LL_DoWork shall not walk the waitingToSend list. ]*/
+    else if ((handleData->nextMessageTimeout != 0) && (handleData->nextMessageTimeout < nowTick))
+    {
+        tickcounter_ms_t nextMessageTimeout = 0;
+        tickcounter_ms_t lastMessageTimeout = 0;
+        bool isOrderedByTimeout = true;
+        DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
+        while (currentItemInWaitingToSend != &(handleData->waitingToSend)) /*while we are not at the end of the list*/
+        {
+            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+            if ((fullEntry->ms_timesOutAfter != 0) && (fullEntry->ms_timesOutAfter < nowTick))
+            {
+                PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
+                DList_RemoveEntryList(currentItemInWaitingToSend);
+                if (fullEntry->callback != NULL)
+                {
+                    fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
+                }
+                IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
+                message_list_pool_release(handleData, fullEntry);
+                currentItemInWaitingToSend = theNext;
+            }
+            else
+            {
+                if (fullEntry->ms_timesOutAfter != 0)
+                {
+                    if (handleData->waitingToSendOrderedByTimeout)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_LL_41_002: [ While waitingToSend is ordered by timeout, IoTHubClient_LL_DoWork shall stop at the first message with a timeout that has not timed out. ]*/
+                        nextMessageTimeout = fullEntry->ms_timesOutAfter;
+                        lastMessageTimeout = handleData->lastMessageTimeout;
+                        break;
+                    }
+                    else
+                    {
+                        if ((nextMessageTimeout == 0) || (fullEntry->ms_timesOutAfter < nextMessageTimeout))
+                        {
+                            nextMessageTimeout = fullEntry->ms_timesOutAfter;
+                        }
+                        if (fullEntry->ms_timesOutAfter < lastMessageTimeout)
+                        {
+                            isOrderedByTimeout = false;
+                        }
+                        else
+                        {
+                            lastMessageTimeout = fullEntry->ms_timesOutAfter;
+                        }
+                    }
+                }
+                currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
+            }
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_003: [ IoTHubClient_LL_DoWork shall remember the earliest timeout of the messages left in waitingToSend and whether they are still ordered by timeout. ]*/
+        handleData->nextMessageTimeout = nextMessageTimeout;
+        handleData->lastMessageTimeout = lastMessageTimeout;
+        handleData->waitingToSendOrderedByTimeout = isOrderedByTimeout;
+    }
+}
+
+#ifndef DONT_USE_DEVICE_TWIN
+/*a response lost with the connection would otherwise hold its place in the twin window forever*/
+static void expire_device_twin_items(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    tickcounter_ms_t nowTick;
+    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        LogErrorLimited("unable to get the current time");
+    }
+    else
+    {
+        DLIST_ENTRY* client_item = handleData->iot_ack_queue.Flink;
+        while (client_item != &(handleData->iot_ack_queue))
+        {
+            PDLIST_ENTRY next_item = client_item->Flink;
+            IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
+            if ((queue_data->ms_timesOutAfter != 0) && (queue_data->ms_timesOutAfter <= nowTick))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_054: [ IoTHubClient_LL_DoWork shall call the callbacks of the items of iot_ack_queue that timed out with TWIN_ACK_TIMEOUT_STATUS_CODE, then remove and destroy them. ]*/
+                LogError("reported state %lu was not acknowledged in time", (unsigned long)queue_data->item_id);
+                device_twin_data_complete(queue_data, TWIN_ACK_TIMEOUT_STATUS_CODE);
+                DList_RemoveEntryList(client_item);
+                device_twin_data_destroy(queue_data);
+                handleData->twinInFlight--;
+            }
+            client_item = next_item;
+        }
+    }
+}
+
+/*the transport takes the reported states while the twin window lets them through, those it accepted wait in iot_ack_queue*/
+static void process_device_twin_items(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    if ((handleData->twinAckTimeoutMs != 0) && (handleData->twinInFlight != 0))
+    {
+        expire_device_twin_items(handleData);
+    }
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClient_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_147: [ IoTHubTransport_ProcessItem, IoTHubTransport_Subscribe_DeviceTwin and IoTHubTransport_Unsubscribe_DeviceTwin shall be given the device handle returned by IoTHubTransport_Register, so a transport shared by several devices knows whose twin it is. ]*/
+    DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_052: [ While the twin window is set, IoTHubClient_LL_DoWork shall leave the items of iot_msg_queue queued once maxInFlight items wait for their acknowledgement. ]*/
+    while ((client_item != &(handleData->iot_msg_queue)) && /*while we are not at the end of the list*/
+        ((handleData->twinMaxInFlight == 0) || (handleData->twinInFlight < handleData->twinMaxInFlight)))
+    {
+        PDLIST_ENTRY next_item = client_item->Flink;
+
+        IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
+        IOTHUB_IDENTITY_INFO identity_info;
+        identity_info.device_twin = queue_data;
+        IOTHUB_PROCESS_ITEM_RESULT process_results =  handleData->IoTHubTransport_ProcessItem(handleData->deviceHandle, IOTHUB_TYPE_DEVICE_TWIN, &identity_info);
+        if (process_results == IOTHUB_PROCESS_CONTINUE || process_results == IOTHUB_PROCESS_NOT_CONNECTED)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_07_010: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_CONTINUE or IOTHUB_PROCESS_NOT_CONNECTED IoTHubClient_LL_DoWork shall continue on to call the underlaying layer's _DoWork function. ]*/
+            break;
+        }
+        else 
+        {
+            DList_RemoveEntryList(client_item);
+            if (process_results == IOTHUB_PROCESS_OK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_07_011: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_OK IoTHubClient_LL_DoWork shall add the IOTHUB_DEVICE_TWIN to the ack queue. ]*/
+                DList_InsertTailList(&(handleData->iot_ack_queue), &(queue_data->entry));
+                handleData->twinInFlight++;
+                if (handleData->twinAckTimeoutMs != 0)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_053: [ If ackTimeoutInSeconds is not 0, IoTHubClient_LL_DoWork shall set the item to time out ackTimeoutInSeconds after it was given to the transport. ]*/
+                    if (tickcounter_get_current_ms(handleData->tickCounter, &queue_data->ms_timesOutAfter) != 0)
+                    {
+                        LogError("unable to get the current time, the item does not time out");
+                        queue_data->ms_timesOutAfter = 0;
+                    }
+                    else
+                    {
+                        queue_data->ms_timesOutAfter += handleData->twinAckTimeoutMs;
+                    }
+                }
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_07_012: [ If 'IoTHubTransport_ProcessItem' returns any other value IoTHubClient_LL_DoWork shall destroy the IOTHUB_DEVICE_TWIN item. ]*/
+                LogError("Failure queue processing item");
+                device_twin_data_destroy(queue_data);
+            }
+        }
+        // Move along to the next item
+        client_item = next_item;
+    }
+}
+#endif
+
+static bool is_rate_limited(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    return (handleData->rateLimit.messagesPerSecond != 0) || (handleData->rateLimit.bytesPerSecond != 0);
+}
+
+/*the rate in use, never 0 so that the tokens keep coming*/
+static uint64_t get_scaled_rate(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t rate)
+{
+    uint64_t result = ((uint64_t)rate * handleData->rateLimitScale) / RATE_LIMIT_FULL_SCALE;
+    return (result == 0) ? 1 : result;
+}
+
+/*a bucket holds one second of its rate, a rate per second adds as many thousandths of a token every ms*/
+static uint64_t refill_bucket(uint64_t tokens, uint64_t rate, tickcounter_ms_t elapsed)
+{
+    uint64_t capacity = rate * RATE_LIMIT_TOKEN;
+    return ((elapsed >= 1000) || (tokens + elapsed * rate >= capacity)) ? capacity : tokens + elapsed * rate;
+}
+
+static void refill_rate_limit_tokens(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, tickcounter_ms_t nowTick)
+{
+    tickcounter_ms_t elapsed = nowTick - handleData->rateLimitRefilledAt;
+    handleData->rateLimitRefilledAt = nowTick;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_171: [ The rates in use shall be raised back by a tenth of the rate limit every second, up to the rate limit. ]*/
+    if ((elapsed >= 1000000) || (handleData->rateLimitScale + elapsed * RATE_LIMIT_RECOVERY_PER_MS >= RATE_LIMIT_FULL_SCALE))
+    {
+        handleData->rateLimitScale = RATE_LIMIT_FULL_SCALE;
+    }
+    else
+    {
+        handleData->rateLimitScale += elapsed * RATE_LIMIT_RECOVERY_PER_MS;
+    }
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_167: [ The token buckets shall fill at the rates in use, up to one second of them. ]*/
+    if (handleData->rateLimit.messagesPerSecond != 0)
+    {
+        handleData->rateLimitMessageTokens = refill_bucket(handleData->rateLimitMessageTokens, get_scaled_rate(handleData, handleData->rateLimit.messagesPerSecond), elapsed);
+    }
+    if (handleData->rateLimit.bytesPerSecond != 0)
+    {
+        handleData->rateLimitByteTokens = refill_bucket(handleData->rateLimitByteTokens, get_scaled_rate(handleData, handleData->rateLimit.bytesPerSecond), elapsed);
+    }
+}
+
+/*a message larger than the byte bucket takes all of it once it is full*/
+static uint64_t get_rate_limit_byte_cost(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    uint64_t result;
+    if (handleData->rateLimit.bytesPerSecond == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        uint64_t capacity = get_scaled_rate(handleData, handleData->rateLimit.bytesPerSecond) * RATE_LIMIT_TOKEN;
+        result = (uint64_t)get_message_byte_count(messageHandle) * RATE_LIMIT_TOKEN;
+        if (result > capacity)
+        {
+            result = capacity;
+        }
+    }
+    return result;
+}
+
+/*ms until the buckets hold the tokens of a message of byteCost, 0 when they do*/
+static uint32_t get_rate_limit_wait_ms(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, uint64_t messageTokens, uint64_t byteTokens, uint64_t byteCost)
+{
+    uint32_t result = 0;
+    if ((handleData->rateLimit.messagesPerSecond != 0) && (messageTokens < RATE_LIMIT_TOKEN))
+    {
+        uint64_t rate = get_scaled_rate(handleData, handleData->rateLimit.messagesPerSecond);
+        result = (uint32_t)((RATE_LIMIT_TOKEN - messageTokens + rate - 1) / rate);
+    }
+    if ((handleData->rateLimit.bytesPerSecond != 0) && (byteTokens < byteCost))
+    {
+        uint64_t rate = get_scaled_rate(handleData, handleData->rateLimit.bytesPerSecond);
+        uint32_t byteWait = (uint32_t)((byteCost - byteTokens + rate - 1) / rate);
+        if (byteWait > result)
+        {
+            result = byteWait;
+        }
+    }
+    return result;
+}
+
+/*returns the first message of waitingToSend the buckets have no tokens for, or waitingToSend itself, and sets waitMs to the time until it has them. The tokens of the messages before it are taken when takeTokens*/
+static PDLIST_ENTRY find_rate_limited_message(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, bool takeTokens, uint32_t* waitMs)
+{
+    PDLIST_ENTRY result = handleData->waitingToSend.Flink;
+    uint64_t messageTokens = handleData->rateLimitMessageTokens;
+    uint64_t byteTokens = handleData->rateLimitByteTokens;
+    *waitMs = 0;
+    while (result != &(handleData->waitingToSend))
+    {
+        uint64_t byteCost = get_rate_limit_byte_cost(handleData, containingRecord(result, IOTHUB_MESSAGE_LIST, entry)->messageHandle);
+        *waitMs = get_rate_limit_wait_ms(handleData, messageTokens, byteTokens, byteCost);
+        if (*waitMs != 0)
+        {
+            break;
+        }
+        if (handleData->rateLimit.messagesPerSecond != 0)
+        {
+            messageTokens -= RATE_LIMIT_TOKEN;
+        }
+        byteTokens -= byteCost;
+        result = result->Flink;
+    }
+    if (takeTokens)
+    {
+        handleData->rateLimitMessageTokens = messageTokens;
+        handleData->rateLimitByteTokens = byteTokens;
+    }
+    return result;
+}
+
+/*moves the messages of waitingToSend from firstHeld on to held, so the transport only sees the ones before them*/
+static void hold_messages(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, PDLIST_ENTRY firstHeld, PDLIST_ENTRY held)
+{
+    if (firstHeld == &(handleData->waitingToSend))
+    {
+        held->Flink = held;
+        held->Blink = held;
+    }
+    else
+    {
+        PDLIST_ENTRY lastHeld = handleData->waitingToSend.Blink;
+        firstHeld->Blink->Flink = &(handleData->waitingToSend);
+        handleData->waitingToSend.Blink = firstHeld->Blink;
+        held->Flink = firstHeld;
+        firstHeld->Blink = held;
+        held->Blink = lastHeld;
+        lastHeld->Flink = held;
+    }
+}
+
+/*puts the held messages back at the end of waitingToSend*/
+static void release_held_messages(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, PDLIST_ENTRY held)
+{
+    if (held->Flink != held)
+    {
+        PDLIST_ENTRY last = handleData->waitingToSend.Blink;
+        last->Flink = held->Flink;
+        held->Flink->Blink = last;
+        held->Blink->Flink = &(handleData->waitingToSend);
+        handleData->waitingToSend.Blink = held->Blink;
+    }
+}
+
+/*token buckets between waitingToSend and the transport: over the rate, the messages wait in waitingToSend instead of being throttled by the hub*/
+static void do_rate_limited_transport_work(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    tickcounter_ms_t nowTick;
+    PDLIST_ENTRY firstMessage = handleData->waitingToSend.Flink;
+    PDLIST_ENTRY firstHeld;
+    PDLIST_ENTRY lastHanded;
+    uint64_t messageTokens = 0;
+    uint64_t byteTokens = 0;
+    DLIST_ENTRY held;
+
+    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        LogErrorLimited("unable to get the current ms, no message is handed to the transport");
+        firstHeld = firstMessage;
+    }
+    else
+    {
+        uint32_t waitMs;
+        refill_rate_limit_tokens(handleData, nowTick);
+        messageTokens = handleData->rateLimitMessageTokens;
+        byteTokens = handleData->rateLimitByteTokens;
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_166: [ While the rate limit is set, IoTHubClient_LL_DoWork shall hand to the underlying layer's _DoWork function only the messages at the head of waitingToSend the token buckets have tokens for, taking one message token and a token per payload byte for each of them, and keep the others in waitingToSend for later. ]*/
+        firstHeld = find_rate_limited_message(handleData, true, &waitMs);
+    }
+    lastHanded = firstHeld->Blink;
+
+    hold_messages(handleData, firstHeld, &held);
+    handleData->IoTHubTransport_DoWork(handleData->transportHandle, handleData);
+
+    if ((firstHeld != firstMessage) && (handleData->waitingToSend.Flink == firstMessage))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_168: [ If the underlying layer's _DoWork function takes none of the messages it is handed, IoTHubClient_LL_DoWork shall give their tokens back. ]*/
+        handleData->rateLimitMessageTokens = messageTokens;
+        handleData->rateLimitByteTokens = byteTokens;
+    }
+    if ((held.Flink != &held) && (handleData->waitingToSend.Blink != lastHanded) && (handleData->waitingToSend.Blink != &(handleData->waitingToSend)))
+    {
+        /*messages were queued while the transport worked, ahead of the held ones that time out before them*/
+        handleData->waitingToSendOrderedByTimeout = false;
+    }
+    release_held_messages(handleData, &held);
+}
+
+/*the transport is asked for its deadline seeing the messages DoWork would hand it*/
+static uint32_t get_rate_limited_transport_deadline(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, tickcounter_ms_t nowTick, bool* isWaitingForNetwork)
+{
+    uint32_t result;
+    uint32_t waitMs;
+    DLIST_ENTRY held;
+
+    refill_rate_limit_tokens(handleData, nowTick);
+    hold_messages(handleData, find_rate_limited_message(handleData, false, &waitMs), &held);
+    result = (handleData->IoTHubTransport_GetNextWorkDeadline == NULL) ? 0 :
+        handleData->IoTHubTransport_GetNextWorkDeadline(handleData->transportHandle, isWaitingForNetwork);
+    if ((held.Flink != &held) && (waitMs < result))
+    {
+        result = waitMs;
+    }
+    release_held_messages(handleData, &held);
+    return result;
+}
+
+/*the hub throttles with failed sends, the rates in use back off multiplicatively and recover additively*/
+static void slow_down_rate_limit(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    tickcounter_ms_t nowTick;
+    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        LogErrorLimited("unable to get the current ms, the rate limit is not lowered");
+    }
+    else if ((handleData->rateLimitScale < RATE_LIMIT_FULL_SCALE) && (nowTick - handleData->rateLimitSlowedAt < RATE_LIMIT_SLOWDOWN_INTERVAL_MS))
+    {
+        /*a failure of the burst that lowered it already*/
+    }
+    else
+    {
+        refill_rate_limit_tokens(handleData, nowTick);
+        handleData->rateLimitSlowedAt = nowTick;
+        handleData->rateLimitScale = (handleData->rateLimitScale / 2 < RATE_LIMIT_MIN_SCALE) ? RATE_LIMIT_MIN_SCALE : handleData->rateLimitScale / 2;
+        if (handleData->rateLimit.messagesPerSecond != 0)
+        {
+            handleData->rateLimitMessageTokens = refill_bucket(handleData->rateLimitMessageTokens, get_scaled_rate(handleData, handleData->rateLimit.messagesPerSecond), 0);
+        }
+        if (handleData->rateLimit.bytesPerSecond != 0)
+        {
+            handleData->rateLimitByteTokens = refill_bucket(handleData->rateLimitByteTokens, get_scaled_rate(handleData, handleData->rateLimit.bytesPerSecond), 0);
+        }
+    }
+}
+
+static IOTHUB_CLIENT_RESULT set_rate_limit(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const IOTHUB_CLIENT_RATE_LIMIT* rateLimit)
+{
+    IOTHUB_CLIENT_RESULT result;
+    tickcounter_ms_t nowTick;
+    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_165: [ If the current time cannot be read, IoTHubClient_LL_SetOption shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("unable to get the current ms");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_164: [ If optionName is OPTION_RATE_LIMIT, IoTHubClient_LL_SetOption shall set the rate limit to the IOTHUB_CLIENT_RATE_LIMIT pointed to by value, both rates 0 to remove it, with token buckets holding one second of it, and return IOTHUB_CLIENT_OK. ]*/
+        handleData->rateLimit = *rateLimit;
+        handleData->rateLimitScale = RATE_LIMIT_FULL_SCALE;
+        handleData->rateLimitMessageTokens = (uint64_t)rateLimit->messagesPerSecond * RATE_LIMIT_TOKEN;
+        handleData->rateLimitByteTokens = (uint64_t)rateLimit->bytesPerSecond * RATE_LIMIT_TOKEN;
+        handleData->rateLimitRefilledAt = nowTick;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_020: [If parameter iotHubClientHandle is NULL then IoTHubClient_LL_DoWork shall not perform any action.] */
+    if (iotHubClientHandle != NULL)
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        DoTimeouts(handleData);
+        if (handleData->outbox != NULL)
+        {
+            load_outbox_messages(handleData);
+        }
+
+#ifndef DONT_USE_DEVICE_TWIN
+        process_device_twin_items(handleData);
+#endif
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.]*/
+        if (is_rate_limited(handleData))
+        {
+            do_rate_limited_transport_work(handleData);
+        }
+        else
+        {
+            handleData->IoTHubTransport_DoWork(handleData->transportHandle, iotHubClientHandle);
+        }
+
+        if (handleData->idleTrimTimeMs != 0)
+        {
+            trim_memory_when_idle(handleData);
+        }
+    }
+}
+
+/*milliseconds from nowTick until the tick at which the client work is due, the deadlines in the past are due now*/
+static uint32_t ms_until(tickcounter_ms_t dueTick, tickcounter_ms_t nowTick)
+{
+    uint32_t result;
+    if (dueTick <= nowTick)
+    {
+        result = 0;
+    }
+    else if (dueTick - nowTick >= IOTHUB_CLIENT_NO_WORK_DEADLINE)
+    {
+        result = IOTHUB_CLIENT_NO_WORK_DEADLINE - 1;
+    }
+    else
+    {
+        result = (uint32_t)(dueTick - nowTick);
+    }
+    return result;
+}
+
+static bool is_outbox_ready(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    return (handleData->outboxRewindPending && (handleData->outboxInFlight == 0)) ||
+        (!handleData->outboxRewindPending &&
+        (handleData->outboxReadSequence - handleData->outboxReleasedSequence < handleData->outboxMaxInFlight) &&
+        (outbox_get_unread_count(handleData->outbox) != 0));
+}
+
+uint32_t IoTHubClient_LL_GetNextWorkDeadlineMs(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
-    IOTHUB_CLIENT_RESULT result;
+    uint32_t result;
+    tickcounter_ms_t nowTick;
     if (iotHubClientHandle == NULL)
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_10_021: [IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
-        LogError("Invalid argument - iotHubClientHandle is NULL");
-        result = IOTHUB_CLIENT_INVALID_ARG;
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_107: [ If iotHubClientHandle is NULL, IoTHubClient_LL_GetNextWorkDeadlineMs shall return 0. ]*/
+        LogError("invalid arg");
+        result = 0;
+    }
+    else if (tickcounter_get_current_ms(iotHubClientHandle->tickCounter, &nowTick) != 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_108: [ If the current time cannot be read, IoTHubClient_LL_GetNextWorkDeadlineMs shall return 0. ]*/
+        LogErrorLimited("unable to get the current ms");
+        result = 0;
     }
     else
     {
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
-        if (messageCallback == NULL)
+        bool isWaitingForNetwork;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_109: [ IoTHubClient_LL_GetNextWorkDeadlineMs shall start from the deadline of the underlying layer's _GetNextWorkDeadline function, or 0 if the transport has none. ]*/
+        if (is_rate_limited(handleData))
         {
-            if (handleData->messageCallback.type == CALLBACK_TYPE_NONE)
-            {
-                /*Codes_SRS_IOTHUBCLIENT_LL_10_018: [If parameter messageCallback is NULL and IoTHubClient_LL_SetMessageCallback_Ex had not been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
-                LogError("not currently set to accept or process incoming messages.");
-                result = IOTHUB_CLIENT_ERROR;
-            }
-            else if (handleData->messageCallback.type == CALLBACK_TYPE_SYNC)
-            {
-                /*Codes_SRS_IOTHUBCLIENT_LL_10_019: [If parameter messageCallback is NULL and IoTHubClient_LL_SetMessageCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
-                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_SetMessageCallback function.");
-                result = IOTHUB_CLIENT_ERROR;
-            }
-            else
-            {
-                /*Codes_SRS_IOTHUBCLIENT_LL_10_023: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */ 
-                handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
-                handleData->messageCallback.type = CALLBACK_TYPE_NONE;
-                handleData->messageCallback.callbackSync = NULL;
-                handleData->messageCallback.callbackAsync = NULL;
-                handleData->messageCallback.userContextCallback = NULL;
-                result = IOTHUB_CLIENT_OK;
-            }
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_169: [ While the rate limit is set, the underlying layer's _GetNextWorkDeadline function shall only see the messages IoTHubClient_LL_DoWork would hand it, and the deadline shall be no later than the time the next of the others has its tokens. ]*/
+            result = get_rate_limited_transport_deadline(handleData, nowTick, &isWaitingForNetwork);
         }
         else
         {
-            if (handleData->messageCallback.type == CALLBACK_TYPE_SYNC)
+            result = (handleData->IoTHubTransport_GetNextWorkDeadline == NULL) ? 0 :
+                handleData->IoTHubTransport_GetNextWorkDeadline(handleData->transportHandle, &isWaitingForNetwork);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_110: [ IoTHubClient_LL_GetNextWorkDeadlineMs shall return 0 while the outbox has messages to move to waitingToSend or iot_msg_queue has reported states the twin window lets through. ]*/
+        if ((handleData->outbox != NULL) && is_outbox_ready(handleData))
+        {
+            result = 0;
+        }
+#ifndef DONT_USE_DEVICE_TWIN
+        else if (!DList_IsListEmpty(&handleData->iot_msg_queue) &&
+            ((handleData->twinMaxInFlight == 0) || (handleData->twinInFlight < handleData->twinMaxInFlight)))
+        {
+            result = 0;
+        }
+#endif
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_111: [ The deadline shall be no later than the earliest timeout of the messages in waitingToSend, after which they time out. ]*/
+        if ((result != 0) && (handleData->nextMessageTimeout != 0))
+        {
+            uint32_t messageTimeout = ms_until(handleData->nextMessageTimeout + 1, nowTick);
+            if (messageTimeout < result)
             {
-                /*Codes_SRS_IOTHUBCLIENT_LL_10_020: [If parameter messageCallback is non-NULL, and IoTHubClient_LL_SetMessageCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
-                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClient_LL_MessageCallbackEx function before subscribing with MessageCallback.");
-                result = IOTHUB_CLIENT_ERROR;
+                result = messageTimeout;
             }
-            else
+        }
+
+#ifndef DONT_USE_DEVICE_TWIN
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_112: [ While ackTimeoutInSeconds is not 0, the deadline shall be no later than the earliest timeout of the reported states waiting for their acknowledgement. ]*/
+        if ((result != 0) && (handleData->twinAckTimeoutMs != 0))
+        {
+            DLIST_ENTRY* client_item = handleData->iot_ack_queue.Flink;
+            while (client_item != &(handleData->iot_ack_queue))
             {
-                if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_10_024: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Subscribe function.]*/
-                    handleData->messageCallback.type = CALLBACK_TYPE_ASYNC;
-                    handleData->messageCallback.callbackAsync = messageCallback;
-                    handleData->messageCallback.userContextCallback = userContextCallback;
-                    result = IOTHUB_CLIENT_OK;
-                }
-                else
+                IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
+                if (queue_data->ms_timesOutAfter != 0)
                 {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_10_025: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback_Ex shall succeed and return IOTHUB_CLIENT_OK.] */
-                    LogError("IoTHubTransport_Subscribe failed");
-                    handleData->messageCallback.type = CALLBACK_TYPE_NONE;
-                    handleData->messageCallback.callbackSync = NULL;
-                    handleData->messageCallback.callbackAsync = NULL;
-                    handleData->messageCallback.userContextCallback = NULL;
-                    result = IOTHUB_CLIENT_ERROR;
+                    uint32_t ackTimeout = ms_until(queue_data->ms_timesOutAfter, nowTick);
+                    if (ackTimeout < result)
+                    {
+                        result = ackTimeout;
+                    }
                 }
+                client_item = client_item->Flink;
+            }
+        }
+#endif
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_141: [ While idle_trim_time is not 0, the deadline shall be no later than the time at which the idle client trims its memory. ]*/
+        if ((result != 0) && (handleData->idleTrimTimeMs != 0) && handleData->isIdle && !handleData->isIdleTrimmed)
+        {
+            uint32_t trimTimeout = ms_until(handleData->idleSince + handleData->idleTrimTimeMs, nowTick);
+            if (trimTimeout < result)
+            {
+                result = trimTimeout;
             }
         }
     }
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendMessageDisposition(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, MESSAGE_CALLBACK_INFO* message_data, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+bool IoTHubClient_LL_IsWaitingForNetwork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
-    IOTHUB_CLIENT_RESULT result;
-    if ((iotHubClientHandle == NULL) || (message_data == NULL))
+    bool result;
+    if (iotHubClientHandle == NULL)
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_10_026: [IoTHubClient_LL_SendMessageDisposition shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
-        LogError("Invalid argument handle=%p, message=%p", iotHubClientHandle, message_data);
-        result = IOTHUB_CLIENT_INVALID_ARG;
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_113: [ If iotHubClientHandle is NULL, IoTHubClient_LL_IsWaitingForNetwork shall return false. ]*/
+        LogError("invalid arg");
+        result = false;
+    }
+    else if (iotHubClientHandle->IoTHubTransport_GetNextWorkDeadline == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_114: [ If the transport has no _GetNextWorkDeadline function, IoTHubClient_LL_IsWaitingForNetwork shall return true. ]*/
+        result = true;
     }
     else
     {
-        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
-        /*Codes_SRS_IOTHUBCLIENT_LL_10_027: [IoTHubClient_LL_SendMessageDisposition shall return the result from calling the underlying layer's _Send_Message_Disposition.]*/
-        result = handleData->IoTHubTransport_SendMessageDisposition(message_data, disposition);
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_115: [ Otherwise IoTHubClient_LL_IsWaitingForNetwork shall return what the underlying layer's _GetNextWorkDeadline function reports in isWaitingForNetwork. ]*/
+        result = false;
+        (void)iotHubClientHandle->IoTHubTransport_GetNextWorkDeadline(iotHubClientHandle->transportHandle, &result);
     }
     return result;
 }
 
-static void DoTimeouts(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetPollDescriptors(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_POLL_DESCRIPTOR* descriptors, size_t* descriptorCount)
 {
-    tickcounter_ms_t nowTick;
-    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    IOTHUB_CLIENT_RESULT result;
+    if ((iotHubClientHandle == NULL) || (descriptorCount == NULL) || ((descriptors == NULL) && (*descriptorCount != 0)))
     {
-        LogError("unable to get the current ms, timeouts will not be processed");
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_116: [ If iotHubClientHandle or descriptorCount is NULL, or descriptors is NULL while descriptorCount is not 0, IoTHubClient_LL_GetPollDescriptors shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
     }
     else
     {
-        DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
-        while (currentItemInWaitingToSend != &(handleData->waitingToSend)) /*while we are not at the end of the list*/
-        {
-            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-            if ((fullEntry->ms_timesOutAfter != 0) && (fullEntry->ms_timesOutAfter < nowTick))
-            {
-                PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
-                DList_RemoveEntryList(currentItemInWaitingToSend);
-                if (fullEntry->callback != NULL)
-                {
-                    fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
-                }
-                IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
-                free(fullEntry);
-                currentItemInWaitingToSend = theNext;
-            }
-            else
-            {
-                currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
-            }
-        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_117: [ IoTHubClient_LL_GetPollDescriptors shall set descriptorCount to the number of sockets the underlying layer's _GetPollDescriptors function wrote, 0 if the transport has none, and return IOTHUB_CLIENT_OK. ]*/
+        *descriptorCount = (iotHubClientHandle->IoTHubTransport_GetPollDescriptors == NULL) ? 0 :
+            iotHubClientHandle->IoTHubTransport_GetPollDescriptors(iotHubClientHandle->transportHandle, descriptors, *descriptorCount);
+        result = IOTHUB_CLIENT_OK;
     }
+    return result;
 }
 
-void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+/*the xio of the transport reads and writes what its socket is ready for in its DoWork, while the timers are checked*/
+void IoTHubClient_LL_OnReadable(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_020: [If parameter iotHubClientHandle is NULL then IoTHubClient_LL_DoWork shall not perform any action.] */
-    if (iotHubClientHandle != NULL)
-    {
-        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
-        DoTimeouts(handleData);
-
-        /*Codes_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClient_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
-        DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
-        while (client_item != &(handleData->iot_msg_queue)) /*while we are not at the end of the list*/
-        {
-            PDLIST_ENTRY next_item = client_item->Flink;
-
-            IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
-            IOTHUB_IDENTITY_INFO identity_info;
-            identity_info.device_twin = queue_data;
-            IOTHUB_PROCESS_ITEM_RESULT process_results =  handleData->IoTHubTransport_ProcessItem(handleData->transportHandle, IOTHUB_TYPE_DEVICE_TWIN, &identity_info);
-            if (process_results == IOTHUB_PROCESS_CONTINUE || process_results == IOTHUB_PROCESS_NOT_CONNECTED)
-            {
-                /*Codes_SRS_IOTHUBCLIENT_LL_07_010: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_CONTINUE or IOTHUB_PROCESS_NOT_CONNECTED IoTHubClient_LL_DoWork shall continue on to call the underlaying layer's _DoWork function. ]*/
-                break;
-            }
-            else 
-            {
-                DList_RemoveEntryList(client_item);
-                if (process_results == IOTHUB_PROCESS_OK)
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_07_011: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_OK IoTHubClient_LL_DoWork shall add the IOTHUB_DEVICE_TWIN to the ack queue. ]*/
-                    DList_InsertTailList(&(iotHubClientHandle->iot_ack_queue), &(queue_data->entry));
-                }
-                else
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_07_012: [ If 'IoTHubTransport_ProcessItem' returns any other value IoTHubClient_LL_DoWork shall destroy the IOTHUB_DEVICE_TWIN item. ]*/
-                    LogError("Failure queue processing item");
-                    device_twin_data_destroy(queue_data);
-                }
-            }
-            // Move along to the next item
-            client_item = next_item;
-        }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_118: [ IoTHubClient_LL_OnReadable and IoTHubClient_LL_OnWritable shall do the work of IoTHubClient_LL_DoWork. ]*/
+    IoTHubClient_LL_DoWork(iotHubClientHandle);
+}
 
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.]*/
-        handleData->IoTHubTransport_DoWork(handleData->transportHandle, iotHubClientHandle);
-    }
+void IoTHubClient_LL_OnWritable(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_118: [ IoTHubClient_LL_OnReadable and IoTHubClient_LL_OnWritable shall do the work of IoTHubClient_LL_DoWork. ]*/
+    IoTHubClient_LL_DoWork(iotHubClientHandle);
 }
 
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
@@ -1166,6 +3420,11 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHu
         /* Codes_SRS_IOTHUBCLIENT_09_008: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there is currently no items to be sent] */
         /* Codes_SRS_IOTHUBCLIENT_09_009: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently items to be sent] */
         result = handleData->IoTHubTransport_GetSendStatus(handleData->deviceHandle, iotHubClientStatus);
+        if ((result == IOTHUB_CLIENT_OK) && (handleData->outbox != NULL) && (outbox_get_unread_count(handleData->outbox) != 0))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_040: [ IoTHubClient_LL_GetSendStatus shall report IOTHUB_CLIENT_SEND_STATUS_BUSY while the outbox has messages not moved to waitingToSend yet. ]*/
+            *iotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        }
     }
 
     return result;
@@ -1187,16 +3446,68 @@ void IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY c
         /*Codes_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_ERROR then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.] */
         /*Codes_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
         PDLIST_ENTRY oldest;
+        if ((result == IOTHUB_CLIENT_CONFIRMATION_ERROR) && is_rate_limited(handle) && (completed->Flink != completed))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_170: [ While the rate limit is set, if result is IOTHUB_CLIENT_CONFIRMATION_ERROR, IoTHubClient_LL_SendComplete shall halve the rates in use, no more than once a second and down to a sixteenth of the rate limit. ]*/
+            slow_down_rate_limit(handle);
+        }
         while ((oldest = DList_RemoveHeadList(completed)) != completed)
         {
             IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
+            if ((messageList->callback == on_send_queue_message_complete) && messageList->countedInStatistics)
+            {
+                handle->statisticsCompletedByTransport++;
+            }
+            if (messageList->traced && (result == IOTHUB_CLIENT_CONFIRMATION_OK))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_067: [ If result is IOTHUB_CLIENT_CONFIRMATION_OK, IoTHubClient_LL_SendComplete shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_ACKED for the traced messages before calling their callback. ]*/
+                IoTHubClient_LL_TraceMessage(messageList, IOTHUB_MESSAGE_TRACE_STAGE_ACKED);
+            }
             /*Codes_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
             if (messageList->callback != NULL)
             {
                 messageList->callback(result, messageList->context);
             }
             IoTHubMessage_Destroy(messageList->messageHandle);
-            free(messageList);
+            message_list_pool_release(handle, messageList);
+        }
+    }
+}
+
+void IoTHubClient_LL_TraceMessage(IOTHUB_MESSAGE_LIST* message, IOTHUB_MESSAGE_TRACE_STAGE stage)
+{
+    tickcounter_ms_t nowTick;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_068: [ If message is NULL or not traced, IoTHubClient_LL_TraceMessage shall return. ]*/
+    if ((message == NULL) || !message->traced)
+    {
+        LogError("invalid argument message(%p)", message);
+    }
+    else if (tickcounter_get_current_ms(message->owner->tickCounter, &nowTick) != 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_069: [ If getting the current ms fails, IoTHubClient_LL_TraceMessage shall leave the timestamps of the message as they are and not call the trace callback. ]*/
+        LogError("unable to get the current ms, the stage %d of the message is not traced", (int)stage);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_070: [ IoTHubClient_LL_TraceMessage shall set the timestamp of stage in the IOTHUB_CLIENT_MESSAGE_TIMESTAMPS of the message to the current ms and call the trace callback, if one is set, with the message handle, stage and the current ms. ]*/
+        switch (stage)
+        {
+            case IOTHUB_MESSAGE_TRACE_STAGE_ENQUEUED:
+                message->timestamps.enqueued = nowTick;
+                break;
+            case IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT:
+                message->timestamps.handedToTransport = nowTick;
+                break;
+            case IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN:
+                message->timestamps.written = nowTick;
+                break;
+            default:
+                message->timestamps.acked = nowTick;
+                break;
+        }
+        if (message->owner->traceCallback != NULL)
+        {
+            message->owner->traceCallback(message->messageHandle, stage, nowTick, message->owner->traceContext);
         }
     }
 }
@@ -1204,6 +3515,15 @@ void IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY c
 int IoTHubClient_LL_DeviceMethodComplete(IOTHUB_CLIENT_LL_HANDLE handle, const char* method_name, const unsigned char* payLoad, size_t size, METHOD_HANDLE response_id)
 {
     int result;
+#ifdef DONT_USE_DEVICE_METHODS
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_143: [ Built with DONT_USE_DEVICE_METHODS, IoTHubClient_LL_DeviceMethodComplete shall return as if deviceMethodCallback was NULL. ]*/
+    (void)handle;
+    (void)method_name;
+    (void)payLoad;
+    (void)size;
+    (void)response_id;
+    result = 0;
+#else
     if (handle == NULL)
     {
         /* Codes_SRS_IOTHUBCLIENT_LL_07_017: [ If handle or response is NULL then IoTHubClient_LL_DeviceMethodComplete shall return 500. ] */
@@ -1245,11 +3565,19 @@ int IoTHubClient_LL_DeviceMethodComplete(IOTHUB_CLIENT_LL_HANDLE handle, const c
                 break;
         }
     }
+#endif /*DONT_USE_DEVICE_METHODS*/
     return result;
 }
 
 void IoTHubClient_LL_RetrievePropertyComplete(IOTHUB_CLIENT_LL_HANDLE handle, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size)
 {
+#ifdef DONT_USE_DEVICE_TWIN
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_142: [ Built with DONT_USE_DEVICE_TWIN, IoTHubClient_LL_ReportedStateComplete and IoTHubClient_LL_RetrievePropertyComplete shall do nothing. ]*/
+    (void)handle;
+    (void)update_state;
+    (void)payLoad;
+    (void)size;
+#else
     if (handle == NULL)
     {
         /* Codes_SRS_IOTHUBCLIENT_LL_07_013: [ If handle is NULL then IoTHubClient_LL_RetrievePropertyComplete shall do nothing.] */
@@ -1266,17 +3594,45 @@ void IoTHubClient_LL_RetrievePropertyComplete(IOTHUB_CLIENT_LL_HANDLE handle, DE
             {
                 handleData->complete_twin_update_encountered = true;
             }
-            if (handleData->complete_twin_update_encountered)
+            if (!handleData->complete_twin_update_encountered)
+            {
+                /*the patches received before the first complete document are dropped*/
+            }
+            else if (handleData->twinCache == NULL)
             {
                 /* Codes_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClient_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
                 handleData->deviceTwinCallback(update_state, payLoad, size, handleData->deviceTwinContextCallback);
             }
+            else
+            {
+                char* patch = NULL;
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_146: [ While the twin cache is enabled, IoTHubClient_LL_RetrievePropertyComplete shall give the document to twin_cache_update and call deviceTwinCallback with it if the result is TWIN_CACHE_DELIVER, with DEVICE_TWIN_UPDATE_PARTIAL and the patch if it is TWIN_CACHE_DELIVER_PATCH and not at all if it is TWIN_CACHE_SKIP. ]*/
+                switch (twin_cache_update(handleData->twinCache, update_state, payLoad, size, &patch))
+                {
+                    case TWIN_CACHE_DELIVER_PATCH:
+                        handleData->deviceTwinCallback(DEVICE_TWIN_UPDATE_PARTIAL, (const unsigned char*)patch, strlen(patch), handleData->deviceTwinContextCallback);
+                        twin_cache_free_patch(patch);
+                        break;
+                    case TWIN_CACHE_SKIP:
+                        break;
+                    default:
+                        handleData->deviceTwinCallback(update_state, payLoad, size, handleData->deviceTwinContextCallback);
+                        break;
+                }
+            }
         }
     }
+#endif /*DONT_USE_DEVICE_TWIN*/
 }
 
 void IoTHubClient_LL_ReportedStateComplete(IOTHUB_CLIENT_LL_HANDLE handle, uint32_t item_id, int status_code)
 {
+#ifdef DONT_USE_DEVICE_TWIN
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_142: [ Built with DONT_USE_DEVICE_TWIN, IoTHubClient_LL_ReportedStateComplete and IoTHubClient_LL_RetrievePropertyComplete shall do nothing. ]*/
+    (void)handle;
+    (void)item_id;
+    (void)status_code;
+#else
     /* Codes_SRS_IOTHUBCLIENT_LL_07_002: [ if handle or queue_handle are NULL then IoTHubClient_LL_ReportedStateComplete shall do nothing. ] */
     if (handle == NULL)
     {
@@ -1295,79 +3651,194 @@ void IoTHubClient_LL_ReportedStateComplete(IOTHUB_CLIENT_LL_HANDLE handle, uint3
             IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
             if (queue_data->item_id == item_id)
             {
-                if (queue_data->reported_state_callback != NULL)
-                {
-                    queue_data->reported_state_callback(status_code, queue_data->context);
-                }
+                device_twin_data_complete(queue_data, status_code);
                 /*Codes_SRS_IOTHUBCLIENT_LL_07_009: [ IoTHubClient_LL_ReportedStateComplete shall remove the IOTHUB_DEVICE_TWIN item from the ack queue.]*/
                 DList_RemoveEntryList(client_item);
                 device_twin_data_destroy(queue_data);
+                handleData->twinInFlight--;
                 break;
             }
-            client_item = next_item;
+            client_item = next_item;
+        }
+    }
+#endif /*DONT_USE_DEVICE_TWIN*/
+}
+
+static IOTHUBMESSAGE_DISPOSITION_RESULT deliver_message_chunks(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE messageHandle, const unsigned char* payload, size_t size)
+{
+    IOTHUBMESSAGE_DISPOSITION_RESULT result;
+    size_t offset = 0;
+    do
+    {
+        size_t chunk = size - offset;
+        if (chunk > handleData->messageCallback.chunkSize)
+        {
+            chunk = handleData->messageCallback.chunkSize;
+        }
+        result = handleData->messageCallback.callbackChunked(messageHandle, payload + offset, chunk, offset, offset + chunk == size, handleData->messageCallback.userContextCallback);
+        offset += chunk;
+    } while ((offset < size) && (result == IOTHUBMESSAGE_ACCEPTED));
+    return result;
+}
+
+static bool message_chunks_callback(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, MESSAGE_CALLBACK_INFO* messageData, const unsigned char* payload, size_t size)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_127: [ The body shall be given to messageChunkCallback in order, in chunks of at most chunkSize bytes, with isLast true for the last one and once with size 0 for an empty body, until messageChunkCallback returns anything but IOTHUBMESSAGE_ACCEPTED. ]*/
+    IOTHUBMESSAGE_DISPOSITION_RESULT cb_result = deliver_message_chunks(handleData, messageData->messageHandle, payload, size);
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_128: [ The last result of messageChunkCallback shall be sent as the message disposition to the underlying layer and true returned. ]*/
+    if (send_message_disposition(handleData, messageData, cb_result) != IOTHUB_CLIENT_OK)
+    {
+        LogError("IoTHubTransport_SendMessageDisposition failed");
+    }
+    return true;
+}
+
+bool IoTHubClient_LL_MessageCallback(IOTHUB_CLIENT_LL_HANDLE handle, MESSAGE_CALLBACK_INFO* messageData)
+{
+    bool result;
+    if ((handle == NULL) || messageData == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
+        LogError("invalid argument: handle(%p), messageData(%p)", handle, messageData);
+        result = false;
+    }
+    else if (messageData->messageHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_004: [If messageHandle field of paramger messageData is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
+        LogError("invalid argument messageData->messageHandle(NULL)");
+        result = false;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)handle;
+
+        /* Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
+        handleData->lastMessageReceiveTime = get_time(NULL);
+        if (is_duplicate_message(handleData, messageData))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_155: [ While OPTION_C2D_DUPLICATE_FILTER is set, if duplicate_filter_contains returns true for the message id of messageHandle, IoTHubClient_LL_MessageCallback shall send IOTHUBMESSAGE_ACCEPTED as the message disposition to the underlying layer without calling the message callback and return true. ]*/
+            if (handleData->IoTHubTransport_SendMessageDisposition(messageData, IOTHUBMESSAGE_ACCEPTED) != IOTHUB_CLIENT_OK)
+            {
+                LogError("IoTHubTransport_SendMessageDisposition failed");
+            }
+            result = true;
+        }
+        else
+        {
+            switch (handleData->messageCallback.type)
+            {
+                case CALLBACK_TYPE_NONE:
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_032: [If the client is not subscribed to receive messages then IoTHubClient_LL_MessageCallback shall return false.] */
+                    LogError("Invalid workflow - not currently set up to accept messages");
+                    result = false;
+                    break;
+                }
+                case CALLBACK_TYPE_SYNC:
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_030: [If messageCallbackType is LEGACY then IoTHubClient_LL_MessageCallback shall invoke the last callback function (the parameter messageCallback to IoTHubClient_LL_SetMessageCallback) passing the message and the passed userContextCallback.]*/
+                    IOTHUBMESSAGE_DISPOSITION_RESULT cb_result = handleData->messageCallback.callbackSync(messageData->messageHandle, handleData->messageCallback.userContextCallback);
+
+                    /*Codes_SRS_IOTHUBCLIENT_LL_10_007: [If messageCallbackType is LEGACY then IoTHubClient_LL_MessageCallback shall send the message disposition as returned by the client to the underlying layer.] */
+                    if (send_message_disposition(handleData, messageData, cb_result) != IOTHUB_CLIENT_OK)
+                    {
+                        LogError("IoTHubTransport_SendMessageDisposition failed");
+                    }
+                    result = true;
+                    break;
+                }
+                case CALLBACK_TYPE_ASYNC:
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_LL_10_009: [If messageCallbackType is ASYNC then IoTHubClient_LL_MessageCallback shall return what messageCallbacEx returns.] */
+                    result = handleData->messageCallback.callbackAsync(messageData, handleData->messageCallback.userContextCallback);
+                    if (!result)
+                    {
+                        LogError("messageCallbackEx failed");
+                    }
+                    break;
+                }
+                case CALLBACK_TYPE_CHUNKED:
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_126: [ If messageChunkCallback is set, IoTHubClient_LL_MessageCallback shall give it the body of messageHandle in chunks. ]*/
+                    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(messageData->messageHandle);
+                    const unsigned char* payload;
+                    size_t size;
+                    if (contentType == IOTHUBMESSAGE_STRING)
+                    {
+                        payload = (const unsigned char*)IoTHubMessage_GetString(messageData->messageHandle);
+                        size = (payload == NULL) ? 0 : strlen((const char*)payload);
+                    }
+                    else if ((contentType != IOTHUBMESSAGE_BYTEARRAY) || (IoTHubMessage_GetByteArray(messageData->messageHandle, &payload, &size) != IOTHUB_MESSAGE_OK))
+                    {
+                        payload = NULL;
+                        size = 0;
+                    }
+                    result = message_chunks_callback(handleData, messageData, payload, size);
+                    break;
+                }
+                default:
+                {
+                    LogError("Invalid state");
+                    result = false;
+                    break;
+                }
+            }
         }
     }
+    return result;
 }
 
-bool IoTHubClient_LL_MessageCallback(IOTHUB_CLIENT_LL_HANDLE handle, MESSAGE_CALLBACK_INFO* messageData)
+size_t IoTHubClient_LL_GetMessageChunkSize(IOTHUB_CLIENT_LL_HANDLE handle)
 {
-    bool result;
-    if ((handle == NULL) || messageData == NULL)
+    size_t result;
+    if (handle == NULL)
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
-        LogError("invalid argument: handle(%p), messageData(%p)", handle, messageData);
-        result = false;
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_129: [ If handle is NULL or the messages are not received in chunks, IoTHubClient_LL_GetMessageChunkSize shall return 0. ]*/
+        LogError("Invalid argument handle=%p", handle);
+        result = 0;
     }
-    else if (messageData->messageHandle == NULL)
+    else
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_10_004: [If messageHandle field of paramger messageData is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
-        LogError("invalid argument messageData->messageHandle(NULL)");
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)handle;
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_130: [ Otherwise IoTHubClient_LL_GetMessageChunkSize shall return the chunkSize given to IoTHubClient_LL_SetMessageChunkCallback. ]*/
+        result = (handleData->messageCallback.type == CALLBACK_TYPE_CHUNKED) ? handleData->messageCallback.chunkSize : 0;
+    }
+    return result;
+}
+
+bool IoTHubClient_LL_MessageChunksCallback(IOTHUB_CLIENT_LL_HANDLE handle, MESSAGE_CALLBACK_INFO* messageData, const unsigned char* payload, size_t size)
+{
+    bool result;
+    if ((handle == NULL) || (messageData == NULL) || (messageData->messageHandle == NULL) || ((payload == NULL) && (size != 0)))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_131: [ If handle, messageData or its messageHandle is NULL, or payload is NULL and size is not 0, IoTHubClient_LL_MessageChunksCallback shall return false. ]*/
+        LogError("invalid argument: handle(%p), messageData(%p), payload(%p)", handle, messageData, payload);
         result = false;
     }
     else
     {
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)handle;
-
-        /* Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
         handleData->lastMessageReceiveTime = get_time(NULL);
-        switch (handleData->messageCallback.type)
+        if (handleData->messageCallback.type != CALLBACK_TYPE_CHUNKED)
         {
-            case CALLBACK_TYPE_NONE:
-            {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_032: [If the client is not subscribed to receive messages then IoTHubClient_LL_MessageCallback shall return false.] */
-                LogError("Invalid workflow - not currently set up to accept messages");
-                result = false;
-                break;
-            }
-            case CALLBACK_TYPE_SYNC:
-            {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_030: [If messageCallbackType is LEGACY then IoTHubClient_LL_MessageCallback shall invoke the last callback function (the parameter messageCallback to IoTHubClient_LL_SetMessageCallback) passing the message and the passed userContextCallback.]*/
-                IOTHUBMESSAGE_DISPOSITION_RESULT cb_result = handleData->messageCallback.callbackSync(messageData->messageHandle, handleData->messageCallback.userContextCallback);
-
-                /*Codes_SRS_IOTHUBCLIENT_LL_10_007: [If messageCallbackType is LEGACY then IoTHubClient_LL_MessageCallback shall send the message disposition as returned by the client to the underlying layer.] */
-                if (handleData->IoTHubTransport_SendMessageDisposition(messageData, cb_result) != IOTHUB_CLIENT_OK)
-                {
-                    LogError("IoTHubTransport_SendMessageDisposition failed");
-                }
-                result = true;
-                break;
-            }
-            case CALLBACK_TYPE_ASYNC:
-            {
-                /* Codes_SRS_IOTHUBCLIENT_LL_10_009: [If messageCallbackType is ASYNC then IoTHubClient_LL_MessageCallback shall return what messageCallbacEx returns.] */
-                result = handleData->messageCallback.callbackAsync(messageData, handleData->messageCallback.userContextCallback);
-                if (!result)
-                {
-                    LogError("messageCallbackEx failed");
-                }
-                break;
-            }
-            default:
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_132: [ If the messages are not received in chunks, IoTHubClient_LL_MessageChunksCallback shall return false. ]*/
+            LogError("Invalid workflow - not currently set up to accept messages in chunks");
+            result = false;
+        }
+        else if (is_duplicate_message(handleData, messageData))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_158: [ While OPTION_C2D_DUPLICATE_FILTER is set, if duplicate_filter_contains returns true for the message id of messageHandle, IoTHubClient_LL_MessageChunksCallback shall send IOTHUBMESSAGE_ACCEPTED as the message disposition to the underlying layer without calling messageChunkCallback and return true. ]*/
+            if (handleData->IoTHubTransport_SendMessageDisposition(messageData, IOTHUBMESSAGE_ACCEPTED) != IOTHUB_CLIENT_OK)
             {
-                LogError("Invalid state");
-                result = false;
-                break;
+                LogError("IoTHubTransport_SendMessageDisposition failed");
             }
+            result = true;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_133: [ Otherwise IoTHubClient_LL_MessageChunksCallback shall give payload to messageChunkCallback in chunks, with the properties of messageHandle. ]*/
+            result = message_chunks_callback(handleData, messageData, payload, size);
         }
     }
     return result;
@@ -1385,6 +3856,41 @@ void IoTHubClient_LL_ConnectionStatusCallBack(IOTHUB_CLIENT_LL_HANDLE handle, IO
     {
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)handle;
 
+        if ((status == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED) && !handleData->statisticsConnected)
+        {
+            handleData->statisticsConnected = true;
+            if (handleData->statisticsDisconnectedAfterConnected)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_029: [ While the statistics are enabled, when the status becomes IOTHUB_CLIENT_CONNECTION_AUTHENTICATED after a disconnection, IoTHubClient_LL_ConnectionStatusCallBack shall increment reconnectCount and add the time spent disconnected to msDisconnected. ]*/
+                tickcounter_ms_t nowTick;
+                handleData->statisticsDisconnectedAfterConnected = false;
+                handleData->statistics.reconnectCount++;
+                if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+                {
+                    LogError("unable to get the current ms, the disconnection is not added to msDisconnected");
+                }
+                else
+                {
+                    handleData->statistics.msDisconnected += nowTick - handleData->statisticsDisconnectedSince;
+                }
+            }
+        }
+        else if ((status != IOTHUB_CLIENT_CONNECTION_AUTHENTICATED) && handleData->statisticsConnected)
+        {
+            handleData->statisticsConnected = false;
+            if (handleData->statisticsEnabled)
+            {
+                if (tickcounter_get_current_ms(handleData->tickCounter, &handleData->statisticsDisconnectedSince) != 0)
+                {
+                    LogError("unable to get the current ms, the disconnection is not counted");
+                }
+                else
+                {
+                    handleData->statisticsDisconnectedAfterConnected = true;
+                }
+            }
+        }
+
         /*Codes_SRS_IOTHUBCLIENT_LL_25_114: [IoTHubClient_LL_ConnectionStatusCallBack shall call non-callback set by the user from IoTHubClient_LL_SetConnectionStatusCallback passing the status, reason and the passed userContextCallback.]*/
         if (handleData->conStatusCallback != NULL)
         {
@@ -1394,6 +3900,20 @@ void IoTHubClient_LL_ConnectionStatusCallBack(IOTHUB_CLIENT_LL_HANDLE handle, IO
 
 }
 
+void IoTHubClient_LL_KeepAliveChanged(IOTHUB_CLIENT_LL_HANDLE handle, int keepAliveInterval)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_073: [ If handle is NULL, IoTHubClient_LL_KeepAliveChanged shall return. ]*/
+    if (handle == NULL)
+    {
+        LogError("invalid arg");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_074: [ IoTHubClient_LL_KeepAliveChanged shall store keepAliveInterval to be returned by IoTHubClient_LL_GetKeepAlive. ]*/
+        ((IOTHUB_CLIENT_LL_HANDLE_DATA*)handle)->keepAliveInterval = keepAliveInterval;
+    }
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetConnectionStatusCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connectionStatusCallback, void * userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1534,6 +4054,181 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetOption(IOTHUB_CLIENT_LL_HANDLE iotHubCli
             handleData->currentMessageTimeout = *(const tickcounter_ms_t*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(optionName, OPTION_SEND_QUEUE_LIMITS) == 0)
+        {
+            const IOTHUB_CLIENT_SEND_QUEUE_LIMITS* limits = (const IOTHUB_CLIENT_SEND_QUEUE_LIMITS*)value;
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_012: [ If optionName is OPTION_SEND_QUEUE_LIMITS and highWatermark is not 0 and lowWatermark is not lower than highWatermark, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+            if ((limits->highWatermark != 0) && (limits->lowWatermark >= limits->highWatermark))
+            {
+                LogError("invalid send queue watermarks low=%zu, high=%zu", limits->lowWatermark, limits->highWatermark);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_013: [ Otherwise IoTHubClient_LL_SetOption shall store the limits pointed to by value, which apply to the messages sent afterwards, and return IOTHUB_CLIENT_OK. ]*/
+                handleData->sendQueueLimits = *limits;
+                handleData->sendQueueLimitsEnabled =
+                    (limits->maxMessageCount != 0) ||
+                    (limits->maxByteCount != 0) ||
+                    ((limits->highWatermark != 0) && (limits->watermarkCallback != NULL));
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_RATE_LIMIT) == 0)
+        {
+            result = set_rate_limit(handleData, (const IOTHUB_CLIENT_RATE_LIMIT*)value);
+        }
+        else if (strcmp(optionName, OPTION_STATISTICS) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_030: [ If optionName is OPTION_STATISTICS, IoTHubClient_LL_SetOption shall enable or disable, as the bool pointed to by value says, the statistics of the messages sent afterwards and return IOTHUB_CLIENT_OK. ]*/
+            handleData->statisticsEnabled = *(const bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_OUTBOX) == 0)
+        {
+            result = set_outbox(handleData, (const IOTHUB_CLIENT_OUTBOX_CONFIG*)value);
+        }
+        else if (strcmp(optionName, OPTION_PRIORITY_WEIGHTS) == 0)
+        {
+            result = set_priority_weights(handleData, (const IOTHUB_CLIENT_PRIORITY_WEIGHTS*)value);
+        }
+#ifndef DONT_USE_DEVICE_TWIN
+        else if (strcmp(optionName, OPTION_COALESCE_REPORTED_STATE) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_046: [ If optionName is OPTION_COALESCE_REPORTED_STATE, IoTHubClient_LL_SetOption shall enable or disable, as the bool pointed to by value says, the coalescing of the reported states sent afterwards and return IOTHUB_CLIENT_OK. ]*/
+            handleData->coalesceReportedState = *(const bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_TWIN_WINDOW) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_050: [ If optionName is OPTION_TWIN_WINDOW, IoTHubClient_LL_SetOption shall store the IOTHUB_CLIENT_TWIN_WINDOW pointed to by value, a maxInFlight of 0 giving all the items of iot_msg_queue to the transport again, and return IOTHUB_CLIENT_OK. ]*/
+            const IOTHUB_CLIENT_TWIN_WINDOW* window = (const IOTHUB_CLIENT_TWIN_WINDOW*)value;
+            handleData->twinMaxInFlight = window->maxInFlight;
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_051: [ The items given to the transport afterwards shall time out after ackTimeoutInSeconds only while maxInFlight is not 0. ]*/
+            handleData->twinAckTimeoutMs = (window->maxInFlight == 0) ? 0 : (tickcounter_ms_t)window->ackTimeoutInSeconds * 1000;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_TWIN_CACHE) == 0)
+        {
+            result = set_twin_cache(handleData, (const IOTHUB_CLIENT_TWIN_CACHE_CONFIG*)value);
+        }
+#endif /*DONT_USE_DEVICE_TWIN*/
+        else if (strcmp(optionName, OPTION_COMPRESSION) == 0)
+        {
+            const IOTHUB_CLIENT_COMPRESSION* compression = (const IOTHUB_CLIENT_COMPRESSION*)value;
+            COMPRESSOR_HANDLE compressor = NULL;
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_055: [ If optionName is OPTION_COMPRESSION, IoTHubClient_LL_SetOption shall replace the compressor by one made by compressor_create with the level of the IOTHUB_CLIENT_COMPRESSION pointed to by value, a level of 0 disabling compression, store minimumSizeInBytes and return IOTHUB_CLIENT_OK. ]*/
+            if ((compression->level < 0) || (compression->level > 9))
+            {
+                LogError("invalid compression level %d", compression->level);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else if ((compression->level != 0) && ((compressor = compressor_create(compression->level)) == NULL))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_056: [ If compressor_create fails, IoTHubClient_LL_SetOption shall keep the previous compression settings and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("unable to create a compressor");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (handleData->compressor != NULL)
+                {
+                    compressor_destroy(handleData->compressor);
+                }
+                handleData->compressor = compressor;
+                handleData->compressionMinimumSize = compression->minimumSizeInBytes;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_MESSAGE_TRACE) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_065: [ If optionName is OPTION_MESSAGE_TRACE, IoTHubClient_LL_SetOption shall store the callback and context of the IOTHUB_CLIENT_MESSAGE_TRACE pointed to by value, a NULL callback stopping the tracing of the messages sent afterwards, and return IOTHUB_CLIENT_OK. ]*/
+            const IOTHUB_CLIENT_MESSAGE_TRACE* trace = (const IOTHUB_CLIENT_MESSAGE_TRACE*)value;
+            handleData->traceCallback = trace->callback;
+            handleData->traceContext = trace->context;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_MESSAGE_PIPELINE) == 0)
+        {
+            const IOTHUB_CLIENT_MESSAGE_PIPELINE* config = (const IOTHUB_CLIENT_MESSAGE_PIPELINE*)value;
+            MESSAGE_PIPELINE_HANDLE pipeline = NULL;
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_148: [ If optionName is OPTION_MESSAGE_PIPELINE, IoTHubClient_LL_SetOption shall replace the pipeline by one made by message_pipeline_create with the IOTHUB_CLIENT_MESSAGE_PIPELINE pointed to by value, no stages removing it, and return IOTHUB_CLIENT_OK. ]*/
+            if ((config->stageCount != 0) && ((pipeline = message_pipeline_create(config)) == NULL))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_149: [ If message_pipeline_create fails, IoTHubClient_LL_SetOption shall keep the previous pipeline and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("unable to create a message pipeline");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (handleData->pipeline != NULL)
+                {
+                    message_pipeline_destroy(handleData->pipeline);
+                }
+                handleData->pipeline = pipeline;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_C2D_DUPLICATE_FILTER) == 0)
+        {
+            const IOTHUB_CLIENT_DUPLICATE_FILTER* config = (const IOTHUB_CLIENT_DUPLICATE_FILTER*)value;
+            DUPLICATE_FILTER_HANDLE duplicateFilter = NULL;
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_153: [ If optionName is OPTION_C2D_DUPLICATE_FILTER, IoTHubClient_LL_SetOption shall replace the duplicate filter by one made by duplicate_filter_create with the capacity and window of the IOTHUB_CLIENT_DUPLICATE_FILTER pointed to by value, a capacity of 0 removing it, and return IOTHUB_CLIENT_OK. ]*/
+            if ((config->capacity != 0) && ((duplicateFilter = duplicate_filter_create(config->capacity, (tickcounter_ms_t)config->windowInSeconds * 1000)) == NULL))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_154: [ If duplicate_filter_create fails, IoTHubClient_LL_SetOption shall keep the previous duplicate filter and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("unable to create a duplicate filter");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (handleData->duplicateFilter != NULL)
+                {
+                    duplicate_filter_destroy(handleData->duplicateFilter);
+                }
+                handleData->duplicateFilter = duplicateFilter;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_MESSAGE_CHUNK_SIZE) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_159: [ If optionName is OPTION_MESSAGE_CHUNK_SIZE, IoTHubClient_LL_SetOption shall set the largest payload of the messages sent afterwards to the size_t pointed to by value, 0 sending them whole, and return IOTHUB_CLIENT_OK. ]*/
+            handleData->messageChunkSize = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_MESSAGE_POOL_SIZE) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_007: [ If optionName is OPTION_MESSAGE_POOL_SIZE, IoTHubClient_LL_SetOption shall set the maximum number of released IOTHUB_MESSAGE_LIST entries kept for reuse to the size_t pointed to by value and free the entries above it. ]*/
+            handleData->messageListPoolMaxCount = *(const size_t*)value;
+            message_list_pool_trim(handleData, handleData->messageListPoolMaxCount);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_IDLE_TRIM_TIME) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_139: [ If optionName is OPTION_IDLE_TRIM_TIME, IoTHubClient_LL_SetOption shall set the seconds without anything queued after which IoTHubClient_LL_DoWork trims the memory to the unsigned int pointed to by value, 0 to stop trimming it, and return IOTHUB_CLIENT_OK. ]*/
+            handleData->idleTrimTimeMs = (tickcounter_ms_t)(*(const unsigned int*)value) * 1000;
+            handleData->isIdle = false;
+            handleData->isIdleTrimmed = false;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_CRYPTO_PROVIDER) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_178: [ If optionName is OPTION_CRYPTO_PROVIDER, IoTHubClient_LL_SetOption shall give the IOTHUB_CRYPTO_PROVIDER pointed to by value to IoTHubClient_Auth_Set_Crypto_Provider and return IOTHUB_CLIENT_ERROR if it fails. ]*/
+            if (IoTHubClient_Auth_Set_Crypto_Provider(handleData->authorization_module, (const IOTHUB_CRYPTO_PROVIDER*)value) != 0)
+            {
+                LogError("unable to IoTHubClient_Auth_Set_Crypto_Provider");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_179: [ Otherwise IoTHubClient_LL_SetOption shall give value to the underlying layer's _SetOption function as OPTION_XIO_CRYPTO_PROVIDER, a failure being ignored, and return IOTHUB_CLIENT_OK. ]*/
+                if (handleData->IoTHubTransport_SetOption(handleData->transportHandle, OPTION_XIO_CRYPTO_PROVIDER, value) != IOTHUB_CLIENT_OK)
+                {
+                    LogInfo("the TLS adapter keeps its software crypto");
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else if (strcmp(optionName, OPTION_PRODUCT_INFO) == 0)
         {
             /*Codes_SRS_IOTHUBCLIENT_LL_10_033: [repeat calls with "product_info" will erase the previously set product information if applicatble. ]*/
@@ -1561,7 +4256,8 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetOption(IOTHUB_CLIENT_LL_HANDLE iotHubCli
             /*Codes_SRS_IOTHUBCLIENT_LL_02_099: [ IoTHubClient_LL_SetOption shall return according to the table below ]*/
             IOTHUB_CLIENT_RESULT uploadToBlob_result; 
 #ifndef DONT_USE_UPLOADTOBLOB
-            uploadToBlob_result = IoTHubClient_LL_UploadToBlob_SetOption(handleData->uploadToBlobHandle, optionName, value);
+            IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE uploadToBlobHandle = get_blob_upload_module(handleData);
+            uploadToBlob_result = (uploadToBlobHandle == NULL) ? IOTHUB_CLIENT_ERROR : IoTHubClient_LL_UploadToBlob_SetOption(uploadToBlobHandle, optionName, value);
             if(uploadToBlob_result == IOTHUB_CLIENT_ERROR)
             {
                 LogError("unable to IoTHubClient_LL_UploadToBlob_SetOption");
@@ -1615,6 +4311,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetOption(IOTHUB_CLIENT_LL_HANDLE iotHubCli
     return result;
 }
 
+#ifndef DONT_USE_DEVICE_TWIN
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceTwinCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1630,14 +4327,14 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceTwinCallback(IOTHUB_CLIENT_LL_HAND
         if (deviceTwinCallback == NULL)
         {
             /* Codes_SRS_IOTHUBCLIENT_LL_10_006: [ If deviceTwinCallback is NULL, then IoTHubClient_LL_SetDeviceTwinCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
-            handleData->IoTHubTransport_Unsubscribe_DeviceTwin(handleData->transportHandle);
+            handleData->IoTHubTransport_Unsubscribe_DeviceTwin(handleData->deviceHandle);
             handleData->deviceTwinCallback = NULL;
             result = IOTHUB_CLIENT_OK;
         }
         else
         {
             /* Codes_SRS_IOTHUBCLIENT_LL_10_002: [ If deviceTwinCallback is not NULL, then IoTHubClient_LL_SetDeviceTwinCallback shall call the underlying layer's _Subscribe function.] */
-            if (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->transportHandle) == 0)
+            if (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->deviceHandle) == 0)
             {
                 handleData->deviceTwinCallback = deviceTwinCallback;
                 handleData->deviceTwinContextCallback = userContextCallback;
@@ -1654,6 +4351,91 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceTwinCallback(IOTHUB_CLIENT_LL_HAND
     return result;
 }
 
+static void deliver_twin_chunks(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+{
+    IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)userContextCallback;
+    size_t offset = 0;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_136: [ The twin documents shall be given to deviceTwinChunkCallback in order, in chunks of at most chunkSize bytes pointing in the buffer of the transport, with isLast true for the last one and once with size 0 for an empty document. ]*/
+    do
+    {
+        size_t chunk = size - offset;
+        if (chunk > handleData->deviceTwinChunkSize)
+        {
+            chunk = handleData->deviceTwinChunkSize;
+        }
+        handleData->deviceTwinChunkCallback(update_state, payLoad + offset, chunk, offset, offset + chunk == size, handleData->deviceTwinChunkContextCallback);
+        offset += chunk;
+    } while (offset < size);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceTwinChunkCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, size_t chunkSize, IOTHUB_CLIENT_DEVICE_TWIN_CHUNK_CALLBACK deviceTwinChunkCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if ((iotHubClientHandle == NULL) || ((deviceTwinChunkCallback != NULL) && (chunkSize == 0)))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_134: [ If iotHubClientHandle is NULL, or deviceTwinChunkCallback is not NULL and chunkSize is 0, IoTHubClient_LL_SetDeviceTwinChunkCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("Invalid argument iotHubClientHandle=%p, chunkSize=%lu", iotHubClientHandle, (unsigned long)chunkSize);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_135: [ IoTHubClient_LL_SetDeviceTwinChunkCallback shall subscribe or unsubscribe as IoTHubClient_LL_SetDeviceTwinCallback does, with a callback giving the documents to deviceTwinChunkCallback, and return its result. ]*/
+        result = IoTHubClient_LL_SetDeviceTwinCallback(iotHubClientHandle, (deviceTwinChunkCallback == NULL) ? NULL : deliver_twin_chunks, handleData);
+        if ((result == IOTHUB_CLIENT_OK) || (deviceTwinChunkCallback == NULL))
+        {
+            handleData->deviceTwinChunkCallback = deviceTwinChunkCallback;
+            handleData->deviceTwinChunkContextCallback = userContextCallback;
+            handleData->deviceTwinChunkSize = chunkSize;
+        }
+    }
+    return result;
+}
+
+/*the items of iot_msg_queue have not been given to the transport yet*/
+static int coalesce_reported_state(IOTHUB_DEVICE_TWIN* pending, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
+{
+    int result;
+    IOTHUB_REPORTED_STATE_CALLBACK* coalesced_callback = NULL;
+    CONSTBUFFER_HANDLE merged;
+    if ((reportedStateCallback != NULL) &&
+        ((coalesced_callback = (IOTHUB_REPORTED_STATE_CALLBACK*)malloc(sizeof(IOTHUB_REPORTED_STATE_CALLBACK))) == NULL))
+    {
+        LogError("unable to malloc");
+        result = __FAILURE__;
+    }
+    else if ((merged = json_merge_patch_combine(pending->report_data_handle, reportedState, size)) == NULL)
+    {
+        if (coalesced_callback != NULL)
+        {
+            free(coalesced_callback);
+        }
+        result = __FAILURE__;
+    }
+    else
+    {
+        CONSTBUFFER_Destroy(pending->report_data_handle);
+        pending->report_data_handle = merged;
+        if (coalesced_callback != NULL)
+        {
+            coalesced_callback->reported_state_callback = reportedStateCallback;
+            coalesced_callback->context = userContextCallback;
+            coalesced_callback->next = NULL;
+            if (pending->last_coalesced_callback == NULL)
+            {
+                pending->coalesced_callbacks = coalesced_callback;
+            }
+            else
+            {
+                pending->last_coalesced_callback->next = coalesced_callback;
+            }
+            pending->last_coalesced_callback = coalesced_callback;
+        }
+        result = 0;
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendReportedState(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1668,9 +4450,17 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendReportedState(IOTHUB_CLIENT_LL_HANDLE i
     else
     {
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        IOTHUB_DEVICE_TWIN* client_data;
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_047: [ While the coalescing is enabled, if iot_msg_queue is not empty, IoTHubClient_LL_SendReportedState shall combine the reported state of its last item with reportedState by calling json_merge_patch_combine, replace the reported state of the item with the result, keep reportedStateCallback and userContextCallback with the item and return IOTHUB_CLIENT_OK. ]*/
+        if (handleData->coalesceReportedState &&
+            (handleData->iot_msg_queue.Blink != &(handleData->iot_msg_queue)) &&
+            (coalesce_reported_state(containingRecord(handleData->iot_msg_queue.Blink, IOTHUB_DEVICE_TWIN, entry), reportedState, size, reportedStateCallback, userContextCallback) == 0))
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_048: [ If the reported states cannot be combined or any error occurs, IoTHubClient_LL_SendReportedState shall leave the last item unchanged and queue reportedState in a new item. ]*/
         /* Codes_SRS_IOTHUBCLIENT_LL_10_014: [IoTHubClient_LL_SendReportedState shall construct and queue the reported a Device_Twin structure for transmition by the underlying transport.] */
-        IOTHUB_DEVICE_TWIN* client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), reportedState, size, reportedStateCallback, userContextCallback);
-        if (client_data == NULL)
+        else if ((client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), reportedState, size, reportedStateCallback, userContextCallback)) == NULL)
         {
             /* Codes_SRS_IOTHUBCLIENT_LL_10_015: [If any error is encountered IoTHubClient_LL_SendReportedState shall return IOTHUB_CLIENT_ERROR.] */
             LogError("Failure constructing device twin data");
@@ -1678,7 +4468,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendReportedState(IOTHUB_CLIENT_LL_HANDLE i
         }
         else
         {
-            if (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->transportHandle) != 0)
+            if (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->deviceHandle) != 0)
             {
                 LogError("Failure adding device twin data to queue");
                 device_twin_data_destroy(client_data);
@@ -1696,7 +4486,9 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendReportedState(IOTHUB_CLIENT_LL_HANDLE i
     }
     return result;
 }
+#endif /*DONT_USE_DEVICE_TWIN*/
 
+#ifndef DONT_USE_DEVICE_METHODS
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC deviceMethodCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1729,7 +4521,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback(IOTHUB_CLIENT_LL_HA
                 /*Codes_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
                 /*Codes_SRS_IOTHUBCLIENT_LL_12_018: [If deviceMethodCallback is NULL, then IoTHubClient_LL_SetDeviceMethodCallback shall call the underlying layer's IoTHubTransport_Unsubscribe_DeviceMethod function and return IOTHUB_CLIENT_OK. ] */
                 /*Codes_SRS_IOTHUBCLIENT_LL_12_022: [ Otherwise IoTHubClient_LL_SetDeviceMethodCallback shall succeed and return IOTHUB_CLIENT_OK. ]*/
-                handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->transportHandle);
+                unsubscribe_methods(handleData);
                 handleData->methodCallback.type = CALLBACK_TYPE_NONE;
                 handleData->methodCallback.callbackSync = NULL;
                 handleData->methodCallback.userContextCallback = NULL;
@@ -1747,7 +4539,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback(IOTHUB_CLIENT_LL_HA
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_12_019: [ If deviceMethodCallback is not NULL, then IoTHubClient_LL_SetDeviceMethodCallback shall call the underlying layer's IoTHubTransport_Subscribe_DeviceMethod function. ]*/
-                if (handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle) == 0)
+                if (subscribe_methods(handleData) == 0)
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_12_022: [ Otherwise IoTHubClient_LL_SetDeviceMethodCallback shall succeed and return IOTHUB_CLIENT_OK. ]*/
                     handleData->methodCallback.type = CALLBACK_TYPE_SYNC;
@@ -1802,7 +4594,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback_Ex(IOTHUB_CLIENT_LL
             else
             {
                 /* Codes_SRS_IOTHUBCLIENT_LL_07_022: [ If inboundDeviceMethodCallback is NULL then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall call the underlying layer's IoTHubTransport_Unsubscribe_DeviceMethod function and return IOTHUB_CLIENT_OK.] */
-                handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->transportHandle);
+                unsubscribe_methods(handleData);
                 handleData->methodCallback.type = CALLBACK_TYPE_NONE;
                 handleData->methodCallback.callbackAsync = NULL;
                 handleData->methodCallback.userContextCallback = NULL;
@@ -1820,7 +4612,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback_Ex(IOTHUB_CLIENT_LL
             else
             {
                 /* Codes_SRS_IOTHUBCLIENT_LL_07_023: [ If inboundDeviceMethodCallback is non-NULL then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall call the underlying layer's IoTHubTransport_Subscribe_DeviceMethod function.]*/
-                if (handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle) == 0)
+                if (subscribe_methods(handleData) == 0)
                 {
                     handleData->methodCallback.type = CALLBACK_TYPE_ASYNC;
                     handleData->methodCallback.callbackAsync = inboundDeviceMethodCallback;
@@ -1869,6 +4661,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_DeviceMethodResponse(IOTHUB_CLIENT_LL_HANDL
     }
     return result;
 }
+#endif /*DONT_USE_DEVICE_METHODS*/
 
 #ifndef DONT_USE_UPLOADTOBLOB
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* destinationFileName, const unsigned char* source, size_t size)
@@ -1887,7 +4680,71 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob(IOTHUB_CLIENT_LL_HANDLE iotHub
     }
     else
     {
-        result = IoTHubClient_LL_UploadToBlob_Impl(iotHubClientHandle->uploadToBlobHandle, destinationFileName, source, size);
+        IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE uploadToBlobHandle = get_blob_upload_module(iotHubClientHandle);
+        result = (uploadToBlobHandle == NULL) ? IOTHUB_CLIENT_ERROR : IoTHubClient_LL_UploadToBlob_Impl(uploadToBlobHandle, destinationFileName, source, size);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_080: [ If handle, destinationFileName or getDataCallback is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (getDataCallback == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle=%p, const char* destinationFileName=%s, getDataCallback=%p", iotHubClientHandle, destinationFileName, getDataCallback);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE uploadToBlobHandle = get_blob_upload_module(iotHubClientHandle);
+        result = (uploadToBlobHandle == NULL) ? IOTHUB_CLIENT_ERROR : IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(uploadToBlobHandle, destinationFileName, getDataCallback, context);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadFileToBlob(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* destinationFileName, const char* filePath)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_083: [ If handle, destinationFileName or filePath is NULL then IoTHubClient_LL_UploadFileToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (filePath == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle=%p, const char* destinationFileName=%s, const char* filePath=%s", iotHubClientHandle, destinationFileName, filePath);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE uploadToBlobHandle = get_blob_upload_module(iotHubClientHandle);
+        result = (uploadToBlobHandle == NULL) ? IOTHUB_CLIENT_ERROR : IoTHubClient_LL_UploadFileToBlob_Impl(uploadToBlobHandle, destinationFileName, filePath);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleToBlob(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM* items, size_t itemCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_093: [ If handle or items is NULL or itemCount is 0 then IoTHubClient_LL_UploadMultipleToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (items == NULL) ||
+        (itemCount == 0)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle=%p, IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM* items=%p, size_t itemCount=%zu", iotHubClientHandle, items, itemCount);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE uploadToBlobHandle = get_blob_upload_module(iotHubClientHandle);
+        result = (uploadToBlobHandle == NULL) ? IOTHUB_CLIENT_ERROR : IoTHubClient_LL_UploadMultipleToBlob_Impl(uploadToBlobHandle, items, itemCount);
     }
     return result;
 }
@@ -0,0 +1,335 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+
+#include "iothub_client_ll_failover.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+#define FAILOVER_CLIENT_COUNT 2
+#define FAILOVER_PRIMARY 0
+
+typedef struct FAILOVER_CLIENT_TAG
+{
+    IOTHUB_CLIENT_LL_HANDLE handle;
+    struct IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA_TAG* owner;
+    size_t index;
+    bool connected;
+    bool lost; /*reported unauthenticated since it was last connected, the standby one takes over when it connects*/
+} FAILOVER_CLIENT;
+
+typedef struct FAILOVER_EVENT_TAG
+{
+    DLIST_ENTRY entry; /*in inProgress until confirmed*/
+    IOTHUB_MESSAGE_HANDLE message; /*shares the content of the message of the application, to send it again*/
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+    size_t sentTo; /*only the confirmation of this client is given to the application*/
+    size_t pendingCount[FAILOVER_CLIENT_COUNT]; /*confirmations still to come from each client*/
+    bool sending; /*a client can confirm the event before its SendEventAsync returns*/
+    bool confirmed;
+} FAILOVER_EVENT;
+
+typedef struct IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA_TAG
+{
+    FAILOVER_CLIENT clients[FAILOVER_CLIENT_COUNT];
+    size_t active;
+    DLIST_ENTRY inProgress;
+    IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connectionStatusCallback;
+    void* connectionStatusContext;
+} IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA;
+
+static void release_event_if_done(FAILOVER_EVENT* event)
+{
+    if (event->confirmed && !event->sending && (event->pendingCount[0] == 0) && (event->pendingCount[1] == 0))
+    {
+        free(event);
+    }
+}
+
+static void complete_event(FAILOVER_EVENT* event, size_t index, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    event->pendingCount[index]--;
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_011: [ The confirmation of an event shall be given to eventConfirmationCallback only when it comes from the client the event was sent through last, the confirmations of the client it was moved from being ignored. ]*/
+    if (!event->confirmed && (event->sentTo == index))
+    {
+        event->confirmed = true;
+        (void)DList_RemoveEntryList(&event->entry);
+        IoTHubMessage_Destroy(event->message);
+        if (event->callback != NULL)
+        {
+            event->callback(result, event->context);
+        }
+    }
+    release_event_if_done(event);
+}
+
+static void on_primary_event_complete(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    complete_event((FAILOVER_EVENT*)userContextCallback, 0, result);
+}
+
+static void on_standby_event_complete(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    complete_event((FAILOVER_EVENT*)userContextCallback, 1, result);
+}
+
+static const IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK EVENT_COMPLETE_CALLBACKS[FAILOVER_CLIENT_COUNT] = { on_primary_event_complete, on_standby_event_complete };
+
+static IOTHUB_CLIENT_RESULT send_event_through(IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA* handleData, FAILOVER_EVENT* event, size_t index)
+{
+    IOTHUB_CLIENT_RESULT result;
+    event->sending = true;
+    event->pendingCount[index]++;
+    if ((result = IoTHubClient_LL_SendEventAsync(handleData->clients[index].handle, event->message, EVENT_COMPLETE_CALLBACKS[index], event)) != IOTHUB_CLIENT_OK)
+    {
+        event->pendingCount[index]--;
+    }
+    else if (!event->confirmed)
+    {
+        event->sentTo = index;
+    }
+    event->sending = false;
+    return result;
+}
+
+static void report_connection_status(IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA* handleData, IOTHUB_CLIENT_CONNECTION_STATUS status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason)
+{
+    if (handleData->connectionStatusCallback != NULL)
+    {
+        handleData->connectionStatusCallback(status, reason, handleData->connectionStatusContext);
+    }
+}
+
+static void switch_to(IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA* handleData, size_t index)
+{
+    size_t lost = handleData->active;
+    PDLIST_ENTRY current = handleData->inProgress.Flink;
+
+    LogInfo("failing over to client %lu", (unsigned long)index);
+    handleData->active = index;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_009: [ When the active client is switched, the events sent through the lost one and not confirmed yet shall be sent again through the new active one, in the order they were sent, the events whose IoTHubClient_LL_SendEventAsync fails staying with the lost one. ]*/
+    while (current != &handleData->inProgress)
+    {
+        FAILOVER_EVENT* event = containingRecord(current, FAILOVER_EVENT, entry);
+        current = current->Flink;
+        if ((event->sentTo == lost) && (send_event_through(handleData, event, index) != IOTHUB_CLIENT_OK))
+        {
+            LogError("unable to move an event to client %lu", (unsigned long)index);
+        }
+        else
+        {
+            release_event_if_done(event);
+        }
+    }
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_010: [ When the active client is switched, the connection status callback shall be called with IOTHUB_CLIENT_CONNECTION_AUTHENTICATED and IOTHUB_CLIENT_CONNECTION_OK. ]*/
+    report_connection_status(handleData, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+}
+
+static void on_client_connection_status(IOTHUB_CLIENT_CONNECTION_STATUS result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* userContextCallback)
+{
+    FAILOVER_CLIENT* client = (FAILOVER_CLIENT*)userContextCallback;
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA* handleData = client->owner;
+    FAILOVER_CLIENT* other = &handleData->clients[FAILOVER_CLIENT_COUNT - 1 - client->index];
+
+    client->connected = (result == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED);
+    client->lost = !client->connected;
+
+    if (client->index == handleData->active)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_007: [ When the active client reports IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED while the other one is connected, the other one shall become the active one. ]*/
+        if (!client->connected && other->connected)
+        {
+            switch_to(handleData, other->index);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_012: [ The connection status of the active client shall be given to the connection status callback as it is, the one of the standby client not at all. ]*/
+            report_connection_status(handleData, result, reason);
+        }
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_008: [ When the standby client reports IOTHUB_CLIENT_CONNECTION_AUTHENTICATED after the active one reported IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, the standby one shall become the active one. ]*/
+    else if (client->connected && other->lost)
+    {
+        switch_to(handleData, client->index);
+    }
+}
+
+IOTHUB_CLIENT_LL_FAILOVER_HANDLE IoTHubClient_LL_Failover_Create(IOTHUB_CLIENT_LL_HANDLE primaryHandle, IOTHUB_CLIENT_LL_HANDLE standbyHandle)
+{
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA* result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_001: [ If primaryHandle or standbyHandle is NULL, or they are the same handle, IoTHubClient_LL_Failover_Create shall fail and return NULL. ]*/
+    if ((primaryHandle == NULL) || (standbyHandle == NULL) || (primaryHandle == standbyHandle))
+    {
+        LogError("invalid argument primaryHandle=%p, standbyHandle=%p", primaryHandle, standbyHandle);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA*)malloc(sizeof(IOTHUB_CLIENT_LL_FAILOVER_HANDLE_DATA))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_003: [ If any error occurs, IoTHubClient_LL_Failover_Create shall fail, leave the connection status callback of the clients unset and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        size_t i;
+        result->clients[0].handle = primaryHandle;
+        result->clients[1].handle = standbyHandle;
+        result->active = FAILOVER_PRIMARY;
+        result->connectionStatusCallback = NULL;
+        result->connectionStatusContext = NULL;
+        DList_InitializeListHead(&result->inProgress);
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_002: [ IoTHubClient_LL_Failover_Create shall set the connection status callback of both clients, make primaryHandle the active client and return a non-NULL handle owning both clients. ]*/
+        for (i = 0; i < FAILOVER_CLIENT_COUNT; i++)
+        {
+            result->clients[i].owner = result;
+            result->clients[i].index = i;
+            result->clients[i].connected = false;
+            result->clients[i].lost = false;
+            if (IoTHubClient_LL_SetConnectionStatusCallback(result->clients[i].handle, on_client_connection_status, &result->clients[i]) != IOTHUB_CLIENT_OK)
+            {
+                break;
+            }
+        }
+
+        if (i < FAILOVER_CLIENT_COUNT)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_003: [ If any error occurs, IoTHubClient_LL_Failover_Create shall fail, leave the connection status callback of the clients unset and return NULL. ]*/
+            LogError("unable to set the connection status callback of client %lu", (unsigned long)i);
+            while (i > 0)
+            {
+                i--;
+                (void)IoTHubClient_LL_SetConnectionStatusCallback(result->clients[i].handle, NULL, NULL);
+            }
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+void IoTHubClient_LL_Failover_Destroy(IOTHUB_CLIENT_LL_FAILOVER_HANDLE failoverHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_004: [ If failoverHandle is NULL, IoTHubClient_LL_Failover_Destroy shall do nothing. ]*/
+    if (failoverHandle != NULL)
+    {
+        size_t i;
+        /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_005: [ IoTHubClient_LL_Failover_Destroy shall destroy both clients, which confirm the events not confirmed yet, and free the failover client. ]*/
+        failoverHandle->connectionStatusCallback = NULL;
+        for (i = 0; i < FAILOVER_CLIENT_COUNT; i++)
+        {
+            IoTHubClient_LL_Destroy(failoverHandle->clients[i].handle);
+        }
+        free(failoverHandle);
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_Failover_SendEventAsync(IOTHUB_CLIENT_LL_FAILOVER_HANDLE failoverHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    FAILOVER_EVENT* event;
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_013: [ If failoverHandle or eventMessageHandle is NULL, or eventConfirmationCallback is NULL and userContextCallback is not, IoTHubClient_LL_Failover_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((failoverHandle == NULL) || (eventMessageHandle == NULL) || ((eventConfirmationCallback == NULL) && (userContextCallback != NULL)))
+    {
+        LogError("invalid argument failoverHandle=%p, eventMessageHandle=%p", failoverHandle, eventMessageHandle);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if ((event = (FAILOVER_EVENT*)malloc(sizeof(FAILOVER_EVENT))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_015: [ If any error occurs, IoTHubClient_LL_Failover_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR, or the error of IoTHubClient_LL_SendEventAsync. ]*/
+        LogError("unable to malloc");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_014: [ IoTHubClient_LL_Failover_SendEventAsync shall keep a clone of eventMessageHandle, sharing its content, until the event is confirmed and send it with IoTHubClient_LL_SendEventAsync through the active client. ]*/
+    else if ((event->message = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_015: [ If any error occurs, IoTHubClient_LL_Failover_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR, or the error of IoTHubClient_LL_SendEventAsync. ]*/
+        LogError("unable to clone the message");
+        free(event);
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        event->callback = eventConfirmationCallback;
+        event->context = userContextCallback;
+        event->sentTo = failoverHandle->active;
+        event->pendingCount[0] = 0;
+        event->pendingCount[1] = 0;
+        event->sending = false;
+        event->confirmed = false;
+        DList_InsertTailList(&failoverHandle->inProgress, &event->entry);
+
+        if ((result = send_event_through(failoverHandle, event, failoverHandle->active)) != IOTHUB_CLIENT_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_015: [ If any error occurs, IoTHubClient_LL_Failover_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR, or the error of IoTHubClient_LL_SendEventAsync. ]*/
+            LogError("unable to send the event through client %lu", (unsigned long)failoverHandle->active);
+            (void)DList_RemoveEntryList(&event->entry);
+            IoTHubMessage_Destroy(event->message);
+            free(event);
+        }
+        else
+        {
+            release_event_if_done(event);
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_Failover_SetConnectionStatusCallback(IOTHUB_CLIENT_LL_FAILOVER_HANDLE failoverHandle, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connectionStatusCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_016: [ If failoverHandle is NULL, IoTHubClient_LL_Failover_SetConnectionStatusCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (failoverHandle == NULL)
+    {
+        LogError("invalid argument failoverHandle=NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_017: [ IoTHubClient_LL_Failover_SetConnectionStatusCallback shall store connectionStatusCallback and userContextCallback and return IOTHUB_CLIENT_OK. ]*/
+        failoverHandle->connectionStatusCallback = connectionStatusCallback;
+        failoverHandle->connectionStatusContext = userContextCallback;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+void IoTHubClient_LL_Failover_DoWork(IOTHUB_CLIENT_LL_FAILOVER_HANDLE failoverHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_018: [ If failoverHandle is NULL, IoTHubClient_LL_Failover_DoWork shall do nothing. ]*/
+    if (failoverHandle != NULL)
+    {
+        size_t i;
+        /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_006: [ IoTHubClient_LL_Failover_DoWork shall call IoTHubClient_LL_DoWork on both clients, so the standby one connects and stays connected. ]*/
+        for (i = 0; i < FAILOVER_CLIENT_COUNT; i++)
+        {
+            IoTHubClient_LL_DoWork(failoverHandle->clients[i].handle);
+        }
+    }
+}
+
+IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_Failover_GetActiveHandle(IOTHUB_CLIENT_LL_FAILOVER_HANDLE failoverHandle)
+{
+    IOTHUB_CLIENT_LL_HANDLE result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_FAILOVER_41_019: [ IoTHubClient_LL_Failover_GetActiveHandle shall return the active client, NULL if failoverHandle is NULL. ]*/
+    if (failoverHandle == NULL)
+    {
+        LogError("invalid argument failoverHandle=NULL");
+        result = NULL;
+    }
+    else
+    {
+        result = failoverHandle->clients[failoverHandle->active].handle;
+    }
+    return result;
+}
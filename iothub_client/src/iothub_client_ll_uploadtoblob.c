@@ -6,6 +6,8 @@
 #else
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -13,6 +15,7 @@
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
 
 #include "iothub_client_ll.h"
@@ -24,6 +27,9 @@
 #include "iothub_client_ll_uploadtoblob.h"
 #include "blob.h"
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_BLOB
+#include "iothub_client_memory_tag.h"
+
 
 #ifdef WINCE
 #include <stdarg.h>
@@ -66,8 +72,39 @@ typedef struct IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA_TAG
         UPLOADTOBLOB_X509_CREDENTIALS x509credentials; /*assumed to be used when both deviceKey and deviceSasToken are NULL*/
     } credentials;                              /*needed for file upload*/
     char* certificates; /*if there are any certificates used*/
+    bool keepIotHubConnection; /*set by "blob_upload_keep_connection"*/
+    LOCK_HANDLE idleIotHubHttpApiExLock; /*created when "blob_upload_keep_connection" is first set, uploads run on their own threads*/
+    HTTPAPIEX_HANDLE idleIotHubHttpApiExHandle; /*connection to IoTHub kept from the last successful upload, NULL when none*/
+    size_t blobUploadConcurrency; /*set by "blob_upload_concurrency", blocks uploaded to storage at the same time*/
+    size_t blobUploadBlockRetries; /*set by "blob_upload_block_retries", times a failed block is put again*/
+    IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK progressCallback; /*set by "blob_upload_progress", NULL when the progress is not reported*/
+    void* progressUserContextCallback;
+    bool computeBlockCrc64; /*set by "blob_upload_block_crc64", every block is sent with its CRC64*/
 }IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA;
 
+/*the biggest block of a block blob, a local file is read in blocks of this size*/
+#define FILE_BLOCK_SIZE (4 * 1024 * 1024)
+
+typedef struct FILE_BLOCK_READER_TAG
+{
+    FILE* file;
+    unsigned char* block; /*reused for every block of the file*/
+}FILE_BLOCK_READER;
+
+/*IoTHub lets a device have 10 file uploads in progress by default, a batch requests the SAS URIs of this many files ahead*/
+#define FILE_UPLOAD_BATCH_WINDOW 10
+
+typedef struct FILE_UPLOAD_BATCH_FILE_TAG
+{
+    STRING_HANDLE correlationId;
+    STRING_HANDLE sasUri;
+    HTTP_HEADERS_HANDLE requestHttpHeaders; /*built by step 1 of the file and used by its step 3 too*/
+    BUFFER_HANDLE responseToIoTHub;
+    unsigned int httpResponse;
+    int hasSasUri;
+    int step2success;
+}FILE_UPLOAD_BATCH_FILE;
+
 IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE IoTHubClient_LL_UploadToBlob_Create(const IOTHUB_CLIENT_CONFIG* config)
 {
     IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData = malloc(sizeof(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA));
@@ -103,6 +140,14 @@ IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE IoTHubClient_LL_UploadToBlob_Create(const I
                 ((char*)handleData->hostname)[iotHubNameLength] = '.';
                 (void)memcpy((char*)handleData->hostname + iotHubNameLength + 1, config->iotHubSuffix, iotHubSuffixLength + 1); /*+1 will copy the \0 too*/
                 handleData->certificates = NULL;
+                handleData->keepIotHubConnection = false;
+                handleData->idleIotHubHttpApiExLock = NULL;
+                handleData->idleIotHubHttpApiExHandle = NULL;
+                handleData->blobUploadConcurrency = 1;
+                handleData->blobUploadBlockRetries = 0;
+                handleData->progressCallback = NULL;
+                handleData->progressUserContextCallback = NULL;
+                handleData->computeBlockCrc64 = false;
                 if ((config->deviceSasToken != NULL) && (config->deviceKey == NULL))
                 {
                     handleData->authorizationScheme = SAS_TOKEN;
@@ -700,13 +745,186 @@ static int IoTHubClient_LL_UploadToBlob_step3(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HAND
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const unsigned char* source, size_t size)
+/*takes the connection to IoTHub kept by the previous upload, NULL if there is none*/
+static HTTPAPIEX_HANDLE takeIdleIotHubHttpApiExHandle(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData)
+{
+    HTTPAPIEX_HANDLE result;
+    if ((handleData->idleIotHubHttpApiExLock == NULL) || (Lock(handleData->idleIotHubHttpApiExLock) != LOCK_OK))
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = handleData->idleIotHubHttpApiExHandle;
+        handleData->idleIotHubHttpApiExHandle = NULL;
+        (void)Unlock(handleData->idleIotHubHttpApiExLock);
+    }
+    return result;
+}
+
+/*keeps iotHubHttpApiExHandle for the next upload when "blob_upload_keep_connection" is set and no other upload kept its own, destroys it otherwise*/
+static void releaseIotHubHttpApiExHandle(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData, HTTPAPIEX_HANDLE iotHubHttpApiExHandle, bool canBeKept)
+{
+    bool isKept = false;
+    if (canBeKept && handleData->keepIotHubConnection &&
+        (handleData->idleIotHubHttpApiExLock != NULL) && (Lock(handleData->idleIotHubHttpApiExLock) == LOCK_OK))
+    {
+        if (handleData->idleIotHubHttpApiExHandle == NULL)
+        {
+            handleData->idleIotHubHttpApiExHandle = iotHubHttpApiExHandle;
+            isKept = true;
+        }
+        (void)Unlock(handleData->idleIotHubHttpApiExLock);
+    }
+
+    if (!isKept)
+    {
+        HTTPAPIEX_Destroy(iotHubHttpApiExHandle);
+    }
+}
+
+/*the kept connection was made with the previous credentials and certificates*/
+static void dropIdleIotHubHttpApiExHandle(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData)
+{
+    HTTPAPIEX_HANDLE idleIotHubHttpApiExHandle = takeIdleIotHubHttpApiExHandle(handleData);
+    if (idleIotHubHttpApiExHandle != NULL)
+    {
+        HTTPAPIEX_Destroy(idleIotHubHttpApiExHandle);
+    }
+}
+
+/*takes the connection to IoTHub kept by a previous upload or creates a new one, NULL when it cannot be created*/
+static HTTPAPIEX_HANDLE openIotHubHttpApiExHandle(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_076: [ If a connection to IoTHub was kept by a previous upload, IoTHubClient_LL_UploadToBlob shall use it instead of creating an HTTPAPIEX_HANDLE and setting its options. ]*/
+    HTTPAPIEX_HANDLE result = takeIdleIotHubHttpApiExHandle(handleData);
+    if (result == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_064: [ IoTHubClient_LL_UploadToBlob shall create an HTTPAPIEX_HANDLE to the IoTHub hostname. ]*/
+        result = HTTPAPIEX_Create(handleData->hostname);
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_065: [ If creating the HTTPAPIEX_HANDLE fails then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        if (result == NULL)
+        {
+            LogError("unable to HTTPAPIEX_Create");
+        }
+        else if (
+            (handleData->authorizationScheme == X509) &&
+
+            /*transmit the x509certificate and x509privatekey*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_106: [ - x509certificate and x509privatekey saved options shall be passed on the HTTPAPIEX_SetOption ]*/
+            (!(
+                (HTTPAPIEX_SetOption(result, OPTION_X509_CERT, handleData->credentials.x509credentials.x509certificate) == HTTPAPIEX_OK) &&
+                (HTTPAPIEX_SetOption(result, OPTION_X509_PRIVATE_KEY, handleData->credentials.x509credentials.x509privatekey) == HTTPAPIEX_OK)
+            ))
+            )
+        {
+            LogError("unable to HTTPAPIEX_SetOption for x509");
+            HTTPAPIEX_Destroy(result);
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_111: [ If certificates is non-NULL then certificates shall be passed to HTTPAPIEX_SetOption with optionName TrustedCerts. ]*/
+        else if ((handleData->certificates != NULL) && (HTTPAPIEX_SetOption(result, "TrustedCerts", handleData->certificates) != HTTPAPIEX_OK))
+        {
+            LogError("unable to set TrustedCerts!");
+            HTTPAPIEX_Destroy(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+/*step 2 of an upload: sends source or, when getDataCallback is not NULL, the blocks it returns to sasUri. Returns non-zero when storage answered*/
+static int uploadToSasUri(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData, STRING_HANDLE sasUri, const unsigned char* source, size_t size, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback, void* context, unsigned int* httpResponse, BUFFER_HANDLE responseToIoTHub)
+{
+    int step2success;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_083: [ IoTHubClient_LL_UploadToBlob shall call Blob_UploadFromSasUri and capture the HTTP return code and HTTP body. ]*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_079: [ IoTHubClient_LL_UploadToBlob shall call Blob_UploadFromSasUri_Ex passing the "blob_upload_concurrency" value (1 when the option is not set). ]*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_087: [ IoTHubClient_LL_UploadToBlob shall pass the "blob_upload_block_retries" value (0 when the option is not set) to Blob_UploadFromSasUri_Ex and Blob_UploadMultipleBlocksFromSasUri. ]*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_089: [ IoTHubClient_LL_UploadToBlob shall pass the "blob_upload_progress" callback and context (NULL when the option is not set) to Blob_UploadFromSasUri_Ex and Blob_UploadMultipleBlocksFromSasUri. ]*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_091: [ IoTHubClient_LL_UploadToBlob shall pass the "blob_upload_block_crc64" value (false when the option is not set) to Blob_UploadFromSasUri_Ex and Blob_UploadMultipleBlocksFromSasUri. ]*/
+    if (getDataCallback == NULL)
+    {
+        step2success = (Blob_UploadFromSasUri_Ex(STRING_c_str(sasUri), source, size, httpResponse, responseToIoTHub, handleData->certificates, handleData->blobUploadConcurrency, handleData->blobUploadBlockRetries, handleData->progressCallback, handleData->progressUserContextCallback, handleData->computeBlockCrc64) == BLOB_OK);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_081: [ IoTHubClient_LL_UploadMultipleBlocksToBlob shall upload the blocks of getDataCallback by calling Blob_UploadMultipleBlocksFromSasUri, then notify IoTHub as IoTHubClient_LL_UploadToBlob does. ]*/
+        step2success = (Blob_UploadMultipleBlocksFromSasUri(STRING_c_str(sasUri), getDataCallback, context, httpResponse, responseToIoTHub, handleData->certificates, handleData->blobUploadBlockRetries, handleData->progressCallback, handleData->progressUserContextCallback, handleData->computeBlockCrc64) == BLOB_OK);
+    }
+    return step2success;
+}
+
+/*step 3 of an upload: tells IoTHub the outcome of step 2 and returns the result of the whole upload*/
+static IOTHUB_CLIENT_RESULT notifyUploadResult(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData, STRING_HANDLE correlationId, HTTPAPIEX_HANDLE iotHubHttpApiExHandle, HTTP_HEADERS_HANDLE requestHttpHeaders, int step2success, unsigned int httpResponse, BUFFER_HANDLE responseToIoTHub)
 {
     IOTHUB_CLIENT_RESULT result;
     BUFFER_HANDLE toBeTransmitted;
     int requiredStringLength;
     char* requiredString;
 
+    if (!step2success)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_084: [ If Blob_UploadFromSasUri fails then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("unable to Blob_UploadFromSasUri");
+
+        /*do step 3*/ /*try*/
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_091: [ If step 2 fails without establishing an HTTP dialogue, then the HTTP message body shall look like: ]*/
+        if (BUFFER_build(responseToIoTHub, (const unsigned char*)FILE_UPLOAD_FAILED_BODY, sizeof(FILE_UPLOAD_FAILED_BODY) / sizeof(FILE_UPLOAD_FAILED_BODY[0])) == 0)
+        {
+            if (IoTHubClient_LL_UploadToBlob_step3(handleData, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, responseToIoTHub) != 0)
+            {
+                LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
+            }
+        }
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        /*must make a json*/
+
+        requiredStringLength = snprintf(NULL, 0, "{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
+
+        requiredString = malloc(requiredStringLength + 1);
+        if (requiredString == 0)
+        {
+            LogError("unable to malloc");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            /*do again snprintf*/
+            (void)snprintf(requiredString, requiredStringLength + 1, "{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
+            toBeTransmitted = BUFFER_create((const unsigned char*)requiredString, requiredStringLength);
+            if (toBeTransmitted == NULL)
+            {
+                LogError("unable to BUFFER_create");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (IoTHubClient_LL_UploadToBlob_step3(handleData, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, toBeTransmitted) != 0)
+                {
+                    LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    result = (httpResponse < 300) ? IOTHUB_CLIENT_OK : IOTHUB_CLIENT_ERROR;
+                }
+                BUFFER_delete(toBeTransmitted);
+            }
+            free(requiredString);
+        }
+    }
+    return result;
+}
+
+/*uploads source or, when getDataCallback is not NULL, the blocks it returns*/
+static IOTHUB_CLIENT_RESULT uploadToBlob(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const unsigned char* source, size_t size, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+
     /*Codes_SRS_IOTHUBCLIENT_LL_02_061: [ If handle is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
     /*Codes_SRS_IOTHUBCLIENT_LL_02_062: [ If destinationFileName is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
     /*Codes_SRS_IOTHUBCLIENT_LL_02_063: [ If source is NULL and size is greater than 0 then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
@@ -722,156 +940,291 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTO
     else
     {
         IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle;
-
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_064: [ IoTHubClient_LL_UploadToBlob shall create an HTTPAPIEX_HANDLE to the IoTHub hostname. ]*/
-        HTTPAPIEX_HANDLE iotHubHttpApiExHandle = HTTPAPIEX_Create(handleData->hostname);
-
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_065: [ If creating the HTTPAPIEX_HANDLE fails then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        HTTPAPIEX_HANDLE iotHubHttpApiExHandle = openIotHubHttpApiExHandle(handleData);
         if (iotHubHttpApiExHandle == NULL)
         {
-            LogError("unable to HTTPAPIEX_Create");
             result = IOTHUB_CLIENT_ERROR;
         }
         else
         {
-            if (
-                (handleData->authorizationScheme == X509) &&
-
-                /*transmit the x509certificate and x509privatekey*/
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_106: [ - x509certificate and x509privatekey saved options shall be passed on the HTTPAPIEX_SetOption ]*/
-                (!(
-                    (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_CERT, handleData->credentials.x509credentials.x509certificate) == HTTPAPIEX_OK) &&
-                    (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_PRIVATE_KEY, handleData->credentials.x509credentials.x509privatekey) == HTTPAPIEX_OK)
-                ))
-                )
+            STRING_HANDLE correlationId = STRING_new();
+            if (correlationId == NULL)
             {
-                LogError("unable to HTTPAPIEX_SetOption for x509");
+                LogError("unable to STRING_new");
                 result = IOTHUB_CLIENT_ERROR;
             }
             else
             {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_111: [ If certificates is non-NULL then certificates shall be passed to HTTPAPIEX_SetOption with optionName TrustedCerts. ]*/
-                if ((handleData->certificates != NULL) && (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, "TrustedCerts", handleData->certificates) != HTTPAPIEX_OK))
+                STRING_HANDLE sasUri = STRING_new();
+                if (sasUri == NULL)
                 {
-                    LogError("unable to set TrustedCerts!");
+                    LogError("unable to STRING_new");
                     result = IOTHUB_CLIENT_ERROR;
                 }
                 else
                 {
-
-                    STRING_HANDLE correlationId = STRING_new();
-                    if (correlationId == NULL)
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_070: [ IoTHubClient_LL_UploadToBlob shall create request HTTP headers. ]*/
+                    HTTP_HEADERS_HANDLE requestHttpHeaders = HTTPHeaders_Alloc(); /*these are build by step 1 and used by step 3 too*/
+                    if (requestHttpHeaders == NULL)
                     {
-                        LogError("unable to STRING_new");
+                        LogError("unable to HTTPHeaders_Alloc");
                         result = IOTHUB_CLIENT_ERROR;
                     }
                     else
                     {
-                        STRING_HANDLE sasUri = STRING_new();
-                        if (sasUri == NULL)
+                        /*do step 1*/
+                        if (IoTHubClient_LL_UploadToBlob_step1and2(handleData, iotHubHttpApiExHandle, requestHttpHeaders, destinationFileName, correlationId, sasUri) != 0)
                         {
-                            LogError("unable to STRING_new");
+                            LogError("error in IoTHubClient_LL_UploadToBlob_step1");
                             result = IOTHUB_CLIENT_ERROR;
                         }
                         else
                         {
-                            /*Codes_SRS_IOTHUBCLIENT_LL_02_070: [ IoTHubClient_LL_UploadToBlob shall create request HTTP headers. ]*/
-                            HTTP_HEADERS_HANDLE requestHttpHeaders = HTTPHeaders_Alloc(); /*these are build by step 1 and used by step 3 too*/
-                            if (requestHttpHeaders == NULL)
+                            /*do step 2.*/
+
+                            unsigned int httpResponse;
+                            BUFFER_HANDLE responseToIoTHub = BUFFER_new();
+                            if (responseToIoTHub == NULL)
                             {
-                                LogError("unable to HTTPHeaders_Alloc");
                                 result = IOTHUB_CLIENT_ERROR;
+                                LogError("unable to BUFFER_new");
                             }
                             else
                             {
-                                /*do step 1*/
-                                if (IoTHubClient_LL_UploadToBlob_step1and2(handleData, iotHubHttpApiExHandle, requestHttpHeaders, destinationFileName, correlationId, sasUri) != 0)
-                                {
-                                    LogError("error in IoTHubClient_LL_UploadToBlob_step1");
-                                    result = IOTHUB_CLIENT_ERROR;
-                                }
-                                else
-                                {
-                                    /*do step 2.*/
+                                int step2success = uploadToSasUri(handleData, sasUri, source, size, getDataCallback, context, &httpResponse, responseToIoTHub);
+                                result = notifyUploadResult(handleData, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, step2success, httpResponse, responseToIoTHub);
+                                BUFFER_delete(responseToIoTHub);
+                            }
+                        }
+                        HTTPHeaders_Free(requestHttpHeaders);
+                    }
+                    STRING_delete(sasUri);
+                }
+                STRING_delete(correlationId);
+            }
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_077: [ If "blob_upload_keep_connection" is set and the upload succeeded, IoTHubClient_LL_UploadToBlob shall keep its connection to IoTHub for the next upload unless another upload already kept one, otherwise it shall destroy it. ]*/
+            releaseIotHubHttpApiExHandle(handleData, iotHubHttpApiExHandle, (result == IOTHUB_CLIENT_OK));
+        }
+    }
+    return result;
+}
 
-                                    unsigned int httpResponse;
-                                    BUFFER_HANDLE responseToIoTHub = BUFFER_new();
-                                    if (responseToIoTHub == NULL)
-                                    {
-                                        result = IOTHUB_CLIENT_ERROR;
-                                        LogError("unable to BUFFER_new");
-                                    }
-                                    else
-                                    {
-                                        int step2success;
-                                        /*Codes_SRS_IOTHUBCLIENT_LL_02_083: [ IoTHubClient_LL_UploadToBlob shall call Blob_UploadFromSasUri and capture the HTTP return code and HTTP body. ]*/
-                                        step2success = (Blob_UploadFromSasUri(STRING_c_str(sasUri), source, size, &httpResponse, responseToIoTHub, handleData->certificates) == BLOB_OK);
-                                        if (!step2success)
-                                        {
-                                            /*Codes_SRS_IOTHUBCLIENT_LL_02_084: [ If Blob_UploadFromSasUri fails then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
-                                            LogError("unable to Blob_UploadFromSasUri");
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const unsigned char* source, size_t size)
+{
+    return uploadToBlob(handle, destinationFileName, source, size, NULL, NULL);
+}
 
-                                            /*do step 3*/ /*try*/
-                                            /*Codes_SRS_IOTHUBCLIENT_LL_02_091: [ If step 2 fails without establishing an HTTP dialogue, then the HTTP message body shall look like: ]*/
-                                            if (BUFFER_build(responseToIoTHub, (const unsigned char*)FILE_UPLOAD_FAILED_BODY, sizeof(FILE_UPLOAD_FAILED_BODY) / sizeof(FILE_UPLOAD_FAILED_BODY[0])) == 0)
-                                            {
-                                                if (IoTHubClient_LL_UploadToBlob_step3(handleData, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, responseToIoTHub) != 0)
-                                                {
-                                                    LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
-                                                }
-                                            }
-                                            result = IOTHUB_CLIENT_ERROR;
-                                        }
-                                        else
-                                        {
-                                            /*must make a json*/
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK getDataCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_080: [ If handle, destinationFileName or getDataCallback is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((handle == NULL) || (destinationFileName == NULL) || (getDataCallback == NULL))
+    {
+        LogError("invalid argument detected handle=%p destinationFileName=%p getDataCallback=%p", handle, destinationFileName, getDataCallback);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        result = uploadToBlob(handle, destinationFileName, NULL, 0, getDataCallback, context);
 
-                                            requiredStringLength = snprintf(NULL, 0, "{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_082: [ Once the upload finished, IoTHubClient_LL_UploadMultipleBlocksToBlob shall call getDataCallback with FILE_UPLOAD_OK when it succeeded (FILE_UPLOAD_ERROR otherwise) and with NULL data and size. ]*/
+        getDataCallback((result == IOTHUB_CLIENT_OK) ? FILE_UPLOAD_OK : FILE_UPLOAD_ERROR, NULL, NULL, context);
+    }
+    return result;
+}
 
-                                            requiredString = malloc(requiredStringLength + 1);
-                                            if (requiredString == 0)
-                                            {
-                                                LogError("unable to malloc");
-                                                result = IOTHUB_CLIENT_ERROR;
-                                            }
-                                            else
-                                            {
-                                                /*do again snprintf*/
-                                                (void)snprintf(requiredString, requiredStringLength + 1, "{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
-                                                toBeTransmitted = BUFFER_create((const unsigned char*)requiredString, requiredStringLength);
-                                                if (toBeTransmitted == NULL)
-                                                {
-                                                    LogError("unable to BUFFER_create");
-                                                    result = IOTHUB_CLIENT_ERROR;
-                                                }
-                                                else
-                                                {
-                                                    if (IoTHubClient_LL_UploadToBlob_step3(handleData, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, toBeTransmitted) != 0)
-                                                    {
-                                                        LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
-                                                        result = IOTHUB_CLIENT_ERROR;
-                                                    }
-                                                    else
-                                                    {
-                                                        result = (httpResponse < 300) ? IOTHUB_CLIENT_OK : IOTHUB_CLIENT_ERROR;
-                                                    }
-                                                    BUFFER_delete(toBeTransmitted);
-                                                }
-                                                free(requiredString);
-                                            }
-                                        }
-                                        BUFFER_delete(responseToIoTHub);
-                                    }
-                                }
-                                HTTPHeaders_Free(requestHttpHeaders);
-                            }
-                            STRING_delete(sasUri);
+static void readFileBlock(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const ** data, size_t* size, void* context)
+{
+    FILE_BLOCK_READER* reader = (FILE_BLOCK_READER*)context;
+    (void)result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_085: [ IoTHubClient_LL_UploadFileToBlob shall read the file in blocks of 4MB into a single buffer and upload them by calling Blob_UploadMultipleBlocksFromSasUri, then notify IoTHub as IoTHubClient_LL_UploadToBlob does. ]*/
+    size_t readSize = fread(reader->block, 1, FILE_BLOCK_SIZE, reader->file);
+    if (ferror(reader->file))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_086: [ If reading the file fails, IoTHubClient_LL_UploadFileToBlob shall fail the upload and notify IoTHub of the failure. ]*/
+        /*a block bigger than the biggest block of a block blob fails the upload instead of committing a truncated blob*/
+        LogError("unable to read the file to upload");
+        *data = reader->block;
+        *size = SIZE_MAX;
+    }
+    else
+    {
+        *data = (readSize == 0) ? NULL : reader->block;
+        *size = readSize;
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadFileToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const char* filePath)
+{
+    IOTHUB_CLIENT_RESULT result;
+    FILE_BLOCK_READER reader;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_083: [ If handle, destinationFileName or filePath is NULL then IoTHubClient_LL_UploadFileToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((handle == NULL) || (destinationFileName == NULL) || (filePath == NULL))
+    {
+        LogError("invalid argument detected handle=%p destinationFileName=%p filePath=%p", handle, destinationFileName, filePath);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_084: [ If the file cannot be opened or the block buffer cannot be allocated then IoTHubClient_LL_UploadFileToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+    else if ((reader.file = fopen(filePath, "rb")) == NULL)
+    {
+        LogError("unable to open file %s", filePath);
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        if ((reader.block = (unsigned char*)malloc(FILE_BLOCK_SIZE)) == NULL)
+        {
+            LogError("unable to malloc");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = uploadToBlob(handle, destinationFileName, NULL, 0, readFileBlock, &reader);
+            free(reader.block);
+        }
+        (void)fclose(reader.file);
+    }
+    return result;
+}
+
+/*returns 0 when the SAS URI of a file of a batch has been received, the file then has everything its steps 2 and 3 need*/
+static int requestBatchFileSasUri(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData, HTTPAPIEX_HANDLE iotHubHttpApiExHandle, const char* destinationFileName, FILE_UPLOAD_BATCH_FILE* batchFile)
+{
+    int result;
+    batchFile->sasUri = NULL;
+    batchFile->requestHttpHeaders = NULL;
+    batchFile->responseToIoTHub = NULL;
+
+    if (
+        ((batchFile->correlationId = STRING_new()) == NULL) ||
+        ((batchFile->sasUri = STRING_new()) == NULL) ||
+        ((batchFile->requestHttpHeaders = HTTPHeaders_Alloc()) == NULL) ||
+        ((batchFile->responseToIoTHub = BUFFER_new()) == NULL)
+        )
+    {
+        LogError("unable to allocate the upload of %s", destinationFileName);
+        result = __FAILURE__;
+    }
+    else if (IoTHubClient_LL_UploadToBlob_step1and2(handleData, iotHubHttpApiExHandle, batchFile->requestHttpHeaders, destinationFileName, batchFile->correlationId, batchFile->sasUri) != 0)
+    {
+        LogError("error in IoTHubClient_LL_UploadToBlob_step1 of %s", destinationFileName);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static void deinitBatchFile(FILE_UPLOAD_BATCH_FILE* batchFile)
+{
+    if (batchFile->responseToIoTHub != NULL)
+    {
+        BUFFER_delete(batchFile->responseToIoTHub);
+    }
+    if (batchFile->requestHttpHeaders != NULL)
+    {
+        HTTPHeaders_Free(batchFile->requestHttpHeaders);
+    }
+    if (batchFile->sasUri != NULL)
+    {
+        STRING_delete(batchFile->sasUri);
+    }
+    if (batchFile->correlationId != NULL)
+    {
+        STRING_delete(batchFile->correlationId);
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM* items, size_t itemCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+    size_t i;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_093: [ If handle or items is NULL or itemCount is 0 then IoTHubClient_LL_UploadMultipleToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((handle == NULL) || (items == NULL) || (itemCount == 0))
+    {
+        LogError("invalid argument detected handle=%p items=%p itemCount=%zu", handle, items, itemCount);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_094: [ If the destinationFileName of a file is NULL, or its source is NULL and its size greater than 0, then IoTHubClient_LL_UploadMultipleToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG before uploading any file. ]*/
+        for (i = 0; i < itemCount; i++)
+        {
+            if ((items[i].destinationFileName == NULL) || ((items[i].source == NULL) && (items[i].size > 0)))
+            {
+                break;
+            }
+        }
+
+        if (i < itemCount)
+        {
+            LogError("invalid file %zu in the batch destinationFileName=%p source=%p size=%zu", i, items[i].destinationFileName, items[i].source, items[i].size);
+            result = IOTHUB_CLIENT_INVALID_ARG;
+        }
+        else
+        {
+            IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle;
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_095: [ IoTHubClient_LL_UploadMultipleToBlob shall upload all the files on a single connection to IoTHub, taken and kept as IoTHubClient_LL_UploadToBlob does. ]*/
+            HTTPAPIEX_HANDLE iotHubHttpApiExHandle = openIotHubHttpApiExHandle(handleData);
+
+            for (i = 0; i < itemCount; i++)
+            {
+                items[i].result = IOTHUB_CLIENT_ERROR;
+            }
+
+            if (iotHubHttpApiExHandle == NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                size_t first;
+                result = IOTHUB_CLIENT_OK;
+                for (first = 0; first < itemCount; first += FILE_UPLOAD_BATCH_WINDOW)
+                {
+                    FILE_UPLOAD_BATCH_FILE batchFiles[FILE_UPLOAD_BATCH_WINDOW];
+                    size_t windowSize = ((itemCount - first) < FILE_UPLOAD_BATCH_WINDOW) ? (itemCount - first) : FILE_UPLOAD_BATCH_WINDOW;
+
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_096: [ IoTHubClient_LL_UploadMultipleToBlob shall take the files 10 at a time and request the SAS URIs of all of them (step 1) before uploading any of them to storage. ]*/
+                    for (i = 0; i < windowSize; i++)
+                    {
+                        batchFiles[i].hasSasUri = (requestBatchFileSasUri(handleData, iotHubHttpApiExHandle, items[first + i].destinationFileName, &batchFiles[i]) == 0);
+                    }
+
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_097: [ IoTHubClient_LL_UploadMultipleToBlob shall then upload to storage every file of the 10 that has its SAS URI, as IoTHubClient_LL_UploadToBlob does. ]*/
+                    for (i = 0; i < windowSize; i++)
+                    {
+                        if (batchFiles[i].hasSasUri)
+                        {
+                            batchFiles[i].step2success = uploadToSasUri(handleData, batchFiles[i].sasUri, items[first + i].source, items[first + i].size, NULL, NULL, &batchFiles[i].httpResponse, batchFiles[i].responseToIoTHub);
+                        }
+                    }
+
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_098: [ IoTHubClient_LL_UploadMultipleToBlob shall then notify IoTHub of the completion of these uploads one right after the other (step 3) and set the result of every file in its result. ]*/
+                    for (i = 0; i < windowSize; i++)
+                    {
+                        if (batchFiles[i].hasSasUri)
+                        {
+                            items[first + i].result = notifyUploadResult(handleData, batchFiles[i].correlationId, iotHubHttpApiExHandle, batchFiles[i].requestHttpHeaders, batchFiles[i].step2success, batchFiles[i].httpResponse, batchFiles[i].responseToIoTHub);
                         }
-                        STRING_delete(correlationId);
+
+                        /*Codes_SRS_IOTHUBCLIENT_LL_41_099: [ A file that fails shall not stop the upload of the others, IoTHubClient_LL_UploadMultipleToBlob shall return IOTHUB_CLIENT_OK when all the files were uploaded and IOTHUB_CLIENT_ERROR otherwise. ]*/
+                        if (items[first + i].result != IOTHUB_CLIENT_OK)
+                        {
+                            result = IOTHUB_CLIENT_ERROR;
+                        }
+                        deinitBatchFile(&batchFiles[i]);
                     }
                 }
+
+                releaseIotHubHttpApiExHandle(handleData, iotHubHttpApiExHandle, (result == IOTHUB_CLIENT_OK));
             }
-            HTTPAPIEX_Destroy(iotHubHttpApiExHandle);
         }
     }
     return result;
@@ -916,6 +1269,14 @@ void IoTHubClient_LL_UploadToBlob_Destroy(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h
                 break;
             }
         }
+        if (handleData->idleIotHubHttpApiExHandle != NULL)
+        {
+            HTTPAPIEX_Destroy(handleData->idleIotHubHttpApiExHandle);
+        }
+        if (handleData->idleIotHubHttpApiExLock != NULL)
+        {
+            (void)Lock_Deinit(handleData->idleIotHubHttpApiExLock);
+        }
         free((void*)handleData->hostname);
         STRING_delete(handleData->deviceId);
         if (handleData->certificates != NULL)
@@ -967,6 +1328,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_SetOption(IOTHUB_CLIENT_LL_UPL
                         free((void*)handleData->credentials.x509credentials.x509certificate);
                     }
                     handleData->credentials.x509credentials.x509certificate = temp;
+                    dropIdleIotHubHttpApiExHandle(handleData);
                     result = IOTHUB_CLIENT_OK;
                 }
             }
@@ -999,6 +1361,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_SetOption(IOTHUB_CLIENT_LL_UPL
                         free((void*)handleData->credentials.x509credentials.x509privatekey);
                     }
                     handleData->credentials.x509credentials.x509privatekey = temp;
+                    dropIdleIotHubHttpApiExHandle(handleData);
                     result = IOTHUB_CLIENT_OK;
                 }
             }
@@ -1025,10 +1388,93 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_SetOption(IOTHUB_CLIENT_LL_UPL
                         free(handleData->certificates);
                     }
                     handleData->certificates = tempCopy;
+                    dropIdleIotHubHttpApiExHandle(handleData);
                     result = IOTHUB_CLIENT_OK;
                 }
             }
         }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_075: [ blob_upload_keep_connection - then value is a pointer to a bool that tells whether the connection to IoTHub of an upload is kept for the next one. ]*/
+        else if (strcmp(OPTION_BLOB_UPLOAD_KEEP_CONNECTION, optionName) == 0)
+        {
+            if (value == NULL)
+            {
+                LogError("NULL is a not a valid value for %s", OPTION_BLOB_UPLOAD_KEEP_CONNECTION);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else if (*(const bool*)value && (handleData->idleIotHubHttpApiExLock == NULL) &&
+                ((handleData->idleIotHubHttpApiExLock = Lock_Init()) == NULL))
+            {
+                LogError("unable to Lock_Init");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                handleData->keepIotHubConnection = *(const bool*)value;
+                if (!handleData->keepIotHubConnection)
+                {
+                    dropIdleIotHubHttpApiExHandle(handleData);
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_078: [ blob_upload_concurrency - then value is a pointer to a size_t with the number of blocks of a blob of 64MB or more uploaded to storage at the same time. ]*/
+        else if (strcmp(OPTION_BLOB_UPLOAD_CONCURRENCY, optionName) == 0)
+        {
+            if (value == NULL)
+            {
+                LogError("NULL is a not a valid value for %s", OPTION_BLOB_UPLOAD_CONCURRENCY);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->blobUploadConcurrency = *(const size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_088: [ blob_upload_block_retries - then value is a pointer to a size_t with the number of times a block that failed to reach storage, or that storage answered with 408, 429 or 5xx, is put again before the upload fails. ]*/
+        else if (strcmp(OPTION_BLOB_UPLOAD_BLOCK_RETRIES, optionName) == 0)
+        {
+            if (value == NULL)
+            {
+                LogError("NULL is a not a valid value for %s", OPTION_BLOB_UPLOAD_BLOCK_RETRIES);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->blobUploadBlockRetries = *(const size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_090: [ blob_upload_progress - then value is a pointer to an IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_REPORTING with the callback called after every block put in storage, a NULL progressCallback stops the reporting. ]*/
+        else if (strcmp(OPTION_BLOB_UPLOAD_PROGRESS, optionName) == 0)
+        {
+            if (value == NULL)
+            {
+                LogError("NULL is a not a valid value for %s", OPTION_BLOB_UPLOAD_PROGRESS);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                const IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_REPORTING* progressReporting = (const IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_REPORTING*)value;
+                handleData->progressCallback = progressReporting->progressCallback;
+                handleData->progressUserContextCallback = progressReporting->progressUserContextCallback;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_092: [ blob_upload_block_crc64 - then value is a pointer to a bool that tells whether every block is sent with its CRC64 for storage to refuse the blocks corrupted on the way. ]*/
+        else if (strcmp(OPTION_BLOB_UPLOAD_BLOCK_CRC64, optionName) == 0)
+        {
+            if (value == NULL)
+            {
+                LogError("NULL is a not a valid value for %s", OPTION_BLOB_UPLOAD_BLOCK_CRC64);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->computeBlockCrc64 = *(const bool*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else
         {
             /*Codes_SRS_IOTHUBCLIENT_LL_02_102: [ If an unknown option is presented then IoTHubClient_LL_UploadToBlob_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "iothub_client_log_limit.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/*not tickcounter nor get_time: the hot paths log where the tests expect their exact calls*/
+static int get_monotonic_ms(uint64_t* now_ms)
+{
+    int result;
+#if defined(_WIN32)
+    *now_ms = (uint64_t)GetTickCount64();
+    result = 0;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        *now_ms = (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+        result = 0;
+    }
+#else
+    (void)now_ms;
+    result = __LINE__;
+#endif
+    return result;
+}
+
+int iothub_client_log_limit_check(IOTHUB_CLIENT_LOG_LIMIT* limit, size_t* suppressed)
+{
+    int result;
+    uint64_t now_ms;
+
+    *suppressed = 0;
+
+    if (get_monotonic_ms(&now_ms) != 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_004: [ If the platform has no monotonic clock, iothub_client_log_limit_check shall let every message be logged. ]*/
+        result = 1;
+    }
+    else if ((limit->loggedInInterval == 0) || (now_ms - limit->intervalStart >= IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_001: [ The first message of a call site, and the first one after IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS have passed since an interval started, shall start a new interval and be logged. ]*/
+        /*Codes_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_003: [ When a message is logged after some were suppressed, iothub_client_log_limit_check shall set suppressed to their number and start counting them again from 0. ]*/
+        limit->intervalStart = now_ms;
+        limit->loggedInInterval = 1;
+        *suppressed = limit->suppressed;
+        limit->suppressed = 0;
+        result = 1;
+    }
+    else if (limit->loggedInInterval < IOTHUB_CLIENT_LOG_LIMIT_BURST)
+    {
+        limit->loggedInInterval++;
+        result = 1;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_002: [ After IOTHUB_CLIENT_LOG_LIMIT_BURST messages have been logged in an interval, iothub_client_log_limit_check shall count the others of the interval as suppressed and return 0. ]*/
+        limit->suppressed++;
+        result = 0;
+    }
+
+    return result;
+}
@@ -0,0 +1,323 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+
+#include "iothub_client_memory.h"
+#include "iothub_client_memory_pool.h"
+
+#ifdef USE_MEMORY_ACCOUNTING
+
+#define SUBSYSTEM_COUNT             ((size_t)IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER + 1)
+#define INITIAL_TABLE_CAPACITY      1024
+
+/*the allocations are found by their address in an open addressing table, not in a header in front of them:
+  a pointer allocated by an untagged file or freed by one is then only a missed entry*/
+typedef struct ALLOCATION_ENTRY_TAG
+{
+    void* ptr;
+    size_t size;
+    IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem;
+} ALLOCATION_ENTRY;
+
+static LOCK_HANDLE accounting_lock = NULL;
+static ALLOCATION_ENTRY* allocation_table = NULL;
+static size_t allocation_table_capacity = 0;
+static size_t allocation_table_count = 0;
+static IOTHUB_CLIENT_MEMORY_USAGE subsystem_usage[SUBSYSTEM_COUNT];
+
+static size_t hash_pointer(const void* ptr, size_t capacity)
+{
+    /*the low bits of an address are the alignment of the heap, Fibonacci hashing mixes the others in*/
+    uint64_t key = (uint64_t)(uintptr_t)ptr;
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+/*the lock is made by the first tagged allocation, which is on the thread creating the first client, before any thread of the SDK runs*/
+static int lock_accounting(void)
+{
+    int result;
+    if ((accounting_lock == NULL) && ((accounting_lock = Lock_Init()) == NULL))
+    {
+        LogError("unable to create the lock of the memory accounting");
+        result = __FAILURE__;
+    }
+    else if (Lock(accounting_lock) != LOCK_OK)
+    {
+        LogError("unable to lock the memory accounting");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static void unlock_accounting(void)
+{
+    (void)Unlock(accounting_lock);
+}
+
+static ALLOCATION_ENTRY* find_entry(const void* ptr)
+{
+    ALLOCATION_ENTRY* result = NULL;
+    if (allocation_table_count != 0)
+    {
+        size_t index = hash_pointer(ptr, allocation_table_capacity);
+        while (allocation_table[index].ptr != NULL)
+        {
+            if (allocation_table[index].ptr == ptr)
+            {
+                result = &allocation_table[index];
+                break;
+            }
+            index = (index + 1) & (allocation_table_capacity - 1);
+        }
+    }
+    return result;
+}
+
+static void place_entry(ALLOCATION_ENTRY* table, size_t capacity, const ALLOCATION_ENTRY* entry)
+{
+    size_t index = hash_pointer(entry->ptr, capacity);
+    while (table[index].ptr != NULL)
+    {
+        index = (index + 1) & (capacity - 1);
+    }
+    table[index] = *entry;
+}
+
+static int grow_table(void)
+{
+    int result;
+    size_t new_capacity = (allocation_table_capacity == 0) ? INITIAL_TABLE_CAPACITY : (allocation_table_capacity * 2);
+    ALLOCATION_ENTRY* new_table;
+
+    if ((new_capacity < allocation_table_capacity) || (new_capacity > SIZE_MAX / sizeof(ALLOCATION_ENTRY)) ||
+        ((new_table = (ALLOCATION_ENTRY*)malloc(new_capacity * sizeof(ALLOCATION_ENTRY))) == NULL))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+        (void)memset(new_table, 0, new_capacity * sizeof(ALLOCATION_ENTRY));
+        for (i = 0; i < allocation_table_capacity; i++)
+        {
+            if (allocation_table[i].ptr != NULL)
+            {
+                place_entry(new_table, new_capacity, &allocation_table[i]);
+            }
+        }
+        free(allocation_table);
+        allocation_table = new_table;
+        allocation_table_capacity = new_capacity;
+        result = 0;
+    }
+    return result;
+}
+
+static void remove_entry(ALLOCATION_ENTRY* entry)
+{
+    size_t hole = (size_t)(entry - allocation_table);
+    size_t index = hole;
+    IOTHUB_CLIENT_MEMORY_USAGE* usage = &subsystem_usage[entry->subsystem];
+
+    usage->currentBytes -= entry->size;
+    usage->currentAllocations--;
+    allocation_table_count--;
+
+    /*backward shift: the entries after the hole that hash at or before it move into it, so lookups never need tombstones*/
+    allocation_table[hole].ptr = NULL;
+    while (1)
+    {
+        size_t home;
+        index = (index + 1) & (allocation_table_capacity - 1);
+        if (allocation_table[index].ptr == NULL)
+        {
+            break;
+        }
+        home = hash_pointer(allocation_table[index].ptr, allocation_table_capacity);
+        if (((index - home) & (allocation_table_capacity - 1)) >= ((index - hole) & (allocation_table_capacity - 1)))
+        {
+            allocation_table[hole] = allocation_table[index];
+            allocation_table[index].ptr = NULL;
+            hole = index;
+        }
+    }
+}
+
+static void add_entry(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, void* ptr, size_t size)
+{
+    ALLOCATION_ENTRY entry;
+    ALLOCATION_ENTRY* stale;
+
+    /*an address freed by an untagged file and handed out again*/
+    if ((stale = find_entry(ptr)) != NULL)
+    {
+        remove_entry(stale);
+    }
+
+    if (((allocation_table_count + 1) * 2 > allocation_table_capacity) && (grow_table() != 0))
+    {
+        /*not counted, its free is then a missed entry*/
+        LogError("unable to grow the memory accounting table");
+    }
+    else
+    {
+        IOTHUB_CLIENT_MEMORY_USAGE* usage = &subsystem_usage[subsystem];
+        entry.ptr = ptr;
+        entry.size = size;
+        entry.subsystem = subsystem;
+        place_entry(allocation_table, allocation_table_capacity, &entry);
+        allocation_table_count++;
+
+        usage->currentBytes += size;
+        usage->currentAllocations++;
+        usage->totalAllocations++;
+        if (usage->currentBytes > usage->peakBytes)
+        {
+            usage->peakBytes = usage->currentBytes;
+        }
+    }
+}
+
+static void account_allocation(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, void* ptr, size_t size)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_001: [ iothub_client_memory_malloc, iothub_client_memory_calloc and iothub_client_memory_realloc shall count the allocations they return to subsystem. ]*/
+    if (((size_t)subsystem < SUBSYSTEM_COUNT) && (lock_accounting() == 0))
+    {
+        add_entry(subsystem, ptr, size);
+        unlock_accounting();
+    }
+}
+
+static void account_reallocation(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, void* ptr, void* result, size_t size)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_002: [ iothub_client_memory_realloc shall count a moved or resized allocation to the subsystem of ptr, or to subsystem if ptr was not counted, and leave it counted if realloc fails. ]*/
+    if (((result != NULL) || ((ptr != NULL) && (size == 0))) && (lock_accounting() == 0))
+    {
+        ALLOCATION_ENTRY* entry;
+        if ((ptr != NULL) && ((entry = find_entry(ptr)) != NULL))
+        {
+            subsystem = entry->subsystem;
+            remove_entry(entry);
+        }
+        if ((result != NULL) && ((size_t)subsystem < SUBSYSTEM_COUNT))
+        {
+            add_entry(subsystem, result, size);
+        }
+        unlock_accounting();
+    }
+}
+
+static void account_free(void* ptr)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_003: [ iothub_client_memory_free shall free ptr and remove it from its subsystem, a ptr that was not counted only being freed. ]*/
+    if ((ptr != NULL) && (allocation_table_count != 0) && (lock_accounting() == 0))
+    {
+        ALLOCATION_ENTRY* entry = find_entry(ptr);
+        if (entry != NULL)
+        {
+            remove_entry(entry);
+        }
+        unlock_accounting();
+    }
+}
+
+#endif /* USE_MEMORY_ACCOUNTING */
+
+#if defined(USE_MEMORY_ACCOUNTING) || defined(USE_STATIC_MEMORY_POOLS)
+
+#ifdef USE_STATIC_MEMORY_POOLS
+/*the tagged allocations come from the pools of iothub_client_memory_pool.h, which fall back to the heap*/
+#define memory_backend_malloc(size)         iothub_client_memory_pool_malloc(size)
+#define memory_backend_calloc(nmemb, size)  iothub_client_memory_pool_calloc(nmemb, size)
+#define memory_backend_realloc(ptr, size)   iothub_client_memory_pool_realloc(ptr, size)
+#define memory_backend_free(ptr)            iothub_client_memory_pool_free(ptr)
+#else
+#define memory_backend_malloc(size)         malloc(size)
+#define memory_backend_calloc(nmemb, size)  calloc(nmemb, size)
+#define memory_backend_realloc(ptr, size)   realloc(ptr, size)
+#define memory_backend_free(ptr)            free(ptr)
+#endif
+
+#ifndef USE_MEMORY_ACCOUNTING
+#define account_allocation(subsystem, ptr, size) (void)(subsystem)
+#define account_reallocation(subsystem, ptr, result, size) (void)(subsystem)
+#define account_free(ptr)
+#endif
+
+void* iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, size_t size)
+{
+    void* result = memory_backend_malloc(size);
+    if (result != NULL)
+    {
+        account_allocation(subsystem, result, size);
+    }
+    return result;
+}
+
+void* iothub_client_memory_calloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, size_t nmemb, size_t size)
+{
+    /*calloc fails when nmemb * size overflows*/
+    void* result = memory_backend_calloc(nmemb, size);
+    if (result != NULL)
+    {
+        account_allocation(subsystem, result, nmemb * size);
+    }
+    return result;
+}
+
+void* iothub_client_memory_realloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, void* ptr, size_t size)
+{
+    void* result = memory_backend_realloc(ptr, size);
+    account_reallocation(subsystem, ptr, result, size);
+    return result;
+}
+
+void iothub_client_memory_free(void* ptr)
+{
+    account_free(ptr);
+    memory_backend_free(ptr);
+}
+
+#endif /* USE_MEMORY_ACCOUNTING || USE_STATIC_MEMORY_POOLS */
+
+IOTHUB_CLIENT_RESULT IoTHubClient_GetMemoryUsage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem, IOTHUB_CLIENT_MEMORY_USAGE* usage)
+{
+    IOTHUB_CLIENT_RESULT result;
+#ifdef USE_MEMORY_ACCOUNTING
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_004: [ If usage is NULL or subsystem is not an IOTHUB_CLIENT_MEMORY_SUBSYSTEM, IoTHubClient_GetMemoryUsage shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((usage == NULL) || ((size_t)subsystem >= SUBSYSTEM_COUNT))
+    {
+        LogError("invalid argument usage=%p subsystem=%d", usage, (int)subsystem);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (lock_accounting() != 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_005: [ If locking the accounting fails, IoTHubClient_GetMemoryUsage shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_006: [ IoTHubClient_GetMemoryUsage shall copy the bytes and allocations currently counted to subsystem, the peak of its bytes and the number of allocations counted to it so far into usage, and return IOTHUB_CLIENT_OK. ]*/
+        *usage = subsystem_usage[subsystem];
+        unlock_accounting();
+        result = IOTHUB_CLIENT_OK;
+    }
+#else
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_007: [ Unless the SDK is built with use_memory_accounting, IoTHubClient_GetMemoryUsage shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+    (void)subsystem;
+    (void)usage;
+    LogError("the SDK is built without use_memory_accounting");
+    result = IOTHUB_CLIENT_ERROR;
+#endif
+    return result;
+}
@@ -0,0 +1,506 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+
+#include "iothub_client_memory_pool.h"
+#include "iothub_client_log_limit.h"
+
+/*the blocks are aligned for any type, like what malloc returns*/
+typedef union POOL_MAX_ALIGN_TAG
+{
+    long long integer;
+    long double floating;
+    void* pointer;
+    void(*function)(void);
+} POOL_MAX_ALIGN;
+
+#define POOL_ALIGNMENT              sizeof(POOL_MAX_ALIGN)
+#define ROUND_UP_TO_ALIGNMENT(size) ((((size) + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT) * POOL_ALIGNMENT)
+
+/*per message: the message and its queue entry, the ids and properties the transports copy, one copy of the payload;
+  and for the client, the transport and their handles a few large blocks*/
+#define DEFAULT_SMALL_BLOCK_SIZE        32
+#define DEFAULT_LARGE_BLOCK_SIZE        4096
+#define DEFAULT_SPARE_BLOCKS            16
+
+static const IOTHUB_CLIENT_MEMORY_POOL_CLASS DEFAULT_CLASSES[] =
+{
+    { DEFAULT_SMALL_BLOCK_SIZE, DEFAULT_SPARE_BLOCKS * 2 },
+    { 64, DEFAULT_SPARE_BLOCKS * 2 },
+    { 128, DEFAULT_SPARE_BLOCKS * 2 },
+    { 256, DEFAULT_SPARE_BLOCKS },
+    { 512, DEFAULT_SPARE_BLOCKS },
+    { 1024, 8 },
+    { DEFAULT_LARGE_BLOCK_SIZE, 4 }
+};
+
+#define DEFAULT_CLASS_COUNT (sizeof(DEFAULT_CLASSES) / sizeof(DEFAULT_CLASSES[0]))
+
+static size_t add_blocks(size_t count, size_t more)
+{
+    return (count > SIZE_MAX - more) ? SIZE_MAX : (count + more);
+}
+
+static size_t multiply_blocks(size_t count, size_t factor)
+{
+    return ((factor != 0) && (count > SIZE_MAX / factor)) ? SIZE_MAX : (count * factor);
+}
+
+size_t IoTHubClient_MemoryPool_GetDefaultClasses(const IOTHUB_CLIENT_MEMORY_POOL_LIMITS* limits, IOTHUB_CLIENT_MEMORY_POOL_CLASS* classes)
+{
+    size_t result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_001: [ If limits or classes is NULL, or maxInFlightMessages or maxMessageSize is 0, IoTHubClient_MemoryPool_GetDefaultClasses shall return 0. ]*/
+    if ((limits == NULL) || (classes == NULL) || (limits->maxInFlightMessages == 0) || (limits->maxMessageSize == 0))
+    {
+        LogError("invalid argument limits=%p classes=%p", limits, classes);
+        result = 0;
+    }
+    else
+    {
+        size_t messages = limits->maxInFlightMessages;
+        size_t index;
+
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_002: [ IoTHubClient_MemoryPool_GetDefaultClasses shall fill classes of 32 to 4096 bytes with blocks for maxInFlightMessages messages of maxProperties properties, plus a block of maxMessageSize bytes per message, and return the number of classes it filled. ]*/
+        (void)memcpy(classes, DEFAULT_CLASSES, sizeof(DEFAULT_CLASSES));
+        classes[0].blockCount = add_blocks(classes[0].blockCount, multiply_blocks(messages, add_blocks(multiply_blocks(limits->maxProperties, 2), 4)));
+        classes[1].blockCount = add_blocks(classes[1].blockCount, multiply_blocks(messages, 2));
+        classes[2].blockCount = add_blocks(classes[2].blockCount, multiply_blocks(messages, 2));
+        classes[3].blockCount = add_blocks(classes[3].blockCount, messages);
+        result = DEFAULT_CLASS_COUNT;
+
+        if (limits->maxMessageSize > DEFAULT_LARGE_BLOCK_SIZE)
+        {
+            classes[result].blockSize = limits->maxMessageSize;
+            classes[result].blockCount = messages;
+            result++;
+        }
+        else
+        {
+            for (index = 0; index < DEFAULT_CLASS_COUNT; index++)
+            {
+                if (classes[index].blockSize >= limits->maxMessageSize)
+                {
+                    classes[index].blockCount = add_blocks(classes[index].blockCount, messages);
+                    break;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+size_t IoTHubClient_MemoryPool_GetRequiredSize(const IOTHUB_CLIENT_MEMORY_POOL_CLASS* classes, size_t classCount)
+{
+    /*the memory given to init is aligned first*/
+    size_t result = POOL_ALIGNMENT - 1;
+    size_t index;
+
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_003: [ If classes is NULL, classCount is 0 or more than IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES, a class has no block or a 0 blockSize, or the blockSizes are not ascending, IoTHubClient_MemoryPool_GetRequiredSize shall return 0. ]*/
+    if ((classes == NULL) || (classCount == 0) || (classCount > IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES))
+    {
+        LogError("invalid argument classes=%p classCount=%lu", classes, (unsigned long)classCount);
+        result = 0;
+    }
+    else
+    {
+        for (index = 0; index < classCount; index++)
+        {
+            size_t blockSize = classes[index].blockSize;
+            if ((blockSize == 0) || (classes[index].blockCount == 0) ||
+                ((index != 0) && (blockSize <= classes[index - 1].blockSize)) ||
+                (blockSize > SIZE_MAX - POOL_ALIGNMENT))
+            {
+                LogError("invalid class %lu: blockSize=%lu blockCount=%lu", (unsigned long)index, (unsigned long)blockSize, (unsigned long)classes[index].blockCount);
+                result = 0;
+                break;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_004: [ IoTHubClient_MemoryPool_GetRequiredSize shall return the size of the blocks of all the classes, each rounded up to the alignment of malloc, plus the alignment of the memory, or 0 if it overflows. ]*/
+                size_t classSize = multiply_blocks(ROUND_UP_TO_ALIGNMENT(blockSize), classes[index].blockCount);
+                if ((classSize == SIZE_MAX) || (result > SIZE_MAX - classSize))
+                {
+                    LogError("the blocks of class %lu do not fit in a size_t", (unsigned long)index);
+                    result = 0;
+                    break;
+                }
+                result += classSize;
+            }
+        }
+    }
+
+    return result;
+}
+
+#ifdef USE_STATIC_MEMORY_POOLS
+
+typedef struct POOL_CLASS_TAG
+{
+    size_t blockSize;
+    size_t blockCount;
+    unsigned char* start;
+    unsigned char* end;
+    /*the free blocks are linked through their first bytes*/
+    void* freeList;
+    size_t blocksInUse;
+    size_t peakBlocksInUse;
+    size_t exhaustions;
+} POOL_CLASS;
+
+static POOL_CLASS pool_classes[IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES];
+static size_t pool_class_count = 0;
+static unsigned char* pool_start = NULL;
+static unsigned char* pool_end = NULL;
+static LOCK_HANDLE pool_lock = NULL;
+static bool pool_init_ended = false;
+
+static POOL_CLASS* find_class_of(const void* ptr)
+{
+    POOL_CLASS* result = NULL;
+    if ((pool_class_count != 0) && ((const unsigned char*)ptr >= pool_start) && ((const unsigned char*)ptr < pool_end))
+    {
+        size_t index;
+        for (index = 0; index < pool_class_count; index++)
+        {
+            if ((const unsigned char*)ptr < pool_classes[index].end)
+            {
+                result = &pool_classes[index];
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+/*called with the lock taken*/
+static void* take_block(size_t size)
+{
+    void* result = NULL;
+    POOL_CLASS* fitting = NULL;
+    size_t index;
+
+    for (index = 0; index < pool_class_count; index++)
+    {
+        POOL_CLASS* poolClass = &pool_classes[index];
+        if (poolClass->blockSize >= size)
+        {
+            if (fitting == NULL)
+            {
+                fitting = poolClass;
+            }
+            if (poolClass->freeList != NULL)
+            {
+                result = poolClass->freeList;
+                poolClass->freeList = *(void**)result;
+                poolClass->blocksInUse++;
+                if (poolClass->blocksInUse > poolClass->peakBlocksInUse)
+                {
+                    poolClass->peakBlocksInUse = poolClass->blocksInUse;
+                }
+                break;
+            }
+        }
+    }
+
+    if ((result == NULL) && pool_init_ended)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_010: [ After IoTHubClient_MemoryPool_EndInit, an allocation no class from the smallest fitting one up has a free block for shall fail, be logged and be counted in the exhaustions of the smallest fitting class, or of the largest class if none fits. ]*/
+        if (fitting == NULL)
+        {
+            fitting = &pool_classes[pool_class_count - 1];
+        }
+        fitting->exhaustions++;
+        LogErrorLimited("the memory pools have no free block of %lu bytes (class of %lu bytes, %lu blocks)", (unsigned long)size, (unsigned long)fitting->blockSize, (unsigned long)fitting->blockCount);
+    }
+
+    return result;
+}
+
+/*called with the lock taken*/
+static void return_block(POOL_CLASS* poolClass, void* ptr)
+{
+    *(void**)ptr = poolClass->freeList;
+    poolClass->freeList = ptr;
+    poolClass->blocksInUse--;
+}
+
+/*an allocation the pools do not serve comes from the heap until the end of the initialization, NULL after it*/
+static void* pool_allocate(size_t size)
+{
+    void* result;
+
+    if (pool_class_count == 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_008: [ Before IoTHubClient_MemoryPool_Init and after IoTHubClient_MemoryPool_Deinit, the allocations shall come from the heap. ]*/
+        result = malloc(size);
+    }
+    else if (Lock(pool_lock) != LOCK_OK)
+    {
+        LogError("unable to lock the memory pools");
+        result = NULL;
+    }
+    else
+    {
+        bool fromHeap;
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_009: [ An allocation shall take a block of the smallest class whose blockSize fits it and that has a free block, or until IoTHubClient_MemoryPool_EndInit come from the heap if there is none. ]*/
+        result = take_block((size == 0) ? 1 : size);
+        fromHeap = (result == NULL) && !pool_init_ended;
+        (void)Unlock(pool_lock);
+
+        if (fromHeap)
+        {
+            result = malloc(size);
+        }
+    }
+
+    return result;
+}
+
+static void pool_release(void* ptr)
+{
+    POOL_CLASS* poolClass = (ptr == NULL) ? NULL : find_class_of(ptr);
+
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_011: [ iothub_client_memory_pool_free shall return a block to its class, and free to the heap a ptr that is not in the memory of the pools. ]*/
+    if (poolClass == NULL)
+    {
+        free(ptr);
+    }
+    else if (Lock(pool_lock) != LOCK_OK)
+    {
+        /*the block is lost, not handed out twice*/
+        LogError("unable to lock the memory pools, a block of %lu bytes is lost", (unsigned long)poolClass->blockSize);
+    }
+    else
+    {
+        return_block(poolClass, ptr);
+        (void)Unlock(pool_lock);
+    }
+}
+
+void* iothub_client_memory_pool_malloc(size_t size)
+{
+    return pool_allocate(size);
+}
+
+void* iothub_client_memory_pool_calloc(size_t nmemb, size_t size)
+{
+    void* result;
+
+    if ((size != 0) && (nmemb > SIZE_MAX / size))
+    {
+        LogError("calloc of %lu elements of %lu bytes overflows", (unsigned long)nmemb, (unsigned long)size);
+        result = NULL;
+    }
+    else if ((result = pool_allocate(nmemb * size)) != NULL)
+    {
+        (void)memset(result, 0, nmemb * size);
+    }
+
+    return result;
+}
+
+void* iothub_client_memory_pool_realloc(void* ptr, size_t size)
+{
+    void* result;
+    POOL_CLASS* poolClass;
+
+    if (ptr == NULL)
+    {
+        result = pool_allocate(size);
+    }
+    else if (size == 0)
+    {
+        pool_release(ptr);
+        result = NULL;
+    }
+    else if ((poolClass = find_class_of(ptr)) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_013: [ iothub_client_memory_pool_realloc shall realloc on the heap a ptr that is not in the memory of the pools until IoTHubClient_MemoryPool_EndInit, and fail after it. ]*/
+        if (pool_init_ended)
+        {
+            /*its size is not known, it cannot be moved into a block*/
+            LogError("unable to grow an allocation made on the heap during the initialization");
+            result = NULL;
+        }
+        else
+        {
+            result = realloc(ptr, size);
+        }
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_012: [ iothub_client_memory_pool_realloc shall return ptr when size fits in its block, and otherwise allocate a new block, copy the old block into it and return the old block to its class. ]*/
+    else if (size <= poolClass->blockSize)
+    {
+        result = ptr;
+    }
+    else if ((result = pool_allocate(size)) != NULL)
+    {
+        (void)memcpy(result, ptr, poolClass->blockSize);
+        pool_release(ptr);
+    }
+
+    return result;
+}
+
+void iothub_client_memory_pool_free(void* ptr)
+{
+    pool_release(ptr);
+}
+
+#endif /* USE_STATIC_MEMORY_POOLS */
+
+IOTHUB_CLIENT_RESULT IoTHubClient_MemoryPool_Init(const IOTHUB_CLIENT_MEMORY_POOL_CLASS* classes, size_t classCount, void* memory, size_t size)
+{
+    IOTHUB_CLIENT_RESULT result;
+#ifdef USE_STATIC_MEMORY_POOLS
+    size_t requiredSize;
+
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_005: [ If memory is NULL, the classes are invalid or size is less than their required size, IoTHubClient_MemoryPool_Init shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((memory == NULL) || ((requiredSize = IoTHubClient_MemoryPool_GetRequiredSize(classes, classCount)) == 0) || (size < requiredSize))
+    {
+        LogError("invalid argument memory=%p size=%lu for %lu classes", memory, (unsigned long)size, (unsigned long)classCount);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (pool_class_count != 0)
+    {
+        LogError("the memory pools are already initialized");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((pool_lock = Lock_Init()) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_006: [ If the memory pools are already initialized or their lock cannot be created, IoTHubClient_MemoryPool_Init shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("unable to create the lock of the memory pools");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        unsigned char* block = (unsigned char*)memory + ((POOL_ALIGNMENT - ((uintptr_t)memory % POOL_ALIGNMENT)) % POOL_ALIGNMENT);
+        size_t index;
+
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_007: [ IoTHubClient_MemoryPool_Init shall carve the blocks of every class out of memory, aligned like malloc, and return IOTHUB_CLIENT_OK. ]*/
+        pool_start = block;
+        for (index = 0; index < classCount; index++)
+        {
+            POOL_CLASS* poolClass = &pool_classes[index];
+            size_t blockIndex;
+
+            (void)memset(poolClass, 0, sizeof(POOL_CLASS));
+            poolClass->blockSize = ROUND_UP_TO_ALIGNMENT(classes[index].blockSize);
+            poolClass->blockCount = classes[index].blockCount;
+            poolClass->start = block;
+            /*linked from the last block so that the first one is handed out first*/
+            for (blockIndex = poolClass->blockCount; blockIndex > 0; blockIndex--)
+            {
+                void* freeBlock = block + (blockIndex - 1) * poolClass->blockSize;
+                *(void**)freeBlock = poolClass->freeList;
+                poolClass->freeList = freeBlock;
+            }
+            block += poolClass->blockSize * poolClass->blockCount;
+            poolClass->end = block;
+        }
+        pool_end = block;
+        pool_init_ended = false;
+        pool_class_count = classCount;
+        result = IOTHUB_CLIENT_OK;
+    }
+#else
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_019: [ Unless the SDK is built with use_static_memory_pools, IoTHubClient_MemoryPool_Init and IoTHubClient_MemoryPool_GetStatistics shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+    (void)classes;
+    (void)classCount;
+    (void)memory;
+    (void)size;
+    LogError("the SDK is built without use_static_memory_pools");
+    result = IOTHUB_CLIENT_ERROR;
+#endif
+    return result;
+}
+
+void IoTHubClient_MemoryPool_EndInit(void)
+{
+#ifdef USE_STATIC_MEMORY_POOLS
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_014: [ IoTHubClient_MemoryPool_EndInit shall make the allocations the pools cannot serve fail from then on. ]*/
+    if (pool_class_count == 0)
+    {
+        LogError("the memory pools are not initialized");
+    }
+    else if (Lock(pool_lock) != LOCK_OK)
+    {
+        LogError("unable to lock the memory pools");
+    }
+    else
+    {
+        pool_init_ended = true;
+        (void)Unlock(pool_lock);
+    }
+#endif
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_MemoryPool_GetStatistics(size_t classIndex, IOTHUB_CLIENT_MEMORY_POOL_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+#ifdef USE_STATIC_MEMORY_POOLS
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_015: [ If statistics is NULL or classIndex is not the index of a class, IoTHubClient_MemoryPool_GetStatistics shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((statistics == NULL) || (classIndex >= pool_class_count))
+    {
+        LogError("invalid argument statistics=%p classIndex=%lu", statistics, (unsigned long)classIndex);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (Lock(pool_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_016: [ If locking the pools fails, IoTHubClient_MemoryPool_GetStatistics shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("unable to lock the memory pools");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_017: [ IoTHubClient_MemoryPool_GetStatistics shall copy the block size and count of the class, the blocks it has in use, their peak and its exhaustions into statistics, and return IOTHUB_CLIENT_OK. ]*/
+        const POOL_CLASS* poolClass = &pool_classes[classIndex];
+        statistics->blockSize = poolClass->blockSize;
+        statistics->blockCount = poolClass->blockCount;
+        statistics->blocksInUse = poolClass->blocksInUse;
+        statistics->peakBlocksInUse = poolClass->peakBlocksInUse;
+        statistics->exhaustions = poolClass->exhaustions;
+        (void)Unlock(pool_lock);
+        result = IOTHUB_CLIENT_OK;
+    }
+#else
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_019: [ Unless the SDK is built with use_static_memory_pools, IoTHubClient_MemoryPool_Init and IoTHubClient_MemoryPool_GetStatistics shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+    (void)classIndex;
+    (void)statistics;
+    LogError("the SDK is built without use_static_memory_pools");
+    result = IOTHUB_CLIENT_ERROR;
+#endif
+    return result;
+}
+
+void IoTHubClient_MemoryPool_Deinit(void)
+{
+#ifdef USE_STATIC_MEMORY_POOLS
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_018: [ IoTHubClient_MemoryPool_Deinit shall log the blocks still in use, destroy the lock and make the allocations come from the heap again. ]*/
+    if (pool_class_count != 0)
+    {
+        size_t index;
+        for (index = 0; index < pool_class_count; index++)
+        {
+            if (pool_classes[index].blocksInUse != 0)
+            {
+                LogError("%lu blocks of %lu bytes are still in use", (unsigned long)pool_classes[index].blocksInUse, (unsigned long)pool_classes[index].blockSize);
+            }
+        }
+        (void)Lock_Deinit(pool_lock);
+        pool_lock = NULL;
+        pool_class_count = 0;
+        pool_start = NULL;
+        pool_end = NULL;
+        pool_init_ended = false;
+    }
+#endif
+}
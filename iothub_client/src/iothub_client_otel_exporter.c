@@ -0,0 +1,1087 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#ifndef DONT_USE_OTLP_HTTP
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#endif
+
+#include "iothub_client_otel_exporter.h"
+#include "iothub_client_version.h"
+#include "iothub_message.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_OTEL_EXPORT_KIND, IOTHUB_CLIENT_OTEL_EXPORT_KIND_VALUES);
+
+#define MESSAGE_ID_MAX_LENGTH           64
+#define TRACE_ID_SIZE                   16
+#define SPAN_ID_SIZE                    8
+#define NS_PER_MS                       ((uint64_t)1000000)
+#define NS_PER_S                        ((uint64_t)1000000000)
+
+/*OTLP enums*/
+#define OTLP_AGGREGATION_TEMPORALITY_CUMULATIVE     2
+#define OTLP_SPAN_KIND_PRODUCER                     4
+#define OTLP_STATUS_CODE_OK                         1
+#define OTLP_STATUS_CODE_ERROR                      2
+
+#define OTEL_SCOPE "{\"name\":\"azure-iot-sdk-c\",\"version\":\"" IOTHUB_SDK_VERSION "\"}"
+#define METRICS_DOCUMENT_END "]}]}]}"
+#define SPANS_DOCUMENT_END "]}]}]}"
+
+typedef enum OTEL_SPAN_STATE_TAG
+{
+    OTEL_SPAN_FREE,
+    OTEL_SPAN_OPEN,
+    OTEL_SPAN_ENDED
+} OTEL_SPAN_STATE;
+
+typedef struct OTEL_SPAN_TAG
+{
+    OTEL_SPAN_STATE state;
+    const void* subject;
+    uint64_t startNs;
+    uint64_t publishNs;
+    uint64_t endNs;
+    uint64_t packetId;
+    bool published;
+    IOTHUB_CLIENT_CONFIRMATION_RESULT result;
+    unsigned char traceId[TRACE_ID_SIZE];
+    unsigned char spanId[SPAN_ID_SIZE];
+    char messageId[MESSAGE_ID_MAX_LENGTH];
+} OTEL_SPAN;
+
+typedef struct OTEL_CLIENT_TAG
+{
+    IOTHUB_CLIENT_HANDLE client;
+    IOTHUB_CLIENT_LL_HANDLE clientLL;
+    char* transportName;
+    char* deviceId;
+    uint64_t startUnixNs;
+    bool hasStatistics;
+    IOTHUB_CLIENT_STATISTICS statistics;
+} OTEL_CLIENT;
+
+typedef struct IOTHUB_CLIENT_OTEL_EXPORTER_TAG
+{
+    char* serviceName;
+    char* serviceInstanceId;
+    unsigned int intervalMs;
+    IOTHUB_CLIENT_OTEL_SINK sink;
+    void* sinkContext;
+#ifndef DONT_USE_OTLP_HTTP
+    HTTPAPIEX_HANDLE httpApiEx;
+    HTTP_HEADERS_HANDLE httpHeaders;
+#endif
+    TICK_COUNTER_HANDLE tickCounter;
+    tickcounter_ms_t lastExport;
+    uint64_t startUnixNs;
+    OTEL_CLIENT* clients;
+    size_t clientCount;
+    char* exportBuffer;
+    size_t exportBufferSize;
+    /*the lock guards the spans, the counters and the random state, the trace events come from the threads of the clients*/
+    LOCK_HANDLE lock;
+    OTEL_SPAN* spans;
+    OTEL_SPAN* exportSpans;
+    size_t maxSpans;
+    uint64_t droppedSpans;
+    uint64_t lastEventNs;
+    uint64_t monotonicToUnixNs;
+    bool monotonicToUnixNsSet;
+    uint64_t randomState;
+} IOTHUB_CLIENT_OTEL_EXPORTER;
+
+typedef struct OTEL_WRITER_TAG
+{
+    char* buffer;
+    size_t size;
+    size_t length;
+    bool failed;
+} OTEL_WRITER;
+
+typedef uint64_t(*OTEL_SUM_GETTER)(const IOTHUB_CLIENT_STATISTICS* statistics);
+
+typedef struct OTEL_SUM_METRIC_TAG
+{
+    const char* name;
+    const char* unit;
+    OTEL_SUM_GETTER getter;
+} OTEL_SUM_METRIC;
+
+static uint64_t get_messages_enqueued(const IOTHUB_CLIENT_STATISTICS* statistics) { return statistics->messagesEnqueued; }
+static uint64_t get_messages_confirmed(const IOTHUB_CLIENT_STATISTICS* statistics) { return statistics->messagesConfirmed; }
+static uint64_t get_messages_timed_out(const IOTHUB_CLIENT_STATISTICS* statistics) { return statistics->messagesTimedOut; }
+static uint64_t get_messages_failed(const IOTHUB_CLIENT_STATISTICS* statistics) { return statistics->messagesFailed; }
+static uint64_t get_bytes_sent(const IOTHUB_CLIENT_STATISTICS* statistics) { return statistics->bytesConfirmed; }
+static uint64_t get_reconnects(const IOTHUB_CLIENT_STATISTICS* statistics) { return statistics->reconnectCount; }
+static uint64_t get_disconnected_duration(const IOTHUB_CLIENT_STATISTICS* statistics) { return statistics->msDisconnected; }
+
+static const OTEL_SUM_METRIC SUM_METRICS[] =
+{
+    { "iothub.client.messages.enqueued", "{message}", get_messages_enqueued },
+    { "iothub.client.messages.confirmed", "{message}", get_messages_confirmed },
+    { "iothub.client.messages.timed_out", "{message}", get_messages_timed_out },
+    { "iothub.client.messages.failed", "{message}", get_messages_failed },
+    { "iothub.client.bytes.sent", "By", get_bytes_sent },
+    { "iothub.client.reconnects", "{reconnect}", get_reconnects },
+    { "iothub.client.disconnected.duration", "ms", get_disconnected_duration }
+};
+
+static void write_raw(OTEL_WRITER* writer, const char* text)
+{
+    size_t textLength = strlen(text);
+    if (writer->failed || (textLength >= writer->size - writer->length))
+    {
+        writer->failed = true;
+    }
+    else
+    {
+        (void)memcpy(writer->buffer + writer->length, text, textLength);
+        writer->length += textLength;
+    }
+}
+
+static void write_char(OTEL_WRITER* writer, char c)
+{
+    if (writer->failed || (writer->length + 1 >= writer->size))
+    {
+        writer->failed = true;
+    }
+    else
+    {
+        writer->buffer[writer->length++] = c;
+    }
+}
+
+/*not snprintf("%llu"): it is missing from the older C runtimes the SDK builds with*/
+static void write_uint64(OTEL_WRITER* writer, uint64_t value)
+{
+    char digits[21];
+    size_t position = sizeof(digits) - 1;
+    digits[position] = '\0';
+    do
+    {
+        digits[--position] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0);
+    write_raw(writer, digits + position);
+}
+
+/*the 64 bit integers of OTLP/JSON are strings*/
+static void write_uint64_string(OTEL_WRITER* writer, uint64_t value)
+{
+    write_char(writer, '"');
+    write_uint64(writer, value);
+    write_char(writer, '"');
+}
+
+static void write_string(OTEL_WRITER* writer, const char* value)
+{
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    const char* current;
+    write_char(writer, '"');
+    for (current = value; *current != '\0'; current++)
+    {
+        unsigned char c = (unsigned char)*current;
+        if ((c == '"') || (c == '\\'))
+        {
+            write_char(writer, '\\');
+            write_char(writer, (char)c);
+        }
+        else if (c < 0x20)
+        {
+            write_raw(writer, "\\u00");
+            write_char(writer, HEX_DIGITS[c >> 4]);
+            write_char(writer, HEX_DIGITS[c & 0x0F]);
+        }
+        else
+        {
+            write_char(writer, (char)c);
+        }
+    }
+    write_char(writer, '"');
+}
+
+static void write_hex(OTEL_WRITER* writer, const unsigned char* bytes, size_t size)
+{
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    size_t index;
+    write_char(writer, '"');
+    for (index = 0; index < size; index++)
+    {
+        write_char(writer, HEX_DIGITS[bytes[index] >> 4]);
+        write_char(writer, HEX_DIGITS[bytes[index] & 0x0F]);
+    }
+    write_char(writer, '"');
+}
+
+static void write_string_attribute(OTEL_WRITER* writer, const char* key, const char* value, bool first)
+{
+    write_raw(writer, first ? "{\"key\":" : ",{\"key\":");
+    write_string(writer, key);
+    write_raw(writer, ",\"value\":{\"stringValue\":");
+    write_string(writer, value);
+    write_raw(writer, "}}");
+}
+
+static void write_int_attribute(OTEL_WRITER* writer, const char* key, uint64_t value, bool first)
+{
+    write_raw(writer, first ? "{\"key\":" : ",{\"key\":");
+    write_string(writer, key);
+    write_raw(writer, ",\"value\":{\"intValue\":");
+    write_uint64_string(writer, value);
+    write_raw(writer, "}}");
+}
+
+static void write_resource(OTEL_WRITER* writer, IOTHUB_CLIENT_OTEL_EXPORTER* exporter)
+{
+    write_raw(writer, "{\"resource\":{\"attributes\":[");
+    write_string_attribute(writer, "service.name", exporter->serviceName, true);
+    if (exporter->serviceInstanceId != NULL)
+    {
+        write_string_attribute(writer, "service.instance.id", exporter->serviceInstanceId, false);
+    }
+    write_string_attribute(writer, "telemetry.sdk.name", "azure-iot-sdk-c", false);
+    write_string_attribute(writer, "telemetry.sdk.language", "c", false);
+    write_string_attribute(writer, "telemetry.sdk.version", IOTHUB_SDK_VERSION, false);
+    write_raw(writer, "]}");
+}
+
+static void write_client_attributes(OTEL_WRITER* writer, const OTEL_CLIENT* client)
+{
+    write_raw(writer, "\"attributes\":[");
+    write_string_attribute(writer, "iothub.transport", client->transportName, true);
+    if (client->deviceId != NULL)
+    {
+        write_string_attribute(writer, "iothub.device.id", client->deviceId, false);
+    }
+}
+
+static uint64_t get_unix_ns(void)
+{
+    time_t now = get_time(NULL);
+    return (now == (time_t)(-1)) ? 0 : (uint64_t)now * NS_PER_S;
+}
+
+/*xorshift64*: the ids only have to be unique, not unpredictable. Called with the lock taken*/
+static uint64_t next_random(IOTHUB_CLIENT_OTEL_EXPORTER* exporter)
+{
+    exporter->randomState ^= exporter->randomState >> 12;
+    exporter->randomState ^= exporter->randomState << 25;
+    exporter->randomState ^= exporter->randomState >> 27;
+    return exporter->randomState * 0x2545F4914F6CDD1DULL;
+}
+
+static void fill_random_id(IOTHUB_CLIENT_OTEL_EXPORTER* exporter, unsigned char* id, size_t size)
+{
+    size_t index;
+    uint64_t random = 0;
+    for (index = 0; index < size; index++)
+    {
+        if ((index % sizeof(uint64_t)) == 0)
+        {
+            random = next_random(exporter);
+        }
+        id[index] = (unsigned char)(random >> (8 * (index % sizeof(uint64_t))));
+    }
+}
+
+static OTEL_SPAN* find_open_span(IOTHUB_CLIENT_OTEL_EXPORTER* exporter, const void* subject)
+{
+    OTEL_SPAN* result = NULL;
+    size_t index;
+    for (index = 0; index < exporter->maxSpans; index++)
+    {
+        if ((exporter->spans[index].state == OTEL_SPAN_OPEN) && (exporter->spans[index].subject == subject))
+        {
+            result = &exporter->spans[index];
+            break;
+        }
+    }
+    return result;
+}
+
+static OTEL_SPAN* find_free_span(IOTHUB_CLIENT_OTEL_EXPORTER* exporter)
+{
+    OTEL_SPAN* result = NULL;
+    size_t index;
+    for (index = 0; index < exporter->maxSpans; index++)
+    {
+        if (exporter->spans[index].state == OTEL_SPAN_FREE)
+        {
+            result = &exporter->spans[index];
+            break;
+        }
+    }
+    return result;
+}
+
+void IoTHubClient_OTelExporter_OnTraceEvent(void* context, IOTHUB_CLIENT_TRACE_EVENT trace_event, uint64_t timestamp_ns, const void* subject, uint64_t value)
+{
+    IOTHUB_CLIENT_OTEL_EXPORTER* exporter = (IOTHUB_CLIENT_OTEL_EXPORTER*)context;
+    const char* messageId = NULL;
+
+    if ((exporter == NULL) || (exporter->maxSpans == 0) || (subject == NULL) ||
+        ((trace_event != IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED) && (trace_event != IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH) && (trace_event != IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK)))
+    {
+        /*the connection and CBS events are not spans*/
+    }
+    else
+    {
+        if (trace_event == IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED)
+        {
+            messageId = IoTHubMessage_GetMessageId((IOTHUB_MESSAGE_HANDLE)subject);
+        }
+
+        if (Lock(exporter->lock) != LOCK_OK)
+        {
+            LogError("unable to Lock");
+        }
+        else
+        {
+            OTEL_SPAN* span;
+
+            /*the timestamps are monotonic, the first event places them on the wall clock*/
+            if (!exporter->monotonicToUnixNsSet)
+            {
+                exporter->monotonicToUnixNs = get_unix_ns() - timestamp_ns;
+                exporter->monotonicToUnixNsSet = true;
+            }
+            exporter->lastEventNs = timestamp_ns;
+
+            if (trace_event == IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED)
+            {
+                /*a handle queued again while its span is open was freed and reused, its first message is not acknowledged anymore*/
+                if ((span = find_open_span(exporter, subject)) != NULL)
+                {
+                    span->state = OTEL_SPAN_FREE;
+                    exporter->droppedSpans++;
+                }
+
+                if ((span = find_free_span(exporter)) == NULL)
+                {
+                    /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_009: [ When all the maxSpans slots are taken, the span of the message shall be dropped and counted in iothub.client.spans.dropped. ]*/
+                    exporter->droppedSpans++;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_008: [ On IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, IoTHubClient_OTelExporter_OnTraceEvent shall open a span for the message in a free slot, with a new trace id, a new span id and the id of the message. ]*/
+                    (void)memset(span, 0, sizeof(OTEL_SPAN));
+                    span->state = OTEL_SPAN_OPEN;
+                    span->subject = subject;
+                    span->startNs = timestamp_ns;
+                    fill_random_id(exporter, span->traceId, TRACE_ID_SIZE);
+                    fill_random_id(exporter, span->spanId, SPAN_ID_SIZE);
+                    if (messageId != NULL)
+                    {
+                        (void)strncpy(span->messageId, messageId, MESSAGE_ID_MAX_LENGTH - 1);
+                    }
+                }
+            }
+            else if ((span = find_open_span(exporter, subject)) == NULL)
+            {
+                /*queued before the exporter was there, or dropped*/
+            }
+            else if (trace_event == IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_010: [ On IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, IoTHubClient_OTelExporter_OnTraceEvent shall add a publish event with the packet id to the open span of the message. ]*/
+                span->published = true;
+                span->publishNs = timestamp_ns;
+                span->packetId = value;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_011: [ On IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, IoTHubClient_OTelExporter_OnTraceEvent shall end the open span of the message, with the status OK if the confirmation result is IOTHUB_CLIENT_CONFIRMATION_OK and ERROR otherwise. ]*/
+                span->state = OTEL_SPAN_ENDED;
+                span->endNs = timestamp_ns;
+                span->result = (IOTHUB_CLIENT_CONFIRMATION_RESULT)value;
+            }
+
+            (void)Unlock(exporter->lock);
+        }
+    }
+}
+
+static int send_export(IOTHUB_CLIENT_OTEL_EXPORTER* exporter, IOTHUB_CLIENT_OTEL_EXPORT_KIND kind, const char* json, size_t length)
+{
+    int result;
+
+    if (exporter->sink != NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_013: [ Every export shall be handed to the sink if there is one, or else posted with the Content-Type application/json to /v1/metrics or /v1/traces of otlpHost, a status code other than 2xx failing it. ]*/
+        exporter->sink(exporter->sinkContext, kind, json, length);
+        result = 0;
+    }
+    else
+    {
+#ifdef DONT_USE_OTLP_HTTP
+        (void)json;
+        (void)length;
+        LogError("no OTLP/HTTP in this build, cannot export the %s", ENUM_TO_STRING(IOTHUB_CLIENT_OTEL_EXPORT_KIND, kind));
+        result = __FAILURE__;
+#else
+        BUFFER_HANDLE content;
+        unsigned int statusCode;
+
+        if ((content = BUFFER_create((const unsigned char*)json, length)) == NULL)
+        {
+            LogError("unable to BUFFER_create");
+            result = __FAILURE__;
+        }
+        else
+        {
+            const char* relativePath = (kind == IOTHUB_CLIENT_OTEL_EXPORT_METRICS) ? "/v1/metrics" : "/v1/traces";
+            if (HTTPAPIEX_ExecuteRequest(exporter->httpApiEx, HTTPAPI_REQUEST_POST, relativePath, exporter->httpHeaders, content, &statusCode, NULL, NULL) != HTTPAPIEX_OK)
+            {
+                LogError("unable to post the %s to the collector", ENUM_TO_STRING(IOTHUB_CLIENT_OTEL_EXPORT_KIND, kind));
+                result = __FAILURE__;
+            }
+            else if ((statusCode < 200) || (statusCode >= 300))
+            {
+                LogError("the collector answered the %s with the status code %u", ENUM_TO_STRING(IOTHUB_CLIENT_OTEL_EXPORT_KIND, kind), statusCode);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            BUFFER_delete(content);
+        }
+#endif
+    }
+
+    return result;
+}
+
+static void write_metric_start(OTEL_WRITER* writer, const char* name, const char* unit, bool first)
+{
+    write_raw(writer, first ? "{\"name\":" : ",{\"name\":");
+    write_string(writer, name);
+    write_raw(writer, ",\"unit\":");
+    write_string(writer, unit);
+}
+
+static void write_sum_metric(OTEL_WRITER* writer, IOTHUB_CLIENT_OTEL_EXPORTER* exporter, const OTEL_SUM_METRIC* metric, uint64_t nowUnixNs, bool first)
+{
+    size_t index;
+    bool firstPoint = true;
+
+    write_metric_start(writer, metric->name, metric->unit, first);
+    write_raw(writer, ",\"sum\":{\"aggregationTemporality\":2,\"isMonotonic\":true,\"dataPoints\":[");
+    for (index = 0; index < exporter->clientCount; index++)
+    {
+        OTEL_CLIENT* client = &exporter->clients[index];
+        if (client->hasStatistics)
+        {
+            write_raw(writer, firstPoint ? "{" : ",{");
+            write_client_attributes(writer, client);
+            write_raw(writer, "],\"startTimeUnixNano\":");
+            write_uint64_string(writer, client->startUnixNs);
+            write_raw(writer, ",\"timeUnixNano\":");
+            write_uint64_string(writer, nowUnixNs);
+            write_raw(writer, ",\"asInt\":");
+            write_uint64_string(writer, metric->getter(&client->statistics));
+            write_raw(writer, "}");
+            firstPoint = false;
+        }
+    }
+    write_raw(writer, "]}}");
+}
+
+static void write_queue_depth_point(OTEL_WRITER* writer, const OTEL_CLIENT* client, const char* queue, uint64_t depth, uint64_t nowUnixNs, bool first)
+{
+    write_raw(writer, first ? "{" : ",{");
+    write_client_attributes(writer, client);
+    write_string_attribute(writer, "iothub.queue", queue, false);
+    write_raw(writer, "],\"timeUnixNano\":");
+    write_uint64_string(writer, nowUnixNs);
+    write_raw(writer, ",\"asInt\":");
+    write_uint64_string(writer, depth);
+    write_raw(writer, "}");
+}
+
+static void write_queue_depth_metric(OTEL_WRITER* writer, IOTHUB_CLIENT_OTEL_EXPORTER* exporter, uint64_t nowUnixNs)
+{
+    size_t index;
+    bool firstPoint = true;
+
+    write_metric_start(writer, "iothub.client.queue.depth", "{message}", false);
+    write_raw(writer, ",\"gauge\":{\"dataPoints\":[");
+    for (index = 0; index < exporter->clientCount; index++)
+    {
+        OTEL_CLIENT* client = &exporter->clients[index];
+        if (client->hasStatistics)
+        {
+            write_queue_depth_point(writer, client, "waiting_to_send", client->statistics.waitingToSendDepth, nowUnixNs, firstPoint);
+            write_queue_depth_point(writer, client, "in_progress", client->statistics.inProgressDepth, nowUnixNs, false);
+            firstPoint = false;
+        }
+    }
+    write_raw(writer, "]}}");
+}
+
+static void write_latency_metric(OTEL_WRITER* writer, IOTHUB_CLIENT_OTEL_EXPORTER* exporter, uint64_t nowUnixNs)
+{
+    size_t index;
+    size_t bucket;
+    bool firstPoint = true;
+
+    write_metric_start(writer, "iothub.client.send.latency", "ms", false);
+    write_raw(writer, ",\"histogram\":{\"aggregationTemporality\":2,\"dataPoints\":[");
+    for (index = 0; index < exporter->clientCount; index++)
+    {
+        OTEL_CLIENT* client = &exporter->clients[index];
+        if (client->hasStatistics)
+        {
+            uint64_t count = 0;
+            for (bucket = 0; bucket < IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKET_COUNT; bucket++)
+            {
+                count += client->statistics.latencyHistogram[bucket];
+            }
+
+            write_raw(writer, firstPoint ? "{" : ",{");
+            write_client_attributes(writer, client);
+            write_raw(writer, "],\"startTimeUnixNano\":");
+            write_uint64_string(writer, client->startUnixNs);
+            write_raw(writer, ",\"timeUnixNano\":");
+            write_uint64_string(writer, nowUnixNs);
+            write_raw(writer, ",\"count\":");
+            write_uint64_string(writer, count);
+            write_raw(writer, ",\"bucketCounts\":[");
+            for (bucket = 0; bucket < IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKET_COUNT; bucket++)
+            {
+                if (bucket != 0)
+                {
+                    write_char(writer, ',');
+                }
+                write_uint64_string(writer, client->statistics.latencyHistogram[bucket]);
+            }
+            /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_007: [ iothub.client.send.latency shall have the buckets of the latency histogram of the statistics, with the explicit bounds 1, 2, 4 ... 2^14 ms. ]*/
+            write_raw(writer, "],\"explicitBounds\":[");
+            for (bucket = 0; bucket < IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKET_COUNT - 1; bucket++)
+            {
+                if (bucket != 0)
+                {
+                    write_char(writer, ',');
+                }
+                write_uint64(writer, (uint64_t)1 << bucket);
+            }
+            write_raw(writer, "]}");
+            firstPoint = false;
+        }
+    }
+    write_raw(writer, "]}}");
+}
+
+static int export_metrics(IOTHUB_CLIENT_OTEL_EXPORTER* exporter)
+{
+    int result;
+    OTEL_WRITER writer;
+    uint64_t nowUnixNs = get_unix_ns();
+    uint64_t droppedSpans;
+    size_t index;
+
+    /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_006: [ The metrics shall have a data point per client, from its statistics; a client whose statistics cannot be read shall be left out of the export. ]*/
+    for (index = 0; index < exporter->clientCount; index++)
+    {
+        OTEL_CLIENT* client = &exporter->clients[index];
+        IOTHUB_CLIENT_RESULT statisticsResult = (client->client != NULL) ?
+            IoTHubClient_GetStatistics(client->client, &client->statistics) :
+            IoTHubClient_LL_GetStatistics(client->clientLL, &client->statistics);
+        client->hasStatistics = (statisticsResult == IOTHUB_CLIENT_OK);
+        if (!client->hasStatistics)
+        {
+            LogError("unable to get the statistics of the %s client", client->transportName);
+        }
+    }
+
+    if (Lock(exporter->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        droppedSpans = 0;
+    }
+    else
+    {
+        droppedSpans = exporter->droppedSpans;
+        (void)Unlock(exporter->lock);
+    }
+
+    writer.buffer = exporter->exportBuffer;
+    writer.size = exporter->exportBufferSize;
+    writer.length = 0;
+    writer.failed = false;
+
+    write_raw(&writer, "{\"resourceMetrics\":[");
+    write_resource(&writer, exporter);
+    write_raw(&writer, ",\"scopeMetrics\":[{\"scope\":" OTEL_SCOPE ",\"metrics\":[");
+    for (index = 0; index < sizeof(SUM_METRICS) / sizeof(SUM_METRICS[0]); index++)
+    {
+        write_sum_metric(&writer, exporter, &SUM_METRICS[index], nowUnixNs, index == 0);
+    }
+    write_queue_depth_metric(&writer, exporter, nowUnixNs);
+    write_latency_metric(&writer, exporter, nowUnixNs);
+    write_metric_start(&writer, "iothub.client.spans.dropped", "{span}", false);
+    write_raw(&writer, ",\"sum\":{\"aggregationTemporality\":2,\"isMonotonic\":true,\"dataPoints\":[{\"startTimeUnixNano\":");
+    write_uint64_string(&writer, exporter->startUnixNs);
+    write_raw(&writer, ",\"timeUnixNano\":");
+    write_uint64_string(&writer, nowUnixNs);
+    write_raw(&writer, ",\"asInt\":");
+    write_uint64_string(&writer, droppedSpans);
+    write_raw(&writer, "}]}}");
+    write_raw(&writer, METRICS_DOCUMENT_END);
+
+    if (writer.failed)
+    {
+        LogError("the metrics of %lu clients do not fit in maxExportSize (%lu)", (unsigned long)exporter->clientCount, (unsigned long)exporter->exportBufferSize);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = send_export(exporter, IOTHUB_CLIENT_OTEL_EXPORT_METRICS, writer.buffer, writer.length);
+    }
+
+    return result;
+}
+
+static void write_span(OTEL_WRITER* writer, IOTHUB_CLIENT_OTEL_EXPORTER* exporter, const OTEL_SPAN* span, bool first)
+{
+    write_raw(writer, first ? "{\"traceId\":" : ",{\"traceId\":");
+    write_hex(writer, span->traceId, TRACE_ID_SIZE);
+    write_raw(writer, ",\"spanId\":");
+    write_hex(writer, span->spanId, SPAN_ID_SIZE);
+    write_raw(writer, ",\"name\":\"iothub.client.send\",\"kind\":4,\"startTimeUnixNano\":");
+    write_uint64_string(writer, span->startNs + exporter->monotonicToUnixNs);
+    write_raw(writer, ",\"endTimeUnixNano\":");
+    write_uint64_string(writer, span->endNs + exporter->monotonicToUnixNs);
+    write_raw(writer, ",\"attributes\":[");
+    write_string_attribute(writer, "messaging.system", "iothub", true);
+    write_string_attribute(writer, "messaging.operation", "publish", false);
+    if (span->messageId[0] != '\0')
+    {
+        write_string_attribute(writer, "messaging.message.id", span->messageId, false);
+    }
+    if (span->published && (span->packetId != 0))
+    {
+        write_int_attribute(writer, "iothub.mqtt.packet_id", span->packetId, false);
+    }
+    write_raw(writer, "]");
+    if (span->published)
+    {
+        write_raw(writer, ",\"events\":[{\"timeUnixNano\":");
+        write_uint64_string(writer, span->publishNs + exporter->monotonicToUnixNs);
+        write_raw(writer, ",\"name\":\"publish\"}]");
+    }
+    if (span->result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        write_raw(writer, ",\"status\":{\"code\":1}}");
+    }
+    else
+    {
+        write_raw(writer, ",\"status\":{\"code\":2,\"message\":");
+        write_string(writer, ENUM_TO_STRING(IOTHUB_CLIENT_CONFIRMATION_RESULT, span->result));
+        write_raw(writer, "}}");
+    }
+}
+
+static int export_spans(IOTHUB_CLIENT_OTEL_EXPORTER* exporter)
+{
+    int result = 0;
+    size_t exportCount = 0;
+    size_t dropped = 0;
+    size_t index;
+
+    if (Lock(exporter->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*the spans are copied out so that the formatting does not hold the lock the trace events take*/
+        for (index = 0; index < exporter->maxSpans; index++)
+        {
+            OTEL_SPAN* span = &exporter->spans[index];
+            if (span->state == OTEL_SPAN_ENDED)
+            {
+                exporter->exportSpans[exportCount++] = *span;
+                span->state = OTEL_SPAN_FREE;
+            }
+            else if ((span->state == OTEL_SPAN_OPEN) && (exporter->lastEventNs - span->startNs > (uint64_t)IOTHUB_CLIENT_OTEL_SPAN_MAX_AGE_MS * NS_PER_MS))
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_012: [ A span still open IOTHUB_CLIENT_OTEL_SPAN_MAX_AGE_MS after it was opened, by the time of the last trace event, shall be dropped and counted in iothub.client.spans.dropped. ]*/
+                span->state = OTEL_SPAN_FREE;
+                exporter->droppedSpans++;
+            }
+        }
+        (void)Unlock(exporter->lock);
+
+        /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_014: [ The ended spans shall be exported in as many exports of at most maxExportSize bytes as needed; a span that does not fit in an export by itself shall be dropped. ]*/
+        index = 0;
+        while (index < exportCount)
+        {
+            OTEL_WRITER writer;
+            size_t written = 0;
+
+            writer.buffer = exporter->exportBuffer;
+            writer.size = exporter->exportBufferSize - (sizeof(SPANS_DOCUMENT_END) - 1);
+            writer.length = 0;
+            writer.failed = false;
+
+            write_raw(&writer, "{\"resourceSpans\":[");
+            write_resource(&writer, exporter);
+            write_raw(&writer, ",\"scopeSpans\":[{\"scope\":" OTEL_SCOPE ",\"spans\":[");
+            for (; (index < exportCount) && !writer.failed; index++)
+            {
+                size_t spanStart = writer.length;
+                write_span(&writer, exporter, &exporter->exportSpans[index], written == 0);
+                if (writer.failed)
+                {
+                    writer.length = spanStart;
+                    break;
+                }
+                written++;
+            }
+
+            if (written == 0)
+            {
+                LogError("a span does not fit in maxExportSize (%lu)", (unsigned long)exporter->exportBufferSize);
+                dropped++;
+                index++;
+            }
+            else
+            {
+                writer.size = exporter->exportBufferSize;
+                writer.failed = false;
+                write_raw(&writer, SPANS_DOCUMENT_END);
+                if (send_export(exporter, IOTHUB_CLIENT_OTEL_EXPORT_SPANS, writer.buffer, writer.length) != 0)
+                {
+                    result = __FAILURE__;
+                }
+            }
+        }
+
+        if ((dropped != 0) && (Lock(exporter->lock) == LOCK_OK))
+        {
+            exporter->droppedSpans += dropped;
+            (void)Unlock(exporter->lock);
+        }
+    }
+
+    return result;
+}
+
+static void destroy_exporter_resources(IOTHUB_CLIENT_OTEL_EXPORTER* exporter)
+{
+    size_t index;
+    for (index = 0; index < exporter->clientCount; index++)
+    {
+        free(exporter->clients[index].transportName);
+        if (exporter->clients[index].deviceId != NULL)
+        {
+            free(exporter->clients[index].deviceId);
+        }
+    }
+    if (exporter->clients != NULL)
+    {
+        free(exporter->clients);
+    }
+#ifndef DONT_USE_OTLP_HTTP
+    if (exporter->httpHeaders != NULL)
+    {
+        HTTPHeaders_Free(exporter->httpHeaders);
+    }
+    if (exporter->httpApiEx != NULL)
+    {
+        HTTPAPIEX_Destroy(exporter->httpApiEx);
+    }
+#endif
+    if (exporter->tickCounter != NULL)
+    {
+        tickcounter_destroy(exporter->tickCounter);
+    }
+    if (exporter->lock != NULL)
+    {
+        (void)Lock_Deinit(exporter->lock);
+    }
+    if (exporter->spans != NULL)
+    {
+        free(exporter->spans);
+    }
+    if (exporter->exportSpans != NULL)
+    {
+        free(exporter->exportSpans);
+    }
+    if (exporter->exportBuffer != NULL)
+    {
+        free(exporter->exportBuffer);
+    }
+    if (exporter->serviceInstanceId != NULL)
+    {
+        free(exporter->serviceInstanceId);
+    }
+    if (exporter->serviceName != NULL)
+    {
+        free(exporter->serviceName);
+    }
+    free(exporter);
+}
+
+#ifndef DONT_USE_OTLP_HTTP
+static int create_http_resources(IOTHUB_CLIENT_OTEL_EXPORTER* exporter, const IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG* config)
+{
+    int result;
+    if ((exporter->httpApiEx = HTTPAPIEX_Create(config->otlpHost)) == NULL)
+    {
+        LogError("unable to HTTPAPIEX_Create");
+        result = __FAILURE__;
+    }
+    else if ((exporter->httpHeaders = HTTPHeaders_Alloc()) == NULL)
+    {
+        LogError("unable to HTTPHeaders_Alloc");
+        result = __FAILURE__;
+    }
+    else if ((HTTPHeaders_AddHeaderNameValuePair(exporter->httpHeaders, "Content-Type", "application/json") != HTTP_HEADERS_OK) ||
+        (HTTPHeaders_AddHeaderNameValuePair(exporter->httpHeaders, "User-Agent", "azure-iot-sdk-c/" IOTHUB_SDK_VERSION) != HTTP_HEADERS_OK) ||
+        ((config->otlpAuthorization != NULL) && (HTTPHeaders_AddHeaderNameValuePair(exporter->httpHeaders, "Authorization", config->otlpAuthorization) != HTTP_HEADERS_OK)))
+    {
+        LogError("unable to HTTPHeaders_AddHeaderNameValuePair");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+#endif
+
+IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE IoTHubClient_OTelExporter_Create(const IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG* config)
+{
+    IOTHUB_CLIENT_OTEL_EXPORTER* result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_001: [ If config or its serviceName is NULL, or config does not have exactly one of sink and otlpHost, IoTHubClient_OTelExporter_Create shall fail and return NULL. ]*/
+    if ((config == NULL) || (config->serviceName == NULL) || ((config->sink == NULL) == (config->otlpHost == NULL)))
+    {
+        LogError("invalid argument config(%p), it needs a serviceName and one of sink and otlpHost", config);
+        result = NULL;
+    }
+#ifdef DONT_USE_OTLP_HTTP
+    else if (config->sink == NULL)
+    {
+        LogError("no OTLP/HTTP in this build, the exporter needs a sink");
+        result = NULL;
+    }
+#endif
+    else if ((result = (IOTHUB_CLIENT_OTEL_EXPORTER*)malloc(sizeof(IOTHUB_CLIENT_OTEL_EXPORTER))) == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else
+    {
+        bool created;
+        (void)memset(result, 0, sizeof(IOTHUB_CLIENT_OTEL_EXPORTER));
+        result->intervalMs = (config->intervalMs == 0) ? IOTHUB_CLIENT_OTEL_DEFAULT_INTERVAL_MS : config->intervalMs;
+        result->exportBufferSize = (config->maxExportSize == 0) ? IOTHUB_CLIENT_OTEL_DEFAULT_EXPORT_SIZE : config->maxExportSize;
+        result->maxSpans = config->maxSpans;
+        result->sink = config->sink;
+        result->sinkContext = config->sinkContext;
+        result->startUnixNs = get_unix_ns();
+        result->randomState = (result->startUnixNs ^ (uint64_t)(uintptr_t)result) | 1;
+
+        /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_002: [ IoTHubClient_OTelExporter_Create shall allocate the export buffer and the spans up front, and fail and return NULL if any allocation or resource creation fails. ]*/
+        if (mallocAndStrcpy_s(&result->serviceName, config->serviceName) != 0)
+        {
+            LogError("unable to copy the serviceName");
+            created = false;
+        }
+        else if ((config->serviceInstanceId != NULL) && (mallocAndStrcpy_s(&result->serviceInstanceId, config->serviceInstanceId) != 0))
+        {
+            LogError("unable to copy the serviceInstanceId");
+            created = false;
+        }
+        else if ((result->exportBuffer = (char*)malloc(result->exportBufferSize)) == NULL)
+        {
+            LogError("unable to malloc the export buffer");
+            created = false;
+        }
+        else if ((result->maxSpans != 0) &&
+            (((result->spans = (OTEL_SPAN*)calloc(result->maxSpans, sizeof(OTEL_SPAN))) == NULL) ||
+             ((result->exportSpans = (OTEL_SPAN*)malloc(result->maxSpans * sizeof(OTEL_SPAN))) == NULL)))
+        {
+            LogError("unable to allocate %lu spans", (unsigned long)result->maxSpans);
+            created = false;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("unable to Lock_Init");
+            created = false;
+        }
+        else if ((result->tickCounter = tickcounter_create()) == NULL)
+        {
+            LogError("unable to tickcounter_create");
+            created = false;
+        }
+        else if (tickcounter_get_current_ms(result->tickCounter, &result->lastExport) != 0)
+        {
+            LogError("unable to tickcounter_get_current_ms");
+            created = false;
+        }
+#ifndef DONT_USE_OTLP_HTTP
+        else if ((result->sink == NULL) && (create_http_resources(result, config) != 0))
+        {
+            created = false;
+        }
+#endif
+        /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_003: [ If maxSpans is not 0, IoTHubClient_OTelExporter_Create shall set IoTHubClient_OTelExporter_OnTraceEvent as the trace callback, with the exporter as context. ]*/
+        else if ((result->maxSpans != 0) && (IoTHubClient_Trace_SetCallback(IoTHubClient_OTelExporter_OnTraceEvent, result) != 0))
+        {
+            LogError("unable to IoTHubClient_Trace_SetCallback");
+            created = false;
+        }
+        else
+        {
+            created = true;
+        }
+
+        if (!created)
+        {
+            destroy_exporter_resources(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClient_OTelExporter_Destroy(IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter)
+{
+    if (exporter == NULL)
+    {
+        LogError("invalid argument exporter(NULL)");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_015: [ IoTHubClient_OTelExporter_Destroy shall remove the trace callback it set and free all the resources of the exporter, without exporting. ]*/
+        if (exporter->maxSpans != 0)
+        {
+            (void)IoTHubClient_Trace_SetCallback(NULL, NULL);
+        }
+        destroy_exporter_resources(exporter);
+    }
+}
+
+static int add_client(IOTHUB_CLIENT_OTEL_EXPORTER* exporter, IOTHUB_CLIENT_HANDLE client, IOTHUB_CLIENT_LL_HANDLE clientLL, const char* transportName, const char* deviceId)
+{
+    int result;
+    OTEL_CLIENT* clients;
+
+    /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_004: [ If exporter, client or transportName is NULL, IoTHubClient_OTelExporter_AddClient and IoTHubClient_OTelExporter_AddClientLL shall fail and return a non-zero value. ]*/
+    if ((exporter == NULL) || ((client == NULL) && (clientLL == NULL)) || (transportName == NULL))
+    {
+        LogError("invalid argument exporter(%p), transportName(%p)", exporter, transportName);
+        result = __FAILURE__;
+    }
+    else if ((clients = (OTEL_CLIENT*)realloc(exporter->clients, (exporter->clientCount + 1) * sizeof(OTEL_CLIENT))) == NULL)
+    {
+        LogError("unable to realloc the clients");
+        result = __FAILURE__;
+    }
+    else
+    {
+        OTEL_CLIENT* added = &clients[exporter->clientCount];
+        exporter->clients = clients;
+        (void)memset(added, 0, sizeof(OTEL_CLIENT));
+
+        if (mallocAndStrcpy_s(&added->transportName, transportName) != 0)
+        {
+            LogError("unable to copy the transportName");
+            result = __FAILURE__;
+        }
+        else if ((deviceId != NULL) && (mallocAndStrcpy_s(&added->deviceId, deviceId) != 0))
+        {
+            LogError("unable to copy the deviceId");
+            free(added->transportName);
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_005: [ The client shall be in the exports that follow, its sums starting at the time it was added. ]*/
+            added->client = client;
+            added->clientLL = clientLL;
+            added->startUnixNs = get_unix_ns();
+            exporter->clientCount++;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int IoTHubClient_OTelExporter_AddClient(IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter, IOTHUB_CLIENT_HANDLE client, const char* transportName, const char* deviceId)
+{
+    return add_client(exporter, client, NULL, transportName, deviceId);
+}
+
+int IoTHubClient_OTelExporter_AddClientLL(IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter, IOTHUB_CLIENT_LL_HANDLE client, const char* transportName, const char* deviceId)
+{
+    return add_client(exporter, NULL, client, transportName, deviceId);
+}
+
+int IoTHubClient_OTelExporter_Export(IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter)
+{
+    int result;
+
+    if (exporter == NULL)
+    {
+        LogError("invalid argument exporter(NULL)");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*the spans go out even when the metrics do not*/
+        int metricsResult = export_metrics(exporter);
+        int spansResult = (exporter->maxSpans != 0) ? export_spans(exporter) : 0;
+        result = ((metricsResult != 0) || (spansResult != 0)) ? __FAILURE__ : 0;
+    }
+
+    return result;
+}
+
+void IoTHubClient_OTelExporter_DoWork(IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter)
+{
+    tickcounter_ms_t now;
+
+    if (exporter == NULL)
+    {
+        LogError("invalid argument exporter(NULL)");
+    }
+    else if (tickcounter_get_current_ms(exporter->tickCounter, &now) != 0)
+    {
+        LogError("unable to tickcounter_get_current_ms");
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_016: [ IoTHubClient_OTelExporter_DoWork shall export once intervalMs have passed since the exporter was created or last exported, whether that export succeeded or not. ]*/
+    else if (now - exporter->lastExport >= exporter->intervalMs)
+    {
+        exporter->lastExport = now;
+        (void)IoTHubClient_OTelExporter_Export(exporter);
+    }
+}
@@ -0,0 +1,782 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "iothub_client_outbox.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#define OUTBOX_SYNC_FILE(file) _commit(_fileno(file))
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define OUTBOX_SYNC_FILE(file) fsync(fileno(file))
+#else
+/*no way to ask for more than fflush*/
+#define OUTBOX_SYNC_FILE(file) 0
+#endif
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+/*the file is a header followed by a ring of records. A record is its length followed by the serialized message.
+A record never wraps around the end of the ring, a wrap marker (or less room than a length) sends the reader back to the start*/
+#define OUTBOX_MAGIC "IHOB"
+#define OUTBOX_VERSION 1
+#define OUTBOX_HEADER_SIZE 32
+#define OUTBOX_LENGTH_SIZE 4
+#define OUTBOX_WRAP_MARKER 0xFFFFFFFF
+#define OUTBOX_NO_STRING 0xFFFFFFFF
+
+#define OUTBOX_CONTENT_BYTEARRAY 0
+#define OUTBOX_CONTENT_STRING 1
+
+typedef struct OUTBOX_TAG
+{
+    FILE* file;
+    uint32_t capacity; /*size of the ring*/
+    uint32_t head; /*offset of the oldest record*/
+    uint32_t tail; /*offset after the newest record*/
+    uint32_t count;
+    uint32_t read_offset; /*offset of the oldest record not read yet*/
+    uint32_t unread_count;
+    uint32_t synced_head; /*head written in the file, the room of the records released since is not reused before the next sync*/
+    uint32_t released_since_sync;
+    size_t sync_interval;
+    size_t unsynced_count;
+} OUTBOX;
+
+typedef struct OUTBOX_READER_TAG
+{
+    const unsigned char* position;
+    size_t remaining;
+} OUTBOX_READER;
+
+static void put_uint32(unsigned char* destination, uint32_t value)
+{
+    destination[0] = (unsigned char)(value & 0xFF);
+    destination[1] = (unsigned char)((value >> 8) & 0xFF);
+    destination[2] = (unsigned char)((value >> 16) & 0xFF);
+    destination[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+static uint32_t get_uint32(const unsigned char* source)
+{
+    return (uint32_t)source[0] | ((uint32_t)source[1] << 8) | ((uint32_t)source[2] << 16) | ((uint32_t)source[3] << 24);
+}
+
+static int write_file(OUTBOX* outbox, uint32_t position, const void* data, size_t size)
+{
+    int result;
+    if ((fseek(outbox->file, (long)position, SEEK_SET) != 0) ||
+        (fwrite(data, 1, size, outbox->file) != size))
+    {
+        LogError("unable to write %lu bytes at %lu", (unsigned long)size, (unsigned long)position);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static int read_file(OUTBOX* outbox, uint32_t position, void* data, size_t size)
+{
+    int result;
+    if ((fseek(outbox->file, (long)position, SEEK_SET) != 0) ||
+        (fread(data, 1, size, outbox->file) != size))
+    {
+        LogError("unable to read %lu bytes at %lu", (unsigned long)size, (unsigned long)position);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+/*follows the wrap of the ring, on return offset is the offset of the record and length the size of the record without its length*/
+static int read_record_length(OUTBOX* outbox, uint32_t* offset, uint32_t* length)
+{
+    int result;
+    unsigned char encoded[OUTBOX_LENGTH_SIZE];
+    if (outbox->capacity - *offset < OUTBOX_LENGTH_SIZE)
+    {
+        *offset = 0;
+    }
+
+    if (read_file(outbox, OUTBOX_HEADER_SIZE + *offset, encoded, sizeof(encoded)) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else if (((*length = get_uint32(encoded)) == OUTBOX_WRAP_MARKER) &&
+        ((*offset = 0), (read_file(outbox, OUTBOX_HEADER_SIZE, encoded, sizeof(encoded)) != 0)))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *length = get_uint32(encoded);
+        if (*length > outbox->capacity - *offset - OUTBOX_LENGTH_SIZE)
+        {
+            LogError("corrupted record of %lu bytes at %lu", (unsigned long)*length, (unsigned long)*offset);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static int write_header(OUTBOX* outbox)
+{
+    unsigned char header[OUTBOX_HEADER_SIZE];
+    (void)memset(header, 0, sizeof(header));
+    (void)memcpy(header, OUTBOX_MAGIC, 4);
+    put_uint32(header + 4, OUTBOX_VERSION);
+    put_uint32(header + 8, outbox->capacity);
+    put_uint32(header + 12, outbox->head);
+    put_uint32(header + 16, outbox->tail);
+    put_uint32(header + 20, outbox->count);
+    return write_file(outbox, 0, header, sizeof(header));
+}
+
+/*reads the header of an existing file and checks that the records it describes can be walked*/
+static int load_header(OUTBOX* outbox)
+{
+    int result;
+    unsigned char header[OUTBOX_HEADER_SIZE];
+    if (read_file(outbox, 0, header, sizeof(header)) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else if ((memcmp(header, OUTBOX_MAGIC, 4) != 0) || (get_uint32(header + 4) != OUTBOX_VERSION))
+    {
+        LogError("not an outbox file");
+        result = __FAILURE__;
+    }
+    else
+    {
+        uint32_t offset;
+        uint32_t i;
+        outbox->capacity = get_uint32(header + 8);
+        outbox->head = get_uint32(header + 12);
+        outbox->tail = get_uint32(header + 16);
+        outbox->count = get_uint32(header + 20);
+
+        result = ((outbox->capacity > OUTBOX_LENGTH_SIZE) && (outbox->head <= outbox->capacity) && (outbox->tail <= outbox->capacity)) ? 0 : __FAILURE__;
+        offset = outbox->head;
+        for (i = 0; (i < outbox->count) && (result == 0); i++)
+        {
+            uint32_t length;
+            if (read_record_length(outbox, &offset, &length) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                offset += OUTBOX_LENGTH_SIZE + length;
+            }
+        }
+
+        if ((result != 0) || ((outbox->count != 0) && (offset != outbox->tail)))
+        {
+            LogError("the records of the outbox file are not consistent");
+            result = __FAILURE__;
+        }
+        else if (outbox->count == 0)
+        {
+            outbox->head = 0;
+            outbox->tail = 0;
+        }
+    }
+    return result;
+}
+
+/*finds where a record of size bytes can be written, given the head and the number of records from it*/
+static int find_room(const OUTBOX* outbox, uint32_t head, uint32_t count, size_t size, uint32_t* offset)
+{
+    int result;
+    if (size > outbox->capacity)
+    {
+        result = __FAILURE__;
+    }
+    else if (count == 0)
+    {
+        *offset = 0;
+        result = 0;
+    }
+    else if (outbox->tail > head)
+    {
+        if (outbox->capacity - outbox->tail >= size)
+        {
+            *offset = outbox->tail;
+            result = 0;
+        }
+        else if (head >= size)
+        {
+            *offset = 0;
+            result = 0;
+        }
+        else
+        {
+            result = __FAILURE__;
+        }
+    }
+    else if (head - outbox->tail >= size)
+    {
+        *offset = outbox->tail;
+        result = 0;
+    }
+    else
+    {
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+static void note_change(OUTBOX* outbox)
+{
+    outbox->unsynced_count++;
+    if ((outbox->unsynced_count >= outbox->sync_interval) && (outbox_sync(outbox) != 0))
+    {
+        LogError("unable to sync the outbox, it is tried again on the next change");
+    }
+}
+
+static size_t get_string_size(const char* value)
+{
+    return OUTBOX_LENGTH_SIZE + ((value == NULL) ? 0 : strlen(value) + 1);
+}
+
+static unsigned char* put_bytes(unsigned char* destination, const void* data, size_t size)
+{
+    put_uint32(destination, (uint32_t)size);
+    (void)memcpy(destination + OUTBOX_LENGTH_SIZE, data, size);
+    return destination + OUTBOX_LENGTH_SIZE + size;
+}
+
+static unsigned char* put_string(unsigned char* destination, const char* value)
+{
+    unsigned char* result;
+    if (value == NULL)
+    {
+        put_uint32(destination, OUTBOX_NO_STRING);
+        result = destination + OUTBOX_LENGTH_SIZE;
+    }
+    else
+    {
+        result = put_bytes(destination, value, strlen(value) + 1);
+    }
+    return result;
+}
+
+/*the record is the length, the content type, the payload, the message id, the correlation id and the properties*/
+static unsigned char* serialize_message(IOTHUB_MESSAGE_HANDLE message, size_t* size)
+{
+    unsigned char* result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message);
+    const unsigned char* payload = NULL;
+    size_t payloadSize = 0;
+    const char* messageId = IoTHubMessage_GetMessageId(message);
+    const char* correlationId = IoTHubMessage_GetCorrelationId(message);
+    const char*const* keys;
+    const char*const* values;
+    size_t propertyCount;
+
+    if (contentType == IOTHUBMESSAGE_STRING)
+    {
+        payload = (const unsigned char*)IoTHubMessage_GetString(message);
+        payloadSize = (payload == NULL) ? 0 : strlen((const char*)payload) + 1;
+    }
+    else if ((contentType == IOTHUBMESSAGE_BYTEARRAY) && (IoTHubMessage_GetByteArray(message, &payload, &payloadSize) != IOTHUB_MESSAGE_OK))
+    {
+        payload = NULL;
+    }
+
+    if (payload == NULL)
+    {
+        LogError("unable to get the content of the message");
+        result = NULL;
+    }
+    else if (Map_GetInternals(IoTHubMessage_Properties(message), &keys, &values, &propertyCount) != MAP_OK)
+    {
+        LogError("unable to get the properties of the message");
+        result = NULL;
+    }
+    else
+    {
+        size_t i;
+        uint64_t recordSize = OUTBOX_LENGTH_SIZE + 1 + OUTBOX_LENGTH_SIZE + (uint64_t)payloadSize + get_string_size(messageId) + get_string_size(correlationId) + OUTBOX_LENGTH_SIZE;
+        for (i = 0; i < propertyCount; i++)
+        {
+            recordSize += get_string_size(keys[i]) + get_string_size(values[i]);
+        }
+
+        if (recordSize >= OUTBOX_WRAP_MARKER)
+        {
+            LogError("message too large for the outbox");
+            result = NULL;
+        }
+        else if ((result = (unsigned char*)malloc((size_t)recordSize)) == NULL)
+        {
+            LogError("unable to malloc");
+        }
+        else
+        {
+            unsigned char* position = result;
+            put_uint32(position, (uint32_t)(recordSize - OUTBOX_LENGTH_SIZE));
+            position += OUTBOX_LENGTH_SIZE;
+            *position++ = (contentType == IOTHUBMESSAGE_STRING) ? OUTBOX_CONTENT_STRING : OUTBOX_CONTENT_BYTEARRAY;
+            position = put_bytes(position, payload, payloadSize);
+            position = put_string(position, messageId);
+            position = put_string(position, correlationId);
+            put_uint32(position, (uint32_t)propertyCount);
+            position += OUTBOX_LENGTH_SIZE;
+            for (i = 0; i < propertyCount; i++)
+            {
+                position = put_string(position, keys[i]);
+                position = put_string(position, values[i]);
+            }
+            *size = (size_t)recordSize;
+        }
+    }
+    return result;
+}
+
+static int get_reader_bytes(OUTBOX_READER* reader, const unsigned char** bytes, uint32_t* size)
+{
+    int result;
+    if (reader->remaining < OUTBOX_LENGTH_SIZE)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *size = get_uint32(reader->position);
+        reader->position += OUTBOX_LENGTH_SIZE;
+        reader->remaining -= OUTBOX_LENGTH_SIZE;
+        if (*size == OUTBOX_NO_STRING)
+        {
+            *bytes = NULL;
+            result = 0;
+        }
+        else if (*size > reader->remaining)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            *bytes = reader->position;
+            reader->position += *size;
+            reader->remaining -= *size;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*value is NULL when the string was not set*/
+static int get_reader_string(OUTBOX_READER* reader, const char** value)
+{
+    int result;
+    const unsigned char* bytes;
+    uint32_t size;
+    if (get_reader_bytes(reader, &bytes, &size) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else if ((bytes != NULL) && ((size == 0) || (bytes[size - 1] != '\0')))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *value = (const char*)bytes;
+        result = 0;
+    }
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE deserialize_message(const unsigned char* record, size_t size)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    OUTBOX_READER reader;
+    const unsigned char* payload;
+    uint32_t payloadSize;
+    reader.position = record + 1;
+    reader.remaining = size - 1;
+
+    if ((size == 0) || (get_reader_bytes(&reader, &payload, &payloadSize) != 0) || (payload == NULL))
+    {
+        result = NULL;
+    }
+    else if (record[0] == OUTBOX_CONTENT_STRING)
+    {
+        result = ((payloadSize != 0) && (payload[payloadSize - 1] == '\0')) ? IoTHubMessage_CreateFromString((const char*)payload) : NULL;
+    }
+    else
+    {
+        result = IoTHubMessage_CreateFromByteArray(payload, payloadSize);
+    }
+
+    if (result != NULL)
+    {
+        const char* messageId;
+        const char* correlationId;
+        const unsigned char* encodedCount;
+        uint32_t propertyCount = 0;
+        uint32_t i;
+        bool succeeded =
+            (get_reader_string(&reader, &messageId) == 0) &&
+            ((messageId == NULL) || (IoTHubMessage_SetMessageId(result, messageId) == IOTHUB_MESSAGE_OK)) &&
+            (get_reader_string(&reader, &correlationId) == 0) &&
+            ((correlationId == NULL) || (IoTHubMessage_SetCorrelationId(result, correlationId) == IOTHUB_MESSAGE_OK)) &&
+            (reader.remaining >= OUTBOX_LENGTH_SIZE);
+        if (succeeded)
+        {
+            encodedCount = reader.position;
+            propertyCount = get_uint32(encodedCount);
+            reader.position += OUTBOX_LENGTH_SIZE;
+            reader.remaining -= OUTBOX_LENGTH_SIZE;
+        }
+        for (i = 0; (i < propertyCount) && succeeded; i++)
+        {
+            const char* key;
+            const char* value;
+            succeeded =
+                (get_reader_string(&reader, &key) == 0) && (key != NULL) &&
+                (get_reader_string(&reader, &value) == 0) && (value != NULL) &&
+                (Map_AddOrUpdate(IoTHubMessage_Properties(result), key, value) == MAP_OK);
+        }
+
+        if (!succeeded)
+        {
+            IoTHubMessage_Destroy(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+static int create_outbox_file(OUTBOX* outbox, const char* file_name, size_t max_file_size)
+{
+    int result;
+    if ((outbox->file = fopen(file_name, "w+b")) == NULL)
+    {
+        LogError("unable to create the outbox file %s", file_name);
+        result = __FAILURE__;
+    }
+    else
+    {
+        outbox->capacity = (uint32_t)(max_file_size - OUTBOX_HEADER_SIZE);
+        outbox->head = 0;
+        outbox->tail = 0;
+        outbox->count = 0;
+        if (outbox_sync(outbox) != 0)
+        {
+            (void)fclose(outbox->file);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+OUTBOX_HANDLE outbox_create(const char* file_name, size_t max_file_size, size_t sync_interval)
+{
+    OUTBOX* result;
+    if ((file_name == NULL) ||
+        (max_file_size <= OUTBOX_HEADER_SIZE + OUTBOX_LENGTH_SIZE) ||
+        ((uint64_t)max_file_size - OUTBOX_HEADER_SIZE >= OUTBOX_WRAP_MARKER) ||
+        ((uint64_t)max_file_size > (uint64_t)LONG_MAX))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_001: [ If file_name is NULL or max_file_size cannot hold a header and a record, or is larger than the file offsets allow, outbox_create shall fail and return NULL. ]*/
+        LogError("invalid argument const char* file_name=%p, size_t max_file_size=%lu", file_name, (unsigned long)max_file_size);
+        result = NULL;
+    }
+    else if ((result = (OUTBOX*)malloc(sizeof(OUTBOX))) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_002: [ If any error occurs, outbox_create shall fail and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_003: [ A sync_interval of 0 shall be handled as 1. ]*/
+        result->sync_interval = (sync_interval == 0) ? 1 : sync_interval;
+        result->unsynced_count = 0;
+        result->released_since_sync = 0;
+
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_004: [ If file_name is an outbox file, outbox_create shall keep its records, unread, and its size. ]*/
+        if ((result->file = fopen(file_name, "r+b")) != NULL)
+        {
+            if (load_header(result) != 0)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_005: [ If file_name exists and is not a consistent outbox file, outbox_create shall replace it with an empty outbox file. ]*/
+                LogError("the outbox file %s is reset", file_name);
+                (void)fclose(result->file);
+                result->file = NULL;
+            }
+        }
+
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_006: [ Otherwise outbox_create shall create an empty outbox file of at most max_file_size bytes. ]*/
+        if ((result->file == NULL) && (create_outbox_file(result, file_name, max_file_size) != 0))
+        {
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->synced_head = result->head;
+            result->read_offset = result->head;
+            result->unread_count = result->count;
+        }
+    }
+    return result;
+}
+
+void outbox_destroy(OUTBOX_HANDLE outbox)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_007: [ If outbox is NULL, outbox_destroy shall return. ]*/
+    if (outbox != NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_008: [ outbox_destroy shall sync the changes not synced yet, close the file and free the outbox. ]*/
+        if ((outbox->unsynced_count != 0) && (outbox_sync(outbox) != 0))
+        {
+            LogError("unable to sync the outbox, the last changes may be lost");
+        }
+        (void)fclose(outbox->file);
+        free(outbox);
+    }
+}
+
+int outbox_append(OUTBOX_HANDLE outbox, IOTHUB_MESSAGE_HANDLE message)
+{
+    int result;
+    if ((outbox == NULL) || (message == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_009: [ If outbox or message are NULL, outbox_append shall fail and return a non-zero value. ]*/
+        LogError("invalid argument OUTBOX_HANDLE outbox=%p, IOTHUB_MESSAGE_HANDLE message=%p", outbox, message);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t size;
+        unsigned char* record = serialize_message(message, &size);
+        if (record == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_010: [ If the content, the message id, the correlation id or the properties of message cannot be serialized, outbox_append shall fail and return a non-zero value. ]*/
+            result = __FAILURE__;
+        }
+        else
+        {
+            uint32_t offset;
+            /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_011: [ outbox_append shall not overwrite the records released since the last sync, and sync first if that is the only way for the record to fit. ]*/
+            if ((find_room(outbox, outbox->synced_head, outbox->count + outbox->released_since_sync, size, &offset) != 0) &&
+                ((outbox->released_since_sync == 0) || (outbox_sync(outbox) != 0) || (find_room(outbox, outbox->head, outbox->count, size, &offset) != 0)))
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_012: [ If the record does not fit in the file, outbox_append shall fail and return a non-zero value. ]*/
+                LogError("the outbox is full");
+                result = __FAILURE__;
+            }
+            else
+            {
+                unsigned char wrapMarker[OUTBOX_LENGTH_SIZE];
+                put_uint32(wrapMarker, OUTBOX_WRAP_MARKER);
+                if (offset == 0)
+                {
+                    if ((outbox->count == 0) && (outbox->released_since_sync == 0))
+                    {
+                        outbox->head = 0;
+                        outbox->synced_head = 0;
+                        outbox->read_offset = 0;
+                    }
+                    else if (outbox->capacity - outbox->tail >= OUTBOX_LENGTH_SIZE)
+                    {
+                        /*the reader wraps by itself when there is no room for a length*/
+                        if (write_file(outbox, OUTBOX_HEADER_SIZE + outbox->tail, wrapMarker, sizeof(wrapMarker)) != 0)
+                        {
+                            offset = OUTBOX_WRAP_MARKER;
+                        }
+                    }
+                }
+
+                /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_013: [ outbox_append shall write the serialized message in one record after the newest record, and return 0. ]*/
+                if ((offset == OUTBOX_WRAP_MARKER) || (write_file(outbox, OUTBOX_HEADER_SIZE + offset, record, size) != 0))
+                {
+                    /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_014: [ If writing the file fails, outbox_append shall fail and return a non-zero value. ]*/
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    outbox->tail = offset + (uint32_t)size;
+                    outbox->count++;
+                    outbox->unread_count++;
+                    note_change(outbox);
+                    result = 0;
+                }
+            }
+            free(record);
+        }
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_HANDLE outbox_read_next(OUTBOX_HANDLE outbox)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    if (outbox == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_015: [ If outbox is NULL, outbox_read_next shall return NULL. ]*/
+        LogError("invalid argument OUTBOX_HANDLE outbox=%p", outbox);
+        result = NULL;
+    }
+    else if (outbox->unread_count == 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_016: [ If all the records have been read, outbox_read_next shall return NULL. ]*/
+        result = NULL;
+    }
+    else
+    {
+        uint32_t offset = outbox->read_offset;
+        uint32_t length;
+        unsigned char* record;
+        if (read_record_length(outbox, &offset, &length) != 0)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_017: [ If reading the file fails, outbox_read_next shall return NULL. ]*/
+            result = NULL;
+        }
+        else if ((record = (unsigned char*)malloc((length == 0) ? 1 : length)) == NULL)
+        {
+            LogError("unable to malloc");
+            result = NULL;
+        }
+        else
+        {
+            if (read_file(outbox, OUTBOX_HEADER_SIZE + offset + OUTBOX_LENGTH_SIZE, record, length) != 0)
+            {
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_018: [ outbox_read_next shall create a message from the oldest record not read yet, with its content, message id, correlation id and properties, mark the record as read and return the message. ]*/
+                /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_019: [ If the record cannot be turned into a message, outbox_read_next shall still mark it as read, so that it does not block the records after it, and return NULL. ]*/
+                if ((result = deserialize_message(record, length)) == NULL)
+                {
+                    LogError("unable to create a message from the record at %lu, it is skipped", (unsigned long)offset);
+                }
+                outbox->read_offset = offset + OUTBOX_LENGTH_SIZE + length;
+                outbox->unread_count--;
+            }
+            free(record);
+        }
+    }
+    return result;
+}
+
+int outbox_release_oldest(OUTBOX_HANDLE outbox)
+{
+    int result;
+    if (outbox == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_020: [ If outbox is NULL, outbox_release_oldest shall fail and return a non-zero value. ]*/
+        LogError("invalid argument OUTBOX_HANDLE outbox=%p", outbox);
+        result = __FAILURE__;
+    }
+    else if (outbox->count == outbox->unread_count)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_021: [ If the oldest record was not read, outbox_release_oldest shall fail and return a non-zero value. ]*/
+        LogError("no record was read");
+        result = __FAILURE__;
+    }
+    else
+    {
+        uint32_t offset = outbox->head;
+        uint32_t length;
+        if (read_record_length(outbox, &offset, &length) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_022: [ outbox_release_oldest shall remove the oldest record and return 0. ]*/
+            outbox->head = offset + OUTBOX_LENGTH_SIZE + length;
+            outbox->count--;
+            outbox->released_since_sync++;
+            note_change(outbox);
+            result = 0;
+        }
+    }
+    return result;
+}
+
+void outbox_rewind(OUTBOX_HANDLE outbox)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_023: [ If outbox is NULL, outbox_rewind shall return. ]*/
+    if (outbox != NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_024: [ outbox_rewind shall mark all the records as not read. ]*/
+        outbox->read_offset = outbox->head;
+        outbox->unread_count = outbox->count;
+    }
+}
+
+size_t outbox_get_count(OUTBOX_HANDLE outbox)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_025: [ outbox_get_count shall return the number of records, 0 if outbox is NULL. ]*/
+    return (outbox == NULL) ? 0 : outbox->count;
+}
+
+size_t outbox_get_unread_count(OUTBOX_HANDLE outbox)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_026: [ outbox_get_unread_count shall return the number of records not read, 0 if outbox is NULL. ]*/
+    return (outbox == NULL) ? 0 : outbox->unread_count;
+}
+
+int outbox_sync(OUTBOX_HANDLE outbox)
+{
+    int result;
+    if (outbox == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_027: [ If outbox is NULL, outbox_sync shall fail and return a non-zero value. ]*/
+        LogError("invalid argument OUTBOX_HANDLE outbox=%p", outbox);
+        result = __FAILURE__;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_028: [ outbox_sync shall flush the records to the disk, then write the position of the records and flush it to the disk, and return 0. ]*/
+    else if ((fflush(outbox->file) != 0) || (OUTBOX_SYNC_FILE(outbox->file) != 0))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_OUTBOX_41_029: [ If writing or flushing the file fails, outbox_sync shall fail and return a non-zero value. ]*/
+        LogError("unable to flush the records");
+        result = __FAILURE__;
+    }
+    else if ((write_header(outbox) != 0) || (fflush(outbox->file) != 0) || (OUTBOX_SYNC_FILE(outbox->file) != 0))
+    {
+        LogError("unable to flush the header");
+        result = __FAILURE__;
+    }
+    else
+    {
+        outbox->synced_head = outbox->head;
+        outbox->released_since_sync = 0;
+        outbox->unsynced_count = 0;
+        result = 0;
+    }
+    return result;
+}
@@ -0,0 +1,423 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "iothub_client_pipeline.h"
+#include "iothub_client_crc64.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+#define WINDOW_KEY_COUNT 4
+static const char* const WINDOW_KEY_SUFFIXES[WINDOW_KEY_COUNT] = { "-count", "-min", "-max", "-avg" };
+
+/*room for "%.15g" of any double*/
+#define NUMBER_TEXT_SIZE 32
+
+typedef struct MESSAGE_STAGE_TAG
+{
+    IOTHUB_CLIENT_MESSAGE_STAGE_TYPE type;
+    IOTHUB_CLIENT_MESSAGE_STAGE_CALLBACK callback;
+    void* context;
+    char* propertyName; /*NULL for the custom and dedupe stages, the window keys are in the same allocation*/
+    const char* windowKeys[WINDOW_KEY_COUNT];
+    double deadband;
+    size_t maxSuppressedCount;
+    tickcounter_ms_t windowInMs;
+    bool hasKept; /*false until the stage keeps its first message*/
+    uint64_t keptCrc; /*dedupe: CRC64 and size of the payload of the last message kept*/
+    size_t keptSize;
+    size_t suppressedCount;
+    double keptValue; /*deadband: number of the last message kept*/
+    tickcounter_ms_t windowStart; /*window: when the last message was kept*/
+    size_t windowCount; /*window: numbers since the last message kept*/
+    double windowSum;
+    double windowMin;
+    double windowMax;
+} MESSAGE_STAGE;
+
+typedef struct MESSAGE_PIPELINE_TAG
+{
+    MESSAGE_STAGE* stages;
+    size_t stageCount;
+} MESSAGE_PIPELINE;
+
+static bool is_valid_stage(const IOTHUB_CLIENT_MESSAGE_STAGE* stage)
+{
+    bool result;
+    switch (stage->type)
+    {
+    case IOTHUB_CLIENT_MESSAGE_STAGE_CUSTOM:
+        result = (stage->callback != NULL);
+        break;
+    case IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE:
+        result = true;
+        break;
+    case IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND:
+        result = (stage->propertyName != NULL) && (stage->deadband >= 0);
+        break;
+    case IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW:
+        result = (stage->propertyName != NULL) && (stage->windowInMs != 0);
+        break;
+    default:
+        result = false;
+        break;
+    }
+    return result;
+}
+
+/*the property name is followed by the names of the window aggregates in one allocation*/
+static int copy_property_name(MESSAGE_STAGE* stage, const char* propertyName)
+{
+    int result;
+    size_t nameLength = strlen(propertyName);
+    size_t size = nameLength + 1;
+    size_t i;
+    if (stage->type == IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW)
+    {
+        for (i = 0; i < WINDOW_KEY_COUNT; i++)
+        {
+            size += nameLength + strlen(WINDOW_KEY_SUFFIXES[i]) + 1;
+        }
+    }
+
+    if ((stage->propertyName = (char*)malloc(size)) == NULL)
+    {
+        LogError("unable to malloc");
+        result = __FAILURE__;
+    }
+    else
+    {
+        char* next = stage->propertyName + nameLength + 1;
+        (void)memcpy(stage->propertyName, propertyName, nameLength + 1);
+        if (stage->type == IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW)
+        {
+            for (i = 0; i < WINDOW_KEY_COUNT; i++)
+            {
+                size_t suffixLength = strlen(WINDOW_KEY_SUFFIXES[i]);
+                (void)memcpy(next, propertyName, nameLength);
+                (void)memcpy(next + nameLength, WINDOW_KEY_SUFFIXES[i], suffixLength + 1);
+                stage->windowKeys[i] = next;
+                next += nameLength + suffixLength + 1;
+            }
+        }
+        result = 0;
+    }
+    return result;
+}
+
+static void destroy_stages(MESSAGE_PIPELINE* pipeline)
+{
+    size_t i;
+    for (i = 0; i < pipeline->stageCount; i++)
+    {
+        free(pipeline->stages[i].propertyName);
+    }
+    free(pipeline->stages);
+}
+
+MESSAGE_PIPELINE_HANDLE message_pipeline_create(const IOTHUB_CLIENT_MESSAGE_PIPELINE* config)
+{
+    MESSAGE_PIPELINE* result;
+    size_t i;
+
+    /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_001: [ If config is NULL, its stages are NULL or it has no stages, message_pipeline_create shall fail and return NULL. ]*/
+    if ((config == NULL) || (config->stages == NULL) || (config->stageCount == 0))
+    {
+        LogError("invalid argument config=%p", config);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_002: [ If a custom stage has no callback, a deadband or window stage has no propertyName, a deadband is negative, a window is 0 ms or a type is unknown, message_pipeline_create shall fail and return NULL. ]*/
+        for (i = 0; i < config->stageCount; i++)
+        {
+            if (!is_valid_stage(&config->stages[i]))
+            {
+                break;
+            }
+        }
+
+        if (i < config->stageCount)
+        {
+            LogError("invalid stage %lu", (unsigned long)i);
+            result = NULL;
+        }
+        else if ((result = (MESSAGE_PIPELINE*)malloc(sizeof(MESSAGE_PIPELINE))) == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_004: [ If any error occurs, message_pipeline_create shall fail and return NULL. ]*/
+            LogError("unable to malloc");
+        }
+        else if ((result->stages = (MESSAGE_STAGE*)malloc(config->stageCount * sizeof(MESSAGE_STAGE))) == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_004: [ If any error occurs, message_pipeline_create shall fail and return NULL. ]*/
+            LogError("unable to malloc");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_003: [ message_pipeline_create shall copy the stages of config and their propertyName and return a non-NULL handle. ]*/
+            (void)memset(result->stages, 0, config->stageCount * sizeof(MESSAGE_STAGE));
+            for (result->stageCount = 0; result->stageCount < config->stageCount; result->stageCount++)
+            {
+                const IOTHUB_CLIENT_MESSAGE_STAGE* from = &config->stages[result->stageCount];
+                MESSAGE_STAGE* stage = &result->stages[result->stageCount];
+                stage->type = from->type;
+                stage->callback = from->callback;
+                stage->context = from->context;
+                stage->deadband = from->deadband;
+                stage->maxSuppressedCount = from->maxSuppressedCount;
+                stage->windowInMs = from->windowInMs;
+                if ((from->type == IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND) || (from->type == IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW))
+                {
+                    if (copy_property_name(stage, from->propertyName) != 0)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            if (result->stageCount < config->stageCount)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_004: [ If any error occurs, message_pipeline_create shall fail and return NULL. ]*/
+                destroy_stages(result);
+                free(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
+
+void message_pipeline_destroy(MESSAGE_PIPELINE_HANDLE pipeline)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_005: [ If pipeline is NULL, message_pipeline_destroy shall do nothing. ]*/
+    if (pipeline != NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_006: [ message_pipeline_destroy shall free the stages and the pipeline. ]*/
+        destroy_stages(pipeline);
+        free(pipeline);
+    }
+}
+
+/*the CRC64 of the segments of a byte array in place, not of the copy IoTHubMessage_GetByteArray makes of them*/
+static int get_payload_crc(IOTHUB_MESSAGE_HANDLE message, uint64_t* crc, size_t* size)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message);
+    *crc = 0;
+    *size = 0;
+    if (contentType == IOTHUBMESSAGE_STRING)
+    {
+        const char* text = IoTHubMessage_GetString(message);
+        if (text == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            *size = strlen(text);
+            *crc = crc64_compute(0, (const unsigned char*)text, *size);
+            result = 0;
+        }
+    }
+    else if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        size_t segmentCount = IoTHubMessage_GetSegmentCount(message);
+        size_t i;
+        for (i = 0; i < segmentCount; i++)
+        {
+            const unsigned char* buffer;
+            size_t bufferSize;
+            if (IoTHubMessage_GetSegment(message, i, &buffer, &bufferSize) != IOTHUB_MESSAGE_OK)
+            {
+                break;
+            }
+            *crc = crc64_compute(*crc, buffer, bufferSize);
+            *size += bufferSize;
+        }
+        result = (i == segmentCount) ? 0 : __FAILURE__;
+    }
+    else
+    {
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_MESSAGE_STAGE_RESULT process_dedupe(MESSAGE_STAGE* stage, IOTHUB_MESSAGE_HANDLE message)
+{
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT result;
+    uint64_t crc;
+    size_t size;
+    if (get_payload_crc(message, &crc, &size) != 0)
+    {
+        LogError("unable to read the payload, the message is kept");
+        result = IOTHUB_CLIENT_MESSAGE_STAGE_KEEP;
+    }
+    else if (stage->hasKept && (crc == stage->keptCrc) && (size == stage->keptSize) &&
+        ((stage->maxSuppressedCount == 0) || (stage->suppressedCount < stage->maxSuppressedCount)))
+    {
+        stage->suppressedCount++;
+        result = IOTHUB_CLIENT_MESSAGE_STAGE_DROP;
+    }
+    else
+    {
+        stage->hasKept = true;
+        stage->keptCrc = crc;
+        stage->keptSize = size;
+        stage->suppressedCount = 0;
+        result = IOTHUB_CLIENT_MESSAGE_STAGE_KEEP;
+    }
+    return result;
+}
+
+/*the whole value of the property has to be a number*/
+static int get_property_number(IOTHUB_MESSAGE_HANDLE message, const char* propertyName, double* value)
+{
+    int result;
+    MAP_HANDLE properties = IoTHubMessage_Properties(message);
+    const char* text = (properties == NULL) ? NULL : Map_GetValueFromKey(properties, propertyName);
+    char* end;
+    if ((text == NULL) || (*text == '\0'))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *value = strtod(text, &end);
+        result = (*end == '\0') ? 0 : __FAILURE__;
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_MESSAGE_STAGE_RESULT process_deadband(MESSAGE_STAGE* stage, IOTHUB_MESSAGE_HANDLE message)
+{
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT result;
+    double value;
+    if (get_property_number(message, stage->propertyName, &value) != 0)
+    {
+        result = IOTHUB_CLIENT_MESSAGE_STAGE_KEEP;
+    }
+    else if (stage->hasKept && (value - stage->keptValue < stage->deadband) && (stage->keptValue - value < stage->deadband))
+    {
+        result = IOTHUB_CLIENT_MESSAGE_STAGE_DROP;
+    }
+    else
+    {
+        stage->hasKept = true;
+        stage->keptValue = value;
+        result = IOTHUB_CLIENT_MESSAGE_STAGE_KEEP;
+    }
+    return result;
+}
+
+static void set_window_properties(MESSAGE_STAGE* stage, IOTHUB_MESSAGE_HANDLE message)
+{
+    char values[WINDOW_KEY_COUNT][NUMBER_TEXT_SIZE];
+    MAP_HANDLE properties = IoTHubMessage_Properties(message);
+    size_t i;
+    (void)snprintf(values[0], NUMBER_TEXT_SIZE, "%lu", (unsigned long)stage->windowCount);
+    (void)snprintf(values[1], NUMBER_TEXT_SIZE, "%.15g", stage->windowMin);
+    (void)snprintf(values[2], NUMBER_TEXT_SIZE, "%.15g", stage->windowMax);
+    (void)snprintf(values[3], NUMBER_TEXT_SIZE, "%.15g", stage->windowSum / (double)stage->windowCount);
+    for (i = 0; i < WINDOW_KEY_COUNT; i++)
+    {
+        if (Map_AddOrUpdate(properties, stage->windowKeys[i], values[i]) != MAP_OK)
+        {
+            LogError("unable to set %s, the message is kept without it", stage->windowKeys[i]);
+        }
+    }
+}
+
+static IOTHUB_CLIENT_MESSAGE_STAGE_RESULT process_window(MESSAGE_STAGE* stage, IOTHUB_MESSAGE_HANDLE message, tickcounter_ms_t nowMs)
+{
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT result;
+    double value;
+    if (get_property_number(message, stage->propertyName, &value) != 0)
+    {
+        result = IOTHUB_CLIENT_MESSAGE_STAGE_KEEP;
+    }
+    else
+    {
+        if ((stage->windowCount == 0) || (value < stage->windowMin))
+        {
+            stage->windowMin = value;
+        }
+        if ((stage->windowCount == 0) || (value > stage->windowMax))
+        {
+            stage->windowMax = value;
+        }
+        stage->windowSum += value;
+        stage->windowCount++;
+
+        if (stage->hasKept && (nowMs - stage->windowStart < stage->windowInMs))
+        {
+            result = IOTHUB_CLIENT_MESSAGE_STAGE_DROP;
+        }
+        else
+        {
+            set_window_properties(stage, message);
+            stage->hasKept = true;
+            stage->windowStart = nowMs;
+            stage->windowCount = 0;
+            stage->windowSum = 0;
+            result = IOTHUB_CLIENT_MESSAGE_STAGE_KEEP;
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_MESSAGE_STAGE_RESULT message_pipeline_process(MESSAGE_PIPELINE_HANDLE pipeline, IOTHUB_MESSAGE_HANDLE message, tickcounter_ms_t nowMs)
+{
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT result = IOTHUB_CLIENT_MESSAGE_STAGE_KEEP;
+    size_t i;
+
+    /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_007: [ If pipeline or message is NULL, message_pipeline_process shall return IOTHUB_CLIENT_MESSAGE_STAGE_KEEP. ]*/
+    if ((pipeline == NULL) || (message == NULL))
+    {
+        LogError("invalid argument pipeline=%p, message=%p", pipeline, message);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_008: [ message_pipeline_process shall give message to the stages in order and return IOTHUB_CLIENT_MESSAGE_STAGE_DROP as soon as one of them drops it, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP if they all keep it. ]*/
+        for (i = 0; (i < pipeline->stageCount) && (result == IOTHUB_CLIENT_MESSAGE_STAGE_KEEP); i++)
+        {
+            MESSAGE_STAGE* stage = &pipeline->stages[i];
+            switch (stage->type)
+            {
+            case IOTHUB_CLIENT_MESSAGE_STAGE_CUSTOM:
+                /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_009: [ A custom stage shall call its callback with message and its context and keep or drop the message as the callback returns. ]*/
+                result = stage->callback(message, stage->context);
+                break;
+            case IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE:
+                /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_010: [ A dedupe stage shall drop a message whose payload has the size and CRC64 of the payload of the last message it kept, unless maxSuppressedCount is not 0 and that many were dropped in a row already. ]*/
+                /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_011: [ A dedupe stage shall compute the CRC64 of the segments of a byte array message in place. ]*/
+                result = process_dedupe(stage, message);
+                break;
+            case IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND:
+                /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_012: [ A deadband stage shall drop a message whose application property propertyName is a number less than deadband away from the number of the last message it kept, and keep the messages without a number in it. ]*/
+                result = process_deadband(stage, message);
+                break;
+            case IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW:
+                /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_013: [ A window stage shall keep the first message with a number in the application property propertyName and then the first one windowInMs or more after the last one it kept, dropping those in between, and keep the messages without a number in it. ]*/
+                /*Codes_SRS_IOTHUB_CLIENT_PIPELINE_41_014: [ A window stage shall set the application properties propertyName-count, -min, -max and -avg of the message it keeps to the count, minimum, maximum and average of the numbers of the messages since the last one it kept, itself included. ]*/
+                result = process_window(stage, message, nowMs);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return result;
+}
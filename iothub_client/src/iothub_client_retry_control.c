@@ -4,72 +4,70 @@
 #include "iothub_client_retry_control.h"
 
 #include <math.h>
+#include <limits.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
 
 #define RESULT_OK           0
 #define INDEFINITE_TIME     ((time_t)-1)
+#define INDEFINITE_TIME_MS  ((tickcounter_ms_t)-1)
+#define DEFAULT_MAX_WAIT_TIME_IN_MS     60000
+#define HELD_BACK_WAIT_TIME_IN_MS       1000
+
+typedef enum RETRY_COORDINATOR_STATE_TAG
+{
+	RETRY_COORDINATOR_STATE_CLOSED,
+	RETRY_COORDINATOR_STATE_OPEN,
+	RETRY_COORDINATOR_STATE_HALF_OPEN
+} RETRY_COORDINATOR_STATE;
+
+typedef struct RETRY_COORDINATOR_INSTANCE_TAG
+{
+	LOCK_HANDLE lock;
+	unsigned int retry_budget;
+	unsigned int retries_per_sec;
+	unsigned int failure_threshold;
+	unsigned int open_time_in_secs;
+
+	unsigned int available_retries;
+	time_t last_refill_time;
+	unsigned int failure_count;
+	RETRY_COORDINATOR_STATE state;
+	time_t state_change_time;
+	const void* probe_owner;
+} RETRY_COORDINATOR_INSTANCE;
 
 typedef struct RETRY_CONTROL_INSTANCE_TAG
 {
 	IOTHUB_CLIENT_RETRY_POLICY policy;
 	unsigned int max_retry_time_in_secs;
+	TICK_COUNTER_HANDLE tick_counter;
 
-	unsigned int initial_wait_time_in_secs;
+	unsigned int initial_wait_time_in_ms;
+	unsigned int max_wait_time_in_ms;
 	unsigned int max_jitter_percent;
 
 	unsigned int retry_count;
-	time_t first_retry_time;
-	time_t last_retry_time;
-	unsigned int current_wait_time_in_secs;
-} RETRY_CONTROL_INSTANCE;
+	tickcounter_ms_t first_retry_time;
+	tickcounter_ms_t last_retry_time;
+	unsigned int current_wait_time_in_ms;
 
-typedef int (*RETRY_ACTION_EVALUATION_FUNCTION)(RETRY_CONTROL_INSTANCE* retry_state, RETRY_ACTION* retry_action);
+	RETRY_COORDINATOR_INSTANCE* retry_coordinator;
+	bool is_failure_counted;
+	bool is_held_back;
+} RETRY_CONTROL_INSTANCE;
 
 
 // ========== Helper Functions ========== //
 
-static int evaluate_retry_action_fixed_interval(RETRY_CONTROL_INSTANCE* retry_control, RETRY_ACTION* retry_action)
-{
-	int result;
-
-	time_t current_time;
-
-	if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
-	{
-		LogError("Cannot evaluate if should retry (get_time failed)");
-		result = __FAILURE__;
-	}
-	else
-	{
-		if (retry_control->max_retry_time_in_secs > 0 &&
-			get_difftime(current_time, retry_control->last_retry_time) >= retry_control->max_retry_time_in_secs)
-		{
-			*retry_action = RETRY_ACTION_STOP_RETRYING;
-		}
-		else
-		{
-			if (get_difftime(current_time, retry_control->last_retry_time) >= retry_control->current_wait_time_in_secs)
-			{
-				*retry_action = RETRY_ACTION_RETRY_NOW;
-				retry_control->last_retry_time = current_time;
-			}
-			else
-			{
-				*retry_action = RETRY_ACTION_RETRY_LATER;
-			}
-		}
-
-		result = RESULT_OK;
-	}
-
-	return result;
-}
-
-
 // ---------- Set/Retrieve Options Helpers ----------//
 
 static void* retry_control_clone_option(const char* name, const void* value)
@@ -82,6 +80,8 @@ static void* retry_control_clone_option(const char* name, const void* value)
 		result = NULL;
 	}
 	else if (strcmp(RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, name) == 0 ||
+			strcmp(RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, name) == 0 ||
+			strcmp(RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS, name) == 0 ||
 			strcmp(RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, name) == 0)
 	{
 		unsigned int* cloned_value;
@@ -114,6 +114,8 @@ static void retry_control_destroy_option(const char* name, const void* value)
 		LogError("Failed to destroy option (either name (%p) or value (%p) are NULL)", name, value);
 	}
 	else if (strcmp(RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, name) == 0 ||
+		strcmp(RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, name) == 0 ||
+		strcmp(RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS, name) == 0 ||
 		strcmp(RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, name) == 0)
 	{
 		free((void*)value);
@@ -137,7 +139,7 @@ static int evaluate_retry_action(RETRY_CONTROL_INSTANCE* retry_control, RETRY_AC
 		result = RESULT_OK;
 	}
 	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_020: [If `retry_control->last_retry_time` is INDEFINITE_TIME and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, the evaluation function shall return non-zero]
-	else if (retry_control->last_retry_time == INDEFINITE_TIME &&
+	else if (retry_control->last_retry_time == INDEFINITE_TIME_MS &&
 		     retry_control->policy != IOTHUB_CLIENT_RETRY_IMMEDIATE)
 	{
 		LogError("Failed to evaluate retry action (last_retry_time is INDEFINITE_TIME)");
@@ -145,18 +147,18 @@ static int evaluate_retry_action(RETRY_CONTROL_INSTANCE* retry_control, RETRY_AC
 	}
 	else
 	{
-		time_t current_time;
+		tickcounter_ms_t current_time;
 
-		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_021: [`current_time` shall be set using get_time()]
-		if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_021: [`current_time` shall be set using tickcounter_get_current_ms()]
+		if (tickcounter_get_current_ms(retry_control->tick_counter, &current_time) != 0)
 		{
-			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_022: [If get_time() fails, the evaluation function shall return non-zero]
-			LogError("Failed to evaluate retry action (get_time() failed)");
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_022: [If tickcounter_get_current_ms() fails, the evaluation function shall return non-zero]
+			LogError("Failed to evaluate retry action (tickcounter_get_current_ms() failed)");
 			result = __FAILURE__;
 		}
 		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_023: [If `retry_control->max_retry_time_in_secs` is not 0 and (`current_time` - `retry_control->first_retry_time`) is greater than or equal to `retry_control->max_retry_time_in_secs`, `retry_action` shall be set to RETRY_ACTION_STOP_RETRYING]
 		else if (retry_control->max_retry_time_in_secs > 0 &&
-			get_difftime(current_time, retry_control->first_retry_time) >= retry_control->max_retry_time_in_secs)
+			(current_time - retry_control->first_retry_time) >= (tickcounter_ms_t)retry_control->max_retry_time_in_secs * 1000)
 		{
 			*retry_action = RETRY_ACTION_STOP_RETRYING;
 
@@ -171,15 +173,15 @@ static int evaluate_retry_action(RETRY_CONTROL_INSTANCE* retry_control, RETRY_AC
 			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_026: [If no errors occur, the evaluation function shall return 0]
 			result = RESULT_OK;
 		}
-		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_024: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is less than `retry_control->current_wait_time_in_secs`, `retry_action` shall be set to RETRY_ACTION_RETRY_LATER]
-		else if (get_difftime(current_time, retry_control->last_retry_time) < retry_control->current_wait_time_in_secs)
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_024: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is less than `retry_control->current_wait_time_in_ms`, `retry_action` shall be set to RETRY_ACTION_RETRY_LATER]
+		else if ((current_time - retry_control->last_retry_time) < retry_control->current_wait_time_in_ms)
 		{
 			*retry_action = RETRY_ACTION_RETRY_LATER;
 
 			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_026: [If no errors occur, the evaluation function shall return 0]
 			result = RESULT_OK;
 		}
-		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_025: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is greater or equal to `retry_control->current_wait_time_in_secs`, `retry_action` shall be set to RETRY_ACTION_RETRY_NOW]
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_025: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is greater or equal to `retry_control->current_wait_time_in_ms`, `retry_action` shall be set to RETRY_ACTION_RETRY_NOW]
 		else
 		{
 			*retry_action = RETRY_ACTION_RETRY_NOW;
@@ -196,33 +198,43 @@ static unsigned int calculate_next_wait_time(RETRY_CONTROL_INSTANCE* retry_contr
 {
 	unsigned int result;
 
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_029: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_INTERVAL, `calculate_next_wait_time` shall return `retry_control->initial_wait_time_in_secs`]
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_029: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_INTERVAL, `calculate_next_wait_time` shall return `retry_control->initial_wait_time_in_ms`]
 	if (retry_control->policy == IOTHUB_CLIENT_RETRY_INTERVAL)
 	{
-		result = retry_control->initial_wait_time_in_secs;
+		result = retry_control->initial_wait_time_in_ms;
 	}
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (`retry_control->retry_count`))]
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_ms` * (`retry_control->retry_count`))]
 	else if (retry_control->policy == IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF)
 	{
-		result = retry_control->initial_wait_time_in_secs * (retry_control->retry_count);
+		result = retry_control->initial_wait_time_in_ms * (retry_control->retry_count);
 	}
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `calculate_next_wait_time` shall return (pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`)]
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `calculate_next_wait_time` shall return (pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_ms`)]
 	else if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF)
 	{
-		result = (unsigned int)(pow(2, retry_control->retry_count - 1) * retry_control->initial_wait_time_in_secs);
+		result = (unsigned int)(pow(2, retry_control->retry_count - 1) * retry_control->initial_wait_time_in_ms);
 	}
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `calculate_next_wait_time` shall return ((pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`) * (1 + (`retry_control->max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `calculate_next_wait_time` shall return ((pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_ms`) * (1 + (`retry_control->max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
 	else if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER)
 	{
 		double jitter_percent = (retry_control->max_jitter_percent / 100) * (rand() / RAND_MAX);
 
-		result = (unsigned int)(pow(2, retry_control->retry_count - 1) * retry_control->initial_wait_time_in_secs * (1 + jitter_percent));
+		result = (unsigned int)(pow(2, retry_control->retry_count - 1) * retry_control->initial_wait_time_in_ms * (1 + jitter_percent));
 	}
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_033: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_RANDOM, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (rand() / RAND_MAX))]
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_033: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_RANDOM, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_ms` * (rand() / RAND_MAX))]
 	else if (retry_control->policy == IOTHUB_CLIENT_RETRY_RANDOM)
 	{
 		double random_percent = ((double)rand() / (double)RAND_MAX);
-		result = (unsigned int)(retry_control->initial_wait_time_in_secs * random_percent);
+		result = (unsigned int)(retry_control->initial_wait_time_in_ms * random_percent);
+	}
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_019: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, `calculate_next_wait_time` shall return a random wait between `retry_control->initial_wait_time_in_ms` and 3 times the previous wait, bounded by `retry_control->max_wait_time_in_ms`]
+	else if (retry_control->policy == IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER)
+	{
+		double lower_bound = retry_control->initial_wait_time_in_ms;
+		double upper_bound = 3.0 * (retry_control->current_wait_time_in_ms > retry_control->initial_wait_time_in_ms ?
+			retry_control->current_wait_time_in_ms : retry_control->initial_wait_time_in_ms);
+		double wait_time = lower_bound + (upper_bound - lower_bound) * ((double)rand() / (double)RAND_MAX);
+
+		result = (wait_time >= retry_control->max_wait_time_in_ms ? retry_control->max_wait_time_in_ms : (unsigned int)wait_time);
 	}
 	else
 	{
@@ -235,6 +247,175 @@ static unsigned int calculate_next_wait_time(RETRY_CONTROL_INSTANCE* retry_contr
 }
 
 
+// ========== Retry Coordinator Auxiliary Functions ========== //
+
+static void refill_retry_budget(RETRY_COORDINATOR_INSTANCE* retry_coordinator, time_t current_time)
+{
+	if (retry_coordinator->last_refill_time == INDEFINITE_TIME)
+	{
+		retry_coordinator->last_refill_time = current_time;
+	}
+	else
+	{
+		double secs_since_last_refill = get_difftime(current_time, retry_coordinator->last_refill_time);
+
+		if (secs_since_last_refill >= 1)
+		{
+			double refill = secs_since_last_refill * retry_coordinator->retries_per_sec;
+
+			if (refill >= (double)(retry_coordinator->retry_budget - retry_coordinator->available_retries))
+			{
+				retry_coordinator->available_retries = retry_coordinator->retry_budget;
+			}
+			else
+			{
+				retry_coordinator->available_retries += (unsigned int)refill;
+			}
+
+			retry_coordinator->last_refill_time = current_time;
+		}
+	}
+}
+
+static void open_circuit(RETRY_COORDINATOR_INSTANCE* retry_coordinator, time_t current_time)
+{
+	LogError("Too many connection failures, no connection retry shall be attempted for %u secs", retry_coordinator->open_time_in_secs);
+
+	retry_coordinator->state = RETRY_COORDINATOR_STATE_OPEN;
+	retry_coordinator->state_change_time = current_time;
+	retry_coordinator->probe_owner = NULL;
+}
+
+static bool admit_retry(RETRY_COORDINATOR_INSTANCE* retry_coordinator, RETRY_CONTROL_INSTANCE* retry_control)
+{
+	bool result;
+
+	if (Lock(retry_coordinator->lock) != LOCK_OK)
+	{
+		LogError("Failed to consult the retry coordinator (Lock failed); assuming the retry is admitted.");
+		result = true;
+	}
+	else
+	{
+		time_t current_time;
+
+		if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+		{
+			LogError("Failed to consult the retry coordinator (get_time() failed); assuming the retry is admitted.");
+			result = true;
+		}
+		else if (retry_coordinator->state == RETRY_COORDINATOR_STATE_CLOSED)
+		{
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_007: [If the circuit is closed, the failed attempt of `retry_control` shall be counted once, however many times the retry is held back]
+			if (!retry_control->is_failure_counted)
+			{
+				retry_control->is_failure_counted = true;
+				retry_coordinator->failure_count++;
+			}
+
+			refill_retry_budget(retry_coordinator, current_time);
+
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_008: [If `failure_threshold` failures were counted, the circuit shall open and the retry shall not be admitted]
+			if (retry_coordinator->failure_count >= retry_coordinator->failure_threshold)
+			{
+				open_circuit(retry_coordinator, current_time);
+				result = false;
+			}
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_009: [Otherwise the retry shall be admitted only if a token of the retry budget is available, and it shall take it]
+			else if (retry_coordinator->available_retries == 0)
+			{
+				result = false;
+			}
+			else
+			{
+				retry_coordinator->available_retries--;
+				result = true;
+			}
+		}
+		else if (retry_coordinator->state == RETRY_COORDINATOR_STATE_OPEN)
+		{
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_010: [If the circuit is open for `open_time_in_secs` or more, it shall be half-open and the retry of `retry_control` shall be admitted as the single probe]
+			if (get_difftime(current_time, retry_coordinator->state_change_time) >= retry_coordinator->open_time_in_secs)
+			{
+				retry_coordinator->state = RETRY_COORDINATOR_STATE_HALF_OPEN;
+				retry_coordinator->state_change_time = current_time;
+				retry_coordinator->probe_owner = retry_control;
+				result = true;
+			}
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_011: [Otherwise, while the circuit is open, no retry shall be admitted]
+			else
+			{
+				result = false;
+			}
+		}
+		else
+		{
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_012: [If the circuit is half-open and the probe asks to retry again, the probe failed and the circuit shall open again]
+			if (retry_coordinator->probe_owner == retry_control)
+			{
+				open_circuit(retry_coordinator, current_time);
+				result = false;
+			}
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_013: [If the circuit is half-open and the probe was released or has not completed for `open_time_in_secs`, the retry of `retry_control` shall be admitted as the new probe]
+			else if (retry_coordinator->probe_owner == NULL ||
+				get_difftime(current_time, retry_coordinator->state_change_time) >= retry_coordinator->open_time_in_secs)
+			{
+				retry_coordinator->state_change_time = current_time;
+				retry_coordinator->probe_owner = retry_control;
+				result = true;
+			}
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_014: [Otherwise, while the probe is pending, no other retry shall be admitted]
+			else
+			{
+				result = false;
+			}
+		}
+
+		if (result)
+		{
+			retry_control->is_failure_counted = false;
+		}
+
+		(void)Unlock(retry_coordinator->lock);
+	}
+
+	return result;
+}
+
+static void report_connection_success(RETRY_COORDINATOR_INSTANCE* retry_coordinator)
+{
+	if (Lock(retry_coordinator->lock) != LOCK_OK)
+	{
+		LogError("Failed to report the connection success to the retry coordinator (Lock failed)");
+	}
+	else
+	{
+		retry_coordinator->state = RETRY_COORDINATOR_STATE_CLOSED;
+		retry_coordinator->failure_count = 0;
+		retry_coordinator->probe_owner = NULL;
+
+		(void)Unlock(retry_coordinator->lock);
+	}
+}
+
+static void release_probe(RETRY_COORDINATOR_INSTANCE* retry_coordinator, RETRY_CONTROL_INSTANCE* retry_control)
+{
+	if (Lock(retry_coordinator->lock) != LOCK_OK)
+	{
+		LogError("Failed to release the retry coordinator probe (Lock failed)");
+	}
+	else
+	{
+		if (retry_coordinator->probe_owner == retry_control)
+		{
+			retry_coordinator->probe_owner = NULL;
+		}
+
+		(void)Unlock(retry_coordinator->lock);
+	}
+}
+
+
 // ========== Public API ========== //
 
 int is_timeout_reached(time_t start_time, unsigned int timeout_in_secs, bool* is_timed_out)
@@ -296,11 +477,19 @@ void retry_control_reset(RETRY_CONTROL_HANDLE retry_control_handle)
 	{
 		RETRY_CONTROL_INSTANCE* retry_control = (RETRY_CONTROL_INSTANCE*)retry_control_handle;
 
-		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_035: [`retry_control` shall have fields `retry_count` and `current_wait_time_in_secs` set to 0 (zero), `first_retry_time` and `last_retry_time` set to INDEFINITE_TIME]
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_035: [`retry_control` shall have fields `retry_count` and `current_wait_time_in_ms` set to 0 (zero), `first_retry_time` and `last_retry_time` set to INDEFINITE_TIME]
 		retry_control->retry_count = 0;
-		retry_control->current_wait_time_in_secs = 0;
-		retry_control->first_retry_time = INDEFINITE_TIME;
-		retry_control->last_retry_time = INDEFINITE_TIME;
+		retry_control->current_wait_time_in_ms = 0;
+		retry_control->first_retry_time = INDEFINITE_TIME_MS;
+		retry_control->last_retry_time = INDEFINITE_TIME_MS;
+		retry_control->is_failure_counted = false;
+		retry_control->is_held_back = false;
+
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_015: [If a retry coordinator is set, `retry_control_reset` shall report the connection success to it, closing its circuit and clearing its failure count]
+		if (retry_control->retry_coordinator != NULL)
+		{
+			report_connection_success(retry_control->retry_coordinator);
+		}
 	}
 }
 
@@ -321,23 +510,38 @@ RETRY_CONTROL_HANDLE retry_control_create(IOTHUB_CLIENT_RETRY_POLICY policy, uns
 		retry_control->policy = policy;
 		retry_control->max_retry_time_in_secs = max_retry_time_in_secs;
 
-		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_005: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF or IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `retry_control->initial_wait_time_in_secs` shall be set to 1]
-		if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF ||
-			retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER)
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_020: [`retry_control->tick_counter` shall be created using tickcounter_create()]
+		if ((retry_control->tick_counter = tickcounter_create()) == NULL)
 		{
-			retry_control->initial_wait_time_in_secs = 1;
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_021: [If tickcounter_create fails, `retry_control_create` shall fail and return NULL]
+			LogError("Failed creating the retry control (tickcounter_create failed)");
+			free(retry_control);
+			retry_control = NULL;
 		}
-		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_006: [Otherwise `retry_control->initial_wait_time_in_secs` shall be set to 5]
 		else
 		{
-			retry_control->initial_wait_time_in_secs = 5;
-		}
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_005: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER or IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, `retry_control->initial_wait_time_in_ms` shall be set to 1000]
+			if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF ||
+				retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER ||
+				retry_control->policy == IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER)
+			{
+				retry_control->initial_wait_time_in_ms = 1000;
+			}
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_006: [Otherwise `retry_control->initial_wait_time_in_ms` shall be set to 5000]
+			else
+			{
+				retry_control->initial_wait_time_in_ms = 5000;
+			}
 
-		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_007: [`retry_control->max_jitter_percent` shall be set to 5]
-		retry_control->max_jitter_percent = 5;
-	
-		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_008: [The remaining fields in `retry_control` shall be initialized according to retry_control_reset()]
-		retry_control_reset(retry_control);
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_022: [`retry_control->max_wait_time_in_ms` shall be set to 60000]
+			retry_control->max_wait_time_in_ms = DEFAULT_MAX_WAIT_TIME_IN_MS;
+
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_007: [`retry_control->max_jitter_percent` shall be set to 5]
+			retry_control->max_jitter_percent = 5;
+
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_008: [The remaining fields in `retry_control` shall be initialized according to retry_control_reset()]
+			retry_control_reset(retry_control);
+		}
 	}
 
 	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_009: [If no errors occur, `retry_control_create` shall return a handle to `retry_control`]
@@ -353,11 +557,79 @@ void retry_control_destroy(RETRY_CONTROL_HANDLE retry_control_handle)
 	}
 	else
 	{
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_016: [If a retry coordinator is set and `retry_control_handle` holds its probe, `retry_control_destroy` shall release the probe]
+		if (retry_control_handle->retry_coordinator != NULL)
+		{
+			release_probe(retry_control_handle->retry_coordinator, retry_control_handle);
+		}
+
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_023: [`retry_control_destroy` shall destroy `retry_control_handle->tick_counter` using tickcounter_destroy()]
+		tickcounter_destroy(retry_control_handle->tick_counter);
+
 		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_056: [`retry_control_destroy` shall destroy `retry_control_handle` using free()]
 		free(retry_control_handle);
 	}
 }
 
+RETRY_COORDINATOR_HANDLE retry_coordinator_create(unsigned int retry_budget, unsigned int retries_per_sec, unsigned int failure_threshold, unsigned int open_time_in_secs)
+{
+	RETRY_COORDINATOR_INSTANCE* retry_coordinator;
+
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_001: [If `retry_budget`, `retries_per_sec` or `failure_threshold` are 0, `retry_coordinator_create` shall fail and return NULL]
+	if (retry_budget == 0 || retries_per_sec == 0 || failure_threshold == 0)
+	{
+		LogError("Failed creating the retry coordinator (retry_budget (%u), retries_per_sec (%u) and failure_threshold (%u) must be greater than 0)", retry_budget, retries_per_sec, failure_threshold);
+		retry_coordinator = NULL;
+	}
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_002: [`retry_coordinator_create` shall allocate memory for the retry coordinator and create its lock]
+	else if ((retry_coordinator = (RETRY_COORDINATOR_INSTANCE*)malloc(sizeof(RETRY_COORDINATOR_INSTANCE))) == NULL)
+	{
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_003: [If malloc or Lock_Init fail, `retry_coordinator_create` shall fail and return NULL]
+		LogError("Failed creating the retry coordinator (malloc failed)");
+	}
+	else
+	{
+		memset(retry_coordinator, 0, sizeof(RETRY_COORDINATOR_INSTANCE));
+
+		if ((retry_coordinator->lock = Lock_Init()) == NULL)
+		{
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_003: [If malloc or Lock_Init fail, `retry_coordinator_create` shall fail and return NULL]
+			LogError("Failed creating the retry coordinator (Lock_Init failed)");
+			free(retry_coordinator);
+			retry_coordinator = NULL;
+		}
+		else
+		{
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_004: [The retry coordinator shall start with its circuit closed and its retry budget full]
+			retry_coordinator->retry_budget = retry_budget;
+			retry_coordinator->retries_per_sec = retries_per_sec;
+			retry_coordinator->failure_threshold = failure_threshold;
+			retry_coordinator->open_time_in_secs = open_time_in_secs;
+			retry_coordinator->available_retries = retry_budget;
+			retry_coordinator->last_refill_time = INDEFINITE_TIME;
+			retry_coordinator->state = RETRY_COORDINATOR_STATE_CLOSED;
+			retry_coordinator->state_change_time = INDEFINITE_TIME;
+		}
+	}
+
+	return (RETRY_COORDINATOR_HANDLE)retry_coordinator;
+}
+
+void retry_coordinator_destroy(RETRY_COORDINATOR_HANDLE retry_coordinator_handle)
+{
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_017: [If `retry_coordinator_handle` is NULL, `retry_coordinator_destroy` shall return]
+	if (retry_coordinator_handle == NULL)
+	{
+		LogError("Failed to destroy the retry coordinator (retry_coordinator_handle is NULL)");
+	}
+	else
+	{
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_018: [`retry_coordinator_destroy` shall destroy the lock and free the retry coordinator]
+		(void)Lock_Deinit(retry_coordinator_handle->lock);
+		free(retry_coordinator_handle);
+	}
+}
+
 int retry_control_should_retry(RETRY_CONTROL_HANDLE retry_control_handle, RETRY_ACTION* retry_action)
 {
 	int result;
@@ -378,11 +650,12 @@ int retry_control_should_retry(RETRY_CONTROL_HANDLE retry_control_handle, RETRY_
 			*retry_action = RETRY_ACTION_STOP_RETRYING;
 			result = RESULT_OK;
 		}
-		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_011: [If `retry_control->first_retry_time` is INDEFINITE_TIME, it shall be set using get_time()]
-		else if (retry_control->first_retry_time == INDEFINITE_TIME && (retry_control->first_retry_time = get_time(NULL)) == INDEFINITE_TIME)
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_011: [If `retry_control->first_retry_time` is INDEFINITE_TIME, it shall be set using tickcounter_get_current_ms()]
+		else if (retry_control->first_retry_time == INDEFINITE_TIME_MS && tickcounter_get_current_ms(retry_control->tick_counter, &retry_control->first_retry_time) != 0)
 		{
-			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_012: [If get_time() fails, `retry_control_should_retry` shall fail and return non-zero]
-			LogError("Failed to evaluate if retry should be attempted (get_time() failed)");
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_012: [If tickcounter_get_current_ms() fails, `retry_control_should_retry` shall fail and return non-zero]
+			LogError("Failed to evaluate if retry should be attempted (tickcounter_get_current_ms() failed)");
+			retry_control->first_retry_time = INDEFINITE_TIME_MS;
 			result = __FAILURE__;
 		}
 		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_013: [evaluate_retry_action() shall be invoked]
@@ -394,6 +667,19 @@ int retry_control_should_retry(RETRY_CONTROL_HANDLE retry_control_handle, RETRY_
 		}
 		else
 		{
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_006: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and a retry coordinator is set, `retry_action` shall be set to RETRY_ACTION_RETRY_LATER unless the retry coordinator admits the retry]
+			if (*retry_action == RETRY_ACTION_RETRY_NOW &&
+				retry_control->retry_coordinator != NULL &&
+				!admit_retry(retry_control->retry_coordinator, retry_control))
+			{
+				*retry_action = RETRY_ACTION_RETRY_LATER;
+				retry_control->is_held_back = true;
+			}
+			else
+			{
+				retry_control->is_held_back = false;
+			}
+
 			if (*retry_action == RETRY_ACTION_RETRY_NOW)
 			{
 				// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_015: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW, `retry_control->retry_count` shall be incremented by 1]
@@ -401,11 +687,15 @@ int retry_control_should_retry(RETRY_CONTROL_HANDLE retry_control_handle, RETRY_
 
 				if (retry_control->policy != IOTHUB_CLIENT_RETRY_IMMEDIATE)
 				{
-					// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_016: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->last_retry_time` shall be set using get_time()]
-					retry_control->last_retry_time = get_time(NULL);
-
-					// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_017: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->current_wait_time_in_secs` shall be set using calculate_next_wait_time()]
-					retry_control->current_wait_time_in_secs = calculate_next_wait_time(retry_control);
+					// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_016: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->last_retry_time` shall be set using tickcounter_get_current_ms()]
+					if (tickcounter_get_current_ms(retry_control->tick_counter, &retry_control->last_retry_time) != 0)
+					{
+						LogError("Failed to save the time of the retry (tickcounter_get_current_ms() failed)");
+						retry_control->last_retry_time = INDEFINITE_TIME_MS;
+					}
+
+					// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_017: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->current_wait_time_in_ms` shall be set using calculate_next_wait_time()]
+					retry_control->current_wait_time_in_ms = calculate_next_wait_time(retry_control);
 				}
 			}
 
@@ -417,6 +707,64 @@ int retry_control_should_retry(RETRY_CONTROL_HANDLE retry_control_handle, RETRY_
 	return result;
 }
 
+int retry_control_get_wait_time(RETRY_CONTROL_HANDLE retry_control_handle, RETRY_ACTION* retry_action, unsigned int* wait_time_in_ms)
+{
+	int result;
+
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_028: [If `retry_control_handle`, `retry_action` or `wait_time_in_ms` are NULL, `retry_control_get_wait_time` shall fail and return non-zero]
+	if ((retry_control_handle == NULL) || (retry_action == NULL) || (wait_time_in_ms == NULL))
+	{
+		LogError("Failed to get the retry wait time (retry_control_handle (%p), retry_action (%p) or wait_time_in_ms (%p) are NULL)", retry_control_handle, retry_action, wait_time_in_ms);
+		result = __FAILURE__;
+	}
+	else
+	{
+		RETRY_CONTROL_INSTANCE* retry_control = (RETRY_CONTROL_INSTANCE*)retry_control_handle;
+		tickcounter_ms_t current_time;
+
+		*wait_time_in_ms = 0;
+
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_029: [`retry_control_get_wait_time` shall set `retry_action` as `retry_control_should_retry` would, without changing the state of `retry_control` nor consulting the retry coordinator]
+		if (retry_control->policy == IOTHUB_CLIENT_RETRY_NONE)
+		{
+			*retry_action = RETRY_ACTION_STOP_RETRYING;
+			result = RESULT_OK;
+		}
+		else if (evaluate_retry_action(retry_control, retry_action) != RESULT_OK)
+		{
+			LogError("Failed to get the retry wait time (evaluate_retry_action() failed)");
+			result = __FAILURE__;
+		}
+		// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_030: [If `retry_action` is RETRY_ACTION_RETRY_LATER, `wait_time_in_ms` shall be set to what is left of `retry_control->current_wait_time_in_ms` since `retry_control->last_retry_time`]
+		else if (*retry_action == RETRY_ACTION_RETRY_LATER)
+		{
+			if (tickcounter_get_current_ms(retry_control->tick_counter, &current_time) != 0)
+			{
+				LogError("Failed to get the retry wait time (tickcounter_get_current_ms() failed)");
+				result = __FAILURE__;
+			}
+			else
+			{
+				tickcounter_ms_t elapsed = current_time - retry_control->last_retry_time;
+				*wait_time_in_ms = (elapsed >= retry_control->current_wait_time_in_ms) ? 0 : (unsigned int)(retry_control->current_wait_time_in_ms - elapsed);
+				result = RESULT_OK;
+			}
+		}
+		else
+		{
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_031: [If `retry_action` is RETRY_ACTION_RETRY_NOW and the retry coordinator held back the last retry, `retry_action` shall be set to RETRY_ACTION_RETRY_LATER and `wait_time_in_ms` to 1000, the coordinator admitting retries by the second]
+			if ((*retry_action == RETRY_ACTION_RETRY_NOW) && (retry_control->retry_coordinator != NULL) && retry_control->is_held_back)
+			{
+				*retry_action = RETRY_ACTION_RETRY_LATER;
+				*wait_time_in_ms = HELD_BACK_WAIT_TIME_IN_MS;
+			}
+			result = RESULT_OK;
+		}
+	}
+
+	return result;
+}
+
 int retry_control_set_option(RETRY_CONTROL_HANDLE retry_control_handle, const char* name, const void* value)
 {
 	int result;
@@ -435,7 +783,27 @@ int retry_control_set_option(RETRY_CONTROL_HANDLE retry_control_handle, const ch
 		{
 			unsigned int cast_value = *((unsigned int*)value);
 
-			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_037: [If `name` is "initial_wait_time_in_secs" and `value` is less than 1, `retry_control_set_option` shall fail and return non-zero]
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_037: [If `name` is "initial_wait_time_in_secs" and `value` is less than 1 or greater than UINT_MAX / 1000, `retry_control_set_option` shall fail and return non-zero]
+			if (cast_value < 1 || cast_value > UINT_MAX / 1000)
+			{
+				LogError("Failed to set option '%s' (value must be in the range 1 to %u)", name, UINT_MAX / 1000);
+				result = __FAILURE__;
+			}
+			else
+			{
+				// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_038: [If `name` is "initial_wait_time_in_secs", `value` shall be saved in milliseconds on `retry_control->initial_wait_time_in_ms`]
+				retry_control->initial_wait_time_in_ms = cast_value * 1000;
+
+				// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_044: [If no errors occur, retry_control_set_option shall return 0]
+				result = RESULT_OK;
+			}
+		}
+		else if (strcmp(RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, name) == 0 ||
+			strcmp(RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS, name) == 0)
+		{
+			unsigned int cast_value = *((unsigned int*)value);
+
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_024: [If `name` is "initial_wait_time_in_ms" or "max_wait_time_in_ms" and `value` is less than 1, `retry_control_set_option` shall fail and return non-zero]
 			if (cast_value < 1)
 			{
 				LogError("Failed to set option '%s' (value must be equal or greater to 1)", name);
@@ -443,8 +811,16 @@ int retry_control_set_option(RETRY_CONTROL_HANDLE retry_control_handle, const ch
 			}
 			else
 			{
-				// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_038: [If `name` is "initial_wait_time_in_secs", `value` shall be saved on `retry_control->initial_wait_time_in_secs`]
-				retry_control->initial_wait_time_in_secs = cast_value;
+				// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_025: [If `name` is "initial_wait_time_in_ms", `value` shall be saved on `retry_control->initial_wait_time_in_ms`]
+				if (strcmp(RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, name) == 0)
+				{
+					retry_control->initial_wait_time_in_ms = cast_value;
+				}
+				// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_026: [If `name` is "max_wait_time_in_ms", `value` shall be saved on `retry_control->max_wait_time_in_ms`]
+				else
+				{
+					retry_control->max_wait_time_in_ms = cast_value;
+				}
 
 				// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_044: [If no errors occur, retry_control_set_option shall return 0]
 				result = RESULT_OK;
@@ -469,6 +845,20 @@ int retry_control_set_option(RETRY_CONTROL_HANDLE retry_control_handle, const ch
 				result = RESULT_OK;
 			}
 		}
+		else if (strcmp(RETRY_CONTROL_OPTION_RETRY_COORDINATOR, name) == 0)
+		{
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_005: [If `name` is "retry_coordinator", `value` shall be saved on `retry_control->retry_coordinator`, releasing the probe of the previous retry coordinator if `retry_control` holds it]
+			if (retry_control->retry_coordinator != NULL)
+			{
+				release_probe(retry_control->retry_coordinator, retry_control);
+			}
+
+			retry_control->retry_coordinator = (RETRY_COORDINATOR_INSTANCE*)value;
+			retry_control->is_failure_counted = false;
+
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_044: [If no errors occur, `retry_control_set_option` shall return 0]
+			result = RESULT_OK;
+		}
 		else if (strcmp(RETRY_CONTROL_OPTION_SAVED_OPTIONS, name) == 0)
 		{
 			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_041: [If `name` is "retry_control_options", value shall be fed to `retry_control` using OptionHandler_FeedOptions]
@@ -520,11 +910,18 @@ OPTIONHANDLER_HANDLE retry_control_retrieve_options(RETRY_CONTROL_HANDLE retry_c
 		{
 			RETRY_CONTROL_INSTANCE* retry_control = (RETRY_CONTROL_INSTANCE*)retry_control_handle;
 
-			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_050: [`retry_control->initial_wait_time_in_secs` shall be added to `options` using OptionHandler_Add]
-			if (OptionHandler_AddOption(options, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, (void*)&retry_control->initial_wait_time_in_secs) != OPTIONHANDLER_OK)
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_050: [`retry_control->initial_wait_time_in_ms` shall be added to `options` using OptionHandler_Add]
+			if (OptionHandler_AddOption(options, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, (void*)&retry_control->initial_wait_time_in_ms) != OPTIONHANDLER_OK)
 			{
 				// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_052: [If any call to OptionHandler_Add fails, `retry_control_retrieve_options` shall fail and return NULL]
-				LogError("Failed to retrieve options (OptionHandler_Create failed for option '%s')", RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS);
+				LogError("Failed to retrieve options (OptionHandler_Create failed for option '%s')", RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS);
+				result = NULL;
+			}
+			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_027: [`retry_control->max_wait_time_in_ms` shall be added to `options` using OptionHandler_Add]
+			else if (OptionHandler_AddOption(options, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS, (void*)&retry_control->max_wait_time_in_ms) != OPTIONHANDLER_OK)
+			{
+				// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_052: [If any call to OptionHandler_Add fails, `retry_control_retrieve_options` shall fail and return NULL]
+				LogError("Failed to retrieve options (OptionHandler_Create failed for option '%s')", RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS);
 				result = NULL;
 			}
 			// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_051: [`retry_control->max_jitter_percent` shall be added to `options` using OptionHandler_Add]
@@ -0,0 +1,111 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /*pthread_setaffinity_np and pthread_setname_np*/
+#endif
+
+#include <stddef.h>
+#include <stdio.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_thread_attributes.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+/*pthread_setname_np takes at most 16 bytes, the terminating 0 included*/
+#define THREAD_NAME_SIZE 16
+
+int IoTHubClient_ThreadAttributes_ApplyToCurrentThread(const IOTHUB_CLIENT_THREAD_ATTRIBUTES* attributes, const char* name_suffix)
+{
+    int result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_001: [ If attributes is NULL, IoTHubClient_ThreadAttributes_ApplyToCurrentThread shall fail and return a non-zero value. ]*/
+    if (attributes == NULL)
+    {
+        LogError("invalid arg (NULL)");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+#if defined(_WIN32)
+        (void)name_suffix; /*SetThreadDescription is not there before Windows 10*/
+
+        /*Codes_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_002: [ If affinity_mask is not 0, the calling thread shall be allowed to run on the CPUs of the mask only. ]*/
+        if ((attributes->affinity_mask != 0) && (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)attributes->affinity_mask) == 0))
+        {
+            LogError("SetThreadAffinityMask failed (%lu)", (unsigned long)GetLastError());
+            result = __FAILURE__;
+        }
+
+        /*Codes_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_003: [ If set_priority is true, the priority of the calling thread shall be set to priority, the nice value on Linux. ]*/
+        if (attributes->set_priority && !SetThreadPriority(GetCurrentThread(), attributes->priority))
+        {
+            LogError("SetThreadPriority failed (%lu)", (unsigned long)GetLastError());
+            result = __FAILURE__;
+        }
+#elif defined(__linux__)
+        /*Codes_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_002: [ If affinity_mask is not 0, the calling thread shall be allowed to run on the CPUs of the mask only. ]*/
+        if (attributes->affinity_mask != 0)
+        {
+            cpu_set_t cpus;
+            int cpu;
+            CPU_ZERO(&cpus);
+            for (cpu = 0; (cpu < 64) && (cpu < CPU_SETSIZE); cpu++)
+            {
+                if ((attributes->affinity_mask >> cpu) & 1)
+                {
+                    CPU_SET(cpu, &cpus);
+                }
+            }
+
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+            {
+                LogError("pthread_setaffinity_np failed");
+                result = __FAILURE__;
+            }
+        }
+
+        /*Codes_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_003: [ If set_priority is true, the priority of the calling thread shall be set to priority, the nice value on Linux. ]*/
+        /*the nice value of a Linux thread is the one of its task id*/
+        if (attributes->set_priority && (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), attributes->priority) != 0))
+        {
+            LogError("setpriority failed");
+            result = __FAILURE__;
+        }
+
+        /*Codes_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_004: [ If name is not NULL and the platform names threads, the calling thread shall be named name followed by name_suffix, cut to what the platform allows. ]*/
+        if (attributes->name != NULL)
+        {
+            char thread_name[THREAD_NAME_SIZE];
+            (void)snprintf(thread_name, sizeof(thread_name), "%s%s", attributes->name, (name_suffix == NULL) ? "" : name_suffix);
+            if (pthread_setname_np(pthread_self(), thread_name) != 0)
+            {
+                LogError("pthread_setname_np failed");
+                result = __FAILURE__;
+            }
+        }
+#else
+        (void)name_suffix;
+
+        /*Codes_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_005: [ On a platform without these controls, asking for the affinity or the priority shall fail, the name shall be ignored. ]*/
+        if ((attributes->affinity_mask != 0) || attributes->set_priority)
+        {
+            LogError("thread affinity and priority are not supported on this platform");
+            result = __FAILURE__;
+        }
+#endif
+    }
+
+    return result;
+}
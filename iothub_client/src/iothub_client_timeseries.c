@@ -0,0 +1,302 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "iothub_client_timeseries.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+/*version (8 bits) and sample count (32 bits), then the first timestamp and value (64 bits each)*/
+#define HEADER_BITS 40
+#define FIRST_SAMPLE_BITS 128
+/*'1111' and 64 bits of timestamp, '11', 5 bits of leading zeros, 6 bits of length and 64 bits of value*/
+#define MAX_SAMPLE_BITS 145
+#define INITIAL_CAPACITY 64
+#define MAX_LEADING_ZEROS 31
+
+typedef struct TIMESERIES_BUILDER_TAG
+{
+    unsigned char* buffer; /*the bytes after bitCount are 0*/
+    size_t capacity;
+    size_t bitCount; /*the header included, 0 without samples*/
+    uint32_t sampleCount;
+    uint64_t previousTimestamp; /*the arithmetic on the timestamps is modulo 2^64, so any int64_t round trips*/
+    uint64_t previousDelta;
+    uint64_t previousValue; /*IEEE 754 bits of the previous value*/
+    unsigned int previousLeading; /*zeros around the meaningful bits of the last XOR block written*/
+    unsigned int previousTrailing;
+    bool hasBlock;
+} TIMESERIES_BUILDER;
+
+static int ensure_capacity(TIMESERIES_BUILDER* builder, size_t bits)
+{
+    int result;
+    size_t needed = (builder->bitCount + bits + 7) / 8;
+    if (needed <= builder->capacity)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t newCapacity = (builder->capacity == 0) ? INITIAL_CAPACITY : builder->capacity * 2;
+        unsigned char* newBuffer;
+        if (newCapacity < needed)
+        {
+            newCapacity = needed;
+        }
+
+        if ((newBuffer = (unsigned char*)realloc(builder->buffer, newCapacity)) == NULL)
+        {
+            LogError("unable to realloc %lu bytes", (unsigned long)newCapacity);
+            result = __FAILURE__;
+        }
+        else
+        {
+            (void)memset(newBuffer + builder->capacity, 0, newCapacity - builder->capacity);
+            builder->buffer = newBuffer;
+            builder->capacity = newCapacity;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*writes the count low bits of value, most significant first, a byte at a time*/
+static void write_bits(TIMESERIES_BUILDER* builder, uint64_t value, unsigned int count)
+{
+    while (count > 0)
+    {
+        unsigned int free = 8 - (unsigned int)(builder->bitCount % 8);
+        unsigned int n = (count < free) ? count : free;
+        unsigned int bits = (unsigned int)(value >> (count - n)) & ((1u << n) - 1);
+        builder->buffer[builder->bitCount / 8] |= (unsigned char)(bits << (free - n));
+        builder->bitCount += n;
+        count -= n;
+    }
+}
+
+static int64_t to_signed(uint64_t value)
+{
+    return (value <= (uint64_t)INT64_MAX) ? (int64_t)value : -(int64_t)(~value) - 1;
+}
+
+static void write_timestamp(TIMESERIES_BUILDER* builder, uint64_t timestamp)
+{
+    uint64_t delta = timestamp - builder->previousTimestamp;
+    int64_t deltaOfDelta = to_signed(delta - builder->previousDelta);
+
+    /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_007: [ The delta of delta D of the timestamps shall be written as '0' if it is 0, '10' and 7 bits if it is between -64 and 63, '110' and 9 bits between -256 and 255, '1110' and 12 bits between -2048 and 2047, '1111' and 64 bits otherwise, in two's complement. ]*/
+    if (deltaOfDelta == 0)
+    {
+        write_bits(builder, 0, 1);
+    }
+    else if ((deltaOfDelta >= -64) && (deltaOfDelta <= 63))
+    {
+        write_bits(builder, 0x2, 2);
+        write_bits(builder, (uint64_t)deltaOfDelta, 7);
+    }
+    else if ((deltaOfDelta >= -256) && (deltaOfDelta <= 255))
+    {
+        write_bits(builder, 0x6, 3);
+        write_bits(builder, (uint64_t)deltaOfDelta, 9);
+    }
+    else if ((deltaOfDelta >= -2048) && (deltaOfDelta <= 2047))
+    {
+        write_bits(builder, 0xE, 4);
+        write_bits(builder, (uint64_t)deltaOfDelta, 12);
+    }
+    else
+    {
+        write_bits(builder, 0xF, 4);
+        write_bits(builder, (uint64_t)deltaOfDelta, 64);
+    }
+    builder->previousTimestamp = timestamp;
+    builder->previousDelta = delta;
+}
+
+static void write_value(TIMESERIES_BUILDER* builder, uint64_t value)
+{
+    uint64_t xor = value ^ builder->previousValue;
+    /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_008: [ The XOR X of the bits of the value with the previous one shall be written as '0' if it is 0, as '10' and the bits of X between the leading and trailing zeros of the last block written if X has at least as many, or else as '11', 5 bits of leading zeros (at most 31), 6 bits of the number of meaningful bits (0 for 64) and the meaningful bits, which start a new block. ]*/
+    if (xor == 0)
+    {
+        write_bits(builder, 0, 1);
+    }
+    else
+    {
+        unsigned int leading = 0;
+        unsigned int trailing = 0;
+        while ((leading < MAX_LEADING_ZEROS) && ((xor & ((uint64_t)1 << (63 - leading))) == 0))
+        {
+            leading++;
+        }
+        while ((xor & ((uint64_t)1 << trailing)) == 0)
+        {
+            trailing++;
+        }
+
+        if (builder->hasBlock && (leading >= builder->previousLeading) && (trailing >= builder->previousTrailing))
+        {
+            write_bits(builder, 0x2, 2);
+            write_bits(builder, xor >> builder->previousTrailing, 64 - builder->previousLeading - builder->previousTrailing);
+        }
+        else
+        {
+            unsigned int meaningful = 64 - leading - trailing;
+            write_bits(builder, 0x3, 2);
+            write_bits(builder, leading, 5);
+            write_bits(builder, meaningful & 0x3F, 6);
+            write_bits(builder, xor >> trailing, meaningful);
+            builder->previousLeading = leading;
+            builder->previousTrailing = trailing;
+            builder->hasBlock = true;
+        }
+    }
+    builder->previousValue = value;
+}
+
+static void start_series(TIMESERIES_BUILDER* builder)
+{
+    builder->bitCount = 0;
+    builder->sampleCount = 0;
+    builder->previousTimestamp = 0;
+    builder->previousDelta = 0;
+    builder->previousValue = 0;
+    builder->previousLeading = 0;
+    builder->previousTrailing = 0;
+    builder->hasBlock = false;
+}
+
+TIMESERIES_BUILDER_HANDLE timeseries_builder_create(void)
+{
+    TIMESERIES_BUILDER* result;
+    /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_001: [ timeseries_builder_create shall allocate a builder without samples, its buffer being allocated by the first sample, and return a non-NULL handle. ]*/
+    if ((result = (TIMESERIES_BUILDER*)malloc(sizeof(TIMESERIES_BUILDER))) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_002: [ If allocating fails, timeseries_builder_create shall fail and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        result->buffer = NULL;
+        result->capacity = 0;
+        start_series(result);
+    }
+    return result;
+}
+
+void timeseries_builder_destroy(TIMESERIES_BUILDER_HANDLE builder)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_003: [ timeseries_builder_destroy shall free the builder and its buffer, doing nothing if builder is NULL. ]*/
+    if (builder != NULL)
+    {
+        free(builder->buffer);
+        free(builder);
+    }
+}
+
+IOTHUB_MESSAGE_RESULT timeseries_builder_append(TIMESERIES_BUILDER_HANDLE builder, int64_t timestamp, double value)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_004: [ If builder is NULL, or it holds UINT32_MAX samples, timeseries_builder_append shall fail and return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+    if ((builder == NULL) || (builder->sampleCount == UINT32_MAX))
+    {
+        LogError("invalid argument builder=%p", builder);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_005: [ If the buffer cannot grow to the largest encoding of the sample, timeseries_builder_append shall fail, leave the series as it was and return IOTHUB_MESSAGE_ERROR. ]*/
+    else if (ensure_capacity(builder, (builder->sampleCount == 0) ? HEADER_BITS + FIRST_SAMPLE_BITS : MAX_SAMPLE_BITS) != 0)
+    {
+        LogError("unable to grow the time series");
+        result = IOTHUB_MESSAGE_ERROR;
+    }
+    else
+    {
+        uint64_t bits;
+        (void)memcpy(&bits, &value, sizeof(bits));
+        if (builder->sampleCount == 0)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_006: [ The first sample shall be written after the header as its 64 bits of timestamp and the 64 bits of the IEEE 754 binary64 value. ]*/
+            builder->bitCount = HEADER_BITS;
+            write_bits(builder, (uint64_t)timestamp, 64);
+            write_bits(builder, bits, 64);
+            builder->previousTimestamp = (uint64_t)timestamp;
+            builder->previousValue = bits;
+        }
+        else
+        {
+            write_timestamp(builder, (uint64_t)timestamp);
+            write_value(builder, bits);
+        }
+        builder->sampleCount++;
+        result = IOTHUB_MESSAGE_OK;
+    }
+    return result;
+}
+
+size_t timeseries_builder_get_sample_count(TIMESERIES_BUILDER_HANDLE builder)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_009: [ timeseries_builder_get_sample_count shall return the number of samples of the series, 0 if builder is NULL. ]*/
+    return (builder == NULL) ? 0 : builder->sampleCount;
+}
+
+size_t timeseries_builder_get_size(TIMESERIES_BUILDER_HANDLE builder)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_010: [ timeseries_builder_get_size shall return the size in bytes of the payload of the series, 0 if builder is NULL or without samples. ]*/
+    return (builder == NULL) ? 0 : (builder->bitCount + 7) / 8;
+}
+
+IOTHUB_MESSAGE_HANDLE timeseries_builder_to_message(TIMESERIES_BUILDER_HANDLE builder)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_011: [ If builder is NULL or without samples, timeseries_builder_to_message shall fail and return NULL. ]*/
+    if ((builder == NULL) || (builder->sampleCount == 0))
+    {
+        LogError("invalid argument builder=%p, or no samples", builder);
+        result = NULL;
+    }
+    else
+    {
+        size_t size = (builder->bitCount + 7) / 8;
+        /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_012: [ timeseries_builder_to_message shall write the header, TIMESERIES_FORMAT_VERSION in 8 bits and the sample count in 32 bits, and return a message created by IoTHubMessage_CreateFromByteArray with the series, with the application property content-type set to application/x-gorilla-timeseries. ]*/
+        builder->buffer[0] = TIMESERIES_FORMAT_VERSION;
+        builder->buffer[1] = (unsigned char)(builder->sampleCount >> 24);
+        builder->buffer[2] = (unsigned char)(builder->sampleCount >> 16);
+        builder->buffer[3] = (unsigned char)(builder->sampleCount >> 8);
+        builder->buffer[4] = (unsigned char)builder->sampleCount;
+
+        if ((result = IoTHubMessage_CreateFromByteArray(builder->buffer, size)) == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_014: [ If any error occurs, timeseries_builder_to_message shall fail, keep the series and return NULL. ]*/
+            LogError("IoTHubMessage_CreateFromByteArray failed");
+        }
+        else
+        {
+            MAP_HANDLE properties = IoTHubMessage_Properties(result);
+            if ((properties == NULL) ||
+                (Map_AddOrUpdate(properties, TIMESERIES_CONTENT_TYPE_PROPERTY, TIMESERIES_CONTENT_TYPE_GORILLA) != MAP_OK))
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_014: [ If any error occurs, timeseries_builder_to_message shall fail, keep the series and return NULL. ]*/
+                LogError("unable to set the content type of the message");
+                IoTHubMessage_Destroy(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_TIMESERIES_41_013: [ timeseries_builder_to_message shall then start a new series, keeping the buffer. ]*/
+                (void)memset(builder->buffer, 0, size);
+                start_series(builder);
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,161 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_client_trace.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(USE_ETW_TRACE)
+#include <TraceLoggingProvider.h>
+#elif defined(USE_LTTNG_TRACE)
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+#include "iothub_client_trace_lttng.h"
+#endif
+
+DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_TRACE_EVENT, IOTHUB_CLIENT_TRACE_EVENT_VALUES);
+
+#define TRACE_ENABLED_CALLBACK  0x01
+#define TRACE_ENABLED_PLATFORM  0x02
+
+#if defined(USE_ETW_TRACE)
+/*{252d30b5-4d78-44e1-b1f6-1679b0d76038}*/
+TRACELOGGING_DEFINE_PROVIDER(iothub_client_trace_provider, "Microsoft.Azure.IoT.SDK.C",
+    (0x252d30b5, 0x4d78, 0x44e1, 0xb1, 0xf6, 0x16, 0x79, 0xb0, 0xd7, 0x60, 0x38));
+#endif
+
+volatile int iothub_client_trace_enabled = 0;
+
+static IOTHUB_CLIENT_TRACE_CALLBACK trace_callback_function = NULL;
+static void* trace_callback_context = NULL;
+
+/*monotonic, 0 where the platform has no such clock*/
+static uint64_t get_timestamp_ns(void)
+{
+    uint64_t result;
+#if defined(_WIN32)
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    if (!QueryPerformanceCounter(&counter) || !QueryPerformanceFrequency(&frequency) || frequency.QuadPart == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        /*split, so the multiplication does not overflow after a few days of uptime*/
+        result = (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+            (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / (uint64_t)frequency.QuadPart;
+    }
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        result = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    }
+#else
+    result = 0;
+#endif
+    return result;
+}
+
+int IoTHubClient_Trace_SetCallback(IOTHUB_CLIENT_TRACE_CALLBACK trace_callback, void* context)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_41_001: [ IoTHubClient_Trace_SetCallback shall store trace_callback and context, and return 0. ]*/
+    trace_callback_function = trace_callback;
+    trace_callback_context = context;
+
+    if (trace_callback == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRACE_41_002: [ If trace_callback is NULL, the trace points shall stop calling the callback. ]*/
+        iothub_client_trace_enabled &= ~TRACE_ENABLED_CALLBACK;
+    }
+    else
+    {
+        iothub_client_trace_enabled |= TRACE_ENABLED_CALLBACK;
+    }
+
+    return 0;
+}
+
+int IoTHubClient_Trace_EnablePlatformBackend(void)
+{
+    int result;
+
+#if defined(USE_ETW_TRACE)
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_41_003: [ With use_etw_trace, IoTHubClient_Trace_EnablePlatformBackend shall register the TraceLogging provider of the client, once. ]*/
+    if ((iothub_client_trace_enabled & TRACE_ENABLED_PLATFORM) != 0)
+    {
+        result = 0;
+    }
+    else if (FAILED(TraceLoggingRegister(iothub_client_trace_provider)))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRACE_41_004: [ If registering the provider fails, IoTHubClient_Trace_EnablePlatformBackend shall fail and return a non-zero value. ]*/
+        LogError("TraceLoggingRegister failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        iothub_client_trace_enabled |= TRACE_ENABLED_PLATFORM;
+        result = 0;
+    }
+#elif defined(USE_LTTNG_TRACE)
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_41_005: [ With use_lttng_trace, IoTHubClient_Trace_EnablePlatformBackend shall turn the LTTng tracepoints on and return 0; LTTng registers its probes when the library loads. ]*/
+    iothub_client_trace_enabled |= TRACE_ENABLED_PLATFORM;
+    result = 0;
+#else
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_41_006: [ If no platform backend is built in, IoTHubClient_Trace_EnablePlatformBackend shall fail and return a non-zero value. ]*/
+    LogError("no platform trace backend is built in, build with use_lttng_trace or use_etw_trace");
+    result = __FAILURE__;
+#endif
+
+    return result;
+}
+
+void IoTHubClient_Trace_DisablePlatformBackend(void)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_41_007: [ IoTHubClient_Trace_DisablePlatformBackend shall turn the platform backend off, unregistering the TraceLogging provider with use_etw_trace. ]*/
+    if ((iothub_client_trace_enabled & TRACE_ENABLED_PLATFORM) != 0)
+    {
+        iothub_client_trace_enabled &= ~TRACE_ENABLED_PLATFORM;
+#if defined(USE_ETW_TRACE)
+        TraceLoggingUnregister(iothub_client_trace_provider);
+#endif
+    }
+}
+
+void iothub_client_trace_emit(IOTHUB_CLIENT_TRACE_EVENT trace_event, const void* subject, uint64_t value)
+{
+    /*the callback is read once, so a concurrent IoTHubClient_Trace_SetCallback(NULL, NULL) cannot make it NULL under our feet*/
+    IOTHUB_CLIENT_TRACE_CALLBACK trace_callback = trace_callback_function;
+
+    if (trace_callback != NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRACE_41_008: [ iothub_client_trace_emit shall call the trace callback with its context, trace_event, a monotonic timestamp in nanoseconds, subject and value. ]*/
+        trace_callback(trace_callback_context, trace_event, get_timestamp_ns(), subject, value);
+    }
+
+    if ((iothub_client_trace_enabled & TRACE_ENABLED_PLATFORM) != 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRACE_41_009: [ If the platform backend is on, iothub_client_trace_emit shall write the name of trace_event, subject and value to it. ]*/
+#if defined(USE_ETW_TRACE)
+        TraceLoggingWrite(iothub_client_trace_provider, "ClientEvent",
+            TraceLoggingString(ENUM_TO_STRING(IOTHUB_CLIENT_TRACE_EVENT, trace_event), "Event"),
+            TraceLoggingPointer(subject, "Subject"),
+            TraceLoggingUInt64(value, "Value"));
+#elif defined(USE_LTTNG_TRACE)
+        tracepoint(azure_iot_sdk_c, client_event, ENUM_TO_STRING(IOTHUB_CLIENT_TRACE_EVENT, trace_event), subject, value);
+#endif
+    }
+}
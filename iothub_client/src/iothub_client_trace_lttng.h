@@ -0,0 +1,32 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* LTTng-UST tracepoint provider of the client, only built with use_lttng_trace. The events show in
+   "lttng list --userspace" as azure_iot_sdk_c:client_event once IoTHubClient_Trace_EnablePlatformBackend ran. */
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER azure_iot_sdk_c
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "./iothub_client_trace_lttng.h"
+
+#if !defined(IOTHUB_CLIENT_TRACE_LTTNG_H) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define IOTHUB_CLIENT_TRACE_LTTNG_H
+
+#include <stdint.h>
+#include <lttng/tracepoint.h>
+
+TRACEPOINT_EVENT(
+    azure_iot_sdk_c,
+    client_event,
+    TP_ARGS(const char*, trace_event, const void*, subject, uint64_t, value),
+    TP_FIELDS(
+        ctf_string(trace_event, trace_event)
+        ctf_integer_hex(uintptr_t, subject, (uintptr_t)subject)
+        ctf_integer(uint64_t, value, value)
+    )
+)
+
+#endif /* IOTHUB_CLIENT_TRACE_LTTNG_H */
+
+#include <lttng/tracepoint-event.h>
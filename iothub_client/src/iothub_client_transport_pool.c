@@ -0,0 +1,238 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+
+#include "iothub_client_transport_pool.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+typedef struct POOLED_TRANSPORT_TAG
+{
+    TRANSPORT_HANDLE transport;
+    size_t device_count;
+} POOLED_TRANSPORT;
+
+typedef struct TRANSPORT_POOL_TAG
+{
+    LOCK_HANDLE lock;
+    POOLED_TRANSPORT* transports;
+    size_t transport_count;
+    size_t max_devices_per_transport;
+} TRANSPORT_POOL;
+
+/*FNV-1a*/
+static uint32_t get_device_id_hash(const char* device_id)
+{
+    uint32_t hash = 2166136261u;
+    while (*device_id != '\0')
+    {
+        hash = (hash ^ (unsigned char)*device_id) * 16777619u;
+        device_id++;
+    }
+    return hash;
+}
+
+/*weight of a transport for a device in the rendezvous hashing, the device goes to the transport with the highest weight.
+Adding or removing a transport only moves the devices whose highest weight was on it*/
+static uint32_t get_transport_weight(uint32_t device_id_hash, size_t index)
+{
+    uint32_t weight = device_id_hash ^ ((uint32_t)(index + 1) * 0x9E3779B9u);
+    weight ^= weight >> 16;
+    weight *= 0x85EBCA6Bu;
+    weight ^= weight >> 13;
+    weight *= 0xC2B2AE35u;
+    weight ^= weight >> 16;
+    return weight;
+}
+
+static void destroy_transports(TRANSPORT_POOL* transport_pool, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        IoTHubTransport_Destroy(transport_pool->transports[i].transport);
+    }
+}
+
+TRANSPORT_POOL_HANDLE transport_pool_create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix, size_t transport_count, size_t max_devices_per_transport)
+{
+    TRANSPORT_POOL* result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL or transport_count is 0, transport_pool_create shall fail and return NULL. ]*/
+    if ((protocol == NULL) || (iotHubName == NULL) || (iotHubSuffix == NULL) || (transport_count == 0))
+    {
+        LogError("invalid argument protocol(%p), iotHubName(%p), iotHubSuffix(%p), transport_count(%lu)", protocol, iotHubName, iotHubSuffix, (unsigned long)transport_count);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_002: [ transport_pool_create shall allocate memory for the pool and its transports and create a lock. ]*/
+    else if ((result = (TRANSPORT_POOL*)malloc(sizeof(TRANSPORT_POOL))) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_003: [ If any of the resources cannot be created, transport_pool_create shall free everything it allocated and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else if ((transport_count > SIZE_MAX / sizeof(POOLED_TRANSPORT)) ||
+        ((result->transports = (POOLED_TRANSPORT*)malloc(transport_count * sizeof(POOLED_TRANSPORT))) == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_003: [ If any of the resources cannot be created, transport_pool_create shall free everything it allocated and return NULL. ]*/
+        LogError("unable to malloc %lu transports", (unsigned long)transport_count);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->lock = Lock_Init()) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_003: [ If any of the resources cannot be created, transport_pool_create shall free everything it allocated and return NULL. ]*/
+        LogError("unable to Lock_Init");
+        free(result->transports);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        size_t i;
+        result->transport_count = transport_count;
+        result->max_devices_per_transport = max_devices_per_transport;
+
+        /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_004: [ transport_pool_create shall create transport_count transports by calling IoTHubTransport_Create with protocol, iotHubName and iotHubSuffix. ]*/
+        for (i = 0; i < transport_count; i++)
+        {
+            if ((result->transports[i].transport = IoTHubTransport_Create(protocol, iotHubName, iotHubSuffix)) == NULL)
+            {
+                LogError("unable to create transport %lu of the pool", (unsigned long)i);
+                break;
+            }
+            result->transports[i].device_count = 0;
+        }
+
+        if (i < transport_count)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_005: [ If creating any of the transports fails, transport_pool_create shall destroy the transports already created, free all resources and return NULL. ]*/
+            destroy_transports(result, i);
+            (void)Lock_Deinit(result->lock);
+            free(result->transports);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void transport_pool_destroy(TRANSPORT_POOL_HANDLE transport_pool)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_006: [ If transport_pool is NULL, transport_pool_destroy shall return. ]*/
+    if (transport_pool == NULL)
+    {
+        LogError("invalid argument transport_pool(NULL)");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_007: [ transport_pool_destroy shall destroy all the transports of the pool, its lock and free its memory. ]*/
+        destroy_transports(transport_pool, transport_pool->transport_count);
+        (void)Lock_Deinit(transport_pool->lock);
+        free(transport_pool->transports);
+        free(transport_pool);
+    }
+}
+
+TRANSPORT_HANDLE transport_pool_acquire(TRANSPORT_POOL_HANDLE transport_pool, const char* device_id)
+{
+    TRANSPORT_HANDLE result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_008: [ If transport_pool or device_id is NULL, transport_pool_acquire shall fail and return NULL. ]*/
+    if ((transport_pool == NULL) || (device_id == NULL))
+    {
+        LogError("invalid argument transport_pool(%p), device_id(%p)", transport_pool, device_id);
+        result = NULL;
+    }
+    else if (Lock(transport_pool->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_009: [ If taking the lock fails, transport_pool_acquire shall fail and return NULL. ]*/
+        LogError("unable to Lock");
+        result = NULL;
+    }
+    else
+    {
+        uint32_t device_id_hash = get_device_id_hash(device_id);
+        POOLED_TRANSPORT* selected = NULL;
+        uint32_t selected_weight = 0;
+        size_t i;
+
+        /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_010: [ transport_pool_acquire shall return the transport with the highest rendezvous hashing weight for device_id among the transports serving less than max_devices_per_transport devices (any transport when max_devices_per_transport is 0). ]*/
+        for (i = 0; i < transport_pool->transport_count; i++)
+        {
+            POOLED_TRANSPORT* candidate = &transport_pool->transports[i];
+            if ((transport_pool->max_devices_per_transport == 0) || (candidate->device_count < transport_pool->max_devices_per_transport))
+            {
+                uint32_t weight = get_transport_weight(device_id_hash, i);
+                if ((selected == NULL) || (weight > selected_weight))
+                {
+                    selected = candidate;
+                    selected_weight = weight;
+                }
+            }
+        }
+
+        if (selected == NULL)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_011: [ If all the transports serve max_devices_per_transport devices, transport_pool_acquire shall fail and return NULL. ]*/
+            LogError("unable to acquire a transport for device '%s', all %lu transports serve %lu devices", device_id, (unsigned long)transport_pool->transport_count, (unsigned long)transport_pool->max_devices_per_transport);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_012: [ transport_pool_acquire shall count the device on the returned transport. ]*/
+            selected->device_count++;
+            result = selected->transport;
+        }
+
+        (void)Unlock(transport_pool->lock);
+    }
+
+    return result;
+}
+
+void transport_pool_release(TRANSPORT_POOL_HANDLE transport_pool, TRANSPORT_HANDLE transport)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_013: [ If transport_pool or transport is NULL, transport_pool_release shall return. ]*/
+    if ((transport_pool == NULL) || (transport == NULL))
+    {
+        LogError("invalid argument transport_pool(%p), transport(%p)", transport_pool, transport);
+    }
+    else if (Lock(transport_pool->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < transport_pool->transport_count; i++)
+        {
+            if (transport_pool->transports[i].transport == transport)
+            {
+                break;
+            }
+        }
+
+        /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_014: [ If transport is not a transport of the pool with devices acquired on it, transport_pool_release shall return. ]*/
+        if ((i == transport_pool->transport_count) || (transport_pool->transports[i].device_count == 0))
+        {
+            LogError("transport %p has no device acquired from this pool", transport);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_015: [ transport_pool_release shall stop counting one device on transport. ]*/
+            transport_pool->transports[i].device_count--;
+        }
+
+        (void)Unlock(transport_pool->lock);
+    }
+}
@@ -0,0 +1,425 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+
+#include "iothub_client_twin_cache.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+static const char DESIRED_NAME[] = "desired";
+static const char VERSION_NAME[] = "$version";
+
+typedef struct TWIN_CACHE_TAG
+{
+    char* file_name; /*NULL when the cache is in memory only*/
+    JSON_Value* desired; /*desired properties with their $version, NULL until a complete document is received*/
+    double version;
+} TWIN_CACHE;
+
+static JSON_Value* parse_json(const unsigned char* buffer, size_t size)
+{
+    JSON_Value* result;
+    /*the twin documents are not null terminated*/
+    char* json_string = (char*)malloc(size + 1);
+    if (json_string == NULL)
+    {
+        LogError("unable to malloc");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(json_string, buffer, size);
+        json_string[size] = '\0';
+        result = json_parse_string(json_string);
+        free(json_string);
+    }
+    return result;
+}
+
+static int get_version(const JSON_Object* object, double* version)
+{
+    int result;
+    JSON_Value* value = json_object_get_value(object, VERSION_NAME);
+    if (json_value_get_type(value) != JSONNumber)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *version = json_object_get_number(object, VERSION_NAME);
+        result = 0;
+    }
+    return result;
+}
+
+static void save_desired(TWIN_CACHE* twin_cache)
+{
+    if ((twin_cache->file_name != NULL) && (json_serialize_to_file(twin_cache->desired, twin_cache->file_name) != JSONSuccess))
+    {
+        /*not an error for the application, the cache in memory is still good and a file that cannot be parsed is ignored*/
+        LogError("unable to write the twin cache to %s", twin_cache->file_name);
+    }
+}
+
+static void forget_desired(TWIN_CACHE* twin_cache)
+{
+    if (twin_cache->desired != NULL)
+    {
+        json_value_free(twin_cache->desired);
+        twin_cache->desired = NULL;
+        if (twin_cache->file_name != NULL)
+        {
+            (void)remove(twin_cache->file_name);
+        }
+    }
+}
+
+static int apply_patch(JSON_Object* target, const JSON_Object* patch)
+{
+    int result = 0;
+    size_t count = json_object_get_count(patch);
+    size_t index;
+    for (index = 0; (result == 0) && (index < count); index++)
+    {
+        const char* name = json_object_get_name(patch, index);
+        JSON_Value* patch_value = json_object_get_value(patch, name);
+        JSON_Value* target_value = json_object_get_value(target, name);
+        if (json_value_get_type(patch_value) == JSONNull)
+        {
+            (void)json_object_remove(target, name);
+        }
+        else if ((json_value_get_type(patch_value) == JSONObject) && (json_value_get_type(target_value) == JSONObject))
+        {
+            result = apply_patch(json_value_get_object(target_value), json_value_get_object(patch_value));
+        }
+        else
+        {
+            JSON_Value* copy = json_value_deep_copy(patch_value);
+            if (copy == NULL)
+            {
+                LogError("unable to json_value_deep_copy");
+                result = __FAILURE__;
+            }
+            else if ((json_value_get_type(copy) == JSONObject) && (apply_patch(json_value_get_object(copy), json_value_get_object(patch_value)) != 0))
+            {
+                /*the nulls of a new object are not members of the document*/
+                json_value_free(copy);
+                result = __FAILURE__;
+            }
+            else if (json_object_set_value(target, name, copy) != JSONSuccess)
+            {
+                LogError("unable to json_object_set_value");
+                json_value_free(copy);
+                result = __FAILURE__;
+            }
+        }
+    }
+    return result;
+}
+
+static int diff_objects(JSON_Object* patch, const JSON_Object* from, const JSON_Object* to)
+{
+    int result = 0;
+    size_t count = json_object_get_count(to);
+    size_t index;
+    for (index = 0; (result == 0) && (index < count); index++)
+    {
+        const char* name = json_object_get_name(to, index);
+        JSON_Value* to_value = json_object_get_value(to, name);
+        JSON_Value* from_value = json_object_get_value(from, name);
+        if (strcmp(name, VERSION_NAME) == 0)
+        {
+            /*the $version of the patch is the one of the document, set by the caller*/
+        }
+        else if ((json_value_get_type(to_value) == JSONObject) && (json_value_get_type(from_value) == JSONObject))
+        {
+            JSON_Value* member_patch = json_value_init_object();
+            if (member_patch == NULL)
+            {
+                LogError("unable to json_value_init_object");
+                result = __FAILURE__;
+            }
+            else if (diff_objects(json_value_get_object(member_patch), json_value_get_object(from_value), json_value_get_object(to_value)) != 0)
+            {
+                json_value_free(member_patch);
+                result = __FAILURE__;
+            }
+            else if (json_object_get_count(json_value_get_object(member_patch)) == 0)
+            {
+                json_value_free(member_patch);
+            }
+            else if (json_object_set_value(patch, name, member_patch) != JSONSuccess)
+            {
+                LogError("unable to json_object_set_value");
+                json_value_free(member_patch);
+                result = __FAILURE__;
+            }
+        }
+        else if ((from_value == NULL) || !json_value_equals(from_value, to_value))
+        {
+            JSON_Value* copy = json_value_deep_copy(to_value);
+            if (copy == NULL)
+            {
+                LogError("unable to json_value_deep_copy");
+                result = __FAILURE__;
+            }
+            else if (json_object_set_value(patch, name, copy) != JSONSuccess)
+            {
+                LogError("unable to json_object_set_value");
+                json_value_free(copy);
+                result = __FAILURE__;
+            }
+        }
+    }
+
+    count = json_object_get_count(from);
+    for (index = 0; (result == 0) && (index < count); index++)
+    {
+        const char* name = json_object_get_name(from, index);
+        if ((strcmp(name, VERSION_NAME) != 0) &&
+            (json_object_get_value(to, name) == NULL) &&
+            (json_object_set_null(patch, name) != JSONSuccess))
+        {
+            LogError("unable to json_object_set_null");
+            result = __FAILURE__;
+        }
+    }
+    return result;
+}
+
+static TWIN_CACHE_RESULT update_complete(TWIN_CACHE* twin_cache, JSON_Value* document, char** patch)
+{
+    TWIN_CACHE_RESULT result;
+    JSON_Value* desired_value = json_object_get_value(json_value_get_object(document), DESIRED_NAME);
+    JSON_Object* desired = json_value_get_object(desired_value);
+    double version;
+    if ((desired == NULL) || (get_version(desired, &version) != 0))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_006: [ If the document has no desired properties with a $version, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+        LogError("the twin document has no desired $version, it is not cached");
+        forget_desired(twin_cache);
+        result = TWIN_CACHE_DELIVER;
+    }
+    else if (twin_cache->desired == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_007: [ If the cache is empty, twin_cache_update shall store the desired properties of the document and return TWIN_CACHE_DELIVER. ]*/
+        JSON_Value* copy = json_value_deep_copy(desired_value);
+        if (copy == NULL)
+        {
+            LogError("unable to json_value_deep_copy");
+            result = TWIN_CACHE_DELIVER;
+        }
+        else
+        {
+            twin_cache->desired = copy;
+            twin_cache->version = version;
+            save_desired(twin_cache);
+            result = TWIN_CACHE_DELIVER;
+        }
+    }
+    else if (version == twin_cache->version)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_008: [ If the desired $version of the document is the one of the cache, twin_cache_update shall return TWIN_CACHE_SKIP. ]*/
+        result = TWIN_CACHE_SKIP;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_009: [ Otherwise twin_cache_update shall set *patch to a JSON merge patch setting every desired property that differs from the cache, null for the ones that are gone, and $version to the one of the document, replace the cache with the desired properties of the document and return TWIN_CACHE_DELIVER_PATCH. ]*/
+        JSON_Value* patch_value = json_value_init_object();
+        JSON_Value* copy;
+        if (patch_value == NULL)
+        {
+            LogError("unable to json_value_init_object");
+            forget_desired(twin_cache);
+            result = TWIN_CACHE_DELIVER;
+        }
+        else
+        {
+            if ((diff_objects(json_value_get_object(patch_value), json_value_get_object(twin_cache->desired), desired) != 0) ||
+                (json_object_set_number(json_value_get_object(patch_value), VERSION_NAME, version) != JSONSuccess) ||
+                ((copy = json_value_deep_copy(desired_value)) == NULL))
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_012: [ If payLoad is not a JSON object or any error occurs, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+                LogError("unable to compute the changes of the desired properties");
+                forget_desired(twin_cache);
+                result = TWIN_CACHE_DELIVER;
+            }
+            else if ((*patch = json_serialize_to_string(patch_value)) == NULL)
+            {
+                LogError("unable to json_serialize_to_string");
+                json_value_free(copy);
+                forget_desired(twin_cache);
+                result = TWIN_CACHE_DELIVER;
+            }
+            else
+            {
+                json_value_free(twin_cache->desired);
+                twin_cache->desired = copy;
+                twin_cache->version = version;
+                save_desired(twin_cache);
+                result = TWIN_CACHE_DELIVER_PATCH;
+            }
+            json_value_free(patch_value);
+        }
+    }
+    return result;
+}
+
+static TWIN_CACHE_RESULT update_partial(TWIN_CACHE* twin_cache, JSON_Value* document)
+{
+    TWIN_CACHE_RESULT result;
+    double version;
+    if (twin_cache->desired == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_010: [ If update_state is DEVICE_TWIN_UPDATE_PARTIAL and the cache is empty, the patch has no $version or its $version is more than one after the one of the cache, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+        result = TWIN_CACHE_DELIVER;
+    }
+    else if (get_version(json_value_get_object(document), &version) != 0)
+    {
+        LogError("the desired properties patch has no $version, the twin cache is emptied");
+        forget_desired(twin_cache);
+        result = TWIN_CACHE_DELIVER;
+    }
+    else if (version <= twin_cache->version)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_011: [ If the $version of the patch is not after the one of the cache, twin_cache_update shall return TWIN_CACHE_SKIP. ]*/
+        result = TWIN_CACHE_SKIP;
+    }
+    else if (version != twin_cache->version + 1)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_010: [ If update_state is DEVICE_TWIN_UPDATE_PARTIAL and the cache is empty, the patch has no $version or its $version is more than one after the one of the cache, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+        /*a patch was missed, the next complete document is given as it is*/
+        LogError("desired properties patch %.0f after %.0f, the twin cache is emptied", version, twin_cache->version);
+        forget_desired(twin_cache);
+        result = TWIN_CACHE_DELIVER;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_013: [ Otherwise twin_cache_update shall apply the patch to the cache and return TWIN_CACHE_DELIVER. ]*/
+    else if (apply_patch(json_value_get_object(twin_cache->desired), json_value_get_object(document)) != 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_012: [ If payLoad is not a JSON object or any error occurs, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+        forget_desired(twin_cache);
+        result = TWIN_CACHE_DELIVER;
+    }
+    else
+    {
+        twin_cache->version = version;
+        save_desired(twin_cache);
+        result = TWIN_CACHE_DELIVER;
+    }
+    return result;
+}
+
+TWIN_CACHE_HANDLE twin_cache_create(const char* file_name)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_001: [ twin_cache_create shall allocate an empty cache and return it, NULL if any error occurs. ]*/
+    TWIN_CACHE* result = (TWIN_CACHE*)malloc(sizeof(TWIN_CACHE));
+    if (result == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else
+    {
+        result->desired = NULL;
+        result->version = 0;
+        if (file_name == NULL)
+        {
+            result->file_name = NULL;
+        }
+        else if ((result->file_name = (char*)malloc(strlen(file_name) + 1)) == NULL)
+        {
+            LogError("unable to malloc");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            JSON_Value* saved;
+            (void)strcpy(result->file_name, file_name);
+            /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_002: [ If file_name is not NULL, twin_cache_create shall load the cache from the file, a file that does not exist or does not hold desired properties with a $version leaving the cache empty. ]*/
+            if ((saved = json_parse_file(file_name)) != NULL)
+            {
+                if ((json_value_get_type(saved) == JSONObject) && (get_version(json_value_get_object(saved), &result->version) == 0))
+                {
+                    result->desired = saved;
+                }
+                else
+                {
+                    LogError("%s does not hold a twin cache, it is ignored", file_name);
+                    json_value_free(saved);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void twin_cache_destroy(TWIN_CACHE_HANDLE twin_cache)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_003: [ If twin_cache is NULL, twin_cache_destroy shall do nothing. ]*/
+    if (twin_cache != NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_004: [ twin_cache_destroy shall free the cache, leaving its file as it is. ]*/
+        if (twin_cache->desired != NULL)
+        {
+            json_value_free(twin_cache->desired);
+        }
+        free(twin_cache->file_name);
+        free(twin_cache);
+    }
+}
+
+TWIN_CACHE_RESULT twin_cache_update(TWIN_CACHE_HANDLE twin_cache, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, char** patch)
+{
+    TWIN_CACHE_RESULT result;
+    JSON_Value* document;
+    if ((twin_cache == NULL) || (payLoad == NULL) || (size == 0) || (patch == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_005: [ If twin_cache, payLoad or patch is NULL or size is 0, twin_cache_update shall return TWIN_CACHE_DELIVER. ]*/
+        LogError("invalid argument TWIN_CACHE_HANDLE twin_cache=%p, const unsigned char* payLoad=%p, size_t size=%lu, char** patch=%p", twin_cache, payLoad, (unsigned long)size, patch);
+        result = TWIN_CACHE_DELIVER;
+    }
+    else if ((document = parse_json(payLoad, size)) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_012: [ If payLoad is not a JSON object or any error occurs, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+        LogError("the twin document is not JSON, the twin cache is emptied");
+        forget_desired(twin_cache);
+        result = TWIN_CACHE_DELIVER;
+    }
+    else
+    {
+        if (json_value_get_type(document) != JSONObject)
+        {
+            LogError("the twin document is not a JSON object, the twin cache is emptied");
+            forget_desired(twin_cache);
+            result = TWIN_CACHE_DELIVER;
+        }
+        else if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
+        {
+            result = update_complete(twin_cache, document, patch);
+        }
+        else
+        {
+            result = update_partial(twin_cache, document);
+        }
+        json_value_free(document);
+    }
+    return result;
+}
+
+void twin_cache_free_patch(char* patch)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_014: [ twin_cache_free_patch shall free patch. ]*/
+    if (patch != NULL)
+    {
+        json_free_serialized_string(patch);
+    }
+}
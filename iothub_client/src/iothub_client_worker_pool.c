@@ -0,0 +1,391 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+
+#include "iothub_client_worker_pool.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+/*upper bound of the time an idle worker thread waits before looking at the items again*/
+#define WORKER_POOL_MAX_WAIT_MS 1000
+
+typedef struct WORKER_POOL_ITEM_TAG
+{
+    struct WORKER_POOL_TAG* worker_pool;
+    WORKER_POOL_WORK_FUNCTION work_function;
+    void* work_context;
+    tickcounter_ms_t due_time;
+    int is_running;
+    int is_scheduled;
+    DLIST_ENTRY entry;
+} WORKER_POOL_ITEM;
+
+typedef struct WORKER_POOL_TAG
+{
+    LOCK_HANDLE lock;
+    COND_HANDLE work_available;
+    COND_HANDLE item_done;
+    TICK_COUNTER_HANDLE tick_counter;
+    THREAD_HANDLE* threads;
+    size_t thread_count;
+    int stop;
+    DLIST_ENTRY items;
+} WORKER_POOL;
+
+/*used by unittests only*/
+const size_t WorkerPool_ThreadTerminationOffset = offsetof(WORKER_POOL, stop);
+
+/*this function is called with the lock taken. It returns the first item that is due and not running and computes how long to wait otherwise*/
+static WORKER_POOL_ITEM* get_next_due_item(WORKER_POOL* worker_pool, tickcounter_ms_t now, tickcounter_ms_t* wait_time)
+{
+    WORKER_POOL_ITEM* result = NULL;
+    PDLIST_ENTRY current = worker_pool->items.Flink;
+
+    *wait_time = WORKER_POOL_MAX_WAIT_MS;
+
+    while (current != &worker_pool->items)
+    {
+        WORKER_POOL_ITEM* item = containingRecord(current, WORKER_POOL_ITEM, entry);
+        if (item->is_running == 0)
+        {
+            if (item->due_time <= now)
+            {
+                result = item;
+                break;
+            }
+            else if (item->due_time - now < *wait_time)
+            {
+                *wait_time = item->due_time - now;
+            }
+        }
+        current = current->Flink;
+    }
+
+    return result;
+}
+
+static int worker_pool_thread(void* thread_argument)
+{
+    WORKER_POOL* worker_pool = (WORKER_POOL*)thread_argument;
+
+    if (Lock(worker_pool->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+    }
+    else
+    {
+        bool is_locked = true;
+
+        while (worker_pool->stop == 0)
+        {
+            tickcounter_ms_t now;
+            tickcounter_ms_t wait_time;
+            WORKER_POOL_ITEM* item;
+
+            if (tickcounter_get_current_ms(worker_pool->tick_counter, &now) != 0)
+            {
+                LogError("unable to tickcounter_get_current_ms");
+                (void)Condition_Wait(worker_pool->work_available, worker_pool->lock, 1);
+            }
+            else if ((item = get_next_due_item(worker_pool, now, &wait_time)) == NULL)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_009: [ When no item is due, the worker thread shall wait until the earliest due time or until worker_pool_schedule is called. ]*/
+                (void)Condition_Wait(worker_pool->work_available, worker_pool->lock, (int)wait_time);
+            }
+            else
+            {
+                unsigned int next_run_in_ms;
+
+                /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_010: [ The worker thread shall mark the item as running, so that no other worker thread runs it, and call its work function without holding the pool lock. ]*/
+                item->is_running = 1;
+                item->is_scheduled = 0;
+
+                /*items that just ran go to the back of the list so that busy items do not starve the others*/
+                (void)DList_RemoveEntryList(&item->entry);
+                DList_InsertTailList(&worker_pool->items, &item->entry);
+
+                (void)Unlock(worker_pool->lock);
+                next_run_in_ms = item->work_function(item->work_context);
+                if (Lock(worker_pool->lock) != LOCK_OK)
+                {
+                    LogError("unable to Lock - worker thread exiting");
+                    item->is_running = 0;
+                    is_locked = false;
+                    break;
+                }
+
+                /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_011: [ When the work function returns, the item shall be due again after the number of milliseconds returned, or immediately if worker_pool_schedule was called while it was running. ]*/
+                item->is_running = 0;
+                item->due_time = (item->is_scheduled != 0) ? now : now + next_run_in_ms;
+                (void)Condition_Post(worker_pool->item_done);
+            }
+        }
+
+        if (is_locked)
+        {
+            (void)Unlock(worker_pool->lock);
+        }
+    }
+
+    return 0;
+}
+
+static void stop_worker_threads(WORKER_POOL* worker_pool, size_t started_threads)
+{
+    size_t i;
+
+    if (Lock(worker_pool->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock - will still proceed to try to end the threads without locking");
+    }
+    worker_pool->stop = 1;
+    for (i = 0; i < started_threads; i++)
+    {
+        (void)Condition_Post(worker_pool->work_available);
+    }
+    (void)Unlock(worker_pool->lock);
+
+    for (i = 0; i < started_threads; i++)
+    {
+        int res;
+        if (ThreadAPI_Join(worker_pool->threads[i], &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed");
+        }
+    }
+}
+
+static void destroy_worker_pool_resources(WORKER_POOL* worker_pool)
+{
+    if (worker_pool->threads != NULL)
+    {
+        free(worker_pool->threads);
+    }
+    if (worker_pool->tick_counter != NULL)
+    {
+        tickcounter_destroy(worker_pool->tick_counter);
+    }
+    if (worker_pool->item_done != NULL)
+    {
+        Condition_Deinit(worker_pool->item_done);
+    }
+    if (worker_pool->work_available != NULL)
+    {
+        Condition_Deinit(worker_pool->work_available);
+    }
+    if (worker_pool->lock != NULL)
+    {
+        (void)Lock_Deinit(worker_pool->lock);
+    }
+    free(worker_pool);
+}
+
+WORKER_POOL_HANDLE worker_pool_create(size_t thread_count)
+{
+    WORKER_POOL* result;
+
+    if (thread_count == 0)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_001: [ If thread_count is 0, worker_pool_create shall fail and return NULL. ]*/
+        LogError("invalid argument thread_count (0)");
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_002: [ worker_pool_create shall allocate memory for the worker pool, create a lock, two conditions and a tick counter. ]*/
+    else if ((result = (WORKER_POOL*)malloc(sizeof(WORKER_POOL))) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_003: [ If any of the resources cannot be created, worker_pool_create shall free everything it allocated and return NULL. ]*/
+        LogError("unable to allocate worker pool");
+    }
+    else
+    {
+        result->work_available = NULL;
+        result->item_done = NULL;
+        result->tick_counter = NULL;
+        result->threads = NULL;
+        result->thread_count = thread_count;
+        result->stop = 0;
+        DList_InitializeListHead(&result->items);
+
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("unable to Lock_Init");
+            destroy_worker_pool_resources(result);
+            result = NULL;
+        }
+        else if (((result->work_available = Condition_Init()) == NULL) ||
+            ((result->item_done = Condition_Init()) == NULL))
+        {
+            LogError("unable to Condition_Init");
+            destroy_worker_pool_resources(result);
+            result = NULL;
+        }
+        else if ((result->tick_counter = tickcounter_create()) == NULL)
+        {
+            LogError("unable to tickcounter_create");
+            destroy_worker_pool_resources(result);
+            result = NULL;
+        }
+        else if ((result->threads = (THREAD_HANDLE*)malloc(thread_count * sizeof(THREAD_HANDLE))) == NULL)
+        {
+            LogError("unable to allocate thread handles");
+            destroy_worker_pool_resources(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t i;
+
+            /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_004: [ worker_pool_create shall start thread_count worker threads. ]*/
+            for (i = 0; i < thread_count; i++)
+            {
+                if (ThreadAPI_Create(&result->threads[i], worker_pool_thread, result) != THREADAPI_OK)
+                {
+                    break;
+                }
+            }
+
+            if (i < thread_count)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_005: [ If starting any of the threads fails, worker_pool_create shall stop the threads already started, free all resources and return NULL. ]*/
+                LogError("unable to ThreadAPI_Create");
+                stop_worker_threads(result, i);
+                destroy_worker_pool_resources(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+void worker_pool_destroy(WORKER_POOL_HANDLE worker_pool)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_006: [ If worker_pool is NULL, worker_pool_destroy shall return. ]*/
+    if (worker_pool != NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_007: [ worker_pool_destroy shall signal all worker threads to stop, join them and free all the resources of the pool, including the items that were not removed. ]*/
+        stop_worker_threads(worker_pool, worker_pool->thread_count);
+
+        while (DList_IsListEmpty(&worker_pool->items) == 0)
+        {
+            PDLIST_ENTRY entry = DList_RemoveHeadList(&worker_pool->items);
+            free(containingRecord(entry, WORKER_POOL_ITEM, entry));
+        }
+
+        destroy_worker_pool_resources(worker_pool);
+    }
+}
+
+WORKER_POOL_ITEM_HANDLE worker_pool_add(WORKER_POOL_HANDLE worker_pool, WORKER_POOL_WORK_FUNCTION work_function, void* work_context)
+{
+    WORKER_POOL_ITEM* result;
+
+    if ((worker_pool == NULL) || (work_function == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_012: [ If worker_pool or work_function are NULL, worker_pool_add shall fail and return NULL. ]*/
+        LogError("invalid argument worker_pool=%p, work_function=%p", worker_pool, work_function);
+        result = NULL;
+    }
+    else if ((result = (WORKER_POOL_ITEM*)malloc(sizeof(WORKER_POOL_ITEM))) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_013: [ If allocating the item fails, worker_pool_add shall fail and return NULL. ]*/
+        LogError("unable to allocate worker pool item");
+    }
+    else
+    {
+        result->worker_pool = worker_pool;
+        result->work_function = work_function;
+        result->work_context = work_context;
+        result->due_time = 0;
+        result->is_running = 0;
+        result->is_scheduled = 0;
+
+        if (Lock(worker_pool->lock) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_015: [ If acquiring the pool lock fails, worker_pool_add shall fail and return NULL. ]*/
+            LogError("unable to Lock");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_014: [ worker_pool_add shall add the item to the pool as due immediately and wake up a worker thread. ]*/
+            DList_InsertTailList(&worker_pool->items, &result->entry);
+            (void)Condition_Post(worker_pool->work_available);
+            (void)Unlock(worker_pool->lock);
+        }
+    }
+
+    return result;
+}
+
+int worker_pool_schedule(WORKER_POOL_ITEM_HANDLE item)
+{
+    int result;
+
+    if (item == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_016: [ If item is NULL, worker_pool_schedule shall fail and return a non-zero value. ]*/
+        LogError("invalid argument item (NULL)");
+        result = __FAILURE__;
+    }
+    else if (Lock(item->worker_pool->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_018: [ If acquiring the pool lock fails, worker_pool_schedule shall fail and return a non-zero value. ]*/
+        LogError("unable to Lock");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_017: [ worker_pool_schedule shall make the item due immediately, wake up a worker thread and return 0. ]*/
+        item->due_time = 0;
+        item->is_scheduled = 1;
+        (void)Condition_Post(item->worker_pool->work_available);
+        (void)Unlock(item->worker_pool->lock);
+        result = 0;
+    }
+
+    return result;
+}
+
+void worker_pool_remove(WORKER_POOL_ITEM_HANDLE item)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_019: [ If item is NULL, worker_pool_remove shall return. ]*/
+    if (item != NULL)
+    {
+        WORKER_POOL* worker_pool = item->worker_pool;
+
+        if (Lock(worker_pool->lock) != LOCK_OK)
+        {
+            LogError("unable to Lock, item not removed");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_WORKER_POOL_41_020: [ worker_pool_remove shall wait for the work function of the item to return if it is running, remove the item from the pool and free it. ]*/
+            /*worker_pool_remove shall not be called from the work function of the item being removed*/
+            while (item->is_running != 0)
+            {
+                /*item_done is posted once per completed run; the timeout handles more than one thread removing items at the same time*/
+                (void)Condition_Wait(worker_pool->item_done, worker_pool->lock, 10);
+            }
+
+            (void)DList_RemoveEntryList(&item->entry);
+            (void)Unlock(worker_pool->lock);
+            free(item);
+        }
+    }
+}
@@ -0,0 +1,1292 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/optionhandler.h"
+
+#include "iothub_client_options.h"
+#include "iothub_client_ws_deflate_io.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+#ifdef USE_COMPRESSION
+#include "zlib.h"
+#endif
+
+/*the options of the underlying IO, kept among the options of this IO by ws_deflate_io_retrieveoptions*/
+#define WS_DEFLATE_IO_OPTION_UNDERLYING_OPTIONS "ws_deflate_io_underlying_options"
+
+#define WS_FRAME_FIN 0x80
+#define WS_FRAME_RSV1 0x40
+#define WS_FRAME_OPCODE_MASK 0x0F
+#define WS_FRAME_OPCODE_CONTINUATION 0x00
+#define WS_FRAME_OPCODE_FIRST_CONTROL 0x08
+#define WS_FRAME_MASKED 0x80
+#define WS_FRAME_MAX_HEADER_SIZE 14
+#define WS_DEFLATE_TAIL_SIZE 4
+#define WS_DEFLATE_MIN_WINDOW_BITS 9
+#define WS_DEFLATE_MAX_WINDOW_BITS 15
+#define WS_DEFLATE_MEMORY_LEVEL 8
+#define WS_UPGRADE_RESPONSE_MAX_SIZE 16384
+
+/*a message ends with the empty block a sync flush writes, RFC 7692 takes it out of the frames*/
+static const unsigned char WS_DEFLATE_TAIL[WS_DEFLATE_TAIL_SIZE] = { 0x00, 0x00, 0xFF, 0xFF };
+static const char WS_HEADER_END[] = "\r\n\r\n";
+static const char WS_EXTENSIONS_HEADER[] = "Sec-WebSocket-Extensions:";
+static const char WS_PERMESSAGE_DEFLATE[] = "permessage-deflate";
+
+typedef struct WS_FRAME_TAG
+{
+    unsigned char first_byte; /*FIN, RSV and opcode*/
+    bool is_masked;
+    unsigned char mask[4];
+    size_t header_size;
+    size_t payload_size;
+} WS_FRAME;
+
+typedef struct WS_DEFLATE_IO_INSTANCE_TAG
+{
+    XIO_HANDLE underlying_io;
+    IOTHUB_WEBSOCKET_DEFLATE_OPTIONS options;
+    ON_BYTES_RECEIVED on_bytes_received;
+    void* on_bytes_received_context;
+    ON_IO_ERROR on_io_error;
+    void* on_io_error_context;
+    /*where this connection is in its upgrade: the first bytes sent are the upgrade request, the first bytes received
+      up to an empty line its response*/
+    bool is_upgrade_sent;
+    bool is_upgrade_offered;
+    bool is_upgraded;
+    bool is_negotiated;
+    int client_window_bits;
+    int server_window_bits;
+    bool client_no_context_takeover;
+    unsigned char* upgrade_response;
+    size_t upgrade_response_size;
+    /*the start of a frame not complete yet, in each direction*/
+    unsigned char* partial_sent;
+    size_t partial_sent_size;
+    unsigned char* partial_received;
+    size_t partial_received_size;
+    bool is_sending_compressed_message;
+    bool is_receiving_compressed_message;
+    /*reused for every frame: the unmasked payload, and the frame made of it*/
+    unsigned char* payload;
+    size_t payload_capacity;
+    unsigned char* frame;
+    size_t frame_capacity;
+#ifdef USE_COMPRESSION
+    z_stream deflate_stream;
+    z_stream inflate_stream;
+    bool is_codec_started;
+#endif
+} WS_DEFLATE_IO_INSTANCE;
+
+static int reserve(unsigned char** buffer, size_t* capacity, size_t size)
+{
+    int result;
+    if (size <= *capacity)
+    {
+        result = 0;
+    }
+    else
+    {
+        unsigned char* grown = (unsigned char*)realloc(*buffer, size);
+        if (grown == NULL)
+        {
+            LogError("unable to realloc %lu bytes", (unsigned long)size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            *buffer = grown;
+            *capacity = size;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+#ifdef USE_COMPRESSION
+
+static int start_codec(WS_DEFLATE_IO_INSTANCE* instance)
+{
+    int result;
+    /*zlib does not inflate with less than a 9 bit window, which inflates what an 8 bit window deflated as well*/
+    int inflate_window_bits = (instance->server_window_bits < WS_DEFLATE_MIN_WINDOW_BITS) ? WS_DEFLATE_MIN_WINDOW_BITS : instance->server_window_bits;
+
+    (void)memset(&instance->deflate_stream, 0, sizeof(instance->deflate_stream));
+    (void)memset(&instance->inflate_stream, 0, sizeof(instance->inflate_stream));
+    /*negative window bits make zlib write and read raw deflate, without the zlib header and trailer*/
+    if (deflateInit2(&instance->deflate_stream, instance->options.level, Z_DEFLATED, -instance->client_window_bits, WS_DEFLATE_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        LogError("deflateInit2 failed");
+        result = __FAILURE__;
+    }
+    else if (inflateInit2(&instance->inflate_stream, -inflate_window_bits) != Z_OK)
+    {
+        LogError("inflateInit2 failed");
+        (void)deflateEnd(&instance->deflate_stream);
+        result = __FAILURE__;
+    }
+    else
+    {
+        instance->is_codec_started = true;
+        result = 0;
+    }
+    return result;
+}
+
+static void stop_codec(WS_DEFLATE_IO_INSTANCE* instance)
+{
+    if (instance->is_codec_started)
+    {
+        (void)deflateEnd(&instance->deflate_stream);
+        (void)inflateEnd(&instance->inflate_stream);
+        instance->is_codec_started = false;
+    }
+}
+
+/*deflates payload after the room left for the header in instance->frame, as one frame of a message*/
+static int deflate_payload(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* payload, size_t payload_size, bool is_final, size_t* deflated_size)
+{
+    int result;
+
+    if (payload_size > UINT_MAX)
+    {
+        LogError("frame of %lu bytes too large to deflate", (unsigned long)payload_size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t capacity = WS_FRAME_MAX_HEADER_SIZE + deflateBound(&instance->deflate_stream, (uLong)payload_size) + WS_DEFLATE_TAIL_SIZE + 1;
+        size_t output_size = 0;
+
+        instance->deflate_stream.next_in = (Bytef*)payload;
+        instance->deflate_stream.avail_in = (uInt)payload_size;
+        result = 0;
+        do
+        {
+            size_t available;
+            int deflate_result;
+
+            if (reserve(&instance->frame, &instance->frame_capacity, capacity) != 0)
+            {
+                result = __FAILURE__;
+                break;
+            }
+
+            available = instance->frame_capacity - WS_FRAME_MAX_HEADER_SIZE - output_size;
+            if (available > UINT_MAX)
+            {
+                available = UINT_MAX;
+            }
+            instance->deflate_stream.next_out = instance->frame + WS_FRAME_MAX_HEADER_SIZE + output_size;
+            instance->deflate_stream.avail_out = (uInt)available;
+            deflate_result = deflate(&instance->deflate_stream, Z_SYNC_FLUSH);
+            output_size += available - instance->deflate_stream.avail_out;
+            if ((deflate_result != Z_OK) && (deflate_result != Z_BUF_ERROR))
+            {
+                LogError("deflate failed with %d", deflate_result);
+                result = __FAILURE__;
+                break;
+            }
+            capacity = 2 * instance->frame_capacity;
+        } while (instance->deflate_stream.avail_out == 0);
+
+        if (result == 0)
+        {
+            if (!is_final)
+            {
+                *deflated_size = output_size;
+            }
+            else if ((output_size < WS_DEFLATE_TAIL_SIZE) ||
+                (memcmp(instance->frame + WS_FRAME_MAX_HEADER_SIZE + output_size - WS_DEFLATE_TAIL_SIZE, WS_DEFLATE_TAIL, WS_DEFLATE_TAIL_SIZE) != 0))
+            {
+                LogError("the deflated message does not end with a sync flush");
+                result = __FAILURE__;
+            }
+            else
+            {
+                *deflated_size = output_size - WS_DEFLATE_TAIL_SIZE;
+                if (instance->client_no_context_takeover)
+                {
+                    (void)deflateReset(&instance->deflate_stream);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static int inflate_input(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* input, size_t input_size, size_t* output_size)
+{
+    int result = 0;
+
+    instance->inflate_stream.next_in = (Bytef*)input;
+    instance->inflate_stream.avail_in = (uInt)input_size;
+    do
+    {
+        size_t available = instance->frame_capacity - WS_FRAME_MAX_HEADER_SIZE - *output_size;
+        int inflate_result;
+
+        if ((available == 0) &&
+            (reserve(&instance->frame, &instance->frame_capacity, 2 * instance->frame_capacity) != 0))
+        {
+            result = __FAILURE__;
+            break;
+        }
+
+        available = instance->frame_capacity - WS_FRAME_MAX_HEADER_SIZE - *output_size;
+        if (available > UINT_MAX)
+        {
+            available = UINT_MAX;
+        }
+        instance->inflate_stream.next_out = instance->frame + WS_FRAME_MAX_HEADER_SIZE + *output_size;
+        instance->inflate_stream.avail_out = (uInt)available;
+        inflate_result = inflate(&instance->inflate_stream, Z_SYNC_FLUSH);
+        *output_size += available - instance->inflate_stream.avail_out;
+        if (inflate_result == Z_STREAM_END)
+        {
+            /*the hub ended its deflate stream with this message, the next one starts a new stream*/
+            (void)inflateReset(&instance->inflate_stream);
+            break;
+        }
+        else if (inflate_result == Z_BUF_ERROR)
+        {
+            /*no progress possible: the input is all inflated*/
+            if (instance->inflate_stream.avail_out != 0)
+            {
+                break;
+            }
+        }
+        else if (inflate_result != Z_OK)
+        {
+            LogError("inflate failed with %d", inflate_result);
+            result = __FAILURE__;
+            break;
+        }
+    } while ((instance->inflate_stream.avail_in != 0) || (instance->inflate_stream.avail_out == 0));
+
+    return result;
+}
+
+/*inflates payload after the room left for the header in instance->frame, as one frame of a message*/
+static int inflate_payload(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* payload, size_t payload_size, bool is_final, size_t* inflated_size)
+{
+    int result;
+
+    if (payload_size > UINT_MAX)
+    {
+        LogError("frame of %lu bytes too large to inflate", (unsigned long)payload_size);
+        result = __FAILURE__;
+    }
+    else if (reserve(&instance->frame, &instance->frame_capacity, WS_FRAME_MAX_HEADER_SIZE + 4 * payload_size + 256) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *inflated_size = 0;
+        if (inflate_input(instance, payload, payload_size, inflated_size) != 0)
+        {
+            result = __FAILURE__;
+        }
+        /*what the hub took out of the end of the message is given back to inflate*/
+        else if (is_final && (inflate_input(instance, WS_DEFLATE_TAIL, WS_DEFLATE_TAIL_SIZE, inflated_size) != 0))
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static bool is_level_supported(int level)
+{
+    (void)level;
+    return true;
+}
+
+#else /* USE_COMPRESSION */
+
+static int start_codec(WS_DEFLATE_IO_INSTANCE* instance)
+{
+    (void)instance;
+    LogError("permessage-deflate negotiated, the SDK is built without use_compression");
+    return __FAILURE__;
+}
+
+static void stop_codec(WS_DEFLATE_IO_INSTANCE* instance)
+{
+    (void)instance;
+}
+
+static int deflate_payload(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* payload, size_t payload_size, bool is_final, size_t* deflated_size)
+{
+    (void)instance;
+    (void)payload;
+    (void)payload_size;
+    (void)is_final;
+    (void)deflated_size;
+    return __FAILURE__;
+}
+
+static int inflate_payload(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* payload, size_t payload_size, bool is_final, size_t* inflated_size)
+{
+    (void)instance;
+    (void)payload;
+    (void)payload_size;
+    (void)is_final;
+    (void)inflated_size;
+    return __FAILURE__;
+}
+
+static bool is_level_supported(int level)
+{
+    LogError("permessage-deflate level %d requested, the SDK is built without use_compression", level);
+    return false;
+}
+
+#endif /* USE_COMPRESSION */
+
+/*reads the header of the frame at the start of buffer; *is_complete is false while buffer does not hold all of it*/
+static int decode_frame(const unsigned char* buffer, size_t size, WS_FRAME* frame, bool* is_complete)
+{
+    int result = 0;
+    size_t length_size;
+
+    *is_complete = false;
+    if (size >= 2)
+    {
+        unsigned char length = buffer[1] & 0x7F;
+        length_size = (length == 127) ? 8 : ((length == 126) ? 2 : 0);
+        frame->first_byte = buffer[0];
+        frame->is_masked = ((buffer[1] & WS_FRAME_MASKED) != 0);
+        frame->header_size = 2 + length_size + (frame->is_masked ? 4 : 0);
+        if (size >= frame->header_size)
+        {
+            size_t i;
+            if (length_size == 0)
+            {
+                frame->payload_size = length;
+            }
+            else
+            {
+                unsigned long long payload_size = 0;
+                for (i = 0; i < length_size; i++)
+                {
+                    payload_size = (payload_size << 8) | buffer[2 + i];
+                }
+                if (payload_size > (unsigned long long)(SIZE_MAX - WS_FRAME_MAX_HEADER_SIZE))
+                {
+                    LogError("frame of %llu bytes cannot be held", payload_size);
+                    result = __FAILURE__;
+                }
+                frame->payload_size = (size_t)payload_size;
+            }
+
+            if (result == 0)
+            {
+                if (frame->is_masked)
+                {
+                    (void)memcpy(frame->mask, buffer + 2 + length_size, sizeof(frame->mask));
+                }
+                *is_complete = ((size - frame->header_size) >= frame->payload_size);
+            }
+        }
+    }
+    return result;
+}
+
+/*writes the header of a frame of payload_size bytes right before the payload at WS_FRAME_MAX_HEADER_SIZE in
+  instance->frame, masked with mask if there is one, and returns where the frame starts*/
+static unsigned char* encode_frame_header(WS_DEFLATE_IO_INSTANCE* instance, unsigned char first_byte, const unsigned char* mask, size_t payload_size)
+{
+    unsigned char header[WS_FRAME_MAX_HEADER_SIZE];
+    size_t header_size = 0;
+    unsigned char masked = (mask != NULL) ? WS_FRAME_MASKED : 0;
+
+    header[header_size++] = first_byte;
+    if (payload_size < 126)
+    {
+        header[header_size++] = masked | (unsigned char)payload_size;
+    }
+    else if (payload_size <= 0xFFFF)
+    {
+        header[header_size++] = masked | 126;
+        header[header_size++] = (unsigned char)(payload_size >> 8);
+        header[header_size++] = (unsigned char)payload_size;
+    }
+    else
+    {
+        int shift;
+        header[header_size++] = masked | 127;
+        for (shift = 56; shift >= 0; shift -= 8)
+        {
+            header[header_size++] = (unsigned char)(((unsigned long long)payload_size) >> shift);
+        }
+    }
+
+    if (mask != NULL)
+    {
+        size_t i;
+        unsigned char* payload = instance->frame + WS_FRAME_MAX_HEADER_SIZE;
+        (void)memcpy(header + header_size, mask, 4);
+        header_size += 4;
+        for (i = 0; i < payload_size; i++)
+        {
+            payload[i] ^= mask[i % 4];
+        }
+    }
+
+    (void)memcpy(instance->frame + WS_FRAME_MAX_HEADER_SIZE - header_size, header, header_size);
+    return instance->frame + WS_FRAME_MAX_HEADER_SIZE - header_size;
+}
+
+/*the payload of a frame as it was before masking*/
+static const unsigned char* unmask_payload(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* frame_bytes, const WS_FRAME* frame)
+{
+    const unsigned char* result;
+    const unsigned char* payload = frame_bytes + frame->header_size;
+
+    if (!frame->is_masked)
+    {
+        result = payload;
+    }
+    else if (reserve(&instance->payload, &instance->payload_capacity, frame->payload_size + 1) != 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < frame->payload_size; i++)
+        {
+            instance->payload[i] = payload[i] ^ frame->mask[i % 4];
+        }
+        result = instance->payload;
+    }
+    return result;
+}
+
+static int send_frame(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* frame_bytes, const WS_FRAME* frame, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+    unsigned char opcode = frame->first_byte & WS_FRAME_OPCODE_MASK;
+    bool is_final = ((frame->first_byte & WS_FRAME_FIN) != 0);
+
+    if (opcode < WS_FRAME_OPCODE_FIRST_CONTROL)
+    {
+        if (opcode != WS_FRAME_OPCODE_CONTINUATION)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_006: [ Once permessage-deflate is negotiated, the data frames sent by the WebSocket IO shall be deflated with RSV1 set on the first frame of each message, except for the messages of one frame smaller than minimumSizeInBytes, which shall be sent as they are. ]*/
+            instance->is_sending_compressed_message = (!is_final || (frame->payload_size >= instance->options.minimumSizeInBytes));
+        }
+    }
+
+    if ((opcode >= WS_FRAME_OPCODE_FIRST_CONTROL) || !instance->is_sending_compressed_message)
+    {
+        /*control frames are never compressed*/
+        result = xio_send(instance->underlying_io, frame_bytes, frame->header_size + frame->payload_size, on_send_complete, callback_context);
+    }
+    else
+    {
+        const unsigned char* payload = unmask_payload(instance, frame_bytes, frame);
+        size_t deflated_size;
+
+        if (is_final)
+        {
+            instance->is_sending_compressed_message = false;
+        }
+
+        if ((payload == NULL) || (deflate_payload(instance, payload, frame->payload_size, is_final, &deflated_size) != 0))
+        {
+            LogError("unable to deflate a frame of %lu bytes", (unsigned long)frame->payload_size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_007: [ A deflated frame shall be masked with the mask of the frame it replaces, and the 4 bytes ending the deflate sync flush shall be taken out of the last frame of a message. ]*/
+            unsigned char first_byte = (opcode != WS_FRAME_OPCODE_CONTINUATION) ? (frame->first_byte | WS_FRAME_RSV1) : frame->first_byte;
+            unsigned char* deflated_frame = encode_frame_header(instance, first_byte, frame->is_masked ? frame->mask : NULL, deflated_size);
+            result = xio_send(instance->underlying_io, deflated_frame, (size_t)(instance->frame + WS_FRAME_MAX_HEADER_SIZE + deflated_size - deflated_frame), on_send_complete, callback_context);
+        }
+    }
+    return result;
+}
+
+static int receive_frame(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* frame_bytes, const WS_FRAME* frame)
+{
+    int result;
+    unsigned char opcode = frame->first_byte & WS_FRAME_OPCODE_MASK;
+    bool is_final = ((frame->first_byte & WS_FRAME_FIN) != 0);
+    bool is_compressed = ((frame->first_byte & WS_FRAME_RSV1) != 0);
+
+    if ((opcode >= WS_FRAME_OPCODE_FIRST_CONTROL) && is_compressed)
+    {
+        LogError("compressed control frame received");
+        result = __FAILURE__;
+    }
+    else if ((opcode == WS_FRAME_OPCODE_CONTINUATION) && is_compressed)
+    {
+        LogError("RSV1 set on a continuation frame");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((opcode < WS_FRAME_OPCODE_FIRST_CONTROL) && (opcode != WS_FRAME_OPCODE_CONTINUATION))
+        {
+            instance->is_receiving_compressed_message = is_compressed;
+        }
+
+        if ((opcode >= WS_FRAME_OPCODE_FIRST_CONTROL) || !instance->is_receiving_compressed_message)
+        {
+            instance->on_bytes_received(instance->on_bytes_received_context, frame_bytes, frame->header_size + frame->payload_size);
+            result = 0;
+        }
+        else
+        {
+            const unsigned char* payload = unmask_payload(instance, frame_bytes, frame);
+            size_t inflated_size;
+
+            if (is_final)
+            {
+                instance->is_receiving_compressed_message = false;
+            }
+
+            if ((payload == NULL) || (inflate_payload(instance, payload, frame->payload_size, is_final, &inflated_size) != 0))
+            {
+                LogError("unable to inflate a frame of %lu bytes", (unsigned long)frame->payload_size);
+                result = __FAILURE__;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_008: [ Once permessage-deflate is negotiated, the frames of the messages received with RSV1 set shall be inflated and given to the WebSocket IO unmasked, with RSV1 cleared; any other frame shall be given as it is. ]*/
+                unsigned char* inflated_frame = encode_frame_header(instance, frame->first_byte & ~WS_FRAME_RSV1, NULL, inflated_size);
+                instance->on_bytes_received(instance->on_bytes_received_context, inflated_frame, (size_t)(instance->frame + WS_FRAME_MAX_HEADER_SIZE + inflated_size - inflated_frame));
+                result = 0;
+            }
+        }
+    }
+    return result;
+}
+
+typedef int(*PROCESS_FRAME)(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* frame_bytes, const WS_FRAME* frame, ON_SEND_COMPLETE on_send_complete, void* callback_context);
+
+static int receive_frame_with_callback(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* frame_bytes, const WS_FRAME* frame, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    (void)on_send_complete;
+    (void)callback_context;
+    return receive_frame(instance, frame_bytes, frame);
+}
+
+/*processes the complete frames of the bytes kept in *partial followed by buffer, and keeps the start of the frame
+  they end with. The callback goes with the last frame processed, or is called right away if buffer completes none*/
+static int process_frames(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* buffer, size_t size, unsigned char** partial, size_t* partial_size, PROCESS_FRAME process_frame, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result = 0;
+    const unsigned char* bytes;
+    size_t bytes_size;
+    size_t offset = 0;
+    size_t partial_capacity = *partial_size;
+    bool is_callback_given = false;
+
+    if (*partial_size == 0)
+    {
+        bytes = buffer;
+        bytes_size = size;
+    }
+    else if (reserve(partial, &partial_capacity, *partial_size + size) != 0)
+    {
+        bytes = NULL;
+        bytes_size = 0;
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(*partial + *partial_size, buffer, size);
+        bytes = *partial;
+        bytes_size = *partial_size + size;
+    }
+
+    while (result == 0)
+    {
+        WS_FRAME frame;
+        WS_FRAME next_frame;
+        bool is_complete;
+        bool is_next_complete;
+        size_t frame_size;
+
+        if (decode_frame(bytes + offset, bytes_size - offset, &frame, &is_complete) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else if (!is_complete)
+        {
+            break;
+        }
+        else
+        {
+            frame_size = frame.header_size + frame.payload_size;
+            if (decode_frame(bytes + offset + frame_size, bytes_size - offset - frame_size, &next_frame, &is_next_complete) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else if (is_next_complete)
+            {
+                result = process_frame(instance, bytes + offset, &frame, NULL, NULL);
+            }
+            else
+            {
+                result = process_frame(instance, bytes + offset, &frame, on_send_complete, callback_context);
+                is_callback_given = true;
+            }
+            offset += frame_size;
+        }
+    }
+
+    if (result == 0)
+    {
+        size_t left = bytes_size - offset;
+        if (bytes == buffer)
+        {
+            if (left == 0)
+            {
+                *partial_size = 0;
+            }
+            else if (reserve(partial, &partial_capacity, left) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                (void)memcpy(*partial, buffer + offset, left);
+                *partial_size = left;
+            }
+        }
+        else
+        {
+            (void)memmove(*partial, *partial + offset, left);
+            *partial_size = left;
+        }
+
+        if ((result == 0) && !is_callback_given && (on_send_complete != NULL))
+        {
+            on_send_complete(callback_context, IO_SEND_OK);
+        }
+    }
+    return result;
+}
+
+static bool starts_with_ignoring_case(const char* text, const char* text_end, const char* prefix)
+{
+    bool result = true;
+    while (*prefix != '\0')
+    {
+        char c = (text < text_end) ? *text : '\0';
+        if ((c >= 'A') && (c <= 'Z'))
+        {
+            c = (char)(c - 'A' + 'a');
+        }
+        if (c != ((*prefix >= 'A') && (*prefix <= 'Z') ? (char)(*prefix - 'A' + 'a') : *prefix))
+        {
+            result = false;
+            break;
+        }
+        text++;
+        prefix++;
+    }
+    return result;
+}
+
+static const char* skip_spaces(const char* text, const char* text_end)
+{
+    while ((text < text_end) && ((*text == ' ') || (*text == '\t')))
+    {
+        text++;
+    }
+    return text;
+}
+
+static int parse_window_bits(const char* value, const char* value_end, int* window_bits)
+{
+    int result;
+    int bits = 0;
+    const char* digit;
+
+    value = skip_spaces(value, value_end);
+    if ((value < value_end) && (*value == '"'))
+    {
+        value++;
+    }
+    for (digit = value; (digit < value_end) && (*digit >= '0') && (*digit <= '9') && (bits <= WS_DEFLATE_MAX_WINDOW_BITS); digit++)
+    {
+        bits = bits * 10 + (*digit - '0');
+    }
+
+    if ((digit == value) || (bits < 8) || (bits > WS_DEFLATE_MAX_WINDOW_BITS))
+    {
+        LogError("invalid window bits in the permessage-deflate response");
+        result = __FAILURE__;
+    }
+    else
+    {
+        *window_bits = bits;
+        result = 0;
+    }
+    return result;
+}
+
+/*reads the parameters of the permessage-deflate the hub accepted, from after its name to the end of the header*/
+static int parse_deflate_parameters(WS_DEFLATE_IO_INSTANCE* instance, const char* parameters, const char* parameters_end)
+{
+    int result = 0;
+    const char* parameter = skip_spaces(parameters, parameters_end);
+
+    while ((result == 0) && (parameter < parameters_end) && (*parameter == ';'))
+    {
+        const char* parameter_end;
+        const char* equal;
+        int window_bits;
+
+        parameter = skip_spaces(parameter + 1, parameters_end);
+        for (parameter_end = parameter; (parameter_end < parameters_end) && (*parameter_end != ';') && (*parameter_end != ','); parameter_end++)
+        {
+        }
+        for (equal = parameter; (equal < parameter_end) && (*equal != '='); equal++)
+        {
+        }
+
+        if (starts_with_ignoring_case(parameter, parameter_end, "server_no_context_takeover"))
+        {
+            /*nothing to do: the hub does not use the previous messages, the inflate history does not matter*/
+        }
+        else if (starts_with_ignoring_case(parameter, parameter_end, "client_no_context_takeover"))
+        {
+            instance->client_no_context_takeover = true;
+        }
+        else if (starts_with_ignoring_case(parameter, parameter_end, "server_max_window_bits") && (equal < parameter_end))
+        {
+            if (parse_window_bits(equal + 1, parameter_end, &window_bits) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                instance->server_window_bits = window_bits;
+            }
+        }
+        else if (starts_with_ignoring_case(parameter, parameter_end, "client_max_window_bits") && (equal < parameter_end))
+        {
+            if (parse_window_bits(equal + 1, parameter_end, &window_bits) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else if (window_bits < WS_DEFLATE_MIN_WINDOW_BITS)
+            {
+                /*zlib does not deflate with an 8 bit window*/
+                LogError("the hub asks for a %d bit window, zlib needs at least %d", window_bits, WS_DEFLATE_MIN_WINDOW_BITS);
+                result = __FAILURE__;
+            }
+            else if (window_bits < instance->client_window_bits)
+            {
+                instance->client_window_bits = window_bits;
+            }
+        }
+        else
+        {
+            LogError("unknown permessage-deflate parameter in the response");
+            result = __FAILURE__;
+        }
+        parameter = parameter_end;
+    }
+
+    if ((result == 0) && (parameter < parameters_end))
+    {
+        /*a second extension, when only one was offered*/
+        LogError("extension not offered in the response");
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+/*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_004: [ When the upgrade response received ends, ws_deflate_io shall find out whether the hub accepted permessage-deflate from its Sec-WebSocket-Extensions header, with the window bits and context takeover it answers with, and start the deflate and inflate streams if it did. ]*/
+static int parse_upgrade_response(WS_DEFLATE_IO_INSTANCE* instance, const char* response, const char* response_end)
+{
+    int result = 0;
+    const char* line = response;
+
+    instance->client_window_bits = instance->options.clientMaxWindowBits;
+    instance->server_window_bits = (instance->options.serverMaxWindowBits == 0) ? WS_DEFLATE_MAX_WINDOW_BITS : instance->options.serverMaxWindowBits;
+    instance->client_no_context_takeover = instance->options.noContextTakeover;
+
+    while ((result == 0) && (line < response_end))
+    {
+        const char* line_end;
+        for (line_end = line; (line_end < response_end) && (*line_end != '\r') && (*line_end != '\n'); line_end++)
+        {
+        }
+
+        if (starts_with_ignoring_case(line, line_end, WS_EXTENSIONS_HEADER))
+        {
+            const char* value = skip_spaces(line + sizeof(WS_EXTENSIONS_HEADER) - 1, line_end);
+            if (!starts_with_ignoring_case(value, line_end, WS_PERMESSAGE_DEFLATE) || instance->is_negotiated)
+            {
+                LogError("extension not offered in the response");
+                result = __FAILURE__;
+            }
+            else if (parse_deflate_parameters(instance, value + sizeof(WS_PERMESSAGE_DEFLATE) - 1, line_end) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                instance->is_negotiated = true;
+            }
+        }
+
+        line = line_end;
+        while ((line < response_end) && ((*line == '\r') || (*line == '\n')))
+        {
+            line++;
+        }
+    }
+
+    if ((result == 0) && instance->is_negotiated && (start_codec(instance) != 0))
+    {
+        instance->is_negotiated = false;
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+/*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_003: [ When a level is set, the first bytes sent after ws_deflate_io_open, the upgrade request of the WebSocket IO, shall be sent with a Sec-WebSocket-Extensions header offering permessage-deflate with client_max_window_bits, server_max_window_bits when serverMaxWindowBits is not 0, and client_no_context_takeover and server_no_context_takeover when noContextTakeover is set. ]*/
+static int send_upgrade_request(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+    size_t header_end_size = sizeof(WS_HEADER_END) - 1;
+
+    instance->is_upgrade_sent = true;
+    if (instance->options.level == 0)
+    {
+        result = xio_send(instance->underlying_io, buffer, size, on_send_complete, callback_context);
+    }
+    else if ((size < header_end_size) || (memcmp(buffer + size - header_end_size, WS_HEADER_END, header_end_size) != 0))
+    {
+        LogError("the upgrade request is not sent at once, permessage-deflate is not offered");
+        result = xio_send(instance->underlying_io, buffer, size, on_send_complete, callback_context);
+    }
+    else
+    {
+        char offer[192];
+        char server_window_bits[40] = { 0 };
+        int offer_size;
+        unsigned char* request;
+
+        if (instance->options.serverMaxWindowBits != 0)
+        {
+            (void)snprintf(server_window_bits, sizeof(server_window_bits), "; server_max_window_bits=%d", instance->options.serverMaxWindowBits);
+        }
+        offer_size = snprintf(offer, sizeof(offer), "%s %s; client_max_window_bits=%d%s%s\r\n",
+            WS_EXTENSIONS_HEADER, WS_PERMESSAGE_DEFLATE, instance->options.clientMaxWindowBits, server_window_bits,
+            instance->options.noContextTakeover ? "; client_no_context_takeover; server_no_context_takeover" : "");
+
+        if ((offer_size < 0) || ((size_t)offer_size >= sizeof(offer)))
+        {
+            LogError("unable to write the permessage-deflate offer");
+            result = __FAILURE__;
+        }
+        else if ((request = (unsigned char*)malloc(size + offer_size)) == NULL)
+        {
+            LogError("unable to malloc");
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*the offer is the last header, before the empty line*/
+            (void)memcpy(request, buffer, size - 2);
+            (void)memcpy(request + size - 2, offer, offer_size);
+            (void)memcpy(request + size - 2 + offer_size, "\r\n", 2);
+            result = xio_send(instance->underlying_io, request, size + offer_size, on_send_complete, callback_context);
+            free(request);
+            instance->is_upgrade_offered = true;
+        }
+    }
+    return result;
+}
+
+static void report_error(WS_DEFLATE_IO_INSTANCE* instance)
+{
+    if (instance->on_io_error != NULL)
+    {
+        instance->on_io_error(instance->on_io_error_context);
+    }
+}
+
+static void receive_upgrade_response(WS_DEFLATE_IO_INSTANCE* instance, const unsigned char* buffer, size_t size)
+{
+    size_t capacity = instance->upgrade_response_size;
+    size_t header_end_size = sizeof(WS_HEADER_END) - 1;
+    size_t searched = (instance->upgrade_response_size < header_end_size) ? 0 : instance->upgrade_response_size - (header_end_size - 1);
+    size_t i;
+    size_t response_size = 0;
+
+    if ((instance->upgrade_response_size + size > WS_UPGRADE_RESPONSE_MAX_SIZE) ||
+        (reserve(&instance->upgrade_response, &capacity, instance->upgrade_response_size + size) != 0))
+    {
+        LogError("unable to keep an upgrade response of more than %lu bytes", (unsigned long)instance->upgrade_response_size);
+        report_error(instance);
+    }
+    else
+    {
+        (void)memcpy(instance->upgrade_response + instance->upgrade_response_size, buffer, size);
+        instance->upgrade_response_size += size;
+
+        for (i = searched; i + header_end_size <= instance->upgrade_response_size; i++)
+        {
+            if (memcmp(instance->upgrade_response + i, WS_HEADER_END, header_end_size) == 0)
+            {
+                response_size = i + header_end_size;
+                break;
+            }
+        }
+
+        if (response_size != 0)
+        {
+            size_t frames_size = instance->upgrade_response_size - response_size;
+            instance->is_upgraded = true;
+            instance->upgrade_response_size = 0;
+            if (parse_upgrade_response(instance, (const char*)instance->upgrade_response, (const char*)instance->upgrade_response + response_size) != 0)
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_005: [ If the response cannot be parsed, accepts an extension or a parameter that was not offered, or the deflate and inflate streams cannot be started, ws_deflate_io shall report an error with the on_io_error callback. ]*/
+                report_error(instance);
+            }
+            else
+            {
+                instance->on_bytes_received(instance->on_bytes_received_context, instance->upgrade_response, response_size);
+                if ((frames_size != 0) &&
+                    (process_frames(instance, instance->upgrade_response + response_size, frames_size, &instance->partial_received, &instance->partial_received_size, receive_frame_with_callback, NULL, NULL) != 0))
+                {
+                    report_error(instance);
+                }
+            }
+            free(instance->upgrade_response);
+            instance->upgrade_response = NULL;
+        }
+    }
+}
+
+static void on_underlying_bytes_received(void* context, const unsigned char* buffer, size_t size)
+{
+    WS_DEFLATE_IO_INSTANCE* instance = (WS_DEFLATE_IO_INSTANCE*)context;
+
+    if (instance->is_upgrade_offered && !instance->is_upgraded)
+    {
+        receive_upgrade_response(instance, buffer, size);
+    }
+    else if (!instance->is_negotiated)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_009: [ While permessage-deflate is not negotiated, ws_deflate_io shall send and receive the bytes as they are. ]*/
+        instance->on_bytes_received(instance->on_bytes_received_context, buffer, size);
+    }
+    else if (process_frames(instance, buffer, size, &instance->partial_received, &instance->partial_received_size, receive_frame_with_callback, NULL, NULL) != 0)
+    {
+        report_error(instance);
+    }
+}
+
+/*forgets what the previous connection negotiated*/
+static void reset_connection(WS_DEFLATE_IO_INSTANCE* instance)
+{
+    stop_codec(instance);
+    free(instance->upgrade_response);
+    instance->upgrade_response = NULL;
+    instance->upgrade_response_size = 0;
+    instance->partial_sent_size = 0;
+    instance->partial_received_size = 0;
+    instance->is_upgrade_sent = false;
+    instance->is_upgrade_offered = false;
+    instance->is_upgraded = false;
+    instance->is_negotiated = false;
+    instance->is_sending_compressed_message = false;
+    instance->is_receiving_compressed_message = false;
+}
+
+static CONCRETE_IO_HANDLE ws_deflate_io_create(void* io_create_parameters)
+{
+    WS_DEFLATE_IO_INSTANCE* result;
+    WS_DEFLATE_IO_CONFIG* config = (WS_DEFLATE_IO_CONFIG*)io_create_parameters;
+
+    /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_001: [ If io_create_parameters or its underlying_io_interface is NULL, ws_deflate_io_create shall fail and return NULL. ]*/
+    if ((config == NULL) || (config->underlying_io_interface == NULL))
+    {
+        LogError("invalid argument io_create_parameters(%p)", config);
+        result = NULL;
+    }
+    else if ((result = (WS_DEFLATE_IO_INSTANCE*)malloc(sizeof(WS_DEFLATE_IO_INSTANCE))) == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(WS_DEFLATE_IO_INSTANCE));
+        /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_002: [ ws_deflate_io_create shall create the underlying IO with xio_create and the underlying_io_interface and underlying_io_parameters of io_create_parameters, and shall not offer permessage-deflate until OPTION_WEBSOCKET_DEFLATE is set with a level. ]*/
+        if ((result->underlying_io = xio_create(config->underlying_io_interface, config->underlying_io_parameters)) == NULL)
+        {
+            LogError("xio_create failed");
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+static void ws_deflate_io_destroy(CONCRETE_IO_HANDLE ws_deflate_io)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_014: [ If ws_deflate_io is NULL, ws_deflate_io_destroy shall do nothing, otherwise it shall destroy the underlying IO, end the deflate and inflate streams and free the instance. ]*/
+    if (ws_deflate_io != NULL)
+    {
+        WS_DEFLATE_IO_INSTANCE* instance = (WS_DEFLATE_IO_INSTANCE*)ws_deflate_io;
+        xio_destroy(instance->underlying_io);
+        reset_connection(instance);
+        free(instance->partial_sent);
+        free(instance->partial_received);
+        free(instance->payload);
+        free(instance->frame);
+        free(instance);
+    }
+}
+
+static int ws_deflate_io_open(CONCRETE_IO_HANDLE ws_deflate_io, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+    int result;
+    if ((ws_deflate_io == NULL) || (on_bytes_received == NULL))
+    {
+        LogError("invalid argument ws_deflate_io(%p), on_bytes_received(%p)", ws_deflate_io, on_bytes_received);
+        result = __FAILURE__;
+    }
+    else
+    {
+        WS_DEFLATE_IO_INSTANCE* instance = (WS_DEFLATE_IO_INSTANCE*)ws_deflate_io;
+        /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_015: [ ws_deflate_io_open shall forget what the previous connection negotiated and open the underlying IO with xio_open, the bytes it receives going through ws_deflate_io before on_bytes_received. ]*/
+        reset_connection(instance);
+        instance->on_bytes_received = on_bytes_received;
+        instance->on_bytes_received_context = on_bytes_received_context;
+        instance->on_io_error = on_io_error;
+        instance->on_io_error_context = on_io_error_context;
+        result = xio_open(instance->underlying_io, on_io_open_complete, on_io_open_complete_context, on_underlying_bytes_received, instance, on_io_error, on_io_error_context);
+    }
+    return result;
+}
+
+static int ws_deflate_io_close(CONCRETE_IO_HANDLE ws_deflate_io, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+    int result;
+    if (ws_deflate_io == NULL)
+    {
+        LogError("invalid argument ws_deflate_io(NULL)");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_016: [ ws_deflate_io_close and ws_deflate_io_dowork shall call xio_close and xio_dowork on the underlying IO. ]*/
+        result = xio_close(((WS_DEFLATE_IO_INSTANCE*)ws_deflate_io)->underlying_io, on_io_close_complete, callback_context);
+    }
+    return result;
+}
+
+static int ws_deflate_io_send(CONCRETE_IO_HANDLE ws_deflate_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+    if ((ws_deflate_io == NULL) || (buffer == NULL) || (size == 0))
+    {
+        LogError("invalid argument ws_deflate_io(%p), buffer(%p), size(%lu)", ws_deflate_io, buffer, (unsigned long)size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        WS_DEFLATE_IO_INSTANCE* instance = (WS_DEFLATE_IO_INSTANCE*)ws_deflate_io;
+        if (!instance->is_upgrade_sent)
+        {
+            result = send_upgrade_request(instance, (const unsigned char*)buffer, size, on_send_complete, callback_context);
+        }
+        else if (!instance->is_negotiated)
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_009: [ While permessage-deflate is not negotiated, ws_deflate_io shall send and receive the bytes as they are. ]*/
+            result = xio_send(instance->underlying_io, buffer, size, on_send_complete, callback_context);
+        }
+        else
+        {
+            result = process_frames(instance, (const unsigned char*)buffer, size, &instance->partial_sent, &instance->partial_sent_size, send_frame, on_send_complete, callback_context);
+        }
+    }
+    return result;
+}
+
+static void ws_deflate_io_dowork(CONCRETE_IO_HANDLE ws_deflate_io)
+{
+    if (ws_deflate_io != NULL)
+    {
+        xio_dowork(((WS_DEFLATE_IO_INSTANCE*)ws_deflate_io)->underlying_io);
+    }
+}
+
+static int ws_deflate_io_setoption(CONCRETE_IO_HANDLE ws_deflate_io, const char* optionName, const void* value)
+{
+    int result;
+    if ((ws_deflate_io == NULL) || (optionName == NULL))
+    {
+        LogError("invalid argument ws_deflate_io(%p), optionName(%p)", ws_deflate_io, optionName);
+        result = __FAILURE__;
+    }
+    else
+    {
+        WS_DEFLATE_IO_INSTANCE* instance = (WS_DEFLATE_IO_INSTANCE*)ws_deflate_io;
+        if (strcmp(OPTION_WEBSOCKET_DEFLATE, optionName) == 0)
+        {
+            const IOTHUB_WEBSOCKET_DEFLATE_OPTIONS* options = (const IOTHUB_WEBSOCKET_DEFLATE_OPTIONS*)value;
+            /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_010: [ If optionName is OPTION_WEBSOCKET_DEFLATE, ws_deflate_io_setoption shall fail if value is NULL, level is not between 0 and 9, or, with a level, clientMaxWindowBits is not between 9 and 15, serverMaxWindowBits is neither 0 nor between 9 and 15, or the SDK is built without use_compression. ]*/
+            if ((options == NULL) || (options->level < 0) || (options->level > 9) ||
+                ((options->level != 0) &&
+                    ((options->clientMaxWindowBits < WS_DEFLATE_MIN_WINDOW_BITS) || (options->clientMaxWindowBits > WS_DEFLATE_MAX_WINDOW_BITS) ||
+                    ((options->serverMaxWindowBits != 0) && ((options->serverMaxWindowBits < WS_DEFLATE_MIN_WINDOW_BITS) || (options->serverMaxWindowBits > WS_DEFLATE_MAX_WINDOW_BITS))) ||
+                    !is_level_supported(options->level))))
+            {
+                LogError("invalid %s", OPTION_WEBSOCKET_DEFLATE);
+                result = __FAILURE__;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_011: [ Otherwise ws_deflate_io_setoption shall keep a copy of the options, used from the next ws_deflate_io_open, and return 0. ]*/
+                instance->options = *options;
+                result = 0;
+            }
+        }
+        else if (strcmp(WS_DEFLATE_IO_OPTION_UNDERLYING_OPTIONS, optionName) == 0)
+        {
+            if (OptionHandler_FeedOptions((OPTIONHANDLER_HANDLE)value, instance->underlying_io) != OPTIONHANDLER_OK)
+            {
+                LogError("OptionHandler_FeedOptions failed");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_012: [ Any other option shall be given to the underlying IO with xio_setoption. ]*/
+            result = xio_setoption(instance->underlying_io, optionName, value);
+        }
+    }
+    return result;
+}
+
+static void* ws_deflate_io_clone_option(const char* name, const void* value)
+{
+    void* result;
+    if (strcmp(OPTION_WEBSOCKET_DEFLATE, name) == 0)
+    {
+        if ((result = malloc(sizeof(IOTHUB_WEBSOCKET_DEFLATE_OPTIONS))) == NULL)
+        {
+            LogError("unable to malloc");
+        }
+        else
+        {
+            (void)memcpy(result, value, sizeof(IOTHUB_WEBSOCKET_DEFLATE_OPTIONS));
+        }
+    }
+    else if (strcmp(WS_DEFLATE_IO_OPTION_UNDERLYING_OPTIONS, name) == 0)
+    {
+        result = OptionHandler_Clone((OPTIONHANDLER_HANDLE)value);
+    }
+    else
+    {
+        LogError("unknown option %s", name);
+        result = NULL;
+    }
+    return result;
+}
+
+static void ws_deflate_io_destroy_option(const char* name, const void* value)
+{
+    if (strcmp(OPTION_WEBSOCKET_DEFLATE, name) == 0)
+    {
+        free((void*)value);
+    }
+    else if (strcmp(WS_DEFLATE_IO_OPTION_UNDERLYING_OPTIONS, name) == 0)
+    {
+        OptionHandler_Destroy((OPTIONHANDLER_HANDLE)value);
+    }
+    else
+    {
+        LogError("unknown option %s", name);
+    }
+}
+
+/*Codes_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_013: [ ws_deflate_io_retrieveoptions shall return an OPTIONHANDLER_HANDLE with OPTION_WEBSOCKET_DEFLATE when it has a level, and the options of the underlying IO. ]*/
+static OPTIONHANDLER_HANDLE ws_deflate_io_retrieveoptions(CONCRETE_IO_HANDLE ws_deflate_io)
+{
+    OPTIONHANDLER_HANDLE result;
+    if (ws_deflate_io == NULL)
+    {
+        LogError("invalid argument ws_deflate_io(NULL)");
+        result = NULL;
+    }
+    else if ((result = OptionHandler_Create(ws_deflate_io_clone_option, ws_deflate_io_destroy_option, ws_deflate_io_setoption)) == NULL)
+    {
+        LogError("OptionHandler_Create failed");
+    }
+    else
+    {
+        WS_DEFLATE_IO_INSTANCE* instance = (WS_DEFLATE_IO_INSTANCE*)ws_deflate_io;
+        OPTIONHANDLER_HANDLE underlying_options = xio_retrieveoptions(instance->underlying_io);
+
+        if (((instance->options.level != 0) && (OptionHandler_AddOption(result, OPTION_WEBSOCKET_DEFLATE, &instance->options) != OPTIONHANDLER_OK)) ||
+            ((underlying_options != NULL) && (OptionHandler_AddOption(result, WS_DEFLATE_IO_OPTION_UNDERLYING_OPTIONS, underlying_options) != OPTIONHANDLER_OK)))
+        {
+            LogError("OptionHandler_AddOption failed");
+            OptionHandler_Destroy(result);
+            result = NULL;
+        }
+
+        if (underlying_options != NULL)
+        {
+            OptionHandler_Destroy(underlying_options);
+        }
+    }
+    return result;
+}
+
+static const IO_INTERFACE_DESCRIPTION ws_deflate_io_interface_description =
+{
+    ws_deflate_io_retrieveoptions,
+    ws_deflate_io_create,
+    ws_deflate_io_destroy,
+    ws_deflate_io_open,
+    ws_deflate_io_close,
+    ws_deflate_io_send,
+    ws_deflate_io_dowork,
+    ws_deflate_io_setoption
+};
+
+const IO_INTERFACE_DESCRIPTION* ws_deflate_io_get_interface_description(void)
+{
+    return &ws_deflate_io_interface_description;
+}
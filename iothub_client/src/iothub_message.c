@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
@@ -9,25 +10,130 @@
 
 #include "iothub_message.h"
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
 DEFINE_ENUM_STRINGS(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES);
 DEFINE_ENUM_STRINGS(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 
 #define LOG_IOTHUB_MESSAGE_ERROR() \
     LogError("(result = %s)", ENUM_TO_STRING(IOTHUB_MESSAGE_RESULT, result));
 
-typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
+/*the clones of a message share its content, which never changes, and its properties until one of the clones changes them.
+The reference counts are atomic so that the clones of a message can be used and destroyed from different threads*/
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define IOTHUB_MESSAGE_USE_C11_ATOMICS
+typedef atomic_long IOTHUB_MESSAGE_REF_COUNT;
+typedef _Atomic(unsigned char*) IOTHUB_MESSAGE_FLAT_CONTENT;
+#elif defined(_MSC_VER)
+#include <windows.h>
+#define IOTHUB_MESSAGE_USE_INTERLOCKED
+typedef LONG volatile IOTHUB_MESSAGE_REF_COUNT;
+typedef unsigned char* volatile IOTHUB_MESSAGE_FLAT_CONTENT;
+#elif defined(__GNUC__)
+typedef long volatile IOTHUB_MESSAGE_REF_COUNT;
+typedef unsigned char* volatile IOTHUB_MESSAGE_FLAT_CONTENT;
+#else
+/*no atomic increment, the clones of a message shall not be destroyed or changed at the same time from different threads*/
+#define IOTHUB_MESSAGE_USE_PLAIN_COUNT
+typedef long IOTHUB_MESSAGE_REF_COUNT;
+typedef unsigned char* IOTHUB_MESSAGE_FLAT_CONTENT;
+#endif
+
+typedef struct IOTHUB_MESSAGE_CONTENT_TAG
 {
+    IOTHUB_MESSAGE_REF_COUNT refCount;
     IOTHUBMESSAGE_CONTENT_TYPE contentType;
+    bool isBorrowed;
     union 
     {
         BUFFER_HANDLE byteArray;
         STRING_HANDLE string;
+        struct
+        {
+            /*the segments are stored right after the content block*/
+            IOTHUB_MESSAGE_SEGMENT* segments;
+            size_t segmentCount;
+            size_t size;
+            IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK freeCallback;
+            void* context;
+            /*the segments copied in one block, built the first time a contiguous content is needed*/
+            IOTHUB_MESSAGE_FLAT_CONTENT flat;
+        } borrowed;
     } value;
-    MAP_HANDLE properties;
+}IOTHUB_MESSAGE_CONTENT;
+
+static const unsigned char EMPTY_CONTENT = 0x00;
+
+typedef struct IOTHUB_MESSAGE_PROPERTIES_TAG
+{
+    IOTHUB_MESSAGE_REF_COUNT refCount;
+    MAP_HANDLE map;
     char* messageId;
     char* correlationId;
+    /*application properties of a received message not yet added to map, NUL terminated name and value pairs*/
+    char* pending;
+    size_t pendingSize;
+}IOTHUB_MESSAGE_PROPERTIES;
+
+typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
+{
+    IOTHUB_MESSAGE_CONTENT* content;
+    IOTHUB_MESSAGE_PROPERTIES* properties;
+    IOTHUB_MESSAGE_PRIORITY priority;
+    IOTHUB_MESSAGE_COMPRESSION compression;
+    IOTHUB_MESSAGE_DELIVERY delivery;
 }IOTHUB_MESSAGE_HANDLE_DATA;
 
+static void ref_count_init(IOTHUB_MESSAGE_REF_COUNT* refCount)
+{
+#if defined(IOTHUB_MESSAGE_USE_C11_ATOMICS)
+    atomic_init(refCount, 1);
+#else
+    *refCount = 1;
+#endif
+}
+
+static void ref_count_inc(IOTHUB_MESSAGE_REF_COUNT* refCount)
+{
+#if defined(IOTHUB_MESSAGE_USE_C11_ATOMICS)
+    (void)atomic_fetch_add(refCount, 1);
+#elif defined(IOTHUB_MESSAGE_USE_INTERLOCKED)
+    (void)InterlockedIncrement(refCount);
+#elif defined(IOTHUB_MESSAGE_USE_PLAIN_COUNT)
+    (*refCount)++;
+#else
+    (void)__sync_add_and_fetch(refCount, 1);
+#endif
+}
+
+/*returns the count left after the decrement*/
+static long ref_count_dec(IOTHUB_MESSAGE_REF_COUNT* refCount)
+{
+    long result;
+#if defined(IOTHUB_MESSAGE_USE_C11_ATOMICS)
+    result = atomic_fetch_sub(refCount, 1) - 1;
+#elif defined(IOTHUB_MESSAGE_USE_INTERLOCKED)
+    result = InterlockedDecrement(refCount);
+#elif defined(IOTHUB_MESSAGE_USE_PLAIN_COUNT)
+    result = --(*refCount);
+#else
+    result = __sync_sub_and_fetch(refCount, 1);
+#endif
+    return result;
+}
+
+/*a count of 1 read by an owner cannot grow behind its back, since only the owners of a block can clone it*/
+static bool ref_count_is_shared(IOTHUB_MESSAGE_REF_COUNT* refCount)
+{
+#if defined(IOTHUB_MESSAGE_USE_C11_ATOMICS)
+    return atomic_load(refCount) > 1;
+#else
+    return *refCount > 1;
+#endif
+}
+
 static bool ContainsOnlyUsAscii(const char* asciiValue)
 {
     bool result = true;
@@ -60,6 +166,259 @@ static int ValidateAsciiCharactersFilter(const char* mapKey, const char* mapValu
     return result;
 }
 
+/*stores copy as the flat content unless another clone stored one first, returns the stored one*/
+static unsigned char* publish_flat_content(IOTHUB_MESSAGE_CONTENT* content, unsigned char* copy)
+{
+    unsigned char* result;
+#if defined(IOTHUB_MESSAGE_USE_C11_ATOMICS)
+    unsigned char* expected = NULL;
+    result = atomic_compare_exchange_strong(&content->value.borrowed.flat, &expected, copy) ? copy : expected;
+#elif defined(IOTHUB_MESSAGE_USE_INTERLOCKED)
+    result = (unsigned char*)InterlockedCompareExchangePointer((PVOID volatile*)&content->value.borrowed.flat, copy, NULL);
+    result = (result == NULL) ? copy : result;
+#elif defined(IOTHUB_MESSAGE_USE_PLAIN_COUNT)
+    if (content->value.borrowed.flat == NULL)
+    {
+        content->value.borrowed.flat = copy;
+    }
+    result = content->value.borrowed.flat;
+#else
+    result = __sync_val_compare_and_swap(&content->value.borrowed.flat, NULL, copy);
+    result = (result == NULL) ? copy : result;
+#endif
+    return result;
+}
+
+/*returns the content of a borrowed message as one block. A message of several segments is copied once, on first use;
+clones racing to copy it keep the first copy published*/
+static const unsigned char* get_flat_content(IOTHUB_MESSAGE_CONTENT* content)
+{
+    const unsigned char* result;
+    if (content->value.borrowed.size == 0)
+    {
+        result = &EMPTY_CONTENT;
+    }
+    else if (content->value.borrowed.segmentCount == 1)
+    {
+        result = content->value.borrowed.segments[0].buffer;
+    }
+#if defined(IOTHUB_MESSAGE_USE_C11_ATOMICS)
+    else if ((result = atomic_load(&content->value.borrowed.flat)) != NULL)
+#else
+    else if ((result = content->value.borrowed.flat) != NULL)
+#endif
+    {
+        /*already copied*/
+    }
+    else
+    {
+        unsigned char* copy = (unsigned char*)malloc(content->value.borrowed.size);
+        if (copy == NULL)
+        {
+            LogError("unable to malloc");
+            result = NULL;
+        }
+        else
+        {
+            size_t i;
+            size_t position = 0;
+            for (i = 0; i < content->value.borrowed.segmentCount; i++)
+            {
+                if (content->value.borrowed.segments[i].size != 0)
+                {
+                    (void)memcpy(copy + position, content->value.borrowed.segments[i].buffer, content->value.borrowed.segments[i].size);
+                    position += content->value.borrowed.segments[i].size;
+                }
+            }
+
+            result = publish_flat_content(content, copy);
+            if (result != copy)
+            {
+                free(copy);
+            }
+        }
+    }
+    return result;
+}
+
+static IOTHUB_MESSAGE_PROPERTIES* create_properties(void)
+{
+    IOTHUB_MESSAGE_PROPERTIES* result = (IOTHUB_MESSAGE_PROPERTIES*)malloc(sizeof(IOTHUB_MESSAGE_PROPERTIES));
+    if (result == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else if ((result->map = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+    {
+        LogError("Map_Create failed");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        ref_count_init(&result->refCount);
+        result->messageId = NULL;
+        result->correlationId = NULL;
+        result->pending = NULL;
+        result->pendingSize = 0;
+    }
+    return result;
+}
+
+static void release_content(IOTHUB_MESSAGE_CONTENT* content)
+{
+    if (ref_count_dec(&content->refCount) == 0)
+    {
+        if (content->isBorrowed)
+        {
+            if (content->value.borrowed.freeCallback != NULL)
+            {
+                size_t i;
+                for (i = 0; i < content->value.borrowed.segmentCount; i++)
+                {
+                    content->value.borrowed.freeCallback(content->value.borrowed.segments[i].buffer, content->value.borrowed.context);
+                }
+            }
+            if (content->value.borrowed.flat != NULL)
+            {
+                free((void*)content->value.borrowed.flat);
+            }
+        }
+        else if (content->contentType == IOTHUBMESSAGE_BYTEARRAY)
+        {
+            BUFFER_delete(content->value.byteArray);
+        }
+        else if (content->contentType == IOTHUBMESSAGE_STRING)
+        {
+            STRING_delete(content->value.string);
+        }
+        else
+        {
+            LogError("Unknown contentType in IoTHubMessage");
+        }
+        free(content);
+    }
+}
+
+static void release_properties(IOTHUB_MESSAGE_PROPERTIES* properties)
+{
+    if (ref_count_dec(&properties->refCount) == 0)
+    {
+        Map_Destroy(properties->map);
+        free(properties->messageId);
+        free(properties->correlationId);
+        free(properties->pending);
+        free(properties);
+    }
+}
+
+/*adds the pending application properties to the map, they are kept pending if that fails so that it can be retried*/
+static int apply_pending_properties(IOTHUB_MESSAGE_PROPERTIES* properties)
+{
+    int result = 0;
+    if (properties->pending != NULL)
+    {
+        size_t position = 0;
+        while ((position < properties->pendingSize) && (result == 0))
+        {
+            const char* name = properties->pending + position;
+            const char* value = name + strlen(name) + 1;
+            if ((size_t)(value - properties->pending) >= properties->pendingSize)
+            {
+                LogError("property %s has no value, it is dropped", name);
+                break;
+            }
+            else if (Map_AddOrUpdate(properties->map, name, value) != MAP_OK)
+            {
+                LogError("Map_AddOrUpdate failed for property %s", name);
+                result = __FAILURE__;
+            }
+            else
+            {
+                position = (size_t)(value - properties->pending) + strlen(value) + 1;
+            }
+        }
+
+        if (result == 0)
+        {
+            free(properties->pending);
+            properties->pending = NULL;
+            properties->pendingSize = 0;
+        }
+    }
+    return result;
+}
+
+/*gives the message its own copy of the properties when they are shared with a clone, so that they can be changed*/
+static int make_properties_writable(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    int result;
+    IOTHUB_MESSAGE_PROPERTIES* source = handleData->properties;
+    if (!ref_count_is_shared(&source->refCount))
+    {
+        result = 0;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_PROPERTIES* copy = (IOTHUB_MESSAGE_PROPERTIES*)malloc(sizeof(IOTHUB_MESSAGE_PROPERTIES));
+        if (copy == NULL)
+        {
+            LogError("unable to malloc");
+            result = __FAILURE__;
+        }
+        else
+        {
+            copy->messageId = NULL;
+            copy->correlationId = NULL;
+            copy->pending = NULL;
+            copy->pendingSize = 0;
+            if ((copy->map = Map_Clone(source->map)) == NULL)
+            {
+                LogError("unable to Map_Clone");
+                free(copy);
+                result = __FAILURE__;
+            }
+            else if (source->messageId != NULL && mallocAndStrcpy_s(&copy->messageId, source->messageId) != 0)
+            {
+                LogError("unable to Copy messageId");
+                Map_Destroy(copy->map);
+                free(copy);
+                result = __FAILURE__;
+            }
+            else if (source->correlationId != NULL && mallocAndStrcpy_s(&copy->correlationId, source->correlationId) != 0)
+            {
+                LogError("unable to Copy correlationId");
+                Map_Destroy(copy->map);
+                free(copy->messageId);
+                free(copy);
+                result = __FAILURE__;
+            }
+            else if (source->pending != NULL && (copy->pending = (char*)malloc(source->pendingSize)) == NULL)
+            {
+                LogError("unable to Copy the pending properties");
+                Map_Destroy(copy->map);
+                free(copy->messageId);
+                free(copy->correlationId);
+                free(copy);
+                result = __FAILURE__;
+            }
+            else
+            {
+                if (source->pending != NULL)
+                {
+                    (void)memcpy(copy->pending, source->pending, source->pendingSize);
+                    copy->pendingSize = source->pendingSize;
+                }
+                ref_count_init(&copy->refCount);
+                handleData->properties = copy;
+                release_properties(source);
+                result = 0;
+            }
+        }
+    }
+    return result;
+}
+
 IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
 {
     IOTHUB_MESSAGE_HANDLE_DATA* result;
@@ -77,6 +436,13 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
             /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
             /*let it go through*/
         }
+        else if ((result->content = (IOTHUB_MESSAGE_CONTENT*)malloc(sizeof(IOTHUB_MESSAGE_CONTENT))) == NULL)
+        {
+            LogError("unable to malloc");
+            /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
+            free(result);
+            result = NULL;
+        }
         else
         {
             const unsigned char* source;
@@ -84,57 +450,225 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
             if (size != 0)
             {
                 /*Codes_SRS_IOTHUBMESSAGE_06_002: [If size is NOT zero then byteArray MUST NOT be NULL*/
-                if (byteArray == NULL)
-                {
-                    LogError("Attempted to create a Hub Message from a NULL pointer!");
-                    free(result);
-                    result = NULL;
-                    source = NULL;
-                }
-                else
-                {
-                    source = byteArray;
-                }
+                source = byteArray;
             }
             else
             {
                 /*Codes_SRS_IOTHUBMESSAGE_06_001: [If size is zero then byteArray may be NULL.]*/
                 source = &temp;
             }
-            if (result != NULL)
+
+            /*Codes_SRS_IOTHUBMESSAGE_02_022: [IoTHubMessage_CreateFromByteArray shall call BUFFER_create passing byteArray and size as parameters.] */
+            if ((result->content->value.byteArray = BUFFER_create(source, size)) == NULL)
             {
-                /*Codes_SRS_IOTHUBMESSAGE_02_022: [IoTHubMessage_CreateFromByteArray shall call BUFFER_create passing byteArray and size as parameters.] */
-                if ((result->value.byteArray = BUFFER_create(source, size)) == NULL)
-                {
-                    LogError("BUFFER_create failed");
-                    /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
-                    free(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_023: [IoTHubMessage_CreateFromByteArray shall call Map_Create to create the message properties.] */
-                else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
-                {
-                    LogError("Map_Create failed");
-                    /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
-                    BUFFER_delete(result->value.byteArray);
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_02_025: [Otherwise, IoTHubMessage_CreateFromByteArray shall return a non-NULL handle.] */
-                    /*Codes_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
-                    result->contentType = IOTHUBMESSAGE_BYTEARRAY;
-                    result->messageId = NULL;
-                    result->correlationId = NULL;
-                    /*all is fine, return result*/
-                }
+                LogError("BUFFER_create failed");
+                /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
+                free(result->content);
+                free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_IOTHUBMESSAGE_02_023: [IoTHubMessage_CreateFromByteArray shall call Map_Create to create the message properties.] */
+            else if ((result->properties = create_properties()) == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
+                BUFFER_delete(result->content->value.byteArray);
+                free(result->content);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_02_025: [Otherwise, IoTHubMessage_CreateFromByteArray shall return a non-NULL handle.] */
+                /*Codes_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
+                ref_count_init(&result->content->refCount);
+                result->content->contentType = IOTHUBMESSAGE_BYTEARRAY;
+                result->content->isBorrowed = false;
+                /*Codes_SRS_IOTHUBMESSAGE_41_001: [The priority of the new message shall be IOTHUB_MESSAGE_PRIORITY_NORMAL.] */
+                result->priority = IOTHUB_MESSAGE_PRIORITY_NORMAL;
+                result->compression = IOTHUB_MESSAGE_COMPRESSION_DEFAULT;
+                result->delivery = IOTHUB_MESSAGE_DELIVERY_DEFAULT;
+                /*all is fine, return result*/
             }
         }
     }
     return result;
 }
 
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromPrototype(IOTHUB_MESSAGE_HANDLE prototype, const unsigned char* byteArray, size_t size)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_IOTHUBMESSAGE_41_032: [If prototype is NULL, or byteArray is NULL and size is not zero, then IoTHubMessage_CreateFromPrototype shall fail and return NULL.] */
+    if ((prototype == NULL) || ((byteArray == NULL) && (size != 0)))
+    {
+        LogError("Invalid argument - prototype=%p, byteArray=%p, size=%lu", prototype, byteArray, (unsigned long)size);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_035: [If there are any errors then IoTHubMessage_CreateFromPrototype shall return NULL.] */
+        LogError("unable to malloc");
+    }
+    else if ((result->content = (IOTHUB_MESSAGE_CONTENT*)malloc(sizeof(IOTHUB_MESSAGE_CONTENT))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_035: [If there are any errors then IoTHubMessage_CreateFromPrototype shall return NULL.] */
+        LogError("unable to malloc");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        unsigned char temp = 0x00;
+        /*Codes_SRS_IOTHUBMESSAGE_41_033: [IoTHubMessage_CreateFromPrototype shall call BUFFER_create passing byteArray and size as parameters.] */
+        if ((result->content->value.byteArray = BUFFER_create((size != 0) ? byteArray : &temp, size)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_035: [If there are any errors then IoTHubMessage_CreateFromPrototype shall return NULL.] */
+            LogError("BUFFER_create failed");
+            free(result->content);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            ref_count_init(&result->content->refCount);
+            result->content->contentType = IOTHUBMESSAGE_BYTEARRAY;
+            result->content->isBorrowed = false;
+            /*Codes_SRS_IOTHUBMESSAGE_41_034: [IoTHubMessage_CreateFromPrototype shall share the properties, message id and correlation id of prototype with the new message by incrementing their reference count, copy the priority of prototype and return a non-NULL handle to a message of type IOTHUBMESSAGE_BYTEARRAY.] */
+            ref_count_inc(&prototype->properties->refCount);
+            result->properties = prototype->properties;
+            result->priority = prototype->priority;
+            /*Codes_SRS_IOTHUBMESSAGE_41_036: [IoTHubMessage_Clone and IoTHubMessage_CreateFromPrototype shall copy the compression of the message.] */
+            result->compression = prototype->compression;
+            /*Codes_SRS_IOTHUBMESSAGE_41_041: [IoTHubMessage_Clone and IoTHubMessage_CreateFromPrototype shall copy the delivery of the message.] */
+            result->delivery = prototype->delivery;
+        }
+    }
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE_DATA* create_borrowed_message(const IOTHUB_MESSAGE_SEGMENT* segments, size_t segmentCount, IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK freeCallback, void* context)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
+    if (result == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else if ((result->content = (IOTHUB_MESSAGE_CONTENT*)malloc(sizeof(IOTHUB_MESSAGE_CONTENT) + segmentCount * sizeof(IOTHUB_MESSAGE_SEGMENT))) == NULL)
+    {
+        LogError("unable to malloc");
+        free(result);
+        result = NULL;
+    }
+    else if ((result->properties = create_properties()) == NULL)
+    {
+        free(result->content);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        size_t i;
+        ref_count_init(&result->content->refCount);
+        result->content->contentType = IOTHUBMESSAGE_BYTEARRAY;
+        result->content->isBorrowed = true;
+        result->content->value.borrowed.segments = (IOTHUB_MESSAGE_SEGMENT*)(result->content + 1);
+        result->content->value.borrowed.segmentCount = segmentCount;
+        result->content->value.borrowed.size = 0;
+        for (i = 0; i < segmentCount; i++)
+        {
+            result->content->value.borrowed.segments[i] = segments[i];
+            result->content->value.borrowed.size += segments[i].size;
+        }
+        result->content->value.borrowed.freeCallback = freeCallback;
+        result->content->value.borrowed.context = context;
+#if defined(IOTHUB_MESSAGE_USE_C11_ATOMICS)
+        atomic_init(&result->content->value.borrowed.flat, NULL);
+#else
+        result->content->value.borrowed.flat = NULL;
+#endif
+        result->priority = IOTHUB_MESSAGE_PRIORITY_NORMAL;
+        result->compression = IOTHUB_MESSAGE_COMPRESSION_DEFAULT;
+        result->delivery = IOTHUB_MESSAGE_DELIVERY_DEFAULT;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromBorrowedBuffer(const unsigned char* buffer, size_t size, IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK freeCallback, void* context)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_IOTHUBMESSAGE_41_017: [If buffer is NULL and size is not zero then IoTHubMessage_CreateFromBorrowedBuffer shall fail and return NULL.] */
+    if ((buffer == NULL) && (size != 0))
+    {
+        LogError("Invalid argument - buffer is NULL");
+        result = NULL;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_SEGMENT segment;
+        segment.buffer = buffer;
+        segment.size = size;
+        /*Codes_SRS_IOTHUBMESSAGE_41_019: [IoTHubMessage_CreateFromBorrowedBuffer shall call Map_Create to create the message properties.] */
+        /*Codes_SRS_IOTHUBMESSAGE_41_018: [If there are any errors then IoTHubMessage_CreateFromBorrowedBuffer shall return NULL and shall not call freeCallback.] */
+        /*Codes_SRS_IOTHUBMESSAGE_41_020: [IoTHubMessage_CreateFromBorrowedBuffer shall keep buffer without copying it and return a non-NULL handle to a message of type IOTHUBMESSAGE_BYTEARRAY and priority IOTHUB_MESSAGE_PRIORITY_NORMAL.] */
+        result = create_borrowed_message(&segment, 1, freeCallback, context);
+    }
+    return result;
+}
+
+static void free_owned_buffer(const unsigned char* buffer, void* context)
+{
+    (void)context;
+    free((void*)buffer);
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromOwnedBuffer(unsigned char* buffer, size_t size)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_IOTHUBMESSAGE_41_051: [If buffer is NULL and size is not zero then IoTHubMessage_CreateFromOwnedBuffer shall fail and return NULL.] */
+    if ((buffer == NULL) && (size != 0))
+    {
+        LogError("Invalid argument - buffer is NULL");
+        result = NULL;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_SEGMENT segment;
+        segment.buffer = buffer;
+        segment.size = size;
+        /*Codes_SRS_IOTHUBMESSAGE_41_052: [If there are any errors then IoTHubMessage_CreateFromOwnedBuffer shall return NULL and shall not free buffer.] */
+        /*Codes_SRS_IOTHUBMESSAGE_41_053: [IoTHubMessage_CreateFromOwnedBuffer shall take ownership of buffer without copying it and return a non-NULL handle to a message of type IOTHUBMESSAGE_BYTEARRAY and priority IOTHUB_MESSAGE_PRIORITY_NORMAL.] */
+        /*Codes_SRS_IOTHUBMESSAGE_41_054: [When the content of a message created by IoTHubMessage_CreateFromOwnedBuffer is freed, IoTHubMessage_Destroy shall free buffer.] */
+        result = create_borrowed_message(&segment, 1, free_owned_buffer, NULL);
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromBorrowedSegments(const IOTHUB_MESSAGE_SEGMENT* segments, size_t segmentCount, IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK freeCallback, void* context)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    size_t i;
+    for (i = 0; i < segmentCount; i++)
+    {
+        if ((segments == NULL) || ((segments[i].buffer == NULL) && (segments[i].size != 0)))
+        {
+            break;
+        }
+    }
+
+    /*Codes_SRS_IOTHUBMESSAGE_41_023: [If segments is NULL and segmentCount is not zero, or the buffer of a segment is NULL and its size is not zero, then IoTHubMessage_CreateFromBorrowedSegments shall fail and return NULL.] */
+    if (i < segmentCount)
+    {
+        LogError("Invalid argument - segments=%p, segment %lu has a NULL buffer", segments, (unsigned long)i);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_024: [IoTHubMessage_CreateFromBorrowedSegments shall copy the segment descriptors but not the segments and return a non-NULL handle to a message of type IOTHUBMESSAGE_BYTEARRAY whose content is the segments in order.] */
+        /*Codes_SRS_IOTHUBMESSAGE_41_025: [If there are any errors then IoTHubMessage_CreateFromBorrowedSegments shall return NULL and shall not call freeCallback.] */
+        result = create_borrowed_message(segments, segmentCount, freeCallback, context);
+    }
+    return result;
+}
+
 IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
 {
     IOTHUB_MESSAGE_HANDLE_DATA* result;
@@ -152,33 +686,42 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
             /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
             /*let it go through*/
         }
+        else if ((result->content = (IOTHUB_MESSAGE_CONTENT*)malloc(sizeof(IOTHUB_MESSAGE_CONTENT))) == NULL)
+        {
+            LogError("malloc failed");
+            /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
+            free(result);
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBMESSAGE_02_027: [IoTHubMessage_CreateFromString shall call STRING_construct passing source as parameter.] */
+        else if ((result->content->value.string = STRING_construct(source)) == NULL)
+        {
+            LogError("STRING_construct failed");
+            /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
+            free(result->content);
+            free(result);
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBMESSAGE_02_028: [IoTHubMessage_CreateFromString shall call Map_Create to create the message properties.] */
+        else if ((result->properties = create_properties()) == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
+            STRING_delete(result->content->value.string);
+            free(result->content);
+            free(result);
+            result = NULL;
+        }
         else
         {
-            /*Codes_SRS_IOTHUBMESSAGE_02_027: [IoTHubMessage_CreateFromString shall call STRING_construct passing source as parameter.] */
-            if ((result->value.string = STRING_construct(source)) == NULL)
-            {
-                LogError("STRING_construct failed");
-                /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
-                free(result);
-                result = NULL;
-            }
-            /*Codes_SRS_IOTHUBMESSAGE_02_028: [IoTHubMessage_CreateFromString shall call Map_Create to create the message properties.] */
-            else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
-            {
-                LogError("Map_Create failed");
-                /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
-                STRING_delete(result->value.string);
-                free(result);
-                result = NULL;
-            }
-            else
-            {
-                /*Codes_SRS_IOTHUBMESSAGE_02_031: [Otherwise, IoTHubMessage_CreateFromString shall return a non-NULL handle.] */
-                /*Codes_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
-                result->contentType = IOTHUBMESSAGE_STRING;
-                result->messageId = NULL;
-                result->correlationId = NULL;
-            }
+            /*Codes_SRS_IOTHUBMESSAGE_02_031: [Otherwise, IoTHubMessage_CreateFromString shall return a non-NULL handle.] */
+            /*Codes_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
+            ref_count_init(&result->content->refCount);
+            result->content->contentType = IOTHUBMESSAGE_STRING;
+            result->content->isBorrowed = false;
+            /*Codes_SRS_IOTHUBMESSAGE_41_002: [The priority of the new message shall be IOTHUB_MESSAGE_PRIORITY_NORMAL.] */
+            result->priority = IOTHUB_MESSAGE_PRIORITY_NORMAL;
+            result->compression = IOTHUB_MESSAGE_COMPRESSION_DEFAULT;
+            result->delivery = IOTHUB_MESSAGE_DELIVERY_DEFAULT;
         }
     }
     return result;
@@ -198,7 +741,6 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
     else
     {
         result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
-        /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
         if (result == NULL)
         {
             /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
@@ -207,116 +749,19 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
         }
         else
         {
-            result->messageId = NULL;
-            result->correlationId = NULL;
-            if (source->messageId != NULL && mallocAndStrcpy_s(&result->messageId, source->messageId) != 0)
-            {
-                LogError("unable to Copy messageId");
-                free(result);
-                result = NULL;
-            }
-            else if (source->correlationId != NULL && mallocAndStrcpy_s(&result->correlationId, source->correlationId) != 0)
-            {
-                LogError("unable to Copy correlationId");
-                if (result->messageId != NULL)
-                {
-                    free(result->messageId);
-                    result->messageId = NULL;
-                }
-                free(result);
-                result = NULL;
-            }
-            else if (source->contentType == IOTHUBMESSAGE_BYTEARRAY)
-            {
-                /*Codes_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone to content by a call to BUFFER_clone] */
-                if ((result->value.byteArray = BUFFER_clone(source->value.byteArray)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to BUFFER_clone");
-                    if (result->messageId)
-                    {
-                        free(result->messageId);
-                        result->messageId = NULL;
-                    }
-                    if (result->correlationId != NULL)
-                    {
-                        free(result->correlationId);
-                        result->correlationId = NULL;
-                    }
-                    free(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-                else if ((result->properties = Map_Clone(source->properties)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to Map_Clone");
-                    BUFFER_delete(result->value.byteArray);
-                    if (result->messageId)
-                    {
-                        free(result->messageId);
-                        result->messageId = NULL;
-                    }
-                    if (result->correlationId != NULL)
-                    {
-                        free(result->correlationId);
-                        result->correlationId = NULL;
-                    }
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    result->contentType = IOTHUBMESSAGE_BYTEARRAY;
-                    /*Codes_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
-                    /*return as is, this is a good result*/
-                }
-            }
-            else /*can only be STRING*/
-            {
-                /*Codes_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-                if ((result->value.string = STRING_clone(source->value.string)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    if (result->messageId)
-                    {
-                        free(result->messageId);
-                        result->messageId = NULL;
-                    }
-                    if (result->correlationId != NULL)
-                    {
-                        free(result->correlationId);
-                        result->correlationId = NULL;
-                    }
-                    free(result);
-                    result = NULL;
-                    LogError("failed to STRING_clone");
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-                else if ((result->properties = Map_Clone(source->properties)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to Map_Clone");
-                    STRING_delete(result->value.string);
-                    if (result->messageId)
-                    {
-                        free(result->messageId);
-                        result->messageId = NULL;
-                    }
-                    if (result->correlationId != NULL)
-                    {
-                        free(result->correlationId);
-                        result->correlationId = NULL;
-                    }
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    result->contentType = IOTHUBMESSAGE_STRING;
-                    /*all is fine*/
-                }
-            }
+            /*Codes_SRS_IOTHUBMESSAGE_41_008: [IoTHubMessage_Clone shall share the content of the message with the new message by incrementing its reference count.] */
+            ref_count_inc(&source->content->refCount);
+            result->content = source->content;
+            /*Codes_SRS_IOTHUBMESSAGE_41_009: [IoTHubMessage_Clone shall share the properties, message id and correlation id of the message with the new message by incrementing their reference count.] */
+            ref_count_inc(&source->properties->refCount);
+            result->properties = source->properties;
+            /*Codes_SRS_IOTHUBMESSAGE_41_003: [IoTHubMessage_Clone shall copy the priority of the message.] */
+            result->priority = source->priority;
+            /*Codes_SRS_IOTHUBMESSAGE_41_036: [IoTHubMessage_Clone and IoTHubMessage_CreateFromPrototype shall copy the compression of the message.] */
+            result->compression = source->compression;
+            /*Codes_SRS_IOTHUBMESSAGE_41_041: [IoTHubMessage_Clone and IoTHubMessage_CreateFromPrototype shall copy the delivery of the message.] */
+            result->delivery = source->delivery;
+            /*Codes_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
         }
     }
     return result;
@@ -338,24 +783,86 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMes
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        if (handleData->contentType != IOTHUBMESSAGE_BYTEARRAY)
+        if (handleData->content->contentType != IOTHUBMESSAGE_BYTEARRAY)
         {
             /*Codes_SRS_IOTHUBMESSAGE_02_021: [If iotHubMessageHandle is not a iothubmessage containing BYTEARRAY data, then IoTHubMessage_GetData shall write in *buffer NULL and shall set *size to 0.] */
             result = IOTHUB_MESSAGE_INVALID_ARG;
-            LogError("invalid type of message %s", ENUM_TO_STRING(IOTHUBMESSAGE_CONTENT_TYPE, handleData->contentType));
+            LogError("invalid type of message %s", ENUM_TO_STRING(IOTHUBMESSAGE_CONTENT_TYPE, handleData->content->contentType));
+        }
+        else if (handleData->content->isBorrowed)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_021: [If the message was created by IoTHubMessage_CreateFromBorrowedBuffer or IoTHubMessage_CreateFromOwnedBuffer, IoTHubMessage_GetByteArray shall return the buffer and size it was created with.] */
+            /*Codes_SRS_IOTHUBMESSAGE_41_026: [If the message was created by IoTHubMessage_CreateFromBorrowedSegments with more than one segment, IoTHubMessage_GetByteArray shall copy the segments in one block the first time it is called and return that block afterwards, for the message and all its clones.] */
+            const unsigned char* flat = get_flat_content(handleData->content);
+            if (flat == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_41_027: [If copying the segments fails, IoTHubMessage_GetByteArray shall return IOTHUB_MESSAGE_ERROR.] */
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else
+            {
+                *buffer = flat;
+                *size = handleData->content->value.borrowed.size;
+                result = IOTHUB_MESSAGE_OK;
+            }
         }
         else
         {
             /*Codes_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
-            *buffer = BUFFER_u_char(handleData->value.byteArray);
+            *buffer = BUFFER_u_char(handleData->content->value.byteArray);
             /*Codes_SRS_IOTHUBMESSAGE_01_012: [The size of the associated data shall be obtained by using BUFFER_length and it shall be copied to the size argument.]*/
-            *size = BUFFER_length(handleData->value.byteArray);
+            *size = BUFFER_length(handleData->content->value.byteArray);
             result = IOTHUB_MESSAGE_OK;
         }
     }
     return result;
 }
 
+size_t IoTHubMessage_GetSegmentCount(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    size_t result;
+    /*Codes_SRS_IOTHUBMESSAGE_41_028: [If iotHubMessageHandle is NULL or the message is not of type IOTHUBMESSAGE_BYTEARRAY then IoTHubMessage_GetSegmentCount shall return 0.] */
+    if ((iotHubMessageHandle == NULL) || (iotHubMessageHandle->content->contentType != IOTHUBMESSAGE_BYTEARRAY))
+    {
+        result = 0;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_41_029: [IoTHubMessage_GetSegmentCount shall return the number of segments of a message created by IoTHubMessage_CreateFromBorrowedSegments, and 1 for the other byte array messages.] */
+    else if (iotHubMessageHandle->content->isBorrowed)
+    {
+        result = iotHubMessageHandle->content->value.borrowed.segmentCount;
+    }
+    else
+    {
+        result = 1;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_GetSegment(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, size_t index, const unsigned char** buffer, size_t* size)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /*Codes_SRS_IOTHUBMESSAGE_41_030: [If iotHubMessageHandle, buffer or size is NULL, or index is not less than IoTHubMessage_GetSegmentCount, then IoTHubMessage_GetSegment shall return IOTHUB_MESSAGE_INVALID_ARG.] */
+    if ((buffer == NULL) || (size == NULL) || (index >= IoTHubMessage_GetSegmentCount(iotHubMessageHandle)))
+    {
+        LogError("invalid arg passed to IoTHubMessage_GetSegment, iotHubMessageHandle=%p, index=%lu, buffer=%p, size=%p", iotHubMessageHandle, (unsigned long)index, buffer, size);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_41_031: [IoTHubMessage_GetSegment shall return the buffer and size of the segment without copying it and return IOTHUB_MESSAGE_OK.] */
+    else if (iotHubMessageHandle->content->isBorrowed)
+    {
+        *buffer = iotHubMessageHandle->content->value.borrowed.segments[index].buffer;
+        *size = iotHubMessageHandle->content->value.borrowed.segments[index].size;
+        result = IOTHUB_MESSAGE_OK;
+    }
+    else
+    {
+        *buffer = BUFFER_u_char(iotHubMessageHandle->content->value.byteArray);
+        *size = BUFFER_length(iotHubMessageHandle->content->value.byteArray);
+        result = IOTHUB_MESSAGE_OK;
+    }
+    return result;
+}
+
 const char* IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
 {
     const char* result;
@@ -367,7 +874,7 @@ const char* IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        if (handleData->contentType != IOTHUBMESSAGE_STRING)
+        if (handleData->content->contentType != IOTHUBMESSAGE_STRING)
         {
             /*Codes_SRS_IOTHUBMESSAGE_02_017: [IoTHubMessage_GetString shall return NULL if the iotHubMessageHandle does not refer to a IOTHUBMESSAGE of type STRING.] */
             result = NULL;
@@ -375,7 +882,7 @@ const char* IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
         else
         {
             /*Codes_SRS_IOTHUBMESSAGE_02_018: [IoTHubMessage_GetStringData shall return the currently stored null terminated string.] */
-            result = STRING_c_str(handleData->value.string);
+            result = STRING_c_str(handleData->content->value.string);
         }
     }
     return result;
@@ -393,7 +900,7 @@ IOTHUBMESSAGE_CONTENT_TYPE IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE io
     {
         /*Codes_SRS_IOTHUBMESSAGE_02_009: [Otherwise IoTHubMessage_GetContentType shall return the type of the message.] */
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        result = handleData->contentType;
+        result = handleData->content->contentType;
     }
     return result;
 }
@@ -409,9 +916,26 @@ MAP_HANDLE IoTHubMessage_Properties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
     }
     else
     {
-        /*Codes_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.]*/
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
-        result = handleData->properties;
+        /*Codes_SRS_IOTHUBMESSAGE_41_010: [If the properties are shared with a clone, IoTHubMessage_Properties shall first give the message its own copy of the properties, message id and correlation id by calling Map_Clone and mallocAndStrcpy_s, since the returned map can be changed.] */
+        if (make_properties_writable(handleData) != 0)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_011: [If making the copy fails, IoTHubMessage_Properties shall return NULL.] */
+            LogError("unable to copy the shared properties");
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBMESSAGE_41_048: [IoTHubMessage_Properties shall add the pending properties to the map by calling Map_AddOrUpdate for each name and value pair, the first time it is called after IoTHubMessage_SetPendingProperties.] */
+        else if (apply_pending_properties(handleData->properties) != 0)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_049: [If adding a pending property fails, IoTHubMessage_Properties shall return NULL.] */
+            LogError("unable to add the pending properties");
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.]*/
+            result = handleData->properties->map;
+        }
     }
     return result;
 }
@@ -429,7 +953,7 @@ const char* IoTHubMessage_GetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHa
     {
         /* Codes_SRS_IOTHUBMESSAGE_07_017: [IoTHubMessage_GetCorrelationId shall return the correlationId as a const char*.] */
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        result = handleData->correlationId;
+        result = handleData->properties->correlationId;
     }
     return result;
 }
@@ -443,16 +967,23 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHu
         LogError("invalid arg (NULL) passed to IoTHubMessage_SetCorrelationId");
         result = IOTHUB_MESSAGE_INVALID_ARG;
     }
+    /* Codes_SRS_IOTHUBMESSAGE_41_012: [If the properties are shared with a clone, IoTHubMessage_SetCorrelationId shall first give the message its own copy of them.] */
+    else if (make_properties_writable((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle) != 0)
+    {
+        /* Codes_SRS_IOTHUBMESSAGE_41_013: [If making the copy fails, IoTHubMessage_SetCorrelationId shall return IOTHUB_MESSAGE_ERROR.] */
+        LogError("unable to copy the shared properties");
+        result = IOTHUB_MESSAGE_ERROR;
+    }
     else
     {
-        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        IOTHUB_MESSAGE_PROPERTIES* properties = ((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle)->properties;
         /* Codes_SRS_IOTHUBMESSAGE_07_019: [If the IOTHUB_MESSAGE_HANDLE correlationId is not NULL, then the IOTHUB_MESSAGE_HANDLE correlationId will be deallocated.] */
-        if (handleData->correlationId != NULL)
+        if (properties->correlationId != NULL)
         {
-            free(handleData->correlationId);
+            free(properties->correlationId);
         }
 
-        if (mallocAndStrcpy_s(&handleData->correlationId, correlationId) != 0)
+        if (mallocAndStrcpy_s(&properties->correlationId, correlationId) != 0)
         {
             /* Codes_SRS_IOTHUBMESSAGE_07_020: [If the allocation or the copying of the correlationId fails, then IoTHubMessage_SetCorrelationId shall return IOTHUB_MESSAGE_ERROR.] */
             result = IOTHUB_MESSAGE_ERROR;
@@ -475,17 +1006,24 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMes
         LogError("invalid arg (NULL) passed to IoTHubMessage_SetMessageId");
         result = IOTHUB_MESSAGE_INVALID_ARG;
     }
+    /* Codes_SRS_IOTHUBMESSAGE_41_014: [If the properties are shared with a clone, IoTHubMessage_SetMessageId shall first give the message its own copy of them.] */
+    else if (make_properties_writable((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle) != 0)
+    {
+        /* Codes_SRS_IOTHUBMESSAGE_41_015: [If making the copy fails, IoTHubMessage_SetMessageId shall return IOTHUB_MESSAGE_ERROR.] */
+        LogError("unable to copy the shared properties");
+        result = IOTHUB_MESSAGE_ERROR;
+    }
     else
     {
-        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        IOTHUB_MESSAGE_PROPERTIES* properties = ((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle)->properties;
         /* Codes_SRS_IOTHUBMESSAGE_07_013: [If the IOTHUB_MESSAGE_HANDLE messageId is not NULL, then the IOTHUB_MESSAGE_HANDLE messageId will be freed] */
-        if (handleData->messageId != NULL)
+        if (properties->messageId != NULL)
         {
-            free(handleData->messageId);
+            free(properties->messageId);
         }
 
         /* Codes_SRS_IOTHUBMESSAGE_07_014: [If the allocation or the copying of the messageId fails, then IoTHubMessage_SetMessageId shall return IOTHUB_MESSAGE_ERROR.] */
-        if (mallocAndStrcpy_s(&handleData->messageId, messageId) != 0)
+        if (mallocAndStrcpy_s(&properties->messageId, messageId) != 0)
         {
             result = IOTHUB_MESSAGE_ERROR;
         }
@@ -510,7 +1048,151 @@ const char* IoTHubMessage_GetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle
     {
         /* Codes_SRS_IOTHUBMESSAGE_07_011: [IoTHubMessage_MessageId shall return the messageId as a const char*.] */
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        result = handleData->messageId;
+        result = handleData->properties->messageId;
+    }
+    return result;
+}
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetPendingProperties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, char* properties, size_t size)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /* Codes_SRS_IOTHUBMESSAGE_41_046: [If iotHubMessageHandle or properties is NULL, size is 0 or properties does not end with a NUL, IoTHubMessage_SetPendingProperties shall return IOTHUB_MESSAGE_INVALID_ARG.] */
+    if (iotHubMessageHandle == NULL || properties == NULL || size == 0 || properties[size - 1] != '\0')
+    {
+        LogError("invalid arg passed to IoTHubMessage_SetPendingProperties iotHubMessageHandle(%p), properties(%p), size(%lu)", iotHubMessageHandle, properties, (unsigned long)size);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    /* Codes_SRS_IOTHUBMESSAGE_41_050: [If the properties are shared with a clone and making a copy of them fails, or properties pending from a previous call cannot be added to the map, IoTHubMessage_SetPendingProperties shall return IOTHUB_MESSAGE_ERROR and leave properties to the caller.] */
+    else if (make_properties_writable((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle) != 0)
+    {
+        LogError("unable to copy the shared properties");
+        result = IOTHUB_MESSAGE_ERROR;
+    }
+    else if (apply_pending_properties(((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle)->properties) != 0)
+    {
+        LogError("unable to add the previously pending properties");
+        result = IOTHUB_MESSAGE_ERROR;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBMESSAGE_41_047: [IoTHubMessage_SetPendingProperties shall take ownership of properties and keep it without adding it to the map, then return IOTHUB_MESSAGE_OK.] */
+        IOTHUB_MESSAGE_PROPERTIES* messageProperties = ((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle)->properties;
+        messageProperties->pending = properties;
+        messageProperties->pendingSize = size;
+        result = IOTHUB_MESSAGE_OK;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetPriority(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, IOTHUB_MESSAGE_PRIORITY priority)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /* Codes_SRS_IOTHUBMESSAGE_41_004: [if iotHubMessageHandle is NULL or priority is not a IOTHUB_MESSAGE_PRIORITY value then IoTHubMessage_SetPriority shall return a IOTHUB_MESSAGE_INVALID_ARG value.] */
+    if (iotHubMessageHandle == NULL ||
+        (priority != IOTHUB_MESSAGE_PRIORITY_LOW && priority != IOTHUB_MESSAGE_PRIORITY_NORMAL && priority != IOTHUB_MESSAGE_PRIORITY_HIGH))
+    {
+        LogError("invalid arg passed to IoTHubMessage_SetPriority, iotHubMessageHandle=%p, priority=%d", iotHubMessageHandle, (int)priority);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBMESSAGE_41_005: [IoTHubMessage_SetPriority shall store priority in the message and return IOTHUB_MESSAGE_OK.] */
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        handleData->priority = priority;
+        result = IOTHUB_MESSAGE_OK;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_PRIORITY IoTHubMessage_GetPriority(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    IOTHUB_MESSAGE_PRIORITY result;
+    /* Codes_SRS_IOTHUBMESSAGE_41_006: [if the iotHubMessageHandle parameter is NULL then IoTHubMessage_GetPriority shall return IOTHUB_MESSAGE_PRIORITY_NORMAL.] */
+    if (iotHubMessageHandle == NULL)
+    {
+        LogError("invalid arg (NULL) passed to IoTHubMessage_GetPriority");
+        result = IOTHUB_MESSAGE_PRIORITY_NORMAL;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBMESSAGE_41_007: [IoTHubMessage_GetPriority shall return the priority of the message.] */
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        result = handleData->priority;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetCompression(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, IOTHUB_MESSAGE_COMPRESSION compression)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /* Codes_SRS_IOTHUBMESSAGE_41_037: [if iotHubMessageHandle is NULL or compression is not a IOTHUB_MESSAGE_COMPRESSION value then IoTHubMessage_SetCompression shall return a IOTHUB_MESSAGE_INVALID_ARG value.] */
+    if (iotHubMessageHandle == NULL ||
+        (compression != IOTHUB_MESSAGE_COMPRESSION_DEFAULT && compression != IOTHUB_MESSAGE_COMPRESSION_NONE && compression != IOTHUB_MESSAGE_COMPRESSION_GZIP))
+    {
+        LogError("invalid arg passed to IoTHubMessage_SetCompression, iotHubMessageHandle=%p, compression=%d", iotHubMessageHandle, (int)compression);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBMESSAGE_41_038: [IoTHubMessage_SetCompression shall store compression in the message and return IOTHUB_MESSAGE_OK.] */
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        handleData->compression = compression;
+        result = IOTHUB_MESSAGE_OK;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_COMPRESSION IoTHubMessage_GetCompression(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    IOTHUB_MESSAGE_COMPRESSION result;
+    /* Codes_SRS_IOTHUBMESSAGE_41_039: [if the iotHubMessageHandle parameter is NULL then IoTHubMessage_GetCompression shall return IOTHUB_MESSAGE_COMPRESSION_DEFAULT.] */
+    if (iotHubMessageHandle == NULL)
+    {
+        LogError("invalid arg (NULL) passed to IoTHubMessage_GetCompression");
+        result = IOTHUB_MESSAGE_COMPRESSION_DEFAULT;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBMESSAGE_41_040: [IoTHubMessage_GetCompression shall return the compression of the message.] */
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        result = handleData->compression;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetDelivery(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, IOTHUB_MESSAGE_DELIVERY delivery)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /* Codes_SRS_IOTHUBMESSAGE_41_042: [if iotHubMessageHandle is NULL or delivery is not a IOTHUB_MESSAGE_DELIVERY value then IoTHubMessage_SetDelivery shall return a IOTHUB_MESSAGE_INVALID_ARG value.] */
+    if (iotHubMessageHandle == NULL ||
+        (delivery != IOTHUB_MESSAGE_DELIVERY_DEFAULT && delivery != IOTHUB_MESSAGE_DELIVERY_AT_LEAST_ONCE && delivery != IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE))
+    {
+        LogError("invalid arg passed to IoTHubMessage_SetDelivery, iotHubMessageHandle=%p, delivery=%d", iotHubMessageHandle, (int)delivery);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBMESSAGE_41_043: [IoTHubMessage_SetDelivery shall store delivery in the message and return IOTHUB_MESSAGE_OK.] */
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        handleData->delivery = delivery;
+        result = IOTHUB_MESSAGE_OK;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_DELIVERY IoTHubMessage_GetDelivery(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    IOTHUB_MESSAGE_DELIVERY result;
+    /* Codes_SRS_IOTHUBMESSAGE_41_044: [if the iotHubMessageHandle parameter is NULL then IoTHubMessage_GetDelivery shall return IOTHUB_MESSAGE_DELIVERY_DEFAULT.] */
+    if (iotHubMessageHandle == NULL)
+    {
+        LogError("invalid arg (NULL) passed to IoTHubMessage_GetDelivery");
+        result = IOTHUB_MESSAGE_DELIVERY_DEFAULT;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBMESSAGE_41_045: [IoTHubMessage_GetDelivery shall return the delivery of the message.] */
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        result = handleData->delivery;
     }
     return result;
 }
@@ -521,24 +1203,12 @@ void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
     if (iotHubMessageHandle != NULL)
     {
         /*Codes_SRS_IOTHUBMESSAGE_01_003: [IoTHubMessage_Destroy shall free all resources associated with iotHubMessageHandle.]  */
+        /*Codes_SRS_IOTHUBMESSAGE_41_016: [IoTHubMessage_Destroy shall decrement the reference counts of the content and of the properties and free them when they reach zero.] */
+        /*Codes_SRS_IOTHUBMESSAGE_41_022: [When the content of a message created by IoTHubMessage_CreateFromBorrowedBuffer or IoTHubMessage_CreateFromBorrowedSegments is freed, IoTHubMessage_Destroy shall call freeCallback with the buffer of each segment and context, if freeCallback is not NULL.] */
+        /*Codes_SRS_IOTHUBMESSAGE_41_054: [When the content of a message created by IoTHubMessage_CreateFromOwnedBuffer is freed, IoTHubMessage_Destroy shall free buffer.] */
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        if (handleData->contentType == IOTHUBMESSAGE_BYTEARRAY)
-        {
-            BUFFER_delete(handleData->value.byteArray);
-        }
-        else if (handleData->contentType == IOTHUBMESSAGE_STRING)
-        {
-            STRING_delete(handleData->value.string);
-        }
-        else
-        {
-            LogError("Unknown contentType in IoTHubMessage");
-        }
-        Map_Destroy(handleData->properties);
-        free(handleData->messageId);
-        handleData->messageId = NULL;
-        free(handleData->correlationId);
-        handleData->correlationId = NULL;
+        release_content(handleData->content);
+        release_properties(handleData->properties);
         free(handleData);
     }
 }
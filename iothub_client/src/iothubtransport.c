@@ -5,15 +5,35 @@
 #include "azure_c_shared_utility/gballoc.h"
 #include <signal.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothubtransport.h"
 #include "iothub_client.h"
 #include "iothub_client_private.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT
+#include "iothub_client_memory_tag.h"
+
+/*a client worker visits a share of the clients, concurrently with the transport worker thread and the other client workers*/
+typedef struct CLIENT_WORKER_TAG
+{
+    struct TRANSPORT_HANDLE_DATA_TAG* transportData;
+    THREAD_HANDLE threadHandle;
+    /*held while the client worker visits its clients, so that IoTHubTransport_SignalEndWorkerThread can wait for a visit to end*/
+    LOCK_HANDLE visitLockHandle;
+    /*guards readyClients and stop, taken after the readyLockHandle of the transport*/
+    LOCK_HANDLE lockHandle;
+    COND_HANDLE workCondition;
+    VECTOR_HANDLE readyClients;
+    int stop;
+} CLIENT_WORKER;
+
 typedef struct TRANSPORT_HANDLE_DATA_TAG
 {
     TRANSPORT_LL_HANDLE transportLLHandle;
@@ -24,10 +44,20 @@ typedef struct TRANSPORT_HANDLE_DATA_TAG
     VECTOR_HANDLE clients;
     LOCK_HANDLE clientsLockHandle;
     IOTHUB_CLIENT_MULTIPLEXED_DO_WORK clientDoWork;
+    /*the clients that signaled work since the worker thread last visited them. readyLockHandle is always the last lock taken,
+    it also guards the changes of clients so that IoTHubTransport_SignalClientWork can check a client is still on the transport*/
+    VECTOR_HANDLE readyClients;
+    LOCK_HANDLE readyLockHandle;
+    COND_HANDLE workCondition; /*only created when the worker thread is allowed to wait for work*/
+    unsigned int workerMaxIdleTime;
+    /*when set, the clients are visited by the client workers instead of the worker thread*/
+    CLIENT_WORKER* clientWorkers;
+    size_t clientWorkerCount;
 } TRANSPORT_HANDLE_DATA;
 
 /* Used for Unit test */
 const size_t IoTHubTransport_ThreadTerminationOffset = offsetof(TRANSPORT_HANDLE_DATA, stopThread);
+const size_t IoTHubTransport_ClientWorkerTerminationOffset = offsetof(CLIENT_WORKER, stop);
 
 TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
 {
@@ -95,6 +125,17 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
                     free(result);
                     result = NULL;
                 }
+                /*Codes_SRS_IOTHUBTRANSPORT_41_001: [ IoTHubTransport_Create shall create a lock and a list for the clients that have signaled work. ]*/
+                else if ((result->readyLockHandle = Lock_Init()) == NULL)
+                {
+                    /*Codes_SRS_IOTHUBTRANSPORT_41_002: [ If creating any of them fails, IoTHubTransport_Create shall clean up the resources it created and return NULL. ]*/
+                    LogError("ready clients Lock not created.");
+                    Lock_Deinit(result->clientsLockHandle);
+                    Lock_Deinit(result->lockHandle);
+                    transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
+                    free(result);
+                    result = NULL;
+                }
                 else
                 {
                     /*Codes_SRS_IOTHUBTRANSPORT_17_038: [ IoTHubTransport_Create shall call VECTOR_Create to make a list of IOTHUB_CLIENT_HANDLE using this transport. ]*/
@@ -104,6 +145,19 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
                         /*Codes_SRS_IOTHUBTRANSPORT_17_039: [ If the Vector creation fails, IoTHubTransport_Create shall return NULL. ]*/
                         /*Codes_SRS_IOTHUBTRANSPORT_17_009: [ IoTHubTransport_Create shall clean up any resources it creates if the function does not succeed. ]*/
                         LogError("clients list not created.");
+                        Lock_Deinit(result->readyLockHandle);
+                        Lock_Deinit(result->clientsLockHandle);
+                        Lock_Deinit(result->lockHandle);
+                        transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
+                        free(result);
+                        result = NULL;
+                    }
+                    else if ((result->readyClients = VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE))) == NULL)
+                    {
+                        /*Codes_SRS_IOTHUBTRANSPORT_41_002: [ If creating any of them fails, IoTHubTransport_Create shall clean up the resources it created and return NULL. ]*/
+                        LogError("ready clients list not created.");
+                        VECTOR_destroy(result->clients);
+                        Lock_Deinit(result->readyLockHandle);
                         Lock_Deinit(result->clientsLockHandle);
                         Lock_Deinit(result->lockHandle);
                         transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
@@ -114,6 +168,10 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
                     {
                         /*Codes_SRS_IOTHUBTRANSPORT_17_001: [ IoTHubTransport_Create shall return a non-NULL handle on success.]*/
                         result->stopThread = 1;
+                        result->workCondition = NULL;
+                        result->workerMaxIdleTime = 0;
+                        result->clientWorkers = NULL;
+                        result->clientWorkerCount = 0;
                         result->clientDoWork = NULL;
                         result->workerThreadHandle = NULL; /* create thread when work needs to be done */
                         result->IoTHubTransport_GetHostname = transportProtocol->IoTHubTransport_GetHostname;
@@ -127,6 +185,9 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
                         result->IoTHubTransport_DoWork = transportProtocol->IoTHubTransport_DoWork;
                         result->IoTHubTransport_SetRetryPolicy = transportProtocol->IoTHubTransport_SetRetryPolicy;
                         result->IoTHubTransport_GetSendStatus = transportProtocol->IoTHubTransport_GetSendStatus;
+                        result->IoTHubTransport_GetNextWorkDeadline = transportProtocol->IoTHubTransport_GetNextWorkDeadline;
+                        result->IoTHubTransport_GetPollDescriptors = transportProtocol->IoTHubTransport_GetPollDescriptors;
+                        result->IoTHubTransport_TrimMemory = transportProtocol->IoTHubTransport_TrimMemory;
                     }
                 }
             }
@@ -136,6 +197,33 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
     return result;
 }
 
+/*this function is called with the clients lock taken, which keeps the clients it returns on the transport*/
+static VECTOR_HANDLE take_ready_clients(TRANSPORT_HANDLE_DATA* transportData)
+{
+    VECTOR_HANDLE result;
+
+    if (Lock(transportData->readyLockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for take_ready_clients");
+        result = NULL;
+    }
+    else
+    {
+        if (VECTOR_size(transportData->readyClients) == 0)
+        {
+            result = NULL;
+        }
+        else if ((result = VECTOR_move(transportData->readyClients)) == NULL)
+        {
+            LogError("VECTOR_move failed");
+        }
+
+        (void)Unlock(transportData->readyLockHandle);
+    }
+
+    return result;
+}
+
 static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
 {
     if (Lock(transportData->clientsLockHandle) != LOCK_OK)
@@ -144,18 +232,25 @@ static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
     }
     else
     {
-        size_t numberOfClients;
-        size_t iterator;
-
-        numberOfClients = VECTOR_size(transportData->clients);
-        for (iterator = 0; iterator < numberOfClients; iterator++)
+        /*Codes_SRS_IOTHUBTRANSPORT_41_006: [ After the lower layer transport DoWork the thread shall call the client DoWork of the clients that signaled work since the last time, once each, and only of those. ]*/
+        VECTOR_HANDLE readyClients = take_ready_clients(transportData);
+        if (readyClients != NULL)
         {
-            IOTHUB_CLIENT_HANDLE* clientHandle = (IOTHUB_CLIENT_HANDLE*)VECTOR_element(transportData->clients, iterator);
+            size_t numberOfClients;
+            size_t iterator;
 
-            if (clientHandle != NULL)
+            numberOfClients = VECTOR_size(readyClients);
+            for (iterator = 0; iterator < numberOfClients; iterator++)
             {
-                transportData->clientDoWork(*clientHandle);
+                IOTHUB_CLIENT_HANDLE* clientHandle = (IOTHUB_CLIENT_HANDLE*)VECTOR_element(readyClients, iterator);
+
+                if (clientHandle != NULL)
+                {
+                    transportData->clientDoWork(*clientHandle);
+                }
             }
+
+            VECTOR_destroy(readyClients);
         }
 
         if (Unlock(transportData->clientsLockHandle) != LOCK_OK)
@@ -165,6 +260,51 @@ static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
     }
 }
 
+static bool has_ready_clients(TRANSPORT_HANDLE_DATA* transportData)
+{
+    bool result;
+
+    if (Lock(transportData->readyLockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for has_ready_clients");
+        result = true;
+    }
+    else
+    {
+        result = (VECTOR_size(transportData->readyClients) != 0);
+        (void)Unlock(transportData->readyLockHandle);
+    }
+
+    return result;
+}
+
+static void wait_for_work(TRANSPORT_HANDLE_DATA* transportData)
+{
+    bool waited = false;
+
+    if ((transportData->workerMaxIdleTime != 0) && (Lock(transportData->lockHandle) == LOCK_OK))
+    {
+        if ((transportData->stopThread == 0) && !has_ready_clients(transportData))
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_41_008: [ When a worker max idle time was set and no client has signaled work, the thread shall wait on a condition for at most the worker max idle time before calling lower layer transport DoWork again. ]*/
+            /*the underlying XIOs do not expose readiness, so the max idle time bounds the latency of incoming data and of transport timers (keepalive, SAS token refresh)*/
+            COND_RESULT wait_result = Condition_Wait(transportData->workCondition, transportData->lockHandle, (int)transportData->workerMaxIdleTime);
+            if ((wait_result != COND_OK) && (wait_result != COND_TIMEOUT))
+            {
+                LogError("Condition_Wait failed");
+            }
+            waited = true;
+        }
+        (void)Unlock(transportData->lockHandle);
+    }
+
+    if (!waited)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]*/
+        ThreadAPI_Sleep(1);
+    }
+}
+
 static int transport_worker_thread(void* threadArgument)
 {
     TRANSPORT_HANDLE_DATA* transportData = (TRANSPORT_HANDLE_DATA*)threadArgument;
@@ -191,8 +331,7 @@ static int transport_worker_thread(void* threadArgument)
 
         multiplexed_client_do_work(transportData);
 
-        /*Codes_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]*/
-        ThreadAPI_Sleep(1);
+        wait_for_work(transportData);
     }
 
     return 0;
@@ -206,6 +345,261 @@ static bool find_by_handle(const void* element, const void* value)
     return (*guess == match);
 }
 
+static CLIENT_WORKER* get_client_worker(TRANSPORT_HANDLE_DATA* transportData, IOTHUB_CLIENT_HANDLE clientHandle)
+{
+    CLIENT_WORKER* result;
+
+    if (transportData->clientWorkerCount == 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        /*the low bits of a heap address are all alike, they are mixed with the high ones before picking the client worker*/
+        uint64_t hash = (uint64_t)(uintptr_t)clientHandle;
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 33;
+        result = &transportData->clientWorkers[hash % transportData->clientWorkerCount];
+    }
+
+    return result;
+}
+
+/*returns false once the client worker is told to stop*/
+static bool wait_for_client_work(CLIENT_WORKER* clientWorker)
+{
+    bool result;
+
+    if (Lock(clientWorker->lockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for wait_for_client_work");
+        result = true;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_41_018: [ A client worker shall wait until one of its clients signals work, then call the client DoWork of the clients that signaled work, once each, while holding its visit lock. ]*/
+        while ((clientWorker->stop == 0) && (VECTOR_size(clientWorker->readyClients) == 0))
+        {
+            if (Condition_Wait(clientWorker->workCondition, clientWorker->lockHandle, 0) != COND_OK)
+            {
+                LogError("Condition_Wait failed");
+                break;
+            }
+        }
+        result = (clientWorker->stop == 0);
+        (void)Unlock(clientWorker->lockHandle);
+    }
+
+    return result;
+}
+
+static VECTOR_HANDLE take_client_worker_ready_clients(CLIENT_WORKER* clientWorker)
+{
+    VECTOR_HANDLE result;
+
+    if (Lock(clientWorker->lockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for take_client_worker_ready_clients");
+        result = NULL;
+    }
+    else
+    {
+        if (VECTOR_size(clientWorker->readyClients) == 0)
+        {
+            result = NULL;
+        }
+        else if ((result = VECTOR_move(clientWorker->readyClients)) == NULL)
+        {
+            LogError("VECTOR_move failed");
+        }
+
+        (void)Unlock(clientWorker->lockHandle);
+    }
+
+    return result;
+}
+
+static int client_worker_thread(void* threadArgument)
+{
+    CLIENT_WORKER* clientWorker = (CLIENT_WORKER*)threadArgument;
+    TRANSPORT_HANDLE_DATA* transportData = clientWorker->transportData;
+
+    while (wait_for_client_work(clientWorker))
+    {
+        if (Lock(clientWorker->visitLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock for client_worker_thread");
+        }
+        else
+        {
+            /*the clients are taken with the visit lock held, IoTHubTransport_SignalEndWorkerThread either removes a client before or waits for its visit to end*/
+            VECTOR_HANDLE readyClients = take_client_worker_ready_clients(clientWorker);
+            if (readyClients != NULL)
+            {
+                size_t numberOfClients = VECTOR_size(readyClients);
+                size_t iterator;
+
+                for (iterator = 0; iterator < numberOfClients; iterator++)
+                {
+                    IOTHUB_CLIENT_HANDLE* clientHandle = (IOTHUB_CLIENT_HANDLE*)VECTOR_element(readyClients, iterator);
+
+                    if (clientHandle != NULL)
+                    {
+                        transportData->clientDoWork(*clientHandle);
+                    }
+                }
+
+                VECTOR_destroy(readyClients);
+            }
+
+            (void)Unlock(clientWorker->visitLockHandle);
+        }
+
+        /*Codes_SRS_IOTHUBTRANSPORT_41_019: [ After a visit the client worker shall wake up the worker thread if it is waiting for work, so that what the clients queued is sent, then sleep 1 ms. ]*/
+        if (transportData->workCondition != NULL)
+        {
+            (void)Condition_Post(transportData->workCondition);
+        }
+        /*a client that stays busy signals work again on every visit, this paces it like the worker thread*/
+        ThreadAPI_Sleep(1);
+    }
+
+    return 0;
+}
+
+static int create_client_worker(TRANSPORT_HANDLE_DATA* transportData, CLIENT_WORKER* clientWorker)
+{
+    int result;
+
+    clientWorker->transportData = transportData;
+    clientWorker->stop = 0;
+
+    if ((clientWorker->visitLockHandle = Lock_Init()) == NULL)
+    {
+        LogError("client worker visit Lock not created.");
+        result = __FAILURE__;
+    }
+    else if ((clientWorker->lockHandle = Lock_Init()) == NULL)
+    {
+        LogError("client worker Lock not created.");
+        (void)Lock_Deinit(clientWorker->visitLockHandle);
+        result = __FAILURE__;
+    }
+    else if ((clientWorker->workCondition = Condition_Init()) == NULL)
+    {
+        LogError("client worker condition not created.");
+        (void)Lock_Deinit(clientWorker->lockHandle);
+        (void)Lock_Deinit(clientWorker->visitLockHandle);
+        result = __FAILURE__;
+    }
+    else if ((clientWorker->readyClients = VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE))) == NULL)
+    {
+        LogError("client worker ready clients list not created.");
+        Condition_Deinit(clientWorker->workCondition);
+        (void)Lock_Deinit(clientWorker->lockHandle);
+        (void)Lock_Deinit(clientWorker->visitLockHandle);
+        result = __FAILURE__;
+    }
+    else if (ThreadAPI_Create(&clientWorker->threadHandle, client_worker_thread, clientWorker) != THREADAPI_OK)
+    {
+        LogError("client worker thread not created.");
+        VECTOR_destroy(clientWorker->readyClients);
+        Condition_Deinit(clientWorker->workCondition);
+        (void)Lock_Deinit(clientWorker->lockHandle);
+        (void)Lock_Deinit(clientWorker->visitLockHandle);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void destroy_client_workers(CLIENT_WORKER* clientWorkers, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (Lock(clientWorkers[i].lockHandle) != LOCK_OK)
+        {
+            LogError("Unable to lock - will still attempt to end the client worker without thread safety");
+            clientWorkers[i].stop = 1;
+            (void)Condition_Post(clientWorkers[i].workCondition);
+        }
+        else
+        {
+            clientWorkers[i].stop = 1;
+            (void)Condition_Post(clientWorkers[i].workCondition);
+            (void)Unlock(clientWorkers[i].lockHandle);
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        int res;
+        if (ThreadAPI_Join(clientWorkers[i].threadHandle, &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed");
+        }
+        VECTOR_destroy(clientWorkers[i].readyClients);
+        Condition_Deinit(clientWorkers[i].workCondition);
+        (void)Lock_Deinit(clientWorkers[i].lockHandle);
+        (void)Lock_Deinit(clientWorkers[i].visitLockHandle);
+    }
+}
+
+/*called with the readyLockHandle of the transport taken*/
+static void add_client_worker_ready_client(CLIENT_WORKER* clientWorker, IOTHUB_CLIENT_HANDLE clientHandle)
+{
+    if (Lock(clientWorker->lockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for add_client_worker_ready_client");
+    }
+    else
+    {
+        if ((VECTOR_find_if(clientWorker->readyClients, find_by_handle, clientHandle) == NULL) &&
+            (VECTOR_push_back(clientWorker->readyClients, &clientHandle, 1) != 0))
+        {
+            LogError("Failed adding client to the ready clients of its client worker (VECTOR_push_back failed)");
+        }
+        else if (Condition_Post(clientWorker->workCondition) != COND_OK)
+        {
+            LogError("unable to Condition_Post");
+        }
+        (void)Unlock(clientWorker->lockHandle);
+    }
+}
+
+/*called with the readyLockHandle of the transport taken*/
+static void remove_ready_client(TRANSPORT_HANDLE_DATA* transportData, CLIENT_WORKER* clientWorker, IOTHUB_CLIENT_HANDLE clientHandle)
+{
+    if (clientWorker == NULL)
+    {
+        void* readyElement = VECTOR_find_if(transportData->readyClients, find_by_handle, clientHandle);
+        if (readyElement != NULL)
+        {
+            VECTOR_erase(transportData->readyClients, readyElement, 1);
+        }
+    }
+    else if (Lock(clientWorker->lockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for remove_ready_client");
+    }
+    else
+    {
+        void* readyElement = VECTOR_find_if(clientWorker->readyClients, find_by_handle, clientHandle);
+        if (readyElement != NULL)
+        {
+            VECTOR_erase(clientWorker->readyClients, readyElement, 1);
+        }
+        (void)Unlock(clientWorker->lockHandle);
+    }
+}
+
 static IOTHUB_CLIENT_RESULT start_worker_if_needed(TRANSPORT_HANDLE_DATA * transportData, IOTHUB_CLIENT_HANDLE clientHandle)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -231,16 +625,25 @@ static IOTHUB_CLIENT_RESULT start_worker_if_needed(TRANSPORT_HANDLE_DATA * trans
             bool addToList = ((VECTOR_size(transportData->clients) == 0) || (VECTOR_find_if(transportData->clients, find_by_handle, clientHandle) == NULL));
             if (addToList)
             {
-                /*Codes_SRS_IOTHUBTRANSPORT_17_021: [ If handle is not found, then clientHandle shall be added to the list. ]*/
-                if (VECTOR_push_back(transportData->clients, &clientHandle, 1) != 0)
+                if (Lock(transportData->readyLockHandle) != LOCK_OK)
                 {
-                    LogError("Failed adding device to list (VECTOR_push_back failed)");
-                    /*Codes_SRS_IOTHUBTRANSPORT_17_042: [ If Adding to the client list fails, IoTHubTransport_StartWorkerThread shall return IOTHUB_CLIENT_ERROR. ]*/
+                    LogError("failed to lock the ready clients for start_worker_if_needed");
                     result = IOTHUB_CLIENT_ERROR;
                 }
                 else
                 {
-                    result = IOTHUB_CLIENT_OK;
+                    /*Codes_SRS_IOTHUBTRANSPORT_17_021: [ If handle is not found, then clientHandle shall be added to the list. ]*/
+                    if (VECTOR_push_back(transportData->clients, &clientHandle, 1) != 0)
+                    {
+                        LogError("Failed adding device to list (VECTOR_push_back failed)");
+                        /*Codes_SRS_IOTHUBTRANSPORT_17_042: [ If Adding to the client list fails, IoTHubTransport_StartWorkerThread shall return IOTHUB_CLIENT_ERROR. ]*/
+                        result = IOTHUB_CLIENT_ERROR;
+                    }
+                    else
+                    {
+                        result = IOTHUB_CLIENT_OK;
+                    }
+                    (void)Unlock(transportData->readyLockHandle);
                 }
             }
             else
@@ -265,6 +668,14 @@ static void stop_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
 {
     /*Codes_SRS_IOTHUBTRANSPORT_17_043: [** IoTHubTransport_SignalEndWorkerThread shall signal the worker thread to end.*/
     transportData->stopThread = 1;
+    if (transportData->workCondition != NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_41_009: [ Signaling the worker thread to end shall wake it up if it is waiting for work. ]*/
+        if (Condition_Post(transportData->workCondition) != COND_OK)
+        {
+            LogError("unable to Condition_Post");
+        }
+    }
 }
 
 static void wait_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
@@ -298,8 +709,33 @@ static bool signal_end_worker_thread(TRANSPORT_HANDLE_DATA * transportData, IOTH
         void* element = VECTOR_find_if(transportData->clients, find_by_handle, clientHandle);
         if (element != NULL)
         {
-            /*Codes_SRS_IOTHUBTRANSPORT_17_026: [ IoTHubTransport_EndWorkerThread shall remove clientHandlehandle from handle list. ]*/
-            VECTOR_erase(transportData->clients, element, 1);
+            CLIENT_WORKER* clientWorker = get_client_worker(transportData, clientHandle);
+
+            /*Codes_SRS_IOTHUBTRANSPORT_41_020: [ When client workers were set, IoTHubTransport_SignalEndWorkerThread shall wait for the client worker of clientHandle to end its visit before removing clientHandle. ]*/
+            if ((clientWorker != NULL) && (Lock(clientWorker->visitLockHandle) != LOCK_OK))
+            {
+                LogError("failed to lock the client worker for signal_end_worker_thread");
+            }
+            else
+            {
+                if (Lock(transportData->readyLockHandle) != LOCK_OK)
+                {
+                    LogError("failed to lock the ready clients for signal_end_worker_thread");
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBTRANSPORT_17_026: [ IoTHubTransport_EndWorkerThread shall remove clientHandlehandle from handle list. ]*/
+                    VECTOR_erase(transportData->clients, element, 1);
+                    /*Codes_SRS_IOTHUBTRANSPORT_41_007: [ IoTHubTransport_SignalEndWorkerThread shall also remove clientHandle from the clients that signaled work. ]*/
+                    remove_ready_client(transportData, clientWorker, clientHandle);
+                    (void)Unlock(transportData->readyLockHandle);
+                }
+
+                if (clientWorker != NULL)
+                {
+                    (void)Unlock(clientWorker->visitLockHandle);
+                }
+            }
         }
         /*Codes_SRS_IOTHUBTRANSPORT_17_025: [ If the worker thread does not exist, then IoTHubTransport_EndWorkerThread shall return. ]*/
         if (transportData->workerThreadHandle != NULL)
@@ -345,11 +781,23 @@ void IoTHubTransport_Destroy(TRANSPORT_HANDLE transportHandle)
             (void)Unlock(transportData->lockHandle);
         }
         wait_worker_thread(transportData);
+        if (transportData->clientWorkers != NULL)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_41_021: [ IoTHubTransport_Destroy shall stop, join and free the client workers. ]*/
+            destroy_client_workers(transportData->clientWorkers, transportData->clientWorkerCount);
+            free(transportData->clientWorkers);
+        }
         /*Codes_SRS_IOTHUBTRANSPORT_17_010: [ IoTHubTransport_Destroy shall free all resources. ]*/
         Lock_Deinit(transportData->lockHandle);
         (transportData->IoTHubTransport_Destroy)(transportData->transportLLHandle);
         VECTOR_destroy(transportData->clients);
         Lock_Deinit(transportData->clientsLockHandle);
+        VECTOR_destroy(transportData->readyClients);
+        Lock_Deinit(transportData->readyLockHandle);
+        if (transportData->workCondition != NULL)
+        {
+            Condition_Deinit(transportData->workCondition);
+        }
         free(transportHandle);
     }
 }
@@ -448,3 +896,170 @@ void IoTHubTransport_JoinWorkerThread(TRANSPORT_HANDLE transportHandle, IOTHUB_C
         wait_worker_thread(transportData);
     }
 }
+
+void IoTHubTransport_SignalClientWork(TRANSPORT_HANDLE transportHandle, IOTHUB_CLIENT_HANDLE clientHandle)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_41_003: [ If transportHandle or clientHandle is NULL, IoTHubTransport_SignalClientWork shall do nothing. ]*/
+    if ((transportHandle == NULL) || (clientHandle == NULL))
+    {
+        LogError("invalid argument transportHandle(%p), clientHandle(%p)", transportHandle, clientHandle);
+    }
+    else
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+
+        if (Lock(transportData->readyLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock for IoTHubTransport_SignalClientWork");
+        }
+        else
+        {
+            CLIENT_WORKER* clientWorker = get_client_worker(transportData, clientHandle);
+
+            /*Codes_SRS_IOTHUBTRANSPORT_41_004: [ IoTHubTransport_SignalClientWork shall add clientHandle, once, to the clients that signaled work if clientHandle started the worker thread and did not signal it to end. ]*/
+            /*a client being destroyed can still queue callbacks after IoTHubTransport_SignalEndWorkerThread, it shall not come back to the worker thread*/
+            if (VECTOR_find_if(transportData->clients, find_by_handle, clientHandle) != NULL)
+            {
+                if (clientWorker != NULL)
+                {
+                    /*Codes_SRS_IOTHUBTRANSPORT_41_017: [ When client workers were set, IoTHubTransport_SignalClientWork shall add clientHandle, once, to the clients that signaled work of the client worker picked by hashing clientHandle and wake that client worker up. ]*/
+                    add_client_worker_ready_client(clientWorker, clientHandle);
+                }
+                else if ((VECTOR_find_if(transportData->readyClients, find_by_handle, clientHandle) == NULL) &&
+                    (VECTOR_push_back(transportData->readyClients, &clientHandle, 1) != 0))
+                {
+                    LogError("Failed adding client to the ready clients (VECTOR_push_back failed)");
+                }
+            }
+            (void)Unlock(transportData->readyLockHandle);
+
+            /*the client workers wake up the worker thread once they visited the client*/
+            if ((clientWorker == NULL) && (transportData->workCondition != NULL))
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_41_005: [ IoTHubTransport_SignalClientWork shall wake up the worker thread if it is waiting for work. ]*/
+                if (Condition_Post(transportData->workCondition) != COND_OK)
+                {
+                    LogError("unable to Condition_Post");
+                }
+            }
+        }
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubTransport_SetWorkerMaxIdleTime(TRANSPORT_HANDLE transportHandle, unsigned int maxIdleTime)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBTRANSPORT_41_010: [ If transportHandle is NULL, IoTHubTransport_SetWorkerMaxIdleTime shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (transportHandle == NULL)
+    {
+        LogError("invalid argument transportHandle(NULL)");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+
+        if (Lock(transportData->lockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_41_011: [ If taking the transport lock or creating the condition fails, IoTHubTransport_SetWorkerMaxIdleTime shall return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("unable to Lock");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            if ((maxIdleTime != 0) && (transportData->workCondition == NULL) &&
+                ((transportData->workCondition = Condition_Init()) == NULL))
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_41_011: [ If taking the transport lock or creating the condition fails, IoTHubTransport_SetWorkerMaxIdleTime shall return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("unable to Condition_Init");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_41_012: [ IoTHubTransport_SetWorkerMaxIdleTime shall create (once) the condition the worker thread waits on, store maxIdleTime, 0 going back to calling lower layer transport DoWork every 1 ms, and return IOTHUB_CLIENT_OK. ]*/
+                transportData->workerMaxIdleTime = maxIdleTime;
+                if (transportData->workCondition != NULL)
+                {
+                    (void)Condition_Post(transportData->workCondition);
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+            (void)Unlock(transportData->lockHandle);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubTransport_SetClientWorkerCount(TRANSPORT_HANDLE transportHandle, size_t clientWorkerCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBTRANSPORT_41_013: [ If transportHandle is NULL or clientWorkerCount is 0, IoTHubTransport_SetClientWorkerCount shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((transportHandle == NULL) || (clientWorkerCount == 0))
+    {
+        LogError("invalid argument transportHandle(%p), clientWorkerCount(%lu)", transportHandle, (unsigned long)clientWorkerCount);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+
+        if (Lock(transportData->clientsLockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_41_014: [ If taking the clients lock fails, the client workers were already set or a client already started the worker thread, IoTHubTransport_SetClientWorkerCount shall return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("unable to Lock");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            /*a client maps to its client worker by hashing, the count cannot change while clients use the transport*/
+            if ((transportData->clientWorkers != NULL) || (VECTOR_size(transportData->clients) != 0))
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_41_014: [ If taking the clients lock fails, the client workers were already set or a client already started the worker thread, IoTHubTransport_SetClientWorkerCount shall return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("the client workers can only be set once, before any client uses the transport");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if ((clientWorkerCount > SIZE_MAX / sizeof(CLIENT_WORKER)) ||
+                ((transportData->clientWorkers = (CLIENT_WORKER*)malloc(clientWorkerCount * sizeof(CLIENT_WORKER))) == NULL))
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_41_016: [ If creating any of them fails, IoTHubTransport_SetClientWorkerCount shall stop and free the client workers it created and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("unable to malloc %lu client workers", (unsigned long)clientWorkerCount);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                size_t i;
+
+                /*Codes_SRS_IOTHUBTRANSPORT_41_015: [ IoTHubTransport_SetClientWorkerCount shall start clientWorkerCount client worker threads, each with its own locks, condition and list of clients that signaled work, and return IOTHUB_CLIENT_OK. ]*/
+                for (i = 0; i < clientWorkerCount; i++)
+                {
+                    if (create_client_worker(transportData, &transportData->clientWorkers[i]) != 0)
+                    {
+                        LogError("unable to create client worker %lu", (unsigned long)i);
+                        break;
+                    }
+                }
+
+                if (i < clientWorkerCount)
+                {
+                    /*Codes_SRS_IOTHUBTRANSPORT_41_016: [ If creating any of them fails, IoTHubTransport_SetClientWorkerCount shall stop and free the client workers it created and return IOTHUB_CLIENT_ERROR. ]*/
+                    destroy_client_workers(transportData->clientWorkers, i);
+                    free(transportData->clientWorkers);
+                    transportData->clientWorkers = NULL;
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    transportData->clientWorkerCount = clientWorkerCount;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+
+            (void)Unlock(transportData->clientsLockHandle);
+        }
+    }
+
+    return result;
+}
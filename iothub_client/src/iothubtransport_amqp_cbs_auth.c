@@ -8,6 +8,10 @@
 #include "azure_c_shared_utility/agenttime.h" 
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/sastoken.h"
+#include "iothub_client_trace.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP
+#include "iothub_client_memory_tag.h"
 
 #define RESULT_OK                                 0
 #define INDEFINITE_TIME                           ((time_t)(-1))
@@ -20,7 +24,8 @@
 typedef struct AUTHENTICATION_INSTANCE_TAG 
 {
     const char* device_id;
-    STRING_HANDLE iothub_host_fqdn;
+    // The FQDN of the transport, shared by all its devices
+    const char* iothub_host_fqdn;
     
     ON_AUTHENTICATION_STATE_CHANGED_CALLBACK on_state_changed_callback;
     void* on_state_changed_callback_context;
@@ -31,12 +36,17 @@ typedef struct AUTHENTICATION_INSTANCE_TAG
     size_t cbs_request_timeout_secs;
     size_t sas_token_lifetime_secs;
     size_t sas_token_refresh_time_secs;
+    size_t sas_token_refresh_window_secs;
+    // Seconds after `current_sas_token_put_time` at which the SAS token is refreshed, worked out whenever the refresh time or window are set
+    size_t sas_token_refresh_due_secs;
 
     AUTHENTICATION_STATE state;
     CBS_HANDLE cbs_handle;
 
     bool is_cbs_put_token_in_progress;
     bool is_sas_token_refresh_in_progress;
+    // Only the SAS tokens created from the device keys get refreshed; set when the token is put to CBS
+    bool is_sas_token_refresh_scheduled;
 
     time_t current_sas_token_put_time;
 
@@ -124,6 +134,36 @@ static int verify_cbs_put_token_timeout(AUTHENTICATION_INSTANCE* instance, bool*
     return result;
 }
 
+// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_001: [If `instance->sas_token_refresh_window_secs` is not 0, the SAS token shall be refreshed earlier than `instance->sas_token_refresh_time_secs` by an offset less than that window, derived from the device id]
+// Devices registered at the same time would otherwise refresh their SAS tokens in the same second.
+// Each device refreshes earlier by an offset within `sas_token_refresh_window_secs`, derived from its device id
+// so the devices of a transport are spread evenly across the window (and keep their place on every refresh).
+static size_t get_sas_token_refresh_time_secs(AUTHENTICATION_INSTANCE* instance)
+{
+    size_t result;
+
+    if (instance->sas_token_refresh_window_secs == 0 || instance->sas_token_refresh_time_secs == 0)
+    {
+        result = instance->sas_token_refresh_time_secs;
+    }
+    else
+    {
+        size_t window_secs = (instance->sas_token_refresh_window_secs < instance->sas_token_refresh_time_secs ? instance->sas_token_refresh_window_secs : instance->sas_token_refresh_time_secs);
+        size_t hash = 2166136261u;
+        const char* device_id = instance->device_id;
+
+        while (*device_id != '\0')
+        {
+            hash = (hash ^ (unsigned char)*device_id) * 16777619u;
+            device_id++;
+        }
+
+        result = instance->sas_token_refresh_time_secs - (hash % window_secs);
+    }
+
+    return result;
+}
+
 static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, bool* is_timed_out)
 {
     int result;
@@ -142,7 +182,7 @@ static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, b
             result = __FAILURE__;
             LogError("Failed verifying if SAS token refresh timed out (get_time failed)");
         }
-        else if ((uint32_t)get_difftime(current_time, instance->current_sas_token_put_time) >= instance->sas_token_refresh_time_secs)
+        else if ((uint32_t)get_difftime(current_time, instance->current_sas_token_put_time) >= instance->sas_token_refresh_due_secs)
         {
             *is_timed_out = true;
             result = RESULT_OK;
@@ -157,10 +197,10 @@ static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, b
     return result;
 }
 
-static STRING_HANDLE create_devices_path(STRING_HANDLE iothub_host_fqdn, const char* device_id)
+static STRING_HANDLE create_devices_path(const char* iothub_host_fqdn, const char* device_id)
 {
     STRING_HANDLE devices_path;
-    if ((devices_path = STRING_construct_sprintf(IOTHUB_DEVICES_PATH_FMT, STRING_c_str(iothub_host_fqdn), device_id)) == NULL)
+    if ((devices_path = STRING_construct_sprintf(IOTHUB_DEVICES_PATH_FMT, iothub_host_fqdn, device_id)) == NULL)
     {
         LogError("Failed creating devices_path (STRING_new failed)");
     }
@@ -175,6 +215,9 @@ static void on_cbs_put_token_complete_callback(void* context, CBS_OPERATION_RESU
 #endif
     AUTHENTICATION_INSTANCE* instance = (AUTHENTICATION_INSTANCE*)context;
 
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_006: [on_cbs_put_token_complete_callback shall emit IOTHUB_CLIENT_TRACE_EVENT_CBS_PUT_TOKEN_COMPLETE with `instance` and `status_code`]
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CBS_PUT_TOKEN_COMPLETE, instance, status_code);
+
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_095: [`instance->is_sas_token_refresh_in_progress` and `instance->is_cbs_put_token_in_progress` shall be set to FALSE]
     instance->is_cbs_put_token_in_progress = false;
 
@@ -241,6 +284,9 @@ static int put_SAS_token_to_cbs(AUTHENTICATION_INSTANCE* instance, STRING_HANDLE
 
         instance->current_sas_token_put_time = current_time; // If it failed, fear not. `current_sas_token_put_time` shall be checked for INDEFINITE_TIME wherever it is used.
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_005: [If cbs_put_token() succeeds, IOTHUB_CLIENT_TRACE_EVENT_CBS_PUT_TOKEN shall be emitted with `instance` and 0]
+        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CBS_PUT_TOKEN, instance, 0);
+
         result = RESULT_OK;
     }
 
@@ -265,6 +311,10 @@ static int create_and_put_SAS_token_to_cbs(AUTHENTICATION_INSTANCE* instance)
     {
         /* Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_07_001: [ authentication_do_work() shall determine what credential type is used SAS_TOKEN or DEVICE_KEY by calling IoTHubClient_Auth_Get_Credential_Type ] */
         IOTHUB_CREDENTIAL_TYPE cred_type = IoTHubClient_Auth_Get_Credential_Type(instance->authorization_module);
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_004: [authentication_do_work() shall schedule the SAS token refresh only if the SAS token was created from the device keys, so later calls do not query the credential type]
+        instance->is_sas_token_refresh_scheduled = (cred_type == IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+
         if (cred_type == IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY)
         {
             double seconds_since_epoch;
@@ -378,6 +428,7 @@ static void* authentication_clone_option(const char* name, const void* value)
     {
         if (strcmp(AUTHENTICATION_OPTION_CBS_REQUEST_TIMEOUT_SECS, name) == 0 ||
             strcmp(AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, name) == 0 ||
+            strcmp(AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, name) == 0 ||
             strcmp(AUTHENTICATION_OPTION_SAS_TOKEN_LIFETIME_SECS, name) == 0 ||
             strcmp(AUTHENTICATION_OPTION_SAVED_OPTIONS, name) == 0)
         {
@@ -507,10 +558,6 @@ void authentication_destroy(AUTHENTICATION_HANDLE authentication_handle)
         {
             (void)authentication_stop(authentication_handle);
         }
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_108: [authentication_destroy() shall destroy all resouces used by this module]
-        if (instance->iothub_host_fqdn != NULL)
-            STRING_delete(instance->iothub_host_fqdn);
-
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_108: [authentication_destroy() shall destroy all resouces used by this module]
         free(instance);
     }
@@ -566,15 +613,11 @@ AUTHENTICATION_HANDLE authentication_create(const AUTHENTICATION_CONFIG* config)
                 result = NULL;
                 LogError("authentication_create failed (config->device_id could not be copied; STRING_construct failed)");
             }
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_016: [If provided, authentication_create() shall save a copy of `config->iothub_host_fqdn` into `instance->iothub_host_fqdn`]
-            else if ((instance->iothub_host_fqdn = STRING_construct(config->iothub_host_fqdn)) == NULL)
-            {
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_017: [If STRING_clone() fails to copy `config->iothub_host_fqdn`, authentication_create() shall fail and return NULL]
-                result = NULL;
-                LogError("authentication_create failed (config->iothub_host_fqdn could not be copied; STRING_construct failed)");
-            }
             else
             {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_007: [authentication_create() shall keep `config->iothub_host_fqdn` in `instance->iothub_host_fqdn` without copying it, the FQDN belongs to the transport and outlives its devices]
+                instance->iothub_host_fqdn = config->iothub_host_fqdn;
+
                 instance->state = AUTHENTICATION_STATE_STOPPED;
 
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_018: [authentication_create() shall save `config->on_state_changed_callback` and `config->on_state_changed_callback_context` into `instance->on_state_changed_callback` and `instance->on_state_changed_callback_context`.]
@@ -593,6 +636,7 @@ AUTHENTICATION_HANDLE authentication_create(const AUTHENTICATION_CONFIG* config)
                 instance->sas_token_refresh_time_secs = DEFAULT_SAS_TOKEN_REFRESH_TIME_SECS;
 
                 instance->authorization_module = config->authorization_module;
+                instance->sas_token_refresh_due_secs = get_sas_token_refresh_time_secs(instance);
 
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_024: [If no failure occurs, authentication_create() shall return a reference to the AUTHENTICATION_INSTANCE handle]
                 result = (AUTHENTICATION_HANDLE)instance;
@@ -652,7 +696,7 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
         else if (instance->state == AUTHENTICATION_STATE_STARTED)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_040: [If `instance->state` is AUTHENTICATION_STATE_STARTED and user-provided SAS token was used, authentication_do_work() shall return]
-            if (IoTHubClient_Auth_Get_Credential_Type(instance->authorization_module) == IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY)
+            if (instance->is_sas_token_refresh_scheduled)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_039: [If `instance->state` is AUTHENTICATION_STATE_STARTED and device keys were used, authentication_do_work() shall only verify the SAS token refresh time]
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_065: [The SAS token shall be refreshed if the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs`]
@@ -736,6 +780,14 @@ int authentication_set_option(AUTHENTICATION_HANDLE authentication_handle, const
         else if (strcmp(AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, name) == 0)
         {
             instance->sas_token_refresh_time_secs = *((size_t*)value);
+            instance->sas_token_refresh_due_secs = get_sas_token_refresh_time_secs(instance);
+            result = RESULT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_002: [If name matches AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, `value` shall be saved on `instance->sas_token_refresh_window_secs`]
+        else if (strcmp(AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, name) == 0)
+        {
+            instance->sas_token_refresh_window_secs = *((size_t*)value);
+            instance->sas_token_refresh_due_secs = get_sas_token_refresh_time_secs(instance);
             result = RESULT_OK;
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_125: [If name matches AUTHENTICATION_OPTION_SAS_TOKEN_LIFETIME_SECS, `value` shall be saved on `instance->sas_token_lifetime_secs`]
@@ -812,6 +864,13 @@ OPTIONHANDLER_HANDLE authentication_retrieve_options(AUTHENTICATION_HANDLE authe
                 LogError("Failed to retrieve options from authentication instance (OptionHandler_Create failed for option '%s')", AUTHENTICATION_OPTION_SAS_TOKEN_LIFETIME_SECS);
                 result = NULL;
             }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_003: [AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS shall only be added to the OPTIONHANDLER_HANDLE instance if it is not 0]
+            else if (instance->sas_token_refresh_window_secs != 0 &&
+                OptionHandler_AddOption(options, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, (void*)&instance->sas_token_refresh_window_secs) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from authentication instance (OptionHandler_Create failed for option '%s')", AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS);
+                result = NULL;
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_127: [If no failures occur, authentication_retrieve_options shall return the OPTIONHANDLER_HANDLE instance]
@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <time.h>
 #include <limits.h>
+#include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/agenttime.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -32,11 +33,20 @@
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
 #include "iothubtransportamqp_methods.h"
 #endif
+#include "iothubtransportamqp_twin.h"
 #include "iothub_client_retry_control.h"
+#include "iothub_client_connection_ramp.h"
+#include "iothub_client_happy_eyeballs.h"
+#include "iothub_client_coalescing_io.h"
 #include "iothubtransport_amqp_common.h"
 #include "iothubtransport_amqp_connection.h"
 #include "iothubtransport_amqp_device.h"
 #include "iothub_client_version.h"
+#include "iothub_client_trace.h"
+#include "iothub_client_log_limit.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP
+#include "iothub_client_memory_tag.h"
 
 #define RESULT_OK                                 0
 #define INDEFINITE_TIME                           ((time_t)(-1))
@@ -49,6 +59,8 @@
 #define DEFAULT_RETRY_POLICY                      IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER
 // DEFAULT_MAX_RETRY_TIME_IN_SECS = 0 means infinite retry.
 #define DEFAULT_MAX_RETRY_TIME_IN_SECS            0
+// Number of buckets of the index of registered devices; a power of 2, so the bucket is taken from the low bits of the device id hash.
+#define REGISTERED_DEVICES_INDEX_SIZE             128
 
 // ---------- Data Definitions ---------- //
 
@@ -75,15 +87,25 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
 {
     STRING_HANDLE iothub_host_fqdn;                                     // FQDN of the IoT Hub.
     XIO_HANDLE tls_io;                                                  // TSL I/O transport.
+    XIO_HANDLE coalescing_io;                                           // On top of tls_io while the writes are coalesced, the I/O of the amqp_connection.
+    size_t write_coalescing_size;                                       // The most bytes of the writes of a DoWork coalesced in one, 0 to not coalesce them.
+    size_t device_quantum;                                              // Bytes of event content each device may send per DoWork, carried over when unused; 0 for no limit.
     AMQP_GET_IO_TRANSPORT underlying_io_transport_provider;             // Pointer to the function that creates the TLS I/O (internal use only).
     AMQP_CONNECTION_HANDLE amqp_connection;                             // Base amqp connection with service.
     AMQP_CONNECTION_STATE amqp_connection_state;                        // Current state of the amqp_connection.
     AMQP_TRANSPORT_AUTHENTICATION_MODE preferred_authentication_mode;   // Used to avoid registered devices using different authentication modes.
     SINGLYLINKEDLIST_HANDLE registered_devices;                         // List of devices currently registered in this transport.
+    struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG* registered_devices_index[REGISTERED_DEVICES_INDEX_SIZE]; // Registered devices hashed by device id, so looking them up does not walk `registered_devices`.
     bool is_trace_on;                                                   // Turns logging on and off.
     OPTIONHANDLER_HANDLE saved_tls_options;                             // Here are the options from the xio layer if any is saved.
+    bool saved_tls_options_stale;                                       // True until the options are first saved, or when an option reached tls_io after they were saved.
+    bool keep_underlying_io;                                            // Reopens the same tls_io on re-connection instead of creating a new one.
     AMQP_TRANSPORT_STATE state;                                         // Current state of the transport.
     RETRY_CONTROL_HANDLE connection_retry_control;                      // Controls when the re-connection attempt should occur.
+    RETRY_COORDINATOR_HANDLE retry_coordinator;                         // Shared with other transports to hold their re-connection attempts back together (not owned).
+    unsigned int retry_initial_wait_time_in_ms;                         // Wait before the first re-connection attempt, 0 for the default of the retry policy.
+    CONNECTION_RAMP_HANDLE connection_ramp;                             // Shared with other transports and clients to stagger the device authentications (not owned).
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs;                               // Shared with other transports to race IPv6 and IPv4 and remember the family that won (not owned).
 
     char* http_proxy_hostname;
     int http_proxy_port;
@@ -92,8 +114,12 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
     
     size_t option_sas_token_lifetime_secs;                              // Device-specific option.
     size_t option_sas_token_refresh_time_secs;                          // Device-specific option.
+    size_t option_sas_token_refresh_window_secs;                        // Device-specific option.
     size_t option_cbs_request_timeout_secs;                             // Device-specific option.
     size_t option_send_event_timeout_secs;                              // Device-specific option.
+    size_t option_c2d_link_credit;                                      // Device-specific option.
+    size_t option_event_send_batch_max_count;                           // Device-specific option.
+    size_t option_event_send_batch_linger_secs;                         // Device-specific option.
 
                                                                         // Auth module used to generating handle authorization
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;                   // with either SAS Token, x509 Certs, and Device SAS Token
@@ -102,6 +128,9 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
 typedef struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG
 {
     STRING_HANDLE device_id;                                            // Identity of the device.
+    size_t device_id_hash;                                              // Hash of `device_id`, selects the bucket of the device in `registered_devices_index`.
+    struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG* next_in_index;           // Next device in the same bucket of `registered_devices_index`.
+    LIST_ITEM_HANDLE registered_devices_item;                           // Item of the device in `registered_devices`, so unregistering does not search for it.
     DEVICE_HANDLE device_handle;                                        // Logic unit that performs authentication, messaging, etc.
     IOTHUB_CLIENT_LL_HANDLE iothub_client_handle;                       // Saved reference to the IoTHub LL Client.
     AMQP_TRANSPORT_INSTANCE* transport_instance;                        // Saved reference to the transport the device is registered on.
@@ -111,6 +140,7 @@ typedef struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG
     size_t number_of_send_event_complete_failures;                      // Number of times on_event_send_complete was called in row with an error.
     time_t time_of_last_state_change;                                   // Time the device_handle last changed state; used to track timeouts of device_start_async and device_stop.
     unsigned int max_state_change_timeout_secs;                         // Maximum number of seconds allowed for device_handle to complete start and stop state changes.
+    size_t send_deficit;                                                // With `device_quantum`, bytes of event content the device can still send.
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
     // the methods portion
     IOTHUBTRANSPORT_AMQP_METHODS_HANDLE methods_handle;                 // Handle to instance of module that deals with device methods for AMQP.
@@ -119,6 +149,10 @@ typedef struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG
     // is the transport subscribed for methods?
     bool subscribed_for_methods;                                         // Indicates if device is subscribed for device methods.
 #endif
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle;                        // Handle to instance of module that deals with the device twin for AMQP.
+    bool subscribe_twin_needed;                                          // Indicates if should subscribe for the device twin.
+    bool subscribed_for_twin;                                            // Indicates if device is subscribed for the device twin.
+    bool twin_links_failed;                                              // Set by the twin module on errors; the twin links are re-created on the next DoWork.
 } AMQP_TRANSPORT_DEVICE_INSTANCE;
 
 typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
@@ -194,6 +228,10 @@ static void internal_destroy_amqp_device_instance(AMQP_TRANSPORT_DEVICE_INSTANCE
         iothubtransportamqp_methods_destroy(trdev_inst->methods_handle);
     }
 #endif
+    if (trdev_inst->twin_handle != NULL)
+    {
+        iothubtransportamqp_twin_destroy(trdev_inst->twin_handle);
+    }
     if (trdev_inst->device_handle != NULL)
     {
         device_destroy(trdev_inst->device_handle);
@@ -217,6 +255,8 @@ static void on_device_state_changed_callback(void* context, DEVICE_STATE previou
         AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_062: [If `new_state` shall be saved into the `registered_device` instance]
         registered_device->device_state = new_state;
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_016: [on_device_state_changed_callback shall emit IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE with `registered_device` and `new_state`]
+        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE, registered_device, new_state);
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_063: [If `registered_device->time_of_last_state_change` shall be set using get_time()]
         registered_device->time_of_last_state_change = get_time(NULL);
 
@@ -246,50 +286,93 @@ static void on_device_state_changed_callback(void* context, DEVICE_STATE previou
     }
 }
 
-// @brief    Auxiliary function to be used to find a device in the registered_devices list.
-// @returns  true if the device ids match, false otherwise.
-static bool find_device_by_id_callback(LIST_ITEM_HANDLE list_item, const void* match_context)
+// @brief    FNV-1a hash of a device id, used to index the registered devices.
+static size_t get_device_id_hash(const char* device_id)
 {
-    bool result;
+    size_t hash = 2166136261u;
 
-    if (match_context == NULL)
+    while (*device_id != '\0')
     {
-        result = false;
+        hash = (hash ^ (unsigned char)*device_id) * 16777619u;
+        device_id++;
     }
-    else
+
+    return hash;
+}
+
+// @brief    Returns the first slot of the bucket of `registered_devices_index` a device id hash falls into.
+static AMQP_TRANSPORT_DEVICE_INSTANCE** get_registered_devices_index_bucket(AMQP_TRANSPORT_INSTANCE* transport_instance, size_t device_id_hash)
+{
+    return &transport_instance->registered_devices_index[device_id_hash & (REGISTERED_DEVICES_INDEX_SIZE - 1)];
+}
+
+// @brief       Looks up a device by id in the index of devices registered in the transport.
+// @remarks     The device ids are only compared for devices whose id hash matches.
+// @returns     The registered device with the given id, or NULL if there is none.
+static AMQP_TRANSPORT_DEVICE_INSTANCE* find_registered_device(AMQP_TRANSPORT_INSTANCE* transport_instance, const char* device_id, size_t device_id_hash)
+{
+    AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance = *get_registered_devices_index_bucket(transport_instance, device_id_hash);
+
+    while (device_instance != NULL)
     {
-        AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item);
+        const char* registered_device_id;
 
-        if (device_instance == NULL || 
-            device_instance->device_id == NULL || 
-            STRING_c_str(device_instance->device_id) != match_context)
+        if (device_instance->device_id_hash == device_id_hash &&
+            (registered_device_id = STRING_c_str(device_instance->device_id)) != NULL &&
+            strcmp(registered_device_id, device_id) == 0)
         {
-            result = false;
+            break;
         }
-        else
+
+        device_instance = device_instance->next_in_index;
+    }
+
+    return device_instance;
+}
+
+static void add_device_to_registered_devices_index(AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_instance)
+{
+    AMQP_TRANSPORT_DEVICE_INSTANCE** bucket = get_registered_devices_index_bucket(amqp_device_instance->transport_instance, amqp_device_instance->device_id_hash);
+
+    amqp_device_instance->next_in_index = *bucket;
+    *bucket = amqp_device_instance;
+}
+
+// @brief       Removes a device from the index of devices registered in the transport.
+// @returns     true if the device was in the index, false otherwise.
+static bool remove_device_from_registered_devices_index(AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_instance)
+{
+    bool result = false;
+    AMQP_TRANSPORT_DEVICE_INSTANCE** slot = get_registered_devices_index_bucket(amqp_device_instance->transport_instance, amqp_device_instance->device_id_hash);
+
+    while (*slot != NULL)
+    {
+        if (*slot == amqp_device_instance)
         {
+            *slot = amqp_device_instance->next_in_index;
+            amqp_device_instance->next_in_index = NULL;
             result = true;
+            break;
         }
+
+        slot = &(*slot)->next_in_index;
     }
 
     return result;
 }
 
-// @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
-// @remarks     Returns the correspoding LIST_ITEM_HANDLE in registered_devices, if found.
-// @returns     true if the device is already in the list, false otherwise.
-static bool is_device_registered_ex(SINGLYLINKEDLIST_HANDLE registered_devices, const char* device_id, LIST_ITEM_HANDLE *list_item)
-{
-    return ((*list_item = singlylinkedlist_find(registered_devices, find_device_by_id_callback, device_id)) != NULL ? 1 : 0);
-}
-
-// @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
-// @returns     true if the device is already in the list, false otherwise.
+// @brief       Verifies if a device is registered within the transport it refers to.
+// @returns     true if the device is in the index of registered devices of its transport, false otherwise.
 static bool is_device_registered(AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_instance)
 {
-    LIST_ITEM_HANDLE list_item;
-    const char* device_id = STRING_c_str(amqp_device_instance->device_id);
-    return is_device_registered_ex(amqp_device_instance->transport_instance->registered_devices, device_id, &list_item);
+    AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance = *get_registered_devices_index_bucket(amqp_device_instance->transport_instance, amqp_device_instance->device_id_hash);
+
+    while (device_instance != NULL && device_instance != amqp_device_instance)
+    {
+        device_instance = device_instance->next_in_index;
+    }
+
+    return (device_instance != NULL);
 }
 
 
@@ -366,7 +449,7 @@ static DEVICE_MESSAGE_DISPOSITION_RESULT get_device_disposition_result_from(IOTH
     }
     else
     {
-        LogError("Failed getting corresponding DEVICE_MESSAGE_DISPOSITION_RESULT for IOTHUBMESSAGE_DISPOSITION_RESULT (%d is not supported)", iothubclient_disposition_result);
+        LogErrorLimited("Failed getting corresponding DEVICE_MESSAGE_DISPOSITION_RESULT for IOTHUBMESSAGE_DISPOSITION_RESULT (%d is not supported)", iothubclient_disposition_result);
         device_disposition_result = DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED;
     }
 
@@ -381,7 +464,7 @@ static DEVICE_MESSAGE_DISPOSITION_RESULT on_message_received(IOTHUB_MESSAGE_HAND
 
     if ((message_data = MESSAGE_CALLBACK_INFO_Create(message, disposition_info, amqp_device_instance)) == NULL)
     {
-        LogError("Failed processing message received (failed to assemble callback info)");
+        LogErrorLimited("Failed processing message received (failed to assemble callback info)");
         device_disposition_result = DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED;
     }
     else
@@ -390,7 +473,7 @@ static DEVICE_MESSAGE_DISPOSITION_RESULT on_message_received(IOTHUB_MESSAGE_HAND
         if (IoTHubClient_LL_MessageCallback(amqp_device_instance->iothub_client_handle, message_data) != true)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_090: [If IoTHubClient_LL_MessageCallback() fails, on_message_received_callback shall return DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED]
-            LogError("Failed processing message received (IoTHubClient_LL_MessageCallback failed)");
+            LogErrorLimited("Failed processing message received (IoTHubClient_LL_MessageCallback failed)");
             IoTHubMessage_Destroy(message);
             MESSAGE_CALLBACK_INFO_Destroy(message_data);
             device_disposition_result = DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED;
@@ -431,7 +514,7 @@ static int on_method_request_received(void* context, const char* method_name, co
     /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_022: [ The status code shall be the return value of the call to `IoTHubClient_LL_DeviceMethodComplete`. ]*/
     if (IoTHubClient_LL_DeviceMethodComplete(device_state->iothub_client_handle, method_name, request, request_size, (void*)method_handle) != 0)
     {
-        LogError("Failure: IoTHubClient_LL_DeviceMethodComplete");
+        LogErrorLimited("Failure: IoTHubClient_LL_DeviceMethodComplete");
         result = __FAILURE__;
     }
     else
@@ -476,6 +559,60 @@ static int subscribe_methods(AMQP_TRANSPORT_DEVICE_INSTANCE* deviceState)
 }
 #endif
 
+static void on_twin_error(void* context)
+{
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_023: [`on_twin_error` shall mark the twin links of the device as failed, so the next DoWork re-creates them]
+    AMQP_TRANSPORT_DEVICE_INSTANCE* device_state = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
+    device_state->twin_links_failed = true;
+}
+
+static void on_twin_document_received(void* context, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* document, size_t document_size)
+{
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_024: [`on_twin_document_received` shall call IoTHubClient_LL_RetrievePropertyComplete with the update state, the document and its size]
+    AMQP_TRANSPORT_DEVICE_INSTANCE* device_state = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
+    IoTHubClient_LL_RetrievePropertyComplete(device_state->iothub_client_handle, update_state, document, document_size);
+}
+
+static void on_twin_reported_state_complete(void* context, uint32_t item_id, int status_code)
+{
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_025: [`on_twin_reported_state_complete` shall call IoTHubClient_LL_ReportedStateComplete with the item id and the status code]
+    AMQP_TRANSPORT_DEVICE_INSTANCE* device_state = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
+    IoTHubClient_LL_ReportedStateComplete(device_state->iothub_client_handle, item_id, status_code);
+}
+
+static int subscribe_twin(AMQP_TRANSPORT_DEVICE_INSTANCE* deviceState)
+{
+    int result;
+    SESSION_HANDLE session_handle;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_026: [If the twin links failed, they shall be destroyed with iothubtransportamqp_twin_unsubscribe before subscribing again]
+    if (deviceState->subscribed_for_twin)
+    {
+        iothubtransportamqp_twin_unsubscribe(deviceState->twin_handle);
+        deviceState->subscribed_for_twin = false;
+    }
+    deviceState->twin_links_failed = false;
+
+    if ((amqp_connection_get_session_handle(deviceState->transport_instance->amqp_connection, &session_handle)) != RESULT_OK)
+    {
+        LogError("Device '%s' failed subscribing for the device twin (failed getting session handle)", STRING_c_str(deviceState->device_id));
+        result = __FAILURE__;
+    }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_022: [Once the device is started and IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin was called, IoTHubTransport_AMQP_Common_DoWork shall call iothubtransportamqp_twin_subscribe with the current session handle]
+    else if (iothubtransportamqp_twin_subscribe(deviceState->twin_handle, session_handle, on_twin_error, on_twin_document_received, on_twin_reported_state_complete, deviceState) != 0)
+    {
+        LogError("Cannot subscribe for the device twin");
+        result = __FAILURE__;
+    }
+    else
+    {
+        deviceState->subscribed_for_twin = true;
+        result = 0;
+    }
+
+    return result;
+}
+
 
 // ---------- Underlying TLS I/O Helpers ---------- //
 
@@ -598,6 +735,12 @@ static int get_new_underlying_io_transport(AMQP_TRANSPORT_INSTANCE* transport_in
             LogError("Failed to apply options previous saved to new underlying I/O transport instance.");
         }
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_038: [If a happy eyeballs handle was set, happy_eyeballs_prepare_io() shall be invoked with every new `instance->tls_io` and `instance->iothub_host_fqdn`]
+        if (transport_instance->happy_eyeballs != NULL)
+        {
+            happy_eyeballs_prepare_io(transport_instance->happy_eyeballs, *xio_handle, STRING_c_str(transport_instance->iothub_host_fqdn));
+        }
+
         result = RESULT_OK;
     }
 
@@ -605,6 +748,27 @@ static int get_new_underlying_io_transport(AMQP_TRANSPORT_INSTANCE* transport_in
 }
 
 
+// @brief    Destroys the coalescing I/O of the connection, if any; `instance->tls_io` is left as it is.
+static void destroy_coalescing_io(AMQP_TRANSPORT_INSTANCE* transport_instance)
+{
+    if (transport_instance->coalescing_io != NULL)
+    {
+        xio_destroy(transport_instance->coalescing_io);
+        transport_instance->coalescing_io = NULL;
+    }
+}
+
+// @brief    Corks or uncorks (writing what it holds) the coalescing I/O of the connection, if any.
+static void cork_coalescing_io(AMQP_TRANSPORT_INSTANCE* transport_instance, bool cork)
+{
+    if (transport_instance->coalescing_io != NULL &&
+        xio_setoption(transport_instance->coalescing_io, COALESCING_IO_OPTION_CORK, &cork) != 0)
+    {
+        LogErrorLimited("Failed writing the coalesced frames.");
+    }
+}
+
+
 // ---------- AMQP connection establishment/tear-down, connectry retry ---------- //
 
 static void on_amqp_connection_state_changed(const void* context, AMQP_CONNECTION_STATE previous_state, AMQP_CONNECTION_STATE new_state)
@@ -621,10 +785,22 @@ static void on_amqp_connection_state_changed(const void* context, AMQP_CONNECTIO
         {
             LogError("Transport received an ERROR from the amqp_connection (state changed %s -> %s); it will be flagged for connection retry.", ENUM_TO_STRING(AMQP_CONNECTION_STATE, previous_state), ENUM_TO_STRING(AMQP_CONNECTION_STATE, new_state));
 
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_040: [If a happy eyeballs handle was set and the AMQP connection fails before it is opened, happy_eyeballs_on_connect_failed() shall be invoked with `instance->iothub_host_fqdn`]
+            if (transport_instance->happy_eyeballs != NULL && previous_state != AMQP_CONNECTION_STATE_OPENED)
+            {
+                happy_eyeballs_on_connect_failed(transport_instance->happy_eyeballs, STRING_c_str(transport_instance->iothub_host_fqdn));
+            }
+
             update_state(transport_instance, AMQP_TRANSPORT_STATE_RECONNECTION_REQUIRED);
         }
         else if (new_state == AMQP_CONNECTION_STATE_OPENED)
         {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_039: [If a happy eyeballs handle was set and the AMQP connection is opened, happy_eyeballs_on_connected() shall be invoked with `instance->tls_io` and `instance->iothub_host_fqdn`]
+            if (transport_instance->happy_eyeballs != NULL)
+            {
+                happy_eyeballs_on_connected(transport_instance->happy_eyeballs, transport_instance->tls_io, STRING_c_str(transport_instance->iothub_host_fqdn));
+            }
+
             update_state(transport_instance, AMQP_TRANSPORT_STATE_CONNECTED);
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_115: [If the AMQP connection is closed by the service side, the connection retry logic shall be triggered]
@@ -659,8 +835,23 @@ static int establish_amqp_connection(AMQP_TRANSPORT_INSTANCE* transport_instance
     else
     {
         AMQP_CONNECTION_CONFIG amqp_connection_config;
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_042: [If `write_coalescing` is not 0, the AMQP connection shall be created on a new coalescing I/O over `instance->tls_io`, or on `instance->tls_io` itself if it cannot be created]
+        destroy_coalescing_io(transport_instance);
+        if (transport_instance->write_coalescing_size != 0)
+        {
+            COALESCING_IO_CONFIG coalescing_io_config;
+            coalescing_io_config.underlying_io = transport_instance->tls_io;
+            coalescing_io_config.buffer_size = transport_instance->write_coalescing_size;
+
+            if ((transport_instance->coalescing_io = xio_create(coalescing_io_get_interface_description(), &coalescing_io_config)) == NULL)
+            {
+                LogError("Failed creating the coalescing I/O; the frames will not be coalesced.");
+            }
+        }
+
         amqp_connection_config.iothub_host_fqdn = STRING_c_str(transport_instance->iothub_host_fqdn);
-        amqp_connection_config.underlying_io_transport = transport_instance->tls_io;
+        amqp_connection_config.underlying_io_transport = (transport_instance->coalescing_io != NULL) ? transport_instance->coalescing_io : transport_instance->tls_io;
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_029: [`instance->is_trace_on` shall be set into `AMQP_CONNECTION_CONFIG->is_trace_on`]
         amqp_connection_config.is_trace_on = transport_instance->is_trace_on;
         amqp_connection_config.on_state_changed_callback = on_amqp_connection_state_changed;
@@ -715,6 +906,12 @@ static void prepare_device_for_connection_retry(AMQP_TRANSPORT_DEVICE_INSTANCE*
     iothubtransportamqp_methods_unsubscribe(registered_device->methods_handle);
     registered_device->subscribed_for_methods = 0;
 #endif
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_027: [Each `instance->registered_devices` subscribed for the device twin shall call iothubtransportamqp_twin_unsubscribe, which keeps the reported states waiting for their response to send them again]
+    if (registered_device->subscribed_for_twin)
+    {
+        iothubtransportamqp_twin_unsubscribe(registered_device->twin_handle);
+        registered_device->subscribed_for_twin = false;
+    }
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_031: [device_stop() shall be invoked on all `instance->registered_devices` that are not already stopped]
     if (registered_device->device_state != DEVICE_STATE_STOPPED)
@@ -733,10 +930,19 @@ static void prepare_for_connection_retry(AMQP_TRANSPORT_INSTANCE* transport_inst
 {
     LogInfo("Preparing transport for re-connection");
 
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_003: [If `keep_underlying_io` is set, `instance->tls_io` shall be neither saved nor destroyed, so the next connection reopens it]
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_034: [`instance->tls_io` options shall be saved on `instance->saved_tls_options` using xio_retrieveoptions()]
-    if (save_underlying_io_transport_options(transport_instance) != RESULT_OK)
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_048: [If no option was passed to `instance->tls_io` since `instance->saved_tls_options` was last saved, xio_retrieveoptions() shall not be called and `instance->saved_tls_options` shall be kept]
+    if (!transport_instance->keep_underlying_io && transport_instance->saved_tls_options_stale)
     {
-        LogError("Failed saving TLS I/O options while preparing for connection retry; failure will be ignored");
+        if (save_underlying_io_transport_options(transport_instance) != RESULT_OK)
+        {
+            LogError("Failed saving TLS I/O options while preparing for connection retry; failure will be ignored");
+        }
+        else
+        {
+            transport_instance->saved_tls_options_stale = false;
+        }
     }
 
     LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(transport_instance->registered_devices);
@@ -761,9 +967,13 @@ static void prepare_for_connection_retry(AMQP_TRANSPORT_INSTANCE* transport_inst
     amqp_connection_destroy(transport_instance->amqp_connection);
     transport_instance->amqp_connection = NULL;
     transport_instance->amqp_connection_state = AMQP_CONNECTION_STATE_CLOSED;
+    destroy_coalescing_io(transport_instance);
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_035: [`instance->tls_io` shall be destroyed using xio_destroy()]
-    destroy_underlying_io_transport(transport_instance);
+    if (!transport_instance->keep_underlying_io)
+    {
+        destroy_underlying_io_transport(transport_instance);
+    }
 
     update_state(transport_instance, AMQP_TRANSPORT_STATE_READY_FOR_RECONNECTION);
 }
@@ -816,6 +1026,11 @@ static IOTHUB_MESSAGE_LIST* get_next_event_to_send(AMQP_TRANSPORT_DEVICE_INSTANC
         PDLIST_ENTRY list_entry = registered_device->waiting_to_send->Flink;
         message = containingRecord(list_entry, IOTHUB_MESSAGE_LIST, entry);
         (void)DList_RemoveEntryList(list_entry);
+        if (message->traced)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_001: [For a traced message taken from `waiting_to_send`, IoTHubTransport_AMQP_Common_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT]
+            IoTHubClient_LL_TraceMessage(message, IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT);
+        }
     }
     else
     {
@@ -869,6 +1084,9 @@ static void on_event_send_complete(IOTHUB_MESSAGE_LIST* message, D2C_EVENT_SEND_
         registered_device->number_of_send_event_complete_failures = 0;
     }
 
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_015: [on_event_send_complete shall emit IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK with `message->messageHandle` and the `iothub_send_result` of `result`]
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, message->messageHandle, get_iothub_client_confirmation_result_from(result));
+
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_056: [If `message->callback` is not NULL, it shall invoked with the `iothub_send_result`]
     if (message->callback != NULL)
     {
@@ -889,6 +1107,79 @@ static void on_event_send_complete(IOTHUB_MESSAGE_LIST* message, D2C_EVENT_SEND_
     free(message);
 }
 
+// @brief
+//     Size of the content of the oldest event on the wait to send list, what `device_quantum` is counted in.
+static size_t get_next_event_content_size(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    size_t result = 0;
+    IOTHUB_MESSAGE_LIST* message = containingRecord(registered_device->waiting_to_send->Flink, IOTHUB_MESSAGE_LIST, entry);
+    const unsigned char* buffer;
+    const char* text;
+
+    if (IoTHubMessage_GetContentType(message->messageHandle) == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        if (IoTHubMessage_GetByteArray(message->messageHandle, &buffer, &result) != IOTHUB_MESSAGE_OK)
+        {
+            result = 0;
+        }
+    }
+    else if ((text = IoTHubMessage_GetString(message->messageHandle)) != NULL)
+    {
+        result = strlen(text);
+    }
+
+    return result;
+}
+
+// @brief
+//     With `device_quantum`, tells if the oldest event fits in the deficit of the device and takes its size from the deficit.
+static bool is_next_event_within_deficit(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    bool result;
+
+    if (registered_device->transport_instance->device_quantum == 0)
+    {
+        result = true;
+    }
+    else if (DList_IsListEmpty(registered_device->waiting_to_send))
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_047: [A device whose `wait_to_send_list` is empty shall have its deficit set to 0]
+        registered_device->send_deficit = 0;
+        result = true;
+    }
+    else
+    {
+        size_t size = get_next_event_content_size(registered_device);
+
+        if (size <= registered_device->send_deficit)
+        {
+            registered_device->send_deficit -= size;
+            result = true;
+        }
+        else
+        {
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+// @brief
+//     With `device_quantum`, grows the deficit of the device by one quantum, bounded by the quantum plus the size of its oldest event.
+static void add_device_quantum(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    size_t quantum = registered_device->transport_instance->device_quantum;
+
+    if ((quantum != 0) && !DList_IsListEmpty(registered_device->waiting_to_send))
+    {
+        size_t size = get_next_event_content_size(registered_device);
+        size_t limit = (size > SIZE_MAX - quantum) ? SIZE_MAX : (size + quantum);
+
+        registered_device->send_deficit = (registered_device->send_deficit > limit - quantum) ? limit : (registered_device->send_deficit + quantum);
+    }
+}
+
 // @brief
 //     Gets events from wait to send list and sends to service in the order they were added.
 // @returns
@@ -900,9 +1191,16 @@ static int send_pending_events(AMQP_TRANSPORT_DEVICE_INSTANCE* device_state)
 
     result = RESULT_OK;
 
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_046: [If `device_quantum` is not 0, `device_quantum` shall be added to the deficit of the device, up to `device_quantum` plus the content size of its oldest event, and the events shall be sent only while the content size of the oldest one is not larger than the deficit, which it is taken from; the deficit left shall be kept for the next DoWork]
+    add_device_quantum(device_state);
+
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_047: [If the registered device is started, each event on `registered_device->wait_to_send_list` shall be removed from the list and sent using device_send_event_async()]
-    while ((message = get_next_event_to_send(device_state)) != NULL)
+    while (is_next_event_within_deficit(device_state) &&
+        (message = get_next_event_to_send(device_state)) != NULL)
     {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_014: [Before each event is sent, IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH shall be emitted with `message->messageHandle` and 0]
+        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, message->messageHandle, 0);
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_048: [device_send_event_async() shall be invoked passing `on_event_send_complete`]
         if (device_send_event_async(device_state->device_handle, message, on_event_send_complete, device_state) != RESULT_OK)
         {
@@ -935,7 +1233,15 @@ static int IoTHubTransport_AMQP_Common_Device_DoWork(AMQP_TRANSPORT_DEVICE_INSTA
         {
             SESSION_HANDLE session_handle;
             CBS_HANDLE cbs_handle = NULL;
+            unsigned int ramp_wait_time_in_ms;
 
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_036: [If a connection ramp was set, connection_ramp_admit() shall be invoked with whether `waiting_to_send` has events before the device is started]
+            if (registered_device->transport_instance->connection_ramp != NULL &&
+                !connection_ramp_admit(registered_device->transport_instance->connection_ramp, !DList_IsListEmpty(registered_device->waiting_to_send), &ramp_wait_time_in_ms))
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_037: [If connection_ramp_admit() returns false, the device shall stay in DEVICE_STATE_STOPPED without a failure being counted]
+                result = RESULT_OK;
+            }
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_039: [amqp_connection_get_session_handle() shall be invoked on `instance->connection`]
             if (amqp_connection_get_session_handle(registered_device->transport_instance->amqp_connection, &session_handle) != RESULT_OK)
             {
@@ -1021,6 +1327,14 @@ static int IoTHubTransport_AMQP_Common_Device_DoWork(AMQP_TRANSPORT_DEVICE_INSTA
         result = __FAILURE__;
     }
 #endif
+    else if (registered_device->subscribe_twin_needed &&
+        (!registered_device->subscribed_for_twin || registered_device->twin_links_failed) &&
+        subscribe_twin(registered_device) != RESULT_OK)
+    {
+        LogError("Failed performing DoWork for device '%s' (failed subscribing for the device twin)", STRING_c_str(registered_device->device_id));
+        registered_device->number_of_previous_failures++;
+        result = __FAILURE__;
+    }
     else
     {
         if (send_pending_events(registered_device) != RESULT_OK)
@@ -1061,6 +1375,21 @@ static int replicate_device_options_to(AMQP_TRANSPORT_DEVICE_INSTANCE* dev_insta
         LogError("Failed to apply option DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
         result = __FAILURE__;
     }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_004: [The event send batching options shall be replicated to a registered device only if they have been set]
+    else if (dev_instance->transport_instance->option_event_send_batch_max_count != 0 &&
+        (device_set_option(dev_instance->device_handle, DEVICE_OPTION_EVENT_SEND_BATCH_MAX_COUNT, &dev_instance->transport_instance->option_event_send_batch_max_count) != RESULT_OK ||
+         device_set_option(dev_instance->device_handle, DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_SECS, &dev_instance->transport_instance->option_event_send_batch_linger_secs) != RESULT_OK))
+    {
+        LogError("Failed to apply the event send batching options to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_009: [The C2D link credit option shall be replicated to a registered device only if it has been set]
+    else if (dev_instance->transport_instance->option_c2d_link_credit != 0 &&
+        device_set_option(dev_instance->device_handle, DEVICE_OPTION_C2D_LINK_CREDIT, &dev_instance->transport_instance->option_c2d_link_credit) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_C2D_LINK_CREDIT to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
     else if (auth_mode == DEVICE_AUTH_MODE_CBS)
     {
         if (device_set_option(
@@ -1087,6 +1416,16 @@ static int replicate_device_options_to(AMQP_TRANSPORT_DEVICE_INSTANCE* dev_insta
             LogError("Failed to apply option DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
             result = __FAILURE__;
         }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_008: [The SAS token refresh window option shall be replicated to a registered device only if it has been set]
+        else if (dev_instance->transport_instance->option_sas_token_refresh_window_secs != 0 &&
+            device_set_option(
+                dev_instance->device_handle,
+                DEVICE_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS,
+                &dev_instance->transport_instance->option_sas_token_refresh_window_secs) != RESULT_OK)
+        {
+            LogError("Failed to apply option DEVICE_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+            result = __FAILURE__;
+        }
         else
         {
             result = RESULT_OK;
@@ -1114,6 +1453,10 @@ static const char* get_device_option_name_from(const char* iothubclient_option_n
     {
         device_option_name = DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS;
     }
+    else if (strcmp(OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS;
+    }
     else if (strcmp(OPTION_CBS_REQUEST_TIMEOUT, iothubclient_option_name) == 0)
     {
         device_option_name = DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS;
@@ -1122,6 +1465,18 @@ static const char* get_device_option_name_from(const char* iothubclient_option_n
     {
         device_option_name = DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS;
     }
+    else if (strcmp(OPTION_EVENT_SEND_BATCH_MAX_COUNT, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_EVENT_SEND_BATCH_MAX_COUNT;
+    }
+    else if (strcmp(OPTION_EVENT_SEND_BATCH_LINGER_SECS, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_SECS;
+    }
+    else if (strcmp(OPTION_C2D_LINK_CREDIT, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_C2D_LINK_CREDIT;
+    }
     else
     {
         device_option_name = NULL;
@@ -1201,6 +1556,7 @@ static void internal_destroy_instance(AMQP_TRANSPORT_INSTANCE* instance)
             amqp_connection_destroy(instance->amqp_connection);
         }
 
+        destroy_coalescing_io(instance);
         destroy_underlying_io_transport(instance);
         destroy_underlying_io_transport_options(instance);
         retry_control_destroy(instance->connection_retry_control);
@@ -1222,11 +1578,11 @@ static DEVICE_MESSAGE_DISPOSITION_INFO* create_device_message_disposition_info_f
 
     if ((result = (DEVICE_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO))) == NULL)
     {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (malloc failed)");
+        LogErrorLimited("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (malloc failed)");
     }
     else if (mallocAndStrcpy_s(&result->source, message_data->transportContext->link_name) != RESULT_OK)
     {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (mallocAndStrcpy_s failed)");
+        LogErrorLimited("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (mallocAndStrcpy_s failed)");
         free(result);
         result = NULL;
     }
@@ -1282,6 +1638,7 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
             instance->preferred_authentication_mode = AMQP_TRANSPORT_AUTHENTICATION_MODE_NOT_SET;
             instance->state = AMQP_TRANSPORT_STATE_NOT_CONNECTED;
             instance->authorization_module = config->auth_module_handle;
+            instance->saved_tls_options_stale = true;
 
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_124: [`instance->connection_retry_control` shall be set using retry_control_create(), passing defaults EXPONENTIAL_BACKOFF_WITH_JITTER and 0]
             if ((instance->connection_retry_control = retry_control_create(DEFAULT_RETRY_POLICY, DEFAULT_MAX_RETRY_TIME_IN_SECS)) == NULL)
@@ -1310,6 +1667,7 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_010: [`get_io_transport` shall be saved on `instance->underlying_io_transport_provider`]
                 instance->underlying_io_transport_provider = get_io_transport;
                 instance->is_trace_on = false;
+                instance->keep_underlying_io = false;
                 instance->option_sas_token_lifetime_secs = DEFAULT_SAS_TOKEN_LIFETIME_SECS;
                 instance->option_sas_token_refresh_time_secs = DEFAULT_SAS_TOKEN_REFRESH_TIME_SECS;
                 instance->option_cbs_request_timeout_secs = DEFAULT_CBS_REQUEST_TIMEOUT_SECS;
@@ -1330,13 +1688,40 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
     return result;
 }
 
-IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_AMQP_Common_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_AMQP_Common_ProcessItem(IOTHUB_DEVICE_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
 {
-    (void)handle;
-    (void)item_type;
-    (void)iothub_item;
-    LogError("Currently Not Supported.");
-    return IOTHUB_PROCESS_ERROR;
+    IOTHUB_PROCESS_ITEM_RESULT result;
+    AMQP_TRANSPORT_DEVICE_INSTANCE* device_state = (AMQP_TRANSPORT_DEVICE_INSTANCE*)handle;
+
+    if (handle == NULL || iothub_item == NULL)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_028: [If `handle` or `iothub_item` is NULL, IoTHubTransport_AMQP_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR]
+        LogError("Invalid argument (handle=%p, iothub_item=%p)", handle, iothub_item);
+        result = IOTHUB_PROCESS_ERROR;
+    }
+    else if (item_type != IOTHUB_TYPE_DEVICE_TWIN)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_029: [If `item_type` is not IOTHUB_TYPE_DEVICE_TWIN, IoTHubTransport_AMQP_Common_ProcessItem shall return IOTHUB_PROCESS_CONTINUE]
+        result = IOTHUB_PROCESS_CONTINUE;
+    }
+    else if (!device_state->subscribed_for_twin || device_state->twin_links_failed)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_030: [If the twin links of the device are not up, IoTHubTransport_AMQP_Common_ProcessItem shall return IOTHUB_PROCESS_NOT_CONNECTED]
+        result = IOTHUB_PROCESS_NOT_CONNECTED;
+    }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_031: [IoTHubTransport_AMQP_Common_ProcessItem shall send the reported state with iothubtransportamqp_twin_send_reported_state, passing the item id and `report_data_handle`, and return IOTHUB_PROCESS_OK, without waiting for the reported states sent before]
+    else if (iothubtransportamqp_twin_send_reported_state(device_state->twin_handle, iothub_item->device_twin->item_id, iothub_item->device_twin->report_data_handle) != 0)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_032: [If iothubtransportamqp_twin_send_reported_state fails, IoTHubTransport_AMQP_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR]
+        LogErrorLimited("Device '%s' failed sending a reported state", STRING_c_str(device_state->device_id));
+        result = IOTHUB_PROCESS_ERROR;
+    }
+    else
+    {
+        result = IOTHUB_PROCESS_OK;
+    }
+
+    return result;
 }
 
 void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
@@ -1361,7 +1746,7 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_126: [The connection retry shall be attempted only if retry_control_should_retry() returns RETRY_ACTION_NOW, or if it fails]
             if (retry_control_should_retry(transport_instance->connection_retry_control, &retry_action) != RESULT_OK)
             {
-                LogError("retry_control_should_retry() failed; assuming immediate connection retry for safety.");
+                LogErrorLimited("retry_control_should_retry() failed; assuming immediate connection retry for safety.");
                 retry_action = RETRY_ACTION_RETRY_NOW;
             }
 
@@ -1379,13 +1764,16 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_019: [If `instance->amqp_connection` is NULL, it shall be established]
             if (transport_instance->amqp_connection == NULL && establish_amqp_connection(transport_instance) != RESULT_OK)
             {
-                LogError("AMQP transport failed to establish connection with service.");
+                LogErrorLimited("AMQP transport failed to establish connection with service.");
 
                 update_state(transport_instance, AMQP_TRANSPORT_STATE_RECONNECTION_REQUIRED);
             }
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_020: [If the amqp_connection is OPENED, the transport shall iterate through each registered device and perform a device-specific do_work on each]
             else if (transport_instance->amqp_connection_state == AMQP_CONNECTION_STATE_OPENED)
             {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_043: [While the AMQP connection is on a coalescing I/O, it shall be corked before the device-specific do_work and uncorked, which writes what it holds, after the last of them]
+                cork_coalescing_io(transport_instance, true);
+
                 while (list_item != NULL)
                 {
                     AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device;
@@ -1413,6 +1801,8 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
 
                     list_item = singlylinkedlist_get_next_item(list_item);
                 }
+
+                cork_coalescing_io(transport_instance, false);
             }
         }
 
@@ -1487,18 +1877,45 @@ void IoTHubTransport_AMQP_Common_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
 
 int IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
 {
-    (void)handle;
-    /*Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_02_009: [ IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin shall return a non-zero value. ]*/
-    int result = __FAILURE__;
-    LogError("IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin Not supported");
+    int result;
+
+    if (handle == NULL)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_020: [If `handle` is NULL, IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin shall fail and return a non-zero value]
+        LogError("NULL handle");
+        result = __FAILURE__;
+    }
+    else
+    {
+        AMQP_TRANSPORT_DEVICE_INSTANCE* device_state = (AMQP_TRANSPORT_DEVICE_INSTANCE*)handle;
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_02_009: [IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin shall remember that the twin links are to be created in the next call to DoWork and return 0; it shall do nothing more if already subscribed]
+        device_state->subscribe_twin_needed = true;
+        result = 0;
+    }
+
     return result;
 }
 
 void IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
 {
-    (void)handle;
-    /*Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_02_010: [ IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin shall return. ]*/
-    LogError("IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin Not supported");
+    if (handle == NULL)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_021: [If `handle` is NULL, IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin shall do nothing]
+        LogError("NULL handle");
+    }
+    else
+    {
+        AMQP_TRANSPORT_DEVICE_INSTANCE* device_state = (AMQP_TRANSPORT_DEVICE_INSTANCE*)handle;
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_02_010: [IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin shall destroy the twin links with iothubtransportamqp_twin_unsubscribe if they were created; the reported states waiting for their response are sent again by the next subscribe]
+        device_state->subscribe_twin_needed = false;
+        if (device_state->subscribed_for_twin)
+        {
+            iothubtransportamqp_twin_unsubscribe(device_state->twin_handle);
+            device_state->subscribed_for_twin = false;
+        }
+    }
 }
 
 int IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE handle)
@@ -1609,7 +2026,7 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_GetSendStatus(IOTHUB_DEVICE_HAN
         if (device_get_send_status(amqp_device_state->device_handle, &device_send_status) != RESULT_OK)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_098: [If device_get_send_status() fails, IoTHubTransport_AMQP_Common_GetSendStatus shall return IOTHUB_CLIENT_ERROR]
-            LogError("Failed retrieving the device send status (device_get_send_status failed)");
+            LogErrorLimited("Failed retrieving the device send status (device_get_send_status failed)");
             result = IOTHUB_CLIENT_ERROR;
         }
         else
@@ -1633,6 +2050,43 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_GetSendStatus(IOTHUB_DEVICE_HAN
     return result;
 }
 
+size_t IoTHubTransport_AMQP_Common_GetPollDescriptors(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_POLL_DESCRIPTOR* descriptors, size_t descriptorCount)
+{
+    size_t result;
+    AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
+    intptr_t descriptor;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_017: [If `handle` is NULL, or `descriptors` is NULL while `descriptorCount` is not 0, IoTHubTransport_AMQP_Common_GetPollDescriptors shall return 0]
+    if (transport_instance == NULL || (descriptors == NULL && descriptorCount != 0))
+    {
+        LogError("Failed getting the poll descriptors (handle=%p, descriptors=%p)", handle, descriptors);
+        result = 0;
+    }
+    else if (descriptorCount == 0 || transport_instance->tls_io == NULL ||
+        (transport_instance->state != AMQP_TRANSPORT_STATE_CONNECTING && transport_instance->state != AMQP_TRANSPORT_STATE_CONNECTED))
+    {
+        result = 0;
+    }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_018: [If xio_setoption() with OPTION_XIO_SOCKET_DESCRIPTOR fails on `instance->tls_io`, IoTHubTransport_AMQP_Common_GetPollDescriptors shall return 0]
+    else if (xio_setoption(transport_instance->tls_io, OPTION_XIO_SOCKET_DESCRIPTOR, &descriptor) != 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_019: [While connecting or connected, IoTHubTransport_AMQP_Common_GetPollDescriptors shall write the socket of `instance->tls_io`, to be waited for readable, and writable until the AMQP connection is opened, and return 1]
+        descriptors[0].descriptor = descriptor;
+        descriptors[0].events = IOTHUB_CLIENT_POLL_READABLE;
+        if (transport_instance->amqp_connection_state != AMQP_CONNECTION_STATE_OPENED)
+        {
+            descriptors[0].events |= IOTHUB_CLIENT_POLL_WRITABLE;
+        }
+        result = 1;
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1659,6 +2113,11 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             is_device_specific_option = true;
             transport_instance->option_sas_token_refresh_time_secs = *(size_t*)value;
         }
+        else if (strcmp(OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_sas_token_refresh_window_secs = *(size_t*)value;
+        }
         else if (strcmp(OPTION_CBS_REQUEST_TIMEOUT, option) == 0)
         {
             is_device_specific_option = true;
@@ -1669,6 +2128,21 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             is_device_specific_option = true;
             transport_instance->option_send_event_timeout_secs = *(size_t*)value;
         }
+        else if (strcmp(OPTION_EVENT_SEND_BATCH_MAX_COUNT, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_event_send_batch_max_count = *(size_t*)value;
+        }
+        else if (strcmp(OPTION_EVENT_SEND_BATCH_LINGER_SECS, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_event_send_batch_linger_secs = *(size_t*)value;
+        }
+        else if (strcmp(OPTION_C2D_LINK_CREDIT, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_c2d_link_credit = *(size_t*)value;
+        }
         else
         {
             is_device_specific_option = false;
@@ -1703,6 +2177,69 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
                 result = IOTHUB_CLIENT_OK;
             }
         }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_002: [If `option` is `keep_underlying_io`, `value` shall be saved as a bool that determines if `instance->tls_io` is kept across re-connections]
+        else if (strcmp(OPTION_KEEP_UNDERLYING_IO, option) == 0)
+        {
+            transport_instance->keep_underlying_io = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_010: [If `option` is `retry_coordinator`, `value` shall be saved as the RETRY_COORDINATOR_HANDLE shared by the transports and set on `instance->connection_retry_control` using retry_control_set_option()]
+        else if (strcmp(OPTION_RETRY_COORDINATOR, option) == 0)
+        {
+            if (retry_control_set_option(transport_instance->connection_retry_control, RETRY_CONTROL_OPTION_RETRY_COORDINATOR, value) != RESULT_OK)
+            {
+                LogError("transport failed setting option '%s' (retry_control_set_option failed)", option);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                transport_instance->retry_coordinator = (RETRY_COORDINATOR_HANDLE)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_035: [If `option` is `connection_ramp`, `value` shall be saved as the CONNECTION_RAMP_HANDLE shared by the transports]
+        else if (strcmp(OPTION_CONNECTION_RAMP, option) == 0)
+        {
+            transport_instance->connection_ramp = (CONNECTION_RAMP_HANDLE)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_044: [If `option` is `write_coalescing`, `value` shall be saved as a size_t, the most bytes of the frames of a DoWork coalesced in one write, used from the next connection]
+        else if (strcmp(OPTION_WRITE_COALESCING, option) == 0)
+        {
+            transport_instance->write_coalescing_size = *((const size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_045: [If `option` is `device_quantum`, `value` shall be saved as a size_t, the bytes of event content each registered device may send per DoWork, 0 for no limit]
+        else if (strcmp(OPTION_DEVICE_QUANTUM, option) == 0)
+        {
+            transport_instance->device_quantum = *((const size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_041: [If `option` is `happy_eyeballs`, `value` shall be saved as the HAPPY_EYEBALLS_HANDLE shared by the transports]
+        else if (strcmp(OPTION_HAPPY_EYEBALLS, option) == 0)
+        {
+            transport_instance->happy_eyeballs = (HAPPY_EYEBALLS_HANDLE)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_012: [If `option` is `retry_initial_wait_time_in_ms`, `value` shall be saved as an unsigned int greater than 0 and set on `instance->connection_retry_control` using retry_control_set_option()]
+        else if (strcmp(OPTION_RETRY_INITIAL_WAIT_TIME_IN_MS, option) == 0)
+        {
+            if (*((unsigned int*)value) == 0)
+            {
+                LogError("transport failed setting option '%s' (value must be greater than 0)", option);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else if (retry_control_set_option(transport_instance->connection_retry_control, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, value) != RESULT_OK)
+            {
+                LogError("transport failed setting option '%s' (retry_control_set_option failed)", option);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                transport_instance->retry_initial_wait_time_in_ms = *((unsigned int*)value);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else if (strcmp(OPTION_HTTP_PROXY, option) == 0)
         {
             /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_032: [ If `option` is `proxy_data`, `value` shall be used as an `HTTP_PROXY_OPTIONS*`. ]*/
@@ -1818,10 +2355,8 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
                 }
                 else
                 {
-                    if (save_underlying_io_transport_options(transport_instance) != RESULT_OK)
-                    {
-                        LogError("IoTHubTransport_AMQP_Common_SetOption failed to save underlying I/O options; failure will be ignored");
-                    }
+                    // The options are retrieved from `instance->tls_io` only when it is about to be destroyed.
+                    transport_instance->saved_tls_options_stale = true;
 
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_03_001: [If no failures occur, IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK.]
                     result = IOTHUB_CLIENT_OK;
@@ -1856,11 +2391,12 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
     }
     else
     {
-        LIST_ITEM_HANDLE list_item;
         AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
+        size_t device_id_hash = get_device_id_hash(device->deviceId);
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_064: [If the device is already registered, IoTHubTransport_AMQP_Common_Register shall fail and return NULL.]
-        if (is_device_registered_ex(transport_instance->registered_devices, device->deviceId, &list_item))
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_005: [The registered devices shall be looked up by `device->deviceId` in an index hashed by device id, comparing the ids of the devices whose id hash matches]
+        if (find_registered_device(transport_instance, device->deviceId, device_id_hash) != NULL)
         {
             LogError("IoTHubTransport_AMQP_Common_Register failed (device '%s' already registered on this transport instance)", device->deviceId);
             result = NULL;
@@ -1901,6 +2437,7 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                 amqp_device_instance->iothub_client_handle = iotHubClientHandle;
                 amqp_device_instance->transport_instance = transport_instance;
                 amqp_device_instance->waiting_to_send = waitingToSend;
+                amqp_device_instance->device_id_hash = device_id_hash;
                 amqp_device_instance->device_state = DEVICE_STATE_STOPPED;
                 amqp_device_instance->max_state_change_timeout_secs = DEFAULT_DEVICE_STATE_CHANGE_TIMEOUT_SECS;
      
@@ -1939,48 +2476,56 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                     {
                         bool is_first_device_being_registered = (singlylinkedlist_get_head_item(transport_instance->registered_devices) == NULL);
 
+                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_033: [IoTHubTransport_AMQP_Common_Register shall create the device twin handler with iothubtransportamqp_twin_create, passing the fully qualified domain name and the device Id]
+                        if ((amqp_device_instance->twin_handle = iothubtransportamqp_twin_create(STRING_c_str(transport_instance->iothub_host_fqdn), device->deviceId)) == NULL)
+                        {
+                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_034: [If iothubtransportamqp_twin_create fails, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
+                            LogError("Transport failed to register device '%s' (Cannot create the twin module)", device->deviceId);
+                            result = NULL;
+                        }
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
                         /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_010: [ `IoTHubTransport_AMQP_Common_Create` shall create a new iothubtransportamqp_methods instance by calling `iothubtransportamqp_methods_create` while passing to it the the fully qualified domain name and the device Id. ]*/
-                        amqp_device_instance->methods_handle = iothubtransportamqp_methods_create(STRING_c_str(transport_instance->iothub_host_fqdn), device->deviceId);
-                        if (amqp_device_instance->methods_handle == NULL)
+                        else if ((amqp_device_instance->methods_handle = iothubtransportamqp_methods_create(STRING_c_str(transport_instance->iothub_host_fqdn), device->deviceId)) == NULL)
                         {
                             /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_011: [ If `iothubtransportamqp_methods_create` fails, `IoTHubTransport_AMQP_Common_Create` shall fail and return NULL. ]*/
                             LogError("Transport failed to register device '%s' (Cannot create the methods module)", device->deviceId);
                             result = NULL;
                         }
-                        else
 #endif
-                            if (replicate_device_options_to(amqp_device_instance, device_config.authentication_mode) != RESULT_OK)
-                            {
-                                LogError("Transport failed to register device '%s' (failed to replicate options)", device->deviceId);
-                                result = NULL;
-                            }
-                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices`]
-                            else if (singlylinkedlist_add(transport_instance->registered_devices, amqp_device_instance) == NULL)
-                            {
-                                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_075: [If it fails to add `amqp_device_instance`, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
-                                LogError("Transport failed to register device '%s' (singlylinkedlist_add failed)", device->deviceId);
-                                result = NULL;
-                            }
-                            else
+                        else if (replicate_device_options_to(amqp_device_instance, device_config.authentication_mode) != RESULT_OK)
+                        {
+                            LogError("Transport failed to register device '%s' (failed to replicate options)", device->deviceId);
+                            result = NULL;
+                        }
+                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices`]
+                        else if ((amqp_device_instance->registered_devices_item = singlylinkedlist_add(transport_instance->registered_devices, amqp_device_instance)) == NULL)
+                        {
+                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_075: [If it fails to add `amqp_device_instance`, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
+                            LogError("Transport failed to register device '%s' (singlylinkedlist_add failed)", device->deviceId);
+                            result = NULL;
+                        }
+                        else
+                        {
+                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_006: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to the index of registered devices]
+                            add_device_to_registered_devices_index(amqp_device_instance);
+
+                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_076: [If the device is the first being registered on the transport, IoTHubTransport_AMQP_Common_Register shall save its authentication mode as the transport preferred authentication mode]
+                            if (transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_NOT_SET &&
+                                is_first_device_being_registered)
                             {
-                                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_076: [If the device is the first being registered on the transport, IoTHubTransport_AMQP_Common_Register shall save its authentication mode as the transport preferred authentication mode]
-                                if (transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_NOT_SET &&
-                                    is_first_device_being_registered)
+                                if (device_config.authentication_mode == DEVICE_AUTH_MODE_CBS)
                                 {
-                                    if (device_config.authentication_mode == DEVICE_AUTH_MODE_CBS)
-                                    {
-                                        transport_instance->preferred_authentication_mode = AMQP_TRANSPORT_AUTHENTICATION_MODE_CBS;
-                                    }
-                                    else
-                                    {
-                                        transport_instance->preferred_authentication_mode = AMQP_TRANSPORT_AUTHENTICATION_MODE_X509;
-                                    }
+                                    transport_instance->preferred_authentication_mode = AMQP_TRANSPORT_AUTHENTICATION_MODE_CBS;
+                                }
+                                else
+                                {
+                                    transport_instance->preferred_authentication_mode = AMQP_TRANSPORT_AUTHENTICATION_MODE_X509;
                                 }
-
-                                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_078: [IoTHubTransport_AMQP_Common_Register shall return a handle to `amqp_device_instance` as a IOTHUB_DEVICE_HANDLE]
-                                result = (IOTHUB_DEVICE_HANDLE)amqp_device_instance;
                             }
+
+                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_078: [IoTHubTransport_AMQP_Common_Register shall return a handle to `amqp_device_instance` as a IOTHUB_DEVICE_HANDLE]
+                            result = (IOTHUB_DEVICE_HANDLE)amqp_device_instance;
+                        }
                     }
                 }
 
@@ -2008,7 +2553,6 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
     {
         AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)deviceHandle;
         const char* device_id;
-        LIST_ITEM_HANDLE list_item;
 
         if ((device_id = STRING_c_str(registered_device->device_id)) == NULL)
         {
@@ -2020,14 +2564,15 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
             LogError("Failed to unregister device '%s' (deviceHandle does not have a transport state associated to).", device_id);
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_081: [If the device is not registered with this transport, IoTHubTransport_AMQP_Common_Unregister shall return]
-        else if (!is_device_registered_ex(registered_device->transport_instance->registered_devices, device_id, &list_item))
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_007: [IoTHubTransport_AMQP_Common_Unregister shall remove the device from the index of registered devices]
+        else if (!remove_device_from_registered_devices_index(registered_device))
         {
             LogError("Failed to unregister device '%s' (device is not registered within this transport).", device_id);
         }
         else
         {
             // Removing it first so the race hazzard is reduced between this function and DoWork. Best would be to use locks.
-            if (singlylinkedlist_remove(registered_device->transport_instance->registered_devices, list_item) != RESULT_OK)
+            if (singlylinkedlist_remove(registered_device->transport_instance->registered_devices, registered_device->registered_devices_item) != RESULT_OK)
             {
                 LogError("Failed to unregister device '%s' (singlylinkedlist_remove failed).", device_id);
             }
@@ -2084,6 +2629,20 @@ int IoTHubTransport_AMQP_Common_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHU
             AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
             RETRY_CONTROL_HANDLE previous_retry_control = transport_instance->connection_retry_control;
 
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_011: [If a retry coordinator was set, it shall be set on the new retry control using retry_control_set_option()]
+            if (transport_instance->retry_coordinator != NULL &&
+                retry_control_set_option(new_retry_control, RETRY_CONTROL_OPTION_RETRY_COORDINATOR, transport_instance->retry_coordinator) != RESULT_OK)
+            {
+                LogError("Failed setting the retry coordinator on the new retry policy; the retries of this transport will not be coordinated");
+            }
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_013: [If `retry_initial_wait_time_in_ms` was set, it shall be set on the new retry control using retry_control_set_option()]
+            if (transport_instance->retry_initial_wait_time_in_ms != 0 &&
+                retry_control_set_option(new_retry_control, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, &transport_instance->retry_initial_wait_time_in_ms) != RESULT_OK)
+            {
+                LogError("Failed setting the initial wait time on the new retry policy; the default of the policy is used");
+            }
+
             transport_instance->connection_retry_control = new_retry_control;
 
             retry_control_destroy(previous_retry_control);
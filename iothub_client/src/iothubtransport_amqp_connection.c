@@ -13,6 +13,9 @@
 #include "azure_uamqp_c/sasl_mssbcbs.h"
 #include "azure_uamqp_c/connection.h"
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP
+#include "iothub_client_memory_tag.h"
+
 #define RESULT_OK                            0
 #define DEFAULT_CONNECTION_IDLE_TIMEOUT      240000
 #define DEFAULT_INCOMING_WINDOW_SIZE         UINT_MAX
@@ -11,6 +11,9 @@
 #include "iothubtransport_amqp_cbs_auth.h"
 #include "iothubtransport_amqp_device.h"
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP
+#include "iothub_client_memory_tag.h"
+
 #define RESULT_OK                                  0
 #define INDEFINITE_TIME                            ((time_t)-1)
 #define DEFAULT_AUTH_STATE_CHANGED_TIMEOUT_SECS    60
@@ -344,8 +347,6 @@ static void destroy_device_config(DEVICE_CONFIG* config)
 {
     if (config != NULL)
     {
-        free(config->product_info);
-        free(config->iothub_host_fqdn);
         free(config);
     }
 }
@@ -360,35 +361,15 @@ static DEVICE_CONFIG* clone_device_config(DEVICE_CONFIG *config)
     }
     else
     {
-        int result;
         memset(new_config, 0, sizeof(DEVICE_CONFIG));
 
-        if (config->product_info != NULL &&
-            mallocAndStrcpy_s(&new_config->product_info, config->product_info) != RESULT_OK)
-        {
-            LogError("Failed copying the DEVICE_CONFIG (failed copying product_info)");
-            result = __FAILURE__;
-        }
-        else if (mallocAndStrcpy_s(&new_config->iothub_host_fqdn, config->iothub_host_fqdn) != RESULT_OK)
-        {
-            LogError("Failed copying the DEVICE_CONFIG (failed copying iothub_host_fqdn)");
-            result = __FAILURE__;
-        }
-        else
-        {
-            new_config->authorization_module = config->authorization_module;
-            new_config->authentication_mode = config->authentication_mode;
-            new_config->on_state_changed_callback = config->on_state_changed_callback;
-            new_config->on_state_changed_context = config->on_state_changed_context;
-            new_config->device_id = IoTHubClient_Auth_Get_DeviceId(config->authorization_module);
-            result = RESULT_OK;
-        }
-
-        if (result != RESULT_OK)
-        {
-            destroy_device_config(new_config);
-            new_config = NULL;
-        }
+        // Codes_SRS_DEVICE_41_001: [The copy of `config` shall keep `config->iothub_host_fqdn` without copying it, the FQDN belongs to the transport and is shared by all its devices; `config->product_info` is only used by device_create() and shall not be kept]
+        new_config->iothub_host_fqdn = config->iothub_host_fqdn;
+        new_config->authorization_module = config->authorization_module;
+        new_config->authentication_mode = config->authentication_mode;
+        new_config->on_state_changed_callback = config->on_state_changed_callback;
+        new_config->on_state_changed_context = config->on_state_changed_context;
+        new_config->device_id = IoTHubClient_Auth_Get_DeviceId(config->authorization_module);
     }
 
     return new_config;
@@ -1150,6 +1131,7 @@ int device_set_option(DEVICE_HANDLE handle, const char* name, void* value)
 
         if (strcmp(DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS, name) == 0 ||
             strcmp(DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, name) == 0 ||
+            strcmp(DEVICE_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, name) == 0 ||
             strcmp(DEVICE_OPTION_SAS_TOKEN_LIFETIME_SECS, name) == 0)
         {
             // Codes_SRS_DEVICE_09_083: [If `name` refers to authentication but CBS authentication is not used, device_set_option shall return a non-zero result]
@@ -1170,7 +1152,10 @@ int device_set_option(DEVICE_HANDLE handle, const char* name, void* value)
                 result = RESULT_OK;
             }
         }
-        else if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0)
+        else if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0 ||
+                 strcmp(DEVICE_OPTION_EVENT_SEND_BATCH_MAX_COUNT, name) == 0 ||
+                 strcmp(DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_SECS, name) == 0 ||
+                 strcmp(DEVICE_OPTION_C2D_LINK_CREDIT, name) == 0)
         {
             // Codes_SRS_DEVICE_09_086: [If `name` refers to messenger module, it shall be passed along with `value` to messenger_set_option]
             if (messenger_set_option(instance->messenger_handle, name, value) != RESULT_OK)
@@ -9,7 +9,7 @@
 #include "azure_c_shared_utility/agenttime.h" 
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/uniqueid.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_uamqp_c/link.h"
 #include "azure_uamqp_c/messaging.h"
 #include "azure_uamqp_c/message_sender.h"
@@ -18,6 +18,10 @@
 #include "iothub_client_private.h"
 #include "iothub_client_version.h"
 #include "iothubtransport_amqp_messenger.h"
+#include "iothub_client_log_limit.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP
+#include "iothub_client_memory_tag.h"
 
 #define RESULT_OK 0
 #define INDEFINITE_TIME ((time_t)(-1))
@@ -34,15 +38,18 @@
 #define MAX_MESSAGE_SENDER_STATE_CHANGE_TIMEOUT_SECS    300
 #define MAX_MESSAGE_RECEIVER_STATE_CHANGE_TIMEOUT_SECS  300
 #define UNIQUE_ID_BUFFER_SIZE                           37
+#define EVENT_SEND_BATCH_MAX_SIZE                       (256 * 1024)
+#define AMQP_BATCHING_FORMAT_CODE                       0x80013700
 #define STRING_NULL_TERMINATOR                          '\0'
  
 typedef struct MESSENGER_INSTANCE_TAG
 {
 	STRING_HANDLE device_id;
     STRING_HANDLE product_info;
-	STRING_HANDLE iothub_host_fqdn;
-	SINGLYLINKEDLIST_HANDLE waiting_to_send;
-	SINGLYLINKEDLIST_HANDLE in_progress_list;
+	// The FQDN of the transport, shared by all its devices
+	const char* iothub_host_fqdn;
+	DLIST_ENTRY waiting_to_send;
+	DLIST_ENTRY in_progress_list;
 	MESSENGER_STATE state;
 	
 	ON_MESSENGER_STATE_CHANGED_CALLBACK on_state_changed_callback;
@@ -57,26 +64,34 @@ typedef struct MESSENGER_INSTANCE_TAG
 	MESSAGE_SENDER_HANDLE message_sender;
 	MESSAGE_SENDER_STATE message_sender_current_state;
 	MESSAGE_SENDER_STATE message_sender_previous_state;
+	bool is_destroying_message_sender;
 	LINK_HANDLE receiver_link;
 	MESSAGE_RECEIVER_HANDLE message_receiver;
 	MESSAGE_RECEIVER_STATE message_receiver_current_state;
 	MESSAGE_RECEIVER_STATE message_receiver_previous_state;
+	UAMQP_PROPERTY_KEY_CACHE_HANDLE property_key_cache;
 
 	size_t event_send_retry_limit;
 	size_t event_send_error_count;
 	size_t event_send_timeout_secs;
+	size_t event_send_batch_max_count;
+	size_t event_send_batch_linger_secs;
+	size_t c2d_link_credit;
 	time_t last_message_sender_state_change_time;
 	time_t last_message_receiver_state_change_time;
 } MESSENGER_INSTANCE;
 
 typedef struct MESSENGER_SEND_EVENT_TASK_TAG
 {
+	DLIST_ENTRY entry;  // links the task in either `waiting_to_send` or `in_progress_list`
 	IOTHUB_MESSAGE_LIST* message;
 	ON_MESSENGER_EVENT_SEND_COMPLETE on_event_send_complete_callback;
 	void* context;
 	time_t send_time;
 	MESSENGER_INSTANCE *messenger;
 	bool is_timed_out;
+	time_t enqueue_time;
+	struct MESSENGER_SEND_EVENT_TASK_TAG* next_in_batch;
 } MESSENGER_SEND_EVENT_TASK;
 
 // @brief
@@ -100,7 +115,7 @@ static int is_timeout_reached(time_t start_time, size_t timeout_in_secs, int *is
 
 		if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
 		{
-			LogError("Failed to verify timeout (get_time failed)");
+			LogErrorLimited("Failed to verify timeout (get_time failed)");
 			result = __FAILURE__;
 		}
 		else
@@ -121,7 +136,7 @@ static int is_timeout_reached(time_t start_time, size_t timeout_in_secs, int *is
 	return result;
 }
 
-static STRING_HANDLE create_devices_path(STRING_HANDLE iothub_host_fqdn, STRING_HANDLE device_id)
+static STRING_HANDLE create_devices_path(const char* iothub_host_fqdn, STRING_HANDLE device_id)
 {
 	STRING_HANDLE devices_path;
 
@@ -131,9 +146,8 @@ static STRING_HANDLE create_devices_path(STRING_HANDLE iothub_host_fqdn, STRING_
 	}
 	else
         {
-		const char* iothub_host_fqdn_char_ptr = STRING_c_str(iothub_host_fqdn);
 		const char* device_id_char_ptr = STRING_c_str(device_id);
-        	if (STRING_sprintf(devices_path, IOTHUB_DEVICES_PATH_FMT, iothub_host_fqdn_char_ptr, device_id_char_ptr) != RESULT_OK)
+        	if (STRING_sprintf(devices_path, IOTHUB_DEVICES_PATH_FMT, iothub_host_fqdn, device_id_char_ptr) != RESULT_OK)
 		{
 			STRING_delete(devices_path);
 			devices_path = NULL;
@@ -329,7 +343,10 @@ static void destroy_event_sender(MESSENGER_INSTANCE* instance)
 	if (instance->message_sender != NULL)
 	{
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_060: [`instance->message_sender` shall be destroyed using messagesender_destroy()]
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_018: [The send completions reported while `instance->message_sender` is destroyed shall be ignored, leaving the events in `instance->in_progress_list`]
+		instance->is_destroying_message_sender = true;
 		messagesender_destroy(instance->message_sender);
+		instance->is_destroying_message_sender = false;
 		instance->message_sender = NULL;
 		instance->message_sender_current_state = MESSAGE_SENDER_STATE_IDLE;
 		instance->message_sender_previous_state = MESSAGE_SENDER_STATE_IDLE;
@@ -536,7 +553,7 @@ static MESSENGER_MESSAGE_DISPOSITION_INFO* create_message_disposition_info(MESSE
 
 	if ((result = (MESSENGER_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(MESSENGER_MESSAGE_DISPOSITION_INFO))) == NULL)
 	{
-		LogError("Failed creating MESSENGER_MESSAGE_DISPOSITION_INFO container (malloc failed)");
+		LogErrorLimited("Failed creating MESSENGER_MESSAGE_DISPOSITION_INFO container (malloc failed)");
 		result = NULL;
 	}
 	else
@@ -545,7 +562,7 @@ static MESSENGER_MESSAGE_DISPOSITION_INFO* create_message_disposition_info(MESSE
 
 		if (messagereceiver_get_received_message_id(messenger->message_receiver, &message_id) != RESULT_OK)
 		{
-			LogError("Failed creating MESSENGER_MESSAGE_DISPOSITION_INFO container (messagereceiver_get_received_message_id failed)");
+			LogErrorLimited("Failed creating MESSENGER_MESSAGE_DISPOSITION_INFO container (messagereceiver_get_received_message_id failed)");
 			free(result);
 			result = NULL;
 		}
@@ -555,13 +572,13 @@ static MESSENGER_MESSAGE_DISPOSITION_INFO* create_message_disposition_info(MESSE
 
 			if (messagereceiver_get_link_name(messenger->message_receiver, &link_name) != RESULT_OK)
 			{
-				LogError("Failed creating MESSENGER_MESSAGE_DISPOSITION_INFO container (messagereceiver_get_link_name failed)");
+				LogErrorLimited("Failed creating MESSENGER_MESSAGE_DISPOSITION_INFO container (messagereceiver_get_link_name failed)");
 				free(result);
 				result = NULL;
 			}
 			else if (mallocAndStrcpy_s(&result->source, link_name) != RESULT_OK)
 			{
-				LogError("Failed creating MESSENGER_MESSAGE_DISPOSITION_INFO container (failed copying link name)");
+				LogErrorLimited("Failed creating MESSENGER_MESSAGE_DISPOSITION_INFO container (failed copying link name)");
 				free(result);
 				result = NULL;
 			}
@@ -603,7 +620,7 @@ static AMQP_VALUE create_uamqp_disposition_result_from(MESSENGER_DISPOSITION_RES
 	}
 	else
 	{
-		LogError("Failed creating a disposition result for messagereceiver (result %d is not supported)", disposition_result);
+		LogErrorLimited("Failed creating a disposition result for messagereceiver (result %d is not supported)", disposition_result);
 		uamqp_disposition_result = NULL;
 	}
 
@@ -633,7 +650,7 @@ static AMQP_VALUE on_message_received_internal_callback(const void* context, MES
 		if ((message_disposition_info = create_message_disposition_info(instance)) == NULL)
 		{
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_187: [**If the MESSENGER_MESSAGE_DISPOSITION_INFO instance fails to be created, on_message_received_internal_callback shall return messaging_delivery_released()]
-			LogError("on_message_received_internal_callback failed (failed creating MESSENGER_MESSAGE_DISPOSITION_INFO).");
+			LogErrorLimited("on_message_received_internal_callback failed (failed creating MESSENGER_MESSAGE_DISPOSITION_INFO).");
 			result = messaging_delivery_released();
 		}
 		else
@@ -728,6 +745,13 @@ static int create_message_receiver(MESSENGER_INSTANCE* instance)
 			LogError("Failed setting message receiver link max message size.");
 		}
 
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_012: [If `instance->c2d_link_credit` is not 0, `instance->receiver_link` maximum link credit shall be set to it using link_set_max_link_credit(); if it fails, it shall be logged and ignored]
+		if (instance->c2d_link_credit != 0 &&
+			link_set_max_link_credit(instance->receiver_link, (uint32_t)instance->c2d_link_credit) != RESULT_OK)
+		{
+			LogError("Failed setting message receiver link credit to %lu.", (unsigned long)instance->c2d_link_credit);
+		}
+
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_084: [`instance->receiver_link` should have a property "com.microsoft:client-version" set as `CLIENT_DEVICE_TYPE_PREFIX/IOTHUB_SDK_VERSION`, using amqpvalue_set_map_value() and link_set_attach_properties()]
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_085: [If amqpvalue_set_map_value() or link_set_attach_properties() fail, the failure shall be ignored]
 		attach_device_client_type_to_link(instance->receiver_link, instance->product_info);
@@ -774,265 +798,366 @@ static int create_message_receiver(MESSENGER_INSTANCE* instance)
 	return result;
 }
 
-static int move_event_to_in_progress_list(MESSENGER_SEND_EVENT_TASK* task)
+static void move_event_to_in_progress_list(MESSENGER_SEND_EVENT_TASK* task)
 {
-	int result; 
-
-	if (singlylinkedlist_add(task->messenger->in_progress_list, (void*)task) == NULL)
-	{
-		result = __FAILURE__;
-		LogError("Failed moving event to in_progress list (singlylinkedlist_add failed)");
-	}
-	else
-	{
-		result = RESULT_OK;
-	}
-
-	return result;
+	DList_InsertTailList(&task->messenger->in_progress_list, &task->entry);
 }
 
-static bool find_MESSENGER_SEND_EVENT_TASK_on_list(LIST_ITEM_HANDLE list_item, const void* match_context)
+static void remove_event_from_in_progress_list(MESSENGER_SEND_EVENT_TASK *task)
 {
-	return (list_item != NULL && singlylinkedlist_item_get_value(list_item) == match_context);
+	// Re-initializing the entry makes removing a task that is no longer on a list harmless.
+	(void)DList_RemoveEntryList(&task->entry);
+	DList_InitializeListHead(&task->entry);
 }
 
-static void remove_event_from_in_progress_list(MESSENGER_SEND_EVENT_TASK *task)
+static void move_events_to_wait_to_send_list(MESSENGER_INSTANCE* instance)
 {
-	LIST_ITEM_HANDLE list_item = singlylinkedlist_find(task->messenger->in_progress_list, find_MESSENGER_SEND_EVENT_TASK_on_list, (void*)task);
+	PDLIST_ENTRY entry;
 
-	if (list_item != NULL)
+	// Events in progress are older than any event waiting to be sent, so starting from the newest
+	// each goes back to the head of `waiting_to_send`, keeping the order they were queued in.
+	while ((entry = instance->in_progress_list.Blink) != &instance->in_progress_list)
 	{
-		if (singlylinkedlist_remove(task->messenger->in_progress_list, list_item) != RESULT_OK)
-		{
-			LogError("Failed removing event from in_progress list (singlylinkedlist_remove failed)");
-		}
+		(void)DList_RemoveEntryList(entry);
+		DList_InsertHeadList(&instance->waiting_to_send, entry);
 	}
 }
 
-static int copy_events_to_list(SINGLYLINKEDLIST_HANDLE from_list, SINGLYLINKEDLIST_HANDLE to_list)
+static void complete_event_send_task(MESSENGER_SEND_EVENT_TASK* task, MESSAGE_SEND_RESULT send_result)
 {
-	int result;
-	LIST_ITEM_HANDLE list_item;
-
-	result = RESULT_OK;
-	list_item = singlylinkedlist_get_head_item(from_list);
-
-	while (list_item != NULL)
+	// Events cancelled by messagesender_destroy() stay in progress, so messenger_stop() can queue them
+	// again in their original order instead of failing them to the upper layer.
+	if (task->messenger->is_destroying_message_sender)
 	{
-		MESSENGER_SEND_EVENT_TASK *task = (MESSENGER_SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
-
-		if (singlylinkedlist_add(to_list, task) == NULL)
+		LogInfo("messenger on_event_send_complete_callback invoked for event %p while the message sender is destroyed; the event will be sent again.", task->message);
+	}
+	else if (task->messenger->message_sender_current_state != MESSAGE_SENDER_STATE_ERROR)
+	{
+		if (task->is_timed_out == false)
 		{
-			LogError("Failed copying event to destination list (singlylinkedlist_add failed)");
-			result = __FAILURE__;
-			break;
+			MESSENGER_EVENT_SEND_COMPLETE_RESULT messenger_send_result;
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_107: [If no failure occurs, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_OK]  
+			if (send_result == MESSAGE_SEND_OK)
+			{
+				messenger_send_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_OK;
+			}
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_108: [If a failure occurred, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING] 
+			else
+			{
+				messenger_send_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING;
+			}
+
+			task->on_event_send_complete_callback(task->message, messenger_send_result, (void*)task->context);
 		}
 		else
 		{
-			list_item = singlylinkedlist_get_next_item(list_item);
+			LogInfo("messenger on_event_send_complete_callback invoked for timed out event %p; not firing upper layer callback.", task->message);
 		}
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_128: [`task` shall be removed from `instance->in_progress_list`]  
+		remove_event_from_in_progress_list(task);
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_130: [`task` shall be destroyed using free()]  
+		free(task);
 	}
+}
 
-	return result;
+static void internal_on_event_send_complete_callback(void* context, MESSAGE_SEND_RESULT send_result)
+{ 
+	if (context != NULL)
+	{
+		complete_event_send_task((MESSENGER_SEND_EVENT_TASK*)context, send_result);
+	}
 }
 
-static int singlylinkedlist_clear(SINGLYLINKEDLIST_HANDLE list)
+static void internal_on_event_batch_send_complete_callback(void* context, MESSAGE_SEND_RESULT send_result)
 {
-	int result;
-	LIST_ITEM_HANDLE list_item;
-
-	result = RESULT_OK;
+	MESSENGER_SEND_EVENT_TASK* task = (MESSENGER_SEND_EVENT_TASK*)context;
 
-	while ((list_item = singlylinkedlist_get_head_item(list)) != NULL)
+	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_007: [When a batch completes, the result of its transfer shall be reported for each event of the batch as if it had been sent alone]
+	while (task != NULL)
 	{
-		if (singlylinkedlist_remove(list, list_item) != RESULT_OK)
-		{
-			LogError("Failed removing items from list (%d)", list);
-			result = __FAILURE__;
-			break;
-		}
+		MESSENGER_SEND_EVENT_TASK* next_task = task->next_in_batch;
+		complete_event_send_task(task, send_result);
+		task = next_task;
 	}
-
-	return result;
 }
 
-static int move_events_to_wait_to_send_list(MESSENGER_INSTANCE* instance)
+static MESSENGER_SEND_EVENT_TASK* get_next_event_to_send(MESSENGER_INSTANCE* instance)
 {
-	int result;
-	LIST_ITEM_HANDLE list_item;
+	MESSENGER_SEND_EVENT_TASK* task;
+	PDLIST_ENTRY entry = DList_RemoveHeadList(&instance->waiting_to_send);
 
-	if ((list_item = singlylinkedlist_get_head_item(instance->in_progress_list)) == NULL)
+	if (entry == &instance->waiting_to_send)
 	{
-		result = RESULT_OK;
+		task = NULL;
 	}
 	else
 	{
-		SINGLYLINKEDLIST_HANDLE new_wait_to_send_list;
-
-		if ((new_wait_to_send_list = singlylinkedlist_create()) == NULL)
-		{
-			LogError("Failed moving events back to wait_to_send list (singlylinkedlist_create failed to create new wait_to_send_list)");
-			result = __FAILURE__;
-		}
-		else
-		{
-			SINGLYLINKEDLIST_HANDLE new_in_progress_list;
-		
-			if (copy_events_to_list(instance->in_progress_list, new_wait_to_send_list) != RESULT_OK)
-			{
-				LogError("Failed moving events back to wait_to_send list (failed adding in_progress_list items to new_wait_to_send_list)");
-				singlylinkedlist_destroy(new_wait_to_send_list);
-				result = __FAILURE__;
-			}
-			else if (copy_events_to_list(instance->waiting_to_send, new_wait_to_send_list) != RESULT_OK)
-			{
-				LogError("Failed moving events back to wait_to_send list (failed adding wait_to_send items to new_wait_to_send_list)");
-				singlylinkedlist_destroy(new_wait_to_send_list);
-				result = __FAILURE__;
-			}
-			else if ((new_in_progress_list = singlylinkedlist_create()) == NULL)
-			{
-				LogError("Failed moving events back to wait_to_send list (singlylinkedlist_create failed to create new in_progress_list)");
-				singlylinkedlist_destroy(new_wait_to_send_list);
-				result = __FAILURE__;
-			}
-			else 
-			{
-				singlylinkedlist_destroy(instance->waiting_to_send);
-				singlylinkedlist_destroy(instance->in_progress_list);
-				instance->waiting_to_send = new_wait_to_send_list;
-				instance->in_progress_list = new_in_progress_list;
-				result = RESULT_OK;
-			}
-		}
+		task = containingRecord(entry, MESSENGER_SEND_EVENT_TASK, entry);
 	}
 
-	return result;
+	return task;
 }
 
-static void internal_on_event_send_complete_callback(void* context, MESSAGE_SEND_RESULT send_result)
-{ 
-	if (context != NULL)
+static int send_pending_events(MESSENGER_INSTANCE* instance)
+{
+	int result = RESULT_OK;
+
+	MESSENGER_SEND_EVENT_TASK* task;
+
+	while ((task = get_next_event_to_send(instance)) != NULL)
 	{
-		MESSENGER_SEND_EVENT_TASK* task = (MESSENGER_SEND_EVENT_TASK*)context;
+		int uamqp_result;
+		MESSAGE_HANDLE amqp_message = NULL;
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_153: [messenger_do_work() shall move each event to be sent from `instance->wait_to_send_list` to `instance->in_progress_list`] 
+		move_event_to_in_progress_list(task);
 
-		if (task->messenger->message_sender_current_state != MESSAGE_SENDER_STATE_ERROR)
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_154: [A MESSAGE_HANDLE shall be obtained out of the event's IOTHUB_MESSAGE_HANDLE instance by using message_create_from_iothub_message_with_key_cache(), passing `instance->property_key_cache`]  
+		if ((uamqp_result = message_create_from_iothub_message_with_key_cache(task->message->messageHandle, instance->property_key_cache, &amqp_message)) != RESULT_OK)
 		{
-			if (task->is_timed_out == false)
+			LogErrorLimited("Failed sending event message (failed creating AMQP message; error: %d).", uamqp_result);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_155: [If message_create_from_iothub_message() fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE]  
+			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, (void*)task->context);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_160: [If any failure occurs the event shall be removed from `instance->in_progress_list` and destroyed]  
+			remove_event_from_in_progress_list(task);
+			free(task);
+			
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_156: [If message_create_from_iothub_message() fails, messenger_do_work() shall skip to the next event to be sent]  
+		}
+		else
+		{
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_157: [The MESSAGE_HANDLE shall be submitted for sending using messagesender_send(), passing `internal_on_event_send_complete_callback`]  
+			uamqp_result = messagesender_send(instance->message_sender, amqp_message, internal_on_event_send_complete_callback, task);
+			task->send_time = get_time(NULL);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_159: [The MESSAGE_HANDLE shall be destroyed using message_destroy().]
+			message_destroy(amqp_message);
+
+			if (uamqp_result != RESULT_OK)
 			{
-				MESSENGER_EVENT_SEND_COMPLETE_RESULT messenger_send_result;
+				LogErrorLimited("Failed sending event (messagesender_send failed; error: %d)", uamqp_result);
 
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_107: [If no failure occurs, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_OK]  
-				if (send_result == MESSAGE_SEND_OK)
-				{
-					messenger_send_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_OK;
-				}
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_108: [If a failure occurred, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING] 
-				else
-				{
-					messenger_send_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING;
-				}
+				result = __FAILURE__;
+
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_158: [If messagesender_send() fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING]
+				task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, (void*)task->context);
+
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_160: [If any failure occurs the event shall be removed from `instance->in_progress_list` and destroyed]  
+				remove_event_from_in_progress_list(task);
+				free(task);
 
-				task->on_event_send_complete_callback(task->message, messenger_send_result, (void*)task->context);
+				break;
 			}
-			else
+			else if (task->message->traced)
 			{
-				LogInfo("messenger on_event_send_complete_callback invoked for timed out event %p; not firing upper layer callback.", task->message);
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_002: [For a traced event, IoTHubClient_LL_TraceMessage shall be called with IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN once messagesender_send() succeeds]
+				IoTHubClient_LL_TraceMessage(task->message, IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
 			}
-
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_128: [`task` shall be removed from `instance->in_progress_list`]  
-			remove_event_from_in_progress_list(task);
-
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_130: [`task` shall be destroyed using free()]  
-			free(task);
 		}
 	}
+
+	return result;
 }
 
-static MESSENGER_SEND_EVENT_TASK* get_next_event_to_send(MESSENGER_INSTANCE* instance)
+// @brief
+//     Checks if the events waiting to be sent shall be held back, so more events can be added to their batch.
+// @returns
+//     true if the events do not fill a batch and the oldest of them has waited less than `event_send_batch_linger_secs`, false otherwise.
+static bool should_linger_event_batch(MESSENGER_INSTANCE* instance)
 {
-	MESSENGER_SEND_EVENT_TASK* task;
-	LIST_ITEM_HANDLE list_item;
+	bool result;
+	PDLIST_ENTRY entry = instance->waiting_to_send.Flink;
 
-	if ((list_item = singlylinkedlist_get_head_item(instance->waiting_to_send)) == NULL)
+	if (entry == &instance->waiting_to_send || instance->event_send_batch_linger_secs == 0)
 	{
-		task = NULL;
+		result = false;
 	}
 	else
 	{
-		task = (MESSENGER_SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
+		MESSENGER_SEND_EVENT_TASK* oldest_task = containingRecord(entry, MESSENGER_SEND_EVENT_TASK, entry);
+		size_t count = 0;
+		int is_timed_out;
+
+		while (entry != &instance->waiting_to_send && count < instance->event_send_batch_max_count)
+		{
+			count++;
+			entry = entry->Flink;
+		}
 
-		if (singlylinkedlist_remove(instance->waiting_to_send, list_item) != RESULT_OK)
+		if (count >= instance->event_send_batch_max_count)
+		{
+			result = false;
+		}
+		else if (is_timeout_reached(oldest_task->enqueue_time, instance->event_send_batch_linger_secs, &is_timed_out) != RESULT_OK)
 		{
-			LogError("Failed removing item from waiting_to_send list (singlylinkedlist_remove failed)");
+			LogErrorLimited("messenger failed to evaluate the batch linger time; sending the events");
+			result = false;
+		}
+		else
+		{
+			result = (is_timed_out == 0);
 		}
 	}
 
-	return task;
+	return result;
 }
 
-static int send_pending_events(MESSENGER_INSTANCE* instance)
+static void fail_event_batch(MESSENGER_SEND_EVENT_TASK* batch)
 {
-	int result = RESULT_OK;
+	while (batch != NULL)
+	{
+		MESSENGER_SEND_EVENT_TASK* next_task = batch->next_in_batch;
 
-	MESSENGER_SEND_EVENT_TASK* task;
+		batch->on_event_send_complete_callback(batch->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, (void*)batch->context);
+		remove_event_from_in_progress_list(batch);
+		free(batch);
 
-	while ((task = get_next_event_to_send(instance)) != NULL)
+		batch = next_task;
+	}
+}
+
+// @brief
+//     Packs the next events of `instance->waiting_to_send` into one message with the AMQP batching format and sends it.
+// @returns
+//     0 if no failures occur, non-zero otherwise.
+static int send_next_event_batch(MESSENGER_INSTANCE* instance)
+{
+	int result = RESULT_OK;
+	MESSAGE_HANDLE batch_message;
+	MESSENGER_SEND_EVENT_TASK* batch_head = NULL;
+	MESSENGER_SEND_EVENT_TASK* batch_tail = NULL;
+	size_t batch_count = 0;
+	size_t batch_size = 0;
+
+	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_004: [The batch shall be a MESSAGE_HANDLE created with message_create() and set with the AMQP batching message format using message_set_message_format()]
+	if ((batch_message = message_create()) == NULL)
 	{
-		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_153: [messenger_do_work() shall move each event to be sent from `instance->wait_to_send_list` to `instance->in_progress_list`] 
-		if (move_event_to_in_progress_list(task) != RESULT_OK)
-		{
-			result = __FAILURE__;
-			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, (void*)task->context);
-			break;
-		}
-		else
+		LogError("Failed sending event batch (message_create failed)");
+		result = __FAILURE__;
+	}
+	else if (message_set_message_format(batch_message, AMQP_BATCHING_FORMAT_CODE) != RESULT_OK)
+	{
+		LogErrorLimited("Failed sending event batch (message_set_message_format failed)");
+		result = __FAILURE__;
+	}
+	else
+	{
+		while (batch_count < instance->event_send_batch_max_count &&
+			!DList_IsListEmpty(&instance->waiting_to_send))
 		{
-			int uamqp_result;
-			MESSAGE_HANDLE amqp_message = NULL;
+			MESSENGER_SEND_EVENT_TASK* task = containingRecord(instance->waiting_to_send.Flink, MESSENGER_SEND_EVENT_TASK, entry);
+			BINARY_DATA encoded_message;
 
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_154: [A MESSAGE_HANDLE shall be obtained out of the event's IOTHUB_MESSAGE_HANDLE instance by using message_create_from_iothub_message()]  
-			if ((uamqp_result = message_create_from_iothub_message(task->message->messageHandle, &amqp_message)) != RESULT_OK)
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_005: [Each event shall be added to the batch as a data section encoded with message_create_uamqp_encoding_from_iothub_message(), until the batch holds `event_send_batch_max_count` events or adding the next event would make it larger than the IoT Hub message size limit]
+			if (message_create_uamqp_encoding_from_iothub_message(task->message->messageHandle, &encoded_message) != RESULT_OK)
 			{
-				LogError("Failed sending event message (failed creating AMQP message; error: %d).", uamqp_result);
+				LogErrorLimited("Failed adding event to batch (failed encoding AMQP message)");
+				(void)get_next_event_to_send(instance);
 
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_155: [If message_create_from_iothub_message() fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE]  
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_006: [If an event cannot be encoded, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE and the event shall be destroyed]
 				task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, (void*)task->context);
-
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_160: [If any failure occurs the event shall be removed from `instance->in_progress_list` and destroyed]  
-				remove_event_from_in_progress_list(task);
 				free(task);
-				
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_156: [If message_create_from_iothub_message() fails, messenger_do_work() shall skip to the next event to be sent]  
+			}
+			else if (batch_count > 0 && batch_size + encoded_message.length > EVENT_SEND_BATCH_MAX_SIZE)
+			{
+				// The event stays at the head of waiting_to_send, it starts the next batch.
+				free((void*)encoded_message.bytes);
+				break;
 			}
 			else
 			{
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_157: [The MESSAGE_HANDLE shall be submitted for sending using messagesender_send(), passing `internal_on_event_send_complete_callback`]  
-				uamqp_result = messagesender_send(instance->message_sender, amqp_message, internal_on_event_send_complete_callback, task);
-				task->send_time = get_time(NULL);
+				int add_result;
+
+				(void)get_next_event_to_send(instance);
+				move_event_to_in_progress_list(task);
 
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_159: [The MESSAGE_HANDLE shall be destroyed using message_destroy().]
-				message_destroy(amqp_message);
+				add_result = message_add_body_amqp_data(batch_message, encoded_message);
+				free((void*)encoded_message.bytes);
 
-				if (uamqp_result != RESULT_OK)
+				task->next_in_batch = NULL;
+				if (batch_tail == NULL)
 				{
-					LogError("Failed sending event (messagesender_send failed; error: %d)", uamqp_result);
+					batch_head = task;
+				}
+				else
+				{
+					batch_tail->next_in_batch = task;
+				}
+				batch_tail = task;
 
+				if (add_result != RESULT_OK)
+				{
+					LogErrorLimited("Failed adding event to batch (message_add_body_amqp_data failed)");
 					result = __FAILURE__;
+					break;
+				}
 
-					// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_158: [If messagesender_send() fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING]
-					task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, (void*)task->context);
+				batch_count++;
+				batch_size += encoded_message.length;
+			}
+		}
+	}
 
-					// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_160: [If any failure occurs the event shall be removed from `instance->in_progress_list` and destroyed]  
-					remove_event_from_in_progress_list(task);
-					free(task);
+	if (batch_head != NULL)
+	{
+		if (result == RESULT_OK &&
+			messagesender_send(instance->message_sender, batch_message, internal_on_event_batch_send_complete_callback, batch_head) != RESULT_OK)
+		{
+			LogErrorLimited("Failed sending event batch (messagesender_send failed)");
+			result = __FAILURE__;
+		}
 
-					break;
+		if (result != RESULT_OK)
+		{
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_008: [If the batch fails to be sent, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING for each event of the batch, and the events shall be removed from `instance->in_progress_list` and destroyed]
+			fail_event_batch(batch_head);
+		}
+		else
+		{
+			MESSENGER_SEND_EVENT_TASK* task;
+			time_t send_time = get_time(NULL);
+
+			for (task = batch_head; task != NULL; task = task->next_in_batch)
+			{
+				task->send_time = send_time;
+
+				if (task->message->traced)
+				{
+					IoTHubClient_LL_TraceMessage(task->message, IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
 				}
 			}
 		}
 	}
 
+	if (batch_message != NULL)
+	{
+		message_destroy(batch_message);
+	}
+
+	return result;
+}
+
+// @brief
+//     Sends the events waiting to be sent in batches, holding back a batch that is not full for up to `event_send_batch_linger_secs`.
+// @returns
+//     0 if no failures occur, non-zero otherwise.
+static int send_pending_event_batches(MESSENGER_INSTANCE* instance)
+{
+	int result = RESULT_OK;
+
+	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_003: [If `instance->event_send_batch_max_count` is greater than 1, messenger_do_work() shall send the events in batches, holding back a batch that is not full until its oldest event has waited `instance->event_send_batch_linger_secs`]
+	while (result == RESULT_OK &&
+		!DList_IsListEmpty(&instance->waiting_to_send) &&
+		!should_linger_event_batch(instance))
+	{
+		result = send_next_event_batch(instance);
+	}
+
 	return result;
 }
 
@@ -1048,11 +1173,11 @@ static int process_event_send_timeouts(MESSENGER_INSTANCE* instance)
 
 	if (instance->event_send_timeout_secs > 0)
 	{
-		LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->in_progress_list);
+		PDLIST_ENTRY entry;
 
-		while (list_item != NULL)
+		for (entry = instance->in_progress_list.Flink; entry != &instance->in_progress_list; entry = entry->Flink)
 		{
-			MESSENGER_SEND_EVENT_TASK* task = (MESSENGER_SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
+			MESSENGER_SEND_EVENT_TASK* task = containingRecord(entry, MESSENGER_SEND_EVENT_TASK, entry);
 
 			if (task->is_timed_out == false)
 			{
@@ -1069,15 +1194,18 @@ static int process_event_send_timeouts(MESSENGER_INSTANCE* instance)
 							task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT, task->context);
 						}
 					}
+					else
+					{
+						// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_001: [Events are added to `instance->in_progress_list` in the order they are sent, so the timeout check shall stop at the first event that has not timed out]
+						break;
+					}
 				}
 				else
 				{
-					LogError("messenger failed to evaluate event send timeout of event %d", task->message);
+					LogErrorLimited("messenger failed to evaluate event send timeout of event %d", task->message);
 					result = __FAILURE__;
 				}
 			}
-
-			list_item = singlylinkedlist_get_next_item(list_item);
 		}
 	}
 
@@ -1088,11 +1216,14 @@ static int process_event_send_timeouts(MESSENGER_INSTANCE* instance)
 //     Removes all the timed out events from the in_progress_list, without invoking callbacks or detroying the messages.
 static void remove_timed_out_events(MESSENGER_INSTANCE* instance)
 {
-	LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->in_progress_list);
+	PDLIST_ENTRY entry = instance->in_progress_list.Flink;
 
-	while (list_item != NULL)
+	while (entry != &instance->in_progress_list)
 	{
-		MESSENGER_SEND_EVENT_TASK* task = (MESSENGER_SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
+		MESSENGER_SEND_EVENT_TASK* task = containingRecord(entry, MESSENGER_SEND_EVENT_TASK, entry);
+
+		// The next entry is saved first, `task` is freed below.
+		entry = entry->Flink;
 
 		if (task->is_timed_out == true)
 		{
@@ -1100,8 +1231,6 @@ static void remove_timed_out_events(MESSENGER_INSTANCE* instance)
 
 			free(task);
 		}
-
-		list_item = singlylinkedlist_get_next_item(list_item);
 	}
 }
 
@@ -1125,6 +1254,9 @@ static void* messenger_clone_option(const char* name, const void* value)
 	else
 	{
 		if (strcmp(MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0 ||
+			strcmp(MESSENGER_OPTION_EVENT_SEND_BATCH_MAX_COUNT, name) == 0 ||
+			strcmp(MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_SECS, name) == 0 ||
+			strcmp(MESSENGER_OPTION_C2D_LINK_CREDIT, name) == 0 ||
 			strcmp(MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
 		{
 			result = (void*)value;
@@ -1284,7 +1416,7 @@ int messenger_send_message_disposition(MESSENGER_HANDLE messenger_handle, MESSEN
 				if (messagereceiver_send_message_disposition(messenger->message_receiver, disposition_info->source, disposition_info->message_id, uamqp_disposition_result) != RESULT_OK)
 				{
 					// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_183: [If `messagereceiver_send_message_disposition()` fails, messenger_send_message_disposition() shall fail and return __FAILURE__]  
-					LogError("Failed sending message disposition (messagereceiver_send_message_disposition failed)");
+					LogErrorLimited("Failed sending message disposition (messagereceiver_send_message_disposition failed)");
 					result = __FAILURE__;
 				}
 				else
@@ -1333,19 +1465,8 @@ int messenger_send_async(MESSENGER_HANDLE messenger_handle, IOTHUB_MESSAGE_LIST*
 		if ((task = (MESSENGER_SEND_EVENT_TASK*)malloc(sizeof(MESSENGER_SEND_EVENT_TASK))) == NULL)
 		{
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_138: [If malloc() fails, messenger_send_async() shall fail and return a non-zero value]
-			LogError("Failed sending event (failed to create struct for task; malloc failed)");
-			result = __FAILURE__;
-		}
-		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_100: [`task` shall be added to `instance->waiting_to_send` using singlylinkedlist_add()]  
-		else if (singlylinkedlist_add(instance->waiting_to_send, task) == NULL)
-		{
-			LogError("Failed sending event (singlylinkedlist_add failed)");
-
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_139: [If singlylinkedlist_add() fails, messenger_send_async() shall fail and return a non-zero value]
+			LogErrorLimited("Failed sending event (failed to create struct for task; malloc failed)");
 			result = __FAILURE__;
-
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_142: [If any failure occurs, messenger_send_async() shall free any memory it has allocated]
-			free(task);
 		}
 		else
 		{
@@ -1356,6 +1477,10 @@ int messenger_send_async(MESSENGER_HANDLE messenger_handle, IOTHUB_MESSAGE_LIST*
 			task->send_time = INDEFINITE_TIME;
 			task->messenger = instance;
 			task->is_timed_out = false;
+			task->enqueue_time = (instance->event_send_batch_max_count > 1 ? get_time(NULL) : INDEFINITE_TIME);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_100: [`task` shall be added to the tail of `instance->waiting_to_send` using DList_InsertTailList()]  
+			DList_InsertTailList(&instance->waiting_to_send, &task->entry);
 			
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_143: [If no failures occur, messenger_send_async() shall return zero]  
 			result = RESULT_OK;
@@ -1384,11 +1509,9 @@ int messenger_get_send_status(MESSENGER_HANDLE messenger_handle, MESSENGER_SEND_
 	else
 	{
 		MESSENGER_INSTANCE* instance = (MESSENGER_INSTANCE*)messenger_handle;
-		LIST_ITEM_HANDLE wts_list_head = singlylinkedlist_get_head_item(instance->waiting_to_send);
-		LIST_ITEM_HANDLE ip_list_head = singlylinkedlist_get_head_item(instance->in_progress_list);
 
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_147: [If `instance->in_progress_list` and `instance->wait_to_send_list` are empty, send_status shall be set to MESSENGER_SEND_STATUS_IDLE] 
-		if (wts_list_head == NULL && ip_list_head == NULL)
+		if (DList_IsListEmpty(&instance->waiting_to_send) && DList_IsListEmpty(&instance->in_progress_list))
 		{
 			*send_status = MESSENGER_SEND_STATUS_IDLE;
 		}
@@ -1478,20 +1601,11 @@ int messenger_stop(MESSENGER_HANDLE messenger_handle)
 			remove_timed_out_events(instance);
 
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_162: [messenger_stop() shall move all items from `instance->in_progress_list` to the beginning of `instance->wait_to_send_list`]
-			if (move_events_to_wait_to_send_list(instance) != RESULT_OK)
-			{
-				LogError("Messenger failed to move events in progress back to wait_to_send list");
-				
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_163: [If not all items from `instance->in_progress_list` can be moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_ERROR, and `instance->on_state_changed_callback` invoked]
-				update_messenger_state(instance, MESSENGER_STATE_ERROR);
-				result = __FAILURE__;
-			}
-			else
-			{
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_164: [If all items get successfuly moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_STOPPED, and `instance->on_state_changed_callback` invoked]
-				update_messenger_state(instance, MESSENGER_STATE_STOPPED);
-				result = RESULT_OK;
-			}
+			move_events_to_wait_to_send_list(instance);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_164: [Once all items are moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_STOPPED, and `instance->on_state_changed_callback` invoked]
+			update_messenger_state(instance, MESSENGER_STATE_STOPPED);
+			result = RESULT_OK;
 		}
 	}
 
@@ -1616,7 +1730,8 @@ void messenger_do_work(MESSENGER_HANDLE messenger_handle)
 			{
 				update_messenger_state(instance, MESSENGER_STATE_ERROR);
 			}
-			else if (send_pending_events(instance) != RESULT_OK && instance->event_send_retry_limit > 0)
+			else if ((instance->event_send_batch_max_count > 1 ? send_pending_event_batches(instance) : send_pending_events(instance)) != RESULT_OK &&
+				instance->event_send_retry_limit > 0)
 			{
 				instance->event_send_error_count++;
 
@@ -1644,7 +1759,7 @@ void messenger_destroy(MESSENGER_HANDLE messenger_handle)
 	}
 	else
 	{
-		LIST_ITEM_HANDLE list_node;
+		PDLIST_ENTRY entry;
 		MESSENGER_INSTANCE* instance = (MESSENGER_INSTANCE*)messenger_handle;
 
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_110: [If the `instance->state` is not MESSENGER_STATE_STOPPED, messenger_destroy() shall invoke messenger_stop()]
@@ -1655,46 +1770,31 @@ void messenger_destroy(MESSENGER_HANDLE messenger_handle)
 
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_111: [All elements of `instance->in_progress_list` and `instance->wait_to_send_list` shall be removed, invoking `task->on_event_send_complete_callback` for each with EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED]
 
-		// Note: yes messenger_stop() tried to move all events from in_progress_list to wait_to_send_list, 
-		//       but we need to iterate through in case any events failed to be moved.
-		while ((list_node = singlylinkedlist_get_head_item(instance->in_progress_list)) != NULL)
+		// Note: messenger_stop() is not invoked if the messenger is already stopped, so in_progress_list is walked as well.
+		while ((entry = DList_RemoveHeadList(&instance->in_progress_list)) != &instance->in_progress_list)
 		{
-			MESSENGER_SEND_EVENT_TASK* task = (MESSENGER_SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_node);
+			MESSENGER_SEND_EVENT_TASK* task = containingRecord(entry, MESSENGER_SEND_EVENT_TASK, entry);
 
-			(void)singlylinkedlist_remove(instance->in_progress_list, list_node);
-
-			if (task != NULL)
-			{
-				task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED, (void*)task->context);
-				free(task);
-			}
+			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED, (void*)task->context);
+			free(task);
 		}
 
-		while ((list_node = singlylinkedlist_get_head_item(instance->waiting_to_send)) != NULL)
+		while ((entry = DList_RemoveHeadList(&instance->waiting_to_send)) != &instance->waiting_to_send)
 		{
-			MESSENGER_SEND_EVENT_TASK* task = (MESSENGER_SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_node);
-
-			(void)singlylinkedlist_remove(instance->waiting_to_send, list_node);
+			MESSENGER_SEND_EVENT_TASK* task = containingRecord(entry, MESSENGER_SEND_EVENT_TASK, entry);
 
-			if (task != NULL)
-			{
-				task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED, (void*)task->context);
-				free(task);
-			}
+			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED, (void*)task->context);
+			free(task);
 		}
 
-		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_150: [`instance->in_progress_list` and `instance->wait_to_send_list` shall be destroyed using singlylinkedlist_destroy()]
-		singlylinkedlist_destroy(instance->waiting_to_send);
-		singlylinkedlist_destroy(instance->in_progress_list);
-
-		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_112: [`instance->iothub_host_fqdn` shall be destroyed using STRING_delete()]
-		STRING_delete(instance->iothub_host_fqdn);
-		
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_113: [`instance->device_id` shall be destroyed using STRING_delete()]
 		STRING_delete(instance->device_id);
 
         STRING_delete(instance->product_info);
 
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_017: [`instance->property_key_cache` shall be destroyed using uamqp_property_key_cache_destroy()]
+		uamqp_property_key_cache_destroy(instance->property_key_cache);
+
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [messenger_destroy() shall destroy `instance` with free()]
 		(void)free(instance);
 	}
@@ -1746,6 +1846,12 @@ MESSENGER_HANDLE messenger_create(const MESSENGER_CONFIG* messenger_config, cons
 			instance->last_message_sender_state_change_time = INDEFINITE_TIME;
 			instance->last_message_receiver_state_change_time = INDEFINITE_TIME;
 
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_165: [`instance->wait_to_send_list` shall be initialized using DList_InitializeListHead()]
+			DList_InitializeListHead(&instance->waiting_to_send);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_132: [`instance->in_progress_list` shall be initialized using DList_InitializeListHead()]  
+			DList_InitializeListHead(&instance->in_progress_list);
+
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_008: [messenger_create() shall save a copy of `messenger_config->device_id` into `instance->device_id`]
 			if ((instance->device_id = STRING_construct(messenger_config->device_id)) == NULL)
 			{
@@ -1758,29 +1864,18 @@ MESSENGER_HANDLE messenger_create(const MESSENGER_CONFIG* messenger_config, cons
                 handle = NULL;
                 LogError("messenger_create failed (product_info could not be copied; STRING_construct failed)");
             }
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_010: [messenger_create() shall save a copy of `messenger_config->iothub_host_fqdn` into `instance->iothub_host_fqdn`]
-			else if ((instance->iothub_host_fqdn = STRING_construct(messenger_config->iothub_host_fqdn)) == NULL)
-			{
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_011: [If STRING_construct() fails, messenger_create() shall fail and return NULL]
-				handle = NULL;
-				LogError("messenger_create failed (iothub_host_fqdn could not be copied; STRING_construct failed)");
-			}
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_165: [`instance->wait_to_send_list` shall be set using singlylinkedlist_create()]
-			else if ((instance->waiting_to_send = singlylinkedlist_create()) == NULL)
-			{
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_166: [If singlylinkedlist_create() fails, messenger_create() shall fail and return NULL]  
-				handle = NULL;
-				LogError("messenger_create failed (singlylinkedlist_create failed to create wait_to_send_list)");
-			}
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_132: [`instance->in_progress_list` shall be set using singlylinkedlist_create()]  
-			else if ((instance->in_progress_list = singlylinkedlist_create()) == NULL)
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_015: [messenger_create() shall create `instance->property_key_cache` using uamqp_property_key_cache_create(), so the events sent reuse the AMQP values of their application property names]
+			else if ((instance->property_key_cache = uamqp_property_key_cache_create()) == NULL)
 			{
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_133: [If singlylinkedlist_create() fails, messenger_create() shall fail and return NULL] 
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_016: [If uamqp_property_key_cache_create() fails, messenger_create() shall fail and return NULL]
 				handle = NULL;
-				LogError("messenger_create failed (singlylinkedlist_create failed to create in_progress_list)");
+				LogError("messenger_create failed (uamqp_property_key_cache_create failed)");
 			}
 			else
 			{
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_019: [messenger_create() shall keep `messenger_config->iothub_host_fqdn` in `instance->iothub_host_fqdn` without copying it, the FQDN belongs to the transport and outlives its devices]
+				instance->iothub_host_fqdn = messenger_config->iothub_host_fqdn;
+
 				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_013: [`messenger_config->on_state_changed_callback` shall be saved into `instance->on_state_changed_callback`]
 				instance->on_state_changed_callback = messenger_config->on_state_changed_callback;
 
@@ -1822,6 +1917,24 @@ int messenger_set_option(MESSENGER_HANDLE messenger_handle, const char* name, vo
 			instance->event_send_timeout_secs = *((size_t*)value);
 			result = RESULT_OK;
 		}
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_009: [If name matches MESSENGER_OPTION_EVENT_SEND_BATCH_MAX_COUNT, `value` shall be saved on `instance->event_send_batch_max_count`]
+		else if (strcmp(MESSENGER_OPTION_EVENT_SEND_BATCH_MAX_COUNT, name) == 0)
+		{
+			instance->event_send_batch_max_count = *((size_t*)value);
+			result = RESULT_OK;
+		}
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_010: [If name matches MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_SECS, `value` shall be saved on `instance->event_send_batch_linger_secs`]
+		else if (strcmp(MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_SECS, name) == 0)
+		{
+			instance->event_send_batch_linger_secs = *((size_t*)value);
+			result = RESULT_OK;
+		}
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_013: [If name matches MESSENGER_OPTION_C2D_LINK_CREDIT, `value` shall be saved on `instance->c2d_link_credit`, to be applied when the message receiver is created]
+		else if (strcmp(MESSENGER_OPTION_C2D_LINK_CREDIT, name) == 0)
+		{
+			instance->c2d_link_credit = *((size_t*)value);
+			result = RESULT_OK;
+		}
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
 		else if (strcmp(MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
 		{
@@ -1880,6 +1993,21 @@ OPTIONHANDLER_HANDLE messenger_retrieve_options(MESSENGER_HANDLE messenger_handl
 				LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS);
 				result = NULL;
 			}
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_011: [The batching options shall be added to the OPTIONHANDLER_HANDLE instance only if batching is enabled]
+			else if (instance->event_send_batch_max_count > 1 &&
+				(OptionHandler_AddOption(options, MESSENGER_OPTION_EVENT_SEND_BATCH_MAX_COUNT, (void*)&instance->event_send_batch_max_count) != OPTIONHANDLER_OK ||
+				 OptionHandler_AddOption(options, MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_SECS, (void*)&instance->event_send_batch_linger_secs) != OPTIONHANDLER_OK))
+			{
+				LogError("Failed to retrieve options from messenger instance (OptionHandler_AddOption failed for the batching options)");
+				result = NULL;
+			}
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_014: [MESSENGER_OPTION_C2D_LINK_CREDIT shall be added to the OPTIONHANDLER_HANDLE instance only if it has been set]
+			else if (instance->c2d_link_credit != 0 &&
+				OptionHandler_AddOption(options, MESSENGER_OPTION_C2D_LINK_CREDIT, (void*)&instance->c2d_link_credit) != OPTIONHANDLER_OK)
+			{
+				LogError("Failed to retrieve options from messenger instance (OptionHandler_AddOption failed for option '%s')", MESSENGER_OPTION_C2D_LINK_CREDIT);
+				result = NULL;
+			}
 			else
 			{
 				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_179: [If no failures occur, messenger_retrieve_options shall return the OPTIONHANDLER_HANDLE instance]
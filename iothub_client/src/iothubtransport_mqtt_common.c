@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <ctype.h>
+#include <stdio.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 
@@ -14,6 +15,10 @@
 #include "iothub_client_ll.h"
 #include "iothub_client_options.h"
 #include "iothub_client_private.h"
+#include "iothub_client_retry_control.h"
+#include "iothub_client_happy_eyeballs.h"
+#include "iothub_client_coalescing_io.h"
+#include "iothub_client_connection_health.h"
 #include "azure_umqtt_c/mqtt_client.h"
 #include "azure_c_shared_utility/sastoken.h"
 #include "azure_c_shared_utility/tickcounter.h"
@@ -21,10 +26,11 @@
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/platform.h"
 
-#include "azure_c_shared_utility/string_tokenizer.h"
 #include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/urlencode.h"
 #include "iothub_client_version.h"
+#include "iothub_client_trace.h"
+#include "iothub_client_log_limit.h"
 
 #include "iothubtransport_mqtt_common.h"
 
@@ -34,6 +40,9 @@
 #include <limits.h>
 #include <inttypes.h>
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT
+#include "iothub_client_memory_tag.h"
+
 #define SAS_TOKEN_DEFAULT_LIFETIME  3600
 #define SAS_REFRESH_MULTIPLIER      .8
 #define EPOCH_TIME_T_VALUE          0
@@ -46,11 +55,19 @@
 #define FAILED_CONN_BACKOFF_VALUE   5
 #define STATUS_CODE_FAILURE_VALUE   500
 #define STATUS_CODE_TIMEOUT_VALUE   408
-#define ERROR_TIME_FOR_RETRY_SECS   5       // We won't retry more than once every 5 seconds
-
-static const char TOPIC_DEVICE_TWIN_PREFIX[] = "$iothub/twin";
-static const char TOPIC_DEVICE_METHOD_PREFIX[] = "$iothub/methods";
-
+#define PACKET_ID_TABLE_INITIAL_CAPACITY    16
+#define PACKET_ID_TABLE_MAX_CAPACITY        65536   // every packet id fits with a free slot left
+#define KEEPALIVE_PROBE_INTERVALS           2       // an adaptive keepalive is kept once a connection stayed up for this many intervals
+#define TWIN_TOPIC_MAX_LENGTH               64      // the twin topics with the longest request id (65535) and the terminating NUL
+#define STATUS_CODE_MAX_LENGTH              11      // an int written in decimal with its sign
+#define KEEPALIVE_PING_LEAD_SECS            9       // mqtt_client_dowork pings once its seconds without a packet plus 10 exceed the keepalive
+
+static const char TOPIC_IOTHUB_PREFIX[] = "$iothub";
+static const char TOPIC_DEVICE_TWIN_SEGMENT[] = "twin";
+static const char TOPIC_DEVICE_METHOD_SEGMENT[] = "methods";
+
+// A filter never subscribed: the hub answers its UNSUBSCRIBE at once, the probe of the connection health
+static const char* TOPIC_DEVICE_MSG_PROBE = "devices/%s/messages/devicebound/connection-probe";
 static const char* TOPIC_GET_DESIRED_STATE = "$iothub/twin/res/#";
 static const char* TOPIC_NOTIFICATION_STATE = "$iothub/twin/PATCH/properties/desired/#";
 
@@ -72,6 +89,13 @@ static const char* REQUEST_ID_PROPERTY = "?$rid=";
 static const char* MESSAGE_ID_PROPERTY = "mid";
 static const char* CORRELATION_ID_PROPERTY = "cid";
 
+static const char* SYSTEM_PROPERTY_MESSAGE_ID = "%24.mid=";
+static const char* SYSTEM_PROPERTY_CORRELATION_ID = "%24.cid=";
+
+// The property of an envelope of packed messages, and the length written before each of them
+static const char* PACKED_COUNT_PROPERTY = "packed-count=";
+#define PACKED_LENGTH_PREFIX_SIZE               4
+
 #define UNSUBSCRIBE_FROM_TOPIC                  0x0000
 #define SUBSCRIBE_GET_REPORTED_STATE_TOPIC      0x0001
 #define SUBSCRIBE_NOTIFICATION_STATE_TOPIC      0x0002
@@ -113,22 +137,6 @@ typedef enum MQTT_TRANSPORT_CREDENTIAL_TYPE_TAG
     DEVICE_KEY,
 } MQTT_TRANSPORT_CREDENTIAL_TYPE;
 
-typedef int(*RETRY_POLICY)(bool *permit, size_t* delay, void* retryContextCallback);
-
-typedef struct RETRY_LOGIC_TAG
-{
-    IOTHUB_CLIENT_RETRY_POLICY retryPolicy; // Type of policy we're using
-    size_t retryTimeoutLimitInSeconds;      // If we don't connect in this many seconds, give up even trying.
-    RETRY_POLICY fnRetryPolicy;             // Pointer to the policy function
-    time_t start;                           // When did we start retrying?
-    time_t lastConnect;                     // When did we last try to connect?
-    bool retryStarted;                      // true if the retry timer is set and we're trying to retry
-    bool retryExpired;                      // true if we haven't connected in retryTimeoutLimitInSeconds seconds
-    bool firstAttempt;                      // true on init so we can connect the first time without waiting for any timeouts.
-    size_t retrycount;                      // How many times have we tried connecting?
-    size_t delayFromLastConnectToRetry;     // last time delta betweewn retry attempts.
-} RETRY_LOGIC;
-
 typedef enum MQTT_CLIENT_STATUS_TAG
 {
     MQTT_CLIENT_STATUS_NOT_CONNECTED,
@@ -136,8 +144,62 @@ typedef enum MQTT_CLIENT_STATUS_TAG
     MQTT_CLIENT_STATUS_CONNECTED
 } MQTT_CLIENT_STATUS;
 
+// The telemetry topic without the property values: the event topic followed by one "key=" segment per property,
+// each segment but the first one starting with the property separator. The text is not NUL terminated.
+#define INCOMING_TOPIC_SEGMENT_COUNT 5
+
+// A part of an incoming topic, not NUL terminated
+typedef struct TOPIC_SLICE_TAG
+{
+    const char* text;
+    size_t length;
+} TOPIC_SLICE;
+
+// The first segments of an incoming topic, enough for $iothub/twin/res/{status code}/?$rid={request id} and
+// $iothub/methods/POST/{method name}/?$rid={request id}. The last one runs to the next '/' or the end of the topic.
+typedef struct INCOMING_TOPIC_TAG
+{
+    TOPIC_SLICE segments[INCOMING_TOPIC_SEGMENT_COUNT];
+    size_t segmentCount;
+} INCOMING_TOPIC;
+
+typedef struct TELEMETRY_TOPIC_TEMPLATE_TAG
+{
+    size_t keyCount;
+    size_t prefixLength;
+    size_t textLength;
+    size_t* segmentEnds;
+    char* text;
+} TELEMETRY_TOPIC_TEMPLATE;
+
+// Open addressing table from the packet id of a publish to the entry waiting for its answer, so acks are matched
+// without walking the waiting list. A slot is free when its entry is NULL; packet ids come out of get_next_packet_id
+// in sequence so the id masked with the capacity is used as the home slot.
+typedef struct PACKET_ID_SLOT_TAG
+{
+    uint16_t packet_id;
+    void* entry;
+} PACKET_ID_SLOT;
+
+typedef struct PACKET_ID_TABLE_TAG
+{
+    PACKET_ID_SLOT* slots;
+    size_t capacity;                        // power of two
+    size_t count;
+} PACKET_ID_TABLE;
+
+// The device handles given out by IoTHubTransport_MQTT_Common_Register are either the transport data, for the device
+// of the connection, or a bridged device; both start with their kind.
+typedef enum MQTT_DEVICE_HANDLE_KIND_TAG
+{
+    MQTT_DEVICE_HANDLE_TRANSPORT,
+    MQTT_DEVICE_HANDLE_BRIDGED
+} MQTT_DEVICE_HANDLE_KIND;
+
 typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 {
+    MQTT_DEVICE_HANDLE_KIND kind;
+
     // Topic control
     STRING_HANDLE topic_MqttEvent;
     STRING_HANDLE topic_MqttMessage;
@@ -147,6 +209,20 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     STRING_HANDLE topic_DeviceMethods;
 
     uint32_t topics_ToSubscribe;
+    // Topics subscribed in the current mqtt session, kept by the service with a persistent session
+    uint32_t topics_Subscribed;
+    uint32_t topics_AwaitingSuback;
+    bool persistentSession;
+    // Reopens the same xioTransport on a reconnect instead of creating a new one
+    bool keepUnderlyingIO;
+    // Shared with other transports to race IPv6 and IPv4 and remember the family that won (not owned)
+    HAPPY_EYEBALLS_HANDLE happyEyeballs;
+    // The writes of a DoWork are coalesced in up to writeCoalescingSize bytes by xioCoalescing, on top of xioTransport
+    size_t writeCoalescingSize;
+    // Probes the connection once its acknowledgements are late for their round trip time, by unsubscribing topic_Probe
+    CONNECTION_HEALTH_HANDLE connectionHealth;
+    STRING_HANDLE topic_Probe;
+    uint16_t probePacketId;
 
     // Connection related constants
     STRING_HANDLE hostAddress;
@@ -170,6 +246,7 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     // Protocol 
     MQTT_CLIENT_HANDLE mqttClient;
     XIO_HANDLE xioTransport;
+    XIO_HANDLE xioCoalescing;
 
     // Session - connection
     uint16_t packetId;
@@ -181,6 +258,15 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     bool device_twin_get_sent;
     bool isRecoverableError;
     uint16_t keepAliveValue;
+    // Adaptive keepalive, keepAliveValue is probed from keepAliveSafe up to keepAliveMax (0 when disabled)
+    uint16_t keepAliveMax;
+    uint16_t keepAliveSafe;
+    bool keepAliveSettled;
+    // When mqtt_client pings, as seen by IoTHubTransport_MQTT_Common_GetNextWorkDeadline: a packet given to mqtt_client
+    // since it last looked moves lastPacketSentTime to the time it looks
+    bool isPacketSent;
+    bool isPingDue;                                     // mqtt_client pings in the next mqtt_client_dowork
+    tickcounter_ms_t lastPacketSentTime;
     tickcounter_ms_t mqtt_connect_time;
     size_t connectFailCount;
     tickcounter_ms_t connectTick;
@@ -191,15 +277,30 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     // Internal lists for message tracking
     PDLIST_ENTRY waitingToSend;
     DLIST_ENTRY ack_waiting_queue;
+    PACKET_ID_TABLE deviceTwinByPacketId;               // the items of ack_waiting_queue by $rid
 
     // Message tracking
     CONTROL_PACKET_TYPE currPacketState;
 
     // Telemetry specific
     DLIST_ENTRY telemetry_waitingForAck;
+    PACKET_ID_TABLE telemetryByPacketId;                // the messages of telemetry_waitingForAck by packet id
+    TELEMETRY_TOPIC_TEMPLATE* telemetryTopicTemplate;   // built for the property keys of the last published message
+    char* telemetryTopicBuffer;                         // the topic of each published message and method response is written here
+    size_t telemetryTopicBufferSize;
+    size_t maxInflight;                                 // most messages in telemetry_waitingForAck, 0 for no limit
+    size_t inflightCount;
+    bool resendInflight;                                // republish telemetry_waitingForAck once reconnected
+    bool telemetryAtMostOnce;                           // publish the messages with the default delivery at QoS 0
+    IOTHUB_MQTT_PACKING_OPTIONS packing;                // maxEnvelopeSize 0 while the messages are published alone
+    bool isPackingLingering;                            // set while an envelope that is not full waits for more messages
+    tickcounter_ms_t packingLingerStartTime;
 
     //Retry Logic
-    RETRY_LOGIC* retryLogic;
+    RETRY_CONTROL_HANDLE retryControl;
+    unsigned int retryInitialWaitTimeInMs;              // set on each retry control created, 0 for the default of its policy
+    bool isFirstConnectionAttempted;                    // the first connection is attempted whatever the retry policy
+    bool retryExpired;                                  // the retry control stopped retrying, logged once
 
     // Auth module used to generating handle authorization
     // with either SAS Token, x509 Certs, and Device SAS Token
@@ -209,8 +310,30 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     int http_proxy_port;
     char* http_proxy_username;
     char* http_proxy_password;
+
+    // Gateway bridge, the telemetry of leaf devices published over the connection to the protocol gateway
+    bool isProtocolGateway;
+    bool isGatewayBridge;
+    DLIST_ENTRY bridgedDevices;
+
+    // Sleepy device, the session kept for the next wake (sessionState NULL when disabled)
+    IOTHUB_MQTT_SLEEPY_DEVICE_OPTIONS sleepyDevice;
+    bool powerDownReported;                             // the callback was called since the last work to do
 } MQTTTRANSPORT_HANDLE_DATA, *PMQTTTRANSPORT_HANDLE_DATA;
 
+// A leaf device registered on a gateway bridge. Its messages are published on its own event topic and completed to its
+// own client; the connection, its status and the twin, methods and cloud to device messages belong to the transport device.
+typedef struct MQTT_BRIDGED_DEVICE_TAG
+{
+    MQTT_DEVICE_HANDLE_KIND kind;
+    MQTTTRANSPORT_HANDLE_DATA* transport_data;
+    STRING_HANDLE device_id;
+    TELEMETRY_TOPIC_TEMPLATE* telemetryTopicTemplate;
+    PDLIST_ENTRY waitingToSend;
+    IOTHUB_CLIENT_LL_HANDLE llClientHandle;
+    DLIST_ENTRY entry;
+} MQTT_BRIDGED_DEVICE;
+
 typedef struct MQTT_DEVICE_TWIN_ITEM_TAG
 {
     tickcounter_ms_t msgPublishTime;
@@ -229,10 +352,23 @@ typedef struct MQTT_MESSAGE_DETAILS_LIST_TAG
     size_t retryCount;
     IOTHUB_MESSAGE_LIST* iotHubMessageEntry;
     void* context;
+    MQTT_BRIDGED_DEVICE* bridgedDevice;                 // NULL for the messages of the transport device
     uint16_t packet_id;
+    // An envelope: its messages, iotHubMessageEntry being the first one, and the payload made of them
+    size_t packedCount;                                 // 0 for a message published alone
+    DLIST_ENTRY packedMessages;
+    unsigned char* packedPayload;
+    size_t packedPayloadLength;
     DLIST_ENTRY entry;
 } MQTT_MESSAGE_DETAILS_LIST, *PMQTT_MESSAGE_DETAILS_LIST;
 
+typedef enum MQTT_PACKING_RESULT_TAG
+{
+    MQTT_PACKING_PUBLISH_ALONE,                         // the message is published as it is
+    MQTT_PACKING_PUBLISHED,                             // the messages of an envelope were published, or completed with an error
+    MQTT_PACKING_LINGER                                 // the messages wait for more of them
+} MQTT_PACKING_RESULT;
+
 typedef struct DEVICE_METHOD_INFO_TAG
 {
     STRING_HANDLE request_id;
@@ -259,314 +395,244 @@ static void free_proxy_data(MQTTTRANSPORT_HANDLE_DATA* mqtt_transport_instance)
     }
 }
 
-static int RetryPolicy_Exponential_BackOff_With_Jitter(bool *permit, size_t* delay, void* retryContextCallback)
+int IoTHubTransport_MQTT_Common_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
 {
     int result;
-
-    if (retryContextCallback != NULL && permit != NULL && delay != NULL)
+    PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
+    if (transport_data == NULL)
     {
-        RETRY_LOGIC *retryLogic = (RETRY_LOGIC*)retryContextCallback;
-        int numOfFailures = (int) retryLogic->retrycount;
-        *permit = true;
-
-        /*Intentionally not evaluating fraction of a second as it woudn't work on all platforms*/
-
-        /* Exponential backoff with jitter
-            1. delay = (pow(2, attempt) - 1 ) / 2
-            2. delay with jitter = delay + rand_between(0, delay/2)
-        */
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_041: [**If any handle is NULL then IoTHubTransport_MQTT_Common_SetRetryPolicy shall return resultant line.] */
+        LogError("Invalid handle parameter. NULL.");
+        result = __FAILURE__;
+    }
+    else
+    {
+        RETRY_CONTROL_HANDLE new_retry_control;
 
-        size_t halfDelta = ((1 << numOfFailures) - 1) / 4;
-        if (halfDelta > 0)
+        /*Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_042: [**IoTHubTransport_MQTT_Common_SetRetryPolicy shall create the retry control by calling retry_control_create with retry policy and retryTimeout as parameters]*/
+        if ((new_retry_control = retry_control_create(retryPolicy, (unsigned int)retryTimeoutLimitInSeconds)) == NULL)
         {
-            *delay = halfDelta + (rand() % (int)halfDelta);
+            /*Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_044: [**If retry control for specified parameters of retry policy and retryTimeoutLimitInSeconds cannot be created then IoTHubTransport_MQTT_Common_SetRetryPolicy shall return resultant line]*/
+            LogError("Retry Logic is not created");
+            result = __FAILURE__;
         }
         else
         {
-            *delay = halfDelta;
-        }
+            /*Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_027: [**If `retry_initial_wait_time_in_ms` was set, IoTHubTransport_MQTT_Common_SetRetryPolicy shall set it on the new retry control using retry_control_set_option]*/
+            if (transport_data->retryInitialWaitTimeInMs != 0 &&
+                retry_control_set_option(new_retry_control, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, &transport_data->retryInitialWaitTimeInMs) != 0)
+            {
+                LogError("Failed setting the initial wait time on the new retry policy; the default of the policy is used");
+            }
 
-        result = 0;
-    }
-    else
-    {
-        result = __FAILURE__;
+            /*Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_043: [**If the retry control is already created then IoTHubTransport_MQTT_Common_SetRetryPolicy shall destroy the existing retry control]*/
+            retry_control_destroy(transport_data->retryControl);
+            transport_data->retryControl = new_retry_control;
+            transport_data->retryExpired = false;
+
+            /*Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_045: [**If retry control for specified parameters of retry policy and retryTimeoutLimitInSeconds is created successfully then IoTHubTransport_MQTT_Common_SetRetryPolicy shall return 0]*/
+            result = 0;
+        }
     }
     return result;
 }
 
-static RETRY_LOGIC* CreateRetryLogic(IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
+// Called for every do_work when connection is broken
+static bool CanRetry(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
-    RETRY_LOGIC *retryLogic;
-    retryLogic = (RETRY_LOGIC*)malloc(sizeof(RETRY_LOGIC));
-    if (retryLogic != NULL)
+    bool result;
+    RETRY_ACTION retry_action;
+
+    if (!transport_data->isFirstConnectionAttempted)
     {
-        retryLogic->retryPolicy = retryPolicy;
-        retryLogic->retryTimeoutLimitInSeconds = retryTimeoutLimitInSeconds;
-        switch (retryLogic->retryPolicy)
-        {
-        case IOTHUB_CLIENT_RETRY_NONE:
-            LogError("Not implemented chosing default");
-            retryLogic->fnRetryPolicy = &RetryPolicy_Exponential_BackOff_With_Jitter;
-            break;
-        case IOTHUB_CLIENT_RETRY_IMMEDIATE:
-            LogError("Not implemented chosing default");
-            retryLogic->fnRetryPolicy = &RetryPolicy_Exponential_BackOff_With_Jitter;
-            break;
-        case IOTHUB_CLIENT_RETRY_INTERVAL:
-            LogError("Not implemented chosing default");
-            retryLogic->fnRetryPolicy = &RetryPolicy_Exponential_BackOff_With_Jitter;
-            break;
-        case IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF:
-            LogError("Not implemented chosing default");
-            retryLogic->fnRetryPolicy = &RetryPolicy_Exponential_BackOff_With_Jitter;
-            break;
-        case IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF:
-            LogError("Not implemented chosing default");
-            retryLogic->fnRetryPolicy = &RetryPolicy_Exponential_BackOff_With_Jitter;
-            break;
-        case IOTHUB_CLIENT_RETRY_RANDOM:
-            LogError("Not implemented chosing default");
-            retryLogic->fnRetryPolicy = &RetryPolicy_Exponential_BackOff_With_Jitter;
-            break;
-        case IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER:
-        default:
-            retryLogic->fnRetryPolicy = &RetryPolicy_Exponential_BackOff_With_Jitter;
-            break;
-        }
-        retryLogic->start = EPOCH_TIME_T_VALUE;
-        retryLogic->delayFromLastConnectToRetry = 0;
-        retryLogic->lastConnect = EPOCH_TIME_T_VALUE;
-        retryLogic->retryStarted = false;
-        retryLogic->retryExpired = false;
-        retryLogic->firstAttempt = true;
-        retryLogic->retrycount = 0;
+        // This is the first time ever running through this code.  We need to try connecting no matter what.
+        transport_data->isFirstConnectionAttempted = true;
+        result = true;
     }
-    else
+    else if (transport_data->retryControl == NULL)
     {
-        LogError("Init retry logic failed");
+        LogError("Retry Logic is not created, retrying forever");
+        result = true;
     }
-    return retryLogic;
-}
-
-static void DestroyRetryLogic(RETRY_LOGIC *retryLogic)
-{
-    if (retryLogic != NULL)
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_028: [ The connection shall be retried only if retry_control_should_retry returns RETRY_ACTION_RETRY_NOW, or if it fails. ] */
+    else if (retry_control_should_retry(transport_data->retryControl, &retry_action) != 0)
     {
-        free(retryLogic);
-        retryLogic = NULL;
+        LogError("retry_control_should_retry() failed; assuming immediate connection retry for safety.");
+        result = true;
     }
-}
-
-// Called when first attempted to re-connect
-static void StartRetryTimer(RETRY_LOGIC *retryLogic)
-{
-    if (retryLogic != NULL)
+    else if (retry_action == RETRY_ACTION_STOP_RETRYING)
     {
-        if (retryLogic->retryStarted == false)
+        if (!transport_data->retryExpired)
         {
-            retryLogic->start = get_time(NULL);
-            retryLogic->delayFromLastConnectToRetry = 0;
-            retryLogic->retryStarted = true;
+            // Retry expired.  Stop trying.
+            LogError("Retry timeout expired, the connection will not be retried");
+            transport_data->retryExpired = true;
         }
-
-        retryLogic->firstAttempt = false;
+        result = false;
     }
     else
     {
-        LogError("Retry Logic parameter. NULL.");
+        result = (retry_action == RETRY_ACTION_RETRY_NOW);
     }
+    return result;
 }
 
-// Called when connected
-static void StopRetryTimer(RETRY_LOGIC *retryLogic)
+
+static void save_session_state(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
-    if (retryLogic != NULL)
+    if (transport_data->sleepyDevice.sessionState != NULL)
     {
-        if (retryLogic->retryStarted == true)
-        {
-            retryLogic->retryStarted = false;
-            retryLogic->delayFromLastConnectToRetry = 0;
-            retryLogic->lastConnect = EPOCH_TIME_T_VALUE;
-            retryLogic->retrycount = 0;
-        }
-        else
-        {
-            LogError("Start retry logic before stopping");
-        }
+        transport_data->sleepyDevice.sessionState->subscribedTopics = transport_data->topics_Subscribed;
+        transport_data->sleepyDevice.sessionState->packetId = transport_data->packetId;
+    }
+}
+
+static uint16_t get_next_packet_id(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    if (transport_data->packetId+1 >= USHRT_MAX)
+    {
+        transport_data->packetId = 1;
     }
     else
     {
-        LogError("Retry Logic parameter. NULL.");
+        transport_data->packetId++;
     }
+    return transport_data->packetId;
 }
 
-int IoTHubTransport_MQTT_Common_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
+static int packet_id_table_init(PACKET_ID_TABLE* table)
 {
     int result;
-    PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
-    if (transport_data == NULL)
+    if ((table->slots = (PACKET_ID_SLOT*)malloc(PACKET_ID_TABLE_INITIAL_CAPACITY * sizeof(PACKET_ID_SLOT))) == NULL)
     {
-        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_041: [**If any handle is NULL then IoTHubTransport_MQTT_Common_SetRetryPolicy shall return resultant line.] */
-        LogError("Invalid handle parameter. NULL.");
+        LogError("Failure allocating the packet id table");
+        table->capacity = 0;
+        table->count = 0;
         result = __FAILURE__;
     }
     else
     {
-        if (transport_data->retryLogic == NULL)
-        {
-            /*Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_042: [**If the retry logic is not already created then IoTHubTransport_MQTT_Common_SetRetryPolicy shall create retry logic by calling CreateRetryLogic with retry policy and retryTimeout as parameters]*/
-            transport_data->retryLogic = CreateRetryLogic(retryPolicy, retryTimeoutLimitInSeconds);
-        }
-        else
-        {
-            /*Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_043: [**If the retry logic is already created then IoTHubTransport_MQTT_Common_SetRetryPolicy shall destroy existing retry logic and create retry logic by calling CreateRetryLogic with retry policy and retryTimeout as parameters]*/
-            DestroyRetryLogic(transport_data->retryLogic);
-            transport_data->retryLogic = CreateRetryLogic(retryPolicy, retryTimeoutLimitInSeconds);
-        }
-
-        if (transport_data->retryLogic != NULL)
-        {
-            /*Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_045: [**If retry logic for specified parameters of retry policy and retryTimeoutLimitInSeconds is created successfully then IoTHubTransport_MQTT_Common_SetRetryPolicy shall return 0]*/
-            result = 0;
-        }
-        else
-        {
-            /*Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_25_044: [**If retry logic for specified parameters of retry policy and retryTimeoutLimitInSeconds cannot be created then IoTHubTransport_MQTT_Common_SetRetryPolicy shall return resultant line]*/
-            LogError("Retry Logic is not created");
-            result = __FAILURE__;
-        }
+        (void)memset(table->slots, 0, PACKET_ID_TABLE_INITIAL_CAPACITY * sizeof(PACKET_ID_SLOT));
+        table->capacity = PACKET_ID_TABLE_INITIAL_CAPACITY;
+        table->count = 0;
+        result = 0;
     }
     return result;
 }
 
-// Called for every do_work when connection is broken
-static bool CanRetry(RETRY_LOGIC *retryLogic)
+static void packet_id_table_deinit(PACKET_ID_TABLE* table)
 {
-    bool result;
-    time_t now = get_time(NULL);
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
 
-    if (retryLogic == NULL)
-    {
-        LogError("Retry Logic is not created, retrying forever");
-        result = true;
-    }
-    else if (now < 0 || retryLogic->start < 0)
+static size_t packet_id_table_home(const PACKET_ID_TABLE* table, uint16_t packet_id)
+{
+    return (size_t)packet_id & (table->capacity - 1);
+}
+
+static size_t packet_id_table_find_slot(const PACKET_ID_TABLE* table, uint16_t packet_id)
+{
+    size_t index = packet_id_table_home(table, packet_id);
+    while (table->slots[index].entry != NULL && table->slots[index].packet_id != packet_id)
     {
-        LogError("Time could not be retrieved, retrying forever");
-        result = true;
+        index = (index + 1) & (table->capacity - 1);
     }
-    else if (retryLogic->retryExpired)
+    return index;
+}
+
+// packet_id_table_reserve shall have succeeded. A packet id that wrapped around while its entry is still waiting now
+// points to the new entry.
+static void packet_id_table_insert(PACKET_ID_TABLE* table, uint16_t packet_id, void* entry)
+{
+    size_t index = packet_id_table_find_slot(table, packet_id);
+    if (table->slots[index].entry == NULL)
     {
-        // We've given up trying to retry.  Don't do anything.
-        result = false;
+        table->count++;
     }
-    else if (retryLogic->firstAttempt)
+    table->slots[index].packet_id = packet_id;
+    table->slots[index].entry = entry;
+}
+
+// Makes room for one more entry, growing the table past three quarters full. Only fails if the table could not grow
+// and has a single free slot left, which the lookups need to stop probing.
+static int packet_id_table_reserve(PACKET_ID_TABLE* table)
+{
+    int result;
+    if (((table->count + 1) * 4 <= table->capacity * 3) || (table->capacity >= PACKET_ID_TABLE_MAX_CAPACITY))
     {
-        // This is the first time ever running through this code.  We need to try connecting no matter what.
-        StartRetryTimer(retryLogic);
-        retryLogic->lastConnect = now;
-        retryLogic->retrycount++;
-        result = true;
+        result = 0;
     }
     else
     {
-        // Are we trying to retry?
-        if (retryLogic->retryStarted)
+        size_t capacity = table->capacity * 2;
+        PACKET_ID_SLOT* slots = (PACKET_ID_SLOT*)malloc(capacity * sizeof(PACKET_ID_SLOT));
+        if (slots == NULL)
         {
-            // How long since we last tried to connect?  Store this in difftime.
-            double diffTime = get_difftime(now, retryLogic->lastConnect);
-
-            // Has it been less than 5 seconds since we tried last?  If so, we have to
-            // be careful so we don't hit the server too quickly.
-            if (diffTime <= ERROR_TIME_FOR_RETRY_SECS)
-            {
-                // As do_work can be called within as little as 1 ms, wait to avoid throtling server
-                result = false;
-            }
-            else if (diffTime < retryLogic->delayFromLastConnectToRetry)
-            {
-                // delayFromLastConnectionToRetry is either 0 (the first time around)
-                // or it's the backoff delta from the last time through the loop.
-                // If we're less than that, don't even bother trying.  It's
-                // Too early to retry
-                result = false;
-            }
-            else
+            LogError("Failure growing the packet id table");
+            result = (table->count + 2 <= table->capacity) ? 0 : __FAILURE__;
+        }
+        else
+        {
+            PACKET_ID_TABLE grown;
+            size_t index;
+            (void)memset(slots, 0, capacity * sizeof(PACKET_ID_SLOT));
+            grown.slots = slots;
+            grown.capacity = capacity;
+            grown.count = 0;
+            for (index = 0; index < table->capacity; index++)
             {
-                // last retry time evaluated have crossed, determine when to try next
-                // In other words, it migth be time to retry, so we should validate with the retry policy function.
-                bool permit = false;
-                size_t delay;
-
-                if (retryLogic->fnRetryPolicy != NULL && (retryLogic->fnRetryPolicy(&permit, &delay, retryLogic) == 0))
-                {
-                    // Does the policy function want us to retry (permit == true), or are we still allowed to retry?
-                    // (in other words, are we within retryTimeoutLimitInSeconds seconds since starting to retry?)
-                    // If so, see if we _really_ want to retry.
-                    if ((permit == true) && ((retryLogic->retryTimeoutLimitInSeconds == 0) || retryLogic->retryTimeoutLimitInSeconds >= (delay + get_difftime(now, retryLogic->start))))
-                    {
-                        retryLogic->delayFromLastConnectToRetry = delay;
-
-                        LogInfo("Evaluated delay %d at %d attempt to retry\n", delay, retryLogic->retrycount);
-
-                        // If the retry policy is telling us to connect right away ( <= ERROR_TIME_FOR_RETRY_SECS),
-                        // or if enough time has elapsed, then we retry.
-                        if ((retryLogic->delayFromLastConnectToRetry <= ERROR_TIME_FOR_RETRY_SECS) ||
-                            (diffTime >= retryLogic->delayFromLastConnectToRetry))
-                        {
-                            retryLogic->lastConnect = now;
-                            retryLogic->retrycount++;
-                            result = true;
-                        }
-                        else
-                        {
-                            // To soon to retry according to policy.  
-                            result = false;
-                        }
-                    }
-                    else
-                    {
-                        // Retry expired.  Stop trying.
-                        LogError("Retry timeout expired after %d attempts", retryLogic->retrycount);
-                        retryLogic->retryExpired = true;
-                        StopRetryTimer(retryLogic);
-                        result = false;
-                    }
-                }
-                else
+                if (table->slots[index].entry != NULL)
                 {
-                    // We don't have a retry policy.  Sorry, can't even guess.  Don't bother even trying to retry.
-                    LogError("Cannot evaluate the next best time to retry");
-                    result = false;
+                    packet_id_table_insert(&grown, table->slots[index].packet_id, table->slots[index].entry);
                 }
             }
-        }
-        else
-        {
-            // Since this function is only called when the connection is 
-            // already broken, we can start doing the rety logic.  We'll do the
-            // actual interval checking next time around this loop.
-            StartRetryTimer(retryLogic);
-            //wait for next do work to evaluate next best attempt
-            result = false;
+            free(table->slots);
+            *table = grown;
+            result = 0;
         }
     }
     return result;
 }
 
+static void* packet_id_table_find(const PACKET_ID_TABLE* table, uint16_t packet_id)
+{
+    return (table->capacity == 0) ? NULL : table->slots[packet_id_table_find_slot(table, packet_id)].entry;
+}
 
-static uint16_t get_next_packet_id(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+// Removes packet_id if it still points to entry, moving back the entries probed past its slot so no tombstone is left.
+static void packet_id_table_remove(PACKET_ID_TABLE* table, uint16_t packet_id, const void* entry)
 {
-    if (transport_data->packetId+1 >= USHRT_MAX)
-    {
-        transport_data->packetId = 1;
-    }
-    else
+    if (table->capacity != 0)
     {
-        transport_data->packetId++;
+        size_t mask = table->capacity - 1;
+        size_t hole = packet_id_table_find_slot(table, packet_id);
+        if (table->slots[hole].entry == entry)
+        {
+            size_t index = hole;
+            for (;;)
+            {
+                size_t home;
+                index = (index + 1) & mask;
+                if (table->slots[index].entry == NULL)
+                {
+                    break;
+                }
+                home = packet_id_table_home(table, table->slots[index].packet_id);
+                // the entry can fill the hole unless its home slot lies cyclically in (hole, index]
+                if (((index - home) & mask) >= ((index - hole) & mask))
+                {
+                    table->slots[hole] = table->slots[index];
+                    hole = index;
+                }
+            }
+            table->slots[hole].entry = NULL;
+            table->slots[hole].packet_id = 0;
+            table->count--;
+        }
     }
-    return transport_data->packetId;
 }
 
 static const char* retrieve_mqtt_return_codes(CONNECT_RETURN_CODE rtn_code)
@@ -591,195 +657,131 @@ static const char* retrieve_mqtt_return_codes(CONNECT_RETURN_CODE rtn_code)
     }
 }
 
-static int retrieve_device_method_rid_info(const char* resp_topic, STRING_HANDLE method_name, STRING_HANDLE request_id)
+static bool topic_slice_equals(const TOPIC_SLICE* slice, const char* text, size_t length)
 {
-    int result;
-    STRING_TOKENIZER_HANDLE token_handle = STRING_TOKENIZER_create_from_char(resp_topic);
-    if (token_handle == NULL)
+    return (slice->length == length) && (memcmp(slice->text, text, length) == 0);
+}
+
+static bool topic_slice_starts_with_no_case(const TOPIC_SLICE* slice, const char* text, size_t length)
+{
+    bool result = (slice->length >= length);
+    size_t index;
+    for (index = 0; result && index < length; index++)
     {
-        LogError("Failed creating token from device twin topic.");
-        result = __FAILURE__;
+        result = (TOUPPER(slice->text[index]) == TOUPPER(text[index]));
     }
-    else
+    return result;
+}
+
+// The value of the leading decimal digits of text, as atol would read them
+static size_t topic_slice_number(const char* text, size_t length)
+{
+    size_t result = 0;
+    size_t index;
+    for (index = 0; index < length && text[index] >= '0' && text[index] <= '9'; index++)
     {
-        STRING_HANDLE token_value;
-        if ((token_value = STRING_new()) == NULL)
-        {
-            LogError("Failed allocating new string .");
-            result = __FAILURE__;
-        }
-        else
+        result = (result * 10) + (size_t)(text[index] - '0');
+    }
+    return result;
+}
+
+/* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_014: [ mqtt_notification_callback shall split the first segments of the topic in a single pass, without allocating, and classify and parse the topic from them. ] */
+static void split_incoming_topic(const char* topic, INCOMING_TOPIC* incoming)
+{
+    const char* segment = topic;
+    const char* cursor = topic;
+    incoming->segmentCount = 0;
+    while (incoming->segmentCount < INCOMING_TOPIC_SEGMENT_COUNT)
+    {
+        if (*cursor == '/' || *cursor == '\0')
         {
-            size_t token_index = 0;
-            size_t request_id_length = strlen(REQUEST_ID_PROPERTY);
-            result = __FAILURE__;
-            while (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/") == 0)
+            incoming->segments[incoming->segmentCount].text = segment;
+            incoming->segments[incoming->segmentCount].length = (size_t)(cursor - segment);
+            incoming->segmentCount++;
+            if (*cursor == '\0')
             {
-                if (token_index == 3)
-                {
-                    if (STRING_concat_with_STRING(method_name, token_value) != 0)
-                    {
-                        LogError("Failed STRING_concat_with_STRING.");
-                        result = __FAILURE__;
-                        break;
-                    }
-                }
-                else if (token_index == 4)
-                {
-                    if (STRING_length(token_value) >= request_id_length)
-                    {
-                        const char* request_id_value = STRING_c_str(token_value);
-                        if (memcmp(request_id_value, REQUEST_ID_PROPERTY, request_id_length) == 0)
-                        {
-                            if (STRING_concat(request_id, request_id_value+request_id_length) != 0)
-                            {
-                                LogError("Failed STRING_concat failed.");
-                                result = __FAILURE__;
-                            }
-                            else
-                            {
-                                result = 0;
-                            }
-                            break;
-                        }
-                    }
-                }
-                token_index++;
+                break;
             }
-            STRING_delete(token_value);
+            segment = cursor + 1;
         }
-        STRING_TOKENIZER_destroy(token_handle);
+        cursor++;
     }
-    return result;
 }
 
-static int parse_device_twin_topic_info(const char* resp_topic, bool* patch_msg, size_t* request_id, int* status_code)
+static int retrieve_device_method_rid_info(const INCOMING_TOPIC* incoming, TOPIC_SLICE* method_name, TOPIC_SLICE* request_id)
 {
     int result;
-    STRING_TOKENIZER_HANDLE token_handle = STRING_TOKENIZER_create_from_char(resp_topic);
-    if (token_handle == NULL)
+    size_t request_id_length = strlen(REQUEST_ID_PROPERTY);
+    // $iothub/methods/POST/{method name}/?$rid={request id}
+    if ((incoming->segmentCount < 5) ||
+        (incoming->segments[4].length < request_id_length) ||
+        (memcmp(incoming->segments[4].text, REQUEST_ID_PROPERTY, request_id_length) != 0))
     {
-        LogError("Failed creating token from device twin topic.");
+        LogError("Failed finding the method name and request id of the device method topic.");
         result = __FAILURE__;
-        *status_code = 0;
-        *request_id = 0;
-        *patch_msg = false;
     }
     else
     {
-        STRING_HANDLE token_value;
-        if ((token_value = STRING_new()) == NULL)
-        {
-            LogError("Failed allocating new string .");
-            result = __FAILURE__;
-            *status_code = 0;
-            *request_id = 0;
-            *patch_msg = false;
-        }
-        else
-        {
-            result = __FAILURE__;
-            size_t token_count = 0;
-            while (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/") == 0)
-            {
-                if (token_count == 2)
-                {
-                    if (strcmp(STRING_c_str(token_value), "PATCH") == 0)
-                    {
-                        *patch_msg = true;
-                        *status_code = 0;
-                        *request_id = 0;
-                        result = 0;
-                        break;
-                    }
-                    else
-                    {
-                        *patch_msg = false;
-                    }
-                }
-                else if (token_count == 3)
-                {
-                    *status_code = atol(STRING_c_str(token_value));
-                    if (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/?$rid=") == 0)
-                    {
-                        *request_id = (size_t)atol(STRING_c_str(token_value));
-                    }
-                    *patch_msg = false;
-                    result = 0;
-                    break;
-                }
-                token_count++;
-            }
-            STRING_delete(token_value);
-        }
-        STRING_TOKENIZER_destroy(token_handle);
+        *method_name = incoming->segments[3];
+        request_id->text = incoming->segments[4].text + request_id_length;
+        request_id->length = incoming->segments[4].length - request_id_length;
+        result = 0;
     }
     return result;
 }
 
-static IOTHUB_IDENTITY_TYPE retrieve_topic_type(const char* topic_resp)
+static int parse_device_twin_topic_info(const INCOMING_TOPIC* incoming, bool* patch_msg, size_t* request_id, int* status_code)
 {
-    IOTHUB_IDENTITY_TYPE type;
-    size_t dev_twin_topic_len = sizeof(TOPIC_DEVICE_TWIN_PREFIX)-1;
-    size_t dev_method_topic_len = sizeof(TOPIC_DEVICE_METHOD_PREFIX)-1;
-    size_t topic_len = strlen(topic_resp);
-    size_t len_to_use = (dev_twin_topic_len > dev_method_topic_len) ? dev_twin_topic_len : dev_method_topic_len;
-
-    bool search_device_twin = true;
-    bool search_device_method = true;
-    if (topic_len < len_to_use)
+    int result;
+    size_t request_id_length = strlen(REQUEST_ID_PROPERTY);
+    *status_code = 0;
+    *request_id = 0;
+    *patch_msg = false;
+    // $iothub/twin/PATCH/properties/desired/... or $iothub/twin/res/{status code}/?$rid={request id}
+    if (incoming->segmentCount < 3)
+    {
+        LogError("Failed finding the message type of the device twin topic.");
+        result = __FAILURE__;
+    }
+    else if (topic_slice_equals(&incoming->segments[2], "PATCH", sizeof("PATCH") - 1))
+    {
+        *patch_msg = true;
+        result = 0;
+    }
+    else if (incoming->segmentCount < 4)
     {
-        search_device_twin = false;
-        search_device_method = false;
+        LogError("Failed finding the status code of the device twin topic.");
+        result = __FAILURE__;
     }
     else
     {
-        size_t index = 0;
-        for (index = 0; index < len_to_use && (search_device_twin || search_device_method); index++)
+        *status_code = (int)topic_slice_number(incoming->segments[3].text, incoming->segments[3].length);
+        if ((incoming->segmentCount >= 5) &&
+            (incoming->segments[4].length >= request_id_length) &&
+            (memcmp(incoming->segments[4].text, REQUEST_ID_PROPERTY, request_id_length) == 0))
         {
-            if (search_device_twin)
-            {
-                if (index > dev_twin_topic_len)
-                {
-                    search_device_twin = false;
-                }
-                else
-                {
-                    if (index == dev_twin_topic_len)
-                    {
-                        break;
-                    }
-                    else if (TOUPPER(TOPIC_DEVICE_TWIN_PREFIX[index]) != TOUPPER(topic_resp[index]))
-                    {
-                        search_device_twin = false;
-                    }
-                }
-            }
-            if (search_device_method)
-            {
-                if (index > dev_method_topic_len)
-                {
-                    search_device_method = false;
-                }
-                else
-                {
-                    if (index == dev_method_topic_len)
-                    {
-                        break;
-                    }
-                    else if (TOUPPER(TOPIC_DEVICE_METHOD_PREFIX[index]) != TOUPPER(topic_resp[index]))
-                    {
-                        search_device_method = false;
-                    }
-                }
-            }
+            *request_id = topic_slice_number(incoming->segments[4].text + request_id_length, incoming->segments[4].length - request_id_length);
         }
+        result = 0;
     }
-    if (search_device_twin)
+    return result;
+}
+
+static IOTHUB_IDENTITY_TYPE retrieve_topic_type(const INCOMING_TOPIC* incoming)
+{
+    IOTHUB_IDENTITY_TYPE type;
+    // the topics of the hub start with $iothub/twin or $iothub/methods, matched without case
+    if ((incoming->segmentCount < 2) ||
+        (incoming->segments[0].length != sizeof(TOPIC_IOTHUB_PREFIX) - 1) ||
+        !topic_slice_starts_with_no_case(&incoming->segments[0], TOPIC_IOTHUB_PREFIX, sizeof(TOPIC_IOTHUB_PREFIX) - 1))
+    {
+        type = IOTHUB_TYPE_TELEMETRY;
+    }
+    else if (topic_slice_starts_with_no_case(&incoming->segments[1], TOPIC_DEVICE_TWIN_SEGMENT, sizeof(TOPIC_DEVICE_TWIN_SEGMENT) - 1))
     {
         type = IOTHUB_TYPE_DEVICE_TWIN;
     }
-    else if (search_device_method)
+    else if (topic_slice_starts_with_no_case(&incoming->segments[1], TOPIC_DEVICE_METHOD_SEGMENT, sizeof(TOPIC_DEVICE_METHOD_SEGMENT) - 1))
     {
         type = IOTHUB_TYPE_DEVICE_METHODS;
     }
@@ -790,77 +792,310 @@ static IOTHUB_IDENTITY_TYPE retrieve_topic_type(const char* topic_resp)
     return type;
 }
 
-static void sendMsgComplete(IOTHUB_MESSAGE_LIST* iothubMsgList, PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_CLIENT_CONFIRMATION_RESULT confirmResult)
+static MQTT_BRIDGED_DEVICE* get_bridged_device(IOTHUB_DEVICE_HANDLE handle)
+{
+    return (*(const MQTT_DEVICE_HANDLE_KIND*)handle == MQTT_DEVICE_HANDLE_BRIDGED) ? (MQTT_BRIDGED_DEVICE*)handle : NULL;
+}
+
+static MQTT_BRIDGED_DEVICE* find_bridged_device_by_client(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_CLIENT_LL_HANDLE llClientHandle)
+{
+    MQTT_BRIDGED_DEVICE* result = NULL;
+    PDLIST_ENTRY currentListEntry = transport_data->bridgedDevices.Flink;
+    while ((result == NULL) && (currentListEntry != &transport_data->bridgedDevices))
+    {
+        MQTT_BRIDGED_DEVICE* bridged_device = containingRecord(currentListEntry, MQTT_BRIDGED_DEVICE, entry);
+        if (bridged_device->llClientHandle == llClientHandle)
+        {
+            result = bridged_device;
+        }
+        currentListEntry = currentListEntry->Flink;
+    }
+    return result;
+}
+
+static void sendMsgComplete(IOTHUB_MESSAGE_LIST* iothubMsgList, PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_BRIDGED_DEVICE* bridged_device, IOTHUB_CLIENT_CONFIRMATION_RESULT confirmResult)
 {
     DLIST_ENTRY messageCompleted;
     DList_InitializeListHead(&messageCompleted);
     DList_InsertTailList(&messageCompleted, &(iothubMsgList->entry));
-    IoTHubClient_LL_SendComplete(transport_data->llClientHandle, &messageCompleted, confirmResult);
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_034: [ The messages of a bridged device shall be completed to the client that registered it. ] */
+    IoTHubClient_LL_SendComplete((bridged_device == NULL) ? transport_data->llClientHandle : bridged_device->llClientHandle, &messageCompleted, confirmResult);
 }
 
-static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, const char* eventTopic)
+static void complete_mqtt_message(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, IOTHUB_CLIENT_CONFIRMATION_RESULT confirmResult)
 {
-    STRING_HANDLE result = STRING_construct(eventTopic);
-    const char* const* propertyKeys;
-    const char* const* propertyValues;
-    size_t propertyCount;
-    size_t index = 0;
+    if (mqttMsgEntry->packedCount == 0)
+    {
+        sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, mqttMsgEntry->bridgedDevice, confirmResult);
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_070: [ The messages of an envelope shall be completed together, with the result of the envelope. ] */
+        IoTHubClient_LL_SendComplete(transport_data->llClientHandle, &mqttMsgEntry->packedMessages, confirmResult);
+        free(mqttMsgEntry->packedPayload);
+    }
+    free(mqttMsgEntry);
+}
 
-    // Construct Properties
-    MAP_HANDLE properties_map = IoTHubMessage_Properties(iothub_message_handle);
-    if (properties_map != NULL)
+static void trace_mqtt_message(MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, IOTHUB_MESSAGE_TRACE_STAGE stage)
+{
+    if (mqttMsgEntry->packedCount == 0)
     {
-        if (Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK)
+        if (mqttMsgEntry->iotHubMessageEntry->traced)
         {
-            LogError("Failed to get the internals of the property map.");
-            STRING_delete(result);
-            result = NULL;
+            IoTHubClient_LL_TraceMessage(mqttMsgEntry->iotHubMessageEntry, stage);
         }
-        else
+    }
+    else
+    {
+        PDLIST_ENTRY packedEntry;
+        for (packedEntry = mqttMsgEntry->packedMessages.Flink; packedEntry != &mqttMsgEntry->packedMessages; packedEntry = packedEntry->Flink)
         {
-            if (propertyCount != 0)
+            IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(packedEntry, IOTHUB_MESSAGE_LIST, entry);
+            if (iothubMsgList->traced)
             {
-                for (index = 0; index < propertyCount && result != NULL; index++)
-                {
-                    if (STRING_sprintf(result, "%s=%s%s", propertyKeys[index], propertyValues[index], propertyCount - 1 == index ? "" : PROPERTY_SEPARATOR) != 0)
-                    {
-                        LogError("Failed construting property string.");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                }
+                IoTHubClient_LL_TraceMessage(iothubMsgList, stage);
             }
         }
     }
+}
 
-    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_052: [ IoTHubTransport_MQTT_Common_DoWork shall check for the CorrelationId property and if found add the value as a system property in the format of $.cid=<id> ] */
-    if (result != NULL)
+static bool topic_template_matches(const TELEMETRY_TOPIC_TEMPLATE* topic_template, const char* const* propertyKeys, size_t propertyCount)
+{
+    bool result;
+    if ((topic_template == NULL) || (topic_template->keyCount != propertyCount))
     {
-        const char* correlation_id = IoTHubMessage_GetCorrelationId(iothub_message_handle);
-        if (correlation_id != NULL)
+        result = false;
+    }
+    else
+    {
+        size_t index;
+        size_t segmentStart = topic_template->prefixLength;
+        result = true;
+        for (index = 0; index < propertyCount && result; index++)
         {
-            if (STRING_sprintf(result, "%s%%24.cid=%s", index == 0 ? "" : PROPERTY_SEPARATOR, correlation_id) != 0)
+            // each segment is the separator (but for the first one), the key and '='
+            size_t keyStart = segmentStart + (index == 0 ? 0 : 1);
+            size_t keyLength = topic_template->segmentEnds[index] - keyStart - 1;
+            if ((strncmp(topic_template->text + keyStart, propertyKeys[index], keyLength) != 0) || (propertyKeys[index][keyLength] != '\0'))
             {
-                LogError("Failed setting correlation_id.");
-                STRING_delete(result);
-                result = NULL;
+                result = false;
+            }
+            segmentStart = topic_template->segmentEnds[index];
+        }
+    }
+    return result;
+}
+
+static TELEMETRY_TOPIC_TEMPLATE* create_topic_template(const char* eventTopic, const char* const* propertyKeys, size_t propertyCount)
+{
+    TELEMETRY_TOPIC_TEMPLATE* result;
+    size_t prefixLength = strlen(eventTopic);
+    size_t textLength = prefixLength;
+    size_t index;
+
+    for (index = 0; index < propertyCount; index++)
+    {
+        textLength += strlen(propertyKeys[index]) + (index == 0 ? 1 : 2);
+    }
+
+    // the segment ends and the text are allocated with the template
+    if ((result = (TELEMETRY_TOPIC_TEMPLATE*)malloc(sizeof(TELEMETRY_TOPIC_TEMPLATE) + propertyCount * sizeof(size_t) + textLength)) == NULL)
+    {
+        LogError("Failed allocating the telemetry topic template.");
+    }
+    else
+    {
+        size_t position = prefixLength;
+        result->keyCount = propertyCount;
+        result->prefixLength = prefixLength;
+        result->textLength = textLength;
+        result->segmentEnds = (size_t*)(result + 1);
+        result->text = (char*)(result->segmentEnds + propertyCount);
+        (void)memcpy(result->text, eventTopic, prefixLength);
+        for (index = 0; index < propertyCount; index++)
+        {
+            size_t keyLength = strlen(propertyKeys[index]);
+            if (index != 0)
+            {
+                result->text[position++] = PROPERTY_SEPARATOR[0];
             }
-            index++;
+            (void)memcpy(result->text + position, propertyKeys[index], keyLength);
+            position += keyLength;
+            result->text[position++] = '=';
+            result->segmentEnds[index] = position;
+        }
+    }
+    return result;
+}
+
+static int refresh_topic_template(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_BRIDGED_DEVICE* bridged_device, TELEMETRY_TOPIC_TEMPLATE** telemetryTopicTemplate, const char* const* propertyKeys, size_t propertyCount)
+{
+    int result;
+    TELEMETRY_TOPIC_TEMPLATE* topic_template;
+    if (bridged_device == NULL)
+    {
+        topic_template = create_topic_template(STRING_c_str(transport_data->topic_MqttEvent), propertyKeys, propertyCount);
+    }
+    else
+    {
+        // A gateway can bridge many leaf devices: they share TOPIC_DEVICE_DEVICE and keep only their device id, the
+        // event topic is only formatted here, when the template of the device changes.
+        char eventTopic[sizeof("devices//messages/events/") + 128];
+        (void)sprintf(eventTopic, TOPIC_DEVICE_DEVICE, STRING_c_str(bridged_device->device_id));
+        topic_template = create_topic_template(eventTopic, propertyKeys, propertyCount);
+    }
+
+    if (topic_template == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (*telemetryTopicTemplate != NULL)
+        {
+            free(*telemetryTopicTemplate);
+        }
+        *telemetryTopicTemplate = topic_template;
+        result = 0;
+    }
+    return result;
+}
+
+static int reserve_topic_buffer(PMQTTTRANSPORT_HANDLE_DATA transport_data, size_t size)
+{
+    int result;
+    if (size <= transport_data->telemetryTopicBufferSize)
+    {
+        result = 0;
+    }
+    else
+    {
+        char* buffer = (char*)realloc(transport_data->telemetryTopicBuffer, size);
+        if (buffer == NULL)
+        {
+            LogError("Failed growing the telemetry topic buffer.");
+            result = __FAILURE__;
+        }
+        else
+        {
+            transport_data->telemetryTopicBuffer = buffer;
+            transport_data->telemetryTopicBufferSize = size;
+            result = 0;
         }
     }
+    return result;
+}
+
+static char* append_system_property(char* position, bool first, const char* name, const char* value)
+{
+    size_t length;
+    if (!first)
+    {
+        *position++ = PROPERTY_SEPARATOR[0];
+    }
+    length = strlen(name);
+    (void)memcpy(position, name, length);
+    position += length;
+    length = strlen(value);
+    (void)memcpy(position, value, length);
+    return position + length;
+}
 
-    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_053: [ IoTHubTransport_MQTT_Common_DoWork shall check for the MessageId property and if found add the value as a system property in the format of $.mid=<id> ] */
-    if (result != NULL)
+static const char* build_telemetry_topic(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_BRIDGED_DEVICE* bridged_device, IOTHUB_MESSAGE_HANDLE iothub_message_handle, size_t packedCount)
+{
+    const char* result;
+    const char* const* propertyKeys = NULL;
+    const char* const* propertyValues = NULL;
+    size_t propertyCount = 0;
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_033: [ The messages of a bridged device shall be published on its own devices/<device id>/messages/events/ topic, with a topic template of its own. ] */
+    TELEMETRY_TOPIC_TEMPLATE** telemetryTopicTemplate = (bridged_device == NULL) ? &transport_data->telemetryTopicTemplate : &bridged_device->telemetryTopicTemplate;
+
+    // Construct Properties
+    MAP_HANDLE properties_map = IoTHubMessage_Properties(iothub_message_handle);
+    if ((properties_map != NULL) && (Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK))
+    {
+        LogError("Failed to get the internals of the property map.");
+        result = NULL;
+    }
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_003: [ IoTHubTransport_MQTT_Common_DoWork shall keep the topic prefix and the property keys of the last published message in a topic template, and rebuild it only when the property keys of the message differ. ] */
+    else if (!topic_template_matches(*telemetryTopicTemplate, propertyKeys, propertyCount) &&
+        (refresh_topic_template(transport_data, bridged_device, telemetryTopicTemplate, propertyKeys, propertyCount) != 0))
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_005: [ If the topic template or the topic buffer cannot be allocated, IoTHubTransport_MQTT_Common_DoWork shall fail to publish the message. ] */
+        result = NULL;
+    }
+    else
     {
+        const TELEMETRY_TOPIC_TEMPLATE* topic_template = *telemetryTopicTemplate;
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_052: [ IoTHubTransport_MQTT_Common_DoWork shall check for the CorrelationId property and if found add the value as a system property in the format of $.cid=<id> ] */
+        const char* correlation_id = IoTHubMessage_GetCorrelationId(iothub_message_handle);
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_053: [ IoTHubTransport_MQTT_Common_DoWork shall check for the MessageId property and if found add the value as a system property in the format of $.mid=<id> ] */
         const char* msg_id = IoTHubMessage_GetMessageId(iothub_message_handle);
+        size_t topicLength = topic_template->textLength + 1;
+        size_t index;
+        char packedCountText[21];
+
+        for (index = 0; index < propertyCount; index++)
+        {
+            topicLength += strlen(propertyValues[index]);
+        }
+        if (correlation_id != NULL)
+        {
+            topicLength += 1 + strlen(SYSTEM_PROPERTY_CORRELATION_ID) + strlen(correlation_id);
+        }
         if (msg_id != NULL)
         {
-            if (STRING_sprintf(result, "%s%%24.mid=%s", index == 0 ? "" : PROPERTY_SEPARATOR, msg_id) != 0)
+            topicLength += 1 + strlen(SYSTEM_PROPERTY_MESSAGE_ID) + strlen(msg_id);
+        }
+        if (packedCount != 0)
+        {
+            (void)sprintf(packedCountText, "%lu", (unsigned long)packedCount);
+            topicLength += 1 + strlen(PACKED_COUNT_PROPERTY) + strlen(packedCountText);
+        }
+
+        if (reserve_topic_buffer(transport_data, topicLength) != 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_005: [ If the topic template or the topic buffer cannot be allocated, IoTHubTransport_MQTT_Common_DoWork shall fail to publish the message. ] */
+            result = NULL;
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_004: [ IoTHubTransport_MQTT_Common_DoWork shall write the topic of the message in a buffer kept by the transport, copying the segments of the topic template and the property values of the message. ] */
+            char* position = transport_data->telemetryTopicBuffer;
+            size_t segmentStart = 0;
+            bool first = (propertyCount == 0);
+            if (propertyCount == 0)
             {
-                LogError("Failed setting correlation_id.");
-                STRING_delete(result);
-                result = NULL;
+                (void)memcpy(position, topic_template->text, topic_template->prefixLength);
+                position += topic_template->prefixLength;
+            }
+            for (index = 0; index < propertyCount; index++)
+            {
+                size_t valueLength = strlen(propertyValues[index]);
+                (void)memcpy(position, topic_template->text + segmentStart, topic_template->segmentEnds[index] - segmentStart);
+                position += topic_template->segmentEnds[index] - segmentStart;
+                (void)memcpy(position, propertyValues[index], valueLength);
+                position += valueLength;
+                segmentStart = topic_template->segmentEnds[index];
+            }
+            if (correlation_id != NULL)
+            {
+                position = append_system_property(position, first, SYSTEM_PROPERTY_CORRELATION_ID, correlation_id);
+                first = false;
             }
+            if (msg_id != NULL)
+            {
+                position = append_system_property(position, first, SYSTEM_PROPERTY_MESSAGE_ID, msg_id);
+                first = false;
+            }
+            if (packedCount != 0)
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_069: [ An envelope shall be published at QoS 1 on the topic of its first message, with a packed-count property set to its number of messages. ] */
+                position = append_system_property(position, first, PACKED_COUNT_PROPERTY, packedCountText);
+            }
+            *position = '\0';
+            result = transport_data->telemetryTopicBuffer;
         }
     }
     return result;
@@ -869,14 +1104,14 @@ static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_me
 static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
 {
     int result;
-    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transport_data->topic_MqttEvent));
+    const char* msgTopic = build_telemetry_topic(transport_data, mqttMsgEntry->bridgedDevice, mqttMsgEntry->iotHubMessageEntry->messageHandle, mqttMsgEntry->packedCount);
     if (msgTopic == NULL)
     {
         result = __FAILURE__;
     }
     else
     {
-        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(mqttMsgEntry->packet_id, STRING_c_str(msgTopic), DELIVER_AT_LEAST_ONCE, payload, len);
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(mqttMsgEntry->packet_id, msgTopic, DELIVER_AT_LEAST_ONCE, payload, len);
         if (mqttMsg == NULL)
         {
             result = __FAILURE__;
@@ -885,7 +1120,7 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
         {
             if (tickcounter_get_current_ms(transport_data->msgTickCounter, &mqttMsgEntry->msgPublishTime) != 0)
             {
-                LogError("Failed retrieving tickcounter info");
+                LogErrorLimited("Failed retrieving tickcounter info");
                 result = __FAILURE__;
             }
             else
@@ -896,13 +1131,72 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
                 }
                 else
                 {
+                    transport_data->isPacketSent = true;
+                    if (transport_data->connectionHealth != NULL)
+                    {
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_085: [ If connection_health is set, once a telemetry message is published IoTHubTransport_MQTT_Common_DoWork shall call connection_health_on_sent with the time it was published. ] */
+                        connection_health_on_sent(transport_data->connectionHealth, mqttMsgEntry->msgPublishTime);
+                    }
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_044: [ Once a telemetry message is published, IoTHubTransport_MQTT_Common_DoWork shall emit IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH with its message handle and its packet id, 0 at QoS 0. ] */
+                    if (mqttMsgEntry->packedCount == 0)
+                    {
+                        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, mqttMsgEntry->iotHubMessageEntry->messageHandle, mqttMsgEntry->packet_id);
+                    }
+                    else
+                    {
+                        PDLIST_ENTRY packedEntry;
+                        for (packedEntry = mqttMsgEntry->packedMessages.Flink; packedEntry != &mqttMsgEntry->packedMessages; packedEntry = packedEntry->Flink)
+                        {
+                            IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, containingRecord(packedEntry, IOTHUB_MESSAGE_LIST, entry)->messageHandle, mqttMsgEntry->packet_id);
+                        }
+                    }
                     mqttMsgEntry->retryCount++;
                     result = 0;
                 }
             }
             mqttmessage_destroy(mqttMsg);
         }
-        STRING_delete(msgTopic);
+    }
+    return result;
+}
+
+static bool is_delivered_at_most_once(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_010: [ IoTHubTransport_MQTT_Common_DoWork shall publish a message at QoS 0 if its delivery is IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE, or IOTHUB_MESSAGE_DELIVERY_DEFAULT while mqtt_telemetry_qos is 0. ] */
+    IOTHUB_MESSAGE_DELIVERY delivery = IoTHubMessage_GetDelivery(messageHandle);
+    return (delivery == IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE) ||
+        ((delivery == IOTHUB_MESSAGE_DELIVERY_DEFAULT) && transport_data->telemetryAtMostOnce);
+}
+
+static int publish_mqtt_telemetry_msg_at_most_once(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_BRIDGED_DEVICE* bridged_device, IOTHUB_MESSAGE_HANDLE messageHandle, const unsigned char* payload, size_t len)
+{
+    int result;
+    const char* msgTopic = build_telemetry_topic(transport_data, bridged_device, messageHandle, 0);
+    if (msgTopic == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(get_next_packet_id(transport_data), msgTopic, DELIVER_AT_MOST_ONCE, payload, len);
+        if (mqttMsg == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (mqtt_client_publish(transport_data->mqttClient, mqttMsg) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                transport_data->isPacketSent = true;
+                IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, messageHandle, 0);
+                result = 0;
+            }
+            mqttmessage_destroy(mqttMsg);
+        }
     }
     return result;
 }
@@ -912,15 +1206,18 @@ static int publish_device_method_message(MQTTTRANSPORT_HANDLE_DATA* transport_da
     int result;
     uint16_t packet_id = get_next_packet_id(transport_data);
 
-    STRING_HANDLE msg_topic = STRING_construct_sprintf(DEVICE_METHOD_RESPONSE_TOPIC, status_code, STRING_c_str(request_id) );
-    if (msg_topic == NULL)
+    const char* rid = STRING_c_str(request_id);
+
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_024: [ IoTHubTransport_MQTT_Common_DeviceMethod_Response shall write the topic of the response in the topic buffer kept by the transport instead of allocating a topic for each response. ] */
+    if (reserve_topic_buffer(transport_data, strlen(DEVICE_METHOD_RESPONSE_TOPIC) + STATUS_CODE_MAX_LENGTH + strlen(rid) + 1) != 0)
     {
         LogError("Failed constructing message topic.");
         result = __FAILURE__;
     }
     else
     {
-        MQTT_MESSAGE_HANDLE mqtt_get_msg = mqttmessage_create(packet_id, STRING_c_str(msg_topic), DELIVER_AT_MOST_ONCE, response, response_size);
+        (void)sprintf(transport_data->telemetryTopicBuffer, DEVICE_METHOD_RESPONSE_TOPIC, status_code, rid);
+        MQTT_MESSAGE_HANDLE mqtt_get_msg = mqttmessage_create(packet_id, transport_data->telemetryTopicBuffer, DELIVER_AT_MOST_ONCE, response, response_size);
         if (mqtt_get_msg == NULL)
         {
             LogError("Failed constructing mqtt message.");
@@ -935,11 +1232,11 @@ static int publish_device_method_message(MQTTTRANSPORT_HANDLE_DATA* transport_da
             }
             else
             {
+                transport_data->isPacketSent = true;
                 result = 0;
             }
             mqttmessage_destroy(mqtt_get_msg);
         }
-        STRING_delete(msg_topic);
     }
     return result;
 }
@@ -953,6 +1250,12 @@ static int publish_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_
         LogError("Failed allocating device twin data.");
         result = __FAILURE__;
     }
+    else if (packet_id_table_reserve(&transport_data->deviceTwinByPacketId) != 0)
+    {
+        LogError("Failed growing the device twin packet id table.");
+        free(mqtt_info);
+        result = __FAILURE__;
+    }
     else
     {
         mqtt_info->packet_id = get_next_packet_id(transport_data);
@@ -962,8 +1265,9 @@ static int publish_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_
         mqtt_info->msgPublishTime = 0;
         mqtt_info->iothub_type = IOTHUB_TYPE_DEVICE_TWIN;
         mqtt_info->device_twin_data = NULL;
-        STRING_HANDLE msg_topic = STRING_construct_sprintf(GET_PROPERTIES_TOPIC, mqtt_info->packet_id);
-        if (msg_topic == NULL)
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_025: [ The topics of the device twin get and reported state messages shall be written on the stack. ] */
+        char msg_topic[TWIN_TOPIC_MAX_LENGTH];
+        if (sprintf(msg_topic, GET_PROPERTIES_TOPIC, mqtt_info->packet_id) < 0)
         {
             LogError("Failed constructing get Prop topic.");
             free(mqtt_info);
@@ -971,7 +1275,7 @@ static int publish_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_
         }
         else
         {
-            MQTT_MESSAGE_HANDLE mqtt_get_msg = mqttmessage_create(mqtt_info->packet_id, STRING_c_str(msg_topic), DELIVER_AT_MOST_ONCE, NULL, 0);
+            MQTT_MESSAGE_HANDLE mqtt_get_msg = mqttmessage_create(mqtt_info->packet_id, msg_topic, DELIVER_AT_MOST_ONCE, NULL, 0);
             if (mqtt_get_msg == NULL)
             {
                 LogError("Failed constructing mqtt message.");
@@ -988,12 +1292,13 @@ static int publish_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_
                 }
                 else
                 {
+                    transport_data->isPacketSent = true;
                     DList_InsertTailList(&transport_data->ack_waiting_queue, &mqtt_info->entry);
+                    packet_id_table_insert(&transport_data->deviceTwinByPacketId, mqtt_info->packet_id, mqtt_info);
                     result = 0;
                 }
                 mqttmessage_destroy(mqtt_get_msg);
             }
-            STRING_delete(msg_topic);
         }
     }
     return result;
@@ -1004,8 +1309,9 @@ static int publish_device_twin_message(MQTTTRANSPORT_HANDLE_DATA* transport_data
     int result;
     mqtt_info->packet_id = get_next_packet_id(transport_data);
     mqtt_info->device_twin_msg_type = REPORTED_STATE;
-    STRING_HANDLE msgTopic = STRING_construct_sprintf(REPORTED_PROPERTIES_TOPIC, mqtt_info->packet_id);
-    if (msgTopic == NULL)
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_025: [ The topics of the device twin get and reported state messages shall be written on the stack. ] */
+    char msgTopic[TWIN_TOPIC_MAX_LENGTH];
+    if (sprintf(msgTopic, REPORTED_PROPERTIES_TOPIC, mqtt_info->packet_id) < 0)
     {
         LogError("Failed constructing reported prop topic.");
         result = __FAILURE__;
@@ -1013,7 +1319,7 @@ static int publish_device_twin_message(MQTTTRANSPORT_HANDLE_DATA* transport_data
     else
     {
         const CONSTBUFFER* data_buff = CONSTBUFFER_GetContent(device_twin_info->report_data_handle);
-        MQTT_MESSAGE_HANDLE mqtt_rpt_msg = mqttmessage_create(mqtt_info->packet_id, STRING_c_str(msgTopic), DELIVER_AT_MOST_ONCE, data_buff->buffer, data_buff->size);
+        MQTT_MESSAGE_HANDLE mqtt_rpt_msg = mqttmessage_create(mqtt_info->packet_id, msgTopic, DELIVER_AT_MOST_ONCE, data_buff->buffer, data_buff->size);
         if (mqtt_rpt_msg == NULL)
         {
             LogError("Failed creating mqtt message");
@@ -1023,7 +1329,7 @@ static int publish_device_twin_message(MQTTTRANSPORT_HANDLE_DATA* transport_data
         {
             if (tickcounter_get_current_ms(transport_data->msgTickCounter, &mqtt_info->msgPublishTime) != 0)
             {
-                LogError("Failed retrieving tickcounter info");
+                LogErrorLimited("Failed retrieving tickcounter info");
                 result = __FAILURE__;
             }
             else
@@ -1035,25 +1341,25 @@ static int publish_device_twin_message(MQTTTRANSPORT_HANDLE_DATA* transport_data
                 }
                 else
                 {
+                    transport_data->isPacketSent = true;
                     mqtt_info->retryCount++;
                     result = 0;
                 }
             }
             mqttmessage_destroy(mqtt_rpt_msg);
         }
-        STRING_delete(msgTopic);
     }
     return result;
 }
 
-static bool isSystemProperty(const char* tokenData)
+static bool isSystemProperty(const char* tokenData, size_t tokenLength)
 {
     bool result = false;
     size_t propCount = sizeof(sysPropList)/sizeof(sysPropList[0]);
     size_t index = 0;
     for (index = 0; index < propCount; index++)
     {
-        if (memcmp(tokenData, sysPropList[index].propName, sysPropList[index].propLength) == 0)
+        if (tokenLength >= sysPropList[index].propLength && memcmp(tokenData, sysPropList[index].propName, sysPropList[index].propLength) == 0)
         {
             result = true;
             break;
@@ -1062,154 +1368,84 @@ static bool isSystemProperty(const char* tokenData)
     return result;
 }
 
+/*reads the properties of a received message out of its topic in one pass: the message and correlation ids are set on the message,
+  the application properties are packed in a single buffer as NUL terminated name and value pairs that the message adds to its map
+  only when they are asked for*/
 static int extractMqttProperties(IOTHUB_MESSAGE_HANDLE IoTHubMessage, const char* topic_name)
 {
     int result;
-    STRING_HANDLE mqttTopic = STRING_construct(topic_name);
-    if (mqttTopic == NULL)
+    size_t topicLength = strlen(topic_name);
+    /*each name=value& token packs into name\0value\0, so the pairs never need more than the topic and its NUL*/
+    char* pairs = (char*)malloc(topicLength + 1);
+    if (pairs == NULL)
     {
-        LogError("Failure constructing string topic name.");
+        LogErrorLimited("Failure allocating the message properties.");
         result = __FAILURE__;
     }
     else
     {
-        STRING_TOKENIZER_HANDLE token = STRING_TOKENIZER_create(mqttTopic);
-        if (token != NULL)
+        size_t pairsSize = 0;
+        const char* token = topic_name;
+        result = 0;
+        while (*token != '\0' && result == 0)
         {
-            MAP_HANDLE propertyMap = IoTHubMessage_Properties(IoTHubMessage);
-            if (propertyMap == NULL)
-            {
-                LogError("Failure to retrieve IoTHubMessage_properties.");
-                result = __FAILURE__;
-            }
-            else
+            size_t tokenLength = strcspn(token, PROPERTY_SEPARATOR);
+            const char* equals = (const char*)memchr(token, '=', tokenLength);
+            if (equals != NULL)
             {
-                STRING_HANDLE output = STRING_new();
-                if (output == NULL)
+                size_t nameLength = (size_t)(equals - token);
+                size_t valueLength = tokenLength - nameLength - 1;
+                char* propName = pairs + pairsSize;
+                char* propValue = propName + nameLength + 1;
+
+                (void)memcpy(propName, token, nameLength);
+                propName[nameLength] = '\0';
+                (void)memcpy(propValue, equals + 1, valueLength);
+                propValue[valueLength] = '\0';
+
+                if (!isSystemProperty(token, tokenLength))
                 {
-                    LogError("Failure to allocate STRING_new.");
-                    result = __FAILURE__;
+                    pairsSize += tokenLength + 1;
                 }
-                else
+                else if (nameLength > 3)
                 {
-                    result = 0;
-
-                    while (STRING_TOKENIZER_get_next_token(token, output, PROPERTY_SEPARATOR) == 0 && result == 0)
+                    /*system properties are unpacked in place and overwritten by the next pair*/
+                    if (strcmp((const char*)&propName[nameLength - 3], MESSAGE_ID_PROPERTY) == 0)
                     {
-                        const char* tokenData = STRING_c_str(output);
-                        size_t tokenLen = strlen(tokenData);
-                        if (tokenData == NULL || tokenLen == 0)
+                        if (IoTHubMessage_SetMessageId(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
                         {
-                            break;
+                            LogErrorLimited("Failed to set IOTHUB_MESSAGE_HANDLE 'messageId' property.");
+                            result = __FAILURE__;
                         }
-                        else
+                    }
+                    else if (strcmp((const char*)&propName[nameLength - 3], CORRELATION_ID_PROPERTY) == 0)
+                    {
+                        if (IoTHubMessage_SetCorrelationId(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
                         {
-                            if (isSystemProperty(tokenData))
-                            {
-                                const char* iterator = tokenData;
-                                while (iterator != NULL && *iterator != '\0' && result == 0)
-                                {
-                                    if (*iterator == '=')
-                                    {
-                                        size_t nameLen = iterator - tokenData;
-                                        char* propName = malloc(nameLen + 1);
-
-                                        size_t valLen = tokenLen - (nameLen + 1) + 1;
-                                        char* propValue = malloc(valLen + 1);
-
-                                        if (propName == NULL || propValue == NULL)
-                                        {
-                                            result = __FAILURE__;
-                                        }
-                                        else
-                                        {
-                                            strncpy(propName, tokenData, nameLen);
-                                            propName[nameLen] = '\0';
-
-                                            strncpy(propValue, iterator + 1, valLen);
-                                            propValue[valLen] = '\0';
-
-                                            if (nameLen > 3)
-                                            {
-                                                if (strcmp((const char*)&propName[nameLen - 3], MESSAGE_ID_PROPERTY) == 0)
-                                                {
-                                                    if (IoTHubMessage_SetMessageId(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
-                                                    {
-                                                        LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'messageId' property.");
-                                                        result = __FAILURE__;
-                                                    }
-                                                }
-
-                                                if (strcmp((const char*)&propName[nameLen - 3], CORRELATION_ID_PROPERTY) == 0)
-                                                {
-                                                    if (IoTHubMessage_SetCorrelationId(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
-                                                    {
-                                                        LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'correlationId' property.");
-                                                        result = __FAILURE__;
-                                                    }
-                                                }
-                                            }
-                                        }
-                                        free(propName);
-                                        free(propValue);
-
-                                        break;
-                                    }
-                                    iterator++;
-                                }
-                            }
-                            else
-                            {
-                                const char* iterator = tokenData;
-                                while (iterator != NULL && *iterator != '\0' && result == 0)
-                                {
-                                    if (*iterator == '=')
-                                    {
-                                        size_t nameLen = iterator - tokenData;
-                                        char* propName = malloc(nameLen + 1);
-
-                                        size_t valLen = tokenLen - (nameLen + 1) + 1;
-                                        char* propValue = malloc(valLen + 1);
-
-                                        if (propName == NULL || propValue == NULL)
-                                        {
-                                            result = __FAILURE__;
-                                        }
-                                        else
-                                        {
-                                            strncpy(propName, tokenData, nameLen);
-                                            propName[nameLen] = '\0';
-
-                                            strncpy(propValue, iterator + 1, valLen);
-                                            propValue[valLen] = '\0';
-
-                                            if (Map_AddOrUpdate(propertyMap, propName, propValue) != MAP_OK)
-                                            {
-                                                LogError("Map_AddOrUpdate failed.");
-                                                result = __FAILURE__;
-                                            }
-                                        }
-                                        free(propName);
-                                        free(propValue);
-
-                                        break;
-                                    }
-                                    iterator++;
-                                }
-                            }
+                            LogErrorLimited("Failed to set IOTHUB_MESSAGE_HANDLE 'correlationId' property.");
+                            result = __FAILURE__;
                         }
                     }
-                    STRING_delete(output);
                 }
             }
-            STRING_TOKENIZER_destroy(token);
+
+            token += tokenLength;
+            if (*token != '\0')
+            {
+                token++;
+            }
         }
-        else
+
+        if (result != 0 || pairsSize == 0)
         {
-            LogError("Unable to create Tokenizer object.");
+            free(pairs);
+        }
+        else if (IoTHubMessage_SetPendingProperties(IoTHubMessage, pairs, pairsSize) != IOTHUB_MESSAGE_OK)
+        {
+            LogErrorLimited("Failure to give the message its properties.");
+            free(pairs);
             result = __FAILURE__;
         }
-        STRING_delete(mqttTopic);
     }
     return result;
 }
@@ -1223,21 +1459,23 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
         const char* topic_resp = mqttmessage_getTopicName(msgHandle);
         if (topic_resp == NULL)
         {
-            LogError("Failure: NULL topic name encountered");
+            LogErrorLimited("Failure: NULL topic name encountered");
         }
         else
         {
             PMQTTTRANSPORT_HANDLE_DATA transportData = (PMQTTTRANSPORT_HANDLE_DATA)callbackCtx;
+            INCOMING_TOPIC incoming_topic;
 
-            IOTHUB_IDENTITY_TYPE type = retrieve_topic_type(topic_resp);
+            split_incoming_topic(topic_resp, &incoming_topic);
+            IOTHUB_IDENTITY_TYPE type = retrieve_topic_type(&incoming_topic);
             if (type == IOTHUB_TYPE_DEVICE_TWIN)
             {
                 size_t request_id;
                 int status_code;
                 bool notification_msg;
-                if (parse_device_twin_topic_info(topic_resp, &notification_msg, &request_id, &status_code) != 0)
+                if (parse_device_twin_topic_info(&incoming_topic, &notification_msg, &request_id, &status_code) != 0)
                 {
-                    LogError("Failure: parsing device topic info");
+                    LogErrorLimited("Failure: parsing device topic info");
                 }
                 else
                 {
@@ -1248,59 +1486,54 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                     }
                     else
                     {
-                        PDLIST_ENTRY dev_twin_item = transportData->ack_waiting_queue.Flink;
-                        while (dev_twin_item != &transportData->ack_waiting_queue)
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_013: [ On a device twin response, mqtt_notification_callback shall find the request it answers by its $rid without walking the requests waiting for an answer. ] */
+                        MQTT_DEVICE_TWIN_ITEM* msg_entry = (request_id > USHRT_MAX) ? NULL :
+                            (MQTT_DEVICE_TWIN_ITEM*)packet_id_table_find(&transportData->deviceTwinByPacketId, (uint16_t)request_id);
+                        if (msg_entry != NULL)
                         {
-                            DLIST_ENTRY saveListEntry;
-                            saveListEntry.Flink = dev_twin_item->Flink;
-                            MQTT_DEVICE_TWIN_ITEM* msg_entry = containingRecord(dev_twin_item, MQTT_DEVICE_TWIN_ITEM, entry);
-                            if (request_id == msg_entry->packet_id)
+                            (void)DList_RemoveEntryList(&msg_entry->entry);
+                            packet_id_table_remove(&transportData->deviceTwinByPacketId, msg_entry->packet_id, msg_entry);
+                            if (msg_entry->device_twin_msg_type == RETRIEVE_PROPERTIES)
                             {
-                                (void)DList_RemoveEntryList(dev_twin_item);
-                                if (msg_entry->device_twin_msg_type == RETRIEVE_PROPERTIES)
-                                {
-                                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_054: [ If type is IOTHUB_TYPE_DEVICE_TWIN, then on success if msg_type is RETRIEVE_PROPERTIES then mqtt_notification_callback shall call IoTHubClient_LL_RetrievePropertyComplete... ] */
-                                    IoTHubClient_LL_RetrievePropertyComplete(transportData->llClientHandle, DEVICE_TWIN_UPDATE_COMPLETE, payload->message, payload->length);
-                                }
-                                else
-                                {
-                                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_055: [ if device_twin_msg_type is not RETRIEVE_PROPERTIES then mqtt_notification_callback shall call IoTHubClient_LL_ReportedStateComplete ] */
-                                    IoTHubClient_LL_ReportedStateComplete(transportData->llClientHandle, msg_entry->iothub_msg_id, status_code);
-                                }
-                                free(msg_entry);
-                                break;
+                                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_054: [ If type is IOTHUB_TYPE_DEVICE_TWIN, then on success if msg_type is RETRIEVE_PROPERTIES then mqtt_notification_callback shall call IoTHubClient_LL_RetrievePropertyComplete... ] */
+                                IoTHubClient_LL_RetrievePropertyComplete(transportData->llClientHandle, DEVICE_TWIN_UPDATE_COMPLETE, payload->message, payload->length);
+                            }
+                            else
+                            {
+                                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_055: [ if device_twin_msg_type is not RETRIEVE_PROPERTIES then mqtt_notification_callback shall call IoTHubClient_LL_ReportedStateComplete ] */
+                                IoTHubClient_LL_ReportedStateComplete(transportData->llClientHandle, msg_entry->iothub_msg_id, status_code);
                             }
-                            dev_twin_item = saveListEntry.Flink;
+                            free(msg_entry);
                         }
                     }
                 }
             }
             else if (type == IOTHUB_TYPE_DEVICE_METHODS)
             {
-                STRING_HANDLE method_name = STRING_new();
-                if (method_name == NULL)
+                TOPIC_SLICE method_name_slice;
+                TOPIC_SLICE request_id_slice;
+                STRING_HANDLE method_name;
+                if (retrieve_device_method_rid_info(&incoming_topic, &method_name_slice, &request_id_slice) != 0)
+                {
+                    LogErrorLimited("Failure: retrieve device topic info");
+                }
+                else if ((method_name = STRING_construct_n(method_name_slice.text, method_name_slice.length)) == NULL)
                 {
-                    LogError("Failure: allocating method_name string value");
+                    LogErrorLimited("Failure: allocating method_name string value");
                 }
                 else
                 {
                     DEVICE_METHOD_INFO* dev_method_info = malloc(sizeof(DEVICE_METHOD_INFO) );
                     if (dev_method_info == NULL)
                     {
-                        LogError("Failure: allocating DEVICE_METHOD_INFO object");
+                        LogErrorLimited("Failure: allocating DEVICE_METHOD_INFO object");
                     }
                     else
                     {
-                        dev_method_info->request_id = STRING_new();
+                        dev_method_info->request_id = STRING_construct_n(request_id_slice.text, request_id_slice.length);
                         if (dev_method_info->request_id == NULL)
                         {
-                            LogError("Failure constructing request_id string");
-                            free(dev_method_info);
-                        }
-                        else if (retrieve_device_method_rid_info(topic_resp, method_name, dev_method_info->request_id) != 0)
-                        {
-                            LogError("Failure: retrieve device topic info");
-                            STRING_delete(dev_method_info->request_id);
+                            LogErrorLimited("Failure constructing request_id string");
                             free(dev_method_info);
                         }
                         else
@@ -1309,7 +1542,7 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                             const APP_PAYLOAD* payload = mqttmessage_getApplicationMsg(msgHandle);
                             if (IoTHubClient_LL_DeviceMethodComplete(transportData->llClientHandle, STRING_c_str(method_name), payload->message, payload->length, (void*)dev_method_info) != 0)
                             {
-                                LogError("Failure: IoTHubClient_LL_DeviceMethodComplete");
+                                LogErrorLimited("Failure: IoTHubClient_LL_DeviceMethodComplete");
                                 STRING_delete(dev_method_info->request_id);
                                 free(dev_method_info);
                             }
@@ -1321,24 +1554,27 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
             else
             {
                 const APP_PAYLOAD* appPayload = mqttmessage_getApplicationMsg(msgHandle);
-                IOTHUB_MESSAGE_HANDLE IoTHubMessage = IoTHubMessage_CreateFromByteArray(appPayload->message, appPayload->length);
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_060: [ If type is IOTHUB_TYPE_TELEMETRY and IoTHubClient_LL_GetMessageChunkSize is not 0, mqtt_notification_callback shall create the message with an empty body and give the payload of the PUBLISH to IoTHubClient_LL_MessageChunksCallback instead of calling IoTHubClient_LL_MessageCallback. ] */
+                bool chunked = (IoTHubClient_LL_GetMessageChunkSize(transportData->llClientHandle) != 0);
+                IOTHUB_MESSAGE_HANDLE IoTHubMessage = chunked ? IoTHubMessage_CreateFromByteArray(NULL, 0) : IoTHubMessage_CreateFromByteArray(appPayload->message, appPayload->length);
                 if (IoTHubMessage == NULL)
                 {
-                    LogError("Failure: IotHub Message creation has failed.");
+                    LogErrorLimited("Failure: IotHub Message creation has failed.");
                 }
                 else
                 {
                     // Will need to update this when the service has messages that can be rejected
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_015: [ If type is IOTHUB_TYPE_TELEMETRY, mqtt_notification_callback shall read the properties out of the topic in one pass, set the message id and correlation id on the message and give it the application properties with IoTHubMessage_SetPendingProperties, packed in a single allocation. ] */
                     if (extractMqttProperties(IoTHubMessage, topic_resp) != 0)
                     {
-                        LogError("failure extracting mqtt properties.");
+                        LogErrorLimited("failure extracting mqtt properties.");
                     }
                     else
                     {
                         MESSAGE_CALLBACK_INFO* messageData = (MESSAGE_CALLBACK_INFO*)malloc(sizeof(MESSAGE_CALLBACK_INFO));
                         if (messageData == NULL)
                         {
-                            LogError("malloc failed");
+                            LogErrorLimited("malloc failed");
                         }
                         else
                         {
@@ -1346,9 +1582,11 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                             messageData->transportContext = NULL;
 
                             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_056: [ If type is IOTHUB_TYPE_TELEMETRY, then on success mqtt_notification_callback shall call IoTHubClient_LL_MessageCallback. ] */
-                            if (!IoTHubClient_LL_MessageCallback(transportData->llClientHandle, messageData))
+                            if (chunked ?
+                                !IoTHubClient_LL_MessageChunksCallback(transportData->llClientHandle, messageData, appPayload->message, appPayload->length) :
+                                !IoTHubClient_LL_MessageCallback(transportData->llClientHandle, messageData))
                             {
-                                LogError("IoTHubClient_LL_MessageCallback returned false");
+                                LogErrorLimited("IoTHubClient_LL_MessageCallback returned false");
 
                                 IoTHubMessage_Destroy(IoTHubMessage);
                                 free(messageData);
@@ -1376,25 +1614,41 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                 const PUBLISH_ACK* puback = (const PUBLISH_ACK*)msgInfo;
                 if (puback != NULL)
                 {
-                    PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
-                    while (currentListEntry != &transport_data->telemetry_waitingForAck)
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_012: [ On a PUBACK, mqtt_operation_complete_callback shall find the message waiting for it by its packet id without walking the messages waiting for their PUBACK. ] */
+                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)packet_id_table_find(&transport_data->telemetryByPacketId, puback->packetId);
+                    if (mqttMsgEntry != NULL)
                     {
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                        DLIST_ENTRY saveListEntry;
-                        saveListEntry.Flink = currentListEntry->Flink;
-
-                        if (puback->packetId == mqttMsgEntry->packet_id)
+                        (void)DList_RemoveEntryList(&mqttMsgEntry->entry); //First remove the item from Waiting for Ack List.
+                        packet_id_table_remove(&transport_data->telemetryByPacketId, mqttMsgEntry->packet_id, mqttMsgEntry);
+                        transport_data->inflightCount--;
+                        if (transport_data->connectionHealth != NULL)
+                        {
+                            tickcounter_ms_t current_ms;
+                            if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) == 0)
+                            {
+                                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_086: [ If connection_health is set, on a PUBACK mqtt_operation_complete_callback shall call connection_health_on_acked with the time the message was published, whether it was published more than once and the current ms. ] */
+                                connection_health_on_acked(transport_data->connectionHealth, mqttMsgEntry->msgPublishTime, mqttMsgEntry->retryCount > 1, current_ms);
+                            }
+                        }
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_045: [ On a PUBACK, mqtt_operation_complete_callback shall emit IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK with the message handle and IOTHUB_CLIENT_CONFIRMATION_OK before completing the message. ] */
+                        if (mqttMsgEntry->packedCount == 0)
+                        {
+                            IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, mqttMsgEntry->iotHubMessageEntry->messageHandle, IOTHUB_CLIENT_CONFIRMATION_OK);
+                        }
+                        else
                         {
-                            (void)DList_RemoveEntryList(currentListEntry); //First remove the item from Waiting for Ack List.
-                            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
-                            free(mqttMsgEntry);
+                            PDLIST_ENTRY packedEntry;
+                            for (packedEntry = mqttMsgEntry->packedMessages.Flink; packedEntry != &mqttMsgEntry->packedMessages; packedEntry = packedEntry->Flink)
+                            {
+                                IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, containingRecord(packedEntry, IOTHUB_MESSAGE_LIST, entry)->messageHandle, IOTHUB_CLIENT_CONFIRMATION_OK);
+                            }
                         }
-                        currentListEntry = saveListEntry.Flink;
+                        complete_mqtt_message(transport_data, mqttMsgEntry, IOTHUB_CLIENT_CONFIRMATION_OK);
                     }
                 }
                 else
                 {
-                    LogError("Failure: MQTT_CLIENT_ON_PUBLISH_ACK publish_ack structure NULL.");
+                    LogErrorLimited("Failure: MQTT_CLIENT_ON_PUBLISH_ACK publish_ack structure NULL.");
                 }
                 break;
             }
@@ -1409,7 +1663,43 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                         transport_data->currPacketState = CONNACK_TYPE;
                         transport_data->isRecoverableError = true;
                         transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_CONNECTED;
-                        StopRetryTimer(transport_data->retryLogic);
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_046: [ Whenever the MQTT client status changes, IoTHubTransport_MQTT_Common shall emit IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE with the transport handle and the new MQTT_CLIENT_STATUS. ] */
+                        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE, transport_data, MQTT_CLIENT_STATUS_CONNECTED);
+                        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_029: [ Once the connection is accepted, IoTHubTransport_MQTT_Common_DoWork shall reset the retry control using retry_control_reset. ] */
+                        retry_control_reset(transport_data->retryControl);
+                        if (transport_data->happyEyeballs != NULL)
+                        {
+                            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_078: [ If happy_eyeballs is set, once the connection is accepted IoTHubTransport_MQTT_Common_DoWork shall call happy_eyeballs_on_connected with the xio and the host address. ] */
+                            happy_eyeballs_on_connected(transport_data->happyEyeballs, transport_data->xioTransport, STRING_c_str(transport_data->hostAddress));
+                        }
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_008: [ If mqtt_max_inflight is set, once reconnected IoTHubTransport_MQTT_Common_DoWork shall republish the messages waiting for their PUBACK in the order they were first published, without waiting for their resend timeout. ] */
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_090: [ If connection_health is set, once reconnected IoTHubTransport_MQTT_Common_DoWork shall call connection_health_on_connected and republish the messages waiting for their PUBACK without waiting for their resend timeout. ] */
+                        if (transport_data->connectionHealth != NULL)
+                        {
+                            connection_health_on_connected(transport_data->connectionHealth);
+                        }
+                        transport_data->resendInflight = ((transport_data->maxInflight != 0) || (transport_data->connectionHealth != NULL)) && (transport_data->inflightCount != 0);
+                        transport_data->topics_AwaitingSuback = UNSUBSCRIBE_FROM_TOPIC;
+                        if (transport_data->persistentSession && connack->isSessionPresent)
+                        {
+                            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_017: [ If mqtt_persistent_session is set and the CONNACK reports a session present, IoTHubTransport_MQTT_Common_DoWork shall only subscribe to the topics that were not subscribed in that session. ] */
+                            transport_data->topics_ToSubscribe &= ~transport_data->topics_Subscribed;
+                            if ((transport_data->topics_ToSubscribe == UNSUBSCRIBE_FROM_TOPIC) && (transport_data->topics_Subscribed != UNSUBSCRIBE_FROM_TOPIC))
+                            {
+                                // The session holds every subscription, carry on as if they had just been acked
+                                transport_data->currPacketState = SUBACK_TYPE;
+                            }
+                        }
+                        else
+                        {
+                            transport_data->topics_Subscribed = UNSUBSCRIBE_FROM_TOPIC;
+                        }
+                        save_session_state(transport_data);
+                        if (transport_data->keepAliveMax != 0)
+                        {
+                            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_023: [ If "mqtt_keepalive_max" is set, on an accepted CONNACK the keepalive of the connection shall be reported with IoTHubClient_LL_KeepAliveChanged. ] */
+                            IoTHubClient_LL_KeepAliveChanged(transport_data->llClientHandle, (int)transport_data->keepAliveValue);
+                        }
                         IoTHubClient_LL_ConnectionStatusCallBack(transport_data->llClientHandle, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
                     }
                     else
@@ -1430,6 +1720,7 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                         LogError("Connection Not Accepted: 0x%x: %s", connack->returnCode, retrieve_mqtt_return_codes(connack->returnCode) );
                         (void)mqtt_client_disconnect(transport_data->mqttClient);
                         transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_NOT_CONNECTED;
+                        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE, transport_data, MQTT_CLIENT_STATUS_NOT_CONNECTED);
                         transport_data->currPacketState = PACKET_TYPE_ERROR;
                     }
                 }
@@ -1445,13 +1736,21 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                 if (suback != NULL)
                 {
                     size_t index = 0;
+                    bool subscribed = true;
                     for (index = 0; index < suback->qosCount; index++)
                     {
                         if (suback->qosReturn[index] == DELIVER_FAILURE)
                         {
                             LogError("Subscribe delivery failure of subscribe %zu", index);
+                            subscribed = false;
                         }
                     }
+                    if (subscribed)
+                    {
+                        transport_data->topics_Subscribed |= transport_data->topics_AwaitingSuback;
+                        save_session_state(transport_data);
+                    }
+                    transport_data->topics_AwaitingSuback = UNSUBSCRIBE_FROM_TOPIC;
                     // The connect packet has been acked
                     transport_data->currPacketState = SUBACK_TYPE;
                 }
@@ -1471,17 +1770,57 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
             {
                 // Close the client so we can reconnect again
                 transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_NOT_CONNECTED;
+                IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE, transport_data, MQTT_CLIENT_STATUS_NOT_CONNECTED);
                 transport_data->currPacketState = DISCONNECT_TYPE;
                 break;
             }
             case MQTT_CLIENT_ON_UNSUBSCRIBE_ACK:
             {
+                const UNSUBSCRIBE_ACK* unsuback = (const UNSUBSCRIBE_ACK*)msgInfo;
+                tickcounter_ms_t current_ms;
+                if ((unsuback != NULL) && (transport_data->connectionHealth != NULL) && (unsuback->packetId == transport_data->probePacketId) &&
+                    (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) == 0))
+                {
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_087: [ On the UNSUBACK of the probe, mqtt_operation_complete_callback shall call connection_health_on_probe_acked with the current ms. ] */
+                    connection_health_on_probe_acked(transport_data->connectionHealth, current_ms);
+                }
                 break;
             }
         }
     }
 }
 
+// The topics are subscribed again on the next connection, the twin is requested again
+static void ResetTopicsToSubscribe(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    transport_data->device_twin_get_sent = false;
+    if (transport_data->topic_MqttMessage != NULL)
+    {
+        transport_data->topics_ToSubscribe |= SUBSCRIBE_TELEMETRY_TOPIC;
+    }
+    if (transport_data->topic_GetState != NULL)
+    {
+        transport_data->topics_ToSubscribe |= SUBSCRIBE_GET_REPORTED_STATE_TOPIC;
+    }
+    if (transport_data->topic_NotifyState != NULL)
+    {
+        transport_data->topics_ToSubscribe |= SUBSCRIBE_NOTIFICATION_STATE_TOPIC;
+    }
+    if (transport_data->topic_DeviceMethods != NULL)
+    {
+        transport_data->topics_ToSubscribe |= SUBSCRIBE_DEVICE_METHOD_TOPIC;
+    }
+}
+
+static void ForgetAddressFamily(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    if (transport_data->happyEyeballs != NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_079: [ If happy_eyeballs is set, IoTHubTransport_MQTT_Common_DoWork shall call happy_eyeballs_on_connect_failed with the host address when the connection cannot be made or times out waiting for CONNACK. ] */
+        happy_eyeballs_on_connect_failed(transport_data->happyEyeballs, STRING_c_str(transport_data->hostAddress));
+    }
+}
+
 static void mqtt_error_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_ERROR error, void* callbackCtx)
 {
     (void)handle;
@@ -1492,6 +1831,10 @@ static void mqtt_error_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_ERR
         {
             case MQTT_CLIENT_CONNECTION_ERROR:
             {
+                if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_CONNECTING)
+                {
+                    ForgetAddressFamily(transport_data);
+                }
                 IoTHubClient_LL_ConnectionStatusCallBack(transport_data->llClientHandle, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
                 break;
             }
@@ -1513,25 +1856,18 @@ static void mqtt_error_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_ERR
                 break;
             }
         }
-        transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_NOT_CONNECTED;
-        transport_data->currPacketState = PACKET_TYPE_ERROR;
-        transport_data->device_twin_get_sent = false;
-        if (transport_data->topic_MqttMessage != NULL)
-        {
-            transport_data->topics_ToSubscribe |= SUBSCRIBE_TELEMETRY_TOPIC;
-        }
-        if (transport_data->topic_GetState != NULL)
-        {
-            transport_data->topics_ToSubscribe |= SUBSCRIBE_GET_REPORTED_STATE_TOPIC;
-        }
-        if (transport_data->topic_NotifyState != NULL)
-        {
-            transport_data->topics_ToSubscribe |= SUBSCRIBE_NOTIFICATION_STATE_TOPIC;
-        }
-        if (transport_data->topic_DeviceMethods != NULL)
+        if ((transport_data->keepAliveMax != 0) && (transport_data->keepAliveValue > transport_data->keepAliveSafe) &&
+            (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_CONNECTED))
         {
-            transport_data->topics_ToSubscribe |= SUBSCRIBE_DEVICE_METHOD_TOPIC;
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_022: [ If an error ends a connection whose adaptive keepalive was not kept yet, the keepalive shall be set back to the last one kept and no longer probed. ] */
+            LogInfo("connection lost with a keepalive of %u seconds, keeping %u seconds", (unsigned int)transport_data->keepAliveValue, (unsigned int)transport_data->keepAliveSafe);
+            transport_data->keepAliveValue = transport_data->keepAliveSafe;
+            transport_data->keepAliveSettled = true;
         }
+        transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_NOT_CONNECTED;
+        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE, transport_data, MQTT_CLIENT_STATUS_NOT_CONNECTED);
+        transport_data->currPacketState = PACKET_TYPE_ERROR;
+        ResetTopicsToSubscribe(transport_data);
     }
     else
     {
@@ -1585,8 +1921,10 @@ static void SubscribeToMqttProtocol(PMQTTTRANSPORT_HANDLE_DATA transport_data)
             }
             else
             {
+                transport_data->isPacketSent = true;
                 /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_018: [On success IoTHubTransport_MQTT_Common_Subscribe shall return 0.] */
                 transport_data->topics_ToSubscribe &= ~topic_subscription;
+                transport_data->topics_AwaitingSuback |= topic_subscription;
                 transport_data->currPacketState = SUBSCRIBE_TYPE;
             }
         }
@@ -1612,7 +1950,7 @@ static const unsigned char* RetrieveMessagePayload(IOTHUB_MESSAGE_HANDLE message
     {
         if (IoTHubMessage_GetByteArray(messageHandle, &result, length) != IOTHUB_MESSAGE_OK)
         {
-            LogError("Failure result from IoTHubMessage_GetByteArray");
+            LogErrorLimited("Failure result from IoTHubMessage_GetByteArray");
             result = NULL;
             *length = 0;
         }
@@ -1622,7 +1960,7 @@ static const unsigned char* RetrieveMessagePayload(IOTHUB_MESSAGE_HANDLE message
         result = (const unsigned char*)IoTHubMessage_GetString(messageHandle);
         if (result == NULL)
         {
-            LogError("Failure result from IoTHubMessage_GetString");
+            LogErrorLimited("Failure result from IoTHubMessage_GetString");
             result = NULL;
             *length = 0;
         }
@@ -1664,6 +2002,11 @@ static int GetTransportProviderIfNecessary(PMQTTTRANSPORT_HANDLE_DATA transport_
         }
         else
         {
+            if (transport_data->happyEyeballs != NULL)
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_077: [ If happy_eyeballs is set, IoTHubTransport_MQTT_Common_DoWork shall call happy_eyeballs_prepare_io with every new xio and the host address before connecting. ] */
+                happy_eyeballs_prepare_io(transport_data->happyEyeballs, transport_data->xioTransport, hostAddress);
+            }
             result = 0;
         }
     }
@@ -1674,11 +2017,47 @@ static int GetTransportProviderIfNecessary(PMQTTTRANSPORT_HANDLE_DATA transport_
     return result;
 }
 
+static void DestroyCoalescingIO(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    if (transport_data->xioCoalescing != NULL)
+    {
+        xio_destroy(transport_data->xioCoalescing);
+        transport_data->xioCoalescing = NULL;
+    }
+}
+
+static void CreateCoalescingIO(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_082: [ Each connection shall be made on a new coalescing IO over the xio when "write_coalescing" is not 0, and on the xio itself otherwise or if the coalescing IO cannot be created. ] */
+    DestroyCoalescingIO(transport_data);
+    if (transport_data->writeCoalescingSize != 0)
+    {
+        COALESCING_IO_CONFIG coalescing_io_config;
+        coalescing_io_config.underlying_io = transport_data->xioTransport;
+        coalescing_io_config.buffer_size = transport_data->writeCoalescingSize;
+        if ((transport_data->xioCoalescing = xio_create(coalescing_io_get_interface_description(), &coalescing_io_config)) == NULL)
+        {
+            LogError("Unable to create the coalescing IO, the writes are not coalesced.");
+        }
+    }
+}
+
+static void CorkTransport(PMQTTTRANSPORT_HANDLE_DATA transport_data, bool cork)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_083: [ While the connection is on a coalescing IO, IoTHubTransport_MQTT_Common_DoWork shall cork it before publishing and uncork it, which writes what it holds, before calling mqtt_client_dowork. ] */
+    if ((transport_data->xioCoalescing != NULL) && (xio_setoption(transport_data->xioCoalescing, COALESCING_IO_OPTION_CORK, &cork) != 0))
+    {
+        LogErrorLimited("Failure writing the coalesced packets.");
+    }
+}
+
 static int SendMqttConnectMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
     int result;
 
     char* sasToken = NULL;
+    const char* password = NULL;
+    IOTHUB_MQTT_SESSION_STATE* sessionState = transport_data->sleepyDevice.sessionState;
     result = 0;
 
     IOTHUB_CREDENTIAL_TYPE cred_type = IoTHubClient_Auth_Get_Credential_Type(transport_data->authorization_module);
@@ -1686,12 +2065,29 @@ static int SendMqttConnectMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data)
     {
         size_t secSinceEpoch = (size_t)(difftime(get_time(NULL), EPOCH_TIME_T_VALUE) + 0);
         size_t expiryTime = secSinceEpoch + SAS_TOKEN_DEFAULT_LIFETIME;
-        sasToken = IoTHubClient_Auth_Get_SasToken(transport_data->authorization_module, STRING_c_str(transport_data->devicesPath), expiryTime);
-        if (sasToken == NULL)
+        if ((sessionState != NULL) && (sessionState->sasTokenExpiry >= secSinceEpoch + (size_t)(SAS_TOKEN_DEFAULT_LIFETIME * (1 - SAS_REFRESH_MULTIPLIER))))
         {
-            LogError("failure getting sas Token.");
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_042: [ While "mqtt_sleepy_device" is set, the SAS token of the session state shall be used to connect for as long as it has at least the refresh margin of its lifetime left; the token generated otherwise shall be kept in the session state if it fits. ] */
+            password = sessionState->sasToken;
+        }
+        else if ((sasToken = IoTHubClient_Auth_Get_SasToken(transport_data->authorization_module, STRING_c_str(transport_data->devicesPath), expiryTime)) == NULL)
+        {
+            LogErrorLimited("failure getting sas Token.");
             result = __FAILURE__;
         }
+        else if (sessionState != NULL)
+        {
+            size_t sasTokenLength = strlen(sasToken);
+            if (sasTokenLength < sizeof(sessionState->sasToken))
+            {
+                (void)memcpy(sessionState->sasToken, sasToken, sasTokenLength + 1);
+                sessionState->sasTokenExpiry = expiryTime;
+            }
+            else
+            {
+                sessionState->sasTokenExpiry = 0;
+            }
+        }
     }
     else if (cred_type == IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN)
     {
@@ -1711,7 +2107,7 @@ static int SendMqttConnectMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data)
             sasToken = IoTHubClient_Auth_Get_SasToken(transport_data->authorization_module, NULL, 0);
             if (sasToken == NULL)
             {
-                LogError("failure getting sas Token.");
+                LogErrorLimited("failure getting sas Token.");
                 result = __FAILURE__;
             }
         }
@@ -1743,19 +2139,26 @@ static int SendMqttConnectMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data)
         {
             options.password = sasToken;
         }
+        else if (password != NULL)
+        {
+            options.password = (char*)password;
+        }
         options.keepAliveInterval = transport_data->keepAliveValue;
+        /* A session is always asked for, mqtt_persistent_session decides whether the subscriptions it holds are trusted on reconnect */
         options.useCleanSession = false;
         options.qualityOfServiceValue = DELIVER_AT_LEAST_ONCE;
 
         if (GetTransportProviderIfNecessary(transport_data) == 0)
         {
-            if (mqtt_client_connect(transport_data->mqttClient, transport_data->xioTransport, &options) != 0)
+            CreateCoalescingIO(transport_data);
+            if (mqtt_client_connect(transport_data->mqttClient, (transport_data->xioCoalescing != NULL) ? transport_data->xioCoalescing : transport_data->xioTransport, &options) != 0)
             {
                 LogError("failure connecting to address %s:%d.", STRING_c_str(transport_data->hostAddress), transport_data->portNum);
                 result = __FAILURE__;
             }
             else
             {
+                transport_data->isPacketSent = true;
                 (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &transport_data->mqtt_connect_time);
                 result = 0;
             }
@@ -1776,13 +2179,79 @@ static int SendMqttConnectMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 static void DisconnectFromClient(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
     (void)mqtt_client_disconnect(transport_data->mqttClient);
-    xio_destroy(transport_data->xioTransport);
-    transport_data->xioTransport = NULL;
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_019: [ If "keep_underlying_io" is set, the underlying xio shall not be destroyed on a disconnect, unless the transport is being destroyed, and the next connect shall reopen it. ] */
+    if (!transport_data->keepUnderlyingIO || transport_data->isDestroyCalled)
+    {
+        DestroyCoalescingIO(transport_data);
+        xio_destroy(transport_data->xioTransport);
+        transport_data->xioTransport = NULL;
+    }
 
     transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_NOT_CONNECTED;
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE, transport_data, MQTT_CLIENT_STATUS_NOT_CONNECTED);
     transport_data->currPacketState = DISCONNECT_TYPE;
 }
 
+static void CheckConnectionHealth(PMQTTTRANSPORT_HANDLE_DATA transport_data, tickcounter_ms_t current_time)
+{
+    switch (connection_health_check(transport_data->connectionHealth, !DList_IsListEmpty(&transport_data->telemetry_waitingForAck), current_time))
+    {
+        case CONNECTION_HEALTH_ACTION_PROBE:
+        {
+            const char* unsubscribe[1];
+            if ((transport_data->topic_Probe == NULL) &&
+                ((transport_data->topic_Probe = STRING_construct_sprintf(TOPIC_DEVICE_MSG_PROBE, STRING_c_str(transport_data->device_id))) == NULL))
+            {
+                LogErrorLimited("Failure constructing the connection probe topic");
+            }
+            else
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_088: [ Once connection_health_check asks for a probe, IoTHubTransport_MQTT_Common_DoWork shall unsubscribe from devices/<device id>/messages/devicebound/connection-probe, a filter it never subscribes, whose UNSUBACK the hub sends at once. ] */
+                unsubscribe[0] = STRING_c_str(transport_data->topic_Probe);
+                transport_data->probePacketId = get_next_packet_id(transport_data);
+                if (mqtt_client_unsubscribe(transport_data->mqttClient, transport_data->probePacketId, unsubscribe, 1) != 0)
+                {
+                    LogErrorLimited("Failure sending the connection probe");
+                }
+                else
+                {
+                    transport_data->isPacketSent = true;
+                }
+            }
+            break;
+        }
+        case CONNECTION_HEALTH_ACTION_RECONNECT:
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_089: [ Once connection_health_check asks for a reconnection, IoTHubTransport_MQTT_Common_DoWork shall report IOTHUB_CLIENT_CONNECTION_NO_NETWORK, disconnect and connect again. ] */
+            LogError("the hub did not acknowledge for %u ms, reconnecting", connection_health_get_timeout(transport_data->connectionHealth));
+            IoTHubClient_LL_ConnectionStatusCallBack(transport_data->llClientHandle, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
+            DisconnectFromClient(transport_data);
+            ResetTopicsToSubscribe(transport_data);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void ProbeKeepAlive(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    transport_data->keepAliveSafe = transport_data->keepAliveValue;
+    if (transport_data->keepAliveValue >= transport_data->keepAliveMax)
+    {
+        transport_data->keepAliveSettled = true;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_021: [ Once a connection stayed up for two keepalive intervals, IoTHubTransport_MQTT_Common_DoWork shall keep that keepalive and, if it is below "mqtt_keepalive_max", double it up to "mqtt_keepalive_max" and reconnect with it. ] */
+        uint32_t probe = (uint32_t)transport_data->keepAliveValue * 2;
+        transport_data->keepAliveValue = (uint16_t)((probe > transport_data->keepAliveMax) ? transport_data->keepAliveMax : probe);
+        LogInfo("probing a keepalive of %u seconds", (unsigned int)transport_data->keepAliveValue);
+        DisconnectFromClient(transport_data);
+        ResetTopicsToSubscribe(transport_data);
+    }
+}
+
 static int InitializeConnection(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
     int result = 0;
@@ -1792,7 +2261,7 @@ static int InitializeConnection(PMQTTTRANSPORT_HANDLE_DATA transport_data)
     {
         // If we are MQTT_CLIENT_STATUS_NOT_CONNECTED then check to see if we need 
         // to back off the connecting to the server
-        if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_NOT_CONNECTED && transport_data->isRecoverableError && CanRetry(transport_data->retryLogic))
+        if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_NOT_CONNECTED && transport_data->isRecoverableError && CanRetry(transport_data))
         {
             if (tickcounter_get_current_ms(transport_data->msgTickCounter, &transport_data->connectTick) != 0)
             {
@@ -1803,12 +2272,14 @@ static int InitializeConnection(PMQTTTRANSPORT_HANDLE_DATA transport_data)
             {
                 if (SendMqttConnectMsg(transport_data) != 0)
                 {
+                    ForgetAddressFamily(transport_data);
                     transport_data->connectFailCount++;
                     result = __FAILURE__;
                 }
                 else
                 {
                     transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_CONNECTING;
+                    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE, transport_data, MQTT_CLIENT_STATUS_CONNECTING);
                     transport_data->connectFailCount = 0;
                     result = 0;
                 }
@@ -1820,12 +2291,13 @@ static int InitializeConnection(PMQTTTRANSPORT_HANDLE_DATA transport_data)
             tickcounter_ms_t current_time;
             if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_time) != 0)
             {
-                LogError("failed verifying MQTT_CLIENT_STATUS_CONNECTING timeout");
+                LogErrorLimited("failed verifying MQTT_CLIENT_STATUS_CONNECTING timeout");
                 result = __FAILURE__;
             }
             else if ((current_time - transport_data->mqtt_connect_time) / 1000 > transport_data->keepAliveValue) 
             {
-                LogError("mqtt_client timed out waiting for CONNACK");
+                LogErrorLimited("mqtt_client timed out waiting for CONNACK");
+                ForgetAddressFamily(transport_data);
                 DisconnectFromClient(transport_data);
                 result = 0;
             }
@@ -1846,24 +2318,18 @@ static int InitializeConnection(PMQTTTRANSPORT_HANDLE_DATA transport_data)
                     (void)mqtt_client_disconnect(transport_data->mqttClient);
                     IoTHubClient_LL_ConnectionStatusCallBack(transport_data->llClientHandle, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_EXPIRED_SAS_TOKEN);
                     transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_NOT_CONNECTED;
+                    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE, transport_data, MQTT_CLIENT_STATUS_NOT_CONNECTED);
                     transport_data->currPacketState = UNKNOWN_TYPE;
-                    transport_data->device_twin_get_sent = false;
-                    if (transport_data->topic_MqttMessage != NULL)
-                    {
-                        transport_data->topics_ToSubscribe |= SUBSCRIBE_TELEMETRY_TOPIC;
-                    }
-                    if (transport_data->topic_GetState != NULL)
-                    {
-                        transport_data->topics_ToSubscribe |= SUBSCRIBE_GET_REPORTED_STATE_TOPIC;
-                    }
-                    if (transport_data->topic_NotifyState != NULL)
-                    {
-                        transport_data->topics_ToSubscribe |= SUBSCRIBE_NOTIFICATION_STATE_TOPIC;
-                    }
-                    if (transport_data->topic_DeviceMethods != NULL)
-                    {
-                        transport_data->topics_ToSubscribe |= SUBSCRIBE_DEVICE_METHOD_TOPIC;
-                    }
+                    ResetTopicsToSubscribe(transport_data);
+                }
+                else if ((transport_data->keepAliveMax != 0) && !transport_data->keepAliveSettled &&
+                    ((current_time - transport_data->mqtt_connect_time) / 1000 > (tickcounter_ms_t)transport_data->keepAliveValue * KEEPALIVE_PROBE_INTERVALS))
+                {
+                    ProbeKeepAlive(transport_data);
+                }
+                else if ((transport_data->connectionHealth != NULL) && (transport_data->currPacketState == PUBLISH_TYPE))
+                {
+                    CheckConnectionHealth(transport_data, current_time);
                 }
             }
         }
@@ -1963,11 +2429,40 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                         free(state);
                         state = NULL;
                     }
+                    else if (packet_id_table_init(&state->telemetryByPacketId) != 0)
+                    {
+                        LogError("failure allocating the telemetry packet id table.");
+                        STRING_delete(state->configPassedThroughUsername);
+                        STRING_delete(state->devicesPath);
+                        mqtt_client_deinit(state->mqttClient);
+                        STRING_delete(state->hostAddress);
+                        STRING_delete(state->topic_MqttEvent);
+                        STRING_delete(state->device_id);
+                        tickcounter_destroy(state->msgTickCounter);
+                        free(state);
+                        state = NULL;
+                    }
+                    else if (packet_id_table_init(&state->deviceTwinByPacketId) != 0)
+                    {
+                        LogError("failure allocating the device twin packet id table.");
+                        packet_id_table_deinit(&state->telemetryByPacketId);
+                        STRING_delete(state->configPassedThroughUsername);
+                        STRING_delete(state->devicesPath);
+                        mqtt_client_deinit(state->mqttClient);
+                        STRING_delete(state->hostAddress);
+                        STRING_delete(state->topic_MqttEvent);
+                        STRING_delete(state->device_id);
+                        tickcounter_destroy(state->msgTickCounter);
+                        free(state);
+                        state = NULL;
+                    }
                     else
                     {
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_010: [IoTHubTransport_MQTT_Common_Create shall allocate memory to save its internal state where all topics, hostname, device_id, device_key, sasTokenSr and client handle shall be saved.] */
                         DList_InitializeListHead(&(state->telemetry_waitingForAck));
                         DList_InitializeListHead(&(state->ack_waiting_queue));
+                        DList_InitializeListHead(&(state->bridgedDevices));
+                        state->kind = MQTT_DEVICE_HANDLE_TRANSPORT;
                         state->isDestroyCalled = false;
                         state->isRegistered = false;
                         state->mqttClientStatus = MQTT_CLIENT_STATUS_NOT_CONNECTED;
@@ -1980,15 +2475,48 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                         state->waitingToSend = waitingToSend;
                         state->currPacketState = CONNECT_TYPE;
                         state->keepAliveValue = DEFAULT_MQTT_KEEPALIVE;
+                        state->keepAliveMax = 0;
+                        state->keepAliveSafe = DEFAULT_MQTT_KEEPALIVE;
+                        state->keepAliveSettled = false;
                         state->connectFailCount = 0;
                         state->connectTick = 0;
                         state->topic_MqttMessage = NULL;
                         state->topic_GetState = NULL;
                         state->topic_NotifyState = NULL;
                         state->topics_ToSubscribe = UNSUBSCRIBE_FROM_TOPIC;
+                        state->topics_Subscribed = UNSUBSCRIBE_FROM_TOPIC;
+                        state->topics_AwaitingSuback = UNSUBSCRIBE_FROM_TOPIC;
+                        state->persistentSession = false;
+                        state->keepUnderlyingIO = false;
+                        state->happyEyeballs = NULL;
+                        state->writeCoalescingSize = 0;
+                        state->xioCoalescing = NULL;
+                        state->connectionHealth = NULL;
+                        state->topic_Probe = NULL;
+                        state->probePacketId = 0;
                         state->topic_DeviceMethods = NULL;
+                        state->telemetryTopicTemplate = NULL;
+                        state->telemetryTopicBuffer = NULL;
+                        state->telemetryTopicBufferSize = 0;
+                        state->maxInflight = 0;
+                        state->inflightCount = 0;
+                        state->resendInflight = false;
+                        state->telemetryAtMostOnce = false;
+                        state->packing.maxEnvelopeSize = 0;
+                        state->packing.lingerTimeInMs = 0;
+                        state->isPackingLingering = false;
+                        state->packingLingerStartTime = 0;
                         state->log_trace = state->raw_trace = false;
-                        state->retryLogic = NULL;
+                        state->retryControl = NULL;
+                        state->retryInitialWaitTimeInMs = 0;
+                        state->isFirstConnectionAttempted = false;
+                        state->retryExpired = false;
+                        state->isProtocolGateway = (upperConfig->protocolGatewayHostName != NULL);
+                        state->isGatewayBridge = false;
+                        state->sleepyDevice.sessionState = NULL;
+                        state->sleepyDevice.powerDownCallback = NULL;
+                        state->sleepyDevice.powerDownContext = NULL;
+                        state->powerDownReported = false;
                         srand((unsigned int)get_time(NULL));
                         state->authorization_module = auth_module;
                     }
@@ -2076,6 +2604,16 @@ TRANSPORT_LL_HANDLE IoTHubTransport_MQTT_Common_Create(const IOTHUBTRANSPORT_CON
     return result;
 }
 
+static void destroy_bridged_device(MQTT_BRIDGED_DEVICE* bridged_device)
+{
+    STRING_delete(bridged_device->device_id);
+    if (bridged_device->telemetryTopicTemplate != NULL)
+    {
+        free(bridged_device->telemetryTopicTemplate);
+    }
+    free(bridged_device);
+}
+
 void IoTHubTransport_MQTT_Common_Destroy(TRANSPORT_LL_HANDLE handle)
 {
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_012: [IoTHubTransport_MQTT_Common_Destroy shall do nothing if parameter handle is NULL.] */
@@ -2091,8 +2629,16 @@ void IoTHubTransport_MQTT_Common_Destroy(TRANSPORT_LL_HANDLE handle)
         {
             PDLIST_ENTRY currentEntry = DList_RemoveHeadList(&transport_data->telemetry_waitingForAck);
             MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
-            free(mqttMsgEntry);
+            complete_mqtt_message(transport_data, mqttMsgEntry, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+        }
+        packet_id_table_deinit(&transport_data->telemetryByPacketId);
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_037: [ IoTHubTransport_MQTT_Common_Destroy shall free the bridged devices still registered, once their messages waiting for a PUBACK are completed with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. ] */
+        PDLIST_ENTRY bridgedEntry = transport_data->bridgedDevices.Flink;
+        while (bridgedEntry != &transport_data->bridgedDevices)
+        {
+            PDLIST_ENTRY nextBridgedEntry = bridgedEntry->Flink;
+            destroy_bridged_device(containingRecord(bridgedEntry, MQTT_BRIDGED_DEVICE, entry));
+            bridgedEntry = nextBridgedEntry;
         }
         while (!DList_IsListEmpty(&transport_data->ack_waiting_queue))
         {
@@ -2101,6 +2647,7 @@ void IoTHubTransport_MQTT_Common_Destroy(TRANSPORT_LL_HANDLE handle)
             IoTHubClient_LL_ReportedStateComplete(transport_data->llClientHandle, mqtt_device_twin->iothub_msg_id, STATUS_CODE_TIMEOUT_VALUE);
             free(mqtt_device_twin);
         }
+        packet_id_table_deinit(&transport_data->deviceTwinByPacketId);
 
         STRING_delete(transport_data->devicesPath);
 
@@ -2114,11 +2661,27 @@ void IoTHubTransport_MQTT_Common_Destroy(TRANSPORT_LL_HANDLE handle)
         STRING_delete(transport_data->topic_GetState);
         STRING_delete(transport_data->topic_NotifyState);
         STRING_delete(transport_data->topic_DeviceMethods);
+        if (transport_data->topic_Probe != NULL)
+        {
+            STRING_delete(transport_data->topic_Probe);
+        }
+        if (transport_data->connectionHealth != NULL)
+        {
+            connection_health_destroy(transport_data->connectionHealth);
+        }
 
         tickcounter_destroy(transport_data->msgTickCounter);
-        DestroyRetryLogic(transport_data->retryLogic);
+        retry_control_destroy(transport_data->retryControl);
         /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_01_012: [ `IoTHubTransport_MQTT_Common_Destroy` shall free the stored proxy options. ]*/
         free_proxy_data(transport_data);
+        if (transport_data->telemetryTopicTemplate != NULL)
+        {
+            free(transport_data->telemetryTopicTemplate);
+        }
+        if (transport_data->telemetryTopicBuffer != NULL)
+        {
+            free(transport_data->telemetryTopicBuffer);
+        }
         free(transport_data);
     }
 }
@@ -2133,6 +2696,12 @@ int IoTHubTransport_MQTT_Common_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle
         LogError("Invalid handle parameter. NULL.");
         result = __FAILURE__;
     }
+    else if (get_bridged_device(handle) != NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_064: [ IoTHubTransport_MQTT_Common_Subscribe_DeviceTwin shall fail and IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR for a bridged device, and IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin shall do nothing for it. ] */
+        LogError("The device twin is not supported for a bridged device.");
+        result = __FAILURE__;
+    }
     else
     {
         if (transport_data->topic_GetState == NULL)
@@ -2190,12 +2759,19 @@ void IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE han
 {
     PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_048: [If the parameter handle is NULL than IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin shall do nothing.] */
-    if (transport_data != NULL)
+    if ((transport_data != NULL) && (get_bridged_device(handle) != NULL))
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_064: [ IoTHubTransport_MQTT_Common_Subscribe_DeviceTwin shall fail and IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR for a bridged device, and IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin shall do nothing for it. ] */
+        LogError("The device twin is not supported for a bridged device.");
+    }
+    else if (transport_data != NULL)
     {
         if (transport_data->topic_GetState != NULL)
         {
             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_049: [If subscribe_state is set to IOTHUB_DEVICE_TWIN_DESIRED_STATE then IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin shall unsubscribe from the topic_GetState to the mqtt client.] */
             transport_data->topics_ToSubscribe &= ~SUBSCRIBE_GET_REPORTED_STATE_TOPIC;
+            transport_data->topics_Subscribed &= ~SUBSCRIBE_GET_REPORTED_STATE_TOPIC;
+            transport_data->topics_AwaitingSuback &= ~SUBSCRIBE_GET_REPORTED_STATE_TOPIC;
             STRING_delete(transport_data->topic_GetState);
             transport_data->topic_GetState = NULL;
         }
@@ -2203,6 +2779,8 @@ void IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE han
         {
             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_050: [If subscribe_state is set to IOTHUB_DEVICE_TWIN_NOTIFICATION_STATE then IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin shall unsubscribe from the topic_NotifyState to the mqtt client.] */
             transport_data->topics_ToSubscribe &= ~SUBSCRIBE_NOTIFICATION_STATE_TOPIC;
+            transport_data->topics_Subscribed &= ~SUBSCRIBE_NOTIFICATION_STATE_TOPIC;
+            transport_data->topics_AwaitingSuback &= ~SUBSCRIBE_NOTIFICATION_STATE_TOPIC;
             STRING_delete(transport_data->topic_NotifyState);
             transport_data->topic_NotifyState = NULL;
         }
@@ -2224,6 +2802,12 @@ int IoTHubTransport_MQTT_Common_Subscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE hand
         LogError("Invalid handle parameter. NULL.");
         result = __FAILURE__;
     }
+    else if (get_bridged_device(handle) != NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_036: [ IoTHubTransport_MQTT_Common_Subscribe, IoTHubTransport_MQTT_Common_Subscribe_DeviceMethod and IoTHubTransport_MQTT_Common_DeviceMethod_Response shall fail for a bridged device, and IoTHubTransport_MQTT_Common_Unsubscribe and IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod shall do nothing for it. ] */
+        LogError("Device methods are not supported for a bridged device.");
+        result = __FAILURE__;
+    }
     else
     {
         if (transport_data->topic_DeviceMethods == NULL)
@@ -2269,7 +2853,11 @@ void IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE h
 {
     PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
     /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_12_008 : [If the parameter handle is NULL than IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod shall do nothing and return.]*/
-    if (transport_data != NULL)
+    if (transport_data == NULL)
+    {
+        LogError("Invalid argument to unsubscribe (NULL).");
+    }
+    else if (get_bridged_device(handle) == NULL)
     {
         /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_12_009 : [If the MQTT transport has not been subscribed to DEVICE_METHOD topic IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod shall do nothing and return.]*/
         if (transport_data->topic_DeviceMethods != NULL)
@@ -2283,24 +2871,32 @@ void IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE h
             {
                 LogError("Failure calling mqtt_client_unsubscribe");
             }
+            else
+            {
+                transport_data->isPacketSent = true;
+            }
 
             /*Codes_SRS_IOTHUB_MQTT_TRANSPORT_12_012 : [IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod shall removes the signaling flag for DEVICE_METHOD topic from the receiver's topic list. ]*/
             STRING_delete(transport_data->topic_DeviceMethods);
             transport_data->topic_DeviceMethods = NULL;
             transport_data->topics_ToSubscribe &= ~SUBSCRIBE_DEVICE_METHOD_TOPIC;
+            transport_data->topics_Subscribed &= ~SUBSCRIBE_DEVICE_METHOD_TOPIC;
+            transport_data->topics_AwaitingSuback &= ~SUBSCRIBE_DEVICE_METHOD_TOPIC;
         }
     }
-    else
-    {
-        LogError("Invalid argument to unsubscribe (NULL).");
-    }
 }
 
 int IoTHubTransport_MQTT_Common_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle, METHOD_HANDLE methodId, const unsigned char* response, size_t respSize, int status)
 {
     int result;
     MQTTTRANSPORT_HANDLE_DATA* transport_data = (MQTTTRANSPORT_HANDLE_DATA*)handle;
-    if (transport_data != NULL)
+    if ((transport_data != NULL) && (get_bridged_device(handle) != NULL))
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_036: [ IoTHubTransport_MQTT_Common_Subscribe, IoTHubTransport_MQTT_Common_Subscribe_DeviceMethod and IoTHubTransport_MQTT_Common_DeviceMethod_Response shall fail for a bridged device, and IoTHubTransport_MQTT_Common_Unsubscribe and IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod shall do nothing for it. ] */
+        LogError("Device methods are not supported for a bridged device.");
+        result = __FAILURE__;
+    }
+    else if (transport_data != NULL)
     {
         /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_042: [ IoTHubTransport_MQTT_Common_DeviceMethod_Response shall publish an mqtt message for the device method response. ] */
         DEVICE_METHOD_INFO* dev_method_info = (DEVICE_METHOD_INFO*)methodId;
@@ -2344,6 +2940,12 @@ int IoTHubTransport_MQTT_Common_Subscribe(IOTHUB_DEVICE_HANDLE handle)
         LogError("Invalid handle parameter. NULL.");
         result = __FAILURE__;
     }
+    else if (get_bridged_device(handle) != NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_036: [ IoTHubTransport_MQTT_Common_Subscribe, IoTHubTransport_MQTT_Common_Subscribe_DeviceMethod and IoTHubTransport_MQTT_Common_DeviceMethod_Response shall fail for a bridged device, and IoTHubTransport_MQTT_Common_Unsubscribe and IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod shall do nothing for it. ] */
+        LogError("Cloud to device messages are not supported for a bridged device.");
+        result = __FAILURE__;
+    }
     else
     {
         /* Code_SRS_IOTHUB_MQTT_TRANSPORT_07_016: [IoTHubTransport_MQTT_Common_Subscribe shall set a flag to enable mqtt_client_subscribe to be called to subscribe to the Message Topic.] */
@@ -2374,7 +2976,11 @@ void IoTHubTransport_MQTT_Common_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
 {
     PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_019: [If parameter handle is NULL then IoTHubTransport_MQTT_Common_Unsubscribe shall do nothing.] */
-    if (transport_data != NULL)
+    if (transport_data == NULL)
+    {
+        LogError("Invalid argument to unsubscribe (NULL).");
+    }
+    else if (get_bridged_device(handle) == NULL)
     {
         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_020: [IoTHubTransport_MQTT_Common_Unsubscribe shall call mqtt_client_unsubscribe to unsubscribe the mqtt message topic.] */
         const char* unsubscribe[1];
@@ -2383,17 +2989,19 @@ void IoTHubTransport_MQTT_Common_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
         {
             LogError("Failure calling mqtt_client_unsubscribe");
         }
+        else
+        {
+            transport_data->isPacketSent = true;
+        }
         STRING_delete(transport_data->topic_MqttMessage);
         transport_data->topic_MqttMessage = NULL;
         transport_data->topics_ToSubscribe &= ~SUBSCRIBE_TELEMETRY_TOPIC;
-    }
-    else
-    {
-        LogError("Invalid argument to unsubscribe (NULL).");
+        transport_data->topics_Subscribed &= ~SUBSCRIBE_TELEMETRY_TOPIC;
+        transport_data->topics_AwaitingSuback &= ~SUBSCRIBE_TELEMETRY_TOPIC;
     }
 }
 
-IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_MQTT_Common_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_MQTT_Common_ProcessItem(IOTHUB_DEVICE_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
 {
     IOTHUB_PROCESS_ITEM_RESULT result;
     /* Codes_SRS_IOTHUBCLIENT_LL_07_001: [ If handle or iothub_item are NULL then IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR. ]*/
@@ -2402,6 +3010,12 @@ IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_MQTT_Common_ProcessItem(TRANSPORT_LL_
         LogError("Invalid handle parameter iothub_item=%p", iothub_item);
         result = IOTHUB_PROCESS_ERROR;
     }
+    else if (get_bridged_device(handle) != NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_064: [ IoTHubTransport_MQTT_Common_Subscribe_DeviceTwin shall fail and IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR for a bridged device, and IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin shall do nothing for it. ] */
+        LogError("The device twin is not supported for a bridged device.");
+        result = IOTHUB_PROCESS_ERROR;
+    }
     else
     {
         PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
@@ -2416,6 +3030,12 @@ IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_MQTT_Common_ProcessItem(TRANSPORT_LL_
                     /* Codes_SRS_IOTHUBCLIENT_LL_07_004: [ If any errors are encountered IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR. ]*/
                     result = IOTHUB_PROCESS_ERROR;
                 }
+                else if (packet_id_table_reserve(&transport_data->deviceTwinByPacketId) != 0)
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_LL_07_004: [ If any errors are encountered IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR. ]*/
+                    free(mqtt_info);
+                    result = IOTHUB_PROCESS_ERROR;
+                }
                 else
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_07_003: [ IoTHubTransport_MQTT_Common_ProcessItem shall publish a message to the mqtt protocol with the message topic for the message type.]*/
@@ -2430,159 +3050,739 @@ IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_MQTT_Common_ProcessItem(TRANSPORT_LL_
                     {
                         DList_RemoveEntryList(&mqtt_info->entry);
 
-                        free(mqtt_info);
-                        /* Codes_SRS_IOTHUBCLIENT_LL_07_004: [ If any errors are encountered IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR. ]*/
-                        result = IOTHUB_PROCESS_ERROR;
-                    }
-                    else
-                    {
-                        result = IOTHUB_PROCESS_OK;
-                    }
-                }
+                        free(mqtt_info);
+                        /* Codes_SRS_IOTHUBCLIENT_LL_07_004: [ If any errors are encountered IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR. ]*/
+                        result = IOTHUB_PROCESS_ERROR;
+                    }
+                    else
+                    {
+                        packet_id_table_insert(&transport_data->deviceTwinByPacketId, mqtt_info->packet_id, mqtt_info);
+                        result = IOTHUB_PROCESS_OK;
+                    }
+                }
+            }
+            else
+            {
+                /* Codes_SRS_IOTHUBCLIENT_LL_07_006: [ If the item_type is not a supported type IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_CONTINUE. ]*/
+                result = IOTHUB_PROCESS_CONTINUE;
+            }
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBCLIENT_LL_07_002: [ If the mqtt is not ready to publish messages IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_NOT_CONNECTED. ] */
+            result = IOTHUB_PROCESS_NOT_CONNECTED;
+        }
+    }
+    return result;
+}
+
+/* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_054: [ IoTHubTransport_MQTT_Common_DoWork shall subscribe to the Notification and get_state Topics if they are defined. ] */
+static bool is_packable(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE messageHandle, size_t* length)
+{
+    const unsigned char* payload = RetrieveMessagePayload(messageHandle, length);
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_066: [ While "mqtt_packing" is set, a message of the transport device shall be packed if its payload and its length fit in maxEnvelopeSize, it is published at QoS 1 and it has neither a message id nor a correlation id. ] */
+    return (payload != NULL) && (*length != 0) && (*length <= transport_data->packing.maxEnvelopeSize - PACKED_LENGTH_PREFIX_SIZE) &&
+        !is_delivered_at_most_once(transport_data, messageHandle) &&
+        (IoTHubMessage_GetMessageId(messageHandle) == NULL) &&
+        (IoTHubMessage_GetCorrelationId(messageHandle) == NULL);
+}
+
+static bool has_properties(IOTHUB_MESSAGE_HANDLE messageHandle, const char* const* keys, const char* const* values, size_t count)
+{
+    bool result;
+    const char* const* messageKeys = NULL;
+    const char* const* messageValues = NULL;
+    size_t messageCount = 0;
+    MAP_HANDLE properties = IoTHubMessage_Properties(messageHandle);
+    if ((properties != NULL) && (Map_GetInternals(properties, &messageKeys, &messageValues, &messageCount) != MAP_OK))
+    {
+        result = false;
+    }
+    else if (messageCount != count)
+    {
+        result = false;
+    }
+    else
+    {
+        size_t index;
+        result = true;
+        for (index = 0; index < count && result; index++)
+        {
+            result = (strcmp(messageKeys[index], keys[index]) == 0) && (strcmp(messageValues[index], values[index]) == 0);
+        }
+    }
+    return result;
+}
+
+// The messages from first that go in its envelope: the packable messages following it with the same properties, while they
+// fit. isComplete is set when no message queued later could join them, the run ending before the end of waitingToSend or
+// the envelope being full.
+static size_t get_packing_run(PMQTTTRANSPORT_HANDLE_DATA transport_data, PDLIST_ENTRY first, size_t* envelopeLength, bool* isComplete)
+{
+    size_t result;
+    size_t length;
+    const char* const* keys = NULL;
+    const char* const* values = NULL;
+    size_t count = 0;
+    IOTHUB_MESSAGE_HANDLE messageHandle = containingRecord(first, IOTHUB_MESSAGE_LIST, entry)->messageHandle;
+    MAP_HANDLE properties;
+    *envelopeLength = 0;
+    *isComplete = false;
+    if (!is_packable(transport_data, messageHandle, &length) ||
+        (((properties = IoTHubMessage_Properties(messageHandle)) != NULL) && (Map_GetInternals(properties, &keys, &values, &count) != MAP_OK)))
+    {
+        result = 0;
+    }
+    else
+    {
+        PDLIST_ENTRY current = first->Flink;
+        result = 1;
+        *envelopeLength = PACKED_LENGTH_PREFIX_SIZE + length;
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_067: [ An envelope shall hold the packable messages that follow each other in waitingToSend with the same properties, as long as they fit in maxEnvelopeSize. ] */
+        while (!*isComplete && (current != transport_data->waitingToSend))
+        {
+            messageHandle = containingRecord(current, IOTHUB_MESSAGE_LIST, entry)->messageHandle;
+            if (!is_packable(transport_data, messageHandle, &length) ||
+                (*envelopeLength + PACKED_LENGTH_PREFIX_SIZE + length > transport_data->packing.maxEnvelopeSize) ||
+                !has_properties(messageHandle, keys, values, count))
+            {
+                *isComplete = true;
+            }
+            else
+            {
+                result++;
+                *envelopeLength += PACKED_LENGTH_PREFIX_SIZE + length;
+                current = current->Flink;
+            }
+        }
+        if (*envelopeLength + PACKED_LENGTH_PREFIX_SIZE >= transport_data->packing.maxEnvelopeSize)
+        {
+            *isComplete = true;
+        }
+    }
+    return result;
+}
+
+static bool is_packing_lingering(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    bool result;
+    tickcounter_ms_t current_ms;
+    if (transport_data->packing.lingerTimeInMs == 0)
+    {
+        result = false;
+    }
+    else if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) != 0)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_073: [ If the current time is not available, the envelope shall be published without lingering. ] */
+        LogErrorLimited("Failed retrieving tickcounter info, the messages are packed without lingering");
+        result = false;
+    }
+    else if (!transport_data->isPackingLingering)
+    {
+        transport_data->isPackingLingering = true;
+        transport_data->packingLingerStartTime = current_ms;
+        result = true;
+    }
+    else
+    {
+        result = ((current_ms - transport_data->packingLingerStartTime) < transport_data->packing.lingerTimeInMs);
+    }
+    return result;
+}
+
+static int publish_packed_telemetry(PMQTTTRANSPORT_HANDLE_DATA transport_data, PDLIST_ENTRY first, size_t packedCount, size_t envelopeLength, PDLIST_ENTRY* next)
+{
+    int result;
+    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST));
+    if (mqttMsgEntry == NULL)
+    {
+        LogErrorLimited("Allocation Error: Failure allocating MQTT Message Detail List.");
+        result = __FAILURE__;
+    }
+    else if ((mqttMsgEntry->packedPayload = (unsigned char*)malloc(envelopeLength)) == NULL)
+    {
+        LogErrorLimited("Allocation Error: Failure allocating the payload of an envelope.");
+        free(mqttMsgEntry);
+        result = __FAILURE__;
+    }
+    else if (packet_id_table_reserve(&transport_data->telemetryByPacketId) != 0)
+    {
+        LogErrorLimited("Allocation Error: Failure growing the telemetry packet id table.");
+        free(mqttMsgEntry->packedPayload);
+        free(mqttMsgEntry);
+        result = __FAILURE__;
+    }
+    else
+    {
+        PDLIST_ENTRY current = first;
+        size_t position = 0;
+        size_t index;
+        mqttMsgEntry->retryCount = 0;
+        mqttMsgEntry->iotHubMessageEntry = containingRecord(first, IOTHUB_MESSAGE_LIST, entry);
+        mqttMsgEntry->bridgedDevice = NULL;
+        mqttMsgEntry->packet_id = get_next_packet_id(transport_data);
+        mqttMsgEntry->packedCount = packedCount;
+        mqttMsgEntry->packedPayloadLength = envelopeLength;
+        DList_InitializeListHead(&mqttMsgEntry->packedMessages);
+        for (index = 0; index < packedCount; index++)
+        {
+            PDLIST_ENTRY following = current->Flink;
+            size_t length;
+            const unsigned char* payload = RetrieveMessagePayload(containingRecord(current, IOTHUB_MESSAGE_LIST, entry)->messageHandle, &length);
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_068: [ The payload of an envelope shall be, for each of its messages in the order they were queued, the length of its payload on 4 bytes in network order followed by its payload. ] */
+            mqttMsgEntry->packedPayload[position++] = (unsigned char)((length >> 24) & 0xFF);
+            mqttMsgEntry->packedPayload[position++] = (unsigned char)((length >> 16) & 0xFF);
+            mqttMsgEntry->packedPayload[position++] = (unsigned char)((length >> 8) & 0xFF);
+            mqttMsgEntry->packedPayload[position++] = (unsigned char)(length & 0xFF);
+            (void)memcpy(mqttMsgEntry->packedPayload + position, payload, length);
+            position += length;
+            (void)DList_RemoveEntryList(current);
+            DList_InsertTailList(&mqttMsgEntry->packedMessages, current);
+            current = following;
+        }
+        *next = current;
+
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_001: [For a traced message, IoTHubTransport_MQTT_Common_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT before publishing it.] */
+        trace_mqtt_message(mqttMsgEntry, IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT);
+        if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, mqttMsgEntry->packedPayload, envelopeLength) != 0)
+        {
+            complete_mqtt_message(transport_data, mqttMsgEntry, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_070: [ The messages of an envelope shall be completed together, with the result of the envelope. ] */
+            DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(mqttMsgEntry->entry));
+            packet_id_table_insert(&transport_data->telemetryByPacketId, mqttMsgEntry->packet_id, mqttMsgEntry);
+            transport_data->inflightCount++;
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_002: [For a traced message, IoTHubTransport_MQTT_Common_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN once mqtt_client_publish succeeds.] */
+            trace_mqtt_message(mqttMsgEntry, IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
+        }
+        result = 0;
+    }
+    return result;
+}
+
+static MQTT_PACKING_RESULT pack_waiting_telemetry(PMQTTTRANSPORT_HANDLE_DATA transport_data, PDLIST_ENTRY first, PDLIST_ENTRY* next)
+{
+    MQTT_PACKING_RESULT result;
+    size_t envelopeLength;
+    bool isComplete;
+    size_t packedCount = get_packing_run(transport_data, first, &envelopeLength, &isComplete);
+    if (packedCount == 0)
+    {
+        result = MQTT_PACKING_PUBLISH_ALONE;
+    }
+    else if (!isComplete && is_packing_lingering(transport_data))
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_072: [ If lingerTimeInMs is not 0, the messages of an envelope that is not complete shall stay in waitingToSend until lingerTimeInMs has elapsed since the first IoTHubTransport_MQTT_Common_DoWork that held them back. ] */
+        result = MQTT_PACKING_LINGER;
+    }
+    else
+    {
+        transport_data->isPackingLingering = false;
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_074: [ A message left alone in its envelope, or whose envelope cannot be allocated, shall be published as it is. ] */
+        result = ((packedCount > 1) && (publish_packed_telemetry(transport_data, first, packedCount, envelopeLength, next) == 0)) ?
+            MQTT_PACKING_PUBLISHED : MQTT_PACKING_PUBLISH_ALONE;
+    }
+    return result;
+}
+
+static void send_waiting_telemetry(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_BRIDGED_DEVICE* bridged_device)
+{
+    PDLIST_ENTRY waitingToSend = (bridged_device == NULL) ? transport_data->waitingToSend : bridged_device->waitingToSend;
+    PDLIST_ENTRY currentListEntry = waitingToSend->Flink;
+    MQTT_PACKING_RESULT packing = MQTT_PACKING_PUBLISH_ALONE;
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_007: [ If mqtt_max_inflight messages are waiting for their PUBACK, IoTHubTransport_MQTT_Common_DoWork shall leave the remaining messages in waitingToSend. ] */
+    while ((currentListEntry != waitingToSend) && (packing != MQTT_PACKING_LINGER) &&
+        ((transport_data->maxInflight == 0) || (transport_data->inflightCount < transport_data->maxInflight)))
+    {
+        IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
+        DLIST_ENTRY savedFromCurrentListEntry;
+        savedFromCurrentListEntry.Flink = currentListEntry->Flink;
+
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_075: [ The messages of bridged devices shall not be packed. ] */
+        packing = ((bridged_device == NULL) && (transport_data->packing.maxEnvelopeSize != 0)) ?
+            pack_waiting_telemetry(transport_data, currentListEntry, &savedFromCurrentListEntry.Flink) : MQTT_PACKING_PUBLISH_ALONE;
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
+        size_t messageLength;
+        const unsigned char* messagePayload;
+        if (packing != MQTT_PACKING_PUBLISH_ALONE)
+        {
+            // published in an envelope from this message, or left lingering for more messages
+        }
+        else if (((messagePayload = RetrieveMessagePayload(iothubMsgList->messageHandle, &messageLength)) == NULL) || (messageLength == 0))
+        {
+            LogErrorLimited("Failure result from IoTHubMessage_GetData");
+        }
+        else if (is_delivered_at_most_once(transport_data, iothubMsgList->messageHandle))
+        {
+            if (iothubMsgList->traced)
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_001: [For a traced message, IoTHubTransport_MQTT_Common_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT before publishing it.] */
+                IoTHubClient_LL_TraceMessage(iothubMsgList, IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT);
+            }
+            (void)(DList_RemoveEntryList(currentListEntry));
+            if (publish_mqtt_telemetry_msg_at_most_once(transport_data, bridged_device, iothubMsgList->messageHandle, messagePayload, messageLength) != 0)
+            {
+                sendMsgComplete(iothubMsgList, transport_data, bridged_device, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+            }
+            else
+            {
+                if (iothubMsgList->traced)
+                {
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_002: [For a traced message, IoTHubTransport_MQTT_Common_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN once mqtt_client_publish succeeds.] */
+                    IoTHubClient_LL_TraceMessage(iothubMsgList, IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
+                }
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_011: [ IoTHubTransport_MQTT_Common_DoWork shall complete a message published at QoS 0 with IOTHUB_CLIENT_CONFIRMATION_OK as soon as mqtt_client_publish succeeds, without keeping it for a PUBACK. ] */
+                sendMsgComplete(iothubMsgList, transport_data, bridged_device, IOTHUB_CLIENT_CONFIRMATION_OK);
+            }
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_029: [IoTHubTransport_MQTT_Common_DoWork shall create a MQTT_MESSAGE_HANDLE and pass this to a call to mqtt_client_publish.] */
+            MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST));
+            if (mqttMsgEntry == NULL)
+            {
+                LogErrorLimited("Allocation Error: Failure allocating MQTT Message Detail List.");
+            }
+            else if (packet_id_table_reserve(&transport_data->telemetryByPacketId) != 0)
+            {
+                LogErrorLimited("Allocation Error: Failure growing the telemetry packet id table.");
+                free(mqttMsgEntry);
+            }
+            else
+            {
+                mqttMsgEntry->retryCount = 0;
+                mqttMsgEntry->iotHubMessageEntry = iothubMsgList;
+                mqttMsgEntry->bridgedDevice = bridged_device;
+                mqttMsgEntry->packet_id = get_next_packet_id(transport_data);
+                mqttMsgEntry->packedCount = 0;
+                mqttMsgEntry->packedPayload = NULL;
+                if (iothubMsgList->traced)
+                {
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_001: [For a traced message, IoTHubTransport_MQTT_Common_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT before publishing it.] */
+                    IoTHubClient_LL_TraceMessage(iothubMsgList, IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT);
+                }
+                if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
+                {
+                    (void)(DList_RemoveEntryList(currentListEntry));
+                    sendMsgComplete(iothubMsgList, transport_data, bridged_device, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                    free(mqttMsgEntry);
+                }
+                else
+                {
+                    (void)(DList_RemoveEntryList(currentListEntry));
+                    DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(mqttMsgEntry->entry));
+                    packet_id_table_insert(&transport_data->telemetryByPacketId, mqttMsgEntry->packet_id, mqttMsgEntry);
+                    transport_data->inflightCount++;
+                    if (iothubMsgList->traced)
+                    {
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_002: [For a traced message, IoTHubTransport_MQTT_Common_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN once mqtt_client_publish succeeds.] */
+                        IoTHubClient_LL_TraceMessage(iothubMsgList, IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
+                    }
+                }
+            }
+        }
+        currentListEntry = savedFromCurrentListEntry.Flink;
+    }
+
+    if ((bridged_device == NULL) && (waitingToSend->Flink == waitingToSend))
+    {
+        transport_data->isPackingLingering = false;
+    }
+}
+
+static bool has_work_pending(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    bool result = (transport_data->waitingToSend->Flink != transport_data->waitingToSend) ||
+        (transport_data->telemetry_waitingForAck.Flink != &transport_data->telemetry_waitingForAck) ||
+        (transport_data->ack_waiting_queue.Flink != &transport_data->ack_waiting_queue);
+    PDLIST_ENTRY bridgedEntry = transport_data->bridgedDevices.Flink;
+    while (!result && (bridgedEntry != &transport_data->bridgedDevices))
+    {
+        MQTT_BRIDGED_DEVICE* bridged_device = containingRecord(bridgedEntry, MQTT_BRIDGED_DEVICE, entry);
+        result = (bridged_device->waitingToSend->Flink != bridged_device->waitingToSend);
+        bridgedEntry = bridgedEntry->Flink;
+    }
+    return result;
+}
+
+static void report_power_down_if_idle(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    if ((transport_data->currPacketState != PUBLISH_TYPE) || has_work_pending(transport_data))
+    {
+        transport_data->powerDownReported = false;
+    }
+    else if (!transport_data->powerDownReported)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_043: [ While "mqtt_sleepy_device" is set, once the subscriptions are done and no telemetry, twin request or message of a bridged device is left to send or to be acknowledged, IoTHubTransport_MQTT_Common_DoWork shall save the session state and call powerDownCallback once, until there is work to do again. ] */
+        transport_data->powerDownReported = true;
+        save_session_state(transport_data);
+        if (transport_data->sleepyDevice.powerDownCallback != NULL)
+        {
+            transport_data->sleepyDevice.powerDownCallback(transport_data->sleepyDevice.powerDownContext);
+        }
+    }
+}
+
+void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_026: [IoTHubTransport_MQTT_Common_DoWork shall do nothing if parameter handle and/or iotHubClientHandle is NULL.] */
+    PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
+    MQTT_BRIDGED_DEVICE* bridged_device;
+    if (transport_data != NULL && iotHubClientHandle != NULL)
+    {
+        if ((bridged_device = find_bridged_device_by_client(transport_data, iotHubClientHandle)) != NULL)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_035: [ When called for the client of a bridged device, IoTHubTransport_MQTT_Common_DoWork shall only publish the messages of its waitingToSend, once the connection of the transport device is ready to publish. ] */
+            if (transport_data->currPacketState == PUBLISH_TYPE)
+            {
+                CorkTransport(transport_data, true);
+                send_waiting_telemetry(transport_data, bridged_device);
+                CorkTransport(transport_data, false);
+            }
+        }
+        else
+        {
+            transport_data->llClientHandle = iotHubClientHandle;
+
+            if (InitializeConnection(transport_data) != 0)
+            {
+                // Don't want to flood the logs with failures here
+            }
+            else
+            {
+                CorkTransport(transport_data, true);
+                if (transport_data->currPacketState == CONNACK_TYPE || transport_data->currPacketState == SUBSCRIBE_TYPE)
+                {
+                    SubscribeToMqttProtocol(transport_data);
+                }
+                else if (transport_data->currPacketState == SUBACK_TYPE)
+                {
+                    if ((transport_data->topic_NotifyState != NULL || transport_data->topic_GetState != NULL) &&
+                        !transport_data->device_twin_get_sent)
+                    {
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_055: [ IoTHubTransport_MQTT_Common_DoWork shall send a device twin get property message upon successfully retrieving a SUBACK on device twin topics. ] */
+                        if (publish_device_twin_get_message(transport_data) == 0)
+                        {
+                            transport_data->device_twin_get_sent = true;
+                        }
+                        else
+                        {
+                            LogErrorLimited("Failure: sending device twin get property command.");
+                        }
+                    }
+                    // Publish can be called now
+                    transport_data->currPacketState = PUBLISH_TYPE;
+                }
+                else if (transport_data->currPacketState == PUBLISH_TYPE)
+                {
+                    PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
+                    while (currentListEntry != &transport_data->telemetry_waitingForAck)
+                    {
+                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
+                        DLIST_ENTRY nextListEntry;
+                        nextListEntry.Flink = currentListEntry->Flink;
+
+                        tickcounter_ms_t current_ms;
+                        (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
+                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_033: [IoTHubTransport_MQTT_Common_DoWork shall iterate through the Waiting Acknowledge messages looking for any message that has been waiting longer than 2 min.]*/
+                        if (transport_data->resendInflight || (((current_ms - mqttMsgEntry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN))
+                        {
+                            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_034: [If IoTHubTransport_MQTT_Common_DoWork has resent the message two times then it shall fail the message] */
+                            if (!transport_data->resendInflight && (mqttMsgEntry->retryCount >= MAX_SEND_RECOUNT_LIMIT))
+                            {
+                                (void)DList_RemoveEntryList(currentListEntry);
+                                packet_id_table_remove(&transport_data->telemetryByPacketId, mqttMsgEntry->packet_id, mqttMsgEntry);
+                                transport_data->inflightCount--;
+                                complete_mqtt_message(transport_data, mqttMsgEntry, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
+                            }
+                            else
+                            {
+                                size_t messageLength;
+                                const unsigned char* messagePayload;
+                                if (mqttMsgEntry->packedCount == 0)
+                                {
+                                    messagePayload = RetrieveMessagePayload(mqttMsgEntry->iotHubMessageEntry->messageHandle, &messageLength);
+                                }
+                                else
+                                {
+                                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_071: [ An envelope shall be published again as it was first published, under the rules of the messages published alone. ] */
+                                    messagePayload = mqttMsgEntry->packedPayload;
+                                    messageLength = mqttMsgEntry->packedPayloadLength;
+                                }
+                                if (messageLength == 0 || messagePayload == NULL)
+                                {
+                                    LogErrorLimited("Failure from creating Message IoTHubMessage_GetData");
+                                }
+                                else
+                                {
+                                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_001: [For a traced message, IoTHubTransport_MQTT_Common_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT before publishing it.] */
+                                    trace_mqtt_message(mqttMsgEntry, IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT);
+                                    if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
+                                    {
+                                        (void)DList_RemoveEntryList(currentListEntry);
+                                        packet_id_table_remove(&transport_data->telemetryByPacketId, mqttMsgEntry->packet_id, mqttMsgEntry);
+                                        transport_data->inflightCount--;
+                                        complete_mqtt_message(transport_data, mqttMsgEntry, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                                    }
+                                    else
+                                    {
+                                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_002: [For a traced message, IoTHubTransport_MQTT_Common_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN once mqtt_client_publish succeeds.] */
+                                        trace_mqtt_message(mqttMsgEntry, IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
+                                    }
+                                }
+                            }
+                        }
+                        currentListEntry = nextListEntry.Flink;
+                    }
+                    transport_data->resendInflight = false;
+
+                    send_waiting_telemetry(transport_data, NULL);
+                }
+                CorkTransport(transport_data, false);
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_030: [IoTHubTransport_MQTT_Common_DoWork shall call mqtt_client_dowork everytime it is called if it is connected.] */
+                mqtt_client_dowork(transport_data->mqttClient);
+                if (transport_data->isPingDue)
+                {
+                    transport_data->isPingDue = false;
+                    transport_data->isPacketSent = true;
+                }
+
+                if (transport_data->sleepyDevice.sessionState != NULL)
+                {
+                    report_power_down_if_idle(transport_data);
+                }
+            }
+        }
+    }
+}
+
+static uint32_t ms_until(tickcounter_ms_t due_time, tickcounter_ms_t current_time)
+{
+    return (due_time <= current_time) ? 0 :
+        (due_time - current_time >= IOTHUB_CLIENT_NO_WORK_DEADLINE) ? (IOTHUB_CLIENT_NO_WORK_DEADLINE - 1) :
+        (uint32_t)(due_time - current_time);
+}
+
+static bool has_telemetry_to_publish(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    bool result = false;
+    if ((transport_data->maxInflight == 0) || (transport_data->inflightCount < transport_data->maxInflight))
+    {
+        PDLIST_ENTRY bridgedEntry = transport_data->bridgedDevices.Flink;
+        result = !DList_IsListEmpty(transport_data->waitingToSend) && !transport_data->isPackingLingering;
+        while (!result && (bridgedEntry != &transport_data->bridgedDevices))
+        {
+            result = !DList_IsListEmpty(containingRecord(bridgedEntry, MQTT_BRIDGED_DEVICE, entry)->waitingToSend);
+            bridgedEntry = bridgedEntry->Flink;
+        }
+    }
+    return result;
+}
+
+static uint32_t get_retry_deadline(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    uint32_t result;
+    RETRY_ACTION retry_action;
+    unsigned int wait_time_in_ms;
+    if (!transport_data->isFirstConnectionAttempted || (transport_data->retryControl == NULL))
+    {
+        result = 0;
+    }
+    else if (retry_control_get_wait_time(transport_data->retryControl, &retry_action, &wait_time_in_ms) != 0)
+    {
+        LogErrorLimited("unable to get the time of the next connection retry");
+        result = 0;
+    }
+    else if (retry_action == RETRY_ACTION_STOP_RETRYING)
+    {
+        result = IOTHUB_CLIENT_NO_WORK_DEADLINE;
+    }
+    else
+    {
+        result = (retry_action == RETRY_ACTION_RETRY_NOW) ? 0 : (uint32_t)wait_time_in_ms;
+    }
+    return result;
+}
+
+static bool has_packets_to_send(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    return (transport_data->currPacketState == CONNACK_TYPE) || (transport_data->currPacketState == SUBACK_TYPE) ||
+        ((transport_data->currPacketState == SUBSCRIBE_TYPE) && (transport_data->topics_ToSubscribe != UNSUBSCRIBE_FROM_TOPIC)) ||
+        ((transport_data->currPacketState == PUBLISH_TYPE) && (transport_data->resendInflight || has_telemetry_to_publish(transport_data)));
+}
+
+static uint32_t get_connected_deadline(PMQTTTRANSPORT_HANDLE_DATA transport_data, tickcounter_ms_t current_time)
+{
+    uint32_t result;
+    if (has_packets_to_send(transport_data))
+    {
+        result = 0;
+    }
+    else
+    {
+        uint32_t deadline;
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_048: [ While connected, the deadline shall be no later than the reconnection that refreshes the SAS token and, while the adaptive keepalive is probed, the reconnection with the next keepalive. ] */
+        result = ms_until(transport_data->mqtt_connect_time + ((tickcounter_ms_t)(SAS_TOKEN_DEFAULT_LIFETIME*SAS_REFRESH_MULTIPLIER) + 1) * 1000, current_time);
+        if ((transport_data->keepAliveMax != 0) && !transport_data->keepAliveSettled &&
+            ((deadline = ms_until(transport_data->mqtt_connect_time + ((tickcounter_ms_t)transport_data->keepAliveValue * KEEPALIVE_PROBE_INTERVALS + 1) * 1000, current_time)) < result))
+        {
+            result = deadline;
+        }
+
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_049: [ While connected with a keepalive, the deadline shall be no later than the ping mqtt_client sends once no packet was given to it for the keepalive less KEEPALIVE_PING_LEAD_SECS seconds. ] */
+        if (transport_data->keepAliveValue != 0)
+        {
+            tickcounter_ms_t ping_after = (transport_data->keepAliveValue > KEEPALIVE_PING_LEAD_SECS) ?
+                ((tickcounter_ms_t)transport_data->keepAliveValue - KEEPALIVE_PING_LEAD_SECS) * 1000 : 0;
+            deadline = ms_until(transport_data->lastPacketSentTime + ping_after, current_time);
+            transport_data->isPingDue = (deadline == 0);
+            if (deadline < result)
+            {
+                result = deadline;
             }
-            else
+        }
+
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_091: [ If connection_health is set, the deadline shall be no later than the time connection_health_get_due_time gives. ] */
+        if ((transport_data->connectionHealth != NULL) && (transport_data->currPacketState == PUBLISH_TYPE))
+        {
+            tickcounter_ms_t due_time;
+            if (connection_health_get_due_time(transport_data->connectionHealth, &due_time) &&
+                ((deadline = ms_until(due_time, current_time)) < result))
             {
-                /* Codes_SRS_IOTHUBCLIENT_LL_07_006: [ If the item_type is not a supported type IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_CONTINUE. ]*/
-                result = IOTHUB_PROCESS_CONTINUE;
+                result = deadline;
             }
         }
-        else
+
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_050: [ The deadline shall be no later than the time the oldest telemetry message waiting for its PUBACK is published again. ] */
+        if (transport_data->currPacketState == PUBLISH_TYPE)
         {
-            /* Codes_SRS_IOTHUBCLIENT_LL_07_002: [ If the mqtt is not ready to publish messages IoTHubTransport_MQTT_Common_ProcessItem shall return IOTHUB_PROCESS_NOT_CONNECTED. ] */
-            result = IOTHUB_PROCESS_NOT_CONNECTED;
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_076: [ While messages linger for their envelope, the deadline shall be no later than the end of lingerTimeInMs. ] */
+            if (transport_data->isPackingLingering &&
+                ((deadline = ms_until(transport_data->packingLingerStartTime + transport_data->packing.lingerTimeInMs, current_time)) < result))
+            {
+                result = deadline;
+            }
+
+            PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
+            while (currentListEntry != &transport_data->telemetry_waitingForAck)
+            {
+                MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
+                deadline = ms_until(mqttMsgEntry->msgPublishTime + ((tickcounter_ms_t)RESEND_TIMEOUT_VALUE_MIN + 1) * 1000, current_time);
+                if (deadline < result)
+                {
+                    result = deadline;
+                }
+                currentListEntry = currentListEntry->Flink;
+            }
         }
     }
     return result;
 }
 
-/* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_054: [ IoTHubTransport_MQTT_Common_DoWork shall subscribe to the Notification and get_state Topics if they are defined. ] */
-void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+uint32_t IoTHubTransport_MQTT_Common_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, bool* isWaitingForNetwork)
 {
-    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_026: [IoTHubTransport_MQTT_Common_DoWork shall do nothing if parameter handle and/or iotHubClientHandle is NULL.] */
+    uint32_t result;
     PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
-    if (transport_data != NULL && iotHubClientHandle != NULL)
+    tickcounter_ms_t current_time;
+    if ((transport_data == NULL) || (isWaitingForNetwork == NULL))
     {
-        transport_data->llClientHandle = iotHubClientHandle;
-
-        if (InitializeConnection(transport_data) != 0)
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_047: [ If handle or isWaitingForNetwork is NULL, IoTHubTransport_MQTT_Common_GetNextWorkDeadline shall return 0. ] */
+        LogError("Invalid argument handle=%p, isWaitingForNetwork=%p", handle, isWaitingForNetwork);
+        result = 0;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_051: [ IoTHubTransport_MQTT_Common_GetNextWorkDeadline shall set isWaitingForNetwork to true while the connection is open or being opened. ] */
+        *isWaitingForNetwork = (transport_data->mqttClientStatus != MQTT_CLIENT_STATUS_NOT_CONNECTED);
+        if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_time) != 0)
         {
-            // Don't want to flood the logs with failures here
+            LogErrorLimited("unable to get the current ms");
+            result = 0;
         }
         else
         {
-            if (transport_data->currPacketState == CONNACK_TYPE || transport_data->currPacketState == SUBSCRIBE_TYPE)
+            if (transport_data->isPacketSent)
             {
-                SubscribeToMqttProtocol(transport_data);
+                transport_data->isPacketSent = false;
+                transport_data->lastPacketSentTime = current_time;
             }
-            else if (transport_data->currPacketState == SUBACK_TYPE)
+
+            if (transport_data->isDestroyCalled)
             {
-                if ((transport_data->topic_NotifyState != NULL || transport_data->topic_GetState != NULL) &&
-                    !transport_data->device_twin_get_sent)
-                {
-                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_055: [ IoTHubTransport_MQTT_Common_DoWork shall send a device twin get property message upon successfully retrieving a SUBACK on device twin topics. ] */
-                    if (publish_device_twin_get_message(transport_data) == 0)
-                    {
-                        transport_data->device_twin_get_sent = true;
-                    }
-                    else
-                    {
-                        LogError("Failure: sending device twin get property command.");
-                    }
-                }
-                // Publish can be called now
-                transport_data->currPacketState = PUBLISH_TYPE;
+                result = IOTHUB_CLIENT_NO_WORK_DEADLINE;
             }
-            else if (transport_data->currPacketState == PUBLISH_TYPE)
+            else if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_NOT_CONNECTED)
             {
-                PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
-                while (currentListEntry != &transport_data->telemetry_waitingForAck)
-                {
-                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                    DLIST_ENTRY nextListEntry;
-                    nextListEntry.Flink = currentListEntry->Flink;
-
-                    tickcounter_ms_t current_ms;
-                    (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
-                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_033: [IoTHubTransport_MQTT_Common_DoWork shall iterate through the Waiting Acknowledge messages looking for any message that has been waiting longer than 2 min.]*/
-                    if (((current_ms - mqttMsgEntry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
-                    {
-                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_034: [If IoTHubTransport_MQTT_Common_DoWork has resent the message two times then it shall fail the message] */
-                        if (mqttMsgEntry->retryCount >= MAX_SEND_RECOUNT_LIMIT)
-                        {
-                            (void)DList_RemoveEntryList(currentListEntry);
-                            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
-                            free(mqttMsgEntry);
-                        }
-                        else
-                        {
-                            size_t messageLength;
-                            const unsigned char* messagePayload = RetrieveMessagePayload(mqttMsgEntry->iotHubMessageEntry->messageHandle, &messageLength);
-                            if (messageLength == 0 || messagePayload == NULL)
-                            {
-                                LogError("Failure from creating Message IoTHubMessage_GetData");
-                            }
-                            else
-                            {
-                                if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
-                                {
-                                    (void)DList_RemoveEntryList(currentListEntry);
-                                    sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                                    free(mqttMsgEntry);
-                                }
-                            }
-                        }
-                    }
-                    currentListEntry = nextListEntry.Flink;
-                }
-
-                currentListEntry = transport_data->waitingToSend->Flink;
-                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                while (currentListEntry != transport_data->waitingToSend)
-                {
-                    IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
-                    DLIST_ENTRY savedFromCurrentListEntry;
-                    savedFromCurrentListEntry.Flink = currentListEntry->Flink;
-
-                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                    size_t messageLength;
-                    const unsigned char* messagePayload = RetrieveMessagePayload(iothubMsgList->messageHandle, &messageLength);
-                    if (messageLength == 0 || messagePayload == NULL)
-                    {
-                        LogError("Failure result from IoTHubMessage_GetData");
-                    }
-                    else
-                    {
-                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_029: [IoTHubTransport_MQTT_Common_DoWork shall create a MQTT_MESSAGE_HANDLE and pass this to a call to mqtt_client_publish.] */
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST));
-                        if (mqttMsgEntry == NULL)
-                        {
-                            LogError("Allocation Error: Failure allocating MQTT Message Detail List.");
-                        }
-                        else
-                        {
-                            mqttMsgEntry->retryCount = 0;
-                            mqttMsgEntry->iotHubMessageEntry = iothubMsgList;
-                            mqttMsgEntry->packet_id = get_next_packet_id(transport_data);
-                            if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
-                            {
-                                (void)(DList_RemoveEntryList(currentListEntry));
-                                sendMsgComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                                free(mqttMsgEntry);
-                            }
-                            else
-                            {
-                                (void)(DList_RemoveEntryList(currentListEntry));
-                                DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(mqttMsgEntry->entry));
-                            }
-                        }
-                    }
-                    currentListEntry = savedFromCurrentListEntry.Flink;
-                }
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_052: [ While not connected, the deadline shall be the next connection retry, as told by retry_control_get_wait_time, and IOTHUB_CLIENT_NO_WORK_DEADLINE once the connection is not retried. ] */
+                result = transport_data->isRecoverableError ? get_retry_deadline(transport_data) : IOTHUB_CLIENT_NO_WORK_DEADLINE;
+            }
+            else if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_CONNECTING)
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_053: [ While connecting, the deadline shall be the time the CONNACK stops being waited for. ] */
+                result = ms_until(transport_data->mqtt_connect_time + ((tickcounter_ms_t)transport_data->keepAliveValue + 1) * 1000, current_time);
+            }
+            else
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_054: [ While connected, the deadline shall be 0 while topics are to be subscribed or telemetry is to be published. ] */
+                result = get_connected_deadline(transport_data, current_time);
             }
-            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_030: [IoTHubTransport_MQTT_Common_DoWork shall call mqtt_client_dowork everytime it is called if it is connected.] */
-            mqtt_client_dowork(transport_data->mqttClient);
         }
     }
+    return result;
+}
+
+size_t IoTHubTransport_MQTT_Common_GetPollDescriptors(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_POLL_DESCRIPTOR* descriptors, size_t descriptorCount)
+{
+    size_t result;
+    PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
+    intptr_t descriptor;
+    if ((transport_data == NULL) || ((descriptors == NULL) && (descriptorCount != 0)))
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_056: [ If handle is NULL, or descriptors is NULL while descriptorCount is not 0, IoTHubTransport_MQTT_Common_GetPollDescriptors shall return 0. ] */
+        LogError("Invalid argument handle=%p, descriptors=%p", handle, descriptors);
+        result = 0;
+    }
+    else if ((descriptorCount == 0) || (transport_data->xioTransport == NULL) || (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_NOT_CONNECTED))
+    {
+        result = 0;
+    }
+    else if (xio_setoption(transport_data->xioTransport, OPTION_XIO_SOCKET_DESCRIPTOR, &descriptor) != 0)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_057: [ If xio_setoption with OPTION_XIO_SOCKET_DESCRIPTOR fails, IoTHubTransport_MQTT_Common_GetPollDescriptors shall return 0. ] */
+        result = 0;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_058: [ While a connection is open or being opened, IoTHubTransport_MQTT_Common_GetPollDescriptors shall write the socket the xio gives for OPTION_XIO_SOCKET_DESCRIPTOR, to be waited for readable, and writable while connecting or while packets are to be sent, and return 1. ] */
+        descriptors[0].descriptor = descriptor;
+        descriptors[0].events = IOTHUB_CLIENT_POLL_READABLE;
+        if ((transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_CONNECTING) || has_packets_to_send(transport_data))
+        {
+            descriptors[0].events |= IOTHUB_CLIENT_POLL_WRITABLE;
+        }
+        result = 1;
+    }
+    return result;
+}
+
+void IoTHubTransport_MQTT_Common_TrimMemory(TRANSPORT_LL_HANDLE handle)
+{
+    PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
+    if (transport_data == NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_061: [ If handle is NULL, IoTHubTransport_MQTT_Common_TrimMemory shall do nothing. ] */
+        LogError("Invalid argument handle=%p", handle);
+    }
+    else if (transport_data->telemetryTopicBuffer != NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_062: [ IoTHubTransport_MQTT_Common_TrimMemory shall free the buffer the telemetry topics are built in, the next PUBLISH allocates it again. ] */
+        free(transport_data->telemetryTopicBuffer);
+        transport_data->telemetryTopicBuffer = NULL;
+        transport_data->telemetryTopicBufferSize = 0;
+    }
 }
 
 IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
@@ -2595,6 +3795,20 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_GetSendStatus(IOTHUB_DEVICE_HAN
         LogError("invalid arument.");
         result = IOTHUB_CLIENT_INVALID_ARG;
     }
+    else if (get_bridged_device(handle) != NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_038: [ For a bridged device, IoTHubTransport_MQTT_Common_GetSendStatus shall return IOTHUB_CLIENT_SEND_STATUS_BUSY while its waitingToSend is not empty or one of its messages waits for a PUBACK, IOTHUB_CLIENT_SEND_STATUS_IDLE otherwise. ] */
+        MQTT_BRIDGED_DEVICE* bridged_device = get_bridged_device(handle);
+        bool isBusy = !DList_IsListEmpty(bridged_device->waitingToSend);
+        PDLIST_ENTRY currentListEntry = bridged_device->transport_data->telemetry_waitingForAck.Flink;
+        while (!isBusy && (currentListEntry != &bridged_device->transport_data->telemetry_waitingForAck))
+        {
+            isBusy = (containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry)->bridgedDevice == bridged_device);
+            currentListEntry = currentListEntry->Flink;
+        }
+        *iotHubClientStatus = isBusy ? IOTHUB_CLIENT_SEND_STATUS_BUSY : IOTHUB_CLIENT_SEND_STATUS_IDLE;
+        result = IOTHUB_CLIENT_OK;
+    }
     else
     {
         MQTTTRANSPORT_HANDLE_DATA* handleData = (MQTTTRANSPORT_HANDLE_DATA*)handle;
@@ -2653,6 +3867,9 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             if (*keepAliveOption != transport_data->keepAliveValue)
             {
                 transport_data->keepAliveValue = (uint16_t)(*keepAliveOption);
+                // an adaptive keepalive starts again from the new value
+                transport_data->keepAliveSafe = transport_data->keepAliveValue;
+                transport_data->keepAliveSettled = false;
                 if (transport_data->mqttClientStatus != MQTT_CLIENT_STATUS_NOT_CONNECTED)
                 {
                     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_038: [If the client is connected when the keepalive is set then IoTHubTransport_MQTT_Common_SetOption shall disconnect and reconnect with the specified keepalive value.] */
@@ -2661,6 +3878,192 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             }
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(OPTION_MQTT_KEEP_ALIVE_MAX, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_020: [ If the option parameter is set to "mqtt_keepalive_max" then the value shall be a int_ptr, 0 or up to 65535, the longest keepalive probed from "keepalive", and IoTHubTransport_MQTT_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG for any other value. ] */
+            int keepAliveMax = *((int*)value);
+            if ((keepAliveMax < 0) || (keepAliveMax > UINT16_MAX))
+            {
+                LogError("invalid mqtt_keepalive_max %d", keepAliveMax);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_data->keepAliveMax = (uint16_t)keepAliveMax;
+                transport_data->keepAliveSafe = transport_data->keepAliveValue;
+                transport_data->keepAliveSettled = false;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_MQTT_TELEMETRY_QOS, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_009: [ If the option parameter is set to "mqtt_telemetry_qos" then the value shall be a int_ptr of 0 or 1, the QoS of the messages with the default delivery, and IoTHubTransport_MQTT_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG for any other value. ] */
+            int qos = *((int*)value);
+            if ((qos != 0) && (qos != 1))
+            {
+                LogError("invalid mqtt_telemetry_qos %d", qos);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_data->telemetryAtMostOnce = (qos == 0);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_MQTT_MAX_INFLIGHT, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_006: [ If the option parameter is set to "mqtt_max_inflight" then the value shall be a size_t_ptr and the value will determine how many telemetry messages may wait for their PUBACK, 0 for no limit. ] */
+            transport_data->maxInflight = *((size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_MQTT_PACKING, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_065: [ If the option parameter is set to "mqtt_packing" then the value shall be an IOTHUB_MQTT_PACKING_OPTIONS* whose maxEnvelopeSize is the most bytes of an envelope of packed messages, 0 to publish the messages alone; IoTHubTransport_MQTT_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG for a maxEnvelopeSize that does not fit a length and a byte. ] */
+            const IOTHUB_MQTT_PACKING_OPTIONS* packing = (const IOTHUB_MQTT_PACKING_OPTIONS*)value;
+            if ((packing->maxEnvelopeSize != 0) && (packing->maxEnvelopeSize <= PACKED_LENGTH_PREFIX_SIZE))
+            {
+                LogError("invalid mqtt_packing maxEnvelopeSize %lu", (unsigned long)packing->maxEnvelopeSize);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_data->packing = *packing;
+                transport_data->isPackingLingering = false;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_MQTT_PERSISTENT_SESSION, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_016: [ If the option parameter is set to "mqtt_persistent_session" then the value shall be a bool_ptr and the value will determine if the subscriptions are trusted to the mqtt session kept by the service across reconnects. ] */
+            transport_data->persistentSession = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_MQTT_GATEWAY_BRIDGE, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_030: [ If the option parameter is set to "mqtt_gateway_bridge" then the value shall be a bool_ptr enabling the registration of leaf devices on the transport; IoTHubTransport_MQTT_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG if the transport does not connect to a protocol gateway, and IOTHUB_CLIENT_ERROR when disabling it while leaf devices are registered. ] */
+            bool isGatewayBridge = *((bool*)value);
+            if (isGatewayBridge && !transport_data->isProtocolGateway)
+            {
+                LogError("mqtt_gateway_bridge requires a protocolGatewayHostName");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else if (!isGatewayBridge && (transport_data->bridgedDevices.Flink != &transport_data->bridgedDevices))
+            {
+                LogError("mqtt_gateway_bridge cannot be disabled while leaf devices are registered");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                transport_data->isGatewayBridge = isGatewayBridge;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_MQTT_SLEEPY_DEVICE, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_040: [ If the option parameter is set to "mqtt_sleepy_device" then the value shall be an IOTHUB_MQTT_SLEEPY_DEVICE_OPTIONS* with a non-NULL sessionState, kept up to date by the transport, which then trusts the subscriptions of the session; IoTHubTransport_MQTT_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG for a NULL sessionState. ] */
+            const IOTHUB_MQTT_SLEEPY_DEVICE_OPTIONS* sleepyDevice = (const IOTHUB_MQTT_SLEEPY_DEVICE_OPTIONS*)value;
+            IOTHUB_MQTT_SESSION_STATE* sessionState = sleepyDevice->sessionState;
+            if (sessionState == NULL)
+            {
+                LogError("mqtt_sleepy_device requires a sessionState");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                if ((sessionState->version == IOTHUB_MQTT_SESSION_STATE_VERSION) && !transport_data->isFirstConnectionAttempted)
+                {
+                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_041: [ Before the first connection, a sessionState of the current version shall restore the subscriptions and the packet id of the previous session, any other sessionState shall be reset to an empty state of the current version. ] */
+                    transport_data->topics_Subscribed = sessionState->subscribedTopics;
+                    if (sessionState->packetId != 0)
+                    {
+                        transport_data->packetId = sessionState->packetId;
+                    }
+                }
+                else
+                {
+                    (void)memset(sessionState, 0, sizeof(IOTHUB_MQTT_SESSION_STATE));
+                    sessionState->version = IOTHUB_MQTT_SESSION_STATE_VERSION;
+                }
+                transport_data->sleepyDevice = *sleepyDevice;
+                transport_data->persistentSession = true;
+                transport_data->powerDownReported = false;
+                save_session_state(transport_data);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_RETRY_INITIAL_WAIT_TIME_IN_MS, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_026: [ If the option parameter is set to "retry_initial_wait_time_in_ms" then the value shall be an unsigned int greater than 0, the wait before the first connection retry, set on the retry control using retry_control_set_option and on each retry control created later, and IoTHubTransport_MQTT_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG for any other value. ] */
+            unsigned int initial_wait_time_in_ms = *((unsigned int*)value);
+            if (initial_wait_time_in_ms == 0)
+            {
+                LogError("invalid retry_initial_wait_time_in_ms value %u", initial_wait_time_in_ms);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else if (transport_data->retryControl != NULL &&
+                retry_control_set_option(transport_data->retryControl, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, &initial_wait_time_in_ms) != 0)
+            {
+                LogError("failure setting the initial wait time on the retry control");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                transport_data->retryInitialWaitTimeInMs = initial_wait_time_in_ms;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_KEEP_UNDERLYING_IO, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_018: [ If the option parameter is set to "keep_underlying_io" then the value shall be a bool_ptr and the value will determine if the underlying xio is kept across reconnects. ] */
+            transport_data->keepUnderlyingIO = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_WRITE_COALESCING, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_081: [ If the option parameter is set to "write_coalescing" then the value shall be a size_t*, the most bytes of the writes of a DoWork coalesced in one, 0 to write each packet alone, used from the next connection. ] */
+            transport_data->writeCoalescingSize = *((const size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_CONNECTION_HEALTH, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_084: [ If the option parameter is set to "connection_health" then the value shall be a const IOTHUB_CONNECTION_HEALTH_OPTIONS*, a minimumTimeoutInMs of 0 stopping the monitoring, a maximumTimeoutInMs less than minimumTimeoutInMs giving IOTHUB_CLIENT_INVALID_ARG, and any other value replacing the monitor with one created by connection_health_create, IOTHUB_CLIENT_ERROR if it fails. ] */
+            const IOTHUB_CONNECTION_HEALTH_OPTIONS* healthOptions = (const IOTHUB_CONNECTION_HEALTH_OPTIONS*)value;
+            CONNECTION_HEALTH_HANDLE connectionHealth;
+            if (healthOptions->minimumTimeoutInMs == 0)
+            {
+                if (transport_data->connectionHealth != NULL)
+                {
+                    connection_health_destroy(transport_data->connectionHealth);
+                    transport_data->connectionHealth = NULL;
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+            else if (healthOptions->maximumTimeoutInMs < healthOptions->minimumTimeoutInMs)
+            {
+                LogError("connection_health maximumTimeoutInMs %u is less than its minimumTimeoutInMs %u", healthOptions->maximumTimeoutInMs, healthOptions->minimumTimeoutInMs);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else if ((connectionHealth = connection_health_create(healthOptions)) == NULL)
+            {
+                LogError("unable to create the connection health monitor");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (transport_data->connectionHealth != NULL)
+                {
+                    connection_health_destroy(transport_data->connectionHealth);
+                }
+                transport_data->connectionHealth = connectionHealth;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_HAPPY_EYEBALLS, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_080: [ If the option parameter is set to "happy_eyeballs" then the value shall be saved as the HAPPY_EYEBALLS_HANDLE shared by the transports. ] */
+            transport_data->happyEyeballs = (HAPPY_EYEBALLS_HANDLE)value;
+            result = IOTHUB_CLIENT_OK;
+        }
         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_039: [If the option parameter is set to "x509certificate" then the value shall be a const char of the certificate to be used for x509.] */
         else if ((strcmp(OPTION_X509_CERT, option) == 0) && (cred_type != IOTHUB_CREDENTIAL_TYPE_X509 && cred_type != IOTHUB_CREDENTIAL_TYPE_UNKNOWN))
         {
@@ -2775,10 +4178,64 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
     return result;
 }
 
+static IOTHUB_DEVICE_HANDLE register_bridged_device(PMQTTTRANSPORT_HANDLE_DATA transport_data, const char* deviceId, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
+{
+    IOTHUB_DEVICE_HANDLE result;
+    size_t deviceIdSize = strlen(deviceId);
+    PDLIST_ENTRY currentListEntry = transport_data->bridgedDevices.Flink;
+    while ((currentListEntry != &transport_data->bridgedDevices) &&
+        (strcmp(STRING_c_str(containingRecord(currentListEntry, MQTT_BRIDGED_DEVICE, entry)->device_id), deviceId) != 0))
+    {
+        currentListEntry = currentListEntry->Flink;
+    }
+
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_031: [ While mqtt_gateway_bridge is enabled, IoTHubTransport_MQTT_Common_Register shall register a device other than the one of the transport as a bridged device, and return NULL if its deviceId is empty, longer than 128 characters or already registered. ] */
+    if ((deviceIdSize == 0) || (deviceIdSize > 128U))
+    {
+        LogError("IoTHubTransport_MQTT_Common_Register: invalid length of the leaf deviceId.");
+        result = NULL;
+    }
+    else if (currentListEntry != &transport_data->bridgedDevices)
+    {
+        LogError("Transport already has leaf device registered by id: [%s]", deviceId);
+        result = NULL;
+    }
+    else
+    {
+        MQTT_BRIDGED_DEVICE* bridged_device = (MQTT_BRIDGED_DEVICE*)malloc(sizeof(MQTT_BRIDGED_DEVICE));
+        if (bridged_device == NULL)
+        {
+            LogError("Could not allocate the leaf device.");
+            result = NULL;
+        }
+        else
+        {
+            memset(bridged_device, 0, sizeof(MQTT_BRIDGED_DEVICE));
+            if ((bridged_device->device_id = STRING_construct(deviceId)) == NULL)
+            {
+                LogError("failure constructing the leaf device_id.");
+                free(bridged_device);
+                result = NULL;
+            }
+            else
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_032: [ IoTHubTransport_MQTT_Common_Register shall return the bridged device as the IOTHUB_DEVICE_HANDLE. ] */
+                bridged_device->kind = MQTT_DEVICE_HANDLE_BRIDGED;
+                bridged_device->transport_data = transport_data;
+                bridged_device->telemetryTopicTemplate = NULL;
+                bridged_device->waitingToSend = waitingToSend;
+                bridged_device->llClientHandle = iotHubClientHandle;
+                DList_InsertTailList(&transport_data->bridgedDevices, &bridged_device->entry);
+                result = (IOTHUB_DEVICE_HANDLE)bridged_device;
+            }
+        }
+    }
+    return result;
+}
+
 IOTHUB_DEVICE_HANDLE IoTHubTransport_MQTT_Common_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
 {
     IOTHUB_DEVICE_HANDLE result = NULL;
-    (void)iotHubClientHandle;
 
     // Codes_SRS_IOTHUB_MQTT_TRANSPORT_17_001: [ IoTHubTransport_MQTT_Common_Register shall return NULL if the TRANSPORT_LL_HANDLE is NULL.]
     // Codes_SRS_IOTHUB_MQTT_TRANSPORT_17_002: [ IoTHubTransport_MQTT_Common_Register shall return NULL if device or waitingToSend are NULL.]
@@ -2805,8 +4262,13 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_MQTT_Common_Register(TRANSPORT_LL_HANDLE ha
         }
         else
         {
+            bool isTransportDevice = (strcmp(STRING_c_str(transport_data->device_id), device->deviceId) == 0);
+            if (!isTransportDevice && transport_data->isGatewayBridge)
+            {
+                result = register_bridged_device(transport_data, device->deviceId, iotHubClientHandle, waitingToSend);
+            }
             // Codes_SRS_IOTHUB_MQTT_TRANSPORT_17_003: [ IoTHubTransport_MQTT_Common_Register shall return NULL if deviceId or deviceKey do not match the deviceId and deviceKey passed in during IoTHubTransport_MQTT_Common_Create.]
-            if (strcmp(STRING_c_str(transport_data->device_id), device->deviceId) != 0)
+            else if (!isTransportDevice)
             {
                 LogError("IoTHubTransport_MQTT_Common_Register: deviceId does not match.");
                 result = NULL;
@@ -2842,9 +4304,33 @@ void IoTHubTransport_MQTT_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
     // Codes_SRS_IOTHUB_MQTT_TRANSPORT_17_005: [ If deviceHandle is NULL `IoTHubTransport_MQTT_Common_Unregister` shall do nothing. ]
     if (deviceHandle != NULL)
     {
-        MQTTTRANSPORT_HANDLE_DATA* transport_data = (MQTTTRANSPORT_HANDLE_DATA*)deviceHandle;
+        MQTT_BRIDGED_DEVICE* bridged_device = get_bridged_device(deviceHandle);
+        if (bridged_device != NULL)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_039: [ IoTHubTransport_MQTT_Common_Unregister shall complete the messages of a bridged device waiting for a PUBACK with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, then remove and free the bridged device. ] */
+            MQTTTRANSPORT_HANDLE_DATA* transport_data = bridged_device->transport_data;
+            PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
+            while (currentListEntry != &transport_data->telemetry_waitingForAck)
+            {
+                MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
+                currentListEntry = currentListEntry->Flink;
+                if (mqttMsgEntry->bridgedDevice == bridged_device)
+                {
+                    (void)DList_RemoveEntryList(&mqttMsgEntry->entry);
+                    packet_id_table_remove(&transport_data->telemetryByPacketId, mqttMsgEntry->packet_id, mqttMsgEntry);
+                    transport_data->inflightCount--;
+                    complete_mqtt_message(transport_data, mqttMsgEntry, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+                }
+            }
+            (void)DList_RemoveEntryList(&bridged_device->entry);
+            destroy_bridged_device(bridged_device);
+        }
+        else
+        {
+            MQTTTRANSPORT_HANDLE_DATA* transport_data = (MQTTTRANSPORT_HANDLE_DATA*)deviceHandle;
 
-        transport_data->isRegistered = false;
+            transport_data->isRegistered = false;
+        }
     }
 }
 
@@ -54,7 +54,7 @@ static TRANSPORT_LL_HANDLE IoTHubTransportAMQP_Create(const IOTHUBTRANSPORT_CONF
     return IoTHubTransport_AMQP_Common_Create(config, getTLSIOTransport);
 }
 
-static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportAMQP_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportAMQP_ProcessItem(IOTHUB_DEVICE_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
 {
     // Codes_SRS_IOTHUBTRANSPORTAMQP_09_014: [IoTHubTransportAMQP_ProcessItem shall invoke IoTHubTransport_AMQP_Common_ProcessItem() and return its result.]
     return IoTHubTransport_AMQP_Common_ProcessItem(handle, item_type, iothub_item);
@@ -113,6 +113,12 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_GetSendStatus(IOTHUB_DEVICE_HAND
     return IoTHubTransport_AMQP_Common_GetSendStatus(handle, iotHubClientStatus);
 }
 
+static size_t IoTHubTransportAMQP_GetPollDescriptors(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_POLL_DESCRIPTOR* descriptors, size_t descriptorCount)
+{
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_41_001: [IoTHubTransportAMQP_GetPollDescriptors shall get the sockets by calling into the IoTHubTransport_AMQP_Common_GetPollDescriptors()]
+    return IoTHubTransport_AMQP_Common_GetPollDescriptors(handle, descriptors, descriptorCount);
+}
+
 static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     // Codes_SRS_IOTHUBTRANSPORTAMQP_09_017: [IoTHubTransportAMQP_SetOption shall set the options by calling into the IoTHubTransport_AMQP_Common_SetOption()]
@@ -174,7 +180,10 @@ static TRANSPORT_PROVIDER thisTransportProvider =
     IoTHubTransportAMQP_Unsubscribe,                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
     IoTHubTransportAMQP_DoWork,                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
     IoTHubTransportAMQP_SetRetryPolicy,             /*pfIoTHubTransport_DoWork IoTHubTransport_SetRetryPolicy;*/
-    IoTHubTransportAMQP_GetSendStatus               /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportAMQP_GetSendStatus,              /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    NULL,                                           /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline; uAMQP keeps its timers to itself*/
+    IoTHubTransportAMQP_GetPollDescriptors,         /*pfIoTHubTransport_GetPollDescriptors IoTHubTransport_GetPollDescriptors;*/
+    NULL                                            /*pfIoTHubTransport_TrimMemory IoTHubTransport_TrimMemory; the frame buffers are uAMQP's*/
 };
 
 /* Codes_SRS_IOTHUBTRANSPORTAMQP_09_019: [This function shall return a pointer to a structure of type TRANSPORT_PROVIDER having the following values for it's fields:
@@ -8,12 +8,16 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_uamqp_c/link.h"
 #include "azure_uamqp_c/messaging.h"
 #include "azure_uamqp_c/message_receiver.h"
 #include "azure_uamqp_c/message_sender.h"
 #include "iothubtransportamqp_methods.h"
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP
+#include "iothub_client_memory_tag.h"
+
 typedef enum SUBSCRIBE_STATE_TAG
 {
     SUBSCRIBE_STATE_NOT_SUBSCRIBED,
@@ -35,8 +39,7 @@ typedef struct IOTHUBTRANSPORT_AMQP_METHODS_TAG
     ON_METHODS_UNSUBSCRIBED on_methods_unsubscribed;
     void* on_methods_unsubscribed_context;
     SUBSCRIBE_STATE subscribe_state;
-    IOTHUBTRANSPORT_AMQP_METHOD_HANDLE* method_request_handles;
-    size_t method_request_handle_count;
+    DLIST_ENTRY method_request_handles;
     bool receiver_link_disconnected;
     bool sender_link_disconnected;
 } IOTHUBTRANSPORT_AMQP_METHODS;
@@ -52,42 +55,9 @@ typedef struct IOTHUBTRANSPORT_AMQP_METHOD_TAG
 {
     IOTHUBTRANSPORT_AMQP_METHODS_HANDLE iothubtransport_amqp_methods_handle;
     uuid correlation_id;
+    DLIST_ENTRY entry;
 } IOTHUBTRANSPORT_AMQP_METHOD;
 
-static void remove_tracked_handle(IOTHUBTRANSPORT_AMQP_METHODS* amqp_methods_handle, IOTHUBTRANSPORT_AMQP_METHOD_HANDLE method_request_handle)
-{
-    size_t i;
-
-    for (i = 0; i < amqp_methods_handle->method_request_handle_count; i++)
-    {
-        if (amqp_methods_handle->method_request_handles[i] == method_request_handle)
-        {
-            if (amqp_methods_handle->method_request_handle_count - i > 1)
-            {
-                (void)memmove(&amqp_methods_handle->method_request_handles[i], &amqp_methods_handle->method_request_handles[i + 1],
-                    (amqp_methods_handle->method_request_handle_count - i - 1) * sizeof(IOTHUBTRANSPORT_AMQP_METHOD_HANDLE));
-            }
-
-            amqp_methods_handle->method_request_handle_count--;
-            i--;
-        }
-    }
-
-    if (amqp_methods_handle->method_request_handle_count == 0)
-    {
-        free(amqp_methods_handle->method_request_handles);
-        amqp_methods_handle->method_request_handles = NULL;
-    }
-    else
-    {
-        IOTHUBTRANSPORT_AMQP_METHOD_HANDLE* new_handles = (IOTHUBTRANSPORT_AMQP_METHOD_HANDLE*)realloc(amqp_methods_handle->method_request_handles, amqp_methods_handle->method_request_handle_count * sizeof(IOTHUBTRANSPORT_AMQP_METHOD_HANDLE));
-        if (new_handles != NULL)
-        {
-            amqp_methods_handle->method_request_handles = new_handles;
-        }
-    }
-}
-
 IOTHUBTRANSPORT_AMQP_METHODS_HANDLE iothubtransportamqp_methods_create(const char* hostname, const char* device_id)
 {
     IOTHUBTRANSPORT_AMQP_METHODS* result;
@@ -133,8 +103,7 @@ IOTHUBTRANSPORT_AMQP_METHODS_HANDLE iothubtransportamqp_methods_create(const cha
                 else
                 {
                     result->subscribe_state = SUBSCRIBE_STATE_NOT_SUBSCRIBED;
-                    result->method_request_handles = NULL;
-                    result->method_request_handle_count = 0;
+                    DList_InitializeListHead(&result->method_request_handles);
                     result->receiver_link_disconnected = false;
                     result->sender_link_disconnected = false;
                 }
@@ -154,7 +123,7 @@ void iothubtransportamqp_methods_destroy(IOTHUBTRANSPORT_AMQP_METHODS_HANDLE iot
     }
     else
     {
-        size_t i;
+        PDLIST_ENTRY method_request_entry;
 
         /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_007: [ If the instance pointed to by `iothubtransport_amqp_methods_handle` is subscribed to receive C2D methods, `iothubtransportamqp_methods_destroy` shall free all resources allocated by the subscribe. ]*/
         if (iothubtransport_amqp_methods_handle->subscribe_state == SUBSCRIBE_STATE_SUBSCRIBED)
@@ -162,14 +131,10 @@ void iothubtransportamqp_methods_destroy(IOTHUBTRANSPORT_AMQP_METHODS_HANDLE iot
             iothubtransportamqp_methods_unsubscribe(iothubtransport_amqp_methods_handle);
         }
 
-        for (i = 0; i < iothubtransport_amqp_methods_handle->method_request_handle_count; i++)
-        {
-            free(iothubtransport_amqp_methods_handle->method_request_handles[i]);
-        }
-
-        if (iothubtransport_amqp_methods_handle->method_request_handles != NULL)
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_110: [ `iothubtransportamqp_methods_destroy` shall free all tracked method handles indicated to the user via the callback `on_method_request_received` and than have not yet been completed by calls to `iothubtransportamqp_methods_respond`. ]*/
+        while ((method_request_entry = DList_RemoveHeadList(&iothubtransport_amqp_methods_handle->method_request_handles)) != &iothubtransport_amqp_methods_handle->method_request_handles)
         {
-            free(iothubtransport_amqp_methods_handle->method_request_handles);
+            free(containingRecord(method_request_entry, IOTHUBTRANSPORT_AMQP_METHOD, entry));
         }
 
         /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_005: [ `iothubtransportamqp_methods_destroy` shall free all resources allocated by `iothubtransportamqp_methods_create` for the handle `iothubtransport_amqp_methods_handle`. ]*/
@@ -293,154 +258,138 @@ static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE messag
                 }
                 else
                 {
-                    IOTHUBTRANSPORT_AMQP_METHOD_HANDLE* new_handles;
-                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_113: [ All `IOTHUBTRANSPORT_AMQP_METHOD_HANDLE` handles shall be tracked in an array of handles that shall be resized accordingly when a methopd handle is added to it. ]*/
-                    new_handles = (IOTHUBTRANSPORT_AMQP_METHOD_HANDLE*)realloc(amqp_methods_handle->method_request_handles, (amqp_methods_handle->method_request_handle_count + 1) * sizeof(IOTHUBTRANSPORT_AMQP_METHOD_HANDLE));
-                    if (new_handles == NULL)
+                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_121: [ The uuid value for the correlation ID shall be obtained by calling `amqpvalue_get_uuid`. ]*/
+                    if (amqpvalue_get_uuid(correlation_id, &method_handle->correlation_id) != 0)
                     {
-                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_138: [ If resizing the tracked method handles array fails, the RELEASED outcome shall be returned and an error shall be indicated. ]*/
+                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_122: [ If `amqpvalue_get_uuid` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
                         free(method_handle);
-                        LogError("Cannot grow method handles array");
-                        message_outcome = MESSAGE_OUTCOME_RELEASED;
+                        LogError("Cannot get uuid value for correlation-id");
+                        message_outcome = MESSAGE_OUTCOME_REJECTED;
+                        result = messaging_delivery_rejected("amqp:decode-error", "Cannot get uuid value for correlation-id");
                     }
                     else
                     {
-                        amqp_methods_handle->method_request_handles = new_handles;
+                        BINARY_DATA binary_data;
 
-                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_121: [ The uuid value for the correlation ID shall be obtained by calling `amqpvalue_get_uuid`. ]*/
-                        if (amqpvalue_get_uuid(correlation_id, &method_handle->correlation_id) != 0)
+                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_048: [ - The message payload shall be obtained by calling `message_get_body_amqp_data_in_place` with the index argument being 0. ]*/
+                        if (message_get_body_amqp_data_in_place(message, 0, &binary_data) != 0)
                         {
-                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_122: [ If `amqpvalue_get_uuid` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
+                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_049: [ If `message_get_body_amqp_data_in_place` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
                             free(method_handle);
-                            LogError("Cannot get uuid value for correlation-id");
+                            LogError("Cannot get method request message payload");
                             message_outcome = MESSAGE_OUTCOME_REJECTED;
-                            result = messaging_delivery_rejected("amqp:decode-error", "Cannot get uuid value for correlation-id");
+                            result = messaging_delivery_rejected("amqp:decode-error", "Cannot get method request message payload");
                         }
                         else
                         {
-                            BINARY_DATA binary_data;
+                            AMQP_VALUE application_properties;
 
-                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_048: [ - The message payload shall be obtained by calling `message_get_body_amqp_data_in_place` with the index argument being 0. ]*/
-                            if (message_get_body_amqp_data_in_place(message, 0, &binary_data) != 0)
+                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_099: [ The application properties for the received message shall be obtained by calling `message_get_application_properties`. ]*/
+                            if (message_get_application_properties(message, &application_properties) != 0)
                             {
-                                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_049: [ If `message_get_body_amqp_data_in_place` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
+                                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_133: [ If `message_get_application_properties` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
+                                LogError("Cannot get application properties");
                                 free(method_handle);
-                                LogError("Cannot get method request message payload");
                                 message_outcome = MESSAGE_OUTCOME_REJECTED;
-                                result = messaging_delivery_rejected("amqp:decode-error", "Cannot get method request message payload");
+                                result = messaging_delivery_rejected("amqp:decode-error", "Cannot get application properties");
                             }
                             else
                             {
-                                AMQP_VALUE application_properties;
-
-                                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_099: [ The application properties for the received message shall be obtained by calling `message_get_application_properties`. ]*/
-                                if (message_get_application_properties(message, &application_properties) != 0)
+                                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_123: [ The AMQP map shall be retrieve from the application properties by calling `amqpvalue_get_inplace_described_value`. ]*/
+                                AMQP_VALUE amqp_properties_map = amqpvalue_get_inplace_described_value(application_properties);
+                                if (amqp_properties_map == NULL)
                                 {
-                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_133: [ If `message_get_application_properties` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
-                                    LogError("Cannot get application properties");
+                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_134: [ If `amqpvalue_get_inplace_described_value` fails the RELEASED outcome with `amqp:decode-error` shall be returned. ]*/
+                                    LogError("Cannot get application properties map");
                                     free(method_handle);
-                                    message_outcome = MESSAGE_OUTCOME_REJECTED;
-                                    result = messaging_delivery_rejected("amqp:decode-error", "Cannot get application properties");
+                                    message_outcome = MESSAGE_OUTCOME_RELEASED;
                                 }
                                 else
                                 {
-                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_123: [ The AMQP map shall be retrieve from the application properties by calling `amqpvalue_get_inplace_described_value`. ]*/
-                                    AMQP_VALUE amqp_properties_map = amqpvalue_get_inplace_described_value(application_properties);
-                                    if (amqp_properties_map == NULL)
+                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_100: [ A property key `IoThub-methodname` shall be created by calling `amqpvalue_create_string`. ]*/
+                                    AMQP_VALUE property_key = amqpvalue_create_string("IoThub-methodname");
+                                    if (property_key == NULL)
                                     {
-                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_134: [ If `amqpvalue_get_inplace_described_value` fails the RELEASED outcome with `amqp:decode-error` shall be returned. ]*/
-                                        LogError("Cannot get application properties map");
+                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_132: [ If `amqpvalue_create_string` fails the RELEASED outcome shall be returned. ]*/
+                                        LogError("Cannot create the property key for method name");
                                         free(method_handle);
                                         message_outcome = MESSAGE_OUTCOME_RELEASED;
                                     }
                                     else
                                     {
-                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_100: [ A property key `IoThub-methodname` shall be created by calling `amqpvalue_create_string`. ]*/
-                                        AMQP_VALUE property_key = amqpvalue_create_string("IoThub-methodname");
-                                        if (property_key == NULL)
+                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_101: [ The method name property value shall be found in the map by calling `amqpvalue_get_map_value`. ]*/
+                                        AMQP_VALUE property_value = amqpvalue_get_map_value(amqp_properties_map, property_key);
+                                        if (property_value == NULL)
                                         {
-                                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_132: [ If `amqpvalue_create_string` fails the RELEASED outcome shall be returned. ]*/
-                                            LogError("Cannot create the property key for method name");
+                                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_103: [ If `amqpvalue_get_map_value` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
+                                            LogError("Cannot find the IoThub-methodname property in the properties map");
                                             free(method_handle);
-                                            message_outcome = MESSAGE_OUTCOME_RELEASED;
+                                            message_outcome = MESSAGE_OUTCOME_REJECTED;
+                                            result = messaging_delivery_rejected("amqp:decode-error", "Cannot find the IoThub-methodname property in the properties map");
                                         }
                                         else
                                         {
-                                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_101: [ The method name property value shall be found in the map by calling `amqpvalue_get_map_value`. ]*/
-                                            AMQP_VALUE property_value = amqpvalue_get_map_value(amqp_properties_map, property_key);
-                                            if (property_value == NULL)
+                                            const char* method_name;
+
+                                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_102: [ The string contained by the property value shall be obtained by calling `amqpvalue_get_string`. ]*/
+                                            if (amqpvalue_get_string(property_value, &method_name) != 0)
                                             {
-                                                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_103: [ If `amqpvalue_get_map_value` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
-                                                LogError("Cannot find the IoThub-methodname property in the properties map");
+                                                /*Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_131: [ If `amqpvalue_get_string` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
+                                                LogError("Cannot read the method name from the property value");
                                                 free(method_handle);
                                                 message_outcome = MESSAGE_OUTCOME_REJECTED;
-                                                result = messaging_delivery_rejected("amqp:decode-error", "Cannot find the IoThub-methodname property in the properties map");
+                                                result = messaging_delivery_rejected("amqp:decode-error", "Cannot read the method name from the property value");
                                             }
                                             else
                                             {
-                                                const char* method_name;
-
-                                                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_102: [ The string contained by the property value shall be obtained by calling `amqpvalue_get_string`. ]*/
-                                                if (amqpvalue_get_string(property_value, &method_name) != 0)
+                                                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_056: [ On success the `on_message_received` callback shall return a newly constructed delivery state obtained by calling `messaging_delivery_accepted`. ]*/
+                                                result = messaging_delivery_accepted();
+                                                if (result == NULL)
                                                 {
-                                                    /*Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_131: [ If `amqpvalue_get_string` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
-                                                    LogError("Cannot read the method name from the property value");
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_057: [ If `messaging_delivery_accepted` fails the RELEASED outcome with `amqp:decode-error` shall be returned. ]*/
+                                                    LogError("Cannot allocate memory for delivery state");
                                                     free(method_handle);
-                                                    message_outcome = MESSAGE_OUTCOME_REJECTED;
-                                                    result = messaging_delivery_rejected("amqp:decode-error", "Cannot read the method name from the property value");
+                                                    message_outcome = MESSAGE_OUTCOME_RELEASED;
                                                 }
                                                 else
                                                 {
-                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_056: [ On success the `on_message_received` callback shall return a newly constructed delivery state obtained by calling `messaging_delivery_accepted`. ]*/
-                                                    result = messaging_delivery_accepted();
-                                                    if (result == NULL)
+                                                    method_handle->iothubtransport_amqp_methods_handle = amqp_methods_handle;
+
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_113: [ All `IOTHUBTRANSPORT_AMQP_METHOD_HANDLE` handles shall be tracked in a list of handles, so that a handle can be added or removed without searching or resizing. ]*/
+                                                    DList_InsertTailList(&amqp_methods_handle->method_request_handles, &method_handle->entry);
+
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_050: [ The binary message payload shall be indicated by calling the `on_method_request_received` callback passed to `iothubtransportamqp_methods_subscribe` with the arguments: ]*/
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_051: [ - `context` shall be set to the `on_method_request_received_context` argument passed to `iothubtransportamqp_methods_subscribe`. ]*/
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_098: [ - `method_name` shall be set to the application property value for `IoThub-methodname`. ]*/
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_052: [ - `request` shall be set to the payload bytes obtained by calling `message_get_body_amqp_data_in_place`. ]*/
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_053: [ - `request_size` shall be set to the payload size obtained by calling `message_get_body_amqp_data_in_place`. ]*/
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_054: [ - `method_handle` shall be set to a newly created `IOTHUBTRANSPORT_AMQP_METHOD_HANDLE` that can be passed later as an argument to `iothubtransportamqp_methods_respond`. ]*/
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_109: [ `iothubtransportamqp_methods_respond` shall be allowed to be called from the callback `on_method_request_received`. ]*/
+                                                    if (amqp_methods_handle->on_method_request_received(amqp_methods_handle->on_method_request_received_context, method_name, binary_data.bytes, binary_data.length, method_handle) != 0)
                                                     {
-                                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_057: [ If `messaging_delivery_accepted` fails the RELEASED outcome with `amqp:decode-error` shall be returned. ]*/
-                                                        LogError("Cannot allocate memory for delivery state");
+                                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_147: [ If `on_method_request_received` fails, the REJECTED outcome shall be returned with `amqp:internal-error`. ]*/
+                                                        LogError("Cannot execute the callback with the given data");
+                                                        amqpvalue_destroy(result);
+                                                        (void)DList_RemoveEntryList(&method_handle->entry);
                                                         free(method_handle);
-                                                        message_outcome = MESSAGE_OUTCOME_RELEASED;
+                                                        message_outcome = MESSAGE_OUTCOME_REJECTED;
+                                                        result = messaging_delivery_rejected("amqp:internal-error", "Cannot execute the callback with the given data");
                                                     }
                                                     else
                                                     {
-                                                        method_handle->iothubtransport_amqp_methods_handle = amqp_methods_handle;
-
-                                                        /* set the method request handle in the handle array */
-                                                        amqp_methods_handle->method_request_handles[amqp_methods_handle->method_request_handle_count] = method_handle;
-                                                        amqp_methods_handle->method_request_handle_count++;
-
-                                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_050: [ The binary message payload shall be indicated by calling the `on_method_request_received` callback passed to `iothubtransportamqp_methods_subscribe` with the arguments: ]*/
-                                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_051: [ - `context` shall be set to the `on_method_request_received_context` argument passed to `iothubtransportamqp_methods_subscribe`. ]*/
-                                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_098: [ - `method_name` shall be set to the application property value for `IoThub-methodname`. ]*/
-                                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_052: [ - `request` shall be set to the payload bytes obtained by calling `message_get_body_amqp_data_in_place`. ]*/
-                                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_053: [ - `request_size` shall be set to the payload size obtained by calling `message_get_body_amqp_data_in_place`. ]*/
-                                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_054: [ - `method_handle` shall be set to a newly created `IOTHUBTRANSPORT_AMQP_METHOD_HANDLE` that can be passed later as an argument to `iothubtransportamqp_methods_respond`. ]*/
-                                                        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_109: [ `iothubtransportamqp_methods_respond` shall be allowed to be called from the callback `on_method_request_received`. ]*/
-                                                        if (amqp_methods_handle->on_method_request_received(amqp_methods_handle->on_method_request_received_context, method_name, binary_data.bytes, binary_data.length, method_handle) != 0)
-                                                        {
-                                                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_147: [ If `on_method_request_received` fails, the REJECTED outcome shall be returned with `amqp:internal-error`. ]*/
-                                                            LogError("Cannot execute the callback with the given data");
-                                                            amqpvalue_destroy(result);
-                                                            free(method_handle);
-                                                            amqp_methods_handle->method_request_handle_count--;
-                                                            message_outcome = MESSAGE_OUTCOME_REJECTED;
-                                                            result = messaging_delivery_rejected("amqp:internal-error", "Cannot execute the callback with the given data");
-                                                        }
-                                                        else
-                                                        {
-                                                            message_outcome = MESSAGE_OUTCOME_ACCEPTED;
-                                                        }
+                                                        message_outcome = MESSAGE_OUTCOME_ACCEPTED;
                                                     }
                                                 }
-
-                                                amqpvalue_destroy(property_value);
                                             }
 
-                                            amqpvalue_destroy(property_key);
+                                            amqpvalue_destroy(property_value);
                                         }
-                                    }
 
-                                    application_properties_destroy(application_properties);
+                                        amqpvalue_destroy(property_key);
+                                    }
                                 }
+
+                                application_properties_destroy(application_properties);
                             }
                         }
                     }
@@ -971,8 +920,8 @@ int iothubtransportamqp_methods_respond(IOTHUBTRANSPORT_AMQP_METHOD_HANDLE metho
                                                 }
                                                 else
                                                 {
-                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_114: [ The handle `method_handle` shall be removed from the array used to track the method handles. ]*/
-                                                    remove_tracked_handle(method_handle->iothubtransport_amqp_methods_handle, method_handle);
+                                                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_114: [ The handle `method_handle` shall be removed from the list used to track the method handles. ]*/
+                                                    (void)DList_RemoveEntryList(&method_handle->entry);
 
                                                     /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_111: [ The handle `method_handle` shall be freed (have no meaning) after `iothubtransportamqp_methods_respond` has been executed. ]*/
                                                     free(method_handle);
@@ -0,0 +1,895 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/messaging.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "iothubtransportamqp_twin.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP
+#include "iothub_client_memory_tag.h"
+
+#define TWIN_API_VERSION                    "2016-11-14"
+#define TWIN_ANNOTATION_OPERATION           "operation"
+#define TWIN_ANNOTATION_RESOURCE            "resource"
+#define TWIN_ANNOTATION_STATUS              "status"
+#define TWIN_RESOURCE_REPORTED              "/properties/reported"
+#define TWIN_RESOURCE_DESIRED_NOTIFICATIONS "/notifications/twin/properties/desired"
+#define TWIN_STATUS_CODE_OK_MIN             200
+#define TWIN_STATUS_CODE_OK_MAX             299
+#define TWIN_STATUS_CODE_SERVER_ERROR       500
+/* "twin-" followed by the decimal digits of an unsigned long */
+#define TWIN_CORRELATION_ID_SIZE            32
+
+typedef enum SUBSCRIBE_STATE_TAG
+{
+    SUBSCRIBE_STATE_NOT_SUBSCRIBED,
+    SUBSCRIBE_STATE_SUBSCRIBED
+} SUBSCRIBE_STATE;
+
+typedef enum TWIN_OPERATION_TAG
+{
+    TWIN_OPERATION_GET,
+    TWIN_OPERATION_PATCH,
+    TWIN_OPERATION_PUT
+} TWIN_OPERATION;
+
+typedef struct TWIN_REQUEST_TAG
+{
+    TWIN_OPERATION operation;
+    uint32_t item_id;
+    CONSTBUFFER_HANDLE reported_state;
+    char correlation_id[TWIN_CORRELATION_ID_SIZE];
+    bool sent;
+    DLIST_ENTRY entry;
+} TWIN_REQUEST;
+
+typedef struct IOTHUBTRANSPORT_AMQP_TWIN_TAG
+{
+    char* device_id;
+    char* hostname;
+    LINK_HANDLE receiver_link;
+    LINK_HANDLE sender_link;
+    MESSAGE_RECEIVER_HANDLE message_receiver;
+    MESSAGE_SENDER_HANDLE message_sender;
+    ON_TWIN_ERROR on_twin_error;
+    ON_TWIN_DOCUMENT_RECEIVED on_document_received;
+    ON_TWIN_REPORTED_STATE_COMPLETE on_reported_state_complete;
+    void* context;
+    SUBSCRIBE_STATE subscribe_state;
+    bool sender_open;
+    unsigned long next_correlation_id;
+    /* In the order they were made; the ones sent wait here for their response. */
+    DLIST_ENTRY requests;
+} IOTHUBTRANSPORT_AMQP_TWIN;
+
+static void destroy_request(TWIN_REQUEST* request)
+{
+    if (request->reported_state != NULL)
+    {
+        CONSTBUFFER_Destroy(request->reported_state);
+    }
+    free(request);
+}
+
+static TWIN_REQUEST* create_request(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle, TWIN_OPERATION operation)
+{
+    TWIN_REQUEST* result = (TWIN_REQUEST*)malloc(sizeof(TWIN_REQUEST));
+    if (result == NULL)
+    {
+        LogError("Cannot allocate memory for the twin request");
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_009: [ Every request shall carry a string correlation id unique for the handle. ]*/
+        (void)sprintf(result->correlation_id, "twin-%lu", twin_handle->next_correlation_id++);
+        result->operation = operation;
+        result->item_id = 0;
+        result->reported_state = NULL;
+        result->sent = false;
+    }
+
+    return result;
+}
+
+static int add_annotation(AMQP_VALUE annotations_map, const char* name, const char* value)
+{
+    int result;
+    AMQP_VALUE key = amqpvalue_create_symbol(name);
+    if (key == NULL)
+    {
+        LogError("Cannot create the key of the '%s' annotation", name);
+        result = __FAILURE__;
+    }
+    else
+    {
+        AMQP_VALUE amqp_value = amqpvalue_create_string(value);
+        if (amqp_value == NULL)
+        {
+            LogError("Cannot create the value of the '%s' annotation", name);
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (amqpvalue_set_map_value(annotations_map, key, amqp_value) != 0)
+            {
+                LogError("Cannot set the '%s' annotation", name);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+
+            amqpvalue_destroy(amqp_value);
+        }
+
+        amqpvalue_destroy(key);
+    }
+
+    return result;
+}
+
+static int set_request_annotations(MESSAGE_HANDLE message, TWIN_OPERATION operation)
+{
+    int result;
+    AMQP_VALUE annotations_map = amqpvalue_create_map();
+    if (annotations_map == NULL)
+    {
+        LogError("Cannot create the map of the message annotations");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_010: [ The GET of the twin document shall carry the message annotation `operation` set to `GET`. ]*/
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_011: [ The subscription to the desired properties shall carry the message annotations `operation` set to `PUT` and `resource` set to `/notifications/twin/properties/desired`. ]*/
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_012: [ A reported state shall carry the message annotations `operation` set to `PATCH` and `resource` set to `/properties/reported`, and the reported state as its body. ]*/
+        if (((operation == TWIN_OPERATION_GET) && (add_annotation(annotations_map, TWIN_ANNOTATION_OPERATION, "GET") != 0)) ||
+            ((operation == TWIN_OPERATION_PUT) && ((add_annotation(annotations_map, TWIN_ANNOTATION_OPERATION, "PUT") != 0) || (add_annotation(annotations_map, TWIN_ANNOTATION_RESOURCE, TWIN_RESOURCE_DESIRED_NOTIFICATIONS) != 0))) ||
+            ((operation == TWIN_OPERATION_PATCH) && ((add_annotation(annotations_map, TWIN_ANNOTATION_OPERATION, "PATCH") != 0) || (add_annotation(annotations_map, TWIN_ANNOTATION_RESOURCE, TWIN_RESOURCE_REPORTED) != 0))))
+        {
+            result = __FAILURE__;
+        }
+        else if (message_set_message_annotations(message, annotations_map) != 0)
+        {
+            LogError("Cannot set the message annotations");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+
+        amqpvalue_destroy(annotations_map);
+    }
+
+    return result;
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle = (IOTHUBTRANSPORT_AMQP_TWIN_HANDLE)context;
+
+    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_013: [ If sending a request fails while subscribed, `on_twin_error` shall be called. ]*/
+    if ((send_result == MESSAGE_SEND_ERROR) &&
+        (twin_handle->subscribe_state == SUBSCRIBE_STATE_SUBSCRIBED))
+    {
+        twin_handle->on_twin_error(twin_handle->context);
+    }
+}
+
+static int send_request(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle, TWIN_REQUEST* request)
+{
+    int result;
+    MESSAGE_HANDLE message = message_create();
+    if (message == NULL)
+    {
+        LogError("Cannot create the twin request message");
+        result = __FAILURE__;
+    }
+    else
+    {
+        PROPERTIES_HANDLE properties = properties_create();
+        if (properties == NULL)
+        {
+            LogError("Cannot create the twin request properties");
+            result = __FAILURE__;
+        }
+        else
+        {
+            AMQP_VALUE correlation_id = amqpvalue_create_string(request->correlation_id);
+            if (correlation_id == NULL)
+            {
+                LogError("Cannot create the correlation id value");
+                result = __FAILURE__;
+            }
+            else
+            {
+                if (properties_set_correlation_id(properties, correlation_id) != 0)
+                {
+                    LogError("Cannot set the correlation id on the properties");
+                    result = __FAILURE__;
+                }
+                else if (message_set_properties(message, properties) != 0)
+                {
+                    LogError("Cannot set the properties on the twin request message");
+                    result = __FAILURE__;
+                }
+                else if (set_request_annotations(message, request->operation) != 0)
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    BINARY_DATA binary_data;
+
+                    if (request->reported_state != NULL)
+                    {
+                        const CONSTBUFFER* content = CONSTBUFFER_GetContent(request->reported_state);
+                        binary_data.bytes = content->buffer;
+                        binary_data.length = content->size;
+                    }
+                    else
+                    {
+                        binary_data.bytes = NULL;
+                        binary_data.length = 0;
+                    }
+
+                    if ((binary_data.length > 0) &&
+                        (message_add_body_amqp_data(message, binary_data) != 0))
+                    {
+                        LogError("Cannot set the body of the twin request message");
+                        result = __FAILURE__;
+                    }
+                    else if (messagesender_send(twin_handle->message_sender, message, on_message_send_complete, twin_handle) != 0)
+                    {
+                        LogError("Cannot send the twin request message");
+                        result = __FAILURE__;
+                    }
+                    else
+                    {
+                        request->sent = true;
+                        result = 0;
+                    }
+                }
+
+                amqpvalue_destroy(correlation_id);
+            }
+
+            properties_destroy(properties);
+        }
+
+        message_destroy(message);
+    }
+
+    return result;
+}
+
+static void send_pending_requests(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle)
+{
+    PDLIST_ENTRY entry = twin_handle->requests.Flink;
+    bool failed = false;
+
+    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_014: [ Once the sender link is open, all the requests not sent yet shall be sent in order without waiting for the responses of the previous ones. ]*/
+    while ((!failed) && (entry != &twin_handle->requests))
+    {
+        TWIN_REQUEST* request = containingRecord(entry, TWIN_REQUEST, entry);
+        if ((!request->sent) &&
+            (send_request(twin_handle, request) != 0))
+        {
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_015: [ If a request cannot be sent, `on_twin_error` shall be called and the request shall be kept for the next subscribe. ]*/
+            failed = true;
+        }
+        entry = entry->Flink;
+    }
+
+    if (failed)
+    {
+        twin_handle->on_twin_error(twin_handle->context);
+    }
+}
+
+static void on_message_receiver_state_changed(const void* context, MESSAGE_RECEIVER_STATE new_state, MESSAGE_RECEIVER_STATE previous_state)
+{
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle = (IOTHUBTRANSPORT_AMQP_TWIN_HANDLE)context;
+
+    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_016: [ If the message receiver or the message sender goes to the ERROR state, `on_twin_error` shall be called. ]*/
+    if ((new_state != previous_state) &&
+        (new_state == MESSAGE_RECEIVER_STATE_ERROR))
+    {
+        twin_handle->on_twin_error(twin_handle->context);
+    }
+}
+
+static void on_message_sender_state_changed(void* context, MESSAGE_SENDER_STATE new_state, MESSAGE_SENDER_STATE previous_state)
+{
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle = (IOTHUBTRANSPORT_AMQP_TWIN_HANDLE)context;
+
+    if (new_state != previous_state)
+    {
+        if (new_state == MESSAGE_SENDER_STATE_ERROR)
+        {
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_016: [ If the message receiver or the message sender goes to the ERROR state, `on_twin_error` shall be called. ]*/
+            twin_handle->sender_open = false;
+            twin_handle->on_twin_error(twin_handle->context);
+        }
+        else if (new_state == MESSAGE_SENDER_STATE_OPEN)
+        {
+            twin_handle->sender_open = true;
+            send_pending_requests(twin_handle);
+        }
+        else
+        {
+            twin_handle->sender_open = false;
+        }
+    }
+}
+
+static TWIN_REQUEST* find_sent_request(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle, const char* correlation_id)
+{
+    TWIN_REQUEST* result = NULL;
+    PDLIST_ENTRY entry = twin_handle->requests.Flink;
+
+    while ((result == NULL) && (entry != &twin_handle->requests))
+    {
+        TWIN_REQUEST* request = containingRecord(entry, TWIN_REQUEST, entry);
+        if (request->sent && (strcmp(request->correlation_id, correlation_id) == 0))
+        {
+            result = request;
+        }
+        entry = entry->Flink;
+    }
+
+    return result;
+}
+
+static const char* get_correlation_id(MESSAGE_HANDLE message, PROPERTIES_HANDLE* properties)
+{
+    const char* result = NULL;
+    AMQP_VALUE correlation_id;
+
+    *properties = NULL;
+    if ((message_get_properties(message, properties) == 0) &&
+        (*properties != NULL) &&
+        (properties_get_correlation_id(*properties, &correlation_id) == 0) &&
+        (amqpvalue_get_string(correlation_id, &result) != 0))
+    {
+        result = NULL;
+    }
+
+    return result;
+}
+
+static int get_status_code(MESSAGE_HANDLE message)
+{
+    int result = TWIN_STATUS_CODE_SERVER_ERROR;
+    annotations message_annotations = NULL;
+
+    if ((message_get_message_annotations(message, &message_annotations) != 0) || (message_annotations == NULL))
+    {
+        LogError("Cannot get the message annotations of the twin response");
+    }
+    else
+    {
+        AMQP_VALUE key = amqpvalue_create_symbol(TWIN_ANNOTATION_STATUS);
+        if (key == NULL)
+        {
+            LogError("Cannot create the key of the status annotation");
+        }
+        else
+        {
+            AMQP_VALUE status = amqpvalue_get_map_value(message_annotations, key);
+            if (status == NULL)
+            {
+                LogError("The twin response has no status annotation");
+            }
+            else
+            {
+                int32_t status_code;
+                if (amqpvalue_get_int(status, &status_code) != 0)
+                {
+                    LogError("Cannot read the status of the twin response");
+                }
+                else
+                {
+                    result = (int)status_code;
+                }
+
+                amqpvalue_destroy(status);
+            }
+
+            amqpvalue_destroy(key);
+        }
+
+        amqpvalue_destroy(message_annotations);
+    }
+
+    return result;
+}
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+    AMQP_VALUE result;
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle = (IOTHUBTRANSPORT_AMQP_TWIN_HANDLE)context;
+
+    if (message == NULL)
+    {
+        LogError("NULL message");
+        result = messaging_delivery_released();
+    }
+    else
+    {
+        PROPERTIES_HANDLE properties;
+        const char* correlation_id = get_correlation_id(message, &properties);
+        size_t body_count;
+        BINARY_DATA binary_data;
+
+        binary_data.bytes = NULL;
+        binary_data.length = 0;
+
+        if ((message_get_body_amqp_data_count(message, &body_count) == 0) &&
+            (body_count > 0) &&
+            (message_get_body_amqp_data_in_place(message, 0, &binary_data) != 0))
+        {
+            LogError("Cannot get the body of the twin message");
+            result = messaging_delivery_rejected("amqp:decode-error", "Cannot get the body of the twin message");
+        }
+        else
+        {
+            TWIN_REQUEST* request = (correlation_id == NULL) ? NULL : find_sent_request(twin_handle, correlation_id);
+
+            if (request == NULL)
+            {
+                if (correlation_id == NULL)
+                {
+                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_017: [ A message without correlation id shall be a patch of the desired properties, given to `on_document_received` with DEVICE_TWIN_UPDATE_PARTIAL. ]*/
+                    twin_handle->on_document_received(twin_handle->context, DEVICE_TWIN_UPDATE_PARTIAL, binary_data.bytes, binary_data.length);
+                }
+                else
+                {
+                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_018: [ A response matching no request waiting for its response shall be accepted and ignored. ]*/
+                    LogError("Twin response '%s' matches no request", correlation_id);
+                }
+            }
+            else
+            {
+                int status_code = get_status_code(message);
+
+                (void)DList_RemoveEntryList(&request->entry);
+
+                if (request->operation == TWIN_OPERATION_PATCH)
+                {
+                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_019: [ The response of a reported state shall be given to `on_reported_state_complete` with the `item_id` of the reported state and the `status` annotation of the response, 500 if it has none. ]*/
+                    twin_handle->on_reported_state_complete(twin_handle->context, request->item_id, status_code);
+                }
+                else if ((status_code < TWIN_STATUS_CODE_OK_MIN) || (status_code > TWIN_STATUS_CODE_OK_MAX))
+                {
+                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_020: [ If the GET or the subscription to the desired properties fails, `on_twin_error` shall be called. ]*/
+                    LogError("Twin request '%s' failed with status %d", request->correlation_id, status_code);
+                    twin_handle->on_twin_error(twin_handle->context);
+                }
+                else if (request->operation == TWIN_OPERATION_GET)
+                {
+                    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_021: [ The response of the GET shall be given to `on_document_received` with DEVICE_TWIN_UPDATE_COMPLETE. ]*/
+                    twin_handle->on_document_received(twin_handle->context, DEVICE_TWIN_UPDATE_COMPLETE, binary_data.bytes, binary_data.length);
+                }
+
+                destroy_request(request);
+            }
+
+            result = messaging_delivery_accepted();
+        }
+
+        if (properties != NULL)
+        {
+            properties_destroy(properties);
+        }
+    }
+
+    return result;
+}
+
+static int set_link_attach_properties(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle)
+{
+    int result;
+    fields link_attach_properties = amqpvalue_create_map();
+
+    if (link_attach_properties == NULL)
+    {
+        LogError("Cannot create the map for the link attach properties");
+        result = __FAILURE__;
+    }
+    else
+    {
+        STRING_HANDLE channel_correlation_id = STRING_construct_sprintf("twin:%s", twin_handle->device_id);
+        if (channel_correlation_id == NULL)
+        {
+            LogError("Cannot create the channel correlation id");
+            result = __FAILURE__;
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_007: [ Both links shall have the attach properties `com.microsoft:channel-correlation-id` set to `twin:` followed by the device id and `com.microsoft:api-version` set to `2016-11-14`. ]*/
+            if ((add_annotation(link_attach_properties, "com.microsoft:channel-correlation-id", STRING_c_str(channel_correlation_id)) != 0) ||
+                (add_annotation(link_attach_properties, "com.microsoft:api-version", TWIN_API_VERSION) != 0))
+            {
+                result = __FAILURE__;
+            }
+            else if (link_set_attach_properties(twin_handle->sender_link, link_attach_properties) != 0)
+            {
+                LogError("Cannot set the link attach properties on the sender link");
+                result = __FAILURE__;
+            }
+            else if (link_set_attach_properties(twin_handle->receiver_link, link_attach_properties) != 0)
+            {
+                LogError("Cannot set the link attach properties on the receiver link");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+
+            STRING_delete(channel_correlation_id);
+        }
+
+        amqpvalue_destroy(link_attach_properties);
+    }
+
+    return result;
+}
+
+static LINK_HANDLE create_link(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle, SESSION_HANDLE session_handle, const char* endpoint, role link_role)
+{
+    LINK_HANDLE result = NULL;
+    STRING_HANDLE link_name = STRING_construct_sprintf((link_role == role_sender) ? "twin_sender_link-%s" : "twin_receiver_link-%s", twin_handle->device_id);
+
+    if (link_name == NULL)
+    {
+        LogError("Cannot create the twin link name");
+    }
+    else
+    {
+        AMQP_VALUE source = messaging_create_source((link_role == role_sender) ? "twin_requests" : endpoint);
+        if (source == NULL)
+        {
+            LogError("Cannot create the twin link source");
+        }
+        else
+        {
+            AMQP_VALUE target = messaging_create_target((link_role == role_sender) ? endpoint : "twin_responses");
+            if (target == NULL)
+            {
+                LogError("Cannot create the twin link target");
+            }
+            else
+            {
+                if ((result = link_create(session_handle, STRING_c_str(link_name), link_role, source, target)) == NULL)
+                {
+                    LogError("Cannot create the twin link");
+                }
+
+                amqpvalue_destroy(target);
+            }
+
+            amqpvalue_destroy(source);
+        }
+
+        STRING_delete(link_name);
+    }
+
+    return result;
+}
+
+static void destroy_links(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle)
+{
+    if (twin_handle->message_receiver != NULL)
+    {
+        messagereceiver_destroy(twin_handle->message_receiver);
+        twin_handle->message_receiver = NULL;
+    }
+    if (twin_handle->message_sender != NULL)
+    {
+        messagesender_destroy(twin_handle->message_sender);
+        twin_handle->message_sender = NULL;
+    }
+    if (twin_handle->sender_link != NULL)
+    {
+        link_destroy(twin_handle->sender_link);
+        twin_handle->sender_link = NULL;
+    }
+    if (twin_handle->receiver_link != NULL)
+    {
+        link_destroy(twin_handle->receiver_link);
+        twin_handle->receiver_link = NULL;
+    }
+    twin_handle->sender_open = false;
+}
+
+static void forget_requests_but_reported_states(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle)
+{
+    PDLIST_ENTRY entry = twin_handle->requests.Flink;
+
+    while (entry != &twin_handle->requests)
+    {
+        TWIN_REQUEST* request = containingRecord(entry, TWIN_REQUEST, entry);
+        entry = entry->Flink;
+
+        if (request->operation == TWIN_OPERATION_PATCH)
+        {
+            request->sent = false;
+        }
+        else
+        {
+            (void)DList_RemoveEntryList(&request->entry);
+            destroy_request(request);
+        }
+    }
+}
+
+IOTHUBTRANSPORT_AMQP_TWIN_HANDLE iothubtransportamqp_twin_create(const char* hostname, const char* device_id)
+{
+    IOTHUBTRANSPORT_AMQP_TWIN* result;
+
+    if ((hostname == NULL) ||
+        (device_id == NULL))
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_002: [ If any argument is NULL, `iothubtransportamqp_twin_create` shall return NULL. ]*/
+        LogError("Bad arguments: hostname=%p, device_id=%p", hostname, device_id);
+        result = NULL;
+    }
+    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_001: [ `iothubtransportamqp_twin_create` shall allocate a new instance handling the device twin of `device_id` over AMQP, saving copies of `hostname` and `device_id`, and on success return a non-NULL handle to it. ]*/
+    else if ((result = (IOTHUBTRANSPORT_AMQP_TWIN*)malloc(sizeof(IOTHUBTRANSPORT_AMQP_TWIN))) == NULL)
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_003: [ If any allocation fails, `iothubtransportamqp_twin_create` shall return NULL. ]*/
+        LogError("Cannot allocate memory for the AMQP twin handle");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUBTRANSPORT_AMQP_TWIN));
+
+        if (mallocAndStrcpy_s(&result->device_id, device_id) != 0)
+        {
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_003: [ If any allocation fails, `iothubtransportamqp_twin_create` shall return NULL. ]*/
+            LogError("Cannot copy device_id");
+            free(result);
+            result = NULL;
+        }
+        else if (mallocAndStrcpy_s(&result->hostname, hostname) != 0)
+        {
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_003: [ If any allocation fails, `iothubtransportamqp_twin_create` shall return NULL. ]*/
+            LogError("Cannot copy hostname");
+            free(result->device_id);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->subscribe_state = SUBSCRIBE_STATE_NOT_SUBSCRIBED;
+            DList_InitializeListHead(&result->requests);
+        }
+    }
+
+    return result;
+}
+
+void iothubtransportamqp_twin_destroy(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle)
+{
+    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_004: [ If `twin_handle` is NULL, `iothubtransportamqp_twin_destroy` shall do nothing. ]*/
+    if (twin_handle == NULL)
+    {
+        LogError("NULL handle");
+    }
+    else
+    {
+        PDLIST_ENTRY entry;
+
+        if (twin_handle->subscribe_state == SUBSCRIBE_STATE_SUBSCRIBED)
+        {
+            iothubtransportamqp_twin_unsubscribe(twin_handle);
+        }
+
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_005: [ `iothubtransportamqp_twin_destroy` shall unsubscribe if subscribed and free the instance with the requests still waiting, without calling any callback. ]*/
+        while ((entry = DList_RemoveHeadList(&twin_handle->requests)) != &twin_handle->requests)
+        {
+            destroy_request(containingRecord(entry, TWIN_REQUEST, entry));
+        }
+
+        free(twin_handle->hostname);
+        free(twin_handle->device_id);
+        free(twin_handle);
+    }
+}
+
+int iothubtransportamqp_twin_subscribe(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle, SESSION_HANDLE session_handle,
+    ON_TWIN_ERROR on_twin_error, ON_TWIN_DOCUMENT_RECEIVED on_document_received, ON_TWIN_REPORTED_STATE_COMPLETE on_reported_state_complete, void* context)
+{
+    int result;
+
+    if ((twin_handle == NULL) ||
+        (session_handle == NULL) ||
+        (on_twin_error == NULL) ||
+        (on_document_received == NULL) ||
+        (on_reported_state_complete == NULL))
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_022: [ If any argument but `context` is NULL, `iothubtransportamqp_twin_subscribe` shall fail and return a non-zero value. ]*/
+        LogError("Invalid arguments: twin_handle=%p, session_handle=%p, on_twin_error=%p, on_document_received=%p, on_reported_state_complete=%p",
+            twin_handle, session_handle, on_twin_error, on_document_received, on_reported_state_complete);
+        result = __FAILURE__;
+    }
+    else if (twin_handle->subscribe_state != SUBSCRIBE_STATE_NOT_SUBSCRIBED)
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_023: [ If the instance is already subscribed, `iothubtransportamqp_twin_subscribe` shall fail and return a non-zero value. ]*/
+        LogError("Already subscribed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_006: [ `iothubtransportamqp_twin_subscribe` shall create on `session_handle` a sender link and a receiver link to `amqps://{hostname}/devices/{device_id}/twin`, named `twin_sender_link-{device_id}` and `twin_receiver_link-{device_id}`. ]*/
+        STRING_HANDLE endpoint = STRING_construct_sprintf("amqps://%s/devices/%s/twin", twin_handle->hostname, twin_handle->device_id);
+        if (endpoint == NULL)
+        {
+            LogError("Cannot create the twin endpoint");
+            result = __FAILURE__;
+        }
+        else
+        {
+            TWIN_REQUEST* subscribe_request;
+            TWIN_REQUEST* get_request;
+
+            twin_handle->on_twin_error = on_twin_error;
+            twin_handle->on_document_received = on_document_received;
+            twin_handle->on_reported_state_complete = on_reported_state_complete;
+            twin_handle->context = context;
+
+            if ((twin_handle->receiver_link = create_link(twin_handle, session_handle, STRING_c_str(endpoint), role_receiver)) == NULL ||
+                (twin_handle->sender_link = create_link(twin_handle, session_handle, STRING_c_str(endpoint), role_sender)) == NULL ||
+                set_link_attach_properties(twin_handle) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else if ((twin_handle->message_receiver = messagereceiver_create(twin_handle->receiver_link, on_message_receiver_state_changed, twin_handle)) == NULL)
+            {
+                LogError("Cannot create the twin message receiver");
+                result = __FAILURE__;
+            }
+            else if ((twin_handle->message_sender = messagesender_create(twin_handle->sender_link, on_message_sender_state_changed, twin_handle)) == NULL)
+            {
+                LogError("Cannot create the twin message sender");
+                result = __FAILURE__;
+            }
+            else if ((subscribe_request = create_request(twin_handle, TWIN_OPERATION_PUT)) == NULL)
+            {
+                result = __FAILURE__;
+            }
+            else if ((get_request = create_request(twin_handle, TWIN_OPERATION_GET)) == NULL)
+            {
+                destroy_request(subscribe_request);
+                result = __FAILURE__;
+            }
+            else
+            {
+                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_008: [ `iothubtransportamqp_twin_subscribe` shall queue the subscription to the desired properties and then the GET of the twin document ahead of the reported states kept from a previous subscription, and open the message sender and the message receiver. ]*/
+                DList_InsertHeadList(&twin_handle->requests, &get_request->entry);
+                DList_InsertHeadList(&twin_handle->requests, &subscribe_request->entry);
+
+                if (messagesender_open(twin_handle->message_sender) != 0)
+                {
+                    LogError("Cannot open the twin message sender");
+                    result = __FAILURE__;
+                }
+                else if (messagereceiver_open(twin_handle->message_receiver, on_message_received, twin_handle) != 0)
+                {
+                    LogError("Cannot open the twin message receiver");
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    twin_handle->subscribe_state = SUBSCRIBE_STATE_SUBSCRIBED;
+                    result = 0;
+                }
+            }
+
+            if (result != 0)
+            {
+                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_024: [ If anything fails, `iothubtransportamqp_twin_subscribe` shall destroy what it created and return a non-zero value. ]*/
+                destroy_links(twin_handle);
+                forget_requests_but_reported_states(twin_handle);
+            }
+
+            STRING_delete(endpoint);
+        }
+    }
+
+    return result;
+}
+
+void iothubtransportamqp_twin_unsubscribe(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle)
+{
+    if (twin_handle == NULL)
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_025: [ If `twin_handle` is NULL or not subscribed, `iothubtransportamqp_twin_unsubscribe` shall do nothing. ]*/
+        LogError("NULL handle");
+    }
+    else if (twin_handle->subscribe_state != SUBSCRIBE_STATE_SUBSCRIBED)
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_025: [ If `twin_handle` is NULL or not subscribed, `iothubtransportamqp_twin_unsubscribe` shall do nothing. ]*/
+        LogError("unsubscribe called while not subscribed");
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_026: [ `iothubtransportamqp_twin_unsubscribe` shall destroy the message receiver, the message sender and both links, drop the GET and the subscription to the desired properties, and keep the reported states waiting for their response to send them again on the next subscribe. ]*/
+        twin_handle->subscribe_state = SUBSCRIBE_STATE_NOT_SUBSCRIBED;
+        destroy_links(twin_handle);
+        forget_requests_but_reported_states(twin_handle);
+    }
+}
+
+int iothubtransportamqp_twin_send_reported_state(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE twin_handle, uint32_t item_id, CONSTBUFFER_HANDLE reported_state)
+{
+    int result;
+
+    if ((twin_handle == NULL) ||
+        (reported_state == NULL))
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_027: [ If `twin_handle` or `reported_state` is NULL, `iothubtransportamqp_twin_send_reported_state` shall fail and return a non-zero value. ]*/
+        LogError("Invalid arguments: twin_handle=%p, reported_state=%p", twin_handle, reported_state);
+        result = __FAILURE__;
+    }
+    else if (twin_handle->subscribe_state != SUBSCRIBE_STATE_SUBSCRIBED)
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_028: [ If the instance is not subscribed, `iothubtransportamqp_twin_send_reported_state` shall fail and return a non-zero value. ]*/
+        LogError("Cannot send a reported state while not subscribed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        TWIN_REQUEST* request = create_request(twin_handle, TWIN_OPERATION_PATCH);
+        if (request == NULL)
+        {
+            result = __FAILURE__;
+        }
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_029: [ `iothubtransportamqp_twin_send_reported_state` shall keep a clone of `reported_state`, so the content is not copied. ]*/
+        else if ((request->reported_state = CONSTBUFFER_Clone(reported_state)) == NULL)
+        {
+            LogError("Cannot clone the reported state");
+            destroy_request(request);
+            result = __FAILURE__;
+        }
+        else
+        {
+            request->item_id = item_id;
+
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_030: [ `iothubtransportamqp_twin_send_reported_state` shall queue the reported state and send it right away if the sender link is open, whatever the number of reported states waiting for their response. ]*/
+            DList_InsertTailList(&twin_handle->requests, &request->entry);
+
+            if (twin_handle->sender_open &&
+                (send_request(twin_handle, request) != 0))
+            {
+                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_031: [ If sending the reported state fails, `iothubtransportamqp_twin_send_reported_state` shall remove it and return a non-zero value. ]*/
+                (void)DList_RemoveEntryList(&request->entry);
+                destroy_request(request);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
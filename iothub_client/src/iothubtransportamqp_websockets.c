@@ -8,6 +8,7 @@
 #include "azure_c_shared_utility/http_proxy_io.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "iothub_client_ws_deflate_io.h"
 
 #define DEFAULT_WS_PROTOCOL_NAME "AMQPWSB10"
 #define DEFAULT_WS_RELATIVE_PATH "/$iothub/websocket"
@@ -18,6 +19,7 @@ static XIO_HANDLE getWebSocketsIOTransport(const char* fqdn, const AMQP_TRANSPOR
     WSIO_CONFIG ws_io_config;
     TLSIO_CONFIG tls_io_config;
     HTTP_PROXY_IO_CONFIG http_proxy_io_config;
+    WS_DEFLATE_IO_CONFIG ws_deflate_io_config;
     /* Codes_SRS_IOTHUBTRANSPORTAMQP_WS_01_001: [ `getIoTransportProvider` shall obtain the WebSocket IO interface handle by calling `wsio_get_interface_description`. ]*/
     const IO_INTERFACE_DESCRIPTION* io_interface_description = wsio_get_interface_description();
     XIO_HANDLE result;
@@ -93,6 +95,12 @@ static XIO_HANDLE getWebSocketsIOTransport(const char* fqdn, const AMQP_TRANSPOR
                 /* Codes_SRS_IOTHUBTRANSPORTAMQP_WS_01_014: [ - If `amqp_transport_proxy_options` is NULL `underlying_io_parameters` shall be set to NULL. ]*/
                 tls_io_config.underlying_io_parameters = NULL;
             }
+
+            /* Codes_SRS_IOTHUBTRANSPORTAMQP_WS_41_002: [ The WebSocket IO shall be put over the permessage-deflate IO obtained with `ws_deflate_io_get_interface_description`, whose `WS_DEFLATE_IO_CONFIG` shall be given the TLS IO interface description and arguments. ]*/
+            ws_deflate_io_config.underlying_io_interface = ws_io_config.underlying_io_interface;
+            ws_deflate_io_config.underlying_io_parameters = &tls_io_config;
+            ws_io_config.underlying_io_interface = ws_deflate_io_get_interface_description();
+            ws_io_config.underlying_io_parameters = &ws_deflate_io_config;
         }
 
         /* Codes_SRS_IoTHubTransportAMQP_WS_09_004: [getWebSocketsIOTransport shall return the XIO_HANDLE created using xio_create().] */
@@ -110,7 +118,7 @@ static TRANSPORT_LL_HANDLE IoTHubTransportAMQP_WS_Create(const IOTHUBTRANSPORT_C
     return IoTHubTransport_AMQP_Common_Create(config, getWebSocketsIOTransport);
 }
 
-static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportAMQP_WS_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportAMQP_WS_ProcessItem(IOTHUB_DEVICE_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
 {
     // Codes_SRS_IoTHubTransportAMQP_WS_09_014: [IoTHubTransportAMQP_WS_ProcessItem shall invoke IoTHubTransport_AMQP_Common_ProcessItem() and return its result.]
     return IoTHubTransport_AMQP_Common_ProcessItem(handle, item_type, iothub_item);
@@ -169,6 +177,12 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_WS_GetSendStatus(IOTHUB_DEVICE_H
     return IoTHubTransport_AMQP_Common_GetSendStatus(handle, iotHubClientStatus);
 }
 
+static size_t IoTHubTransportAMQP_WS_GetPollDescriptors(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_POLL_DESCRIPTOR* descriptors, size_t descriptorCount)
+{
+    // Codes_SRS_IoTHubTransportAMQP_WS_41_001: [IoTHubTransportAMQP_WS_GetPollDescriptors shall get the sockets by calling into the IoTHubTransport_AMQP_Common_GetPollDescriptors()]
+    return IoTHubTransport_AMQP_Common_GetPollDescriptors(handle, descriptors, descriptorCount);
+}
+
 static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_WS_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     // Codes_SRS_IoTHubTransportAMQP_WS_09_017: [IoTHubTransportAMQP_WS_SetOption shall set the options by calling into the IoTHubTransport_AMQP_Common_SetOption()]
@@ -229,7 +243,10 @@ static TRANSPORT_PROVIDER thisTransportProvider_WebSocketsOverTls =
     IoTHubTransportAMQP_WS_Unsubscribe,                                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
     IoTHubTransportAMQP_WS_DoWork,                                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
     IoTHubTransportAMQP_WS_SetRetryPolicy,                             /*pfIoTHubTransport_SetRetryLogic IoTHubTransport_SetRetryPolicy;*/
-    IoTHubTransportAMQP_WS_GetSendStatus                               /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportAMQP_WS_GetSendStatus,                              /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    NULL,                                                              /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline; uAMQP keeps its timers to itself*/
+    IoTHubTransportAMQP_WS_GetPollDescriptors,                         /*pfIoTHubTransport_GetPollDescriptors IoTHubTransport_GetPollDescriptors;*/
+    NULL                                                               /*pfIoTHubTransport_TrimMemory IoTHubTransport_TrimMemory; the frame buffers are uAMQP's*/
 };
 
 /* Codes_SRS_IoTHubTransportAMQP_WS_09_019: [This function shall return a pointer to a structure of type TRANSPORT_PROVIDER having the following values for it's fields:
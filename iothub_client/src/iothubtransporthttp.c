@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <time.h>
@@ -10,6 +11,7 @@
 #include "iothub_client_private.h"
 #include "iothub_transport_ll.h"
 #include "iothubtransporthttp.h"
+#include "iothub_client_log_limit.h"
 
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
@@ -17,6 +19,7 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "azure_c_shared_utility/sastoken.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
@@ -24,6 +27,9 @@
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/agenttime.h"
 
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_HTTP
+#include "iothub_client_memory_tag.h"
+
 #define IOTHUB_APP_PREFIX "iothub-app-"
 const char* IOTHUB_MESSAGE_ID = "iothub-messageid";
 const char* IOTHUB_CORRELATION_ID = "iothub-correlationid";
@@ -36,6 +42,9 @@ const char* IOTHUB_CORRELATION_ID = "iothub-correlationid";
 /*the default is 25 minutes*/
 #define DEFAULT_GETMINIMUMPOLLINGTIME ((unsigned int)25*60) 
 
+/*a SAS token cached for a device key (only when "sas_token_lifetime" is set) is created again after this many seconds by default*/
+#define DEFAULT_SAS_TOKEN_REFRESH_TIME_SECS 1800
+
 #define MAXIMUM_MESSAGE_SIZE (255*1024-1)
 #define MAXIMUM_PAYLOAD_OVERHEAD 384
 #define MAXIMUM_PROPERTY_OVERHEAD 16
@@ -48,10 +57,28 @@ typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
     STRING_HANDLE hostName;
     HTTPAPIEX_HANDLE httpApiExHandle;
     bool doBatchedTransfers;
+    bool sendBinaryEventsAlone; /*with doBatchedTransfers, byte array events skip the base64 JSON batch and are sent as their own binary POST*/
+    size_t batchMaxEvents; /*0 when a batch is only limited by its size*/
+    size_t batchMaxBytes; /*0 when a batch is only limited by MAXIMUM_MESSAGE_SIZE*/
+    unsigned int batchLingerTime; /*seconds a batch that is not full waits for more events, 0 sends whatever is queued at each DoWork*/
     unsigned int getMinimumPollingTime;
+    bool pollC2DUntilEmpty;
+    unsigned int c2dPollingBackoffMax; /*0 when the GETs are always GetMinimumPollingTime apart*/
+    bool deferC2DDisposition;
+    size_t sasTokenLifetime; /*0 when the SAS token of the device keys is derived again by each request*/
+    size_t sasTokenRefreshTime;
     VECTOR_HANDLE perDeviceList;
+    size_t firstDeviceIndex; /*index in perDeviceList of the device served first by the next DoWork*/
+    size_t deviceQuantum; /*bytes of event content each device may send per DoWork, carried over when unused, 0 for no limit*/
 }HTTPTRANSPORT_HANDLE_DATA;
 
+typedef struct PENDING_DISPOSITION_TAG
+{
+    struct PENDING_DISPOSITION_TAG* next;
+    char* etagValue;
+    IOTHUBMESSAGE_DISPOSITION_RESULT action;
+} PENDING_DISPOSITION;
+
 typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
 {
     HTTPTRANSPORT_HANDLE_DATA* transportHandle;
@@ -63,15 +90,28 @@ typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
     STRING_HANDLE messageHTTPrelativePath;
     HTTP_HEADERS_HANDLE eventHTTPrequestHeaders;
     HTTP_HEADERS_HANDLE messageHTTPrequestHeaders;
+    HTTP_HEADERS_HANDLE eventOctetStreamHTTPrequestHeaders; /*eventHTTPrequestHeaders with "Content-Type" set to "application/octet-stream", the template of the NonBatched events*/
     STRING_HANDLE abandonHTTPrelativePathBegin;
     HTTPAPIEX_SAS_HANDLE sasObject;
+    STRING_HANDLE cachedSasToken; /*created from deviceKey when "sas_token_lifetime" is set, used for the requests until it is refreshed*/
+    time_t cachedSasTokenCreationTime;
     bool DoWork_PullMessage;
     time_t lastPollTime;
     bool isFirstPoll;
+    bool isNextPollAllowed; /*set when a GET returned a message and "c2d_poll_until_empty" or "c2d_polling_backoff_max" is enabled*/
+    unsigned int pollingInterval; /*with "c2d_polling_backoff_max", seconds between GETs grown by the GETs that found no message, 0 for GetMinimumPollingTime*/
 
     IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle;
     PDLIST_ENTRY waitingToSend;
     DLIST_ENTRY eventConfirmations; /*holds items for event confirmations*/
+    BUFFER_HANDLE eventBatchBuffer; /*request content of the batched events, kept from one DoEvent to the next so its memory is reused*/
+    bool isBatchLingering; /*set while a batch that is not full waits for "batching_linger_time" to elapse*/
+    time_t batchLingerStartTime;
+    size_t batchSplitRemaining; /*events of a batch refused by the hub that are neither accepted nor failed yet, 0 when there are none*/
+    size_t batchSplitMaxEvents; /*most events of a batch while batchSplitRemaining is not 0*/
+    size_t sendDeficit; /*with "device_quantum", bytes of event content the device can still send*/
+    PENDING_DISPOSITION* pendingDispositionsHead; /*dispositions waiting for the next DoWork when "c2d_defer_disposition" is enabled, oldest first*/
+    PENDING_DISPOSITION* pendingDispositionsTail;
 } HTTPTRANSPORT_PERDEVICE_DATA;
 
 typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
@@ -81,6 +121,9 @@ typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
     char* etagValue;
 } MESSAGE_DISPOSITION_CONTEXT;
 
+/*forward declaration*/
+static void flushPendingDispositions(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData);
+
 DEFINE_ENUM_STRINGS(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_DISPOSITION_RESULT_VALUES);
 
 static void destroy_eventHTTPrelativePath(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
@@ -478,6 +521,135 @@ static bool create_deviceSasToken(HTTPTRANSPORT_PERDEVICE_DATA* handleData, cons
 */
 
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]*/
+static void destroy_eventBatchBuffer(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
+{
+    if (handleData->eventBatchBuffer != NULL)
+    {
+        BUFFER_delete(handleData->eventBatchBuffer);
+        handleData->eventBatchBuffer = NULL;
+    }
+}
+
+static void destroy_eventOctetStreamHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
+{
+    if (handleData->eventOctetStreamHTTPrequestHeaders != NULL)
+    {
+        HTTPHeaders_Free(handleData->eventOctetStreamHTTPrequestHeaders);
+        handleData->eventOctetStreamHTTPrequestHeaders = NULL;
+    }
+}
+
+static void destroy_cachedSasToken(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
+{
+    if (handleData->cachedSasToken != NULL)
+    {
+        STRING_delete(handleData->cachedSasToken);
+        handleData->cachedSasToken = NULL;
+    }
+}
+
+static STRING_HANDLE create_cachedSasToken(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, time_t timeNow)
+{
+    /*same scope and key name as the HTTPAPIEX_SAS_HANDLE made by create_deviceSASObject*/
+    STRING_HANDLE result;
+    STRING_HANDLE keyName = URL_EncodeString(STRING_c_str(deviceData->deviceId));
+    if (keyName == NULL)
+    {
+        LogError("URL_EncodeString keyname failed");
+        result = NULL;
+    }
+    else
+    {
+        STRING_HANDLE uriResource = STRING_clone(handleData->hostName);
+        if (uriResource == NULL)
+        {
+            LogError("STRING_clone uri resource failed");
+            result = NULL;
+        }
+        else
+        {
+            if ((STRING_concat(uriResource, "/devices/") != 0) ||
+                (STRING_concat_with_STRING(uriResource, keyName) != 0) ||
+                (STRING_empty(keyName) != 0))
+            {
+                LogError("unable to form the SAS token scope");
+                result = NULL;
+            }
+            else
+            {
+                size_t expiry = (size_t)get_difftime(timeNow, (time_t)0) + handleData->sasTokenLifetime;
+                if ((result = SASToken_Create(deviceData->deviceKey, uriResource, keyName, expiry)) == NULL)
+                {
+                    LogError("SASToken_Create failed");
+                }
+            }
+            STRING_delete(uriResource);
+        }
+        STRING_delete(keyName);
+    }
+    return result;
+}
+
+/*returns the token to put in the Authorization header of a request of the device, NULL when the request shall be signed by HTTPAPIEX_SAS_ExecuteRequest*/
+static STRING_HANDLE getDeviceSasToken(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    STRING_HANDLE result;
+    if (deviceData->deviceSasToken != NULL)
+    {
+        result = deviceData->deviceSasToken;
+    }
+    else if ((handleData->sasTokenLifetime == 0) || (deviceData->deviceKey == NULL))
+    {
+        result = NULL;
+    }
+    else
+    {
+        time_t timeNow = get_time(NULL);
+        if (timeNow == (time_t)(-1))
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_015: [ If the time is not available, the request shall be signed by HTTPAPIEX_SAS_ExecuteRequest. ]*/
+            LogErrorLimited("unable to get_time, the request is signed by HTTPAPIEX_SAS_ExecuteRequest");
+            result = NULL;
+        }
+        else
+        {
+            double tokenAge = (deviceData->cachedSasToken == NULL) ? 0 : get_difftime(timeNow, deviceData->cachedSasTokenCreationTime);
+            size_t refreshTime = (handleData->sasTokenRefreshTime < handleData->sasTokenLifetime) ? handleData->sasTokenRefreshTime : handleData->sasTokenLifetime;
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_013: [ The cached SAS token shall be created with SASToken_Create, expiring "sas_token_lifetime" seconds from now, by the first request of the device and again by the first request "sas_token_refresh_time" seconds (or "sas_token_lifetime" seconds if smaller) after it was created. ]*/
+            if ((deviceData->cachedSasToken == NULL) || (tokenAge < 0) || (tokenAge >= refreshTime))
+            {
+                STRING_HANDLE newSasToken = create_cachedSasToken(handleData, deviceData, timeNow);
+                if (newSasToken != NULL)
+                {
+                    destroy_cachedSasToken(deviceData);
+                    deviceData->cachedSasToken = newSasToken;
+                    deviceData->cachedSasTokenCreationTime = timeNow;
+                }
+                /*Codes_SRS_TRANSPORTMULTITHTTP_41_014: [ If creating the SAS token fails, the previous one shall be used while it has not expired, otherwise the request shall be signed by HTTPAPIEX_SAS_ExecuteRequest. ]*/
+                else if ((deviceData->cachedSasToken != NULL) && ((tokenAge < 0) || (tokenAge >= handleData->sasTokenLifetime)))
+                {
+                    LogError("unable to refresh the SAS token of %s, it has expired", STRING_c_str(deviceData->deviceId));
+                    destroy_cachedSasToken(deviceData);
+                }
+            }
+            result = deviceData->cachedSasToken;
+        }
+    }
+    return result;
+}
+
+static void destroy_pendingDispositions(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
+{
+    while (handleData->pendingDispositionsHead != NULL)
+    {
+        PENDING_DISPOSITION* pendingDisposition = handleData->pendingDispositionsHead;
+        handleData->pendingDispositionsHead = pendingDisposition->next;
+        free(pendingDisposition->etagValue);
+        free(pendingDisposition);
+    }
+    handleData->pendingDispositionsTail = NULL;
+}
+
 static bool findDeviceHandle(const void* element, const void* value)
 {
     bool result;
@@ -604,8 +776,19 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_128: [ IoTHubTransportHttp_Register shall mark this device as unsubscribed. ]*/
                 result->DoWork_PullMessage = false;
                 result->isFirstPoll = true;
+                result->isNextPollAllowed = false;
+                result->pollingInterval = 0;
                 result->waitingToSend = waitingToSend;
                 DList_InitializeListHead(&(result->eventConfirmations));
+                result->eventBatchBuffer = NULL; /*created by the first batched DoEvent*/
+                result->eventOctetStreamHTTPrequestHeaders = NULL; /*created by the first NonBatched DoEvent*/
+                result->isBatchLingering = false;
+                result->batchSplitRemaining = 0;
+                result->batchSplitMaxEvents = 0;
+                result->sendDeficit = 0;
+                result->pendingDispositionsHead = NULL;
+                result->pendingDispositionsTail = NULL;
+                result->cachedSasToken = NULL; /*created by the first request when "sas_token_lifetime" is set*/
                 result->transportHandle = (HTTPTRANSPORT_HANDLE_DATA *) handle;
             }
             else
@@ -642,6 +825,10 @@ static void destroy_perDeviceData(HTTPTRANSPORT_PERDEVICE_DATA * perDeviceItem)
     destroy_messageHTTPrequestHeaders(perDeviceItem);
     destroy_abandonHTTPrelativePathBegin(perDeviceItem);
     destroy_SASObject(perDeviceItem);
+    destroy_eventBatchBuffer(perDeviceItem);
+    destroy_eventOctetStreamHTTPrequestHeaders(perDeviceItem);
+    destroy_pendingDispositions(perDeviceItem);
+    destroy_cachedSasToken(perDeviceItem);
 }
 
 static IOTHUB_DEVICE_HANDLE* get_perDeviceDataItem(IOTHUB_DEVICE_HANDLE deviceHandle)
@@ -687,6 +874,8 @@ static void IoTHubTransportHttp_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
         {
             HTTPTRANSPORT_PERDEVICE_DATA * perDeviceItem = (HTTPTRANSPORT_PERDEVICE_DATA *)(*listItem);
 
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_011: [ IoTHubTransportHttp_Unregister and IoTHubTransportHttp_Destroy shall send the dispositions still queued for the device before freeing it. ]*/
+            flushPendingDispositions(handleData, perDeviceItem);
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_047: [ IoTHubTransportHttp_Unregister shall free all the resources used in the device structure. ]*/
             destroy_perDeviceData(perDeviceItem);
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_048: [ IoTHubTransportHttp_Unregister shall call singlylinkedlist_remove to remove device from devices list. ]*/
@@ -844,7 +1033,18 @@ static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONF
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]*/
                 result->doBatchedTransfers = false;
+                result->sendBinaryEventsAlone = false;
+                result->batchMaxEvents = 0;
+                result->batchMaxBytes = 0;
+                result->batchLingerTime = 0;
                 result->getMinimumPollingTime = DEFAULT_GETMINIMUMPOLLINGTIME;
+                result->pollC2DUntilEmpty = false;
+                result->c2dPollingBackoffMax = 0;
+                result->deferC2DDisposition = false;
+                result->sasTokenLifetime = 0;
+                result->sasTokenRefreshTime = DEFAULT_SAS_TOKEN_REFRESH_TIME_SECS;
+                result->firstDeviceIndex = 0;
+                result->deviceQuantum = 0;
             }
             else
             {
@@ -874,6 +1074,8 @@ static void IoTHubTransportHttp_Destroy(TRANSPORT_LL_HANDLE handle)
         {
             listItem = (IOTHUB_DEVICE_HANDLE *) VECTOR_element(handleData->perDeviceList, i);
             HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = (HTTPTRANSPORT_PERDEVICE_DATA*)(*listItem);
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_011: [ IoTHubTransportHttp_Unregister and IoTHubTransportHttp_Destroy shall send the dispositions still queued for the device before freeing it. ]*/
+            flushPendingDispositions(handleData, perDeviceItem);
             destroy_perDeviceData(perDeviceItem);
             free(perDeviceItem);
         }
@@ -1085,11 +1287,12 @@ static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, cons
     return result;
 }
 
-/*makes the following string:{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-/*return NULL if there was a failure, or a non-NULL STRING_HANDLE that contains the intended data*/
-static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeContribution)
+/*appends the following string to payload:{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]},*/
+/*the item is written straight into the batch payload, so no intermediate STRING is built and copied for every message*/
+/*returns 0 if the item was appended, otherwise payload might contain part of the item and has to be rolled back by the caller*/
+static int appendEventJSONitem(STRING_HANDLE payload, PDLIST_ENTRY item, size_t *messageSizeContribution)
 {
-    STRING_HANDLE result; /*temp wants to contain :{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
+    int result;
     IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
     IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message->messageHandle);
 
@@ -1097,10 +1300,10 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
     {
     case IOTHUBMESSAGE_BYTEARRAY:
     {
-        result = STRING_construct("{\"body\":\"");
-        if (result == NULL)
+        if (STRING_concat(payload, "{\"body\":\"") != 0)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to STRING_concat");
+            result = __FAILURE__;
         }
         else
         {
@@ -1110,8 +1313,7 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
             if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) != IOTHUB_MESSAGE_OK)
             {
                 LogError("unable to get the data for the message.");
-                STRING_delete(result);
-                result = NULL;
+                result = __FAILURE__;
             }
             else
             {
@@ -1119,28 +1321,27 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
                 if (encoded == NULL)
                 {
                     LogError("unable to Base64_Encode_Bytes.");
-                    STRING_delete(result);
-                    result = NULL;
+                    result = __FAILURE__;
                 }
                 else
                 {
                     size_t propertiesSize;
                     if (!(
-                        (STRING_concat_with_STRING(result, encoded) == 0) &&
-                        (STRING_concat(result, "\"") == 0) && /*\" because closing value*/
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
+                        (STRING_concat_with_STRING(payload, encoded) == 0) &&
+                        (STRING_concat(payload, "\"") == 0) && /*\" because closing value*/
+                        (concat_Properties(payload, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
+                        (STRING_concat(payload, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
                         ))
                     {
-                        STRING_delete(result);
-                        result = NULL;
                         LogError("unable to STRING_concat_with_STRING.");
+                        result = __FAILURE__;
                     }
                     else
                     {
                         /*all is fine... */
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
                         *messageSizeContribution = size + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
+                        result = 0;
                     }
                     STRING_delete(encoded);
                 }
@@ -1151,10 +1352,10 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_057: [If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false}] */
     case IOTHUBMESSAGE_STRING:
     {
-        result = STRING_construct("{\"body\":");
-        if (result == NULL)
+        if (STRING_concat(payload, "{\"body\":") != 0)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to STRING_concat");
+            result = __FAILURE__;
         }
         else
         {
@@ -1162,8 +1363,7 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
             if (source == NULL)
             {
                 LogError("unable to IoTHubMessage_GetString");
-                STRING_delete(result);
-                result = NULL;
+                result = __FAILURE__;
             }
             else
             {
@@ -1171,28 +1371,27 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
                 if (asJson == NULL)
                 {
                     LogError("unable to STRING_new_JSON");
-                    STRING_delete(result);
-                    result = NULL;
+                    result = __FAILURE__;
                 }
                 else
                 {
                     size_t propertiesSize;
                     if (!(
-                        (STRING_concat_with_STRING(result, asJson) == 0) &&
-                        (STRING_concat(result, ",\"base64Encoded\":false") == 0) &&
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
+                        (STRING_concat_with_STRING(payload, asJson) == 0) &&
+                        (STRING_concat(payload, ",\"base64Encoded\":false") == 0) &&
+                        (concat_Properties(payload, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
+                        (STRING_concat(payload, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
                         ))
                     {
                         LogError("unable to STRING_concat_with_STRING");
-                        STRING_delete(result);
-                        result = NULL;
+                        result = __FAILURE__;
                     }
                     else
                     {
-                        /*result has the intended content*/
+                        /*payload has the intended content*/
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
                         *messageSizeContribution = strlen(source) + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
+                        result = 0;
                     }
                     STRING_delete(asJson);
                 }
@@ -1203,13 +1402,19 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
     default:
     {
         LogError("an unknown message type was encountered (%d)", contentType);
-        result = NULL; /*unknown message type*/
+        result = __FAILURE__; /*unknown message type*/
         break;
     }
     }
     return result;
 }
 
+/*drops whatever was appended to payload after its first length characters*/
+static void rollbackPayload(STRING_HANDLE payload, size_t length)
+{
+    ((char*)STRING_c_str(payload))[length] = '\0'; /*TODO - do this in STRING_HANDLE*/
+}
+
 #define MAKE_PAYLOAD_RESULT_VALUES \
     MAKE_PAYLOAD_OK, /*returned when there is a payload to be later send by HTTP*/ \
     MAKE_PAYLOAD_NO_ITEMS, /*returned when there are no items to be send*/ \
@@ -1220,10 +1425,164 @@ DEFINE_ENUM(MAKE_PAYLOAD_RESULT, MAKE_PAYLOAD_RESULT_VALUES);
 
 /*this function assembles several {"body":"base64 encoding of the message content"," base64Encoded": true} into 1 payload*/
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_056: [IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...]]*/
-static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, STRING_HANDLE* payload)
+static bool isBinaryEvent(PDLIST_ENTRY item)
+{
+    IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
+    return (IoTHubMessage_GetContentType(message->messageHandle) == IOTHUBMESSAGE_BYTEARRAY);
+}
+
+static size_t getBatchMaxBytes(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    return ((handleData->batchMaxBytes == 0) || (handleData->batchMaxBytes > MAXIMUM_MESSAGE_SIZE)) ? MAXIMUM_MESSAGE_SIZE : handleData->batchMaxBytes;
+}
+
+/*size of the event in the JSON batch, without its properties*/
+static size_t estimateEventJSONitemSize(PDLIST_ENTRY item)
+{
+    size_t result;
+    IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
+    const unsigned char* source;
+    size_t size;
+    const char* text;
+    if (IoTHubMessage_GetContentType(message->messageHandle) == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        result = MAXIMUM_PAYLOAD_OVERHEAD + ((IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) == IOTHUB_MESSAGE_OK) ? ((size + 2) / 3 * 4) : 0);
+    }
+    else
+    {
+        result = MAXIMUM_PAYLOAD_OVERHEAD + (((text = IoTHubMessage_GetString(message->messageHandle)) != NULL) ? strlen(text) : 0);
+    }
+    return result;
+}
+
+/*size of the content of the event, what "device_quantum" is counted in*/
+static size_t getEventContentSize(PDLIST_ENTRY item)
+{
+    size_t result = 0;
+    IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
+    const unsigned char* source;
+    const char* text;
+    if (IoTHubMessage_GetContentType(message->messageHandle) == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &result) != IOTHUB_MESSAGE_OK)
+        {
+            result = 0;
+        }
+    }
+    else if ((text = IoTHubMessage_GetString(message->messageHandle)) != NULL)
+    {
+        result = strlen(text);
+    }
+    return result;
+}
+
+/*with "device_quantum" every DoWork gives a device with events one more quantum, the device sends only once its oldest event fits*/
+static bool addDeviceQuantum(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    bool result;
+    if (handleData->deviceQuantum == 0)
+    {
+        result = true;
+    }
+    else if (DList_IsListEmpty(deviceData->waitingToSend))
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_046: [ A device with no events to send shall have its deficit set to 0. ]*/
+        deviceData->sendDeficit = 0;
+        result = true;
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_044: [ If "device_quantum" is not 0, each `IoTHubTransportHttp_DoWork` shall add "device_quantum" to the deficit of a device with events to send, up to "device_quantum" plus the content size of its oldest event, and skip the events of the device while that size is larger than the deficit; the deficit left shall be kept for the next `IoTHubTransportHttp_DoWork`. ]*/
+        size_t size = getEventContentSize(deviceData->waitingToSend->Flink);
+        size_t limit = (size > SIZE_MAX - handleData->deviceQuantum) ? SIZE_MAX : (size + handleData->deviceQuantum);
+        deviceData->sendDeficit = (deviceData->sendDeficit > limit - handleData->deviceQuantum) ? limit : (deviceData->sendDeficit + handleData->deviceQuantum);
+        result = (size <= deviceData->sendDeficit);
+    }
+    return result;
+}
+
+/*Codes_SRS_TRANSPORTMULTITHTTP_41_045: [ The content size of the events of a request, sent or not, shall be taken from the deficit, and a batch shall end before an event that does not fit in what is left of it. ]*/
+static void takeFromDeficit(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, size_t size)
+{
+    if (handleData->deviceQuantum != 0)
+    {
+        deviceData->sendDeficit = (size < deviceData->sendDeficit) ? (deviceData->sendDeficit - size) : 0;
+    }
+}
+
+/*a batch is ready when the queued events fill it or when it has lingered "batching_linger_time" seconds*/
+static bool isBatchReady(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    bool result;
+    if (handleData->batchLingerTime == 0)
+    {
+        result = true;
+    }
+    else if (deviceData->batchSplitRemaining != 0)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_042: [ The events of a refused batch shall be sent again without lingering. ]*/
+        result = true;
+    }
+    else
+    {
+        size_t maxBytes = getBatchMaxBytes(handleData);
+        size_t eventCount = 0;
+        size_t batchSize = 0;
+        PDLIST_ENTRY current = deviceData->waitingToSend->Flink;
+        result = false;
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_021: [ If "batching_linger_time" is not 0, the batch shall be sent as soon as the queued events reach "batching_max_events" or "batching_max_bytes", or end before a byte array event when "batching_send_binary_alone" is set. ]*/
+        while (!result && (current != deviceData->waitingToSend))
+        {
+            if (handleData->sendBinaryEventsAlone && (eventCount > 0) && isBinaryEvent(current))
+            {
+                result = true;
+            }
+            else
+            {
+                eventCount++;
+                batchSize += estimateEventJSONitemSize(current);
+                result = ((handleData->batchMaxEvents != 0) && (eventCount >= handleData->batchMaxEvents)) || (batchSize >= maxBytes);
+                current = current->Flink;
+            }
+        }
+
+        if (!result)
+        {
+            time_t timeNow = get_time(NULL);
+            if (timeNow == (time_t)(-1))
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_41_023: [ If the time is not available, the batch shall be sent without lingering. ]*/
+                LogErrorLimited("unable to get_time, the batch is sent without lingering");
+                result = true;
+            }
+            else if (!deviceData->isBatchLingering)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_41_022: [ Otherwise the batch shall wait for more events until "batching_linger_time" seconds have elapsed since the first `IoTHubTransportHttp_DoWork` that held it back. ]*/
+                deviceData->isBatchLingering = true;
+                deviceData->batchLingerStartTime = timeNow;
+            }
+            else
+            {
+                result = (get_difftime(timeNow, deviceData->batchLingerStartTime) >= handleData->batchLingerTime);
+            }
+        }
+
+        if (result)
+        {
+            deviceData->isBatchLingering = false;
+        }
+    }
+    return result;
+}
+
+/*when "batching_send_binary_alone" is set the batch ends before the first byte array event, the first event is never a byte array one*/
+static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, STRING_HANDLE* payload)
 {
     MAKE_PAYLOAD_RESULT result;
     size_t allMessagesSize = 0;
+    size_t eventCount = 0;
+    size_t contentSize = 0; /*only counted with "device_quantum"*/
+    size_t maxBytes = getBatchMaxBytes(handleData);
     *payload = STRING_construct("[");
     if (*payload == NULL)
     {
@@ -1240,86 +1599,98 @@ static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData,
         while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
         {
             size_t messageSize;
-            STRING_HANDLE temp = make1EventJSONitem(actual, &messageSize);
             if (isFirst)
             {
                 isFirst = false;
-                /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                if (temp == NULL) /*first item failed to create, nothing to send*/
+                /*the first item is never rolled back, the whole payload is dropped instead*/
+                if (appendEventJSONitem(*payload, actual, &messageSize) != 0) /*first item failed to create, nothing to send*/
                 {
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
                     result = MAKE_PAYLOAD_ERROR;
                     STRING_delete(*payload);
                     *payload = NULL;
                     keepGoing = false;
                 }
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
+                else if (messageSize > MAXIMUM_MESSAGE_SIZE)
+                {
+                    PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                    DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                    result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
+                    STRING_delete(*payload);
+                    *payload = NULL;
+                    keepGoing = false;
+                }
                 else
                 {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
-                    if (messageSize > MAXIMUM_MESSAGE_SIZE)
+                    /*first item was put nicely in the payload*/
+                    if (handleData->deviceQuantum != 0)
                     {
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
-                        STRING_delete(*payload);
-                        *payload = NULL;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        if (STRING_concat_with_STRING(*payload, temp) != 0)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            result = MAKE_PAYLOAD_ERROR;
-                            STRING_delete(*payload);
-                            *payload = NULL;
-                            keepGoing = false;
-                        }
-                        else
-                        {
-                            /*first item was put nicely in the payload*/
-                            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                            DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                            allMessagesSize += messageSize;
-                        }
+                        contentSize += getEventContentSize(actual);
                     }
-                    STRING_delete(temp);
+                    PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                    DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                    allMessagesSize += messageSize;
+                    eventCount++;
                 }
             }
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_017: [ If "batching_send_binary_alone" is enabled, the batch shall end before the first event of type IOTHUBMESSAGE_BYTEARRAY. ]*/
+            else if (handleData->sendBinaryEventsAlone && isBinaryEvent(actual))
+            {
+                result = MAKE_PAYLOAD_OK;
+                keepGoing = false;
+            }
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_020: [ The batch shall end once it holds "batching_max_events" events. ]*/
+            else if ((handleData->batchMaxEvents != 0) && (eventCount >= handleData->batchMaxEvents))
+            {
+                result = MAKE_PAYLOAD_OK;
+                keepGoing = false;
+            }
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_041: [ While the events of a refused batch are sent again, the batch shall end once it holds half the events of the last batch refused, and never hold events queued after the refused ones. ]*/
+            else if ((deviceData->batchSplitRemaining != 0) && (eventCount >= deviceData->batchSplitMaxEvents))
+            {
+                result = MAKE_PAYLOAD_OK;
+                keepGoing = false;
+            }
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_045: [ The content size of the events of a request, sent or not, shall be taken from the deficit, and a batch shall end before an event that does not fit in what is left of it. ]*/
+            else if ((handleData->deviceQuantum != 0) && (contentSize + getEventContentSize(actual) > deviceData->sendDeficit))
+            {
+                result = MAKE_PAYLOAD_OK;
+                keepGoing = false;
+            }
             else
             {
                 /*there is at least 1 item already in the payload*/
-                if (temp == NULL)
+                size_t payloadLength = STRING_length(*payload);
+                if (appendEventJSONitem(*payload, actual, &messageSize) != 0)
                 {
                     /*there are multiple payloads encoded, the last one had an internal error, just go with those - closing the payload happens "after the loop"*/
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+                    rollbackPayload(*payload, payloadLength);
+                    result = MAKE_PAYLOAD_OK;
+                    keepGoing = false;
+                }
+                /*Codes_SRS_TRANSPORTMULTITHTTP_41_047: [ The batch shall not grow past "batching_max_bytes" bytes (255KB - 1 byte when 0 or larger), the oldest event is always sent. ]*/
+                else if (allMessagesSize + messageSize > maxBytes)
+                {
+                    /*this item doesn't make it to the payload, but the payload is valid so far*/
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+                    rollbackPayload(*payload, payloadLength);
                     result = MAKE_PAYLOAD_OK;
                     keepGoing = false;
                 }
                 else
                 {
-                    if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
+                    /*cool, the payload made it there, let's continue... */
+                    if (handleData->deviceQuantum != 0)
                     {
-                        /*this item doesn't make it to the payload, but the payload is valid so far*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
+                        contentSize += getEventContentSize(actual);
                     }
-                    else if (STRING_concat_with_STRING(*payload, temp) != 0)
-                    {
-                        /*should still send what there is so far...*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        /*cool, the payload made it there, let's continue... */
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        allMessagesSize += messageSize;
-                    }
-                    STRING_delete(temp);
+                    PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                    DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                    allMessagesSize += messageSize;
+                    eventCount++;
                 }
             }
         }
@@ -1328,6 +1699,7 @@ static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData,
         if (result == MAKE_PAYLOAD_OK)
         {
             ((char*)STRING_c_str(*payload))[STRING_length(*payload) - 1] = ']'; /*TODO - do this in STRING_HANDLE*/
+            takeFromDeficit(handleData, deviceData, contentSize);
         }
         else
         {
@@ -1345,6 +1717,118 @@ static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
     DList_InitializeListHead(source);
 }
 
+static size_t countEvents(PDLIST_ENTRY events)
+{
+    size_t result = 0;
+    PDLIST_ENTRY current = events->Flink;
+    while (current != events)
+    {
+        result++;
+        current = current->Flink;
+    }
+    return result;
+}
+
+/*400 and 413 refuse the content of the request: sending the same batch again would be refused again*/
+static bool isBatchRefused(unsigned int statusCode)
+{
+    return (statusCode == 400) || (statusCode == 413);
+}
+
+/*eventCount events of a refused batch have been accepted or failed*/
+static void settleBatchSplit(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, size_t eventCount)
+{
+    if (deviceData->batchSplitRemaining != 0)
+    {
+        deviceData->batchSplitRemaining = (eventCount < deviceData->batchSplitRemaining) ? (deviceData->batchSplitRemaining - eventCount) : 0;
+        if (deviceData->batchSplitMaxEvents > deviceData->batchSplitRemaining)
+        {
+            deviceData->batchSplitMaxEvents = deviceData->batchSplitRemaining;
+        }
+    }
+}
+
+/*the hub refused the batch in eventConfirmations: it is split in halves sent again one after the other, an event refused alone fails*/
+static void splitRefusedBatch(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    size_t eventCount = countEvents(&(deviceData->eventConfirmations));
+    if (eventCount > 1)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_039: [ If the http status code is 400 or 413 for a batch of more than one event, its events shall go back to waitingToSend and be sent again in batches of half its events. ]*/
+        if (deviceData->batchSplitRemaining == 0)
+        {
+            deviceData->batchSplitRemaining = eventCount;
+        }
+        deviceData->batchSplitMaxEvents = eventCount / 2;
+        reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_040: [ If the http status code is 400 or 413 for a batch of one event, IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete with that event and IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+        IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR);
+        settleBatchSplit(deviceData, eventCount);
+    }
+}
+
+static void traceEvents(PDLIST_ENTRY events, IOTHUB_MESSAGE_TRACE_STAGE stage)
+{
+    PDLIST_ENTRY current = events->Flink;
+    while (current != events)
+    {
+        IOTHUB_MESSAGE_LIST* message = containingRecord(current, IOTHUB_MESSAGE_LIST, entry);
+        if (message->traced)
+        {
+            IoTHubClient_LL_TraceMessage(message, stage);
+        }
+        current = current->Flink;
+    }
+}
+
+/*returns the headers of the NonBatched request of the message: the device's template when the message adds no header to it, otherwise a clone of the template that the caller frees*/
+static HTTP_HEADERS_HANDLE getEventOctetStreamHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    HTTP_HEADERS_HANDLE result;
+    if (deviceData->eventOctetStreamHTTPrequestHeaders == NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_076: [A clone of the event HTTP request headers shall be created.]*/
+        if ((deviceData->eventOctetStreamHTTPrequestHeaders = HTTPHeaders_Clone(deviceData->eventHTTPrequestHeaders)) == NULL)
+        {
+            LogError("HTTPHeaders_Clone failed");
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_077: [The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream".] */
+        else if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->eventOctetStreamHTTPrequestHeaders, CONTENT_TYPE, APPLICATION_OCTET_STREAM) != HTTP_HEADERS_OK)
+        {
+            LogError("HTTPHeaders_ReplaceHeaderNameValuePair failed");
+            destroy_eventOctetStreamHTTPrequestHeaders(deviceData);
+        }
+    }
+
+    if (deviceData->eventOctetStreamHTTPrequestHeaders == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        const char*const* keys;
+        const char*const* values;
+        size_t count;
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_024: [ The event HTTP request headers with "Content-Type" set to "application/octet-stream" shall be built once per device and reused by the NonBatched events. ]*/
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_025: [ They shall be cloned only for the messages that have properties, a message id or a correlation id. ]*/
+        if ((Map_GetInternals(IoTHubMessage_Properties(messageHandle), &keys, &values, &count) == MAP_OK) &&
+            (count == 0) &&
+            (IoTHubMessage_GetMessageId(messageHandle) == NULL) &&
+            (IoTHubMessage_GetCorrelationId(messageHandle) == NULL))
+        {
+            result = deviceData->eventOctetStreamHTTPrequestHeaders;
+        }
+        else if ((result = HTTPHeaders_Clone(deviceData->eventOctetStreamHTTPrequestHeaders)) == NULL)
+        {
+            LogError("HTTPHeaders_Clone failed");
+        }
+    }
+    return result;
+}
+
 static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
 
@@ -1355,10 +1839,16 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
     else
     {
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_053: [If option SetBatching is true then _Dowork shall send batched event message as specced below.] */
-        if (handleData->doBatchedTransfers)
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_016: [ If "batching_send_binary_alone" is enabled and the oldest event in waitingToSend has type IOTHUBMESSAGE_BYTEARRAY, _DoWork shall send it as a non batched event. ]*/
+        if (handleData->doBatchedTransfers &&
+            !(handleData->sendBinaryEventsAlone && isBinaryEvent(deviceData->waitingToSend->Flink)))
         {
+            if (!isBatchReady(handleData, deviceData))
+            {
+                /*the events stay in waitingToSend, the batch lingers for more of them*/
+            }
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_054: [Request HTTP headers shall have the value of "Content-Type" created or updated to "application/vnd.microsoft.iothub.json" by a call to HTTPHeaders_ReplaceHeaderNameValuePair.] */
-            if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->eventHTTPrequestHeaders, CONTENT_TYPE, APPLICATION_VND_MICROSOFT_IOTHUB_JSON) != HTTP_HEADERS_OK)
+            else if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->eventHTTPrequestHeaders, CONTENT_TYPE, APPLICATION_VND_MICROSOFT_IOTHUB_JSON) != HTTP_HEADERS_OK)
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_055: [If updating Content-Type fails for any reason, then _DoWork shall advance to the next action.] */
                 LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
@@ -1367,13 +1857,13 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_059: [It shall inspect the "waitingToSend" DLIST passed in config structure.] */
                 STRING_HANDLE payload;
-                switch (makePayload(deviceData, &payload))
+                switch (makePayload(handleData, deviceData, &payload))
                 {
                 case MAKE_PAYLOAD_OK:
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_068: [Once a final payload has been obtained, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters:] */
-                    BUFFER_HANDLE temp = BUFFER_new();
-                    if (temp == NULL)
+                    if ((deviceData->eventBatchBuffer == NULL) &&
+                        ((deviceData->eventBatchBuffer = BUFFER_new()) == NULL))
                     {
                         LogError("unable to BUFFER_new");
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
@@ -1381,7 +1871,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                     }
                     else
                     {
-                        if (BUFFER_build(temp, (const unsigned char*)STRING_c_str(payload), STRING_length(payload)) != 0)
+                        if (BUFFER_build(deviceData->eventBatchBuffer, (const unsigned char*)STRING_c_str(payload), STRING_length(payload)) != 0)
                         {
                             LogError("unable to BUFFER_build");
                             //items go back to waitingToSend
@@ -1391,40 +1881,78 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                         else
                         {
                             unsigned int statusCode;
-                            if (HTTPAPIEX_SAS_ExecuteRequest(
-                                deviceData->sasObject,
-                                handleData->httpApiExHandle,
-                                HTTPAPI_REQUEST_POST,
-                                STRING_c_str(deviceData->eventHTTPrelativePath),
-                                deviceData->eventHTTPrequestHeaders,
-                                temp,
-                                &statusCode,
-                                NULL,
-                                NULL
-                                ) != HTTPAPIEX_OK)
+                            STRING_HANDLE sasToken;
+                            HTTPAPIEX_RESULT r;
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_41_001: [IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT for the traced messages of the request before executing it.] */
+                            traceEvents(&(deviceData->eventConfirmations), IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT);
+                            if ((sasToken = getDeviceSasToken(handleData, deviceData)) != NULL)
+                            {
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
+                                if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->eventHTTPrequestHeaders, "Authorization", STRING_c_str(sasToken)) != HTTP_HEADERS_OK)
+                                {
+                                    LogError("Unable to replace the old SAS Token.");
+                                    r = HTTPAPIEX_ERROR;
+                                }
+                                else
+                                {
+                                    r = HTTPAPIEX_ExecuteRequest(
+                                        handleData->httpApiExHandle,
+                                        HTTPAPI_REQUEST_POST,
+                                        STRING_c_str(deviceData->eventHTTPrelativePath),
+                                        deviceData->eventHTTPrequestHeaders,
+                                        deviceData->eventBatchBuffer,
+                                        &statusCode,
+                                        NULL,
+                                        NULL
+                                        );
+                                }
+                            }
+                            else
+                            {
+                                r = HTTPAPIEX_SAS_ExecuteRequest(
+                                    deviceData->sasObject,
+                                    handleData->httpApiExHandle,
+                                    HTTPAPI_REQUEST_POST,
+                                    STRING_c_str(deviceData->eventHTTPrelativePath),
+                                    deviceData->eventHTTPrequestHeaders,
+                                    deviceData->eventBatchBuffer,
+                                    &statusCode,
+                                    NULL,
+                                    NULL
+                                    );
+                            }
+                            if (r != HTTPAPIEX_OK)
                             {
-                                LogError("unable to HTTPAPIEX_ExecuteRequest");
+                                LogErrorLimited("unable to HTTPAPIEX_ExecuteRequest");
                                 //items go back to waitingToSend
                                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
                                 reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                             }
                             else
                             {
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_41_002: [If the request is executed, IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN for the traced messages of the request.] */
+                                traceEvents(&(deviceData->eventConfirmations), IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
                                 if (statusCode < 300)
                                 {
+                                    size_t eventCount = countEvents(&(deviceData->eventConfirmations));
                                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
                                     IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK);
+                                    settleBatchSplit(deviceData, eventCount);
+                                }
+                                else if (isBatchRefused(statusCode))
+                                {
+                                    LogErrorLimited("batch refused with HTTP status code (%u)", statusCode);
+                                    splitRefusedBatch(deviceData, iotHubClientHandle);
                                 }
                                 else
                                 {
                                     //items go back to waitingToSend
                                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                    LogError("unexpected HTTP status code (%u)", statusCode);
+                                    LogErrorLimited("unexpected HTTP status code (%u)", statusCode);
                                     reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                                 }
                             }
                         }
-                        BUFFER_delete(temp);
                     }
                     STRING_delete(payload);
                     break;
@@ -1432,6 +1960,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                 case MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT:
                 {
                     IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
+                    settleBatchSplit(deviceData, 1);
                     break;
                 }
                 case MAKE_PAYLOAD_ERROR:
@@ -1479,6 +2008,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             }
             else
             {
+                takeFromDeficit(handleData, deviceData, originalMessageSize);
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_075: [If the oldest message in waitingToSend causes the message to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_072: [The message size shall be limited to 255KB -1 bytes.] */
                 if (messageSize > MAXIMUM_MESSAGE_SIZE)
@@ -1490,190 +2020,194 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                 else
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_071: [If option SetBatching is false then _Dowork shall send individual event message as specced below.] */
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_076: [A clone of the event HTTP request headers shall be created.]*/
-                    HTTP_HEADERS_HANDLE clonedEventHTTPrequestHeaders = HTTPHeaders_Clone(deviceData->eventHTTPrequestHeaders);
-                    if (clonedEventHTTPrequestHeaders == NULL)
+                    HTTP_HEADERS_HANDLE eventRequestHttpHeaders = getEventOctetStreamHTTPrequestHeaders(deviceData, message->messageHandle);
+                    if (eventRequestHttpHeaders == NULL)
                     {
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                        LogError("HTTPHeaders_Clone failed");
+                        LogError("unable to get the event HTTP request headers");
                     }
                     else
                     {
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_077: [The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream".] */
-                        if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, CONTENT_TYPE, APPLICATION_OCTET_STREAM) != HTTP_HEADERS_OK)
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_078: [Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value".] */
+                        MAP_HANDLE map = IoTHubMessage_Properties(message->messageHandle);
+                        const char*const* keys;
+                        const char*const* values;
+                        size_t count;
+                        if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
                         {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                            LogError("HTTPHeaders_ReplaceHeaderNameValuePair failed");
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_078: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
+                            LogError("unable to Map_GetInternals");
                         }
                         else
                         {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_078: [Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value".] */
-                            MAP_HANDLE map = IoTHubMessage_Properties(message->messageHandle);
-                            const char*const* keys;
-                            const char*const* values;
-                            size_t count;
-                            if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
-                            {
-                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_078: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                                LogError("unable to Map_GetInternals");
-                            }
-                            else
-                            {
-                                size_t i;
-                                bool goOn = true;
-                                const char* msgId;
-                                const char* corrId;
+                            size_t i;
+                            bool goOn = true;
+                            const char* msgId;
+                            const char* corrId;
 
-                                for (i = 0; (i < count) && goOn; i++)
+                            for (i = 0; (i < count) && goOn; i++)
+                            {
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_074: [Every property name shall add  to the message size the length of the property name + the length of the property value + 16 bytes.] */
+                                messageSize += (strlen(values[i]) + strlen(keys[i]) + MAXIMUM_PROPERTY_OVERHEAD);
+                                if (messageSize > MAXIMUM_MESSAGE_SIZE)
                                 {
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_074: [Every property name shall add  to the message size the length of the property name + the length of the property value + 16 bytes.] */
-                                    messageSize += (strlen(values[i]) + strlen(keys[i]) + MAXIMUM_PROPERTY_OVERHEAD);
-                                    if (messageSize > MAXIMUM_MESSAGE_SIZE)
+                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_072: [The message size shall be limited to 255KB -1 bytes.] */
+                                    PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                                    DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
+                                    goOn = false;
+                                }
+                                else
+                                {
+                                    STRING_HANDLE temp = STRING_construct(IOTHUB_APP_PREFIX);
+                                    if (temp == NULL)
                                     {
-                                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_072: [The message size shall be limited to 255KB -1 bytes.] */
-                                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                                        IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR); /*takes care of emptying the list too*/
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
+                                        LogError("unable to STRING_construct");
                                         goOn = false;
                                     }
                                     else
                                     {
-                                        STRING_HANDLE temp = STRING_construct(IOTHUB_APP_PREFIX);
-                                        if (temp == NULL)
+                                        if (STRING_concat(temp, keys[i]) != 0)
                                         {
                                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                                            LogError("unable to STRING_construct");
+                                            LogError("unable to STRING_concat");
                                             goOn = false;
                                         }
                                         else
                                         {
-                                            if (STRING_concat(temp, keys[i]) != 0)
+                                            if (HTTPHeaders_ReplaceHeaderNameValuePair(eventRequestHttpHeaders, STRING_c_str(temp), values[i]) != HTTP_HEADERS_OK)
                                             {
                                                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                                                LogError("unable to STRING_concat");
+                                                LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
                                                 goOn = false;
                                             }
-                                            else
-                                            {
-                                                if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, STRING_c_str(temp), values[i]) != HTTP_HEADERS_OK)
-                                                {
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                                                    LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
-                                                    goOn = false;
-                                                }
-                                            }
-                                            STRING_delete(temp);
                                         }
+                                        STRING_delete(temp);
                                     }
                                 }
+                            }
 
-                                // Add the Message Id and the Correlation Id
-                                msgId = IoTHubMessage_GetMessageId(message->messageHandle);
-                                if (goOn && msgId != NULL)
+                            // Add the Message Id and the Correlation Id
+                            msgId = IoTHubMessage_GetMessageId(message->messageHandle);
+                            if (goOn && msgId != NULL)
+                            {
+                                if (HTTPHeaders_ReplaceHeaderNameValuePair(eventRequestHttpHeaders, IOTHUB_MESSAGE_ID, msgId) != HTTP_HEADERS_OK)
                                 {
-                                    if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, IOTHUB_MESSAGE_ID, msgId) != HTTP_HEADERS_OK)
-                                    {
-                                        LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
-                                        goOn = false;
-                                    }
+                                    LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
+                                    goOn = false;
                                 }
+                            }
 
-                                corrId = IoTHubMessage_GetCorrelationId(message->messageHandle);
-                                if (goOn && corrId != NULL)
+                            corrId = IoTHubMessage_GetCorrelationId(message->messageHandle);
+                            if (goOn && corrId != NULL)
+                            {
+                                if (HTTPHeaders_ReplaceHeaderNameValuePair(eventRequestHttpHeaders, IOTHUB_CORRELATION_ID, corrId) != HTTP_HEADERS_OK)
                                 {
-                                    if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, IOTHUB_CORRELATION_ID, corrId) != HTTP_HEADERS_OK)
-                                    {
-                                        LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
-                                        goOn = false;
-                                    }
+                                    LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
+                                    goOn = false;
                                 }
+                            }
 
-                                if (!goOn)
+                            if (!goOn)
+                            {
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
+                            }
+                            else
+                            {
+                                BUFFER_HANDLE toBeSend = BUFFER_new();
+                                if (toBeSend == NULL)
                                 {
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
+                                    LogError("unable to BUFFER_new");
                                 }
                                 else
                                 {
-                                    BUFFER_HANDLE toBeSend = BUFFER_new();
-                                    if (toBeSend == NULL)
+                                    if (BUFFER_build(toBeSend, messageContent, originalMessageSize) != 0)
                                     {
-                                        LogError("unable to BUFFER_new");
+                                        LogError("unable to BUFFER_build");
                                     }
                                     else
                                     {
-                                        if (BUFFER_build(toBeSend, messageContent, originalMessageSize) != 0)
+                                        unsigned int statusCode = 0;
+                                        HTTPAPIEX_RESULT r;
+                                        STRING_HANDLE sasToken;
+                                        if (message->traced)
                                         {
-                                            LogError("unable to BUFFER_build");
+                                            /*Codes_SRS_TRANSPORTMULTITHTTP_41_001: [IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT for the traced messages of the request before executing it.] */
+                                            IoTHubClient_LL_TraceMessage(message, IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT);
                                         }
-                                        else
+                                        if ((sasToken = getDeviceSasToken(handleData, deviceData)) != NULL)
                                         {
-                                            unsigned int statusCode = 0;
-                                            HTTPAPIEX_RESULT r;
-                                            if (deviceData->deviceSasToken != NULL)
+                                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
+                                            if (HTTPHeaders_ReplaceHeaderNameValuePair(eventRequestHttpHeaders, "Authorization", STRING_c_str(sasToken)) != HTTP_HEADERS_OK)
                                             {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                                                if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, "Authorization", STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
-                                                {
-                                                    r = HTTPAPIEX_ERROR;
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
-                                                    LogError("Unable to replace the old SAS Token.");
-                                                }
+                                                r = HTTPAPIEX_ERROR;
+                                                /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
+                                                LogError("Unable to replace the old SAS Token.");
+                                            }
 
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_03_003: [If a deviceSasToken exists, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_ExecuteRequest passing the following parameters] */
-                                                else if ((r = HTTPAPIEX_ExecuteRequest(
-                                                    handleData->httpApiExHandle,
-                                                    HTTPAPI_REQUEST_POST,
-                                                    STRING_c_str(deviceData->eventHTTPrelativePath),
-                                                    clonedEventHTTPrequestHeaders,
-                                                    toBeSend,
-                                                    &statusCode,
-                                                    NULL,
-                                                    NULL
-                                                    )) != HTTPAPIEX_OK)
-                                                {
-                                                    LogError("Unable to HTTPAPIEX_ExecuteRequest.");
-                                                }
+                                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_003: [If a deviceSasToken exists, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_ExecuteRequest passing the following parameters] */
+                                            else if ((r = HTTPAPIEX_ExecuteRequest(
+                                                handleData->httpApiExHandle,
+                                                HTTPAPI_REQUEST_POST,
+                                                STRING_c_str(deviceData->eventHTTPrelativePath),
+                                                eventRequestHttpHeaders,
+                                                toBeSend,
+                                                &statusCode,
+                                                NULL,
+                                                NULL
+                                                )) != HTTPAPIEX_OK)
+                                            {
+                                                LogErrorLimited("Unable to HTTPAPIEX_ExecuteRequest.");
                                             }
-                                            else
+                                        }
+                                        else
+                                        {
+                                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_080: [If a deviceSasToken does not exist, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters] */
+                                            if ((r = HTTPAPIEX_SAS_ExecuteRequest(
+                                                deviceData->sasObject,
+                                                handleData->httpApiExHandle,
+                                                HTTPAPI_REQUEST_POST,
+                                                STRING_c_str(deviceData->eventHTTPrelativePath),
+                                                eventRequestHttpHeaders,
+                                                toBeSend,
+                                                &statusCode,
+                                                NULL,
+                                                NULL
+                                                )) != HTTPAPIEX_OK)
                                             {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_080: [If a deviceSasToken does not exist, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters] */
-                                                if ((r = HTTPAPIEX_SAS_ExecuteRequest(
-                                                    deviceData->sasObject,
-                                                    handleData->httpApiExHandle,
-                                                    HTTPAPI_REQUEST_POST,
-                                                    STRING_c_str(deviceData->eventHTTPrelativePath),
-                                                    clonedEventHTTPrequestHeaders,
-                                                    toBeSend,
-                                                    &statusCode,
-                                                    NULL,
-                                                    NULL
-                                                    )) != HTTPAPIEX_OK)
-                                                {
-                                                    LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
-                                                }
+                                                LogErrorLimited("unable to HTTPAPIEX_SAS_ExecuteRequest");
                                             }
-                                            if (r == HTTPAPIEX_OK)
+                                        }
+                                        if (r == HTTPAPIEX_OK)
+                                        {
+                                            if (message->traced)
                                             {
-                                                if (statusCode < 300)
-                                                {
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_082: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend.] */
-                                                    PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                                                    DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
-                                                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK); /*takes care of emptying the list too*/
-                                                }
-                                                else
-                                                {
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_081: [If HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                                    LogError("unexpected HTTP status code (%u)", statusCode);
-                                                }
+                                                /*Codes_SRS_TRANSPORTMULTITHTTP_41_002: [If the request is executed, IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN for the traced messages of the request.] */
+                                                IoTHubClient_LL_TraceMessage(message, IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
+                                            }
+                                            if (statusCode < 300)
+                                            {
+                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_082: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend.] */
+                                                PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                                                DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
+                                                IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK); /*takes care of emptying the list too*/
+                                            }
+                                            else
+                                            {
+                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_081: [If HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
+                                                LogErrorLimited("unexpected HTTP status code (%u)", statusCode);
                                             }
                                         }
-                                        BUFFER_delete(toBeSend);
                                     }
+                                    BUFFER_delete(toBeSend);
                                 }
                             }
                         }
-                        HTTPHeaders_Free(clonedEventHTTPrequestHeaders);
+                        if (eventRequestHttpHeaders != deviceData->eventOctetStreamHTTPrequestHeaders)
+                        {
+                            HTTPHeaders_Free(eventRequestHttpHeaders);
+                        }
                     }
                 }
             }
@@ -1681,7 +2215,8 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
     }
 }
 
-static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, const char* ETag, IOTHUBMESSAGE_DISPOSITION_RESULT action)
+/*sharedRequestHttpHeaders is NULL when the request is built for this disposition only, otherwise it already has the User-Agent and Authorization headers and only If-Match is replaced*/
+static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, HTTP_HEADERS_HANDLE sharedRequestHttpHeaders, const char* ETag, IOTHUBMESSAGE_DISPOSITION_RESULT action)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_097: [_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest with the following parameters:
     -requestType: POST
@@ -1750,7 +2285,7 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
             }
             else
             {
-                HTTP_HEADERS_HANDLE abandonRequestHttpHeaders = HTTPHeaders_Alloc();
+                HTTP_HEADERS_HANDLE abandonRequestHttpHeaders = (sharedRequestHttpHeaders != NULL) ? sharedRequestHttpHeaders : HTTPHeaders_Alloc();
                 if (abandonRequestHttpHeaders == NULL)
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_098: [Abandoning the message is considered successful if the HTTPAPIEX_SAS_ExecuteRequest doesn't fail and the statusCode is 204.]*/
@@ -1761,11 +2296,13 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                 }
                 else
                 {
-                    if (!(
+                    if (!((sharedRequestHttpHeaders != NULL) ?
+                        (HTTPHeaders_ReplaceHeaderNameValuePair(abandonRequestHttpHeaders, "If-Match", ETag) == HTTP_HEADERS_OK) :
+                        (
                         (addUserAgentHeaderInfo(deviceData->iotHubClientHandle, abandonRequestHttpHeaders) == HTTP_HEADERS_OK) &&
                         (HTTPHeaders_AddHeaderNameValuePair(abandonRequestHttpHeaders, "Authorization", " ") == HTTP_HEADERS_OK) &&
                         (HTTPHeaders_AddHeaderNameValuePair(abandonRequestHttpHeaders, "If-Match", ETag) == HTTP_HEADERS_OK)
-                        ))
+                        )))
                     {
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_098: [Abandoning the message is considered successful if the HTTPAPIEX_SAS_ExecuteRequest doesn't fail and the statusCode is 204.]*/
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_100: [Accepting a message is successful when HTTPAPIEX_SAS_ExecuteRequest completes successfully and the status code is 204.] */
@@ -1777,10 +2314,11 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                     {
                         unsigned int statusCode = 0;
                         HTTPAPIEX_RESULT r;
-                        if (deviceData->deviceSasToken != NULL)
+                        STRING_HANDLE sasToken;
+                        if ((sasToken = getDeviceSasToken(handleData, deviceData)) != NULL)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                            if (HTTPHeaders_ReplaceHeaderNameValuePair(abandonRequestHttpHeaders, "Authorization", STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
+                            if (HTTPHeaders_ReplaceHeaderNameValuePair(abandonRequestHttpHeaders, "Authorization", STRING_c_str(sasToken)) != HTTP_HEADERS_OK)
                             {
                                 r = HTTPAPIEX_ERROR;
                                 /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
@@ -1847,7 +2385,10 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                             result = false;
                         }
                     }
-                    HTTPHeaders_Free(abandonRequestHttpHeaders);
+                    if (sharedRequestHttpHeaders == NULL)
+                    {
+                        HTTPHeaders_Free(abandonRequestHttpHeaders);
+                    }
                 }
             }
             STRING_delete(ETagUnquoted);
@@ -1893,14 +2434,35 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SendMessageDisposition(MESSAGE_C
                 }
                 else
                 {
-                    if (abandonOrAcceptMessage(tc->handleData, tc->deviceData, tc->etagValue, disposition))
+                    PENDING_DISPOSITION* pendingDisposition;
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_41_007: [ If "c2d_defer_disposition" is enabled, IoTHubTransportHttp_SendMessageDisposition shall queue the disposition for the next IoTHubTransportHttp_DoWork of the device and return IOTHUB_CLIENT_OK. ]*/
+                    if (tc->handleData->deferC2DDisposition &&
+                        ((pendingDisposition = (PENDING_DISPOSITION*)malloc(sizeof(PENDING_DISPOSITION))) != NULL))
+                    {
+                        pendingDisposition->next = NULL;
+                        pendingDisposition->etagValue = tc->etagValue; /*ownership of the ETag moves to the queue*/
+                        pendingDisposition->action = disposition;
+                        if (tc->deviceData->pendingDispositionsTail == NULL)
+                        {
+                            tc->deviceData->pendingDispositionsHead = pendingDisposition;
+                        }
+                        else
+                        {
+                            tc->deviceData->pendingDispositionsTail->next = pendingDisposition;
+                        }
+                        tc->deviceData->pendingDispositionsTail = pendingDisposition;
+                        tc->etagValue = NULL;
+                        result = IOTHUB_CLIENT_OK;
+                    }
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_41_008: [ If queuing the disposition fails, IoTHubTransportHttp_SendMessageDisposition shall send it right away. ]*/
+                    else if (abandonOrAcceptMessage(tc->handleData, tc->deviceData, NULL, tc->etagValue, disposition))
                     {
                         result = IOTHUB_CLIENT_OK;
                     }
                     else
                     {
                         /* Codes_SRS_TRANSPORTMULTITHTTP_10_003: [IoTHubTransportHttp_SendMessageDisposition shall fail and return IOTHUB_CLIENT_ERROR if the POST message fails, otherwise return IOTHUB_CLIENT_OK.] */
-                        LogError("HTTP Transport layer failed to report %s disposition", ENUM_TO_STRING(IOTHUBMESSAGE_DISPOSITION_RESULT, disposition));
+                        LogErrorLimited("HTTP Transport layer failed to report %s disposition", ENUM_TO_STRING(IOTHUBMESSAGE_DISPOSITION_RESULT, disposition));
                         result = IOTHUB_CLIENT_ERROR;
                     }
                 }
@@ -1914,6 +2476,47 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SendMessageDisposition(MESSAGE_C
     return result;
 }
 
+static void flushPendingDispositions(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    if (deviceData->pendingDispositionsHead != NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_009: [ Before the "ExecuteMessage" action, IoTHubTransportHttp_DoWork shall send the queued dispositions of the device in the order they were given, all of them reusing one HTTP headers instance with the User-Agent and Authorization headers and replacing only If-Match. ]*/
+        HTTP_HEADERS_HANDLE requestHttpHeaders = HTTPHeaders_Alloc();
+        if (requestHttpHeaders == NULL)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_010: [ If building the HTTP headers instance fails, the dispositions shall stay queued for the next IoTHubTransportHttp_DoWork. ]*/
+            LogError("unable to HTTPHeaders_Alloc, the %s dispositions stay queued", STRING_c_str(deviceData->deviceId));
+        }
+        else
+        {
+            if (!(
+                (addUserAgentHeaderInfo(deviceData->iotHubClientHandle, requestHttpHeaders) == HTTP_HEADERS_OK) &&
+                (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "Authorization", " ") == HTTP_HEADERS_OK)
+                ))
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_41_010: [ If building the HTTP headers instance fails, the dispositions shall stay queued for the next IoTHubTransportHttp_DoWork. ]*/
+                LogError("unable to HTTPHeaders_AddHeaderNameValuePair, the %s dispositions stay queued", STRING_c_str(deviceData->deviceId));
+            }
+            else
+            {
+                while (deviceData->pendingDispositionsHead != NULL)
+                {
+                    PENDING_DISPOSITION* pendingDisposition = deviceData->pendingDispositionsHead;
+                    deviceData->pendingDispositionsHead = pendingDisposition->next;
+                    if (!abandonOrAcceptMessage(handleData, deviceData, requestHttpHeaders, pendingDisposition->etagValue, pendingDisposition->action))
+                    {
+                        LogErrorLimited("HTTP Transport layer failed to report %s disposition", ENUM_TO_STRING(IOTHUBMESSAGE_DISPOSITION_RESULT, pendingDisposition->action));
+                    }
+                    free(pendingDisposition->etagValue);
+                    free(pendingDisposition);
+                }
+                deviceData->pendingDispositionsTail = NULL;
+            }
+            HTTPHeaders_Free(requestHttpHeaders);
+        }
+    }
+}
+
 static MESSAGE_CALLBACK_INFO* MESSAGE_CALLBACK_INFO_Create(IOTHUB_MESSAGE_HANDLE received_message, HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, const char* etagValue)
 {
     MESSAGE_CALLBACK_INFO* result = (MESSAGE_CALLBACK_INFO*)malloc(sizeof(MESSAGE_CALLBACK_INFO));
@@ -1965,6 +2568,21 @@ static MESSAGE_CALLBACK_INFO* MESSAGE_CALLBACK_INFO_Create(IOTHUB_MESSAGE_HANDLE
     return result;
 }
 
+static unsigned int getPollingInterval(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    return (deviceData->pollingInterval > handleData->getMinimumPollingTime) ? deviceData->pollingInterval : handleData->getMinimumPollingTime;
+}
+
+/*Codes_SRS_TRANSPORTMULTITHTTP_41_027: [ If "c2d_polling_backoff_max" is not 0, every GET that finds no message shall double the time until the next GET, starting from GetMinimumPollingTime, up to "c2d_polling_backoff_max" seconds. ]*/
+static void backOffPollingInterval(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    unsigned int pollingInterval = getPollingInterval(handleData, deviceData);
+    deviceData->pollingInterval =
+        (pollingInterval == 0) ? 1 :
+        (pollingInterval > handleData->c2dPollingBackoffMax / 2) ? handleData->c2dPollingBackoffMax :
+        (pollingInterval * 2);
+}
+
 static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_083: [ If device is not subscribed then _DoWork shall advance to the next action. ] */
@@ -1974,7 +2592,8 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
         time_t timeNow = get_time(NULL);
-        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime);
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_004: [ The GET following a GET that returned a message shall be allowed no matter what the value of GetMinimumPollingTime. ]*/
+        bool isPollingAllowed = deviceData->isFirstPoll || deviceData->isNextPollAllowed || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > getPollingInterval(handleData, deviceData));
         if (isPollingAllowed)
         {
             HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
@@ -1995,10 +2614,11 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                 {
                     unsigned int statusCode = 0;
                     HTTPAPIEX_RESULT r;
-                    if (deviceData->deviceSasToken != NULL)
+                    STRING_HANDLE sasToken;
+                    if ((sasToken = getDeviceSasToken(handleData, deviceData)) != NULL)
                     {
                         /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                        if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->messageHTTPrequestHeaders, "Authorization", STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
+                        if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->messageHTTPrequestHeaders, "Authorization", STRING_c_str(sasToken)) != HTTP_HEADERS_OK)
                         {
                             r = HTTPAPIEX_ERROR;
                             /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
@@ -2016,7 +2636,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                             )) != HTTPAPIEX_OK)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
-                            LogError("Unable to HTTPAPIEX_ExecuteRequest.");
+                            LogErrorLimited("Unable to HTTPAPIEX_ExecuteRequest.");
                         }
                     }
 
@@ -2042,7 +2662,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                         )) != HTTPAPIEX_OK)
                     {
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
-                        LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
+                        LogErrorLimited("unable to HTTPAPIEX_SAS_ExecuteRequest");
                     }
                     if (r == HTTPAPIEX_OK)
                     {
@@ -2056,6 +2676,20 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                             deviceData->isFirstPoll = false;
                             deviceData->lastPollTime = timeNow;
                         }
+                        /*a message was waiting, the next one might be too: poll again at the next DoWork instead of waiting GetMinimumPollingTime*/
+                        deviceData->isNextPollAllowed = (handleData->pollC2DUntilEmpty || (handleData->c2dPollingBackoffMax != 0)) && (statusCode == 200);
+                        if (handleData->c2dPollingBackoffMax != 0)
+                        {
+                            if (statusCode == 204)
+                            {
+                                backOffPollingInterval(handleData, deviceData);
+                            }
+                            else if (statusCode == 200)
+                            {
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_41_028: [ If "c2d_polling_backoff_max" is not 0, a GET that returns a message shall allow the next GET at the next IoTHubTransportHttp_DoWork and bring the time between GETs back to GetMinimumPollingTime. ]*/
+                                deviceData->pollingInterval = 0;
+                            }
+                        }
                         if (statusCode == 204)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
@@ -2066,7 +2700,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                         else if (statusCode != 200)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
-                            LogError("expected status code was 200, but actually was received %u... moving on", statusCode);
+                            LogErrorLimited("expected status code was 200, but actually was received %u... moving on", statusCode);
                         }
                         else
                         {
@@ -2100,7 +2734,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                     {
                                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_092: [If assembling the message fails in any way, then _DoWork shall "abandon" the message.]*/
                                         LogError("unable to IoTHubMessage_CreateFromByteArray, trying to abandon the message... ");
-                                        if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                        if (!abandonOrAcceptMessage(handleData, deviceData, NULL, etagValue, IOTHUBMESSAGE_ABANDONED))
                                         {
                                             LogError("HTTP Transport layer failed to report ABANDON disposition");
                                         }
@@ -2113,7 +2747,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                         if (HTTPHeaders_GetHeaderCount(responseHTTPHeaders, &nHeaders) != HTTP_HEADERS_OK)
                                         {
                                             LogError("unable to get the count of HTTP headers");
-                                            if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                            if (!abandonOrAcceptMessage(handleData, deviceData, NULL, etagValue, IOTHUBMESSAGE_ABANDONED))
                                             {
                                                 LogError("HTTP Transport layer failed to report ABANDON disposition");
                                             }
@@ -2178,7 +2812,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
 
                                             if (i < nHeaders)
                                             {
-                                                if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                                if (!abandonOrAcceptMessage(handleData, deviceData, NULL, etagValue, IOTHUBMESSAGE_ABANDONED))
                                                 {
                                                     LogError("HTTP Transport layer failed to report ABANDON disposition");
                                                 }
@@ -2190,7 +2824,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                                 {
                                                     /*Codes_SRS_TRANSPORTMULTITHTTP_10_006: [If assembling the transport context fails, _DoWork shall "abandon" the message.] */
                                                     LogError("failed to assemble callback info");
-                                                    if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                                    if (!abandonOrAcceptMessage(handleData, deviceData, NULL, etagValue, IOTHUBMESSAGE_ABANDONED))
                                                     {
                                                         LogError("HTTP Transport layer failed to report ABANDON disposition");
                                                     }
@@ -2235,7 +2869,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
     }
 }
 
-static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportHttp_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportHttp_ProcessItem(IOTHUB_DEVICE_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
 {
     (void)handle;
     (void)item_type;
@@ -2258,14 +2892,26 @@ static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_052: [ IoTHubTransportHttp_DoWork shall perform a round-robin loop through every deviceHandle in the transport device list, using the iotHubClientHandle field saved in the IOTHUB_DEVICE_HANDLE. ]*/
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_050: [ IoTHubTransportHttp_DoWork shall call loop through the device list. ] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_051: [ IF the list is empty, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_005: [ Each call to IoTHubTransportHttp_DoWork shall start the loop one device after the device the previous call started with, so a device whose requests are slow does not always delay the same devices. ]*/
+        size_t firstDeviceIndex = (deviceListSize == 0) ? 0 : (handleData->firstDeviceIndex % deviceListSize);
         for (size_t i = 0; i < deviceListSize; i++)
         {
-            listItem = (IOTHUB_DEVICE_HANDLE *) VECTOR_element(handleData->perDeviceList, i);
+            listItem = (IOTHUB_DEVICE_HANDLE *) VECTOR_element(handleData->perDeviceList, (firstDeviceIndex + i) % deviceListSize);
             HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
-            DoEvent(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_029: [ If "c2d_polling_backoff_max" is not 0, a device with events to send shall bring the time between its GETs back to GetMinimumPollingTime. ]*/
+            if ((handleData->c2dPollingBackoffMax != 0) && !DList_IsListEmpty(perDeviceItem->waitingToSend))
+            {
+                perDeviceItem->pollingInterval = 0;
+            }
+            if (addDeviceQuantum(handleData, perDeviceItem))
+            {
+                DoEvent(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
+            }
+            flushPendingDispositions(handleData, perDeviceItem);
             DoMessages(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
 
         }
+        handleData->firstDeviceIndex = firstDeviceIndex + 1;
     }
     else
     {
@@ -2273,6 +2919,105 @@ static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
     }
 }
 
+/*milliseconds from timeNow until seconds after since, clamped below IOTHUB_CLIENT_NO_WORK_DEADLINE*/
+static uint32_t msUntil(time_t timeNow, time_t since, double seconds)
+{
+    double msLeft = (seconds - get_difftime(timeNow, since)) * 1000;
+    return (msLeft <= 0) ? 0 :
+        (msLeft >= (double)IOTHUB_CLIENT_NO_WORK_DEADLINE) ? (IOTHUB_CLIENT_NO_WORK_DEADLINE - 1) :
+        (uint32_t)msLeft;
+}
+
+static uint32_t getDeviceWorkDeadline(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, time_t timeNow)
+{
+    uint32_t result = IOTHUB_CLIENT_NO_WORK_DEADLINE;
+    uint32_t deadline;
+    if (!DList_IsListEmpty(deviceData->waitingToSend))
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_032: [ A device with queued events shall have a deadline of 0, or the end of "batching_linger_time" while its batch lingers. ]*/
+        result = ((handleData->batchLingerTime != 0) && deviceData->isBatchLingering) ?
+            msUntil(timeNow, deviceData->batchLingerStartTime, handleData->batchLingerTime) : 0;
+    }
+
+    if (deviceData->pendingDispositionsHead != NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_033: [ A device with queued dispositions shall have a deadline of 0. ]*/
+        result = 0;
+    }
+
+    if (deviceData->DoWork_PullMessage)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_034: [ A device subscribed to messages shall have a deadline no later than its next allowed GET. ]*/
+        deadline = (deviceData->isFirstPoll || deviceData->isNextPollAllowed) ? 0 :
+            msUntil(timeNow, deviceData->lastPollTime, (double)getPollingInterval(handleData, deviceData) + 1);
+        if (deadline < result)
+        {
+            result = deadline;
+        }
+    }
+    return result;
+}
+
+static uint32_t IoTHubTransportHttp_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, bool* isWaitingForNetwork)
+{
+    uint32_t result;
+    if ((handle == NULL) || (isWaitingForNetwork == NULL))
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_030: [ If handle or isWaitingForNetwork is NULL, IoTHubTransportHttp_GetNextWorkDeadline shall return 0. ]*/
+        LogError("Invalid argument handle=%p, isWaitingForNetwork=%p", handle, isWaitingForNetwork);
+        result = 0;
+    }
+    else
+    {
+        HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
+        time_t timeNow = get_time(NULL);
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_031: [ IoTHubTransportHttp_GetNextWorkDeadline shall set isWaitingForNetwork to false, the requests of IoTHubTransportHttp_DoWork complete before it returns. ]*/
+        *isWaitingForNetwork = false;
+        if (timeNow == (time_t)(-1))
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_035: [ If the time is not available, IoTHubTransportHttp_GetNextWorkDeadline shall return 0. ]*/
+            LogErrorLimited("unable to get_time");
+            result = 0;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_036: [ IoTHubTransportHttp_GetNextWorkDeadline shall return the earliest deadline of the devices in the transport device list, IOTHUB_CLIENT_NO_WORK_DEADLINE if the list is empty. ]*/
+            size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+            result = IOTHUB_CLIENT_NO_WORK_DEADLINE;
+            for (size_t i = 0; (i < deviceListSize) && (result != 0); i++)
+            {
+                HTTPTRANSPORT_PERDEVICE_DATA* deviceData = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i);
+                uint32_t deadline = getDeviceWorkDeadline(handleData, deviceData, timeNow);
+                if (deadline < result)
+                {
+                    result = deadline;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static void IoTHubTransportHttp_TrimMemory(TRANSPORT_LL_HANDLE handle)
+{
+    if (handle == NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_037: [ If handle is NULL, IoTHubTransportHttp_TrimMemory shall do nothing. ]*/
+        LogError("Invalid argument handle=%p", handle);
+    }
+    else
+    {
+        HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
+        size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+        for (size_t i = 0; i < deviceListSize; i++)
+        {
+            HTTPTRANSPORT_PERDEVICE_DATA* deviceData = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i);
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_038: [ IoTHubTransportHttp_TrimMemory shall free the event batch buffer of every device in the transport device list, the next batch allocates it again. ]*/
+            destroy_eventBatchBuffer(deviceData);
+        }
+    }
+}
+
 static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2343,12 +3088,69 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             handleData->doBatchedTransfers = *(bool*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_018: [ "batching_send_binary_alone" ] */
+        else if (strcmp(OPTION_BATCHING_SEND_BINARY_ALONE, option) == 0)
+        {
+            handleData->sendBinaryEventsAlone = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_019: [ "batching_max_events", "batching_max_bytes" and "batching_linger_time" ] */
+        else if (strcmp(OPTION_BATCHING_MAX_EVENTS, option) == 0)
+        {
+            handleData->batchMaxEvents = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_BATCHING_MAX_BYTES, option) == 0)
+        {
+            handleData->batchMaxBytes = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_BATCHING_LINGER_TIME, option) == 0)
+        {
+            handleData->batchLingerTime = *(unsigned int*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_043: [ "device_quantum" ] */
+        else if (strcmp(OPTION_DEVICE_QUANTUM, option) == 0)
+        {
+            handleData->deviceQuantum = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_121: ["MinimumPollingTime"] */
         else if (strcmp(OPTION_MIN_POLLING_TIME, option) == 0)
         {
             handleData->getMinimumPollingTime = *(unsigned int*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_003: [ "c2d_poll_until_empty" ] */
+        else if (strcmp(OPTION_C2D_POLL_UNTIL_EMPTY, option) == 0)
+        {
+            handleData->pollC2DUntilEmpty = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_026: [ "c2d_polling_backoff_max" ] */
+        else if (strcmp(OPTION_C2D_POLLING_BACKOFF_MAX, option) == 0)
+        {
+            handleData->c2dPollingBackoffMax = *(unsigned int*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_012: [ "sas_token_lifetime" and "sas_token_refresh_time" ] */
+        else if (strcmp(OPTION_SAS_TOKEN_LIFETIME, option) == 0)
+        {
+            handleData->sasTokenLifetime = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_SAS_TOKEN_REFRESH_TIME, option) == 0)
+        {
+            handleData->sasTokenRefreshTime = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_006: [ "c2d_defer_disposition" ] */
+        else if (strcmp(OPTION_C2D_DEFER_DISPOSITION, option) == 0)
+        {
+            handleData->deferC2DDisposition = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
         else
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_126: [ "TrustedCerts"] */
@@ -2427,7 +3229,10 @@ static TRANSPORT_PROVIDER thisTransportProvider =
     IoTHubTransportHttp_Unsubscribe,                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
     IoTHubTransportHttp_DoWork,                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
     IoTHubTransportHttp_SetRetryPolicy,             /*pfIoTHubTransport_DoWork IoTHubTransport_SetRetryPolicy;*/
-    IoTHubTransportHttp_GetSendStatus               /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportHttp_GetSendStatus,              /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportHttp_GetNextWorkDeadline,        /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline;*/
+    NULL,                                           /*pfIoTHubTransport_GetPollDescriptors IoTHubTransport_GetPollDescriptors; the requests open and close their connection inside DoWork*/
+    IoTHubTransportHttp_TrimMemory                  /*pfIoTHubTransport_TrimMemory IoTHubTransport_TrimMemory;*/
 };
 
 const TRANSPORT_PROVIDER* HTTP_Protocol(void)
@@ -102,7 +102,7 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_SendMessageDisposition(MESSAGE_C
     return IoTHubTransport_MQTT_Common_SendMessageDisposition(message_data, disposition);
 }
 
-static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportMqtt_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportMqtt_ProcessItem(IOTHUB_DEVICE_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
 {
     return IoTHubTransport_MQTT_Common_ProcessItem(handle, item_type, iothub_item);
 }
@@ -126,6 +126,24 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_GetSendStatus(IOTHUB_DEVICE_HAND
     return IoTHubTransport_MQTT_Common_GetSendStatus(handle, iotHubClientStatus);
 }
 
+static uint32_t IoTHubTransportMqtt_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, bool* isWaitingForNetwork)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_055: [ IoTHubTransportMqtt_GetNextWorkDeadline shall get the deadline by calling into the IoTHubTransport_MQTT_Common_GetNextWorkDeadline function. ] */
+    return IoTHubTransport_MQTT_Common_GetNextWorkDeadline(handle, isWaitingForNetwork);
+}
+
+static size_t IoTHubTransportMqtt_GetPollDescriptors(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_POLL_DESCRIPTOR* descriptors, size_t descriptorCount)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_059: [ IoTHubTransportMqtt_GetPollDescriptors shall get the sockets by calling into the IoTHubTransport_MQTT_Common_GetPollDescriptors function. ] */
+    return IoTHubTransport_MQTT_Common_GetPollDescriptors(handle, descriptors, descriptorCount);
+}
+
+static void IoTHubTransportMqtt_TrimMemory(TRANSPORT_LL_HANDLE handle)
+{
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_063: [ IoTHubTransportMqtt_TrimMemory shall trim the memory by calling into the IoTHubTransport_MQTT_Common_TrimMemory function. ] */
+    IoTHubTransport_MQTT_Common_TrimMemory(handle);
+}
+
 static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_009: [ IoTHubTransportMqtt_SetOption shall set the options by calling into the IoTHubMqttAbstract_SetOption function. ] */
@@ -169,7 +187,10 @@ static TRANSPORT_PROVIDER myfunc =
     IoTHubTransportMqtt_Unsubscribe,                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
     IoTHubTransportMqtt_DoWork,                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
     IoTHubTransportMqtt_SetRetryPolicy,             /*pfIoTHubTransport_DoWork IoTHubTransport_SetRetryPolicy;*/
-    IoTHubTransportMqtt_GetSendStatus               /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportMqtt_GetSendStatus,              /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportMqtt_GetNextWorkDeadline,        /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline;*/
+    IoTHubTransportMqtt_GetPollDescriptors,         /*pfIoTHubTransport_GetPollDescriptors IoTHubTransport_GetPollDescriptors;*/
+    IoTHubTransportMqtt_TrimMemory                  /*pfIoTHubTransport_TrimMemory IoTHubTransport_TrimMemory;*/
 };
 
 /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_022: [This function shall return a pointer to a structure of type TRANSPORT_PROVIDER */
@@ -8,6 +8,7 @@
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/http_proxy_io.h"
 #include "iothubtransportmqtt_websockets.h"
+#include "iothub_client_ws_deflate_io.h"
 #include "iothubtransport_mqtt_common.h"
 
 static XIO_HANDLE getWebSocketsIOTransport(const char* fully_qualified_name, const MQTT_TRANSPORT_PROXY_OPTIONS* mqtt_transport_proxy_options)
@@ -17,6 +18,7 @@ static XIO_HANDLE getWebSocketsIOTransport(const char* fully_qualified_name, con
     const IO_INTERFACE_DESCRIPTION* io_interface_description = wsio_get_interface_description();
     TLSIO_CONFIG tls_io_config;
     HTTP_PROXY_IO_CONFIG http_proxy_io_config;
+    WS_DEFLATE_IO_CONFIG ws_deflate_io_config;
 
     if (io_interface_description == NULL)
     {
@@ -91,6 +93,12 @@ static XIO_HANDLE getWebSocketsIOTransport(const char* fully_qualified_name, con
                 /* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_01_014: [ - If `mqtt_transport_proxy_options` is NULL `underlying_io_parameters` shall be set to NULL. ]*/
                 tls_io_config.underlying_io_parameters = NULL;
             }
+
+            /* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_004: [ The WebSocket IO shall be put over the permessage-deflate IO obtained with `ws_deflate_io_get_interface_description`, whose `WS_DEFLATE_IO_CONFIG` shall be given the TLS IO interface description and arguments. ]*/
+            ws_deflate_io_config.underlying_io_interface = ws_io_config.underlying_io_interface;
+            ws_deflate_io_config.underlying_io_parameters = &tls_io_config;
+            ws_io_config.underlying_io_interface = ws_deflate_io_get_interface_description();
+            ws_io_config.underlying_io_parameters = &ws_deflate_io_config;
         }
 
         /* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_07_012: [ `getIoTransportProvider` shall return the `XIO_HANDLE` returned by `xio_create`. ] */
@@ -154,7 +162,7 @@ static void IoTHubTransportMqtt_WS_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE h
 }
 
 /* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_07_014: [ IoTHubTransportMqtt_WS_ProcessItem shall call into the IoTHubTransport_MQTT_Common_DoWork function ] */
-static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportMqtt_WS_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportMqtt_WS_ProcessItem(IOTHUB_DEVICE_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
 {
     return IoTHubTransport_MQTT_Common_ProcessItem(handle, item_type, iothub_item);
 }
@@ -171,6 +179,24 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_WS_GetSendStatus(IOTHUB_DEVICE_H
     return IoTHubTransport_MQTT_Common_GetSendStatus(handle, iotHubClientStatus);
 }
 
+/* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_001: [ IoTHubTransportMqtt_WS_GetNextWorkDeadline shall get the deadline by calling into the IoTHubTransport_MQTT_Common_GetNextWorkDeadline function. ] */
+static uint32_t IoTHubTransportMqtt_WS_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, bool* isWaitingForNetwork)
+{
+    return IoTHubTransport_MQTT_Common_GetNextWorkDeadline(handle, isWaitingForNetwork);
+}
+
+/* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_002: [ IoTHubTransportMqtt_WS_GetPollDescriptors shall get the sockets by calling into the IoTHubTransport_MQTT_Common_GetPollDescriptors function. ] */
+static size_t IoTHubTransportMqtt_WS_GetPollDescriptors(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_POLL_DESCRIPTOR* descriptors, size_t descriptorCount)
+{
+    return IoTHubTransport_MQTT_Common_GetPollDescriptors(handle, descriptors, descriptorCount);
+}
+
+/* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_003: [ IoTHubTransportMqtt_WS_TrimMemory shall trim the memory by calling into the IoTHubTransport_MQTT_Common_TrimMemory function. ] */
+static void IoTHubTransportMqtt_WS_TrimMemory(TRANSPORT_LL_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_TrimMemory(handle);
+}
+
 /* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_07_009: [ IoTHubTransportMqtt_WS_SetOption shall set the options by calling into the IoTHubMqttAbstract_SetOption function. ] */
 static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_WS_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
@@ -238,7 +264,10 @@ static TRANSPORT_PROVIDER thisTransportProvider_WebSocketsOverTls = {
     IoTHubTransportMqtt_WS_Unsubscribe,
     IoTHubTransportMqtt_WS_DoWork,
     IoTHubTransportMqtt_WS_SetRetryPolicy,
-    IoTHubTransportMqtt_WS_GetSendStatus
+    IoTHubTransportMqtt_WS_GetSendStatus,
+    IoTHubTransportMqtt_WS_GetNextWorkDeadline,
+    IoTHubTransportMqtt_WS_GetPollDescriptors,
+    IoTHubTransportMqtt_WS_TrimMemory
 };
 
 const TRANSPORT_PROVIDER* MQTT_WebSocket_Protocol(void)
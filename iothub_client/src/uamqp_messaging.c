@@ -1,16 +1,120 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 #include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
 #include "uamqp_messaging.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_uamqp_c/message.h"
 #include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqp_definitions.h"
 #include "iothub_message.h"
+
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP
+#include "iothub_client_memory_tag.h"
 #ifndef RESULT_OK
 #define RESULT_OK 0
 #endif
 
+#define BATCH_SECTION_COUNT 3  // properties, application-properties and data
+#define PROPERTY_KEY_CACHE_SIZE 16
+
+typedef struct PROPERTY_KEY_CACHE_ENTRY_TAG
+{
+	char* key;
+	AMQP_VALUE key_value;
+} PROPERTY_KEY_CACHE_ENTRY;
+
+typedef struct UAMQP_PROPERTY_KEY_CACHE_TAG
+{
+	PROPERTY_KEY_CACHE_ENTRY entries[PROPERTY_KEY_CACHE_SIZE];
+	size_t count;
+	size_t next_to_replace;
+} UAMQP_PROPERTY_KEY_CACHE;
+
+static int add_property_key_to_cache(UAMQP_PROPERTY_KEY_CACHE* key_cache, const char* key, AMQP_VALUE key_value)
+{
+	int result;
+	size_t key_length = strlen(key);
+	char* key_copy;
+
+	if ((key_copy = (char*)malloc(key_length + 1)) == NULL)
+	{
+		LogError("Failed allocating the copy of property name '%s' for the key cache.", key);
+		result = __FAILURE__;
+	}
+	else
+	{
+		PROPERTY_KEY_CACHE_ENTRY* entry;
+
+		(void)memcpy(key_copy, key, key_length + 1);
+
+		if (key_cache->count < PROPERTY_KEY_CACHE_SIZE)
+		{
+			entry = &key_cache->entries[key_cache->count];
+			key_cache->count++;
+		}
+		else
+		{
+			// The maps the replaced key was set on hold their own clone of it.
+			entry = &key_cache->entries[key_cache->next_to_replace];
+			key_cache->next_to_replace = (key_cache->next_to_replace + 1) % PROPERTY_KEY_CACHE_SIZE;
+			amqpvalue_destroy(entry->key_value);
+			free(entry->key);
+		}
+
+		entry->key = key_copy;
+		entry->key_value = key_value;
+		result = RESULT_OK;
+	}
+
+	return result;
+}
+
+// @brief
+//     Gets the AMQP_VALUE of an application property name, from `key_cache` if it is there.
+// @returns
+//     The AMQP_VALUE, or NULL if it fails to be created. It only needs to be destroyed by the caller if `is_cached` is false.
+static AMQP_VALUE get_property_key_value(UAMQP_PROPERTY_KEY_CACHE* key_cache, const char* key, bool* is_cached)
+{
+	AMQP_VALUE result = NULL;
+
+	*is_cached = false;
+
+	if (key_cache != NULL)
+	{
+		size_t i;
+
+		for (i = 0; i < key_cache->count; i++)
+		{
+			if (strcmp(key_cache->entries[i].key, key) == 0)
+			{
+				// Codes_SRS_UAMQP_MESSAGING_41_009: [If a property name is in `key_cache`, its cached AMQP_VALUE shall be used as the uAMQP property map key instead of creating one, and it shall not be destroyed.]
+				result = key_cache->entries[i].key_value;
+				*is_cached = true;
+				break;
+			}
+		}
+	}
+
+	if (result == NULL)
+	{
+		// Codes_SRS_UAMQP_MESSAGING_09_088: [An AMQP_VALUE instance shall be created using amqpvalue_create_string() to hold each uAMQP property name.]
+		if ((result = amqpvalue_create_string(key)) == NULL)
+		{
+			LogError("Failed to create uAMQP property key name.");
+		}
+		// Codes_SRS_UAMQP_MESSAGING_41_010: [A property name not in `key_cache` shall be added to it, replacing the oldest entry if the cache is full; if it cannot be added, its AMQP_VALUE shall be destroyed after use.]
+		else if (key_cache != NULL && add_property_key_to_cache(key_cache, key, result) == RESULT_OK)
+		{
+			*is_cached = true;
+		}
+	}
+
+	return result;
+}
+
 static int addPropertiesTouAMQPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, MESSAGE_HANDLE uamqp_message)
 {
 	int result = RESULT_OK;
@@ -103,7 +207,7 @@ static int addPropertiesTouAMQPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_hand
 	return result;
 }
 
-static int addApplicationPropertiesTouAMQPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, MESSAGE_HANDLE uamqp_message)
+static int addApplicationPropertiesTouAMQPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, UAMQP_PROPERTY_KEY_CACHE* key_cache, MESSAGE_HANDLE uamqp_message)
 {
 	int result = RESULT_OK;
 	MAP_HANDLE properties_map;
@@ -146,9 +250,9 @@ static int addApplicationPropertiesTouAMQPMessage(IOTHUB_MESSAGE_HANDLE iothub_m
 				{
 					AMQP_VALUE map_key_value = NULL;
 					AMQP_VALUE map_value_value = NULL;
+					bool is_key_cached;
 
-					// Codes_SRS_UAMQP_MESSAGING_09_088: [An AMQP_VALUE instance shall be created using amqpvalue_create_string() to hold each uAMQP property name.]
-					if ((map_key_value = amqpvalue_create_string(propertyKeys[i])) == NULL)
+					if ((map_key_value = get_property_key_value(key_cache, propertyKeys[i], &is_key_cached)) == NULL)
 					{
 						// Codes_SRS_UAMQP_MESSAGING_09_089: [If amqpvalue_create_string() fails, message_create_from_iothub_message() shall fail and return immediately..]
 						LogError("Failed to create uAMQP property key name.");
@@ -170,7 +274,7 @@ static int addApplicationPropertiesTouAMQPMessage(IOTHUB_MESSAGE_HANDLE iothub_m
 					}
 
 					// Codes_SRS_UAMQP_MESSAGING_09_094: [After adding the property name and value to the uAMQP property map, both AMQP_VALUE instances shall be destroyed using amqpvalue_destroy().]
-					if (map_key_value != NULL)
+					if (map_key_value != NULL && !is_key_cached)
 						amqpvalue_destroy(map_key_value);
 
 					if (map_value_value != NULL)
@@ -451,7 +555,7 @@ int IoTHubMessage_CreateFromUamqpMessage(MESSAGE_HANDLE uamqp_message, IOTHUB_ME
 	return result;
 }
 
-int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MESSAGE_HANDLE* uamqp_message)
+static int create_uamqp_message_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, UAMQP_PROPERTY_KEY_CACHE* key_cache, MESSAGE_HANDLE* uamqp_message)
 {
 	int result = __FAILURE__;
 	// Codes_SRS_UAMQP_MESSAGING_09_047: [The content type of the IOTHUB_MESSAGE_HANDLE instance shall be obtained using IoTHubMessage_GetContentType().]
@@ -514,7 +618,7 @@ int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MES
 			LogError("Failed setting properties of the uAMQP message.");
 			result = __FAILURE__;
 		}
-		else if (addApplicationPropertiesTouAMQPMessage(iothub_message, uamqp_message_tmp) != RESULT_OK)
+		else if (addApplicationPropertiesTouAMQPMessage(iothub_message, key_cache, uamqp_message_tmp) != RESULT_OK)
 		{
 			LogError("Failed setting application properties of the uAMQP message.");
 			result = __FAILURE__;
@@ -535,3 +639,231 @@ int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MES
 
 	return result;
 }
+
+int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MESSAGE_HANDLE* uamqp_message)
+{
+	return create_uamqp_message_from_iothub_message(iothub_message, NULL, uamqp_message);
+}
+
+UAMQP_PROPERTY_KEY_CACHE_HANDLE uamqp_property_key_cache_create(void)
+{
+	UAMQP_PROPERTY_KEY_CACHE* result;
+
+	// Codes_SRS_UAMQP_MESSAGING_41_006: [uamqp_property_key_cache_create() shall allocate an empty property key cache, or return NULL if malloc() fails.]
+	if ((result = (UAMQP_PROPERTY_KEY_CACHE*)malloc(sizeof(UAMQP_PROPERTY_KEY_CACHE))) == NULL)
+	{
+		LogError("Failed allocating the property key cache.");
+	}
+	else
+	{
+		memset(result, 0, sizeof(UAMQP_PROPERTY_KEY_CACHE));
+	}
+
+	return result;
+}
+
+void uamqp_property_key_cache_destroy(UAMQP_PROPERTY_KEY_CACHE_HANDLE key_cache)
+{
+	// Codes_SRS_UAMQP_MESSAGING_41_007: [uamqp_property_key_cache_destroy() shall destroy the cached AMQP_VALUEs, free the cached names and the cache; it shall return if key_cache is NULL.]
+	if (key_cache != NULL)
+	{
+		size_t i;
+
+		for (i = 0; i < key_cache->count; i++)
+		{
+			amqpvalue_destroy(key_cache->entries[i].key_value);
+			free(key_cache->entries[i].key);
+		}
+
+		free(key_cache);
+	}
+}
+
+int message_create_from_iothub_message_with_key_cache(IOTHUB_MESSAGE_HANDLE iothub_message, UAMQP_PROPERTY_KEY_CACHE_HANDLE key_cache, MESSAGE_HANDLE* uamqp_message)
+{
+	// Codes_SRS_UAMQP_MESSAGING_41_008: [message_create_from_iothub_message_with_key_cache() shall create the uAMQP message as message_create_from_iothub_message() does, taking the application property names from `key_cache` when `key_cache` is not NULL.]
+	return create_uamqp_message_from_iothub_message(iothub_message, key_cache, uamqp_message);
+}
+
+typedef struct ENCODING_BUFFER_TAG
+{
+	unsigned char* bytes;
+	size_t length;
+} ENCODING_BUFFER;
+
+static int append_encoded_bytes(void* context, const unsigned char* bytes, size_t length)
+{
+	ENCODING_BUFFER* buffer = (ENCODING_BUFFER*)context;
+	(void)memcpy(buffer->bytes + buffer->length, bytes, length);
+	buffer->length += length;
+	return RESULT_OK;
+}
+
+// @brief
+//     Creates the described sections (properties, application-properties and data) of a uAMQP message.
+// @returns
+//     The number of sections created, or 0 if any failure occurs.
+static size_t create_batch_sections(MESSAGE_HANDLE uamqp_message, AMQP_VALUE* sections)
+{
+	size_t count = 0;
+	bool failed = false;
+	PROPERTIES_HANDLE properties = NULL;
+	AMQP_VALUE application_properties = NULL;
+	BINARY_DATA body;
+
+	if (message_get_properties(uamqp_message, &properties) != RESULT_OK)
+	{
+		LogError("Failed getting the properties of the uAMQP message.");
+		failed = true;
+	}
+	else if (properties != NULL && (sections[count++] = amqpvalue_create_properties(properties)) == NULL)
+	{
+		LogError("Failed creating the properties section of the uAMQP message.");
+		failed = true;
+	}
+	else if (message_get_application_properties(uamqp_message, &application_properties) != RESULT_OK)
+	{
+		LogError("Failed getting the application properties of the uAMQP message.");
+		failed = true;
+	}
+	else if (application_properties != NULL && (sections[count++] = amqpvalue_create_application_properties(application_properties)) == NULL)
+	{
+		LogError("Failed creating the application properties section of the uAMQP message.");
+		failed = true;
+	}
+	else if (message_get_body_amqp_data_in_place(uamqp_message, 0, &body) != RESULT_OK)
+	{
+		LogError("Failed getting the body of the uAMQP message.");
+		failed = true;
+	}
+	else
+	{
+		data body_data;
+		body_data.bytes = body.bytes;
+		body_data.length = (uint32_t)body.length;
+
+		if ((sections[count++] = amqpvalue_create_data(body_data)) == NULL)
+		{
+			LogError("Failed creating the data section of the uAMQP message.");
+			failed = true;
+		}
+	}
+
+	if (properties != NULL)
+	{
+		properties_destroy(properties);
+	}
+
+	if (application_properties != NULL)
+	{
+		amqpvalue_destroy(application_properties);
+	}
+
+	if (failed)
+	{
+		while (count > 0)
+		{
+			count--;
+			if (sections[count] != NULL)
+			{
+				amqpvalue_destroy(sections[count]);
+			}
+		}
+	}
+
+	return count;
+}
+
+int message_create_uamqp_encoding_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, BINARY_DATA* encoded_message)
+{
+	int result;
+	MESSAGE_HANDLE uamqp_message;
+	AMQP_VALUE sections[BATCH_SECTION_COUNT];
+	size_t section_count;
+
+	// Codes_SRS_UAMQP_MESSAGING_41_001: [If iothub_message or encoded_message are NULL, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+	if (iothub_message == NULL || encoded_message == NULL)
+	{
+		LogError("Invalid argument (iothub_message=%p, encoded_message=%p).", iothub_message, encoded_message);
+		result = __FAILURE__;
+	}
+	// Codes_SRS_UAMQP_MESSAGING_41_002: [The uAMQP message shall be created from iothub_message using message_create_from_iothub_message().]
+	else if (message_create_from_iothub_message(iothub_message, &uamqp_message) != RESULT_OK)
+	{
+		// Codes_SRS_UAMQP_MESSAGING_41_005: [If any failure occurs, message_create_uamqp_encoding_from_iothub_message() shall free any memory it allocated and return a non-zero value.]
+		LogError("Failed creating the uAMQP message to encode.");
+		result = __FAILURE__;
+	}
+	else
+	{
+		// Codes_SRS_UAMQP_MESSAGING_41_003: [The properties, the application properties and the data of the uAMQP message shall be encoded one after the other in a buffer allocated for encoded_message, as a message of a batch.]
+		if ((section_count = create_batch_sections(uamqp_message, sections)) == 0)
+		{
+			// Codes_SRS_UAMQP_MESSAGING_41_005: [If any failure occurs, message_create_uamqp_encoding_from_iothub_message() shall free any memory it allocated and return a non-zero value.]
+			result = __FAILURE__;
+		}
+		else
+		{
+			size_t encoded_size = 0;
+			size_t index;
+
+			result = RESULT_OK;
+			for (index = 0; result == RESULT_OK && index < section_count; index++)
+			{
+				size_t section_size;
+				if (amqpvalue_get_encoded_size(sections[index], &section_size) != RESULT_OK)
+				{
+					LogError("Failed getting the encoded size of section %lu of the uAMQP message.", (unsigned long)index);
+					result = __FAILURE__;
+				}
+				else
+				{
+					encoded_size += section_size;
+				}
+			}
+
+			if (result == RESULT_OK)
+			{
+				ENCODING_BUFFER buffer;
+
+				if ((buffer.bytes = (unsigned char*)malloc(encoded_size)) == NULL)
+				{
+					LogError("Failed allocating %lu bytes to encode the uAMQP message.", (unsigned long)encoded_size);
+					result = __FAILURE__;
+				}
+				else
+				{
+					buffer.length = 0;
+					for (index = 0; result == RESULT_OK && index < section_count; index++)
+					{
+						if (amqpvalue_encode(sections[index], append_encoded_bytes, &buffer) != RESULT_OK)
+						{
+							LogError("Failed encoding section %lu of the uAMQP message.", (unsigned long)index);
+							result = __FAILURE__;
+						}
+					}
+
+					if (result != RESULT_OK)
+					{
+						free(buffer.bytes);
+					}
+					else
+					{
+						// Codes_SRS_UAMQP_MESSAGING_41_004: [If no failures occur, encoded_message shall own the encoded bytes, to be freed by the caller, and message_create_uamqp_encoding_from_iothub_message() shall return 0.]
+						encoded_message->bytes = buffer.bytes;
+						encoded_message->length = buffer.length;
+					}
+				}
+			}
+
+			for (index = 0; index < section_count; index++)
+			{
+				amqpvalue_destroy(sections[index]);
+			}
+		}
+
+		message_destroy(uamqp_message);
+	}
+
+	return result;
+}
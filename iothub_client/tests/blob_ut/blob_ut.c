@@ -29,12 +29,17 @@ static void my_gballoc_free(void* s)
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_client_crc64.h"
 #undef ENABLE_MOCKS
 
 #include "blob.h"
 #include "testrunnerswitcher.h"
 #include "umock_c.h"
 #include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
 #include "umock_c_negative_tests.h"
 
 /*helps when enums are not matched*/
@@ -74,6 +79,11 @@ static void my_BUFFER_delete(BUFFER_HANDLE h)
     my_gballoc_free(h);
 }
 
+static BUFFER_HANDLE my_BUFFER_new(void)
+{
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
 static HTTP_HEADERS_HANDLE my_HTTPHeaders_Alloc(void)
 {
     return (HTTP_HEADERS_HANDLE)my_gballoc_malloc(1);
@@ -104,6 +114,57 @@ static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t
     return (STRING_HANDLE)my_gballoc_malloc(1);
 }
 
+static unsigned int blockHttpStatus; /*status code set by my_HTTPAPIEX_ExecuteRequest*/
+static size_t failingRequestCount; /*the first failingRequestCount requests get failingHttpStatus instead*/
+static unsigned int failingHttpStatus;
+static HTTPAPIEX_RESULT my_HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    (void)handle;
+    (void)requestType;
+    (void)relativePath;
+    (void)requestHttpHeadersHandle;
+    (void)requestContent;
+    (void)responseHttpHeadersHandle;
+    (void)responseContent;
+    if (failingRequestCount > 0)
+    {
+        failingRequestCount--;
+        *statusCode = failingHttpStatus;
+    }
+    else
+    {
+        *statusCode = blockHttpStatus;
+    }
+    return HTTPAPIEX_OK;
+}
+
+/*the body storage answers when the CRC64 of a block does not match its content*/
+static const char TEST_CRC64_MISMATCH_BODY[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?><Error><Code>Crc64Mismatch</Code></Error>";
+static const unsigned char* my_BUFFER_u_char(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return (const unsigned char*)TEST_CRC64_MISMATCH_BODY;
+}
+
+static size_t my_BUFFER_length(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return sizeof(TEST_CRC64_MISMATCH_BODY) - 1;
+}
+
+#define TEST_LOCK_HANDLE (LOCK_HANDLE)0x4242
+#define TEST_TICK_COUNTER_HANDLE (TICK_COUNTER_HANDLE)0x4243
+
+/*every reading of the tick counter is a second after the previous one*/
+static tickcounter_ms_t currentMs;
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = currentMs;
+    currentMs += 1000;
+    return 0;
+}
+
 TEST_DEFINE_ENUM_TYPE(BLOB_RESULT, BLOB_RESULT_VALUES);
 
 static TEST_MUTEX_HANDLE g_dllByDll;
@@ -130,7 +191,6 @@ static unsigned int httpResponse; /*used as out parameter in every call to Blob_
 static const unsigned int TwoHundred = 200;
 static const unsigned int FourHundredFour = 404;
 
-
 BEGIN_TEST_SUITE(blob_ut)
 
 TEST_SUITE_INITIALIZE(TestSuiteInitialize)
@@ -139,6 +199,7 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
     (void)umock_c_init(on_umock_c_error);
 
     (void)umocktypes_charptr_register_types();
+    (void)umocktypes_stdint_register_types();
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -152,8 +213,10 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_create, my_BUFFER_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_create, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, my_BUFFER_new);
 
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_Alloc, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Free, my_HTTPHeaders_Free);
 
     REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, my_STRING_construct);
@@ -168,12 +231,26 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
     REGISTER_GLOBAL_MOCK_RETURN(STRING_c_str, "a");
     REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Create, THREADAPI_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
     
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
 
     REGISTER_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE);
     REGISTER_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT);
@@ -186,7 +263,6 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
 {
-
     BUFFER_delete(testValidBufferHandle);
 
     umock_c_deinit();
@@ -672,37 +748,17 @@ TEST_FUNCTION(Blob_UploadFromSasUri_various_sizes_happy_path)
             .IgnoreArgument_size();
 
         STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is creating the httpapiex handle to storage (it is always the same host)*/
-        STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the relative path of the Put Block and Put Block List operations*/
+            .IgnoreArgument_size();
 
         /*uploading blocks (Put Block)*/
         for (size_t blockNumber = 0;blockNumber < (sizes[iSize] - 1) / (4 * 1024 * 1024) + 1;blockNumber++)
         {
-            /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-            STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-                .IgnoreArgument_source();
-
-            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
-                .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-                .IgnoreArgument_s1()
-                .IgnoreArgument_s2();
-            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
-                .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relativePath*/
-
-            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
-                .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-                .IgnoreArgument_s1()
-                .IgnoreArgument_s2();
-
+            /*here the blockID is written in the relative path, base64 encoded from a string in the form: 000000...049999*/
             STRICT_EXPECTED_CALL(BUFFER_create(content + blockNumber * 4 * 1024 * 1024,
                 (blockNumber != (sizes[iSize] - 1) / (4 * 1024 * 1024)) ? 4 * 1024 * 1024 : (sizes[iSize] - 1) % (4 * 1024 * 1024) + 1 /*condition to take care of "the size of the last block*/
             )); /*this is the content to be uploaded by this call*/
 
-            STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
-                .IgnoreArgument_handle();
-
             STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
                 .IgnoreArgument_handle()
                 .IgnoreArgument_relativePath()
@@ -710,28 +766,15 @@ TEST_FUNCTION(Blob_UploadFromSasUri_various_sizes_happy_path)
 
             STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
-                .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-                .IgnoreArgument_handle();
         }
 
         /*this part is Put Block list*/
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
-
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist")) /*This is still building relative path for Put Block list*/
-            .IgnoreArgument_handle();
-
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the XML as const char* so it can be passed to _ExecuteRequest*/
-            .IgnoreArgument_handle();
-
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is writing the XML used in Put Block List operation*/
+            .IgnoreArgument_size();
         STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*this is creating the XML body as BUFFER_HANDLE*/
             .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path*/
-            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the XML once copied in the BUFFER_HANDLE*/
+            .IgnoreArgument_ptr();
 
         STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(
             IGNORED_PTR_ARG,
@@ -751,10 +794,8 @@ TEST_FUNCTION(Blob_UploadFromSasUri_various_sizes_happy_path)
 
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*This is the XML as BUFFER_HANDLE*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is destroying the relative path for Put Block List*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
-            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the relative path*/
+            .IgnoreArgument_ptr();
         STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
             .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
@@ -806,37 +847,17 @@ TEST_FUNCTION(Blob_UploadFromSasUri_various_sizes_with_certificates_happy_path)
 
         STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is creating the httpapiex handle to storage (it is always the same host)*/
         STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, "TrustedCerts", IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the relative path of the Put Block and Put Block List operations*/
+            .IgnoreArgument_size();
 
                                                                                                              /*uploading blocks (Put Block)*/
         for (size_t blockNumber = 0;blockNumber < (sizes[iSize] - 1) / (4 * 1024 * 1024) + 1;blockNumber++)
         {
-            /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-            STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-                .IgnoreArgument_source();
-
-            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
-                .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-                .IgnoreArgument_s1()
-                .IgnoreArgument_s2();
-            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
-                .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relativePath*/
-
-            STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
-                .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-                .IgnoreArgument_s1()
-                .IgnoreArgument_s2();
-
+            /*here the blockID is written in the relative path, base64 encoded from a string in the form: 000000...049999*/
             STRICT_EXPECTED_CALL(BUFFER_create(content + blockNumber * 4 * 1024 * 1024,
                 (blockNumber != (sizes[iSize] - 1) / (4 * 1024 * 1024)) ? 4 * 1024 * 1024 : (sizes[iSize] - 1) % (4 * 1024 * 1024) + 1 /*condition to take care of "the size of the last block*/
             )); /*this is the content to be uploaded by this call*/
 
-            STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
-                .IgnoreArgument_handle();
-
             STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
                 .IgnoreArgument_handle()
                 .IgnoreArgument_relativePath()
@@ -844,28 +865,15 @@ TEST_FUNCTION(Blob_UploadFromSasUri_various_sizes_with_certificates_happy_path)
 
             STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
                 .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
-                .IgnoreArgument_handle();
-            STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-                .IgnoreArgument_handle();
         }
 
         /*this part is Put Block list*/
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
-
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist")) /*This is still building relative path for Put Block list*/
-            .IgnoreArgument_handle();
-
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the XML as const char* so it can be passed to _ExecuteRequest*/
-            .IgnoreArgument_handle();
-
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is writing the XML used in Put Block List operation*/
+            .IgnoreArgument_size();
         STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*this is creating the XML body as BUFFER_HANDLE*/
             .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path*/
-            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the XML once copied in the BUFFER_HANDLE*/
+            .IgnoreArgument_ptr();
 
         STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(
             IGNORED_PTR_ARG,
@@ -885,10 +893,8 @@ TEST_FUNCTION(Blob_UploadFromSasUri_various_sizes_with_certificates_happy_path)
 
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*This is the XML as BUFFER_HANDLE*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is destroying the relative path for Put Block List*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
-            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the relative path*/
+            .IgnoreArgument_ptr();
         STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
             .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
@@ -913,84 +919,32 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_unhappy_paths)
 
     size_t calls_that_cannot_fail[] =
     {
-        13   ,/*BUFFER_delete*/
+        5    ,/*BUFFER_delete*/
+        8    ,/*BUFFER_delete*/
+        11   ,/*BUFFER_delete*/
+        14   ,/*BUFFER_delete*/
+        17   ,/*BUFFER_delete*/
+        20   ,/*BUFFER_delete*/
+        23   ,/*BUFFER_delete*/
         26   ,/*BUFFER_delete*/
-        39   ,/*BUFFER_delete*/
-        52   ,/*BUFFER_delete*/
-        65   ,/*BUFFER_delete*/
-        78   ,/*BUFFER_delete*/
-        91   ,/*BUFFER_delete*/
-        104  ,/*BUFFER_delete*/
-        117  ,/*BUFFER_delete*/
-        130  ,/*BUFFER_delete*/
-        143  ,/*BUFFER_delete*/
-        156  ,/*BUFFER_delete*/
-        169  ,/*BUFFER_delete*/
-        182  ,/*BUFFER_delete*/
-        195  ,/*BUFFER_delete*/
-        208  ,/*BUFFER_delete*/
-        11   ,/*STRING_c_str*/
-        24   ,/*STRING_c_str*/
-        37   ,/*STRING_c_str*/
-        50   ,/*STRING_c_str*/
-        63   ,/*STRING_c_str*/
-        76   ,/*STRING_c_str*/
-        89   ,/*STRING_c_str*/
-        102  ,/*STRING_c_str*/
-        115  ,/*STRING_c_str*/
-        128  ,/*STRING_c_str*/
-        141  ,/*STRING_c_str*/
-        154  ,/*STRING_c_str*/
-        167  ,/*STRING_c_str*/
-        180  ,/*STRING_c_str*/
-        193  ,/*STRING_c_str*/
-        206  ,/*STRING_c_str*/
-        14   ,/*STRING_delete*/
-        27   ,/*STRING_delete*/
-        40   ,/*STRING_delete*/
-        53   ,/*STRING_delete*/
-        66   ,/*STRING_delete*/
-        79   ,/*STRING_delete*/
-        92   ,/*STRING_delete*/
-        105  ,/*STRING_delete*/
-        118  ,/*STRING_delete*/
-        131  ,/*STRING_delete*/
-        144  ,/*STRING_delete*/
-        157  ,/*STRING_delete*/
-        170  ,/*STRING_delete*/
-        183  ,/*STRING_delete*/
-        196  ,/*STRING_delete*/
-        209  ,/*STRING_delete*/
-        15   ,/*STRING_delete*/
-        28   ,/*STRING_delete*/
-        41   ,/*STRING_delete*/
-        54   ,/*STRING_delete*/
-        67   ,/*STRING_delete*/
-        80   ,/*STRING_delete*/
-        93   ,/*STRING_delete*/
-        106  ,/*STRING_delete*/
-        119  ,/*STRING_delete*/
-        132  ,/*STRING_delete*/
-        145  ,/*STRING_delete*/
-        158  ,/*STRING_delete*/
-        171  ,/*STRING_delete*/
-        184  ,/*STRING_delete*/
-        197  ,/*STRING_delete*/
-        210  ,/*STRING_delete*/
-
-
-        214, /*STRING_c_str*/
-        216, /*STRING_c_str*/
-        218, /*BUFFER_delete*/
-        219, /*STRING_delete*/
-        220, /*STRING_delete*/
-        221, /*HTTPAPIEX_Destroy*/
-        222, /*gballoc_free*/
+        29   ,/*BUFFER_delete*/
+        32   ,/*BUFFER_delete*/
+        35   ,/*BUFFER_delete*/
+        38   ,/*BUFFER_delete*/
+        41   ,/*BUFFER_delete*/
+        44   ,/*BUFFER_delete*/
+        47   ,/*BUFFER_delete*/
+        50   ,/*BUFFER_delete*/
+
+        53, /*gballoc_free*/
+        55, /*BUFFER_delete*/
+        56, /*gballoc_free*/
+        57, /*HTTPAPIEX_Destroy*/
+        58, /*gballoc_free*/
     };
 
     (void)umock_c_negative_tests_init();
     
-    
     umock_c_reset_all_calls();
     ///arrange
     unsigned char * content = (unsigned char*)gballoc_malloc(size);
@@ -1006,37 +960,17 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_unhappy_paths)
         .IgnoreArgument_size();
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is creating the httpapiex handle to storage (it is always the same host)*/
-    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the relative path of the Put Block and Put Block List operations*/
+        .IgnoreArgument_size();
 
     /*uploading blocks (Put Block)*/
     for (size_t blockNumber = 0;blockNumber < (size - 1) / (4 * 1024 * 1024) + 1;blockNumber++)
     {
-        /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/ /*3, 16, 29... (16 numbers)*/
-            .IgnoreArgument_source();
-
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relativePath*/
-
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
-
+        /*here the blockID is written in the relative path, base64 encoded from a string in the form: 000000...049999*/
         STRICT_EXPECTED_CALL(BUFFER_create(content + blockNumber * 4 * 1024 * 1024,
             (blockNumber != (size - 1) / (4 * 1024 * 1024)) ? 4 * 1024 * 1024 : (size - 1) % (4 * 1024 * 1024) + 1 /*condition to take care of "the size of the last block*/
         )); /*this is the content to be uploaded by this call*/
 
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */ /*11, 24, 27...*/
-            .IgnoreArgument_handle();
-
         STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
             .IgnoreArgument_handle()
             .IgnoreArgument_relativePath()
@@ -1044,30 +978,17 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_unhappy_paths)
             .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
             ;
 
-        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*13, 26, 39... (16 numbers)*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/ /*14, 27, 40...*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/ /*15, 28, 41... 210*/
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*5, 8, 11... (16 numbers)*/
             .IgnoreArgument_handle();
     }
 
     /*this part is Put Block list*/
-    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/ /*211*/
-        .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
-
-    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist")) /*This is still building relative path for Put Block list*/
-        .IgnoreArgument_handle();
-
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the XML as const char* so it can be passed to _ExecuteRequest*/
-        .IgnoreArgument_handle();
-
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is writing the XML used in Put Block List operation*/
+        .IgnoreArgument_size();
     STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*this is creating the XML body as BUFFER_HANDLE*/
         .IgnoreAllArguments();
-
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path*/
-        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the XML once copied in the BUFFER_HANDLE*/
+        .IgnoreArgument_ptr();
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(
         IGNORED_PTR_ARG,
@@ -1087,10 +1008,8 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_unhappy_paths)
 
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*This is the XML as BUFFER_HANDLE*/
         .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is destroying the relative path for Put Block List*/
-        .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
-        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the relative path*/
+        .IgnoreArgument_ptr();
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
         .IgnoreArgument_handle();
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
@@ -1111,7 +1030,6 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_unhappy_paths)
 
         if (j == sizeof(calls_that_cannot_fail) / sizeof(calls_that_cannot_fail[0]))
         {
-            
             umock_c_negative_tests_fail_call(i);
             char temp_str[128];
             sprintf(temp_str, "On failed call %zu", i);
@@ -1139,84 +1057,32 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_with_certificate_unhappy_paths)
 
     size_t calls_that_cannot_fail[] =
     {
-        13  + 1 ,/*BUFFER_delete*/
+        5   + 1 ,/*BUFFER_delete*/
+        8   + 1 ,/*BUFFER_delete*/
+        11  + 1 ,/*BUFFER_delete*/
+        14  + 1 ,/*BUFFER_delete*/
+        17  + 1 ,/*BUFFER_delete*/
+        20  + 1 ,/*BUFFER_delete*/
+        23  + 1 ,/*BUFFER_delete*/
         26  + 1 ,/*BUFFER_delete*/
-        39  + 1 ,/*BUFFER_delete*/
-        52  + 1 ,/*BUFFER_delete*/
-        65  + 1 ,/*BUFFER_delete*/
-        78  + 1 ,/*BUFFER_delete*/
-        91  + 1 ,/*BUFFER_delete*/
-        104 + 1 ,/*BUFFER_delete*/
-        117 + 1 ,/*BUFFER_delete*/
-        130 + 1 ,/*BUFFER_delete*/
-        143 + 1 ,/*BUFFER_delete*/
-        156 + 1 ,/*BUFFER_delete*/
-        169 + 1 ,/*BUFFER_delete*/
-        182 + 1 ,/*BUFFER_delete*/
-        195 + 1 ,/*BUFFER_delete*/
-        208 + 1 ,/*BUFFER_delete*/
-        11  + 1 ,/*STRING_c_str*/
-        24  + 1 ,/*STRING_c_str*/
-        37  + 1 ,/*STRING_c_str*/
-        50  + 1 ,/*STRING_c_str*/
-        63  + 1 ,/*STRING_c_str*/
-        76  + 1 ,/*STRING_c_str*/
-        89  + 1 ,/*STRING_c_str*/
-        102 + 1 ,/*STRING_c_str*/
-        115 + 1 ,/*STRING_c_str*/
-        128 + 1 ,/*STRING_c_str*/
-        141 + 1 ,/*STRING_c_str*/
-        154 + 1 ,/*STRING_c_str*/
-        167 + 1 ,/*STRING_c_str*/
-        180 + 1 ,/*STRING_c_str*/
-        193 + 1 ,/*STRING_c_str*/
-        206 + 1 ,/*STRING_c_str*/
-        14  + 1 ,/*STRING_delete*/
-        27  + 1 ,/*STRING_delete*/
-        40  + 1 ,/*STRING_delete*/
-        53  + 1 ,/*STRING_delete*/
-        66  + 1 ,/*STRING_delete*/
-        79  + 1 ,/*STRING_delete*/
-        92  + 1 ,/*STRING_delete*/
-        105 + 1 ,/*STRING_delete*/
-        118 + 1 ,/*STRING_delete*/
-        131 + 1 ,/*STRING_delete*/
-        144 + 1 ,/*STRING_delete*/
-        157 + 1 ,/*STRING_delete*/
-        170 + 1 ,/*STRING_delete*/
-        183 + 1 ,/*STRING_delete*/
-        196 + 1 ,/*STRING_delete*/
-        209 + 1 ,/*STRING_delete*/
-        15  + 1 ,/*STRING_delete*/
-        28  + 1 ,/*STRING_delete*/
-        41  + 1 ,/*STRING_delete*/
-        54  + 1 ,/*STRING_delete*/
-        67  + 1 ,/*STRING_delete*/
-        80  + 1 ,/*STRING_delete*/
-        93  + 1 ,/*STRING_delete*/
-        106 + 1 ,/*STRING_delete*/
-        119 + 1 ,/*STRING_delete*/
-        132 + 1 ,/*STRING_delete*/
-        145 + 1 ,/*STRING_delete*/
-        158 + 1 ,/*STRING_delete*/
-        171 + 1 ,/*STRING_delete*/
-        184 + 1 ,/*STRING_delete*/
-        197 + 1 ,/*STRING_delete*/
-        210 + 1 ,/*STRING_delete*/
-
-
-        214+1, /*STRING_c_str*/
-        216+1, /*STRING_c_str*/
-        218+1, /*BUFFER_delete*/
-        219+1, /*STRING_delete*/
-        220+1, /*STRING_delete*/
-        221+1, /*HTTPAPIEX_Destroy*/
-        222+1, /*gballoc_free*/
+        29  + 1 ,/*BUFFER_delete*/
+        32  + 1 ,/*BUFFER_delete*/
+        35  + 1 ,/*BUFFER_delete*/
+        38  + 1 ,/*BUFFER_delete*/
+        41  + 1 ,/*BUFFER_delete*/
+        44  + 1 ,/*BUFFER_delete*/
+        47  + 1 ,/*BUFFER_delete*/
+        50  + 1 ,/*BUFFER_delete*/
+
+        53+1, /*gballoc_free*/
+        55+1, /*BUFFER_delete*/
+        56+1, /*gballoc_free*/
+        57+1, /*HTTPAPIEX_Destroy*/
+        58+1, /*gballoc_free*/
     };
 
     (void)umock_c_negative_tests_init();
 
-
     umock_c_reset_all_calls();
     ///arrange
     unsigned char * content = (unsigned char*)gballoc_malloc(size);
@@ -1233,37 +1099,17 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_with_certificate_unhappy_paths)
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is creating the httpapiex handle to storage (it is always the same host)*/
     STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, "TrustedCerts", IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the relative path of the Put Block and Put Block List operations*/
+        .IgnoreArgument_size();
 
                                                                                                          /*uploading blocks (Put Block)*/
     for (size_t blockNumber = 0;blockNumber < (size - 1) / (4 * 1024 * 1024) + 1;blockNumber++)
     {
-        /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/ /*3, 16, 29... (16 numbers)*/
-            .IgnoreArgument_source();
-
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relativePath*/
-
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
-
+        /*here the blockID is written in the relative path, base64 encoded from a string in the form: 000000...049999*/
         STRICT_EXPECTED_CALL(BUFFER_create(content + blockNumber * 4 * 1024 * 1024,
             (blockNumber != (size - 1) / (4 * 1024 * 1024)) ? 4 * 1024 * 1024 : (size - 1) % (4 * 1024 * 1024) + 1 /*condition to take care of "the size of the last block*/
         )); /*this is the content to be uploaded by this call*/
 
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */ /*11, 24, 27...*/
-            .IgnoreArgument_handle();
-
         STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
             .IgnoreArgument_handle()
             .IgnoreArgument_relativePath()
@@ -1271,30 +1117,17 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_with_certificate_unhappy_paths)
             .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
             ;
 
-        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*13, 26, 39... (16 numbers)*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/ /*14, 27, 40...*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/ /*15, 28, 41... 210*/
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/ /*5, 8, 11... (16 numbers)*/
             .IgnoreArgument_handle();
     }
 
     /*this part is Put Block list*/
-    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/ /*211*/
-        .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
-
-    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist")) /*This is still building relative path for Put Block list*/
-        .IgnoreArgument_handle();
-
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the XML as const char* so it can be passed to _ExecuteRequest*/
-        .IgnoreArgument_handle();
-
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is writing the XML used in Put Block List operation*/
+        .IgnoreArgument_size();
     STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*this is creating the XML body as BUFFER_HANDLE*/
         .IgnoreAllArguments();
-
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path*/
-        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the XML once copied in the BUFFER_HANDLE*/
+        .IgnoreArgument_ptr();
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(
         IGNORED_PTR_ARG,
@@ -1314,10 +1147,8 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_with_certificate_unhappy_paths)
 
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*This is the XML as BUFFER_HANDLE*/
         .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is destroying the relative path for Put Block List*/
-        .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
-        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the relative path*/
+        .IgnoreArgument_ptr();
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
         .IgnoreArgument_handle();
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
@@ -1338,7 +1169,6 @@ TEST_FUNCTION(Blob_UploadFromSasUri_64MB_with_certificate_unhappy_paths)
 
         if (j == sizeof(calls_that_cannot_fail) / sizeof(calls_that_cannot_fail[0]))
         {
-
             umock_c_negative_tests_fail_call(i);
             char temp_str[128];
             sprintf(temp_str, "On failed call %zu", i);
@@ -1404,37 +1234,17 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
         .IgnoreArgument_size();
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is creating the httpapiex handle to storage (it is always the same host)*/
-    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the relative path of the Put Block and Put Block List operations*/
+        .IgnoreArgument_size();
 
     /*uploading blocks (Put Block)*/ /*this simply fails first block*/
     size_t blockNumber = 0;
     {
-        /*here some sprintf happens and that produces a string in the form: 000000...049999*/
-        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
-            .IgnoreArgument_source();
-
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relativePath*/
-
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
-            .IgnoreArgument_s1()
-            .IgnoreArgument_s2();
-
+        /*here the blockID is written in the relative path, base64 encoded from a string in the form: 000000...049999*/
         STRICT_EXPECTED_CALL(BUFFER_create(content + blockNumber * 4 * 1024 * 1024,
             (blockNumber != (size - 1) / (4 * 1024 * 1024)) ? 4 * 1024 * 1024 : (size - 1) % (4 * 1024 * 1024) + 1 /*condition to take care of "the size of the last block*/
         )); /*this is the content to be uploaded by this call*/
 
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
-            .IgnoreArgument_handle();
-
         STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
             .IgnoreArgument_handle()
             .IgnoreArgument_relativePath()
@@ -1444,16 +1254,11 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
 
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
             .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
-            .IgnoreArgument_handle();
     }
 
     /*this part is Put Block list*/ /*notice: no op because it failed before with 404*/
-
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
-        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the relative path*/
+        .IgnoreArgument_ptr();
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
         .IgnoreArgument_handle();
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
@@ -1471,5 +1276,624 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
     
 }
 
+static size_t countActualCalls(const char* call)
+{
+    size_t result = 0;
+    const char* actualCalls = umock_c_get_actual_calls();
+    while ((actualCalls = strstr(actualCalls, call)) != NULL)
+    {
+        result++;
+        actualCalls += strlen(call);
+    }
+    return result;
+}
+
+/*Tests_SRS_BLOB_41_001: [ Blob_UploadFromSasUri shall call Blob_UploadFromSasUri_Ex with a blockUploadConcurrency of 1. ]*/
+TEST_FUNCTION(Blob_UploadFromSasUri_does_not_start_block_upload_threads)
+{
+    size_t size = 64 * 1024 * 1024;
+
+    ///arrange
+    unsigned char * content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    memset(content, '3', size);
+    blockHttpStatus = 201;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadFromSasUri("https://h.h/something?a=b", content, size, &httpResponse, testValidBufferHandle, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("Lock_Init("));
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("ThreadAPI_Create("));
+    ASSERT_ARE_EQUAL(size_t, 17, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+    gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_41_019: [ The relative path of the "Put Block"s and of the "Put Block List" shall be allocated once per upload and per block upload thread, only the block ID being written again for every block. ]*/
+/*Tests_SRS_BLOB_41_021: [ The "Put Block"s of the calling thread and the "Put Block List" shall be executed on the same HTTPAPIEX_HANDLE, which keeps its connection to storage from one request to the next. ]*/
+TEST_FUNCTION(Blob_UploadFromSasUri_puts_all_the_blocks_on_one_HTTPAPIEX_handle_and_one_relative_path)
+{
+    size_t size = 64 * 1024 * 1024;
+
+    ///arrange
+    unsigned char * content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    memset(content, '3', size);
+    blockHttpStatus = 201;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadFromSasUri("https://h.h/something?a=b", content, size, &httpResponse, testValidBufferHandle, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("HTTPAPIEX_Create("));
+    ASSERT_ARE_EQUAL(size_t, 17, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+    ASSERT_ARE_EQUAL(size_t, 3, countActualCalls("gballoc_malloc(")); /*the hostname, the relative path and the XML*/
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("/something?a=b&comp=block&blockid=ICAgICAw\""));
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("/something?a=b&comp=block&blockid=ICAgIDE1\""));
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("/something?a=b&comp=blocklist\""));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+    gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_41_020: [ Once all the blocks have been put, the XML of the "Put Block List" shall be written in a single allocation of its exact size. ]*/
+TEST_FUNCTION(Blob_UploadFromSasUri_writes_the_block_list_in_a_buffer_of_its_exact_size)
+{
+    size_t size = 64 * 1024 * 1024;
+    /*the XML header, 16 times <Latest>8 characters of block ID</Latest> and </BlockList>*/
+    size_t xmlSize = strlen("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>") + 16 * strlen("<Latest>ICAgIDE1</Latest>") + strlen("</BlockList>");
+    char expectedCall[64];
+
+    ///arrange
+    unsigned char * content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    memset(content, '3', size);
+    blockHttpStatus = 201;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadFromSasUri("https://h.h/something?a=b", content, size, &httpResponse, testValidBufferHandle, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    (void)sprintf(expectedCall, "[gballoc_malloc(%lu)]", (unsigned long)(xmlSize + 1));
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls(expectedCall));
+    (void)sprintf(expectedCall, ",%lu)]", (unsigned long)xmlSize);
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls(expectedCall));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+    gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_41_002: [ If blockUploadConcurrency is bigger than 1, Blob_UploadFromSasUri_Ex shall upload the blocks from up to blockUploadConcurrency threads, each thread having its own HTTPAPIEX_HANDLE to the same hostname and certificates. ]*/
+TEST_FUNCTION(Blob_UploadFromSasUri_Ex_fails_when_Lock_Init_fails)
+{
+    size_t size = 64 * 1024 * 1024;
+
+    ///arrange
+    unsigned char * content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    memset(content, '3', size);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is creating the httpapiex handle to storage (it is always the same host)*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the relative path of the Put Block and Put Block List operations*/
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(Lock_Init())
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the relative path*/
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadFromSasUri_Ex("https://h.h/something?a=b", content, size, &httpResponse, testValidBufferHandle, NULL, 4, 0, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
+
+    ///cleanup
+    gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_41_003: [ If a thread cannot be started, Blob_UploadFromSasUri_Ex shall upload the blocks with the threads already started. ]*/
+/*Tests_SRS_BLOB_41_005: [ Once all the blocks have been uploaded, Blob_UploadFromSasUri_Ex shall add their block IDs to the XML in block ID order. ]*/
+TEST_FUNCTION(Blob_UploadFromSasUri_Ex_uploads_all_the_blocks_from_the_calling_thread_when_no_thread_can_be_started)
+{
+    size_t size = 64 * 1024 * 1024;
+
+    ///arrange
+    unsigned char * content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    memset(content, '3', size);
+    blockHttpStatus = 201;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(THREADAPI_ERROR);
+
+    ///act
+    BLOB_RESULT result = Blob_UploadFromSasUri_Ex("https://h.h/something?a=b", content, size, &httpResponse, testValidBufferHandle, NULL, 4, 0, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 201, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("ThreadAPI_Create("));
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("ThreadAPI_Join("));
+    ASSERT_ARE_EQUAL(size_t, 17, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("&comp=block&blockid=ICAgIDE1\""));
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("&comp=blocklist\""));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+    gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_41_004: [ If a block fails, the threads shall stop taking blocks and Blob_UploadFromSasUri_Ex shall report the first failure as the sequential upload does. ]*/
+TEST_FUNCTION(Blob_UploadFromSasUri_Ex_when_http_code_is_404_it_stops_uploading_blocks_and_succeeds)
+{
+    size_t size = 64 * 1024 * 1024;
+
+    ///arrange
+    unsigned char * content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    memset(content, '3', size);
+    blockHttpStatus = 404;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadFromSasUri_Ex("https://h.h/something?a=b", content, size, &httpResponse, testValidBufferHandle, NULL, 4, 0, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 404, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("BUFFER_build("));
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("&comp=blocklist\""));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+    gballoc_free(content);
+}
+
+/*getDataCallback of the tests: returns blockCount blocks of blockSize bytes of testBlock*/
+typedef struct TEST_GET_DATA_CONTEXT_TAG
+{
+    size_t blockCount;
+    size_t blockSize;
+    size_t callCount;
+} TEST_GET_DATA_CONTEXT;
+
+static unsigned char testBlock[4 * 1024 * 1024 + 1];
+
+static void testGetDataCallback(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const ** data, size_t* size, void* context)
+{
+    TEST_GET_DATA_CONTEXT* testContext = (TEST_GET_DATA_CONTEXT*)context;
+    ASSERT_ARE_EQUAL(int, (int)FILE_UPLOAD_OK, (int)result);
+    if (testContext->callCount < testContext->blockCount)
+    {
+        *data = testBlock;
+        *size = testContext->blockSize;
+    }
+    else
+    {
+        *data = NULL;
+        *size = 0;
+    }
+    testContext->callCount++;
+}
+
+/*Tests_SRS_BLOB_41_006: [ If SASURI or getDataCallback is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_NULL_getDataCallback_fails)
+{
+    ///arrange
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", NULL, NULL, &httpResponse, testValidBufferHandle, NULL, 0, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+}
+
+/*Tests_SRS_BLOB_41_007: [ Blob_UploadMultipleBlocksFromSasUri shall upload every block with a "Put Block" and commit them with a "Put Block List", whatever the size of the blob. ]*/
+/*Tests_SRS_BLOB_41_008: [ Blob_UploadMultipleBlocksFromSasUri shall get every block by calling getDataCallback with FILE_UPLOAD_OK, a NULL data or a size of 0 meaning there are no more blocks. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_uploads_every_block_of_getDataCallback)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 2, 10, 0 };
+    blockHttpStatus = 201;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 0, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 3, context.callCount);
+    ASSERT_ARE_EQUAL(size_t, 3, countActualCalls("BUFFER_create(")); /*the 2 blocks and the XML*/
+    ASSERT_ARE_EQUAL(size_t, 2, countActualCalls("&comp=block&blockid="));
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("&comp=blocklist\""));
+    ASSERT_ARE_EQUAL(size_t, 3, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("crc64_compute("));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
+
+/*Tests_SRS_BLOB_41_009: [ If getDataCallback returns a block bigger than 4MB or more than 50000 blocks, Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_a_block_bigger_than_4MB_fails)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 1, sizeof(testBlock), 0 };
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 0, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(size_t, 1, context.callCount);
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+}
+
+/*Tests_SRS_BLOB_41_010: [ If putting a block fails or storage answers 408, 429 or a 5xx status, the upload shall put the block again with the same block ID, up to blockRetryCount times, waiting 1 second before the first retry and twice as long before every next one, up to 32 seconds. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_puts_a_block_refused_with_503_again)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 2, 10, 0 };
+    blockHttpStatus = 201;
+    failingRequestCount = 2;
+    failingHttpStatus = 503;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 3, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 201, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 3, context.callCount); /*the blocks are not asked again*/
+    ASSERT_ARE_EQUAL(size_t, 2, countActualCalls("&comp=block&blockid="));
+    ASSERT_ARE_EQUAL(size_t, 5, countActualCalls("HTTPAPIEX_ExecuteRequest(")); /*the first block 3 times, the second block and the block list*/
+    ASSERT_ARE_EQUAL(size_t, 2, countActualCalls("ThreadAPI_Sleep("));
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "ThreadAPI_Sleep(1000)"));
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "ThreadAPI_Sleep(2000)"));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
+
+/*Tests_SRS_BLOB_41_010: [ If putting a block fails or storage answers 408, 429 or a 5xx status, the upload shall put the block again with the same block ID, up to blockRetryCount times, waiting 1 second before the first retry and twice as long before every next one, up to 32 seconds. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_stops_after_blockRetryCount_retries)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 2, 10, 0 };
+    blockHttpStatus = 201;
+    failingRequestCount = 10;
+    failingHttpStatus = 500;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 2, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result); /*storage refused the block, as without retries*/
+    ASSERT_ARE_EQUAL(int, 500, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 3, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("&comp=blocklist\""));
+
+    ///cleanup
+    failingRequestCount = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
+
+/*Tests_SRS_BLOB_41_010: [ If putting a block fails or storage answers 408, 429 or a 5xx status, the upload shall put the block again with the same block ID, up to blockRetryCount times, waiting 1 second before the first retry and twice as long before every next one, up to 32 seconds. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_does_not_put_a_block_refused_with_403_again)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 2, 10, 0 };
+    blockHttpStatus = 201;
+    failingRequestCount = 1;
+    failingHttpStatus = 403;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 3, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 403, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("ThreadAPI_Sleep("));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
+
+/*Tests_SRS_BLOB_41_012: [ When a block of source needed a retry, the next blocks of source shall be half as big, down to 256KB and never smaller than what fits the rest of source in the 50000 blocks. ]*/
+/*Tests_SRS_BLOB_41_013: [ After 4 blocks in a row put without a retry, the next blocks of source shall be twice as big, up to 4MB. ]*/
+TEST_FUNCTION(Blob_UploadFromSasUri_Ex_halves_the_blocks_after_a_retry_and_grows_them_back)
+{
+    size_t size = 64 * 1024 * 1024;
+
+    ///arrange
+    unsigned char * content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    memset(content, '3', size);
+    blockHttpStatus = 201;
+    failingRequestCount = 1;
+    failingHttpStatus = 503;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadFromSasUri_Ex("https://h.h/something?a=b", content, size, &httpResponse, testValidBufferHandle, NULL, 1, 1, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    /*a 4MB block put twice, 4 blocks of 2MB then 13 blocks of 4MB*/
+    ASSERT_ARE_EQUAL(size_t, 18, countActualCalls("&comp=block&blockid="));
+    ASSERT_ARE_EQUAL(size_t, 20, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+    gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_41_012: [ When a block of source needed a retry, the next blocks of source shall be half as big, down to 256KB and never smaller than what fits the rest of source in the 50000 blocks. ]*/
+TEST_FUNCTION(Blob_UploadFromSasUri_Ex_keeps_the_blocks_at_4MB_without_retries)
+{
+    size_t size = 64 * 1024 * 1024;
+
+    ///arrange
+    unsigned char * content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    memset(content, '3', size);
+    blockHttpStatus = 201;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadFromSasUri_Ex("https://h.h/something?a=b", content, size, &httpResponse, testValidBufferHandle, NULL, 1, 3, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 16, countActualCalls("&comp=block&blockid="));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+    gballoc_free(content);
+}
+
+/*progressCallback of the tests: keeps the last progress, cancels the upload on its cancelOnCall-th call (never when 0)*/
+typedef struct TEST_PROGRESS_CONTEXT_TAG
+{
+    size_t cancelOnCall;
+    size_t callCount;
+    IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS lastProgress;
+} TEST_PROGRESS_CONTEXT;
+
+static int testProgressCallback(const IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS* progress, void* userContextCallback)
+{
+    TEST_PROGRESS_CONTEXT* testContext = (TEST_PROGRESS_CONTEXT*)userContextCallback;
+    testContext->lastProgress = *progress;
+    testContext->callCount++;
+    return (testContext->callCount == testContext->cancelOnCall) ? 1 : 0;
+}
+
+/*Tests_SRS_BLOB_41_014: [ If progressCallback is not NULL, it shall be called with progressContext after every block put in storage, with the bytes and blocks sent so far, the retries they needed, the throughput since the upload started and the size of source (0 for getDataCallback). ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_reports_the_progress_after_every_block)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 2, 10, 0 };
+    TEST_PROGRESS_CONTEXT progressContext = { 0, 0 };
+    blockHttpStatus = 201;
+    failingRequestCount = 1;
+    failingHttpStatus = 503;
+    currentMs = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 1, testProgressCallback, &progressContext, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, progressContext.callCount);
+    ASSERT_ARE_EQUAL(int, 20, (int)progressContext.lastProgress.bytesSent);
+    ASSERT_ARE_EQUAL(int, 0, (int)progressContext.lastProgress.totalBytes);
+    ASSERT_ARE_EQUAL(size_t, 2, progressContext.lastProgress.blocksSent);
+    ASSERT_ARE_EQUAL(size_t, 1, progressContext.lastProgress.retries);
+    ASSERT_ARE_EQUAL(int, 10, (int)progressContext.lastProgress.bytesPerSecond); /*20 bytes in 2 seconds*/
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("tickcounter_destroy("));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
+
+/*Tests_SRS_BLOB_41_015: [ If progressCallback returns non-zero, the upload shall put no more blocks, shall not put the block list and shall return BLOB_ABORTED. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_cancelled_by_progressCallback_returns_BLOB_ABORTED)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 3, 10, 0 };
+    TEST_PROGRESS_CONTEXT progressContext = { 1, 0 };
+    blockHttpStatus = 201;
+    failingRequestCount = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 0, testProgressCallback, &progressContext, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ABORTED, result);
+    ASSERT_ARE_EQUAL(size_t, 1, progressContext.callCount);
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("&comp=block&blockid="));
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("&comp=blocklist\""));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
+
+/*Tests_SRS_BLOB_41_015: [ If progressCallback returns non-zero, the upload shall put no more blocks, shall not put the block list and shall return BLOB_ABORTED. ]*/
+TEST_FUNCTION(Blob_UploadFromSasUri_Ex_in_parallel_cancelled_by_progressCallback_returns_BLOB_ABORTED)
+{
+    size_t size = 64 * 1024 * 1024;
+
+    ///arrange
+    TEST_PROGRESS_CONTEXT progressContext = { 1, 0 };
+    unsigned char * content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    memset(content, '3', size);
+    blockHttpStatus = 201;
+    failingRequestCount = 0;
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Create, THREADAPI_ERROR); /*the blocks are put from the calling thread*/
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadFromSasUri_Ex("https://h.h/something?a=b", content, size, &httpResponse, testValidBufferHandle, NULL, 4, 0, testProgressCallback, &progressContext, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ABORTED, result);
+    ASSERT_ARE_EQUAL(size_t, 1, progressContext.callCount);
+    ASSERT_ARE_EQUAL(int, 4 * 1024 * 1024, (int)progressContext.lastProgress.bytesSent);
+    ASSERT_ARE_EQUAL(int, 64 * 1024 * 1024, (int)progressContext.lastProgress.totalBytes);
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("&comp=blocklist\""));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Create, THREADAPI_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+    gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_41_016: [ If computeBlockCrc64 is true, every "Put Block" shall have the header x-ms-content-crc64 with the base64 of the CRC64 of the block (little endian) and the header x-ms-version 2019-02-02. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_computeBlockCrc64_sends_the_CRC64_of_every_block)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 2, 10, 0 };
+    blockHttpStatus = 201;
+    failingRequestCount = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 0, NULL, NULL, true);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, countActualCalls("crc64_compute(0,"));
+    ASSERT_ARE_EQUAL(size_t, 2, countActualCalls("\"x-ms-content-crc64\""));
+    ASSERT_ARE_EQUAL(size_t, 2, countActualCalls("\"x-ms-version\",\"2019-02-02\""));
+    ASSERT_ARE_EQUAL(size_t, 2, countActualCalls("HTTPHeaders_Free("));
+    ASSERT_ARE_EQUAL(size_t, 3, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
+
+/*Tests_SRS_BLOB_41_016: [ If computeBlockCrc64 is true, every "Put Block" shall have the header x-ms-content-crc64 with the base64 of the CRC64 of the block (little endian) and the header x-ms-version 2019-02-02. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_computeBlockCrc64_fails_when_HTTPHeaders_Alloc_fails)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 2, 10, 0 };
+    blockHttpStatus = 201;
+    failingRequestCount = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_Alloc, NULL);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 0, NULL, NULL, true);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
+
+/*Tests_SRS_BLOB_41_017: [ If computeBlockCrc64 is true and storage answers 400 with the error Crc64Mismatch, the upload shall put the block again as for SRS_BLOB_41_010. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_computeBlockCrc64_puts_a_corrupted_block_again)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 2, 10, 0 };
+    blockHttpStatus = 201;
+    failingRequestCount = 1;
+    failingHttpStatus = 400;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, my_BUFFER_length);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 3, NULL, NULL, true);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 201, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 4, countActualCalls("HTTPAPIEX_ExecuteRequest(")); /*the first block twice, the second block and the block list*/
+    ASSERT_ARE_EQUAL(size_t, 2, countActualCalls("crc64_compute(0,")); /*the CRC64 of a block is not computed again for its retries*/
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("ThreadAPI_Sleep("));
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
+
+/*Tests_SRS_BLOB_41_017: [ If computeBlockCrc64 is true and storage answers 400 with the error Crc64Mismatch, the upload shall put the block again as for SRS_BLOB_41_010. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_without_computeBlockCrc64_does_not_put_a_block_refused_with_400_again)
+{
+    ///arrange
+    TEST_GET_DATA_CONTEXT context = { 2, 10, 0 };
+    blockHttpStatus = 201;
+    failingRequestCount = 1;
+    failingHttpStatus = 400;
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, my_BUFFER_length);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", testGetDataCallback, &context, &httpResponse, testValidBufferHandle, NULL, 3, NULL, NULL, false);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 400, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 1, countActualCalls("HTTPAPIEX_ExecuteRequest("));
+
+    ///cleanup
+    failingRequestCount = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, NULL);
+}
 
 END_TEST_SUITE(blob_ut);
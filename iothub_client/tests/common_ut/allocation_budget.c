@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stddef.h>
+#include <string.h>
+
+#include "umock_c.h"
+#include "allocation_budget.h"
+
+static const char* const ALLOCATION_CALLS[] = { "[gballoc_malloc(", "[gballoc_calloc(", "[gballoc_realloc(" };
+
+static size_t count_occurrences(const char* calls, const char* call)
+{
+    size_t result = 0;
+    size_t call_length = strlen(call);
+    const char* found = strstr(calls, call);
+    while (found != NULL)
+    {
+        result++;
+        found = strstr(found + call_length, call);
+    }
+    return result;
+}
+
+size_t allocation_budget_get_allocation_count(void)
+{
+    size_t result = 0;
+    const char* actual_calls = umock_c_get_actual_calls();
+    if (actual_calls != NULL)
+    {
+        size_t index;
+        for (index = 0; index < sizeof(ALLOCATION_CALLS) / sizeof(ALLOCATION_CALLS[0]); index++)
+        {
+            result += count_occurrences(actual_calls, ALLOCATION_CALLS[index]);
+        }
+    }
+    return result;
+}
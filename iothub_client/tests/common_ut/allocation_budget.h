@@ -0,0 +1,47 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef ALLOCATION_BUDGET_H
+#define ALLOCATION_BUDGET_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdio>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdio.h>
+#endif
+
+#include "testrunnerswitcher.h"
+
+/* Allocation budgets of the hot paths, for the unit tests built with gballoc mocked.
+   The allocations are counted in the calls umock_c recorded without expecting them, so a budget is asserted on a
+   path run right after umock_c_reset_all_calls() with no expected calls:
+
+       umock_c_reset_all_calls();
+       (void)IoTHubClient_LL_SendEventAsync(handle, message, callback, context);
+       ASSERT_ALLOCATION_BUDGET(1);
+
+   Every gballoc_malloc, gballoc_calloc and gballoc_realloc counts as one allocation. What the mocked modules allocate
+   themselves is not counted. */
+
+extern size_t allocation_budget_get_allocation_count(void);
+
+#define ASSERT_ALLOCATION_BUDGET(budget) \
+    do \
+    { \
+        size_t allocation_budget_count = allocation_budget_get_allocation_count(); \
+        if (allocation_budget_count > (size_t)(budget)) \
+        { \
+            char allocation_budget_message[128]; \
+            (void)snprintf(allocation_budget_message, sizeof(allocation_budget_message), "%lu allocations, the budget is %lu", (unsigned long)allocation_budget_count, (unsigned long)(budget)); \
+            ASSERT_FAIL(allocation_budget_message); \
+        } \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ALLOCATION_BUDGET_H */
@@ -24,6 +24,7 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/macro_utils.h"
 
 #include "iothub_client_authorization.h"
+#include "azure_c_shared_utility/sha.h"
 
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/gballoc.h"
@@ -31,8 +32,15 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/agenttime.h" 
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/sastoken.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/urlencode.h"
 
 #include "azure_c_shared_utility/umock_c_prod.h"
+
+MOCKABLE_FUNCTION(, int, hmacReset, HMACContext*, ctx, SHAversion, whichSha, const unsigned char*, key, int, key_len);
+MOCKABLE_FUNCTION(, int, hmacInput, HMACContext*, ctx, const unsigned char*, text, int, text_len);
+MOCKABLE_FUNCTION(, int, hmacResult, HMACContext*, ctx, uint8_t*, digest);
 #undef ENABLE_MOCKS
 
 static const char* DEVICE_ID = "device_id";
@@ -71,6 +79,36 @@ static STRING_HANDLE my_SASToken_CreateString(const char* key, const char* scope
 }
 
 
+static int my_size_tToString(char* destination, size_t destinationSize, size_t value)
+{
+    (void)snprintf(destination, destinationSize, "%zu", value);
+    return 0;
+}
+
+static BUFFER_HANDLE my_Base64_Decoder(const char* source)
+{
+    (void)source;
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_BUFFER_delete(BUFFER_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
+{
+    (void)source;
+    (void)size;
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
+
+static STRING_HANDLE my_URL_Encode(STRING_HANDLE input)
+{
+    (void)input;
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
+
 static STRING_HANDLE my_STRING_construct(const char* psz)
 {
     (void)psz;
@@ -110,6 +148,12 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HMACContext*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SHAversion, int);
+    REGISTER_UMOCK_ALIAS_TYPE(const unsigned char*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(unsigned char*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(uint8_t*, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -124,6 +168,30 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(get_time, TEST_TIME_VALUE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, ((time_t)(-1)));
 
+    REGISTER_GLOBAL_MOCK_HOOK(size_tToString, my_size_tToString);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(size_tToString, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Base64_Decoder, my_Base64_Decoder);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Decoder, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+    REGISTER_GLOBAL_MOCK_HOOK(Base64_Encode_Bytes, my_Base64_Encode_Bytes);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Encode_Bytes, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(URL_Encode, my_URL_Encode);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(URL_Encode, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(hmacReset, shaSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(hmacReset, shaNull);
+    REGISTER_GLOBAL_MOCK_RETURN(hmacInput, shaSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(hmacInput, shaNull);
+    REGISTER_GLOBAL_MOCK_RETURN(hmacResult, shaSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(hmacResult, shaNull);
+
+    REGISTER_GLOBAL_MOCK_RETURN(STRING_concat, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat, __LINE__);
+    REGISTER_GLOBAL_MOCK_RETURN(STRING_concat_with_STRING, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat_with_STRING, __LINE__);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
+
     REGISTER_GLOBAL_MOCK_RETURN(STRING_c_str, TEST_STRING_VALUE);
     REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
     REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, my_STRING_construct);
@@ -145,6 +213,10 @@ TEST_FUNCTION_INITIALIZE(method_init)
         ASSERT_FAIL("Could not acquire test serialization mutex.");
     }
     umock_c_reset_all_calls();
+    g_hmac_sha256_count = 0;
+    g_hmac_sha256_context = NULL;
+    g_hmac_sha256_data_length = 0;
+    g_hmac_sha256_result = 0;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -162,11 +234,83 @@ static void setup_IoTHubClient_Auth_Create_mocks(bool device_key)
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, DEVICE_ID));
 }
 
-static void setup_IoTHubClient_Auth_Get_ConnString_mocks()
+static void setup_IoTHubClient_Auth_Get_ConnString_mocks(bool create_signing_context)
 {
     STRICT_EXPECTED_CALL(get_time(NULL));
     STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(SASToken_CreateString(IGNORED_PTR_ARG, SCOPE_NAME, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    if (create_signing_context)
+    {
+        STRICT_EXPECTED_CALL(Base64_Decoder(DEVICE_KEY));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(hmacReset(IGNORED_PTR_ARG, SHA256, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(size_tToString(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(hmacInput(IGNORED_PTR_ARG, IGNORED_PTR_ARG, (int)strlen(SCOPE_NAME)));
+    STRICT_EXPECTED_CALL(hmacInput(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(hmacInput(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(hmacResult(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, SHA256HashSize));
+    STRICT_EXPECTED_CALL(URL_Encode(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_construct("SharedAccessSignature sr="));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, SCOPE_NAME));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&sig="));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&se="));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&skn="));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, ""));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+}
+
+static size_t g_hmac_sha256_count;
+static void* g_hmac_sha256_context;
+static size_t g_hmac_sha256_data_length;
+static int g_hmac_sha256_result;
+
+static int test_hmac_sha256(void* context, const unsigned char* key, size_t keyLength, const unsigned char* data, size_t dataLength, unsigned char* digest)
+{
+    (void)key;
+    (void)keyLength;
+    (void)data;
+    g_hmac_sha256_count++;
+    g_hmac_sha256_context = context;
+    g_hmac_sha256_data_length = dataLength;
+    (void)memset(digest, 0x5A, SHA256HashSize);
+    return g_hmac_sha256_result;
+}
+
+static void setup_IoTHubClient_Auth_Get_ConnString_crypto_provider_mocks(bool decode_key)
+{
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    if (decode_key)
+    {
+        STRICT_EXPECTED_CALL(Base64_Decoder(DEVICE_KEY));
+    }
+    STRICT_EXPECTED_CALL(size_tToString(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, SHA256HashSize));
+    STRICT_EXPECTED_CALL(URL_Encode(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_construct("SharedAccessSignature sr="));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, SCOPE_NAME));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&sig="));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&se="));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&skn="));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, ""));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
@@ -359,6 +503,30 @@ TEST_FUNCTION(IoTHubClient_Auth_Destroy_succeed)
     //cleanup
 }
 
+/* Tests_SRS_IoTHub_Authorization_41_003: [ IoTHubClient_Auth_Destroy shall clear the signing context before freeing it. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Destroy_with_signing_context_succeed)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+    free(conn_string);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+
+    //act
+    IoTHubClient_Auth_Destroy(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
 TEST_FUNCTION(IoTHubClient_Auth_Set_x509_Type_do_nothing)
 {
     //arrange
@@ -477,7 +645,8 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_scope_NULL_fail)
 }
 
 /* Codes_SRS_IoTHub_Authorization_07_010: [ IoTHubClient_Auth_Get_ConnString shall construct the expiration time using the expire_time. ] */
-/* Codes_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall call SASToken_CreateString to construct the sas token. ] */
+/* Tests_SRS_IoTHub_Authorization_41_001: [ The first time IoTHubClient_Auth_Get_SasToken signs a token it shall base64 decode the device key and key an HMAC-SHA256 signing context with it, kept for the tokens after it. ] */
+/* Codes_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall construct the sas token. ] */
 /* Codes_SRS_IoTHub_Authorization_07_012: [ On success IoTHubClient_Auth_Get_ConnString shall allocate and return the sas token in a char*. ] */
 TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_succeed)
 {
@@ -485,12 +654,94 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_succeed)
     IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
     umock_c_reset_all_calls();
 
-    setup_IoTHubClient_Auth_Get_ConnString_mocks();
+    setup_IoTHubClient_Auth_Get_ConnString_mocks(true);
+
+    //act
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+
+    //assert
+    ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(conn_string);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_001: [ The first time IoTHubClient_Auth_Get_SasToken signs a token it shall base64 decode the device key and key an HMAC-SHA256 signing context with it, kept for the tokens after it. ] */
+/* Tests_SRS_IoTHub_Authorization_41_002: [ IoTHubClient_Auth_Get_SasToken shall sign the scope and expiry with a copy of the signing context, leaving the signing context unchanged. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_reuses_signing_context_succeed)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
+    char* first_conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+    umock_c_reset_all_calls();
+
+    setup_IoTHubClient_Auth_Get_ConnString_mocks(false);
 
     //act
     char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
 
     //assert
+    ASSERT_IS_NOT_NULL(first_conn_string);
+    ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(first_conn_string);
+    free(conn_string);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_decode_key_fail)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Base64_Decoder(DEVICE_KEY))
+        .SetReturn(NULL);
+
+    //act
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+
+    //assert
+    ASSERT_IS_NULL(conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
+/* Tests_SRS_IoTHub_Authorization_41_001: [ The first time IoTHubClient_Auth_Get_SasToken signs a token it shall base64 decode the device key and key an HMAC-SHA256 signing context with it, kept for the tokens after it. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_hmacReset_fail_retries_signing_context)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Base64_Decoder(DEVICE_KEY));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hmacReset(IGNORED_PTR_ARG, SHA256, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(shaNull);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    setup_IoTHubClient_Auth_Get_ConnString_mocks(true);
+
+    //act
+    char* failed_conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+
+    //assert
+    ASSERT_IS_NULL(failed_conn_string);
     ASSERT_IS_NOT_NULL(conn_string);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
@@ -504,16 +755,18 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_fail)
 {
     //arrange
     IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
+    char* first_conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+    free(first_conn_string);
     umock_c_reset_all_calls();
 
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-    setup_IoTHubClient_Auth_Get_ConnString_mocks();
+    setup_IoTHubClient_Auth_Get_ConnString_mocks(false);
 
     umock_c_negative_tests_snapshot();
 
-    size_t calls_cannot_fail[] = { 1, 3, 5 };
+    size_t calls_cannot_fail[] = { 1, 17, 18, 19, 21 };
 
     //act
     size_t count = umock_c_negative_tests_call_count();
@@ -664,4 +917,141 @@ TEST_FUNCTION(IoTHubClient_Auth_Is_SasToken_Valid_sas_token_succeed)
     IoTHubClient_Auth_Destroy(handle);
 }
 
+/* Tests_SRS_IoTHub_Authorization_41_004: [ if handle is NULL, IoTHubClient_Auth_Set_Crypto_Provider shall fail and return a non-zero value. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Set_Crypto_Provider_handle_NULL_fail)
+{
+    //arrange
+    IOTHUB_CRYPTO_PROVIDER crypto_provider = { test_hmac_sha256, (void*)0x4242 };
+
+    //act
+    int result = IoTHubClient_Auth_Set_Crypto_Provider(NULL, &crypto_provider);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_005: [ While a crypto provider is set, IoTHubClient_Auth_Get_SasToken shall sign the scope and expiry with its hmacSha256, given its context and the decoded device key, instead of the signing context. ] */
+/* Tests_SRS_IoTHub_Authorization_41_006: [ The first time IoTHubClient_Auth_Get_SasToken signs a token with a crypto provider it shall base64 decode the device key, kept for the tokens after it, instead of keying a signing context. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_with_crypto_provider_succeed)
+{
+    //arrange
+    IOTHUB_CRYPTO_PROVIDER crypto_provider = { test_hmac_sha256, (void*)0x4242 };
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
+    int set_result = IoTHubClient_Auth_Set_Crypto_Provider(handle, &crypto_provider);
+    umock_c_reset_all_calls();
+
+    setup_IoTHubClient_Auth_Get_ConnString_crypto_provider_mocks(true);
+    setup_IoTHubClient_Auth_Get_ConnString_crypto_provider_mocks(false);
+
+    //act
+    char* first_sas_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+    char* sas_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, set_result);
+    ASSERT_IS_NOT_NULL(first_sas_token);
+    ASSERT_IS_NOT_NULL(sas_token);
+    ASSERT_ARE_EQUAL(size_t, 2, g_hmac_sha256_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x4242, g_hmac_sha256_context);
+    ASSERT_IS_TRUE(g_hmac_sha256_data_length > strlen(SCOPE_NAME) + 1);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(first_sas_token);
+    free(sas_token);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_005: [ While a crypto provider is set, IoTHubClient_Auth_Get_SasToken shall sign the scope and expiry with its hmacSha256, given its context and the decoded device key, instead of the signing context. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_crypto_provider_fails)
+{
+    //arrange
+    IOTHUB_CRYPTO_PROVIDER crypto_provider = { test_hmac_sha256, NULL };
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
+    (void)IoTHubClient_Auth_Set_Crypto_Provider(handle, &crypto_provider);
+    g_hmac_sha256_result = __LINE__;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Base64_Decoder(DEVICE_KEY));
+    STRICT_EXPECTED_CALL(size_tToString(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+
+    //act
+    char* sas_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+
+    //assert
+    ASSERT_IS_NULL(sas_token);
+    ASSERT_ARE_EQUAL(size_t, 1, g_hmac_sha256_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_008: [ IoTHubClient_Auth_Set_Crypto_Provider shall keep a copy of crypto_provider, none when it is NULL or has no hmacSha256, clear the decoded device key it kept for the previous one and return 0. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Set_Crypto_Provider_NULL_signs_in_software_succeed)
+{
+    //arrange
+    IOTHUB_CRYPTO_PROVIDER crypto_provider = { test_hmac_sha256, NULL };
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
+    (void)IoTHubClient_Auth_Set_Crypto_Provider(handle, &crypto_provider);
+    char* first_sas_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    setup_IoTHubClient_Auth_Get_ConnString_mocks(true);
+
+    //act
+    int result = IoTHubClient_Auth_Set_Crypto_Provider(handle, NULL);
+    char* sas_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(first_sas_token);
+    ASSERT_IS_NOT_NULL(sas_token);
+    ASSERT_ARE_EQUAL(size_t, 1, g_hmac_sha256_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(first_sas_token);
+    free(sas_token);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_007: [ IoTHubClient_Auth_Destroy shall clear the decoded device key kept for the crypto provider before freeing it. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Destroy_with_crypto_provider_succeed)
+{
+    //arrange
+    IOTHUB_CRYPTO_PROVIDER crypto_provider = { test_hmac_sha256, NULL };
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL);
+    (void)IoTHubClient_Auth_Set_Crypto_Provider(handle, &crypto_provider);
+    char* sas_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME);
+    free(sas_token);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
+
+    //act
+    IoTHubClient_Auth_Destroy(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
 END_TEST_SUITE(iothub_client_authorization_ut)
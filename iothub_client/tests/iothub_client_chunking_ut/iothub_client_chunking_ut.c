@@ -0,0 +1,377 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/uniqueid.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_chunking.h"
+
+#define TEST_MESSAGE_HANDLE     (IOTHUB_MESSAGE_HANDLE)0x41
+#define TEST_CHUNK_HANDLE       (IOTHUB_MESSAGE_HANDLE)0x42
+#define TEST_MAP_HANDLE         (MAP_HANDLE)0x43
+#define TEST_CHUNK_ID           "chunk_id"
+#define TEST_MESSAGE_ID         "message_id"
+#define TEST_PAYLOAD            "0123456789"
+#define TEST_PAYLOAD_SIZE       10
+
+static const unsigned char* g_payload = (const unsigned char*)TEST_PAYLOAD;
+static size_t g_payloadSize = TEST_PAYLOAD_SIZE;
+
+static void setup_payload(void)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_BYTEARRAY);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_buffer(&g_payload, sizeof(g_payload))
+        .CopyOutArgumentBuffer_size(&g_payloadSize, sizeof(g_payloadSize));
+}
+
+static void setup_properties(const char* index, const char* count)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_CHUNK_HANDLE));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, CHUNKING_ID_PROPERTY, TEST_CHUNK_ID));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, CHUNKING_INDEX_PROPERTY, index));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, CHUNKING_TOTAL_PROPERTY, count));
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_chunking_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(UNIQUEID_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromPrototype, TEST_CHUNK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromPrototype, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Properties, TEST_MAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_Properties, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_AddOrUpdate, MAP_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(UniqueId_Generate, UNIQUEID_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(UniqueId_Generate, UNIQUEID_ERROR);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_001: [ If message is NULL, maxChunkSize is 0 or the payload of message cannot be read, chunking_get_chunk_count shall return 0. ]*/
+TEST_FUNCTION(chunking_get_chunk_count_with_invalid_arguments_returns_0)
+{
+    //arrange
+
+    //act
+    size_t result1 = chunking_get_chunk_count(NULL, 4);
+    size_t result2 = chunking_get_chunk_count(TEST_MESSAGE_HANDLE, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, result1);
+    ASSERT_ARE_EQUAL(size_t, 0, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_001: [ If message is NULL, maxChunkSize is 0 or the payload of message cannot be read, chunking_get_chunk_count shall return 0. ]*/
+TEST_FUNCTION(chunking_get_chunk_count_returns_0_when_the_payload_cannot_be_read)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn(NULL);
+
+    //act
+    size_t result = chunking_get_chunk_count(TEST_MESSAGE_HANDLE, 4);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_002: [ Otherwise chunking_get_chunk_count shall return the number of chunks of at most maxChunkSize bytes of the payload, 1 for an empty payload. ]*/
+TEST_FUNCTION(chunking_get_chunk_count_rounds_up)
+{
+    //arrange
+    setup_payload();
+    setup_payload();
+    setup_payload();
+
+    //act
+    size_t result1 = chunking_get_chunk_count(TEST_MESSAGE_HANDLE, 4);
+    size_t result2 = chunking_get_chunk_count(TEST_MESSAGE_HANDLE, 5);
+    size_t result3 = chunking_get_chunk_count(TEST_MESSAGE_HANDLE, 100);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 3, result1);
+    ASSERT_ARE_EQUAL(size_t, 2, result2);
+    ASSERT_ARE_EQUAL(size_t, 1, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_002: [ Otherwise chunking_get_chunk_count shall return the number of chunks of at most maxChunkSize bytes of the payload, 1 for an empty payload. ]*/
+TEST_FUNCTION(chunking_get_chunk_count_of_an_empty_string_is_1)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn("");
+
+    //act
+    size_t result = chunking_get_chunk_count(TEST_MESSAGE_HANDLE, 4);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_003: [ If message or generatedId is NULL, chunking_get_chunk_id shall fail and return NULL. ]*/
+TEST_FUNCTION(chunking_get_chunk_id_with_NULL_arguments_fails)
+{
+    //arrange
+    char generatedId[CHUNKING_GENERATED_ID_SIZE];
+
+    //act
+    const char* result1 = chunking_get_chunk_id(NULL, generatedId);
+    const char* result2 = chunking_get_chunk_id(TEST_MESSAGE_HANDLE, NULL);
+
+    //assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_004: [ chunking_get_chunk_id shall return the message id of message if it has one. ]*/
+TEST_FUNCTION(chunking_get_chunk_id_returns_the_message_id)
+{
+    //arrange
+    char generatedId[CHUNKING_GENERATED_ID_SIZE];
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE))
+        .SetReturn(TEST_MESSAGE_ID);
+
+    //act
+    const char* result = chunking_get_chunk_id(TEST_MESSAGE_HANDLE, generatedId);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_005: [ Otherwise chunking_get_chunk_id shall generate a UUID in generatedId with UniqueId_Generate and return generatedId, NULL if it fails. ]*/
+TEST_FUNCTION(chunking_get_chunk_id_generates_an_id_without_message_id)
+{
+    //arrange
+    char generatedId[CHUNKING_GENERATED_ID_SIZE];
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(UniqueId_Generate(generatedId, CHUNKING_GENERATED_ID_SIZE));
+
+    //act
+    const char* result = chunking_get_chunk_id(TEST_MESSAGE_HANDLE, generatedId);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, generatedId, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_005: [ Otherwise chunking_get_chunk_id shall generate a UUID in generatedId with UniqueId_Generate and return generatedId, NULL if it fails. ]*/
+TEST_FUNCTION(chunking_get_chunk_id_fails_when_UniqueId_Generate_fails)
+{
+    //arrange
+    char generatedId[CHUNKING_GENERATED_ID_SIZE];
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(UniqueId_Generate(generatedId, CHUNKING_GENERATED_ID_SIZE))
+        .SetReturn(UNIQUEID_ERROR);
+
+    //act
+    const char* result = chunking_get_chunk_id(TEST_MESSAGE_HANDLE, generatedId);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_006: [ If message or chunkId is NULL, maxChunkSize is 0 or index is not less than count, chunking_create_chunk shall fail and return NULL. ]*/
+TEST_FUNCTION(chunking_create_chunk_with_invalid_arguments_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result1 = chunking_create_chunk(NULL, TEST_CHUNK_ID, 4, 0, 3);
+    IOTHUB_MESSAGE_HANDLE result2 = chunking_create_chunk(TEST_MESSAGE_HANDLE, NULL, 4, 0, 3);
+    IOTHUB_MESSAGE_HANDLE result3 = chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, 0, 0, 3);
+    IOTHUB_MESSAGE_HANDLE result4 = chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, 4, 3, 3);
+
+    //assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_006: [ If message or chunkId is NULL, maxChunkSize is 0 or index is not less than count, chunking_create_chunk shall fail and return NULL. ]*/
+TEST_FUNCTION(chunking_create_chunk_past_the_payload_fails)
+{
+    //arrange
+    setup_payload();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, 4, 3, 4);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_007: [ chunking_create_chunk shall create the chunk with IoTHubMessage_CreateFromPrototype, with the bytes of the payload of message from index times maxChunkSize, at most maxChunkSize of them, and the properties of message. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_008: [ chunking_create_chunk shall set the application properties chunk-id to chunkId, chunk-index to index and chunk-total to count, in decimal, of the chunk, the properties of message being left as they are. ]*/
+TEST_FUNCTION(chunking_create_chunk_makes_a_middle_chunk)
+{
+    //arrange
+    setup_payload();
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromPrototype(TEST_MESSAGE_HANDLE, g_payload + 4, 4))
+        .ValidateArgumentBuffer(2, TEST_PAYLOAD + 4, 4);
+    setup_properties("1", "3");
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, 4, 1, 3);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CHUNK_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_007: [ chunking_create_chunk shall create the chunk with IoTHubMessage_CreateFromPrototype, with the bytes of the payload of message from index times maxChunkSize, at most maxChunkSize of them, and the properties of message. ]*/
+TEST_FUNCTION(chunking_create_chunk_makes_a_shorter_last_chunk)
+{
+    //arrange
+    setup_payload();
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromPrototype(TEST_MESSAGE_HANDLE, g_payload + 8, 2))
+        .ValidateArgumentBuffer(2, TEST_PAYLOAD + 8, 2);
+    setup_properties("2", "3");
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, 4, 2, 3);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CHUNK_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CHUNKING_41_009: [ If any error occurs, chunking_create_chunk shall fail and return NULL. ]*/
+TEST_FUNCTION(chunking_create_chunk_fails_when_any_call_fails)
+{
+    //arrange
+    size_t i;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    setup_payload();
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromPrototype(TEST_MESSAGE_HANDLE, g_payload + 4, 4));
+    setup_properties("1", "3");
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        /*IoTHubMessage_GetContentType cannot fail*/
+        if (i == 0)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        //act
+        IOTHUB_MESSAGE_HANDLE result = chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, 4, 1, 3);
+
+        //assert
+        ASSERT_IS_NULL(result);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+END_TEST_SUITE(iothub_client_chunking_ut)
@@ -0,0 +1,625 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xio.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_options.h"
+#include "iothub_client_coalescing_io.h"
+
+#define TEST_UNDERLYING_IO                  (XIO_HANDLE)0x41
+#define TEST_UNDERLYING_OPTIONHANDLER       (OPTIONHANDLER_HANDLE)0x45
+#define TEST_OPTION_NAME                    "TrustedCerts"
+#define TEST_OPTION_VALUE                   (const void*)0x46
+#define TEST_BUFFER_SIZE                    64
+#define TEST_MAX_SENDS                      8
+
+/*the underlying IO is mocked: what it is given to send is kept, and its send callback kept for the test to call*/
+static unsigned char g_sent[TEST_BUFFER_SIZE * 4];
+static size_t g_sent_size;
+static size_t g_underlying_send_count;
+static ON_SEND_COMPLETE g_underlying_on_send_complete;
+static void* g_underlying_callback_context;
+static size_t g_on_io_error_count;
+static size_t g_completed_count;
+static int g_completed_contexts[TEST_MAX_SENDS];
+static IO_SEND_RESULT g_completed_results[TEST_MAX_SENDS];
+static int g_contexts[TEST_MAX_SENDS] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+static int my_xio_send(XIO_HANDLE xio, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    (void)xio;
+    if (g_sent_size + size <= sizeof(g_sent))
+    {
+        (void)memcpy(g_sent + g_sent_size, buffer, size);
+        g_sent_size += size;
+    }
+    g_underlying_send_count++;
+    g_underlying_on_send_complete = on_send_complete;
+    g_underlying_callback_context = callback_context;
+    return 0;
+}
+
+static void test_on_io_error(void* context)
+{
+    (void)context;
+    g_on_io_error_count++;
+}
+
+static void test_on_send_complete(void* context, IO_SEND_RESULT send_result)
+{
+    if (g_completed_count < TEST_MAX_SENDS)
+    {
+        g_completed_contexts[g_completed_count] = *(int*)context;
+        g_completed_results[g_completed_count] = send_result;
+    }
+    g_completed_count++;
+}
+
+static const IO_INTERFACE_DESCRIPTION* coalescing_io(void)
+{
+    return coalescing_io_get_interface_description();
+}
+
+static CONCRETE_IO_HANDLE create_and_open(void)
+{
+    COALESCING_IO_CONFIG config = { TEST_UNDERLYING_IO, TEST_BUFFER_SIZE };
+    CONCRETE_IO_HANDLE result = coalescing_io()->concrete_io_create(&config);
+    (void)coalescing_io()->concrete_io_open(result, NULL, NULL, NULL, NULL, test_on_io_error, NULL);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static int cork(CONCRETE_IO_HANDLE io, bool is_corked)
+{
+    return coalescing_io()->concrete_io_setoption(io, COALESCING_IO_OPTION_CORK, &is_corked);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_coalescing_io_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_OPEN_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_CLOSE_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_ERROR, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_BYTES_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SEND_COMPLETE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(xio_open, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(xio_send, my_xio_send);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(xio_send, __LINE__);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_setoption, 0);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_close, 0);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_retrieveoptions, TEST_UNDERLYING_OPTIONHANDLER);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    g_sent_size = 0;
+    g_underlying_send_count = 0;
+    g_underlying_on_send_complete = NULL;
+    g_underlying_callback_context = NULL;
+    g_on_io_error_count = 0;
+    g_completed_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_001: [ If io_create_parameters or its underlying_io is NULL, or its buffer_size is 0, coalescing_io_create shall fail and return NULL. ]*/
+TEST_FUNCTION(coalescing_io_create_with_invalid_parameters_fails)
+{
+    //arrange
+    COALESCING_IO_CONFIG no_io = { NULL, TEST_BUFFER_SIZE };
+    COALESCING_IO_CONFIG no_size = { TEST_UNDERLYING_IO, 0 };
+
+    //act
+    CONCRETE_IO_HANDLE result_NULL = coalescing_io()->concrete_io_create(NULL);
+    CONCRETE_IO_HANDLE result_io = coalescing_io()->concrete_io_create(&no_io);
+    CONCRETE_IO_HANDLE result_size = coalescing_io()->concrete_io_create(&no_size);
+
+    //assert
+    ASSERT_IS_NULL(result_NULL);
+    ASSERT_IS_NULL(result_io);
+    ASSERT_IS_NULL(result_size);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_002: [ coalescing_io_create shall return an uncorked IO over underlying_io, without allocating its buffer. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_003: [ coalescing_io_create shall set OPTION_XIO_TCP_NODELAY to true on underlying_io, a failure being ignored. ]*/
+TEST_FUNCTION(coalescing_io_create_disables_nagle_on_the_underlying_io)
+{
+    //arrange
+    COALESCING_IO_CONFIG config = { TEST_UNDERLYING_IO, TEST_BUFFER_SIZE };
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_UNDERLYING_IO, OPTION_XIO_TCP_NODELAY, IGNORED_PTR_ARG))
+        .SetReturn(__LINE__);
+
+    //act
+    CONCRETE_IO_HANDLE result = coalescing_io()->concrete_io_create(&config);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(result);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_001: [ If io_create_parameters or its underlying_io is NULL, or its buffer_size is 0, coalescing_io_create shall fail and return NULL. ]*/
+TEST_FUNCTION(coalescing_io_create_fails_when_malloc_fails)
+{
+    //arrange
+    COALESCING_IO_CONFIG config = { TEST_UNDERLYING_IO, TEST_BUFFER_SIZE };
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    CONCRETE_IO_HANDLE result = coalescing_io()->concrete_io_create(&config);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_004: [ If coalescing_io is NULL, coalescing_io_destroy shall do nothing, otherwise it shall call the callbacks of the sends still held with IO_SEND_CANCELLED and free the instance, leaving the underlying IO to its owner. ]*/
+TEST_FUNCTION(coalescing_io_destroy_cancels_the_sends_held)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)cork(io, true);
+    (void)coalescing_io()->concrete_io_send(io, "abc", 3, test_on_send_complete, &g_contexts[0]);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(io));
+
+    //act
+    coalescing_io()->concrete_io_destroy(io);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_underlying_send_count);
+    ASSERT_ARE_EQUAL(size_t, 1, g_completed_count);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_CANCELLED, (int)g_completed_results[0]);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_005: [ coalescing_io_open shall uncork the IO and open the underlying IO with xio_open and the callbacks it was given. ]*/
+TEST_FUNCTION(coalescing_io_open_opens_the_underlying_io)
+{
+    //arrange
+    COALESCING_IO_CONFIG config = { TEST_UNDERLYING_IO, TEST_BUFFER_SIZE };
+    CONCRETE_IO_HANDLE io = coalescing_io()->concrete_io_create(&config);
+    int result;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_open(TEST_UNDERLYING_IO, NULL, NULL, NULL, NULL, test_on_io_error, NULL));
+
+    //act
+    result = coalescing_io()->concrete_io_open(io, NULL, NULL, NULL, NULL, test_on_io_error, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_007: [ While uncorked, coalescing_io_send shall send with xio_send on the underlying IO. ]*/
+TEST_FUNCTION(coalescing_io_send_while_uncorked_goes_to_the_underlying_io)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, 3, test_on_send_complete, &g_contexts[0]));
+
+    //act
+    int result = coalescing_io()->concrete_io_send(io, "abc", 3, test_on_send_complete, &g_contexts[0]);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_009: [ A send of buffer_size bytes or more shall then be sent with xio_send on the underlying IO, any other shall be copied to the buffer, held with its callback, and coalescing_io_send shall return 0. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_014: [ If optionName is COALESCING_IO_OPTION_CORK and value is true, coalescing_io_setoption shall cork the IO and return 0. ]*/
+TEST_FUNCTION(coalescing_io_send_while_corked_holds_the_bytes)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    int result_cork = cork(io, true);
+    STRICT_EXPECTED_CALL(gballoc_malloc(TEST_BUFFER_SIZE));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+
+    //act
+    int result_first = coalescing_io()->concrete_io_send(io, "abc", 3, test_on_send_complete, &g_contexts[0]);
+    int result_second = coalescing_io()->concrete_io_send(io, "de", 2, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result_cork);
+    ASSERT_ARE_EQUAL(int, 0, result_first);
+    ASSERT_ARE_EQUAL(int, 0, result_second);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_underlying_send_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_completed_count);
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_010: [ A flush shall send the bytes held to the underlying IO with one xio_send. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_015: [ If optionName is COALESCING_IO_OPTION_CORK and value is false, coalescing_io_setoption shall flush the bytes held, uncork the IO and return whether the flush succeeded. ]*/
+TEST_FUNCTION(coalescing_io_uncork_sends_the_bytes_held_in_one_write)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)cork(io, true);
+    (void)coalescing_io()->concrete_io_send(io, "abc", 3, test_on_send_complete, &g_contexts[0]);
+    (void)coalescing_io()->concrete_io_send(io, "de", 2, NULL, NULL);
+    (void)coalescing_io()->concrete_io_send(io, "f", 1, test_on_send_complete, &g_contexts[1]);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, 6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    int result = cork(io, false);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_underlying_send_count);
+    ASSERT_ARE_EQUAL(int, 0, memcmp("abcdef", g_sent, 6));
+    ASSERT_ARE_EQUAL(size_t, 0, g_completed_count);
+
+    //cleanup
+    g_underlying_on_send_complete(g_underlying_callback_context, IO_SEND_OK);
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_011: [ When the underlying IO completes the write, the callbacks of all the sends it holds shall be called with its result, in the order of the sends. ]*/
+TEST_FUNCTION(coalescing_io_write_complete_completes_the_sends_in_order)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)cork(io, true);
+    (void)coalescing_io()->concrete_io_send(io, "abc", 3, test_on_send_complete, &g_contexts[0]);
+    (void)coalescing_io()->concrete_io_send(io, "de", 2, test_on_send_complete, &g_contexts[1]);
+    (void)coalescing_io()->concrete_io_send(io, "f", 1, test_on_send_complete, &g_contexts[2]);
+    (void)cork(io, false);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    g_underlying_on_send_complete(g_underlying_callback_context, IO_SEND_OK);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 3, g_completed_count);
+    ASSERT_ARE_EQUAL(int, 0, g_completed_contexts[0]);
+    ASSERT_ARE_EQUAL(int, 1, g_completed_contexts[1]);
+    ASSERT_ARE_EQUAL(int, 2, g_completed_contexts[2]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_OK, (int)g_completed_results[2]);
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_010: [ A flush shall send the bytes held to the underlying IO with one xio_send. ]*/
+TEST_FUNCTION(coalescing_io_uncork_without_callbacks_sends_without_a_callback)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)cork(io, true);
+    (void)coalescing_io()->concrete_io_send(io, "abc", 3, NULL, NULL);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, 3, NULL, NULL));
+
+    //act
+    int result = cork(io, false);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_015: [ If optionName is COALESCING_IO_OPTION_CORK and value is false, coalescing_io_setoption shall flush the bytes held, uncork the IO and return whether the flush succeeded. ]*/
+TEST_FUNCTION(coalescing_io_uncork_with_nothing_held_sends_nothing)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)cork(io, true);
+    umock_c_reset_all_calls();
+
+    //act
+    int result = cork(io, false);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_008: [ While corked, coalescing_io_send shall flush first if the bytes held and size exceed buffer_size, and fail if that flush fails. ]*/
+TEST_FUNCTION(coalescing_io_send_that_does_not_fit_flushes_first)
+{
+    //arrange
+    unsigned char payload[TEST_BUFFER_SIZE - 1];
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)memset(payload, 'x', sizeof(payload));
+    (void)cork(io, true);
+    (void)coalescing_io()->concrete_io_send(io, "abc", 3, NULL, NULL);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, 3, NULL, NULL));
+
+    //act
+    int result = coalescing_io()->concrete_io_send(io, payload, sizeof(payload), NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_underlying_send_count);
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_009: [ A send of buffer_size bytes or more shall then be sent with xio_send on the underlying IO, any other shall be copied to the buffer, held with its callback, and coalescing_io_send shall return 0. ]*/
+TEST_FUNCTION(coalescing_io_send_larger_than_the_buffer_goes_to_the_underlying_io_after_the_bytes_held)
+{
+    //arrange
+    unsigned char payload[TEST_BUFFER_SIZE * 2];
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)memset(payload, 'x', sizeof(payload));
+    (void)cork(io, true);
+    (void)coalescing_io()->concrete_io_send(io, "abc", 3, NULL, NULL);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, 3, NULL, NULL));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(payload), test_on_send_complete, &g_contexts[0]));
+
+    //act
+    int result = coalescing_io()->concrete_io_send(io, payload, sizeof(payload), test_on_send_complete, &g_contexts[0]);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp("abc", g_sent, 3));
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_012: [ If the flush fails, the callbacks of the sends held shall be called with IO_SEND_ERROR and the on_io_error of the open shall be called. ]*/
+TEST_FUNCTION(coalescing_io_uncork_fails_when_the_write_fails)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)cork(io, true);
+    (void)coalescing_io()->concrete_io_send(io, "abc", 3, test_on_send_complete, &g_contexts[0]);
+    (void)coalescing_io()->concrete_io_send(io, "de", 2, test_on_send_complete, &g_contexts[1]);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, 5, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(__LINE__);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    int result = cork(io, false);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, g_completed_count);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_ERROR, (int)g_completed_results[0]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_ERROR, (int)g_completed_results[1]);
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_io_error_count);
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_008: [ While corked, coalescing_io_send shall flush first if the bytes held and size exceed buffer_size, and fail if that flush fails. ]*/
+TEST_FUNCTION(coalescing_io_send_fails_when_the_flush_first_fails)
+{
+    //arrange
+    unsigned char payload[TEST_BUFFER_SIZE - 1];
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)memset(payload, 'x', sizeof(payload));
+    (void)cork(io, true);
+    (void)coalescing_io()->concrete_io_send(io, "abc", 3, NULL, NULL);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, 3, NULL, NULL))
+        .SetReturn(__LINE__);
+
+    //act
+    int result = coalescing_io()->concrete_io_send(io, payload, sizeof(payload), test_on_send_complete, &g_contexts[0]);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_completed_count);
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_io_error_count);
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_006: [ coalescing_io_close shall flush the bytes held, uncork the IO and close the underlying IO with xio_close. ]*/
+TEST_FUNCTION(coalescing_io_close_flushes_and_closes_the_underlying_io)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    (void)cork(io, true);
+    (void)coalescing_io()->concrete_io_send(io, "abc", 3, NULL, NULL);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, 3, NULL, NULL));
+    STRICT_EXPECTED_CALL(xio_close(TEST_UNDERLYING_IO, NULL, NULL));
+
+    //act
+    int result = coalescing_io()->concrete_io_close(io, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_013: [ coalescing_io_dowork shall call xio_dowork on the underlying IO. ]*/
+TEST_FUNCTION(coalescing_io_dowork_goes_to_the_underlying_io)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    STRICT_EXPECTED_CALL(xio_dowork(TEST_UNDERLYING_IO));
+
+    //act
+    coalescing_io()->concrete_io_dowork(io);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_014: [ If optionName is COALESCING_IO_OPTION_CORK and value is true, coalescing_io_setoption shall cork the IO and return 0. ]*/
+TEST_FUNCTION(coalescing_io_setoption_cork_with_NULL_value_fails)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+
+    //act
+    int result = coalescing_io()->concrete_io_setoption(io, COALESCING_IO_OPTION_CORK, NULL);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_016: [ Any other option shall be given to the underlying IO with xio_setoption. ]*/
+TEST_FUNCTION(coalescing_io_setoption_gives_other_options_to_the_underlying_io)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_UNDERLYING_IO, TEST_OPTION_NAME, TEST_OPTION_VALUE));
+
+    //act
+    int result = coalescing_io()->concrete_io_setoption(io, TEST_OPTION_NAME, TEST_OPTION_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_017: [ coalescing_io_retrieveoptions shall return the options of the underlying IO with xio_retrieveoptions. ]*/
+TEST_FUNCTION(coalescing_io_retrieveoptions_returns_the_underlying_options)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open();
+    STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO));
+
+    //act
+    OPTIONHANDLER_HANDLE result = coalescing_io()->concrete_io_retrieveoptions(io);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_UNDERLYING_OPTIONHANDLER, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    coalescing_io()->concrete_io_destroy(io);
+}
+
+END_TEST_SUITE(iothub_client_coalescing_io_ut)
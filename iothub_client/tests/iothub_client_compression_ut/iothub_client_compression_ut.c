@@ -0,0 +1,427 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#include "zlib.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_compression.h"
+
+#define TEST_MESSAGE_HANDLE             (IOTHUB_MESSAGE_HANDLE)0x41
+#define TEST_COMPRESSED_MESSAGE_HANDLE  (IOTHUB_MESSAGE_HANDLE)0x42
+#define TEST_MAP_HANDLE                 (MAP_HANDLE)0x43
+#define TEST_LEVEL                      6
+#define TEST_PAYLOAD_SIZE               1000
+
+/*zlib is not mocked, the payloads are really deflated and the prototype hook inflates them back*/
+static char g_payload[TEST_PAYLOAD_SIZE + 1];
+static unsigned char g_inflated[TEST_PAYLOAD_SIZE + 1];
+static size_t g_inflatedSize;
+static size_t g_compressedSize;
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromPrototype(IOTHUB_MESSAGE_HANDLE prototype, const unsigned char* byteArray, size_t size)
+{
+    z_stream stream;
+    (void)prototype;
+    (void)memset(&stream, 0, sizeof(stream));
+    g_compressedSize = size;
+    if (inflateInit2(&stream, 15 + 16) != Z_OK)
+    {
+        g_inflatedSize = 0;
+    }
+    else
+    {
+        stream.next_in = (Bytef*)byteArray;
+        stream.avail_in = (uInt)size;
+        stream.next_out = g_inflated;
+        stream.avail_out = (uInt)sizeof(g_inflated);
+        g_inflatedSize = (inflate(&stream, Z_FINISH) == Z_STREAM_END) ? (size_t)stream.total_out : 0;
+        (void)inflateEnd(&stream);
+    }
+    return TEST_COMPRESSED_MESSAGE_HANDLE;
+}
+
+static void setup_payload(const char* payload)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn(payload);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_compression_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromPrototype, my_IoTHubMessage_CreateFromPrototype);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Properties, TEST_MAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_AddOrUpdate, MAP_ERROR);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    /*a payload that deflates well*/
+    (void)memset(g_payload, 'a', TEST_PAYLOAD_SIZE);
+    g_payload[TEST_PAYLOAD_SIZE] = '\0';
+    g_inflatedSize = 0;
+    g_compressedSize = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_001: [ If level is not between 1 and 9, compressor_create shall fail and return NULL. ]*/
+TEST_FUNCTION(compressor_create_with_level_0_fails)
+{
+    //arrange
+
+    //act
+    COMPRESSOR_HANDLE result = compressor_create(0);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_001: [ If level is not between 1 and 9, compressor_create shall fail and return NULL. ]*/
+TEST_FUNCTION(compressor_create_with_level_10_fails)
+{
+    //arrange
+
+    //act
+    COMPRESSOR_HANDLE result = compressor_create(10);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_002: [ compressor_create shall initialize a deflate stream writing gzip with level and return a non-NULL handle. ]*/
+TEST_FUNCTION(compressor_create_succeeds)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    COMPRESSOR_HANDLE result = compressor_create(TEST_LEVEL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    compressor_destroy(result);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_003: [ If any error occurs, compressor_create shall fail and return NULL. ]*/
+TEST_FUNCTION(compressor_create_fails_when_malloc_fails)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    COMPRESSOR_HANDLE result = compressor_create(TEST_LEVEL);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_004: [ If compressor is NULL, compressor_destroy shall do nothing. ]*/
+TEST_FUNCTION(compressor_destroy_with_NULL_does_nothing)
+{
+    //arrange
+
+    //act
+    compressor_destroy(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_005: [ compressor_destroy shall end the deflate stream and free the output buffer and the compressor. ]*/
+TEST_FUNCTION(compressor_destroy_frees_the_output_buffer_and_the_compressor)
+{
+    //arrange
+    COMPRESSOR_HANDLE compressor = compressor_create(TEST_LEVEL);
+    setup_payload(g_payload);
+    (void)compressor_compress_message(compressor, TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    compressor_destroy(compressor);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_006: [ If compressor or message is NULL, compressor_compress_message shall fail and return NULL. ]*/
+TEST_FUNCTION(compressor_compress_message_with_NULL_compressor_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = compressor_compress_message(NULL, TEST_MESSAGE_HANDLE);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_006: [ If compressor or message is NULL, compressor_compress_message shall fail and return NULL. ]*/
+TEST_FUNCTION(compressor_compress_message_with_NULL_message_fails)
+{
+    //arrange
+    COMPRESSOR_HANDLE compressor = compressor_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = compressor_compress_message(compressor, NULL);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    compressor_destroy(compressor);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_007: [ compressor_compress_message shall deflate the payload of message as gzip into the output buffer of the compressor, reusing the deflate stream and the buffer of the previous messages. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_009: [ compressor_compress_message shall return a message created by IoTHubMessage_CreateFromPrototype with message and the gzip payload, with the application property content-encoding set to gzip. ]*/
+TEST_FUNCTION(compressor_compress_message_returns_the_gzip_copy)
+{
+    //arrange
+    COMPRESSOR_HANDLE compressor = compressor_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    setup_payload(g_payload);
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromPrototype(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_COMPRESSED_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "content-encoding", "gzip"));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = compressor_compress_message(compressor, TEST_MESSAGE_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_COMPRESSED_MESSAGE_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(g_compressedSize < TEST_PAYLOAD_SIZE);
+    ASSERT_ARE_EQUAL(size_t, TEST_PAYLOAD_SIZE, g_inflatedSize);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(g_payload, g_inflated, TEST_PAYLOAD_SIZE));
+
+    //cleanup
+    compressor_destroy(compressor);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_007: [ compressor_compress_message shall deflate the payload of message as gzip into the output buffer of the compressor, reusing the deflate stream and the buffer of the previous messages. ]*/
+TEST_FUNCTION(compressor_compress_message_reuses_the_output_buffer)
+{
+    //arrange
+    COMPRESSOR_HANDLE compressor = compressor_create(TEST_LEVEL);
+    setup_payload(g_payload);
+    (void)compressor_compress_message(compressor, TEST_MESSAGE_HANDLE);
+    g_payload[TEST_PAYLOAD_SIZE / 2] = '\0';
+    umock_c_reset_all_calls();
+
+    setup_payload(g_payload);
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromPrototype(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_COMPRESSED_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "content-encoding", "gzip"));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = compressor_compress_message(compressor, TEST_MESSAGE_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_COMPRESSED_MESSAGE_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, TEST_PAYLOAD_SIZE / 2, g_inflatedSize);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(g_payload, g_inflated, TEST_PAYLOAD_SIZE / 2));
+
+    //cleanup
+    compressor_destroy(compressor);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_008: [ If the gzip payload is not smaller than the payload, compressor_compress_message shall return NULL. ]*/
+TEST_FUNCTION(compressor_compress_message_returns_NULL_when_the_gzip_is_not_smaller)
+{
+    //arrange
+    COMPRESSOR_HANDLE compressor = compressor_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    setup_payload("ab");
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = compressor_compress_message(compressor, TEST_MESSAGE_HANDLE);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    compressor_destroy(compressor);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_010: [ If any error occurs, compressor_compress_message shall fail and return NULL. ]*/
+TEST_FUNCTION(compressor_compress_message_fails_when_realloc_fails)
+{
+    //arrange
+    COMPRESSOR_HANDLE compressor = compressor_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    setup_payload(g_payload);
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = compressor_compress_message(compressor, TEST_MESSAGE_HANDLE);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    compressor_destroy(compressor);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_010: [ If any error occurs, compressor_compress_message shall fail and return NULL. ]*/
+TEST_FUNCTION(compressor_compress_message_fails_when_IoTHubMessage_CreateFromPrototype_fails)
+{
+    //arrange
+    COMPRESSOR_HANDLE compressor = compressor_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    setup_payload(g_payload);
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromPrototype(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = compressor_compress_message(compressor, TEST_MESSAGE_HANDLE);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    compressor_destroy(compressor);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_COMPRESSION_41_010: [ If any error occurs, compressor_compress_message shall fail and return NULL. ]*/
+TEST_FUNCTION(compressor_compress_message_destroys_the_copy_when_Map_AddOrUpdate_fails)
+{
+    //arrange
+    COMPRESSOR_HANDLE compressor = compressor_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    setup_payload(g_payload);
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromPrototype(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_COMPRESSED_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "content-encoding", "gzip"))
+        .SetReturn(MAP_ERROR);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_COMPRESSED_MESSAGE_HANDLE));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = compressor_compress_message(compressor, TEST_MESSAGE_HANDLE);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    compressor_destroy(compressor);
+}
+
+END_TEST_SUITE(iothub_client_compression_ut)
@@ -0,0 +1,454 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_options.h"
+#include "iothub_client_connection_health.h"
+
+#define TEST_MINIMUM_TIMEOUT    50
+#define TEST_MAXIMUM_TIMEOUT    10000
+#define TEST_SENT_TIME          1000
+
+static CONNECTION_HEALTH_HANDLE create_health(void)
+{
+    IOTHUB_CONNECTION_HEALTH_OPTIONS options = { TEST_MINIMUM_TIMEOUT, TEST_MAXIMUM_TIMEOUT };
+    CONNECTION_HEALTH_HANDLE result = connection_health_create(&options);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+/*a first round trip of 100 ms: srtt 100, rttvar 50, a timeout of 300 ms*/
+static CONNECTION_HEALTH_HANDLE create_measured_health(void)
+{
+    CONNECTION_HEALTH_HANDLE result = create_health();
+    connection_health_on_sent(result, TEST_SENT_TIME);
+    connection_health_on_acked(result, TEST_SENT_TIME, false, TEST_SENT_TIME + 100);
+    return result;
+}
+
+static uint64_t get_due_time(CONNECTION_HEALTH_HANDLE health)
+{
+    tickcounter_ms_t due = 0;
+    ASSERT_IS_TRUE(connection_health_get_due_time(health, &due));
+    return (uint64_t)due;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_connection_health_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_001: [ If options is NULL, its minimumTimeoutInMs is 0 or its maximumTimeoutInMs is less than its minimumTimeoutInMs, connection_health_create shall fail and return NULL. ]*/
+TEST_FUNCTION(connection_health_create_with_invalid_options_fails)
+{
+    //arrange
+    IOTHUB_CONNECTION_HEALTH_OPTIONS no_minimum = { 0, TEST_MAXIMUM_TIMEOUT };
+    IOTHUB_CONNECTION_HEALTH_OPTIONS maximum_below_minimum = { TEST_MINIMUM_TIMEOUT, TEST_MINIMUM_TIMEOUT - 1 };
+
+    //act
+    CONNECTION_HEALTH_HANDLE result_NULL = connection_health_create(NULL);
+    CONNECTION_HEALTH_HANDLE result_minimum = connection_health_create(&no_minimum);
+    CONNECTION_HEALTH_HANDLE result_maximum = connection_health_create(&maximum_below_minimum);
+
+    //assert
+    ASSERT_IS_NULL(result_NULL);
+    ASSERT_IS_NULL(result_minimum);
+    ASSERT_IS_NULL(result_maximum);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_001: [ If options is NULL, its minimumTimeoutInMs is 0 or its maximumTimeoutInMs is less than its minimumTimeoutInMs, connection_health_create shall fail and return NULL. ]*/
+TEST_FUNCTION(connection_health_create_when_malloc_fails_fails)
+{
+    //arrange
+    IOTHUB_CONNECTION_HEALTH_OPTIONS options = { TEST_MINIMUM_TIMEOUT, TEST_MAXIMUM_TIMEOUT };
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    CONNECTION_HEALTH_HANDLE result = connection_health_create(&options);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_002: [ connection_health_create shall return a monitor waiting for nothing, with no round trip time and a timeout of maximumTimeoutInMs. ]*/
+TEST_FUNCTION(connection_health_create_succeeds)
+{
+    //arrange
+    IOTHUB_CONNECTION_HEALTH_OPTIONS options = { TEST_MINIMUM_TIMEOUT, TEST_MAXIMUM_TIMEOUT };
+    tickcounter_ms_t due;
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    CONNECTION_HEALTH_HANDLE result = connection_health_create(&options);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, TEST_MAXIMUM_TIMEOUT, (int)connection_health_get_timeout(result));
+    ASSERT_IS_FALSE(connection_health_get_due_time(result, &due));
+
+    //cleanup
+    connection_health_destroy(result);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_003: [ If health is NULL, connection_health_destroy shall do nothing, otherwise it shall free it. ]*/
+TEST_FUNCTION(connection_health_destroy_frees)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_health();
+    STRICT_EXPECTED_CALL(gballoc_free(health));
+
+    //act
+    connection_health_destroy(NULL);
+    connection_health_destroy(health);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_005: [ connection_health_on_sent shall start waiting for acknowledgements at nowMs, unless they are already waited for. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_013: [ While a probe is waited for, connection_health_get_due_time shall set dueMs to the time it was sent and the timeout, while only acknowledgements are waited for, to the time they are waited for since and the timeout, and return true; it shall return false otherwise. ]*/
+TEST_FUNCTION(connection_health_on_sent_starts_waiting_once)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_health();
+
+    //act
+    connection_health_on_sent(health, TEST_SENT_TIME);
+    connection_health_on_sent(health, TEST_SENT_TIME + 500);
+
+    //assert
+    ASSERT_ARE_EQUAL(uint64_t, TEST_SENT_TIME + TEST_MAXIMUM_TIMEOUT, get_due_time(health));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_006: [ connection_health_on_acked shall measure the round trip time from sentMs to nowMs, unless isResent is true, and the next acknowledgement shall be waited for from nowMs. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_007: [ Once measured, the timeout shall be the smoothed round trip time and four times its variation, no less than minimumTimeoutInMs and no more than maximumTimeoutInMs. ]*/
+TEST_FUNCTION(connection_health_on_acked_measures_the_first_round_trip)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_health();
+    connection_health_on_sent(health, TEST_SENT_TIME);
+
+    //act
+    connection_health_on_acked(health, TEST_SENT_TIME, false, TEST_SENT_TIME + 100);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 300, (int)connection_health_get_timeout(health));
+    ASSERT_ARE_EQUAL(uint64_t, TEST_SENT_TIME + 100 + 300, get_due_time(health));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_007: [ Once measured, the timeout shall be the smoothed round trip time and four times its variation, no less than minimumTimeoutInMs and no more than maximumTimeoutInMs. ]*/
+TEST_FUNCTION(connection_health_on_acked_smooths_the_round_trips)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_measured_health();
+
+    //act
+    connection_health_on_acked(health, TEST_SENT_TIME + 200, false, TEST_SENT_TIME + 400);
+
+    //assert
+    /*rttvar (3 * 50 + 100) / 4 = 62, srtt (7 * 100 + 200) / 8 = 112*/
+    ASSERT_ARE_EQUAL(int, 112 + 4 * 62, (int)connection_health_get_timeout(health));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_007: [ Once measured, the timeout shall be the smoothed round trip time and four times its variation, no less than minimumTimeoutInMs and no more than maximumTimeoutInMs. ]*/
+TEST_FUNCTION(connection_health_timeout_is_kept_between_minimum_and_maximum)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE fast = create_health();
+    CONNECTION_HEALTH_HANDLE slow = create_health();
+
+    //act
+    connection_health_on_acked(fast, TEST_SENT_TIME, false, TEST_SENT_TIME + 10);
+    connection_health_on_acked(slow, TEST_SENT_TIME, false, TEST_SENT_TIME + 5000);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, TEST_MINIMUM_TIMEOUT, (int)connection_health_get_timeout(fast));
+    ASSERT_ARE_EQUAL(int, TEST_MAXIMUM_TIMEOUT, (int)connection_health_get_timeout(slow));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(fast);
+    connection_health_destroy(slow);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_006: [ connection_health_on_acked shall measure the round trip time from sentMs to nowMs, unless isResent is true, and the next acknowledgement shall be waited for from nowMs. ]*/
+TEST_FUNCTION(connection_health_on_acked_does_not_measure_a_resent_packet)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_health();
+    connection_health_on_sent(health, TEST_SENT_TIME);
+
+    //act
+    connection_health_on_acked(health, TEST_SENT_TIME, true, TEST_SENT_TIME + 100);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, TEST_MAXIMUM_TIMEOUT, (int)connection_health_get_timeout(health));
+    ASSERT_ARE_EQUAL(uint64_t, TEST_SENT_TIME + 100 + TEST_MAXIMUM_TIMEOUT, get_due_time(health));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_009: [ If isWaitingForAcks is false, connection_health_check shall forget the acknowledgements and the probe waited for, if it is true while no acknowledgement was waited for, they shall be waited for from nowMs, and it shall return CONNECTION_HEALTH_ACTION_NONE. ]*/
+TEST_FUNCTION(connection_health_check_without_acks_waited_for_forgets_waiting)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_measured_health();
+    tickcounter_ms_t due;
+
+    //act
+    CONNECTION_HEALTH_ACTION result = connection_health_check(health, false, TEST_SENT_TIME + 1000);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, CONNECTION_HEALTH_ACTION_NONE, result);
+    ASSERT_IS_FALSE(connection_health_get_due_time(health, &due));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_009: [ If isWaitingForAcks is false, connection_health_check shall forget the acknowledgements and the probe waited for, if it is true while no acknowledgement was waited for, they shall be waited for from nowMs, and it shall return CONNECTION_HEALTH_ACTION_NONE. ]*/
+TEST_FUNCTION(connection_health_check_starts_waiting_for_acks_not_waited_for)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_health();
+
+    //act
+    CONNECTION_HEALTH_ACTION result = connection_health_check(health, true, TEST_SENT_TIME);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, CONNECTION_HEALTH_ACTION_NONE, result);
+    ASSERT_ARE_EQUAL(uint64_t, TEST_SENT_TIME + TEST_MAXIMUM_TIMEOUT, get_due_time(health));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_010: [ Once acknowledgements have been waited for the timeout without a probe, connection_health_check shall wait for a probe sent at nowMs and return CONNECTION_HEALTH_ACTION_PROBE. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_013: [ While a probe is waited for, connection_health_get_due_time shall set dueMs to the time it was sent and the timeout, while only acknowledgements are waited for, to the time they are waited for since and the timeout, and return true; it shall return false otherwise. ]*/
+TEST_FUNCTION(connection_health_check_asks_for_a_probe_once_the_acks_are_late)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_measured_health();
+    connection_health_on_sent(health, TEST_SENT_TIME + 200);
+
+    //act
+    CONNECTION_HEALTH_ACTION result_early = connection_health_check(health, true, TEST_SENT_TIME + 100 + 299);
+    CONNECTION_HEALTH_ACTION result_late = connection_health_check(health, true, TEST_SENT_TIME + 100 + 300);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, CONNECTION_HEALTH_ACTION_NONE, result_early);
+    ASSERT_ARE_EQUAL(int, CONNECTION_HEALTH_ACTION_PROBE, result_late);
+    ASSERT_ARE_EQUAL(uint64_t, TEST_SENT_TIME + 400 + 300, get_due_time(health));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_008: [ If a probe is waited for, connection_health_on_probe_acked shall measure its round trip time, stop waiting for it and wait for the next acknowledgement from nowMs; it shall do nothing otherwise. ]*/
+TEST_FUNCTION(connection_health_on_probe_acked_measures_and_stops_the_probe)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_measured_health();
+    (void)connection_health_check(health, true, TEST_SENT_TIME + 400);
+
+    //act
+    connection_health_on_probe_acked(health, TEST_SENT_TIME + 500);
+
+    //assert
+    /*rttvar (3 * 50 + 0) / 4 = 37, srtt stays 100*/
+    ASSERT_ARE_EQUAL(int, 100 + 4 * 37, (int)connection_health_get_timeout(health));
+    ASSERT_ARE_EQUAL(uint64_t, TEST_SENT_TIME + 500 + 248, get_due_time(health));
+    ASSERT_ARE_EQUAL(int, CONNECTION_HEALTH_ACTION_NONE, connection_health_check(health, true, TEST_SENT_TIME + 700));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_008: [ If a probe is waited for, connection_health_on_probe_acked shall measure its round trip time, stop waiting for it and wait for the next acknowledgement from nowMs; it shall do nothing otherwise. ]*/
+TEST_FUNCTION(connection_health_on_probe_acked_without_a_probe_does_nothing)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_measured_health();
+
+    //act
+    connection_health_on_probe_acked(health, TEST_SENT_TIME + 5000);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 300, (int)connection_health_get_timeout(health));
+    ASSERT_ARE_EQUAL(uint64_t, TEST_SENT_TIME + 100 + 300, get_due_time(health));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_011: [ Once the probe has been waited for the timeout, connection_health_check shall forget the acknowledgements and the probe waited for and return CONNECTION_HEALTH_ACTION_RECONNECT. ]*/
+TEST_FUNCTION(connection_health_check_asks_for_a_reconnection_once_the_probe_is_late)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_measured_health();
+    tickcounter_ms_t due;
+    (void)connection_health_check(health, true, TEST_SENT_TIME + 400);
+
+    //act
+    CONNECTION_HEALTH_ACTION result_early = connection_health_check(health, true, TEST_SENT_TIME + 699);
+    CONNECTION_HEALTH_ACTION result_late = connection_health_check(health, true, TEST_SENT_TIME + 700);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, CONNECTION_HEALTH_ACTION_NONE, result_early);
+    ASSERT_ARE_EQUAL(int, CONNECTION_HEALTH_ACTION_RECONNECT, result_late);
+    ASSERT_IS_FALSE(connection_health_get_due_time(health, &due));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_004: [ connection_health_on_connected shall forget the acknowledgements and the probe waited for and keep the round trip time. ]*/
+TEST_FUNCTION(connection_health_on_connected_forgets_waiting_and_keeps_the_round_trip)
+{
+    //arrange
+    CONNECTION_HEALTH_HANDLE health = create_measured_health();
+    tickcounter_ms_t due;
+    (void)connection_health_check(health, true, TEST_SENT_TIME + 400);
+
+    //act
+    connection_health_on_connected(health);
+
+    //assert
+    ASSERT_IS_FALSE(connection_health_get_due_time(health, &due));
+    ASSERT_ARE_EQUAL(int, 300, (int)connection_health_get_timeout(health));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    connection_health_destroy(health);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_012: [ If health is NULL, connection_health_check shall return CONNECTION_HEALTH_ACTION_NONE. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_HEALTH_41_014: [ connection_health_get_timeout shall return the timeout, 0 if health is NULL. ]*/
+TEST_FUNCTION(connection_health_with_NULL_handle_does_nothing)
+{
+    //arrange
+    tickcounter_ms_t due;
+
+    //act
+    connection_health_on_connected(NULL);
+    connection_health_on_sent(NULL, TEST_SENT_TIME);
+    connection_health_on_acked(NULL, TEST_SENT_TIME, false, TEST_SENT_TIME + 100);
+    connection_health_on_probe_acked(NULL, TEST_SENT_TIME);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, CONNECTION_HEALTH_ACTION_NONE, connection_health_check(NULL, true, TEST_SENT_TIME));
+    ASSERT_IS_FALSE(connection_health_get_due_time(NULL, &due));
+    ASSERT_ARE_EQUAL(int, 0, (int)connection_health_get_timeout(NULL));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_connection_health_ut)
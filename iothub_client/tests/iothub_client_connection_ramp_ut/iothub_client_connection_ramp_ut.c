@@ -0,0 +1,354 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdbool>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_connection_ramp.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_LOCK_HANDLE                    (LOCK_HANDLE)0x7772
+#define TEST_TICK_COUNTER_HANDLE            (TICK_COUNTER_HANDLE)0x7773
+
+static tickcounter_ms_t g_current_ms;
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static CONNECTION_RAMP_HANDLE create_connection_ramp(unsigned int connections_per_sec, unsigned int burst)
+{
+    CONNECTION_RAMP_HANDLE result = connection_ramp_create(connections_per_sec, burst);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void admit_and_verify(CONNECTION_RAMP_HANDLE connection_ramp, bool has_queued_data, bool expected_result, unsigned int expected_wait_time_in_ms)
+{
+    unsigned int wait_time_in_ms = 0;
+    bool result = connection_ramp_admit(connection_ramp, has_queued_data, &wait_time_in_ms);
+
+    ASSERT_ARE_EQUAL(bool, expected_result, result);
+    if (!expected_result)
+    {
+        ASSERT_ARE_EQUAL(int, expected_wait_time_in_ms, wait_time_in_ms);
+    }
+}
+
+BEGIN_TEST_SUITE(iothub_client_connection_ramp_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, 1);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    g_current_ms = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_001: [ If connections_per_sec or burst is 0, connection_ramp_create shall fail and return NULL. ]*/
+TEST_FUNCTION(connection_ramp_create_with_0_connections_per_sec_fails)
+{
+    // act
+    CONNECTION_RAMP_HANDLE result = connection_ramp_create(0, 10);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_001: [ If connections_per_sec or burst is 0, connection_ramp_create shall fail and return NULL. ]*/
+TEST_FUNCTION(connection_ramp_create_with_0_burst_fails)
+{
+    // act
+    CONNECTION_RAMP_HANDLE result = connection_ramp_create(10, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_002: [ connection_ramp_create shall allocate the connection ramp, create its lock and tick counter, and return it with a budget of burst tokens. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_011: [ connection_ramp_destroy shall destroy the tick counter and the lock and free the connection ramp. ]*/
+TEST_FUNCTION(connection_ramp_create_and_destroy_succeed)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+
+    // act
+    CONNECTION_RAMP_HANDLE result = connection_ramp_create(10, 5);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(result));
+
+    connection_ramp_destroy(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_003: [ If any of them fails, connection_ramp_create shall fail and return NULL. ]*/
+TEST_FUNCTION(connection_ramp_create_negative_tests)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        CONNECTION_RAMP_HANDLE result = connection_ramp_create(10, 5);
+
+        // assert
+        ASSERT_IS_NULL(result);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_010: [ If connection_ramp is NULL, connection_ramp_destroy shall return. ]*/
+TEST_FUNCTION(connection_ramp_destroy_NULL_returns)
+{
+    // act
+    connection_ramp_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_004: [ If connection_ramp or wait_time_in_ms is NULL, connection_ramp_admit shall return true, the connection not being held back. ]*/
+TEST_FUNCTION(connection_ramp_admit_NULL_admits)
+{
+    // arrange
+    unsigned int wait_time_in_ms;
+
+    // act
+    bool result = connection_ramp_admit(NULL, false, &wait_time_in_ms);
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_005: [ If Lock or tickcounter_get_current_ms fail, connection_ramp_admit shall return true. ]*/
+TEST_FUNCTION(connection_ramp_admit_Lock_fails_admits)
+{
+    // arrange
+    CONNECTION_RAMP_HANDLE connection_ramp = create_connection_ramp(1, 1);
+    unsigned int wait_time_in_ms;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE)).SetReturn(LOCK_ERROR);
+
+    // act
+    bool result = connection_ramp_admit(connection_ramp, false, &wait_time_in_ms);
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_ramp_destroy(connection_ramp);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_005: [ If Lock or tickcounter_get_current_ms fail, connection_ramp_admit shall return true. ]*/
+TEST_FUNCTION(connection_ramp_admit_tickcounter_get_current_ms_fails_admits)
+{
+    // arrange
+    CONNECTION_RAMP_HANDLE connection_ramp = create_connection_ramp(1, 1);
+    unsigned int wait_time_in_ms;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).SetReturn(1);
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    bool result = connection_ramp_admit(connection_ramp, false, &wait_time_in_ms);
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_ramp_destroy(connection_ramp);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_007: [ If no token is left, connection_ramp_admit shall return false and set wait_time_in_ms to the time until the next token, remembering the time if has_queued_data is true. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_009: [ Otherwise connection_ramp_admit shall take a token and return true. ]*/
+TEST_FUNCTION(connection_ramp_admit_takes_the_burst_then_holds_back)
+{
+    // arrange
+    CONNECTION_RAMP_HANDLE connection_ramp = create_connection_ramp(4, 2);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    admit_and_verify(connection_ramp, false, true, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    admit_and_verify(connection_ramp, false, true, 0);
+    admit_and_verify(connection_ramp, false, false, 250);
+    g_current_ms = 100;
+    admit_and_verify(connection_ramp, false, false, 150);
+
+    // cleanup
+    connection_ramp_destroy(connection_ramp);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_006: [ connection_ramp_admit shall refill the budget by connections_per_sec tokens per second since it was last refilled, up to burst tokens. ]*/
+TEST_FUNCTION(connection_ramp_admit_refills_up_to_the_burst)
+{
+    // arrange
+    CONNECTION_RAMP_HANDLE connection_ramp = create_connection_ramp(4, 2);
+    admit_and_verify(connection_ramp, false, true, 0);
+    admit_and_verify(connection_ramp, false, true, 0);
+
+    // act
+    g_current_ms = 250;
+    admit_and_verify(connection_ramp, false, true, 0);
+    admit_and_verify(connection_ramp, false, false, 250);
+    g_current_ms = 60000;
+    admit_and_verify(connection_ramp, false, true, 0);
+    admit_and_verify(connection_ramp, false, true, 0);
+
+    // assert
+    admit_and_verify(connection_ramp, false, false, 250);
+
+    // cleanup
+    connection_ramp_destroy(connection_ramp);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_CONNECTION_RAMP_41_008: [ While a device with queued data was turned away in the last second, connection_ramp_admit shall return false if has_queued_data is false and set wait_time_in_ms to the end of that second or the time until the next token, whichever is later. ]*/
+TEST_FUNCTION(connection_ramp_admit_gives_priority_to_queued_data)
+{
+    // arrange
+    CONNECTION_RAMP_HANDLE connection_ramp = create_connection_ramp(10, 1);
+    admit_and_verify(connection_ramp, false, true, 0);
+    admit_and_verify(connection_ramp, true, false, 100);
+
+    // act
+    g_current_ms = 100;
+    admit_and_verify(connection_ramp, false, false, 900);
+    admit_and_verify(connection_ramp, true, true, 0);
+    g_current_ms = 1100;
+
+    // assert
+    admit_and_verify(connection_ramp, false, true, 0);
+
+    // cleanup
+    connection_ramp_destroy(connection_ramp);
+}
+
+END_TEST_SUITE(iothub_client_connection_ramp_ut)
@@ -0,0 +1,327 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#include "iothub_client.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_cpp_async.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static IOTHUB_CLIENT_HANDLE TEST_CLIENT_HANDLE = (IOTHUB_CLIENT_HANDLE)0x4501;
+static IOTHUB_MESSAGE_HANDLE TEST_MESSAGE_HANDLE = (IOTHUB_MESSAGE_HANDLE)0x4502;
+static METHOD_HANDLE TEST_METHOD_HANDLE = (METHOD_HANDLE)0x4503;
+static const char* TEST_CONNECTION_STRING = "HostName=hub;DeviceId=device;SharedAccessKey=key";
+
+/*what the SDK was given, so the tests can call back as the SDK would*/
+static IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK g_confirmation_callback;
+static void* g_confirmation_context;
+static IOTHUB_CLIENT_REPORTED_STATE_CALLBACK g_reported_state_callback;
+static void* g_reported_state_context;
+static IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK g_method_callback;
+static void* g_method_context;
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    (void)iotHubClientHandle;
+    (void)eventMessageHandle;
+    g_confirmation_callback = eventConfirmationCallback;
+    g_confirmation_context = userContextCallback;
+    return IOTHUB_CLIENT_OK;
+}
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_SendReportedState(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
+{
+    (void)iotHubClientHandle;
+    (void)reportedState;
+    (void)size;
+    g_reported_state_callback = reportedStateCallback;
+    g_reported_state_context = userContextCallback;
+    return IOTHUB_CLIENT_OK;
+}
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_SetDeviceMethodCallback_Ex(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inboundDeviceMethodCallback, void* userContextCallback)
+{
+    (void)iotHubClientHandle;
+    g_method_callback = inboundDeviceMethodCallback;
+    g_method_context = userContextCallback;
+    return IOTHUB_CLIENT_OK;
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static iothub::client create_client(void)
+{
+    iothub::client result = iothub::client::from_connection_string(TEST_CONNECTION_STRING, NULL);
+    ASSERT_IS_TRUE((bool)result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+#ifdef IOTHUB_CLIENT_CPP_HAS_COROUTINES
+/*the smallest coroutine type, started at once and never awaited*/
+struct detached_task
+{
+    struct promise_type
+    {
+        detached_task get_return_object() { return detached_task(); }
+        std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+        std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+        void return_void() {}
+        void unhandled_exception() { std::abort(); }
+    };
+};
+
+static detached_task send_then_report(iothub::client& client, std::vector<int>& steps)
+{
+    IOTHUB_CLIENT_CONFIRMATION_RESULT confirmed = co_await client.send_event(iothub::message::from_string("a"));
+    steps.push_back((int)confirmed);
+    int status_code = co_await client.send_reported_state(iothub::as_bytes("{}"));
+    steps.push_back(status_code);
+}
+#endif
+
+BEGIN_TEST_SUITE(iothub_client_cpp_async_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(METHOD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_TRANSPORT_PROVIDER, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_REPORTED_STATE_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_CreateFromConnectionString, TEST_CLIENT_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_CreateFromConnectionString, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromByteArray, TEST_MESSAGE_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_SendEventAsync_TakeOwnership, my_IoTHubClient_SendEventAsync_TakeOwnership);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_SendReportedState, my_IoTHubClient_SendReportedState);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_SetDeviceMethodCallback_Ex, my_IoTHubClient_SetDeviceMethodCallback_Ex);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_DeviceMethodResponse, IOTHUB_CLIENT_OK);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+    g_confirmation_callback = NULL;
+    g_confirmation_context = NULL;
+    g_reported_state_callback = NULL;
+    g_reported_state_context = NULL;
+    g_method_callback = NULL;
+    g_method_context = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(send_event_is_done_when_the_SDK_confirms_it)
+{
+    // arrange
+    iothub::client client = create_client();
+    iothub::message message = iothub::message::from_string("a");
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_SendEventAsync_TakeOwnership(TEST_CLIENT_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    iothub::operation<IOTHUB_CLIENT_CONFIRMATION_RESULT> sent = client.send_event(message);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, sent.start_result());
+    ASSERT_IS_FALSE((bool)message);
+    ASSERT_IS_FALSE(sent.is_done());
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    g_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, g_confirmation_context);
+    ASSERT_IS_TRUE(sent.is_done());
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, sent.get());
+}
+
+TEST_FUNCTION(send_event_fails_to_start_and_is_done_with_an_error)
+{
+    // arrange
+    iothub::client client = create_client();
+    iothub::message message = iothub::message::from_string("a");
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_SendEventAsync_TakeOwnership(TEST_CLIENT_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_CLIENT_INVALID_ARG);
+
+    // act
+    iothub::operation<IOTHUB_CLIENT_CONFIRMATION_RESULT> sent = client.send_event(message);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, sent.start_result());
+    ASSERT_IS_TRUE(message.get() == TEST_MESSAGE_HANDLE);
+    ASSERT_IS_TRUE(sent.is_done());
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_ERROR, sent.get());
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(send_reported_state_gives_the_status_code_of_the_hub)
+{
+    // arrange
+    iothub::client client = create_client();
+    STRICT_EXPECTED_CALL(IoTHubClient_SendReportedState(TEST_CLIENT_HANDLE, IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    iothub::operation<int> reported = client.send_reported_state(iothub::as_bytes("{}"));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, reported.start_result());
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    g_reported_state_callback(204, g_reported_state_context);
+    ASSERT_ARE_EQUAL(int, 204, reported.get());
+}
+
+TEST_FUNCTION(confirmation_after_the_operation_was_destroyed_is_safe)
+{
+    // arrange
+    iothub::client client = create_client();
+
+    // act
+    {
+        iothub::operation<int> reported = client.send_reported_state(iothub::as_bytes("{}"));
+    }
+    g_reported_state_callback(200, g_reported_state_context);
+
+    // assert - the context given to the SDK kept the state of the operation alive
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(method_request_is_answered_after_the_callback_returned)
+{
+    // arrange
+    iothub::client client = create_client();
+    std::vector<iothub::method_request> pending;
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, client.set_device_method_callback([&pending](iothub::method_request request) {
+        pending.push_back(std::move(request));
+    }));
+    iothub::client moved = std::move(client);
+    std::string payload("{\"delay\":1}");
+    ASSERT_ARE_EQUAL(int, 0, g_method_callback("reboot", (const unsigned char*)payload.data(), payload.size(), TEST_METHOD_HANDLE, g_method_context));
+    payload.assign(payload.size(), 'x');
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_DeviceMethodResponse(TEST_CLIENT_HANDLE, TEST_METHOD_HANDLE, IGNORED_PTR_ARG, 2, 200));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = pending[0].respond(200, iothub::as_bytes("{}"));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "reboot", pending[0].method_name().c_str());
+    ASSERT_ARE_EQUAL(char_ptr, "{\"delay\":1}", std::string(iothub::as_string_view(pending[0].payload())).c_str());
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(client_destroys_the_handle_once)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(IoTHubClient_CreateFromConnectionString(TEST_CONNECTION_STRING, NULL));
+    STRICT_EXPECTED_CALL(IoTHubClient_Destroy(TEST_CLIENT_HANDLE));
+
+    // act
+    {
+        iothub::client client = iothub::client::from_connection_string(TEST_CONNECTION_STRING, NULL);
+        iothub::client moved = std::move(client);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+#ifdef IOTHUB_CLIENT_CPP_HAS_COROUTINES
+TEST_FUNCTION(coroutine_resumes_on_the_thread_calling_each_callback)
+{
+    // arrange
+    iothub::client client = create_client();
+    std::vector<int> steps;
+
+    // act
+    send_then_report(client, steps);
+    ASSERT_ARE_EQUAL(size_t, 0, steps.size());
+    g_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, g_confirmation_context);
+    ASSERT_ARE_EQUAL(size_t, 1, steps.size());
+    g_reported_state_callback(204, g_reported_state_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, steps.size());
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_OK, steps[0]);
+    ASSERT_ARE_EQUAL(int, 204, steps[1]);
+}
+
+TEST_FUNCTION(coroutine_goes_on_without_suspending_when_the_send_could_not_start)
+{
+    // arrange
+    iothub::client client = create_client();
+    std::vector<int> steps;
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(IoTHubClient_SendEventAsync_TakeOwnership(TEST_CLIENT_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_CLIENT_ERROR);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_SendReportedState(TEST_CLIENT_HANDLE, IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    send_then_report(client, steps);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, steps.size());
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_ERROR, steps[0]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    g_reported_state_callback(200, g_reported_state_context);
+}
+#endif
+
+END_TEST_SUITE(iothub_client_cpp_async_ut)
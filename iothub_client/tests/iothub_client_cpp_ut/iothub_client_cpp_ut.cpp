@@ -0,0 +1,415 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#include "iothub_client_ll.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_cpp.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static IOTHUB_CLIENT_LL_HANDLE TEST_CLIENT_HANDLE = (IOTHUB_CLIENT_LL_HANDLE)0x4401;
+static IOTHUB_MESSAGE_HANDLE TEST_MESSAGE_HANDLE = (IOTHUB_MESSAGE_HANDLE)0x4402;
+static MAP_HANDLE TEST_MAP_HANDLE = (MAP_HANDLE)0x4403;
+static const char* TEST_CONNECTION_STRING = "HostName=hub;DeviceId=device;SharedAccessKey=key";
+
+/*what the SDK was given, so the tests can call back as the SDK would*/
+static IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK g_free_callback;
+static const unsigned char* g_borrowed_buffer;
+static size_t g_borrowed_size;
+static void* g_free_context;
+static IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK g_confirmation_callback;
+static void* g_confirmation_context;
+static IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC g_message_callback;
+static IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC g_method_callback;
+static void* g_callback_context;
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromBorrowedBuffer(const unsigned char* buffer, size_t size, IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK freeCallback, void* context)
+{
+    g_borrowed_buffer = buffer;
+    g_borrowed_size = size;
+    g_free_callback = freeCallback;
+    g_free_context = context;
+    return TEST_MESSAGE_HANDLE;
+}
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_LL_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    (void)iotHubClientHandle;
+    (void)eventMessageHandle;
+    g_confirmation_callback = eventConfirmationCallback;
+    g_confirmation_context = userContextCallback;
+    return IOTHUB_CLIENT_OK;
+}
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
+{
+    (void)iotHubClientHandle;
+    g_message_callback = messageCallback;
+    g_callback_context = userContextCallback;
+    return IOTHUB_CLIENT_OK;
+}
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_LL_SetDeviceMethodCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC deviceMethodCallback, void* userContextCallback)
+{
+    (void)iotHubClientHandle;
+    g_method_callback = deviceMethodCallback;
+    g_callback_context = userContextCallback;
+    return IOTHUB_CLIENT_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const unsigned char** buffer, size_t* size)
+{
+    (void)iotHubMessageHandle;
+    *buffer = (const unsigned char*)"payload";
+    *size = 7;
+    return IOTHUB_MESSAGE_OK;
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static iothub::client_ll create_client(void)
+{
+    iothub::client_ll result = iothub::client_ll::from_connection_string(TEST_CONNECTION_STRING, NULL);
+    ASSERT_IS_TRUE((bool)result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothub_client_cpp_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_LL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_TRANSPORT_PROVIDER, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_LL_CreateFromConnectionString, TEST_CLIENT_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_CreateFromConnectionString, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromByteArray, TEST_MESSAGE_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromBorrowedBuffer, my_IoTHubMessage_CreateFromBorrowedBuffer);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, my_IoTHubMessage_GetByteArray);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Properties, TEST_MAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SendEventAsync_TakeOwnership, my_IoTHubClient_LL_SendEventAsync_TakeOwnership);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SetMessageCallback, my_IoTHubClient_LL_SetMessageCallback);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SetDeviceMethodCallback, my_IoTHubClient_LL_SetDeviceMethodCallback);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+    g_free_callback = NULL;
+    g_borrowed_buffer = NULL;
+    g_borrowed_size = 0;
+    g_free_context = NULL;
+    g_confirmation_callback = NULL;
+    g_confirmation_context = NULL;
+    g_message_callback = NULL;
+    g_method_callback = NULL;
+    g_callback_context = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(message_from_string_copies_the_view_without_strlen)
+{
+    // arrange
+    std::string_view text("abcdef", 3);
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray((const unsigned char*)text.data(), 3));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
+
+    // act
+    {
+        iothub::message message = iothub::message::from_string(text);
+        ASSERT_IS_TRUE(message.get() == TEST_MESSAGE_HANDLE);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(message_take_sends_from_the_moved_container)
+{
+    // arrange
+    std::vector<unsigned char> content(100, 0x42);
+    const unsigned char* content_data = content.data();
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromBorrowedBuffer(content_data, 100, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
+
+    // act
+    {
+        iothub::message message = iothub::message::take(std::move(content));
+        ASSERT_IS_TRUE((bool)message);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(g_borrowed_buffer == content_data);
+    ASSERT_IS_NOT_NULL((void*)g_free_callback);
+
+    // cleanup - the SDK frees the container once the message and its clones are destroyed
+    g_free_callback(g_borrowed_buffer, g_free_context);
+}
+
+TEST_FUNCTION(message_take_fails_and_frees_the_container)
+{
+    // arrange
+    std::string content("content");
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromBorrowedBuffer(IGNORED_PTR_ARG, 7, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+
+    // act
+    iothub::message message = iothub::message::take(std::move(content));
+
+    // assert
+    ASSERT_IS_FALSE((bool)message);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(message_borrow_calls_on_release_when_the_SDK_frees_the_buffer)
+{
+    // arrange
+    static const unsigned char content[] = { 1, 2, 3 };
+    int release_count = 0;
+    iothub::message message = iothub::message::borrow(iothub::byte_span(content, sizeof(content)), [&release_count]() { release_count++; });
+    ASSERT_IS_TRUE(g_borrowed_buffer == content);
+    ASSERT_ARE_EQUAL(int, 0, release_count);
+
+    // act
+    g_free_callback(g_borrowed_buffer, g_free_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 1, release_count);
+}
+
+TEST_FUNCTION(message_move_destroys_the_handle_once)
+{
+    // arrange
+    iothub::message first = iothub::message::from_string("a");
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
+
+    // act
+    {
+        iothub::message second = std::move(first);
+        ASSERT_IS_FALSE((bool)first);
+        ASSERT_IS_TRUE(second.get() == TEST_MESSAGE_HANDLE);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(message_set_property_terminates_the_views)
+{
+    // arrange
+    iothub::message message = iothub::message::from_string("a");
+    std::string_view name("namexx", 4);
+    std::string_view value("valuexx", 5);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "name", "value"));
+
+    // act
+    MAP_RESULT result = message.set_property(name, value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, MAP_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(client_ll_send_event_gives_the_message_to_the_SDK)
+{
+    // arrange
+    iothub::client_ll client = create_client();
+    iothub::message message = iothub::message::from_string("a");
+    IOTHUB_CLIENT_CONFIRMATION_RESULT confirmed = IOTHUB_CLIENT_CONFIRMATION_ERROR;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_CLIENT_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = client.send_event(message, [&confirmed](IOTHUB_CLIENT_CONFIRMATION_RESULT r) { confirmed = r; });
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_FALSE((bool)message);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    g_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, g_confirmation_context);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_OK, confirmed);
+}
+
+TEST_FUNCTION(client_ll_send_event_fails_and_the_caller_keeps_the_message)
+{
+    // arrange
+    iothub::client_ll client = create_client();
+    iothub::message message = iothub::message::from_string("a");
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_CLIENT_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_CLIENT_ERROR);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = client.send_event(message, [](IOTHUB_CLIENT_CONFIRMATION_RESULT) {});
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_IS_TRUE(message.get() == TEST_MESSAGE_HANDLE);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(client_ll_message_callback_gets_the_body_without_a_copy)
+{
+    // arrange
+    iothub::client_ll client = create_client();
+    iothub::byte_span received;
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, client.set_message_callback([&received](const iothub::message_view& message) {
+        received = message.body();
+        return IOTHUBMESSAGE_ACCEPTED;
+    }));
+    iothub::client_ll moved = std::move(client);
+
+    // act
+    IOTHUBMESSAGE_DISPOSITION_RESULT result = g_message_callback(TEST_MESSAGE_HANDLE, g_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUBMESSAGE_ACCEPTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, "payload", std::string(iothub::as_string_view(received)).c_str());
+}
+
+TEST_FUNCTION(client_ll_device_method_callback_response_is_given_to_the_SDK)
+{
+    // arrange
+    iothub::client_ll client = create_client();
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, client.set_device_method_callback([](std::string_view method_name, iothub::byte_span payload, std::string& response) {
+        response = std::string(method_name) + ":" + std::string(iothub::as_string_view(payload));
+        return 200;
+    }));
+    unsigned char* response;
+    size_t response_size;
+
+    // act
+    int result = g_method_callback("reboot", (const unsigned char*)"{}", 2, &response, &response_size, g_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 200, result);
+    ASSERT_ARE_EQUAL(size_t, 9, response_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(response, "reboot:{}", 9));
+
+    // cleanup
+    free(response);
+}
+
+TEST_FUNCTION(client_ll_message_callback_that_throws_abandons_the_message)
+{
+    // arrange
+    iothub::client_ll client = create_client();
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, client.set_message_callback([](const iothub::message_view&) -> IOTHUBMESSAGE_DISPOSITION_RESULT {
+        throw std::runtime_error("user code");
+    }));
+
+    // act
+    IOTHUBMESSAGE_DISPOSITION_RESULT result = g_message_callback(TEST_MESSAGE_HANDLE, g_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUBMESSAGE_ABANDONED, result);
+}
+
+TEST_FUNCTION(client_ll_device_method_callback_that_throws_fails_the_method_with_500)
+{
+    // arrange
+    iothub::client_ll client = create_client();
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, client.set_device_method_callback([](std::string_view, iothub::byte_span, std::string& response) -> int {
+        response = "partial";
+        throw std::runtime_error("user code");
+    }));
+    unsigned char* response;
+    size_t response_size;
+
+    // act
+    int result = g_method_callback("reboot", (const unsigned char*)"{}", 2, &response, &response_size, g_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 500, result);
+    ASSERT_ARE_EQUAL(size_t, 0, response_size);
+
+    // cleanup
+    free(response);
+}
+
+TEST_FUNCTION(client_ll_destroys_the_handle)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_CreateFromConnectionString(TEST_CONNECTION_STRING, NULL));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_Destroy(TEST_CLIENT_HANDLE));
+
+    // act
+    {
+        iothub::client_ll client = iothub::client_ll::from_connection_string(TEST_CONNECTION_STRING, NULL);
+        iothub::client_ll moved = std::move(client);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_cpp_ut)
@@ -0,0 +1,180 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#include "iothub_client_crc64.h"
+
+/*the CRC64 storage computes for "123456789"*/
+#define TEST_CHECK_VALUE 0xAE8B14860A799888ULL
+
+static const unsigned char TEST_CHECK_DATA[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+/*a CRC64 computed one bit at a time, the tables are checked against it*/
+static uint64_t bitwise_crc64(const unsigned char* data, size_t size)
+{
+    uint64_t crc = ~(uint64_t)0;
+    size_t i;
+    for (i = 0; i < size; i++)
+    {
+        int bit;
+        crc ^= data[i];
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0x9A6C9329AC4BC9B5ULL) : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+static void fill_test_data(unsigned char* data, size_t size)
+{
+    size_t i;
+    for (i = 0; i < size; i++)
+    {
+        data[i] = (unsigned char)((i * 131) ^ (i >> 3));
+    }
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_crc64_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_CRC64_41_001: [ If data is NULL and size is not 0, crc64_compute shall fail and return crc. ]*/
+TEST_FUNCTION(crc64_compute_NULL_data_fails)
+{
+    // arrange
+
+    // act
+    uint64_t result = crc64_compute(42, NULL, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 42, result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_CRC64_41_002: [ crc64_compute shall return the CRC64 of the bytes before data, whose CRC64 is crc, followed by the size bytes of data. ]*/
+TEST_FUNCTION(crc64_compute_no_bytes_returns_crc)
+{
+    // arrange
+
+    // act
+    uint64_t empty = crc64_compute(0, NULL, 0);
+    uint64_t unchanged = crc64_compute(TEST_CHECK_VALUE, TEST_CHECK_DATA, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 0, empty);
+    ASSERT_ARE_EQUAL(uint64_t, TEST_CHECK_VALUE, unchanged);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_CRC64_41_002: [ crc64_compute shall return the CRC64 of the bytes before data, whose CRC64 is crc, followed by the size bytes of data. ]*/
+TEST_FUNCTION(crc64_compute_returns_the_storage_check_value)
+{
+    // arrange
+
+    // act
+    uint64_t result = crc64_compute(0, TEST_CHECK_DATA, sizeof(TEST_CHECK_DATA));
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, TEST_CHECK_VALUE, result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_CRC64_41_002: [ crc64_compute shall return the CRC64 of the bytes before data, whose CRC64 is crc, followed by the size bytes of data. ]*/
+TEST_FUNCTION(crc64_compute_matches_the_bitwise_crc64_for_every_size_and_alignment)
+{
+    // arrange
+    unsigned char data[64 + 8];
+    size_t offset;
+    size_t size;
+    fill_test_data(data, sizeof(data));
+
+    for (offset = 0; offset < 8; offset++)
+    {
+        for (size = 0; size <= 64; size++)
+        {
+            // act
+            uint64_t result = crc64_compute(0, data + offset, size);
+
+            // assert
+            ASSERT_ARE_EQUAL(uint64_t, bitwise_crc64(data + offset, size), result);
+        }
+    }
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_CRC64_41_002: [ crc64_compute shall return the CRC64 of the bytes before data, whose CRC64 is crc, followed by the size bytes of data. ]*/
+TEST_FUNCTION(crc64_compute_over_several_calls_is_the_crc64_of_all_the_bytes)
+{
+    // arrange
+    unsigned char data[1000];
+    uint64_t expected;
+    uint64_t result;
+    fill_test_data(data, sizeof(data));
+    expected = crc64_compute(0, data, sizeof(data));
+
+    // act
+    result = crc64_compute(0, data, 333);
+    result = crc64_compute(result, data + 333, 5);
+    result = crc64_compute(result, data + 338, sizeof(data) - 338);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, expected, result);
+}
+
+END_TEST_SUITE(iothub_client_crc64_ut)
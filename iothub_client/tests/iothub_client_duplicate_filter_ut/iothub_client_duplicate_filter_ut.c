@@ -0,0 +1,288 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_duplicate_filter.h"
+
+#define TEST_CAPACITY       100
+#define TEST_WINDOW_MS      1000
+#define TEST_MESSAGE_ID     "a0b1c2d3-message"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static DUPLICATE_FILTER_HANDLE create_filter(void)
+{
+    DUPLICATE_FILTER_HANDLE result = duplicate_filter_create(TEST_CAPACITY, TEST_WINDOW_MS);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void add_ids(DUPLICATE_FILTER_HANDLE filter, const char* prefix, size_t count, tickcounter_ms_t nowMs)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        char id[32];
+        (void)snprintf(id, sizeof(id), "%s-%lu", prefix, (unsigned long)i);
+        duplicate_filter_add(filter, id, nowMs);
+    }
+}
+
+BEGIN_TEST_SUITE(iothub_client_duplicate_filter_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_001: [ If capacity or windowInMs is 0, or the filters of capacity ids do not fit a size_t, duplicate_filter_create shall fail and return NULL. ]*/
+TEST_FUNCTION(duplicate_filter_create_with_invalid_arguments_fails)
+{
+    // arrange
+
+    // act
+    DUPLICATE_FILTER_HANDLE result1 = duplicate_filter_create(0, TEST_WINDOW_MS);
+    DUPLICATE_FILTER_HANDLE result2 = duplicate_filter_create(TEST_CAPACITY, 0);
+    DUPLICATE_FILTER_HANDLE result3 = duplicate_filter_create(SIZE_MAX / 4, TEST_WINDOW_MS);
+
+    // assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_002: [ duplicate_filter_create shall allocate, in one block, two empty bloom filters of BITS_PER_ID bits per id of capacity and return a non-NULL handle. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_004: [ duplicate_filter_destroy shall free the filter, doing nothing if filter is NULL. ]*/
+TEST_FUNCTION(duplicate_filter_create_allocates_one_block)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    DUPLICATE_FILTER_HANDLE result = duplicate_filter_create(TEST_CAPACITY, TEST_WINDOW_MS);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(duplicate_filter_contains(result, TEST_MESSAGE_ID, 0));
+
+    // cleanup
+    duplicate_filter_destroy(result);
+    duplicate_filter_destroy(NULL);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_003: [ If allocating fails, duplicate_filter_create shall fail and return NULL. ]*/
+TEST_FUNCTION(duplicate_filter_create_fails_when_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    DUPLICATE_FILTER_HANDLE result = duplicate_filter_create(TEST_CAPACITY, TEST_WINDOW_MS);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_005: [ If filter or messageId is NULL, duplicate_filter_contains shall return false. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_008: [ If filter or messageId is NULL, duplicate_filter_add shall do nothing. ]*/
+TEST_FUNCTION(duplicate_filter_with_NULL_arguments_does_nothing)
+{
+    // arrange
+    DUPLICATE_FILTER_HANDLE filter = create_filter();
+
+    // act
+    duplicate_filter_add(NULL, TEST_MESSAGE_ID, 0);
+    duplicate_filter_add(filter, NULL, 0);
+
+    // assert
+    ASSERT_IS_FALSE(duplicate_filter_contains(NULL, TEST_MESSAGE_ID, 0));
+    ASSERT_IS_FALSE(duplicate_filter_contains(filter, NULL, 0));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    duplicate_filter_destroy(filter);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_007: [ duplicate_filter_contains shall return true if all the bits of messageId are set in the current or the previous filter, false otherwise. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_010: [ duplicate_filter_add shall set the HASH_COUNT bits of messageId, derived from its CRC64, in the current filter. ]*/
+TEST_FUNCTION(duplicate_filter_contains_an_added_id)
+{
+    // arrange
+    DUPLICATE_FILTER_HANDLE filter = create_filter();
+
+    // act
+    duplicate_filter_add(filter, TEST_MESSAGE_ID, 10);
+
+    // assert
+    ASSERT_IS_TRUE(duplicate_filter_contains(filter, TEST_MESSAGE_ID, 20));
+    ASSERT_IS_FALSE(duplicate_filter_contains(filter, "another-message", 20));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    duplicate_filter_destroy(filter);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_006: [ When windowInMs elapsed since the current filter was started, the current filter shall become the previous one, the ids older than two windows being forgotten, and an empty current filter shall be started. ]*/
+TEST_FUNCTION(duplicate_filter_remembers_an_id_for_one_to_two_windows)
+{
+    // arrange
+    DUPLICATE_FILTER_HANDLE filter = create_filter();
+    duplicate_filter_add(filter, TEST_MESSAGE_ID, 10);
+
+    // act
+    bool inNextWindow = duplicate_filter_contains(filter, TEST_MESSAGE_ID, TEST_WINDOW_MS + 10);
+    bool twoWindowsLater = duplicate_filter_contains(filter, TEST_MESSAGE_ID, 2 * TEST_WINDOW_MS + 10);
+
+    // assert
+    ASSERT_IS_TRUE(inNextWindow);
+    ASSERT_IS_FALSE(twoWindowsLater);
+
+    // cleanup
+    duplicate_filter_destroy(filter);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_006: [ When windowInMs elapsed since the current filter was started, the current filter shall become the previous one, the ids older than two windows being forgotten, and an empty current filter shall be started. ]*/
+TEST_FUNCTION(duplicate_filter_forgets_both_filters_after_an_idle_period)
+{
+    // arrange
+    DUPLICATE_FILTER_HANDLE filter = create_filter();
+    duplicate_filter_add(filter, TEST_MESSAGE_ID, 10);
+
+    // act
+    bool result = duplicate_filter_contains(filter, TEST_MESSAGE_ID, 5 * TEST_WINDOW_MS);
+
+    // assert
+    ASSERT_IS_FALSE(result);
+
+    // cleanup
+    duplicate_filter_destroy(filter);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_009: [ When the current filter holds capacity ids, duplicate_filter_add shall make it the previous one and start an empty current filter before adding messageId, bounding the false positives. ]*/
+TEST_FUNCTION(duplicate_filter_rotates_when_the_current_filter_is_full)
+{
+    // arrange
+    DUPLICATE_FILTER_HANDLE filter = create_filter();
+    duplicate_filter_add(filter, TEST_MESSAGE_ID, 0);
+    add_ids(filter, "first", TEST_CAPACITY - 1, 0);
+
+    // act
+    add_ids(filter, "second", 1, 0);
+    bool inPrevious = duplicate_filter_contains(filter, TEST_MESSAGE_ID, 0);
+    add_ids(filter, "third", TEST_CAPACITY, 0);
+    bool forgotten = duplicate_filter_contains(filter, TEST_MESSAGE_ID, 0);
+
+    // assert
+    ASSERT_IS_TRUE(inPrevious);
+    ASSERT_IS_FALSE(forgotten);
+
+    // cleanup
+    duplicate_filter_destroy(filter);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_DUPLICATE_FILTER_41_007: [ duplicate_filter_contains shall return true if all the bits of messageId are set in the current or the previous filter, false otherwise. ]*/
+TEST_FUNCTION(duplicate_filter_false_positives_stay_low_when_full)
+{
+    // arrange
+    size_t i;
+    size_t falsePositives = 0;
+    DUPLICATE_FILTER_HANDLE filter = create_filter();
+    add_ids(filter, "added", TEST_CAPACITY, 0);
+
+    // act
+    for (i = 0; i < 1000; i++)
+    {
+        char id[32];
+        (void)snprintf(id, sizeof(id), "never-added-%lu", (unsigned long)i);
+        if (duplicate_filter_contains(filter, id, 0))
+        {
+            falsePositives++;
+        }
+    }
+
+    // assert
+    ASSERT_IS_TRUE(falsePositives < 50);
+
+    // cleanup
+    duplicate_filter_destroy(filter);
+}
+
+END_TEST_SUITE(iothub_client_duplicate_filter_ut)
@@ -0,0 +1,570 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <cstdbool>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xio.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_options.h"
+#include "iothub_client_happy_eyeballs.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_LOCK_HANDLE                    (LOCK_HANDLE)0x7872
+#define TEST_TICK_COUNTER_HANDLE            (TICK_COUNTER_HANDLE)0x7873
+#define TEST_XIO_HANDLE                     (XIO_HANDLE)0x7874
+
+static const char* TEST_HOST = "hub.azure-devices.net";
+static const char* TEST_OTHER_HOST = "other.azure-devices.net";
+
+static tickcounter_ms_t g_current_ms;
+static unsigned int g_connection_attempt_delay_in_ms;
+static IOTHUB_CLIENT_ADDRESS_FAMILY g_preferred_family;
+static IOTHUB_CLIENT_ADDRESS_FAMILY g_connected_family;
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    *destination = (char*)malloc(strlen(source) + 1);
+    (void)strcpy(*destination, source);
+    return 0;
+}
+
+static int my_xio_setoption(XIO_HANDLE xio, const char* optionName, const void* value)
+{
+    (void)xio;
+    if (strcmp(optionName, OPTION_XIO_CONNECTION_ATTEMPT_DELAY) == 0)
+    {
+        g_connection_attempt_delay_in_ms = *(const unsigned int*)value;
+    }
+    else if (strcmp(optionName, OPTION_XIO_PREFERRED_ADDRESS_FAMILY) == 0)
+    {
+        g_preferred_family = *(const IOTHUB_CLIENT_ADDRESS_FAMILY*)value;
+    }
+    else if (strcmp(optionName, OPTION_XIO_CONNECTED_ADDRESS_FAMILY) == 0)
+    {
+        *(IOTHUB_CLIENT_ADDRESS_FAMILY*)value = g_connected_family;
+    }
+    return 0;
+}
+
+static HAPPY_EYEBALLS_HANDLE create_happy_eyeballs(void)
+{
+    HAPPY_EYEBALLS_HANDLE result = happy_eyeballs_create(300);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void connect_with_family(HAPPY_EYEBALLS_HANDLE happy_eyeballs, const char* host, IOTHUB_CLIENT_ADDRESS_FAMILY family)
+{
+    g_connected_family = family;
+    happy_eyeballs_on_connected(happy_eyeballs, TEST_XIO_HANDLE, host);
+}
+
+static IOTHUB_CLIENT_ADDRESS_FAMILY get_preferred_family(HAPPY_EYEBALLS_HANDLE happy_eyeballs, const char* host)
+{
+    g_preferred_family = IOTHUB_CLIENT_ADDRESS_FAMILY_ANY;
+    happy_eyeballs_prepare_io(happy_eyeballs, TEST_XIO_HANDLE, host);
+    return g_preferred_family;
+}
+
+BEGIN_TEST_SUITE(iothub_client_happy_eyeballs_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, 1);
+
+    REGISTER_GLOBAL_MOCK_HOOK(xio_setoption, my_xio_setoption);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(xio_setoption, __LINE__);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    g_current_ms = 0;
+    g_connection_attempt_delay_in_ms = 0;
+    g_preferred_family = IOTHUB_CLIENT_ADDRESS_FAMILY_ANY;
+    g_connected_family = IOTHUB_CLIENT_ADDRESS_FAMILY_ANY;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_001: [ happy_eyeballs_create shall allocate the happy eyeballs, create its lock and tick counter, and return it with no family remembered. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_005: [ happy_eyeballs_destroy shall free the remembered hosts, destroy the tick counter and the lock and free the happy eyeballs. ]*/
+TEST_FUNCTION(happy_eyeballs_create_and_destroy_succeed)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+
+    // act
+    HAPPY_EYEBALLS_HANDLE result = happy_eyeballs_create(300);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(result));
+
+    happy_eyeballs_destroy(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_002: [ If any of them fails, happy_eyeballs_create shall fail and return NULL. ]*/
+TEST_FUNCTION(happy_eyeballs_create_negative_tests)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        HAPPY_EYEBALLS_HANDLE result = happy_eyeballs_create(300);
+
+        // assert
+        ASSERT_IS_NULL(result);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_003: [ If connection_attempt_delay_in_ms is 0, the connection attempt delay shall be HAPPY_EYEBALLS_DEFAULT_CONNECTION_ATTEMPT_DELAY_IN_MS. ]*/
+TEST_FUNCTION(happy_eyeballs_create_with_0_delay_uses_the_default)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = happy_eyeballs_create(0);
+    ASSERT_IS_NOT_NULL(happy_eyeballs);
+
+    // act
+    happy_eyeballs_prepare_io(happy_eyeballs, TEST_XIO_HANDLE, TEST_HOST);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HAPPY_EYEBALLS_DEFAULT_CONNECTION_ATTEMPT_DELAY_IN_MS, g_connection_attempt_delay_in_ms);
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_004: [ If happy_eyeballs is NULL, happy_eyeballs_destroy shall return. ]*/
+TEST_FUNCTION(happy_eyeballs_destroy_NULL_returns)
+{
+    // act
+    happy_eyeballs_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_006: [ If happy_eyeballs, xio or host is NULL, happy_eyeballs_prepare_io shall return. ]*/
+TEST_FUNCTION(happy_eyeballs_prepare_io_NULL_arguments_return)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+
+    // act
+    happy_eyeballs_prepare_io(NULL, TEST_XIO_HANDLE, TEST_HOST);
+    happy_eyeballs_prepare_io(happy_eyeballs, NULL, TEST_HOST);
+    happy_eyeballs_prepare_io(happy_eyeballs, TEST_XIO_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_007: [ happy_eyeballs_prepare_io shall set the connection attempt delay on xio with OPTION_XIO_CONNECTION_ATTEMPT_DELAY. ]*/
+TEST_FUNCTION(happy_eyeballs_prepare_io_unknown_host_sets_the_delay_only)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_XIO_CONNECTION_ATTEMPT_DELAY, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    happy_eyeballs_prepare_io(happy_eyeballs, TEST_XIO_HANDLE, TEST_HOST);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 300, g_connection_attempt_delay_in_ms);
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_008: [ If xio_setoption fails, happy_eyeballs_prepare_io shall return, the xio connecting with the policy of its platform. ]*/
+TEST_FUNCTION(happy_eyeballs_prepare_io_unsupported_by_the_xio_returns)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+    connect_with_family(happy_eyeballs, TEST_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_XIO_CONNECTION_ATTEMPT_DELAY, IGNORED_PTR_ARG)).SetReturn(__LINE__);
+
+    // act
+    happy_eyeballs_prepare_io(happy_eyeballs, TEST_XIO_HANDLE, TEST_HOST);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_009: [ If Lock or tickcounter_get_current_ms fail, happy_eyeballs_prepare_io shall return without a preferred family. ]*/
+TEST_FUNCTION(happy_eyeballs_prepare_io_Lock_fails_sets_no_preferred_family)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+    connect_with_family(happy_eyeballs, TEST_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_XIO_CONNECTION_ATTEMPT_DELAY, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE)).SetReturn(LOCK_ERROR);
+
+    // act
+    happy_eyeballs_prepare_io(happy_eyeballs, TEST_XIO_HANDLE, TEST_HOST);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_ANY, g_preferred_family);
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_011: [ If a family is remembered for host, happy_eyeballs_prepare_io shall set it on xio with OPTION_XIO_PREFERRED_ADDRESS_FAMILY, a failure being ignored. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_014: [ happy_eyeballs_on_connected shall remember the family for host with the current time, in place of the host that connected the longest ago when HAPPY_EYEBALLS_MAX_HOSTS hosts are remembered. ]*/
+TEST_FUNCTION(happy_eyeballs_prepare_io_sets_the_family_that_won)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+    connect_with_family(happy_eyeballs, TEST_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_XIO_CONNECTION_ATTEMPT_DELAY, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_XIO_PREFERRED_ADDRESS_FAMILY, IGNORED_PTR_ARG));
+
+    // act
+    happy_eyeballs_prepare_io(happy_eyeballs, TEST_XIO_HANDLE, TEST_HOST);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4, g_preferred_family);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_ANY, get_preferred_family(happy_eyeballs, TEST_OTHER_HOST));
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_010: [ A family remembered for HAPPY_EYEBALLS_FAMILY_LIFETIME_IN_MS or more shall be forgotten. ]*/
+TEST_FUNCTION(happy_eyeballs_prepare_io_forgets_an_old_family)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+    connect_with_family(happy_eyeballs, TEST_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6);
+
+    // act
+    g_current_ms = HAPPY_EYEBALLS_FAMILY_LIFETIME_IN_MS - 1;
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6, get_preferred_family(happy_eyeballs, TEST_HOST));
+    g_current_ms = HAPPY_EYEBALLS_FAMILY_LIFETIME_IN_MS;
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_ANY, get_preferred_family(happy_eyeballs, TEST_HOST));
+    g_current_ms = 0;
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_ANY, get_preferred_family(happy_eyeballs, TEST_HOST));
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_012: [ If happy_eyeballs, xio or host is NULL, happy_eyeballs_on_connected shall return. ]*/
+TEST_FUNCTION(happy_eyeballs_on_connected_NULL_arguments_return)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+
+    // act
+    happy_eyeballs_on_connected(NULL, TEST_XIO_HANDLE, TEST_HOST);
+    happy_eyeballs_on_connected(happy_eyeballs, NULL, TEST_HOST);
+    happy_eyeballs_on_connected(happy_eyeballs, TEST_XIO_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_013: [ happy_eyeballs_on_connected shall get the family xio connected with using xio_setoption with OPTION_XIO_CONNECTED_ADDRESS_FAMILY, and return if it fails or gives IOTHUB_CLIENT_ADDRESS_FAMILY_ANY. ]*/
+TEST_FUNCTION(happy_eyeballs_on_connected_without_a_family_remembers_nothing)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_XIO_CONNECTED_ADDRESS_FAMILY, IGNORED_PTR_ARG));
+
+    // act
+    connect_with_family(happy_eyeballs, TEST_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_ANY);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_013: [ happy_eyeballs_on_connected shall get the family xio connected with using xio_setoption with OPTION_XIO_CONNECTED_ADDRESS_FAMILY, and return if it fails or gives IOTHUB_CLIENT_ADDRESS_FAMILY_ANY. ]*/
+TEST_FUNCTION(happy_eyeballs_on_connected_xio_setoption_fails_remembers_nothing)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+    g_connected_family = IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4;
+
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_XIO_CONNECTED_ADDRESS_FAMILY, IGNORED_PTR_ARG)).SetReturn(__LINE__);
+
+    // act
+    happy_eyeballs_on_connected(happy_eyeballs, TEST_XIO_HANDLE, TEST_HOST);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_ANY, get_preferred_family(happy_eyeballs, TEST_HOST));
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_014: [ happy_eyeballs_on_connected shall remember the family for host with the current time, in place of the host that connected the longest ago when HAPPY_EYEBALLS_MAX_HOSTS hosts are remembered. ]*/
+TEST_FUNCTION(happy_eyeballs_on_connected_remembers_the_host)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+    g_connected_family = IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6;
+
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_XIO_CONNECTED_ADDRESS_FAMILY, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_HOST));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    happy_eyeballs_on_connected(happy_eyeballs, TEST_XIO_HANDLE, TEST_HOST);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6, get_preferred_family(happy_eyeballs, TEST_HOST));
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_014: [ happy_eyeballs_on_connected shall remember the family for host with the current time, in place of the host that connected the longest ago when HAPPY_EYEBALLS_MAX_HOSTS hosts are remembered. ]*/
+TEST_FUNCTION(happy_eyeballs_on_connected_updates_a_known_host)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+    connect_with_family(happy_eyeballs, TEST_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6);
+
+    // act
+    connect_with_family(happy_eyeballs, TEST_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4, get_preferred_family(happy_eyeballs, TEST_HOST));
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_014: [ happy_eyeballs_on_connected shall remember the family for host with the current time, in place of the host that connected the longest ago when HAPPY_EYEBALLS_MAX_HOSTS hosts are remembered. ]*/
+TEST_FUNCTION(happy_eyeballs_on_connected_replaces_the_oldest_host)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+    char hosts[HAPPY_EYEBALLS_MAX_HOSTS][32];
+    size_t i;
+
+    for (i = 0; i < HAPPY_EYEBALLS_MAX_HOSTS; i++)
+    {
+        (void)snprintf(hosts[i], sizeof(hosts[i]), "hub%u.azure-devices.net", (unsigned int)i);
+        g_current_ms = 10 + i;
+        connect_with_family(happy_eyeballs, hosts[i], IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4);
+    }
+    g_current_ms = 5;
+    connect_with_family(happy_eyeballs, hosts[3], IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4);
+
+    // act
+    g_current_ms = 100;
+    connect_with_family(happy_eyeballs, TEST_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6, get_preferred_family(happy_eyeballs, TEST_HOST));
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_ANY, get_preferred_family(happy_eyeballs, hosts[3]));
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4, get_preferred_family(happy_eyeballs, hosts[0]));
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_015: [ If happy_eyeballs or host is NULL, happy_eyeballs_on_connect_failed shall return. ]*/
+TEST_FUNCTION(happy_eyeballs_on_connect_failed_NULL_arguments_return)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+
+    // act
+    happy_eyeballs_on_connect_failed(NULL, TEST_HOST);
+    happy_eyeballs_on_connect_failed(happy_eyeballs, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_HAPPY_EYEBALLS_41_016: [ happy_eyeballs_on_connect_failed shall forget the family of host, so its next connection races both families again. ]*/
+TEST_FUNCTION(happy_eyeballs_on_connect_failed_forgets_the_host)
+{
+    // arrange
+    HAPPY_EYEBALLS_HANDLE happy_eyeballs = create_happy_eyeballs();
+    connect_with_family(happy_eyeballs, TEST_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV4);
+    connect_with_family(happy_eyeballs, TEST_OTHER_HOST, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    happy_eyeballs_on_connect_failed(happy_eyeballs, TEST_HOST);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_ANY, get_preferred_family(happy_eyeballs, TEST_HOST));
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ADDRESS_FAMILY_IPV6, get_preferred_family(happy_eyeballs, TEST_OTHER_HOST));
+
+    // cleanup
+    happy_eyeballs_destroy(happy_eyeballs);
+}
+
+END_TEST_SUITE(iothub_client_happy_eyeballs_ut)
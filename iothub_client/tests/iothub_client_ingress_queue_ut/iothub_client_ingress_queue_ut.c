@@ -0,0 +1,346 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_ingress_queue.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static void* TEST_VALUE_1 = (void*)0x4251;
+static void* TEST_VALUE_2 = (void*)0x4252;
+static void* TEST_VALUE_3 = (void*)0x4253;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_ingress_queue_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_001: [ ingress_queue_create shall allocate memory for an empty queue and return a handle to it. ]*/
+TEST_FUNCTION(ingress_queue_create_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    INGRESS_QUEUE_HANDLE result = ingress_queue_create();
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_IS_TRUE(ingress_queue_is_empty(result));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_002: [ If any error occurs, ingress_queue_create shall fail and return NULL. ]*/
+TEST_FUNCTION(ingress_queue_create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    INGRESS_QUEUE_HANDLE result = ingress_queue_create();
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_003: [ If ingress_queue is NULL, ingress_queue_destroy shall return. ]*/
+TEST_FUNCTION(ingress_queue_destroy_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    ingress_queue_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_004: [ ingress_queue_destroy shall free the queue and the nodes of the values not popped yet. The values themselves are not freed. ]*/
+TEST_FUNCTION(ingress_queue_destroy_frees_the_nodes_not_popped)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = ingress_queue_create();
+    (void)ingress_queue_push(ingress_queue, TEST_VALUE_1, NULL);
+    (void)ingress_queue_push(ingress_queue, TEST_VALUE_2, NULL);
+    (void)ingress_queue_pop(ingress_queue);
+    (void)ingress_queue_push(ingress_queue, TEST_VALUE_3, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(ingress_queue));
+
+    // act
+    ingress_queue_destroy(ingress_queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_005: [ If ingress_queue or value are NULL, ingress_queue_push shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(ingress_queue_push_NULL_ingress_queue_fails)
+{
+    // arrange
+
+    // act
+    int result = ingress_queue_push(NULL, TEST_VALUE_1, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_005: [ If ingress_queue or value are NULL, ingress_queue_push shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(ingress_queue_push_NULL_value_fails)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = ingress_queue_create();
+    umock_c_reset_all_calls();
+
+    // act
+    int result = ingress_queue_push(ingress_queue, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(ingress_queue_is_empty(ingress_queue));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_006: [ If allocating the node fails, ingress_queue_push shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(ingress_queue_push_malloc_fails)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = ingress_queue_create();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    int result = ingress_queue_push(ingress_queue, TEST_VALUE_1, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(ingress_queue_is_empty(ingress_queue));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_007: [ ingress_queue_push shall add value to the queue with an atomic compare-and-swap, without taking a lock, and return 0. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_013: [ ingress_queue_is_empty shall return false if a value was pushed and not popped yet, true otherwise. ]*/
+TEST_FUNCTION(ingress_queue_push_succeeds)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = ingress_queue_create();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    int result = ingress_queue_push(ingress_queue, TEST_VALUE_1, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_FALSE(ingress_queue_is_empty(ingress_queue));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_014: [ If was_empty is not NULL, ingress_queue_push shall set it to true when no other value pushed before was left for the consumer to take, false otherwise. ]*/
+TEST_FUNCTION(ingress_queue_push_reports_was_empty_only_for_the_first_value_not_taken)
+{
+    // arrange
+    bool was_empty_1 = false;
+    bool was_empty_2 = true;
+    bool was_empty_3 = false;
+    INGRESS_QUEUE_HANDLE ingress_queue = ingress_queue_create();
+    umock_c_reset_all_calls();
+
+    // act
+    (void)ingress_queue_push(ingress_queue, TEST_VALUE_1, &was_empty_1);
+    (void)ingress_queue_push(ingress_queue, TEST_VALUE_2, &was_empty_2);
+    (void)ingress_queue_pop(ingress_queue);
+    (void)ingress_queue_push(ingress_queue, TEST_VALUE_3, &was_empty_3);
+
+    // assert
+    ASSERT_IS_TRUE(was_empty_1);
+    ASSERT_IS_FALSE(was_empty_2);
+    ASSERT_IS_TRUE(was_empty_3);
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_008: [ If ingress_queue is NULL, ingress_queue_pop shall return NULL. ]*/
+TEST_FUNCTION(ingress_queue_pop_NULL_ingress_queue_returns_NULL)
+{
+    // arrange
+
+    // act
+    void* result = ingress_queue_pop(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_010: [ If the queue is empty, ingress_queue_pop shall return NULL. ]*/
+TEST_FUNCTION(ingress_queue_pop_empty_queue_returns_NULL)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = ingress_queue_create();
+    umock_c_reset_all_calls();
+
+    // act
+    void* result = ingress_queue_pop(ingress_queue);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_009: [ When the values taken before are exhausted, ingress_queue_pop shall take all the values pushed since, in the order they were pushed. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_011: [ ingress_queue_pop shall remove the oldest value from the queue, free its node and return the value. ]*/
+TEST_FUNCTION(ingress_queue_pop_returns_the_values_in_the_order_they_were_pushed)
+{
+    // arrange
+    void* result_1;
+    void* result_2;
+    void* result_3;
+    INGRESS_QUEUE_HANDLE ingress_queue = ingress_queue_create();
+    (void)ingress_queue_push(ingress_queue, TEST_VALUE_1, NULL);
+    (void)ingress_queue_push(ingress_queue, TEST_VALUE_2, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    result_1 = ingress_queue_pop(ingress_queue);
+    (void)ingress_queue_push(ingress_queue, TEST_VALUE_3, NULL);
+    result_2 = ingress_queue_pop(ingress_queue);
+    result_3 = ingress_queue_pop(ingress_queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_1, result_1);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_2, result_2);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_3, result_3);
+    ASSERT_IS_NULL(ingress_queue_pop(ingress_queue));
+    ASSERT_IS_TRUE(ingress_queue_is_empty(ingress_queue));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_INGRESS_QUEUE_41_012: [ If ingress_queue is NULL, ingress_queue_is_empty shall return true. ]*/
+TEST_FUNCTION(ingress_queue_is_empty_NULL_ingress_queue_returns_true)
+{
+    // arrange
+
+    // act
+    bool result = ingress_queue_is_empty(NULL);
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_ingress_queue_ut)
@@ -0,0 +1,360 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/constbuffer.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_json_merge_patch.h"
+
+/*parson is not mocked, the patches are really parsed and serialized*/
+typedef struct TEST_CONSTBUFFER_TAG
+{
+    CONSTBUFFER content;
+} TEST_CONSTBUFFER;
+
+static CONSTBUFFER_HANDLE my_CONSTBUFFER_Create(const unsigned char* source, size_t size)
+{
+    TEST_CONSTBUFFER* result = (TEST_CONSTBUFFER*)malloc(sizeof(TEST_CONSTBUFFER));
+    unsigned char* buffer = (unsigned char*)malloc(size);
+    (void)memcpy(buffer, source, size);
+    result->content.buffer = buffer;
+    result->content.size = size;
+    return (CONSTBUFFER_HANDLE)result;
+}
+
+static const CONSTBUFFER* my_CONSTBUFFER_GetContent(CONSTBUFFER_HANDLE constbufferHandle)
+{
+    return &((TEST_CONSTBUFFER*)constbufferHandle)->content;
+}
+
+static void my_CONSTBUFFER_Destroy(CONSTBUFFER_HANDLE constbufferHandle)
+{
+    free((void*)((TEST_CONSTBUFFER*)constbufferHandle)->content.buffer);
+    free(constbufferHandle);
+}
+
+static CONSTBUFFER_HANDLE create_patch(const char* json)
+{
+    return my_CONSTBUFFER_Create((const unsigned char*)json, strlen(json));
+}
+
+static void assert_patch(CONSTBUFFER_HANDLE patch, const char* expectedJson)
+{
+    const CONSTBUFFER* content;
+    ASSERT_IS_NOT_NULL(patch);
+    content = my_CONSTBUFFER_GetContent(patch);
+    ASSERT_ARE_EQUAL(size_t, strlen(expectedJson), content->size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expectedJson, content->buffer, content->size));
+}
+
+static CONSTBUFFER_HANDLE combine(const char* firstJson, const char* secondJson)
+{
+    CONSTBUFFER_HANDLE first = create_patch(firstJson);
+    CONSTBUFFER_HANDLE result = json_merge_patch_combine(first, (const unsigned char*)secondJson, strlen(secondJson));
+    my_CONSTBUFFER_Destroy(first);
+    return result;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_json_merge_patch_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(CONSTBUFFER_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Create, my_CONSTBUFFER_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_GetContent, my_CONSTBUFFER_GetContent);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Destroy, my_CONSTBUFFER_Destroy);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_001: [ If first or second is NULL or second_size is 0, json_merge_patch_combine shall return NULL. ]*/
+TEST_FUNCTION(json_merge_patch_combine_NULL_first_fails)
+{
+    // arrange
+
+    // act
+    CONSTBUFFER_HANDLE result = json_merge_patch_combine(NULL, (const unsigned char*)"{}", 2);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_001: [ If first or second is NULL or second_size is 0, json_merge_patch_combine shall return NULL. ]*/
+TEST_FUNCTION(json_merge_patch_combine_NULL_second_fails)
+{
+    // arrange
+    CONSTBUFFER_HANDLE first = create_patch("{}");
+
+    // act
+    CONSTBUFFER_HANDLE result = json_merge_patch_combine(first, NULL, 2);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    my_CONSTBUFFER_Destroy(first);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_001: [ If first or second is NULL or second_size is 0, json_merge_patch_combine shall return NULL. ]*/
+TEST_FUNCTION(json_merge_patch_combine_second_size_0_fails)
+{
+    // arrange
+    CONSTBUFFER_HANDLE first = create_patch("{}");
+
+    // act
+    CONSTBUFFER_HANDLE result = json_merge_patch_combine(first, (const unsigned char*)"{}", 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    my_CONSTBUFFER_Destroy(first);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_002: [ If first or second is not a JSON object, json_merge_patch_combine shall return NULL. ]*/
+TEST_FUNCTION(json_merge_patch_combine_second_not_JSON_fails)
+{
+    // act
+    CONSTBUFFER_HANDLE result = combine("{\"a\":1}", "{\"a\":");
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_002: [ If first or second is not a JSON object, json_merge_patch_combine shall return NULL. ]*/
+TEST_FUNCTION(json_merge_patch_combine_first_not_an_object_fails)
+{
+    // act
+    CONSTBUFFER_HANDLE result = combine("[1]", "{\"a\":1}");
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_003: [ json_merge_patch_combine shall set every member of second that is not an object in both patches, null included, to its value in second. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_006: [ json_merge_patch_combine shall return a new CONSTBUFFER_HANDLE holding the combined patch, without null terminator, and leave first unchanged. ]*/
+TEST_FUNCTION(json_merge_patch_combine_adds_the_members_of_second)
+{
+    // arrange
+    const char* second = "{\"b\":\"x\",\"c\":null}";
+    CONSTBUFFER_HANDLE first = create_patch("{\"a\":1}");
+    CONSTBUFFER_HANDLE result;
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(first));
+    STRICT_EXPECTED_CALL(gballoc_malloc(8));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(second) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+
+    // act
+    result = json_merge_patch_combine(first, (const unsigned char*)second, strlen(second));
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_patch(result, "{\"a\":1,\"b\":\"x\",\"c\":null}");
+    assert_patch(first, "{\"a\":1}");
+
+    // cleanup
+    my_CONSTBUFFER_Destroy(result);
+    my_CONSTBUFFER_Destroy(first);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_003: [ json_merge_patch_combine shall set every member of second that is not an object in both patches, null included, to its value in second. ]*/
+TEST_FUNCTION(json_merge_patch_combine_null_in_second_removes_the_member_again)
+{
+    // act
+    CONSTBUFFER_HANDLE result = combine("{\"a\":1,\"b\":2}", "{\"a\":null}");
+
+    // assert
+    assert_patch(result, "{\"a\":null,\"b\":2}");
+
+    // cleanup
+    my_CONSTBUFFER_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_003: [ json_merge_patch_combine shall set every member of second that is not an object in both patches, null included, to its value in second. ]*/
+TEST_FUNCTION(json_merge_patch_combine_value_in_second_replaces_an_object)
+{
+    // act
+    CONSTBUFFER_HANDLE result = combine("{\"a\":{\"x\":1}}", "{\"a\":[1,2]}");
+
+    // assert
+    assert_patch(result, "{\"a\":[1,2]}");
+
+    // cleanup
+    my_CONSTBUFFER_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_004: [ A member that is an object in both patches shall be combined the same way. ]*/
+TEST_FUNCTION(json_merge_patch_combine_combines_the_objects_of_both)
+{
+    // act
+    CONSTBUFFER_HANDLE result = combine("{\"a\":{\"x\":1,\"y\":{\"z\":1}}}", "{\"a\":{\"y\":{\"z\":null},\"w\":3}}");
+
+    // assert
+    assert_patch(result, "{\"a\":{\"x\":1,\"y\":{\"z\":null},\"w\":3}}");
+
+    // cleanup
+    my_CONSTBUFFER_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_003: [ json_merge_patch_combine shall set every member of second that is not an object in both patches, null included, to its value in second. ]*/
+TEST_FUNCTION(json_merge_patch_combine_adds_an_object_missing_from_first)
+{
+    // act
+    CONSTBUFFER_HANDLE result = combine("{\"a\":1}", "{\"b\":{\"x\":null}}");
+
+    // assert
+    assert_patch(result, "{\"a\":1,\"b\":{\"x\":null}}");
+
+    // cleanup
+    my_CONSTBUFFER_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_005: [ If a member is a value or null in first and an object in second, json_merge_patch_combine shall return NULL. ]*/
+TEST_FUNCTION(json_merge_patch_combine_object_after_a_value_fails)
+{
+    // act
+    CONSTBUFFER_HANDLE result = combine("{\"a\":1}", "{\"a\":{\"x\":1}}");
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_005: [ If a member is a value or null in first and an object in second, json_merge_patch_combine shall return NULL. ]*/
+TEST_FUNCTION(json_merge_patch_combine_object_after_null_fails)
+{
+    // act
+    CONSTBUFFER_HANDLE result = combine("{\"a\":{\"b\":null}}", "{\"a\":{\"b\":{\"x\":1}}}");
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_007: [ If any error occurs, json_merge_patch_combine shall return NULL. ]*/
+TEST_FUNCTION(json_merge_patch_combine_malloc_fails)
+{
+    // arrange
+    CONSTBUFFER_HANDLE first = create_patch("{\"a\":1}");
+    CONSTBUFFER_HANDLE result;
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(first));
+    STRICT_EXPECTED_CALL(gballoc_malloc(8))
+        .SetReturn(NULL);
+
+    // act
+    result = json_merge_patch_combine(first, (const unsigned char*)"{}", 2);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    my_CONSTBUFFER_Destroy(first);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_JSON_MERGE_PATCH_41_007: [ If any error occurs, json_merge_patch_combine shall return NULL. ]*/
+TEST_FUNCTION(json_merge_patch_combine_CONSTBUFFER_Create_fails)
+{
+    // arrange
+    CONSTBUFFER_HANDLE first = create_patch("{\"a\":1}");
+    CONSTBUFFER_HANDLE result;
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(first));
+    STRICT_EXPECTED_CALL(gballoc_malloc(8));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(3));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    result = json_merge_patch_combine(first, (const unsigned char*)"{}", 2);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    my_CONSTBUFFER_Destroy(first);
+}
+
+END_TEST_SUITE(iothub_client_json_merge_patch_ut)
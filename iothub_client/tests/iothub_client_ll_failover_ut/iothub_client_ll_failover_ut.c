@@ -0,0 +1,651 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "iothub_message.h"
+#include "iothub_client_ll.h"
+
+MOCKABLE_FUNCTION(, void, test_event_confirmation_callback, IOTHUB_CLIENT_CONFIRMATION_RESULT, result, void*, userContextCallback);
+MOCKABLE_FUNCTION(, void, test_connection_status_callback, IOTHUB_CLIENT_CONNECTION_STATUS, result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON, reason, void*, userContextCallback);
+#undef ENABLE_MOCKS
+
+#include "iothub_client_ll_failover.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+#ifdef __cplusplus
+}
+#endif
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static IOTHUB_CLIENT_LL_HANDLE TEST_PRIMARY_HANDLE = (IOTHUB_CLIENT_LL_HANDLE)0x4301;
+static IOTHUB_CLIENT_LL_HANDLE TEST_STANDBY_HANDLE = (IOTHUB_CLIENT_LL_HANDLE)0x4302;
+static IOTHUB_MESSAGE_HANDLE TEST_MESSAGE_HANDLE = (IOTHUB_MESSAGE_HANDLE)0x4303;
+static IOTHUB_MESSAGE_HANDLE TEST_CLONED_MESSAGE_HANDLE = (IOTHUB_MESSAGE_HANDLE)0x4304;
+static void* TEST_EVENT_CONTEXT = (void*)0x4305;
+static void* TEST_STATUS_CONTEXT = (void*)0x4306;
+
+#define TEST_MAX_SENDS 8
+
+typedef struct TEST_SEND_TAG
+{
+    IOTHUB_CLIENT_LL_HANDLE handle;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+} TEST_SEND;
+
+static TEST_SEND g_sends[TEST_MAX_SENDS];
+static size_t g_send_count;
+static bool g_confirm_while_sending;
+
+static IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK g_status_callbacks[2];
+static void* g_status_contexts[2];
+
+static size_t index_of(IOTHUB_CLIENT_LL_HANDLE handle)
+{
+    return (handle == TEST_PRIMARY_HANDLE) ? 0 : 1;
+}
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_LL_SetConnectionStatusCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connectionStatusCallback, void* userContextCallback)
+{
+    g_status_callbacks[index_of(iotHubClientHandle)] = connectionStatusCallback;
+    g_status_contexts[index_of(iotHubClientHandle)] = userContextCallback;
+    return IOTHUB_CLIENT_OK;
+}
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    (void)eventMessageHandle;
+    if (g_confirm_while_sending)
+    {
+        eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, userContextCallback);
+    }
+    else
+    {
+        g_sends[g_send_count].handle = iotHubClientHandle;
+        g_sends[g_send_count].callback = eventConfirmationCallback;
+        g_sends[g_send_count].context = userContextCallback;
+        g_send_count++;
+    }
+    return IOTHUB_CLIENT_OK;
+}
+
+static void my_IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    size_t i;
+    for (i = 0; i < g_send_count; i++)
+    {
+        if ((g_sends[i].handle == iotHubClientHandle) && (g_sends[i].callback != NULL))
+        {
+            g_sends[i].callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, g_sends[i].context);
+            g_sends[i].callback = NULL;
+        }
+    }
+}
+
+static void confirm_send(size_t i, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    g_sends[i].callback(result, g_sends[i].context);
+    g_sends[i].callback = NULL;
+}
+
+static void report_status(IOTHUB_CLIENT_LL_HANDLE handle, IOTHUB_CLIENT_CONNECTION_STATUS status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason)
+{
+    g_status_callbacks[index_of(handle)](status, reason, g_status_contexts[index_of(handle)]);
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static IOTHUB_CLIENT_LL_FAILOVER_HANDLE create_connected_failover(void)
+{
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE result = IoTHubClient_LL_Failover_Create(TEST_PRIMARY_HANDLE, TEST_STANDBY_HANDLE);
+    ASSERT_IS_NOT_NULL(result);
+    (void)IoTHubClient_LL_Failover_SetConnectionStatusCallback(result, test_connection_status_callback, TEST_STATUS_CONTEXT);
+    report_status(TEST_PRIMARY_HANDLE, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+    report_status(TEST_STANDBY_HANDLE, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothub_client_ll_failover_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_LL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS_REASON, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SetConnectionStatusCallback, my_IoTHubClient_LL_SetConnectionStatusCallback);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_SetConnectionStatusCallback, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SendEventAsync, my_IoTHubClient_LL_SendEventAsync);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_SendEventAsync, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_Destroy, my_IoTHubClient_LL_Destroy);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Clone, TEST_CLONED_MESSAGE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_Clone, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+    memset(g_sends, 0, sizeof(g_sends));
+    g_send_count = 0;
+    g_confirm_while_sending = false;
+    memset(g_status_callbacks, 0, sizeof(g_status_callbacks));
+    memset(g_status_contexts, 0, sizeof(g_status_contexts));
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_001: [ If primaryHandle or standbyHandle is NULL, or they are the same handle, IoTHubClient_LL_Failover_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_Create_with_invalid_handles_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE result1 = IoTHubClient_LL_Failover_Create(NULL, TEST_STANDBY_HANDLE);
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE result2 = IoTHubClient_LL_Failover_Create(TEST_PRIMARY_HANDLE, NULL);
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE result3 = IoTHubClient_LL_Failover_Create(TEST_PRIMARY_HANDLE, TEST_PRIMARY_HANDLE);
+
+    // assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_002: [ IoTHubClient_LL_Failover_Create shall set the connection status callback of both clients, make primaryHandle the active client and return a non-NULL handle owning both clients. ]*/
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_019: [ IoTHubClient_LL_Failover_GetActiveHandle shall return the active client, NULL if failoverHandle is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_Create_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetConnectionStatusCallback(TEST_PRIMARY_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetConnectionStatusCallback(TEST_STANDBY_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE result = IoTHubClient_LL_Failover_Create(TEST_PRIMARY_HANDLE, TEST_STANDBY_HANDLE);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_PRIMARY_HANDLE, IoTHubClient_LL_Failover_GetActiveHandle(result));
+    ASSERT_IS_NULL(IoTHubClient_LL_Failover_GetActiveHandle(NULL));
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_003: [ If any error occurs, IoTHubClient_LL_Failover_Create shall fail, leave the connection status callback of the clients unset and return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_Create_negative_tests)
+{
+    // arrange
+    size_t i;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetConnectionStatusCallback(TEST_PRIMARY_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetConnectionStatusCallback(TEST_STANDBY_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        IOTHUB_CLIENT_LL_FAILOVER_HANDLE result;
+
+        /*DList_InitializeListHead cannot fail*/
+        if (i == 1)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+        g_status_callbacks[0] = NULL;
+
+        // act
+        result = IoTHubClient_LL_Failover_Create(TEST_PRIMARY_HANDLE, TEST_STANDBY_HANDLE);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, "IoTHubClient_LL_Failover_Create was expected to fail");
+        ASSERT_IS_NULL(g_status_callbacks[0]);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_004: [ If failoverHandle is NULL, IoTHubClient_LL_Failover_Destroy shall do nothing. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_Destroy_with_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    IoTHubClient_LL_Failover_Destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_005: [ IoTHubClient_LL_Failover_Destroy shall destroy both clients, which confirm the events not confirmed yet, and free the failover client. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_Destroy_destroys_both_clients_and_confirms_the_events)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    (void)IoTHubClient_LL_Failover_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_Destroy(TEST_PRIMARY_HANDLE));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_CLONED_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, TEST_EVENT_CONTEXT));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_Destroy(TEST_STANDBY_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_LL_Failover_Destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_006: [ IoTHubClient_LL_Failover_DoWork shall call IoTHubClient_LL_DoWork on both clients, so the standby one connects and stays connected. ]*/
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_018: [ If failoverHandle is NULL, IoTHubClient_LL_Failover_DoWork shall do nothing. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_DoWork_does_the_work_of_both_clients)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_DoWork(TEST_PRIMARY_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_DoWork(TEST_STANDBY_HANDLE));
+
+    // act
+    IoTHubClient_LL_Failover_DoWork(handle);
+    IoTHubClient_LL_Failover_DoWork(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_013: [ If failoverHandle or eventMessageHandle is NULL, or eventConfirmationCallback is NULL and userContextCallback is not, IoTHubClient_LL_Failover_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_SendEventAsync_with_invalid_args_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+
+    // act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_LL_Failover_SendEventAsync(NULL, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_Failover_SendEventAsync(handle, NULL, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+    IOTHUB_CLIENT_RESULT result3 = IoTHubClient_LL_Failover_SendEventAsync(handle, TEST_MESSAGE_HANDLE, NULL, TEST_EVENT_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_014: [ IoTHubClient_LL_Failover_SendEventAsync shall keep a clone of eventMessageHandle, sharing its content, until the event is confirmed and send it with IoTHubClient_LL_SendEventAsync through the active client. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_SendEventAsync_sends_a_clone_through_the_primary_client)
+{
+    // arrange
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync(TEST_PRIMARY_HANDLE, TEST_CLONED_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    result = IoTHubClient_LL_Failover_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_send_count);
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_015: [ If any error occurs, IoTHubClient_LL_Failover_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR, or the error of IoTHubClient_LL_SendEventAsync. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_SendEventAsync_negative_tests)
+{
+    // arrange
+    size_t i;
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync(TEST_PRIMARY_HANDLE, TEST_CLONED_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        IOTHUB_CLIENT_RESULT result;
+
+        /*DList_InsertTailList cannot fail*/
+        if (i == 2)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        result = IoTHubClient_LL_Failover_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+
+        // assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_ERROR, result);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_Destroy(TEST_PRIMARY_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_Destroy(TEST_STANDBY_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    IoTHubClient_LL_Failover_Destroy(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_011: [ The confirmation of an event shall be given to eventConfirmationCallback only when it comes from the client the event was sent through last, the confirmations of the client it was moved from being ignored. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_confirmation_of_the_active_client_is_given_to_the_application)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    (void)IoTHubClient_LL_Failover_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_CLONED_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, TEST_EVENT_CONTEXT));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    confirm_send(0, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_011: [ The confirmation of an event shall be given to eventConfirmationCallback only when it comes from the client the event was sent through last, the confirmations of the client it was moved from being ignored. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_SendEventAsync_confirmed_while_sending_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    g_confirm_while_sending = true;
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync(TEST_PRIMARY_HANDLE, TEST_CLONED_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_CLONED_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, TEST_EVENT_CONTEXT));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    result = IoTHubClient_LL_Failover_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_007: [ When the active client reports IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED while the other one is connected, the other one shall become the active one. ]*/
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_009: [ When the active client is switched, the events sent through the lost one and not confirmed yet shall be sent again through the new active one, in the order they were sent, the events whose IoTHubClient_LL_SendEventAsync fails staying with the lost one. ]*/
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_010: [ When the active client is switched, the connection status callback shall be called with IOTHUB_CLIENT_CONNECTION_AUTHENTICATED and IOTHUB_CLIENT_CONNECTION_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_primary_lost_sends_the_events_again_through_the_standby_client)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    (void)IoTHubClient_LL_Failover_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+    (void)IoTHubClient_LL_Failover_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync(TEST_STANDBY_HANDLE, TEST_CLONED_MESSAGE_HANDLE, IGNORED_PTR_ARG, g_sends[0].context));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync(TEST_STANDBY_HANDLE, TEST_CLONED_MESSAGE_HANDLE, IGNORED_PTR_ARG, g_sends[1].context));
+    STRICT_EXPECTED_CALL(test_connection_status_callback(IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK, TEST_STATUS_CONTEXT));
+
+    // act
+    report_status(TEST_PRIMARY_HANDLE, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_STANDBY_HANDLE, IoTHubClient_LL_Failover_GetActiveHandle(handle));
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_011: [ The confirmation of an event shall be given to eventConfirmationCallback only when it comes from the client the event was sent through last, the confirmations of the client it was moved from being ignored. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_confirmation_of_the_lost_client_is_ignored)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    (void)IoTHubClient_LL_Failover_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, TEST_EVENT_CONTEXT);
+    report_status(TEST_PRIMARY_HANDLE, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_CLONED_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, TEST_EVENT_CONTEXT));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    confirm_send(0, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    confirm_send(1, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_012: [ The connection status of the active client shall be given to the connection status callback as it is, the one of the standby client not at all. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_primary_lost_with_standby_down_is_reported)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    report_status(TEST_STANDBY_HANDLE, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
+
+    STRICT_EXPECTED_CALL(test_connection_status_callback(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK, TEST_STATUS_CONTEXT));
+
+    // act
+    report_status(TEST_PRIMARY_HANDLE, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_PRIMARY_HANDLE, IoTHubClient_LL_Failover_GetActiveHandle(handle));
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_008: [ When the standby client reports IOTHUB_CLIENT_CONNECTION_AUTHENTICATED after the active one reported IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, the standby one shall become the active one. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_standby_connected_after_primary_lost_becomes_active)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = create_connected_failover();
+    report_status(TEST_STANDBY_HANDLE, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
+    report_status(TEST_PRIMARY_HANDLE, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_connection_status_callback(IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK, TEST_STATUS_CONTEXT));
+
+    // act
+    report_status(TEST_STANDBY_HANDLE, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_STANDBY_HANDLE, IoTHubClient_LL_Failover_GetActiveHandle(handle));
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_008: [ When the standby client reports IOTHUB_CLIENT_CONNECTION_AUTHENTICATED after the active one reported IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, the standby one shall become the active one. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_standby_connected_first_does_not_become_active)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = IoTHubClient_LL_Failover_Create(TEST_PRIMARY_HANDLE, TEST_STANDBY_HANDLE);
+    (void)IoTHubClient_LL_Failover_SetConnectionStatusCallback(handle, test_connection_status_callback, TEST_STATUS_CONTEXT);
+    umock_c_reset_all_calls();
+
+    // act
+    report_status(TEST_STANDBY_HANDLE, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_PRIMARY_HANDLE, IoTHubClient_LL_Failover_GetActiveHandle(handle));
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_016: [ If failoverHandle is NULL, IoTHubClient_LL_Failover_SetConnectionStatusCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_SetConnectionStatusCallback_with_NULL_handle_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_Failover_SetConnectionStatusCallback(NULL, test_connection_status_callback, TEST_STATUS_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_FAILOVER_41_017: [ IoTHubClient_LL_Failover_SetConnectionStatusCallback shall store connectionStatusCallback and userContextCallback and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Failover_SetConnectionStatusCallback_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_FAILOVER_HANDLE handle = IoTHubClient_LL_Failover_Create(TEST_PRIMARY_HANDLE, TEST_STANDBY_HANDLE);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(test_connection_status_callback(IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK, TEST_STATUS_CONTEXT));
+
+    // act
+    result = IoTHubClient_LL_Failover_SetConnectionStatusCallback(handle, test_connection_status_callback, TEST_STATUS_CONTEXT);
+    report_status(TEST_PRIMARY_HANDLE, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Failover_Destroy(handle);
+}
+
+END_TEST_SUITE(iothub_client_ll_failover_ut)
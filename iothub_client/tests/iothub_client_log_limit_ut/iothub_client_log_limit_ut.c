@@ -0,0 +1,200 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#include "iothub_client_log_limit.h"
+
+static size_t g_argument_evaluation_count;
+
+static int evaluate_argument(void)
+{
+    g_argument_evaluation_count++;
+    return (int)g_argument_evaluation_count;
+}
+
+static void log_limited(void)
+{
+    LogErrorLimited("evaluated %d times", evaluate_argument());
+}
+
+static void log_burst(IOTHUB_CLIENT_LOG_LIMIT* limit)
+{
+    size_t i;
+    size_t suppressed;
+    for (i = 0; i < IOTHUB_CLIENT_LOG_LIMIT_BURST; i++)
+    {
+        (void)iothub_client_log_limit_check(limit, &suppressed);
+    }
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_log_limit_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+
+    g_argument_evaluation_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_001: [ The first message of a call site, and the first one after IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS have passed since an interval started, shall start a new interval and be logged. ]*/
+TEST_FUNCTION(iothub_client_log_limit_check_logs_the_burst)
+{
+    // arrange
+    IOTHUB_CLIENT_LOG_LIMIT limit;
+    size_t suppressed = 42;
+    size_t i;
+    (void)memset(&limit, 0, sizeof(limit));
+
+    for (i = 0; i < IOTHUB_CLIENT_LOG_LIMIT_BURST; i++)
+    {
+        // act
+        int result = iothub_client_log_limit_check(&limit, &suppressed);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 0, suppressed);
+    }
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_002: [ After IOTHUB_CLIENT_LOG_LIMIT_BURST messages have been logged in an interval, iothub_client_log_limit_check shall count the others of the interval as suppressed and return 0. ]*/
+TEST_FUNCTION(iothub_client_log_limit_check_suppresses_after_the_burst)
+{
+    // arrange
+    IOTHUB_CLIENT_LOG_LIMIT limit;
+    size_t suppressed;
+    int result1;
+    int result2;
+    (void)memset(&limit, 0, sizeof(limit));
+    log_burst(&limit);
+
+    // act
+    result1 = iothub_client_log_limit_check(&limit, &suppressed);
+    result2 = iothub_client_log_limit_check(&limit, &suppressed);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(size_t, 0, suppressed);
+    ASSERT_ARE_EQUAL(size_t, 2, limit.suppressed);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_001: [ The first message of a call site, and the first one after IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS have passed since an interval started, shall start a new interval and be logged. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_003: [ When a message is logged after some were suppressed, iothub_client_log_limit_check shall set suppressed to their number and start counting them again from 0. ]*/
+TEST_FUNCTION(iothub_client_log_limit_check_reports_the_suppressed_in_the_next_interval)
+{
+    // arrange
+    IOTHUB_CLIENT_LOG_LIMIT limit;
+    size_t suppressed;
+    int result;
+    (void)memset(&limit, 0, sizeof(limit));
+    log_burst(&limit);
+    (void)iothub_client_log_limit_check(&limit, &suppressed);
+    (void)iothub_client_log_limit_check(&limit, &suppressed);
+    (void)iothub_client_log_limit_check(&limit, &suppressed);
+    limit.intervalStart -= IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS;
+
+    // act
+    result = iothub_client_log_limit_check(&limit, &suppressed);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 3, suppressed);
+    ASSERT_ARE_EQUAL(size_t, 0, limit.suppressed);
+    ASSERT_ARE_EQUAL(size_t, 1, limit.loggedInInterval);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_001: [ The first message of a call site, and the first one after IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS have passed since an interval started, shall start a new interval and be logged. ]*/
+TEST_FUNCTION(iothub_client_log_limit_check_starts_a_new_burst_in_the_next_interval)
+{
+    // arrange
+    IOTHUB_CLIENT_LOG_LIMIT limit;
+    size_t suppressed;
+    int result;
+    (void)memset(&limit, 0, sizeof(limit));
+    log_burst(&limit);
+    limit.intervalStart -= IOTHUB_CLIENT_LOG_LIMIT_INTERVAL_MS;
+    log_burst(&limit);
+
+    // act
+    result = iothub_client_log_limit_check(&limit, &suppressed);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, limit.suppressed);
+}
+
+#ifndef NO_LOGGING
+/* Tests_SRS_IOTHUB_CLIENT_LOG_LIMIT_41_002: [ After IOTHUB_CLIENT_LOG_LIMIT_BURST messages have been logged in an interval, iothub_client_log_limit_check shall count the others of the interval as suppressed and return 0. ]*/
+TEST_FUNCTION(LogErrorLimited_does_not_evaluate_the_suppressed_messages)
+{
+    // arrange
+    size_t i;
+
+    // act
+    for (i = 0; i < IOTHUB_CLIENT_LOG_LIMIT_BURST + 3; i++)
+    {
+        log_limited();
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, IOTHUB_CLIENT_LOG_LIMIT_BURST, g_argument_evaluation_count);
+}
+#endif
+
+END_TEST_SUITE(iothub_client_log_limit_ut)
@@ -0,0 +1,545 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_memory_pool.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4241;
+
+/*the blocks of 10 bytes are rounded up to the alignment*/
+static const IOTHUB_CLIENT_MEMORY_POOL_CLASS TEST_CLASSES[] =
+{
+    { 10, 2 },
+    { 100, 1 }
+};
+
+#define TEST_CLASS_COUNT (sizeof(TEST_CLASSES) / sizeof(TEST_CLASSES[0]))
+
+static unsigned char g_memory[4096];
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static bool is_in_pools(const void* ptr)
+{
+    return ((const unsigned char*)ptr >= g_memory) && ((const unsigned char*)ptr < g_memory + sizeof(g_memory));
+}
+
+static IOTHUB_CLIENT_MEMORY_POOL_STATISTICS get_statistics(size_t classIndex)
+{
+    IOTHUB_CLIENT_MEMORY_POOL_STATISTICS statistics;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_MemoryPool_GetStatistics(classIndex, &statistics);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_OK, (int)result);
+    return statistics;
+}
+
+static void init_test_pools(void)
+{
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_MemoryPool_Init(TEST_CLASSES, TEST_CLASS_COUNT, g_memory, sizeof(g_memory));
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_OK, (int)result);
+    umock_c_reset_all_calls();
+}
+
+BEGIN_TEST_SUITE(iothub_client_memory_pool_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    IoTHubClient_MemoryPool_Deinit();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_001: [ If limits or classes is NULL, or maxInFlightMessages or maxMessageSize is 0, IoTHubClient_MemoryPool_GetDefaultClasses shall return 0. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_GetDefaultClasses_without_messages_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_POOL_LIMITS limits = { 0, 1024, 4 };
+    IOTHUB_CLIENT_MEMORY_POOL_CLASS classes[IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES];
+
+    // act
+    size_t result = IoTHubClient_MemoryPool_GetDefaultClasses(&limits, classes);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_MemoryPool_GetDefaultClasses(NULL, classes));
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_002: [ IoTHubClient_MemoryPool_GetDefaultClasses shall fill classes of 32 to 4096 bytes with blocks for maxInFlightMessages messages of maxProperties properties, plus a block of maxMessageSize bytes per message, and return the number of classes it filled. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_GetDefaultClasses_adds_a_class_for_large_messages)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_POOL_LIMITS small_limits = { 8, 1000, 4 };
+    IOTHUB_CLIENT_MEMORY_POOL_LIMITS large_limits = { 8, 10000, 4 };
+    IOTHUB_CLIENT_MEMORY_POOL_CLASS small_classes[IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES];
+    IOTHUB_CLIENT_MEMORY_POOL_CLASS large_classes[IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES];
+
+    // act
+    size_t small_count = IoTHubClient_MemoryPool_GetDefaultClasses(&small_limits, small_classes);
+    size_t large_count = IoTHubClient_MemoryPool_GetDefaultClasses(&large_limits, large_classes);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 7, small_count);
+    ASSERT_ARE_EQUAL(size_t, 32, small_classes[0].blockSize);
+    ASSERT_ARE_EQUAL(size_t, 32 + 8 * (2 * 4 + 4), small_classes[0].blockCount);
+    ASSERT_ARE_EQUAL(size_t, 1024, small_classes[5].blockSize);
+    ASSERT_ARE_EQUAL(size_t, 8 + 8, small_classes[5].blockCount);
+    ASSERT_ARE_EQUAL(size_t, 8, large_count);
+    ASSERT_ARE_EQUAL(size_t, 8, large_classes[5].blockCount);
+    ASSERT_ARE_EQUAL(size_t, 10000, large_classes[7].blockSize);
+    ASSERT_ARE_EQUAL(size_t, 8, large_classes[7].blockCount);
+    ASSERT_ARE_NOT_EQUAL(size_t, 0, IoTHubClient_MemoryPool_GetRequiredSize(large_classes, large_count));
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_003: [ If classes is NULL, classCount is 0 or more than IOTHUB_CLIENT_MEMORY_POOL_MAX_CLASSES, a class has no block or a 0 blockSize, or the blockSizes are not ascending, IoTHubClient_MemoryPool_GetRequiredSize shall return 0. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_GetRequiredSize_with_classes_not_ascending_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_POOL_CLASS classes[] = { { 100, 1 }, { 100, 1 } };
+    IOTHUB_CLIENT_MEMORY_POOL_CLASS empty_class[] = { { 100, 0 } };
+
+    // act
+    size_t result = IoTHubClient_MemoryPool_GetRequiredSize(classes, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_MemoryPool_GetRequiredSize(empty_class, 1));
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_MemoryPool_GetRequiredSize(NULL, 1));
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_MemoryPool_GetRequiredSize(classes, 0));
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_004: [ IoTHubClient_MemoryPool_GetRequiredSize shall return the size of the blocks of all the classes, each rounded up to the alignment of malloc, plus the alignment of the memory, or 0 if it overflows. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_GetRequiredSize_rounds_the_blocks_up)
+{
+    // act
+    size_t result = IoTHubClient_MemoryPool_GetRequiredSize(TEST_CLASSES, TEST_CLASS_COUNT);
+
+    // assert
+    ASSERT_IS_TRUE(result >= 2 * 16 + 100);
+    ASSERT_IS_TRUE(result <= 2 * 16 + 112 + 15);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_005: [ If memory is NULL, the classes are invalid or size is less than their required size, IoTHubClient_MemoryPool_Init shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_Init_with_too_little_memory_fails)
+{
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_MemoryPool_Init(TEST_CLASSES, TEST_CLASS_COUNT, g_memory, 64);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_INVALID_ARG, (int)result);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_INVALID_ARG, (int)IoTHubClient_MemoryPool_Init(TEST_CLASSES, TEST_CLASS_COUNT, NULL, sizeof(g_memory)));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_006: [ If the memory pools are already initialized or their lock cannot be created, IoTHubClient_MemoryPool_Init shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_Init_twice_fails)
+{
+    // arrange
+    init_test_pools();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_MemoryPool_Init(TEST_CLASSES, TEST_CLASS_COUNT, g_memory, sizeof(g_memory));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_006: [ If the memory pools are already initialized or their lock cannot be created, IoTHubClient_MemoryPool_Init shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_Init_fails_when_Lock_Init_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(Lock_Init())
+        .SetReturn(NULL);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_MemoryPool_Init(TEST_CLASSES, TEST_CLASS_COUNT, g_memory, sizeof(g_memory));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_007: [ IoTHubClient_MemoryPool_Init shall carve the blocks of every class out of memory, aligned like malloc, and return IOTHUB_CLIENT_OK. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_009: [ An allocation shall take a block of the smallest class whose blockSize fits it and that has a free block, or until IoTHubClient_MemoryPool_EndInit come from the heap if there is none. ]*/
+TEST_FUNCTION(iothub_client_memory_pool_malloc_takes_aligned_blocks_of_the_smallest_class)
+{
+    // arrange
+    void* first;
+    void* second;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_MemoryPool_Init(TEST_CLASSES, TEST_CLASS_COUNT, g_memory + 1, sizeof(g_memory) - 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    first = iothub_client_memory_pool_malloc(10);
+    second = iothub_client_memory_pool_malloc(1);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_OK, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(is_in_pools(first));
+    ASSERT_IS_TRUE(is_in_pools(second));
+    ASSERT_ARE_EQUAL(size_t, 0, ((size_t)first) % sizeof(void*));
+    ASSERT_ARE_EQUAL(size_t, 2, get_statistics(0).blocksInUse);
+    ASSERT_ARE_EQUAL(size_t, 0, get_statistics(1).blocksInUse);
+
+    // cleanup
+    iothub_client_memory_pool_free(first);
+    iothub_client_memory_pool_free(second);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_009: [ An allocation shall take a block of the smallest class whose blockSize fits it and that has a free block, or until IoTHubClient_MemoryPool_EndInit come from the heap if there is none. ]*/
+TEST_FUNCTION(iothub_client_memory_pool_malloc_takes_a_larger_block_when_its_class_is_exhausted)
+{
+    // arrange
+    void* first;
+    void* second;
+    void* third;
+    void* fourth;
+    init_test_pools();
+    first = iothub_client_memory_pool_malloc(8);
+    second = iothub_client_memory_pool_malloc(8);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_malloc(8));
+
+    // act
+    third = iothub_client_memory_pool_malloc(8);
+    fourth = iothub_client_memory_pool_malloc(8);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(is_in_pools(third));
+    ASSERT_ARE_EQUAL(size_t, 1, get_statistics(1).blocksInUse);
+    ASSERT_IS_NOT_NULL(fourth);
+    ASSERT_IS_FALSE(is_in_pools(fourth));
+    ASSERT_ARE_EQUAL(size_t, 0, get_statistics(0).exhaustions);
+
+    // cleanup
+    iothub_client_memory_pool_free(first);
+    iothub_client_memory_pool_free(second);
+    iothub_client_memory_pool_free(third);
+    iothub_client_memory_pool_free(fourth);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_008: [ Before IoTHubClient_MemoryPool_Init and after IoTHubClient_MemoryPool_Deinit, the allocations shall come from the heap. ]*/
+TEST_FUNCTION(iothub_client_memory_pool_malloc_before_init_comes_from_the_heap)
+{
+    // arrange
+    void* ptr;
+    STRICT_EXPECTED_CALL(gballoc_malloc(10));
+
+    // act
+    ptr = iothub_client_memory_pool_malloc(10);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(ptr);
+
+    // cleanup
+    iothub_client_memory_pool_free(ptr);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_010: [ After IoTHubClient_MemoryPool_EndInit, an allocation no class from the smallest fitting one up has a free block for shall fail, be logged and be counted in the exhaustions of the smallest fitting class, or of the largest class if none fits. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_014: [ IoTHubClient_MemoryPool_EndInit shall make the allocations the pools cannot serve fail from then on. ]*/
+TEST_FUNCTION(iothub_client_memory_pool_malloc_after_EndInit_fails_when_the_pools_are_exhausted)
+{
+    // arrange
+    void* first;
+    void* second;
+    void* third;
+    void* exhausted;
+    void* too_large;
+    init_test_pools();
+    first = iothub_client_memory_pool_malloc(8);
+    second = iothub_client_memory_pool_malloc(8);
+    third = iothub_client_memory_pool_malloc(8);
+    IoTHubClient_MemoryPool_EndInit();
+    umock_c_reset_all_calls();
+
+    // act
+    exhausted = iothub_client_memory_pool_malloc(8);
+    too_large = iothub_client_memory_pool_malloc(1000);
+
+    // assert
+    ASSERT_IS_NULL(exhausted);
+    ASSERT_IS_NULL(too_large);
+    ASSERT_ARE_EQUAL(size_t, 1, get_statistics(0).exhaustions);
+    ASSERT_ARE_EQUAL(size_t, 1, get_statistics(1).exhaustions);
+    ASSERT_ARE_EQUAL(char_ptr, "[Lock(0x4241)][Unlock(0x4241)][Lock(0x4241)][Unlock(0x4241)][Lock(0x4241)][Unlock(0x4241)][Lock(0x4241)][Unlock(0x4241)]", umock_c_get_actual_calls());
+
+    // cleanup
+    iothub_client_memory_pool_free(first);
+    iothub_client_memory_pool_free(second);
+    iothub_client_memory_pool_free(third);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_011: [ iothub_client_memory_pool_free shall return a block to its class, and free to the heap a ptr that is not in the memory of the pools. ]*/
+TEST_FUNCTION(iothub_client_memory_pool_free_returns_the_block_to_its_class)
+{
+    // arrange
+    void* ptr;
+    void* heap_ptr = my_gballoc_malloc(4);
+    init_test_pools();
+    ptr = iothub_client_memory_pool_malloc(50);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(heap_ptr));
+
+    // act
+    iothub_client_memory_pool_free(ptr);
+    iothub_client_memory_pool_free(heap_ptr);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, get_statistics(1).blocksInUse);
+    ASSERT_ARE_EQUAL(size_t, 1, get_statistics(1).peakBlocksInUse);
+    ASSERT_IS_TRUE(iothub_client_memory_pool_malloc(50) == ptr);
+
+    // cleanup
+    iothub_client_memory_pool_free(ptr);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_012: [ iothub_client_memory_pool_realloc shall return ptr when size fits in its block, and otherwise allocate a new block, copy the old block into it and return the old block to its class. ]*/
+TEST_FUNCTION(iothub_client_memory_pool_realloc_moves_to_a_larger_block)
+{
+    // arrange
+    char* ptr;
+    char* same;
+    char* moved;
+    init_test_pools();
+    ptr = (char*)iothub_client_memory_pool_malloc(6);
+    (void)strcpy(ptr, "hello");
+
+    // act
+    same = (char*)iothub_client_memory_pool_realloc(ptr, 10);
+    moved = (char*)iothub_client_memory_pool_realloc(same, 60);
+
+    // assert
+    ASSERT_IS_TRUE(same == ptr);
+    ASSERT_IS_TRUE(is_in_pools(moved));
+    ASSERT_ARE_EQUAL(char_ptr, "hello", moved);
+    ASSERT_ARE_EQUAL(size_t, 0, get_statistics(0).blocksInUse);
+    ASSERT_ARE_EQUAL(size_t, 1, get_statistics(1).blocksInUse);
+
+    // cleanup
+    iothub_client_memory_pool_free(moved);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_013: [ iothub_client_memory_pool_realloc shall realloc on the heap a ptr that is not in the memory of the pools until IoTHubClient_MemoryPool_EndInit, and fail after it. ]*/
+TEST_FUNCTION(iothub_client_memory_pool_realloc_of_a_heap_allocation_after_EndInit_fails)
+{
+    // arrange
+    void* heap_ptr = my_gballoc_malloc(4);
+    void* result;
+    init_test_pools();
+    heap_ptr = iothub_client_memory_pool_realloc(heap_ptr, 8);
+    ASSERT_IS_NOT_NULL(heap_ptr);
+    IoTHubClient_MemoryPool_EndInit();
+    umock_c_reset_all_calls();
+
+    // act
+    result = iothub_client_memory_pool_realloc(heap_ptr, 16);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    my_gballoc_free(heap_ptr);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_009: [ An allocation shall take a block of the smallest class whose blockSize fits it and that has a free block, or until IoTHubClient_MemoryPool_EndInit come from the heap if there is none. ]*/
+TEST_FUNCTION(iothub_client_memory_pool_calloc_zeroes_a_block)
+{
+    // arrange
+    unsigned char* ptr;
+    size_t index;
+    init_test_pools();
+    ptr = (unsigned char*)iothub_client_memory_pool_malloc(100);
+    (void)memset(ptr, 0xAA, 100);
+    iothub_client_memory_pool_free(ptr);
+
+    // act
+    ptr = (unsigned char*)iothub_client_memory_pool_calloc(10, 10);
+
+    // assert
+    ASSERT_IS_TRUE(is_in_pools(ptr));
+    for (index = 0; index < 100; index++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, (int)ptr[index]);
+    }
+
+    // cleanup
+    iothub_client_memory_pool_free(ptr);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_015: [ If statistics is NULL or classIndex is not the index of a class, IoTHubClient_MemoryPool_GetStatistics shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_GetStatistics_with_an_invalid_class_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_POOL_STATISTICS statistics;
+    init_test_pools();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_MemoryPool_GetStatistics(TEST_CLASS_COUNT, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_INVALID_ARG, (int)result);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_INVALID_ARG, (int)IoTHubClient_MemoryPool_GetStatistics(0, NULL));
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_016: [ If locking the pools fails, IoTHubClient_MemoryPool_GetStatistics shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_GetStatistics_fails_when_Lock_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_POOL_STATISTICS statistics;
+    init_test_pools();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_MemoryPool_GetStatistics(0, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_017: [ IoTHubClient_MemoryPool_GetStatistics shall copy the block size and count of the class, the blocks it has in use, their peak and its exhaustions into statistics, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_GetStatistics_returns_the_rounded_block_size)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_POOL_STATISTICS statistics;
+    init_test_pools();
+
+    // act
+    statistics = get_statistics(0);
+
+    // assert
+    ASSERT_IS_TRUE(statistics.blockSize >= 10);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.blockSize % sizeof(void*));
+    ASSERT_ARE_EQUAL(size_t, 2, statistics.blockCount);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.blocksInUse);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.peakBlocksInUse);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.exhaustions);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_POOL_41_018: [ IoTHubClient_MemoryPool_Deinit shall log the blocks still in use, destroy the lock and make the allocations come from the heap again. ]*/
+TEST_FUNCTION(IoTHubClient_MemoryPool_Deinit_makes_the_allocations_come_from_the_heap)
+{
+    // arrange
+    void* ptr;
+    init_test_pools();
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_malloc(8));
+
+    // act
+    IoTHubClient_MemoryPool_Deinit();
+    ptr = iothub_client_memory_pool_malloc(8);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(is_in_pools(ptr));
+
+    // cleanup
+    iothub_client_memory_pool_free(ptr);
+}
+
+END_TEST_SUITE(iothub_client_memory_pool_ut)
@@ -0,0 +1,374 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_calloc(size_t nmemb, size_t size)
+{
+    return calloc(nmemb, size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_memory.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4241;
+
+/*more than the initial capacity of the table, so it grows*/
+#define TEST_MANY_ALLOCATIONS 3000
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static IOTHUB_CLIENT_MEMORY_USAGE get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM subsystem)
+{
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetMemoryUsage(subsystem, &usage);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_OK, (int)result);
+    return usage;
+}
+
+BEGIN_TEST_SUITE(iothub_client_memory_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, my_gballoc_calloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_001: [ iothub_client_memory_malloc, iothub_client_memory_calloc and iothub_client_memory_realloc shall count the allocations they return to subsystem. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_003: [ iothub_client_memory_free shall free ptr and remove it from its subsystem, a ptr that was not counted only being freed. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_006: [ IoTHubClient_GetMemoryUsage shall copy the bytes and allocations currently counted to subsystem, the peak of its bytes and the number of allocations counted to it so far into usage, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(iothub_client_memory_malloc_counts_to_its_subsystem_until_freed)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE mqtt_before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT);
+    IOTHUB_CLIENT_MEMORY_USAGE amqp_before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP);
+    IOTHUB_CLIENT_MEMORY_USAGE allocated;
+    IOTHUB_CLIENT_MEMORY_USAGE freed;
+    void* ptr;
+
+    // act
+    ptr = iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT, 100);
+    allocated = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT);
+    iothub_client_memory_free(ptr);
+    freed = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT);
+
+    // assert
+    ASSERT_IS_NOT_NULL(ptr);
+    ASSERT_ARE_EQUAL(size_t, mqtt_before.currentBytes + 100, allocated.currentBytes);
+    ASSERT_ARE_EQUAL(size_t, mqtt_before.currentAllocations + 1, allocated.currentAllocations);
+    ASSERT_ARE_EQUAL(size_t, mqtt_before.totalAllocations + 1, allocated.totalAllocations);
+    ASSERT_IS_TRUE(allocated.peakBytes >= allocated.currentBytes);
+    ASSERT_ARE_EQUAL(size_t, mqtt_before.currentBytes, freed.currentBytes);
+    ASSERT_ARE_EQUAL(size_t, mqtt_before.currentAllocations, freed.currentAllocations);
+    ASSERT_ARE_EQUAL(size_t, mqtt_before.totalAllocations + 1, freed.totalAllocations);
+    ASSERT_ARE_EQUAL(size_t, amqp_before.currentBytes, get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP).currentBytes);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_006: [ IoTHubClient_GetMemoryUsage shall copy the bytes and allocations currently counted to subsystem, the peak of its bytes and the number of allocations counted to it so far into usage, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_GetMemoryUsage_keeps_the_peak)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_HTTP);
+    void* first = iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_HTTP, 1000);
+    void* second = iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_HTTP, 500);
+    IOTHUB_CLIENT_MEMORY_USAGE after;
+    iothub_client_memory_free(first);
+    iothub_client_memory_free(second);
+
+    // act
+    after = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_HTTP);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, before.currentBytes, after.currentBytes);
+    ASSERT_IS_TRUE(after.peakBytes >= before.currentBytes + 1500);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_001: [ iothub_client_memory_malloc, iothub_client_memory_calloc and iothub_client_memory_realloc shall count the allocations they return to subsystem. ]*/
+TEST_FUNCTION(iothub_client_memory_calloc_counts_all_the_elements)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_BLOB);
+    IOTHUB_CLIENT_MEMORY_USAGE allocated;
+
+    // act
+    void* ptr = iothub_client_memory_calloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_BLOB, 10, 12);
+    allocated = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_BLOB);
+
+    // assert
+    ASSERT_IS_NOT_NULL(ptr);
+    ASSERT_ARE_EQUAL(size_t, before.currentBytes + 120, allocated.currentBytes);
+
+    // cleanup
+    iothub_client_memory_free(ptr);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_002: [ iothub_client_memory_realloc shall count a moved or resized allocation to the subsystem of ptr, or to subsystem if ptr was not counted, and leave it counted if realloc fails. ]*/
+TEST_FUNCTION(iothub_client_memory_realloc_keeps_the_subsystem_of_the_allocation)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE serializer_before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER);
+    IOTHUB_CLIENT_MEMORY_USAGE client_before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT);
+    IOTHUB_CLIENT_MEMORY_USAGE serializer_after;
+    void* ptr = iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER, 16);
+
+    // act
+    ptr = iothub_client_memory_realloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT, ptr, 4096);
+    serializer_after = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER);
+
+    // assert
+    ASSERT_IS_NOT_NULL(ptr);
+    ASSERT_ARE_EQUAL(size_t, serializer_before.currentBytes + 4096, serializer_after.currentBytes);
+    ASSERT_ARE_EQUAL(size_t, serializer_before.currentAllocations + 1, serializer_after.currentAllocations);
+    ASSERT_ARE_EQUAL(size_t, client_before.currentBytes, get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT).currentBytes);
+
+    // cleanup
+    iothub_client_memory_free(ptr);
+    ASSERT_ARE_EQUAL(size_t, serializer_before.currentBytes, get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER).currentBytes);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_002: [ iothub_client_memory_realloc shall count a moved or resized allocation to the subsystem of ptr, or to subsystem if ptr was not counted, and leave it counted if realloc fails. ]*/
+TEST_FUNCTION(iothub_client_memory_realloc_of_NULL_counts_to_subsystem)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP);
+
+    // act
+    void* ptr = iothub_client_memory_realloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP, NULL, 64);
+
+    // assert
+    ASSERT_IS_NOT_NULL(ptr);
+    ASSERT_ARE_EQUAL(size_t, before.currentBytes + 64, get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_AMQP).currentBytes);
+
+    // cleanup
+    iothub_client_memory_free(ptr);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_002: [ iothub_client_memory_realloc shall count a moved or resized allocation to the subsystem of ptr, or to subsystem if ptr was not counted, and leave it counted if realloc fails. ]*/
+TEST_FUNCTION(iothub_client_memory_realloc_fails_and_leaves_the_allocation_counted)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE allocated;
+    IOTHUB_CLIENT_MEMORY_USAGE after;
+    void* ptr = iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT, 32);
+    void* result;
+    allocated = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_realloc(ptr, 64))
+        .SetReturn(NULL);
+
+    // act
+    result = iothub_client_memory_realloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT, ptr, 64);
+    after = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, allocated.currentBytes, after.currentBytes);
+    ASSERT_ARE_EQUAL(size_t, allocated.currentAllocations, after.currentAllocations);
+
+    // cleanup
+    iothub_client_memory_free(ptr);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_001: [ iothub_client_memory_malloc, iothub_client_memory_calloc and iothub_client_memory_realloc shall count the allocations they return to subsystem. ]*/
+TEST_FUNCTION(iothub_client_memory_malloc_fails_and_counts_nothing)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT);
+    IOTHUB_CLIENT_MEMORY_USAGE after;
+    void* ptr;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(10))
+        .SetReturn(NULL);
+
+    // act
+    ptr = iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT, 10);
+    after = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT);
+
+    // assert
+    ASSERT_IS_NULL(ptr);
+    ASSERT_ARE_EQUAL(size_t, before.currentBytes, after.currentBytes);
+    ASSERT_ARE_EQUAL(size_t, before.totalAllocations, after.totalAllocations);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_003: [ iothub_client_memory_free shall free ptr and remove it from its subsystem, a ptr that was not counted only being freed. ]*/
+TEST_FUNCTION(iothub_client_memory_free_of_an_allocation_not_counted_only_frees_it)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT);
+    void* counted = iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT, 8);
+    void* not_counted = my_gballoc_malloc(8);
+
+    // act
+    iothub_client_memory_free(not_counted);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, before.currentBytes + 8, get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT).currentBytes);
+
+    // cleanup
+    iothub_client_memory_free(counted);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_001: [ iothub_client_memory_malloc, iothub_client_memory_calloc and iothub_client_memory_realloc shall count the allocations they return to subsystem. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_003: [ iothub_client_memory_free shall free ptr and remove it from its subsystem, a ptr that was not counted only being freed. ]*/
+TEST_FUNCTION(iothub_client_memory_counts_many_allocations_freed_in_any_order)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE before = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT);
+    IOTHUB_CLIENT_MEMORY_USAGE allocated;
+    IOTHUB_CLIENT_MEMORY_USAGE half_freed;
+    static void* ptrs[TEST_MANY_ALLOCATIONS];
+    size_t i;
+
+    // act
+    for (i = 0; i < TEST_MANY_ALLOCATIONS; i++)
+    {
+        ptrs[i] = iothub_client_memory_malloc(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT, 1 + (i % 7));
+        ASSERT_IS_NOT_NULL(ptrs[i]);
+    }
+    allocated = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT);
+    for (i = 1; i < TEST_MANY_ALLOCATIONS; i += 2)
+    {
+        iothub_client_memory_free(ptrs[i]);
+    }
+    half_freed = get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT);
+    for (i = 0; i < TEST_MANY_ALLOCATIONS; i += 2)
+    {
+        iothub_client_memory_free(ptrs[i]);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, before.currentAllocations + TEST_MANY_ALLOCATIONS, allocated.currentAllocations);
+    ASSERT_ARE_EQUAL(size_t, before.currentAllocations + TEST_MANY_ALLOCATIONS / 2, half_freed.currentAllocations);
+    ASSERT_ARE_EQUAL(size_t, before.currentAllocations, get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT).currentAllocations);
+    ASSERT_ARE_EQUAL(size_t, before.currentBytes, get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_CLIENT).currentBytes);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_004: [ If usage is NULL or subsystem is not an IOTHUB_CLIENT_MEMORY_SUBSYSTEM, IoTHubClient_GetMemoryUsage shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_GetMemoryUsage_NULL_usage_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetMemoryUsage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_INVALID_ARG, (int)result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_004: [ If usage is NULL or subsystem is not an IOTHUB_CLIENT_MEMORY_SUBSYSTEM, IoTHubClient_GetMemoryUsage shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_GetMemoryUsage_unknown_subsystem_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetMemoryUsage((IOTHUB_CLIENT_MEMORY_SUBSYSTEM)(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER + 1), &usage);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_INVALID_ARG, (int)result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_MEMORY_41_005: [ If locking the accounting fails, IoTHubClient_GetMemoryUsage shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_GetMemoryUsage_Lock_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    IOTHUB_CLIENT_RESULT result;
+    (void)get_usage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    result = IoTHubClient_GetMemoryUsage(IOTHUB_CLIENT_MEMORY_SUBSYSTEM_MQTT, &usage);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_memory_ut)
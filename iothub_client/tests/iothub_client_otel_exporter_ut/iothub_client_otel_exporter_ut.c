@@ -0,0 +1,788 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_calloc(size_t nmemb, size_t size)
+{
+    return calloc(nmemb, size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "iothub_client.h"
+#include "iothub_client_ll.h"
+#include "iothub_message.h"
+#include "iothub_client_trace.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_otel_exporter.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    extern int real_mallocAndStrcpy_s(char** destination, const char* source);
+#ifdef __cplusplus
+}
+#endif
+
+DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_RESULT_VALUES);
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#define TEST_TIME_VALUE                 ((time_t)1500000000)
+#define TEST_SERVICE_NAME               "test_service"
+#define TEST_OTLP_HOST                  "collector.contoso.com"
+#define TEST_MAX_SPANS                  2
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4241;
+static TICK_COUNTER_HANDLE TEST_TICK_COUNTER_HANDLE = (TICK_COUNTER_HANDLE)0x4242;
+static HTTPAPIEX_HANDLE TEST_HTTPAPIEX_HANDLE = (HTTPAPIEX_HANDLE)0x4243;
+static HTTP_HEADERS_HANDLE TEST_HTTP_HEADERS_HANDLE = (HTTP_HEADERS_HANDLE)0x4244;
+static BUFFER_HANDLE TEST_BUFFER_HANDLE = (BUFFER_HANDLE)0x4245;
+static IOTHUB_CLIENT_HANDLE TEST_CLIENT_HANDLE = (IOTHUB_CLIENT_HANDLE)0x4246;
+static IOTHUB_CLIENT_LL_HANDLE TEST_CLIENT_LL_HANDLE = (IOTHUB_CLIENT_LL_HANDLE)0x4247;
+static IOTHUB_MESSAGE_HANDLE TEST_MESSAGE_HANDLE = (IOTHUB_MESSAGE_HANDLE)0x4248;
+static IOTHUB_MESSAGE_HANDLE TEST_MESSAGE_HANDLE_2 = (IOTHUB_MESSAGE_HANDLE)0x4249;
+static IOTHUB_MESSAGE_HANDLE TEST_MESSAGE_HANDLE_3 = (IOTHUB_MESSAGE_HANDLE)0x424A;
+
+static tickcounter_ms_t g_current_ms;
+static unsigned int g_http_status_code;
+
+#define SINK_JSON_MAX_LENGTH 16384
+static size_t g_metrics_export_count;
+static size_t g_spans_export_count;
+static char g_last_metrics[SINK_JSON_MAX_LENGTH];
+static char g_last_spans[SINK_JSON_MAX_LENGTH];
+
+static void test_sink(void* context, IOTHUB_CLIENT_OTEL_EXPORT_KIND kind, const char* json, size_t length)
+{
+    char* destination = (kind == IOTHUB_CLIENT_OTEL_EXPORT_METRICS) ? g_last_metrics : g_last_spans;
+    (void)context;
+    ASSERT_IS_TRUE(length < SINK_JSON_MAX_LENGTH);
+    (void)memcpy(destination, json, length);
+    destination[length] = '\0';
+    if (kind == IOTHUB_CLIENT_OTEL_EXPORT_METRICS)
+    {
+        g_metrics_export_count++;
+    }
+    else
+    {
+        g_spans_export_count++;
+    }
+}
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_GetStatistics(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    (void)iotHubClientHandle;
+    (void)memset(statistics, 0, sizeof(IOTHUB_CLIENT_STATISTICS));
+    statistics->messagesEnqueued = 42;
+    statistics->bytesConfirmed = 4242;
+    statistics->reconnectCount = 3;
+    statistics->waitingToSendDepth = 7;
+    statistics->latencyHistogram[2] = 5;
+    return IOTHUB_CLIENT_OK;
+}
+
+static const char* my_IoTHubMessage_GetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return (iotHubMessageHandle == TEST_MESSAGE_HANDLE) ? "test_message_id" : NULL;
+}
+
+static HTTPAPIEX_RESULT my_HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    (void)handle;
+    (void)requestType;
+    (void)relativePath;
+    (void)requestHttpHeadersHandle;
+    (void)requestContent;
+    (void)responseHttpHeadersHandle;
+    (void)responseContent;
+    *statusCode = g_http_status_code;
+    return HTTPAPIEX_OK;
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static void init_sink_config(IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG* config, size_t maxSpans)
+{
+    (void)memset(config, 0, sizeof(IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG));
+    config->serviceName = TEST_SERVICE_NAME;
+    config->intervalMs = 1000;
+    config->maxSpans = maxSpans;
+    config->sink = test_sink;
+}
+
+static void set_expected_calls_for_create(const IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG* config)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, config->serviceName));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IOTHUB_CLIENT_OTEL_DEFAULT_EXPORT_SIZE));
+    if (config->maxSpans != 0)
+    {
+        STRICT_EXPECTED_CALL(gballoc_calloc(config->maxSpans, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    }
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    if (config->otlpHost != NULL)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(config->otlpHost));
+        STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "Content-Type", "application/json"));
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "User-Agent", IGNORED_PTR_ARG));
+    }
+    if (config->maxSpans != 0)
+    {
+        STRICT_EXPECTED_CALL(IoTHubClient_Trace_SetCallback(IoTHubClient_OTelExporter_OnTraceEvent, IGNORED_PTR_ARG));
+    }
+}
+
+static void trace_acknowledged_message(IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter, IOTHUB_MESSAGE_HANDLE message, uint64_t start_ns, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    IoTHubClient_OTelExporter_OnTraceEvent(exporter, IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, start_ns, message, 0);
+    IoTHubClient_OTelExporter_OnTraceEvent(exporter, IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, start_ns + 1000, message, 12);
+    IoTHubClient_OTelExporter_OnTraceEvent(exporter, IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, start_ns + 2000, message, result);
+}
+
+BEGIN_TEST_SUITE(iothub_client_otel_exporter_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPI_REQUEST_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_LL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_TRACE_CALLBACK, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, my_gballoc_calloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_calloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, real_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_RETURN(get_time, TEST_TIME_VALUE);
+
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_Create, TEST_HTTPAPIEX_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_ExecuteRequest, HTTPAPIEX_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_Alloc, TEST_HTTP_HEADERS_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_Alloc, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_create, TEST_BUFFER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_create, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_GetStatistics, my_IoTHubClient_GetStatistics);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_GetStatistics, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_LL_GetStatistics, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetMessageId, my_IoTHubMessage_GetMessageId);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_Trace_SetCallback, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Trace_SetCallback, __LINE__);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+
+    g_current_ms = 0;
+    g_http_status_code = 200;
+    g_metrics_export_count = 0;
+    g_spans_export_count = 0;
+    g_last_metrics[0] = '\0';
+    g_last_spans[0] = '\0';
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_001: [ If config or its serviceName is NULL, or config does not have exactly one of sink and otlpHost, IoTHubClient_OTelExporter_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Create_with_NULL_config_fails)
+{
+    // act
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE result = IoTHubClient_OTelExporter_Create(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_001: [ If config or its serviceName is NULL, or config does not have exactly one of sink and otlpHost, IoTHubClient_OTelExporter_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Create_without_serviceName_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    config.serviceName = NULL;
+
+    // act
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE result = IoTHubClient_OTelExporter_Create(&config);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_001: [ If config or its serviceName is NULL, or config does not have exactly one of sink and otlpHost, IoTHubClient_OTelExporter_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Create_with_a_sink_and_an_otlpHost_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    config.otlpHost = TEST_OTLP_HOST;
+
+    // act
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE result = IoTHubClient_OTelExporter_Create(&config);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_001: [ If config or its serviceName is NULL, or config does not have exactly one of sink and otlpHost, IoTHubClient_OTelExporter_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Create_without_a_sink_nor_an_otlpHost_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    config.sink = NULL;
+
+    // act
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE result = IoTHubClient_OTelExporter_Create(&config);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_002: [ IoTHubClient_OTelExporter_Create shall allocate the export buffer and the spans up front, and fail and return NULL if any allocation or resource creation fails. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Create_with_a_sink_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    set_expected_calls_for_create(&config);
+
+    // act
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE result = IoTHubClient_OTelExporter_Create(&config);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_002: [ IoTHubClient_OTelExporter_Create shall allocate the export buffer and the spans up front, and fail and return NULL if any allocation or resource creation fails. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_003: [ If maxSpans is not 0, IoTHubClient_OTelExporter_Create shall set IoTHubClient_OTelExporter_OnTraceEvent as the trace callback, with the exporter as context. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Create_with_an_otlpHost_and_spans_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, TEST_MAX_SPANS);
+    config.sink = NULL;
+    config.otlpHost = TEST_OTLP_HOST;
+    set_expected_calls_for_create(&config);
+
+    // act
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE result = IoTHubClient_OTelExporter_Create(&config);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_002: [ IoTHubClient_OTelExporter_Create shall allocate the export buffer and the spans up front, and fail and return NULL if any allocation or resource creation fails. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Create_negative_tests)
+{
+    // arrange
+    size_t i;
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, TEST_MAX_SPANS);
+    config.sink = NULL;
+    config.otlpHost = TEST_OTLP_HOST;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_expected_calls_for_create(&config);
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        /*get_time cannot fail*/
+        if (i == 1)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE result = IoTHubClient_OTelExporter_Create(&config);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, "IoTHubClient_OTelExporter_Create was expected to fail");
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_015: [ IoTHubClient_OTelExporter_Destroy shall remove the trace callback it set and free all the resources of the exporter, without exporting. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Destroy_removes_the_trace_callback)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, TEST_MAX_SPANS);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Trace_SetCallback(NULL, NULL));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_OTelExporter_Destroy(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_metrics_export_count);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_004: [ If exporter, client or transportName is NULL, IoTHubClient_OTelExporter_AddClient and IoTHubClient_OTelExporter_AddClientLL shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_AddClient_with_NULL_arguments_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = IoTHubClient_OTelExporter_AddClient(NULL, TEST_CLIENT_HANDLE, "MQTT", NULL);
+    int result2 = IoTHubClient_OTelExporter_AddClient(exporter, NULL, "MQTT", NULL);
+    int result3 = IoTHubClient_OTelExporter_AddClientLL(exporter, TEST_CLIENT_LL_HANDLE, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_005: [ The client shall be in the exports that follow, its sums starting at the time it was added. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_006: [ The metrics shall have a data point per client, from its statistics; a client whose statistics cannot be read shall be left out of the export. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_sends_the_statistics_of_the_clients_as_metrics)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_OTelExporter_AddClient(exporter, TEST_CLIENT_HANDLE, "MQTT", "test_device"));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(IoTHubClient_GetStatistics(TEST_CLIENT_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    int result = IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_metrics_export_count);
+    ASSERT_IS_NOT_NULL(strstr(g_last_metrics, "{\"key\":\"service.name\",\"value\":{\"stringValue\":\"test_service\"}}"));
+    ASSERT_IS_NOT_NULL(strstr(g_last_metrics, "{\"name\":\"iothub.client.messages.enqueued\",\"unit\":\"{message}\",\"sum\":{\"aggregationTemporality\":2,\"isMonotonic\":true,\"dataPoints\":[{\"attributes\":[{\"key\":\"iothub.transport\",\"value\":{\"stringValue\":\"MQTT\"}},{\"key\":\"iothub.device.id\",\"value\":{\"stringValue\":\"test_device\"}}],\"startTimeUnixNano\":\"1500000000000000000\",\"timeUnixNano\":\"1500000000000000000\",\"asInt\":\"42\"}]}}"));
+    ASSERT_IS_NOT_NULL(strstr(g_last_metrics, "\"name\":\"iothub.client.bytes.sent\""));
+    ASSERT_IS_NOT_NULL(strstr(g_last_metrics, "\"asInt\":\"4242\""));
+    ASSERT_IS_NOT_NULL(strstr(g_last_metrics, "{\"key\":\"iothub.queue\",\"value\":{\"stringValue\":\"waiting_to_send\"}}],\"timeUnixNano\":\"1500000000000000000\",\"asInt\":\"7\"}"));
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_006: [ The metrics shall have a data point per client, from its statistics; a client whose statistics cannot be read shall be left out of the export. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_leaves_out_a_client_without_statistics)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_OTelExporter_AddClientLL(exporter, TEST_CLIENT_LL_HANDLE, "AMQP", NULL));
+    umock_c_reset_all_calls();
+
+    // act
+    int result = IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_metrics_export_count);
+    ASSERT_IS_NULL(strstr(g_last_metrics, "AMQP"));
+    ASSERT_IS_NOT_NULL(strstr(g_last_metrics, "\"name\":\"iothub.client.messages.enqueued\",\"unit\":\"{message}\",\"sum\":{\"aggregationTemporality\":2,\"isMonotonic\":true,\"dataPoints\":[]}"));
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_007: [ iothub.client.send.latency shall have the buckets of the latency histogram of the statistics, with the explicit bounds 1, 2, 4 ... 2^14 ms. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_sends_the_latency_histogram)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_OTelExporter_AddClient(exporter, TEST_CLIENT_HANDLE, "MQTT", NULL));
+    umock_c_reset_all_calls();
+
+    // act
+    int result = IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(strstr(g_last_metrics, "\"count\":\"5\",\"bucketCounts\":[\"0\",\"0\",\"5\",\"0\",\"0\",\"0\",\"0\",\"0\",\"0\",\"0\",\"0\",\"0\",\"0\",\"0\",\"0\",\"0\"],\"explicitBounds\":[1,2,4,8,16,32,64,128,256,512,1024,2048,4096,8192,16384]}"));
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_008: [ On IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, IoTHubClient_OTelExporter_OnTraceEvent shall open a span for the message in a free slot, with a new trace id, a new span id and the id of the message. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_010: [ On IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, IoTHubClient_OTelExporter_OnTraceEvent shall add a publish event with the packet id to the open span of the message. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_011: [ On IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, IoTHubClient_OTelExporter_OnTraceEvent shall end the open span of the message, with the status OK if the confirmation result is IOTHUB_CLIENT_CONFIRMATION_OK and ERROR otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_sends_the_span_of_an_acknowledged_message)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, TEST_MAX_SPANS);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    trace_acknowledged_message(exporter, TEST_MESSAGE_HANDLE, 5000, IOTHUB_CLIENT_CONFIRMATION_OK);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_spans_export_count);
+    ASSERT_IS_NOT_NULL(strstr(g_last_spans, "\"name\":\"iothub.client.send\",\"kind\":4,\"startTimeUnixNano\":\"1500000000000000000\",\"endTimeUnixNano\":\"1500000000000002000\""));
+    ASSERT_IS_NOT_NULL(strstr(g_last_spans, "{\"key\":\"messaging.message.id\",\"value\":{\"stringValue\":\"test_message_id\"}}"));
+    ASSERT_IS_NOT_NULL(strstr(g_last_spans, "{\"key\":\"iothub.mqtt.packet_id\",\"value\":{\"intValue\":\"12\"}}"));
+    ASSERT_IS_NOT_NULL(strstr(g_last_spans, "\"events\":[{\"timeUnixNano\":\"1500000000000001000\",\"name\":\"publish\"}],\"status\":{\"code\":1}}"));
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_011: [ On IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, IoTHubClient_OTelExporter_OnTraceEvent shall end the open span of the message, with the status OK if the confirmation result is IOTHUB_CLIENT_CONFIRMATION_OK and ERROR otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_sends_an_error_span_for_a_failed_message)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, TEST_MAX_SPANS);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    trace_acknowledged_message(exporter, TEST_MESSAGE_HANDLE_2, 5000, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(strstr(g_last_spans, "messaging.message.id"));
+    ASSERT_IS_NOT_NULL(strstr(g_last_spans, "\"status\":{\"code\":2,\"message\":\"IOTHUB_CLIENT_CONFIRMATION_ERROR\"}}"));
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_011: [ On IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, IoTHubClient_OTelExporter_OnTraceEvent shall end the open span of the message, with the status OK if the confirmation result is IOTHUB_CLIENT_CONFIRMATION_OK and ERROR otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_does_not_send_the_open_spans)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, TEST_MAX_SPANS);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    IoTHubClient_OTelExporter_OnTraceEvent(exporter, IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, 5000, TEST_MESSAGE_HANDLE, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_metrics_export_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_spans_export_count);
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_009: [ When all the maxSpans slots are taken, the span of the message shall be dropped and counted in iothub.client.spans.dropped. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_OnTraceEvent_drops_the_spans_above_maxSpans)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 1);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubClient_OTelExporter_OnTraceEvent(exporter, IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, 5000, TEST_MESSAGE_HANDLE, 0);
+    IoTHubClient_OTelExporter_OnTraceEvent(exporter, IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, 6000, TEST_MESSAGE_HANDLE_2, 0);
+    IoTHubClient_OTelExporter_OnTraceEvent(exporter, IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, 7000, TEST_MESSAGE_HANDLE_2, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_OTelExporter_Export(exporter));
+    ASSERT_ARE_EQUAL(size_t, 0, g_spans_export_count);
+    ASSERT_IS_NOT_NULL(strstr(g_last_metrics, "\"name\":\"iothub.client.spans.dropped\",\"unit\":\"{span}\",\"sum\":{\"aggregationTemporality\":2,\"isMonotonic\":true,\"dataPoints\":[{\"startTimeUnixNano\":\"1500000000000000000\",\"timeUnixNano\":\"1500000000000000000\",\"asInt\":\"1\"}]}}"));
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_012: [ A span still open IOTHUB_CLIENT_OTEL_SPAN_MAX_AGE_MS after it was opened, by the time of the last trace event, shall be dropped and counted in iothub.client.spans.dropped. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_drops_the_spans_never_acknowledged)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 1);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    IoTHubClient_OTelExporter_OnTraceEvent(exporter, IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, 5000, TEST_MESSAGE_HANDLE, 0);
+    IoTHubClient_OTelExporter_OnTraceEvent(exporter, IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, 5000 + (uint64_t)IOTHUB_CLIENT_OTEL_SPAN_MAX_AGE_MS * 1000000 + 1, TEST_MESSAGE_HANDLE_2, IOTHUB_CLIENT_CONFIRMATION_OK);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_OTelExporter_Export(exporter));
+
+    // act
+    trace_acknowledged_message(exporter, TEST_MESSAGE_HANDLE_3, 5000 + (uint64_t)IOTHUB_CLIENT_OTEL_SPAN_MAX_AGE_MS * 1000000 + 2, IOTHUB_CLIENT_CONFIRMATION_OK);
+    int result = IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_spans_export_count);
+    ASSERT_IS_NOT_NULL(strstr(g_last_metrics, "\"name\":\"iothub.client.spans.dropped\",\"unit\":\"{span}\",\"sum\":{\"aggregationTemporality\":2,\"isMonotonic\":true,\"dataPoints\":[{\"startTimeUnixNano\":\"1500000000000000000\",\"timeUnixNano\":\"1500000000000000000\",\"asInt\":\"1\"}]}}"));
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_014: [ The ended spans shall be exported in as many exports of at most maxExportSize bytes as needed; a span that does not fit in an export by itself shall be dropped. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_splits_the_spans_in_exports_of_maxExportSize)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, TEST_MAX_SPANS);
+    config.maxExportSize = 1000;
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    trace_acknowledged_message(exporter, TEST_MESSAGE_HANDLE, 5000, IOTHUB_CLIENT_CONFIRMATION_OK);
+    trace_acknowledged_message(exporter, TEST_MESSAGE_HANDLE_2, 6000, IOTHUB_CLIENT_CONFIRMATION_OK);
+    umock_c_reset_all_calls();
+
+    // act
+    (void)IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_spans_export_count);
+    ASSERT_IS_TRUE(strlen(g_last_spans) <= 1000);
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_013: [ Every export shall be handed to the sink if there is one, or else posted with the Content-Type application/json to /v1/metrics or /v1/traces of otlpHost, a status code other than 2xx failing it. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_posts_to_the_collector)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    config.sink = NULL;
+    config.otlpHost = TEST_OTLP_HOST;
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(TEST_HTTPAPIEX_HANDLE, HTTPAPI_REQUEST_POST, "/v1/metrics", TEST_HTTP_HEADERS_HANDLE, TEST_BUFFER_HANDLE, IGNORED_PTR_ARG, NULL, NULL));
+    STRICT_EXPECTED_CALL(BUFFER_delete(TEST_BUFFER_HANDLE));
+
+    // act
+    int result = IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_013: [ Every export shall be handed to the sink if there is one, or else posted with the Content-Type application/json to /v1/metrics or /v1/traces of otlpHost, a status code other than 2xx failing it. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_Export_fails_when_the_collector_rejects_the_export)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    config.sink = NULL;
+    config.otlpHost = TEST_OTLP_HOST;
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    umock_c_reset_all_calls();
+    g_http_status_code = 500;
+
+    // act
+    int result = IoTHubClient_OTelExporter_Export(exporter);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OTEL_EXPORTER_41_016: [ IoTHubClient_OTelExporter_DoWork shall export once intervalMs have passed since the exporter was created or last exported, whether that export succeeded or not. ]*/
+TEST_FUNCTION(IoTHubClient_OTelExporter_DoWork_exports_every_interval)
+{
+    // arrange
+    IOTHUB_CLIENT_OTEL_EXPORTER_CONFIG config;
+    init_sink_config(&config, 0);
+    IOTHUB_CLIENT_OTEL_EXPORTER_HANDLE exporter = IoTHubClient_OTelExporter_Create(&config);
+    umock_c_reset_all_calls();
+
+    // act
+    g_current_ms = 999;
+    IoTHubClient_OTelExporter_DoWork(exporter);
+    ASSERT_ARE_EQUAL(size_t, 0, g_metrics_export_count);
+    g_current_ms = 1000;
+    IoTHubClient_OTelExporter_DoWork(exporter);
+    ASSERT_ARE_EQUAL(size_t, 1, g_metrics_export_count);
+    g_current_ms = 1999;
+    IoTHubClient_OTelExporter_DoWork(exporter);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_metrics_export_count);
+
+    // cleanup
+    IoTHubClient_OTelExporter_Destroy(exporter);
+}
+
+END_TEST_SUITE(iothub_client_otel_exporter_ut)
@@ -0,0 +1,772 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_outbox.h"
+
+#define TEST_FILE_NAME "iothub_client_outbox_ut.bin"
+#define TEST_FILE_SIZE 256
+#define TEST_MAX_PROPERTIES 4
+
+/*a message is kept in plain memory so that what the outbox writes can be compared with what it reads back*/
+typedef struct TEST_MESSAGE_TAG
+{
+    IOTHUBMESSAGE_CONTENT_TYPE contentType;
+    unsigned char* content;
+    size_t size;
+    char* messageId;
+    char* correlationId;
+    const char* keys[TEST_MAX_PROPERTIES];
+    const char* values[TEST_MAX_PROPERTIES];
+    size_t propertyCount;
+} TEST_MESSAGE;
+
+static char* copy_string(const char* source)
+{
+    char* result = (char*)malloc(strlen(source) + 1);
+    (void)strcpy(result, source);
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)calloc(1, sizeof(TEST_MESSAGE));
+    message->contentType = IOTHUBMESSAGE_BYTEARRAY;
+    message->content = (unsigned char*)malloc(size + 1);
+    (void)memcpy(message->content, byteArray, size);
+    message->size = size;
+    return (IOTHUB_MESSAGE_HANDLE)message;
+}
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromString(const char* source)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)my_IoTHubMessage_CreateFromByteArray((const unsigned char*)source, strlen(source) + 1);
+    message->contentType = IOTHUBMESSAGE_STRING;
+    return (IOTHUB_MESSAGE_HANDLE)message;
+}
+
+static void my_IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)iotHubMessageHandle;
+    size_t i;
+    for (i = 0; i < message->propertyCount; i++)
+    {
+        free((void*)message->keys[i]);
+        free((void*)message->values[i]);
+    }
+    free(message->content);
+    free(message->messageId);
+    free(message->correlationId);
+    free(message);
+}
+
+static IOTHUBMESSAGE_CONTENT_TYPE my_IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->contentType;
+}
+
+static const char* my_IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return (const char*)((TEST_MESSAGE*)iotHubMessageHandle)->content;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const unsigned char** buffer, size_t* size)
+{
+    *buffer = ((TEST_MESSAGE*)iotHubMessageHandle)->content;
+    *size = ((TEST_MESSAGE*)iotHubMessageHandle)->size;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* my_IoTHubMessage_GetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->messageId;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* messageId)
+{
+    ((TEST_MESSAGE*)iotHubMessageHandle)->messageId = copy_string(messageId);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* my_IoTHubMessage_GetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->correlationId;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* correlationId)
+{
+    ((TEST_MESSAGE*)iotHubMessageHandle)->correlationId = copy_string(correlationId);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static MAP_HANDLE my_IoTHubMessage_Properties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return (MAP_HANDLE)iotHubMessageHandle;
+}
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    *keys = message->keys;
+    *values = message->values;
+    *count = message->propertyCount;
+    return MAP_OK;
+}
+
+static MAP_RESULT my_Map_AddOrUpdate(MAP_HANDLE handle, const char* key, const char* value)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    message->keys[message->propertyCount] = copy_string(key);
+    message->values[message->propertyCount] = copy_string(value);
+    message->propertyCount++;
+    return MAP_OK;
+}
+
+static IOTHUB_MESSAGE_HANDLE create_test_message(const char* text)
+{
+    return my_IoTHubMessage_CreateFromString(text);
+}
+
+static void append_test_message(OUTBOX_HANDLE outbox, const char* text)
+{
+    IOTHUB_MESSAGE_HANDLE message = create_test_message(text);
+    ASSERT_ARE_EQUAL(int, 0, outbox_append(outbox, message));
+    my_IoTHubMessage_Destroy(message);
+}
+
+static void read_test_message(OUTBOX_HANDLE outbox, const char* expectedText)
+{
+    IOTHUB_MESSAGE_HANDLE message = outbox_read_next(outbox);
+    ASSERT_IS_NOT_NULL(message);
+    ASSERT_ARE_EQUAL(char_ptr, expectedText, my_IoTHubMessage_GetString(message));
+    my_IoTHubMessage_Destroy(message);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_outbox_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromByteArray, my_IoTHubMessage_CreateFromByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromString, my_IoTHubMessage_CreateFromString);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Destroy, my_IoTHubMessage_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentType, my_IoTHubMessage_GetContentType);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetString, my_IoTHubMessage_GetString);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, my_IoTHubMessage_GetByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetMessageId, my_IoTHubMessage_GetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetMessageId, my_IoTHubMessage_SetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetCorrelationId, my_IoTHubMessage_GetCorrelationId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetCorrelationId, my_IoTHubMessage_SetCorrelationId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Properties, my_IoTHubMessage_Properties);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_AddOrUpdate, my_Map_AddOrUpdate);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    (void)remove(TEST_FILE_NAME);
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    (void)remove(TEST_FILE_NAME);
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_001: [ If file_name is NULL or max_file_size cannot hold a header and a record, or is larger than the file offsets allow, outbox_create shall fail and return NULL. ]*/
+TEST_FUNCTION(outbox_create_NULL_file_name_fails)
+{
+    // arrange
+
+    // act
+    OUTBOX_HANDLE result = outbox_create(NULL, TEST_FILE_SIZE, 1);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_001: [ If file_name is NULL or max_file_size cannot hold a header and a record, or is larger than the file offsets allow, outbox_create shall fail and return NULL. ]*/
+TEST_FUNCTION(outbox_create_max_file_size_too_small_fails)
+{
+    // arrange
+
+    // act
+    OUTBOX_HANDLE result = outbox_create(TEST_FILE_NAME, 32, 1);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_002: [ If any error occurs, outbox_create shall fail and return NULL. ]*/
+TEST_FUNCTION(outbox_create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    OUTBOX_HANDLE result = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_006: [ Otherwise outbox_create shall create an empty outbox file of at most max_file_size bytes. ]*/
+TEST_FUNCTION(outbox_create_creates_an_empty_outbox)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    OUTBOX_HANDLE result = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, outbox_get_count(result));
+    ASSERT_ARE_EQUAL(size_t, 0, outbox_get_unread_count(result));
+    ASSERT_IS_NULL(outbox_read_next(result));
+
+    // cleanup
+    outbox_destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_004: [ If file_name is an outbox file, outbox_create shall keep its records, unread, and its size. ]*/
+TEST_FUNCTION(outbox_create_keeps_the_records_of_an_existing_file)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    append_test_message(outbox, "first");
+    append_test_message(outbox, "second");
+    read_test_message(outbox, "first");
+    outbox_destroy(outbox);
+
+    // act
+    outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE * 2, 1);
+
+    // assert
+    ASSERT_IS_NOT_NULL(outbox);
+    ASSERT_ARE_EQUAL(size_t, 2, outbox_get_count(outbox));
+    ASSERT_ARE_EQUAL(size_t, 2, outbox_get_unread_count(outbox));
+    read_test_message(outbox, "first");
+    read_test_message(outbox, "second");
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_005: [ If file_name exists and is not a consistent outbox file, outbox_create shall replace it with an empty outbox file. ]*/
+TEST_FUNCTION(outbox_create_resets_a_file_that_is_not_an_outbox)
+{
+    // arrange
+    FILE* file = fopen(TEST_FILE_NAME, "wb");
+    ASSERT_IS_NOT_NULL(file);
+    (void)fputs("this is not an outbox file, it is long enough to hold a header", file);
+    (void)fclose(file);
+
+    // act
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+
+    // assert
+    ASSERT_IS_NOT_NULL(outbox);
+    ASSERT_ARE_EQUAL(size_t, 0, outbox_get_count(outbox));
+    append_test_message(outbox, "first");
+    read_test_message(outbox, "first");
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_007: [ If outbox is NULL, outbox_destroy shall return. ]*/
+TEST_FUNCTION(outbox_destroy_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    outbox_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_008: [ outbox_destroy shall sync the changes not synced yet, close the file and free the outbox. ]*/
+TEST_FUNCTION(outbox_destroy_syncs_the_changes_not_synced)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 100);
+    append_test_message(outbox, "first");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(outbox));
+
+    // act
+    outbox_destroy(outbox);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    ASSERT_ARE_EQUAL(size_t, 1, outbox_get_count(outbox));
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_009: [ If outbox or message are NULL, outbox_append shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(outbox_append_NULL_outbox_fails)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE message = create_test_message("first");
+
+    // act
+    int result = outbox_append(NULL, message);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_009: [ If outbox or message are NULL, outbox_append shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(outbox_append_NULL_message_fails)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = outbox_append(outbox, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, outbox_get_count(outbox));
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_010: [ If the content, the message id, the correlation id or the properties of message cannot be serialized, outbox_append shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(outbox_append_Map_GetInternals_fails)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    IOTHUB_MESSAGE_HANDLE message = create_test_message("first");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(message));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(message));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(message));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(message));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message));
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(MAP_ERROR);
+
+    // act
+    int result = outbox_append(outbox, message);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, outbox_get_count(outbox));
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_012: [ If the record does not fit in the file, outbox_append shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(outbox_append_fails_when_the_file_is_full)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    IOTHUB_MESSAGE_HANDLE message = create_test_message("a message of about fifty bytes, a few fit in a file");
+    size_t count = 0;
+    while (outbox_append(outbox, message) == 0)
+    {
+        count++;
+    }
+
+    // act
+    int result = outbox_append(outbox, message);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_NOT_EQUAL(size_t, 0, count);
+    ASSERT_ARE_EQUAL(size_t, count, outbox_get_count(outbox));
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_013: [ outbox_append shall write the serialized message in one record after the newest record, and return 0. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_018: [ outbox_read_next shall create a message from the oldest record not read yet, with its content, message id, correlation id and properties, mark the record as read and return the message. ]*/
+TEST_FUNCTION(outbox_read_next_returns_the_message_appended)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    const unsigned char content[] = { 0x00, 0x01, 0xFF };
+    IOTHUB_MESSAGE_HANDLE message = my_IoTHubMessage_CreateFromByteArray(content, sizeof(content));
+    (void)my_IoTHubMessage_SetMessageId(message, "message id");
+    (void)my_IoTHubMessage_SetCorrelationId(message, "correlation id");
+    (void)my_Map_AddOrUpdate((MAP_HANDLE)message, "key", "value");
+    ASSERT_ARE_EQUAL(int, 0, outbox_append(outbox, message));
+    umock_c_reset_all_calls();
+
+    // act
+    TEST_MESSAGE* result = (TEST_MESSAGE*)outbox_read_next(outbox);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUBMESSAGE_BYTEARRAY, (int)result->contentType);
+    ASSERT_ARE_EQUAL(size_t, sizeof(content), result->size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(content, result->content, sizeof(content)));
+    ASSERT_ARE_EQUAL(char_ptr, "message id", result->messageId);
+    ASSERT_ARE_EQUAL(char_ptr, "correlation id", result->correlationId);
+    ASSERT_ARE_EQUAL(size_t, 1, result->propertyCount);
+    ASSERT_ARE_EQUAL(char_ptr, "key", result->keys[0]);
+    ASSERT_ARE_EQUAL(char_ptr, "value", result->values[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, outbox_get_count(outbox));
+    ASSERT_ARE_EQUAL(size_t, 0, outbox_get_unread_count(outbox));
+
+    // cleanup
+    my_IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)result);
+    my_IoTHubMessage_Destroy(message);
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_015: [ If outbox is NULL, outbox_read_next shall return NULL. ]*/
+TEST_FUNCTION(outbox_read_next_NULL_outbox_returns_NULL)
+{
+    // arrange
+
+    // act
+    IOTHUB_MESSAGE_HANDLE result = outbox_read_next(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_016: [ If all the records have been read, outbox_read_next shall return NULL. ]*/
+TEST_FUNCTION(outbox_read_next_after_the_last_record_returns_NULL)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    append_test_message(outbox, "first");
+    read_test_message(outbox, "first");
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_MESSAGE_HANDLE result = outbox_read_next(outbox);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_019: [ If the record cannot be turned into a message, outbox_read_next shall still mark it as read, so that it does not block the records after it, and return NULL. ]*/
+TEST_FUNCTION(outbox_read_next_skips_a_record_that_cannot_be_turned_into_a_message)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    append_test_message(outbox, "first");
+    append_test_message(outbox, "second");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromString("first"))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_MESSAGE_HANDLE result = outbox_read_next(outbox);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, outbox_get_unread_count(outbox));
+    read_test_message(outbox, "second");
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_020: [ If outbox is NULL, outbox_release_oldest shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(outbox_release_oldest_NULL_outbox_fails)
+{
+    // arrange
+
+    // act
+    int result = outbox_release_oldest(NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_021: [ If the oldest record was not read, outbox_release_oldest shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(outbox_release_oldest_record_not_read_fails)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    append_test_message(outbox, "first");
+    umock_c_reset_all_calls();
+
+    // act
+    int result = outbox_release_oldest(outbox);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, outbox_get_count(outbox));
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_022: [ outbox_release_oldest shall remove the oldest record and return 0. ]*/
+TEST_FUNCTION(outbox_release_oldest_removes_the_oldest_record)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    append_test_message(outbox, "first");
+    append_test_message(outbox, "second");
+    read_test_message(outbox, "first");
+    umock_c_reset_all_calls();
+
+    // act
+    int result = outbox_release_oldest(outbox);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, outbox_get_count(outbox));
+    outbox_rewind(outbox);
+    read_test_message(outbox, "second");
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_011: [ outbox_append shall not overwrite the records released since the last sync, and sync first if that is the only way for the record to fit. ]*/
+TEST_FUNCTION(outbox_append_reuses_the_room_of_the_released_records)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 100);
+    char text[32];
+    int appended = 0;
+    int released = 0;
+
+    // act
+    while (appended < 50)
+    {
+        IOTHUB_MESSAGE_HANDLE message;
+        (void)sprintf(text, "message %d", appended);
+        message = create_test_message(text);
+        if (outbox_append(outbox, message) == 0)
+        {
+            appended++;
+        }
+        else
+        {
+            (void)sprintf(text, "message %d", released);
+            read_test_message(outbox, text);
+            ASSERT_ARE_EQUAL(int, 0, outbox_release_oldest(outbox));
+            released++;
+        }
+        my_IoTHubMessage_Destroy(message);
+    }
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, released);
+    ASSERT_ARE_EQUAL(size_t, (size_t)(appended - released), outbox_get_count(outbox));
+    outbox_destroy(outbox);
+    outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    ASSERT_ARE_EQUAL(size_t, (size_t)(appended - released), outbox_get_count(outbox));
+    while (released < appended)
+    {
+        (void)sprintf(text, "message %d", released);
+        read_test_message(outbox, text);
+        released++;
+    }
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_023: [ If outbox is NULL, outbox_rewind shall return. ]*/
+TEST_FUNCTION(outbox_rewind_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    outbox_rewind(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_024: [ outbox_rewind shall mark all the records as not read. ]*/
+TEST_FUNCTION(outbox_rewind_reads_the_records_again)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 1);
+    append_test_message(outbox, "first");
+    append_test_message(outbox, "second");
+    read_test_message(outbox, "first");
+    read_test_message(outbox, "second");
+
+    // act
+    outbox_rewind(outbox);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, outbox_get_unread_count(outbox));
+    read_test_message(outbox, "first");
+    read_test_message(outbox, "second");
+
+    // cleanup
+    outbox_destroy(outbox);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_025: [ outbox_get_count shall return the number of records, 0 if outbox is NULL. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_026: [ outbox_get_unread_count shall return the number of records not read, 0 if outbox is NULL. ]*/
+TEST_FUNCTION(outbox_get_count_NULL_returns_0)
+{
+    // arrange
+
+    // act
+    size_t count = outbox_get_count(NULL);
+    size_t unreadCount = outbox_get_unread_count(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, count);
+    ASSERT_ARE_EQUAL(size_t, 0, unreadCount);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_027: [ If outbox is NULL, outbox_sync shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(outbox_sync_NULL_fails)
+{
+    // arrange
+
+    // act
+    int result = outbox_sync(NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_OUTBOX_41_028: [ outbox_sync shall flush the records to the disk, then write the position of the records and flush it to the disk, and return 0. ]*/
+TEST_FUNCTION(outbox_sync_writes_the_records_appended)
+{
+    // arrange
+    OUTBOX_HANDLE outbox = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 100);
+    OUTBOX_HANDLE copy;
+    append_test_message(outbox, "first");
+
+    // act
+    int result = outbox_sync(outbox);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    copy = outbox_create(TEST_FILE_NAME, TEST_FILE_SIZE, 100);
+    ASSERT_ARE_EQUAL(size_t, 1, outbox_get_count(copy));
+
+    // cleanup
+    outbox_destroy(copy);
+    outbox_destroy(outbox);
+}
+
+END_TEST_SUITE(iothub_client_outbox_ut)
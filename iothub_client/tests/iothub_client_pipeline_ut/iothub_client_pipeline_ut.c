@@ -0,0 +1,594 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umock_c_negative_tests.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_pipeline.h"
+
+#define ENABLE_MOCKS
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_MESSAGE_STAGE_RESULT, test_stage_callback, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback);
+#undef ENABLE_MOCKS
+
+#define TEST_MESSAGE_HANDLE             (IOTHUB_MESSAGE_HANDLE)0x41
+#define TEST_MAP_HANDLE                 (MAP_HANDLE)0x43
+#define TEST_PROPERTY_NAME              "temperature"
+#define TEST_WINDOW_KEY_COUNT           4
+
+/*the payload and the property of the message, the properties the window stage sets are recorded*/
+static const char* g_payload;
+static const char* g_propertyValue;
+static char g_windowValues[TEST_WINDOW_KEY_COUNT][32];
+static const char* const TEST_WINDOW_KEYS[TEST_WINDOW_KEY_COUNT] = { TEST_PROPERTY_NAME "-count", TEST_PROPERTY_NAME "-min", TEST_PROPERTY_NAME "-max", TEST_PROPERTY_NAME "-avg" };
+
+static const char* my_IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    (void)iotHubMessageHandle;
+    return g_payload;
+}
+
+static const char* my_Map_GetValueFromKey(MAP_HANDLE handle, const char* key)
+{
+    (void)handle;
+    return (strcmp(key, TEST_PROPERTY_NAME) == 0) ? g_propertyValue : NULL;
+}
+
+static MAP_RESULT my_Map_AddOrUpdate(MAP_HANDLE handle, const char* key, const char* value)
+{
+    size_t i;
+    (void)handle;
+    for (i = 0; i < TEST_WINDOW_KEY_COUNT; i++)
+    {
+        if (strcmp(key, TEST_WINDOW_KEYS[i]) == 0)
+        {
+            (void)strncpy(g_windowValues[i], value, sizeof(g_windowValues[i]) - 1);
+        }
+    }
+    return MAP_OK;
+}
+
+static IOTHUB_CLIENT_MESSAGE_STAGE make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_TYPE type)
+{
+    IOTHUB_CLIENT_MESSAGE_STAGE stage;
+    (void)memset(&stage, 0, sizeof(stage));
+    stage.type = type;
+    stage.propertyName = TEST_PROPERTY_NAME;
+    return stage;
+}
+
+static MESSAGE_PIPELINE_HANDLE create_pipeline(const IOTHUB_CLIENT_MESSAGE_STAGE* stages, size_t stageCount)
+{
+    IOTHUB_CLIENT_MESSAGE_PIPELINE config;
+    MESSAGE_PIPELINE_HANDLE result;
+    config.stages = stages;
+    config.stageCount = stageCount;
+    result = message_pipeline_create(&config);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static IOTHUB_CLIENT_MESSAGE_STAGE_RESULT process_text(MESSAGE_PIPELINE_HANDLE pipeline, const char* payload)
+{
+    g_payload = payload;
+    return message_pipeline_process(pipeline, TEST_MESSAGE_HANDLE, 0);
+}
+
+static IOTHUB_CLIENT_MESSAGE_STAGE_RESULT process_number(MESSAGE_PIPELINE_HANDLE pipeline, const char* value, tickcounter_ms_t nowMs)
+{
+    g_propertyValue = value;
+    return message_pipeline_process(pipeline, TEST_MESSAGE_HANDLE, nowMs);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_pipeline_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_MESSAGE_STAGE_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetContentType, IOTHUBMESSAGE_STRING);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetString, my_IoTHubMessage_GetString);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Properties, TEST_MAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_GetValueFromKey, my_Map_GetValueFromKey);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_AddOrUpdate, my_Map_AddOrUpdate);
+    REGISTER_GLOBAL_MOCK_RETURN(test_stage_callback, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    g_payload = "payload";
+    g_propertyValue = NULL;
+    (void)memset(g_windowValues, 0, sizeof(g_windowValues));
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_001: [ If config is NULL, its stages are NULL or it has no stages, message_pipeline_create shall fail and return NULL. ]*/
+TEST_FUNCTION(message_pipeline_create_with_NULL_config_fails)
+{
+    //arrange
+
+    //act
+    MESSAGE_PIPELINE_HANDLE result = message_pipeline_create(NULL);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_001: [ If config is NULL, its stages are NULL or it has no stages, message_pipeline_create shall fail and return NULL. ]*/
+TEST_FUNCTION(message_pipeline_create_without_stages_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE);
+    IOTHUB_CLIENT_MESSAGE_PIPELINE config = { &stage, 0 };
+
+    //act
+    MESSAGE_PIPELINE_HANDLE result = message_pipeline_create(&config);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_002: [ If a custom stage has no callback, a deadband or window stage has no propertyName, a deadband is negative, a window is 0 ms or a type is unknown, message_pipeline_create shall fail and return NULL. ]*/
+TEST_FUNCTION(message_pipeline_create_with_a_custom_stage_without_callback_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_CUSTOM);
+    IOTHUB_CLIENT_MESSAGE_PIPELINE config = { &stage, 1 };
+
+    //act
+    MESSAGE_PIPELINE_HANDLE result = message_pipeline_create(&config);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_002: [ If a custom stage has no callback, a deadband or window stage has no propertyName, a deadband is negative, a window is 0 ms or a type is unknown, message_pipeline_create shall fail and return NULL. ]*/
+TEST_FUNCTION(message_pipeline_create_with_a_deadband_stage_without_propertyName_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND);
+    IOTHUB_CLIENT_MESSAGE_PIPELINE config = { &stage, 1 };
+    stage.propertyName = NULL;
+
+    //act
+    MESSAGE_PIPELINE_HANDLE result = message_pipeline_create(&config);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_002: [ If a custom stage has no callback, a deadband or window stage has no propertyName, a deadband is negative, a window is 0 ms or a type is unknown, message_pipeline_create shall fail and return NULL. ]*/
+TEST_FUNCTION(message_pipeline_create_with_a_window_of_0_ms_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW);
+    IOTHUB_CLIENT_MESSAGE_PIPELINE config = { &stage, 1 };
+
+    //act
+    MESSAGE_PIPELINE_HANDLE result = message_pipeline_create(&config);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_003: [ message_pipeline_create shall copy the stages of config and their propertyName and return a non-NULL handle. ]*/
+TEST_FUNCTION(message_pipeline_create_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stages[2];
+    IOTHUB_CLIENT_MESSAGE_PIPELINE config = { stages, 2 };
+    stages[0] = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE);
+    stages[1] = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW);
+    stages[1].windowInMs = 1000;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    MESSAGE_PIPELINE_HANDLE result = message_pipeline_create(&config);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    message_pipeline_destroy(result);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_004: [ If any error occurs, message_pipeline_create shall fail and return NULL. ]*/
+TEST_FUNCTION(message_pipeline_create_fails_when_malloc_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stages[2];
+    IOTHUB_CLIENT_MESSAGE_PIPELINE config = { stages, 2 };
+    size_t i;
+    stages[0] = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE);
+    stages[1] = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND);
+    stages[1].deadband = 0.5;
+
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        MESSAGE_PIPELINE_HANDLE result;
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        //act
+        result = message_pipeline_create(&config);
+
+        //assert
+        ASSERT_IS_NULL(result);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_005: [ If pipeline is NULL, message_pipeline_destroy shall do nothing. ]*/
+TEST_FUNCTION(message_pipeline_destroy_with_NULL_does_nothing)
+{
+    //arrange
+
+    //act
+    message_pipeline_destroy(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_006: [ message_pipeline_destroy shall free the stages and the pipeline. ]*/
+TEST_FUNCTION(message_pipeline_destroy_frees_the_stages_and_the_pipeline)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND);
+    MESSAGE_PIPELINE_HANDLE pipeline = create_pipeline(&stage, 1);
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    message_pipeline_destroy(pipeline);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_007: [ If pipeline or message is NULL, message_pipeline_process shall return IOTHUB_CLIENT_MESSAGE_STAGE_KEEP. ]*/
+TEST_FUNCTION(message_pipeline_process_with_NULL_pipeline_keeps_the_message)
+{
+    //arrange
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT result = message_pipeline_process(NULL, TEST_MESSAGE_HANDLE, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_008: [ message_pipeline_process shall give message to the stages in order and return IOTHUB_CLIENT_MESSAGE_STAGE_DROP as soon as one of them drops it, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP if they all keep it. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_009: [ A custom stage shall call its callback with message and its context and keep or drop the message as the callback returns. ]*/
+TEST_FUNCTION(message_pipeline_process_gives_the_message_to_the_stages_in_order)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stages[2];
+    MESSAGE_PIPELINE_HANDLE pipeline;
+    stages[0] = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_CUSTOM);
+    stages[0].callback = test_stage_callback;
+    stages[0].context = (void*)1;
+    stages[1] = stages[0];
+    stages[1].context = (void*)2;
+    pipeline = create_pipeline(stages, 2);
+
+    STRICT_EXPECTED_CALL(test_stage_callback(TEST_MESSAGE_HANDLE, (void*)1));
+    STRICT_EXPECTED_CALL(test_stage_callback(TEST_MESSAGE_HANDLE, (void*)2));
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT result = message_pipeline_process(pipeline, TEST_MESSAGE_HANDLE, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    message_pipeline_destroy(pipeline);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_008: [ message_pipeline_process shall give message to the stages in order and return IOTHUB_CLIENT_MESSAGE_STAGE_DROP as soon as one of them drops it, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP if they all keep it. ]*/
+TEST_FUNCTION(message_pipeline_process_stops_at_the_stage_dropping_the_message)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stages[2];
+    MESSAGE_PIPELINE_HANDLE pipeline;
+    stages[0] = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_CUSTOM);
+    stages[0].callback = test_stage_callback;
+    stages[0].context = (void*)1;
+    stages[1] = stages[0];
+    stages[1].context = (void*)2;
+    pipeline = create_pipeline(stages, 2);
+
+    STRICT_EXPECTED_CALL(test_stage_callback(TEST_MESSAGE_HANDLE, (void*)1))
+        .SetReturn(IOTHUB_CLIENT_MESSAGE_STAGE_DROP);
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT result = message_pipeline_process(pipeline, TEST_MESSAGE_HANDLE, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_DROP, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    message_pipeline_destroy(pipeline);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_010: [ A dedupe stage shall drop a message whose payload has the size and CRC64 of the payload of the last message it kept, unless maxSuppressedCount is not 0 and that many were dropped in a row already. ]*/
+TEST_FUNCTION(message_pipeline_process_dedupe_drops_the_same_payload)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE);
+    MESSAGE_PIPELINE_HANDLE pipeline = create_pipeline(&stage, 1);
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT first = process_text(pipeline, "{\"a\":1}");
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT second = process_text(pipeline, "{\"a\":1}");
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT third = process_text(pipeline, "{\"a\":2}");
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT fourth = process_text(pipeline, "{\"a\":1}");
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, first);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_DROP, second);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, third);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, fourth);
+
+    //cleanup
+    message_pipeline_destroy(pipeline);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_010: [ A dedupe stage shall drop a message whose payload has the size and CRC64 of the payload of the last message it kept, unless maxSuppressedCount is not 0 and that many were dropped in a row already. ]*/
+TEST_FUNCTION(message_pipeline_process_dedupe_keeps_a_duplicate_after_maxSuppressedCount)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE);
+    MESSAGE_PIPELINE_HANDLE pipeline;
+    stage.maxSuppressedCount = 2;
+    pipeline = create_pipeline(&stage, 1);
+    (void)process_text(pipeline, "same");
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT first = process_text(pipeline, "same");
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT second = process_text(pipeline, "same");
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT third = process_text(pipeline, "same");
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_DROP, first);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_DROP, second);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, third);
+
+    //cleanup
+    message_pipeline_destroy(pipeline);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_011: [ A dedupe stage shall compute the CRC64 of the segments of a byte array message in place. ]*/
+TEST_FUNCTION(message_pipeline_process_dedupe_reads_the_segments_in_place)
+{
+    //arrange
+    static const unsigned char segment[] = { 1, 2, 3 };
+    const unsigned char* buffer = segment;
+    size_t size = sizeof(segment);
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE);
+    MESSAGE_PIPELINE_HANDLE pipeline = create_pipeline(&stage, 1);
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_BYTEARRAY);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetSegmentCount(TEST_MESSAGE_HANDLE))
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetSegment(TEST_MESSAGE_HANDLE, 0, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_buffer(&buffer, sizeof(buffer))
+        .CopyOutArgumentBuffer_size(&size, sizeof(size))
+        .SetReturn(IOTHUB_MESSAGE_OK);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetSegment(TEST_MESSAGE_HANDLE, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_buffer(&buffer, sizeof(buffer))
+        .CopyOutArgumentBuffer_size(&size, sizeof(size))
+        .SetReturn(IOTHUB_MESSAGE_OK);
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT result = message_pipeline_process(pipeline, TEST_MESSAGE_HANDLE, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    message_pipeline_destroy(pipeline);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_012: [ A deadband stage shall drop a message whose application property propertyName is a number less than deadband away from the number of the last message it kept, and keep the messages without a number in it. ]*/
+TEST_FUNCTION(message_pipeline_process_deadband_drops_the_small_changes)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND);
+    MESSAGE_PIPELINE_HANDLE pipeline;
+    stage.deadband = 0.5;
+    pipeline = create_pipeline(&stage, 1);
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT first = process_number(pipeline, "20.0", 0);
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT second = process_number(pipeline, "20.4", 0);
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT third = process_number(pipeline, "19.6", 0);
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT fourth = process_number(pipeline, "19.5", 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, first);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_DROP, second);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_DROP, third);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, fourth);
+
+    //cleanup
+    message_pipeline_destroy(pipeline);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_012: [ A deadband stage shall drop a message whose application property propertyName is a number less than deadband away from the number of the last message it kept, and keep the messages without a number in it. ]*/
+TEST_FUNCTION(message_pipeline_process_deadband_keeps_the_messages_without_a_number)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_DEADBAND);
+    MESSAGE_PIPELINE_HANDLE pipeline;
+    stage.deadband = 0.5;
+    pipeline = create_pipeline(&stage, 1);
+    (void)process_number(pipeline, "20", 0);
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT first = process_number(pipeline, NULL, 0);
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT second = process_number(pipeline, "20 degrees", 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, first);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, second);
+
+    //cleanup
+    message_pipeline_destroy(pipeline);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_013: [ A window stage shall keep the first message with a number in the application property propertyName and then the first one windowInMs or more after the last one it kept, dropping those in between, and keep the messages without a number in it. ]*/
+TEST_FUNCTION(message_pipeline_process_window_keeps_one_message_per_window)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW);
+    MESSAGE_PIPELINE_HANDLE pipeline;
+    stage.windowInMs = 1000;
+    pipeline = create_pipeline(&stage, 1);
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT first = process_number(pipeline, "1", 100);
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT second = process_number(pipeline, "2", 600);
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT third = process_number(pipeline, NULL, 700);
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT fourth = process_number(pipeline, "3", 1100);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, first);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_DROP, second);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, third);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, fourth);
+
+    //cleanup
+    message_pipeline_destroy(pipeline);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_PIPELINE_41_014: [ A window stage shall set the application properties propertyName-count, -min, -max and -avg of the message it keeps to the count, minimum, maximum and average of the numbers of the messages since the last one it kept, itself included. ]*/
+TEST_FUNCTION(message_pipeline_process_window_sets_the_aggregates_of_the_window)
+{
+    //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage = make_stage(IOTHUB_CLIENT_MESSAGE_STAGE_WINDOW);
+    MESSAGE_PIPELINE_HANDLE pipeline;
+    stage.windowInMs = 1000;
+    pipeline = create_pipeline(&stage, 1);
+    (void)process_number(pipeline, "10", 0);
+    (void)process_number(pipeline, "4", 200);
+    (void)process_number(pipeline, "8", 400);
+
+    //act
+    IOTHUB_CLIENT_MESSAGE_STAGE_RESULT result = process_number(pipeline, "6", 1000);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP, result);
+    ASSERT_ARE_EQUAL(char_ptr, "3", g_windowValues[0]);
+    ASSERT_ARE_EQUAL(char_ptr, "4", g_windowValues[1]);
+    ASSERT_ARE_EQUAL(char_ptr, "8", g_windowValues[2]);
+    ASSERT_ARE_EQUAL(char_ptr, "6", g_windowValues[3]);
+
+    //cleanup
+    message_pipeline_destroy(pipeline);
+}
+
+END_TEST_SUITE(iothub_client_pipeline_ut)
@@ -39,6 +39,8 @@ void real_free(void* ptr)
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/agenttime.h"
 #include "azure_c_shared_utility/optionhandler.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "iothub_client_ll.h"
 #undef ENABLE_MOCKS
 
@@ -61,9 +63,12 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 
 #define INDEFINITE_TIME                     ((time_t)-1)
 #define TEST_OPTIONHANDLER_HANDLE           (OPTIONHANDLER_HANDLE)0x7771
+#define TEST_LOCK_HANDLE                    (LOCK_HANDLE)0x7772
+#define TEST_TICK_COUNTER_HANDLE            (TICK_COUNTER_HANDLE)0x7773
 
 
 static time_t TEST_current_time;
+static tickcounter_ms_t TEST_current_time_ms;
 
 
 // Helpers
@@ -121,28 +126,21 @@ static time_t add_seconds(time_t base_time, int seconds)
 	return new_time;
 }
 
-static void run_and_verify_should_retry(RETRY_CONTROL_HANDLE handle, time_t first_retry_time, time_t last_retry_time, time_t current_time, double secs_since_first_retry, double secs_since_last_retry, RETRY_ACTION expected_retry_action, bool is_first_check)
+static void set_expected_current_ms(tickcounter_ms_t* current_ms)
+{
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer_current_ms(current_ms, sizeof(tickcounter_ms_t));
+}
+
+static void run_and_verify_should_retry(RETRY_CONTROL_HANDLE handle, tickcounter_ms_t current_time, RETRY_ACTION expected_retry_action)
 {
 	// arrange
 	umock_c_reset_all_calls();
-	if (is_first_check)
-	{
-		STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
-	}
-	else
-	{
-		STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
-		STRICT_EXPECTED_CALL(get_difftime(current_time, first_retry_time)).SetReturn(secs_since_first_retry);
-
-		if (expected_retry_action != RETRY_ACTION_STOP_RETRYING)
-		{
-			STRICT_EXPECTED_CALL(get_difftime(current_time, last_retry_time)).SetReturn(secs_since_last_retry);
-		}
-	}
+	set_expected_current_ms(&current_time);
 
 	if (expected_retry_action == RETRY_ACTION_RETRY_NOW)
 	{
-		STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+		set_expected_current_ms(&current_time);
 	}
 
 	// act
@@ -156,54 +154,59 @@ static void run_and_verify_should_retry(RETRY_CONTROL_HANDLE handle, time_t firs
 }
 
 // @brief
-//     The first element of 'expected_retry_times' shall be 0
-static void run_and_verify_should_retry_times(RETRY_CONTROL_HANDLE handle, int* expected_retry_times, int number_of_elements, unsigned int max_retry_time_in_secs)
+//     The first element of 'expected_retry_times' shall be 0; the elements are the expected waits in milliseconds
+static void run_and_verify_should_retry_times_in_ms(RETRY_CONTROL_HANDLE handle, unsigned int* expected_retry_times, int number_of_elements, unsigned int max_retry_time_in_secs)
 {
-	time_t current_time = TEST_current_time;
-	time_t first_time = INDEFINITE_TIME;
-	time_t last_time = INDEFINITE_TIME;
-	unsigned int secs_since_first_try = 0;
-	unsigned int secs_since_last_try = 0;
-	RETRY_ACTION expected_retry_action = RETRY_ACTION_RETRY_NOW;
-
-	run_and_verify_should_retry(handle, first_time, last_time, current_time, secs_since_first_try, secs_since_last_try, expected_retry_action, true);
+	tickcounter_ms_t current_time = TEST_current_time_ms;
+	tickcounter_ms_t max_retry_time_in_ms = (tickcounter_ms_t)max_retry_time_in_secs * 1000;
+	tickcounter_ms_t ms_since_first_try = 0;
+	RETRY_ACTION expected_retry_action;
 
-	first_time = current_time;
-	last_time = current_time;
+	run_and_verify_should_retry(handle, current_time, RETRY_ACTION_RETRY_NOW);
 
 	int i;
 	for (i = 1; i < number_of_elements; i++)
 	{
 		// RETRY_LATER time test
-		int half_secs_since_last_try = (expected_retry_times[i] - expected_retry_times[i - 1]) / 2;
+		tickcounter_ms_t half_ms_since_last_try = (expected_retry_times[i] - expected_retry_times[i - 1]) / 2;
 
-		if (half_secs_since_last_try > 0 && half_secs_since_last_try != expected_retry_times[i])
+		if (half_ms_since_last_try > 0 && half_ms_since_last_try != expected_retry_times[i])
 		{
-			unsigned int half_secs_since_first_try = secs_since_first_try + half_secs_since_last_try;
-			time_t half_current_time = add_seconds(current_time, half_secs_since_last_try);
-			expected_retry_action = (half_secs_since_first_try < max_retry_time_in_secs ? RETRY_ACTION_RETRY_LATER : RETRY_ACTION_STOP_RETRYING);
+			expected_retry_action = (ms_since_first_try + half_ms_since_last_try < max_retry_time_in_ms ? RETRY_ACTION_RETRY_LATER : RETRY_ACTION_STOP_RETRYING);
 
-			run_and_verify_should_retry(handle, first_time, last_time, half_current_time, half_secs_since_first_try, half_secs_since_last_try, expected_retry_action, false);
+			run_and_verify_should_retry(handle, current_time + half_ms_since_last_try, expected_retry_action);
 		}
 
 		// RETRY_NOW/STOP_RETRYING time test
-		secs_since_last_try = expected_retry_times[i];
-		secs_since_first_try += expected_retry_times[i];
-		current_time = add_seconds(current_time, secs_since_last_try);
-		expected_retry_action = (secs_since_first_try < max_retry_time_in_secs ? RETRY_ACTION_RETRY_NOW : RETRY_ACTION_STOP_RETRYING);
+		ms_since_first_try += expected_retry_times[i];
+		current_time += expected_retry_times[i];
+		expected_retry_action = (ms_since_first_try < max_retry_time_in_ms ? RETRY_ACTION_RETRY_NOW : RETRY_ACTION_STOP_RETRYING);
 
-		run_and_verify_should_retry(handle, first_time, last_time, current_time, secs_since_first_try, secs_since_last_try, expected_retry_action, false);
+		run_and_verify_should_retry(handle, current_time, expected_retry_action);
+	}
+}
 
-		if (expected_retry_action == RETRY_ACTION_RETRY_NOW)
-		{
-			last_time = current_time;
-		}
+// @brief
+//     The first element of 'expected_retry_times' shall be 0; the elements are the expected waits in seconds
+static void run_and_verify_should_retry_times(RETRY_CONTROL_HANDLE handle, int* expected_retry_times, int number_of_elements, unsigned int max_retry_time_in_secs)
+{
+	unsigned int expected_retry_times_in_ms[10];
+	int i;
+
+	ASSERT_IS_TRUE(number_of_elements <= 10);
+
+	for (i = 0; i < number_of_elements; i++)
+	{
+		expected_retry_times_in_ms[i] = (unsigned int)expected_retry_times[i] * 1000;
 	}
+
+	run_and_verify_should_retry_times_in_ms(handle, expected_retry_times_in_ms, number_of_elements, max_retry_time_in_secs);
 }
 
 static void initialize_variables()
 {
 	TEST_current_time = time(NULL);
+	TEST_current_time_ms = 1234567;
 
 	TEST_OptionHandler_AddOption_saved_value = 0;
 	TEST_OptionHandler_AddOption_result = OPTIONHANDLER_OK;
@@ -217,6 +220,9 @@ static void register_umock_alias_types()
 	REGISTER_UMOCK_ALIAS_TYPE(pfCloneOption, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(pfDestroyOption, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(pfSetOption, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
 }
 
 static void register_global_mock_hooks()
@@ -236,6 +242,16 @@ static void register_global_mock_returns()
 
 	REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_OK);
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_ERROR);
+
+	REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+	REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+	REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+	REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+	REGISTER_GLOBAL_MOCK_RETURN(tickcounter_get_current_ms, 0);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, 1);
 }
 
 
@@ -243,11 +259,41 @@ static RETRY_CONTROL_HANDLE create_retry_control(IOTHUB_CLIENT_RETRY_POLICY poli
 {
 	umock_c_reset_all_calls();
 	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(tickcounter_create());
 	RETRY_CONTROL_HANDLE handle = retry_control_create(policy_name, max_retry_time_in_secs);
 
 	return handle;
 }
 
+static RETRY_COORDINATOR_HANDLE create_retry_coordinator(unsigned int retry_budget, unsigned int retries_per_sec, unsigned int failure_threshold, unsigned int open_time_in_secs)
+{
+	umock_c_reset_all_calls();
+	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(Lock_Init());
+	RETRY_COORDINATOR_HANDLE handle = retry_coordinator_create(retry_budget, retries_per_sec, failure_threshold, open_time_in_secs);
+
+	return handle;
+}
+
+static RETRY_CONTROL_HANDLE create_coordinated_retry_control(RETRY_COORDINATOR_HANDLE retry_coordinator)
+{
+	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_IMMEDIATE, 0);
+	(void)retry_control_set_option(handle, RETRY_CONTROL_OPTION_RETRY_COORDINATOR, retry_coordinator);
+
+	return handle;
+}
+
+static void verify_coordinated_should_retry(RETRY_CONTROL_HANDLE handle, RETRY_ACTION expected_retry_action)
+{
+	RETRY_ACTION retry_action;
+	int result = retry_control_should_retry(handle, &retry_action);
+
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(int, expected_retry_action, retry_action);
+	umock_c_reset_all_calls();
+}
+
 
 BEGIN_TEST_SUITE(iothub_client_retry_control_ut)
 
@@ -321,8 +367,28 @@ TEST_FUNCTION(create_malloc_fails)
 	umock_c_reset_all_calls();
 }
 
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_021: [If tickcounter_create fails, `retry_control_create` shall fail and return NULL]
+TEST_FUNCTION(create_tickcounter_create_fails)
+{
+	// arrange
+	umock_c_reset_all_calls();
+	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(NULL);
+	EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+	// act
+	RETRY_CONTROL_HANDLE handle = retry_control_create(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 10);
+
+	// assert
+	ASSERT_IS_NULL(handle);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+}
+
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_002: [`retry_control_create` shall allocate memory for the retry control instance structure (a.k.a. `retry_control`)]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_009: [If no errors occur, `retry_control_create` shall return a handle to `retry_control`]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_020: [`retry_control->tick_counter` shall be created using tickcounter_create()]
 TEST_FUNCTION(create_success)
 {
 	// arrange
@@ -355,15 +421,18 @@ TEST_FUNCTION(destroy_NULL_handle)
 	// cleanup
 }
 
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_023: [`retry_control_destroy` shall destroy `retry_control_handle->tick_counter` using tickcounter_destroy()]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_056: [`retry_control_destroy` shall destroy `retry_control_handle` using free()]
 TEST_FUNCTION(destroy_success)
 {
 	// arrange
 	umock_c_reset_all_calls();
 	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(tickcounter_create());
 	RETRY_CONTROL_HANDLE handle = retry_control_create(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 10);
 
 	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
 	EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
 	// act
@@ -487,7 +556,8 @@ TEST_FUNCTION(Retrieve_Options_NULL_handle)
 
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_007: [`retry_control->max_jitter_percent` shall be set to 5]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_046: [An instance of OPTIONHANDLER_HANDLE (a.k.a. `options`) shall be created using OptionHandler_Create]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_050: [`retry_control->initial_wait_time_in_secs` shall be added to `options` using OptionHandler_Add]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_050: [`retry_control->initial_wait_time_in_ms` shall be added to `options` using OptionHandler_Add]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_027: [`retry_control->max_wait_time_in_ms` shall be added to `options` using OptionHandler_Add]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_051: [`retry_control->max_jitter_percent` shall be added to `options` using OptionHandler_Add]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_054: [If no errors occur, `retry_control_retrieve_options` shall return the OPTIONHANDLER_HANDLE instance]
 TEST_FUNCTION(Retrieve_Options_success)
@@ -495,11 +565,14 @@ TEST_FUNCTION(Retrieve_Options_success)
 	// arrange
 	umock_c_reset_all_calls();
 	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(tickcounter_create());
 	RETRY_CONTROL_HANDLE handle = retry_control_create(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 10);
 
 	umock_c_reset_all_calls();
 	EXPECTED_CALL(OptionHandler_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-	STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, IGNORED_PTR_ARG))
+		.IgnoreArgument_value();
+	STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS, IGNORED_PTR_ARG))
 		.IgnoreArgument_value();
 	STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, IGNORED_PTR_ARG))
 		.IgnoreArgument_value();
@@ -526,11 +599,14 @@ TEST_FUNCTION(Retrieve_Options_failure_checks)
 
 	umock_c_reset_all_calls();
 	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(tickcounter_create());
 	RETRY_CONTROL_HANDLE handle = retry_control_create(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 10);
 
 	umock_c_reset_all_calls();
 	EXPECTED_CALL(OptionHandler_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-	STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, IGNORED_PTR_ARG))
+		.IgnoreArgument_value();
+	STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS, IGNORED_PTR_ARG))
 		.IgnoreArgument_value();
 	STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, IGNORED_PTR_ARG))
 		.IgnoreArgument_value();
@@ -613,7 +689,7 @@ TEST_FUNCTION(Set_Options_NULL_value)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_037: [If `name` is "initial_wait_time_in_secs" and `value` is less than 1, `retry_control_set_option` shall fail and return non-zero]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_037: [If `name` is "initial_wait_time_in_secs" and `value` is less than 1 or greater than UINT_MAX / 1000, `retry_control_set_option` shall fail and return non-zero]
 TEST_FUNCTION(Set_Options_INVALID_initial_wait_time_in_secs)
 {
 	// arrange
@@ -624,10 +700,35 @@ TEST_FUNCTION(Set_Options_INVALID_initial_wait_time_in_secs)
 	// act
 	unsigned int value = 0;
 	int result = retry_control_set_option(handle, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, &value);
+	unsigned int too_large_value = UINT_MAX / 1000 + 1;
+	int too_large_result = retry_control_set_option(handle, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, &too_large_value);
 
 	// assert
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_NOT_EQUAL(int, 0, too_large_result);
+
+	// cleanup
+	retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_024: [If `name` is "initial_wait_time_in_ms" or "max_wait_time_in_ms" and `value` is less than 1, `retry_control_set_option` shall fail and return non-zero]
+TEST_FUNCTION(Set_Options_INVALID_wait_time_in_ms)
+{
+	// arrange
+	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, 10);
+
+	umock_c_reset_all_calls();
+
+	// act
+	unsigned int value = 0;
+	int result1 = retry_control_set_option(handle, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, &value);
+	int result2 = retry_control_set_option(handle, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS, &value);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+	ASSERT_ARE_NOT_EQUAL(int, 0, result2);
 
 	// cleanup
 	retry_control_destroy(handle);
@@ -767,7 +868,7 @@ TEST_FUNCTION(Should_Retry_NULL_retry_action)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_012: [If get_time() fails, `retry_control_should_retry` shall fail and return non-zero]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_012: [If tickcounter_get_current_ms() fails, `retry_control_should_retry` shall fail and return non-zero]
 TEST_FUNCTION(Should_Retry_failure)
 {
 	// arrange
@@ -775,7 +876,7 @@ TEST_FUNCTION(Should_Retry_failure)
 	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, max_retry_time_in_secs);
 
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(INDEFINITE_TIME);
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).SetReturn(1);
 
 	// act
 	RETRY_ACTION retry_action;
@@ -789,7 +890,7 @@ TEST_FUNCTION(Should_Retry_failure)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_022: [If get_time() fails, the evaluation function shall return non-zero]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_022: [If tickcounter_get_current_ms() fails, the evaluation function shall return non-zero]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_014: [If evaluate_retry_action() fails, `retry_control_should_retry` shall fail and return non-zero]
 TEST_FUNCTION(Should_Retry_evaluate_retry_action_failure)
 {
@@ -799,13 +900,13 @@ TEST_FUNCTION(Should_Retry_evaluate_retry_action_failure)
 
 	// This first call succeeds because retry_count is 0
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
+	set_expected_current_ms(&TEST_current_time_ms);
+	set_expected_current_ms(&TEST_current_time_ms);
 	RETRY_ACTION retry_action;
 	(void)retry_control_should_retry(handle, &retry_action);
 
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(INDEFINITE_TIME);
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).SetReturn(1);
 
 	// act
 	int result = retry_control_should_retry(handle, &retry_action);
@@ -828,8 +929,8 @@ TEST_FUNCTION(Should_Retry_INDEFINITE_last_retry_time)
 
 	// This first call succeeds because retry_count is 0
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(INDEFINITE_TIME);
+	set_expected_current_ms(&TEST_current_time_ms);
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).SetReturn(1);
 	RETRY_ACTION retry_action;
 	(void)retry_control_should_retry(handle, &retry_action);
 
@@ -853,18 +954,17 @@ TEST_FUNCTION(Should_Retry_NO_MAX_RETRY_TIME_success)
 	unsigned int max_retry_time_in_secs = 0;
 	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_IMMEDIATE, max_retry_time_in_secs);
 
-	time_t first_try_time = TEST_current_time;
-	time_t next_try_time = add_seconds(first_try_time, 100);
+	tickcounter_ms_t first_try_time = TEST_current_time_ms;
+	tickcounter_ms_t next_try_time = first_try_time + 100000;
 
 	// This first call succeeds because retry_count is 0
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(first_try_time);
+	set_expected_current_ms(&first_try_time);
 	RETRY_ACTION retry_action;
 	(void)retry_control_should_retry(handle, &retry_action);
 
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(next_try_time);
-	// no get_difftime gets invoked.
+	set_expected_current_ms(&next_try_time);
 
 	// act
 	int result = retry_control_should_retry(handle, &retry_action);
@@ -879,21 +979,21 @@ TEST_FUNCTION(Should_Retry_NO_MAX_RETRY_TIME_success)
 }
 
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_004: [The parameters passed to `retry_control_create` shall be saved into `retry_control`]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_005: [If `policy_name` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF or IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `retry_control->initial_wait_time_in_secs` shall be set to 1]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_005: [If `policy_name` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER or IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, `retry_control->initial_wait_time_in_ms` shall be set to 1000]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_008: [The remaining fields in `retry_control` shall be initialized according to retry_control_reset()]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_011: [If `retry_control->first_retry_time` is INDEFINITE_TIME, it shall be set using get_time()]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_011: [If `retry_control->first_retry_time` is INDEFINITE_TIME, it shall be set using tickcounter_get_current_ms()]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_013: [evaluate_retry_action() shall be invoked]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_015: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW, `retry_control->retry_count` shall be incremented by 1]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_016: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->last_retry_time` shall be set using get_time()]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_017: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->current_wait_time_in_secs` shall be set using calculate_next_wait_time()]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_016: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->last_retry_time` shall be set using tickcounter_get_current_ms()]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_017: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->current_wait_time_in_ms` shall be set using calculate_next_wait_time()]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_018: [If no errors occur, `retry_control_should_retry` shall return 0]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_019: [If `retry_control->retry_count` is 0, `retry_action` shall be set to RETRY_ACTION_RETRY_NOW]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_021: [`current_time` shall be set using get_time()]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_021: [`current_time` shall be set using tickcounter_get_current_ms()]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_023: [If `retry_control->max_retry_time_in_secs` is not 0 and (`current_time` - `retry_control->first_retry_time`) is greater than or equal to `retry_control->max_retry_time_in_secs`, `retry_action` shall be set to RETRY_ACTION_STOP_RETRYING]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_024: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is less than `retry_control->current_wait_time_in_secs`, `retry_action` shall be set to RETRY_ACTION_RETRY_LATER]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_025: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is greater or equal to `retry_control->current_wait_time_in_secs`, `retry_action` shall be set to RETRY_ACTION_RETRY_NOW]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_024: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is less than `retry_control->current_wait_time_in_ms`, `retry_action` shall be set to RETRY_ACTION_RETRY_LATER]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_025: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is greater or equal to `retry_control->current_wait_time_in_ms`, `retry_action` shall be set to RETRY_ACTION_RETRY_NOW]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_026: [If no errors occur, the evaluation function shall return 0]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `calculate_next_wait_time` shall return ((pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`) * (1 + (`retry_control->max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `calculate_next_wait_time` shall return ((pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_ms`) * (1 + (`retry_control->max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_040: [If `name` is "max_jitter_percent", value shall be saved on `retry_control->max_jitter_percent`]
 TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_WITH_JITTER_success)
 {
@@ -914,8 +1014,8 @@ TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_WITH_JITTER_success)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `calculate_next_wait_time` shall return (pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`)]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_038: [If `name` is "initial_wait_time_in_secs", `value` shall be saved on `retry_control->initial_wait_time_in_secs`]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `calculate_next_wait_time` shall return (pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_ms`)]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_038: [If `name` is "initial_wait_time_in_secs", `value` shall be saved in milliseconds on `retry_control->initial_wait_time_in_ms`]
 TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_success)
 {
 	// arrange
@@ -936,7 +1036,7 @@ TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_success)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_029: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_INTERVAL, `calculate_next_wait_time` shall return `retry_control->initial_wait_time_in_secs`]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_029: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_INTERVAL, `calculate_next_wait_time` shall return `retry_control->initial_wait_time_in_ms`]
 TEST_FUNCTION(Should_Retry_INTERVAL_success)
 {
 	// arrange
@@ -953,8 +1053,8 @@ TEST_FUNCTION(Should_Retry_INTERVAL_success)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_006: [Otherwise `retry_control->initial_wait_time_in_secs` shall be set to 5]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (`retry_control->retry_count`))]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_006: [Otherwise `retry_control->initial_wait_time_in_ms` shall be set to 5]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_ms` * (`retry_control->retry_count`))]
 TEST_FUNCTION(Should_Retry_LINEAR_BACKOFF_success)
 {
 	// arrange
@@ -971,7 +1071,77 @@ TEST_FUNCTION(Should_Retry_LINEAR_BACKOFF_success)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_033: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_RANDOM, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (rand() / RAND_MAX))]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_025: [If `name` is "initial_wait_time_in_ms", `value` shall be saved on `retry_control->initial_wait_time_in_ms`]
+TEST_FUNCTION(Should_Retry_INTERVAL_initial_wait_time_in_ms_success)
+{
+	// arrange
+	unsigned int max_retry_time_in_secs = 1;
+	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_INTERVAL, max_retry_time_in_secs);
+
+	unsigned int option_value = 250;
+	int set_option_result = retry_control_set_option(handle, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, &option_value);
+
+	unsigned int expected_retry_times[] = { 0, 250, 250, 250, 250 };
+
+	// act
+	// assert
+	run_and_verify_should_retry_times_in_ms(handle, expected_retry_times, 5, max_retry_time_in_secs);
+	ASSERT_ARE_EQUAL(int, 0, set_option_result);
+
+	// cleanup
+	retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_019: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, `calculate_next_wait_time` shall return a random wait between `retry_control->initial_wait_time_in_ms` and 3 times the previous wait, bounded by `retry_control->max_wait_time_in_ms`]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_026: [If `name` is "max_wait_time_in_ms", `value` shall be saved on `retry_control->max_wait_time_in_ms`]
+TEST_FUNCTION(Should_Retry_DECORRELATED_JITTER_success)
+{
+	// arrange
+	unsigned int max_retry_time_in_secs = 10;
+	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, max_retry_time_in_secs);
+
+	// the lower bound of the wait is the initial wait, so bounding it at the same value makes it deterministic
+	unsigned int option_value = 300;
+	int set_option_result1 = retry_control_set_option(handle, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, &option_value);
+	int set_option_result2 = retry_control_set_option(handle, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_MS, &option_value);
+
+	unsigned int expected_retry_times[] = { 0, 300, 300, 300, 300 };
+
+	// act
+	// assert
+	run_and_verify_should_retry_times_in_ms(handle, expected_retry_times, 5, max_retry_time_in_secs);
+	ASSERT_ARE_EQUAL(int, 0, set_option_result1);
+	ASSERT_ARE_EQUAL(int, 0, set_option_result2);
+
+	// cleanup
+	retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_019: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, `calculate_next_wait_time` shall return a random wait between `retry_control->initial_wait_time_in_ms` and 3 times the previous wait, bounded by `retry_control->max_wait_time_in_ms`]
+TEST_FUNCTION(Should_Retry_DECORRELATED_JITTER_waits_at_least_initial_wait_time)
+{
+	// arrange
+	unsigned int max_retry_time_in_secs = 0;
+	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, max_retry_time_in_secs);
+	tickcounter_ms_t first_try_time = TEST_current_time_ms;
+	tickcounter_ms_t early_try_time = first_try_time + 999;
+	tickcounter_ms_t late_try_time = first_try_time + 60000;
+
+	// act
+	// assert
+	run_and_verify_should_retry(handle, first_try_time, RETRY_ACTION_RETRY_NOW);
+
+	// the default initial wait of DECORRELATED_JITTER is 1 second
+	run_and_verify_should_retry(handle, early_try_time, RETRY_ACTION_RETRY_LATER);
+
+	// and the wait never goes beyond the default max wait of 60 seconds
+	run_and_verify_should_retry(handle, late_try_time, RETRY_ACTION_RETRY_NOW);
+
+	// cleanup
+	retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_033: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_RANDOM, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_ms` * (rand() / RAND_MAX))]
 // This test must be replaced. Create an auxiliary module for get_rand() in c-shared-utilities and test using that
 /*
 TEST_FUNCTION(Should_Retry_RANDOM_success)
@@ -1047,23 +1217,21 @@ TEST_FUNCTION(Should_Retry_RETRY_IMMEDIATE_success)
 	unsigned int max_retry_time_in_secs = 10;
 	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_IMMEDIATE, max_retry_time_in_secs);
 
-	time_t first_time = TEST_current_time;
-	time_t current_time = TEST_current_time;
+	tickcounter_ms_t current_times[11];
 
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+	current_times[0] = TEST_current_time_ms;
+	set_expected_current_ms(&current_times[0]);
 
 	unsigned int i;
 	for (i = 0; i <= max_retry_time_in_secs; i++)
 	{
 		// arrange
-		current_time = add_seconds(current_time, 1);
-
 		if (i > 0)
 		{
 			// i.e., if it's not the first call to _should_retry.
-			STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
-			STRICT_EXPECTED_CALL(get_difftime(current_time, first_time)).SetReturn(i);
+			current_times[i] = TEST_current_time_ms + i * 1000;
+			set_expected_current_ms(&current_times[i]);
 		}
 
 		// act
@@ -1114,20 +1282,97 @@ TEST_FUNCTION(Should_Retry_RETRY_NONE_success)
 	retry_control_destroy(handle);
 }
 
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_028: [If `retry_control_handle`, `retry_action` or `wait_time_in_ms` are NULL, `retry_control_get_wait_time` shall fail and return non-zero]
+TEST_FUNCTION(Get_Wait_Time_NULL_args)
+{
+	// arrange
+	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_INTERVAL, 0);
+	RETRY_ACTION retry_action;
+	unsigned int wait_time_in_ms;
+
+	umock_c_reset_all_calls();
+
+	// act
+	int result1 = retry_control_get_wait_time(NULL, &retry_action, &wait_time_in_ms);
+	int result2 = retry_control_get_wait_time(handle, NULL, &wait_time_in_ms);
+	int result3 = retry_control_get_wait_time(handle, &retry_action, NULL);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+	ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+	ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+
+	// cleanup
+	retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_029: [`retry_control_get_wait_time` shall set `retry_action` as `retry_control_should_retry` would, without changing the state of `retry_control` nor consulting the retry coordinator]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_030: [If `retry_action` is RETRY_ACTION_RETRY_LATER, `wait_time_in_ms` shall be set to what is left of `retry_control->current_wait_time_in_ms` since `retry_control->last_retry_time`]
+TEST_FUNCTION(Get_Wait_Time_INTERVAL_success)
+{
+	// arrange
+	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_INTERVAL, 0);
+	tickcounter_ms_t current_time = TEST_current_time_ms + 2000;
+	RETRY_ACTION retry_action;
+	unsigned int wait_time_in_ms;
+
+	run_and_verify_should_retry(handle, TEST_current_time_ms, RETRY_ACTION_RETRY_NOW);
+	umock_c_reset_all_calls();
+	set_expected_current_ms(&current_time);
+	set_expected_current_ms(&current_time);
+
+	// act
+	int result = retry_control_get_wait_time(handle, &retry_action, &wait_time_in_ms);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(int, RETRY_ACTION_RETRY_LATER, retry_action);
+	ASSERT_ARE_EQUAL(int, 3000, (int)wait_time_in_ms);
+	run_and_verify_should_retry(handle, current_time, RETRY_ACTION_RETRY_LATER);
+	run_and_verify_should_retry(handle, TEST_current_time_ms + 5000, RETRY_ACTION_RETRY_NOW);
+
+	// cleanup
+	retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_029: [`retry_control_get_wait_time` shall set `retry_action` as `retry_control_should_retry` would, without changing the state of `retry_control` nor consulting the retry coordinator]
+TEST_FUNCTION(Get_Wait_Time_RETRY_NONE_stops_retrying)
+{
+	// arrange
+	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_NONE, 10);
+	RETRY_ACTION retry_action;
+	unsigned int wait_time_in_ms;
+
+	umock_c_reset_all_calls();
+
+	// act
+	int result = retry_control_get_wait_time(handle, &retry_action, &wait_time_in_ms);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(int, RETRY_ACTION_STOP_RETRYING, retry_action);
+
+	// cleanup
+	retry_control_destroy(handle);
+}
+
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_034: [If `retry_control_handle` is NULL, `retry_control_reset` shall return]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_035: [`retry_control` shall have fields `retry_count` and `current_wait_time_in_secs` set to 0 (zero), `first_retry_time` and `last_retry_time` set to INDEFINITE_TIME]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_035: [`retry_control` shall have fields `retry_count` and `current_wait_time_in_ms` set to 0 (zero), `first_retry_time` and `last_retry_time` set to INDEFINITE_TIME]
 TEST_FUNCTION(Reset_success)
 {
 	// arrange
 	unsigned int max_retry_time_in_secs = 10;
 	RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_IMMEDIATE, max_retry_time_in_secs);
 
-	time_t first_try_time = TEST_current_time;
-	time_t next_try_time = add_seconds(first_try_time, max_retry_time_in_secs);
+	tickcounter_ms_t first_try_time = TEST_current_time_ms;
+	tickcounter_ms_t next_try_time = first_try_time + max_retry_time_in_secs * 1000;
 
 	// This first call succeeds because retry_count is 0
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(first_try_time);
+	set_expected_current_ms(&first_try_time);
 	RETRY_ACTION retry_action;
 	int result = retry_control_should_retry(handle, &retry_action);
 	ASSERT_ARE_EQUAL(int, 0, result);
@@ -1135,8 +1380,7 @@ TEST_FUNCTION(Reset_success)
 
 	// At this point the retry control reached the max_retry_time_in_secs.
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(next_try_time);
-	STRICT_EXPECTED_CALL(get_difftime(next_try_time, first_try_time)).SetReturn(max_retry_time_in_secs);
+	set_expected_current_ms(&next_try_time);
 	result = retry_control_should_retry(handle, &retry_action);
 	ASSERT_ARE_EQUAL(int, 0, result);
 	ASSERT_ARE_EQUAL(int, RETRY_ACTION_STOP_RETRYING, retry_action);
@@ -1147,7 +1391,7 @@ TEST_FUNCTION(Reset_success)
 	// assert
 	umock_c_reset_all_calls();
 	// notice "next_try_time" below.
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(next_try_time); 
+	set_expected_current_ms(&next_try_time);
 	// The return is RETRY_ACTION_RETRY_NOW because retry_count is 0.
 	result = retry_control_should_retry(handle, &retry_action);
 
@@ -1159,4 +1403,350 @@ TEST_FUNCTION(Reset_success)
 	retry_control_destroy(handle);
 }
 
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_001: [If `retry_budget`, `retries_per_sec` or `failure_threshold` are 0, `retry_coordinator_create` shall fail and return NULL]
+TEST_FUNCTION(Coordinator_Create_invalid_args)
+{
+	// arrange
+	umock_c_reset_all_calls();
+
+	// act
+	RETRY_COORDINATOR_HANDLE no_budget = retry_coordinator_create(0, 1, 10, 30);
+	RETRY_COORDINATOR_HANDLE no_refill = retry_coordinator_create(10, 0, 10, 30);
+	RETRY_COORDINATOR_HANDLE no_threshold = retry_coordinator_create(10, 1, 0, 30);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_NULL(no_budget);
+	ASSERT_IS_NULL(no_refill);
+	ASSERT_IS_NULL(no_threshold);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_002: [`retry_coordinator_create` shall allocate memory for the retry coordinator and create its lock]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_018: [`retry_coordinator_destroy` shall destroy the lock and free the retry coordinator]
+TEST_FUNCTION(Coordinator_Create_and_Destroy_success)
+{
+	// arrange
+	umock_c_reset_all_calls();
+	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(Lock_Init());
+
+	// act
+	RETRY_COORDINATOR_HANDLE handle = retry_coordinator_create(10, 1, 10, 30);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_NOT_NULL(handle);
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(free(handle));
+
+	retry_coordinator_destroy(handle);
+
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_003: [If malloc or Lock_Init fail, `retry_coordinator_create` shall fail and return NULL]
+TEST_FUNCTION(Coordinator_Create_failure_checks)
+{
+	// arrange
+	ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+	umock_c_reset_all_calls();
+	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(Lock_Init());
+	umock_c_negative_tests_snapshot();
+
+	size_t i;
+	for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+	{
+		// arrange
+		char error_msg[64];
+
+		umock_c_negative_tests_reset();
+		umock_c_negative_tests_fail_call(i);
+
+		// act
+		RETRY_COORDINATOR_HANDLE handle = retry_coordinator_create(10, 1, 10, 30);
+
+		// assert
+		sprintf(error_msg, "On failed call %zu", i);
+		ASSERT_IS_NULL_WITH_MSG(handle, error_msg);
+	}
+
+	// cleanup
+	umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_017: [If `retry_coordinator_handle` is NULL, `retry_coordinator_destroy` shall return]
+TEST_FUNCTION(Coordinator_Destroy_NULL_handle)
+{
+	// arrange
+	umock_c_reset_all_calls();
+
+	// act
+	retry_coordinator_destroy(NULL);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_005: [If `name` is "retry_coordinator", `value` shall be saved on `retry_control->retry_coordinator`, releasing the probe of the previous retry coordinator if `retry_control` holds it]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_006: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and a retry coordinator is set, `retry_action` shall be set to RETRY_ACTION_RETRY_LATER unless the retry coordinator admits the retry]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_009: [Otherwise the retry shall be admitted only if a token of the retry budget is available, and it shall take it]
+TEST_FUNCTION(Should_Retry_retry_coordinator_budget_exhausted_retry_later)
+{
+	// arrange
+	RETRY_COORDINATOR_HANDLE retry_coordinator = create_retry_coordinator(1, 1, 10, 30);
+	RETRY_CONTROL_HANDLE handle_a = create_coordinated_retry_control(retry_coordinator);
+	RETRY_CONTROL_HANDLE handle_b = create_coordinated_retry_control(retry_coordinator);
+	time_t t0 = TEST_current_time;
+	time_t t1 = add_seconds(t0, 1);
+	tickcounter_ms_t t0_ms = TEST_current_time_ms;
+
+	umock_c_reset_all_calls();
+
+	// act & assert
+	// the only token goes to the first retry
+	set_expected_current_ms(&t0_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t0);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_a, RETRY_ACTION_RETRY_NOW);
+
+	set_expected_current_ms(&t0_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t0);
+	STRICT_EXPECTED_CALL(get_difftime(t0, t0)).SetReturn(0);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_b, RETRY_ACTION_RETRY_LATER);
+
+	// a second later the budget is refilled
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t1);
+	STRICT_EXPECTED_CALL(get_difftime(t1, t0)).SetReturn(1);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_b, RETRY_ACTION_RETRY_NOW);
+
+	// cleanup
+	retry_control_destroy(handle_a);
+	retry_control_destroy(handle_b);
+	retry_coordinator_destroy(retry_coordinator);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_031: [If `retry_action` is RETRY_ACTION_RETRY_NOW and the retry coordinator held back the last retry, `retry_action` shall be set to RETRY_ACTION_RETRY_LATER and `wait_time_in_ms` to 1000, the coordinator admitting retries by the second]
+TEST_FUNCTION(Get_Wait_Time_retry_coordinator_held_back_waits_a_second)
+{
+	// arrange
+	RETRY_COORDINATOR_HANDLE retry_coordinator = create_retry_coordinator(1, 1, 10, 30);
+	RETRY_CONTROL_HANDLE handle_a = create_coordinated_retry_control(retry_coordinator);
+	RETRY_CONTROL_HANDLE handle_b = create_coordinated_retry_control(retry_coordinator);
+	time_t t0 = TEST_current_time;
+	tickcounter_ms_t t0_ms = TEST_current_time_ms;
+	RETRY_ACTION retry_action;
+	unsigned int wait_time_in_ms;
+
+	umock_c_reset_all_calls();
+	set_expected_current_ms(&t0_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t0);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_a, RETRY_ACTION_RETRY_NOW);
+
+	set_expected_current_ms(&t0_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t0);
+	STRICT_EXPECTED_CALL(get_difftime(t0, t0)).SetReturn(0);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_b, RETRY_ACTION_RETRY_LATER);
+
+	// act
+	int result = retry_control_get_wait_time(handle_b, &retry_action, &wait_time_in_ms);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(int, RETRY_ACTION_RETRY_LATER, retry_action);
+	ASSERT_ARE_EQUAL(int, 1000, (int)wait_time_in_ms);
+
+	// cleanup
+	retry_control_destroy(handle_a);
+	retry_control_destroy(handle_b);
+	retry_coordinator_destroy(retry_coordinator);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_007: [If the circuit is closed, the failed attempt of `retry_control` shall be counted once, however many times the retry is held back]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_008: [If `failure_threshold` failures were counted, the circuit shall open and the retry shall not be admitted]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_010: [If the circuit is open for `open_time_in_secs` or more, it shall be half-open and the retry of `retry_control` shall be admitted as the single probe]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_011: [Otherwise, while the circuit is open, no retry shall be admitted]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_014: [Otherwise, while the probe is pending, no other retry shall be admitted]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_015: [If a retry coordinator is set, `retry_control_reset` shall report the connection success to it, closing its circuit and clearing its failure count]
+TEST_FUNCTION(Should_Retry_retry_coordinator_opens_circuit_and_lets_one_probe)
+{
+	// arrange
+	RETRY_COORDINATOR_HANDLE retry_coordinator = create_retry_coordinator(10, 1, 2, 30);
+	RETRY_CONTROL_HANDLE handle_a = create_coordinated_retry_control(retry_coordinator);
+	RETRY_CONTROL_HANDLE handle_b = create_coordinated_retry_control(retry_coordinator);
+	time_t t0 = TEST_current_time;
+	time_t t1 = add_seconds(t0, 1);
+	time_t t2 = add_seconds(t0, 30);
+	tickcounter_ms_t t0_ms = TEST_current_time_ms;
+	tickcounter_ms_t t1_ms = TEST_current_time_ms + 1000;
+	tickcounter_ms_t t2_ms = TEST_current_time_ms + 30000;
+
+	umock_c_reset_all_calls();
+
+	// act & assert
+	set_expected_current_ms(&t0_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t0);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_a, RETRY_ACTION_RETRY_NOW);
+
+	// the second failure opens the circuit
+	set_expected_current_ms(&t0_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t0);
+	STRICT_EXPECTED_CALL(get_difftime(t0, t0)).SetReturn(0);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_b, RETRY_ACTION_RETRY_LATER);
+
+	set_expected_current_ms(&t1_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t1);
+	STRICT_EXPECTED_CALL(get_difftime(t1, t0)).SetReturn(1);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_a, RETRY_ACTION_RETRY_LATER);
+
+	// once open_time_in_secs elapsed a single probe goes through
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t2);
+	STRICT_EXPECTED_CALL(get_difftime(t2, t0)).SetReturn(30);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_b, RETRY_ACTION_RETRY_NOW);
+
+	set_expected_current_ms(&t2_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t2);
+	STRICT_EXPECTED_CALL(get_difftime(t2, t2)).SetReturn(0);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_a, RETRY_ACTION_RETRY_LATER);
+
+	// the probe connects, closing the circuit
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	retry_control_reset(handle_b);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	umock_c_reset_all_calls();
+
+	set_expected_current_ms(&t2_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t2);
+	STRICT_EXPECTED_CALL(get_difftime(t2, t0)).SetReturn(30);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_a, RETRY_ACTION_RETRY_NOW);
+
+	// cleanup
+	retry_control_destroy(handle_a);
+	retry_control_destroy(handle_b);
+	retry_coordinator_destroy(retry_coordinator);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_012: [If the circuit is half-open and the probe asks to retry again, the probe failed and the circuit shall open again]
+TEST_FUNCTION(Should_Retry_retry_coordinator_failed_probe_reopens_circuit)
+{
+	// arrange
+	RETRY_COORDINATOR_HANDLE retry_coordinator = create_retry_coordinator(10, 1, 1, 30);
+	RETRY_CONTROL_HANDLE handle = create_coordinated_retry_control(retry_coordinator);
+	time_t t0 = TEST_current_time;
+	time_t t1 = add_seconds(t0, 30);
+	time_t t2 = add_seconds(t0, 31);
+	time_t t3 = add_seconds(t0, 32);
+	tickcounter_ms_t t0_ms = TEST_current_time_ms;
+	tickcounter_ms_t t2_ms = TEST_current_time_ms + 31000;
+	tickcounter_ms_t t3_ms = TEST_current_time_ms + 32000;
+
+	umock_c_reset_all_calls();
+
+	// act & assert
+	set_expected_current_ms(&t0_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t0);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle, RETRY_ACTION_RETRY_LATER);
+
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t1);
+	STRICT_EXPECTED_CALL(get_difftime(t1, t0)).SetReturn(30);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle, RETRY_ACTION_RETRY_NOW);
+
+	// the probe failed and asks again
+	set_expected_current_ms(&t2_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t2);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle, RETRY_ACTION_RETRY_LATER);
+
+	set_expected_current_ms(&t3_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t3);
+	STRICT_EXPECTED_CALL(get_difftime(t3, t2)).SetReturn(1);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle, RETRY_ACTION_RETRY_LATER);
+
+	// cleanup
+	retry_control_destroy(handle);
+	retry_coordinator_destroy(retry_coordinator);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_013: [If the circuit is half-open and the probe was released or has not completed for `open_time_in_secs`, the retry of `retry_control` shall be admitted as the new probe]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_016: [If a retry coordinator is set and `retry_control_handle` holds its probe, `retry_control_destroy` shall release the probe]
+TEST_FUNCTION(Destroy_releases_retry_coordinator_probe)
+{
+	// arrange
+	RETRY_COORDINATOR_HANDLE retry_coordinator = create_retry_coordinator(10, 1, 1, 30);
+	RETRY_CONTROL_HANDLE handle_a = create_coordinated_retry_control(retry_coordinator);
+	RETRY_CONTROL_HANDLE handle_b = create_coordinated_retry_control(retry_coordinator);
+	time_t t0 = TEST_current_time;
+	time_t t1 = add_seconds(t0, 30);
+	tickcounter_ms_t t0_ms = TEST_current_time_ms;
+	tickcounter_ms_t t1_ms = TEST_current_time_ms + 30000;
+
+	umock_c_reset_all_calls();
+
+	set_expected_current_ms(&t0_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t0);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_a, RETRY_ACTION_RETRY_LATER);
+
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t1);
+	STRICT_EXPECTED_CALL(get_difftime(t1, t0)).SetReturn(30);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_a, RETRY_ACTION_RETRY_NOW);
+
+	// act
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+	STRICT_EXPECTED_CALL(free(handle_a));
+	retry_control_destroy(handle_a);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	umock_c_reset_all_calls();
+
+	set_expected_current_ms(&t1_ms);
+	STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t1);
+	STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+	verify_coordinated_should_retry(handle_b, RETRY_ACTION_RETRY_NOW);
+
+	// cleanup
+	retry_control_destroy(handle_b);
+	retry_coordinator_destroy(retry_coordinator);
+}
+
 END_TEST_SUITE(iothub_client_retry_control_ut)
@@ -0,0 +1,122 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /*pthread_getname_np and pthread_setname_np*/
+#endif
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+#include "testrunnerswitcher.h"
+
+#include "iothub_client_thread_attributes.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+BEGIN_TEST_SUITE(iothub_client_thread_attributes_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_001: [ If attributes is NULL, IoTHubClient_ThreadAttributes_ApplyToCurrentThread shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubClient_ThreadAttributes_ApplyToCurrentThread_with_NULL_attributes_fails)
+{
+    // act
+    int result = IoTHubClient_ThreadAttributes_ApplyToCurrentThread(NULL, "-work");
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(IoTHubClient_ThreadAttributes_ApplyToCurrentThread_with_nothing_asked_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_THREAD_ATTRIBUTES attributes = { 0, false, 0, NULL };
+
+    // act
+    int result = IoTHubClient_ThreadAttributes_ApplyToCurrentThread(&attributes, "-work");
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+}
+
+#if defined(__linux__)
+/* Tests_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_004: [ If name is not NULL and the platform names threads, the calling thread shall be named name followed by name_suffix, cut to what the platform allows. ]*/
+TEST_FUNCTION(IoTHubClient_ThreadAttributes_ApplyToCurrentThread_names_the_thread_with_the_suffix)
+{
+    // arrange
+    char saved_name[16];
+    char name[16];
+    IOTHUB_CLIENT_THREAD_ATTRIBUTES attributes = { 0, false, 0, "ctrl" };
+    ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), saved_name, sizeof(saved_name)));
+
+    // act
+    int result = IoTHubClient_ThreadAttributes_ApplyToCurrentThread(&attributes, "-work");
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), name, sizeof(name)));
+    ASSERT_ARE_EQUAL(char_ptr, "ctrl-work", name);
+
+    // cleanup
+    (void)pthread_setname_np(pthread_self(), saved_name);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_THREAD_ATTRIBUTES_41_004: [ If name is not NULL and the platform names threads, the calling thread shall be named name followed by name_suffix, cut to what the platform allows. ]*/
+TEST_FUNCTION(IoTHubClient_ThreadAttributes_ApplyToCurrentThread_cuts_a_long_name)
+{
+    // arrange
+    char saved_name[16];
+    char name[16];
+    IOTHUB_CLIENT_THREAD_ATTRIBUTES attributes = { 0, false, 0, "a_long_controller_name" };
+    ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), saved_name, sizeof(saved_name)));
+
+    // act
+    int result = IoTHubClient_ThreadAttributes_ApplyToCurrentThread(&attributes, "-work");
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), name, sizeof(name)));
+    ASSERT_ARE_EQUAL(char_ptr, "a_long_controll", name);
+
+    // cleanup
+    (void)pthread_setname_np(pthread_self(), saved_name);
+}
+#endif
+
+END_TEST_SUITE(iothub_client_thread_attributes_ut)
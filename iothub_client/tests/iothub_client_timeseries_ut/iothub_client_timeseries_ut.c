@@ -0,0 +1,538 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_timeseries.h"
+
+#define TEST_MESSAGE_HANDLE     (IOTHUB_MESSAGE_HANDLE)0x41
+#define TEST_MAP_HANDLE         (MAP_HANDLE)0x42
+#define TEST_TIMESTAMP          1500000000000LL
+#define TEST_INTERVAL           1000
+#define TEST_MAX_SAMPLES        64
+
+/*the prototype hook decodes the payload as a decoder following the requirements would*/
+static int64_t g_timestamps[TEST_MAX_SAMPLES];
+static double g_values[TEST_MAX_SAMPLES];
+static size_t g_decodedCount;
+static size_t g_payloadSize;
+static const unsigned char* g_payload;
+static size_t g_bitPosition;
+
+static uint64_t read_bits(unsigned int count)
+{
+    uint64_t result = 0;
+    while (count-- > 0)
+    {
+        result = (result << 1) | ((g_payload[g_bitPosition / 8] >> (7 - (g_bitPosition % 8))) & 1);
+        g_bitPosition++;
+    }
+    return result;
+}
+
+static uint64_t sign_extend(uint64_t value, unsigned int count)
+{
+    return ((value >> (count - 1)) & 1) ? value | (~(uint64_t)0 << count) : value;
+}
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
+{
+    uint64_t timestamp;
+    uint64_t delta = 0;
+    uint64_t value;
+    unsigned int leading = 0;
+    unsigned int trailing = 0;
+    size_t count;
+    size_t i;
+
+    g_payload = byteArray;
+    g_payloadSize = size;
+    g_bitPosition = 0;
+    g_decodedCount = 0;
+
+    if ((read_bits(8) == TIMESERIES_FORMAT_VERSION) &&
+        ((count = (size_t)read_bits(32)) <= TEST_MAX_SAMPLES))
+    {
+        timestamp = read_bits(64);
+        value = read_bits(64);
+        for (i = 0; i < count; i++)
+        {
+            if (i > 0)
+            {
+                uint64_t deltaOfDelta;
+                if (read_bits(1) == 0)
+                {
+                    deltaOfDelta = 0;
+                }
+                else if (read_bits(1) == 0)
+                {
+                    deltaOfDelta = sign_extend(read_bits(7), 7);
+                }
+                else if (read_bits(1) == 0)
+                {
+                    deltaOfDelta = sign_extend(read_bits(9), 9);
+                }
+                else if (read_bits(1) == 0)
+                {
+                    deltaOfDelta = sign_extend(read_bits(12), 12);
+                }
+                else
+                {
+                    deltaOfDelta = read_bits(64);
+                }
+                delta += deltaOfDelta;
+                timestamp += delta;
+
+                if (read_bits(1) == 1)
+                {
+                    if (read_bits(1) == 0)
+                    {
+                        value ^= read_bits(64 - leading - trailing) << trailing;
+                    }
+                    else
+                    {
+                        unsigned int meaningful;
+                        leading = (unsigned int)read_bits(5);
+                        meaningful = (unsigned int)read_bits(6);
+                        if (meaningful == 0)
+                        {
+                            meaningful = 64;
+                        }
+                        trailing = 64 - leading - meaningful;
+                        value ^= read_bits(meaningful) << trailing;
+                    }
+                }
+            }
+            g_timestamps[i] = (int64_t)timestamp;
+            (void)memcpy(&g_values[i], &value, sizeof(value));
+        }
+        g_decodedCount = count;
+    }
+    return TEST_MESSAGE_HANDLE;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TIMESERIES_BUILDER_HANDLE create_builder(void)
+{
+    TIMESERIES_BUILDER_HANDLE result = timeseries_builder_create();
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void append_samples(TIMESERIES_BUILDER_HANDLE builder, const int64_t* timestamps, const double* values, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_OK, timeseries_builder_append(builder, timestamps[i], values[i]));
+    }
+    umock_c_reset_all_calls();
+}
+
+static void assert_decoded(const int64_t* timestamps, const double* values, size_t count)
+{
+    size_t i;
+    ASSERT_ARE_EQUAL(size_t, count, g_decodedCount);
+    ASSERT_ARE_EQUAL(size_t, (g_bitPosition + 7) / 8, g_payloadSize);
+    for (i = 0; i < count; i++)
+    {
+        ASSERT_IS_TRUE(timestamps[i] == g_timestamps[i]);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(&values[i], &g_values[i], sizeof(double)));
+    }
+}
+
+static void setup_to_message(void)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, TIMESERIES_CONTENT_TYPE_PROPERTY, TIMESERIES_CONTENT_TYPE_GORILLA));
+}
+
+BEGIN_TEST_SUITE(iothub_client_timeseries_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromByteArray, my_IoTHubMessage_CreateFromByteArray);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromByteArray, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Properties, TEST_MAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_AddOrUpdate, MAP_ERROR);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    g_decodedCount = 0;
+    g_payloadSize = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_001: [ timeseries_builder_create shall allocate a builder without samples, its buffer being allocated by the first sample, and return a non-NULL handle. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_003: [ timeseries_builder_destroy shall free the builder and its buffer, doing nothing if builder is NULL. ]*/
+TEST_FUNCTION(timeseries_builder_create_succeeds)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    TIMESERIES_BUILDER_HANDLE result = timeseries_builder_create();
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 0, timeseries_builder_get_sample_count(result));
+    ASSERT_ARE_EQUAL(size_t, 0, timeseries_builder_get_size(result));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    timeseries_builder_destroy(result);
+    timeseries_builder_destroy(NULL);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_002: [ If allocating fails, timeseries_builder_create shall fail and return NULL. ]*/
+TEST_FUNCTION(timeseries_builder_create_fails_when_malloc_fails)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    TIMESERIES_BUILDER_HANDLE result = timeseries_builder_create();
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_004: [ If builder is NULL, or it holds UINT32_MAX samples, timeseries_builder_append shall fail and return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+TEST_FUNCTION(timeseries_builder_append_with_NULL_builder_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = timeseries_builder_append(NULL, TEST_TIMESTAMP, 1.0);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_006: [ The first sample shall be written after the header as its 64 bits of timestamp and the 64 bits of the IEEE 754 binary64 value. ]*/
+TEST_FUNCTION(timeseries_builder_append_first_sample_allocates_the_buffer)
+{
+    //arrange
+    TIMESERIES_BUILDER_HANDLE builder = create_builder();
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = timeseries_builder_append(builder, TEST_TIMESTAMP, 21.5);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, timeseries_builder_get_sample_count(builder));
+    ASSERT_ARE_EQUAL(size_t, 5 + 8 + 8, timeseries_builder_get_size(builder));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    timeseries_builder_destroy(builder);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_005: [ If the buffer cannot grow to the largest encoding of the sample, timeseries_builder_append shall fail, leave the series as it was and return IOTHUB_MESSAGE_ERROR. ]*/
+TEST_FUNCTION(timeseries_builder_append_fails_when_realloc_fails)
+{
+    //arrange
+    TIMESERIES_BUILDER_HANDLE builder = create_builder();
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = timeseries_builder_append(builder, TEST_TIMESTAMP, 21.5);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, timeseries_builder_get_sample_count(builder));
+    ASSERT_ARE_EQUAL(size_t, 0, timeseries_builder_get_size(builder));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    timeseries_builder_destroy(builder);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_007: [ The delta of delta D of the timestamps shall be written as '0' if it is 0, '10' and 7 bits if it is between -64 and 63, '110' and 9 bits between -256 and 255, '1110' and 12 bits between -2048 and 2047, '1111' and 64 bits otherwise, in two's complement. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_008: [ The XOR X of the bits of the value with the previous one shall be written as '0' if it is 0, as '10' and the bits of X between the leading and trailing zeros of the last block written if X has at least as many, or else as '11', 5 bits of leading zeros (at most 31), 6 bits of the number of meaningful bits (0 for 64) and the meaningful bits, which start a new block. ]*/
+TEST_FUNCTION(timeseries_builder_append_regular_samples_take_2_bits)
+{
+    //arrange
+    TIMESERIES_BUILDER_HANDLE builder = create_builder();
+    size_t i;
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_OK, timeseries_builder_append(builder, TEST_TIMESTAMP, 21.5));
+    /*the first delta is a delta of delta of 1000, '1110' and 12 bits*/
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_OK, timeseries_builder_append(builder, TEST_TIMESTAMP + TEST_INTERVAL, 21.5));
+    umock_c_reset_all_calls();
+
+    //act
+    for (i = 2; i < 18; i++)
+    {
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_OK, timeseries_builder_append(builder, TEST_TIMESTAMP + (int64_t)i * TEST_INTERVAL, 21.5));
+    }
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 18, timeseries_builder_get_sample_count(builder));
+    /*168 bits of header and first sample, 17 bits of second sample, 16 samples of 2 bits*/
+    ASSERT_ARE_EQUAL(size_t, (168 + 17 + 32 + 7) / 8, timeseries_builder_get_size(builder));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    timeseries_builder_destroy(builder);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_009: [ timeseries_builder_get_sample_count shall return the number of samples of the series, 0 if builder is NULL. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_010: [ timeseries_builder_get_size shall return the size in bytes of the payload of the series, 0 if builder is NULL or without samples. ]*/
+TEST_FUNCTION(timeseries_builder_get_sample_count_and_size_with_NULL_builder_return_0)
+{
+    //arrange
+
+    //act
+    size_t count = timeseries_builder_get_sample_count(NULL);
+    size_t size = timeseries_builder_get_size(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, count);
+    ASSERT_ARE_EQUAL(size_t, 0, size);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_011: [ If builder is NULL or without samples, timeseries_builder_to_message shall fail and return NULL. ]*/
+TEST_FUNCTION(timeseries_builder_to_message_without_samples_fails)
+{
+    //arrange
+    TIMESERIES_BUILDER_HANDLE builder = create_builder();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result1 = timeseries_builder_to_message(NULL);
+    IOTHUB_MESSAGE_HANDLE result2 = timeseries_builder_to_message(builder);
+
+    //assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    timeseries_builder_destroy(builder);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_012: [ timeseries_builder_to_message shall write the header, TIMESERIES_FORMAT_VERSION in 8 bits and the sample count in 32 bits, and return a message created by IoTHubMessage_CreateFromByteArray with the series, with the application property content-type set to application/x-gorilla-timeseries. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_013: [ timeseries_builder_to_message shall then start a new series, keeping the buffer. ]*/
+TEST_FUNCTION(timeseries_builder_to_message_round_trips_a_regular_series)
+{
+    //arrange
+    static const int64_t timestamps[] = { TEST_TIMESTAMP, TEST_TIMESTAMP + 1000, TEST_TIMESTAMP + 2000, TEST_TIMESTAMP + 3001, TEST_TIMESTAMP + 3999, TEST_TIMESTAMP + 5000 };
+    static const double values[] = { 21.5, 21.5, 21.75, 21.5, 22.0, -3.25 };
+    TIMESERIES_BUILDER_HANDLE builder = create_builder();
+    size_t size;
+    append_samples(builder, timestamps, values, sizeof(values) / sizeof(values[0]));
+    size = timeseries_builder_get_size(builder);
+    setup_to_message();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = timeseries_builder_to_message(builder);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_MESSAGE_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, size, g_payloadSize);
+    assert_decoded(timestamps, values, sizeof(values) / sizeof(values[0]));
+    ASSERT_ARE_EQUAL(size_t, 0, timeseries_builder_get_sample_count(builder));
+    ASSERT_ARE_EQUAL(size_t, 0, timeseries_builder_get_size(builder));
+
+    //cleanup
+    timeseries_builder_destroy(builder);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_007: [ The delta of delta D of the timestamps shall be written as '0' if it is 0, '10' and 7 bits if it is between -64 and 63, '110' and 9 bits between -256 and 255, '1110' and 12 bits between -2048 and 2047, '1111' and 64 bits otherwise, in two's complement. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_008: [ The XOR X of the bits of the value with the previous one shall be written as '0' if it is 0, as '10' and the bits of X between the leading and trailing zeros of the last block written if X has at least as many, or else as '11', 5 bits of leading zeros (at most 31), 6 bits of the number of meaningful bits (0 for 64) and the meaningful bits, which start a new block. ]*/
+TEST_FUNCTION(timeseries_builder_to_message_round_trips_every_encoding)
+{
+    //arrange
+    static const int64_t timestamps[] = { 0, 10, 20, 83, 82, 337, 336, 2383, 2382, 100000, INT64_MIN, INT64_MAX, -1, -1, 5 };
+    static const double values[] = { 0.0, -0.0, 1.0, 1.0e300, -1.0e-300, 1.0, 1.5, 1.75, 1.0, 2.0, 4.0, 0.1, 0.0, 123456.789, 123456.789 };
+    TIMESERIES_BUILDER_HANDLE builder = create_builder();
+    append_samples(builder, timestamps, values, sizeof(values) / sizeof(values[0]));
+    setup_to_message();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = timeseries_builder_to_message(builder);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_MESSAGE_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_decoded(timestamps, values, sizeof(values) / sizeof(values[0]));
+
+    //cleanup
+    timeseries_builder_destroy(builder);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_013: [ timeseries_builder_to_message shall then start a new series, keeping the buffer. ]*/
+TEST_FUNCTION(timeseries_builder_to_message_starts_a_new_series)
+{
+    //arrange
+    static const int64_t timestamps1[] = { TEST_TIMESTAMP, TEST_TIMESTAMP + 1000, TEST_TIMESTAMP + 2000 };
+    static const double values1[] = { 1.0, 2.0, 3.0 };
+    static const int64_t timestamps2[] = { 7, 8 };
+    static const double values2[] = { -1.0, -1.0 };
+    TIMESERIES_BUILDER_HANDLE builder = create_builder();
+    append_samples(builder, timestamps1, values1, sizeof(values1) / sizeof(values1[0]));
+    ASSERT_ARE_EQUAL(void_ptr, TEST_MESSAGE_HANDLE, timeseries_builder_to_message(builder));
+    umock_c_reset_all_calls();
+
+    //act
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_OK, timeseries_builder_append(builder, timestamps2[0], values2[0]));
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGE_OK, timeseries_builder_append(builder, timestamps2[1], values2[1]));
+    setup_to_message();
+    IOTHUB_MESSAGE_HANDLE result = timeseries_builder_to_message(builder);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_MESSAGE_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_decoded(timestamps2, values2, sizeof(values2) / sizeof(values2[0]));
+
+    //cleanup
+    timeseries_builder_destroy(builder);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_014: [ If any error occurs, timeseries_builder_to_message shall fail, keep the series and return NULL. ]*/
+TEST_FUNCTION(timeseries_builder_to_message_fails_when_creating_the_message_fails)
+{
+    //arrange
+    static const int64_t timestamps[] = { TEST_TIMESTAMP, TEST_TIMESTAMP + 1000 };
+    static const double values[] = { 1.0, 2.0 };
+    TIMESERIES_BUILDER_HANDLE builder = create_builder();
+    append_samples(builder, timestamps, values, sizeof(values) / sizeof(values[0]));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = timeseries_builder_to_message(builder);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, timeseries_builder_get_sample_count(builder));
+
+    //cleanup
+    timeseries_builder_destroy(builder);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_TIMESERIES_41_014: [ If any error occurs, timeseries_builder_to_message shall fail, keep the series and return NULL. ]*/
+TEST_FUNCTION(timeseries_builder_to_message_fails_when_setting_the_content_type_fails)
+{
+    //arrange
+    static const int64_t timestamps[] = { TEST_TIMESTAMP, TEST_TIMESTAMP + 1000 };
+    static const double values[] = { 1.0, 2.0 };
+    TIMESERIES_BUILDER_HANDLE builder = create_builder();
+    append_samples(builder, timestamps, values, sizeof(values) / sizeof(values[0]));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, TIMESERIES_CONTENT_TYPE_PROPERTY, TIMESERIES_CONTENT_TYPE_GORILLA))
+        .SetReturn(MAP_ERROR);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE result = timeseries_builder_to_message(builder);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, timeseries_builder_get_sample_count(builder));
+
+    //cleanup
+    timeseries_builder_destroy(builder);
+}
+
+END_TEST_SUITE(iothub_client_timeseries_ut)
@@ -0,0 +1,210 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#include "iothub_client_trace.h"
+
+#define TEST_CONTEXT        ((void*)0x4242)
+#define TEST_SUBJECT        ((const void*)0x1111)
+#define TEST_OTHER_SUBJECT  ((const void*)0x2222)
+
+static size_t g_trace_call_count;
+static void* g_trace_context;
+static IOTHUB_CLIENT_TRACE_EVENT g_trace_event;
+static uint64_t g_trace_timestamp_ns;
+static const void* g_trace_subject;
+static uint64_t g_trace_value;
+
+static void test_trace_callback(void* context, IOTHUB_CLIENT_TRACE_EVENT trace_event, uint64_t timestamp_ns, const void* subject, uint64_t value)
+{
+    g_trace_call_count++;
+    g_trace_context = context;
+    g_trace_event = trace_event;
+    g_trace_timestamp_ns = timestamp_ns;
+    g_trace_subject = subject;
+    g_trace_value = value;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_trace_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+
+    g_trace_call_count = 0;
+    g_trace_context = NULL;
+    g_trace_subject = NULL;
+    g_trace_value = 0;
+    g_trace_timestamp_ns = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    (void)IoTHubClient_Trace_SetCallback(NULL, NULL);
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(IOTHUB_CLIENT_TRACE_without_a_backend_does_nothing)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_SEND_QUEUED, TEST_SUBJECT, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, iothub_client_trace_enabled);
+    ASSERT_ARE_EQUAL(size_t, 0, g_trace_call_count);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRACE_41_001: [ IoTHubClient_Trace_SetCallback shall store trace_callback and context, and return 0. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_TRACE_41_008: [ iothub_client_trace_emit shall call the trace callback with its context, trace_event, a monotonic timestamp in nanoseconds, subject and value. ]*/
+TEST_FUNCTION(IOTHUB_CLIENT_TRACE_calls_the_callback)
+{
+    // arrange
+    int result = IoTHubClient_Trace_SetCallback(test_trace_callback, TEST_CONTEXT);
+
+    // act
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, TEST_SUBJECT, 42);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_trace_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT, g_trace_context);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, (int)g_trace_event);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)TEST_SUBJECT, (void*)g_trace_subject);
+    ASSERT_ARE_EQUAL(uint64_t, 42, g_trace_value);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRACE_41_008: [ iothub_client_trace_emit shall call the trace callback with its context, trace_event, a monotonic timestamp in nanoseconds, subject and value. ]*/
+TEST_FUNCTION(IOTHUB_CLIENT_TRACE_timestamps_do_not_go_back)
+{
+    // arrange
+    uint64_t first_timestamp_ns;
+    (void)IoTHubClient_Trace_SetCallback(test_trace_callback, TEST_CONTEXT);
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_PUBLISH, TEST_SUBJECT, 0);
+    first_timestamp_ns = g_trace_timestamp_ns;
+
+    // act
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_TRANSPORT_ACK, TEST_OTHER_SUBJECT, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_trace_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)TEST_OTHER_SUBJECT, (void*)g_trace_subject);
+    ASSERT_IS_TRUE(g_trace_timestamp_ns >= first_timestamp_ns);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRACE_41_001: [ IoTHubClient_Trace_SetCallback shall store trace_callback and context, and return 0. ]*/
+TEST_FUNCTION(IoTHubClient_Trace_SetCallback_replaces_the_callback_context)
+{
+    // arrange
+    (void)IoTHubClient_Trace_SetCallback(test_trace_callback, NULL);
+
+    // act
+    int result = IoTHubClient_Trace_SetCallback(test_trace_callback, TEST_CONTEXT);
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CONNECTION_STATE, TEST_SUBJECT, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_trace_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT, g_trace_context);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRACE_41_002: [ If trace_callback is NULL, the trace points shall stop calling the callback. ]*/
+TEST_FUNCTION(IoTHubClient_Trace_SetCallback_NULL_stops_the_calls)
+{
+    // arrange
+    (void)IoTHubClient_Trace_SetCallback(test_trace_callback, TEST_CONTEXT);
+
+    // act
+    int result = IoTHubClient_Trace_SetCallback(NULL, NULL);
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CBS_PUT_TOKEN, TEST_SUBJECT, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, iothub_client_trace_enabled);
+    ASSERT_ARE_EQUAL(size_t, 0, g_trace_call_count);
+}
+
+#if !defined(USE_ETW_TRACE) && !defined(USE_LTTNG_TRACE)
+/* Tests_SRS_IOTHUB_CLIENT_TRACE_41_006: [ If no platform backend is built in, IoTHubClient_Trace_EnablePlatformBackend shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubClient_Trace_EnablePlatformBackend_without_a_backend_fails)
+{
+    // arrange
+
+    // act
+    int result = IoTHubClient_Trace_EnablePlatformBackend();
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, iothub_client_trace_enabled);
+}
+#endif
+
+/* Tests_SRS_IOTHUB_CLIENT_TRACE_41_007: [ IoTHubClient_Trace_DisablePlatformBackend shall turn the platform backend off, unregistering the TraceLogging provider with use_etw_trace. ]*/
+TEST_FUNCTION(IoTHubClient_Trace_DisablePlatformBackend_keeps_the_callback)
+{
+    // arrange
+    (void)IoTHubClient_Trace_SetCallback(test_trace_callback, TEST_CONTEXT);
+    (void)IoTHubClient_Trace_EnablePlatformBackend();
+
+    // act
+    IoTHubClient_Trace_DisablePlatformBackend();
+    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_EVENT_CBS_PUT_TOKEN_COMPLETE, TEST_SUBJECT, 200);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_trace_call_count);
+    ASSERT_ARE_EQUAL(uint64_t, 200, g_trace_value);
+}
+
+END_TEST_SUITE(iothub_client_trace_ut)
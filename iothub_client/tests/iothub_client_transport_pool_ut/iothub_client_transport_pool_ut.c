@@ -0,0 +1,490 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "iothubtransport.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_transport_pool.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#define TEST_TRANSPORT_COUNT 3
+#define TEST_IOTHUB_NAME "theNameoftheIotHub"
+#define TEST_IOTHUB_SUFFIX "theSuffixoftheIotHubHostname"
+#define TEST_DEVICE_ID "theidofTheDevice"
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4241;
+static TRANSPORT_HANDLE TEST_UNKNOWN_TRANSPORT_HANDLE = (TRANSPORT_HANDLE)0x4242;
+
+static const TRANSPORT_PROVIDER* TEST_PROTOCOL(void)
+{
+    return NULL;
+}
+
+/*each created transport gets its own handle, so the tests can tell them apart*/
+static size_t g_created_transport_count;
+static TRANSPORT_HANDLE my_IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
+{
+    (void)protocol;
+    (void)iotHubName;
+    (void)iotHubSuffix;
+    g_created_transport_count++;
+    return (TRANSPORT_HANDLE)(0x4300 + g_created_transport_count);
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static void set_expected_calls_for_create(size_t transport_count)
+{
+    size_t i;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    for (i = 0; i < transport_count; i++)
+    {
+        STRICT_EXPECTED_CALL(IoTHubTransport_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX));
+    }
+}
+
+static TRANSPORT_POOL_HANDLE create_transport_pool(size_t max_devices_per_transport)
+{
+    TRANSPORT_POOL_HANDLE result = transport_pool_create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_TRANSPORT_COUNT, max_devices_per_transport);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothub_client_transport_pool_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSPORT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_TRANSPORT_PROVIDER, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubTransport_Create, my_IoTHubTransport_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubTransport_Create, NULL);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+    g_created_transport_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL or transport_count is 0, transport_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(transport_pool_create_NULL_protocol_fails)
+{
+    // arrange
+
+    // act
+    TRANSPORT_POOL_HANDLE result = transport_pool_create(NULL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_TRANSPORT_COUNT, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL or transport_count is 0, transport_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(transport_pool_create_NULL_iotHubName_fails)
+{
+    // arrange
+
+    // act
+    TRANSPORT_POOL_HANDLE result = transport_pool_create(TEST_PROTOCOL, NULL, TEST_IOTHUB_SUFFIX, TEST_TRANSPORT_COUNT, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL or transport_count is 0, transport_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(transport_pool_create_NULL_iotHubSuffix_fails)
+{
+    // arrange
+
+    // act
+    TRANSPORT_POOL_HANDLE result = transport_pool_create(TEST_PROTOCOL, TEST_IOTHUB_NAME, NULL, TEST_TRANSPORT_COUNT, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL or transport_count is 0, transport_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(transport_pool_create_transport_count_0_fails)
+{
+    // arrange
+
+    // act
+    TRANSPORT_POOL_HANDLE result = transport_pool_create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, 0, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_002: [ transport_pool_create shall allocate memory for the pool and its transports and create a lock. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_004: [ transport_pool_create shall create transport_count transports by calling IoTHubTransport_Create with protocol, iotHubName and iotHubSuffix. ]*/
+TEST_FUNCTION(transport_pool_create_succeeds)
+{
+    // arrange
+    set_expected_calls_for_create(TEST_TRANSPORT_COUNT);
+
+    // act
+    TRANSPORT_POOL_HANDLE result = transport_pool_create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_TRANSPORT_COUNT, 0);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    transport_pool_destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_003: [ If any of the resources cannot be created, transport_pool_create shall free everything it allocated and return NULL. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_005: [ If creating any of the transports fails, transport_pool_create shall destroy the transports already created, free all resources and return NULL. ]*/
+TEST_FUNCTION(transport_pool_create_negative_tests)
+{
+    // arrange
+    size_t i;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_expected_calls_for_create(TEST_TRANSPORT_COUNT);
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        TRANSPORT_POOL_HANDLE result = transport_pool_create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_TRANSPORT_COUNT, 0);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, "transport_pool_create was expected to fail");
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_005: [ If creating any of the transports fails, transport_pool_create shall destroy the transports already created, free all resources and return NULL. ]*/
+TEST_FUNCTION(transport_pool_create_destroys_created_transports_on_failure)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(IoTHubTransport_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy((TRANSPORT_HANDLE)0x4301));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    TRANSPORT_POOL_HANDLE result = transport_pool_create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_TRANSPORT_COUNT, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_006: [ If transport_pool is NULL, transport_pool_destroy shall return. ]*/
+TEST_FUNCTION(transport_pool_destroy_NULL_returns)
+{
+    // arrange
+
+    // act
+    transport_pool_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_007: [ transport_pool_destroy shall destroy all the transports of the pool, its lock and free its memory. ]*/
+TEST_FUNCTION(transport_pool_destroy_destroys_transports_and_frees_resources)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE transport_pool = create_transport_pool(0);
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy((TRANSPORT_HANDLE)0x4301));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy((TRANSPORT_HANDLE)0x4302));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy((TRANSPORT_HANDLE)0x4303));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    transport_pool_destroy(transport_pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_008: [ If transport_pool or device_id is NULL, transport_pool_acquire shall fail and return NULL. ]*/
+TEST_FUNCTION(transport_pool_acquire_NULL_transport_pool_fails)
+{
+    // arrange
+
+    // act
+    TRANSPORT_HANDLE result = transport_pool_acquire(NULL, TEST_DEVICE_ID);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_008: [ If transport_pool or device_id is NULL, transport_pool_acquire shall fail and return NULL. ]*/
+TEST_FUNCTION(transport_pool_acquire_NULL_device_id_fails)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE transport_pool = create_transport_pool(0);
+
+    // act
+    TRANSPORT_HANDLE result = transport_pool_acquire(transport_pool, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    transport_pool_destroy(transport_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_009: [ If taking the lock fails, transport_pool_acquire shall fail and return NULL. ]*/
+TEST_FUNCTION(transport_pool_acquire_Lock_fails)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE transport_pool = create_transport_pool(0);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    TRANSPORT_HANDLE result = transport_pool_acquire(transport_pool, TEST_DEVICE_ID);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    transport_pool_destroy(transport_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_010: [ transport_pool_acquire shall return the transport with the highest rendezvous hashing weight for device_id among the transports serving less than max_devices_per_transport devices (any transport when max_devices_per_transport is 0). ]*/
+TEST_FUNCTION(transport_pool_acquire_same_device_id_returns_same_transport)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE transport_pool = create_transport_pool(0);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    TRANSPORT_HANDLE result1 = transport_pool_acquire(transport_pool, TEST_DEVICE_ID);
+    TRANSPORT_HANDLE result2 = transport_pool_acquire(transport_pool, TEST_DEVICE_ID);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result1);
+    ASSERT_ARE_EQUAL(void_ptr, result1, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    transport_pool_destroy(transport_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_010: [ transport_pool_acquire shall return the transport with the highest rendezvous hashing weight for device_id among the transports serving less than max_devices_per_transport devices (any transport when max_devices_per_transport is 0). ]*/
+TEST_FUNCTION(transport_pool_acquire_spreads_devices_across_transports)
+{
+    // arrange
+    size_t device_counts[TEST_TRANSPORT_COUNT] = { 0 };
+    size_t i;
+    TRANSPORT_POOL_HANDLE transport_pool = create_transport_pool(0);
+
+    // act
+    for (i = 0; i < 60; i++)
+    {
+        char device_id[32];
+        TRANSPORT_HANDLE transport;
+        (void)sprintf(device_id, "device_%lu", (unsigned long)i);
+        transport = transport_pool_acquire(transport_pool, device_id);
+        ASSERT_IS_NOT_NULL(transport);
+        device_counts[(size_t)transport - 0x4301]++;
+    }
+
+    // assert
+    for (i = 0; i < TEST_TRANSPORT_COUNT; i++)
+    {
+        ASSERT_ARE_NOT_EQUAL(size_t, 0, device_counts[i]);
+    }
+
+    // cleanup
+    transport_pool_destroy(transport_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_010: [ transport_pool_acquire shall return the transport with the highest rendezvous hashing weight for device_id among the transports serving less than max_devices_per_transport devices (any transport when max_devices_per_transport is 0). ]*/
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_011: [ If all the transports serve max_devices_per_transport devices, transport_pool_acquire shall fail and return NULL. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_012: [ transport_pool_acquire shall count the device on the returned transport. ]*/
+TEST_FUNCTION(transport_pool_acquire_skips_full_transports)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE transport_pool = create_transport_pool(1);
+
+    // act
+    TRANSPORT_HANDLE result1 = transport_pool_acquire(transport_pool, TEST_DEVICE_ID);
+    TRANSPORT_HANDLE result2 = transport_pool_acquire(transport_pool, TEST_DEVICE_ID);
+    TRANSPORT_HANDLE result3 = transport_pool_acquire(transport_pool, TEST_DEVICE_ID);
+    TRANSPORT_HANDLE result4 = transport_pool_acquire(transport_pool, TEST_DEVICE_ID);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result1);
+    ASSERT_IS_NOT_NULL(result2);
+    ASSERT_IS_NOT_NULL(result3);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, result1, result2);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, result1, result3);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, result2, result3);
+    ASSERT_IS_NULL(result4);
+
+    // cleanup
+    transport_pool_destroy(transport_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_013: [ If transport_pool or transport is NULL, transport_pool_release shall return. ]*/
+TEST_FUNCTION(transport_pool_release_NULL_transport_pool_returns)
+{
+    // arrange
+
+    // act
+    transport_pool_release(NULL, (TRANSPORT_HANDLE)0x4301);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_014: [ If transport is not a transport of the pool with devices acquired on it, transport_pool_release shall return. ]*/
+TEST_FUNCTION(transport_pool_release_unknown_transport_does_not_free_a_slot)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE transport_pool = create_transport_pool(1);
+    size_t i;
+    for (i = 0; i < TEST_TRANSPORT_COUNT; i++)
+    {
+        ASSERT_IS_NOT_NULL(transport_pool_acquire(transport_pool, TEST_DEVICE_ID));
+    }
+
+    // act
+    transport_pool_release(transport_pool, TEST_UNKNOWN_TRANSPORT_HANDLE);
+
+    // assert
+    ASSERT_IS_NULL(transport_pool_acquire(transport_pool, TEST_DEVICE_ID));
+
+    // cleanup
+    transport_pool_destroy(transport_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TRANSPORT_POOL_41_015: [ transport_pool_release shall stop counting one device on transport. ]*/
+TEST_FUNCTION(transport_pool_release_frees_a_slot_on_the_transport)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE transport_pool = create_transport_pool(1);
+    TRANSPORT_HANDLE released;
+    size_t i;
+    for (i = 0; i < TEST_TRANSPORT_COUNT - 1; i++)
+    {
+        ASSERT_IS_NOT_NULL(transport_pool_acquire(transport_pool, TEST_DEVICE_ID));
+    }
+    released = transport_pool_acquire(transport_pool, TEST_DEVICE_ID);
+    ASSERT_IS_NOT_NULL(released);
+
+    // act
+    transport_pool_release(transport_pool, released);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, released, transport_pool_acquire(transport_pool, TEST_DEVICE_ID));
+
+    // cleanup
+    transport_pool_destroy(transport_pool);
+}
+
+END_TEST_SUITE(iothub_client_transport_pool_ut)
@@ -0,0 +1,460 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_twin_cache.h"
+
+/*parson is not mocked, the documents are really parsed and serialized*/
+static const char* TEST_FILE_NAME = "iothub_client_twin_cache_ut.json";
+
+static const char* TEST_DOCUMENT = "{\"desired\":{\"a\":1,\"b\":{\"x\":1,\"y\":2},\"$version\":3},\"reported\":{\"r\":1,\"$version\":7}}";
+
+static TWIN_CACHE_RESULT update(TWIN_CACHE_HANDLE twin_cache, DEVICE_TWIN_UPDATE_STATE update_state, const char* json, char** patch)
+{
+    return twin_cache_update(twin_cache, update_state, (const unsigned char*)json, strlen(json), patch);
+}
+
+static TWIN_CACHE_HANDLE create_with_document(const char* file_name)
+{
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE result = twin_cache_create(file_name);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, update(result, DEVICE_TWIN_UPDATE_COMPLETE, TEST_DOCUMENT, &patch));
+    ASSERT_IS_NULL(patch);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_twin_cache_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+    (void)remove(TEST_FILE_NAME);
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    (void)remove(TEST_FILE_NAME);
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_001: [ twin_cache_create shall allocate an empty cache and return it, NULL if any error occurs. ]*/
+TEST_FUNCTION(twin_cache_create_succeeds)
+{
+    // arrange
+    TWIN_CACHE_HANDLE result;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    result = twin_cache_create(NULL);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    twin_cache_destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_001: [ twin_cache_create shall allocate an empty cache and return it, NULL if any error occurs. ]*/
+TEST_FUNCTION(twin_cache_create_malloc_fails)
+{
+    // arrange
+    TWIN_CACHE_HANDLE result;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    result = twin_cache_create(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_001: [ twin_cache_create shall allocate an empty cache and return it, NULL if any error occurs. ]*/
+TEST_FUNCTION(twin_cache_create_copying_the_file_name_fails)
+{
+    // arrange
+    TWIN_CACHE_HANDLE result;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_FILE_NAME) + 1))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    result = twin_cache_create(TEST_FILE_NAME);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_003: [ If twin_cache is NULL, twin_cache_destroy shall do nothing. ]*/
+TEST_FUNCTION(twin_cache_destroy_NULL_does_nothing)
+{
+    // act
+    twin_cache_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_005: [ If twin_cache, payLoad or patch is NULL or size is 0, twin_cache_update shall return TWIN_CACHE_DELIVER. ]*/
+TEST_FUNCTION(twin_cache_update_NULL_twin_cache_delivers)
+{
+    // arrange
+    char* patch = NULL;
+
+    // act
+    TWIN_CACHE_RESULT result = update(NULL, DEVICE_TWIN_UPDATE_COMPLETE, TEST_DOCUMENT, &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, result);
+    ASSERT_IS_NULL(patch);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_005: [ If twin_cache, payLoad or patch is NULL or size is 0, twin_cache_update shall return TWIN_CACHE_DELIVER. ]*/
+TEST_FUNCTION(twin_cache_update_size_0_delivers)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = twin_cache_create(NULL);
+    TWIN_CACHE_RESULT result;
+    umock_c_reset_all_calls();
+
+    // act
+    result = twin_cache_update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)TEST_DOCUMENT, 0, &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_012: [ If payLoad is not a JSON object or any error occurs, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+TEST_FUNCTION(twin_cache_update_not_JSON_empties_the_cache)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(NULL);
+
+    // act
+    TWIN_CACHE_RESULT result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":", &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, result);
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, TEST_DOCUMENT, &patch));
+    ASSERT_IS_NULL(patch);
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_007: [ If the cache is empty, twin_cache_update shall store the desired properties of the document and return TWIN_CACHE_DELIVER. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_008: [ If the desired $version of the document is the one of the cache, twin_cache_update shall return TWIN_CACHE_SKIP. ]*/
+TEST_FUNCTION(twin_cache_update_same_desired_version_skips)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(NULL);
+
+    // act
+    TWIN_CACHE_RESULT result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":{\"a\":1,\"b\":{\"x\":1,\"y\":2},\"$version\":3},\"reported\":{\"r\":2,\"$version\":8}}", &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_SKIP, result);
+    ASSERT_IS_NULL(patch);
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_009: [ Otherwise twin_cache_update shall set *patch to a JSON merge patch setting every desired property that differs from the cache, null for the ones that are gone, and $version to the one of the document, replace the cache with the desired properties of the document and return TWIN_CACHE_DELIVER_PATCH. ]*/
+TEST_FUNCTION(twin_cache_update_new_desired_version_delivers_the_changes)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(NULL);
+
+    // act
+    TWIN_CACHE_RESULT result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":{\"b\":{\"x\":1,\"y\":3},\"c\":true,\"$version\":5},\"reported\":{\"$version\":7}}", &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER_PATCH, result);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"b\":{\"y\":3},\"c\":true,\"a\":null,\"$version\":5}", patch);
+
+    // cleanup
+    twin_cache_free_patch(patch);
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_009: [ Otherwise twin_cache_update shall set *patch to a JSON merge patch setting every desired property that differs from the cache, null for the ones that are gone, and $version to the one of the document, replace the cache with the desired properties of the document and return TWIN_CACHE_DELIVER_PATCH. ]*/
+TEST_FUNCTION(twin_cache_update_compares_the_next_document_with_the_new_one)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(NULL);
+    TWIN_CACHE_RESULT result;
+    (void)update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":{\"a\":2,\"$version\":4}}", &patch);
+    twin_cache_free_patch(patch);
+    patch = NULL;
+
+    // act
+    result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":{\"a\":2,\"$version\":4}}", &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_SKIP, result);
+    ASSERT_IS_NULL(patch);
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_006: [ If the document has no desired properties with a $version, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+TEST_FUNCTION(twin_cache_update_without_desired_version_empties_the_cache)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(NULL);
+    TWIN_CACHE_RESULT result;
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":{\"a\":1}}", &patch));
+
+    // act
+    result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, TEST_DOCUMENT, &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, result);
+    ASSERT_IS_NULL(patch);
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_010: [ If update_state is DEVICE_TWIN_UPDATE_PARTIAL and the cache is empty, the patch has no $version or its $version is more than one after the one of the cache, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+TEST_FUNCTION(twin_cache_update_patch_with_an_empty_cache_delivers)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = twin_cache_create(NULL);
+    TWIN_CACHE_RESULT result;
+
+    // act
+    result = update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, "{\"a\":2,\"$version\":4}", &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, result);
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, TEST_DOCUMENT, &patch));
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_013: [ Otherwise twin_cache_update shall apply the patch to the cache and return TWIN_CACHE_DELIVER. ]*/
+TEST_FUNCTION(twin_cache_update_applies_the_next_patch)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(NULL);
+    TWIN_CACHE_RESULT result;
+
+    // act
+    result = update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, "{\"a\":null,\"b\":{\"y\":3},\"c\":{\"z\":1,\"w\":null},\"$version\":4}", &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, result);
+    ASSERT_IS_NULL(patch);
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_SKIP, update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":{\"b\":{\"x\":1,\"y\":3},\"c\":{\"z\":1},\"$version\":4}}", &patch));
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_011: [ If the $version of the patch is not after the one of the cache, twin_cache_update shall return TWIN_CACHE_SKIP. ]*/
+TEST_FUNCTION(twin_cache_update_patch_the_document_had_already_skips)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(NULL);
+
+    // act
+    TWIN_CACHE_RESULT result = update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, "{\"a\":1,\"$version\":3}", &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_SKIP, result);
+    ASSERT_IS_NULL(patch);
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_010: [ If update_state is DEVICE_TWIN_UPDATE_PARTIAL and the cache is empty, the patch has no $version or its $version is more than one after the one of the cache, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+TEST_FUNCTION(twin_cache_update_after_a_missed_patch_delivers_the_next_document)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(NULL);
+    TWIN_CACHE_RESULT result;
+
+    // act
+    result = update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, "{\"a\":3,\"$version\":5}", &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, result);
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":{\"a\":3,\"$version\":5}}", &patch));
+    ASSERT_IS_NULL(patch);
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_002: [ If file_name is not NULL, twin_cache_create shall load the cache from the file, a file that does not exist or does not hold desired properties with a $version leaving the cache empty. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_004: [ twin_cache_destroy shall free the cache, leaving its file as it is. ]*/
+TEST_FUNCTION(twin_cache_create_loads_the_cache_from_the_file)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(TEST_FILE_NAME);
+    TWIN_CACHE_RESULT result;
+    (void)update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, "{\"a\":2,\"$version\":4}", &patch);
+    twin_cache_destroy(twin_cache);
+    twin_cache = twin_cache_create(TEST_FILE_NAME);
+
+    // act
+    result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, "{\"desired\":{\"a\":2,\"b\":{\"x\":1,\"y\":2},\"$version\":4}}", &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_SKIP, result);
+    ASSERT_IS_NULL(patch);
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_002: [ If file_name is not NULL, twin_cache_create shall load the cache from the file, a file that does not exist or does not hold desired properties with a $version leaving the cache empty. ]*/
+TEST_FUNCTION(twin_cache_create_ignores_a_truncated_file)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache;
+    TWIN_CACHE_RESULT result;
+    FILE* file = fopen(TEST_FILE_NAME, "w");
+    ASSERT_IS_NOT_NULL(file);
+    (void)fputs("{\"a\":1,\"$ver", file);
+    (void)fclose(file);
+    twin_cache = twin_cache_create(TEST_FILE_NAME);
+    ASSERT_IS_NOT_NULL(twin_cache);
+
+    // act
+    result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, TEST_DOCUMENT, &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, result);
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_TWIN_CACHE_41_012: [ If payLoad is not a JSON object or any error occurs, twin_cache_update shall empty the cache and return TWIN_CACHE_DELIVER. ]*/
+TEST_FUNCTION(twin_cache_update_malloc_fails)
+{
+    // arrange
+    char* patch = NULL;
+    TWIN_CACHE_HANDLE twin_cache = create_with_document(NULL);
+    const char* document = "{\"desired\":{\"a\":2,\"$version\":4}}";
+    TWIN_CACHE_RESULT result;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(document) + 1))
+        .SetReturn(NULL);
+
+    // act
+    result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, document, &patch);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, TWIN_CACHE_DELIVER, result);
+    ASSERT_IS_NULL(patch);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+END_TEST_SUITE(iothub_client_twin_cache_ut)
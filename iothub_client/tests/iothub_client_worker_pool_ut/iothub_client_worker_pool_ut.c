@@ -0,0 +1,569 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+
+MOCKABLE_FUNCTION(, unsigned int, test_work_function, void*, work_context);
+#undef ENABLE_MOCKS
+
+#include "iothub_client_worker_pool.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+
+    extern const size_t WorkerPool_ThreadTerminationOffset;
+#ifdef __cplusplus
+}
+#endif
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#define TEST_THREAD_COUNT 2
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4241;
+static COND_HANDLE TEST_COND_HANDLE = (COND_HANDLE)0x4242;
+static TICK_COUNTER_HANDLE TEST_TICK_COUNTER_HANDLE = (TICK_COUNTER_HANDLE)0x4243;
+static THREAD_HANDLE TEST_THREAD_HANDLE = (THREAD_HANDLE)0x4244;
+static void* TEST_WORK_CONTEXT = (void*)0x4245;
+
+static THREAD_START_FUNC g_thread_func;
+static void* g_thread_func_arg;
+static tickcounter_ms_t g_current_ms;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = TEST_THREAD_HANDLE;
+    g_thread_func = func;
+    g_thread_func_arg = arg;
+    return THREADAPI_OK;
+}
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static void stop_worker_thread(void)
+{
+    *(int*)(((char*)g_thread_func_arg) + WorkerPool_ThreadTerminationOffset) = 1;
+}
+
+static unsigned int my_test_work_function(void* work_context)
+{
+    (void)work_context;
+    stop_worker_thread();
+    return 5;
+}
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    stop_worker_thread();
+    return COND_TIMEOUT;
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static void set_expected_calls_for_create(size_t thread_count)
+{
+    size_t i;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(gballoc_malloc(thread_count * sizeof(THREAD_HANDLE)));
+    for (i = 0; i < thread_count; i++)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+}
+
+BEGIN_TEST_SUITE(iothub_client_worker_pool_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+
+    REGISTER_GLOBAL_MOCK_HOOK(test_work_function, my_test_work_function);
+
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+    g_thread_func = NULL;
+    g_thread_func_arg = NULL;
+    g_current_ms = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_001: [ If thread_count is 0, worker_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(worker_pool_create_thread_count_0_fails)
+{
+    // arrange
+
+    // act
+    WORKER_POOL_HANDLE result = worker_pool_create(0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_002: [ worker_pool_create shall allocate memory for the worker pool, create a lock, two conditions and a tick counter. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_004: [ worker_pool_create shall start thread_count worker threads. ]*/
+TEST_FUNCTION(worker_pool_create_succeeds)
+{
+    // arrange
+    set_expected_calls_for_create(TEST_THREAD_COUNT);
+
+    // act
+    WORKER_POOL_HANDLE result = worker_pool_create(TEST_THREAD_COUNT);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    worker_pool_destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_003: [ If any of the resources cannot be created, worker_pool_create shall free everything it allocated and return NULL. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_005: [ If starting any of the threads fails, worker_pool_create shall stop the threads already started, free all resources and return NULL. ]*/
+TEST_FUNCTION(worker_pool_create_negative_tests)
+{
+    // arrange
+    size_t i;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_expected_calls_for_create(TEST_THREAD_COUNT);
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        /*DList_InitializeListHead cannot fail*/
+        if (i == 1)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        WORKER_POOL_HANDLE result = worker_pool_create(TEST_THREAD_COUNT);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, "worker_pool_create was expected to fail");
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_006: [ If worker_pool is NULL, worker_pool_destroy shall return. ]*/
+TEST_FUNCTION(worker_pool_destroy_NULL_returns)
+{
+    // arrange
+
+    // act
+    worker_pool_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_007: [ worker_pool_destroy shall signal all worker threads to stop, join them and free all the resources of the pool, including the items that were not removed. ]*/
+TEST_FUNCTION(worker_pool_destroy_joins_threads_and_frees_resources)
+{
+    // arrange
+    WORKER_POOL_HANDLE worker_pool = worker_pool_create(TEST_THREAD_COUNT);
+    (void)worker_pool_add(worker_pool, test_work_function, TEST_WORK_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    worker_pool_destroy(worker_pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_012: [ If worker_pool or work_function are NULL, worker_pool_add shall fail and return NULL. ]*/
+TEST_FUNCTION(worker_pool_add_NULL_worker_pool_fails)
+{
+    // arrange
+
+    // act
+    WORKER_POOL_ITEM_HANDLE result = worker_pool_add(NULL, test_work_function, TEST_WORK_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_012: [ If worker_pool or work_function are NULL, worker_pool_add shall fail and return NULL. ]*/
+TEST_FUNCTION(worker_pool_add_NULL_work_function_fails)
+{
+    // arrange
+    WORKER_POOL_HANDLE worker_pool = worker_pool_create(TEST_THREAD_COUNT);
+    umock_c_reset_all_calls();
+
+    // act
+    WORKER_POOL_ITEM_HANDLE result = worker_pool_add(worker_pool, NULL, TEST_WORK_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    worker_pool_destroy(worker_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_014: [ worker_pool_add shall add the item to the pool as due immediately and wake up a worker thread. ]*/
+TEST_FUNCTION(worker_pool_add_succeeds)
+{
+    // arrange
+    WORKER_POOL_HANDLE worker_pool = worker_pool_create(TEST_THREAD_COUNT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    WORKER_POOL_ITEM_HANDLE result = worker_pool_add(worker_pool, test_work_function, TEST_WORK_CONTEXT);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    worker_pool_remove(result);
+    worker_pool_destroy(worker_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_013: [ If allocating the item fails, worker_pool_add shall fail and return NULL. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_015: [ If acquiring the pool lock fails, worker_pool_add shall fail and return NULL. ]*/
+TEST_FUNCTION(worker_pool_add_negative_tests)
+{
+    // arrange
+    WORKER_POOL_HANDLE worker_pool = worker_pool_create(TEST_THREAD_COUNT);
+    umock_c_reset_all_calls();
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        WORKER_POOL_ITEM_HANDLE result = worker_pool_add(worker_pool, test_work_function, TEST_WORK_CONTEXT);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, "worker_pool_add was expected to fail");
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    worker_pool_destroy(worker_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_016: [ If item is NULL, worker_pool_schedule shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(worker_pool_schedule_NULL_item_fails)
+{
+    // arrange
+
+    // act
+    int result = worker_pool_schedule(NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_017: [ worker_pool_schedule shall make the item due immediately, wake up a worker thread and return 0. ]*/
+TEST_FUNCTION(worker_pool_schedule_succeeds)
+{
+    // arrange
+    WORKER_POOL_HANDLE worker_pool = worker_pool_create(TEST_THREAD_COUNT);
+    WORKER_POOL_ITEM_HANDLE item = worker_pool_add(worker_pool, test_work_function, TEST_WORK_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    int result = worker_pool_schedule(item);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    worker_pool_remove(item);
+    worker_pool_destroy(worker_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_018: [ If acquiring the pool lock fails, worker_pool_schedule shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(worker_pool_schedule_Lock_fails)
+{
+    // arrange
+    WORKER_POOL_HANDLE worker_pool = worker_pool_create(TEST_THREAD_COUNT);
+    WORKER_POOL_ITEM_HANDLE item = worker_pool_add(worker_pool, test_work_function, TEST_WORK_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    int result = worker_pool_schedule(item);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    worker_pool_remove(item);
+    worker_pool_destroy(worker_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_019: [ If item is NULL, worker_pool_remove shall return. ]*/
+TEST_FUNCTION(worker_pool_remove_NULL_returns)
+{
+    // arrange
+
+    // act
+    worker_pool_remove(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_020: [ worker_pool_remove shall wait for the work function of the item to return if it is running, remove the item from the pool and free it. ]*/
+TEST_FUNCTION(worker_pool_remove_succeeds)
+{
+    // arrange
+    WORKER_POOL_HANDLE worker_pool = worker_pool_create(TEST_THREAD_COUNT);
+    WORKER_POOL_ITEM_HANDLE item = worker_pool_add(worker_pool, test_work_function, TEST_WORK_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(item));
+
+    // act
+    worker_pool_remove(item);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    worker_pool_destroy(worker_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_010: [ The worker thread shall mark the item as running, so that no other worker thread runs it, and call its work function without holding the pool lock. ]*/
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_011: [ When the work function returns, the item shall be due again after the number of milliseconds returned, or immediately if worker_pool_schedule was called while it was running. ]*/
+TEST_FUNCTION(worker_pool_thread_runs_due_item_without_the_lock)
+{
+    // arrange
+    WORKER_POOL_HANDLE worker_pool = worker_pool_create(1);
+    WORKER_POOL_ITEM_HANDLE item = worker_pool_add(worker_pool, test_work_function, TEST_WORK_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(test_work_function(TEST_WORK_CONTEXT));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    worker_pool_remove(item);
+    worker_pool_destroy(worker_pool);
+}
+
+/* Tests_SRS_IOTHUB_CLIENT_WORKER_POOL_41_009: [ When no item is due, the worker thread shall wait until the earliest due time or until worker_pool_schedule is called. ]*/
+TEST_FUNCTION(worker_pool_thread_waits_until_the_earliest_due_time)
+{
+    // arrange
+    WORKER_POOL_HANDLE worker_pool = worker_pool_create(1);
+    WORKER_POOL_ITEM_HANDLE item = worker_pool_add(worker_pool, test_work_function, TEST_WORK_CONTEXT);
+    (void)g_thread_func(g_thread_func_arg); /*runs the item once, next due time is 5 ms from now*/
+    *(int*)(((char*)g_thread_func_arg) + WorkerPool_ThreadTerminationOffset) = 0;
+    umock_c_reset_all_calls();
+
+    g_current_ms = 2;
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 3));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    worker_pool_remove(item);
+    worker_pool_destroy(worker_pool);
+}
+
+END_TEST_SUITE(iothub_client_worker_pool_ut)
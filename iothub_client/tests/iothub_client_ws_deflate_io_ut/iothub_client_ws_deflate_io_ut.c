@@ -0,0 +1,781 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#include "zlib.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/optionhandler.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_options.h"
+#include "iothub_client_ws_deflate_io.h"
+
+#define TEST_UNDERLYING_IO                  (XIO_HANDLE)0x41
+#define TEST_UNDERLYING_INTERFACE           (const IO_INTERFACE_DESCRIPTION*)0x42
+#define TEST_UNDERLYING_PARAMETERS          (void*)0x43
+#define TEST_OPTIONHANDLER_HANDLE           (OPTIONHANDLER_HANDLE)0x44
+#define TEST_UNDERLYING_OPTIONHANDLER       (OPTIONHANDLER_HANDLE)0x45
+#define TEST_OPTION_NAME                    "TrustedCerts"
+#define TEST_OPTION_VALUE                   (const void*)0x46
+#define TEST_PAYLOAD_SIZE                   200
+#define TEST_BUFFER_SIZE                    4096
+
+static const char TEST_UPGRADE_REQUEST[] = "GET /$iothub/websocket HTTP/1.1\r\nHost: test.azure-devices.net\r\n\r\n";
+static const char TEST_UPGRADE_RESPONSE[] = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n\r\n";
+static const char TEST_DEFLATE_RESPONSE[] = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nsec-websocket-extensions: permessage-deflate; client_max_window_bits=12\r\n\r\n";
+static const unsigned char TEST_MASK[4] = { 0x11, 0x22, 0x33, 0x44 };
+
+/*the underlying IO is mocked, zlib is not: the frames sent are really inflated back to be checked*/
+static ON_BYTES_RECEIVED g_on_underlying_bytes_received;
+static void* g_on_underlying_bytes_received_context;
+static unsigned char g_sent[TEST_BUFFER_SIZE];
+static size_t g_sent_size;
+static unsigned char g_received[TEST_BUFFER_SIZE];
+static size_t g_received_size;
+static size_t g_on_io_error_count;
+static size_t g_on_send_complete_count;
+static unsigned char g_payload[TEST_PAYLOAD_SIZE];
+
+static int my_xio_open(XIO_HANDLE xio, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+    (void)xio;
+    (void)on_io_open_complete;
+    (void)on_io_open_complete_context;
+    (void)on_io_error;
+    (void)on_io_error_context;
+    g_on_underlying_bytes_received = on_bytes_received;
+    g_on_underlying_bytes_received_context = on_bytes_received_context;
+    return 0;
+}
+
+static int my_xio_send(XIO_HANDLE xio, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    (void)xio;
+    (void)on_send_complete;
+    (void)callback_context;
+    if (g_sent_size + size <= sizeof(g_sent))
+    {
+        (void)memcpy(g_sent + g_sent_size, buffer, size);
+        g_sent_size += size;
+    }
+    return 0;
+}
+
+static void test_on_bytes_received(void* context, const unsigned char* buffer, size_t size)
+{
+    (void)context;
+    if (g_received_size + size <= sizeof(g_received))
+    {
+        (void)memcpy(g_received + g_received_size, buffer, size);
+        g_received_size += size;
+    }
+}
+
+static void test_on_io_error(void* context)
+{
+    (void)context;
+    g_on_io_error_count++;
+}
+
+static void test_on_send_complete(void* context, IO_SEND_RESULT send_result)
+{
+    (void)context;
+    if (send_result == IO_SEND_OK)
+    {
+        g_on_send_complete_count++;
+    }
+}
+
+static const IO_INTERFACE_DESCRIPTION* ws_deflate_io(void)
+{
+    return ws_deflate_io_get_interface_description();
+}
+
+static CONCRETE_IO_HANDLE create_and_open(int level)
+{
+    WS_DEFLATE_IO_CONFIG config = { TEST_UNDERLYING_INTERFACE, TEST_UNDERLYING_PARAMETERS };
+    IOTHUB_WEBSOCKET_DEFLATE_OPTIONS options = { 0, 15, 0, false, 16 };
+    CONCRETE_IO_HANDLE result = ws_deflate_io()->concrete_io_create(&config);
+
+    options.level = level;
+    (void)ws_deflate_io()->concrete_io_setoption(result, OPTION_WEBSOCKET_DEFLATE, &options);
+    (void)ws_deflate_io()->concrete_io_open(result, NULL, NULL, test_on_bytes_received, NULL, test_on_io_error, NULL);
+    return result;
+}
+
+static CONCRETE_IO_HANDLE create_and_upgrade(int level, const char* response)
+{
+    CONCRETE_IO_HANDLE result = create_and_open(level);
+    (void)ws_deflate_io()->concrete_io_send(result, TEST_UPGRADE_REQUEST, sizeof(TEST_UPGRADE_REQUEST) - 1, NULL, NULL);
+    g_on_underlying_bytes_received(g_on_underlying_bytes_received_context, (const unsigned char*)response, strlen(response));
+    g_sent_size = 0;
+    g_received_size = 0;
+    umock_c_reset_all_calls();
+    return result;
+}
+
+/*a frame as the WebSocket IO of the client sends it: masked*/
+static size_t make_masked_frame(unsigned char* frame, unsigned char first_byte, const unsigned char* payload, size_t payload_size)
+{
+    size_t i;
+    size_t size = 0;
+    frame[size++] = first_byte;
+    if (payload_size < 126)
+    {
+        frame[size++] = 0x80 | (unsigned char)payload_size;
+    }
+    else
+    {
+        frame[size++] = 0x80 | 126;
+        frame[size++] = (unsigned char)(payload_size >> 8);
+        frame[size++] = (unsigned char)payload_size;
+    }
+    (void)memcpy(frame + size, TEST_MASK, sizeof(TEST_MASK));
+    size += sizeof(TEST_MASK);
+    for (i = 0; i < payload_size; i++)
+    {
+        frame[size++] = payload[i] ^ TEST_MASK[i % 4];
+    }
+    return size;
+}
+
+/*inflates a masked frame of one deflated message sent to the hub, *header_first_byte gets its first byte*/
+static size_t inflate_sent_frame(unsigned char* header_first_byte, unsigned char* inflated, size_t inflated_capacity)
+{
+    unsigned char deflated[TEST_BUFFER_SIZE];
+    size_t header_size = ((g_sent[1] & 0x7F) == 126) ? 4 : 2;
+    size_t payload_size = ((g_sent[1] & 0x7F) == 126) ? (((size_t)g_sent[2] << 8) | g_sent[3]) : (size_t)(g_sent[1] & 0x7F);
+    const unsigned char* mask = g_sent + header_size;
+    size_t i;
+    size_t result;
+    z_stream stream;
+
+    *header_first_byte = g_sent[0];
+    for (i = 0; i < payload_size; i++)
+    {
+        deflated[i] = g_sent[header_size + 4 + i] ^ mask[i % 4];
+    }
+    (void)memcpy(deflated + payload_size, "\x00\x00\xff\xff", 4);
+
+    (void)memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -15) != Z_OK)
+    {
+        result = 0;
+    }
+    else
+    {
+        stream.next_in = deflated;
+        stream.avail_in = (uInt)(payload_size + 4);
+        stream.next_out = inflated;
+        stream.avail_out = (uInt)inflated_capacity;
+        (void)inflate(&stream, Z_SYNC_FLUSH);
+        result = (size_t)stream.total_out;
+        (void)inflateEnd(&stream);
+    }
+    return result;
+}
+
+/*a frame as the hub sends it: unmasked, RSV1 set and the payload deflated without its sync flush tail*/
+static size_t make_deflated_server_frame(unsigned char* frame, const unsigned char* payload, size_t payload_size)
+{
+    unsigned char deflated[TEST_BUFFER_SIZE];
+    size_t deflated_size;
+    size_t size = 0;
+    z_stream stream;
+
+    (void)memset(&stream, 0, sizeof(stream));
+    (void)deflateInit2(&stream, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    stream.next_in = (Bytef*)payload;
+    stream.avail_in = (uInt)payload_size;
+    stream.next_out = deflated;
+    stream.avail_out = (uInt)sizeof(deflated);
+    (void)deflate(&stream, Z_SYNC_FLUSH);
+    deflated_size = sizeof(deflated) - stream.avail_out - 4;
+    (void)deflateEnd(&stream);
+
+    frame[size++] = 0xC2;
+    frame[size++] = (unsigned char)deflated_size;
+    (void)memcpy(frame + size, deflated, deflated_size);
+    return size + deflated_size;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_ws_deflate_io_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(pfCloneOption, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(pfDestroyOption, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(pfSetOption, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_OPEN_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_CLOSE_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_ERROR, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_BYTES_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SEND_COMPLETE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(xio_create, TEST_UNDERLYING_IO);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(xio_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(xio_open, my_xio_open);
+    REGISTER_GLOBAL_MOCK_HOOK(xio_send, my_xio_send);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_setoption, 0);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_close, 0);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_retrieveoptions, TEST_UNDERLYING_OPTIONHANDLER);
+    REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_Create, TEST_OPTIONHANDLER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_Create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_AddOption, OPTIONHANDLER_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_AddOption, OPTIONHANDLER_ERROR);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    size_t i;
+
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    /*a payload that deflates well*/
+    for (i = 0; i < TEST_PAYLOAD_SIZE; i++)
+    {
+        g_payload[i] = (unsigned char)('a' + (i % 5));
+    }
+    g_on_underlying_bytes_received = NULL;
+    g_on_underlying_bytes_received_context = NULL;
+    g_sent_size = 0;
+    g_received_size = 0;
+    g_on_io_error_count = 0;
+    g_on_send_complete_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_001: [ If io_create_parameters or its underlying_io_interface is NULL, ws_deflate_io_create shall fail and return NULL. ]*/
+TEST_FUNCTION(ws_deflate_io_create_with_NULL_parameters_fails)
+{
+    //arrange
+
+    //act
+    CONCRETE_IO_HANDLE result = ws_deflate_io()->concrete_io_create(NULL);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_001: [ If io_create_parameters or its underlying_io_interface is NULL, ws_deflate_io_create shall fail and return NULL. ]*/
+TEST_FUNCTION(ws_deflate_io_create_with_NULL_underlying_interface_fails)
+{
+    //arrange
+    WS_DEFLATE_IO_CONFIG config = { NULL, TEST_UNDERLYING_PARAMETERS };
+
+    //act
+    CONCRETE_IO_HANDLE result = ws_deflate_io()->concrete_io_create(&config);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_002: [ ws_deflate_io_create shall create the underlying IO with xio_create and the underlying_io_interface and underlying_io_parameters of io_create_parameters, and shall not offer permessage-deflate until OPTION_WEBSOCKET_DEFLATE is set with a level. ]*/
+TEST_FUNCTION(ws_deflate_io_create_creates_the_underlying_io)
+{
+    //arrange
+    WS_DEFLATE_IO_CONFIG config = { TEST_UNDERLYING_INTERFACE, TEST_UNDERLYING_PARAMETERS };
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_create(TEST_UNDERLYING_INTERFACE, TEST_UNDERLYING_PARAMETERS));
+
+    //act
+    CONCRETE_IO_HANDLE result = ws_deflate_io()->concrete_io_create(&config);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(result);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_001: [ If io_create_parameters or its underlying_io_interface is NULL, ws_deflate_io_create shall fail and return NULL. ]*/
+TEST_FUNCTION(ws_deflate_io_create_fails_when_xio_create_fails)
+{
+    //arrange
+    WS_DEFLATE_IO_CONFIG config = { TEST_UNDERLYING_INTERFACE, TEST_UNDERLYING_PARAMETERS };
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_create(TEST_UNDERLYING_INTERFACE, TEST_UNDERLYING_PARAMETERS))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    CONCRETE_IO_HANDLE result = ws_deflate_io()->concrete_io_create(&config);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_014: [ If ws_deflate_io is NULL, ws_deflate_io_destroy shall do nothing, otherwise it shall destroy the underlying IO, end the deflate and inflate streams and free the instance. ]*/
+TEST_FUNCTION(ws_deflate_io_destroy_destroys_the_underlying_io)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open(0);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_destroy(TEST_UNDERLYING_IO));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(io));
+
+    //act
+    ws_deflate_io()->concrete_io_destroy(io);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_015: [ ws_deflate_io_open shall forget what the previous connection negotiated and open the underlying IO with xio_open, the bytes it receives going through ws_deflate_io before on_bytes_received. ]*/
+TEST_FUNCTION(ws_deflate_io_open_opens_the_underlying_io)
+{
+    //arrange
+    WS_DEFLATE_IO_CONFIG config = { TEST_UNDERLYING_INTERFACE, TEST_UNDERLYING_PARAMETERS };
+    CONCRETE_IO_HANDLE io = ws_deflate_io()->concrete_io_create(&config);
+    int result;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(xio_open(TEST_UNDERLYING_IO, NULL, NULL, IGNORED_PTR_ARG, io, test_on_io_error, NULL));
+
+    //act
+    result = ws_deflate_io()->concrete_io_open(io, NULL, NULL, test_on_bytes_received, NULL, test_on_io_error, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_016: [ ws_deflate_io_close and ws_deflate_io_dowork shall call xio_close and xio_dowork on the underlying IO. ]*/
+TEST_FUNCTION(ws_deflate_io_close_and_dowork_go_to_the_underlying_io)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open(0);
+    int result;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_dowork(TEST_UNDERLYING_IO));
+    STRICT_EXPECTED_CALL(xio_close(TEST_UNDERLYING_IO, NULL, NULL));
+
+    //act
+    ws_deflate_io()->concrete_io_dowork(io);
+    result = ws_deflate_io()->concrete_io_close(io, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_010: [ If optionName is OPTION_WEBSOCKET_DEFLATE, ws_deflate_io_setoption shall fail if value is NULL, level is not between 0 and 9, or, with a level, clientMaxWindowBits is not between 9 and 15, serverMaxWindowBits is neither 0 nor between 9 and 15, or the SDK is built without use_compression. ]*/
+TEST_FUNCTION(ws_deflate_io_setoption_with_invalid_deflate_options_fails)
+{
+    //arrange
+    WS_DEFLATE_IO_CONFIG config = { TEST_UNDERLYING_INTERFACE, TEST_UNDERLYING_PARAMETERS };
+    CONCRETE_IO_HANDLE io = ws_deflate_io()->concrete_io_create(&config);
+    IOTHUB_WEBSOCKET_DEFLATE_OPTIONS level_10 = { 10, 15, 0, false, 16 };
+    IOTHUB_WEBSOCKET_DEFLATE_OPTIONS client_window_8 = { 6, 8, 0, false, 16 };
+    IOTHUB_WEBSOCKET_DEFLATE_OPTIONS server_window_16 = { 6, 15, 16, false, 16 };
+    umock_c_reset_all_calls();
+
+    //act
+    int result_NULL = ws_deflate_io()->concrete_io_setoption(io, OPTION_WEBSOCKET_DEFLATE, NULL);
+    int result_level = ws_deflate_io()->concrete_io_setoption(io, OPTION_WEBSOCKET_DEFLATE, &level_10);
+    int result_client = ws_deflate_io()->concrete_io_setoption(io, OPTION_WEBSOCKET_DEFLATE, &client_window_8);
+    int result_server = ws_deflate_io()->concrete_io_setoption(io, OPTION_WEBSOCKET_DEFLATE, &server_window_16);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_NULL);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_level);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_client);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_server);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_011: [ Otherwise ws_deflate_io_setoption shall keep a copy of the options, used from the next ws_deflate_io_open, and return 0. ]*/
+TEST_FUNCTION(ws_deflate_io_setoption_keeps_the_deflate_options)
+{
+    //arrange
+    WS_DEFLATE_IO_CONFIG config = { TEST_UNDERLYING_INTERFACE, TEST_UNDERLYING_PARAMETERS };
+    CONCRETE_IO_HANDLE io = ws_deflate_io()->concrete_io_create(&config);
+    IOTHUB_WEBSOCKET_DEFLATE_OPTIONS options = { 6, 15, 0, false, 16 };
+    umock_c_reset_all_calls();
+
+    //act
+    int result = ws_deflate_io()->concrete_io_setoption(io, OPTION_WEBSOCKET_DEFLATE, &options);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_012: [ Any other option shall be given to the underlying IO with xio_setoption. ]*/
+TEST_FUNCTION(ws_deflate_io_setoption_gives_other_options_to_the_underlying_io)
+{
+    //arrange
+    WS_DEFLATE_IO_CONFIG config = { TEST_UNDERLYING_INTERFACE, TEST_UNDERLYING_PARAMETERS };
+    CONCRETE_IO_HANDLE io = ws_deflate_io()->concrete_io_create(&config);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_UNDERLYING_IO, TEST_OPTION_NAME, TEST_OPTION_VALUE));
+
+    //act
+    int result = ws_deflate_io()->concrete_io_setoption(io, TEST_OPTION_NAME, TEST_OPTION_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_013: [ ws_deflate_io_retrieveoptions shall return an OPTIONHANDLER_HANDLE with OPTION_WEBSOCKET_DEFLATE when it has a level, and the options of the underlying IO. ]*/
+TEST_FUNCTION(ws_deflate_io_retrieveoptions_returns_the_deflate_and_the_underlying_options)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open(6);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(OptionHandler_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO));
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, OPTION_WEBSOCKET_DEFLATE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, IGNORED_PTR_ARG, TEST_UNDERLYING_OPTIONHANDLER));
+    STRICT_EXPECTED_CALL(OptionHandler_Destroy(TEST_UNDERLYING_OPTIONHANDLER));
+
+    //act
+    OPTIONHANDLER_HANDLE result = ws_deflate_io()->concrete_io_retrieveoptions(io);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_OPTIONHANDLER_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_009: [ While permessage-deflate is not negotiated, ws_deflate_io shall send and receive the bytes as they are. ]*/
+TEST_FUNCTION(ws_deflate_io_without_a_level_sends_the_upgrade_request_as_it_is)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open(0);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(TEST_UPGRADE_REQUEST) - 1, test_on_send_complete, NULL));
+
+    //act
+    int result = ws_deflate_io()->concrete_io_send(io, TEST_UPGRADE_REQUEST, sizeof(TEST_UPGRADE_REQUEST) - 1, test_on_send_complete, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_UPGRADE_REQUEST, g_sent, sizeof(TEST_UPGRADE_REQUEST) - 1));
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_003: [ When a level is set, the first bytes sent after ws_deflate_io_open, the upgrade request of the WebSocket IO, shall be sent with a Sec-WebSocket-Extensions header offering permessage-deflate with client_max_window_bits, server_max_window_bits when serverMaxWindowBits is not 0, and client_no_context_takeover and server_no_context_takeover when noContextTakeover is set. ]*/
+TEST_FUNCTION(ws_deflate_io_with_a_level_offers_permessage_deflate_in_the_upgrade_request)
+{
+    //arrange
+    static const char expected[] = "GET /$iothub/websocket HTTP/1.1\r\nHost: test.azure-devices.net\r\nSec-WebSocket-Extensions: permessage-deflate; client_max_window_bits=15\r\n\r\n";
+    CONCRETE_IO_HANDLE io = create_and_open(6);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(expected) - 1, test_on_send_complete, NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    int result = ws_deflate_io()->concrete_io_send(io, TEST_UPGRADE_REQUEST, sizeof(TEST_UPGRADE_REQUEST) - 1, test_on_send_complete, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected) - 1, g_sent_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected, g_sent, sizeof(expected) - 1));
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_009: [ While permessage-deflate is not negotiated, ws_deflate_io shall send and receive the bytes as they are. ]*/
+TEST_FUNCTION(ws_deflate_io_sends_frames_as_they_are_when_the_hub_declines_permessage_deflate)
+{
+    //arrange
+    unsigned char frame[TEST_BUFFER_SIZE];
+    size_t frame_size = make_masked_frame(frame, 0x82, g_payload, TEST_PAYLOAD_SIZE);
+    CONCRETE_IO_HANDLE io = create_and_upgrade(6, TEST_UPGRADE_RESPONSE);
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, frame_size, test_on_send_complete, NULL));
+
+    //act
+    int result = ws_deflate_io()->concrete_io_send(io, frame, frame_size, test_on_send_complete, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(frame, g_sent, frame_size));
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_io_error_count);
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_004: [ When the upgrade response received ends, ws_deflate_io shall find out whether the hub accepted permessage-deflate from its Sec-WebSocket-Extensions header, with the window bits and context takeover it answers with, and start the deflate and inflate streams if it did. ]*/
+TEST_FUNCTION(ws_deflate_io_gives_the_upgrade_response_to_the_websocket_io)
+{
+    //arrange
+    CONCRETE_IO_HANDLE io = create_and_open(6);
+    (void)ws_deflate_io()->concrete_io_send(io, TEST_UPGRADE_REQUEST, sizeof(TEST_UPGRADE_REQUEST) - 1, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    //act
+    g_on_underlying_bytes_received(g_on_underlying_bytes_received_context, (const unsigned char*)TEST_DEFLATE_RESPONSE, 10);
+    g_on_underlying_bytes_received(g_on_underlying_bytes_received_context, (const unsigned char*)TEST_DEFLATE_RESPONSE + 10, sizeof(TEST_DEFLATE_RESPONSE) - 1 - 10);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_io_error_count);
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_DEFLATE_RESPONSE) - 1, g_received_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_DEFLATE_RESPONSE, g_received, g_received_size));
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_005: [ If the response cannot be parsed, accepts an extension or a parameter that was not offered, or the deflate and inflate streams cannot be started, ws_deflate_io shall report an error with the on_io_error callback. ]*/
+TEST_FUNCTION(ws_deflate_io_reports_an_error_when_the_response_has_an_unknown_parameter)
+{
+    //arrange
+    static const char response[] = "HTTP/1.1 101 Switching Protocols\r\nSec-WebSocket-Extensions: permessage-deflate; unknown_parameter\r\n\r\n";
+    CONCRETE_IO_HANDLE io = create_and_open(6);
+    (void)ws_deflate_io()->concrete_io_send(io, TEST_UPGRADE_REQUEST, sizeof(TEST_UPGRADE_REQUEST) - 1, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    //act
+    g_on_underlying_bytes_received(g_on_underlying_bytes_received_context, (const unsigned char*)response, sizeof(response) - 1);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_io_error_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_received_size);
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_006: [ Once permessage-deflate is negotiated, the data frames sent by the WebSocket IO shall be deflated with RSV1 set on the first frame of each message, except for the messages of one frame smaller than minimumSizeInBytes, which shall be sent as they are. ]*/
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_007: [ A deflated frame shall be masked with the mask of the frame it replaces, and the 4 bytes ending the deflate sync flush shall be taken out of the last frame of a message. ]*/
+TEST_FUNCTION(ws_deflate_io_deflates_the_frames_sent_once_negotiated)
+{
+    //arrange
+    unsigned char frame[TEST_BUFFER_SIZE];
+    unsigned char inflated[TEST_BUFFER_SIZE];
+    unsigned char first_byte;
+    size_t inflated_size;
+    size_t frame_size = make_masked_frame(frame, 0x82, g_payload, TEST_PAYLOAD_SIZE);
+    CONCRETE_IO_HANDLE io = create_and_upgrade(6, TEST_DEFLATE_RESPONSE);
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, IGNORED_NUM_ARG, test_on_send_complete, NULL));
+
+    //act
+    int result = ws_deflate_io()->concrete_io_send(io, frame, frame_size, test_on_send_complete, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(g_sent_size < frame_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_MASK, g_sent + 2, sizeof(TEST_MASK)));
+    inflated_size = inflate_sent_frame(&first_byte, inflated, sizeof(inflated));
+    ASSERT_ARE_EQUAL(int, 0xC2, first_byte);
+    ASSERT_ARE_EQUAL(size_t, TEST_PAYLOAD_SIZE, inflated_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(g_payload, inflated, TEST_PAYLOAD_SIZE));
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_006: [ Once permessage-deflate is negotiated, the data frames sent by the WebSocket IO shall be deflated with RSV1 set on the first frame of each message, except for the messages of one frame smaller than minimumSizeInBytes, which shall be sent as they are. ]*/
+TEST_FUNCTION(ws_deflate_io_sends_a_frame_split_in_two_sends_once_complete)
+{
+    //arrange
+    unsigned char frame[TEST_BUFFER_SIZE];
+    unsigned char inflated[TEST_BUFFER_SIZE];
+    unsigned char first_byte;
+    size_t frame_size = make_masked_frame(frame, 0x82, g_payload, TEST_PAYLOAD_SIZE);
+    CONCRETE_IO_HANDLE io = create_and_upgrade(6, TEST_DEFLATE_RESPONSE);
+
+    //act
+    int result_first = ws_deflate_io()->concrete_io_send(io, frame, 50, test_on_send_complete, NULL);
+    size_t sent_size_first = g_sent_size;
+    int result_second = ws_deflate_io()->concrete_io_send(io, frame + 50, frame_size - 50, test_on_send_complete, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result_first);
+    ASSERT_ARE_EQUAL(int, 0, result_second);
+    ASSERT_ARE_EQUAL(size_t, 0, sent_size_first);
+    /*the first send completes no frame, its callback is called right away*/
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_send_complete_count);
+    ASSERT_ARE_EQUAL(size_t, TEST_PAYLOAD_SIZE, inflate_sent_frame(&first_byte, inflated, sizeof(inflated)));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(g_payload, inflated, TEST_PAYLOAD_SIZE));
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_006: [ Once permessage-deflate is negotiated, the data frames sent by the WebSocket IO shall be deflated with RSV1 set on the first frame of each message, except for the messages of one frame smaller than minimumSizeInBytes, which shall be sent as they are. ]*/
+TEST_FUNCTION(ws_deflate_io_sends_a_small_message_as_it_is)
+{
+    //arrange
+    unsigned char frame[TEST_BUFFER_SIZE];
+    size_t frame_size = make_masked_frame(frame, 0x82, g_payload, 10);
+    CONCRETE_IO_HANDLE io = create_and_upgrade(6, TEST_DEFLATE_RESPONSE);
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, frame_size, test_on_send_complete, NULL));
+
+    //act
+    int result = ws_deflate_io()->concrete_io_send(io, frame, frame_size, test_on_send_complete, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(frame, g_sent, frame_size));
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_008: [ Once permessage-deflate is negotiated, the frames of the messages received with RSV1 set shall be inflated and given to the WebSocket IO unmasked, with RSV1 cleared; any other frame shall be given as it is. ]*/
+TEST_FUNCTION(ws_deflate_io_inflates_the_frames_received_once_negotiated)
+{
+    //arrange
+    static const unsigned char ping[] = { 0x89, 0x00 };
+    unsigned char frames[TEST_BUFFER_SIZE];
+    size_t frames_size = make_deflated_server_frame(frames, g_payload, TEST_PAYLOAD_SIZE);
+    CONCRETE_IO_HANDLE io = create_and_upgrade(6, TEST_DEFLATE_RESPONSE);
+    (void)memcpy(frames + frames_size, ping, sizeof(ping));
+    frames_size += sizeof(ping);
+
+    //act
+    g_on_underlying_bytes_received(g_on_underlying_bytes_received_context, frames, 3);
+    g_on_underlying_bytes_received(g_on_underlying_bytes_received_context, frames + 3, frames_size - 3);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_io_error_count);
+    ASSERT_ARE_EQUAL(size_t, 4 + TEST_PAYLOAD_SIZE + sizeof(ping), g_received_size);
+    ASSERT_ARE_EQUAL(int, 0x82, g_received[0]);
+    ASSERT_ARE_EQUAL(int, 126, g_received[1]);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(g_payload, g_received + 4, TEST_PAYLOAD_SIZE));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(ping, g_received + 4 + TEST_PAYLOAD_SIZE, sizeof(ping)));
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+/*Tests_SRS_IOTHUB_CLIENT_WS_DEFLATE_IO_41_008: [ Once permessage-deflate is negotiated, the frames of the messages received with RSV1 set shall be inflated and given to the WebSocket IO unmasked, with RSV1 cleared; any other frame shall be given as it is. ]*/
+TEST_FUNCTION(ws_deflate_io_reports_an_error_for_a_compressed_control_frame)
+{
+    //arrange
+    static const unsigned char compressed_ping[] = { 0xC9, 0x00 };
+    CONCRETE_IO_HANDLE io = create_and_upgrade(6, TEST_DEFLATE_RESPONSE);
+
+    //act
+    g_on_underlying_bytes_received(g_on_underlying_bytes_received_context, compressed_ping, sizeof(compressed_ping));
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_io_error_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_received_size);
+
+    //cleanup
+    ws_deflate_io()->concrete_io_destroy(io);
+}
+
+END_TEST_SUITE(iothub_client_ws_deflate_io_ut)
@@ -8,8 +8,12 @@
 
 #ifdef __cplusplus
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #else
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #endif
 
 static void* my_gballoc_malloc(size_t size)
@@ -40,6 +44,7 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
 #include "blob.h"
 #include "parson.h"
 
@@ -273,6 +278,7 @@ static const unsigned int FourHundred = 400;
 static unsigned char TestValid_BUFFER_u_char[] = { '3', '\0' };
 
 static char TEST_DEFAULT_STRING_VALUE[2] = { '3', '\0' };
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4241;
 
 BEGIN_TEST_SUITE(iothubclient_ll_uploadtoblob_ut)
 
@@ -300,6 +306,10 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(const unsigned char*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_CALLBACK, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
@@ -352,11 +362,16 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_ExecuteRequest, HTTPAPIEX_ERROR);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SetOption, HTTPAPIEX_ERROR);
 
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_UploadFromSasUri, BLOB_ERROR);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_UploadFromSasUri_Ex, BLOB_ERROR);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __FAILURE__);
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
 
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -746,7 +761,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SAS_token_happypath)
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -1042,7 +1057,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SAS_token_with_certificates_happypath
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, "some certificates"))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, "some certificates", 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -1476,7 +1491,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SAS_token_when_step2_httpStatusCode_i
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -1769,7 +1784,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SAS_token_when_step3_httpStatusCode_i
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -2072,7 +2087,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SAS_token_unhappypaths)
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -2527,7 +2542,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_deviceKey_happypath)
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -2962,7 +2977,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_deviceKey_when_step3_httpStatusCode_i
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -3280,7 +3295,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_deviceKey_unhappypaths)
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -3634,7 +3649,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_passes_x509_information_to_HTTPAPIEX_
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -3932,7 +3947,7 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_passes_x509_information_to_HTTPAPIEX_
             .CaptureReturn(&sasUri_as_const_char)
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+        STRICT_EXPECTED_CALL(Blob_UploadFromSasUri_Ex(sasUri_as_const_char, &c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, 1, 0, NULL, NULL, false))
             .IgnoreArgument(1)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
@@ -4245,6 +4260,601 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_x509privatekey_fails_when_s
     IoTHubClient_LL_UploadToBlob_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_41_075: [ blob_upload_keep_connection - then value is a pointer to a bool that tells whether the connection to IoTHub of an upload is kept for the next one. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_blob_upload_keep_connection_succeeds)
+{
+    ///arrange
+    bool keepConnection = true;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_KEEP_CONNECTION, &keepConnection);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_075: [ blob_upload_keep_connection - then value is a pointer to a bool that tells whether the connection to IoTHub of an upload is kept for the next one. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_blob_upload_keep_connection_fails_when_Lock_Init_fails)
+{
+    ///arrange
+    bool keepConnection = true;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init())
+        .SetReturn(NULL);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_KEEP_CONNECTION, &keepConnection);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+static void setupUploadToBlobStep2Succeeds(void)
+{
+    EXPECTED_CALL(Blob_UploadFromSasUri_Ex(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .CopyOutArgumentBuffer_httpStatus(&TwoHundred, sizeof(TwoHundred));
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_076: [ If a connection to IoTHub was kept by a previous upload, IoTHubClient_LL_UploadToBlob shall use it instead of creating an HTTPAPIEX_HANDLE and setting its options. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_077: [ If "blob_upload_keep_connection" is set and the upload succeeded, IoTHubClient_LL_UploadToBlob shall keep its connection to IoTHub for the next upload unless another upload already kept one, otherwise it shall destroy it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_blob_upload_keep_connection_reuses_the_connection_of_the_previous_upload)
+{
+    ///arrange
+    bool keepConnection = true;
+    unsigned char c = '3';
+    IOTHUB_CLIENT_RESULT result1;
+    IOTHUB_CLIENT_RESULT result2;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_KEEP_CONNECTION, &keepConnection);
+    umock_c_reset_all_calls();
+
+    setupUploadToBlobStep2Succeeds();
+    result1 = IoTHubClient_LL_UploadToBlob_Impl(h, "text.txt", &c, 1);
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "HTTPAPIEX_Destroy("));
+    umock_c_reset_all_calls();
+
+    setupUploadToBlobStep2Succeeds();
+
+    ///act
+    result2 = IoTHubClient_LL_UploadToBlob_Impl(h, "text.txt", &c, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "HTTPAPIEX_Create("));
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "HTTPAPIEX_Destroy("));
+
+    ///cleanup
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "HTTPAPIEX_Destroy("));
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_077: [ If "blob_upload_keep_connection" is set and the upload succeeded, IoTHubClient_LL_UploadToBlob shall keep its connection to IoTHub for the next upload unless another upload already kept one, otherwise it shall destroy it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_without_blob_upload_keep_connection_destroys_the_connection)
+{
+    ///arrange
+    unsigned char c = '3';
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    setupUploadToBlobStep2Succeeds();
+
+    ///act
+    result = IoTHubClient_LL_UploadToBlob_Impl(h, "text.txt", &c, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "HTTPAPIEX_Destroy("));
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Lock("));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_078: [ blob_upload_concurrency - then value is a pointer to a size_t with the number of blocks of a blob of 64MB or more uploaded to storage at the same time. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_blob_upload_concurrency_with_NULL_value_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CONCURRENCY, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_078: [ blob_upload_concurrency - then value is a pointer to a size_t with the number of blocks of a blob of 64MB or more uploaded to storage at the same time. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_079: [ IoTHubClient_LL_UploadToBlob shall call Blob_UploadFromSasUri_Ex passing the "blob_upload_concurrency" value (1 when the option is not set). ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_blob_upload_concurrency_passes_it_to_Blob_UploadFromSasUri_Ex)
+{
+    ///arrange
+    size_t concurrency = 4;
+    unsigned char c = '3';
+    IOTHUB_CLIENT_RESULT setOptionResult;
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    setOptionResult = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_CONCURRENCY, &concurrency);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(Blob_UploadFromSasUri_Ex(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 4, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .ValidateArgument_blockUploadConcurrency()
+        .CopyOutArgumentBuffer_httpStatus(&TwoHundred, sizeof(TwoHundred));
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+
+    ///act
+    result = IoTHubClient_LL_UploadToBlob_Impl(h, "text.txt", &c, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, setOptionResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_NULL(strstr(umock_c_get_expected_calls(), "Blob_UploadFromSasUri_Ex("));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_088: [ blob_upload_block_retries - then value is a pointer to a size_t with the number of times a block that failed to reach storage, or that storage answered with 408, 429 or 5xx, is put again before the upload fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_blob_upload_block_retries_with_NULL_value_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_BLOCK_RETRIES, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_087: [ IoTHubClient_LL_UploadToBlob shall pass the "blob_upload_block_retries" value (0 when the option is not set) to Blob_UploadFromSasUri_Ex and Blob_UploadMultipleBlocksFromSasUri. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_blob_upload_block_retries_passes_it_to_Blob_UploadFromSasUri_Ex)
+{
+    ///arrange
+    size_t retries = 5;
+    unsigned char c = '3';
+    IOTHUB_CLIENT_RESULT setOptionResult;
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    setOptionResult = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_BLOCK_RETRIES, &retries);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(Blob_UploadFromSasUri_Ex(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, 5, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .ValidateArgument_blockRetryCount()
+        .CopyOutArgumentBuffer_httpStatus(&TwoHundred, sizeof(TwoHundred));
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+
+    ///act
+    result = IoTHubClient_LL_UploadToBlob_Impl(h, "text.txt", &c, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, setOptionResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_NULL(strstr(umock_c_get_expected_calls(), "Blob_UploadFromSasUri_Ex("));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_090: [ blob_upload_progress - then value is a pointer to an IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_REPORTING with the callback called after every block put in storage, a NULL progressCallback stops the reporting. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_blob_upload_progress_with_NULL_value_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_PROGRESS, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+static int testProgressCallback(const IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS* progress, void* userContextCallback)
+{
+    (void)progress;
+    (void)userContextCallback;
+    return 0;
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_089: [ IoTHubClient_LL_UploadToBlob shall pass the "blob_upload_progress" callback and context (NULL when the option is not set) to Blob_UploadFromSasUri_Ex and Blob_UploadMultipleBlocksFromSasUri. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_090: [ blob_upload_progress - then value is a pointer to an IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_REPORTING with the callback called after every block put in storage, a NULL progressCallback stops the reporting. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_blob_upload_progress_passes_it_to_Blob_UploadFromSasUri_Ex)
+{
+    ///arrange
+    IOTHUB_CLIENT_FILE_UPLOAD_PROGRESS_REPORTING progressReporting = { testProgressCallback, (void*)0x42 };
+    unsigned char c = '3';
+    IOTHUB_CLIENT_RESULT setOptionResult;
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    setOptionResult = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_PROGRESS, &progressReporting);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(Blob_UploadFromSasUri_Ex(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, testProgressCallback, (void*)0x42, IGNORED_NUM_ARG))
+        .ValidateArgument_progressCallback()
+        .ValidateArgument_progressContext()
+        .CopyOutArgumentBuffer_httpStatus(&TwoHundred, sizeof(TwoHundred));
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+
+    ///act
+    result = IoTHubClient_LL_UploadToBlob_Impl(h, "text.txt", &c, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, setOptionResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_NULL(strstr(umock_c_get_expected_calls(), "Blob_UploadFromSasUri_Ex("));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_091: [ IoTHubClient_LL_UploadToBlob shall pass the "blob_upload_block_crc64" value (false when the option is not set) to Blob_UploadFromSasUri_Ex and Blob_UploadMultipleBlocksFromSasUri. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_092: [ blob_upload_block_crc64 - then value is a pointer to a bool that tells whether every block is sent with its CRC64 for storage to refuse the blocks corrupted on the way. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_blob_upload_block_crc64_passes_it_to_Blob_UploadFromSasUri_Ex)
+{
+    ///arrange
+    bool computeBlockCrc64 = true;
+    unsigned char c = '3';
+    IOTHUB_CLIENT_RESULT setOptionResult;
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    setOptionResult = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_BLOCK_CRC64, &computeBlockCrc64);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(Blob_UploadFromSasUri_Ex(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, true))
+        .ValidateArgument_computeBlockCrc64()
+        .CopyOutArgumentBuffer_httpStatus(&TwoHundred, sizeof(TwoHundred));
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+
+    ///act
+    result = IoTHubClient_LL_UploadToBlob_Impl(h, "text.txt", &c, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, setOptionResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_NULL(strstr(umock_c_get_expected_calls(), "Blob_UploadFromSasUri_Ex("));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_092: [ blob_upload_block_crc64 - then value is a pointer to a bool that tells whether every block is sent with its CRC64 for storage to refuse the blocks corrupted on the way. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_blob_upload_block_crc64_with_NULL_value_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_BLOCK_CRC64, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+static IOTHUB_CLIENT_FILE_UPLOAD_RESULT lastGetDataResult;
+static size_t getDataFinalCallCount;
+static void testGetDataCallback(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const ** data, size_t* size, void* context)
+{
+    (void)context;
+    if ((data == NULL) && (size == NULL))
+    {
+        lastGetDataResult = result;
+        getDataFinalCallCount++;
+    }
+    else
+    {
+        *data = NULL;
+        *size = 0;
+    }
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_080: [ If handle, destinationFileName or getDataCallback is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl_with_NULL_getDataCallback_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(h, "text.txt", NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_081: [ IoTHubClient_LL_UploadMultipleBlocksToBlob shall upload the blocks of getDataCallback by calling Blob_UploadMultipleBlocksFromSasUri, then notify IoTHub as IoTHubClient_LL_UploadToBlob does. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_082: [ Once the upload finished, IoTHubClient_LL_UploadMultipleBlocksToBlob shall call getDataCallback with FILE_UPLOAD_OK when it succeeded (FILE_UPLOAD_ERROR otherwise) and with NULL data and size. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl_succeeds)
+{
+    ///arrange
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    lastGetDataResult = FILE_UPLOAD_ERROR;
+    getDataFinalCallCount = 0;
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(Blob_UploadMultipleBlocksFromSasUri(IGNORED_PTR_ARG, testGetDataCallback, (void*)0x42, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .ValidateArgument_getDataCallback()
+        .ValidateArgument_context()
+        .CopyOutArgumentBuffer_httpStatus(&TwoHundred, sizeof(TwoHundred));
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+
+    ///act
+    result = IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(h, "text.txt", testGetDataCallback, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_NULL(strstr(umock_c_get_expected_calls(), "Blob_UploadMultipleBlocksFromSasUri("));
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Blob_UploadFromSasUri_Ex("));
+    ASSERT_ARE_EQUAL(size_t, 1, getDataFinalCallCount);
+    ASSERT_ARE_EQUAL(int, (int)FILE_UPLOAD_OK, (int)lastGetDataResult);
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_082: [ Once the upload finished, IoTHubClient_LL_UploadMultipleBlocksToBlob shall call getDataCallback with FILE_UPLOAD_OK when it succeeded (FILE_UPLOAD_ERROR otherwise) and with NULL data and size. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl_when_Blob_UploadMultipleBlocksFromSasUri_fails_tells_getDataCallback)
+{
+    ///arrange
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    lastGetDataResult = FILE_UPLOAD_OK;
+    getDataFinalCallCount = 0;
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(Blob_UploadMultipleBlocksFromSasUri(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(BLOB_ERROR);
+
+    ///act
+    result = IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(h, "text.txt", testGetDataCallback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 1, getDataFinalCallCount);
+    ASSERT_ARE_EQUAL(int, (int)FILE_UPLOAD_ERROR, (int)lastGetDataResult);
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_083: [ If handle, destinationFileName or filePath is NULL then IoTHubClient_LL_UploadFileToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_with_NULL_filePath_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, "text.txt", NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_084: [ If the file cannot be opened or the block buffer cannot be allocated then IoTHubClient_LL_UploadFileToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_with_missing_file_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, "text.txt", "iothub_client_ll_u2b_ut_no_such_file.bin");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_085: [ IoTHubClient_LL_UploadFileToBlob shall read the file in blocks of 4MB into a single buffer and upload them by calling Blob_UploadMultipleBlocksFromSasUri, then notify IoTHub as IoTHubClient_LL_UploadToBlob does. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_succeeds)
+{
+    ///arrange
+    const char* filePath = "iothub_client_ll_u2b_ut_file.bin";
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    FILE* file = fopen(filePath, "wb");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_ARE_EQUAL(size_t, 3, fwrite("abc", 1, 3, file));
+    (void)fclose(file);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(Blob_UploadMultipleBlocksFromSasUri(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .CopyOutArgumentBuffer_httpStatus(&TwoHundred, sizeof(TwoHundred));
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+
+    ///act
+    result = IoTHubClient_LL_UploadFileToBlob_Impl(h, "text.txt", filePath);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_NULL(strstr(umock_c_get_expected_calls(), "Blob_UploadMultipleBlocksFromSasUri("));
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Blob_UploadFromSasUri_Ex("));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(filePath);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_094: [ If the destinationFileName of a file is NULL, or its source is NULL and its size greater than 0, then IoTHubClient_LL_UploadMultipleToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG before uploading any file. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleToBlob_Impl_with_a_NULL_destinationFileName_fails)
+{
+    ///arrange
+    unsigned char c = '3';
+    IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM items[2] = { { "a.txt", &c, 1, IOTHUB_CLIENT_ERROR }, { NULL, &c, 1, IOTHUB_CLIENT_ERROR } };
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleToBlob_Impl(h, items, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+static const char* findLastCall(const char* calls, const char* call)
+{
+    const char* result = NULL;
+    const char* found;
+    while ((found = strstr(calls, call)) != NULL)
+    {
+        result = found;
+        calls = found + strlen(call);
+    }
+    return result;
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_095: [ IoTHubClient_LL_UploadMultipleToBlob shall upload all the files on a single connection to IoTHub, taken and kept as IoTHubClient_LL_UploadToBlob does. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_096: [ IoTHubClient_LL_UploadMultipleToBlob shall take the files 10 at a time and request the SAS URIs of all of them (step 1) before uploading any of them to storage. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_097: [ IoTHubClient_LL_UploadMultipleToBlob shall then upload to storage every file of the 10 that has its SAS URI, as IoTHubClient_LL_UploadToBlob does. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_098: [ IoTHubClient_LL_UploadMultipleToBlob shall then notify IoTHub of the completion of these uploads one right after the other (step 3) and set the result of every file in its result. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleToBlob_Impl_requests_all_the_SAS_URIs_then_uploads_then_notifies)
+{
+    ///arrange
+    unsigned char c = '3';
+    IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM items[2] = { { "a.txt", &c, 1, IOTHUB_CLIENT_ERROR }, { "b.txt", &c, 1, IOTHUB_CLIENT_ERROR } };
+    IOTHUB_CLIENT_RESULT result;
+    const char* actualCalls;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    setupUploadToBlobStep2Succeeds();
+    setupUploadToBlobStep2Succeeds();
+
+    ///act
+    result = IoTHubClient_LL_UploadMultipleToBlob_Impl(h, items, 2);
+
+    ///assert
+    actualCalls = umock_c_get_actual_calls();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, items[0].result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, items[1].result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)strstr(actualCalls, "HTTPAPIEX_Create("), (void*)findLastCall(actualCalls, "HTTPAPIEX_Create("));
+    ASSERT_IS_TRUE(strstr(actualCalls, "\"b.txt\"") < strstr(actualCalls, "Blob_UploadFromSasUri_Ex("));
+    ASSERT_IS_TRUE(findLastCall(actualCalls, "Blob_UploadFromSasUri_Ex(") < strstr(actualCalls, "\"/files/notifications/\""));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_099: [ A file that fails shall not stop the upload of the others, IoTHubClient_LL_UploadMultipleToBlob shall return IOTHUB_CLIENT_OK when all the files were uploaded and IOTHUB_CLIENT_ERROR otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleToBlob_Impl_when_the_SAS_URI_of_a_file_fails_uploads_the_others)
+{
+    ///arrange
+    unsigned char c = '3';
+    IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM items[2] = { { "a.txt", &c, 1, IOTHUB_CLIENT_OK }, { "b.txt", &c, 1, IOTHUB_CLIENT_ERROR } };
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .SetReturn(TestValid_BUFFER_u_char);
+    setupUploadToBlobStep2Succeeds();
+
+    ///act
+    result = IoTHubClient_LL_UploadMultipleToBlob_Impl(h, items, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, items[0].result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, items[1].result);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "Blob_UploadFromSasUri_Ex("));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)strstr(umock_c_get_actual_calls(), "Blob_UploadFromSasUri_Ex("), (void*)findLastCall(umock_c_get_actual_calls(), "Blob_UploadFromSasUri_Ex("));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
 
 END_TEST_SUITE(iothubclient_ll_uploadtoblob_ut)
 #endif /*DONT_USE_UPLOADTOBLOB*/
@@ -30,6 +30,7 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 #include "umocktypes_charptr.h"
 #include "umocktypes_bool.h"
 #include "umocktypes_stdint.h"
+#include "allocation_budget.h"
 
 #define ENABLE_MOCKS
 
@@ -46,6 +47,13 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 #include "iothub_client_version.h"
 #include "iothub_message.h"
 #include "iothub_client_authorization.h"
+#include "iothub_client_outbox.h"
+#include "iothub_client_json_merge_patch.h"
+#include "iothub_client_twin_cache.h"
+#include "iothub_client_compression.h"
+#include "iothub_client_pipeline.h"
+#include "iothub_client_duplicate_filter.h"
+#include "iothub_client_chunking.h"
 
 #undef ENABLE_MOCKS
 
@@ -61,9 +69,13 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 #endif
 
 MOCKABLE_FUNCTION(, void, test_event_confirmation_callback, IOTHUB_CLIENT_CONFIRMATION_RESULT, result, void*, userContextCallback);
+MOCKABLE_FUNCTION(, void, test_event_confirmation_callback_ex, IOTHUB_CLIENT_CONFIRMATION_RESULT, result, const IOTHUB_CLIENT_MESSAGE_TIMESTAMPS*, timestamps, void*, userContextCallback);
+MOCKABLE_FUNCTION(, void, test_message_trace_callback, IOTHUB_MESSAGE_HANDLE, message, IOTHUB_MESSAGE_TRACE_STAGE, stage, uint64_t, timestamp, void*, userContextCallback);
 MOCKABLE_FUNCTION(, IOTHUBMESSAGE_DISPOSITION_RESULT, test_message_callback_async, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback);
 MOCKABLE_FUNCTION(, void, iothub_reported_state_callback, int, status_code, void*, userContextCallback);
 MOCKABLE_FUNCTION(, void, iothub_device_twin_callback, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, payLoad, size_t, size, void*, userContextCallback);
+MOCKABLE_FUNCTION(, IOTHUBMESSAGE_DISPOSITION_RESULT, test_message_chunk_callback, IOTHUB_MESSAGE_HANDLE, message, const unsigned char*, chunk, size_t, size, size_t, offset, bool, isLast, void*, userContextCallback);
+MOCKABLE_FUNCTION(, void, test_device_twin_chunk_callback, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, chunk, size_t, size, size_t, offset, bool, isLast, void*, userContextCallback);
 MOCKABLE_FUNCTION(, int, deviceMethodCallback, const char*, method_name, const unsigned char*, payload, size_t, size, unsigned char**, response, size_t*, resp_size, void*, userContextCallback);
 MOCKABLE_FUNCTION(, int, iothub_client_inbound_device_method_callback, const char*, method_name, const unsigned char*, payload, size_t, size, METHOD_HANDLE, method_id, void*, userContextCallback);
 
@@ -78,17 +90,21 @@ MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_Unsubscribe, IOTHUB_DEVICE_HANDLE
 MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_DoWork, TRANSPORT_LL_HANDLE, handle, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
 MOCKABLE_FUNCTION(, int, FAKE_IoTHubTransport_SetRetryPolicy, TRANSPORT_LL_HANDLE, handle, IOTHUB_CLIENT_RETRY_POLICY, retryPolicy, size_t, retryTimeoutLimitInSeconds);
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_GetSendStatus, IOTHUB_DEVICE_HANDLE, handle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
+MOCKABLE_FUNCTION(, uint32_t, FAKE_IoTHubTransport_GetNextWorkDeadline, TRANSPORT_LL_HANDLE, handle, bool*, isWaitingForNetwork);
+MOCKABLE_FUNCTION(, size_t, FAKE_IoTHubTransport_GetPollDescriptors, TRANSPORT_LL_HANDLE, handle, IOTHUB_CLIENT_POLL_DESCRIPTOR*, descriptors, size_t, descriptorCount);
+MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_TrimMemory, TRANSPORT_LL_HANDLE, handle);
 MOCKABLE_FUNCTION(, int, FAKE_IoTHubTransport_Subscribe_DeviceTwin, IOTHUB_DEVICE_HANDLE, handle);
 MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_Unsubscribe_DeviceTwin, IOTHUB_DEVICE_HANDLE, handle);
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_SendMessageDisposition, MESSAGE_CALLBACK_INFO*, messageData, IOTHUBMESSAGE_DISPOSITION_RESULT, disposition);
 MOCKABLE_FUNCTION(, const char*, FAKE_IoTHubMessage_GetMessageId, IOTHUB_MESSAGE_HANDLE, message);
-MOCKABLE_FUNCTION(, IOTHUB_PROCESS_ITEM_RESULT, FAKE_IoTHubTransport_ProcessItem, TRANSPORT_LL_HANDLE, handle, IOTHUB_IDENTITY_TYPE, item_type, IOTHUB_IDENTITY_INFO*, iothub_item);
+MOCKABLE_FUNCTION(, IOTHUB_PROCESS_ITEM_RESULT, FAKE_IoTHubTransport_ProcessItem, IOTHUB_DEVICE_HANDLE, handle, IOTHUB_IDENTITY_TYPE, item_type, IOTHUB_IDENTITY_INFO*, iothub_item);
 MOCKABLE_FUNCTION(, int, FAKE_IoTHubTransport_Subscribe_DeviceMethod, IOTHUB_DEVICE_HANDLE, handle);
 MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_Unsubscribe_DeviceMethod, IOTHUB_DEVICE_HANDLE, handle);
 MOCKABLE_FUNCTION(, void, connectionStatusCallback, IOTHUB_CLIENT_CONNECTION_STATUS, result3, IOTHUB_CLIENT_CONNECTION_STATUS_REASON, reason, void*, userContextCallback);
 MOCKABLE_FUNCTION(, IOTHUBMESSAGE_DISPOSITION_RESULT, messageCallback, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback);
 MOCKABLE_FUNCTION(, bool, messageCallbackEx, MESSAGE_CALLBACK_INFO*, messageData, void*, userContextCallback);
 MOCKABLE_FUNCTION(, void, eventConfirmationCallback, IOTHUB_CLIENT_CONFIRMATION_RESULT, result2, void*, userContextCallback);
+MOCKABLE_FUNCTION(, void, sendQueueWatermarkCallback, IOTHUB_CLIENT_SEND_QUEUE_WATERMARK, watermark, size_t, messageCount, size_t, byteCount, void*, userContextCallback);
 MOCKABLE_FUNCTION(, int, FAKE_IoTHubTransport_DeviceMethod_Response, IOTHUB_DEVICE_HANDLE, handle, METHOD_HANDLE, methodId, const unsigned char*, response, size_t, resp_size, int, status_response);
 
 #undef ENABLE_MOCKS
@@ -164,6 +180,19 @@ static const char* TEST_STRING_VALUE = "Test string value";
 #define TEST_RETRY_TIMEOUT_SECS             60
 
 #define TEST_METHOD_ID                      (METHOD_HANDLE)0x61
+#define TEST_OUTBOX_HANDLE                  (OUTBOX_HANDLE)0x71
+#define TEST_OUTBOX_FILE_NAME               "outbox.bin"
+#define TEST_COMPRESSOR_HANDLE              (COMPRESSOR_HANDLE)0x72
+#define TEST_COMPRESSED_MESSAGE_HANDLE      (IOTHUB_MESSAGE_HANDLE)0x73
+#define TEST_TWIN_CACHE_HANDLE              (TWIN_CACHE_HANDLE)0x74
+#define TEST_TWIN_CACHE_FILE_NAME           "twin.json"
+#define TEST_PIPELINE_HANDLE                (MESSAGE_PIPELINE_HANDLE)0x75
+#define TEST_DUPLICATE_FILTER_HANDLE        (DUPLICATE_FILTER_HANDLE)0x76
+#define TEST_C2D_MESSAGE_ID                 "c2d_message_id"
+#define TEST_CHUNK_MESSAGE_HANDLE_1         (IOTHUB_MESSAGE_HANDLE)0x77
+#define TEST_CHUNK_MESSAGE_HANDLE_2         (IOTHUB_MESSAGE_HANDLE)0x78
+#define TEST_CHUNK_ID                       "chunk_id"
+#define TEST_CHUNK_SIZE                     100
 
 static const char* TEST_METHOD_NAME = "method_name";
 static const char* TEST_CHAR = "TestChar";
@@ -323,6 +352,15 @@ static TICK_COUNTER_HANDLE my_tickcounter_create(void)
     return (TICK_COUNTER_HANDLE)my_gballoc_malloc(1);
 }
 
+static IOTHUB_CLIENT_MESSAGE_TIMESTAMPS g_confirmed_timestamps;
+
+static void my_test_event_confirmation_callback_ex(IOTHUB_CLIENT_CONFIRMATION_RESULT result, const IOTHUB_CLIENT_MESSAGE_TIMESTAMPS* timestamps, void* userContextCallback)
+{
+    (void)result;
+    (void)userContextCallback;
+    g_confirmed_timestamps = *timestamps;
+}
+
 static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t * current_ms)
 {
     (void)tick_counter;
@@ -331,6 +369,14 @@ static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickc
     return 0;
 }
 
+/*for the rate limit, whose tokens come back with the time*/
+static int my_tickcounter_get_current_ms_frozen(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t * current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
 static void my_tickcounter_destroy(TICK_COUNTER_HANDLE tick_counter)
 {
     my_gballoc_free(tick_counter);
@@ -348,6 +394,12 @@ static void my_CONSTBUFFER_Destroy(CONSTBUFFER_HANDLE constbufferHandle)
     my_gballoc_free(constbufferHandle);
 }
 
+static CONSTBUFFER_HANDLE my_json_merge_patch_combine(CONSTBUFFER_HANDLE first, const unsigned char* second, size_t second_size)
+{
+    (void)first;
+    return my_CONSTBUFFER_Create(second, second_size);
+}
+
 static IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE my_IoTHubClient_LL_UploadToBlob_Create(const IOTHUB_CLIENT_CONFIG* config)
 {
     (void)config;
@@ -359,12 +411,74 @@ static void my_IoTHubClient_LL_UploadToBlob_Destroy(IOTHUB_CLIENT_LL_UPLOADTOBLO
     my_gballoc_free(handle);
 }
 
+static PDLIST_ENTRY g_waitingToSend;
+
+static size_t g_transport_seen_message_count;
+static bool g_transport_takes_messages;
+static DLIST_ENTRY g_transport_taken_messages;
+
+static size_t get_waiting_message_count(void)
+{
+    size_t result = 0;
+    PDLIST_ENTRY entry;
+    for (entry = g_waitingToSend->Flink; entry != g_waitingToSend; entry = entry->Flink)
+    {
+        result++;
+    }
+    return result;
+}
+
+static void my_FAKE_IoTHubTransport_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    (void)handle;
+    (void)iotHubClientHandle;
+    g_transport_seen_message_count = get_waiting_message_count();
+    if (g_transport_takes_messages && (g_waitingToSend->Flink != g_waitingToSend))
+    {
+        g_transport_taken_messages.Blink->Flink = g_waitingToSend->Flink;
+        g_waitingToSend->Flink->Blink = g_transport_taken_messages.Blink;
+        g_waitingToSend->Blink->Flink = &g_transport_taken_messages;
+        g_transport_taken_messages.Blink = g_waitingToSend->Blink;
+        g_waitingToSend->Flink = g_waitingToSend;
+        g_waitingToSend->Blink = g_waitingToSend;
+    }
+}
+
+static IOTHUB_CLIENT_LL_HANDLE create_rate_limited_client(size_t messagesPerSecond, size_t messageCount, bool transportTakesMessages)
+{
+    IOTHUB_CLIENT_RATE_LIMIT rateLimit;
+    IOTHUB_CLIENT_LL_HANDLE result = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t i;
+    rateLimit.messagesPerSecond = messagesPerSecond;
+    rateLimit.bytesPerSecond = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms_frozen);
+    REGISTER_GLOBAL_MOCK_HOOK(FAKE_IoTHubTransport_DoWork, my_FAKE_IoTHubTransport_DoWork);
+    g_transport_seen_message_count = 0;
+    g_transport_takes_messages = transportTakesMessages;
+    g_transport_taken_messages.Flink = &g_transport_taken_messages;
+    g_transport_taken_messages.Blink = &g_transport_taken_messages;
+    (void)IoTHubClient_LL_SetOption(result, OPTION_RATE_LIMIT, &rateLimit);
+    for (i = 0; i < messageCount; i++)
+    {
+        (void)IoTHubClient_LL_SendEventAsync(result, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    }
+    return result;
+}
+
+static void destroy_rate_limited_client(IOTHUB_CLIENT_LL_HANDLE handle)
+{
+    IoTHubClient_LL_SendComplete(handle, &g_transport_taken_messages, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+    IoTHubClient_LL_Destroy(handle);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_HOOK(FAKE_IoTHubTransport_DoWork, NULL);
+}
+
 static IOTHUB_DEVICE_HANDLE my_FAKE_IoTHubTransport_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
 {
     (void)handle;
     (void)device;
     (void)iotHubClientHandle;
-    (void)waitingToSend;
+    g_waitingToSend = waitingToSend;
     return (IOTHUB_DEVICE_HANDLE)my_gballoc_malloc(1);
 }
 
@@ -437,7 +551,10 @@ static TRANSPORT_PROVIDER FAKE_transport_provider =
     FAKE_IoTHubTransport_Unsubscribe,   /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;    */
     FAKE_IoTHubTransport_DoWork,        /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;              */
     FAKE_IoTHubTransport_SetRetryPolicy,/*pfIoTHubTransport_SetRetryPolicy IoTHubTransport_SetRetryPolicy;*/
-    FAKE_IoTHubTransport_GetSendStatus  /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    FAKE_IoTHubTransport_GetSendStatus, /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    FAKE_IoTHubTransport_GetNextWorkDeadline, /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline;*/
+    FAKE_IoTHubTransport_GetPollDescriptors, /*pfIoTHubTransport_GetPollDescriptors IoTHubTransport_GetPollDescriptors;*/
+    FAKE_IoTHubTransport_TrimMemory /*pfIoTHubTransport_TrimMemory IoTHubTransport_TrimMemory;*/
 };
 
 static const TRANSPORT_PROVIDER* provideFAKE(void)
@@ -522,6 +639,18 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(METHOD_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OUTBOX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_PRIORITY, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COMPRESSOR_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_PIPELINE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DUPLICATE_FILTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_MESSAGE_STAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TWIN_CACHE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TWIN_CACHE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_COMPRESSION, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_TRACE_STAGE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(const IOTHUB_CLIENT_MESSAGE_TIMESTAMPS*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const IOTHUB_CRYPTO_PROVIDER*, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_DISPOSITION_RESULT, int);
@@ -531,9 +660,12 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS_REASON, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RETRY_POLICY, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_SEND_QUEUE_WATERMARK, int);
 
 #ifndef DONT_USE_UPLOADTOBLOB
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM*, void*);
 #endif // DONT_USE_UPLOADTOBLOB
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_GetVersionString, "version 1.0");
@@ -559,6 +691,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_SetRetryPolicy, __FAILURE__);
     REGISTER_GLOBAL_MOCK_HOOK(FAKE_IoTHubTransport_GetSendStatus, my_FAKE_IoTHubTransport_GetSendStatus);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_GetSendStatus, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(FAKE_IoTHubTransport_GetNextWorkDeadline, IOTHUB_CLIENT_NO_WORK_DEADLINE);
+    REGISTER_GLOBAL_MOCK_RETURN(FAKE_IoTHubTransport_GetPollDescriptors, 1);
     REGISTER_GLOBAL_MOCK_RETURN(FAKE_IoTHubTransport_Subscribe_DeviceMethod, 0);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_Subscribe_DeviceMethod, __FAILURE__);
@@ -581,6 +715,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromString, (IOTHUB_MESSAGE_HANDLE)0x44);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Clone, (IOTHUB_MESSAGE_HANDLE)0x44);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_Clone, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetPriority, IOTHUB_MESSAGE_PRIORITY_NORMAL);
 
     REGISTER_GLOBAL_MOCK_RETURN(get_time, (time_t)TEST_TIME_VALUE);
 
@@ -617,6 +752,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(tickcounter_destroy, my_tickcounter_destroy);
 
     REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_HOOK(test_event_confirmation_callback_ex, my_test_event_confirmation_callback_ex);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, __FAILURE__);
 
     REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
@@ -628,12 +764,36 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
 
     REGISTER_GLOBAL_MOCK_RETURN(test_message_callback_async, IOTHUBMESSAGE_ACCEPTED);
+    REGISTER_GLOBAL_MOCK_RETURN(test_message_chunk_callback, IOTHUBMESSAGE_ACCEPTED);
     REGISTER_GLOBAL_MOCK_RETURN(messageCallback, IOTHUBMESSAGE_ACCEPTED);
     REGISTER_GLOBAL_MOCK_RETURN(messageCallbackEx, true);
 
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_Create, my_IoTHubClient_Auth_Create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Auth_Create, NULL);
 
+    REGISTER_GLOBAL_MOCK_RETURN(outbox_create, TEST_OUTBOX_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(outbox_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(outbox_append, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(outbox_append, __FAILURE__);
+    REGISTER_GLOBAL_MOCK_RETURN(outbox_release_oldest, 0);
+    REGISTER_GLOBAL_MOCK_RETURN(outbox_get_count, 0);
+    REGISTER_GLOBAL_MOCK_RETURN(outbox_get_unread_count, 0);
+
+    REGISTER_GLOBAL_MOCK_HOOK(json_merge_patch_combine, my_json_merge_patch_combine);
+    REGISTER_GLOBAL_MOCK_RETURN(twin_cache_create, TEST_TWIN_CACHE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(twin_cache_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(twin_cache_update, TWIN_CACHE_DELIVER);
+    REGISTER_GLOBAL_MOCK_RETURN(compressor_create, TEST_COMPRESSOR_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(compressor_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(message_pipeline_create, TEST_PIPELINE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_pipeline_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(message_pipeline_process, IOTHUB_CLIENT_MESSAGE_STAGE_KEEP);
+    REGISTER_GLOBAL_MOCK_RETURN(duplicate_filter_create, TEST_DUPLICATE_FILTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(duplicate_filter_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(duplicate_filter_contains, false);
+    REGISTER_GLOBAL_MOCK_RETURN(chunking_get_chunk_id, TEST_CHUNK_ID);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetCompression, IOTHUB_MESSAGE_COMPRESSION_DEFAULT);
+
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_Destroy, my_IoTHubClient_Auth_Destroy);
 
     REGISTER_GLOBAL_MOCK_HOOK(platform_get_platform_info, my_plafrom_get_platform_info);
@@ -694,7 +854,7 @@ static void setup_iothubclient_ll_create_mocks(bool use_device_config)
         STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG));
     }
 #ifndef DONT_USE_UPLOADTOBLOB
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the configuration of the upload to blob module*/
 #endif /*DONT_USE_UPLOADTOBLOB*/
     STRICT_EXPECTED_CALL(tickcounter_create());
     STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG))
@@ -730,6 +890,43 @@ static void setup_iothubclient_ll_sendreportedstate_mocks()
         .IgnoreArgument(2);
 }
 
+/*the reported state waits in iot_msg_queue until DoWork*/
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_pending_reported_state(void)
+{
+    bool coalesce = true;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_COALESCE_REPORTED_STATE, &coalesce);
+    (void)IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)1);
+    umock_c_reset_all_calls();
+    return handle;
+}
+
+/*two reported states wait in iot_msg_queue, only one fits in the window*/
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_twin_window(size_t ackTimeoutInSeconds)
+{
+    IOTHUB_CLIENT_TWIN_WINDOW window;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    window.maxInFlight = 1;
+    window.ackTimeoutInSeconds = ackTimeoutInSeconds;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_TWIN_WINDOW, &window);
+    (void)IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)1);
+    (void)IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)2);
+    umock_c_reset_all_calls();
+    return handle;
+}
+
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_twin_cache(void)
+{
+    IOTHUB_CLIENT_TWIN_CACHE_CONFIG config;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    config.enabled = true;
+    config.fileName = TEST_TWIN_CACHE_FILE_NAME;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_TWIN_CACHE, &config);
+    (void)IoTHubClient_LL_SetDeviceTwinCallback(handle, iothub_device_twin_callback, NULL);
+    umock_c_reset_all_calls();
+    return handle;
+}
+
 static void setup_iothubclient_ll_createfromconnectionstring_mocks(const char* device_token, const char* token_value)
 {
 #ifndef NO_LOGGING
@@ -1174,7 +1371,7 @@ TEST_FUNCTION(IoTHubClient_LL_Create_with_NULL_protocol_fails)
     ASSERT_ARE_EQUAL(void_ptr, NULL, result);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_094: [IoTHubClient_LL_Create shall create a IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE from IOTHUB_CLIENT_CONFIG. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_102: [ IoTHubClient_LL_Create and IoTHubClient_LL_CreateWithTransport shall not create the upload to blob module, they shall keep a copy of the configuration it is created from. ]*/
 /*Tests_SRS_IOTHUBCLIENT_LL_02_045: [Otherwise IoTHubClient_LL_Create shall create a new TICK_COUNTER_HANDLE ]*/
 /*Tests_SRS_IOTHUBCLIENT_LL_02_004: [Otherwise IoTHubClient_LL_Create shall initialize a new DLIST (further called "waitingToSend") containing records with fields of the following types: IOTHUB_MESSAGE_HANDLE, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*.]*/
 /*Tests_SRS_IOTHUBCLIENT_LL_02_006: [IoTHubClient_LL_Create shall populate a structure of type IOTHUBTRANSPORT_CONFIG with the information from config parameter and the previous DLIST and shall pass that to the underlying layer _Create function.]*/
@@ -1207,7 +1404,7 @@ TEST_FUNCTION(IoTHubClient_LL_Create_suceeds)
 /*Tests_SRS_IOTHUBCLIENT_LL_02_006: [IoTHubClient_LL_Create shall populate a structure of type IOTHUBTRANSPORT_CONFIG with the information from config parameter and the previous DLIST and shall pass that to the underlying layer _Create function.]*/
 /*Tests_SRS_IOTHUBCLIENT_LL_02_007: [If the underlaying layer _Create function fails them IoTHubClient_LL_Create shall fail and return NULL.]*/
 /*Tests_SRS_IOTHUBCLIENT_LL_02_046: [ If creating the TICK_COUNTER_HANDLE fails then IoTHubClient_LL_Create shall fail and return NULL. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_095: [ If creating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClient_LL_Create shall fail and return NULL. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_095: [ If copying the configuration of the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClient_LL_Create shall fail and return NULL. ]*/
 TEST_FUNCTION(IoTHubClient_LL_Create_fail)
 {
     int negativeTestsInitResult = umock_c_negative_tests_init();
@@ -1391,7 +1588,7 @@ TEST_FUNCTION(IoTHubClient_LL_Destroys_the_underlying_transport_succeeds)
     STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
 
 #ifndef DONT_USE_UPLOADTOBLOB
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the configuration of the upload to blob module*/
 #endif
 
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
@@ -1425,7 +1622,7 @@ TEST_FUNCTION(IoTHubClient_LL_Destroys_unregisters_but_does_not_destroy_transpor
     STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
 
 #ifndef DONT_USE_UPLOADTOBLOB
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the configuration of the upload to blob module*/
 #endif
 
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
@@ -1519,1509 +1716,1730 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_succeeds)
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_010: [IoTHubClient_LL_Destroy shall call the underlaying layer's _Destroy function and shall free the resources allocated by IoTHubClient (if any).] */
-/*Tests_SRS_IOTHUBCLIENT_LL_02_033: [Otherwise, IoTHubClient_LL_Destroy shall complete all the event message callbacks that are in the waitingToSend list with the result IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.] */
-TEST_FUNCTION(IoTHubClient_LL_Destroy_after_sendEvent_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_004: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall behave as IoTHubClient_LL_SendEventAsync, with the exception of the message handle not being cloned. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_with_NULL_messageHandle_fails)
 {
     //arrange
-
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-
-    IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG)); /*because there is one item in the list*/
-    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)1));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*IOTHUBMESSAGE*/
-
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG)); /*because there is one item in the list*/
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG)); /*because there is one item in the list*/
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG)); /*because there is one item in the list*/
-
-    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Destroy(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
-
-#ifndef DONT_USE_UPLOADTOBLOB
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG));
-#endif
-
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-
     //act
-    IoTHubClient_LL_Destroy(handle);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, NULL, test_event_confirmation_callback, (void*)1);
 
     //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_005: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall add eventMessageHandle itself to waitingToSend, without cloning it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_does_not_clone_the_message)
 {
     //arrange
-    int negativeTestsInitResult = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
-
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    tickcounter_ms_t thisIsNotZero = 312984751;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &thisIsNotZero); /*this forces _SendEventAsync to query the currentTime. If that fails, _SendEvent should fail as well*/
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
-    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    umock_c_negative_tests_snapshot();
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
 
-    // act
-    size_t calls_cannot_fail[] = { 3 };
-    size_t count = umock_c_negative_tests_call_count();
-    for (size_t index = 0; index < count; index++)
-    {
-        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
-        {
-            continue;
-        }
+/*Tests_SRS_IOTHUBCLIENT_LL_41_005: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall add eventMessageHandle itself to waitingToSend, without cloning it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Destroy_after_SendEventAsync_TakeOwnership_destroys_the_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
 
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(index);
+    (void)IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
 
-        char tmp_msg[64];
-        sprintf(tmp_msg, "IoTHubClient_LL_Create failure in test %zu/%zu", index, count);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG));
 
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE)); /*the caller's handle, not a clone*/
 
-        //assert
-        ASSERT_ARE_NOT_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    }
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
-    //cleanup
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the configuration of the upload to blob module*/
+#endif
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
     IoTHubClient_LL_Destroy(handle);
-    umock_c_negative_tests_deinit();
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_25_111: [IoTHubClient_LL_SetConnectionStatusCallback shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter iotHubClientHandle]*/
-TEST_FUNCTION(IoTHubClient_LL_SetConnectionStatusCallback_with_NULL_iotHubClientHandle_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_019: [ If iotHubClientHandle or eventMessageHandles are NULL, eventMessageCount is 0, any of the message handles is NULL, or eventConfirmationCallback is NULL and userContextCallback is not NULL, IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_NULL_handle_fails)
 {
-    ///arrange
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetConnectionStatusCallback(NULL, connectionStatusCallback, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(NULL, messages, 2, test_event_confirmation_callback, (void*)1);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_25_112: [IoTHubClient_LL_SetConnectionStatusCallback shall return IOTHUB_CLIENT_OK and save the callback and userContext as a member of the handle.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetConnectionStatusCallback_with_non_NULL_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_019: [ If iotHubClientHandle or eventMessageHandles are NULL, eventMessageCount is 0, any of the message handles is NULL, or eventConfirmationCallback is NULL and userContextCallback is not NULL, IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_zero_messages_fails)
 {
-    ///arrange
-
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE };
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetConnectionStatusCallback(handle, connectionStatusCallback, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 0, test_event_confirmation_callback, (void*)1);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_016: [IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_iotHubClientHandle_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_019: [ If iotHubClientHandle or eventMessageHandles are NULL, eventMessageCount is 0, any of the message handles is NULL, or eventConfirmationCallback is NULL and userContextCallback is not NULL, IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_a_NULL_message_fails)
 {
-    ///arrange
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE, NULL };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(NULL, messageCallback, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)1);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_calls_Unsubscribe_and_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_020: [ IoTHubClient_LL_SendEventBatchAsync shall add a clone of every message to waitingToSend, in order, the same way IoTHubClient_LL_SendEventAsync does. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_succeeds)
 {
-    ///arrange
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the batch*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, NULL, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)1);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_010: [If parameter messageCallback is NULL and the _SetMessageCallback had not been called to subscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_after_SetMessageCallbacEx_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_023: [ If adding any of the messages fails, IoTHubClient_LL_SendEventBatchAsync shall remove the messages of the batch already added, without calling eventConfirmationCallback, and return the error of IoTHubClient_LL_SendEventAsync. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_when_the_second_clone_fails_removes_the_first_message)
 {
-    ///arrange
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
     umock_c_reset_all_calls();
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, NULL, (void*)1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the batch*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the batch*/
 
-    ///assert
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)1);
+
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_011: [If parameter messageCallback is non-NULL and the _SetMessageCallback_Ex had been used to susbscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_after_SetMessageCallbacEx_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_021: [ eventConfirmationCallback, if not NULL, shall be called once, after all the messages of the batch have been confirmed. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_022: [ The batch shall be confirmed with IOTHUB_CLIENT_CONFIRMATION_OK if all its messages are confirmed with IOTHUB_CLIENT_CONFIRMATION_OK, and with the result of the first message that is not otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_calls_the_batch_callback_once_all_messages_are_confirmed)
 {
-    ///arrange
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    DLIST_ENTRY completed;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
+    (void)IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)1);
+    DList_InitializeListHead(&completed);
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend)); /*this is the transport picking the whole batch*/
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend));
     umock_c_reset_all_calls();
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the batch*/
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    //act
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    //assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_021: [IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_with_NULL_iotHubClientHandle_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_012: [ If optionName is OPTION_SEND_QUEUE_LIMITS and highWatermark is not 0 and lowWatermark is not lower than highWatermark, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_send_queue_limits_with_low_watermark_not_below_high_watermark_fails)
 {
-    ///arrange
-
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(NULL, messageCallbackEx, (void*)1);
+    //arrange
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    memset(&limits, 0, sizeof(limits));
+    limits.highWatermark = 2;
+    limits.lowWatermark = 2;
+    limits.watermarkCallback = sendQueueWatermarkCallback;
+    umock_c_reset_all_calls();
 
-    ///assert
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_018: [If parameter messageCallback is NULL and IoTHubClient_LL_SetMessageCallback_Ex had not been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_with_NULL_not_subscribed_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_013: [ Otherwise IoTHubClient_LL_SetOption shall store the limits pointed to by value, which apply to the messages sent afterwards, and return IOTHUB_CLIENT_OK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_014: [ If the message does not fit in the send queue and fullPolicy is not IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_QUEUE_FULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_full_send_queue_returns_QUEUE_FULL)
 {
-    ///arrange
+    //arrange
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    memset(&limits, 0, sizeof(limits));
+    limits.maxMessageCount = 1;
+    limits.fullPolicy = IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
     umock_c_reset_all_calls();
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, NULL, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_019: [If parameter messageCallback is NULL and IoTHubClient_LL_SetMessageCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_with_NULL_after_SetMessageCallback_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_014: [ If the message does not fit in the send queue and fullPolicy is not IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_QUEUE_FULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_over_max_byte_count_returns_QUEUE_FULL)
 {
-    ///arrange
+    //arrange
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    memset(&limits, 0, sizeof(limits));
+    limits.maxByteCount = 1;
+    limits.fullPolicy = IOTHUB_CLIENT_SEND_QUEUE_FULL_REJECT;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits);
     umock_c_reset_all_calls();
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, NULL, (void*)1);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn("two");
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_023: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_with_NULL_unsubscribe_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_015: [ If fullPolicy is IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall complete the oldest counted messages still in waitingToSend with IOTHUB_CLIENT_CONFIRMATION_ERROR until the message fits, and fail with IOTHUB_CLIENT_QUEUE_FULL if it still does not fit. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_full_send_queue_drops_the_oldest_message)
 {
-    ///arrange
+    //arrange
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
+    memset(&limits, 0, sizeof(limits));
+    limits.maxMessageCount = 1;
+    limits.fullPolicy = IOTHUB_CLIENT_SEND_QUEUE_FULL_DROP_OLDEST;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, NULL, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_025: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_Subscribe_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_016: [ When the number of counted messages reaches highWatermark, watermarkCallback shall be called with IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_018: [ While the send queue limits are in use, IoTHubClient_LL_SendEventAsync shall count the message and its payload size until its confirmation callback is called. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_reaching_high_watermark_calls_the_watermark_callback)
 {
-    ///arrange
+    //arrange
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    memset(&limits, 0, sizeof(limits));
+    limits.highWatermark = 2;
+    limits.lowWatermark = 1;
+    limits.watermarkCallback = sendQueueWatermarkCallback;
+    limits.watermarkUserContextCallback = (void*)0x42;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
-        .IgnoreArgument_handle()
-        .SetReturn(__LINE__);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(sendQueueWatermarkCallback(IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK, 2, 0, (void*)0x42));
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_020: [If parameter messageCallback is non-NULL, and IoTHubClient_LL_SetMessageCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_after_SetMessageCallback_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_017: [ When the number of counted messages drops to lowWatermark after the high watermark was reached, watermarkCallback shall be called with IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_reaching_low_watermark_calls_the_watermark_callback)
 {
-    ///arrange
+    //arrange
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
+    DLIST_ENTRY completed;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    memset(&limits, 0, sizeof(limits));
+    limits.highWatermark = 2;
+    limits.lowWatermark = 1;
+    limits.watermarkCallback = sendQueueWatermarkCallback;
+    limits.watermarkUserContextCallback = (void*)0x42;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+    DList_InitializeListHead(&completed);
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend)); /*this is the transport picking the first message*/
     umock_c_reset_all_calls();
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(sendQueueWatermarkCallback(IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK, 1, 0, (void*)0x42));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    //act
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    //assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_024: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Subscribe function.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_happy_path_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_027: [ While the statistics are enabled, IoTHubClient_LL_SendEventAsync shall count the message, its payload size and the time it was enqueued until its confirmation callback is called. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_030: [ If optionName is OPTION_STATISTICS, IoTHubClient_LL_SetOption shall enable or disable, as the bool pointed to by value says, the statistics of the messages sent afterwards and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_statistics_counts_the_message)
 {
-    ///arrange
+    //arrange
+    bool statisticsEnabled = true;
+    IOTHUB_CLIENT_STATISTICS statistics;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT setOptionResult = IoTHubClient_LL_SetOption(handle, OPTION_STATISTICS, &statisticsEnabled);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
-        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn("abc");
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT statisticsResult = IoTHubClient_LL_GetStatistics(handle, &statistics);
 
-    ///assert
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, setOptionResult);
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, statisticsResult);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.messagesEnqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 3, statistics.bytesEnqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.messagesSent);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.waitingToSendDepth);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.inProgressDepth);
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_026: [IoTHubClient_LL_SendMessageDisposition shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendMessageDisposition_with_first_NULL_fails)
-{
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendMessageDisposition(NULL, NULL, IOTHUBMESSAGE_ACCEPTED);
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-}
-
-/*Tests_SRS_IOTHUBCLIENT_LL_10_027: [IoTHubClient_LL_SendMessageDisposition shall return the result from calling the underlying layer's _Send_Message_Disposition.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendMessageDisposition_with_second_NULL_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_025: [ IoTHubClient_LL_GetStatistics shall copy the counters and the latency histogram of the counted messages to statistics, together with the number of them still in waitingToSend, the number of them picked up by the transport and not confirmed yet, and the percentiles of the latency. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetStatistics_counts_the_messages_picked_up_by_the_transport_as_in_progress)
 {
-    ///arrange
+    //arrange
+    bool statisticsEnabled = true;
+    IOTHUB_CLIENT_STATISTICS statistics;
+    DLIST_ENTRY completed;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_STATISTICS, &statisticsEnabled);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn("abc");
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    DList_InitializeListHead(&completed);
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend)); /*this is the transport picking the message*/
     umock_c_reset_all_calls();
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendMessageDisposition(NULL, NULL, IOTHUBMESSAGE_ACCEPTED);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetStatistics(handle, &statistics);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.messagesSent);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.waitingToSendDepth);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.inProgressDepth);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.msLatencyP50);
 
-    ///cleanup
+    //cleanup
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_027: [IoTHubClient_LL_SendMessageDisposition shall return the result from calling the underlying layer's Send_MessageDisposition.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendMessageDisposition_Succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_028: [ When a counted message is confirmed with IOTHUB_CLIENT_CONFIRMATION_OK, the time elapsed since it was enqueued shall be added to the latency histogram. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_statistics_records_the_latency)
 {
-    ///arrange
+    //arrange
+    bool statisticsEnabled = true;
+    IOTHUB_CLIENT_STATISTICS statistics;
+    DLIST_ENTRY completed;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_STATISTICS, &statisticsEnabled);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn("abc");
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    DList_InitializeListHead(&completed);
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend)); /*this is the transport picking the message*/
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*1000 ms after the message was enqueued*/
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendMessageDisposition(handle, testMessage, IOTHUBMESSAGE_ACCEPTED);
+    //act
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetStatistics(handle, &statistics);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.messagesSent);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.messagesConfirmed);
+    ASSERT_ARE_EQUAL(uint64_t, 3, statistics.bytesConfirmed);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.inProgressDepth);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.latencyHistogram[10]);
+    ASSERT_ARE_EQUAL(uint64_t, 1024, statistics.msLatencyP50);
+    ASSERT_ARE_EQUAL(uint64_t, 1024, statistics.msLatencyP99);
 
-    ///cleanup
-    destroy_test_message_info(testMessage);
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_1_items_with_callback_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_025: [ IoTHubClient_LL_GetStatistics shall copy the counters and the latency histogram of the counted messages to statistics, together with the number of them still in waitingToSend, the number of them picked up by the transport and not confirmed yet, and the percentiles of the latency. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_statistics_counts_the_failed_messages)
 {
-    ///arrange
-
+    //arrange
+    bool statisticsEnabled = true;
+    IOTHUB_CLIENT_STATISTICS statistics;
+    DLIST_ENTRY completed;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = eventConfirmationCallback;
-    one->context = (void*)1;
-    DList_InsertTailList(&temp, &(one->entry));
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_STATISTICS, &statisticsEnabled);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn("abc");
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    DList_InitializeListHead(&completed);
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend)); /*this is the transport picking the message*/
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(gballoc_free(one));
-
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
-    ///act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    //act
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetStatistics(handle, &statistics);
 
-    ///assert
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.messagesSent);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.messagesConfirmed);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.messagesFailed);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.inProgressDepth);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.msLatencyP50);
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_with_callback_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_024: [ If iotHubClientHandle or statistics are NULL, IoTHubClient_LL_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetStatistics_with_NULL_handle_fails)
 {
-    ///arrange
+    //arrange
+    IOTHUB_CLIENT_STATISTICS statistics;
 
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetStatistics(NULL, &statistics);
 
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = eventConfirmationCallback;
-    one->context = (void*)1;
-    DList_InsertTailList(&temp, &(one->entry));
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+}
 
-    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
-    two->callback = eventConfirmationCallback;
-    two->context = (void*)2;
-    DList_InsertTailList(&temp, &(two->entry));
+/*Tests_SRS_IOTHUBCLIENT_LL_41_024: [ If iotHubClientHandle or statistics are NULL, IoTHubClient_LL_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetStatistics_with_NULL_statistics_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
 
-    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
-    three->callback = eventConfirmationCallback;
-    three->context = (void*)3;
-    DList_InsertTailList(&temp, &(three->entry));
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetStatistics(handle, NULL);
 
-    umock_c_reset_all_calls();
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(gballoc_free(one));
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)2));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
-    STRICT_EXPECTED_CALL(gballoc_free(two));
+/*Tests_SRS_IOTHUBCLIENT_LL_41_071: [ If iotHubClientHandle or keepAliveInterval are NULL, IoTHubClient_LL_GetKeepAlive shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetKeepAlive_with_NULL_handle_fails)
+{
+    //arrange
+    int keepAliveInterval;
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)3));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
-    STRICT_EXPECTED_CALL(gballoc_free(three));
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetKeepAlive(NULL, &keepAliveInterval);
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+}
 
-    ///act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+/*Tests_SRS_IOTHUBCLIENT_LL_41_072: [ IoTHubClient_LL_GetKeepAlive shall set keepAliveInterval to the last value reported by the transport with IoTHubClient_LL_KeepAliveChanged, 0 if none was reported, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetKeepAlive_without_report_returns_0)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    int keepAliveInterval = -1;
+    umock_c_reset_all_calls();
 
-    ///assert
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetKeepAlive(handle, &keepAliveInterval);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(int, 0, keepAliveInterval);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_BACTCHSTATE_FAILED then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_with_callback__but_batch_failed_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_072: [ IoTHubClient_LL_GetKeepAlive shall set keepAliveInterval to the last value reported by the transport with IoTHubClient_LL_KeepAliveChanged, 0 if none was reported, and return IOTHUB_CLIENT_OK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_074: [ IoTHubClient_LL_KeepAliveChanged shall store keepAliveInterval to be returned by IoTHubClient_LL_GetKeepAlive. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetKeepAlive_returns_the_reported_keepalive)
 {
-    ///arrange
-
+    //arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
-
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = eventConfirmationCallback;
-    one->context = (void*)1;
-    DList_InsertTailList(&temp, &(one->entry));
-
-    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
-    two->callback = eventConfirmationCallback;
-    two->context = (void*)2;
-    DList_InsertTailList(&temp, &(two->entry));
+    int keepAliveInterval = -1;
+    IoTHubClient_LL_KeepAliveChanged(handle, 240);
+    IoTHubClient_LL_KeepAliveChanged(handle, 480);
+    umock_c_reset_all_calls();
 
-    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
-    three->callback = eventConfirmationCallback;
-    three->context = (void*)3;
-    DList_InsertTailList(&temp, &(three->entry));
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetKeepAlive(handle, &keepAliveInterval);
 
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(int, 480, keepAliveInterval);
 
-    umock_c_reset_all_calls();
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)1));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(gballoc_free(one));
+/*Tests_SRS_IOTHUBCLIENT_LL_41_100: [ If iotHubClientHandle is NULL, IoTHubClient_LL_GetTransportHandle shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetTransportHandle_with_NULL_handle_fails)
+{
+    //arrange
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)2));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
-    STRICT_EXPECTED_CALL(gballoc_free(two));
+    //act
+    void* result = IoTHubClient_LL_GetTransportHandle(NULL);
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)3));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
-    STRICT_EXPECTED_CALL(gballoc_free(three));
+    //assert
+    ASSERT_IS_NULL(result);
+}
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+/*Tests_SRS_IOTHUBCLIENT_LL_41_101: [ IoTHubClient_LL_GetTransportHandle shall return the lower layer transport of the client, created by it or given to IoTHubClient_LL_CreateWithTransport. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetTransportHandle_returns_the_transport_of_the_client)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
 
-    ///act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    //act
+    void* result = IoTHubClient_LL_GetTransportHandle(handle);
 
-    ///assert
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_TRANSPORT_LL_HANDLE, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-
-/* Tests_SRS_IOTHUBCLIENT_LL_25_116: [**IoTHubClient_LL_SetRetryPolicy shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL iotHubClientHandle]*/
-TEST_FUNCTION(IoTHubClient_LL_SetRetryPolicy_with_NULL_iotHubClientHandle_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_073: [ If handle is NULL, IoTHubClient_LL_KeepAliveChanged shall return. ]*/
+TEST_FUNCTION(IoTHubClient_LL_KeepAliveChanged_with_NULL_handle_does_nothing)
 {
-    ///arrange
+    //arrange
     umock_c_reset_all_calls();
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetRetryPolicy(NULL, TEST_RETRY_POLICY, TEST_RETRY_TIMEOUT_SECS);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    //act
+    IoTHubClient_LL_KeepAliveChanged(NULL, 240);
 
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-TEST_FUNCTION(IoTHubClient_LL_SetRetryPolicy_Retrytimeout_0_pass)
+/*Tests_SRS_IOTHUBCLIENT_LL_02_010: [IoTHubClient_LL_Destroy shall call the underlaying layer's _Destroy function and shall free the resources allocated by IoTHubClient (if any).] */
+/*Tests_SRS_IOTHUBCLIENT_LL_02_033: [Otherwise, IoTHubClient_LL_Destroy shall complete all the event message callbacks that are in the waitingToSend list with the result IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.] */
+TEST_FUNCTION(IoTHubClient_LL_Destroy_after_sendEvent_succeeds)
 {
-    ///arrange
+    //arrange
+
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+
+    IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
     umock_c_reset_all_calls();
 
-    ///act
-    for (int policy = 0; policy <= 6; policy++)
-    {
-        STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SetRetryPolicy(IGNORED_PTR_ARG, (IOTHUB_CLIENT_RETRY_POLICY)policy, 0))
-                .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG));
 
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetRetryPolicy(handle, (IOTHUB_CLIENT_RETRY_POLICY)policy, 0);
-        ///assert
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG)); /*because there is one item in the list*/
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
 
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*IOTHUBMESSAGE*/
 
-    }
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG)); /*because there is one item in the list*/
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG)); /*because there is one item in the list*/
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG)); /*because there is one item in the list*/
 
-    ///cleanup
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the configuration of the upload to blob module*/
+#endif
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
     IoTHubClient_LL_Destroy(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-TEST_FUNCTION(IoTHubClient_LL_SetRetryPolicy_success)
+/*Tests_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails)
 {
-    ///arrange
+    //arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t thisIsNotZero = 312984751;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &thisIsNotZero); /*this forces _SendEventAsync to query the currentTime. If that fails, _SendEvent should fail as well*/
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SetRetryPolicy(IGNORED_PTR_ARG, TEST_RETRY_POLICY, TEST_RETRY_TIMEOUT_SECS))
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetRetryPolicy(handle, TEST_RETRY_POLICY, TEST_RETRY_TIMEOUT_SECS);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    ///cleanup
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    umock_c_negative_tests_snapshot();
+
+    // act
+    size_t calls_cannot_fail[] = { 3 };
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClient_LL_Create failure in test %zu/%zu", index, count);
+
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    }
+
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
+    umock_c_negative_tests_deinit();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_25_114: [**IoTHubClient_LL_ConnectionStatusCallBack shall call non-callback set by the user from IoTHubClient_LL_SetConnectionStatusCallback passing the status, reason and the passed userContextCallback.]*/
-TEST_FUNCTION(IoTHubClient_LL_ConnectionStatusCallBack_calls_upper_layer_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_25_111: [IoTHubClient_LL_SetConnectionStatusCallback shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter iotHubClientHandle]*/
+TEST_FUNCTION(IoTHubClient_LL_SetConnectionStatusCallback_with_NULL_iotHubClientHandle_fails)
 {
     ///arrange
 
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetConnectionStatusCallback(handle, connectionStatusCallback, (void*)11);
-    umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(connectionStatusCallback((IOTHUB_CLIENT_CONNECTION_STATUS)IGNORED_NUM_ARG, (IOTHUB_CLIENT_CONNECTION_STATUS_REASON)IGNORED_NUM_ARG, (void*)11)).IgnoreAllArguments();
-
     ///act
-    IoTHubClient_LL_ConnectionStatusCallBack(handle, (IOTHUB_CLIENT_CONNECTION_STATUS)IGNORED_NUM_ARG, (IOTHUB_CLIENT_CONNECTION_STATUS_REASON)IGNORED_NUM_ARG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetConnectionStatusCallback(NULL, connectionStatusCallback, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_25_113: [If parameter connectionStatus is NULL or parameter handle is NULL then IoTHubClient_LL_ConnectionStatusCallBack shall return.] */
-TEST_FUNCTION(IoTHubClient_LL_ConnectionStatusCallBack_with_NULL_parameter_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_25_112: [IoTHubClient_LL_SetConnectionStatusCallback shall return IOTHUB_CLIENT_OK and save the callback and userContext as a member of the handle.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetConnectionStatusCallback_with_non_NULL_succeeds)
 {
     ///arrange
 
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetConnectionStatusCallback(handle, connectionStatusCallback, (void*)11);
     umock_c_reset_all_calls();
 
     ///act
-    IoTHubClient_LL_ConnectionStatusCallBack(NULL, (IOTHUB_CLIENT_CONNECTION_STATUS)IGNORED_NUM_ARG, (IOTHUB_CLIENT_CONNECTION_STATUS_REASON)IGNORED_NUM_ARG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetConnectionStatusCallback(handle, connectionStatusCallback, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_25_113: [If parameter connectionStatus is NULL or parameter handle is NULL then IoTHubClient_LL_ConnectionStatusCallBack shall return.] */
-TEST_FUNCTION(IoTHubClient_LL_ConnectionStatusCallBack_with_NULL_callback_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_02_016: [IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_iotHubClientHandle_fails)
 {
     ///arrange
 
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(NULL, messageCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_calls_Unsubscribe_and_succeeds)
+{
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetConnectionStatusCallback(handle, NULL, (void*)11);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)1);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
     ///act
-    IoTHubClient_LL_ConnectionStatusCallBack(NULL, (IOTHUB_CLIENT_CONNECTION_STATUS)IGNORED_NUM_ARG, (IOTHUB_CLIENT_CONNECTION_STATUS_REASON)IGNORED_NUM_ARG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, NULL, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
 /*Tests_SRS_IOTHUBCLIENT_LL_10_010: [If parameter messageCallback is NULL and the _SetMessageCallback had not been called to subscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_before_subscribe_fails)
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_after_SetMessageCallbacEx_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
     umock_c_reset_all_calls();
 
-    //act
+    ///act
     IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, NULL, (void*)1);
 
-    //assert
+    ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_017: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Subscribe function.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_non_NULL_succeeds)
+/* Tests_SRS_IOTHUBCLIENT_LL_10_011: [If parameter messageCallback is non-NULL and the _SetMessageCallback_Ex had been used to susbscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_after_SetMessageCallbacEx_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)1);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
 
-    //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_018: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_non_fails_when_underlying_transport_fails)
-{
-    //arrange
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetReturn(1);
-
-    //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)1);
-
-    //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup
-    IoTHubClient_LL_Destroy(handle);
-}
-
-/*Tests_SRS_IOTHUBCLIENT_LL_02_020: [If parameter iotHubClientHandle is NULL then IoTHubClient_LL_DoWork shall not perform any action.] */
-TEST_FUNCTION(IoTHubClient_LL_DoWork_with_NULL_does_nothing)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_021: [IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_with_NULL_iotHubClientHandle_fails)
 {
-    //arrange
+    ///arrange
 
-    //act
-    IoTHubClient_LL_DoWork(NULL);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(NULL, messageCallbackEx, (void*)1);
 
-    //assert
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.] */
-TEST_FUNCTION(IoTHubClient_LL_DoWork_calls_underlying_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_018: [If parameter messageCallback is NULL and IoTHubClient_LL_SetMessageCallback_Ex had not been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_with_NULL_not_subscribed_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
-        .IgnoreAllArguments();
-
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
-        .IgnoreArgument(1);
-
-    //act
-    IoTHubClient_LL_DoWork(handle);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, NULL, (void*)1);
 
-    //assert
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_NULL_handle_shall_return)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_019: [If parameter messageCallback is NULL and IoTHubClient_LL_SetMessageCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_with_NULL_after_SetMessageCallback_fails)
 {
-    //arrange
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
     umock_c_reset_all_calls();
 
-    //act
-    IoTHubClient_LL_SendComplete(NULL, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, NULL, (void*)1);
 
-    //assert
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_NULL_completed_shall_return)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_023: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_with_NULL_unsubscribe_succeeds)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
     umock_c_reset_all_calls();
 
-    //act
-    IoTHubClient_LL_SendComplete(handle, NULL, IOTHUB_CLIENT_CONFIRMATION_OK);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    //assert
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, NULL, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_empty_completed_shall_return)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_025: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_Subscribe_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .SetReturn(__LINE__);
 
-    //act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
 
-    //assert
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_one_without_callback_succeeds) /*for fun*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_020: [If parameter messageCallback is non-NULL, and IoTHubClient_LL_SetMessageCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_after_SetMessageCallback_fails)
 {
-    //arrange
-
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
-
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = test_event_confirmation_callback;
-    one->context = (void*)1;
-    DList_InsertTailList(&temp, &(one->entry));
-
-    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
-    two->callback = NULL;
-    two->context = NULL;
-    DList_InsertTailList(&temp, &(two->entry));
-
-    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
-    three->callback = test_event_confirmation_callback;
-    three->context = (void*)3;
-    DList_InsertTailList(&temp, &(three->entry));
-
+    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(gballoc_free(one));
-
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
-    STRICT_EXPECTED_CALL(gballoc_free(two));
-
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)3));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
-    STRICT_EXPECTED_CALL(gballoc_free(three));
-
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    //act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.] */
-TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_one_with_callback_but_batch_failed_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_024: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Subscribe function.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_happy_path_succeeds)
 {
-    //arrange
-
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    DLIST_ENTRY temp;
-    DList_InitializeListHead(&temp);
-
-    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
-    one->callback = NULL;
-    one->context = NULL;
-    DList_InsertTailList(&temp, &(one->entry));
-
-    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
-    two->callback = NULL;
-    two->context = NULL;
-    DList_InsertTailList(&temp, &(two->entry));
-
-    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
-    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
-    three->callback = test_event_confirmation_callback;
-    three->context = (void*)3;
-    DList_InsertTailList(&temp, &(three->entry));
-
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
-    STRICT_EXPECTED_CALL(gballoc_free(one));
-
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
-    STRICT_EXPECTED_CALL(gballoc_free(two));
-
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)3));
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
-    STRICT_EXPECTED_CALL(gballoc_free(three));
-
-    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
 
-    //act
-    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_handle_NULL_parameter_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_119: [ If iotHubClientHandle is NULL, or messageChunkCallback is not NULL and chunkSize is 0, IoTHubClient_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageChunkCallback_with_NULL_iotHubClientHandle_fails)
 {
-    //arrange
-
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(NULL, (MESSAGE_CALLBACK_INFO*)1);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageChunkCallback(NULL, 16, test_message_chunk_callback, (void*)1);
 
     ///assert
-    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_029: [If either parameter `handle` or `messageData` is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageData_NULL_parameter_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_119: [ If iotHubClientHandle is NULL, or messageChunkCallback is not NULL and chunkSize is 0, IoTHubClient_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageChunkCallback_with_chunkSize_0_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(handle, NULL);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageChunkCallback(handle, 0, test_message_chunk_callback, (void*)1);
 
     ///assert
-    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_004: [If messageHandle field of the messageData parameter is NULL then IoTHubClient_LL_MessageCallback shall return false.] */
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageData_messageHandle_is_NULL_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_120: [ If messageChunkCallback is NULL and IoTHubClient_LL_SetMessageChunkCallback had not been used to subscribe for messages, IoTHubClient_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageChunkCallback_with_NULL_not_subscribed_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(NULL);
     umock_c_reset_all_calls();
 
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageChunkCallback(handle, 0, NULL, NULL);
 
-    //assert
-    ASSERT_IS_FALSE(result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
-    destroy_test_message_info(testMessage);
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_032: [If messageCallbackType is NONE then IoTHubClient_LL_MessageCallback shall report false.] */
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_unsubscribed_returns_false)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_123: [ If messageChunkCallback is not NULL and IoTHubClient_LL_SetMessageCallback or IoTHubClient_LL_SetMessageCallback_Ex had been used to subscribe for messages, IoTHubClient_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageChunkCallback_after_SetMessageCallback_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(get_time(NULL));
-
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageChunkCallback(handle, 16, test_message_chunk_callback, (void*)1);
 
-    //assert
-    ASSERT_IS_FALSE(result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
-    destroy_test_message_info(testMessage);
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_030: [If messageCallbackType is LEGACY then IoTHubClient_LL_MessageCallback shall invoke the last callback function (the parameter messageCallback to IoTHubClient_LL_SetMessageCallback) passing the message and the passed userContextCallback.]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_10_007: [If messageCallbackType is LEGACY then IoTHubClient_LL_MessageCallback shall send the message disposition as returned by the client to the underlying layer and return true.]*/
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallback_calls_client_layer_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_122: [ If IoTHubClient_LL_SetMessageChunkCallback had been used to subscribe for messages, then IoTHubClient_LL_SetMessageCallback and IoTHubClient_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_Ex_after_SetMessageChunkCallback_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)11);
-    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    (void)IoTHubClient_LL_SetMessageChunkCallback(handle, 16, test_message_chunk_callback, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(get_time(NULL));
-    STRICT_EXPECTED_CALL(test_message_callback_async(testMessage->messageHandle, (void*)11));
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED));
-
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)1);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SetMessageCallback(handle, NULL, NULL);
 
-    //assert
-    ASSERT_IS_TRUE(result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result2);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
-    destroy_test_message_info(testMessage);
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallback_calls_client_layer_succeeds_report_disposition_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_124: [ If messageChunkCallback is not NULL, IoTHubClient_LL_SetMessageChunkCallback shall call the underlying layer's _Subscribe function unless it is subscribed already, and fail with IOTHUB_CLIENT_ERROR if it fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageChunkCallback_Subscribe_fails)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)11);
-    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(get_time(NULL));
-    STRICT_EXPECTED_CALL(test_message_callback_async(testMessage->messageHandle, (void*)11));
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED))
-        .SetReturn(IOTHUB_CLIENT_ERROR);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .SetReturn(__FAILURE__);
 
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageChunkCallback(handle, 16, test_message_chunk_callback, (void*)1);
 
-    //assert
-    ASSERT_IS_TRUE(result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_LL_GetMessageChunkSize(handle));
 
-    //cleanup
-    destroy_test_message_info(testMessage);
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallbackEx_calls_client_layer_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_124: [ If messageChunkCallback is not NULL, IoTHubClient_LL_SetMessageChunkCallback shall call the underlying layer's _Subscribe function unless it is subscribed already, and fail with IOTHUB_CLIENT_ERROR if it fails. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_125: [ Otherwise IoTHubClient_LL_SetMessageChunkCallback shall keep messageChunkCallback, chunkSize and userContextCallback and return IOTHUB_CLIENT_OK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_130: [ Otherwise IoTHubClient_LL_GetMessageChunkSize shall return the chunkSize given to IoTHubClient_LL_SetMessageChunkCallback. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageChunkCallback_happy_path_succeeds)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)11);
-    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(get_time(NULL));
-    STRICT_EXPECTED_CALL(messageCallbackEx(testMessage, (void*)11));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
 
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageChunkCallback(handle, 16, test_message_chunk_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SetMessageChunkCallback(handle, 32, test_message_chunk_callback, (void*)1);
 
-    //assert
-    ASSERT_IS_TRUE(result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 32, IoTHubClient_LL_GetMessageChunkSize(handle));
 
-    //cleanup
-    destroy_test_message_info(testMessage);
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_009: [If messageCallbackType is ASYNC then  IoTHubClient_LL_MessageCallback shall return what messageCallbacEx returns.] */
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallbackEx_calls_client_layer_reports_true)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_121: [ If messageChunkCallback is NULL, IoTHubClient_LL_SetMessageChunkCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_129: [ If handle is NULL or the messages are not received in chunks, IoTHubClient_LL_GetMessageChunkSize shall return 0. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageChunkCallback_with_NULL_unsubscribe_succeeds)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)11);
-    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    (void)IoTHubClient_LL_SetMessageChunkCallback(handle, 16, test_message_chunk_callback, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(get_time(NULL));
-    STRICT_EXPECTED_CALL(messageCallbackEx(testMessage, (void*)11));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
 
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageChunkCallback(handle, 0, NULL, NULL);
 
-    //assert
-    ASSERT_IS_TRUE(result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_LL_GetMessageChunkSize(handle));
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_LL_GetMessageChunkSize(NULL));
 
-    //cleanup
-    destroy_test_message_info(testMessage);
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_009: [If messageCallbackType is ASYNC then  IoTHubClient_LL_MessageCallback shall return what messageCallbacEx returns.] */
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallbackEx_calls_client_layer_reports_false)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_172: [ If iotHubClientHandle is NULL, IoTHubClient_LL_PauseReceive shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_175: [ If iotHubClientHandle is NULL, IoTHubClient_LL_ResumeReceive shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_PauseReceive_and_ResumeReceive_with_NULL_iotHubClientHandle_fail)
 {
-    //arrange
+    ///act
+    IOTHUB_CLIENT_RESULT pauseResult = IoTHubClient_LL_PauseReceive(NULL);
+    IOTHUB_CLIENT_RESULT resumeResult = IoTHubClient_LL_ResumeReceive(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, pauseResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, resumeResult);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_173: [ IoTHubClient_LL_PauseReceive shall call the underlying layer's _Unsubscribe function while a message callback is set and its IoTHubTransport_Unsubscribe_DeviceMethod function while a method callback is set, keeping the callbacks. ]*/
+TEST_FUNCTION(IoTHubClient_LL_PauseReceive_unsubscribes_messages_and_methods)
+{
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)11);
-    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(get_time(NULL));
-    STRICT_EXPECTED_CALL(messageCallbackEx(testMessage, (void*)11))
-        .SetReturn(false);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_PauseReceive(handle);
 
-    //assert
-    ASSERT_IS_FALSE(result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
-    destroy_test_message_info(testMessage);
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallbackEx_calls_client_layer_fails_disposition_reporting_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_174: [ While the receive is paused, the message and method callbacks shall be set and cleared without calling the underlying layer, and IoTHubClient_LL_PauseReceive shall return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_while_paused_does_not_subscribe)
 {
-    //arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)11);
-    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    (void)IoTHubClient_LL_PauseReceive(handle);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(get_time(NULL));
-    STRICT_EXPECTED_CALL(messageCallbackEx(testMessage, (void*)11))
-        .SetReturn(false);
-
-    //act
-    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    IOTHUB_CLIENT_RESULT pauseResult = IoTHubClient_LL_PauseReceive(handle);
+    IOTHUB_CLIENT_RESULT clearResult = IoTHubClient_LL_SetMessageCallback(handle, NULL, NULL);
 
-    //assert
-    ASSERT_IS_FALSE(result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, pauseResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, clearResult);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
-    destroy_test_message_info(testMessage);
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*** IoTHubClient_LL_GetLastMessageReceiveTime ***/
-
-/* Tests_SRS_IOTHUBCLIENT_LL_09_001: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG if any of the arguments is NULL] */
-TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_InvalidClientHandleArg_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_176: [ IoTHubClient_LL_ResumeReceive shall call the underlying layer's _Subscribe function while a message callback is set and its IoTHubTransport_Subscribe_DeviceMethod function while a method callback is set, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ResumeReceive_subscribes_messages_and_methods)
 {
-    // arrange
-    time_t lastMessageReceiveTime;
-
-    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_PauseReceive(handle);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
     umock_c_reset_all_calls();
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(NULL, &lastMessageReceiveTime);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_ResumeReceive(handle);
+    IOTHUB_CLIENT_RESULT resumeAgainResult = IoTHubClient_LL_ResumeReceive(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, resumeAgainResult);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    // Cleanup
-    IoTHubClient_LL_Destroy(iotHubClientHandle);
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_09_001: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG if any of the arguments is NULL] */
-TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_InvalidTimeRefArg_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_177: [ If a subscription fails, IoTHubClient_LL_ResumeReceive shall undo the subscription it made, stay paused and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ResumeReceive_Subscribe_DeviceMethod_fails_stays_paused)
 {
-    // arrange
-    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_PauseReceive(handle);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
     umock_c_reset_all_calls();
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(iotHubClientHandle, NULL);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(__LINE__);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_ResumeReceive(handle);
+    IOTHUB_CLIENT_RESULT clearResult = IoTHubClient_LL_SetMessageCallback(handle, NULL, NULL);
 
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, clearResult);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    // Cleanup
-    IoTHubClient_LL_Destroy(iotHubClientHandle);
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_09_002: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INDEFINITE_TIME - and not set 'lastMessageReceiveTime' - if it is unable to provide the time for the last commands] */
-TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_NoMessagesReceived_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_026: [IoTHubClient_LL_SendMessageDisposition shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendMessageDisposition_with_first_NULL_fails)
 {
-    // arrange
-    time_t lastMessageReceiveTime = (time_t)0;
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendMessageDisposition(NULL, NULL, IOTHUBMESSAGE_ACCEPTED);
 
-    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_027: [IoTHubClient_LL_SendMessageDisposition shall return the result from calling the underlying layer's _Send_Message_Disposition.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendMessageDisposition_with_second_NULL_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(iotHubClientHandle, &lastMessageReceiveTime);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendMessageDisposition(NULL, NULL, IOTHUBMESSAGE_ACCEPTED);
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
-    ASSERT_ARE_EQUAL(int, 0, (int)(lastMessageReceiveTime));
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    // Cleanup
-    IoTHubClient_LL_Destroy(iotHubClientHandle);
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_09_003: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_OK if it wrote in the lastMessageReceiveTime the time when the last command was received] */
-/* Tests_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
-TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_MessagesReceived_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_10_027: [IoTHubClient_LL_SendMessageDisposition shall return the result from calling the underlying layer's Send_MessageDisposition.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendMessageDisposition_Succeeds)
 {
-    // arrange
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)11);
-
     MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(get_time(NULL));
-    STRICT_EXPECTED_CALL(test_message_callback_async(testMessage->messageHandle, (void*)11));
     STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED));
 
-    (void)IoTHubClient_LL_MessageCallback(handle, testMessage);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendMessageDisposition(handle, testMessage, IOTHUBMESSAGE_ACCEPTED);
 
-    // act
-    time_t lastMessageReceiveTime = (time_t)0;
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(handle, &lastMessageReceiveTime);
-
-    // assert
+    ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    ASSERT_ARE_EQUAL(int, (int)TEST_TIME_VALUE, (int)lastMessageReceiveTime);
-
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
-    IoTHubClient_LL_Destroy(handle);
     destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*** IoTHubClient_LL_GetSendStatus ***/
-
-/* Tests_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
-TEST_FUNCTION(IoTHubClient_LL_GetSendStatus_BadHandleArgument_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_1_items_with_callback_succeeds)
 {
-    // arrange
+    ///arrange
 
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = eventConfirmationCallback;
+    one->context = (void*)1;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
     umock_c_reset_all_calls();
 
-    IOTHUB_CLIENT_STATUS status;
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(gballoc_free(one));
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(NULL, &status);
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    // assert
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    ///assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
 
-    // cleanup
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
-TEST_FUNCTION(IoTHubClient_LL_GetSendStatus_BadStatusArgument_fails)
+/*the allocation budgets of SendEventAsync: the clone of the message is mocked, so only the IOTHUB_MESSAGE_LIST entry counts*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_allocates_at_most_the_message_list_entry)
 {
-    // arrange
-
+    ///arrange
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, NULL);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
-    // assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ALLOCATION_BUDGET(1);
 
-    // cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_09_008: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there is currently no items to be sent] */
-TEST_FUNCTION(IoTHubClient_GetSendStatus_NoEventToSend_Succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_008: [ IoTHubClient_LL_SendEventAsync shall reuse a released IOTHUB_MESSAGE_LIST entry if there is one in the pool instead of allocating a new one. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_a_warm_message_pool_does_not_allocate)
 {
-    // arrange
+    ///arrange
+    size_t poolSize = 1;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_POOL_SIZE, &poolSize);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = NULL;
+    one->context = NULL;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
     umock_c_reset_all_calls();
 
-    IOTHUB_CLIENT_STATUS status;
-    IOTHUB_CLIENT_STATUS desire_status = IOTHUB_CLIENT_SEND_STATUS_IDLE;
-
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument_handle()
-        .CopyOutArgumentBuffer_iotHubClientStatus(&desire_status, sizeof(status))
-        .SetReturn(IOTHUB_CLIENT_OK);
-
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, &status);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
-    // assert
+    ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_IDLE, status);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ALLOCATION_BUDGET(0);
 
-    // cleanup
+    ///cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_09_009: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently items to be sent] */
-TEST_FUNCTION(IoTHubClient_GetSendStatus_HasEventToSend_Succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_007: [ If optionName is OPTION_MESSAGE_POOL_SIZE, IoTHubClient_LL_SetOption shall set the maximum number of released IOTHUB_MESSAGE_LIST entries kept for reuse to the size_t pointed to by value and free the entries above it. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_009: [ A released IOTHUB_MESSAGE_LIST entry shall be kept in the pool while the pool holds less than the maximum number of entries, and freed otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_message_pool_keeps_the_entry)
 {
-    // arrange
+    ///arrange
+    size_t poolSize = 1;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_POOL_SIZE, &poolSize);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = eventConfirmationCallback;
+    one->context = (void*)1;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
     umock_c_reset_all_calls();
 
-    IOTHUB_CLIENT_STATUS status;
-    IOTHUB_CLIENT_STATUS desire_status = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument_handle()
-        .CopyOutArgumentBuffer_iotHubClientStatus(&desire_status, sizeof(status))
-        .SetReturn(IOTHUB_CLIENT_OK);
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, &status);
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
 
-    // assert
+    ///assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
 
-    // cleanup
-    IoTHubClient_LL_Destroy(handle);
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle); /*frees the pooled entry*/
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_034: [If iotHubClientHandle is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_handle_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_008: [ IoTHubClient_LL_SendEventAsync shall reuse a released IOTHUB_MESSAGE_LIST entry if there is one in the pool instead of allocating a new one. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_011: [ IoTHubClient_LL_GetMessagePoolStatistics shall copy the pool hits, misses, current number of cached entries and the highest number of cached entries to statistics and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_message_pool_reuses_the_released_entry)
 {
-    //arrange
+    ///arrange
+    size_t poolSize = 1;
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_POOL_SIZE, &poolSize);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = NULL;
+    one->context = NULL;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    umock_c_reset_all_calls();
 
-    //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(NULL, "a", "b");
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT statisticsResult = IoTHubClient_LL_GetMessagePoolStatistics(handle, &statistics);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, statisticsResult);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.hits);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.misses);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.cached);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.highWaterMark);
 
     ///cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_035: [If optionName is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_optionName_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_007: [ If optionName is OPTION_MESSAGE_POOL_SIZE, IoTHubClient_LL_SetOption shall set the maximum number of released IOTHUB_MESSAGE_LIST entries kept for reuse to the size_t pointed to by value and free the entries above it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_pool_size_0_frees_the_pooled_entries)
 {
-    //arrange
-
+    ///arrange
+    size_t poolSize = 1;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_POOL_SIZE, &poolSize);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = NULL;
+    one->context = NULL;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
     umock_c_reset_all_calls();
+    poolSize = 0;
 
-    //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, NULL, "b");
+    STRICT_EXPECTED_CALL(gballoc_free(one));
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_POOL_SIZE, &poolSize);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_010: [ If iotHubClientHandle or statistics are NULL, IoTHubClient_LL_GetMessagePoolStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetMessagePoolStatistics_with_NULL_handle_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetMessagePoolStatistics(NULL, &statistics);
 
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_036: [If value is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_value_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_137: [ If iotHubClientHandle is NULL, IoTHubClient_LL_TrimMemory shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_TrimMemory_with_NULL_handle_fails)
 {
-    //arrange
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_TrimMemory(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
 
+/*Tests_SRS_IOTHUBCLIENT_LL_41_138: [ IoTHubClient_LL_TrimMemory shall free the IOTHUB_MESSAGE_LIST entries kept for reuse, call the underlying layer's _TrimMemory function if the transport has one and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_TrimMemory_frees_the_pooled_entries_and_trims_the_transport)
+{
+    ///arrange
+    size_t poolSize = 1;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_POOL_SIZE, &poolSize);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = NULL;
+    one->context = NULL;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
     umock_c_reset_all_calls();
 
-    //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "a", NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(one));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_TrimMemory(TEST_TRANSPORT_LL_HANDLE));
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_TrimMemory(handle);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
-
 }
 
-#ifndef DONT_USE_UPLOADTOBLOB
-/*these tests are to be run when upload to blob functionality exists*/
-
-/*Tests_SRS_IOTHUBCLIENT_LL_02_099 : [IoTHubClient_LL_SetOption shall return according to the table below]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_all_combinations)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_138: [ IoTHubClient_LL_TrimMemory shall free the IOTHUB_MESSAGE_LIST entries kept for reuse, call the underlying layer's _TrimMemory function if the transport has one and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_TrimMemory_with_transport_without_TrimMemory_succeeds)
 {
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle;
+    FAKE_transport_provider.IoTHubTransport_TrimMemory = NULL;
+    handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
 
-    static struct SetOptionTriplet
-    {
-        IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlob_SetOption_return;
-        IOTHUB_CLIENT_RESULT Transport_SetOption_return;
-        IOTHUB_CLIENT_RESULT expected_return;
-    } allCombinations[] =
-    {
-        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_OK },
-        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_OK },
-        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_OK },
-        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
-        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_INVALID_ARG }
-    };
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_TrimMemory(handle);
 
-    //arrange
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    FAKE_transport_provider.IoTHubTransport_TrimMemory = FAKE_IoTHubTransport_TrimMemory;
+}
 
+/*Tests_SRS_IOTHUBCLIENT_LL_41_178: [ If optionName is OPTION_CRYPTO_PROVIDER, IoTHubClient_LL_SetOption shall give the IOTHUB_CRYPTO_PROVIDER pointed to by value to IoTHubClient_Auth_Set_Crypto_Provider and return IOTHUB_CLIENT_ERROR if it fails. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_179: [ Otherwise IoTHubClient_LL_SetOption shall give value to the underlying layer's _SetOption function as OPTION_XIO_CRYPTO_PROVIDER, a failure being ignored, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_crypto_provider_succeeds)
+{
+    ///arrange
+    IOTHUB_CRYPTO_PROVIDER cryptoProvider = { NULL, (void*)0x4242 };
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Set_Crypto_Provider(IGNORED_PTR_ARG, &cryptoProvider))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SetOption(TEST_TRANSPORT_LL_HANDLE, OPTION_XIO_CRYPTO_PROVIDER, &cryptoProvider))
+        .SetReturn(IOTHUB_CLIENT_INVALID_ARG);
 
-    for (size_t i = 0;i < sizeof(allCombinations) / sizeof(allCombinations[0]);i++)
-    {
-        umock_c_reset_all_calls();
-        EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_SetOption(IGNORED_PTR_ARG, "a", "b"))
-            .SetReturn(allCombinations[i].IoTHubClient_UploadToBlob_SetOption_return);
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_CRYPTO_PROVIDER, &cryptoProvider);
 
-        EXPECTED_CALL(FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
-            .SetReturn(allCombinations[i].Transport_SetOption_return);
-
-        //act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "a", "b");
-
-        ///assert
-        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, allCombinations[i].expected_return, result);
-    }
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
-    umock_c_reset_all_calls();
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_038: [Otherwise, IoTHubClient_LL shall call the function _SetOption of the underlying transport and return what that function is returning.] */
-TEST_FUNCTION(IoTHubClient_LL_SetOption_fails_when_underlying_transport_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_178: [ If optionName is OPTION_CRYPTO_PROVIDER, IoTHubClient_LL_SetOption shall give the IOTHUB_CRYPTO_PROVIDER pointed to by value to IoTHubClient_Auth_Set_Crypto_Provider and return IOTHUB_CLIENT_ERROR if it fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_crypto_provider_Auth_fails)
 {
-    //arrange
+    ///arrange
+    IOTHUB_CRYPTO_PROVIDER cryptoProvider = { NULL, NULL };
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument_handle()
-        .IgnoreArgument_optionName()
-        .IgnoreArgument_value()
-        .SetReturn(IOTHUB_CLIENT_INVALID_ARG);
-
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Set_Crypto_Provider(IGNORED_PTR_ARG, &cryptoProvider))
         .IgnoreArgument_handle()
-        .IgnoreArgument_optionName()
-        .IgnoreArgument_value()
-        .SetReturn(IOTHUB_CLIENT_INDEFINITE_TIME);
+        .SetReturn(__LINE__);
 
-    //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "a", "b");
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_CRYPTO_PROVIDER, &cryptoProvider);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
-
 }
-#else
-/*these tests are to be run when uploadtoblob is not present*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_fails_when_underlying_transport_fails)
-{
-    //arrange
 
+/*Tests_SRS_IOTHUBCLIENT_LL_41_139: [ If optionName is OPTION_IDLE_TRIM_TIME, IoTHubClient_LL_SetOption shall set the seconds without anything queued after which IoTHubClient_LL_DoWork trims the memory to the unsigned int pointed to by value, 0 to stop trimming it, and return IOTHUB_CLIENT_OK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_140: [ While idle_trim_time is not 0, IoTHubClient_LL_DoWork shall trim the memory as IoTHubClient_LL_TrimMemory does once waitingToSend and iot_msg_queue have been empty for idle_trim_time seconds, and once only until a message or reported state is queued again. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_idle_trim_time_trims_the_memory_once_idle)
+{
+    ///arrange
+    unsigned int idleTrimTime = 1;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_IDLE_TRIM_TIME, &idleTrimTime);
+    IoTHubClient_LL_DoWork(handle); /*the client becomes idle*/
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
-        .SetReturn(IOTHUB_CLIENT_INDEFINITE_TIME);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(TEST_TRANSPORT_LL_HANDLE, handle));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*2000 ms after it became idle*/
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_TrimMemory(TEST_TRANSPORT_LL_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(TEST_TRANSPORT_LL_HANDLE, handle));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 
-    //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "a", "b");
+    ///act
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_DoWork(handle); /*trimmed already*/
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
-
 }
-#endif
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_zero_after_Create_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_164: [ If optionName is OPTION_RATE_LIMIT, IoTHubClient_LL_SetOption shall set the rate limit to the IOTHUB_CLIENT_RATE_LIMIT pointed to by value, both rates 0 to remove it, with token buckets holding one second of it, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_rate_limit_succeeds)
 {
-    //arrange
-
+    ///arrange
+    IOTHUB_CLIENT_RATE_LIMIT rateLimit;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    rateLimit.messagesPerSecond = 10;
+    rateLimit.bytesPerSecond = 4096;
     umock_c_reset_all_calls();
 
-    //act
-    tickcounter_ms_t zero = 0;
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_RATE_LIMIT, &rateLimit);
 
     ///assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
@@ -3031,168 +3449,200 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_zero_after_Create_succ
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_one_after_Create_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_165: [ If the current time cannot be read, IoTHubClient_LL_SetOption shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_rate_limit_tickcounter_fails)
 {
-    //arrange
-
+    ///arrange
+    IOTHUB_CLIENT_RATE_LIMIT rateLimit;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    rateLimit.messagesPerSecond = 10;
+    rateLimit.bytesPerSecond = 0;
     umock_c_reset_all_calls();
 
-    //act
-    tickcounter_ms_t one = 1;
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(__FAILURE__);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_RATE_LIMIT, &rateLimit);
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
     IoTHubClient_LL_Destroy(handle);
-
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_can_be_reverted_back_to_zero_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_166: [ While the rate limit is set, IoTHubClient_LL_DoWork shall hand to the underlying layer's _DoWork function only the messages at the head of waitingToSend the token buckets have tokens for, taking one message token and a token per payload byte for each of them, and keep the others in waitingToSend for later. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_rate_limit_hands_only_the_messages_with_tokens)
 {
-    //arrange
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_rate_limited_client(2, 3, true);
 
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    tickcounter_ms_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
-    umock_c_reset_all_calls();
+    ///act
+    IoTHubClient_LL_DoWork(handle);
 
-    //act
-    tickcounter_ms_t zero = 0;
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero);
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_transport_seen_message_count);
+    ASSERT_ARE_EQUAL(size_t, 1, get_waiting_message_count());
+
+    ///act
+    IoTHubClient_LL_DoWork(handle); /*no time passed, no token came back*/
 
     ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_transport_seen_message_count);
+    ASSERT_ARE_EQUAL(size_t, 1, get_waiting_message_count());
 
     ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    destroy_rate_limited_client(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_calls_timeout_callback)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_167: [ The token buckets shall fill at the rates in use, up to one second of them. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_rate_limit_refills_the_tokens_with_the_time)
 {
-    //arrange
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_rate_limited_client(2, 5, true);
+    IoTHubClient_LL_DoWork(handle);
+    g_current_ms += 500;
 
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    tickcounter_ms_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    ///act
+    IoTHubClient_LL_DoWork(handle);
 
-    /*send 1 messages that will expire*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    tickcounter_ms_t ten = 10;
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
-    umock_c_reset_all_calls();
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_transport_seen_message_count);
+    ASSERT_ARE_EQUAL(size_t, 2, get_waiting_message_count());
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout*/
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    ///cleanup
+    destroy_rate_limited_client(handle);
+}
 
-    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
-        .IgnoreArgument(1);
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+/*Tests_SRS_IOTHUBCLIENT_LL_41_168: [ If the underlying layer's _DoWork function takes none of the messages it is handed, IoTHubClient_LL_DoWork shall give their tokens back. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_rate_limit_gives_the_tokens_back_when_the_transport_takes_nothing)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_rate_limited_client(2, 3, false);
+    IoTHubClient_LL_DoWork(handle);
 
-    //act
+    ///act
     IoTHubClient_LL_DoWork(handle);
 
     ///assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, g_transport_seen_message_count);
+    ASSERT_ARE_EQUAL(size_t, 3, get_waiting_message_count());
 
     ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    destroy_rate_limited_client(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_defaults_to_zero)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_169: [ While the rate limit is set, the underlying layer's _GetNextWorkDeadline function shall only see the messages IoTHubClient_LL_DoWork would hand it, and the deadline shall be no later than the time the next of the others has its tokens. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadlineMs_with_rate_limit_returns_the_time_of_the_next_token)
 {
-    //arrange
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_rate_limited_client(2, 3, true);
+    IoTHubClient_LL_DoWork(handle);
 
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    ///act
+    uint32_t result = IoTHubClient_LL_GetNextWorkDeadlineMs(handle);
 
-    /*send 1 messages that will expire*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    tickcounter_ms_t ten = 10;
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
-    umock_c_reset_all_calls();
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 500, (size_t)result);
+    ASSERT_ARE_EQUAL(size_t, 1, get_waiting_message_count());
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    ///cleanup
+    destroy_rate_limited_client(handle);
+}
 
-    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => would result in timeout, except the fact that messageTimeout option has never been set, therefore no timeout shall be called*/
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+/*Tests_SRS_IOTHUBCLIENT_LL_41_170: [ While the rate limit is set, if result is IOTHUB_CLIENT_CONFIRMATION_ERROR, IoTHubClient_LL_SendComplete shall halve the rates in use, no more than once a second and down to a sixteenth of the rate limit. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_rate_limit_and_error_halves_the_rate)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_rate_limited_client(2, 3, true);
+    IoTHubClient_LL_DoWork(handle);
 
-    //act
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &g_transport_taken_messages, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1000, (size_t)IoTHubClient_LL_GetNextWorkDeadlineMs(handle));
+
+    ///cleanup
+    destroy_rate_limited_client(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_171: [ The rates in use shall be raised back by a tenth of the rate limit every second, up to the rate limit. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_rate_limit_raises_the_rate_back_after_an_error)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_rate_limited_client(20, 40, true);
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_SendComplete(handle, &g_transport_taken_messages, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    g_current_ms += 1000; /*12 messages per second once raised by a tenth of 20*/
+
+    ///act
     IoTHubClient_LL_DoWork(handle);
 
     ///assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 12, g_transport_seen_message_count);
 
     ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    destroy_rate_limited_client(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_only_removes_the_message_if_it_has_NULL_callback)
+/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_with_callback_succeeds)
 {
-    //arrange
+    ///arrange
 
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    tickcounter_ms_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
 
-    /*send 1 messages that will expire*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    tickcounter_ms_t ten = 10;
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL); /*this is a message with a NULL callback*/
-    umock_c_reset_all_calls();
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = eventConfirmationCallback;
+    one->context = (void*)1;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
 
-    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout*/
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
+    two->callback = eventConfirmationCallback;
+    two->context = (void*)2;
+    two->traced = false;
+    DList_InsertTailList(&temp, &(two->entry));
 
-    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
+    three->callback = eventConfirmationCallback;
+    three->context = (void*)3;
+    three->traced = false;
+    DList_InsertTailList(&temp, &(three->entry));
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(gballoc_free(one));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)2));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
+    STRICT_EXPECTED_CALL(gballoc_free(two));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)3));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
+    STRICT_EXPECTED_CALL(gballoc_free(three));
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    //act
-    IoTHubClient_LL_DoWork(handle);
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
 
     ///assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -3201,36 +3651,62 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_only_removes_the_message_
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_exactly_on_the_edge_does_not_call_the_callback) /*because "more"*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_BACTCHSTATE_FAILED then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_with_callback__but_batch_failed_succeeds)
 {
-    //arrange
+    ///arrange
+
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    tickcounter_ms_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = eventConfirmationCallback;
+    one->context = (void*)1;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
+
+    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
+    two->callback = eventConfirmationCallback;
+    two->context = (void*)2;
+    two->traced = false;
+    DList_InsertTailList(&temp, &(two->entry));
+
+    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
+    three->callback = eventConfirmationCallback;
+    three->context = (void*)3;
+    three->traced = false;
+    DList_InsertTailList(&temp, &(three->entry));
+
 
-    /*send 1 messages that will expire*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    tickcounter_ms_t ten = 10;
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
     umock_c_reset_all_calls();
 
-    tickcounter_ms_t eleven = 11; /*11 = 10 (receive time) + 1 (timeout) => NO timeout*/
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &eleven, sizeof(eleven));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(gballoc_free(one));
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)2));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
+    STRICT_EXPECTED_CALL(gballoc_free(two));
 
-    //act
-    IoTHubClient_LL_DoWork(handle);
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)3));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
+    STRICT_EXPECTED_CALL(gballoc_free(three));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_ERROR);
 
     ///assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -3239,1349 +3715,5078 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_exactly_on_the_edge_
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_calls_1_timeout) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+
+/* Tests_SRS_IOTHUBCLIENT_LL_25_116: [**IoTHubClient_LL_SetRetryPolicy shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL iotHubClientHandle]*/
+TEST_FUNCTION(IoTHubClient_LL_SetRetryPolicy_with_NULL_iotHubClientHandle_fails)
+{
+    ///arrange
+    umock_c_reset_all_calls();
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetRetryPolicy(NULL, TEST_RETRY_POLICY, TEST_RETRY_TIMEOUT_SECS);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+}
+
+TEST_FUNCTION(IoTHubClient_LL_SetRetryPolicy_Retrytimeout_0_pass)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    ///act
+    for (int policy = 0; policy <= 6; policy++)
+    {
+        STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SetRetryPolicy(IGNORED_PTR_ARG, (IOTHUB_CLIENT_RETRY_POLICY)policy, 0))
+                .IgnoreArgument(1);
+
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetRetryPolicy(handle, (IOTHUB_CLIENT_RETRY_POLICY)policy, 0);
+        ///assert
+
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    }
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_LL_SetRetryPolicy_success)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SetRetryPolicy(IGNORED_PTR_ARG, TEST_RETRY_POLICY, TEST_RETRY_TIMEOUT_SECS))
+        .IgnoreArgument(1);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetRetryPolicy(handle, TEST_RETRY_POLICY, TEST_RETRY_TIMEOUT_SECS);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_25_114: [**IoTHubClient_LL_ConnectionStatusCallBack shall call non-callback set by the user from IoTHubClient_LL_SetConnectionStatusCallback passing the status, reason and the passed userContextCallback.]*/
+TEST_FUNCTION(IoTHubClient_LL_ConnectionStatusCallBack_calls_upper_layer_succeeds)
+{
+    ///arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetConnectionStatusCallback(handle, connectionStatusCallback, (void*)11);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(connectionStatusCallback((IOTHUB_CLIENT_CONNECTION_STATUS)IGNORED_NUM_ARG, (IOTHUB_CLIENT_CONNECTION_STATUS_REASON)IGNORED_NUM_ARG, (void*)11)).IgnoreAllArguments();
+
+    ///act
+    IoTHubClient_LL_ConnectionStatusCallBack(handle, (IOTHUB_CLIENT_CONNECTION_STATUS)IGNORED_NUM_ARG, (IOTHUB_CLIENT_CONNECTION_STATUS_REASON)IGNORED_NUM_ARG);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_029: [ While the statistics are enabled, when the status becomes IOTHUB_CLIENT_CONNECTION_AUTHENTICATED after a disconnection, IoTHubClient_LL_ConnectionStatusCallBack shall increment reconnectCount and add the time spent disconnected to msDisconnected. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ConnectionStatusCallBack_with_statistics_counts_the_reconnection)
 {
     //arrange
+    bool statisticsEnabled = true;
+    IOTHUB_CLIENT_STATISTICS statistics;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_STATISTICS, &statisticsEnabled);
+    IoTHubClient_LL_ConnectionStatusCallBack(handle, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*1000 ms later*/
+
+    //act
+    IoTHubClient_LL_ConnectionStatusCallBack(handle, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
+    IoTHubClient_LL_ConnectionStatusCallBack(handle, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetStatistics(handle, &statistics);
 
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.reconnectCount);
+    ASSERT_ARE_EQUAL(uint64_t, 1000, statistics.msDisconnected);
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_026: [ If the client is disconnected, IoTHubClient_LL_GetStatistics shall add the time elapsed since the disconnection to msDisconnected. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetStatistics_while_disconnected_adds_the_current_disconnection)
+{
+    //arrange
+    bool statisticsEnabled = true;
+    IOTHUB_CLIENT_STATISTICS statistics;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    tickcounter_ms_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_STATISTICS, &statisticsEnabled);
+    IoTHubClient_LL_ConnectionStatusCallBack(handle, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+    IoTHubClient_LL_ConnectionStatusCallBack(handle, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
+    umock_c_reset_all_calls();
 
-    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    tickcounter_ms_t ten = 10;
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*1000 ms after the disconnection*/
 
-    tickcounter_ms_t two = 2;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &two);
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetStatistics(handle, &statistics);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.reconnectCount);
+    ASSERT_ARE_EQUAL(uint64_t, 1000, statistics.msDisconnected);
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_outbox(void)
+{
+    IOTHUB_CLIENT_OUTBOX_CONFIG config = { TEST_OUTBOX_FILE_NAME, 1000, 1, 2 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_OUTBOX, &config);
+    return handle;
+}
+
+/*the outbox holds one message sent with test_event_confirmation_callback, which DoWork moved to waitingToSend*/
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_outbox_message_in_flight(void)
+{
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox();
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(outbox_read_next(TEST_OUTBOX_HANDLE))
+        .SetReturn(TEST_DEVICEMESSAGE_HANDLE);
+    IoTHubClient_LL_DoWork(handle);
+    return handle;
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_031: [ If optionName is OPTION_OUTBOX and an outbox is already set, fileName is NULL or maxInFlight is 0, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_outbox_with_NULL_fileName_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_OUTBOX_CONFIG config = { NULL, 1000, 1, 2 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_OUTBOX, &config);
 
-    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
-        .IgnoreArgument(1);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
 
-    /*because we're at time = 12 in this test, the second message is untouched*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_031: [ If optionName is OPTION_OUTBOX and an outbox is already set, fileName is NULL or maxInFlight is 0, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_outbox_twice_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_OUTBOX_CONFIG config = { TEST_OUTBOX_FILE_NAME, 1000, 1, 2 };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox();
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_OUTBOX, &config);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_032: [ Otherwise IoTHubClient_LL_SetOption shall open the outbox described by the IOTHUB_CLIENT_OUTBOX_CONFIG pointed to by value, whose messages from a previous run are sent again first, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_outbox_opens_the_outbox)
+{
+    //arrange
+    IOTHUB_CLIENT_OUTBOX_CONFIG config = { TEST_OUTBOX_FILE_NAME, 1000, 1, 2 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(2));
+    STRICT_EXPECTED_CALL(outbox_create(TEST_OUTBOX_FILE_NAME, 1000, 1));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(outbox_get_count(TEST_OUTBOX_HANDLE));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_OUTBOX, &config);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_033: [ While an outbox is set, IoTHubClient_LL_SendEventAsync shall append the message to the outbox instead of waitingToSend, keep the confirmation callback for when the message is removed from the outbox, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_outbox_appends_the_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(outbox_append(TEST_OUTBOX_HANDLE, TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(DList_IsListEmpty(g_waitingToSend));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_034: [ If the message cannot be appended to the outbox, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_QUEUE_FULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_outbox_full_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(outbox_append(TEST_OUTBOX_HANDLE, TEST_MESSAGE_HANDLE))
+        .SetReturn(__FAILURE__);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_035: [ IoTHubClient_LL_DoWork shall, before calling the underlaying layer's _DoWork function, add the messages of the outbox to waitingToSend, in order and without a timeout, while less than maxInFlight of them are in flight. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_outbox_moves_the_messages_to_waitingToSend)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox();
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(3);
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(3);
+    STRICT_EXPECTED_CALL(outbox_read_next(TEST_OUTBOX_HANDLE))
+        .SetReturn(TEST_DEVICEMESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(outbox_read_next(TEST_OUTBOX_HANDLE))
+        .SetReturn(TEST_DEVICEMESSAGE_HANDLE_2);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*maxInFlight is reached*/
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DEVICEMESSAGE_HANDLE, containingRecord(g_waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry)->messageHandle);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DEVICEMESSAGE_HANDLE_2, containingRecord(g_waitingToSend->Blink, IOTHUB_MESSAGE_LIST, entry)->messageHandle);
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_036: [ Once a message and all the messages appended to the outbox before it are confirmed, IoTHubClient_LL shall remove it from the outbox and call its confirmation callback with IOTHUB_CLIENT_CONFIRMATION_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_outbox_releases_the_message)
+{
+    //arrange
+    DLIST_ENTRY completed;
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox_message_in_flight();
+    DList_InitializeListHead(&completed);
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend)); /*this is the transport picking the message*/
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(outbox_release_oldest(TEST_OUTBOX_HANDLE));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_037: [ If a message read from the outbox is not confirmed with IOTHUB_CLIENT_CONFIRMATION_OK, IoTHubClient_LL_DoWork shall, once no message read from the outbox is in flight, read the outbox again from its oldest message. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_outbox_after_a_failure_reads_the_outbox_again)
+{
+    //arrange
+    DLIST_ENTRY completed;
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox_message_in_flight();
+    DList_InitializeListHead(&completed);
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend)); /*this is the transport picking the message*/
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(outbox_rewind(TEST_OUTBOX_HANDLE));
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(outbox_read_next(TEST_OUTBOX_HANDLE))
+        .SetReturn(TEST_DEVICEMESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_038: [ A message of the outbox that cannot be read back shall be removed from the outbox in order and its confirmation callback called with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_outbox_releases_a_message_that_cannot_be_read)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox();
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(outbox_read_next(TEST_OUTBOX_HANDLE))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE)); /*the record was skipped*/
+    STRICT_EXPECTED_CALL(outbox_release_oldest(TEST_OUTBOX_HANDLE));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_039: [ IoTHubClient_LL_Destroy shall complete the callbacks of the messages still in the outbox with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY and close the outbox, which keeps the messages for the next run. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Destroy_with_outbox_completes_the_messages_of_the_outbox)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox();
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(outbox_destroy(TEST_OUTBOX_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the configuration of the upload to blob module*/
+#endif
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_Destroy(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_040: [ IoTHubClient_LL_GetSendStatus shall report IOTHUB_CLIENT_SEND_STATUS_BUSY while the outbox has messages not moved to waitingToSend yet. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetSendStatus_with_outbox_messages_not_read_reports_busy)
+{
+    //arrange
+    IOTHUB_CLIENT_STATUS status;
+    IOTHUB_CLIENT_STATUS transportStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_outbox();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .CopyOutArgumentBuffer_iotHubClientStatus(&transportStatus, sizeof(transportStatus));
+    STRICT_EXPECTED_CALL(outbox_get_unread_count(TEST_OUTBOX_HANDLE))
+        .SetReturn(1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, &status);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+static void send_event_with_priority(IOTHUB_CLIENT_LL_HANDLE handle, IOTHUB_MESSAGE_PRIORITY priority, IOTHUB_MESSAGE_HANDLE clonedMessage)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn(clonedMessage);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE))
+        .SetReturn(priority);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+}
+
+static void assert_waitingToSend_messages(const IOTHUB_MESSAGE_HANDLE* expectedMessages, size_t count)
+{
+    size_t index = 0;
+    PDLIST_ENTRY currentEntry;
+    for (currentEntry = g_waitingToSend->Flink; currentEntry != g_waitingToSend; currentEntry = currentEntry->Flink)
+    {
+        ASSERT_IS_TRUE(index < count);
+        ASSERT_ARE_EQUAL(void_ptr, expectedMessages[index], containingRecord(currentEntry, IOTHUB_MESSAGE_LIST, entry)->messageHandle);
+        index++;
+    }
+    ASSERT_ARE_EQUAL(size_t, count, index);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_041: [ If optionName is OPTION_PRIORITY_WEIGHTS and not all the weights are 0 but one of them is 0 or larger than IOTHUB_CLIENT_PRIORITY_MAX_WEIGHT, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_priority_weights_with_a_0_weight_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS weights = { 0, 1, 4 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_PRIORITY_WEIGHTS, &weights);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_041: [ If optionName is OPTION_PRIORITY_WEIGHTS and not all the weights are 0 but one of them is 0 or larger than IOTHUB_CLIENT_PRIORITY_MAX_WEIGHT, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_priority_weights_above_the_maximum_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS weights = { 1, 1, IOTHUB_CLIENT_PRIORITY_MAX_WEIGHT + 1 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_PRIORITY_WEIGHTS, &weights);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_043: [ Otherwise IoTHubClient_LL_SetOption shall store the weights pointed to by value, which apply to the messages sent afterwards, and return IOTHUB_CLIENT_OK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_044: [ While the priority weights are set, IoTHubClient_LL_SendEventAsync shall tag the message one step, inversely proportional to the weight of its IOTHUB_MESSAGE_PRIORITY, after the later of the last tag of that priority and the tag of the message at the head of waitingToSend. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_045: [ IoTHubClient_LL_SendEventAsync shall insert the message in waitingToSend after the last message whose tag is not larger than its own. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_priority_weights_sends_a_high_priority_message_ahead_of_the_backlog)
+{
+    //arrange
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS weights = { 1, 1, 4 };
+    IOTHUB_MESSAGE_HANDLE expectedMessages[] = { TEST_DEVICEMESSAGE_HANDLE, TEST_DEVICEMESSAGE_HANDLE_2, TEST_DEVICEMESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT setOptionResult = IoTHubClient_LL_SetOption(handle, OPTION_PRIORITY_WEIGHTS, &weights);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, TEST_DEVICEMESSAGE_HANDLE);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn(TEST_DEVICEMESSAGE_HANDLE_2);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_MESSAGE_PRIORITY_HIGH);
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, setOptionResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_waitingToSend_messages(expectedMessages, sizeof(expectedMessages) / sizeof(expectedMessages[0]));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_044: [ While the priority weights are set, IoTHubClient_LL_SendEventAsync shall tag the message one step, inversely proportional to the weight of its IOTHUB_MESSAGE_PRIORITY, after the later of the last tag of that priority and the tag of the message at the head of waitingToSend. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_045: [ IoTHubClient_LL_SendEventAsync shall insert the message in waitingToSend after the last message whose tag is not larger than its own. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_priority_weights_does_not_starve_the_low_priority_messages)
+{
+    //arrange
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS weights = { 1, 1, 2 };
+    IOTHUB_MESSAGE_HANDLE expectedMessages[] = { TEST_DEVICEMESSAGE_HANDLE, TEST_DEVICEMESSAGE_HANDLE_2, TEST_DEVICEMESSAGE_HANDLE, TEST_DEVICEMESSAGE_HANDLE_2, TEST_DEVICEMESSAGE_HANDLE_2, TEST_DEVICEMESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_PRIORITY_WEIGHTS, &weights);
+    umock_c_reset_all_calls();
+
+    //act
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_LOW, TEST_DEVICEMESSAGE_HANDLE);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_LOW, TEST_DEVICEMESSAGE_HANDLE);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_LOW, TEST_DEVICEMESSAGE_HANDLE);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, TEST_DEVICEMESSAGE_HANDLE_2);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, TEST_DEVICEMESSAGE_HANDLE_2);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, TEST_DEVICEMESSAGE_HANDLE_2);
+
+    //assert
+    assert_waitingToSend_messages(expectedMessages, sizeof(expectedMessages) / sizeof(expectedMessages[0]));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_042: [ If all the weights are 0, IoTHubClient_LL_SetOption shall add the messages sent afterwards at the end of waitingToSend again and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_priority_weights_all_0_queues_in_order_again)
+{
+    //arrange
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS weights = { 1, 1, 4 };
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS noWeights = { 0, 0, 0 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_PRIORITY_WEIGHTS, &weights);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT setOptionResult = IoTHubClient_LL_SetOption(handle, OPTION_PRIORITY_WEIGHTS, &noWeights);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, setOptionResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_25_113: [If parameter connectionStatus is NULL or parameter handle is NULL then IoTHubClient_LL_ConnectionStatusCallBack shall return.] */
+TEST_FUNCTION(IoTHubClient_LL_ConnectionStatusCallBack_with_NULL_parameter_fails)
+{
+    ///arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetConnectionStatusCallback(handle, connectionStatusCallback, (void*)11);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubClient_LL_ConnectionStatusCallBack(NULL, (IOTHUB_CLIENT_CONNECTION_STATUS)IGNORED_NUM_ARG, (IOTHUB_CLIENT_CONNECTION_STATUS_REASON)IGNORED_NUM_ARG);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_25_113: [If parameter connectionStatus is NULL or parameter handle is NULL then IoTHubClient_LL_ConnectionStatusCallBack shall return.] */
+TEST_FUNCTION(IoTHubClient_LL_ConnectionStatusCallBack_with_NULL_callback_fails)
+{
+    ///arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetConnectionStatusCallback(handle, NULL, (void*)11);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubClient_LL_ConnectionStatusCallBack(NULL, (IOTHUB_CLIENT_CONNECTION_STATUS)IGNORED_NUM_ARG, (IOTHUB_CLIENT_CONNECTION_STATUS_REASON)IGNORED_NUM_ARG);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_010: [If parameter messageCallback is NULL and the _SetMessageCallback had not been called to subscribe for messages, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_NULL_before_subscribe_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, NULL, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_017: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Subscribe function.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_non_NULL_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_018: [If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR. Otherwise IoTHubClient_LL_SetMessageCallback shall succeed and return IOTHUB_CLIENT_OK.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_with_non_fails_when_underlying_transport_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_020: [If parameter iotHubClientHandle is NULL then IoTHubClient_LL_DoWork shall not perform any action.] */
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_NULL_does_nothing)
+{
+    //arrange
+
+    //act
+    IoTHubClient_LL_DoWork(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.] */
+TEST_FUNCTION(IoTHubClient_LL_DoWork_calls_underlying_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
+        .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_NULL_handle_shall_return)
+{
+    //arrange
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_LL_SendComplete(NULL, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_NULL_completed_shall_return)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, NULL, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL or parameter handle is NULL then IoTHubClient_LL_SendBatch shall return.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_empty_completed_shall_return)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_one_without_callback_succeeds) /*for fun*/
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = test_event_confirmation_callback;
+    one->context = (void*)1;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
+
+    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
+    two->callback = NULL;
+    two->context = NULL;
+    two->traced = false;
+    DList_InsertTailList(&temp, &(two->entry));
+
+    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
+    three->callback = test_event_confirmation_callback;
+    three->context = (void*)3;
+    three->traced = false;
+    DList_InsertTailList(&temp, &(three->entry));
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(gballoc_free(one));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
+    STRICT_EXPECTED_CALL(gballoc_free(two));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)3));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
+    STRICT_EXPECTED_CALL(gballoc_free(three));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.] */
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_3_items_one_with_callback_but_batch_failed_succeeds)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    DList_InitializeListHead(&temp);
+
+    IOTHUB_MESSAGE_LIST* one = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
+    one->callback = NULL;
+    one->context = NULL;
+    one->traced = false;
+    DList_InsertTailList(&temp, &(one->entry));
+
+    IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
+    two->callback = NULL;
+    two->context = NULL;
+    two->traced = false;
+    DList_InsertTailList(&temp, &(two->entry));
+
+    IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
+    three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
+    three->callback = test_event_confirmation_callback;
+    three->context = (void*)3;
+    three->traced = false;
+    DList_InsertTailList(&temp, &(three->entry));
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(gballoc_free(one));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)2));
+    STRICT_EXPECTED_CALL(gballoc_free(two));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)3));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)3));
+    STRICT_EXPECTED_CALL(gballoc_free(three));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_handle_NULL_parameter_fails)
+{
+    //arrange
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(NULL, (MESSAGE_CALLBACK_INFO*)1);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_029: [If either parameter `handle` or `messageData` is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageData_NULL_parameter_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, NULL);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_004: [If messageHandle field of the messageData parameter is NULL then IoTHubClient_LL_MessageCallback shall return false.] */
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageData_messageHandle_is_NULL_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(NULL);
+    umock_c_reset_all_calls();
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    //assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_032: [If messageCallbackType is NONE then IoTHubClient_LL_MessageCallback shall report false.] */
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_unsubscribed_returns_false)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    //assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_030: [If messageCallbackType is LEGACY then IoTHubClient_LL_MessageCallback shall invoke the last callback function (the parameter messageCallback to IoTHubClient_LL_SetMessageCallback) passing the message and the passed userContextCallback.]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_007: [If messageCallbackType is LEGACY then IoTHubClient_LL_MessageCallback shall send the message disposition as returned by the client to the underlying layer and return true.]*/
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallback_calls_client_layer_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(test_message_callback_async(testMessage->messageHandle, (void*)11));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED));
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    //assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_126: [ If messageChunkCallback is set, IoTHubClient_LL_MessageCallback shall give it the body of messageHandle in chunks. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_128: [ The last result of messageChunkCallback shall be sent as the message disposition to the underlying layer and true returned. ]*/
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageChunkCallback_gives_the_body_in_chunks)
+{
+    //arrange
+    static const char* body = "abc";
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageChunkCallback(handle, 2, test_message_chunk_callback, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn(body);
+    STRICT_EXPECTED_CALL(test_message_chunk_callback(TEST_MESSAGE_HANDLE, (const unsigned char*)body, 2, 0, false, (void*)11));
+    STRICT_EXPECTED_CALL(test_message_chunk_callback(TEST_MESSAGE_HANDLE, (const unsigned char*)body + 2, 1, 2, true, (void*)11))
+        .SetReturn(IOTHUBMESSAGE_REJECTED);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_REJECTED));
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    //assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_131: [ If handle, messageData or its messageHandle is NULL, or payload is NULL and size is not 0, IoTHubClient_LL_MessageChunksCallback shall return false. ]*/
+TEST_FUNCTION(IoTHubClient_LL_MessageChunksCallback_with_NULL_parameters_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    bool result = IoTHubClient_LL_MessageChunksCallback(NULL, testMessage, NULL, 0);
+    bool result2 = IoTHubClient_LL_MessageChunksCallback(handle, NULL, NULL, 0);
+    bool result3 = IoTHubClient_LL_MessageChunksCallback(handle, testMessage, NULL, 1);
+
+    //assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_IS_FALSE(result2);
+    ASSERT_IS_FALSE(result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_132: [ If the messages are not received in chunks, IoTHubClient_LL_MessageChunksCallback shall return false. ]*/
+TEST_FUNCTION(IoTHubClient_LL_MessageChunksCallback_not_chunked_returns_false)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+
+    //act
+    bool result = IoTHubClient_LL_MessageChunksCallback(handle, testMessage, NULL, 0);
+
+    //assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_127: [ The body shall be given to messageChunkCallback in order, in chunks of at most chunkSize bytes, with isLast true for the last one and once with size 0 for an empty body, until messageChunkCallback returns anything but IOTHUBMESSAGE_ACCEPTED. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_133: [ Otherwise IoTHubClient_LL_MessageChunksCallback shall give payload to messageChunkCallback in chunks, with the properties of messageHandle. ]*/
+TEST_FUNCTION(IoTHubClient_LL_MessageChunksCallback_stops_at_the_first_chunk_not_accepted)
+{
+    //arrange
+    static const unsigned char payload[] = { 1, 2, 3, 4, 5 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageChunkCallback(handle, 2, test_message_chunk_callback, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(test_message_chunk_callback(TEST_MESSAGE_HANDLE, payload, 2, 0, false, (void*)11));
+    STRICT_EXPECTED_CALL(test_message_chunk_callback(TEST_MESSAGE_HANDLE, payload + 2, 2, 2, false, (void*)11))
+        .SetReturn(IOTHUBMESSAGE_ABANDONED);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ABANDONED));
+
+    //act
+    bool result = IoTHubClient_LL_MessageChunksCallback(handle, testMessage, payload, sizeof(payload));
+
+    //assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_127: [ The body shall be given to messageChunkCallback in order, in chunks of at most chunkSize bytes, with isLast true for the last one and once with size 0 for an empty body, until messageChunkCallback returns anything but IOTHUBMESSAGE_ACCEPTED. ]*/
+TEST_FUNCTION(IoTHubClient_LL_MessageChunksCallback_empty_body_gives_one_last_chunk)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageChunkCallback(handle, 2, test_message_chunk_callback, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(test_message_chunk_callback(TEST_MESSAGE_HANDLE, NULL, 0, 0, true, (void*)11));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED));
+
+    //act
+    bool result = IoTHubClient_LL_MessageChunksCallback(handle, testMessage, NULL, 0);
+
+    //assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallback_calls_client_layer_succeeds_report_disposition_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(test_message_callback_async(testMessage->messageHandle, (void*)11));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED))
+        .SetReturn(IOTHUB_CLIENT_ERROR);
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    //assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallbackEx_calls_client_layer_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(messageCallbackEx(testMessage, (void*)11));
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    //assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_009: [If messageCallbackType is ASYNC then  IoTHubClient_LL_MessageCallback shall return what messageCallbacEx returns.] */
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallbackEx_calls_client_layer_reports_true)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(messageCallbackEx(testMessage, (void*)11));
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    //assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_009: [If messageCallbackType is ASYNC then  IoTHubClient_LL_MessageCallback shall return what messageCallbacEx returns.] */
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallbackEx_calls_client_layer_reports_false)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(messageCallbackEx(testMessage, (void*)11))
+        .SetReturn(false);
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    //assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_messageCallbackEx_calls_client_layer_fails_disposition_reporting_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback_Ex(handle, messageCallbackEx, (void*)11);
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(messageCallbackEx(testMessage, (void*)11))
+        .SetReturn(false);
+
+    //act
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    //assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*** IoTHubClient_LL_GetLastMessageReceiveTime ***/
+
+/* Tests_SRS_IOTHUBCLIENT_LL_09_001: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG if any of the arguments is NULL] */
+TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_InvalidClientHandleArg_fails)
+{
+    // arrange
+    time_t lastMessageReceiveTime;
+
+    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(NULL, &lastMessageReceiveTime);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    IoTHubClient_LL_Destroy(iotHubClientHandle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_09_001: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INVALID_ARG if any of the arguments is NULL] */
+TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_InvalidTimeRefArg_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(iotHubClientHandle, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+
+    // Cleanup
+    IoTHubClient_LL_Destroy(iotHubClientHandle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_09_002: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INDEFINITE_TIME - and not set 'lastMessageReceiveTime' - if it is unable to provide the time for the last commands] */
+TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_NoMessagesReceived_fails)
+{
+    // arrange
+    time_t lastMessageReceiveTime = (time_t)0;
+
+    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(iotHubClientHandle, &lastMessageReceiveTime);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
+    ASSERT_ARE_EQUAL(int, 0, (int)(lastMessageReceiveTime));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    IoTHubClient_LL_Destroy(iotHubClientHandle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_09_003: [IoTHubClient_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_OK if it wrote in the lastMessageReceiveTime the time when the last command was received] */
+/* Tests_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
+TEST_FUNCTION(IoTHubClient_LL_GetLastMessageReceiveTime_MessagesReceived_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)11);
+
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(test_message_callback_async(testMessage->messageHandle, (void*)11));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED));
+
+    (void)IoTHubClient_LL_MessageCallback(handle, testMessage);
+
+    // act
+    time_t lastMessageReceiveTime = (time_t)0;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetLastMessageReceiveTime(handle, &lastMessageReceiveTime);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(int, (int)TEST_TIME_VALUE, (int)lastMessageReceiveTime);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    destroy_test_message_info(testMessage);
+}
+
+/*** IoTHubClient_LL_GetNextWorkDeadlineMs ***/
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_107: [ If iotHubClientHandle is NULL, IoTHubClient_LL_GetNextWorkDeadlineMs shall return 0. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadlineMs_with_NULL_handle_returns_0)
+{
+    // act
+    uint32_t result = IoTHubClient_LL_GetNextWorkDeadlineMs(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, (size_t)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_108: [ If the current time cannot be read, IoTHubClient_LL_GetNextWorkDeadlineMs shall return 0. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadlineMs_tickcounter_fails_returns_0)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(__FAILURE__);
+
+    // act
+    uint32_t result = IoTHubClient_LL_GetNextWorkDeadlineMs(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, (size_t)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_109: [ IoTHubClient_LL_GetNextWorkDeadlineMs shall start from the deadline of the underlying layer's _GetNextWorkDeadline function, or 0 if the transport has none. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadlineMs_returns_the_transport_deadline)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetNextWorkDeadline(TEST_TRANSPORT_LL_HANDLE, IGNORED_PTR_ARG))
+        .SetReturn(4242);
+
+    // act
+    uint32_t result = IoTHubClient_LL_GetNextWorkDeadlineMs(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 4242, (size_t)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_109: [ IoTHubClient_LL_GetNextWorkDeadlineMs shall start from the deadline of the underlying layer's _GetNextWorkDeadline function, or 0 if the transport has none. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadlineMs_transport_without_deadline_returns_0)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle;
+    FAKE_transport_provider.IoTHubTransport_GetNextWorkDeadline = NULL;
+    handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    uint32_t result = IoTHubClient_LL_GetNextWorkDeadlineMs(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, (size_t)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+    FAKE_transport_provider.IoTHubTransport_GetNextWorkDeadline = FAKE_IoTHubTransport_GetNextWorkDeadline;
+}
+
+/*** IoTHubClient_LL_IsWaitingForNetwork ***/
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_113: [ If iotHubClientHandle is NULL, IoTHubClient_LL_IsWaitingForNetwork shall return false. ]*/
+TEST_FUNCTION(IoTHubClient_LL_IsWaitingForNetwork_with_NULL_handle_returns_false)
+{
+    // act
+    bool result = IoTHubClient_LL_IsWaitingForNetwork(NULL);
+
+    // assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_115: [ Otherwise IoTHubClient_LL_IsWaitingForNetwork shall return what the underlying layer's _GetNextWorkDeadline function reports in isWaitingForNetwork. ]*/
+TEST_FUNCTION(IoTHubClient_LL_IsWaitingForNetwork_returns_what_the_transport_reports)
+{
+    // arrange
+    bool isWaitingForNetwork = true;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetNextWorkDeadline(TEST_TRANSPORT_LL_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_isWaitingForNetwork(&isWaitingForNetwork, sizeof(isWaitingForNetwork));
+
+    // act
+    bool result = IoTHubClient_LL_IsWaitingForNetwork(handle);
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*** IoTHubClient_LL_GetPollDescriptors ***/
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_116: [ If iotHubClientHandle or descriptorCount is NULL, or descriptors is NULL while descriptorCount is not 0, IoTHubClient_LL_GetPollDescriptors shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetPollDescriptors_with_NULL_handle_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_POLL_DESCRIPTOR descriptors[1];
+    size_t descriptorCount = 1;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetPollDescriptors(NULL, descriptors, &descriptorCount);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_116: [ If iotHubClientHandle or descriptorCount is NULL, or descriptors is NULL while descriptorCount is not 0, IoTHubClient_LL_GetPollDescriptors shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetPollDescriptors_with_NULL_descriptors_fails)
+{
+    // arrange
+    size_t descriptorCount = 1;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetPollDescriptors(handle, NULL, &descriptorCount);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_117: [ IoTHubClient_LL_GetPollDescriptors shall set descriptorCount to the number of sockets the underlying layer's _GetPollDescriptors function wrote, 0 if the transport has none, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetPollDescriptors_returns_the_transport_sockets)
+{
+    // arrange
+    IOTHUB_CLIENT_POLL_DESCRIPTOR descriptors[2];
+    size_t descriptorCount = 2;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetPollDescriptors(TEST_TRANSPORT_LL_HANDLE, descriptors, 2));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetPollDescriptors(handle, descriptors, &descriptorCount);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, descriptorCount);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_117: [ IoTHubClient_LL_GetPollDescriptors shall set descriptorCount to the number of sockets the underlying layer's _GetPollDescriptors function wrote, 0 if the transport has none, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetPollDescriptors_transport_without_sockets_returns_none)
+{
+    // arrange
+    IOTHUB_CLIENT_POLL_DESCRIPTOR descriptors[1];
+    size_t descriptorCount = 1;
+    IOTHUB_CLIENT_LL_HANDLE handle;
+    FAKE_transport_provider.IoTHubTransport_GetPollDescriptors = NULL;
+    handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetPollDescriptors(handle, descriptors, &descriptorCount);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, descriptorCount);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+    FAKE_transport_provider.IoTHubTransport_GetPollDescriptors = FAKE_IoTHubTransport_GetPollDescriptors;
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_41_118: [ IoTHubClient_LL_OnReadable and IoTHubClient_LL_OnWritable shall do the work of IoTHubClient_LL_DoWork. ]*/
+TEST_FUNCTION(IoTHubClient_LL_OnReadable_with_NULL_handle_does_nothing)
+{
+    // act
+    IoTHubClient_LL_OnReadable(NULL);
+    IoTHubClient_LL_OnWritable(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*** IoTHubClient_LL_GetSendStatus ***/
+
+/* Tests_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
+TEST_FUNCTION(IoTHubClient_LL_GetSendStatus_BadHandleArgument_fails)
+{
+    // arrange
+
+    umock_c_reset_all_calls();
+
+    IOTHUB_CLIENT_STATUS status;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(NULL, &status);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    // cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_09_007: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter] */
+TEST_FUNCTION(IoTHubClient_LL_GetSendStatus_BadStatusArgument_fails)
+{
+    // arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_09_008: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there is currently no items to be sent] */
+TEST_FUNCTION(IoTHubClient_GetSendStatus_NoEventToSend_Succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    IOTHUB_CLIENT_STATUS status;
+    IOTHUB_CLIENT_STATUS desire_status = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .CopyOutArgumentBuffer_iotHubClientStatus(&desire_status, sizeof(status))
+        .SetReturn(IOTHUB_CLIENT_OK);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, &status);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_IDLE, status);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_09_009: [IoTHubClient_LL_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently items to be sent] */
+TEST_FUNCTION(IoTHubClient_GetSendStatus_HasEventToSend_Succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    IOTHUB_CLIENT_STATUS status;
+    IOTHUB_CLIENT_STATUS desire_status = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .CopyOutArgumentBuffer_iotHubClientStatus(&desire_status, sizeof(status))
+        .SetReturn(IOTHUB_CLIENT_OK);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetSendStatus(handle, &status);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_034: [If iotHubClientHandle is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_handle_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(NULL, "a", "b");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_035: [If optionName is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_optionName_fails)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, NULL, "b");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_036: [If value is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_value_fails)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "a", NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+
+#ifndef DONT_USE_UPLOADTOBLOB
+/*these tests are to be run when upload to blob functionality exists*/
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_099 : [IoTHubClient_LL_SetOption shall return according to the table below]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_all_combinations)
+{
+
+    static struct SetOptionTriplet
+    {
+        IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlob_SetOption_return;
+        IOTHUB_CLIENT_RESULT Transport_SetOption_return;
+        IOTHUB_CLIENT_RESULT expected_return;
+    } allCombinations[] =
+    {
+        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_OK },
+        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_OK },
+        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_OK , IOTHUB_CLIENT_OK },
+        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_ERROR },
+        { IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_INVALID_ARG }
+    };
+
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+
+
+    for (size_t i = 0;i < sizeof(allCombinations) / sizeof(allCombinations[0]);i++)
+    {
+        umock_c_reset_all_calls();
+        EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_SetOption(IGNORED_PTR_ARG, "a", "b"))
+            .SetReturn(allCombinations[i].IoTHubClient_UploadToBlob_SetOption_return);
+
+        EXPECTED_CALL(FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
+            .SetReturn(allCombinations[i].Transport_SetOption_return);
+
+        //act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "a", "b");
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, allCombinations[i].expected_return, result);
+    }
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+    umock_c_reset_all_calls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_038: [Otherwise, IoTHubClient_LL shall call the function _SetOption of the underlying transport and return what that function is returning.] */
+TEST_FUNCTION(IoTHubClient_LL_SetOption_fails_when_underlying_transport_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_optionName()
+        .IgnoreArgument_value()
+        .SetReturn(IOTHUB_CLIENT_INVALID_ARG);
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_optionName()
+        .IgnoreArgument_value()
+        .SetReturn(IOTHUB_CLIENT_INDEFINITE_TIME);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "a", "b");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+#else
+/*these tests are to be run when uploadtoblob is not present*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_fails_when_underlying_transport_fails)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(FAKE_IoTHubTransport_SetOption(IGNORED_PTR_ARG, "a", "b"))
+        .SetReturn(IOTHUB_CLIENT_INDEFINITE_TIME);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "a", "b");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INDEFINITE_TIME, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+#endif
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_zero_after_Create_succeeds)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    tickcounter_ms_t zero = 0;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_to_one_after_Create_succeeds)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    tickcounter_ms_t one = 1;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_can_be_reverted_back_to_zero_succeeds)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    umock_c_reset_all_calls();
+
+    //act
+    tickcounter_ms_t zero = 0;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_calls_timeout_callback)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 1 messages that will expire*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+        .IgnoreArgument(1);
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_defaults_to_zero)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+
+    /*send 1 messages that will expire*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+
+    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => would result in timeout, except the fact that messageTimeout option has never been set, therefore no timeout shall be called*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_only_removes_the_message_if_it_has_NULL_callback)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 1 messages that will expire*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, NULL, NULL); /*this is a message with a NULL callback*/
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+        .IgnoreArgument(1);
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_exactly_on_the_edge_does_not_call_the_callback) /*because "more"*/
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 1 messages that will expire*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t eleven = 11; /*11 = 10 (receive time) + 1 (timeout) => NO timeout*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &eleven, sizeof(eleven));
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_calls_1_timeout) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    tickcounter_ms_t two = 2;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &two);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+        .IgnoreArgument(1);
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    /*because we're at time = 12 in this test, the second message is untouched*/
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_calls_2_timeouts) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    tickcounter_ms_t two = 2;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &two);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+
+    umock_c_reset_all_calls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+
+    tickcounter_ms_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+        .IgnoreArgument(1);
+
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    timeIsNow = 13; /*13 > 10 (receive time) + 2 (timeout) => timeout!!!*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)(TEST_DEVICEMESSAGE_HANDLE_2))); /*calling the callback*/
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+        .IgnoreArgument(1);
+
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+
+    /*because we're at time = 13 in this test, the second message times out too*/
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClient_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_one_with_timeout_one_without_call_1_callback) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    tickcounter_ms_t zero = 0;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero); /*essentially no timeout*/
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+
+    umock_c_reset_all_calls();
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+
+    {/*this scope happen in the first _DoWork call*/
+        tickcounter_ms_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+
+        STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
+        STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+            .IgnoreArgument(1);
+    }
+
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    {/*this scope happen in the second _DoWork call*/
+        tickcounter_ms_t timeIsNow = 999999999UL; /*some very big number*/
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+    }
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_001: [ If no message in waitingToSend can have timed out yet, IoTHubClient_LL_DoWork shall not walk the waitingToSend list. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_002: [ While waitingToSend is ordered by timeout, IoTHubClient_LL_DoWork shall stop at the first message with a timeout that has not timed out. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_before_the_earliest_timeout_does_not_time_out_messages)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*both messages are sent at time=10, they time out after 11*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE_2);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t eleven = 11; /*exactly on the edge, nothing times out*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &eleven, sizeof(eleven));
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_003: [ IoTHubClient_LL_DoWork shall remember the earliest timeout of the messages left in waitingToSend and whether they are still ordered by timeout. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_times_out_messages_when_messageTimeout_was_lowered)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t five = 5;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &five);
+
+    /*first message is sent at time=10 and times out after 15, the second one is sent at time=10 and times out after 11*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE_2);
+    umock_c_reset_all_calls();
+
+    {/*this scope happen in the first _DoWork call, only the second message times out*/
+        tickcounter_ms_t timeIsNow = 12;
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+        STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE_2));
+        STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+    }
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    {/*this scope happen in the second _DoWork call, the first message times out*/
+        tickcounter_ms_t timeIsNow = 16;
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+        STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE));
+        STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+    }
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_tickcounter_fails_in_do_work_no_timeout_callbacks_are_called) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
+    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
+    "the message has been received at time=10*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    umock_c_reset_all_calls();
+
+    {/*this scope happen in the _DoWork call*/
+        tickcounter_ms_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!! (well - normally - but here the code doesn't call any callbacks because time cannot be obtained*/
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow))
+            .SetReturn(__FAILURE__);
+    }
+
+    /*we don't care what happens in the Transport, so let's ignore all those calls*/
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+#ifndef DONT_USE_UPLOADTOBLOB
+/*Tests_SRS_IOTHUBCLIENT_LL_02_061: [ If iotHubClientHandle is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_handle_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(NULL, "irrelevantFileName", (const unsigned char*)"a", 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    ///cleanup
+}
+#endif
+
+#ifndef DONT_USE_UPLOADTOBLOB
+/*Tests_SRS_IOTHUBCLIENT_LL_02_062: [ If destinationFileName is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_fileName_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(h, NULL, (const unsigned char*)"a", 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_063: [ If source is NULL and size is greater than 0 then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_source_and_size_greater_than_0_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(h, "someFileName.txt", NULL, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+static void test_get_data_callback(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const ** data, size_t* size, void* context)
+{
+    (void)result;
+    (void)context;
+    if (data != NULL)
+    {
+        *data = NULL;
+    }
+    if (size != NULL)
+    {
+        *size = 0;
+    }
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_080: [ If handle, destinationFileName or getDataCallback is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_with_NULL_getDataCallback_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlob(h, "someFileName.txt", NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_081: [ IoTHubClient_LL_UploadMultipleBlocksToBlob shall upload the blocks of getDataCallback by calling Blob_UploadMultipleBlocksFromSasUri, then notify IoTHub as IoTHubClient_LL_UploadToBlob does. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlob_calls_IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IGNORED_PTR_ARG, "someFileName.txt", test_get_data_callback, (void*)0x42))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlob(h, "someFileName.txt", test_get_data_callback, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_083: [ If handle, destinationFileName or filePath is NULL then IoTHubClient_LL_UploadFileToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_with_NULL_filePath_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob(h, "someFileName.txt", NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_calls_IoTHubClient_LL_UploadFileToBlob_Impl)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadFileToBlob_Impl(IGNORED_PTR_ARG, "someFileName.txt", "/var/log/archive.tar"))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob(h, "someFileName.txt", "/var/log/archive.tar");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_093: [ If handle or items is NULL or itemCount is 0 then IoTHubClient_LL_UploadMultipleToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleToBlob_with_0_itemCount_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM items[1] = { { "someFileName.txt", NULL, 0, IOTHUB_CLIENT_ERROR } };
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleToBlob(h, items, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleToBlob_calls_IoTHubClient_LL_UploadMultipleToBlob_Impl)
+{
+    //arrange
+    IOTHUB_CLIENT_FILE_UPLOAD_BATCH_ITEM items[2] = { { "a.txt", NULL, 0, IOTHUB_CLIENT_ERROR }, { "b.txt", NULL, 0, IOTHUB_CLIENT_ERROR } };
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadMultipleToBlob_Impl(IGNORED_PTR_ARG, items, 2))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleToBlob(h, items, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_103: [ The upload to blob module shall be created by calling IoTHubClient_LL_UploadToBlob_Create the first time an upload function or an option given to it needs it, after which the copy of the configuration shall be freed. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_creates_the_upload_module_only_once)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_UploadFileToBlob(h, "a.txt", "/var/log/a.log");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadFileToBlob_Impl(IGNORED_PTR_ARG, "b.txt", "/var/log/b.log"))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob(h, "b.txt", "/var/log/b.log");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_104: [ If IoTHubClient_LL_UploadToBlob_Create fails, the call that needed it shall fail and return IOTHUB_CLIENT_ERROR, and the module shall be created again by the next one. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_when_creating_the_upload_module_fails_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Create(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadFileToBlob_Impl(IGNORED_PTR_ARG, "someFileName.txt", "/var/log/archive.tar"))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_LL_UploadFileToBlob(h, "someFileName.txt", "/var/log/archive.tar");
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_UploadFileToBlob(h, "someFileName.txt", "/var/log/archive.tar");
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+#endif 
+
+/* Tests_SRS_IOTHUBCLIENT_LL_10_016: [ Otherwise IoTHubClient_LL_SendReportedState shall succeed and return IOTHUB_CLIENT_OK.] */
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    setup_iothubclient_ll_sendreportedstate_mocks();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_10_012: [ IoTHubClient_LL_SendReportedState shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL. ] */
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_NULL_fails)
+{
+    //arrange
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(NULL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_10_013: [ IoTHubClient_LL_SendReportedState shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter reportedState is NULL] */
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_reported_state_NULL_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, NULL, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_reported_size_0_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, 0, iothub_reported_state_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_10_015: [ If any error is encountered IoTHubClient_LL_SendReportedState shall return IOTHUB_CLIENT_ERROR.] */
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_fail)
+{
+    //arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    setup_iothubclient_ll_sendreportedstate_mocks();
+
+    umock_c_negative_tests_snapshot();
+
+    size_t calls_cannot_fail[] = { 4 };
+
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+        {
+            continue;
+        }
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[128];
+        sprintf(tmp_msg, "IoTHubClient_LL_SendReportedState failure in test %zu/%zu", index, count);
+
+        //act
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result, tmp_msg);
+    }
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+    umock_c_negative_tests_deinit();
+}
+
+
+/*Tests_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClient_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
+/*Tests_SRS_IOTHUBCLIENT_LL_07_011: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_OK IoTHubClient_LL_DoWork shall add the IOTHUB_QUEUE_DATA_ITEM to the ack queue. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_SendReportedState_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
+        .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument_item_type()
+        .IgnoreArgument(3);
+
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, h))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_07_010: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_CONTINUE or IOTHUB_PROCESS_NOT_CONNECTED IoTHubClient_LL_DoWork shall continue on to call the underlaying layer's _DoWork function. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_SendReportedState_continue_processing_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
+        .IgnoreArgument_tick_counter()
+        .IgnoreArgument_current_ms();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument_item_type()
+        .IgnoreArgument(3)
+        .SetReturn(IOTHUB_PROCESS_CONTINUE);
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, h))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_12_017: [ `IoTHubClient_LL_SetDeviceMethodCallback` shall fail and return `IOTHUB_CLIENT_INVALID_ARG` if parameter `iotHubClientHandle` is `NULL`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_with_NULL_iotHubClientHandle_fails)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(NULL, deviceMethodCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_12_018: [ If `deviceMethodCallback` is `NULL`, then `IoTHubClient_LL_SetDeviceMethodCallback` shall call the underlying layer's `IoTHubTransport_Unsubscribe_DeviceMethod` function and return `IOTHUB_CLIENT_OK`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_with_NULL_callback_Unsubscribe_and_succeeds)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, NULL, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_10_028: [If the user has subscribed using IoTHubClient_LL_SetDeviceMethodCallback_Ex, IoTHubClient_LL_SetDeviceMethodCallback shall fail and return IOTHUB_CLIENT_ERROR. ] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_with_NULL_callback_Unsubscribe_After_SetDeviceMethodCallback_Ex_fail)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback_Ex(handle, iothub_client_inbound_device_method_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, NULL, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_10_029: [ If deviceMethodCallback is NULL and the client is not subscribed to receive method calls, IoTHubClient_LL_SetDeviceMethodCallback shall fail and return IOTHUB_CLIENT_ERROR. ] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_unitialized_with_NULL_callback_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback(NULL, deviceMethodCallback, (void*)1);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, NULL, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_12_019: [ If `deviceMethodCallback` is not `NULL`, then `IoTHubClient_LL_SetDeviceMethodCallback` shall call the underlying layer's `IoTHubTransport_Subscribe_DeviceMethod` function. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_with_non_NULL_succeeds)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_10_028: [If the user has subscribed using IoTHubClient_LL_SetDeviceMethodCallback_Ex, IoTHubClient_LL_SetDeviceMethodCallback shall fail and return IOTHUB_CLIENT_ERROR. ] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_After_SetDeviceMethodCallback_Ex_fail)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback_Ex(handle, iothub_client_inbound_device_method_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_12_020: [ If the underlying layer's `IoTHubTransport_Subscribe_DeviceMethod` function fails, then `IoTHubClient_LL_SetDeviceMethodCallback` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_12_021: [ If adding the information fails for any reason, `IoTHubClient_LL_SetDeviceMethodCallback` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_fails_when_underlying_transport_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(1);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_07_003: [ IoTHubClient_LL_ReportedStateComplete shall enumerate through the IOTHUB_DEVICE_TWIN structures in queue_handle. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_07_009: [ IoTHubClient_LL_ReportedStateComplete shall remove the IOTHUB_QUEUE_DATA_ITEM item from the ack queue.]*/
+TEST_FUNCTION(IoTHubClient_LL_ReportedStateComplete_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    IoTHubClient_LL_DoWork(h);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(iothub_reported_state_callback(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_ReportedStateComplete(h, 2, TEST_DEVICE_STATUS_CODE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_07_002: [ if handle is NULL then IoTHubClient_LL_ReportedStateComplete shall do nothing. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ReportedStateComplete_NULL_fail)
+{
+    //arrange
+
+    //act
+    IoTHubClient_LL_ReportedStateComplete(NULL, 2, TEST_DEVICE_STATUS_CODE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_046: [ If optionName is OPTION_COALESCE_REPORTED_STATE, IoTHubClient_LL_SetOption shall enable or disable, as the bool pointed to by value says, the coalescing of the reported states sent afterwards and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_coalesce_reported_state_succeeds)
+{
+    //arrange
+    bool coalesce = true;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_COALESCE_REPORTED_STATE, &coalesce);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_047: [ While the coalescing is enabled, if iot_msg_queue is not empty, IoTHubClient_LL_SendReportedState shall combine the reported state of its last item with reportedState by calling json_merge_patch_combine, replace the reported state of the item with the result, keep reportedStateCallback and userContextCallback with the item and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_with_coalescing_merges_into_the_pending_reported_state)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pending_reported_state();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(json_merge_patch_combine(IGNORED_PTR_ARG, TEST_REPORTED_STATE, TEST_REPORTED_SIZE));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_047: [ While the coalescing is enabled, if iot_msg_queue is not empty, IoTHubClient_LL_SendReportedState shall combine the reported state of its last item with reportedState by calling json_merge_patch_combine, replace the reported state of the item with the result, keep reportedStateCallback and userContextCallback with the item and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_with_coalescing_and_NULL_callback_merges_without_allocating)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pending_reported_state();
+
+    STRICT_EXPECTED_CALL(json_merge_patch_combine(IGNORED_PTR_ARG, TEST_REPORTED_STATE, TEST_REPORTED_SIZE));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_048: [ If the reported states cannot be combined or any error occurs, IoTHubClient_LL_SendReportedState shall leave the last item unchanged and queue reportedState in a new item. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_with_coalescing_queues_a_new_item_when_the_merge_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pending_reported_state();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(json_merge_patch_combine(IGNORED_PTR_ARG, TEST_REPORTED_STATE, TEST_REPORTED_SIZE))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    setup_iothubclient_ll_sendreportedstate_mocks();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_047: [ While the coalescing is enabled, if iot_msg_queue is not empty, IoTHubClient_LL_SendReportedState shall combine the reported state of its last item with reportedState by calling json_merge_patch_combine, replace the reported state of the item with the result, keep reportedStateCallback and userContextCallback with the item and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_with_coalescing_does_not_merge_into_a_sent_reported_state)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pending_reported_state();
+    IoTHubClient_LL_DoWork(handle);
+    umock_c_reset_all_calls();
+
+    setup_iothubclient_ll_sendreportedstate_mocks();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_049: [ IoTHubClient_LL_ReportedStateComplete shall then call, in the order they were sent, the callbacks of the reported states merged into the item with status_code. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ReportedStateComplete_calls_the_callbacks_of_the_merged_reported_states)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pending_reported_state();
+    (void)IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)2);
+    (void)IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)3);
+    IoTHubClient_LL_DoWork(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(iothub_reported_state_callback(TEST_DEVICE_STATUS_CODE, (void*)1));
+    STRICT_EXPECTED_CALL(iothub_reported_state_callback(TEST_DEVICE_STATUS_CODE, (void*)2));
+    STRICT_EXPECTED_CALL(iothub_reported_state_callback(TEST_DEVICE_STATUS_CODE, (void*)3));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_ReportedStateComplete(handle, 2, TEST_DEVICE_STATUS_CODE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_050: [ If optionName is OPTION_TWIN_WINDOW, IoTHubClient_LL_SetOption shall store the IOTHUB_CLIENT_TWIN_WINDOW pointed to by value, a maxInFlight of 0 giving all the items of iot_msg_queue to the transport again, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_twin_window_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_WINDOW window = { 2, 30 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_TWIN_WINDOW, &window);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_145: [ Otherwise IoTHubClient_LL_SetOption shall replace the twin cache by one created with twin_cache_create and fileName and return IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR if it fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_twin_cache_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_CONFIG config = { true, TEST_TWIN_CACHE_FILE_NAME };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(twin_cache_create(TEST_TWIN_CACHE_FILE_NAME));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_TWIN_CACHE, &config);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_145: [ Otherwise IoTHubClient_LL_SetOption shall replace the twin cache by one created with twin_cache_create and fileName and return IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR if it fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_twin_cache_create_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_CONFIG config = { true, NULL };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(twin_cache_create(NULL))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_TWIN_CACHE, &config);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_144: [ If optionName is OPTION_TWIN_CACHE and enabled is false, IoTHubClient_LL_SetOption shall destroy the twin cache, if any, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_twin_cache_disabled_destroys_the_cache)
+{
+    //arrange
+    IOTHUB_CLIENT_TWIN_CACHE_CONFIG config = { false, NULL };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_twin_cache();
+
+    STRICT_EXPECTED_CALL(twin_cache_destroy(TEST_TWIN_CACHE_HANDLE));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_TWIN_CACHE, &config);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_052: [ While the twin window is set, IoTHubClient_LL_DoWork shall leave the items of iot_msg_queue queued once maxInFlight items wait for their acknowledgement. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_twin_window_leaves_the_items_above_maxInFlight_queued)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_twin_window(0);
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_052: [ While the twin window is set, IoTHubClient_LL_DoWork shall leave the items of iot_msg_queue queued once maxInFlight items wait for their acknowledgement. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_twin_window_gives_the_next_item_once_acknowledged)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_twin_window(0);
+    IoTHubClient_LL_DoWork(handle);
+    IoTHubClient_LL_ReportedStateComplete(handle, 2, TEST_DEVICE_STATUS_CODE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_053: [ If ackTimeoutInSeconds is not 0, IoTHubClient_LL_DoWork shall set the item to time out ackTimeoutInSeconds after it was given to the transport. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_054: [ IoTHubClient_LL_DoWork shall call the callbacks of the items of iot_ack_queue that timed out with TWIN_ACK_TIMEOUT_STATUS_CODE, then remove and destroy them. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_with_twin_window_times_out_the_unacknowledged_item)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_twin_window(1);
+    IoTHubClient_LL_DoWork(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*2000 ms after the item was given to the transport*/
+    STRICT_EXPECTED_CALL(iothub_reported_state_callback(408, (void*)1));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, handle))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_018: [ If deviceMethodCallback is not NULL IoTHubClient_LL_DeviceMethodComplete shall execute deviceMethodCallback and return the status. ] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(h, deviceMethodCallback, (void*)1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    umock_c_reset_all_calls();
+
+    size_t len = 1;
+    unsigned char* resp = (unsigned char*)my_gballoc_malloc(len);
+    resp[0] = 0xa;
+
+    STRICT_EXPECTED_CALL(deviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_method_name()
+        .IgnoreArgument_payload()
+        .IgnoreArgument_size()
+        .IgnoreArgument_userContextCallback()
+        .CopyOutArgumentBuffer_response(&resp, sizeof(unsigned char**))
+        .CopyOutArgumentBuffer_resp_size(&len, sizeof(size_t));
+
+    EXPECTED_CALL(FAKE_IoTHubTransport_DeviceMethod_Response(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+
+    //act
+    int status = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, status);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_018: [ If deviceMethodCallback is not NULL IoTHubClient_LL_DeviceMethodComplete shall execute deviceMethodCallback and return the status. ] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_payload_NULL_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(h, deviceMethodCallback, (void*)1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    umock_c_reset_all_calls();
+
+    size_t len = 0;
+    unsigned char* resp = NULL;
+
+    STRICT_EXPECTED_CALL(deviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_method_name()
+        .IgnoreArgument_payload()
+        .IgnoreArgument_size()
+        .IgnoreArgument_userContextCallback()
+        .CopyOutArgumentBuffer_response(&resp, sizeof(unsigned char**))
+        .CopyOutArgumentBuffer_resp_size(&len, sizeof(size_t));
+
+    //act
+    int status = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, status);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_Async_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(iothub_client_inbound_device_method_callback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    int status = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, status);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_019: [ If deviceMethodCallback is NULL IoTHubClient_LL_DeviceMethodComplete shall return 404. ] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_No_callback_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    int result = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_017: [ If `handle` or response is NULL then `IoTHubClient_LL_DeviceMethodComplete` shall return 500. ] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_handle_NULL_succeed)
+{
+    //arrange
+
+    //act
+    int result = IoTHubClient_LL_DeviceMethodComplete(NULL, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_001: [ IoTHubClient_LL_SetDeviceTwinCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinCallback_iothubclienthandle_NULL_fail)
+{
+    //arrange
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(NULL, iothub_device_twin_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClient_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_COMPLETE, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_update_state()
+        .IgnoreArgument_userContextCallback()
+        .IgnoreArgument_payLoad()
+        .IgnoreArgument_size();
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_013: [ If handle is NULL then IoTHubClient_LL_RetrievePropertyComplete shall do nothing.] */
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_iothubclienthandle_NULL_fail)
+{
+    //arrange
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(NULL, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_014: [ If deviceTwinCallback is NULL then IoTHubClient_LL_RetrievePropertyComplete shall do nothing.] */
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_deviceTwincallback_NULL_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_015: [ If the the update_state parameter is DEVICE_TWIN_UPDATE_PARTIAL and a DEVICE_TWIN_UPDATE_COMPLETE has not been previously recieved then IoTHubClient_LL_RetrievePropertyComplete shall do nothing.] */
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_update_partial_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_PARTIAL, NULL, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClient_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_update_partial_before_complete_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_PARTIAL, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_update_state()
+        .IgnoreArgument_userContextCallback()
+        .IgnoreArgument_payLoad()
+        .IgnoreArgument_size();
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_PARTIAL, NULL, 0);
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_146: [ While the twin cache is enabled, IoTHubClient_LL_RetrievePropertyComplete shall give the document to twin_cache_update and call deviceTwinCallback with it if the result is TWIN_CACHE_DELIVER, with DEVICE_TWIN_UPDATE_PARTIAL and the patch if it is TWIN_CACHE_DELIVER_PATCH and not at all if it is TWIN_CACHE_SKIP. ]*/
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_with_twin_cache_delivers_the_document)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = create_client_with_twin_cache();
+
+    STRICT_EXPECTED_CALL(twin_cache_update(TEST_TWIN_CACHE_HANDLE, DEVICE_TWIN_UPDATE_COMPLETE, IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_COMPLETE, IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)"{}", 2);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_146: [ While the twin cache is enabled, IoTHubClient_LL_RetrievePropertyComplete shall give the document to twin_cache_update and call deviceTwinCallback with it if the result is TWIN_CACHE_DELIVER, with DEVICE_TWIN_UPDATE_PARTIAL and the patch if it is TWIN_CACHE_DELIVER_PATCH and not at all if it is TWIN_CACHE_SKIP. ]*/
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_with_twin_cache_delivers_the_patch)
+{
+    //arrange
+    char* patch = (char*)"{\"a\":2,\"$version\":2}";
+    IOTHUB_CLIENT_LL_HANDLE h = create_client_with_twin_cache();
+
+    STRICT_EXPECTED_CALL(twin_cache_update(TEST_TWIN_CACHE_HANDLE, DEVICE_TWIN_UPDATE_COMPLETE, IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_patch(&patch, sizeof(patch))
+        .SetReturn(TWIN_CACHE_DELIVER_PATCH);
+    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_PARTIAL, IGNORED_PTR_ARG, strlen(patch), IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(twin_cache_free_patch(patch));
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)"{}", 2);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_146: [ While the twin cache is enabled, IoTHubClient_LL_RetrievePropertyComplete shall give the document to twin_cache_update and call deviceTwinCallback with it if the result is TWIN_CACHE_DELIVER, with DEVICE_TWIN_UPDATE_PARTIAL and the patch if it is TWIN_CACHE_DELIVER_PATCH and not at all if it is TWIN_CACHE_SKIP. ]*/
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_with_twin_cache_skips_the_document)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = create_client_with_twin_cache();
+
+    STRICT_EXPECTED_CALL(twin_cache_update(TEST_TWIN_CACHE_HANDLE, DEVICE_TWIN_UPDATE_COMPLETE, IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
+        .SetReturn(TWIN_CACHE_SKIP);
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)"{}", 2);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_006: [ If deviceTwinCallback is NULL, then IoTHubClient_LL_SetDeviceTwinCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinCallback_unsubscribe_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe_DeviceTwin(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_002: [ If deviceTwinCallback is not NULL, then IoTHubClient_LL_SetDeviceTwinCallback shall call the underlying layer's _Subscribe function.] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinCallback_subscribe_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceTwin(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_003: [ If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetDeviceTwinCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinCallback_subscribe_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceTwin(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .SetReturn(__FAILURE__);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_134: [ If iotHubClientHandle is NULL, or deviceTwinChunkCallback is not NULL and chunkSize is 0, IoTHubClient_LL_SetDeviceTwinChunkCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinChunkCallback_invalid_args_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinChunkCallback(NULL, 16, test_device_twin_chunk_callback, NULL);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SetDeviceTwinChunkCallback(h, 0, test_device_twin_chunk_callback, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_135: [ IoTHubClient_LL_SetDeviceTwinChunkCallback shall subscribe or unsubscribe as IoTHubClient_LL_SetDeviceTwinCallback does, with a callback giving the documents to deviceTwinChunkCallback, and return its result. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_136: [ The twin documents shall be given to deviceTwinChunkCallback in order, in chunks of at most chunkSize bytes pointing in the buffer of the transport, with isLast true for the last one and once with size 0 for an empty document. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinChunkCallback_gives_the_document_in_chunks)
+{
+    //arrange
+    static const unsigned char document[] = { '{', '"', 'a', '"', ':', '1', '}' };
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceTwin(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(test_device_twin_chunk_callback(DEVICE_TWIN_UPDATE_COMPLETE, document, 3, 0, false, (void*)1));
+    STRICT_EXPECTED_CALL(test_device_twin_chunk_callback(DEVICE_TWIN_UPDATE_COMPLETE, document + 3, 3, 3, false, (void*)1));
+    STRICT_EXPECTED_CALL(test_device_twin_chunk_callback(DEVICE_TWIN_UPDATE_COMPLETE, document + 6, 1, 6, true, (void*)1));
+    STRICT_EXPECTED_CALL(test_device_twin_chunk_callback(DEVICE_TWIN_UPDATE_PARTIAL, NULL, 0, 0, true, (void*)1));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinChunkCallback(h, 3, test_device_twin_chunk_callback, (void*)1);
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, document, sizeof(document));
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_PARTIAL, NULL, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_135: [ IoTHubClient_LL_SetDeviceTwinChunkCallback shall subscribe or unsubscribe as IoTHubClient_LL_SetDeviceTwinCallback does, with a callback giving the documents to deviceTwinChunkCallback, and return its result. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinChunkCallback_NULL_unsubscribes)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetDeviceTwinChunkCallback(h, 3, test_device_twin_chunk_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe_DeviceTwin(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinChunkCallback(h, 0, NULL, NULL);
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Test_SRS_IOTHUBCLIENT_LL_07_021: [ If handle is NULL then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_handle_NULL_fail)
+{
+    //arrange
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(NULL, iothub_client_inbound_device_method_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_07_025: [ If any error is encountered then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall return IOTHUB_CLIENT_ERROR.] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_subscribe_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(__FAILURE__);
 
     //act
-    IoTHubClient_LL_DoWork(handle);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
 
-    ///assert
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_calls_2_timeouts) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+/* Tests_SRS_IOTHUBCLIENT_LL_07_022: [ If inboundDeviceMethodCallback is NULL then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall call the underlying layer's IoTHubTransport_Unsubscribe_DeviceMethod function and return IOTHUB_CLIENT_OK.] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_inbound_device_method_cb_NULL_succeed)
 {
     //arrange
-
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    tickcounter_ms_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
-
-    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    tickcounter_ms_t ten = 10;
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
-
-    tickcounter_ms_t two = 2;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &two);
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
 
     umock_c_reset_all_calls();
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-
-    tickcounter_ms_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
-
-    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
-        .IgnoreArgument(1);
-
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
-
-    timeIsNow = 13; /*13 > 10 (receive time) + 2 (timeout) => timeout!!!*/
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
-
-    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)(TEST_DEVICEMESSAGE_HANDLE_2))); /*calling the callback*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe_DeviceMethod(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
-
-
-    /*because we're at time = 13 in this test, the second message times out too*/
-
     //act
-    IoTHubClient_LL_DoWork(handle);
-    IoTHubClient_LL_DoWork(handle);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, NULL, 0);
 
-    ///assert
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClient_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClient_LL shall not have their timeouts modified by a new call to IoTHubClient_LL_SetOption. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_one_with_timeout_one_without_call_1_callback) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+/* Tests_SRS_IOTHUBCLIENT_LL_10_031: [If the user has subscribed using IoTHubClient_LL_SetDeviceMethodCallback, IoTHubClient_LL_SetDeviceMethodCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. ] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_inbound_device_method_cb_NULL_After_SetDeviceMethodCallback_fail)
 {
     //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback(h, deviceMethodCallback, (void*)1);
+    umock_c_reset_all_calls();
 
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    tickcounter_ms_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, NULL, 0);
 
-    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    tickcounter_ms_t ten = 10;
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    tickcounter_ms_t zero = 0;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &zero); /*essentially no timeout*/
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
 
+/* Tests_SRS_IOTHUBCLIENT_LL_10_030: [ If deviceMethodCallback is NULL and the client is not subscribed to receive method calls, IoTHubClient_LL_SetDeviceMethodCallback shall fail and return IOTHUB_CLIENT_ERROR. ] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_uninitialized_inbound_device_method_cb_NULL_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-
-    {/*this scope happen in the first _DoWork call*/
-        tickcounter_ms_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
-        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, NULL, 0);
 
-        STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)) /*this is removing the item from waitingToSend*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE)); /*calling the callback*/
-        STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)) /*destroying the message clone*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*destroying the IOTHUB_MESSAGE_LIST*/
-            .IgnoreArgument(1);
-    }
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
 
-    {/*this scope happen in the second _DoWork call*/
-        tickcounter_ms_t timeIsNow = 999999999UL; /*some very big number*/
-        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow));
-    }
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+/* Tests_SRS_IOTHUBCLIENT_LL_10_031: [If the user has subscribed using IoTHubClient_LL_SetDeviceMethodCallback, IoTHubClient_LL_SetDeviceMethodCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. ] */
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_After_SetDeviceMethodCallback_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetDeviceMethodCallback(h, deviceMethodCallback, (void*)1);
+    umock_c_reset_all_calls();
 
     //act
-    IoTHubClient_LL_DoWork(handle);
-    IoTHubClient_LL_DoWork(handle);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
 
-    ///assert
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetOption_messageTimeout_when_tickcounter_fails_in_do_work_no_timeout_callbacks_are_called) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
+/* Tests_SRS_IOTHUBCLIENT_LL_07_023: [ If inboundDeviceMethodCallback is non-NULL then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall call the underlying layer's IoTHubTransport_Subscribe_DeviceMethod function.]*/
+TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_succeed)
 {
     //arrange
-
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    tickcounter_ms_t one = 1;
-    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
-
-    /*send 2 messages that will expire at 12 and 13, both of these messages are send at time=10*/
-    /*because sending messages stamps the message's timeout, the call to tickcounter_get_current_ms needs to be here, so the test can says
-    "the message has been received at time=10*/
-    tickcounter_ms_t ten = 10;
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
-    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
-
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    {/*this scope happen in the _DoWork call*/
-        tickcounter_ms_t timeIsNow = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!! (well - normally - but here the code doesn't call any callbacks because time cannot be obtained*/
-        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &timeIsNow, sizeof(timeIsNow))
-            .SetReturn(__FAILURE__);
-    }
-
-    /*we don't care what happens in the Transport, so let's ignore all those calls*/
-    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllCalls();
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //act
-    IoTHubClient_LL_DoWork(handle);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
 
-    ///assert
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
 }
 
-#ifndef DONT_USE_UPLOADTOBLOB
-/*Tests_SRS_IOTHUBCLIENT_LL_02_061: [ If iotHubClientHandle is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
-TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_handle_fails)
+/* Tests_SRS_IOTHUBCLIENT_LL_07_026: [ If handle or methodId is NULL then IoTHubClient_LL_DeviceMethodResponse shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodResponse_handle_NULL_fail)
 {
     //arrange
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(NULL, "irrelevantFileName", (const unsigned char*)"a", 1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_DeviceMethodResponse(NULL, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
 }
-#endif
 
-#ifndef DONT_USE_UPLOADTOBLOB
-/*Tests_SRS_IOTHUBCLIENT_LL_02_062: [ If destinationFileName is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
-TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_fileName_fails)
+/* Tests_SRS_IOTHUBCLIENT_LL_07_026: [ If handle or methodId is NULL then IoTHubClient_LL_DeviceMethodResponse shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodResponse_method_id_NULL_fail)
 {
     //arrange
     IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(h, NULL, (const unsigned char*)"a", 1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_DeviceMethodResponse(h, NULL, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_02_063: [ If source is NULL and size is greater than 0 then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
-TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_with_NULL_source_and_size_greater_than_0_fails)
+/* Tests_SRS_IOTHUBCLIENT_LL_07_026: [ If handle or methodId is NULL then IoTHubClient_LL_DeviceMethodResponse shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodResponse_IoTHubTransport_DeviceMethod_Response_FAILS_fail)
 {
     //arrange
     IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DeviceMethod_Response(IGNORED_PTR_ARG, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE)).SetReturn(__FAILURE__);
+
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob(h, "someFileName.txt", NULL, 1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_DeviceMethodResponse(h, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(h);
 }
-#endif 
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_016: [ Otherwise IoTHubClient_LL_SendReportedState shall succeed and return IOTHUB_CLIENT_OK.] */
-TEST_FUNCTION(IoTHubClient_LL_SendReportedState_succeeds)
+/* Tests_SRS_IOTHUBCLIENT_LL_07_027: [ IoTHubClient_LL_DeviceMethodResponse shall call the IoTHubTransport_DeviceMethod_Response transport function.] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodResponse_succeed)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    setup_iothubclient_ll_sendreportedstate_mocks();
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DeviceMethod_Response(IGNORED_PTR_ARG, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE))
+        .IgnoreArgument(1);
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_DeviceMethodResponse(h, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(handle);
+    IoTHubClient_LL_Destroy(h);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_012: [ IoTHubClient_LL_SendReportedState shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL. ] */
-TEST_FUNCTION(IoTHubClient_LL_SendReportedState_NULL_fails)
+
+/* Tests_SRS_IOTHUBCLIENT_LL_25_120: [If iotHubClientHandle, retryPolicy or retryTimeoutLimitinSeconds is NULL, IoTHubClient_LL_GetRetryPolicy shall return IOTHUB_CLIENT_INVALID_ARG ] */
+TEST_FUNCTION(IoTHubClient_LL_GetRetryPolicy_NULL_HANDLEParam_fail)
 {
     //arrange
-    umock_c_reset_all_calls();
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(NULL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetRetryPolicy(NULL, NULL, NULL);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///cleanup
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_013: [ IoTHubClient_LL_SendReportedState shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter reportedState is NULL] */
-TEST_FUNCTION(IoTHubClient_LL_SendReportedState_reported_state_NULL_fail)
+/* Tests_SRS_IOTHUBCLIENT_LL_25_120: [If iotHubClientHandle, retryPolicy or retryTimeoutLimitinSeconds is NULL, IoTHubClient_LL_GetRetryPolicy shall return `IOTHUB_CLIENT_INVALID_ARG ] */
+TEST_FUNCTION(IoTHubClient_LL_GetRetryPolicy_NULL_RetryPolicyParam_fail)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, NULL, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetRetryPolicy(h, NULL, NULL);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
 }
 
-TEST_FUNCTION(IoTHubClient_LL_SendReportedState_reported_size_0_fail)
+/* Tests_SRS_IOTHUBCLIENT_LL_25_120: [If iotHubClientHandle, retryPolicy or retryTimeoutLimitinSeconds is NULL, IoTHubClient_LL_GetRetryPolicy shall return `IOTHUB_CLIENT_INVALID_ARG ] */
+TEST_FUNCTION(IoTHubClient_LL_GetRetryPolicy_NULL_SizeParam_fail)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, 0, iothub_reported_state_callback, NULL);
+    IOTHUB_CLIENT_RETRY_POLICY r;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetRetryPolicy(h, &r, NULL);
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
-}
-
-/* Tests_SRS_IOTHUBCLIENT_LL_10_015: [ If any error is encountered IoTHubClient_LL_SendReportedState shall return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SendReportedState_fail)
-{
-    //arrange
-    int negativeTestsInitResult = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
-
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
-
-    setup_iothubclient_ll_sendreportedstate_mocks();
-
-    umock_c_negative_tests_snapshot();
-
-    size_t calls_cannot_fail[] = { 4 };
-
-    size_t count = umock_c_negative_tests_call_count();
-    for (size_t index = 0; index < count; index++)
-    {
-        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
-        {
-            continue;
-        }
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(index);
-
-        char tmp_msg[128];
-        sprintf(tmp_msg, "IoTHubClient_LL_SendReportedState failure in test %zu/%zu", index, count);
-
-        //act
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(handle, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
-
-        //assert
-        ASSERT_ARE_NOT_EQUAL_WITH_MSG(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result, tmp_msg);
-    }
-
     //cleanup
-    IoTHubClient_LL_Destroy(handle);
-    umock_c_negative_tests_deinit();
+    IoTHubClient_LL_Destroy(h);
 }
 
-
-/*Tests_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClient_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
-/*Tests_SRS_IOTHUBCLIENT_LL_07_011: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_OK IoTHubClient_LL_DoWork shall add the IOTHUB_QUEUE_DATA_ITEM to the ack queue. ]*/
-TEST_FUNCTION(IoTHubClient_LL_DoWork_SendReportedState_succeed)
+/* Tests_SRS_IOTHUBCLIENT_LL_25_121: [IoTHubClient_LL_GetRetryPolicy shall retrieve connection retry policy from retryPolicy in struct IOTHUB_CLIENT_LL_HANDLE_DATA] */
+/* Tests_SRS_IOTHUBCLIENT_LL_25_122: [IoTHubClient_LL_GetRetryPolicy shall retrieve retryTimeoutLimit in seconds from retryTimeoutinSeconds in struct IOTHUB_CLIENT_LL_HANDLE_DATA] */
+TEST_FUNCTION(IoTHubClient_LL_GetRetryPolicy_succeed)
 {
     //arrange
     IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
-        .IgnoreAllArguments();
-
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument_item_type()
-        .IgnoreArgument(3);
-
-    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, h))
-        .IgnoreArgument(1);
-
     //act
-    IoTHubClient_LL_DoWork(h);
+    IOTHUB_CLIENT_RETRY_POLICY r;
+    size_t s;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetRetryPolicy(h, &r, &s);
 
-    ///assert
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_07_010: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_CONTINUE or IOTHUB_PROCESS_NOT_CONNECTED IoTHubClient_LL_DoWork shall continue on to call the underlaying layer's _DoWork function. ]*/
-TEST_FUNCTION(IoTHubClient_LL_DoWork_SendReportedState_continue_processing_succeed)
+TEST_FUNCTION(IoTHubClient_LL_SetOption_product_info_twice_succeeds)
 {
     //arrange
     IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
-        .IgnoreArgument_tick_counter()
-        .IgnoreArgument_current_ms();
-
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument_item_type()
-        .IgnoreArgument(3)
-        .SetReturn(IOTHUB_PROCESS_CONTINUE);
-
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, h))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(platform_get_platform_info());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(platform_get_platform_info());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 
     //act
-    IoTHubClient_LL_DoWork(h);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
+    if (result == IOTHUB_CLIENT_OK)
+    {
+        result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
+    }
 
-    ///assert
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_12_017: [ `IoTHubClient_LL_SetDeviceMethodCallback` shall fail and return `IOTHUB_CLIENT_INVALID_ARG` if parameter `iotHubClientHandle` is `NULL`. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_with_NULL_iotHubClientHandle_fails)
-{
-    ///arrange
-
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(NULL, deviceMethodCallback, (void*)1);
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-}
-
-/*Tests_SRS_IOTHUBCLIENT_LL_12_018: [ If `deviceMethodCallback` is `NULL`, then `IoTHubClient_LL_SetDeviceMethodCallback` shall call the underlying layer's `IoTHubTransport_Unsubscribe_DeviceMethod` function and return `IOTHUB_CLIENT_OK`. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_with_NULL_callback_Unsubscribe_and_succeeds)
+TEST_FUNCTION(IoTHubClient_LL_SetOption_product_info_succeeds)
 {
-    ///arrange
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(platform_get_platform_info());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe_DeviceMethod(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, NULL, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_028: [If the user has subscribed using IoTHubClient_LL_SetDeviceMethodCallback_Ex, IoTHubClient_LL_SetDeviceMethodCallback shall fail and return IOTHUB_CLIENT_ERROR. ] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_with_NULL_callback_Unsubscribe_After_SetDeviceMethodCallback_Ex_fail)
+TEST_FUNCTION(IoTHubClient_LL_SetOption_product_info_fails_case2)
 {
-    ///arrange
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetDeviceMethodCallback_Ex(handle, iothub_client_inbound_device_method_callback, (void*)1);
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(platform_get_platform_info());
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, NULL, (void*)1);
+    //act
+    g_fail_platform_get_platform_info = true;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_029: [ If deviceMethodCallback is NULL and the client is not subscribed to receive method calls, IoTHubClient_LL_SetDeviceMethodCallback shall fail and return IOTHUB_CLIENT_ERROR. ] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_unitialized_with_NULL_callback_fails)
+TEST_FUNCTION(IoTHubClient_LL_SetOption_product_info_fails_case1)
 {
-    ///arrange
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetDeviceMethodCallback(NULL, deviceMethodCallback, (void*)1);
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(platform_get_platform_info());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, NULL, (void*)1);
+    //act
+    g_fail_string_construct_sprintf = true;
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
 
-    ///assert
+    //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_12_019: [ If `deviceMethodCallback` is not `NULL`, then `IoTHubClient_LL_SetDeviceMethodCallback` shall call the underlying layer's `IoTHubTransport_Subscribe_DeviceMethod` function. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_with_non_NULL_succeeds)
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_compression(size_t minimumSizeInBytes)
 {
-    ///arrange
+    IOTHUB_CLIENT_COMPRESSION compression;
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    compression.level = 6;
+    compression.minimumSizeInBytes = minimumSizeInBytes;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_COMPRESSION, &compression);
     umock_c_reset_all_calls();
+    return handle;
+}
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///cleanup
-    IoTHubClient_LL_Destroy(handle);
+static void setup_message_of_text(const char* text)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_STRING);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE))
+        .SetReturn(text);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_028: [If the user has subscribed using IoTHubClient_LL_SetDeviceMethodCallback_Ex, IoTHubClient_LL_SetDeviceMethodCallback shall fail and return IOTHUB_CLIENT_ERROR. ] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_After_SetDeviceMethodCallback_Ex_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_055: [ If optionName is OPTION_COMPRESSION, IoTHubClient_LL_SetOption shall replace the compressor by one made by compressor_create with the level of the IOTHUB_CLIENT_COMPRESSION pointed to by value, a level of 0 disabling compression, store minimumSizeInBytes and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_compression_creates_a_compressor)
 {
-    ///arrange
+    //arrange
+    IOTHUB_CLIENT_COMPRESSION compression = { 6, 100 };
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetDeviceMethodCallback_Ex(handle, iothub_client_inbound_device_method_callback, (void*)1);
     umock_c_reset_all_calls();
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
+    STRICT_EXPECTED_CALL(compressor_create(6));
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_COMPRESSION, &compression);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_12_020: [ If the underlying layer's `IoTHubTransport_Subscribe_DeviceMethod` function fails, then `IoTHubClient_LL_SetDeviceMethodCallback` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_12_021: [ If adding the information fails for any reason, `IoTHubClient_LL_SetDeviceMethodCallback` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_fails_when_underlying_transport_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_055: [ If optionName is OPTION_COMPRESSION, IoTHubClient_LL_SetOption shall replace the compressor by one made by compressor_create with the level of the IOTHUB_CLIENT_COMPRESSION pointed to by value, a level of 0 disabling compression, store minimumSizeInBytes and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_compression_level_0_destroys_the_compressor)
 {
-    ///arrange
-    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
+    //arrange
+    IOTHUB_CLIENT_COMPRESSION compression = { 0, 0 };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_compression(0);
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetReturn(1);
+    STRICT_EXPECTED_CALL(compressor_destroy(TEST_COMPRESSOR_HANDLE));
 
-    ///act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(handle, deviceMethodCallback, (void*)1);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_COMPRESSION, &compression);
 
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    ///cleanup
+    //cleanup
     IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_07_003: [ IoTHubClient_LL_ReportedStateComplete shall enumerate through the IOTHUB_DEVICE_TWIN structures in queue_handle. ]*/
-/*Tests_SRS_IOTHUBCLIENT_LL_07_009: [ IoTHubClient_LL_ReportedStateComplete shall remove the IOTHUB_QUEUE_DATA_ITEM item from the ack queue.]*/
-TEST_FUNCTION(IoTHubClient_LL_ReportedStateComplete_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_055: [ If optionName is OPTION_COMPRESSION, IoTHubClient_LL_SetOption shall replace the compressor by one made by compressor_create with the level of the IOTHUB_CLIENT_COMPRESSION pointed to by value, a level of 0 disabling compression, store minimumSizeInBytes and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_compression_with_invalid_level_fails)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-
-    IoTHubClient_LL_DoWork(h);
-
+    IOTHUB_CLIENT_COMPRESSION compression = { 10, 0 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(iothub_reported_state_callback(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-
-    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     //act
-    IoTHubClient_LL_ReportedStateComplete(h, 2, TEST_DEVICE_STATUS_CODE);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_COMPRESSION, &compression);
 
     //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_07_002: [ if handle is NULL then IoTHubClient_LL_ReportedStateComplete shall do nothing. ]*/
-TEST_FUNCTION(IoTHubClient_LL_ReportedStateComplete_NULL_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_056: [ If compressor_create fails, IoTHubClient_LL_SetOption shall keep the previous compression settings and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_compression_fails_when_compressor_create_fails)
 {
     //arrange
+    IOTHUB_CLIENT_COMPRESSION compression = { 9, 0 };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_compression(0);
+
+    STRICT_EXPECTED_CALL(compressor_create(9))
+        .SetReturn(NULL);
 
     //act
-    IoTHubClient_LL_ReportedStateComplete(NULL, 2, TEST_DEVICE_STATUS_CODE);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_COMPRESSION, &compression);
 
     //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_018: [ If deviceMethodCallback is not NULL IoTHubClient_LL_DeviceMethodComplete shall execute deviceMethodCallback and return the status. ] */
-TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_058: [ Otherwise IoTHubClient_LL_SendEventAsync shall send the gzip copy of the message made by compressor_compress_message instead of the message, and send the message as it is if compressor_compress_message returns NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_compression_sends_the_gzip_copy)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(h, deviceMethodCallback, (void*)1);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-
-    umock_c_reset_all_calls();
-
-    size_t len = 1;
-    unsigned char* resp = (unsigned char*)my_gballoc_malloc(len);
-    resp[0] = 0xa;
-
-    STRICT_EXPECTED_CALL(deviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument_method_name()
-        .IgnoreArgument_payload()
-        .IgnoreArgument_size()
-        .IgnoreArgument_userContextCallback()
-        .CopyOutArgumentBuffer_response(&resp, sizeof(unsigned char**))
-        .CopyOutArgumentBuffer_resp_size(&len, sizeof(size_t));
+    IOTHUB_MESSAGE_HANDLE expectedMessages[] = { TEST_COMPRESSED_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_compression(3);
 
-    EXPECTED_CALL(FAKE_IoTHubTransport_DeviceMethod_Response(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCompression(TEST_MESSAGE_HANDLE));
+    setup_message_of_text("three");
+    STRICT_EXPECTED_CALL(compressor_compress_message(TEST_COMPRESSOR_HANDLE, TEST_MESSAGE_HANDLE))
+        .SetReturn(TEST_COMPRESSED_MESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    int status = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
-    ASSERT_ARE_EQUAL(int, 0, status);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_waitingToSend_messages(expectedMessages, 1);
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_018: [ If deviceMethodCallback is not NULL IoTHubClient_LL_DeviceMethodComplete shall execute deviceMethodCallback and return the status. ] */
-TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_payload_NULL_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_057: [ While compression is enabled, IoTHubClient_LL_SendEventAsync shall send a message whose compression is IOTHUB_MESSAGE_COMPRESSION_NONE, or IOTHUB_MESSAGE_COMPRESSION_DEFAULT with a payload smaller than minimumSizeInBytes, as it is. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_compression_sends_a_small_message_as_it_is)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback(h, deviceMethodCallback, (void*)1);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_compression(10);
 
-    umock_c_reset_all_calls();
-
-    size_t len = 0;
-    unsigned char* resp = NULL;
-
-    STRICT_EXPECTED_CALL(deviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument_method_name()
-        .IgnoreArgument_payload()
-        .IgnoreArgument_size()
-        .IgnoreArgument_userContextCallback()
-        .CopyOutArgumentBuffer_response(&resp, sizeof(unsigned char**))
-        .CopyOutArgumentBuffer_resp_size(&len, sizeof(size_t));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCompression(TEST_MESSAGE_HANDLE));
+    setup_message_of_text("three");
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    int status = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
-    ASSERT_ARE_NOT_EQUAL(int, 0, status);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_Async_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_057: [ While compression is enabled, IoTHubClient_LL_SendEventAsync shall send a message whose compression is IOTHUB_MESSAGE_COMPRESSION_NONE, or IOTHUB_MESSAGE_COMPRESSION_DEFAULT with a payload smaller than minimumSizeInBytes, as it is. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_compression_NONE_sends_the_message_as_it_is)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
-    umock_c_reset_all_calls();
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_compression(0);
 
-    STRICT_EXPECTED_CALL(iothub_client_inbound_device_method_callback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCompression(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_MESSAGE_COMPRESSION_NONE);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    int status = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
-    ASSERT_ARE_EQUAL(int, 0, status);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_019: [ If deviceMethodCallback is NULL IoTHubClient_LL_DeviceMethodComplete shall return 404. ] */
-TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_No_callback_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_058: [ Otherwise IoTHubClient_LL_SendEventAsync shall send the gzip copy of the message made by compressor_compress_message instead of the message, and send the message as it is if compressor_compress_message returns NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_compression_GZIP_compresses_a_small_message)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_compression(1000);
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCompression(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_MESSAGE_COMPRESSION_GZIP);
+    STRICT_EXPECTED_CALL(compressor_compress_message(TEST_COMPRESSOR_HANDLE, TEST_MESSAGE_HANDLE))
+        .SetReturn(TEST_COMPRESSED_MESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    int result = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
-    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_017: [ If `handle` or response is NULL then `IoTHubClient_LL_DeviceMethodComplete` shall return 500. ] */
-TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_handle_NULL_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_058: [ Otherwise IoTHubClient_LL_SendEventAsync shall send the gzip copy of the message made by compressor_compress_message instead of the message, and send the message as it is if compressor_compress_message returns NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_compression_sends_the_message_as_it_is_when_it_does_not_compress)
 {
     //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_compression(0);
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCompression(TEST_MESSAGE_HANDLE));
+    setup_message_of_text("three");
+    STRICT_EXPECTED_CALL(compressor_compress_message(TEST_COMPRESSOR_HANDLE, TEST_MESSAGE_HANDLE))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    int result = IoTHubClient_LL_DeviceMethodComplete(NULL, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
-    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_001: [ IoTHubClient_LL_SetDeviceTwinCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL.] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinCallback_iothubclienthandle_NULL_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_059: [ If the gzip copy cannot be added, IoTHubClient_LL_SendEventAsync shall destroy it and fail with the error of adding it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_compression_destroys_the_gzip_copy_when_adding_it_fails)
 {
     //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_compression(0);
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCompression(TEST_MESSAGE_HANDLE));
+    setup_message_of_text("three");
+    STRICT_EXPECTED_CALL(compressor_compress_message(TEST_COMPRESSOR_HANDLE, TEST_MESSAGE_HANDLE))
+        .SetReturn(TEST_COMPRESSED_MESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_COMPRESSED_MESSAGE_HANDLE));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(NULL, iothub_device_twin_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClient_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
-TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_060: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall destroy eventMessageHandle once its gzip copy is added. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_with_compression_destroys_the_message)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, NULL);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_compression(0);
 
-    umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_COMPLETE, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument_update_state()
-        .IgnoreArgument_userContextCallback()
-        .IgnoreArgument_payLoad()
-        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCompression(TEST_MESSAGE_HANDLE));
+    setup_message_of_text("three");
+    STRICT_EXPECTED_CALL(compressor_compress_message(TEST_COMPRESSOR_HANDLE, TEST_MESSAGE_HANDLE))
+        .SetReturn(TEST_COMPRESSED_MESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
 
     //act
-    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_013: [ If handle is NULL then IoTHubClient_LL_RetrievePropertyComplete shall do nothing.] */
-TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_iothubclienthandle_NULL_fail)
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_pipeline(void)
+{
+    IOTHUB_CLIENT_MESSAGE_STAGE stage;
+    IOTHUB_CLIENT_MESSAGE_PIPELINE pipeline;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)memset(&stage, 0, sizeof(stage));
+    stage.type = IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE;
+    pipeline.stages = &stage;
+    pipeline.stageCount = 1;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_PIPELINE, &pipeline);
+    umock_c_reset_all_calls();
+    return handle;
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_148: [ If optionName is OPTION_MESSAGE_PIPELINE, IoTHubClient_LL_SetOption shall replace the pipeline by one made by message_pipeline_create with the IOTHUB_CLIENT_MESSAGE_PIPELINE pointed to by value, no stages removing it, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_pipeline_creates_a_pipeline)
 {
     //arrange
+    IOTHUB_CLIENT_MESSAGE_STAGE stage;
+    IOTHUB_CLIENT_MESSAGE_PIPELINE pipeline = { &stage, 1 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+    (void)memset(&stage, 0, sizeof(stage));
+    stage.type = IOTHUB_CLIENT_MESSAGE_STAGE_DEDUPE;
+
+    STRICT_EXPECTED_CALL(message_pipeline_create(&pipeline));
 
     //act
-    IoTHubClient_LL_RetrievePropertyComplete(NULL, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_PIPELINE, &pipeline);
 
     //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_014: [ If deviceTwinCallback is NULL then IoTHubClient_LL_RetrievePropertyComplete shall do nothing.] */
-TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_deviceTwincallback_NULL_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_148: [ If optionName is OPTION_MESSAGE_PIPELINE, IoTHubClient_LL_SetOption shall replace the pipeline by one made by message_pipeline_create with the IOTHUB_CLIENT_MESSAGE_PIPELINE pointed to by value, no stages removing it, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_pipeline_without_stages_destroys_the_pipeline)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_MESSAGE_PIPELINE pipeline = { NULL, 0 };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pipeline();
 
-    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(message_pipeline_destroy(TEST_PIPELINE_HANDLE));
 
     //act
-    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_PIPELINE, &pipeline);
 
     //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_015: [ If the the update_state parameter is DEVICE_TWIN_UPDATE_PARTIAL and a DEVICE_TWIN_UPDATE_COMPLETE has not been previously recieved then IoTHubClient_LL_RetrievePropertyComplete shall do nothing.] */
-TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_update_partial_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_149: [ If message_pipeline_create fails, IoTHubClient_LL_SetOption shall keep the previous pipeline and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_pipeline_fails_when_message_pipeline_create_fails)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, NULL);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    IOTHUB_CLIENT_MESSAGE_STAGE stage;
+    IOTHUB_CLIENT_MESSAGE_PIPELINE pipeline = { &stage, 1 };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pipeline();
+    (void)memset(&stage, 0, sizeof(stage));
 
-    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(message_pipeline_create(&pipeline))
+        .SetReturn(NULL);
 
     //act
-    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_PARTIAL, NULL, 0);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_PIPELINE, &pipeline);
 
     //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClient_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
-TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_update_partial_before_complete_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_150: [ While OPTION_MESSAGE_PIPELINE is set, IoTHubClient_LL_SendEventAsync shall give the message it queues, its clone or the message itself with IoTHubClient_LL_SendEventAsync_TakeOwnership, to message_pipeline_process with the current ms before compressing and queueing it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_pipeline_queues_the_clone_it_processed)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, NULL);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    IOTHUB_MESSAGE_HANDLE expectedMessages[] = { (IOTHUB_MESSAGE_HANDLE)0x44 };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pipeline();
 
-    umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_PARTIAL, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument_update_state()
-        .IgnoreArgument_userContextCallback()
-        .IgnoreArgument_payLoad()
-        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(message_pipeline_process(TEST_PIPELINE_HANDLE, (IOTHUB_MESSAGE_HANDLE)0x44, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_PARTIAL, NULL, 0);
-    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_waitingToSend_messages(expectedMessages, 1);
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_006: [ If deviceTwinCallback is NULL, then IoTHubClient_LL_SetDeviceTwinCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinCallback_unsubscribe_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_150: [ While OPTION_MESSAGE_PIPELINE is set, IoTHubClient_LL_SendEventAsync shall give the message it queues, its clone or the message itself with IoTHubClient_LL_SendEventAsync_TakeOwnership, to message_pipeline_process with the current ms before compressing and queueing it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_with_pipeline_processes_the_message_itself)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
+    IOTHUB_MESSAGE_HANDLE expectedMessages[] = { TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pipeline();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe_DeviceTwin(IGNORED_PTR_ARG))
-        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_pipeline_process(TEST_PIPELINE_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, NULL, NULL);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_waitingToSend_messages(expectedMessages, 1);
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_002: [ If deviceTwinCallback is not NULL, then IoTHubClient_LL_SetDeviceTwinCallback shall call the underlying layer's _Subscribe function.] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinCallback_subscribe_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_151: [ If message_pipeline_process returns IOTHUB_CLIENT_MESSAGE_STAGE_DROP, IoTHubClient_LL_SendEventAsync shall destroy the message it would have queued, call the confirmation callback with IOTHUB_CLIENT_CONFIRMATION_OK and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_pipeline_confirms_a_dropped_message)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_pipeline();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceTwin(IGNORED_PTR_ARG))
-        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(message_pipeline_process(TEST_PIPELINE_HANDLE, (IOTHUB_MESSAGE_HANDLE)0x44, IGNORED_NUM_ARG))
+        .SetReturn(IOTHUB_CLIENT_MESSAGE_STAGE_DROP);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)0x44));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(DList_IsListEmpty(g_waitingToSend));
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
+}
+
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_duplicate_filter(void)
+{
+    IOTHUB_CLIENT_DUPLICATE_FILTER filter = { 100, 60 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetMessageCallback(handle, test_message_callback_async, (void*)11);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_C2D_DUPLICATE_FILTER, &filter);
+    umock_c_reset_all_calls();
+    return handle;
 }
 
-/*Tests_SRS_IOTHUBCLIENT_LL_10_003: [ If the underlying layer's _Subscribe function fails, then IoTHubClient_LL_SetDeviceTwinCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinCallback_subscribe_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_153: [ If optionName is OPTION_C2D_DUPLICATE_FILTER, IoTHubClient_LL_SetOption shall replace the duplicate filter by one made by duplicate_filter_create with the capacity and window of the IOTHUB_CLIENT_DUPLICATE_FILTER pointed to by value, a capacity of 0 removing it, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_c2d_duplicate_filter_creates_a_filter)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_DUPLICATE_FILTER filter = { 100, 60 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceTwin(IGNORED_PTR_ARG))
-        .IgnoreArgument_handle()
-        .SetReturn(__FAILURE__);
+    STRICT_EXPECTED_CALL(duplicate_filter_create(100, 60000));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_C2D_DUPLICATE_FILTER, &filter);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Test_SRS_IOTHUBCLIENT_LL_07_021: [ If handle is NULL then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_handle_NULL_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_153: [ If optionName is OPTION_C2D_DUPLICATE_FILTER, IoTHubClient_LL_SetOption shall replace the duplicate filter by one made by duplicate_filter_create with the capacity and window of the IOTHUB_CLIENT_DUPLICATE_FILTER pointed to by value, a capacity of 0 removing it, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_c2d_duplicate_filter_with_capacity_0_destroys_the_filter)
 {
     //arrange
+    IOTHUB_CLIENT_DUPLICATE_FILTER filter = { 0, 60 };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_duplicate_filter();
+
+    STRICT_EXPECTED_CALL(duplicate_filter_destroy(TEST_DUPLICATE_FILTER_HANDLE));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(NULL, iothub_client_inbound_device_method_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_C2D_DUPLICATE_FILTER, &filter);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_025: [ If any error is encountered then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall return IOTHUB_CLIENT_ERROR.] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_subscribe_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_154: [ If duplicate_filter_create fails, IoTHubClient_LL_SetOption shall keep the previous duplicate filter and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_c2d_duplicate_filter_fails_when_duplicate_filter_create_fails)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
+    IOTHUB_CLIENT_DUPLICATE_FILTER filter = { 100, 60 };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_duplicate_filter();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetReturn(__FAILURE__);
+    STRICT_EXPECTED_CALL(duplicate_filter_create(100, 60000))
+        .SetReturn(NULL);
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_C2D_DUPLICATE_FILTER, &filter);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_022: [ If inboundDeviceMethodCallback is NULL then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall call the underlying layer's IoTHubTransport_Unsubscribe_DeviceMethod function and return IOTHUB_CLIENT_OK.] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_inbound_device_method_cb_NULL_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_155: [ While OPTION_C2D_DUPLICATE_FILTER is set, if duplicate_filter_contains returns true for the message id of messageHandle, IoTHubClient_LL_MessageCallback shall send IOTHUBMESSAGE_ACCEPTED as the message disposition to the underlying layer without calling the message callback and return true. ]*/
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_duplicate_filter_accepts_a_duplicate)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
-
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_duplicate_filter();
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe_DeviceMethod(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE))
+        .SetReturn(TEST_C2D_MESSAGE_ID);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(duplicate_filter_contains(TEST_DUPLICATE_FILTER_HANDLE, TEST_C2D_MESSAGE_ID, IGNORED_NUM_ARG))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, NULL, 0);
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_TRUE(result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_031: [If the user has subscribed using IoTHubClient_LL_SetDeviceMethodCallback, IoTHubClient_LL_SetDeviceMethodCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. ] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_inbound_device_method_cb_NULL_After_SetDeviceMethodCallback_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_156: [ While OPTION_C2D_DUPLICATE_FILTER is set, the message id of a message whose disposition is sent to the underlying layer, other than IOTHUBMESSAGE_ABANDONED, shall be given to duplicate_filter_add before the disposition is sent. ]*/
+TEST_FUNCTION(IoTHubClient_LL_MessageCallback_with_duplicate_filter_remembers_an_accepted_message)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetDeviceMethodCallback(h, deviceMethodCallback, (void*)1);
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_duplicate_filter();
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE))
+        .SetReturn(TEST_C2D_MESSAGE_ID);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(duplicate_filter_contains(TEST_DUPLICATE_FILTER_HANDLE, TEST_C2D_MESSAGE_ID, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(test_message_callback_async(TEST_MESSAGE_HANDLE, (void*)11));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_MESSAGE_HANDLE))
+        .SetReturn(TEST_C2D_MESSAGE_ID);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(duplicate_filter_add(TEST_DUPLICATE_FILTER_HANDLE, TEST_C2D_MESSAGE_ID, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ACCEPTED));
+
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, NULL, 0);
+    bool result = IoTHubClient_LL_MessageCallback(handle, testMessage);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_IS_TRUE(result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_030: [ If deviceMethodCallback is NULL and the client is not subscribed to receive method calls, IoTHubClient_LL_SetDeviceMethodCallback shall fail and return IOTHUB_CLIENT_ERROR. ] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_uninitialized_inbound_device_method_cb_NULL_fails)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_156: [ While OPTION_C2D_DUPLICATE_FILTER is set, the message id of a message whose disposition is sent to the underlying layer, other than IOTHUBMESSAGE_ABANDONED, shall be given to duplicate_filter_add before the disposition is sent. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendMessageDisposition_with_duplicate_filter_does_not_remember_an_abandoned_message)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_duplicate_filter();
+    MESSAGE_CALLBACK_INFO* testMessage = make_test_message_info(TEST_MESSAGE_HANDLE);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_SendMessageDisposition(testMessage, IOTHUBMESSAGE_ABANDONED));
+
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, NULL, 0);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendMessageDisposition(handle, testMessage, IOTHUBMESSAGE_ABANDONED);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    destroy_test_message_info(testMessage);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_10_031: [If the user has subscribed using IoTHubClient_LL_SetDeviceMethodCallback, IoTHubClient_LL_SetDeviceMethodCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR. ] */
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_After_SetDeviceMethodCallback_fail)
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_message_trace(void)
+{
+    IOTHUB_CLIENT_MESSAGE_TRACE trace;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    trace.callback = test_message_trace_callback;
+    trace.context = (void*)5;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_TRACE, &trace);
+    umock_c_reset_all_calls();
+    return handle;
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_065: [ If optionName is OPTION_MESSAGE_TRACE, IoTHubClient_LL_SetOption shall store the callback and context of the IOTHUB_CLIENT_MESSAGE_TRACE pointed to by value, a NULL callback stopping the tracing of the messages sent afterwards, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_trace_succeeds)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    (void)IoTHubClient_LL_SetDeviceMethodCallback(h, deviceMethodCallback, (void*)1);
+    IOTHUB_CLIENT_MESSAGE_TRACE trace = { test_message_trace_callback, (void*)5 };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_TRACE, &trace);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_023: [ If inboundDeviceMethodCallback is non-NULL then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall call the underlying layer's IoTHubTransport_Subscribe_DeviceMethod function.]*/
-TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_064: [ While OPTION_MESSAGE_TRACE is set, IoTHubClient_LL_SendEventAsync shall trace the message and call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_ENQUEUED. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_070: [ IoTHubClient_LL_TraceMessage shall set the timestamp of stage in the IOTHUB_CLIENT_MESSAGE_TIMESTAMPS of the message to the current ms and call the trace callback, if one is set, with the message handle, stage and the current ms. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_message_trace_traces_the_message)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_message_trace();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_message_trace_callback((IOTHUB_MESSAGE_HANDLE)0x44, IOTHUB_MESSAGE_TRACE_STAGE_ENQUEUED, IGNORED_NUM_ARG, (void*)5));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceMethodCallback_Ex(h, iothub_client_inbound_device_method_callback, (void*)1);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(containingRecord(g_waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry)->traced);
+    ASSERT_ARE_EQUAL(uint64_t, IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE, containingRecord(g_waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry)->timestamps.acked);
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_026: [ If handle or methodId is NULL then IoTHubClient_LL_DeviceMethodResponse shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_LL_DeviceMethodResponse_handle_NULL_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_065: [ If optionName is OPTION_MESSAGE_TRACE, IoTHubClient_LL_SetOption shall store the callback and context of the IOTHUB_CLIENT_MESSAGE_TRACE pointed to by value, a NULL callback stopping the tracing of the messages sent afterwards, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_after_message_trace_is_cleared_does_not_trace_the_message)
 {
     //arrange
+    IOTHUB_CLIENT_MESSAGE_TRACE trace = { NULL, NULL };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_message_trace();
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_TRACE, &trace);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_DeviceMethodResponse(NULL, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(containingRecord(g_waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry)->traced);
 
     //cleanup
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_026: [ If handle or methodId is NULL then IoTHubClient_LL_DeviceMethodResponse shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_LL_DeviceMethodResponse_method_id_NULL_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_061: [ IoTHubClient_LL_SendEventAsync_Ex shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL, or if eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_Ex_with_NULL_handle_fails)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_DeviceMethodResponse(h, NULL, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync_Ex(NULL, TEST_MESSAGE_HANDLE, test_event_confirmation_callback_ex, (void*)1);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup
-    IoTHubClient_LL_Destroy(h);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_026: [ If handle or methodId is NULL then IoTHubClient_LL_DeviceMethodResponse shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_LL_DeviceMethodResponse_IoTHubTransport_DeviceMethod_Response_FAILS_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_061: [ IoTHubClient_LL_SendEventAsync_Ex shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL, or if eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_Ex_with_NULL_callback_and_non_NULL_context_fails)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DeviceMethod_Response(IGNORED_PTR_ARG, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE)).SetReturn(__FAILURE__);
-
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_DeviceMethodResponse(h, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync_Ex(handle, TEST_MESSAGE_HANDLE, NULL, (void*)1);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_07_027: [ IoTHubClient_LL_DeviceMethodResponse shall call the IoTHubTransport_DeviceMethod_Response transport function.] */
-TEST_FUNCTION(IoTHubClient_LL_DeviceMethodResponse_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_062: [ IoTHubClient_LL_SendEventAsync_Ex shall behave as IoTHubClient_LL_SendEventAsync, tracing the message and calling eventConfirmationCallback with its IOTHUB_CLIENT_MESSAGE_TIMESTAMPS. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_067: [ If result is IOTHUB_CLIENT_CONFIRMATION_OK, IoTHubClient_LL_SendComplete shall call IoTHubClient_LL_TraceMessage with IOTHUB_MESSAGE_TRACE_STAGE_ACKED for the traced messages before calling their callback. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_with_SendEventAsync_Ex_gives_the_timestamps)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY completed;
+    IOTHUB_MESSAGE_LIST* message;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SendEventAsync_Ex(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback_ex, (void*)1);
+    DList_InitializeListHead(&completed);
+    message = containingRecord(DList_RemoveHeadList(g_waitingToSend), IOTHUB_MESSAGE_LIST, entry); /*this is the transport picking the message*/
+    DList_InsertTailList(&completed, &message->entry);
+    IoTHubClient_LL_TraceMessage(message, IOTHUB_MESSAGE_TRACE_STAGE_HANDED_TO_TRANSPORT);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DeviceMethod_Response(IGNORED_PTR_ARG, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback_ex(IOTHUB_CLIENT_CONFIRMATION_OK, IGNORED_PTR_ARG, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_DeviceMethodResponse(h, TEST_METHOD_ID, (const unsigned char*)TEST_DEVICE_METHOD_RESPONSE, strlen(TEST_DEVICE_METHOD_RESPONSE), TEST_DEVICE_STATUS_CODE);
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 1000, g_confirmed_timestamps.handedToTransport - g_confirmed_timestamps.enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE, g_confirmed_timestamps.written);
+    ASSERT_ARE_EQUAL(uint64_t, 1000, g_confirmed_timestamps.acked - g_confirmed_timestamps.handedToTransport);
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-
-/* Tests_SRS_IOTHUBCLIENT_LL_25_120: [If iotHubClientHandle, retryPolicy or retryTimeoutLimitinSeconds is NULL, IoTHubClient_LL_GetRetryPolicy shall return IOTHUB_CLIENT_INVALID_ARG ] */
-TEST_FUNCTION(IoTHubClient_LL_GetRetryPolicy_NULL_HANDLEParam_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_068: [ If message is NULL or not traced, IoTHubClient_LL_TraceMessage shall return. ]*/
+TEST_FUNCTION(IoTHubClient_LL_TraceMessage_with_NULL_message_returns)
 {
     //arrange
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetRetryPolicy(NULL, NULL, NULL);
+    IoTHubClient_LL_TraceMessage(NULL, IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_25_120: [If iotHubClientHandle, retryPolicy or retryTimeoutLimitinSeconds is NULL, IoTHubClient_LL_GetRetryPolicy shall return `IOTHUB_CLIENT_INVALID_ARG ] */
-TEST_FUNCTION(IoTHubClient_LL_GetRetryPolicy_NULL_RetryPolicyParam_fail)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_069: [ If getting the current ms fails, IoTHubClient_LL_TraceMessage shall leave the timestamps of the message as they are and not call the trace callback. ]*/
+TEST_FUNCTION(IoTHubClient_LL_TraceMessage_fails_when_tickcounter_fails)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_LIST* message;
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_message_trace();
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    message = containingRecord(g_waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(__FAILURE__);
+
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetRetryPolicy(h, NULL, NULL);
+    IoTHubClient_LL_TraceMessage(message, IOTHUB_MESSAGE_TRACE_STAGE_WRITTEN);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, IOTHUB_CLIENT_MESSAGE_TIMESTAMP_NONE, message->timestamps.written);
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_25_120: [If iotHubClientHandle, retryPolicy or retryTimeoutLimitinSeconds is NULL, IoTHubClient_LL_GetRetryPolicy shall return `IOTHUB_CLIENT_INVALID_ARG ] */
-TEST_FUNCTION(IoTHubClient_LL_GetRetryPolicy_NULL_SizeParam_fail)
+static IOTHUB_CLIENT_LL_HANDLE create_client_with_chunking(void)
+{
+    size_t chunkSize = TEST_CHUNK_SIZE;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    ASSERT_IS_NOT_NULL(handle);
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_CHUNK_SIZE, &chunkSize);
+    umock_c_reset_all_calls();
+    return handle;
+}
+
+static void setup_chunk(IOTHUB_MESSAGE_HANDLE chunk, size_t index, size_t count)
+{
+    STRICT_EXPECTED_CALL(chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, TEST_CHUNK_SIZE, index, count))
+        .SetReturn(chunk);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_159: [ If optionName is OPTION_MESSAGE_CHUNK_SIZE, IoTHubClient_LL_SetOption shall set the largest payload of the messages sent afterwards to the size_t pointed to by value, 0 sending them whole, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_chunk_size_succeeds)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t chunkSize = TEST_CHUNK_SIZE;
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
     //act
-    IOTHUB_CLIENT_RETRY_POLICY r;
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetRetryPolicy(h, &r, NULL);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_CHUNK_SIZE, &chunkSize);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_LL_25_121: [IoTHubClient_LL_GetRetryPolicy shall retrieve connection retry policy from retryPolicy in struct IOTHUB_CLIENT_LL_HANDLE_DATA] */
-/* Tests_SRS_IOTHUBCLIENT_LL_25_122: [IoTHubClient_LL_GetRetryPolicy shall retrieve retryTimeoutLimit in seconds from retryTimeoutinSeconds in struct IOTHUB_CLIENT_LL_HANDLE_DATA] */
-TEST_FUNCTION(IoTHubClient_LL_GetRetryPolicy_succeed)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_160: [ While OPTION_MESSAGE_CHUNK_SIZE is set and no outbox is set, IoTHubClient_LL_SendEventAsync shall send a message, once compressed, in chunks if chunking_get_chunk_count returns more than 1 for it and the chunk size. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_chunking_sends_a_message_of_one_chunk_whole)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_chunking();
+
+    STRICT_EXPECTED_CALL(chunking_get_chunk_count(TEST_MESSAGE_HANDLE, TEST_CHUNK_SIZE))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_CLIENT_RETRY_POLICY r;
-    size_t s;
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetRetryPolicy(h, &r, &s);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubClient_LL_SetOption_product_info_twice_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_160: [ While OPTION_MESSAGE_CHUNK_SIZE is set and no outbox is set, IoTHubClient_LL_SendEventAsync shall send a message, once compressed, in chunks if chunking_get_chunk_count returns more than 1 for it and the chunk size. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_161: [ IoTHubClient_LL_SendEventAsync shall add the chunks made by chunking_create_chunk with the chunk id of chunking_get_chunk_id to waitingToSend, in order, instead of the message, and call the confirmation callback once, after all of them have been confirmed, with IOTHUB_CLIENT_CONFIRMATION_OK if all of them are confirmed with IOTHUB_CLIENT_CONFIRMATION_OK and with the result of the first one that is not otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_chunking_adds_the_chunks)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(platform_get_platform_info());
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(platform_get_platform_info());
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    IOTHUB_MESSAGE_HANDLE expectedMessages[] = { TEST_CHUNK_MESSAGE_HANDLE_1, TEST_CHUNK_MESSAGE_HANDLE_2 };
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_chunking();
+
+    STRICT_EXPECTED_CALL(chunking_get_chunk_count(TEST_MESSAGE_HANDLE, TEST_CHUNK_SIZE))
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(chunking_get_chunk_id(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the batch*/
+    setup_chunk(TEST_CHUNK_MESSAGE_HANDLE_1, 0, 2);
+    setup_chunk(TEST_CHUNK_MESSAGE_HANDLE_2, 1, 2);
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
-    if (result == IOTHUB_CLIENT_OK)
-    {
-        result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
-    }
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_waitingToSend_messages(expectedMessages, 2);
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubClient_LL_SetOption_product_info_succeeds)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_161: [ IoTHubClient_LL_SendEventAsync shall add the chunks made by chunking_create_chunk with the chunk id of chunking_get_chunk_id to waitingToSend, in order, instead of the message, and call the confirmation callback once, after all of them have been confirmed, with IOTHUB_CLIENT_CONFIRMATION_OK if all of them are confirmed with IOTHUB_CLIENT_CONFIRMATION_OK and with the result of the first one that is not otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_confirms_the_chunked_message_once_all_chunks_are_confirmed)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY completed;
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_chunking();
+    STRICT_EXPECTED_CALL(chunking_get_chunk_count(TEST_MESSAGE_HANDLE, TEST_CHUNK_SIZE))
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, TEST_CHUNK_SIZE, 0, 2))
+        .SetReturn(TEST_CHUNK_MESSAGE_HANDLE_1);
+    STRICT_EXPECTED_CALL(chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, TEST_CHUNK_SIZE, 1, 2))
+        .SetReturn(TEST_CHUNK_MESSAGE_HANDLE_2);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    DList_InitializeListHead(&completed);
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend)); /*this is the transport picking both chunks*/
+    DList_InsertTailList(&completed, DList_RemoveHeadList(g_waitingToSend));
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(platform_get_platform_info());
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_CHUNK_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the batch*/
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_CHUNK_MESSAGE_HANDLE_2));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
+    IoTHubClient_LL_SendComplete(handle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubClient_LL_SetOption_product_info_fails_case2)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_162: [ If making or adding any of the chunks fails, IoTHubClient_LL_SendEventAsync shall remove the chunks already added, without calling the confirmation callback, and fail with the error of adding it, IOTHUB_CLIENT_ERROR for making it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_chunking_removes_the_chunks_added_when_making_one_fails)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(platform_get_platform_info());
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_chunking();
+
+    STRICT_EXPECTED_CALL(chunking_get_chunk_count(TEST_MESSAGE_HANDLE, TEST_CHUNK_SIZE))
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(chunking_get_chunk_id(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the batch*/
+    setup_chunk(TEST_CHUNK_MESSAGE_HANDLE_1, 0, 2);
+    STRICT_EXPECTED_CALL(chunking_create_chunk(TEST_MESSAGE_HANDLE, TEST_CHUNK_ID, TEST_CHUNK_SIZE, 1, 2))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_CHUNK_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the batch*/
 
     //act
-    g_fail_platform_get_platform_info = true;
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_waitingToSend_messages(NULL, 0);
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubClient_LL_SetOption_product_info_fails_case1)
+/*Tests_SRS_IOTHUBCLIENT_LL_41_163: [ IoTHubClient_LL_SendEventAsync_TakeOwnership shall destroy eventMessageHandle once its chunks are added. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_TakeOwnership_with_chunking_destroys_the_message)
 {
     //arrange
-    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
-    umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(platform_get_platform_info());
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    IOTHUB_CLIENT_LL_HANDLE handle = create_client_with_chunking();
+
+    STRICT_EXPECTED_CALL(chunking_get_chunk_count(TEST_MESSAGE_HANDLE, TEST_CHUNK_SIZE))
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(chunking_get_chunk_id(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the batch*/
+    setup_chunk(TEST_CHUNK_MESSAGE_HANDLE_1, 0, 2);
+    setup_chunk(TEST_CHUNK_MESSAGE_HANDLE_2, 1, 2);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
 
     //act
-    g_fail_string_construct_sprintf = true;
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_PRODUCT_INFO, "Eight");
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync_TakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
-    IoTHubClient_LL_Destroy(h);
+    IoTHubClient_LL_Destroy(handle);
 }
 
 END_TEST_SUITE(iothubclient_ll_ut)
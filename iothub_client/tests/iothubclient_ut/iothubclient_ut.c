@@ -41,6 +41,7 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 #undef ENABLE_MOCKS
 
 #include "iothub_client.h"
+#include "iothub_client_options.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -74,6 +75,15 @@ static void my_test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_RESUL
     g_userContextCallback = NULL;
 }
 
+static void my_test_device_twin_payload_callback(DEVICE_TWIN_UPDATE_STATE update_state, unsigned char* payLoad, size_t size, void* userContextCallback)
+{
+    (void)update_state;
+    (void)size;
+    (void)userContextCallback;
+    /*the callback owns the payload*/
+    my_gballoc_free(payLoad);
+}
+
 static int my_DeviceMethodCallback_Impl(const char* method_name, const unsigned char* payload, size_t size, unsigned char** response, size_t* resp_size, void* userContextCallback)
 {
     (void)method_name;
@@ -94,13 +104,20 @@ static int my_DeviceMethodCallback_Impl(const char* method_name, const unsigned
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/tickcounter.h"
 
 #include "iothub_client_ll.h"
+#include "iothub_client_worker_pool.h"
+#include "iothub_client_ingress_queue.h"
+#include "iothub_client_connection_ramp.h"
+#include "iothub_client_thread_attributes.h"
 
 MOCKABLE_FUNCTION(, void, test_event_confirmation_callback, IOTHUB_CLIENT_CONFIRMATION_RESULT, result, void*, userContextCallback);
 MOCKABLE_FUNCTION(, IOTHUBMESSAGE_DISPOSITION_RESULT, test_message_confirmation_callback, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback);
 MOCKABLE_FUNCTION(, IOTHUBMESSAGE_DISPOSITION_RESULT, test_message_confirmation_callback_ex, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback, void*, transportContext);
 MOCKABLE_FUNCTION(, void, test_device_twin_callback, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, payLoad, size_t, size, void*, userContextCallback);
+MOCKABLE_FUNCTION(, void, test_device_twin_payload_callback, DEVICE_TWIN_UPDATE_STATE, update_state, unsigned char*, payLoad, size_t, size, void*, userContextCallback);
 MOCKABLE_FUNCTION(, void, test_connection_status_callback, IOTHUB_CLIENT_CONNECTION_STATUS, result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON, reason, void*, userContextCallback);
 MOCKABLE_FUNCTION(, void, test_report_state_callback, int, status_code, void*, userContextCallback);
 MOCKABLE_FUNCTION(, int, test_incoming_method_callback, const char*, method_name, const unsigned char*, payload, size_t, size, METHOD_HANDLE, method_id, void*, userContextCallback);
@@ -163,6 +180,11 @@ static IOTHUB_CLIENT_DEVICE_CONFIG* TEST_CLIENT_DEVICE_CONFIG = (IOTHUB_CLIENT_D
 static METHOD_HANDLE TEST_METHOD_ID = (METHOD_HANDLE)0x111B;
 static STRING_HANDLE TEST_STRING_HANDLE = (STRING_HANDLE)0x111C;
 static BUFFER_HANDLE TEST_BUFFER_HANDLE = (BUFFER_HANDLE)0x111D;
+static COND_HANDLE TEST_COND_HANDLE = (COND_HANDLE)0x111E;
+static TICK_COUNTER_HANDLE TEST_TICK_COUNTER_HANDLE = (TICK_COUNTER_HANDLE)0x111F;
+static WORKER_POOL_HANDLE TEST_WORKER_POOL_HANDLE = (WORKER_POOL_HANDLE)0x111F;
+static WORKER_POOL_ITEM_HANDLE TEST_WORKER_POOL_ITEM_HANDLE = (WORKER_POOL_ITEM_HANDLE)0x1120;
+static INGRESS_QUEUE_HANDLE TEST_INGRESS_QUEUE_HANDLE = (INGRESS_QUEUE_HANDLE)0x1121;
 
 static const char* TEST_CONNECTION_STRING = "Test_connection_string";
 static const char* TEST_DEVICE_ID = "theidofTheDevice";
@@ -171,7 +193,7 @@ static const char* TEST_IOTHUBNAME = "theNameoftheIotHub";
 static const char* TEST_DEVICE_SAS = "theSasOfTheDevice";
 static const char* TEST_IOTHUBSUFFIX = "theSuffixoftheIotHubHostname";
 static const char* TEST_METHOD_NAME = "method_name";
-static const unsigned char* TEST_DEVICE_METHOD_RESPONSE = (const unsigned char*)0x62;
+static const unsigned char TEST_DEVICE_METHOD_RESPONSE[] = { 0x62 };
 static size_t TEST_DEVICE_RESP_LENGTH = 1;
 static void* CALLBACK_CONTEXT = (void*)0x1210;
 
@@ -194,7 +216,10 @@ static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
 static LOCK_RESULT my_Lock(LOCK_HANDLE handle)
 {
     LOCK_TEST_INFO* lock_info = (LOCK_TEST_INFO*)handle;
-    lock_info->lock_taken = my_gballoc_malloc(1);
+    if (lock_info->lock_taken == NULL)
+    {
+        lock_info->lock_taken = my_gballoc_malloc(1);
+    }
     return LOCK_OK;
 }
 
@@ -202,6 +227,7 @@ static LOCK_RESULT my_Unlock(LOCK_HANDLE handle)
 {
     LOCK_TEST_INFO* lock_info = (LOCK_TEST_INFO*)handle;
     my_gballoc_free(lock_info->lock_taken);
+    lock_info->lock_taken = NULL;
     return LOCK_OK;
 }
 
@@ -236,6 +262,68 @@ static void my_ThreadAPI_Sleep(unsigned int milliseconds)
     }
 }
 
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    g_thread_loop_count++;
+    if ((g_how_thread_loops > 0) && (g_how_thread_loops == g_thread_loop_count))
+    {
+        *(sig_atomic_t*)(((char*)g_thread_func_arg) + IoTHubClient_ThreadTerminationOffset) = 1; /*tell the thread to stop*/
+    }
+    return COND_TIMEOUT;
+}
+
+static size_t g_thread_attributes_apply_count;
+static char g_thread_attributes_name_suffix[16];
+
+static int my_IoTHubClient_ThreadAttributes_ApplyToCurrentThread(const IOTHUB_CLIENT_THREAD_ATTRIBUTES* attributes, const char* name_suffix)
+{
+    (void)attributes;
+    g_thread_attributes_apply_count++;
+    (void)snprintf(g_thread_attributes_name_suffix, sizeof(g_thread_attributes_name_suffix), "%s", name_suffix);
+    return 0;
+}
+
+static void* g_ingress_queue_value;
+static size_t g_ingress_queue_is_empty_count;
+static IOTHUB_CLIENT_HANDLE g_push_in_ingress_queue_is_empty_client;
+static IOTHUB_MESSAGE_HANDLE g_push_in_ingress_queue_is_empty_message;
+static size_t g_push_in_ingress_queue_is_empty_call;
+
+static int my_ingress_queue_push(INGRESS_QUEUE_HANDLE ingress_queue, void* value, bool* was_empty)
+{
+    (void)ingress_queue;
+    if (was_empty != NULL)
+    {
+        *was_empty = (g_ingress_queue_value == NULL);
+    }
+    g_ingress_queue_value = value;
+    return 0;
+}
+
+static void* my_ingress_queue_pop(INGRESS_QUEUE_HANDLE ingress_queue)
+{
+    void* result = g_ingress_queue_value;
+    (void)ingress_queue;
+    g_ingress_queue_value = NULL;
+    return result;
+}
+
+static bool my_ingress_queue_is_empty(INGRESS_QUEUE_HANDLE ingress_queue)
+{
+    bool result = (g_ingress_queue_value == NULL);
+    (void)ingress_queue;
+    g_ingress_queue_is_empty_count++;
+    if ((g_push_in_ingress_queue_is_empty_client != NULL) && (g_ingress_queue_is_empty_count == g_push_in_ingress_queue_is_empty_call))
+    {
+        /*a producer pushes right after the worker saw the queue empty*/
+        (void)IoTHubClient_SendEventAsync_TakeOwnership(g_push_in_ingress_queue_is_empty_client, g_push_in_ingress_queue_is_empty_message, test_event_confirmation_callback, NULL);
+    }
+    return result;
+}
+
 static IOTHUB_CLIENT_RESULT my_IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
 {
     (void)iotHubClientHandle;
@@ -352,6 +440,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE*, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_LL_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*);
@@ -387,6 +476,13 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(METHOD_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(WORKER_POOL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(WORKER_POOL_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(WORKER_POOL_WORK_FUNCTION, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(INGRESS_QUEUE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(bool*, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -400,6 +496,10 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_CreateWithTransport, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SendEventAsync, my_IoTHubClient_LL_SendEventAsync);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_SendEventAsync, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SendEventAsync_TakeOwnership, my_IoTHubClient_LL_SendEventAsync);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_SendEventAsync_TakeOwnership, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_LL_SendEventBatchAsync, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_SendEventBatchAsync, IOTHUB_CLIENT_ERROR);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_GetSendStatus, my_IoTHubClient_LL_GetSendStatus);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_GetSendStatus, IOTHUB_CLIENT_ERROR);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_GetLastMessageReceiveTime, my_IoTHubClient_LL_GetLastMessageReceiveTime);
@@ -425,6 +525,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_LL_GetRetryPolicy, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_Destroy, my_IoTHubClient_LL_Destroy);
     REGISTER_GLOBAL_MOCK_HOOK(test_event_confirmation_callback, my_test_event_confirmation_callback);
+    REGISTER_GLOBAL_MOCK_HOOK(test_device_twin_payload_callback, my_test_device_twin_payload_callback);
     
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_GetRetryPolicy, IOTHUB_CLIENT_ERROR);
 
@@ -456,8 +557,30 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Join, THREADAPI_ERROR);
 
     REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_ThreadAttributes_ApplyToCurrentThread, my_IoTHubClient_ThreadAttributes_ApplyToCurrentThread);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
 
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Post, COND_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+
+    REGISTER_GLOBAL_MOCK_RETURN(worker_pool_create, TEST_WORKER_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(worker_pool_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(worker_pool_add, TEST_WORKER_POOL_ITEM_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(worker_pool_add, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(worker_pool_schedule, 0);
+
+    REGISTER_GLOBAL_MOCK_RETURN(ingress_queue_create, TEST_INGRESS_QUEUE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ingress_queue_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(ingress_queue_push, my_ingress_queue_push);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ingress_queue_push, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(ingress_queue_pop, my_ingress_queue_pop);
+    REGISTER_GLOBAL_MOCK_HOOK(ingress_queue_is_empty, my_ingress_queue_is_empty);
+
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_create, real_VECTOR_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_create, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_move, real_VECTOR_move);
@@ -497,6 +620,7 @@ TEST_FUNCTION_INITIALIZE(method_init)
     g_thread_func_arg = NULL;
     g_userContextCallback = NULL;
     g_how_thread_loops = 0;
+    g_thread_attributes_apply_count = 0;
     g_thread_loop_count = 0;
     
     g_eventConfirmationCallback = NULL;
@@ -506,6 +630,11 @@ TEST_FUNCTION_INITIALIZE(method_init)
     g_inboundDeviceCallback = NULL;
     g_messageCallback = NULL;
     g_messageCallback_ex = NULL;
+    g_ingress_queue_value = NULL;
+    g_ingress_queue_is_empty_count = 0;
+    g_push_in_ingress_queue_is_empty_client = NULL;
+    g_push_in_ingress_queue_is_empty_message = NULL;
+    g_push_in_ingress_queue_is_empty_call = 0;
 
     my_IoTHubClient_LL_SetDeviceMethodCallback_Ex_result = IOTHUB_CLIENT_OK;
     my_IoTHubClient_LL_SetConnectionStatusCallback_result = IOTHUB_CLIENT_OK;
@@ -1010,6 +1139,118 @@ TEST_FUNCTION(IoTHubClient_SendEventAsync_succeed)
     IoTHubClient_Destroy(iothub_handle);
 }
 
+/* Tests_SRS_IOTHUBCLIENT_41_021: [ IoTHubClient_SendEventAsync_TakeOwnership shall behave as IoTHubClient_SendEventAsync, with the exception of the message handle being handed over to the SDK instead of being cloned. ]*/
+/* Tests_SRS_IOTHUBCLIENT_41_022: [ IoTHubClient_SendEventAsync_TakeOwnership shall call IoTHubClient_LL_SendEventAsync_TakeOwnership instead of IoTHubClient_LL_SendEventAsync. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync_TakeOwnership(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_021: [ IoTHubClient_SendEventAsync_TakeOwnership shall behave as IoTHubClient_SendEventAsync, with the exception of the message handle being handed over to the SDK instead of being cloned. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_handle_NULL_fail)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(NULL, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_031: [ IoTHubClient_SendEventBatchAsync shall behave as IoTHubClient_SendEventAsync, enqueuing all the messages of eventMessageHandles under a single acquisition of the lock. ]*/
+/* Tests_SRS_IOTHUBCLIENT_41_032: [ IoTHubClient_SendEventBatchAsync shall call IoTHubClient_LL_SendEventBatchAsync instead of IoTHubClient_LL_SendEventAsync, passing eventMessageHandles and eventMessageCount. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventBatchAsync_succeed)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventBatchAsync(IGNORED_PTR_ARG, messages, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventBatchAsync(iothub_handle, messages, 2, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_031: [ IoTHubClient_SendEventBatchAsync shall behave as IoTHubClient_SendEventAsync, enqueuing all the messages of eventMessageHandles under a single acquisition of the lock. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventBatchAsync_LL_fails_frees_the_queue_context)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventBatchAsync(IGNORED_PTR_ARG, messages, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .SetReturn(IOTHUB_CLIENT_ERROR);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventBatchAsync(iothub_handle, messages, 2, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
 /* Tests_SRS_IOTHUBCLIENT_01_010: [If starting the thread fails, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR.] */
 /* Tests_SRS_IOTHUBCLIENT_01_011: [If iotHubClientHandle is NULL, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_INVALID_ARG.] */
 /* Tests_SRS_IOTHUBCLIENT_01_013: [When IoTHubClient_LL_SendEventAsync is called, IoTHubClient_SendEventAsync shall return the result of IoTHubClient_LL_SendEventAsync.] */
@@ -1414,6 +1655,82 @@ TEST_FUNCTION(IoTHubClient_SetConnectionStatusCallback_fail)
     umock_c_negative_tests_deinit();
 }
 
+/* Tests_SRS_IOTHUBCLIENT_41_055: [ If `iotHubClientHandle` is `NULL`, `IoTHubClient_Connect` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClient_Connect_client_handle_NULL_fail)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Connect(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_056: [ `IoTHubClient_Connect` shall start the worker thread if it was not previously started, so that the transport connects and authenticates the device before the first message is sent. ]*/
+/* Tests_SRS_IOTHUBCLIENT_41_058: [ Otherwise `IoTHubClient_Connect` shall return `IOTHUB_CLIENT_OK`. ]*/
+TEST_FUNCTION(IoTHubClient_Connect_starts_the_worker_thread_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Connect(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_056: [ `IoTHubClient_Connect` shall start the worker thread if it was not previously started, so that the transport connects and authenticates the device before the first message is sent. ]*/
+TEST_FUNCTION(IoTHubClient_Connect_twice_starts_the_worker_thread_once_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClient_Connect(iothub_handle);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Connect(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_057: [ If starting the thread fails, `IoTHubClient_Connect` shall return `IOTHUB_CLIENT_ERROR`. ]*/
+TEST_FUNCTION(IoTHubClient_Connect_thread_create_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(THREADAPI_ERROR);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Connect(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
 /* Tests_SRS_IOTHUBCLIENT_25_076: [ If `iotHubClientHandle` is `NULL`, `IoTHubClient_SetRetryPolicy` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
 TEST_FUNCTION(IoTHubClient_SetRetryPolicy_client_handle_fail)
 {
@@ -1588,143 +1905,311 @@ TEST_FUNCTION(IoTHubClient_GetLastMessageReceiveTime_succeed)
     IoTHubClient_Destroy(iothub_handle);
 }
 
-TEST_FUNCTION(IoTHubClient_GetLastMessageReceiveTime_failed)
+/* Tests_SRS_IOTHUBCLIENT_41_023: [ If iotHubClientHandle is NULL, IoTHubClient_GetMessagePoolStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_GetMessagePoolStatistics_client_handle_NULL_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetMessagePoolStatistics(NULL, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_025: [ IoTHubClient_GetMessagePoolStatistics shall return the result of IoTHubClient_LL_GetMessagePoolStatistics, called with the lock taken. ]*/
+TEST_FUNCTION(IoTHubClient_GetMessagePoolStatistics_succeed)
 {
     // arrange
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     umock_c_reset_all_calls();
 
-    int negativeTestsInitResult = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
-
-    time_t recv_time;
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
 
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetLastMessageReceiveTime(TEST_IOTHUB_CLIENT_HANDLE, &recv_time));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetMessagePoolStatistics(TEST_IOTHUB_CLIENT_HANDLE, &statistics));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
 
-    umock_c_negative_tests_snapshot();
-
     // act
-    size_t calls_cannot_fail[] = { 2 };
-
-    size_t count = umock_c_negative_tests_call_count();
-    for (size_t index = 0; index < count; index++)
-    {
-        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail)/sizeof(calls_cannot_fail[0])) != 0)
-        {
-            continue;
-        }
-
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(index);
-
-        char tmp_msg[64];
-        sprintf(tmp_msg, "IoTHubClient_GetLastMessageReceiveTime failure in test %zu/%zu", index, count);
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iothub_handle, &recv_time);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetMessagePoolStatistics(iothub_handle, &statistics);
 
-        // assert
-        ASSERT_ARE_NOT_EQUAL_WITH_MSG(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result, tmp_msg);
-    }
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
-    umock_c_negative_tests_deinit();
     IoTHubClient_Destroy(iothub_handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_02_034: [If parameter iotHubClientHandle is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_SetOption_client_handle_NULL_fail)
+/* Tests_SRS_IOTHUBCLIENT_41_024: [ If acquiring the lock fails, IoTHubClient_GetMessagePoolStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_GetMessagePoolStatistics_lock_fails)
 {
     // arrange
-    const char* option_name = "option_name";
-    const void* option_value = (void*)0x0123;
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    IOTHUB_CLIENT_POOL_STATISTICS statistics;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .SetReturn(LOCK_ERROR);
 
     // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(NULL, option_name, option_value);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetMessagePoolStatistics(iothub_handle, &statistics);
 
     // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
+    IoTHubClient_Destroy(iothub_handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_02_035: [If parameter optionName is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_SetOption_option_name_NULL_fail)
+/* Tests_SRS_IOTHUBCLIENT_41_052: [ If iotHubClientHandle is NULL, IoTHubClient_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_GetStatistics_client_handle_NULL_fail)
 {
     // arrange
-    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
-    umock_c_reset_all_calls();
-
-    const void* option_value = (void*)0x0123;
+    IOTHUB_CLIENT_STATISTICS statistics;
 
     // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, NULL, option_value);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetStatistics(NULL, &statistics);
 
     // assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
-    IoTHubClient_Destroy(iothub_handle);
 }
 
-/*Tests_SRS_IOTHUBCLIENT_02_036: [If parameter value is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubClient_SetOption_option_value_NULL_fail)
+/* Tests_SRS_IOTHUBCLIENT_41_054: [ IoTHubClient_GetStatistics shall return the result of IoTHubClient_LL_GetStatistics, called with the lock taken. ]*/
+TEST_FUNCTION(IoTHubClient_GetStatistics_succeed)
 {
     // arrange
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     umock_c_reset_all_calls();
 
-    const char* option_name = "option_name";
-
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, option_name, NULL);
+    IOTHUB_CLIENT_STATISTICS statistics;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetStatistics(TEST_IOTHUB_CLIENT_HANDLE, &statistics));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetStatistics(iothub_handle, &statistics);
 
     // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
     IoTHubClient_Destroy(iothub_handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
-/* Tests_SRS_IOTHUBCLIENT_01_041: [ IoTHubClient_SetOption shall be made thread-safe by using the lock created in IoTHubClient_Create. ] */
-TEST_FUNCTION(IoTHubClient_SetOption_succeed)
+/* Tests_SRS_IOTHUBCLIENT_41_053: [ If acquiring the lock fails, IoTHubClient_GetStatistics shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_GetStatistics_lock_fails)
 {
     // arrange
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     umock_c_reset_all_calls();
 
-    const char* option_name = "option_name";
-    const void* option_value = (void*)0x0123;
+    IOTHUB_CLIENT_STATISTICS statistics;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetStatistics(iothub_handle, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_039: [ If iotHubClientHandle or depth are NULL, IoTHubClient_GetCallbackQueueDepth shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_GetCallbackQueueDepth_client_handle_NULL_fail)
+{
+    // arrange
+    size_t depth;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetCallbackQueueDepth(NULL, &depth);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_041: [ IoTHubClient_GetCallbackQueueDepth shall set depth to the number of user callbacks queued and not dispatched yet, including the ones the callback dispatcher thread is running, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_GetCallbackQueueDepth_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t depth = 42;
+    umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetOption(TEST_IOTHUB_CLIENT_HANDLE, option_name, option_value));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
 
     // act
-    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, option_name, option_value);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetCallbackQueueDepth(iothub_handle, &depth);
 
     // assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, depth);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
     IoTHubClient_Destroy(iothub_handle);
 }
 
-/* Tests_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.]*/
-/* Tests_SRS_IOTHUBCLIENT_01_042: [If acquiring the lock fails, IoTHubClient_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_ERROR. ]*/
-/* Tests_SRS_IOTHUBCLIENT_10_007: [IoTHubClient_SetDeviceTwinCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL. ]*/
-/* Tests_SRS_IOTHUBCLIENT_10_002: [If acquiring the lock fails, IoTHubClient_SetDeviceTwinCallback shall return IOTHUB_CLIENT_ERROR. ]*/
-/* Tests_SRS_IOTHUBCLIENT_10_004: [If starting the thread fails, IoTHubClient_SetDeviceTwinCallback shall return IOTHUB_CLIENT_ERROR. ]*/
-TEST_FUNCTION(IoTHubClient_SetOption_fail)
+/* Tests_SRS_IOTHUBCLIENT_41_040: [ If acquiring the lock fails, IoTHubClient_GetCallbackQueueDepth shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_GetCallbackQueueDepth_lock_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t depth;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetCallbackQueueDepth(iothub_handle, &depth);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_085: [ If iotHubClientHandle is NULL, IoTHubClient_PauseReceive and IoTHubClient_ResumeReceive shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_PauseReceive_and_ResumeReceive_client_handle_NULL_fail)
+{
+    // act
+    IOTHUB_CLIENT_RESULT pause_result = IoTHubClient_PauseReceive(NULL);
+    IOTHUB_CLIENT_RESULT resume_result = IoTHubClient_ResumeReceive(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, pause_result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, resume_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_087: [ IoTHubClient_PauseReceive and IoTHubClient_ResumeReceive shall pause and resume the receive with IoTHubClient_LL_PauseReceive and IoTHubClient_LL_ResumeReceive, called with the lock taken, the receive staying paused while the inbound callback limit pauses it, and return their result. ]*/
+TEST_FUNCTION(IoTHubClient_PauseReceive_and_ResumeReceive_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_PauseReceive(TEST_IOTHUB_CLIENT_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_ResumeReceive(TEST_IOTHUB_CLIENT_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT pause_result = IoTHubClient_PauseReceive(iothub_handle);
+    IOTHUB_CLIENT_RESULT pause_again_result = IoTHubClient_PauseReceive(iothub_handle);
+    IOTHUB_CLIENT_RESULT resume_result = IoTHubClient_ResumeReceive(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, pause_result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, pause_again_result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, resume_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_087: [ IoTHubClient_PauseReceive and IoTHubClient_ResumeReceive shall pause and resume the receive with IoTHubClient_LL_PauseReceive and IoTHubClient_LL_ResumeReceive, called with the lock taken, the receive staying paused while the inbound callback limit pauses it, and return their result. ]*/
+TEST_FUNCTION(IoTHubClient_ResumeReceive_LL_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClient_PauseReceive(iothub_handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_ResumeReceive(TEST_IOTHUB_CLIENT_HANDLE))
+        .SetReturn(IOTHUB_CLIENT_ERROR);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_ResumeReceive(TEST_IOTHUB_CLIENT_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_ResumeReceive(iothub_handle);
+    IOTHUB_CLIENT_RESULT retry_result = IoTHubClient_ResumeReceive(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, retry_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_086: [ If acquiring the lock fails, IoTHubClient_PauseReceive and IoTHubClient_ResumeReceive shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_PauseReceive_lock_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_PauseReceive(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClient_GetLastMessageReceiveTime_failed)
 {
     // arrange
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
@@ -1733,20 +2218,19 @@ TEST_FUNCTION(IoTHubClient_SetOption_fail)
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-    const char* option_name = "option_name";
-    const void* option_value = (void*)0x0123;
+    time_t recv_time;
 
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetOption(TEST_IOTHUB_CLIENT_HANDLE, option_name, option_value));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetLastMessageReceiveTime(TEST_IOTHUB_CLIENT_HANDLE, &recv_time));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
 
     umock_c_negative_tests_snapshot();
 
+    // act
     size_t calls_cannot_fail[] = { 2 };
 
-    // act
     size_t count = umock_c_negative_tests_call_count();
     for (size_t index = 0; index < count; index++)
     {
@@ -1758,17 +2242,1250 @@ TEST_FUNCTION(IoTHubClient_SetOption_fail)
         umock_c_negative_tests_reset();
         umock_c_negative_tests_fail_call(index);
 
-        char tmp_msg[64];
-        sprintf(tmp_msg, "IoTHubClient_SetOption failure in test %zu/%zu", index, count);
-        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, option_name, option_value);
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClient_GetLastMessageReceiveTime failure in test %zu/%zu", index, count);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_GetLastMessageReceiveTime(iothub_handle, &recv_time);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_034: [If parameter iotHubClientHandle is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_SetOption_client_handle_NULL_fail)
+{
+    // arrange
+    const char* option_name = "option_name";
+    const void* option_value = (void*)0x0123;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(NULL, option_name, option_value);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_035: [If parameter optionName is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_SetOption_option_name_NULL_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    const void* option_value = (void*)0x0123;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, NULL, option_value);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_036: [If parameter value is NULL then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubClient_SetOption_option_value_NULL_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    const char* option_name = "option_name";
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, option_name, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
+/* Tests_SRS_IOTHUBCLIENT_01_041: [ IoTHubClient_SetOption shall be made thread-safe by using the lock created in IoTHubClient_Create. ] */
+TEST_FUNCTION(IoTHubClient_SetOption_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    const char* option_name = "option_name";
+    const void* option_value = (void*)0x0123;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetOption(TEST_IOTHUB_CLIENT_HANDLE, option_name, option_value));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, option_name, option_value);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.]*/
+/* Tests_SRS_IOTHUBCLIENT_01_042: [If acquiring the lock fails, IoTHubClient_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_ERROR. ]*/
+/* Tests_SRS_IOTHUBCLIENT_10_007: [IoTHubClient_SetDeviceTwinCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL. ]*/
+/* Tests_SRS_IOTHUBCLIENT_10_002: [If acquiring the lock fails, IoTHubClient_SetDeviceTwinCallback shall return IOTHUB_CLIENT_ERROR. ]*/
+/* Tests_SRS_IOTHUBCLIENT_10_004: [If starting the thread fails, IoTHubClient_SetDeviceTwinCallback shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    const char* option_name = "option_name";
+    const void* option_value = (void*)0x0123;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetOption(TEST_IOTHUB_CLIENT_HANDLE, option_name, option_value));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    umock_c_negative_tests_snapshot();
+
+    size_t calls_cannot_fail[] = { 2 };
+
+    // act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail)/sizeof(calls_cannot_fail[0])) != 0)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClient_SetOption failure in test %zu/%zu", index, count);
+        IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, option_name, option_value);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_002: [ If optionName is OPTION_EVENT_DRIVEN_WORKER, IoTHubClient_SetOption shall create (once) a condition used to wake up the worker thread and enable or disable the event driven mode as indicated by the bool pointed to by value. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_event_driven_worker_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool event_driven = true;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &event_driven);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_002: [ If optionName is OPTION_EVENT_DRIVEN_WORKER, IoTHubClient_SetOption shall create (once) a condition used to wake up the worker thread and enable or disable the event driven mode as indicated by the bool pointed to by value. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_event_driven_worker_twice_creates_condition_once)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool event_driven = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &event_driven);
+    umock_c_reset_all_calls();
+
+    event_driven = false;
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &event_driven);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_003: [ If creating the condition fails, IoTHubClient_SetOption shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_event_driven_worker_Condition_Init_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool event_driven = true;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Init())
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &event_driven);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_001: [ If optionName is OPTION_EVENT_DRIVEN_WORKER and the client was created with a shared transport then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_event_driven_worker_with_transport_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_CreateWithTransport(TEST_TRANSPORT_HANDLE, TEST_CLIENT_CONFIG);
+    bool event_driven = true;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &event_driven);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_008: [ If optionName is OPTION_WORKER_MAX_IDLE_TIME and the value pointed to by value is 0 then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_worker_max_idle_time_0_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    unsigned int max_idle_time = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_WORKER_MAX_IDLE_TIME, &max_idle_time);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_009: [ Otherwise IoTHubClient_SetOption shall store the new max idle time and wake up the worker thread. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_worker_max_idle_time_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    unsigned int max_idle_time = 1000;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_WORKER_MAX_IDLE_TIME, &max_idle_time);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_088: [ If optionName is OPTION_INBOUND_CALLBACK_LIMIT, IoTHubClient_SetOption shall keep the limit, 0 for none, resume the receive it paused when the limit is 0 and return IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR if resuming fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_inbound_callback_limit_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t limit = 16;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_INBOUND_CALLBACK_LIMIT, &limit);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_092: [ If optionName is OPTION_THREAD_ATTRIBUTES, IoTHubClient_SetOption shall keep a copy of the attributes, name included, for the threads the client starts afterwards, and return IOTHUB_CLIENT_ERROR if copying the name fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_thread_attributes_copies_the_name)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_CLIENT_THREAD_ATTRIBUTES attributes = { 0x3, true, 10, "ctrl" };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "ctrl"))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_THREAD_ATTRIBUTES, &attributes);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_092: [ If optionName is OPTION_THREAD_ATTRIBUTES, IoTHubClient_SetOption shall keep a copy of the attributes, name included, for the threads the client starts afterwards, and return IOTHUB_CLIENT_ERROR if copying the name fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_thread_attributes_name_copy_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_CLIENT_THREAD_ATTRIBUTES attributes = { 0x3, false, 0, "ctrl" };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "ctrl"))
+        .IgnoreArgument_destination()
+        .SetReturn(__FAILURE__);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_THREAD_ATTRIBUTES, &attributes);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_093: [ The worker thread, the callback dispatcher thread and the thread of an upload shall apply the attributes of OPTION_THREAD_ATTRIBUTES, if set, as they start, and go on with the attributes they have if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_worker_thread_applies_the_thread_attributes_once)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_CLIENT_THREAD_ATTRIBUTES attributes = { 0x3, false, 0, NULL };
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_THREAD_ATTRIBUTES, &attributes);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+    g_how_thread_loops = 2;
+    umock_c_reset_all_calls();
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_thread_attributes_apply_count);
+    ASSERT_ARE_EQUAL(char_ptr, "-work", g_thread_attributes_name_suffix);
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_093: [ The worker thread, the callback dispatcher thread and the thread of an upload shall apply the attributes of OPTION_THREAD_ATTRIBUTES, if set, as they start, and go on with the attributes they have if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_worker_thread_without_thread_attributes_leaves_the_thread_alone)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+    g_how_thread_loops = 1;
+    umock_c_reset_all_calls();
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_thread_attributes_apply_count);
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_033: [ If optionName is OPTION_CALLBACK_DISPATCH_QUEUE_SIZE and the value pointed to by value is 0 then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_callback_dispatch_queue_size_0_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t queue_size = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_QUEUE_SIZE, &queue_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_034: [ Otherwise IoTHubClient_SetOption shall store the queue size and start (once) the callback dispatcher thread, with its condition and queue, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_callback_dispatch_queue_size_starts_the_dispatcher_thread)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t queue_size = 16;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(VECTOR_create(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_QUEUE_SIZE, &queue_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_034: [ Otherwise IoTHubClient_SetOption shall store the queue size and start (once) the callback dispatcher thread, with its condition and queue, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_callback_dispatch_queue_size_ThreadAPI_Create_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t queue_size = 16;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(VECTOR_create(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(THREADAPI_ERROR);
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_QUEUE_SIZE, &queue_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_038: [ IoTHubClient_Destroy shall stop and join the callback dispatcher thread, if any, before taking the lock. ]*/
+TEST_FUNCTION(IoTHubClient_Destroy_joins_the_callback_dispatcher_thread)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t queue_size = 16;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_QUEUE_SIZE, &queue_size);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument_res();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument_iotHubClientHandle();
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)); /*the callback dispatcher queue*/
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_Destroy(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_042: [ If optionName is OPTION_SEND_INGRESS_QUEUE and the value pointed to by value is true, IoTHubClient_SetOption shall create (once) the ingress queue and return IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_send_ingress_queue_creates_the_queue)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool enable = true;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(ingress_queue_create());
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_042: [ If optionName is OPTION_SEND_INGRESS_QUEUE and the value pointed to by value is true, IoTHubClient_SetOption shall create (once) the ingress queue and return IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_send_ingress_queue_create_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool enable = true;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(ingress_queue_create())
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_043: [ If optionName is OPTION_SEND_INGRESS_QUEUE, the value pointed to by value is false and the ingress queue was created then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_send_ingress_queue_cannot_be_disabled)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool enable = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+    enable = false;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_044: [ When the ingress queue is enabled, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall not take the lock; they shall push the message (cloned by IoTHubClient_SendEventAsync) on the ingress queue, wake up the worker thread and return IOTHUB_CLIENT_OK. ]*/
+/* Tests_SRS_IOTHUBCLIENT_41_051: [ IoTHubClient_Destroy shall destroy the messages left in the ingress queue and call their confirmation callbacks with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_with_send_ingress_queue_does_not_take_the_lock)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString("Hello World");
+    bool enable = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the ingress item*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the queue context*/
+    STRICT_EXPECTED_CALL(ingress_queue_push(TEST_INGRESS_QUEUE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_value()
+        .IgnoreArgument_was_empty();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iothub_handle, message, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_NOT_NULL(g_ingress_queue_value);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+    ASSERT_IS_NULL(g_ingress_queue_value);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_045: [ If creating or pushing the ingress item fails, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR and the caller keeps the ownership of the message. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_with_send_ingress_queue_push_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool enable = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(ingress_queue_push(TEST_INGRESS_QUEUE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_value()
+        .IgnoreArgument_was_empty()
+        .SetReturn(__LINE__);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_046: [ Before calling IoTHubClient_LL_DoWork the worker shall pass the messages of the ingress queue, in the order they were pushed, to IoTHubClient_LL_SendEventAsync_TakeOwnership. ]*/
+/* Tests_SRS_IOTHUBCLIENT_41_048: [ Otherwise, if IoTHubClient_LL_SendEventAsync_TakeOwnership fails, the worker shall destroy the message and call the confirmation callback with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_drains_the_send_ingress_queue)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString("Hello World");
+    bool enable = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+    (void)IoTHubClient_SendEventAsync_TakeOwnership(iothub_handle, message, test_event_confirmation_callback, NULL);
+    umock_c_reset_all_calls();
+
+    g_how_thread_loops = 1;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(ingress_queue_pop(TEST_INGRESS_QUEUE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync_TakeOwnership(TEST_IOTHUB_CLIENT_HANDLE, message, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_eventConfirmationCallback()
+        .IgnoreArgument_userContextCallback()
+        .SetReturn(IOTHUB_CLIENT_ERROR);
+    STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_elements();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the queue context*/
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*the ingress item*/
+    STRICT_EXPECTED_CALL(ingress_queue_pop(TEST_INGRESS_QUEUE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, NULL));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_050: [ IoTHubClient_GetSendStatus shall report IOTHUB_CLIENT_SEND_STATUS_BUSY while the ingress queue is not empty. ]*/
+TEST_FUNCTION(IoTHubClient_GetSendStatus_reports_busy_while_the_send_ingress_queue_is_not_empty)
+{
+    // arrange
+    IOTHUB_CLIENT_STATUS status = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString("Hello World");
+    bool enable = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+    (void)IoTHubClient_SendEventAsync_TakeOwnership(iothub_handle, message, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_HANDLE, &status));
+    STRICT_EXPECTED_CALL(ingress_queue_is_empty(TEST_INGRESS_QUEUE_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_GetSendStatus(iothub_handle, &status);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_026: [ If optionName is OPTION_SEND_QUEUE_LIMITS, fullPolicy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK and blockTimeoutInMilliseconds is 0, IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_send_queue_limits_block_without_timeout_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
+    memset(&limits, 0, sizeof(limits));
+    limits.maxMessageCount = 10;
+    limits.fullPolicy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_027: [ If fullPolicy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, IoTHubClient_SetOption shall create (once) a tick counter and a condition used to wait for room in the send queue, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_send_queue_limits_block_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
+    memset(&limits, 0, sizeof(limits));
+    limits.maxMessageCount = 10;
+    limits.fullPolicy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+    limits.blockTimeoutInMilliseconds = 1000;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetOption(TEST_IOTHUB_CLIENT_HANDLE, OPTION_SEND_QUEUE_LIMITS, IGNORED_PTR_ARG))
+        .IgnoreArgument_value();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_027: [ If fullPolicy is IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK, IoTHubClient_SetOption shall create (once) a tick counter and a condition used to wait for room in the send queue, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_send_queue_limits_block_tickcounter_create_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
+    memset(&limits, 0, sizeof(limits));
+    limits.maxMessageCount = 10;
+    limits.fullPolicy = IOTHUB_CLIENT_SEND_QUEUE_FULL_BLOCK;
+    limits.blockTimeoutInMilliseconds = 1000;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(tickcounter_create())
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_006: [ IoTHubClient_SendEventAsync, IoTHubClient_SendReportedState and IoTHubClient_DeviceMethodResponse shall wake up the worker thread when they succeed. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_event_driven_worker_signals_thread)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool event_driven = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &event_driven);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_005: [ Otherwise the thread shall wait on the work condition for at most the worker max idle time before calling IoTHubClient_LL_DoWork again. ]*/
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_event_driven_worker_waits_when_idle)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool event_driven = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &event_driven);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    g_how_thread_loops = 1;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument_iotHubClientStatus();
+    STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, IGNORED_PTR_ARG, 100))
+        .IgnoreArgument_lock();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_094: [ When the push found the ingress queue empty and the worker waits on the work condition, the work condition shall be posted with the lock taken. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_event_driven_worker_posts_under_the_lock_when_the_ingress_queue_was_empty)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString("Hello World");
+    bool enable = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &enable);
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the ingress item*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the queue context*/
+    STRICT_EXPECTED_CALL(ingress_queue_push(TEST_INGRESS_QUEUE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_value()
+        .IgnoreArgument_was_empty();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iothub_handle, message, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_044: [ When the ingress queue is enabled, IoTHubClient_SendEventAsync and IoTHubClient_SendEventAsync_TakeOwnership shall not take the lock; they shall push the message (cloned by IoTHubClient_SendEventAsync) on the ingress queue, wake up the worker thread and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_TakeOwnership_event_driven_worker_does_not_take_the_lock_when_the_ingress_queue_was_not_empty)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString("Hello World");
+    bool enable = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &enable);
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+    g_ingress_queue_value = (void*)0x4242; /*a value pushed before and not taken by the worker yet*/
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the ingress item*/
+    STRICT_EXPECTED_CALL(ingress_queue_push(TEST_INGRESS_QUEUE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_value()
+        .IgnoreArgument_was_empty();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync_TakeOwnership(iothub_handle, message, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_094: [ When the push found the ingress queue empty and the worker waits on the work condition, the work condition shall be posted with the lock taken. ]*/
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_event_driven_worker_does_not_miss_a_push_made_before_it_waits)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    bool enable = true;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_EVENT_DRIVEN_WORKER, &enable);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_SEND_INGRESS_QUEUE, &enable);
+    umock_c_reset_all_calls();
+
+    g_how_thread_loops = 1;
+    /*the second ingress_queue_is_empty is the check wait_for_work makes right before Condition_Wait*/
+    g_push_in_ingress_queue_is_empty_client = iothub_handle;
+    g_push_in_ingress_queue_is_empty_message = IoTHubMessage_CreateFromString("Hello World");
+    g_push_in_ingress_queue_is_empty_call = 2;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(ingress_queue_pop(TEST_INGRESS_QUEUE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(ingress_queue_is_empty(TEST_INGRESS_QUEUE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetSendStatus(TEST_IOTHUB_CLIENT_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument_iotHubClientStatus();
+    STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(ingress_queue_is_empty(TEST_INGRESS_QUEUE_HANDLE));
+    /*the producer, between the check and the wait. With a real lock it blocks until Condition_Wait releases the lock, so its post reaches the waiting worker*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the ingress item*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the queue context*/
+    STRICT_EXPECTED_CALL(ingress_queue_push(TEST_INGRESS_QUEUE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_value()
+        .IgnoreArgument_was_empty();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, IGNORED_PTR_ARG, 100))
+        .IgnoreArgument_lock();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(g_ingress_queue_value);
+
+    // cleanup
+    g_push_in_ingress_queue_is_empty_client = NULL;
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_016: [ If threadCount is 0, IoTHubClient_WorkerPool_Init shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_WorkerPool_Init_threadCount_0_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_WorkerPool_Init(0);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_018: [ IoTHubClient_WorkerPool_Init shall create the process wide worker pool by calling worker_pool_create with threadCount. ]*/
+TEST_FUNCTION(IoTHubClient_WorkerPool_Init_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(worker_pool_create(4));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_WorkerPool_Init(4);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_WorkerPool_Deinit();
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_017: [ If the worker pool is already initialized, IoTHubClient_WorkerPool_Init shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_WorkerPool_Init_twice_fails)
+{
+    // arrange
+    (void)IoTHubClient_WorkerPool_Init(4);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_WorkerPool_Init(4);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_WorkerPool_Deinit();
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_019: [ If worker_pool_create fails, IoTHubClient_WorkerPool_Init shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_WorkerPool_Init_worker_pool_create_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(worker_pool_create(4))
+        .SetReturn(NULL);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_WorkerPool_Init(4);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_020: [ IoTHubClient_WorkerPool_Deinit shall destroy the process wide worker pool, if any. ]*/
+TEST_FUNCTION(IoTHubClient_WorkerPool_Deinit_destroys_the_pool)
+{
+    // arrange
+    (void)IoTHubClient_WorkerPool_Init(4);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(worker_pool_destroy(TEST_WORKER_POOL_HANDLE));
+
+    // act
+    IoTHubClient_WorkerPool_Deinit();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_081: [ If the worker pool is not initialized, IoTHubClient_WorkerPool_SetConnectionRamp shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_WorkerPool_SetConnectionRamp_without_worker_pool_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_WorkerPool_SetConnectionRamp((CONNECTION_RAMP_HANDLE)0x4247);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_084: [ IoTHubClient_WorkerPool_SetConnectionRamp shall save connectionRamp, NULL removing it, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_WorkerPool_SetConnectionRamp_succeeds)
+{
+    // arrange
+    (void)IoTHubClient_WorkerPool_Init(4);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_WorkerPool_SetConnectionRamp((CONNECTION_RAMP_HANDLE)0x4247);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_WorkerPool_Deinit();
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_011: [ If the worker pool is initialized and the client does not use a shared transport, the client shall be added to the worker pool instead of starting a dedicated thread. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_with_worker_pool_adds_the_client_to_the_pool)
+{
+    // arrange
+    (void)IoTHubClient_WorkerPool_Init(4);
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(worker_pool_add(TEST_WORKER_POOL_HANDLE, IGNORED_PTR_ARG, iothub_handle))
+        .IgnoreArgument_work_function();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsync(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(worker_pool_schedule(TEST_WORKER_POOL_ITEM_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+    IoTHubClient_WorkerPool_Deinit();
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_015: [ IoTHubClient_Destroy shall remove the client from the worker pool, waiting for a running work function to finish, before taking the lock. ]*/
+TEST_FUNCTION(IoTHubClient_Destroy_with_worker_pool_removes_the_client_from_the_pool)
+{
+    // arrange
+    (void)IoTHubClient_WorkerPool_Init(4);
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(worker_pool_remove(TEST_WORKER_POOL_ITEM_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument_iotHubClientHandle();
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_Destroy(iothub_handle);
 
-        // assert
-        ASSERT_ARE_NOT_EQUAL_WITH_MSG(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result, tmp_msg);
-    }
+    // assert
+    ASSERT_IS_NULL(g_thread_func);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
-    umock_c_negative_tests_deinit();
-    IoTHubClient_Destroy(iothub_handle);
+    IoTHubClient_WorkerPool_Deinit();
 }
 
 /* Tests_SRS_IOTHUBCLIENT_LL_10_007: [** `IoTHubClient_SetDeviceTwinCallback` shall fail and return `IOTHUB_CLIENT_INVALID_ARG` if parameter `iotHubClientHandle` is `NULL`. ]*/
@@ -1888,6 +3605,65 @@ TEST_FUNCTION(IoTHubClient_SetDeviceTwinCallback_device_twin_callback_succeed)
     IoTHubClient_Destroy(iothub_handle);
 }
 
+/* Tests_SRS_IOTHUBCLIENT_41_077: [ If iotHubClientHandle is NULL, IoTHubClient_SetDeviceTwinPayloadCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_SetDeviceTwinPayloadCallback_client_handle_NULL_fail)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetDeviceTwinPayloadCallback(NULL, test_device_twin_payload_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_079: [ IoTHubClient_SetDeviceTwinPayloadCallback shall replace the callback set by IoTHubClient_SetDeviceTwinCallback. ]*/
+TEST_FUNCTION(IoTHubClient_SetDeviceTwinPayloadCallback_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClient_SetDeviceTwinCallback(iothub_handle, test_device_twin_callback, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetDeviceTwinCallback(TEST_IOTHUB_CLIENT_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetDeviceTwinPayloadCallback(iothub_handle, test_device_twin_payload_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_080: [ IoTHubClient_ReleaseDeviceTwinPayload shall free payLoad with the allocator of the SDK, and do nothing if it is NULL. ]*/
+TEST_FUNCTION(IoTHubClient_ReleaseDeviceTwinPayload_frees_the_payload)
+{
+    // arrange
+    unsigned char* payload = (unsigned char*)my_gballoc_malloc(1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(payload));
+
+    // act
+    IoTHubClient_ReleaseDeviceTwinPayload(payload);
+    IoTHubClient_ReleaseDeviceTwinPayload(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
 /* Tests_SRS_IOTHUBCLIENT_10_013: [** If `iotHubClientHandle` is `NULL`, `IoTHubClient_SendReportedState` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
 TEST_FUNCTION(IoTHubClient_SendReportedState_client_handle_NULL_fail)
 {
@@ -2198,9 +3974,7 @@ TEST_FUNCTION(IoTHubClient_call_inbound_device_callback_succeed)
     (void)IoTHubClient_SetDeviceMethodCallback_Ex(iothub_handle, test_incoming_method_callback, NULL);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreArgument_psz();
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
 
     // act
@@ -2368,6 +4142,42 @@ TEST_FUNCTION(IoTHubClient_UploadToBlobAsync_with_NULL_destinationFileName_fails
     IoTHubClient_Destroy(iothub_handle);
 }
 
+/* Tests_SRS_IOTHUBCLIENT_41_059: [ If iotHubClientHandle, destinationFileName or getDataCallback is NULL then IoTHubClient_UploadMultipleBlocksToBlobAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_UploadMultipleBlocksToBlobAsync_with_NULL_getDataCallback_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_UploadMultipleBlocksToBlobAsync(iothub_handle, "a", NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_063: [ If iotHubClientHandle, destinationFileName or filePath is NULL then IoTHubClient_UploadFileToBlobAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_UploadFileToBlobAsync_with_NULL_filePath_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_UploadFileToBlobAsync(iothub_handle, "a", NULL, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
 /* Tests_SRS_IOTHUBCLIENT_02_049: [ If source is NULL and size is greated than 0 then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
 TEST_FUNCTION(IoTHubClient_UploadToBlobAsync_with_NULL_source_and_size_1_fails)
 {
@@ -2421,53 +4231,155 @@ TEST_FUNCTION(IoTHubClient_UploadToBlobAsync_succeeds)
         .SetReturn((void*)g_thread_func_arg);
     IoTHubClient_Destroy(iothub_handle);
 }
-#endif
 
-/* SYNC DEVICE METHOD */
-TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_VECTOR_move_FAILS_fail)
+/* Tests_SRS_IOTHUBCLIENT_41_067: [ If optionName is OPTION_BLOB_UPLOAD_WORKERS and the value pointed to by value is 0 then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_blob_upload_workers_0_fails)
 {
+    // arrange
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
-    (void)IoTHubClient_SetDeviceMethodCallback(iothub_handle, test_method_callback, CALLBACK_CONTEXT);
-    (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
+    size_t worker_count = 0;
     umock_c_reset_all_calls();
-    g_how_thread_loops = 1;
 
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_HANDLE));
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
-    STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG)).SetReturn(NULL);
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
 
     // act
-    g_thread_func(g_thread_func_arg);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_BLOB_UPLOAD_WORKERS, &worker_count);
 
     // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
     IoTHubClient_Destroy(iothub_handle);
 }
 
-TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_STRING_construct_FAILS_fail)
+/* Tests_SRS_IOTHUBCLIENT_41_069: [ Otherwise IoTHubClient_SetOption shall create the queue of the waiting uploads, a worker pool of workerCount threads with one upload worker per thread, and turn on OPTION_BLOB_UPLOAD_KEEP_CONNECTION so that the workers reuse the connection to IoT Hub, and fail with IOTHUB_CLIENT_ERROR if any of that fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_blob_upload_workers_starts_the_upload_workers)
 {
+    // arrange
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
-    (void)IoTHubClient_SetDeviceMethodCallback(iothub_handle, test_method_callback, CALLBACK_CONTEXT);
+    size_t worker_count = 2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_malloc(2 * sizeof(WORKER_POOL_ITEM_HANDLE)));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(worker_pool_create(2));
+    STRICT_EXPECTED_CALL(worker_pool_add(TEST_WORKER_POOL_HANDLE, IGNORED_PTR_ARG, iothub_handle));
+    STRICT_EXPECTED_CALL(worker_pool_add(TEST_WORKER_POOL_HANDLE, IGNORED_PTR_ARG, iothub_handle));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SetOption(TEST_IOTHUB_CLIENT_HANDLE, OPTION_BLOB_UPLOAD_KEEP_CONNECTION, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_BLOB_UPLOAD_WORKERS, &worker_count);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_068: [ If optionName is OPTION_BLOB_UPLOAD_WORKERS and the upload workers are already started then IoTHubClient_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_blob_upload_workers_twice_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t worker_count = 2;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_BLOB_UPLOAD_WORKERS, &worker_count);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_BLOB_UPLOAD_WORKERS, &worker_count);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_069: [ Otherwise IoTHubClient_SetOption shall create the queue of the waiting uploads, a worker pool of workerCount threads with one upload worker per thread, and turn on OPTION_BLOB_UPLOAD_KEEP_CONNECTION so that the workers reuse the connection to IoT Hub, and fail with IOTHUB_CLIENT_ERROR if any of that fails. ]*/
+TEST_FUNCTION(IoTHubClient_SetOption_blob_upload_workers_worker_pool_create_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t worker_count = 2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_malloc(2 * sizeof(WORKER_POOL_ITEM_HANDLE)));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(worker_pool_create(2))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SetOption(iothub_handle, OPTION_BLOB_UPLOAD_WORKERS, &worker_count);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_41_070: [ When the upload workers are started, IoTHubClient_UploadToBlobAsync shall queue the structure for them and schedule them instead of spawning a thread. ]*/
+TEST_FUNCTION(IoTHubClient_UploadToBlobAsync_with_upload_workers_queues_the_upload)
+{
+    //arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    size_t worker_count = 2;
+    (void)IoTHubClient_SetOption(iothub_handle, OPTION_BLOB_UPLOAD_WORKERS, &worker_count);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG)).SetReturn(NULL);
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "worker_pool_schedule("));
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "IoTHubClient_LL_UploadToBlob("));
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+#endif
+
+/* SYNC DEVICE METHOD */
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_VECTOR_move_FAILS_fail)
+{
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClient_SetDeviceMethodCallback(iothub_handle, test_method_callback, CALLBACK_CONTEXT);
     (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
+    umock_c_reset_all_calls();
     g_how_thread_loops = 1;
 
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(IoTHubClient_LL_DoWork(TEST_IOTHUB_CLIENT_HANDLE));
     STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
-    STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG)).SetReturn(NULL);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(0);
-    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
@@ -2482,16 +4394,13 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_STRING_construct_
     IoTHubClient_Destroy(iothub_handle);
 }
 
-TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_BUFFER_create_FAILS_fail)
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_malloc_FAILS_fail)
 {
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     (void)IoTHubClient_SetDeviceMethodCallback(iothub_handle, test_method_callback, CALLBACK_CONTEXT);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).SetReturn(NULL);
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
     (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
     g_how_thread_loops = 1;
 
@@ -2522,11 +4431,9 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_VECTOR_push_back_
     (void)IoTHubClient_SetDeviceMethodCallback(iothub_handle, test_method_callback, CALLBACK_CONTEXT);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1)).SetReturn(__FAILURE__);
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
     g_how_thread_loops = 1;
@@ -2599,15 +4506,11 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_DMR_Fails)
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(1);
     STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(my_DeviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG, IGNORED_NUM_ARG, CALLBACK_CONTEXT));
+    STRICT_EXPECTED_CALL(my_DeviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_DEVICE_RESP_LENGTH, IGNORED_PTR_ARG, IGNORED_NUM_ARG, CALLBACK_CONTEXT));
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(IoTHubClient_LL_DeviceMethodResponse(TEST_IOTHUB_CLIENT_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(IOTHUB_CLIENT_ERROR);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
@@ -2641,15 +4544,11 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_succeed)
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(1);
     STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(my_DeviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG, IGNORED_NUM_ARG, CALLBACK_CONTEXT));
+    STRICT_EXPECTED_CALL(my_DeviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_DEVICE_RESP_LENGTH, IGNORED_PTR_ARG, IGNORED_NUM_ARG, CALLBACK_CONTEXT));
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(IoTHubClient_LL_DeviceMethodResponse(TEST_IOTHUB_CLIENT_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
@@ -2689,12 +4588,8 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_repeated_method_callback_succeed)
     for (size_t ii = 0; ii < method_calls_repeat; ++ii)
     {
         STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, ii));
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(test_incoming_method_callback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, TEST_METHOD_ID, CALLBACK_CONTEXT));
-        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(test_incoming_method_callback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, CALLBACK_CONTEXT));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     }
 
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
@@ -2713,13 +4608,13 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_repeated_method_callback_succeed)
 }
 
 /* ASYNC DEVICE METHOD */
-TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_STRING_construct_FAILS_fail)
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_malloc_FAILS_fail)
 {
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     (void)IoTHubClient_SetDeviceMethodCallback_Ex(iothub_handle, test_incoming_method_callback, CALLBACK_CONTEXT);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
     (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
     g_how_thread_loops = 1;
 
@@ -2744,15 +4639,15 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_STRING_c
     IoTHubClient_Destroy(iothub_handle);
 }
 
-TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_BUFFER_create_FAILS_fail)
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_VECTOR_push_back_FAILS_fail)
 {
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     (void)IoTHubClient_SetDeviceMethodCallback_Ex(iothub_handle, test_incoming_method_callback, CALLBACK_CONTEXT);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).SetReturn(NULL);
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1)).SetReturn(__FAILURE__);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
     g_how_thread_loops = 1;
@@ -2778,20 +4673,13 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_BUFFER_c
     IoTHubClient_Destroy(iothub_handle);
 }
 
-
-TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_VECTOR_push_back_FAILS_fail)
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_NULL_CONTEXT_fail)
 {
+    // arrange
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     (void)IoTHubClient_SetDeviceMethodCallback_Ex(iothub_handle, test_incoming_method_callback, CALLBACK_CONTEXT);
+    (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, NULL);
     umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1)).SetReturn(__FAILURE__);
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-
-    (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
     g_how_thread_loops = 1;
 
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
@@ -2815,13 +4703,14 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_VECTOR_p
     IoTHubClient_Destroy(iothub_handle);
 }
 
-TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_NULL_CONTEXT_fail)
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_succeed)
 {
     // arrange
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     (void)IoTHubClient_SetDeviceMethodCallback_Ex(iothub_handle, test_incoming_method_callback, CALLBACK_CONTEXT);
-    (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, NULL);
+    (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
     umock_c_reset_all_calls();
+
     g_how_thread_loops = 1;
 
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
@@ -2829,7 +4718,10 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_NULL_CON
     STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
     STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(0);
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(1);
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(test_incoming_method_callback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, CALLBACK_CONTEXT));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
@@ -2845,12 +4737,15 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_NULL_CON
     IoTHubClient_Destroy(iothub_handle);
 }
 
-TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_succeed)
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_repeated_incoming_method_callback_succeed)
 {
     // arrange
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     (void)IoTHubClient_SetDeviceMethodCallback_Ex(iothub_handle, test_incoming_method_callback, CALLBACK_CONTEXT);
-    (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
+    for (size_t ii = 0; ii < method_calls_repeat; ++ii)
+    {
+        (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
+    }
     umock_c_reset_all_calls();
 
     g_how_thread_loops = 1;
@@ -2860,14 +4755,15 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_succeed)
     STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
     STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(1);
-    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(test_incoming_method_callback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, TEST_METHOD_ID, CALLBACK_CONTEXT));
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(method_calls_repeat);
+
+    for (size_t ii = 0; ii < method_calls_repeat; ++ii)
+    {
+        STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, ii));
+        STRICT_EXPECTED_CALL(test_incoming_method_callback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, CALLBACK_CONTEXT));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    }
+
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
@@ -2883,15 +4779,14 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_succeed)
     IoTHubClient_Destroy(iothub_handle);
 }
 
-TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_repeated_incoming_method_callback_succeed)
+/* Tests_SRS_IOTHUBCLIENT_41_078: [ The callback set by IoTHubClient_SetDeviceTwinPayloadCallback shall be handed the queued copy of the payload, which it owns from then on. ]*/
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_device_twin_payload_callback_owns_the_payload)
 {
     // arrange
+    const unsigned char twin[] = "{}";
     IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
-    (void)IoTHubClient_SetDeviceMethodCallback_Ex(iothub_handle, test_incoming_method_callback, CALLBACK_CONTEXT);
-    for (size_t ii = 0; ii < method_calls_repeat; ++ii)
-    {
-        (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
-    }
+    (void)IoTHubClient_SetDeviceTwinPayloadCallback(iothub_handle, test_device_twin_payload_callback, NULL);
+    g_deviceTwinCallback(DEVICE_TWIN_UPDATE_COMPLETE, twin, sizeof(twin), g_userContextCallback);
     umock_c_reset_all_calls();
 
     g_how_thread_loops = 1;
@@ -2901,25 +4796,18 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_repeated_incoming_method_callback
     STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
     STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(method_calls_repeat);
-
-    for (size_t ii = 0; ii < method_calls_repeat; ++ii)
-    {
-        STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, ii));
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(test_incoming_method_callback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, TEST_METHOD_ID, CALLBACK_CONTEXT));
-        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    }
-
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(1);
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_device_twin_payload_callback(DEVICE_TWIN_UPDATE_COMPLETE, IGNORED_PTR_ARG, sizeof(twin), NULL));
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
 
     // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
     g_thread_func(g_thread_func_arg);
 
     // assert
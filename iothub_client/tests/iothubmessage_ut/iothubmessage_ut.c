@@ -76,6 +76,10 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES)
 TEST_DEFINE_ENUM_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 
+TEST_DEFINE_ENUM_TYPE(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_VALUES);
+TEST_DEFINE_ENUM_TYPE(IOTHUB_MESSAGE_COMPRESSION, IOTHUB_MESSAGE_COMPRESSION_VALUES);
+TEST_DEFINE_ENUM_TYPE(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_VALUES);
+
 DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
 static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
@@ -109,6 +113,38 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
     return 0;
 }
 
+static const char TEST_PENDING_PROPERTIES[] = "name1\0value1\0name2\0value2";
+
+static char* create_test_pending_properties(void)
+{
+    char* result = (char*)my_gballoc_malloc(sizeof(TEST_PENDING_PROPERTIES));
+    (void)memcpy(result, TEST_PENDING_PROPERTIES, sizeof(TEST_PENDING_PROPERTIES));
+    return result;
+}
+
+static size_t g_bufferFreeCallCount;
+static const unsigned char* g_bufferFreeBuffer;
+static void* g_bufferFreeContext;
+
+static void test_buffer_free(const unsigned char* buffer, void* context)
+{
+    g_bufferFreeCallCount++;
+    g_bufferFreeBuffer = buffer;
+    g_bufferFreeContext = context;
+}
+
+static const unsigned char TEST_SEGMENT_HEADER[2] = { 'h', 'h' };
+static const unsigned char TEST_SEGMENT_BODY[3] = { 'b', 'b', 'b' };
+static const unsigned char TEST_SEGMENT_TRAILER[1] = { 't' };
+static const IOTHUB_MESSAGE_SEGMENT TEST_SEGMENTS[] =
+{
+    { TEST_SEGMENT_HEADER, sizeof(TEST_SEGMENT_HEADER) },
+    { TEST_SEGMENT_BODY, sizeof(TEST_SEGMENT_BODY) },
+    { NULL, 0 },
+    { TEST_SEGMENT_TRAILER, sizeof(TEST_SEGMENT_TRAILER) }
+};
+#define TEST_SEGMENT_COUNT (sizeof(TEST_SEGMENTS) / sizeof(TEST_SEGMENTS[0]))
+
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -133,6 +169,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -157,6 +194,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(Map_Clone, my_Map_Clone);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_Clone, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(Map_Destroy, my_Map_Destroy);
+    REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_AddOrUpdate, MAP_ERROR);
 
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __FAILURE__);
@@ -179,6 +218,9 @@ TEST_FUNCTION_INITIALIZE(method_init)
     umock_c_reset_all_calls();
 
     g_mapFilterFunc = NULL;
+    g_bufferFreeCallCount = 0;
+    g_bufferFreeBuffer = NULL;
+    g_bufferFreeContext = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -209,7 +251,9 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_happy_path)
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
@@ -244,7 +288,9 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
@@ -263,7 +309,9 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     //arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
@@ -285,7 +333,9 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_fails)
 
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
@@ -319,7 +369,9 @@ TEST_FUNCTION(IoTHubMessage_CreateFromString_happy_path)
 {
     //arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_construct("a"));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
@@ -357,7 +409,9 @@ TEST_FUNCTION(IoTHubMessage_CreateFromString_fails)
 
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_construct("a"));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
@@ -455,9 +509,12 @@ TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_BYTEARRAY_IoTHubMEssage)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(h));
 
     //act
@@ -477,9 +534,12 @@ TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_STRING_IoTHubMessage)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(h));
 
     //act
@@ -575,8 +635,8 @@ TEST_FUNCTION(IoTHubMessage_GetByteArray_with_STRING_fails)
 }
 
 /*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-/*Tests_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_008: [IoTHubMessage_Clone shall share the content of the message with the new message by incrementing its reference count.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_009: [IoTHubMessage_Clone shall share the properties, message id and correlation id of the message with the new message by incrementing their reference count.] */
 /*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
 TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
 {
@@ -585,8 +645,6 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
 
     //act
     IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
@@ -626,8 +684,6 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
 
@@ -653,8 +709,8 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
 }
 
 /*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-/*Tests_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_008: [IoTHubMessage_Clone shall share the content of the message with the new message by incrementing its reference count.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_009: [IoTHubMessage_Clone shall share the properties, message id and correlation id of the message with the new message by incrementing their reference count.] */
 /*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
 TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_happy_path)
 {
@@ -663,8 +719,6 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_happy_path)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
 
     ///act
     IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
@@ -689,8 +743,6 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_fails)
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
 
@@ -1057,4 +1109,1294 @@ TEST_FUNCTION(IoTHubMessage_SetCorrelationId_CorrelationId_Not_NULL_SUCCEED)
     IoTHubMessage_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBMESSAGE_41_001: [The priority of the new message shall be IOTHUB_MESSAGE_PRIORITY_NORMAL.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_007: [IoTHubMessage_GetPriority shall return the priority of the message.] */
+TEST_FUNCTION(IoTHubMessage_GetPriority_of_a_new_message_is_NORMAL)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_PRIORITY result = IoTHubMessage_GetPriority(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_NORMAL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_006: [if the iotHubMessageHandle parameter is NULL then IoTHubMessage_GetPriority shall return IOTHUB_MESSAGE_PRIORITY_NORMAL.] */
+TEST_FUNCTION(IoTHubMessage_GetPriority_NULL_handle_returns_NORMAL)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_PRIORITY result = IoTHubMessage_GetPriority(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_NORMAL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_004: [if iotHubMessageHandle is NULL or priority is not a IOTHUB_MESSAGE_PRIORITY value then IoTHubMessage_SetPriority shall return a IOTHUB_MESSAGE_INVALID_ARG value.] */
+TEST_FUNCTION(IoTHubMessage_SetPriority_NULL_handle_Fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(NULL, IOTHUB_MESSAGE_PRIORITY_HIGH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_004: [if iotHubMessageHandle is NULL or priority is not a IOTHUB_MESSAGE_PRIORITY value then IoTHubMessage_SetPriority shall return a IOTHUB_MESSAGE_INVALID_ARG value.] */
+TEST_FUNCTION(IoTHubMessage_SetPriority_invalid_priority_Fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(h, (IOTHUB_MESSAGE_PRIORITY)(IOTHUB_MESSAGE_PRIORITY_HIGH + 1));
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_NORMAL, IoTHubMessage_GetPriority(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_005: [IoTHubMessage_SetPriority shall store priority in the message and return IOTHUB_MESSAGE_OK.] */
+TEST_FUNCTION(IoTHubMessage_SetPriority_SUCCEED)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString("a");
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(h, IOTHUB_MESSAGE_PRIORITY_HIGH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_HIGH, IoTHubMessage_GetPriority(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_003: [IoTHubMessage_Clone shall copy the priority of the message.] */
+TEST_FUNCTION(IoTHubMessage_Clone_copies_the_priority)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetPriority(h, IOTHUB_MESSAGE_PRIORITY_LOW);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_LOW, IoTHubMessage_GetPriority(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_040: [IoTHubMessage_GetCompression shall return the compression of the message.] */
+TEST_FUNCTION(IoTHubMessage_GetCompression_of_a_new_message_is_DEFAULT)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_COMPRESSION result = IoTHubMessage_GetCompression(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_COMPRESSION, IOTHUB_MESSAGE_COMPRESSION_DEFAULT, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_039: [if the iotHubMessageHandle parameter is NULL then IoTHubMessage_GetCompression shall return IOTHUB_MESSAGE_COMPRESSION_DEFAULT.] */
+TEST_FUNCTION(IoTHubMessage_GetCompression_NULL_handle_returns_DEFAULT)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_COMPRESSION result = IoTHubMessage_GetCompression(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_COMPRESSION, IOTHUB_MESSAGE_COMPRESSION_DEFAULT, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_037: [if iotHubMessageHandle is NULL or compression is not a IOTHUB_MESSAGE_COMPRESSION value then IoTHubMessage_SetCompression shall return a IOTHUB_MESSAGE_INVALID_ARG value.] */
+TEST_FUNCTION(IoTHubMessage_SetCompression_NULL_handle_Fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetCompression(NULL, IOTHUB_MESSAGE_COMPRESSION_GZIP);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_037: [if iotHubMessageHandle is NULL or compression is not a IOTHUB_MESSAGE_COMPRESSION value then IoTHubMessage_SetCompression shall return a IOTHUB_MESSAGE_INVALID_ARG value.] */
+TEST_FUNCTION(IoTHubMessage_SetCompression_invalid_compression_Fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetCompression(h, (IOTHUB_MESSAGE_COMPRESSION)(IOTHUB_MESSAGE_COMPRESSION_GZIP + 1));
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_COMPRESSION, IOTHUB_MESSAGE_COMPRESSION_DEFAULT, IoTHubMessage_GetCompression(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_038: [IoTHubMessage_SetCompression shall store compression in the message and return IOTHUB_MESSAGE_OK.] */
+TEST_FUNCTION(IoTHubMessage_SetCompression_SUCCEED)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString("a");
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetCompression(h, IOTHUB_MESSAGE_COMPRESSION_NONE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_COMPRESSION, IOTHUB_MESSAGE_COMPRESSION_NONE, IoTHubMessage_GetCompression(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_036: [IoTHubMessage_Clone and IoTHubMessage_CreateFromPrototype shall copy the compression of the message.] */
+TEST_FUNCTION(IoTHubMessage_Clone_copies_the_compression)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetCompression(h, IOTHUB_MESSAGE_COMPRESSION_GZIP);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_COMPRESSION, IOTHUB_MESSAGE_COMPRESSION_GZIP, IoTHubMessage_GetCompression(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_036: [IoTHubMessage_Clone and IoTHubMessage_CreateFromPrototype shall copy the compression of the message.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromPrototype_copies_the_compression)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE prototype = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetCompression(prototype, IOTHUB_MESSAGE_COMPRESSION_NONE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromPrototype(prototype, c, 1);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_COMPRESSION, IOTHUB_MESSAGE_COMPRESSION_NONE, IoTHubMessage_GetCompression(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(prototype);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_045: [IoTHubMessage_GetDelivery shall return the delivery of the message.] */
+TEST_FUNCTION(IoTHubMessage_GetDelivery_of_a_new_message_is_DEFAULT)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_DELIVERY result = IoTHubMessage_GetDelivery(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_DEFAULT, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_044: [if the iotHubMessageHandle parameter is NULL then IoTHubMessage_GetDelivery shall return IOTHUB_MESSAGE_DELIVERY_DEFAULT.] */
+TEST_FUNCTION(IoTHubMessage_GetDelivery_NULL_handle_returns_DEFAULT)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_DELIVERY result = IoTHubMessage_GetDelivery(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_DEFAULT, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_042: [if iotHubMessageHandle is NULL or delivery is not a IOTHUB_MESSAGE_DELIVERY value then IoTHubMessage_SetDelivery shall return a IOTHUB_MESSAGE_INVALID_ARG value.] */
+TEST_FUNCTION(IoTHubMessage_SetDelivery_invalid_delivery_Fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDelivery(h, (IOTHUB_MESSAGE_DELIVERY)(IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE + 1));
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_DEFAULT, IoTHubMessage_GetDelivery(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_043: [IoTHubMessage_SetDelivery shall store delivery in the message and return IOTHUB_MESSAGE_OK.] */
+TEST_FUNCTION(IoTHubMessage_SetDelivery_SUCCEED)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString("a");
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDelivery(h, IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE, IoTHubMessage_GetDelivery(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_041: [IoTHubMessage_Clone and IoTHubMessage_CreateFromPrototype shall copy the delivery of the message.] */
+TEST_FUNCTION(IoTHubMessage_Clone_copies_the_delivery)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetDelivery(h, IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE, IoTHubMessage_GetDelivery(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_008: [IoTHubMessage_Clone shall share the content of the message with the new message by incrementing its reference count.] */
+TEST_FUNCTION(IoTHubMessage_Clone_shares_the_content)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    //act
+    const char* clonedString = IoTHubMessage_GetString(r);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)IoTHubMessage_GetString(h), (void*)clonedString);
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_016: [IoTHubMessage_Destroy shall decrement the reference counts of the content and of the properties and free them when they reach zero.] */
+TEST_FUNCTION(IoTHubMessage_Destroy_of_a_clone_frees_only_the_clone)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(r));
+
+    //act
+    IoTHubMessage_Destroy(r);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_STRING_VALUE, IoTHubMessage_GetString(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_016: [IoTHubMessage_Destroy shall decrement the reference counts of the content and of the properties and free them when they reach zero.] */
+TEST_FUNCTION(IoTHubMessage_Destroy_of_the_last_clone_frees_the_shared_content)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    IoTHubMessage_Destroy(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(r));
+
+    //act
+    IoTHubMessage_Destroy(r);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_010: [If the properties are shared with a clone, IoTHubMessage_Properties shall first give the message its own copy of the properties, message id and correlation id by calling Map_Clone and mallocAndStrcpy_s, since the returned map can be changed.] */
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_clone_copies_the_shared_properties)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID));
+
+    //act
+    MAP_HANDLE clonedProperties = IoTHubMessage_Properties(r);
+
+    //assert
+    ASSERT_IS_NOT_NULL(clonedProperties);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)IoTHubMessage_Properties(h), (void*)clonedProperties);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_011: [If making the copy fails, IoTHubMessage_Properties shall return NULL.] */
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_clone_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Properties failure in test %zu/%zu", index, count);
+
+        MAP_HANDLE clonedProperties = IoTHubMessage_Properties(r);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(clonedProperties, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_014: [If the properties are shared with a clone, IoTHubMessage_SetMessageId shall first give the message its own copy of them.] */
+TEST_FUNCTION(IoTHubMessage_SetMessageId_of_a_clone_does_not_change_the_original)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID2));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(r, TEST_MESSAGE_ID2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(h));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID2, IoTHubMessage_GetMessageId(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_015: [If making the copy fails, IoTHubMessage_SetMessageId shall return IOTHUB_MESSAGE_ERROR.] */
+TEST_FUNCTION(IoTHubMessage_SetMessageId_of_a_clone_fails_when_copying_the_properties_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(r, TEST_MESSAGE_ID);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(IoTHubMessage_GetMessageId(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_012: [If the properties are shared with a clone, IoTHubMessage_SetCorrelationId shall first give the message its own copy of them.] */
+TEST_FUNCTION(IoTHubMessage_SetCorrelationId_of_a_clone_does_not_change_the_original)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetCorrelationId(r, TEST_MESSAGE_ID);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(IoTHubMessage_GetCorrelationId(h));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetCorrelationId(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_013: [If making the copy fails, IoTHubMessage_SetCorrelationId shall return IOTHUB_MESSAGE_ERROR.] */
+TEST_FUNCTION(IoTHubMessage_SetCorrelationId_of_a_clone_fails_when_copying_the_properties_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetCorrelationId(r, TEST_MESSAGE_ID);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_019: [IoTHubMessage_CreateFromBorrowedBuffer shall call Map_Create to create the message properties.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_020: [IoTHubMessage_CreateFromBorrowedBuffer shall keep buffer without copying it and return a non-NULL handle to a message of type IOTHUBMESSAGE_BYTEARRAY and priority IOTHUB_MESSAGE_PRIORITY_NORMAL.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromBorrowedBuffer_happy_path)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedBuffer(c, 1, test_buffer_free, (void*)0x4242);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_NORMAL, IoTHubMessage_GetPriority(h));
+    ASSERT_ARE_EQUAL(size_t, 0, g_bufferFreeCallCount);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_017: [If buffer is NULL and size is not zero then IoTHubMessage_CreateFromBorrowedBuffer shall fail and return NULL.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromBorrowedBuffer_with_NULL_buffer_and_non_zero_size_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedBuffer(NULL, 1, test_buffer_free, NULL);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_bufferFreeCallCount);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_018: [If there are any errors then IoTHubMessage_CreateFromBorrowedBuffer shall return NULL and shall not call freeCallback.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromBorrowedBuffer_fails)
+{
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_CreateFromBorrowedBuffer failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedBuffer(c, 1, test_buffer_free, NULL);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(h, tmp_msg);
+        ASSERT_ARE_EQUAL(size_t, 0, g_bufferFreeCallCount);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_021: [If the message was created by IoTHubMessage_CreateFromBorrowedBuffer or IoTHubMessage_CreateFromOwnedBuffer, IoTHubMessage_GetByteArray shall return the buffer and size it was created with.] */
+TEST_FUNCTION(IoTHubMessage_GetByteArray_of_a_borrowed_buffer_returns_the_buffer)
+{
+    //arrange
+    const unsigned char* byteArray;
+    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedBuffer(c, 1, test_buffer_free, NULL);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)byteArray);
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_022: [When the content of a message created by IoTHubMessage_CreateFromBorrowedBuffer or IoTHubMessage_CreateFromBorrowedSegments is freed, IoTHubMessage_Destroy shall call freeCallback with the buffer of each segment and context, if freeCallback is not NULL.] */
+TEST_FUNCTION(IoTHubMessage_Destroy_of_a_borrowed_buffer_calls_the_free_callback_after_the_last_clone)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedBuffer(c, 1, test_buffer_free, (void*)0x4242);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    IoTHubMessage_Destroy(h);
+    ASSERT_ARE_EQUAL(size_t, 0, g_bufferFreeCallCount);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(r));
+
+    //act
+    IoTHubMessage_Destroy(r);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_bufferFreeCallCount);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)g_bufferFreeBuffer);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x4242, g_bufferFreeContext);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_022: [When the content of a message created by IoTHubMessage_CreateFromBorrowedBuffer or IoTHubMessage_CreateFromBorrowedSegments is freed, IoTHubMessage_Destroy shall call freeCallback with the buffer of each segment and context, if freeCallback is not NULL.] */
+TEST_FUNCTION(IoTHubMessage_Destroy_of_a_borrowed_buffer_without_free_callback_succeeds)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedBuffer(c, 1, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_bufferFreeCallCount);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_053: [IoTHubMessage_CreateFromOwnedBuffer shall take ownership of buffer without copying it and return a non-NULL handle to a message of type IOTHUBMESSAGE_BYTEARRAY and priority IOTHUB_MESSAGE_PRIORITY_NORMAL.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_021: [If the message was created by IoTHubMessage_CreateFromBorrowedBuffer or IoTHubMessage_CreateFromOwnedBuffer, IoTHubMessage_GetByteArray shall return the buffer and size it was created with.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromOwnedBuffer_happy_path)
+{
+    //arrange
+    const unsigned char* byteArray;
+    size_t size;
+    unsigned char* buffer = (unsigned char*)my_gballoc_malloc(1);
+    buffer[0] = '3';
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromOwnedBuffer(buffer, 1);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_NORMAL, IoTHubMessage_GetPriority(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(h, &byteArray, &size));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)buffer, (void*)byteArray);
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_051: [If buffer is NULL and size is not zero then IoTHubMessage_CreateFromOwnedBuffer shall fail and return NULL.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromOwnedBuffer_with_NULL_buffer_and_non_zero_size_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromOwnedBuffer(NULL, 1);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_052: [If there are any errors then IoTHubMessage_CreateFromOwnedBuffer shall return NULL and shall not free buffer.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromOwnedBuffer_fails)
+{
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    //arrange
+    unsigned char* buffer = (unsigned char*)my_gballoc_malloc(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_CreateFromOwnedBuffer failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromOwnedBuffer(buffer, 1);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(h, tmp_msg);
+    }
+
+    //cleanup
+    my_gballoc_free(buffer);
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_054: [When the content of a message created by IoTHubMessage_CreateFromOwnedBuffer is freed, IoTHubMessage_Destroy shall free buffer.] */
+TEST_FUNCTION(IoTHubMessage_Destroy_of_an_owned_buffer_frees_the_buffer_after_the_last_clone)
+{
+    //arrange
+    unsigned char* buffer = (unsigned char*)my_gballoc_malloc(1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromOwnedBuffer(buffer, 1);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+    IoTHubMessage_Destroy(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(buffer));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(r));
+
+    //act
+    IoTHubMessage_Destroy(r);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_024: [IoTHubMessage_CreateFromBorrowedSegments shall copy the segment descriptors but not the segments and return a non-NULL handle to a message of type IOTHUBMESSAGE_BYTEARRAY whose content is the segments in order.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_029: [IoTHubMessage_GetSegmentCount shall return the number of segments of a message created by IoTHubMessage_CreateFromBorrowedSegments, and 1 for the other byte array messages.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_031: [IoTHubMessage_GetSegment shall return the buffer and size of the segment without copying it and return IOTHUB_MESSAGE_OK.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromBorrowedSegments_happy_path)
+{
+    //arrange
+    const unsigned char* buffer;
+    size_t size;
+    size_t i;
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedSegments(TEST_SEGMENTS, TEST_SEGMENT_COUNT, test_buffer_free, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(size_t, TEST_SEGMENT_COUNT, IoTHubMessage_GetSegmentCount(h));
+    for (i = 0; i < TEST_SEGMENT_COUNT; i++)
+    {
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetSegment(h, i, &buffer, &size));
+        ASSERT_ARE_EQUAL(void_ptr, (void*)TEST_SEGMENTS[i].buffer, (void*)buffer);
+        ASSERT_ARE_EQUAL(size_t, TEST_SEGMENTS[i].size, size);
+    }
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_023: [If segments is NULL and segmentCount is not zero, or the buffer of a segment is NULL and its size is not zero, then IoTHubMessage_CreateFromBorrowedSegments shall fail and return NULL.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromBorrowedSegments_with_NULL_segments_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedSegments(NULL, 1, test_buffer_free, NULL);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_023: [If segments is NULL and segmentCount is not zero, or the buffer of a segment is NULL and its size is not zero, then IoTHubMessage_CreateFromBorrowedSegments shall fail and return NULL.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromBorrowedSegments_with_a_NULL_segment_buffer_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_SEGMENT segments[2];
+    segments[0].buffer = TEST_SEGMENT_HEADER;
+    segments[0].size = sizeof(TEST_SEGMENT_HEADER);
+    segments[1].buffer = NULL;
+    segments[1].size = 1;
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedSegments(segments, 2, test_buffer_free, NULL);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_025: [If there are any errors then IoTHubMessage_CreateFromBorrowedSegments shall return NULL and shall not call freeCallback.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromBorrowedSegments_fails)
+{
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_CreateFromBorrowedSegments failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedSegments(TEST_SEGMENTS, TEST_SEGMENT_COUNT, test_buffer_free, NULL);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(h, tmp_msg);
+        ASSERT_ARE_EQUAL(size_t, 0, g_bufferFreeCallCount);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_026: [If the message was created by IoTHubMessage_CreateFromBorrowedSegments with more than one segment, IoTHubMessage_GetByteArray shall copy the segments in one block the first time it is called and return that block afterwards, for the message and all its clones.] */
+TEST_FUNCTION(IoTHubMessage_GetByteArray_of_segments_copies_them_once)
+{
+    //arrange
+    const unsigned char* byteArray;
+    const unsigned char* clonedByteArray;
+    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedSegments(TEST_SEGMENTS, TEST_SEGMENT_COUNT, test_buffer_free, NULL);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(6));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+    IOTHUB_MESSAGE_RESULT clonedResult = IoTHubMessage_GetByteArray(r, &clonedByteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, clonedResult);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 6, size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(byteArray, "hhbbbt", 6));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)byteArray, (void*)clonedByteArray);
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_027: [If copying the segments fails, IoTHubMessage_GetByteArray shall return IOTHUB_MESSAGE_ERROR.] */
+TEST_FUNCTION(IoTHubMessage_GetByteArray_of_segments_fails_when_copying_fails)
+{
+    //arrange
+    const unsigned char* byteArray;
+    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedSegments(TEST_SEGMENTS, TEST_SEGMENT_COUNT, test_buffer_free, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(6)).SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_028: [If iotHubMessageHandle is NULL or the message is not of type IOTHUBMESSAGE_BYTEARRAY then IoTHubMessage_GetSegmentCount shall return 0.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_029: [IoTHubMessage_GetSegmentCount shall return the number of segments of a message created by IoTHubMessage_CreateFromBorrowedSegments, and 1 for the other byte array messages.] */
+TEST_FUNCTION(IoTHubMessage_GetSegmentCount_of_the_other_messages)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE byteArrayMessage = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE stringMessage = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    size_t byteArrayCount = IoTHubMessage_GetSegmentCount(byteArrayMessage);
+    size_t stringCount = IoTHubMessage_GetSegmentCount(stringMessage);
+    size_t nullCount = IoTHubMessage_GetSegmentCount(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, byteArrayCount);
+    ASSERT_ARE_EQUAL(size_t, 0, stringCount);
+    ASSERT_ARE_EQUAL(size_t, 0, nullCount);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(stringMessage);
+    IoTHubMessage_Destroy(byteArrayMessage);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_031: [IoTHubMessage_GetSegment shall return the buffer and size of the segment without copying it and return IOTHUB_MESSAGE_OK.] */
+TEST_FUNCTION(IoTHubMessage_GetSegment_of_a_byte_array_message_returns_the_whole_content)
+{
+    //arrange
+    const unsigned char* buffer;
+    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetSegment(h, 0, &buffer, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(buffer, c, 1));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_030: [If iotHubMessageHandle, buffer or size is NULL, or index is not less than IoTHubMessage_GetSegmentCount, then IoTHubMessage_GetSegment shall return IOTHUB_MESSAGE_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubMessage_GetSegment_with_invalid_index_fails)
+{
+    //arrange
+    const unsigned char* buffer;
+    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedSegments(TEST_SEGMENTS, TEST_SEGMENT_COUNT, test_buffer_free, NULL);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetSegment(h, TEST_SEGMENT_COUNT, &buffer, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, IoTHubMessage_GetSegment(NULL, 0, &buffer, &size));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, IoTHubMessage_GetSegment(h, 0, NULL, &size));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, IoTHubMessage_GetSegment(h, 0, &buffer, NULL));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_022: [When the content of a message created by IoTHubMessage_CreateFromBorrowedBuffer or IoTHubMessage_CreateFromBorrowedSegments is freed, IoTHubMessage_Destroy shall call freeCallback with the buffer of each segment and context, if freeCallback is not NULL.] */
+TEST_FUNCTION(IoTHubMessage_Destroy_of_segments_calls_the_free_callback_for_each_segment)
+{
+    //arrange
+    const unsigned char* byteArray;
+    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBorrowedSegments(TEST_SEGMENTS, TEST_SEGMENT_COUNT, test_buffer_free, (void*)0x4242);
+    (void)IoTHubMessage_GetByteArray(h, &byteArray, &size);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, TEST_SEGMENT_COUNT, g_bufferFreeCallCount);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)TEST_SEGMENT_TRAILER, (void*)g_bufferFreeBuffer);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x4242, g_bufferFreeContext);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_033: [IoTHubMessage_CreateFromPrototype shall call BUFFER_create passing byteArray and size as parameters.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_034: [IoTHubMessage_CreateFromPrototype shall share the properties, message id and correlation id of prototype with the new message by incrementing their reference count, copy the priority of prototype and return a non-NULL handle to a message of type IOTHUBMESSAGE_BYTEARRAY.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromPrototype_happy_path)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE prototype = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetMessageId(prototype, TEST_MESSAGE_ID);
+    (void)IoTHubMessage_SetPriority(prototype, IOTHUB_MESSAGE_PRIORITY_HIGH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromPrototype(prototype, c, 1);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_HIGH, IoTHubMessage_GetPriority(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(prototype);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_034: [IoTHubMessage_CreateFromPrototype shall share the properties, message id and correlation id of prototype with the new message by incrementing their reference count, copy the priority of prototype and return a non-NULL handle to a message of type IOTHUBMESSAGE_BYTEARRAY.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromPrototype_message_does_not_change_the_prototype_properties)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE prototype = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromPrototype(prototype, c, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE properties = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(properties);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)IoTHubMessage_Properties(prototype), (void*)properties);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    IoTHubMessage_Destroy(prototype);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_032: [If prototype is NULL, or byteArray is NULL and size is not zero, then IoTHubMessage_CreateFromPrototype shall fail and return NULL.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromPrototype_with_invalid_args_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE prototype = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_HANDLE withoutPrototype = IoTHubMessage_CreateFromPrototype(NULL, c, 1);
+    IOTHUB_MESSAGE_HANDLE withoutByteArray = IoTHubMessage_CreateFromPrototype(prototype, NULL, 1);
+
+    //assert
+    ASSERT_IS_NULL(withoutPrototype);
+    ASSERT_IS_NULL(withoutByteArray);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(prototype);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_035: [If there are any errors then IoTHubMessage_CreateFromPrototype shall return NULL.] */
+TEST_FUNCTION(IoTHubMessage_CreateFromPrototype_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE prototype = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_CreateFromPrototype failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromPrototype(prototype, c, 1);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(h, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubMessage_Destroy(prototype);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_046: [If iotHubMessageHandle or properties is NULL, size is 0 or properties does not end with a NUL, IoTHubMessage_SetPendingProperties shall return IOTHUB_MESSAGE_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubMessage_SetPendingProperties_with_invalid_args_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    char* pending = create_test_pending_properties();
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT withoutHandle = IoTHubMessage_SetPendingProperties(NULL, pending, sizeof(TEST_PENDING_PROPERTIES));
+    IOTHUB_MESSAGE_RESULT withoutProperties = IoTHubMessage_SetPendingProperties(h, NULL, sizeof(TEST_PENDING_PROPERTIES));
+    IOTHUB_MESSAGE_RESULT withoutSize = IoTHubMessage_SetPendingProperties(h, pending, 0);
+    IOTHUB_MESSAGE_RESULT withoutLastNul = IoTHubMessage_SetPendingProperties(h, pending, sizeof(TEST_PENDING_PROPERTIES) - 1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, withoutHandle);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, withoutProperties);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, withoutSize);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, withoutLastNul);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    my_gballoc_free(pending);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_047: [IoTHubMessage_SetPendingProperties shall take ownership of properties and keep it without adding it to the map, then return IOTHUB_MESSAGE_OK.] */
+TEST_FUNCTION(IoTHubMessage_SetPendingProperties_does_not_add_to_the_map)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPendingProperties(h, create_test_pending_properties(), sizeof(TEST_PENDING_PROPERTIES));
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_048: [IoTHubMessage_Properties shall add the pending properties to the map by calling Map_AddOrUpdate for each name and value pair, the first time it is called after IoTHubMessage_SetPendingProperties.] */
+TEST_FUNCTION(IoTHubMessage_Properties_adds_the_pending_properties_once)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetPendingProperties(h, create_test_pending_properties(), sizeof(TEST_PENDING_PROPERTIES));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "name1", "value1"));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "name2", "value2"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE first = IoTHubMessage_Properties(h);
+    MAP_HANDLE second = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(first);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)first, (void*)second);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_049: [If adding a pending property fails, IoTHubMessage_Properties shall return NULL.] */
+TEST_FUNCTION(IoTHubMessage_Properties_adding_the_pending_properties_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetPendingProperties(h, create_test_pending_properties(), sizeof(TEST_PENDING_PROPERTIES));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "name1", "value1"))
+        .SetReturn(MAP_ERROR);
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "name1", "value1"));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "name2", "value2"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE failed = IoTHubMessage_Properties(h);
+    MAP_HANDLE retried = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NULL(failed);
+    ASSERT_IS_NOT_NULL(retried);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_010: [If the properties are shared with a clone, IoTHubMessage_Properties shall first give the message its own copy of the properties, message id and correlation id by calling Map_Clone and mallocAndStrcpy_s, since the returned map can be changed.] */
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_clone_copies_the_pending_properties)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetPendingProperties(h, create_test_pending_properties(), sizeof(TEST_PENDING_PROPERTIES));
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_PENDING_PROPERTIES)));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "name1", "value1"));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "name2", "value2"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE clonedProperties = IoTHubMessage_Properties(r);
+
+    //assert
+    ASSERT_IS_NOT_NULL(clonedProperties);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
 END_TEST_SUITE(iothubmessage_ut)
@@ -86,7 +86,6 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_DEVICE_ID                                    "my_device"
 #define TEST_DEVICE_ID_STRING_HANDLE                      (STRING_HANDLE)0x4442
 #define TEST_IOTHUB_HOST_FQDN                             "some.fqdn.com"
-#define TEST_IOTHUB_HOST_FQDN_STRING_HANDLE               (STRING_HANDLE)0x4443
 #define TEST_ON_STATE_CHANGED_CALLBACK_CONTEXT            (void*)0x4444
 #define TEST_ON_ERROR_CALLBACK_CONTEXT                    (void*)0x4445
 #define TEST_USER_DEFINED_SAS_TOKEN                       "blablabla"
@@ -340,12 +339,25 @@ static void set_expected_calls_for_authentication_create(AUTHENTICATION_CONFIG*
     (void)config;
     EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_DeviceId(TEST_AUTHORIZATION_MODULE_HANDLE));
-    STRICT_EXPECTED_CALL(STRING_construct(TEST_IOTHUB_HOST_FQDN)).SetReturn(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE);
+}
+
+// Offset by which the SAS token of TEST_DEVICE_ID is refreshed earlier, within a refresh window of `window_secs`.
+static size_t get_expected_sas_token_refresh_offset(size_t window_secs)
+{
+    size_t hash = 2166136261u;
+    const char* device_id = TEST_DEVICE_ID;
+
+    while (*device_id != '\0')
+    {
+        hash = (hash ^ (unsigned char)*device_id) * 16777619u;
+        device_id++;
+    }
+
+    return hash % window_secs;
 }
 
 static void set_expected_calls_for_authentication_destroy(AUTHENTICATION_HANDLE handle)
 {
-    STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
     STRICT_EXPECTED_CALL(free(handle));
 }
 
@@ -390,7 +402,6 @@ static void set_expected_calls_for_create_and_put_sas_token(AUTHENTICATION_HANDL
         .SetReturn(current_time);
     STRICT_EXPECTED_CALL(get_difftime(current_time, (time_t)0))
         .SetReturn(difftime(current_time, (time_t)0));
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
     set_expected_calls_for_put_SAS_token_to_cbs(handle, current_time, TEST_GENERATED_SAS_TOKEN_STRING_HANDLE);
     STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
 }
@@ -414,14 +425,12 @@ static void set_expected_calls_for_authentication_do_work(AUTHENTICATION_CONFIG*
     }
     else if (exp_context->current_state == AUTHENTICATION_STATE_STARTING)
     {
-        STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
         set_expected_calls_for_put_SAS_token_to_cbs(handle, current_time, exp_context->sas_token_to_use);
         STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
     }
     else if (exp_context->current_state == AUTHENTICATION_STATE_STARTED)
     {
-        STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
         STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
         STRICT_EXPECTED_CALL(get_difftime(current_time, exp_context->current_sas_token_put_time));
     }
@@ -574,7 +583,7 @@ TEST_FUNCTION(authentication_create_NULL_on_state_changed_callback)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_008: [authentication_create() shall save a copy of `config->device_id` into the `instance->device_id`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_012: [If provided, authentication_create() shall save a copy of `config->device_primary_key` into the `instance->device_primary_key`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_014: [If provided, authentication_create() shall save a copy of `config->device_secondary_key` into `instance->device_secondary_key`]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_016: [If provided, authentication_create() shall save a copy of `config->iothub_host_fqdn` into `instance->iothub_host_fqdn`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_007: [authentication_create() shall keep `config->iothub_host_fqdn` in `instance->iothub_host_fqdn` without copying it, the FQDN belongs to the transport and outlives its devices]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_024: [If no failure occurs, authentication_create() shall return a reference to the AUTHENTICATION_INSTANCE handle]
 TEST_FUNCTION(authentication_create_DEVICE_KEYS_succeeds)
 {
@@ -784,7 +793,6 @@ TEST_FUNCTION(authentication_destroy_NULL_handle)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_109: [authentication_destroy() shall destroy `instance->device_sas_token` using STRING_delete()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_110: [authentication_destroy() shall destroy `instance->device_primary_key` using STRING_delete()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_111: [authentication_destroy() shall destroy `instance->device_secondary_key` using STRING_delete()]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_112: [authentication_destroy() shall destroy `instance->iothub_host_fqdn` using STRING_delete()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_113: [authentication_destroy() shall destroy `instance` using free()]
 TEST_FUNCTION(authentication_destroy_succeeds)
 {
@@ -1006,12 +1014,12 @@ TEST_FUNCTION(authentication_do_work_SAS_TOKEN_AUTHENTICATION_STATE_STARTING_fai
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 0 || i == 1 || i == 4 || i == 6 || i == 7)
+        if (i == 0 || i == 3 || i == 5 || i == 6)
         {
             // These expected calls do not cause the API to fail.
             continue;
         }
-        else if (i == 5)
+        else if (i == 4)
         {
             TEST_cbs_put_token_async_return = 1;
         }
@@ -1102,12 +1110,12 @@ TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_AUTHENTICATION_STATE_STARTING_f
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 0 || i == 1 || i == 3 || i == 4 || i == 7 || i == 8 || i == 10 || i == 11 || i == 12)
+        if (i == 0 || i == 2 || i == 3 || i == 6 || i == 7 || i == 9 || i == 10 || i == 11)
         {
             // These expected calls do not cause the API to fail.
             continue;
         }
-        else if (i == 9)
+        else if (i == 8)
         {
             TEST_cbs_put_token_async_return = 1;
         }
@@ -1137,6 +1145,7 @@ TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_AUTHENTICATION_STATE_STARTING_f
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_040: [If `instance->state` is AUTHENTICATION_STATE_STARTED and user-provided SAS token was used, authentication_do_work() shall return]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_004: [authentication_do_work() shall schedule the SAS token refresh only if the SAS token was created from the device keys, so later calls do not query the credential type]
 TEST_FUNCTION(authentication_do_work_SAS_TOKEN_next_calls_no_op)
 {
     // arrange
@@ -1157,11 +1166,6 @@ TEST_FUNCTION(authentication_do_work_SAS_TOKEN_next_calls_no_op)
     ASSERT_ARE_EQUAL(int, AUTHENTICATION_STATE_STARTED, saved_on_state_changed_callback_new_state);
 
     umock_c_reset_all_calls();
-    
-    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
-    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
-    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
-    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
 
     // act
     authentication_do_work(handle);
@@ -1268,6 +1272,116 @@ TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh)
     authentication_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_001: [If `instance->sas_token_refresh_window_secs` is not 0, the SAS token shall be refreshed earlier than `instance->sas_token_refresh_time_secs` by an offset less than that window, derived from the device id]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_002: [If name matches AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, `value` shall be saved on `instance->sas_token_refresh_window_secs`]
+TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh_window_check)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config);
+
+    size_t refresh_time_secs = 100;
+    size_t window_secs = 100;
+    size_t offset_secs = get_expected_sas_token_refresh_offset(window_secs);
+    ASSERT_ARE_EQUAL(int, 0, authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, &refresh_time_secs));
+    ASSERT_ARE_EQUAL(int, 0, authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, &window_secs));
+
+    time_t current_time = time(NULL);
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+    exp_state->sas_token_to_use = TEST_PRIMARY_DEVICE_KEY_STRING_HANDLE;
+
+    crank_authentication_do_work(config, handle, current_time, exp_state);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    STRICT_EXPECTED_CALL(get_difftime(current_time, IGNORED_NUM_ARG)).SetReturn((double)(refresh_time_secs - offset_secs - 1));
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_001: [If `instance->sas_token_refresh_window_secs` is not 0, the SAS token shall be refreshed earlier than `instance->sas_token_refresh_time_secs` by an offset less than that window, derived from the device id]
+TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh_window)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config);
+
+    size_t refresh_time_secs = 100;
+    size_t window_secs = 100;
+    size_t offset_secs = get_expected_sas_token_refresh_offset(window_secs);
+    ASSERT_ARE_EQUAL(int, 0, authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, &refresh_time_secs));
+    ASSERT_ARE_EQUAL(int, 0, authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, &window_secs));
+
+    time_t current_time = time(NULL);
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+    exp_state->sas_token_to_use = TEST_PRIMARY_DEVICE_KEY_STRING_HANDLE;
+
+    crank_authentication_do_work(config, handle, current_time, exp_state);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    STRICT_EXPECTED_CALL(get_difftime(current_time, IGNORED_NUM_ARG)).SetReturn((double)(refresh_time_secs - offset_secs));
+    set_expected_calls_for_put_SAS_token_to_cbs(handle, current_time, exp_state->sas_token_to_use);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_124: [If name matches AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, `value` shall be saved on `instance->sas_token_refresh_time_secs`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_065: [The SAS token shall be refreshed if the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs`]
+TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh_time_set_after_put)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config);
+
+    time_t current_time = time(NULL);
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+    exp_state->sas_token_to_use = TEST_PRIMARY_DEVICE_KEY_STRING_HANDLE;
+
+    crank_authentication_do_work(config, handle, current_time, exp_state);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    size_t refresh_time_secs = 10;
+    ASSERT_ARE_EQUAL(int, 0, authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, &refresh_time_secs));
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    STRICT_EXPECTED_CALL(get_difftime(current_time, IGNORED_NUM_ARG)).SetReturn((double)refresh_time_secs);
+    set_expected_calls_for_put_SAS_token_to_cbs(handle, current_time, exp_state->sas_token_to_use);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_021: [authentication_create() shall set `instance->cbs_request_timeout_secs` with the default value of UINT32_MAX]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_038: [If `instance->is_cbs_put_token_in_progress` is TRUE, authentication_do_work() shall only verify the authentication timeout]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_043: [authentication_do_work() shall set `instance->is_cbs_put_token_in_progress` to TRUE]
@@ -1554,6 +1668,42 @@ TEST_FUNCTION(authentication_retrieve_options_succeeds)
     authentication_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_003: [AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS shall only be added to the OPTIONHANDLER_HANDLE instance if it is not 0]
+TEST_FUNCTION(authentication_retrieve_options_with_sas_token_refresh_window_succeeds)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_SAS_TOKEN);
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config);
+
+    size_t window_secs = 300;
+    ASSERT_ARE_EQUAL(int, 0, authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, &window_secs));
+
+    umock_c_reset_all_calls();
+    EXPECTED_CALL(OptionHandler_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(TEST_OPTIONHANDLER_HANDLE);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, AUTHENTICATION_OPTION_CBS_REQUEST_TIMEOUT_SECS, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .SetReturn(OPTIONHANDLER_OK);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .SetReturn(OPTIONHANDLER_OK);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, AUTHENTICATION_OPTION_SAS_TOKEN_LIFETIME_SECS, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .SetReturn(OPTIONHANDLER_OK);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .SetReturn(OPTIONHANDLER_OK);
+
+    // act
+    OPTIONHANDLER_HANDLE result = authentication_retrieve_options(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_OPTIONHANDLER_HANDLE, result);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_102: [If an OPTIONHANDLER_HANDLE instance fails to be created, authentication_retrieve_options shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_104: [If OptionHandler_AddOption fails, authentication_retrieve_options shall fail and return NULL]
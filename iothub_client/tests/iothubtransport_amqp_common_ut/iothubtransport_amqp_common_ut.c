@@ -113,7 +113,11 @@ extern "C"
 #include "iothub_client_private.h"
 #include "iothub_client_version.h"
 #include "iothub_client_retry_control.h"
+#include "iothub_client_connection_ramp.h"
+#include "iothub_client_happy_eyeballs.h"
+#include "iothub_client_coalescing_io.h"
 #include "iothubtransportamqp_methods.h"
+#include "iothubtransportamqp_twin.h"
 #include "iothubtransport_amqp_connection.h"
 #include "iothubtransport_amqp_device.h"
 #undef ENABLE_MOCKS
@@ -207,13 +211,6 @@ extern "C"
         return item_found == 1 ? 0 : 1;
     }
 
-    static LIST_ITEM_HANDLE TEST_singlylinkedlist_find(SINGLYLINKEDLIST_HANDLE list, LIST_MATCH_FUNCTION match_function, const void* match_context)
-    {
-        (void)list;
-        (void)match_function;
-        return (LIST_ITEM_HANDLE)match_context;
-    }
-
     static const void* TEST_singlylinkedlist_item_get_value(LIST_ITEM_HANDLE item_handle)
     {
         return (const void*)item_handle;
@@ -369,6 +366,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
 #define TEST_IOTHUBTRANSPORTAMQP_METHODS	       ((IOTHUBTRANSPORT_AMQP_METHODS_HANDLE)0x4244)
 #endif
+#define TEST_IOTHUBTRANSPORTAMQP_TWIN              ((IOTHUBTRANSPORT_AMQP_TWIN_HANDLE)0x4243)
 #define TEST_SESSION_HANDLE                        ((SESSION_HANDLE)0x4245)
 #define TEST_METHOD_HANDLE                         ((IOTHUBTRANSPORT_AMQP_METHOD_HANDLE)0x4246)
 #define TEST_XIO_INTERFACE                         ((const IO_INTERFACE_DESCRIPTION*)0x4247)
@@ -404,6 +402,9 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_X509_PRIVATE_KEY                      "Raphael Rabello"
 #define TEST_MESSAGE_SOURCE_CHAR_PTR               "messagereceiver_link_name"
 #define TEST_RETRY_CONTROL_HANDLE                  (RETRY_CONTROL_HANDLE)0x4276
+#define TEST_RETRY_COORDINATOR_HANDLE              (RETRY_COORDINATOR_HANDLE)0x4277
+#define TEST_CONNECTION_RAMP_HANDLE                (CONNECTION_RAMP_HANDLE)0x4278
+#define TEST_HAPPY_EYEBALLS_HANDLE                 (HAPPY_EYEBALLS_HANDLE)0x4279
 
 
 static const unsigned char* TEST_DEVICE_METHOD_RESPONSE = (const unsigned char*)0x62;
@@ -454,16 +455,6 @@ static void set_expected_calls_for_GetHostname()
     STRICT_EXPECTED_CALL(STRING_clone(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN_CLONE_STRING_HANDLE);
 }
 
-static void set_expected_calls_for_is_device_registered_ex(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
-{
-    (void)device_config;
-
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn((LIST_ITEM_HANDLE)registered_device);
-}
-
 static MESSAGE_DISPOSITION_CONTEXT* TRANSPORT_CONTEXT_DATA_create2(IOTHUB_DEVICE_HANDLE device_handle)
 {
     MESSAGE_DISPOSITION_CONTEXT* result = (MESSAGE_DISPOSITION_CONTEXT*)malloc(sizeof(MESSAGE_DISPOSITION_CONTEXT));
@@ -523,20 +514,10 @@ static void set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_DISPOSIT
     set_expected_calls_for_destroy_device_message_disposition_info();
 }
 
-// @param registered_device
-//     provide the handle to the registered device if the expected call is supposed to return an item, 
-//     or NULL if the intent is to return "not registered".
-static void set_expected_calls_for_is_device_registered(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
-{
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
-        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-
-    set_expected_calls_for_is_device_registered_ex(device_config, registered_device);
-}
-
 static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config, bool is_using_cbs)
 {
-    set_expected_calls_for_is_device_registered_ex(device_config, NULL);
+    // find_registered_device
+    // Nothing to expect.
 
     // is_device_credential_acceptable
     // Nothing to expect.
@@ -552,6 +533,8 @@ static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config,
     EXPECTED_CALL(device_create(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST))
         .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR);
+    STRICT_EXPECTED_CALL(iothubtransportamqp_twin_create(TEST_IOTHUB_HOST_FQDN_CHAR_PTR, device_config->deviceId));
 
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR);
@@ -582,17 +565,12 @@ static void set_expected_calls_for_Unregister(IOTHUB_DEVICE_HANDLE iothub_device
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn((LIST_ITEM_HANDLE)iothub_device_handle);
-
-    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_REGISTERED_DEVICES_LIST, (LIST_ITEM_HANDLE)iothub_device_handle));
 
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
     STRICT_EXPECTED_CALL(iothubtransportamqp_methods_destroy(TEST_IOTHUBTRANSPORTAMQP_METHODS));
 #endif	
+    STRICT_EXPECTED_CALL(iothubtransportamqp_twin_destroy(TEST_IOTHUBTRANSPORTAMQP_TWIN));
 
     STRICT_EXPECTED_CALL(device_destroy(TEST_DEVICE_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICE_ID_STRING_HANDLE));
@@ -767,7 +745,8 @@ static void set_expected_calls_for_Destroy(int number_of_registered_devices, IOT
 
 static void set_expected_calls_for_Subscribe(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
 {
-    set_expected_calls_for_is_device_registered(device_config, registered_device);
+    (void)device_config;
+    (void)registered_device;
 
     STRICT_EXPECTED_CALL(device_subscribe_message(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
@@ -776,7 +755,8 @@ static void set_expected_calls_for_Subscribe(IOTHUB_DEVICE_CONFIG* device_config
 
 static void set_expected_calls_for_Unsubscribe(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
 {
-    set_expected_calls_for_is_device_registered(device_config, registered_device);
+    (void)device_config;
+    (void)registered_device;
 
     STRICT_EXPECTED_CALL(device_unsubscribe_message(TEST_DEVICE_HANDLE));
 }
@@ -791,14 +771,17 @@ static void set_expected_calls_for_prepare_device_for_connection_retry(DEVICE_ST
     }
 }
 
-static void set_expected_calls_for_prepare_for_connection_retry(int number_of_registered_devices, DEVICE_STATE current_device_state)
+static void set_expected_calls_for_prepare_for_connection_retry(int number_of_registered_devices, DEVICE_STATE current_device_state, bool save_options)
 {
     RETRY_ACTION retry_action = RETRY_ACTION_RETRY_NOW;
     STRICT_EXPECTED_CALL(retry_control_should_retry(TEST_RETRY_CONTROL_HANDLE, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer_retry_action(&retry_action, sizeof(RETRY_ACTION));
 
-    STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO_TRANSPORT))
-        .SetReturn(TEST_OPTIONHANDLER_HANDLE);
+    if (save_options)
+    {
+        STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO_TRANSPORT))
+            .SetReturn(TEST_OPTIONHANDLER_HANDLE);
+    }
 
     EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
 
@@ -1103,6 +1086,9 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(PREDICATE_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(PROPERTIES_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(RETRY_CONTROL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(RETRY_COORDINATOR_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CONNECTION_RAMP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HAPPY_EYEBALLS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
@@ -1113,6 +1099,11 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(role, bool);
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUBTRANSPORT_AMQP_METHODS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBTRANSPORT_AMQP_TWIN_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TWIN_ERROR, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TWIN_DOCUMENT_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TWIN_REPORTED_STATE_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CONSTBUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ON_METHOD_REQUEST_RECEIVED, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ON_METHODS_ERROR, void*);
 #endif
@@ -1132,7 +1123,6 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, TEST_singlylinkedlist_remove);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, TEST_singlylinkedlist_get_next_item);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, TEST_singlylinkedlist_find);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, TEST_singlylinkedlist_item_get_value);
 
     REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, my_DList_RemoveEntryList);
@@ -1152,10 +1142,15 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_MessageCallback, TEST_IoTHubClient_LL_MessageCallback);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_GetOption, TEST_IoTHubClient_LL_GetOption);
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, TEST_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, TEST_IoTHubMessage_GetByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(device_send_event_async, TEST_device_send_event_async);
 }
 
 static void register_global_mock_returns()
 {
+    REGISTER_GLOBAL_MOCK_RETURN(iothubtransportamqp_twin_create, TEST_IOTHUBTRANSPORTAMQP_TWIN);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(iothubtransportamqp_twin_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(iothubtransportamqp_twin_send_reported_state, 0);
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
     REGISTER_GLOBAL_MOCK_RETURN(iothubtransportamqp_methods_create, TEST_IOTHUBTRANSPORTAMQP_METHODS);
 #endif
@@ -1246,6 +1241,61 @@ static void initialize_test_variables()
     real_DList_InitializeListHead(&TEST_waitingToSend);
 }
 
+// device_quantum: TEST_events are byte array events of TEST_event_sizes bytes, the events handed to device_send_event_async are counted
+#define TEST_EVENT_COUNT 3
+static IOTHUB_MESSAGE_LIST TEST_events[TEST_EVENT_COUNT];
+static size_t TEST_event_sizes[TEST_EVENT_COUNT];
+static size_t TEST_sent_event_count;
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const unsigned char** buffer, size_t* size)
+{
+    size_t index = (size_t)iotHubMessageHandle - 1;
+
+    *buffer = NULL;
+    *size = (index < TEST_EVENT_COUNT) ? TEST_event_sizes[index] : 0;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static int TEST_device_send_event_async(DEVICE_HANDLE handle, IOTHUB_MESSAGE_LIST* message, ON_DEVICE_D2C_EVENT_SEND_COMPLETE on_device_d2c_event_send_complete_callback, void* context)
+{
+    (void)handle;
+    (void)message;
+    (void)on_device_d2c_event_send_complete_callback;
+    (void)context;
+    TEST_sent_event_count++;
+    return 0;
+}
+
+static void queue_test_events(const size_t* sizes, size_t count)
+{
+    size_t index;
+
+    TEST_sent_event_count = 0;
+    for (index = 0; index < count; index++)
+    {
+        memset(&TEST_events[index], 0, sizeof(TEST_events[index]));
+        TEST_events[index].messageHandle = (IOTHUB_MESSAGE_HANDLE)(index + 1);
+        TEST_event_sizes[index] = sizes[index];
+        real_DList_InsertTailList(&TEST_waitingToSend, &TEST_events[index].entry);
+    }
+}
+
+static TRANSPORT_LL_HANDLE create_transport_with_started_device(IOTHUB_DEVICE_HANDLE* device_handle, size_t device_quantum)
+{
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    IOTHUB_DEVICE_CONFIG device_config;
+
+    device_config.deviceId = "blah";
+    device_config.deviceKey = "cucu";
+    device_config.deviceSasToken = NULL;
+
+    *device_handle = register_device(handle, &device_config, &TEST_waitingToSend, true);
+    crank_transport_ready_after_create(handle, &TEST_waitingToSend, 0, false, true, 1, TEST_current_time, false);
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_DEVICE_QUANTUM, &device_quantum);
+
+    return handle;
+}
+
 
 BEGIN_TEST_SUITE(iothubtransport_amqp_common_ut)
 
@@ -1354,7 +1404,7 @@ TEST_FUNCTION(when_creating_the_methods_handler_fails_then_IoTHubTransport_AMQP_
     size_t n = umock_c_negative_tests_call_count();
     for (i = 0; i < n; i++)
     {
-        if (i == 0 || i == 2 || i == 3 || i == 4 || i == 6 || i == 8 || i == 9 || i == 16)
+        if (i == 0 || i == 2 || i == 3 || i == 4 || i == 6 || i == 8 || i == 10 || i == 11 || i == 18)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -2170,6 +2220,7 @@ TEST_FUNCTION(Register_NULL_config_device_id)
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_064: [If the device is already registered, IoTHubTransport_AMQP_Common_Register shall fail and return NULL.]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_005: [The registered devices shall be looked up by `device->deviceId` in an index hashed by device id, comparing the ids of the devices whose id hash matches]
 TEST_FUNCTION(Register_device_already_registered)
 {
     // arrange
@@ -2178,19 +2229,22 @@ TEST_FUNCTION(Register_device_already_registered)
 
     IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(TEST_LIST_ITEM_HANDLE);
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
 
     // act
-    IOTHUB_DEVICE_HANDLE device_handle = IoTHubTransport_AMQP_Common_Register(handle, device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &TEST_waitingToSend);
+    IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &TEST_waitingToSend);
 
     // assert
-    ASSERT_IS_NULL(device_handle);
+    ASSERT_IS_NOT_NULL(device_handle1);
+    ASSERT_IS_NULL(device_handle2);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
-    destroy_transport(handle, device_handle, NULL);
+    destroy_transport(handle, device_handle1, NULL);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_065: [IoTHubTransport_AMQP_Common_Register shall fail and return NULL if the device is not using an authentication mode compatible with the currently used by the transport.]
@@ -2209,10 +2263,6 @@ TEST_FUNCTION(Register_CBS_transport_X509_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(NULL);
-
     // act
     IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config2, TEST_IOTHUB_CLIENT_LL_HANDLE, &TEST_waitingToSend);
 
@@ -2241,10 +2291,6 @@ TEST_FUNCTION(Register_X509_transport_CBS_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(NULL);
-
     // act
     IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config2, TEST_IOTHUB_CLIENT_LL_HANDLE, &TEST_waitingToSend);
 
@@ -2280,7 +2326,7 @@ TEST_FUNCTION(Register_failure_checks)
     size_t i, n = umock_c_negative_tests_call_count();
     for (i = 0; i < n; i++)
     {
-        if (i == 0 || i == 2 || i == 3 || i == 4 || i >= 6)
+        if (i == 1 || i == 2 || i == 3 || i >= 5)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -2354,32 +2400,6 @@ TEST_FUNCTION(Subscribe_NULL_handle)
     // cleanup
 }
 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_085: [If `amqp_device_instance` is not registered, IoTHubTransport_AMQP_Common_Subscribe shall return a non-zero result]
-TEST_FUNCTION(Subscribe_device_not_registered)
-{
-    // arrange
-    initialize_test_variables();
-    TRANSPORT_LL_HANDLE handle = create_transport();
-
-    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
-    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
-
-    umock_c_reset_all_calls();
-    set_expected_calls_for_is_device_registered(device_config, NULL);
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
-        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-
-    // act
-    int result = IoTHubTransport_AMQP_Common_Subscribe(device_handle);
-
-    // assert
-    ASSERT_ARE_NOT_EQUAL(int, 0, result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    // cleanup
-    destroy_transport(handle, device_handle, NULL);
-}
-
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_086: [device_subscribe_message() shall be invoked passing `on_message_received_callback`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_088: [If no failures occur, IoTHubTransport_AMQP_Common_Subscribe shall return 0]
 TEST_FUNCTION(Subscribe_messages_succeeds)
@@ -2429,11 +2449,6 @@ TEST_FUNCTION(Subscribe_messages_failure_checks)
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 0 || i == 1)
-        {
-            continue;
-        }
-
         // arrange
         char error_msg[64];
         umock_c_negative_tests_reset();
@@ -2468,31 +2483,6 @@ TEST_FUNCTION(Unsubscribe_NULL_handle)
     // cleanup
 }
 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_094: [If `amqp_device_instance` is not registered, IoTHubTransport_AMQP_Common_Subscribe shall return]
-TEST_FUNCTION(Unsubscribe_messages_device_not_registered)
-{
-    // arrange
-    initialize_test_variables();
-    TRANSPORT_LL_HANDLE handle = create_transport();
-
-    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
-    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
-
-    umock_c_reset_all_calls();
-    set_expected_calls_for_is_device_registered(device_config, NULL);
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
-        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-
-    // act
-    IoTHubTransport_AMQP_Common_Unsubscribe(device_handle);
-
-    // assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    // cleanup
-    destroy_transport(handle, device_handle, NULL);
-}
-
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_095: [device_unsubscribe_message() shall be invoked passing `amqp_device_instance->device_handle`]
 TEST_FUNCTION(Unsubscribe_messages_succeeds)
 {
@@ -2871,9 +2861,7 @@ TEST_FUNCTION(SetOption_xio_option_success)
         .IgnoreArgument(2)
         .IgnoreArgument(3)
         .SetReturn(0);
-    STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO_TRANSPORT))
-        .SetReturn(TEST_OPTIONHANDLER_HANDLE);
-        
+
     // act
     IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, "Some XIO option name", &value);
 
@@ -3732,31 +3720,6 @@ TEST_FUNCTION(Unregister_NULL_handle)
     // cleanup
 }
 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_081: [If the device is not registered with this transport, IoTHubTransport_AMQP_Common_Unregister shall return]
-TEST_FUNCTION(Unregister_device_not_registered)
-{
-    // arrange
-    initialize_test_variables();
-    TRANSPORT_LL_HANDLE handle = create_transport();
-
-    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
-    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
-
-    umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
-        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-    set_expected_calls_for_is_device_registered_ex(device_config, NULL);
-
-    // act
-    IoTHubTransport_AMQP_Common_Unregister(device_handle);
-
-    // assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    // cleanup
-    destroy_transport(handle, device_handle, NULL);
-}
-
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_080: [if `deviceHandle` has a NULL reference to its transport instance, IoTHubTransport_AMQP_Common_Unregister shall return.] (NT)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_082: [`device_instance` shall be removed from `instance->registered_devices`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_012: [IoTHubTransport_AMQP_Common_Unregister shall destroy the C2D methods handler by calling iothubtransportamqp_methods_destroy]
@@ -3964,7 +3927,65 @@ TEST_FUNCTION(on_amqp_connection_state_changed_CLOSED_unexpectedly)
         TEST_amqp_connection_create_saved_on_state_changed_context,
         AMQP_CONNECTION_STATE_OPENED, AMQP_CONNECTION_STATE_CLOSED);
 
-    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED);
+    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED, true);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    set_expected_calls_for_DoWork2(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_048: [If no option was passed to `instance->tls_io` since `instance->saved_tls_options` was last saved, xio_retrieveoptions() shall not be called and `instance->saved_tls_options` shall be kept]
+TEST_FUNCTION(on_amqp_connection_state_changed_CLOSED_unexpectedly_twice_retrieves_the_options_once)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    umock_c_reset_all_calls();
+
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, true, true, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_OPENED, AMQP_CONNECTION_STATE_CLOSED);
+
+    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED, true);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    set_expected_calls_for_DoWork2(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, true, true, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_OPENED, AMQP_CONNECTION_STATE_CLOSED);
+
+    // act
+    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED, false);
     IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     set_expected_calls_for_DoWork2(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, true, false, false, 1, TEST_current_time, false);
@@ -3977,6 +3998,57 @@ TEST_FUNCTION(on_amqp_connection_state_changed_CLOSED_unexpectedly)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_002: [If `option` is `keep_underlying_io`, `value` shall be saved as a bool that determines if `instance->tls_io` is kept across re-connections]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_003: [If `keep_underlying_io` is set, `instance->tls_io` shall be neither saved nor destroyed, so the next connection reopens it]
+TEST_FUNCTION(on_amqp_connection_state_changed_CLOSED_unexpectedly_keeps_underlying_io)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    bool keep_underlying_io = true;
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    umock_c_reset_all_calls();
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_KEEP_UNDERLYING_IO, &keep_underlying_io));
+
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, true, true, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // act
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_OPENED, AMQP_CONNECTION_STATE_CLOSED);
+
+    RETRY_ACTION retry_action = RETRY_ACTION_RETRY_NOW;
+    STRICT_EXPECTED_CALL(retry_control_should_retry(TEST_RETRY_CONTROL_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_retry_action(&retry_action, sizeof(RETRY_ACTION));
+    EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_prepare_device_for_connection_retry(DEVICE_STATE_STOPPED);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_destroy(TEST_AMQP_CONNECTION_HANDLE));
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_016: [If `handle` is NULL, IoTHubTransport_AMQP_Common_DoWork shall return without doing any work]
 TEST_FUNCTION(DoWork_NULL_handle)
 {
@@ -4586,4 +4658,632 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetRetryPolicy_success)
     destroy_transport(handle, NULL, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_010: [If `option` is `retry_coordinator`, `value` shall be saved as the RETRY_COORDINATOR_HANDLE shared by the transports and set on `instance->connection_retry_control` using retry_control_set_option()]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_retry_coordinator_success)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_set_option(TEST_RETRY_CONTROL_HANDLE, RETRY_CONTROL_OPTION_RETRY_COORDINATOR, TEST_RETRY_COORDINATOR_HANDLE));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_RETRY_COORDINATOR, TEST_RETRY_COORDINATOR_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_010: [If `option` is `retry_coordinator`, `value` shall be saved as the RETRY_COORDINATOR_HANDLE shared by the transports and set on `instance->connection_retry_control` using retry_control_set_option()]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_retry_coordinator_fails)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_set_option(TEST_RETRY_CONTROL_HANDLE, RETRY_CONTROL_OPTION_RETRY_COORDINATOR, TEST_RETRY_COORDINATOR_HANDLE))
+        .SetReturn(1);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_RETRY_COORDINATOR, TEST_RETRY_COORDINATOR_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_039: [If a happy eyeballs handle was set and the AMQP connection is opened, happy_eyeballs_on_connected() shall be invoked with `instance->tls_io` and `instance->iothub_host_fqdn`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_041: [If `option` is `happy_eyeballs`, `value` shall be saved as the HAPPY_EYEBALLS_HANDLE shared by the transports]
+TEST_FUNCTION(DoWork_happy_eyeballs_remembers_the_family_once_opened)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_HAPPY_EYEBALLS, TEST_HAPPY_EYEBALLS_HANDLE));
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR);
+    STRICT_EXPECTED_CALL(happy_eyeballs_on_connected(TEST_HAPPY_EYEBALLS_HANDLE, TEST_UNDERLYING_IO_TRANSPORT, TEST_IOTHUB_HOST_FQDN_CHAR_PTR));
+
+    // act
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_040: [If a happy eyeballs handle was set and the AMQP connection fails before it is opened, happy_eyeballs_on_connect_failed() shall be invoked with `instance->iothub_host_fqdn`]
+TEST_FUNCTION(DoWork_happy_eyeballs_forgets_the_family_when_the_connection_fails)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_HAPPY_EYEBALLS, TEST_HAPPY_EYEBALLS_HANDLE));
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR);
+    STRICT_EXPECTED_CALL(happy_eyeballs_on_connect_failed(TEST_HAPPY_EYEBALLS_HANDLE, TEST_IOTHUB_HOST_FQDN_CHAR_PTR));
+
+    // act
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_ERROR);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_035: [If `option` is `connection_ramp`, `value` shall be saved as the CONNECTION_RAMP_HANDLE shared by the transports]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_036: [If a connection ramp was set, connection_ramp_admit() shall be invoked with whether `waiting_to_send` has events before the device is started]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_037: [If connection_ramp_admit() returns false, the device shall stay in DEVICE_STATE_STOPPED without a failure being counted]
+TEST_FUNCTION(DoWork_connection_ramp_holds_the_device_back)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_CONNECTION_RAMP, TEST_CONNECTION_RAMP_HANDLE));
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&TEST_waitingToSend));
+    STRICT_EXPECTED_CALL(connection_ramp_admit(TEST_CONNECTION_RAMP_HANDLE, false, IGNORED_PTR_ARG))
+        .IgnoreArgument_wait_time_in_ms()
+        .SetReturn(false);
+    STRICT_EXPECTED_CALL(device_do_work(TEST_DEVICE_HANDLE));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_036: [If a connection ramp was set, connection_ramp_admit() shall be invoked with whether `waiting_to_send` has events before the device is started]
+TEST_FUNCTION(DoWork_connection_ramp_admits_the_device)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_CONNECTION_RAMP, TEST_CONNECTION_RAMP_HANDLE));
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&TEST_waitingToSend));
+    STRICT_EXPECTED_CALL(connection_ramp_admit(TEST_CONNECTION_RAMP_HANDLE, false, IGNORED_PTR_ARG))
+        .IgnoreArgument_wait_time_in_ms()
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(amqp_connection_get_session_handle(TEST_AMQP_CONNECTION_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument_session_handle();
+    STRICT_EXPECTED_CALL(amqp_connection_get_cbs_handle(TEST_AMQP_CONNECTION_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument_cbs_handle();
+    STRICT_EXPECTED_CALL(device_start_async(TEST_DEVICE_HANDLE, TEST_SESSION_HANDLE, TEST_CBS_HANDLE));
+    STRICT_EXPECTED_CALL(device_do_work(TEST_DEVICE_HANDLE));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_011: [If a retry coordinator was set, it shall be set on the new retry control using retry_control_set_option()]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetRetryPolicy_keeps_retry_coordinator)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_RETRY_COORDINATOR, TEST_RETRY_COORDINATOR_HANDLE));
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600));
+    STRICT_EXPECTED_CALL(retry_control_set_option(TEST_RETRY_CONTROL_HANDLE, RETRY_CONTROL_OPTION_RETRY_COORDINATOR, TEST_RETRY_COORDINATOR_HANDLE));
+    STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
+
+    // act
+    int result = IoTHubTransport_AMQP_Common_SetRetryPolicy(handle, IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_012: [If `option` is `retry_initial_wait_time_in_ms`, `value` shall be saved as an unsigned int greater than 0 and set on `instance->connection_retry_control` using retry_control_set_option()]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_retry_initial_wait_time_in_ms_success)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    unsigned int initial_wait_time_in_ms = 250;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_set_option(TEST_RETRY_CONTROL_HANDLE, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, &initial_wait_time_in_ms));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_RETRY_INITIAL_WAIT_TIME_IN_MS, &initial_wait_time_in_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_012: [If `option` is `retry_initial_wait_time_in_ms`, `value` shall be saved as an unsigned int greater than 0 and set on `instance->connection_retry_control` using retry_control_set_option()]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_retry_initial_wait_time_in_ms_zero_fails)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    unsigned int initial_wait_time_in_ms = 0;
+
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_RETRY_INITIAL_WAIT_TIME_IN_MS, &initial_wait_time_in_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_044: [If `option` is `write_coalescing`, `value` shall be saved as a size_t, the most bytes of the frames of a DoWork coalesced in one write, used from the next connection]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_write_coalescing_success)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    size_t write_coalescing_size = 4096;
+
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_WRITE_COALESCING, &write_coalescing_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_045: [If `option` is `device_quantum`, `value` shall be saved as a size_t, the bytes of event content each registered device may send per DoWork, 0 for no limit]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_device_quantum_success)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    size_t device_quantum = 1024;
+
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_DEVICE_QUANTUM, &device_quantum);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_047: [If the registered device is started, each event on `registered_device->wait_to_send_list` shall be removed from the list and sent using device_send_event_async()]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_without_device_quantum_sends_all_the_events)
+{
+    // arrange
+    size_t sizes[] = { 2, 3, 4 };
+    IOTHUB_DEVICE_HANDLE device_handle;
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport_with_started_device(&device_handle, 0);
+    queue_test_events(sizes, sizeof(sizes) / sizeof(sizes[0]));
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, TEST_sent_event_count);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&TEST_waitingToSend));
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_046: [If `device_quantum` is not 0, `device_quantum` shall be added to the deficit of the device, up to `device_quantum` plus the content size of its oldest event, and the events shall be sent only while the content size of the oldest one is not larger than the deficit, which it is taken from; the deficit left shall be kept for the next DoWork]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_with_device_quantum_sends_the_events_that_fit)
+{
+    // arrange
+    size_t sizes[] = { 2, 3, 4 };
+    IOTHUB_DEVICE_HANDLE device_handle;
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport_with_started_device(&device_handle, 5);
+    queue_test_events(sizes, sizeof(sizes) / sizeof(sizes[0]));
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, TEST_sent_event_count);
+    ASSERT_IS_TRUE(TEST_waitingToSend.Flink == &TEST_events[2].entry);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, TEST_sent_event_count);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&TEST_waitingToSend));
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_046: [If `device_quantum` is not 0, `device_quantum` shall be added to the deficit of the device, up to `device_quantum` plus the content size of its oldest event, and the events shall be sent only while the content size of the oldest one is not larger than the deficit, which it is taken from; the deficit left shall be kept for the next DoWork]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_with_device_quantum_an_event_larger_than_the_quantum_waits_for_the_deficit)
+{
+    // arrange
+    size_t sizes[] = { 7 };
+    IOTHUB_DEVICE_HANDLE device_handle;
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport_with_started_device(&device_handle, 3);
+    queue_test_events(sizes, sizeof(sizes) / sizeof(sizes[0]));
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, TEST_sent_event_count);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, TEST_sent_event_count);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&TEST_waitingToSend));
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_047: [A device whose `wait_to_send_list` is empty shall have its deficit set to 0]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_with_device_quantum_a_device_without_events_loses_its_deficit)
+{
+    // arrange
+    size_t sizes[] = { 1 };
+    size_t later_sizes[] = { 7 };
+    IOTHUB_DEVICE_HANDLE device_handle;
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport_with_started_device(&device_handle, 5);
+    queue_test_events(sizes, sizeof(sizes) / sizeof(sizes[0]));
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    queue_test_events(later_sizes, sizeof(later_sizes) / sizeof(later_sizes[0]));
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, TEST_sent_event_count);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, TEST_sent_event_count);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_013: [If `retry_initial_wait_time_in_ms` was set, it shall be set on the new retry control using retry_control_set_option()]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetRetryPolicy_keeps_retry_initial_wait_time_in_ms)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    unsigned int initial_wait_time_in_ms = 250;
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_RETRY_INITIAL_WAIT_TIME_IN_MS, &initial_wait_time_in_ms));
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, 1600));
+    STRICT_EXPECTED_CALL(retry_control_set_option(TEST_RETRY_CONTROL_HANDLE, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_MS, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
+
+    // act
+    int result = IoTHubTransport_AMQP_Common_SetRetryPolicy(handle, IOTHUB_CLIENT_RETRY_DECORRELATED_JITTER, 1600);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+/* IoTHubTransport_AMQP_Common_Register (device twin) */
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_034: [If iothubtransportamqp_twin_create fails, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
+TEST_FUNCTION(when_creating_the_twin_handler_fails_then_IoTHubTransport_AMQP_Common_Register_fails)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_CONFIG device_config;
+    IOTHUB_DEVICE_HANDLE device_handle;
+
+    initialize_test_variables();
+
+    handle = create_transport();
+
+    device_config.deviceId = "blah";
+    device_config.deviceKey = "cucu";
+    device_config.deviceSasToken = NULL;
+
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+    umock_c_reset_all_calls();
+    set_expected_calls_for_Register(&device_config, true);
+    umock_c_negative_tests_snapshot();
+
+    umock_c_negative_tests_reset();
+    // the 10th expected call is iothubtransportamqp_twin_create
+    umock_c_negative_tests_fail_call(9);
+
+    // act
+    device_handle = IoTHubTransport_AMQP_Common_Register(handle, &device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &TEST_waitingToSend);
+
+    // assert
+    ASSERT_IS_NULL(device_handle);
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    destroy_transport(handle, NULL, NULL);
+}
+
+/* IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin */
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_020: [If `handle` is NULL, IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin shall fail and return a non-zero value]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin_with_NULL_handle_fails)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    int result = IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_02_009: [IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin shall remember that the twin links are to be created in the next call to DoWork and return 0; it shall do nothing more if already subscribed]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin_defers_the_twin_links_to_DoWork)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_CONFIG device_config;
+    IOTHUB_DEVICE_HANDLE device_handle;
+
+    initialize_test_variables();
+
+    handle = create_transport();
+
+    device_config.deviceId = "blah";
+    device_config.deviceKey = "cucu";
+    device_config.deviceSasToken = NULL;
+
+    device_handle = register_device(handle, &device_config, &TEST_waitingToSend, true);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(device_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+/* IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin */
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_021: [If `handle` is NULL, IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin shall do nothing]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin_with_NULL_handle_does_nothing)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_02_010: [IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin shall destroy the twin links with iothubtransportamqp_twin_unsubscribe if they were created; the reported states waiting for their response are sent again by the next subscribe]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin_before_DoWork_does_not_touch_the_twin_links)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_CONFIG device_config;
+    IOTHUB_DEVICE_HANDLE device_handle;
+
+    initialize_test_variables();
+
+    handle = create_transport();
+
+    device_config.deviceId = "blah";
+    device_config.deviceKey = "cucu";
+    device_config.deviceSasToken = NULL;
+
+    device_handle = register_device(handle, &device_config, &TEST_waitingToSend, true);
+    (void)IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(device_handle);
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin(device_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+/* IoTHubTransport_AMQP_Common_ProcessItem */
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_028: [If `handle` or `iothub_item` is NULL, IoTHubTransport_AMQP_Common_ProcessItem shall return IOTHUB_PROCESS_ERROR]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_ProcessItem_with_NULL_arguments_fails)
+{
+    // arrange
+    IOTHUB_DEVICE_TWIN device_twin;
+    IOTHUB_IDENTITY_INFO identity_info;
+    identity_info.device_twin = &device_twin;
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_PROCESS_ITEM_RESULT result1 = IoTHubTransport_AMQP_Common_ProcessItem(NULL, IOTHUB_TYPE_DEVICE_TWIN, &identity_info);
+    IOTHUB_PROCESS_ITEM_RESULT result2 = IoTHubTransport_AMQP_Common_ProcessItem(TEST_IOTHUB_DEVICE_HANDLE, IOTHUB_TYPE_DEVICE_TWIN, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, IOTHUB_PROCESS_ERROR, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_PROCESS_ERROR, result2);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_029: [If `item_type` is not IOTHUB_TYPE_DEVICE_TWIN, IoTHubTransport_AMQP_Common_ProcessItem shall return IOTHUB_PROCESS_CONTINUE]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_030: [If the twin links of the device are not up, IoTHubTransport_AMQP_Common_ProcessItem shall return IOTHUB_PROCESS_NOT_CONNECTED]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_ProcessItem_without_twin_links_is_not_connected)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_CONFIG device_config;
+    IOTHUB_DEVICE_HANDLE device_handle;
+    IOTHUB_DEVICE_TWIN device_twin;
+    IOTHUB_IDENTITY_INFO identity_info;
+
+    initialize_test_variables();
+
+    handle = create_transport();
+
+    device_config.deviceId = "blah";
+    device_config.deviceKey = "cucu";
+    device_config.deviceSasToken = NULL;
+
+    device_handle = register_device(handle, &device_config, &TEST_waitingToSend, true);
+    (void)IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(device_handle);
+    memset(&device_twin, 0, sizeof(device_twin));
+    device_twin.item_id = 42;
+    identity_info.device_twin = &device_twin;
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_PROCESS_ITEM_RESULT result1 = IoTHubTransport_AMQP_Common_ProcessItem(device_handle, IOTHUB_TYPE_TELEMETRY, &identity_info);
+    IOTHUB_PROCESS_ITEM_RESULT result2 = IoTHubTransport_AMQP_Common_ProcessItem(device_handle, IOTHUB_TYPE_DEVICE_TWIN, &identity_info);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, IOTHUB_PROCESS_CONTINUE, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_PROCESS_NOT_CONNECTED, result2);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 END_TEST_SUITE(iothubtransport_amqp_common_ut)
@@ -422,10 +422,8 @@ static void set_expected_calls_for_is_timeout_reached(time_t current_time)
 
 static void set_expected_calls_for_clone_device_config(DEVICE_CONFIG *config)
 {
+    (void)config;
     STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, config->product_info));
-
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, config->iothub_host_fqdn));
     STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_DeviceId(TEST_AUTHORIZATION_MODULE_HANDLE));
 }
 
@@ -540,8 +538,6 @@ static void set_expected_calls_for_device_destroy(DEVICE_HANDLE handle, DEVICE_C
     }
 
     // destroy config
-    STRICT_EXPECTED_CALL(free(config->product_info));
-    STRICT_EXPECTED_CALL(free(config->iothub_host_fqdn));
     EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
     STRICT_EXPECTED_CALL(free(handle));
@@ -572,6 +568,7 @@ static void set_expected_calls_for_device_set_option(DEVICE_HANDLE handle, DEVIC
     {
         if (strcmp(DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS, option_name) == 0 ||
             strcmp(DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, option_name) == 0 ||
+            strcmp(DEVICE_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, option_name) == 0 ||
             strcmp(DEVICE_OPTION_SAS_TOKEN_LIFETIME_SECS, option_name) == 0)
         {
             STRICT_EXPECTED_CALL(authentication_set_option(TEST_AUTHENTICATION_HANDLE, option_name, option_value));
@@ -582,7 +579,10 @@ static void set_expected_calls_for_device_set_option(DEVICE_HANDLE handle, DEVIC
         }
     }
 
-    if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, option_name) == 0)
+    if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, option_name) == 0 ||
+        strcmp(DEVICE_OPTION_EVENT_SEND_BATCH_MAX_COUNT, option_name) == 0 ||
+        strcmp(DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_SECS, option_name) == 0 ||
+        strcmp(DEVICE_OPTION_C2D_LINK_CREDIT, option_name) == 0)
     {
         STRICT_EXPECTED_CALL(messenger_set_option(TEST_MESSENGER_HANDLE, option_name, option_value));
     }
@@ -776,6 +776,7 @@ TEST_FUNCTION(device_create_NULL_config_on_state_changed_callback)
 
 // Tests_SRS_DEVICE_09_002: [device_create shall allocate memory for the device instance structure]
 // Tests_SRS_DEVICE_09_004: [All `config` parameters shall be saved into `instance`]
+// Tests_SRS_DEVICE_41_001: [The copy of `config` shall keep `config->iothub_host_fqdn` without copying it, the FQDN belongs to the transport and is shared by all its devices; `config->product_info` is only used by device_create() and shall not be kept]
 // Tests_SRS_DEVICE_09_006: [If `instance->authentication_mode` is DEVICE_AUTH_MODE_CBS, `instance->authentication_handle` shall be set using authentication_create()]
 // Tests_SRS_DEVICE_09_008: [`instance->messenger_handle` shall be set using messenger_create()]
 // Tests_SRS_DEVICE_09_011: [If device_create succeeds it shall return a handle to its `instance` structure]
@@ -821,7 +822,7 @@ TEST_FUNCTION(device_create_failure_checks)
         // arrange 
         char error_msg[64];
 
-        if (i == 4)
+        if (i == 2)
         {
             // for the IoTHubClient_Auth_Get_DeviceId
             continue;
@@ -1713,6 +1714,85 @@ TEST_FUNCTION(device_set_option_MSGR_succeeds)
     device_destroy(handle);
 }
 
+// Tests_SRS_DEVICE_09_084: [If `name` refers to authentication, it shall be passed along with `value` to authentication_set_option]
+TEST_FUNCTION(device_set_option_AUTH_sas_token_refresh_window_succeeds)
+{
+    // arrange
+    ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
+    DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+    size_t window_secs = 300;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, &window_secs);
+
+    // act
+    int result = device_set_option(handle, DEVICE_OPTION_SAS_TOKEN_REFRESH_WINDOW_SECS, &window_secs);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    device_destroy(handle);
+}
+
+// Tests_SRS_DEVICE_09_086: [If `name` refers to messenger module, it shall be passed along with `value` to messenger_set_option]
+TEST_FUNCTION(device_set_option_MSGR_event_send_batch_succeeds)
+{
+    // arrange
+    ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
+    DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+    size_t max_count = 10;
+    size_t linger_secs = 1;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_EVENT_SEND_BATCH_MAX_COUNT, &max_count);
+    set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_SECS, &linger_secs);
+
+    // act
+    int result1 = device_set_option(handle, DEVICE_OPTION_EVENT_SEND_BATCH_MAX_COUNT, &max_count);
+    int result2 = device_set_option(handle, DEVICE_OPTION_EVENT_SEND_BATCH_LINGER_SECS, &linger_secs);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+
+    // cleanup
+    device_destroy(handle);
+}
+
+// Tests_SRS_DEVICE_09_086: [If `name` refers to messenger module, it shall be passed along with `value` to messenger_set_option]
+TEST_FUNCTION(device_set_option_MSGR_c2d_link_credit_succeeds)
+{
+    // arrange
+    ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
+    DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+    size_t c2d_link_credit = 500;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_C2D_LINK_CREDIT, &c2d_link_credit);
+
+    // act
+    int result = device_set_option(handle, DEVICE_OPTION_C2D_LINK_CREDIT, &c2d_link_credit);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    device_destroy(handle);
+}
+
 // Tests_SRS_DEVICE_09_088: [If `name` is DEVICE_OPTION_SAVED_AUTH_OPTIONS but CBS authentication is not being used, device_set_option shall return a non-zero result]
 TEST_FUNCTION(device_set_option_X509_saved_auth_options)
 {
@@ -41,7 +41,7 @@ void real_free(void* ptr)
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/optionhandler.h"
 #include "azure_uamqp_c/session.h"
@@ -57,6 +57,20 @@ void real_free(void* ptr)
 
 #include "iothubtransport_amqp_messenger.h"
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+	void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+	int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+	void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+	void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+	void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+	int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+	PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+#ifdef __cplusplus
+}
+#endif
 
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
@@ -87,7 +101,6 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 
 #define TEST_DEVICE_ID                                    "my_device"
 #define TEST_DEVICE_ID_STRING_HANDLE                      (STRING_HANDLE)0x4442
-#define TEST_IOTHUB_HOST_FQDN_STRING_HANDLE               (STRING_HANDLE)0x4443
 #define TEST_IOTHUB_HOST_FQDN                             "some.fqdn.com"
 #define TEST_ON_STATE_CHANGED_CB_CONTEXT                  (void*)0x4445
 #define TEST_STRING_HANDLE                                (STRING_HANDLE)0x4446
@@ -132,18 +145,11 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_MESSAGE_DISPOSITION_ACCEPTED_AMQP_VALUE      (AMQP_VALUE)0x4471
 #define TEST_MESSAGE_DISPOSITION_RELEASED_AMQP_VALUE      (AMQP_VALUE)0x4472
 #define TEST_MESSAGE_DISPOSITION_REJECTED_AMQP_VALUE      (AMQP_VALUE)0x4473
-#define TEST_SINGLYLINKEDLIST_HANDLE                      (SINGLYLINKEDLIST_HANDLE)0x4476
-#define TEST_LIST_ITEM_HANDLE                             (LIST_ITEM_HANDLE)0x4477
 #define TEST_SEND_EVENT_TASK                              (const void*)0x4478
 #define TEST_IOTHUB_CLIENT_HANDLE                         (void*)0x4479
 static IOTHUB_MESSAGE_LIST* TEST_IOTHUB_MESSAGE_LIST_HANDLE;
-static SINGLYLINKEDLIST_HANDLE TEST_WAIT_TO_SEND_LIST;
-static SINGLYLINKEDLIST_HANDLE TEST_IN_PROGRESS_LIST;
-#define TEST_WAIT_TO_SEND_LIST1                           (SINGLYLINKEDLIST_HANDLE)0x4481
-#define TEST_WAIT_TO_SEND_LIST2                           (SINGLYLINKEDLIST_HANDLE)0x4482
-#define TEST_IN_PROGRESS_LIST1                            (SINGLYLINKEDLIST_HANDLE)0x4483
-#define TEST_IN_PROGRESS_LIST2                            (SINGLYLINKEDLIST_HANDLE)0x4484
 #define TEST_OPTIONHANDLER_HANDLE                         (OPTIONHANDLER_HANDLE)0x4485
+#define TEST_PROPERTY_KEY_CACHE_HANDLE                    (UAMQP_PROPERTY_KEY_CACHE_HANDLE)0x4486
 #define INDEFINITE_TIME                                   ((time_t)-1)
 
 static delivery_number TEST_DELIVERY_NUMBER;
@@ -157,6 +163,7 @@ extern "C"
 #endif
 
 static int TEST_link_set_max_message_size_result;
+static size_t TEST_c2d_link_credit;
 int TEST_amqpvalue_set_map_value_result;
 int TEST_link_set_attach_properties_result;
 
@@ -216,19 +223,6 @@ static void TEST_free(void* ptr)
 	}
 }
 
-
-static int saved_wait_to_send_list_count;
-static const void* saved_wait_to_send_list[20];
-
-static int saved_wait_to_send_list_count2;
-static const void* saved_wait_to_send_list2[20];
-
-static int saved_in_progress_list_count;
-static const void* saved_in_progress_list[20];
-
-static int saved_in_progress_list_count2;
-static const void* saved_in_progress_list2[20];
-
 static void* saved_on_state_changed_callback_context;
 static MESSENGER_STATE saved_on_state_changed_callback_previous_state;
 static MESSENGER_STATE saved_on_state_changed_callback_new_state;
@@ -363,8 +357,9 @@ static MESSENGER_DO_WORK_EXP_CALL_PROFILE* get_msgr_do_work_exp_call_profile(MES
 
 static IOTHUB_MESSAGE_HANDLE saved_message_create_from_iothub_message;
 static int TEST_message_create_from_iothub_message_return;
-static int TEST_message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MESSAGE_HANDLE* uamqp_message)
+static int TEST_message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, UAMQP_PROPERTY_KEY_CACHE_HANDLE key_cache, MESSAGE_HANDLE* uamqp_message)
 {
+    (void)key_cache;
     saved_message_create_from_iothub_message = iothub_message;
 
     if (TEST_message_create_from_iothub_message_return == 0)
@@ -390,6 +385,15 @@ static int TEST_IoTHubMessage_CreateFromUamqpMessage(MESSAGE_HANDLE uamqp_messag
     return TEST_IoTHubMessage_CreateFromUamqpMessage_return;
 }
 
+#define TEST_ENCODED_MESSAGE_SIZE 16
+static int TEST_message_create_uamqp_encoding_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, BINARY_DATA* encoded_message)
+{
+    (void)iothub_message;
+    encoded_message->bytes = (const unsigned char*)TEST_malloc(TEST_ENCODED_MESSAGE_SIZE);
+    encoded_message->length = TEST_ENCODED_MESSAGE_SIZE;
+    return 0;
+}
+
 static int TEST_messagesender_send_result;
 static MESSAGE_SENDER_HANDLE saved_messagesender_send_message_sender;
 static MESSAGE_HANDLE saved_messagesender_send_message;
@@ -406,215 +410,16 @@ static int TEST_messagesender_send(MESSAGE_SENDER_HANDLE message_sender, MESSAGE
     return TEST_messagesender_send_result;
 }
 
-
-static bool TEST_singlylinkedlist_add_fail_return = false;
-static LIST_ITEM_HANDLE TEST_singlylinkedlist_add(SINGLYLINKEDLIST_HANDLE list, const void* item)
-{
-	if (list == TEST_WAIT_TO_SEND_LIST1)
-	{
-		saved_wait_to_send_list[saved_wait_to_send_list_count++] = item;
-	}
-	else if (list == TEST_WAIT_TO_SEND_LIST2)
-	{
-		saved_wait_to_send_list2[saved_wait_to_send_list_count2++] = item;
-	}
-	else if (list == TEST_IN_PROGRESS_LIST1)
-	{
-		saved_in_progress_list[saved_in_progress_list_count++] = item;
-	}
-	else if (list == TEST_IN_PROGRESS_LIST2)
-	{
-		saved_in_progress_list2[saved_in_progress_list_count2++] = item;
-	}
-
-	return TEST_singlylinkedlist_add_fail_return ? NULL : (LIST_ITEM_HANDLE)item;
-}
-
-static int TEST_singlylinkedlist_remove_return = 0;
-static int TEST_singlylinkedlist_remove(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE item)
+static bool TEST_messagesender_destroy_cancels_pending_send;
+static void TEST_messagesender_destroy(MESSAGE_SENDER_HANDLE message_sender)
 {
-	const void** TEST_list = NULL;
-	int* TEST_list_count = NULL;
-
-	if (list == TEST_WAIT_TO_SEND_LIST1)
-	{
-		TEST_list = saved_wait_to_send_list;
-		TEST_list_count = &saved_wait_to_send_list_count;
-	}
-	else if (list == TEST_WAIT_TO_SEND_LIST2)
-	{
-		TEST_list = saved_wait_to_send_list2;
-		TEST_list_count = &saved_wait_to_send_list_count2;
-	}
-	else if (list == TEST_IN_PROGRESS_LIST1)
-	{
-		TEST_list = saved_in_progress_list;
-		TEST_list_count = &saved_in_progress_list_count;
-	}
-	else // i.e., "if (list == TEST_IN_PROGRESS_LIST2)"
-	{
-		TEST_list = saved_in_progress_list2;
-		TEST_list_count = &saved_in_progress_list_count2;
-	}
-
-	int i;
-	int item_found = 0;
-	for (i = 0; i < *TEST_list_count; i++)
-	{
-		if (item_found)
-		{
-			TEST_list[i - 1] = TEST_list[i];
-		}
-		else if (TEST_list[i] == item)
-		{
-			item_found = 1;
-		}
-	}
-
-	if (item_found)
-	{
-		(*TEST_list_count)--;
-	}
+    (void)message_sender;
 
-	return item_found == 1 ? 0 : 1;
-}
-
-static LIST_ITEM_HANDLE TEST_singlylinkedlist_find(SINGLYLINKEDLIST_HANDLE list, LIST_MATCH_FUNCTION match_function, const void* match_context)
-{
-	(void)list;
-	(void)match_function;
-	return (LIST_ITEM_HANDLE)match_context;
-}
-
-static const void* TEST_singlylinkedlist_item_get_value(LIST_ITEM_HANDLE item_handle)
-{
-	return (const void*)item_handle;
-}
-
-static LIST_ITEM_HANDLE TEST_singlylinkedlist_get_head_item(SINGLYLINKEDLIST_HANDLE list)
-{
-	LIST_ITEM_HANDLE list_item;
-
-	if (list == TEST_WAIT_TO_SEND_LIST1)
-	{
-		if (saved_wait_to_send_list_count <= 0)
-		{
-			list_item = NULL;
-		}
-		else
-		{
-			list_item = (LIST_ITEM_HANDLE)saved_wait_to_send_list[0];
-		}
-	}
-	else if (list == TEST_WAIT_TO_SEND_LIST2)
-	{
-		if (saved_wait_to_send_list_count2 <= 0)
-		{
-			list_item = NULL;
-		}
-		else
-		{
-			list_item = (LIST_ITEM_HANDLE)saved_wait_to_send_list2[0];
-		}
-	}
-	else if (list == TEST_IN_PROGRESS_LIST1)
-	{
-		if (saved_in_progress_list_count <= 0)
-		{
-			list_item = NULL;
-		}
-		else
-		{
-			list_item = (LIST_ITEM_HANDLE)saved_in_progress_list[0];
-		}
-	}
-	else if (list == TEST_IN_PROGRESS_LIST2)
-	{
-		if (saved_in_progress_list_count2 <= 0)
-		{
-			list_item = NULL;
-		}
-		else
-		{
-			list_item = (LIST_ITEM_HANDLE)saved_in_progress_list2[0];
-		}
-	}
-	else
-	{
-		list_item = NULL;
-	}
-
-	return list_item;
-}
-
-static LIST_ITEM_HANDLE TEST_singlylinkedlist_get_next_item(LIST_ITEM_HANDLE item_handle)
-{
-	LIST_ITEM_HANDLE next_item = NULL;
-
-	int i;
-	int item_found = 0;
-	for (i = 0; i < saved_in_progress_list_count; i++)
-	{
-		if (item_found)
-		{
-			next_item = (LIST_ITEM_HANDLE)saved_in_progress_list[i];
-			break;
-		}
-		else if (saved_in_progress_list[i] == (void*)item_handle)
-		{
-			item_found = 1;
-		}
-	}
-
-	if (item_found == 0)
-	{
-		for (i = 0; i < saved_in_progress_list_count2; i++)
-		{
-			if (item_found)
-			{
-				next_item = (LIST_ITEM_HANDLE)saved_in_progress_list2[i];
-				break;
-			}
-			else if (saved_in_progress_list2[i] == (void*)item_handle)
-			{
-				item_found = 1;
-			}
-		}
-	}
-
-	if (item_found == 0)
-	{
-		for (i = 0; i < saved_wait_to_send_list_count2; i++)
-		{
-			if (item_found)
-			{
-				next_item = (LIST_ITEM_HANDLE)saved_wait_to_send_list2[i];
-				break;
-			}
-			else if (saved_wait_to_send_list2[i] == (void*)item_handle)
-			{
-				item_found = 1;
-			}
-		}
-	}
-
-	if (item_found == 0)
-	{
-		for (i = 0; i < saved_wait_to_send_list_count; i++)
-		{
-			if (item_found)
-			{
-				next_item = (LIST_ITEM_HANDLE)saved_wait_to_send_list[i];
-				break;
-			}
-			else if (saved_wait_to_send_list[i] == (void*)item_handle)
-			{
-				item_found = 1;
-			}
-		}
-	}
-
-	return next_item;
+    // uAMQP reports the messages still pending as failed when the message sender is destroyed.
+    if (TEST_messagesender_destroy_cancels_pending_send && saved_messagesender_send_on_message_send_complete != NULL)
+    {
+        saved_messagesender_send_on_message_send_complete(saved_messagesender_send_callback_context, MESSAGE_SEND_ERROR);
+    }
 }
 
 
@@ -622,11 +427,11 @@ static void set_expected_calls_for_messenger_create(MESSENGER_CONFIG* config)
 {
     EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
     // memset() - not mocked.
+	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(STRING_construct(config->device_id)).SetReturn(TEST_DEVICE_ID_STRING_HANDLE);
     STRICT_EXPECTED_CALL(STRING_construct(config->device_id)).SetReturn(TEST_DEVICE_ID_STRING_HANDLE);
-    STRICT_EXPECTED_CALL(STRING_construct(config->iothub_host_fqdn)).SetReturn(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE);
-	STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_WAIT_TO_SEND_LIST);
-	STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_IN_PROGRESS_LIST);
+    STRICT_EXPECTED_CALL(uamqp_property_key_cache_create());
 }
 
 static void set_expected_calls_for_attach_device_client_type_to_link(LINK_HANDLE link_handle, int amqpvalue_set_map_value_result, int link_set_attach_properties_result)
@@ -653,7 +458,6 @@ static void set_expected_calls_for_message_receiver_create()
     // create_event_sender()
     // create_devices_path()
     STRICT_EXPECTED_CALL(STRING_new()).SetReturn(TEST_DEVICES_PATH_STRING_HANDLE);
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN);
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE)).SetReturn(TEST_DEVICE_ID);
     // EXPECTED: STRING_sprintf
 
@@ -689,6 +493,11 @@ static void set_expected_calls_for_message_receiver_create()
 
     STRICT_EXPECTED_CALL(link_set_max_message_size(TEST_MESSAGE_RECEIVER_LINK_HANDLE, MESSAGE_RECEIVER_MAX_LINK_SIZE));
 
+    if (TEST_c2d_link_credit != 0)
+    {
+        STRICT_EXPECTED_CALL(link_set_max_link_credit(TEST_MESSAGE_RECEIVER_LINK_HANDLE, (uint32_t)TEST_c2d_link_credit));
+    }
+
     set_expected_calls_for_attach_device_client_type_to_link(TEST_MESSAGE_RECEIVER_LINK_HANDLE, 0, 0);
 
     STRICT_EXPECTED_CALL(messagereceiver_create(TEST_MESSAGE_RECEIVER_LINK_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -716,14 +525,16 @@ static void set_expected_calls_for_message_receiver_destroy()
 static void set_expected_calls_for_messenger_send_async()
 {
 	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
-	EXPECTED_CALL(singlylinkedlist_add(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 }
 
 static IOTHUB_MESSAGE_LIST* TEST_on_event_send_complete_message;
 static MESSENGER_EVENT_SEND_COMPLETE_RESULT TEST_on_event_send_complete_result;
 static void* TEST_on_event_send_complete_context;
+static int TEST_on_event_send_complete_count;
 static void TEST_on_event_send_complete(IOTHUB_MESSAGE_LIST* message, MESSENGER_EVENT_SEND_COMPLETE_RESULT result, void* context)
 {
+	TEST_on_event_send_complete_count++;
 	TEST_on_event_send_complete_message = message;
 	TEST_on_event_send_complete_result = result;
 	TEST_on_event_send_complete_context = context;
@@ -752,7 +563,6 @@ static void set_expected_calls_for_message_sender_create()
 	// create_event_sender()
 	// create_devices_path()
 	STRICT_EXPECTED_CALL(STRING_new()).SetReturn(TEST_DEVICES_PATH_STRING_HANDLE);
-	STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN);
 	STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE)).SetReturn(TEST_DEVICE_ID);
 	// EXPECTED: STRING_sprintf
 
@@ -815,6 +625,11 @@ static void set_expected_calls_for_message_sender_destroy()
 
 static void set_expected_calls_for_messenger_stop(int wait_to_send_list_length, int in_progress_list_length, bool destroy_message_receiver)
 {
+	int i;
+
+	// The events waiting to be sent are not touched, the events in progress are moved ahead of them.
+	(void)wait_to_send_list_length;
+
 	set_expected_calls_for_message_sender_destroy();
 
 	if (destroy_message_receiver)
@@ -822,79 +637,20 @@ static void set_expected_calls_for_messenger_stop(int wait_to_send_list_length,
 		set_expected_calls_for_message_receiver_destroy();
 	}
 
-	// remove timed out events
-	if (in_progress_list_length <= 0)
-	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-	}
-	else
-	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-
-		int i;
-		for (i = 0; i < in_progress_list_length; i++)
-		{
-			EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-			// por fazer: adicionar codigo para remover items prescritos.
-
-			if (i < (in_progress_list_length - 1))
-			{
-				EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-			}
-			else
-			{
-				EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG)).SetReturn(NULL);
-			}
-		}
-	}
+	// remove_timed_out_events() only walks in_progress_list, no events have timed out.
 
-	// Move events to wts list
-	if (in_progress_list_length <= 0)
+	// move_events_to_wait_to_send_list()
+	for (i = 0; i < in_progress_list_length; i++)
 	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-	}
-	else
-	{
-		SINGLYLINKEDLIST_HANDLE new_wts_list = (TEST_WAIT_TO_SEND_LIST == TEST_WAIT_TO_SEND_LIST1 ? TEST_WAIT_TO_SEND_LIST2 : TEST_WAIT_TO_SEND_LIST1);
-		SINGLYLINKEDLIST_HANDLE new_ip_list = (TEST_IN_PROGRESS_LIST == TEST_IN_PROGRESS_LIST1 ? TEST_IN_PROGRESS_LIST2 : TEST_IN_PROGRESS_LIST1);
-
-		// rest of function
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-		STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(new_wts_list);
-
-		// Moving in_progress_list items to the new wts list.
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-		int i;
-		for (i = 0; i < in_progress_list_length; i++)
-		{
-			EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-			EXPECTED_CALL(singlylinkedlist_add(new_wts_list, IGNORED_PTR_ARG));
-			EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-		}
-
-		// Moving wts (wait to send) list items to the new wts list.
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
-		for (i = 0; i < wait_to_send_list_length; i++)
-		{
-			EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-			EXPECTED_CALL(singlylinkedlist_add(new_wts_list, IGNORED_PTR_ARG));
-			EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-		}
-
-		STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(new_ip_list);
-		STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_WAIT_TO_SEND_LIST));
-		STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_IN_PROGRESS_LIST));
-		TEST_WAIT_TO_SEND_LIST = new_wts_list;
-		TEST_IN_PROGRESS_LIST = new_ip_list;
+		STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 	}
 }
 
 static void set_expected_calls_for_on_message_send_complete()
 {
-	STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument_match_context()
-		.IgnoreArgument_match_function();
-	STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG)).IgnoreArgument_item_handle();
+	STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
 	EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
@@ -903,13 +659,11 @@ static void set_expected_calls_for_message_do_work_send_pending_events(int numbe
 	int i;
 	for (i = 0; i < number_of_events_pending; i++)
     {
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
-		EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-		STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG)).IgnoreArgument(2);
-		STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG)).IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
-        STRICT_EXPECTED_CALL(message_create_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG))
-            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(message_create_from_iothub_message_with_key_cache(TEST_IOTHUB_MESSAGE_HANDLE, TEST_PROPERTY_KEY_CACHE_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument(3);
 
         STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2).IgnoreArgument(3).IgnoreArgument(4);
@@ -918,7 +672,41 @@ static void set_expected_calls_for_message_do_work_send_pending_events(int numbe
         EXPECTED_CALL(message_destroy(IGNORED_PTR_ARG));
     }
 
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+}
+
+static void set_expected_calls_for_message_do_work_send_pending_event_batch(int number_of_events_in_batch, int batch_max_count, time_t current_time)
+{
+	BINARY_DATA encoded_message = { NULL, 0 };
+	int i;
+
+	// send_pending_event_batches(); should_linger_event_batch() only walks waiting_to_send.
+	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+
+	STRICT_EXPECTED_CALL(message_create());
+	STRICT_EXPECTED_CALL(message_set_message_format(TEST_MESSAGE_HANDLE, 0x80013700));
+
+	for (i = 0; i < number_of_events_in_batch; i++)
+	{
+		STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(message_add_body_amqp_data(TEST_MESSAGE_HANDLE, encoded_message)).IgnoreArgument(2);
+		EXPECTED_CALL(free(IGNORED_PTR_ARG));
+	}
+
+	if (number_of_events_in_batch < batch_max_count)
+	{
+		STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+	}
+
+	STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+	STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+
+	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 }
 
 static time_t add_seconds(time_t base_time, int seconds)
@@ -941,25 +729,16 @@ static time_t add_seconds(time_t base_time, int seconds)
 
 static void set_expected_calls_for_process_event_send_timeouts(size_t in_progress_list_length, size_t send_event_timeout_secs, time_t current_time)
 {
-	if (in_progress_list_length <= 0)
-	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-	}
-	else
+	// in_progress_list is walked directly, only the timeout evaluation is mocked.
+	if (in_progress_list_length > 0)
 	{
 		time_t send_time = add_seconds(current_time, -1 * (int)send_event_timeout_secs);
 
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-		
 		for (; in_progress_list_length > 0; in_progress_list_length--)
 		{
-			EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
 			STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
 			EXPECTED_CALL(get_difftime(current_time, send_time)).SetReturn(difftime(current_time, send_time));
-			EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
 		}
-
-		EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG)).SetReturn(NULL);
 	}
 }
 
@@ -999,28 +778,23 @@ static void set_expected_calls_for_messenger_destroy(MESSENGER_CONFIG* config, M
 	do_work_profile->destroy_message_receiver = destroy_message_receiver;
 	set_expected_calls_for_messenger_do_work(do_work_profile);
 
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
+	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
 	wait_to_send_list_length += in_progress_list_length; // all events from in_progress_list should have been moved to wts list.
 
 	while (wait_to_send_list_length > 0)
 	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST)); 
-		EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-		STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG)).IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 		EXPECTED_CALL(free(IGNORED_PTR_ARG)); // Freeing the SEND_EVENT_TASK instance.
 
 		wait_to_send_list_length--;
 	}
 
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST)).SetReturn(NULL);
+	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
-	STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_WAIT_TO_SEND_LIST));
-	STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_IN_PROGRESS_LIST));
-
-	STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
 	STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICE_ID_STRING_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(uamqp_property_key_cache_destroy(TEST_PROPERTY_KEY_CACHE_HANDLE));
 	STRICT_EXPECTED_CALL(free(messenger_handle));
 }
 
@@ -1188,9 +962,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_RECEIVED, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_RECEIVER_STATE_CHANGED, void*);
     REGISTER_UMOCK_ALIAS_TYPE(receiver_settle_mode, int);
-	REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
-	REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
-	REGISTER_UMOCK_ALIAS_TYPE(LIST_MATCH_FUNCTION, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MESSENGER_SEND_STATUS, int);
 	REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_RESULT, int);
@@ -1200,28 +973,26 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(time_t, int);
 	REGISTER_UMOCK_ALIAS_TYPE(delivery_number, int);
 	REGISTER_UMOCK_ALIAS_TYPE(MESSENGER_MESSAGE_DISPOSITION_INFO, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(BINARY_DATA, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(malloc, TEST_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(free, TEST_free);
     REGISTER_GLOBAL_MOCK_HOOK(messagesender_create, TEST_messagesender_create);
     REGISTER_GLOBAL_MOCK_HOOK(messagesender_send, TEST_messagesender_send);
+    REGISTER_GLOBAL_MOCK_HOOK(messagesender_destroy, TEST_messagesender_destroy);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_create, TEST_messagereceiver_create);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_open, TEST_messagereceiver_open);
-    REGISTER_GLOBAL_MOCK_HOOK(message_create_from_iothub_message, TEST_message_create_from_iothub_message);
+    REGISTER_GLOBAL_MOCK_HOOK(message_create_from_iothub_message_with_key_cache, TEST_message_create_from_iothub_message);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromUamqpMessage, TEST_IoTHubMessage_CreateFromUamqpMessage);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, TEST_singlylinkedlist_add);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, TEST_singlylinkedlist_remove);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, TEST_singlylinkedlist_item_get_value);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, TEST_singlylinkedlist_get_next_item);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, TEST_singlylinkedlist_find);
 	REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_get_link_name, TEST_messagereceiver_get_link_name);
 
-	REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_remove, 0);
-	REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_remove, 555);
-
-	REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_add, TEST_LIST_ITEM_HANDLE);
-	REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
 
     REGISTER_GLOBAL_MOCK_RETURN(STRING_construct, TEST_STRING_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
@@ -1238,6 +1009,9 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(link_set_max_message_size, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(link_set_max_message_size, 1);
 
+    REGISTER_GLOBAL_MOCK_RETURN(link_set_max_link_credit, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(link_set_max_link_credit, 1);
+
     REGISTER_GLOBAL_MOCK_RETURN(messagesender_create, TEST_MESSAGE_SENDER_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(messagesender_create, NULL);
     
@@ -1253,8 +1027,17 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(messagereceiver_open, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(messagereceiver_open, 1);
 
-    REGISTER_GLOBAL_MOCK_RETURN(message_create_from_iothub_message, 0);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_create_from_iothub_message, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(message_create_from_iothub_message_with_key_cache, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_create_from_iothub_message_with_key_cache, 1);
+
+    REGISTER_GLOBAL_MOCK_RETURN(uamqp_property_key_cache_create, TEST_PROPERTY_KEY_CACHE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uamqp_property_key_cache_create, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(message_create_uamqp_encoding_from_iothub_message, TEST_message_create_uamqp_encoding_from_iothub_message);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_create_uamqp_encoding_from_iothub_message, 1);
+
+    REGISTER_GLOBAL_MOCK_RETURN(message_create, TEST_MESSAGE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_create, NULL);
 
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_map, TEST_LINK_ATTACH_PROPERTIES);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_map, NULL);
@@ -1307,6 +1090,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	TEST_IOTHUB_MESSAGE_LIST_HANDLE = (IOTHUB_MESSAGE_LIST*)real_malloc(sizeof(IOTHUB_MESSAGE_LIST));
 	ASSERT_IS_NOT_NULL(TEST_IOTHUB_MESSAGE_LIST_HANDLE);
 	TEST_IOTHUB_MESSAGE_LIST_HANDLE->messageHandle = TEST_IOTHUB_MESSAGE_HANDLE;
+	TEST_IOTHUB_MESSAGE_LIST_HANDLE->traced = false;
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -1333,15 +1117,6 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 
     saved_malloc_returns_count = 0;
 
-	TEST_WAIT_TO_SEND_LIST = TEST_WAIT_TO_SEND_LIST1;
-	TEST_IN_PROGRESS_LIST = TEST_IN_PROGRESS_LIST1;
-
-	TEST_singlylinkedlist_add_fail_return = false;
-	saved_wait_to_send_list_count = 0;
-	saved_wait_to_send_list_count2 = 0;
-	saved_in_progress_list_count = 0;
-	saved_in_progress_list_count2 = 0;
-	
     saved_messagesender_create_link = NULL;
     saved_messagesender_create_on_message_sender_state_changed = NULL;
     saved_messagesender_create_context = NULL;
@@ -1358,6 +1133,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     saved_messagesender_send_message = NULL;
     saved_messagesender_send_on_message_send_complete = NULL;
     saved_messagesender_send_callback_context = NULL;
+    TEST_messagesender_destroy_cancels_pending_send = false;
 
     saved_messagereceiver_create_link = NULL;
     saved_messagereceiver_create_on_message_receiver_state_changed = NULL;
@@ -1374,6 +1150,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     TEST_on_new_message_received_callback_result = MESSENGER_DISPOSITION_RESULT_ACCEPTED;
 
     TEST_link_set_max_message_size_result = 0;
+    TEST_c2d_link_credit = 0;
     TEST_amqpvalue_set_map_value_result = 0;
     TEST_link_set_attach_properties_result = 0;
 
@@ -1446,11 +1223,12 @@ TEST_FUNCTION(messenger_create_config_NULL_iothub_host_fqdn)
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_006: [messenger_create() shall allocate memory for the messenger instance structure (aka `instance`)]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_008: [messenger_create() shall save a copy of `messenger_config->device_id` into `instance->device_id`]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_010: [messenger_create() shall save a copy of `messenger_config->iothub_host_fqdn` into `instance->iothub_host_fqdn`]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_165: [`instance->wait_to_send_list` shall be set using singlylinkedlist_create()]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_132: [`instance->in_progress_list` shall be set using singlylinkedlist_create()]   
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_019: [messenger_create() shall keep `messenger_config->iothub_host_fqdn` in `instance->iothub_host_fqdn` without copying it, the FQDN belongs to the transport and outlives its devices]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_165: [`instance->wait_to_send_list` shall be initialized using DList_InitializeListHead()]  
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_132: [`instance->in_progress_list` shall be initialized using DList_InitializeListHead()]   
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_013: [`messenger_config->on_state_changed_callback` shall be saved into `instance->on_state_changed_callback`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_014: [`messenger_config->on_state_changed_context` shall be saved into `instance->on_state_changed_context`]  
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_015: [messenger_create() shall create `instance->property_key_cache` using uamqp_property_key_cache_create(), so the events sent reuse the AMQP values of their application property names]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_015: [If no failures occurr, messenger_create() shall return a handle to `instance`]
 TEST_FUNCTION(messenger_create_success)
 {
@@ -1473,9 +1251,7 @@ TEST_FUNCTION(messenger_create_success)
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_007: [If malloc() fails, messenger_create() shall fail and return NULL]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_009: [If STRING_construct() fails, messenger_create() shall fail and return NULL]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_011: [If STRING_construct() fails, messenger_create() shall fail and return NULL] 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_166: [If singlylinkedlist_create() fails, messenger_create() shall fail and return NULL]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_133: [If singlylinkedlist_create() fails, messenger_create() shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_016: [If uamqp_property_key_cache_create() fails, messenger_create() shall fail and return NULL]
 TEST_FUNCTION(messenger_create_failure_checks)
 {
     // arrange
@@ -1491,9 +1267,9 @@ TEST_FUNCTION(messenger_create_failure_checks)
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 3)
+        if (i == 1 || i == 2)
         {
-            // These expected calls do not cause the API to fail.
+            // DList_InitializeListHead() cannot fail.
             continue;
         }
 
@@ -1707,6 +1483,43 @@ TEST_FUNCTION(messenger_stop_succeeds)
     messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_018: [The send completions reported while `instance->message_sender` is destroyed shall be ignored, leaving the events in `instance->in_progress_list`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_162: [messenger_stop() shall move all items from `instance->in_progress_list` to the beginning of `instance->wait_to_send_list`]
+TEST_FUNCTION(messenger_stop_keeps_events_cancelled_by_messagesender_destroy)
+{
+    // arrange
+    MESSENGER_CONFIG* config = get_messenger_config();
+    MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+
+    time_t current_time = time(NULL);
+    MESSENGER_DO_WORK_EXP_CALL_PROFILE* mdwp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+    crank_messenger_do_work(handle, mdwp);
+
+    TEST_messagesender_destroy_cancels_pending_send = true;
+    TEST_on_event_send_complete_count = 0;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_messenger_stop(0, 1, false);
+
+    // act
+    int result = messenger_stop(handle);
+
+    // assert
+    MESSENGER_SEND_STATUS send_status;
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(int, 0, TEST_on_event_send_complete_count);
+    ASSERT_ARE_EQUAL(int, 0, messenger_get_send_status(handle, &send_status));
+    ASSERT_ARE_EQUAL(int, MESSENGER_SEND_STATUS_BUSY, send_status);
+
+    // cleanup
+    messenger_destroy(handle);
+    ASSERT_ARE_EQUAL(int, 1, TEST_on_event_send_complete_count);
+    ASSERT_ARE_EQUAL(int, MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED, TEST_on_event_send_complete_result);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_109: [If `messenger_handle` is NULL, messenger_destroy() shall fail and return]  
 TEST_FUNCTION(messenger_destroy_NULL_handle)
 {
@@ -1729,12 +1542,11 @@ TEST_FUNCTION(messenger_destroy_NULL_handle)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_063: [`instance->sender_link` shall be destroyed using link_destroy()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_064: [`instance->receiver_link` shall be destroyed using link_destroy()] 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_162: [If `instance->state` is MESSENGER_STATE_STOPPING, messenger_do_work() shall move all items from `instance->in_progress_list` to the beginning of `instance->wait_to_send_list`]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_164: [If all items get successfuly moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_STOPPED, and `instance->on_state_changed_callback` invoked]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_164: [Once all items are moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_STOPPED, and `instance->on_state_changed_callback` invoked]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_110: [If the `instance->state` is not MESSENGER_STATE_STOPPED, messenger_destroy() shall invoke messenger_stop() and messenger_do_work() once]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_111: [All elements of `instance->in_progress_list` and `instance->wait_to_send_list` shall be removed, invoking `task->on_event_send_complete_callback` for each with MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_150: [`instance->in_progress_list` and `instance->wait_to_send_list` shall be destroyed using singlylinkedlist_destroy()]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_112: [`instance->iothub_host_fqdn` shall be destroyed using STRING_delete()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_113: [`instance->device_id` shall be destroyed using STRING_delete()]  
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_017: [`instance->property_key_cache` shall be destroyed using uamqp_property_key_cache_destroy()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [messenger_destroy() shall destroy `instance` with free()] 
 TEST_FUNCTION(messenger_destroy_succeeds)
 {
@@ -1762,37 +1574,6 @@ TEST_FUNCTION(messenger_destroy_succeeds)
     // cleanup
 }
 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_163: [If not all items from `instance->in_progress_list` can be moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_ERROR, and `instance->on_state_changed_callback` invoked]
-TEST_FUNCTION(messenger_destroy_FAIL_TO_ROLLBACK_EVENTS)
-{
-	// arrange
-	MESSENGER_CONFIG* config = get_messenger_config();
-	MESSENGER_HANDLE handle = create_and_start_messenger2(config, true);
-
-	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
-
-	time_t current_time = time(NULL);
-	MESSENGER_DO_WORK_EXP_CALL_PROFILE* mdecp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, true, true, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
-	crank_messenger_do_work(handle, mdecp);
-
-	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
-
-	umock_c_reset_all_calls();
-	set_expected_calls_for_message_sender_destroy();
-	set_expected_calls_for_message_receiver_destroy();
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-	STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(NULL);
-
-	// act
-	messenger_destroy(handle);
-
-	// assert
-	ASSERT_ARE_EQUAL(int, MESSENGER_STATE_STOPPING, saved_on_state_changed_callback_previous_state);
-	ASSERT_ARE_EQUAL(int, MESSENGER_STATE_ERROR, saved_on_state_changed_callback_new_state);
-
-	// cleanup
-}
-
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_065: [If `messenger_handle` is NULL, messenger_do_work() shall fail and return]
 TEST_FUNCTION(messenger_do_work_NULL_handle)
 {
@@ -1843,7 +1624,7 @@ TEST_FUNCTION(messenger_do_work_not_started)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_053: [`instance->message_sender` shall be opened using messagesender_open()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_055: [Before returning, messenger_do_work() shall release all the temporary memory it has allocated]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_153: [messenger_do_work() shall move each event to be sent from `instance->wait_to_send_list` to `instance->in_progress_list`]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_154: [A MESSAGE_HANDLE shall be obtained out of the event's IOTHUB_MESSAGE_HANDLE instance by using message_create_from_iothub_message()]  
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_154: [A MESSAGE_HANDLE shall be obtained out of the event's IOTHUB_MESSAGE_HANDLE instance by using message_create_from_iothub_message_with_key_cache(), passing `instance->property_key_cache`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_157: [The MESSAGE_HANDLE shall be submitted for sending using messagesender_send(), passing `internal_on_event_send_complete_callback`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_159: [The MESSAGE_HANDLE shall be destroyed using message_destroy().] 
 TEST_FUNCTION(messenger_do_work_send_events_success)
@@ -1872,6 +1653,34 @@ TEST_FUNCTION(messenger_do_work_send_events_success)
     messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_001: [Events are added to `instance->in_progress_list` in the order they are sent, so the timeout check shall stop at the first event that has not timed out]
+TEST_FUNCTION(messenger_do_work_timeout_check_stops_at_first_event_not_timed_out)
+{
+    // arrange
+    MESSENGER_CONFIG* config = get_messenger_config();
+    MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+	ASSERT_ARE_EQUAL(int, 2, send_events(handle, 2));
+
+	time_t current_time = time(NULL);
+	MESSENGER_DO_WORK_EXP_CALL_PROFILE *mdwp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, false, 2, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+	crank_messenger_do_work(handle, mdwp);
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+	EXPECTED_CALL(get_difftime(current_time, current_time)).SetReturn(0);
+	set_expected_calls_for_message_do_work_send_pending_events(0, current_time);
+
+    // act
+    messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_067: [If `instance->receive_messages` is true and `instance->message_receiver` is NULL, a message_receiver shall be created]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_068: [A variable, named `devices_path`, shall be created concatenating `instance->iothub_host_fqdn`, "/devices/" and `instance->device_id`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_070: [A variable, named `message_receive_address`, shall be created concatenating "amqps://", `devices_path` and "/messages/devicebound"]  
@@ -1907,6 +1716,33 @@ TEST_FUNCTION(messenger_do_work_create_message_receiver)
     messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_012: [If `instance->c2d_link_credit` is not 0, `instance->receiver_link` maximum link credit shall be set to it using link_set_max_link_credit(); if it fails, it shall be logged and ignored]
+TEST_FUNCTION(messenger_do_work_create_message_receiver_with_c2d_link_credit)
+{
+    // arrange
+    MESSENGER_CONFIG* config = get_messenger_config();
+    MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+    size_t c2d_link_credit = 500;
+
+    ASSERT_ARE_EQUAL(int, 0, messenger_set_option(handle, MESSENGER_OPTION_C2D_LINK_CREDIT, &c2d_link_credit));
+    (void)messenger_subscribe_for_messages(handle, TEST_on_new_message_received_callback, TEST_ON_NEW_MESSAGE_RECEIVED_CB_CONTEXT);
+
+    TEST_c2d_link_credit = c2d_link_credit;
+	time_t current_time = time(NULL);
+	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, true, false, 0, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+	umock_c_reset_all_calls();
+	set_expected_calls_for_messenger_do_work(do_work_profile);
+
+    // act
+    messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_069: [If `devices_path` fails to be created, messenger_do_work() shall fail and return]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_071: [If `message_receive_address` fails to be created, messenger_do_work() shall fail and return]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_073: [If `link_name` fails to be created, messenger_do_work() shall fail and return]  
@@ -1938,8 +1774,8 @@ TEST_FUNCTION(messenger_do_work_create_message_receiver_failure_checks)
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 1 || i == 2 || i == 4 || i == 5 || i == 9 || i == 11 || i == 12 || 
-            i == 14 || i == 16 || i == 19 || (i >= 20 && i <= 27) || (i >= 30 && i <= 35) )
+        if (i == 1 || i == 3 || i == 4 || i == 8 || i == 10 || i == 11 || 
+            i == 13 || i == 15 || i == 18 || (i >= 19 && i <= 26) || (i >= 29 && i <= 34) )
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -1986,8 +1822,8 @@ TEST_FUNCTION(messenger_do_work_create_message_sender_failure_checks)
 	size_t n = 10;
 	for (i = 0; i < n; i++)
 	{
-		if (i == 1 || i == 2 || i == 4 || i == 5 || i == 9 || i == 11 || i == 12 || 
-			i == 14 || i == 16 || i == 18 || (i >= 19 && i <= 35)) 
+		if (i == 1 || i == 3 || i == 4 || i == 8 || i == 10 || i == 11 || 
+			i == 13 || i == 15 || i == 17 || (i >= 18 && i <= 34)) 
 		{
 			continue; // These expected calls do not cause the API to fail.
 		}
@@ -2156,22 +1992,14 @@ TEST_FUNCTION(messenger_do_work_send_events_message_create_from_iothub_message_f
 	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
 
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
-	EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-	STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG))
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG))
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(message_create_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG))
-		.IgnoreArgument(2).SetReturn(1);
-	STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument_match_context()
-		.IgnoreArgument_match_function();
-	STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG))
-		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(message_create_from_iothub_message_with_key_cache(TEST_IOTHUB_MESSAGE_HANDLE, TEST_PROPERTY_KEY_CACHE_HANDLE, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).SetReturn(1);
+	STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
 	EXPECTED_CALL(free(IGNORED_PTR_ARG));
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST)).SetReturn(NULL);
+	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
     // act
     messenger_do_work(handle);
@@ -2204,26 +2032,17 @@ TEST_FUNCTION(messenger_do_work_send_events_messagesender_send_fails)
 		ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
 
 		umock_c_reset_all_calls();
-		// timeout checks
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-		
 		// send events
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
-		EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-		STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG))
-			.IgnoreArgument(2);
-		STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG))
-			.IgnoreArgument(2);
-		STRICT_EXPECTED_CALL(message_create_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG))
-			.IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(message_create_from_iothub_message_with_key_cache(TEST_IOTHUB_MESSAGE_HANDLE, TEST_PROPERTY_KEY_CACHE_HANDLE, IGNORED_PTR_ARG))
+			.IgnoreArgument(3);
 		STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreArgument(2).IgnoreArgument(3).IgnoreArgument(4).SetReturn(1);
 		EXPECTED_CALL(get_time(NULL)).SetReturn(INDEFINITE_TIME);
 		EXPECTED_CALL(message_destroy(IGNORED_PTR_ARG));
-		STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreArgument_match_function()
-			.IgnoreArgument_match_context();
-		STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG)).IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
 		EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
         // act
@@ -2546,7 +2365,6 @@ TEST_FUNCTION(messenger_send_async_NULL_callback)
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_138: [If malloc() fails, messenger_send_async() shall fail and return a non-zero value]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_139: [If singlylinkedlist_add() fails, messenger_send_async() shall fail and return a non-zero value]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_142: [If any failure occurs, messenger_send_async() shall free any memory it has allocated]
 TEST_FUNCTION(messenger_send_async_failure_checks)
 {
@@ -2564,6 +2382,12 @@ TEST_FUNCTION(messenger_send_async_failure_checks)
 	size_t i;
 	for (i = 0; i < umock_c_negative_tests_call_count(); i++)
 	{
+		if (i == 1)
+		{
+			// DList_InsertTailList() cannot fail.
+			continue;
+		}
+
 		// arrange
 		char error_msg[64];
 
@@ -2737,6 +2561,136 @@ TEST_FUNCTION(messenger_set_option_EVENT_SEND_TIMEOUT_SECS)
 	messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_009: [If name matches MESSENGER_OPTION_EVENT_SEND_BATCH_MAX_COUNT, `value` shall be saved on `instance->event_send_batch_max_count`]
+TEST_FUNCTION(messenger_set_option_EVENT_SEND_BATCH_MAX_COUNT)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+	size_t value = 10;
+
+	// act
+	int result = messenger_set_option(handle, MESSENGER_OPTION_EVENT_SEND_BATCH_MAX_COUNT, &value);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_013: [If name matches MESSENGER_OPTION_C2D_LINK_CREDIT, `value` shall be saved on `instance->c2d_link_credit`, to be applied when the message receiver is created]
+TEST_FUNCTION(messenger_set_option_C2D_LINK_CREDIT)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+	size_t value = 500;
+
+	// act
+	int result = messenger_set_option(handle, MESSENGER_OPTION_C2D_LINK_CREDIT, &value);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_010: [If name matches MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_SECS, `value` shall be saved on `instance->event_send_batch_linger_secs`]
+TEST_FUNCTION(messenger_set_option_EVENT_SEND_BATCH_LINGER_SECS)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+	size_t value = 1;
+
+	// act
+	int result = messenger_set_option(handle, MESSENGER_OPTION_EVENT_SEND_BATCH_LINGER_SECS, &value);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_003: [If `instance->event_send_batch_max_count` is greater than 1, messenger_do_work() shall send the events in batches, holding back a batch that is not full until its oldest event has waited `instance->event_send_batch_linger_secs`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_004: [The batch shall be a MESSAGE_HANDLE created with message_create() and set with the AMQP batching message format using message_set_message_format()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_005: [Each event shall be added to the batch as a data section encoded with message_create_uamqp_encoding_from_iothub_message(), until the batch holds `event_send_batch_max_count` events or adding the next event would make it larger than the IoT Hub message size limit]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_007: [When a batch completes, the result of its transfer shall be reported for each event of the batch as if it had been sent alone]
+TEST_FUNCTION(messenger_do_work_send_events_in_batch_success)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+	size_t batch_max_count = 2;
+	time_t current_time = time(NULL);
+	int i;
+
+	ASSERT_ARE_EQUAL(int, 0, messenger_set_option(handle, MESSENGER_OPTION_EVENT_SEND_BATCH_MAX_COUNT, &batch_max_count));
+
+	for (i = 0; i < 2; i++)
+	{
+		umock_c_reset_all_calls();
+		STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+		STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+		STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+		ASSERT_ARE_EQUAL(int, 0, messenger_send_async(handle, TEST_IOTHUB_MESSAGE_LIST_HANDLE, TEST_on_event_send_complete, TEST_IOTHUB_CLIENT_HANDLE));
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	}
+
+	umock_c_reset_all_calls();
+	set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+	set_expected_calls_for_message_do_work_send_pending_event_batch(2, (int)batch_max_count, current_time);
+
+	// act
+	messenger_do_work(handle);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_NOT_NULL(saved_messagesender_send_on_message_send_complete);
+
+	TEST_on_event_send_complete_count = 0;
+	saved_messagesender_send_on_message_send_complete(saved_messagesender_send_callback_context, MESSAGE_SEND_OK);
+
+	ASSERT_ARE_EQUAL(int, 2, TEST_on_event_send_complete_count);
+	ASSERT_ARE_EQUAL(int, MESSENGER_EVENT_SEND_COMPLETE_RESULT_OK, TEST_on_event_send_complete_result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_008: [If the batch fails to be sent, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING for each event of the batch, and the events shall be removed from `instance->in_progress_list` and destroyed]
+TEST_FUNCTION(messenger_do_work_send_events_in_batch_messagesender_send_fails)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+	size_t batch_max_count = 2;
+
+	ASSERT_ARE_EQUAL(int, 0, messenger_set_option(handle, MESSENGER_OPTION_EVENT_SEND_BATCH_MAX_COUNT, &batch_max_count));
+	ASSERT_ARE_EQUAL(int, 2, send_events(handle, 2));
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4).SetReturn(1);
+	TEST_on_event_send_complete_count = 0;
+
+	// act
+	messenger_do_work(handle);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 2, TEST_on_event_send_complete_count);
+	ASSERT_ARE_EQUAL(int, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, TEST_on_event_send_complete_result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
 TEST_FUNCTION(messenger_set_option_SAVED_OPTIONS)
 {
@@ -3027,6 +2981,32 @@ TEST_FUNCTION(messenger_retrieve_options_succeeds)
 	messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_014: [MESSENGER_OPTION_C2D_LINK_CREDIT shall be added to the OPTIONHANDLER_HANDLE instance only if it has been set]
+TEST_FUNCTION(messenger_retrieve_options_with_c2d_link_credit_succeeds)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, true);
+	size_t c2d_link_credit = 500;
+
+	ASSERT_ARE_EQUAL(int, 0, messenger_set_option(handle, MESSENGER_OPTION_C2D_LINK_CREDIT, &c2d_link_credit));
+
+	umock_c_reset_all_calls();
+	set_expected_calls_for_messenger_retrieve_options();
+	STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, MESSENGER_OPTION_C2D_LINK_CREDIT, IGNORED_PTR_ARG))
+		.IgnoreArgument(3);
+
+	// act
+	OPTIONHANDLER_HANDLE result = messenger_retrieve_options(handle);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(void_ptr, TEST_OPTIONHANDLER_HANDLE, result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_175: [If an OPTIONHANDLER_HANDLE instance fails to be created, messenger_retrieve_options shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_177: [If OptionHandler_AddOption fails, messenger_retrieve_options shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_178: [If messenger_retrieve_options fails, any allocated memory shall be freed]
@@ -12,6 +12,7 @@
 #include "iothubtransport.h"
 
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 
@@ -60,8 +61,10 @@ static bool checkProtocolGatewayIsNull;
 static size_t howManyDoWorkCalls = 0;
 static size_t doWorkCallCount = 0;
 extern "C" const size_t IoTHubTransport_ThreadTerminationOffset;
+extern "C" const size_t IoTHubTransport_ClientWorkerTerminationOffset;
 static THREAD_START_FUNC threadFunc;
 static void* threadFuncArg;
+static void* clientWorkerToStop;
 
 #define TEST_DEVICE_ID "theidofTheDevice"
 #define TEST_DEVICE_KEY "theKeyoftheDevice"
@@ -72,6 +75,8 @@ static void* threadFuncArg;
 #define TEST_IOTHUB_CLIENT_HANDLE2 (IOTHUB_CLIENT_HANDLE)0xDEAF
 #define TEST_LOCK_HANDLE (LOCK_HANDLE)0x4443
 #define TEST_CLIENTS_LOCK_HANDLE (LOCK_HANDLE)0x4445
+#define TEST_READY_LOCK_HANDLE (LOCK_HANDLE)0x4446
+#define TEST_COND_HANDLE (COND_HANDLE)0x4447
 #define TEST_THREAD_HANDLE (THREAD_HANDLE)0x4442
 
 
@@ -133,6 +138,14 @@ static void clientDoWork(void* clientHandle)
     clientDoWork_calls++;
 }
 
+static void stopThreadAfterDoWorkCalls(void)
+{
+    if ((howManyDoWorkCalls > 0) && (howManyDoWorkCalls == doWorkCallCount))
+    {
+        * (sig_atomic_t*)(((char*)threadFuncArg) + IoTHubTransport_ThreadTerminationOffset) = 1; /*tell the thread to stop*/
+    }
+}
+
 TYPED_MOCK_CLASS(CIotHubTransportMocks, CGlobalMock)
 {
 public:
@@ -355,6 +368,10 @@ public:
         size_t result2 = BASEIMPLEMENTATION::VECTOR_size(vector);
     MOCK_METHOD_END(size_t, result2)
 
+    MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, VECTOR_move, VECTOR_HANDLE, vector)
+        VECTOR_HANDLE result2 = BASEIMPLEMENTATION::VECTOR_move(vector);
+    MOCK_METHOD_END(VECTOR_HANDLE, result2)
+
 
         /* ThreadAPI mocks */
         MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
@@ -367,10 +384,7 @@ public:
     MOCK_STATIC_METHOD_1(, void, ThreadAPI_Exit, int, res);
     MOCK_VOID_METHOD_END();
     MOCK_STATIC_METHOD_1(, void, ThreadAPI_Sleep, unsigned int, milliseconds)
-        if ((howManyDoWorkCalls > 0) && (howManyDoWorkCalls == doWorkCallCount))
-        {
-            * (sig_atomic_t*)(((char*)threadFuncArg) + IoTHubTransport_ThreadTerminationOffset) = 1; /*tell the thread to stop*/
-        }
+        stopThreadAfterDoWorkCalls();
     MOCK_VOID_METHOD_END();
 
     /* Lock mocks */
@@ -383,6 +397,21 @@ public:
     MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
     MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
 
+    /* Condition mocks */
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init);
+    MOCK_METHOD_END(COND_HANDLE, TEST_COND_HANDLE);
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle);
+    MOCK_METHOD_END(COND_RESULT, COND_OK);
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+        stopThreadAfterDoWorkCalls();
+        if (clientWorkerToStop != NULL)
+        {
+            *(int*)(((char*)clientWorkerToStop) + IoTHubTransport_ClientWorkerTerminationOffset) = 1; /*tell the client worker to stop*/
+        }
+    MOCK_METHOD_END(COND_RESULT, COND_TIMEOUT);
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle);
+    MOCK_VOID_METHOD_END();
+
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, DList_InitializeListHead, PDLIST_ENTRY, listHead);
@@ -443,6 +472,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void*, VECTOR_front, VECTO
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void*, VECTOR_back, VECTOR_HANDLE, vector);
 DECLARE_GLOBAL_MOCK_METHOD_3(CIotHubTransportMocks, , void*, VECTOR_find_if, VECTOR_HANDLE, vector, PREDICATE_FUNCTION, pred, const void*, value);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , size_t, VECTOR_size, VECTOR_HANDLE, vector);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , VECTOR_HANDLE, VECTOR_move, VECTOR_HANDLE, vector);
 
 DECLARE_GLOBAL_MOCK_METHOD_3(CIotHubTransportMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIotHubTransportMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
@@ -455,6 +485,11 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , LOCK_RESULT, Lock, LOCK_HA
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CIotHubTransportMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CIotHubTransportMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
 static TRANSPORT_PROVIDER FAKE_transport_provider =
 {
     FAKE_IoTHubTransport_SendMessageDisposition,
@@ -510,6 +545,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     checkProtocolGatewayIsNull = false;
     howManyDoWorkCalls = 0;
     doWorkCallCount = 0;
+    clientWorkerToStop = NULL;
 
 }
 
@@ -526,6 +562,7 @@ TEST_FUNCTION_CLEANUP(TestMethodCleanup)
 /*Tests_SRS_IOTHUBTRANSPORT_17_007: [ IoTHubTransport_Create shall create the transport lock by Calling Lock_Init. */
 /*Tests_SRS_IOTHUBTRANSPORT_17_038: [ IoTHubTransport_Create shall call VECTOR_Create to make a list of IOTHUB_CLIENT_HANDLE using this transport. ]*/
 //Tests_SRS_IOTHUBTRANSPORT_17_032: [ IoTHubTransport_Create shall allocate memory for the transport data. ]
+/*Tests_SRS_IOTHUBTRANSPORT_41_001: [ IoTHubTransport_Create shall create a lock and a list for the clients that have signaled work. ]*/
 TEST_FUNCTION(IoTHubTransport_Create_success_returns_non_null)
 {
     CIotHubTransportMocks mocks;
@@ -536,7 +573,9 @@ TEST_FUNCTION(IoTHubTransport_Create_success_returns_non_null)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_CLIENTS_LOCK_HANDLE); // clients lock
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_READY_LOCK_HANDLE); // ready clients lock
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE))); // ready clients
 
     ///act
     auto result = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
@@ -567,6 +606,8 @@ TEST_FUNCTION(IoTHubTransport_Create_vector_create_fails_returns_null)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_CLIENTS_LOCK_HANDLE);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_READY_LOCK_HANDLE);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_READY_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_CLIENTS_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)))
@@ -583,6 +624,71 @@ TEST_FUNCTION(IoTHubTransport_Create_vector_create_fails_returns_null)
 
 }
 
+/*Tests_SRS_IOTHUBTRANSPORT_41_002: [ If creating any of them fails, IoTHubTransport_Create shall clean up the resources it created and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_Create_ready_clients_lock_init_fails_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_CLIENTS_LOCK_HANDLE);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init())
+        .SetFailReturn((LOCK_HANDLE)NULL);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_CLIENTS_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_LOCK_HANDLE));
+
+    ///act
+    auto result = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_002: [ If creating any of them fails, IoTHubTransport_Create shall clean up the resources it created and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_Create_ready_clients_vector_create_fails_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_CLIENTS_LOCK_HANDLE);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_READY_LOCK_HANDLE);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)))
+        .SetFailReturn((VECTOR_HANDLE)NULL);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_READY_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_CLIENTS_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
 //Tests_SRS_IOTHUBTRANSPORT_17_008: [ If the lock creation fails, IoTHubTransport_Create shall return NULL. ]
 TEST_FUNCTION(IoTHubTransport_Create_lock_init_fails_returns_null)
 {
@@ -725,6 +831,10 @@ TEST_FUNCTION(IoTHubTransport_Destroy_success)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -761,6 +871,10 @@ TEST_FUNCTION(IoTHubTransport_Destroy_success_thread_join_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -792,6 +906,10 @@ TEST_FUNCTION(IoTHubTransport_Destroy_success_lock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -913,11 +1031,15 @@ TEST_FUNCTION(IoTHubTransport_StartWorkerThread_success)
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
 
@@ -982,11 +1104,15 @@ TEST_FUNCTION(IoTHubTransport_StartWorkerThread_two_client_success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE2))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
 
@@ -1078,12 +1204,16 @@ TEST_FUNCTION(IoTHubTransport_StartWorkerThread_Vector_push_back_returns_error)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetFailReturn(42);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
 
@@ -1115,9 +1245,16 @@ TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
@@ -1151,9 +1288,16 @@ TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_2_client_success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
@@ -1327,154 +1471,1064 @@ TEST_FUNCTION(IoTHubTransport_JoinWorkerThread_join_fails)
     IoTHubTransport_Destroy(transportHandle);
 }
 
-//Tests_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]
-//Tests_SRS_IOTHUBTRANSPORT_17_030: [ All calls to lower layer transport DoWork shall be protected by the lock created in IoTHubTransport_Create. ]
-TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
+/*Tests_SRS_IOTHUBTRANSPORT_41_003: [ If transportHandle or clientHandle is NULL, IoTHubTransport_SignalClientWork shall do nothing. ]*/
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_null_transport_does_nothing)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    IoTHubTransport_SignalClientWork(NULL, TEST_IOTHUB_CLIENT_HANDLE1);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_003: [ If transportHandle or clientHandle is NULL, IoTHubTransport_SignalClientWork shall do nothing. ]*/
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_null_client_does_nothing)
 {
     CIotHubTransportMocks mocks;
     ///arrange
+    int fake = 0x43;
+
+    ///act
+    IoTHubTransport_SignalClientWork((TRANSPORT_HANDLE)(&fake), NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
 
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_004: [ IoTHubTransport_SignalClientWork shall add clientHandle, once, to the clients that signaled work if clientHandle started the worker thread and did not signal it to end. ]*/
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_success)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
     auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
     (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
     mocks.ResetAllCalls();
 
-    howManyDoWorkCalls = 2;
-    clientDoWork_calls = 0;
-    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
-
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
-
-    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
-
-    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
     ///act
-    threadFunc(threadFuncArg);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
-    ASSERT_IS_TRUE(clientDoWork_calls == howManyDoWorkCalls);
 
     ///cleanup
     IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
-    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
-    //If a thread were actually created, we'd need a Join here.
     IoTHubTransport_Destroy(transportHandle);
 }
 
-//Tests_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]
-//Tests_SRS_IOTHUBTRANSPORT_17_030: [ All calls to lower layer transport DoWork shall be protected by the lock created in IoTHubTransport_Create. 
-TEST_FUNCTION(IoTHubTransport_worker_thread_runs_two_devices_once)
+/*Tests_SRS_IOTHUBTRANSPORT_41_004: [ IoTHubTransport_SignalClientWork shall add clientHandle, once, to the clients that signaled work if clientHandle started the worker thread and did not signal it to end. ]*/
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_twice_adds_the_client_once)
 {
     CIotHubTransportMocks mocks;
     ///arrange
-
     auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
     (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
-    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
     mocks.ResetAllCalls();
 
-    howManyDoWorkCalls = 1;
-    clientDoWork_calls = 0;
-    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
-
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
-
-    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
     ///act
-    threadFunc(threadFuncArg);
-    ASSERT_IS_TRUE(clientDoWork_calls == (2 * howManyDoWorkCalls));
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
-    
 
     ///cleanup
     IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
-    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
     IoTHubTransport_Destroy(transportHandle);
 }
 
-//Tests_SRS_IOTHUBTRANSPORT_17_031: [ If acquiring the lock fails, lower layer transport DoWork shall not be called. ]
-TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
+/*Tests_SRS_IOTHUBTRANSPORT_41_004: [ IoTHubTransport_SignalClientWork shall add clientHandle, once, to the clients that signaled work if clientHandle started the worker thread and did not signal it to end. ]*/
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_client_not_started_is_not_added)
 {
     CIotHubTransportMocks mocks;
     ///arrange
-
     auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
     (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
-    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
     mocks.ResetAllCalls();
 
-    howManyDoWorkCalls = 1;
-    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
-        .SetFailReturn(LOCK_ERROR);
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
-
-    /* DoWork needs to run at least once, so, the number of calls to DoWork increments. */
-    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
-    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE2))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
 
-    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
-    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    ///act
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_005: [ IoTHubTransport_SignalClientWork shall wake up the worker thread if it is waiting for work. ]*/
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_wakes_up_the_worker_thread)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 100);
+    mocks.ResetAllCalls();
+
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
 
     ///act
-    threadFunc(threadFuncArg);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
-    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
-
     IoTHubTransport_Destroy(transportHandle);
 }
 
+/*Tests_SRS_IOTHUBTRANSPORT_41_010: [ If transportHandle is NULL, IoTHubTransport_SetWorkerMaxIdleTime shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubTransport_SetWorkerMaxIdleTime_null_transport_returns_bad_arg)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetWorkerMaxIdleTime(NULL, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_INVALID_ARG, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_012: [ IoTHubTransport_SetWorkerMaxIdleTime shall create (once) the condition the worker thread waits on, store maxIdleTime, 0 going back to calling lower layer transport DoWork every 1 ms, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubTransport_SetWorkerMaxIdleTime_success)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_OK, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_012: [ IoTHubTransport_SetWorkerMaxIdleTime shall create (once) the condition the worker thread waits on, store maxIdleTime, 0 going back to calling lower layer transport DoWork every 1 ms, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubTransport_SetWorkerMaxIdleTime_twice_creates_the_condition_once)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 100);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_OK, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_011: [ If taking the transport lock or creating the condition fails, IoTHubTransport_SetWorkerMaxIdleTime shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubTransport_SetWorkerMaxIdleTime_condition_init_fails_returns_error)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Init())
+        .SetFailReturn((COND_HANDLE)NULL);
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_011: [ If taking the transport lock or creating the condition fails, IoTHubTransport_SetWorkerMaxIdleTime shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubTransport_SetWorkerMaxIdleTime_lock_fails_returns_error)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_17_010: [ IoTHubTransport_Destroy shall free all resources. ]
+/*Tests_SRS_IOTHUBTRANSPORT_41_009: [ Signaling the worker thread to end shall wake it up if it is waiting for work. ]*/
+TEST_FUNCTION(IoTHubTransport_Destroy_with_a_worker_max_idle_time_wakes_up_the_thread_and_frees_the_condition)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 100);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubTransport_Destroy(transportHandle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_007: [ IoTHubTransport_SignalEndWorkerThread shall also remove clientHandle from the clients that signaled work. ]*/
+TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_removes_the_client_from_the_ready_clients)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    (void)IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    mocks.ResetAllCalls();
+
+    howManyDoWorkCalls = 1;
+    clientDoWork_calls = 0;
+
+    ///act
+    threadFunc(threadFuncArg);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, clientDoWork_calls);
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]
+//Tests_SRS_IOTHUBTRANSPORT_17_030: [ All calls to lower layer transport DoWork shall be protected by the lock created in IoTHubTransport_Create. ]
+/*Tests_SRS_IOTHUBTRANSPORT_41_006: [ After the lower layer transport DoWork the thread shall call the client DoWork of the clients that signaled work since the last time, once each, and only of those. ]*/
+TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    mocks.ResetAllCalls();
+
+    howManyDoWorkCalls = 2;
+    clientDoWork_calls = 0;
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    threadFunc(threadFuncArg);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 0, clientDoWork_calls);
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+    //If a thread were actually created, we'd need a Join here.
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_006: [ After the lower layer transport DoWork the thread shall call the client DoWork of the clients that signaled work since the last time, once each, and only of those. ]*/
+TEST_FUNCTION(IoTHubTransport_worker_thread_runs_a_signaled_client_once)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    mocks.ResetAllCalls();
+
+    howManyDoWorkCalls = 2;
+    clientDoWork_calls = 0;
+
+    ///act
+    threadFunc(threadFuncArg);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, clientDoWork_calls);
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]
+//Tests_SRS_IOTHUBTRANSPORT_17_030: [ All calls to lower layer transport DoWork shall be protected by the lock created in IoTHubTransport_Create. 
+TEST_FUNCTION(IoTHubTransport_worker_thread_runs_two_devices_once)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+    mocks.ResetAllCalls();
+
+    howManyDoWorkCalls = 1;
+    clientDoWork_calls = 0;
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_move(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    threadFunc(threadFuncArg);
+    ASSERT_IS_TRUE(clientDoWork_calls == (2 * howManyDoWorkCalls));
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_008: [ When a worker max idle time was set and no client has signaled work, the thread shall wait on a condition for at most the worker max idle time before calling lower layer transport DoWork again. ]*/
+TEST_FUNCTION(IoTHubTransport_worker_thread_with_a_worker_max_idle_time_waits_for_work)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 100);
+    mocks.ResetAllCalls();
+
+    howManyDoWorkCalls = 1;
+    clientDoWork_calls = 0;
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    threadFunc(threadFuncArg);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_17_031: [ If acquiring the lock fails, lower layer transport DoWork shall not be called. ]
+TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
+    mocks.ResetAllCalls();
+
+    howManyDoWorkCalls = 1;
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE))
+        .SetFailReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+    /* DoWork needs to run at least once, so, the number of calls to DoWork increments. */
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    threadFunc(threadFuncArg);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_013: [ If transportHandle is NULL or clientWorkerCount is 0, IoTHubTransport_SetClientWorkerCount shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubTransport_SetClientWorkerCount_null_transport_returns_bad_arg)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetClientWorkerCount(NULL, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_INVALID_ARG, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_013: [ If transportHandle is NULL or clientWorkerCount is 0, IoTHubTransport_SetClientWorkerCount shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubTransport_SetClientWorkerCount_0_client_workers_returns_bad_arg)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetClientWorkerCount(transportHandle, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_INVALID_ARG, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_015: [ IoTHubTransport_SetClientWorkerCount shall start clientWorkerCount client worker threads, each with its own locks, condition and list of clients that signaled work, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubTransport_SetClientWorkerCount_success)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetClientWorkerCount(transportHandle, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_OK, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_014: [ If taking the clients lock fails, the client workers were already set or a client already started the worker thread, IoTHubTransport_SetClientWorkerCount shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubTransport_SetClientWorkerCount_twice_returns_error)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_SetClientWorkerCount(transportHandle, 2);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetClientWorkerCount(transportHandle, 4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_014: [ If taking the clients lock fails, the client workers were already set or a client already started the worker thread, IoTHubTransport_SetClientWorkerCount shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubTransport_SetClientWorkerCount_after_a_client_started_returns_error)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetClientWorkerCount(transportHandle, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_014: [ If taking the clients lock fails, the client workers were already set or a client already started the worker thread, IoTHubTransport_SetClientWorkerCount shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubTransport_SetClientWorkerCount_lock_fails_returns_error)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetClientWorkerCount(transportHandle, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_016: [ If creating any of them fails, IoTHubTransport_SetClientWorkerCount shall stop and free the client workers it created and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubTransport_SetClientWorkerCount_condition_init_fails_returns_error)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init())
+        .SetFailReturn((COND_HANDLE)NULL);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetClientWorkerCount(transportHandle, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_016: [ If creating any of them fails, IoTHubTransport_SetClientWorkerCount shall stop and free the client workers it created and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubTransport_SetClientWorkerCount_second_thread_create_fails_stops_the_first_client_worker)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetFailReturn(THREADAPI_ERROR);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    /*the first client worker is stopped and joined*/
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_SetClientWorkerCount(transportHandle, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_ERROR, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_017: [ When client workers were set, IoTHubTransport_SignalClientWork shall add clientHandle, once, to the clients that signaled work of the client worker picked by hashing clientHandle and wake that client worker up. ]*/
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_with_client_workers_wakes_up_the_client_worker)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_SetClientWorkerCount(transportHandle, 2);
+    (void)IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 100);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    /*only the client worker is woken up, not the worker thread*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_018: [ A client worker shall wait until one of its clients signals work, then call the client DoWork of the clients that signaled work, once each, while holding its visit lock. ]*/
+/*Tests_SRS_IOTHUBTRANSPORT_41_019: [ After a visit the client worker shall wake up the worker thread if it is waiting for work, so that what the clients queued is sent, then sleep 1 ms. ]*/
+TEST_FUNCTION(IoTHubTransport_client_worker_visits_a_signaled_client_once)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_SetClientWorkerCount(transportHandle, 1);
+    THREAD_START_FUNC clientWorkerFunc = threadFunc;
+    clientWorkerToStop = threadFuncArg;
+    (void)IoTHubTransport_SetWorkerMaxIdleTime(transportHandle, 100);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    mocks.ResetAllCalls();
+
+    clientDoWork_calls = 0;
+    /*first pass: the client signaled work*/
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_move(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
+    /*second pass: nothing to do, the client worker waits and is told to stop*/
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(TEST_COND_HANDLE, IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    clientWorkerFunc(clientWorkerToStop);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, clientDoWork_calls);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_020: [ When client workers were set, IoTHubTransport_SignalEndWorkerThread shall wait for the client worker of clientHandle to end its visit before removing clientHandle. ]*/
+TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_with_client_workers_waits_for_the_visit_to_end)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_SetClientWorkerCount(transportHandle, 1);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_HANDLE1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    auto rv = IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+
+    ///assert
+    ASSERT_IS_FALSE(rv);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE2);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_020: [ When client workers were set, IoTHubTransport_SignalEndWorkerThread shall wait for the client worker of clientHandle to end its visit before removing clientHandle. ]*/
+TEST_FUNCTION(IoTHubTransport_client_worker_does_not_visit_a_client_that_signaled_the_end)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_SetClientWorkerCount(transportHandle, 1);
+    THREAD_START_FUNC clientWorkerFunc = threadFunc;
+    clientWorkerToStop = threadFuncArg;
+    (void)IoTHubTransport_StartWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    IoTHubTransport_SignalClientWork(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    (void)IoTHubTransport_SignalEndWorkerThread(transportHandle, TEST_IOTHUB_CLIENT_HANDLE1);
+    mocks.ResetAllCalls();
+
+    clientDoWork_calls = 0;
+
+    ///act
+    clientWorkerFunc(clientWorkerToStop);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, clientDoWork_calls);
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_41_021: [ IoTHubTransport_Destroy shall stop, join and free the client workers. ]*/
+TEST_FUNCTION(IoTHubTransport_Destroy_stops_and_frees_the_client_workers)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_SetClientWorkerCount(transportHandle, 1);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubTransport_Destroy(transportHandle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
 END_TEST_SUITE(iothubtransport_ut)
 
@@ -53,6 +53,7 @@ extern "C"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_uamqp_c/amqp_definitions.h"
 #include "azure_uamqp_c/link.h"
 #include "azure_uamqp_c/message_receiver.h"
@@ -64,6 +65,21 @@ extern "C"
 
 #include "iothubtransportamqp_methods.h"
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+#ifdef __cplusplus
+}
+#endif
+
 static IOTHUBTRANSPORT_AMQP_METHOD_HANDLE g_method_handle;
 static int g_respond_result;
 
@@ -326,6 +342,10 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, real_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_open, my_messagereceiver_open);
     REGISTER_GLOBAL_MOCK_HOOK(messagesender_send, my_messagesender_send);
     REGISTER_GLOBAL_MOCK_HOOK(messagesender_create, my_messagesender_create);
@@ -346,6 +366,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUBTRANSPORT_AMQP_METHOD_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_SEND_COMPLETE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(fields, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -453,7 +475,6 @@ static void setup_message_received_calls(void)
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -469,6 +490,7 @@ static void setup_message_received_calls(void)
     STRICT_EXPECTED_CALL(amqpvalue_get_string(test_property_value, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &method_name_ptr, sizeof(method_name_ptr));
     STRICT_EXPECTED_CALL(messaging_delivery_accepted());
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(test_on_method_request_received((void*)0x4243, TEST_METHOD_NAME, IGNORED_PTR_ARG, sizeof(test_method_request_payload), IGNORED_PTR_ARG))
         .ValidateArgumentBuffer(3, test_method_request_payload, sizeof(test_method_request_payload))
         .IgnoreArgument_method_handle();
@@ -512,6 +534,7 @@ static void setup_method_respond_calls(void)
     STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER, TEST_RESPONSE_UAMQP_MESSAGE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument_on_message_send_complete()
         .IgnoreArgument_callback_context();
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 }
 
@@ -549,7 +572,7 @@ static void setup_respond_calls(int status)
     STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER, TEST_RESPONSE_UAMQP_MESSAGE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument_on_message_send_complete()
         .IgnoreArgument_callback_context();
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(status_property_value));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(status_property_key));
@@ -574,6 +597,7 @@ TEST_FUNCTION(iothubtransportamqp_methods_create_copies_the_device_id_and_succee
         .IgnoreArgument_destination();
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "testhost"))
         .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
 
     /// act
     amqp_methods_handle = iothubtransportamqp_methods_create("testhost", "testdevice");
@@ -679,6 +703,7 @@ TEST_FUNCTION(iothubtransportamqp_methods_destroy_frees_the_device_id_and_handle
     IOTHUBTRANSPORT_AMQP_METHODS_HANDLE amqp_methods_handle = iothubtransportamqp_methods_create("testhost", "testdevice");
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -717,6 +742,7 @@ TEST_FUNCTION(destroy_after_subscribe_also_destroys_links_and_the_message_receiv
     STRICT_EXPECTED_CALL(messagesender_destroy(TEST_MESSAGE_SENDER));
     STRICT_EXPECTED_CALL(link_destroy(TEST_SENDER_LINK));
     STRICT_EXPECTED_CALL(link_destroy(TEST_RECEIVER_LINK));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -742,9 +768,10 @@ TEST_FUNCTION(iothubtransportamqp_methods_destroy_frees_tracked_handles)
     iothubtransportamqp_methods_unsubscribe(amqp_methods_handle);
     umock_c_reset_all_calls();
 
-    /* one extra free for the handle and one extra for the handle array */
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    /* one extra free for the tracked handle */
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -773,10 +800,12 @@ TEST_FUNCTION(iothubtransportamqp_methods_destroy_frees_2_tracked_handles)
     iothubtransportamqp_methods_unsubscribe(amqp_methods_handle);
     umock_c_reset_all_calls();
 
-    /* 2 extra frees for the handle and one extra for the handle array */
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    /* 2 extra frees for the tracked handles */
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -1338,7 +1367,7 @@ TEST_FUNCTION(iothubtransportamqp_methods_unsubscribe_after_unsubscribe_does_not
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_054: [ - `method_handle` shall be set to a newly created `IOTHUBTRANSPORT_AMQP_METHOD_HANDLE` that can be passed later as an argument to `iothubtransportamqp_methods_respond`. ]*/
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_112: [ Memory shall be allocated for the `IOTHUBTRANSPORT_AMQP_METHOD_HANDLE` to hold the correlation-id, so that it can be used in the `iothubtransportamqp_methods_respond` function. ]*/
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_056: [ On success the `on_message_received` callback shall return a newly constructed delivery state obtained by calling `messaging_delivery_accepted`. ]*/
-/* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_113: [ All `IOTHUBTRANSPORT_AMQP_METHOD_HANDLE` handles shall be tracked in an array of handles that shall be resized accordingly when a methopd handle is added to it. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_113: [ All `IOTHUBTRANSPORT_AMQP_METHOD_HANDLE` handles shall be tracked in a list of handles, so that a handle can be added or removed without searching or resizing. ]*/
 TEST_FUNCTION(when_a_message_is_received_a_new_method_request_is_indicated)
 {
     /// arrange
@@ -1483,40 +1512,6 @@ TEST_FUNCTION(when_allocating_memory_for_the_method_handle_fails_the_message_is_
     iothubtransportamqp_methods_destroy(amqp_methods_handle);
 }
 
-/* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_138: [ If resizing the tracked method handles array fails, the RELEASED outcome shall be returned and an error shall be indicated. ]*/
-TEST_FUNCTION(when_reallocating_memory_for_tracked_handles_fails_the_message_is_rejected)
-{
-    /// arrange
-    IOTHUBTRANSPORT_AMQP_METHODS_HANDLE amqp_methods_handle = iothubtransportamqp_methods_create("testhost", "testdevice");
-    AMQP_VALUE correlation_id = (AMQP_VALUE)0x5000;
-    AMQP_VALUE result;
-    umock_c_reset_all_calls();
-    setup_subscribe_expected_calls();
-    (void)iothubtransportamqp_methods_subscribe(amqp_methods_handle, TEST_SESSION_HANDLE, test_on_methods_error, (void*)0x4242, test_on_method_request_received, (void*)0x4243, test_on_methods_unsubscribed, (void*)0x4344);
-    umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(message_get_properties(TEST_UAMQP_MESSAGE, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer(2, &test_properties_handle, sizeof(test_properties_handle));
-    STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
-    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .SetReturn(NULL);
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(properties_destroy(test_properties_handle));
-    STRICT_EXPECTED_CALL(messaging_delivery_released());
-    STRICT_EXPECTED_CALL(test_on_methods_error((void*)0x4242));
-    /// act
-    result = g_on_message_received(amqp_methods_handle, TEST_UAMQP_MESSAGE);
-
-    /// assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ASSERT_ARE_EQUAL(void_ptr, TEST_DELIVERY_RELEASED, result);
-
-    /// cleanup
-    iothubtransportamqp_methods_destroy(amqp_methods_handle);
-}
-
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_122: [ If `amqpvalue_get_uuid` fails the REJECTED outcome with `amqp:decode-error` shall be returned. ]*/
 TEST_FUNCTION(when_amqpvalue_get_uuid_fails_the_message_is_rejected)
 {
@@ -1535,7 +1530,6 @@ TEST_FUNCTION(when_amqpvalue_get_uuid_fails_the_message_is_rejected)
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid))
         .SetReturn(42);
@@ -1579,7 +1573,6 @@ TEST_FUNCTION(when_message_get_body_amqp_data_in_place_fails_the_message_is_reje
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -1626,7 +1619,6 @@ TEST_FUNCTION(when_message_get_application_properties_fails_the_message_is_rejec
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -1675,7 +1667,6 @@ TEST_FUNCTION(when_amqpvalue_get_inplace_described_value_fails_the_message_is_re
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -1727,7 +1718,6 @@ TEST_FUNCTION(when_amqpvalue_create_string_fails_the_message_is_released)
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -1782,7 +1772,6 @@ TEST_FUNCTION(when_amqpvalue_get_map_value_fails_the_message_is_rejected)
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -1841,7 +1830,6 @@ TEST_FUNCTION(when_amqpvalue_get_string_fails_the_message_is_rejected)
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -1905,7 +1893,6 @@ TEST_FUNCTION(when_messaging_delivery_accepted_fails_an_RELEASED_outcome_shall_b
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -1970,7 +1957,6 @@ TEST_FUNCTION(when_creating_the_RELEASED_outcome_fails_an_error_is_triggered)
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -2036,7 +2022,6 @@ TEST_FUNCTION(when_calling_the_method_request_received_callback_fails_then_RELEA
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -2052,11 +2037,13 @@ TEST_FUNCTION(when_calling_the_method_request_received_callback_fails_then_RELEA
     STRICT_EXPECTED_CALL(amqpvalue_get_string(test_property_value, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &method_name_ptr, sizeof(method_name_ptr));
     STRICT_EXPECTED_CALL(messaging_delivery_accepted());
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(test_on_method_request_received((void*)0x4243, TEST_METHOD_NAME, IGNORED_PTR_ARG, sizeof(test_method_request_payload), IGNORED_PTR_ARG))
         .ValidateArgumentBuffer(3, test_method_request_payload, sizeof(test_method_request_payload))
         .IgnoreArgument_method_handle()
         .SetReturn(42);
     STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_DELIVERY_ACCEPTED));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(messaging_delivery_rejected("amqp:internal-error", IGNORED_PTR_ARG))
         .IgnoreArgument_error_description();
@@ -2182,7 +2169,7 @@ TEST_FUNCTION(iothubtransportamqp_methods_respond_sends_the_uAMQP_message)
     STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER, TEST_RESPONSE_UAMQP_MESSAGE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument_on_message_send_complete()
         .IgnoreArgument_callback_context();
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(status_property_value));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(status_property_key));
@@ -2294,11 +2281,12 @@ TEST_FUNCTION(when_a_failure_occurs_iothubtransportamqp_methods_respond_fails)
         .IgnoreArgument_on_message_send_complete()
         .IgnoreArgument_callback_context()
         .SetFailReturn(1);
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
 
-    for (size_t i = 0; i < umock_c_negative_tests_call_count() - 1; i++)
+    for (size_t i = 0; i < umock_c_negative_tests_call_count() - 2; i++)
     {
         umock_c_negative_tests_reset();
         umock_c_negative_tests_fail_call(i);
@@ -2356,7 +2344,6 @@ TEST_FUNCTION(iothubtransportamqp_methods_respond_can_be_called_from_the_method_
     STRICT_EXPECTED_CALL(properties_get_correlation_id(test_properties_handle, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id, sizeof(correlation_id));
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_get_uuid(correlation_id, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &correlation_id_uuid, sizeof(correlation_id_uuid));
     STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_UAMQP_MESSAGE, 0, IGNORED_PTR_ARG))
@@ -2372,6 +2359,7 @@ TEST_FUNCTION(iothubtransportamqp_methods_respond_can_be_called_from_the_method_
     STRICT_EXPECTED_CALL(amqpvalue_get_string(test_property_value, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &method_name_ptr, sizeof(method_name_ptr));
     STRICT_EXPECTED_CALL(messaging_delivery_accepted());
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(test_on_method_request_received_calling_respond((void*)0x4243, TEST_METHOD_NAME, IGNORED_PTR_ARG, sizeof(test_method_request_payload), IGNORED_PTR_ARG))
         .ValidateArgumentBuffer(3, test_method_request_payload, sizeof(test_method_request_payload))
         .IgnoreArgument(5);
@@ -2397,7 +2385,7 @@ TEST_FUNCTION(iothubtransportamqp_methods_respond_can_be_called_from_the_method_
     STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER, TEST_RESPONSE_UAMQP_MESSAGE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument_on_message_send_complete()
         .IgnoreArgument_callback_context();
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(status_property_value));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(status_property_key));
@@ -2477,7 +2465,7 @@ TEST_FUNCTION(iothubtransportamqp_methods_respond_to_the_second_method_succeeds)
     STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER, TEST_RESPONSE_UAMQP_MESSAGE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument_on_message_send_complete()
         .IgnoreArgument_callback_context();
-    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(status_property_value));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(status_property_key));
@@ -2498,7 +2486,7 @@ TEST_FUNCTION(iothubtransportamqp_methods_respond_to_the_second_method_succeeds)
     iothubtransportamqp_methods_destroy(amqp_methods_handle);
 }
 
-/* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_114: [ The handle `method_handle` shall be removed from the array used to track the method handles. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_114: [ The handle `method_handle` shall be removed from the list used to track the method handles. ]*/
 TEST_FUNCTION(iothubtransportamqp_methods_respond_removes_the_handle_from_the_tracked_handles)
 {
     /// arrange
@@ -2525,9 +2513,10 @@ TEST_FUNCTION(iothubtransportamqp_methods_respond_removes_the_handle_from_the_tr
     iothubtransportamqp_methods_unsubscribe(amqp_methods_handle);
     umock_c_reset_all_calls();
 
-    /* 1 extra free for the handle and one extra for the handle array */
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    /* 1 extra free for the handle still tracked */
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -2540,7 +2529,7 @@ TEST_FUNCTION(iothubtransportamqp_methods_respond_removes_the_handle_from_the_tr
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_114: [ The handle `method_handle` shall be removed from the array used to track the method handles. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_114: [ The handle `method_handle` shall be removed from the list used to track the method handles. ]*/
 TEST_FUNCTION(iothubtransportamqp_methods_respond_after_a_handle_has_been_removed_works)
 {
     /// arrange
@@ -2572,6 +2561,46 @@ TEST_FUNCTION(iothubtransportamqp_methods_respond_after_a_handle_has_been_remove
     iothubtransportamqp_methods_destroy(amqp_methods_handle);
 }
 
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_113: [ All `IOTHUBTRANSPORT_AMQP_METHOD_HANDLE` handles shall be tracked in a list of handles, so that a handle can be added or removed without searching or resizing. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_114: [ The handle `method_handle` shall be removed from the list used to track the method handles. ]*/
+TEST_FUNCTION(iothubtransportamqp_methods_respond_to_methods_in_the_reverse_order_succeeds)
+{
+    /// arrange
+    int first_result;
+    int second_result;
+    IOTHUBTRANSPORT_AMQP_METHODS_HANDLE amqp_methods_handle = iothubtransportamqp_methods_create("testhost", "testdevice");
+    const unsigned char response_payload[] = { 0x43 };
+    IOTHUBTRANSPORT_AMQP_METHOD_HANDLE g_first_method_handle;
+    IOTHUBTRANSPORT_AMQP_METHOD_HANDLE g_second_method_handle;
+
+    umock_c_reset_all_calls();
+    setup_subscribe_expected_calls();
+    (void)iothubtransportamqp_methods_subscribe(amqp_methods_handle, TEST_SESSION_HANDLE, test_on_methods_error, (void*)0x4242, test_on_method_request_received, (void*)0x4243, test_on_methods_unsubscribed, (void*)0x4344);
+    umock_c_reset_all_calls();
+    setup_message_received_calls();
+    g_on_message_received(amqp_methods_handle, TEST_UAMQP_MESSAGE);
+    g_first_method_handle = g_method_handle;
+    setup_message_received_calls();
+    g_on_message_received(amqp_methods_handle, TEST_UAMQP_MESSAGE);
+    g_second_method_handle = g_method_handle;
+    umock_c_reset_all_calls();
+
+    setup_respond_calls(242);
+    setup_respond_calls(242);
+
+    /// act
+    second_result = iothubtransportamqp_methods_respond(g_second_method_handle, response_payload, sizeof(response_payload), 242);
+    first_result = iothubtransportamqp_methods_respond(g_first_method_handle, response_payload, sizeof(response_payload), 242);
+
+    /// assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, second_result);
+    ASSERT_ARE_EQUAL(int, 0, first_result);
+
+    /// cleanup
+    iothubtransportamqp_methods_destroy(amqp_methods_handle);
+}
+
 /* on_message_receiver_state_changed */
 
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_119: [ When `on_message_receiver_state_changed` if called with the `new_state` being `MESSAGE_RECEIVER_STATE_ERROR`, an error shall be indicated by calling the `on_methods_error` callback passed to `iothubtransportamqp_methods_subscribe`. ]*/
@@ -0,0 +1,1156 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdbool>
+#include <cstdint>
+#include <cstring>
+#include <cstdarg>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umock_c_negative_tests.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    void* my_gballoc_malloc(size_t size)
+    {
+        return malloc(size);
+    }
+
+    void my_gballoc_free(void* ptr)
+    {
+        free(ptr);
+    }
+
+    void* my_gballoc_realloc(void* ptr, size_t size)
+    {
+        return realloc(ptr, size);
+    }
+
+    int real_mallocAndStrcpy_s(char** destination, const char* source);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/constbuffer.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "azure_uamqp_c/messaging.h"
+#include "azure_uamqp_c/message.h"
+
+#undef ENABLE_MOCKS
+
+#include "iothubtransportamqp_twin.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+#ifdef __cplusplus
+}
+#endif
+
+#define TEST_HOSTNAME               "test.azure-devices.net"
+#define TEST_DEVICE_ID              "test_device"
+#define TEST_SESSION_HANDLE         (SESSION_HANDLE)0x4245
+#define TEST_SENDER_LINK            (LINK_HANDLE)0x4246
+#define TEST_RECEIVER_LINK          (LINK_HANDLE)0x4247
+#define TEST_MESSAGE_RECEIVER       (MESSAGE_RECEIVER_HANDLE)0x4248
+#define TEST_MESSAGE_SENDER         (MESSAGE_SENDER_HANDLE)0x4249
+#define TEST_UAMQP_MESSAGE          (MESSAGE_HANDLE)0x4255
+#define TEST_RESPONSE_UAMQP_MESSAGE (MESSAGE_HANDLE)0x4256
+#define TEST_PROPERTIES_HANDLE      (PROPERTIES_HANDLE)0x4257
+#define TEST_DELIVERY_ACCEPTED      (AMQP_VALUE)0x4258
+#define TEST_DELIVERY_RELEASED      (AMQP_VALUE)0x4259
+#define TEST_DELIVERY_REJECTED      (AMQP_VALUE)0x4260
+#define TEST_REPORTED_STATE_1       (CONSTBUFFER_HANDLE)0x4261
+#define TEST_REPORTED_STATE_2       (CONSTBUFFER_HANDLE)0x4262
+#define TEST_CONTEXT                (void*)0x4263
+#define TEST_MAX_SENT               8
+
+static const unsigned char TEST_REPORTED_STATE_BYTES[] = { '{', '}' };
+static const CONSTBUFFER TEST_REPORTED_STATE_CONTENT = { TEST_REPORTED_STATE_BYTES, sizeof(TEST_REPORTED_STATE_BYTES) };
+static const unsigned char TEST_DOCUMENT[] = "{\"desired\":{\"$version\":2}}";
+
+typedef struct SENT_REQUEST_TAG
+{
+    char correlation_id[32];
+    char operation[8];
+    char resource[64];
+} SENT_REQUEST;
+
+static SENT_REQUEST g_sent[TEST_MAX_SENT];
+static size_t g_sent_count;
+static char g_pending_correlation_id[32];
+static char g_pending_operation[8];
+static char g_pending_resource[64];
+static int g_messagesender_send_result;
+static int g_messagesender_open_result;
+static size_t g_destroyed_count;
+static char g_sender_link_name[64];
+static char g_sender_link_target[128];
+static char g_receiver_link_name[64];
+static char g_receiver_link_source[128];
+static char g_channel_correlation_id[64];
+static char g_api_version[16];
+
+static const char* g_response_correlation_id;
+static int32_t g_response_status;
+static bool g_response_has_status;
+static const unsigned char* g_response_body;
+static size_t g_response_body_size;
+
+static size_t g_on_twin_error_count;
+static size_t g_on_document_received_count;
+static DEVICE_TWIN_UPDATE_STATE g_document_update_state;
+static size_t g_document_size;
+static size_t g_on_reported_state_complete_count;
+static uint32_t g_reported_state_item_id;
+static int g_reported_state_status_code;
+static void* g_callback_context;
+static size_t g_constbuffer_clones;
+
+static ON_MESSAGE_RECEIVED g_on_message_received;
+static void* g_on_message_received_context;
+static ON_MESSAGE_SEND_COMPLETE g_on_message_send_complete;
+static void* g_on_message_send_complete_context;
+static ON_MESSAGE_SENDER_STATE_CHANGED g_on_message_sender_state_changed;
+static void* g_on_message_sender_state_changed_context;
+static ON_MESSAGE_RECEIVER_STATE_CHANGED g_on_message_receiver_state_changed;
+static void* g_on_message_receiver_state_changed_context;
+
+static void test_on_twin_error(void* context)
+{
+    g_callback_context = context;
+    g_on_twin_error_count++;
+}
+
+static void test_on_document_received(void* context, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* document, size_t document_size)
+{
+    (void)document;
+    g_callback_context = context;
+    g_document_update_state = update_state;
+    g_document_size = document_size;
+    g_on_document_received_count++;
+}
+
+static void test_on_reported_state_complete(void* context, uint32_t item_id, int status_code)
+{
+    g_callback_context = context;
+    g_reported_state_item_id = item_id;
+    g_reported_state_status_code = status_code;
+    g_on_reported_state_complete_count++;
+}
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* The AMQP values are copies of their string (an empty one for maps), so the module under test frees them with amqpvalue_destroy. */
+    static AMQP_VALUE create_test_amqp_value(const char* value)
+    {
+        char* result = (char*)my_gballoc_malloc(strlen(value) + 1);
+        (void)strcpy(result, value);
+        return (AMQP_VALUE)result;
+    }
+
+    static AMQP_VALUE my_amqpvalue_create_string(const char* value)
+    {
+        return create_test_amqp_value(value);
+    }
+
+    static AMQP_VALUE my_amqpvalue_create_symbol(const char* value)
+    {
+        return create_test_amqp_value(value);
+    }
+
+    static AMQP_VALUE my_amqpvalue_create_map(void)
+    {
+        return create_test_amqp_value("");
+    }
+
+    static void my_amqpvalue_destroy(AMQP_VALUE value)
+    {
+        my_gballoc_free(value);
+    }
+
+    static AMQP_VALUE my_messaging_create_source(const char* address)
+    {
+        return create_test_amqp_value(address);
+    }
+
+    static AMQP_VALUE my_messaging_create_target(const char* address)
+    {
+        return create_test_amqp_value(address);
+    }
+
+    static int my_amqpvalue_set_map_value(AMQP_VALUE map, AMQP_VALUE key, AMQP_VALUE value)
+    {
+        (void)map;
+        if (strcmp((const char*)key, "operation") == 0)
+        {
+            (void)strcpy(g_pending_operation, (const char*)value);
+        }
+        else if (strcmp((const char*)key, "resource") == 0)
+        {
+            (void)strcpy(g_pending_resource, (const char*)value);
+        }
+        else if (strcmp((const char*)key, "com.microsoft:channel-correlation-id") == 0)
+        {
+            (void)strcpy(g_channel_correlation_id, (const char*)value);
+        }
+        else if (strcmp((const char*)key, "com.microsoft:api-version") == 0)
+        {
+            (void)strcpy(g_api_version, (const char*)value);
+        }
+        return 0;
+    }
+
+    static int my_properties_set_correlation_id(PROPERTIES_HANDLE properties, AMQP_VALUE correlation_id_value)
+    {
+        (void)properties;
+        (void)strcpy(g_pending_correlation_id, (const char*)correlation_id_value);
+        return 0;
+    }
+
+    static LINK_HANDLE my_link_create(SESSION_HANDLE session, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+    {
+        LINK_HANDLE result;
+        (void)session;
+        if (role == role_sender)
+        {
+            (void)strcpy(g_sender_link_name, name);
+            (void)strcpy(g_sender_link_target, (const char*)target);
+            result = TEST_SENDER_LINK;
+        }
+        else
+        {
+            (void)strcpy(g_receiver_link_name, name);
+            (void)strcpy(g_receiver_link_source, (const char*)source);
+            result = TEST_RECEIVER_LINK;
+        }
+        return result;
+    }
+
+    static void my_link_destroy(LINK_HANDLE link)
+    {
+        (void)link;
+        g_destroyed_count++;
+    }
+
+    static void my_messagesender_destroy(MESSAGE_SENDER_HANDLE message_sender)
+    {
+        (void)message_sender;
+        g_destroyed_count++;
+    }
+
+    static void my_messagereceiver_destroy(MESSAGE_RECEIVER_HANDLE message_receiver)
+    {
+        (void)message_receiver;
+        g_destroyed_count++;
+    }
+
+    static int my_messagesender_open(MESSAGE_SENDER_HANDLE message_sender)
+    {
+        (void)message_sender;
+        return g_messagesender_open_result;
+    }
+
+    static MESSAGE_SENDER_HANDLE my_messagesender_create(LINK_HANDLE link, ON_MESSAGE_SENDER_STATE_CHANGED on_message_sender_state_changed, void* context)
+    {
+        (void)link;
+        g_on_message_sender_state_changed = on_message_sender_state_changed;
+        g_on_message_sender_state_changed_context = context;
+        return TEST_MESSAGE_SENDER;
+    }
+
+    static MESSAGE_RECEIVER_HANDLE my_messagereceiver_create(LINK_HANDLE link, ON_MESSAGE_RECEIVER_STATE_CHANGED on_message_receiver_state_changed, void* context)
+    {
+        (void)link;
+        g_on_message_receiver_state_changed = on_message_receiver_state_changed;
+        g_on_message_receiver_state_changed_context = context;
+        return TEST_MESSAGE_RECEIVER;
+    }
+
+    static int my_messagereceiver_open(MESSAGE_RECEIVER_HANDLE message_receiver, ON_MESSAGE_RECEIVED on_message_received, void* callback_context)
+    {
+        (void)message_receiver;
+        g_on_message_received = on_message_received;
+        g_on_message_received_context = callback_context;
+        return 0;
+    }
+
+    static int my_messagesender_send(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
+    {
+        (void)message_sender;
+        (void)message;
+        g_on_message_send_complete = on_message_send_complete;
+        g_on_message_send_complete_context = callback_context;
+        if ((g_messagesender_send_result == 0) && (g_sent_count < TEST_MAX_SENT))
+        {
+            (void)strcpy(g_sent[g_sent_count].correlation_id, g_pending_correlation_id);
+            (void)strcpy(g_sent[g_sent_count].operation, g_pending_operation);
+            (void)strcpy(g_sent[g_sent_count].resource, g_pending_resource);
+            g_sent_count++;
+        }
+        g_pending_resource[0] = '\0';
+        return g_messagesender_send_result;
+    }
+
+    static int my_message_get_properties(MESSAGE_HANDLE message, PROPERTIES_HANDLE* properties)
+    {
+        (void)message;
+        *properties = TEST_PROPERTIES_HANDLE;
+        return 0;
+    }
+
+    static int my_properties_get_correlation_id(PROPERTIES_HANDLE properties, AMQP_VALUE* correlation_id_value)
+    {
+        int result;
+        (void)properties;
+        if (g_response_correlation_id == NULL)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            *correlation_id_value = (AMQP_VALUE)g_response_correlation_id;
+            result = 0;
+        }
+        return result;
+    }
+
+    static int my_amqpvalue_get_string(AMQP_VALUE value, const char** string_value)
+    {
+        *string_value = (const char*)value;
+        return 0;
+    }
+
+    static int my_message_get_message_annotations(MESSAGE_HANDLE message, annotations* message_annotations)
+    {
+        (void)message;
+        *message_annotations = my_amqpvalue_create_map();
+        return 0;
+    }
+
+    static AMQP_VALUE my_amqpvalue_get_map_value(AMQP_VALUE map, AMQP_VALUE key)
+    {
+        (void)map;
+        (void)key;
+        return g_response_has_status ? create_test_amqp_value("status") : NULL;
+    }
+
+    static int my_amqpvalue_get_int(AMQP_VALUE value, int32_t* int_value)
+    {
+        (void)value;
+        *int_value = g_response_status;
+        return 0;
+    }
+
+    static int my_message_get_body_amqp_data_count(MESSAGE_HANDLE message, size_t* count)
+    {
+        (void)message;
+        *count = (g_response_body_size > 0) ? 1 : 0;
+        return 0;
+    }
+
+    static int my_message_get_body_amqp_data_in_place(MESSAGE_HANDLE message, size_t index, BINARY_DATA* amqp_data)
+    {
+        (void)message;
+        (void)index;
+        amqp_data->bytes = g_response_body;
+        amqp_data->length = g_response_body_size;
+        return 0;
+    }
+
+    static CONSTBUFFER_HANDLE my_CONSTBUFFER_Clone(CONSTBUFFER_HANDLE constbufferHandle)
+    {
+        g_constbuffer_clones++;
+        return constbufferHandle;
+    }
+
+    static void my_CONSTBUFFER_Destroy(CONSTBUFFER_HANDLE constbufferHandle)
+    {
+        (void)constbufferHandle;
+        g_constbuffer_clones--;
+    }
+
+    static const CONSTBUFFER* my_CONSTBUFFER_GetContent(CONSTBUFFER_HANDLE constbufferHandle)
+    {
+        (void)constbufferHandle;
+        return &TEST_REPORTED_STATE_CONTENT;
+    }
+
+    STRING_HANDLE STRING_construct_sprintf(const char* format, ...)
+    {
+        char* result = (char*)my_gballoc_malloc(256);
+        va_list args;
+        va_start(args, format);
+        (void)vsnprintf(result, 256, format, args);
+        va_end(args);
+        return (STRING_HANDLE)result;
+    }
+
+    static const char* my_STRING_c_str(STRING_HANDLE handle)
+    {
+        return (const char*)handle;
+    }
+
+    static void my_STRING_delete(STRING_HANDLE handle)
+    {
+        my_gballoc_free(handle);
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static IOTHUBTRANSPORT_AMQP_TWIN_HANDLE create_and_subscribe(void)
+{
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE result = iothubtransportamqp_twin_create(TEST_HOSTNAME, TEST_DEVICE_ID);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, 0, iothubtransportamqp_twin_subscribe(result, TEST_SESSION_HANDLE, test_on_twin_error, test_on_document_received, test_on_reported_state_complete, TEST_CONTEXT));
+    return result;
+}
+
+static void open_sender(void)
+{
+    g_on_message_sender_state_changed(g_on_message_sender_state_changed_context, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_OPENING);
+}
+
+static AMQP_VALUE receive_response(const char* correlation_id, int32_t status, const unsigned char* body, size_t body_size)
+{
+    g_response_correlation_id = correlation_id;
+    g_response_status = status;
+    g_response_has_status = true;
+    g_response_body = body;
+    g_response_body_size = body_size;
+    return g_on_message_received(g_on_message_received_context, TEST_RESPONSE_UAMQP_MESSAGE);
+}
+
+BEGIN_TEST_SUITE(iothubtransportamqp_twin_unittests)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    result = umock_c_init(on_umock_c_error);
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_RETURN(message_create, TEST_UAMQP_MESSAGE);
+    REGISTER_GLOBAL_MOCK_RETURN(properties_create, TEST_PROPERTIES_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(messaging_delivery_accepted, TEST_DELIVERY_ACCEPTED);
+    REGISTER_GLOBAL_MOCK_RETURN(messaging_delivery_released, TEST_DELIVERY_RELEASED);
+    REGISTER_GLOBAL_MOCK_RETURN(messaging_delivery_rejected, TEST_DELIVERY_REJECTED);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, real_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, my_STRING_c_str);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_create_string, my_amqpvalue_create_string);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_create_symbol, my_amqpvalue_create_symbol);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_create_map, my_amqpvalue_create_map);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_destroy, my_amqpvalue_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_set_map_value, my_amqpvalue_set_map_value);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_string, my_amqpvalue_get_string);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_map_value, my_amqpvalue_get_map_value);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_int, my_amqpvalue_get_int);
+    REGISTER_GLOBAL_MOCK_HOOK(messaging_create_source, my_messaging_create_source);
+    REGISTER_GLOBAL_MOCK_HOOK(messaging_create_target, my_messaging_create_target);
+    REGISTER_GLOBAL_MOCK_HOOK(properties_set_correlation_id, my_properties_set_correlation_id);
+    REGISTER_GLOBAL_MOCK_HOOK(properties_get_correlation_id, my_properties_get_correlation_id);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_properties, my_message_get_properties);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_message_annotations, my_message_get_message_annotations);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_body_amqp_data_count, my_message_get_body_amqp_data_count);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_body_amqp_data_in_place, my_message_get_body_amqp_data_in_place);
+    REGISTER_GLOBAL_MOCK_HOOK(link_create, my_link_create);
+    REGISTER_GLOBAL_MOCK_HOOK(link_destroy, my_link_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(messagesender_destroy, my_messagesender_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_destroy, my_messagereceiver_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(messagesender_open, my_messagesender_open);
+    REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_open, my_messagereceiver_open);
+    REGISTER_GLOBAL_MOCK_HOOK(messagesender_send, my_messagesender_send);
+    REGISTER_GLOBAL_MOCK_HOOK(messagesender_create, my_messagesender_create);
+    REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_create, my_messagereceiver_create);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Clone, my_CONSTBUFFER_Clone);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Destroy, my_CONSTBUFFER_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_GetContent, my_CONSTBUFFER_GetContent);
+
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_RECEIVER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_SENDER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CONSTBUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(role, bool);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_RECEIVER_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_SENDER_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PROPERTIES_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(fields, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(annotations, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(annotations*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    memset(g_sent, 0, sizeof(g_sent));
+    g_sent_count = 0;
+    g_pending_correlation_id[0] = '\0';
+    g_pending_operation[0] = '\0';
+    g_pending_resource[0] = '\0';
+    g_messagesender_send_result = 0;
+    g_messagesender_open_result = 0;
+    g_destroyed_count = 0;
+    g_sender_link_name[0] = '\0';
+    g_sender_link_target[0] = '\0';
+    g_receiver_link_name[0] = '\0';
+    g_receiver_link_source[0] = '\0';
+    g_channel_correlation_id[0] = '\0';
+    g_api_version[0] = '\0';
+    g_response_correlation_id = NULL;
+    g_response_status = 0;
+    g_response_has_status = false;
+    g_response_body = NULL;
+    g_response_body_size = 0;
+    g_on_twin_error_count = 0;
+    g_on_document_received_count = 0;
+    g_document_size = 0;
+    g_on_reported_state_complete_count = 0;
+    g_reported_state_item_id = 0;
+    g_reported_state_status_code = 0;
+    g_callback_context = NULL;
+    g_constbuffer_clones = 0;
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_002: [ If any argument is NULL, `iothubtransportamqp_twin_create` shall return NULL. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_create_with_NULL_hostname_fails)
+{
+    // arrange
+
+    // act
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE result = iothubtransportamqp_twin_create(NULL, TEST_DEVICE_ID);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_002: [ If any argument is NULL, `iothubtransportamqp_twin_create` shall return NULL. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_create_with_NULL_device_id_fails)
+{
+    // arrange
+
+    // act
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE result = iothubtransportamqp_twin_create(TEST_HOSTNAME, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_001: [ `iothubtransportamqp_twin_create` shall allocate a new instance handling the device twin of `device_id` over AMQP, saving copies of `hostname` and `device_id`, and on success return a non-NULL handle to it. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_create_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DEVICE_ID));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_HOSTNAME));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE result = iothubtransportamqp_twin_create(TEST_HOSTNAME, TEST_DEVICE_ID);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(result);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_003: [ If any allocation fails, `iothubtransportamqp_twin_create` shall return NULL. ]*/
+TEST_FUNCTION(when_an_allocation_fails_iothubtransportamqp_twin_create_fails)
+{
+    // arrange
+    size_t i;
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DEVICE_ID));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_HOSTNAME));
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        IOTHUBTRANSPORT_AMQP_TWIN_HANDLE result = iothubtransportamqp_twin_create(TEST_HOSTNAME, TEST_DEVICE_ID);
+
+        // assert
+        ASSERT_IS_NULL(result);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_004: [ If `twin_handle` is NULL, `iothubtransportamqp_twin_destroy` shall do nothing. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_destroy_with_NULL_handle_does_nothing)
+{
+    // arrange
+
+    // act
+    iothubtransportamqp_twin_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_022: [ If any argument but `context` is NULL, `iothubtransportamqp_twin_subscribe` shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_subscribe_with_NULL_arguments_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = iothubtransportamqp_twin_create(TEST_HOSTNAME, TEST_DEVICE_ID);
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = iothubtransportamqp_twin_subscribe(NULL, TEST_SESSION_HANDLE, test_on_twin_error, test_on_document_received, test_on_reported_state_complete, TEST_CONTEXT);
+    int result2 = iothubtransportamqp_twin_subscribe(handle, NULL, test_on_twin_error, test_on_document_received, test_on_reported_state_complete, TEST_CONTEXT);
+    int result3 = iothubtransportamqp_twin_subscribe(handle, TEST_SESSION_HANDLE, NULL, test_on_document_received, test_on_reported_state_complete, TEST_CONTEXT);
+    int result4 = iothubtransportamqp_twin_subscribe(handle, TEST_SESSION_HANDLE, test_on_twin_error, NULL, test_on_reported_state_complete, TEST_CONTEXT);
+    int result5 = iothubtransportamqp_twin_subscribe(handle, TEST_SESSION_HANDLE, test_on_twin_error, test_on_document_received, NULL, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result4);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result5);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_006: [ `iothubtransportamqp_twin_subscribe` shall create on `session_handle` a sender link and a receiver link to `amqps://{hostname}/devices/{device_id}/twin`, named `twin_sender_link-{device_id}` and `twin_receiver_link-{device_id}`. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_007: [ Both links shall have the attach properties `com.microsoft:channel-correlation-id` set to `twin:` followed by the device id and `com.microsoft:api-version` set to `2016-11-14`. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_subscribe_creates_the_twin_links)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = iothubtransportamqp_twin_create(TEST_HOSTNAME, TEST_DEVICE_ID);
+
+    // act
+    int result = iothubtransportamqp_twin_subscribe(handle, TEST_SESSION_HANDLE, test_on_twin_error, test_on_document_received, test_on_reported_state_complete, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, "twin_sender_link-" TEST_DEVICE_ID, g_sender_link_name);
+    ASSERT_ARE_EQUAL(char_ptr, "amqps://" TEST_HOSTNAME "/devices/" TEST_DEVICE_ID "/twin", g_sender_link_target);
+    ASSERT_ARE_EQUAL(char_ptr, "twin_receiver_link-" TEST_DEVICE_ID, g_receiver_link_name);
+    ASSERT_ARE_EQUAL(char_ptr, "amqps://" TEST_HOSTNAME "/devices/" TEST_DEVICE_ID "/twin", g_receiver_link_source);
+    ASSERT_ARE_EQUAL(char_ptr, "twin:" TEST_DEVICE_ID, g_channel_correlation_id);
+    ASSERT_ARE_EQUAL(char_ptr, "2016-11-14", g_api_version);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_023: [ If the instance is already subscribed, `iothubtransportamqp_twin_subscribe` shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_subscribe_when_subscribed_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+
+    // act
+    int result = iothubtransportamqp_twin_subscribe(handle, TEST_SESSION_HANDLE, test_on_twin_error, test_on_document_received, test_on_reported_state_complete, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_024: [ If anything fails, `iothubtransportamqp_twin_subscribe` shall destroy what it created and return a non-zero value. ]*/
+TEST_FUNCTION(when_messagesender_open_fails_iothubtransportamqp_twin_subscribe_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = iothubtransportamqp_twin_create(TEST_HOSTNAME, TEST_DEVICE_ID);
+    g_messagesender_open_result = __LINE__;
+
+    // act
+    int result = iothubtransportamqp_twin_subscribe(handle, TEST_SESSION_HANDLE, test_on_twin_error, test_on_document_received, test_on_reported_state_complete, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 4, g_destroyed_count);
+
+    // act
+    g_messagesender_open_result = 0;
+    result = iothubtransportamqp_twin_subscribe(handle, TEST_SESSION_HANDLE, test_on_twin_error, test_on_document_received, test_on_reported_state_complete, TEST_CONTEXT);
+    open_sender();
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 2, g_sent_count);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_008: [ `iothubtransportamqp_twin_subscribe` shall queue the subscription to the desired properties and then the GET of the twin document ahead of the reported states kept from a previous subscription, and open the message sender and the message receiver. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_010: [ The GET of the twin document shall carry the message annotation `operation` set to `GET`. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_011: [ The subscription to the desired properties shall carry the message annotations `operation` set to `PUT` and `resource` set to `/notifications/twin/properties/desired`. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_014: [ Once the sender link is open, all the requests not sent yet shall be sent in order without waiting for the responses of the previous ones. ]*/
+TEST_FUNCTION(when_the_sender_opens_the_subscription_and_the_GET_are_sent)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    ASSERT_ARE_EQUAL(size_t, 0, g_sent_count);
+
+    // act
+    open_sender();
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_sent_count);
+    ASSERT_ARE_EQUAL(char_ptr, "PUT", g_sent[0].operation);
+    ASSERT_ARE_EQUAL(char_ptr, "/notifications/twin/properties/desired", g_sent[0].resource);
+    ASSERT_ARE_EQUAL(char_ptr, "GET", g_sent[1].operation);
+    ASSERT_ARE_EQUAL(char_ptr, "", g_sent[1].resource);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_009: [ Every request shall carry a string correlation id unique for the handle. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_012: [ A reported state shall carry the message annotations `operation` set to `PATCH` and `resource` set to `/properties/reported`, and the reported state as its body. ]*/
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_030: [ `iothubtransportamqp_twin_send_reported_state` shall queue the reported state and send it right away if the sender link is open, whatever the number of reported states waiting for their response. ]*/
+TEST_FUNCTION(reported_states_are_sent_without_waiting_for_the_previous_responses)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+
+    // act
+    int result1 = iothubtransportamqp_twin_send_reported_state(handle, 1, TEST_REPORTED_STATE_1);
+    int result2 = iothubtransportamqp_twin_send_reported_state(handle, 2, TEST_REPORTED_STATE_2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(size_t, 4, g_sent_count);
+    ASSERT_ARE_EQUAL(char_ptr, "PATCH", g_sent[2].operation);
+    ASSERT_ARE_EQUAL(char_ptr, "/properties/reported", g_sent[2].resource);
+    ASSERT_ARE_EQUAL(char_ptr, "PATCH", g_sent[3].operation);
+    ASSERT_ARE_NOT_EQUAL(int, 0, strcmp(g_sent[0].correlation_id, g_sent[1].correlation_id));
+    ASSERT_ARE_NOT_EQUAL(int, 0, strcmp(g_sent[1].correlation_id, g_sent[2].correlation_id));
+    ASSERT_ARE_NOT_EQUAL(int, 0, strcmp(g_sent[2].correlation_id, g_sent[3].correlation_id));
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_029: [ `iothubtransportamqp_twin_send_reported_state` shall keep a clone of `reported_state`, so the content is not copied. ]*/
+TEST_FUNCTION(a_reported_state_queued_before_the_sender_opens_is_sent_when_it_opens)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+
+    // act
+    int result = iothubtransportamqp_twin_send_reported_state(handle, 1, TEST_REPORTED_STATE_1);
+    ASSERT_ARE_EQUAL(size_t, 0, g_sent_count);
+    open_sender();
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_constbuffer_clones);
+    ASSERT_ARE_EQUAL(size_t, 3, g_sent_count);
+    ASSERT_ARE_EQUAL(char_ptr, "PUT", g_sent[0].operation);
+    ASSERT_ARE_EQUAL(char_ptr, "GET", g_sent[1].operation);
+    ASSERT_ARE_EQUAL(char_ptr, "PATCH", g_sent[2].operation);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+    ASSERT_ARE_EQUAL(size_t, 0, g_constbuffer_clones);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_027: [ If `twin_handle` or `reported_state` is NULL, `iothubtransportamqp_twin_send_reported_state` shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_send_reported_state_with_NULL_arguments_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+
+    // act
+    int result1 = iothubtransportamqp_twin_send_reported_state(NULL, 1, TEST_REPORTED_STATE_1);
+    int result2 = iothubtransportamqp_twin_send_reported_state(handle, 1, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_028: [ If the instance is not subscribed, `iothubtransportamqp_twin_send_reported_state` shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_send_reported_state_when_not_subscribed_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = iothubtransportamqp_twin_create(TEST_HOSTNAME, TEST_DEVICE_ID);
+
+    // act
+    int result = iothubtransportamqp_twin_send_reported_state(handle, 1, TEST_REPORTED_STATE_1);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_031: [ If sending the reported state fails, `iothubtransportamqp_twin_send_reported_state` shall remove it and return a non-zero value. ]*/
+TEST_FUNCTION(when_messagesender_send_fails_iothubtransportamqp_twin_send_reported_state_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+    g_messagesender_send_result = __LINE__;
+
+    // act
+    int result = iothubtransportamqp_twin_send_reported_state(handle, 1, TEST_REPORTED_STATE_1);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_constbuffer_clones);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_019: [ The response of a reported state shall be given to `on_reported_state_complete` with the `item_id` of the reported state and the `status` annotation of the response, 500 if it has none. ]*/
+TEST_FUNCTION(the_responses_of_the_reported_states_are_matched_by_correlation_id)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+    (void)iothubtransportamqp_twin_send_reported_state(handle, 1, TEST_REPORTED_STATE_1);
+    (void)iothubtransportamqp_twin_send_reported_state(handle, 2, TEST_REPORTED_STATE_2);
+
+    // act
+    AMQP_VALUE result = receive_response(g_sent[3].correlation_id, 204, NULL, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DELIVERY_ACCEPTED, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_reported_state_complete_count);
+    ASSERT_ARE_EQUAL(uint32_t, 2, g_reported_state_item_id);
+    ASSERT_ARE_EQUAL(int, 204, g_reported_state_status_code);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT, g_callback_context);
+
+    // act
+    (void)receive_response(g_sent[2].correlation_id, 400, NULL, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_on_reported_state_complete_count);
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_reported_state_item_id);
+    ASSERT_ARE_EQUAL(int, 400, g_reported_state_status_code);
+    ASSERT_ARE_EQUAL(size_t, 0, g_constbuffer_clones);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_019: [ The response of a reported state shall be given to `on_reported_state_complete` with the `item_id` of the reported state and the `status` annotation of the response, 500 if it has none. ]*/
+TEST_FUNCTION(a_reported_state_response_without_status_completes_with_500)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+    (void)iothubtransportamqp_twin_send_reported_state(handle, 7, TEST_REPORTED_STATE_1);
+    g_response_correlation_id = g_sent[2].correlation_id;
+    g_response_has_status = false;
+
+    // act
+    (void)g_on_message_received(g_on_message_received_context, TEST_RESPONSE_UAMQP_MESSAGE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_reported_state_complete_count);
+    ASSERT_ARE_EQUAL(uint32_t, 7, g_reported_state_item_id);
+    ASSERT_ARE_EQUAL(int, 500, g_reported_state_status_code);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_021: [ The response of the GET shall be given to `on_document_received` with DEVICE_TWIN_UPDATE_COMPLETE. ]*/
+TEST_FUNCTION(the_response_of_the_GET_is_a_complete_document)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+
+    // act
+    (void)receive_response(g_sent[1].correlation_id, 200, TEST_DOCUMENT, sizeof(TEST_DOCUMENT) - 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_document_received_count);
+    ASSERT_ARE_EQUAL(int, DEVICE_TWIN_UPDATE_COMPLETE, g_document_update_state);
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_DOCUMENT) - 1, g_document_size);
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_twin_error_count);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_020: [ If the GET or the subscription to the desired properties fails, `on_twin_error` shall be called. ]*/
+TEST_FUNCTION(a_failed_subscription_to_the_desired_properties_calls_on_twin_error)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+
+    // act
+    (void)receive_response(g_sent[0].correlation_id, 404, NULL, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_twin_error_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_document_received_count);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_017: [ A message without correlation id shall be a patch of the desired properties, given to `on_document_received` with DEVICE_TWIN_UPDATE_PARTIAL. ]*/
+TEST_FUNCTION(a_message_without_correlation_id_is_a_desired_properties_patch)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+
+    // act
+    AMQP_VALUE result = receive_response(NULL, 0, TEST_DOCUMENT, sizeof(TEST_DOCUMENT) - 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DELIVERY_ACCEPTED, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_document_received_count);
+    ASSERT_ARE_EQUAL(int, DEVICE_TWIN_UPDATE_PARTIAL, g_document_update_state);
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_DOCUMENT) - 1, g_document_size);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_018: [ A response matching no request waiting for its response shall be accepted and ignored. ]*/
+TEST_FUNCTION(a_response_matching_no_request_is_ignored)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+
+    // act
+    AMQP_VALUE result = receive_response("twin-4242", 204, NULL, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DELIVERY_ACCEPTED, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_document_received_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_reported_state_complete_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_twin_error_count);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_013: [ If sending a request fails while subscribed, `on_twin_error` shall be called. ]*/
+TEST_FUNCTION(a_send_error_calls_on_twin_error)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+
+    // act
+    g_on_message_send_complete(g_on_message_send_complete_context, MESSAGE_SEND_ERROR);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_on_twin_error_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT, g_callback_context);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_016: [ If the message receiver or the message sender goes to the ERROR state, `on_twin_error` shall be called. ]*/
+TEST_FUNCTION(a_link_error_calls_on_twin_error)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+
+    // act
+    g_on_message_receiver_state_changed(g_on_message_receiver_state_changed_context, MESSAGE_RECEIVER_STATE_ERROR, MESSAGE_RECEIVER_STATE_OPEN);
+    g_on_message_sender_state_changed(g_on_message_sender_state_changed_context, MESSAGE_SENDER_STATE_ERROR, MESSAGE_SENDER_STATE_OPEN);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_on_twin_error_count);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_025: [ If `twin_handle` is NULL or not subscribed, `iothubtransportamqp_twin_unsubscribe` shall do nothing. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_unsubscribe_when_not_subscribed_does_nothing)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = iothubtransportamqp_twin_create(TEST_HOSTNAME, TEST_DEVICE_ID);
+    umock_c_reset_all_calls();
+
+    // act
+    iothubtransportamqp_twin_unsubscribe(NULL);
+    iothubtransportamqp_twin_unsubscribe(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_026: [ `iothubtransportamqp_twin_unsubscribe` shall destroy the message receiver, the message sender and both links, drop the GET and the subscription to the desired properties, and keep the reported states waiting for their response to send them again on the next subscribe. ]*/
+TEST_FUNCTION(the_reported_states_waiting_for_their_response_are_sent_again_after_a_new_subscribe)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+    (void)iothubtransportamqp_twin_send_reported_state(handle, 1, TEST_REPORTED_STATE_1);
+
+    // act
+    iothubtransportamqp_twin_unsubscribe(handle);
+    ASSERT_ARE_EQUAL(size_t, 4, g_destroyed_count);
+    g_sent_count = 0;
+    ASSERT_ARE_EQUAL(int, 0, iothubtransportamqp_twin_subscribe(handle, TEST_SESSION_HANDLE, test_on_twin_error, test_on_document_received, test_on_reported_state_complete, TEST_CONTEXT));
+    open_sender();
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, g_sent_count);
+    ASSERT_ARE_EQUAL(char_ptr, "PUT", g_sent[0].operation);
+    ASSERT_ARE_EQUAL(char_ptr, "GET", g_sent[1].operation);
+    ASSERT_ARE_EQUAL(char_ptr, "PATCH", g_sent[2].operation);
+    ASSERT_ARE_EQUAL(size_t, 1, g_constbuffer_clones);
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_reported_state_complete_count);
+
+    // cleanup
+    iothubtransportamqp_twin_destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_41_005: [ `iothubtransportamqp_twin_destroy` shall unsubscribe if subscribed and free the instance with the requests still waiting, without calling any callback. ]*/
+TEST_FUNCTION(iothubtransportamqp_twin_destroy_frees_the_waiting_reported_states_without_callbacks)
+{
+    // arrange
+    IOTHUBTRANSPORT_AMQP_TWIN_HANDLE handle = create_and_subscribe();
+    open_sender();
+    (void)iothubtransportamqp_twin_send_reported_state(handle, 1, TEST_REPORTED_STATE_1);
+    (void)iothubtransportamqp_twin_send_reported_state(handle, 2, TEST_REPORTED_STATE_2);
+
+    // act
+    iothubtransportamqp_twin_destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_constbuffer_clones);
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_reported_state_complete_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_on_twin_error_count);
+}
+
+END_TEST_SUITE(iothubtransportamqp_twin_unittests)
@@ -670,6 +670,28 @@ TEST_FUNCTION(AMQP_GetSendStatus)
 }
 
 
+// Tests_SRS_IOTHUBTRANSPORTAMQP_41_001: [IoTHubTransportAMQP_GetPollDescriptors shall get the sockets by calling into the IoTHubTransport_AMQP_Common_GetPollDescriptors()]
+TEST_FUNCTION(AMQP_GetPollDescriptors)
+{
+	// arrange
+	TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+
+	IOTHUB_CLIENT_POLL_DESCRIPTOR descriptors[1];
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(IoTHubTransport_AMQP_Common_GetPollDescriptors(TEST_TRANSPORT_LL_HANDLE, descriptors, 1))
+		.SetReturn(1);
+
+	// act
+	size_t result = provider->IoTHubTransport_GetPollDescriptors(TEST_TRANSPORT_LL_HANDLE, descriptors, 1);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 1, result);
+
+	// cleanup
+}
+
 // Tests_SRS_IOTHUBTRANSPORTAMQP_09_018: [IoTHubTransportAMQP_GetHostname shall get the hostname by calling into the IoTHubTransport_AMQP_Common_GetHostname()]
 TEST_FUNCTION(AMQP_GetHostname)
 {
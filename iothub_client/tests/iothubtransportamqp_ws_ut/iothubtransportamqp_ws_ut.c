@@ -35,6 +35,7 @@ static void real_free(void* ptr)
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/http_proxy_io.h"
+#include "iothub_client_ws_deflate_io.h"
 #include "iothubtransport_amqp_common.h"
 #undef ENABLE_MOCKS
 
@@ -71,6 +72,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 static IO_INTERFACE_DESCRIPTION* TEST_WSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1182;
 static IO_INTERFACE_DESCRIPTION* TEST_TLSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1183;
 static IO_INTERFACE_DESCRIPTION* TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1185;
+static IO_INTERFACE_DESCRIPTION* TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1186;
 
 static const IOTHUBTRANSPORT_CONFIG* saved_IoTHubTransport_AMQP_Common_Create_config;
 static AMQP_GET_IO_TRANSPORT saved_IoTHubTransport_AMQP_Common_Create_get_io_transport;
@@ -149,7 +151,7 @@ static int umocktypes_copy_WSIO_CONFIG_ptr(WSIO_CONFIG** destination, const WSIO
             {
                 (*destination)->port = (*source)->port;
                 (*destination)->underlying_io_interface = (*source)->underlying_io_interface;
-                if (umocktypes_copy("TLSIO_CONFIG*", &((*destination)->underlying_io_parameters), &((*source)->underlying_io_parameters)) != 0)
+                if (umocktypes_copy("WS_DEFLATE_IO_CONFIG*", &((*destination)->underlying_io_parameters), &((*source)->underlying_io_parameters)) != 0)
                 {
                     real_free((char*)(*destination)->resource_name);
                     real_free((char*)(*destination)->hostname);
@@ -172,7 +174,7 @@ static void umocktypes_free_WSIO_CONFIG_ptr(WSIO_CONFIG** value)
 {
     if (*value != NULL)
     {
-        umocktypes_free("TLSIO_CONFIG*", &((*value)->underlying_io_parameters));
+        umocktypes_free("WS_DEFLATE_IO_CONFIG*", &((*value)->underlying_io_parameters));
         real_free((void*)(*value)->hostname);
         real_free((void*)(*value)->resource_name);
         real_free((void*)(*value)->protocol);
@@ -247,7 +249,7 @@ static int umocktypes_are_equal_WSIO_CONFIG_ptr(WSIO_CONFIG** left, WSIO_CONFIG*
                 if ((strcmp((*left)->hostname, (*right)->hostname) != 0) ||
                     (strcmp((*left)->protocol, (*right)->protocol) != 0) ||
                     (strcmp((*left)->resource_name, (*right)->resource_name) != 0) ||
-                    (umocktypes_are_equal("TLSIO_CONFIG*", &((*left)->underlying_io_parameters), &((*right)->underlying_io_parameters)) != 1))
+                    (umocktypes_are_equal("WS_DEFLATE_IO_CONFIG*", &((*left)->underlying_io_parameters), &((*right)->underlying_io_parameters)) != 1))
                 {
                     result = 0;
                 }
@@ -262,6 +264,113 @@ static int umocktypes_are_equal_WSIO_CONFIG_ptr(WSIO_CONFIG** left, WSIO_CONFIG*
     return result;
 }
 
+static int umocktypes_copy_WS_DEFLATE_IO_CONFIG_ptr(WS_DEFLATE_IO_CONFIG** destination, const WS_DEFLATE_IO_CONFIG** source)
+{
+    int result;
+
+    if (*source == NULL)
+    {
+        *destination = NULL;
+        result = 0;
+    }
+    else
+    {
+        *destination = (WS_DEFLATE_IO_CONFIG*)real_malloc(sizeof(WS_DEFLATE_IO_CONFIG));
+        if (*destination == NULL)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            (*destination)->underlying_io_interface = (*source)->underlying_io_interface;
+            if (umocktypes_copy("TLSIO_CONFIG*", &((*destination)->underlying_io_parameters), &((*source)->underlying_io_parameters)) != 0)
+            {
+                real_free(*destination);
+                result = __LINE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void umocktypes_free_WS_DEFLATE_IO_CONFIG_ptr(WS_DEFLATE_IO_CONFIG** value)
+{
+    if (*value != NULL)
+    {
+        umocktypes_free("TLSIO_CONFIG*", &((*value)->underlying_io_parameters));
+        real_free(*value);
+    }
+}
+
+static char* umocktypes_stringify_WS_DEFLATE_IO_CONFIG_ptr(const WS_DEFLATE_IO_CONFIG** value)
+{
+    char* result;
+    if (*value == NULL)
+    {
+        result = (char*)real_malloc(5);
+        if (result != NULL)
+        {
+            (void)memcpy(result, "NULL", 5);
+        }
+    }
+    else
+    {
+        int length = snprintf(NULL, 0, "{ %p, %p }",
+            (*value)->underlying_io_interface,
+            (*value)->underlying_io_parameters);
+        if (length < 0)
+        {
+            result = NULL;
+        }
+        else
+        {
+            result = (char*)real_malloc(length + 1);
+            (void)snprintf(result, length + 1, "{ %p, %p }",
+                (*value)->underlying_io_interface,
+                (*value)->underlying_io_parameters);
+        }
+    }
+
+    return result;
+}
+
+static int umocktypes_are_equal_WS_DEFLATE_IO_CONFIG_ptr(WS_DEFLATE_IO_CONFIG** left, WS_DEFLATE_IO_CONFIG** right)
+{
+    int result;
+
+    if (*left == *right)
+    {
+        result = 1;
+    }
+    else
+    {
+        if ((*left == NULL) ||
+            (*right == NULL))
+        {
+            result = 0;
+        }
+        else
+        {
+            if (((*left)->underlying_io_interface != (*right)->underlying_io_interface) ||
+                (umocktypes_are_equal("TLSIO_CONFIG*", &((*left)->underlying_io_parameters), &((*right)->underlying_io_parameters)) != 1))
+            {
+                result = 0;
+            }
+            else
+            {
+                result = 1;
+            }
+        }
+    }
+
+    return result;
+}
+
 static int umocktypes_copy_TLSIO_CONFIG_ptr(TLSIO_CONFIG** destination, const TLSIO_CONFIG** source)
 {
     int result;
@@ -574,6 +683,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_IDENTITY_TYPE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(AMQP_GET_IO_TRANSPORT, void*);
     REGISTER_TYPE(WSIO_CONFIG*, WSIO_CONFIG_ptr);
+    REGISTER_TYPE(WS_DEFLATE_IO_CONFIG*, WS_DEFLATE_IO_CONFIG_ptr);
     REGISTER_TYPE(TLSIO_CONFIG*, TLSIO_CONFIG_ptr);
     REGISTER_TYPE(HTTP_PROXY_IO_CONFIG*, HTTP_PROXY_IO_CONFIG_ptr);
 
@@ -591,6 +701,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetSendStatus, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(wsio_get_interface_description, TEST_WSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_TLSIO_INTERFACE_DESCRIPTION);
+    REGISTER_GLOBAL_MOCK_RETURN(ws_deflate_io_get_interface_description, TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(http_proxy_io_get_interface_description, TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION);
 }
 
@@ -668,12 +779,14 @@ TEST_FUNCTION(AMQP_Create)
 /* Tests_SRS_IOTHUBTRANSPORTAMQP_WS_01_012: [ - `port` shall be set to 443. ]*/
 /* Tests_SRS_IOTHUBTRANSPORTAMQP_WS_01_013: [ - If `amqp_transport_proxy_options` is NULL, `underlying_io_interface` shall be set to NULL. ]*/
 /* Tests_SRS_IOTHUBTRANSPORTAMQP_WS_01_014: [ - If `amqp_transport_proxy_options` is NULL `underlying_io_parameters` shall be set to NULL. ]*/
+/* Tests_SRS_IOTHUBTRANSPORTAMQP_WS_41_002: [ The WebSocket IO shall be put over the permessage-deflate IO obtained with `ws_deflate_io_get_interface_description`, whose `WS_DEFLATE_IO_CONFIG` shall be given the TLS IO interface description and arguments. ]*/
 TEST_FUNCTION(AMQP_Create_getWebSocketsIOTransport_with_NULL_proxy_options_sets_up_wsio_over_tlsio_over_socketio)
 {
 	// arrange
 	TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol_over_WebSocketsTls();
     WSIO_CONFIG wsio_config;
     TLSIO_CONFIG tlsio_config;
+    WS_DEFLATE_IO_CONFIG ws_deflate_io_config;
     XIO_HANDLE underlying_io_transport;
 
 	(void)provider->IoTHubTransport_Create(TEST_IOTHUBTRANSPORT_CONFIG_HANDLE);
@@ -688,11 +801,15 @@ TEST_FUNCTION(AMQP_Create_getWebSocketsIOTransport_with_NULL_proxy_options_sets_
     wsio_config.port = 443;
     wsio_config.protocol = "AMQPWSB10";
     wsio_config.resource_name = "/$iothub/websocket";
-    wsio_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
-    wsio_config.underlying_io_parameters = &tlsio_config;
+    ws_deflate_io_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
+    ws_deflate_io_config.underlying_io_parameters = &tlsio_config;
+
+    wsio_config.underlying_io_interface = TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION;
+    wsio_config.underlying_io_parameters = &ws_deflate_io_config;
 
     STRICT_EXPECTED_CALL(wsio_get_interface_description());
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(ws_deflate_io_get_interface_description());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
 
@@ -771,6 +888,7 @@ TEST_FUNCTION(AMQP_Create_getWebSocketsIOTransport_with_proxy_options_sets_up_ws
     TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol_over_WebSocketsTls();
     WSIO_CONFIG wsio_config;
     TLSIO_CONFIG tlsio_config;
+    WS_DEFLATE_IO_CONFIG ws_deflate_io_config;
     HTTP_PROXY_IO_CONFIG http_proxy_io_config;
     XIO_HANDLE underlying_io_transport;
 
@@ -793,8 +911,11 @@ TEST_FUNCTION(AMQP_Create_getWebSocketsIOTransport_with_proxy_options_sets_up_ws
     wsio_config.port = 443;
     wsio_config.protocol = "AMQPWSB10";
     wsio_config.resource_name = "/$iothub/websocket";
-    wsio_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
-    wsio_config.underlying_io_parameters = &tlsio_config;
+    ws_deflate_io_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
+    ws_deflate_io_config.underlying_io_parameters = &tlsio_config;
+
+    wsio_config.underlying_io_interface = TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION;
+    wsio_config.underlying_io_parameters = &ws_deflate_io_config;
 
     amqp_proxy_options.host_address = "some_host";
     amqp_proxy_options.port = 444;
@@ -804,6 +925,7 @@ TEST_FUNCTION(AMQP_Create_getWebSocketsIOTransport_with_proxy_options_sets_up_ws
     STRICT_EXPECTED_CALL(wsio_get_interface_description());
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
     STRICT_EXPECTED_CALL(http_proxy_io_get_interface_description());
+    STRICT_EXPECTED_CALL(ws_deflate_io_get_interface_description());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
 
@@ -823,6 +945,7 @@ TEST_FUNCTION(when_http_proxy_io_get_interface_description_returns_NULL_AMQP_Cre
     TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol_over_WebSocketsTls();
     WSIO_CONFIG wsio_config;
     TLSIO_CONFIG tlsio_config;
+    WS_DEFLATE_IO_CONFIG ws_deflate_io_config;
     XIO_HANDLE underlying_io_transport;
 
     (void)provider->IoTHubTransport_Create(TEST_IOTHUBTRANSPORT_CONFIG_HANDLE);
@@ -837,8 +960,11 @@ TEST_FUNCTION(when_http_proxy_io_get_interface_description_returns_NULL_AMQP_Cre
     wsio_config.port = 443;
     wsio_config.protocol = "AMQPWSB10";
     wsio_config.resource_name = "/$iothub/websocket";
-    wsio_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
-    wsio_config.underlying_io_parameters = &tlsio_config;
+    ws_deflate_io_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
+    ws_deflate_io_config.underlying_io_parameters = &tlsio_config;
+
+    wsio_config.underlying_io_interface = TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION;
+    wsio_config.underlying_io_parameters = &ws_deflate_io_config;
 
     amqp_proxy_options.host_address = "some_host";
     amqp_proxy_options.port = 444;
@@ -849,6 +975,7 @@ TEST_FUNCTION(when_http_proxy_io_get_interface_description_returns_NULL_AMQP_Cre
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
     STRICT_EXPECTED_CALL(http_proxy_io_get_interface_description())
         .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(ws_deflate_io_get_interface_description());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
 
@@ -1086,6 +1213,28 @@ TEST_FUNCTION(AMQP_GetSendStatus)
 }
 
 
+// Tests_SRS_IOTHUBTRANSPORTAMQP_WS_41_001: [IoTHubTransportAMQP_WS_GetPollDescriptors shall get the sockets by calling into the IoTHubTransport_AMQP_Common_GetPollDescriptors()]
+TEST_FUNCTION(AMQP_GetPollDescriptors)
+{
+	// arrange
+	TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol_over_WebSocketsTls();
+
+	IOTHUB_CLIENT_POLL_DESCRIPTOR descriptors[1];
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(IoTHubTransport_AMQP_Common_GetPollDescriptors(TEST_TRANSPORT_LL_HANDLE, descriptors, 1))
+		.SetReturn(1);
+
+	// act
+	size_t result = provider->IoTHubTransport_GetPollDescriptors(TEST_TRANSPORT_LL_HANDLE, descriptors, 1);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 1, result);
+
+	// cleanup
+}
+
 // Tests_SRS_IOTHUBTRANSPORTAMQP_WS_09_018: [IoTHubTransportAMQP_WS_GetHostname shall get the hostname by calling into the IoTHubTransport_AMQP_Common_GetHostname()]
 TEST_FUNCTION(AMQP_GetHostname)
 {
@@ -38,6 +38,7 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "azure_c_shared_utility/sastoken.h"
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/vector_types_internal.h"
@@ -120,6 +121,9 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CON
 #define TEST_IOTHUB_SUFFIX "thisIsIotHubSuffix"
 #define TEST_IOTHUB_GWHOSTNAME "thisIsGWHostname"
 #define TEST_BLANK_SAS_TOKEN " "
+#define TEST_CACHED_SAS_TOKEN "SharedAccessSignature sr=test"
+#define TEST_SAS_TOKEN_LIFETIME 3600
+#define TEST_SAS_TOKEN_REFRESH_TIME 1800
 #define TEST_IOTHUB_CLIENT_LL_HANDLE (IOTHUB_CLIENT_LL_HANDLE)0x34333
 #define TEST_IOTHUB_CLIENT_LL_HANDLE2 (IOTHUB_CLIENT_LL_HANDLE)0x34344
 #define TEST_ETAG_VALUE_UNQUOTED "thisIsSomeETAGValueSomeGUIDMaybe"
@@ -485,6 +489,8 @@ static pfIoTHubTransport_Subscribe                      IoTHubTransportHttp_Subs
 static pfIoTHubTransport_Unsubscribe                    IoTHubTransportHttp_Unsubscribe;
 static pfIoTHubTransport_DoWork                         IoTHubTransportHttp_DoWork;
 static pfIoTHubTransport_GetSendStatus                  IoTHubTransportHttp_GetSendStatus;
+static pfIoTHubTransport_GetNextWorkDeadline            IoTHubTransportHttp_GetNextWorkDeadline;
+static pfIoTHubTransport_TrimMemory                     IoTHubTransportHttp_TrimMemory;
 
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
@@ -546,6 +552,15 @@ static void my_HTTPAPIEX_SAS_Destroy(HTTPAPIEX_SAS_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+static STRING_HANDLE my_SASToken_Create(STRING_HANDLE key, STRING_HANDLE scope, STRING_HANDLE keyName, size_t expiry)
+{
+    (void)key;
+    (void)scope;
+    (void)keyName;
+    (void)expiry;
+    return real_STRING_construct(TEST_CACHED_SAS_TOKEN);
+}
+
 static HTTPAPIEX_RESULT my_HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
 {
     (void)handle;
@@ -564,6 +579,110 @@ static HTTPAPIEX_RESULT my_HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTT
     return HTTPAPIEX_OK;
 }
 
+/*the batch split tests play a hub that answers the event requests with scripted status codes, they count the events of each
+request and what IoTHubClient_LL_SendComplete was given (and empty the list, as the client does)*/
+#define BATCH_SPLIT_MAX_REQUESTS 8
+static bool batchSplitHubEnabled;
+static unsigned int batchSplitStatusCodes[BATCH_SPLIT_MAX_REQUESTS];
+static size_t batchSplitStatusCodeCount;
+static size_t batchSplitRequestCount;
+static size_t batchSplitRequestEvents[BATCH_SPLIT_MAX_REQUESTS];
+static size_t batchSplitSendCompleteCount;
+static size_t batchSplitSendCompleteEvents[BATCH_SPLIT_MAX_REQUESTS];
+static IOTHUB_CLIENT_CONFIRMATION_RESULT batchSplitSendCompleteResults[BATCH_SPLIT_MAX_REQUESTS];
+static time_t batchSplitTime;
+
+static void startBatchSplitHub(const unsigned int* statusCodes, size_t statusCodeCount)
+{
+    size_t index;
+    batchSplitHubEnabled = true;
+    for (index = 0; index < statusCodeCount; index++)
+    {
+        batchSplitStatusCodes[index] = statusCodes[index];
+    }
+    batchSplitStatusCodeCount = statusCodeCount;
+    batchSplitRequestCount = 0;
+    batchSplitSendCompleteCount = 0;
+    batchSplitTime = 1000;
+}
+
+static size_t countBatchEvents(BUFFER_HANDLE requestContent)
+{
+    size_t result = 0;
+    const char* content = (const char*)real_BUFFER_u_char(requestContent);
+    size_t length = real_BUFFER_length(requestContent);
+    size_t index;
+    for (index = 0; index + 7 <= length; index++)
+    {
+        if (memcmp(content + index, "{\"body\"", 7) == 0)
+        {
+            result++;
+        }
+    }
+    return result;
+}
+
+static void batchSplitHubAnswer(BUFFER_HANDLE requestContent, unsigned int* statusCode)
+{
+    if (batchSplitHubEnabled && (batchSplitRequestCount < BATCH_SPLIT_MAX_REQUESTS))
+    {
+        batchSplitRequestEvents[batchSplitRequestCount] = countBatchEvents(requestContent);
+        if (batchSplitRequestCount < batchSplitStatusCodeCount)
+        {
+            *statusCode = batchSplitStatusCodes[batchSplitRequestCount];
+        }
+        batchSplitRequestCount++;
+    }
+}
+
+static void my_IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    (void)handle;
+    if (batchSplitHubEnabled && (batchSplitSendCompleteCount < BATCH_SPLIT_MAX_REQUESTS))
+    {
+        size_t eventCount = 0;
+        while (!real_DList_IsListEmpty(completed))
+        {
+            (void)real_DList_RemoveHeadList(completed);
+            eventCount++;
+        }
+        batchSplitSendCompleteEvents[batchSplitSendCompleteCount] = eventCount;
+        batchSplitSendCompleteResults[batchSplitSendCompleteCount] = result;
+        batchSplitSendCompleteCount++;
+    }
+}
+
+static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
+{
+    (void)source;
+    (void)size;
+    return batchSplitHubEnabled ? real_STRING_construct("YWJj") : NULL;
+}
+
+/*for the hub played by the batch split tests message10 is the only string event, all the others are byte arrays*/
+static IOTHUBMESSAGE_CONTENT_TYPE my_IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return (batchSplitHubEnabled && (iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_10)) ? IOTHUBMESSAGE_STRING : IOTHUBMESSAGE_BYTEARRAY;
+}
+
+static const char* my_IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    (void)iotHubMessageHandle;
+    return batchSplitHubEnabled ? "abc" : NULL;
+}
+
+/*the clock of the hub is batchSplitTime, moved by the linger tests ((time_t)-1 when the time is not available)*/
+static time_t my_get_time(time_t* currentTime)
+{
+    (void)currentTime;
+    return batchSplitHubEnabled ? batchSplitTime : 0;
+}
+
+static double my_get_difftime(time_t stopTime, time_t startTime)
+{
+    return batchSplitHubEnabled ? (double)(stopTime - startTime) : 0.0;
+}
+
 static HTTPAPIEX_RESULT my_HTTPAPIEX_SAS_ExecuteRequest(HTTPAPIEX_SAS_HANDLE sasHandle, HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHeadersHandle, BUFFER_HANDLE responseContent)
 {
     (void)sasHandle;
@@ -572,9 +691,9 @@ static HTTPAPIEX_RESULT my_HTTPAPIEX_SAS_ExecuteRequest(HTTPAPIEX_SAS_HANDLE sas
     (void)relativePath;
     (void)requestHttpHeadersHandle;
     (void)responseHeadersHandle;
-    (void)requestContent;
     (void)responseContent;
     *statusCode = 204;
+    batchSplitHubAnswer(requestContent, statusCode);
     if (last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest != NULL)
     {
         real_BUFFER_delete(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
@@ -1185,7 +1304,15 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_ExecuteRequest, HTTPAPIEX_ERROR);
     REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_SAS_ExecuteRequest, my_HTTPAPIEX_SAS_ExecuteRequest);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SendComplete, my_IoTHubClient_LL_SendComplete);
+    REGISTER_GLOBAL_MOCK_HOOK(Base64_Encode_Bytes, my_Base64_Encode_Bytes);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentType, my_IoTHubMessage_GetContentType);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetString, my_IoTHubMessage_GetString);
+    REGISTER_GLOBAL_MOCK_HOOK(get_time, my_get_time);
+    REGISTER_GLOBAL_MOCK_HOOK(get_difftime, my_get_difftime);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(SASToken_Create, my_SASToken_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(SASToken_Create, NULL);
 
     REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_FindHeaderValue, TEST_ETAG_VALUE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_FindHeaderValue, NULL);
@@ -1235,6 +1362,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     IoTHubTransportHttp_Unsubscribe = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_Unsubscribe;
     IoTHubTransportHttp_DoWork = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_DoWork;
     IoTHubTransportHttp_GetSendStatus = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_GetSendStatus;
+    IoTHubTransportHttp_GetNextWorkDeadline = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_GetNextWorkDeadline;
+    IoTHubTransportHttp_TrimMemory = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_TrimMemory;
 
     TEST_STRING_HANDLE = real_STRING_construct(TEST_STRING_DATA);
 }
@@ -1264,6 +1393,7 @@ TEST_FUNCTION_INITIALIZE(method_init)
     real_DList_InitializeListHead(&waitingToSend);
     real_DList_InitializeListHead(&waitingToSend2);
     last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest = NULL;
+    batchSplitHubEnabled = false;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -3425,6 +3555,33 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_2_registered_devices_em
     IoTHubTransportHttp_Destroy(handle);
 }
 
+//Tests_SRS_TRANSPORTMULTITHTTP_41_005: [ Each call to IoTHubTransportHttp_DoWork shall start the loop one device after the device the previous call started with, so a device whose requests are slow does not always delay the same devices. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_registered_devices_starts_with_the_next_device_succeeds)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend2));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
 //Tests_SRS_TRANSPORTMULTITHTTP_17_084: [ Otherwise, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters
 //requestType: GET
 //	relativePath : the message HTTP relative path
@@ -3546,195 +3703,1123 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     //assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+static void setupDoWorkGetMessageNoMessage(void)
+{
+    static unsigned int statusCode204 = 204;
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+}
+
+static IOTHUB_DEVICE_HANDLE setupDoWorkWithOneServiceMessageReceived(TRANSPORT_LL_HANDLE handle)
+{
+    unsigned int statusCode200 = 200;
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    return devHandle;
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_003: [ "c2d_poll_until_empty" ]
+//Tests_SRS_TRANSPORTMULTITHTTP_41_004: [ The GET following a GET that returned a message shall be allowed no matter what the value of GetMinimumPollingTime. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_c2d_poll_until_empty_polls_again_after_a_service_message)
+{
+    //arrange
+    bool pollUntilEmpty = true;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_C2D_POLL_UNTIL_EMPTY, &pollUntilEmpty));
+    (void)setupDoWorkWithOneServiceMessageReceived(handle);
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    setupDoWorkGetMessageNoMessage();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_004: [ The GET following a GET that returned a message shall be allowed no matter what the value of GetMinimumPollingTime. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_c2d_poll_until_empty_waits_after_no_service_message)
+{
+    //arrange
+    bool pollUntilEmpty = true;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_C2D_POLL_UNTIL_EMPTY, &pollUntilEmpty));
+    (void)setupDoWorkWithOneServiceMessageReceived(handle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE); /*the service has no more messages*/
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_122: [ A GET request that happens earlier than GetMinimumPollingTime shall be ignored. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_without_c2d_poll_until_empty_waits_after_a_service_message)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)setupDoWorkWithOneServiceMessageReceived(handle);
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_026: [ "c2d_polling_backoff_max" ]
+//Tests_SRS_TRANSPORTMULTITHTTP_41_028: [ If "c2d_polling_backoff_max" is not 0, a GET that returns a message shall allow the next GET at the next IoTHubTransportHttp_DoWork and bring the time between GETs back to GetMinimumPollingTime. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_c2d_polling_backoff_max_polls_again_after_a_service_message)
+{
+    //arrange
+    unsigned int backoffMax = 100;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_C2D_POLLING_BACKOFF_MAX, &backoffMax));
+    (void)setupDoWorkWithOneServiceMessageReceived(handle);
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because of the polling backoff*/
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    setupDoWorkGetMessageNoMessage();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_027: [ If "c2d_polling_backoff_max" is not 0, every GET that finds no message shall double the time until the next GET, starting from GetMinimumPollingTime, up to "c2d_polling_backoff_max" seconds. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_c2d_polling_backoff_max_doubles_the_polling_time_after_no_service_message)
+{
+    //arrange
+    unsigned int backoffMax = 100;
+    unsigned int minimumPollingTime = 10;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle;
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_C2D_POLLING_BACKOFF_MAX, &backoffMax));
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime));
+    devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE); /*the first GET finds no message*/
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because of the polling backoff*/
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG))
+        .SetReturn(15); /*more than MinimumPollingTime, less than twice it*/
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_027: [ If "c2d_polling_backoff_max" is not 0, every GET that finds no message shall double the time until the next GET, starting from GetMinimumPollingTime, up to "c2d_polling_backoff_max" seconds. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_c2d_polling_backoff_max_polls_once_the_doubled_polling_time_elapsed)
+{
+    //arrange
+    unsigned int backoffMax = 100;
+    unsigned int minimumPollingTime = 10;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle;
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_C2D_POLLING_BACKOFF_MAX, &backoffMax));
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime));
+    devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE); /*the first GET finds no message*/
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because of the polling backoff*/
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG))
+        .SetReturn(21);
+    setupDoWorkGetMessageNoMessage();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+static void setupDoWorkSendDisposition(const char* disposition_api)
+{
+    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_construct_n(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, disposition_api));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_DELETE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, NULL, NULL))
+        .IgnoreArgument_requestType()
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_006: [ "c2d_defer_disposition" ]
+//Tests_SRS_TRANSPORTMULTITHTTP_41_007: [ If "c2d_defer_disposition" is enabled, IoTHubTransportHttp_SendMessageDisposition shall queue the disposition for the next IoTHubTransportHttp_DoWork of the device and return IOTHUB_CLIENT_OK. ]
+TEST_FUNCTION(IoTHubTransportHttp_SendMessageDisposition_with_c2d_defer_disposition_queues_it)
+{
+    //arrange
+    bool deferDisposition = true;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_C2D_DEFER_DISPOSITION, &deferDisposition));
+    MESSAGE_CALLBACK_INFO* test_message = make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SendMessageDisposition(test_message, IOTHUBMESSAGE_ACCEPTED);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_009: [ Before the "ExecuteMessage" action, IoTHubTransportHttp_DoWork shall send the queued dispositions of the device in the order they were given, all of them reusing one HTTP headers instance with the User-Agent and Authorization headers and replacing only If-Match. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_c2d_defer_disposition_sends_the_queued_dispositions_with_one_headers_instance)
+{
+    //arrange
+    bool deferDisposition = true;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_C2D_DEFER_DISPOSITION, &deferDisposition));
+    (void)IoTHubTransportHttp_SendMessageDisposition(make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle), IOTHUBMESSAGE_ACCEPTED);
+    (void)IoTHubTransportHttp_SendMessageDisposition(make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle), IOTHUBMESSAGE_REJECTED);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(IGNORED_PTR_ARG, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", TEST_STRING_DATA));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN));
+    setupDoWorkSendDisposition(API_VERSION);
+    setupDoWorkSendDisposition(API_VERSION "&reject");
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_010: [ If building the HTTP headers instance fails, the dispositions shall stay queued for the next IoTHubTransportHttp_DoWork. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_c2d_defer_disposition_keeps_the_dispositions_when_HTTPHeaders_Alloc_fails)
+{
+    //arrange
+    bool deferDisposition = true;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_C2D_DEFER_DISPOSITION, &deferDisposition));
+    (void)IoTHubTransportHttp_SendMessageDisposition(make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle), IOTHUBMESSAGE_ACCEPTED);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc())
+        .SetReturn(NULL);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(IGNORED_PTR_ARG, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", TEST_STRING_DATA));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN));
+    setupDoWorkSendDisposition(API_VERSION);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+static void setupCreateCachedSasToken(bool sasTokenCreated)
+{
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*the device id*/
+    STRICT_EXPECTED_CALL(URL_EncodeString(TEST_DEVICE_ID));
+    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "/devices/"));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_empty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    if (sasTokenCreated)
+    {
+        STRICT_EXPECTED_CALL(SASToken_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_SAS_TOKEN_LIFETIME));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(SASToken_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_SAS_TOKEN_LIFETIME))
+            .SetReturn(NULL);
+    }
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+}
+
+static void setupSendAcceptWithCachedSasToken(void)
+{
+    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_construct_n(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, API_VERSION));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(IGNORED_PTR_ARG, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", TEST_STRING_DATA));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+}
+
+static void setupExecuteAcceptWithCachedSasToken(void)
+{
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*the cached SAS token*/
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_CACHED_SAS_TOKEN));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_DELETE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, NULL, NULL))
+        .IgnoreArgument_requestType()
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_012: [ "sas_token_lifetime" and "sas_token_refresh_time" ]
+//Tests_SRS_TRANSPORTMULTITHTTP_41_013: [ The cached SAS token shall be created with SASToken_Create, expiring "sas_token_lifetime" seconds from now, by the first request of the device and again by the first request "sas_token_refresh_time" seconds (or "sas_token_lifetime" seconds if smaller) after it was created. ]
+TEST_FUNCTION(IoTHubTransportHttp_SendMessageDisposition_with_sas_token_lifetime_creates_the_cached_SAS_token)
+{
+    //arrange
+    size_t sasTokenLifetime = TEST_SAS_TOKEN_LIFETIME;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_LIFETIME, &sasTokenLifetime));
+    MESSAGE_CALLBACK_INFO* test_message = make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle);
+    umock_c_reset_all_calls();
+
+    setupSendAcceptWithCachedSasToken();
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    setupCreateCachedSasToken(true);
+    setupExecuteAcceptWithCachedSasToken();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SendMessageDisposition(test_message, IOTHUBMESSAGE_ACCEPTED);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_013: [ The cached SAS token shall be created with SASToken_Create, expiring "sas_token_lifetime" seconds from now, by the first request of the device and again by the first request "sas_token_refresh_time" seconds (or "sas_token_lifetime" seconds if smaller) after it was created. ]
+TEST_FUNCTION(IoTHubTransportHttp_SendMessageDisposition_with_sas_token_lifetime_reuses_the_cached_SAS_token)
+{
+    //arrange
+    size_t sasTokenLifetime = TEST_SAS_TOKEN_LIFETIME;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_LIFETIME, &sasTokenLifetime));
+    (void)IoTHubTransportHttp_SendMessageDisposition(make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle), IOTHUBMESSAGE_ACCEPTED);
+    MESSAGE_CALLBACK_INFO* test_message = make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle);
+    umock_c_reset_all_calls();
+
+    setupSendAcceptWithCachedSasToken();
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG))
+        .SetReturn((double)(TEST_SAS_TOKEN_REFRESH_TIME - 1));
+    setupExecuteAcceptWithCachedSasToken();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SendMessageDisposition(test_message, IOTHUBMESSAGE_ACCEPTED);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_013: [ The cached SAS token shall be created with SASToken_Create, expiring "sas_token_lifetime" seconds from now, by the first request of the device and again by the first request "sas_token_refresh_time" seconds (or "sas_token_lifetime" seconds if smaller) after it was created. ]
+TEST_FUNCTION(IoTHubTransportHttp_SendMessageDisposition_with_sas_token_lifetime_refreshes_the_cached_SAS_token)
+{
+    //arrange
+    size_t sasTokenLifetime = TEST_SAS_TOKEN_LIFETIME;
+    size_t sasTokenRefreshTime = TEST_SAS_TOKEN_REFRESH_TIME;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_LIFETIME, &sasTokenLifetime));
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_REFRESH_TIME, &sasTokenRefreshTime));
+    (void)IoTHubTransportHttp_SendMessageDisposition(make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle), IOTHUBMESSAGE_ACCEPTED);
+    MESSAGE_CALLBACK_INFO* test_message = make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle);
+    umock_c_reset_all_calls();
+
+    setupSendAcceptWithCachedSasToken();
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG))
+        .SetReturn((double)TEST_SAS_TOKEN_REFRESH_TIME);
+    setupCreateCachedSasToken(true);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); /*the previous SAS token*/
+    setupExecuteAcceptWithCachedSasToken();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SendMessageDisposition(test_message, IOTHUBMESSAGE_ACCEPTED);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_014: [ If creating the SAS token fails, the previous one shall be used while it has not expired, otherwise the request shall be signed by HTTPAPIEX_SAS_ExecuteRequest. ]
+TEST_FUNCTION(IoTHubTransportHttp_SendMessageDisposition_with_sas_token_lifetime_signs_the_request_when_SASToken_Create_fails)
+{
+    //arrange
+    size_t sasTokenLifetime = TEST_SAS_TOKEN_LIFETIME;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_LIFETIME, &sasTokenLifetime));
+    MESSAGE_CALLBACK_INFO* test_message = make_transport_context_data((IOTHUB_MESSAGE_HANDLE)my_gballoc_malloc(1), handle, devHandle);
+    umock_c_reset_all_calls();
+
+    setupSendAcceptWithCachedSasToken();
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    setupCreateCachedSasToken(false);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_DELETE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, NULL, NULL))
+        .IgnoreArgument_requestType()
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SendMessageDisposition(test_message, IOTHUBMESSAGE_ACCEPTED);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+/**/
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_async_and_1_service_malloc_fails)
+{
+    //arrange
+     
+    unsigned int statusCode200 = 200;
+    unsigned int statusCode204 = 204;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
+        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+    ))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .SetReturn(TEST_ETAG_VALUE);
+
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
+        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(IGNORED_PTR_ARG, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", TEST_STRING_DATA));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
+        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_POST,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        NULL                                                /*BUFFER_HANDLE responseContent))                              */
+    ))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_async_and_2nd_service_malloc_fails)
+{
+    //arrange
+     
+    unsigned int statusCode200 = 200;
+    unsigned int statusCode204 = 204;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
+        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+    ))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .SetReturn(TEST_ETAG_VALUE);
+
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
+        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(IGNORED_PTR_ARG, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", TEST_STRING_DATA))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
+        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_POST,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        NULL                                                /*BUFFER_HANDLE responseContent))                              */
+    ))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+static TRANSPORT_LL_HANDLE createBatchingTransportWithEvents(IOTHUB_MESSAGE_LIST** events, size_t eventCount)
+{
+    bool batching = true;
+    size_t index;
+    TRANSPORT_LL_HANDLE result = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(result, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(result, OPTION_BATCHING, &batching);
+    for (index = 0; index < eventCount; index++)
+    {
+        real_DList_InsertTailList(&waitingToSend, &(events[index]->entry));
+    }
+    return result;
+}
+
+static size_t countWaitingToSend(void)
+{
+    size_t result = 0;
+    PDLIST_ENTRY current = waitingToSend.Flink;
+    while (current != &waitingToSend)
+    {
+        result++;
+        current = current->Flink;
+    }
+    return result;
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_039: [ If the http status code is 400 or 413 for a batch of more than one event, its events shall go back to waitingToSend and be sent again in batches of half its events. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batch_of_4_refused_with_400_is_sent_again_as_2)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1, &message2, &message3, &message7 };
+    unsigned int statusCodes[] = { 400, 204 };
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 4, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 0, batchSplitSendCompleteCount);
+    ASSERT_ARE_EQUAL(size_t, 4, countWaitingToSend());
+    ASSERT_IS_TRUE(waitingToSend.Flink == &(message1.entry));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestEvents[1]);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_039: [ If the http status code is 400 or 413 for a batch of more than one event, its events shall go back to waitingToSend and be sent again in batches of half its events. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_41_041: [ While the events of a refused batch are sent again, the batch shall end once it holds half the events of the last batch refused, and never hold events queued after the refused ones. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_accepted_half_of_a_refused_batch_is_confirmed_OK)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1, &message2, &message3, &message7 };
+    unsigned int statusCodes[] = { 413, 204, 204 };
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitSendCompleteCount);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitSendCompleteEvents[0]);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_OK, batchSplitSendCompleteResults[0]);
+    ASSERT_ARE_EQUAL(size_t, 2, countWaitingToSend());
+    ASSERT_IS_TRUE(waitingToSend.Flink == &(message3.entry));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 3, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestEvents[2]);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitSendCompleteCount);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_OK, batchSplitSendCompleteResults[1]);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_040: [ If the http status code is 400 or 413 for a batch of one event, IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete with that event and IOTHUB_CLIENT_CONFIRMATION_ERROR. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_single_refused_event_completes_with_ERROR)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1 };
+    unsigned int statusCodes[] = { 400 };
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitSendCompleteCount);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitSendCompleteEvents[0]);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_ERROR, batchSplitSendCompleteResults[0]);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_016: [ If "batching_send_binary_alone" is set and the oldest message in `waitingToSend` is a byte array message, `IoTHubTransportHttp_DoWork` shall send it as a NonBatched Event. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_send_binary_alone_sends_the_oldest_byte_array_event_alone)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1, &message10 };
+    unsigned int statusCodes[] = { 204 };
+    bool sendBinaryAlone = true;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING_SEND_BINARY_ALONE, &sendBinaryAlone);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 0, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, buffer1_size, real_BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitSendCompleteCount);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitSendCompleteEvents[0]);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_OK, batchSplitSendCompleteResults[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, countWaitingToSend());
+    ASSERT_IS_TRUE(waitingToSend.Flink == &(message10.entry));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_017: [ If "batching_send_binary_alone" is set, the batch shall end before the first byte array message that follows the oldest message. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_send_binary_alone_batch_ends_before_a_byte_array_event)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message10, &message1 };
+    unsigned int statusCodes[] = { 204, 204 };
+    bool sendBinaryAlone = true;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING_SEND_BINARY_ALONE, &sendBinaryAlone);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, countWaitingToSend());
+    ASSERT_IS_TRUE(waitingToSend.Flink == &(message1.entry));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 0, batchSplitRequestEvents[1]);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitSendCompleteCount);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_OK, batchSplitSendCompleteResults[1]);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_020: [ The batch shall end once it holds "batching_max_events" events. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batch_ends_at_batching_max_events)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1, &message2, &message3 };
+    unsigned int statusCodes[] = { 204, 204 };
+    size_t maxEvents = 2;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING_MAX_EVENTS, &maxEvents);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestEvents[1]);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitSendCompleteCount);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitSendCompleteEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitSendCompleteEvents[1]);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_047: [ The batch shall not grow past "batching_max_bytes" bytes (255KB - 1 byte when 0 or larger), the oldest event is always sent. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batch_does_not_grow_past_batching_max_bytes_but_sends_the_oldest_event)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1, &message2 };
+    unsigned int statusCodes[] = { 204, 204 };
+    size_t maxBytes = 1;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING_MAX_BYTES, &maxBytes);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitSendCompleteCount);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CONFIRMATION_OK, batchSplitSendCompleteResults[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, countWaitingToSend());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_021: [ If "batching_linger_time" is not 0, the batch shall be sent as soon as the queued events reach "batching_max_events" or "batching_max_bytes", or end before a byte array event when "batching_send_binary_alone" is set. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_linger_time_a_full_batch_is_sent_at_once)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1, &message2 };
+    unsigned int statusCodes[] = { 204 };
+    size_t maxEvents = 2;
+    unsigned int lingerTime = 10;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING_MAX_EVENTS, &maxEvents);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING_LINGER_TIME, &lingerTime);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_022: [ Otherwise the batch shall wait for more events until "batching_linger_time" seconds have elapsed since the first `IoTHubTransportHttp_DoWork` that held it back. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_linger_time_a_batch_that_is_not_full_waits_for_the_linger_time)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1, &message2 };
+    unsigned int statusCodes[] = { 204 };
+    unsigned int lingerTime = 10;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING_LINGER_TIME, &lingerTime);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    batchSplitTime += 9;
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 2, countWaitingToSend());
+
+    //act
+    batchSplitTime += 1;
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_023: [ If the time is not available, the batch shall be sent without lingering. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_linger_time_and_no_time_available_sends_the_batch_at_once)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1 };
+    unsigned int statusCodes[] = { 204 };
+    unsigned int lingerTime = 10;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING_LINGER_TIME, &lingerTime);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+    batchSplitTime = (time_t)(-1);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
 
     //cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-/**/
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_async_and_1_service_malloc_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_41_045: [ The content size of the events of a request, sent or not, shall be taken from the deficit, and a batch shall end before an event that does not fit in what is left of it. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_device_quantum_batch_ends_before_an_event_that_does_not_fit)
 {
     //arrange
-     
-    unsigned int statusCode200 = 200;
-    unsigned int statusCode204 = 204;
-    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-    (void)IoTHubTransportHttp_Subscribe(devHandle);
-    umock_c_reset_all_calls();
-
-    setupDoWorkLoopOnceForOneDevice();
+    IOTHUB_MESSAGE_LIST* events[] = { &message1, &message2, &message3 };
+    unsigned int statusCodes[] = { 204, 204 };
+    size_t quantum = 3;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_DEVICE_QUANTUM, &quantum);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
 
-    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
-
-    STRICT_EXPECTED_CALL(get_time(NULL));
-    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
-
-    STRICT_EXPECTED_CALL(BUFFER_new());
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
-    ))
-        .IgnoreArgument_requestType()
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, countWaitingToSend());
+    ASSERT_IS_TRUE(waitingToSend.Flink == &(message3.entry));
 
-    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
-        .SetReturn(TEST_ETAG_VALUE);
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestEvents[1]);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
 
-    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
-        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION));
-    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(IGNORED_PTR_ARG, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", TEST_STRING_DATA));
-    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN));
-    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_POST,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        NULL                                                /*BUFFER_HANDLE responseContent))                              */
-    ))
-        .IgnoreArgument_requestType()
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+//Tests_SRS_TRANSPORTMULTITHTTP_41_044: [ If "device_quantum" is not 0, each `IoTHubTransportHttp_DoWork` shall add "device_quantum" to the deficit of a device with events to send, up to "device_quantum" plus the content size of its oldest event, and skip the events of the device while that size is larger than the deficit; the deficit left shall be kept for the next `IoTHubTransportHttp_DoWork`. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_device_quantum_an_event_larger_than_the_quantum_waits_for_the_deficit)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message7 };
+    unsigned int statusCodes[] = { 204 };
+    size_t quantum = 3;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_DEVICE_QUANTUM, &quantum);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
 
-    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 1, countWaitingToSend());
 
     //act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     //assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestEvents[0]);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
 
     //cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_async_and_2nd_service_malloc_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_41_044: [ If "device_quantum" is not 0, each `IoTHubTransportHttp_DoWork` shall add "device_quantum" to the deficit of a device with events to send, up to "device_quantum" plus the content size of its oldest event, and skip the events of the device while that size is larger than the deficit; the deficit left shall be kept for the next `IoTHubTransportHttp_DoWork`. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_41_045: [ The content size of the events of a request, sent or not, shall be taken from the deficit, and a batch shall end before an event that does not fit in what is left of it. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_device_quantum_not_batched_keeps_the_deficit_left_for_the_next_DoWork)
 {
     //arrange
-     
-    unsigned int statusCode200 = 200;
-    unsigned int statusCode204 = 204;
+    unsigned int statusCodes[] = { 204, 204 };
+    size_t quantum = 2;
     TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-    (void)IoTHubTransportHttp_Subscribe(devHandle);
-    umock_c_reset_all_calls();
-
-    setupDoWorkLoopOnceForOneDevice();
-
-    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
-
-    STRICT_EXPECTED_CALL(get_time(NULL));
-    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_DEVICE_QUANTUM, &quantum);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    real_DList_InsertTailList(&waitingToSend, &(message3.entry));
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
 
-    STRICT_EXPECTED_CALL(BUFFER_new());
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
-    ))
-        .IgnoreArgument_requestType()
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 1, countWaitingToSend());
+    ASSERT_IS_TRUE(waitingToSend.Flink == &(message3.entry));
 
-    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
-        .SetReturn(TEST_ETAG_VALUE);
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
 
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-    STRICT_EXPECTED_CALL(STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
-        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION));
-    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(IGNORED_PTR_ARG, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", TEST_STRING_DATA))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_POST,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        NULL                                                /*BUFFER_HANDLE responseContent))                              */
-    ))
-        .IgnoreArgument_requestType()
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+//Tests_SRS_TRANSPORTMULTITHTTP_41_046: [ A device with no events to send shall have its deficit set to 0. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_device_quantum_a_device_without_events_loses_its_deficit)
+{
+    //arrange
+    IOTHUB_MESSAGE_LIST* events[] = { &message1 };
+    unsigned int statusCodes[] = { 204, 204 };
+    size_t quantum = 5;
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithEvents(events, sizeof(events) / sizeof(events[0]));
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_DEVICE_QUANTUM, &quantum);
+    startBatchSplitHub(statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    real_DList_InsertTailList(&waitingToSend, &(message7.entry));
 
-    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 1, countWaitingToSend());
 
     //act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     //assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, batchSplitRequestCount);
+    ASSERT_ARE_EQUAL(size_t, 0, countWaitingToSend());
 
     //cleanup
     IoTHubTransportHttp_Destroy(handle);
@@ -7831,6 +8916,9 @@ TEST_FUNCTION(HTTP_Protocol_succeeds)
     ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_Unsubscribe, (void*)IoTHubTransportHttp_Unsubscribe);
     ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_DoWork, (void*)IoTHubTransportHttp_DoWork);
     ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_GetSendStatus, (void*)IoTHubTransportHttp_GetSendStatus);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_GetNextWorkDeadline, (void*)IoTHubTransportHttp_GetNextWorkDeadline);
+    ASSERT_IS_NULL((void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_GetPollDescriptors);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_TrimMemory, (void*)IoTHubTransportHttp_TrimMemory);
     ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_SetOption, (void*)IoTHubTransportHttp_SetOption);
 
     //cleanup
@@ -9747,6 +10835,104 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_the_second_one_does_
 }
 
 
+/*** IoTHubTransportHttp_TrimMemory ***/
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_037: [ If handle is NULL, IoTHubTransportHttp_TrimMemory shall do nothing. ]
+TEST_FUNCTION(IoTHubTransportHttp_TrimMemory_with_NULL_handle_does_nothing)
+{
+    // act
+    IoTHubTransportHttp_TrimMemory(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_038: [ IoTHubTransportHttp_TrimMemory shall free the event batch buffer of every device in the transport device list, the next batch allocates it again. ]
+TEST_FUNCTION(IoTHubTransportHttp_TrimMemory_device_without_batch_buffer_frees_nothing)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+
+    // act
+    IoTHubTransportHttp_TrimMemory(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+/*** IoTHubTransportHttp_GetNextWorkDeadline ***/
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_030: [ If handle or isWaitingForNetwork is NULL, IoTHubTransportHttp_GetNextWorkDeadline shall return 0. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetNextWorkDeadline_with_NULL_handle_returns_0)
+{
+    // arrange
+    bool isWaitingForNetwork;
+
+    // act
+    uint32_t result = IoTHubTransportHttp_GetNextWorkDeadline(NULL, &isWaitingForNetwork);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, (size_t)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_031: [ IoTHubTransportHttp_GetNextWorkDeadline shall set isWaitingForNetwork to false, the requests of IoTHubTransportHttp_DoWork complete before it returns. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_41_036: [ IoTHubTransportHttp_GetNextWorkDeadline shall return the earliest deadline of the devices in the transport device list, IOTHUB_CLIENT_NO_WORK_DEADLINE if the list is empty. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetNextWorkDeadline_idle_device_returns_no_deadline)
+{
+    // arrange
+    bool isWaitingForNetwork = true;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+
+    // act
+    uint32_t result = IoTHubTransportHttp_GetNextWorkDeadline(handle, &isWaitingForNetwork);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, (size_t)IOTHUB_CLIENT_NO_WORK_DEADLINE, (size_t)result);
+    ASSERT_IS_FALSE(isWaitingForNetwork);
+
+    // cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_41_035: [ If the time is not available, IoTHubTransportHttp_GetNextWorkDeadline shall return 0. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetNextWorkDeadline_get_time_fails_returns_0)
+{
+    // arrange
+    bool isWaitingForNetwork;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn((time_t)(-1));
+
+    // act
+    uint32_t result = IoTHubTransportHttp_GetNextWorkDeadline(handle, &isWaitingForNetwork);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, (size_t)result);
+
+    // cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
 /*** IoTHubTransportHttp_GetSendStatus ***/
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_111: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter. ]
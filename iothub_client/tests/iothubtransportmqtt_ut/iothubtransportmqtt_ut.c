@@ -93,6 +93,9 @@ static pfIoTHubTransport_Unsubscribe                IoTHubTransportMqtt_Unsubscr
 static pfIoTHubTransport_DoWork                     IoTHubTransportMqtt_DoWork;
 static pfIoTHubTransport_SetRetryPolicy             IoTHubTransportMqtt_SetRetryPolicy;
 static pfIoTHubTransport_GetSendStatus              IoTHubTransportMqtt_GetSendStatus;
+static pfIoTHubTransport_GetNextWorkDeadline        IoTHubTransportMqtt_GetNextWorkDeadline;
+static pfIoTHubTransport_GetPollDescriptors         IoTHubTransportMqtt_GetPollDescriptors;
+static pfIoTHubTransport_TrimMemory                 IoTHubTransportMqtt_TrimMemory;
 static pfIoTHubTransport_Subscribe_DeviceTwin       IoTHubTransportMqtt_Subscribe_DeviceTwin;
 static pfIoTHubTransport_Unsubscribe_DeviceTwin     IoTHubTransportMqtt_Unsubscribe_DeviceTwin;
 static pfIoTHubTransport_Subscribe_DeviceMethod     IoTHubTransportMqtt_Subscribe_DeviceMethod;
@@ -306,6 +309,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_SendMessageDisposition, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_Subscribe, 0);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_GetSendStatus, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_GetNextWorkDeadline, 1000);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_GetPollDescriptors, 1);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_SetOption, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_Register, TEST_DEVICE_HANDLE);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_GetHostname, (STRING_HANDLE)0x1182);
@@ -331,6 +336,9 @@ TEST_SUITE_INITIALIZE(suite_init)
     IoTHubTransportMqtt_DoWork = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_DoWork;
     IoTHubTransportMqtt_SetRetryPolicy = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_SetRetryPolicy;
     IoTHubTransportMqtt_GetSendStatus = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_GetSendStatus;
+    IoTHubTransportMqtt_GetNextWorkDeadline = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_GetNextWorkDeadline;
+    IoTHubTransportMqtt_GetPollDescriptors = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_GetPollDescriptors;
+    IoTHubTransportMqtt_TrimMemory = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_TrimMemory;
     IoTHubTransportMqtt_Subscribe_DeviceTwin = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_Subscribe_DeviceTwin;
     IoTHubTransportMqtt_Unsubscribe_DeviceTwin = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_Unsubscribe_DeviceTwin;
     IoTHubTransportMqtt_Subscribe_DeviceMethod = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_Subscribe_DeviceMethod;
@@ -699,6 +707,72 @@ TEST_FUNCTION(IoTHubTransportMqtt_GetSendStatus_success)
     //cleanup
 }
 
+/* Tests_SRS_IOTHUB_MQTT_TRANSPORT_41_055: [ IoTHubTransportMqtt_GetNextWorkDeadline shall get the deadline by calling into the IoTHubTransport_MQTT_Common_GetNextWorkDeadline function. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_GetNextWorkDeadline_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportMqtt_Create(&config);
+    umock_c_reset_all_calls();
+
+    bool isWaitingForNetwork;
+
+    // act
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_GetNextWorkDeadline(handle, &isWaitingForNetwork));
+
+    uint32_t result = IoTHubTransportMqtt_GetNextWorkDeadline(handle, &isWaitingForNetwork);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1000, (size_t)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUB_MQTT_TRANSPORT_41_059: [ IoTHubTransportMqtt_GetPollDescriptors shall get the sockets by calling into the IoTHubTransport_MQTT_Common_GetPollDescriptors function. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_GetPollDescriptors_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportMqtt_Create(&config);
+    umock_c_reset_all_calls();
+
+    IOTHUB_CLIENT_POLL_DESCRIPTOR descriptors[1];
+
+    // act
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_GetPollDescriptors(handle, descriptors, 1));
+
+    size_t result = IoTHubTransportMqtt_GetPollDescriptors(handle, descriptors, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUB_MQTT_TRANSPORT_41_063: [ IoTHubTransportMqtt_TrimMemory shall trim the memory by calling into the IoTHubTransport_MQTT_Common_TrimMemory function. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_TrimMemory_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportMqtt_Create(&config);
+    umock_c_reset_all_calls();
+
+    // act
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_TrimMemory(handle));
+
+    IoTHubTransportMqtt_TrimMemory(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
 /* Tests_SRS_IOTHUB_MQTT_TRANSPORT_07_009: [ IoTHubTransportMqtt_SetOption shall set the options by calling into the IoTHubMqttAbstract_SetOption function. ] */
 TEST_FUNCTION(IoTHubTransportMqtt_SetOption_success)
 {
@@ -31,6 +31,7 @@ static void real_free(void* ptr)
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/http_proxy_io.h"
+#include "iothub_client_ws_deflate_io.h"
 #include "iothubtransport_mqtt_common.h"
 
 #undef ENABLE_MOCKS
@@ -56,6 +57,7 @@ static IOTHUB_DEVICE_HANDLE TEST_DEVICE_HANDLE = (IOTHUB_DEVICE_HANDLE)0x1181;
 static IO_INTERFACE_DESCRIPTION* TEST_WSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1182;
 static IO_INTERFACE_DESCRIPTION* TEST_TLSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1183;
 static IO_INTERFACE_DESCRIPTION* TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1185;
+static IO_INTERFACE_DESCRIPTION* TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1186;
 
 static IOTHUB_CLIENT_CONFIG g_iothubClientConfig = { 0 };
 static DLIST_ENTRY g_waitingToSend;
@@ -144,7 +146,7 @@ static int umocktypes_copy_WSIO_CONFIG_ptr(WSIO_CONFIG** destination, const WSIO
             {
                 (*destination)->port = (*source)->port;
                 (*destination)->underlying_io_interface = (*source)->underlying_io_interface;
-                if (umocktypes_copy("TLSIO_CONFIG*", &((*destination)->underlying_io_parameters), &((*source)->underlying_io_parameters)) != 0)
+                if (umocktypes_copy("WS_DEFLATE_IO_CONFIG*", &((*destination)->underlying_io_parameters), &((*source)->underlying_io_parameters)) != 0)
                 {
                     real_free((char*)(*destination)->resource_name);
                     real_free((char*)(*destination)->hostname);
@@ -167,7 +169,7 @@ static void umocktypes_free_WSIO_CONFIG_ptr(WSIO_CONFIG** value)
 {
     if (*value != NULL)
     {
-        umocktypes_free("TLSIO_CONFIG*", &((*value)->underlying_io_parameters));
+        umocktypes_free("WS_DEFLATE_IO_CONFIG*", &((*value)->underlying_io_parameters));
         real_free((void*)(*value)->hostname);
         real_free((void*)(*value)->resource_name);
         real_free((void*)(*value)->protocol);
@@ -242,7 +244,7 @@ static int umocktypes_are_equal_WSIO_CONFIG_ptr(WSIO_CONFIG** left, WSIO_CONFIG*
                 if ((strcmp((*left)->hostname, (*right)->hostname) != 0) ||
                     (strcmp((*left)->protocol, (*right)->protocol) != 0) ||
                     (strcmp((*left)->resource_name, (*right)->resource_name) != 0) ||
-                    (umocktypes_are_equal("TLSIO_CONFIG*", &((*left)->underlying_io_parameters), &((*right)->underlying_io_parameters)) != 1))
+                    (umocktypes_are_equal("WS_DEFLATE_IO_CONFIG*", &((*left)->underlying_io_parameters), &((*right)->underlying_io_parameters)) != 1))
                 {
                     result = 0;
                 }
@@ -257,6 +259,113 @@ static int umocktypes_are_equal_WSIO_CONFIG_ptr(WSIO_CONFIG** left, WSIO_CONFIG*
     return result;
 }
 
+static int umocktypes_copy_WS_DEFLATE_IO_CONFIG_ptr(WS_DEFLATE_IO_CONFIG** destination, const WS_DEFLATE_IO_CONFIG** source)
+{
+    int result;
+
+    if (*source == NULL)
+    {
+        *destination = NULL;
+        result = 0;
+    }
+    else
+    {
+        *destination = (WS_DEFLATE_IO_CONFIG*)real_malloc(sizeof(WS_DEFLATE_IO_CONFIG));
+        if (*destination == NULL)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            (*destination)->underlying_io_interface = (*source)->underlying_io_interface;
+            if (umocktypes_copy("TLSIO_CONFIG*", &((*destination)->underlying_io_parameters), &((*source)->underlying_io_parameters)) != 0)
+            {
+                real_free(*destination);
+                result = __LINE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void umocktypes_free_WS_DEFLATE_IO_CONFIG_ptr(WS_DEFLATE_IO_CONFIG** value)
+{
+    if (*value != NULL)
+    {
+        umocktypes_free("TLSIO_CONFIG*", &((*value)->underlying_io_parameters));
+        real_free(*value);
+    }
+}
+
+static char* umocktypes_stringify_WS_DEFLATE_IO_CONFIG_ptr(const WS_DEFLATE_IO_CONFIG** value)
+{
+    char* result;
+    if (*value == NULL)
+    {
+        result = (char*)real_malloc(5);
+        if (result != NULL)
+        {
+            (void)memcpy(result, "NULL", 5);
+        }
+    }
+    else
+    {
+        int length = snprintf(NULL, 0, "{ %p, %p }",
+            (*value)->underlying_io_interface,
+            (*value)->underlying_io_parameters);
+        if (length < 0)
+        {
+            result = NULL;
+        }
+        else
+        {
+            result = (char*)real_malloc(length + 1);
+            (void)snprintf(result, length + 1, "{ %p, %p }",
+                (*value)->underlying_io_interface,
+                (*value)->underlying_io_parameters);
+        }
+    }
+
+    return result;
+}
+
+static int umocktypes_are_equal_WS_DEFLATE_IO_CONFIG_ptr(WS_DEFLATE_IO_CONFIG** left, WS_DEFLATE_IO_CONFIG** right)
+{
+    int result;
+
+    if (*left == *right)
+    {
+        result = 1;
+    }
+    else
+    {
+        if ((*left == NULL) ||
+            (*right == NULL))
+        {
+            result = 0;
+        }
+        else
+        {
+            if (((*left)->underlying_io_interface != (*right)->underlying_io_interface) ||
+                (umocktypes_are_equal("TLSIO_CONFIG*", &((*left)->underlying_io_parameters), &((*right)->underlying_io_parameters)) != 1))
+            {
+                result = 0;
+            }
+            else
+            {
+                result = 1;
+            }
+        }
+    }
+
+    return result;
+}
+
 static int umocktypes_copy_TLSIO_CONFIG_ptr(TLSIO_CONFIG** destination, const TLSIO_CONFIG** source)
 {
     int result;
@@ -556,6 +665,9 @@ static pfIoTHubTransport_Unsubscribe                IoTHubTransportMqtt_WS_Unsub
 static pfIoTHubTransport_DoWork                     IoTHubTransportMqtt_WS_DoWork;
 static pfIoTHubTransport_SetRetryPolicy             IoTHubTransportMqtt_WS_SetRetryPolicy;
 static pfIoTHubTransport_GetSendStatus              IoTHubTransportMqtt_WS_GetSendStatus;
+static pfIoTHubTransport_GetNextWorkDeadline        IoTHubTransportMqtt_WS_GetNextWorkDeadline;
+static pfIoTHubTransport_GetPollDescriptors         IoTHubTransportMqtt_WS_GetPollDescriptors;
+static pfIoTHubTransport_TrimMemory                 IoTHubTransportMqtt_WS_TrimMemory;
 static pfIoTHubTransport_Subscribe_DeviceTwin       IoTHubTransportMqtt_WS_Subscribe_DeviceTwin;
 static pfIoTHubTransport_Unsubscribe_DeviceTwin     IoTHubTransportMqtt_WS_Unsubscribe_DeviceTwin;
 static pfIoTHubTransport_Subscribe_DeviceMethod     IoTHubTransportMqtt_WS_Subscribe_DeviceMethod;
@@ -601,6 +713,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_DISPOSITION_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RETRY_POLICY, int);
     REGISTER_TYPE(WSIO_CONFIG*, WSIO_CONFIG_ptr);
+    REGISTER_TYPE(WS_DEFLATE_IO_CONFIG*, WS_DEFLATE_IO_CONFIG_ptr);
     REGISTER_TYPE(TLSIO_CONFIG*, TLSIO_CONFIG_ptr);
     REGISTER_TYPE(HTTP_PROXY_IO_CONFIG*, HTTP_PROXY_IO_CONFIG_ptr);
 
@@ -608,6 +721,8 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_Subscribe, 0);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_GetSendStatus, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_GetNextWorkDeadline, 1000);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_GetPollDescriptors, 1);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_SetOption, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_Register, TEST_DEVICE_HANDLE);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_GetHostname, (STRING_HANDLE)0x1182);
@@ -616,6 +731,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(xio_create, TEST_XIO_HANDLE);
     REGISTER_GLOBAL_MOCK_RETURN(wsio_get_interface_description, TEST_WSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_TLSIO_INTERFACE_DESCRIPTION);
+    REGISTER_GLOBAL_MOCK_RETURN(ws_deflate_io_get_interface_description, TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(http_proxy_io_get_interface_description, TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION);
 
     /* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_07_011: [ This function shall return a pointer to a structure of type TRANSPORT_PROVIDER having the following values for its fields:
@@ -643,6 +759,9 @@ TEST_SUITE_INITIALIZE(suite_init)
     IoTHubTransportMqtt_WS_DoWork = ((TRANSPORT_PROVIDER*)MQTT_WebSocket_Protocol())->IoTHubTransport_DoWork;
     IoTHubTransportMqtt_WS_SetRetryPolicy = ((TRANSPORT_PROVIDER*)MQTT_WebSocket_Protocol())->IoTHubTransport_SetRetryPolicy;
     IoTHubTransportMqtt_WS_GetSendStatus = ((TRANSPORT_PROVIDER*)MQTT_WebSocket_Protocol())->IoTHubTransport_GetSendStatus;
+    IoTHubTransportMqtt_WS_GetNextWorkDeadline = ((TRANSPORT_PROVIDER*)MQTT_WebSocket_Protocol())->IoTHubTransport_GetNextWorkDeadline;
+    IoTHubTransportMqtt_WS_GetPollDescriptors = ((TRANSPORT_PROVIDER*)MQTT_WebSocket_Protocol())->IoTHubTransport_GetPollDescriptors;
+    IoTHubTransportMqtt_WS_TrimMemory = ((TRANSPORT_PROVIDER*)MQTT_WebSocket_Protocol())->IoTHubTransport_TrimMemory;
     IoTHubTransportMqtt_WS_Subscribe_DeviceTwin = ((TRANSPORT_PROVIDER*)MQTT_WebSocket_Protocol())->IoTHubTransport_Subscribe_DeviceTwin;
     IoTHubTransportMqtt_WS_Unsubscribe_DeviceTwin = ((TRANSPORT_PROVIDER*)MQTT_WebSocket_Protocol())->IoTHubTransport_Unsubscribe_DeviceTwin;
     IoTHubTransportMqtt_WS_Subscribe_DeviceMethod = ((TRANSPORT_PROVIDER*)MQTT_WebSocket_Protocol())->IoTHubTransport_Subscribe_DeviceMethod;
@@ -718,6 +837,7 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_Create_success)
 /* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_01_012: [ - `port` shall be set to 443. ]*/
 /* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_01_013: [ - If `mqtt_transport_proxy_options` is NULL, `underlying_io_interface` shall be set to NULL ]*/
 /* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_01_014: [ - If `mqtt_transport_proxy_options` is NULL `underlying_io_parameters` shall be set to NULL. ]*/
+/* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_004: [ The WebSocket IO shall be put over the permessage-deflate IO obtained with `ws_deflate_io_get_interface_description`, whose `WS_DEFLATE_IO_CONFIG` shall be given the TLS IO interface description and arguments. ]*/
 TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_with_NULL_uses_a_socket_IO)
 {
     // arrange
@@ -725,6 +845,7 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_with_NULL_uses_a_s
     XIO_HANDLE xioTest;
     WSIO_CONFIG wsio_config;
     TLSIO_CONFIG tlsio_config;
+    WS_DEFLATE_IO_CONFIG ws_deflate_io_config;
     SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
     (void)IoTHubTransportMqtt_WS_Create(&config);
     umock_c_reset_all_calls();
@@ -738,11 +859,15 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_with_NULL_uses_a_s
     wsio_config.port = 443;
     wsio_config.protocol = "MQTT";
     wsio_config.resource_name = "/$iothub/websocket";
-    wsio_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
-    wsio_config.underlying_io_parameters = &tlsio_config;
+    ws_deflate_io_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
+    ws_deflate_io_config.underlying_io_parameters = &tlsio_config;
+
+    wsio_config.underlying_io_interface = TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION;
+    wsio_config.underlying_io_parameters = &ws_deflate_io_config;
 
     STRICT_EXPECTED_CALL(wsio_get_interface_description());
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(ws_deflate_io_get_interface_description());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
 
@@ -770,6 +895,7 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_with_proxy_setting
     MQTT_TRANSPORT_PROXY_OPTIONS mqtt_proxy_options;
     WSIO_CONFIG wsio_config;
     TLSIO_CONFIG tlsio_config;
+    WS_DEFLATE_IO_CONFIG ws_deflate_io_config;
     HTTP_PROXY_IO_CONFIG http_proxy_io_config;
     XIO_HANDLE xioTest;
     SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
@@ -792,8 +918,11 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_with_proxy_setting
     wsio_config.port = 443;
     wsio_config.protocol = "MQTT";
     wsio_config.resource_name = "/$iothub/websocket";
-    wsio_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
-    wsio_config.underlying_io_parameters = &tlsio_config;
+    ws_deflate_io_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
+    ws_deflate_io_config.underlying_io_parameters = &tlsio_config;
+
+    wsio_config.underlying_io_interface = TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION;
+    wsio_config.underlying_io_parameters = &ws_deflate_io_config;
 
     mqtt_proxy_options.host_address = "some_host";
     mqtt_proxy_options.port = 444;
@@ -803,6 +932,7 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_with_proxy_setting
     STRICT_EXPECTED_CALL(wsio_get_interface_description());
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
     STRICT_EXPECTED_CALL(http_proxy_io_get_interface_description());
+    STRICT_EXPECTED_CALL(ws_deflate_io_get_interface_description());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
 
@@ -824,6 +954,7 @@ TEST_FUNCTION(when_socket_io_interface_is_NULL_getWebSocketsIOTransport_with_pro
     MQTT_TRANSPORT_PROXY_OPTIONS mqtt_proxy_options;
     WSIO_CONFIG wsio_config;
     TLSIO_CONFIG tlsio_config;
+    WS_DEFLATE_IO_CONFIG ws_deflate_io_config;
     HTTP_PROXY_IO_CONFIG http_proxy_io_config;
     XIO_HANDLE xioTest;
     SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
@@ -846,8 +977,11 @@ TEST_FUNCTION(when_socket_io_interface_is_NULL_getWebSocketsIOTransport_with_pro
     wsio_config.port = 443;
     wsio_config.protocol = "MQTT";
     wsio_config.resource_name = "/$iothub/websocket";
-    wsio_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
-    wsio_config.underlying_io_parameters = &tlsio_config;
+    ws_deflate_io_config.underlying_io_interface = TEST_TLSIO_INTERFACE_DESCRIPTION;
+    ws_deflate_io_config.underlying_io_parameters = &tlsio_config;
+
+    wsio_config.underlying_io_interface = TEST_WS_DEFLATE_IO_INTERFACE_DESCRIPTION;
+    wsio_config.underlying_io_parameters = &ws_deflate_io_config;
 
     mqtt_proxy_options.host_address = "some_host";
     mqtt_proxy_options.port = 444;
@@ -858,6 +992,7 @@ TEST_FUNCTION(when_socket_io_interface_is_NULL_getWebSocketsIOTransport_with_pro
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
     STRICT_EXPECTED_CALL(http_proxy_io_get_interface_description())
         .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(ws_deflate_io_get_interface_description());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
 
@@ -1092,6 +1227,72 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_GetSendStatus_success)
     //cleanup
 }
 
+/* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_001: [ IoTHubTransportMqtt_WS_GetNextWorkDeadline shall get the deadline by calling into the IoTHubTransport_MQTT_Common_GetNextWorkDeadline function. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_WS_GetNextWorkDeadline_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportMqtt_WS_Create(&config);
+    umock_c_reset_all_calls();
+
+    bool isWaitingForNetwork;
+
+    // act
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_GetNextWorkDeadline(handle, &isWaitingForNetwork));
+
+    uint32_t result = IoTHubTransportMqtt_WS_GetNextWorkDeadline(handle, &isWaitingForNetwork);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1000, (size_t)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_002: [ IoTHubTransportMqtt_WS_GetPollDescriptors shall get the sockets by calling into the IoTHubTransport_MQTT_Common_GetPollDescriptors function. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_WS_GetPollDescriptors_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportMqtt_WS_Create(&config);
+    umock_c_reset_all_calls();
+
+    IOTHUB_CLIENT_POLL_DESCRIPTOR descriptors[1];
+
+    // act
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_GetPollDescriptors(handle, descriptors, 1));
+
+    size_t result = IoTHubTransportMqtt_WS_GetPollDescriptors(handle, descriptors, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_003: [ IoTHubTransportMqtt_WS_TrimMemory shall trim the memory by calling into the IoTHubTransport_MQTT_Common_TrimMemory function. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_WS_TrimMemory_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportMqtt_WS_Create(&config);
+    umock_c_reset_all_calls();
+
+    // act
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_TrimMemory(handle));
+
+    IoTHubTransportMqtt_WS_TrimMemory(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
 /* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_07_009: [ IoTHubTransportMqtt_WS_SetOption shall set the options by calling into the IoTHubMqttAbstract_SetOption function. ] */
 TEST_FUNCTION(IoTHubTransportMqtt_WS_SetOption_success)
 {
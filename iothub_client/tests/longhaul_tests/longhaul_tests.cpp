@@ -6,6 +6,9 @@
 #include <cstddef>
 #include <cstdbool>
 #include <limits.h>
+#include <cstdio>
+#include <ctime>
+#include <cstdint>
 #include "testrunnerswitcher.h"
 #include "micromock.h"
 #include "micromockcharstararenullterminatedstrings.h"
@@ -22,6 +25,12 @@
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 
 #ifdef MBED_BUILD_TIMESTAMP
@@ -83,12 +92,295 @@ typedef struct LONGHAUL_SEND_STATISTICS_TAG
 	double avgEventTravelTime;
 } LONGHAUL_SEND_STATISTICS;
 
+// Metrics are sampled every LONGHAUL_METRICS_INTERVAL_IN_SEC seconds (default 60) and written as one CSV line (or one JSON
+// object per line, if LONGHAUL_METRICS_FORMAT is "json") to the file named by LONGHAUL_METRICS_FILE, or to stdout.
+// heap_in_use and heap_peak come from gballoc and are -1 unless the SDK is built with GB_MEASURE_MEMORY_FOR_THIS (always on
+// Windows, with -Drun_perf_tests=ON elsewhere); rss_kb is -1 outside Linux. A growing heap_in_use is a leak, rss_kb growing
+// faster than heap_in_use is fragmentation.
+#define DEFAULT_METRICS_INTERVAL_IN_SECONDS 60
+
+static const char* METRICS_CSV_HEADER = "test,time_utc,elapsed_s,messages,latency_samples,latency_p50_ms,latency_p90_ms,latency_p99_ms,latency_max_ms,reconnects,cpu_s,heap_in_use,heap_peak,rss_kb";
+
+static TICK_COUNTER_HANDLE g_tickCounter = NULL;
+
+typedef struct LONGHAUL_METRICS_TAG
+{
+	const char* testName;
+	FILE* output;
+	bool json;
+	int intervalInSeconds;
+	time_t startTime;
+	time_t lastSampleTime;
+	unsigned long messageCount;
+	unsigned long reconnectCount;
+	bool wasConnected;
+	tickcounter_ms_t* latencies;
+	size_t latencyCount;
+	size_t latencyCapacity;
+	LOCK_HANDLE lock;
+} LONGHAUL_METRICS;
+
+static tickcounter_ms_t getCurrentTimeInMs(void)
+{
+	tickcounter_ms_t now = 0;
+
+	if (g_tickCounter == NULL || tickcounter_get_current_ms(g_tickCounter, &now) != 0)
+	{
+		LogError("Failed getting the current time in ms (tickcounter_get_current_ms failed)");
+	}
+
+	return now;
+}
+
+static long getRssInKb(void)
+{
+	long result = -1;
+#ifdef __linux__
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm != NULL)
+	{
+		long totalPages;
+		long residentPages;
+		if (fscanf(statm, "%ld %ld", &totalPages, &residentPages) == 2)
+		{
+			result = residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+		}
+		(void)fclose(statm);
+	}
+#endif
+	return result;
+}
+
+static long long getHeapMetric(size_t value)
+{
+	// gballoc answers SIZE_MAX when it is not initialized
+	return (value == SIZE_MAX) ? -1 : (long long)value;
+}
+
+static int compareLatencies(const void* left, const void* right)
+{
+	tickcounter_ms_t leftLatency = *(const tickcounter_ms_t*)left;
+	tickcounter_ms_t rightLatency = *(const tickcounter_ms_t*)right;
+	return (leftLatency < rightLatency) ? -1 : ((leftLatency > rightLatency) ? 1 : 0);
+}
+
+// nearest rank percentile of the sorted latencies of the interval
+static unsigned long getLatencyPercentile(const LONGHAUL_METRICS* metrics, double percentile)
+{
+	unsigned long result;
+
+	if (metrics->latencyCount == 0)
+	{
+		result = 0;
+	}
+	else
+	{
+		size_t rank = (size_t)(percentile * metrics->latencyCount / 100.0 + 0.999999);
+		if (rank == 0)
+		{
+			rank = 1;
+		}
+		else if (rank > metrics->latencyCount)
+		{
+			rank = metrics->latencyCount;
+		}
+		result = (unsigned long)metrics->latencies[rank - 1];
+	}
+
+	return result;
+}
+
+static void ConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* userContextCallback)
+{
+	LONGHAUL_METRICS* metrics = (LONGHAUL_METRICS*)userContextCallback;
+
+	LogInfo("Connection status changed (status: %s, reason: %s)", ENUM_TO_STRING(IOTHUB_CLIENT_CONNECTION_STATUS, status), ENUM_TO_STRING(IOTHUB_CLIENT_CONNECTION_STATUS_REASON, reason));
+
+	if (Lock(metrics->lock) != LOCK_OK)
+	{
+		LogError("Unable to lock on ConnectionStatusCallback()");
+	}
+	else
+	{
+		if (status == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED)
+		{
+			// the first authentication is the connection, the next ones are reconnections
+			if (metrics->wasConnected)
+			{
+				metrics->reconnectCount++;
+			}
+			metrics->wasConnected = true;
+		}
+		(void)Unlock(metrics->lock);
+	}
+}
+
+static int initializeMetrics(LONGHAUL_METRICS* metrics, const char* testName)
+{
+	int result;
+
+	(void)memset(metrics, 0, sizeof(LONGHAUL_METRICS));
+	metrics->testName = testName;
+	metrics->output = stdout;
+	metrics->intervalInSeconds = DEFAULT_METRICS_INTERVAL_IN_SECONDS;
+
+#ifndef MBED_BUILD_TIMESTAMP
+	char* fileName = getenv("LONGHAUL_METRICS_FILE");
+	char* format = getenv("LONGHAUL_METRICS_FORMAT");
+	char* interval = getenv("LONGHAUL_METRICS_INTERVAL_IN_SEC");
+
+	metrics->json = (format != NULL && strcmp(format, "json") == 0);
+	if (interval != NULL && atoi(interval) > 0)
+	{
+		metrics->intervalInSeconds = atoi(interval);
+	}
+	if (fileName != NULL && *fileName != '\0')
+	{
+		// the file is appended to, so one file can hold every test of the run
+		if ((metrics->output = fopen(fileName, "a")) == NULL)
+		{
+			LogError("Failed opening %s for the metrics, writing them to stdout", fileName);
+			metrics->output = stdout;
+		}
+	}
+#endif
+
+	if ((metrics->lock = Lock_Init()) == NULL)
+	{
+		LogError("Failed initializing the lock of the metrics.");
+		result = __FAILURE__;
+	}
+	else if ((metrics->startTime = time(NULL)) == INDEFINITE_TIME)
+	{
+		LogError("Failed setting the start time of the metrics (time(NULL) failed).");
+		(void)Lock_Deinit(metrics->lock);
+		result = __FAILURE__;
+	}
+	else
+	{
+		metrics->lastSampleTime = metrics->startTime;
+		if (!metrics->json)
+		{
+			(void)fprintf(metrics->output, "%s\r\n", METRICS_CSV_HEADER);
+		}
+		result = 0;
+	}
+
+	if (result != 0 && metrics->output != stdout)
+	{
+		(void)fclose(metrics->output);
+	}
+
+	return result;
+}
+
+static void recordMessageLatency(LONGHAUL_METRICS* metrics, tickcounter_ms_t latency)
+{
+	metrics->messageCount++;
+
+	if (metrics->latencyCount == metrics->latencyCapacity)
+	{
+		size_t newCapacity = (metrics->latencyCapacity == 0) ? 256 : metrics->latencyCapacity * 2;
+		tickcounter_ms_t* newLatencies = (tickcounter_ms_t*)realloc(metrics->latencies, newCapacity * sizeof(tickcounter_ms_t));
+		if (newLatencies == NULL)
+		{
+			LogError("Failed growing the latency samples (realloc failed), the sample is dropped");
+			return;
+		}
+		metrics->latencies = newLatencies;
+		metrics->latencyCapacity = newCapacity;
+	}
+
+	metrics->latencies[metrics->latencyCount++] = latency;
+}
+
+static void writeMetrics(LONGHAUL_METRICS* metrics, time_t now)
+{
+	char timeUtc[32];
+	unsigned long reconnectCount = 0;
+	struct tm* utc = gmtime(&now);
+
+	if (utc == NULL || strftime(timeUtc, sizeof(timeUtc), "%Y-%m-%dT%H:%M:%SZ", utc) == 0)
+	{
+		timeUtc[0] = '\0';
+	}
+
+	if (Lock(metrics->lock) != LOCK_OK)
+	{
+		LogError("Unable to lock to read the reconnection count.");
+	}
+	else
+	{
+		reconnectCount = metrics->reconnectCount;
+		(void)Unlock(metrics->lock);
+	}
+
+	qsort(metrics->latencies, metrics->latencyCount, sizeof(tickcounter_ms_t), compareLatencies);
+
+	(void)fprintf(metrics->output,
+		metrics->json ?
+			"{\"test\":\"%s\",\"time_utc\":\"%s\",\"elapsed_s\":%.0f,\"messages\":%lu,\"latency_samples\":%lu,\"latency_p50_ms\":%lu,\"latency_p90_ms\":%lu,\"latency_p99_ms\":%lu,\"latency_max_ms\":%lu,\"reconnects\":%lu,\"cpu_s\":%.3f,\"heap_in_use\":%lld,\"heap_peak\":%lld,\"rss_kb\":%ld}\r\n" :
+			"%s,%s,%.0f,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.3f,%lld,%lld,%ld\r\n",
+		metrics->testName,
+		timeUtc,
+		difftime(now, metrics->startTime),
+		metrics->messageCount,
+		(unsigned long)metrics->latencyCount,
+		getLatencyPercentile(metrics, 50.0),
+		getLatencyPercentile(metrics, 90.0),
+		getLatencyPercentile(metrics, 99.0),
+		getLatencyPercentile(metrics, 100.0),
+		reconnectCount,
+		(double)clock() / CLOCKS_PER_SEC,
+		getHeapMetric(gballoc_getCurrentMemoryUsed()),
+		getHeapMetric(gballoc_getMaximumMemoryUsed()),
+		getRssInKb());
+	(void)fflush(metrics->output);
+
+	// percentiles are per interval, so a drift shows instead of being averaged away
+	metrics->latencyCount = 0;
+	metrics->lastSampleTime = now;
+}
+
+static void sampleMetrics(LONGHAUL_METRICS* metrics)
+{
+	time_t now;
+
+	if ((now = time(NULL)) == INDEFINITE_TIME)
+	{
+		LogError("Failed sampling the metrics (time(NULL) failed)");
+	}
+	else if (difftime(now, metrics->lastSampleTime) >= metrics->intervalInSeconds)
+	{
+		writeMetrics(metrics, now);
+	}
+}
+
+static void deinitializeMetrics(LONGHAUL_METRICS* metrics)
+{
+	time_t now;
+
+	// the last, partial, interval
+	if ((now = time(NULL)) != INDEFINITE_TIME)
+	{
+		writeMetrics(metrics, now);
+	}
+
+	if (metrics->output != stdout)
+	{
+		(void)fclose(metrics->output);
+	}
+	free(metrics->latencies);
+	(void)Lock_Deinit(metrics->lock);
+}
+
 typedef struct LONGHAUL_SEND_TEST_STATE_TAG
 {
 	const LONGHAUL_SEND_TEST_PROFILE* profile;
 	int sendFrequencyIndex;
 	double timeUntilNextSendEventInSeconds;
 	LONGHAUL_SEND_STATISTICS statistics;
+	LONGHAUL_METRICS* metrics;
 } LONGHAUL_SEND_TEST_STATE;
 
 typedef struct LONGHAUL_RECEIVE_TEST_STATE_TAG
@@ -97,6 +389,7 @@ typedef struct LONGHAUL_RECEIVE_TEST_STATE_TAG
 	int receiveFrequencyIndex;
 	double timeUntilNextReceiveMessageInSeconds;
 	LONGHAUL_RECEIVE_STATISTICS statistics;
+	LONGHAUL_METRICS* metrics;
 } LONGHAUL_RECEIVE_TEST_STATE;
 
 typedef struct EXPECTED_SEND_DATA_TAG
@@ -106,6 +399,8 @@ typedef struct EXPECTED_SEND_DATA_TAG
 	bool dataWasSent;
 	time_t timeSent;
 	time_t timeReceived;
+	tickcounter_ms_t timeEnqueuedInMs;
+	tickcounter_ms_t timeConfirmedInMs;
 	LOCK_HANDLE lock;
 } EXPECTED_SEND_DATA;
 
@@ -116,6 +411,8 @@ typedef struct EXPECTED_RECEIVE_DATA_TAG
 	bool receivedByClient;
 	time_t timeSent;
 	time_t timeReceived;
+	tickcounter_ms_t timeSentInMs;
+	tickcounter_ms_t timeReceivedInMs;
 	LOCK_HANDLE lock;
 } EXPECTED_RECEIVE_DATA;
 
@@ -174,6 +471,7 @@ static void SendConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, v
 			else
 			{
 				expectedData->dataWasSent = true;
+				expectedData->timeConfirmedInMs = getCurrentTimeInMs();
 
 				if ((expectedData->timeSent = time(NULL)) == INDEFINITE_TIME)
 				{
@@ -573,6 +871,7 @@ static IOTHUBMESSAGE_DISPOSITION_RESULT ReceiveMessageCallback(IOTHUB_MESSAGE_HA
 					if (size == 0)
 					{
 						notifyData->receivedByClient = true;
+						notifyData->timeReceivedInMs = getCurrentTimeInMs();
 
 						if ((notifyData->timeReceived = time(NULL)) == INDEFINITE_TIME)
 						{
@@ -595,6 +894,7 @@ static IOTHUBMESSAGE_DISPOSITION_RESULT ReceiveMessageCallback(IOTHUB_MESSAGE_HA
 						if ((size == notifyData->dataSize) && (memcmp(notifyData->data, buffer, size) == 0))
 						{
 							notifyData->receivedByClient = true;
+							notifyData->timeReceivedInMs = getCurrentTimeInMs();
 
 							if ((notifyData->timeReceived = time(NULL)) == INDEFINITE_TIME)
 							{
@@ -685,6 +985,8 @@ static int sendEventLoop(IOTHUB_CLIENT_HANDLE iotHubClientHandle, LONGHAUL_SEND_
 						}
 						else
 						{
+							sendData->timeEnqueuedInMs = getCurrentTimeInMs();
+
 							if (IoTHubClient_SendEventAsync(iotHubClientHandle, msgHandle, SendConfirmationCallback, sendData) != IOTHUB_CLIENT_OK)
 							{
 								LogError("Call to IoTHubClient_SendEventAsync failed.");
@@ -736,6 +1038,8 @@ static int sendEventLoop(IOTHUB_CLIENT_HANDLE iotHubClientHandle, LONGHAUL_SEND_
 									}
 									else
 									{
+										recordMessageLatency(test_state->metrics, sendData->timeConfirmedInMs - sendData->timeEnqueuedInMs);
+
 #ifdef MBED_BUILD_TIMESTAMP
 										if (verifyEventReceivedByHub(sendData) != 0)
 										{
@@ -769,6 +1073,8 @@ static int sendEventLoop(IOTHUB_CLIENT_HANDLE iotHubClientHandle, LONGHAUL_SEND_
 
 				ThreadAPI_Sleep(500);
 
+				sampleMetrics(test_state->metrics);
+
 				if ((loopIterationEndTimeInSeconds = time(NULL)) == INDEFINITE_TIME)
 				{
 					LogError("Failed setting the end time of the send loop iteration (time(NULL) failed)");
@@ -860,7 +1166,8 @@ static int receiveMessageLoop(IOTHUB_CLIENT_HANDLE iotHubClientHandle, LONGHAUL_
 							LogError("Call to IoTHubClient_SetMessageCallback failed.");
 							result = __FAILURE__;
 						}
-						else if ((sendResult = IoTHubTest_SendMessage(iotHubTestHandle, (const unsigned char*)receiveData->data, receiveData->dataSize)) != IOTHUB_TEST_CLIENT_OK)
+						else if ((receiveData->timeSentInMs = getCurrentTimeInMs()),
+							(sendResult = IoTHubTest_SendMessage(iotHubTestHandle, (const unsigned char*)receiveData->data, receiveData->dataSize)) != IOTHUB_TEST_CLIENT_OK)
 						{
 							LogError("Call to IoTHubTest_SendMessage failed (%i).", sendResult);
 							result = __FAILURE__;
@@ -917,6 +1224,7 @@ static int receiveMessageLoop(IOTHUB_CLIENT_HANDLE iotHubClientHandle, LONGHAUL_
 									}
 									else
 									{
+										recordMessageLatency(test_state->metrics, receiveData->timeReceivedInMs - receiveData->timeSentInMs);
 #ifndef MBED_BUILD_TIMESTAMP
 										computeReceiveStatistics(&test_state->statistics, receiveData);
 #endif
@@ -934,6 +1242,8 @@ static int receiveMessageLoop(IOTHUB_CLIENT_HANDLE iotHubClientHandle, LONGHAUL_
 
 				ThreadAPI_Sleep(500);
 
+				sampleMetrics(test_state->metrics);
+
 				if ((loopIterationEndTimeInSeconds = time(NULL)) == INDEFINITE_TIME)
 				{
 					LogError("Failed setting the end time of the receive loop iteration (time(NULL) failed)");
@@ -963,7 +1273,9 @@ static int runLongHaulSendTest(const LONGHAUL_SEND_TEST_PROFILE* testProfile)
 	int result;
 
 	LONGHAUL_SEND_TEST_STATE test_state;
+	LONGHAUL_METRICS metrics;
 	test_state.profile = testProfile;
+	test_state.metrics = &metrics;
 	test_state.sendFrequencyIndex = 0;
 	test_state.timeUntilNextSendEventInSeconds = 0;
 	
@@ -983,11 +1295,24 @@ static int runLongHaulSendTest(const LONGHAUL_SEND_TEST_PROFILE* testProfile)
 	iotHubConfig.deviceSasToken = NULL;
 	iotHubConfig.protocolGatewayHostName = NULL;
 
-	if ((iotHubClientHandle = IoTHubClient_Create(&iotHubConfig)) == NULL)
+	bool metricsInitialized = (initializeMetrics(&metrics, testProfile->name) == 0);
+
+	if (!metricsInitialized)
+	{
+		LogError("Failed initializing the metrics.");
+		iotHubClientHandle = NULL;
+		result = __FAILURE__;
+	}
+	else if ((iotHubClientHandle = IoTHubClient_Create(&iotHubConfig)) == NULL)
 	{
 		LogError("Failed creating the IoT Hub Client.");
 		result = __FAILURE__;
 	}
+	else if (IoTHubClient_SetConnectionStatusCallback(iotHubClientHandle, ConnectionStatusCallback, &metrics) != IOTHUB_CLIENT_OK)
+	{
+		LogError("Failed setting the connection status callback.");
+		result = __FAILURE__;
+	}
 #ifdef MBED_BUILD_TIMESTAMP
 	else if ((client_result = IoTHubClient_SetOption(iotHubClientHandle, "TrustedCerts", certificates)) != IOTHUB_CLIENT_OK)
 	{
@@ -1005,6 +1330,11 @@ static int runLongHaulSendTest(const LONGHAUL_SEND_TEST_PROFILE* testProfile)
 		IoTHubClient_Destroy(iotHubClientHandle);
 	}
 
+	if (metricsInitialized)
+	{
+		deinitializeMetrics(&metrics);
+	}
+
 	LogInfo("Long Haul send test \"%s\" completed (result=%d)", test_state.profile->name, result);
 
 	return result;
@@ -1015,7 +1345,9 @@ static int runLongHaulReceiveTest(const LONGHAUL_RECEIVE_TEST_PROFILE* testProfi
 	int result;
 
 	LONGHAUL_RECEIVE_TEST_STATE test_state;
+	LONGHAUL_METRICS metrics;
 	test_state.profile = testProfile;
+	test_state.metrics = &metrics;
 	test_state.receiveFrequencyIndex = 0;
 	test_state.timeUntilNextReceiveMessageInSeconds = 0;
 
@@ -1035,11 +1367,24 @@ static int runLongHaulReceiveTest(const LONGHAUL_RECEIVE_TEST_PROFILE* testProfi
 	iotHubConfig.deviceSasToken = NULL;
 	iotHubConfig.protocolGatewayHostName = NULL;
 
-	if ((iotHubClientHandle = IoTHubClient_Create(&iotHubConfig)) == NULL)
+	bool metricsInitialized = (initializeMetrics(&metrics, testProfile->name) == 0);
+
+	if (!metricsInitialized)
+	{
+		LogError("Failed initializing the metrics.");
+		iotHubClientHandle = NULL;
+		result = __FAILURE__;
+	}
+	else if ((iotHubClientHandle = IoTHubClient_Create(&iotHubConfig)) == NULL)
 	{
 		LogError("Failed creating the IoT Hub Client.");
 		result = __FAILURE__;
 	}
+	else if (IoTHubClient_SetConnectionStatusCallback(iotHubClientHandle, ConnectionStatusCallback, &metrics) != IOTHUB_CLIENT_OK)
+	{
+		LogError("Failed setting the connection status callback.");
+		result = __FAILURE__;
+	}
 #ifdef MBED_BUILD_TIMESTAMP
 	else if ((client_result = IoTHubClient_SetOption(iotHubClientHandle, "TrustedCerts", certificates)) != IOTHUB_CLIENT_OK)
 	{
@@ -1057,6 +1402,11 @@ static int runLongHaulReceiveTest(const LONGHAUL_RECEIVE_TEST_PROFILE* testProfi
 		IoTHubClient_Destroy(iotHubClientHandle);
 	}
 
+	if (metricsInitialized)
+	{
+		deinitializeMetrics(&metrics);
+	}
+
 	LogInfo("Long Haul receive test \"%s\" completed (result=%d)", test_state.profile->name, result);
 
 	return result;
@@ -1069,7 +1419,14 @@ BEGIN_TEST_SUITE(longhaul_tests)
 	{
                 TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
 
-		if (platform_init() != 0)
+		// first, so every allocation of the SDK is counted by the heap_in_use metric
+		(void)gballoc_init();
+
+		if ((g_tickCounter = tickcounter_create()) == NULL)
+		{
+			ASSERT_FAIL("Failed creating the tick counter of the metrics.");
+		}
+		else if (platform_init() != 0)
 		{
 			ASSERT_FAIL("Failed initializing uAMQP platform (1st call).");
 		}
@@ -1097,6 +1454,8 @@ BEGIN_TEST_SUITE(longhaul_tests)
 		platform_deinit();
 		TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
 		platform_deinit();
+		tickcounter_destroy(g_tickCounter);
+		gballoc_deinit();
 	}
 
 	TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
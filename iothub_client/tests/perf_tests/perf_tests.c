@@ -0,0 +1,438 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "testrunnerswitcher.h"
+
+#include "iothub_client_ll.h"
+#include "iothub_message.h"
+#include "iothub_transport_ll.h"
+#include "iothubtransport_mqtt_common.h"
+#include "iothubtransportmqtt.h"
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/xio.h"
+
+/* The perf tests run the client over a loopback IO that plays the part of the hub, so what is measured is the SDK alone:
+   the CPU time spent per message (clock), the heap allocations per message (gballoc, counted by wrapping its entry points
+   at link time where the linker supports it) and the peak heap. Every transport that can be given a loopback IO has an
+   entry in PERF_TRANSPORTS; each one runs the same fixed message mix so the numbers can be compared from one commit to the
+   next. */
+
+#define PERF_MESSAGES_PER_MIX 1000
+#define PERF_MAX_DOWORK_PER_MESSAGE 100
+#define PERF_LOOPBACK_BUFFER_SIZE (64 * 1024)
+
+static const char* TEST_DEVICE_ID = "perfdevice";
+static const char* TEST_DEVICE_KEY = "cGVyZmRldmljZWtleXBlcmZkZXZpY2VrZXk=";
+static const char* TEST_IOTHUB_NAME = "perfhub";
+static const char* TEST_IOTHUB_SUFFIX = "loopback.net";
+
+typedef struct PERF_MESSAGE_MIX_TAG
+{
+    const char* name;
+    size_t payload_size;
+    size_t property_count;
+} PERF_MESSAGE_MIX;
+
+static const PERF_MESSAGE_MIX PERF_MIXES[] =
+{
+    { "small", 16, 0 },
+    { "small+properties", 16, 4 },
+    { "medium", 256, 0 },
+    { "large", 4096, 0 },
+    { "large+properties", 4096, 4 }
+};
+
+#ifdef PERF_COUNT_ALLOCATIONS
+/* the perf target is linked with --wrap for the gballoc allocation functions, so every allocation made by the SDK and
+   its dependencies lands here first */
+static size_t g_allocation_count;
+
+extern void* __real_gballoc_malloc(size_t size);
+extern void* __real_gballoc_calloc(size_t nmemb, size_t size);
+extern void* __real_gballoc_realloc(void* ptr, size_t size);
+
+void* __wrap_gballoc_malloc(size_t size)
+{
+    g_allocation_count++;
+    return __real_gballoc_malloc(size);
+}
+
+void* __wrap_gballoc_calloc(size_t nmemb, size_t size)
+{
+    g_allocation_count++;
+    return __real_gballoc_calloc(nmemb, size);
+}
+
+void* __wrap_gballoc_realloc(void* ptr, size_t size)
+{
+    g_allocation_count++;
+    return __real_gballoc_realloc(ptr, size);
+}
+#endif
+
+/* loopback MQTT broker: it accepts whatever is connected, acknowledges every QoS 1 publish and every subscribe, and
+   answers the pings. The answers are queued and handed to the client on the next dowork, as a socket would */
+typedef struct MQTT_LOOPBACK_TAG
+{
+    ON_BYTES_RECEIVED on_bytes_received;
+    void* on_bytes_received_context;
+    unsigned char received[PERF_LOOPBACK_BUFFER_SIZE];
+    size_t received_size;
+    unsigned char pending[PERF_LOOPBACK_BUFFER_SIZE];
+    size_t pending_size;
+} MQTT_LOOPBACK;
+
+static void mqtt_loopback_reply(MQTT_LOOPBACK* loopback, const unsigned char* packet, size_t size)
+{
+    if (loopback->pending_size + size <= sizeof(loopback->pending))
+    {
+        (void)memcpy(loopback->pending + loopback->pending_size, packet, size);
+        loopback->pending_size += size;
+    }
+}
+
+static void mqtt_loopback_process_packet(MQTT_LOOPBACK* loopback, const unsigned char* packet, size_t header_size, size_t remaining_length)
+{
+    const unsigned char* variable_header = packet + header_size;
+    unsigned char reply[4 + 256];
+
+    switch (packet[0] >> 4)
+    {
+        case 1: /* CONNECT */
+            reply[0] = 0x20;
+            reply[1] = 0x02;
+            reply[2] = 0x00;
+            reply[3] = 0x00;
+            mqtt_loopback_reply(loopback, reply, 4);
+            break;
+        case 3: /* PUBLISH */
+            if (((packet[0] >> 1) & 0x03) != 0)
+            {
+                size_t topic_length = ((size_t)variable_header[0] << 8) | variable_header[1];
+                reply[0] = 0x40;
+                reply[1] = 0x02;
+                reply[2] = variable_header[2 + topic_length];
+                reply[3] = variable_header[3 + topic_length];
+                mqtt_loopback_reply(loopback, reply, 4);
+            }
+            break;
+        case 8: /* SUBSCRIBE */
+        {
+            size_t index = 2;
+            size_t granted = 0;
+            while (index + 2 < remaining_length && granted < 256)
+            {
+                size_t topic_length = ((size_t)variable_header[index] << 8) | variable_header[index + 1];
+                reply[4 + granted++] = variable_header[index + 2 + topic_length];
+                index += 3 + topic_length;
+            }
+            reply[0] = 0x90;
+            reply[1] = (unsigned char)(2 + granted);
+            reply[2] = variable_header[0];
+            reply[3] = variable_header[1];
+            mqtt_loopback_reply(loopback, reply, 4 + granted);
+            break;
+        }
+        case 12: /* PINGREQ */
+            reply[0] = 0xD0;
+            reply[1] = 0x00;
+            mqtt_loopback_reply(loopback, reply, 2);
+            break;
+        default:
+            break;
+    }
+}
+
+static void mqtt_loopback_process_received(MQTT_LOOPBACK* loopback)
+{
+    size_t offset = 0;
+
+    for (;;)
+    {
+        size_t remaining_length = 0;
+        size_t multiplier = 1;
+        size_t header_size = 1;
+        int complete_header = 0;
+
+        while (offset + header_size < loopback->received_size && header_size <= 4)
+        {
+            unsigned char encoded = loopback->received[offset + header_size];
+            remaining_length += (encoded & 0x7F) * multiplier;
+            multiplier *= 128;
+            header_size++;
+            if ((encoded & 0x80) == 0)
+            {
+                complete_header = 1;
+                break;
+            }
+        }
+
+        if (!complete_header || offset + header_size + remaining_length > loopback->received_size)
+        {
+            break;
+        }
+
+        mqtt_loopback_process_packet(loopback, loopback->received + offset, header_size, remaining_length);
+        offset += header_size + remaining_length;
+    }
+
+    (void)memmove(loopback->received, loopback->received + offset, loopback->received_size - offset);
+    loopback->received_size -= offset;
+}
+
+static CONCRETE_IO_HANDLE mqtt_loopback_create(void* io_create_parameters)
+{
+    (void)io_create_parameters;
+    return calloc(1, sizeof(MQTT_LOOPBACK));
+}
+
+static void mqtt_loopback_destroy(CONCRETE_IO_HANDLE concrete_io)
+{
+    free(concrete_io);
+}
+
+static int mqtt_loopback_open(CONCRETE_IO_HANDLE concrete_io, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+    MQTT_LOOPBACK* loopback = (MQTT_LOOPBACK*)concrete_io;
+    (void)on_io_error;
+    (void)on_io_error_context;
+
+    loopback->on_bytes_received = on_bytes_received;
+    loopback->on_bytes_received_context = on_bytes_received_context;
+    loopback->received_size = 0;
+    loopback->pending_size = 0;
+    on_io_open_complete(on_io_open_complete_context, IO_OPEN_OK);
+    return 0;
+}
+
+static int mqtt_loopback_close(CONCRETE_IO_HANDLE concrete_io, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+    (void)concrete_io;
+    if (on_io_close_complete != NULL)
+    {
+        on_io_close_complete(callback_context);
+    }
+    return 0;
+}
+
+static int mqtt_loopback_send(CONCRETE_IO_HANDLE concrete_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    MQTT_LOOPBACK* loopback = (MQTT_LOOPBACK*)concrete_io;
+    int result;
+
+    if (loopback->received_size + size > sizeof(loopback->received))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(loopback->received + loopback->received_size, buffer, size);
+        loopback->received_size += size;
+        mqtt_loopback_process_received(loopback);
+        if (on_send_complete != NULL)
+        {
+            on_send_complete(callback_context, IO_SEND_OK);
+        }
+        result = 0;
+    }
+
+    return result;
+}
+
+static void mqtt_loopback_dowork(CONCRETE_IO_HANDLE concrete_io)
+{
+    MQTT_LOOPBACK* loopback = (MQTT_LOOPBACK*)concrete_io;
+    if (loopback->pending_size > 0)
+    {
+        unsigned char delivered[PERF_LOOPBACK_BUFFER_SIZE];
+        size_t delivered_size = loopback->pending_size;
+        (void)memcpy(delivered, loopback->pending, delivered_size);
+        loopback->pending_size = 0;
+        loopback->on_bytes_received(loopback->on_bytes_received_context, delivered, delivered_size);
+    }
+}
+
+static int mqtt_loopback_setoption(CONCRETE_IO_HANDLE concrete_io, const char* optionName, const void* value)
+{
+    (void)concrete_io;
+    (void)optionName;
+    (void)value;
+    return 0;
+}
+
+static OPTIONHANDLER_HANDLE mqtt_loopback_retrieveoptions(CONCRETE_IO_HANDLE concrete_io)
+{
+    (void)concrete_io;
+    return NULL;
+}
+
+static const IO_INTERFACE_DESCRIPTION mqtt_loopback_interface_description =
+{
+    mqtt_loopback_retrieveoptions,
+    mqtt_loopback_create,
+    mqtt_loopback_destroy,
+    mqtt_loopback_open,
+    mqtt_loopback_close,
+    mqtt_loopback_send,
+    mqtt_loopback_dowork,
+    mqtt_loopback_setoption
+};
+
+static XIO_HANDLE get_mqtt_loopback_io(const char* fully_qualified_name, const MQTT_TRANSPORT_PROXY_OPTIONS* mqtt_transport_proxy_options)
+{
+    (void)fully_qualified_name;
+    (void)mqtt_transport_proxy_options;
+    return xio_create(&mqtt_loopback_interface_description, NULL);
+}
+
+static TRANSPORT_LL_HANDLE perf_mqtt_create(const IOTHUBTRANSPORT_CONFIG* config)
+{
+    return IoTHubTransport_MQTT_Common_Create(config, get_mqtt_loopback_io);
+}
+
+/* MQTT_Protocol with the IO swapped for the loopback broker */
+static const TRANSPORT_PROVIDER* perf_mqtt_protocol(void)
+{
+    static TRANSPORT_PROVIDER perf_mqtt_provider;
+    perf_mqtt_provider = *MQTT_Protocol();
+    perf_mqtt_provider.IoTHubTransport_Create = perf_mqtt_create;
+    return &perf_mqtt_provider;
+}
+
+typedef struct PERF_TRANSPORT_TAG
+{
+    const char* name;
+    IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;
+} PERF_TRANSPORT;
+
+static const PERF_TRANSPORT PERF_TRANSPORTS[] =
+{
+    { "MQTT", perf_mqtt_protocol }
+};
+
+static void on_send_confirmation(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    size_t* confirmed = (size_t*)userContextCallback;
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        (*confirmed)++;
+    }
+}
+
+static int run_message_mix(IOTHUB_CLIENT_LL_HANDLE client, const PERF_MESSAGE_MIX* mix, const char* transport_name)
+{
+    int result = 0;
+    size_t confirmed = 0;
+    size_t sent;
+    unsigned char* payload = (unsigned char*)malloc(mix->payload_size);
+    clock_t start;
+    double cpu_seconds;
+#ifdef PERF_COUNT_ALLOCATIONS
+    size_t allocations_at_start = g_allocation_count;
+#endif
+
+    ASSERT_IS_NOT_NULL(payload);
+    (void)memset(payload, 'p', mix->payload_size);
+
+    start = clock();
+    for (sent = 0; sent < PERF_MESSAGES_PER_MIX && result == 0; sent++)
+    {
+        IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromByteArray(payload, mix->payload_size);
+        size_t property_index;
+        size_t dowork_count;
+
+        if (message == NULL)
+        {
+            result = __FAILURE__;
+            break;
+        }
+
+        for (property_index = 0; property_index < mix->property_count; property_index++)
+        {
+            char key[16];
+            (void)sprintf(key, "prop%u", (unsigned int)property_index);
+            (void)Map_AddOrUpdate(IoTHubMessage_Properties(message), key, "value");
+        }
+
+        if (IoTHubClient_LL_SendEventAsync(client, message, on_send_confirmation, &confirmed) != IOTHUB_CLIENT_OK)
+        {
+            result = __FAILURE__;
+        }
+        IoTHubMessage_Destroy(message);
+
+        for (dowork_count = 0; confirmed <= sent && dowork_count < PERF_MAX_DOWORK_PER_MESSAGE; dowork_count++)
+        {
+            IoTHubClient_LL_DoWork(client);
+        }
+
+        if (confirmed <= sent)
+        {
+            result = __FAILURE__;
+        }
+    }
+    cpu_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    (void)printf("%-6s %-18s %10.2f us/msg", transport_name, mix->name, cpu_seconds * 1000000.0 / PERF_MESSAGES_PER_MIX);
+#ifdef PERF_COUNT_ALLOCATIONS
+    (void)printf(" %8.2f allocs/msg", (double)(g_allocation_count - allocations_at_start) / PERF_MESSAGES_PER_MIX);
+#endif
+    (void)printf(" %10lu peak heap bytes\r\n", (unsigned long)gballoc_getMaximumMemoryUsed());
+
+    free(payload);
+    return result;
+}
+
+BEGIN_TEST_SUITE(perf_tests)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    (void)printf("transp mix                CPU time/msg      allocations          peak heap\r\n");
+}
+
+TEST_FUNCTION(perf_transports_send_fixed_message_mixes)
+{
+    size_t transport_index;
+    int failures = 0;
+
+    for (transport_index = 0; transport_index < sizeof(PERF_TRANSPORTS) / sizeof(PERF_TRANSPORTS[0]); transport_index++)
+    {
+        size_t mix_index;
+        IOTHUB_CLIENT_CONFIG config;
+        IOTHUB_CLIENT_LL_HANDLE client;
+
+        (void)memset(&config, 0, sizeof(config));
+        config.protocol = PERF_TRANSPORTS[transport_index].protocol;
+        config.deviceId = TEST_DEVICE_ID;
+        config.deviceKey = TEST_DEVICE_KEY;
+        config.iotHubName = TEST_IOTHUB_NAME;
+        config.iotHubSuffix = TEST_IOTHUB_SUFFIX;
+
+        /* the peak heap is reported per transport, from the creation of its client on */
+        (void)gballoc_init();
+        client = IoTHubClient_LL_Create(&config);
+        ASSERT_IS_NOT_NULL(client);
+
+        for (mix_index = 0; mix_index < sizeof(PERF_MIXES) / sizeof(PERF_MIXES[0]); mix_index++)
+        {
+            if (run_message_mix(client, &PERF_MIXES[mix_index], PERF_TRANSPORTS[transport_index].name) != 0)
+            {
+                failures++;
+            }
+        }
+
+        IoTHubClient_LL_Destroy(client);
+        gballoc_deinit();
+    }
+
+    ASSERT_ARE_EQUAL(int, 0, failures);
+}
+
+END_TEST_SUITE(perf_tests)
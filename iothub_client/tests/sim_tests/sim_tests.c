@@ -0,0 +1,506 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "testrunnerswitcher.h"
+
+#include "iothub_client_ll.h"
+#include "iothub_message.h"
+#include "iothub_transport_ll.h"
+#include "iothub_client_private.h"
+#include "iothub_client_retry_control.h"
+
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+/* The sim tests run a fleet of clients through a hub outage in virtual time. Every clock the SDK reads (tickcounter and
+   get_time) is wrapped at link time and answers the virtual clock of this file, which only moves when the simulation
+   steps it, so half an hour of fleet behaviour runs in seconds and twice the same run gives the same numbers. Each client
+   runs over SIM_TRANSPORT, an in-memory transport that plays the part of the hub: it delivers what is queued while the
+   hub is up, drops every connection when it goes down and, like a real hub, accepts only so many connections per second
+   while the fleet comes back. Reconnection is paced by the SDK's own retry control, so what is reported (queue growth,
+   connection attempts per second, time to recover) is the retry and timeout logic of the SDK alone. */
+
+#ifndef SIM_DEVICE_COUNT
+#define SIM_DEVICE_COUNT 1000
+#endif
+#define SIM_TICK_MS 250
+#define SIM_RUN_MS (30 * 60 * 1000)
+#define SIM_OUTAGE_START_MS (5 * 60 * 1000)
+#define SIM_OUTAGE_END_MS (10 * 60 * 1000)
+#define SIM_SEND_PERIOD_MS (10 * 1000)
+#define SIM_MESSAGE_TIMEOUT_MS (2 * 60 * 1000)
+#define SIM_HUB_CONNECTS_PER_SECOND 100
+#define SIM_HUB_MESSAGES_PER_DOWORK 10
+#define SIM_RANDOM_SEED 42
+/* an arbitrary wall clock start, so get_time never answers anything close to 0 */
+#define SIM_EPOCH ((time_t)1500000000)
+
+static const char* TEST_DEVICE_KEY = "c2ltZGV2aWNla2V5c2ltZGV2aWNla2V5c2ltZGV2aWM=";
+static const char* TEST_IOTHUB_NAME = "simhub";
+static const char* TEST_IOTHUB_SUFFIX = "loopback.net";
+static const char* TEST_MESSAGE = "{\"temperature\":21.5}";
+
+typedef struct SIM_TRANSPORT_TAG
+{
+    IOTHUB_CLIENT_LL_HANDLE client;
+    PDLIST_ENTRY waitingToSend;
+    RETRY_CONTROL_HANDLE retry_control;
+    bool connected;
+    bool retry_expired;
+} SIM_TRANSPORT;
+
+typedef struct SIM_STATS_TAG
+{
+    size_t connected_devices;
+    size_t expired_devices;
+    size_t messages_sent;
+    size_t messages_confirmed;
+    size_t messages_timed_out;
+    size_t queued_messages;
+    size_t peak_queued_messages;
+    size_t connect_attempts;
+    size_t connect_attempts_this_second;
+    size_t peak_connect_attempts_per_second;
+    size_t connects_accepted_this_second;
+    tickcounter_ms_t all_connected_ms;
+    tickcounter_ms_t queues_drained_ms;
+} SIM_STATS;
+
+static tickcounter_ms_t g_virtual_ms;
+static bool g_hub_up;
+static SIM_STATS g_stats;
+
+/* the linker sends every reference to the real clocks here */
+int __wrap_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms);
+time_t __wrap_get_time(time_t* p);
+
+int __wrap_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    int result;
+    if ((tick_counter == NULL) || (current_ms == NULL))
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        *current_ms = g_virtual_ms;
+        result = 0;
+    }
+    return result;
+}
+
+time_t __wrap_get_time(time_t* p)
+{
+    time_t result = SIM_EPOCH + (time_t)(g_virtual_ms / 1000);
+    if (p != NULL)
+    {
+        *p = result;
+    }
+    return result;
+}
+
+static void sim_report_connection(SIM_TRANSPORT* transport, IOTHUB_CLIENT_CONNECTION_STATUS status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason)
+{
+    IoTHubClient_LL_ConnectionStatusCallBack(transport->client, status, reason);
+}
+
+static void sim_try_connect(SIM_TRANSPORT* transport)
+{
+    RETRY_ACTION retry_action;
+
+    if (retry_control_should_retry(transport->retry_control, &retry_action) != 0)
+    {
+        LogError("retry control failed, the device stays disconnected");
+    }
+    else if (retry_action == RETRY_ACTION_STOP_RETRYING)
+    {
+        transport->retry_expired = true;
+        g_stats.expired_devices++;
+        sim_report_connection(transport, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED);
+    }
+    else if (retry_action == RETRY_ACTION_RETRY_NOW)
+    {
+        g_stats.connect_attempts++;
+        g_stats.connect_attempts_this_second++;
+
+        /* a hub that is down, or already busy with the connections of this second, refuses the connection */
+        if (g_hub_up && (g_stats.connects_accepted_this_second < SIM_HUB_CONNECTS_PER_SECOND))
+        {
+            g_stats.connects_accepted_this_second++;
+            g_stats.connected_devices++;
+            transport->connected = true;
+            retry_control_reset(transport->retry_control);
+            sim_report_connection(transport, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
+        }
+    }
+    else
+    {
+        /* RETRY_ACTION_RETRY_LATER, the retry control is backing off */
+    }
+}
+
+static TRANSPORT_LL_HANDLE SimTransport_Create(const IOTHUBTRANSPORT_CONFIG* config)
+{
+    SIM_TRANSPORT* result = (SIM_TRANSPORT*)malloc(sizeof(SIM_TRANSPORT));
+    if (result != NULL)
+    {
+        (void)memset(result, 0, sizeof(SIM_TRANSPORT));
+        result->waitingToSend = config->waitingToSend;
+    }
+    return (TRANSPORT_LL_HANDLE)result;
+}
+
+static void SimTransport_Destroy(TRANSPORT_LL_HANDLE handle)
+{
+    SIM_TRANSPORT* transport = (SIM_TRANSPORT*)handle;
+    if (transport->retry_control != NULL)
+    {
+        retry_control_destroy(transport->retry_control);
+    }
+    free(transport);
+}
+
+static IOTHUB_DEVICE_HANDLE SimTransport_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
+{
+    SIM_TRANSPORT* transport = (SIM_TRANSPORT*)handle;
+    (void)device;
+    transport->client = iotHubClientHandle;
+    transport->waitingToSend = waitingToSend;
+    return (IOTHUB_DEVICE_HANDLE)transport;
+}
+
+static void SimTransport_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
+{
+    (void)deviceHandle;
+}
+
+static int SimTransport_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
+{
+    int result;
+    SIM_TRANSPORT* transport = (SIM_TRANSPORT*)handle;
+    RETRY_CONTROL_HANDLE retry_control = retry_control_create(retryPolicy, (unsigned int)retryTimeoutLimitInSeconds);
+
+    if (retry_control == NULL)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        if (transport->retry_control != NULL)
+        {
+            retry_control_destroy(transport->retry_control);
+        }
+        transport->retry_control = retry_control;
+        result = 0;
+    }
+    return result;
+}
+
+static void SimTransport_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    SIM_TRANSPORT* transport = (SIM_TRANSPORT*)handle;
+    (void)iotHubClientHandle;
+
+    if (transport->connected && !g_hub_up)
+    {
+        transport->connected = false;
+        g_stats.connected_devices--;
+        sim_report_connection(transport, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK);
+    }
+
+    if (!transport->connected && !transport->retry_expired)
+    {
+        sim_try_connect(transport);
+    }
+
+    if (transport->connected)
+    {
+        DLIST_ENTRY delivered;
+        size_t delivered_count = 0;
+
+        DList_InitializeListHead(&delivered);
+        while ((delivered_count < SIM_HUB_MESSAGES_PER_DOWORK) && !DList_IsListEmpty(transport->waitingToSend))
+        {
+            DLIST_ENTRY* entry = DList_RemoveHeadList(transport->waitingToSend);
+            DList_InsertTailList(&delivered, entry);
+            delivered_count++;
+        }
+
+        if (delivered_count > 0)
+        {
+            IoTHubClient_LL_SendComplete(transport->client, &delivered, IOTHUB_CLIENT_CONFIRMATION_OK);
+        }
+    }
+}
+
+static IOTHUB_CLIENT_RESULT SimTransport_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS* iotHubClientStatus)
+{
+    SIM_TRANSPORT* transport = (SIM_TRANSPORT*)handle;
+    *iotHubClientStatus = DList_IsListEmpty(transport->waitingToSend) ? IOTHUB_CLIENT_SEND_STATUS_IDLE : IOTHUB_CLIENT_SEND_STATUS_BUSY;
+    return IOTHUB_CLIENT_OK;
+}
+
+static STRING_HANDLE SimTransport_GetHostname(TRANSPORT_LL_HANDLE handle)
+{
+    (void)handle;
+    return STRING_construct("simhub.loopback.net");
+}
+
+static IOTHUB_CLIENT_RESULT SimTransport_SetOption(TRANSPORT_LL_HANDLE handle, const char* optionName, const void* value)
+{
+    (void)handle;
+    (void)optionName;
+    (void)value;
+    return IOTHUB_CLIENT_OK;
+}
+
+static int SimTransport_Subscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+    return 0;
+}
+
+static void SimTransport_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+}
+
+static int SimTransport_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle, METHOD_HANDLE methodId, const unsigned char* response, size_t response_size, int status_response)
+{
+    (void)handle;
+    (void)methodId;
+    (void)response;
+    (void)response_size;
+    (void)status_response;
+    return __LINE__;
+}
+
+static IOTHUB_PROCESS_ITEM_RESULT SimTransport_ProcessItem(IOTHUB_DEVICE_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+{
+    (void)handle;
+    (void)item_type;
+    (void)iothub_item;
+    return IOTHUB_PROCESS_ERROR;
+}
+
+static IOTHUB_CLIENT_RESULT SimTransport_SendMessageDisposition(MESSAGE_CALLBACK_INFO* messageData, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    (void)messageData;
+    (void)disposition;
+    return IOTHUB_CLIENT_ERROR;
+}
+
+static uint32_t SimTransport_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, bool* isWaitingForNetwork)
+{
+    (void)handle;
+    *isWaitingForNetwork = false;
+    return 0;
+}
+
+static size_t SimTransport_GetPollDescriptors(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_POLL_DESCRIPTOR* descriptors, size_t descriptorCount)
+{
+    (void)handle;
+    (void)descriptors;
+    (void)descriptorCount;
+    return 0;
+}
+
+static void SimTransport_TrimMemory(TRANSPORT_LL_HANDLE handle)
+{
+    (void)handle;
+}
+
+static TRANSPORT_PROVIDER SIM_TRANSPORT_PROVIDER =
+{
+    SimTransport_SendMessageDisposition,
+    SimTransport_Subscribe,
+    SimTransport_Unsubscribe,
+    SimTransport_DeviceMethod_Response,
+    SimTransport_Subscribe,
+    SimTransport_Unsubscribe,
+    SimTransport_ProcessItem,
+    SimTransport_GetHostname,
+    SimTransport_SetOption,
+    SimTransport_Create,
+    SimTransport_Destroy,
+    SimTransport_Register,
+    SimTransport_Unregister,
+    SimTransport_Subscribe,
+    SimTransport_Unsubscribe,
+    SimTransport_DoWork,
+    SimTransport_SetRetryPolicy,
+    SimTransport_GetSendStatus,
+    SimTransport_GetNextWorkDeadline,
+    SimTransport_GetPollDescriptors,
+    SimTransport_TrimMemory
+};
+
+static const TRANSPORT_PROVIDER* sim_protocol(void)
+{
+    return &SIM_TRANSPORT_PROVIDER;
+}
+
+static void sim_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    (void)userContextCallback;
+    g_stats.queued_messages--;
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        g_stats.messages_confirmed++;
+    }
+    else if (result == IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT)
+    {
+        g_stats.messages_timed_out++;
+    }
+}
+
+static int sim_send(IOTHUB_CLIENT_LL_HANDLE client)
+{
+    int result;
+    IOTHUB_MESSAGE_HANDLE message = IoTHubMessage_CreateFromString(TEST_MESSAGE);
+    if (message == NULL)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        if (IoTHubClient_LL_SendEventAsync(client, message, sim_confirmation_callback, NULL) != IOTHUB_CLIENT_OK)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            g_stats.messages_sent++;
+            g_stats.queued_messages++;
+            result = 0;
+        }
+        IoTHubMessage_Destroy(message);
+    }
+    return result;
+}
+
+/* closes the virtual second that just ended, the hub's connection budget starts over */
+static void sim_end_second(void)
+{
+    if (g_stats.connect_attempts_this_second > g_stats.peak_connect_attempts_per_second)
+    {
+        g_stats.peak_connect_attempts_per_second = g_stats.connect_attempts_this_second;
+    }
+    g_stats.connect_attempts_this_second = 0;
+    g_stats.connects_accepted_this_second = 0;
+}
+
+static size_t g_failures;
+
+BEGIN_TEST_SUITE(sim_tests)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    (void)printf("%u devices, one message every %u s, hub outage from %u s to %u s, %u connections/s accepted by the hub\r\n",
+        (unsigned int)SIM_DEVICE_COUNT, (unsigned int)(SIM_SEND_PERIOD_MS / 1000), (unsigned int)(SIM_OUTAGE_START_MS / 1000),
+        (unsigned int)(SIM_OUTAGE_END_MS / 1000), (unsigned int)SIM_HUB_CONNECTS_PER_SECOND);
+}
+
+TEST_FUNCTION(sim_fleet_recovers_from_hub_outage)
+{
+    static IOTHUB_CLIENT_LL_HANDLE clients[SIM_DEVICE_COUNT];
+    static char device_ids[SIM_DEVICE_COUNT][32];
+    size_t device_index;
+    uint64_t message_timeout = SIM_MESSAGE_TIMEOUT_MS;
+
+    srand(SIM_RANDOM_SEED);
+    (void)memset(&g_stats, 0, sizeof(g_stats));
+    g_virtual_ms = 0;
+    g_hub_up = true;
+    g_failures = 0;
+
+    for (device_index = 0; device_index < SIM_DEVICE_COUNT; device_index++)
+    {
+        IOTHUB_CLIENT_CONFIG config;
+
+        (void)sprintf(device_ids[device_index], "simdevice%05u", (unsigned int)device_index);
+        (void)memset(&config, 0, sizeof(config));
+        config.protocol = sim_protocol;
+        config.deviceId = device_ids[device_index];
+        config.deviceKey = TEST_DEVICE_KEY;
+        config.iotHubName = TEST_IOTHUB_NAME;
+        config.iotHubSuffix = TEST_IOTHUB_SUFFIX;
+
+        clients[device_index] = IoTHubClient_LL_Create(&config);
+        ASSERT_IS_NOT_NULL(clients[device_index]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubClient_LL_SetOption(clients[device_index], "messageTimeout", &message_timeout));
+    }
+
+    for (g_virtual_ms = 0; g_virtual_ms < SIM_RUN_MS; g_virtual_ms += SIM_TICK_MS)
+    {
+        g_hub_up = (g_virtual_ms < SIM_OUTAGE_START_MS) || (g_virtual_ms >= SIM_OUTAGE_END_MS);
+
+        for (device_index = 0; device_index < SIM_DEVICE_COUNT; device_index++)
+        {
+            /* the devices send at the same period but not in the same tick */
+            if (((g_virtual_ms / SIM_TICK_MS) % (SIM_SEND_PERIOD_MS / SIM_TICK_MS)) == (device_index % (SIM_SEND_PERIOD_MS / SIM_TICK_MS)))
+            {
+                if (sim_send(clients[device_index]) != 0)
+                {
+                    g_failures++;
+                }
+            }
+            IoTHubClient_LL_DoWork(clients[device_index]);
+        }
+
+        if (g_stats.queued_messages > g_stats.peak_queued_messages)
+        {
+            g_stats.peak_queued_messages = g_stats.queued_messages;
+        }
+
+        if (g_virtual_ms >= SIM_OUTAGE_END_MS)
+        {
+            if ((g_stats.all_connected_ms == 0) && (g_stats.connected_devices == SIM_DEVICE_COUNT))
+            {
+                g_stats.all_connected_ms = g_virtual_ms;
+            }
+            /* "drained" is a backlog no longer than what the steady state keeps in flight */
+            if ((g_stats.all_connected_ms != 0) && (g_stats.queues_drained_ms == 0) && (g_stats.queued_messages <= SIM_DEVICE_COUNT))
+            {
+                g_stats.queues_drained_ms = g_virtual_ms;
+            }
+        }
+
+        if (((g_virtual_ms + SIM_TICK_MS) % 1000) == 0)
+        {
+            sim_end_second();
+        }
+    }
+
+    (void)printf("messages: %lu sent, %lu confirmed, %lu timed out, peak queued %lu\r\n",
+        (unsigned long)g_stats.messages_sent, (unsigned long)g_stats.messages_confirmed,
+        (unsigned long)g_stats.messages_timed_out, (unsigned long)g_stats.peak_queued_messages);
+    (void)printf("connections: %lu attempts, peak %lu attempts/s, %lu devices gave up retrying\r\n",
+        (unsigned long)g_stats.connect_attempts, (unsigned long)g_stats.peak_connect_attempts_per_second,
+        (unsigned long)g_stats.expired_devices);
+    (void)printf("recovery after the outage: all devices connected in %.1f s, queues drained in %.1f s\r\n",
+        g_stats.all_connected_ms == 0 ? -1.0 : (double)(g_stats.all_connected_ms - SIM_OUTAGE_END_MS) / 1000.0,
+        g_stats.queues_drained_ms == 0 ? -1.0 : (double)(g_stats.queues_drained_ms - SIM_OUTAGE_END_MS) / 1000.0);
+
+    for (device_index = 0; device_index < SIM_DEVICE_COUNT; device_index++)
+    {
+        IoTHubClient_LL_Destroy(clients[device_index]);
+    }
+
+    ASSERT_ARE_EQUAL(int, 0, (int)g_failures);
+    ASSERT_IS_TRUE(g_stats.all_connected_ms != 0);
+    ASSERT_IS_TRUE(g_stats.queues_drained_ms != 0);
+}
+
+END_TEST_SUITE(sim_tests)
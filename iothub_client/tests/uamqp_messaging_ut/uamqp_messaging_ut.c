@@ -99,6 +99,22 @@ int test_amqpvalue_get_string(AMQP_VALUE value, const char** string_value)
     return saved_amqpvalue_get_string_return;
 }
 
+#define TEST_ENCODED_SECTION_SIZE 4
+static const unsigned char TEST_ENCODED_SECTION[TEST_ENCODED_SECTION_SIZE] = { 0x00, 0x53, 0x75, 0x40 };
+
+int test_amqpvalue_get_encoded_size(AMQP_VALUE value, size_t* encoded_size)
+{
+    (void)value;
+    *encoded_size = TEST_ENCODED_SECTION_SIZE;
+    return 0;
+}
+
+int test_amqpvalue_encode(AMQP_VALUE value, AMQPVALUE_ENCODER_OUTPUT encoder_output, void* context)
+{
+    (void)value;
+    return encoder_output(context, TEST_ENCODED_SECTION, TEST_ENCODED_SECTION_SIZE);
+}
+
 
 // Helpers to set EXPECTED_CALLS
 void set_exp_calls_for_addPropertiesTouAMQPMessage(bool has_message_id, bool has_correlation_id, bool message_handle_has_properties)
@@ -143,7 +159,7 @@ void set_exp_calls_for_addPropertiesTouAMQPMessage(bool has_message_id, bool has
     EXPECTED_CALL(properties_destroy(IGNORED_PTR_ARG));
 }
 
-static void set_exp_calls_for_addApplicationPropertiesTouAMQPMessage(size_t number_of_app_properties)
+static void set_exp_calls_for_addApplicationPropertiesTouAMQPMessage_with_key_cache(size_t number_of_app_properties, bool use_key_cache, bool are_keys_cached)
 {
     STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -159,10 +175,21 @@ static void set_exp_calls_for_addApplicationPropertiesTouAMQPMessage(size_t numb
         size_t i;
         for (i = 0; i < number_of_app_properties; i++)
         {
-            STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_MAP_KEYS[i])); // map key
+            if (!are_keys_cached)
+            {
+                STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_MAP_KEYS[i])); // map key
+
+                if (use_key_cache)
+                {
+                    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_MAP_KEYS[i]) + 1)); // cached copy of the key
+                }
+            }
             STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_MAP_VALUES[i])); // map value
             STRICT_EXPECTED_CALL(amqpvalue_set_map_value(TEST_AMQP_VALUE, TEST_AMQP_VALUE, TEST_AMQP_VALUE));
-            STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+            if (!use_key_cache)
+            {
+                STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+            }
             STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
         }
 
@@ -171,7 +198,12 @@ static void set_exp_calls_for_addApplicationPropertiesTouAMQPMessage(size_t numb
     }
 }
 
-static void set_exp_calls_for_message_create_from_iothub_message(size_t number_of_app_properties, IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool has_message_id, bool has_correlation_id, bool message_handle_has_properties)
+static void set_exp_calls_for_addApplicationPropertiesTouAMQPMessage(size_t number_of_app_properties)
+{
+    set_exp_calls_for_addApplicationPropertiesTouAMQPMessage_with_key_cache(number_of_app_properties, false, false);
+}
+
+static void set_exp_calls_for_message_create_from_iothub_message_body_and_properties(IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool has_message_id, bool has_correlation_id, bool message_handle_has_properties)
 {
     // message_create_from_iothub_message
     BINARY_DATA test_binary_data;
@@ -195,9 +227,48 @@ static void set_exp_calls_for_message_create_from_iothub_message(size_t number_o
         .IgnoreArgument(2).SetReturn(0);
 
     set_exp_calls_for_addPropertiesTouAMQPMessage(has_message_id, has_correlation_id, message_handle_has_properties);
+}
+
+static void set_exp_calls_for_message_create_from_iothub_message(size_t number_of_app_properties, IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool has_message_id, bool has_correlation_id, bool message_handle_has_properties)
+{
+    set_exp_calls_for_message_create_from_iothub_message_body_and_properties(msg_content_type, has_message_id, has_correlation_id, message_handle_has_properties);
     set_exp_calls_for_addApplicationPropertiesTouAMQPMessage(number_of_app_properties);
 }
 
+static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message()
+{
+    data test_data = { NULL, 0 };
+    BINARY_DATA test_body;
+    test_body.bytes = (const unsigned char*)TEST_STRING;
+    test_body.length = strlen(TEST_STRING);
+
+    set_exp_calls_for_message_create_from_iothub_message(1, IOTHUBMESSAGE_BYTEARRAY, true, true, true);
+
+    STRICT_EXPECTED_CALL(message_get_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_properties(&TEST_PROPERTIES_HANDLE_PTR, sizeof(PROPERTIES_HANDLE));
+    STRICT_EXPECTED_CALL(amqpvalue_create_properties(TEST_PROPERTIES_HANDLE));
+    STRICT_EXPECTED_CALL(message_get_application_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_application_properties(&TEST_AMQP_VALUE2, sizeof(AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_create_application_properties(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_MESSAGE_HANDLE, 0, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_amqp_data(&test_body, sizeof(BINARY_DATA));
+    STRICT_EXPECTED_CALL(amqpvalue_create_data(test_data)).IgnoreArgument_value();
+    STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+
+    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(3 * TEST_ENCODED_SECTION_SIZE));
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+}
+
 static void set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(size_t number_of_properties, bool has_message_id, bool has_correlation_id, bool has_properties)
 {
     static BINARY_DATA test_binary_data;
@@ -310,6 +381,12 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(AMQP_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_ENCODER_OUTPUT, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(data, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
 
     REGISTER_GLOBAL_MOCK_HOOK(properties_get_message_id, test_properties_get_message_id);
     REGISTER_GLOBAL_MOCK_HOOK(properties_get_correlation_id, test_properties_get_correlation_id);
@@ -375,6 +452,17 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(properties_create, TEST_PROPERTIES_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(properties_create, NULL);
 
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_properties, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_properties, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_application_properties, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_application_properties, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_data, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_data, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_encoded_size, test_amqpvalue_get_encoded_size);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_get_encoded_size, 1);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, test_amqpvalue_encode);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_encode, 1);
+
     // Initialization of variables.
     TEST_MAP_KEYS = (char**)real_malloc(sizeof(char*) * 5);
     ASSERT_IS_NOT_NULL_WITH_MSG(TEST_MAP_KEYS, "Could not allocate memory for TEST_MAP_KEYS");
@@ -813,4 +901,170 @@ TEST_FUNCTION(IoTHubMessage_CreateFromUamqpMessage_no_app_properties_success)
     // cleanup
 }
 
+// Tests_SRS_UAMQP_MESSAGING_41_006: [uamqp_property_key_cache_create() shall allocate an empty property key cache, or return NULL if malloc() fails.]
+TEST_FUNCTION(uamqp_property_key_cache_create_success)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    UAMQP_PROPERTY_KEY_CACHE_HANDLE key_cache = uamqp_property_key_cache_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(key_cache);
+
+    // cleanup
+    uamqp_property_key_cache_destroy(key_cache);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_006: [uamqp_property_key_cache_create() shall allocate an empty property key cache, or return NULL if malloc() fails.]
+TEST_FUNCTION(uamqp_property_key_cache_create_malloc_fails)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    UAMQP_PROPERTY_KEY_CACHE_HANDLE key_cache = uamqp_property_key_cache_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(key_cache);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_007: [uamqp_property_key_cache_destroy() shall destroy the cached AMQP_VALUEs, free the cached names and the cache; it shall return if key_cache is NULL.]
+TEST_FUNCTION(uamqp_property_key_cache_destroy_NULL_key_cache)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    uamqp_property_key_cache_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_008: [message_create_from_iothub_message_with_key_cache() shall create the uAMQP message as message_create_from_iothub_message() does, taking the application property names from `key_cache` when `key_cache` is not NULL.]
+// Tests_SRS_UAMQP_MESSAGING_41_009: [If a property name is in `key_cache`, its cached AMQP_VALUE shall be used as the uAMQP property map key instead of creating one, and it shall not be destroyed.]
+// Tests_SRS_UAMQP_MESSAGING_41_010: [A property name not in `key_cache` shall be added to it, replacing the oldest entry if the cache is full; if it cannot be added, its AMQP_VALUE shall be destroyed after use.]
+// Tests_SRS_UAMQP_MESSAGING_41_007: [uamqp_property_key_cache_destroy() shall destroy the cached AMQP_VALUEs, free the cached names and the cache; it shall return if key_cache is NULL.]
+TEST_FUNCTION(message_create_from_iothub_message_with_key_cache_reuses_property_names)
+{
+    // arrange
+    UAMQP_PROPERTY_KEY_CACHE_HANDLE key_cache = uamqp_property_key_cache_create();
+    MESSAGE_HANDLE uamqp_message1 = NULL;
+    MESSAGE_HANDLE uamqp_message2 = NULL;
+    size_t i;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_from_iothub_message_body_and_properties(IOTHUBMESSAGE_BYTEARRAY, true, true, true);
+    set_exp_calls_for_addApplicationPropertiesTouAMQPMessage_with_key_cache(2, true, false);
+    set_exp_calls_for_message_create_from_iothub_message_body_and_properties(IOTHUBMESSAGE_BYTEARRAY, true, true, true);
+    set_exp_calls_for_addApplicationPropertiesTouAMQPMessage_with_key_cache(2, true, true);
+    for (i = 0; i < 2; i++)
+    {
+        STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    int result1 = message_create_from_iothub_message_with_key_cache(TEST_IOTHUB_MESSAGE_HANDLE, key_cache, &uamqp_message1);
+    int result2 = message_create_from_iothub_message_with_key_cache(TEST_IOTHUB_MESSAGE_HANDLE, key_cache, &uamqp_message2);
+    uamqp_property_key_cache_destroy(key_cache);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)TEST_MESSAGE_HANDLE, (void*)uamqp_message2);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_001: [If iothub_message or encoded_message are NULL, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_NULL_message_fails)
+{
+    // arrange
+    BINARY_DATA encoded_message;
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message(NULL, &encoded_message);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_001: [If iothub_message or encoded_message are NULL, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_NULL_encoded_message_fails)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_002: [The uAMQP message shall be created from iothub_message using message_create_from_iothub_message().]
+// Tests_SRS_UAMQP_MESSAGING_41_003: [The properties, the application properties and the data of the uAMQP message shall be encoded one after the other in a buffer allocated for encoded_message, as a message of a batch.]
+// Tests_SRS_UAMQP_MESSAGING_41_004: [If no failures occur, encoded_message shall own the encoded bytes, to be freed by the caller, and message_create_uamqp_encoding_from_iothub_message() shall return 0.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_success)
+{
+    // arrange
+    BINARY_DATA encoded_message;
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message();
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, &encoded_message);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 3 * TEST_ENCODED_SECTION_SIZE, encoded_message.length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(encoded_message.bytes + 2 * TEST_ENCODED_SECTION_SIZE, TEST_ENCODED_SECTION, TEST_ENCODED_SECTION_SIZE));
+
+    // cleanup
+    real_free((void*)encoded_message.bytes);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_005: [If any failure occurs, message_create_uamqp_encoding_from_iothub_message() shall free any memory it allocated and return a non-zero value.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_encode_fails)
+{
+    // arrange
+    BINARY_DATA encoded_message;
+    data test_data = { NULL, 0 };
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_from_iothub_message(1, IOTHUBMESSAGE_BYTEARRAY, true, true, true);
+    STRICT_EXPECTED_CALL(message_get_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_properties(&TEST_PROPERTIES_HANDLE_PTR, sizeof(PROPERTIES_HANDLE));
+    STRICT_EXPECTED_CALL(amqpvalue_create_properties(TEST_PROPERTIES_HANDLE));
+    STRICT_EXPECTED_CALL(message_get_application_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(TEST_MESSAGE_HANDLE, 0, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_create_data(test_data)).IgnoreArgument_value();
+    STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
+    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(2 * TEST_ENCODED_SECTION_SIZE));
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, &encoded_message);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
 END_TEST_SUITE(uamqp_messaging_ut)
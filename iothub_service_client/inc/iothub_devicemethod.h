@@ -28,6 +28,22 @@ DEFINE_ENUM(IOTHUB_DEVICE_METHOD_RESULT, IOTHUB_DEVICE_METHOD_RESULT_VALUES);
 */
 typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_TAG* IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE;
 
+/** @brief  Called once per device as the asynchronous invocations complete.
+*
+* @param    result                  IOTHUB_DEVICE_METHOD_OK if the method was called on the device.
+*                                   Devices not invoked yet when the handle is destroyed are reported
+*                                   with IOTHUB_DEVICE_METHOD_ERROR.
+* @param    deviceId                The device the method was called on.
+* @param    responseStatus          The return status of the method on the device.
+* @param    responsePayload         The response payload, only valid during the callback.
+* @param    responsePayloadSize     The size of the response payload.
+* @param    userContextCallback     The context passed to the invoke function.
+*
+*           The callback runs on a worker thread of the device method client. Calls for one
+*           invocation are serialized. The callback must not destroy the device method handle.
+*/
+typedef void(*IOTHUB_DEVICE_METHOD_INVOKE_CALLBACK)(IOTHUB_DEVICE_METHOD_RESULT result, const char* deviceId, int responseStatus, const unsigned char* responsePayload, size_t responsePayloadSize, void* userContextCallback);
+
 /** @brief	Creates a IoT Hub Service Client DeviceMethod handle for use it in consequent APIs.
 *
 * @param	serviceClientHandle	Service client handle.
@@ -55,6 +71,36 @@ MOCKABLE_FUNCTION(, void,  IoTHubDeviceMethod_Destroy, IOTHUB_SERVICE_CLIENT_DEV
 */
 MOCKABLE_FUNCTION(, IOTHUB_DEVICE_METHOD_RESULT,  IoTHubDeviceMethod_Invoke, IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, serviceClientDeviceMethodHandle, const char*, deviceId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, int*, responseStatus, unsigned char**, responsePayload, size_t*, responsePayloadSize);
 
+/** @brief	Call a method on a device without waiting for the response.
+*
+* @param	serviceClientDeviceMethodHandle	The handle created by a call to the create function.
+* @param    deviceId                        The device name (id) to call a method on.
+* @param    methodName                      The method name to call.
+* @param    methodPayload                   The message payload to send.
+* @param    timeout                         The method timeout on the device, in seconds.
+* @param    invokeCallback                  Called with the result when the device responds.
+* @param    userContextCallback             User specified context that will be provided to the callback.
+*
+* @return	IOTHUB_DEVICE_METHOD_OK if the call was started; the callback is not called otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_DEVICE_METHOD_RESULT, IoTHubDeviceMethod_InvokeAsync, IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, serviceClientDeviceMethodHandle, const char*, deviceId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, IOTHUB_DEVICE_METHOD_INVOKE_CALLBACK, invokeCallback, void*, userContextCallback);
+
+/** @brief	Call a method on a list of devices, at most maxConcurrency at a time, without waiting for the responses.
+*
+* @param	serviceClientDeviceMethodHandle	The handle created by a call to the create function.
+* @param    deviceIds                       The devices to call the method on. Copied before the function returns.
+* @param    deviceCount                     The number of entries in deviceIds.
+* @param    methodName                      The method name to call.
+* @param    methodPayload                   The message payload to send.
+* @param    timeout                         The method timeout on each device, in seconds.
+* @param    maxConcurrency                  The maximum number of devices called at the same time.
+* @param    invokeCallback                  Called once per device as each one completes.
+* @param    userContextCallback             User specified context that will be provided to the callback.
+*
+* @return	IOTHUB_DEVICE_METHOD_OK if the calls were started; the callback is not called otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_DEVICE_METHOD_RESULT, IoTHubDeviceMethod_InvokeOnDevices, IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, serviceClientDeviceMethodHandle, const char* const*, deviceIds, size_t, deviceCount, const char*, methodName, const char*, methodPayload, unsigned int, timeout, size_t, maxConcurrency, IOTHUB_DEVICE_METHOD_INVOKE_CALLBACK, invokeCallback, void*, userContextCallback);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@ extern "C"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/map.h"
 #include <time.h>
+#include <stdbool.h>
 #include "iothub_service_client_auth.h"
 
 #include "azure_c_shared_utility/umock_c_prod.h"
@@ -32,6 +33,15 @@ DEFINE_ENUM(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_RESULT_VALUES);
 */
 typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_TAG* IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE;
 
+/** @brief  Callback invoked by IoTHubDeviceTwin_Query for every twin in the result set.
+*
+* @param    deviceTwinJson          The twin as a JSON string, valid only during the call.
+* @param    userContextCallback     User specified context passed to IoTHubDeviceTwin_Query.
+*
+* @return   true to continue the query, false to stop it.
+*/
+typedef bool(*IOTHUB_DEVICE_TWIN_QUERY_CALLBACK)(const char* deviceTwinJson, void* userContextCallback);
+
 
 /** @brief	Creates a IoT Hub Service Client DeviceTwin handle for use it in consequent APIs.
 *
@@ -69,6 +79,18 @@ MOCKABLE_FUNCTION(, char*,  IoTHubDeviceTwin_GetTwin, IOTHUB_SERVICE_CLIENT_DEVI
 */
 MOCKABLE_FUNCTION(, char*,  IoTHubDeviceTwin_UpdateTwin, IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, serviceClientDeviceTwinHandle, const char*, deviceId, const char*, deviceTwinJson);
 
+/** @brief	Runs a twin query against the IoT Hub and passes every matching twin to a callback.
+*
+* @param	serviceClientDeviceTwinHandle	The handle created by a call to the create function.
+* @param    sqlQuery                        The query, e.g. "SELECT * FROM devices WHERE tags.location = 'US'".
+* @param    pageSize                        Maximum number of twins requested per round trip (1 to 1000).
+* @param    queryCallback                   Callback invoked for every twin, one page at a time.
+* @param    userContextCallback             User specified context passed to the callback.
+*
+* @return	IOTHUB_DEVICE_TWIN_OK once all the pages were read or the callback stopped the query, an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_DEVICE_TWIN_RESULT, IoTHubDeviceTwin_Query, IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, serviceClientDeviceTwinHandle, const char*, sqlQuery, size_t, pageSize, IOTHUB_DEVICE_TWIN_QUERY_CALLBACK, queryCallback, void*, userContextCallback);
+
 #ifdef __cplusplus
 }
 #endif
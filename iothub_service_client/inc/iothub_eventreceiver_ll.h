@@ -0,0 +1,135 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// This file is under development and it is subject to change
+
+#ifndef IOTHUB_EVENTRECEIVER_LL_H
+#define IOTHUB_EVENTRECEIVER_LL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "iothub_message.h"
+#include "iothub_service_client_auth.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#else
+#endif
+
+#define IOTHUB_EVENT_RECEIVER_RESULT_VALUES       \
+    IOTHUB_EVENT_RECEIVER_OK,                     \
+    IOTHUB_EVENT_RECEIVER_INVALID_ARG,            \
+    IOTHUB_EVENT_RECEIVER_ERROR,                  \
+    IOTHUB_EVENT_RECEIVER_PARTITION_EXIST,        \
+    IOTHUB_EVENT_RECEIVER_PARTITION_NOT_FOUND     \
+
+DEFINE_ENUM(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_RESULT_VALUES);
+
+/** @brief Position of a received event in its partition. The strings are only valid
+*          during the callback they are given to.
+*/
+typedef struct IOTHUB_EVENT_INFO_TAG
+{
+    const char* partitionId;
+    const char* offset;
+    int64_t sequenceNumber;
+    int64_t enqueuedTimeUtc;
+    const char* connectionDeviceId;
+} IOTHUB_EVENT_INFO;
+
+/** @brief Handle to hide struct and use it in consequent APIs
+*/
+typedef struct IOTHUB_EVENT_RECEIVER_LL_TAG* IOTHUB_EVENT_RECEIVER_LL_HANDLE;
+
+/** @brief  Callback invoked for every event received on a partition. The message
+*           is destroyed when the callback returns.
+*/
+typedef void(*IOTHUB_EVENT_RECEIVED_CALLBACK)(void* context, IOTHUB_MESSAGE_HANDLE message, const IOTHUB_EVENT_INFO* eventInfo);
+
+/** @brief  Callback invoked every checkpointInterval events of a partition, and when
+*           the partition is closed, with the position of the last event delivered.
+*           Storing offset allows a later IoTHubEventReceiver_LL_OpenPartition to resume there.
+*/
+typedef void(*IOTHUB_EVENT_CHECKPOINT_CALLBACK)(void* context, const char* partitionId, const char* offset, int64_t sequenceNumber);
+
+/** @brief	Creates a receiver for the Event Hub-compatible endpoint of an IoT Hub.
+*
+* @param	serviceClientHandle         Service client handle, its key name and key sign the connection.
+* @param	eventHubHostName            Host name of the Event Hub-compatible endpoint, e.g. "ihsuprodbyres001dednamespace.servicebus.windows.net".
+* @param	eventHubName                Event Hub-compatible name of the IoT Hub.
+* @param	consumerGroup               Consumer group to read from, NULL for "$Default".
+*
+* @return	A non-NULL @c IOTHUB_EVENT_RECEIVER_LL_HANDLE value that is used when
+* 			invoking other functions for the receiver and @c NULL on failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_EVENT_RECEIVER_LL_HANDLE, IoTHubEventReceiver_LL_Create, IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, serviceClientHandle, const char*, eventHubHostName, const char*, eventHubName, const char*, consumerGroup);
+
+/** @brief	Closes every partition and disposes of resources allocated by IoTHubEventReceiver_LL_Create.
+*
+* @param	eventReceiverHandle	The handle created by a call to the create function.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubEventReceiver_LL_Destroy, IOTHUB_EVENT_RECEIVER_LL_HANDLE, eventReceiverHandle);
+
+/** @brief	Sets how many events the hub may send ahead on each partition link. Applies to the
+*           partitions opened afterwards; 0 keeps the uAMQP default.
+*
+* @param	eventReceiverHandle	The handle created by a call to the create function.
+* @param	prefetchCount       Link credit of each partition link.
+*
+* @return	IOTHUB_EVENT_RECEIVER_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_EVENT_RECEIVER_RESULT, IoTHubEventReceiver_LL_SetPrefetchCount, IOTHUB_EVENT_RECEIVER_LL_HANDLE, eventReceiverHandle, uint32_t, prefetchCount);
+
+/** @brief	Sets the callback reporting the progress of the partitions.
+*
+* @param	eventReceiverHandle	The handle created by a call to the create function.
+* @param	checkpointCallback  Callback to invoke, NULL to stop reporting.
+* @param	userContextCallback User specified context passed to the callback.
+* @param	checkpointInterval  Number of events of a partition between two calls, at least 1.
+*
+* @return	IOTHUB_EVENT_RECEIVER_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_EVENT_RECEIVER_RESULT, IoTHubEventReceiver_LL_SetCheckpointCallback, IOTHUB_EVENT_RECEIVER_LL_HANDLE, eventReceiverHandle, IOTHUB_EVENT_CHECKPOINT_CALLBACK, checkpointCallback, void*, userContextCallback, size_t, checkpointInterval);
+
+/** @brief	Starts receiving the events of a partition on its own link. The connection is opened
+*           with the first partition and shared by the others. To consume partitions in parallel,
+*           spread them over several receivers, each driven by its own thread.
+*
+* @param	eventReceiverHandle	The handle created by a call to the create function.
+* @param	partitionId         Id of the partition, "0" to partition count - 1.
+* @param	startOffset         Offset of the last event already processed, NULL to read only new events.
+* @param	eventCallback       Callback invoked for every event of the partition.
+* @param	userContextCallback User specified context passed to the callback.
+*
+* @return	IOTHUB_EVENT_RECEIVER_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_EVENT_RECEIVER_RESULT, IoTHubEventReceiver_LL_OpenPartition, IOTHUB_EVENT_RECEIVER_LL_HANDLE, eventReceiverHandle, const char*, partitionId, const char*, startOffset, IOTHUB_EVENT_RECEIVED_CALLBACK, eventCallback, void*, userContextCallback);
+
+/** @brief	Stops receiving the events of a partition, reporting its last checkpoint.
+*
+* @param	eventReceiverHandle	The handle created by a call to the create function.
+* @param	partitionId         Id of the partition given to IoTHubEventReceiver_LL_OpenPartition.
+*
+* @return	IOTHUB_EVENT_RECEIVER_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_EVENT_RECEIVER_RESULT, IoTHubEventReceiver_LL_ClosePartition, IOTHUB_EVENT_RECEIVER_LL_HANDLE, eventReceiverHandle, const char*, partitionId);
+
+/** @brief	Closes every partition and the connection.
+*
+* @param	eventReceiverHandle	The handle created by a call to the create function.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubEventReceiver_LL_Close, IOTHUB_EVENT_RECEIVER_LL_HANDLE, eventReceiverHandle);
+
+/** @brief	Sends and receives the pending AMQP frames; the event and checkpoint callbacks are invoked from here.
+*
+* @param	eventReceiverHandle	The handle created by a call to the create function.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubEventReceiver_LL_DoWork, IOTHUB_EVENT_RECEIVER_LL_HANDLE, eventReceiverHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_EVENTRECEIVER_LL_H
@@ -0,0 +1,138 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// This file is under development and it is subject to change
+
+#ifndef IOTHUB_JOBS_H
+#define IOTHUB_JOBS_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#else
+#endif
+
+#include <stddef.h>
+#include <time.h>
+#include "iothub_service_client_auth.h"
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#define IOTHUB_JOBS_RESULT_VALUES                \
+    IOTHUB_JOBS_OK,                              \
+    IOTHUB_JOBS_INVALID_ARG,                     \
+    IOTHUB_JOBS_ERROR,                           \
+    IOTHUB_JOBS_HTTPAPI_ERROR,                   \
+    IOTHUB_JOBS_HTTP_STATUS_ERROR,               \
+    IOTHUB_JOBS_JSON_ERROR                       \
+
+DEFINE_ENUM(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_RESULT_VALUES);
+
+#define IOTHUB_JOB_TYPE_VALUES                   \
+    IOTHUB_JOB_TYPE_UNKNOWN,                     \
+    IOTHUB_JOB_TYPE_SCHEDULE_UPDATE_TWIN,        \
+    IOTHUB_JOB_TYPE_SCHEDULE_DEVICE_METHOD       \
+
+DEFINE_ENUM(IOTHUB_JOB_TYPE, IOTHUB_JOB_TYPE_VALUES);
+
+#define IOTHUB_JOB_STATUS_VALUES                 \
+    IOTHUB_JOB_STATUS_UNKNOWN,                   \
+    IOTHUB_JOB_STATUS_QUEUED,                    \
+    IOTHUB_JOB_STATUS_SCHEDULED,                 \
+    IOTHUB_JOB_STATUS_RUNNING,                   \
+    IOTHUB_JOB_STATUS_COMPLETED,                 \
+    IOTHUB_JOB_STATUS_FAILED,                    \
+    IOTHUB_JOB_STATUS_CANCELLED                  \
+
+DEFINE_ENUM(IOTHUB_JOB_STATUS, IOTHUB_JOB_STATUS_VALUES);
+
+/** @brief Scheduled job as reported by the IoT Hub. jobId and failureReason are
+*          allocated by the jobs client and must be freed by the caller.
+*/
+typedef struct IOTHUB_JOB_TAG
+{
+    const char* jobId;
+    IOTHUB_JOB_TYPE type;
+    IOTHUB_JOB_STATUS status;
+    const char* failureReason;
+    size_t deviceCount;
+    size_t succeededCount;
+    size_t failedCount;
+    size_t runningCount;
+    size_t pendingCount;
+} IOTHUB_JOB;
+
+/** @brief Handle to hide struct and use it in consequent APIs
+*/
+typedef struct IOTHUB_SERVICE_CLIENT_JOBS_TAG* IOTHUB_SERVICE_CLIENT_JOBS_HANDLE;
+
+/** @brief	Creates a IoT Hub Service Client Jobs handle for use it in consequent APIs.
+*
+* @param	serviceClientHandle	Service client handle.
+*
+* @return	A non-NULL @c IOTHUB_SERVICE_CLIENT_JOBS_HANDLE value that is used when
+* 			invoking other functions for IoT Hub Jobs and @c NULL on failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, IoTHubJobs_Create, IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, serviceClientHandle);
+
+/** @brief	Disposes of resources allocated by the IoT Hub IoTHubJobs_Create.
+*
+* @param	serviceClientJobsHandle	The handle created by a call to the create function.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubJobs_Destroy, IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, serviceClientJobsHandle);
+
+/** @brief	Schedules a job applying a twin patch to every device matching a query condition.
+*
+* @param	serviceClientJobsHandle	        The handle created by a call to the create function.
+* @param    jobId                           Unique Id of the new job.
+* @param    queryCondition                  Condition selecting the devices, e.g. "tags.building = '43'".
+* @param    twinPatchJson                   Twin patch to apply, e.g. {"properties":{"desired":{"fw":"1.2"}}}.
+* @param    startTime                       Time the job starts at, 0 to start now.
+* @param    maxExecutionTimeInSeconds       Time after which the IoT Hub stops the job.
+* @param    job                             Output parameter, will contain the created job.
+*
+* @return	IOTHUB_JOBS_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_JOBS_RESULT, IoTHubJobs_ScheduleTwinUpdate, IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, serviceClientJobsHandle, const char*, jobId, const char*, queryCondition, const char*, twinPatchJson, time_t, startTime, unsigned int, maxExecutionTimeInSeconds, IOTHUB_JOB*, job);
+
+/** @brief	Schedules a job invoking a device method on every device matching a query condition.
+*
+* @param	serviceClientJobsHandle	        The handle created by a call to the create function.
+* @param    jobId                           Unique Id of the new job.
+* @param    queryCondition                  Condition selecting the devices, e.g. "tags.building = '43'".
+* @param    methodName                      Name of the method to call.
+* @param    methodPayload                   JSON payload of the method, NULL for none.
+* @param    responseTimeoutInSeconds        Time each device has to answer the call.
+* @param    startTime                       Time the job starts at, 0 to start now.
+* @param    maxExecutionTimeInSeconds       Time after which the IoT Hub stops the job.
+* @param    job                             Output parameter, will contain the created job.
+*
+* @return	IOTHUB_JOBS_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_JOBS_RESULT, IoTHubJobs_ScheduleDeviceMethod, IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, serviceClientJobsHandle, const char*, jobId, const char*, queryCondition, const char*, methodName, const char*, methodPayload, unsigned int, responseTimeoutInSeconds, time_t, startTime, unsigned int, maxExecutionTimeInSeconds, IOTHUB_JOB*, job);
+
+/** @brief	Gets the status and the device statistics of a scheduled job.
+*
+* @param	serviceClientJobsHandle	        The handle created by a call to the create function.
+* @param    jobId                           The Id of the job.
+* @param    job                             Output parameter, will contain the job.
+*
+* @return	IOTHUB_JOBS_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_JOBS_RESULT, IoTHubJobs_GetJob, IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, serviceClientJobsHandle, const char*, jobId, IOTHUB_JOB*, job);
+
+/** @brief	Cancels a scheduled or running job.
+*
+* @param	serviceClientJobsHandle	        The handle created by a call to the create function.
+* @param    jobId                           The Id of the job.
+* @param    job                             Output parameter, will contain the cancelled job.
+*
+* @return	IOTHUB_JOBS_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_JOBS_RESULT, IoTHubJobs_CancelJob, IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, serviceClientJobsHandle, const char*, jobId, IOTHUB_JOB*, job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_JOBS_H
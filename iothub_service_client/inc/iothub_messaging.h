@@ -90,6 +90,25 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_SendAsync, IOTHUB_M
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_SetFeedbackMessageCallback, IOTHUB_MESSAGING_CLIENT_HANDLE, messagingClientHandle, IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, feedbackMessageReceivedCallback, void*, userContextCallback);
 
+/** @brief	Creates a process wide pool of worker threads that serves all the
+*			messaging clients sending afterwards, whatever IoT hub they are
+*			connected to, instead of one thread per client. A client is never
+*			served by two threads at once.
+*
+* @param	threadCount	The number of worker threads, usually the number of cores.
+*
+*			This function is not thread safe and shall be called before
+*			creating any messaging client, in the same way as platform_init.
+*
+* @return	IOTHUB_MESSAGING_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_WorkerPool_Init, size_t, threadCount);
+
+/** @brief	Destroys the process wide worker pool. All the messaging clients
+*			using it shall have been destroyed before calling this function.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubMessaging_WorkerPool_Deinit);
+
 #ifdef __cplusplus
 }
 #endif
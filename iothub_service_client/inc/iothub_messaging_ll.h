@@ -9,6 +9,7 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/map.h"
+#include <stdbool.h>
 #include "iothub_message.h"
 #include "iothub_service_client_auth.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
@@ -70,6 +71,7 @@ typedef struct IOTHUB_MESSAGING_TAG* IOTHUB_MESSAGING_HANDLE;
 typedef void(*IOTHUB_OPEN_COMPLETE_CALLBACK)(void* context);
 typedef void(*IOTHUB_SEND_COMPLETE_CALLBACK)(void* context, IOTHUB_MESSAGING_RESULT messagingResult);
 typedef void(*IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK)(void* context, IOTHUB_SERVICE_FEEDBACK_BATCH* feedbackBatch);
+typedef void(*IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK)(void* context, const IOTHUB_SERVICE_FEEDBACK_RECORD* feedbackRecord);
 
 /** @brief	Creates a IoT Hub Service Client Messaging handle for use it in consequent APIs.
 *
@@ -143,6 +145,55 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_Send, IOTHUB_MES
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_SetFeedbackMessageCallback, IOTHUB_MESSAGING_HANDLE, messagingHandle, IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, feedbackMessageReceivedCallback, void*, userContextCallback);
 
+/**
+* @brief	This API specifies a callback to be called once for every record of a received feedback message.
+*
+* @param	messagingHandle		        The handle created by a call to the create function.
+* @param	feedbackRecordReceivedCallback	    The callback specified by the user. The record and its strings point into
+*									            the parsed feedback message and are only valid during the call; nothing
+*									            is copied or allocated per record. When set, it is used instead of the
+*									            IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK. NULL restores the batch callback.
+* @param	userContextCallback		            User specified context that will be provided to the
+* 									            callback. This can be @c NULL.
+*
+* @return	IOTHUB_MESSAGING_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_SetFeedbackRecordCallback, IOTHUB_MESSAGING_HANDLE, messagingHandle, IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, feedbackRecordReceivedCallback, void*, userContextCallback);
+
+/**
+* @brief	Asks the IoT Hub to send feedback messages pre-settled, so no disposition is sent back for them.
+*
+* @param	messagingHandle		        The handle created by a call to the create function.
+* @param	presettled	                true to receive pre-settled feedback. Feedback that fails to parse can then
+*									            not be rejected and is lost (at most once delivery). Applies to the next
+*									            IoTHubMessaging_LL_Open. false (the default) settles every feedback message.
+*
+* @return	IOTHUB_MESSAGING_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_SetFeedbackPresettled, IOTHUB_MESSAGING_HANDLE, messagingHandle, bool, presettled);
+
+/**
+* @brief	Bounds the number of sends that may wait for their completion callback at the same time.
+*
+* @param	messagingHandle		        The handle created by a call to the create function.
+* @param	maxOutstandingSends	        The largest number of pending sends. While that many sends are
+*									            pending IoTHubMessaging_LL_Send fails with IOTHUB_MESSAGING_ERROR.
+*									            0 (the default) means no bound.
+*
+* @return	IOTHUB_MESSAGING_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_SetMaxOutstandingSends, IOTHUB_MESSAGING_HANDLE, messagingHandle, size_t, maxOutstandingSends);
+
+/**
+* @brief	Reports how many sends wait for their completion callback.
+*
+* @param	messagingHandle		        The handle created by a call to the create function.
+* @param	pendingSendCount	        Receives the number of pending sends.
+*
+* @return	IOTHUB_MESSAGING_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_GetPendingSendCount, IOTHUB_MESSAGING_HANDLE, messagingHandle, size_t*, pendingSendCount);
+
 /**
 * @brief	This function is meant to be called by the user when work
 * 			(sending/receiving) can be done by the IoTHubServiceClient.
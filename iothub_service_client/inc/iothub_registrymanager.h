@@ -82,6 +82,45 @@ typedef struct IOTHUB_REGISTRY_STATISTIC_TAG
     size_t disabledDeviceCount;
 } IOTHUB_REGISTRY_STATISTICS;
 
+/** @brief Maximum number of devices the IoT Hub accepts in one bulk registry request;
+*          IoTHubRegistryManager_BulkDevices splits larger sets into batches of this size.
+*/
+#define IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES 100
+
+#define IOTHUB_REGISTRY_BULK_OPERATION_VALUES      \
+    IOTHUB_REGISTRY_BULK_CREATE,                   \
+    IOTHUB_REGISTRY_BULK_UPDATE,                   \
+    IOTHUB_REGISTRY_BULK_DELETE                    \
+
+DEFINE_ENUM(IOTHUB_REGISTRY_BULK_OPERATION, IOTHUB_REGISTRY_BULK_OPERATION_VALUES);
+
+#define IOTHUB_REGISTRY_JOB_STATUS_VALUES          \
+    IOTHUB_REGISTRY_JOB_STATUS_UNKNOWN,            \
+    IOTHUB_REGISTRY_JOB_STATUS_ENQUEUED,           \
+    IOTHUB_REGISTRY_JOB_STATUS_RUNNING,            \
+    IOTHUB_REGISTRY_JOB_STATUS_COMPLETED,          \
+    IOTHUB_REGISTRY_JOB_STATUS_FAILED,             \
+    IOTHUB_REGISTRY_JOB_STATUS_CANCELLED           \
+
+DEFINE_ENUM(IOTHUB_REGISTRY_JOB_STATUS, IOTHUB_REGISTRY_JOB_STATUS_VALUES);
+
+/** @brief Import or export job. jobId and failureReason are allocated by the
+*          registry manager and must be freed by the caller.
+*/
+typedef struct IOTHUB_REGISTRY_JOB_TAG
+{
+    const char* jobId;
+    IOTHUB_REGISTRY_JOB_STATUS status;
+    size_t progress;
+    const char* failureReason;
+} IOTHUB_REGISTRY_JOB;
+
+/** @brief Called by IoTHubRegistryManager_EnumerateDevices once for every device. The
+*          device and its strings are freed when the callback returns; copy what must be kept.
+*          Return true to continue the enumeration or false to stop it.
+*/
+typedef bool(*IOTHUB_REGISTRYMANAGER_DEVICE_CALLBACK)(const IOTHUB_DEVICE* device, void* userContextCallback);
+
 /** @brief Structure to store IoTHub authentication information
 */
 typedef struct IOTHUB_REGISTRYMANAGER_TAG
@@ -91,6 +130,7 @@ typedef struct IOTHUB_REGISTRYMANAGER_TAG
     char* iothubSuffix;
     char* sharedAccessKey;
     char* keyName;
+    struct IOTHUB_SC_HTTP_POOL_TAG* httpPool;
 } IOTHUB_REGISTRYMANAGER;
 
 /** @brief Handle to hide struct and use it in consequent APIs
@@ -184,6 +224,73 @@ extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetDeviceList(IOTHUB_
 */
 extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetStatistics(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REGISTRY_STATISTICS* registryStatistics);
 
+/**
+* @brief	Creates, updates or deletes a set of devices using the bulk registry API.
+*           The devices are sent in batches of IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES
+*           and the call returns when every batch has completed.
+*
+* @param	registryManagerHandle   The handle created by a call to the create function.
+* @param    operation               The operation applied to every device.
+* @param    devices                 Array of deviceCount devices. For delete only deviceId is used.
+* @param    deviceCount             Number of devices in the array.
+* @param    maxConcurrency          Maximum number of batches in flight at the same time.
+* @param    deviceResults           Array of deviceCount results, set to the outcome for each device.
+*
+* @return	IOTHUB_REGISTRYMANAGER_OK if every device succeeded, IOTHUB_REGISTRYMANAGER_ERROR
+*           if any failed (see deviceResults) or an error code upon failure.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_BulkDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REGISTRY_BULK_OPERATION operation, const IOTHUB_REGISTRY_DEVICE_UPDATE* devices, size_t deviceCount, size_t maxConcurrency, IOTHUB_REGISTRYMANAGER_RESULT* deviceResults);
+
+/**
+* @brief	Starts a job importing the devices described in a blob container.
+*
+* @param	registryManagerHandle   The handle created by a call to the create function.
+* @param    inputBlobContainerUri   SAS URI of the container holding devices.txt.
+* @param    outputBlobContainerUri  SAS URI of the container the job writes its log to.
+* @param    job                     Output parameter, will contain the created job.
+*
+* @return	IOTHUB_REGISTRYMANAGER_RESULT_OK upon success or an error code upon failure.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_ImportDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* inputBlobContainerUri, const char* outputBlobContainerUri, IOTHUB_REGISTRY_JOB* job);
+
+/**
+* @brief	Starts a job exporting every device of the IoT Hub to a blob container.
+*
+* @param	registryManagerHandle   The handle created by a call to the create function.
+* @param    outputBlobContainerUri  SAS URI of the container the job writes devices.txt to.
+* @param    excludeKeys             If true the device keys are left out of the export.
+* @param    job                     Output parameter, will contain the created job.
+*
+* @return	IOTHUB_REGISTRYMANAGER_RESULT_OK upon success or an error code upon failure.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_ExportDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* outputBlobContainerUri, bool excludeKeys, IOTHUB_REGISTRY_JOB* job);
+
+/**
+* @brief	Gets the status of an import or export job.
+*
+* @param	registryManagerHandle   The handle created by a call to the create function.
+* @param    jobId                   The Id of the job.
+* @param    job                     Output parameter, will contain the job status.
+*
+* @return	IOTHUB_REGISTRYMANAGER_RESULT_OK upon success or an error code upon failure.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetJob(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* jobId, IOTHUB_REGISTRY_JOB* job);
+
+/**
+* @brief	Enumerates every device registered on the IoT Hub, page by page, using the
+*           query API. Unlike IoTHubRegistryManager_GetDeviceList there is no limit on
+*           the number of devices and only one page is held in memory at a time.
+*           The query returns the device twins, so the device keys are not populated.
+*
+* @param	registryManagerHandle   The handle created by a call to the create function.
+* @param    pageSize                Number of devices requested per page, between 1 and 1000.
+* @param    deviceCallback          Called once for every device.
+* @param    userContextCallback     User specified context passed to deviceCallback.
+*
+* @return	IOTHUB_REGISTRYMANAGER_RESULT_OK upon success or an error code upon failure.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_EnumerateDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, size_t pageSize, IOTHUB_REGISTRYMANAGER_DEVICE_CALLBACK deviceCallback, void* userContextCallback);
+
 #ifdef __cplusplus
 }
 #endif
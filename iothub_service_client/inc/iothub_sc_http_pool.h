@@ -0,0 +1,84 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_sc_http_pool.h
+*   @brief Pool of HTTP connections and SAS token shared by the service client APIs
+*
+*   @details The pool is created together with the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE
+*            and every registry manager, device twin and device method handle made
+*            from it holds a reference. Requests reuse idle connections to the
+*            IoT Hub and a SAS token that is signed again only when it is close to
+*            expiring. All the functions are thread-safe.
+*/
+
+#ifndef IOTHUB_SC_HTTP_POOL_H
+#define IOTHUB_SC_HTTP_POOL_H
+
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct IOTHUB_SC_HTTP_POOL_TAG* IOTHUB_SC_HTTP_POOL_HANDLE;
+
+/**
+* @brief    Creates a pool of connections to the given IoT Hub. The pool starts with one reference.
+*
+* @param    hostname            The IoT Hub host name.
+* @param    sharedAccessKey     The shared access key used to sign the SAS token.
+* @param    keyName             The shared access key name.
+*
+* @return   A non-NULL @c IOTHUB_SC_HTTP_POOL_HANDLE upon success or @c NULL on failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_SC_HTTP_POOL_HANDLE, IoTHubScHttpPool_Create, const char*, hostname, const char*, sharedAccessKey, const char*, keyName);
+
+/**
+* @brief    Adds a reference to the pool.
+*
+* @param    httpPool    The pool to share.
+*
+* @return   @p httpPool upon success or @c NULL on failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_SC_HTTP_POOL_HANDLE, IoTHubScHttpPool_Clone, IOTHUB_SC_HTTP_POOL_HANDLE, httpPool);
+
+/**
+* @brief    Releases a reference to the pool. The last reference closes the idle connections and frees the pool.
+*
+* @param    httpPool    The pool to release.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubScHttpPool_Destroy, IOTHUB_SC_HTTP_POOL_HANDLE, httpPool);
+
+/**
+* @brief    Executes one HTTP request on a pooled connection, setting its Authorization header to the cached SAS token.
+*
+* @param    httpPool                    The pool.
+* @param    requestType                 The HTTP verb.
+* @param    relativePath                The path of the request on the IoT Hub.
+* @param    requestHttpHeadersHandle    The request headers.
+* @param    requestContent              The request body. This can be @c NULL.
+* @param    statusCode                  Receives the HTTP status code. This can be @c NULL.
+* @param    responseContent             Receives the response body. This can be @c NULL.
+*
+* @return   The result of HTTPAPIEX_ExecuteRequest, or an error if the request could not be started.
+*/
+MOCKABLE_FUNCTION(, HTTPAPIEX_RESULT, IoTHubScHttpPool_ExecuteRequest, IOTHUB_SC_HTTP_POOL_HANDLE, httpPool, HTTPAPI_REQUEST_TYPE, requestType, const char*, relativePath, HTTP_HEADERS_HANDLE, requestHttpHeadersHandle, BUFFER_HANDLE, requestContent, unsigned int*, statusCode, BUFFER_HANDLE, responseContent);
+
+/**
+* @brief    Same as IoTHubScHttpPool_ExecuteRequest, and also returns the response headers.
+*
+* @param    responseHttpHeadersHandle   Receives the response headers. This can be @c NULL.
+*
+* @return   The result of HTTPAPIEX_ExecuteRequest, or an error if the request could not be started.
+*/
+MOCKABLE_FUNCTION(, HTTPAPIEX_RESULT, IoTHubScHttpPool_ExecuteRequestWithResponseHeaders, IOTHUB_SC_HTTP_POOL_HANDLE, httpPool, HTTPAPI_REQUEST_TYPE, requestType, const char*, relativePath, HTTP_HEADERS_HANDLE, requestHttpHeadersHandle, BUFFER_HANDLE, requestContent, unsigned int*, statusCode, HTTP_HEADERS_HANDLE, responseHttpHeadersHandle, BUFFER_HANDLE, responseContent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_SC_HTTP_POOL_H
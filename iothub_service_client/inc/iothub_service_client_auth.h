@@ -48,6 +48,7 @@ typedef struct IOTHUB_SERVICE_CLIENT_AUTH_TAG
     char* iothubSuffix;
     char* sharedAccessKey;
     char* keyName;
+    struct IOTHUB_SC_HTTP_POOL_TAG* httpPool;
 } IOTHUB_SERVICE_CLIENT_AUTH;
 
 /** @brief Handle to hide struct and use it in consequent APIs
@@ -2,15 +2,20 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <ctype.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/string_tokenizer.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/httpapiex.h"
-#include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/connection_string_parser.h"
@@ -18,6 +23,7 @@
 #include "parson.h"
 #include "iothub_devicemethod.h"
 #include "iothub_sc_version.h"
+#include "iothub_sc_http_pool.h"
 
 #define IOTHUB_DEVICE_METHOD_REQUEST_MODE_VALUES    \
     IOTHUB_DEVICEMETHOD_REQUEST_INVOKE
@@ -46,8 +52,34 @@ typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_TAG
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
+    LOCK_HANDLE asyncInvocationsLock;
+    DLIST_ENTRY asyncInvocations;
 } IOTHUB_SERVICE_CLIENT_DEVICE_METHOD;
 
+/** @brief Structure to store one asynchronous invocation of a method on a list of devices
+*/
+typedef struct DEVICE_METHOD_ASYNC_INVOCATION_TAG
+{
+    DLIST_ENTRY entry;
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle;
+    char** deviceIds;
+    size_t deviceCount;
+    char* methodName;
+    char* methodPayload;
+    unsigned int timeout;
+    IOTHUB_DEVICE_METHOD_INVOKE_CALLBACK invokeCallback;
+    void* userContextCallback;
+    THREAD_HANDLE* workers;
+    size_t workerCount;
+    /* lock protects nextDevice, exitedWorkers and cancelled; callbackLock serializes the calls to invokeCallback */
+    LOCK_HANDLE lock;
+    LOCK_HANDLE callbackLock;
+    size_t nextDevice;
+    size_t exitedWorkers;
+    bool cancelled;
+} DEVICE_METHOD_ASYNC_INVOCATION;
+
 static IOTHUB_DEVICE_METHOD_RESULT parseResponseJson(BUFFER_HANDLE responseJson, int* responseStatus, unsigned char** responsePayload, size_t* responsePayloadSize)
 {
     IOTHUB_DEVICE_METHOD_RESULT result;
@@ -236,58 +268,13 @@ static IOTHUB_DEVICE_METHOD_RESULT sendHttpRequestDeviceMethod(IOTHUB_SERVICE_CL
 {
     IOTHUB_DEVICE_METHOD_RESULT result;
 
-    STRING_HANDLE uriResouce;
-    STRING_HANDLE accessKey;
-    STRING_HANDLE keyName;
-    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle;
-    HTTPAPIEX_HANDLE httpExApiHandle;
     HTTP_HEADERS_HANDLE httpHeader;
 
-    if ((uriResouce = STRING_construct(serviceClientDeviceMethodHandle->hostname)) == NULL)
-    {
-        LogError("STRING_construct failed for uriResource");
-        result = IOTHUB_DEVICE_METHOD_ERROR;
-    }
-    else if ((accessKey = STRING_construct(serviceClientDeviceMethodHandle->sharedAccessKey)) == NULL)
-    {
-        LogError("STRING_construct failed for accessKey");
-        STRING_delete(uriResouce);
-        result = IOTHUB_DEVICE_METHOD_ERROR;
-    }
-    else if ((keyName = STRING_construct(serviceClientDeviceMethodHandle->keyName)) == NULL)
-    {
-        LogError("STRING_construct failed for keyName");
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
-        result = IOTHUB_DEVICE_METHOD_ERROR;
-    }
-    else if ((httpHeader = createHttpHeader()) == NULL)
+    if ((httpHeader = createHttpHeader()) == NULL)
     {
         LogError("HttpHeader creation failed");
-        STRING_delete(keyName);
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
         result = IOTHUB_DEVICE_METHOD_ERROR;
     }
-    else if ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResouce, keyName)) == NULL)
-    {
-        LogError("HTTPAPIEX_SAS_Create failed");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(keyName);
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
-        result = IOTHUB_DEVICE_METHOD_HTTPAPI_ERROR;
-    }
-    else if ((httpExApiHandle = HTTPAPIEX_Create(serviceClientDeviceMethodHandle->hostname)) == NULL)
-    {
-        LogError("HTTPAPIEX_Create failed");
-        HTTPAPIEX_SAS_Destroy(httpExApiSasHandle);
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(keyName);
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
-        result = IOTHUB_DEVICE_METHOD_HTTPAPI_ERROR;
-    }
     else 
     {
         HTTPAPI_REQUEST_TYPE httpApiRequestType = HTTPAPI_REQUEST_GET;
@@ -316,9 +303,9 @@ static IOTHUB_DEVICE_METHOD_RESULT sendHttpRequestDeviceMethod(IOTHUB_SERVICE_CL
                 LogError("Failure creating relative path");
                 result = IOTHUB_DEVICE_METHOD_ERROR;
             }
-            else if (HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, STRING_c_str(relativePath), httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
+            else if (IoTHubScHttpPool_ExecuteRequest(serviceClientDeviceMethodHandle->httpPool, httpApiRequestType, STRING_c_str(relativePath), httpHeader, deviceJsonBuffer, &statusCode, responseBuffer) != HTTPAPIEX_OK)
             {
-                LogError("HTTPAPIEX_SAS_ExecuteRequest failed");
+                LogError("IoTHubScHttpPool_ExecuteRequest failed");
                 STRING_delete(relativePath);
                 result = IOTHUB_DEVICE_METHOD_HTTPAPI_ERROR;
             }
@@ -336,16 +323,288 @@ static IOTHUB_DEVICE_METHOD_RESULT sendHttpRequestDeviceMethod(IOTHUB_SERVICE_CL
                 }
             }
         }
-        HTTPAPIEX_Destroy(httpExApiHandle);
-        HTTPAPIEX_SAS_Destroy(httpExApiSasHandle);
         HTTPHeaders_Free(httpHeader);
-        STRING_delete(keyName);
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
     }
     return result;
 }
 
+static void freeAsyncInvocation(DEVICE_METHOD_ASYNC_INVOCATION* invocation)
+{
+    size_t i;
+
+    if (invocation->deviceIds != NULL)
+    {
+        for (i = 0; i < invocation->deviceCount; i++)
+        {
+            free(invocation->deviceIds[i]);
+        }
+        free(invocation->deviceIds);
+    }
+    if (invocation->lock != NULL)
+    {
+        (void)Lock_Deinit(invocation->lock);
+    }
+    if (invocation->callbackLock != NULL)
+    {
+        (void)Lock_Deinit(invocation->callbackLock);
+    }
+    free(invocation->workers);
+    free(invocation->methodName);
+    free(invocation->methodPayload);
+    free(invocation);
+}
+
+static DEVICE_METHOD_ASYNC_INVOCATION* createAsyncInvocation(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle, const char* const* deviceIds, size_t deviceCount, const char* methodName, const char* methodPayload, unsigned int timeout, IOTHUB_DEVICE_METHOD_INVOKE_CALLBACK invokeCallback, void* userContextCallback)
+{
+    DEVICE_METHOD_ASYNC_INVOCATION* result;
+
+    if ((result = (DEVICE_METHOD_ASYNC_INVOCATION*)malloc(sizeof(DEVICE_METHOD_ASYNC_INVOCATION))) == NULL)
+    {
+        LogError("Malloc failed for DEVICE_METHOD_ASYNC_INVOCATION");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(DEVICE_METHOD_ASYNC_INVOCATION));
+        result->serviceClientDeviceMethodHandle = serviceClientDeviceMethodHandle;
+        result->timeout = timeout;
+        result->invokeCallback = invokeCallback;
+        result->userContextCallback = userContextCallback;
+
+        if (mallocAndStrcpy_s(&result->methodName, methodName) != 0)
+        {
+            LogError("mallocAndStrcpy_s failed for methodName");
+            freeAsyncInvocation(result);
+            result = NULL;
+        }
+        else if (mallocAndStrcpy_s(&result->methodPayload, methodPayload) != 0)
+        {
+            LogError("mallocAndStrcpy_s failed for methodPayload");
+            freeAsyncInvocation(result);
+            result = NULL;
+        }
+        else if ((deviceCount > SIZE_MAX / sizeof(char*)) || ((result->deviceIds = (char**)malloc(deviceCount * sizeof(char*))) == NULL))
+        {
+            LogError("Malloc failed for the list of %lu device ids", (unsigned long)deviceCount);
+            freeAsyncInvocation(result);
+            result = NULL;
+        }
+        else
+        {
+            while (result->deviceCount < deviceCount)
+            {
+                if (mallocAndStrcpy_s(&result->deviceIds[result->deviceCount], deviceIds[result->deviceCount]) != 0)
+                {
+                    LogError("mallocAndStrcpy_s failed for deviceId");
+                    break;
+                }
+                result->deviceCount++;
+            }
+
+            if (result->deviceCount < deviceCount)
+            {
+                freeAsyncInvocation(result);
+                result = NULL;
+            }
+            else if ((result->lock = Lock_Init()) == NULL)
+            {
+                LogError("Lock_Init failed for the invocation lock");
+                freeAsyncInvocation(result);
+                result = NULL;
+            }
+            else if ((result->callbackLock = Lock_Init()) == NULL)
+            {
+                LogError("Lock_Init failed for the invocation callback lock");
+                freeAsyncInvocation(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
+
+static int asyncInvocationWorker(void* arg)
+{
+    DEVICE_METHOD_ASYNC_INVOCATION* invocation = (DEVICE_METHOD_ASYNC_INVOCATION*)arg;
+    bool finished = false;
+
+    while (!finished)
+    {
+        const char* deviceId = NULL;
+        bool cancelled = false;
+
+        if (Lock(invocation->lock) != LOCK_OK)
+        {
+            LogError("failed locking the device method invocation");
+            finished = true;
+        }
+        else
+        {
+            if (invocation->nextDevice < invocation->deviceCount)
+            {
+                deviceId = invocation->deviceIds[invocation->nextDevice];
+                invocation->nextDevice++;
+                cancelled = invocation->cancelled;
+            }
+            else
+            {
+                finished = true;
+            }
+            (void)Unlock(invocation->lock);
+        }
+
+        if (deviceId != NULL)
+        {
+            IOTHUB_DEVICE_METHOD_RESULT invokeResult;
+            int responseStatus = 0;
+            unsigned char* responsePayload = NULL;
+            size_t responsePayloadSize = 0;
+
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_012: [ Devices that are not invoked yet when the invocation is cancelled by IoTHubDeviceMethod_Destroy shall be reported to invokeCallback with IOTHUB_DEVICE_METHOD_ERROR ]*/
+            if (cancelled)
+            {
+                invokeResult = IOTHUB_DEVICE_METHOD_ERROR;
+            }
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_010: [ Each worker thread shall take the next device not yet invoked and call the method on it by calling IoTHubDeviceMethod_Invoke, until all the devices are invoked ]*/
+            else
+            {
+                invokeResult = IoTHubDeviceMethod_Invoke(invocation->serviceClientDeviceMethodHandle, deviceId, invocation->methodName, invocation->methodPayload, invocation->timeout, &responseStatus, &responsePayload, &responsePayloadSize);
+            }
+
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_011: [ As each device completes, the worker thread shall call invokeCallback with the result, the device id, the response status and payload and userContextCallback. Calls to invokeCallback for one invocation shall be serialized. ]*/
+            if (Lock(invocation->callbackLock) != LOCK_OK)
+            {
+                LogError("failed locking the device method invocation callback, result for device %s is lost", deviceId);
+            }
+            else
+            {
+                invocation->invokeCallback(invokeResult, deviceId, responseStatus, responsePayload, responsePayloadSize, invocation->userContextCallback);
+                (void)Unlock(invocation->callbackLock);
+            }
+            free(responsePayload);
+        }
+    }
+
+    if (Lock(invocation->lock) != LOCK_OK)
+    {
+        LogError("failed locking the device method invocation");
+    }
+    else
+    {
+        invocation->exitedWorkers++;
+        (void)Unlock(invocation->lock);
+    }
+
+    return 0;
+}
+
+static int startAsyncInvocation(DEVICE_METHOD_ASYNC_INVOCATION* invocation, size_t workerCount)
+{
+    int result;
+
+    if ((invocation->workers = (THREAD_HANDLE*)malloc(workerCount * sizeof(THREAD_HANDLE))) == NULL)
+    {
+        LogError("Malloc failed for the device method worker threads");
+        result = __FAILURE__;
+    }
+    else
+    {
+        while (invocation->workerCount < workerCount)
+        {
+            if (ThreadAPI_Create(&invocation->workers[invocation->workerCount], asyncInvocationWorker, invocation) != THREADAPI_OK)
+            {
+                LogError("ThreadAPI_Create failed for device method worker %lu", (unsigned long)invocation->workerCount);
+                break;
+            }
+            invocation->workerCount++;
+        }
+
+        if (invocation->workerCount == 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (invocation->workerCount < workerCount)
+            {
+                LogError("continuing with %lu of %lu device method workers", (unsigned long)invocation->workerCount, (unsigned long)workerCount);
+            }
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static void destroyAsyncInvocation(DEVICE_METHOD_ASYNC_INVOCATION* invocation)
+{
+    size_t i;
+
+    for (i = 0; i < invocation->workerCount; i++)
+    {
+        if (ThreadAPI_Join(invocation->workers[i], NULL) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for device method worker %lu", (unsigned long)i);
+        }
+    }
+    freeAsyncInvocation(invocation);
+}
+
+/* Must be called with asyncInvocationsLock held. The worker threads of a completed invocation have already returned, so joining them does not block. */
+static void reapCompletedAsyncInvocations(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD* serviceClientDeviceMethod)
+{
+    PDLIST_ENTRY current = serviceClientDeviceMethod->asyncInvocations.Flink;
+
+    while (current != &serviceClientDeviceMethod->asyncInvocations)
+    {
+        DEVICE_METHOD_ASYNC_INVOCATION* invocation = containingRecord(current, DEVICE_METHOD_ASYNC_INVOCATION, entry);
+        bool completed = false;
+
+        current = current->Flink;
+
+        if (Lock(invocation->lock) != LOCK_OK)
+        {
+            LogError("failed locking the device method invocation");
+        }
+        else
+        {
+            completed = (invocation->exitedWorkers == invocation->workerCount);
+            (void)Unlock(invocation->lock);
+        }
+
+        if (completed)
+        {
+            (void)DList_RemoveEntryList(&invocation->entry);
+            destroyAsyncInvocation(invocation);
+        }
+    }
+}
+
+static void destroyAsyncInvocations(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD* serviceClientDeviceMethod)
+{
+    PDLIST_ENTRY current;
+
+    /* Cancel everything first so that no invocation keeps calling devices while the earlier ones are joined */
+    for (current = serviceClientDeviceMethod->asyncInvocations.Flink; current != &serviceClientDeviceMethod->asyncInvocations; current = current->Flink)
+    {
+        DEVICE_METHOD_ASYNC_INVOCATION* invocation = containingRecord(current, DEVICE_METHOD_ASYNC_INVOCATION, entry);
+
+        if (Lock(invocation->lock) != LOCK_OK)
+        {
+            LogError("failed locking the device method invocation, it cannot be cancelled");
+        }
+        else
+        {
+            invocation->cancelled = true;
+            (void)Unlock(invocation->lock);
+        }
+    }
+
+    while (DList_IsListEmpty(&serviceClientDeviceMethod->asyncInvocations) == 0)
+    {
+        current = DList_RemoveHeadList(&serviceClientDeviceMethod->asyncInvocations);
+        destroyAsyncInvocation(containingRecord(current, DEVICE_METHOD_ASYNC_INVOCATION, entry));
+    }
+}
+
 IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE IoTHubDeviceMethod_Create(IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientHandle)
 {
     IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE result;
@@ -425,6 +684,31 @@ IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE IoTHubDeviceMethod_Create(IOTHUB_SERV
                     free(result);
                     result = NULL;
                 }
+                /*Codes_SRS_IOTHUBDEVICEMETHOD_41_001: [ IoTHubDeviceMethod_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none. If this fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
+                else if ((result->httpPool = ((serviceClientAuth->httpPool != NULL) ? IoTHubScHttpPool_Clone(serviceClientAuth->httpPool) : IoTHubScHttpPool_Create(result->hostname, result->sharedAccessKey, result->keyName))) == NULL)
+                {
+                    LogError("unable to get an HTTP connection pool");
+                    free(result->hostname);
+                    free(result->sharedAccessKey);
+                    free(result->keyName);
+                    free(result);
+                    result = NULL;
+                }
+                /*Codes_SRS_IOTHUBDEVICEMETHOD_41_004: [ IoTHubDeviceMethod_Create shall create the lock protecting the list of asynchronous invocations by calling Lock_Init. If this fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
+                else if ((result->asyncInvocationsLock = Lock_Init()) == NULL)
+                {
+                    LogError("Lock_Init failed for asyncInvocationsLock");
+                    IoTHubScHttpPool_Destroy(result->httpPool);
+                    free(result->hostname);
+                    free(result->sharedAccessKey);
+                    free(result->keyName);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    DList_InitializeListHead(&result->asyncInvocations);
+                }
             }
         }
     }
@@ -439,9 +723,15 @@ void IoTHubDeviceMethod_Destroy(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE servi
         /*Codes_SRS_IOTHUBDEVICEMETHOD_12_017: [ If the serviceClientDeviceMethodHandle input parameter is not NULL IoTHubDeviceMethod_Destroy shall free the memory of it and return ]*/
         IOTHUB_SERVICE_CLIENT_DEVICE_METHOD* serviceClientDeviceMethod = (IOTHUB_SERVICE_CLIENT_DEVICE_METHOD*)serviceClientDeviceMethodHandle;
 
+        /*Codes_SRS_IOTHUBDEVICEMETHOD_41_005: [ IoTHubDeviceMethod_Destroy shall cancel the asynchronous invocations, wait for their worker threads to exit and free them ]*/
+        destroyAsyncInvocations(serviceClientDeviceMethod);
+        (void)Lock_Deinit(serviceClientDeviceMethod->asyncInvocationsLock);
+
         free(serviceClientDeviceMethod->hostname);
         free(serviceClientDeviceMethod->sharedAccessKey);
         free(serviceClientDeviceMethod->keyName);
+        /*Codes_SRS_IOTHUBDEVICEMETHOD_41_003: [ IoTHubDeviceMethod_Destroy shall release its reference to the HTTP connection pool by calling IoTHubScHttpPool_Destroy ]*/
+        IoTHubScHttpPool_Destroy(serviceClientDeviceMethod->httpPool);
         free(serviceClientDeviceMethod);
     }
 }
@@ -478,8 +768,7 @@ IOTHUB_DEVICE_METHOD_RESULT  IoTHubDeviceMethod_Invoke(IOTHUB_SERVICE_CLIENT_DEV
         }
         /*Codes_SRS_IOTHUBDEVICEMETHOD_12_039: [ IoTHubDeviceMethod_Invoke shall create an HTTP POST request using methodPayloadBuffer ]*/
         /*Codes_SRS_IOTHUBDEVICEMETHOD_12_040: [ IoTHubDeviceMethod_Invoke shall create an HTTP POST request using the following HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-        /*Codes_SRS_IOTHUBDEVICEMETHOD_12_041: [ IoTHubDeviceMethod_Invoke shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-        /*Codes_SRS_IOTHUBDEVICEMETHOD_12_042: [ IoTHubDeviceMethod_Invoke shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
+        /*Codes_SRS_IOTHUBDEVICEMETHOD_41_002: [ IoTHubDeviceMethod_Invoke shall execute the HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
         /*Codes_SRS_IOTHUBDEVICEMETHOD_12_043: [ IoTHubDeviceMethod_Invoke shall execute the HTTP POST request by calling HTTPAPIEX_ExecuteRequest ]*/
         else if (sendHttpRequestDeviceMethod(serviceClientDeviceMethodHandle, IOTHUB_DEVICEMETHOD_REQUEST_INVOKE, deviceId, httpPayloadBuffer, responseBuffer) != IOTHUB_DEVICE_METHOD_OK)
         {
@@ -511,3 +800,69 @@ IOTHUB_DEVICE_METHOD_RESULT  IoTHubDeviceMethod_Invoke(IOTHUB_SERVICE_CLIENT_DEV
     }
     return result;
 }
+
+IOTHUB_DEVICE_METHOD_RESULT IoTHubDeviceMethod_InvokeOnDevices(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle, const char* const* deviceIds, size_t deviceCount, const char* methodName, const char* methodPayload, unsigned int timeout, size_t maxConcurrency, IOTHUB_DEVICE_METHOD_INVOKE_CALLBACK invokeCallback, void* userContextCallback)
+{
+    IOTHUB_DEVICE_METHOD_RESULT result;
+    size_t i = 0;
+
+    if ((deviceIds != NULL) && (deviceCount > 0))
+    {
+        while ((i < deviceCount) && (deviceIds[i] != NULL))
+        {
+            i++;
+        }
+    }
+
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_006: [ If serviceClientDeviceMethodHandle, deviceIds, any of the device ids, methodName, methodPayload or invokeCallback is NULL, or deviceCount or maxConcurrency is 0, IoTHubDeviceMethod_InvokeOnDevices shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+    if ((serviceClientDeviceMethodHandle == NULL) || (deviceIds == NULL) || (deviceCount == 0) || (i < deviceCount) || (methodName == NULL) || (methodPayload == NULL) || (maxConcurrency == 0) || (invokeCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL, and deviceCount and maxConcurrency cannot be 0");
+        result = IOTHUB_DEVICE_METHOD_INVALID_ARG;
+    }
+    else
+    {
+        DEVICE_METHOD_ASYNC_INVOCATION* invocation;
+
+        /*Codes_SRS_IOTHUBDEVICEMETHOD_41_007: [ IoTHubDeviceMethod_InvokeOnDevices shall copy the device ids, methodName and methodPayload so the caller may free them as soon as the call returns. ]*/
+        if ((invocation = createAsyncInvocation(serviceClientDeviceMethodHandle, deviceIds, deviceCount, methodName, methodPayload, timeout, invokeCallback, userContextCallback)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_009: [ If any of the calls above fails, IoTHubDeviceMethod_InvokeOnDevices shall free all the resources it allocated, never call invokeCallback and return IOTHUB_DEVICE_METHOD_ERROR ]*/
+            LogError("failed creating the device method invocation");
+            result = IOTHUB_DEVICE_METHOD_ERROR;
+        }
+        else if (Lock(serviceClientDeviceMethodHandle->asyncInvocationsLock) != LOCK_OK)
+        {
+            LogError("failed locking the list of device method invocations");
+            freeAsyncInvocation(invocation);
+            result = IOTHUB_DEVICE_METHOD_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_013: [ IoTHubDeviceMethod_InvokeOnDevices shall join and free the invocations whose worker threads have all exited. ]*/
+            reapCompletedAsyncInvocations(serviceClientDeviceMethodHandle);
+
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_008: [ IoTHubDeviceMethod_InvokeOnDevices shall start the lesser of maxConcurrency and deviceCount worker threads by calling ThreadAPI_Create and return IOTHUB_DEVICE_METHOD_OK without waiting for the devices. If only some of the threads can be started, the invocation shall continue with those. ]*/
+            if (startAsyncInvocation(invocation, (maxConcurrency < deviceCount) ? maxConcurrency : deviceCount) != 0)
+            {
+                /*Codes_SRS_IOTHUBDEVICEMETHOD_41_009: [ If any of the calls above fails, IoTHubDeviceMethod_InvokeOnDevices shall free all the resources it allocated, never call invokeCallback and return IOTHUB_DEVICE_METHOD_ERROR ]*/
+                LogError("failed starting the device method workers");
+                freeAsyncInvocation(invocation);
+                result = IOTHUB_DEVICE_METHOD_ERROR;
+            }
+            else
+            {
+                DList_InsertTailList(&serviceClientDeviceMethodHandle->asyncInvocations, &invocation->entry);
+                result = IOTHUB_DEVICE_METHOD_OK;
+            }
+            (void)Unlock(serviceClientDeviceMethodHandle->asyncInvocationsLock);
+        }
+    }
+    return result;
+}
+
+IOTHUB_DEVICE_METHOD_RESULT IoTHubDeviceMethod_InvokeAsync(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle, const char* deviceId, const char* methodName, const char* methodPayload, unsigned int timeout, IOTHUB_DEVICE_METHOD_INVOKE_CALLBACK invokeCallback, void* userContextCallback)
+{
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_014: [ IoTHubDeviceMethod_InvokeAsync shall call IoTHubDeviceMethod_InvokeOnDevices with deviceId as the only device and a maxConcurrency of 1 and return its result ]*/
+    return IoTHubDeviceMethod_InvokeOnDevices(serviceClientDeviceMethodHandle, &deviceId, 1, methodName, methodPayload, timeout, 1, invokeCallback, userContextCallback);
+}
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <ctype.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -11,7 +12,6 @@
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/httpapiex.h"
-#include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/connection_string_parser.h"
@@ -19,13 +19,15 @@
 #include "parson.h"
 #include "iothub_devicetwin.h"
 #include "iothub_sc_version.h"
+#include "iothub_sc_http_pool.h"
 
 #define IOTHUB_TWIN_REQUEST_MODE_VALUES    \
     IOTHUB_TWIN_REQUEST_GET,               \
     IOTHUB_TWIN_REQUEST_UPDATE,            \
     IOTHUB_TWIN_REQUEST_REPLACE_TAGS,      \
     IOTHUB_TWIN_REQUEST_REPLACE_DESIRED,   \
-    IOTHUB_TWIN_REQUEST_UPDATE_DESIRED
+    IOTHUB_TWIN_REQUEST_UPDATE_DESIRED,    \
+    IOTHUB_TWIN_REQUEST_QUERY
 
 DEFINE_ENUM(IOTHUB_TWIN_REQUEST_MODE, IOTHUB_TWIN_REQUEST_MODE_VALUES);
 
@@ -40,6 +42,9 @@ DEFINE_ENUM(IOTHUB_TWIN_REQUEST_MODE, IOTHUB_TWIN_REQUEST_MODE_VALUES);
 #define  HTTP_HEADER_VAL_CONTENT_TYPE  "application/json; charset=utf-8"
 #define  HTTP_HEADER_KEY_IFMATCH  "If-Match"
 #define  HTTP_HEADER_VAL_IFMATCH  "'*'"
+#define  HTTP_HEADER_KEY_MAX_ITEM_COUNT  "x-ms-max-item-count"
+#define  HTTP_HEADER_KEY_CONTINUATION  "x-ms-continuation"
+#define  QUERY_MAX_PAGE_SIZE  1000
 #define UID_LENGTH 37
 
 static const char* URL_API_VERSION = "?api-version=2016-11-14";
@@ -47,6 +52,10 @@ static const char* URL_API_VERSION = "?api-version=2016-11-14";
 static const char* RELATIVE_PATH_FMT_TWIN = "/twins/%s%s";
 static const char* RELATIVE_PATH_FMT_TWIN_TAGS = "/twins/%s/tags%s";
 static const char* RELATIVE_PATH_FMT_TWIN_DESIRED = "/twins/%s/properties/desired%s";
+static const char* RELATIVE_PATH_FMT_TWIN_QUERY = "/devices/query%s";
+
+static const char* QUERY_JSON_PREFIX = "{\"query\":\"";
+static const char* QUERY_JSON_SUFFIX = "\"}";
 
 
 /** @brief Structure to store IoTHub authentication information
@@ -56,6 +65,7 @@ typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_TAG
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
 } IOTHUB_SERVICE_CLIENT_DEVICE_TWIN;
 
 static const char* generateGuid(void)
@@ -81,6 +91,7 @@ static STRING_HANDLE createRelativePath(IOTHUB_TWIN_REQUEST_MODE iotHubTwinReque
     //IOTHUB_TWIN_REQUEST_REPLACE_TAGS      PUT      {iot hub}/twins/{device id}/tags                // Replace update tags
     //IOTHUB_TWIN_REQUEST_REPLACE_DESIRED   PUT      {iot hub}/twins/{device id}/properties/desired  // Replace update desired properties
     //IOTHUB_TWIN_REQUEST_UPDATE_DESIRED    PATCH    {iot hub}/twins/{device id}/properties/desired  // Partially update desired properties
+    //IOTHUB_TWIN_REQUEST_QUERY             POST     {iot hub}/devices/query                         // Query device twins
 
     STRING_HANDLE result;
 
@@ -88,6 +99,10 @@ static STRING_HANDLE createRelativePath(IOTHUB_TWIN_REQUEST_MODE iotHubTwinReque
     {
         result = STRING_construct_sprintf(RELATIVE_PATH_FMT_TWIN, deviceId, URL_API_VERSION);
     }
+    else if (iotHubTwinRequestMode == IOTHUB_TWIN_REQUEST_QUERY)
+    {
+        result = STRING_construct_sprintf(RELATIVE_PATH_FMT_TWIN_QUERY, URL_API_VERSION);
+    }
     else
     {
         result = NULL;
@@ -135,7 +150,7 @@ static HTTP_HEADERS_HANDLE createHttpHeader(IOTHUB_TWIN_REQUEST_MODE iotHubTwinR
         HTTPHeaders_Free(httpHeader);
         httpHeader = NULL;
     }
-    else if (iotHubTwinRequestMode != IOTHUB_TWIN_REQUEST_GET)
+    else if ((iotHubTwinRequestMode != IOTHUB_TWIN_REQUEST_GET) && (iotHubTwinRequestMode != IOTHUB_TWIN_REQUEST_QUERY))
     {
         if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_IFMATCH, HTTP_HEADER_VAL_IFMATCH) != HTTP_HEADERS_OK)
         {
@@ -153,67 +168,15 @@ static IOTHUB_DEVICE_TWIN_RESULT sendHttpRequestTwin(IOTHUB_SERVICE_CLIENT_DEVIC
 {
     IOTHUB_DEVICE_TWIN_RESULT result;
 
-    STRING_HANDLE uriResouce;
-    STRING_HANDLE accessKey;
-    STRING_HANDLE keyName;
-    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle;
-    HTTPAPIEX_HANDLE httpExApiHandle;
     HTTP_HEADERS_HANDLE httpHeader;
 
-    if ((uriResouce = STRING_construct(serviceClientDeviceTwinHandle->hostname)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBDEVICETWIN_12_024: [ If any of the HTTPAPI call fails IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
-        LogError("STRING_construct failed for uriResource");
-        result = IOTHUB_DEVICE_TWIN_ERROR;
-    }
-    else if ((accessKey = STRING_construct(serviceClientDeviceTwinHandle->sharedAccessKey)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBDEVICETWIN_12_024: [ If any of the call fails during the HTTP creation IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
-        LogError("STRING_construct failed for accessKey");
-        STRING_delete(uriResouce);
-        result = IOTHUB_DEVICE_TWIN_ERROR;
-    }
-    else if ((keyName = STRING_construct(serviceClientDeviceTwinHandle->keyName)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBDEVICETWIN_12_024: [ If any of the call fails during the HTTP creation IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
-        LogError("STRING_construct failed for keyName");
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
-        result = IOTHUB_DEVICE_TWIN_ERROR;
-    }
     /*Codes_SRS_IOTHUBDEVICETWIN_12_020: [ IoTHubDeviceTwin_GetTwin shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-    else if ((httpHeader = createHttpHeader(iotHubTwinRequestMode)) == NULL)
+    if ((httpHeader = createHttpHeader(iotHubTwinRequestMode)) == NULL)
     {
         /*Codes_SRS_IOTHUBDEVICETWIN_12_024: [ If any of the call fails during the HTTP creation IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
         LogError("HttpHeader creation failed");
-        STRING_delete(keyName);
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
         result = IOTHUB_DEVICE_TWIN_ERROR;
     }
-    /*Codes_SRS_IOTHUBDEVICETWIN_12_021: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-    else if ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResouce, keyName)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBDEVICETWIN_12_025: [ If any of the HTTPAPI call fails IoTHubDeviceTwin_GetTwin shall fail and return IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR ]*/
-        LogError("HTTPAPIEX_SAS_Create failed");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(keyName);
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
-        result = IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR;
-    }
-    /*Codes_SRS_IOTHUBDEVICETWIN_12_022: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
-    else if ((httpExApiHandle = HTTPAPIEX_Create(serviceClientDeviceTwinHandle->hostname)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBDEVICETWIN_12_025: [ If any of the HTTPAPI call fails IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
-        LogError("HTTPAPIEX_Create failed");
-        HTTPAPIEX_SAS_Destroy(httpExApiSasHandle);
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(keyName);
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
-        result = IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR;
-    }
     else 
     {
         HTTPAPI_REQUEST_TYPE httpApiRequestType = HTTPAPI_REQUEST_GET;
@@ -259,10 +222,11 @@ static IOTHUB_DEVICE_TWIN_RESULT sendHttpRequestTwin(IOTHUB_SERVICE_CLIENT_DEVIC
                 result = IOTHUB_DEVICE_TWIN_ERROR;
             }
             /*Codes_SRS_IOTHUBDEVICETWIN_12_023: [ IoTHubDeviceTwin_GetTwin shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ]*/
-            else if (HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, STRING_c_str(relativePath), httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
+            /*Codes_SRS_IOTHUBDEVICETWIN_41_002: [ IoTHubDeviceTwin_GetTwin shall execute the HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
+            else if (IoTHubScHttpPool_ExecuteRequest(serviceClientDeviceTwinHandle->httpPool, httpApiRequestType, STRING_c_str(relativePath), httpHeader, deviceJsonBuffer, &statusCode, responseBuffer) != HTTPAPIEX_OK)
             {
                 /*Codes_SRS_IOTHUBDEVICETWIN_12_025: [ If any of the HTTPAPI call fails IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
-                LogError("HTTPAPIEX_SAS_ExecuteRequest failed");
+                LogError("IoTHubScHttpPool_ExecuteRequest failed");
                 STRING_delete(relativePath);
                 result = IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR;
             }
@@ -282,12 +246,7 @@ static IOTHUB_DEVICE_TWIN_RESULT sendHttpRequestTwin(IOTHUB_SERVICE_CLIENT_DEVIC
                 }
             }
         }
-        HTTPAPIEX_Destroy(httpExApiHandle);
-        HTTPAPIEX_SAS_Destroy(httpExApiSasHandle);
         HTTPHeaders_Free(httpHeader);
-        STRING_delete(keyName);
-        STRING_delete(accessKey);
-        STRING_delete(uriResouce);
     }
     return result;
 }
@@ -371,6 +330,16 @@ IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE IoTHubDeviceTwin_Create(IOTHUB_SERVICE_
                     free(result);
                     result = NULL;
                 }
+                /*Codes_SRS_IOTHUBDEVICETWIN_41_001: [ IoTHubDeviceTwin_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none. If this fails, IoTHubDeviceTwin_Create shall do clean up and return NULL. ]*/
+                else if ((result->httpPool = ((serviceClientAuth->httpPool != NULL) ? IoTHubScHttpPool_Clone(serviceClientAuth->httpPool) : IoTHubScHttpPool_Create(result->hostname, result->sharedAccessKey, result->keyName))) == NULL)
+                {
+                    LogError("unable to get an HTTP connection pool");
+                    free(result->hostname);
+                    free(result->sharedAccessKey);
+                    free(result->keyName);
+                    free(result);
+                    result = NULL;
+                }
             }
         }
     }
@@ -388,6 +357,8 @@ void IoTHubDeviceTwin_Destroy(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceCl
         free(serviceClientDeviceTwin->hostname);
         free(serviceClientDeviceTwin->sharedAccessKey);
         free(serviceClientDeviceTwin->keyName);
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_003: [ IoTHubDeviceTwin_Destroy shall release its reference to the HTTP connection pool by calling IoTHubScHttpPool_Destroy ]*/
+        IoTHubScHttpPool_Destroy(serviceClientDeviceTwin->httpPool);
         free(serviceClientDeviceTwin);
     }
 }
@@ -420,6 +391,264 @@ static int malloc_and_copy_uchar(char** strDestination, BUFFER_HANDLE strSource)
     return result;
 }
 
+static BUFFER_HANDLE createQueryBody(const char* sqlQuery)
+{
+    BUFFER_HANDLE result;
+    size_t prefixLength = strlen(QUERY_JSON_PREFIX);
+    size_t suffixLength = strlen(QUERY_JSON_SUFFIX);
+    size_t escapedLength = 0;
+    const char* current;
+    char* body;
+
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_006: [ IoTHubDeviceTwin_Query shall create the request body {"query":"sqlQuery"}, escaping the quotes, backslashes and control characters of sqlQuery ]*/
+    for (current = sqlQuery; *current != '\0'; current++)
+    {
+        if ((*current == '"') || (*current == '\\'))
+        {
+            escapedLength += 2;
+        }
+        else if ((unsigned char)*current < 0x20)
+        {
+            escapedLength += 6;
+        }
+        else
+        {
+            escapedLength++;
+        }
+    }
+
+    if ((body = malloc(prefixLength + escapedLength + suffixLength + 1)) == NULL)
+    {
+        LogError("malloc failed for the query body");
+        result = NULL;
+    }
+    else
+    {
+        char* destination = body;
+
+        (void)memcpy(destination, QUERY_JSON_PREFIX, prefixLength);
+        destination += prefixLength;
+        for (current = sqlQuery; *current != '\0'; current++)
+        {
+            if ((*current == '"') || (*current == '\\'))
+            {
+                *destination++ = '\\';
+                *destination++ = *current;
+            }
+            else if ((unsigned char)*current < 0x20)
+            {
+                (void)sprintf(destination, "\\u%04x", (unsigned int)(unsigned char)*current);
+                destination += 6;
+            }
+            else
+            {
+                *destination++ = *current;
+            }
+        }
+        (void)memcpy(destination, QUERY_JSON_SUFFIX, suffixLength);
+        destination += suffixLength;
+        *destination = '\0';
+
+        if ((result = BUFFER_create((const unsigned char*)body, (size_t)(destination - body))) == NULL)
+        {
+            LogError("BUFFER_create failed for the query body");
+        }
+        free(body);
+    }
+    return result;
+}
+
+static IOTHUB_DEVICE_TWIN_RESULT sendTwinQueryRequest(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceClientDeviceTwinHandle, BUFFER_HANDLE queryBody, size_t pageSize, const char* continuationToken, HTTP_HEADERS_HANDLE responseHeaders, BUFFER_HANDLE responseBuffer)
+{
+    IOTHUB_DEVICE_TWIN_RESULT result;
+    HTTP_HEADERS_HANDLE httpHeader;
+    STRING_HANDLE relativePath;
+    char pageSizeString[16];
+    unsigned int statusCode = 0;
+
+    (void)sprintf(pageSizeString, "%lu", (unsigned long)pageSize);
+
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_007: [ IoTHubDeviceTwin_Query shall add the Authorization, Request-Id, User-Agent and Content-Type headers and x-ms-max-item-count=pageSize to every request, and x-ms-continuation with the continuation token of the previous page to every request but the first ]*/
+    if ((httpHeader = createHttpHeader(IOTHUB_TWIN_REQUEST_QUERY)) == NULL)
+    {
+        LogError("HttpHeader creation failed");
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else
+    {
+        if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_MAX_ITEM_COUNT, pageSizeString) != HTTP_HEADERS_OK)
+        {
+            /*Codes_SRS_IOTHUBDEVICETWIN_41_010: [ If any of the calls above fails then IoTHubDeviceTwin_Query shall fail and return IOTHUB_DEVICE_TWIN_ERROR ]*/
+            LogError("HTTPHeaders_AddHeaderNameValuePair failed for x-ms-max-item-count header");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        else if ((continuationToken != NULL) && (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_CONTINUATION, continuationToken) != HTTP_HEADERS_OK))
+        {
+            LogError("HTTPHeaders_AddHeaderNameValuePair failed for x-ms-continuation header");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_005: [ IoTHubDeviceTwin_Query shall send the query as an HTTP POST request to url/devices/query ]*/
+        else if ((relativePath = createRelativePath(IOTHUB_TWIN_REQUEST_QUERY, NULL)) == NULL)
+        {
+            LogError("Failure creating relative path");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBDEVICETWIN_41_008: [ IoTHubDeviceTwin_Query shall execute every request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequestWithResponseHeaders ]*/
+            if (IoTHubScHttpPool_ExecuteRequestWithResponseHeaders(serviceClientDeviceTwinHandle->httpPool, HTTPAPI_REQUEST_POST, STRING_c_str(relativePath), httpHeader, queryBody, &statusCode, responseHeaders, responseBuffer) != HTTPAPIEX_OK)
+            {
+                /*Codes_SRS_IOTHUBDEVICETWIN_41_009: [ If the request fails IoTHubDeviceTwin_Query shall return IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR, and if the HTTP status code is not 200 it shall return IOTHUB_DEVICE_TWIN_ERROR ]*/
+                LogError("IoTHubScHttpPool_ExecuteRequestWithResponseHeaders failed");
+                result = IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR;
+            }
+            else if (statusCode != 200)
+            {
+                LogError("Http Failure status code %d.", statusCode);
+                result = IOTHUB_DEVICE_TWIN_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_DEVICE_TWIN_OK;
+            }
+            STRING_delete(relativePath);
+        }
+        HTTPHeaders_Free(httpHeader);
+    }
+    return result;
+}
+
+static size_t skipJsonWhitespace(const unsigned char* json, size_t length, size_t position)
+{
+    while ((position < length) && isspace(json[position]))
+    {
+        position++;
+    }
+    return position;
+}
+
+static int visitTwinQueryPage(const unsigned char* page, size_t length, IOTHUB_DEVICE_TWIN_QUERY_CALLBACK queryCallback, void* userContextCallback, bool* stopped)
+{
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_011: [ IoTHubDeviceTwin_Query shall walk each page as a JSON array without building a document tree, and shall invoke queryCallback with a NUL-terminated copy of each element of the array, one at a time ]*/
+    int result;
+    size_t position = skipJsonWhitespace(page, length, 0);
+
+    if ((position >= length) || (page[position] != '['))
+    {
+        LogError("query response is not a JSON array");
+        result = __FAILURE__;
+    }
+    else
+    {
+        bool done = false;
+
+        result = 0;
+        position = skipJsonWhitespace(page, length, position + 1);
+        if ((position < length) && (page[position] == ']'))
+        {
+            done = true;
+        }
+
+        while (!done)
+        {
+            size_t start = position;
+            size_t end;
+            size_t depth = 0;
+            bool inString = false;
+            bool escaped = false;
+
+            while (position < length)
+            {
+                unsigned char c = page[position];
+                if (inString)
+                {
+                    if (escaped)
+                    {
+                        escaped = false;
+                    }
+                    else if (c == '\\')
+                    {
+                        escaped = true;
+                    }
+                    else if (c == '"')
+                    {
+                        inString = false;
+                    }
+                }
+                else if (c == '"')
+                {
+                    inString = true;
+                }
+                else if ((c == '{') || (c == '['))
+                {
+                    depth++;
+                }
+                else if ((c == '}') || (c == ']'))
+                {
+                    if (depth == 0)
+                    {
+                        break;
+                    }
+                    depth--;
+                }
+                else if ((c == ',') && (depth == 0))
+                {
+                    break;
+                }
+                position++;
+            }
+
+            end = position;
+            while ((end > start) && isspace(page[end - 1]))
+            {
+                end--;
+            }
+
+            if ((position >= length) || (page[position] == '}') || (end == start))
+            {
+                /*Codes_SRS_IOTHUBDEVICETWIN_41_012: [ If a page is not a well-formed JSON array then IoTHubDeviceTwin_Query shall fail and return IOTHUB_DEVICE_TWIN_ERROR ]*/
+                LogError("malformed query response");
+                result = __FAILURE__;
+                done = true;
+            }
+            else
+            {
+                char* deviceTwinJson;
+                size_t elementLength = end - start;
+
+                if ((deviceTwinJson = malloc(elementLength + 1)) == NULL)
+                {
+                    LogError("malloc failed for the device twin");
+                    result = __FAILURE__;
+                    done = true;
+                }
+                else
+                {
+                    (void)memcpy(deviceTwinJson, page + start, elementLength);
+                    deviceTwinJson[elementLength] = '\0';
+
+                    /*Codes_SRS_IOTHUBDEVICETWIN_41_013: [ If queryCallback returns false then IoTHubDeviceTwin_Query shall stop without requesting further pages and return IOTHUB_DEVICE_TWIN_OK ]*/
+                    if (!queryCallback(deviceTwinJson, userContextCallback))
+                    {
+                        *stopped = true;
+                        done = true;
+                    }
+                    else if (page[position] == ']')
+                    {
+                        done = true;
+                    }
+                    else
+                    {
+                        position = skipJsonWhitespace(page, length, position + 1);
+                    }
+                    free(deviceTwinJson);
+                }
+            }
+        }
+    }
+    return result;
+}
+
 char* IoTHubDeviceTwin_GetTwin(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceClientDeviceTwinHandle, const char* deviceId)
 {
     char* result;
@@ -441,8 +670,6 @@ char* IoTHubDeviceTwin_GetTwin(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceC
         }
         /*Codes_SRS_IOTHUBDEVICETWIN_12_019: [ IoTHubDeviceTwin_GetTwin shall create HTTP GET request URL using the given deviceId using the following format: url/twins/[deviceId] ]*/
         /*Codes_SRS_IOTHUBDEVICETWIN_12_020: [ IoTHubDeviceTwin_GetTwin shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-        /*Codes_SRS_IOTHUBDEVICETWIN_12_021: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-        /*Codes_SRS_IOTHUBDEVICETWIN_12_022: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
         /*Codes_SRS_IOTHUBDEVICETWIN_12_023: [ IoTHubDeviceTwin_GetTwin shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ]*/
         else if (sendHttpRequestTwin(serviceClientDeviceTwinHandle, IOTHUB_TWIN_REQUEST_GET, deviceId, NULL, responseBuffer) != IOTHUB_DEVICE_TWIN_OK)
         {
@@ -499,8 +726,6 @@ char* IoTHubDeviceTwin_UpdateTwin(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE servi
         }
         /*CodesSRS_IOTHUBDEVICETWIN_12_039: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTP PATCH request using deviceTwinJson ]*/
         /*CodesSRS_IOTHUBDEVICETWIN_12_040: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTP PATCH request using the createdfollowing HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-        /*CodesSRS_IOTHUBDEVICETWIN_12_041: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-        /*CodesSRS_IOTHUBDEVICETWIN_12_042: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
         /*CodesSRS_IOTHUBDEVICETWIN_12_043: [ IoTHubDeviceTwin_UpdateTwin shall execute the HTTP PATCH request by calling HTTPAPIEX_ExecuteRequest ]*/
         else if (sendHttpRequestTwin(serviceClientDeviceTwinHandle, IOTHUB_TWIN_REQUEST_UPDATE, deviceId, updateJson, responseBuffer) != IOTHUB_DEVICE_TWIN_OK)
         {
@@ -526,3 +751,90 @@ char* IoTHubDeviceTwin_UpdateTwin(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE servi
     }
     return result;
 }
+
+IOTHUB_DEVICE_TWIN_RESULT IoTHubDeviceTwin_Query(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceClientDeviceTwinHandle, const char* sqlQuery, size_t pageSize, IOTHUB_DEVICE_TWIN_QUERY_CALLBACK queryCallback, void* userContextCallback)
+{
+    IOTHUB_DEVICE_TWIN_RESULT result;
+    BUFFER_HANDLE queryBody;
+
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_004: [ If serviceClientDeviceTwinHandle, sqlQuery or queryCallback is NULL, or pageSize is 0 or greater than 1000, IoTHubDeviceTwin_Query shall fail and return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+    if ((serviceClientDeviceTwinHandle == NULL) || (sqlQuery == NULL) || (queryCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_DEVICE_TWIN_INVALID_ARG;
+    }
+    else if ((pageSize == 0) || (pageSize > QUERY_MAX_PAGE_SIZE))
+    {
+        LogError("pageSize must be between 1 and %d", QUERY_MAX_PAGE_SIZE);
+        result = IOTHUB_DEVICE_TWIN_INVALID_ARG;
+    }
+    else if ((queryBody = createQueryBody(sqlQuery)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_010: [ If any of the calls above fails then IoTHubDeviceTwin_Query shall fail and return IOTHUB_DEVICE_TWIN_ERROR ]*/
+        LogError("Failure creating the query body");
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else
+    {
+        char* continuationToken = NULL;
+        bool stopped = false;
+
+        do
+        {
+            HTTP_HEADERS_HANDLE responseHeaders;
+            BUFFER_HANDLE responseBuffer;
+
+            if ((responseHeaders = HTTPHeaders_Alloc()) == NULL)
+            {
+                LogError("HTTPHeaders_Alloc failed for the response headers");
+                result = IOTHUB_DEVICE_TWIN_ERROR;
+            }
+            else
+            {
+                if ((responseBuffer = BUFFER_new()) == NULL)
+                {
+                    LogError("BUFFER_new failed for responseBuffer");
+                    result = IOTHUB_DEVICE_TWIN_ERROR;
+                }
+                else
+                {
+                    if ((result = sendTwinQueryRequest(serviceClientDeviceTwinHandle, queryBody, pageSize, continuationToken, responseHeaders, responseBuffer)) != IOTHUB_DEVICE_TWIN_OK)
+                    {
+                        LogError("Failure sending HTTP request for query");
+                    }
+                    else
+                    {
+                        const unsigned char* page = BUFFER_u_char(responseBuffer);
+                        size_t pageLength = BUFFER_length(responseBuffer);
+
+                        if (visitTwinQueryPage(page, pageLength, queryCallback, userContextCallback, &stopped) != 0)
+                        {
+                            LogError("Failure parsing the query response");
+                            result = IOTHUB_DEVICE_TWIN_ERROR;
+                        }
+                        else
+                        {
+                        /*Codes_SRS_IOTHUBDEVICETWIN_41_014: [ IoTHubDeviceTwin_Query shall keep requesting pages while the response carries an x-ms-continuation header, and shall return IOTHUB_DEVICE_TWIN_OK after the last page ]*/
+                            const char* nextContinuationToken = stopped ? NULL : HTTPHeaders_FindHeaderValue(responseHeaders, HTTP_HEADER_KEY_CONTINUATION);
+
+                            free(continuationToken);
+                            continuationToken = NULL;
+                            if ((nextContinuationToken != NULL) && (mallocAndStrcpy_s(&continuationToken, nextContinuationToken) != 0))
+                            {
+                                LogError("mallocAndStrcpy_s failed for the continuation token");
+                                continuationToken = NULL;
+                                result = IOTHUB_DEVICE_TWIN_ERROR;
+                            }
+                        }
+                    }
+                    BUFFER_delete(responseBuffer);
+                }
+                HTTPHeaders_Free(responseHeaders);
+            }
+        } while ((result == IOTHUB_DEVICE_TWIN_OK) && (continuationToken != NULL));
+
+        free(continuationToken);
+        BUFFER_delete(queryBody);
+    }
+    return result;
+}
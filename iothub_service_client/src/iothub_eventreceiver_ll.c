@@ -0,0 +1,832 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/tlsio.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/messaging.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+#include "azure_uamqp_c/sasl_mechanism.h"
+#include "azure_uamqp_c/saslclientio.h"
+#include "azure_uamqp_c/sasl_plain.h"
+
+#include "uamqp_messaging.h"
+#include "iothub_eventreceiver_ll.h"
+
+#define EVENT_OFFSET_MAX_LENGTH         64
+#define DEVICE_ID_MAX_LENGTH            128
+
+static const char* DEFAULT_CONSUMER_GROUP = "$Default";
+static const char* SELECTOR_FILTER_NAME = "apache.org:selector-filter:string";
+static const char* LATEST_OFFSET = "@latest";
+
+static const char* ANNOTATION_KEY_OFFSET = "x-opt-offset";
+static const char* ANNOTATION_KEY_SEQUENCE_NUMBER = "x-opt-sequence-number";
+static const char* ANNOTATION_KEY_ENQUEUED_TIME = "x-opt-enqueued-time";
+static const char* ANNOTATION_KEY_CONNECTION_DEVICE_ID = "iothub-connection-device-id";
+
+/*one per opened partition, each with its own receiver link on the shared session*/
+typedef struct PARTITION_RECEIVER_TAG
+{
+    struct IOTHUB_EVENT_RECEIVER_LL_TAG* eventReceiver;
+    char* partitionId;
+    LINK_HANDLE link;
+    MESSAGE_RECEIVER_HANDLE message_receiver;
+    IOTHUB_EVENT_RECEIVED_CALLBACK eventCallback;
+    void* eventUserContext;
+    size_t eventsSinceCheckpoint;
+    int64_t lastSequenceNumber;
+    char lastOffset[EVENT_OFFSET_MAX_LENGTH + 1];
+} PARTITION_RECEIVER;
+
+typedef struct IOTHUB_EVENT_RECEIVER_LL_TAG
+{
+    char* eventHubHostName;
+    char* eventHubName;
+    char* consumerGroup;
+    char* sharedAccessKey;
+    char* keyName;
+
+    SASL_PLAIN_CONFIG sasl_plain_config;
+    SASL_MECHANISM_HANDLE sasl_mechanism_handle;
+    XIO_HANDLE tls_io;
+    XIO_HANDLE sasl_io;
+    CONNECTION_HANDLE connection;
+    SESSION_HANDLE session;
+
+    SINGLYLINKEDLIST_HANDLE partitions;
+    uint32_t prefetchCount;
+
+    IOTHUB_EVENT_CHECKPOINT_CALLBACK checkpointCallback;
+    void* checkpointUserContext;
+    size_t checkpointInterval;
+} IOTHUB_EVENT_RECEIVER_LL;
+
+static void closeConnection(IOTHUB_EVENT_RECEIVER_LL* eventReceiver)
+{
+    if (eventReceiver->session != NULL)
+    {
+        session_destroy(eventReceiver->session);
+        eventReceiver->session = NULL;
+    }
+    if (eventReceiver->connection != NULL)
+    {
+        connection_destroy(eventReceiver->connection);
+        eventReceiver->connection = NULL;
+    }
+    if (eventReceiver->sasl_io != NULL)
+    {
+        xio_destroy(eventReceiver->sasl_io);
+        eventReceiver->sasl_io = NULL;
+    }
+    if (eventReceiver->tls_io != NULL)
+    {
+        xio_destroy(eventReceiver->tls_io);
+        eventReceiver->tls_io = NULL;
+    }
+    if (eventReceiver->sasl_mechanism_handle != NULL)
+    {
+        saslmechanism_destroy(eventReceiver->sasl_mechanism_handle);
+        eventReceiver->sasl_mechanism_handle = NULL;
+    }
+}
+
+static int openConnection(IOTHUB_EVENT_RECEIVER_LL* eventReceiver)
+{
+    int result;
+    const SASL_MECHANISM_INTERFACE_DESCRIPTION* sasl_mechanism_interface;
+    const IO_INTERFACE_DESCRIPTION* tlsio_interface;
+    const IO_INTERFACE_DESCRIPTION* saslclientio_interface;
+    TLSIO_CONFIG tls_io_config;
+    SASLCLIENTIO_CONFIG sasl_io_config;
+
+    /*the Event Hub-compatible endpoint takes the policy name and key of the hub as SASL PLAIN credentials*/
+    eventReceiver->sasl_plain_config.authcid = eventReceiver->keyName;
+    eventReceiver->sasl_plain_config.passwd = eventReceiver->sharedAccessKey;
+    eventReceiver->sasl_plain_config.authzid = NULL;
+
+    tls_io_config.hostname = eventReceiver->eventHubHostName;
+    tls_io_config.port = 5671;
+    tls_io_config.underlying_io_interface = NULL;
+    tls_io_config.underlying_io_parameters = NULL;
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_010: [ The first IoTHubEventReceiver_LL_OpenPartition shall open the AMQP connection by creating a SASL PLAIN mechanism with keyName and sharedAccessKey, a TLS IO to eventHubHostName on port 5671, a SASL IO, a connection and a session ] */
+    if ((sasl_mechanism_interface = saslplain_get_interface()) == NULL)
+    {
+        LogError("Could not get SASL plain mechanism interface.");
+        result = __FAILURE__;
+    }
+    else if ((eventReceiver->sasl_mechanism_handle = saslmechanism_create(sasl_mechanism_interface, &eventReceiver->sasl_plain_config)) == NULL)
+    {
+        LogError("Could not create SASL plain mechanism.");
+        result = __FAILURE__;
+    }
+    else if ((tlsio_interface = platform_get_default_tlsio()) == NULL)
+    {
+        LogError("Could not get default TLS IO interface.");
+        closeConnection(eventReceiver);
+        result = __FAILURE__;
+    }
+    else if ((eventReceiver->tls_io = xio_create(tlsio_interface, &tls_io_config)) == NULL)
+    {
+        LogError("Could not create TLS IO.");
+        closeConnection(eventReceiver);
+        result = __FAILURE__;
+    }
+    else
+    {
+        sasl_io_config.sasl_mechanism = eventReceiver->sasl_mechanism_handle;
+        sasl_io_config.underlying_io = eventReceiver->tls_io;
+
+        if ((saslclientio_interface = saslclientio_get_interface_description()) == NULL)
+        {
+            LogError("Could not create get SASL IO interface description.");
+            closeConnection(eventReceiver);
+            result = __FAILURE__;
+        }
+        else if ((eventReceiver->sasl_io = xio_create(saslclientio_interface, &sasl_io_config)) == NULL)
+        {
+            LogError("Could not create SASL IO.");
+            closeConnection(eventReceiver);
+            result = __FAILURE__;
+        }
+        else if ((eventReceiver->connection = connection_create(eventReceiver->sasl_io, eventReceiver->eventHubHostName, "eventreceiver", NULL, NULL)) == NULL)
+        {
+            LogError("Could not create connection.");
+            closeConnection(eventReceiver);
+            result = __FAILURE__;
+        }
+        else if ((eventReceiver->session = session_create(eventReceiver->connection, NULL, NULL)) == NULL)
+        {
+            LogError("Could not create session.");
+            closeConnection(eventReceiver);
+            result = __FAILURE__;
+        }
+        else if (session_set_incoming_window(eventReceiver->session, 2147483647) != 0)
+        {
+            LogError("Could not set incoming window.");
+            closeConnection(eventReceiver);
+            result = __FAILURE__;
+        }
+        else if (session_set_outgoing_window(eventReceiver->session, 255 * 1024) != 0)
+        {
+            LogError("Could not set outgoing window.");
+            closeConnection(eventReceiver);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/*valuesLength is the length of all the strings formatted in, so the buffer fits them*/
+static char* createFormattedString(size_t valuesLength, const char* format, ...)
+{
+    char* result;
+    size_t length = strlen(format) + valuesLength;
+
+    if ((result = (char*)malloc(length + 1)) == NULL)
+    {
+        LogError("Malloc failed for formatted string");
+    }
+    else
+    {
+        va_list args;
+        int formatted;
+
+        va_start(args, format);
+        formatted = vsnprintf(result, length + 1, format, args);
+        va_end(args);
+
+        if (formatted < 0)
+        {
+            LogError("vsnprintf failed for formatted string");
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+/*the source is the partition address, filtered so the hub starts after startOffset*/
+static AMQP_VALUE createPartitionSource(const char* address, const char* startOffset)
+{
+    AMQP_VALUE result;
+    const char* offset = (startOffset == NULL) ? LATEST_OFFSET : startOffset;
+    char* filter_string;
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_013: [ IoTHubEventReceiver_LL_OpenPartition shall filter the link source with an apache.org:selector-filter:string of amqp.annotation.x-opt-offset > 'startOffset', or > '@latest' if startOffset is NULL ] */
+    if ((filter_string = createFormattedString(strlen(offset), "amqp.annotation.x-opt-offset > '%s'", offset)) == NULL)
+    {
+        LogError("Could not create the offset filter.");
+        result = NULL;
+    }
+    else
+    {
+        filter_set filter_map = NULL;
+        AMQP_VALUE filter_key = NULL;
+        AMQP_VALUE descriptor = NULL;
+        AMQP_VALUE filter_value = NULL;
+        AMQP_VALUE described_filter_value = NULL;
+        AMQP_VALUE address_value = NULL;
+        SOURCE_HANDLE source_handle = NULL;
+
+        if (((filter_map = amqpvalue_create_map()) == NULL) ||
+            ((filter_key = amqpvalue_create_symbol(SELECTOR_FILTER_NAME)) == NULL) ||
+            ((descriptor = amqpvalue_create_symbol(SELECTOR_FILTER_NAME)) == NULL) ||
+            ((filter_value = amqpvalue_create_string(filter_string)) == NULL))
+        {
+            LogError("Could not create the filter set.");
+            result = NULL;
+        }
+        else if ((described_filter_value = amqpvalue_create_described(descriptor, filter_value)) == NULL)
+        {
+            LogError("Could not create the described filter.");
+            result = NULL;
+        }
+        else
+        {
+            /*the described value owns the descriptor and the filter string from now on*/
+            descriptor = NULL;
+            filter_value = NULL;
+
+            if (amqpvalue_set_map_value(filter_map, filter_key, described_filter_value) != 0)
+            {
+                LogError("Could not add the filter to the filter set.");
+                result = NULL;
+            }
+            else if ((source_handle = source_create()) == NULL)
+            {
+                LogError("Could not create source.");
+                result = NULL;
+            }
+            else if ((address_value = amqpvalue_create_string(address)) == NULL)
+            {
+                LogError("Could not create source address.");
+                result = NULL;
+            }
+            else if ((source_set_address(source_handle, address_value) != 0) ||
+                (source_set_filter(source_handle, filter_map) != 0))
+            {
+                LogError("Could not set the address and filter of the source.");
+                result = NULL;
+            }
+            else if ((result = amqpvalue_create_source(source_handle)) == NULL)
+            {
+                LogError("Could not create source value.");
+            }
+        }
+
+        if (source_handle != NULL)
+        {
+            source_destroy(source_handle);
+        }
+        if (address_value != NULL)
+        {
+            amqpvalue_destroy(address_value);
+        }
+        if (described_filter_value != NULL)
+        {
+            amqpvalue_destroy(described_filter_value);
+        }
+        if (filter_value != NULL)
+        {
+            amqpvalue_destroy(filter_value);
+        }
+        if (descriptor != NULL)
+        {
+            amqpvalue_destroy(descriptor);
+        }
+        if (filter_key != NULL)
+        {
+            amqpvalue_destroy(filter_key);
+        }
+        if (filter_map != NULL)
+        {
+            amqpvalue_destroy(filter_map);
+        }
+        free(filter_string);
+    }
+
+    return result;
+}
+
+static void readEventAnnotation(PARTITION_RECEIVER* partition, IOTHUB_EVENT_INFO* eventInfo, char* deviceIdBuffer, const char* key_name, AMQP_VALUE value)
+{
+    const char* string_value;
+
+    if (strcmp(key_name, ANNOTATION_KEY_OFFSET) == 0)
+    {
+        if ((amqpvalue_get_string(value, &string_value) != 0) || (strlen(string_value) > EVENT_OFFSET_MAX_LENGTH))
+        {
+            LogError("Invalid event offset");
+        }
+        else
+        {
+            (void)strcpy(partition->lastOffset, string_value);
+            eventInfo->offset = partition->lastOffset;
+        }
+    }
+    else if (strcmp(key_name, ANNOTATION_KEY_SEQUENCE_NUMBER) == 0)
+    {
+        if (amqpvalue_get_long(value, &eventInfo->sequenceNumber) != 0)
+        {
+            LogError("Invalid event sequence number");
+        }
+    }
+    else if (strcmp(key_name, ANNOTATION_KEY_ENQUEUED_TIME) == 0)
+    {
+        if (amqpvalue_get_timestamp(value, &eventInfo->enqueuedTimeUtc) != 0)
+        {
+            LogError("Invalid event enqueued time");
+        }
+    }
+    else if (strcmp(key_name, ANNOTATION_KEY_CONNECTION_DEVICE_ID) == 0)
+    {
+        if ((amqpvalue_get_string(value, &string_value) != 0) || (strlen(string_value) > DEVICE_ID_MAX_LENGTH))
+        {
+            LogError("Invalid event device id");
+        }
+        else
+        {
+            (void)strcpy(deviceIdBuffer, string_value);
+            eventInfo->connectionDeviceId = deviceIdBuffer;
+        }
+    }
+}
+
+/*Codes_SRS_IOTHUBEVENTRECEIVER_41_017: [ The event info shall hold the partitionId and the x-opt-offset, x-opt-sequence-number, x-opt-enqueued-time and iothub-connection-device-id message annotations of the event; missing annotations shall be left NULL or 0 ] */
+static void readEventAnnotations(MESSAGE_HANDLE message, PARTITION_RECEIVER* partition, IOTHUB_EVENT_INFO* eventInfo, char* deviceIdBuffer)
+{
+    annotations message_annotations = NULL;
+
+    eventInfo->partitionId = partition->partitionId;
+    eventInfo->offset = NULL;
+    eventInfo->sequenceNumber = 0;
+    eventInfo->enqueuedTimeUtc = 0;
+    eventInfo->connectionDeviceId = NULL;
+
+    if (message_get_message_annotations(message, &message_annotations) != 0)
+    {
+        LogError("Failed getting the message annotations");
+    }
+    else if (message_annotations != NULL)
+    {
+        AMQP_VALUE annotations_map = (amqpvalue_get_type(message_annotations) == AMQP_TYPE_DESCRIBED) ? amqpvalue_get_inplace_described_value(message_annotations) : message_annotations;
+        uint32_t pair_count;
+
+        if ((annotations_map == NULL) || (amqpvalue_get_map_pair_count(annotations_map, &pair_count) != 0))
+        {
+            LogError("Failed reading the message annotations");
+        }
+        else
+        {
+            uint32_t i;
+            for (i = 0; i < pair_count; i++)
+            {
+                AMQP_VALUE key;
+                AMQP_VALUE value;
+                const char* key_name;
+
+                if (amqpvalue_get_map_key_value_pair(annotations_map, i, &key, &value) != 0)
+                {
+                    LogError("Failed reading message annotation %u", i);
+                }
+                else
+                {
+                    if (amqpvalue_get_symbol(key, &key_name) == 0)
+                    {
+                        readEventAnnotation(partition, eventInfo, deviceIdBuffer, key_name, value);
+                    }
+                    amqpvalue_destroy(key);
+                    amqpvalue_destroy(value);
+                }
+            }
+        }
+        amqpvalue_destroy(message_annotations);
+    }
+}
+
+static void reportCheckpoint(PARTITION_RECEIVER* partition)
+{
+    IOTHUB_EVENT_RECEIVER_LL* eventReceiver = partition->eventReceiver;
+
+    if ((eventReceiver->checkpointCallback != NULL) && (partition->eventsSinceCheckpoint != 0) && (partition->lastOffset[0] != '\0'))
+    {
+        eventReceiver->checkpointCallback(eventReceiver->checkpointUserContext, partition->partitionId, partition->lastOffset, partition->lastSequenceNumber);
+    }
+    partition->eventsSinceCheckpoint = 0;
+}
+
+static AMQP_VALUE onEventReceived(const void* context, MESSAGE_HANDLE message)
+{
+    AMQP_VALUE result;
+    PARTITION_RECEIVER* partition = (PARTITION_RECEIVER*)context;
+    IOTHUB_MESSAGE_HANDLE iothub_message;
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_016: [ For every event received on a partition, IoTHubEventReceiver_LL_DoWork shall convert it with IoTHubMessage_CreateFromUamqpMessage and pass it with its event info to the eventCallback of the partition, then destroy it ] */
+    if (IoTHubMessage_CreateFromUamqpMessage(message, &iothub_message) != 0)
+    {
+        LogError("Failed converting the event of partition %s", partition->partitionId);
+        result = messaging_delivery_rejected("Rejected due to failure reading AMQP message", "Failed converting the event");
+    }
+    else
+    {
+        IOTHUB_EVENT_INFO eventInfo;
+        char deviceIdBuffer[DEVICE_ID_MAX_LENGTH + 1];
+
+        readEventAnnotations(message, partition, &eventInfo, deviceIdBuffer);
+        partition->lastSequenceNumber = eventInfo.sequenceNumber;
+
+        partition->eventCallback(partition->eventUserContext, iothub_message, &eventInfo);
+        IoTHubMessage_Destroy(iothub_message);
+
+        /*Codes_SRS_IOTHUBEVENTRECEIVER_41_018: [ After every checkpointInterval events of a partition, the checkpoint callback shall be called with the partitionId and the offset and sequence number of the last event ] */
+        partition->eventsSinceCheckpoint++;
+        if (partition->eventsSinceCheckpoint >= partition->eventReceiver->checkpointInterval)
+        {
+            reportCheckpoint(partition);
+        }
+
+        result = messaging_delivery_accepted();
+    }
+
+    return result;
+}
+
+static void closePartitionReceiver(PARTITION_RECEIVER* partition)
+{
+    if (partition->message_receiver != NULL)
+    {
+        messagereceiver_destroy(partition->message_receiver);
+    }
+    if (partition->link != NULL)
+    {
+        link_destroy(partition->link);
+    }
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_020: [ Closing a partition shall destroy its message receiver and link, and report a checkpoint for the events delivered since the last one ] */
+    reportCheckpoint(partition);
+
+    free(partition->partitionId);
+    free(partition);
+}
+
+static LIST_ITEM_HANDLE findPartition(IOTHUB_EVENT_RECEIVER_LL* eventReceiver, const char* partitionId)
+{
+    LIST_ITEM_HANDLE item = singlylinkedlist_get_head_item(eventReceiver->partitions);
+
+    while (item != NULL)
+    {
+        const PARTITION_RECEIVER* partition = (const PARTITION_RECEIVER*)singlylinkedlist_item_get_value(item);
+        if (strcmp(partition->partitionId, partitionId) == 0)
+        {
+            break;
+        }
+        item = singlylinkedlist_get_next_item(item);
+    }
+
+    return item;
+}
+
+static int openPartitionLink(IOTHUB_EVENT_RECEIVER_LL* eventReceiver, PARTITION_RECEIVER* partition, const char* startOffset)
+{
+    int result;
+    char* address;
+    char* link_name;
+    AMQP_VALUE source = NULL;
+    AMQP_VALUE target = NULL;
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_012: [ IoTHubEventReceiver_LL_OpenPartition shall create a receiver link named eventreceiver-link-[partitionId] with source amqps://[eventHubHostName]/[eventHubName]/ConsumerGroups/[consumerGroup]/Partitions/[partitionId] ] */
+    if ((address = createFormattedString(strlen(eventReceiver->eventHubHostName) + strlen(eventReceiver->eventHubName) + strlen(eventReceiver->consumerGroup) + strlen(partition->partitionId),
+        "amqps://%s/%s/ConsumerGroups/%s/Partitions/%s", eventReceiver->eventHubHostName, eventReceiver->eventHubName, eventReceiver->consumerGroup, partition->partitionId)) == NULL)
+    {
+        LogError("Could not create the partition address.");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((link_name = createFormattedString(strlen(partition->partitionId), "eventreceiver-link-%s", partition->partitionId)) == NULL)
+        {
+            LogError("Could not create the link name.");
+            result = __FAILURE__;
+        }
+        else
+        {
+            if ((source = createPartitionSource(address, startOffset)) == NULL)
+            {
+                LogError("Could not create source for link.");
+                result = __FAILURE__;
+            }
+            else if ((target = messaging_create_target(link_name)) == NULL)
+            {
+                LogError("Could not create target for link.");
+                result = __FAILURE__;
+            }
+            else if ((partition->link = link_create(eventReceiver->session, link_name, role_receiver, source, target)) == NULL)
+            {
+                LogError("Could not create link.");
+                result = __FAILURE__;
+            }
+            else if (link_set_rcv_settle_mode(partition->link, receiver_settle_mode_first) != 0)
+            {
+                LogError("Could not set the receiver settle mode.");
+                result = __FAILURE__;
+            }
+            /*Codes_SRS_IOTHUBEVENTRECEIVER_41_014: [ IoTHubEventReceiver_LL_OpenPartition shall ask for presettled events by calling link_set_snd_settle_mode with sender_settle_mode_settled, and set the prefetch count as maximum link credit with link_set_max_link_credit if it is not 0 ] */
+            else if (link_set_snd_settle_mode(partition->link, sender_settle_mode_settled) != 0)
+            {
+                LogError("Could not set the sender settle mode.");
+                result = __FAILURE__;
+            }
+            else if ((eventReceiver->prefetchCount != 0) && (link_set_max_link_credit(partition->link, eventReceiver->prefetchCount) != 0))
+            {
+                LogError("Could not set the prefetch count.");
+                result = __FAILURE__;
+            }
+            /*Codes_SRS_IOTHUBEVENTRECEIVER_41_015: [ IoTHubEventReceiver_LL_OpenPartition shall create and open a message receiver on the link by calling messagereceiver_create and messagereceiver_open ] */
+            else if ((partition->message_receiver = messagereceiver_create(partition->link, NULL, NULL)) == NULL)
+            {
+                LogError("Could not create message receiver.");
+                result = __FAILURE__;
+            }
+            else if (messagereceiver_open(partition->message_receiver, onEventReceived, partition) != 0)
+            {
+                LogError("Could not open message receiver.");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+
+            if (target != NULL)
+            {
+                amqpvalue_destroy(target);
+            }
+            if (source != NULL)
+            {
+                amqpvalue_destroy(source);
+            }
+            free(link_name);
+        }
+        free(address);
+    }
+
+    return result;
+}
+
+IOTHUB_EVENT_RECEIVER_LL_HANDLE IoTHubEventReceiver_LL_Create(IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientHandle, const char* eventHubHostName, const char* eventHubName, const char* consumerGroup)
+{
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE result;
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_001: [ If serviceClientHandle, eventHubHostName or eventHubName is NULL IoTHubEventReceiver_LL_Create shall return NULL ] */
+    if ((serviceClientHandle == NULL) || (eventHubHostName == NULL) || (eventHubName == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = NULL;
+    }
+    else
+    {
+        IOTHUB_SERVICE_CLIENT_AUTH* serviceClientAuth = (IOTHUB_SERVICE_CLIENT_AUTH*)serviceClientHandle;
+
+        /*Codes_SRS_IOTHUBEVENTRECEIVER_41_002: [ If the keyName or sharedAccessKey member of serviceClientHandle is NULL IoTHubEventReceiver_LL_Create shall return NULL ] */
+        if (serviceClientAuth->keyName == NULL)
+        {
+            LogError("authInfo->keyName input parameter cannot be NULL");
+            result = NULL;
+        }
+        else if (serviceClientAuth->sharedAccessKey == NULL)
+        {
+            LogError("authInfo->sharedAccessKey input parameter cannot be NULL");
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBEVENTRECEIVER_41_003: [ IoTHubEventReceiver_LL_Create shall allocate memory for a new receiver and copy eventHubHostName, eventHubName, consumerGroup ($Default if NULL), sharedAccessKey and keyName by calling mallocAndStrcpy_s ] */
+        else if ((result = (IOTHUB_EVENT_RECEIVER_LL*)malloc(sizeof(IOTHUB_EVENT_RECEIVER_LL))) == NULL)
+        {
+            /*Codes_SRS_IOTHUBEVENTRECEIVER_41_004: [ If any of the above fails IoTHubEventReceiver_LL_Create shall free what it allocated and return NULL ] */
+            LogError("Malloc failed for IOTHUB_EVENT_RECEIVER_LL");
+        }
+        else
+        {
+            memset(result, 0, sizeof(IOTHUB_EVENT_RECEIVER_LL));
+            result->checkpointInterval = 1;
+
+            if ((mallocAndStrcpy_s(&result->eventHubHostName, eventHubHostName) != 0) ||
+                (mallocAndStrcpy_s(&result->eventHubName, eventHubName) != 0) ||
+                (mallocAndStrcpy_s(&result->consumerGroup, (consumerGroup == NULL) ? DEFAULT_CONSUMER_GROUP : consumerGroup) != 0) ||
+                (mallocAndStrcpy_s(&result->sharedAccessKey, serviceClientAuth->sharedAccessKey) != 0) ||
+                (mallocAndStrcpy_s(&result->keyName, serviceClientAuth->keyName) != 0))
+            {
+                LogError("mallocAndStrcpy_s failed");
+                IoTHubEventReceiver_LL_Destroy(result);
+                result = NULL;
+            }
+            /*Codes_SRS_IOTHUBEVENTRECEIVER_41_005: [ IoTHubEventReceiver_LL_Create shall create the list of partitions by calling singlylinkedlist_create ] */
+            else if ((result->partitions = singlylinkedlist_create()) == NULL)
+            {
+                LogError("singlylinkedlist_create failed");
+                IoTHubEventReceiver_LL_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+void IoTHubEventReceiver_LL_Destroy(IOTHUB_EVENT_RECEIVER_LL_HANDLE eventReceiverHandle)
+{
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_006: [ If eventReceiverHandle is NULL IoTHubEventReceiver_LL_Destroy shall return, otherwise it shall close the receiver as IoTHubEventReceiver_LL_Close does and free its memory ] */
+    if (eventReceiverHandle != NULL)
+    {
+        if (eventReceiverHandle->partitions != NULL)
+        {
+            IoTHubEventReceiver_LL_Close(eventReceiverHandle);
+            singlylinkedlist_destroy(eventReceiverHandle->partitions);
+        }
+        free(eventReceiverHandle->eventHubHostName);
+        free(eventReceiverHandle->eventHubName);
+        free(eventReceiverHandle->consumerGroup);
+        free(eventReceiverHandle->sharedAccessKey);
+        free(eventReceiverHandle->keyName);
+        free(eventReceiverHandle);
+    }
+}
+
+IOTHUB_EVENT_RECEIVER_RESULT IoTHubEventReceiver_LL_SetPrefetchCount(IOTHUB_EVENT_RECEIVER_LL_HANDLE eventReceiverHandle, uint32_t prefetchCount)
+{
+    IOTHUB_EVENT_RECEIVER_RESULT result;
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_007: [ If eventReceiverHandle is NULL IoTHubEventReceiver_LL_SetPrefetchCount shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG, otherwise it shall save prefetchCount for the partitions opened afterwards and return IOTHUB_EVENT_RECEIVER_OK ] */
+    if (eventReceiverHandle == NULL)
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_EVENT_RECEIVER_INVALID_ARG;
+    }
+    else
+    {
+        eventReceiverHandle->prefetchCount = prefetchCount;
+        result = IOTHUB_EVENT_RECEIVER_OK;
+    }
+
+    return result;
+}
+
+IOTHUB_EVENT_RECEIVER_RESULT IoTHubEventReceiver_LL_SetCheckpointCallback(IOTHUB_EVENT_RECEIVER_LL_HANDLE eventReceiverHandle, IOTHUB_EVENT_CHECKPOINT_CALLBACK checkpointCallback, void* userContextCallback, size_t checkpointInterval)
+{
+    IOTHUB_EVENT_RECEIVER_RESULT result;
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_008: [ If eventReceiverHandle is NULL or checkpointInterval is 0 IoTHubEventReceiver_LL_SetCheckpointCallback shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG ] */
+    if ((eventReceiverHandle == NULL) || (checkpointInterval == 0))
+    {
+        LogError("Invalid argument, eventReceiverHandle: %p, checkpointInterval: %u", eventReceiverHandle, (unsigned int)checkpointInterval);
+        result = IOTHUB_EVENT_RECEIVER_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBEVENTRECEIVER_41_009: [ IoTHubEventReceiver_LL_SetCheckpointCallback shall save checkpointCallback, userContextCallback and checkpointInterval and return IOTHUB_EVENT_RECEIVER_OK ] */
+        eventReceiverHandle->checkpointCallback = checkpointCallback;
+        eventReceiverHandle->checkpointUserContext = userContextCallback;
+        eventReceiverHandle->checkpointInterval = checkpointInterval;
+        result = IOTHUB_EVENT_RECEIVER_OK;
+    }
+
+    return result;
+}
+
+IOTHUB_EVENT_RECEIVER_RESULT IoTHubEventReceiver_LL_OpenPartition(IOTHUB_EVENT_RECEIVER_LL_HANDLE eventReceiverHandle, const char* partitionId, const char* startOffset, IOTHUB_EVENT_RECEIVED_CALLBACK eventCallback, void* userContextCallback)
+{
+    IOTHUB_EVENT_RECEIVER_RESULT result;
+    PARTITION_RECEIVER* partition;
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_011: [ If eventReceiverHandle, partitionId or eventCallback is NULL IoTHubEventReceiver_LL_OpenPartition shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG, and if the partition is already open it shall return IOTHUB_EVENT_RECEIVER_PARTITION_EXIST ] */
+    if ((eventReceiverHandle == NULL) || (partitionId == NULL) || (eventCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_EVENT_RECEIVER_INVALID_ARG;
+    }
+    else if (findPartition(eventReceiverHandle, partitionId) != NULL)
+    {
+        LogError("Partition %s is already open", partitionId);
+        result = IOTHUB_EVENT_RECEIVER_PARTITION_EXIST;
+    }
+    else if ((eventReceiverHandle->connection == NULL) && (openConnection(eventReceiverHandle) != 0))
+    {
+        LogError("Could not open the connection.");
+        result = IOTHUB_EVENT_RECEIVER_ERROR;
+    }
+    else if ((partition = (PARTITION_RECEIVER*)malloc(sizeof(PARTITION_RECEIVER))) == NULL)
+    {
+        LogError("Malloc failed for PARTITION_RECEIVER");
+        result = IOTHUB_EVENT_RECEIVER_ERROR;
+    }
+    else
+    {
+        memset(partition, 0, sizeof(PARTITION_RECEIVER));
+        partition->eventReceiver = eventReceiverHandle;
+        partition->eventCallback = eventCallback;
+        partition->eventUserContext = userContextCallback;
+
+        if (mallocAndStrcpy_s(&partition->partitionId, partitionId) != 0)
+        {
+            LogError("mallocAndStrcpy_s failed for partitionId");
+            free(partition);
+            result = IOTHUB_EVENT_RECEIVER_ERROR;
+        }
+        else if (openPartitionLink(eventReceiverHandle, partition, startOffset) != 0)
+        {
+            /*Codes_SRS_IOTHUBEVENTRECEIVER_41_019: [ If any call fails IoTHubEventReceiver_LL_OpenPartition shall destroy what it created for the partition and return IOTHUB_EVENT_RECEIVER_ERROR ] */
+            closePartitionReceiver(partition);
+            result = IOTHUB_EVENT_RECEIVER_ERROR;
+        }
+        else if (singlylinkedlist_add(eventReceiverHandle->partitions, partition) == NULL)
+        {
+            LogError("singlylinkedlist_add failed for partition %s", partitionId);
+            closePartitionReceiver(partition);
+            result = IOTHUB_EVENT_RECEIVER_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_EVENT_RECEIVER_OK;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_EVENT_RECEIVER_RESULT IoTHubEventReceiver_LL_ClosePartition(IOTHUB_EVENT_RECEIVER_LL_HANDLE eventReceiverHandle, const char* partitionId)
+{
+    IOTHUB_EVENT_RECEIVER_RESULT result;
+    LIST_ITEM_HANDLE item;
+
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_021: [ If eventReceiverHandle or partitionId is NULL IoTHubEventReceiver_LL_ClosePartition shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG, and if the partition is not open it shall return IOTHUB_EVENT_RECEIVER_PARTITION_NOT_FOUND ] */
+    if ((eventReceiverHandle == NULL) || (partitionId == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_EVENT_RECEIVER_INVALID_ARG;
+    }
+    else if ((item = findPartition(eventReceiverHandle, partitionId)) == NULL)
+    {
+        LogError("Partition %s is not open", partitionId);
+        result = IOTHUB_EVENT_RECEIVER_PARTITION_NOT_FOUND;
+    }
+    else
+    {
+        PARTITION_RECEIVER* partition = (PARTITION_RECEIVER*)singlylinkedlist_item_get_value(item);
+
+        (void)singlylinkedlist_remove(eventReceiverHandle->partitions, item);
+        closePartitionReceiver(partition);
+        result = IOTHUB_EVENT_RECEIVER_OK;
+    }
+
+    return result;
+}
+
+void IoTHubEventReceiver_LL_Close(IOTHUB_EVENT_RECEIVER_LL_HANDLE eventReceiverHandle)
+{
+    if (eventReceiverHandle == NULL)
+    {
+        LogError("Input parameter cannot be NULL");
+    }
+    else
+    {
+        LIST_ITEM_HANDLE item;
+
+        /*Codes_SRS_IOTHUBEVENTRECEIVER_41_022: [ IoTHubEventReceiver_LL_Close shall close every open partition, then destroy the session, connection, SASL IO, TLS IO and SASL mechanism ] */
+        while ((item = singlylinkedlist_get_head_item(eventReceiverHandle->partitions)) != NULL)
+        {
+            PARTITION_RECEIVER* partition = (PARTITION_RECEIVER*)singlylinkedlist_item_get_value(item);
+
+            (void)singlylinkedlist_remove(eventReceiverHandle->partitions, item);
+            closePartitionReceiver(partition);
+        }
+
+        closeConnection(eventReceiverHandle);
+    }
+}
+
+void IoTHubEventReceiver_LL_DoWork(IOTHUB_EVENT_RECEIVER_LL_HANDLE eventReceiverHandle)
+{
+    /*Codes_SRS_IOTHUBEVENTRECEIVER_41_023: [ If eventReceiverHandle is NULL or no partition was opened IoTHubEventReceiver_LL_DoWork shall return, otherwise it shall call connection_dowork ] */
+    if ((eventReceiverHandle != NULL) && (eventReceiverHandle->connection != NULL))
+    {
+        connection_dowork(eventReceiverHandle->connection);
+    }
+}
@@ -0,0 +1,623 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/uniqueid.h"
+
+#include "parson.h"
+#include "iothub_jobs.h"
+#include "iothub_sc_version.h"
+#include "iothub_sc_http_pool.h"
+
+#define  HTTP_HEADER_KEY_AUTHORIZATION  "Authorization"
+#define  HTTP_HEADER_VAL_AUTHORIZATION  " "
+#define  HTTP_HEADER_KEY_REQUEST_ID  "Request-Id"
+#define  HTTP_HEADER_KEY_USER_AGENT  "User-Agent"
+#define  HTTP_HEADER_VAL_USER_AGENT  IOTHUB_SERVICE_CLIENT_TYPE_PREFIX IOTHUB_SERVICE_CLIENT_BACKSLASH IOTHUB_SERVICE_CLIENT_VERSION
+#define  HTTP_HEADER_KEY_CONTENT_TYPE  "Content-Type"
+#define  HTTP_HEADER_VAL_CONTENT_TYPE  "application/json; charset=utf-8"
+#define UID_LENGTH 37
+#define ISO8601_TIME_LENGTH 21
+
+static const char* URL_API_VERSION = "?api-version=2016-11-14";
+
+static const char* RELATIVE_PATH_FMT_JOB = "/jobs/v2/%s%s";
+static const char* RELATIVE_PATH_FMT_JOB_CANCEL = "/jobs/v2/%s/cancel%s";
+
+static const char* JOB_JSON_KEY_JOB_ID = "jobId";
+static const char* JOB_JSON_KEY_TYPE = "type";
+static const char* JOB_JSON_KEY_STATUS = "status";
+static const char* JOB_JSON_KEY_FAILURE_REASON = "failureReason";
+static const char* JOB_JSON_KEY_QUERY_CONDITION = "queryCondition";
+static const char* JOB_JSON_KEY_START_TIME = "startTime";
+static const char* JOB_JSON_KEY_MAX_EXECUTION_TIME = "maxExecutionTimeInSeconds";
+static const char* JOB_JSON_KEY_UPDATE_TWIN = "updateTwin";
+static const char* JOB_JSON_KEY_METHOD_NAME = "cloudToDeviceMethod.methodName";
+static const char* JOB_JSON_KEY_METHOD_PAYLOAD = "cloudToDeviceMethod.payload";
+static const char* JOB_JSON_KEY_METHOD_RESPONSE_TIMEOUT = "cloudToDeviceMethod.responseTimeoutInSeconds";
+static const char* JOB_JSON_KEY_DEVICE_COUNT = "deviceJobStatistics.deviceCount";
+static const char* JOB_JSON_KEY_SUCCEEDED_COUNT = "deviceJobStatistics.succeededCount";
+static const char* JOB_JSON_KEY_FAILED_COUNT = "deviceJobStatistics.failedCount";
+static const char* JOB_JSON_KEY_RUNNING_COUNT = "deviceJobStatistics.runningCount";
+static const char* JOB_JSON_KEY_PENDING_COUNT = "deviceJobStatistics.pendingCount";
+
+static const char* JOB_JSON_VALUE_TYPE_UPDATE_TWIN = "scheduleUpdateTwin";
+static const char* JOB_JSON_VALUE_TYPE_DEVICE_METHOD = "scheduleDeviceMethod";
+
+/** @brief Structure to store IoTHub authentication information
+*/
+typedef struct IOTHUB_SERVICE_CLIENT_JOBS_TAG
+{
+    char* hostname;
+    char* sharedAccessKey;
+    char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
+} IOTHUB_SERVICE_CLIENT_JOBS;
+
+static const char* generateGuid(void)
+{
+    char* result;
+
+    if ((result = malloc(UID_LENGTH)) != NULL)
+    {
+        result[0] = '\0';
+        if (UniqueId_Generate(result, UID_LENGTH) != UNIQUEID_OK)
+        {
+            free((void*)result);
+            result = NULL;
+        }
+    }
+    return (const char*)result;
+}
+
+static HTTP_HEADERS_HANDLE createHttpHeader(void)
+{
+    /*Codes_SRS_IOTHUBJOBS_41_011: [ The jobs functions shall add the following headers to the request: Authorization, Request-Id, User-Agent and Content-Type=application/json; charset=utf-8 ]*/
+    HTTP_HEADERS_HANDLE httpHeader;
+    const char* guid = NULL;
+
+    if ((httpHeader = HTTPHeaders_Alloc()) == NULL)
+    {
+        LogError("HTTPHeaders_Alloc failed");
+    }
+    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_AUTHORIZATION, HTTP_HEADER_VAL_AUTHORIZATION) != HTTP_HEADERS_OK)
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for Authorization header");
+        HTTPHeaders_Free(httpHeader);
+        httpHeader = NULL;
+    }
+    else if ((guid = generateGuid()) == NULL)
+    {
+        LogError("GUID creation failed");
+        HTTPHeaders_Free(httpHeader);
+        httpHeader = NULL;
+    }
+    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_REQUEST_ID, guid) != HTTP_HEADERS_OK)
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for RequestId header");
+        HTTPHeaders_Free(httpHeader);
+        httpHeader = NULL;
+    }
+    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_USER_AGENT, HTTP_HEADER_VAL_USER_AGENT) != HTTP_HEADERS_OK)
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for User-Agent header");
+        HTTPHeaders_Free(httpHeader);
+        httpHeader = NULL;
+    }
+    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_CONTENT_TYPE, HTTP_HEADER_VAL_CONTENT_TYPE) != HTTP_HEADERS_OK)
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for Content-Type header");
+        HTTPHeaders_Free(httpHeader);
+        httpHeader = NULL;
+    }
+    free((void*)guid);
+
+    return httpHeader;
+}
+
+static IOTHUB_JOB_TYPE parseJobType(const char* type)
+{
+    IOTHUB_JOB_TYPE result;
+
+    if (type == NULL)
+    {
+        result = IOTHUB_JOB_TYPE_UNKNOWN;
+    }
+    else if (strcmp(type, JOB_JSON_VALUE_TYPE_UPDATE_TWIN) == 0)
+    {
+        result = IOTHUB_JOB_TYPE_SCHEDULE_UPDATE_TWIN;
+    }
+    else if (strcmp(type, JOB_JSON_VALUE_TYPE_DEVICE_METHOD) == 0)
+    {
+        result = IOTHUB_JOB_TYPE_SCHEDULE_DEVICE_METHOD;
+    }
+    else
+    {
+        result = IOTHUB_JOB_TYPE_UNKNOWN;
+    }
+
+    return result;
+}
+
+static IOTHUB_JOB_STATUS parseJobStatus(const char* status)
+{
+    IOTHUB_JOB_STATUS result;
+
+    if (status == NULL)
+    {
+        result = IOTHUB_JOB_STATUS_UNKNOWN;
+    }
+    else if (strcmp(status, "queued") == 0)
+    {
+        result = IOTHUB_JOB_STATUS_QUEUED;
+    }
+    else if (strcmp(status, "scheduled") == 0)
+    {
+        result = IOTHUB_JOB_STATUS_SCHEDULED;
+    }
+    else if (strcmp(status, "running") == 0)
+    {
+        result = IOTHUB_JOB_STATUS_RUNNING;
+    }
+    else if (strcmp(status, "completed") == 0)
+    {
+        result = IOTHUB_JOB_STATUS_COMPLETED;
+    }
+    else if (strcmp(status, "failed") == 0)
+    {
+        result = IOTHUB_JOB_STATUS_FAILED;
+    }
+    else if (strcmp(status, "cancelled") == 0)
+    {
+        result = IOTHUB_JOB_STATUS_CANCELLED;
+    }
+    else
+    {
+        result = IOTHUB_JOB_STATUS_UNKNOWN;
+    }
+
+    return result;
+}
+
+static IOTHUB_JOBS_RESULT parseJobJson(BUFFER_HANDLE jsonBuffer, IOTHUB_JOB* job)
+{
+    IOTHUB_JOBS_RESULT result;
+    const char* bufferStr;
+    JSON_Value* root_value;
+    JSON_Object* root_object;
+
+    memset(job, 0, sizeof(IOTHUB_JOB));
+
+    /*Codes_SRS_IOTHUBJOBS_41_014: [ The jobs functions shall parse the jobId, type, status, failureReason and deviceJobStatistics of the response into job; jobId and failureReason shall be allocated copies owned by the caller ]*/
+    if ((bufferStr = (const char*)BUFFER_u_char(jsonBuffer)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBJOBS_41_015: [ If the response cannot be parsed the jobs functions shall return IOTHUB_JOBS_JSON_ERROR ]*/
+        LogError("BUFFER_u_char failed");
+        result = IOTHUB_JOBS_JSON_ERROR;
+    }
+    else if ((root_value = json_parse_string(bufferStr)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBJOBS_41_015: [ If the response cannot be parsed the jobs functions shall return IOTHUB_JOBS_JSON_ERROR ]*/
+        LogError("json_parse_string failed");
+        result = IOTHUB_JOBS_JSON_ERROR;
+    }
+    else
+    {
+        if ((root_object = json_value_get_object(root_value)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBJOBS_41_015: [ If the response cannot be parsed the jobs functions shall return IOTHUB_JOBS_JSON_ERROR ]*/
+            LogError("json_value_get_object failed");
+            result = IOTHUB_JOBS_JSON_ERROR;
+        }
+        else
+        {
+            const char* jobId = json_object_get_string(root_object, JOB_JSON_KEY_JOB_ID);
+            const char* failureReason = json_object_get_string(root_object, JOB_JSON_KEY_FAILURE_REASON);
+
+            if (jobId == NULL)
+            {
+                /*Codes_SRS_IOTHUBJOBS_41_015: [ If the response cannot be parsed the jobs functions shall return IOTHUB_JOBS_JSON_ERROR ]*/
+                LogError("Job response has no jobId");
+                result = IOTHUB_JOBS_JSON_ERROR;
+            }
+            else if (mallocAndStrcpy_s((char**)&job->jobId, jobId) != 0)
+            {
+                LogError("mallocAndStrcpy_s failed for jobId");
+                job->jobId = NULL;
+                result = IOTHUB_JOBS_ERROR;
+            }
+            else if ((failureReason != NULL) && (mallocAndStrcpy_s((char**)&job->failureReason, failureReason) != 0))
+            {
+                LogError("mallocAndStrcpy_s failed for failureReason");
+                free((char*)job->jobId);
+                job->jobId = NULL;
+                job->failureReason = NULL;
+                result = IOTHUB_JOBS_ERROR;
+            }
+            else
+            {
+                job->type = parseJobType(json_object_get_string(root_object, JOB_JSON_KEY_TYPE));
+                job->status = parseJobStatus(json_object_get_string(root_object, JOB_JSON_KEY_STATUS));
+                job->deviceCount = (size_t)json_object_dotget_number(root_object, JOB_JSON_KEY_DEVICE_COUNT);
+                job->succeededCount = (size_t)json_object_dotget_number(root_object, JOB_JSON_KEY_SUCCEEDED_COUNT);
+                job->failedCount = (size_t)json_object_dotget_number(root_object, JOB_JSON_KEY_FAILED_COUNT);
+                job->runningCount = (size_t)json_object_dotget_number(root_object, JOB_JSON_KEY_RUNNING_COUNT);
+                job->pendingCount = (size_t)json_object_dotget_number(root_object, JOB_JSON_KEY_PENDING_COUNT);
+                result = IOTHUB_JOBS_OK;
+            }
+        }
+        json_value_free(root_value);
+    }
+
+    return result;
+}
+
+static IOTHUB_JOBS_RESULT sendHttpRequestJobs(IOTHUB_SERVICE_CLIENT_JOBS_HANDLE serviceClientJobsHandle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePathFormat, const char* jobId, BUFFER_HANDLE jobJsonBuffer, IOTHUB_JOB* job)
+{
+    IOTHUB_JOBS_RESULT result;
+    HTTP_HEADERS_HANDLE httpHeader;
+    STRING_HANDLE relativePath;
+    BUFFER_HANDLE responseBuffer;
+    unsigned int statusCode = 0;
+
+    if ((httpHeader = createHttpHeader()) == NULL)
+    {
+        /*Codes_SRS_IOTHUBJOBS_41_016: [ If any other call fails the jobs functions shall return IOTHUB_JOBS_ERROR ]*/
+        LogError("HttpHeader creation failed");
+        result = IOTHUB_JOBS_ERROR;
+    }
+    else
+    {
+        if ((relativePath = STRING_construct_sprintf(relativePathFormat, jobId, URL_API_VERSION)) == NULL)
+        {
+            LogError("Failure creating relative path");
+            result = IOTHUB_JOBS_ERROR;
+        }
+        else
+        {
+            if ((responseBuffer = BUFFER_new()) == NULL)
+            {
+                LogError("BUFFER_new failed for responseBuffer");
+                result = IOTHUB_JOBS_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBJOBS_41_012: [ The jobs functions shall execute the request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
+                if (IoTHubScHttpPool_ExecuteRequest(serviceClientJobsHandle->httpPool, requestType, STRING_c_str(relativePath), httpHeader, jobJsonBuffer, &statusCode, responseBuffer) != HTTPAPIEX_OK)
+                {
+                    /*Codes_SRS_IOTHUBJOBS_41_013: [ If the request fails the jobs functions shall return IOTHUB_JOBS_HTTPAPI_ERROR, and if the HTTP status code is not 2xx they shall return IOTHUB_JOBS_HTTP_STATUS_ERROR ]*/
+                    LogError("IoTHubScHttpPool_ExecuteRequest failed");
+                    result = IOTHUB_JOBS_HTTPAPI_ERROR;
+                }
+                else if ((statusCode < 200) || (statusCode >= 300))
+                {
+                    LogError("Http Failure status code %u.", statusCode);
+                    result = IOTHUB_JOBS_HTTP_STATUS_ERROR;
+                }
+                else
+                {
+                    result = parseJobJson(responseBuffer, job);
+                }
+                BUFFER_delete(responseBuffer);
+            }
+            STRING_delete(relativePath);
+        }
+        HTTPHeaders_Free(httpHeader);
+    }
+
+    return result;
+}
+
+static JSON_Value* createJobJson(const char* jobId, const char* jobType, const char* queryCondition, time_t startTime, unsigned int maxExecutionTimeInSeconds)
+{
+    JSON_Value* result;
+    JSON_Object* root_object;
+    char startTimeString[ISO8601_TIME_LENGTH];
+    struct tm* startTimeUtc;
+
+    if (startTime == 0)
+    {
+        startTime = time(NULL);
+    }
+
+    /*Codes_SRS_IOTHUBJOBS_41_008: [ IoTHubJobs_ScheduleTwinUpdate and IoTHubJobs_ScheduleDeviceMethod shall create a JSON object containing jobId, type, queryCondition, startTime as an ISO 8601 UTC time (now if startTime is 0) and maxExecutionTimeInSeconds ]*/
+    if (((startTimeUtc = gmtime(&startTime)) == NULL) || (strftime(startTimeString, sizeof(startTimeString), "%Y-%m-%dT%H:%M:%SZ", startTimeUtc) == 0))
+    {
+        LogError("Failure formatting startTime");
+        result = NULL;
+    }
+    else if ((result = json_value_init_object()) == NULL)
+    {
+        LogError("json_value_init_object failed");
+    }
+    else if ((root_object = json_value_get_object(result)) == NULL)
+    {
+        LogError("json_value_get_object failed");
+        json_value_free(result);
+        result = NULL;
+    }
+    else if ((json_object_set_string(root_object, JOB_JSON_KEY_JOB_ID, jobId) != JSONSuccess) ||
+        (json_object_set_string(root_object, JOB_JSON_KEY_TYPE, jobType) != JSONSuccess) ||
+        (json_object_set_string(root_object, JOB_JSON_KEY_QUERY_CONDITION, queryCondition) != JSONSuccess) ||
+        (json_object_set_string(root_object, JOB_JSON_KEY_START_TIME, startTimeString) != JSONSuccess) ||
+        (json_object_set_number(root_object, JOB_JSON_KEY_MAX_EXECUTION_TIME, (double)maxExecutionTimeInSeconds) != JSONSuccess))
+    {
+        LogError("Failure setting the job properties");
+        json_value_free(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static BUFFER_HANDLE serializeJobJson(JSON_Value* root_value)
+{
+    BUFFER_HANDLE result;
+    char* serialized_string;
+
+    if ((serialized_string = json_serialize_to_string(root_value)) == NULL)
+    {
+        LogError("json_serialize_to_string failed");
+        result = NULL;
+    }
+    else
+    {
+        if ((result = BUFFER_create((const unsigned char*)serialized_string, strlen(serialized_string))) == NULL)
+        {
+            LogError("BUFFER_create failed");
+        }
+        json_free_serialized_string(serialized_string);
+    }
+
+    return result;
+}
+
+static IOTHUB_JOBS_RESULT scheduleJob(IOTHUB_SERVICE_CLIENT_JOBS_HANDLE serviceClientJobsHandle, const char* jobId, JSON_Value* root_value, IOTHUB_JOB* job)
+{
+    IOTHUB_JOBS_RESULT result;
+    BUFFER_HANDLE jobJsonBuffer;
+
+    if ((jobJsonBuffer = serializeJobJson(root_value)) == NULL)
+    {
+        LogError("Failure serializing the job");
+        result = IOTHUB_JOBS_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBJOBS_41_010: [ IoTHubJobs_ScheduleTwinUpdate and IoTHubJobs_ScheduleDeviceMethod shall send the job as an HTTP PUT request to url/jobs/v2/[jobId] ]*/
+        result = sendHttpRequestJobs(serviceClientJobsHandle, HTTPAPI_REQUEST_PUT, RELATIVE_PATH_FMT_JOB, jobId, jobJsonBuffer, job);
+        BUFFER_delete(jobJsonBuffer);
+    }
+
+    return result;
+}
+
+IOTHUB_SERVICE_CLIENT_JOBS_HANDLE IoTHubJobs_Create(IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientHandle)
+{
+    IOTHUB_SERVICE_CLIENT_JOBS_HANDLE result;
+
+    /*Codes_SRS_IOTHUBJOBS_41_001: [ If the serviceClientHandle input parameter is NULL IoTHubJobs_Create shall return NULL ]*/
+    if (serviceClientHandle == NULL)
+    {
+        LogError("serviceClientHandle input parameter cannot be NULL");
+        result = NULL;
+    }
+    else
+    {
+        IOTHUB_SERVICE_CLIENT_AUTH* serviceClientAuth = (IOTHUB_SERVICE_CLIENT_AUTH*)serviceClientHandle;
+
+        /*Codes_SRS_IOTHUBJOBS_41_002: [ If the hostname, keyName or sharedAccessKey member of the serviceClientHandle input parameter is NULL IoTHubJobs_Create shall return NULL ]*/
+        if (serviceClientAuth->hostname == NULL)
+        {
+            LogError("authInfo->hostName input parameter cannot be NULL");
+            result = NULL;
+        }
+        else if (serviceClientAuth->keyName == NULL)
+        {
+            LogError("authInfo->keyName input parameter cannot be NULL");
+            result = NULL;
+        }
+        else if (serviceClientAuth->sharedAccessKey == NULL)
+        {
+            LogError("authInfo->sharedAccessKey input parameter cannot be NULL");
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBJOBS_41_003: [ IoTHubJobs_Create shall allocate memory for a new IOTHUB_SERVICE_CLIENT_JOBS_HANDLE instance and copy hostname, sharedAccessKey and keyName by calling mallocAndStrcpy_s ]*/
+        else if ((result = malloc(sizeof(IOTHUB_SERVICE_CLIENT_JOBS))) == NULL)
+        {
+            /*Codes_SRS_IOTHUBJOBS_41_005: [ If any of the above fails IoTHubJobs_Create shall free what it allocated and return NULL ]*/
+            LogError("Malloc failed for IOTHUB_SERVICE_CLIENT_JOBS");
+        }
+        else
+        {
+            memset(result, 0, sizeof(IOTHUB_SERVICE_CLIENT_JOBS));
+
+            if (mallocAndStrcpy_s(&result->hostname, serviceClientAuth->hostname) != 0)
+            {
+                LogError("mallocAndStrcpy_s failed for hostName");
+                free(result);
+                result = NULL;
+            }
+            else if (mallocAndStrcpy_s(&result->sharedAccessKey, serviceClientAuth->sharedAccessKey) != 0)
+            {
+                LogError("mallocAndStrcpy_s failed for sharedAccessKey");
+                free(result->hostname);
+                free(result);
+                result = NULL;
+            }
+            else if (mallocAndStrcpy_s(&result->keyName, serviceClientAuth->keyName) != 0)
+            {
+                LogError("mallocAndStrcpy_s failed for keyName");
+                free(result->hostname);
+                free(result->sharedAccessKey);
+                free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_IOTHUBJOBS_41_004: [ IoTHubJobs_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none ]*/
+            else if ((result->httpPool = ((serviceClientAuth->httpPool != NULL) ? IoTHubScHttpPool_Clone(serviceClientAuth->httpPool) : IoTHubScHttpPool_Create(result->hostname, result->sharedAccessKey, result->keyName))) == NULL)
+            {
+                LogError("unable to get an HTTP connection pool");
+                free(result->hostname);
+                free(result->sharedAccessKey);
+                free(result->keyName);
+                free(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
+
+void IoTHubJobs_Destroy(IOTHUB_SERVICE_CLIENT_JOBS_HANDLE serviceClientJobsHandle)
+{
+    /*Codes_SRS_IOTHUBJOBS_41_006: [ If serviceClientJobsHandle is NULL IoTHubJobs_Destroy shall return, otherwise it shall release its reference to the HTTP connection pool and free the memory of the handle ]*/
+    if (serviceClientJobsHandle != NULL)
+    {
+        free(serviceClientJobsHandle->hostname);
+        free(serviceClientJobsHandle->sharedAccessKey);
+        free(serviceClientJobsHandle->keyName);
+        IoTHubScHttpPool_Destroy(serviceClientJobsHandle->httpPool);
+        free(serviceClientJobsHandle);
+    }
+}
+
+IOTHUB_JOBS_RESULT IoTHubJobs_ScheduleTwinUpdate(IOTHUB_SERVICE_CLIENT_JOBS_HANDLE serviceClientJobsHandle, const char* jobId, const char* queryCondition, const char* twinPatchJson, time_t startTime, unsigned int maxExecutionTimeInSeconds, IOTHUB_JOB* job)
+{
+    IOTHUB_JOBS_RESULT result;
+
+    /*Codes_SRS_IOTHUBJOBS_41_007: [ If serviceClientJobsHandle, jobId, queryCondition, twinPatchJson, methodName or job is NULL the schedule functions shall return IOTHUB_JOBS_INVALID_ARG ]*/
+    if ((serviceClientJobsHandle == NULL) || (jobId == NULL) || (queryCondition == NULL) || (twinPatchJson == NULL) || (job == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_JOBS_INVALID_ARG;
+    }
+    else
+    {
+        JSON_Value* root_value;
+        JSON_Value* patch_value;
+
+        if ((root_value = createJobJson(jobId, JOB_JSON_VALUE_TYPE_UPDATE_TWIN, queryCondition, startTime, maxExecutionTimeInSeconds)) == NULL)
+        {
+            LogError("Failure creating the job JSON");
+            result = IOTHUB_JOBS_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBJOBS_41_009: [ IoTHubJobs_ScheduleTwinUpdate shall add twinPatchJson as updateTwin and IoTHubJobs_ScheduleDeviceMethod shall add cloudToDeviceMethod with methodName, methodPayload (null if NULL) and responseTimeoutInSeconds; if twinPatchJson or methodPayload is not valid JSON they shall return IOTHUB_JOBS_JSON_ERROR ]*/
+            if ((patch_value = json_parse_string(twinPatchJson)) == NULL)
+            {
+                LogError("twinPatchJson is not valid JSON");
+                result = IOTHUB_JOBS_JSON_ERROR;
+            }
+            else if (json_object_set_value(json_value_get_object(root_value), JOB_JSON_KEY_UPDATE_TWIN, patch_value) != JSONSuccess)
+            {
+                LogError("json_object_set_value failed for updateTwin");
+                json_value_free(patch_value);
+                result = IOTHUB_JOBS_ERROR;
+            }
+            else
+            {
+                result = scheduleJob(serviceClientJobsHandle, jobId, root_value, job);
+            }
+            json_value_free(root_value);
+        }
+    }
+    return result;
+}
+
+IOTHUB_JOBS_RESULT IoTHubJobs_ScheduleDeviceMethod(IOTHUB_SERVICE_CLIENT_JOBS_HANDLE serviceClientJobsHandle, const char* jobId, const char* queryCondition, const char* methodName, const char* methodPayload, unsigned int responseTimeoutInSeconds, time_t startTime, unsigned int maxExecutionTimeInSeconds, IOTHUB_JOB* job)
+{
+    IOTHUB_JOBS_RESULT result;
+
+    /*Codes_SRS_IOTHUBJOBS_41_007: [ If serviceClientJobsHandle, jobId, queryCondition, twinPatchJson, methodName or job is NULL the schedule functions shall return IOTHUB_JOBS_INVALID_ARG ]*/
+    if ((serviceClientJobsHandle == NULL) || (jobId == NULL) || (queryCondition == NULL) || (methodName == NULL) || (job == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_JOBS_INVALID_ARG;
+    }
+    else
+    {
+        JSON_Value* root_value;
+        JSON_Value* payload_value;
+
+        if ((root_value = createJobJson(jobId, JOB_JSON_VALUE_TYPE_DEVICE_METHOD, queryCondition, startTime, maxExecutionTimeInSeconds)) == NULL)
+        {
+            LogError("Failure creating the job JSON");
+            result = IOTHUB_JOBS_ERROR;
+        }
+        else
+        {
+            JSON_Object* root_object = json_value_get_object(root_value);
+
+            /*Codes_SRS_IOTHUBJOBS_41_009: [ IoTHubJobs_ScheduleTwinUpdate shall add twinPatchJson as updateTwin and IoTHubJobs_ScheduleDeviceMethod shall add cloudToDeviceMethod with methodName, methodPayload (null if NULL) and responseTimeoutInSeconds; if twinPatchJson or methodPayload is not valid JSON they shall return IOTHUB_JOBS_JSON_ERROR ]*/
+            if ((json_object_dotset_string(root_object, JOB_JSON_KEY_METHOD_NAME, methodName) != JSONSuccess) ||
+                (json_object_dotset_number(root_object, JOB_JSON_KEY_METHOD_RESPONSE_TIMEOUT, (double)responseTimeoutInSeconds) != JSONSuccess))
+            {
+                LogError("Failure setting the method properties");
+                result = IOTHUB_JOBS_ERROR;
+            }
+            else if ((payload_value = ((methodPayload == NULL) ? json_value_init_null() : json_parse_string(methodPayload))) == NULL)
+            {
+                LogError("methodPayload is not valid JSON");
+                result = IOTHUB_JOBS_JSON_ERROR;
+            }
+            else if (json_object_dotset_value(root_object, JOB_JSON_KEY_METHOD_PAYLOAD, payload_value) != JSONSuccess)
+            {
+                LogError("json_object_dotset_value failed for payload");
+                json_value_free(payload_value);
+                result = IOTHUB_JOBS_ERROR;
+            }
+            else
+            {
+                result = scheduleJob(serviceClientJobsHandle, jobId, root_value, job);
+            }
+            json_value_free(root_value);
+        }
+    }
+    return result;
+}
+
+IOTHUB_JOBS_RESULT IoTHubJobs_GetJob(IOTHUB_SERVICE_CLIENT_JOBS_HANDLE serviceClientJobsHandle, const char* jobId, IOTHUB_JOB* job)
+{
+    IOTHUB_JOBS_RESULT result;
+
+    /*Codes_SRS_IOTHUBJOBS_41_017: [ If serviceClientJobsHandle, jobId or job is NULL IoTHubJobs_GetJob and IoTHubJobs_CancelJob shall return IOTHUB_JOBS_INVALID_ARG ]*/
+    if ((serviceClientJobsHandle == NULL) || (jobId == NULL) || (job == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_JOBS_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBJOBS_41_018: [ IoTHubJobs_GetJob shall send an HTTP GET request to url/jobs/v2/[jobId] ]*/
+        result = sendHttpRequestJobs(serviceClientJobsHandle, HTTPAPI_REQUEST_GET, RELATIVE_PATH_FMT_JOB, jobId, NULL, job);
+    }
+    return result;
+}
+
+IOTHUB_JOBS_RESULT IoTHubJobs_CancelJob(IOTHUB_SERVICE_CLIENT_JOBS_HANDLE serviceClientJobsHandle, const char* jobId, IOTHUB_JOB* job)
+{
+    IOTHUB_JOBS_RESULT result;
+
+    /*Codes_SRS_IOTHUBJOBS_41_017: [ If serviceClientJobsHandle, jobId or job is NULL IoTHubJobs_GetJob and IoTHubJobs_CancelJob shall return IOTHUB_JOBS_INVALID_ARG ]*/
+    if ((serviceClientJobsHandle == NULL) || (jobId == NULL) || (job == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_JOBS_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBJOBS_41_019: [ IoTHubJobs_CancelJob shall send an HTTP POST request to url/jobs/v2/[jobId]/cancel ]*/
+        result = sendHttpRequestJobs(serviceClientJobsHandle, HTTPAPI_REQUEST_POST, RELATIVE_PATH_FMT_JOB_CANCEL, jobId, NULL, job);
+    }
+    return result;
+}
@@ -21,11 +21,13 @@
 #include <signal.h>
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 
 #include "parson.h"
 
 #include "iothub_messaging_ll.h"
 #include "iothub_messaging.h"
+#include "iothub_client_worker_pool.h"
 
 typedef struct IOTHUB_MESSAGING_CLIENT_INSTANCE_TAG
 {
@@ -33,8 +35,85 @@ typedef struct IOTHUB_MESSAGING_CLIENT_INSTANCE_TAG
     THREAD_HANDLE ThreadHandle;
     LOCK_HANDLE LockHandle;
     sig_atomic_t StopThread;
+    COND_HANDLE WorkCondition;
+    WORKER_POOL_ITEM_HANDLE WorkerPoolItem;
 } IOTHUB_MESSAGING_CLIENT_INSTANCE;
 
+/*the AMQP connection does not expose readiness, so an idle client still calls IoTHubMessaging_LL_DoWork this often to get feedback messages and keep the connection alive*/
+#define WORKER_MAX_IDLE_TIME_MS 100
+
+/*when set by IoTHubMessaging_WorkerPool_Init, serves the messaging clients instead of one thread each, whatever IoT hub they are connected to*/
+static WORKER_POOL_HANDLE g_worker_pool = NULL;
+
+/*this function is called with the lock taken, right after IoTHubMessaging_LL_DoWork*/
+static unsigned int get_next_work_time(IOTHUB_MESSAGING_CLIENT_INSTANCE* iotHubMessagingClientInstance)
+{
+    size_t pendingSendCount;
+    unsigned int result;
+
+    if ((IoTHubMessaging_LL_GetPendingSendCount(iotHubMessagingClientInstance->IoTHubMessagingHandle, &pendingSendCount) != IOTHUB_MESSAGING_OK) ||
+        (pendingSendCount != 0))
+    {
+        result = 1;
+    }
+    else
+    {
+        result = WORKER_MAX_IDLE_TIME_MS;
+    }
+    return result;
+}
+
+/*this function is called with the lock taken, right after IoTHubMessaging_LL_DoWork*/
+static void wait_for_work(IOTHUB_MESSAGING_CLIENT_INSTANCE* iotHubMessagingClientInstance)
+{
+    /*Codes_SRS_IOTHUBMESSAGING_41_028: [ While IoTHubMessaging_LL_GetPendingSendCount reports pending sends, or if it fails, the thread shall wait on the work condition for 1 ms only. ]*/
+    int waitTime = (int)get_next_work_time(iotHubMessagingClientInstance);
+
+    COND_RESULT waitResult = Condition_Wait(iotHubMessagingClientInstance->WorkCondition, iotHubMessagingClientInstance->LockHandle, waitTime);
+    if ((waitResult != COND_OK) && (waitResult != COND_TIMEOUT))
+    {
+        LogError("Condition_Wait failed");
+    }
+}
+
+/*wakes up the worker thread when it waits on the work condition, or makes the client due in the worker pool*/
+static void signal_worker_thread(IOTHUB_MESSAGING_CLIENT_INSTANCE* iotHubMessagingClientInstance)
+{
+    if (iotHubMessagingClientInstance->WorkerPoolItem != NULL)
+    {
+        if (worker_pool_schedule(iotHubMessagingClientInstance->WorkerPoolItem) != 0)
+        {
+            LogError("unable to worker_pool_schedule");
+        }
+    }
+    else if (Condition_Post(iotHubMessagingClientInstance->WorkCondition) != COND_OK)
+    {
+        LogError("unable to Condition_Post");
+    }
+}
+
+/*runs on a thread of the worker pool, which never runs it for the same client on two threads at once*/
+static unsigned int ScheduleWork_WorkerPool(void* work_context)
+{
+    IOTHUB_MESSAGING_CLIENT_INSTANCE* iotHubMessagingClientInstance = (IOTHUB_MESSAGING_CLIENT_INSTANCE*)work_context;
+    unsigned int result;
+
+    if (Lock(iotHubMessagingClientInstance->LockHandle) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_042: [ If acquiring the lock fails, the work function shall not call IoTHubMessaging_LL_DoWork and shall ask to be run again after 1 ms. ]*/
+        LogError("Lock failed, shall retry");
+        result = 1;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_041: [ The work function run by the worker pool shall call IoTHubMessaging_LL_DoWork under the lock created in IoTHubMessaging_Create, then ask to be run again after 1 ms while IoTHubMessaging_LL_GetPendingSendCount reports pending sends or fails, and after 100 ms otherwise. ]*/
+        IoTHubMessaging_LL_DoWork(iotHubMessagingClientInstance->IoTHubMessagingHandle);
+        result = get_next_work_time(iotHubMessagingClientInstance);
+        (void)Unlock(iotHubMessagingClientInstance->LockHandle);
+    }
+    return result;
+}
+
 static int ScheduleWork_Thread(void* threadArgument)
 {
     IOTHUB_MESSAGING_CLIENT_INSTANCE* iotHubMessagingClientInstance = (IOTHUB_MESSAGING_CLIENT_INSTANCE*)threadArgument;
@@ -51,9 +130,11 @@ static int ScheduleWork_Thread(void* threadArgument)
             }
             else
             {
-                /*Codes_SRS_IOTHUBMESSAGING_12_042: [ The thread created by IoTHubMessaging_SendAsync shall call IoTHubMessaging_LL_DoWork every 1 ms. ]*/
+                /*Codes_SRS_IOTHUBMESSAGING_12_042: [ The thread created by IoTHubMessaging_SendAsync shall call IoTHubMessaging_LL_DoWork, then wait on the work condition with the lock created in IoTHubMessaging_Create before calling it again. ]*/
                 /*Codes_SRS_IOTHUBMESSAGING_12_043: [ All calls to IoTHubMessaging_LL_DoWork shall be protected by the lock created in IoTHubMessaging_Create. ]*/
                 IoTHubMessaging_LL_DoWork(iotHubMessagingClientInstance->IoTHubMessagingHandle);
+                /*Codes_SRS_IOTHUBMESSAGING_41_029: [ Otherwise the thread shall wait on the work condition for at most 100 ms. ]*/
+                wait_for_work(iotHubMessagingClientInstance);
                 (void)Unlock(iotHubMessagingClientInstance->LockHandle);
             }
         }
@@ -61,8 +142,8 @@ static int ScheduleWork_Thread(void* threadArgument)
         {
             /*Codes_SRS_IOTHUBMESSAGING_12_044: [ If acquiring the lock fails, `IoTHubMessaging_LL_DoWork` shall not be called. ]*/
             LogError("Lock failed, shall retry");
+            (void)ThreadAPI_Sleep(1);
         }
-        (void)ThreadAPI_Sleep(1);
     }
 
     ThreadAPI_Exit(0);
@@ -72,7 +153,28 @@ static int ScheduleWork_Thread(void* threadArgument)
 static IOTHUB_MESSAGING_RESULT StartWorkerThreadIfNeeded(IOTHUB_MESSAGING_CLIENT_INSTANCE* iotHubMessagingClientInstance)
 {
     IOTHUB_MESSAGING_RESULT result;
-    if (iotHubMessagingClientInstance->ThreadHandle == NULL)
+    if (g_worker_pool != NULL)
+    {
+        if (iotHubMessagingClientInstance->WorkerPoolItem == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_038: [ If the worker pool is initialized, IoTHubMessaging_SendAsync shall add the client to the worker pool by calling worker_pool_add instead of starting a dedicated thread. ]*/
+            if ((iotHubMessagingClientInstance->WorkerPoolItem = worker_pool_add(g_worker_pool, ScheduleWork_WorkerPool, iotHubMessagingClientInstance)) == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGING_41_039: [ If worker_pool_add fails, IoTHubMessaging_SendAsync shall return IOTHUB_MESSAGING_ERROR. ]*/
+                LogError("worker_pool_add failed");
+                result = IOTHUB_MESSAGING_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_MESSAGING_OK;
+            }
+        }
+        else
+        {
+            result = IOTHUB_MESSAGING_OK;
+        }
+    }
+    else if (iotHubMessagingClientInstance->ThreadHandle == NULL)
     {
         iotHubMessagingClientInstance->StopThread = 0;
         if (ThreadAPI_Create(&iotHubMessagingClientInstance->ThreadHandle, ScheduleWork_Thread, iotHubMessagingClientInstance) != THREADAPI_OK)
@@ -92,6 +194,47 @@ static IOTHUB_MESSAGING_RESULT StartWorkerThreadIfNeeded(IOTHUB_MESSAGING_CLIENT
     return result;
 }
 
+IOTHUB_MESSAGING_RESULT IoTHubMessaging_WorkerPool_Init(size_t threadCount)
+{
+    IOTHUB_MESSAGING_RESULT result;
+
+    if (threadCount == 0)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_033: [ If threadCount is 0, IoTHubMessaging_WorkerPool_Init shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+        LogError("invalid argument threadCount (0)");
+        result = IOTHUB_MESSAGING_INVALID_ARG;
+    }
+    else if (g_worker_pool != NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_034: [ If the worker pool is already initialized, IoTHubMessaging_WorkerPool_Init shall return IOTHUB_MESSAGING_ERROR. ]*/
+        LogError("worker pool already initialized");
+        result = IOTHUB_MESSAGING_ERROR;
+    }
+    /*Codes_SRS_IOTHUBMESSAGING_41_035: [ IoTHubMessaging_WorkerPool_Init shall create the process wide worker pool by calling worker_pool_create with threadCount. ]*/
+    else if ((g_worker_pool = worker_pool_create(threadCount)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_036: [ If worker_pool_create fails, IoTHubMessaging_WorkerPool_Init shall return IOTHUB_MESSAGING_ERROR. ]*/
+        LogError("worker_pool_create failed");
+        result = IOTHUB_MESSAGING_ERROR;
+    }
+    else
+    {
+        result = IOTHUB_MESSAGING_OK;
+    }
+
+    return result;
+}
+
+void IoTHubMessaging_WorkerPool_Deinit(void)
+{
+    /*Codes_SRS_IOTHUBMESSAGING_41_037: [ IoTHubMessaging_WorkerPool_Deinit shall destroy the process wide worker pool, if any. ]*/
+    if (g_worker_pool != NULL)
+    {
+        worker_pool_destroy(g_worker_pool);
+        g_worker_pool = NULL;
+    }
+}
+
 IOTHUB_MESSAGING_CLIENT_HANDLE IoTHubMessaging_Create(IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientHandle)
 {
     IOTHUB_MESSAGING_CLIENT_INSTANCE* result;
@@ -123,6 +266,16 @@ IOTHUB_MESSAGING_CLIENT_HANDLE IoTHubMessaging_Create(IOTHUB_SERVICE_CLIENT_AUTH
                 free(result);
                 result = NULL;
             }
+            /*Codes_SRS_IOTHUBMESSAGING_41_026: [ IoTHubMessaging_Create shall create a condition used to wake up the worker thread when there is work for it. ]*/
+            else if ((result->WorkCondition = Condition_Init()) == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGING_41_027: [ If creating the condition fails, then IoTHubMessaging_Create shall return NULL. ]*/
+                /*Codes_SRS_IOTHUBMESSAGING_12_008: [If IoTHubMessaging_Create fails, all resources allocated by it shall be freed. ]*/
+                LogError("Condition_Init failed");
+                Lock_Deinit(result->LockHandle);
+                free(result);
+                result = NULL;
+            }
             else
             {
                 /*Codes_SRS_IOTHUBMESSAGING_12_006: [IoTHubMessaging_Create shall instantiate a new IoTHubMessaging_LL instance by calling IoTHubMessaging_LL_Create and passing the serviceClientHandle argument. ]*/
@@ -132,6 +285,7 @@ IOTHUB_MESSAGING_CLIENT_HANDLE IoTHubMessaging_Create(IOTHUB_SERVICE_CLIENT_AUTH
                     /*Codes_SRS_IOTHUBMESSAGING_12_007: [ If IoTHubMessaging_LL_Create fails, then IoTHubMessaging_Create shall return NULL. ]*/
                     /*Codes_SRS_IOTHUBMESSAGING_12_008: [If IoTHubMessaging_Create fails, all resources allocated by it shall be freed. ]*/
                     LogError("IoTHubMessaging_LL_Create failed");
+                    Condition_Deinit(result->WorkCondition);
                     Lock_Deinit(result->LockHandle);
                     free(result);
                     result = NULL;
@@ -140,6 +294,7 @@ IOTHUB_MESSAGING_CLIENT_HANDLE IoTHubMessaging_Create(IOTHUB_SERVICE_CLIENT_AUTH
                 {
                     result->StopThread = 0;
                     result->ThreadHandle = NULL;
+                    result->WorkerPoolItem = NULL;
                 }
             }
         }
@@ -158,12 +313,22 @@ void IoTHubMessaging_Destroy(IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandl
     {
         IOTHUB_MESSAGING_CLIENT_INSTANCE* messagingClientInstance = (IOTHUB_MESSAGING_CLIENT_INSTANCE*)messagingClientHandle;
 
+        if (messagingClientInstance->WorkerPoolItem != NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_044: [ If IoTHubMessaging_Close was not called, IoTHubMessaging_Destroy shall remove the client from the worker pool, waiting for a running work function to finish, before calling IoTHubMessaging_LL_Destroy. ]*/
+            worker_pool_remove(messagingClientInstance->WorkerPoolItem);
+            messagingClientInstance->WorkerPoolItem = NULL;
+        }
+
         /*Codes_SRS_IOTHUBMESSAGING_12_011: [ IoTHubMessaging_Destroy shall destroy IoTHubMessagingHandle by call IoTHubMessaging_LL_Destroy. ]*/
         IoTHubMessaging_LL_Destroy(messagingClientInstance->IoTHubMessagingHandle);
 
         /*Codes_SRS_IOTHUBMESSAGING_12_014: [ If the lock was allocated in IoTHubMessaging_Create, it shall be also freed. ]*/
         Lock_Deinit(messagingClientInstance->LockHandle);
 
+        /*Codes_SRS_IOTHUBMESSAGING_41_032: [ IoTHubMessaging_Destroy shall free the work condition created in IoTHubMessaging_Create. ]*/
+        Condition_Deinit(messagingClientInstance->WorkCondition);
+
         free(messagingClientInstance);
     }
 }
@@ -228,6 +393,18 @@ void IoTHubMessaging_Close(IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle)
             (void)Unlock(iotHubMessagingClientInstance->LockHandle);
         }
 
+        if (iotHubMessagingClientInstance->WorkerPoolItem != NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_043: [ If the client was added to the worker pool, IoTHubMessaging_Close shall remove it by calling worker_pool_remove, which waits for a running work function to finish, instead of posting the work condition and joining a thread. ]*/
+            worker_pool_remove(iotHubMessagingClientInstance->WorkerPoolItem);
+            iotHubMessagingClientInstance->WorkerPoolItem = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_030: [ IoTHubMessaging_Close shall post the work condition, so the worker thread sees the stop request without waiting for its timeout. ]*/
+            signal_worker_thread(iotHubMessagingClientInstance);
+        }
+
         if (iotHubMessagingClientInstance->ThreadHandle != NULL)
         {
             int res;
@@ -313,6 +490,10 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_SendAsync(IOTHUB_MESSAGING_CLIENT_HANDLE
                 /*Codes_SRS_IOTHUBMESSAGING_12_038: [ IoTHubMessaging_SendAsync shall call IoTHubMessaging_LL_Send, while passing the IOTHUB_MESSAGING_HANDLE handle created by IoTHubClient_Create and the parameters deviceId, message, sendCompleteCallback and userContextCallback.*/
                 /*Codes_SRS_IOTHUBMESSAGING_12_039: [ When IoTHubMessaging_LL_Send is called, IoTHubMessaging_SendAsync shall return the result of IoTHubMessaging_LL_Send. ]*/
                 result = IoTHubMessaging_LL_Send(iotHubMessagingClientInstance->IoTHubMessagingHandle, deviceId, message, sendCompleteCallback, userContextCallback);
+
+                /*Codes_SRS_IOTHUBMESSAGING_41_031: [ IoTHubMessaging_SendAsync shall post the work condition, so the worker thread calls IoTHubMessaging_LL_DoWork for the message without waiting for its timeout. ]*/
+                /*Codes_SRS_IOTHUBMESSAGING_41_040: [ If the client was added to the worker pool, IoTHubMessaging_SendAsync shall call worker_pool_schedule instead of posting the work condition. ]*/
+                signal_worker_thread(iotHubMessagingClientInstance);
             }
 
             /*Codes_SRS_IOTHUBMESSAGING_12_040: [ IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create. ]*/
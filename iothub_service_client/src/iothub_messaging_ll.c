@@ -28,13 +28,23 @@
 typedef struct CALLBACK_DATA_TAG
 {
     IOTHUB_OPEN_COMPLETE_CALLBACK openCompleteCompleteCallback;
-    IOTHUB_SEND_COMPLETE_CALLBACK sendCompleteCallback;
     IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK feedbackMessageCallback;
+    IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK feedbackRecordCallback;
     void* openUserContext;
-    void* sendUserContext;
     void* feedbackUserContext;
+    void* feedbackRecordUserContext;
 } CALLBACK_DATA;
 
+/*one per outstanding IoTHubMessaging_LL_Send, given to messagesender_send as the completion context*/
+typedef struct SEND_CALLBACK_DATA_TAG
+{
+    IOTHUB_SEND_COMPLETE_CALLBACK sendCompleteCallback;
+    void* sendUserContext;
+    struct IOTHUB_MESSAGING_TAG* messagingHandle;
+    struct SEND_CALLBACK_DATA_TAG* previous;
+    struct SEND_CALLBACK_DATA_TAG* next;
+} SEND_CALLBACK_DATA;
+
 typedef struct IOTHUB_MESSAGING_TAG
 {
     int isOpened;
@@ -59,8 +69,27 @@ typedef struct IOTHUB_MESSAGING_TAG
     MESSAGE_RECEIVER_STATE message_receiver_state;
 
     CALLBACK_DATA* callback_data;
+
+    SEND_CALLBACK_DATA* pending_sends;
+    size_t pending_send_count;
+    size_t max_outstanding_sends;
+    bool feedback_presettled;
+
+    /*the SAS token is renewed on the open connection through CBS; the signing strings are built once and kept*/
+    CBS_HANDLE cbs_handle;
+    bool is_cbs_open;
+    bool is_cbs_put_token_in_progress;
+    time_t sas_token_refresh_time;
+    STRING_HANDLE sas_signing_hostname;
+    STRING_HANDLE sas_signing_key;
+    STRING_HANDLE sas_signing_key_name;
 } IOTHUB_MESSAGING;
 
+#define SAS_TOKEN_LIFETIME_SECS         3600
+#define SAS_TOKEN_REFRESH_SECS          (SAS_TOKEN_LIFETIME_SECS * 4 / 5)
+#define SAS_TOKEN_RETRY_SECS            30
+
+static const char* SAS_TOKEN_TYPE = "servicebus.windows.net:sastoken";
 
 static const char* FEEDBACK_RECORD_KEY_DEVICE_ID = "deviceId";
 static const char* FEEDBACK_RECORD_KEY_DEVICE_GENERATION_ID = "deviceGenerationId";
@@ -404,7 +433,7 @@ static char* createSasToken(IOTHUB_MESSAGING_HANDLE messagingHandle)
         else
         {
             time_t currentTime = time(NULL);
-            size_t expiry_time = (size_t)(currentTime + (365 * 24 * 60 * 60));
+            size_t expiry_time = (size_t)(currentTime + SAS_TOKEN_LIFETIME_SECS);
             const char* c_buffer = NULL;
 
             STRING_HANDLE sasHandle = SASToken_Create(sharedAccessKey, hostName, keyName, expiry_time);
@@ -425,6 +454,8 @@ static char* createSasToken(IOTHUB_MESSAGING_HANDLE messagingHandle)
             }
             else
             {
+                /*Codes_SRS_IOTHUBMESSAGING_41_018: [ IoTHubMessaging_LL_Open shall create the SAS token with a lifetime of one hour and schedule its renewal at 80% of that lifetime ] */
+                messagingHandle->sas_token_refresh_time = currentTime + SAS_TOKEN_REFRESH_SECS;
                 result = buffer;
             }
             STRING_delete(sasHandle);
@@ -625,18 +656,285 @@ static void IoTHubMessaging_LL_ReceiverStateChanged(const void* context, MESSAGE
     }
 }
 
+static void addPendingSend(IOTHUB_MESSAGING* messagingData, SEND_CALLBACK_DATA* sendCallbackData)
+{
+    sendCallbackData->messagingHandle = messagingData;
+    sendCallbackData->previous = NULL;
+    sendCallbackData->next = messagingData->pending_sends;
+    if (messagingData->pending_sends != NULL)
+    {
+        messagingData->pending_sends->previous = sendCallbackData;
+    }
+    messagingData->pending_sends = sendCallbackData;
+    messagingData->pending_send_count++;
+}
+
+static void removePendingSend(SEND_CALLBACK_DATA* sendCallbackData)
+{
+    IOTHUB_MESSAGING* messagingData = sendCallbackData->messagingHandle;
+    if (sendCallbackData->previous != NULL)
+    {
+        sendCallbackData->previous->next = sendCallbackData->next;
+    }
+    else
+    {
+        messagingData->pending_sends = sendCallbackData->next;
+    }
+    if (sendCallbackData->next != NULL)
+    {
+        sendCallbackData->next->previous = sendCallbackData->previous;
+    }
+    messagingData->pending_send_count--;
+}
+
 static void IoTHubMessaging_LL_SendMessageComplete(void* context, IOTHUB_MESSAGING_RESULT send_result)
 {
     /*Codes_SRS_IOTHUBMESSAGING_12_056: [ If context is NULL IoTHubMessaging_LL_SendMessageComplete shall return ] */
     if (context != NULL)
     {
+        SEND_CALLBACK_DATA* sendCallbackData = (SEND_CALLBACK_DATA*)context;
+
+        /*Codes_SRS_IOTHUBMESSAGING_41_008: [ IoTHubMessaging_LL_SendMessageComplete shall remove the send context from the pending sends, call the user callback stored in it and free it ] */
+        /*unlinked first so that the user callback may call IoTHubMessaging_LL_Send or IoTHubMessaging_LL_Close*/
+        removePendingSend(sendCallbackData);
+
         /*Codes_SRS_IOTHUBMESSAGING_12_055: [ If context is not NULL and IoTHubMessaging_LL_SendMessageComplete shall call user callback with user context and messaging result ] */
-        IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
-        if (messagingData->callback_data->sendCompleteCallback != NULL)
+        if (sendCallbackData->sendCompleteCallback != NULL)
+        {
+            (sendCallbackData->sendCompleteCallback)(sendCallbackData->sendUserContext, send_result);
+        }
+        free(sendCallbackData);
+    }
+}
+
+static void destroySasRenewal(IOTHUB_MESSAGING_HANDLE messagingHandle)
+{
+    if (messagingHandle->cbs_handle != NULL)
+    {
+        cbs_destroy(messagingHandle->cbs_handle);
+        messagingHandle->cbs_handle = NULL;
+    }
+    if (messagingHandle->sas_signing_hostname != NULL)
+    {
+        STRING_delete(messagingHandle->sas_signing_hostname);
+        messagingHandle->sas_signing_hostname = NULL;
+    }
+    if (messagingHandle->sas_signing_key != NULL)
+    {
+        STRING_delete(messagingHandle->sas_signing_key);
+        messagingHandle->sas_signing_key = NULL;
+    }
+    if (messagingHandle->sas_signing_key_name != NULL)
+    {
+        STRING_delete(messagingHandle->sas_signing_key_name);
+        messagingHandle->sas_signing_key_name = NULL;
+    }
+    messagingHandle->is_cbs_open = false;
+    messagingHandle->is_cbs_put_token_in_progress = false;
+    messagingHandle->sas_token_refresh_time = 0;
+}
+
+static void on_cbs_open_complete(void* context, CBS_OPEN_COMPLETE_RESULT open_complete_result)
+{
+    IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
+
+    if (open_complete_result != CBS_OPEN_OK)
+    {
+        LogError("CBS open failed, the SAS token cannot be renewed");
+        messagingData->sas_token_refresh_time = time(NULL) + SAS_TOKEN_RETRY_SECS;
+    }
+    else
+    {
+        messagingData->is_cbs_open = true;
+    }
+}
+
+static void on_cbs_error(void* context)
+{
+    (void)context;
+    LogError("CBS Error occured");
+}
+
+static void on_cbs_put_token_complete(void* context, CBS_OPERATION_RESULT operation_result, unsigned int status_code, const char* status_description)
+{
+#ifdef NO_LOGGING
+    UNUSED(status_code);
+    UNUSED(status_description);
+#endif
+    IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
+
+    messagingData->is_cbs_put_token_in_progress = false;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_021: [ If the put-token operation fails, the renewal shall be retried 30 seconds later ] */
+    if (operation_result != CBS_OPERATION_RESULT_OK)
+    {
+        LogError("CBS reported status code %u, error: '%s' for put-token operation", status_code, status_description);
+        messagingData->sas_token_refresh_time = time(NULL) + SAS_TOKEN_RETRY_SECS;
+    }
+}
+
+static int putSasTokenToCbs(IOTHUB_MESSAGING_HANDLE messagingHandle, time_t currentTime)
+{
+    int result;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_020: [ The renewed SAS token shall be signed with hostname, sharedAccessKey and keyName STRING_HANDLEs built on the first renewal and reused until IoTHubMessaging_LL_Close ] */
+    if ((messagingHandle->sas_signing_hostname == NULL) &&
+        ((messagingHandle->sas_signing_hostname = STRING_construct(messagingHandle->hostname)) == NULL))
+    {
+        LogError("STRING_construct failed for hostName");
+        result = __FAILURE__;
+    }
+    else if ((messagingHandle->sas_signing_key == NULL) &&
+        ((messagingHandle->sas_signing_key = STRING_construct(messagingHandle->sharedAccessKey)) == NULL))
+    {
+        LogError("STRING_construct failed for sharedAccessKey");
+        result = __FAILURE__;
+    }
+    else if ((messagingHandle->sas_signing_key_name == NULL) &&
+        ((messagingHandle->sas_signing_key_name = STRING_construct(messagingHandle->keyName)) == NULL))
+    {
+        LogError("STRING_construct failed for keyName");
+        result = __FAILURE__;
+    }
+    else
+    {
+        STRING_HANDLE sasToken;
+
+        if ((sasToken = SASToken_Create(messagingHandle->sas_signing_key, messagingHandle->sas_signing_hostname, messagingHandle->sas_signing_key_name, (size_t)(currentTime + SAS_TOKEN_LIFETIME_SECS))) == NULL)
+        {
+            LogError("SASToken_Create failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_019: [ When the renewal is due, IoTHubMessaging_LL_DoWork shall send a new SAS token with cbs_put_token_async, using servicebus.windows.net:sastoken as type and the hostname as audience ] */
+            messagingHandle->is_cbs_put_token_in_progress = true;
+            if (cbs_put_token_async(messagingHandle->cbs_handle, SAS_TOKEN_TYPE, messagingHandle->hostname, STRING_c_str(sasToken), on_cbs_put_token_complete, messagingHandle) != 0)
+            {
+                LogError("cbs_put_token_async failed");
+                messagingHandle->is_cbs_put_token_in_progress = false;
+                result = __FAILURE__;
+            }
+            else
+            {
+                messagingHandle->sas_token_refresh_time = currentTime + SAS_TOKEN_REFRESH_SECS;
+                result = 0;
+            }
+            STRING_delete(sasToken);
+        }
+    }
+
+    return result;
+}
+
+static void renewSasTokenIfDue(IOTHUB_MESSAGING_HANDLE messagingHandle)
+{
+    time_t currentTime = time(NULL);
+
+    if ((messagingHandle->sas_token_refresh_time != 0) && (currentTime >= messagingHandle->sas_token_refresh_time) && !messagingHandle->is_cbs_put_token_in_progress)
+    {
+        if (messagingHandle->cbs_handle == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_022: [ The first time the renewal is due, IoTHubMessaging_LL_DoWork shall create and open a CBS instance on the existing session with cbs_create and cbs_open_async ] */
+            if ((messagingHandle->cbs_handle = cbs_create(messagingHandle->session)) == NULL)
+            {
+                LogError("Failed to create the CBS connection.");
+                messagingHandle->sas_token_refresh_time = currentTime + SAS_TOKEN_RETRY_SECS;
+            }
+            else if (cbs_open_async(messagingHandle->cbs_handle, on_cbs_open_complete, messagingHandle, on_cbs_error, messagingHandle) != 0)
+            {
+                LogError("Failed to open the connection with CBS.");
+                cbs_destroy(messagingHandle->cbs_handle);
+                messagingHandle->cbs_handle = NULL;
+                messagingHandle->sas_token_refresh_time = currentTime + SAS_TOKEN_RETRY_SECS;
+            }
+        }
+        else if (messagingHandle->is_cbs_open && (putSasTokenToCbs(messagingHandle, currentTime) != 0))
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_021: [ If the put-token operation fails, the renewal shall be retried 30 seconds later ] */
+            messagingHandle->sas_token_refresh_time = currentTime + SAS_TOKEN_RETRY_SECS;
+        }
+    }
+}
+
+static void readFeedbackRecord(JSON_Object* feedback_object, IOTHUB_SERVICE_FEEDBACK_RECORD* feedbackRecord)
+{
+    feedbackRecord->deviceId = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_DEVICE_ID);
+    feedbackRecord->generationId = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_DEVICE_GENERATION_ID);
+    feedbackRecord->description = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_DESCRIPTION);
+    feedbackRecord->enqueuedTimeUtc = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_ENQUED_TIME_UTC);
+    feedbackRecord->originalMessageId = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_ORIGINAL_MESSAGE_ID);
+    feedbackRecord->correlationId = "";
+
+    if (feedbackRecord->description == NULL)
+    {
+        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
+    }
+    else
+    {
+        size_t j;
+        for (j = 0; feedbackRecord->description[j]; j++)
+        {
+            feedbackRecord->description[j] = (char)tolower(feedbackRecord->description[j]);
+        }
+
+        if (strcmp(feedbackRecord->description, "success") == 0)
+        {
+            feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_SUCCESS;
+        }
+        else if (strcmp(feedbackRecord->description, "expired") == 0)
+        {
+            feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_EXPIRED;
+        }
+        else if (strcmp(feedbackRecord->description, "deliverycountexceeded") == 0)
+        {
+            feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_DELIVER_COUNT_EXCEEDED;
+        }
+        else if (strcmp(feedbackRecord->description, "rejected") == 0)
+        {
+            feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_REJECTED;
+        }
+        else
+        {
+            feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
+        }
+    }
+}
+
+static AMQP_VALUE visitFeedbackRecords(IOTHUB_MESSAGING* messagingData, JSON_Array* feedback_array)
+{
+    AMQP_VALUE result;
+    size_t array_count = json_array_get_count(feedback_array);
+    size_t i;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_014: [ If any element of the feedback array is not an object, IoTHubMessaging_LL_FeedbackMessageReceived shall reject the message without calling the feedback record callback ] */
+    for (i = 0; i < array_count; i++)
+    {
+        if (json_array_get_object(feedback_array, i) == NULL)
         {
-            (messagingData->callback_data->sendCompleteCallback)(messagingData->callback_data->sendUserContext, send_result);
+            break;
         }
     }
+
+    if (i < array_count)
+    {
+        LogError("Failed to read feedback records");
+        result = messaging_delivery_rejected("Rejected due to failure reading AMQP message", "Failed to read feedback records");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_013: [ If a feedback record callback is set, IoTHubMessaging_LL_FeedbackMessageReceived shall call it once per record with a record pointing into the parsed message, without building an IOTHUB_SERVICE_FEEDBACK_BATCH ] */
+        for (i = 0; i < array_count; i++)
+        {
+            IOTHUB_SERVICE_FEEDBACK_RECORD feedbackRecord;
+
+            readFeedbackRecord(json_array_get_object(feedback_array, i), &feedbackRecord);
+            (messagingData->callback_data->feedbackRecordCallback)(messagingData->callback_data->feedbackRecordUserContext, &feedbackRecord);
+        }
+        result = messaging_delivery_accepted();
+    }
+
+    return result;
 }
 
 static AMQP_VALUE IoTHubMessaging_LL_FeedbackMessageReceived(const void* context, MESSAGE_HANDLE message)
@@ -684,6 +982,10 @@ static AMQP_VALUE IoTHubMessaging_LL_FeedbackMessageReceived(const void* context
             LogError("json_array_get_count failed");
             result = messaging_delivery_rejected("Rejected due to failure reading AMQP message", "json_array_get_count failed");
         }
+        else if (messagingData->callback_data->feedbackRecordCallback != NULL)
+        {
+            result = visitFeedbackRecords(messagingData, feedback_array);
+        }
         else
         {
             IOTHUB_SERVICE_FEEDBACK_BATCH* feedbackBatch;
@@ -731,46 +1033,7 @@ static AMQP_VALUE IoTHubMessaging_LL_FeedbackMessageReceived(const void* context
                             }
                             else
                             {
-                                feedbackRecord->deviceId = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_DEVICE_ID);
-                                feedbackRecord->generationId = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_DEVICE_GENERATION_ID);
-                                feedbackRecord->description = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_DESCRIPTION);
-                                feedbackRecord->enqueuedTimeUtc = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_ENQUED_TIME_UTC);
-                                feedbackRecord->originalMessageId = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_ORIGINAL_MESSAGE_ID);
-                                feedbackRecord->correlationId = "";
-
-                                if (feedbackRecord->description == NULL)
-                                {
-                                    feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
-                                }
-                                else
-                                {
-                                    size_t j;
-                                    for (j = 0; feedbackRecord->description[j]; j++)
-                                    {
-                                        feedbackRecord->description[j] = (char)tolower(feedbackRecord->description[j]);
-                                    }
-
-                                    if (strcmp(feedbackRecord->description, "success") == 0)
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_SUCCESS;
-                                    }
-                                    else if (strcmp(feedbackRecord->description, "expired") == 0)
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_EXPIRED;
-                                    }
-                                    else if (strcmp(feedbackRecord->description, "deliverycountexceeded") == 0)
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_DELIVER_COUNT_EXCEEDED;
-                                    }
-                                    else if (strcmp(feedbackRecord->description, "rejected") == 0)
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_REJECTED;
-                                    }
-                                    else
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
-                                    }
-                                }
+                                readFeedbackRecord(feedback_object, feedbackRecord);
                                 singlylinkedlist_add(feedbackBatch->feedbackRecordList, feedbackRecord);
                             }
                         }
@@ -929,14 +1192,30 @@ IOTHUB_MESSAGING_HANDLE IoTHubMessaging_LL_Create(IOTHUB_SERVICE_CLIENT_AUTH_HAN
             {
                 /*Codes_SRS_IOTHUBMESSAGING_12_076: [ If create successfull IoTHubMessaging_LL_Create shall save the callback data return the valid messaging handle ] */
                 callback_data->openCompleteCompleteCallback = NULL;
-                callback_data->sendCompleteCallback = NULL;
                 callback_data->feedbackMessageCallback = NULL;
+                callback_data->feedbackRecordCallback = NULL;
                 callback_data->openUserContext = NULL;
-                callback_data->sendUserContext = NULL;
                 callback_data->feedbackUserContext = NULL;
+                callback_data->feedbackRecordUserContext = NULL;
 
                 result->callback_data = callback_data;
                 result->isOpened = false;
+
+                /*Codes_SRS_IOTHUBMESSAGING_41_001: [ IoTHubMessaging_LL_Create shall start with no pending sends and an unlimited outstanding sends window ] */
+                result->pending_sends = NULL;
+                result->pending_send_count = 0;
+                result->max_outstanding_sends = 0;
+
+                /*Codes_SRS_IOTHUBMESSAGING_41_011: [ IoTHubMessaging_LL_Create shall start with no feedback record callback and with feedback settled by the client ] */
+                result->feedback_presettled = false;
+
+                result->cbs_handle = NULL;
+                result->is_cbs_open = false;
+                result->is_cbs_put_token_in_progress = false;
+                result->sas_token_refresh_time = 0;
+                result->sas_signing_hostname = NULL;
+                result->sas_signing_key = NULL;
+                result->sas_signing_key_name = NULL;
             }
         }
     }
@@ -951,6 +1230,16 @@ void IoTHubMessaging_LL_Destroy(IOTHUB_MESSAGING_HANDLE messagingHandle)
         /*Codes_SRS_IOTHUBMESSAGING_12_006: [ If the messagingHandle input parameter is not NULL IoTHubMessaging_LL_Destroy shall free all resources (memory) allocated by IoTHubMessaging_LL_Create ] */
         IOTHUB_MESSAGING* messHandle = (IOTHUB_MESSAGING*)messagingHandle;
 
+        /*Codes_SRS_IOTHUBMESSAGING_41_002: [ IoTHubMessaging_LL_Destroy shall free the context of every send that is still pending ] */
+        while (messHandle->pending_sends != NULL)
+        {
+            SEND_CALLBACK_DATA* sendCallbackData = messHandle->pending_sends;
+            removePendingSend(sendCallbackData);
+            free(sendCallbackData);
+        }
+
+        destroySasRenewal(messHandle);
+
         free(messHandle->callback_data);
         free(messHandle->hostname);
         free(messHandle->iothubName);
@@ -1302,6 +1591,15 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Open(IOTHUB_MESSAGING_HANDLE messagin
                         free((char*)messagingHandle->sasl_plain_config.passwd);
                         result = IOTHUB_MESSAGING_ERROR;
                     }
+                    /*Codes_SRS_IOTHUBMESSAGING_41_017: [ If feedback is presettled, IoTHubMessaging_LL_Open shall ask for settled deliveries on the receiver link by calling link_set_snd_settle_mode with sender_settle_mode_settled ] */
+                    else if (messagingHandle->feedback_presettled && (link_set_snd_settle_mode(messagingHandle->receiver_link, sender_settle_mode_settled) != 0))
+                    {
+                        /*Codes_SRS_IOTHUBMESSAGING_12_030: [ If any of the uAMQP call fails IoTHubMessaging_LL_Open shall return IOTHUB_MESSAGING_ERROR ] */
+                        LogError("Could not set the receiver link sender settle mode.");
+                        free((char*)messagingHandle->sasl_plain_config.authcid);
+                        free((char*)messagingHandle->sasl_plain_config.passwd);
+                        result = IOTHUB_MESSAGING_ERROR;
+                    }
                     /*Codes_SRS_IOTHUBMESSAGING_12_029: [ IoTHubMessaging_LL_Open shall create uAMQP message receiver by calling the messagereceiver_create with the created sender link and the local IoTHubMessaging_LL_ReceiverStateChanged callback ] */
                     else if ((messagingHandle->message_receiver = messagereceiver_create(messagingHandle->receiver_link, IoTHubMessaging_LL_ReceiverStateChanged, messagingHandle)) == NULL)
                     {
@@ -1357,11 +1655,21 @@ void IoTHubMessaging_LL_Close(IOTHUB_MESSAGING_HANDLE messagingHandle)
     else
     {
         messagesender_destroy(messagingHandle->message_sender);
+
+        /*Codes_SRS_IOTHUBMESSAGING_41_003: [ IoTHubMessaging_LL_Close shall complete every send still pending after the message sender is destroyed with IOTHUB_MESSAGING_ERROR ] */
+        while (messagingHandle->pending_sends != NULL)
+        {
+            IoTHubMessaging_LL_SendMessageComplete(messagingHandle->pending_sends, IOTHUB_MESSAGING_ERROR);
+        }
+
         messagereceiver_destroy(messagingHandle->message_receiver);
 
         link_destroy(messagingHandle->sender_link);
         link_destroy(messagingHandle->receiver_link);
 
+        /*Codes_SRS_IOTHUBMESSAGING_41_023: [ IoTHubMessaging_LL_Close shall destroy the CBS instance and the cached signing strings before destroying the session, and stop the SAS token renewal ] */
+        destroySasRenewal(messagingHandle);
+
         session_destroy(messagingHandle->session);
         connection_destroy(messagingHandle->connection);
         xio_destroy(messagingHandle->sasl_io);
@@ -1405,6 +1713,44 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_SetFeedbackMessageCallback(IOTHUB_MES
     return result;
 }
 
+IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_SetFeedbackRecordCallback(IOTHUB_MESSAGING_HANDLE messagingHandle, IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK feedbackRecordReceivedCallback, void* userContextCallback)
+{
+    IOTHUB_MESSAGING_RESULT result;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_012: [ If messagingHandle is NULL, IoTHubMessaging_LL_SetFeedbackRecordCallback shall return IOTHUB_MESSAGING_INVALID_ARG, otherwise it shall save feedbackRecordReceivedCallback and userContextCallback and return IOTHUB_MESSAGING_OK ] */
+    if (messagingHandle == NULL)
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_MESSAGING_INVALID_ARG;
+    }
+    else
+    {
+        messagingHandle->callback_data->feedbackRecordCallback = feedbackRecordReceivedCallback;
+        messagingHandle->callback_data->feedbackRecordUserContext = userContextCallback;
+        result = IOTHUB_MESSAGING_OK;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_SetFeedbackPresettled(IOTHUB_MESSAGING_HANDLE messagingHandle, bool presettled)
+{
+    IOTHUB_MESSAGING_RESULT result;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_015: [ If messagingHandle is NULL, IoTHubMessaging_LL_SetFeedbackPresettled shall return IOTHUB_MESSAGING_INVALID_ARG ] */
+    if (messagingHandle == NULL)
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_MESSAGING_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_016: [ IoTHubMessaging_LL_SetFeedbackPresettled shall save presettled to be applied by the next IoTHubMessaging_LL_Open and return IOTHUB_MESSAGING_OK ] */
+        messagingHandle->feedback_presettled = presettled;
+        result = IOTHUB_MESSAGING_OK;
+    }
+    return result;
+}
+
 IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Send(IOTHUB_MESSAGING_HANDLE messagingHandle, const char* deviceId, IOTHUB_MESSAGE_HANDLE message, IOTHUB_SEND_COMPLETE_CALLBACK sendCompleteCallback, void* userContextCallback)
 {
     IOTHUB_MESSAGING_RESULT result;
@@ -1435,6 +1781,12 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Send(IOTHUB_MESSAGING_HANDLE messagin
         LogError("Messaging is not opened - call IoTHubMessaging_LL_Open to open");
         result = IOTHUB_MESSAGING_ERROR;
     }
+    /*Codes_SRS_IOTHUBMESSAGING_41_004: [ If the outstanding sends window is not 0 and as many sends as the window are pending, IoTHubMessaging_LL_Send shall return IOTHUB_MESSAGING_ERROR without sending ] */
+    else if ((messagingHandle->max_outstanding_sends != 0) && (messagingHandle->pending_send_count >= messagingHandle->max_outstanding_sends))
+    {
+        LogError("Outstanding sends window is full (%zu sends pending)", messagingHandle->pending_send_count);
+        result = IOTHUB_MESSAGING_ERROR;
+    }
     /*Codes_SRS_IOTHUBMESSAGING_12_038: [ IoTHubMessaging_LL_SendMessage shall set the uAMQP message properties to the given message properties by calling message_set_properties ] */
     else if ((deviceDestinationString = createDeviceDestinationString(deviceId)) == NULL)
     {
@@ -1503,21 +1855,36 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Send(IOTHUB_MESSAGING_HANDLE messagin
                 }
                 else
                 {
-                    messagingHandle->callback_data->sendCompleteCallback = sendCompleteCallback;
-                    messagingHandle->callback_data->sendUserContext = userContextCallback;
+                    SEND_CALLBACK_DATA* sendCallbackData;
 
-                    /*Codes_SRS_IOTHUBMESSAGING_12_039: [ IoTHubMessaging_LL_SendMessage shall call uAMQP messagesender_send with the created message with IoTHubMessaging_LL_SendMessageComplete callback by which IoTHubMessaging is notified of completition of send ] */
-                    if (messagesender_send(messagingHandle->message_sender, amqpMessage, (ON_MESSAGE_SEND_COMPLETE)IoTHubMessaging_LL_SendMessageComplete, messagingHandle) != 0)
+                    /*Codes_SRS_IOTHUBMESSAGING_41_005: [ IoTHubMessaging_LL_Send shall allocate a send context holding sendCompleteCallback and userContextCallback and add it to the pending sends ] */
+                    if ((sendCallbackData = (SEND_CALLBACK_DATA*)malloc(sizeof(SEND_CALLBACK_DATA))) == NULL)
                     {
-                        /*Codes_SRS_IOTHUBMESSAGING_12_040: [ If any of the uAMQP call fails IoTHubMessaging_LL_SendMessage shall return IOTHUB_MESSAGING_ERROR ] */
-                        LogError("Could not set outgoing window.");
-                        message_destroy(amqpMessage);
+                        /*Codes_SRS_IOTHUBMESSAGING_41_006: [ If allocating the send context fails, IoTHubMessaging_LL_Send shall return IOTHUB_MESSAGING_ERROR ] */
+                        LogError("Malloc failed for the send context");
                         result = IOTHUB_MESSAGING_ERROR;
                     }
                     else
                     {
-                        /*Codes_SRS_IOTHUBMESSAGING_12_041: [ If all uAMQP call return 0 then IoTHubMessaging_LL_SendMessage shall return IOTHUB_MESSAGING_OK  ] */
-                        result = IOTHUB_MESSAGING_OK;
+                        sendCallbackData->sendCompleteCallback = sendCompleteCallback;
+                        sendCallbackData->sendUserContext = userContextCallback;
+                        addPendingSend(messagingHandle, sendCallbackData);
+
+                        /*Codes_SRS_IOTHUBMESSAGING_12_039: [ IoTHubMessaging_LL_SendMessage shall call uAMQP messagesender_send with the created message with IoTHubMessaging_LL_SendMessageComplete callback by which IoTHubMessaging is notified of completition of send ] */
+                        if (messagesender_send(messagingHandle->message_sender, amqpMessage, (ON_MESSAGE_SEND_COMPLETE)IoTHubMessaging_LL_SendMessageComplete, sendCallbackData) != 0)
+                        {
+                            /*Codes_SRS_IOTHUBMESSAGING_12_040: [ If any of the uAMQP call fails IoTHubMessaging_LL_SendMessage shall return IOTHUB_MESSAGING_ERROR ] */
+                            /*Codes_SRS_IOTHUBMESSAGING_41_007: [ If messagesender_send fails, IoTHubMessaging_LL_Send shall remove the send context from the pending sends and free it ] */
+                            LogError("Could not set outgoing window.");
+                            removePendingSend(sendCallbackData);
+                            free(sendCallbackData);
+                            result = IOTHUB_MESSAGING_ERROR;
+                        }
+                        else
+                        {
+                            /*Codes_SRS_IOTHUBMESSAGING_12_041: [ If all uAMQP call return 0 then IoTHubMessaging_LL_SendMessage shall return IOTHUB_MESSAGING_OK  ] */
+                            result = IOTHUB_MESSAGING_OK;
+                        }
                     }
                 }
                 message_destroy(amqpMessage);
@@ -1529,6 +1896,44 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Send(IOTHUB_MESSAGING_HANDLE messagin
     return result;
 }
 
+IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_SetMaxOutstandingSends(IOTHUB_MESSAGING_HANDLE messagingHandle, size_t maxOutstandingSends)
+{
+    IOTHUB_MESSAGING_RESULT result;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_009: [ If messagingHandle is NULL, IoTHubMessaging_LL_SetMaxOutstandingSends shall return IOTHUB_MESSAGING_INVALID_ARG ] */
+    if (messagingHandle == NULL)
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_MESSAGING_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_010: [ IoTHubMessaging_LL_SetMaxOutstandingSends shall save maxOutstandingSends as the outstanding sends window and return IOTHUB_MESSAGING_OK ] */
+        messagingHandle->max_outstanding_sends = maxOutstandingSends;
+        result = IOTHUB_MESSAGING_OK;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_GetPendingSendCount(IOTHUB_MESSAGING_HANDLE messagingHandle, size_t* pendingSendCount)
+{
+    IOTHUB_MESSAGING_RESULT result;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_024: [ If messagingHandle or pendingSendCount is NULL, IoTHubMessaging_LL_GetPendingSendCount shall return IOTHUB_MESSAGING_INVALID_ARG ] */
+    if ((messagingHandle == NULL) || (pendingSendCount == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_MESSAGING_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_025: [ IoTHubMessaging_LL_GetPendingSendCount shall set pendingSendCount to the number of sends waiting for their completion callback and return IOTHUB_MESSAGING_OK ] */
+        *pendingSendCount = messagingHandle->pending_send_count;
+        result = IOTHUB_MESSAGING_OK;
+    }
+    return result;
+}
+
 void IoTHubMessaging_LL_DoWork(IOTHUB_MESSAGING_HANDLE messagingHandle)
 {
     /*Codes_SRS_IOTHUBMESSAGING_12_045: [ IoTHubMessaging_LL_DoWork shall verify if uAMQP transport has been initialized and if it is not then return immediately ] */
@@ -1537,6 +1942,10 @@ void IoTHubMessaging_LL_DoWork(IOTHUB_MESSAGING_HANDLE messagingHandle)
         /*Codes_SRS_IOTHUBMESSAGING_12_046: [ IoTHubMessaging_LL_DoWork shall call uAMQP connection_dowork ] */
         /*Codes_SRS_IOTHUBMESSAGING_12_047: [ IoTHubMessaging_LL_SendMessageComplete callback given to messagesender_send will be called with MESSAGE_SEND_RESULT ] */
         /*Codes_SRS_IOTHUBMESSAGING_12_048: [ If message has been received the IoTHubMessaging_LL_FeedbackMessageReceived callback given to messagesender_receive will be called with the received MESSAGE_HANDLE ] */
+        if (messagingHandle->isOpened)
+        {
+            renewSasTokenIfDue(messagingHandle);
+        }
         connection_dowork(messagingHandle->connection);
     }
 }
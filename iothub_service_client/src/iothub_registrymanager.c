@@ -3,18 +3,22 @@
 
 #include <stdlib.h>
 #include <ctype.h>
+#include <string.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/string_tokenizer.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/httpapiex.h"
-#include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/connection_string_parser.h"
 
 #include "parson.h"
 #include "iothub_registrymanager.h"
+#include "iothub_sc_http_pool.h"
 #include "iothub_sc_version.h"
 
 #define IOTHUB_REQUEST_MODE_VALUES    \
@@ -23,7 +27,11 @@
     IOTHUB_REQUEST_UPDATE,            \
     IOTHUB_REQUEST_DELETE,            \
     IOTHUB_REQUEST_GET_DEVICE_LIST,   \
-    IOTHUB_REQUEST_GET_STATISTICS     \
+    IOTHUB_REQUEST_GET_STATISTICS,    \
+    IOTHUB_REQUEST_BULK,              \
+    IOTHUB_REQUEST_CREATE_JOB,        \
+    IOTHUB_REQUEST_GET_JOB,           \
+    IOTHUB_REQUEST_QUERY_DEVICES      \
 
 DEFINE_ENUM(IOTHUB_REQUEST_MODE, IOTHUB_REQUEST_MODE_VALUES);
 
@@ -39,6 +47,8 @@ DEFINE_ENUM(IOTHUB_REQUEST_MODE, IOTHUB_REQUEST_MODE_VALUES);
 #define  HTTP_HEADER_VAL_CONTENT_TYPE  "application/json; charset=utf-8"
 #define  HTTP_HEADER_KEY_IFMATCH  "If-Match"
 #define  HTTP_HEADER_VAL_IFMATCH  "*"
+#define  HTTP_HEADER_KEY_MAX_ITEM_COUNT  "x-ms-max-item-count"
+#define  HTTP_HEADER_KEY_CONTINUATION  "x-ms-continuation"
 
 static size_t IOTHUB_DEVICES_MAX_REQUEST = 1000;
 
@@ -49,6 +59,14 @@ static const char* DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY = "authentication.symmet
 static const char* DEVICE_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT = "authentication.x509Thumbprint.primaryThumbprint";
 static const char* DEVICE_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT = "authentication.x509Thumbprint.secondaryThumbprint";
 
+static const char* DEVICE_JSON_KEY_AUTHENTICATION = "authentication";
+static const char* DEVICE_JSON_KEY_SYMMETRIC_KEY = "symmetricKey";
+static const char* DEVICE_JSON_KEY_X509_THUMBPRINT = "x509Thumbprint";
+static const char* DEVICE_JSON_KEY_PRIMARY_KEY = "primaryKey";
+static const char* DEVICE_JSON_KEY_SECONDARY_KEY = "secondaryKey";
+static const char* DEVICE_JSON_KEY_PRIMARY_THUMBPRINT = "primaryThumbprint";
+static const char* DEVICE_JSON_KEY_SECONDARY_THUMBPRINT = "secondaryThumbprint";
+
 static const char* DEVICE_JSON_KEY_DEVICE_GENERATION_ID = "generationId";
 static const char* DEVICE_JSON_KEY_DEVICE_ETAG = "etag";
 
@@ -71,6 +89,29 @@ static const char* DEVICE_JSON_KEY_TOTAL_DEVICECOUNT = "totalDeviceCount";
 static const char* DEVICE_JSON_KEY_ENABLED_DEVICECCOUNT = "enabledDeviceCount";
 static const char* DEVICE_JSON_KEY_DISABLED_DEVICECOUNT = "disabledDeviceCount";
 
+static const char* BULK_JSON_KEY_DEVICE_ID = "id";
+static const char* BULK_JSON_KEY_IMPORT_MODE = "importMode";
+static const char* BULK_JSON_KEY_ERRORS = "errors";
+static const char* BULK_JSON_KEY_ERROR_CODE = "errorCode";
+static const char* BULK_JSON_VALUE_IMPORT_MODE_CREATE = "create";
+static const char* BULK_JSON_VALUE_IMPORT_MODE_UPDATE = "update";
+static const char* BULK_JSON_VALUE_IMPORT_MODE_DELETE = "delete";
+static const char* BULK_JSON_VALUE_ERROR_DEVICE_EXISTS = "DeviceAlreadyExists";
+static const char* BULK_JSON_VALUE_ERROR_DEVICE_NOT_FOUND = "DeviceNotFound";
+
+static const char* JOB_JSON_KEY_JOB_ID = "jobId";
+static const char* JOB_JSON_KEY_TYPE = "type";
+static const char* JOB_JSON_KEY_STATUS = "status";
+static const char* JOB_JSON_KEY_PROGRESS = "progress";
+static const char* JOB_JSON_KEY_FAILURE_REASON = "failureReason";
+static const char* JOB_JSON_KEY_INPUT_BLOB_CONTAINER_URI = "inputBlobContainerUri";
+static const char* JOB_JSON_KEY_OUTPUT_BLOB_CONTAINER_URI = "outputBlobContainerUri";
+static const char* JOB_JSON_KEY_EXCLUDE_KEYS_IN_EXPORT = "excludeKeysInExport";
+static const char* JOB_JSON_VALUE_TYPE_IMPORT = "import";
+static const char* JOB_JSON_VALUE_TYPE_EXPORT = "export";
+
+static const char* QUERY_JSON_ALL_DEVICES = "{\"query\":\"SELECT * FROM devices\"}";
+
 static const char* DEVICE_JSON_DEFAULT_VALUE_ENABLED = "Enabled";
 static const char* DEVICE_JSON_DEFAULT_VALUE_DISABLED = "Disabled";
 static const char* DEVICE_JSON_DEFAULT_VALUE_CONNECTED = "Connected";
@@ -84,6 +125,10 @@ static const char* URL_API_VERSION = "api-version=2016-11-14";
 static const char* RELATIVE_PATH_FMT_CRUD = "/devices/%s?%s";
 static const char* RELATIVE_PATH_FMT_LIST = "/devices/?top=%s&%s";
 static const char* RELATIVE_PATH_FMT_STAT = "/statistics/devices?%s";
+static const char* RELATIVE_PATH_FMT_BULK = "/devices?%s";
+static const char* RELATIVE_PATH_FMT_CREATE_JOB = "/jobs/create?%s";
+static const char* RELATIVE_PATH_FMT_GET_JOB = "/jobs/%s?%s";
+static const char* RELATIVE_PATH_FMT_QUERY = "/devices/query?%s";
 
 static int strHasNoWhitespace(const char* s)
 {
@@ -204,50 +249,287 @@ static BUFFER_HANDLE constructDeviceJson(const IOTHUB_DEVICE* deviceInfo)
     return result;
 }
 
-static IOTHUB_REGISTRYMANAGER_RESULT parseDeviceJson(BUFFER_HANDLE jsonBuffer, IOTHUB_DEVICE* deviceInfo)
+static void initializeDeviceInfo(IOTHUB_DEVICE* deviceInfo)
+{
+    deviceInfo->deviceId = NULL;
+    deviceInfo->primaryKey = NULL;
+    deviceInfo->secondaryKey = NULL;
+    deviceInfo->generationId = NULL;
+    deviceInfo->eTag = NULL;
+    deviceInfo->connectionState = IOTHUB_DEVICE_CONNECTION_STATE_DISCONNECTED;
+    deviceInfo->connectionStateUpdatedTime = NULL;
+    deviceInfo->status = IOTHUB_DEVICE_STATUS_DISABLED;
+    deviceInfo->statusReason = NULL;
+    deviceInfo->statusUpdatedTime = NULL;
+    deviceInfo->lastActivityTime = NULL;
+    deviceInfo->cloudToDeviceMessageCount = 0;
+    deviceInfo->isManaged = false;
+    deviceInfo->configuration = NULL;
+    deviceInfo->deviceProperties = NULL;
+    deviceInfo->serviceProperties = NULL;
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT parseDeviceJsonObject(JSON_Object* root_object, IOTHUB_DEVICE* deviceInfo)
 {
     IOTHUB_REGISTRYMANAGER_RESULT result;
 
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_024: [ If the deviceInfo out parameter is not NULL IoTHubRegistryManager_CreateDevice shall save the received deviceInfo to the out parameter and return IOTHUB_REGISTRYMANAGER_OK ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_033: [ IoTHubRegistryManager_GetDevice shall verify the received HTTP status code and if it is less or equal than 300 then try to parse the response JSON to deviceInfo for the following properties: deviceId, primaryKey, secondaryKey, generationId, eTag, connectionState, connectionstateUpdatedTime, status, statusReason, statusUpdatedTime, lastActivityTime, cloudToDeviceMessageCount ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_034: [ If any of the property field above missing from the JSON the property value will not be populated ] */
-    if (jsonBuffer == NULL)
+    const char* deviceId = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_NAME);
+    /*the "authentication" object and its children are resolved once, the keys are then read from them*/
+    JSON_Object* authentication = json_object_get_object(root_object, DEVICE_JSON_KEY_AUTHENTICATION);
+    JSON_Object* symmetricKey = json_object_get_object(authentication, DEVICE_JSON_KEY_SYMMETRIC_KEY);
+    JSON_Object* x509Thumbprint = json_object_get_object(authentication, DEVICE_JSON_KEY_X509_THUMBPRINT);
+    const char* primaryKey = (char*)json_object_get_string(symmetricKey, DEVICE_JSON_KEY_PRIMARY_KEY);
+    const char* secondaryKey = (char*)json_object_get_string(symmetricKey, DEVICE_JSON_KEY_SECONDARY_KEY);
+    const char* generationId = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_GENERATION_ID);
+    const char* eTag = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_ETAG);
+    const char* connectionState = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_CONNECTIONSTATE);
+    const char* connectionStateUpdatedTime = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_CONNECTIONSTATEUPDATEDTIME);
+    const char* status = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_STATUS);
+    const char* statusReason = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_STATUSREASON);
+    const char* statusUpdatedTime = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_STATUSUPDATEDTIME);
+    const char* lastActivityTime = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_LASTACTIVITYTIME);
+    const char* cloudToDeviceMessageCount = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_CLOUDTODEVICEMESSAGECOUNT);
+    const char* isManaged = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_ISMANAGED);
+    const char* configuration = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_CONFIGURATION);
+    const char* deviceProperties = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_DEVICEROPERTIES);
+    const char* serviceProperties = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_SERVICEPROPERTIES);
+
+    if (primaryKey == NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_007: [ IoTHubRegistryManager_GetDevice shall, if no json was found for authorization.symetricKey.primaryKey, parse for authorization.x509Thumbprint.primaryThumbprint ] */
+        primaryKey = (char*)json_object_get_string(x509Thumbprint, DEVICE_JSON_KEY_PRIMARY_THUMBPRINT);
+        if (primaryKey != NULL)
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_009: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.x509Thumbprint.primaryThumbprint, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT" ] */
+            deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT;
+        }
+    } 
+    else
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_008: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.symetricKey.primaryKey, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_SPK" ] */
+        deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_SPK;
+    }
+
+    if (secondaryKey == NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_011: [ IoTHubRegistryManager_GetDevice shall, if no json was found for authorization.symetricKey.secondaryKey, parse for authorization.x509Thumbprint.secondaryThumbprint ] */
+        secondaryKey = (char*)json_object_get_string(x509Thumbprint, DEVICE_JSON_KEY_SECONDARY_THUMBPRINT);
+        if (secondaryKey != NULL)
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_012: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.x509Thumbprint.secondaryThumbprint, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT" ] */
+            deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT;
+        }
+    }
+    else
+    {
+        //
+        // Yes, this should already be set. If it isn't then code later on will fail.  But I simply
+        // can't leave dangling logic.
+        //
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_010: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.symetricKey.secondaryKey, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_SPK" ] */
+        deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_SPK;
+    }
+
+    if ((deviceId != NULL) && (mallocAndStrcpy_s((char**)&(deviceInfo->deviceId), deviceId) != 0))
     {
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-        LogError("jsonBuffer cannot be NULL");
+        LogError("mallocAndStrcpy_s failed for deviceId");
         result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
     }
-    else if (deviceInfo == NULL)
+    else if ((primaryKey != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->primaryKey, primaryKey) != 0))
     {
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-        LogError("deviceInfo cannot be NULL");
+        LogError("mallocAndStrcpy_s failed for primaryKey");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((secondaryKey != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->secondaryKey, secondaryKey) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for secondaryKey");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((generationId != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->generationId, generationId) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for generationId");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((eTag != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->eTag, eTag) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for eTag");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((connectionStateUpdatedTime != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->connectionStateUpdatedTime, connectionStateUpdatedTime) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for connectionStateUpdatedTime");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((statusReason != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->statusReason, statusReason) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for statusReason");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((statusUpdatedTime != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->statusUpdatedTime, statusUpdatedTime) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for statusUpdatedTime");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((lastActivityTime != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->lastActivityTime, lastActivityTime) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for lastActivityTime");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((configuration != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->configuration, configuration) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for configuration");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((deviceProperties != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->deviceProperties, deviceProperties) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for deviceProperties");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((serviceProperties != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->serviceProperties, serviceProperties) != 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("mallocAndStrcpy_s failed for serviceProperties");
         result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
     }
     else
     {
-        const char* bufferStr = NULL;
-        JSON_Value* root_value = NULL;
-        JSON_Object* root_object = NULL;
-        JSON_Status jsonStatus;
+        if ((connectionState != NULL) && (strcmp(connectionState, DEVICE_JSON_DEFAULT_VALUE_CONNECTED) == 0))
+        {
+            deviceInfo->connectionState = IOTHUB_DEVICE_CONNECTION_STATE_CONNECTED;
+        }
+        if ((status != NULL) && (strcmp(status, DEVICE_JSON_DEFAULT_VALUE_ENABLED) == 0))
+        {
+            deviceInfo->status = IOTHUB_DEVICE_STATUS_ENABLED;
+        }
+        if (cloudToDeviceMessageCount != NULL)
+        {
+            deviceInfo->cloudToDeviceMessageCount = atoi(cloudToDeviceMessageCount);
+        }
+        if ((isManaged != NULL) && (strcmp(isManaged, DEVICE_JSON_DEFAULT_VALUE_TRUE) == 0))
+        {
+            deviceInfo->isManaged = true;
+        }
+        result = IOTHUB_REGISTRYMANAGER_OK;
+    }
+    return result;
+}
 
+static void freeDeviceInfoMembers(IOTHUB_DEVICE* deviceInfo)
+{
+    if (deviceInfo->deviceId != NULL)
+    {
+        free((void*)deviceInfo->deviceId);
         deviceInfo->deviceId = NULL;
+    }
+    if (deviceInfo->primaryKey != NULL)
+    {
+        free((void*)deviceInfo->primaryKey);
         deviceInfo->primaryKey = NULL;
+    }
+    if (deviceInfo->secondaryKey != NULL)
+    {
+        free((void*)deviceInfo->secondaryKey);
         deviceInfo->secondaryKey = NULL;
+    }
+    if (deviceInfo->generationId != NULL)
+    {
+        free((void*)deviceInfo->generationId);
         deviceInfo->generationId = NULL;
+    }
+    if (deviceInfo->eTag != NULL)
+    {
+        free((void*)deviceInfo->eTag);
         deviceInfo->eTag = NULL;
-        deviceInfo->connectionState = IOTHUB_DEVICE_CONNECTION_STATE_DISCONNECTED;
+    }
+    if (deviceInfo->connectionStateUpdatedTime != NULL)
+    {
+        free((void*)deviceInfo->connectionStateUpdatedTime);
         deviceInfo->connectionStateUpdatedTime = NULL;
-        deviceInfo->status = IOTHUB_DEVICE_STATUS_DISABLED;
+    }
+    if (deviceInfo->statusReason != NULL)
+    {
+        free((void*)deviceInfo->statusReason);
         deviceInfo->statusReason = NULL;
+    }
+    if (deviceInfo->statusUpdatedTime != NULL)
+    {
+        free((void*)deviceInfo->statusUpdatedTime);
         deviceInfo->statusUpdatedTime = NULL;
+    }
+    if (deviceInfo->lastActivityTime != NULL)
+    {
+        free((void*)deviceInfo->lastActivityTime);
         deviceInfo->lastActivityTime = NULL;
-        deviceInfo->cloudToDeviceMessageCount = 0;
-        deviceInfo->isManaged = false;
+    }
+    if (deviceInfo->configuration != NULL)
+    {
+        free((void*)deviceInfo->configuration);
         deviceInfo->configuration = NULL;
+    }
+    if (deviceInfo->deviceProperties != NULL)
+    {
+        free((void*)deviceInfo->deviceProperties);
         deviceInfo->deviceProperties = NULL;
+    }
+    if (deviceInfo->serviceProperties != NULL)
+    {
+        free((void*)deviceInfo->serviceProperties);
         deviceInfo->serviceProperties = NULL;
+    }
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT parseDeviceJson(BUFFER_HANDLE jsonBuffer, IOTHUB_DEVICE* deviceInfo)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_024: [ If the deviceInfo out parameter is not NULL IoTHubRegistryManager_CreateDevice shall save the received deviceInfo to the out parameter and return IOTHUB_REGISTRYMANAGER_OK ] */
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_033: [ IoTHubRegistryManager_GetDevice shall verify the received HTTP status code and if it is less or equal than 300 then try to parse the response JSON to deviceInfo for the following properties: deviceId, primaryKey, secondaryKey, generationId, eTag, connectionState, connectionstateUpdatedTime, status, statusReason, statusUpdatedTime, lastActivityTime, cloudToDeviceMessageCount ] */
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_034: [ If any of the property field above missing from the JSON the property value will not be populated ] */
+    if (jsonBuffer == NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("jsonBuffer cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if (deviceInfo == NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("deviceInfo cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else
+    {
+        const char* bufferStr = NULL;
+        JSON_Value* root_value = NULL;
+        JSON_Object* root_object = NULL;
+        JSON_Status jsonStatus;
+
+        initializeDeviceInfo(deviceInfo);
 
         if ((bufferStr = (const char*)BUFFER_u_char(jsonBuffer)) == NULL)
         {
@@ -272,163 +554,7 @@ static IOTHUB_REGISTRYMANAGER_RESULT parseDeviceJson(BUFFER_HANDLE jsonBuffer, I
         }
         else
         {
-            const char* deviceId = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_NAME);
-            const char* primaryKey = (char*)json_object_dotget_string(root_object, DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY);
-            const char* secondaryKey = (char*)json_object_dotget_string(root_object, DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY);
-            const char* generationId = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_GENERATION_ID);
-            const char* eTag = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_ETAG);
-            const char* connectionState = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_CONNECTIONSTATE);
-            const char* connectionStateUpdatedTime = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_CONNECTIONSTATEUPDATEDTIME);
-            const char* status = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_STATUS);
-            const char* statusReason = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_STATUSREASON);
-            const char* statusUpdatedTime = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_STATUSUPDATEDTIME);
-            const char* lastActivityTime = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_LASTACTIVITYTIME);
-            const char* cloudToDeviceMessageCount = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_CLOUDTODEVICEMESSAGECOUNT);
-            const char* isManaged = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_ISMANAGED);
-            const char* configuration = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_CONFIGURATION);
-            const char* deviceProperties = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_DEVICEROPERTIES);
-            const char* serviceProperties = (char*)json_object_get_string(root_object, DEVICE_JSON_KEY_DEVICE_SERVICEPROPERTIES);
-
-            if (primaryKey == NULL)
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_007: [ IoTHubRegistryManager_GetDevice shall, if no json was found for authorization.symetricKey.primaryKey, parse for authorization.x509Thumbprint.primaryThumbprint ] */
-                primaryKey = (char*)json_object_dotget_string(root_object, DEVICE_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT);
-                if (primaryKey != NULL)
-                {
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_009: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.x509Thumbprint.primaryThumbprint, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT" ] */
-                    deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT;
-                }
-            } 
-            else
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_008: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.symetricKey.primaryKey, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_SPK" ] */
-                deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_SPK;
-            }
-
-            if (secondaryKey == NULL)
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_011: [ IoTHubRegistryManager_GetDevice shall, if no json was found for authorization.symetricKey.secondaryKey, parse for authorization.x509Thumbprint.secondaryThumbprint ] */
-                secondaryKey = (char*)json_object_dotget_string(root_object, DEVICE_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT);
-                if (secondaryKey != NULL)
-                {
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_012: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.x509Thumbprint.secondaryThumbprint, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT" ] */
-                    deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT;
-                }
-            }
-            else
-            {
-                //
-                // Yes, this should already be set. If it isn't then code later on will fail.  But I simply
-                // can't leave dangling logic.
-                //
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_010: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.symetricKey.secondaryKey, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_SPK" ] */
-                deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_SPK;
-            }
-
-            if ((deviceId != NULL) && (mallocAndStrcpy_s((char**)&(deviceInfo->deviceId), deviceId) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for deviceId");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((primaryKey != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->primaryKey, primaryKey) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for primaryKey");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((secondaryKey != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->secondaryKey, secondaryKey) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for secondaryKey");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((generationId != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->generationId, generationId) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for generationId");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((eTag != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->eTag, eTag) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for eTag");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((connectionStateUpdatedTime != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->connectionStateUpdatedTime, connectionStateUpdatedTime) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for connectionStateUpdatedTime");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((statusReason != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->statusReason, statusReason) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for statusReason");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((statusUpdatedTime != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->statusUpdatedTime, statusUpdatedTime) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for statusUpdatedTime");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((lastActivityTime != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->lastActivityTime, lastActivityTime) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for lastActivityTime");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((configuration != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->configuration, configuration) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for configuration");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((deviceProperties != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->deviceProperties, deviceProperties) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for deviceProperties");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else if ((serviceProperties != NULL) && (mallocAndStrcpy_s((char**)&deviceInfo->serviceProperties, serviceProperties) != 0))
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_023: [ If the JSON parsing failed, IoTHubRegistryManager_CreateDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_035: [ If the JSON parsing failed, IoTHubRegistryManager_GetDevice shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
-                LogError("mallocAndStrcpy_s failed for serviceProperties");
-                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
-            }
-            else
-            {
-                if ((connectionState != NULL) && (strcmp(connectionState, DEVICE_JSON_DEFAULT_VALUE_CONNECTED) == 0))
-                {
-                    deviceInfo->connectionState = IOTHUB_DEVICE_CONNECTION_STATE_CONNECTED;
-                }
-                if ((status != NULL) && (strcmp(status, DEVICE_JSON_DEFAULT_VALUE_ENABLED) == 0))
-                {
-                    deviceInfo->status = IOTHUB_DEVICE_STATUS_ENABLED;
-                }
-                if (cloudToDeviceMessageCount != NULL)
-                {
-                    deviceInfo->cloudToDeviceMessageCount = atoi(cloudToDeviceMessageCount);
-                }
-                if ((isManaged != NULL) && (strcmp(isManaged, DEVICE_JSON_DEFAULT_VALUE_TRUE) == 0))
-                {
-                    deviceInfo->isManaged = true;
-                }
-                result = IOTHUB_REGISTRYMANAGER_OK;
-            }
+            result = parseDeviceJsonObject(root_object, deviceInfo);
         }
 
         if ((jsonStatus = json_object_clear(root_object)) != JSONSuccess)
@@ -443,66 +569,7 @@ static IOTHUB_REGISTRYMANAGER_RESULT parseDeviceJson(BUFFER_HANDLE jsonBuffer, I
 
         if (result != IOTHUB_REGISTRYMANAGER_OK)
         {
-            if (deviceInfo->deviceId != NULL)
-            {
-                free((void*)deviceInfo->deviceId);
-                deviceInfo->deviceId = NULL;
-            }
-            if (deviceInfo->primaryKey != NULL)
-            {
-                free((void*)deviceInfo->primaryKey);
-                deviceInfo->primaryKey = NULL;
-            }
-            if (deviceInfo->secondaryKey != NULL)
-            {
-                free((void*)deviceInfo->secondaryKey);
-                deviceInfo->secondaryKey = NULL;
-            }
-            if (deviceInfo->generationId != NULL)
-            {
-                free((void*)deviceInfo->generationId);
-                deviceInfo->generationId = NULL;
-            }
-            if (deviceInfo->eTag != NULL)
-            {
-                free((void*)deviceInfo->eTag);
-                deviceInfo->eTag = NULL;
-            }
-            if (deviceInfo->connectionStateUpdatedTime != NULL)
-            {
-                free((void*)deviceInfo->connectionStateUpdatedTime);
-                deviceInfo->connectionStateUpdatedTime = NULL;
-            }
-            if (deviceInfo->statusReason != NULL)
-            {
-                free((void*)deviceInfo->statusReason);
-                deviceInfo->statusReason = NULL;
-            }
-            if (deviceInfo->statusUpdatedTime != NULL)
-            {
-                free((void*)deviceInfo->statusUpdatedTime);
-                deviceInfo->statusUpdatedTime = NULL;
-            }
-            if (deviceInfo->lastActivityTime != NULL)
-            {
-                free((void*)deviceInfo->lastActivityTime);
-                deviceInfo->lastActivityTime = NULL;
-            }
-            if (deviceInfo->configuration != NULL)
-            {
-                free((void*)deviceInfo->configuration);
-                deviceInfo->configuration = NULL;
-            }
-            if (deviceInfo->deviceProperties != NULL)
-            {
-                free((void*)deviceInfo->deviceProperties);
-                deviceInfo->deviceProperties = NULL;
-            }
-            if (deviceInfo->serviceProperties != NULL)
-            {
-                free((void*)deviceInfo->serviceProperties);
-                deviceInfo->serviceProperties = NULL;
-            }
+            freeDeviceInfoMembers(deviceInfo);
         }
     }
     return result;
@@ -590,8 +657,11 @@ static IOTHUB_REGISTRYMANAGER_RESULT parseDeviceListJson(BUFFER_HANDLE jsonBuffe
                     iothubDevice->deviceProperties = NULL;
                     iothubDevice->serviceProperties = NULL;
                     const char* deviceId = (char*)json_object_get_string(device_object, DEVICE_JSON_KEY_DEVICE_NAME);
-                    const char* primaryKey = (char*)json_object_dotget_string(device_object, DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY);
-                    const char* secondaryKey = (char*)json_object_dotget_string(device_object, DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY);
+                    JSON_Object* authentication = json_object_get_object(device_object, DEVICE_JSON_KEY_AUTHENTICATION);
+                    JSON_Object* symmetricKey = json_object_get_object(authentication, DEVICE_JSON_KEY_SYMMETRIC_KEY);
+                    JSON_Object* x509Thumbprint = json_object_get_object(authentication, DEVICE_JSON_KEY_X509_THUMBPRINT);
+                    const char* primaryKey = (char*)json_object_get_string(symmetricKey, DEVICE_JSON_KEY_PRIMARY_KEY);
+                    const char* secondaryKey = (char*)json_object_get_string(symmetricKey, DEVICE_JSON_KEY_SECONDARY_KEY);
                     const char* generationId = (char*)json_object_get_string(device_object, DEVICE_JSON_KEY_DEVICE_GENERATION_ID);
                     const char* eTag = (char*)json_object_get_string(device_object, DEVICE_JSON_KEY_DEVICE_ETAG);
                     const char* connectionState = (char*)json_object_get_string(device_object, DEVICE_JSON_KEY_DEVICE_CONNECTIONSTATE);
@@ -609,7 +679,7 @@ static IOTHUB_REGISTRYMANAGER_RESULT parseDeviceListJson(BUFFER_HANDLE jsonBuffe
                     if (primaryKey == NULL)
                     {
                         /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_014: [ IoTHubRegistryManager_GetDeviceList shall, if no json was found for authorization.symetricKey.primaryKey, parse for authorization.x509Thumbprint.primaryThumbprint ] */
-                        primaryKey = (char*)json_object_dotget_string(device_object, DEVICE_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT);
+                        primaryKey = (char*)json_object_get_string(x509Thumbprint, DEVICE_JSON_KEY_PRIMARY_THUMBPRINT);
                         if (primaryKey != NULL)
                         {
                             /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_015: [ IoTHubRegistryManager_GetDeviceList shall, if json was found for authorization.x509Thumbprint.primaryThumbprint, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT" ] */
@@ -625,7 +695,7 @@ static IOTHUB_REGISTRYMANAGER_RESULT parseDeviceListJson(BUFFER_HANDLE jsonBuffe
                     if (secondaryKey == NULL)
                     {
                         /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_017: [ IoTHubRegistryManager_GetDeviceList shall, if no json was found for authorization.symetricKey.secondaryKey, parse for authorization.x509Thumbprint.secondaryThumbprint ] */
-                        secondaryKey = (char*)json_object_dotget_string(device_object, DEVICE_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT);
+                        secondaryKey = (char*)json_object_get_string(x509Thumbprint, DEVICE_JSON_KEY_SECONDARY_THUMBPRINT);
                         if (secondaryKey != NULL)
                         {
                             /*Codes_SRS_IOTHUBREGISTRYMANAGER_06_018: [ IoTHubRegistryManager_GetDeviceList shall, if json was found for authorization.x509Thumbprint.secondaryThumbprint, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT" ] */
@@ -1009,9 +1079,11 @@ static IOTHUB_REGISTRYMANAGER_RESULT createRelativePath(IOTHUB_REQUEST_MODE iotH
             result = IOTHUB_REGISTRYMANAGER_ERROR;
         }
     }
-    else
+    else if ((iotHubRequestMode == IOTHUB_REQUEST_BULK) || (iotHubRequestMode == IOTHUB_REQUEST_CREATE_JOB))
     {
-        if (snprintf(relativePath, 256, RELATIVE_PATH_FMT_CRUD, deviceName, URL_API_VERSION) > 0)
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_007: [ IoTHubRegistryManager_BulkDevices shall send each batch as an HTTP POST request to url/devices?api-version ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_014: [ IoTHubRegistryManager_ImportDevices and IoTHubRegistryManager_ExportDevices shall send the job as an HTTP POST request to url/jobs/create?api-version ] */
+        if (snprintf(relativePath, 256, (iotHubRequestMode == IOTHUB_REQUEST_BULK) ? RELATIVE_PATH_FMT_BULK : RELATIVE_PATH_FMT_CREATE_JOB, URL_API_VERSION) > 0)
         {
             result = IOTHUB_REGISTRYMANAGER_OK;
         }
@@ -1020,26 +1092,61 @@ static IOTHUB_REGISTRYMANAGER_RESULT createRelativePath(IOTHUB_REQUEST_MODE iotH
             result = IOTHUB_REGISTRYMANAGER_ERROR;
         }
     }
-
-    return result;
-}
-
-static HTTP_HEADERS_HANDLE createHttpHeader(IOTHUB_REQUEST_MODE iotHubRequestMode)
-{
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_015: [ IoTHubRegistryManager_CreateDevice shall create an HTTP PUT request using the following HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_027: [ IoTHubRegistryManager_GetDevice shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_054: [ IoTHubRegistryManager_DeleteDevice shall add the following headers to the created HTTP GET request : authorization = sasToken, Request - Id = 1001, Accept = application / json, Content - Type = application / json, charset = utf - 8 ] */
-    HTTP_HEADERS_HANDLE httpHeader;
-
-    if ((httpHeader = HTTPHeaders_Alloc()) == NULL)
-    {
-        LogError("HTTPHeaders_Alloc failed");
-    }
-    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_AUTHORIZATION, HTTP_HEADER_VAL_AUTHORIZATION) != HTTP_HEADERS_OK)
+    else if (iotHubRequestMode == IOTHUB_REQUEST_QUERY_DEVICES)
     {
-        LogError("HTTPHeaders_AddHeaderNameValuePair failed for Authorization header");
-        HTTPHeaders_Free(httpHeader);
-        httpHeader = NULL;
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_023: [ IoTHubRegistryManager_EnumerateDevices shall request every page with an HTTP POST request to url/devices/query?api-version with the body {"query":"SELECT * FROM devices"} and the x-ms-max-item-count header set to pageSize, by calling IoTHubScHttpPool_ExecuteRequestWithResponseHeaders ] */
+        if (snprintf(relativePath, 256, RELATIVE_PATH_FMT_QUERY, URL_API_VERSION) > 0)
+        {
+            result = IOTHUB_REGISTRYMANAGER_OK;
+        }
+        else
+        {
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+    }
+    else if (iotHubRequestMode == IOTHUB_REQUEST_GET_JOB)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_020: [ IoTHubRegistryManager_GetJob shall send an HTTP GET request to url/jobs/[jobId]?api-version ] */
+        if (snprintf(relativePath, 256, RELATIVE_PATH_FMT_GET_JOB, deviceName, URL_API_VERSION) > 0)
+        {
+            result = IOTHUB_REGISTRYMANAGER_OK;
+        }
+        else
+        {
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+    }
+    else
+    {
+        if (snprintf(relativePath, 256, RELATIVE_PATH_FMT_CRUD, deviceName, URL_API_VERSION) > 0)
+        {
+            result = IOTHUB_REGISTRYMANAGER_OK;
+        }
+        else
+        {
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+    }
+
+    return result;
+}
+
+static HTTP_HEADERS_HANDLE createHttpHeader(IOTHUB_REQUEST_MODE iotHubRequestMode)
+{
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_015: [ IoTHubRegistryManager_CreateDevice shall create an HTTP PUT request using the following HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_027: [ IoTHubRegistryManager_GetDevice shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_054: [ IoTHubRegistryManager_DeleteDevice shall add the following headers to the created HTTP GET request : authorization = sasToken, Request - Id = 1001, Accept = application / json, Content - Type = application / json, charset = utf - 8 ] */
+    HTTP_HEADERS_HANDLE httpHeader;
+
+    if ((httpHeader = HTTPHeaders_Alloc()) == NULL)
+    {
+        LogError("HTTPHeaders_Alloc failed");
+    }
+    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_AUTHORIZATION, HTTP_HEADER_VAL_AUTHORIZATION) != HTTP_HEADERS_OK)
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for Authorization header");
+        HTTPHeaders_Free(httpHeader);
+        httpHeader = NULL;
     }
     else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_REQUEST_ID, HTTP_HEADER_VAL_REQUEST_ID) != HTTP_HEADERS_OK)
     {
@@ -1083,68 +1190,20 @@ static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_
 {
     IOTHUB_REGISTRYMANAGER_RESULT result;
 
-    STRING_HANDLE uriResouce = NULL;
-    STRING_HANDLE accessKey = NULL;
-    STRING_HANDLE keyName = NULL;
-    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle = NULL;
-    HTTPAPIEX_HANDLE httpExApiHandle = NULL;
     HTTP_HEADERS_HANDLE httpHeader = NULL;
 
-    if ((uriResouce = STRING_construct(registryManagerHandle->hostname)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_099: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_103: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
-        LogError("STRING_construct failed for uriResource");
-        result = IOTHUB_REGISTRYMANAGER_ERROR;
-    }
-    else if ((accessKey = STRING_construct(registryManagerHandle->sharedAccessKey)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_099: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_103: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
-        LogError("STRING_construct failed for accessKey");
-        result = IOTHUB_REGISTRYMANAGER_ERROR;
-    }
-    else if ((keyName = STRING_construct(registryManagerHandle->keyName)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_099: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_103: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
-        LogError("STRING_construct failed for keyName");
-        result = IOTHUB_REGISTRYMANAGER_ERROR;
-    }
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_015: [ IoTHubRegistryManager_CreateDevice shall create an HTTP PUT request using the following HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_027: [ IoTHubRegistryManager_GetDevice shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_043: [ IoTHubRegistryManager_UpdateDevice shall create an HTTP PUT request using the created JSON ] */
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_044: [ IoTHubRegistryManager_UpdateDevice shall create an HTTP PUT request using the createdfollowing HTTP headers : authorization = sasToken, Request - Id = 1001, Accept = application / json, Content - Type = application / json, charset = utf - 8 ] */
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_054: [ IoTHubRegistryManager_DeleteDevice shall add the following headers to the created HTTP GET request : authorization=sasToken, Request-Id=1001, Accept=application/json, Content-Type=application/json, charset=utf-8 ] */
-    else if ((httpHeader = createHttpHeader(iotHubRequestMode)) == NULL)
+    if ((httpHeader = createHttpHeader(iotHubRequestMode)) == NULL)
     {
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_019: [ If any of the HTTPAPI call fails IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_104: [ If any of the HTTPAPI call fails IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
         LogError("HttpHeader creation failed");
         result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
     }
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_016: [ IoTHubRegistryManager_CreateDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_028: [ IoTHubRegistryManager_GetDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_045: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_055: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-    else if ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResouce, keyName)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_019: [ If any of the HTTPAPI call fails IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_104: [ If any of the HTTPAPI call fails IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
-        LogError("HTTPAPIEX_SAS_Create failed");
-        result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
-    }
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_017: [ IoTHubRegistryManager_CreateDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_029: [ IoTHubRegistryManager_GetDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_046: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_056: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-    else if ((httpExApiHandle = HTTPAPIEX_Create(registryManagerHandle->hostname)) == NULL)
-    {
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_019: [ If any of the HTTPAPI call fails IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_104: [ If any of the HTTPAPI call fails IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
-        LogError("HTTPAPIEX_Create failed");
-        result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
-    }
     else 
     {
         HTTPAPI_REQUEST_TYPE httpApiRequestType = HTTPAPI_REQUEST_GET;
@@ -1154,82 +1213,696 @@ static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_
 
         if ((iotHubRequestMode == IOTHUB_REQUEST_CREATE) || (iotHubRequestMode == IOTHUB_REQUEST_UPDATE))
         {
-            httpApiRequestType = HTTPAPI_REQUEST_PUT;
+            httpApiRequestType = HTTPAPI_REQUEST_PUT;
+        }
+        else if (iotHubRequestMode == IOTHUB_REQUEST_DELETE)
+        {
+            httpApiRequestType = HTTPAPI_REQUEST_DELETE;
+        }
+        else if ((iotHubRequestMode == IOTHUB_REQUEST_BULK) || (iotHubRequestMode == IOTHUB_REQUEST_CREATE_JOB))
+        {
+            httpApiRequestType = HTTPAPI_REQUEST_POST;
+        }
+        else if ((iotHubRequestMode == IOTHUB_REQUEST_GET) || (iotHubRequestMode == IOTHUB_REQUEST_GET_DEVICE_LIST) || (iotHubRequestMode == IOTHUB_REQUEST_GET_STATISTICS) || (iotHubRequestMode == IOTHUB_REQUEST_GET_JOB))
+        {
+            httpApiRequestType = HTTPAPI_REQUEST_GET;
+        }
+        else
+        {
+            is_error = 1;
+        }
+
+        if (is_error)
+        {
+            LogError("Invalid request type");
+            result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_026: [ IoTHubRegistryManager_GetDevice shall create HTTP GET request URL using the given deviceId using the following format: url/devices/[deviceId]?api-version=2016-11-14  ] */
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_053: [ IoTHubRegistryManager_DeleteDevice shall create HTTP DELETE request URL using the given deviceId using the following format : url/devices/[deviceId]?api-version ] */
+            if (createRelativePath(iotHubRequestMode, deviceName, numberOfDevices, relativePath) != IOTHUB_REGISTRYMANAGER_OK)
+            {
+                LogError("Failure creating relative path");
+                result = IOTHUB_REGISTRYMANAGER_ERROR;
+            }
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_014: [ IoTHubRegistryManager_CreateDevice shall create an HTTP PUT request using the created JSON ] */
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_018: [ IoTHubRegistryManager_CreateDevice shall execute the HTTP PUT request by calling IoTHubScHttpPool_ExecuteRequest ] */
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_030: [ IoTHubRegistryManager_GetDevice shall execute the HTTP GET request by calling IoTHubScHttpPool_ExecuteRequest ] */
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_047: [ IoTHubRegistryManager_UpdateDevice shall execute the HTTP PUT request by calling IoTHubScHttpPool_ExecuteRequest ] */
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_057: [ IoTHubRegistryManager_DeleteDevice shall execute the HTTP DELETE request by calling IoTHubScHttpPool_ExecuteRequest ] */
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_002: [ IoTHubRegistryManager shall execute every HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ] */
+            else if (IoTHubScHttpPool_ExecuteRequest(registryManagerHandle->httpPool, httpApiRequestType, relativePath, httpHeader, deviceJsonBuffer, &statusCode, responseBuffer) != HTTPAPIEX_OK)
+            {
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_019: [ If any of the HTTPAPI call fails IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
+                LogError("IoTHubScHttpPool_ExecuteRequest failed");
+                result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+            }
+            else
+            {
+                if (statusCode > 300)
+                {
+                    if ((iotHubRequestMode == IOTHUB_REQUEST_CREATE) && (statusCode == 409))
+                    {
+                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_020: [ IoTHubRegistryManager_CreateDevice shall verify the received HTTP status code and if it is 409 then return IOTHUB_REGISTRYMANAGER_DEVICE_EXIST ] */
+                        result = IOTHUB_REGISTRYMANAGER_DEVICE_EXIST;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_021: [ IoTHubRegistryManager_CreateDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
+                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_032: [ IoTHubRegistryManager_GetDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_ERROR ] */
+                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_058: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
+                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_048: [ IoTHubRegistryManager_UpdateDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_ERROR ] */
+                        LogError("Http Failure status code %d.", statusCode);
+                        result = IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR;
+                    }
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_022: [ IoTHubRegistryManager_CreateDevice shall verify the received HTTP status code and if it is less or equal than 300 then try to parse the response JSON to deviceInfo ] */
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_059: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is less or equal than 300 then return IOTHUB_REGISTRYMANAGER_OK ] */
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_049: [ IoTHubRegistryManager_UpdateDevice shall verify the received HTTP status code and if it is less or equal than 300 then return IOTHUB_REGISTRYMANAGER_OK ] */
+                    result = IOTHUB_REGISTRYMANAGER_OK;
+                }
+            }
+        }
+    }
+
+    HTTPHeaders_Free(httpHeader);
+    return result;
+}
+
+typedef struct REGISTRY_BULK_CONTEXT_TAG
+{
+    IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle;
+    IOTHUB_REGISTRY_BULK_OPERATION operation;
+    const IOTHUB_REGISTRY_DEVICE_UPDATE* devices;
+    size_t deviceCount;
+    IOTHUB_REGISTRYMANAGER_RESULT* deviceResults;
+    LOCK_HANDLE lock;
+    size_t nextBatchStart;
+} REGISTRY_BULK_CONTEXT;
+
+static JSON_Value* constructBulkDeviceJson(IOTHUB_REGISTRY_BULK_OPERATION operation, const IOTHUB_REGISTRY_DEVICE_UPDATE* device)
+{
+    JSON_Value* result;
+    JSON_Object* device_object;
+    const char* importMode = (operation == IOTHUB_REGISTRY_BULK_CREATE) ? BULK_JSON_VALUE_IMPORT_MODE_CREATE : ((operation == IOTHUB_REGISTRY_BULK_UPDATE) ? BULK_JSON_VALUE_IMPORT_MODE_UPDATE : BULK_JSON_VALUE_IMPORT_MODE_DELETE);
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_006: [ IoTHubRegistryManager_BulkDevices shall create a JSON array with one object per device containing the id, the importMode ("create", "update" or "delete") and, for create and update, the status and the keys or thumbprints of the device ] */
+    if ((result = json_value_init_object()) == NULL)
+    {
+        LogError("json_value_init_object failed");
+    }
+    else if ((device_object = json_value_get_object(result)) == NULL)
+    {
+        LogError("json_value_get_object failed");
+        json_value_free(result);
+        result = NULL;
+    }
+    else if ((json_object_set_string(device_object, BULK_JSON_KEY_DEVICE_ID, device->deviceId) != JSONSuccess) ||
+        (json_object_set_string(device_object, BULK_JSON_KEY_IMPORT_MODE, importMode) != JSONSuccess))
+    {
+        LogError("json_object_set_string failed for device %s", device->deviceId);
+        json_value_free(result);
+        result = NULL;
+    }
+    else if (operation != IOTHUB_REGISTRY_BULK_DELETE)
+    {
+        const char* primaryKeyName = (device->authMethod == IOTHUB_REGISTRYMANAGER_AUTH_SPK) ? DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY : DEVICE_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT;
+        const char* secondaryKeyName = (device->authMethod == IOTHUB_REGISTRYMANAGER_AUTH_SPK) ? DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY : DEVICE_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT;
+
+        if (json_object_set_string(device_object, DEVICE_JSON_KEY_DEVICE_STATUS, (device->status == IOTHUB_DEVICE_STATUS_ENABLED) ? DEVICE_JSON_DEFAULT_VALUE_ENABLED : DEVICE_JSON_DEFAULT_VALUE_DISABLED) != JSONSuccess)
+        {
+            LogError("json_object_set_string failed for status of device %s", device->deviceId);
+            json_value_free(result);
+            result = NULL;
+        }
+        else if (((device->primaryKey != NULL) && (json_object_dotset_string(device_object, primaryKeyName, device->primaryKey) != JSONSuccess)) ||
+            ((device->secondaryKey != NULL) && (json_object_dotset_string(device_object, secondaryKeyName, device->secondaryKey) != JSONSuccess)))
+        {
+            LogError("json_object_dotset_string failed for keys of device %s", device->deviceId);
+            json_value_free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+static BUFFER_HANDLE constructBulkJson(IOTHUB_REGISTRY_BULK_OPERATION operation, const IOTHUB_REGISTRY_DEVICE_UPDATE* devices, size_t deviceCount)
+{
+    BUFFER_HANDLE result;
+    JSON_Value* root_value;
+    JSON_Array* root_array;
+
+    if ((root_value = json_value_init_array()) == NULL)
+    {
+        LogError("json_value_init_array failed");
+        result = NULL;
+    }
+    else
+    {
+        if ((root_array = json_value_get_array(root_value)) == NULL)
+        {
+            LogError("json_value_get_array failed");
+            result = NULL;
+        }
+        else
+        {
+            size_t index;
+
+            for (index = 0; index < deviceCount; index++)
+            {
+                JSON_Value* device_value;
+
+                if ((device_value = constructBulkDeviceJson(operation, &devices[index])) == NULL)
+                {
+                    LogError("Failure creating JSON for device %s", devices[index].deviceId);
+                    break;
+                }
+                else if (json_array_append_value(root_array, device_value) != JSONSuccess)
+                {
+                    LogError("json_array_append_value failed for device %s", devices[index].deviceId);
+                    json_value_free(device_value);
+                    break;
+                }
+            }
+
+            if (index < deviceCount)
+            {
+                result = NULL;
+            }
+            else
+            {
+                char* serialized_string;
+                if ((serialized_string = json_serialize_to_string(root_value)) == NULL)
+                {
+                    LogError("json_serialize_to_string failed");
+                    result = NULL;
+                }
+                else
+                {
+                    if ((result = BUFFER_create((const unsigned char*)serialized_string, strlen(serialized_string))) == NULL)
+                    {
+                        LogError("Buffer_Create failed");
+                    }
+                    json_free_serialized_string(serialized_string);
+                }
+            }
+        }
+        json_value_free(root_value);
+    }
+
+    return result;
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT parseBulkResponseJson(BUFFER_HANDLE jsonBuffer, const IOTHUB_REGISTRY_DEVICE_UPDATE* devices, size_t deviceCount, IOTHUB_REGISTRYMANAGER_RESULT* deviceResults)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    const char* bufferStr;
+    JSON_Value* root_value;
+    JSON_Object* root_object;
+
+    if ((bufferStr = (const char*)BUFFER_u_char(jsonBuffer)) == NULL)
+    {
+        LogError("BUFFER_u_char failed");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((root_value = json_parse_string(bufferStr)) == NULL)
+    {
+        LogError("json_parse_string failed");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else
+    {
+        JSON_Array* errors;
+
+        if ((root_object = json_value_get_object(root_value)) == NULL)
+        {
+            LogError("json_value_get_object failed");
+            result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+        }
+        else
+        {
+            size_t deviceIndex;
+
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_009: [ IoTHubRegistryManager_BulkDevices shall parse the errors array of the response and set the result of each device listed there to IOTHUB_REGISTRYMANAGER_DEVICE_EXIST for DeviceAlreadyExists, IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST for DeviceNotFound and IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR for any other error; the devices not listed shall be set to IOTHUB_REGISTRYMANAGER_OK ] */
+            for (deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++)
+            {
+                deviceResults[deviceIndex] = IOTHUB_REGISTRYMANAGER_OK;
+            }
+
+            if ((errors = json_object_get_array(root_object, BULK_JSON_KEY_ERRORS)) != NULL)
+            {
+                size_t errorCount = json_array_get_count(errors);
+                size_t errorIndex;
+
+                for (errorIndex = 0; errorIndex < errorCount; errorIndex++)
+                {
+                    JSON_Object* error_object;
+                    const char* deviceId;
+
+                    if (((error_object = json_array_get_object(errors, errorIndex)) != NULL) &&
+                        ((deviceId = json_object_get_string(error_object, DEVICE_JSON_KEY_DEVICE_NAME)) != NULL))
+                    {
+                        const char* errorCode = json_object_get_string(error_object, BULK_JSON_KEY_ERROR_CODE);
+
+                        for (deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++)
+                        {
+                            if (strcmp(devices[deviceIndex].deviceId, deviceId) == 0)
+                            {
+                                if ((errorCode != NULL) && (strcmp(errorCode, BULK_JSON_VALUE_ERROR_DEVICE_EXISTS) == 0))
+                                {
+                                    deviceResults[deviceIndex] = IOTHUB_REGISTRYMANAGER_DEVICE_EXIST;
+                                }
+                                else if ((errorCode != NULL) && (strcmp(errorCode, BULK_JSON_VALUE_ERROR_DEVICE_NOT_FOUND) == 0))
+                                {
+                                    deviceResults[deviceIndex] = IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST;
+                                }
+                                else
+                                {
+                                    LogError("Bulk operation failed for device %s: %s", deviceId, (errorCode == NULL) ? "unknown error" : errorCode);
+                                    deviceResults[deviceIndex] = IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR;
+                                }
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+
+            result = IOTHUB_REGISTRYMANAGER_OK;
+        }
+        json_value_free(root_value);
+    }
+
+    return result;
+}
+
+static void processBulkBatch(REGISTRY_BULK_CONTEXT* context, size_t batchStart, size_t batchSize)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT batchResult;
+    BUFFER_HANDLE bulkJsonBuffer;
+    BUFFER_HANDLE responseBuffer = NULL;
+    const IOTHUB_REGISTRY_DEVICE_UPDATE* batchDevices = &context->devices[batchStart];
+    IOTHUB_REGISTRYMANAGER_RESULT* batchResults = &context->deviceResults[batchStart];
+
+    if ((bulkJsonBuffer = constructBulkJson(context->operation, batchDevices, batchSize)) == NULL)
+    {
+        LogError("Failure creating bulk registry JSON");
+        batchResult = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((responseBuffer = BUFFER_new()) == NULL)
+    {
+        LogError("BUFFER_new failed for responseBuffer");
+        batchResult = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_007: [ IoTHubRegistryManager_BulkDevices shall send each batch as an HTTP POST request to url/devices?api-version ] */
+    else if (((batchResult = sendHttpRequestCRUD(context->registryManagerHandle, IOTHUB_REQUEST_BULK, NULL, bulkJsonBuffer, 0, responseBuffer)) == IOTHUB_REGISTRYMANAGER_OK) ||
+        (batchResult == IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR))
+    {
+        if (parseBulkResponseJson(responseBuffer, batchDevices, batchSize, batchResults) == IOTHUB_REGISTRYMANAGER_OK)
+        {
+            batchSize = 0;
+        }
+    }
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_010: [ If a batch could not be sent, or its response carries no per-device errors, IoTHubRegistryManager_BulkDevices shall set the result of every device in the batch to the result of the request ] */
+    while (batchSize > 0)
+    {
+        batchSize--;
+        batchResults[batchSize] = batchResult;
+    }
+
+    if (responseBuffer != NULL)
+    {
+        BUFFER_delete(responseBuffer);
+    }
+    if (bulkJsonBuffer != NULL)
+    {
+        BUFFER_delete(bulkJsonBuffer);
+    }
+}
+
+static int runBulkBatches(void* arg)
+{
+    REGISTRY_BULK_CONTEXT* context = (REGISTRY_BULK_CONTEXT*)arg;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_008: [ IoTHubRegistryManager_BulkDevices shall split the devices into batches of at most IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES devices and send up to maxConcurrency batches at the same time, the calling thread being one of the senders ] */
+    while (1)
+    {
+        size_t batchStart;
+        size_t batchSize;
+
+        if (Lock(context->lock) != LOCK_OK)
+        {
+            LogError("Failed to lock the bulk operation");
+            break;
+        }
+
+        batchStart = context->nextBatchStart;
+        batchSize = context->deviceCount - batchStart;
+        if (batchSize > IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES)
+        {
+            batchSize = IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES;
+        }
+        context->nextBatchStart += batchSize;
+
+        (void)Unlock(context->lock);
+
+        if (batchSize == 0)
+        {
+            break;
+        }
+
+        processBulkBatch(context, batchStart, batchSize);
+    }
+
+    return 0;
+}
+
+static BUFFER_HANDLE constructJobJson(const char* jobType, const char* inputBlobContainerUri, const char* outputBlobContainerUri, const bool* excludeKeysInExport)
+{
+    BUFFER_HANDLE result;
+    JSON_Value* root_value;
+    JSON_Object* root_object;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_013: [ IoTHubRegistryManager_ImportDevices and IoTHubRegistryManager_ExportDevices shall create a JSON object containing the job type ("import" or "export"), the blob container URIs and, for export, excludeKeysInExport ] */
+    if ((root_value = json_value_init_object()) == NULL)
+    {
+        LogError("json_value_init_object failed");
+        result = NULL;
+    }
+    else
+    {
+        if ((root_object = json_value_get_object(root_value)) == NULL)
+        {
+            LogError("json_value_get_object failed");
+            result = NULL;
+        }
+        else if (json_object_set_string(root_object, JOB_JSON_KEY_TYPE, jobType) != JSONSuccess)
+        {
+            LogError("json_object_set_string failed for type");
+            result = NULL;
+        }
+        else if ((inputBlobContainerUri != NULL) && (json_object_set_string(root_object, JOB_JSON_KEY_INPUT_BLOB_CONTAINER_URI, inputBlobContainerUri) != JSONSuccess))
+        {
+            LogError("json_object_set_string failed for inputBlobContainerUri");
+            result = NULL;
+        }
+        else if (json_object_set_string(root_object, JOB_JSON_KEY_OUTPUT_BLOB_CONTAINER_URI, outputBlobContainerUri) != JSONSuccess)
+        {
+            LogError("json_object_set_string failed for outputBlobContainerUri");
+            result = NULL;
+        }
+        else if ((excludeKeysInExport != NULL) && (json_object_set_boolean(root_object, JOB_JSON_KEY_EXCLUDE_KEYS_IN_EXPORT, *excludeKeysInExport ? 1 : 0) != JSONSuccess))
+        {
+            LogError("json_object_set_boolean failed for excludeKeysInExport");
+            result = NULL;
+        }
+        else
+        {
+            char* serialized_string;
+            if ((serialized_string = json_serialize_to_string(root_value)) == NULL)
+            {
+                LogError("json_serialize_to_string failed");
+                result = NULL;
+            }
+            else
+            {
+                if ((result = BUFFER_create((const unsigned char*)serialized_string, strlen(serialized_string))) == NULL)
+                {
+                    LogError("Buffer_Create failed");
+                }
+                json_free_serialized_string(serialized_string);
+            }
+        }
+        json_value_free(root_value);
+    }
+
+    return result;
+}
+
+static IOTHUB_REGISTRY_JOB_STATUS parseJobStatus(const char* status)
+{
+    IOTHUB_REGISTRY_JOB_STATUS result;
+
+    if (status == NULL)
+    {
+        result = IOTHUB_REGISTRY_JOB_STATUS_UNKNOWN;
+    }
+    else if (strcmp(status, "enqueued") == 0)
+    {
+        result = IOTHUB_REGISTRY_JOB_STATUS_ENQUEUED;
+    }
+    else if (strcmp(status, "running") == 0)
+    {
+        result = IOTHUB_REGISTRY_JOB_STATUS_RUNNING;
+    }
+    else if (strcmp(status, "completed") == 0)
+    {
+        result = IOTHUB_REGISTRY_JOB_STATUS_COMPLETED;
+    }
+    else if (strcmp(status, "failed") == 0)
+    {
+        result = IOTHUB_REGISTRY_JOB_STATUS_FAILED;
+    }
+    else if (strcmp(status, "cancelled") == 0)
+    {
+        result = IOTHUB_REGISTRY_JOB_STATUS_CANCELLED;
+    }
+    else
+    {
+        result = IOTHUB_REGISTRY_JOB_STATUS_UNKNOWN;
+    }
+
+    return result;
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT parseJobJson(BUFFER_HANDLE jsonBuffer, IOTHUB_REGISTRY_JOB* job)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    const char* bufferStr;
+    JSON_Value* root_value;
+    JSON_Object* root_object;
+
+    job->jobId = NULL;
+    job->status = IOTHUB_REGISTRY_JOB_STATUS_UNKNOWN;
+    job->progress = 0;
+    job->failureReason = NULL;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_015: [ IoTHubRegistryManager_ImportDevices, IoTHubRegistryManager_ExportDevices and IoTHubRegistryManager_GetJob shall parse the jobId, status, progress and failureReason of the response into job; jobId and failureReason shall be allocated copies owned by the caller ] */
+    if ((bufferStr = (const char*)BUFFER_u_char(jsonBuffer)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If the parsing fails the job functions shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("BUFFER_u_char failed");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else if ((root_value = json_parse_string(bufferStr)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If the parsing fails the job functions shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        LogError("json_parse_string failed");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else
+    {
+        if ((root_object = json_value_get_object(root_value)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If the parsing fails the job functions shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+            LogError("json_value_get_object failed");
+            result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+        }
+        else
+        {
+            const char* jobId = json_object_get_string(root_object, JOB_JSON_KEY_JOB_ID);
+            const char* failureReason = json_object_get_string(root_object, JOB_JSON_KEY_FAILURE_REASON);
+
+            if (jobId == NULL)
+            {
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If the parsing fails the job functions shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+                LogError("Job response has no jobId");
+                result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+            }
+            else if (mallocAndStrcpy_s((char**)&job->jobId, jobId) != 0)
+            {
+                LogError("mallocAndStrcpy_s failed for jobId");
+                result = IOTHUB_REGISTRYMANAGER_ERROR;
+            }
+            else if ((failureReason != NULL) && (mallocAndStrcpy_s((char**)&job->failureReason, failureReason) != 0))
+            {
+                LogError("mallocAndStrcpy_s failed for failureReason");
+                free((char*)job->jobId);
+                job->jobId = NULL;
+                job->failureReason = NULL;
+                result = IOTHUB_REGISTRYMANAGER_ERROR;
+            }
+            else
+            {
+                job->status = parseJobStatus(json_object_get_string(root_object, JOB_JSON_KEY_STATUS));
+                job->progress = (size_t)json_object_get_number(root_object, JOB_JSON_KEY_PROGRESS);
+                result = IOTHUB_REGISTRYMANAGER_OK;
+            }
+        }
+        json_value_free(root_value);
+    }
+
+    return result;
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT sendJobRequest(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REQUEST_MODE iotHubRequestMode, const char* jobId, BUFFER_HANDLE jobJsonBuffer, IOTHUB_REGISTRY_JOB* job)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    BUFFER_HANDLE responseBuffer;
+
+    if ((responseBuffer = BUFFER_new()) == NULL)
+    {
+        LogError("BUFFER_new failed for responseBuffer");
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else
+    {
+        if ((result = sendHttpRequestCRUD(registryManagerHandle, iotHubRequestMode, jobId, jobJsonBuffer, 0, responseBuffer)) != IOTHUB_REGISTRYMANAGER_OK)
+        {
+            LogError("Failure sending HTTP request for registry job");
+        }
+        else
+        {
+            result = parseJobJson(responseBuffer, job);
+        }
+        BUFFER_delete(responseBuffer);
+    }
+
+    return result;
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT sendDeviceQueryRequest(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, size_t pageSize, const char* continuationToken, BUFFER_HANDLE queryJsonBuffer, HTTP_HEADERS_HANDLE responseHeader, BUFFER_HANDLE responseBuffer)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    HTTP_HEADERS_HANDLE httpHeader;
+    char pageSizeStr[32];
+    char relativePath[256];
+    unsigned int statusCode;
+
+    if ((httpHeader = createHttpHeader(IOTHUB_REQUEST_QUERY_DEVICES)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_028: [ If any of the HTTPAPI calls fails IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR, if parsing a page fails it shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR and if any other call fails it shall return IOTHUB_REGISTRYMANAGER_ERROR ] */
+        LogError("HttpHeader creation failed");
+        result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else
+    {
+        if (snprintf(pageSizeStr, sizeof(pageSizeStr), "%zu", pageSize) <= 0)
+        {
+            LogError("Failure formatting the page size");
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
         }
-        else if (iotHubRequestMode == IOTHUB_REQUEST_DELETE)
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_023: [ IoTHubRegistryManager_EnumerateDevices shall request every page with an HTTP POST request to url/devices/query?api-version with the body {"query":"SELECT * FROM devices"} and the x-ms-max-item-count header set to pageSize, by calling IoTHubScHttpPool_ExecuteRequestWithResponseHeaders ] */
+        else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_MAX_ITEM_COUNT, pageSizeStr) != HTTP_HEADERS_OK)
         {
-            httpApiRequestType = HTTPAPI_REQUEST_DELETE;
+            LogError("HTTPHeaders_AddHeaderNameValuePair failed for x-ms-max-item-count header");
+            result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
         }
-        else if ((iotHubRequestMode == IOTHUB_REQUEST_GET) || (iotHubRequestMode == IOTHUB_REQUEST_GET_DEVICE_LIST) || (iotHubRequestMode == IOTHUB_REQUEST_GET_STATISTICS))
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_024: [ If the response to a page carries an x-ms-continuation header, IoTHubRegistryManager_EnumerateDevices shall request the next page with the x-ms-continuation request header set to its value; the enumeration ends with the first response that has none ] */
+        else if ((continuationToken != NULL) && (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_CONTINUATION, continuationToken) != HTTP_HEADERS_OK))
         {
-            httpApiRequestType = HTTPAPI_REQUEST_GET;
+            LogError("HTTPHeaders_AddHeaderNameValuePair failed for x-ms-continuation header");
+            result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+        }
+        else if (createRelativePath(IOTHUB_REQUEST_QUERY_DEVICES, NULL, 0, relativePath) != IOTHUB_REGISTRYMANAGER_OK)
+        {
+            LogError("Failure creating relative path");
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+        else if (IoTHubScHttpPool_ExecuteRequestWithResponseHeaders(registryManagerHandle->httpPool, HTTPAPI_REQUEST_POST, relativePath, httpHeader, queryJsonBuffer, &statusCode, responseHeader, responseBuffer) != HTTPAPIEX_OK)
+        {
+            LogError("IoTHubScHttpPool_ExecuteRequestWithResponseHeaders failed");
+            result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+        }
+        else if (statusCode > 300)
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_027: [ If the HTTP status code of any page is greater than 300 IoTHubRegistryManager_EnumerateDevices shall stop and return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
+            LogError("Http Failure status code %d.", statusCode);
+            result = IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR;
         }
         else
         {
-            is_error = 1;
+            result = IOTHUB_REGISTRYMANAGER_OK;
         }
 
-        if (is_error)
+        HTTPHeaders_Free(httpHeader);
+    }
+
+    return result;
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT parseDevicePageJson(BUFFER_HANDLE jsonBuffer, IOTHUB_REGISTRYMANAGER_DEVICE_CALLBACK deviceCallback, void* userContextCallback, bool* stopped)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    const char* bufferStr;
+    JSON_Value* root_value;
+    JSON_Array* device_array;
+
+    if ((bufferStr = (const char*)BUFFER_u_char(jsonBuffer)) == NULL)
+    {
+        LogError("BUFFER_u_char failed");
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if ((root_value = json_parse_string(bufferStr)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_028: [ If any of the HTTPAPI calls fails IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR, if parsing a page fails it shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR and if any other call fails it shall return IOTHUB_REGISTRYMANAGER_ERROR ] */
+        LogError("json_parse_string failed");
+        result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+    }
+    else
+    {
+        if ((device_array = json_value_get_array(root_value)) == NULL)
         {
-            LogError("Invalid request type");
-            result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+            LogError("json_value_get_array failed");
+            result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
         }
         else
         {
-            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_026: [ IoTHubRegistryManager_GetDevice shall create HTTP GET request URL using the given deviceId using the following format: url/devices/[deviceId]?api-version=2016-11-14  ] */
-            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_053: [ IoTHubRegistryManager_DeleteDevice shall create HTTP DELETE request URL using the given deviceId using the following format : url/devices/[deviceId]?api-version ] */
-            if (createRelativePath(iotHubRequestMode, deviceName, numberOfDevices, relativePath) != IOTHUB_REGISTRYMANAGER_OK)
-            {
-                LogError("Failure creating relative path");
-                result = IOTHUB_REGISTRYMANAGER_ERROR;
-            }
-            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_014: [ IoTHubRegistryManager_CreateDevice shall create an HTTP PUT request using the created JSON ] */
-            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_018: [ IoTHubRegistryManager_CreateDevice shall execute the HTTP PUT request by calling HTTPAPIEX_ExecuteRequest ] */
-            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_030: [ IoTHubRegistryManager_GetDevice shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ] */
-            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_047: [ IoTHubRegistryManager_UpdateDevice shall execute the HTTP PUT request by calling HTTPAPIEX_ExecuteRequest ] */
-            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_057: [ IoTHubRegistryManager_DeleteDevice shall execute the HTTP DELETE request by calling HTTPAPIEX_ExecuteRequest ] */
-            else if (HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, relativePath, httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_019: [ If any of the HTTPAPI call fails IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
-                LogError("HTTPAPIEX_SAS_ExecuteRequest failed");
-                result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
-            }
-            else
+            size_t array_count = json_array_get_count(device_array);
+            size_t i;
+
+            result = IOTHUB_REGISTRYMANAGER_OK;
+
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_025: [ IoTHubRegistryManager_EnumerateDevices shall parse one page at a time and call deviceCallback once for every device in it, with an IOTHUB_DEVICE that is freed as soon as deviceCallback returns ] */
+            for (i = 0; (i < array_count) && (result == IOTHUB_REGISTRYMANAGER_OK) && (*stopped == false); i++)
             {
-                if (statusCode > 300)
+                JSON_Object* device_object;
+
+                if ((device_object = json_array_get_object(device_array, i)) == NULL)
                 {
-                    if ((iotHubRequestMode == IOTHUB_REQUEST_CREATE) && (statusCode == 409))
+                    LogError("json_array_get_object failed");
+                    result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+                }
+                else
+                {
+                    IOTHUB_DEVICE device;
+
+                    memset(&device, 0, sizeof(device));
+                    initializeDeviceInfo(&device);
+
+                    if ((result = parseDeviceJsonObject(device_object, &device)) != IOTHUB_REGISTRYMANAGER_OK)
                     {
-                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_020: [ IoTHubRegistryManager_CreateDevice shall verify the received HTTP status code and if it is 409 then return IOTHUB_REGISTRYMANAGER_DEVICE_EXIST ] */
-                        result = IOTHUB_REGISTRYMANAGER_DEVICE_EXIST;
+                        LogError("Failure parsing device %zu of the page", i);
                     }
-                    else
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_026: [ If deviceCallback returns false IoTHubRegistryManager_EnumerateDevices shall stop without requesting any further page and return IOTHUB_REGISTRYMANAGER_OK ] */
+                    else if (deviceCallback(&device, userContextCallback) == false)
                     {
-                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_021: [ IoTHubRegistryManager_CreateDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
-                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_032: [ IoTHubRegistryManager_GetDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_ERROR ] */
-                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_058: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
-                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_048: [ IoTHubRegistryManager_UpdateDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_ERROR ] */
-                        LogError("Http Failure status code %d.", statusCode);
-                        result = IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR;
+                        *stopped = true;
                     }
-                }
-                else
-                {
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_022: [ IoTHubRegistryManager_CreateDevice shall verify the received HTTP status code and if it is less or equal than 300 then try to parse the response JSON to deviceInfo ] */
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_059: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is less or equal than 300 then return IOTHUB_REGISTRYMANAGER_OK ] */
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_049: [ IoTHubRegistryManager_UpdateDevice shall verify the received HTTP status code and if it is less or equal than 300 then return IOTHUB_REGISTRYMANAGER_OK ] */
-                    result = IOTHUB_REGISTRYMANAGER_OK;
+
+                    freeDeviceInfoMembers(&device);
                 }
             }
         }
+
+        json_value_free(root_value);
     }
 
-    HTTPHeaders_Free(httpHeader);
-    HTTPAPIEX_Destroy(httpExApiHandle);
-    HTTPAPIEX_SAS_Destroy(httpExApiSasHandle);
-    STRING_delete(keyName);
-    STRING_delete(accessKey);
-    STRING_delete(uriResouce);
     return result;
 }
 
@@ -1335,6 +2008,18 @@ IOTHUB_REGISTRYMANAGER_HANDLE IoTHubRegistryManager_Create(IOTHUB_SERVICE_CLIENT
                     free(result);
                     result = NULL;
                 }
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_001: [ IoTHubRegistryManager_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none. If this fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+                else if ((result->httpPool = ((serviceClientAuth->httpPool != NULL) ? IoTHubScHttpPool_Clone(serviceClientAuth->httpPool) : IoTHubScHttpPool_Create(result->hostname, result->sharedAccessKey, result->keyName))) == NULL)
+                {
+                    LogError("Failed to get an HTTP connection pool");
+                    free(result->hostname);
+                    free(result->iothubName);
+                    free(result->iothubSuffix);
+                    free(result->sharedAccessKey);
+                    free(result->keyName);
+                    free(result);
+                    result = NULL;
+                }
             }
         }
     }
@@ -1354,6 +2039,8 @@ void IoTHubRegistryManager_Destroy(IOTHUB_REGISTRYMANAGER_HANDLE registryManager
         free(regManHandle->iothubSuffix);
         free(regManHandle->sharedAccessKey);
         free(regManHandle->keyName);
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_003: [ IoTHubRegistryManager_Destroy shall release its reference to the HTTP connection pool by calling IoTHubScHttpPool_Destroy ] */
+        IoTHubScHttpPool_Destroy(regManHandle->httpPool);
         free(regManHandle);
     }
 }
@@ -1425,9 +2112,7 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_CreateDevice(IOTHUB_REGISTRY
                 }
                 /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_014: [ IoTHubRegistryManager_CreateDevice shall create an HTTP PUT request using the created JSON ] */
                 /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_015: [ IoTHubRegistryManager_CreateDevice shall create an HTTP PUT request using the following HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_016: [ IoTHubRegistryManager_CreateDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_017: [ IoTHubRegistryManager_CreateDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_018: [ IoTHubRegistryManager_CreateDevice shall execute the HTTP PUT request by calling HTTPAPIEX_ExecuteRequest ] */
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_018: [ IoTHubRegistryManager_CreateDevice shall execute the HTTP PUT request by calling IoTHubScHttpPool_ExecuteRequest ] */
                 else if ((result = sendHttpRequestCRUD(registryManagerHandle, IOTHUB_REQUEST_CREATE, deviceCreateInfo->deviceId, deviceJsonBuffer, 0, responseBuffer)) == IOTHUB_REGISTRYMANAGER_ERROR)
                 {
                     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_019: [ If any of the HTTPAPI call fails IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
@@ -1483,9 +2168,7 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetDevice(IOTHUB_REGISTRYMAN
         }
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_026: [ IoTHubRegistryManager_GetDevice shall create HTTP GET request URL using the given deviceId using the following format: url/devices/[deviceId]?api-version=2016-11-14  ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_027: [ IoTHubRegistryManager_GetDevice shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_028: [ IoTHubRegistryManager_GetDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_029: [ IoTHubRegistryManager_GetDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_030: [ IoTHubRegistryManager_GetDevice shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_030: [ IoTHubRegistryManager_GetDevice shall execute the HTTP GET request by calling IoTHubScHttpPool_ExecuteRequest ] */
         else if ((result = sendHttpRequestCRUD(registryManagerHandle, IOTHUB_REQUEST_GET, deviceId, NULL, 0, responseBuffer)) == IOTHUB_REGISTRYMANAGER_ERROR)
         {
             /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_031: [ If any of the HTTPAPI call fails IoTHubRegistryManager_GetDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
@@ -1580,9 +2263,7 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_UpdateDevice(IOTHUB_REGISTRY
                 }
                 /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_043: [ IoTHubRegistryManager_UpdateDevice shall create an HTTP PUT request using the created JSON ] */
                 /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_044: [ IoTHubRegistryManager_UpdateDevice shall create an HTTP PUT request using the createdfollowing HTTP headers : authorization = sasToken, Request - Id = 1001, Accept = application / json, Content - Type = application / json, charset = utf - 8 ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_045: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_046: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_047: [ IoTHubRegistryManager_UpdateDevice shall execute the HTTP PUT request by calling HTTPAPIEX_ExecuteRequest ] */
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_047: [ IoTHubRegistryManager_UpdateDevice shall execute the HTTP PUT request by calling IoTHubScHttpPool_ExecuteRequest ] */
                 else if ((result = sendHttpRequestCRUD(registryManagerHandle, IOTHUB_REQUEST_UPDATE, deviceUpdate->deviceId, deviceJsonBuffer, 0, responseBuffer)) == IOTHUB_REGISTRYMANAGER_ERROR)
                 {
                     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_103: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
@@ -1620,9 +2301,7 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_DeleteDevice(IOTHUB_REGISTRY
     {
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_053: [ IoTHubRegistryManager_DeleteDevice shall create HTTP DELETE request URL using the given deviceId using the following format : url / devices / [deviceId] ? api - version  ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_054: [ IoTHubRegistryManager_DeleteDevice shall add the following headers to the created HTTP GET request : authorization = sasToken, Request - Id = 1001, Accept = application / json, Content - Type = application / json, charset = utf - 8 ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_055: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_056: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_057: [ IoTHubRegistryManager_DeleteDevice shall execute the HTTP DELETE request by calling HTTPAPIEX_ExecuteRequest ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_057: [ IoTHubRegistryManager_DeleteDevice shall execute the HTTP DELETE request by calling IoTHubScHttpPool_ExecuteRequest ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_058: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_059: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is less or equal than 300 then return IOTHUB_REGISTRYMANAGER_OK ] */
         result = sendHttpRequestCRUD(registryManagerHandle, IOTHUB_REQUEST_DELETE, deviceId, NULL, 0, NULL);
@@ -1659,9 +2338,7 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetDeviceList(IOTHUB_REGISTR
         }
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_062: [ IoTHubRegistryManager_GetDeviceList shall create HTTP GET request for numberOfDevices using the follwoing format: url/devices/?top=[numberOfDevices]&api-version ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_063: [ IoTHubRegistryManager_GetDeviceList shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_064: [ IoTHubRegistryManager_GetDeviceList shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_065: [ IoTHubRegistryManager_GetDeviceList shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_066: [ IoTHubRegistryManager_GetDeviceList shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_066: [ IoTHubRegistryManager_GetDeviceList shall execute the HTTP GET request by calling IoTHubScHttpPool_ExecuteRequest ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_067: [ IoTHubRegistryManager_GetDeviceList shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_068: [ IoTHubRegistryManager_GetDeviceList shall verify the received HTTP status code and if it is less or equal than 300 then try to parse the response JSON to deviceList ] */
         else if ((result = sendHttpRequestCRUD(registryManagerHandle, IOTHUB_REQUEST_GET_DEVICE_LIST, NULL, NULL, numberOfDevices, responseBuffer)) == IOTHUB_REGISTRYMANAGER_ERROR)
@@ -1671,7 +2348,7 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetDeviceList(IOTHUB_REGISTR
         }
         else if (result == IOTHUB_REGISTRYMANAGER_OK)
         {
-            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_069: [ IoTHubRegistryManager_GetDeviceList shall use the following parson APIs to parse the response JSON: json_parse_string, json_value_get_object, json_object_get_string, json_object_dotget_string  ] */
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_069: [ IoTHubRegistryManager_GetDeviceList shall use the following parson APIs to parse the response JSON: json_parse_string, json_value_get_object, json_object_get_object, json_object_get_string  ] */
             /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_070: [ If any of the parson API fails, IoTHubRegistryManager_GetDeviceList shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
             /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_071: [ IoTHubRegistryManager_GetDeviceList shall populate the deviceList parameter with structures of type "IOTHUB_DEVICE" ] */
             /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_072: [ If populating the deviceList parameter fails IoTHubRegistryManager_GetDeviceList shall return IOTHUB_REGISTRYMANAGER_ERROR ] */
@@ -1711,9 +2388,7 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetStatistics(IOTHUB_REGISTR
         }
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_075: [ IoTHubRegistryManager_GetStatistics shall create HTTP GET request for statistics using the following format: url/statistics/devices?api-version ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_076: [ IoTHubRegistryManager_GetStatistics shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_077: [ IoTHubRegistryManager_GetStatistics shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_078: [ IoTHubRegistryManager_GetStatistics shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_079: [ IoTHubRegistryManager_GetStatistics shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_079: [ IoTHubRegistryManager_GetStatistics shall execute the HTTP GET request by calling IoTHubScHttpPool_ExecuteRequest ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_080: [ IoTHubRegistryManager_GetStatistics shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_081: [ IoTHubRegistryManager_GetStatistics shall verify the received HTTP status code and if it is less or equal than 300 then use the following parson APIs to parse the response JSON to registry statistics structure: json_parse_string, json_value_get_object, json_object_get_string, json_object_dotget_string ] */
         else if ((result = sendHttpRequestCRUD(registryManagerHandle, IOTHUB_REQUEST_GET_STATISTICS, NULL, NULL, 0, responseBuffer)) == IOTHUB_REGISTRYMANAGER_ERROR)
@@ -1736,3 +2411,276 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetStatistics(IOTHUB_REGISTR
     }
     return result;
 }
+
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_BulkDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REGISTRY_BULK_OPERATION operation, const IOTHUB_REGISTRY_DEVICE_UPDATE* devices, size_t deviceCount, size_t maxConcurrency, IOTHUB_REGISTRYMANAGER_RESULT* deviceResults)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    size_t index;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_004: [ If registryManagerHandle, devices or deviceResults is NULL, or deviceCount or maxConcurrency is 0, or operation is not a valid IOTHUB_REGISTRY_BULK_OPERATION, IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if ((registryManagerHandle == NULL) || (devices == NULL) || (deviceResults == NULL) || (deviceCount == 0) || (maxConcurrency == 0) ||
+        ((operation != IOTHUB_REGISTRY_BULK_CREATE) && (operation != IOTHUB_REGISTRY_BULK_UPDATE) && (operation != IOTHUB_REGISTRY_BULK_DELETE)))
+    {
+        LogError("Invalid argument");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_005: [ If any device has a NULL deviceId, or, for create and update, an authMethod other than IOTHUB_REGISTRYMANAGER_AUTH_SPK or IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT, IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG without sending any request ] */
+        for (index = 0; index < deviceCount; index++)
+        {
+            if ((devices[index].deviceId == NULL) ||
+                ((operation != IOTHUB_REGISTRY_BULK_DELETE) &&
+                 (devices[index].authMethod != IOTHUB_REGISTRYMANAGER_AUTH_SPK) && (devices[index].authMethod != IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT)))
+            {
+                break;
+            }
+        }
+
+        if (index < deviceCount)
+        {
+            LogError("Invalid device at index %lu", (unsigned long)index);
+            result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+        }
+        else
+        {
+            REGISTRY_BULK_CONTEXT context;
+
+            for (index = 0; index < deviceCount; index++)
+            {
+                deviceResults[index] = IOTHUB_REGISTRYMANAGER_ERROR;
+            }
+
+            context.registryManagerHandle = registryManagerHandle;
+            context.operation = operation;
+            context.devices = devices;
+            context.deviceCount = deviceCount;
+            context.deviceResults = deviceResults;
+            context.nextBatchStart = 0;
+
+            if ((context.lock = Lock_Init()) == NULL)
+            {
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_011: [ If Lock_Init fails IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
+                LogError("Lock_Init failed");
+                result = IOTHUB_REGISTRYMANAGER_ERROR;
+            }
+            else
+            {
+                size_t batchCount = (deviceCount / IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES) + (((deviceCount % IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES) == 0) ? 0 : 1);
+                size_t threadCount = ((maxConcurrency < batchCount) ? maxConcurrency : batchCount) - 1;
+                size_t startedThreads = 0;
+                THREAD_HANDLE* threads = NULL;
+
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_008: [ IoTHubRegistryManager_BulkDevices shall split the devices into batches of at most IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES devices and send up to maxConcurrency batches at the same time, the calling thread being one of the senders ] */
+                if ((threadCount > 0) && (threadCount <= (SIZE_MAX / sizeof(THREAD_HANDLE))))
+                {
+                    if ((threads = (THREAD_HANDLE*)malloc(threadCount * sizeof(THREAD_HANDLE))) == NULL)
+                    {
+                        LogError("Failed to allocate the bulk worker threads, sending the batches one at a time");
+                    }
+                    else
+                    {
+                        while (startedThreads < threadCount)
+                        {
+                            if (ThreadAPI_Create(&threads[startedThreads], runBulkBatches, &context) != THREADAPI_OK)
+                            {
+                                LogError("ThreadAPI_Create failed, continuing with %lu bulk worker threads", (unsigned long)startedThreads);
+                                break;
+                            }
+                            startedThreads++;
+                        }
+                    }
+                }
+
+                (void)runBulkBatches(&context);
+
+                for (index = 0; index < startedThreads; index++)
+                {
+                    int threadResult;
+                    if (ThreadAPI_Join(threads[index], &threadResult) != THREADAPI_OK)
+                    {
+                        LogError("ThreadAPI_Join failed");
+                    }
+                }
+
+                free(threads);
+                Lock_Deinit(context.lock);
+
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_012: [ IoTHubRegistryManager_BulkDevices shall return IOTHUB_REGISTRYMANAGER_OK if every device succeeded and IOTHUB_REGISTRYMANAGER_ERROR otherwise, with the result of each device in deviceResults ] */
+                result = IOTHUB_REGISTRYMANAGER_OK;
+                for (index = 0; index < deviceCount; index++)
+                {
+                    if (deviceResults[index] != IOTHUB_REGISTRYMANAGER_OK)
+                    {
+                        result = IOTHUB_REGISTRYMANAGER_ERROR;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_ImportDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* inputBlobContainerUri, const char* outputBlobContainerUri, IOTHUB_REGISTRY_JOB* job)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_017: [ If registryManagerHandle, inputBlobContainerUri, outputBlobContainerUri or job is NULL, IoTHubRegistryManager_ImportDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if ((registryManagerHandle == NULL) || (inputBlobContainerUri == NULL) || (outputBlobContainerUri == NULL) || (job == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else
+    {
+        BUFFER_HANDLE jobJsonBuffer;
+
+        if ((jobJsonBuffer = constructJobJson(JOB_JSON_VALUE_TYPE_IMPORT, inputBlobContainerUri, outputBlobContainerUri, NULL)) == NULL)
+        {
+            LogError("Failure creating import job JSON");
+            result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_014: [ IoTHubRegistryManager_ImportDevices and IoTHubRegistryManager_ExportDevices shall send the job as an HTTP POST request to url/jobs/create?api-version ] */
+            result = sendJobRequest(registryManagerHandle, IOTHUB_REQUEST_CREATE_JOB, NULL, jobJsonBuffer, job);
+            BUFFER_delete(jobJsonBuffer);
+        }
+    }
+    return result;
+}
+
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_ExportDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* outputBlobContainerUri, bool excludeKeys, IOTHUB_REGISTRY_JOB* job)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_018: [ If registryManagerHandle, outputBlobContainerUri or job is NULL, IoTHubRegistryManager_ExportDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if ((registryManagerHandle == NULL) || (outputBlobContainerUri == NULL) || (job == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else
+    {
+        BUFFER_HANDLE jobJsonBuffer;
+
+        if ((jobJsonBuffer = constructJobJson(JOB_JSON_VALUE_TYPE_EXPORT, NULL, outputBlobContainerUri, &excludeKeys)) == NULL)
+        {
+            LogError("Failure creating export job JSON");
+            result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_014: [ IoTHubRegistryManager_ImportDevices and IoTHubRegistryManager_ExportDevices shall send the job as an HTTP POST request to url/jobs/create?api-version ] */
+            result = sendJobRequest(registryManagerHandle, IOTHUB_REQUEST_CREATE_JOB, NULL, jobJsonBuffer, job);
+            BUFFER_delete(jobJsonBuffer);
+        }
+    }
+    return result;
+}
+
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetJob(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* jobId, IOTHUB_REGISTRY_JOB* job)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_019: [ If registryManagerHandle, jobId or job is NULL, IoTHubRegistryManager_GetJob shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if ((registryManagerHandle == NULL) || (jobId == NULL) || (job == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_020: [ IoTHubRegistryManager_GetJob shall send an HTTP GET request to url/jobs/[jobId]?api-version ] */
+        result = sendJobRequest(registryManagerHandle, IOTHUB_REQUEST_GET_JOB, jobId, NULL, job);
+    }
+    return result;
+}
+
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_EnumerateDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, size_t pageSize, IOTHUB_REGISTRYMANAGER_DEVICE_CALLBACK deviceCallback, void* userContextCallback)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_021: [ If registryManagerHandle or deviceCallback is NULL IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if ((registryManagerHandle == NULL) || (deviceCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_022: [ If pageSize is not between 1 and 1000 IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    else if ((pageSize == 0) || (pageSize > IOTHUB_DEVICES_MAX_REQUEST))
+    {
+        LogError("pageSize has to be between 1 and 1000");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else
+    {
+        BUFFER_HANDLE queryJsonBuffer;
+        BUFFER_HANDLE responseBuffer;
+
+        if ((queryJsonBuffer = BUFFER_create((const unsigned char*)QUERY_JSON_ALL_DEVICES, strlen(QUERY_JSON_ALL_DEVICES))) == NULL)
+        {
+            LogError("BUFFER_create failed for the query");
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+        else if ((responseBuffer = BUFFER_new()) == NULL)
+        {
+            LogError("BUFFER_new failed for responseBuffer");
+            BUFFER_delete(queryJsonBuffer);
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+        else
+        {
+            char* continuationToken = NULL;
+            bool stopped = false;
+
+            do
+            {
+                HTTP_HEADERS_HANDLE responseHeader;
+
+                /*the response headers are collected again for every page, the previous continuation token has been copied out*/
+                if ((responseHeader = HTTPHeaders_Alloc()) == NULL)
+                {
+                    LogError("HTTPHeaders_Alloc failed for the response headers");
+                    result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+                }
+                else
+                {
+                    if ((result = sendDeviceQueryRequest(registryManagerHandle, pageSize, continuationToken, queryJsonBuffer, responseHeader, responseBuffer)) != IOTHUB_REGISTRYMANAGER_OK)
+                    {
+                        LogError("Failure sending HTTP request for device query");
+                    }
+                    else if ((result = parseDevicePageJson(responseBuffer, deviceCallback, userContextCallback, &stopped)) != IOTHUB_REGISTRYMANAGER_OK)
+                    {
+                        LogError("Failure parsing the device query page");
+                    }
+
+                    free(continuationToken);
+                    continuationToken = NULL;
+
+                    if ((result == IOTHUB_REGISTRYMANAGER_OK) && (stopped == false))
+                    {
+                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_024: [ If the response to a page carries an x-ms-continuation header, IoTHubRegistryManager_EnumerateDevices shall request the next page with the x-ms-continuation request header set to its value; the enumeration ends with the first response that has none ] */
+                        const char* nextToken = HTTPHeaders_FindHeaderValue(responseHeader, HTTP_HEADER_KEY_CONTINUATION);
+                        if ((nextToken != NULL) && (nextToken[0] != '\0') && (mallocAndStrcpy_s(&continuationToken, nextToken) != 0))
+                        {
+                            LogError("mallocAndStrcpy_s failed for the continuation token");
+                            continuationToken = NULL;
+                            result = IOTHUB_REGISTRYMANAGER_ERROR;
+                        }
+                    }
+
+                    HTTPHeaders_Free(responseHeader);
+                }
+            } while ((result == IOTHUB_REGISTRYMANAGER_OK) && (continuationToken != NULL));
+
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_029: [ IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_OK once every page has been enumerated ] */
+            free(continuationToken);
+            BUFFER_delete(responseBuffer);
+            BUFFER_delete(queryJsonBuffer);
+        }
+    }
+
+    return result;
+}
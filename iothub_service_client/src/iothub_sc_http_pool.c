@@ -0,0 +1,277 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/sastoken.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/lock.h"
+
+#include "iothub_sc_http_pool.h"
+
+#define IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS 8
+#define IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME_SECS 3600
+#define IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN_SECS 300
+
+#define HTTP_HEADER_KEY_AUTHORIZATION "Authorization"
+
+typedef struct IOTHUB_SC_HTTP_POOL_TAG
+{
+    LOCK_HANDLE lock;
+    size_t refCount;
+    char* hostname;
+    STRING_HANDLE uriResource;
+    STRING_HANDLE sharedAccessKey;
+    STRING_HANDLE keyName;
+    STRING_HANDLE sasToken;
+    size_t sasTokenExpiry;
+    HTTPAPIEX_HANDLE idleConnections[IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS];
+    size_t idleConnectionCount;
+} IOTHUB_SC_HTTP_POOL;
+
+static void destroyPool(IOTHUB_SC_HTTP_POOL* httpPool)
+{
+    while (httpPool->idleConnectionCount > 0)
+    {
+        httpPool->idleConnectionCount--;
+        HTTPAPIEX_Destroy(httpPool->idleConnections[httpPool->idleConnectionCount]);
+    }
+    STRING_delete(httpPool->sasToken);
+    STRING_delete(httpPool->keyName);
+    STRING_delete(httpPool->sharedAccessKey);
+    STRING_delete(httpPool->uriResource);
+    free(httpPool->hostname);
+    if (httpPool->lock != NULL)
+    {
+        (void)Lock_Deinit(httpPool->lock);
+    }
+    free(httpPool);
+}
+
+/*must be called with the pool locked*/
+static int refreshSasTokenIfNeeded(IOTHUB_SC_HTTP_POOL* httpPool)
+{
+    int result;
+    time_t currentTime = get_time(NULL);
+    if (currentTime == (time_t)-1)
+    {
+        LogError("get_time failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t secondsSinceEpoch = (size_t)get_difftime(currentTime, (time_t)0);
+
+        /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_011: [ If there is no cached SAS token, or the cached SAS token expires in less than IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN_SECS, IoTHubScHttpPool_ExecuteRequest shall create a new one by calling SASToken_Create with an expiry of IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME_SECS from now. ]*/
+        if ((httpPool->sasToken != NULL) && (secondsSinceEpoch + IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN_SECS < httpPool->sasTokenExpiry))
+        {
+            result = 0;
+        }
+        else
+        {
+            size_t expiry = secondsSinceEpoch + IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME_SECS;
+            STRING_HANDLE sasToken = SASToken_Create(httpPool->sharedAccessKey, httpPool->uriResource, httpPool->keyName, expiry);
+            if (sasToken == NULL)
+            {
+                LogError("SASToken_Create failed");
+                result = __FAILURE__;
+            }
+            else
+            {
+                STRING_delete(httpPool->sasToken);
+                httpPool->sasToken = sasToken;
+                httpPool->sasTokenExpiry = expiry;
+                result = 0;
+            }
+        }
+    }
+    return result;
+}
+
+IOTHUB_SC_HTTP_POOL_HANDLE IoTHubScHttpPool_Create(const char* hostname, const char* sharedAccessKey, const char* keyName)
+{
+    IOTHUB_SC_HTTP_POOL_HANDLE result;
+
+    /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_001: [ If hostname, sharedAccessKey or keyName is NULL then IoTHubScHttpPool_Create shall fail and return NULL. ]*/
+    if ((hostname == NULL) || (sharedAccessKey == NULL) || (keyName == NULL))
+    {
+        LogError("invalid argument const char* hostname=%p, const char* sharedAccessKey=%p, const char* keyName=%p", hostname, sharedAccessKey, keyName);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_002: [ IoTHubScHttpPool_Create shall allocate memory for the pool, copy hostname, sharedAccessKey and keyName, create a lock and set the reference count to 1. ]*/
+    else if ((result = malloc(sizeof(IOTHUB_SC_HTTP_POOL))) == NULL)
+    {
+        /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_003: [ If any of the above fails then IoTHubScHttpPool_Create shall free all the resources it allocated and return NULL. ]*/
+        LogError("malloc failed for IOTHUB_SC_HTTP_POOL");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(IOTHUB_SC_HTTP_POOL));
+        result->refCount = 1;
+
+        if (mallocAndStrcpy_s(&result->hostname, hostname) != 0)
+        {
+            /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_003: [ If any of the above fails then IoTHubScHttpPool_Create shall free all the resources it allocated and return NULL. ]*/
+            LogError("mallocAndStrcpy_s failed for hostname");
+            destroyPool(result);
+            result = NULL;
+        }
+        else if (((result->uriResource = STRING_construct(hostname)) == NULL) ||
+            ((result->sharedAccessKey = STRING_construct(sharedAccessKey)) == NULL) ||
+            ((result->keyName = STRING_construct(keyName)) == NULL))
+        {
+            /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_003: [ If any of the above fails then IoTHubScHttpPool_Create shall free all the resources it allocated and return NULL. ]*/
+            LogError("STRING_construct failed");
+            destroyPool(result);
+            result = NULL;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_003: [ If any of the above fails then IoTHubScHttpPool_Create shall free all the resources it allocated and return NULL. ]*/
+            LogError("Lock_Init failed");
+            destroyPool(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+IOTHUB_SC_HTTP_POOL_HANDLE IoTHubScHttpPool_Clone(IOTHUB_SC_HTTP_POOL_HANDLE httpPool)
+{
+    IOTHUB_SC_HTTP_POOL_HANDLE result;
+
+    /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_004: [ If httpPool is NULL then IoTHubScHttpPool_Clone shall fail and return NULL. ]*/
+    if (httpPool == NULL)
+    {
+        LogError("invalid argument IOTHUB_SC_HTTP_POOL_HANDLE httpPool=%p", httpPool);
+        result = NULL;
+    }
+    else if (Lock(httpPool->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_006: [ If the lock cannot be taken then IoTHubScHttpPool_Clone shall fail and return NULL. ]*/
+        LogError("Lock failed");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_005: [ IoTHubScHttpPool_Clone shall increment the reference count under the lock and return httpPool. ]*/
+        httpPool->refCount++;
+        (void)Unlock(httpPool->lock);
+        result = httpPool;
+    }
+    return result;
+}
+
+void IoTHubScHttpPool_Destroy(IOTHUB_SC_HTTP_POOL_HANDLE httpPool)
+{
+    /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_007: [ If httpPool is NULL then IoTHubScHttpPool_Destroy shall return. ]*/
+    if (httpPool != NULL)
+    {
+        size_t refCount;
+
+        /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_008: [ IoTHubScHttpPool_Destroy shall decrement the reference count under the lock. ]*/
+        if (Lock(httpPool->lock) != LOCK_OK)
+        {
+            LogError("Lock failed, the pool is leaked");
+            refCount = 0;
+        }
+        else
+        {
+            refCount = httpPool->refCount--;
+            (void)Unlock(httpPool->lock);
+        }
+
+        /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_009: [ When the last reference is released IoTHubScHttpPool_Destroy shall destroy the idle connections, the cached SAS token and the lock and free the pool. ]*/
+        if (refCount == 1)
+        {
+            destroyPool(httpPool);
+        }
+    }
+}
+
+HTTPAPIEX_RESULT IoTHubScHttpPool_ExecuteRequest(IOTHUB_SC_HTTP_POOL_HANDLE httpPool, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, BUFFER_HANDLE responseContent)
+{
+    return IoTHubScHttpPool_ExecuteRequestWithResponseHeaders(httpPool, requestType, relativePath, requestHttpHeadersHandle, requestContent, statusCode, NULL, responseContent);
+}
+
+HTTPAPIEX_RESULT IoTHubScHttpPool_ExecuteRequestWithResponseHeaders(IOTHUB_SC_HTTP_POOL_HANDLE httpPool, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    HTTPAPIEX_RESULT result;
+
+    /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_010: [ If httpPool, relativePath or requestHttpHeadersHandle is NULL then IoTHubScHttpPool_ExecuteRequest shall fail and return HTTPAPIEX_INVALID_ARG. ]*/
+    if ((httpPool == NULL) || (relativePath == NULL) || (requestHttpHeadersHandle == NULL))
+    {
+        LogError("invalid argument IOTHUB_SC_HTTP_POOL_HANDLE httpPool=%p, const char* relativePath=%p, HTTP_HEADERS_HANDLE requestHttpHeadersHandle=%p", httpPool, relativePath, requestHttpHeadersHandle);
+        result = HTTPAPIEX_INVALID_ARG;
+    }
+    else if (Lock(httpPool->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_015: [ If any of the calls above fails then IoTHubScHttpPool_ExecuteRequest shall fail and return HTTPAPIEX_ERROR. ]*/
+        LogError("Lock failed");
+        result = HTTPAPIEX_ERROR;
+    }
+    else
+    {
+        HTTPAPIEX_HANDLE httpExApiHandle = NULL;
+        int tokenResult;
+
+        /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_011: [ If there is no cached SAS token, or the cached SAS token expires in less than IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN_SECS, IoTHubScHttpPool_ExecuteRequest shall create a new one by calling SASToken_Create with an expiry of IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME_SECS from now. ]*/
+        /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_012: [ IoTHubScHttpPool_ExecuteRequest shall set the Authorization header of the request to the cached SAS token by calling HTTPHeaders_ReplaceHeaderNameValuePair. ]*/
+        if ((tokenResult = refreshSasTokenIfNeeded(httpPool)) == 0)
+        {
+            if (HTTPHeaders_ReplaceHeaderNameValuePair(requestHttpHeadersHandle, HTTP_HEADER_KEY_AUTHORIZATION, STRING_c_str(httpPool->sasToken)) != HTTP_HEADERS_OK)
+            {
+                LogError("HTTPHeaders_ReplaceHeaderNameValuePair failed for Authorization header");
+                tokenResult = __FAILURE__;
+            }
+            /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_013: [ IoTHubScHttpPool_ExecuteRequest shall take an idle connection from the pool, or create one by calling HTTPAPIEX_Create outside the lock if there is none. ]*/
+            else if (httpPool->idleConnectionCount > 0)
+            {
+                httpPool->idleConnectionCount--;
+                httpExApiHandle = httpPool->idleConnections[httpPool->idleConnectionCount];
+            }
+        }
+        (void)Unlock(httpPool->lock);
+
+        if (tokenResult != 0)
+        {
+            /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_015: [ If any of the calls above fails then IoTHubScHttpPool_ExecuteRequest shall fail and return HTTPAPIEX_ERROR. ]*/
+            result = HTTPAPIEX_ERROR;
+        }
+        else if ((httpExApiHandle == NULL) && ((httpExApiHandle = HTTPAPIEX_Create(httpPool->hostname)) == NULL))
+        {
+            /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_015: [ If any of the calls above fails then IoTHubScHttpPool_ExecuteRequest shall fail and return HTTPAPIEX_ERROR. ]*/
+            LogError("HTTPAPIEX_Create failed");
+            result = HTTPAPIEX_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_014: [ IoTHubScHttpPool_ExecuteRequest shall execute the request outside the lock by calling HTTPAPIEX_ExecuteRequest and return its result. ]*/
+            /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_017: [ IoTHubScHttpPool_ExecuteRequestWithResponseHeaders shall behave as IoTHubScHttpPool_ExecuteRequest and pass responseHttpHeadersHandle to HTTPAPIEX_ExecuteRequest; IoTHubScHttpPool_ExecuteRequest shall call it with a NULL responseHttpHeadersHandle. ]*/
+            result = HTTPAPIEX_ExecuteRequest(httpExApiHandle, requestType, relativePath, requestHttpHeadersHandle, requestContent, statusCode, responseHttpHeadersHandle, responseContent);
+
+            /*Codes_SRS_IOTHUB_SC_HTTP_POOL_41_016: [ If the request succeeded and the pool holds fewer than IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS idle connections, IoTHubScHttpPool_ExecuteRequest shall return the connection to the pool; otherwise it shall destroy it by calling HTTPAPIEX_Destroy. ]*/
+            if ((result == HTTPAPIEX_OK) && (Lock(httpPool->lock) == LOCK_OK))
+            {
+                if (httpPool->idleConnectionCount < IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS)
+                {
+                    httpPool->idleConnections[httpPool->idleConnectionCount] = httpExApiHandle;
+                    httpPool->idleConnectionCount++;
+                    httpExApiHandle = NULL;
+                }
+                (void)Unlock(httpPool->lock);
+            }
+
+            if (httpExApiHandle != NULL)
+            {
+                HTTPAPIEX_Destroy(httpExApiHandle);
+            }
+        }
+    }
+    return result;
+}
@@ -10,6 +10,7 @@
 #include "azure_c_shared_utility/connection_string_parser.h"
 
 #include "iothub_service_client_auth.h"
+#include "iothub_sc_http_pool.h"
 
 #define IOTHUBHOSTNAME "HostName"
 #define IOTHUBSHAREDACESSKEYNAME "SharedAccessKeyName"
@@ -211,6 +212,19 @@ IOTHUB_SERVICE_CLIENT_AUTH_HANDLE IoTHubServiceClientAuth_CreateFromConnectionSt
                         free(result);
                         result = NULL;
                     }
+                    /*Codes_SRS_IOTHUBSERVICECLIENT_41_001: [** IoTHubServiceClientAuth_CreateFromConnectionString shall create the HTTP connection pool shared by the service client APIs by calling IoTHubScHttpPool_Create with hostName, sharedAccessKey and keyName. **] */
+                    else if ((result->httpPool = IoTHubScHttpPool_Create(result->hostname, result->sharedAccessKey, result->keyName)) == NULL)
+                    {
+                        /*Codes_SRS_IOTHUBSERVICECLIENT_41_002: [** If IoTHubScHttpPool_Create fails, IoTHubServiceClientAuth_CreateFromConnectionString shall do clean up and return NULL. **] */
+                        LogError("IoTHubScHttpPool_Create failed");
+                        free(result->hostname);
+                        free(result->keyName);
+                        free(result->sharedAccessKey);
+                        free(result->iothubName);
+                        free(result->iothubSuffix);
+                        free(result);
+                        result = NULL;
+                    }
                     /*Codes_SRS_IOTHUBSERVICECLIENT_12_006: [** If the IOTHUB_SERVICE_CLIENT_AUTH has been populated IoTHubServiceClientAuth_CreateFromConnectionString shall do clean up and return with a IOTHUB_SERVICE_CLIENT_AUTH_HANDLE to it **] */
                     STRING_delete(token_key_string);
                     STRING_delete(token_value_string);
@@ -238,6 +252,8 @@ void IoTHubServiceClientAuth_Destroy(IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceCl
         free(authInfo->iothubSuffix);
         free(authInfo->sharedAccessKey);
         free(authInfo->keyName);
+        /*Codes_SRS_IOTHUBSERVICECLIENT_41_003: [** IoTHubServiceClient_Destroy shall release its reference to the HTTP connection pool by calling IoTHubScHttpPool_Destroy. **]*/
+        IoTHubScHttpPool_Destroy(authInfo->httpPool);
         free(authInfo);
     }
 }
@@ -52,8 +52,11 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
 
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/httpapiex.h"
-#include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/uniqueid.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "iothub_sc_http_pool.h"
 #include "parson.h"
 
 MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
@@ -144,30 +147,6 @@ void my_BUFFER_delete(BUFFER_HANDLE handle)
     my_gballoc_free(handle);
 }
 
-HTTPAPIEX_HANDLE my_HTTPAPIEX_Create(const char* hostName)
-{
-    (void)hostName;
-    return (HTTPAPIEX_HANDLE)my_gballoc_malloc(1);
-}
-
-void my_HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
-{
-    my_gballoc_free(handle);
-}
-
-HTTPAPIEX_SAS_HANDLE my_HTTPAPIEX_SAS_Create(STRING_HANDLE key, STRING_HANDLE uriResource, STRING_HANDLE keyName)
-{
-    (void)key;
-    (void)uriResource;
-    (void)keyName;
-    return (HTTPAPIEX_SAS_HANDLE)my_gballoc_malloc(1);
-}
-
-void my_HTTPAPIEX_SAS_Destroy(HTTPAPIEX_SAS_HANDLE handle)
-{
-    my_gballoc_free(handle);
-}
-
 char* my_json_serialize_to_string(const JSON_Value *value)
 {
     (void)value;
@@ -196,6 +175,9 @@ typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_TAG
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
+    LOCK_HANDLE asyncInvocationsLock;
+    DLIST_ENTRY asyncInvocations;
 } IOTHUB_SERVICE_CLIENT_DEVICE_METHOD;
 
 static IOTHUB_SERVICE_CLIENT_AUTH TEST_IOTHUB_SERVICE_CLIENT_AUTH;
@@ -214,6 +196,16 @@ static char* TEST_SHAREDACCESSKEY = "theSharedAccessKey";
 static char* TEST_SHAREDACCESSKEYNAME = "theSharedAccessKeyName";
 
 static const HTTP_HEADERS_HANDLE TEST_HTTP_HEADERS_HANDLE = (HTTP_HEADERS_HANDLE)0x4545;
+static const IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4646;
+static const LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4747;
+static const THREAD_HANDLE TEST_THREAD_HANDLE = (THREAD_HANDLE)0x4848;
+
+static const char* TEST_DEVICE_IDS[] = { "device1", "device2" };
+#define TEST_DEVICE_COUNT (sizeof(TEST_DEVICE_IDS) / sizeof(TEST_DEVICE_IDS[0]))
+static const char* TEST_METHOD_NAME = "reboot";
+static const char* TEST_METHOD_PAYLOAD = "{}";
+static const unsigned int TEST_METHOD_TIMEOUT = 30;
+static void* TEST_USER_CONTEXT = (void*)0x4949;
 
 static const unsigned int httpStatusCodeOk = 200;
 static const unsigned int httpStatusCodeBadRequest = 400;
@@ -234,6 +226,71 @@ static JSON_Value* TEST_JSON_VALUE = (JSON_Value*)0x5050;
 static JSON_Object* TEST_JSON_OBJECT = (JSON_Object*)0x5151;
 static JSON_Status TEST_JSON_STATUS = 0;
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+#ifdef __cplusplus
+}
+#endif
+
+static THREAD_START_FUNC g_thread_func;
+static void* g_thread_func_arg;
+static size_t g_thread_join_count;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = TEST_THREAD_HANDLE;
+    g_thread_func = func;
+    g_thread_func_arg = arg;
+    return THREADAPI_OK;
+}
+
+/* The worker threads are not really started, they run when they are joined */
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    (void)threadHandle;
+    g_thread_join_count++;
+    if (g_thread_func != NULL)
+    {
+        THREAD_START_FUNC thread_func = g_thread_func;
+        g_thread_func = NULL;
+        int thread_result = thread_func(g_thread_func_arg);
+        if (res != NULL)
+        {
+            *res = thread_result;
+        }
+    }
+    return THREADAPI_OK;
+}
+
+#define TEST_MAX_CALLBACKS 4
+static size_t g_invoke_callback_count;
+static IOTHUB_DEVICE_METHOD_RESULT g_invoke_callback_results[TEST_MAX_CALLBACKS];
+static const char* g_invoke_callback_device_ids[TEST_MAX_CALLBACKS];
+static void* g_invoke_callback_context;
+
+static void test_invoke_callback(IOTHUB_DEVICE_METHOD_RESULT result, const char* deviceId, int responseStatus, const unsigned char* responsePayload, size_t responsePayloadSize, void* userContextCallback)
+{
+    (void)responseStatus;
+    (void)responsePayload;
+    (void)responsePayloadSize;
+    if (g_invoke_callback_count < TEST_MAX_CALLBACKS)
+    {
+        g_invoke_callback_results[g_invoke_callback_count] = result;
+        g_invoke_callback_device_ids[g_invoke_callback_count] = (strcmp(deviceId, TEST_DEVICE_IDS[0]) == 0) ? TEST_DEVICE_IDS[0] : (strcmp(deviceId, TEST_DEVICE_IDS[1]) == 0) ? TEST_DEVICE_IDS[1] : NULL;
+    }
+    g_invoke_callback_count++;
+    g_invoke_callback_context = userContextCallback;
+}
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -289,8 +346,15 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SC_HTTP_POOL_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(JSON_Value_Type, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
 
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
@@ -330,18 +394,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_ERROR);
 
-    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
-
-    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Destroy, my_HTTPAPIEX_Destroy);
-
-    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_SAS_Create, my_HTTPAPIEX_SAS_Create);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_Create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_Clone, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubScHttpPool_Clone, NULL);
 
-    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_SAS_Destroy, my_HTTPAPIEX_SAS_Destroy);
-
-    REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_OK);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_ExecuteRequest, HTTPAPIEX_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubScHttpPool_ExecuteRequest, HTTPAPIEX_ERROR);
 
     REGISTER_GLOBAL_MOCK_HOOK(json_parse_string, my_json_parse_string);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_parse_string, NULL);
@@ -365,6 +422,25 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
     REGISTER_GLOBAL_MOCK_HOOK(json_serialize_to_string, my_json_serialize_to_string);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_serialize_to_string, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
+
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -388,7 +464,13 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubSuffix = TEST_IOTHUBSUFFIX;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = TEST_SHAREDACCESSKEY;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
 
+    g_thread_func = NULL;
+    g_thread_func_arg = NULL;
+    g_thread_join_count = 0;
+    g_invoke_callback_count = 0;
+    g_invoke_callback_context = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -501,6 +583,10 @@ TEST_FUNCTION(IoTHubDeviceMethod_Create_happy_path)
     
     EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
     
     // act
     IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE result = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
@@ -508,6 +594,7 @@ TEST_FUNCTION(IoTHubDeviceMethod_Create_happy_path)
     // assert
     ASSERT_IS_NOT_NULL(result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_SC_HTTP_POOL_HANDLE, result->httpPool);
     
     ///cleanup
     if (result != NULL)
@@ -520,12 +607,55 @@ TEST_FUNCTION(IoTHubDeviceMethod_Create_happy_path)
     }
 }
 
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_001: [ IoTHubDeviceMethod_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none. If this fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_Create_creates_its_own_HTTP_pool_if_the_auth_handle_has_none)
+{
+    // arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = NULL;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME))
+        .SetReturn(TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE result = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    if (result != NULL)
+    {
+        free(result->hostname);
+        free(result->keyName);
+        free(result->sharedAccessKey);
+        free(result);
+        result = NULL;
+    }
+}
+
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_004: [ If the allocation failed, IoTHubDeviceMethod_Create shall return NULL ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_007: [ If the mallocAndStrcpy_s fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_009: [ If the mallocAndStrcpy_s fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_011: [ If the mallocAndStrcpy_s fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_013: [ If the mallocAndStrcpy_s fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_015: [ If the mallocAndStrcpy_s fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_004: [ IoTHubDeviceMethod_Create shall create the lock protecting the list of asynchronous invocations by calling Lock_Init. If this fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_001: [ IoTHubDeviceMethod_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none. If this fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
 TEST_FUNCTION(IoTHubDeviceMethod_Create_non_happy_path)
 {
     // arrange
@@ -544,23 +674,29 @@ TEST_FUNCTION(IoTHubDeviceMethod_Create_non_happy_path)
     EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, (const char*)(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE->keyName)))
         .IgnoreArgument(1);
 
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
 
     ///act
     for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        /// arrange
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(i);
+        if (i != 6 /*DList_InitializeListHead*/)
+        {
+            /// arrange
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
 
-        /// act
-        IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE result = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+            /// act
+            IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE result = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
 
-        /// assert
-        ASSERT_ARE_EQUAL(void_ptr, NULL, result);
+            /// assert
+            ASSERT_ARE_EQUAL(void_ptr, NULL, result);
 
-        ///cleanup
+            ///cleanup
+        }
     }
     umock_c_negative_tests_deinit();
 
@@ -579,6 +715,8 @@ TEST_FUNCTION(IoTHubDeviceMethod_Destroy_return_if_input_parameter_serviceClient
 }
 
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_017: [ If the serviceClientdevicemethodHandle input parameter is not NULL IoTHubDeviceMethod_Destroy shall free the memory of it and return ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_005: [ IoTHubDeviceMethod_Destroy shall cancel the asynchronous invocations, wait for their worker threads to exit and free them ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_003: [ IoTHubDeviceMethod_Destroy shall release its reference to the HTTP connection pool by calling IoTHubScHttpPool_Destroy ]*/
 TEST_FUNCTION(IoTHubDeviceMethod_Destroy_do_clean_up_and_return_if_input_parameter_serviceClientdevicemethodHandle_is_not_NULL)
 
 {
@@ -587,12 +725,15 @@ TEST_FUNCTION(IoTHubDeviceMethod_Destroy_do_clean_up_and_return_if_input_paramet
 
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -749,8 +890,7 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_return_NULL_if_input_parameter_responseP
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_034: [ IoTHubDeviceMethod_Invoke shall allocate memory for response buffer by calling BUFFER_new ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_039: [ IoTHubDeviceMethod_Invoke shall create an HTTP POST request using methodPayloadBuffer ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_040: [ IoTHubDeviceMethod_Invoke shall create an HTTP POST request using the following HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-/*Tests_SRS_IOTHUBDEVICEMETHOD_12_041: [ IoTHubDeviceMethod_Invoke shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-/*Tests_SRS_IOTHUBDEVICEMETHOD_12_042: [ IoTHubDeviceMethod_Invoke shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_002: [ IoTHubDeviceMethod_Invoke shall execute the HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_043: [ IoTHubDeviceMethod_Invoke shall execute the HTTP POST request by calling HTTPAPIEX_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_049: [ Otherwise IoTHubDeviceMethod_Invoke shall save the received status and payload to the corresponding out parameter and return with IOTHUB_DEVICE_METHOD_OK ]*/
 TEST_FUNCTION(IoTHubDeviceMethod_Invoke_happy_path)
@@ -764,10 +904,6 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_happy_path)
 
     EXPECTED_CALL(BUFFER_new());
 
-    EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
     EXPECTED_CALL(HTTPHeaders_Alloc());
     EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
         .IgnoreArgument(1);
@@ -783,13 +919,9 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_happy_path)
 
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
         .SetReturn(HTTPAPIEX_OK);
@@ -797,20 +929,9 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_happy_path)
     EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .SetReturn(TEST_UNSIGNED_CHAR_PTR);
@@ -867,8 +988,7 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_happy_path)
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_034: [ IoTHubDeviceMethod_Invoke shall allocate memory for response buffer by calling BUFFER_new ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_039: [ IoTHubDeviceMethod_Invoke shall create an HTTP POST request using methodPayloadBuffer ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_040: [ IoTHubDeviceMethod_Invoke shall create an HTTP POST request using the following HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-/*Tests_SRS_IOTHUBDEVICEMETHOD_12_041: [ IoTHubDeviceMethod_Invoke shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-/*Tests_SRS_IOTHUBDEVICEMETHOD_12_042: [ IoTHubDeviceMethod_Invoke shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_002: [ IoTHubDeviceMethod_Invoke shall execute the HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_043: [ IoTHubDeviceMethod_Invoke shall execute the HTTP POST request by calling HTTPAPIEX_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICEMETHOD_12_049: [ Otherwise IoTHubDeviceMethod_Invoke shall save the received status and payload to the corresponding out parameter and return with IOTHUB_DEVICE_METHOD_OK ]*/
 TEST_FUNCTION(IoTHubDeviceMethod_Invoke_happy_path_http_return_not_equal_200)
@@ -882,10 +1002,6 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_happy_path_http_return_not_equal_200)
 
     EXPECTED_CALL(BUFFER_new());
 
-    EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
     EXPECTED_CALL(HTTPHeaders_Alloc());
     EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
         .IgnoreArgument(1);
@@ -901,13 +1017,9 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_happy_path_http_return_not_equal_200)
 
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .CopyOutArgumentBuffer_statusCode(&httpStatusCodeBadRequest, sizeof(httpStatusCodeBadRequest))
         .SetReturn(HTTPAPIEX_OK);
@@ -915,20 +1027,9 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_happy_path_http_return_not_equal_200)
     EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
@@ -973,10 +1074,6 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_non_happy_path)
 
     EXPECTED_CALL(BUFFER_new());
 
-    EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
     EXPECTED_CALL(HTTPHeaders_Alloc());
     EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
         .IgnoreArgument(1);
@@ -992,13 +1089,9 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_non_happy_path)
 
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
         .SetReturn(HTTPAPIEX_OK);
@@ -1006,20 +1099,9 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_non_happy_path)
     EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .SetReturn(TEST_UNSIGNED_CHAR_PTR);
@@ -1082,22 +1164,17 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_non_happy_path)
         /// act
         if (
             (i != 2)  && /*STRING_delete*/
-            (i != 10) && /*UniqueId_Generate*/
-            (i != 14) && /*gballoc_free*/
-            (i != 17) && /*STRING_c_str*/
-            (i != 19) && /*STRING_delete*/
-            (i != 20) && /*HTTPAPIEX_Destroy*/
-            (i != 21) && /*HTTPAPIEX_SAS_Destroy*/
-            (i != 22) && /*HTTPHeaders_Free*/
-            (i != 23) && /*STRING_delete*/
-            (i != 24) && /*STRING_delete*/
-            (i != 25) && /*STRING_delete*/
-            (i != 27) && /*BUFFER_length*/
-            (i != 35) && /*json_value_get_number*/
-            (i != 36) && /*STRING_delete*/
-            (i != 37) && /*json_value_free*/
-            (i != 38) && /*BUFFER_delete*/
-            (i != 39)    /*BUFFER_delete*/
+            (i != 7)  && /*UniqueId_Generate*/
+            (i != 11) && /*gballoc_free*/
+            (i != 12) && /*STRING_c_str*/
+            (i != 14) && /*STRING_delete*/
+            (i != 15) && /*HTTPHeaders_Free*/
+            (i != 17) && /*BUFFER_length*/
+            (i != 25) && /*json_value_get_number*/
+            (i != 26) && /*STRING_delete*/
+            (i != 27) && /*json_value_free*/
+            (i != 28) && /*BUFFER_delete*/
+            (i != 29)    /*BUFFER_delete*/
             )
         {
             result = IoTHubDeviceMethod_Invoke(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, deviceId, methodName, methodPayload, timeout, &responseStatus, &responsePayload, &responsePayloadSize);
@@ -1110,4 +1187,314 @@ TEST_FUNCTION(IoTHubDeviceMethod_Invoke_non_happy_path)
     umock_c_negative_tests_deinit();
 }
 
+static void set_expected_calls_for_InvokeOnDevices(size_t workerCount)
+{
+    size_t i;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_METHOD_NAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_METHOD_PAYLOAD))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(TEST_DEVICE_COUNT * sizeof(char*)));
+    for (i = 0; i < TEST_DEVICE_COUNT; i++)
+    {
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DEVICE_IDS[i]))
+            .IgnoreArgument(1);
+    }
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_malloc(workerCount * sizeof(THREAD_HANDLE)));
+    for (i = 0; i < workerCount; i++)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_006: [ If serviceClientDeviceMethodHandle, deviceIds, any of the device ids, methodName, methodPayload or invokeCallback is NULL, or deviceCount or maxConcurrency is 0, IoTHubDeviceMethod_InvokeOnDevices shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_return_INVALID_ARG_if_input_parameter_serviceClientDeviceMethodHandle_is_NULL)
+{
+    // arrange
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(NULL, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_006: [ If serviceClientDeviceMethodHandle, deviceIds, any of the device ids, methodName, methodPayload or invokeCallback is NULL, or deviceCount or maxConcurrency is 0, IoTHubDeviceMethod_InvokeOnDevices shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_return_INVALID_ARG_if_input_parameter_deviceIds_is_NULL)
+{
+    // arrange
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, NULL, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_006: [ If serviceClientDeviceMethodHandle, deviceIds, any of the device ids, methodName, methodPayload or invokeCallback is NULL, or deviceCount or maxConcurrency is 0, IoTHubDeviceMethod_InvokeOnDevices shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_return_INVALID_ARG_if_input_parameter_deviceCount_is_0)
+{
+    // arrange
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, TEST_DEVICE_IDS, 0, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_006: [ If serviceClientDeviceMethodHandle, deviceIds, any of the device ids, methodName, methodPayload or invokeCallback is NULL, or deviceCount or maxConcurrency is 0, IoTHubDeviceMethod_InvokeOnDevices shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_return_INVALID_ARG_if_a_device_id_is_NULL)
+{
+    // arrange
+    const char* deviceIds[] = { "device1", NULL };
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, deviceIds, 2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_006: [ If serviceClientDeviceMethodHandle, deviceIds, any of the device ids, methodName, methodPayload or invokeCallback is NULL, or deviceCount or maxConcurrency is 0, IoTHubDeviceMethod_InvokeOnDevices shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_return_INVALID_ARG_if_input_parameter_methodName_is_NULL)
+{
+    // arrange
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, NULL, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_006: [ If serviceClientDeviceMethodHandle, deviceIds, any of the device ids, methodName, methodPayload or invokeCallback is NULL, or deviceCount or maxConcurrency is 0, IoTHubDeviceMethod_InvokeOnDevices shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_return_INVALID_ARG_if_input_parameter_methodPayload_is_NULL)
+{
+    // arrange
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, NULL, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_006: [ If serviceClientDeviceMethodHandle, deviceIds, any of the device ids, methodName, methodPayload or invokeCallback is NULL, or deviceCount or maxConcurrency is 0, IoTHubDeviceMethod_InvokeOnDevices shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_return_INVALID_ARG_if_input_parameter_maxConcurrency_is_0)
+{
+    // arrange
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 0, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_006: [ If serviceClientDeviceMethodHandle, deviceIds, any of the device ids, methodName, methodPayload or invokeCallback is NULL, or deviceCount or maxConcurrency is 0, IoTHubDeviceMethod_InvokeOnDevices shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_return_INVALID_ARG_if_input_parameter_invokeCallback_is_NULL)
+{
+    // arrange
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, NULL, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_007: [ IoTHubDeviceMethod_InvokeOnDevices shall copy the device ids, methodName and methodPayload so the caller may free them as soon as the call returns. ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_008: [ IoTHubDeviceMethod_InvokeOnDevices shall start the lesser of maxConcurrency and deviceCount worker threads by calling ThreadAPI_Create and return IOTHUB_DEVICE_METHOD_OK without waiting for the devices. If only some of the threads can be started, the invocation shall continue with those. ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_happy_path_starts_one_worker_per_device_up_to_maxConcurrency)
+{
+    // arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    set_expected_calls_for_InvokeOnDevices(TEST_DEVICE_COUNT);
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(handle, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 10, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_invoke_callback_count);
+
+    // cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_008: [ IoTHubDeviceMethod_InvokeOnDevices shall start the lesser of maxConcurrency and deviceCount worker threads by calling ThreadAPI_Create and return IOTHUB_DEVICE_METHOD_OK without waiting for the devices. If only some of the threads can be started, the invocation shall continue with those. ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_continues_with_the_workers_that_started)
+{
+    // arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(THREADAPI_ERROR);
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(handle, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, TEST_DEVICE_COUNT, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, result);
+
+    // cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+    ASSERT_ARE_EQUAL(size_t, 1, g_thread_join_count);
+    ASSERT_ARE_EQUAL(size_t, TEST_DEVICE_COUNT, g_invoke_callback_count);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_009: [ If any of the calls above fails, IoTHubDeviceMethod_InvokeOnDevices shall free all the resources it allocated, never call invokeCallback and return IOTHUB_DEVICE_METHOD_ERROR ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_non_happy_path)
+{
+    // arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    int umockc_result = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, umockc_result);
+
+    set_expected_calls_for_InvokeOnDevices(1);
+
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        if (
+            (i != 11) && /*DList_InsertTailList*/
+            (i != 12)    /*Unlock*/
+            )
+        {
+            /// arrange
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+
+            /// act
+            IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(handle, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+
+            /// assert
+            ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_ERROR, result);
+        }
+    }
+    umock_c_negative_tests_deinit();
+
+    ASSERT_ARE_EQUAL(size_t, 0, g_invoke_callback_count);
+
+    // cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_010: [ Each worker thread shall take the next device not yet invoked and call the method on it by calling IoTHubDeviceMethod_Invoke, until all the devices are invoked ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_011: [ As each device completes, the worker thread shall call invokeCallback with the result, the device id, the response status and payload and userContextCallback. Calls to invokeCallback for one invocation shall be serialized. ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_worker_invokes_every_device_and_reports_each_result)
+{
+    // arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(handle, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, result);
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn(HTTPAPIEX_ERROR);
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn(HTTPAPIEX_ERROR);
+
+    // act
+    THREAD_START_FUNC thread_func = g_thread_func;
+    g_thread_func = NULL;
+    int thread_result = thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, thread_result);
+    ASSERT_ARE_EQUAL(size_t, TEST_DEVICE_COUNT, g_invoke_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DEVICE_IDS[0], g_invoke_callback_device_ids[0]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DEVICE_IDS[1], g_invoke_callback_device_ids[1]);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_ERROR, g_invoke_callback_results[0]);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_ERROR, g_invoke_callback_results[1]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_USER_CONTEXT, g_invoke_callback_context);
+
+    // cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_013: [ IoTHubDeviceMethod_InvokeOnDevices shall join and free the invocations whose worker threads have all exited. ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeOnDevices_joins_completed_invocations)
+{
+    // arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(handle, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, result);
+    THREAD_START_FUNC thread_func = g_thread_func;
+    g_thread_func = NULL;
+    (void)thread_func(g_thread_func_arg);
+    umock_c_reset_all_calls();
+
+    // act
+    result = IoTHubDeviceMethod_InvokeAsync(handle, TEST_DEVICE_IDS[0], TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_thread_join_count);
+
+    // cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_005: [ IoTHubDeviceMethod_Destroy shall cancel the asynchronous invocations, wait for their worker threads to exit and free them ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_012: [ Devices that are not invoked yet when the invocation is cancelled by IoTHubDeviceMethod_Destroy shall be reported to invokeCallback with IOTHUB_DEVICE_METHOD_ERROR ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_Destroy_cancels_the_devices_not_invoked_yet)
+{
+    // arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeOnDevices(handle, TEST_DEVICE_IDS, TEST_DEVICE_COUNT, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, 1, test_invoke_callback, TEST_USER_CONTEXT);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, result);
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubDeviceMethod_Destroy(handle);
+
+    // assert
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "IoTHubScHttpPool_ExecuteRequest"));
+    ASSERT_ARE_EQUAL(size_t, 1, g_thread_join_count);
+    ASSERT_ARE_EQUAL(size_t, TEST_DEVICE_COUNT, g_invoke_callback_count);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_ERROR, g_invoke_callback_results[0]);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_ERROR, g_invoke_callback_results[1]);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_014: [ IoTHubDeviceMethod_InvokeAsync shall call IoTHubDeviceMethod_InvokeOnDevices with deviceId as the only device and a maxConcurrency of 1 and return its result ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeAsync_return_INVALID_ARG_if_input_parameter_deviceId_is_NULL)
+{
+    // arrange
+
+    // act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeAsync(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, NULL, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_METHOD_TIMEOUT, test_invoke_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 END_TEST_SUITE(iothub_devicemethod_ut)
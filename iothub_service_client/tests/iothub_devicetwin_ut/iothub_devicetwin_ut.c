@@ -53,8 +53,8 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
 
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/httpapiex.h"
-#include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/uniqueid.h"
+#include "iothub_sc_http_pool.h"
 
 #undef ENABLE_MOCKS
 
@@ -118,30 +118,6 @@ void my_BUFFER_delete(BUFFER_HANDLE handle)
     my_gballoc_free(handle);
 }
 
-HTTPAPIEX_HANDLE my_HTTPAPIEX_Create(const char* hostName)
-{
-    (void)hostName;
-    return (HTTPAPIEX_HANDLE)my_gballoc_malloc(1);
-}
-
-void my_HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
-{
-    my_gballoc_free(handle);
-}
-
-HTTPAPIEX_SAS_HANDLE my_HTTPAPIEX_SAS_Create(STRING_HANDLE key, STRING_HANDLE uriResource, STRING_HANDLE keyName)
-{
-    (void)key;
-    (void)uriResource;
-    (void)keyName;
-    return (HTTPAPIEX_SAS_HANDLE)my_gballoc_malloc(1);
-}
-
-void my_HTTPAPIEX_SAS_Destroy(HTTPAPIEX_SAS_HANDLE handle)
-{
-    my_gballoc_free(handle);
-}
-
 #include "iothub_devicetwin.h"
 #include "iothub_service_client_auth.h"
 
@@ -150,6 +126,7 @@ typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_TAG
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
 } IOTHUB_SERVICE_CLIENT_DEVICE_TWIN;
 
 static IOTHUB_SERVICE_CLIENT_AUTH TEST_IOTHUB_SERVICE_CLIENT_AUTH;
@@ -167,6 +144,7 @@ static char* TEST_SHAREDACCESSKEY = "theSharedAccessKey";
 static char* TEST_SHAREDACCESSKEYNAME = "theSharedAccessKeyName";
 
 static const HTTP_HEADERS_HANDLE TEST_HTTP_HEADERS_HANDLE = (HTTP_HEADERS_HANDLE)0x4545;
+static const IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4646;
 
 static const unsigned int httpStatusCodeOk = 200;
 static const unsigned int httpStatusCodeBadRequest = 400;
@@ -213,6 +191,75 @@ extern "C"
 }
 #endif
 
+static const char* TEST_QUERY = "SELECT * FROM devices WHERE tags.location = 'US'";
+static const char* TEST_QUERY_PAGE_1 = "[{\"deviceId\":\"d1\",\"tags\":{\"s\":\"}]\\\"\"}},{\"deviceId\":\"d2\"}]";
+static const char* TEST_QUERY_PAGE_2 = " [ {\"deviceId\":\"d3\",\"a\":[1,{}]} ] ";
+static const char* TEST_CONTINUATION_TOKEN = "theContinuationToken";
+static const char* g_query_pages[2];
+static size_t g_query_page_index;
+static size_t g_query_page_count;
+static size_t g_query_callback_count;
+static size_t g_query_callback_stop_after;
+static unsigned int g_query_status_code;
+
+static HTTPAPIEX_RESULT my_IoTHubScHttpPool_ExecuteRequestWithResponseHeaders(IOTHUB_SC_HTTP_POOL_HANDLE httpPool, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    (void)httpPool;
+    (void)requestType;
+    (void)relativePath;
+    (void)requestHttpHeadersHandle;
+    (void)requestContent;
+    (void)responseHttpHeadersHandle;
+    (void)responseContent;
+    g_query_page_index++;
+    *statusCode = g_query_status_code;
+    return HTTPAPIEX_OK;
+}
+
+static unsigned char* my_BUFFER_u_char(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return (unsigned char*)g_query_pages[g_query_page_index - 1];
+}
+
+static size_t my_BUFFER_length(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return strlen(g_query_pages[g_query_page_index - 1]);
+}
+
+static const char* my_HTTPHeaders_FindHeaderValue(HTTP_HEADERS_HANDLE httpHeadersHandle, const char* name)
+{
+    (void)httpHeadersHandle;
+    (void)name;
+    return (g_query_page_index < g_query_page_count) ? TEST_CONTINUATION_TOKEN : NULL;
+}
+
+static bool test_query_callback(const char* deviceTwinJson, void* userContextCallback)
+{
+    (void)userContextCallback;
+    ASSERT_ARE_EQUAL(char, '{', deviceTwinJson[0]);
+    ASSERT_ARE_EQUAL(char, '}', deviceTwinJson[strlen(deviceTwinJson) - 1]);
+    g_query_callback_count++;
+    return (g_query_callback_stop_after == 0) || (g_query_callback_count < g_query_callback_stop_after);
+}
+
+static void register_twin_query_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders, my_IoTHubScHttpPool_ExecuteRequestWithResponseHeaders);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, my_BUFFER_length);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_FindHeaderValue, my_HTTPHeaders_FindHeaderValue);
+}
+
+static void unregister_twin_query_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_FindHeaderValue, NULL);
+}
+
 BEGIN_TEST_SUITE(iothub_devicetwin_ut)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -238,7 +285,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SC_HTTP_POOL_HANDLE, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -268,18 +315,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_ERROR);
 
-    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_Clone, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubScHttpPool_Clone, NULL);
 
-    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Destroy, my_HTTPAPIEX_Destroy);
-
-    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_SAS_Create, my_HTTPAPIEX_SAS_Create);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_Create, NULL);
-
-    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_SAS_Destroy, my_HTTPAPIEX_SAS_Destroy);
-
-    REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_OK);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_ExecuteRequest, HTTPAPIEX_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubScHttpPool_ExecuteRequest, HTTPAPIEX_ERROR);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -303,6 +343,15 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubSuffix = TEST_IOTHUBSUFFIX;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = TEST_SHAREDACCESSKEY;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    g_query_pages[0] = TEST_QUERY_PAGE_1;
+    g_query_pages[1] = TEST_QUERY_PAGE_2;
+    g_query_page_index = 0;
+    g_query_page_count = 2;
+    g_query_callback_count = 0;
+    g_query_callback_stop_after = 0;
+    g_query_status_code = 200;
 
 }
 
@@ -416,6 +465,8 @@ TEST_FUNCTION(IoTHubDeviceTwin_Create_happy_path)
     
     EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
     
     // act
     IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE result = IoTHubDeviceTwin_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
@@ -424,6 +475,47 @@ TEST_FUNCTION(IoTHubDeviceTwin_Create_happy_path)
     ASSERT_IS_NOT_NULL(result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     
+    ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_SC_HTTP_POOL_HANDLE, result->httpPool);
+    
+    ///cleanup
+    if (result != NULL)
+    {
+        free(result->hostname);
+        free(result->keyName);
+        free(result->sharedAccessKey);
+        free(result);
+        result = NULL;
+    }
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_001: [ IoTHubDeviceTwin_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none. If this fails, IoTHubDeviceTwin_Create shall do clean up and return NULL. ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Create_creates_its_own_HTTP_pool_if_the_auth_handle_has_none)
+{
+    // arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = NULL;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME))
+        .SetReturn(TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+
+    // act
+    IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE result = IoTHubDeviceTwin_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
     ///cleanup
     if (result != NULL)
     {
@@ -441,6 +533,7 @@ TEST_FUNCTION(IoTHubDeviceTwin_Create_happy_path)
 /*Tests_SRS_IOTHUBDEVICETWIN_12_011: [ If the mallocAndStrcpy_s fails, IoTHubDeviceTwin_Create shall do clean up and return NULL. ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_013: [ If the mallocAndStrcpy_s fails, IoTHubDeviceTwin_Create shall do clean up and return NULL. ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_015: [ If the mallocAndStrcpy_s fails, IoTHubDeviceTwin_Create shall do clean up and return NULL. ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_001: [ IoTHubDeviceTwin_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none. If this fails, IoTHubDeviceTwin_Create shall do clean up and return NULL. ]*/
 TEST_FUNCTION(IoTHubDeviceTwin_Create_non_happy_path)
 {
     // arrange
@@ -459,6 +552,7 @@ TEST_FUNCTION(IoTHubDeviceTwin_Create_non_happy_path)
     EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, (const char*)(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE->keyName)))
         .IgnoreArgument(1);
 
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
 
     umock_c_negative_tests_snapshot();
 
@@ -494,6 +588,7 @@ TEST_FUNCTION(IoTHubDeviceTwin_Destroy_return_if_input_parameter_serviceClientDe
 }
 
 /*Tests_SRS_IOTHUBDEVICETWIN_12_017: [ If the serviceClientDeviceTwinHandle input parameter is not NULL IoTHubDeviceTwin_Destroy shall free the memory of it and return ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_003: [ IoTHubDeviceTwin_Destroy shall release its reference to the HTTP connection pool by calling IoTHubScHttpPool_Destroy ]*/
 TEST_FUNCTION(IoTHubDeviceTwin_Destroy_do_clean_up_and_return_if_input_parameter_serviceClientDeviceTwinHandle_is_not_NULL)
 {
     // arrange
@@ -507,6 +602,7 @@ TEST_FUNCTION(IoTHubDeviceTwin_Destroy_do_clean_up_and_return_if_input_parameter
         .IgnoreArgument(1);
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -546,8 +642,7 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_return_NULL_if_input_parameter_deviceId_i
 
 /*Tests_SRS_IOTHUBDEVICETWIN_12_019: [ IoTHubDeviceTwin_GetTwin shall create HTTP GET request URL using the given deviceId using the following format: url/twins/[deviceId] ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_020: [ IoTHubDeviceTwin_GetTwin shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-/*Tests_SRS_IOTHUBDEVICETWIN_12_021: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-/*Tests_SRS_IOTHUBDEVICETWIN_12_022: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_002: [ IoTHubDeviceTwin_GetTwin and IoTHubDeviceTwin_UpdateTwin shall execute the HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_023: [ IoTHubDeviceTwin_GetTwin shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_030: [ Otherwise IoTHubDeviceTwin_GetTwin shall save the received deviceTwin to the out parameter and return with it ]*/
 TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_happy_path_status_code_200)
@@ -555,10 +650,6 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_happy_path_status_code_200)
     // arrange
     EXPECTED_CALL(BUFFER_new());
 
-    EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
     EXPECTED_CALL(HTTPHeaders_Alloc());
     EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
         .IgnoreArgument(1);
@@ -574,33 +665,18 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_happy_path_status_code_200)
     
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
         .SetReturn(HTTPAPIEX_OK);
 
     EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -627,8 +703,7 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_happy_path_status_code_200)
 
 /*Tests_SRS_IOTHUBDEVICETWIN_12_019: [ IoTHubDeviceTwin_GetTwin shall create HTTP GET request URL using the given deviceId using the following format: url/twins/[deviceId] ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_020: [ IoTHubDeviceTwin_GetTwin shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-/*Tests_SRS_IOTHUBDEVICETWIN_12_021: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-/*Tests_SRS_IOTHUBDEVICETWIN_12_022: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_002: [ IoTHubDeviceTwin_GetTwin and IoTHubDeviceTwin_UpdateTwin shall execute the HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_023: [ IoTHubDeviceTwin_GetTwin shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_030: [ Otherwise IoTHubDeviceTwin_GetTwin shall save the received deviceTwin to the out parameter and return with it ]*/
 TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_happy_path_status_code_400)
@@ -636,10 +711,6 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_happy_path_status_code_400)
     // arrange
     EXPECTED_CALL(BUFFER_new());
 
-    EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
     EXPECTED_CALL(HTTPHeaders_Alloc());
     EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
         .IgnoreArgument(1);
@@ -656,13 +727,9 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_happy_path_status_code_400)
 
     EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .CopyOutArgumentBuffer_statusCode(&httpStatusCodeBadRequest, sizeof(httpStatusCodeBadRequest))
         .SetReturn(HTTPAPIEX_OK);
@@ -670,20 +737,9 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_happy_path_status_code_400)
     EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -707,10 +763,6 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_non_happy_path)
 
     EXPECTED_CALL(BUFFER_new());
 
-    EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
     EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     EXPECTED_CALL(UniqueId_Generate(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
 
@@ -727,33 +779,18 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_non_happy_path)
 
     EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
         .SetReturn(HTTPAPIEX_OK);
 
     EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -779,17 +816,13 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_non_happy_path)
 
         /// act
         if (
-            (i != 7) && /*gballoc_malloc*/
-            (i != 13) && /*STRING_c_str*/
-            (i != 15) && /*HTTPHeaders_Free*/
-            (i != 16) && /*HTTPAPIEX_Destroy*/
-            (i != 17) && /*HTTPAPIEX_SAS_Destroy*/
-            (i != 18) && /*STRING_delete*/
-            (i != 19) && /*STRING_delete*/
-            (i != 20) && /*STRING_delete*/
-            (i != 21) && /*BUFFER_u_char*/
-            (i != 22) && /*mallocAndStrcpy_s*/
-            (i != 23)    /*BUFFER_delete*/
+            (i != 8) &&  /*gballoc_free*/
+            (i != 9) &&  /*STRING_c_str*/
+            (i != 11) && /*STRING_delete*/
+            (i != 12) && /*HTTPHeaders_Free*/
+            (i != 13) && /*BUFFER_length*/
+            (i != 15) && /*BUFFER_u_char*/
+            (i != 16)    /*BUFFER_delete*/
             )
         {
             const char* deviceId = " ";
@@ -850,8 +883,7 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_return_NULL_if_input_parameter_deviceT
 /*Tests_SRS_IOTHUBDEVICETWIN_12_034: [ IoTHubDeviceTwin_UpdateTwin shall allocate memory for response buffer by calling BUFFER_new ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_039: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTP PATCH request using deviceTwinJson ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_040: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTP PATCH request using the createdfollowing HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-/*Tests_SRS_IOTHUBDEVICETWIN_12_041: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-/*Tests_SRS_IOTHUBDEVICETWIN_12_042: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_002: [ IoTHubDeviceTwin_GetTwin and IoTHubDeviceTwin_UpdateTwin shall execute the HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_043: [ IoTHubDeviceTwin_UpdateTwin shall execute the HTTP PATCH request by calling HTTPAPIEX_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_047: [ Otherwise IoTHubDeviceTwin_UpdateTwin shall save the received updated device twin to the out parameter and return with it ]*/
 TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_happy_path_status_code_200)
@@ -862,10 +894,6 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_happy_path_status_code_200)
 
     EXPECTED_CALL(BUFFER_new());
 
-    EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
     EXPECTED_CALL(HTTPHeaders_Alloc());
     EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
         .IgnoreArgument(1);
@@ -883,13 +911,9 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_happy_path_status_code_200)
 
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
         .SetReturn(HTTPAPIEX_OK);
@@ -897,20 +921,9 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_happy_path_status_code_200)
     EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -942,8 +955,7 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_happy_path_status_code_200)
 /*Tests_SRS_IOTHUBDEVICETWIN_12_034: [ IoTHubDeviceTwin_UpdateTwin shall allocate memory for response buffer by calling BUFFER_new ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_039: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTP PATCH request using deviceTwinJson ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_040: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTP PATCH request using the createdfollowing HTTP headers: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-/*Tests_SRS_IOTHUBDEVICETWIN_12_041: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-/*Tests_SRS_IOTHUBDEVICETWIN_12_042: [ IoTHubDeviceTwin_UpdateTwin shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_002: [ IoTHubDeviceTwin_GetTwin and IoTHubDeviceTwin_UpdateTwin shall execute the HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_043: [ IoTHubDeviceTwin_UpdateTwin shall execute the HTTP PATCH request by calling HTTPAPIEX_ExecuteRequest ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_047: [ Otherwise IoTHubDeviceTwin_UpdateTwin shall save the received updated device twin to the out parameter and return with it ]*/
 TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_happy_path_status_code_400)
@@ -954,10 +966,6 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_happy_path_status_code_400)
 
     EXPECTED_CALL(BUFFER_new());
 
-    EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
     EXPECTED_CALL(HTTPHeaders_Alloc());
     EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
         .IgnoreArgument(1);
@@ -975,13 +983,9 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_happy_path_status_code_400)
 
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .CopyOutArgumentBuffer_statusCode(&httpStatusCodeBadRequest, sizeof(httpStatusCodeBadRequest))
         .SetReturn(HTTPAPIEX_OK);
@@ -989,20 +993,9 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_happy_path_status_code_400)
     EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
     EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -1035,10 +1028,6 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_non_happy_path)
 
     EXPECTED_CALL(BUFFER_new());
 
-    EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-    EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
     EXPECTED_CALL(HTTPHeaders_Alloc());
     EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
         .IgnoreArgument(1);
@@ -1056,13 +1045,9 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_non_happy_path)
 
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
 
-    EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
         .SetReturn(HTTPAPIEX_OK);
@@ -1070,20 +1055,9 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_non_happy_path)
     EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
 
     EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -1113,20 +1087,14 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_non_happy_path)
 
         /// act
         if (
-            (i != 7)  && /*gballoc_malloc*/
-            (i != 8)  && /*UniqueId_Generate*/
-            (i != 13) && /*gballoc_free*/
-            (i != 16) && /*STRING_c_str*/
-            (i != 18) && /*STRING_delete*/
-            (i != 19) && /*STRING_delete*/
-            (i != 20) && /*STRING_delete*/
-            (i != 21) && /*BUFFER_u_char*/
-            (i != 22) && /*mallocAndStrcpy_s*/
-            (i != 23) && /*BUFFER_delete*/
-            (i != 24) && /*BUFFER_delete*/
-            (i != 25) && /*BUFFER_delete*/
-            (i != 27) && /*BUFFER_delete*/
-            (i != 28)    /*BUFFER_delete*/
+            (i != 10) && /*gballoc_free*/
+            (i != 11) && /*STRING_c_str*/
+            (i != 13) && /*STRING_delete*/
+            (i != 14) && /*HTTPHeaders_Free*/
+            (i != 15) && /*BUFFER_length*/
+            (i != 17) && /*BUFFER_u_char*/
+            (i != 18) && /*BUFFER_delete*/
+            (i != 19)    /*BUFFER_delete*/
             )
         {
             const char* deviceId = " ";
@@ -1142,4 +1110,204 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwin_non_happy_path)
     umock_c_negative_tests_deinit();
 }
 
+/*Tests_SRS_IOTHUBDEVICETWIN_41_004: [ If serviceClientDeviceTwinHandle, sqlQuery or queryCallback is NULL, or pageSize is 0 or greater than 1000, IoTHubDeviceTwin_Query shall fail and return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Query_return_INVALID_ARG_if_input_parameter_is_NULL)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_DEVICE_TWIN_RESULT result1 = IoTHubDeviceTwin_Query(NULL, TEST_QUERY, 100, test_query_callback, NULL);
+    IOTHUB_DEVICE_TWIN_RESULT result2 = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, NULL, 100, test_query_callback, NULL);
+    IOTHUB_DEVICE_TWIN_RESULT result3 = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 100, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_004: [ If serviceClientDeviceTwinHandle, sqlQuery or queryCallback is NULL, or pageSize is 0 or greater than 1000, IoTHubDeviceTwin_Query shall fail and return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Query_return_INVALID_ARG_if_pageSize_is_out_of_range)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_DEVICE_TWIN_RESULT result1 = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 0, test_query_callback, NULL);
+    IOTHUB_DEVICE_TWIN_RESULT result2 = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 1001, test_query_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_005: [ IoTHubDeviceTwin_Query shall send the query as an HTTP POST request to url/devices/query ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_006: [ IoTHubDeviceTwin_Query shall create the request body {"query":"sqlQuery"}, escaping the quotes, backslashes and control characters of sqlQuery ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_007: [ IoTHubDeviceTwin_Query shall add the Authorization, Request-Id, User-Agent and Content-Type headers and x-ms-max-item-count=pageSize to every request, and x-ms-continuation with the continuation token of the previous page to every request but the first ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_008: [ IoTHubDeviceTwin_Query shall execute every request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequestWithResponseHeaders ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_011: [ IoTHubDeviceTwin_Query shall walk each page as a JSON array without building a document tree, and shall invoke queryCallback with a NUL-terminated copy of each element of the array, one at a time ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Query_happy_path_single_page)
+{
+    ///arrange
+    register_twin_query_hooks();
+    g_query_pages[0] = "[]";
+    g_query_page_count = 1;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Alloc());
+    EXPECTED_CALL(BUFFER_new());
+
+    EXPECTED_CALL(HTTPHeaders_Alloc());
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(UniqueId_Generate(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_REQUEST_ID, TEST_HTTP_HEADER_VAL_REQUEST_ID))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_USER_AGENT, IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_ACCEPT, TEST_HTTP_HEADER_VAL_ACCEPT))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "x-ms-max-item-count", "100"))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(8);
+    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "x-ms-continuation"))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(gballoc_free(NULL));
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(NULL));
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    ///act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 100, test_query_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_query_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    unregister_twin_query_hooks();
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_007: [ IoTHubDeviceTwin_Query shall add the Authorization, Request-Id, User-Agent and Content-Type headers and x-ms-max-item-count=pageSize to every request, and x-ms-continuation with the continuation token of the previous page to every request but the first ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_011: [ IoTHubDeviceTwin_Query shall walk each page as a JSON array without building a document tree, and shall invoke queryCallback with a NUL-terminated copy of each element of the array, one at a time ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_014: [ IoTHubDeviceTwin_Query shall keep requesting pages while the response carries an x-ms-continuation header, and shall return IOTHUB_DEVICE_TWIN_OK after the last page ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Query_follows_the_continuation_token)
+{
+    ///arrange
+    register_twin_query_hooks();
+
+    ///act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 100, test_query_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, g_query_page_index);
+    ASSERT_ARE_EQUAL(size_t, 3, g_query_callback_count);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), TEST_CONTINUATION_TOKEN));
+
+    ///cleanup
+    unregister_twin_query_hooks();
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_013: [ If queryCallback returns false then IoTHubDeviceTwin_Query shall stop without requesting further pages and return IOTHUB_DEVICE_TWIN_OK ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Query_stops_when_the_callback_returns_false)
+{
+    ///arrange
+    register_twin_query_hooks();
+    g_query_callback_stop_after = 1;
+
+    ///act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 100, test_query_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_query_page_index);
+    ASSERT_ARE_EQUAL(size_t, 1, g_query_callback_count);
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "HTTPHeaders_FindHeaderValue"));
+
+    ///cleanup
+    unregister_twin_query_hooks();
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_009: [ If the request fails IoTHubDeviceTwin_Query shall return IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR, and if the HTTP status code is not 200 it shall return IOTHUB_DEVICE_TWIN_ERROR ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Query_return_ERROR_if_status_code_is_not_200)
+{
+    ///arrange
+    register_twin_query_hooks();
+    g_query_status_code = httpStatusCodeBadRequest;
+
+    ///act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 100, test_query_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_query_callback_count);
+
+    ///cleanup
+    unregister_twin_query_hooks();
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_009: [ If the request fails IoTHubDeviceTwin_Query shall return IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR, and if the HTTP status code is not 200 it shall return IOTHUB_DEVICE_TWIN_ERROR ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Query_return_HTTPAPI_ERROR_if_the_request_fails)
+{
+    ///arrange
+    register_twin_query_hooks();
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders, HTTPAPIEX_ERROR);
+
+    ///act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 100, test_query_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_query_callback_count);
+
+    ///cleanup
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders, HTTPAPIEX_OK);
+    unregister_twin_query_hooks();
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_012: [ If a page is not a well-formed JSON array then IoTHubDeviceTwin_Query shall fail and return IOTHUB_DEVICE_TWIN_ERROR ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Query_return_ERROR_if_the_page_is_malformed)
+{
+    ///arrange
+    register_twin_query_hooks();
+    g_query_pages[0] = "{\"deviceId\":\"d1\"}";
+
+    ///act
+    IOTHUB_DEVICE_TWIN_RESULT result1 = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 100, test_query_callback, NULL);
+    g_query_pages[0] = "[{\"deviceId\":\"d1\"}";
+    g_query_page_index = 0;
+    IOTHUB_DEVICE_TWIN_RESULT result2 = IoTHubDeviceTwin_Query(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, TEST_QUERY, 100, test_query_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_ERROR, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_TWIN_ERROR, result2);
+    ASSERT_ARE_EQUAL(size_t, 0, g_query_callback_count);
+
+    ///cleanup
+    unregister_twin_query_hooks();
+}
+
 END_TEST_SUITE(iothub_devicetwin_ut)
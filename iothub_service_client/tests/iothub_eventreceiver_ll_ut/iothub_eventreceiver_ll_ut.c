@@ -0,0 +1,1071 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t l = strlen(source);
+    *destination = (char*)my_gballoc_malloc(l + 1);
+    strcpy(*destination, source);
+    return 0;
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/tlsio.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/xio.h"
+
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/session.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/messaging.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+#include "azure_uamqp_c/sasl_mechanism.h"
+#include "azure_uamqp_c/saslclientio.h"
+#include "azure_uamqp_c/sasl_plain.h"
+
+#include "uamqp_messaging.h"
+#include "iothub_message.h"
+
+#undef ENABLE_MOCKS
+
+#include "iothub_eventreceiver_ll.h"
+#include "iothub_service_client_auth.h"
+
+TEST_DEFINE_ENUM_TYPE(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_RESULT_VALUES);
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+typedef struct LIST_ITEM_INSTANCE_TAG
+{
+    const void* item;
+    void* next;
+} LIST_ITEM_INSTANCE;
+
+typedef struct SINGLYLINKEDLIST_INSTANCE_TAG
+{
+    LIST_ITEM_INSTANCE* head;
+} LIST_INSTANCE;
+
+static SINGLYLINKEDLIST_HANDLE my_list_create(void)
+{
+    LIST_INSTANCE* result = (LIST_INSTANCE*)malloc(sizeof(LIST_INSTANCE));
+    if (result != NULL)
+    {
+        result->head = NULL;
+    }
+    return result;
+}
+
+static void my_list_destroy(SINGLYLINKEDLIST_HANDLE list)
+{
+    LIST_INSTANCE* list_instance = (LIST_INSTANCE*)list;
+
+    while (list_instance->head != NULL)
+    {
+        LIST_ITEM_INSTANCE* current_item = list_instance->head;
+        list_instance->head = (LIST_ITEM_INSTANCE*)current_item->next;
+        free(current_item);
+    }
+    free(list_instance);
+}
+
+static LIST_ITEM_HANDLE my_list_add(SINGLYLINKEDLIST_HANDLE list, const void* item)
+{
+    LIST_INSTANCE* list_instance = (LIST_INSTANCE*)list;
+    LIST_ITEM_INSTANCE* result = (LIST_ITEM_INSTANCE*)malloc(sizeof(LIST_ITEM_INSTANCE));
+
+    result->next = NULL;
+    result->item = item;
+
+    if (list_instance->head == NULL)
+    {
+        list_instance->head = result;
+    }
+    else
+    {
+        LIST_ITEM_INSTANCE* current = list_instance->head;
+        while (current->next != NULL)
+        {
+            current = (LIST_ITEM_INSTANCE*)current->next;
+        }
+        current->next = result;
+    }
+    return result;
+}
+
+static int my_list_remove(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE item)
+{
+    LIST_INSTANCE* list_instance = (LIST_INSTANCE*)list;
+    LIST_ITEM_INSTANCE* previous = NULL;
+    LIST_ITEM_INSTANCE* current = list_instance->head;
+
+    while ((current != NULL) && (current != (LIST_ITEM_INSTANCE*)item))
+    {
+        previous = current;
+        current = (LIST_ITEM_INSTANCE*)current->next;
+    }
+    if (current != NULL)
+    {
+        if (previous == NULL)
+        {
+            list_instance->head = (LIST_ITEM_INSTANCE*)current->next;
+        }
+        else
+        {
+            previous->next = current->next;
+        }
+        free(current);
+    }
+    return (current != NULL) ? 0 : 1;
+}
+
+static LIST_ITEM_HANDLE my_list_get_head_item(SINGLYLINKEDLIST_HANDLE list)
+{
+    return ((LIST_INSTANCE*)list)->head;
+}
+
+static LIST_ITEM_HANDLE my_list_get_next_item(LIST_ITEM_HANDLE item_handle)
+{
+    return (LIST_ITEM_HANDLE)((LIST_ITEM_INSTANCE*)item_handle)->next;
+}
+
+static const void* my_list_item_get_value(LIST_ITEM_HANDLE item_handle)
+{
+    return ((LIST_ITEM_INSTANCE*)item_handle)->item;
+}
+
+static ON_MESSAGE_RECEIVED g_on_message_received;
+static const void* g_on_message_received_context;
+
+static int my_messagereceiver_open(MESSAGE_RECEIVER_HANDLE message_receiver, ON_MESSAGE_RECEIVED on_message_received, const void* callback_context)
+{
+    (void)message_receiver;
+    g_on_message_received = on_message_received;
+    g_on_message_received_context = callback_context;
+    return 0;
+}
+
+static const IOTHUB_MESSAGE_HANDLE TEST_IOTHUB_MESSAGE_HANDLE = (IOTHUB_MESSAGE_HANDLE)0x4242;
+
+static int my_IoTHubMessage_CreateFromUamqpMessage(MESSAGE_HANDLE uamqp_message, IOTHUB_MESSAGE_HANDLE* iothubclient_message)
+{
+    (void)uamqp_message;
+    *iothubclient_message = TEST_IOTHUB_MESSAGE_HANDLE;
+    return 0;
+}
+
+static const AMQP_VALUE TEST_ANNOTATIONS = (AMQP_VALUE)0x5001;
+static const AMQP_VALUE TEST_ANNOTATION_KEY = (AMQP_VALUE)0x5002;
+static const AMQP_VALUE TEST_ANNOTATION_VALUE = (AMQP_VALUE)0x5003;
+static const char* TEST_OFFSET = "4711";
+static const char* g_annotation_key_name;
+
+static int my_message_get_message_annotations(MESSAGE_HANDLE message, annotations* message_annotations)
+{
+    (void)message;
+    *message_annotations = TEST_ANNOTATIONS;
+    return 0;
+}
+
+static int my_amqpvalue_get_map_pair_count(AMQP_VALUE map, uint32_t* pair_count)
+{
+    (void)map;
+    *pair_count = 1;
+    return 0;
+}
+
+static int my_amqpvalue_get_map_key_value_pair(AMQP_VALUE map, uint32_t index, AMQP_VALUE* key, AMQP_VALUE* value)
+{
+    (void)map;
+    (void)index;
+    *key = TEST_ANNOTATION_KEY;
+    *value = TEST_ANNOTATION_VALUE;
+    return 0;
+}
+
+static int my_amqpvalue_get_symbol(AMQP_VALUE value, const char** symbol_value)
+{
+    (void)value;
+    *symbol_value = g_annotation_key_name;
+    return 0;
+}
+
+static int my_amqpvalue_get_string(AMQP_VALUE value, const char** string_value)
+{
+    (void)value;
+    *string_value = TEST_OFFSET;
+    return 0;
+}
+
+static size_t g_event_count;
+static IOTHUB_MESSAGE_HANDLE g_event_message;
+static char g_event_partition_id[16];
+static char g_event_offset[16];
+
+static void test_on_event_received(void* context, IOTHUB_MESSAGE_HANDLE message, const IOTHUB_EVENT_INFO* eventInfo)
+{
+    (void)context;
+    g_event_count++;
+    g_event_message = message;
+    (void)strcpy(g_event_partition_id, eventInfo->partitionId);
+    (void)strcpy(g_event_offset, (eventInfo->offset == NULL) ? "" : eventInfo->offset);
+}
+
+static size_t g_checkpoint_count;
+static char g_checkpoint_partition_id[16];
+static char g_checkpoint_offset[16];
+
+static void test_on_checkpoint(void* context, const char* partitionId, const char* offset, int64_t sequenceNumber)
+{
+    (void)context;
+    (void)sequenceNumber;
+    g_checkpoint_count++;
+    (void)strcpy(g_checkpoint_partition_id, partitionId);
+    (void)strcpy(g_checkpoint_offset, offset);
+}
+
+static const SASL_MECHANISM_INTERFACE_DESCRIPTION* TEST_SASL_MECHANISM_INTERFACE_DESCRIPTION = (const SASL_MECHANISM_INTERFACE_DESCRIPTION*)0x4141;
+static const SASL_MECHANISM_HANDLE TEST_SASL_MECHANISM_HANDLE = (SASL_MECHANISM_HANDLE)0x4343;
+static const IO_INTERFACE_DESCRIPTION* TEST_IO_INTERFACE_DESCRIPTION = (const IO_INTERFACE_DESCRIPTION*)0x4444;
+static const XIO_HANDLE TEST_XIO_HANDLE = (XIO_HANDLE)0x4545;
+static const CONNECTION_HANDLE TEST_CONNECTION_HANDLE = (CONNECTION_HANDLE)0x4646;
+static const SESSION_HANDLE TEST_SESSION_HANDLE = (SESSION_HANDLE)0x4747;
+static const AMQP_VALUE TEST_AMQP_VALUE = (AMQP_VALUE)0x4848;
+static const LINK_HANDLE TEST_LINK_HANDLE = (LINK_HANDLE)0x4949;
+static const SOURCE_HANDLE TEST_SOURCE_HANDLE = (SOURCE_HANDLE)0x4A4A;
+static const MESSAGE_RECEIVER_HANDLE TEST_MESSAGE_RECEIVER_HANDLE = (MESSAGE_RECEIVER_HANDLE)0x4B4B;
+static const MESSAGE_HANDLE TEST_MESSAGE_HANDLE = (MESSAGE_HANDLE)0x4C4C;
+
+static char* TEST_HOSTNAME = "theHostName";
+static char* TEST_IOTHUBNAME = "theIotHubName";
+static char* TEST_IOTHUBSUFFIX = "theIotHubSuffix";
+static char* TEST_SHAREDACCESSKEY = "theSharedAccessKey";
+static char* TEST_SHAREDACCESSKEYNAME = "theSharedAccessKeyName";
+
+static const char* TEST_EVENTHUB_HOSTNAME = "theEventHubHostName.servicebus.windows.net";
+static const char* TEST_EVENTHUB_NAME = "theEventHubName";
+static const char* TEST_CONSUMER_GROUP = "theConsumerGroup";
+static const char* TEST_PARTITION_ID = "3";
+static const char* TEST_OTHER_PARTITION_ID = "4";
+static const char* TEST_PARTITION_ADDRESS = "amqps://theEventHubHostName.servicebus.windows.net/theEventHubName/ConsumerGroups/theConsumerGroup/Partitions/3";
+static const char* TEST_PARTITION_LINK_NAME = "eventreceiver-link-3";
+static const char* TEST_OFFSET_FILTER = "amqp.annotation.x-opt-offset > '4711'";
+static const char* TEST_LATEST_FILTER = "amqp.annotation.x-opt-offset > '@latest'";
+
+static IOTHUB_SERVICE_CLIENT_AUTH TEST_IOTHUB_SERVICE_CLIENT_AUTH;
+static IOTHUB_SERVICE_CLIENT_AUTH_HANDLE TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_AUTH;
+
+static void setExpectedCallsForOpenConnection(void)
+{
+    STRICT_EXPECTED_CALL(saslplain_get_interface());
+    STRICT_EXPECTED_CALL(saslmechanism_create(TEST_SASL_MECHANISM_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(xio_create(TEST_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(saslclientio_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(connection_create(TEST_XIO_HANDLE, TEST_EVENTHUB_HOSTNAME, IGNORED_PTR_ARG, NULL, NULL))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(session_create(TEST_CONNECTION_HANDLE, NULL, NULL));
+    STRICT_EXPECTED_CALL(session_set_incoming_window(TEST_SESSION_HANDLE, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(session_set_outgoing_window(TEST_SESSION_HANDLE, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+}
+
+static void setExpectedCallsForOpenPartitionLink(const char* filter, uint32_t prefetchCount)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(amqpvalue_create_map());
+    STRICT_EXPECTED_CALL(amqpvalue_create_symbol("apache.org:selector-filter:string"));
+    STRICT_EXPECTED_CALL(amqpvalue_create_symbol("apache.org:selector-filter:string"));
+    STRICT_EXPECTED_CALL(amqpvalue_create_string(filter));
+    STRICT_EXPECTED_CALL(amqpvalue_create_described(TEST_AMQP_VALUE, TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_set_map_value(TEST_AMQP_VALUE, TEST_AMQP_VALUE, TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(source_create());
+    STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_PARTITION_ADDRESS));
+    STRICT_EXPECTED_CALL(source_set_address(TEST_SOURCE_HANDLE, TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(source_set_filter(TEST_SOURCE_HANDLE, TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_create_source(TEST_SOURCE_HANDLE));
+    STRICT_EXPECTED_CALL(source_destroy(TEST_SOURCE_HANDLE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(messaging_create_target(TEST_PARTITION_LINK_NAME));
+    STRICT_EXPECTED_CALL(link_create(TEST_SESSION_HANDLE, TEST_PARTITION_LINK_NAME, role_receiver, TEST_AMQP_VALUE, TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(link_set_rcv_settle_mode(TEST_LINK_HANDLE, receiver_settle_mode_first));
+    STRICT_EXPECTED_CALL(link_set_snd_settle_mode(TEST_LINK_HANDLE, sender_settle_mode_settled));
+    if (prefetchCount != 0)
+    {
+        STRICT_EXPECTED_CALL(link_set_max_link_credit(TEST_LINK_HANDLE, prefetchCount));
+    }
+    STRICT_EXPECTED_CALL(messagereceiver_create(TEST_LINK_HANDLE, NULL, NULL));
+    STRICT_EXPECTED_CALL(messagereceiver_open(TEST_MESSAGE_RECEIVER_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+}
+
+static IOTHUB_EVENT_RECEIVER_LL_HANDLE createOpenedReceiver(void)
+{
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE result = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, TEST_CONSUMER_GROUP);
+    (void)IoTHubEventReceiver_LL_OpenPartition(result, TEST_PARTITION_ID, TEST_OFFSET, test_on_event_received, NULL);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothub_eventreceiver_ll_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CONNECTION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SOURCE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_RECEIVER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SASL_MECHANISM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(filter_set, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(annotations, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(fields, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_ATTACHED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_NEW_ENDPOINT, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_RECEIVER_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(role, int);
+    REGISTER_UMOCK_ALIAS_TYPE(sender_settle_mode, int);
+    REGISTER_UMOCK_ALIAS_TYPE(receiver_settle_mode, uint8_t);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_TYPE, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_create, my_list_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_destroy, my_list_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, my_list_add);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, my_list_remove);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, my_list_get_head_item);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, my_list_get_next_item);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, my_list_item_get_value);
+
+    REGISTER_GLOBAL_MOCK_RETURN(saslplain_get_interface, TEST_SASL_MECHANISM_INTERFACE_DESCRIPTION);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(saslplain_get_interface, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(saslmechanism_create, TEST_SASL_MECHANISM_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(saslmechanism_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_IO_INTERFACE_DESCRIPTION);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(platform_get_default_tlsio, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(saslclientio_get_interface_description, TEST_IO_INTERFACE_DESCRIPTION);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(saslclientio_get_interface_description, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_create, TEST_XIO_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(xio_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(connection_create, TEST_CONNECTION_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(connection_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(session_create, TEST_SESSION_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(session_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(session_set_incoming_window, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(session_set_incoming_window, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(session_set_outgoing_window, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(session_set_outgoing_window, 1);
+
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_map, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_map, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_symbol, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_symbol, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_string, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_string, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_described, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_described, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_set_map_value, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_set_map_value, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(source_create, TEST_SOURCE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(source_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(source_set_address, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(source_set_address, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(source_set_filter, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(source_set_filter, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_source, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_source, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(messaging_create_target, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(messaging_create_target, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(link_create, TEST_LINK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(link_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(link_set_rcv_settle_mode, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(link_set_rcv_settle_mode, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(link_set_snd_settle_mode, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(link_set_snd_settle_mode, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(link_set_max_link_credit, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(link_set_max_link_credit, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(messagereceiver_create, TEST_MESSAGE_RECEIVER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(messagereceiver_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_open, my_messagereceiver_open);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(messagereceiver_open, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(messaging_delivery_accepted, TEST_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_RETURN(messaging_delivery_rejected, TEST_AMQP_VALUE);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromUamqpMessage, my_IoTHubMessage_CreateFromUamqpMessage);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromUamqpMessage, 1);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_message_annotations, my_message_get_message_annotations);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_type, AMQP_TYPE_MAP);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_map_pair_count, my_amqpvalue_get_map_pair_count);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_map_key_value_pair, my_amqpvalue_get_map_key_value_pair);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_symbol, my_amqpvalue_get_symbol);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_string, my_amqpvalue_get_string);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.hostname = TEST_HOSTNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubName = TEST_IOTHUBNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubSuffix = TEST_IOTHUBSUFFIX;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = TEST_SHAREDACCESSKEY;
+
+    g_on_message_received = NULL;
+    g_on_message_received_context = NULL;
+    g_annotation_key_name = "x-opt-offset";
+    g_event_count = 0;
+    g_event_message = NULL;
+    g_event_partition_id[0] = '\0';
+    g_event_offset[0] = '\0';
+    g_checkpoint_count = 0;
+    g_checkpoint_partition_id[0] = '\0';
+    g_checkpoint_offset[0] = '\0';
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    umock_c_negative_tests_deinit();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_001: [ If serviceClientHandle, eventHubHostName or eventHubName is NULL IoTHubEventReceiver_LL_Create shall return NULL ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_Create_return_null_if_input_parameter_is_NULL)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE result1 = IoTHubEventReceiver_LL_Create(NULL, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, NULL);
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE result2 = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, NULL, TEST_EVENTHUB_NAME, NULL);
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE result3 = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, NULL, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_002: [ If the keyName or sharedAccessKey member of serviceClientHandle is NULL IoTHubEventReceiver_LL_Create shall return NULL ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_Create_return_null_if_auth_member_is_NULL)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = NULL;
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE result1 = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, NULL);
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = NULL;
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE result2 = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_003: [ IoTHubEventReceiver_LL_Create shall allocate memory for a new receiver and copy eventHubHostName, eventHubName, consumerGroup ($Default if NULL), sharedAccessKey and keyName by calling mallocAndStrcpy_s ] */
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_005: [ IoTHubEventReceiver_LL_Create shall create the list of partitions by calling singlylinkedlist_create ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_Create_happy_path)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_EVENTHUB_HOSTNAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_EVENTHUB_NAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "$Default"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEY))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEYNAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE result = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(result);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_004: [ If any of the above fails IoTHubEventReceiver_LL_Create shall free what it allocated and return NULL ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_Create_non_happy_path)
+{
+    ///arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_EVENTHUB_HOSTNAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_EVENTHUB_NAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONSUMER_GROUP))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEY))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEYNAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        ///act
+        IOTHUB_EVENT_RECEIVER_LL_HANDLE result = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, TEST_CONSUMER_GROUP);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+    }
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_006: [ If eventReceiverHandle is NULL IoTHubEventReceiver_LL_Destroy shall return, otherwise it shall close the receiver as IoTHubEventReceiver_LL_Close does and free its memory ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_Destroy_return_if_input_parameter_is_NULL)
+{
+    ///arrange
+
+    ///act
+    IoTHubEventReceiver_LL_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_007: [ If eventReceiverHandle is NULL IoTHubEventReceiver_LL_SetPrefetchCount shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG, otherwise it shall save prefetchCount for the partitions opened afterwards and return IOTHUB_EVENT_RECEIVER_OK ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_SetPrefetchCount_return_INVALID_ARG_if_input_parameter_is_NULL)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_RESULT result = IoTHubEventReceiver_LL_SetPrefetchCount(NULL, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_INVALID_ARG, result);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_007: [ If eventReceiverHandle is NULL IoTHubEventReceiver_LL_SetPrefetchCount shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG, otherwise it shall save prefetchCount for the partitions opened afterwards and return IOTHUB_EVENT_RECEIVER_OK ] */
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_014: [ IoTHubEventReceiver_LL_OpenPartition shall ask for presettled events by calling link_set_snd_settle_mode with sender_settle_mode_settled, and set the prefetch count as maximum link credit with link_set_max_link_credit if it is not 0 ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_SetPrefetchCount_sets_the_link_credit_of_the_partitions_opened_afterwards)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, TEST_CONSUMER_GROUP);
+    IOTHUB_EVENT_RECEIVER_RESULT setResult = IoTHubEventReceiver_LL_SetPrefetchCount(handle, 300);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    setExpectedCallsForOpenConnection();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_PARTITION_ID))
+        .IgnoreArgument(1);
+    setExpectedCallsForOpenPartitionLink(TEST_LATEST_FILTER, 300);
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_RESULT result = IoTHubEventReceiver_LL_OpenPartition(handle, TEST_PARTITION_ID, NULL, test_on_event_received, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_OK, setResult);
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_008: [ If eventReceiverHandle is NULL or checkpointInterval is 0 IoTHubEventReceiver_LL_SetCheckpointCallback shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_SetCheckpointCallback_return_INVALID_ARG_if_input_parameter_is_invalid)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, TEST_CONSUMER_GROUP);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_RESULT result1 = IoTHubEventReceiver_LL_SetCheckpointCallback(NULL, test_on_checkpoint, NULL, 10);
+    IOTHUB_EVENT_RECEIVER_RESULT result2 = IoTHubEventReceiver_LL_SetCheckpointCallback(handle, test_on_checkpoint, NULL, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_011: [ If eventReceiverHandle, partitionId or eventCallback is NULL IoTHubEventReceiver_LL_OpenPartition shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG, and if the partition is already open it shall return IOTHUB_EVENT_RECEIVER_PARTITION_EXIST ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_OpenPartition_return_INVALID_ARG_if_input_parameter_is_NULL)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, TEST_CONSUMER_GROUP);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_RESULT result1 = IoTHubEventReceiver_LL_OpenPartition(NULL, TEST_PARTITION_ID, NULL, test_on_event_received, NULL);
+    IOTHUB_EVENT_RECEIVER_RESULT result2 = IoTHubEventReceiver_LL_OpenPartition(handle, NULL, NULL, test_on_event_received, NULL);
+    IOTHUB_EVENT_RECEIVER_RESULT result3 = IoTHubEventReceiver_LL_OpenPartition(handle, TEST_PARTITION_ID, NULL, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_010: [ The first IoTHubEventReceiver_LL_OpenPartition shall open the AMQP connection by creating a SASL PLAIN mechanism with keyName and sharedAccessKey, a TLS IO to eventHubHostName on port 5671, a SASL IO, a connection and a session ] */
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_012: [ IoTHubEventReceiver_LL_OpenPartition shall create a receiver link named eventreceiver-link-[partitionId] with source amqps://[eventHubHostName]/[eventHubName]/ConsumerGroups/[consumerGroup]/Partitions/[partitionId] ] */
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_013: [ IoTHubEventReceiver_LL_OpenPartition shall filter the link source with an apache.org:selector-filter:string of amqp.annotation.x-opt-offset > 'startOffset', or > '@latest' if startOffset is NULL ] */
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_015: [ IoTHubEventReceiver_LL_OpenPartition shall create and open a message receiver on the link by calling messagereceiver_create and messagereceiver_open ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_OpenPartition_happy_path)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, TEST_CONSUMER_GROUP);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    setExpectedCallsForOpenConnection();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_PARTITION_ID))
+        .IgnoreArgument(1);
+    setExpectedCallsForOpenPartitionLink(TEST_OFFSET_FILTER, 0);
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_RESULT result = IoTHubEventReceiver_LL_OpenPartition(handle, TEST_PARTITION_ID, TEST_OFFSET, test_on_event_received, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL((void*)g_on_message_received);
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_011: [ If eventReceiverHandle, partitionId or eventCallback is NULL IoTHubEventReceiver_LL_OpenPartition shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG, and if the partition is already open it shall return IOTHUB_EVENT_RECEIVER_PARTITION_EXIST ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_OpenPartition_return_PARTITION_EXIST_if_partition_is_open)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = createOpenedReceiver();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_RESULT result = IoTHubEventReceiver_LL_OpenPartition(handle, TEST_PARTITION_ID, NULL, test_on_event_received, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_PARTITION_EXIST, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_010: [ The first IoTHubEventReceiver_LL_OpenPartition shall open the AMQP connection by creating a SASL PLAIN mechanism with keyName and sharedAccessKey, a TLS IO to eventHubHostName on port 5671, a SASL IO, a connection and a session ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_OpenPartition_shares_the_connection_between_partitions)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = createOpenedReceiver();
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_RESULT result = IoTHubEventReceiver_LL_OpenPartition(handle, TEST_OTHER_PARTITION_ID, NULL, test_on_event_received, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_OK, result);
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "connection_create"));
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "[link_create("));
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_019: [ If any call fails IoTHubEventReceiver_LL_OpenPartition shall destroy what it created for the partition and return IOTHUB_EVENT_RECEIVER_ERROR ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_OpenPartition_non_happy_path)
+{
+    ///arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, TEST_CONSUMER_GROUP);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    setExpectedCallsForOpenConnection();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_PARTITION_ID))
+        .IgnoreArgument(1);
+    setExpectedCallsForOpenPartitionLink(TEST_OFFSET_FILTER, 0);
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        /*the list lookup, the frees and the destroys of the temporary AMQP values cannot fail*/
+        if ((i != 0) &&
+            (i != 27) && (i != 28) && (i != 29) && (i != 30) && (i != 31) && (i != 32) &&
+            (i != 39) && (i != 40) && (i != 41) && (i != 42))
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+
+            ///act
+            IOTHUB_EVENT_RECEIVER_RESULT result = IoTHubEventReceiver_LL_OpenPartition(handle, TEST_PARTITION_ID, TEST_OFFSET, test_on_event_received, NULL);
+
+            ///assert
+            ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_ERROR, result);
+
+            IoTHubEventReceiver_LL_Close(handle);
+        }
+    }
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_016: [ For every event received on a partition, IoTHubEventReceiver_LL_DoWork shall convert it with IoTHubMessage_CreateFromUamqpMessage and pass it with its event info to the eventCallback of the partition, then destroy it ] */
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_017: [ The event info shall hold the partitionId and the x-opt-offset, x-opt-sequence-number, x-opt-enqueued-time and iothub-connection-device-id message annotations of the event; missing annotations shall be left NULL or 0 ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_event_received_calls_the_event_callback)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = createOpenedReceiver();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromUamqpMessage(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(message_get_message_annotations(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(amqpvalue_get_type(TEST_ANNOTATIONS));
+    STRICT_EXPECTED_CALL(amqpvalue_get_map_pair_count(TEST_ANNOTATIONS, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(amqpvalue_get_map_key_value_pair(TEST_ANNOTATIONS, 0, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(amqpvalue_get_symbol(TEST_ANNOTATION_KEY, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(amqpvalue_get_string(TEST_ANNOTATION_VALUE, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_ANNOTATION_KEY));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_ANNOTATION_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_ANNOTATIONS));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_IOTHUB_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(messaging_delivery_accepted());
+
+    ///act
+    AMQP_VALUE result = g_on_message_received(g_on_message_received_context, TEST_MESSAGE_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_AMQP_VALUE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_event_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_MESSAGE_HANDLE, g_event_message);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PARTITION_ID, g_event_partition_id);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_OFFSET, g_event_offset);
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_016: [ For every event received on a partition, IoTHubEventReceiver_LL_DoWork shall convert it with IoTHubMessage_CreateFromUamqpMessage and pass it with its event info to the eventCallback of the partition, then destroy it ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_event_received_rejects_the_event_if_it_cannot_be_converted)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = createOpenedReceiver();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromUamqpMessage(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(messaging_delivery_rejected(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    (void)g_on_message_received(g_on_message_received_context, TEST_MESSAGE_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_event_count);
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_009: [ IoTHubEventReceiver_LL_SetCheckpointCallback shall save checkpointCallback, userContextCallback and checkpointInterval and return IOTHUB_EVENT_RECEIVER_OK ] */
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_018: [ After every checkpointInterval events of a partition, the checkpoint callback shall be called with the partitionId and the offset and sequence number of the last event ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_event_received_reports_a_checkpoint_every_checkpointInterval_events)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = createOpenedReceiver();
+    IOTHUB_EVENT_RECEIVER_RESULT setResult = IoTHubEventReceiver_LL_SetCheckpointCallback(handle, test_on_checkpoint, NULL, 2);
+
+    ///act
+    (void)g_on_message_received(g_on_message_received_context, TEST_MESSAGE_HANDLE);
+    size_t checkpointsAfterFirstEvent = g_checkpoint_count;
+    (void)g_on_message_received(g_on_message_received_context, TEST_MESSAGE_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_OK, setResult);
+    ASSERT_ARE_EQUAL(size_t, 0, checkpointsAfterFirstEvent);
+    ASSERT_ARE_EQUAL(size_t, 1, g_checkpoint_count);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PARTITION_ID, g_checkpoint_partition_id);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_OFFSET, g_checkpoint_offset);
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_021: [ If eventReceiverHandle or partitionId is NULL IoTHubEventReceiver_LL_ClosePartition shall return IOTHUB_EVENT_RECEIVER_INVALID_ARG, and if the partition is not open it shall return IOTHUB_EVENT_RECEIVER_PARTITION_NOT_FOUND ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_ClosePartition_return_error_if_input_parameter_is_invalid)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = createOpenedReceiver();
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_RESULT result1 = IoTHubEventReceiver_LL_ClosePartition(NULL, TEST_PARTITION_ID);
+    IOTHUB_EVENT_RECEIVER_RESULT result2 = IoTHubEventReceiver_LL_ClosePartition(handle, NULL);
+    IOTHUB_EVENT_RECEIVER_RESULT result3 = IoTHubEventReceiver_LL_ClosePartition(handle, TEST_OTHER_PARTITION_ID);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_PARTITION_NOT_FOUND, result3);
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_020: [ Closing a partition shall destroy its message receiver and link, and report a checkpoint for the events delivered since the last one ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_ClosePartition_happy_path)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = createOpenedReceiver();
+    (void)IoTHubEventReceiver_LL_SetCheckpointCallback(handle, test_on_checkpoint, NULL, 100);
+    (void)g_on_message_received(g_on_message_received_context, TEST_MESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(messagereceiver_destroy(TEST_MESSAGE_RECEIVER_HANDLE));
+    STRICT_EXPECTED_CALL(link_destroy(TEST_LINK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IOTHUB_EVENT_RECEIVER_RESULT result = IoTHubEventReceiver_LL_ClosePartition(handle, TEST_PARTITION_ID);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_EVENT_RECEIVER_RESULT, IOTHUB_EVENT_RECEIVER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_checkpoint_count);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_OFFSET, g_checkpoint_offset);
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_022: [ IoTHubEventReceiver_LL_Close shall close every open partition, then destroy the session, connection, SASL IO, TLS IO and SASL mechanism ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_Close_happy_path)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = createOpenedReceiver();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(messagereceiver_destroy(TEST_MESSAGE_RECEIVER_HANDLE));
+    STRICT_EXPECTED_CALL(link_destroy(TEST_LINK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(session_destroy(TEST_SESSION_HANDLE));
+    STRICT_EXPECTED_CALL(connection_destroy(TEST_CONNECTION_HANDLE));
+    STRICT_EXPECTED_CALL(xio_destroy(TEST_XIO_HANDLE));
+    STRICT_EXPECTED_CALL(xio_destroy(TEST_XIO_HANDLE));
+    STRICT_EXPECTED_CALL(saslmechanism_destroy(TEST_SASL_MECHANISM_HANDLE));
+
+    ///act
+    IoTHubEventReceiver_LL_Close(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_023: [ If eventReceiverHandle is NULL or no partition was opened IoTHubEventReceiver_LL_DoWork shall return, otherwise it shall call connection_dowork ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_DoWork_return_if_no_partition_was_opened)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = IoTHubEventReceiver_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE, TEST_EVENTHUB_HOSTNAME, TEST_EVENTHUB_NAME, TEST_CONSUMER_GROUP);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubEventReceiver_LL_DoWork(NULL);
+    IoTHubEventReceiver_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBEVENTRECEIVER_41_023: [ If eventReceiverHandle is NULL or no partition was opened IoTHubEventReceiver_LL_DoWork shall return, otherwise it shall call connection_dowork ] */
+TEST_FUNCTION(IoTHubEventReceiver_LL_DoWork_happy_path)
+{
+    ///arrange
+    IOTHUB_EVENT_RECEIVER_LL_HANDLE handle = createOpenedReceiver();
+
+    STRICT_EXPECTED_CALL(connection_dowork(TEST_CONNECTION_HANDLE));
+
+    ///act
+    IoTHubEventReceiver_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubEventReceiver_LL_Destroy(handle);
+}
+
+END_TEST_SUITE(iothub_eventreceiver_ll_ut)
@@ -0,0 +1,812 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t l = strlen(source);
+    *destination = (char*)my_gballoc_malloc(l + 1);
+    strcpy(*destination, source);
+    return 0;
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/uniqueid.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "parson.h"
+#include "iothub_sc_http_pool.h"
+
+MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
+MOCKABLE_FUNCTION(, const char*, json_object_get_string, const JSON_Object *, object, const char *, name);
+MOCKABLE_FUNCTION(, double, json_object_dotget_number, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, JSON_Object*, json_value_get_object, const JSON_Value *, value);
+MOCKABLE_FUNCTION(, char*, json_serialize_to_string, const JSON_Value*, value);
+MOCKABLE_FUNCTION(, void, json_free_serialized_string, char*, string);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_set_string, JSON_Object*, object, const char*, name, const char*, string);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_set_number, JSON_Object*, object, const char*, name, double, number);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_set_value, JSON_Object*, object, const char*, name, JSON_Value*, value);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_dotset_string, JSON_Object*, object, const char*, name, const char*, string);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_dotset_number, JSON_Object*, object, const char*, name, double, number);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_dotset_value, JSON_Object*, object, const char*, name, JSON_Value*, value);
+MOCKABLE_FUNCTION(, JSON_Value*, json_value_init_object);
+MOCKABLE_FUNCTION(, JSON_Value*, json_value_init_null);
+MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value *, value);
+
+#undef ENABLE_MOCKS
+
+#include "azure_c_shared_utility/strings.h"
+#include "iothub_jobs.h"
+#include "iothub_service_client_auth.h"
+
+TEST_DEFINE_ENUM_TYPE(HTTPAPI_RESULT, HTTPAPI_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPI_RESULT, HTTPAPI_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
+TEST_DEFINE_ENUM_TYPE(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(IOTHUB_JOB_STATUS, IOTHUB_JOB_STATUS_VALUES);
+TEST_DEFINE_ENUM_TYPE(IOTHUB_JOB_TYPE, IOTHUB_JOB_TYPE_VALUES);
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+static unsigned char* TEST_UNSIGNED_CHAR_PTR = (unsigned char*)"{\"jobId\":\"theJobId\"}";
+static char* TEST_CHAR_PTR = "aChar";
+static JSON_Value* TEST_JSON_VALUE = (JSON_Value*)0x5050;
+static JSON_Object* TEST_JSON_OBJECT = (JSON_Object*)0x5151;
+
+static const IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4646;
+
+static char* TEST_HOSTNAME = "theHostName";
+static char* TEST_IOTHUBNAME = "theIotHubName";
+static char* TEST_IOTHUBSUFFIX = "theIotHubSuffix";
+static char* TEST_SHAREDACCESSKEY = "theSharedAccessKey";
+static char* TEST_SHAREDACCESSKEYNAME = "theSharedAccessKeyName";
+
+static const char* TEST_JOB_ID = "theJobId";
+static const char* TEST_QUERY_CONDITION = "tags.building = '43'";
+static const char* TEST_TWIN_PATCH = "{\"properties\":{\"desired\":{\"fw\":\"1.2\"}}}";
+static const char* TEST_METHOD_NAME = "reboot";
+static const char* TEST_METHOD_PAYLOAD = "{\"delay\":10}";
+static const time_t TEST_START_TIME = 1500000000;
+static const char* TEST_START_TIME_STRING = "2017-07-14T02:40:00Z";
+static const unsigned int TEST_MAX_EXECUTION_TIME = 3600;
+static const unsigned int TEST_RESPONSE_TIMEOUT = 30;
+
+static const char* TEST_HTTP_HEADER_KEY_AUTHORIZATION = "Authorization";
+static const char* TEST_HTTP_HEADER_VAL_AUTHORIZATION = " ";
+static const char* TEST_HTTP_HEADER_KEY_REQUEST_ID = "Request-Id";
+static const char* TEST_HTTP_HEADER_KEY_USER_AGENT = "User-Agent";
+static const char* TEST_HTTP_HEADER_KEY_CONTENT_TYPE = "Content-Type";
+static const char* TEST_HTTP_HEADER_VAL_CONTENT_TYPE = "application/json; charset=utf-8";
+
+static const unsigned int httpStatusCodeOk = 200;
+static const unsigned int httpStatusCodeNotFound = 404;
+
+static IOTHUB_SERVICE_CLIENT_AUTH TEST_IOTHUB_SERVICE_CLIENT_AUTH;
+static IOTHUB_SERVICE_CLIENT_AUTH_HANDLE TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_AUTH;
+
+typedef struct IOTHUB_SERVICE_CLIENT_JOBS_TAG
+{
+    char* hostname;
+    char* sharedAccessKey;
+    char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
+} IOTHUB_SERVICE_CLIENT_JOBS;
+
+static IOTHUB_SERVICE_CLIENT_JOBS TEST_IOTHUB_SERVICE_CLIENT_JOBS;
+static IOTHUB_SERVICE_CLIENT_JOBS_HANDLE TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_JOBS;
+
+static char g_relative_path[256];
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    STRING_HANDLE STRING_construct_sprintf(const char* format, ...);
+
+    STRING_HANDLE STRING_construct_sprintf(const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        (void)vsnprintf(g_relative_path, sizeof(g_relative_path), format, args);
+        va_end(args);
+        return (STRING_HANDLE)my_gballoc_malloc(1);
+    }
+#ifdef __cplusplus
+}
+#endif
+
+static const char* my_STRING_c_str(STRING_HANDLE handle)
+{
+    (void)handle;
+    return g_relative_path;
+}
+
+static void my_STRING_delete(STRING_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static HTTP_HEADERS_HANDLE my_HTTPHeaders_Alloc(void)
+{
+    return (HTTP_HEADERS_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_HTTPHeaders_Free(HTTP_HEADERS_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static BUFFER_HANDLE my_BUFFER_new(void)
+{
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
+static BUFFER_HANDLE my_BUFFER_create(const unsigned char* source, size_t size)
+{
+    (void)source;
+    (void)size;
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_BUFFER_delete(BUFFER_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static const char* my_json_object_get_string(const JSON_Object* object, const char* name)
+{
+    const char* result;
+    (void)object;
+
+    if (strcmp(name, "jobId") == 0)
+    {
+        result = TEST_JOB_ID;
+    }
+    else if (strcmp(name, "type") == 0)
+    {
+        result = "scheduleUpdateTwin";
+    }
+    else if (strcmp(name, "status") == 0)
+    {
+        result = "running";
+    }
+    else
+    {
+        result = NULL;
+    }
+    return result;
+}
+
+static double my_json_object_dotget_number(const JSON_Object* object, const char* name)
+{
+    (void)object;
+    return (strcmp(name, "deviceJobStatistics.deviceCount") == 0) ? 200000 : 7;
+}
+
+static void free_job_members(IOTHUB_JOB* job)
+{
+    free((void*)job->jobId);
+    free((void*)job->failureReason);
+}
+
+static void set_expected_calls_for_send_request(HTTPAPI_REQUEST_TYPE requestType)
+{
+    EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(UniqueId_Generate(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_REQUEST_ID, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_USER_AGENT, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(BUFFER_new());
+    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, requestType, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk));
+
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(json_parse_string((const char*)TEST_UNSIGNED_CHAR_PTR));
+    STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "jobId"));
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "failureReason"));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_JOB_ID))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "type"));
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "status"));
+    STRICT_EXPECTED_CALL(json_object_dotget_number(TEST_JSON_OBJECT, "deviceJobStatistics.deviceCount"));
+    STRICT_EXPECTED_CALL(json_object_dotget_number(TEST_JSON_OBJECT, "deviceJobStatistics.succeededCount"));
+    STRICT_EXPECTED_CALL(json_object_dotget_number(TEST_JSON_OBJECT, "deviceJobStatistics.failedCount"));
+    STRICT_EXPECTED_CALL(json_object_dotget_number(TEST_JSON_OBJECT, "deviceJobStatistics.runningCount"));
+    STRICT_EXPECTED_CALL(json_object_dotget_number(TEST_JSON_OBJECT, "deviceJobStatistics.pendingCount"));
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+}
+
+static void set_expected_calls_for_create_job_json(const char* jobType)
+{
+    STRICT_EXPECTED_CALL(json_value_init_object());
+    STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "jobId", TEST_JOB_ID));
+    STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "type", jobType));
+    STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "queryCondition", TEST_QUERY_CONDITION));
+    STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "startTime", TEST_START_TIME_STRING));
+    STRICT_EXPECTED_CALL(json_object_set_number(TEST_JSON_OBJECT, "maxExecutionTimeInSeconds", (double)TEST_MAX_EXECUTION_TIME));
+}
+
+static void set_expected_calls_for_schedule_job(void)
+{
+    STRICT_EXPECTED_CALL(json_serialize_to_string(TEST_JSON_VALUE));
+    EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(json_free_serialized_string(TEST_CHAR_PTR));
+    set_expected_calls_for_send_request(HTTPAPI_REQUEST_PUT);
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+}
+
+BEGIN_TEST_SUITE(iothub_jobs_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_TYPE(HTTPAPI_RESULT, HTTPAPI_RESULT);
+    REGISTER_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT);
+    REGISTER_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT);
+    REGISTER_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE);
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SC_HTTP_POOL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(JSON_Value, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(JSON_Object, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(JSON_Status, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, 42);
+
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, my_STRING_c_str);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
+
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, my_BUFFER_new);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_new, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_create, my_BUFFER_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_u_char, TEST_UNSIGNED_CHAR_PTR);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_u_char, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_Alloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Free, my_HTTPHeaders_Free);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(UniqueId_Generate, UNIQUEID_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(UniqueId_Generate, UNIQUEID_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_Clone, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubScHttpPool_Clone, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_ExecuteRequest, HTTPAPIEX_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubScHttpPool_ExecuteRequest, HTTPAPIEX_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(json_value_init_object, TEST_JSON_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_init_object, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_value_init_null, TEST_JSON_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_init_null, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_value_get_object, TEST_JSON_OBJECT);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_get_object, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_parse_string, TEST_JSON_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_parse_string, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_serialize_to_string, TEST_CHAR_PTR);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_serialize_to_string, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(json_object_get_string, my_json_object_get_string);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_get_string, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(json_object_dotget_number, my_json_object_dotget_number);
+    REGISTER_GLOBAL_MOCK_RETURN(json_object_set_string, JSONSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_set_string, JSONFailure);
+    REGISTER_GLOBAL_MOCK_RETURN(json_object_set_number, JSONSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_set_number, JSONFailure);
+    REGISTER_GLOBAL_MOCK_RETURN(json_object_set_value, JSONSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_set_value, JSONFailure);
+    REGISTER_GLOBAL_MOCK_RETURN(json_object_dotset_string, JSONSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_dotset_string, JSONFailure);
+    REGISTER_GLOBAL_MOCK_RETURN(json_object_dotset_number, JSONSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_dotset_number, JSONFailure);
+    REGISTER_GLOBAL_MOCK_RETURN(json_object_dotset_value, JSONSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_dotset_value, JSONFailure);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.hostname = TEST_HOSTNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubName = TEST_IOTHUBNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubSuffix = TEST_IOTHUBSUFFIX;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = TEST_SHAREDACCESSKEY;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    TEST_IOTHUB_SERVICE_CLIENT_JOBS.hostname = TEST_HOSTNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_JOBS.sharedAccessKey = TEST_SHAREDACCESSKEY;
+    TEST_IOTHUB_SERVICE_CLIENT_JOBS.keyName = TEST_SHAREDACCESSKEYNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_JOBS.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    g_relative_path[0] = '\0';
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    umock_c_negative_tests_deinit();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_001: [ If the serviceClientHandle input parameter is NULL IoTHubJobs_Create shall return NULL ]*/
+TEST_FUNCTION(IoTHubJobs_Create_return_null_if_input_parameter_serviceClientHandle_is_NULL)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_SERVICE_CLIENT_JOBS_HANDLE result = IoTHubJobs_Create(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_002: [ If the hostname, keyName or sharedAccessKey member of the serviceClientHandle input parameter is NULL IoTHubJobs_Create shall return NULL ]*/
+TEST_FUNCTION(IoTHubJobs_Create_return_null_if_a_member_of_serviceClientHandle_is_NULL)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = NULL;
+
+    ///act
+    IOTHUB_SERVICE_CLIENT_JOBS_HANDLE result = IoTHubJobs_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_003: [ IoTHubJobs_Create shall allocate memory for a new IOTHUB_SERVICE_CLIENT_JOBS_HANDLE instance and copy hostname, sharedAccessKey and keyName by calling mallocAndStrcpy_s ]*/
+/*Tests_SRS_IOTHUBJOBS_41_004: [ IoTHubJobs_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none ]*/
+/*Tests_SRS_IOTHUBJOBS_41_006: [ If serviceClientJobsHandle is NULL IoTHubJobs_Destroy shall return, otherwise it shall release its reference to the HTTP connection pool and free the memory of the handle ]*/
+TEST_FUNCTION(IoTHubJobs_Create_and_Destroy_happy_path)
+{
+    ///arrange
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_HOSTNAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEY))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEYNAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    IOTHUB_SERVICE_CLIENT_JOBS_HANDLE result = IoTHubJobs_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(result);
+    IoTHubJobs_Destroy(result);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_005: [ If any of the above fails IoTHubJobs_Create shall free what it allocated and return NULL ]*/
+TEST_FUNCTION(IoTHubJobs_Create_non_happy_path)
+{
+    ///arrange
+    int umockc_result = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, umockc_result);
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_HOSTNAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEY))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEYNAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        ///arrange
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        ///act
+        IOTHUB_SERVICE_CLIENT_JOBS_HANDLE result = IoTHubJobs_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+    }
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_006: [ If serviceClientJobsHandle is NULL IoTHubJobs_Destroy shall return, otherwise it shall release its reference to the HTTP connection pool and free the memory of the handle ]*/
+TEST_FUNCTION(IoTHubJobs_Destroy_return_if_input_parameter_is_NULL)
+{
+    ///arrange
+
+    ///act
+    IoTHubJobs_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_007: [ If serviceClientJobsHandle, jobId, queryCondition, twinPatchJson, methodName or job is NULL the schedule functions shall return IOTHUB_JOBS_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubJobs_ScheduleTwinUpdate_return_INVALID_ARG_if_input_parameter_is_NULL)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    ///act
+    IOTHUB_JOBS_RESULT result1 = IoTHubJobs_ScheduleTwinUpdate(NULL, TEST_JOB_ID, TEST_QUERY_CONDITION, TEST_TWIN_PATCH, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+    IOTHUB_JOBS_RESULT result2 = IoTHubJobs_ScheduleTwinUpdate(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, NULL, TEST_QUERY_CONDITION, TEST_TWIN_PATCH, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+    IOTHUB_JOBS_RESULT result3 = IoTHubJobs_ScheduleTwinUpdate(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, NULL, TEST_TWIN_PATCH, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+    IOTHUB_JOBS_RESULT result4 = IoTHubJobs_ScheduleTwinUpdate(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, TEST_QUERY_CONDITION, NULL, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+    IOTHUB_JOBS_RESULT result5 = IoTHubJobs_ScheduleTwinUpdate(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, TEST_QUERY_CONDITION, TEST_TWIN_PATCH, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result4);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result5);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_008: [ IoTHubJobs_ScheduleTwinUpdate and IoTHubJobs_ScheduleDeviceMethod shall create a JSON object containing jobId, type, queryCondition, startTime as an ISO 8601 UTC time (now if startTime is 0) and maxExecutionTimeInSeconds ]*/
+/*Tests_SRS_IOTHUBJOBS_41_009: [ IoTHubJobs_ScheduleTwinUpdate shall add twinPatchJson as updateTwin and IoTHubJobs_ScheduleDeviceMethod shall add cloudToDeviceMethod with methodName, methodPayload (null if NULL) and responseTimeoutInSeconds; if twinPatchJson or methodPayload is not valid JSON they shall return IOTHUB_JOBS_JSON_ERROR ]*/
+/*Tests_SRS_IOTHUBJOBS_41_010: [ IoTHubJobs_ScheduleTwinUpdate and IoTHubJobs_ScheduleDeviceMethod shall send the job as an HTTP PUT request to url/jobs/v2/[jobId] ]*/
+/*Tests_SRS_IOTHUBJOBS_41_011: [ The jobs functions shall add the following headers to the request: Authorization, Request-Id, User-Agent and Content-Type=application/json; charset=utf-8 ]*/
+/*Tests_SRS_IOTHUBJOBS_41_012: [ The jobs functions shall execute the request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ]*/
+/*Tests_SRS_IOTHUBJOBS_41_014: [ The jobs functions shall parse the jobId, type, status, failureReason and deviceJobStatistics of the response into job; jobId and failureReason shall be allocated copies owned by the caller ]*/
+TEST_FUNCTION(IoTHubJobs_ScheduleTwinUpdate_happy_path)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    set_expected_calls_for_create_job_json("scheduleUpdateTwin");
+    STRICT_EXPECTED_CALL(json_parse_string(TEST_TWIN_PATCH));
+    STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(json_object_set_value(TEST_JSON_OBJECT, "updateTwin", TEST_JSON_VALUE));
+    set_expected_calls_for_schedule_job();
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+    ///act
+    IOTHUB_JOBS_RESULT result = IoTHubJobs_ScheduleTwinUpdate(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, TEST_QUERY_CONDITION, TEST_TWIN_PATCH, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "/jobs/v2/theJobId?api-version=2016-11-14", g_relative_path);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_JOB_ID, job.jobId);
+    ASSERT_IS_NULL(job.failureReason);
+    ASSERT_ARE_EQUAL(IOTHUB_JOB_TYPE, IOTHUB_JOB_TYPE_SCHEDULE_UPDATE_TWIN, job.type);
+    ASSERT_ARE_EQUAL(IOTHUB_JOB_STATUS, IOTHUB_JOB_STATUS_RUNNING, job.status);
+    ASSERT_ARE_EQUAL(size_t, 200000, job.deviceCount);
+    ASSERT_ARE_EQUAL(size_t, 7, job.pendingCount);
+
+    ///cleanup
+    free_job_members(&job);
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_013: [ If the request fails the jobs functions shall return IOTHUB_JOBS_HTTPAPI_ERROR, and if the HTTP status code is not 2xx they shall return IOTHUB_JOBS_HTTP_STATUS_ERROR ]*/
+/*Tests_SRS_IOTHUBJOBS_41_015: [ If the response cannot be parsed the jobs functions shall return IOTHUB_JOBS_JSON_ERROR ]*/
+/*Tests_SRS_IOTHUBJOBS_41_016: [ If any other call fails the jobs functions shall return IOTHUB_JOBS_ERROR ]*/
+TEST_FUNCTION(IoTHubJobs_ScheduleTwinUpdate_non_happy_path)
+{
+    ///arrange
+    int umockc_result = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, umockc_result);
+
+    set_expected_calls_for_create_job_json("scheduleUpdateTwin");
+    STRICT_EXPECTED_CALL(json_parse_string(TEST_TWIN_PATCH));
+    STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(json_object_set_value(TEST_JSON_OBJECT, "updateTwin", TEST_JSON_VALUE));
+    set_expected_calls_for_schedule_job();
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        if ((i != 8) &&  /*json_value_get_object*/
+            (i != 12) && /*json_free_serialized_string*/
+            (i != 20) && /*gballoc_free*/
+            (i != 22) && /*STRING_c_str*/
+            (i != 28) && /*json_object_get_string(failureReason)*/
+            (i < 30 || i > 42) /*type, status, deviceJobStatistics and cleanup*/
+            )
+        {
+            ///arrange
+            IOTHUB_JOB job;
+
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+
+            ///act
+            IOTHUB_JOBS_RESULT result = IoTHubJobs_ScheduleTwinUpdate(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, TEST_QUERY_CONDITION, TEST_TWIN_PATCH, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+
+            ///assert
+            ASSERT_ARE_NOT_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_OK, result);
+        }
+    }
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_009: [ IoTHubJobs_ScheduleTwinUpdate shall add twinPatchJson as updateTwin and IoTHubJobs_ScheduleDeviceMethod shall add cloudToDeviceMethod with methodName, methodPayload (null if NULL) and responseTimeoutInSeconds; if twinPatchJson or methodPayload is not valid JSON they shall return IOTHUB_JOBS_JSON_ERROR ]*/
+TEST_FUNCTION(IoTHubJobs_ScheduleTwinUpdate_return_JSON_ERROR_if_twinPatchJson_is_not_valid_JSON)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    set_expected_calls_for_create_job_json("scheduleUpdateTwin");
+    STRICT_EXPECTED_CALL(json_parse_string(TEST_TWIN_PATCH))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+    ///act
+    IOTHUB_JOBS_RESULT result = IoTHubJobs_ScheduleTwinUpdate(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, TEST_QUERY_CONDITION, TEST_TWIN_PATCH, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_JSON_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_007: [ If serviceClientJobsHandle, jobId, queryCondition, twinPatchJson, methodName or job is NULL the schedule functions shall return IOTHUB_JOBS_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubJobs_ScheduleDeviceMethod_return_INVALID_ARG_if_input_parameter_is_NULL)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    ///act
+    IOTHUB_JOBS_RESULT result1 = IoTHubJobs_ScheduleDeviceMethod(NULL, TEST_JOB_ID, TEST_QUERY_CONDITION, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_RESPONSE_TIMEOUT, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+    IOTHUB_JOBS_RESULT result2 = IoTHubJobs_ScheduleDeviceMethod(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, NULL, TEST_QUERY_CONDITION, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_RESPONSE_TIMEOUT, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+    IOTHUB_JOBS_RESULT result3 = IoTHubJobs_ScheduleDeviceMethod(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, NULL, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_RESPONSE_TIMEOUT, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+    IOTHUB_JOBS_RESULT result4 = IoTHubJobs_ScheduleDeviceMethod(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, TEST_QUERY_CONDITION, NULL, TEST_METHOD_PAYLOAD, TEST_RESPONSE_TIMEOUT, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+    IOTHUB_JOBS_RESULT result5 = IoTHubJobs_ScheduleDeviceMethod(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, TEST_QUERY_CONDITION, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_RESPONSE_TIMEOUT, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result4);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result5);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_008: [ IoTHubJobs_ScheduleTwinUpdate and IoTHubJobs_ScheduleDeviceMethod shall create a JSON object containing jobId, type, queryCondition, startTime as an ISO 8601 UTC time (now if startTime is 0) and maxExecutionTimeInSeconds ]*/
+/*Tests_SRS_IOTHUBJOBS_41_009: [ IoTHubJobs_ScheduleTwinUpdate shall add twinPatchJson as updateTwin and IoTHubJobs_ScheduleDeviceMethod shall add cloudToDeviceMethod with methodName, methodPayload (null if NULL) and responseTimeoutInSeconds; if twinPatchJson or methodPayload is not valid JSON they shall return IOTHUB_JOBS_JSON_ERROR ]*/
+/*Tests_SRS_IOTHUBJOBS_41_010: [ IoTHubJobs_ScheduleTwinUpdate and IoTHubJobs_ScheduleDeviceMethod shall send the job as an HTTP PUT request to url/jobs/v2/[jobId] ]*/
+TEST_FUNCTION(IoTHubJobs_ScheduleDeviceMethod_happy_path)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    set_expected_calls_for_create_job_json("scheduleDeviceMethod");
+    STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(json_object_dotset_string(TEST_JSON_OBJECT, "cloudToDeviceMethod.methodName", TEST_METHOD_NAME));
+    STRICT_EXPECTED_CALL(json_object_dotset_number(TEST_JSON_OBJECT, "cloudToDeviceMethod.responseTimeoutInSeconds", (double)TEST_RESPONSE_TIMEOUT));
+    STRICT_EXPECTED_CALL(json_parse_string(TEST_METHOD_PAYLOAD));
+    STRICT_EXPECTED_CALL(json_object_dotset_value(TEST_JSON_OBJECT, "cloudToDeviceMethod.payload", TEST_JSON_VALUE));
+    set_expected_calls_for_schedule_job();
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+    ///act
+    IOTHUB_JOBS_RESULT result = IoTHubJobs_ScheduleDeviceMethod(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, TEST_QUERY_CONDITION, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_RESPONSE_TIMEOUT, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "/jobs/v2/theJobId?api-version=2016-11-14", g_relative_path);
+
+    ///cleanup
+    free_job_members(&job);
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_009: [ IoTHubJobs_ScheduleTwinUpdate shall add twinPatchJson as updateTwin and IoTHubJobs_ScheduleDeviceMethod shall add cloudToDeviceMethod with methodName, methodPayload (null if NULL) and responseTimeoutInSeconds; if twinPatchJson or methodPayload is not valid JSON they shall return IOTHUB_JOBS_JSON_ERROR ]*/
+TEST_FUNCTION(IoTHubJobs_ScheduleDeviceMethod_sends_a_null_payload_if_methodPayload_is_NULL)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    ///act
+    IOTHUB_JOBS_RESULT result = IoTHubJobs_ScheduleDeviceMethod(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, TEST_QUERY_CONDITION, TEST_METHOD_NAME, NULL, TEST_RESPONSE_TIMEOUT, TEST_START_TIME, TEST_MAX_EXECUTION_TIME, &job);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_OK, result);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "json_value_init_null()"));
+
+    ///cleanup
+    free_job_members(&job);
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_017: [ If serviceClientJobsHandle, jobId or job is NULL IoTHubJobs_GetJob and IoTHubJobs_CancelJob shall return IOTHUB_JOBS_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubJobs_GetJob_and_CancelJob_return_INVALID_ARG_if_input_parameter_is_NULL)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    ///act
+    IOTHUB_JOBS_RESULT result1 = IoTHubJobs_GetJob(NULL, TEST_JOB_ID, &job);
+    IOTHUB_JOBS_RESULT result2 = IoTHubJobs_GetJob(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, NULL, &job);
+    IOTHUB_JOBS_RESULT result3 = IoTHubJobs_GetJob(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, NULL);
+    IOTHUB_JOBS_RESULT result4 = IoTHubJobs_CancelJob(NULL, TEST_JOB_ID, &job);
+    IOTHUB_JOBS_RESULT result5 = IoTHubJobs_CancelJob(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, NULL, &job);
+    IOTHUB_JOBS_RESULT result6 = IoTHubJobs_CancelJob(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result4);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result5);
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_INVALID_ARG, result6);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_018: [ IoTHubJobs_GetJob shall send an HTTP GET request to url/jobs/v2/[jobId] ]*/
+TEST_FUNCTION(IoTHubJobs_GetJob_happy_path)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    set_expected_calls_for_send_request(HTTPAPI_REQUEST_GET);
+
+    ///act
+    IOTHUB_JOBS_RESULT result = IoTHubJobs_GetJob(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, &job);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "/jobs/v2/theJobId?api-version=2016-11-14", g_relative_path);
+    ASSERT_ARE_EQUAL(IOTHUB_JOB_STATUS, IOTHUB_JOB_STATUS_RUNNING, job.status);
+
+    ///cleanup
+    free_job_members(&job);
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_013: [ If the request fails the jobs functions shall return IOTHUB_JOBS_HTTPAPI_ERROR, and if the HTTP status code is not 2xx they shall return IOTHUB_JOBS_HTTP_STATUS_ERROR ]*/
+TEST_FUNCTION(IoTHubJobs_GetJob_return_HTTP_STATUS_ERROR_if_status_code_is_not_2xx)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .CopyOutArgumentBuffer_statusCode(&httpStatusCodeNotFound, sizeof(httpStatusCodeNotFound));
+
+    ///act
+    IOTHUB_JOBS_RESULT result = IoTHubJobs_GetJob(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, &job);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_HTTP_STATUS_ERROR, result);
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_013: [ If the request fails the jobs functions shall return IOTHUB_JOBS_HTTPAPI_ERROR, and if the HTTP status code is not 2xx they shall return IOTHUB_JOBS_HTTP_STATUS_ERROR ]*/
+TEST_FUNCTION(IoTHubJobs_GetJob_return_HTTPAPI_ERROR_if_the_request_fails)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn(HTTPAPIEX_ERROR);
+
+    ///act
+    IOTHUB_JOBS_RESULT result = IoTHubJobs_GetJob(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, &job);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_HTTPAPI_ERROR, result);
+}
+
+/*Tests_SRS_IOTHUBJOBS_41_019: [ IoTHubJobs_CancelJob shall send an HTTP POST request to url/jobs/v2/[jobId]/cancel ]*/
+TEST_FUNCTION(IoTHubJobs_CancelJob_happy_path)
+{
+    ///arrange
+    IOTHUB_JOB job;
+
+    set_expected_calls_for_send_request(HTTPAPI_REQUEST_POST);
+
+    ///act
+    IOTHUB_JOBS_RESULT result = IoTHubJobs_CancelJob(TEST_IOTHUB_SERVICE_CLIENT_JOBS_HANDLE, TEST_JOB_ID, &job);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_JOBS_RESULT, IOTHUB_JOBS_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "/jobs/v2/theJobId/cancel?api-version=2016-11-14", g_relative_path);
+
+    ///cleanup
+    free_job_members(&job);
+}
+
+END_TEST_SUITE(iothub_jobs_ut)
@@ -296,12 +296,13 @@ void my_messagereceiver_destroy(MESSAGE_RECEIVER_HANDLE message_receiver)
 }
 
 static ON_MESSAGE_SEND_COMPLETE onMessageSendCompleteCallback;
+static void* onMessageSendCompleteContext;
 static int my_messagesender_send(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
 {
     (void)message;
     (void)message_sender;
-    (void)callback_context;
     onMessageSendCompleteCallback = on_message_send_complete;
+    onMessageSendCompleteContext = callback_context;
     return 0;
 }
 
@@ -329,6 +330,14 @@ void f_on_feedback_message_received(void* context, IOTHUB_SERVICE_FEEDBACK_BATCH
     }
 }
 
+static size_t receivedFeedbackRecordCount = 0;
+void f_on_feedback_record_received(void* context, const IOTHUB_SERVICE_FEEDBACK_RECORD* feedbackRecord)
+{
+    (void)context;
+    receivedFeedbackStatusCode = feedbackRecord->statusCode;
+    receivedFeedbackRecordCount++;
+}
+
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/gballoc.h"
 #undef ENABLE_MOCKS
@@ -380,11 +389,11 @@ typedef struct TEST_SASL_PLAIN_CONFIG_TAG
 typedef struct TEST_CALLBACK_TAG
 {
     IOTHUB_OPEN_COMPLETE_CALLBACK openCompleteCompleteCallback;
-    IOTHUB_SEND_COMPLETE_CALLBACK sendCompleteCallback;
     IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK feedbackMessageCallback;
+    IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK feedbackRecordCallback;
     void* openUserContext;
-    void* sendUserContext;
     void* feedbackUserContext;
+    void* feedbackRecordUserContext;
 } TEST_CALLBACK;
 
 typedef struct TEST_IOTHUB_MESSAGING_TAG
@@ -411,6 +420,19 @@ typedef struct TEST_IOTHUB_MESSAGING_TAG
     MESSAGE_RECEIVER_STATE message_receiver_state;
 
     TEST_CALLBACK* callback_data;
+
+    void* pending_sends;
+    size_t pending_send_count;
+    size_t max_outstanding_sends;
+    bool feedback_presettled;
+
+    CBS_HANDLE cbs_handle;
+    bool is_cbs_open;
+    bool is_cbs_put_token_in_progress;
+    time_t sas_token_refresh_time;
+    STRING_HANDLE sas_signing_hostname;
+    STRING_HANDLE sas_signing_key;
+    STRING_HANDLE sas_signing_key_name;
 } TEST_IOTHUB_MESSAGING;
 
 static void* TEST_VOID_PTR = (void*)0x5454;
@@ -427,6 +449,7 @@ static const IO_INTERFACE_DESCRIPTION* TEST_IO_INTERFACE_DESCRIPTION = (const IO
 static XIO_HANDLE TEST_XIO_HANDLE = (XIO_HANDLE)0x4545;
 static CONNECTION_HANDLE TEST_CONNECTION_HANDLE = (CONNECTION_HANDLE)0x4646;
 static SESSION_HANDLE TEST_SESSION_HANDLE = (SESSION_HANDLE)0x4747;
+static CBS_HANDLE TEST_CBS_HANDLE = (CBS_HANDLE)0x4A4A;
 static AMQP_VALUE TEST_AMQP_VALUE = (AMQP_VALUE)0x4848;
 static AMQP_VALUE TEST_AMQP_VALUE_NULL = (AMQP_VALUE)NULL;
 static LINK_HANDLE TEST_LINK_HANDLE = (LINK_HANDLE)0x4949;
@@ -474,6 +497,10 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(fields, void*);
         REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(CBS_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(ON_CBS_OPEN_COMPLETE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(ON_CBS_ERROR, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(ON_CBS_OPERATION_COMPLETE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(CONNECTION_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(LINK_HANDLE, void*);
@@ -541,6 +568,15 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         REGISTER_GLOBAL_MOCK_RETURN(session_create, TEST_SESSION_HANDLE);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(session_create, NULL);
 
+        REGISTER_GLOBAL_MOCK_RETURN(cbs_create, TEST_CBS_HANDLE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(cbs_create, NULL);
+
+        REGISTER_GLOBAL_MOCK_RETURN(cbs_open_async, 0);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(cbs_open_async, 1);
+
+        REGISTER_GLOBAL_MOCK_RETURN(cbs_put_token_async, 0);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(cbs_put_token_async, 1);
+
         REGISTER_GLOBAL_MOCK_RETURN(session_set_incoming_window, 0);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(session_set_incoming_window, 1);
 
@@ -707,15 +743,28 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         TEST_IOTHUB_MESSAGING_DATA.keyName = TEST_SHAREDACCESSKEYNAME;
         TEST_IOTHUB_MESSAGING_DATA.sharedAccessKey = TEST_SHAREDACCESSKEY;
         TEST_IOTHUB_MESSAGING_DATA.isOpened = false;
+        TEST_IOTHUB_MESSAGING_DATA.pending_sends = NULL;
+        TEST_IOTHUB_MESSAGING_DATA.pending_send_count = 0;
+        TEST_IOTHUB_MESSAGING_DATA.max_outstanding_sends = 0;
+        TEST_IOTHUB_MESSAGING_DATA.feedback_presettled = false;
+        TEST_IOTHUB_MESSAGING_DATA.cbs_handle = NULL;
+        TEST_IOTHUB_MESSAGING_DATA.is_cbs_open = false;
+        TEST_IOTHUB_MESSAGING_DATA.is_cbs_put_token_in_progress = false;
+        TEST_IOTHUB_MESSAGING_DATA.sas_token_refresh_time = 0;
+        TEST_IOTHUB_MESSAGING_DATA.sas_signing_hostname = NULL;
+        TEST_IOTHUB_MESSAGING_DATA.sas_signing_key = NULL;
+        TEST_IOTHUB_MESSAGING_DATA.sas_signing_key_name = NULL;
 
         onMessageSenderStateChangedCallback = NULL;
         onMessageReceiverStateChangedCallback = NULL;
         onMessageSendCompleteCallback = NULL;
+        onMessageSendCompleteContext = NULL;
         onMessageReceivedCallback = NULL;
         messagereceiver_create_return = NULL;
         messagesender_create_return = NULL;
 
         receivedFeedbackStatusCode = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
+        receivedFeedbackRecordCount = 0;
     }
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -1261,6 +1310,53 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     }
 
+    /*Tests_SRS_IOTHUBMESSAGING_41_023: [ IoTHubMessaging_LL_Close shall destroy the CBS instance and the cached signing strings before destroying the session, and stop the SAS token renewal ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_Close_destroys_cbs_before_the_session)
+    {
+        // arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+
+        TEST_IOTHUB_MESSAGING* test_handle = (TEST_IOTHUB_MESSAGING*)iothub_messaging_handle;
+        test_handle->cbs_handle = TEST_CBS_HANDLE;
+        test_handle->is_cbs_open = true;
+        test_handle->sas_signing_hostname = my_STRING_construct(TEST_HOSTNAME);
+
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(messagesender_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(messagereceiver_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(link_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(link_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(cbs_destroy(TEST_CBS_HANDLE));
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(session_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        EXPECTED_CALL(connection_destroy(IGNORED_PTR_ARG));
+        EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+        EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+        EXPECTED_CALL(saslmechanism_destroy(IGNORED_PTR_ARG));
+        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        // act
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_NULL(test_handle->cbs_handle);
+        ASSERT_IS_FALSE(test_handle->is_cbs_open);
+        ASSERT_ARE_EQUAL(int, 0, (int)test_handle->sas_token_refresh_time);
+
+        ///cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
     /*Tests_SRS_IOTHUBMESSAGING_12_033: [ IoTHubMessaging_LL_Close destroy the AMQP transportconnection by calling link_destroy, session_destroy, connection_destroy, xio_destroy, saslmechanism_destroy ] */
     TEST_FUNCTION(IoTHubMessaging_LL_Close_happy_path)
     {
@@ -1315,6 +1411,60 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
+    /*Tests_SRS_IOTHUBMESSAGING_41_003: [ IoTHubMessaging_LL_Close shall complete every send still pending after the message sender is destroyed with IOTHUB_MESSAGING_ERROR ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_Close_completes_pending_sends)
+    {
+        // arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)2);
+
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(messagesender_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK((void*)2, IOTHUB_MESSAGING_ERROR));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK((void*)1, IOTHUB_MESSAGING_ERROR));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(messagereceiver_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(link_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(link_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(session_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(connection_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(saslmechanism_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        // act
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_NULL(((TEST_IOTHUB_MESSAGING*)iothub_messaging_handle)->pending_sends);
+
+        ///cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
     /*Tests_SRS_IOTHUBMESSAGING_12_033: [ IoTHubMessaging_LL_Close destroy the AMQP transportconnection by calling link_destroy, session_destroy, connection_destroy, xio_destroy, saslmechanism_destroy ] */
     TEST_FUNCTION(IoTHubMessaging_LL_Close_non_happy_path)
     {
@@ -1541,6 +1691,8 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG))
             .IgnoreAllArguments();
 
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(messagesender_send(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments();
 
@@ -1558,6 +1710,11 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         ///assert
         ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, onMessageSendCompleteContext, TEST_IOTHUB_MESSAGING_DATA.pending_sends);
+        ASSERT_ARE_EQUAL(size_t, 1, TEST_IOTHUB_MESSAGING_DATA.pending_send_count);
+
+        ///cleanup
+        my_gballoc_free(onMessageSendCompleteContext);
     }
 
     /*Tests_SRS_IOTHUBMESSAGING_12_040: [ If any of the uAMQP call fails IoTHubMessaging_LL_SendMessage shall return IOTHUB_MESSAGING_ERROR ] */
@@ -1583,7 +1740,7 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
             26, /*amqpvalue_destroy*/
             27, /*amqpvalue_destroy*/
             28, /*amqpvalue_destroy*/
-            30  /*gballoc_free*/
+            31  /*gballoc_free*/
         };
 
         size_t number_of_arguments = 1;
@@ -1665,6 +1822,8 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG))
             .IgnoreAllArguments();
 
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(messagesender_send(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments();
 
@@ -1700,6 +1859,139 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         umock_c_negative_tests_deinit();
     }
 
+    /*Tests_SRS_IOTHUBMESSAGING_41_004: [ If the outstanding sends window is not 0 and as many sends as the window are pending, IoTHubMessaging_LL_Send shall return IOTHUB_MESSAGING_ERROR without sending ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_Send_return_IOTHUB_MESSAGING_ERROR_if_outstanding_sends_window_is_full)
+    {
+        ///arrange
+        TEST_IOTHUB_MESSAGING_DATA.isOpened = true;
+        TEST_IOTHUB_MESSAGING_DATA.max_outstanding_sends = 2;
+        TEST_IOTHUB_MESSAGING_DATA.pending_send_count = 2;
+
+        umock_c_reset_all_calls();
+
+        ///act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_Send(TEST_IOTHUB_MESSAGING_HANDLE, TEST_CONST_CHAR_PTR, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, TEST_IOTHUB_MESSAGING_DATA.pending_send_count);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_009: [ If messagingHandle is NULL, IoTHubMessaging_LL_SetMaxOutstandingSends shall return IOTHUB_MESSAGING_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SetMaxOutstandingSends_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
+    {
+        ///arrange
+
+        ///act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetMaxOutstandingSends(NULL, 16);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_010: [ IoTHubMessaging_LL_SetMaxOutstandingSends shall save maxOutstandingSends as the outstanding sends window and return IOTHUB_MESSAGING_OK ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SetMaxOutstandingSends_happy_path)
+    {
+        ///arrange
+
+        ///act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetMaxOutstandingSends(TEST_IOTHUB_MESSAGING_HANDLE, 16);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 16, TEST_IOTHUB_MESSAGING_DATA.max_outstanding_sends);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_024: [ If messagingHandle or pendingSendCount is NULL, IoTHubMessaging_LL_GetPendingSendCount shall return IOTHUB_MESSAGING_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_GetPendingSendCount_return_IOTHUB_MESSAGING_INVALID_ARG_if_an_input_parameter_is_NULL)
+    {
+        ///arrange
+        size_t pendingSendCount = 0;
+
+        ///act
+        IOTHUB_MESSAGING_RESULT result1 = IoTHubMessaging_LL_GetPendingSendCount(NULL, &pendingSendCount);
+        IOTHUB_MESSAGING_RESULT result2 = IoTHubMessaging_LL_GetPendingSendCount(TEST_IOTHUB_MESSAGING_HANDLE, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_INVALID_ARG, result1);
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_INVALID_ARG, result2);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_025: [ IoTHubMessaging_LL_GetPendingSendCount shall set pendingSendCount to the number of sends waiting for their completion callback and return IOTHUB_MESSAGING_OK ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_GetPendingSendCount_happy_path)
+    {
+        ///arrange
+        size_t pendingSendCount = 0;
+        TEST_IOTHUB_MESSAGING_DATA.pending_send_count = 3;
+
+        ///act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_GetPendingSendCount(TEST_IOTHUB_MESSAGING_HANDLE, &pendingSendCount);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 3, pendingSendCount);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_012: [ If messagingHandle is NULL, IoTHubMessaging_LL_SetFeedbackRecordCallback shall return IOTHUB_MESSAGING_INVALID_ARG, otherwise it shall save feedbackRecordReceivedCallback and userContextCallback and return IOTHUB_MESSAGING_OK ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackRecordCallback_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
+    {
+        ///arrange
+
+        ///act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackRecordCallback(NULL, f_on_feedback_record_received, TEST_VOID_PTR);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_012: [ If messagingHandle is NULL, IoTHubMessaging_LL_SetFeedbackRecordCallback shall return IOTHUB_MESSAGING_INVALID_ARG, otherwise it shall save feedbackRecordReceivedCallback and userContextCallback and return IOTHUB_MESSAGING_OK ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackRecordCallback_happy_path)
+    {
+        ///arrange
+
+        ///act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackRecordCallback(TEST_IOTHUB_MESSAGING_HANDLE, f_on_feedback_record_received, TEST_VOID_PTR);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)f_on_feedback_record_received, (void*)TEST_IOTHUB_MESSAGING_DATA.callback_data->feedbackRecordCallback);
+        ASSERT_ARE_EQUAL(void_ptr, TEST_VOID_PTR, TEST_IOTHUB_MESSAGING_DATA.callback_data->feedbackRecordUserContext);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        TEST_IOTHUB_MESSAGING_DATA.callback_data->feedbackRecordCallback = NULL;
+        TEST_IOTHUB_MESSAGING_DATA.callback_data->feedbackRecordUserContext = NULL;
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_015: [ If messagingHandle is NULL, IoTHubMessaging_LL_SetFeedbackPresettled shall return IOTHUB_MESSAGING_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackPresettled_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
+    {
+        ///arrange
+
+        ///act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackPresettled(NULL, true);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_016: [ IoTHubMessaging_LL_SetFeedbackPresettled shall save presettled to be applied by the next IoTHubMessaging_LL_Open and return IOTHUB_MESSAGING_OK ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackPresettled_happy_path)
+    {
+        ///arrange
+
+        ///act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackPresettled(TEST_IOTHUB_MESSAGING_HANDLE, true);
+
+        ///assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_OK, result);
+        ASSERT_IS_TRUE(TEST_IOTHUB_MESSAGING_DATA.feedback_presettled);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
     /*Tests_SRS_IOTHUBMESSAGING_12_042: [ IoTHubMessaging_LL_SetCallbacks shall verify the messagingHandle input parameter and if it is NULL then return NULL ] */
     TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackMessageCallback_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
     {
@@ -1755,6 +2047,126 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     }
 
+    /*Tests_SRS_IOTHUBMESSAGING_41_022: [ The first time the renewal is due, IoTHubMessaging_LL_DoWork shall create and open a CBS instance on the existing session with cbs_create and cbs_open_async ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_DoWork_opens_cbs_when_sas_token_renewal_is_due)
+    {
+        ///arrange
+        TEST_IOTHUB_MESSAGING_DATA.isOpened = true;
+        TEST_IOTHUB_MESSAGING_DATA.session = TEST_SESSION_HANDLE;
+        TEST_IOTHUB_MESSAGING_DATA.sas_token_refresh_time = 1;
+
+        STRICT_EXPECTED_CALL(cbs_create(TEST_SESSION_HANDLE));
+        STRICT_EXPECTED_CALL(cbs_open_async(TEST_CBS_HANDLE, IGNORED_PTR_ARG, TEST_IOTHUB_MESSAGING_HANDLE, IGNORED_PTR_ARG, TEST_IOTHUB_MESSAGING_HANDLE))
+            .IgnoreArgument(2)
+            .IgnoreArgument(4);
+        STRICT_EXPECTED_CALL(connection_dowork(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        ///act
+        IoTHubMessaging_LL_DoWork(TEST_IOTHUB_MESSAGING_HANDLE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, TEST_CBS_HANDLE, TEST_IOTHUB_MESSAGING_DATA.cbs_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_018: [ IoTHubMessaging_LL_Open shall create the SAS token with a lifetime of one hour and schedule its renewal at 80% of that lifetime ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_DoWork_does_not_renew_sas_token_before_it_is_due)
+    {
+        ///arrange
+        TEST_IOTHUB_MESSAGING_DATA.isOpened = true;
+        TEST_IOTHUB_MESSAGING_DATA.sas_token_refresh_time = time(NULL) + 1000;
+
+        STRICT_EXPECTED_CALL(connection_dowork(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        ///act
+        IoTHubMessaging_LL_DoWork(TEST_IOTHUB_MESSAGING_HANDLE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_019: [ When the renewal is due, IoTHubMessaging_LL_DoWork shall send a new SAS token with cbs_put_token_async, using servicebus.windows.net:sastoken as type and the hostname as audience ] */
+    /*Tests_SRS_IOTHUBMESSAGING_41_020: [ The renewed SAS token shall be signed with hostname, sharedAccessKey and keyName STRING_HANDLEs built on the first renewal and reused until IoTHubMessaging_LL_Close ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_DoWork_puts_renewed_sas_token_to_cbs)
+    {
+        ///arrange
+        time_t before = time(NULL);
+        TEST_IOTHUB_MESSAGING_DATA.isOpened = true;
+        TEST_IOTHUB_MESSAGING_DATA.cbs_handle = TEST_CBS_HANDLE;
+        TEST_IOTHUB_MESSAGING_DATA.is_cbs_open = true;
+        TEST_IOTHUB_MESSAGING_DATA.sas_token_refresh_time = 1;
+
+        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
+        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
+        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
+        STRICT_EXPECTED_CALL(SASToken_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(cbs_put_token_async(TEST_CBS_HANDLE, "servicebus.windows.net:sastoken", TEST_HOSTNAME, IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_MESSAGING_HANDLE))
+            .IgnoreArgument(4)
+            .IgnoreArgument(5);
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(connection_dowork(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        ///act
+        IoTHubMessaging_LL_DoWork(TEST_IOTHUB_MESSAGING_HANDLE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_TRUE(TEST_IOTHUB_MESSAGING_DATA.is_cbs_put_token_in_progress);
+        ASSERT_IS_TRUE(TEST_IOTHUB_MESSAGING_DATA.sas_token_refresh_time >= before + 2880);
+
+        ///cleanup
+        my_STRING_delete(TEST_IOTHUB_MESSAGING_DATA.sas_signing_hostname);
+        my_STRING_delete(TEST_IOTHUB_MESSAGING_DATA.sas_signing_key);
+        my_STRING_delete(TEST_IOTHUB_MESSAGING_DATA.sas_signing_key_name);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_021: [ If the put-token operation fails, the renewal shall be retried 30 seconds later ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_DoWork_retries_sas_token_renewal_when_put_token_fails)
+    {
+        ///arrange
+        time_t before = time(NULL);
+        TEST_IOTHUB_MESSAGING_DATA.isOpened = true;
+        TEST_IOTHUB_MESSAGING_DATA.cbs_handle = TEST_CBS_HANDLE;
+        TEST_IOTHUB_MESSAGING_DATA.is_cbs_open = true;
+        TEST_IOTHUB_MESSAGING_DATA.sas_token_refresh_time = 1;
+
+        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
+        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
+        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
+        STRICT_EXPECTED_CALL(SASToken_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(cbs_put_token_async(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments()
+            .SetReturn(1);
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(connection_dowork(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        ///act
+        IoTHubMessaging_LL_DoWork(TEST_IOTHUB_MESSAGING_HANDLE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_FALSE(TEST_IOTHUB_MESSAGING_DATA.is_cbs_put_token_in_progress);
+        ASSERT_IS_TRUE(TEST_IOTHUB_MESSAGING_DATA.sas_token_refresh_time >= before + 30);
+        ASSERT_IS_TRUE(TEST_IOTHUB_MESSAGING_DATA.sas_token_refresh_time < before + 2880);
+
+        ///cleanup
+        my_STRING_delete(TEST_IOTHUB_MESSAGING_DATA.sas_signing_hostname);
+        my_STRING_delete(TEST_IOTHUB_MESSAGING_DATA.sas_signing_key);
+        my_STRING_delete(TEST_IOTHUB_MESSAGING_DATA.sas_signing_key_name);
+    }
+
     /*Tests_SRS_IOTHUBMESSAGING_12_049: [ IoTHubMessaging_LL_SenderStateChanged shall save the new_state to local variable ] */
     /*Tests_SRS_IOTHUBMESSAGING_12_050: [ If both sender and receiver state is open IoTHubMessaging_LL_SenderStateChanged shall set the isOpened local variable to true ] */
     TEST_FUNCTION(IoTHubMessaging_LL_SenderStateChanged_call_user_callback)
@@ -1963,18 +2375,17 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         ///arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
         (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
-        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, NULL, (void*)1);
 
         umock_c_reset_all_calls();
 
-        MESSAGE_SEND_RESULT send_result = MESSAGE_SEND_OK;
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
 
-        TEST_IOTHUB_MESSAGING* test_handle = (TEST_IOTHUB_MESSAGING*)iothub_messaging_handle;
-        test_handle->isOpened = true;
-        test_handle->callback_data->sendCompleteCallback = NULL;
+        MESSAGE_SEND_RESULT send_result = MESSAGE_SEND_OK;
 
         ///act
-        onMessageSendCompleteCallback((void*)test_handle, send_result);
+        onMessageSendCompleteCallback(onMessageSendCompleteContext, send_result);
 
         ///assert
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -1995,16 +2406,58 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
 
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK(IGNORED_PTR_ARG, TEST_IOTHUB_MESSAGING_RESULT))
-            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK((void*)1, IOTHUB_MESSAGING_OK));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
 
         MESSAGE_SEND_RESULT send_result = MESSAGE_SEND_OK;
 
         ///act
-        onMessageSendCompleteCallback((void*)iothub_messaging_handle, send_result);
+        onMessageSendCompleteCallback(onMessageSendCompleteContext, send_result);
 
         ///assert
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_NULL(((TEST_IOTHUB_MESSAGING*)iothub_messaging_handle)->pending_sends);
+        ASSERT_ARE_EQUAL(size_t, 0, ((TEST_IOTHUB_MESSAGING*)iothub_messaging_handle)->pending_send_count);
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_005: [ IoTHubMessaging_LL_Send shall allocate a send context holding sendCompleteCallback and userContextCallback and add it to the pending sends ] */
+    /*Tests_SRS_IOTHUBMESSAGING_41_008: [ IoTHubMessaging_LL_SendMessageComplete shall remove the send context from the pending sends, call the user callback stored in it and free it ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SendMessageComplete_outstanding_sends_keep_their_own_context)
+    {
+        ///arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)1);
+        void* first_send_context = onMessageSendCompleteContext;
+        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)2);
+        void* second_send_context = onMessageSendCompleteContext;
+
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK((void*)1, IOTHUB_MESSAGING_OK));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK((void*)2, IOTHUB_MESSAGING_OK));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        TEST_IOTHUB_MESSAGING* test_handle = (TEST_IOTHUB_MESSAGING*)iothub_messaging_handle;
+        ASSERT_ARE_NOT_EQUAL(void_ptr, first_send_context, second_send_context);
+        ASSERT_ARE_EQUAL(size_t, 2, test_handle->pending_send_count);
+
+        ///act
+        onMessageSendCompleteCallback(first_send_context, MESSAGE_SEND_OK);
+        onMessageSendCompleteCallback(second_send_context, MESSAGE_SEND_OK);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_NULL(test_handle->pending_sends);
+        ASSERT_ARE_EQUAL(size_t, 0, test_handle->pending_send_count);
 
         ///cleanup
         IoTHubMessaging_LL_Close(iothub_messaging_handle);
@@ -2616,6 +3069,108 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
+    /*Tests_SRS_IOTHUBMESSAGING_41_013: [ If a feedback record callback is set, IoTHubMessaging_LL_FeedbackMessageReceived shall call it once per record with a record pointing into the parsed message, without building an IOTHUB_SERVICE_FEEDBACK_BATCH ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_FeedbackMessageReceived_record_callback_visits_records_without_allocating)
+    {
+        ///arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_SetFeedbackMessageCallback(iothub_messaging_handle, TEST_FUNC_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_SetFeedbackRecordCallback(iothub_messaging_handle, f_on_feedback_record_received, (void*)1);
+
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(IGNORED_PTR_ARG, IGNORED_NUM_ARG, &TEST_BINARY_DATA_INST))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, 0))
+            .SetReturn(TEST_JSON_OBJECT);
+        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, 1))
+            .SetReturn(TEST_JSON_OBJECT);
+        for (size_t i = 0; i < 2; i++)
+        {
+            STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, i))
+                .SetReturn(TEST_JSON_OBJECT);
+            STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_DEVICE_ID))
+                .SetReturn("deviceId");
+            STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_DEVICE_GENERATION_ID))
+                .SetReturn("generationId");
+            STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_DESCRIPTION))
+                .SetReturn(NULL);
+            STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_ENQUED_TIME_UTC))
+                .SetReturn("time");
+            STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_ORIGINAL_MESSAGE_ID))
+                .SetReturn("originalMessageId");
+        }
+        STRICT_EXPECTED_CALL(messaging_delivery_accepted());
+        STRICT_EXPECTED_CALL(json_array_clear(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        onMessageReceivedCallback((void*)iothub_messaging_handle, TEST_MESSAGE_HANDLE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 2, receivedFeedbackRecordCount);
+        ASSERT_ARE_EQUAL(int, IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN, receivedFeedbackStatusCode);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_014: [ If any element of the feedback array is not an object, IoTHubMessaging_LL_FeedbackMessageReceived shall reject the message without calling the feedback record callback ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_FeedbackMessageReceived_record_callback_rejects_invalid_record_before_calling_user)
+    {
+        ///arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_SetFeedbackRecordCallback(iothub_messaging_handle, f_on_feedback_record_received, (void*)1);
+
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(IGNORED_PTR_ARG, IGNORED_NUM_ARG, &TEST_BINARY_DATA_INST))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, 0))
+            .SetReturn(TEST_JSON_OBJECT);
+        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, 1))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(messaging_delivery_rejected(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(json_array_clear(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        onMessageReceivedCallback((void*)iothub_messaging_handle, TEST_MESSAGE_HANDLE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 0, receivedFeedbackRecordCount);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
     /*Tests_SRS_IOTHUBMESSAGING_12_061: [ If any of the parson API fails, IoTHubMessaging_LL_FeedbackMessageReceived shall return IOTHUB_MESSAGING_INVALID_JSON ] */
     /*Tests_SRS_IOTHUBMESSAGING_12_078: [** IoTHubMessaging_LL_FeedbackMessageReceived shall do clean up before exits ] */
     TEST_FUNCTION(IoTHubMessaging_LL_FeedbackMessageReceived_non_happy_path)
@@ -21,6 +21,7 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "parson.h"
 #ifdef __cplusplus
 #include <csignal>
@@ -28,6 +29,7 @@
 #include <signal.h>
 #endif
 #include "iothub_messaging_ll.h"
+#include "iothub_client_worker_pool.h"
 #undef ENABLE_MOCKS
 
 #include "iothub_messaging.h"
@@ -95,6 +97,8 @@ typedef struct TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE_TAG
     THREAD_HANDLE ThreadHandle;
     LOCK_HANDLE LockHandle;
     sig_atomic_t StopThread;
+    COND_HANDLE WorkCondition;
+    WORKER_POOL_ITEM_HANDLE WorkerPoolItem;
 } TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE;
 
 static TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE TEST_IOTHUB_MESSAGING_CLIENT;
@@ -130,6 +134,74 @@ static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int *res)
     return THREADAPI_OK;
 }
 
+/*the worker thread is not started by ThreadAPI_Create; the tests run g_thread_func on the test thread*/
+static THREAD_START_FUNC g_thread_func;
+static void* g_thread_func_arg;
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = (THREAD_HANDLE)0x4343;
+    g_thread_func = func;
+    g_thread_func_arg = arg;
+    return THREADAPI_OK;
+}
+
+/*each wait of the worker thread counts as a loop; the thread is asked to stop after g_how_thread_loops of them*/
+static size_t g_how_thread_loops;
+static void count_thread_loop(void)
+{
+    if (g_how_thread_loops > 0)
+    {
+        g_how_thread_loops--;
+    }
+    if (g_how_thread_loops == 0)
+    {
+        ((TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE*)g_thread_func_arg)->StopThread = 1;
+    }
+}
+
+static void my_ThreadAPI_Sleep(unsigned int milliseconds)
+{
+    (void)milliseconds;
+    count_thread_loop();
+}
+
+static COND_HANDLE TEST_COND_HANDLE = (COND_HANDLE)0x1313;
+static COND_HANDLE my_Condition_Init(void)
+{
+    return TEST_COND_HANDLE;
+}
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    count_thread_loop();
+    return COND_TIMEOUT;
+}
+
+static WORKER_POOL_HANDLE TEST_WORKER_POOL_HANDLE = (WORKER_POOL_HANDLE)0x1414;
+static WORKER_POOL_ITEM_HANDLE TEST_WORKER_POOL_ITEM_HANDLE = (WORKER_POOL_ITEM_HANDLE)0x1515;
+
+/*the worker pool does not run the items; the tests run g_work_function on the test thread*/
+static WORKER_POOL_WORK_FUNCTION g_work_function;
+static void* g_work_context;
+static WORKER_POOL_ITEM_HANDLE my_worker_pool_add(WORKER_POOL_HANDLE worker_pool, WORKER_POOL_WORK_FUNCTION work_function, void* work_context)
+{
+    (void)worker_pool;
+    g_work_function = work_function;
+    g_work_context = work_context;
+    return TEST_WORKER_POOL_ITEM_HANDLE;
+}
+
+static size_t g_pending_send_count;
+static IOTHUB_MESSAGING_RESULT my_IoTHubMessaging_LL_GetPendingSendCount(IOTHUB_MESSAGING_HANDLE messagingHandle, size_t* pendingSendCount)
+{
+    (void)messagingHandle;
+    *pendingSendCount = g_pending_send_count;
+    return IOTHUB_MESSAGING_OK;
+}
+
 static IOTHUB_SERVICE_CLIENT_AUTH_HANDLE TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE = (IOTHUB_SERVICE_CLIENT_AUTH_HANDLE)0x4242;
 static IOTHUB_MESSAGING_HANDLE my_IoTHubMessaging_LL_Create(IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientHandle)
 {
@@ -191,6 +263,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SEND_COMPLETE_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
     REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(WORKER_POOL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(WORKER_POOL_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(WORKER_POOL_WORK_FUNCTION, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -215,6 +292,22 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Join, THREADAPI_ERROR);
 
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Sleep, my_ThreadAPI_Sleep);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(worker_pool_create, TEST_WORKER_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(worker_pool_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(worker_pool_add, my_worker_pool_add);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(worker_pool_add, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(worker_pool_schedule, 0);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessaging_LL_GetPendingSendCount, my_IoTHubMessaging_LL_GetPendingSendCount);
+
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessaging_LL_Create, my_IoTHubMessaging_LL_Create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessaging_LL_Create, NULL);
 
@@ -250,10 +343,19 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     TEST_IOTHUB_MESSAGING_CLIENT.ThreadHandle = (THREAD_HANDLE)0x3535;
     TEST_IOTHUB_MESSAGING_CLIENT.LockHandle = (LOCK_HANDLE)0x3636;
     TEST_IOTHUB_MESSAGING_CLIENT.StopThread = (sig_atomic_t)0x3737;
+    TEST_IOTHUB_MESSAGING_CLIENT.WorkCondition = (COND_HANDLE)0x3838;
+
+    g_thread_func = NULL;
+    g_thread_func_arg = NULL;
+    g_how_thread_loops = 1;
+    g_pending_send_count = 0;
+    g_work_function = NULL;
+    g_work_context = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
 {
+    IoTHubMessaging_WorkerPool_Deinit();
     TEST_MUTEX_RELEASE(g_testByTest);
 }
 
@@ -272,6 +374,7 @@ TEST_FUNCTION(IoTHubMessaging_Create_return_null_if_input_parameter_serviceClien
 
 /*Tests_SRS_IOTHUBMESSAGING_12_002: [ IoTHubMessaging_Create shall allocate a new IoTHubMessagingClient instance. ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_004: [ IoTHubMessaging_Create shall create a lock object to be used later for serializing IoTHubMessagingClient calls. ]*/
+/*Tests_SRS_IOTHUBMESSAGING_41_026: [ IoTHubMessaging_Create shall create a condition used to wake up the worker thread when there is work for it. ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_006: [ IoTHubMessaging_Create shall instantiate a new IoTHubMessaging_LL instance by calling IoTHubMessaging_LL_Create and passing the serviceClientHandle argument. ]*/
 TEST_FUNCTION(IoTHubMessaging_Create_happy_path)
 {
@@ -280,6 +383,7 @@ TEST_FUNCTION(IoTHubMessaging_Create_happy_path)
         .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
     STRICT_EXPECTED_CALL(IoTHubMessaging_LL_Create(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -299,6 +403,7 @@ TEST_FUNCTION(IoTHubMessaging_Create_happy_path)
 }
 /*Tests_SRS_IOTHUBMESSAGING_12_003 : [ If allocating memory for the new IoTHubMessagingClient instance fails, then IoTHubMessaging_Create shall return NULL. ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_005 : [ If creating the lock fails, then IoTHubMessaging_Create shall return NULL. ]*/
+/*Tests_SRS_IOTHUBMESSAGING_41_027: [ If creating the condition fails, then IoTHubMessaging_Create shall return NULL. ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_007 : [ If IoTHubMessaging_LL_Create fails, then IoTHubMessaging_Create shall return NULL. ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_008 : [ If IoTHubMessaging_Create fails, all resources allocated by it shall be freed. ]*/
 TEST_FUNCTION(IoTHubMessaging_Create_non_happy_path)
@@ -311,6 +416,7 @@ TEST_FUNCTION(IoTHubMessaging_Create_non_happy_path)
         .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
     STRICT_EXPECTED_CALL(IoTHubMessaging_LL_Create(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -347,6 +453,7 @@ TEST_FUNCTION(IoTHubMessaging_Destroy_return_if_input_parameter_messagingHandle_
 /*Tests_SRS_IOTHUBMESSAGING_12_012: [ IoTHubMessaging_Destroy shall unlock the serializing lock. ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_013: [ The thread created as part of executing IoTHubMessaging_SendAsync shall be joined. ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_014: [ If the lock was allocated in IoTHubMessaging_Create, it shall be also freed. ]*/
+/*Tests_SRS_IOTHUBMESSAGING_41_032: [ IoTHubMessaging_Destroy shall free the work condition created in IoTHubMessaging_Create. ]*/
 TEST_FUNCTION(IoTHubMessaging_Destroy_happy_path)
 {
     // arrange
@@ -360,6 +467,8 @@ TEST_FUNCTION(IoTHubMessaging_Destroy_happy_path)
     STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
 
@@ -467,6 +576,7 @@ TEST_FUNCTION(IoTHubMessaging_Close_happy_path_thread_handle_null)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
 
     STRICT_EXPECTED_CALL(IoTHubMessaging_LL_Close(TEST_IOTHUB_MESSAGING_HANDLE));
 
@@ -484,6 +594,7 @@ TEST_FUNCTION(IoTHubMessaging_Close_happy_path_thread_handle_null)
 /*Tests_SRS_IOTHUBMESSAGING_12_024: [ IoTHubMessaging_Close shall call IoTHubMessaging_LL_Close, while passing the IOTHUB_MESSAGING_HANDLE handle created by IoTHubMessaging_Create ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_025: [ When IoTHubMessaging_LL_Close is called, IoTHubMessaging_Close shall return the result of IoTHubMessaging_LL_Close. ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_026: [ IoTHubMessaging_Close shall be made thread-safe by using the lock created in IoTHubMessaging_Create. ]*/
+/*Tests_SRS_IOTHUBMESSAGING_41_030: [ IoTHubMessaging_Close shall post the work condition, so the worker thread sees the stop request without waiting for its timeout. ]*/
 TEST_FUNCTION(IoTHubMessaging_Close_happy_path_thread_handle_not_null)
 {
     // arrange
@@ -498,6 +609,7 @@ TEST_FUNCTION(IoTHubMessaging_Close_happy_path_thread_handle_not_null)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
 
     STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .IgnoreAllArguments();
@@ -527,6 +639,7 @@ TEST_FUNCTION(IoTHubMessaging_Close_Lock_fails)
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
 
     STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .IgnoreAllArguments();
@@ -624,6 +737,7 @@ TEST_FUNCTION(IoTHubMessaging_SendAsync_return_IOTHUB_MESSAGING_INVALID_ARG_if_i
 /*Tests_SRS_IOTHUBMESSAGING_12_038: [ IoTHubMessaging_SendAsync shall call IoTHubMessaging_LL_Send, while passing the IOTHUB_MESSAGING_HANDLE handle created by IoTHubClient_Create and the parameters deviceId, message, sendCompleteCallback and userContextCallback.*/
 /*Tests_SRS_IOTHUBMESSAGING_12_039: [ When IoTHubMessaging_LL_Send is called, IoTHubMessaging_SendAsync shall return the result of IoTHubMessaging_LL_Send. ]*/
 /*Tests_SRS_IOTHUBMESSAGING_12_040: [ IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create. ]*/
+/*Tests_SRS_IOTHUBMESSAGING_41_031: [ IoTHubMessaging_SendAsync shall post the work condition, so the worker thread calls IoTHubMessaging_LL_DoWork for the message without waiting for its timeout. ]*/
 TEST_FUNCTION(IoTHubMessaging_SendAsync_happy_path)
 {
     // arrange
@@ -642,6 +756,7 @@ TEST_FUNCTION(IoTHubMessaging_SendAsync_happy_path)
         .IgnoreAllArguments();
 
     STRICT_EXPECTED_CALL(IoTHubMessaging_LL_Send((IOTHUB_MESSAGING_HANDLE)0X3333, deviceId, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)0x4242));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -677,6 +792,7 @@ TEST_FUNCTION(IoTHubMessaging_SendAsync_happy_path_threadhandle_not_null)
         .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(IoTHubMessaging_LL_Send((IOTHUB_MESSAGING_HANDLE)0X3333, deviceId, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)0x4242));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -750,4 +866,412 @@ TEST_FUNCTION(IoTHubMessaging_ThreadAPI_Create_fails)
     free(messagingClientHandle);
 }
 
+static IOTHUB_MESSAGING_CLIENT_HANDLE create_messaging_client_with_worker_thread(void)
+{
+    const char* deviceId = "42";
+
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = IoTHubMessaging_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE* messagingClientInstance = (TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE*)messagingClientHandle;
+    messagingClientInstance->IoTHubMessagingHandle = (IOTHUB_MESSAGING_HANDLE)0X3333;
+
+    (void)IoTHubMessaging_SendAsync(messagingClientHandle, deviceId, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)0x4242);
+    ASSERT_IS_NOT_NULL(g_thread_func);
+
+    umock_c_reset_all_calls();
+
+    return messagingClientHandle;
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_12_042: [ The thread created by IoTHubMessaging_SendAsync shall call IoTHubMessaging_LL_DoWork, then wait on the work condition with the lock created in IoTHubMessaging_Create before calling it again. ]*/
+/*Tests_SRS_IOTHUBMESSAGING_12_043: [ All calls to IoTHubMessaging_LL_DoWork shall be protected by the lock created in IoTHubMessaging_Create. ]*/
+/*Tests_SRS_IOTHUBMESSAGING_41_029: [ Otherwise the thread shall wait on the work condition for at most 100 ms. ]*/
+/*Tests_SRS_IOTHUBMESSAGING_12_041: [ The thread shall exit when all IoTHubServiceClients using the thread have had IoTHubMessaging_Destroy called. ]*/
+TEST_FUNCTION(IoTHubMessaging_ScheduleWork_Thread_waits_100_ms_when_no_send_is_pending)
+{
+    // arrange
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = create_messaging_client_with_worker_thread();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_DoWork((IOTHUB_MESSAGING_HANDLE)0X3333));
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_GetPendingSendCount((IOTHUB_MESSAGING_HANDLE)0X3333, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_028: [ While IoTHubMessaging_LL_GetPendingSendCount reports pending sends, or if it fails, the thread shall wait on the work condition for 1 ms only. ]*/
+TEST_FUNCTION(IoTHubMessaging_ScheduleWork_Thread_waits_1_ms_while_sends_are_pending)
+{
+    // arrange
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = create_messaging_client_with_worker_thread();
+    g_pending_send_count = 2;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_DoWork((IOTHUB_MESSAGING_HANDLE)0X3333));
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_GetPendingSendCount((IOTHUB_MESSAGING_HANDLE)0X3333, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 1));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_028: [ While IoTHubMessaging_LL_GetPendingSendCount reports pending sends, or if it fails, the thread shall wait on the work condition for 1 ms only. ]*/
+TEST_FUNCTION(IoTHubMessaging_ScheduleWork_Thread_waits_1_ms_when_GetPendingSendCount_fails)
+{
+    // arrange
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = create_messaging_client_with_worker_thread();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_DoWork((IOTHUB_MESSAGING_HANDLE)0X3333));
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_GetPendingSendCount((IOTHUB_MESSAGING_HANDLE)0X3333, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(IOTHUB_MESSAGING_ERROR);
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 1));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_12_044: [ If acquiring the lock fails, `IoTHubMessaging_LL_DoWork` shall not be called. ]*/
+TEST_FUNCTION(IoTHubMessaging_ScheduleWork_Thread_Lock_fails_sleeps_1_ms_without_DoWork)
+{
+    // arrange
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = create_messaging_client_with_worker_thread();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_033: [ If threadCount is 0, IoTHubMessaging_WorkerPool_Init shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubMessaging_WorkerPool_Init_with_0_threads_fails)
+{
+    // act
+    IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_WorkerPool_Init(0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_035: [ IoTHubMessaging_WorkerPool_Init shall create the process wide worker pool by calling worker_pool_create with threadCount. ]*/
+TEST_FUNCTION(IoTHubMessaging_WorkerPool_Init_happy_path)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(worker_pool_create(4));
+
+    // act
+    IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_WorkerPool_Init(4);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_034: [ If the worker pool is already initialized, IoTHubMessaging_WorkerPool_Init shall return IOTHUB_MESSAGING_ERROR. ]*/
+TEST_FUNCTION(IoTHubMessaging_WorkerPool_Init_twice_fails)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, IoTHubMessaging_WorkerPool_Init(4));
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_WorkerPool_Init(4);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_036: [ If worker_pool_create fails, IoTHubMessaging_WorkerPool_Init shall return IOTHUB_MESSAGING_ERROR. ]*/
+TEST_FUNCTION(IoTHubMessaging_WorkerPool_Init_worker_pool_create_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(worker_pool_create(4))
+        .SetReturn(NULL);
+
+    // act
+    IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_WorkerPool_Init(4);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_037: [ IoTHubMessaging_WorkerPool_Deinit shall destroy the process wide worker pool, if any. ]*/
+TEST_FUNCTION(IoTHubMessaging_WorkerPool_Deinit_destroys_the_worker_pool)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, IoTHubMessaging_WorkerPool_Init(4));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(worker_pool_destroy(TEST_WORKER_POOL_HANDLE));
+
+    // act
+    IoTHubMessaging_WorkerPool_Deinit();
+    IoTHubMessaging_WorkerPool_Deinit();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_038: [ If the worker pool is initialized, IoTHubMessaging_SendAsync shall add the client to the worker pool by calling worker_pool_add instead of starting a dedicated thread. ]*/
+/*Tests_SRS_IOTHUBMESSAGING_41_040: [ If the client was added to the worker pool, IoTHubMessaging_SendAsync shall call worker_pool_schedule instead of posting the work condition. ]*/
+TEST_FUNCTION(IoTHubMessaging_SendAsync_with_worker_pool_adds_the_client_to_the_pool)
+{
+    // arrange
+    const char* deviceId = "42";
+
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, IoTHubMessaging_WorkerPool_Init(4));
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = IoTHubMessaging_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE* messagingClientInstance = (TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE*)messagingClientHandle;
+    messagingClientInstance->IoTHubMessagingHandle = (IOTHUB_MESSAGING_HANDLE)0X3333;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(worker_pool_add(TEST_WORKER_POOL_HANDLE, IGNORED_PTR_ARG, messagingClientHandle))
+        .IgnoreArgument_work_function();
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_Send((IOTHUB_MESSAGING_HANDLE)0X3333, deviceId, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)0x4242));
+    STRICT_EXPECTED_CALL(worker_pool_schedule(TEST_WORKER_POOL_ITEM_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_SendAsync(messagingClientHandle, deviceId, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)0x4242);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(g_thread_func);
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_039: [ If worker_pool_add fails, IoTHubMessaging_SendAsync shall return IOTHUB_MESSAGING_ERROR. ]*/
+TEST_FUNCTION(IoTHubMessaging_SendAsync_worker_pool_add_fails)
+{
+    // arrange
+    const char* deviceId = "42";
+
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, IoTHubMessaging_WorkerPool_Init(4));
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = IoTHubMessaging_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(worker_pool_add(TEST_WORKER_POOL_HANDLE, IGNORED_PTR_ARG, messagingClientHandle))
+        .IgnoreArgument_work_function()
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_SendAsync(messagingClientHandle, deviceId, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)0x4242);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+static IOTHUB_MESSAGING_CLIENT_HANDLE create_messaging_client_in_worker_pool(void)
+{
+    const char* deviceId = "42";
+
+    ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, IoTHubMessaging_WorkerPool_Init(4));
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = IoTHubMessaging_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE* messagingClientInstance = (TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE*)messagingClientHandle;
+    messagingClientInstance->IoTHubMessagingHandle = (IOTHUB_MESSAGING_HANDLE)0X3333;
+
+    (void)IoTHubMessaging_SendAsync(messagingClientHandle, deviceId, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)0x4242);
+    ASSERT_IS_NOT_NULL(g_work_function);
+
+    umock_c_reset_all_calls();
+
+    return messagingClientHandle;
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_041: [ The work function run by the worker pool shall call IoTHubMessaging_LL_DoWork under the lock created in IoTHubMessaging_Create, then ask to be run again after 1 ms while IoTHubMessaging_LL_GetPendingSendCount reports pending sends or fails, and after 100 ms otherwise. ]*/
+TEST_FUNCTION(IoTHubMessaging_ScheduleWork_WorkerPool_asks_for_100_ms_when_no_send_is_pending)
+{
+    // arrange
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = create_messaging_client_in_worker_pool();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_DoWork((IOTHUB_MESSAGING_HANDLE)0X3333));
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_GetPendingSendCount((IOTHUB_MESSAGING_HANDLE)0X3333, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    unsigned int result = g_work_function(g_work_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 100, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_041: [ The work function run by the worker pool shall call IoTHubMessaging_LL_DoWork under the lock created in IoTHubMessaging_Create, then ask to be run again after 1 ms while IoTHubMessaging_LL_GetPendingSendCount reports pending sends or fails, and after 100 ms otherwise. ]*/
+TEST_FUNCTION(IoTHubMessaging_ScheduleWork_WorkerPool_asks_for_1_ms_while_sends_are_pending)
+{
+    // arrange
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = create_messaging_client_in_worker_pool();
+    g_pending_send_count = 2;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_DoWork((IOTHUB_MESSAGING_HANDLE)0X3333));
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_GetPendingSendCount((IOTHUB_MESSAGING_HANDLE)0X3333, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    unsigned int result = g_work_function(g_work_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 1, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_042: [ If acquiring the lock fails, the work function shall not call IoTHubMessaging_LL_DoWork and shall ask to be run again after 1 ms. ]*/
+TEST_FUNCTION(IoTHubMessaging_ScheduleWork_WorkerPool_Lock_fails_asks_for_1_ms_without_DoWork)
+{
+    // arrange
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = create_messaging_client_in_worker_pool();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    unsigned int result = g_work_function(g_work_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 1, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_043: [ If the client was added to the worker pool, IoTHubMessaging_Close shall remove it by calling worker_pool_remove, which waits for a running work function to finish, instead of posting the work condition and joining a thread. ]*/
+TEST_FUNCTION(IoTHubMessaging_Close_with_worker_pool_removes_the_client_from_the_pool)
+{
+    // arrange
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = create_messaging_client_in_worker_pool();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(worker_pool_remove(TEST_WORKER_POOL_ITEM_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_Close((IOTHUB_MESSAGING_HANDLE)0X3333));
+
+    // act
+    IoTHubMessaging_Close(messagingClientHandle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(((TEST_IOTHUB_MESSAGING_CLIENT_INSTANCE*)messagingClientHandle)->WorkerPoolItem);
+
+    // cleanup
+    free(messagingClientHandle);
+}
+
+/*Tests_SRS_IOTHUBMESSAGING_41_044: [ If IoTHubMessaging_Close was not called, IoTHubMessaging_Destroy shall remove the client from the worker pool, waiting for a running work function to finish, before calling IoTHubMessaging_LL_Destroy. ]*/
+TEST_FUNCTION(IoTHubMessaging_Destroy_with_worker_pool_removes_the_client_from_the_pool)
+{
+    // arrange
+    IOTHUB_MESSAGING_CLIENT_HANDLE messagingClientHandle = create_messaging_client_in_worker_pool();
+
+    STRICT_EXPECTED_CALL(worker_pool_remove(TEST_WORKER_POOL_ITEM_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessaging_LL_Destroy((IOTHUB_MESSAGING_HANDLE)0X3333));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    IoTHubMessaging_Destroy(messagingClientHandle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 END_TEST_SUITE(iothub_messaging_ut)
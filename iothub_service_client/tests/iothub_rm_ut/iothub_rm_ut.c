@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #endif
+#include <string.h>
 
 #include "testrunnerswitcher.h"
 #include "umock_c.h"
@@ -18,11 +19,11 @@
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/httpapiex.h"
-#include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "parson.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "iothub_sc_http_pool.h"
 
 MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
 MOCKABLE_FUNCTION(, const char*, json_object_get_string, const JSON_Object *, object, const char *, name);
@@ -31,6 +32,7 @@ MOCKABLE_FUNCTION(, double, json_object_get_number, const JSON_Object*, object,
 MOCKABLE_FUNCTION(, char*, json_serialize_to_string, const JSON_Value*, value);
 MOCKABLE_FUNCTION(, void, json_free_serialized_string, char*, string);
 MOCKABLE_FUNCTION(, const char*, json_object_dotget_string, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, JSON_Object*, json_object_get_object, const JSON_Object*, object, const char*, name);
 MOCKABLE_FUNCTION(, JSON_Status, json_object_set_string, JSON_Object*, object, const char*, name, const char*, string);
 MOCKABLE_FUNCTION(, JSON_Status, json_object_dotset_string, JSON_Object*, object, const char*, name, const char*, string);
 MOCKABLE_FUNCTION(, JSON_Value*, json_value_init_object);
@@ -41,6 +43,10 @@ MOCKABLE_FUNCTION(, size_t, json_array_get_count, const JSON_Array*, array);
 MOCKABLE_FUNCTION(, JSON_Status, json_array_clear, JSON_Array*, array);
 MOCKABLE_FUNCTION(, JSON_Status, json_object_clear, JSON_Object*, object);
 MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value *, value);
+MOCKABLE_FUNCTION(, JSON_Value*, json_value_init_array);
+MOCKABLE_FUNCTION(, JSON_Status, json_array_append_value, JSON_Array*, array, JSON_Value*, value);
+MOCKABLE_FUNCTION(, JSON_Array*, json_object_get_array, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_set_boolean, JSON_Object*, object, const char*, name, int, boolean);
 #undef ENABLE_MOCKS
 
 static TEST_MUTEX_HANDLE g_testByTest;
@@ -84,47 +90,100 @@ void my_BUFFER_delete(BUFFER_HANDLE handle)
     free(handle);
 }
 
-HTTPAPIEX_HANDLE my_HTTPAPIEX_Create(const char* hostName)
+static void* my_gballoc_malloc(size_t size)
 {
-    (void)hostName;
-    return (HTTPAPIEX_HANDLE)malloc(1);
+    return malloc(size);
 }
 
-void my_HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
+static void my_gballoc_free(void* ptr)
 {
-    free(handle);
+    free(ptr);
 }
 
-HTTPAPIEX_SAS_HANDLE my_HTTPAPIEX_SAS_Create(STRING_HANDLE key, STRING_HANDLE uriResource, STRING_HANDLE keyName)
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
 {
-    (void)key;
-    (void)uriResource;
-    (void)keyName;
-    return (HTTPAPIEX_SAS_HANDLE)malloc(1);
+    char* p = (char*)malloc(2);
+    p[0] = source[0];
+    p[1] = '\0';
+    *destination = p;
+    return 0;
 }
 
-void my_HTTPAPIEX_SAS_Destroy(HTTPAPIEX_SAS_HANDLE handle)
+static const LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4747;
+static const THREAD_HANDLE TEST_THREAD_HANDLE = (THREAD_HANDLE)0x4848;
+
+static THREAD_START_FUNC g_thread_func;
+static void* g_thread_func_arg;
+static size_t g_thread_create_count;
+static size_t g_execute_request_count;
+static unsigned int g_execute_request_status_code;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
 {
-    free(handle);
+    *threadHandle = TEST_THREAD_HANDLE;
+    g_thread_func = func;
+    g_thread_func_arg = arg;
+    g_thread_create_count++;
+    return THREADAPI_OK;
 }
 
-static void* my_gballoc_malloc(size_t size)
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
 {
-    return malloc(size);
+    (void)threadHandle;
+    if (g_thread_func != NULL)
+    {
+        THREAD_START_FUNC thread_func = g_thread_func;
+        g_thread_func = NULL;
+        *res = thread_func(g_thread_func_arg);
+    }
+    return THREADAPI_OK;
 }
 
-static void my_gballoc_free(void* ptr)
+static HTTPAPIEX_RESULT my_IoTHubScHttpPool_ExecuteRequest(IOTHUB_SC_HTTP_POOL_HANDLE httpPool, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, BUFFER_HANDLE responseContent)
 {
-    free(ptr);
+    (void)httpPool;
+    (void)requestType;
+    (void)relativePath;
+    (void)requestHttpHeadersHandle;
+    (void)requestContent;
+    (void)responseContent;
+    g_execute_request_count++;
+    *statusCode = g_execute_request_status_code;
+    return HTTPAPIEX_OK;
 }
 
-static int my_mallocAndStrcpy_s(char** destination, const char* source)
+static HTTPAPIEX_RESULT my_IoTHubScHttpPool_ExecuteRequestWithResponseHeaders(IOTHUB_SC_HTTP_POOL_HANDLE httpPool, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
 {
-    char* p = (char*)malloc(2);
-    p[0] = source[0];
-    p[1] = '\0';
-    *destination = p;
-    return 0;
+    (void)responseHttpHeadersHandle;
+    return my_IoTHubScHttpPool_ExecuteRequest(httpPool, requestType, relativePath, requestHttpHeadersHandle, requestContent, statusCode, responseContent);
+}
+
+static size_t g_json_array_count;
+static size_t g_continuation_page_count;
+static size_t g_device_callback_count;
+static size_t g_device_callback_stop_after;
+
+static size_t my_json_array_get_count(const JSON_Array* array)
+{
+    (void)array;
+    return g_json_array_count;
+}
+
+static const char* my_HTTPHeaders_FindHeaderValue(HTTP_HEADERS_HANDLE httpHeadersHandle, const char* name)
+{
+    const char* result;
+    (void)httpHeadersHandle;
+    (void)name;
+    if (g_continuation_page_count > 0)
+    {
+        g_continuation_page_count--;
+        result = "theContinuationToken";
+    }
+    else
+    {
+        result = NULL;
+    }
+    return result;
 }
 
 typedef struct LIST_ITEM_INSTANCE_TAG
@@ -370,7 +429,6 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
 TEST_DEFINE_ENUM_TYPE(IOTHUB_REGISTRYMANAGER_AUTH_METHOD, IOTHUB_REGISTRYMANAGER_AUTH_METHOD_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_REGISTRYMANAGER_AUTH_METHOD, IOTHUB_REGISTRYMANAGER_AUTH_METHOD_VALUES);
 
-
 static const char* TEST_DEVICE_ID = "theDeviceId";
 static const char* TEST_PRIMARYKEY = "thePrimaryKey";
 static const char* TEST_SECONDARYKEY = "theSecondaryKey";
@@ -397,6 +455,9 @@ static IOTHUB_REGISTRY_STATISTICS TEST_IOTHUB_REGISTRY_STATISTICS;
 static JSON_Value* TEST_JSON_VALUE = (JSON_Value*)0x5050;
 static JSON_Object* TEST_JSON_OBJECT = (JSON_Object*)0x5151;
 static JSON_Array* TEST_JSON_ARRAY = (JSON_Array*)0x5252;
+static JSON_Object* TEST_JSON_OBJECT_AUTHENTICATION = (JSON_Object*)0x5353;
+static JSON_Object* TEST_JSON_OBJECT_SYMMETRIC_KEY = (JSON_Object*)0x5454;
+static JSON_Object* TEST_JSON_OBJECT_X509_THUMBPRINT = (JSON_Object*)0x5555;
 static JSON_Status TEST_JSON_STATUS = 0;
 
 static char* TEST_CHAR_PTR = "TestString";
@@ -412,7 +473,7 @@ static const unsigned int httpStatusCodeOk = 200;
 static const unsigned int httpStatusCodeBadRequest = 400;
 static const unsigned int httpStatusCodeDeviceExists = 409;
 static const HTTPAPIEX_HANDLE TEST_HTTPAPIEX_HANDLE = (HTTPAPIEX_HANDLE)0x4343;
-static HTTPAPIEX_SAS_HANDLE TEST_HTTPAPIEX_SAS_HANDLE = (HTTPAPIEX_SAS_HANDLE)0x4444;
+static const IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4646;
 static const HTTP_HEADERS_HANDLE TEST_HTTP_HEADERS_HANDLE = (HTTP_HEADERS_HANDLE)0x4545;
 static const HTTP_HEADERS_RESULT TEST_HTTP_HEADERS_RESULT = (HTTP_HEADERS_RESULT)0x1;
 static HTTPAPIEX_RESULT TEST_HTTPAPIEX_RESULT = (HTTPAPIEX_RESULT)0x1;
@@ -422,6 +483,13 @@ static const char* TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY = "authentication.sym
 static const char* TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY = "authentication.symmetricKey.secondaryKey";
 static const char* TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT = "authentication.x509Thumbprint.primaryThumbprint";
 static const char* TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT = "authentication.x509Thumbprint.secondaryThumbprint";
+static const char* TEST_DEVICE_JSON_KEY_AUTHENTICATION = "authentication";
+static const char* TEST_DEVICE_JSON_KEY_SYMMETRIC_KEY = "symmetricKey";
+static const char* TEST_DEVICE_JSON_KEY_X509_THUMBPRINT = "x509Thumbprint";
+static const char* TEST_DEVICE_JSON_KEY_PRIMARY_KEY = "primaryKey";
+static const char* TEST_DEVICE_JSON_KEY_SECONDARY_KEY = "secondaryKey";
+static const char* TEST_DEVICE_JSON_KEY_PRIMARY_THUMBPRINT = "primaryThumbprint";
+static const char* TEST_DEVICE_JSON_KEY_SECONDARY_THUMBPRINT = "secondaryThumbprint";
 static const char* TEST_DEVICE_JSON_KEY_DEVICE_GENERATION_ID = "generationId";
 static const char* TEST_DEVICE_JSON_KEY_DEVICE_ETAG = "etag";
 static const char* TEST_DEVICE_JSON_KEY_DEVICE_CONNECTIONSTATE = "connectionState";
@@ -474,6 +542,30 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
     ASSERT_FAIL(temp_str);
 }
 
+static bool test_device_callback(const IOTHUB_DEVICE* device, void* userContextCallback)
+{
+    (void)userContextCallback;
+    ASSERT_IS_NOT_NULL(device);
+    g_device_callback_count++;
+    return (g_device_callback_count != g_device_callback_stop_after);
+}
+
+static void register_device_query_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders, my_IoTHubScHttpPool_ExecuteRequestWithResponseHeaders);
+    REGISTER_GLOBAL_MOCK_HOOK(json_array_get_count, my_json_array_get_count);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_FindHeaderValue, my_HTTPHeaders_FindHeaderValue);
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_u_char, TEST_UNSIGNED_CHAR_PTR);
+}
+
+static void unregister_device_query_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(json_array_get_count, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_FindHeaderValue, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_u_char, NULL);
+}
+
 BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
     TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -499,13 +591,19 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(HTTP_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
-        REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SC_HTTP_POOL_HANDLE, void*);
 
         REGISTER_UMOCK_ALIAS_TYPE(JSON_Value, void*);
         REGISTER_UMOCK_ALIAS_TYPE(JSON_Object, void*);
         REGISTER_UMOCK_ALIAS_TYPE(JSON_Status, int);
         REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(JSON_Array, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+        REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
 
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -557,18 +655,11 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_ERROR);
 
-        REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
-        REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
-
-        REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Destroy, my_HTTPAPIEX_Destroy);
-
-        REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_SAS_Create, my_HTTPAPIEX_SAS_Create);
-        REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_Create, NULL);
+        REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_Clone, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubScHttpPool_Clone, NULL);
 
-        REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_SAS_Destroy, my_HTTPAPIEX_SAS_Destroy);
-
-        REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_OK);
-        REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_ERROR);
+        REGISTER_GLOBAL_MOCK_RETURN(IoTHubScHttpPool_ExecuteRequest, HTTPAPIEX_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubScHttpPool_ExecuteRequest, HTTPAPIEX_ERROR);
 
         REGISTER_GLOBAL_MOCK_RETURN(json_value_init_object, TEST_JSON_VALUE);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_init_object, NULL);
@@ -585,6 +676,9 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         REGISTER_GLOBAL_MOCK_RETURN(json_object_dotget_string, TEST_CONST_CHAR_PTR);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_dotget_string, NULL);
 
+        REGISTER_GLOBAL_MOCK_RETURN(json_object_get_object, TEST_JSON_OBJECT);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_get_object, NULL);
+
         REGISTER_GLOBAL_MOCK_RETURN(json_object_set_string, TEST_JSON_STATUS);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_set_string, -1);
 
@@ -611,6 +705,26 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         REGISTER_GLOBAL_MOCK_RETURN(json_array_clear, JSONSuccess);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_array_clear, JSONFailure);
+
+        REGISTER_GLOBAL_MOCK_RETURN(json_value_init_array, TEST_JSON_VALUE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_init_array, NULL);
+
+        REGISTER_GLOBAL_MOCK_RETURN(json_array_append_value, JSONSuccess);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_array_append_value, JSONFailure);
+
+        REGISTER_GLOBAL_MOCK_RETURN(json_object_set_boolean, JSONSuccess);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_set_boolean, JSONFailure);
+
+        REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+        REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+        REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+        REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+        REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -634,12 +748,14 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubSuffix = TEST_IOTHUBSUFFIX;
         TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
         TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = TEST_SHAREDACCESSKEY;
+        TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
 
         TEST_IOTHUB_REGISTRYMANAGER.hostname = TEST_HOSTNAME;
         TEST_IOTHUB_REGISTRYMANAGER.iothubName = TEST_IOTHUBNAME;
         TEST_IOTHUB_REGISTRYMANAGER.iothubSuffix = TEST_IOTHUBSUFFIX;
         TEST_IOTHUB_REGISTRYMANAGER.keyName = TEST_SHAREDACCESSKEYNAME;
         TEST_IOTHUB_REGISTRYMANAGER.sharedAccessKey = TEST_SHAREDACCESSKEY;
+        TEST_IOTHUB_REGISTRYMANAGER.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
 
         TEST_IOTHUB_REGISTRY_DEVICE_CREATE.deviceId = TEST_DEVICE_ID;
         TEST_IOTHUB_REGISTRY_DEVICE_CREATE.primaryKey = TEST_PRIMARYKEY;
@@ -656,6 +772,16 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         TEST_IOTHUB_DEVICE.primaryKey = TEST_PRIMARYKEY;
         TEST_IOTHUB_DEVICE.secondaryKey = TEST_SECONDARYKEY;
         TEST_IOTHUB_DEVICE.status = IOTHUB_DEVICE_STATUS_DISABLED;
+
+        g_thread_func = NULL;
+        g_thread_func_arg = NULL;
+        g_thread_create_count = 0;
+        g_execute_request_count = 0;
+        g_execute_request_status_code = httpStatusCodeOk;
+        g_json_array_count = 0;
+        g_continuation_page_count = 0;
+        g_device_callback_count = 0;
+        g_device_callback_stop_after = 0;
     }
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -775,6 +901,56 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments();
 
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
+        // act
+        IOTHUB_REGISTRYMANAGER_HANDLE result = IoTHubRegistryManager_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+        // assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_SC_HTTP_POOL_HANDLE, result->httpPool);
+
+        ///cleanup
+        if (result != NULL)
+        {
+            free(result->hostname);
+            free(result->iothubName);
+            free(result->iothubSuffix);
+            free(result->keyName);
+            free(result->sharedAccessKey);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_001: [ IoTHubRegistryManager_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none. If this fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+    TEST_FUNCTION(IoTHubRegistryManager_Create_creates_its_own_HTTP_pool_if_the_auth_handle_has_none)
+    {
+        // arrange
+        TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = NULL;
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME))
+            .SetReturn(TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+
         // act
         IOTHUB_REGISTRYMANAGER_HANDLE result = IoTHubRegistryManager_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
 
@@ -801,6 +977,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_090: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_092: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_094: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ]*/
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_001: [ IoTHubRegistryManager_Create shall share the HTTP connection pool of the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE by calling IoTHubScHttpPool_Clone, or create its own by calling IoTHubScHttpPool_Create if the IOTHUB_SERVICE_CLIENT_AUTH_HANDLE has none. If this fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
     TEST_FUNCTION(IoTHubRegistryManager_Create_non_happy_path)
     {
         // arrange
@@ -825,7 +1002,8 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, (const char*)(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE->keyName)))
             .IgnoreArgument(1);
 
-        
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
         umock_c_negative_tests_snapshot();
 
         ///act
@@ -859,6 +1037,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
     }
 
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_006 : [ If the registryManagerHandle input parameter is not NULL IoTHubRegistryManager_Destroy shall free the memory of it and return ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_003: [ IoTHubRegistryManager_Destroy shall release its reference to the HTTP connection pool by calling IoTHubScHttpPool_Destroy ] */
     TEST_FUNCTION(IoTHubRegistryManager_Destroy_do_clean_up_and_return_if_input_parameter_registryManagerHandle_is_not_NULL)
     {
         // arrange
@@ -876,6 +1055,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
@@ -981,12 +1161,11 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     }
 
-
-
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_010: [ IoTHubRegistryManager_CreateDevice shall create a flat "key1:value2,key2:value2..." JSON representation from the given deviceCreateInfo parameter using the following parson APIs: json_value_init_object, json_value_get_object, json_object_set_string, json_object_dotset_string ]*/
     /* Tests__SRS_IOTHUBREGISTRYMANAGER_06_002: [ IoTHubRegistryManager_CreateDevice shall, if deviceCreateInfo->authMethod is equal to "IOTHUB_REGISTRYMANAGER_AUTH_SPK", set "authorization.symmetricKey.primaryKey" to deviceCreateInfo->primaryKey and "authorization.symmetricKey.secondaryKey" to deviceCreateInfo->secondaryKey ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_024: [ If the deviceInfo out parameter is not NULL IoTHubRegistryManager_CreateDevice shall save the received deviceInfo to the out parameter and return IOTHUB_REGISTRYMANAGER_OK ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_100: [ IoTHubRegistryManager_CreateDevice shall do clean up before return ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_002: [ IoTHubRegistryManager shall execute every HTTP request on the shared HTTP connection pool by calling IoTHubScHttpPool_ExecuteRequest ] */
     TEST_FUNCTION(IoTHubRegistryManager_CreateDevice_happy_path_status_code_200)
     {
         // arrange
@@ -1014,10 +1193,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -1030,35 +1205,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -1072,9 +1229,15 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
             .SetReturn(TEST_DEVICE_ID);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_AUTHENTICATION))
+            .SetReturn(TEST_JSON_OBJECT_AUTHENTICATION);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_SYMMETRIC_KEY))
+            .SetReturn(TEST_JSON_OBJECT_SYMMETRIC_KEY);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_X509_THUMBPRINT))
+            .SetReturn(TEST_JSON_OBJECT_X509_THUMBPRINT);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_PRIMARY_KEY))
             .SetReturn(TEST_PRIMARYKEY);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_SECONDARY_KEY))
             .SetReturn(TEST_SECONDARYKEY);
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_GENERATION_ID))
             .SetReturn(TEST_GENERATIONID);
@@ -1199,10 +1362,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -1215,35 +1374,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -1257,9 +1398,15 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
             .SetReturn(TEST_DEVICE_ID);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_AUTHENTICATION))
+            .SetReturn(TEST_JSON_OBJECT_AUTHENTICATION);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_SYMMETRIC_KEY))
+            .SetReturn(TEST_JSON_OBJECT_SYMMETRIC_KEY);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_X509_THUMBPRINT))
+            .SetReturn(TEST_JSON_OBJECT_X509_THUMBPRINT);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_PRIMARY_KEY))
             .SetReturn(TEST_PRIMARYKEY);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_SECONDARY_KEY))
             .SetReturn(TEST_SECONDARYKEY);
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_GENERATION_ID))
             .SetReturn(TEST_GENERATIONID);
@@ -1358,7 +1505,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         free((void*)deviceInfo.serviceProperties);
     }
 
-
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_020: [ IoTHubRegistryManager_CreateDevice shall verify the received HTTP status code and if it is 409 then return IOTHUB_REGISTRYMANAGER_DEVICE_EXIST ]*/
     TEST_FUNCTION(IoTHubRegistryManager_CreateDevice_happy_path_status_code_409)
     {
@@ -1389,10 +1535,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -1405,35 +1547,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeDeviceExists, sizeof(httpStatusCodeDeviceExists))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -1484,10 +1608,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -1500,35 +1620,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeBadRequest, sizeof(httpStatusCodeBadRequest))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -1585,10 +1687,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -1601,35 +1699,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeBadRequest, sizeof(httpStatusCodeBadRequest))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -1652,15 +1732,10 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
             if (
                 (i != 8) && /*json_free_serialized_string*/
                 (i != 10) && /*json_value_free*/
-                (i != 24) && /*HTTPHeaders_Free*/
-                (i != 25) && /*HTTPAPIEX_Destroy*/
-                (i != 26) && /*HTTPAPIEX_SAS_Destroy*/
-                (i != 27) && /*STRING_delete*/
-                (i != 28) && /*STRING_delete*/
-                (i != 29) && /*STRING_delete*/
-                (i != 30) && /*BUFFER_delete*/
-                (i != 31) && /*BUFFER_delete*/
-                (i != 32) /*gballoc_free*/
+                (i != 19) && /*HTTPHeaders_Free*/
+                (i != 20) && /*BUFFER_delete*/
+                (i != 21) && /*BUFFER_delete*/
+                (i != 22) /*gballoc_free*/
                 )
             {
                 IOTHUB_DEVICE deviceInfo;
@@ -1704,9 +1779,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_026: [ IoTHubRegistryManager_GetDevice shall create HTTP GET request URL using the given deviceId using the following format: url/devices/[deviceId]?api-version=2016-11-14  ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_027: [ IoTHubRegistryManager_GetDevice shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_028: [ IoTHubRegistryManager_GetDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_029: [ IoTHubRegistryManager_GetDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_030: [ IoTHubRegistryManager_GetDevice shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ]*/
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_030: [ IoTHubRegistryManager_GetDevice shall execute the HTTP GET request by calling IoTHubScHttpPool_ExecuteRequest ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_06_008: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.symetricKey.primaryKey, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_SPK" ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_06_012: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.x509Thumbprint.secondaryThumbprint, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT" ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_06_010: [ IoTHubRegistryManager_GetDevice shall, if json was found for authorization.symetricKey.secondaryKey, set the device info authMethod to "IOTHUB_REGISTRYMANAGER_AUTH_SPK" ] */
@@ -1715,10 +1788,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         ///arrange
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -1731,35 +1800,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -1773,9 +1824,15 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
             .SetReturn(TEST_DEVICE_ID);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_AUTHENTICATION))
+            .SetReturn(TEST_JSON_OBJECT_AUTHENTICATION);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_SYMMETRIC_KEY))
+            .SetReturn(TEST_JSON_OBJECT_SYMMETRIC_KEY);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_X509_THUMBPRINT))
+            .SetReturn(TEST_JSON_OBJECT_X509_THUMBPRINT);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_PRIMARY_KEY))
             .SetReturn(TEST_PRIMARYKEY);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_SECONDARY_KEY))
             .SetReturn(TEST_SECONDARYKEY);
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_GENERATION_ID))
             .SetReturn(TEST_GENERATIONID);
@@ -1841,7 +1898,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-
         ///act
         IOTHUB_DEVICE deviceInfo;
         IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetDevice(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_DEVICE_ID, &deviceInfo);
@@ -1871,10 +1927,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         ///arrange
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -1887,35 +1939,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -1929,9 +1963,15 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
             .SetReturn(TEST_DEVICE_ID);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_AUTHENTICATION))
+            .SetReturn(TEST_JSON_OBJECT_AUTHENTICATION);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_SYMMETRIC_KEY))
+            .SetReturn(TEST_JSON_OBJECT_SYMMETRIC_KEY);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_X509_THUMBPRINT))
+            .SetReturn(TEST_JSON_OBJECT_X509_THUMBPRINT);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_PRIMARY_KEY))
             .SetReturn(NULL);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_SECONDARY_KEY))
             .SetReturn(NULL);
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_GENERATION_ID))
             .SetReturn(TEST_GENERATIONID);
@@ -1964,12 +2004,11 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SERVICEPROPERTIES))
             .SetReturn(TEST_SERVICEPROPERTIES);
 
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_X509_THUMBPRINT, TEST_DEVICE_JSON_KEY_PRIMARY_THUMBPRINT))
             .SetReturn(TEST_PRIMARYKEY);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_X509_THUMBPRINT, TEST_DEVICE_JSON_KEY_SECONDARY_THUMBPRINT))
             .SetReturn(TEST_SECONDARYKEY);
 
-
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2003,7 +2042,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-
         ///act
         IOTHUB_DEVICE deviceInfo;
         IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetDevice(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_DEVICE_ID, &deviceInfo);
@@ -2042,10 +2080,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -2058,35 +2092,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -2100,9 +2116,15 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
             .SetReturn(TEST_DEVICE_ID);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_AUTHENTICATION))
+            .SetReturn(TEST_JSON_OBJECT_AUTHENTICATION);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_SYMMETRIC_KEY))
+            .SetReturn(TEST_JSON_OBJECT_SYMMETRIC_KEY);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_X509_THUMBPRINT))
+            .SetReturn(TEST_JSON_OBJECT_X509_THUMBPRINT);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_PRIMARY_KEY))
             .SetReturn(TEST_PRIMARYKEY);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_SECONDARY_KEY))
             .SetReturn(TEST_SECONDARYKEY);
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_GENERATION_ID))
             .SetReturn(TEST_GENERATIONID);
@@ -2181,31 +2203,29 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
             umock_c_negative_tests_fail_call(i);
             /// act
             if (
-                (i != 13) && /*HTTPHeaders_Free*/
-                (i != 14) && /*HTTPAPIEX_Destroy*/
-                (i != 15) && /*HTTPAPIEX_SAS_Destroy*/
-                (i != 16) && /*STRING_delete*/
-                (i != 17) && /*STRING_delete*/
-                (i != 18) && /*STRING_delete*/
-                (i != 19) && /*BUFFER_u_char*/
+                (i != 8) && /*HTTPHeaders_Free*/
+                (i != 9) && /*BUFFER_u_char*/
+                (i != 12) && /*json_object_get_string*/
+                (i != 13) && /*json_object_get_object*/
+                (i != 14) && /*json_object_get_object*/
+                (i != 15) && /*json_object_get_object*/
+                (i != 16) && /*json_object_get_string*/
+                (i != 17) && /*json_object_get_string*/
+                (i != 18) && /*json_object_get_string*/
+                (i != 19) && /*json_object_get_string*/
+                (i != 20) && /*json_object_get_string*/
+                (i != 21) && /*json_object_get_string*/
                 (i != 22) && /*json_object_get_string*/
-                (i != 23) && /*json_object_dotget_string*/
-                (i != 24) && /*json_object_dotget_string*/
+                (i != 23) && /*json_object_get_string*/
+                (i != 24) && /*json_object_get_string*/
                 (i != 25) && /*json_object_get_string*/
                 (i != 26) && /*json_object_get_string*/
                 (i != 27) && /*json_object_get_string*/
                 (i != 28) && /*json_object_get_string*/
                 (i != 29) && /*json_object_get_string*/
                 (i != 30) && /*json_object_get_string*/
-                (i != 31) && /*json_object_get_string*/
-                (i != 32) && /*json_object_get_string*/
-                (i != 33) && /*json_object_get_string*/
-                (i != 34) && /*json_object_get_string*/
-                (i != 35) && /*json_object_get_string*/
-                (i != 36) && /*json_object_get_string*/
-                (i != 37) && /*json_object_get_string*/
-                (i != 51) && /*json_value_free*/
-                (i != 52) /*BUFFER_delete*/
+                (i != 44) && /*json_value_free*/
+                (i != 45) /*BUFFER_delete*/
                 )
             {
                 IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetDevice(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_DEVICE_ID, deviceInfo);
@@ -2279,9 +2299,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_101: [ IoTHubRegistryManager_UpdateDevice shall allocate memory for response buffer by calling BUFFER_new ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_043: [ IoTHubRegistryManager_UpdateDevice shall create an HTTP PUT request using the created JSON ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_044: [ IoTHubRegistryManager_UpdateDevice shall create an HTTP PUT request using the createdfollowing HTTP headers : authorization = sasToken, Request - Id = 1001, Accept = application / json, Content - Type = application / json, charset = utf - 8 ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_045: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_046: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_047: [ IoTHubRegistryManager_UpdateDevice shall execute the HTTP PUT request by calling HTTPAPIEX_ExecuteRequest ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_047: [ IoTHubRegistryManager_UpdateDevice shall execute the HTTP PUT request by calling IoTHubScHttpPool_ExecuteRequest ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_105: [ IoTHubRegistryManager_UpdateDevice shall do clean up before return ] */
     TEST_FUNCTION(IoTHubRegistryManager_UpdateDevice_happy_path)
     {
@@ -2312,10 +2330,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -2330,35 +2344,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_IFMATCH, TEST_HTTP_HEADER_VAL_IFMATCH))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -2383,9 +2379,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_101: [ IoTHubRegistryManager_UpdateDevice shall allocate memory for response buffer by calling BUFFER_new ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_043: [ IoTHubRegistryManager_UpdateDevice shall create an HTTP PUT request using the created JSON ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_044: [ IoTHubRegistryManager_UpdateDevice shall create an HTTP PUT request using the createdfollowing HTTP headers : authorization = sasToken, Request - Id = 1001, Accept = application / json, Content - Type = application / json, charset = utf - 8 ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_045: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_046: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_047: [ IoTHubRegistryManager_UpdateDevice shall execute the HTTP PUT request by calling HTTPAPIEX_ExecuteRequest ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_047: [ IoTHubRegistryManager_UpdateDevice shall execute the HTTP PUT request by calling IoTHubScHttpPool_ExecuteRequest ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_105: [ IoTHubRegistryManager_UpdateDevice shall do clean up before return ] */
     TEST_FUNCTION(IoTHubRegistryManager_UpdateDevice_happy_path_with_thumbprint)
     {
@@ -2416,10 +2410,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -2434,35 +2424,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_IFMATCH, TEST_HTTP_HEADER_VAL_IFMATCH))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -2524,10 +2496,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -2542,35 +2510,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_IFMATCH, TEST_HTTP_HEADER_VAL_IFMATCH))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -2594,15 +2544,10 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
                 (i != 8) && /*json_free_serialized_string*/
                 (i != 9) && /*json_object_clear*/
                 (i != 10) && /*json_value_free*/
-                (i != 25) && /*HTTPHeaders_Free*/
-                (i != 26) && /*HTTPAPIEX_Destroy*/
-                (i != 27) && /*HTTPAPIEX_SAS_Destroy*/
-                (i != 28) && /*STRING_delete*/
-                (i != 29) && /*STRING_delete*/
-                (i != 30) && /*STRING_delete*/
-                (i != 31) && /*BUFFER_delete*/
-                (i != 32) && /*BUFFER_delete*/
-                (i != 33) /*gballoc_free*/
+                (i != 20) && /*HTTPHeaders_Free*/
+                (i != 21) && /*BUFFER_delete*/
+                (i != 22) && /*BUFFER_delete*/
+                (i != 23) /*gballoc_free*/
                 )
             {
                 printf("i is = %zu\n", i);
@@ -2645,17 +2590,12 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_053: [ IoTHubRegistryManager_DeleteDevice shall create HTTP DELETE request URL using the given deviceId using the following format : url / devices / [deviceId] ? api - version  ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_054: [ IoTHubRegistryManager_DeleteDevice shall add the following headers to the created HTTP GET request : authorization = sasToken, Request - Id = 1001, Accept = application / json, Content - Type = application / json, charset = utf - 8 ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_055: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_056: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_057: [ IoTHubRegistryManager_DeleteDevice shall execute the HTTP DELETE request by calling HTTPAPIEX_ExecuteRequest ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_057: [ IoTHubRegistryManager_DeleteDevice shall execute the HTTP DELETE request by calling IoTHubScHttpPool_ExecuteRequest ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_058: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_059: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is less or equal than 300 then return IOTHUB_REGISTRYMANAGER_OK ] */
     TEST_FUNCTION(IoTHubRegistryManager_DeleteDevice_happy_path)
     {
         ///arrange
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
@@ -2671,35 +2611,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_IFMATCH, TEST_HTTP_HEADER_VAL_IFMATCH))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_DELETE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_DELETE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         ///act
         IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_DeleteDevice(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_DEVICE_ID);
@@ -2711,9 +2633,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_053: [ IoTHubRegistryManager_DeleteDevice shall create HTTP DELETE request URL using the given deviceId using the following format : url / devices / [deviceId] ? api - version  ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_054: [ IoTHubRegistryManager_DeleteDevice shall add the following headers to the created HTTP GET request : authorization = sasToken, Request - Id = 1001, Accept = application / json, Content - Type = application / json, charset = utf - 8 ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_055: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_056: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_057: [ IoTHubRegistryManager_DeleteDevice shall execute the HTTP DELETE request by calling HTTPAPIEX_ExecuteRequest ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_057: [ IoTHubRegistryManager_DeleteDevice shall execute the HTTP DELETE request by calling IoTHubScHttpPool_ExecuteRequest ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_058: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_059: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is less or equal than 300 then return IOTHUB_REGISTRYMANAGER_OK ] */
     TEST_FUNCTION(IoTHubRegistryManager_DeleteDevice_non_happy_path)
@@ -2722,10 +2642,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         int umockc_result = umock_c_negative_tests_init();
         ASSERT_ARE_EQUAL(int, 0, umockc_result);
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -2740,35 +2656,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_IFMATCH, TEST_HTTP_HEADER_VAL_IFMATCH))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_DELETE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_DELETE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         umock_c_negative_tests_snapshot();
 
@@ -2781,12 +2679,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
             /// act
             if (
-                (i != 13) && /*HTTPHeaders_Free*/
-                (i != 14) && /*HTTPAPIEX_Destroy*/
-                (i != 15) && /*HTTPAPIEX_SAS_Destroy*/
-                (i != 16) && /*STRING_delete*/
-                (i != 17) && /*STRING_delete*/
-                (i != 18) /*STRING_delete*/
+                (i != 8) /*HTTPHeaders_Free*/
                 )
             {
                 IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_DeleteDevice(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_DEVICE_ID);
@@ -2868,12 +2761,10 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_062: [ IoTHubRegistryManager_GetDeviceList shall create HTTP GET request for numberOfDevices using the follwoing format: url/devices/?top=[numberOfDevices]&api-version ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_063: [ IoTHubRegistryManager_GetDeviceList shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_064: [ IoTHubRegistryManager_GetDeviceList shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_065: [ IoTHubRegistryManager_GetDeviceList shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_066: [ IoTHubRegistryManager_GetDeviceList shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ]*/
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_066: [ IoTHubRegistryManager_GetDeviceList shall execute the HTTP GET request by calling IoTHubScHttpPool_ExecuteRequest ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_067: [ IoTHubRegistryManager_GetDeviceList shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_ERROR ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_068: [ IoTHubRegistryManager_GetDeviceList shall verify the received HTTP status code and if it is less or equal than 300 then try to parse the response JSON to deviceList ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_069: [ IoTHubRegistryManager_GetDeviceList shall use the following parson APIs to parse the response JSON: json_parse_string, json_value_get_object, json_object_get_string, json_object_dotget_string  ]*/
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_069: [ IoTHubRegistryManager_GetDeviceList shall use the following parson APIs to parse the response JSON: json_parse_string, json_value_get_object, json_object_get_object, json_object_get_string  ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_070: [ If any of the parson API fails, IoTHubRegistryManager_GetDeviceList shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_071: [ IoTHubRegistryManager_GetDeviceList shall populate the deviceList parameter with structures of type "IOTHUB_DEVICE" ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_072: [ If populating the deviceList parameter fails IoTHubRegistryManager_GetDeviceList shall return IOTHUB_REGISTRYMANAGER_ERROR ]*/
@@ -2890,10 +2781,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -2906,35 +2793,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -2955,9 +2824,15 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
             .SetReturn(TEST_DEVICE_ID);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_AUTHENTICATION))
+            .SetReturn(TEST_JSON_OBJECT_AUTHENTICATION);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_SYMMETRIC_KEY))
+            .SetReturn(TEST_JSON_OBJECT_SYMMETRIC_KEY);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_X509_THUMBPRINT))
+            .SetReturn(TEST_JSON_OBJECT_X509_THUMBPRINT);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_PRIMARY_KEY))
             .SetReturn(TEST_PRIMARYKEY);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_SECONDARY_KEY))
             .SetReturn(TEST_SECONDARYKEY);
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_GENERATION_ID))
             .SetReturn(TEST_GENERATIONID);
@@ -3086,10 +2961,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -3102,35 +2973,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -3151,9 +3004,15 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
             .SetReturn(TEST_DEVICE_ID);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_AUTHENTICATION))
+            .SetReturn(TEST_JSON_OBJECT_AUTHENTICATION);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_SYMMETRIC_KEY))
+            .SetReturn(TEST_JSON_OBJECT_SYMMETRIC_KEY);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_X509_THUMBPRINT))
+            .SetReturn(TEST_JSON_OBJECT_X509_THUMBPRINT);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_PRIMARY_KEY))
             .SetReturn(NULL);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_SECONDARY_KEY))
             .SetReturn(NULL);
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_GENERATION_ID))
             .SetReturn(TEST_GENERATIONID);
@@ -3182,12 +3041,11 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SERVICEPROPERTIES))
             .SetReturn(TEST_SERVICEPROPERTIES);
 
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_X509_THUMBPRINT, TEST_DEVICE_JSON_KEY_PRIMARY_THUMBPRINT))
             .SetReturn(TEST_PRIMARYKEY);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_X509_THUMBPRINT, TEST_DEVICE_JSON_KEY_SECONDARY_THUMBPRINT))
             .SetReturn(TEST_SECONDARYKEY);
 
-
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3276,7 +3134,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         }
     }
 
-
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_110: [ If the BUFFER_new fails, IoTHubRegistryManager_GetDeviceList shall do clean up and return NULL ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_070: [ If any of the parson API fails, IoTHubRegistryManager_GetDeviceList shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_072: [ If populating the deviceList parameter fails IoTHubRegistryManager_GetDeviceList shall return IOTHUB_REGISTRYMANAGER_ERROR ]*/
@@ -3289,10 +3146,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -3305,35 +3158,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -3354,9 +3189,15 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
             .SetReturn(TEST_DEVICE_ID);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_AUTHENTICATION))
+            .SetReturn(TEST_JSON_OBJECT_AUTHENTICATION);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_SYMMETRIC_KEY))
+            .SetReturn(TEST_JSON_OBJECT_SYMMETRIC_KEY);
+        STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT_AUTHENTICATION, TEST_DEVICE_JSON_KEY_X509_THUMBPRINT))
+            .SetReturn(TEST_JSON_OBJECT_X509_THUMBPRINT);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_PRIMARY_KEY))
             .SetReturn(TEST_PRIMARYKEY);
-        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY))
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT_SYMMETRIC_KEY, TEST_DEVICE_JSON_KEY_SECONDARY_KEY))
             .SetReturn(TEST_SECONDARYKEY);
         STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_GENERATION_ID))
             .SetReturn(TEST_GENERATIONID);
@@ -3441,31 +3282,29 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
             /// act
             if (
-                (i != 13) && /*HTTPHeaders_Free*/
-                (i != 14) && /*HTTPAPIEX_Destroy*/
-                (i != 15) && /*HTTPAPIEX_SAS_Destroy*/
-                (i != 16) && /*STRING_delete*/
-                (i != 17) && /*STRING_delete*/
-                (i != 18) && /*STRING_delete*/
-                (i != 22) && /*json_array_get_count*/
+                (i != 8) && /*HTTPHeaders_Free*/
+                (i != 12) && /*json_array_get_count*/
+                (i != 15) && /*json_object_get_string*/
+                (i != 16) && /*json_object_get_object*/
+                (i != 17) && /*json_object_get_object*/
+                (i != 18) && /*json_object_get_object*/
+                (i != 19) && /*json_object_get_string*/
+                (i != 20) && /*json_object_get_string*/
+                (i != 21) && /*json_object_get_string*/
+                (i != 22) && /*json_object_get_string*/
+                (i != 23) && /*json_object_get_string*/
+                (i != 24) && /*json_object_get_string*/
                 (i != 25) && /*json_object_get_string*/
-                (i != 26) && /*json_object_dotget_string*/
-                (i != 27) && /*json_object_dotget_string*/
+                (i != 26) && /*json_object_get_string*/
+                (i != 27) && /*json_object_get_string*/
                 (i != 28) && /*json_object_get_string*/
                 (i != 29) && /*json_object_get_string*/
                 (i != 30) && /*json_object_get_string*/
                 (i != 31) && /*json_object_get_string*/
                 (i != 32) && /*json_object_get_string*/
                 (i != 33) && /*json_object_get_string*/
-                (i != 34) && /*json_object_get_string*/
-                (i != 35) && /*json_object_get_string*/
-                (i != 36) && /*json_object_get_string*/
-                (i != 37) && /*json_object_get_string*/
-                (i != 38) && /*json_object_get_string*/
-                (i != 39) && /*json_object_get_string*/
-                (i != 40) && /*json_object_get_string*/
-                (i != 56) && /*json_value_free*/
-                (i != 57) /*BUFFER_delete*/
+                (i != 49) && /*json_value_free*/
+                (i != 50) /*BUFFER_delete*/
                 )
             {
                 IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetDeviceList(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, deviceList);
@@ -3512,7 +3351,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
                 singlylinkedlist_destroy(deviceList);
             }
 
-
             //if (deviceList != NULL)
             //{
             //    LIST_INSTANCE* list_instance = (LIST_INSTANCE*)deviceList;
@@ -3598,9 +3436,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_112: [ IoTHubRegistryManager_GetStatistics shall allocate memory for response buffer by calling BUFFER_new ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_075: [ IoTHubRegistryManager_GetStatistics shall create HTTP GET request for statistics using the following format: url/statistics/devices?api-version ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_076: [ IoTHubRegistryManager_GetStatistics shall add the following headers to the created HTTP GET request: authorization=sasToken,Request-Id=1001,Accept=application/json,Content-Type=application/json,charset=utf-8 ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_077: [ IoTHubRegistryManager_GetStatistics shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_078: [ IoTHubRegistryManager_GetStatistics shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_079: [ IoTHubRegistryManager_GetStatistics shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ]*/
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_079: [ IoTHubRegistryManager_GetStatistics shall execute the HTTP GET request by calling IoTHubScHttpPool_ExecuteRequest ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_080: [ IoTHubRegistryManager_GetStatistics shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_ERROR ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_081: [ IoTHubRegistryManager_GetStatistics shall verify the received HTTP status code and if it is less or equal than 300 then use the following parson APIs to parse the response JSON to registry statistics structure: json_parse_string, json_value_get_object, json_object_get_string, json_object_dotget_string ]*/
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_083: [ IoTHubRegistryManager_GetStatistics shall save the registry statistics to the out value and return IOTHUB_REGISTRYMANAGER_OK ]*/
@@ -3610,10 +3446,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         ///arrange
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -3626,35 +3458,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -3700,10 +3514,6 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         STRICT_EXPECTED_CALL(BUFFER_new());
 
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
-        STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
-
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
             .IgnoreArgument(1);
@@ -3716,35 +3526,17 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
-
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
             .IgnoreArgument(4)
             .IgnoreArgument(5)
             .IgnoreArgument(6)
             .IgnoreArgument(7)
-            .IgnoreArgument(8)
-            .IgnoreArgument(9)
             .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
             .SetReturn(HTTPAPIEX_OK);
 
         STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -3780,17 +3572,12 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
             /// act
             if (
-                (i != 13) && /*HTTPHeaders_Free*/
-                (i != 14) && /*HTTPAPIEX_Destroy*/
-                (i != 15) && /*HTTPAPIEX_SAS_Destroy*/
-                (i != 16) && /*STRING_delete*/
-                (i != 17) && /*STRING_delete*/
-                (i != 18) && /*STRING_delete*/
-                (i != 22) && /*json_object_get_number*/
-                (i != 23) && /*json_object_get_number*/
-                (i != 24) && /*json_object_get_number*/
-                (i != 26) && /*json_value_free*/
-                (i != 27) /*BUFFER_delete*/
+                (i != 8) && /*HTTPHeaders_Free*/
+                (i != 12) && /*json_object_get_number*/
+                (i != 13) && /*json_object_get_number*/
+                (i != 14) && /*json_object_get_number*/
+                (i != 16) && /*json_value_free*/
+                (i != 17) /*BUFFER_delete*/
                 )
             {
                 IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetStatistics(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, &TEST_IOTHUB_REGISTRY_STATISTICS);
@@ -3806,4 +3593,733 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         umock_c_negative_tests_deinit();
     }
 #endif
+
+    static void set_expected_calls_for_bulk_batch_request(void)
+    {
+        STRICT_EXPECTED_CALL(BUFFER_new());
+
+        STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_REQUEST_ID, TEST_HTTP_HEADER_VAL_REQUEST_ID))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_USER_AGENT, TEST_HTTP_HEADER_VAL_USER_AGENT))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_ACCEPT, TEST_HTTP_HEADER_VAL_ACCEPT))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
+            .IgnoreArgument(1);
+    }
+
+    static void set_expected_calls_for_bulk_json_serialize(void)
+    {
+        STRICT_EXPECTED_CALL(json_serialize_to_string(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(json_free_serialized_string(TEST_CHAR_PTR));
+        STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_004: [ If registryManagerHandle, devices or deviceResults is NULL, or deviceCount or maxConcurrency is 0, or operation is not a valid IOTHUB_REGISTRY_BULK_OPERATION, IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_registryManagerHandle_is_NULL)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[1];
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(NULL, IOTHUB_REGISTRY_BULK_CREATE, &TEST_IOTHUB_REGISTRY_DEVICE_UPDATE, 1, 1, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_004: [ If registryManagerHandle, devices or deviceResults is NULL, or deviceCount or maxConcurrency is 0, or operation is not a valid IOTHUB_REGISTRY_BULK_OPERATION, IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_devices_is_NULL)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[1];
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_CREATE, NULL, 1, 1, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_004: [ If registryManagerHandle, devices or deviceResults is NULL, or deviceCount or maxConcurrency is 0, or operation is not a valid IOTHUB_REGISTRY_BULK_OPERATION, IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_deviceResults_is_NULL)
+    {
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_CREATE, &TEST_IOTHUB_REGISTRY_DEVICE_UPDATE, 1, 1, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_004: [ If registryManagerHandle, devices or deviceResults is NULL, or deviceCount or maxConcurrency is 0, or operation is not a valid IOTHUB_REGISTRY_BULK_OPERATION, IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_deviceCount_is_zero)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[1];
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_CREATE, &TEST_IOTHUB_REGISTRY_DEVICE_UPDATE, 0, 1, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_004: [ If registryManagerHandle, devices or deviceResults is NULL, or deviceCount or maxConcurrency is 0, or operation is not a valid IOTHUB_REGISTRY_BULK_OPERATION, IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_maxConcurrency_is_zero)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[1];
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_CREATE, &TEST_IOTHUB_REGISTRY_DEVICE_UPDATE, 1, 0, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_005: [ If any device has a NULL deviceId, or, for create and update, an authMethod other than IOTHUB_REGISTRYMANAGER_AUTH_SPK or IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT, IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG without sending any request ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_a_deviceId_is_NULL)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_DEVICE_UPDATE devices[2];
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[2];
+        devices[0] = TEST_IOTHUB_REGISTRY_DEVICE_UPDATE;
+        devices[1] = TEST_IOTHUB_REGISTRY_DEVICE_UPDATE;
+        devices[1].deviceId = NULL;
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_DELETE, devices, 2, 1, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_005: [ If any device has a NULL deviceId, or, for create and update, an authMethod other than IOTHUB_REGISTRYMANAGER_AUTH_SPK or IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT, IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG without sending any request ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_authMethod_is_invalid)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[1];
+        TEST_IOTHUB_REGISTRY_DEVICE_UPDATE.authMethod = (IOTHUB_REGISTRYMANAGER_AUTH_METHOD)42;
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_UPDATE, &TEST_IOTHUB_REGISTRY_DEVICE_UPDATE, 1, 1, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_006: [ IoTHubRegistryManager_BulkDevices shall create a JSON array with one object per device containing the id, the importMode ("create", "update" or "delete") and, for create and update, the status and the keys or thumbprints of the device ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_007: [ IoTHubRegistryManager_BulkDevices shall send each batch as an HTTP POST request to url/devices?api-version ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_009: [ IoTHubRegistryManager_BulkDevices shall parse the errors array of the response and set the result of each device listed there to IOTHUB_REGISTRYMANAGER_DEVICE_EXIST for DeviceAlreadyExists, IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST for DeviceNotFound and IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR for any other error; the devices not listed shall be set to IOTHUB_REGISTRYMANAGER_OK ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_012: [ IoTHubRegistryManager_BulkDevices shall return IOTHUB_REGISTRYMANAGER_OK if every device succeeded and IOTHUB_REGISTRYMANAGER_ERROR otherwise, with the result of each device in deviceResults ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_delete_happy_path)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[1];
+
+        STRICT_EXPECTED_CALL(Lock_Init());
+        STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+        STRICT_EXPECTED_CALL(json_value_init_array());
+        STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_value_init_object());
+        STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "id", TEST_DEVICE_ID));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "importMode", "delete"));
+        STRICT_EXPECTED_CALL(json_array_append_value(TEST_JSON_ARRAY, TEST_JSON_VALUE));
+        set_expected_calls_for_bulk_json_serialize();
+
+        set_expected_calls_for_bulk_batch_request();
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_POST, "/devices?api-version=2016-11-14", IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(4)
+            .IgnoreArgument(5)
+            .IgnoreArgument(6)
+            .IgnoreArgument(7)
+            .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
+            .SetReturn(HTTPAPIEX_OK);
+        STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(TEST_UNSIGNED_CHAR_PTR);
+        STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_object_get_array(TEST_JSON_OBJECT, "errors"))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+        STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_DELETE, &TEST_IOTHUB_REGISTRY_DEVICE_UPDATE, 1, 4, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, deviceResults[0]);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_006: [ IoTHubRegistryManager_BulkDevices shall create a JSON array with one object per device containing the id, the importMode ("create", "update" or "delete") and, for create and update, the status and the keys or thumbprints of the device ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_009: [ IoTHubRegistryManager_BulkDevices shall parse the errors array of the response and set the result of each device listed there to IOTHUB_REGISTRYMANAGER_DEVICE_EXIST for DeviceAlreadyExists, IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST for DeviceNotFound and IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR for any other error; the devices not listed shall be set to IOTHUB_REGISTRYMANAGER_OK ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_012: [ IoTHubRegistryManager_BulkDevices shall return IOTHUB_REGISTRYMANAGER_OK if every device succeeded and IOTHUB_REGISTRYMANAGER_ERROR otherwise, with the result of each device in deviceResults ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_create_reports_per_device_errors)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[1];
+
+        STRICT_EXPECTED_CALL(Lock_Init());
+        STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+        STRICT_EXPECTED_CALL(json_value_init_array());
+        STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_value_init_object());
+        STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "id", TEST_DEVICE_ID));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "importMode", "create"));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_STATUS, "Disabled"));
+        STRICT_EXPECTED_CALL(json_object_dotset_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY, TEST_PRIMARYKEY));
+        STRICT_EXPECTED_CALL(json_object_dotset_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY, TEST_SECONDARYKEY));
+        STRICT_EXPECTED_CALL(json_array_append_value(TEST_JSON_ARRAY, TEST_JSON_VALUE));
+        set_expected_calls_for_bulk_json_serialize();
+
+        set_expected_calls_for_bulk_batch_request();
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(3)
+            .IgnoreArgument(4)
+            .IgnoreArgument(5)
+            .IgnoreArgument(6)
+            .IgnoreArgument(7)
+            .CopyOutArgumentBuffer_statusCode(&httpStatusCodeBadRequest, sizeof(httpStatusCodeBadRequest))
+            .SetReturn(HTTPAPIEX_OK);
+        STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(TEST_UNSIGNED_CHAR_PTR);
+        STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_object_get_array(TEST_JSON_OBJECT, "errors"))
+            .SetReturn(TEST_JSON_ARRAY);
+        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+            .SetReturn(1);
+        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, 0));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
+            .SetReturn(TEST_DEVICE_ID);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "errorCode"))
+            .SetReturn("DeviceAlreadyExists");
+        STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+        STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_CREATE, &TEST_IOTHUB_REGISTRY_DEVICE_UPDATE, 1, 1, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_DEVICE_EXIST, deviceResults[0]);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_008: [ IoTHubRegistryManager_BulkDevices shall split the devices into batches of at most IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES devices and send up to maxConcurrency batches at the same time, the calling thread being one of the senders ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_splits_devices_into_batches)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_DEVICE_UPDATE devices[IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES * 2 + 50];
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES * 2 + 50];
+        size_t deviceCount = sizeof(devices) / sizeof(devices[0]);
+        size_t index;
+
+        for (index = 0; index < deviceCount; index++)
+        {
+            devices[index] = TEST_IOTHUB_REGISTRY_DEVICE_UPDATE;
+        }
+        REGISTER_GLOBAL_MOCK_HOOK(IoTHubScHttpPool_ExecuteRequest, my_IoTHubScHttpPool_ExecuteRequest);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_UPDATE, devices, deviceCount, 8, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 3, g_execute_request_count);
+        ASSERT_ARE_EQUAL(size_t, 2, g_thread_create_count);
+        for (index = 0; index < deviceCount; index++)
+        {
+            ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, deviceResults[index]);
+        }
+
+        ///cleanup
+        REGISTER_GLOBAL_MOCK_HOOK(IoTHubScHttpPool_ExecuteRequest, NULL);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_008: [ IoTHubRegistryManager_BulkDevices shall split the devices into batches of at most IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES devices and send up to maxConcurrency batches at the same time, the calling thread being one of the senders ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_sends_every_batch_if_no_thread_can_be_started)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_DEVICE_UPDATE devices[IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES + 1];
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[IOTHUB_REGISTRYMANAGER_BULK_MAX_DEVICES + 1];
+        size_t deviceCount = sizeof(devices) / sizeof(devices[0]);
+        size_t index;
+
+        for (index = 0; index < deviceCount; index++)
+        {
+            devices[index] = TEST_IOTHUB_REGISTRY_DEVICE_UPDATE;
+        }
+        REGISTER_GLOBAL_MOCK_HOOK(IoTHubScHttpPool_ExecuteRequest, my_IoTHubScHttpPool_ExecuteRequest);
+        EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(THREADAPI_ERROR);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_DELETE, devices, deviceCount, 2, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+        ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "ThreadAPI_Join"));
+
+        ///cleanup
+        REGISTER_GLOBAL_MOCK_HOOK(IoTHubScHttpPool_ExecuteRequest, NULL);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_010: [ If a batch could not be sent, or its response carries no per-device errors, IoTHubRegistryManager_BulkDevices shall set the result of every device in the batch to the result of the request ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_sets_batch_result_when_request_fails)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_DEVICE_UPDATE devices[2];
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[2];
+        devices[0] = TEST_IOTHUB_REGISTRY_DEVICE_UPDATE;
+        devices[1] = TEST_IOTHUB_REGISTRY_DEVICE_UPDATE;
+
+        EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(HTTPAPIEX_ERROR);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_DELETE, devices, 2, 1, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR, deviceResults[0]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR, deviceResults[1]);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_011: [ If Lock_Init fails IoTHubRegistryManager_BulkDevices shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkDevices_return_IOTHUB_REGISTRYMANAGER_ERROR_if_Lock_Init_fails)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_RESULT deviceResults[1];
+
+        STRICT_EXPECTED_CALL(Lock_Init())
+            .SetReturn(NULL);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, IOTHUB_REGISTRY_BULK_DELETE, &TEST_IOTHUB_REGISTRY_DEVICE_UPDATE, 1, 1, deviceResults);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, deviceResults[0]);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_017: [ If registryManagerHandle, inputBlobContainerUri, outputBlobContainerUri or job is NULL, IoTHubRegistryManager_ImportDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_ImportDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_is_NULL)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_JOB job;
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result1 = IoTHubRegistryManager_ImportDevices(NULL, TEST_CONST_CHAR_PTR, TEST_CONST_CHAR_PTR, &job);
+        IOTHUB_REGISTRYMANAGER_RESULT result2 = IoTHubRegistryManager_ImportDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, NULL, TEST_CONST_CHAR_PTR, &job);
+        IOTHUB_REGISTRYMANAGER_RESULT result3 = IoTHubRegistryManager_ImportDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_CONST_CHAR_PTR, NULL, &job);
+        IOTHUB_REGISTRYMANAGER_RESULT result4 = IoTHubRegistryManager_ImportDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_CONST_CHAR_PTR, TEST_CONST_CHAR_PTR, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result1);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result2);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result3);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result4);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_013: [ IoTHubRegistryManager_ImportDevices and IoTHubRegistryManager_ExportDevices shall create a JSON object containing the job type ("import" or "export"), the blob container URIs and, for export, excludeKeysInExport ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_014: [ IoTHubRegistryManager_ImportDevices and IoTHubRegistryManager_ExportDevices shall send the job as an HTTP POST request to url/jobs/create?api-version ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_015: [ IoTHubRegistryManager_ImportDevices, IoTHubRegistryManager_ExportDevices and IoTHubRegistryManager_GetJob shall parse the jobId, status, progress and failureReason of the response into job; jobId and failureReason shall be allocated copies owned by the caller ] */
+    TEST_FUNCTION(IoTHubRegistryManager_ImportDevices_happy_path)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_JOB job;
+
+        STRICT_EXPECTED_CALL(json_value_init_object());
+        STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "type", "import"));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "inputBlobContainerUri", TEST_CONST_CHAR_PTR));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "outputBlobContainerUri", TEST_CONST_CHAR_PTR));
+        set_expected_calls_for_bulk_json_serialize();
+
+        set_expected_calls_for_bulk_batch_request();
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_POST, "/jobs/create?api-version=2016-11-14", IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(4)
+            .IgnoreArgument(5)
+            .IgnoreArgument(6)
+            .IgnoreArgument(7)
+            .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
+            .SetReturn(HTTPAPIEX_OK);
+        STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(TEST_UNSIGNED_CHAR_PTR);
+        STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "jobId"));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "failureReason"))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONST_CHAR_PTR))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "status"))
+            .SetReturn("running");
+        STRICT_EXPECTED_CALL(json_object_get_number(TEST_JSON_OBJECT, "progress"));
+        STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_ImportDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_CONST_CHAR_PTR, TEST_CONST_CHAR_PTR, &job);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_IS_NOT_NULL(job.jobId);
+        ASSERT_IS_NULL(job.failureReason);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRY_JOB_STATUS_RUNNING, job.status);
+        ASSERT_ARE_EQUAL(size_t, 42, job.progress);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        free((char*)job.jobId);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If the parsing fails the job functions shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+    TEST_FUNCTION(IoTHubRegistryManager_ImportDevices_return_IOTHUB_REGISTRYMANAGER_JSON_ERROR_if_response_has_no_jobId)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_JOB job;
+
+        EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk));
+        EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+            .SetReturn(TEST_UNSIGNED_CHAR_PTR);
+        EXPECTED_CALL(json_object_get_string(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(NULL);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_ImportDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_CONST_CHAR_PTR, TEST_CONST_CHAR_PTR, &job);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_JSON_ERROR, result);
+        ASSERT_IS_NULL(job.jobId);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_018: [ If registryManagerHandle, outputBlobContainerUri or job is NULL, IoTHubRegistryManager_ExportDevices shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_ExportDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_is_NULL)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_JOB job;
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result1 = IoTHubRegistryManager_ExportDevices(NULL, TEST_CONST_CHAR_PTR, true, &job);
+        IOTHUB_REGISTRYMANAGER_RESULT result2 = IoTHubRegistryManager_ExportDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, NULL, true, &job);
+        IOTHUB_REGISTRYMANAGER_RESULT result3 = IoTHubRegistryManager_ExportDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_CONST_CHAR_PTR, true, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result1);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result2);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result3);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_013: [ IoTHubRegistryManager_ImportDevices and IoTHubRegistryManager_ExportDevices shall create a JSON object containing the job type ("import" or "export"), the blob container URIs and, for export, excludeKeysInExport ] */
+    TEST_FUNCTION(IoTHubRegistryManager_ExportDevices_sets_excludeKeysInExport)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_JOB job;
+
+        STRICT_EXPECTED_CALL(json_value_init_object());
+        STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "type", "export"));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "outputBlobContainerUri", TEST_CONST_CHAR_PTR));
+        STRICT_EXPECTED_CALL(json_object_set_boolean(TEST_JSON_OBJECT, "excludeKeysInExport", 1));
+        STRICT_EXPECTED_CALL(json_serialize_to_string(TEST_JSON_VALUE))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_ExportDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_CONST_CHAR_PTR, true, &job);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_JSON_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_019: [ If registryManagerHandle, jobId or job is NULL, IoTHubRegistryManager_GetJob shall fail and return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_GetJob_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_is_NULL)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_JOB job;
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result1 = IoTHubRegistryManager_GetJob(NULL, TEST_CONST_CHAR_PTR, &job);
+        IOTHUB_REGISTRYMANAGER_RESULT result2 = IoTHubRegistryManager_GetJob(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, NULL, &job);
+        IOTHUB_REGISTRYMANAGER_RESULT result3 = IoTHubRegistryManager_GetJob(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_CONST_CHAR_PTR, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result1);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result2);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result3);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_020: [ IoTHubRegistryManager_GetJob shall send an HTTP GET request to url/jobs/[jobId]?api-version ] */
+    TEST_FUNCTION(IoTHubRegistryManager_GetJob_sends_GET_to_job_path)
+    {
+        ///arrange
+        IOTHUB_REGISTRY_JOB job;
+
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, "/jobs/theJobId?api-version=2016-11-14", IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(4)
+            .IgnoreArgument(6)
+            .IgnoreArgument(7)
+            .CopyOutArgumentBuffer_statusCode(&httpStatusCodeBadRequest, sizeof(httpStatusCodeBadRequest))
+            .SetReturn(HTTPAPIEX_OK);
+        STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetJob(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, "theJobId", &job);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_021: [ If registryManagerHandle or deviceCallback is NULL IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_is_NULL)
+    {
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result1 = IoTHubRegistryManager_EnumerateDevices(NULL, 10, test_device_callback, NULL);
+        IOTHUB_REGISTRYMANAGER_RESULT result2 = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, NULL, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result1);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_022: [ If pageSize is not between 1 and 1000 IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_pageSize_is_out_of_range)
+    {
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result1 = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 0, test_device_callback, NULL);
+        IOTHUB_REGISTRYMANAGER_RESULT result2 = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 1001, test_device_callback, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result1);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_023: [ IoTHubRegistryManager_EnumerateDevices shall request every page with an HTTP POST request to url/devices/query?api-version with the body {"query":"SELECT * FROM devices"} and the x-ms-max-item-count header set to pageSize, by calling IoTHubScHttpPool_ExecuteRequestWithResponseHeaders ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_029: [ IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_OK once every page has been enumerated ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_single_empty_page_happy_path)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+        STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "x-ms-max-item-count", "10"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_POST, "/devices/query?api-version=2016-11-14", IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(4)
+            .IgnoreArgument(5)
+            .IgnoreArgument(6)
+            .IgnoreArgument(7)
+            .IgnoreArgument(8)
+            .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
+            .SetReturn(HTTPAPIEX_OK);
+        STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(TEST_UNSIGNED_CHAR_PTR);
+        STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+            .SetReturn(0);
+        STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+        STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "x-ms-continuation"))
+            .IgnoreArgument(1)
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, test_device_callback, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 0, g_device_callback_count);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_024: [ If the response to a page carries an x-ms-continuation header, IoTHubRegistryManager_EnumerateDevices shall request the next page with the x-ms-continuation request header set to its value; the enumeration ends with the first response that has none ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_025: [ IoTHubRegistryManager_EnumerateDevices shall parse one page at a time and call deviceCallback once for every device in it, with an IOTHUB_DEVICE that is freed as soon as deviceCallback returns ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_follows_the_continuation_token)
+    {
+        ///arrange
+        g_json_array_count = 3;
+        g_continuation_page_count = 2;
+        register_device_query_hooks();
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 3, test_device_callback, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 3, g_execute_request_count);
+        ASSERT_ARE_EQUAL(size_t, 9, g_device_callback_count);
+        ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "\"x-ms-continuation\",\"theContinuationToken\""));
+
+        ///cleanup
+        unregister_device_query_hooks();
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_026: [ If deviceCallback returns false IoTHubRegistryManager_EnumerateDevices shall stop without requesting any further page and return IOTHUB_REGISTRYMANAGER_OK ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_stops_when_the_callback_returns_false)
+    {
+        ///arrange
+        g_json_array_count = 3;
+        g_continuation_page_count = 2;
+        g_device_callback_stop_after = 2;
+        register_device_query_hooks();
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 3, test_device_callback, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 1, g_execute_request_count);
+        ASSERT_ARE_EQUAL(size_t, 2, g_device_callback_count);
+
+        ///cleanup
+        unregister_device_query_hooks();
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_027: [ If the HTTP status code of any page is greater than 300 IoTHubRegistryManager_EnumerateDevices shall stop and return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_return_IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR_if_the_status_code_is_an_error)
+    {
+        ///arrange
+        g_json_array_count = 3;
+        g_execute_request_status_code = httpStatusCodeBadRequest;
+        register_device_query_hooks();
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 3, test_device_callback, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR, result);
+        ASSERT_ARE_EQUAL(size_t, 1, g_execute_request_count);
+        ASSERT_ARE_EQUAL(size_t, 0, g_device_callback_count);
+
+        ///cleanup
+        unregister_device_query_hooks();
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_028: [ If any of the HTTPAPI calls fails IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR, if parsing a page fails it shall return IOTHUB_REGISTRYMANAGER_JSON_ERROR and if any other call fails it shall return IOTHUB_REGISTRYMANAGER_ERROR ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_return_IOTHUB_REGISTRYMANAGER_JSON_ERROR_if_the_page_is_not_an_array)
+    {
+        ///arrange
+        register_device_query_hooks();
+        REGISTER_GLOBAL_MOCK_RETURN(json_value_get_array, NULL);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 3, test_device_callback, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_JSON_ERROR, result);
+        ASSERT_ARE_EQUAL(size_t, 1, g_execute_request_count);
+
+        ///cleanup
+        REGISTER_GLOBAL_MOCK_RETURN(json_value_get_array, TEST_JSON_ARRAY);
+        unregister_device_query_hooks();
+    }
+
     END_TEST_SUITE(iothub_registrymanager_ut)
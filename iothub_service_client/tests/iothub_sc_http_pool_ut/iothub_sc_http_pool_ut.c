@@ -0,0 +1,673 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t l = strlen(source);
+    *destination = (char*)my_gballoc_malloc(l + 1);
+    (void)strcpy(*destination, source);
+    return 0;
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/sastoken.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/buffer_.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_sc_http_pool.h"
+
+TEST_DEFINE_ENUM_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#define TEST_HOSTNAME "theHostName"
+#define TEST_SHAREDACCESSKEY "theSharedAccessKey"
+#define TEST_SHAREDACCESSKEYNAME "theSharedAccessKeyName"
+#define TEST_RELATIVE_PATH "/twins/theDeviceId?api-version=2016-11-14"
+#define TEST_SAS_TOKEN "SharedAccessSignature sr=theHostName&sig=theSignature&se=3600&skn=theSharedAccessKeyName"
+#define TEST_TIME_SECONDS 1000
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4241;
+static HTTP_HEADERS_HANDLE TEST_HTTP_HEADERS_HANDLE = (HTTP_HEADERS_HANDLE)0x4545;
+static BUFFER_HANDLE TEST_REQUEST_BUFFER = (BUFFER_HANDLE)0x4747;
+static BUFFER_HANDLE TEST_RESPONSE_BUFFER = (BUFFER_HANDLE)0x4848;
+static HTTP_HEADERS_HANDLE TEST_RESPONSE_HTTP_HEADERS_HANDLE = (HTTP_HEADERS_HANDLE)0x4949;
+
+/*get_difftime returns this, so the tests can move the clock*/
+static double g_current_seconds;
+static double my_get_difftime(time_t stopTime, time_t startTime)
+{
+    (void)stopTime;
+    (void)startTime;
+    return g_current_seconds;
+}
+
+static STRING_HANDLE my_STRING_construct(const char* psz)
+{
+    (void)psz;
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_STRING_delete(STRING_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static STRING_HANDLE my_SASToken_Create(STRING_HANDLE key, STRING_HANDLE scope, STRING_HANDLE keyName, size_t expiry)
+{
+    (void)key;
+    (void)scope;
+    (void)keyName;
+    (void)expiry;
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
+
+static HTTPAPIEX_HANDLE my_HTTPAPIEX_Create(const char* hostName)
+{
+    (void)hostName;
+    return (HTTPAPIEX_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static void set_expected_calls_for_create(void)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_HOSTNAME))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
+    STRICT_EXPECTED_CALL(Lock_Init());
+}
+
+static void set_expected_calls_for_execute_request_with_response_headers(bool signsToken, bool createsConnection, HTTPAPIEX_RESULT executeResult, HTTP_HEADERS_HANDLE responseHttpHeadersHandle)
+{
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    if (signsToken)
+    {
+        STRICT_EXPECTED_CALL(SASToken_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, (size_t)g_current_seconds + 3600))
+            .IgnoreArgument_key()
+            .IgnoreArgument_scope()
+            .IgnoreArgument_keyName();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "Authorization", TEST_SAS_TOKEN));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    if (createsConnection)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
+    }
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, TEST_RELATIVE_PATH, TEST_HTTP_HEADERS_HANDLE, TEST_REQUEST_BUFFER, IGNORED_PTR_ARG, responseHttpHeadersHandle, TEST_RESPONSE_BUFFER))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_statusCode()
+        .SetReturn(executeResult);
+    if (executeResult == HTTPAPIEX_OK)
+    {
+        STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    }
+}
+
+static void set_expected_calls_for_execute_request(bool signsToken, bool createsConnection, HTTPAPIEX_RESULT executeResult)
+{
+    set_expected_calls_for_execute_request_with_response_headers(signsToken, createsConnection, executeResult, NULL);
+}
+
+static HTTPAPIEX_RESULT execute_request(IOTHUB_SC_HTTP_POOL_HANDLE httpPool)
+{
+    unsigned int statusCode;
+    return IoTHubScHttpPool_ExecuteRequest(httpPool, HTTPAPI_REQUEST_GET, TEST_RELATIVE_PATH, TEST_HTTP_HEADERS_HANDLE, TEST_REQUEST_BUFFER, &statusCode, TEST_RESPONSE_BUFFER);
+}
+
+static IOTHUB_SC_HTTP_POOL_HANDLE create_http_pool(void)
+{
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubScHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothub_sc_http_pool_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT);
+    REGISTER_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT);
+    REGISTER_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, my_STRING_construct);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
+    REGISTER_GLOBAL_MOCK_RETURN(STRING_c_str, TEST_SAS_TOKEN);
+
+    REGISTER_GLOBAL_MOCK_HOOK(SASToken_Create, my_SASToken_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(SASToken_Create, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(get_time, (time_t)TEST_TIME_SECONDS);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, (time_t)-1);
+    REGISTER_GLOBAL_MOCK_HOOK(get_difftime, my_get_difftime);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_ReplaceHeaderNameValuePair, HTTP_HEADERS_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_ReplaceHeaderNameValuePair, HTTP_HEADERS_ERROR);
+
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Destroy, my_HTTPAPIEX_Destroy);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_ExecuteRequest, HTTPAPIEX_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_ExecuteRequest, HTTPAPIEX_ERROR);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+    g_current_seconds = TEST_TIME_SECONDS;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_001: [ If hostname, sharedAccessKey or keyName is NULL then IoTHubScHttpPool_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Create_NULL_hostname_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubScHttpPool_Create(NULL, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_001: [ If hostname, sharedAccessKey or keyName is NULL then IoTHubScHttpPool_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Create_NULL_sharedAccessKey_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubScHttpPool_Create(TEST_HOSTNAME, NULL, TEST_SHAREDACCESSKEYNAME);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_001: [ If hostname, sharedAccessKey or keyName is NULL then IoTHubScHttpPool_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Create_NULL_keyName_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubScHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_002: [ IoTHubScHttpPool_Create shall allocate memory for the pool, copy hostname, sharedAccessKey and keyName, create a lock and set the reference count to 1. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Create_succeeds)
+{
+    // arrange
+    set_expected_calls_for_create();
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubScHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_003: [ If any of the above fails then IoTHubScHttpPool_Create shall free all the resources it allocated and return NULL. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Create_fails_when_a_call_fails)
+{
+    // arrange
+    size_t i;
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    set_expected_calls_for_create();
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubScHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME);
+
+        // assert
+        ASSERT_IS_NULL(result);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_004: [ If httpPool is NULL then IoTHubScHttpPool_Clone shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Clone_NULL_httpPool_fails)
+{
+    // arrange
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubScHttpPool_Clone(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_005: [ IoTHubScHttpPool_Clone shall increment the reference count under the lock and return httpPool. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Clone_succeeds)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubScHttpPool_Clone(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, httpPool, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(result);
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_006: [ If the lock cannot be taken then IoTHubScHttpPool_Clone shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Clone_fails_when_Lock_fails)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubScHttpPool_Clone(httpPool);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_007: [ If httpPool is NULL then IoTHubScHttpPool_Destroy shall return. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Destroy_NULL_httpPool_returns)
+{
+    // arrange
+
+    // act
+    IoTHubScHttpPool_Destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_008: [ IoTHubScHttpPool_Destroy shall decrement the reference count under the lock. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Destroy_keeps_the_pool_while_it_is_shared)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+    (void)IoTHubScHttpPool_Clone(httpPool);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IoTHubScHttpPool_Destroy(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_009: [ When the last reference is released IoTHubScHttpPool_Destroy shall destroy the idle connections, the cached SAS token and the lock and free the pool. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_Destroy_frees_the_pool_on_the_last_reference)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+    (void)execute_request(httpPool);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(httpPool));
+
+    // act
+    IoTHubScHttpPool_Destroy(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_010: [ If httpPool, relativePath or requestHttpHeadersHandle is NULL then IoTHubScHttpPool_ExecuteRequest shall fail and return HTTPAPIEX_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_ExecuteRequest_NULL_httpPool_fails)
+{
+    // arrange
+    unsigned int statusCode;
+
+    // act
+    HTTPAPIEX_RESULT result = IoTHubScHttpPool_ExecuteRequest(NULL, HTTPAPI_REQUEST_GET, TEST_RELATIVE_PATH, TEST_HTTP_HEADERS_HANDLE, TEST_REQUEST_BUFFER, &statusCode, TEST_RESPONSE_BUFFER);
+
+    // assert
+    ASSERT_ARE_EQUAL(HTTPAPIEX_RESULT, HTTPAPIEX_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_010: [ If httpPool, relativePath or requestHttpHeadersHandle is NULL then IoTHubScHttpPool_ExecuteRequest shall fail and return HTTPAPIEX_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_ExecuteRequest_NULL_relativePath_fails)
+{
+    // arrange
+    unsigned int statusCode;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+
+    // act
+    HTTPAPIEX_RESULT result = IoTHubScHttpPool_ExecuteRequest(httpPool, HTTPAPI_REQUEST_GET, NULL, TEST_HTTP_HEADERS_HANDLE, TEST_REQUEST_BUFFER, &statusCode, TEST_RESPONSE_BUFFER);
+
+    // assert
+    ASSERT_ARE_EQUAL(HTTPAPIEX_RESULT, HTTPAPIEX_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_010: [ If httpPool, relativePath or requestHttpHeadersHandle is NULL then IoTHubScHttpPool_ExecuteRequest shall fail and return HTTPAPIEX_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_ExecuteRequest_NULL_requestHttpHeadersHandle_fails)
+{
+    // arrange
+    unsigned int statusCode;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+
+    // act
+    HTTPAPIEX_RESULT result = IoTHubScHttpPool_ExecuteRequest(httpPool, HTTPAPI_REQUEST_GET, TEST_RELATIVE_PATH, NULL, TEST_REQUEST_BUFFER, &statusCode, TEST_RESPONSE_BUFFER);
+
+    // assert
+    ASSERT_ARE_EQUAL(HTTPAPIEX_RESULT, HTTPAPIEX_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_011: [ If there is no cached SAS token, or the cached SAS token expires in less than IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN_SECS, IoTHubScHttpPool_ExecuteRequest shall create a new one by calling SASToken_Create with an expiry of IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME_SECS from now. ]*/
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_012: [ IoTHubScHttpPool_ExecuteRequest shall set the Authorization header of the request to the cached SAS token by calling HTTPHeaders_ReplaceHeaderNameValuePair. ]*/
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_013: [ IoTHubScHttpPool_ExecuteRequest shall take an idle connection from the pool, or create one by calling HTTPAPIEX_Create outside the lock if there is none. ]*/
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_014: [ IoTHubScHttpPool_ExecuteRequest shall execute the request outside the lock by calling HTTPAPIEX_ExecuteRequest and return its result. ]*/
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_016: [ If the request succeeded and the pool holds fewer than IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS idle connections, IoTHubScHttpPool_ExecuteRequest shall return the connection to the pool; otherwise it shall destroy it by calling HTTPAPIEX_Destroy. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_ExecuteRequest_first_request_signs_a_token_and_opens_a_connection)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+
+    set_expected_calls_for_execute_request(true, true, HTTPAPIEX_OK);
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(HTTPAPIEX_RESULT, HTTPAPIEX_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_011: [ If there is no cached SAS token, or the cached SAS token expires in less than IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN_SECS, IoTHubScHttpPool_ExecuteRequest shall create a new one by calling SASToken_Create with an expiry of IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME_SECS from now. ]*/
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_013: [ IoTHubScHttpPool_ExecuteRequest shall take an idle connection from the pool, or create one by calling HTTPAPIEX_Create outside the lock if there is none. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_ExecuteRequest_reuses_the_token_and_the_connection)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+    (void)execute_request(httpPool);
+    umock_c_reset_all_calls();
+    g_current_seconds = TEST_TIME_SECONDS + 60;
+
+    set_expected_calls_for_execute_request(false, false, HTTPAPIEX_OK);
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(HTTPAPIEX_RESULT, HTTPAPIEX_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_011: [ If there is no cached SAS token, or the cached SAS token expires in less than IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN_SECS, IoTHubScHttpPool_ExecuteRequest shall create a new one by calling SASToken_Create with an expiry of IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME_SECS from now. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_ExecuteRequest_signs_a_new_token_when_the_cached_one_is_about_to_expire)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+    (void)execute_request(httpPool);
+    umock_c_reset_all_calls();
+    g_current_seconds = TEST_TIME_SECONDS + 3600 - 300;
+
+    set_expected_calls_for_execute_request(true, false, HTTPAPIEX_OK);
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(HTTPAPIEX_RESULT, HTTPAPIEX_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_014: [ IoTHubScHttpPool_ExecuteRequest shall execute the request outside the lock by calling HTTPAPIEX_ExecuteRequest and return its result. ]*/
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_016: [ If the request succeeded and the pool holds fewer than IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS idle connections, IoTHubScHttpPool_ExecuteRequest shall return the connection to the pool; otherwise it shall destroy it by calling HTTPAPIEX_Destroy. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_ExecuteRequest_destroys_the_connection_when_the_request_fails)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+
+    set_expected_calls_for_execute_request(true, true, HTTPAPIEX_RECOVERYFAILED);
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(HTTPAPIEX_RESULT, HTTPAPIEX_RECOVERYFAILED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_015: [ If any of the calls above fails then IoTHubScHttpPool_ExecuteRequest shall fail and return HTTPAPIEX_ERROR. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_ExecuteRequest_fails_when_a_call_fails)
+{
+    // arrange
+    size_t i;
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    set_expected_calls_for_execute_request(true, true, HTTPAPIEX_OK);
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        if (
+            (i != 2) && /*get_difftime*/
+            (i != 4) && /*STRING_delete*/
+            (i != 5) && /*STRING_c_str*/
+            (i != 7) && /*Unlock*/
+            (i != 10) && /*Lock*/
+            (i != 11) /*Unlock*/
+            )
+        {
+            /*a fresh pool for every run, so there is never a cached token or an idle connection*/
+            IOTHUB_SC_HTTP_POOL_HANDLE httpPool = IoTHubScHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME);
+            ASSERT_IS_NOT_NULL(httpPool);
+
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+
+            // act
+            HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+            // assert
+            ASSERT_ARE_NOT_EQUAL(HTTPAPIEX_RESULT, HTTPAPIEX_OK, result);
+
+            // cleanup
+            IoTHubScHttpPool_Destroy(httpPool);
+        }
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUB_SC_HTTP_POOL_41_017: [ IoTHubScHttpPool_ExecuteRequestWithResponseHeaders shall behave as IoTHubScHttpPool_ExecuteRequest and pass responseHttpHeadersHandle to HTTPAPIEX_ExecuteRequest; IoTHubScHttpPool_ExecuteRequest shall call it with a NULL responseHttpHeadersHandle. ]*/
+TEST_FUNCTION(IoTHubScHttpPool_ExecuteRequestWithResponseHeaders_returns_the_response_headers)
+{
+    // arrange
+    unsigned int statusCode;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_http_pool();
+
+    set_expected_calls_for_execute_request_with_response_headers(true, true, HTTPAPIEX_OK, TEST_RESPONSE_HTTP_HEADERS_HANDLE);
+
+    // act
+    HTTPAPIEX_RESULT result = IoTHubScHttpPool_ExecuteRequestWithResponseHeaders(httpPool, HTTPAPI_REQUEST_GET, TEST_RELATIVE_PATH, TEST_HTTP_HEADERS_HANDLE, TEST_REQUEST_BUFFER, &statusCode, TEST_RESPONSE_HTTP_HEADERS_HANDLE, TEST_RESPONSE_BUFFER);
+
+    // assert
+    ASSERT_ARE_EQUAL(HTTPAPIEX_RESULT, HTTPAPIEX_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubScHttpPool_Destroy(httpPool);
+}
+
+END_TEST_SUITE(iothub_sc_http_pool_ut)
@@ -16,6 +16,7 @@
 #include "azure_c_shared_utility/connection_string_parser.h"
 
 #include "iothub_service_client_auth.h"
+#include "iothub_sc_http_pool.h"
 
 extern "C" int gballoc_init(void);
 extern "C" void gballoc_deinit(void);
@@ -53,6 +54,8 @@ static MAP_HANDLE TEST_MAP_HANDLE_NULL = (MAP_HANDLE)NULL;
 static STRING_TOKENIZER_HANDLE TEST_STRING_TOKENIZER_HANDLE = (STRING_TOKENIZER_HANDLE)0x4444;
 static STRING_TOKENIZER_HANDLE TEST_STRING_TOKENIZER_HANDLE_NULL = (STRING_TOKENIZER_HANDLE)NULL;
 
+static IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4747;
+
 static STRING_HANDLE TEST_KEY_STRING_HANDLE = (STRING_HANDLE)0x4545;
 static STRING_HANDLE TEST_VALUE_STRING_HANDLE = (STRING_HANDLE)0x4646;
 
@@ -129,6 +132,12 @@ public:
     /* Connection string parser mock */
     MOCK_STATIC_METHOD_1(, MAP_HANDLE, connectionstringparser_parse, STRING_HANDLE, connectionString)
     MOCK_METHOD_END(MAP_HANDLE, TEST_MAP_HANDLE);
+
+    /* IoTHubScHttpPool mocks */
+    MOCK_STATIC_METHOD_3(, IOTHUB_SC_HTTP_POOL_HANDLE, IoTHubScHttpPool_Create, const char*, hostname, const char*, sharedAccessKey, const char*, keyName)
+    MOCK_METHOD_END(IOTHUB_SC_HTTP_POOL_HANDLE, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    MOCK_STATIC_METHOD_1(, void, IoTHubScHttpPool_Destroy, IOTHUB_SC_HTTP_POOL_HANDLE, httpPool)
+    MOCK_VOID_METHOD_END();
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubServiceClientAuthMocks, , int, mallocAndStrcpy_s, char**, destination, const char*, source);
@@ -152,6 +161,9 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubServiceClientAuthMocks, , void, STRING_TOKEN
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubServiceClientAuthMocks, , MAP_HANDLE, connectionstringparser_parse, STRING_HANDLE, connectionString);
 
+DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubServiceClientAuthMocks, , IOTHUB_SC_HTTP_POOL_HANDLE, IoTHubScHttpPool_Create, const char*, hostname, const char*, sharedAccessKey, const char*, keyName);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubServiceClientAuthMocks, , void, IoTHubScHttpPool_Destroy, IOTHUB_SC_HTTP_POOL_HANDLE, httpPool);
+
 BEGIN_TEST_SUITE(iothub_service_client_auth_ut)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -1261,6 +1273,108 @@ TEST_FUNCTION(IoTHubServiceClientAuth_CreateFromConnectionString_do_clean_up_if_
     mocks.AssertActualAndExpectedCalls();
 }
 
+/* Tests_SRS_IOTHUBSERVICECLIENT_41_001: [** IoTHubServiceClientAuth_CreateFromConnectionString shall create the HTTP connection pool shared by the service client APIs by calling IoTHubScHttpPool_Create with hostName, sharedAccessKey and keyName. **]*/
+/* Tests_SRS_IOTHUBSERVICECLIENT_41_002: [** If IoTHubScHttpPool_Create fails, IoTHubServiceClientAuth_CreateFromConnectionString shall do clean up and return NULL. **]*/
+TEST_FUNCTION(IoTHubServiceClientAuth_CreateFromConnectionString_do_clean_up_if_IoTHubScHttpPool_Create_fails)
+{
+    // arrange
+    CIoTHubServiceClientAuthMocks mocks;
+
+    
+    whenShallmalloc_fail = 0;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(TEST_CHAR_PTR));
+    
+    STRICT_EXPECTED_CALL(mocks, connectionstringparser_parse(TEST_STRING_HANDLE))
+        .SetReturn(TEST_MAP_HANDLE);
+    
+    STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(TEST_MAP_HANDLE, (const char*)"HostName"))
+        .SetReturn(TEST_CONST_CHAR_PTR);
+    
+    STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(TEST_MAP_HANDLE, (const char*)"SharedAccessKeyName"))
+        .SetReturn(TEST_CONST_CHAR_PTR);
+    
+    STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(TEST_MAP_HANDLE, (const char*)"SharedAccessKey"))
+        .SetReturn(TEST_CONST_CHAR_PTR);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(TEST_CONST_CHAR_PTR));
+
+    STRICT_EXPECTED_CALL(mocks, STRING_TOKENIZER_create(TEST_STRING_HANDLE))
+        .SetReturn(TEST_STRING_TOKENIZER_HANDLE);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_new())
+        .SetReturn(TEST_STRING_HANDLE);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_new())
+        .SetReturn(TEST_STRING_HANDLE);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_TOKENIZER_get_next_token(TEST_STRING_TOKENIZER_HANDLE, TEST_STRING_HANDLE, "."))
+        .SetReturn(0);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_TOKENIZER_get_next_token(TEST_STRING_TOKENIZER_HANDLE, TEST_STRING_HANDLE, "0"))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, STRING_c_str(TEST_STRING_HANDLE))
+        .SetReturn(TEST_CHAR_PTR);
+    
+    EXPECTED_CALL(mocks, STRING_c_str(TEST_STRING_HANDLE))
+        .SetReturn(TEST_CHAR_PTR);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+    
+    STRICT_EXPECTED_CALL(mocks, IoTHubScHttpPool_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn((IOTHUB_SC_HTTP_POOL_HANDLE)NULL);
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(TEST_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(TEST_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(TEST_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, STRING_TOKENIZER_destroy(TEST_STRING_TOKENIZER_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, Map_Destroy(TEST_MAP_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(TEST_STRING_HANDLE));
+
+    // act
+    IOTHUB_SERVICE_CLIENT_AUTH_HANDLE result = IoTHubServiceClientAuth_CreateFromConnectionString(TEST_CHAR_PTR);
+
+    // assert
+    ASSERT_IS_NULL(result);
+
+    mocks.AssertActualAndExpectedCalls();
+}
+
 /* Tests_SRS_IOTHUBSERVICECLIENT_12_006: [** If the IOTHUB_SERVICE_CLIENT_AUTH has been populated IoTHubServiceClientAuth_CreateFromConnectionString shall return with a IOTHUB_SERVICE_CLIENT_AUTH_HANDLE to it **]*/
 TEST_FUNCTION(IoTHubServiceClientAuth_CreateFromConnectionString_succeed)
 {
@@ -1323,6 +1437,9 @@ TEST_FUNCTION(IoTHubServiceClientAuth_CreateFromConnectionString_succeed)
     EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(0);
     
+    STRICT_EXPECTED_CALL(mocks, IoTHubScHttpPool_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
     STRICT_EXPECTED_CALL(mocks, STRING_delete(TEST_STRING_HANDLE));
     STRICT_EXPECTED_CALL(mocks, STRING_delete(TEST_STRING_HANDLE));
     STRICT_EXPECTED_CALL(mocks, STRING_delete(TEST_STRING_HANDLE));
@@ -1357,6 +1474,7 @@ TEST_FUNCTION(IoTHubServiceClient_Destroy_return_if_input_parameter_serviceClien
 }
 
 /* Tests_SRS_IOTHUBSERVICECLIENT_12_008 : [** If the serviceClientHandle input parameter is not NULL IoTHubServiceClient_Destroy shall free the memory of it and return **] */
+/* Tests_SRS_IOTHUBSERVICECLIENT_41_003: [** IoTHubServiceClient_Destroy shall release its reference to the HTTP connection pool by calling IoTHubScHttpPool_Destroy. **]*/
 TEST_FUNCTION(IoTHubServiceClient_Destroy_do_clean_up_and_return_if_input_parameter_serviceClientHandle_is_not_NULL)
 {
     // arrange
@@ -1438,6 +1556,9 @@ TEST_FUNCTION(IoTHubServiceClient_Destroy_do_clean_up_and_return_if_input_parame
         .IgnoreAllArguments()
         .SetReturn(0);
 
+    STRICT_EXPECTED_CALL(mocks, IoTHubScHttpPool_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
@@ -1461,6 +1582,7 @@ TEST_FUNCTION(IoTHubServiceClient_Destroy_do_clean_up_and_return_if_input_parame
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubScHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
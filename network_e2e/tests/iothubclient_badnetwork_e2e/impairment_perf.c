@@ -0,0 +1,310 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdio>
+#else
+#include <stdlib.h>
+#include <stdio.h>
+#endif
+
+#include "impairment_perf.h"
+#include "iothubclient_common_e2e.h"
+#include "testrunnerswitcher.h"
+#include "network_impairment.h"
+
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#define HIGH_RTT_MESSAGE_COUNT 50
+#define PROFILE_MESSAGE_COUNT 10
+#define OUTAGE_TIME_MS 30000
+#define QUEUED_MESSAGE_COUNT 150
+#define FLAP_COUNT 5
+#define FLAP_OUTAGE_TIME_MS 5000
+#define FLAP_CONNECTED_TIME_MS 5000
+#define NAT_IDLE_TIME_MS 5000
+
+#define DEFAULT_MIN_MSGS_PER_S 1.0
+#define DEFAULT_MAX_RECOVERY_S 60.0
+#define DEFAULT_MAX_QUEUE_KB_PER_MSG 8.0
+
+static double get_threshold(const char* name, double defaultValue)
+{
+    double result = defaultValue;
+    const char* env = getenv(name);
+    if (env != NULL && *env != 0)
+    {
+        result = atof(env);
+    }
+    return result;
+}
+
+static const char* get_protocol_name()
+{
+    // main picks the protocol from the same variable, AMQP when it is not set
+    const char* result = getenv("E2E_PROTOCOL");
+    if (result == NULL || *result == 0)
+    {
+        result = "AMQP";
+    }
+    return result;
+}
+
+static void report(const char* scenario, const char* metric, double value)
+{
+    printf("PERF,%s,%s,%s,%.3f\r\n", scenario, get_protocol_name(), metric, value);
+}
+
+static TICK_COUNTER_HANDLE create_tick_counter()
+{
+    TICK_COUNTER_HANDLE tickCounter = tickcounter_create();
+    ASSERT_IS_NOT_NULL_WITH_MSG(tickCounter, "tickcounter_create failed");
+    return tickCounter;
+}
+
+static tickcounter_ms_t get_now_ms(TICK_COUNTER_HANDLE tickCounter)
+{
+    tickcounter_ms_t now;
+    int result = tickcounter_get_current_ms(tickCounter, &now);
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "tickcounter_get_current_ms failed");
+    return now;
+}
+
+// sends a first message and waits for it, so the measurements do not include the connection
+static IOTHUB_CLIENT_HANDLE connect_and_warm_up(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    IOTHUB_CLIENT_HANDLE iotHubClientHandle = client_connect_to_hub(deviceToUse, protocol);
+    D2C_MESSAGE_HANDLE d2cMessage = client_create_and_send_d2c(iotHubClientHandle);
+
+    bool confirmed = client_wait_for_d2c_confirmation(d2cMessage);
+    destroy_d2c_message_handle(d2cMessage);
+    ASSERT_IS_TRUE_WITH_MSG(confirmed, "the warm up message was not confirmed");
+
+    return iotHubClientHandle;
+}
+
+static void wait_for_all_confirmations(D2C_MESSAGE_HANDLE* d2cMessages, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        bool confirmed = client_wait_for_d2c_confirmation(d2cMessages[i]);
+        ASSERT_IS_TRUE_WITH_MSG(confirmed, "a message was not confirmed");
+    }
+}
+
+static void destroy_all(D2C_MESSAGE_HANDLE* d2cMessages, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        destroy_d2c_message_handle(d2cMessages[i]);
+    }
+}
+
+static double send_and_measure_throughput(IOTHUB_CLIENT_HANDLE iotHubClientHandle, D2C_MESSAGE_HANDLE* d2cMessages, size_t count)
+{
+    TICK_COUNTER_HANDLE tickCounter = create_tick_counter();
+    tickcounter_ms_t start = get_now_ms(tickCounter);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        d2cMessages[i] = client_create_and_send_d2c(iotHubClientHandle);
+    }
+    wait_for_all_confirmations(d2cMessages, count);
+
+    tickcounter_ms_t elapsed = get_now_ms(tickCounter) - start;
+    tickcounter_destroy(tickCounter);
+
+    return (elapsed == 0) ? (double)count * 1000.0 : (double)count * 1000.0 / (double)elapsed;
+}
+
+static void assert_recovery_time(const char* scenario, double recoverySeconds)
+{
+    double maxRecoverySeconds = get_threshold("E2E_PERF_MAX_RECOVERY_S", DEFAULT_MAX_RECOVERY_S);
+
+    report(scenario, "recovery_s", recoverySeconds);
+    if (recoverySeconds > maxRecoverySeconds)
+    {
+        printf("recovery took %.3f s, the limit is %.3f s\r\n", recoverySeconds, maxRecoverySeconds);
+        ASSERT_FAIL("the client took too long to recover");
+    }
+}
+
+// sends a message and returns the time it takes to be confirmed, in seconds
+static double measure_recovery(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
+{
+    TICK_COUNTER_HANDLE tickCounter = create_tick_counter();
+    tickcounter_ms_t start = get_now_ms(tickCounter);
+
+    D2C_MESSAGE_HANDLE d2cMessage = client_create_and_send_d2c(iotHubClientHandle);
+    bool confirmed = client_wait_for_d2c_confirmation(d2cMessage);
+    tickcounter_ms_t elapsed = get_now_ms(tickCounter) - start;
+
+    tickcounter_destroy(tickCounter);
+    destroy_d2c_message_handle(d2cMessage);
+    ASSERT_IS_TRUE_WITH_MSG(confirmed, "the message sent after the impairment was not confirmed");
+
+    return (double)elapsed / 1000.0;
+}
+
+void impairment_throughput_on_high_rtt_link(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    D2C_MESSAGE_HANDLE d2cMessage[HIGH_RTT_MESSAGE_COUNT];
+    double minMessagesPerSecond = get_threshold("E2E_PERF_MIN_MSGS_PER_S", DEFAULT_MIN_MSGS_PER_S);
+
+    IOTHUB_CLIENT_HANDLE iotHubClientHandle = connect_and_warm_up(deviceToUse, protocol);
+
+    if (0 != network_impairment_apply(&NETWORK_PROFILE_HIGH_RTT))
+    {
+        ASSERT_FAIL("applying the network profile failed");
+    }
+
+    double messagesPerSecond = send_and_measure_throughput(iotHubClientHandle, d2cMessage, HIGH_RTT_MESSAGE_COUNT);
+    report("high_rtt", "msgs_per_s", messagesPerSecond);
+
+    IoTHubClient_Destroy(iotHubClientHandle);
+    destroy_all(d2cMessage, HIGH_RTT_MESSAGE_COUNT);
+    (void)network_impairment_clear();
+
+    if (messagesPerSecond < minMessagesPerSecond)
+    {
+        printf("throughput is %.3f messages/s, the limit is %.3f messages/s\r\n", messagesPerSecond, minMessagesPerSecond);
+        ASSERT_FAIL("throughput on a 600 ms round trip link is too low");
+    }
+}
+
+void impairment_send_under_profile(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const NETWORK_IMPAIRMENT_PROFILE* profile)
+{
+    D2C_MESSAGE_HANDLE d2cMessage[PROFILE_MESSAGE_COUNT];
+
+    IOTHUB_CLIENT_HANDLE iotHubClientHandle = connect_and_warm_up(deviceToUse, protocol);
+
+    if (0 != network_impairment_apply(profile))
+    {
+        ASSERT_FAIL("applying the network profile failed");
+    }
+
+    report(profile->name, "msgs_per_s", send_and_measure_throughput(iotHubClientHandle, d2cMessage, PROFILE_MESSAGE_COUNT));
+
+    IoTHubClient_Destroy(iotHubClientHandle);
+    destroy_all(d2cMessage, PROFILE_MESSAGE_COUNT);
+    (void)network_impairment_clear();
+}
+
+void impairment_time_to_recover_after_outage(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    IOTHUB_CLIENT_HANDLE iotHubClientHandle = connect_and_warm_up(deviceToUse, protocol);
+
+    if (0 != network_impairment_start_outage())
+    {
+        ASSERT_FAIL("starting the outage failed");
+    }
+
+    // the message sent during the outage has to make it through as well
+    D2C_MESSAGE_HANDLE queuedMessage = client_create_and_send_d2c(iotHubClientHandle);
+    ThreadAPI_Sleep(OUTAGE_TIME_MS);
+
+    if (0 != network_impairment_end_outage())
+    {
+        ASSERT_FAIL("ending the outage failed");
+    }
+
+    double recoverySeconds = measure_recovery(iotHubClientHandle);
+    bool queuedConfirmed = client_wait_for_d2c_confirmation(queuedMessage);
+
+    IoTHubClient_Destroy(iotHubClientHandle);
+    destroy_d2c_message_handle(queuedMessage);
+
+    ASSERT_IS_TRUE_WITH_MSG(queuedConfirmed, "the message sent during the outage was not confirmed");
+    assert_recovery_time("outage_30s", recoverySeconds);
+}
+
+void impairment_queue_growth_during_outage(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    D2C_MESSAGE_HANDLE d2cMessage[QUEUED_MESSAGE_COUNT];
+    double maxKbPerMessage = get_threshold("E2E_PERF_MAX_QUEUE_KB_PER_MSG", DEFAULT_MAX_QUEUE_KB_PER_MSG);
+
+    IOTHUB_CLIENT_HANDLE iotHubClientHandle = connect_and_warm_up(deviceToUse, protocol);
+    size_t rssBefore = network_impairment_get_rss_kb();
+    size_t rssPeak = rssBefore;
+
+    if (0 != network_impairment_start_outage())
+    {
+        ASSERT_FAIL("starting the outage failed");
+    }
+
+    // spread the messages over the outage, so the retries of the transport get to run while the queue grows
+    for (size_t i = 0; i < QUEUED_MESSAGE_COUNT; i++)
+    {
+        d2cMessage[i] = client_create_and_send_d2c(iotHubClientHandle);
+        ThreadAPI_Sleep(OUTAGE_TIME_MS / QUEUED_MESSAGE_COUNT);
+
+        size_t rss = network_impairment_get_rss_kb();
+        if (rss > rssPeak)
+        {
+            rssPeak = rss;
+        }
+    }
+
+    if (0 != network_impairment_end_outage())
+    {
+        ASSERT_FAIL("ending the outage failed");
+    }
+
+    wait_for_all_confirmations(d2cMessage, QUEUED_MESSAGE_COUNT);
+    size_t rssAfterDrain = network_impairment_get_rss_kb();
+
+    IoTHubClient_Destroy(iotHubClientHandle);
+    destroy_all(d2cMessage, QUEUED_MESSAGE_COUNT);
+
+    double kbPerMessage = (double)(rssPeak - rssBefore) / QUEUED_MESSAGE_COUNT;
+    report("queue_growth", "rss_before_kb", (double)rssBefore);
+    report("queue_growth", "rss_peak_kb", (double)rssPeak);
+    report("queue_growth", "rss_after_drain_kb", (double)rssAfterDrain);
+    report("queue_growth", "kb_per_queued_msg", kbPerMessage);
+
+    if (rssBefore == 0)
+    {
+        printf("the RSS cannot be read on this OS, the queue growth is not checked\r\n");
+    }
+    else if (kbPerMessage > maxKbPerMessage)
+    {
+        printf("each queued message took %.3f KB, the limit is %.3f KB\r\n", kbPerMessage, maxKbPerMessage);
+        ASSERT_FAIL("the queue grows too fast during an outage");
+    }
+}
+
+void impairment_time_to_recover_after_nat_timeout(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    IOTHUB_CLIENT_HANDLE iotHubClientHandle = connect_and_warm_up(deviceToUse, protocol);
+
+    // the connection goes idle, then the NAT forgets it without telling anybody
+    ThreadAPI_Sleep(NAT_IDLE_TIME_MS);
+    if (0 != network_impairment_expire_nat_mappings())
+    {
+        ASSERT_FAIL("expiring the NAT mappings failed");
+    }
+
+    double recoverySeconds = measure_recovery(iotHubClientHandle);
+
+    IoTHubClient_Destroy(iotHubClientHandle);
+    (void)network_impairment_clear();
+
+    assert_recovery_time("nat_timeout", recoverySeconds);
+}
+
+void impairment_time_to_recover_after_link_flaps(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    IOTHUB_CLIENT_HANDLE iotHubClientHandle = connect_and_warm_up(deviceToUse, protocol);
+
+    if (0 != network_impairment_flap(FLAP_COUNT, FLAP_OUTAGE_TIME_MS, FLAP_CONNECTED_TIME_MS))
+    {
+        ASSERT_FAIL("flapping the link failed");
+    }
+
+    double recoverySeconds = measure_recovery(iotHubClientHandle);
+
+    IoTHubClient_Destroy(iotHubClientHandle);
+
+    assert_recovery_time("link_flaps", recoverySeconds);
+}
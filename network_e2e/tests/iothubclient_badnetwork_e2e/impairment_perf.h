@@ -0,0 +1,35 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _IMPAIRMENT_PERF_H_
+#define _IMPAIRMENT_PERF_H_
+
+#include "iothub_client.h"
+#include "iothub_account.h"
+#include "network_impairment.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Every scenario prints its measurements as "PERF,<scenario>,<protocol>,<metric>,<value>" lines, so runs can be
+    // compared, and asserts them against a threshold that can be overridden by the environment variable given below.
+
+    // E2E_PERF_MIN_MSGS_PER_S (default 1.0), on NETWORK_PROFILE_HIGH_RTT
+    extern void impairment_throughput_on_high_rtt_link(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
+    // every message is confirmed, no threshold
+    extern void impairment_send_under_profile(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const NETWORK_IMPAIRMENT_PROFILE* profile);
+    // E2E_PERF_MAX_RECOVERY_S (default 60), after a 30 s outage
+    extern void impairment_time_to_recover_after_outage(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
+    // E2E_PERF_MAX_QUEUE_KB_PER_MSG (default 8), while the messages wait through a 30 s outage
+    extern void impairment_queue_growth_during_outage(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
+    // E2E_PERF_MAX_RECOVERY_S (default 60), after the NAT forgot the connection
+    extern void impairment_time_to_recover_after_nat_timeout(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
+    // E2E_PERF_MAX_RECOVERY_S (default 60), after the last of a series of short outages
+    extern void impairment_time_to_recover_after_link_flaps(IOTHUB_PROVISIONED_DEVICE* deviceToUse, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _IMPAIRMENT_PERF_H_
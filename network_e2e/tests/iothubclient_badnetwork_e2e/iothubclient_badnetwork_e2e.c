@@ -19,6 +19,8 @@
 #include "iothubclient_common_e2e.h"
 #include "iothubtransportamqp.h"
 #include "network_disconnect.h"
+#include "network_impairment.h"
+#include "impairment_perf.h"
 
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -58,6 +60,7 @@ BEGIN_TEST_SUITE(iothubclient_badnetwork_e2e)
             printf("Function cleanup -- reconnecting\r\n");
             network_reconnect();
         }
+        (void)network_impairment_clear();
     }
 
     TEST_FUNCTION(IotHub_BadNetwork_disconnect_create_send_reconnect_SAS)
@@ -90,5 +93,45 @@ BEGIN_TEST_SUITE(iothubclient_badnetwork_e2e)
         send_disconnect_send_reconnect_etc(IoTHubAccount_GetX509Device(g_iothubAcctInfo),g_protocol);
     }
 
+    TEST_FUNCTION(IotHub_BadNetwork_perf_throughput_on_high_rtt_link_SAS)
+    {
+        impairment_throughput_on_high_rtt_link(IoTHubAccount_GetSASDevice(g_iothubAcctInfo),g_protocol);
+    }
+
+    TEST_FUNCTION(IotHub_BadNetwork_perf_send_with_jitter_SAS)
+    {
+        impairment_send_under_profile(IoTHubAccount_GetSASDevice(g_iothubAcctInfo),g_protocol,&NETWORK_PROFILE_JITTER);
+    }
+
+    TEST_FUNCTION(IotHub_BadNetwork_perf_send_with_loss_SAS)
+    {
+        impairment_send_under_profile(IoTHubAccount_GetSASDevice(g_iothubAcctInfo),g_protocol,&NETWORK_PROFILE_LOSSY);
+    }
+
+    TEST_FUNCTION(IotHub_BadNetwork_perf_send_on_constrained_link_SAS)
+    {
+        impairment_send_under_profile(IoTHubAccount_GetSASDevice(g_iothubAcctInfo),g_protocol,&NETWORK_PROFILE_CONSTRAINED);
+    }
+
+    TEST_FUNCTION(IotHub_BadNetwork_perf_time_to_recover_after_outage_SAS)
+    {
+        impairment_time_to_recover_after_outage(IoTHubAccount_GetSASDevice(g_iothubAcctInfo),g_protocol);
+    }
+
+    TEST_FUNCTION(IotHub_BadNetwork_perf_queue_growth_during_outage_SAS)
+    {
+        impairment_queue_growth_during_outage(IoTHubAccount_GetSASDevice(g_iothubAcctInfo),g_protocol);
+    }
+
+    TEST_FUNCTION(IotHub_BadNetwork_perf_time_to_recover_after_nat_timeout_SAS)
+    {
+        impairment_time_to_recover_after_nat_timeout(IoTHubAccount_GetSASDevice(g_iothubAcctInfo),g_protocol);
+    }
+
+    TEST_FUNCTION(IotHub_BadNetwork_perf_time_to_recover_after_link_flaps_SAS)
+    {
+        impairment_time_to_recover_after_link_flaps(IoTHubAccount_GetSASDevice(g_iothubAcctInfo),g_protocol);
+    }
+
 END_TEST_SUITE(iothubclient_badnetwork_e2e)
 
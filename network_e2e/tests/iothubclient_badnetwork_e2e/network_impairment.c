@@ -0,0 +1,226 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "network_impairment.h"
+#include "azure_c_shared_utility/threadapi.h"
+
+// the impairments use tc (iproute2) and iptables, the container under test runs privileged
+#define IMPAIRMENT_COMMAND_SIZE 1024
+#define OUTAGE_RULE_COMMENT "e2e_outage"
+#define NAT_RULE_COMMENT "e2e_nat"
+
+const NETWORK_IMPAIRMENT_PROFILE NETWORK_PROFILE_HIGH_RTT = { "high_rtt", 600, 0, 0, 0 };
+const NETWORK_IMPAIRMENT_PROFILE NETWORK_PROFILE_JITTER = { "jitter", 200, 150, 0, 0 };
+const NETWORK_IMPAIRMENT_PROFILE NETWORK_PROFILE_LOSSY = { "lossy", 0, 0, 5, 0 };
+const NETWORK_IMPAIRMENT_PROFILE NETWORK_PROFILE_CONSTRAINED = { "constrained", 300, 0, 1, 64 };
+
+static const NETWORK_IMPAIRMENT_PROFILE* g_profiles[] =
+{
+    &NETWORK_PROFILE_HIGH_RTT,
+    &NETWORK_PROFILE_JITTER,
+    &NETWORK_PROFILE_LOSSY,
+    &NETWORK_PROFILE_CONSTRAINED
+};
+
+static const char* get_interface()
+{
+    const char* result = getenv("E2E_IMPAIRMENT_INTERFACE");
+    if (result == NULL || *result == 0)
+    {
+        result = "eth0";
+    }
+    return result;
+}
+
+static int run_command(const char* command)
+{
+    int result;
+
+#if defined(__linux__)
+    printf("**** %s ****\r\n", command);
+    result = system(command);
+    if (result != 0)
+    {
+        printf("command returned %d\r\n", result);
+    }
+#else
+    (void)command;
+    ASSERT_FAIL("Network impairments not implemented on this OS\r\n");
+    result = __FAILURE__;
+#endif
+
+    return result;
+}
+
+const NETWORK_IMPAIRMENT_PROFILE* network_impairment_find_profile(const char* name)
+{
+    const NETWORK_IMPAIRMENT_PROFILE* result = NULL;
+
+    for (size_t i = 0; i < sizeof(g_profiles) / sizeof(g_profiles[0]); i++)
+    {
+        if (strcmp(g_profiles[i]->name, name) == 0)
+        {
+            result = g_profiles[i];
+            break;
+        }
+    }
+
+    return result;
+}
+
+int network_impairment_apply(const NETWORK_IMPAIRMENT_PROFILE* profile)
+{
+    int result;
+    char command[IMPAIRMENT_COMMAND_SIZE];
+    int length;
+
+    printf("**** applying network profile %s ****\r\n", profile->name);
+
+    // replace rather than add, so profiles can follow each other without a clear in between
+    length = snprintf(command, sizeof(command), "tc qdisc replace dev %s root netem", get_interface());
+    if (profile->delay_ms != 0)
+    {
+        length += snprintf(command + length, sizeof(command) - length, " delay %ums", profile->delay_ms);
+        if (profile->jitter_ms != 0)
+        {
+            length += snprintf(command + length, sizeof(command) - length, " %ums distribution normal", profile->jitter_ms);
+        }
+    }
+    if (profile->loss_percent != 0)
+    {
+        length += snprintf(command + length, sizeof(command) - length, " loss %u%%", profile->loss_percent);
+    }
+    if (profile->rate_kbit != 0)
+    {
+        length += snprintf(command + length, sizeof(command) - length, " rate %ukbit", profile->rate_kbit);
+    }
+
+    result = run_command(command);
+
+    return result;
+}
+
+static int delete_rules(const char* comment)
+{
+    char command[IMPAIRMENT_COMMAND_SIZE];
+
+    (void)snprintf(command, sizeof(command),
+        "for chain in INPUT OUTPUT; do iptables -S $chain | grep -e '--comment %s' | sed 's/^-A/-D/' | xargs -r -L1 iptables; done",
+        comment);
+
+    return run_command(command);
+}
+
+int network_impairment_clear()
+{
+    int result = 0;
+    char command[IMPAIRMENT_COMMAND_SIZE];
+
+    // deleting a qdisc that is not there fails, which is fine
+    (void)snprintf(command, sizeof(command), "tc qdisc del dev %s root 2>/dev/null", get_interface());
+    (void)run_command(command);
+
+    if (delete_rules(OUTAGE_RULE_COMMENT) != 0 ||
+        delete_rules(NAT_RULE_COMMENT) != 0)
+    {
+        result = __FAILURE__;
+    }
+
+    return result;
+}
+
+int network_impairment_start_outage()
+{
+    char command[IMPAIRMENT_COMMAND_SIZE];
+    const char* networkInterface = get_interface();
+
+    (void)snprintf(command, sizeof(command),
+        "iptables -I OUTPUT -o %s -m comment --comment " OUTAGE_RULE_COMMENT " -j DROP && "
+        "iptables -I INPUT -i %s -m comment --comment " OUTAGE_RULE_COMMENT " -j DROP",
+        networkInterface, networkInterface);
+
+    return run_command(command);
+}
+
+int network_impairment_end_outage()
+{
+    return delete_rules(OUTAGE_RULE_COMMENT);
+}
+
+int network_impairment_expire_nat_mappings()
+{
+    char command[IMPAIRMENT_COMMAND_SIZE];
+    const char* networkInterface = get_interface();
+
+    // ss prints the local address:port of every established connection in its third column
+    (void)snprintf(command, sizeof(command),
+        "for port in $(ss -tn state established | tail -n +2 | awk '{print $3}' | sed 's/.*://'); do "
+        "iptables -I OUTPUT -o %s -p tcp --sport $port -m comment --comment " NAT_RULE_COMMENT " -j DROP && "
+        "iptables -I INPUT -i %s -p tcp --dport $port -m comment --comment " NAT_RULE_COMMENT " -j DROP || exit 1; "
+        "done",
+        networkInterface, networkInterface);
+
+    return run_command(command);
+}
+
+int network_impairment_flap(size_t flap_count, unsigned int outage_ms, unsigned int connected_ms)
+{
+    int result = 0;
+
+    for (size_t i = 0; (i < flap_count) && (result == 0); i++)
+    {
+        if (network_impairment_start_outage() != 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            ThreadAPI_Sleep(outage_ms);
+            if (network_impairment_end_outage() != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                ThreadAPI_Sleep(connected_ms);
+            }
+        }
+    }
+
+    return result;
+}
+
+size_t network_impairment_get_rss_kb()
+{
+    size_t result = 0;
+
+#if defined(__linux__)
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL)
+    {
+        unsigned long totalPages;
+        unsigned long residentPages;
+        if (fscanf(statm, "%lu %lu", &totalPages, &residentPages) == 2)
+        {
+            result = (size_t)residentPages * (size_t)(sysconf(_SC_PAGESIZE) / 1024);
+        }
+        (void)fclose(statm);
+    }
+#endif
+
+    return result;
+}
@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _NETWORK_IMPAIRMENT_H_
+#define _NETWORK_IMPAIRMENT_H_
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+    // A netem profile applied to the egress of the container under test.  Everything leaving the container is
+    // delayed, so delay_ms is the round trip time added to the link.  0 leaves a setting out.
+    typedef struct NETWORK_IMPAIRMENT_PROFILE_TAG
+    {
+        const char* name;
+        unsigned int delay_ms;
+        unsigned int jitter_ms;
+        unsigned int loss_percent;
+        unsigned int rate_kbit;
+    } NETWORK_IMPAIRMENT_PROFILE;
+
+    extern const NETWORK_IMPAIRMENT_PROFILE NETWORK_PROFILE_HIGH_RTT;       // 600 ms round trip, satellite like
+    extern const NETWORK_IMPAIRMENT_PROFILE NETWORK_PROFILE_JITTER;         // 200 ms +/- 150 ms, cellular like
+    extern const NETWORK_IMPAIRMENT_PROFILE NETWORK_PROFILE_LOSSY;          // 5% loss
+    extern const NETWORK_IMPAIRMENT_PROFILE NETWORK_PROFILE_CONSTRAINED;    // 64 kbit/s, 300 ms round trip, 1% loss
+
+    extern const NETWORK_IMPAIRMENT_PROFILE* network_impairment_find_profile(const char* name);
+
+    extern int network_impairment_apply(const NETWORK_IMPAIRMENT_PROFILE* profile);
+    extern int network_impairment_clear();
+
+    // Drops every packet in and out of the container, the interface stays up and nobody gets a reset or an ICMP
+    // error: the peer of every connection just stops answering.  The netem profile, if any, stays in place.
+    extern int network_impairment_start_outage();
+    extern int network_impairment_end_outage();
+
+    // Drops the packets of the TCP connections established right now, new connections still go through.  This is what
+    // the client sees when a NAT or a firewall forgets an idle mapping.
+    extern int network_impairment_expire_nat_mappings();
+
+    // Alternates outage_ms without network and connected_ms with network, flap_count times.
+    extern int network_impairment_flap(size_t flap_count, unsigned int outage_ms, unsigned int connected_ms);
+
+    // Resident set size of the test process, in KB, or 0 where it cannot be read.
+    extern size_t network_impairment_get_rss_kb();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _NETWORK_IMPAIRMENT_H_
@@ -594,11 +594,23 @@ DEFINE_ENUM(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_RESULT_VALUES);
     EDM_COMPLEX_TYPE_TYPE,                                                         \
     EDM_NULL_TYPE,                                                                 \
     EDM_ENTITY_TYPE_TYPE,                                                          \
-    EDM_STRING_NO_QUOTES_TYPE                                                      \
+    EDM_STRING_NO_QUOTES_TYPE,                                                     \
+    EDM_ARRAY_TYPE                                                                 \
 
 
 DEFINE_ENUM(AGENT_DATA_TYPE_TYPE, AGENT_DATA_TYPE_TYPE_VALUES);
 
+/*EDM_ARRAY - this type doesn't exist in EDMX as a primitive type. It is a copy of a C array of count values of elementSize bytes each.
+  elementType is EDM_BOOLEAN_TYPE for bool, EDM_BYTE_TYPE for uint8_t, EDM_SINGLE_TYPE for float, EDM_DOUBLE_TYPE for double and
+  EDM_SBYTE_TYPE, EDM_INT16_TYPE, EDM_INT32_TYPE or EDM_INT64_TYPE for the signed integers, whose width is given by elementSize*/
+typedef struct EDM_ARRAY_TAG
+{
+    AGENT_DATA_TYPE_TYPE elementType;
+    size_t elementSize;
+    size_t count;
+    void* values;
+}EDM_ARRAY;
+
 struct AGENT_DATA_TYPE_TAG
 {
     AGENT_DATA_TYPE_TYPE type;
@@ -639,6 +651,7 @@ struct AGENT_DATA_TYPE_TAG
         EDM_GEOMETRY_MULTI_POLYGON edmGeometryMultiPolygon;
         EDM_GEOMETRY_COLLECTION edmGeometryCollection;
         EDM_COMPLEX_TYPE edmComplexType;
+        EDM_ARRAY edmArray;
     } value;
 };
 
@@ -693,6 +706,9 @@ MOCKABLE_FUNCTION(, AGENT_DATA_TYPES_RESULT, Create_AGENT_DATA_TYPE_from_charz,
 /*create an AGENT_DATA_TYPE from ANSI zero terminated string (no quotes)*/
 MOCKABLE_FUNCTION(, AGENT_DATA_TYPES_RESULT, Create_AGENT_DATA_TYPE_from_charz_no_quotes, AGENT_DATA_TYPE*, agentData, const char*, v);
 
+/*create an AGENT_DATA_TYPE of type EDM_ARRAY_TYPE holding a copy of the count values of the C array values, see EDM_ARRAY*/
+MOCKABLE_FUNCTION(, AGENT_DATA_TYPES_RESULT, Create_AGENT_DATA_TYPE_from_Array, AGENT_DATA_TYPE*, agentData, AGENT_DATA_TYPE_TYPE, elementType, size_t, elementSize, const void*, values, size_t, count);
+
 /*create an AGENT_DATA_TYPE of type EDM_NULL_TYPE */
 MOCKABLE_FUNCTION(, AGENT_DATA_TYPES_RESULT, Create_NULL_AGENT_DATA_TYPE, AGENT_DATA_TYPE*, agentData);
 
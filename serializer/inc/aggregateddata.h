@@ -0,0 +1,43 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef AGGREGATEDDATA_H
+#define AGGREGATEDDATA_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+#include "agenttypesystem.h"
+
+/*the complex type name under which the window summary of a WITH_AGGREGATED_DATA field is reported*/
+#define AGGREGATED_DATA_TYPE_NAME "AGGREGATED_DATA"
+
+/*incremental state of a window. The samples themselves live in caller provided storage of 2 * windowSize doubles:
+the first windowSize doubles are the ring (in arrival order), the next windowSize doubles are the same samples kept sorted*/
+typedef struct AGGREGATED_DATA_STATE_TAG
+{
+    size_t count;
+    size_t next;
+    double sum;
+} AGGREGATED_DATA_STATE;
+
+/*converts one summary value (min, max, percentiles) back to the declared type of the field*/
+typedef AGENT_DATA_TYPES_RESULT(*AGGREGATED_DATA_TO_AGENT_DATA_TYPE)(AGENT_DATA_TYPE* destination, double value);
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+MOCKABLE_FUNCTION(, int, AggregatedData_Add, AGGREGATED_DATA_STATE*, state, double*, samples, size_t, windowSize, double, sample);
+MOCKABLE_FUNCTION(, int, AggregatedData_Reset, AGGREGATED_DATA_STATE*, state);
+MOCKABLE_FUNCTION(, AGENT_DATA_TYPES_RESULT, AggregatedData_ToAGENT_DATA_TYPE, AGENT_DATA_TYPE*, destination, const AGGREGATED_DATA_STATE*, state, const double*, samples, size_t, windowSize, AGGREGATED_DATA_TO_AGENT_DATA_TYPE, toAgentDataType);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AGGREGATEDDATA_H */
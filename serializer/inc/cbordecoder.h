@@ -0,0 +1,34 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef CBORDECODER_H
+#define CBORDECODER_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+#define CBOR_DECODER_RESULT_VALUES           \
+CBOR_DECODER_OK,                             \
+CBOR_DECODER_INVALID_ARG,                    \
+CBOR_DECODER_PARSE_ERROR,                    \
+CBOR_DECODER_ERROR
+
+DEFINE_ENUM(CBOR_DECODER_RESULT, CBOR_DECODER_RESULT_VALUES);
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+/*converts one CBOR data item to the JSON text the serializer consumes (EXECUTE_COMMAND, INGEST_DESIRED_PROPERTIES);
+on success *json is a null terminated string that has to be freed by the caller*/
+MOCKABLE_FUNCTION(, CBOR_DECODER_RESULT, CBORDecoder_CBOR_To_JSON, const unsigned char*, cbor, size_t, cborSize, char**, json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CBORDECODER_H */
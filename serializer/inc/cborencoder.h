@@ -0,0 +1,39 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef CBORENCODER_H
+#define CBORENCODER_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+#include "multitree.h"
+
+/*the content type of the messages produced by CBOREncoder (RFC 7049)*/
+#define CBOR_ENCODER_CONTENT_TYPE "application/cbor"
+
+#define CBOR_ENCODER_RESULT_VALUES           \
+CBOR_ENCODER_OK,                             \
+CBOR_ENCODER_INVALID_ARG,                    \
+CBOR_ENCODER_MULTITREE_ERROR,                \
+CBOR_ENCODER_TOSTRING_FUNCTION_ERROR,        \
+CBOR_ENCODER_ERROR
+
+DEFINE_ENUM(CBOR_ENCODER_RESULT, CBOR_ENCODER_RESULT_VALUES);
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+/*the values of the leafs of treeHandle are AGENT_DATA_TYPE*; on success *destination is allocated and has to be freed by the caller*/
+MOCKABLE_FUNCTION(, CBOR_ENCODER_RESULT, CBOREncoder_EncodeTree_ToBuffer, MULTITREE_HANDLE, treeHandle, unsigned char**, destination, size_t*, destinationSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CBORENCODER_H */
@@ -178,10 +178,21 @@ MOCKABLE_FUNCTION(, METHODRETURN_HANDLE, CodeFirst_ExecuteMethod, void*, device,
 MOCKABLE_FUNCTION(, void*, CodeFirst_CreateDevice, SCHEMA_MODEL_TYPE_HANDLE, model, const REFLECTED_DATA_FROM_DATAPROVIDER*, metadata, size_t, dataSize, bool, includePropertyPath);
 MOCKABLE_FUNCTION(, void, CodeFirst_DestroyDevice, void*, device);
 
+MOCKABLE_FUNCTION(, void, CodeFirst_SetDirectSerialization, bool, directSerialization);
+MOCKABLE_FUNCTION(, void, CodeFirst_SetCBOREncoding, bool, cborEncoding);
+
 extern CODEFIRST_RESULT CodeFirst_SendAsync(unsigned char** destination, size_t* destinationSize, size_t numProperties, ...);
+
+/*takes over destination (allocated with malloc) and returns 0, or returns non-zero and leaves destination to the caller*/
+typedef int(*CODEFIRST_HAND_OFF)(void* handOffContext, unsigned char* destination, size_t destinationSize);
+extern CODEFIRST_RESULT CodeFirst_SendAsyncHandOff(CODEFIRST_HAND_OFF handOff, void* handOffContext, size_t numProperties, ...);
+extern CODEFIRST_RESULT CodeFirst_SendAsyncBatch(unsigned char** destination, size_t* destinationSize, void* const* instances, size_t instanceCount, size_t numProperties, ...);
 extern CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t* destinationSize, size_t numReportedProperties, ...);
+extern CODEFIRST_RESULT CodeFirst_SendAsyncReportedDelta(unsigned char** destination, size_t* destinationSize, size_t numReportedProperties, ...);
+MOCKABLE_FUNCTION(, CODEFIRST_RESULT, CodeFirst_AcknowledgeReportedPropertiesDelta, void*, device);
 
 MOCKABLE_FUNCTION(, CODEFIRST_RESULT, CodeFirst_IngestDesiredProperties, void*, device, const char*, desiredProperties);
+MOCKABLE_FUNCTION(, CODEFIRST_RESULT, CodeFirst_GetDesiredPropertiesVersion, void*, device, int64_t*, version);
 
 MOCKABLE_FUNCTION(, AGENT_DATA_TYPE_TYPE, CodeFirst_GetPrimitiveType, const char*, typeName);
 
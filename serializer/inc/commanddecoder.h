@@ -43,6 +43,9 @@ MOCKABLE_FUNCTION(,METHODRETURN_HANDLE, CommandDecoder_ExecuteMethod, COMMAND_DE
 MOCKABLE_FUNCTION(,void, CommandDecoder_Destroy, COMMAND_DECODER_HANDLE, commandDecoderHandle);
 
 MOCKABLE_FUNCTION(, EXECUTE_COMMAND_RESULT, CommandDecoder_IngestDesiredProperties, void*, startAddress, COMMAND_DECODER_HANDLE, handle, const char*, desiredProperties);
+MOCKABLE_FUNCTION(, void, CommandDecoder_SetStreamingDesiredProperties, bool, streamDesiredProperties);
+MOCKABLE_FUNCTION(, void, CommandDecoder_SetChangeOnlyDesiredProperties, bool, changeOnlyDesiredProperties);
+MOCKABLE_FUNCTION(, int, CommandDecoder_GetDesiredPropertiesVersion, COMMAND_DECODER_HANDLE, handle, int64_t*, version);
 
 #ifdef __cplusplus
 }
@@ -44,6 +44,9 @@ MOCKABLE_FUNCTION(,DATA_MARSHALLER_RESULT, DataMarshaller_SendData, DATA_MARSHAL
 
 MOCKABLE_FUNCTION(, DATA_MARSHALLER_RESULT, DataMarshaller_SendData_ReportedProperties, DATA_MARSHALLER_HANDLE, dataMarshallerHandle, VECTOR_HANDLE, values, unsigned char**, destination, size_t*, destinationSize);
 
+/*selects the encoding of DataMarshaller_SendData: false (default) for JSON, true for CBOR (see cborencoder.h)*/
+MOCKABLE_FUNCTION(, void, DataMarshaller_SetCBOREncoding, bool, value);
+
 #ifdef __cplusplus
 }
 #endif
@@ -40,6 +40,7 @@ MOCKABLE_FUNCTION(,DATA_PUBLISHER_RESULT, DataPublisher_EndTransaction, TRANSACT
 MOCKABLE_FUNCTION(,DATA_PUBLISHER_RESULT, DataPublisher_CancelTransaction, TRANSACTION_HANDLE, transactionHandle);
 MOCKABLE_FUNCTION(,void, DataPublisher_SetMaxBufferSize, size_t, value);
 MOCKABLE_FUNCTION(,size_t, DataPublisher_GetMaxBufferSize);
+MOCKABLE_FUNCTION(,void, DataPublisher_SetTransactionArenaSize, size_t, value);
 
 MOCKABLE_FUNCTION(, REPORTED_PROPERTIES_TRANSACTION_HANDLE, DataPublisher_CreateTransaction_ReportedProperties, DATA_PUBLISHER_HANDLE, dataPublisherHandle);
 MOCKABLE_FUNCTION(, DATA_PUBLISHER_RESULT, DataPublisher_PublishTransacted_ReportedProperty, REPORTED_PROPERTIES_TRANSACTION_HANDLE, transactionHandle, const char*, reportedPropertyPath, const AGENT_DATA_TYPE*, data);
@@ -22,8 +22,20 @@ typedef enum JSON_DECODER_RESULT_TAG
     JSON_DECODER_ERROR
 } JSON_DECODER_RESULT;
 
+/*callbacks used by JSONDecoder_JSON_To_Callbacks. Any of them can be NULL. Returning non-zero stops the parsing.*/
+/*names and values point inside the json being parsed, values are as they appear in the JSON (strings keep their quotes)*/
+typedef struct JSON_DECODER_CALLBACKS_TAG
+{
+    int(*onObjectBegin)(void* context, const char* name);
+    int(*onObjectEnd)(void* context);
+    int(*onArrayBegin)(void* context, const char* name);
+    int(*onArrayEnd)(void* context);
+    int(*onValue)(void* context, const char* name, const char* value);
+} JSON_DECODER_CALLBACKS;
+
 #include "azure_c_shared_utility/umock_c_prod.h"
 MOCKABLE_FUNCTION(, JSON_DECODER_RESULT, JSONDecoder_JSON_To_MultiTree, char*, json, MULTITREE_HANDLE*, multiTreeHandle);
+MOCKABLE_FUNCTION(, JSON_DECODER_RESULT, JSONDecoder_JSON_To_Callbacks, char*, json, const JSON_DECODER_CALLBACKS*, callbacks, void*, callbackContext);
 
 #ifdef __cplusplus
 }
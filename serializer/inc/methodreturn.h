@@ -6,17 +6,24 @@
 
 typedef struct METHODRETURN_HANDLE_DATA_TAG* METHODRETURN_HANDLE;
 
+#include <stddef.h>
 #include "azure_c_shared_utility/macro_utils.h"
 
 /*the following macro expands to "const" if X is defined. If X is not defined, then it expands to nothing*/
 #define CONST_BY_COMPILATION_UNIT(X) IF(COUNT_ARG(X),const,)
 
+/*jsonValue is null terminated when created by MethodReturn_Create. A return created from a buffer carries
+the bytes of the buffer as they are, so jsonValueSize is the only reliable length*/
 typedef struct METHODRETURN_DATA_TAG
 {
     CONST_BY_COMPILATION_UNIT(METHODRETURN_C) int statusCode;
     CONST_BY_COMPILATION_UNIT(METHODRETURN_C) char* jsonValue;
+    CONST_BY_COMPILATION_UNIT(METHODRETURN_C) size_t jsonValueSize;
 }METHODRETURN_DATA;
 
+/*called by MethodReturn_Destroy when a borrowed buffer is no longer used*/
+typedef void(*METHODRETURN_BUFFER_FREE_CALLBACK)(const char* jsonValue, void* context);
+
 #include "azure_c_shared_utility/umock_c_prod.h"
 
 #ifdef __cplusplus
@@ -25,6 +32,9 @@ extern "C"
 #endif
 
 MOCKABLE_FUNCTION(, METHODRETURN_HANDLE, MethodReturn_Create, int, statusCode, const char*, jsonValue);
+MOCKABLE_FUNCTION(, METHODRETURN_HANDLE, MethodReturn_CreateFromBorrowedBuffer, int, statusCode, const char*, jsonValue, size_t, size, METHODRETURN_BUFFER_FREE_CALLBACK, freeCallback, void*, context);
+MOCKABLE_FUNCTION(, METHODRETURN_HANDLE, MethodReturn_CreateFromSerializedBuffer, int, statusCode, unsigned char*, buffer, size_t, size);
+MOCKABLE_FUNCTION(, unsigned char*, MethodReturn_DetachBuffer, METHODRETURN_HANDLE, handle, size_t*, size);
 MOCKABLE_FUNCTION(, void, MethodReturn_Destroy, METHODRETURN_HANDLE, handle);
 MOCKABLE_FUNCTION(, const METHODRETURN_DATA*, MethodReturn_GetReturn, METHODRETURN_HANDLE, handle);
 
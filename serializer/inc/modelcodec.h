@@ -0,0 +1,305 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   modelcodec.h
+*   @brief  Encoders and decoders generated at compile time for the models that need the fastest serialization.
+*
+*   @details    DECLARE_MODEL_CODEC(modelName, type1, field1, type2, field2...) expands to two functions specialized for
+*               the listed fields of the model:
+*               - ModelCodec_Encode_modelName(const modelName* instance, unsigned char** destination, size_t* destinationSize)
+*                 writes the JSON SERIALIZE(destination, destinationSize, instance->field1, instance->field2...) writes, with
+*                 the key strings known at compile time, one allocation sized from the fields and one write per field.
+*               - ModelCodec_Decode_modelName(modelName* instance, const char* json) reads a JSON object straight into
+*                 the fields, comparing each key with the known names; other keys are skipped.
+*               Both return 0 on success. The fields are top level model properties of the types int, long, int8_t,
+*               uint8_t, int16_t, int32_t, int64_t, bool, float, double and ascii_char_ptr, or WITH_ARRAY fields of the
+*               numeric and bool types, listed as array_type (array_float...); any other type does not compile and stays
+*               with the SERIALIZE and desired property APIs. For example:
+*       <pre>
+*       DECLARE_MODEL(Thermostat,
+*           WITH_DATA(double, Temperature),
+*           WITH_DATA(int, Humidity),
+*           WITH_DATA(ascii_char_ptr, DeviceId)
+*       );
+*       DECLARE_MODEL_CODEC(Thermostat, double, Temperature, int, Humidity, ascii_char_ptr, DeviceId);
+*
+*       if (MODEL_CODEC_ENCODE(Thermostat, thermostat, &destination, &destinationSize) == 0) ...
+*       </pre>
+*/
+
+#ifndef MODELCODEC_H
+#define MODELCODEC_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+#include "agenttypesystem.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cfloat>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <float.h>
+#endif
+
+/*the longest text ModelCodec_WriteInt64 writes: "-9223372036854775808"*/
+#define MODEL_CODEC_MAX_INTEGER_LENGTH 20
+/*the longest text ModelCodec_WriteDouble writes, the bound AgentDataTypes_ToString has for a double*/
+#define MODEL_CODEC_MAX_DOUBLE_LENGTH (DECIMAL_DIG * 2 + 2)
+
+/*the position of a decoder in the JSON text it reads*/
+typedef struct MODEL_CODEC_READER_TAG
+{
+    const char* position;
+    bool hasMembers;
+} MODEL_CODEC_READER;
+
+/*the writers write the text SERIALIZE writes for a value and return its length, or a negative number when it cannot be written*/
+extern int ModelCodec_WriteInt64(char* destination, int64_t value);
+extern int ModelCodec_WriteBool(char* destination, bool value);
+#ifndef NO_FLOATS
+extern int ModelCodec_WriteFloat(char* destination, float value);
+extern int ModelCodec_WriteDouble(char* destination, double value);
+#endif
+extern size_t ModelCodec_GetStringMaxLength(const char* value);
+extern int ModelCodec_WriteString(char* destination, const char* value);
+
+extern int ModelCodec_BeginObject(MODEL_CODEC_READER* reader, const char* json);
+extern int ModelCodec_NextKey(MODEL_CODEC_READER* reader, const char** key, size_t* keyLength, bool* isEnd);
+extern int ModelCodec_SkipValue(MODEL_CODEC_READER* reader);
+
+/*the readers read the value at the position of the reader, they leave the destination as it was when it is not of their type*/
+extern int ModelCodec_ReadInt(MODEL_CODEC_READER* reader, int* destination);
+extern int ModelCodec_ReadLong(MODEL_CODEC_READER* reader, long* destination);
+extern int ModelCodec_ReadInt8(MODEL_CODEC_READER* reader, int8_t* destination);
+extern int ModelCodec_ReadUInt8(MODEL_CODEC_READER* reader, uint8_t* destination);
+extern int ModelCodec_ReadInt16(MODEL_CODEC_READER* reader, int16_t* destination);
+extern int ModelCodec_ReadInt32(MODEL_CODEC_READER* reader, int32_t* destination);
+extern int ModelCodec_ReadInt64(MODEL_CODEC_READER* reader, int64_t* destination);
+extern int ModelCodec_ReadBool(MODEL_CODEC_READER* reader, bool* destination);
+#ifndef NO_FLOATS
+extern int ModelCodec_ReadFloat(MODEL_CODEC_READER* reader, float* destination);
+extern int ModelCodec_ReadDouble(MODEL_CODEC_READER* reader, double* destination);
+#endif
+/*frees the previous string of destination, as the desired properties do, and sets it to a copy of the value*/
+extern int ModelCodec_ReadString(MODEL_CODEC_READER* reader, char** destination);
+
+/*arrays are length values of elementSize bytes, elementType tells what they are as it does for EDM_ARRAY*/
+extern size_t ModelCodec_GetArrayMaxLength(AGENT_DATA_TYPE_TYPE elementType, size_t length);
+extern int ModelCodec_WriteArray(char* destination, AGENT_DATA_TYPE_TYPE elementType, size_t elementSize, const void* values, size_t length);
+/*reads at most capacity values, length is 0 when the array cannot be read*/
+extern int ModelCodec_ReadArray(MODEL_CODEC_READER* reader, AGENT_DATA_TYPE_TYPE elementType, size_t elementSize, void* values, size_t* length, size_t capacity);
+
+/*the type of the WITH_ARRAY properties in the schema*/
+#define ARRAY_TYPE_NAME "ARRAY"
+
+/*the values an array of each type holds*/
+#define MODEL_CODEC_ELEMENT_TYPE_int EDM_INT32_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE_long EDM_INT64_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE_int8_t EDM_SBYTE_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE_uint8_t EDM_BYTE_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE_int16_t EDM_INT16_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE_int32_t EDM_INT32_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE_int64_t EDM_INT64_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE_bool EDM_BOOLEAN_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE__Bool EDM_BOOLEAN_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE_float EDM_SINGLE_TYPE
+#define MODEL_CODEC_ELEMENT_TYPE_double EDM_DOUBLE_TYPE
+
+/*what the generated code calls for each type. bool is a macro of _Bool in C, so both names are given*/
+#define MODEL_CODEC_MAX_LENGTH_int(value) MODEL_CODEC_MAX_INTEGER_LENGTH
+#define MODEL_CODEC_MAX_LENGTH_long(value) MODEL_CODEC_MAX_INTEGER_LENGTH
+#define MODEL_CODEC_MAX_LENGTH_int8_t(value) MODEL_CODEC_MAX_INTEGER_LENGTH
+#define MODEL_CODEC_MAX_LENGTH_uint8_t(value) MODEL_CODEC_MAX_INTEGER_LENGTH
+#define MODEL_CODEC_MAX_LENGTH_int16_t(value) MODEL_CODEC_MAX_INTEGER_LENGTH
+#define MODEL_CODEC_MAX_LENGTH_int32_t(value) MODEL_CODEC_MAX_INTEGER_LENGTH
+#define MODEL_CODEC_MAX_LENGTH_int64_t(value) MODEL_CODEC_MAX_INTEGER_LENGTH
+#define MODEL_CODEC_MAX_LENGTH_bool(value) 5
+#define MODEL_CODEC_MAX_LENGTH__Bool(value) 5
+#define MODEL_CODEC_MAX_LENGTH_float(value) MODEL_CODEC_MAX_DOUBLE_LENGTH
+#define MODEL_CODEC_MAX_LENGTH_double(value) MODEL_CODEC_MAX_DOUBLE_LENGTH
+#define MODEL_CODEC_MAX_LENGTH_ascii_char_ptr(value) ModelCodec_GetStringMaxLength(value)
+
+#define MODEL_CODEC_WRITE_int(destination, value) ModelCodec_WriteInt64(destination, (int64_t)(value))
+#define MODEL_CODEC_WRITE_long(destination, value) ModelCodec_WriteInt64(destination, (int64_t)(value))
+#define MODEL_CODEC_WRITE_int8_t(destination, value) ModelCodec_WriteInt64(destination, (int64_t)(value))
+#define MODEL_CODEC_WRITE_uint8_t(destination, value) ModelCodec_WriteInt64(destination, (int64_t)(value))
+#define MODEL_CODEC_WRITE_int16_t(destination, value) ModelCodec_WriteInt64(destination, (int64_t)(value))
+#define MODEL_CODEC_WRITE_int32_t(destination, value) ModelCodec_WriteInt64(destination, (int64_t)(value))
+#define MODEL_CODEC_WRITE_int64_t(destination, value) ModelCodec_WriteInt64(destination, (value))
+#define MODEL_CODEC_WRITE_bool(destination, value) ModelCodec_WriteBool(destination, (value))
+#define MODEL_CODEC_WRITE__Bool(destination, value) ModelCodec_WriteBool(destination, (value))
+#define MODEL_CODEC_WRITE_float(destination, value) ModelCodec_WriteFloat(destination, (value))
+#define MODEL_CODEC_WRITE_double(destination, value) ModelCodec_WriteDouble(destination, (value))
+#define MODEL_CODEC_WRITE_ascii_char_ptr(destination, value) ModelCodec_WriteString(destination, (value))
+
+#define MODEL_CODEC_READ_int ModelCodec_ReadInt
+#define MODEL_CODEC_READ_long ModelCodec_ReadLong
+#define MODEL_CODEC_READ_int8_t ModelCodec_ReadInt8
+#define MODEL_CODEC_READ_uint8_t ModelCodec_ReadUInt8
+#define MODEL_CODEC_READ_int16_t ModelCodec_ReadInt16
+#define MODEL_CODEC_READ_int32_t ModelCodec_ReadInt32
+#define MODEL_CODEC_READ_int64_t ModelCodec_ReadInt64
+#define MODEL_CODEC_READ_bool ModelCodec_ReadBool
+#define MODEL_CODEC_READ__Bool ModelCodec_ReadBool
+#define MODEL_CODEC_READ_float ModelCodec_ReadFloat
+#define MODEL_CODEC_READ_double ModelCodec_ReadDouble
+#define MODEL_CODEC_READ_ascii_char_ptr ModelCodec_ReadString
+
+/*a WITH_ARRAY field of type is listed as array_type, it is a struct with the values and their length*/
+#define MODEL_CODEC_ARRAY_CAPACITY(field) (sizeof((field).values) / sizeof((field).values[0]))
+#define MODEL_CODEC_MAX_LENGTH_ARRAY(type, value) \
+    ModelCodec_GetArrayMaxLength(C2(MODEL_CODEC_ELEMENT_TYPE_, type), ((value).length > MODEL_CODEC_ARRAY_CAPACITY(value)) ? 0 : (value).length)
+#define MODEL_CODEC_WRITE_ARRAY(type, destination, value) \
+    (((value).length > MODEL_CODEC_ARRAY_CAPACITY(value)) ? -1 : ModelCodec_WriteArray(destination, C2(MODEL_CODEC_ELEMENT_TYPE_, type), sizeof((value).values[0]), (value).values, (value).length))
+#define MODEL_CODEC_READ_ARRAY(type, reader, field) \
+    ModelCodec_ReadArray(reader, C2(MODEL_CODEC_ELEMENT_TYPE_, type), sizeof((field)->values[0]), (field)->values, &(field)->length, MODEL_CODEC_ARRAY_CAPACITY(*(field)))
+
+#define MODEL_CODEC_MAX_LENGTH_array_int(value) MODEL_CODEC_MAX_LENGTH_ARRAY(int, value)
+#define MODEL_CODEC_MAX_LENGTH_array_long(value) MODEL_CODEC_MAX_LENGTH_ARRAY(long, value)
+#define MODEL_CODEC_MAX_LENGTH_array_int8_t(value) MODEL_CODEC_MAX_LENGTH_ARRAY(int8_t, value)
+#define MODEL_CODEC_MAX_LENGTH_array_uint8_t(value) MODEL_CODEC_MAX_LENGTH_ARRAY(uint8_t, value)
+#define MODEL_CODEC_MAX_LENGTH_array_int16_t(value) MODEL_CODEC_MAX_LENGTH_ARRAY(int16_t, value)
+#define MODEL_CODEC_MAX_LENGTH_array_int32_t(value) MODEL_CODEC_MAX_LENGTH_ARRAY(int32_t, value)
+#define MODEL_CODEC_MAX_LENGTH_array_int64_t(value) MODEL_CODEC_MAX_LENGTH_ARRAY(int64_t, value)
+#define MODEL_CODEC_MAX_LENGTH_array_bool(value) MODEL_CODEC_MAX_LENGTH_ARRAY(bool, value)
+#define MODEL_CODEC_MAX_LENGTH_array_float(value) MODEL_CODEC_MAX_LENGTH_ARRAY(float, value)
+#define MODEL_CODEC_MAX_LENGTH_array_double(value) MODEL_CODEC_MAX_LENGTH_ARRAY(double, value)
+#define MODEL_CODEC_WRITE_array_int(destination, value) MODEL_CODEC_WRITE_ARRAY(int, destination, value)
+#define MODEL_CODEC_WRITE_array_long(destination, value) MODEL_CODEC_WRITE_ARRAY(long, destination, value)
+#define MODEL_CODEC_WRITE_array_int8_t(destination, value) MODEL_CODEC_WRITE_ARRAY(int8_t, destination, value)
+#define MODEL_CODEC_WRITE_array_uint8_t(destination, value) MODEL_CODEC_WRITE_ARRAY(uint8_t, destination, value)
+#define MODEL_CODEC_WRITE_array_int16_t(destination, value) MODEL_CODEC_WRITE_ARRAY(int16_t, destination, value)
+#define MODEL_CODEC_WRITE_array_int32_t(destination, value) MODEL_CODEC_WRITE_ARRAY(int32_t, destination, value)
+#define MODEL_CODEC_WRITE_array_int64_t(destination, value) MODEL_CODEC_WRITE_ARRAY(int64_t, destination, value)
+#define MODEL_CODEC_WRITE_array_bool(destination, value) MODEL_CODEC_WRITE_ARRAY(bool, destination, value)
+#define MODEL_CODEC_WRITE_array_float(destination, value) MODEL_CODEC_WRITE_ARRAY(float, destination, value)
+#define MODEL_CODEC_WRITE_array_double(destination, value) MODEL_CODEC_WRITE_ARRAY(double, destination, value)
+#define MODEL_CODEC_READ_array_int(reader, field) MODEL_CODEC_READ_ARRAY(int, reader, field)
+#define MODEL_CODEC_READ_array_long(reader, field) MODEL_CODEC_READ_ARRAY(long, reader, field)
+#define MODEL_CODEC_READ_array_int8_t(reader, field) MODEL_CODEC_READ_ARRAY(int8_t, reader, field)
+#define MODEL_CODEC_READ_array_uint8_t(reader, field) MODEL_CODEC_READ_ARRAY(uint8_t, reader, field)
+#define MODEL_CODEC_READ_array_int16_t(reader, field) MODEL_CODEC_READ_ARRAY(int16_t, reader, field)
+#define MODEL_CODEC_READ_array_int32_t(reader, field) MODEL_CODEC_READ_ARRAY(int32_t, reader, field)
+#define MODEL_CODEC_READ_array_int64_t(reader, field) MODEL_CODEC_READ_ARRAY(int64_t, reader, field)
+#define MODEL_CODEC_READ_array_bool(reader, field) MODEL_CODEC_READ_ARRAY(bool, reader, field)
+#define MODEL_CODEC_READ_array_float(reader, field) MODEL_CODEC_READ_ARRAY(float, reader, field)
+#define MODEL_CODEC_READ_array_double(reader, field) MODEL_CODEC_READ_ARRAY(double, reader, field)
+
+/*", " separates a value from the previous one, as in the JSON of SERIALIZE; the first key of the object is written without it*/
+#define MODEL_CODEC_KEY(name) ", \"" TOSTRING(name) "\":"
+
+#define MODEL_CODEC_FIELD_MAX_LENGTH(instance, type, name) \
+    + (sizeof(MODEL_CODEC_KEY(name)) - 1) + C2(MODEL_CODEC_MAX_LENGTH_, type)((instance)->name)
+
+#define MODEL_CODEC_ENCODE_FIELD(instance, type, name) \
+    if (length >= 0) \
+    { \
+        size_t skip = (pos == 1) ? 2 : 0; \
+        (void)memcpy(payload + pos, MODEL_CODEC_KEY(name) + skip, sizeof(MODEL_CODEC_KEY(name)) - 1 - skip); \
+        pos += sizeof(MODEL_CODEC_KEY(name)) - 1 - skip; \
+        if ((length = C2(MODEL_CODEC_WRITE_, type)(payload + pos, (instance)->name)) >= 0) \
+        { \
+            pos += (size_t)length; \
+        } \
+    }
+
+#define MODEL_CODEC_DECODE_FIELD(instance, type, name) \
+    if ((keyLength == sizeof(TOSTRING(name)) - 1) && (memcmp(key, TOSTRING(name), sizeof(TOSTRING(name)) - 1) == 0)) \
+    { \
+        result = C2(MODEL_CODEC_READ_, type)(&reader, &((instance)->name)); \
+    } \
+    else
+
+/**
+ * @def     DECLARE_MODEL_CODEC(modelName, ...)
+ * Generates ModelCodec_Encode_modelName and ModelCodec_Decode_modelName for the listed fields of the model.
+ *
+ * @param   modelName               A model declared by DECLARE_MODEL.
+ * @param   type1, field1...        The type and the name of each field, as they were given to WITH_DATA,
+ *                                  WITH_REPORTED_PROPERTY or WITH_DESIRED_PROPERTY. The fields are written in this order.
+ */
+/*Codes_SRS_MODELCODEC_41_001: [ DECLARE_MODEL_CODEC shall define ModelCodec_Encode_modelName and ModelCodec_Decode_modelName for the fields it lists. ]*/
+#define DECLARE_MODEL_CODEC(modelName, ...) \
+    static int C2(ModelCodec_Encode_, modelName)(const modelName* instance, unsigned char** destination, size_t* destinationSize) \
+    { \
+        int result; \
+        if ((instance == NULL) || (destination == NULL) || (destinationSize == NULL)) \
+        { \
+            /*Codes_SRS_MODELCODEC_41_002: [ If instance, destination or destinationSize is NULL, ModelCodec_Encode_modelName shall fail and return a non-zero value. ]*/ \
+            result = __LINE__; \
+        } \
+        else \
+        { \
+            /*Codes_SRS_MODELCODEC_41_003: [ ModelCodec_Encode_modelName shall allocate one buffer, as large as the keys and the longest text of each value. ]*/ \
+            size_t size = 2 FOR_EACH_2_KEEP_1(MODEL_CODEC_FIELD_MAX_LENGTH, instance, __VA_ARGS__); \
+            char* payload = (char*)malloc(size); \
+            if (payload == NULL) \
+            { \
+                result = __LINE__; \
+            } \
+            else \
+            { \
+                size_t pos = 1; \
+                int length = 0; \
+                payload[0] = '{'; \
+                /*Codes_SRS_MODELCODEC_41_004: [ ModelCodec_Encode_modelName shall write the fields in the order they are listed, as SERIALIZE of the same fields writes them. ]*/ \
+                FOR_EACH_2_KEEP_1(MODEL_CODEC_ENCODE_FIELD, instance, __VA_ARGS__) \
+                if (length < 0) \
+                { \
+                    /*Codes_SRS_MODELCODEC_41_005: [ If a value cannot be written, ModelCodec_Encode_modelName shall free the buffer and return a non-zero value. ]*/ \
+                    free(payload); \
+                    result = __LINE__; \
+                } \
+                else \
+                { \
+                    /*Codes_SRS_MODELCODEC_41_006: [ On success ModelCodec_Encode_modelName shall give the buffer and its length to the caller, who frees it, and return 0. ]*/ \
+                    payload[pos++] = '}'; \
+                    *destination = (unsigned char*)payload; \
+                    *destinationSize = pos; \
+                    result = 0; \
+                } \
+            } \
+        } \
+        return result; \
+    } \
+    static int C2(ModelCodec_Decode_, modelName)(modelName* instance, const char* json) \
+    { \
+        int result; \
+        MODEL_CODEC_READER reader; \
+        if ((instance == NULL) || (json == NULL)) \
+        { \
+            /*Codes_SRS_MODELCODEC_41_007: [ If instance or json is NULL, ModelCodec_Decode_modelName shall fail and return a non-zero value. ]*/ \
+            result = __LINE__; \
+        } \
+        else if ((result = ModelCodec_BeginObject(&reader, json)) == 0) \
+        { \
+            const char* key; \
+            size_t keyLength; \
+            bool isEnd = false; \
+            while ((result == 0) && ((result = ModelCodec_NextKey(&reader, &key, &keyLength, &isEnd)) == 0) && !isEnd) \
+            { \
+                /*Codes_SRS_MODELCODEC_41_008: [ ModelCodec_Decode_modelName shall read the value of a key named as a listed field into that field, and skip the value of any other key. ]*/ \
+                FOR_EACH_2_KEEP_1(MODEL_CODEC_DECODE_FIELD, instance, __VA_ARGS__) \
+                { \
+                    result = ModelCodec_SkipValue(&reader); \
+                } \
+            } \
+        } \
+        return result; \
+    }
+
+/*Codes_SRS_MODELCODEC_41_009: [ MODEL_CODEC_ENCODE and MODEL_CODEC_DECODE shall call the functions generated for modelName. ]*/
+#define MODEL_CODEC_ENCODE(modelName, instance, destination, destinationSize) C2(ModelCodec_Encode_, modelName)(instance, destination, destinationSize)
+#define MODEL_CODEC_DECODE(modelName, instance, json) C2(ModelCodec_Decode_, modelName)(instance, json)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODELCODEC_H */
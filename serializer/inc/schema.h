@@ -168,6 +168,13 @@ MOCKABLE_FUNCTION(, SCHEMA_PROPERTY_HANDLE, Schema_GetStructTypePropertyByIndex,
 MOCKABLE_FUNCTION(, const char*, Schema_GetPropertyName, SCHEMA_PROPERTY_HANDLE, propertyHandle);
 MOCKABLE_FUNCTION(, const char*, Schema_GetPropertyType, SCHEMA_PROPERTY_HANDLE, propertyHandle);
 
+/*builds name indexes over the (large enough) collections of the schema, to be called once the schema is complete*/
+MOCKABLE_FUNCTION(, SCHEMA_RESULT, Schema_BuildLookupIndexes, SCHEMA_HANDLE, schemaHandle);
+
+/*a per model slot where the serialized command metadata (JSON when compact is false) is kept once built*/
+MOCKABLE_FUNCTION(, SCHEMA_RESULT, Schema_SetModelCommandMetadataCache, SCHEMA_MODEL_TYPE_HANDLE, modelTypeHandle, bool, compact, const unsigned char*, bytes, size_t, size);
+MOCKABLE_FUNCTION(, SCHEMA_RESULT, Schema_GetModelCommandMetadataCache, SCHEMA_MODEL_TYPE_HANDLE, modelTypeHandle, bool, compact, const unsigned char**, bytes, size_t*, size);
+
 MOCKABLE_FUNCTION(, void, Schema_Destroy, SCHEMA_HANDLE, schemaHandle);
 MOCKABLE_FUNCTION(, SCHEMA_RESULT, Schema_DestroyIfUnused,SCHEMA_MODEL_TYPE_HANDLE, modelHandle);
 
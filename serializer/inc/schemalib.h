@@ -39,7 +39,12 @@ DEFINE_ENUM(SERIALIZER_RESULT, SERIALIZER_RESULT_VALUES);
 
 #define SERIALIZER_CONFIG_VALUES  \
     CommandPollingInterval,     \
-    SerializeDelayedBufferMaxSize
+    SerializeDelayedBufferMaxSize, \
+    SerializeDirectToBuffer, \
+    IngestDesiredPropertiesStreaming, \
+    SerializeTransactionArenaSize, \
+    SerializeAsCBOR, \
+    IngestDesiredPropertiesChangesOnly
 
 /** @brief Enumeration specifying the option to set on the serializer when  
  * calling ::serializer_setconfig.
@@ -70,6 +75,31 @@ extern void serializer_deinit(void);
 /**
  * @brief   Set serializer options.
  *
+ *          @c SerializeDirectToBuffer takes a pointer to a @c bool. When set to
+ *          @c true, ::SERIALIZE writes the JSON of top level numeric and boolean
+ *          properties straight to the output buffer, skipping the transaction
+ *          and the intermediate tree. The output is the same.
+ *
+ *          @c IngestDesiredPropertiesStreaming takes a pointer to a @c bool. When
+ *          set to @c true, desired properties are decoded from the JSON straight
+ *          into the model as they are parsed, without building an intermediate tree.
+ *
+ *          @c SerializeTransactionArenaSize takes a pointer to a @c size_t. When
+ *          not 0, the transactions of ::SERIALIZE and ::SERIALIZE_REPORTED_PROPERTIES
+ *          take their property paths and values from blocks of that many bytes,
+ *          all freed together at the end of the transaction. The default is 0.
+ *
+ *          @c SerializeAsCBOR takes a pointer to a @c bool. When @c true, ::SERIALIZE
+ *          produces CBOR (RFC 7049) instead of JSON; the application should then
+ *          set the @c CBOR_ENCODER_CONTENT_TYPE on the messages it sends. Reported
+ *          properties are always serialized as JSON. The default is @c false.
+ *
+ *          @c IngestDesiredPropertiesChangesOnly takes a pointer to a @c bool. When
+ *          @c true, a desired property whose value is the same as the last value
+ *          ingested for it is not written again and its callback is not called, so
+ *          the complete twin received after a reconnect only triggers the callbacks
+ *          of what changed. The default is @c false.
+ *
  * @param   which   The option to be set.
  * @param   value   The value to set for the given option.
  *
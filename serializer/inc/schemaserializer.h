@@ -20,6 +20,11 @@ DEFINE_ENUM(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_RESULT_VALUES)
 
 extern SCHEMA_SERIALIZER_RESULT SchemaSerializer_SerializeCommandMetadata(SCHEMA_MODEL_TYPE_HANDLE modelHandle, STRING_HANDLE schemaText);
 
+/*the same text as SchemaSerializer_SerializeCommandMetadata, built once per model and then kept by the schema; *schemaText is owned by the schema*/
+extern SCHEMA_SERIALIZER_RESULT SchemaSerializer_GetCommandMetadata(SCHEMA_MODEL_TYPE_HANDLE modelHandle, const char** schemaText);
+/*a CBOR encoding of the command metadata, built once per model and then kept by the schema; *bytes is owned by the schema*/
+extern SCHEMA_SERIALIZER_RESULT SchemaSerializer_GetCommandMetadataCompact(SCHEMA_MODEL_TYPE_HANDLE modelHandle, const unsigned char** bytes, size_t* size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -57,6 +57,8 @@
 #include "codefirst.h"
 #include "agenttypesystem.h"
 #include "schema.h"
+#include "aggregateddata.h"
+#include "modelcodec.h"
 
 
 
@@ -164,6 +166,8 @@ extern "C"
 #define CREATE_DESIRED_PROPERTY_CALLBACK_MODEL_DESIRED_PROPERTY(type, name, ...) IF(COUNT_ARG(__VA_ARGS__), void __VA_ARGS__ (void*);, )
 #define CREATE_DESIRED_PROPERTY_CALLBACK_MODEL_PROPERTY(...)
 #define CREATE_DESIRED_PROPERTY_CALLBACK_MODEL_REPORTED_PROPERTY(...) 
+#define CREATE_DESIRED_PROPERTY_CALLBACK_MODEL_AGGREGATED_PROPERTY(...)
+#define CREATE_DESIRED_PROPERTY_CALLBACK_MODEL_ARRAY_PROPERTY(...)
 
 #define CREATE_DESIRED_PROPERTY_CALLBACK(...) CREATE_DESIRED_PROPERTY_CALLBACK_##__VA_ARGS__
 
@@ -227,6 +231,48 @@ extern "C"
 
 #define WITH_DESIRED_PROPERTY(type, name, ...) MODEL_DESIRED_PROPERTY(type, name, __VA_ARGS__)
 
+/**
+ * @def   WITH_AGGREGATED_DATA(type, name, window)
+ * The ::WITH_AGGREGATED_DATA macro declares a model property that keeps the
+ * last @p window samples written to it with ::AGGREGATE_SAMPLE. The storage
+ * for the window is part of the model, so no allocation happens per sample.
+ * Publishing the property with ::SERIALIZE sends the summary of the window:
+ * count, min, max, mean, p50, p90 and p99.
+ *
+ * @param   type    Specifies the sample type. Can be any of the numeric types
+ *                  accepted by ::WITH_DATA. min, max and the percentiles are
+ *                  sent as this type, mean is always sent as a double.
+ * @param   name    Specifies the property name
+ * @param   window  Specifies how many of the most recent samples are kept
+ */
+/*Codes_SRS_SERIALIZER_H_41_002: [ WITH_AGGREGATED_DATA shall declare a model property that stores the window of window samples inside the model struct. ]*/
+#define WITH_AGGREGATED_DATA(type, name, window) MODEL_AGGREGATED_PROPERTY(type, name, window)
+
+/*Codes_SRS_SERIALIZER_H_41_003: [ AGGREGATE_SAMPLE shall add sample to the window of field, evicting the oldest sample when the window is full. ]*/
+#define AGGREGATE_SAMPLE(field, sample) \
+    AggregatedData_Add(&(field).state, (field).samples, sizeof((field).samples) / (2 * sizeof((field).samples[0])), (double)(sample))
+
+/*Codes_SRS_SERIALIZER_H_41_004: [ RESET_AGGREGATED_DATA shall empty the window of field. ]*/
+#define RESET_AGGREGATED_DATA(field) AggregatedData_Reset(&(field).state)
+
+/**
+ * @def   WITH_ARRAY(type, name, capacity)
+ * The ::WITH_ARRAY macro declares a model property that is a contiguous C
+ * array of up to @p capacity values. The field of the model struct has
+ * @c values, the array itself, and @c length, how many of its values are
+ * sent. Publishing the property with ::SERIALIZE sends a JSON array, or a
+ * CBOR array with the CBOR encoding, of the first @c length values.
+ * ::DECLARE_MODEL_CODEC lists the property as array_type to encode it and
+ * to decode a JSON array straight into @c values.
+ *
+ * @param   type        Specifies the type of the values: int, long, int8_t,
+ *                      uint8_t, int16_t, int32_t, int64_t, bool, float or double
+ * @param   name        Specifies the property name
+ * @param   capacity    Specifies how many values the array holds
+ */
+/*Codes_SRS_SERIALIZER_H_41_006: [ WITH_ARRAY shall declare a model property that stores capacity values of type and their length inside the model struct. ]*/
+#define WITH_ARRAY(type, name, capacity) MODEL_ARRAY_PROPERTY(type, name, capacity)
+
 /**
  * @def   WITH_ACTION(name, ...)
  * The ::WITH_ACTION macro allows declaring a model action.
@@ -307,9 +353,44 @@ extern "C"
 /*Codes_SRS_SERIALIZER_99_114:[ If CodeFirst_SendAsync fails, SEND shall return IOT_AGENT_SERIALIZE_FAILED.] */
 #define SERIALIZE(destination, destinationSize,...) CodeFirst_SendAsync(destination, destinationSize, COUNT_ARG(__VA_ARGS__) FOR_EACH_1(ADDRESS_MACRO, __VA_ARGS__))
 
+#define BATCH_FIELD_ADDRESS_MACRO(instances, field) ,&((instances)[0]->field)
+
+/**
+ * @def      SERIALIZE_BATCH(destination, destinationSize, instances, count, field1, field2...)
+ * Serializes the same fields of @p count model instances into one array
+ * (a JSON array, or a CBOR array when SerializeAsCBOR is set), element
+ * @c i being what SERIALIZE would produce for @c instances[i].
+ *
+ * @param    instances                   An array of at least one pointer returned by
+ *                                       CREATE_MODEL_INSTANCE, all of the same model.
+ * @param    count                       The number of instances.
+ * @param    field1, field2...           Names of the model properties to send, e.g.
+ *                                       Temperature, or ChildModel.InnerProperty for a
+ *                                       property of a model in model.
+ */
+/*Codes_SRS_SERIALIZER_H_41_001: [ SERIALIZE_BATCH shall call CodeFirst_SendAsyncBatch, passing destination, destinationSize, instances, count, the number of fields and the address of each field in instances[0]. ]*/
+#define SERIALIZE_BATCH(destination, destinationSize, instances, count, ...) CodeFirst_SendAsyncBatch(destination, destinationSize, (void* const*)(instances), count, COUNT_ARG(__VA_ARGS__) FOR_EACH_1_KEEP_1(BATCH_FIELD_ADDRESS_MACRO, instances, __VA_ARGS__))
+
 #define SERIALIZE_REPORTED_PROPERTIES(destination, destinationSize,...) CodeFirst_SendAsyncReported(destination, destinationSize, COUNT_ARG(__VA_ARGS__) FOR_EACH_1(ADDRESS_MACRO, __VA_ARGS__))
 
 
+/**
+ * @def   SERIALIZE_REPORTED_PROPERTIES_DELTA(destination, destinationSize, ...)
+ * Like SERIALIZE_REPORTED_PROPERTIES, but only the reported properties whose value differs
+ * from the last acknowledged one are serialized. When nothing changed, @c *destination is
+ * set to NULL, @c *destinationSize to 0 and the result is CODEFIRST_OK: there is nothing to send.
+ * Call ACKNOWLEDGE_REPORTED_PROPERTIES_DELTA once the service has accepted the payload.
+ */
+#define SERIALIZE_REPORTED_PROPERTIES_DELTA(destination, destinationSize,...) CodeFirst_SendAsyncReportedDelta(destination, destinationSize, COUNT_ARG(__VA_ARGS__) FOR_EACH_1(ADDRESS_MACRO, __VA_ARGS__))
+
+/**
+ * @def   ACKNOWLEDGE_REPORTED_PROPERTIES_DELTA(device)
+ * Marks the values serialized by SERIALIZE_REPORTED_PROPERTIES_DELTA since the previous
+ * acknowledgement as known by the service. Typically called from the reported state
+ * callback when the status code is 2xx.
+ */
+#define ACKNOWLEDGE_REPORTED_PROPERTIES_DELTA(device) CodeFirst_AcknowledgeReportedPropertiesDelta(device)
+
 #define IDENTITY_MACRO(x) ,x
 #define SERIALIZE_REPORTED_PROPERTIES_FROM_POINTERS(destination, destinationSize, ...) CodeFirst_SendAsyncReported(destination, destinationSize, COUNT_ARG(__VA_ARGS__) FOR_EACH_1(IDENTITY_MACRO, __VA_ARGS__))
 
@@ -344,6 +425,16 @@ extern "C"
 */
 #define INGEST_DESIRED_PROPERTIES(device, desiredProperties) (CodeFirst_IngestDesiredProperties(device, desiredProperties))
 
+/**
+* @def   GET_DESIRED_PROPERTIES_VERSION(device, version)
+* Retrieves the "$version" of the last desired properties (complete or patch) ingested
+* for the device that carried one.
+*
+* @param   device                return of CodeFirst_CreateDevice.
+* @param   version               pointer to an int64_t that receives the version.
+*/
+#define GET_DESIRED_PROPERTIES_VERSION(device, version) (CodeFirst_GetDesiredPropertiesVersion(device, version))
+
 /* Helper macros */
 
 /* These macros remove a useless comma from the beginning of an argument list that looks like:
@@ -388,6 +479,12 @@ Actions are discarded, since no marshalling will be done for those when sending
 
 #define TO_AGENT_DT_EXPAND_MODEL_DESIRED_PROPERTY(x, y, ...) ,x,y
 
+/*aggregated properties are only sent by their own SERIALIZE, not as part of a model nested in another one*/
+#define TO_AGENT_DT_EXPAND_MODEL_AGGREGATED_PROPERTY(...) 
+
+/*array properties are only sent by their own SERIALIZE, not as part of a model nested in another one*/
+#define TO_AGENT_DT_EXPAND_MODEL_ARRAY_PROPERTY(...) 
+
 #define TO_AGENT_DT_EXPAND_MODEL_ACTION(...) 
 
 #define TO_AGENT_DT_EXPAND_MODEL_METHOD(...) 
@@ -447,6 +544,10 @@ Actions are discarded, since no marshalling will be done for those when sending
     static const REFLECTED_SOMETHING C2(REFLECTED_, C1(INC(__COUNTER__))) = { REFLECTION_MODEL_TYPE,                &C2(REFLECTED_, C1(DEC(DEC(__COUNTER__)))), { {0}, {0}, {0}, {0}, {0}, {0}, {0}, {TOSTRING(name)} } };
 #define REFLECTED_PROPERTY(type, name, modelName) \
     static const REFLECTED_SOMETHING C2(REFLECTED_, C1(INC(__COUNTER__))) = { REFLECTION_PROPERTY_TYPE,             &C2(REFLECTED_, C1(DEC(DEC(__COUNTER__)))), { {0}, {0}, {0}, {0}, {0}, {TOSTRING(name), TOSTRING(type), Create_AGENT_DATA_TYPE_From_Ptr_##modelName##name, offsetof(modelName, name), sizeof(type), TOSTRING(modelName)}, {0}, {0} } };
+#define REFLECTED_AGGREGATED_PROPERTY(type, name, modelName) \
+    static const REFLECTED_SOMETHING C2(REFLECTED_, C1(INC(__COUNTER__))) = { REFLECTION_PROPERTY_TYPE,             &C2(REFLECTED_, C1(DEC(DEC(__COUNTER__)))), { {0}, {0}, {0}, {0}, {0}, {TOSTRING(name), AGGREGATED_DATA_TYPE_NAME, Create_AGENT_DATA_TYPE_From_Ptr_##modelName##name, offsetof(modelName, name), sizeof(((modelName*)0)->name), TOSTRING(modelName)}, {0}, {0} } };
+#define REFLECTED_ARRAY_PROPERTY(type, name, modelName) \
+    static const REFLECTED_SOMETHING C2(REFLECTED_, C1(INC(__COUNTER__))) = { REFLECTION_PROPERTY_TYPE,             &C2(REFLECTED_, C1(DEC(DEC(__COUNTER__)))), { {0}, {0}, {0}, {0}, {0}, {TOSTRING(name), ARRAY_TYPE_NAME, Create_AGENT_DATA_TYPE_From_Ptr_##modelName##name, offsetof(modelName, name), sizeof(((modelName*)0)->name), TOSTRING(modelName)}, {0}, {0} } };
 #define REFLECTED_REPORTED_PROPERTY(type, name, modelName) \
     static const REFLECTED_SOMETHING C2(REFLECTED_, C1(INC(__COUNTER__))) = { REFLECTION_REPORTED_PROPERTY_TYPE,    &C2(REFLECTED_, C1(DEC(DEC(__COUNTER__)))), { {0}, {0}, {TOSTRING(name), TOSTRING(type), Create_AGENT_DATA_TYPE_From_Ptr_##modelName##name, offsetof(modelName, name), sizeof(type), TOSTRING(modelName)}, {0}, {0}, {0}, {0}, {0} } };
 
@@ -476,6 +577,10 @@ Actions are discarded, since no marshalling will be done for those when sending
 
 #define EXPAND_MODEL_DESIRED_PROPERTY(type, name, ...) EXPAND_ARGS(MODEL_DESIRED_PROPERTY, type, name, __VA_ARGS__)
 
+#define EXPAND_MODEL_AGGREGATED_PROPERTY(type, name, window) EXPAND_ARGS(MODEL_AGGREGATED_PROPERTY, type, name, window)
+
+#define EXPAND_MODEL_ARRAY_PROPERTY(type, name, capacity) EXPAND_ARGS(MODEL_ARRAY_PROPERTY, type, name, capacity)
+
 #define EXPAND_MODEL_ACTION(...) EXPAND_ARGS(MODEL_ACTION, __VA_ARGS__)
 
 #define EXPAND_MODEL_METHOD(...) EXPAND_ARGS(MODEL_METHOD, __VA_ARGS__)
@@ -516,6 +621,16 @@ Actions are discarded, since no marshalling will be done for those when sending
 #define CREATE_GLOBAL_INITIALIZE_MODEL_DESIRED_PROPERTY(modelName, type, name, ...) /*do nothing*/
 #define CREATE_GLOBAL_DEINITIALIZE_MODEL_DESIRED_PROPERTY(modelName, type, name, ...) /*do nothing*/
 
+/*AGGREGATED_PROPERTY keeps the ring of samples followed by the same samples sorted, see aggregateddata.h*/
+#define INSERT_FIELD_FOR_MODEL_AGGREGATED_PROPERTY(type, name, window) struct { AGGREGATED_DATA_STATE state; double samples[2 * (window)]; } name;
+#define CREATE_GLOBAL_INITIALIZE_MODEL_AGGREGATED_PROPERTY(modelName, type, name, window) AggregatedData_Reset(&((modelName*)destination)->name.state);
+#define CREATE_GLOBAL_DEINITIALIZE_MODEL_AGGREGATED_PROPERTY(modelName, type, name, window) /*do nothing, the window has no resources*/
+
+/*ARRAY_PROPERTY sends the first length values*/
+#define INSERT_FIELD_FOR_MODEL_ARRAY_PROPERTY(type, name, capacity) struct { size_t length; type values[capacity]; } name;
+#define CREATE_GLOBAL_INITIALIZE_MODEL_ARRAY_PROPERTY(modelName, type, name, capacity) ((modelName*)destination)->name.length = 0;
+#define CREATE_GLOBAL_DEINITIALIZE_MODEL_ARRAY_PROPERTY(modelName, type, name, capacity) /*do nothing, the array has no resources*/
+
 #define INSERT_FIELD_FOR_MODEL_ACTION(name, ...) /* action isn't a part of the model struct */
 #define INSERT_FIELD_FOR_MODEL_METHOD(name, ...) /* method isn't a part of the model struct */
 
@@ -534,6 +649,12 @@ Actions are discarded, since no marshalling will be done for those when sending
 #define CREATE_MODEL_DESIRED_PROPERTY(modelName, type, name, ...) \
     IMPL_DESIRED_PROPERTY(type, name, modelName, __VA_ARGS__)
 
+#define CREATE_MODEL_AGGREGATED_PROPERTY(modelName, type, name, window) \
+    IMPL_AGGREGATED_PROPERTY(type, name, window, modelName)
+
+#define CREATE_MODEL_ARRAY_PROPERTY(modelName, type, name, capacity) \
+    IMPL_ARRAY_PROPERTY(type, name, capacity, modelName)
+
 #define IMPL_PROPERTY(propertyType, propertyName, modelName) \
     static int Create_AGENT_DATA_TYPE_From_Ptr_##modelName##propertyName(void* param, AGENT_DATA_TYPE* dest) \
     { \
@@ -541,6 +662,29 @@ Actions are discarded, since no marshalling will be done for those when sending
     } \
     REFLECTED_PROPERTY(propertyType, propertyName, modelName)
 
+/*Codes_SRS_SERIALIZER_H_41_005: [ Serializing a WITH_AGGREGATED_DATA property shall produce the summary of its window, with min, max and the percentiles converted to type. ]*/
+#define IMPL_AGGREGATED_PROPERTY(propertyType, propertyName, window, modelName) \
+    static AGENT_DATA_TYPES_RESULT AggregatedSample_ToAGENT_DATA_TYPE_##modelName##propertyName(AGENT_DATA_TYPE* dest, double value) \
+    { \
+        return C1(ToAGENT_DATA_TYPE_##propertyType)(dest, (propertyType)value); \
+    } \
+    static int Create_AGENT_DATA_TYPE_From_Ptr_##modelName##propertyName(void* param, AGENT_DATA_TYPE* dest) \
+    { \
+        modelName* model = (modelName*)((char*)param - offsetof(modelName, propertyName)); \
+        return AggregatedData_ToAGENT_DATA_TYPE(dest, &model->propertyName.state, model->propertyName.samples, (window), AggregatedSample_ToAGENT_DATA_TYPE_##modelName##propertyName); \
+    } \
+    REFLECTED_AGGREGATED_PROPERTY(propertyType, propertyName, modelName)
+
+/*Codes_SRS_SERIALIZER_H_41_007: [ Serializing a WITH_ARRAY property shall produce an EDM_ARRAY_TYPE of its first length values, and fail if length is more than capacity. ]*/
+#define IMPL_ARRAY_PROPERTY(propertyType, propertyName, capacity, modelName) \
+    static int Create_AGENT_DATA_TYPE_From_Ptr_##modelName##propertyName(void* param, AGENT_DATA_TYPE* dest) \
+    { \
+        modelName* model = (modelName*)((char*)param - offsetof(modelName, propertyName)); \
+        return (model->propertyName.length > (capacity)) ? AGENT_DATA_TYPES_INVALID_ARG : \
+            Create_AGENT_DATA_TYPE_from_Array(dest, C2(MODEL_CODEC_ELEMENT_TYPE_, propertyType), sizeof(propertyType), model->propertyName.values, model->propertyName.length); \
+    } \
+    REFLECTED_ARRAY_PROPERTY(propertyType, propertyName, modelName)
+
 #define IMPL_REPORTED_PROPERTY(propertyType, propertyName, modelName) \
     static int Create_AGENT_DATA_TYPE_From_Ptr_##modelName##propertyName(void* param, AGENT_DATA_TYPE* dest) \
     { \
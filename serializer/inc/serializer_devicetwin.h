@@ -9,6 +9,11 @@
 
 #include "iothub_client.h"
 #include "iothub_client_ll.h"
+
+#if defined(DONT_USE_DEVICE_TWIN) || defined(DONT_USE_DEVICE_METHODS)
+#error "trying to #include serializer_devicetwin.h in the presence of #define DONT_USE_DEVICE_TWIN or DONT_USE_DEVICE_METHODS"
+#endif
+
 #include "parson.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/vector.h"
@@ -30,99 +35,89 @@ static void serializer_ingest(DEVICE_TWIN_UPDATE_STATE update_state, const unsig
         (void)memcpy(copyOfPayload, payLoad, size);
         copyOfPayload[size] = '\0';
 
-        /*Codes_SRS_SERIALIZERDEVICETWIN_02_002: [ serializer_ingest shall parse the null terminated string into parson data types. ]*/
-        JSON_Value* allJSON = json_parse_string(copyOfPayload);
-        if (allJSON == NULL)
+        if (update_state == DEVICE_TWIN_UPDATE_PARTIAL)
         {
-            /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
-            LogError("failure in json_parse_string");
+            /*Codes_SRS_SERIALIZERDEVICETWIN_41_001: [ If update_state is DEVICE_TWIN_UPDATE_PARTIAL then serializer_ingest shall call CodeFirst_IngestDesiredProperties with the null terminated string as is, without parsing it. ]*/
+            /*the patch is applied field by field by the command decoder, which also consumes "$version"*/
+            if (CodeFirst_IngestDesiredProperties(userContextCallback, copyOfPayload) != CODEFIRST_OK)
+            {
+                /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
+                LogError("failure ingesting desired properties\n");
+            }
+            else
+            {
+                /*all is fine*/
+            }
         }
         else
         {
-            JSON_Object *allObject = json_value_get_object(allJSON);
-            if (allObject == NULL)
+            /*Codes_SRS_SERIALIZERDEVICETWIN_02_002: [ If update_state is not DEVICE_TWIN_UPDATE_PARTIAL then serializer_ingest shall parse the null terminated string into parson data types. ]*/
+            JSON_Value* allJSON = json_parse_string(copyOfPayload);
+            if (allJSON == NULL)
             {
                 /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
-                LogError("failure in json_value_get_object");
+                LogError("failure in json_parse_string");
             }
             else
             {
-                switch (update_state)
+                JSON_Object *allObject = json_value_get_object(allJSON);
+                if (allObject == NULL)
                 {
-                    /*Codes_SRS_SERIALIZERDEVICETWIN_02_003: [ If update_state is DEVICE_TWIN_UPDATE_COMPLETE then serializer_ingest shall locate "desired" json name. ]*/
-                    case DEVICE_TWIN_UPDATE_COMPLETE:
+                    /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
+                    LogError("failure in json_value_get_object");
+                }
+                else
+                {
+                    switch (update_state)
                     {
-                        JSON_Object* desired = json_object_get_object(allObject, "desired");
-                        if (desired == NULL)
-                        {
-                            /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
-                            LogError("failure in json_object_get_object");
-                        }
-                        else
+                        /*Codes_SRS_SERIALIZERDEVICETWIN_02_003: [ If update_state is DEVICE_TWIN_UPDATE_COMPLETE then serializer_ingest shall locate "desired" json name. ]*/
+                        case DEVICE_TWIN_UPDATE_COMPLETE:
                         {
-                            /*Codes_SRS_SERIALIZERDEVICETWIN_02_004: [ If "desired" contains "$version" then serializer_ingest shall remove it. ]*/
-                            (void)json_object_remove(desired, "$version"); //it might not exist
-                            JSON_Value* desiredAfterRemove = json_object_get_value(allObject, "desired");
-                            if (desiredAfterRemove != NULL)
+                            JSON_Object* desired = json_object_get_object(allObject, "desired");
+                            if (desired == NULL)
                             {
-                                /*Codes_SRS_SERIALIZERDEVICETWIN_02_005: [ The "desired" value shall be outputed to a null terminated string and serializer_ingest shall call CodeFirst_IngestDesiredProperties. ]*/
-                                char* pretty = json_serialize_to_string(desiredAfterRemove);
-                                if (pretty == NULL)
-                                {
-                                    /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
-                                    LogError("failure in json_serialize_to_string\n");
-                                }
-                                else
+                                /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
+                                LogError("failure in json_object_get_object");
+                            }
+                            else
+                            {
+                                /*Codes_SRS_SERIALIZERDEVICETWIN_02_004: [ If "desired" contains "$version" then serializer_ingest shall remove it. ]*/
+                                (void)json_object_remove(desired, "$version"); //it might not exist
+                                JSON_Value* desiredAfterRemove = json_object_get_value(allObject, "desired");
+                                if (desiredAfterRemove != NULL)
                                 {
-                                    if (CodeFirst_IngestDesiredProperties(userContextCallback, pretty) != CODEFIRST_OK)
+                                    /*Codes_SRS_SERIALIZERDEVICETWIN_02_005: [ The "desired" value shall be outputed to a null terminated string and serializer_ingest shall call CodeFirst_IngestDesiredProperties. ]*/
+                                    char* pretty = json_serialize_to_string(desiredAfterRemove);
+                                    if (pretty == NULL)
                                     {
                                         /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
-                                        LogError("failure ingesting desired properties\n");
+                                        LogError("failure in json_serialize_to_string\n");
                                     }
                                     else
                                     {
-                                        /*all is fine*/
+                                        if (CodeFirst_IngestDesiredProperties(userContextCallback, pretty) != CODEFIRST_OK)
+                                        {
+                                            /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
+                                            LogError("failure ingesting desired properties\n");
+                                        }
+                                        else
+                                        {
+                                            /*all is fine*/
+                                        }
+                                        free(pretty);
                                     }
-                                    free(pretty);
                                 }
                             }
+                            break;
                         }
-                        break;
-                    }
-                    case DEVICE_TWIN_UPDATE_PARTIAL:
-                    {
-                        /*Codes_SRS_SERIALIZERDEVICETWIN_02_006: [ If update_state is DEVICE_TWIN_UPDATE_PARTIAL then serializer_ingest shall remove "$version" (if it exists). ]*/
-                        (void)json_object_remove(allObject, "$version");
-
-                        /*Codes_SRS_SERIALIZERDEVICETWIN_02_007: [ The JSON shall be outputed to a null terminated string and serializer_ingest shall call CodeFirst_IngestDesiredProperties. ]*/
-                        char* pretty = json_serialize_to_string(allJSON);
-                        if (pretty == NULL)
+                        default:
                         {
-                            /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
-                            LogError("failure in json_serialize_to_string\n");
+                            LogError("INTERNAL ERROR: unexpected value for update_state=%d\n", (int)update_state);
                         }
-                        else
-                        {
-                            if (CodeFirst_IngestDesiredProperties(userContextCallback, pretty) != CODEFIRST_OK)
-                            {
-                                /*Codes_SRS_SERIALIZERDEVICETWIN_02_008: [ If any of the above operations fail, then serializer_ingest shall return. ]*/
-                                LogError("failure ingesting desired properties\n");
-                            }
-                            else
-                            {
-                                /*all is fine*/
-                            }
-                            free(pretty);
-                        }
-                        break;
-                    }
-                    default:
-                    {
-                        LogError("INTERNAL ERROR: unexpected value for update_state=%d\n", (int)update_state);
                     }
                 }
+                json_value_free(allJSON);
             }
-            json_value_free(allJSON);
         }
         free(copyOfPayload);
     }
@@ -171,9 +166,14 @@ static int deviceMethodCallback(const char* method_name, const unsigned char* pa
                 *resp_size = 0;
                 *response = NULL;
             }
+            else if ((*response = MethodReturn_DetachBuffer(mr, resp_size)) != NULL)
+            {
+                /*Codes_SRS_SERIALIZERDEVICETWIN_41_002: [ If the METHODRETURN_HANDLE owns its JSON value then deviceMethodCallback shall hand that buffer over as *response by calling MethodReturn_DetachBuffer instead of copying it. ]*/
+                /*the client frees *response once the transport has taken the response*/
+            }
             else
             {
-                *resp_size = strlen(data->jsonValue);
+                *resp_size = data->jsonValueSize;
                 *response = (unsigned char*)malloc(*resp_size);
                 if (*response == NULL)
                 {
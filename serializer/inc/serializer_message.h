@@ -0,0 +1,47 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef SERIALIZER_MESSAGE_H
+#define SERIALIZER_MESSAGE_H
+
+#include "serializer.h"
+
+#include "iothub_message.h"
+#include "azure_c_shared_utility/optimize_size.h"
+
+/*hands the output of CodeFirst_SendAsyncHandOff over to a new message, handOffContext is an IOTHUB_MESSAGE_HANDLE* receiving it*/
+static int SerializerMessage_HandOff(void* handOffContext, unsigned char* destination, size_t destinationSize)
+{
+    int result;
+    IOTHUB_MESSAGE_HANDLE* message = (IOTHUB_MESSAGE_HANDLE*)handOffContext;
+
+    /*Codes_SRS_SERIALIZER_H_41_009: [ SERIALIZE_TO_MESSAGE shall create the message with IoTHubMessage_CreateFromOwnedBuffer, so that the message takes the serialized bytes over without copying them. ]*/
+    if ((*message = IoTHubMessage_CreateFromOwnedBuffer(destination, destinationSize)) == NULL)
+    {
+        LogError("unable to IoTHubMessage_CreateFromOwnedBuffer");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+/**
+ * @def      SERIALIZE_TO_MESSAGE(message, ...)
+ * Like SERIALIZE, but the serialized data becomes the content of a new
+ * message instead of being given to the caller. The message owns the data
+ * and frees it once it and all its clones are destroyed, so nothing is
+ * copied between the serializer and the transport.
+ *
+ * @param   message                      Pointer to an @c IOTHUB_MESSAGE_HANDLE
+ *                                       that receives the new message. The
+ *                                       caller destroys it with
+ *                                       IoTHubMessage_Destroy.
+ * @param    property1, property2...     A list of property values to send.
+ */
+/*Codes_SRS_SERIALIZER_H_41_008: [ SERIALIZE_TO_MESSAGE shall call CodeFirst_SendAsyncHandOff, passing a hand-off creating the message, message, the number of properties to publish, and pointers to the values for each property. ]*/
+#define SERIALIZE_TO_MESSAGE(message, ...) CodeFirst_SendAsyncHandOff(SerializerMessage_HandOff, (message), COUNT_ARG(__VA_ARGS__) FOR_EACH_1(ADDRESS_MACRO, __VA_ARGS__))
+
+#endif /*SERIALIZER_MESSAGE_H*/
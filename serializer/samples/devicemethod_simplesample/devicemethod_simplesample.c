@@ -134,7 +134,7 @@ static int DeviceMethodCallback(const char* method_name, const unsigned char* pa
                 }
                 else
                 {
-                    *resp_size = strlen(data->jsonValue);
+                    *resp_size = data->jsonValueSize;
                     *response = (unsigned char*)malloc(*resp_size);
                     (void)memcpy(*response, data->jsonValue, *resp_size);
                 }
@@ -154,13 +154,15 @@ void sendCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCal
     (void)printf("Result Call Back Called! Result is: %s \r\n", ENUM_TO_STRING(IOTHUB_CLIENT_CONFIRMATION_RESULT, result));
 }
 
-static void sendMessage(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const unsigned char* buffer, size_t size)
+static void sendMessage(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, unsigned char* buffer, size_t size)
 {
     static unsigned int messageTrackingId;
-    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromByteArray(buffer, size);
+    /* the message takes the buffer over and frees it once it has been sent */
+    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromOwnedBuffer(buffer, size);
     if (messageHandle == NULL)
     {
         printf("unable to create a new IoTHubMessage\r\n");
+        free(buffer);
     }
     else
     {
@@ -274,7 +276,6 @@ void devicemethod_simplesample_run(void)
                             else
                             {
                                 sendMessage(iotHubClientHandle, destination, destinationSize);
-                                free(destination);
                             }
                         }
 
@@ -1,6 +1,8 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <stdlib.h>
+
 #ifndef WINCE
 #include "iothubtransportamqp.h"
 #else
@@ -72,12 +74,14 @@ EXECUTE_COMMAND_RESULT SetHumidity(Thermostat* thermostat, int humidity)
     return EXECUTE_COMMAND_SUCCESS;
 }
 
-static void sendMessage(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const unsigned char* buffer, size_t size)
+static void sendMessage(IOTHUB_CLIENT_HANDLE iotHubClientHandle, unsigned char* buffer, size_t size)
 {
-    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromByteArray(buffer, size);
+    /* the message takes the buffer over and frees it once it has been sent */
+    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromOwnedBuffer(buffer, size);
     if (messageHandle == NULL)
     {
         printf("unable to create a new IoTHubMessage\r\n");
+        free(buffer);
     }
     else
     {
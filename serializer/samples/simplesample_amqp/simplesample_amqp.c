@@ -74,13 +74,15 @@ void sendCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCal
 }
 
 
-static void sendMessage(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const unsigned char* buffer, size_t size, ContosoAnemometer *myWeather)
+static void sendMessage(IOTHUB_CLIENT_HANDLE iotHubClientHandle, unsigned char* buffer, size_t size, ContosoAnemometer *myWeather)
 {
     static unsigned int messageTrackingId;
-    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromByteArray(buffer, size);
+    /* the message takes the buffer over and frees it once it has been sent */
+    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromOwnedBuffer(buffer, size);
     if (messageHandle == NULL)
     {
         printf("unable to create a new IoTHubMessage\r\n");
+        free(buffer);
     }
     else
     {
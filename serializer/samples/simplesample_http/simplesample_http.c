@@ -76,13 +76,15 @@ void sendCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCal
     (void)printf("Result Call Back Called! Result is: %s \r\n", ENUM_TO_STRING(IOTHUB_CLIENT_CONFIRMATION_RESULT, result));
 }
 
-static void sendMessage(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const unsigned char* buffer, size_t size)
+static void sendMessage(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, unsigned char* buffer, size_t size)
 {
     static unsigned int messageTrackingId;
-    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromByteArray(buffer, size);
+    /* the message takes the buffer over and frees it once it has been sent */
+    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromOwnedBuffer(buffer, size);
     if (messageHandle == NULL)
     {
         printf("unable to create a new IoTHubMessage\r\n");
+        free(buffer);
     }
     else
     {
@@ -211,10 +213,12 @@ void simplesample_http_run(void)
                             }
                             else
                             {
-                                IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromByteArray(destination, destinationSize);
+                                /* the message takes destination over and frees it once it has been sent */
+                                IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromOwnedBuffer(destination, destinationSize);
                                 if (messageHandle == NULL)
                                 {
                                     printf("unable to create a new IoTHubMessage\r\n");
+                                    free(destination);
                                 }
                                 else
                                 {
@@ -236,7 +240,6 @@ void simplesample_http_run(void)
 
                                     IoTHubMessage_Destroy(messageHandle);
                                 }
-                                free(destination);
                             }
                         }
 
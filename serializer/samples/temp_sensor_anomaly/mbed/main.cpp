@@ -222,12 +222,14 @@ static IOTHUBMESSAGE_DISPOSITION_RESULT IoTHubMessage(IOTHUB_MESSAGE_HANDLE mess
     return IOTHUBMESSAGE_ACCEPTED;
 }
 
-static void sendMessage(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const unsigned char* buffer, size_t size)
+static void sendMessage(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, unsigned char* buffer, size_t size)
 {
-    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromByteArray(buffer, size);
+    /* the message takes the buffer over and frees it once it has been sent */
+    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromOwnedBuffer(buffer, size);
     if (messageHandle == NULL)
     {
         (void)printf("unable to create a new IoTHubMessage\r\n");
+        free(buffer);
     }
     else
     {
@@ -372,7 +374,6 @@ int main(void)
                                         else
                                         {
                                             sendMessage(iotHubClientHandle, destination, destinationSize);
-                                            free(destination);
                                         }
                                     }
                                 }
@@ -401,7 +402,6 @@ int main(void)
                                 else
                                 {
                                     sendMessage(iotHubClientHandle, destination, destinationSize);
-                                    free(destination);
                                 }
 
                                 /* schedule IoTHubClient to send events/receive commands */
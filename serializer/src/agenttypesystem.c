@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
 
 #include "agenttypesystem.h"
 #include <inttypes.h>
@@ -27,9 +28,15 @@
 
 #include "jsonencoder.h"
 #include "multitree.h"
+#include "modelcodec.h"
 
 #include "azure_c_shared_utility/xlogging.h"
 
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
 #define NaN_STRING "NaN"
 #define MINUSINF_STRING "-INF"
 #define PLUSINF_STRING "INF"
@@ -81,38 +88,288 @@ static void NoFreeFunction(void* value)
     (void)value;
 }
 
+static const char DigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/*writes the decimal digits of value (2 at a time) followed by '\0' and returns how many digits were written. destination needs 21 characters*/
+static size_t FormatUInt64(uint64_t value, char* destination)
+{
+    char digits[20];
+    size_t pos = sizeof(digits);
+    size_t length;
+    uint32_t smallValue;
 
-#define IS_DIGIT(a) (('0'<=(a)) &&((a)<='9'))
-#define splitInt(intVal, bytePos)   (char)((intVal >> (bytePos << 3)) & 0xFF)
-#define joinChars(a, b, c, d) (uint32_t)( (uint32_t)a + ((uint32_t)b << 8) + ((uint32_t)c << 16) + ((uint32_t)d << 24))
+    while (value > 0xFFFFFFFFULL)
+    {
+        size_t pair = (size_t)(value % 100) * 2;
+        value /= 100;
+        digits[--pos] = DigitPairs[pair + 1];
+        digits[--pos] = DigitPairs[pair];
+    }
 
-static char base64char(unsigned char val)
+    /*the rest is done in 32 bits, 64 bit divisions are expensive on 32 bit platforms*/
+    smallValue = (uint32_t)value;
+    while (smallValue >= 100)
+    {
+        size_t pair = (size_t)(smallValue % 100) * 2;
+        smallValue /= 100;
+        digits[--pos] = DigitPairs[pair + 1];
+        digits[--pos] = DigitPairs[pair];
+    }
+
+    if (smallValue >= 10)
+    {
+        size_t pair = (size_t)smallValue * 2;
+        digits[--pos] = DigitPairs[pair + 1];
+        digits[--pos] = DigitPairs[pair];
+    }
+    else
+    {
+        digits[--pos] = '0' + (char)smallValue;
+    }
+
+    length = sizeof(digits) - pos;
+    (void)memcpy(destination, digits + pos, length);
+    destination[length] = '\0';
+    return length;
+}
+
+/*same as FormatUInt64, with a '-' in front of negative values. destination needs 21 characters*/
+static size_t FormatInt64(int64_t value, char* destination)
 {
-    char result;
+    size_t result;
+    if (value < 0)
+    {
+        destination[0] = '-';
+        /*the negation is done on the unsigned value so that INT64_MIN does not overflow*/
+        result = 1 + FormatUInt64((uint64_t)0 - (uint64_t)value, destination + 1);
+    }
+    else
+    {
+        result = FormatUInt64((uint64_t)value, destination);
+    }
+    return result;
+}
 
-    if (val < 26)
+/*longest output of FormatPaddedUInt64 and FormatPaddedInt64 for minDigits up to 20: a sign and 20 digits*/
+#define PADDED_INTEGER_MAX_LENGTH 21
+
+/*same characters as sprintf("%.*llu", minDigits, value) without the '\0'. minDigits cannot be more than 20*/
+static size_t FormatPaddedUInt64(uint64_t value, size_t minDigits, char* destination)
+{
+    char digits[21];
+    size_t length = FormatUInt64(value, digits);
+    size_t pos = 0;
+
+    while (pos + length < minDigits)
     {
-        result = 'A' + (char)val;
+        destination[pos++] = '0';
     }
-    else if (val < 52)
+    (void)memcpy(destination + pos, digits, length);
+    return pos + length;
+}
+
+/*same characters as sprintf("%.*d", minDigits, value), or "%+.*d" when forceSign is set, without the '\0'*/
+static size_t FormatPaddedInt64(int64_t value, size_t minDigits, bool forceSign, char* destination)
+{
+    size_t result;
+    if (value < 0)
+    {
+        destination[0] = '-';
+        result = 1 + FormatPaddedUInt64((uint64_t)0 - (uint64_t)value, minDigits, destination + 1);
+    }
+    else if (forceSign)
     {
-        result = 'a' + ((char)val - 26);
+        destination[0] = '+';
+        result = 1 + FormatPaddedUInt64((uint64_t)value, minDigits, destination + 1);
     }
-    else if (val < 62)
+    else
     {
-        result = '0' + ((char)val - 52);
+        result = FormatPaddedUInt64((uint64_t)value, minDigits, destination);
     }
-    else if (val == 62)
+    return result;
+}
+
+#ifndef NO_FLOATS
+/*integer part of the values that FormatFixedPoint can produce (2^53, above it a double has no fractional part and might not fit the uint64_t)*/
+#define FIXED_POINT_MAX_VALUE 9007199254740992.0
+
+/*the largest number of decimals for which 5^decimals * 2^53 fits in 128 bits and 10^decimals fits in an uint64_t*/
+#define FIXED_POINT_MAX_DECIMALS 19
+
+/*high:low = a * b */
+static void Multiply64To128(uint64_t a, uint64_t b, uint64_t* high, uint64_t* low)
+{
+    uint64_t aLow = a & 0xFFFFFFFFULL;
+    uint64_t aHigh = a >> 32;
+    uint64_t bLow = b & 0xFFFFFFFFULL;
+    uint64_t bHigh = b >> 32;
+    uint64_t lowLow = aLow * bLow;
+    uint64_t lowHigh = aLow * bHigh;
+    uint64_t highLow = aHigh * bLow;
+    uint64_t middle = (lowLow >> 32) + (lowHigh & 0xFFFFFFFFULL) + (highLow & 0xFFFFFFFFULL);
+
+    *low = (middle << 32) | (lowLow & 0xFFFFFFFFULL);
+    *high = aHigh * bHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+}
+
+/*produces the same characters as sprintf("%.*f", decimals, value), computed exactly with integer arithmetic.
+Returns the number of characters written (destination needs 1 + 16 + 1 + decimals + 1 characters) or 0 when the value is not handled
+(NaN, infinite, not smaller than FIXED_POINT_MAX_VALUE, negative zero), in which case the caller shall use sprintf*/
+static size_t FormatFixedPoint(double value, int decimals, char* destination)
+{
+    static const double positiveZero = 0.0;
+    size_t result;
+
+    if ((decimals < 0) ||
+        (decimals > FIXED_POINT_MAX_DECIMALS) ||
+        !(value > -FIXED_POINT_MAX_VALUE && value < FIXED_POINT_MAX_VALUE) || /*also false for NaN*/
+        ((value == 0.0) && (memcmp(&value, &positiveZero, sizeof(double)) != 0)))
     {
-        result = '-';
+        result = 0;
     }
     else
     {
-        result = '_';
+        double absValue = (value < 0) ? -value : value;
+        double integerPart = floor(absValue);
+        double fractionalPart = absValue - integerPart; /*exact, because absValue < 2^53*/
+        uint64_t integerDigits = (uint64_t)integerPart;
+        uint64_t fractionalDigits;
+        uint64_t scale = 1;
+        uint64_t fivePower = 1;
+        int i;
+
+        for (i = 0; i < decimals; i++)
+        {
+            scale *= 10;
+            fivePower *= 5;
+        }
+
+        if (fractionalPart == 0.0)
+        {
+            fractionalDigits = 0;
+        }
+        else
+        {
+            /*fractionalPart = mantissa * 2^-shift, so fractionalPart * 10^decimals = mantissa * 5^decimals * 2^(decimals - shift)*/
+            int exponent;
+            uint64_t mantissa = (uint64_t)ldexp(frexp(fractionalPart, &exponent), DBL_MANT_DIG);
+            int shift = DBL_MANT_DIG - exponent - decimals; /*always > 0 because fractionalPart < 1*/
+            uint64_t high;
+            uint64_t low;
+            bool roundUp;
+            bool isOdd;
+
+            Multiply64To128(mantissa, fivePower, &high, &low);
+
+            if (shift >= 128)
+            {
+                /*the product is below 2^(DBL_MANT_DIG + 45), far less than half of 2^shift*/
+                fractionalDigits = 0;
+                roundUp = false;
+            }
+            else if (shift > 64)
+            {
+                uint64_t remainderHigh = high & ((1ULL << (shift - 64)) - 1);
+                uint64_t halfHigh = 1ULL << (shift - 65);
+                fractionalDigits = high >> (shift - 64);
+                isOdd = (((decimals == 0) ? integerDigits : fractionalDigits) & 1) != 0;
+                roundUp = (remainderHigh > halfHigh) ||
+                    ((remainderHigh == halfHigh) && ((low != 0) || isOdd));
+            }
+            else if (shift == 64)
+            {
+                fractionalDigits = high;
+                isOdd = (((decimals == 0) ? integerDigits : fractionalDigits) & 1) != 0;
+                roundUp = (low > (1ULL << 63)) ||
+                    ((low == (1ULL << 63)) && isOdd);
+            }
+            else
+            {
+                uint64_t remainder = low & ((1ULL << shift) - 1);
+                uint64_t half = 1ULL << (shift - 1);
+                fractionalDigits = (high << (64 - shift)) | (low >> shift);
+                /*ties go to even (the last printed digit), same as printf in the default rounding mode*/
+                isOdd = (((decimals == 0) ? integerDigits : fractionalDigits) & 1) != 0;
+                roundUp = (remainder > half) ||
+                    ((remainder == half) && isOdd);
+            }
+
+            if (roundUp)
+            {
+                fractionalDigits++;
+                if (fractionalDigits == scale)
+                {
+                    fractionalDigits = 0;
+                    integerDigits++;
+                }
+            }
+        }
+
+        result = 0;
+        if (value < 0)
+        {
+            destination[result++] = '-';
+        }
+        result += FormatUInt64(integerDigits, destination + result);
+
+        if (decimals > 0)
+        {
+            /*the fractional digits are written right to left, padded with '0'*/
+            destination[result++] = '.';
+            for (i = decimals - 1; i >= 0; i--)
+            {
+                destination[result + i] = '0' + (char)(fractionalDigits % 10);
+                fractionalDigits /= 10;
+            }
+            result += decimals;
+            destination[result] = '\0';
+        }
     }
 
     return result;
 }
+#endif
+
+
+#define IS_DIGIT(a) (('0'<=(a)) &&((a)<='9'))
+#define splitInt(intVal, bytePos)   (char)((intVal >> (bytePos << 3)) & 0xFF)
+#define joinChars(a, b, c, d) (uint32_t)( (uint32_t)a + ((uint32_t)b << 8) + ((uint32_t)c << 16) + ((uint32_t)d << 24))
+
+/*the 64 base64url characters, indexed by their 6 bit value*/
+static const char base64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/*the 6 bit value of every character, BASE64_INVALID_VALUE for characters that are not base64url*/
+#define BASE64_INVALID_VALUE 0xFF
+static const unsigned char base64values[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0x3F,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+#define base64char(val) (base64chars[(val) & 0x3F])
 
 static char base64b16(unsigned char val)
 {
@@ -514,34 +771,15 @@ static int ValidateDecimal(const char* v, size_t vlen)
 static int base64toValue(char base64charSource, unsigned char* value)
 {
     int result;
-    if (('A' <= base64charSource) && (base64charSource <= 'Z'))
-    {
-        *value = base64charSource - 'A';
-        result = 0;
-    }
-    else if (('a' <= base64charSource) && (base64charSource <= 'z'))
-    {
-        *value = ('Z' - 'A') +1+ (base64charSource - 'a');
-        result = 0;
-    }
-    else if (('0' <= base64charSource) && (base64charSource <= '9'))
+    unsigned char temp = base64values[(unsigned char)base64charSource];
+    if (temp == BASE64_INVALID_VALUE)
     {
-        *value = ('Z' - 'A') +1+('z'-'a')+1 +(base64charSource - '0');
-        result = 0;
-    }
-    else if ('-' == base64charSource)
-    {
-        *value = 62;
-        result = 0;
-    }
-    else if ('_' == base64charSource)
-    {
-        *value = 63;
-        result = 0;
+        result = 1;
     }
     else
     {
-        result = 1;
+        *value = temp;
+        result = 0;
     }
     return result;
 }
@@ -557,13 +795,12 @@ static int scan4base64char(const char* source, size_t sourceSize, unsigned char
     }
     else
     {
-        unsigned char b0, b1, b2, b3;
-        if (
-            (base64toValue(source[0], &b0) == 0) &&
-            (base64toValue(source[1], &b1) == 0) &&
-            (base64toValue(source[2], &b2) == 0) &&
-            (base64toValue(source[3], &b3) == 0)
-            )
+        unsigned char b0 = base64values[(unsigned char)source[0]];
+        unsigned char b1 = base64values[(unsigned char)source[1]];
+        unsigned char b2 = base64values[(unsigned char)source[2]];
+        unsigned char b3 = base64values[(unsigned char)source[3]];
+        /*BASE64_INVALID_VALUE is the only table entry with any of the 2 high bits set*/
+        if (((b0 | b1 | b2 | b3) & 0xC0) == 0)
         {
             *destination0 = (b0 << 2) | ((b1 & 0x30) >> 4);
             *destination1 = ((b1 & 0x0F)<<4) | ((b2 & 0x3C) >>2 );
@@ -579,33 +816,39 @@ static int scan4base64char(const char* source, size_t sourceSize, unsigned char
 }
 
 /*return 0 if the character is one of ( 'A' / 'E' / 'I' / 'M' / 'Q' / 'U' / 'Y' / 'c' / 'g' / 'k' / 'o' / 's' / 'w' / '0' / '4' / '8' )*/
+/*those are exactly the base64 characters whose value has the 2 low bits clear*/
 static int base64b16toValue(unsigned char source, unsigned char* destination)
 {
-    unsigned char i;
-    for (i = 0; i <= 15; i++)
+    int result;
+    unsigned char temp = base64values[source];
+    if ((temp == BASE64_INVALID_VALUE) || ((temp & 0x03) != 0))
     {
-        if (base64b16(i) == source)
-        {
-            *destination = i;
-            return 0;
-        }
+        result = 1;
+    }
+    else
+    {
+        *destination = temp >> 2;
+        result = 0;
     }
-    return 1;
+    return result;
 }
 
 /*return 0 if the character is one of ( 'A' / 'Q' / 'g' / 'w' )*/
+/*those are exactly the base64 characters whose value has the 4 low bits clear*/
 static int base64b8toValue(unsigned char source, unsigned char* destination)
 {
-    unsigned char i;
-    for (i = 0; i <= 3; i++)
+    int result;
+    unsigned char temp = base64values[source];
+    if ((temp == BASE64_INVALID_VALUE) || ((temp & 0x0F) != 0))
     {
-        if (base64b8(i) == source)
-        {
-            *destination = i;
-            return 0;
-        }
+        result = 1;
     }
-    return 1;
+    else
+    {
+        *destination = temp >> 4;
+        result = 0;
+    }
+    return result;
 }
 
 
@@ -1058,6 +1301,42 @@ AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_charz_no_quotes(AGENT_DATA_T
     return result;
 }
 
+AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_Array(AGENT_DATA_TYPE* agentData, AGENT_DATA_TYPE_TYPE elementType, size_t elementSize, const void* values, size_t count)
+{
+    AGENT_DATA_TYPES_RESULT result;
+    /*Codes_SRS_AGENT_TYPE_SYSTEM_99_013:[ All the Create_... functions shall check their parameters for validity. When an invalid parameter is detected, a code of AGENT_DATA_TYPES_INVALID_ARG shall be returned ].*/
+    if ((agentData == NULL) || (elementSize == 0) || ((values == NULL) && (count > 0)) ||
+        ((elementType != EDM_BOOLEAN_TYPE) && (elementType != EDM_BYTE_TYPE) && (elementType != EDM_SBYTE_TYPE) && (elementType != EDM_INT16_TYPE) &&
+        (elementType != EDM_INT32_TYPE) && (elementType != EDM_INT64_TYPE) && (elementType != EDM_SINGLE_TYPE) && (elementType != EDM_DOUBLE_TYPE)))
+    {
+        result = AGENT_DATA_TYPES_INVALID_ARG;
+        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+    }
+    else
+    {
+        /*Codes_SRS_AGENT_TYPE_SYSTEM_41_006: [ Create_AGENT_DATA_TYPE_from_Array shall create an EDM_ARRAY_TYPE holding a copy of the count values of elementSize bytes, made with one allocation. ]*/
+        agentData->value.edmArray.values = NULL;
+        if ((count > 0) && ((agentData->value.edmArray.values = malloc(count * elementSize)) == NULL))
+        {
+            result = AGENT_DATA_TYPES_ERROR;
+            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+        }
+        else
+        {
+            if (count > 0)
+            {
+                (void)memcpy(agentData->value.edmArray.values, values, count * elementSize);
+            }
+            agentData->type = EDM_ARRAY_TYPE;
+            agentData->value.edmArray.elementType = elementType;
+            agentData->value.edmArray.elementSize = elementSize;
+            agentData->value.edmArray.count = count;
+            result = AGENT_DATA_TYPES_OK;
+        }
+    }
+    return result;
+}
+
 void Destroy_AGENT_DATA_TYPE(AGENT_DATA_TYPE* agentData)
 {
     if(agentData==NULL)
@@ -1272,6 +1551,13 @@ void Destroy_AGENT_DATA_TYPE(AGENT_DATA_TYPE* agentData)
                 free(agentData->value.edmComplexType.fields);
                 break;
             }
+            case (EDM_ARRAY_TYPE):
+            {
+                /*Codes_SRS_AGENT_TYPE_SYSTEM_99_050:[Destroy_AGENT_DATA_TYPE shall deallocate all allocated resources used to represent the type.]*/
+                free(agentData->value.edmArray.values);
+                agentData->value.edmArray.values = NULL;
+                break;
+            }
         }
         agentData->type = EDM_NO_TYPE; /*mark as detroyed*/
     }
@@ -1429,228 +1715,55 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
             {
                 /*Codes_SRS_AGENT_TYPE_SYSTEM_99_019:[ EDM_DATETIMEOFFSET: dateTimeOffsetValue = year "-" month "-" day "T" hour ":" minute [ ":" second [ "." fractionalSeconds ] ] ( "Z" / sign hour ":" minute )]*/
                 /*from ABNF seems like these numbers HAVE to be padded with zeroes*/
-                if (value->value.edmDateTimeOffset.hasTimeZone)
-                {
-                    if (value->value.edmDateTimeOffset.hasFractionalSecond)
-                    {
-                        size_t tempBufferSize = 1 + // \"
-                            MAX_LONG_STRING_LENGTH + // %.4d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // T
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // .
-                            MAX_ULONG_LONG_STRING_LENGTH + // %.12llu
-                            1 + MAX_LONG_STRING_LENGTH + // %+.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + //\"
-                            1;  // " (terminating NULL);
-
-                        char* tempBuffer = (char*)malloc(tempBufferSize);
-                        if (tempBuffer == NULL)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            if (sprintf_s(tempBuffer, tempBufferSize, "\"%.4d-%.2d-%.2dT%.2d:%.2d:%.2d.%.12llu%+.2d:%.2d\"", /*+ in printf forces the sign to appear*/
-                                value->value.edmDateTimeOffset.dateTime.tm_year+1900,
-                                value->value.edmDateTimeOffset.dateTime.tm_mon+1,
-                                value->value.edmDateTimeOffset.dateTime.tm_mday,
-                                value->value.edmDateTimeOffset.dateTime.tm_hour,
-                                value->value.edmDateTimeOffset.dateTime.tm_min,
-                                value->value.edmDateTimeOffset.dateTime.tm_sec,
-                                value->value.edmDateTimeOffset.fractionalSecond,
-                                value->value.edmDateTimeOffset.timeZoneHour,
-                                value->value.edmDateTimeOffset.timeZoneMinute) < 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else if (STRING_concat(destination, tempBuffer) != 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else
-                            {
-                                result = AGENT_DATA_TYPES_OK;
-                            }
-
-                            // Clean up temp buffer if allocated
-                            free(tempBuffer);
-                        }
-                    }
-                    else
-                    {
-                        size_t tempBufferSize = 1 + // \"
-                            MAX_LONG_STRING_LENGTH + // %.4d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // T
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + MAX_LONG_STRING_LENGTH + // %+.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // \"
-                            1; // " terminating NULL
-                        char* tempBuffer = (char*)malloc(tempBufferSize);
-
-                        if (tempBuffer == NULL)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            if (sprintf_s(tempBuffer, tempBufferSize, "\"%.4d-%.2d-%.2dT%.2d:%.2d:%.2d%+.2d:%.2d\"", /*+ in printf forces the sign to appear*/
-                                value->value.edmDateTimeOffset.dateTime.tm_year + 1900,
-                                value->value.edmDateTimeOffset.dateTime.tm_mon+1,
-                                value->value.edmDateTimeOffset.dateTime.tm_mday,
-                                value->value.edmDateTimeOffset.dateTime.tm_hour,
-                                value->value.edmDateTimeOffset.dateTime.tm_min,
-                                value->value.edmDateTimeOffset.dateTime.tm_sec,
-                                value->value.edmDateTimeOffset.timeZoneHour,
-                                value->value.edmDateTimeOffset.timeZoneMinute) < 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else if (STRING_concat(destination, tempBuffer) != 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else
-                            {
-                                result = AGENT_DATA_TYPES_OK;
-                            }
+                /*Codes_SRS_AGENT_TYPE_SYSTEM_41_005: [ EDM_DATE_TIME_OFFSET values shall be formatted in a buffer on the stack, producing the same characters as sprintf with the "%.4d-%.2d-%.2dT%.2d:%.2d:%.2d" format followed by ".%.12llu" when there is a fractional second and by "%+.2d:%.2d" or "Z". ]*/
+                const EDM_DATE_TIME_OFFSET* dateTimeOffset = &value->value.edmDateTimeOffset;
+                char tempBuffer[1 + /* \" */
+                    6 * (PADDED_INTEGER_MAX_LENGTH + 1) + /* year, month, day, hour, minute, second and their separators */
+                    PADDED_INTEGER_MAX_LENGTH + /* fractional second */
+                    2 * (PADDED_INTEGER_MAX_LENGTH + 1) + /* time zone or Z */
+                    1 + /* \" */
+                    1]; /* terminating NULL */
+                size_t pos = 0;
 
-                            // Clean up temp buffer if allocated
-                            free(tempBuffer);
-                        }
-                    }
+                tempBuffer[pos++] = '\"';
+                pos += FormatPaddedInt64((int64_t)dateTimeOffset->dateTime.tm_year + 1900, 4, false, tempBuffer + pos);
+                tempBuffer[pos++] = '-';
+                pos += FormatPaddedInt64((int64_t)dateTimeOffset->dateTime.tm_mon + 1, 2, false, tempBuffer + pos);
+                tempBuffer[pos++] = '-';
+                pos += FormatPaddedInt64(dateTimeOffset->dateTime.tm_mday, 2, false, tempBuffer + pos);
+                tempBuffer[pos++] = 'T';
+                pos += FormatPaddedInt64(dateTimeOffset->dateTime.tm_hour, 2, false, tempBuffer + pos);
+                tempBuffer[pos++] = ':';
+                pos += FormatPaddedInt64(dateTimeOffset->dateTime.tm_min, 2, false, tempBuffer + pos);
+                tempBuffer[pos++] = ':';
+                pos += FormatPaddedInt64(dateTimeOffset->dateTime.tm_sec, 2, false, tempBuffer + pos);
+                if (dateTimeOffset->hasFractionalSecond)
+                {
+                    tempBuffer[pos++] = '.';
+                    pos += FormatPaddedUInt64(dateTimeOffset->fractionalSecond, 12, tempBuffer + pos);
+                }
+                if (dateTimeOffset->hasTimeZone)
+                {
+                    /*+ forces the sign to appear*/
+                    pos += FormatPaddedInt64(dateTimeOffset->timeZoneHour, 2, true, tempBuffer + pos);
+                    tempBuffer[pos++] = ':';
+                    pos += FormatPaddedInt64(dateTimeOffset->timeZoneMinute, 2, false, tempBuffer + pos);
                 }
                 else
                 {
-                    if (value->value.edmDateTimeOffset.hasFractionalSecond)
-                    {
-                        size_t tempBufferSize = 1 + //\"
-                            MAX_LONG_STRING_LENGTH + // %.4d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // T
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // .
-                            MAX_ULONG_LONG_STRING_LENGTH + // %.12llu
-                            1 + // Z
-                            1 + // \"
-                            1; // " (terminating NULL)
-                        char* tempBuffer = (char*)malloc(tempBufferSize);
-
-                        if (tempBuffer == NULL)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            if (sprintf_s(tempBuffer, tempBufferSize, "\"%.4d-%.2d-%.2dT%.2d:%.2d:%.2d.%.12lluZ\"", /*+ in printf forces the sign to appear*/
-                                value->value.edmDateTimeOffset.dateTime.tm_year + 1900,
-                                value->value.edmDateTimeOffset.dateTime.tm_mon+1,
-                                value->value.edmDateTimeOffset.dateTime.tm_mday,
-                                value->value.edmDateTimeOffset.dateTime.tm_hour,
-                                value->value.edmDateTimeOffset.dateTime.tm_min,
-                                value->value.edmDateTimeOffset.dateTime.tm_sec,
-                                value->value.edmDateTimeOffset.fractionalSecond) < 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else if (STRING_concat(destination, tempBuffer) != 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else
-                            {
-                                result = AGENT_DATA_TYPES_OK;
-                            }
-
-                            free(tempBuffer);
-                        }
-                    }
-                    else
-                    {
-                        size_t tempBufferSize = 1 + // \"
-                            MAX_LONG_STRING_LENGTH + // %.4d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // T
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // Z
-                            1 + // \"
-                            1; // " (terminating null);
-
-                        char* tempBuffer = (char*)malloc(tempBufferSize);
-
-                        if (tempBuffer == NULL)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            if (sprintf_s(tempBuffer, tempBufferSize, "\"%.4d-%.2d-%.2dT%.2d:%.2d:%.2dZ\"",
-                                value->value.edmDateTimeOffset.dateTime.tm_year + 1900,
-                                value->value.edmDateTimeOffset.dateTime.tm_mon+1,
-                                value->value.edmDateTimeOffset.dateTime.tm_mday,
-                                value->value.edmDateTimeOffset.dateTime.tm_hour,
-                                value->value.edmDateTimeOffset.dateTime.tm_min,
-                                value->value.edmDateTimeOffset.dateTime.tm_sec) < 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else if (STRING_concat(destination, tempBuffer) != 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else
-                            {
-                                result = AGENT_DATA_TYPES_OK;
-                            }
+                    tempBuffer[pos++] = 'Z';
+                }
+                tempBuffer[pos++] = '\"';
+                tempBuffer[pos] = '\0';
 
-                            free(tempBuffer);
-                        }
-                    }
+                if (STRING_concat(destination, tempBuffer) != 0)
+                {
+                    result = AGENT_DATA_TYPES_ERROR;
+                    LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+                }
+                else
+                {
+                    result = AGENT_DATA_TYPES_OK;
                 }
                 break;
             }
@@ -1670,35 +1783,9 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
             case (EDM_INT16_TYPE) :
             {
                 /*-32768 to +32767*/
-                char buffertemp2[7]; /*because 5 digits and sign and '\0'*/
-                uint16_t positiveValue;
-                size_t pos = 0;
-                uint16_t rank = (uint16_t)10000;
-                bool foundFirstDigit = false;
-
-                if (value->value.edmInt16.value < 0)
-                {
-                    buffertemp2[pos++] = '-';
-                    positiveValue = -value->value.edmInt16.value;
-                }
-                else
-                {
-                    positiveValue = value->value.edmInt16.value;
-                }
+                char buffertemp2[21]; /*what FormatInt64 needs*/
+                (void)FormatInt64(value->value.edmInt16.value, buffertemp2);
 
-                while (rank >= 10)
-                {
-                    if ((foundFirstDigit == true) || (positiveValue / rank) > 0)
-                    {
-                        buffertemp2[pos++] = '0' + (char)(positiveValue / rank);
-                        foundFirstDigit = true;
-                    }
-                    positiveValue %= rank;
-                    rank /= 10;
-                }
-                buffertemp2[pos++] = '0' + (char)(positiveValue);
-                buffertemp2[pos++] = '\0';
-                
                 if (STRING_concat(destination, buffertemp2) != 0)
                 {
                     result = AGENT_DATA_TYPES_ERROR;
@@ -1713,35 +1800,9 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
             case (EDM_INT32_TYPE) :
             {
                 /*-2147483648 to +2147483647*/
-                char buffertemp2[12]; /*because 10 digits and sign and '\0'*/
-                uint32_t positiveValue;
-                size_t pos = 0;
-                uint32_t rank = 1000000000UL;
-                bool foundFirstDigit = false;
+                char buffertemp2[21]; /*what FormatInt64 needs*/
+                (void)FormatInt64(value->value.edmInt32.value, buffertemp2);
 
-                if (value->value.edmInt32.value < 0)
-                {
-                    buffertemp2[pos++] = '-';
-                    positiveValue = - value->value.edmInt32.value;
-                }
-                else
-                {
-                    positiveValue = value->value.edmInt32.value;
-                }
-
-                while (rank >= 10)
-                {
-                    if ((foundFirstDigit == true) || (positiveValue / rank) > 0)
-                    {
-                        buffertemp2[pos++] = '0' + (char)(positiveValue / rank);
-                        foundFirstDigit = true;
-                    }
-                    positiveValue %= rank;
-                    rank /= 10;
-                }
-                buffertemp2[pos++] = '0' + (char)(positiveValue);
-                buffertemp2[pos++] = '\0';
-                
                 if (STRING_concat(destination, buffertemp2) != 0)
                 {
                     result = AGENT_DATA_TYPES_ERROR;
@@ -1756,33 +1817,7 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
             case (EDM_INT64_TYPE):
             {
                 char buffertemp2[21]; /*because 19 digits and sign and '\0'*/
-                uint64_t positiveValue;
-                size_t pos = 0;
-                uint64_t rank = 10000000000000000000ULL;
-                bool foundFirstDigit = false;
-
-                if (value->value.edmInt64.value < 0)
-                {
-                    buffertemp2[pos++] = '-';
-                    positiveValue = -value->value.edmInt64.value;
-                }
-                else
-                {
-                    positiveValue = value->value.edmInt64.value;
-                }
-
-                while (rank >= 10)
-                {
-                    if ((foundFirstDigit == true) || (positiveValue / rank) > 0)
-                    {
-                        buffertemp2[pos++] = '0' + (char)(positiveValue / rank);
-                        foundFirstDigit = true;
-                    }
-                    positiveValue %= rank;
-                    rank /= 10;
-                }
-                buffertemp2[pos++] = '0' + (char)(positiveValue);
-                buffertemp2[pos++] = '\0';
+                (void)FormatInt64(value->value.edmInt64.value, buffertemp2);
 
                 if (STRING_concat(destination, buffertemp2) != 0)
                 {
@@ -1995,31 +2030,23 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 }
                 else
                 {
-                    size_t tempBufferSize = MAX_FLOATING_POINT_STRING_LENGTH;
-                    char* tempBuffer = (char*)malloc(tempBufferSize);
-                    if (tempBuffer == NULL)
+                    char tempBuffer[MAX_FLOATING_POINT_STRING_LENGTH];
+                    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_001: [ EDM_SINGLE and EDM_DOUBLE values whose magnitude is below 2^53 shall be formatted with integer arithmetic, producing the same characters as sprintf with the "%.*f" format. ]*/
+                    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_002: [ Other values shall be formatted with sprintf_s. ]*/
+                    if ((FormatFixedPoint((double)(value->value.edmSingle.value), FLT_DIG, tempBuffer) == 0) &&
+                        (sprintf_s(tempBuffer, sizeof(tempBuffer), "%.*f", FLT_DIG, (double)(value->value.edmSingle.value)) < 0))
+                    {
+                        result = AGENT_DATA_TYPES_ERROR;
+                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+                    }
+                    else if (STRING_concat(destination, tempBuffer) != 0)
                     {
                         result = AGENT_DATA_TYPES_ERROR;
                         LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
                     }
                     else
                     {
-                        if (sprintf_s(tempBuffer, tempBufferSize, "%.*f", FLT_DIG, (double)(value->value.edmSingle.value)) < 0)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else if (STRING_concat(destination, tempBuffer) != 0)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            result = AGENT_DATA_TYPES_OK;
-                        }
-
-                        free(tempBuffer);
+                        result = AGENT_DATA_TYPES_OK;
                     }
                 }
                 break;
@@ -2073,21 +2100,50 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 /*Codes_SRS_AGENT_TYPE_SYSTEM_99_022:[ EDM_DOUBLE: doubleValue = decimalValue [ "e" [SIGN] 1*DIGIT ] / nanInfinity ; IEEE 754 binary64 floating-point number (15-17 decimal digits). The representation shall use DBL_DIG C #define*/
                 else
                 {
-                    size_t tempBufferSize = DECIMAL_DIG * 2;
-                    char* tempBuffer = (char*)malloc(tempBufferSize);
-                    if (tempBuffer == NULL)
+                    char tempBuffer[DECIMAL_DIG * 2];
+                    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_001: [ EDM_SINGLE and EDM_DOUBLE values whose magnitude is below 2^53 shall be formatted with integer arithmetic, producing the same characters as sprintf with the "%.*f" format. ]*/
+                    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_002: [ Other values shall be formatted with sprintf_s. ]*/
+                    if ((FormatFixedPoint(value->value.edmDouble.value, DBL_DIG, tempBuffer) == 0) &&
+                        (sprintf_s(tempBuffer, sizeof(tempBuffer), "%.*f", DBL_DIG, value->value.edmDouble.value) < 0))
+                    {
+                        result = AGENT_DATA_TYPES_ERROR;
+                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+                    }
+                    else if (STRING_concat(destination, tempBuffer) != 0)
                     {
                         result = AGENT_DATA_TYPES_ERROR;
                         LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
                     }
                     else
                     {
-                        if (sprintf_s(tempBuffer, tempBufferSize, "%.*f", DBL_DIG, value->value.edmDouble.value) < 0)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else if (STRING_concat(destination, tempBuffer) != 0)
+                        result = AGENT_DATA_TYPES_OK;
+                    }
+                }
+                break;
+            }
+#endif
+
+            case(EDM_ARRAY_TYPE) :
+            {
+                /*Codes_SRS_AGENT_TYPE_SYSTEM_41_007: [ EDM_ARRAY_TYPE shall be written as a JSON array of its values, rendered into one buffer by ModelCodec_WriteArray. ]*/
+                char* text = (char*)malloc(ModelCodec_GetArrayMaxLength(value->value.edmArray.elementType, value->value.edmArray.count) + 1);
+                if (text == NULL)
+                {
+                    result = AGENT_DATA_TYPES_ERROR;
+                    LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+                }
+                else
+                {
+                    int length = ModelCodec_WriteArray(text, value->value.edmArray.elementType, value->value.edmArray.elementSize, value->value.edmArray.values, value->value.edmArray.count);
+                    if (length < 0)
+                    {
+                        result = AGENT_DATA_TYPES_ERROR;
+                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+                    }
+                    else
+                    {
+                        text[length] = '\0';
+                        if (STRING_concat(destination, text) != 0)
                         {
                             result = AGENT_DATA_TYPES_ERROR;
                             LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
@@ -2096,13 +2152,11 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                         {
                             result = AGENT_DATA_TYPES_OK;
                         }
-
-                        free(tempBuffer);
                     }
+                    free(text);
                 }
                 break;
             }
-#endif
 
             case(EDM_COMPLEX_TYPE_TYPE) :
             {
@@ -2242,27 +2296,19 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                     */
 
                     size_t destinationPointer = 0;
+                    const unsigned char* data = value->value.edmBinary.data;
+                    size_t size = value->value.edmBinary.size;
                     temp[destinationPointer++] = '"';
-                    while (value->value.edmBinary.size - currentPosition >= 3)
+                    /*the 3 bytes of a group are joined in one 24 bit value and each 6 bit slice is a table lookup*/
+                    while (size - currentPosition >= 3)
                     {
-                        char c1 = base64char(value->value.edmBinary.data[currentPosition] >> 2);
-                        char c2 = base64char(
-                            ((value->value.edmBinary.data[currentPosition] & 3) << 4) |
-                                (value->value.edmBinary.data[currentPosition + 1] >> 4)
-                        );
-                        char c3 = base64char(
-                            ((value->value.edmBinary.data[currentPosition + 1] & 0x0F) << 2) |
-                                ((value->value.edmBinary.data[currentPosition + 2] >> 6) & 3)
-                        );
-                        char c4 = base64char(
-                            value->value.edmBinary.data[currentPosition + 2] & 0x3F
-                        );
+                        uint32_t group = ((uint32_t)data[currentPosition] << 16) | ((uint32_t)data[currentPosition + 1] << 8) | data[currentPosition + 2];
+                        temp[destinationPointer] = base64char(group >> 18);
+                        temp[destinationPointer + 1] = base64char(group >> 12);
+                        temp[destinationPointer + 2] = base64char(group >> 6);
+                        temp[destinationPointer + 3] = base64char(group);
                         currentPosition += 3;
-                        temp[destinationPointer++] = c1;
-                        temp[destinationPointer++] = c2;
-                        temp[destinationPointer++] = c3;
-                        temp[destinationPointer++] = c4;
-
+                        destinationPointer += 4;
                     }
                     if (value->value.edmBinary.size - currentPosition == 2)
                     {
@@ -2683,6 +2729,11 @@ AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(AGENT_DATA_T
                 LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
                 break;
             }
+            case(EDM_ARRAY_TYPE) :
+            {
+                result = Create_AGENT_DATA_TYPE_from_Array(dest, src->value.edmArray.elementType, src->value.edmArray.elementSize, src->value.edmArray.values, src->value.edmArray.count);
+                break;
+            }
             case(EDM_COMPLEX_TYPE_TYPE) :
             {
                 result = AGENT_DATA_TYPES_OK;
@@ -2948,29 +2999,12 @@ AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_Members(AGENT_DATA_TYPE* age
 
 #define isLeapYear(y) ((((y) % 400) == 0) || (((y)%4==0)&&(!((y)%100==0))))
 
+/*number of days in a non leap year before the first day of each month, indexed by tm_mon*/
+static const int DaysInAllPreviousMonths[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
 static int daysInAllPreviousMonths(int month)
 {
-    int result = 0;
-    for (int i = 0; i < month; i++)
-    {
-        switch (i)
-        {
-        case 0:
-        case 2:
-        case 4:
-        case 6:
-        case 7:
-        case 9:
-            result += 31;
-            break;
-        case 1:
-            result += 28;
-            break;
-        default:
-            result += 30;
-        }
-    }
-    return result;
+    return DaysInAllPreviousMonths[month];
 }
 
 /*this function assumes a correctly filled in tm_year, tm_mon and tm_mday and will fill in tm_yday and tm_wday*/
@@ -3009,21 +3043,233 @@ static int sscanf2d(const char *pos2, int* sec)
     
 }
 
+/*the fast paths below handle the plain [-]digits[.digits][e[sign]digits] spellings that fit without any loss,
+everything else (whitespace, '+', hex, too many digits...) is left to the strtoxxx functions*/
+
+/*the 8 characters at source, the first one in the lowest byte*/
+static uint64_t Load8Characters(const char* source)
+{
+    uint64_t result = 0;
+    int i;
+    for (i = 7; i >= 0; i--)
+    {
+        result = (result << 8) | (unsigned char)source[i];
+    }
+    return result;
+}
+
+/*converts 8 digit characters (as given by Load8Characters) with 3 multiplications instead of 8*/
+static uint32_t Parse8Digits(uint64_t characters)
+{
+    characters -= 0x3030303030303030ULL;
+    characters = (characters * 10) + (characters >> 8);
+    characters = (((characters & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+        (((characters >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+    return (uint32_t)characters;
+}
+
+static size_t CountDigits(const char* source)
+{
+    size_t result = 0;
+    while (IS_DIGIT(source[result]))
+    {
+        result++;
+    }
+    return result;
+}
+
+/*value = value * 10^nDigits + the nDigits digits at source. The caller makes sure it does not overflow*/
+static uint64_t AccumulateDigits(uint64_t value, const char* source, size_t nDigits)
+{
+    while (nDigits >= 8)
+    {
+        value = (value * 100000000) + Parse8Digits(Load8Characters(source));
+        source += 8;
+        nDigits -= 8;
+    }
+
+    while (nDigits > 0)
+    {
+        value = (value * 10) + (uint64_t)(*source - '0');
+        source++;
+        nDigits--;
+    }
+    return value;
+}
+
+/*parses the digits at source when there are at most maxDigits of them. Returns 0 on success, otherwise the caller shall use strtoxxx*/
+static int ParseDigitsFast(const char* source, size_t maxDigits, uint64_t* value, const char** next)
+{
+    int result;
+    size_t nDigits = CountDigits(source);
+    if ((nDigits == 0) || (nDigits > maxDigits))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *value = AccumulateDigits(0, source, nDigits);
+        *next = source + nDigits;
+        result = 0;
+    }
+    return result;
+}
+
+/*the decimal number at source is (-1)^isNegative * mantissa * 10^exponent. Returns 0 when there is such a number and the mantissa fits in 19 digits*/
+static int ScanDecimalFast(const char* source, bool* isNegative, uint64_t* mantissa, int* exponent)
+{
+    int result;
+    size_t nIntegerDigits;
+
+    *isNegative = (*source == '-');
+    if (*isNegative)
+    {
+        source++;
+    }
+
+    nIntegerDigits = CountDigits(source);
+    if ((nIntegerDigits == 0) ||
+        (nIntegerDigits > 19) ||
+        ((source[nIntegerDigits] == 'x') || (source[nIntegerDigits] == 'X'))) /*strtod reads "0x" as hexadecimal*/
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *mantissa = AccumulateDigits(0, source, nIntegerDigits);
+        *exponent = 0;
+        source += nIntegerDigits;
+        result = 0;
+
+        if (*source == '.')
+        {
+            size_t nFractionalDigits = CountDigits(source + 1);
+            if (nIntegerDigits + nFractionalDigits > 19)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                *mantissa = AccumulateDigits(*mantissa, source + 1, nFractionalDigits);
+                *exponent = -(int)nFractionalDigits;
+                source += 1 + nFractionalDigits;
+            }
+        }
+
+        if ((result == 0) &&
+            ((*source == 'e') || (*source == 'E')))
+        {
+            const char* exponentStart = source + 1;
+            bool isExponentNegative = (*exponentStart == '-');
+            size_t nExponentDigits;
+            if ((*exponentStart == '-') || (*exponentStart == '+'))
+            {
+                exponentStart++;
+            }
+
+            /*an 'e' not followed by digits is not part of the number, same as for strtod*/
+            nExponentDigits = CountDigits(exponentStart);
+            if (nExponentDigits > 4)
+            {
+                result = __FAILURE__;
+            }
+            else if (nExponentDigits > 0)
+            {
+                int exponentValue = (int)AccumulateDigits(0, exponentStart, nExponentDigits);
+                *exponent += isExponentNegative ? -exponentValue : exponentValue;
+            }
+        }
+    }
+    return result;
+}
+
+/*when double arithmetic is done in a wider type the result could be rounded twice, so the fast path stays off*/
+#if !defined(FLT_EVAL_METHOD) || (FLT_EVAL_METHOD == 0) || (FLT_EVAL_METHOD == 1)
+#define CAN_PARSE_FLOATING_POINT_FAST
+
+/*all these are exact in a double*/
+static const double PowersOf10[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*mantissa and 10^|exponent| are exact, so one multiplication or division gives the correctly rounded result*/
+static int ParseDoubleFast(const char* source, double* value)
+{
+    int result;
+    bool isNegative;
+    uint64_t mantissa;
+    int exponent;
+
+    if ((ScanDecimalFast(source, &isNegative, &mantissa, &exponent) != 0) ||
+        (mantissa > (1ULL << DBL_MANT_DIG)) ||
+        (exponent < -22) ||
+        (exponent > 22))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        double temp = (exponent < 0) ? ((double)mantissa / PowersOf10[-exponent]) : ((double)mantissa * PowersOf10[exponent]);
+        *value = isNegative ? -temp : temp;
+        result = 0;
+    }
+    return result;
+}
+
+/*same for float: the operation done in double and then rounded to float is still correctly rounded*/
+static int ParseFloatFast(const char* source, float* value)
+{
+    int result;
+    bool isNegative;
+    uint64_t mantissa;
+    int exponent;
+
+    if ((ScanDecimalFast(source, &isNegative, &mantissa, &exponent) != 0) ||
+        (mantissa > (1ULL << FLT_MANT_DIG)) ||
+        (exponent < -10) ||
+        (exponent > 10))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        double temp = (exponent < 0) ? ((double)mantissa / PowersOf10[-exponent]) : ((double)mantissa * PowersOf10[exponent]);
+        *value = (float)(isNegative ? -temp : temp);
+        result = 0;
+    }
+    return result;
+}
+#endif
+
 /*the following function does the same as  sscanf(pos2, "%d", &sec)*/
 /*this function only exists because of optimizing valgrind time, otherwise sscanf would be just as good*/
 static int sscanfd(const char *src, int* dst)
 {
     int result;
-    char* next;
-    long int temp = strtol(src, &next, 10);
-    if ((src == next) || (((temp == LONG_MAX) || (temp == LONG_MIN)) && (errno != 0)))
+    uint64_t fastValue;
+    const char* fastNext;
+
+    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_003: [ Integers of at most 9 digits (at most 19 for EDM_INT64) shall be parsed without calling strtol, strtoul or strtoull. ]*/
+    if (ParseDigitsFast((*src == '-') ? (src + 1) : src, 9, &fastValue, &fastNext) == 0)
     {
-        result = EOF;
+        (*dst) = (*src == '-') ? -(int)fastValue : (int)fastValue;
+        result = 1;
     }
     else
     {
-        (*dst) = temp;
-        result = 1;
+        char* next;
+        long int temp = strtol(src, &next, 10);
+        if ((src == next) || (((temp == LONG_MAX) || (temp == LONG_MIN)) && (errno != 0)))
+        {
+            result = EOF;
+        }
+        else
+        {
+            (*dst) = temp;
+            result = 1;
+        }
     }
     return result;
 }
@@ -3032,13 +3278,25 @@ static int sscanfd(const char *src, int* dst)
 static int sscanfllu(const char** src, unsigned long long* dst)
 {
     int result = 1;
-    char* next;
-    (*dst) = strtoull((*src), &next, 10);
-    if (((*src) == (const char*)next) || (((*dst) == ULLONG_MAX) && (errno != 0)))
+    uint64_t fastValue;
+    const char* fastNext;
+
+    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_003: [ Integers of at most 9 digits (at most 19 for EDM_INT64) shall be parsed without calling strtol, strtoul or strtoull. ]*/
+    if (ParseDigitsFast(*src, 19, &fastValue, &fastNext) == 0)
     {
-        result = EOF;
+        (*dst) = fastValue;
+        (*src) = fastNext;
+    }
+    else
+    {
+        char* next;
+        (*dst) = strtoull((*src), &next, 10);
+        if (((*src) == (const char*)next) || (((*dst) == ULLONG_MAX) && (errno != 0)))
+        {
+            result = EOF;
+        }
+        (*src) = (const char*)next;
     }
-    (*src) = (const char*)next;
     return result;
 }
 
@@ -3065,16 +3323,28 @@ static int sscanfdotllu(const char*src, unsigned long long* dst)
 static int sscanfu(const char* src, unsigned int* dst)
 {
     int result;
-    char* next;
-    unsigned long int temp = strtoul(src, &next, 10);
-    if ((src == next) || ((temp == ULONG_MAX) && (errno != 0)))
+    uint64_t fastValue;
+    const char* fastNext;
+
+    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_003: [ Integers of at most 9 digits (at most 19 for EDM_INT64) shall be parsed without calling strtol, strtoul or strtoull. ]*/
+    if (ParseDigitsFast(src, 9, &fastValue, &fastNext) == 0)
     {
-        result = EOF;
+        result = 1;
+        (*dst) = (unsigned int)fastValue;
     }
     else
     {
-        result = 1;
-        (*dst) = temp;
+        char* next;
+        unsigned long int temp = strtoul(src, &next, 10);
+        if ((src == next) || ((temp == ULONG_MAX) && (errno != 0)))
+        {
+            result = EOF;
+        }
+        else
+        {
+            result = 1;
+            (*dst) = temp;
+        }
     }
     return result;
 }
@@ -3083,11 +3353,17 @@ static int sscanfu(const char* src, unsigned int* dst)
 static int sscanff(const char*src, float* dst)
 {
     int result = 1;
-    char* next;
-    (*dst) = strtof(src, &next);
-    if ((src == next) || (((*dst) == HUGE_VALF) && (errno != 0)))
+#ifdef CAN_PARSE_FLOATING_POINT_FAST
+    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_004: [ Decimal numbers with at most 19 significant digits that can be converted exactly with one multiplication or division by a power of 10 shall be parsed without calling strtod or strtof. ]*/
+    if (ParseFloatFast(src, dst) != 0)
+#endif
     {
-        result = EOF;
+        char* next;
+        (*dst) = strtof(src, &next);
+        if ((src == next) || (((*dst) == HUGE_VALF) && (errno != 0)))
+        {
+            result = EOF;
+        }
     }
     return result;
 }
@@ -3096,11 +3372,17 @@ static int sscanff(const char*src, float* dst)
 static int sscanflf(const char*src, double* dst)
 {
     int result = 1;
-    char* next;
-    (*dst) = strtod(src, &next);
-    if ((src == next) || (((*dst) == HUGE_VALL) && (errno != 0)))
+#ifdef CAN_PARSE_FLOATING_POINT_FAST
+    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_004: [ Decimal numbers with at most 19 significant digits that can be converted exactly with one multiplication or division by a power of 10 shall be parsed without calling strtod or strtof. ]*/
+    if (ParseDoubleFast(src, dst) != 0)
+#endif
     {
-        result = EOF;
+        char* next;
+        (*dst) = strtod(src, &next);
+        if ((src == next) || (((*dst) == HUGE_VALL) && (errno != 0)))
+        {
+            result = EOF;
+        }
     }
     return result;
 }
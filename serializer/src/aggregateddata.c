@@ -0,0 +1,217 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdint.h>
+#include <string.h>
+#include "aggregateddata.h"
+#include "agenttypesystem.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
+#define AGGREGATED_DATA_MEMBER_COUNT 7
+
+static const char* const aggregatedDataMemberNames[AGGREGATED_DATA_MEMBER_COUNT] = { "count", "min", "max", "mean", "p50", "p90", "p99" };
+
+/*returns the first position in sorted[0..count) whose value is not less than value*/
+static size_t LowerBound(const double* sorted, size_t count, double value)
+{
+    size_t low = 0;
+    size_t high = count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (sorted[middle] < value)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/*returns the first position in sorted[0..count) whose value is greater than value*/
+static size_t UpperBound(const double* sorted, size_t count, double value)
+{
+    size_t low = 0;
+    size_t high = count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (sorted[middle] <= value)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/*nearest rank: the smallest sample such that at least percent% of the window is less than or equal to it*/
+static double Percentile(const double* sorted, size_t count, size_t percent)
+{
+    size_t rank = (percent * count + 99) / 100;
+    return sorted[(rank == 0) ? 0 : rank - 1];
+}
+
+int AggregatedData_Add(AGGREGATED_DATA_STATE* state, double* samples, size_t windowSize, double sample)
+{
+    int result;
+    /*Codes_SRS_AGGREGATEDDATA_41_001: [ If state or samples is NULL or windowSize is 0 then AggregatedData_Add shall fail and return a non-zero value. ]*/
+    if ((state == NULL) || (samples == NULL) || (windowSize == 0))
+    {
+        LogError("invalid argument AGGREGATED_DATA_STATE* state=%p, double* samples=%p, size_t windowSize=%zu", state, samples, windowSize);
+        result = __FAILURE__;
+    }
+    /*Codes_SRS_AGGREGATEDDATA_41_002: [ If sample is NaN then AggregatedData_Add shall fail and return a non-zero value. ]*/
+    else if (sample != sample)
+    {
+        LogError("NaN cannot be aggregated");
+        result = __FAILURE__;
+    }
+    else
+    {
+        double* ring = samples;
+        double* sorted = samples + windowSize;
+        size_t position;
+
+        /*Codes_SRS_AGGREGATEDDATA_41_003: [ If the window already holds windowSize samples then AggregatedData_Add shall evict the oldest sample from the ring, from the sorted samples and from the running sum. ]*/
+        if (state->count == windowSize)
+        {
+            double oldest = ring[state->next];
+            position = LowerBound(sorted, state->count, oldest);
+            (void)memmove(sorted + position, sorted + position + 1, (state->count - position - 1) * sizeof(double));
+            state->count--;
+            state->sum -= oldest;
+        }
+
+        /*Codes_SRS_AGGREGATEDDATA_41_004: [ AggregatedData_Add shall insert sample in the sorted samples keeping them in ascending order, add it to the running sum and store it in the ring at the next position. ]*/
+        position = UpperBound(sorted, state->count, sample);
+        (void)memmove(sorted + position + 1, sorted + position, (state->count - position) * sizeof(double));
+        sorted[position] = sample;
+        state->count++;
+        state->sum += sample;
+        ring[state->next] = sample;
+        state->next = (state->next + 1 == windowSize) ? 0 : state->next + 1;
+
+        /*Codes_SRS_AGGREGATEDDATA_41_005: [ Every time the ring wraps around AggregatedData_Add shall recompute the running sum from the samples in the window. ]*/
+        if (state->next == 0)
+        {
+            size_t i;
+            state->sum = 0;
+            for (i = 0; i < state->count; i++)
+            {
+                state->sum += sorted[i];
+            }
+        }
+
+        /*Codes_SRS_AGGREGATEDDATA_41_006: [ On success AggregatedData_Add shall return 0. ]*/
+        result = 0;
+    }
+    return result;
+}
+
+int AggregatedData_Reset(AGGREGATED_DATA_STATE* state)
+{
+    int result;
+    /*Codes_SRS_AGGREGATEDDATA_41_007: [ If state is NULL then AggregatedData_Reset shall fail and return a non-zero value. ]*/
+    if (state == NULL)
+    {
+        LogError("invalid argument AGGREGATED_DATA_STATE* state=%p", state);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_AGGREGATEDDATA_41_008: [ AggregatedData_Reset shall empty the window and return 0. ]*/
+        state->count = 0;
+        state->next = 0;
+        state->sum = 0;
+        result = 0;
+    }
+    return result;
+}
+
+AGENT_DATA_TYPES_RESULT AggregatedData_ToAGENT_DATA_TYPE(AGENT_DATA_TYPE* destination, const AGGREGATED_DATA_STATE* state, const double* samples, size_t windowSize, AGGREGATED_DATA_TO_AGENT_DATA_TYPE toAgentDataType)
+{
+    AGENT_DATA_TYPES_RESULT result;
+    /*Codes_SRS_AGGREGATEDDATA_41_009: [ If destination, state, samples or toAgentDataType is NULL or windowSize is 0 then AggregatedData_ToAGENT_DATA_TYPE shall fail and return AGENT_DATA_TYPES_INVALID_ARG. ]*/
+    if ((destination == NULL) || (state == NULL) || (samples == NULL) || (windowSize == 0) || (toAgentDataType == NULL))
+    {
+        LogError("invalid argument AGENT_DATA_TYPE* destination=%p, const AGGREGATED_DATA_STATE* state=%p, const double* samples=%p, size_t windowSize=%zu, AGGREGATED_DATA_TO_AGENT_DATA_TYPE toAgentDataType=%p", destination, state, samples, windowSize, toAgentDataType);
+        result = AGENT_DATA_TYPES_INVALID_ARG;
+    }
+    else
+    {
+        const double* sorted = samples + windowSize;
+        AGENT_DATA_TYPE members[AGGREGATED_DATA_MEMBER_COUNT];
+        /*Codes_SRS_AGGREGATEDDATA_41_010: [ If the window is empty, AggregatedData_ToAGENT_DATA_TYPE shall produce a complex type AGGREGATED_DATA_TYPE_NAME having only the member count. ]*/
+        /*Codes_SRS_AGGREGATEDDATA_41_011: [ Otherwise AggregatedData_ToAGENT_DATA_TYPE shall produce a complex type AGGREGATED_DATA_TYPE_NAME having the members count, min, max, mean, p50, p90 and p99. ]*/
+        size_t memberCount = (state->count == 0) ? 1 : AGGREGATED_DATA_MEMBER_COUNT;
+        size_t created = 0;
+
+        /*Codes_SRS_AGGREGATEDDATA_41_012: [ count shall be an EDM_INT64, mean shall be an EDM_DOUBLE and min, max and the percentiles shall be converted by toAgentDataType. ]*/
+        if (Create_AGENT_DATA_TYPE_from_SINT64(&members[created], (int64_t)state->count) == AGENT_DATA_TYPES_OK)
+        {
+            created++;
+        }
+
+        if (created == 1)
+        {
+            /*Codes_SRS_AGGREGATEDDATA_41_013: [ Percentiles shall use the nearest rank method over the sorted samples. ]*/
+            double values[AGGREGATED_DATA_MEMBER_COUNT];
+            if (memberCount > 1)
+            {
+                values[1] = sorted[0];
+                values[2] = sorted[state->count - 1];
+                values[3] = state->sum / (double)state->count;
+                values[4] = Percentile(sorted, state->count, 50);
+                values[5] = Percentile(sorted, state->count, 90);
+                values[6] = Percentile(sorted, state->count, 99);
+            }
+
+            while ((created < memberCount) &&
+                (((created == 3) ? Create_AGENT_DATA_TYPE_from_DOUBLE(&members[created], values[created]) : toAgentDataType(&members[created], values[created])) == AGENT_DATA_TYPES_OK))
+            {
+                created++;
+            }
+        }
+
+        if (created != memberCount)
+        {
+            /*Codes_SRS_AGGREGATEDDATA_41_014: [ If any conversion fails, AggregatedData_ToAGENT_DATA_TYPE shall fail and return AGENT_DATA_TYPES_ERROR. ]*/
+            LogError("unable to convert member %s", aggregatedDataMemberNames[created]);
+            result = AGENT_DATA_TYPES_ERROR;
+        }
+        else if (Create_AGENT_DATA_TYPE_from_Members(destination, AGGREGATED_DATA_TYPE_NAME, memberCount, aggregatedDataMemberNames, members) != AGENT_DATA_TYPES_OK)
+        {
+            /*Codes_SRS_AGGREGATEDDATA_41_014: [ If any conversion fails, AggregatedData_ToAGENT_DATA_TYPE shall fail and return AGENT_DATA_TYPES_ERROR. ]*/
+            LogError("failure in Create_AGENT_DATA_TYPE_from_Members");
+            result = AGENT_DATA_TYPES_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_AGGREGATEDDATA_41_015: [ On success AggregatedData_ToAGENT_DATA_TYPE shall return AGENT_DATA_TYPES_OK. ]*/
+            result = AGENT_DATA_TYPES_OK;
+        }
+
+        /*Codes_SRS_AGGREGATEDDATA_41_016: [ AggregatedData_ToAGENT_DATA_TYPE shall destroy the member values it created. ]*/
+        while (created > 0)
+        {
+            created--;
+            Destroy_AGENT_DATA_TYPE(&members[created]);
+        }
+    }
+    return result;
+}
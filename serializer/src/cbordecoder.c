@@ -0,0 +1,575 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "cbordecoder.h"
+#include "agenttypesystem.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
+DEFINE_ENUM_STRINGS(CBOR_DECODER_RESULT, CBOR_DECODER_RESULT_VALUES);
+
+#define CBOR_MAJOR_UNSIGNED_INTEGER 0
+#define CBOR_MAJOR_NEGATIVE_INTEGER 1
+#define CBOR_MAJOR_BYTE_STRING      2
+#define CBOR_MAJOR_TEXT_STRING      3
+#define CBOR_MAJOR_ARRAY            4
+#define CBOR_MAJOR_MAP              5
+#define CBOR_MAJOR_TAG              6
+#define CBOR_MAJOR_SIMPLE           7
+
+#define CBOR_SIMPLE_FALSE     20
+#define CBOR_SIMPLE_TRUE      21
+#define CBOR_SIMPLE_NULL      22
+#define CBOR_SIMPLE_UNDEFINED 23
+#define CBOR_SIMPLE_FLOAT16   25
+#define CBOR_SIMPLE_FLOAT32   26
+#define CBOR_SIMPLE_FLOAT64   27
+
+#define CBOR_TAG_UUID 37
+#define CBOR_UUID_SIZE 16
+
+/*arrays, maps and tags are decoded recursively, this bounds the stack used by a hostile input*/
+#define CBOR_DECODER_MAX_DEPTH 32
+
+/*the same spellings AgentDataTypes_ToString uses*/
+#define NaN_STRING "NaN"
+#define MINUSINF_STRING "-INF"
+#define PLUSINF_STRING "INF"
+
+typedef struct CBOR_DECODER_READER_TAG
+{
+    const unsigned char* data;
+    size_t size;
+    size_t position;
+} CBOR_DECODER_READER;
+
+/*a growable output buffer for the JSON*/
+typedef struct CBOR_DECODER_SINK_TAG
+{
+    char* buffer;
+    size_t size;
+    size_t capacity;
+} CBOR_DECODER_SINK;
+
+#define CBOR_DECODER_SINK_INITIAL_CAPACITY 64
+
+static const char base64urlCharacters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+static const char hexCharacters[] = "0123456789ABCDEF";
+
+static int Sink_Write(CBOR_DECODER_SINK* sink, const char* source, size_t length)
+{
+    int result;
+    if (length > sink->capacity - sink->size)
+    {
+        size_t newCapacity = (sink->capacity == 0) ? CBOR_DECODER_SINK_INITIAL_CAPACITY : sink->capacity;
+        char* newBuffer;
+        while (newCapacity - sink->size < length)
+        {
+            newCapacity *= 2;
+        }
+
+        if ((newBuffer = (char*)realloc(sink->buffer, newCapacity)) == NULL)
+        {
+            LogError("failure reallocating %lu bytes for the JSON", (unsigned long)newCapacity);
+            result = __FAILURE__;
+        }
+        else
+        {
+            sink->buffer = newBuffer;
+            sink->capacity = newCapacity;
+            result = 0;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if ((result == 0) && (length > 0))
+    {
+        (void)memcpy(sink->buffer + sink->size, source, length);
+        sink->size += length;
+    }
+    return result;
+}
+
+#define Sink_WriteLiteral(sink, literal) Sink_Write((sink), (literal), sizeof(literal) - 1)
+
+static int Sink_WriteUInt64(CBOR_DECODER_SINK* sink, uint64_t value)
+{
+    char digits[20];
+    size_t length = 0;
+    do
+    {
+        digits[sizeof(digits) - 1 - length] = (char)('0' + (value % 10));
+        value /= 10;
+        length++;
+    } while (value != 0);
+    return Sink_Write(sink, digits + sizeof(digits) - length, length);
+}
+
+/*Codes_SRS_CBOR_DECODER_41_007: [ Floating point values shall be written with the fewest digits that read back to the same value; NaN and infinities shall be written as NaN, INF and -INF. ]*/
+static int Sink_WriteDouble(CBOR_DECODER_SINK* sink, double value, int isSingle)
+{
+    int result;
+    if (ISNAN(value))
+    {
+        result = Sink_WriteLiteral(sink, NaN_STRING);
+    }
+    else if (ISNEGATIVEINFINITY(value))
+    {
+        result = Sink_WriteLiteral(sink, MINUSINF_STRING);
+    }
+    else if (ISPOSITIVEINFINITY(value))
+    {
+        result = Sink_WriteLiteral(sink, PLUSINF_STRING);
+    }
+    else
+    {
+        char text[32];
+        int maxPrecision = isSingle ? 9 : 17;
+        int precision;
+        int length = -1;
+        for (precision = 1; precision <= maxPrecision; precision++)
+        {
+            double readBack;
+            length = sprintf_s(text, sizeof(text), "%.*g", precision, value);
+            readBack = strtod(text, NULL);
+            if ((length > 0) &&
+                (isSingle ? ((float)readBack == (float)value) : (readBack == value)))
+            {
+                break;
+            }
+        }
+        result = (length <= 0) ? __FAILURE__ : Sink_Write(sink, text, (size_t)length);
+    }
+    return result;
+}
+
+/*Codes_SRS_CBOR_DECODER_41_005: [ Text strings shall be written as JSON strings, escaping quotes, backslashes and control characters. ]*/
+static int Sink_WriteJSONString(CBOR_DECODER_SINK* sink, const unsigned char* text, size_t length)
+{
+    int result = Sink_WriteLiteral(sink, "\"");
+    size_t runStart = 0;
+    size_t i;
+    for (i = 0; (i < length) && (result == 0); i++)
+    {
+        if ((text[i] < 0x20) || (text[i] == '"') || (text[i] == '\\'))
+        {
+            char escape[6] = { '\\', 'u', '0', '0', 0, 0 };
+            size_t escapeLength;
+            switch (text[i])
+            {
+                case '"': escape[1] = '"'; escapeLength = 2; break;
+                case '\\': escape[1] = '\\'; escapeLength = 2; break;
+                case '\b': escape[1] = 'b'; escapeLength = 2; break;
+                case '\f': escape[1] = 'f'; escapeLength = 2; break;
+                case '\n': escape[1] = 'n'; escapeLength = 2; break;
+                case '\r': escape[1] = 'r'; escapeLength = 2; break;
+                case '\t': escape[1] = 't'; escapeLength = 2; break;
+                default:
+                    escape[4] = hexCharacters[text[i] >> 4];
+                    escape[5] = hexCharacters[text[i] & 0x0F];
+                    escapeLength = 6;
+                    break;
+            }
+
+            if ((Sink_Write(sink, (const char*)text + runStart, i - runStart) != 0) ||
+                (Sink_Write(sink, escape, escapeLength) != 0))
+            {
+                result = __FAILURE__;
+            }
+            runStart = i + 1;
+        }
+    }
+
+    if ((result == 0) &&
+        ((Sink_Write(sink, (const char*)text + runStart, length - runStart) != 0) ||
+        (Sink_WriteLiteral(sink, "\"") != 0)))
+    {
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+/*Codes_SRS_CBOR_DECODER_41_006: [ Byte strings shall be written as JSON strings holding their base64url encoding with padding, which is the form AgentDataTypes uses for EDM_BINARY. ]*/
+static int Sink_WriteBase64url(CBOR_DECODER_SINK* sink, const unsigned char* bytes, size_t length)
+{
+    int result = Sink_WriteLiteral(sink, "\"");
+    size_t i;
+    for (i = 0; (i < length) && (result == 0); i += 3)
+    {
+        char group[4];
+        uint32_t bits = (uint32_t)bytes[i] << 16;
+        if (i + 1 < length)
+        {
+            bits |= (uint32_t)bytes[i + 1] << 8;
+        }
+        if (i + 2 < length)
+        {
+            bits |= bytes[i + 2];
+        }
+        group[0] = base64urlCharacters[(bits >> 18) & 0x3F];
+        group[1] = base64urlCharacters[(bits >> 12) & 0x3F];
+        group[2] = (i + 1 < length) ? base64urlCharacters[(bits >> 6) & 0x3F] : '=';
+        group[3] = (i + 2 < length) ? base64urlCharacters[bits & 0x3F] : '=';
+        result = Sink_Write(sink, group, sizeof(group));
+    }
+
+    if (result == 0)
+    {
+        result = Sink_WriteLiteral(sink, "\"");
+    }
+    return result;
+}
+
+/*8HEXDIG "-" 4HEXDIG "-" 4HEXDIG "-" 4HEXDIG "-" 12HEXDIG, the EDM_GUID form of AgentDataTypes*/
+static int Sink_WriteGuid(CBOR_DECODER_SINK* sink, const unsigned char* bytes)
+{
+    char text[1 + 36 + 1];
+    size_t position = 0;
+    size_t i;
+    text[position++] = '"';
+    for (i = 0; i < CBOR_UUID_SIZE; i++)
+    {
+        if ((i == 4) || (i == 6) || (i == 8) || (i == 10))
+        {
+            text[position++] = '-';
+        }
+        text[position++] = hexCharacters[bytes[i] >> 4];
+        text[position++] = hexCharacters[bytes[i] & 0x0F];
+    }
+    text[position++] = '"';
+    return Sink_Write(sink, text, position);
+}
+
+static int Reader_ReadBigEndian(CBOR_DECODER_READER* reader, size_t byteCount, uint64_t* value)
+{
+    int result;
+    if (reader->size - reader->position < byteCount)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+        *value = 0;
+        for (i = 0; i < byteCount; i++)
+        {
+            *value = (*value << 8) | reader->data[reader->position++];
+        }
+        result = 0;
+    }
+    return result;
+}
+
+/*Codes_SRS_CBOR_DECODER_41_009: [ Indefinite length items and reserved additional information values shall be reported as CBOR_DECODER_PARSE_ERROR. ]*/
+static int Reader_ReadHead(CBOR_DECODER_READER* reader, unsigned char* majorType, unsigned char* additionalInformation, uint64_t* argument)
+{
+    int result;
+    if (reader->position >= reader->size)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        unsigned char initialByte = reader->data[reader->position++];
+        *majorType = (unsigned char)(initialByte >> 5);
+        *additionalInformation = (unsigned char)(initialByte & 0x1F);
+        if (*additionalInformation < 24)
+        {
+            *argument = *additionalInformation;
+            result = 0;
+        }
+        else if (*additionalInformation <= 27)
+        {
+            result = Reader_ReadBigEndian(reader, (size_t)1 << (*additionalInformation - 24), argument);
+        }
+        else
+        {
+            result = __FAILURE__;
+        }
+    }
+    return result;
+}
+
+static int Reader_HasBytes(const CBOR_DECODER_READER* reader, uint64_t length)
+{
+    return (length <= (uint64_t)(reader->size - reader->position));
+}
+
+static CBOR_DECODER_RESULT DecodeItem(CBOR_DECODER_READER* reader, CBOR_DECODER_SINK* sink, size_t depth);
+
+static CBOR_DECODER_RESULT DecodeSimpleOrFloat(CBOR_DECODER_READER* reader, CBOR_DECODER_SINK* sink, unsigned char additionalInformation, uint64_t argument)
+{
+    CBOR_DECODER_RESULT result;
+    int writeResult;
+    (void)reader;
+    switch (additionalInformation)
+    {
+        /*Codes_SRS_CBOR_DECODER_41_008: [ false, true, null and undefined shall be written as false, true, null and null. ]*/
+        case CBOR_SIMPLE_FALSE:
+            writeResult = Sink_WriteLiteral(sink, "false");
+            break;
+        case CBOR_SIMPLE_TRUE:
+            writeResult = Sink_WriteLiteral(sink, "true");
+            break;
+        case CBOR_SIMPLE_NULL:
+        case CBOR_SIMPLE_UNDEFINED:
+            writeResult = Sink_WriteLiteral(sink, "null");
+            break;
+        case CBOR_SIMPLE_FLOAT16:
+        {
+            /*half precision: 1 sign bit, 5 exponent bits, 10 mantissa bits*/
+            unsigned int exponent = (unsigned int)((argument >> 10) & 0x1F);
+            unsigned int mantissa = (unsigned int)(argument & 0x3FF);
+            double value;
+            if (exponent == 0x1F)
+            {
+                value = (mantissa != 0) ? strtod(NaN_STRING, NULL) : HUGE_VAL;
+            }
+            else if (exponent == 0)
+            {
+                value = ldexp((double)mantissa, -24);
+            }
+            else
+            {
+                value = ldexp((double)(mantissa + 0x400), (int)exponent - 25);
+            }
+            writeResult = Sink_WriteDouble(sink, ((argument & 0x8000) != 0) ? -value : value, 1);
+            break;
+        }
+        case CBOR_SIMPLE_FLOAT32:
+        {
+            uint32_t bits = (uint32_t)argument;
+            float value;
+            (void)memcpy(&value, &bits, sizeof(value));
+            writeResult = Sink_WriteDouble(sink, value, 1);
+            break;
+        }
+        case CBOR_SIMPLE_FLOAT64:
+        {
+            double value;
+            (void)memcpy(&value, &argument, sizeof(value));
+            writeResult = Sink_WriteDouble(sink, value, 0);
+            break;
+        }
+        default:
+            LogError("unsupported CBOR simple value %u", (unsigned int)additionalInformation);
+            writeResult = -1;
+            break;
+    }
+
+    if (writeResult == -1)
+    {
+        result = CBOR_DECODER_PARSE_ERROR;
+    }
+    else if (writeResult != 0)
+    {
+        result = CBOR_DECODER_ERROR;
+    }
+    else
+    {
+        result = CBOR_DECODER_OK;
+    }
+    return result;
+}
+
+static CBOR_DECODER_RESULT DecodeItem(CBOR_DECODER_READER* reader, CBOR_DECODER_SINK* sink, size_t depth)
+{
+    CBOR_DECODER_RESULT result;
+    unsigned char majorType;
+    unsigned char additionalInformation;
+    uint64_t argument;
+
+    if (depth > CBOR_DECODER_MAX_DEPTH)
+    {
+        LogError("CBOR nested deeper than %d levels", CBOR_DECODER_MAX_DEPTH);
+        result = CBOR_DECODER_PARSE_ERROR;
+    }
+    else if (Reader_ReadHead(reader, &majorType, &additionalInformation, &argument) != 0)
+    {
+        LogError("truncated or indefinite length CBOR item at offset %lu", (unsigned long)reader->position);
+        result = CBOR_DECODER_PARSE_ERROR;
+    }
+    else
+    {
+        switch (majorType)
+        {
+            /*Codes_SRS_CBOR_DECODER_41_004: [ Unsigned and negative integers shall be written as JSON numbers. ]*/
+            case CBOR_MAJOR_UNSIGNED_INTEGER:
+                result = (Sink_WriteUInt64(sink, argument) != 0) ? CBOR_DECODER_ERROR : CBOR_DECODER_OK;
+                break;
+            case CBOR_MAJOR_NEGATIVE_INTEGER:
+                /*the value is -1 - argument*/
+                if (argument == UINT64_MAX)
+                {
+                    result = (Sink_WriteLiteral(sink, "-18446744073709551616") != 0) ? CBOR_DECODER_ERROR : CBOR_DECODER_OK;
+                }
+                else
+                {
+                    result = ((Sink_WriteLiteral(sink, "-") != 0) || (Sink_WriteUInt64(sink, argument + 1) != 0)) ? CBOR_DECODER_ERROR : CBOR_DECODER_OK;
+                }
+                break;
+            case CBOR_MAJOR_BYTE_STRING:
+            case CBOR_MAJOR_TEXT_STRING:
+                if (!Reader_HasBytes(reader, argument))
+                {
+                    LogError("truncated CBOR string at offset %lu", (unsigned long)reader->position);
+                    result = CBOR_DECODER_PARSE_ERROR;
+                }
+                else
+                {
+                    const unsigned char* bytes = reader->data + reader->position;
+                    reader->position += (size_t)argument;
+                    result = (((majorType == CBOR_MAJOR_BYTE_STRING) ? Sink_WriteBase64url(sink, bytes, (size_t)argument) : Sink_WriteJSONString(sink, bytes, (size_t)argument)) != 0) ?
+                        CBOR_DECODER_ERROR : CBOR_DECODER_OK;
+                }
+                break;
+            /*Codes_SRS_CBOR_DECODER_41_003: [ Arrays shall be written as JSON arrays and maps as JSON objects; map keys that are not text strings shall be reported as CBOR_DECODER_PARSE_ERROR. ]*/
+            case CBOR_MAJOR_ARRAY:
+            case CBOR_MAJOR_MAP:
+            {
+                uint64_t i;
+                /*every element takes at least one byte, this rejects absurd counts before anything is written*/
+                if (!Reader_HasBytes(reader, argument))
+                {
+                    LogError("truncated CBOR container at offset %lu", (unsigned long)reader->position);
+                    result = CBOR_DECODER_PARSE_ERROR;
+                }
+                else if (((majorType == CBOR_MAJOR_ARRAY) ? Sink_WriteLiteral(sink, "[") : Sink_WriteLiteral(sink, "{")) != 0)
+                {
+                    result = CBOR_DECODER_ERROR;
+                }
+                else
+                {
+                    result = CBOR_DECODER_OK;
+                    for (i = 0; (i < argument) && (result == CBOR_DECODER_OK); i++)
+                    {
+                        if ((i > 0) && (Sink_WriteLiteral(sink, ",") != 0))
+                        {
+                            result = CBOR_DECODER_ERROR;
+                        }
+                        else if (majorType == CBOR_MAJOR_MAP)
+                        {
+                            if ((reader->position >= reader->size) || ((reader->data[reader->position] >> 5) != CBOR_MAJOR_TEXT_STRING))
+                            {
+                                LogError("CBOR map key at offset %lu is not a text string", (unsigned long)reader->position);
+                                result = CBOR_DECODER_PARSE_ERROR;
+                            }
+                            else if ((result = DecodeItem(reader, sink, depth + 1)) != CBOR_DECODER_OK)
+                            {
+                                /*result has been set*/
+                            }
+                            else if (Sink_WriteLiteral(sink, ":") != 0)
+                            {
+                                result = CBOR_DECODER_ERROR;
+                            }
+                            else
+                            {
+                                result = DecodeItem(reader, sink, depth + 1);
+                            }
+                        }
+                        else
+                        {
+                            result = DecodeItem(reader, sink, depth + 1);
+                        }
+                    }
+
+                    if ((result == CBOR_DECODER_OK) &&
+                        (((majorType == CBOR_MAJOR_ARRAY) ? Sink_WriteLiteral(sink, "]") : Sink_WriteLiteral(sink, "}")) != 0))
+                    {
+                        result = CBOR_DECODER_ERROR;
+                    }
+                }
+                break;
+            }
+            case CBOR_MAJOR_TAG:
+                /*Codes_SRS_CBOR_DECODER_41_010: [ A byte string of 16 bytes tagged 37 shall be written as a GUID in the EDM_GUID form; the tags of any other item shall be ignored. ]*/
+                if ((argument == CBOR_TAG_UUID) &&
+                    (reader->size - reader->position >= 1 + CBOR_UUID_SIZE) &&
+                    (reader->data[reader->position] == ((CBOR_MAJOR_BYTE_STRING << 5) | CBOR_UUID_SIZE)))
+                {
+                    result = (Sink_WriteGuid(sink, reader->data + reader->position + 1) != 0) ? CBOR_DECODER_ERROR : CBOR_DECODER_OK;
+                    reader->position += 1 + CBOR_UUID_SIZE;
+                }
+                else
+                {
+                    result = DecodeItem(reader, sink, depth + 1);
+                }
+                break;
+            default: /*CBOR_MAJOR_SIMPLE*/
+                result = DecodeSimpleOrFloat(reader, sink, additionalInformation, argument);
+                break;
+        }
+    }
+
+    return result;
+}
+
+CBOR_DECODER_RESULT CBORDecoder_CBOR_To_JSON(const unsigned char* cbor, size_t cborSize, char** json)
+{
+    CBOR_DECODER_RESULT result;
+
+    /*Codes_SRS_CBOR_DECODER_41_001: [ If cbor or json is NULL, or cborSize is 0, then CBORDecoder_CBOR_To_JSON shall return CBOR_DECODER_INVALID_ARG. ]*/
+    if ((cbor == NULL) ||
+        (cborSize == 0) ||
+        (json == NULL))
+    {
+        result = CBOR_DECODER_INVALID_ARG;
+        LogError("(result = %s)", ENUM_TO_STRING(CBOR_DECODER_RESULT, result));
+    }
+    else
+    {
+        CBOR_DECODER_READER reader;
+        CBOR_DECODER_SINK sink;
+        reader.data = cbor;
+        reader.size = cborSize;
+        reader.position = 0;
+        sink.buffer = NULL;
+        sink.size = 0;
+        sink.capacity = 0;
+
+        /*Codes_SRS_CBOR_DECODER_41_002: [ CBORDecoder_CBOR_To_JSON shall convert the CBOR data item in cbor to JSON text. ]*/
+        if ((result = DecodeItem(&reader, &sink, 0)) != CBOR_DECODER_OK)
+        {
+            LogError("(result = %s)", ENUM_TO_STRING(CBOR_DECODER_RESULT, result));
+        }
+        /*Codes_SRS_CBOR_DECODER_41_011: [ If bytes follow the data item, CBORDecoder_CBOR_To_JSON shall return CBOR_DECODER_PARSE_ERROR. ]*/
+        else if (reader.position != reader.size)
+        {
+            result = CBOR_DECODER_PARSE_ERROR;
+            LogError("%lu bytes after the CBOR data item", (unsigned long)(reader.size - reader.position));
+        }
+        else if (Sink_Write(&sink, "", 1) != 0)
+        {
+            result = CBOR_DECODER_ERROR;
+            LogError("(result = %s)", ENUM_TO_STRING(CBOR_DECODER_RESULT, result));
+        }
+
+        if (result != CBOR_DECODER_OK)
+        {
+            /*Codes_SRS_CBOR_DECODER_41_013: [ If any failure occurs, CBORDecoder_CBOR_To_JSON shall free the JSON it produced so far and return the error. ]*/
+            free(sink.buffer);
+        }
+        else
+        {
+            /*Codes_SRS_CBOR_DECODER_41_012: [ On success, CBORDecoder_CBOR_To_JSON shall return the null terminated JSON in *json and CBOR_DECODER_OK. ]*/
+            *json = sink.buffer;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,506 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "cborencoder.h"
+#include "agenttypesystem.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/strings.h"
+
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
+DEFINE_ENUM_STRINGS(CBOR_ENCODER_RESULT, CBOR_ENCODER_RESULT_VALUES);
+
+#define CBOR_MAJOR_UNSIGNED_INTEGER 0
+#define CBOR_MAJOR_NEGATIVE_INTEGER 1
+#define CBOR_MAJOR_BYTE_STRING      2
+#define CBOR_MAJOR_TEXT_STRING      3
+#define CBOR_MAJOR_ARRAY            4
+#define CBOR_MAJOR_MAP              5
+#define CBOR_MAJOR_TAG              6
+
+#define CBOR_FALSE    0xF4
+#define CBOR_TRUE     0xF5
+#define CBOR_NULL     0xF6
+#define CBOR_FLOAT32  0xFA
+#define CBOR_FLOAT64  0xFB
+
+#define CBOR_TAG_DATE_TIME_STRING 0
+#define CBOR_TAG_UUID             37
+
+/*same growable buffer as the one of JSONEncoder_EncodeTree_ToBuffer*/
+typedef struct CBOR_ENCODER_SINK_TAG
+{
+    unsigned char* buffer;
+    size_t size;
+    size_t capacity;
+    STRING_HANDLE scratch; /*reused for every name and for the values that are written as text*/
+} CBOR_ENCODER_SINK;
+
+#define CBOR_ENCODER_SINK_INITIAL_CAPACITY 64
+
+static int Sink_Write(CBOR_ENCODER_SINK* sink, const void* source, size_t length)
+{
+    int result;
+    if (length > sink->capacity - sink->size)
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_003: [ The output buffer shall grow by doubling its capacity. ]*/
+        size_t newCapacity = (sink->capacity == 0) ? CBOR_ENCODER_SINK_INITIAL_CAPACITY : sink->capacity;
+        unsigned char* newBuffer;
+        while (newCapacity - sink->size < length)
+        {
+            newCapacity *= 2;
+        }
+
+        if ((newBuffer = (unsigned char*)realloc(sink->buffer, newCapacity)) == NULL)
+        {
+            LogError("failure reallocating %lu bytes for the CBOR", (unsigned long)newCapacity);
+            result = __FAILURE__;
+        }
+        else
+        {
+            sink->buffer = newBuffer;
+            sink->capacity = newCapacity;
+            result = 0;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if ((result == 0) && (length > 0))
+    {
+        (void)memcpy(sink->buffer + sink->size, source, length);
+        sink->size += length;
+    }
+    return result;
+}
+
+static int Sink_WriteByte(CBOR_ENCODER_SINK* sink, unsigned char value)
+{
+    return Sink_Write(sink, &value, 1);
+}
+
+/*writes value in big endian order on byteCount bytes*/
+static int Sink_WriteBigEndian(CBOR_ENCODER_SINK* sink, uint64_t value, size_t byteCount)
+{
+    unsigned char bytes[8];
+    size_t i;
+    for (i = 0; i < byteCount; i++)
+    {
+        bytes[byteCount - 1 - i] = (unsigned char)(value >> (8 * i));
+    }
+    return Sink_Write(sink, bytes, byteCount);
+}
+
+/*Codes_SRS_CBOR_ENCODER_41_006: [ Integers, lengths, counts and tags shall be written in the shortest form RFC 7049 allows. ]*/
+static int Sink_WriteHead(CBOR_ENCODER_SINK* sink, unsigned char majorType, uint64_t value)
+{
+    int result;
+    unsigned char initialByte = (unsigned char)(majorType << 5);
+    if (value < 24)
+    {
+        result = Sink_WriteByte(sink, (unsigned char)(initialByte | value));
+    }
+    else if (value <= UINT8_MAX)
+    {
+        result = ((Sink_WriteByte(sink, initialByte | 24) != 0) || (Sink_WriteBigEndian(sink, value, 1) != 0)) ? __FAILURE__ : 0;
+    }
+    else if (value <= UINT16_MAX)
+    {
+        result = ((Sink_WriteByte(sink, initialByte | 25) != 0) || (Sink_WriteBigEndian(sink, value, 2) != 0)) ? __FAILURE__ : 0;
+    }
+    else if (value <= UINT32_MAX)
+    {
+        result = ((Sink_WriteByte(sink, initialByte | 26) != 0) || (Sink_WriteBigEndian(sink, value, 4) != 0)) ? __FAILURE__ : 0;
+    }
+    else
+    {
+        result = ((Sink_WriteByte(sink, initialByte | 27) != 0) || (Sink_WriteBigEndian(sink, value, 8) != 0)) ? __FAILURE__ : 0;
+    }
+    return result;
+}
+
+static int Sink_WriteInteger(CBOR_ENCODER_SINK* sink, int64_t value)
+{
+    /*a negative integer n is written as -1 - n, which cannot overflow for INT64_MIN*/
+    return (value < 0) ?
+        Sink_WriteHead(sink, CBOR_MAJOR_NEGATIVE_INTEGER, (uint64_t)(-(value + 1))) :
+        Sink_WriteHead(sink, CBOR_MAJOR_UNSIGNED_INTEGER, (uint64_t)value);
+}
+
+static int Sink_WriteString(CBOR_ENCODER_SINK* sink, unsigned char majorType, const void* source, size_t length)
+{
+    return ((Sink_WriteHead(sink, majorType, length) != 0) || (Sink_Write(sink, source, length) != 0)) ? __FAILURE__ : 0;
+}
+
+/*the text of value as AgentDataTypes_ToString produces it, without the enclosing quotes*/
+static CBOR_ENCODER_RESULT Sink_WriteValueAsText(CBOR_ENCODER_SINK* sink, const AGENT_DATA_TYPE* value)
+{
+    CBOR_ENCODER_RESULT result;
+    if ((STRING_empty(sink->scratch) != 0) ||
+        (AgentDataTypes_ToString(sink->scratch, value) != AGENT_DATA_TYPES_OK))
+    {
+        result = CBOR_ENCODER_TOSTRING_FUNCTION_ERROR;
+        LogError("(result = %s)", ENUM_TO_STRING(CBOR_ENCODER_RESULT, result));
+    }
+    else
+    {
+        const char* text = STRING_c_str(sink->scratch);
+        size_t length = STRING_length(sink->scratch);
+        if ((length >= 2) && (text[0] == '"') && (text[length - 1] == '"'))
+        {
+            text++;
+            length -= 2;
+        }
+
+        if (Sink_WriteString(sink, CBOR_MAJOR_TEXT_STRING, text, length) != 0)
+        {
+            result = CBOR_ENCODER_ERROR;
+            LogError("(result = %s)", ENUM_TO_STRING(CBOR_ENCODER_RESULT, result));
+        }
+        else
+        {
+            result = CBOR_ENCODER_OK;
+        }
+    }
+    return result;
+}
+
+/*the loops are one per type of element, so that the element conversion is known to the compiler*/
+#define SINK_WRITE_ELEMENTS(elementCType, writeElement) \
+    for (i = 0; (i < array->count) && (result == 0); i++) \
+    { \
+        result = writeElement(sink, ((const elementCType*)array->values)[i]); \
+    }
+
+#define SINK_WRITE_BOOLEAN_ELEMENT(sink, value) Sink_WriteByte(sink, (value) ? CBOR_TRUE : CBOR_FALSE)
+#define SINK_WRITE_INTEGER_ELEMENT(sink, value) Sink_WriteInteger(sink, (int64_t)(value))
+
+#ifndef NO_FLOATS
+static int Sink_WriteFloat32(CBOR_ENCODER_SINK* sink, float value)
+{
+    uint32_t bits;
+    (void)memcpy(&bits, &value, sizeof(bits));
+    return ((Sink_WriteByte(sink, CBOR_FLOAT32) != 0) || (Sink_WriteBigEndian(sink, bits, 4) != 0)) ? __FAILURE__ : 0;
+}
+
+static int Sink_WriteFloat64(CBOR_ENCODER_SINK* sink, double value)
+{
+    uint64_t bits;
+    (void)memcpy(&bits, &value, sizeof(bits));
+    return ((Sink_WriteByte(sink, CBOR_FLOAT64) != 0) || (Sink_WriteBigEndian(sink, bits, 8) != 0)) ? __FAILURE__ : 0;
+}
+#endif
+
+static int Sink_WriteArray(CBOR_ENCODER_SINK* sink, const EDM_ARRAY* array)
+{
+    int result;
+    size_t i;
+
+    if (Sink_WriteHead(sink, CBOR_MAJOR_ARRAY, array->count) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+        switch (array->elementType)
+        {
+            case EDM_BOOLEAN_TYPE:
+                if (array->elementSize != sizeof(bool))
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    SINK_WRITE_ELEMENTS(bool, SINK_WRITE_BOOLEAN_ELEMENT);
+                }
+                break;
+            case EDM_BYTE_TYPE:
+                if (array->elementSize != sizeof(uint8_t))
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    SINK_WRITE_ELEMENTS(uint8_t, SINK_WRITE_INTEGER_ELEMENT);
+                }
+                break;
+            case EDM_SBYTE_TYPE:
+            case EDM_INT16_TYPE:
+            case EDM_INT32_TYPE:
+            case EDM_INT64_TYPE:
+                if (array->elementSize == sizeof(int8_t))
+                {
+                    SINK_WRITE_ELEMENTS(int8_t, SINK_WRITE_INTEGER_ELEMENT);
+                }
+                else if (array->elementSize == sizeof(int16_t))
+                {
+                    SINK_WRITE_ELEMENTS(int16_t, SINK_WRITE_INTEGER_ELEMENT);
+                }
+                else if (array->elementSize == sizeof(int32_t))
+                {
+                    SINK_WRITE_ELEMENTS(int32_t, SINK_WRITE_INTEGER_ELEMENT);
+                }
+                else if (array->elementSize == sizeof(int64_t))
+                {
+                    SINK_WRITE_ELEMENTS(int64_t, SINK_WRITE_INTEGER_ELEMENT);
+                }
+                else
+                {
+                    result = __FAILURE__;
+                }
+                break;
+#ifndef NO_FLOATS
+            case EDM_SINGLE_TYPE:
+                if (array->elementSize != sizeof(float))
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    SINK_WRITE_ELEMENTS(float, Sink_WriteFloat32);
+                }
+                break;
+            case EDM_DOUBLE_TYPE:
+                if (array->elementSize != sizeof(double))
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    SINK_WRITE_ELEMENTS(double, Sink_WriteFloat64);
+                }
+                break;
+#endif
+            default:
+                result = __FAILURE__;
+                break;
+        }
+    }
+
+    return result;
+}
+
+static CBOR_ENCODER_RESULT EncodeValueToSink(const AGENT_DATA_TYPE* value, CBOR_ENCODER_SINK* sink)
+{
+    CBOR_ENCODER_RESULT result;
+    int writeResult;
+
+    /*Codes_SRS_CBOR_ENCODER_41_007: [ The leaf values shall be encoded by their AGENT_DATA_TYPE type: ]*/
+    switch (value->type)
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_008: [ EDM_BOOLEAN_TYPE shall be encoded as true or false. ]*/
+        case EDM_BOOLEAN_TYPE:
+            writeResult = Sink_WriteByte(sink, (value->value.edmBoolean.value == EDM_TRUE) ? CBOR_TRUE : CBOR_FALSE);
+            break;
+        /*Codes_SRS_CBOR_ENCODER_41_009: [ EDM_BYTE_TYPE, EDM_SBYTE_TYPE, EDM_INT16_TYPE, EDM_INT32_TYPE and EDM_INT64_TYPE shall be encoded as integers. ]*/
+        case EDM_BYTE_TYPE:
+            writeResult = Sink_WriteInteger(sink, value->value.edmByte.value);
+            break;
+        case EDM_SBYTE_TYPE:
+            writeResult = Sink_WriteInteger(sink, value->value.edmSbyte.value);
+            break;
+        case EDM_INT16_TYPE:
+            writeResult = Sink_WriteInteger(sink, value->value.edmInt16.value);
+            break;
+        case EDM_INT32_TYPE:
+            writeResult = Sink_WriteInteger(sink, value->value.edmInt32.value);
+            break;
+        case EDM_INT64_TYPE:
+            writeResult = Sink_WriteInteger(sink, value->value.edmInt64.value);
+            break;
+#ifndef NO_FLOATS
+        /*Codes_SRS_CBOR_ENCODER_41_010: [ EDM_SINGLE_TYPE shall be encoded as a single precision float and EDM_DOUBLE_TYPE as a double precision float. ]*/
+        case EDM_SINGLE_TYPE:
+            writeResult = Sink_WriteFloat32(sink, value->value.edmSingle.value);
+            break;
+        case EDM_DOUBLE_TYPE:
+            writeResult = Sink_WriteFloat64(sink, value->value.edmDouble.value);
+            break;
+#endif
+        /*Codes_SRS_CBOR_ENCODER_41_011: [ EDM_STRING_TYPE and EDM_STRING_NO_QUOTES_TYPE shall be encoded as text strings. ]*/
+        case EDM_STRING_TYPE:
+            writeResult = Sink_WriteString(sink, CBOR_MAJOR_TEXT_STRING, value->value.edmString.chars, value->value.edmString.length);
+            break;
+        case EDM_STRING_NO_QUOTES_TYPE:
+            writeResult = Sink_WriteString(sink, CBOR_MAJOR_TEXT_STRING, value->value.edmStringNoQuotes.chars, value->value.edmStringNoQuotes.length);
+            break;
+        /*Codes_SRS_CBOR_ENCODER_41_012: [ EDM_BINARY_TYPE shall be encoded as a byte string. ]*/
+        case EDM_BINARY_TYPE:
+            writeResult = Sink_WriteString(sink, CBOR_MAJOR_BYTE_STRING, value->value.edmBinary.data, value->value.edmBinary.size);
+            break;
+        /*Codes_SRS_CBOR_ENCODER_41_013: [ EDM_GUID_TYPE shall be encoded as a 16 bytes byte string tagged 37. ]*/
+        case EDM_GUID_TYPE:
+            writeResult = ((Sink_WriteHead(sink, CBOR_MAJOR_TAG, CBOR_TAG_UUID) != 0) ||
+                (Sink_WriteString(sink, CBOR_MAJOR_BYTE_STRING, value->value.edmGuid.GUID, sizeof(value->value.edmGuid.GUID)) != 0)) ? __FAILURE__ : 0;
+            break;
+        /*Codes_SRS_CBOR_ENCODER_41_014: [ EDM_NULL_TYPE shall be encoded as null. ]*/
+        case EDM_NULL_TYPE:
+            writeResult = Sink_WriteByte(sink, CBOR_NULL);
+            break;
+        /*Codes_SRS_CBOR_ENCODER_41_015: [ EDM_COMPLEX_TYPE_TYPE shall be encoded as a map from the names of the fields to their values. ]*/
+        case EDM_COMPLEX_TYPE_TYPE:
+        {
+            size_t i;
+            writeResult = Sink_WriteHead(sink, CBOR_MAJOR_MAP, value->value.edmComplexType.nMembers);
+            for (i = 0; (i < value->value.edmComplexType.nMembers) && (writeResult == 0); i++)
+            {
+                const COMPLEX_TYPE_FIELD_TYPE* field = &value->value.edmComplexType.fields[i];
+                if (Sink_WriteString(sink, CBOR_MAJOR_TEXT_STRING, field->fieldName, strlen(field->fieldName)) != 0)
+                {
+                    writeResult = __FAILURE__;
+                }
+                else if (EncodeValueToSink(field->value, sink) != CBOR_ENCODER_OK)
+                {
+                    writeResult = __FAILURE__;
+                }
+            }
+            break;
+        }
+        /*Codes_SRS_CBOR_ENCODER_41_019: [ EDM_ARRAY_TYPE shall be encoded as an array of its values, each encoded as a value of its element type. ]*/
+        case EDM_ARRAY_TYPE:
+            writeResult = Sink_WriteArray(sink, &value->value.edmArray);
+            break;
+        /*Codes_SRS_CBOR_ENCODER_41_016: [ EDM_DATE_TIME_OFFSET_TYPE shall be encoded as the text AgentDataTypes_ToString produces, tagged 0. ]*/
+        case EDM_DATE_TIME_OFFSET_TYPE:
+            writeResult = ((Sink_WriteHead(sink, CBOR_MAJOR_TAG, CBOR_TAG_DATE_TIME_STRING) != 0) ||
+                (Sink_WriteValueAsText(sink, value) != CBOR_ENCODER_OK)) ? __FAILURE__ : 0;
+            break;
+        /*Codes_SRS_CBOR_ENCODER_41_017: [ Values of any other type shall be encoded as the text AgentDataTypes_ToString produces, without enclosing quotes. ]*/
+        default:
+            writeResult = (Sink_WriteValueAsText(sink, value) != CBOR_ENCODER_OK) ? __FAILURE__ : 0;
+            break;
+    }
+
+    if (writeResult != 0)
+    {
+        result = CBOR_ENCODER_ERROR;
+        LogError("unable to encode a value of type %s", ENUM_TO_STRING(AGENT_DATA_TYPE_TYPE, value->type));
+    }
+    else
+    {
+        result = CBOR_ENCODER_OK;
+    }
+
+    return result;
+}
+
+static CBOR_ENCODER_RESULT EncodeTreeToSink(MULTITREE_HANDLE treeHandle, CBOR_ENCODER_SINK* sink)
+{
+    CBOR_ENCODER_RESULT result;
+    size_t childCount;
+
+    /*Codes_SRS_CBOR_ENCODER_41_005: [ Every node of the tree shall be encoded as a map from the names of its children to their encoding. ]*/
+    if (MultiTree_GetChildCount(treeHandle, &childCount) != MULTITREE_OK)
+    {
+        result = CBOR_ENCODER_MULTITREE_ERROR;
+        LogError("(result = %s)", ENUM_TO_STRING(CBOR_ENCODER_RESULT, result));
+    }
+    else if (Sink_WriteHead(sink, CBOR_MAJOR_MAP, childCount) != 0)
+    {
+        result = CBOR_ENCODER_ERROR;
+        LogError("(result = %s)", ENUM_TO_STRING(CBOR_ENCODER_RESULT, result));
+    }
+    else
+    {
+        size_t i;
+        result = CBOR_ENCODER_OK;
+        for (i = 0; (i < childCount) && (result == CBOR_ENCODER_OK); i++)
+        {
+            MULTITREE_HANDLE childTreeHandle;
+            size_t innerChildCount;
+
+            if ((MultiTree_GetChild(treeHandle, i, &childTreeHandle) != MULTITREE_OK) ||
+                (STRING_empty(sink->scratch) != 0) ||
+                (MultiTree_GetName(childTreeHandle, sink->scratch) != MULTITREE_OK) ||
+                (MultiTree_GetChildCount(childTreeHandle, &innerChildCount) != MULTITREE_OK))
+            {
+                result = CBOR_ENCODER_MULTITREE_ERROR;
+                LogError("(result = %s)", ENUM_TO_STRING(CBOR_ENCODER_RESULT, result));
+            }
+            else
+            {
+                const char* name = STRING_c_str(sink->scratch);
+                if (Sink_WriteString(sink, CBOR_MAJOR_TEXT_STRING, name, strlen(name)) != 0)
+                {
+                    result = CBOR_ENCODER_ERROR;
+                    LogError("(result = %s)", ENUM_TO_STRING(CBOR_ENCODER_RESULT, result));
+                }
+                else if (innerChildCount > 0)
+                {
+                    result = EncodeTreeToSink(childTreeHandle, sink);
+                }
+                else
+                {
+                    const void* value;
+                    if (MultiTree_GetValue(childTreeHandle, &value) != MULTITREE_OK)
+                    {
+                        result = CBOR_ENCODER_MULTITREE_ERROR;
+                        LogError("(result = %s)", ENUM_TO_STRING(CBOR_ENCODER_RESULT, result));
+                    }
+                    else
+                    {
+                        result = EncodeValueToSink((const AGENT_DATA_TYPE*)value, sink);
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+CBOR_ENCODER_RESULT CBOREncoder_EncodeTree_ToBuffer(MULTITREE_HANDLE treeHandle, unsigned char** destination, size_t* destinationSize)
+{
+    CBOR_ENCODER_RESULT result;
+
+    /*Codes_SRS_CBOR_ENCODER_41_001: [ If any of the arguments passed to CBOREncoder_EncodeTree_ToBuffer is NULL then CBOR_ENCODER_INVALID_ARG shall be returned. ]*/
+    if ((treeHandle == NULL) ||
+        (destination == NULL) ||
+        (destinationSize == NULL))
+    {
+        result = CBOR_ENCODER_INVALID_ARG;
+        LogError("(result = %s)", ENUM_TO_STRING(CBOR_ENCODER_RESULT, result));
+    }
+    else
+    {
+        CBOR_ENCODER_SINK sink;
+        sink.buffer = NULL;
+        sink.size = 0;
+        sink.capacity = 0;
+        if ((sink.scratch = STRING_new()) == NULL)
+        {
+            result = CBOR_ENCODER_ERROR;
+            LogError("(result = %s)", ENUM_TO_STRING(CBOR_ENCODER_RESULT, result));
+        }
+        else
+        {
+            /*Codes_SRS_CBOR_ENCODER_41_002: [ CBOREncoder_EncodeTree_ToBuffer shall encode the tree as a single CBOR data item with the same structure as the JSON produced by JSONEncoder_EncodeTree. ]*/
+            if ((result = EncodeTreeToSink(treeHandle, &sink)) != CBOR_ENCODER_OK)
+            {
+                /*Codes_SRS_CBOR_ENCODER_41_018: [ If any failure occurs, CBOREncoder_EncodeTree_ToBuffer shall free the output buffer and return the error. ]*/
+                free(sink.buffer);
+            }
+            else
+            {
+                /*Codes_SRS_CBOR_ENCODER_41_004: [ On success, CBOREncoder_EncodeTree_ToBuffer shall hand the output buffer to the caller in *destination and its length in *destinationSize, and return CBOR_ENCODER_OK. ]*/
+                *destination = sink.buffer;
+                *destinationSize = sink.size;
+            }
+            STRING_delete(sink.scratch);
+        }
+    }
+
+    return result;
+}
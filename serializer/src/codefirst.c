@@ -3,22 +3,75 @@
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include "codefirst.h"
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
 #include <stddef.h>
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iotdevice.h"
 
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
 DEFINE_ENUM_STRINGS(CODEFIRST_RESULT, CODEFIRST_RESULT_VALUES)
 DEFINE_ENUM_STRINGS(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_RESULT_VALUES)
 
 #define LOG_CODEFIRST_ERROR \
     LogError("(result = %s)", ENUM_TO_STRING(CODEFIRST_RESULT, result))
 
+/*what SERIALIZE_REPORTED_PROPERTIES_DELTA remembers about one reported property, as the JSON text of its value*/
+typedef struct REPORTED_PROPERTY_SHADOW_TAG
+{
+    char* Path;
+    char* Acknowledged; /*the value the service has, NULL if never acknowledged*/
+    char* Sent; /*the value sent since the last acknowledgement, NULL if none*/
+} REPORTED_PROPERTY_SHADOW;
+
+/*a model, action or method of a metadata together with the hash of its model name and name*/
+typedef struct COMMAND_ENTRY_TAG
+{
+    size_t Hash;
+    const REFLECTED_SOMETHING* Command;
+} COMMAND_ENTRY;
+
+/*lookup tables for one metadata: the properties and reported properties sorted by kind, model name and offset,*/
+/*the models, actions and methods sorted by kind and hash*/
+typedef struct METADATA_INDEX_TAG
+{
+    const REFLECTED_DATA_FROM_DATAPROVIDER* Metadata;
+    const REFLECTED_SOMETHING** Fields;
+    size_t FieldCount;
+    COMMAND_ENTRY* Commands;
+    size_t CommandCount;
+} METADATA_INDEX;
+
+/*what creating and destroying a device does to one desired property of its data*/
+typedef struct MODEL_DESIRED_PROPERTY_TAG
+{
+    size_t Offset; /*from the start of the device data*/
+    pfDesiredPropertyInitialize Initialize;
+    pfDesiredPropertyDeinitialize Deinitialize;
+} MODEL_DESIRED_PROPERTY;
+
+/*the state that is the same for all the devices of a model: the desired properties of the model and of its models in model,
+flattened by the first device of the model instead of walking the schema for every device*/
+typedef struct MODEL_BLOCK_TAG
+{
+    SCHEMA_MODEL_TYPE_HANDLE ModelHandle;
+    size_t RefCount; /*devices using the block*/
+    MODEL_DESIRED_PROPERTY* DesiredProperties;
+    size_t DesiredPropertyCount;
+} MODEL_BLOCK;
+
 typedef struct DEVICE_HEADER_DATA_TAG
 {
     DEVICE_HANDLE DeviceHandle;
@@ -26,6 +79,10 @@ typedef struct DEVICE_HEADER_DATA_TAG
     SCHEMA_MODEL_TYPE_HANDLE ModelHandle;
     size_t DataSize;
     unsigned char* data;
+    REPORTED_PROPERTY_SHADOW* ReportedShadows;
+    size_t ReportedShadowCount;
+    const METADATA_INDEX* MetadataIndex; /*NULL when the index could not be built, lookups then scan the metadata*/
+    MODEL_BLOCK* ModelBlock;
 } DEVICE_HEADER_DATA;
 
 #define COUNT_OF(A) (sizeof(A) / sizeof((A)[0]))
@@ -81,84 +138,27 @@ static CODEFIRST_STATE g_state = CODEFIRST_STATE_NOT_INIT;
 static const char* g_OverrideSchemaNamespace;
 static size_t g_DeviceCount = 0;
 static DEVICE_HEADER_DATA** g_Devices = NULL;
-
-static void deinitializeDesiredProperties(SCHEMA_MODEL_TYPE_HANDLE model, void* destination)
-{
-    size_t nDesiredProperties;
-    if (Schema_GetModelDesiredPropertyCount(model, &nDesiredProperties) != SCHEMA_OK)
-    {
-        LogError("unexpected error in Schema_GetModelDesiredPropertyCount");
-    }
-    else
-    {
-        size_t nProcessedDesiredProperties = 0;
-        for (size_t i = 0;i < nDesiredProperties;i++)
-        {
-            SCHEMA_DESIRED_PROPERTY_HANDLE desiredPropertyHandle = Schema_GetModelDesiredPropertyByIndex(model, i);
-            if (desiredPropertyHandle == NULL)
-            {
-                LogError("unexpected error in Schema_GetModelDesiredPropertyByIndex");
-                i = nDesiredProperties;
-            }
-            else
-            {
-                pfDesiredPropertyDeinitialize desiredPropertyDeinitialize = Schema_GetModelDesiredProperty_pfDesiredPropertyDeinitialize(desiredPropertyHandle);
-                if (desiredPropertyDeinitialize == NULL)
-                {
-                    LogError("unexpected error in Schema_GetModelDesiredProperty_pfDesiredPropertyDeinitialize");
-                    i = nDesiredProperties;
-                }
-                else
-                {
-                    size_t offset = Schema_GetModelDesiredProperty_offset(desiredPropertyHandle);
-                    desiredPropertyDeinitialize((char*)destination + offset);
-                    nProcessedDesiredProperties++;
-                }
-            }
-        }
-
-        if (nDesiredProperties == nProcessedDesiredProperties)
-        {
-            /*recursively go in the model and initialize the other fields*/
-            size_t nModelInModel;
-            if (Schema_GetModelModelCount(model, &nModelInModel) != SCHEMA_OK)
-            {
-                LogError("unexpected error in Schema_GetModelModelCount");
-            }
-            else
-            {
-                size_t nProcessedModelInModel = 0;
-                for (size_t i = 0; i < nModelInModel;i++)
-                {
-                    SCHEMA_MODEL_TYPE_HANDLE modelInModel = Schema_GetModelModelyByIndex(model, i);
-                    if (modelInModel == NULL)
-                    {
-                        LogError("unexpected failure in Schema_GetModelModelyByIndex");
-                        i = nModelInModel;
-                    }
-                    else
-                    {
-                        size_t offset = Schema_GetModelModelByIndex_Offset(model, i);
-                        deinitializeDesiredProperties(modelInModel, (char*)destination + offset);
-                        nProcessedModelInModel++;
-                    }
-                }
-
-                if (nProcessedModelInModel == nModelInModel)
-                {
-                    /*all is fine... */
-                }
-            }
-        }
-    }
-}
+static size_t g_MetadataIndexCount = 0;
+static METADATA_INDEX** g_MetadataIndexes = NULL;
+static size_t g_ModelBlockCount = 0;
+static MODEL_BLOCK** g_ModelBlocks = NULL;
+/*guards g_Devices, g_MetadataIndexes and g_ModelBlocks: devices can be created and destroyed while other threads serialize other devices*/
+static LOCK_HANDLE g_DevicesLock = NULL;
 
 static void DestroyDevice(DEVICE_HEADER_DATA* deviceHeader)
 {
     /* Codes_SRS_CODEFIRST_99_085:[CodeFirst_DestroyDevice shall free all resources associated with a device.] */
     /* Codes_SRS_CODEFIRST_99_087:[In order to release the device handle, CodeFirst_DestroyDevice shall call Device_Destroy.] */
     
+    size_t i;
     Device_Destroy(deviceHeader->DeviceHandle);
+    for (i = 0; i < deviceHeader->ReportedShadowCount; i++)
+    {
+        free(deviceHeader->ReportedShadows[i].Path);
+        free(deviceHeader->ReportedShadows[i].Acknowledged);
+        free(deviceHeader->ReportedShadows[i].Sent);
+    }
+    free(deviceHeader->ReportedShadows);
     free(deviceHeader->data);
     free(deviceHeader);
 }
@@ -411,6 +411,33 @@ out:
     return result;
 }
 
+static void DestroyMetadataIndexes(void)
+{
+    size_t i;
+    for (i = 0; i < g_MetadataIndexCount; i++)
+    {
+        free((void*)g_MetadataIndexes[i]->Fields);
+        free(g_MetadataIndexes[i]->Commands);
+        free(g_MetadataIndexes[i]);
+    }
+    free(g_MetadataIndexes);
+    g_MetadataIndexes = NULL;
+    g_MetadataIndexCount = 0;
+}
+
+static void DestroyModelBlocks(void)
+{
+    size_t i;
+    for (i = 0; i < g_ModelBlockCount; i++)
+    {
+        free(g_ModelBlocks[i]->DesiredProperties);
+        free(g_ModelBlocks[i]);
+    }
+    free(g_ModelBlocks);
+    g_ModelBlocks = NULL;
+    g_ModelBlockCount = 0;
+}
+
 static CODEFIRST_RESULT CodeFirst_Init_impl(const char* overrideSchemaNamespace, bool calledFromCodeFirst_Init)
 {
     /*shall build the default EntityContainer*/
@@ -425,6 +452,12 @@ static CODEFIRST_RESULT CodeFirst_Init_impl(const char* overrideSchemaNamespace,
              LogError("CodeFirst was already init %s", ENUM_TO_STRING(CODEFIRST_RESULT, result));
         }
     }
+    /*Codes_SRS_CODEFIRST_41_017: [ CodeFirst_Init shall create the lock that guards the list of devices. If that fails, CodeFirst_Init shall fail and return CODEFIRST_ERROR. ]*/
+    else if ((g_DevicesLock = Lock_Init()) == NULL)
+    {
+        result = CODEFIRST_ERROR;
+        LogError("unable to create the devices lock %s", ENUM_TO_STRING(CODEFIRST_RESULT, result));
+    }
     else
     {
         g_DeviceCount = 0;
@@ -438,6 +471,23 @@ static CODEFIRST_RESULT CodeFirst_Init_impl(const char* overrideSchemaNamespace,
     return result;
 }
 
+/*before CodeFirst is initialized there is no lock, and no other thread can be using devices*/
+static void LockDevices(void)
+{
+    if ((g_DevicesLock != NULL) && (Lock(g_DevicesLock) != LOCK_OK))
+    {
+        LogError("unable to lock the devices");
+    }
+}
+
+static void UnlockDevices(void)
+{
+    if ((g_DevicesLock != NULL) && (Unlock(g_DevicesLock) != LOCK_OK))
+    {
+        LogError("unable to unlock the devices");
+    }
+}
+
 /*Codes_SRS_CODEFIRST_99_002:[ CodeFirst_Init shall initialize the CodeFirst module. If initialization is successful, it shall return CODEFIRST_OK.]*/
 CODEFIRST_RESULT CodeFirst_Init(const char* overrideSchemaNamespace)
 {
@@ -464,11 +514,292 @@ void CodeFirst_Deinit(void)
         free(g_Devices);
         g_Devices = NULL;
         g_DeviceCount = 0;
+        DestroyMetadataIndexes();
+        DestroyModelBlocks();
+        (void)Lock_Deinit(g_DevicesLock);
+        g_DevicesLock = NULL;
 
         g_state = CODEFIRST_STATE_NOT_INIT;
     }
 }
 
+static const char* GetFieldModelName(const REFLECTED_SOMETHING* field)
+{
+    return (field->type == REFLECTION_PROPERTY_TYPE) ? field->what.property.modelName : field->what.reportedProperty.modelName;
+}
+
+static size_t GetFieldOffset(const REFLECTED_SOMETHING* field)
+{
+    return (field->type == REFLECTION_PROPERTY_TYPE) ? field->what.property.offset : field->what.reportedProperty.offset;
+}
+
+static size_t GetFieldSize(const REFLECTED_SOMETHING* field)
+{
+    return (field->type == REFLECTION_PROPERTY_TYPE) ? field->what.property.size : field->what.reportedProperty.size;
+}
+
+static int CompareFieldKey(REFLECTION_TYPE type, const char* modelName, size_t offset, const REFLECTED_SOMETHING* field)
+{
+    int result;
+    if (type != field->type)
+    {
+        result = (type < field->type) ? -1 : 1;
+    }
+    else if ((result = strcmp(modelName, GetFieldModelName(field))) == 0)
+    {
+        result = (offset < GetFieldOffset(field)) ? -1 : (offset > GetFieldOffset(field)) ? 1 : 0;
+    }
+    return result;
+}
+
+static int CompareFields(const void* left, const void* right)
+{
+    const REFLECTED_SOMETHING* leftField = *(const REFLECTED_SOMETHING* const*)left;
+    return CompareFieldKey(leftField->type, GetFieldModelName(leftField), GetFieldOffset(leftField), *(const REFLECTED_SOMETHING* const*)right);
+}
+
+static bool IsCommand(const REFLECTED_SOMETHING* something)
+{
+    return (something->type == REFLECTION_MODEL_TYPE) || (something->type == REFLECTION_ACTION_TYPE) || (something->type == REFLECTION_METHOD_TYPE);
+}
+
+static const char* GetCommandName(const REFLECTED_SOMETHING* command)
+{
+    return (command->type == REFLECTION_ACTION_TYPE) ? command->what.action.name :
+        (command->type == REFLECTION_METHOD_TYPE) ? command->what.method.name :
+        command->what.model.name;
+}
+
+/*models are not declared inside another model, they use "" as model name*/
+static const char* GetCommandModelName(const REFLECTED_SOMETHING* command)
+{
+    return (command->type == REFLECTION_ACTION_TYPE) ? command->what.action.modelName :
+        (command->type == REFLECTION_METHOD_TYPE) ? command->what.method.modelName :
+        "";
+}
+
+/*FNV-1a of modelName, '/' and name*/
+static size_t CommandHash(const char* modelName, const char* name)
+{
+    size_t result = (size_t)2166136261u;
+    const char* part;
+    for (part = modelName; *part != '\0'; part++)
+    {
+        result ^= (unsigned char)*part;
+        result *= (size_t)16777619u;
+    }
+    result ^= (unsigned char)'/';
+    result *= (size_t)16777619u;
+    for (part = name; *part != '\0'; part++)
+    {
+        result ^= (unsigned char)*part;
+        result *= (size_t)16777619u;
+    }
+    return result;
+}
+
+static int CompareCommandKey(REFLECTION_TYPE type, size_t hash, const COMMAND_ENTRY* entry)
+{
+    return (type != entry->Command->type) ? ((type < entry->Command->type) ? -1 : 1) :
+        (hash < entry->Hash) ? -1 :
+        (hash > entry->Hash) ? 1 :
+        0;
+}
+
+static int CompareCommands(const void* left, const void* right)
+{
+    const COMMAND_ENTRY* leftEntry = (const COMMAND_ENTRY*)left;
+    return CompareCommandKey(leftEntry->Command->type, leftEntry->Hash, (const COMMAND_ENTRY*)right);
+}
+
+/*returns the index built for metadata, building it the first time a device uses that metadata*/
+static const METADATA_INDEX* GetMetadataIndex(const REFLECTED_DATA_FROM_DATAPROVIDER* metadata)
+{
+    METADATA_INDEX* result = NULL;
+    size_t i;
+    for (i = 0; i < g_MetadataIndexCount; i++)
+    {
+        if (g_MetadataIndexes[i]->Metadata == metadata)
+        {
+            result = g_MetadataIndexes[i];
+            break;
+        }
+    }
+
+    if (result == NULL)
+    {
+        const REFLECTED_SOMETHING* something;
+        size_t fieldCount = 0;
+        size_t commandCount = 0;
+        METADATA_INDEX** newIndexes;
+        for (something = metadata->reflectedData; something != NULL; something = something->next)
+        {
+            if ((something->type == REFLECTION_PROPERTY_TYPE) || (something->type == REFLECTION_REPORTED_PROPERTY_TYPE))
+            {
+                fieldCount++;
+            }
+            else if (IsCommand(something))
+            {
+                commandCount++;
+            }
+        }
+
+        if ((result = (METADATA_INDEX*)malloc(sizeof(METADATA_INDEX))) == NULL)
+        {
+            LogError("unable to allocate the metadata index");
+        }
+        else if ((result->Fields = (const REFLECTED_SOMETHING**)malloc(sizeof(const REFLECTED_SOMETHING*) * (fieldCount + 1))) == NULL)
+        {
+            LogError("unable to allocate the metadata index");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->Commands = (COMMAND_ENTRY*)malloc(sizeof(COMMAND_ENTRY) * (commandCount + 1))) == NULL)
+        {
+            LogError("unable to allocate the metadata index");
+            free((void*)result->Fields);
+            free(result);
+            result = NULL;
+        }
+        else if ((newIndexes = (METADATA_INDEX**)realloc(g_MetadataIndexes, sizeof(METADATA_INDEX*) * (g_MetadataIndexCount + 1))) == NULL)
+        {
+            LogError("unable to grow the metadata indexes");
+            free(result->Commands);
+            free((void*)result->Fields);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->Metadata = metadata;
+            result->FieldCount = 0;
+            result->CommandCount = 0;
+            for (something = metadata->reflectedData; something != NULL; something = something->next)
+            {
+                if ((something->type == REFLECTION_PROPERTY_TYPE) || (something->type == REFLECTION_REPORTED_PROPERTY_TYPE))
+                {
+                    result->Fields[result->FieldCount++] = something;
+                }
+                else if (IsCommand(something))
+                {
+                    result->Commands[result->CommandCount].Hash = CommandHash(GetCommandModelName(something), GetCommandName(something));
+                    result->Commands[result->CommandCount].Command = something;
+                    result->CommandCount++;
+                }
+            }
+            qsort((void*)result->Fields, result->FieldCount, sizeof(const REFLECTED_SOMETHING*), CompareFields);
+            qsort(result->Commands, result->CommandCount, sizeof(COMMAND_ENTRY), CompareCommands);
+
+            g_MetadataIndexes = newIndexes;
+            g_MetadataIndexes[g_MetadataIndexCount++] = result;
+        }
+    }
+
+    return result;
+}
+
+/*finds the property (or reported property) of modelName that covers valueOffset*/
+static const REFLECTED_SOMETHING* FindField(DEVICE_HEADER_DATA* deviceHeader, REFLECTION_TYPE type, const char* modelName, size_t valueOffset)
+{
+    const REFLECTED_SOMETHING* result = NULL;
+    if (deviceHeader->MetadataIndex != NULL)
+    {
+        /*fields of one model do not overlap, so the only candidate is the last one starting at or before valueOffset*/
+        const METADATA_INDEX* index = deviceHeader->MetadataIndex;
+        size_t low = 0;
+        size_t high = index->FieldCount;
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            if (CompareFieldKey(type, modelName, valueOffset, index->Fields[middle]) >= 0)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        if (low > 0)
+        {
+            result = index->Fields[low - 1];
+        }
+    }
+    else
+    {
+        for (result = deviceHeader->ReflectedData->reflectedData; result != NULL; result = result->next)
+        {
+            if ((result->type == type) &&
+                (strcmp(GetFieldModelName(result), modelName) == 0) &&
+                (GetFieldOffset(result) <= valueOffset) &&
+                (GetFieldOffset(result) + GetFieldSize(result) > valueOffset))
+            {
+                break;
+            }
+        }
+    }
+
+    if ((result != NULL) &&
+        ((result->type != type) ||
+        (strcmp(GetFieldModelName(result), modelName) != 0) ||
+        (GetFieldOffset(result) + GetFieldSize(result) <= valueOffset)))
+    {
+        result = NULL;
+    }
+
+    return result;
+}
+
+/*finds the model (modelName is then ""), action or method called name*/
+static const REFLECTED_SOMETHING* FindCommand(DEVICE_HEADER_DATA* deviceHeader, REFLECTION_TYPE type, const char* modelName, const char* name)
+{
+    const REFLECTED_SOMETHING* result = NULL;
+    if (deviceHeader->MetadataIndex != NULL)
+    {
+        const METADATA_INDEX* index = deviceHeader->MetadataIndex;
+        size_t hash = CommandHash(modelName, name);
+        size_t low = 0;
+        size_t high = index->CommandCount;
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            if (CompareCommandKey(type, hash, &index->Commands[middle]) > 0)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        /*names with the same hash are next to each other*/
+        for (; (low < index->CommandCount) && (CompareCommandKey(type, hash, &index->Commands[low]) == 0); low++)
+        {
+            if ((strcmp(GetCommandName(index->Commands[low].Command), name) == 0) &&
+                (strcmp(GetCommandModelName(index->Commands[low].Command), modelName) == 0))
+            {
+                result = index->Commands[low].Command;
+                break;
+            }
+        }
+    }
+    else
+    {
+        for (result = deviceHeader->ReflectedData->reflectedData; result != NULL; result = result->next)
+        {
+            if ((result->type == type) &&
+                (strcmp(GetCommandName(result), name) == 0) &&
+                (strcmp(GetCommandModelName(result), modelName) == 0))
+            {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
 static const REFLECTED_SOMETHING* FindModelInCodeFirstMetadata(const REFLECTED_SOMETHING* reflectedData, const char* modelName)
 {
     const REFLECTED_SOMETHING* result;
@@ -569,7 +900,7 @@ EXECUTE_COMMAND_RESULT CodeFirst_InvokeAction(DEVICE_HANDLE deviceHandle, void*
 
         modelName = Schema_GetModelName(deviceHeader->ModelHandle);
 
-        if (((childModel = FindModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, modelName)) == NULL) ||
+        if (((childModel = FindCommand(deviceHeader, REFLECTION_MODEL_TYPE, "", modelName)) == NULL) ||
             /* Codes_SRS_CODEFIRST_99_138:[The relativeActionPath argument shall be used by CodeFirst_InvokeAction to find the child model where the action is declared.] */
             ((childModel = FindChildModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, childModel, relativeActionPath, &offset)) == NULL))
         {
@@ -581,21 +912,16 @@ EXECUTE_COMMAND_RESULT CodeFirst_InvokeAction(DEVICE_HANDLE deviceHandle, void*
         {
             /* Codes_SRS_CODEFIRST_99_062:[ When CodeFirst_InvokeAction is called it shall look through the codefirst metadata associated with a specific device for a previously declared action (function) named actionName.]*/
             /* Codes_SRS_CODEFIRST_99_078:[If such a function is not found then the function shall return EXECUTE_COMMAND_ERROR.]*/
+            /*Codes_SRS_CODEFIRST_41_016: [ CodeFirst_InvokeAction and CodeFirst_InvokeMethod shall find the model and the action or method through a table sorted by a hash of the model and command names, built with the metadata index. ]*/
             result = EXECUTE_COMMAND_ERROR;
-            for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
+            if ((something = FindCommand(deviceHeader, REFLECTION_ACTION_TYPE, childModel->what.model.name, actionName)) != NULL)
             {
-                if ((something->type == REFLECTION_ACTION_TYPE) &&
-                    (strcmp(actionName, something->what.action.name) == 0) &&
-                    (strcmp(childModel->what.model.name, something->what.action.modelName) == 0))
-                {
-                    /*Codes_SRS_CODEFIRST_99_063:[ If the function is found, then CodeFirst shall call the wrapper of the found function inside the data provider. The wrapper is linked in the reflected data to the function name. The wrapper shall be called with the same arguments as CodeFirst_InvokeAction has been called.]*/
-                    /*Codes_SRS_CODEFIRST_99_064:[ If the wrapper call succeeds then CODEFIRST_OK shall be returned. ]*/
-                    /*Codes_SRS_CODEFIRST_99_065:[ For all the other return values CODEFIRST_ACTION_EXECUTION_ERROR shall be returned.]*/
-                    /* Codes_SRS_CODEFIRST_99_140:[CodeFirst_InvokeAction shall pass to the action wrapper that it calls a pointer to the model where the action is defined.] */
-                    /*Codes_SRS_CODEFIRST_02_013: [The wrapper's return value shall be returned.]*/
-                    result = something->what.action.wrapper(deviceHeader->data + offset, parameterCount, parameterValues);
-                    break;
-                }
+                /*Codes_SRS_CODEFIRST_99_063:[ If the function is found, then CodeFirst shall call the wrapper of the found function inside the data provider. The wrapper is linked in the reflected data to the function name. The wrapper shall be called with the same arguments as CodeFirst_InvokeAction has been called.]*/
+                /*Codes_SRS_CODEFIRST_99_064:[ If the wrapper call succeeds then CODEFIRST_OK shall be returned. ]*/
+                /*Codes_SRS_CODEFIRST_99_065:[ For all the other return values CODEFIRST_ACTION_EXECUTION_ERROR shall be returned.]*/
+                /* Codes_SRS_CODEFIRST_99_140:[CodeFirst_InvokeAction shall pass to the action wrapper that it calls a pointer to the model where the action is defined.] */
+                /*Codes_SRS_CODEFIRST_02_013: [The wrapper's return value shall be returned.]*/
+                result = something->what.action.wrapper(deviceHeader->data + offset, parameterCount, parameterValues);
             }
         }
     }
@@ -639,7 +965,7 @@ METHODRETURN_HANDLE CodeFirst_InvokeMethod(DEVICE_HANDLE deviceHandle, void* cal
 
         modelName = Schema_GetModelName(deviceHeader->ModelHandle);
 
-        if (((childModel = FindModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, modelName)) == NULL) ||
+        if (((childModel = FindCommand(deviceHeader, REFLECTION_MODEL_TYPE, "", modelName)) == NULL) ||
             ((childModel = FindChildModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, childModel, relativeMethodPath, &offset)) == NULL))
         {
             result = NULL;
@@ -648,15 +974,7 @@ METHODRETURN_HANDLE CodeFirst_InvokeMethod(DEVICE_HANDLE deviceHandle, void* cal
         else
         {
             result = NULL;
-            for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
-            {
-                if ((something->type == REFLECTION_METHOD_TYPE) &&
-                    (strcmp(methodName, something->what.method.name) == 0) &&
-                    (strcmp(childModel->what.model.name, something->what.method.modelName) == 0))
-                {
-                    break; /*found...*/
-                }
-            }
+            something = FindCommand(deviceHeader, REFLECTION_METHOD_TYPE, childModel->what.model.name, methodName);
 
             if (something == NULL)
             {
@@ -698,6 +1016,9 @@ SCHEMA_HANDLE CodeFirst_RegisterSchema(const char* schemaNamespace, const REFLEC
             schemaNamespace = g_OverrideSchemaNamespace;
         }
 
+        /*the schema list is shared with CodeFirst_DestroyDevice, which destroys unused schemas*/
+        LockDevices();
+
         /* Codes_SRS_CODEFIRST_99_121:[If the schema has already been registered, CodeFirst_RegisterSchema shall return its handle.] */
         result = Schema_GetSchemaByNamespace(schemaNamespace);
         if (result == NULL)
@@ -718,10 +1039,17 @@ SCHEMA_HANDLE CodeFirst_RegisterSchema(const char* schemaNamespace, const REFLEC
                 }
                 else
                 {
-                    /* do nothing, everything is OK */
+                    /*Codes_SRS_CODEFIRST_41_005: [ Once the schema has been built, CodeFirst_RegisterSchema shall call Schema_BuildLookupIndexes. ]*/
+                    if (Schema_BuildLookupIndexes(result) != SCHEMA_OK)
+                    {
+                        /*Codes_SRS_CODEFIRST_41_006: [ If Schema_BuildLookupIndexes fails, CodeFirst_RegisterSchema shall still succeed. ]*/
+                        LogError("unable to build the schema lookup indexes, lookups will scan");
+                    }
                 }
             }
         }
+
+        UnlockDevices();
     }
 
     return result;
@@ -801,11 +1129,10 @@ AGENT_DATA_TYPE_TYPE CodeFirst_GetPrimitiveType(const char* typeName)
     }
 }
 
-static void initializeDesiredProperties(SCHEMA_MODEL_TYPE_HANDLE model, void* destination)
+/*adds to modelBlock the desired properties of model and, recursively, of its models in model; baseOffset is where model starts in the device data*/
+static int AddDesiredProperties(MODEL_BLOCK* modelBlock, SCHEMA_MODEL_TYPE_HANDLE model, size_t baseOffset)
 {
-    /*this function assumes that at the address given by destination there is an instance of a model*/
-    /*some constituents of the model need to be initialized - ascii_char_ptr for example should be set to NULL*/
-
+    int result = 0;
     size_t nDesiredProperties;
     if (Schema_GetModelDesiredPropertyCount(model, &nDesiredProperties) != SCHEMA_OK)
     {
@@ -814,27 +1141,42 @@ static void initializeDesiredProperties(SCHEMA_MODEL_TYPE_HANDLE model, void* de
     else
     {
         size_t nProcessedDesiredProperties = 0;
-        for (size_t i = 0;i < nDesiredProperties;i++)
+        for (size_t i = 0; i < nDesiredProperties; i++)
         {
             SCHEMA_DESIRED_PROPERTY_HANDLE desiredPropertyHandle = Schema_GetModelDesiredPropertyByIndex(model, i);
+            pfDesiredPropertyInitialize desiredPropertyInitialize;
+            pfDesiredPropertyDeinitialize desiredPropertyDeinitialize;
             if (desiredPropertyHandle == NULL)
             {
                 LogError("unexpected error in Schema_GetModelDesiredPropertyByIndex");
                 i = nDesiredProperties;
             }
-            else
+            else if ((desiredPropertyInitialize = Schema_GetModelDesiredProperty_pfDesiredPropertyInitialize(desiredPropertyHandle)) == NULL)
             {
-                pfDesiredPropertyInitialize desiredPropertyInitialize = Schema_GetModelDesiredProperty_pfDesiredPropertyInitialize(desiredPropertyHandle);
-                if (desiredPropertyInitialize == NULL)
-                {
-                    LogError("unexpected error in Schema_GetModelDesiredProperty_pfDesiredPropertyInitialize");
-                    i = nDesiredProperties;
-                }
-                else
+                LogError("unexpected error in Schema_GetModelDesiredProperty_pfDesiredPropertyInitialize");
+                i = nDesiredProperties;
+            }
+            else if ((desiredPropertyDeinitialize = Schema_GetModelDesiredProperty_pfDesiredPropertyDeinitialize(desiredPropertyHandle)) == NULL)
+            {
+                LogError("unexpected error in Schema_GetModelDesiredProperty_pfDesiredPropertyDeinitialize");
+                i = nDesiredProperties;
+            }
+            else
+            {
+                MODEL_DESIRED_PROPERTY* newDesiredProperties = (MODEL_DESIRED_PROPERTY*)realloc(modelBlock->DesiredProperties, sizeof(MODEL_DESIRED_PROPERTY) * (modelBlock->DesiredPropertyCount + 1));
+                if (newDesiredProperties == NULL)
+                {
+                    LogError("unable to realloc");
+                    result = __FAILURE__;
+                    i = nDesiredProperties;
+                }
+                else
                 {
-                    /*Codes_SRS_CODEFIRST_02_036: [ CodeFirst_CreateDevice shall initialize all the desired properties to their default values. ]*/
-                    size_t offset = Schema_GetModelDesiredProperty_offset(desiredPropertyHandle);
-                    desiredPropertyInitialize((char*)destination + offset);
+                    modelBlock->DesiredProperties = newDesiredProperties;
+                    newDesiredProperties[modelBlock->DesiredPropertyCount].Offset = baseOffset + Schema_GetModelDesiredProperty_offset(desiredPropertyHandle);
+                    newDesiredProperties[modelBlock->DesiredPropertyCount].Initialize = desiredPropertyInitialize;
+                    newDesiredProperties[modelBlock->DesiredPropertyCount].Deinitialize = desiredPropertyDeinitialize;
+                    modelBlock->DesiredPropertyCount++;
                     nProcessedDesiredProperties++;
                 }
             }
@@ -842,7 +1184,7 @@ static void initializeDesiredProperties(SCHEMA_MODEL_TYPE_HANDLE model, void* de
 
         if (nDesiredProperties == nProcessedDesiredProperties)
         {
-            /*recursively go in the model and initialize the other fields*/
+            /*recursively go in the model and collect the desired properties of the other fields*/
             size_t nModelInModel;
             if (Schema_GetModelModelCount(model, &nModelInModel) != SCHEMA_OK)
             {
@@ -850,8 +1192,7 @@ static void initializeDesiredProperties(SCHEMA_MODEL_TYPE_HANDLE model, void* de
             }
             else
             {
-                size_t nProcessedModelInModel = 0;
-                for (size_t i = 0; i < nModelInModel;i++)
+                for (size_t i = 0; i < nModelInModel; i++)
                 {
                     SCHEMA_MODEL_TYPE_HANDLE modelInModel = Schema_GetModelModelyByIndex(model, i);
                     if (modelInModel == NULL)
@@ -859,21 +1200,156 @@ static void initializeDesiredProperties(SCHEMA_MODEL_TYPE_HANDLE model, void* de
                         LogError("unexpected failure in Schema_GetModelModelyByIndex");
                         i = nModelInModel;
                     }
-                    else
+                    else if (AddDesiredProperties(modelBlock, modelInModel, baseOffset + Schema_GetModelModelByIndex_Offset(model, i)) != 0)
                     {
-                        size_t offset = Schema_GetModelModelByIndex_Offset(model, i);
-                        initializeDesiredProperties(modelInModel, (char*)destination + offset);
-                        nProcessedModelInModel++;
+                        result = __FAILURE__;
+                        i = nModelInModel;
                     }
                 }
+            }
+        }
+    }
+    return result;
+}
 
-                if (nProcessedModelInModel == nModelInModel)
-                {
-                    /*all is fine... */
-                }
+/*returns the block of model, built the first time a device uses model; the devices lock is held by the caller*/
+static MODEL_BLOCK* AcquireModelBlock(SCHEMA_MODEL_TYPE_HANDLE model)
+{
+    MODEL_BLOCK* result = NULL;
+    size_t i;
+    for (i = 0; i < g_ModelBlockCount; i++)
+    {
+        if (g_ModelBlocks[i]->ModelHandle == model)
+        {
+            result = g_ModelBlocks[i];
+            result->RefCount++;
+            break;
+        }
+    }
+
+    if (result == NULL)
+    {
+        MODEL_BLOCK** newModelBlocks;
+        if ((result = (MODEL_BLOCK*)malloc(sizeof(MODEL_BLOCK))) == NULL)
+        {
+            LogError("unable to malloc");
+        }
+        else
+        {
+            result->ModelHandle = model;
+            result->RefCount = 1;
+            result->DesiredProperties = NULL;
+            result->DesiredPropertyCount = 0;
+            if (AddDesiredProperties(result, model, 0) != 0)
+            {
+                free(result->DesiredProperties);
+                free(result);
+                result = NULL;
+            }
+            else if ((newModelBlocks = (MODEL_BLOCK**)realloc(g_ModelBlocks, sizeof(MODEL_BLOCK*) * (g_ModelBlockCount + 1))) == NULL)
+            {
+                LogError("unable to realloc");
+                free(result->DesiredProperties);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                g_ModelBlocks = newModelBlocks;
+                g_ModelBlocks[g_ModelBlockCount++] = result;
+            }
+        }
+    }
+    return result;
+}
+
+/*the block is freed with the last device of its model, a model created later at the same address gets a new block; the devices lock is held by the caller*/
+static void ReleaseModelBlock(MODEL_BLOCK* modelBlock)
+{
+    modelBlock->RefCount--;
+    if (modelBlock->RefCount == 0)
+    {
+        size_t i;
+        for (i = 0; i < g_ModelBlockCount; i++)
+        {
+            if (g_ModelBlocks[i] == modelBlock)
+            {
+                (void)memmove(&g_ModelBlocks[i], &g_ModelBlocks[i + 1], (g_ModelBlockCount - i - 1) * sizeof(MODEL_BLOCK*));
+                g_ModelBlockCount--;
+                break;
             }
         }
+        if (g_ModelBlockCount == 0)
+        {
+            free(g_ModelBlocks);
+            g_ModelBlocks = NULL;
+        }
+        free(modelBlock->DesiredProperties);
+        free(modelBlock);
+    }
+}
+
+/*initializes the desired properties of the device data at destination, returns the block of model (to be released by the device) or NULL*/
+static MODEL_BLOCK* initializeDesiredProperties(SCHEMA_MODEL_TYPE_HANDLE model, unsigned char* destination)
+{
+    MODEL_BLOCK* result;
+    LockDevices();
+    result = AcquireModelBlock(model);
+    UnlockDevices();
+
+    if (result != NULL)
+    {
+        /*some constituents of the model need to be initialized - ascii_char_ptr for example should be set to NULL*/
+        size_t i;
+        for (i = 0; i < result->DesiredPropertyCount; i++)
+        {
+            /*Codes_SRS_CODEFIRST_02_036: [ CodeFirst_CreateDevice shall initialize all the desired properties to their default values. ]*/
+            result->DesiredProperties[i].Initialize(destination + result->DesiredProperties[i].Offset);
+        }
+    }
+    return result;
+}
+
+static void deinitializeDesiredProperties(const MODEL_BLOCK* modelBlock, unsigned char* destination)
+{
+    size_t i;
+    for (i = 0; i < modelBlock->DesiredPropertyCount; i++)
+    {
+        modelBlock->DesiredProperties[i].Deinitialize(destination + modelBlock->DesiredProperties[i].Offset);
+    }
+}
+
+/*makes room in g_Devices for one more device, the device count is not changed*/
+static DEVICE_HEADER_DATA** GrowDevices(void)
+{
+    DEVICE_HEADER_DATA** result;
+    LockDevices();
+    if ((result = (DEVICE_HEADER_DATA**)realloc(g_Devices, sizeof(DEVICE_HEADER_DATA*) * (g_DeviceCount + 1))) != NULL)
+    {
+        g_Devices = result;
+    }
+    UnlockDevices();
+    return result;
+}
+
+/*g_Devices is kept sorted by data address; this returns the index of the first device whose data starts after address*/
+static size_t FindDeviceUpperBound(const unsigned char* address)
+{
+    size_t low = 0;
+    size_t high = g_DeviceCount;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (g_Devices[middle]->data <= address)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
     }
+    return low;
 }
 
 /* Codes_SRS_CODEFIRST_99_079:[CodeFirst_CreateDevice shall create a device and allocate a memory block that should hold the device data.] */
@@ -914,11 +1390,25 @@ void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DAT
             {
                 DEVICE_HEADER_DATA** newDevices;
 
-                initializeDesiredProperties(model, deviceHeader->data);
+                /*Codes_SRS_CODEFIRST_41_029: [ CodeFirst_CreateDevice shall zero the device data block, so that every WITH_AGGREGATED_DATA window starts empty. ]*/
+                (void)memset(deviceHeader->data, 0, dataSize);
 
-                if (Device_Create(model, CodeFirst_InvokeAction, deviceHeader, CodeFirst_InvokeMethod, deviceHeader, 
+                /*Codes_SRS_CODEFIRST_41_030: [ CodeFirst_CreateDevice shall walk the schema of model for its desired properties only when no other device of model exists, the devices of a model shall share the result. ]*/
+                if ((deviceHeader->ModelBlock = initializeDesiredProperties(model, deviceHeader->data)) == NULL)
+                {
+                    free(deviceHeader->data);
+                    free(deviceHeader);
+
+                    /* Codes_SRS_CODEFIRST_99_102:[On any other errors, Device_Create shall return NULL.] */
+                    result = NULL;
+                    LogError(" %s ", ENUM_TO_STRING(CODEFIRST_RESULT, CODEFIRST_ERROR));
+                }
+                else if (Device_Create(model, CodeFirst_InvokeAction, deviceHeader, CodeFirst_InvokeMethod, deviceHeader, 
                     includePropertyPath, &deviceHeader->DeviceHandle) != DEVICE_OK)
                 {
+                    LockDevices();
+                    ReleaseModelBlock(deviceHeader->ModelBlock);
+                    UnlockDevices();
                     free(deviceHeader->data);
                     free(deviceHeader);
 
@@ -926,9 +1416,12 @@ void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DAT
                     result = NULL;
                     LogError(" %s ", ENUM_TO_STRING(CODEFIRST_RESULT, CODEFIRST_DEVICE_FAILED));
                 }
-                else if ((newDevices = (DEVICE_HEADER_DATA**)realloc(g_Devices, sizeof(DEVICE_HEADER_DATA*) * (g_DeviceCount + 1))) == NULL)
+                else if ((newDevices = GrowDevices()) == NULL)
                 {
                     Device_Destroy(deviceHeader->DeviceHandle);
+                    LockDevices();
+                    ReleaseModelBlock(deviceHeader->ModelBlock);
+                    UnlockDevices();
                     free(deviceHeader->data);
                     free(deviceHeader);
 
@@ -942,10 +1435,15 @@ void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DAT
                     deviceHeader->ReflectedData = metadata;
                     deviceHeader->DataSize = dataSize;
                     deviceHeader->ModelHandle = model;
+                    deviceHeader->ReportedShadows = NULL;
+                    deviceHeader->ReportedShadowCount = 0;
                     schemaResult = Schema_AddDeviceRef(model);
                     if (schemaResult != SCHEMA_OK)
                     {
                         Device_Destroy(deviceHeader->DeviceHandle);
+                        LockDevices();
+                        ReleaseModelBlock(deviceHeader->ModelBlock);
+                        UnlockDevices();
                         free(deviceHeader->data);
                         free(deviceHeader);
 
@@ -954,9 +1452,16 @@ void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DAT
                     }
                     else
                     {
-                        g_Devices = newDevices;
-                        g_Devices[g_DeviceCount] = deviceHeader;
+                        size_t position;
+                        LockDevices();
+                        /*Codes_SRS_CODEFIRST_41_015: [ CodeFirst_CreateDevice shall index the properties and reported properties of metadata by model name and offset the first time a device uses metadata; if the index cannot be built, lookups shall scan the metadata. ]*/
+                        deviceHeader->MetadataIndex = GetMetadataIndex(metadata);
+                        /*Codes_SRS_CODEFIRST_41_014: [ CodeFirst_CreateDevice shall keep the devices sorted by the address of their data, so that a device can be found by binary search. ]*/
+                        position = FindDeviceUpperBound(deviceHeader->data);
+                        (void)memmove(&g_Devices[position + 1], &g_Devices[position], (g_DeviceCount - position) * sizeof(DEVICE_HEADER_DATA*));
+                        g_Devices[position] = deviceHeader;
                         g_DeviceCount++;
+                        UnlockDevices();
 
                         /* Codes_SRS_CODEFIRST_99_101:[On success, CodeFirst_CreateDevice shall return a non NULL pointer to the device data.] */
                         result = deviceHeader->data;
@@ -976,22 +1481,25 @@ void CodeFirst_DestroyDevice(void* device)
     if (device != NULL)
     {
         size_t i;
+        bool destroyLock = false;
 
-        for (i = 0; i < g_DeviceCount; i++)
+        /*Codes_SRS_CODEFIRST_41_018: [ CodeFirst_CreateDevice, CodeFirst_DestroyDevice, CodeFirst_RegisterSchema and the lookups of the device a value belongs to shall hold the devices lock, so that different devices can be serialized from different threads. ]*/
+        LockDevices();
+        i = FindDeviceUpperBound((unsigned char*)device);
+
+        if ((i > 0) && (g_Devices[i - 1]->data == device))
         {
-            if (g_Devices[i]->data == device)
-            {
-                deinitializeDesiredProperties(g_Devices[i]->ModelHandle, g_Devices[i]->data);
-                Schema_ReleaseDeviceRef(g_Devices[i]->ModelHandle);
+            i--;
+            deinitializeDesiredProperties(g_Devices[i]->ModelBlock, g_Devices[i]->data);
+            ReleaseModelBlock(g_Devices[i]->ModelBlock);
+            Schema_ReleaseDeviceRef(g_Devices[i]->ModelHandle);
 
-                // Delete the Created Schema if all the devices are unassociated
-                Schema_DestroyIfUnused(g_Devices[i]->ModelHandle);
+            // Delete the Created Schema if all the devices are unassociated
+            Schema_DestroyIfUnused(g_Devices[i]->ModelHandle);
 
-                DestroyDevice(g_Devices[i]);
-                (void)memcpy(&g_Devices[i], &g_Devices[i + 1], (g_DeviceCount - i - 1) * sizeof(DEVICE_HEADER_DATA*));
-                g_DeviceCount--;
-                break;
-            }
+            DestroyDevice(g_Devices[i]);
+            (void)memmove(&g_Devices[i], &g_Devices[i + 1], (g_DeviceCount - i - 1) * sizeof(DEVICE_HEADER_DATA*));
+            g_DeviceCount--;
         }
 
         /*Codes_SRS_CODEFIRST_02_039: [ If the current device count is zero then CodeFirst_DestroyDevice shall deallocate all other used resources. ]*/
@@ -999,25 +1507,34 @@ void CodeFirst_DestroyDevice(void* device)
         {
             free(g_Devices);
             g_Devices = NULL;
+            DestroyMetadataIndexes();
             g_state = CODEFIRST_STATE_NOT_INIT;
+            destroyLock = true;
+        }
+        UnlockDevices();
+
+        if (destroyLock)
+        {
+            (void)Lock_Deinit(g_DevicesLock);
+            g_DevicesLock = NULL;
         }
     }
 }
 
 static DEVICE_HEADER_DATA* FindDevice(void* value)
 {
-    size_t i;
     DEVICE_HEADER_DATA* result = NULL;
+    size_t i;
 
-    for (i = 0; i < g_DeviceCount; i++)
+    LockDevices();
+    /*device data blocks do not overlap, so the only candidate is the last device starting at or before value*/
+    i = FindDeviceUpperBound((unsigned char*)value);
+    if ((i > 0) &&
+        (g_Devices[i - 1]->data + g_Devices[i - 1]->DataSize > (unsigned char*)value))
     {
-        if ((g_Devices[i]->data <= (unsigned char*)value) &&
-            (g_Devices[i]->data + g_Devices[i]->DataSize > (unsigned char*)value))
-        {
-            result = g_Devices[i];
-            break;
-        }
+        result = g_Devices[i - 1];
     }
+    UnlockDevices();
 
     return result;
 }
@@ -1027,25 +1544,16 @@ static const REFLECTED_SOMETHING* FindValue(DEVICE_HEADER_DATA* deviceHeader, vo
     const REFLECTED_SOMETHING* result;
     size_t valueOffset = (size_t)((unsigned char*)value - (unsigned char*)deviceHeader->data) - startOffset;
 
-    for (result = deviceHeader->ReflectedData->reflectedData; result != NULL; result = result->next)
+    result = FindField(deviceHeader, REFLECTION_PROPERTY_TYPE, modelName, valueOffset);
+    if (result != NULL)
     {
-        if (result->type == REFLECTION_PROPERTY_TYPE &&
-            (strcmp(result->what.property.modelName, modelName) == 0) &&
-            (result->what.property.offset <= valueOffset) &&
-            (result->what.property.offset + result->what.property.size > valueOffset))
+        if (startOffset != 0)
         {
-            if (startOffset != 0)
-            {
-                STRING_concat(valuePath, "/");
-            }
-
-            STRING_concat(valuePath, result->what.property.name);
-            break;
+            STRING_concat(valuePath, "/");
         }
-    }
 
-    if (result != NULL)
-    {
+        STRING_concat(valuePath, result->what.property.name);
+
         /* Codes_SRS_CODEFIRST_99_133:[CodeFirst_SendAsync shall allow sending of properties that are part of a child model.] */
         if (result->what.property.offset < valueOffset)
         {
@@ -1056,55 +1564,192 @@ static const REFLECTED_SOMETHING* FindValue(DEVICE_HEADER_DATA* deviceHeader, vo
 
     return result;
 }
-
 static const REFLECTED_SOMETHING* FindReportedProperty(DEVICE_HEADER_DATA* deviceHeader, void* value, const char* modelName, size_t startOffset, STRING_HANDLE valuePath)
 {
     const REFLECTED_SOMETHING* result;
     size_t valueOffset = (size_t)((unsigned char*)value - (unsigned char*)deviceHeader->data) - startOffset;
 
-    for (result = deviceHeader->ReflectedData->reflectedData; result != NULL; result = result->next)
+    result = FindField(deviceHeader, REFLECTION_REPORTED_PROPERTY_TYPE, modelName, valueOffset);
+    if (result != NULL)
+    {
+        if ((startOffset != 0) &&
+            (STRING_concat(valuePath, "/") != 0))
+        {
+            LogError("unable to STRING_concat");
+            result = NULL;
+        }
+        else if (STRING_concat(valuePath, result->what.reportedProperty.name) != 0)
+        {
+            LogError("unable to STRING_concat");
+            result = NULL;
+        }
+        /* Codes_SRS_CODEFIRST_99_133:[CodeFirst_SendAsync shall allow sending of properties that are part of a child model.] */
+        else if (result->what.reportedProperty.offset < valueOffset)
+        {
+            /* find recursively the property in the inner model, if there is one */
+            result = FindReportedProperty(deviceHeader, value, result->what.reportedProperty.type, startOffset + result->what.reportedProperty.offset, valuePath);
+        }
+    }
+
+    return result;
+}
+
+/* Codes_SRS_CODEFIRST_99_130:[If a pointer to the beginning of a device block is passed to CodeFirst_SendAsync instead of a pointer to a property, CodeFirst_SendAsync shall send all the properties that belong to that device.] */
+/* Codes_SRS_CODEFIRST_99_131:[The properties shall be given to Device as one transaction, as if they were all passed as individual arguments to Code_First.] */
+static CODEFIRST_RESULT SendAllDeviceProperties(DEVICE_HEADER_DATA* deviceHeader, TRANSACTION_HANDLE transaction)
+{
+    const char* modelName = Schema_GetModelName(deviceHeader->ModelHandle);
+    const REFLECTED_SOMETHING* something;
+    unsigned char* deviceAddress = (unsigned char*)deviceHeader->data;
+    CODEFIRST_RESULT result = CODEFIRST_OK;
+
+    for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
     {
-        if (result->type == REFLECTION_REPORTED_PROPERTY_TYPE &&
-            (strcmp(result->what.reportedProperty.modelName, modelName) == 0) &&
-            (result->what.reportedProperty.offset <= valueOffset) &&
-            (result->what.reportedProperty.offset + result->what.reportedProperty.size > valueOffset))
+        if ((something->type == REFLECTION_PROPERTY_TYPE) &&
+            (strcmp(something->what.property.modelName, modelName) == 0))
         {
-            if (startOffset != 0)
+            AGENT_DATA_TYPE agentDataType;
+
+            /* Codes_SRS_CODEFIRST_99_097:[For each value marshalling to AGENT_DATA_TYPE shall be performed.] */
+            /* Codes_SRS_CODEFIRST_99_098:[The marshalling shall be done by calling the Create_AGENT_DATA_TYPE_from_Ptr function associated with the property.] */
+            if (something->what.property.Create_AGENT_DATA_TYPE_from_Ptr(deviceAddress + something->what.property.offset, &agentDataType) != AGENT_DATA_TYPES_OK)
+            {
+                /* Codes_SRS_CODEFIRST_99_099:[If Create_AGENT_DATA_TYPE_from_Ptr fails, CodeFirst_SendAsync shall return CODEFIRST_AGENT_DATA_TYPE_ERROR.] */
+                result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+                LOG_CODEFIRST_ERROR;
+                break;
+            }
+            else
             {
-                if (STRING_concat(valuePath, "/") != 0)
+                /* Codes_SRS_CODEFIRST_99_092:[CodeFirst shall publish each value by using Device_PublishTransacted.] */
+                if (Device_PublishTransacted(transaction, something->what.property.name, &agentDataType) != DEVICE_OK)
                 {
-                    LogError("unable to STRING_concat");
-                    result = NULL;
+                    Destroy_AGENT_DATA_TYPE(&agentDataType);
+
+                    /* Codes_SRS_CODEFIRST_99_094:[If any Device API fail, CodeFirst_SendAsync shall return CODEFIRST_DEVICE_PUBLISH_FAILED.] */
+                    result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+                    LOG_CODEFIRST_ERROR;
                     break;
                 }
-            }
 
-            if (STRING_concat(valuePath, result->what.reportedProperty.name) != 0)
-            {
-                LogError("unable to STRING_concat");
-                result = NULL;
-                break;
+                Destroy_AGENT_DATA_TYPE(&agentDataType);
             }
+        }
+    }
+
+    return result;
+}
+
+static REPORTED_PROPERTY_SHADOW* GetReportedPropertyShadow(DEVICE_HEADER_DATA* deviceHeader, const char* path)
+{
+    REPORTED_PROPERTY_SHADOW* result = NULL;
+    size_t i;
+    for (i = 0; i < deviceHeader->ReportedShadowCount; i++)
+    {
+        if (strcmp(deviceHeader->ReportedShadows[i].Path, path) == 0)
+        {
+            result = &deviceHeader->ReportedShadows[i];
             break;
         }
     }
 
-    if (result != NULL)
+    if (result == NULL)
     {
-        /* Codes_SRS_CODEFIRST_99_133:[CodeFirst_SendAsync shall allow sending of properties that are part of a child model.] */
-        if (result->what.reportedProperty.offset < valueOffset)
+        REPORTED_PROPERTY_SHADOW* newShadows;
+        char* pathCopy;
+        if (mallocAndStrcpy_s(&pathCopy, path) != 0)
         {
-            /* find recursively the property in the inner model, if there is one */
-            result = FindReportedProperty(deviceHeader, value, result->what.reportedProperty.type, startOffset + result->what.reportedProperty.offset, valuePath);
+            LogError("unable to copy the reported property path %s", path);
+        }
+        else if ((newShadows = (REPORTED_PROPERTY_SHADOW*)realloc(deviceHeader->ReportedShadows, sizeof(REPORTED_PROPERTY_SHADOW) * (deviceHeader->ReportedShadowCount + 1))) == NULL)
+        {
+            LogError("unable to grow the reported properties shadow");
+            free(pathCopy);
+        }
+        else
+        {
+            deviceHeader->ReportedShadows = newShadows;
+            result = &newShadows[deviceHeader->ReportedShadowCount];
+            result->Path = pathCopy;
+            result->Acknowledged = NULL;
+            result->Sent = NULL;
+            deviceHeader->ReportedShadowCount++;
         }
     }
 
     return result;
 }
 
-/* Codes_SRS_CODEFIRST_99_130:[If a pointer to the beginning of a device block is passed to CodeFirst_SendAsync instead of a pointer to a property, CodeFirst_SendAsync shall send all the properties that belong to that device.] */
-/* Codes_SRS_CODEFIRST_99_131:[The properties shall be given to Device as one transaction, as if they were all passed as individual arguments to Code_First.] */
-static CODEFIRST_RESULT SendAllDeviceProperties(DEVICE_HEADER_DATA* deviceHeader, TRANSACTION_HANDLE transaction)
+/*publishes one reported property; in delta mode the property is published only if its value differs from the acknowledged one*/
+static CODEFIRST_RESULT PublishReportedProperty(DEVICE_HEADER_DATA* deviceHeader, REPORTED_PROPERTIES_TRANSACTION_HANDLE transaction, const char* path, const AGENT_DATA_TYPE* value, bool delta, size_t* publishedCount)
+{
+    CODEFIRST_RESULT result;
+    if (!delta)
+    {
+        if (Device_PublishTransacted_ReportedProperty(transaction, path, value) != DEVICE_OK)
+        {
+            result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+            LOG_CODEFIRST_ERROR;
+        }
+        else
+        {
+            (*publishedCount)++;
+            result = CODEFIRST_OK;
+        }
+    }
+    else
+    {
+        STRING_HANDLE valueText;
+        if ((valueText = STRING_new()) == NULL)
+        {
+            result = CODEFIRST_ERROR;
+            LOG_CODEFIRST_ERROR;
+        }
+        else
+        {
+            REPORTED_PROPERTY_SHADOW* shadow;
+            char* sent;
+            if (AgentDataTypes_ToString(valueText, value) != AGENT_DATA_TYPES_OK)
+            {
+                result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+                LOG_CODEFIRST_ERROR;
+            }
+            else if ((shadow = GetReportedPropertyShadow(deviceHeader, path)) == NULL)
+            {
+                result = CODEFIRST_ERROR;
+                LOG_CODEFIRST_ERROR;
+            }
+            /*Codes_SRS_CODEFIRST_41_009: [ CodeFirst_SendAsyncReportedDelta shall skip the reported properties whose value is the same as the last acknowledged one. ]*/
+            else if ((shadow->Acknowledged != NULL) && (strcmp(shadow->Acknowledged, STRING_c_str(valueText)) == 0))
+            {
+                result = CODEFIRST_OK;
+            }
+            else if (mallocAndStrcpy_s(&sent, STRING_c_str(valueText)) != 0)
+            {
+                result = CODEFIRST_ERROR;
+                LOG_CODEFIRST_ERROR;
+            }
+            else if (Device_PublishTransacted_ReportedProperty(transaction, path, value) != DEVICE_OK)
+            {
+                free(sent);
+                result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+                LOG_CODEFIRST_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_CODEFIRST_41_010: [ CodeFirst_SendAsyncReportedDelta shall remember the values it publishes until CodeFirst_AcknowledgeReportedPropertiesDelta is called. ]*/
+                free(shadow->Sent);
+                shadow->Sent = sent;
+                (*publishedCount)++;
+                result = CODEFIRST_OK;
+            }
+            STRING_delete(valueText);
+        }
+    }
+    return result;
+}
+
+static CODEFIRST_RESULT SendAllDeviceReportedProperties(DEVICE_HEADER_DATA* deviceHeader, REPORTED_PROPERTIES_TRANSACTION_HANDLE transaction, bool delta, size_t* publishedCount)
 {
     const char* modelName = Schema_GetModelName(deviceHeader->ModelHandle);
     const REFLECTED_SOMETHING* something;
@@ -1113,256 +1758,924 @@ static CODEFIRST_RESULT SendAllDeviceProperties(DEVICE_HEADER_DATA* deviceHeader
 
     for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
     {
-        if ((something->type == REFLECTION_PROPERTY_TYPE) &&
-            (strcmp(something->what.property.modelName, modelName) == 0))
+        if ((something->type == REFLECTION_REPORTED_PROPERTY_TYPE) &&
+            (strcmp(something->what.reportedProperty.modelName, modelName) == 0))
+        {
+            AGENT_DATA_TYPE agentDataType;
+
+            if (something->what.reportedProperty.Create_AGENT_DATA_TYPE_from_Ptr(deviceAddress + something->what.reportedProperty.offset, &agentDataType) != AGENT_DATA_TYPES_OK)
+            {
+                result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+                LOG_CODEFIRST_ERROR;
+                break;
+            }
+            else
+            {
+                result = PublishReportedProperty(deviceHeader, transaction, something->what.reportedProperty.name, &agentDataType, delta, publishedCount);
+                Destroy_AGENT_DATA_TYPE(&agentDataType);
+                if (result != CODEFIRST_OK)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+
+/*the longest text a directly serialized value can have: a double is printed by AgentDataTypes_ToString in DECIMAL_DIG*2 characters at most*/
+#define DIRECT_SERIALIZATION_MAX_VALUE_LENGTH (DECIMAL_DIG * 2 + 2)
+
+typedef struct DIRECT_SERIALIZATION_VALUE_TAG
+{
+    const REFLECTED_SOMETHING* property;
+    const void* value;
+} DIRECT_SERIALIZATION_VALUE;
+
+static bool g_DirectSerialization = false;
+
+void CodeFirst_SetDirectSerialization(bool directSerialization)
+{
+    /*Codes_SRS_CODEFIRST_41_001: [ CodeFirst_SetDirectSerialization shall set whether CodeFirst_SendAsync serializes top level properties directly to the output buffer. ]*/
+    g_DirectSerialization = directSerialization;
+}
+
+static bool g_CBOREncoding = false;
+
+void CodeFirst_SetCBOREncoding(bool cborEncoding)
+{
+    /*Codes_SRS_CODEFIRST_41_007: [ CodeFirst_SetCBOREncoding shall set whether the data sent by CodeFirst_SendAsync is encoded as CBOR; the direct serialization path shall not be used while it is set, since it only writes JSON. ]*/
+    g_CBOREncoding = cborEncoding;
+}
+
+static size_t WriteInt64(char* destination, int64_t value)
+{
+    char digits[20];
+    size_t nDigits = 0;
+    size_t pos = 0;
+    uint64_t positiveValue;
+
+    if (value < 0)
+    {
+        destination[pos++] = '-';
+        positiveValue = (uint64_t)0 - (uint64_t)value;
+    }
+    else
+    {
+        positiveValue = (uint64_t)value;
+    }
+
+    do
+    {
+        digits[nDigits++] = (char)('0' + (positiveValue % 10));
+        positiveValue /= 10;
+    } while (positiveValue != 0);
+
+    while (nDigits > 0)
+    {
+        destination[pos++] = digits[--nDigits];
+    }
+
+    return pos;
+}
+
+#ifndef NO_FLOATS
+static int WriteDouble(char* destination, double value, int precision, size_t maxLength)
+{
+    int result;
+
+    if (ISNAN(value))
+    {
+        (void)memcpy(destination, "NaN", 3);
+        result = 3;
+    }
+    else if (ISNEGATIVEINFINITY(value))
+    {
+        (void)memcpy(destination, "-INF", 4);
+        result = 4;
+    }
+    else if (ISPOSITIVEINFINITY(value))
+    {
+        (void)memcpy(destination, "INF", 3);
+        result = 3;
+    }
+    else
+    {
+        char temp[DIRECT_SERIALIZATION_MAX_VALUE_LENGTH];
+        result = sprintf_s(temp, maxLength, "%.*f", precision, value);
+        if (result > 0)
+        {
+            (void)memcpy(destination, temp, result);
+        }
+    }
+
+    return result;
+}
+#endif
+
+/*writes the value the same way AgentDataTypes_ToString would after Create_AGENT_DATA_TYPE_from_Ptr, for the types that need no
+  allocation to be printed. Returns the number of characters written, or -1 when the type has to go through the agent type system*/
+static int WriteDirectValue(char* destination, const char* type, const void* value)
+{
+    int result;
+
+    if ((strcmp(type, "int") == 0) || (strcmp(type, "int32_t") == 0))
+    {
+        result = (int)WriteInt64(destination, *(const int32_t*)value);
+    }
+    else if (strcmp(type, "long") == 0)
+    {
+        result = (int)WriteInt64(destination, *(const long*)value);
+    }
+    else if (strcmp(type, "int64_t") == 0)
+    {
+        result = (int)WriteInt64(destination, *(const int64_t*)value);
+    }
+    else if (strcmp(type, "int16_t") == 0)
+    {
+        result = (int)WriteInt64(destination, *(const int16_t*)value);
+    }
+    else if (strcmp(type, "int8_t") == 0)
+    {
+        result = (int)WriteInt64(destination, *(const int8_t*)value);
+    }
+    else if (strcmp(type, "uint8_t") == 0)
+    {
+        result = (int)WriteInt64(destination, *(const uint8_t*)value);
+    }
+    else if ((strcmp(type, "bool") == 0) || (strcmp(type, "_Bool") == 0))
+    {
+        if (*(const bool*)value)
+        {
+            (void)memcpy(destination, "true", 4);
+            result = 4;
+        }
+        else
+        {
+            (void)memcpy(destination, "false", 5);
+            result = 5;
+        }
+    }
+#ifndef NO_FLOATS
+    else if (strcmp(type, "double") == 0)
+    {
+        result = WriteDouble(destination, *(const double*)value, DBL_DIG, DECIMAL_DIG * 2);
+    }
+    else if (strcmp(type, "float") == 0)
+    {
+        result = WriteDouble(destination, (double)*(const float*)value, FLT_DIG, DIRECT_SERIALIZATION_MAX_VALUE_LENGTH);
+    }
+#endif
+    else
+    {
+        result = -1;
+    }
+
+    return result;
+}
+
+/*serializes the values to JSON straight from the reflected metadata, without a transaction, a MULTITREE or any AGENT_DATA_TYPE.
+  Only top level properties of numeric and boolean types are handled this way. For anything else (a whole device, a property of a
+  child model or of a struct, strings, EDM types, values of different devices...) this returns false and CodeFirst_SendAsync goes
+  through the Device module, which produces the same JSON or reports the error*/
+static bool SendAsyncDirect(unsigned char** destination, size_t* destinationSize, size_t numProperties, va_list ap)
+{
+    bool result;
+    DIRECT_SERIALIZATION_VALUE* values;
+
+    if ((values = (DIRECT_SERIALIZATION_VALUE*)malloc(numProperties * sizeof(DIRECT_SERIALIZATION_VALUE))) == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        DEVICE_HEADER_DATA* deviceHeader = NULL;
+        const char* modelName = NULL;
+        size_t nValues = 0;
+        size_t payloadSize = 2; /* { and } */
+        size_t i;
+
+        for (i = 0; i < numProperties; i++)
+        {
+            void* value = va_arg(ap, void*);
+            DEVICE_HEADER_DATA* currentValueDeviceHeader = FindDevice(value);
+            const REFLECTED_SOMETHING* something = NULL;
+            size_t valueOffset;
+            size_t j;
+
+            if ((currentValueDeviceHeader == NULL) ||
+                ((deviceHeader != NULL) && (currentValueDeviceHeader != deviceHeader)) ||
+                (value == (void*)currentValueDeviceHeader->data))
+            {
+                break;
+            }
+
+            if (deviceHeader == NULL)
+            {
+                deviceHeader = currentValueDeviceHeader;
+                if ((modelName = Schema_GetModelName(deviceHeader->ModelHandle)) == NULL)
+                {
+                    break;
+                }
+            }
+
+            valueOffset = (size_t)((unsigned char*)value - deviceHeader->data);
+            for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
+            {
+                if ((something->type == REFLECTION_PROPERTY_TYPE) &&
+                    (something->what.property.offset == valueOffset) &&
+                    (strcmp(something->what.property.modelName, modelName) == 0))
+                {
+                    break;
+                }
+            }
+
+            if (something == NULL)
+            {
+                break;
+            }
+
+            /*the Device module keeps a property passed twice where it was first published*/
+            for (j = 0; j < nValues; j++)
+            {
+                if (values[j].property == something)
+                {
+                    break;
+                }
+            }
+
+            if (j == nValues)
+            {
+                values[nValues].property = something;
+                values[nValues].value = value;
+                nValues++;
+                /* "name": and the ", " separating it from the previous value */
+                payloadSize += strlen(something->what.property.name) + 5 + DIRECT_SERIALIZATION_MAX_VALUE_LENGTH;
+            }
+        }
+
+        if (i < numProperties)
+        {
+            result = false;
+        }
+        else
+        {
+            char* payload = (char*)malloc(payloadSize);
+            if (payload == NULL)
+            {
+                result = false;
+            }
+            else
+            {
+                size_t pos = 0;
+                payload[pos++] = '{';
+
+                for (i = 0; i < nValues; i++)
+                {
+                    const char* name = values[i].property->what.property.name;
+                    size_t nameLength = strlen(name);
+                    int valueLength;
+
+                    if (i > 0)
+                    {
+                        payload[pos++] = ',';
+                        payload[pos++] = ' ';
+                    }
+                    payload[pos++] = '\"';
+                    (void)memcpy(payload + pos, name, nameLength);
+                    pos += nameLength;
+                    payload[pos++] = '\"';
+                    payload[pos++] = ':';
+
+                    if ((valueLength = WriteDirectValue(payload + pos, values[i].property->what.property.type, values[i].value)) < 0)
+                    {
+                        break;
+                    }
+                    pos += valueLength;
+                }
+
+                if (i < nValues)
+                {
+                    free(payload);
+                    result = false;
+                }
+                else
+                {
+                    payload[pos++] = '}';
+                    *destination = (unsigned char*)payload;
+                    *destinationSize = pos;
+                    result = true;
+                }
+            }
+        }
+
+        free(values);
+    }
+
+    return result;
+}
+
+/*sends the values through the Device module, ap yields numProperties pointers to values*/
+static CODEFIRST_RESULT SendAsyncThroughDevice(unsigned char** destination, size_t* destinationSize, size_t numProperties, va_list ap)
+{
+    CODEFIRST_RESULT result = CODEFIRST_OK;
+    DEVICE_HEADER_DATA* deviceHeader = NULL;
+    size_t i;
+    TRANSACTION_HANDLE transaction = NULL;
+
+    /* Codes_SRS_CODEFIRST_99_105:[The properties are passed as pointers to the memory locations where the data exists in the device block allocated by CodeFirst_CreateDevice.] */
+    /* Codes_SRS_CODEFIRST_99_089:[The numProperties argument shall indicate how many properties are to be sent.] */
+    for (i = 0; i < numProperties; i++)
+    {
+        void* value = (void*)va_arg(ap, void*);
+
+        /* Codes_SRS_CODEFIRST_99_095:[For each value passed to it, CodeFirst_SendAsync shall look up to which device the value belongs.] */
+        DEVICE_HEADER_DATA* currentValueDeviceHeader = FindDevice(value);
+        if (currentValueDeviceHeader == NULL)
+        {
+            /* Codes_SRS_CODEFIRST_99_104:[If a property cannot be associated with a device, CodeFirst_SendAsync shall return CODEFIRST_INVALID_ARG.] */
+            result = CODEFIRST_INVALID_ARG;
+            LOG_CODEFIRST_ERROR;
+            break;
+        }
+        else if ((deviceHeader != NULL) &&
+            (currentValueDeviceHeader != deviceHeader))
+        {
+            /* Codes_SRS_CODEFIRST_99_096:[All values have to belong to the same device, otherwise CodeFirst_SendAsync shall return CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR.] */
+            result = CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR;
+            LOG_CODEFIRST_ERROR;
+            break;
+        }
+        /* Codes_SRS_CODEFIRST_99_090:[All the properties shall be sent together by using the transacted APIs of the device.] */
+        /* Codes_SRS_CODEFIRST_99_091:[CodeFirst_SendAsync shall start a transaction by calling Device_StartTransaction.] */
+        else if ((deviceHeader == NULL) &&
+            ((transaction = Device_StartTransaction(currentValueDeviceHeader->DeviceHandle)) == NULL))
+        {
+            /* Codes_SRS_CODEFIRST_99_094:[If any Device API fail, CodeFirst_SendAsync shall return CODEFIRST_DEVICE_PUBLISH_FAILED.] */
+            result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+            LOG_CODEFIRST_ERROR;
+            break;
+        }
+        else
+        {
+            deviceHeader = currentValueDeviceHeader;
+
+            if (value == ((unsigned char*)deviceHeader->data))
+            {
+                /* we got a full device, send all its state data */
+                result = SendAllDeviceProperties(deviceHeader, transaction);
+                if (result != CODEFIRST_OK)
+                {
+                    LOG_CODEFIRST_ERROR;
+                    break;
+                }
+            }
+            else
+            {
+                const REFLECTED_SOMETHING* propertyReflectedData;
+                const char* modelName;
+                STRING_HANDLE valuePath;
+
+                if ((valuePath = STRING_new()) == NULL)
+                {
+                    /* Codes_SRS_CODEFIRST_99_134:[If CodeFirst_Notify fails for any other reason it shall return CODEFIRST_ERROR.] */
+                    result = CODEFIRST_ERROR;
+                    LOG_CODEFIRST_ERROR;
+                    break;
+                }
+                else
+                {
+                    if ((modelName = Schema_GetModelName(deviceHeader->ModelHandle)) == NULL)
+                    {
+                        /* Codes_SRS_CODEFIRST_99_134:[If CodeFirst_Notify fails for any other reason it shall return CODEFIRST_ERROR.] */
+                        result = CODEFIRST_ERROR;
+                        LOG_CODEFIRST_ERROR;
+                        STRING_delete(valuePath);
+                        break;
+                    }
+                    else if ((propertyReflectedData = FindValue(deviceHeader, value, modelName, 0, valuePath)) == NULL)
+                    {
+                        /* Codes_SRS_CODEFIRST_99_104:[If a property cannot be associated with a device, CodeFirst_SendAsync shall return CODEFIRST_INVALID_ARG.] */
+                        result = CODEFIRST_INVALID_ARG;
+                        LOG_CODEFIRST_ERROR;
+                        STRING_delete(valuePath);
+                        break;
+                    }
+                    else
+                    {
+                        AGENT_DATA_TYPE agentDataType;
+
+                        /* Codes_SRS_CODEFIRST_99_097:[For each value marshalling to AGENT_DATA_TYPE shall be performed.] */
+                        /* Codes_SRS_CODEFIRST_99_098:[The marshalling shall be done by calling the Create_AGENT_DATA_TYPE_from_Ptr function associated with the property.] */
+                        if (propertyReflectedData->what.property.Create_AGENT_DATA_TYPE_from_Ptr(value, &agentDataType) != AGENT_DATA_TYPES_OK)
+                        {
+                            /* Codes_SRS_CODEFIRST_99_099:[If Create_AGENT_DATA_TYPE_from_Ptr fails, CodeFirst_SendAsync shall return CODEFIRST_AGENT_DATA_TYPE_ERROR.] */
+                            result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+                            LOG_CODEFIRST_ERROR;
+                            STRING_delete(valuePath);
+                            break;
+                        }
+                        else
+                        {
+                            /* Codes_SRS_CODEFIRST_99_092:[CodeFirst shall publish each value by using Device_PublishTransacted.] */
+                            /* Codes_SRS_CODEFIRST_99_136:[CodeFirst_SendAsync shall build the full path for each property and then pass it to Device_PublishTransacted.] */
+                            if (Device_PublishTransacted(transaction, STRING_c_str(valuePath), &agentDataType) != DEVICE_OK)
+                            {
+                                Destroy_AGENT_DATA_TYPE(&agentDataType);
+
+                                /* Codes_SRS_CODEFIRST_99_094:[If any Device API fail, CodeFirst_SendAsync shall return CODEFIRST_DEVICE_PUBLISH_FAILED.] */
+                                result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+                                LOG_CODEFIRST_ERROR;
+                                STRING_delete(valuePath);
+                                break;
+                            }
+                            else
+                            {
+                                STRING_delete(valuePath); /*anyway*/
+                            }
+
+                            Destroy_AGENT_DATA_TYPE(&agentDataType);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (i < numProperties)
+    {
+        if (transaction != NULL)
+        {
+            (void)Device_CancelTransaction(transaction);
+        }
+    }
+    /* Codes_SRS_CODEFIRST_99_093:[After all values have been published, Device_EndTransaction shall be called.] */
+    else if (Device_EndTransaction(transaction, destination, destinationSize) != DEVICE_OK)
+    {
+        /* Codes_SRS_CODEFIRST_99_094:[If any Device API fail, CodeFirst_SendAsync shall return CODEFIRST_DEVICE_PUBLISH_FAILED.] */
+        result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        /* Codes_SRS_CODEFIRST_99_117:[On success, CodeFirst_SendAsync shall return CODEFIRST_OK.] */
+        result = CODEFIRST_OK;
+    }
+
+    return result;
+}
+
+/* Codes_SRS_CODEFIRST_99_088:[CodeFirst_SendAsync shall send to the Device module a set of properties, a destination and a destinationSize.]*/
+CODEFIRST_RESULT CodeFirst_SendAsync(unsigned char** destination, size_t* destinationSize, size_t numProperties, ...)
+{
+    CODEFIRST_RESULT result;
+    va_list ap;
+
+    if (
+        (numProperties == 0) || 
+        (destination == NULL) || 
+        (destinationSize == NULL)
+        )
+    {
+        /* Codes_SRS_CODEFIRST_04_002: [If CodeFirst_SendAsync receives destination or destinationSize NULL, CodeFirst_SendAsync shall return Invalid Argument.]*/
+        /* Codes_SRS_CODEFIRST_99_103:[If CodeFirst_SendAsync is called with numProperties being zero, CODEFIRST_INVALID_ARG shall be returned.] */
+        result = CODEFIRST_INVALID_ARG;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_CODEFIRST_02_040: [ CodeFirst_SendAsync shall call CodeFirst_Init, passing NULL for overrideSchemaNamespace. ]*/
+        (void)CodeFirst_Init_impl(NULL, false); /*lazy init*/
+
+        bool sentDirectly = false;
+        if (g_DirectSerialization && !g_CBOREncoding)
+        {
+            /*Codes_SRS_CODEFIRST_41_002: [ When direct serialization is on and all the values are top level numeric or boolean properties of the same device, CodeFirst_SendAsync shall write the JSON straight to a buffer sized from the reflected metadata, without calling the Device module. ]*/
+            /*Codes_SRS_CODEFIRST_41_003: [ The JSON shall be the same the Device module produces for the same values. ]*/
+            va_start(ap, numProperties);
+            sentDirectly = SendAsyncDirect(destination, destinationSize, numProperties, ap);
+            va_end(ap);
+        }
+
+        if (sentDirectly)
+        {
+            result = CODEFIRST_OK;
+        }
+        else
+        {
+            /*Codes_SRS_CODEFIRST_41_004: [ Otherwise CodeFirst_SendAsync shall send the values through the Device module. ]*/
+            va_start(ap, numProperties);
+            result = SendAsyncThroughDevice(destination, destinationSize, numProperties, ap);
+            va_end(ap);
+        }
+        
+    }
+
+    return result;
+}
+
+CODEFIRST_RESULT CodeFirst_SendAsyncHandOff(CODEFIRST_HAND_OFF handOff, void* handOffContext, size_t numProperties, ...)
+{
+    CODEFIRST_RESULT result;
+    va_list ap;
+
+    if ((handOff == NULL) || (numProperties == 0))
+    {
+        /*Codes_SRS_CODEFIRST_41_031: [ If handOff is NULL or numProperties is 0, CodeFirst_SendAsyncHandOff shall return CODEFIRST_INVALID_ARG. ]*/
+        result = CODEFIRST_INVALID_ARG;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        unsigned char* destination;
+        size_t destinationSize;
+        bool sentDirectly = false;
+
+        (void)CodeFirst_Init_impl(NULL, false); /*lazy init*/
+
+        /*Codes_SRS_CODEFIRST_41_032: [ CodeFirst_SendAsyncHandOff shall serialize the values as CodeFirst_SendAsync does. ]*/
+        if (g_DirectSerialization && !g_CBOREncoding)
+        {
+            va_start(ap, numProperties);
+            sentDirectly = SendAsyncDirect(&destination, &destinationSize, numProperties, ap);
+            va_end(ap);
+        }
+
+        if (sentDirectly)
+        {
+            result = CODEFIRST_OK;
+        }
+        else
+        {
+            va_start(ap, numProperties);
+            result = SendAsyncThroughDevice(&destination, &destinationSize, numProperties, ap);
+            va_end(ap);
+        }
+
+        if (result == CODEFIRST_OK)
+        {
+            /*Codes_SRS_CODEFIRST_41_033: [ CodeFirst_SendAsyncHandOff shall pass the serialized bytes, without copying them, to handOff, which takes them over when it returns 0. ]*/
+            if (handOff(handOffContext, destination, destinationSize) != 0)
+            {
+                /*Codes_SRS_CODEFIRST_41_034: [ If handOff returns a non-zero value, CodeFirst_SendAsyncHandOff shall free the serialized bytes and return CODEFIRST_ERROR. ]*/
+                LogError("the serialized data could not be handed off");
+                free(destination);
+                result = CODEFIRST_ERROR;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*a field of a batch is resolved once on the first instance and then read at the same offset of every instance*/
+typedef struct BATCH_FIELD_TAG
+{
+    size_t offset;
+    const REFLECTED_SOMETHING* property; /*NULL when the whole instance is sent*/
+    STRING_HANDLE path;
+} BATCH_FIELD;
+
+typedef struct BATCH_BUFFER_TAG
+{
+    unsigned char* bytes;
+    size_t size;
+    size_t capacity;
+} BATCH_BUFFER;
+
+static int AppendToBatch(BATCH_BUFFER* batch, const unsigned char* bytes, size_t size)
+{
+    int result;
+    if (batch->size + size > batch->capacity)
+    {
+        size_t newCapacity = (batch->capacity == 0) ? 64 : batch->capacity;
+        unsigned char* newBytes;
+        while (newCapacity < batch->size + size)
+        {
+            newCapacity *= 2;
+        }
+
+        if ((newBytes = (unsigned char*)realloc(batch->bytes, newCapacity)) == NULL)
+        {
+            LogError("failure growing the batch to %zu bytes", newCapacity);
+            result = __FAILURE__;
+        }
+        else
+        {
+            batch->bytes = newBytes;
+            batch->capacity = newCapacity;
+            (void)memcpy(batch->bytes + batch->size, bytes, size);
+            batch->size += size;
+            result = 0;
+        }
+    }
+    else
+    {
+        (void)memcpy(batch->bytes + batch->size, bytes, size);
+        batch->size += size;
+        result = 0;
+    }
+    return result;
+}
+
+/*a CBOR array is its item count followed by the items, a JSON array is [item, item]*/
+static int AppendBatchArrayHeader(BATCH_BUFFER* batch, size_t instanceCount)
+{
+    int result;
+    if (g_CBOREncoding)
+    {
+        unsigned char header[9];
+        size_t headerSize;
+        uint64_t count = (uint64_t)instanceCount;
+        size_t i;
+
+        if (count < 24)
+        {
+            header[0] = (unsigned char)(0x80 | count);
+            headerSize = 1;
+        }
+        else
+        {
+            size_t countSize = (count <= 0xFF) ? 1 : (count <= 0xFFFF) ? 2 : (count <= 0xFFFFFFFF) ? 4 : 8;
+            header[0] = (unsigned char)((countSize == 1) ? 0x98 : (countSize == 2) ? 0x99 : (countSize == 4) ? 0x9A : 0x9B);
+            for (i = 0; i < countSize; i++)
+            {
+                header[1 + i] = (unsigned char)(count >> (8 * (countSize - 1 - i)));
+            }
+            headerSize = 1 + countSize;
+        }
+        result = AppendToBatch(batch, header, headerSize);
+    }
+    else
+    {
+        result = AppendToBatch(batch, (const unsigned char*)"[", 1);
+    }
+    return result;
+}
+
+static void DestroyBatchFields(BATCH_FIELD* fields, size_t nFields)
+{
+    size_t i;
+    for (i = 0; i < nFields; i++)
+    {
+        if (fields[i].path != NULL)
+        {
+            STRING_delete(fields[i].path);
+        }
+    }
+    free(fields);
+}
+
+/*looks up the metadata of every field once, on the first instance of the batch*/
+static CODEFIRST_RESULT ResolveBatchFields(DEVICE_HEADER_DATA* deviceHeader, BATCH_FIELD* fields, size_t numProperties, size_t* nResolved, va_list ap)
+{
+    CODEFIRST_RESULT result = CODEFIRST_OK;
+    const char* modelName;
+    size_t i;
+
+    *nResolved = 0;
+    if ((modelName = Schema_GetModelName(deviceHeader->ModelHandle)) == NULL)
+    {
+        result = CODEFIRST_ERROR;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        for (i = 0; i < numProperties; i++)
         {
-            AGENT_DATA_TYPE agentDataType;
+            void* value = va_arg(ap, void*);
+            fields[i].path = NULL;
+            fields[i].property = NULL;
 
-            /* Codes_SRS_CODEFIRST_99_097:[For each value marshalling to AGENT_DATA_TYPE shall be performed.] */
-            /* Codes_SRS_CODEFIRST_99_098:[The marshalling shall be done by calling the Create_AGENT_DATA_TYPE_from_Ptr function associated with the property.] */
-            if (something->what.property.Create_AGENT_DATA_TYPE_from_Ptr(deviceAddress + something->what.property.offset, &agentDataType) != AGENT_DATA_TYPES_OK)
+            if (FindDevice(value) != deviceHeader)
             {
-                /* Codes_SRS_CODEFIRST_99_099:[If Create_AGENT_DATA_TYPE_from_Ptr fails, CodeFirst_SendAsync shall return CODEFIRST_AGENT_DATA_TYPE_ERROR.] */
-                result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+                /*Codes_SRS_CODEFIRST_41_024: [ The fields shall be pointers into the first instance; if one is not, CodeFirst_SendAsyncBatch shall return CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR. ]*/
+                result = CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR;
                 LOG_CODEFIRST_ERROR;
                 break;
             }
-            else
+
+            fields[i].offset = (size_t)((unsigned char*)value - deviceHeader->data);
+            (*nResolved)++;
+            if (fields[i].offset != 0)
             {
-                /* Codes_SRS_CODEFIRST_99_092:[CodeFirst shall publish each value by using Device_PublishTransacted.] */
-                if (Device_PublishTransacted(transaction, something->what.property.name, &agentDataType) != DEVICE_OK)
+                if ((fields[i].path = STRING_new()) == NULL)
                 {
-                    Destroy_AGENT_DATA_TYPE(&agentDataType);
-
-                    /* Codes_SRS_CODEFIRST_99_094:[If any Device API fail, CodeFirst_SendAsync shall return CODEFIRST_DEVICE_PUBLISH_FAILED.] */
-                    result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+                    result = CODEFIRST_ERROR;
+                    LOG_CODEFIRST_ERROR;
+                    break;
+                }
+                /*Codes_SRS_CODEFIRST_41_025: [ CodeFirst_SendAsyncBatch shall look up the property and build the path of every field only once, for the first instance. ]*/
+                else if ((fields[i].property = FindValue(deviceHeader, value, modelName, 0, fields[i].path)) == NULL)
+                {
+                    result = CODEFIRST_INVALID_ARG;
                     LOG_CODEFIRST_ERROR;
                     break;
                 }
-
-                Destroy_AGENT_DATA_TYPE(&agentDataType);
             }
         }
     }
-
     return result;
 }
 
-static CODEFIRST_RESULT SendAllDeviceReportedProperties(DEVICE_HEADER_DATA* deviceHeader, REPORTED_PROPERTIES_TRANSACTION_HANDLE transaction)
+static CODEFIRST_RESULT SerializeBatchInstance(DEVICE_HEADER_DATA* deviceHeader, const BATCH_FIELD* fields, size_t nFields, unsigned char** element, size_t* elementSize)
 {
-    const char* modelName = Schema_GetModelName(deviceHeader->ModelHandle);
-    const REFLECTED_SOMETHING* something;
-    unsigned char* deviceAddress = (unsigned char*)deviceHeader->data;
     CODEFIRST_RESULT result = CODEFIRST_OK;
+    TRANSACTION_HANDLE transaction;
 
-    for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
+    /*Codes_SRS_CODEFIRST_41_026: [ Every instance shall be serialized by its own Device transaction, publishing the value at the offset of each field with the path of that field. ]*/
+    if ((transaction = Device_StartTransaction(deviceHeader->DeviceHandle)) == NULL)
     {
-        if ((something->type == REFLECTION_REPORTED_PROPERTY_TYPE) &&
-            (strcmp(something->what.reportedProperty.modelName, modelName) == 0))
+        result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < nFields; i++)
         {
-            AGENT_DATA_TYPE agentDataType;
-
-            if (something->what.reportedProperty.Create_AGENT_DATA_TYPE_from_Ptr(deviceAddress + something->what.reportedProperty.offset, &agentDataType) != AGENT_DATA_TYPES_OK)
+            if (fields[i].property == NULL)
             {
-                result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
-                LOG_CODEFIRST_ERROR;
-                break;
+                if ((result = SendAllDeviceProperties(deviceHeader, transaction)) != CODEFIRST_OK)
+                {
+                    LOG_CODEFIRST_ERROR;
+                    break;
+                }
             }
             else
             {
-                if (Device_PublishTransacted_ReportedProperty(transaction, something->what.reportedProperty.name, &agentDataType) != DEVICE_OK)
+                AGENT_DATA_TYPE agentDataType;
+                if (fields[i].property->what.property.Create_AGENT_DATA_TYPE_from_Ptr(deviceHeader->data + fields[i].offset, &agentDataType) != AGENT_DATA_TYPES_OK)
                 {
-                    Destroy_AGENT_DATA_TYPE(&agentDataType);
-                    result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+                    result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
                     LOG_CODEFIRST_ERROR;
                     break;
                 }
-
-                Destroy_AGENT_DATA_TYPE(&agentDataType);
+                else
+                {
+                    DEVICE_RESULT publishResult = Device_PublishTransacted(transaction, STRING_c_str(fields[i].path), &agentDataType);
+                    Destroy_AGENT_DATA_TYPE(&agentDataType);
+                    if (publishResult != DEVICE_OK)
+                    {
+                        result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+                        LOG_CODEFIRST_ERROR;
+                        break;
+                    }
+                }
             }
         }
-    }
 
+        if (i < nFields)
+        {
+            (void)Device_CancelTransaction(transaction);
+        }
+        else if (Device_EndTransaction(transaction, element, elementSize) != DEVICE_OK)
+        {
+            result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+            LOG_CODEFIRST_ERROR;
+        }
+        else
+        {
+            result = CODEFIRST_OK;
+        }
+    }
     return result;
 }
 
-
-/* Codes_SRS_CODEFIRST_99_088:[CodeFirst_SendAsync shall send to the Device module a set of properties, a destination and a destinationSize.]*/
-CODEFIRST_RESULT CodeFirst_SendAsync(unsigned char** destination, size_t* destinationSize, size_t numProperties, ...)
+CODEFIRST_RESULT CodeFirst_SendAsyncBatch(unsigned char** destination, size_t* destinationSize, void* const* instances, size_t instanceCount, size_t numProperties, ...)
 {
     CODEFIRST_RESULT result;
-    va_list ap;
 
+    /*Codes_SRS_CODEFIRST_41_022: [ If destination, destinationSize or instances is NULL, or instanceCount or numProperties is 0, CodeFirst_SendAsyncBatch shall return CODEFIRST_INVALID_ARG. ]*/
     if (
-        (numProperties == 0) || 
-        (destination == NULL) || 
-        (destinationSize == NULL)
+        (destination == NULL) ||
+        (destinationSize == NULL) ||
+        (instances == NULL) ||
+        (instanceCount == 0) ||
+        (numProperties == 0)
         )
     {
-        /* Codes_SRS_CODEFIRST_04_002: [If CodeFirst_SendAsync receives destination or destinationSize NULL, CodeFirst_SendAsync shall return Invalid Argument.]*/
-        /* Codes_SRS_CODEFIRST_99_103:[If CodeFirst_SendAsync is called with numProperties being zero, CODEFIRST_INVALID_ARG shall be returned.] */
+        LogError("invalid argument unsigned char** destination=%p, size_t* destinationSize=%p, void* const* instances=%p, size_t instanceCount=%zu, size_t numProperties=%zu", destination, destinationSize, instances, instanceCount, numProperties);
         result = CODEFIRST_INVALID_ARG;
-        LOG_CODEFIRST_ERROR;
     }
     else
     {
-        /*Codes_SRS_CODEFIRST_02_040: [ CodeFirst_SendAsync shall call CodeFirst_Init, passing NULL for overrideSchemaNamespace. ]*/
-        (void)CodeFirst_Init_impl(NULL, false); /*lazy init*/
-        
-        DEVICE_HEADER_DATA* deviceHeader = NULL;
-        size_t i;
-        TRANSACTION_HANDLE transaction = NULL;
-        result = CODEFIRST_OK;
+        DEVICE_HEADER_DATA* firstDeviceHeader;
+        BATCH_FIELD* fields;
 
-        /* Codes_SRS_CODEFIRST_99_105:[The properties are passed as pointers to the memory locations where the data exists in the device block allocated by CodeFirst_CreateDevice.] */
-        va_start(ap, numProperties);
+        (void)CodeFirst_Init_impl(NULL, false); /*lazy init*/
 
-        /* Codes_SRS_CODEFIRST_99_089:[The numProperties argument shall indicate how many properties are to be sent.] */
-        for (i = 0; i < numProperties; i++)
+        /*Codes_SRS_CODEFIRST_41_023: [ Every instance shall be a device created by CodeFirst_CreateDevice with the same model and metadata as the first one, otherwise CodeFirst_SendAsyncBatch shall return CODEFIRST_INVALID_ARG. ]*/
+        if (((firstDeviceHeader = FindDevice(instances[0])) == NULL) ||
+            (firstDeviceHeader->data != (unsigned char*)instances[0]))
         {
-            void* value = (void*)va_arg(ap, void*);
+            result = CODEFIRST_INVALID_ARG;
+            LOG_CODEFIRST_ERROR;
+        }
+        else if ((fields = (BATCH_FIELD*)malloc(numProperties * sizeof(BATCH_FIELD))) == NULL)
+        {
+            result = CODEFIRST_ERROR;
+            LOG_CODEFIRST_ERROR;
+        }
+        else
+        {
+            size_t nFields;
+            va_list ap;
 
-            /* Codes_SRS_CODEFIRST_99_095:[For each value passed to it, CodeFirst_SendAsync shall look up to which device the value belongs.] */
-            DEVICE_HEADER_DATA* currentValueDeviceHeader = FindDevice(value);
-            if (currentValueDeviceHeader == NULL)
-            {
-                /* Codes_SRS_CODEFIRST_99_104:[If a property cannot be associated with a device, CodeFirst_SendAsync shall return CODEFIRST_INVALID_ARG.] */
-                result = CODEFIRST_INVALID_ARG;
-                LOG_CODEFIRST_ERROR;
-                break;
-            }
-            else if ((deviceHeader != NULL) &&
-                (currentValueDeviceHeader != deviceHeader))
-            {
-                /* Codes_SRS_CODEFIRST_99_096:[All values have to belong to the same device, otherwise CodeFirst_SendAsync shall return CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR.] */
-                result = CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR;
-                LOG_CODEFIRST_ERROR;
-                break;
-            }
-            /* Codes_SRS_CODEFIRST_99_090:[All the properties shall be sent together by using the transacted APIs of the device.] */
-            /* Codes_SRS_CODEFIRST_99_091:[CodeFirst_SendAsync shall start a transaction by calling Device_StartTransaction.] */
-            else if ((deviceHeader == NULL) &&
-                ((transaction = Device_StartTransaction(currentValueDeviceHeader->DeviceHandle)) == NULL))
-            {
-                /* Codes_SRS_CODEFIRST_99_094:[If any Device API fail, CodeFirst_SendAsync shall return CODEFIRST_DEVICE_PUBLISH_FAILED.] */
-                result = CODEFIRST_DEVICE_PUBLISH_FAILED;
-                LOG_CODEFIRST_ERROR;
-                break;
-            }
-            else
+            va_start(ap, numProperties);
+            result = ResolveBatchFields(firstDeviceHeader, fields, numProperties, &nFields, ap);
+            va_end(ap);
+
+            if (result == CODEFIRST_OK)
             {
-                deviceHeader = currentValueDeviceHeader;
+                BATCH_BUFFER batch = { NULL, 0, 0 };
+                size_t i;
 
-                if (value == ((unsigned char*)deviceHeader->data))
+                if (AppendBatchArrayHeader(&batch, instanceCount) != 0)
                 {
-                    /* we got a full device, send all its state data */
-                    result = SendAllDeviceProperties(deviceHeader, transaction);
-                    if (result != CODEFIRST_OK)
-                    {
-                        LOG_CODEFIRST_ERROR;
-                        break;
-                    }
+                    result = CODEFIRST_ERROR;
+                    LOG_CODEFIRST_ERROR;
                 }
                 else
                 {
-                    const REFLECTED_SOMETHING* propertyReflectedData;
-                    const char* modelName;
-                    STRING_HANDLE valuePath;
-
-                    if ((valuePath = STRING_new()) == NULL)
-                    {
-                        /* Codes_SRS_CODEFIRST_99_134:[If CodeFirst_Notify fails for any other reason it shall return CODEFIRST_ERROR.] */
-                        result = CODEFIRST_ERROR;
-                        LOG_CODEFIRST_ERROR;
-                        break;
-                    }
-                    else
+                    for (i = 0; i < instanceCount; i++)
                     {
-                        if ((modelName = Schema_GetModelName(deviceHeader->ModelHandle)) == NULL)
+                        DEVICE_HEADER_DATA* deviceHeader = (i == 0) ? firstDeviceHeader : FindDevice(instances[i]);
+                        unsigned char* element;
+                        size_t elementSize;
+
+                        /*Codes_SRS_CODEFIRST_41_023: [ Every instance shall be a device created by CodeFirst_CreateDevice with the same model and metadata as the first one, otherwise CodeFirst_SendAsyncBatch shall return CODEFIRST_INVALID_ARG. ]*/
+                        if ((deviceHeader == NULL) ||
+                            (deviceHeader->data != (unsigned char*)instances[i]) ||
+                            (deviceHeader->ModelHandle != firstDeviceHeader->ModelHandle) ||
+                            (deviceHeader->ReflectedData != firstDeviceHeader->ReflectedData))
                         {
-                            /* Codes_SRS_CODEFIRST_99_134:[If CodeFirst_Notify fails for any other reason it shall return CODEFIRST_ERROR.] */
-                            result = CODEFIRST_ERROR;
+                            result = CODEFIRST_INVALID_ARG;
                             LOG_CODEFIRST_ERROR;
-                            STRING_delete(valuePath);
                             break;
                         }
-                        else if ((propertyReflectedData = FindValue(deviceHeader, value, modelName, 0, valuePath)) == NULL)
+                        else if ((result = SerializeBatchInstance(deviceHeader, fields, nFields, &element, &elementSize)) != CODEFIRST_OK)
                         {
-                            /* Codes_SRS_CODEFIRST_99_104:[If a property cannot be associated with a device, CodeFirst_SendAsync shall return CODEFIRST_INVALID_ARG.] */
-                            result = CODEFIRST_INVALID_ARG;
                             LOG_CODEFIRST_ERROR;
-                            STRING_delete(valuePath);
                             break;
                         }
                         else
                         {
-                            AGENT_DATA_TYPE agentDataType;
-
-                            /* Codes_SRS_CODEFIRST_99_097:[For each value marshalling to AGENT_DATA_TYPE shall be performed.] */
-                            /* Codes_SRS_CODEFIRST_99_098:[The marshalling shall be done by calling the Create_AGENT_DATA_TYPE_from_Ptr function associated with the property.] */
-                            if (propertyReflectedData->what.property.Create_AGENT_DATA_TYPE_from_Ptr(value, &agentDataType) != AGENT_DATA_TYPES_OK)
-                            {
-                                /* Codes_SRS_CODEFIRST_99_099:[If Create_AGENT_DATA_TYPE_from_Ptr fails, CodeFirst_SendAsync shall return CODEFIRST_AGENT_DATA_TYPE_ERROR.] */
-                                result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
-                                LOG_CODEFIRST_ERROR;
-                                STRING_delete(valuePath);
-                                break;
-                            }
-                            else
+                            /*Codes_SRS_CODEFIRST_41_027: [ CodeFirst_SendAsyncBatch shall append the serialization of every instance, in order, to one output buffer holding an array: a JSON array, or a CBOR array when CBOR encoding is set. ]*/
+                            /*the first element tells how big the others are likely to be*/
+                            if ((i == 0) && (batch.capacity < batch.size + (elementSize + 2) * instanceCount + 1))
                             {
-                                /* Codes_SRS_CODEFIRST_99_092:[CodeFirst shall publish each value by using Device_PublishTransacted.] */
-                                /* Codes_SRS_CODEFIRST_99_136:[CodeFirst_SendAsync shall build the full path for each property and then pass it to Device_PublishTransacted.] */
-                                if (Device_PublishTransacted(transaction, STRING_c_str(valuePath), &agentDataType) != DEVICE_OK)
-                                {
-                                    Destroy_AGENT_DATA_TYPE(&agentDataType);
-
-                                    /* Codes_SRS_CODEFIRST_99_094:[If any Device API fail, CodeFirst_SendAsync shall return CODEFIRST_DEVICE_PUBLISH_FAILED.] */
-                                    result = CODEFIRST_DEVICE_PUBLISH_FAILED;
-                                    LOG_CODEFIRST_ERROR;
-                                    STRING_delete(valuePath);
-                                    break;
-                                }
-                                else
+                                unsigned char* reserved = (unsigned char*)realloc(batch.bytes, batch.size + (elementSize + 2) * instanceCount + 1);
+                                if (reserved != NULL)
                                 {
-                                    STRING_delete(valuePath); /*anyway*/
+                                    batch.bytes = reserved;
+                                    batch.capacity = batch.size + (elementSize + 2) * instanceCount + 1;
                                 }
+                            }
 
-                                Destroy_AGENT_DATA_TYPE(&agentDataType);
+                            if ((((i > 0) && !g_CBOREncoding) && (AppendToBatch(&batch, (const unsigned char*)", ", 2) != 0)) ||
+                                (AppendToBatch(&batch, element, elementSize) != 0))
+                            {
+                                result = CODEFIRST_ERROR;
+                                LOG_CODEFIRST_ERROR;
+                                free(element);
+                                break;
                             }
+                            free(element);
                         }
                     }
+
+                    if ((i == instanceCount) &&
+                        (!g_CBOREncoding) &&
+                        (AppendToBatch(&batch, (const unsigned char*)"]", 1) != 0))
+                    {
+                        result = CODEFIRST_ERROR;
+                        LOG_CODEFIRST_ERROR;
+                    }
                 }
-            }
-        }
 
-        if (i < numProperties)
-        {
-            if (transaction != NULL)
-            {
-                (void)Device_CancelTransaction(transaction);
+                if (result == CODEFIRST_OK)
+                {
+                    /*Codes_SRS_CODEFIRST_41_028: [ On success CodeFirst_SendAsyncBatch shall give the buffer to the caller through destination and destinationSize and return CODEFIRST_OK; on failure it shall free it. ]*/
+                    *destination = batch.bytes;
+                    *destinationSize = batch.size;
+                }
+                else
+                {
+                    free(batch.bytes);
+                }
             }
-        }
-        /* Codes_SRS_CODEFIRST_99_093:[After all values have been published, Device_EndTransaction shall be called.] */
-        else if (Device_EndTransaction(transaction, destination, destinationSize) != DEVICE_OK)
-        {
-            /* Codes_SRS_CODEFIRST_99_094:[If any Device API fail, CodeFirst_SendAsync shall return CODEFIRST_DEVICE_PUBLISH_FAILED.] */
-            result = CODEFIRST_DEVICE_PUBLISH_FAILED;
-            LOG_CODEFIRST_ERROR;
-        }
-        else
-        {
-            /* Codes_SRS_CODEFIRST_99_117:[On success, CodeFirst_SendAsync shall return CODEFIRST_OK.] */
-            result = CODEFIRST_OK;
-        }
 
-        va_end(ap);
-        
+            DestroyBatchFields(fields, nFields);
+        }
     }
 
     return result;
 }
 
-CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t* destinationSize, size_t numReportedProperties, ...)
+static CODEFIRST_RESULT SendAsyncReported(bool delta, unsigned char** destination, size_t* destinationSize, size_t numReportedProperties, va_list ap)
 {
     CODEFIRST_RESULT result;
     if ((destination == NULL) || (destinationSize == NULL) || numReportedProperties == 0)
@@ -1378,12 +2691,10 @@ CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t
    
         DEVICE_HEADER_DATA* deviceHeader = NULL;
         size_t i;
+        size_t publishedCount = 0;
         REPORTED_PROPERTIES_TRANSACTION_HANDLE transaction = NULL;
-        va_list ap;
         result = CODEFIRST_ACTION_EXECUTION_ERROR; /*this initialization squelches a false warning about result not being initialized*/
 
-        va_start(ap, numReportedProperties);
-
         for (i = 0; i < numReportedProperties; i++)
         {
             void* value = (void*)va_arg(ap, void*);
@@ -1425,7 +2736,7 @@ CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t
                     if (value == ((unsigned char*)deviceHeader->data))
                     {
                         /*Codes_SRS_CODEFIRST_02_021: [ If the value passed through va_args is a complete model instance, then CodeFirst_SendAsyncReported shall send all the reported properties of that device. ]*/
-                        result = SendAllDeviceReportedProperties(deviceHeader, transaction);
+                        result = SendAllDeviceReportedProperties(deviceHeader, transaction, delta, &publishedCount);
                         if (result != CODEFIRST_OK)
                         {
                             LOG_CODEFIRST_ERROR;
@@ -1471,19 +2782,13 @@ CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t
                                 else
                                 {
                                     /*Codes_SRS_CODEFIRST_02_024: [ CodeFirst_SendAsyncReported shall call Device_PublishTransacted_ReportedProperty for every AGENT_DATA_TYPE converted from REPORTED_PROPERTY. ]*/
-                                    if (Device_PublishTransacted_ReportedProperty(transaction, STRING_c_str(valuePath), &agentDataType) != DEVICE_OK)
+                                    result = PublishReportedProperty(deviceHeader, transaction, STRING_c_str(valuePath), &agentDataType, delta, &publishedCount);
+                                    STRING_delete(valuePath);
+                                    Destroy_AGENT_DATA_TYPE(&agentDataType);
+                                    if (result != CODEFIRST_OK)
                                     {
-                                        Destroy_AGENT_DATA_TYPE(&agentDataType);
-                                        result = CODEFIRST_DEVICE_PUBLISH_FAILED;
-                                        LOG_CODEFIRST_ERROR;
-                                        STRING_delete(valuePath);
                                         break;
                                     }
-                                    else
-                                    {
-                                        STRING_delete(valuePath);
-                                    }
-                                    Destroy_AGENT_DATA_TYPE(&agentDataType);
                                 }
                             }
                         }
@@ -1500,6 +2805,14 @@ CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t
                 Device_DestroyTransaction_ReportedProperties(transaction);
             }
         }
+        /*Codes_SRS_CODEFIRST_41_011: [ If no reported property changed, CodeFirst_SendAsyncReportedDelta shall not commit the transaction, shall set *destination to NULL and *destinationSize to 0, and shall return CODEFIRST_OK. ]*/
+        else if (publishedCount == 0)
+        {
+            *destination = NULL;
+            *destinationSize = 0;
+            result = CODEFIRST_OK;
+            Device_DestroyTransaction_ReportedProperties(transaction);
+        }
         /*Codes_SRS_CODEFIRST_02_026: [ CodeFirst_SendAsyncReported shall call Device_CommitTransaction_ReportedProperties to commit the transaction. ]*/
         else
         {
@@ -1517,8 +2830,58 @@ CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t
             /*Codes_SRS_CODEFIRST_02_029: [ CodeFirst_SendAsyncReported shall call Device_DestroyTransaction_ReportedProperties to destroy the transaction. ]*/
             Device_DestroyTransaction_ReportedProperties(transaction);
         }
+    }
+    return result;
+}
+
+CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t* destinationSize, size_t numReportedProperties, ...)
+{
+    CODEFIRST_RESULT result;
+    va_list ap;
+    va_start(ap, numReportedProperties);
+    result = SendAsyncReported(false, destination, destinationSize, numReportedProperties, ap);
+    va_end(ap);
+    return result;
+}
 
-        va_end(ap);
+CODEFIRST_RESULT CodeFirst_SendAsyncReportedDelta(unsigned char** destination, size_t* destinationSize, size_t numReportedProperties, ...)
+{
+    CODEFIRST_RESULT result;
+    va_list ap;
+    /*Codes_SRS_CODEFIRST_41_008: [ CodeFirst_SendAsyncReportedDelta shall behave as CodeFirst_SendAsyncReported, publishing only the reported properties that changed. ]*/
+    va_start(ap, numReportedProperties);
+    result = SendAsyncReported(true, destination, destinationSize, numReportedProperties, ap);
+    va_end(ap);
+    return result;
+}
+
+CODEFIRST_RESULT CodeFirst_AcknowledgeReportedPropertiesDelta(void* device)
+{
+    CODEFIRST_RESULT result;
+    DEVICE_HEADER_DATA* deviceHeader;
+    /*Codes_SRS_CODEFIRST_41_012: [ If device is NULL or is not a device created by CodeFirst_CreateDevice, CodeFirst_AcknowledgeReportedPropertiesDelta shall return CODEFIRST_INVALID_ARG. ]*/
+    if ((device == NULL) ||
+        ((deviceHeader = FindDevice(device)) == NULL) ||
+        (deviceHeader->data != device))
+    {
+        result = CODEFIRST_INVALID_ARG;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        size_t i;
+        /*Codes_SRS_CODEFIRST_41_013: [ CodeFirst_AcknowledgeReportedPropertiesDelta shall make the values sent by CodeFirst_SendAsyncReportedDelta since the last acknowledgement the acknowledged ones, and return CODEFIRST_OK. ]*/
+        for (i = 0; i < deviceHeader->ReportedShadowCount; i++)
+        {
+            REPORTED_PROPERTY_SHADOW* shadow = &deviceHeader->ReportedShadows[i];
+            if (shadow->Sent != NULL)
+            {
+                free(shadow->Acknowledged);
+                shadow->Acknowledged = shadow->Sent;
+                shadow->Sent = NULL;
+            }
+        }
+        result = CODEFIRST_OK;
     }
     return result;
 }
@@ -1622,4 +2985,40 @@ CODEFIRST_RESULT CodeFirst_IngestDesiredProperties(void* device, const char* des
     return result;
 }
 
+CODEFIRST_RESULT CodeFirst_GetDesiredPropertiesVersion(void* device, int64_t* version)
+{
+    CODEFIRST_RESULT result;
+    /*Codes_SRS_CODEFIRST_41_019: [ If device is NULL or version is NULL then CodeFirst_GetDesiredPropertiesVersion shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    if (
+        (device == NULL) ||
+        (version == NULL)
+        )
+    {
+        LogError("invalid argument void* device=%p, int64_t* version=%p", device, version);
+        result = CODEFIRST_INVALID_ARG;
+    }
+    else
+    {
+        DEVICE_HEADER_DATA* deviceHeader = FindDevice(device);
+        if (deviceHeader == NULL)
+        {
+            /*Codes_SRS_CODEFIRST_41_020: [ If the device cannot be found or Device_GetDesiredPropertiesVersion fails then CodeFirst_GetDesiredPropertiesVersion shall fail and return CODEFIRST_ERROR. ]*/
+            LogError("unable to find a device having this memory address %p", device);
+            result = CODEFIRST_ERROR;
+        }
+        /*Codes_SRS_CODEFIRST_41_021: [ CodeFirst_GetDesiredPropertiesVersion shall call Device_GetDesiredPropertiesVersion and return CODEFIRST_OK when it succeeds. ]*/
+        else if (Device_GetDesiredPropertiesVersion(deviceHeader->DeviceHandle, version) != DEVICE_OK)
+        {
+            /*Codes_SRS_CODEFIRST_41_020: [ If the device cannot be found or Device_GetDesiredPropertiesVersion fails then CodeFirst_GetDesiredPropertiesVersion shall fail and return CODEFIRST_ERROR. ]*/
+            LogError("failure in Device_GetDesiredPropertiesVersion");
+            result = CODEFIRST_ERROR;
+        }
+        else
+        {
+            result = CODEFIRST_OK;
+        }
+    }
+    return result;
+}
+
 
@@ -6,6 +6,8 @@
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
 
 #include "commanddecoder.h"
 #include "multitree.h"
@@ -15,8 +17,20 @@
 #include "codefirst.h"
 #include "jsondecoder.h"
 
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
 DEFINE_ENUM_STRINGS(COMMANDDECODER_RESULT, COMMANDDECODER_RESULT_VALUES);
 
+/*the JSON of the last value written to a desired property, used to detect the values that did not change*/
+typedef struct DESIRED_PROPERTY_SNAPSHOT_TAG
+{
+    size_t offset; /*of the desired property from the start address of the device*/
+    STRING_HANDLE value;
+} DESIRED_PROPERTY_SNAPSHOT;
+
 typedef struct COMMAND_DECODER_HANDLE_DATA_TAG
 {
     METHOD_CALLBACK_FUNC methodCallback;
@@ -24,6 +38,10 @@ typedef struct COMMAND_DECODER_HANDLE_DATA_TAG
     SCHEMA_MODEL_TYPE_HANDLE ModelHandle;
     ACTION_CALLBACK_FUNC ActionCallback;
     void* ActionCallbackContext;
+    bool HasDesiredPropertiesVersion;
+    int64_t DesiredPropertiesVersion; /*"$version" of the last ingested desired properties*/
+    DESIRED_PROPERTY_SNAPSHOT* DesiredPropertySnapshots; /*only filled when changes-only ingestion is on*/
+    size_t DesiredPropertySnapshotCount;
 } COMMAND_DECODER_HANDLE_DATA;
 
 static int DecodeValueFromNode(SCHEMA_HANDLE schemaHandle, AGENT_DATA_TYPE* agentDataType, MULTITREE_HANDLE node, const char* edmTypeName)
@@ -775,6 +793,10 @@ COMMAND_DECODER_HANDLE CommandDecoder_Create(SCHEMA_MODEL_TYPE_HANDLE modelHandl
             result->ActionCallbackContext = actionCallbackContext;
             result->methodCallback = methodCallback;
             result->methodCallbackContext = methodCallbackContext;
+            result->HasDesiredPropertiesVersion = false;
+            result->DesiredPropertiesVersion = 0;
+            result->DesiredPropertySnapshots = NULL;
+            result->DesiredPropertySnapshotCount = 0;
         }
     }
 
@@ -789,16 +811,142 @@ void CommandDecoder_Destroy(COMMAND_DECODER_HANDLE commandDecoderHandle)
         COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance = (COMMAND_DECODER_HANDLE_DATA*)commandDecoderHandle;
 
         /* Codes_SRS_COMMAND_DECODER_01_005: [CommandDecoder_Destroy shall free all resources associated with the commandDecoderHandle instance.] */
+        if (commandDecoderInstance->DesiredPropertySnapshots != NULL)
+        {
+            size_t i;
+            for (i = 0; i < commandDecoderInstance->DesiredPropertySnapshotCount; i++)
+            {
+                STRING_delete(commandDecoderInstance->DesiredPropertySnapshots[i].value);
+            }
+            free(commandDecoderInstance->DesiredPropertySnapshots);
+        }
         free(commandDecoderInstance);
     }
 }
 
 DEFINE_ENUM_STRINGS(AGENT_DATA_TYPE_TYPE, AGENT_DATA_TYPE_TYPE_VALUES);
 
+/*"$version" is not a desired property of the model, it is the version that the service gives to the desired properties (complete or patch)*/
+#define DESIRED_PROPERTIES_VERSION_NAME "$version"
+
+static int IngestDesiredPropertiesVersion(COMMAND_DECODER_HANDLE_DATA* handle, const char* value)
+{
+    int result;
+    AGENT_DATA_TYPE version;
+    /*Codes_SRS_COMMAND_DECODER_41_011: [ A "$version" name at the root of desiredProperties shall not be looked up in the model; its value shall be decoded with CreateAgentDataType_From_String as EDM_INT64_TYPE and kept as the version of the desired properties. ]*/
+    if (CreateAgentDataType_From_String(value, EDM_INT64_TYPE, &version) != AGENT_DATA_TYPES_OK)
+    {
+        LogError("failed parsing " DESIRED_PROPERTIES_VERSION_NAME " %s", value);
+        result = __FAILURE__;
+    }
+    else
+    {
+        handle->DesiredPropertiesVersion = version.value.edmInt64.value;
+        handle->HasDesiredPropertiesVersion = true;
+        Destroy_AGENT_DATA_TYPE(&version);
+        result = 0;
+    }
+    return result;
+}
+
+static bool g_ChangeOnlyDesiredProperties = false;
+
+void CommandDecoder_SetChangeOnlyDesiredProperties(bool changeOnlyDesiredProperties)
+{
+    /*Codes_SRS_COMMAND_DECODER_41_015: [ CommandDecoder_SetChangeOnlyDesiredProperties shall set whether CommandDecoder_IngestDesiredProperties skips the desired properties whose value did not change. ]*/
+    g_ChangeOnlyDesiredProperties = changeOnlyDesiredProperties;
+}
+
+static DESIRED_PROPERTY_SNAPSHOT* FindDesiredPropertySnapshot(COMMAND_DECODER_HANDLE_DATA* handle, size_t offset)
+{
+    DESIRED_PROPERTY_SNAPSHOT* result = NULL;
+    size_t i;
+    for (i = 0; i < handle->DesiredPropertySnapshotCount; i++)
+    {
+        if (handle->DesiredPropertySnapshots[i].offset == offset)
+        {
+            result = &handle->DesiredPropertySnapshots[i];
+            break;
+        }
+    }
+    return result;
+}
+
+/*returns true when changes-only ingestion is on and value is the same as the last value written at offset. Otherwise
+*snapshot receives the JSON of value (or NULL) to be recorded by RecordDesiredPropertySnapshot once value is written*/
+static bool IsDesiredPropertyUnchanged(COMMAND_DECODER_HANDLE_DATA* handle, size_t offset, const AGENT_DATA_TYPE* value, STRING_HANDLE* snapshot)
+{
+    bool result = false;
+    *snapshot = NULL;
+    if (g_ChangeOnlyDesiredProperties)
+    {
+        /*Codes_SRS_COMMAND_DECODER_41_016: [ When changes-only ingestion is on, a decoded desired property shall be converted to JSON by AgentDataTypes_ToString and compared with the JSON of the last value written to the same desired property. ]*/
+        STRING_HANDLE json = STRING_new();
+        if (json == NULL)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_018: [ If the comparison cannot be made, the desired property shall be ingested as changed. ]*/
+            LogError("failure in STRING_new");
+        }
+        else if (AgentDataTypes_ToString(json, value) != AGENT_DATA_TYPES_OK)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_018: [ If the comparison cannot be made, the desired property shall be ingested as changed. ]*/
+            LogError("failure in AgentDataTypes_ToString");
+            STRING_delete(json);
+        }
+        else
+        {
+            DESIRED_PROPERTY_SNAPSHOT* previous = FindDesiredPropertySnapshot(handle, offset);
+            if ((previous != NULL) && (strcmp(STRING_c_str(previous->value), STRING_c_str(json)) == 0))
+            {
+                result = true;
+                STRING_delete(json);
+            }
+            else
+            {
+                *snapshot = json;
+            }
+        }
+    }
+    return result;
+}
+
+/*takes ownership of snapshot*/
+static void RecordDesiredPropertySnapshot(COMMAND_DECODER_HANDLE_DATA* handle, size_t offset, STRING_HANDLE snapshot)
+{
+    if (snapshot != NULL)
+    {
+        DESIRED_PROPERTY_SNAPSHOT* previous = FindDesiredPropertySnapshot(handle, offset);
+        if (previous != NULL)
+        {
+            STRING_delete(previous->value);
+            previous->value = snapshot;
+        }
+        else
+        {
+            DESIRED_PROPERTY_SNAPSHOT* grown = (DESIRED_PROPERTY_SNAPSHOT*)realloc(handle->DesiredPropertySnapshots, (handle->DesiredPropertySnapshotCount + 1) * sizeof(DESIRED_PROPERTY_SNAPSHOT));
+            if (grown == NULL)
+            {
+                /*the next identical value will be ingested as changed*/
+                LogError("failure in realloc");
+                STRING_delete(snapshot);
+            }
+            else
+            {
+                grown[handle->DesiredPropertySnapshotCount].offset = offset;
+                grown[handle->DesiredPropertySnapshotCount].value = snapshot;
+                handle->DesiredPropertySnapshots = grown;
+                handle->DesiredPropertySnapshotCount++;
+            }
+        }
+    }
+}
+
 /*validates that the multitree (coming from a JSON) is actually a serialization of the model (complete or incomplete)*/
 /*if the serialization contains more than the model, then it fails.*/
 /*if the serialization does not contain mandatory items from the model, it fails*/
-static bool validateModel_vs_Multitree(void* startAddress, SCHEMA_MODEL_TYPE_HANDLE modelHandle, MULTITREE_HANDLE desiredPropertiesTree, size_t offset)
+/*isRoot is only true for the root of the JSON, that is the only place where "$version" can be*/
+/*changed is set to true when at least one desired property of the model (or of its models in model) was written*/
+static bool validateModel_vs_Multitree(void* startAddress, SCHEMA_MODEL_TYPE_HANDLE modelHandle, MULTITREE_HANDLE desiredPropertiesTree, size_t offset, COMMAND_DECODER_HANDLE_DATA* handle, bool isRoot, bool* changed)
 {
     
     bool result;
@@ -831,89 +979,128 @@ static bool validateModel_vs_Multitree(void* startAddress, SCHEMA_MODEL_TYPE_HAN
                 else
                 {
                     const char *childName_str = STRING_c_str(childName);
-                    SCHEMA_MODEL_ELEMENT elementType = Schema_GetModelElementByName(modelHandle, childName_str);
-                    switch (elementType.elementType)
+                    const char* versionValue;
+                    if (isRoot && (strcmp(childName_str, DESIRED_PROPERTIES_VERSION_NAME) == 0))
                     {
-                        default:
+                        /*Codes_SRS_COMMAND_DECODER_41_011: [ A "$version" name at the root of desiredProperties shall not be looked up in the model; its value shall be decoded with CreateAgentDataType_From_String as EDM_INT64_TYPE and kept as the version of the desired properties. ]*/
+                        if ((MultiTree_GetValue(child, (const void **)&versionValue) != MULTITREE_OK) ||
+                            (IngestDesiredPropertiesVersion(handle, versionValue) != 0))
                         {
-                            LogError("INTERNAL ERROR: unexpected function return");
+                            LogError("failure ingesting " DESIRED_PROPERTIES_VERSION_NAME);
                             i = nChildren;
-                            break;
                         }
-                        case (SCHEMA_PROPERTY):
+                        else
                         {
-                            LogError("cannot ingest name (WITH_DATA instead of WITH_DESIRED_PROPERTY): %s", STRING_c_str);
-                            i = nChildren;
-                            break;
-                        }
-                        case (SCHEMA_REPORTED_PROPERTY):
-                        {
-                            LogError("cannot ingest name (WITH_REPORTED_PROPERTY instead of WITH_DESIRED_PROPERTY): %s", STRING_c_str);
-                            i = nChildren;
-                            break;
+                            nProcessedChildren++;
                         }
-                        case (SCHEMA_DESIRED_PROPERTY):
+                    }
+                    else
+                    {
+                        SCHEMA_MODEL_ELEMENT elementType = Schema_GetModelElementByName(modelHandle, childName_str);
+                        switch (elementType.elementType)
                         {
-                            /*Codes_SRS_COMMAND_DECODER_02_007: [ If the child name corresponds to a desired property then an AGENT_DATA_TYPE shall be constructed from the MULTITREE node. ]*/
-                            SCHEMA_DESIRED_PROPERTY_HANDLE desiredPropertyHandle = elementType.elementHandle.desiredPropertyHandle;
-                            
-                            const char* desiredPropertyType = Schema_GetModelDesiredPropertyType(desiredPropertyHandle);
-                            AGENT_DATA_TYPE output;
-                            if (DecodeValueFromNode(Schema_GetSchemaForModelType(modelHandle), &output, child, desiredPropertyType) != 0)
+                            default:
                             {
-                                LogError("failure in DecodeValueFromNode");
+                                LogError("INTERNAL ERROR: unexpected function return");
                                 i = nChildren;
+                                break;
                             }
-                            else
+                            case (SCHEMA_PROPERTY):
                             {
-                                /*Codes_SRS_COMMAND_DECODER_02_008: [ The desired property shall be constructed in memory by calling pfDesiredPropertyFromAGENT_DATA_TYPE. ]*/
-                                pfDesiredPropertyFromAGENT_DATA_TYPE leFunction = Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE(desiredPropertyHandle);
-                                if (leFunction(&output, (char*)startAddress + offset + Schema_GetModelDesiredProperty_offset(desiredPropertyHandle)) != 0)
+                                LogError("cannot ingest name (WITH_DATA instead of WITH_DESIRED_PROPERTY): %s", childName_str);
+                                i = nChildren;
+                                break;
+                            }
+                            case (SCHEMA_REPORTED_PROPERTY):
+                            {
+                                LogError("cannot ingest name (WITH_REPORTED_PROPERTY instead of WITH_DESIRED_PROPERTY): %s", childName_str);
+                                i = nChildren;
+                                break;
+                            }
+                            case (SCHEMA_DESIRED_PROPERTY):
+                            {
+                                /*Codes_SRS_COMMAND_DECODER_02_007: [ If the child name corresponds to a desired property then an AGENT_DATA_TYPE shall be constructed from the MULTITREE node. ]*/
+                                SCHEMA_DESIRED_PROPERTY_HANDLE desiredPropertyHandle = elementType.elementHandle.desiredPropertyHandle;
+                            
+                                const char* desiredPropertyType = Schema_GetModelDesiredPropertyType(desiredPropertyHandle);
+                                AGENT_DATA_TYPE output;
+                                if (DecodeValueFromNode(Schema_GetSchemaForModelType(modelHandle), &output, child, desiredPropertyType) != 0)
                                 {
-                                    LogError("failure in a function that converts from AGENT_DATA_TYPE to C data");
+                                    LogError("failure in DecodeValueFromNode");
+                                    i = nChildren;
                                 }
                                 else
                                 {
-                                    /*Codes_SRS_COMMAND_DECODER_02_013: [ If the desired property has a non-NULL pfOnDesiredProperty then it shall be called. ]*/
-                                    pfOnDesiredProperty onDesiredProperty = Schema_GetModelDesiredProperty_pfOnDesiredProperty(desiredPropertyHandle);
-                                    if (onDesiredProperty != NULL)
+                                    /*Codes_SRS_COMMAND_DECODER_02_008: [ The desired property shall be constructed in memory by calling pfDesiredPropertyFromAGENT_DATA_TYPE. ]*/
+                                    pfDesiredPropertyFromAGENT_DATA_TYPE leFunction = Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE(desiredPropertyHandle);
+                                    size_t desiredPropertyOffset = offset + Schema_GetModelDesiredProperty_offset(desiredPropertyHandle);
+                                    STRING_HANDLE snapshot;
+                                    if (IsDesiredPropertyUnchanged(handle, desiredPropertyOffset, &output, &snapshot))
                                     {
-                                        onDesiredProperty((char*)startAddress + offset);
+                                        /*Codes_SRS_COMMAND_DECODER_41_017: [ A desired property whose JSON is the same as the last one written shall be neither written nor have its pfOnDesiredProperty called. ]*/
+                                        nProcessedChildren++;
                                     }
-                                    nProcessedChildren++;
+                                    else if (leFunction(&output, (char*)startAddress + desiredPropertyOffset) != 0)
+                                    {
+                                        LogError("failure in a function that converts from AGENT_DATA_TYPE to C data");
+                                    }
+                                    else
+                                    {
+                                        RecordDesiredPropertySnapshot(handle, desiredPropertyOffset, snapshot);
+                                        snapshot = NULL;
+                                        *changed = true;
+
+                                        /*Codes_SRS_COMMAND_DECODER_02_013: [ If the desired property has a non-NULL pfOnDesiredProperty then it shall be called. ]*/
+                                        pfOnDesiredProperty onDesiredProperty = Schema_GetModelDesiredProperty_pfOnDesiredProperty(desiredPropertyHandle);
+                                        if (onDesiredProperty != NULL)
+                                        {
+                                            onDesiredProperty((char*)startAddress + offset);
+                                        }
+                                        nProcessedChildren++;
+                                    }
+                                    if (snapshot != NULL)
+                                    {
+                                        STRING_delete(snapshot);
+                                    }
+                                    Destroy_AGENT_DATA_TYPE(&output);
                                 }
-                                Destroy_AGENT_DATA_TYPE(&output);
-                            }
-                            
-                            break;
-                        }
-                        case(SCHEMA_MODEL_IN_MODEL):
-                        {
-                            SCHEMA_MODEL_TYPE_HANDLE modelModel = elementType.elementHandle.modelHandle;
                             
-                            /*Codes_SRS_COMMAND_DECODER_02_009: [ If the child name corresponds to a model in model then the function shall call itself recursively. ]*/
-                            if (!validateModel_vs_Multitree(startAddress, modelModel, child, offset + Schema_GetModelModelByName_Offset(modelHandle, childName_str)))
-                            {
-                                LogError("failure in validateModel_vs_Multitree");
-                                i = nChildren;
+                                break;
                             }
-                            else
+                            case(SCHEMA_MODEL_IN_MODEL):
                             {
-                                /*if the model in model so happened to be a WITH_DESIRED_PROPERTY... (only those has non_NULL pfOnDesiredProperty) */
-                                /*Codes_SRS_COMMAND_DECODER_02_012: [ If the child model in model has a non-NULL pfOnDesiredProperty then pfOnDesiredProperty shall be called. ]*/
-                                pfOnDesiredProperty onDesiredProperty = Schema_GetModelModelByName_OnDesiredProperty(modelHandle, childName_str);
-                                if (onDesiredProperty != NULL)
+                                SCHEMA_MODEL_TYPE_HANDLE modelModel = elementType.elementHandle.modelHandle;
+                                bool modelModelChanged = false;
+                            
+                                /*Codes_SRS_COMMAND_DECODER_02_009: [ If the child name corresponds to a model in model then the function shall call itself recursively. ]*/
+                                if (!validateModel_vs_Multitree(startAddress, modelModel, child, offset + Schema_GetModelModelByName_Offset(modelHandle, childName_str), handle, false, &modelModelChanged))
                                 {
-                                    onDesiredProperty((char*)startAddress + offset);
+                                    LogError("failure in validateModel_vs_Multitree");
+                                    i = nChildren;
                                 }
+                                else
+                                {
+                                    /*if the model in model so happened to be a WITH_DESIRED_PROPERTY... (only those has non_NULL pfOnDesiredProperty) */
+                                    /*Codes_SRS_COMMAND_DECODER_02_012: [ If the child model in model has a non-NULL pfOnDesiredProperty then pfOnDesiredProperty shall be called. ]*/
+                                    /*Codes_SRS_COMMAND_DECODER_41_019: [ When changes-only ingestion is on, the pfOnDesiredProperty of a model in model shall only be called when at least one of its desired properties was written. ]*/
+                                    if ((!g_ChangeOnlyDesiredProperties) || modelModelChanged)
+                                    {
+                                        pfOnDesiredProperty onDesiredProperty = Schema_GetModelModelByName_OnDesiredProperty(modelHandle, childName_str);
+                                        if (onDesiredProperty != NULL)
+                                        {
+                                            onDesiredProperty((char*)startAddress + offset);
+                                        }
+                                    }
+                                    *changed = *changed || modelModelChanged;
                                 
-                                nProcessedChildren++;
-                            }
+                                    nProcessedChildren++;
+                                }
                             
-                            break;
-                        }
+                                break;
+                            }
 
-                    } /*switch*/
+                        } /*switch*/
+                    }
                 }
                 STRING_delete(childName);
             }
@@ -936,8 +1123,600 @@ static bool validateModel_vs_Multitree(void* startAddress, SCHEMA_MODEL_TYPE_HAN
 
 static EXECUTE_COMMAND_RESULT DecodeDesiredProperties(void* startAddress, COMMAND_DECODER_HANDLE_DATA* handle, MULTITREE_HANDLE desiredPropertiesTree)
 {
+    bool changed = false;
     /*Codes_SRS_COMMAND_DECODER_02_006: [ CommandDecoder_IngestDesiredProperties shall parse the MULTITREEE recursively. ]*/
-    return validateModel_vs_Multitree(startAddress, handle->ModelHandle, desiredPropertiesTree, 0 )?EXECUTE_COMMAND_SUCCESS:EXECUTE_COMMAND_FAILED;
+    return validateModel_vs_Multitree(startAddress, handle->ModelHandle, desiredPropertiesTree, 0, handle, true, &changed)?EXECUTE_COMMAND_SUCCESS:EXECUTE_COMMAND_FAILED;
+}
+
+/*the streaming ingestion keeps one frame per JSON object (or skipped array) that is open*/
+typedef enum DESIRED_PROPERTIES_FRAME_KIND_TAG
+{
+    DESIRED_PROPERTIES_FRAME_MODEL,
+    DESIRED_PROPERTIES_FRAME_STRUCT,
+    DESIRED_PROPERTIES_FRAME_SKIP
+} DESIRED_PROPERTIES_FRAME_KIND;
+
+typedef struct DESIRED_PROPERTIES_FRAME_TAG
+{
+    DESIRED_PROPERTIES_FRAME_KIND kind;
+    struct DESIRED_PROPERTIES_FRAME_TAG* parent;
+
+    /*model frames*/
+    SCHEMA_MODEL_TYPE_HANDLE modelHandle;
+    size_t offset; /*of the model from startAddress*/
+    size_t parentOffset; /*of the model that contains this model in model*/
+    pfOnDesiredProperty onDesiredProperty; /*of the model in model*/
+    bool failed; /*set when one of the desired properties of the model could not be ingested*/
+    bool changed; /*set when one of the desired properties of the model was written*/
+
+    /*struct frames*/
+    const char* typeName;
+    SCHEMA_STRUCT_TYPE_HANDLE structTypeHandle;
+    size_t memberCount;
+    size_t setMemberCount;
+    const char** memberNames;
+    AGENT_DATA_TYPE* memberValues;
+    bool* isMemberSet;
+    SCHEMA_DESIRED_PROPERTY_HANDLE desiredPropertyHandle; /*when the parent frame is a model*/
+    size_t memberIndex; /*when the parent frame is a struct*/
+
+    /*skip frames*/
+    size_t depth;
+} DESIRED_PROPERTIES_FRAME;
+
+typedef struct DESIRED_PROPERTIES_PARSER_TAG
+{
+    void* startAddress;
+    COMMAND_DECODER_HANDLE_DATA* handle;
+    SCHEMA_MODEL_TYPE_HANDLE modelHandle;
+    DESIRED_PROPERTIES_FRAME* top;
+    bool rootParsed;
+    bool rootFailed;
+    bool aborted;
+} DESIRED_PROPERTIES_PARSER;
+
+static bool g_StreamDesiredProperties = false;
+
+void CommandDecoder_SetStreamingDesiredProperties(bool streamDesiredProperties)
+{
+    /*Codes_SRS_COMMAND_DECODER_41_001: [ CommandDecoder_SetStreamingDesiredProperties shall set whether CommandDecoder_IngestDesiredProperties decodes the JSON straight into the model, without building a MULTITREE. ]*/
+    g_StreamDesiredProperties = streamDesiredProperties;
+}
+
+static void DestroyDesiredPropertiesFrame(DESIRED_PROPERTIES_FRAME* frame)
+{
+    if (frame->kind == DESIRED_PROPERTIES_FRAME_STRUCT)
+    {
+        size_t i;
+        for (i = 0; i < frame->memberCount; i++)
+        {
+            if (frame->isMemberSet[i])
+            {
+                Destroy_AGENT_DATA_TYPE(&frame->memberValues[i]);
+            }
+        }
+        free((void*)frame->memberNames);
+        free(frame->memberValues);
+        free(frame->isMemberSet);
+    }
+    free(frame);
+}
+
+static DESIRED_PROPERTIES_FRAME* PushDesiredPropertiesFrame(DESIRED_PROPERTIES_PARSER* parser, DESIRED_PROPERTIES_FRAME_KIND kind)
+{
+    DESIRED_PROPERTIES_FRAME* result = (DESIRED_PROPERTIES_FRAME*)malloc(sizeof(DESIRED_PROPERTIES_FRAME));
+    if (result == NULL)
+    {
+        LogError("failure allocating a desired properties frame");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(DESIRED_PROPERTIES_FRAME));
+        result->kind = kind;
+        result->parent = parser->top;
+        parser->top = result;
+    }
+    return result;
+}
+
+static void PopDesiredPropertiesFrame(DESIRED_PROPERTIES_PARSER* parser)
+{
+    DESIRED_PROPERTIES_FRAME* frame = parser->top;
+    parser->top = frame->parent;
+    DestroyDesiredPropertiesFrame(frame);
+}
+
+static int PushStructFrame(DESIRED_PROPERTIES_PARSER* parser, const char* typeName, SCHEMA_DESIRED_PROPERTY_HANDLE desiredPropertyHandle, size_t memberIndex)
+{
+    int result;
+    SCHEMA_STRUCT_TYPE_HANDLE structTypeHandle;
+    size_t memberCount;
+
+    /*Codes_SRS_COMMAND_DECODER_41_005: [ The members of a struct typed value shall be determined with the Schema APIs for structure types; a struct type with 0 members shall fail. ]*/
+    if (((structTypeHandle = Schema_GetStructTypeByName(Schema_GetSchemaForModelType(parser->modelHandle), typeName)) == NULL) ||
+        (Schema_GetStructTypePropertyCount(structTypeHandle, &memberCount) != SCHEMA_OK) ||
+        (memberCount == 0))
+    {
+        LogError("cannot get the members of struct type %s", typeName);
+        result = __FAILURE__;
+    }
+    else
+    {
+        DESIRED_PROPERTIES_FRAME* frame = PushDesiredPropertiesFrame(parser, DESIRED_PROPERTIES_FRAME_STRUCT);
+        if (frame == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t i;
+
+            frame->typeName = typeName;
+            frame->structTypeHandle = structTypeHandle;
+            frame->desiredPropertyHandle = desiredPropertyHandle;
+            frame->memberIndex = memberIndex;
+            frame->memberCount = memberCount;
+            frame->memberNames = (const char**)malloc(sizeof(const char*) * memberCount);
+            frame->memberValues = (AGENT_DATA_TYPE*)malloc(sizeof(AGENT_DATA_TYPE) * memberCount);
+            frame->isMemberSet = (bool*)malloc(sizeof(bool) * memberCount);
+            if ((frame->memberNames == NULL) || (frame->memberValues == NULL) || (frame->isMemberSet == NULL))
+            {
+                LogError("failure allocating the members of struct type %s", typeName);
+                result = __FAILURE__;
+            }
+            else
+            {
+                (void)memset(frame->isMemberSet, 0, sizeof(bool) * memberCount);
+                result = 0;
+                for (i = 0; i < memberCount; i++)
+                {
+                    SCHEMA_PROPERTY_HANDLE propertyHandle = Schema_GetStructTypePropertyByIndex(structTypeHandle, i);
+                    if ((propertyHandle == NULL) ||
+                        ((frame->memberNames[i] = Schema_GetPropertyName(propertyHandle)) == NULL))
+                    {
+                        LogError("failure getting member %lu of struct type %s", (unsigned long)i, typeName);
+                        result = __FAILURE__;
+                        break;
+                    }
+                }
+            }
+
+            if (result != 0)
+            {
+                /*no member has been decoded yet*/
+                frame->memberCount = 0;
+                PopDesiredPropertiesFrame(parser);
+            }
+        }
+    }
+    return result;
+}
+
+static int PushModelFrame(DESIRED_PROPERTIES_PARSER* parser, SCHEMA_MODEL_TYPE_HANDLE modelHandle, size_t offset, size_t parentOffset, pfOnDesiredProperty onDesiredProperty)
+{
+    int result;
+    DESIRED_PROPERTIES_FRAME* frame = PushDesiredPropertiesFrame(parser, DESIRED_PROPERTIES_FRAME_MODEL);
+    if (frame == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        frame->modelHandle = modelHandle;
+        frame->offset = offset;
+        frame->parentOffset = parentOffset;
+        frame->onDesiredProperty = onDesiredProperty;
+        result = 0;
+    }
+    return result;
+}
+
+static int PushSkipFrame(DESIRED_PROPERTIES_PARSER* parser)
+{
+    int result;
+    DESIRED_PROPERTIES_FRAME* frame = PushDesiredPropertiesFrame(parser, DESIRED_PROPERTIES_FRAME_SKIP);
+    if (frame == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        frame->depth = 1;
+        result = 0;
+    }
+    return result;
+}
+
+static size_t FindStructMember(const DESIRED_PROPERTIES_FRAME* frame, const char* name)
+{
+    size_t i;
+    for (i = 0; i < frame->memberCount; i++)
+    {
+        if (strcmp(frame->memberNames[i], name) == 0)
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+static const char* GetStructMemberType(const DESIRED_PROPERTIES_FRAME* frame, size_t memberIndex)
+{
+    SCHEMA_PROPERTY_HANDLE propertyHandle = Schema_GetStructTypePropertyByIndex(frame->structTypeHandle, memberIndex);
+    return (propertyHandle == NULL) ? NULL : Schema_GetPropertyType(propertyHandle);
+}
+
+/*consumes value*/
+static void IngestDesiredPropertyValue(DESIRED_PROPERTIES_PARSER* parser, DESIRED_PROPERTIES_FRAME* modelFrame, SCHEMA_DESIRED_PROPERTY_HANDLE desiredPropertyHandle, AGENT_DATA_TYPE* value)
+{
+    /*Codes_SRS_COMMAND_DECODER_41_004: [ A decoded desired property shall be written to the model by pfDesiredPropertyFromAGENT_DATA_TYPE, after which its pfOnDesiredProperty, when not NULL, shall be called. ]*/
+    pfDesiredPropertyFromAGENT_DATA_TYPE leFunction = Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE(desiredPropertyHandle);
+    size_t desiredPropertyOffset = modelFrame->offset + Schema_GetModelDesiredProperty_offset(desiredPropertyHandle);
+    STRING_HANDLE snapshot;
+    if (IsDesiredPropertyUnchanged(parser->handle, desiredPropertyOffset, value, &snapshot))
+    {
+        /*Codes_SRS_COMMAND_DECODER_41_017: [ A desired property whose JSON is the same as the last one written shall be neither written nor have its pfOnDesiredProperty called. ]*/
+    }
+    else if (leFunction(value, (char*)parser->startAddress + desiredPropertyOffset) != 0)
+    {
+        LogError("failure in a function that converts from AGENT_DATA_TYPE to C data");
+        modelFrame->failed = true;
+    }
+    else
+    {
+        RecordDesiredPropertySnapshot(parser->handle, desiredPropertyOffset, snapshot);
+        snapshot = NULL;
+        modelFrame->changed = true;
+
+        pfOnDesiredProperty onDesiredProperty = Schema_GetModelDesiredProperty_pfOnDesiredProperty(desiredPropertyHandle);
+        if (onDesiredProperty != NULL)
+        {
+            onDesiredProperty((char*)parser->startAddress + modelFrame->offset);
+        }
+    }
+    if (snapshot != NULL)
+    {
+        STRING_delete(snapshot);
+    }
+    Destroy_AGENT_DATA_TYPE(value);
+}
+
+static int StreamOnObjectBegin(void* context, const char* name)
+{
+    int result;
+    DESIRED_PROPERTIES_PARSER* parser = (DESIRED_PROPERTIES_PARSER*)context;
+    DESIRED_PROPERTIES_FRAME* top = parser->top;
+
+    if (top == NULL)
+    {
+        /*the root of the JSON is the model*/
+        result = PushModelFrame(parser, parser->modelHandle, 0, 0, NULL);
+    }
+    else if (top->kind == DESIRED_PROPERTIES_FRAME_SKIP)
+    {
+        top->depth++;
+        result = 0;
+    }
+    else if (top->kind == DESIRED_PROPERTIES_FRAME_STRUCT)
+    {
+        size_t memberIndex = FindStructMember(top, name);
+        const char* memberType;
+        if (memberIndex == top->memberCount)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_006: [ Members of a struct typed value that are not in the struct type shall be ignored. ]*/
+            result = PushSkipFrame(parser);
+        }
+        else if ((memberType = GetStructMemberType(top, memberIndex)) == NULL)
+        {
+            LogError("failure getting the type of member %s", name);
+            result = __FAILURE__;
+        }
+        else if ((top->isMemberSet[memberIndex]) ||
+            (CodeFirst_GetPrimitiveType(memberType) != EDM_NO_TYPE))
+        {
+            LogError("unexpected object for member %s", name);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = PushStructFrame(parser, memberType, NULL, memberIndex);
+        }
+    }
+    else
+    {
+        SCHEMA_MODEL_ELEMENT element = Schema_GetModelElementByName(top->modelHandle, name);
+        if (element.elementType == SCHEMA_MODEL_IN_MODEL)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_003: [ An object whose name is a model in model shall be decoded into that model, at the offset of the model in model. ]*/
+            result = PushModelFrame(parser, element.elementHandle.modelHandle,
+                top->offset + Schema_GetModelModelByName_Offset(top->modelHandle, name),
+                top->offset,
+                Schema_GetModelModelByName_OnDesiredProperty(top->modelHandle, name));
+        }
+        else if (element.elementType == SCHEMA_DESIRED_PROPERTY)
+        {
+            const char* desiredPropertyType = Schema_GetModelDesiredPropertyType(element.elementHandle.desiredPropertyHandle);
+            if ((desiredPropertyType == NULL) ||
+                (CodeFirst_GetPrimitiveType(desiredPropertyType) != EDM_NO_TYPE))
+            {
+                LogError("unexpected object for desired property %s", name);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = PushStructFrame(parser, desiredPropertyType, element.elementHandle.desiredPropertyHandle, 0);
+            }
+        }
+        else
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_008: [ A name that is not a desired property or a model in model of the model shall stop the decoding and CommandDecoder_IngestDesiredProperties shall return EXECUTE_COMMAND_FAILED. ]*/
+            LogError("cannot ingest name %s, it is not a WITH_DESIRED_PROPERTY or a model in model", name);
+            result = __FAILURE__;
+        }
+    }
+
+    if (result != 0)
+    {
+        parser->aborted = true;
+    }
+    return result;
+}
+
+static int StreamOnArrayBegin(void* context, const char* name)
+{
+    int result;
+    DESIRED_PROPERTIES_PARSER* parser = (DESIRED_PROPERTIES_PARSER*)context;
+    DESIRED_PROPERTIES_FRAME* top = parser->top;
+
+    if ((top != NULL) && (top->kind == DESIRED_PROPERTIES_FRAME_SKIP))
+    {
+        top->depth++;
+        result = 0;
+    }
+    /*Codes_SRS_COMMAND_DECODER_41_006: [ Members of a struct typed value that are not in the struct type shall be ignored. ]*/
+    else if ((top != NULL) && (top->kind == DESIRED_PROPERTIES_FRAME_STRUCT) && (FindStructMember(top, name) == top->memberCount))
+    {
+        result = PushSkipFrame(parser);
+    }
+    else
+    {
+        /*Codes_SRS_COMMAND_DECODER_41_008: [ A name that is not a desired property or a model in model of the model shall stop the decoding and CommandDecoder_IngestDesiredProperties shall return EXECUTE_COMMAND_FAILED. ]*/
+        LogError("arrays cannot be ingested as desired properties");
+        result = __FAILURE__;
+    }
+
+    if (result != 0)
+    {
+        parser->aborted = true;
+    }
+    return result;
+}
+
+static int StreamOnEnd(void* context)
+{
+    int result;
+    DESIRED_PROPERTIES_PARSER* parser = (DESIRED_PROPERTIES_PARSER*)context;
+    DESIRED_PROPERTIES_FRAME* top = parser->top;
+
+    if (top->kind == DESIRED_PROPERTIES_FRAME_SKIP)
+    {
+        if (--top->depth == 0)
+        {
+            PopDesiredPropertiesFrame(parser);
+        }
+        result = 0;
+    }
+    else if (top->kind == DESIRED_PROPERTIES_FRAME_STRUCT)
+    {
+        AGENT_DATA_TYPE value;
+        if (top->setMemberCount != top->memberCount)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_005: [ The members of a struct typed value shall be determined with the Schema APIs for structure types; a struct type with 0 members shall fail. ]*/
+            LogError("not all the members of struct type %s are present", top->typeName);
+            result = __FAILURE__;
+        }
+        else if (Create_AGENT_DATA_TYPE_from_Members(&value, top->typeName, top->memberCount, (const char* const*)top->memberNames, top->memberValues) != AGENT_DATA_TYPES_OK)
+        {
+            LogError("failure in Create_AGENT_DATA_TYPE_from_Members");
+            result = __FAILURE__;
+        }
+        else
+        {
+            DESIRED_PROPERTIES_FRAME* parent = top->parent;
+            if (parent->kind == DESIRED_PROPERTIES_FRAME_STRUCT)
+            {
+                parent->memberValues[top->memberIndex] = value;
+                parent->isMemberSet[top->memberIndex] = true;
+                parent->setMemberCount++;
+            }
+            else
+            {
+                IngestDesiredPropertyValue(parser, parent, top->desiredPropertyHandle, &value);
+            }
+            PopDesiredPropertiesFrame(parser);
+            result = 0;
+        }
+    }
+    else
+    {
+        DESIRED_PROPERTIES_FRAME* parent = top->parent;
+        if (top->failed)
+        {
+            if (parent == NULL)
+            {
+                parser->rootFailed = true;
+            }
+            else
+            {
+                parent->failed = true;
+            }
+        }
+        /*Codes_SRS_COMMAND_DECODER_41_007: [ When all the desired properties of a model in model have been ingested, the pfOnDesiredProperty of the model in model, when not NULL, shall be called. ]*/
+        /*Codes_SRS_COMMAND_DECODER_41_019: [ When changes-only ingestion is on, the pfOnDesiredProperty of a model in model shall only be called when at least one of its desired properties was written. ]*/
+        else if ((top->onDesiredProperty != NULL) && ((!g_ChangeOnlyDesiredProperties) || top->changed))
+        {
+            top->onDesiredProperty((char*)parser->startAddress + top->parentOffset);
+        }
+
+        if ((parent != NULL) && top->changed)
+        {
+            parent->changed = true;
+        }
+
+        if (parent == NULL)
+        {
+            parser->rootParsed = true;
+        }
+        PopDesiredPropertiesFrame(parser);
+        result = 0;
+    }
+
+    if (result != 0)
+    {
+        parser->aborted = true;
+    }
+    return result;
+}
+
+static int StreamOnValue(void* context, const char* name, const char* value)
+{
+    int result;
+    DESIRED_PROPERTIES_PARSER* parser = (DESIRED_PROPERTIES_PARSER*)context;
+    DESIRED_PROPERTIES_FRAME* top = parser->top;
+
+    if (top->kind == DESIRED_PROPERTIES_FRAME_SKIP)
+    {
+        result = 0;
+    }
+    else if (top->kind == DESIRED_PROPERTIES_FRAME_STRUCT)
+    {
+        size_t memberIndex = FindStructMember(top, name);
+        const char* memberType;
+        AGENT_DATA_TYPE_TYPE primitiveType;
+        if (memberIndex == top->memberCount)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_006: [ Members of a struct typed value that are not in the struct type shall be ignored. ]*/
+            result = 0;
+        }
+        else if (((memberType = GetStructMemberType(top, memberIndex)) == NULL) ||
+            (top->isMemberSet[memberIndex]) ||
+            ((primitiveType = CodeFirst_GetPrimitiveType(memberType)) == EDM_NO_TYPE))
+        {
+            LogError("unexpected value for member %s", name);
+            result = __FAILURE__;
+        }
+        else if (CreateAgentDataType_From_String(value, primitiveType, &top->memberValues[memberIndex]) != AGENT_DATA_TYPES_OK)
+        {
+            LogError("failed parsing member %s", name);
+            result = __FAILURE__;
+        }
+        else
+        {
+            top->isMemberSet[memberIndex] = true;
+            top->setMemberCount++;
+            result = 0;
+        }
+    }
+    else if ((top->parent == NULL) && (strcmp(name, DESIRED_PROPERTIES_VERSION_NAME) == 0))
+    {
+        /*Codes_SRS_COMMAND_DECODER_41_011: [ A "$version" name at the root of desiredProperties shall not be looked up in the model; its value shall be decoded with CreateAgentDataType_From_String as EDM_INT64_TYPE and kept as the version of the desired properties. ]*/
+        result = IngestDesiredPropertiesVersion(parser->handle, value);
+    }
+    else
+    {
+        SCHEMA_MODEL_ELEMENT element = Schema_GetModelElementByName(top->modelHandle, name);
+        if (element.elementType == SCHEMA_DESIRED_PROPERTY)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_002: [ A value whose name is a desired property of primitive type shall be decoded with CreateAgentDataType_From_String as soon as it is parsed. ]*/
+            const char* desiredPropertyType = Schema_GetModelDesiredPropertyType(element.elementHandle.desiredPropertyHandle);
+            AGENT_DATA_TYPE_TYPE primitiveType;
+            AGENT_DATA_TYPE output;
+            if ((desiredPropertyType == NULL) ||
+                ((primitiveType = CodeFirst_GetPrimitiveType(desiredPropertyType)) == EDM_NO_TYPE))
+            {
+                LogError("unexpected value for desired property %s", name);
+                result = __FAILURE__;
+            }
+            else if (CreateAgentDataType_From_String(value, primitiveType, &output) != AGENT_DATA_TYPES_OK)
+            {
+                LogError("failed parsing desired property %s", name);
+                result = __FAILURE__;
+            }
+            else
+            {
+                IngestDesiredPropertyValue(parser, top, element.elementHandle.desiredPropertyHandle, &output);
+                result = 0;
+            }
+        }
+        else
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_008: [ A name that is not a desired property or a model in model of the model shall stop the decoding and CommandDecoder_IngestDesiredProperties shall return EXECUTE_COMMAND_FAILED. ]*/
+            LogError("cannot ingest name %s, it is not a WITH_DESIRED_PROPERTY", name);
+            result = __FAILURE__;
+        }
+    }
+
+    if (result != 0)
+    {
+        parser->aborted = true;
+    }
+    return result;
+}
+
+static const JSON_DECODER_CALLBACKS desiredPropertiesCallbacks =
+{
+    StreamOnObjectBegin,
+    StreamOnEnd,
+    StreamOnArrayBegin,
+    StreamOnEnd,
+    StreamOnValue
+};
+
+static EXECUTE_COMMAND_RESULT StreamDesiredProperties(void* startAddress, COMMAND_DECODER_HANDLE_DATA* handle, char* desiredProperties)
+{
+    EXECUTE_COMMAND_RESULT result;
+    DESIRED_PROPERTIES_PARSER parser;
+    JSON_DECODER_RESULT decoderResult;
+
+    parser.startAddress = startAddress;
+    parser.handle = handle;
+    parser.modelHandle = handle->ModelHandle;
+    parser.top = NULL;
+    parser.rootParsed = false;
+    parser.rootFailed = false;
+    parser.aborted = false;
+
+    /*Codes_SRS_COMMAND_DECODER_41_009: [ When streaming is on, CommandDecoder_IngestDesiredProperties shall decode the clone of desiredProperties with JSONDecoder_JSON_To_Callbacks. ]*/
+    decoderResult = JSONDecoder_JSON_To_Callbacks(desiredProperties, &desiredPropertiesCallbacks, &parser);
+
+    while (parser.top != NULL)
+    {
+        PopDesiredPropertiesFrame(&parser);
+    }
+
+    if (parser.aborted)
+    {
+        /*Codes_SRS_COMMAND_DECODER_41_008: [ A name that is not a desired property or a model in model of the model shall stop the decoding and CommandDecoder_IngestDesiredProperties shall return EXECUTE_COMMAND_FAILED. ]*/
+        result = EXECUTE_COMMAND_FAILED;
+    }
+    else if ((decoderResult != JSON_DECODER_OK) || (!parser.rootParsed))
+    {
+        /*Codes_SRS_COMMAND_DECODER_41_010: [ If JSONDecoder_JSON_To_Callbacks fails to parse the JSON, CommandDecoder_IngestDesiredProperties shall return EXECUTE_COMMAND_ERROR. ]*/
+        LogError("Decoding the desired properties JSON failed");
+        result = EXECUTE_COMMAND_ERROR;
+    }
+    else if (parser.rootFailed)
+    {
+        /*Codes_SRS_COMMAND_DECODER_02_011: [ Otherwise CommandDecoder_IngestDesiredProperties shall fail and return EXECUTE_COMMAND_FAILED. ]*/
+        LogError("not all constituents of the JSON have been ingested");
+        result = EXECUTE_COMMAND_FAILED;
+    }
+    else
+    {
+        /*Codes_SRS_COMMAND_DECODER_02_010: [ If the complete MULTITREE has been parsed then CommandDecoder_IngestDesiredProperties shall succeed and return EXECUTE_COMMAND_SUCCESS. ]*/
+        result = EXECUTE_COMMAND_SUCCESS;
+    }
+    return result;
 }
 
 EXECUTE_COMMAND_RESULT CommandDecoder_IngestDesiredProperties(void* startAddress, COMMAND_DECODER_HANDLE handle, const char* desiredProperties)
@@ -968,7 +1747,11 @@ EXECUTE_COMMAND_RESULT CommandDecoder_IngestDesiredProperties(void* startAddress
         {
             /*Codes_SRS_COMMAND_DECODER_02_005: [ CommandDecoder_IngestDesiredProperties shall create a MULTITREE_HANDLE ouf of the clone of desiredProperties. ]*/
             MULTITREE_HANDLE desiredPropertiesTree;
-            if (JSONDecoder_JSON_To_MultiTree(copy, &desiredPropertiesTree) != JSON_DECODER_OK)
+            if (g_StreamDesiredProperties)
+            {
+                result = StreamDesiredProperties(startAddress, (COMMAND_DECODER_HANDLE_DATA*)handle, copy);
+            }
+            else if (JSONDecoder_JSON_To_MultiTree(copy, &desiredPropertiesTree) != JSON_DECODER_OK)
             {
                 LogError("Decoding JSON to a multi tree failed");
                 result = EXECUTE_COMMAND_ERROR;
@@ -987,3 +1770,34 @@ EXECUTE_COMMAND_RESULT CommandDecoder_IngestDesiredProperties(void* startAddress
     }
     return result;
 }
+
+int CommandDecoder_GetDesiredPropertiesVersion(COMMAND_DECODER_HANDLE handle, int64_t* version)
+{
+    int result;
+    /*Codes_SRS_COMMAND_DECODER_41_012: [ If handle is NULL or version is NULL then CommandDecoder_GetDesiredPropertiesVersion shall fail and return a non-zero value. ]*/
+    if (
+        (handle == NULL) ||
+        (version == NULL)
+        )
+    {
+        LogError("invalid argument COMMAND_DECODER_HANDLE handle=%p, int64_t* version=%p", handle, version);
+        result = __FAILURE__;
+    }
+    else
+    {
+        COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance = (COMMAND_DECODER_HANDLE_DATA*)handle;
+        if (!commandDecoderInstance->HasDesiredPropertiesVersion)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_013: [ If no ingested desired properties had a "$version" then CommandDecoder_GetDesiredPropertiesVersion shall fail and return a non-zero value. ]*/
+            LogError("no " DESIRED_PROPERTIES_VERSION_NAME " has been ingested");
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_014: [ Otherwise CommandDecoder_GetDesiredPropertiesVersion shall set *version to the last "$version" ingested and return 0. ]*/
+            *version = commandDecoderInstance->DesiredPropertiesVersion;
+            result = 0;
+        }
+    }
+    return result;
+}
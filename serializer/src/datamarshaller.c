@@ -9,11 +9,17 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "schema.h"
 #include "jsonencoder.h"
+#include "cborencoder.h"
 #include "agenttypesystem.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "parson.h"
 #include "azure_c_shared_utility/vector.h"
 
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
 DEFINE_ENUM_STRINGS(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_RESULT_VALUES);
 
 #define LOG_DATA_MARSHALLER_ERROR \
@@ -25,6 +31,8 @@ typedef struct DATA_MARSHALLER_HANDLE_DATA_TAG
     bool IncludePropertyPath;
 } DATA_MARSHALLER_HANDLE_DATA;
 
+static bool cborEncoding_ = false;
+
 static int NoCloneFunction(void** destination, const void* source)
 {
     *destination = (void*)source;
@@ -172,40 +180,31 @@ DATA_MARSHALLER_RESULT DataMarshaller_SendData(DATA_MARSHALLER_HANDLE dataMarsha
 
                 if (j == valueCount)
                 {
-                    STRING_HANDLE payload = STRING_new();
-                    if (payload == NULL)
+                    if (cborEncoding_)
                     {
-                        result = DATA_MARSHALLER_ERROR;
-                        LOG_DATA_MARSHALLER_ERROR
-                    }
-                    else
-                    {
-                        if (JSONEncoder_EncodeTree(treeHandle, payload, (JSON_ENCODER_TOSTRING_FUNC)AgentDataTypes_ToString) != JSON_ENCODER_OK)
+                        /*Codes_SRS_DATAMARSHALLER_41_003: [ If CBOR encoding has been turned on, DataMarshaller_SendData shall encode the tree with CBOREncoder_EncodeTree_ToBuffer instead of JSONEncoder_EncodeTree_ToBuffer. ]*/
+                        if (CBOREncoder_EncodeTree_ToBuffer(treeHandle, destination, destinationSize) != CBOR_ENCODER_OK)
                         {
-                            /* Codes_SRS_DATA_MARSHALLER_99_027:[ DATA_MARSHALLER_JSON_ENCODER_ERROR shall be returned when JSONEncoder returns an error code.] */
+                            /*Codes_SRS_DATAMARSHALLER_41_004: [ If CBOREncoder_EncodeTree_ToBuffer fails, DataMarshaller_SendData shall return DATA_MARSHALLER_JSON_ENCODER_ERROR. ]*/
                             result = DATA_MARSHALLER_JSON_ENCODER_ERROR;
                             LOG_DATA_MARSHALLER_ERROR
                         }
                         else
                         {
-                            /*Codes_SRS_DATAMARSHALLER_02_007: [DataMarshaller_SendData shall copy in the output parameters *destination, *destinationSize the content and the content length of the encoded JSON tree.] */
-                            size_t resultSize = STRING_length(payload);
-                            unsigned char* temp = malloc(resultSize);
-                            if (temp == NULL)
-                            {
-                                /*Codes_SRS_DATA_MARSHALLER_99_015:[ DATA_MARSHALLER_ERROR shall be returned in all the other error cases not explicitly defined here.]*/
-                                result = DATA_MARSHALLER_ERROR;
-                                LOG_DATA_MARSHALLER_ERROR;
-                            }
-                            else
-                            {
-                                (void)memcpy(temp, STRING_c_str(payload), resultSize);
-                                *destination = temp;
-                                *destinationSize = resultSize;
-                                result = DATA_MARSHALLER_OK;
-                            }
+                            result = DATA_MARSHALLER_OK;
                         }
-                        STRING_delete(payload);
+                    }
+                    /*Codes_SRS_DATAMARSHALLER_41_001: [ DataMarshaller_SendData shall encode the JSON tree with JSONEncoder_EncodeTree_ToBuffer, which writes it straight into the buffer returned in *destination. ]*/
+                    else if (JSONEncoder_EncodeTree_ToBuffer(treeHandle, destination, destinationSize, (JSON_ENCODER_TOSTRING_FUNC)AgentDataTypes_ToString) != JSON_ENCODER_OK)
+                    {
+                        /* Codes_SRS_DATA_MARSHALLER_99_027:[ DATA_MARSHALLER_JSON_ENCODER_ERROR shall be returned when JSONEncoder returns an error code.] */
+                        result = DATA_MARSHALLER_JSON_ENCODER_ERROR;
+                        LOG_DATA_MARSHALLER_ERROR
+                    }
+                    else
+                    {
+                        /*Codes_SRS_DATAMARSHALLER_02_007: [DataMarshaller_SendData shall copy in the output parameters *destination, *destinationSize the content and the content length of the encoded JSON tree.] */
+                        result = DATA_MARSHALLER_OK;
                     }
                 } /* if (j==valueCount)*/
                 MultiTree_Destroy(treeHandle);
@@ -216,6 +215,12 @@ DATA_MARSHALLER_RESULT DataMarshaller_SendData(DATA_MARSHALLER_HANDLE dataMarsha
     return result;
 }
 
+/*Codes_SRS_DATAMARSHALLER_41_002: [ DataMarshaller_SetCBOREncoding shall select whether the data passed to DataMarshaller_SendData is encoded as CBOR (true) or JSON (false); reported properties are always encoded as JSON. ]*/
+void DataMarshaller_SetCBOREncoding(bool value)
+{
+    cborEncoding_ = value;
+}
+
 
 DATA_MARSHALLER_RESULT DataMarshaller_SendData_ReportedProperties(DATA_MARSHALLER_HANDLE dataMarshallerHandle, VECTOR_HANDLE values, unsigned char** destination, size_t* destinationSize)
 {
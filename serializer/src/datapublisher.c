@@ -5,6 +5,8 @@
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include "datapublisher.h"
 #include "jsonencoder.h"
 #include "datamarshaller.h"
@@ -14,6 +16,11 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
 DEFINE_ENUM_STRINGS(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_RESULT_VALUES)
 
 #define LOG_DATA_PUBLISHER_ERROR \
@@ -24,6 +31,29 @@ DEFINE_ENUM_STRINGS(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_RESULT_VALUES)
 /* Codes_SRS_DATA_PUBLISHER_99_067:[ Before any call to DataPublisher_SetMaxBufferSize, the default max buffer size shall be equal to 10KB.] */
 static size_t maxBufferSize_ = DEFAULT_MAX_BUFFER_SIZE;
 
+/* Codes_SRS_DATA_PUBLISHER_41_001: [ Before any call to DataPublisher_SetTransactionArenaSize, transactions shall not use an arena. ]*/
+static size_t transactionArenaSize_ = 0;
+
+#define TRANSACTION_ARENA_ALIGNMENT 8
+#define TRANSACTION_ARENA_ROUND_UP(size) (((size) + (TRANSACTION_ARENA_ALIGNMENT - 1)) & ~((size_t)TRANSACTION_ARENA_ALIGNMENT - 1))
+
+typedef struct TRANSACTION_ARENA_BLOCK_TAG
+{
+    struct TRANSACTION_ARENA_BLOCK_TAG* Next;
+    size_t Size;
+    size_t Used;
+} TRANSACTION_ARENA_BLOCK;
+
+#define TRANSACTION_ARENA_BLOCK_HEADER_SIZE TRANSACTION_ARENA_ROUND_UP(sizeof(TRANSACTION_ARENA_BLOCK))
+
+/*the property paths, the AGENT_DATA_TYPEs and the DATA_MARSHALLER_VALUEs of a transaction are carved out of the blocks of its arena
+and are all freed together when the transaction goes away. A BlockSize of 0 means that they are allocated one by one with malloc.*/
+typedef struct TRANSACTION_ARENA_TAG
+{
+    size_t BlockSize;
+    TRANSACTION_ARENA_BLOCK* Blocks; /*the block at the head is the one being carved*/
+} TRANSACTION_ARENA;
+
 typedef struct DATA_PUBLISHER_HANDLE_DATA_TAG
 {
     DATA_MARSHALLER_HANDLE DataMarshallerHandle;
@@ -34,15 +64,124 @@ typedef struct TRANSACTION_HANDLE_DATA_TAG
 {
     DATA_PUBLISHER_HANDLE_DATA* DataPublisherInstance;
     size_t ValueCount;
+    size_t ValueCapacity;
     DATA_MARSHALLER_VALUE* Values;
+    TRANSACTION_ARENA Arena;
 } TRANSACTION_HANDLE_DATA;
 
 typedef struct REPORTED_PROPERTIES_TRANSACTION_HANDLE_DATA_TAG
 {
     DATA_PUBLISHER_HANDLE_DATA* DataPublisherInstance;
     VECTOR_HANDLE value; /*holds (DATA_MARSHALLER_VALUE*) */
+    TRANSACTION_ARENA Arena;
 }REPORTED_PROPERTIES_TRANSACTION_HANDLE_DATA;
 
+static void TransactionArena_Init(TRANSACTION_ARENA* arena)
+{
+    arena->BlockSize = transactionArenaSize_;
+    arena->Blocks = NULL;
+}
+
+static void* TransactionArena_Malloc(TRANSACTION_ARENA* arena, size_t size)
+{
+    void* result;
+
+    if (arena->BlockSize == 0)
+    {
+        result = malloc(size);
+    }
+    else
+    {
+        size_t roundedSize = TRANSACTION_ARENA_ROUND_UP(size);
+        TRANSACTION_ARENA_BLOCK* block = arena->Blocks;
+
+        if (roundedSize < size)
+        {
+            LogError("size %lu is too big for the transaction arena", (unsigned long)size);
+            result = NULL;
+        }
+        /* Codes_SRS_DATA_PUBLISHER_41_003: [ Allocations shall be carved out of the current arena block while it has room for them. ]*/
+        else if ((block != NULL) && (block->Size - block->Used >= roundedSize))
+        {
+            result = (unsigned char*)block + TRANSACTION_ARENA_BLOCK_HEADER_SIZE + block->Used;
+            block->Used += roundedSize;
+        }
+        else
+        {
+            /* Codes_SRS_DATA_PUBLISHER_41_004: [ Otherwise a new block of the arena size, or of the allocation size when that is bigger, shall be allocated. ]*/
+            size_t blockSize = (roundedSize > arena->BlockSize) ? roundedSize : arena->BlockSize;
+            if ((blockSize > SIZE_MAX - TRANSACTION_ARENA_BLOCK_HEADER_SIZE) ||
+                ((block = (TRANSACTION_ARENA_BLOCK*)malloc(TRANSACTION_ARENA_BLOCK_HEADER_SIZE + blockSize)) == NULL))
+            {
+                LogError("unable to allocate a transaction arena block of %lu bytes", (unsigned long)blockSize);
+                result = NULL;
+            }
+            else
+            {
+                block->Size = blockSize;
+                block->Used = roundedSize;
+                if ((blockSize > arena->BlockSize) && (arena->Blocks != NULL))
+                {
+                    /*an oversized allocation gets a block of its own, the current block keeps being carved*/
+                    block->Next = arena->Blocks->Next;
+                    arena->Blocks->Next = block;
+                }
+                else
+                {
+                    block->Next = arena->Blocks;
+                    arena->Blocks = block;
+                }
+                result = (unsigned char*)block + TRANSACTION_ARENA_BLOCK_HEADER_SIZE;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*memory that comes from an arena is only given back by TransactionArena_Deinit*/
+static void TransactionArena_Free(TRANSACTION_ARENA* arena, void* ptr)
+{
+    if (arena->BlockSize == 0)
+    {
+        free(ptr);
+    }
+}
+
+static char* TransactionArena_CloneString(TRANSACTION_ARENA* arena, const char* source)
+{
+    char* result;
+
+    if (arena->BlockSize == 0)
+    {
+        if (mallocAndStrcpy_s(&result, source) != 0)
+        {
+            result = NULL;
+        }
+    }
+    else
+    {
+        size_t size = strlen(source) + 1;
+        if ((result = (char*)TransactionArena_Malloc(arena, size)) != NULL)
+        {
+            (void)memcpy(result, source, size);
+        }
+    }
+
+    return result;
+}
+
+/* Codes_SRS_DATA_PUBLISHER_41_005: [ All the arena blocks of a transaction shall be freed at once when the transaction is disposed of. ]*/
+static void TransactionArena_Deinit(TRANSACTION_ARENA* arena)
+{
+    while (arena->Blocks != NULL)
+    {
+        TRANSACTION_ARENA_BLOCK* next = arena->Blocks->Next;
+        free(arena->Blocks);
+        arena->Blocks = next;
+    }
+}
+
 DATA_PUBLISHER_HANDLE DataPublisher_Create(SCHEMA_MODEL_TYPE_HANDLE modelHandle, bool includePropertyPath)
 {
     DATA_PUBLISHER_HANDLE_DATA* result;
@@ -113,8 +252,10 @@ TRANSACTION_HANDLE DataPublisher_StartTransaction(DATA_PUBLISHER_HANDLE dataPubl
         else
         {
             transaction->ValueCount = 0;
+            transaction->ValueCapacity = 0;
             transaction->Values = NULL;
             transaction->DataPublisherInstance = (DATA_PUBLISHER_HANDLE_DATA*)dataPublisherHandle;
+            TransactionArena_Init(&transaction->Arena);
         }
     }
 
@@ -136,7 +277,7 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted(TRANSACTION_HANDLE transac
         result = DATA_PUBLISHER_INVALID_ARG;
         LOG_DATA_PUBLISHER_ERROR;
     }
-    else if (mallocAndStrcpy_s(&propertyPathCopy, propertyPath) != 0)
+    else if ((propertyPathCopy = TransactionArena_CloneString(&((TRANSACTION_HANDLE_DATA*)transactionHandle)->Arena, propertyPath)) == NULL)
     {
         /* Codes_SRS_DATA_PUBLISHER_99_020:[ For any errors not explicitly mentioned here the DataPublisher APIs shall return DATA_PUBLISHER_ERROR.] */
         result = DATA_PUBLISHER_ERROR;
@@ -149,15 +290,15 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted(TRANSACTION_HANDLE transac
 
         if (!Schema_ModelPropertyByPathExists(transaction->DataPublisherInstance->ModelHandle, propertyPath))
         {
-            free(propertyPathCopy);
+            TransactionArena_Free(&transaction->Arena, propertyPathCopy);
 
             /* Codes_SRS_DATA_PUBLISHER_99_040:[ When propertyPath does not exist in the supplied model, DataPublisher_Publish shall return DATA_PUBLISHER_SCHEMA_FAILED without dispatching data.] */
             result = DATA_PUBLISHER_SCHEMA_FAILED;
             LOG_DATA_PUBLISHER_ERROR;
         }
-        else if ((propertyValue = (AGENT_DATA_TYPE*)malloc(sizeof(AGENT_DATA_TYPE))) == NULL)
+        else if ((propertyValue = (AGENT_DATA_TYPE*)TransactionArena_Malloc(&transaction->Arena, sizeof(AGENT_DATA_TYPE))) == NULL)
         {
-            free(propertyPathCopy);
+            TransactionArena_Free(&transaction->Arena, propertyPathCopy);
 
             /* Codes_SRS_DATA_PUBLISHER_99_020:[ For any errors not explicitly mentioned here the DataPublisher APIs shall return DATA_PUBLISHER_ERROR.] */
             result = DATA_PUBLISHER_ERROR;
@@ -165,8 +306,8 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted(TRANSACTION_HANDLE transac
         }
         else if (Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(propertyValue, data) != AGENT_DATA_TYPES_OK)
         {
-            free(propertyPathCopy);
-            free(propertyValue);
+            TransactionArena_Free(&transaction->Arena, propertyPathCopy);
+            TransactionArena_Free(&transaction->Arena, propertyValue);
 
             /* Codes_SRS_DATA_PUBLISHER_99_028:[ If creating the copy fails then DATA_PUBLISHER_AGENT_DATA_TYPES_ERROR shall be returned.] */
             result = DATA_PUBLISHER_AGENT_DATA_TYPES_ERROR;
@@ -189,7 +330,25 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted(TRANSACTION_HANDLE transac
 
             if (propertySlot == NULL)
             {
-                DATA_MARSHALLER_VALUE* newValues = (DATA_MARSHALLER_VALUE*)realloc(transaction->Values, sizeof(DATA_MARSHALLER_VALUE)* (transaction->ValueCount + 1));
+                DATA_MARSHALLER_VALUE* newValues;
+                if (transaction->Arena.BlockSize == 0)
+                {
+                    newValues = (DATA_MARSHALLER_VALUE*)realloc(transaction->Values, sizeof(DATA_MARSHALLER_VALUE)* (transaction->ValueCount + 1));
+                }
+                else if (transaction->ValueCount < transaction->ValueCapacity)
+                {
+                    newValues = transaction->Values;
+                }
+                /* Codes_SRS_DATA_PUBLISHER_41_006: [ When the transaction uses an arena, the array of values shall be grown by doubling its capacity, the previous array being left in the arena. ]*/
+                else if ((newValues = (DATA_MARSHALLER_VALUE*)TransactionArena_Malloc(&transaction->Arena, sizeof(DATA_MARSHALLER_VALUE) * ((transaction->ValueCapacity == 0) ? 4 : transaction->ValueCapacity * 2))) != NULL)
+                {
+                    if (transaction->ValueCount > 0)
+                    {
+                        (void)memcpy(newValues, transaction->Values, sizeof(DATA_MARSHALLER_VALUE) * transaction->ValueCount);
+                    }
+                    transaction->ValueCapacity = (transaction->ValueCapacity == 0) ? 4 : transaction->ValueCapacity * 2;
+                }
+
                 if (newValues != NULL)
                 {
                     transaction->Values = newValues;
@@ -203,8 +362,8 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted(TRANSACTION_HANDLE transac
             if (propertySlot == NULL)
             {
                 Destroy_AGENT_DATA_TYPE((AGENT_DATA_TYPE*)propertyValue);
-                free(propertyValue);
-                free(propertyPathCopy);
+                TransactionArena_Free(&transaction->Arena, propertyValue);
+                TransactionArena_Free(&transaction->Arena, propertyPathCopy);
 
                 /* Codes_SRS_DATA_PUBLISHER_99_020:[ For any errors not explicitly mentioned here the DataPublisher APIs shall return DATA_PUBLISHER_ERROR.] */
                 result = DATA_PUBLISHER_ERROR;
@@ -215,12 +374,12 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted(TRANSACTION_HANDLE transac
                 if (propertySlot->Value != NULL)
                 {
                     Destroy_AGENT_DATA_TYPE((AGENT_DATA_TYPE*)propertySlot->Value);
-                    free((AGENT_DATA_TYPE*)propertySlot->Value);
+                    TransactionArena_Free(&transaction->Arena, (AGENT_DATA_TYPE*)propertySlot->Value);
                 }
                 if (propertySlot->PropertyPath != NULL)
                 {
                     char* existingValue = (char*)propertySlot->PropertyPath;
-                    free(existingValue);
+                    TransactionArena_Free(&transaction->Arena, existingValue);
                 }
 
                 /* Codes_SRS_DATA_PUBLISHER_99_016:[ When DataPublisher_PublishTransacted is invoked, DataPublisher shall associate the data with the transaction identified by the transactionHandle argument and return DATA_PUBLISHER_OK. No data shall be dispatched at the time of the call.] */
@@ -301,12 +460,13 @@ DATA_PUBLISHER_RESULT DataPublisher_CancelTransaction(TRANSACTION_HANDLE transac
         for (i = 0; i < transaction->ValueCount; i++)
         {
             Destroy_AGENT_DATA_TYPE((AGENT_DATA_TYPE*)transaction->Values[i].Value);
-            free((char*)transaction->Values[i].PropertyPath);
-            free((AGENT_DATA_TYPE*)transaction->Values[i].Value);
+            TransactionArena_Free(&transaction->Arena, (char*)transaction->Values[i].PropertyPath);
+            TransactionArena_Free(&transaction->Arena, (AGENT_DATA_TYPE*)transaction->Values[i].Value);
         }
 
         /* Codes_SRS_DATA_PUBLISHER_99_015:[ DataPublisher_CancelTransaction shall dispose of any resources associated with the transaction.] */
-        free(transaction->Values);
+        TransactionArena_Free(&transaction->Arena, transaction->Values);
+        TransactionArena_Deinit(&transaction->Arena);
         free(transaction);
 
         /* Codes_SRS_DATA_PUBLISHER_99_013:[ A call to DataPublisher_CancelTransaction shall dispose of the transaction without dispatching
@@ -329,6 +489,12 @@ size_t DataPublisher_GetMaxBufferSize(void)
     return maxBufferSize_;
 }
 
+/* Codes_SRS_DATA_PUBLISHER_41_002: [ DataPublisher_SetTransactionArenaSize shall set the size of the arena blocks used by the transactions started after the call; 0 shall make the transactions allocate their values one by one. ]*/
+void DataPublisher_SetTransactionArenaSize(size_t value)
+{
+    transactionArenaSize_ = value;
+}
+
 REPORTED_PROPERTIES_TRANSACTION_HANDLE DataPublisher_CreateTransaction_ReportedProperties(DATA_PUBLISHER_HANDLE dataPublisherHandle)
 {
     REPORTED_PROPERTIES_TRANSACTION_HANDLE_DATA* result;
@@ -362,6 +528,7 @@ REPORTED_PROPERTIES_TRANSACTION_HANDLE DataPublisher_CreateTransaction_ReportedP
             {
                 /*Codes_SRS_DATA_PUBLISHER_02_030: [ Otherwise DataPublisher_CreateTransaction_ReportedProperties shall succeed and return a non-NULL handle. ]*/
                 result->DataPublisherInstance = dataPublisherHandle;
+                TransactionArena_Init(&result->Arena);
             }
         }
     }
@@ -406,7 +573,7 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted_ReportedProperty(REPORTED_
             if(existingValue != NULL)
             {
                 /*Codes_SRS_DATA_PUBLISHER_02_014: [ If the same (by reportedPropertypath) reported property has already been added to the transaction, then DataPublisher_PublishTransacted_ReportedProperty shall overwrite the previous reported property. ]*/
-                AGENT_DATA_TYPE *clone = (AGENT_DATA_TYPE *)malloc(sizeof(AGENT_DATA_TYPE));
+                AGENT_DATA_TYPE *clone = (AGENT_DATA_TYPE *)TransactionArena_Malloc(&handleData->Arena, sizeof(AGENT_DATA_TYPE));
                 if(clone == NULL)
                 {
                     /*Codes_SRS_DATA_PUBLISHER_02_016: [ If any error occurs then DataPublisher_PublishTransacted_ReportedProperty shall fail and return DATA_PUBLISHER_ERROR. ]*/
@@ -419,14 +586,14 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted_ReportedProperty(REPORTED_
                     {
                         /*Codes_SRS_DATA_PUBLISHER_02_016: [ If any error occurs then DataPublisher_PublishTransacted_ReportedProperty shall fail and return DATA_PUBLISHER_ERROR. ]*/
                         LogError("unable to Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE");
-                        free(clone);
+                        TransactionArena_Free(&handleData->Arena, clone);
                         result = DATA_PUBLISHER_ERROR;
                     }
                     else
                     {
                         /*Codes_SRS_DATA_PUBLISHER_02_017: [ Otherwise DataPublisher_PublishTransacted_ReportedProperty shall succeed and return DATA_PUBLISHER_OK. ]*/
                         Destroy_AGENT_DATA_TYPE((AGENT_DATA_TYPE*)((*existingValue)->Value));
-                        free((void*)((*existingValue)->Value));
+                        TransactionArena_Free(&handleData->Arena, (void*)((*existingValue)->Value));
                         (*existingValue)->Value = clone;
                         result = DATA_PUBLISHER_OK;
                     }
@@ -435,7 +602,7 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted_ReportedProperty(REPORTED_
             else
             {
                 /*totally new reported property*/
-                DATA_MARSHALLER_VALUE* newValue = (DATA_MARSHALLER_VALUE*)malloc(sizeof(DATA_MARSHALLER_VALUE));
+                DATA_MARSHALLER_VALUE* newValue = (DATA_MARSHALLER_VALUE*)TransactionArena_Malloc(&handleData->Arena, sizeof(DATA_MARSHALLER_VALUE));
                 if (newValue == NULL)
                 {
                     /*Codes_SRS_DATA_PUBLISHER_02_016: [ If any error occurs then DataPublisher_PublishTransacted_ReportedProperty shall fail and return DATA_PUBLISHER_ERROR. ]*/
@@ -444,20 +611,20 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted_ReportedProperty(REPORTED_
                 }
                 else
                 {
-                    if (mallocAndStrcpy_s((char**)&(newValue->PropertyPath), reportedPropertyPath) != 0)
+                    if ((newValue->PropertyPath = TransactionArena_CloneString(&handleData->Arena, reportedPropertyPath)) == NULL)
                     {
                         /*Codes_SRS_DATA_PUBLISHER_02_016: [ If any error occurs then DataPublisher_PublishTransacted_ReportedProperty shall fail and return DATA_PUBLISHER_ERROR. ]*/
-                        LogError("unable to mallocAndStrcpy_s");
-                        free(newValue);
+                        LogError("unable to copy reportedPropertyPath");
+                        TransactionArena_Free(&handleData->Arena, newValue);
                         result = DATA_PUBLISHER_ERROR;
                     }
                     else
                     {
-                        if ((newValue->Value = (AGENT_DATA_TYPE*)malloc(sizeof(AGENT_DATA_TYPE))) == NULL)
+                        if ((newValue->Value = (AGENT_DATA_TYPE*)TransactionArena_Malloc(&handleData->Arena, sizeof(AGENT_DATA_TYPE))) == NULL)
                         {
                             LogError("unable to malloc");
-                            free((void*)newValue->PropertyPath);
-                            free(newValue);
+                            TransactionArena_Free(&handleData->Arena, (void*)newValue->PropertyPath);
+                            TransactionArena_Free(&handleData->Arena, newValue);
                             result = DATA_PUBLISHER_ERROR;
                         }
                         else
@@ -466,9 +633,9 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted_ReportedProperty(REPORTED_
                             {
                                 /*Codes_SRS_DATA_PUBLISHER_02_016: [ If any error occurs then DataPublisher_PublishTransacted_ReportedProperty shall fail and return DATA_PUBLISHER_ERROR. ]*/
                                 LogError("unable to Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE");
-                                free((void*)newValue->Value);
-                                free((void*)newValue->PropertyPath);
-                                free(newValue);
+                                TransactionArena_Free(&handleData->Arena, (void*)newValue->Value);
+                                TransactionArena_Free(&handleData->Arena, (void*)newValue->PropertyPath);
+                                TransactionArena_Free(&handleData->Arena, newValue);
                                 result = DATA_PUBLISHER_ERROR;
                             }
                             else
@@ -479,9 +646,9 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted_ReportedProperty(REPORTED_
                                     /*Codes_SRS_DATA_PUBLISHER_02_016: [ If any error occurs then DataPublisher_PublishTransacted_ReportedProperty shall fail and return DATA_PUBLISHER_ERROR. */
                                     LogError("unable to VECTOR_push_back");
                                     Destroy_AGENT_DATA_TYPE((AGENT_DATA_TYPE*)newValue->Value);
-                                    free((void*)newValue->Value);
-                                    free((void*)newValue->PropertyPath);
-                                    free(newValue);
+                                    TransactionArena_Free(&handleData->Arena, (void*)newValue->Value);
+                                    TransactionArena_Free(&handleData->Arena, (void*)newValue->PropertyPath);
+                                    TransactionArena_Free(&handleData->Arena, newValue);
                                     result = DATA_PUBLISHER_ERROR;
                                 }
                                 else
@@ -560,11 +727,12 @@ void DataPublisher_DestroyTransaction_ReportedProperties(REPORTED_PROPERTIES_TRA
         {
             DATA_MARSHALLER_VALUE *value = *(DATA_MARSHALLER_VALUE**)VECTOR_element(handleData->value, i);
             Destroy_AGENT_DATA_TYPE((AGENT_DATA_TYPE*)value->Value);
-            free((void*)value->Value);
-            free((void*)value->PropertyPath);
-            free((void*)value);
+            TransactionArena_Free(&handleData->Arena, (void*)value->Value);
+            TransactionArena_Free(&handleData->Arena, (void*)value->PropertyPath);
+            TransactionArena_Free(&handleData->Arena, (void*)value);
         }
         VECTOR_destroy(handleData->value);
+        TransactionArena_Deinit(&handleData->Arena);
         free(handleData);
     }
     return;
@@ -11,6 +11,11 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/xlogging.h"
 
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
 #define LOG_DEVICE_ERROR \
     LogError("(result = %s)", ENUM_TO_STRING(DEVICE_RESULT, result))
 
@@ -448,3 +453,34 @@ DEVICE_RESULT Device_IngestDesiredProperties(void* startAddress, DEVICE_HANDLE d
     }
     return result;
 }
+
+DEVICE_RESULT Device_GetDesiredPropertiesVersion(DEVICE_HANDLE deviceHandle, int64_t* version)
+{
+    DEVICE_RESULT result;
+    /*Codes_SRS_DEVICE_41_001: [ If deviceHandle is NULL or version is NULL then Device_GetDesiredPropertiesVersion shall fail and return DEVICE_INVALID_ARG. ]*/
+    if (
+        (deviceHandle == NULL) ||
+        (version == NULL)
+        )
+    {
+        LogError("invalid argument DEVICE_HANDLE deviceHandle=%p, int64_t* version=%p", deviceHandle, version);
+        result = DEVICE_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_DEVICE_41_002: [ Device_GetDesiredPropertiesVersion shall call CommandDecoder_GetDesiredPropertiesVersion. ]*/
+        DEVICE_HANDLE_DATA* device = (DEVICE_HANDLE_DATA*)deviceHandle;
+        if (CommandDecoder_GetDesiredPropertiesVersion(device->commandDecoderHandle, version) != 0)
+        {
+            /*Codes_SRS_DEVICE_41_003: [ If CommandDecoder_GetDesiredPropertiesVersion fails then Device_GetDesiredPropertiesVersion shall fail and return DEVICE_ERROR. ]*/
+            LogError("failure in CommandDecoder_GetDesiredPropertiesVersion");
+            result = DEVICE_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_DEVICE_41_004: [ Otherwise, Device_GetDesiredPropertiesVersion shall succeed and return DEVICE_OK. ]*/
+            result = DEVICE_OK;
+        }
+    }
+    return result;
+}
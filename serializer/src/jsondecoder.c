@@ -9,16 +9,25 @@
 #include <string.h>
 #include <ctype.h>
 #include <stddef.h>
+#include <stdbool.h>
+
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
 
 #define IsWhiteSpace(A) (((A) == 0x20) || ((A) == 0x09) || ((A) == 0x0A) || ((A) == 0x0D))
 
 typedef struct PARSER_STATE_TAG
 {
     char* json;
+    /*when callbacks is not NULL the parser builds no tree and reports the elements as they are parsed*/
+    const JSON_DECODER_CALLBACKS* callbacks;
+    void* callbackContext;
 } PARSER_STATE;
 
-static JSON_DECODER_RESULT ParseArray(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode);
-static JSON_DECODER_RESULT ParseObject(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode);
+static JSON_DECODER_RESULT ParseArray(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode, const char* name);
+static JSON_DECODER_RESULT ParseObject(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode, const char* name);
 
 /* Codes_SRS_JSON_DECODER_99_049:[ JSONDecoder shall not allocate new string values for the leafs, but rather point to strings in the original JSON.] */
 static void NoFreeFunction(void* value)
@@ -216,7 +225,81 @@ static JSON_DECODER_RESULT ParseNumber(PARSER_STATE* parserState)
     return result;
 }
 
-static JSON_DECODER_RESULT ParseValue(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode, char** stringBegin)
+static JSON_DECODER_RESULT NotifyBegin(PARSER_STATE* parserState, bool isArray, const char* name)
+{
+    JSON_DECODER_RESULT result;
+
+    if (parserState->callbacks == NULL)
+    {
+        result = JSON_DECODER_OK;
+    }
+    else
+    {
+        int(*onBegin)(void* context, const char* name) = isArray ? parserState->callbacks->onArrayBegin : parserState->callbacks->onObjectBegin;
+        if ((onBegin != NULL) && (onBegin(parserState->callbackContext, name) != 0))
+        {
+            /* Codes_SRS_JSON_DECODER_41_010: [ If any callback returns a non-zero value, JSONDecoder_JSON_To_Callbacks shall stop parsing and return JSON_DECODER_ERROR. ]*/
+            result = JSON_DECODER_ERROR;
+        }
+        else
+        {
+            result = JSON_DECODER_OK;
+        }
+    }
+
+    return result;
+}
+
+static JSON_DECODER_RESULT NotifyEnd(PARSER_STATE* parserState, bool isArray)
+{
+    JSON_DECODER_RESULT result;
+
+    if (parserState->callbacks == NULL)
+    {
+        result = JSON_DECODER_OK;
+    }
+    else
+    {
+        int(*onEnd)(void* context) = isArray ? parserState->callbacks->onArrayEnd : parserState->callbacks->onObjectEnd;
+        if ((onEnd != NULL) && (onEnd(parserState->callbackContext) != 0))
+        {
+            /* Codes_SRS_JSON_DECODER_41_010: [ If any callback returns a non-zero value, JSONDecoder_JSON_To_Callbacks shall stop parsing and return JSON_DECODER_ERROR. ]*/
+            result = JSON_DECODER_ERROR;
+        }
+        else
+        {
+            result = JSON_DECODER_OK;
+        }
+    }
+
+    return result;
+}
+
+/*value is NULL for objects and arrays, those have already been reported by their begin and end*/
+static JSON_DECODER_RESULT NotifyValue(PARSER_STATE* parserState, const char* name, const char* value)
+{
+    JSON_DECODER_RESULT result;
+
+    if ((parserState->callbacks == NULL) ||
+        (parserState->callbacks->onValue == NULL) ||
+        (value == NULL))
+    {
+        result = JSON_DECODER_OK;
+    }
+    else if (parserState->callbacks->onValue(parserState->callbackContext, name, value) != 0)
+    {
+        /* Codes_SRS_JSON_DECODER_41_010: [ If any callback returns a non-zero value, JSONDecoder_JSON_To_Callbacks shall stop parsing and return JSON_DECODER_ERROR. ]*/
+        result = JSON_DECODER_ERROR;
+    }
+    else
+    {
+        result = JSON_DECODER_OK;
+    }
+
+    return result;
+}
+
+static JSON_DECODER_RESULT ParseValue(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode, const char* name, char** stringBegin)
 {
     JSON_DECODER_RESULT result;
 
@@ -250,12 +333,12 @@ static JSON_DECODER_RESULT ParseValue(PARSER_STATE* parserState, MULTITREE_HANDL
     /* Tests_SRS_JSON_DECODER_99_018:[ A JSON value MUST be an object, array, number, or string, or one of the following three literal names: false null true] */
     else if (*(parserState->json) == '[')
     {
-        result = ParseArray(parserState, currentNode);
+        result = ParseArray(parserState, currentNode, name);
         *stringBegin = NULL;
     }
     else if (*(parserState->json) == '{')
     {
-        result = ParseObject(parserState, currentNode);
+        result = ParseObject(parserState, currentNode, name);
         *stringBegin = NULL;
     }
     else if (
@@ -317,7 +400,7 @@ static JSON_DECODER_RESULT ParseOpenCurly(PARSER_STATE* parserState)
     return result;
 }
 
-static JSON_DECODER_RESULT ParseNameValuePair(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode)
+static JSON_DECODER_RESULT ParseNameValuePair(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode, const char** memberName, char** valueBegin)
 {
     JSON_DECODER_RESULT result;
     char* memberNameBegin;
@@ -328,12 +411,21 @@ static JSON_DECODER_RESULT ParseNameValuePair(PARSER_STATE* parserState, MULTITR
     result = ParseString(parserState, &memberNameBegin);
     if (result == JSON_DECODER_OK)
     {
-        char* valueBegin;
         MULTITREE_HANDLE childNode;
         *(parserState->json - 1) = 0;
+        *memberName = memberNameBegin + 1;
+        *valueBegin = NULL;
 
         result = ParseColon(parserState);
-        if (result == JSON_DECODER_OK)
+        if (result != JSON_DECODER_OK)
+        {
+            /* already have error */
+        }
+        else if (parserState->callbacks != NULL)
+        {
+            result = ParseValue(parserState, NULL, *memberName, valueBegin);
+        }
+        else
         {
             /* Codes_SRS_JSON_DECODER_99_025:[ The names within an object SHOULD be unique.] */
             /* Multi Tree takes care of not having 2 children with the same name */
@@ -347,11 +439,11 @@ static JSON_DECODER_RESULT ParseNameValuePair(PARSER_STATE* parserState, MULTITR
             }
             else
             {
-                result = ParseValue(parserState, childNode, &valueBegin);
-                if ((result == JSON_DECODER_OK) && (valueBegin != NULL))
+                result = ParseValue(parserState, childNode, *memberName, valueBegin);
+                if ((result == JSON_DECODER_OK) && (*valueBegin != NULL))
                 {
                     /* Codes_SRS_JSON_DECODER_99_005:[ The leaf node added in the multi tree shall have the value the string value of the JSON element as parsed from the JSON object.] */
-                    if (MultiTree_SetValue(childNode, valueBegin) != MULTITREE_OK)
+                    if (MultiTree_SetValue(childNode, *valueBegin) != MULTITREE_OK)
                     {
                         /* Codes_SRS_JSON_DECODER_99_038:[ If any MultiTree API fails, JSONDecoder_JSON_To_MultiTree shall return JSON_DECODER_MULTITREE_FAILED.] */
                         result = JSON_DECODER_MULTITREE_FAILED;
@@ -364,10 +456,15 @@ static JSON_DECODER_RESULT ParseNameValuePair(PARSER_STATE* parserState, MULTITR
     return result;
 }
 
-static JSON_DECODER_RESULT ParseObject(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode)
+static JSON_DECODER_RESULT ParseObject(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode, const char* name)
 {
     JSON_DECODER_RESULT result = ParseOpenCurly(parserState);
-    if (result == JSON_DECODER_OK)
+    if (result != JSON_DECODER_OK)
+    {
+        /* already have error */
+    }
+    /* Codes_SRS_JSON_DECODER_41_004: [ When an object begins, JSONDecoder_JSON_To_Callbacks shall call onObjectBegin with the name of the object. ]*/
+    else if ((result = NotifyBegin(parserState, false, name)) == JSON_DECODER_OK)
     {
         char jsonChar;
 
@@ -377,9 +474,11 @@ static JSON_DECODER_RESULT ParseObject(PARSER_STATE* parserState, MULTITREE_HAND
         while ((jsonChar != '}') && (jsonChar != '\0'))
         {
             char* valueEnd;
+            const char* memberName;
+            char* valueBegin;
 
             /* decode each value */
-            result = ParseNameValuePair(parserState, currentNode);
+            result = ParseNameValuePair(parserState, currentNode, &memberName, &valueBegin);
             if (result != JSON_DECODER_OK)
             {
                 break;
@@ -391,6 +490,12 @@ static JSON_DECODER_RESULT ParseObject(PARSER_STATE* parserState, MULTITREE_HAND
             jsonChar = *(parserState->json);
             *valueEnd = 0;
 
+            /* Codes_SRS_JSON_DECODER_41_006: [ For each value that is not an object or an array, JSONDecoder_JSON_To_Callbacks shall call onValue with the member name and the null terminated value as it appears in the JSON. ]*/
+            if ((result = NotifyValue(parserState, memberName, valueBegin)) != JSON_DECODER_OK)
+            {
+                break;
+            }
+
             /* Codes_SRS_JSON_DECODER_99_024:[ A single comma separates a value from a following name.] */
             if (jsonChar == ',')
             {
@@ -413,6 +518,8 @@ static JSON_DECODER_RESULT ParseObject(PARSER_STATE* parserState, MULTITREE_HAND
             else
             {
                 parserState->json++;
+                /* Codes_SRS_JSON_DECODER_41_005: [ When an object ends, JSONDecoder_JSON_To_Callbacks shall call onObjectEnd. ]*/
+                result = NotifyEnd(parserState, false);
             }
         }
     }
@@ -420,7 +527,7 @@ static JSON_DECODER_RESULT ParseObject(PARSER_STATE* parserState, MULTITREE_HAND
     return result;
 }
 
-static JSON_DECODER_RESULT ParseArray(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode)
+static JSON_DECODER_RESULT ParseArray(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode, const char* name)
 {
     JSON_DECODER_RESULT result = JSON_DECODER_OK;
 
@@ -437,26 +544,30 @@ static JSON_DECODER_RESULT ParseArray(PARSER_STATE* parserState, MULTITREE_HANDL
         char* stringBegin;
         char jsonChar;
         int arrayIndex = 0;
-        result = JSON_DECODER_OK;
 
         parserState->json++;
 
+        /* Codes_SRS_JSON_DECODER_41_007: [ When an array begins, JSONDecoder_JSON_To_Callbacks shall call onArrayBegin with the name of the array. ]*/
+        result = NotifyBegin(parserState, true, name);
+
         SkipWhiteSpaces(parserState);
 
         jsonChar = *parserState->json;
-        while ((jsonChar != ']') && (jsonChar != '\0'))
+        while ((result == JSON_DECODER_OK) && (jsonChar != ']') && (jsonChar != '\0'))
         {
             char arrayIndexStr[22];
-            MULTITREE_HANDLE childNode;
+            MULTITREE_HANDLE childNode = NULL;
 
             /* Codes_SRS_JSON_DECODER_99_039:[ For array elements the multi tree node name shall be the string representation of the array index.] */
+            /* Codes_SRS_JSON_DECODER_41_008: [ For array elements the name passed to the callbacks shall be the string representation of the array index. ]*/
             if (sprintf(arrayIndexStr, "%d", arrayIndex++) < 0)
             {
                 result = JSON_DECODER_ERROR;
                 break;
             }
             /* Codes_SRS_JSON_DECODER_99_003:[ When a JSON element is decoded from the JSON object then a leaf shall be added to the MultiTree.] */
-            else if (MultiTree_AddChild(currentNode, arrayIndexStr, &childNode) != MULTITREE_OK)
+            else if ((parserState->callbacks == NULL) &&
+                (MultiTree_AddChild(currentNode, arrayIndexStr, &childNode) != MULTITREE_OK))
             {
                 /* Codes_SRS_JSON_DECODER_99_038:[ If any MultiTree API fails, JSONDecoder_JSON_To_MultiTree shall return JSON_DECODER_MULTITREE_FAILED.] */
                 result = JSON_DECODER_MULTITREE_FAILED;
@@ -466,13 +577,13 @@ static JSON_DECODER_RESULT ParseArray(PARSER_STATE* parserState, MULTITREE_HANDL
                 char* valueEnd;
 
                 /* decode each value */
-                result = ParseValue(parserState, childNode, &stringBegin);
+                result = ParseValue(parserState, childNode, arrayIndexStr, &stringBegin);
                 if (result != JSON_DECODER_OK)
                 {
                     break;
                 }
 
-                if (stringBegin != NULL)
+                if ((stringBegin != NULL) && (childNode != NULL))
                 {
                     /* Codes_SRS_JSON_DECODER_99_005:[ The leaf node added in the multi tree shall have the value the string value of the JSON element as parsed from the JSON object.] */
                     if (MultiTree_SetValue(childNode, stringBegin) != MULTITREE_OK)
@@ -489,8 +600,13 @@ static JSON_DECODER_RESULT ParseArray(PARSER_STATE* parserState, MULTITREE_HANDL
                 jsonChar = *(parserState->json);
                 *valueEnd = 0;
 
+                /* Codes_SRS_JSON_DECODER_41_006: [ For each value that is not an object or an array, JSONDecoder_JSON_To_Callbacks shall call onValue with the member name and the null terminated value as it appears in the JSON. ]*/
+                if ((result = NotifyValue(parserState, arrayIndexStr, stringBegin)) != JSON_DECODER_OK)
+                {
+                    break;
+                }
                 /* Codes_SRS_JSON_DECODER_99_027:[ Elements are separated by commas.] */
-                if (jsonChar == ',')
+                else if (jsonChar == ',')
                 {
                     parserState->json++;
                     /* get the next value pair */
@@ -523,6 +639,8 @@ static JSON_DECODER_RESULT ParseArray(PARSER_STATE* parserState, MULTITREE_HANDL
             {
                 parserState->json++;
                 SkipWhiteSpaces(parserState);
+                /* Codes_SRS_JSON_DECODER_41_009: [ When an array ends, JSONDecoder_JSON_To_Callbacks shall call onArrayEnd. ]*/
+                result = NotifyEnd(parserState, true);
             }
         }
     }
@@ -539,12 +657,12 @@ static JSON_DECODER_RESULT ParseObjectOrArray(PARSER_STATE* parserState, MULTITR
 
     if (*(parserState->json) == '{')
     {
-        result = ParseObject(parserState, currentNode);
+        result = ParseObject(parserState, currentNode, NULL);
         SkipWhiteSpaces(parserState);
     }
     else if (*(parserState->json) == '[')
     {
-        result = ParseArray(parserState, currentNode);
+        result = ParseArray(parserState, currentNode, NULL);
         SkipWhiteSpaces(parserState);
     }
     else
@@ -568,6 +686,8 @@ static JSON_DECODER_RESULT ParseJSON(char* json, MULTITREE_HANDLE currentNode)
     /* Codes_SRS_JSON_DECODER_99_009:[ On success, JSONDecoder_JSON_To_MultiTree shall return a handle to the multi tree it created in the multiTreeHandle argument and it shall return JSON_DECODER_OK.] */
     PARSER_STATE parseState;
     parseState.json = json;
+    parseState.callbacks = NULL;
+    parseState.callbackContext = NULL;
     return ParseObjectOrArray(&parseState, currentNode);
 }
 
@@ -609,3 +729,32 @@ JSON_DECODER_RESULT JSONDecoder_JSON_To_MultiTree(char* json, MULTITREE_HANDLE*
 
     return result;
 }
+
+JSON_DECODER_RESULT JSONDecoder_JSON_To_Callbacks(char* json, const JSON_DECODER_CALLBACKS* callbacks, void* callbackContext)
+{
+    JSON_DECODER_RESULT result;
+
+    if ((json == NULL) ||
+        (callbacks == NULL))
+    {
+        /* Codes_SRS_JSON_DECODER_41_001: [ If json or callbacks is NULL then JSONDecoder_JSON_To_Callbacks shall return JSON_DECODER_INVALID_ARG. ]*/
+        result = JSON_DECODER_INVALID_ARG;
+    }
+    else if (*json == '\0')
+    {
+        /* Codes_SRS_JSON_DECODER_41_002: [ If parsing the JSON fails due to the JSON string being malformed, JSONDecoder_JSON_To_Callbacks shall return JSON_DECODER_PARSE_ERROR. ]*/
+        result = JSON_DECODER_PARSE_ERROR;
+    }
+    else
+    {
+        /* Codes_SRS_JSON_DECODER_41_003: [ JSONDecoder_JSON_To_Callbacks shall parse json in place with the same grammar as JSONDecoder_JSON_To_MultiTree, without creating a multi tree. ]*/
+        /* Codes_SRS_JSON_DECODER_41_011: [ On success JSONDecoder_JSON_To_Callbacks shall return JSON_DECODER_OK. ]*/
+        PARSER_STATE parseState;
+        parseState.json = json;
+        parseState.callbacks = callbacks;
+        parseState.callbackContext = callbackContext;
+        result = ParseObjectOrArray(&parseState, NULL);
+    }
+
+    return result;
+}
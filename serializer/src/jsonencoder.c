@@ -1,12 +1,19 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 
 #include "jsonencoder.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/strings.h"
+#include <string.h>
+
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
 
 #ifdef _MSC_VER
 #pragma warning(disable: 4701) /* potentially uninitialized local variable 'result' used */ /* the scanner cannot track variable "i" and link it to childCount*/
@@ -190,6 +197,193 @@ JSON_ENCODER_RESULT JSONEncoder_EncodeTree(MULTITREE_HANDLE treeHandle, STRING_H
 #endif
 }
 
+/*a growable output buffer, the JSON is appended to it with memcpy of known lengths*/
+typedef struct JSON_ENCODER_SINK_TAG
+{
+    unsigned char* buffer;
+    size_t size;
+    size_t capacity;
+    STRING_HANDLE scratch; /*reused for every name and value*/
+} JSON_ENCODER_SINK;
+
+#define JSON_ENCODER_SINK_INITIAL_CAPACITY 64
+
+static int Sink_Write(JSON_ENCODER_SINK* sink, const char* source, size_t length)
+{
+    int result;
+    if (length > sink->capacity - sink->size)
+    {
+        /*Codes_SRS_JSON_ENCODER_41_003: [ The output buffer shall grow by doubling its capacity. ]*/
+        size_t newCapacity = (sink->capacity == 0) ? JSON_ENCODER_SINK_INITIAL_CAPACITY : sink->capacity;
+        unsigned char* newBuffer;
+        while (newCapacity - sink->size < length)
+        {
+            newCapacity *= 2;
+        }
+
+        if ((newBuffer = (unsigned char*)realloc(sink->buffer, newCapacity)) == NULL)
+        {
+            LogError("failure reallocating %lu bytes for the JSON", (unsigned long)newCapacity);
+            result = __FAILURE__;
+        }
+        else
+        {
+            sink->buffer = newBuffer;
+            sink->capacity = newCapacity;
+            result = 0;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if (result == 0)
+    {
+        (void)memcpy(sink->buffer + sink->size, source, length);
+        sink->size += length;
+    }
+    return result;
+}
+
+#define Sink_WriteLiteral(sink, literal) Sink_Write((sink), (literal), sizeof(literal) - 1)
+
+static int Sink_WriteScratch(JSON_ENCODER_SINK* sink)
+{
+    int result = Sink_Write(sink, STRING_c_str(sink->scratch), STRING_length(sink->scratch));
+    if (STRING_empty(sink->scratch) != 0)
+    {
+        LogError("failure in STRING_empty");
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+static JSON_ENCODER_RESULT EncodeTreeToSink(MULTITREE_HANDLE treeHandle, JSON_ENCODER_SINK* sink, JSON_ENCODER_TOSTRING_FUNC toStringFunc)
+{
+    JSON_ENCODER_RESULT result;
+    size_t childCount;
+
+    /*Codes_SRS_JSON_ENCODER_41_002: [ JSONEncoder_EncodeTree_ToBuffer shall produce the same JSON as JSONEncoder_EncodeTree. ]*/
+    if (MultiTree_GetChildCount(treeHandle, &childCount) != MULTITREE_OK)
+    {
+        result = JSON_ENCODER_MULTITREE_ERROR;
+        LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+    }
+    else if (Sink_WriteLiteral(sink, "{") != 0)
+    {
+        result = JSON_ENCODER_ERROR;
+        LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+    }
+    else
+    {
+        size_t i;
+        result = JSON_ENCODER_OK;
+        for (i = 0; (i < childCount) && (result == JSON_ENCODER_OK); i++)
+        {
+            MULTITREE_HANDLE childTreeHandle;
+            size_t innerChildCount;
+
+            if (((i > 0) && (Sink_WriteLiteral(sink, ", ") != 0)) ||
+                (Sink_WriteLiteral(sink, "\"") != 0))
+            {
+                result = JSON_ENCODER_ERROR;
+                LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+            }
+            else if ((MultiTree_GetChild(treeHandle, i, &childTreeHandle) != MULTITREE_OK) ||
+                (MultiTree_GetName(childTreeHandle, sink->scratch) != MULTITREE_OK) ||
+                (MultiTree_GetChildCount(childTreeHandle, &innerChildCount) != MULTITREE_OK))
+            {
+                result = JSON_ENCODER_MULTITREE_ERROR;
+                LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+            }
+            else if ((Sink_WriteScratch(sink) != 0) ||
+                (Sink_WriteLiteral(sink, "\":") != 0))
+            {
+                result = JSON_ENCODER_ERROR;
+                LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+            }
+            else if (innerChildCount > 0)
+            {
+                /*the child is written in place, there is no intermediate string per subtree*/
+                result = EncodeTreeToSink(childTreeHandle, sink, toStringFunc);
+            }
+            else
+            {
+                const void* value;
+                if (MultiTree_GetValue(childTreeHandle, &value) != MULTITREE_OK)
+                {
+                    result = JSON_ENCODER_MULTITREE_ERROR;
+                    LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+                }
+                else if (toStringFunc(sink->scratch, value) != JSON_ENCODER_TOSTRING_OK)
+                {
+                    result = JSON_ENCODER_TOSTRING_FUNCTION_ERROR;
+                    LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+                }
+                else if (Sink_WriteScratch(sink) != 0)
+                {
+                    result = JSON_ENCODER_ERROR;
+                    LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+                }
+            }
+        }
+
+        if ((result == JSON_ENCODER_OK) &&
+            (Sink_WriteLiteral(sink, "}") != 0))
+        {
+            result = JSON_ENCODER_ERROR;
+            LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+        }
+    }
+
+    return result;
+}
+
+JSON_ENCODER_RESULT JSONEncoder_EncodeTree_ToBuffer(MULTITREE_HANDLE treeHandle, unsigned char** destination, size_t* destinationSize, JSON_ENCODER_TOSTRING_FUNC toStringFunc)
+{
+    JSON_ENCODER_RESULT result;
+
+    /*Codes_SRS_JSON_ENCODER_41_001: [ If any of the arguments passed to JSONEncoder_EncodeTree_ToBuffer is NULL then JSON_ENCODER_INVALID_ARG shall be returned. ]*/
+    if ((treeHandle == NULL) ||
+        (destination == NULL) ||
+        (destinationSize == NULL) ||
+        (toStringFunc == NULL))
+    {
+        result = JSON_ENCODER_INVALID_ARG;
+        LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+    }
+    else
+    {
+        JSON_ENCODER_SINK sink;
+        sink.buffer = NULL;
+        sink.size = 0;
+        sink.capacity = 0;
+        if ((sink.scratch = STRING_new()) == NULL)
+        {
+            result = JSON_ENCODER_ERROR;
+            LogError("(result = %s)", ENUM_TO_STRING(JSON_ENCODER_RESULT, result));
+        }
+        else
+        {
+            if ((result = EncodeTreeToSink(treeHandle, &sink, toStringFunc)) != JSON_ENCODER_OK)
+            {
+                /*Codes_SRS_JSON_ENCODER_41_005: [ If any failure occurs, JSONEncoder_EncodeTree_ToBuffer shall free the output buffer and return the error. ]*/
+                free(sink.buffer);
+            }
+            else
+            {
+                /*Codes_SRS_JSON_ENCODER_41_004: [ On success, JSONEncoder_EncodeTree_ToBuffer shall hand the output buffer (not null terminated) to the caller in *destination and its length in *destinationSize, and return JSON_ENCODER_OK. ]*/
+                *destination = sink.buffer;
+                *destinationSize = sink.size;
+            }
+            STRING_delete(sink.scratch);
+        }
+    }
+
+    return result;
+}
+
 JSON_ENCODER_TOSTRING_RESULT JSONEncoder_CharPtr_ToString(STRING_HANDLE destination, const void* value)
 {
     JSON_ENCODER_TOSTRING_RESULT result;
@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <limits.h>
 
 #include "azure_c_shared_utility/gballoc.h"
@@ -12,11 +14,20 @@
 
 #define METHODRETURN_C
 #include "methodreturn.h"
+
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
 #undef METHODRETURN_C
 
 typedef struct METHODRETURN_HANDLE_DATA_TAG
 {
     METHODRETURN_DATA data;
+    /*true when data.jsonValue was allocated by this module or handed over by the caller and is released with free*/
+    bool ownsJsonValue;
+    METHODRETURN_BUFFER_FREE_CALLBACK freeCallback;
+    void* context;
 }METHODRETURN_HANDLE_DATA;
 
 METHODRETURN_HANDLE MethodReturn_Create(int statusCode, const char* jsonValue)
@@ -44,7 +55,11 @@ METHODRETURN_HANDLE MethodReturn_Create(int statusCode, const char* jsonValue)
             {
                 /*Codes_SRS_METHODRETURN_02_001: [ MethodReturn_Create shall create a non-NULL handle containing statusCode and a clone of jsonValue. ]*/
                 result->data.jsonValue = NULL;
+                result->data.jsonValueSize = 0;
                 result->data.statusCode = statusCode;
+                result->ownsJsonValue = false;
+                result->freeCallback = NULL;
+                result->context = NULL;
             }
             else
             {
@@ -57,7 +72,11 @@ METHODRETURN_HANDLE MethodReturn_Create(int statusCode, const char* jsonValue)
                 else
                 {
                     /*Codes_SRS_METHODRETURN_02_001: [ MethodReturn_Create shall create a non-NULL handle containing statusCode and a clone of jsonValue. ]*/
+                    result->data.jsonValueSize = strlen(result->data.jsonValue);
                     result->data.statusCode = statusCode;
+                    result->ownsJsonValue = true;
+                    result->freeCallback = NULL;
+                    result->context = NULL;
                 }
             }
         }
@@ -66,6 +85,96 @@ METHODRETURN_HANDLE MethodReturn_Create(int statusCode, const char* jsonValue)
     return result;
 }
 
+METHODRETURN_HANDLE MethodReturn_CreateFromBorrowedBuffer(int statusCode, const char* jsonValue, size_t size, METHODRETURN_BUFFER_FREE_CALLBACK freeCallback, void* context)
+{
+    METHODRETURN_HANDLE result;
+    if ((jsonValue == NULL) || (size == 0))
+    {
+        /*Codes_SRS_METHODRETURN_41_001: [ If jsonValue is NULL or size is 0 then MethodReturn_CreateFromBorrowedBuffer shall fail and return NULL. ]*/
+        LogError("invalid argument const char* jsonValue=%p, size_t size=%lu", jsonValue, (unsigned long)size);
+        result = NULL;
+    }
+    else
+    {
+        result = (METHODRETURN_HANDLE_DATA*)malloc(sizeof(METHODRETURN_HANDLE_DATA));
+        if (result == NULL)
+        {
+            /*Codes_SRS_METHODRETURN_41_003: [ If any failure is encountered then MethodReturn_CreateFromBorrowedBuffer shall return NULL and shall not call freeCallback. ]*/
+            LogError("unable to malloc");
+            /*return as is*/
+        }
+        else
+        {
+            /*Codes_SRS_METHODRETURN_41_002: [ MethodReturn_CreateFromBorrowedBuffer shall create a non-NULL handle containing statusCode and a reference to the size bytes of jsonValue, without copying or parsing them. ]*/
+            result->data.statusCode = statusCode;
+            result->data.jsonValue = (char*)jsonValue;
+            result->data.jsonValueSize = size;
+            result->ownsJsonValue = false;
+            result->freeCallback = freeCallback;
+            result->context = context;
+        }
+    }
+    return result;
+}
+
+METHODRETURN_HANDLE MethodReturn_CreateFromSerializedBuffer(int statusCode, unsigned char* buffer, size_t size)
+{
+    METHODRETURN_HANDLE result;
+    if ((buffer == NULL) || (size == 0))
+    {
+        /*Codes_SRS_METHODRETURN_41_004: [ If buffer is NULL or size is 0 then MethodReturn_CreateFromSerializedBuffer shall fail and return NULL. ]*/
+        LogError("invalid argument unsigned char* buffer=%p, size_t size=%lu", buffer, (unsigned long)size);
+        result = NULL;
+    }
+    else
+    {
+        result = (METHODRETURN_HANDLE_DATA*)malloc(sizeof(METHODRETURN_HANDLE_DATA));
+        if (result == NULL)
+        {
+            /*Codes_SRS_METHODRETURN_41_006: [ If any failure is encountered then MethodReturn_CreateFromSerializedBuffer shall return NULL and the caller keeps the ownership of buffer. ]*/
+            LogError("unable to malloc");
+            /*return as is*/
+        }
+        else
+        {
+            /*Codes_SRS_METHODRETURN_41_005: [ MethodReturn_CreateFromSerializedBuffer shall create a non-NULL handle containing statusCode and taking the ownership of buffer, without copying or parsing it. ]*/
+            result->data.statusCode = statusCode;
+            result->data.jsonValue = (char*)buffer;
+            result->data.jsonValueSize = size;
+            result->ownsJsonValue = true;
+            result->freeCallback = NULL;
+            result->context = NULL;
+        }
+    }
+    return result;
+}
+
+unsigned char* MethodReturn_DetachBuffer(METHODRETURN_HANDLE handle, size_t* size)
+{
+    unsigned char* result;
+    if ((handle == NULL) || (size == NULL))
+    {
+        /*Codes_SRS_METHODRETURN_41_007: [ If handle or size is NULL then MethodReturn_DetachBuffer shall fail and return NULL. ]*/
+        LogError("invalid argument METHODRETURN_HANDLE handle=%p, size_t* size=%p", handle, size);
+        result = NULL;
+    }
+    else if ((!handle->ownsJsonValue) || (handle->data.jsonValue == NULL))
+    {
+        /*Codes_SRS_METHODRETURN_41_008: [ If handle does not own its JSON value then MethodReturn_DetachBuffer shall return NULL and leave handle unchanged. ]*/
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_METHODRETURN_41_009: [ Otherwise, MethodReturn_DetachBuffer shall set *size to the size of the JSON value, return it and hand its ownership to the caller, who releases it with free. ]*/
+        result = (unsigned char*)handle->data.jsonValue;
+        *size = handle->data.jsonValueSize;
+        handle->data.jsonValue = NULL;
+        handle->data.jsonValueSize = 0;
+        handle->ownsJsonValue = false;
+    }
+    return result;
+}
+
 void MethodReturn_Destroy(METHODRETURN_HANDLE handle)
 {
     if (handle == NULL)
@@ -78,7 +187,19 @@ void MethodReturn_Destroy(METHODRETURN_HANDLE handle)
         /*Codes_SRS_METHODRETURN_02_004: [ Otherwise, MethodReturn_Destroy shall free all used resources by handle. ]*/
         if (handle->data.jsonValue != NULL)
         {
-            free(handle->data.jsonValue);
+            if (handle->ownsJsonValue)
+            {
+                free(handle->data.jsonValue);
+            }
+            else if (handle->freeCallback != NULL)
+            {
+                /*Codes_SRS_METHODRETURN_41_010: [ If handle was created by MethodReturn_CreateFromBorrowedBuffer with a non-NULL freeCallback then MethodReturn_Destroy shall call freeCallback passing jsonValue and context. ]*/
+                handle->freeCallback(handle->data.jsonValue, handle->context);
+            }
+            else
+            {
+                /*the buffer is borrowed and the caller releases it*/
+            }
         }
         free(handle);
     }
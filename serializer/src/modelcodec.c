@@ -0,0 +1,964 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <limits.h>
+#include "modelcodec.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
+#ifndef _HUGE_ENUF
+#define _HUGE_ENUF  1e+300	/* _HUGE_ENUF*_HUGE_ENUF must overflow */
+#endif /* _HUGE_ENUF */
+
+#ifndef INFINITY
+#define INFINITY   ((float)(_HUGE_ENUF * _HUGE_ENUF))
+#endif /* INFINITY */
+
+#ifndef NAN
+#define NAN        ((float)(INFINITY * 0.0F))
+#endif /* NAN */
+
+static const char hexToASCII[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+
+int ModelCodec_WriteInt64(char* destination, int64_t value)
+{
+    char digits[20];
+    size_t nDigits = 0;
+    int pos = 0;
+    uint64_t positiveValue;
+
+    /*Codes_SRS_MODELCODEC_41_010: [ ModelCodec_WriteInt64 shall write value in decimal, preceded by - when it is negative. ]*/
+    if (value < 0)
+    {
+        destination[pos++] = '-';
+        positiveValue = (uint64_t)0 - (uint64_t)value;
+    }
+    else
+    {
+        positiveValue = (uint64_t)value;
+    }
+
+    do
+    {
+        digits[nDigits++] = (char)('0' + (positiveValue % 10));
+        positiveValue /= 10;
+    } while (positiveValue != 0);
+
+    while (nDigits > 0)
+    {
+        destination[pos++] = digits[--nDigits];
+    }
+
+    return pos;
+}
+
+int ModelCodec_WriteBool(char* destination, bool value)
+{
+    int result;
+
+    /*Codes_SRS_MODELCODEC_41_011: [ ModelCodec_WriteBool shall write true or false. ]*/
+    if (value)
+    {
+        (void)memcpy(destination, "true", 4);
+        result = 4;
+    }
+    else
+    {
+        (void)memcpy(destination, "false", 5);
+        result = 5;
+    }
+
+    return result;
+}
+
+#ifndef NO_FLOATS
+static int WriteFloatingPoint(char* destination, double value, int precision)
+{
+    int result;
+
+    /*Codes_SRS_MODELCODEC_41_012: [ ModelCodec_WriteDouble and ModelCodec_WriteFloat shall write NaN, INF and -INF for the values that are not numbers, otherwise the value in fixed notation with DBL_DIG, respectively FLT_DIG, decimals. ]*/
+    if (ISNAN(value))
+    {
+        (void)memcpy(destination, "NaN", 3);
+        result = 3;
+    }
+    else if (ISNEGATIVEINFINITY(value))
+    {
+        (void)memcpy(destination, "-INF", 4);
+        result = 4;
+    }
+    else if (ISPOSITIVEINFINITY(value))
+    {
+        (void)memcpy(destination, "INF", 3);
+        result = 3;
+    }
+    else
+    {
+        char temp[MODEL_CODEC_MAX_DOUBLE_LENGTH];
+        result = sprintf_s(temp, sizeof(temp), "%.*f", precision, value);
+        if (result > 0)
+        {
+            (void)memcpy(destination, temp, result);
+        }
+        else
+        {
+            LogError("unable to print a floating point value");
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+int ModelCodec_WriteFloat(char* destination, float value)
+{
+    return WriteFloatingPoint(destination, (double)value, FLT_DIG);
+}
+
+int ModelCodec_WriteDouble(char* destination, double value)
+{
+    return WriteFloatingPoint(destination, value, DBL_DIG);
+}
+#endif
+
+size_t ModelCodec_GetStringMaxLength(const char* value)
+{
+    /*Codes_SRS_MODELCODEC_41_013: [ ModelCodec_GetStringMaxLength shall return the length of value with every character escaped as \u00XX and the quotes, 0 when value is NULL. ]*/
+    return (value == NULL) ? 0 : (strlen(value) * 6 + 2);
+}
+
+int ModelCodec_WriteString(char* destination, const char* value)
+{
+    int result;
+
+    if (value == NULL)
+    {
+        /*Codes_SRS_MODELCODEC_41_014: [ If value is NULL, ModelCodec_WriteString shall fail and return a negative number. ]*/
+        LogError("invalid argument value=NULL");
+        result = -1;
+    }
+    else
+    {
+        const unsigned char* source = (const unsigned char*)value;
+        int pos = 0;
+        destination[pos++] = '"';
+        /*Codes_SRS_MODELCODEC_41_015: [ ModelCodec_WriteString shall write value between quotes, with ", \ and / escaped by \ and the control characters as \u00XX. ]*/
+        while (*source != '\0')
+        {
+            if (*source >= 128)
+            {
+                /*Codes_SRS_MODELCODEC_41_016: [ If value has a character that is not ASCII, ModelCodec_WriteString shall fail and return a negative number. ]*/
+                break;
+            }
+            else if (*source <= 0x1F)
+            {
+                destination[pos++] = '\\';
+                destination[pos++] = 'u';
+                destination[pos++] = '0';
+                destination[pos++] = '0';
+                destination[pos++] = hexToASCII[(*source & 0xF0) >> 4];
+                destination[pos++] = hexToASCII[*source & 0x0F];
+            }
+            else if ((*source == '"') || (*source == '\\') || (*source == '/'))
+            {
+                destination[pos++] = '\\';
+                destination[pos++] = (char)*source;
+            }
+            else
+            {
+                destination[pos++] = (char)*source;
+            }
+            source++;
+        }
+
+        if (*source != '\0')
+        {
+            LogError("only ASCII strings can be written");
+            result = -1;
+        }
+        else
+        {
+            destination[pos++] = '"';
+            result = pos;
+        }
+    }
+
+    return result;
+}
+
+static void SkipWhitespace(MODEL_CODEC_READER* reader)
+{
+    while ((*reader->position == ' ') || (*reader->position == '\t') || (*reader->position == '\n') || (*reader->position == '\r'))
+    {
+        reader->position++;
+    }
+}
+
+/*moves the reader after the string it is at, returns the position of its first character and its length without the quotes*/
+static int SkipString(MODEL_CODEC_READER* reader, const char** chars, size_t* length)
+{
+    int result;
+
+    if (*reader->position != '"')
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        const char* current = reader->position + 1;
+        while ((*current != '"') && ((unsigned char)*current >= 0x20))
+        {
+            current += ((*current == '\\') && (current[1] != '\0')) ? 2 : 1;
+        }
+
+        if (*current != '"')
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            *chars = reader->position + 1;
+            *length = (size_t)(current - *chars);
+            reader->position = current + 1;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int ModelCodec_BeginObject(MODEL_CODEC_READER* reader, const char* json)
+{
+    int result;
+
+    reader->position = json;
+    reader->hasMembers = false;
+    SkipWhitespace(reader);
+    if (*reader->position != '{')
+    {
+        /*Codes_SRS_MODELCODEC_41_017: [ If json is not a JSON object, ModelCodec_BeginObject shall fail and return a non-zero value. ]*/
+        LogError("the JSON is not an object");
+        result = __FAILURE__;
+    }
+    else
+    {
+        reader->position++;
+        result = 0;
+    }
+
+    return result;
+}
+
+int ModelCodec_NextKey(MODEL_CODEC_READER* reader, const char** key, size_t* keyLength, bool* isEnd)
+{
+    int result;
+
+    SkipWhitespace(reader);
+    if (*reader->position == '}')
+    {
+        reader->position++;
+        SkipWhitespace(reader);
+        if (*reader->position != '\0')
+        {
+            /*Codes_SRS_MODELCODEC_41_019: [ If anything but whitespace follows the end of the object, ModelCodec_NextKey shall fail and return a non-zero value. ]*/
+            LogError("unexpected characters after the JSON object");
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_MODELCODEC_41_018: [ At the end of the object, ModelCodec_NextKey shall set isEnd to true and return 0. ]*/
+            *isEnd = true;
+            result = 0;
+        }
+    }
+    else if (reader->hasMembers && (*reader->position++ != ','))
+    {
+        LogError("a member of the JSON object is not followed by , or }");
+        result = __FAILURE__;
+    }
+    else
+    {
+        SkipWhitespace(reader);
+        /*Codes_SRS_MODELCODEC_41_020: [ Otherwise ModelCodec_NextKey shall set key and keyLength to the characters of the next key, as they are written between the quotes, and move the reader to its value. ]*/
+        if (SkipString(reader, key, keyLength) != 0)
+        {
+            LogError("invalid key in the JSON object");
+            result = __FAILURE__;
+        }
+        else
+        {
+            SkipWhitespace(reader);
+            if (*reader->position != ':')
+            {
+                LogError("a key of the JSON object is not followed by :");
+                result = __FAILURE__;
+            }
+            else
+            {
+                reader->position++;
+                SkipWhitespace(reader);
+                reader->hasMembers = true;
+                *isEnd = false;
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+int ModelCodec_SkipValue(MODEL_CODEC_READER* reader)
+{
+    int result;
+
+    if (*reader->position == '"')
+    {
+        const char* chars;
+        size_t length;
+        result = SkipString(reader, &chars, &length);
+    }
+    else if ((*reader->position == '{') || (*reader->position == '['))
+    {
+        /*Codes_SRS_MODELCODEC_41_021: [ ModelCodec_SkipValue shall move the reader after the value it is at, a string, an object or an array with all they hold, a number or a literal. ]*/
+        size_t depth = 0;
+        result = 0;
+        do
+        {
+            if (*reader->position == '"')
+            {
+                const char* chars;
+                size_t length;
+                result = SkipString(reader, &chars, &length);
+            }
+            else if (*reader->position == '\0')
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                if ((*reader->position == '{') || (*reader->position == '['))
+                {
+                    depth++;
+                }
+                else if ((*reader->position == '}') || (*reader->position == ']'))
+                {
+                    depth--;
+                }
+                reader->position++;
+            }
+        } while ((result == 0) && (depth > 0));
+    }
+    else
+    {
+        const char* start = reader->position;
+        while ((*reader->position != '\0') && (*reader->position != ',') && (*reader->position != '}') && (*reader->position != ']') &&
+            (*reader->position != ' ') && (*reader->position != '\t') && (*reader->position != '\n') && (*reader->position != '\r'))
+        {
+            reader->position++;
+        }
+        result = (reader->position == start) ? __FAILURE__ : 0;
+    }
+
+    if (result != 0)
+    {
+        /*Codes_SRS_MODELCODEC_41_022: [ If there is no value at the reader or it does not end, ModelCodec_SkipValue shall fail and return a non-zero value. ]*/
+        LogError("invalid value in the JSON object");
+    }
+
+    return result;
+}
+
+/*reads an integer written without fraction nor exponent, between minimum and maximum*/
+static int ReadInteger(MODEL_CODEC_READER* reader, int64_t minimum, int64_t maximum, int64_t* destination)
+{
+    int result;
+    const char* current = reader->position;
+    bool isNegative = (*current == '-');
+    uint64_t magnitude = 0;
+    uint64_t limit;
+    bool isOverflow = false;
+
+    if (isNegative)
+    {
+        current++;
+    }
+    limit = isNegative ? ((uint64_t)0 - (uint64_t)minimum) : (uint64_t)maximum;
+
+    if ((*current < '0') || (*current > '9'))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        while ((*current >= '0') && (*current <= '9'))
+        {
+            uint64_t digit = (uint64_t)(*current - '0');
+            if (magnitude > (limit - digit) / 10)
+            {
+                isOverflow = true;
+            }
+            else
+            {
+                magnitude = magnitude * 10 + digit;
+            }
+            current++;
+        }
+
+        if ((*current == '.') || (*current == 'e') || (*current == 'E') || isOverflow)
+        {
+            /*Codes_SRS_MODELCODEC_41_024: [ If the value is not an integer in the range of the type, the integer readers shall fail and return a non-zero value. ]*/
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_MODELCODEC_41_023: [ The integer readers shall read a JSON number without fraction nor exponent. ]*/
+            *destination = isNegative ? (int64_t)((uint64_t)0 - magnitude) : (int64_t)magnitude;
+            reader->position = current;
+            result = 0;
+        }
+    }
+
+    if (result != 0)
+    {
+        LogError("the value is not an integer in [%" PRId64 ", %" PRId64 "]", minimum, maximum);
+    }
+
+    return result;
+}
+
+int ModelCodec_ReadInt(MODEL_CODEC_READER* reader, int* destination)
+{
+    int64_t value;
+    int result = ReadInteger(reader, INT_MIN, INT_MAX, &value);
+    if (result == 0)
+    {
+        *destination = (int)value;
+    }
+    return result;
+}
+
+int ModelCodec_ReadLong(MODEL_CODEC_READER* reader, long* destination)
+{
+    int64_t value;
+    int result = ReadInteger(reader, LONG_MIN, LONG_MAX, &value);
+    if (result == 0)
+    {
+        *destination = (long)value;
+    }
+    return result;
+}
+
+int ModelCodec_ReadInt8(MODEL_CODEC_READER* reader, int8_t* destination)
+{
+    int64_t value;
+    int result = ReadInteger(reader, INT8_MIN, INT8_MAX, &value);
+    if (result == 0)
+    {
+        *destination = (int8_t)value;
+    }
+    return result;
+}
+
+int ModelCodec_ReadUInt8(MODEL_CODEC_READER* reader, uint8_t* destination)
+{
+    int64_t value;
+    int result = ReadInteger(reader, 0, UINT8_MAX, &value);
+    if (result == 0)
+    {
+        *destination = (uint8_t)value;
+    }
+    return result;
+}
+
+int ModelCodec_ReadInt16(MODEL_CODEC_READER* reader, int16_t* destination)
+{
+    int64_t value;
+    int result = ReadInteger(reader, INT16_MIN, INT16_MAX, &value);
+    if (result == 0)
+    {
+        *destination = (int16_t)value;
+    }
+    return result;
+}
+
+int ModelCodec_ReadInt32(MODEL_CODEC_READER* reader, int32_t* destination)
+{
+    int64_t value;
+    int result = ReadInteger(reader, INT32_MIN, INT32_MAX, &value);
+    if (result == 0)
+    {
+        *destination = (int32_t)value;
+    }
+    return result;
+}
+
+int ModelCodec_ReadInt64(MODEL_CODEC_READER* reader, int64_t* destination)
+{
+    return ReadInteger(reader, INT64_MIN, INT64_MAX, destination);
+}
+
+int ModelCodec_ReadBool(MODEL_CODEC_READER* reader, bool* destination)
+{
+    int result;
+
+    /*Codes_SRS_MODELCODEC_41_025: [ ModelCodec_ReadBool shall read true or false, and fail for any other value. ]*/
+    if (strncmp(reader->position, "true", 4) == 0)
+    {
+        *destination = true;
+        reader->position += 4;
+        result = 0;
+    }
+    else if (strncmp(reader->position, "false", 5) == 0)
+    {
+        *destination = false;
+        reader->position += 5;
+        result = 0;
+    }
+    else
+    {
+        LogError("the value is not a boolean");
+        result = __FAILURE__;
+    }
+
+    return result;
+}
+
+#ifndef NO_FLOATS
+static int ReadFloatingPoint(MODEL_CODEC_READER* reader, double* destination)
+{
+    int result;
+
+    /*Codes_SRS_MODELCODEC_41_026: [ ModelCodec_ReadDouble and ModelCodec_ReadFloat shall read a JSON number, or the NaN, INF and -INF the writers write, and fail for any other value. ]*/
+    if (strncmp(reader->position, "NaN", 3) == 0)
+    {
+        *destination = NAN;
+        reader->position += 3;
+        result = 0;
+    }
+    else if (strncmp(reader->position, "INF", 3) == 0)
+    {
+        *destination = INFINITY;
+        reader->position += 3;
+        result = 0;
+    }
+    else if (strncmp(reader->position, "-INF", 4) == 0)
+    {
+        *destination = -INFINITY;
+        reader->position += 4;
+        result = 0;
+    }
+    else if ((*reader->position != '-') && ((*reader->position < '0') || (*reader->position > '9')))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        char* end;
+        double value = strtod(reader->position, &end);
+        if (end == reader->position)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            *destination = value;
+            reader->position = end;
+            result = 0;
+        }
+    }
+
+    if (result != 0)
+    {
+        LogError("the value is not a number");
+    }
+
+    return result;
+}
+
+int ModelCodec_ReadFloat(MODEL_CODEC_READER* reader, float* destination)
+{
+    double value;
+    int result = ReadFloatingPoint(reader, &value);
+    if (result == 0)
+    {
+        *destination = (float)value;
+    }
+    return result;
+}
+
+int ModelCodec_ReadDouble(MODEL_CODEC_READER* reader, double* destination)
+{
+    return ReadFloatingPoint(reader, destination);
+}
+#endif
+
+static int HexValue(char c)
+{
+    return ((c >= '0') && (c <= '9')) ? (c - '0') :
+        ((c >= 'a') && (c <= 'f')) ? (c - 'a' + 10) :
+        ((c >= 'A') && (c <= 'F')) ? (c - 'A' + 10) :
+        -1;
+}
+
+int ModelCodec_ReadString(MODEL_CODEC_READER* reader, char** destination)
+{
+    int result;
+    const char* chars;
+    size_t length;
+
+    if (SkipString(reader, &chars, &length) != 0)
+    {
+        LogError("the value is not a string");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*the unescaped string is never longer than the escaped one*/
+        char* value = (char*)malloc(length + 1);
+        if (value == NULL)
+        {
+            LogError("unable to malloc");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t i = 0;
+            size_t pos = 0;
+            result = 0;
+            /*Codes_SRS_MODELCODEC_41_027: [ ModelCodec_ReadString shall read a JSON string with its escapes, and fail for any other value or for a \u escape of a character that is not ASCII. ]*/
+            while ((result == 0) && (i < length))
+            {
+                if (chars[i] != '\\')
+                {
+                    value[pos++] = chars[i++];
+                }
+                else
+                {
+                    i++;
+                    switch (chars[i])
+                    {
+                    case '"': value[pos++] = '"'; i++; break;
+                    case '\\': value[pos++] = '\\'; i++; break;
+                    case '/': value[pos++] = '/'; i++; break;
+                    case 'b': value[pos++] = '\b'; i++; break;
+                    case 'f': value[pos++] = '\f'; i++; break;
+                    case 'n': value[pos++] = '\n'; i++; break;
+                    case 'r': value[pos++] = '\r'; i++; break;
+                    case 't': value[pos++] = '\t'; i++; break;
+                    case 'u':
+                    {
+                        int high = (i + 4 < length) ? HexValue(chars[i + 3]) : -1;
+                        int low = (i + 4 < length) ? HexValue(chars[i + 4]) : -1;
+                        if ((i + 4 >= length) || (chars[i + 1] != '0') || (chars[i + 2] != '0') || (high < 0) || (high > 7) || (low < 0))
+                        {
+                            result = __FAILURE__;
+                        }
+                        else
+                        {
+                            value[pos++] = (char)(high * 16 + low);
+                            i += 5;
+                        }
+                        break;
+                    }
+                    default:
+                        result = __FAILURE__;
+                        break;
+                    }
+                }
+            }
+
+            if (result != 0)
+            {
+                LogError("invalid escape in a JSON string");
+                free(value);
+            }
+            else
+            {
+                /*Codes_SRS_MODELCODEC_41_028: [ ModelCodec_ReadString shall free the previous string of destination and set it to the string read. ]*/
+                value[pos] = '\0';
+                if (*destination != NULL)
+                {
+                    free(*destination);
+                }
+                *destination = value;
+            }
+        }
+    }
+
+    return result;
+}
+
+size_t ModelCodec_GetArrayMaxLength(AGENT_DATA_TYPE_TYPE elementType, size_t length)
+{
+    size_t valueLength;
+
+#ifndef NO_FLOATS
+    if ((elementType == EDM_SINGLE_TYPE) || (elementType == EDM_DOUBLE_TYPE))
+    {
+        valueLength = MODEL_CODEC_MAX_DOUBLE_LENGTH;
+    }
+    else
+#endif
+    if (elementType == EDM_BOOLEAN_TYPE)
+    {
+        valueLength = 5;
+    }
+    else
+    {
+        valueLength = MODEL_CODEC_MAX_INTEGER_LENGTH;
+    }
+
+    /*Codes_SRS_MODELCODEC_41_029: [ ModelCodec_GetArrayMaxLength shall return the length of the brackets and of length values of elementType with the ", " separating them. ]*/
+    return 2 + length * (valueLength + 2);
+}
+
+/*the loops are one per type of element, so that the element conversion is known to the compiler*/
+#define MODEL_CODEC_WRITE_ELEMENTS(elementCType, writeElement) \
+    for (i = 0; (i < length) && (elementLength >= 0); i++) \
+    { \
+        if (i > 0) \
+        { \
+            destination[pos++] = ','; \
+            destination[pos++] = ' '; \
+        } \
+        if ((elementLength = writeElement(destination + pos, ((const elementCType*)values)[i])) >= 0) \
+        { \
+            pos += elementLength; \
+        } \
+    }
+
+#define MODEL_CODEC_WRITE_INTEGER_ELEMENT(destination, value) ModelCodec_WriteInt64(destination, (int64_t)(value))
+
+int ModelCodec_WriteArray(char* destination, AGENT_DATA_TYPE_TYPE elementType, size_t elementSize, const void* values, size_t length)
+{
+    int result;
+
+    if ((values == NULL) && (length > 0))
+    {
+        /*Codes_SRS_MODELCODEC_41_030: [ If values is NULL while length is not 0, or elementType and elementSize are not those of an EDM_ARRAY, ModelCodec_WriteArray shall fail and return a negative number. ]*/
+        LogError("invalid argument values=NULL, length=%lu", (unsigned long)length);
+        result = -1;
+    }
+    else
+    {
+        size_t i;
+        int pos = 0;
+        int elementLength = 0;
+
+        destination[pos++] = '[';
+        /*Codes_SRS_MODELCODEC_41_031: [ ModelCodec_WriteArray shall write the values between brackets, separated by ", ", each as the writer of its type writes it. ]*/
+        switch (elementType)
+        {
+            case EDM_BOOLEAN_TYPE:
+                if (elementSize == sizeof(bool))
+                {
+                    MODEL_CODEC_WRITE_ELEMENTS(bool, ModelCodec_WriteBool);
+                }
+                else
+                {
+                    elementLength = -1;
+                }
+                break;
+            case EDM_BYTE_TYPE:
+                if (elementSize == sizeof(uint8_t))
+                {
+                    MODEL_CODEC_WRITE_ELEMENTS(uint8_t, MODEL_CODEC_WRITE_INTEGER_ELEMENT);
+                }
+                else
+                {
+                    elementLength = -1;
+                }
+                break;
+            case EDM_SBYTE_TYPE:
+            case EDM_INT16_TYPE:
+            case EDM_INT32_TYPE:
+            case EDM_INT64_TYPE:
+                if (elementSize == sizeof(int8_t))
+                {
+                    MODEL_CODEC_WRITE_ELEMENTS(int8_t, MODEL_CODEC_WRITE_INTEGER_ELEMENT);
+                }
+                else if (elementSize == sizeof(int16_t))
+                {
+                    MODEL_CODEC_WRITE_ELEMENTS(int16_t, MODEL_CODEC_WRITE_INTEGER_ELEMENT);
+                }
+                else if (elementSize == sizeof(int32_t))
+                {
+                    MODEL_CODEC_WRITE_ELEMENTS(int32_t, MODEL_CODEC_WRITE_INTEGER_ELEMENT);
+                }
+                else if (elementSize == sizeof(int64_t))
+                {
+                    MODEL_CODEC_WRITE_ELEMENTS(int64_t, MODEL_CODEC_WRITE_INTEGER_ELEMENT);
+                }
+                else
+                {
+                    elementLength = -1;
+                }
+                break;
+#ifndef NO_FLOATS
+            case EDM_SINGLE_TYPE:
+                if (elementSize == sizeof(float))
+                {
+                    MODEL_CODEC_WRITE_ELEMENTS(float, ModelCodec_WriteFloat);
+                }
+                else
+                {
+                    elementLength = -1;
+                }
+                break;
+            case EDM_DOUBLE_TYPE:
+                if (elementSize == sizeof(double))
+                {
+                    MODEL_CODEC_WRITE_ELEMENTS(double, ModelCodec_WriteDouble);
+                }
+                else
+                {
+                    elementLength = -1;
+                }
+                break;
+#endif
+            default:
+                elementLength = -1;
+                break;
+        }
+
+        if (elementLength < 0)
+        {
+            LogError("unable to write an array of elementType=%d, elementSize=%lu", (int)elementType, (unsigned long)elementSize);
+            result = -1;
+        }
+        else
+        {
+            destination[pos++] = ']';
+            result = pos;
+        }
+    }
+
+    return result;
+}
+
+static int ReadArrayElement(MODEL_CODEC_READER* reader, AGENT_DATA_TYPE_TYPE elementType, size_t elementSize, void* element)
+{
+    int result;
+
+    switch (elementType)
+    {
+        case EDM_BOOLEAN_TYPE:
+            result = (elementSize != sizeof(bool)) ? __FAILURE__ : ModelCodec_ReadBool(reader, (bool*)element);
+            break;
+        case EDM_BYTE_TYPE:
+            result = (elementSize != sizeof(uint8_t)) ? __FAILURE__ : ModelCodec_ReadUInt8(reader, (uint8_t*)element);
+            break;
+        case EDM_SBYTE_TYPE:
+        case EDM_INT16_TYPE:
+        case EDM_INT32_TYPE:
+        case EDM_INT64_TYPE:
+            if (elementSize == sizeof(int8_t))
+            {
+                result = ModelCodec_ReadInt8(reader, (int8_t*)element);
+            }
+            else if (elementSize == sizeof(int16_t))
+            {
+                result = ModelCodec_ReadInt16(reader, (int16_t*)element);
+            }
+            else if (elementSize == sizeof(int32_t))
+            {
+                result = ModelCodec_ReadInt32(reader, (int32_t*)element);
+            }
+            else if (elementSize == sizeof(int64_t))
+            {
+                result = ModelCodec_ReadInt64(reader, (int64_t*)element);
+            }
+            else
+            {
+                result = __FAILURE__;
+            }
+            break;
+#ifndef NO_FLOATS
+        case EDM_SINGLE_TYPE:
+            result = (elementSize != sizeof(float)) ? __FAILURE__ : ModelCodec_ReadFloat(reader, (float*)element);
+            break;
+        case EDM_DOUBLE_TYPE:
+            result = (elementSize != sizeof(double)) ? __FAILURE__ : ModelCodec_ReadDouble(reader, (double*)element);
+            break;
+#endif
+        default:
+            result = __FAILURE__;
+            break;
+    }
+
+    return result;
+}
+
+int ModelCodec_ReadArray(MODEL_CODEC_READER* reader, AGENT_DATA_TYPE_TYPE elementType, size_t elementSize, void* values, size_t* length, size_t capacity)
+{
+    int result;
+    size_t count = 0;
+
+    if (*reader->position != '[')
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        reader->position++;
+        SkipWhitespace(reader);
+        result = 0;
+        /*Codes_SRS_MODELCODEC_41_032: [ ModelCodec_ReadArray shall read the values of a JSON array straight into values, each as the reader of its type reads it, and set length to their count. ]*/
+        while ((result == 0) && (*reader->position != ']'))
+        {
+            if ((count > 0) && (*reader->position++ != ','))
+            {
+                result = __FAILURE__;
+            }
+            else if (count == capacity)
+            {
+                /*Codes_SRS_MODELCODEC_41_033: [ If the value is not a JSON array, it has more than capacity values or one of them is not of elementType, ModelCodec_ReadArray shall set length to 0 and return a non-zero value. ]*/
+                result = __FAILURE__;
+            }
+            else
+            {
+                SkipWhitespace(reader);
+                if (ReadArrayElement(reader, elementType, elementSize, (unsigned char*)values + count * elementSize) != 0)
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    count++;
+                    SkipWhitespace(reader);
+                }
+            }
+        }
+
+        if (result == 0)
+        {
+            reader->position++;
+        }
+    }
+
+    if (result != 0)
+    {
+        LogError("the value is not an array of at most %lu values of elementType=%d", (unsigned long)capacity, (int)elementType);
+        *length = 0;
+    }
+    else
+    {
+        *length = count;
+    }
+
+    return result;
+}
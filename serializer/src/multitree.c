@@ -10,9 +10,17 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/macro_utils.h"
 
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
 /*assume a name cannot be longer than 100 characters*/
 #define INNER_NODE_NAME_SIZE 128
 
+/*nodes with at least this many children keep an index of their children sorted by name*/
+#define CHILD_INDEX_THRESHOLD 8
+
 DEFINE_ENUM_STRINGS(MULTITREE_RESULT, MULTITREE_RESULT_VALUES);
 
 typedef struct MULTITREE_HANDLE_DATA_TAG
@@ -23,6 +31,7 @@ typedef struct MULTITREE_HANDLE_DATA_TAG
     MULTITREE_FREE_FUNCTION freeFunction;
     size_t nChildren;
     struct MULTITREE_HANDLE_DATA_TAG** children; /*an array of nChildren count of MULTITREE_HANDLE_DATA*   */
+    size_t* childIndex; /*NULL or an array of nChildren positions in children, ordered by the name of the child*/
 }MULTITREE_HANDLE_DATA;
 
 
@@ -51,6 +60,7 @@ MULTITREE_HANDLE MultiTree_Create(MULTITREE_CLONE_FUNCTION cloneFunction, MULTIT
             result->freeFunction = freeFunction;
             result->nChildren = 0;
             result->children = NULL;
+            result->childIndex = NULL;
         }
         else
         {
@@ -62,18 +72,104 @@ MULTITREE_HANDLE MultiTree_Create(MULTITREE_CLONE_FUNCTION cloneFunction, MULTIT
 }
 
 
+/*returns the first position in childIndex whose child name is not less than "name"*/
+/*only considers the first "count" positions of childIndex*/
+static size_t lowerBoundInChildIndex(const MULTITREE_HANDLE_DATA* node, size_t count, const char* name)
+{
+    size_t low = 0;
+    size_t high = count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (strcmp(node->children[node->childIndex[middle]]->name, name) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/*places the last child of the node in the (already allocated) childIndex, considering the first "count" positions are sorted*/
+static void insertInChildIndex(MULTITREE_HANDLE_DATA* node, size_t count, size_t childPosition)
+{
+    size_t where = lowerBoundInChildIndex(node, count, node->children[childPosition]->name);
+    (void)memmove(node->childIndex + where + 1, node->childIndex + where, (count - where) * sizeof(size_t));
+    node->childIndex[where] = childPosition;
+}
+
+/*called after a new child has been appended to children*/
+/*an index that cannot be grown is dropped, lookups then fall back to the linear scan*/
+static void updateChildIndex(MULTITREE_HANDLE_DATA* node)
+{
+    if (node->childIndex != NULL)
+    {
+        /*Codes_SRS_MULTITREE_41_002: [ Children added to a node that already has an index shall be inserted in the index. ]*/
+        size_t* newChildIndex = (size_t*)realloc(node->childIndex, node->nChildren * sizeof(size_t));
+        if (newChildIndex == NULL)
+        {
+            /*Codes_SRS_MULTITREE_41_003: [ If the index cannot be allocated or grown, the node shall drop the index and look up its children by a linear scan. ]*/
+            LogError("unable to grow the children index, falling back to a linear scan");
+            free(node->childIndex);
+            node->childIndex = NULL;
+        }
+        else
+        {
+            node->childIndex = newChildIndex;
+            insertInChildIndex(node, node->nChildren - 1, node->nChildren - 1);
+        }
+    }
+    else if (node->nChildren >= CHILD_INDEX_THRESHOLD)
+    {
+        /*Codes_SRS_MULTITREE_41_001: [ When a node reaches CHILD_INDEX_THRESHOLD children, it shall build an index of its children sorted by name and use it to look up children by name. ]*/
+        node->childIndex = (size_t*)malloc(node->nChildren * sizeof(size_t));
+        if (node->childIndex == NULL)
+        {
+            /*Codes_SRS_MULTITREE_41_003: [ If the index cannot be allocated or grown, the node shall drop the index and look up its children by a linear scan. ]*/
+            LogError("unable to allocate the children index, falling back to a linear scan");
+        }
+        else
+        {
+            size_t i;
+            for (i = 0; i < node->nChildren; i++)
+            {
+                insertInChildIndex(node, i, i);
+            }
+        }
+    }
+    else
+    {
+        /*small nodes are scanned linearly*/
+    }
+}
+
 /*return NULL if a child with the name "name" doesn't exists*/
 /*returns a pointer to the existing child (if any)*/
 static MULTITREE_HANDLE_DATA* getChildByName(MULTITREE_HANDLE_DATA* node, const char* name)
 {
     MULTITREE_HANDLE_DATA* result = NULL;
-    size_t i;
-    for (i = 0; i < node->nChildren; i++)
+    if (node->childIndex != NULL)
     {
-        if (strcmp(node->children[i]->name, name) == 0)
+        size_t where = lowerBoundInChildIndex(node, node->nChildren, name);
+        if ((where < node->nChildren) &&
+            (strcmp(node->children[node->childIndex[where]]->name, name) == 0))
         {
-            result = node->children[i];
-            break;
+            result = node->children[node->childIndex[where]];
+        }
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < node->nChildren; i++)
+        {
+            if (strcmp(node->children[i]->name, name) == 0)
+            {
+                result = node->children[i];
+                break;
+            }
         }
     }
     return result;
@@ -131,6 +227,7 @@ static CREATELEAF_RESULT createLeaf(MULTITREE_HANDLE_DATA* node, const char*name
         {
             newNode->nChildren = 0;
             newNode->children = NULL;
+            newNode->childIndex = NULL;
             if (mallocAndStrcpy_s(&(newNode->name), name) != 0)
             {
                 /*not nice*/
@@ -184,6 +281,8 @@ static CREATELEAF_RESULT createLeaf(MULTITREE_HANDLE_DATA* node, const char*name
                     node->children = newChildren;
                     node->children[node->nChildren] = newNode;
                     node->nChildren++;
+                    /*Codes_SRS_MULTITREE_41_004: [ The order of the children as seen by MultiTree_GetChild shall remain the order in which they were added. ]*/
+                    updateChildIndex(node);
                     if (childNode != NULL)
                     {
                         *childNode = newNode;
@@ -294,7 +393,8 @@ MULTITREE_RESULT MultiTree_AddLeaf(MULTITREE_HANDLE treeHandle, const char* dest
                 {
                     /*Codes_SRS_MULTITREE_99_022:[ If a child along the path does not exist, it shall be created.] */
                     /*Codes_SRS_MULTITREE_99_023:[ The newly created children along the path shall have a NULL value by default.]*/
-                    CREATELEAF_RESULT res = createLeaf(node, firstInnerNodeName, NULL, NULL);
+                    MULTITREE_HANDLE_DATA *createdChild;
+                    CREATELEAF_RESULT res = createLeaf(node, firstInnerNodeName, NULL, &createdChild);
                     switch (res)
                     {
                         default:
@@ -312,7 +412,6 @@ MULTITREE_RESULT MultiTree_AddLeaf(MULTITREE_HANDLE treeHandle, const char* dest
                         }
                         case(CREATELEAF_OK):
                         {
-                            MULTITREE_HANDLE_DATA *createdChild = getChildByName(node, firstInnerNodeName);
                             result = MultiTree_AddLeaf(createdChild, whereIsDelimiter, value);
                             break;
                         }
@@ -499,18 +598,9 @@ MULTITREE_RESULT MultiTree_GetChildByName(MULTITREE_HANDLE treeHandle, const cha
     }
     else
     {
-        MULTITREE_HANDLE_DATA * node = (MULTITREE_HANDLE_DATA *)treeHandle;
-        size_t i;
+        MULTITREE_HANDLE_DATA * child = getChildByName((MULTITREE_HANDLE_DATA *)treeHandle, childName);
 
-        for (i = 0; i < node->nChildren; i++)
-        {
-            if (strcmp(node->children[i]->name, childName) == 0)
-            {
-                break;
-            }
-        }
-
-        if (i == node->nChildren)
+        if (child == NULL)
         {
             /* Codes_SRS_MULTITREE_99_068:[ If the specified child is not found, MultiTree_GetChildByName shall return MULTITREE_CHILD_NOT_FOUND.] */
             result = MULTITREE_CHILD_NOT_FOUND;
@@ -519,7 +609,7 @@ MULTITREE_RESULT MultiTree_GetChildByName(MULTITREE_HANDLE treeHandle, const cha
         else
         {
             /* Codes_SRS_MULTITREE_99_067:[ The child node handle shall be returned in the childHandle argument.] */
-            *childHandle = node->children[i];
+            *childHandle = child;
 
             /* Codes_SRS_MULTITREE_99_064:[ On success, MultiTree_GetChildByName shall return MULTITREE_OK.] */
             result = MULTITREE_OK;
@@ -619,6 +709,13 @@ void MultiTree_Destroy(MULTITREE_HANDLE treeHandle)
             node->children = NULL;
         }
 
+        /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
+        if (node->childIndex != NULL)
+        {
+            free(node->childIndex);
+            node->childIndex = NULL;
+        }
+
         /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
         if (node->name != NULL)
         {
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include "schema.h"
@@ -9,9 +10,29 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
 
 DEFINE_ENUM_STRINGS(SCHEMA_RESULT, SCHEMA_RESULT_VALUES);
 
+/*collections with fewer elements than this are not indexed, a linear scan is just as fast*/
+#define SCHEMA_NAME_INDEX_THRESHOLD 8
+
+/*returns the name of the element at position in a collection (an array of handles or a VECTOR_HANDLE)*/
+typedef const char*(*SCHEMA_ELEMENT_NAME_FUNCTION)(const void* elements, size_t position);
+
+/*an open addressing hash index from element names to positions in their collection*/
+/*it is built by Schema_BuildLookupIndexes and not updated afterwards, it is ignored once the collection changes size*/
+typedef struct SCHEMA_NAME_INDEX_TAG
+{
+    size_t* buckets; /*position + 1 of an element, 0 marks an empty bucket. NULL when there is no index*/
+    size_t bucketMask; /*the bucket count is a power of 2, this is bucket count - 1*/
+    size_t elementCount; /*the number of elements in the collection when the index was built*/
+} SCHEMA_NAME_INDEX;
+
 typedef struct SCHEMA_PROPERTY_HANDLE_DATA_TAG
 {
     const char* PropertyName;
@@ -68,6 +89,13 @@ typedef struct MODEL_IN_MODEL_TAG
     SCHEMA_MODEL_TYPE_HANDLE modelHandle;
 } MODEL_IN_MODEL;
 
+/*a copy of the serialized command metadata of a model, so that it is not rebuilt every time it is asked for*/
+typedef struct SCHEMA_COMMAND_METADATA_CACHE_TAG
+{
+    unsigned char* bytes; /*NULL when nothing is cached*/
+    size_t size;
+} SCHEMA_COMMAND_METADATA_CACHE;
+
 typedef struct SCHEMA_MODEL_TYPE_HANDLE_DATA_TAG
 {
     VECTOR_HANDLE methods; /*holds SCHEMA_METHOD_HANDLE*/
@@ -81,6 +109,13 @@ typedef struct SCHEMA_MODEL_TYPE_HANDLE_DATA_TAG
     size_t ActionCount;
     VECTOR_HANDLE models;
     size_t DeviceCount;
+    SCHEMA_NAME_INDEX propertyIndex;
+    SCHEMA_NAME_INDEX reportedPropertyIndex;
+    SCHEMA_NAME_INDEX desiredPropertyIndex;
+    SCHEMA_NAME_INDEX actionIndex;
+    SCHEMA_NAME_INDEX methodIndex;
+    SCHEMA_NAME_INDEX modelInModelIndex;
+    SCHEMA_COMMAND_METADATA_CACHE commandMetadata[2]; /*indexed by "compact": [0] is the JSON text, [1] the compact form*/
 } SCHEMA_MODEL_TYPE_HANDLE_DATA;
 
 typedef struct SCHEMA_STRUCT_TYPE_HANDLE_DATA_TAG
@@ -88,6 +123,7 @@ typedef struct SCHEMA_STRUCT_TYPE_HANDLE_DATA_TAG
     const char* Name;
     SCHEMA_PROPERTY_HANDLE* Properties;
     size_t PropertyCount;
+    SCHEMA_NAME_INDEX propertyIndex;
 } SCHEMA_STRUCT_TYPE_HANDLE_DATA;
 
 typedef struct SCHEMA_HANDLE_DATA_TAG
@@ -98,10 +134,179 @@ typedef struct SCHEMA_HANDLE_DATA_TAG
     size_t ModelTypeCount;
     SCHEMA_STRUCT_TYPE_HANDLE* StructTypes;
     size_t StructTypeCount;
+    SCHEMA_NAME_INDEX modelTypeIndex;
+    SCHEMA_NAME_INDEX structTypeIndex;
 } SCHEMA_HANDLE_DATA;
 
 static VECTOR_HANDLE g_schemas = NULL;
 
+static void NameIndex_Init(SCHEMA_NAME_INDEX* index)
+{
+    index->buckets = NULL;
+    index->bucketMask = 0;
+    index->elementCount = 0;
+}
+
+static void NameIndex_Deinit(SCHEMA_NAME_INDEX* index)
+{
+    free(index->buckets);
+    NameIndex_Init(index);
+}
+
+/*FNV-1a*/
+static size_t NameIndex_Hash(const char* name)
+{
+    size_t result = (size_t)2166136261u;
+    while (*name != '\0')
+    {
+        result ^= (unsigned char)*name;
+        result *= (size_t)16777619u;
+        name++;
+    }
+    return result;
+}
+
+/*returns 0 when the index has been built or when the collection is too small to need one*/
+static int NameIndex_Build(SCHEMA_NAME_INDEX* index, const void* elements, size_t elementCount, SCHEMA_ELEMENT_NAME_FUNCTION getName)
+{
+    int result;
+    NameIndex_Deinit(index);
+    if (elementCount < SCHEMA_NAME_INDEX_THRESHOLD)
+    {
+        result = 0;
+    }
+    else
+    {
+        /*keep the load factor at or below 1/2*/
+        size_t bucketCount = SCHEMA_NAME_INDEX_THRESHOLD;
+        while (bucketCount < 2 * elementCount)
+        {
+            bucketCount *= 2;
+        }
+
+        if ((index->buckets = (size_t*)malloc(bucketCount * sizeof(size_t))) == NULL)
+        {
+            LogError("unable to allocate a name index of %lu buckets", (unsigned long)bucketCount);
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t i;
+            (void)memset(index->buckets, 0, bucketCount * sizeof(size_t));
+            index->bucketMask = bucketCount - 1;
+            index->elementCount = elementCount;
+            for (i = 0; i < elementCount; i++)
+            {
+                const char* name = getName(elements, i);
+                size_t bucket = NameIndex_Hash(name) & index->bucketMask;
+                while (index->buckets[bucket] != 0)
+                {
+                    bucket = (bucket + 1) & index->bucketMask;
+                }
+                index->buckets[bucket] = i + 1;
+            }
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*returns true when the index answered the lookup. In that case *position is the position of the element named name,*/
+/*or elementCount when there is no such element. Returns false when there is no up to date index, the caller shall scan the collection*/
+static bool NameIndex_Lookup(const SCHEMA_NAME_INDEX* index, const void* elements, size_t elementCount, SCHEMA_ELEMENT_NAME_FUNCTION getName, const char* name, size_t* position)
+{
+    bool result;
+    if ((index->buckets == NULL) ||
+        (index->elementCount != elementCount))
+    {
+        result = false;
+    }
+    else
+    {
+        size_t bucket = NameIndex_Hash(name) & index->bucketMask;
+        *position = elementCount;
+        while (index->buckets[bucket] != 0)
+        {
+            if (strcmp(getName(elements, index->buckets[bucket] - 1), name) == 0)
+            {
+                *position = index->buckets[bucket] - 1;
+                break;
+            }
+            bucket = (bucket + 1) & index->bucketMask;
+        }
+        result = true;
+    }
+    return result;
+}
+
+/*same as VECTOR_find_if(vector, match, name), but uses the index when there is one for the vector*/
+static void* NameIndex_FindInVector(const SCHEMA_NAME_INDEX* index, VECTOR_HANDLE vector, SCHEMA_ELEMENT_NAME_FUNCTION getName, PREDICATE_FUNCTION match, const char* name)
+{
+    void* result;
+    size_t position;
+    if (index->buckets == NULL)
+    {
+        result = VECTOR_find_if(vector, match, name);
+    }
+    else
+    {
+        size_t elementCount = VECTOR_size(vector);
+        if (!NameIndex_Lookup(index, vector, elementCount, getName, name, &position))
+        {
+            result = VECTOR_find_if(vector, match, name);
+        }
+        else if (position == elementCount)
+        {
+            result = NULL;
+        }
+        else
+        {
+            result = VECTOR_element(vector, position);
+        }
+    }
+    return result;
+}
+
+static const char* PropertyArrayName(const void* elements, size_t position)
+{
+    return ((const SCHEMA_PROPERTY_HANDLE_DATA*)((const SCHEMA_PROPERTY_HANDLE*)elements)[position])->PropertyName;
+}
+
+static const char* ActionArrayName(const void* elements, size_t position)
+{
+    return ((const SCHEMA_ACTION_HANDLE_DATA*)((const SCHEMA_ACTION_HANDLE*)elements)[position])->ActionName;
+}
+
+static const char* ModelTypeArrayName(const void* elements, size_t position)
+{
+    return ((const SCHEMA_MODEL_TYPE_HANDLE_DATA*)((const SCHEMA_MODEL_TYPE_HANDLE*)elements)[position])->Name;
+}
+
+static const char* StructTypeArrayName(const void* elements, size_t position)
+{
+    return ((const SCHEMA_STRUCT_TYPE_HANDLE_DATA*)((const SCHEMA_STRUCT_TYPE_HANDLE*)elements)[position])->Name;
+}
+
+static const char* ReportedPropertyVectorName(const void* elements, size_t position)
+{
+    return (*(SCHEMA_REPORTED_PROPERTY_HANDLE_DATA**)VECTOR_element((VECTOR_HANDLE)elements, position))->reportedPropertyName;
+}
+
+static const char* DesiredPropertyVectorName(const void* elements, size_t position)
+{
+    return (*(SCHEMA_DESIRED_PROPERTY_HANDLE_DATA**)VECTOR_element((VECTOR_HANDLE)elements, position))->desiredPropertyName;
+}
+
+static const char* MethodVectorName(const void* elements, size_t position)
+{
+    return (*(SCHEMA_METHOD_HANDLE_DATA**)VECTOR_element((VECTOR_HANDLE)elements, position))->methodName;
+}
+
+static const char* ModelInModelVectorName(const void* elements, size_t position)
+{
+    return ((MODEL_IN_MODEL*)VECTOR_element((VECTOR_HANDLE)elements, position))->propertyName;
+}
+
 static void DestroyProperty(SCHEMA_PROPERTY_HANDLE propertyHandle)
 {
     SCHEMA_PROPERTY_HANDLE_DATA* propertyType = (SCHEMA_PROPERTY_HANDLE_DATA*)propertyHandle;
@@ -184,6 +389,7 @@ static void DestroyStruct(SCHEMA_STRUCT_TYPE_HANDLE structTypeHandle)
             DestroyProperty(structType->Properties[i]);
         }
         free(structType->Properties);
+        NameIndex_Deinit(&structType->propertyIndex);
 
         free((void*)structType->Name);
 
@@ -191,6 +397,20 @@ static void DestroyStruct(SCHEMA_STRUCT_TYPE_HANDLE structTypeHandle)
     }
 }
 
+static void ClearCommandMetadataCache(SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType)
+{
+    size_t i;
+    for (i = 0; i < sizeof(modelType->commandMetadata) / sizeof(modelType->commandMetadata[0]); i++)
+    {
+        if (modelType->commandMetadata[i].bytes != NULL)
+        {
+            free(modelType->commandMetadata[i].bytes);
+            modelType->commandMetadata[i].bytes = NULL;
+            modelType->commandMetadata[i].size = 0;
+        }
+    }
+}
+
 static void DestroyModel(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle)
 {
     SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
@@ -244,6 +464,14 @@ static void DestroyModel(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle)
     VECTOR_destroy(modelType->models);
 
     free(modelType->Actions);
+
+    NameIndex_Deinit(&modelType->propertyIndex);
+    NameIndex_Deinit(&modelType->reportedPropertyIndex);
+    NameIndex_Deinit(&modelType->desiredPropertyIndex);
+    NameIndex_Deinit(&modelType->actionIndex);
+    NameIndex_Deinit(&modelType->methodIndex);
+    NameIndex_Deinit(&modelType->modelInModelIndex);
+    ClearCommandMetadataCache(modelType);
     free(modelType);
 }
 
@@ -407,6 +635,8 @@ SCHEMA_HANDLE Schema_Create(const char* schemaNamespace, void* metadata)
             result->StructTypes = NULL;
             result->StructTypeCount = 0;
             result->metadata = metadata;
+            NameIndex_Init(&result->modelTypeIndex);
+            NameIndex_Init(&result->structTypeIndex);
         }
     }
 
@@ -481,6 +711,8 @@ void Schema_Destroy(SCHEMA_HANDLE schemaHandle)
         }
 
         free(schema->StructTypes);
+        NameIndex_Deinit(&schema->modelTypeIndex);
+        NameIndex_Deinit(&schema->structTypeIndex);
         free((void*)schema->Namespace);
         free(schema);
 
@@ -705,6 +937,16 @@ SCHEMA_MODEL_TYPE_HANDLE Schema_CreateModelType(SCHEMA_HANDLE schemaHandle, cons
                                     modelType->Actions = NULL;
                                     modelType->SchemaHandle = schemaHandle;
                                     modelType->DeviceCount = 0;
+                                    NameIndex_Init(&modelType->propertyIndex);
+                                    NameIndex_Init(&modelType->reportedPropertyIndex);
+                                    NameIndex_Init(&modelType->desiredPropertyIndex);
+                                    NameIndex_Init(&modelType->actionIndex);
+                                    NameIndex_Init(&modelType->methodIndex);
+                                    NameIndex_Init(&modelType->modelInModelIndex);
+                                    modelType->commandMetadata[0].bytes = NULL;
+                                    modelType->commandMetadata[0].size = 0;
+                                    modelType->commandMetadata[1].bytes = NULL;
+                                    modelType->commandMetadata[1].size = 0;
 
                                     schema->ModelTypes[schema->ModelTypeCount] = modelType;
                                     schema->ModelTypeCount++;
@@ -912,6 +1154,8 @@ SCHEMA_ACTION_HANDLE Schema_CreateModelAction(SCHEMA_MODEL_TYPE_HANDLE modelType
 
                         modelType->Actions[modelType->ActionCount] = newAction;
                         modelType->ActionCount++;
+                        /*Codes_SRS_SCHEMA_41_009: [ Schema_CreateModelAction shall discard the cached command metadata of the model. ]*/
+                        ClearCommandMetadataCache(modelType);
                         result = (SCHEMA_ACTION_HANDLE)(newAction);
                     }
 
@@ -1223,12 +1467,16 @@ SCHEMA_PROPERTY_HANDLE Schema_GetModelPropertyByName(SCHEMA_MODEL_TYPE_HANDLE mo
         SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
 
         /* Codes_SRS_SCHEMA_99_036:[Schema_GetModelPropertyByName shall return a non-NULL SCHEMA_PROPERTY_HANDLE corresponding to the model type identified by modelTypeHandle and matching the propertyName argument value.] */
-        for (i = 0; i < modelType->PropertyCount; i++)
+        /* Codes_SRS_SCHEMA_41_002: [ Lookups by name shall use the index built by Schema_BuildLookupIndexes while the indexed collection has not changed size, otherwise they shall scan the collection. ]*/
+        if (!NameIndex_Lookup(&modelType->propertyIndex, modelType->Properties, modelType->PropertyCount, PropertyArrayName, propertyName, &i))
         {
-            SCHEMA_PROPERTY_HANDLE_DATA* modelProperty = (SCHEMA_PROPERTY_HANDLE_DATA*)modelType->Properties[i];
-            if (strcmp(modelProperty->PropertyName, propertyName) == 0)
+            for (i = 0; i < modelType->PropertyCount; i++)
             {
-                break;
+                SCHEMA_PROPERTY_HANDLE_DATA* modelProperty = (SCHEMA_PROPERTY_HANDLE_DATA*)modelType->Properties[i];
+                if (strcmp(modelProperty->PropertyName, propertyName) == 0)
+                {
+                    break;
+                }
             }
         }
 
@@ -1313,7 +1561,7 @@ SCHEMA_REPORTED_PROPERTY_HANDLE Schema_GetModelReportedPropertyByName(SCHEMA_MOD
         SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
         /*Codes_SRS_SCHEMA_02_013: [ If reported property by the name reportedPropertyName exists then Schema_GetModelReportedPropertyByName shall succeed and return a non-NULL value. ]*/
         /*Codes_SRS_SCHEMA_02_014: [ Otherwise Schema_GetModelReportedPropertyByName shall fail and return NULL. ]*/
-        if((result = VECTOR_find_if(modelType->reportedProperties, reportedPropertyExists, reportedPropertyName))==NULL)
+        if((result = NameIndex_FindInVector(&modelType->reportedPropertyIndex, modelType->reportedProperties, ReportedPropertyVectorName, reportedPropertyExists, reportedPropertyName))==NULL)
         {
             LogError("a reported property with name \"%s\" does not exist", reportedPropertyName);
         }
@@ -1391,12 +1639,15 @@ SCHEMA_ACTION_HANDLE Schema_GetModelActionByName(SCHEMA_MODEL_TYPE_HANDLE modelT
         SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
 
         /* Codes_SRS_SCHEMA_99_040:[Schema_GetModelActionByName shall return a non-NULL SCHEMA_ACTION_HANDLE corresponding to the model type identified by modelTypeHandle and matching the actionName argument value.] */
-        for (i = 0; i < modelType->ActionCount; i++)
+        if (!NameIndex_Lookup(&modelType->actionIndex, modelType->Actions, modelType->ActionCount, ActionArrayName, actionName, &i))
         {
-            SCHEMA_ACTION_HANDLE_DATA* modelAction = (SCHEMA_ACTION_HANDLE_DATA*)modelType->Actions[i];
-            if (strcmp(modelAction->ActionName, actionName) == 0)
+            for (i = 0; i < modelType->ActionCount; i++)
             {
-                break;
+                SCHEMA_ACTION_HANDLE_DATA* modelAction = (SCHEMA_ACTION_HANDLE_DATA*)modelType->Actions[i];
+                if (strcmp(modelAction->ActionName, actionName) == 0)
+                {
+                    break;
+                }
             }
         }
 
@@ -1438,7 +1689,7 @@ SCHEMA_METHOD_HANDLE Schema_GetModelMethodByName(SCHEMA_MODEL_TYPE_HANDLE modelT
     else
     {
         /*Codes_SRS_SCHEMA_02_117: [ If a method with the name methodName exists then Schema_GetModelMethodByName shall succeed and returns its handle. ]*/
-        SCHEMA_METHOD_HANDLE* found = VECTOR_find_if(modelTypeHandle->methods, matchModelMethod, methodName);
+        SCHEMA_METHOD_HANDLE* found = NameIndex_FindInVector(&modelTypeHandle->methodIndex, modelTypeHandle->methods, MethodVectorName, matchModelMethod, methodName);
         if (found == NULL)
         {
             /*Codes_SRS_SCHEMA_02_118: [ Otherwise, Schema_GetModelMethodByName shall fail and return NULL. ]*/
@@ -1799,6 +2050,7 @@ SCHEMA_STRUCT_TYPE_HANDLE Schema_CreateStructType(SCHEMA_HANDLE schemaHandle, co
                     schema->StructTypeCount++;
                     structType->PropertyCount = 0;
                     structType->Properties = NULL;
+                    NameIndex_Init(&structType->propertyIndex);
 
                     /* Codes_SRS_SCHEMA_99_058:[On success, a non-NULL handle shall be returned.] */
                     result = (SCHEMA_STRUCT_TYPE_HANDLE)structType;
@@ -1885,12 +2137,15 @@ SCHEMA_STRUCT_TYPE_HANDLE Schema_GetStructTypeByName(SCHEMA_HANDLE schemaHandle,
         size_t i;
 
         /* Codes_SRS_SCHEMA_99_068:[Schema_GetStructTypeByName shall return a non-NULL handle corresponding to the struct type identified by the structTypeName in the schemaHandle schema.] */
-        for (i = 0; i < schema->StructTypeCount; i++)
+        if (!NameIndex_Lookup(&schema->structTypeIndex, schema->StructTypes, schema->StructTypeCount, StructTypeArrayName, name, &i))
         {
-            SCHEMA_STRUCT_TYPE_HANDLE_DATA* structType = (SCHEMA_STRUCT_TYPE_HANDLE_DATA*)schema->StructTypes[i];
-            if (strcmp(structType->Name, name) == 0)
+            for (i = 0; i < schema->StructTypeCount; i++)
             {
-                break;
+                SCHEMA_STRUCT_TYPE_HANDLE_DATA* structType = (SCHEMA_STRUCT_TYPE_HANDLE_DATA*)schema->StructTypes[i];
+                if (strcmp(structType->Name, name) == 0)
+                {
+                    break;
+                }
             }
         }
 
@@ -2045,12 +2300,15 @@ SCHEMA_PROPERTY_HANDLE Schema_GetStructTypePropertyByName(SCHEMA_STRUCT_TYPE_HAN
         size_t i;
         SCHEMA_STRUCT_TYPE_HANDLE_DATA* structType = (SCHEMA_STRUCT_TYPE_HANDLE_DATA*)structTypeHandle;
 
-        for (i = 0; i < structType->PropertyCount; i++)
+        if (!NameIndex_Lookup(&structType->propertyIndex, structType->Properties, structType->PropertyCount, PropertyArrayName, propertyName, &i))
         {
-            SCHEMA_PROPERTY_HANDLE_DATA* modelProperty = (SCHEMA_PROPERTY_HANDLE_DATA*)structType->Properties[i];
-            if (strcmp(modelProperty->PropertyName, propertyName) == 0)
+            for (i = 0; i < structType->PropertyCount; i++)
             {
-                break;
+                SCHEMA_PROPERTY_HANDLE_DATA* modelProperty = (SCHEMA_PROPERTY_HANDLE_DATA*)structType->Properties[i];
+                if (strcmp(modelProperty->PropertyName, propertyName) == 0)
+                {
+                    break;
+                }
             }
         }
 
@@ -2198,12 +2456,15 @@ SCHEMA_MODEL_TYPE_HANDLE Schema_GetModelByName(SCHEMA_HANDLE schemaHandle, const
         /* Codes_SRS_SCHEMA_99_124: [Schema_GetModelByName shall return a non-NULL SCHEMA_MODEL_TYPE_HANDLE corresponding to the model identified by schemaHandle and matching the modelName argument value.] */
         SCHEMA_HANDLE_DATA* schema = (SCHEMA_HANDLE_DATA*)schemaHandle;
         size_t i;
-        for (i = 0; i < schema->ModelTypeCount; i++)
+        if (!NameIndex_Lookup(&schema->modelTypeIndex, schema->ModelTypes, schema->ModelTypeCount, ModelTypeArrayName, modelName, &i))
         {
-            SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)schema->ModelTypes[i];
-            if (strcmp(modelName, modelType->Name)==0)
+            for (i = 0; i < schema->ModelTypeCount; i++)
             {
-                break;
+                SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)schema->ModelTypes[i];
+                if (strcmp(modelName, modelType->Name)==0)
+                {
+                    break;
+                }
             }
         }
         if (i == schema->ModelTypeCount)
@@ -2349,7 +2610,7 @@ SCHEMA_MODEL_TYPE_HANDLE Schema_GetModelModelByName(SCHEMA_MODEL_TYPE_HANDLE mod
         SCHEMA_MODEL_TYPE_HANDLE_DATA* model = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
         /*Codes_SRS_SCHEMA_99_170: [Schema_GetModelModelByName shall return a handle to the model identified by the property with the name propertyName in the model identified by the handle modelTypeHandle.]*/
         /*Codes_SRS_SCHEMA_99_171: [If Schema_GetModelModelByName is unable to provide the handle it shall return NULL.]*/
-        void* temp = VECTOR_find_if(model->models, matchModelName, propertyName);
+        void* temp = NameIndex_FindInVector(&model->modelInModelIndex, model->models, ModelInModelVectorName, matchModelName, propertyName);
         if (temp == NULL)
         {
             LogError("specified propertyName not found (%s)", propertyName);
@@ -2381,7 +2642,7 @@ size_t Schema_GetModelModelByName_Offset(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandl
     {
         SCHEMA_MODEL_TYPE_HANDLE_DATA* model = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
         /*Codes_SRS_SCHEMA_02_056: [ If propertyName is not a model then Schema_GetModelModelByName_Offset shall fail and return 0. ]*/
-        void* temp = VECTOR_find_if(model->models, matchModelName, propertyName);
+        void* temp = NameIndex_FindInVector(&model->modelInModelIndex, model->models, ModelInModelVectorName, matchModelName, propertyName);
         if (temp == NULL)
         {
             LogError("specified propertyName not found (%s)", propertyName);
@@ -2412,7 +2673,7 @@ pfOnDesiredProperty Schema_GetModelModelByName_OnDesiredProperty(SCHEMA_MODEL_TY
     else
     {
         SCHEMA_MODEL_TYPE_HANDLE_DATA* model = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
-        void* temp = VECTOR_find_if(model->models, matchModelName, propertyName);
+        void* temp = NameIndex_FindInVector(&model->modelInModelIndex, model->models, ModelInModelVectorName, matchModelName, propertyName);
         if (temp == NULL)
         {
             LogError("specified propertyName not found (%s)", propertyName);
@@ -2825,7 +3086,7 @@ SCHEMA_DESIRED_PROPERTY_HANDLE Schema_GetModelDesiredPropertyByName(SCHEMA_MODEL
         /*Codes_SRS_SCHEMA_02_036: [ If a desired property having the name desiredPropertyName exists then Schema_GetModelDesiredPropertyByName shall succeed and return a non-NULL value. ]*/
         /*Codes_SRS_SCHEMA_02_037: [ Otherwise, Schema_GetModelDesiredPropertyByName shall fail and return NULL. ]*/
         SCHEMA_MODEL_TYPE_HANDLE_DATA* handleData = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
-        SCHEMA_DESIRED_PROPERTY_HANDLE* temp = VECTOR_find_if(handleData->desiredProperties, desiredPropertyExists, desiredPropertyName);
+        SCHEMA_DESIRED_PROPERTY_HANDLE* temp = NameIndex_FindInVector(&handleData->desiredPropertyIndex, handleData->desiredProperties, DesiredPropertyVectorName, desiredPropertyExists, desiredPropertyName);
         if (temp == NULL)
         {
             LogError("no such desired property by name %s", desiredPropertyName);
@@ -3044,7 +3305,7 @@ SCHEMA_MODEL_ELEMENT Schema_GetModelElementByName(SCHEMA_MODEL_TYPE_HANDLE model
     {
         SCHEMA_MODEL_TYPE_HANDLE_DATA* handleData = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
 
-        SCHEMA_DESIRED_PROPERTY_HANDLE* desiredPropertyHandle = VECTOR_find_if(handleData->desiredProperties, desiredPropertyExists, elementName);
+        SCHEMA_DESIRED_PROPERTY_HANDLE* desiredPropertyHandle = NameIndex_FindInVector(&handleData->desiredPropertyIndex, handleData->desiredProperties, DesiredPropertyVectorName, desiredPropertyExists, elementName);
         if (desiredPropertyHandle != NULL)
         {
             /*Codes_SRS_SCHEMA_02_080: [ If elementName is a desired property then Schema_GetModelElementByName shall succeed and set SCHEMA_MODEL_ELEMENT.elementType to SCHEMA_DESIRED_PROPERTY and SCHEMA_MODEL_ELEMENT.elementHandle.desiredPropertyHandle to the handle of the desired property. ]*/
@@ -3055,16 +3316,23 @@ SCHEMA_MODEL_ELEMENT Schema_GetModelElementByName(SCHEMA_MODEL_TYPE_HANDLE model
         {
             size_t nProcessedProperties = 0;
             SCHEMA_PROPERTY_HANDLE_DATA* property = NULL;
-            for (size_t i = 0; i < handleData->PropertyCount;i++)
+            if (NameIndex_Lookup(&handleData->propertyIndex, handleData->Properties, handleData->PropertyCount, PropertyArrayName, elementName, &nProcessedProperties))
             {
-                property = (SCHEMA_PROPERTY_HANDLE_DATA*)(handleData->Properties[i]);
-                if (strcmp(property->PropertyName, elementName) == 0)
-                {
-                    i = handleData->PropertyCount; /*found it*/
-                }
-                else
+                property = (nProcessedProperties < handleData->PropertyCount) ? (SCHEMA_PROPERTY_HANDLE_DATA*)(handleData->Properties[nProcessedProperties]) : NULL;
+            }
+            else
+            {
+                for (size_t i = 0; i < handleData->PropertyCount;i++)
                 {
-                    nProcessedProperties++;
+                    property = (SCHEMA_PROPERTY_HANDLE_DATA*)(handleData->Properties[i]);
+                    if (strcmp(property->PropertyName, elementName) == 0)
+                    {
+                        i = handleData->PropertyCount; /*found it*/
+                    }
+                    else
+                    {
+                        nProcessedProperties++;
+                    }
                 }
             }
 
@@ -3077,7 +3345,7 @@ SCHEMA_MODEL_ELEMENT Schema_GetModelElementByName(SCHEMA_MODEL_TYPE_HANDLE model
             else
             {
 
-                SCHEMA_REPORTED_PROPERTY_HANDLE* reportedPropertyHandle = VECTOR_find_if(handleData->reportedProperties, reportedPropertyExists, elementName);
+                SCHEMA_REPORTED_PROPERTY_HANDLE* reportedPropertyHandle = NameIndex_FindInVector(&handleData->reportedPropertyIndex, handleData->reportedProperties, ReportedPropertyVectorName, reportedPropertyExists, elementName);
                 if (reportedPropertyHandle != NULL)
                 {
                     /*Codes_SRS_SCHEMA_02_079: [ If elementName is a reported property then Schema_GetModelElementByName shall succeed and set SCHEMA_MODEL_ELEMENT.elementType to SCHEMA_REPORTED_PROPERTY and SCHEMA_MODEL_ELEMENT.elementHandle.reportedPropertyHandle to the handle of the reported property. ]*/
@@ -3089,16 +3357,23 @@ SCHEMA_MODEL_ELEMENT Schema_GetModelElementByName(SCHEMA_MODEL_TYPE_HANDLE model
 
                     size_t nProcessedActions = 0;
                     SCHEMA_ACTION_HANDLE_DATA* actionHandleData = NULL;
-                    for (size_t i = 0;i < handleData->ActionCount; i++)
+                    if (NameIndex_Lookup(&handleData->actionIndex, handleData->Actions, handleData->ActionCount, ActionArrayName, elementName, &nProcessedActions))
                     {
-                        actionHandleData = (SCHEMA_ACTION_HANDLE_DATA*)(handleData->Actions[i]);
-                        if (strcmp(actionHandleData->ActionName, elementName) == 0)
-                        {
-                            i = handleData->ActionCount; /*get out quickly*/
-                        }
-                        else
+                        actionHandleData = (nProcessedActions < handleData->ActionCount) ? (SCHEMA_ACTION_HANDLE_DATA*)(handleData->Actions[nProcessedActions]) : NULL;
+                    }
+                    else
+                    {
+                        for (size_t i = 0;i < handleData->ActionCount; i++)
                         {
-                            nProcessedActions++;
+                            actionHandleData = (SCHEMA_ACTION_HANDLE_DATA*)(handleData->Actions[i]);
+                            if (strcmp(actionHandleData->ActionName, elementName) == 0)
+                            {
+                                i = handleData->ActionCount; /*get out quickly*/
+                            }
+                            else
+                            {
+                                nProcessedActions++;
+                            }
                         }
                     }
 
@@ -3110,7 +3385,7 @@ SCHEMA_MODEL_ELEMENT Schema_GetModelElementByName(SCHEMA_MODEL_TYPE_HANDLE model
                     }
                     else
                     {
-                        MODEL_IN_MODEL* modelInModel = VECTOR_find_if(handleData->models, modelInModelExists, elementName);
+                        MODEL_IN_MODEL* modelInModel = NameIndex_FindInVector(&handleData->modelInModelIndex, handleData->models, ModelInModelVectorName, modelInModelExists, elementName);
                         if (modelInModel != NULL)
                         {
                             /*Codes_SRS_SCHEMA_02_082: [ If elementName is a model in model then Schema_GetModelElementByName shall succeed and set SCHEMA_MODEL_ELEMENT.elementType to SCHEMA_MODEL_IN_MODEL and SCHEMA_MODEL_ELEMENT.elementHandle.modelHandle to the handle of the model. ]*/
@@ -3218,3 +3493,120 @@ void* Schema_GetMetadata(SCHEMA_HANDLE schemaHandle)
     }
     return result;
 }
+
+SCHEMA_RESULT Schema_SetModelCommandMetadataCache(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle, bool compact, const unsigned char* bytes, size_t size)
+{
+    SCHEMA_RESULT result;
+    /*Codes_SRS_SCHEMA_41_006: [ If modelTypeHandle or bytes is NULL, or size is 0, then Schema_SetModelCommandMetadataCache shall fail and return SCHEMA_INVALID_ARG. ]*/
+    if ((modelTypeHandle == NULL) ||
+        (bytes == NULL) ||
+        (size == 0))
+    {
+        LogError("invalid arg SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle=%p, const unsigned char* bytes=%p, size_t size=%lu", modelTypeHandle, bytes, (unsigned long)size);
+        result = SCHEMA_INVALID_ARG;
+    }
+    else
+    {
+        SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
+        SCHEMA_COMMAND_METADATA_CACHE* cache = &modelType->commandMetadata[compact ? 1 : 0];
+        unsigned char* copy = (unsigned char*)malloc(size);
+        if (copy == NULL)
+        {
+            /*Codes_SRS_SCHEMA_41_008: [ If any failure occurs, Schema_SetModelCommandMetadataCache shall fail and return SCHEMA_ERROR, keeping what was cached before. ]*/
+            LogError("unable to malloc");
+            result = SCHEMA_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_SCHEMA_41_007: [ Schema_SetModelCommandMetadataCache shall keep a copy of the size bytes at bytes as the command metadata of the model in the form selected by compact, replacing what was cached before, and return SCHEMA_OK. ]*/
+            (void)memcpy(copy, bytes, size);
+            free(cache->bytes);
+            cache->bytes = copy;
+            cache->size = size;
+            result = SCHEMA_OK;
+        }
+    }
+    return result;
+}
+
+SCHEMA_RESULT Schema_GetModelCommandMetadataCache(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle, bool compact, const unsigned char** bytes, size_t* size)
+{
+    SCHEMA_RESULT result;
+    /*Codes_SRS_SCHEMA_41_010: [ If modelTypeHandle, bytes or size is NULL then Schema_GetModelCommandMetadataCache shall fail and return SCHEMA_INVALID_ARG. ]*/
+    if ((modelTypeHandle == NULL) ||
+        (bytes == NULL) ||
+        (size == NULL))
+    {
+        LogError("invalid arg SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle=%p, const unsigned char** bytes=%p, size_t* size=%p", modelTypeHandle, bytes, size);
+        result = SCHEMA_INVALID_ARG;
+    }
+    else
+    {
+        const SCHEMA_COMMAND_METADATA_CACHE* cache = &((SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle)->commandMetadata[compact ? 1 : 0];
+        if (cache->bytes == NULL)
+        {
+            /*Codes_SRS_SCHEMA_41_011: [ If nothing is cached in the form selected by compact then Schema_GetModelCommandMetadataCache shall return SCHEMA_ELEMENT_NOT_FOUND. ]*/
+            result = SCHEMA_ELEMENT_NOT_FOUND;
+        }
+        else
+        {
+            /*Codes_SRS_SCHEMA_41_012: [ Otherwise Schema_GetModelCommandMetadataCache shall set *bytes and *size to the cached copy, which stays valid until the model is destroyed or an action is added to it, and return SCHEMA_OK. ]*/
+            *bytes = cache->bytes;
+            *size = cache->size;
+            result = SCHEMA_OK;
+        }
+    }
+    return result;
+}
+
+SCHEMA_RESULT Schema_BuildLookupIndexes(SCHEMA_HANDLE schemaHandle)
+{
+    SCHEMA_RESULT result;
+    /*Codes_SRS_SCHEMA_41_001: [ If schemaHandle is NULL then Schema_BuildLookupIndexes shall fail and return SCHEMA_INVALID_ARG. ]*/
+    if (schemaHandle == NULL)
+    {
+        LogError("invalid arg SCHEMA_HANDLE schemaHandle=%p", schemaHandle);
+        result = SCHEMA_INVALID_ARG;
+    }
+    else
+    {
+        SCHEMA_HANDLE_DATA* schema = (SCHEMA_HANDLE_DATA*)schemaHandle;
+        size_t i;
+
+        /*Codes_SRS_SCHEMA_41_003: [ Schema_BuildLookupIndexes shall build a name index for the models and struct types of the schema, and for the properties, reported properties, desired properties, actions, methods and models in model of every model, and for the properties of every struct type, that have at least SCHEMA_NAME_INDEX_THRESHOLD elements. ]*/
+        int failed =
+            NameIndex_Build(&schema->modelTypeIndex, schema->ModelTypes, schema->ModelTypeCount, ModelTypeArrayName) |
+            NameIndex_Build(&schema->structTypeIndex, schema->StructTypes, schema->StructTypeCount, StructTypeArrayName);
+
+        for (i = 0; i < schema->ModelTypeCount; i++)
+        {
+            SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)schema->ModelTypes[i];
+            failed |=
+                NameIndex_Build(&modelType->propertyIndex, modelType->Properties, modelType->PropertyCount, PropertyArrayName) |
+                NameIndex_Build(&modelType->reportedPropertyIndex, modelType->reportedProperties, VECTOR_size(modelType->reportedProperties), ReportedPropertyVectorName) |
+                NameIndex_Build(&modelType->desiredPropertyIndex, modelType->desiredProperties, VECTOR_size(modelType->desiredProperties), DesiredPropertyVectorName) |
+                NameIndex_Build(&modelType->actionIndex, modelType->Actions, modelType->ActionCount, ActionArrayName) |
+                NameIndex_Build(&modelType->methodIndex, modelType->methods, VECTOR_size(modelType->methods), MethodVectorName) |
+                NameIndex_Build(&modelType->modelInModelIndex, modelType->models, VECTOR_size(modelType->models), ModelInModelVectorName);
+        }
+
+        for (i = 0; i < schema->StructTypeCount; i++)
+        {
+            SCHEMA_STRUCT_TYPE_HANDLE_DATA* structType = (SCHEMA_STRUCT_TYPE_HANDLE_DATA*)schema->StructTypes[i];
+            failed |= NameIndex_Build(&structType->propertyIndex, structType->Properties, structType->PropertyCount, PropertyArrayName);
+        }
+
+        if (failed != 0)
+        {
+            /*Codes_SRS_SCHEMA_41_004: [ If building any index fails then Schema_BuildLookupIndexes shall return SCHEMA_ERROR. Lookups in the collections without an index shall still succeed by scanning the collection. ]*/
+            LogError("unable to build all the name indexes, some lookups will scan");
+            result = SCHEMA_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_SCHEMA_41_005: [ Otherwise Schema_BuildLookupIndexes shall succeed and return SCHEMA_OK. ]*/
+            result = SCHEMA_OK;
+        }
+    }
+    return result;
+}
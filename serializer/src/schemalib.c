@@ -11,6 +11,12 @@
 #include <stddef.h>
 #include "azure_c_shared_utility/xlogging.h"
 #include "iotdevice.h"
+#include "commanddecoder.h"
+
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
 
 #define DEFAULT_CONTAINER_NAME  "Container"
 
@@ -84,6 +90,37 @@ SERIALIZER_RESULT serializer_setconfig(SERIALIZER_CONFIG which, void* value)
         DataPublisher_SetMaxBufferSize(*(size_t*)value);
         result = SERIALIZER_OK;
     }
+    /* Codes_SRS_SCHEMALIB_41_001: [ When the which argument is SerializeDirectToBuffer, serializer_setconfig shall invoke CodeFirst_SetDirectSerialization with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+    else if (which == SerializeDirectToBuffer)
+    {
+        CodeFirst_SetDirectSerialization(*(bool*)value);
+        result = SERIALIZER_OK;
+    }
+    /* Codes_SRS_SCHEMALIB_41_002: [ When the which argument is IngestDesiredPropertiesStreaming, serializer_setconfig shall invoke CommandDecoder_SetStreamingDesiredProperties with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+    else if (which == IngestDesiredPropertiesStreaming)
+    {
+        CommandDecoder_SetStreamingDesiredProperties(*(bool*)value);
+        result = SERIALIZER_OK;
+    }
+    /* Codes_SRS_SCHEMALIB_41_003: [ When the which argument is SerializeTransactionArenaSize, serializer_setconfig shall invoke DataPublisher_SetTransactionArenaSize with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+    else if (which == SerializeTransactionArenaSize)
+    {
+        DataPublisher_SetTransactionArenaSize(*(size_t*)value);
+        result = SERIALIZER_OK;
+    }
+    /* Codes_SRS_SCHEMALIB_41_004: [ When the which argument is SerializeAsCBOR, serializer_setconfig shall invoke DataMarshaller_SetCBOREncoding and CodeFirst_SetCBOREncoding with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+    else if (which == SerializeAsCBOR)
+    {
+        DataMarshaller_SetCBOREncoding(*(bool*)value);
+        CodeFirst_SetCBOREncoding(*(bool*)value);
+        result = SERIALIZER_OK;
+    }
+    /* Codes_SRS_SCHEMALIB_41_005: [ When the which argument is IngestDesiredPropertiesChangesOnly, serializer_setconfig shall invoke CommandDecoder_SetChangeOnlyDesiredProperties with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+    else if (which == IngestDesiredPropertiesChangesOnly)
+    {
+        CommandDecoder_SetChangeOnlyDesiredProperties(*(bool*)value);
+        result = SERIALIZER_OK;
+    }
     /* Codes_SRS_SCHEMALIB_99_138:[ If the which argument is not one of the declared members of the SERIALIZER_CONFIG enum, serializer_setconfig shall return SERIALIZER_INVALID_ARG.] */
     else
     {
@@ -5,10 +5,16 @@
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <stddef.h>
+#include <string.h>
 #include "schemaserializer.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/macro_utils.h"
 
+#ifdef USE_MEMORY_ACCOUNTING
+#define IOTHUB_CLIENT_MEMORY_SUBSYSTEM_FOR_THIS IOTHUB_CLIENT_MEMORY_SUBSYSTEM_SERIALIZER
+#include "iothub_client_memory_tag.h"
+#endif
+
 DEFINE_ENUM_STRINGS(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_RESULT_VALUES);
 
 #define LOG_SCHEMA_SERIALIZER_ERROR(result) LogError("(result = %s)", ENUM_TO_STRING(SCHEMA_SERIALIZER_RESULT, (result)))
@@ -172,3 +178,249 @@ SCHEMA_SERIALIZER_RESULT SchemaSerializer_SerializeCommandMetadata(SCHEMA_MODEL_
 
     return result;
 }
+
+SCHEMA_SERIALIZER_RESULT SchemaSerializer_GetCommandMetadata(SCHEMA_MODEL_TYPE_HANDLE modelHandle, const char** schemaText)
+{
+    SCHEMA_SERIALIZER_RESULT result;
+
+    /* Codes_SRS_SCHEMA_SERIALIZER_41_001: [If modelHandle or schemaText is NULL, SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_INVALID_ARG.] */
+    if ((modelHandle == NULL) ||
+        (schemaText == NULL))
+    {
+        result = SCHEMA_SERIALIZER_INVALID_ARG;
+        LogError("(result = %s), modelHandle = %p, schemaText = %p", ENUM_TO_STRING(SCHEMA_SERIALIZER_RESULT, result), modelHandle, schemaText);
+    }
+    else
+    {
+        const unsigned char* cached;
+        size_t cachedSize;
+
+        /* Codes_SRS_SCHEMA_SERIALIZER_41_002: [If the JSON command metadata of the model is cached by Schema_GetModelCommandMetadataCache, SchemaSerializer_GetCommandMetadata shall set *schemaText to it and return SCHEMA_SERIALIZER_OK.] */
+        if (Schema_GetModelCommandMetadataCache(modelHandle, false, &cached, &cachedSize) == SCHEMA_OK)
+        {
+            *schemaText = (const char*)cached;
+            result = SCHEMA_SERIALIZER_OK;
+        }
+        else
+        {
+            STRING_HANDLE text = STRING_new();
+            if (text == NULL)
+            {
+                /* Codes_SRS_SCHEMA_SERIALIZER_41_004: [If any of the Schema or String APIs fail then SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_ERROR.] */
+                result = SCHEMA_SERIALIZER_ERROR;
+                LOG_SCHEMA_SERIALIZER_ERROR(result);
+            }
+            else
+            {
+                /* Codes_SRS_SCHEMA_SERIALIZER_41_003: [Otherwise SchemaSerializer_GetCommandMetadata shall build the text with SchemaSerializer_SerializeCommandMetadata, cache it (including the '\0') with Schema_SetModelCommandMetadataCache and set *schemaText to the cached copy.] */
+                if ((SchemaSerializer_SerializeCommandMetadata(modelHandle, text) != SCHEMA_SERIALIZER_OK) ||
+                    (Schema_SetModelCommandMetadataCache(modelHandle, false, (const unsigned char*)STRING_c_str(text), STRING_length(text) + 1) != SCHEMA_OK) ||
+                    (Schema_GetModelCommandMetadataCache(modelHandle, false, &cached, &cachedSize) != SCHEMA_OK))
+                {
+                    /* Codes_SRS_SCHEMA_SERIALIZER_41_004: [If any of the Schema or String APIs fail then SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_ERROR.] */
+                    result = SCHEMA_SERIALIZER_ERROR;
+                    LOG_SCHEMA_SERIALIZER_ERROR(result);
+                }
+                else
+                {
+                    *schemaText = (const char*)cached;
+                    result = SCHEMA_SERIALIZER_OK;
+                }
+                STRING_delete(text);
+            }
+        }
+    }
+
+    return result;
+}
+
+/*the compact form is CBOR (RFC 7049) made only of arrays and text strings*/
+#define CBOR_MAJOR_TYPE_TEXT_STRING 0x60
+#define CBOR_MAJOR_TYPE_ARRAY 0x80
+
+typedef struct COMPACT_BUFFER_TAG
+{
+    unsigned char* bytes;
+    size_t size;
+    size_t capacity;
+} COMPACT_BUFFER;
+
+static int AppendCompact(COMPACT_BUFFER* buffer, const unsigned char* bytes, size_t size)
+{
+    int result;
+    if (buffer->size + size > buffer->capacity)
+    {
+        size_t newCapacity = (buffer->capacity == 0) ? 64 : buffer->capacity;
+        unsigned char* newBytes;
+        while (newCapacity < buffer->size + size)
+        {
+            newCapacity *= 2;
+        }
+        newBytes = (unsigned char*)realloc(buffer->bytes, newCapacity);
+        if (newBytes == NULL)
+        {
+            LogError("unable to realloc");
+            result = __FAILURE__;
+        }
+        else
+        {
+            buffer->bytes = newBytes;
+            buffer->capacity = newCapacity;
+            result = 0;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if (result == 0)
+    {
+        (void)memcpy(buffer->bytes + buffer->size, bytes, size);
+        buffer->size += size;
+    }
+    return result;
+}
+
+/*writes the head of a CBOR data item, the argument is a count (array elements, string bytes)*/
+static int AppendCompactHead(COMPACT_BUFFER* buffer, unsigned char majorType, size_t argument)
+{
+    unsigned char head[9];
+    size_t headSize;
+    if (argument < 24)
+    {
+        head[0] = majorType | (unsigned char)argument;
+        headSize = 1;
+    }
+    else if (argument <= 0xFF)
+    {
+        head[0] = majorType | 24;
+        head[1] = (unsigned char)argument;
+        headSize = 2;
+    }
+    else if (argument <= 0xFFFF)
+    {
+        head[0] = majorType | 25;
+        head[1] = (unsigned char)(argument >> 8);
+        head[2] = (unsigned char)argument;
+        headSize = 3;
+    }
+    else
+    {
+        /*no name is 4GB long and no model has 4G commands*/
+        head[0] = majorType | 26;
+        head[1] = (unsigned char)(argument >> 24);
+        head[2] = (unsigned char)(argument >> 16);
+        head[3] = (unsigned char)(argument >> 8);
+        head[4] = (unsigned char)argument;
+        headSize = 5;
+    }
+    return AppendCompact(buffer, head, headSize);
+}
+
+static int AppendCompactText(COMPACT_BUFFER* buffer, const char* text)
+{
+    size_t length = strlen(text);
+    return
+        (AppendCompactHead(buffer, CBOR_MAJOR_TYPE_TEXT_STRING, length) != 0) ||
+        (AppendCompact(buffer, (const unsigned char*)text, length) != 0);
+}
+
+static int SerializeCommandMetadataCompact(SCHEMA_MODEL_TYPE_HANDLE modelHandle, COMPACT_BUFFER* buffer)
+{
+    int result;
+    size_t commandCount;
+
+    if ((Schema_GetModelActionCount(modelHandle, &commandCount) != SCHEMA_OK) ||
+        (AppendCompactHead(buffer, CBOR_MAJOR_TYPE_ARRAY, commandCount) != 0))
+    {
+        LogError("Failed encoding the command count.");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+        result = 0;
+        for (i = 0; (result == 0) && (i < commandCount); i++)
+        {
+            SCHEMA_ACTION_HANDLE actionHandle = Schema_GetModelActionByIndex(modelHandle, i);
+            const char* commandName;
+            size_t argCount;
+
+            if ((actionHandle == NULL) ||
+                ((commandName = Schema_GetModelActionName(actionHandle)) == NULL) ||
+                (Schema_GetModelActionArgumentCount(actionHandle, &argCount) != SCHEMA_OK) ||
+                (AppendCompactHead(buffer, CBOR_MAJOR_TYPE_ARRAY, 2) != 0) ||
+                (AppendCompactText(buffer, commandName) != 0) ||
+                (AppendCompactHead(buffer, CBOR_MAJOR_TYPE_ARRAY, argCount) != 0))
+            {
+                LogError("Failed encoding action.");
+                result = __FAILURE__;
+            }
+            else
+            {
+                size_t j;
+                for (j = 0; j < argCount; j++)
+                {
+                    SCHEMA_ACTION_ARGUMENT_HANDLE argHandle = Schema_GetModelActionArgumentByIndex(actionHandle, j);
+                    const char* argName;
+                    const char* argType;
+
+                    if ((argHandle == NULL) ||
+                        ((argName = Schema_GetActionArgumentName(argHandle)) == NULL) ||
+                        ((argType = Schema_GetActionArgumentType(argHandle)) == NULL) ||
+                        (AppendCompactHead(buffer, CBOR_MAJOR_TYPE_ARRAY, 2) != 0) ||
+                        (AppendCompactText(buffer, argName) != 0) ||
+                        (AppendCompactText(buffer, ConvertType(argType)) != 0))
+                    {
+                        LogError("Failed encoding argument.");
+                        result = __FAILURE__;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+SCHEMA_SERIALIZER_RESULT SchemaSerializer_GetCommandMetadataCompact(SCHEMA_MODEL_TYPE_HANDLE modelHandle, const unsigned char** bytes, size_t* size)
+{
+    SCHEMA_SERIALIZER_RESULT result;
+
+    /* Codes_SRS_SCHEMA_SERIALIZER_41_005: [If modelHandle, bytes or size is NULL, SchemaSerializer_GetCommandMetadataCompact shall return SCHEMA_SERIALIZER_INVALID_ARG.] */
+    if ((modelHandle == NULL) ||
+        (bytes == NULL) ||
+        (size == NULL))
+    {
+        result = SCHEMA_SERIALIZER_INVALID_ARG;
+        LogError("(result = %s), modelHandle = %p, bytes = %p, size = %p", ENUM_TO_STRING(SCHEMA_SERIALIZER_RESULT, result), modelHandle, bytes, size);
+    }
+    /* Codes_SRS_SCHEMA_SERIALIZER_41_006: [If the compact command metadata of the model is cached by Schema_GetModelCommandMetadataCache, SchemaSerializer_GetCommandMetadataCompact shall set *bytes and *size to it and return SCHEMA_SERIALIZER_OK.] */
+    else if (Schema_GetModelCommandMetadataCache(modelHandle, true, bytes, size) == SCHEMA_OK)
+    {
+        result = SCHEMA_SERIALIZER_OK;
+    }
+    else
+    {
+        COMPACT_BUFFER buffer = { NULL, 0, 0 };
+
+        /* Codes_SRS_SCHEMA_SERIALIZER_41_007: [Otherwise SchemaSerializer_GetCommandMetadataCompact shall encode the commands as a CBOR array holding, for every command, an array of its name and an array of [name, type] arrays for its arguments, with the types converted as for the JSON form.] */
+        /* Codes_SRS_SCHEMA_SERIALIZER_41_008: [The encoding shall be cached with Schema_SetModelCommandMetadataCache and *bytes and *size shall be set to the cached copy.] */
+        if ((SerializeCommandMetadataCompact(modelHandle, &buffer) != 0) ||
+            (Schema_SetModelCommandMetadataCache(modelHandle, true, buffer.bytes, buffer.size) != SCHEMA_OK) ||
+            (Schema_GetModelCommandMetadataCache(modelHandle, true, bytes, size) != SCHEMA_OK))
+        {
+            /* Codes_SRS_SCHEMA_SERIALIZER_41_009: [If any of the Schema APIs or memory allocation fail then SchemaSerializer_GetCommandMetadataCompact shall return SCHEMA_SERIALIZER_ERROR.] */
+            result = SCHEMA_SERIALIZER_ERROR;
+            LOG_SCHEMA_SERIALIZER_ERROR(result);
+        }
+        else
+        {
+            result = SCHEMA_SERIALIZER_OK;
+        }
+        free(buffer.bytes);
+    }
+
+    return result;
+}
@@ -4177,6 +4177,66 @@ BEGIN_TEST_SUITE(AgentTypeSystem_ut)
             Destroy_AGENT_DATA_TYPE(&ag);
         }
 
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_005: [ EDM_DATE_TIME_OFFSET values shall be formatted in a buffer on the stack, producing the same characters as sprintf with the "%.4d-%.2d-%.2dT%.2d:%.2d:%.2d" format followed by ".%.12llu" when there is a fractional second and by "%+.2d:%.2d" or "Z". ]*/
+        TEST_FUNCTION(AgentDataTypes_ToString_for_EDM_DATE_TIME_OFFSET_without_fractional_second_and_time_zone_succeeds)
+        {
+            ///arrange
+            AGENT_DATA_TYPE ag;
+            EDM_DATE_TIME_OFFSET someDateTimeOffset;
+            someDateTimeOffset.dateTime.tm_year = 114; /*so 2014*/
+            someDateTimeOffset.dateTime.tm_mon = 6 - 1;
+            someDateTimeOffset.dateTime.tm_mday = 8;
+            someDateTimeOffset.dateTime.tm_hour = 9;
+            someDateTimeOffset.dateTime.tm_min = 1;
+            someDateTimeOffset.dateTime.tm_sec = 0;
+            someDateTimeOffset.hasFractionalSecond = 0;
+            someDateTimeOffset.fractionalSecond = 0;
+            someDateTimeOffset.hasTimeZone = 0;
+            someDateTimeOffset.timeZoneHour = 0;
+            someDateTimeOffset.timeZoneMinute = 0;
+            (void)Create_AGENT_DATA_TYPE_from_EDM_DATE_TIME_OFFSET(&ag, someDateTimeOffset);
+
+            ///act
+            auto res = AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res);
+            ASSERT_ARE_EQUAL(char_ptr, "\"2014-06-08T09:01:00Z\"", STRING_c_str(global_bufferTemp));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+        }
+
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_005: [ EDM_DATE_TIME_OFFSET values shall be formatted in a buffer on the stack, producing the same characters as sprintf with the "%.4d-%.2d-%.2dT%.2d:%.2d:%.2d" format followed by ".%.12llu" when there is a fractional second and by "%+.2d:%.2d" or "Z". ]*/
+        TEST_FUNCTION(AgentDataTypes_ToString_for_EDM_DATE_TIME_OFFSET_with_fractional_second_and_time_zone_succeeds)
+        {
+            ///arrange
+            AGENT_DATA_TYPE ag;
+            EDM_DATE_TIME_OFFSET someDateTimeOffset;
+            someDateTimeOffset.dateTime.tm_year = -1900 - 5; /*so -0005*/
+            someDateTimeOffset.dateTime.tm_mon = 12 - 1;
+            someDateTimeOffset.dateTime.tm_mday = 31;
+            someDateTimeOffset.dateTime.tm_hour = 23;
+            someDateTimeOffset.dateTime.tm_min = 59;
+            someDateTimeOffset.dateTime.tm_sec = 59;
+            someDateTimeOffset.hasFractionalSecond = 1;
+            someDateTimeOffset.fractionalSecond = 1234;
+            someDateTimeOffset.hasTimeZone = 1;
+            someDateTimeOffset.timeZoneHour = -8;
+            someDateTimeOffset.timeZoneMinute = 30;
+            (void)Create_AGENT_DATA_TYPE_from_EDM_DATE_TIME_OFFSET(&ag, someDateTimeOffset);
+
+            ///act
+            auto res = AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res);
+            ASSERT_ARE_EQUAL(char_ptr, "\"-0005-12-31T23:59:59.000000001234-08:30\"", STRING_c_str(global_bufferTemp));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+        }
+
 #ifndef NO_FLOATS
         /*Tests_SRS_AGENT_TYPE_SYSTEM_99_041:[ Creates an AGENT_DATA_TYPE containing an EDM_DOUBLE from double]*/
         TEST_FUNCTION(Create_AGENT_DATA_TYPE_from_DOUBLE_succeeds_1)
@@ -4405,6 +4465,78 @@ BEGIN_TEST_SUITE(AgentTypeSystem_ut)
             ASSERT_ARE_EQUAL(double, TEST_DOUBLE_2, atof(STRING_c_str(global_bufferTemp)));
         }
 
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_001: [ EDM_SINGLE and EDM_DOUBLE values whose magnitude is below 2^53 shall be formatted with integer arithmetic, producing the same characters as sprintf with the "%.*f" format. ]*/
+        TEST_FUNCTION(AgentDataTypes_ToString_DOUBLE_produces_the_same_digits_as_printf)
+        {
+            ///arrange
+            AGENT_DATA_TYPE ag;
+            (void)Create_AGENT_DATA_TYPE_from_DOUBLE(&ag, -1234.5678);
+
+            ///act
+            auto res = AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res);
+            ASSERT_ARE_EQUAL(char_ptr, "-1234.567800000000000", STRING_c_str(global_bufferTemp));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+        }
+
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_001: [ EDM_SINGLE and EDM_DOUBLE values whose magnitude is below 2^53 shall be formatted with integer arithmetic, producing the same characters as sprintf with the "%.*f" format. ]*/
+        TEST_FUNCTION(AgentDataTypes_ToString_DOUBLE_rounds_ties_to_even)
+        {
+            ///arrange
+            AGENT_DATA_TYPE ag;
+            (void)Create_AGENT_DATA_TYPE_from_DOUBLE(&ag, 0.0078125);
+
+            ///act
+            auto res = AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res);
+            ASSERT_ARE_EQUAL(char_ptr, "0.007812500000000", STRING_c_str(global_bufferTemp));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+        }
+
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_002: [ Other values shall be formatted with sprintf_s. ]*/
+        TEST_FUNCTION(AgentDataTypes_ToString_DOUBLE_negative_zero_keeps_the_sign)
+        {
+            ///arrange
+            AGENT_DATA_TYPE ag;
+            (void)Create_AGENT_DATA_TYPE_from_DOUBLE(&ag, -0.0);
+
+            ///act
+            auto res = AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res);
+            ASSERT_ARE_EQUAL(char_ptr, "-0.000000000000000", STRING_c_str(global_bufferTemp));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+        }
+
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_002: [ Other values shall be formatted with sprintf_s. ]*/
+        TEST_FUNCTION(AgentDataTypes_ToString_DOUBLE_above_2_to_53_succeeds)
+        {
+            ///arrange
+            AGENT_DATA_TYPE ag;
+            (void)Create_AGENT_DATA_TYPE_from_DOUBLE(&ag, 1e20);
+
+            ///act
+            auto res = AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res);
+            ASSERT_ARE_EQUAL(char_ptr, "100000000000000000000.000000000000000", STRING_c_str(global_bufferTemp));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+        }
+
         /*Tests_SRS_AGENT_TYPE_SYSTEM_99_047:[ Creates an AGENT_DATA_TYPE containing an EDM_SINGLE from float]*/
         TEST_FUNCTION(Create_AGENT_DATA_TYPE_from_FLOAT_succeeds_1)
         {
@@ -4639,6 +4771,42 @@ BEGIN_TEST_SUITE(AgentTypeSystem_ut)
             ASSERT_ARE_EQUAL(float, TEST_FLOAT_2, (float)atof(STRING_c_str(global_bufferTemp)));
 
         }
+
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_001: [ EDM_SINGLE and EDM_DOUBLE values whose magnitude is below 2^53 shall be formatted with integer arithmetic, producing the same characters as sprintf with the "%.*f" format. ]*/
+        TEST_FUNCTION(AgentDataTypes_ToString_FLOAT_produces_the_same_digits_as_printf)
+        {
+            ///arrange
+            AGENT_DATA_TYPE ag;
+            (void)Create_AGENT_DATA_TYPE_from_FLOAT(&ag, 42.42f);
+
+            ///act
+            auto res = AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res);
+            ASSERT_ARE_EQUAL(char_ptr, "42.419998", STRING_c_str(global_bufferTemp));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+        }
+
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_001: [ EDM_SINGLE and EDM_DOUBLE values whose magnitude is below 2^53 shall be formatted with integer arithmetic, producing the same characters as sprintf with the "%.*f" format. ]*/
+        TEST_FUNCTION(AgentDataTypes_ToString_FLOAT_rounds_ties_to_even)
+        {
+            ///arrange
+            AGENT_DATA_TYPE ag;
+            (void)Create_AGENT_DATA_TYPE_from_FLOAT(&ag, -0.0078125f);
+
+            ///act
+            auto res = AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res);
+            ASSERT_ARE_EQUAL(char_ptr, "-0.007812", STRING_c_str(global_bufferTemp));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+        }
 #endif
 
         /*Tests_SRS_AGENT_TYPE_SYSTEM_99_043:[ Creates an AGENT_DATA_TYPE containing an EDM_INT16 from int16_t]*/
@@ -12470,8 +12638,160 @@ BEGIN_TEST_SUITE(AgentTypeSystem_ut)
             // cleanup
             Destroy_AGENT_DATA_TYPE(&agentData);
         }
+
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_41_004: [ Decimal numbers with at most 19 significant digits that can be converted exactly with one multiplication or division by a power of 10 shall be parsed without calling strtod or strtof. ] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_DOUBLE_fast_path_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "-12345.678e-2";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_DOUBLE_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_DOUBLE_TYPE, agentData.type);
+            ASSERT_ARE_EQUAL(double, strtod(source, NULL), agentData.value.edmDouble.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
+
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_41_004: [ Decimal numbers with at most 19 significant digits that can be converted exactly with one multiplication or division by a power of 10 shall be parsed without calling strtod or strtof. ] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_DOUBLE_with_20_digits_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "0.12345678901234567890";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_DOUBLE_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_DOUBLE_TYPE, agentData.type);
+            ASSERT_ARE_EQUAL(double, strtod(source, NULL), agentData.value.edmDouble.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
+
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_41_004: [ Decimal numbers with at most 19 significant digits that can be converted exactly with one multiplication or division by a power of 10 shall be parsed without calling strtod or strtof. ] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_DOUBLE_large_exponent_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "1e23";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_DOUBLE_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_DOUBLE_TYPE, agentData.type);
+            ASSERT_ARE_EQUAL(double, strtod(source, NULL), agentData.value.edmDouble.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
+
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_41_004: [ Decimal numbers with at most 19 significant digits that can be converted exactly with one multiplication or division by a power of 10 shall be parsed without calling strtod or strtof. ] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_DOUBLE_hexadecimal_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "0x10";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_DOUBLE_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_DOUBLE_TYPE, agentData.type);
+            ASSERT_ARE_EQUAL(double, 16.0, agentData.value.edmDouble.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
+
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_41_004: [ Decimal numbers with at most 19 significant digits that can be converted exactly with one multiplication or division by a power of 10 shall be parsed without calling strtod or strtof. ] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_SINGLE_fast_path_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "23.5";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_SINGLE_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_SINGLE_TYPE, agentData.type);
+            ASSERT_ARE_EQUAL(float, 23.5f, agentData.value.edmSingle.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
 #endif
 
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_41_003: [ Integers of at most 9 digits (at most 19 for EDM_INT64) shall be parsed without calling strtol, strtoul or strtoull. ] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_INT64_19_digits_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "-1234567890123456789";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_INT64_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_INT64_TYPE, agentData.type);
+            ASSERT_IS_TRUE(-1234567890123456789LL == agentData.value.edmInt64.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
+
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_41_003: [ Integers of at most 9 digits (at most 19 for EDM_INT64) shall be parsed without calling strtol, strtoul or strtoull. ] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_INT32_10_digits_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "2147483647";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_INT32_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_INT32_TYPE, agentData.type);
+            ASSERT_ARE_EQUAL(int32_t, 2147483647, agentData.value.edmInt32.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
+
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_41_003: [ Integers of at most 9 digits (at most 19 for EDM_INT64) shall be parsed without calling strtol, strtoul or strtoull. ] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_INT16_with_plus_sign_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "+1234";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_INT16_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_INT16_TYPE, agentData.type);
+            ASSERT_ARE_EQUAL(int16_t, 1234, agentData.value.edmInt16.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
+
         /* Tests_SRS_AGENT_TYPE_SYSTEM_99_079:[ EDM_DECIMAL] */
         /* Tests_SRS_AGENT_TYPE_SYSTEM_99_087:[ CreateAgentDataType_From_String shall return AGENT_DATA_TYPES_INVALID_ARG if source is not a valid string for a value of type type.] */
         TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_DECIMAL_Empty_String_Fails)
@@ -13326,6 +13646,29 @@ BEGIN_TEST_SUITE(AgentTypeSystem_ut)
             }
         }
 
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_99_099:[ EDM_BINARY: = *(4base64char) [ base64b16  / base64b8 ]]*/
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_99_100:[ EDM_BINARY]*/
+        TEST_FUNCTION(CreateAgentDataType_From_String_for_a_EDM_BINARY_with_every_base64_character_round_trips)
+        {
+            ///arrange
+            const char* allCharacters = "\"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_\"";
+            AGENT_DATA_TYPE ag;
+            STRING_empty(global_bufferTemp);
+
+            ///act
+            auto result1 = CreateAgentDataType_From_String(allCharacters, EDM_BINARY_TYPE, &ag);
+            auto result2 = AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result1);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result2);
+            ASSERT_ARE_EQUAL(size_t, (size_t)48, ag.value.edmBinary.size);
+            ASSERT_ARE_EQUAL(char_ptr, allCharacters, STRING_c_str(global_bufferTemp));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+        }
+
         /*validating base64 decode with invalid base64 encoded strings*/
         TEST_FUNCTION(CreateAgentDataType_From_String_for_a_EDM_BINARY_when_input_string_contains_1_garbage_character_inserted_fails)
         {
@@ -0,0 +1,457 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* s)
+{
+    free(s);
+}
+
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "agenttypesystem.h"
+#undef ENABLE_MOCKS
+
+#include "aggregateddata.h"
+#include "testrunnerswitcher.h"
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+TEST_DEFINE_ENUM_TYPE(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_RESULT_VALUES);
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#define TEST_WINDOW 4
+#define TEST_MAX_MEMBERS 7
+#define TEST_DESTINATION ((AGENT_DATA_TYPE*)0x4242)
+
+/*the members handed to Create_AGENT_DATA_TYPE_from_Members by the last conversion*/
+static size_t g_nMembers;
+static const char* g_memberNames[TEST_MAX_MEMBERS];
+static AGENT_DATA_TYPE g_memberValues[TEST_MAX_MEMBERS];
+
+static AGENT_DATA_TYPES_RESULT my_Create_AGENT_DATA_TYPE_from_SINT64(AGENT_DATA_TYPE* agentData, int64_t v)
+{
+    agentData->type = EDM_INT64_TYPE;
+    agentData->value.edmInt64.value = v;
+    return AGENT_DATA_TYPES_OK;
+}
+
+static AGENT_DATA_TYPES_RESULT my_Create_AGENT_DATA_TYPE_from_DOUBLE(AGENT_DATA_TYPE* agentData, double v)
+{
+    agentData->type = EDM_DOUBLE_TYPE;
+    agentData->value.edmDouble.value = v;
+    return AGENT_DATA_TYPES_OK;
+}
+
+static AGENT_DATA_TYPES_RESULT my_Create_AGENT_DATA_TYPE_from_Members(AGENT_DATA_TYPE* agentData, const char* typeName, size_t nMembers, const char* const * memberNames, const AGENT_DATA_TYPE* memberValues)
+{
+    size_t i;
+    (void)agentData;
+    (void)typeName;
+    g_nMembers = nMembers;
+    for (i = 0; i < nMembers; i++)
+    {
+        g_memberNames[i] = memberNames[i];
+        g_memberValues[i] = memberValues[i];
+    }
+    return AGENT_DATA_TYPES_OK;
+}
+
+static size_t g_sampleConversions;
+static AGENT_DATA_TYPES_RESULT g_sampleConversionResult;
+
+static AGENT_DATA_TYPES_RESULT test_toAgentDataType(AGENT_DATA_TYPE* destination, double value)
+{
+    g_sampleConversions++;
+    destination->type = EDM_DOUBLE_TYPE;
+    destination->value.edmDouble.value = value;
+    return g_sampleConversionResult;
+}
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static void add_samples(AGGREGATED_DATA_STATE* state, double* samples, const double* values, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, AggregatedData_Add(state, samples, TEST_WINDOW, values[i]));
+    }
+}
+
+static double member_as_double(size_t index)
+{
+    ASSERT_ARE_EQUAL(int, EDM_DOUBLE_TYPE, g_memberValues[index].type);
+    return g_memberValues[index].value.edmDouble.value;
+}
+
+BEGIN_TEST_SUITE(AggregatedData_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        (void)umock_c_init(on_umock_c_error);
+        (void)umocktypes_charptr_register_types();
+        (void)umocktypes_stdint_register_types();
+
+        REGISTER_UMOCK_ALIAS_TYPE(AGENT_DATA_TYPES_RESULT, int);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+        REGISTER_GLOBAL_MOCK_HOOK(Create_AGENT_DATA_TYPE_from_SINT64, my_Create_AGENT_DATA_TYPE_from_SINT64);
+        REGISTER_GLOBAL_MOCK_HOOK(Create_AGENT_DATA_TYPE_from_DOUBLE, my_Create_AGENT_DATA_TYPE_from_DOUBLE);
+        REGISTER_GLOBAL_MOCK_HOOK(Create_AGENT_DATA_TYPE_from_Members, my_Create_AGENT_DATA_TYPE_from_Members);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        umock_c_deinit();
+
+        TEST_MUTEX_DESTROY(g_testByTest);
+        TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest))
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+        g_nMembers = 0;
+        g_sampleConversions = 0;
+        g_sampleConversionResult = AGENT_DATA_TYPES_OK;
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_001: [ If state or samples is NULL or windowSize is 0 then AggregatedData_Add shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(AggregatedData_Add_with_NULL_state_fails)
+    {
+        ///arrange
+        double samples[2 * TEST_WINDOW];
+
+        ///act
+        int result = AggregatedData_Add(NULL, samples, TEST_WINDOW, 1.0);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_001: [ If state or samples is NULL or windowSize is 0 then AggregatedData_Add shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(AggregatedData_Add_with_NULL_samples_fails)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+
+        ///act
+        int result = AggregatedData_Add(&state, NULL, TEST_WINDOW, 1.0);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 0, state.count);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_001: [ If state or samples is NULL or windowSize is 0 then AggregatedData_Add shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(AggregatedData_Add_with_zero_windowSize_fails)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+
+        ///act
+        int result = AggregatedData_Add(&state, samples, 0, 1.0);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 0, state.count);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_002: [ If sample is NaN then AggregatedData_Add shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(AggregatedData_Add_with_NaN_fails)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+
+        ///act
+        int result = AggregatedData_Add(&state, samples, TEST_WINDOW, NAN);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 0, state.count);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_004: [ AggregatedData_Add shall insert sample in the sorted samples keeping them in ascending order, add it to the running sum and store it in the ring at the next position. ]*/
+    /*Tests_SRS_AGGREGATEDDATA_41_006: [ On success AggregatedData_Add shall return 0. ]*/
+    TEST_FUNCTION(AggregatedData_Add_keeps_the_samples_in_arrival_order_and_sorted)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+        const double values[] = { 3.0, 1.0, 2.0 };
+
+        ///act
+        add_samples(&state, samples, values, sizeof(values) / sizeof(values[0]));
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 3, state.count);
+        ASSERT_ARE_EQUAL(size_t, 3, state.next);
+        ASSERT_ARE_EQUAL(double, 6.0, state.sum);
+        ASSERT_ARE_EQUAL(double, 3.0, samples[0]);
+        ASSERT_ARE_EQUAL(double, 1.0, samples[1]);
+        ASSERT_ARE_EQUAL(double, 2.0, samples[2]);
+        ASSERT_ARE_EQUAL(double, 1.0, samples[TEST_WINDOW + 0]);
+        ASSERT_ARE_EQUAL(double, 2.0, samples[TEST_WINDOW + 1]);
+        ASSERT_ARE_EQUAL(double, 3.0, samples[TEST_WINDOW + 2]);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_003: [ If the window already holds windowSize samples then AggregatedData_Add shall evict the oldest sample from the ring, from the sorted samples and from the running sum. ]*/
+    /*Tests_SRS_AGGREGATEDDATA_41_005: [ Every time the ring wraps around AggregatedData_Add shall recompute the running sum from the samples in the window. ]*/
+    TEST_FUNCTION(AggregatedData_Add_evicts_the_oldest_sample_when_the_window_is_full)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+        const double values[] = { 5.0, 1.0, 5.0, 3.0, 7.0, 0.5 };
+
+        ///act
+        add_samples(&state, samples, values, sizeof(values) / sizeof(values[0]));
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, TEST_WINDOW, state.count);
+        ASSERT_ARE_EQUAL(size_t, 2, state.next);
+        ASSERT_ARE_EQUAL(double, 15.5, state.sum);
+        ASSERT_ARE_EQUAL(double, 0.5, samples[TEST_WINDOW + 0]);
+        ASSERT_ARE_EQUAL(double, 3.0, samples[TEST_WINDOW + 1]);
+        ASSERT_ARE_EQUAL(double, 5.0, samples[TEST_WINDOW + 2]);
+        ASSERT_ARE_EQUAL(double, 7.0, samples[TEST_WINDOW + 3]);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_007: [ If state is NULL then AggregatedData_Reset shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(AggregatedData_Reset_with_NULL_state_fails)
+    {
+        ///act
+        int result = AggregatedData_Reset(NULL);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_008: [ AggregatedData_Reset shall empty the window and return 0. ]*/
+    TEST_FUNCTION(AggregatedData_Reset_empties_the_window)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+        const double values[] = { 1.0, 2.0 };
+        add_samples(&state, samples, values, sizeof(values) / sizeof(values[0]));
+
+        ///act
+        int result = AggregatedData_Reset(&state);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 0, state.count);
+        ASSERT_ARE_EQUAL(size_t, 0, state.next);
+        ASSERT_ARE_EQUAL(double, 0.0, state.sum);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_009: [ If destination, state, samples or toAgentDataType is NULL or windowSize is 0 then AggregatedData_ToAGENT_DATA_TYPE shall fail and return AGENT_DATA_TYPES_INVALID_ARG. ]*/
+    TEST_FUNCTION(AggregatedData_ToAGENT_DATA_TYPE_with_NULL_arguments_fails)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+
+        ///act
+        AGENT_DATA_TYPES_RESULT result1 = AggregatedData_ToAGENT_DATA_TYPE(NULL, &state, samples, TEST_WINDOW, test_toAgentDataType);
+        AGENT_DATA_TYPES_RESULT result2 = AggregatedData_ToAGENT_DATA_TYPE(TEST_DESTINATION, NULL, samples, TEST_WINDOW, test_toAgentDataType);
+        AGENT_DATA_TYPES_RESULT result3 = AggregatedData_ToAGENT_DATA_TYPE(TEST_DESTINATION, &state, NULL, TEST_WINDOW, test_toAgentDataType);
+        AGENT_DATA_TYPES_RESULT result4 = AggregatedData_ToAGENT_DATA_TYPE(TEST_DESTINATION, &state, samples, 0, test_toAgentDataType);
+        AGENT_DATA_TYPES_RESULT result5 = AggregatedData_ToAGENT_DATA_TYPE(TEST_DESTINATION, &state, samples, TEST_WINDOW, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_INVALID_ARG, result1);
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_INVALID_ARG, result2);
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_INVALID_ARG, result3);
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_INVALID_ARG, result4);
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_INVALID_ARG, result5);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_010: [ If the window is empty, AggregatedData_ToAGENT_DATA_TYPE shall produce a complex type AGGREGATED_DATA_TYPE_NAME having only the member count. ]*/
+    /*Tests_SRS_AGGREGATEDDATA_41_016: [ AggregatedData_ToAGENT_DATA_TYPE shall destroy the member values it created. ]*/
+    TEST_FUNCTION(AggregatedData_ToAGENT_DATA_TYPE_of_an_empty_window_has_only_count)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT64(IGNORED_PTR_ARG, 0));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_Members(TEST_DESTINATION, AGGREGATED_DATA_TYPE_NAME, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+
+        ///act
+        AGENT_DATA_TYPES_RESULT result = AggregatedData_ToAGENT_DATA_TYPE(TEST_DESTINATION, &state, samples, TEST_WINDOW, test_toAgentDataType);
+
+        ///assert
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, g_nMembers);
+        ASSERT_ARE_EQUAL(char_ptr, "count", g_memberNames[0]);
+        ASSERT_ARE_EQUAL(size_t, 0, g_sampleConversions);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_011: [ Otherwise AggregatedData_ToAGENT_DATA_TYPE shall produce a complex type AGGREGATED_DATA_TYPE_NAME having the members count, min, max, mean, p50, p90 and p99. ]*/
+    /*Tests_SRS_AGGREGATEDDATA_41_012: [ count shall be an EDM_INT64, mean shall be an EDM_DOUBLE and min, max and the percentiles shall be converted by toAgentDataType. ]*/
+    /*Tests_SRS_AGGREGATEDDATA_41_013: [ Percentiles shall use the nearest rank method over the sorted samples. ]*/
+    /*Tests_SRS_AGGREGATEDDATA_41_015: [ On success AggregatedData_ToAGENT_DATA_TYPE shall return AGENT_DATA_TYPES_OK. ]*/
+    TEST_FUNCTION(AggregatedData_ToAGENT_DATA_TYPE_produces_the_window_summary)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+        const double values[] = { 100.0, 4.0, 1.0, 3.0, 2.0 }; /*100 is evicted*/
+        size_t i;
+        add_samples(&state, samples, values, sizeof(values) / sizeof(values[0]));
+
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT64(IGNORED_PTR_ARG, TEST_WINDOW));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, 2.5));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_Members(TEST_DESTINATION, AGGREGATED_DATA_TYPE_NAME, 7, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        for (i = 0; i < 7; i++)
+        {
+            STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        }
+
+        ///act
+        AGENT_DATA_TYPES_RESULT result = AggregatedData_ToAGENT_DATA_TYPE(TEST_DESTINATION, &state, samples, TEST_WINDOW, test_toAgentDataType);
+
+        ///assert
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 7, g_nMembers);
+        ASSERT_ARE_EQUAL(char_ptr, "count", g_memberNames[0]);
+        ASSERT_ARE_EQUAL(char_ptr, "min", g_memberNames[1]);
+        ASSERT_ARE_EQUAL(char_ptr, "max", g_memberNames[2]);
+        ASSERT_ARE_EQUAL(char_ptr, "mean", g_memberNames[3]);
+        ASSERT_ARE_EQUAL(char_ptr, "p50", g_memberNames[4]);
+        ASSERT_ARE_EQUAL(char_ptr, "p90", g_memberNames[5]);
+        ASSERT_ARE_EQUAL(char_ptr, "p99", g_memberNames[6]);
+        ASSERT_ARE_EQUAL(int, EDM_INT64_TYPE, g_memberValues[0].type);
+        ASSERT_ARE_EQUAL(double, 1.0, member_as_double(1));
+        ASSERT_ARE_EQUAL(double, 4.0, member_as_double(2));
+        ASSERT_ARE_EQUAL(double, 2.5, member_as_double(3));
+        ASSERT_ARE_EQUAL(double, 2.0, member_as_double(4));
+        ASSERT_ARE_EQUAL(double, 4.0, member_as_double(5));
+        ASSERT_ARE_EQUAL(double, 4.0, member_as_double(6));
+        ASSERT_ARE_EQUAL(size_t, 5, g_sampleConversions);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_014: [ If any conversion fails, AggregatedData_ToAGENT_DATA_TYPE shall fail and return AGENT_DATA_TYPES_ERROR. ]*/
+    /*Tests_SRS_AGGREGATEDDATA_41_016: [ AggregatedData_ToAGENT_DATA_TYPE shall destroy the member values it created. ]*/
+    TEST_FUNCTION(AggregatedData_ToAGENT_DATA_TYPE_when_the_mean_fails_destroys_the_members_created_so_far)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+        const double values[] = { 1.0, 2.0 };
+        add_samples(&state, samples, values, sizeof(values) / sizeof(values[0]));
+
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT64(IGNORED_PTR_ARG, 2));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, 1.5))
+            .SetReturn(AGENT_DATA_TYPES_ERROR);
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+
+        ///act
+        AGENT_DATA_TYPES_RESULT result = AggregatedData_ToAGENT_DATA_TYPE(TEST_DESTINATION, &state, samples, TEST_WINDOW, test_toAgentDataType);
+
+        ///assert
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, g_nMembers);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_014: [ If any conversion fails, AggregatedData_ToAGENT_DATA_TYPE shall fail and return AGENT_DATA_TYPES_ERROR. ]*/
+    TEST_FUNCTION(AggregatedData_ToAGENT_DATA_TYPE_when_a_sample_conversion_fails_fails)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+        const double values[] = { 1.0 };
+        add_samples(&state, samples, values, sizeof(values) / sizeof(values[0]));
+        g_sampleConversionResult = AGENT_DATA_TYPES_ERROR;
+
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT64(IGNORED_PTR_ARG, 1));
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+
+        ///act
+        AGENT_DATA_TYPES_RESULT result = AggregatedData_ToAGENT_DATA_TYPE(TEST_DESTINATION, &state, samples, TEST_WINDOW, test_toAgentDataType);
+
+        ///assert
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, g_sampleConversions);
+    }
+
+    /*Tests_SRS_AGGREGATEDDATA_41_014: [ If any conversion fails, AggregatedData_ToAGENT_DATA_TYPE shall fail and return AGENT_DATA_TYPES_ERROR. ]*/
+    TEST_FUNCTION(AggregatedData_ToAGENT_DATA_TYPE_when_Create_AGENT_DATA_TYPE_from_Members_fails_fails)
+    {
+        ///arrange
+        AGGREGATED_DATA_STATE state = { 0, 0, 0 };
+        double samples[2 * TEST_WINDOW];
+
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT64(IGNORED_PTR_ARG, 0));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_Members(TEST_DESTINATION, AGGREGATED_DATA_TYPE_NAME, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(AGENT_DATA_TYPES_ERROR);
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+
+        ///act
+        AGENT_DATA_TYPES_RESULT result = AggregatedData_ToAGENT_DATA_TYPE(TEST_DESTINATION, &state, samples, TEST_WINDOW, test_toAgentDataType);
+
+        ///assert
+        ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+END_TEST_SUITE(AggregatedData_ut)
@@ -0,0 +1,385 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* s)
+{
+    free(s);
+}
+
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umock_c_negative_tests.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "cbordecoder.h"
+#include "testrunnerswitcher.h"
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+TEST_DEFINE_ENUM_TYPE(CBOR_DECODER_RESULT, CBOR_DECODER_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(CBOR_DECODER_RESULT, CBOR_DECODER_RESULT_VALUES);
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static void assert_cbor_decodes_to(const unsigned char* cbor, size_t cborSize, const char* expectedJson)
+{
+    char* json;
+
+    CBOR_DECODER_RESULT result = CBORDecoder_CBOR_To_JSON(cbor, cborSize, &json);
+
+    ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, expectedJson, json);
+
+    free(json);
+}
+
+static void assert_cbor_is_rejected(const unsigned char* cbor, size_t cborSize)
+{
+    char* json = NULL;
+
+    CBOR_DECODER_RESULT result = CBORDecoder_CBOR_To_JSON(cbor, cborSize, &json);
+
+    ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_PARSE_ERROR, result);
+    ASSERT_IS_NULL(json);
+}
+
+BEGIN_TEST_SUITE(CBORDecoder_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        (void)umock_c_init(on_umock_c_error);
+        (void)umocktypes_charptr_register_types();
+        (void)umocktypes_stdint_register_types();
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        umock_c_deinit();
+
+        TEST_MUTEX_DESTROY(g_testByTest);
+        TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest))
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_001: [ If cbor or json is NULL, or cborSize is 0, then CBORDecoder_CBOR_To_JSON shall return CBOR_DECODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_NULL_cbor_fails)
+    {
+        ///arrange
+        char* json;
+
+        ///act
+        CBOR_DECODER_RESULT result = CBORDecoder_CBOR_To_JSON(NULL, 1, &json);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_001: [ If cbor or json is NULL, or cborSize is 0, then CBORDecoder_CBOR_To_JSON shall return CBOR_DECODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_0_cborSize_fails)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0xA0 };
+        char* json;
+
+        ///act
+        CBOR_DECODER_RESULT result = CBORDecoder_CBOR_To_JSON(cbor, 0, &json);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_001: [ If cbor or json is NULL, or cborSize is 0, then CBORDecoder_CBOR_To_JSON shall return CBOR_DECODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_NULL_json_fails)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0xA0 };
+
+        ///act
+        CBOR_DECODER_RESULT result = CBORDecoder_CBOR_To_JSON(cbor, sizeof(cbor), NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_002: [ CBORDecoder_CBOR_To_JSON shall convert the CBOR data item in cbor to JSON text. ]*/
+    /*Tests_SRS_CBOR_DECODER_41_012: [ On success, CBORDecoder_CBOR_To_JSON shall return the null terminated JSON in *json and CBOR_DECODER_OK. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_an_empty_map_succeeds)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0xA0 };
+        char* json;
+
+        STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+
+        ///act
+        CBOR_DECODER_RESULT result = CBORDecoder_CBOR_To_JSON(cbor, sizeof(cbor), &json);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(char_ptr, "{}", json);
+
+        ///cleanup
+        free(json);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_003: [ Arrays shall be written as JSON arrays and maps as JSON objects; map keys that are not text strings shall be reported as CBOR_DECODER_PARSE_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_decodes_nested_maps_and_arrays)
+    {
+        ///arrange
+        /*{"a":{"b":[1,2]},"c":[]}*/
+        const unsigned char cbor[] = { 0xA2, 0x61, 'a', 0xA1, 0x61, 'b', 0x82, 0x01, 0x02, 0x61, 'c', 0x80 };
+
+        ///act & assert
+        assert_cbor_decodes_to(cbor, sizeof(cbor), "{\"a\":{\"b\":[1,2]},\"c\":[]}");
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_003: [ Arrays shall be written as JSON arrays and maps as JSON objects; map keys that are not text strings shall be reported as CBOR_DECODER_PARSE_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_a_map_key_that_is_not_text_fails)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0xA1, 0x01, 0x02 };
+
+        ///act & assert
+        assert_cbor_is_rejected(cbor, sizeof(cbor));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_004: [ Unsigned and negative integers shall be written as JSON numbers. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_decodes_integers)
+    {
+        ///arrange
+        const unsigned char smallest[] = { 0x00 };
+        const unsigned char oneByte[] = { 0x18, 0x64 };
+        const unsigned char eightBytes[] = { 0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+        const unsigned char minusOne[] = { 0x20 };
+        const unsigned char minus500[] = { 0x39, 0x01, 0xF3 };
+        const unsigned char mostNegative[] = { 0x3B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+        ///act & assert
+        assert_cbor_decodes_to(smallest, sizeof(smallest), "0");
+        assert_cbor_decodes_to(oneByte, sizeof(oneByte), "100");
+        assert_cbor_decodes_to(eightBytes, sizeof(eightBytes), "18446744073709551615");
+        assert_cbor_decodes_to(minusOne, sizeof(minusOne), "-1");
+        assert_cbor_decodes_to(minus500, sizeof(minus500), "-500");
+        assert_cbor_decodes_to(mostNegative, sizeof(mostNegative), "-18446744073709551616");
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_005: [ Text strings shall be written as JSON strings, escaping quotes, backslashes and control characters. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_escapes_text_strings)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0x67, 'a', '"', '\\', '\n', '\t', 0x01, 'z' };
+
+        ///act & assert
+        assert_cbor_decodes_to(cbor, sizeof(cbor), "\"a\\\"\\\\\\n\\t\\u0001z\"");
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_006: [ Byte strings shall be written as JSON strings holding their base64url encoding with padding, which is the form AgentDataTypes uses for EDM_BINARY. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_writes_byte_strings_as_base64url)
+    {
+        ///arrange
+        const unsigned char empty[] = { 0x40 };
+        const unsigned char one[] = { 0x41, 0xFB };
+        const unsigned char two[] = { 0x42, 0xFB, 0xFF };
+        const unsigned char three[] = { 0x43, 0xFB, 0xFF, 0xBF };
+
+        ///act & assert
+        assert_cbor_decodes_to(empty, sizeof(empty), "\"\"");
+        assert_cbor_decodes_to(one, sizeof(one), "\"-w==\"");
+        assert_cbor_decodes_to(two, sizeof(two), "\"-_8=\"");
+        assert_cbor_decodes_to(three, sizeof(three), "\"-_-_\"");
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_007: [ Floating point values shall be written with the fewest digits that read back to the same value; NaN and infinities shall be written as NaN, INF and -INF. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_decodes_floats)
+    {
+        ///arrange
+        const unsigned char half[] = { 0xF9, 0x3E, 0x00 };
+        const unsigned char halfInfinity[] = { 0xF9, 0x7C, 0x00 };
+        const unsigned char single[] = { 0xFA, 0x3D, 0xCC, 0xCC, 0xCD };
+        const unsigned char singleMinusInfinity[] = { 0xFA, 0xFF, 0x80, 0x00, 0x00 };
+        const unsigned char doubleValue[] = { 0xFB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A };
+        const unsigned char doubleNaN[] = { 0xFB, 0x7F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+        ///act & assert
+        assert_cbor_decodes_to(half, sizeof(half), "1.5");
+        assert_cbor_decodes_to(halfInfinity, sizeof(halfInfinity), "INF");
+        assert_cbor_decodes_to(single, sizeof(single), "0.1");
+        assert_cbor_decodes_to(singleMinusInfinity, sizeof(singleMinusInfinity), "-INF");
+        assert_cbor_decodes_to(doubleValue, sizeof(doubleValue), "0.1");
+        assert_cbor_decodes_to(doubleNaN, sizeof(doubleNaN), "NaN");
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_008: [ false, true, null and undefined shall be written as false, true, null and null. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_decodes_simple_values)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0x84, 0xF4, 0xF5, 0xF6, 0xF7 };
+
+        ///act & assert
+        assert_cbor_decodes_to(cbor, sizeof(cbor), "[false,true,null,null]");
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_009: [ Indefinite length items and reserved additional information values shall be reported as CBOR_DECODER_PARSE_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_an_indefinite_length_map_fails)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0xBF, 0xFF };
+
+        ///act & assert
+        assert_cbor_is_rejected(cbor, sizeof(cbor));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_009: [ Indefinite length items and reserved additional information values shall be reported as CBOR_DECODER_PARSE_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_a_reserved_additional_information_fails)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0x1C };
+
+        ///act & assert
+        assert_cbor_is_rejected(cbor, sizeof(cbor));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_009: [ Indefinite length items and reserved additional information values shall be reported as CBOR_DECODER_PARSE_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_truncated_input_fails)
+    {
+        ///arrange
+        const unsigned char truncatedHead[] = { 0x19, 0x01 };
+        const unsigned char truncatedString[] = { 0x65, 'a', 'b' };
+        const unsigned char truncatedMap[] = { 0xA2, 0x61, 'a', 0x01 };
+        const unsigned char hugeArray[] = { 0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+
+        ///act & assert
+        assert_cbor_is_rejected(truncatedHead, sizeof(truncatedHead));
+        assert_cbor_is_rejected(truncatedString, sizeof(truncatedString));
+        assert_cbor_is_rejected(truncatedMap, sizeof(truncatedMap));
+        assert_cbor_is_rejected(hugeArray, sizeof(hugeArray));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_009: [ Indefinite length items and reserved additional information values shall be reported as CBOR_DECODER_PARSE_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_items_nested_too_deep_fails)
+    {
+        ///arrange
+        unsigned char cbor[64];
+        (void)memset(cbor, 0x81, sizeof(cbor) - 1); /*arrays of one element*/
+        cbor[sizeof(cbor) - 1] = 0x00;
+
+        ///act & assert
+        assert_cbor_is_rejected(cbor, sizeof(cbor));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_010: [ A byte string of 16 bytes tagged 37 shall be written as a GUID in the EDM_GUID form; the tags of any other item shall be ignored. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_writes_a_tagged_uuid_as_a_guid)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0xD8, 0x25, 0x50,
+            0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF };
+
+        ///act & assert
+        assert_cbor_decodes_to(cbor, sizeof(cbor), "\"01234567-89AB-CDEF-0123-456789ABCDEF\"");
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_010: [ A byte string of 16 bytes tagged 37 shall be written as a GUID in the EDM_GUID form; the tags of any other item shall be ignored. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_ignores_other_tags)
+    {
+        ///arrange
+        /*0("2017-01-15T10:20:30Z")*/
+        const unsigned char cbor[] = { 0xC0, 0x74, '2', '0', '1', '7', '-', '0', '1', '-', '1', '5', 'T', '1', '0', ':', '2', '0', ':', '3', '0', 'Z' };
+
+        ///act & assert
+        assert_cbor_decodes_to(cbor, sizeof(cbor), "\"2017-01-15T10:20:30Z\"");
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_011: [ If bytes follow the data item, CBORDecoder_CBOR_To_JSON shall return CBOR_DECODER_PARSE_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_with_trailing_bytes_fails)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0xA0, 0x00 };
+
+        ///act & assert
+        assert_cbor_is_rejected(cbor, sizeof(cbor));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_013: [ If any failure occurs, CBORDecoder_CBOR_To_JSON shall free the JSON it produced so far and return the error. ]*/
+    TEST_FUNCTION(CBORDecoder_CBOR_To_JSON_when_growing_the_buffer_fails_then_fails)
+    {
+        ///arrange
+        const unsigned char cbor[] = { 0xA0 };
+        char* json = NULL;
+
+        STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+            .IgnoreArgument_size()
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+
+        ///act
+        CBOR_DECODER_RESULT result = CBORDecoder_CBOR_To_JSON(cbor, sizeof(cbor), &json);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_NULL(json);
+    }
+
+END_TEST_SUITE(CBORDecoder_ut)
@@ -0,0 +1,622 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* s)
+{
+    free(s);
+}
+
+#include "real_strings.h"
+
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umock_c_negative_tests.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/strings.h"
+#include "multitree.h"
+#include "agenttypesystem.h"
+#undef ENABLE_MOCKS
+
+#include "cborencoder.h"
+#include "testrunnerswitcher.h"
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+TEST_DEFINE_ENUM_TYPE(CBOR_ENCODER_RESULT, CBOR_ENCODER_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(CBOR_ENCODER_RESULT, CBOR_ENCODER_RESULT_VALUES);
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+/*a tree made of these nodes stands for the MULTITREE the DataMarshaller builds*/
+typedef struct TEST_NODE_TAG
+{
+    const char* name;
+    const AGENT_DATA_TYPE* value;
+    size_t childCount;
+    const struct TEST_NODE_TAG* children;
+} TEST_NODE;
+
+#define TEST_DATE_TIME_TEXT "2017-01-15T10:20:30Z"
+
+static MULTITREE_RESULT my_MultiTree_GetChildCount(MULTITREE_HANDLE treeHandle, size_t* count)
+{
+    *count = ((const TEST_NODE*)treeHandle)->childCount;
+    return MULTITREE_OK;
+}
+
+static MULTITREE_RESULT my_MultiTree_GetChild(MULTITREE_HANDLE treeHandle, size_t index, MULTITREE_HANDLE* childHandle)
+{
+    *childHandle = (MULTITREE_HANDLE)&((const TEST_NODE*)treeHandle)->children[index];
+    return MULTITREE_OK;
+}
+
+static MULTITREE_RESULT my_MultiTree_GetName(MULTITREE_HANDLE treeHandle, STRING_HANDLE destination)
+{
+    (void)real_STRING_concat(destination, ((const TEST_NODE*)treeHandle)->name);
+    return MULTITREE_OK;
+}
+
+static MULTITREE_RESULT my_MultiTree_GetValue(MULTITREE_HANDLE treeHandle, const void** destination)
+{
+    *destination = ((const TEST_NODE*)treeHandle)->value;
+    return MULTITREE_OK;
+}
+
+static AGENT_DATA_TYPES_RESULT my_AgentDataTypes_ToString(STRING_HANDLE destination, const AGENT_DATA_TYPE* value)
+{
+    (void)value;
+    (void)real_STRING_concat(destination, "\"" TEST_DATE_TIME_TEXT "\"");
+    return AGENT_DATA_TYPES_OK;
+}
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+/*encodes a tree with one leaf called "a" and checks the bytes*/
+static void assert_leaf_encodes_to(const AGENT_DATA_TYPE* value, const unsigned char* expectedValue, size_t expectedValueSize)
+{
+    TEST_NODE leaf = { "a", value, 0, NULL };
+    TEST_NODE root = { NULL, NULL, 1, &leaf };
+    unsigned char* destination;
+    size_t destinationSize;
+
+    CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer((MULTITREE_HANDLE)&root, &destination, &destinationSize);
+
+    ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 3 + expectedValueSize, destinationSize);
+    ASSERT_ARE_EQUAL(int, 0xA1, destination[0]); /*a map of 1*/
+    ASSERT_ARE_EQUAL(int, 0x61, destination[1]); /*a text string of 1*/
+    ASSERT_ARE_EQUAL(int, 'a', destination[2]);
+    ASSERT_IS_TRUE(memcmp(expectedValue, destination + 3, expectedValueSize) == 0);
+
+    free(destination);
+}
+
+BEGIN_TEST_SUITE(CBOREncoder_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        (void)umock_c_init(on_umock_c_error);
+        (void)umocktypes_charptr_register_types();
+        (void)umocktypes_stdint_register_types();
+
+        REGISTER_UMOCK_ALIAS_TYPE(MULTITREE_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(MULTITREE_RESULT, int);
+        REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(AGENT_DATA_TYPES_RESULT, int);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+        REGISTER_GLOBAL_MOCK_HOOK(STRING_new, real_STRING_new);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_new, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, real_STRING_delete);
+        REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, real_STRING_c_str);
+        REGISTER_GLOBAL_MOCK_HOOK(STRING_length, real_STRING_length);
+        REGISTER_GLOBAL_MOCK_HOOK(STRING_empty, real_STRING_empty);
+
+        REGISTER_GLOBAL_MOCK_HOOK(MultiTree_GetChildCount, my_MultiTree_GetChildCount);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(MultiTree_GetChildCount, MULTITREE_ERROR);
+        REGISTER_GLOBAL_MOCK_HOOK(MultiTree_GetChild, my_MultiTree_GetChild);
+        REGISTER_GLOBAL_MOCK_HOOK(MultiTree_GetName, my_MultiTree_GetName);
+        REGISTER_GLOBAL_MOCK_HOOK(MultiTree_GetValue, my_MultiTree_GetValue);
+
+        REGISTER_GLOBAL_MOCK_HOOK(AgentDataTypes_ToString, my_AgentDataTypes_ToString);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(AgentDataTypes_ToString, AGENT_DATA_TYPES_ERROR);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        umock_c_deinit();
+
+        TEST_MUTEX_DESTROY(g_testByTest);
+        TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest))
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_001: [ If any of the arguments passed to CBOREncoder_EncodeTree_ToBuffer is NULL then CBOR_ENCODER_INVALID_ARG shall be returned. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_with_NULL_treeHandle_fails)
+    {
+        ///arrange
+        unsigned char* destination;
+        size_t destinationSize;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer(NULL, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_001: [ If any of the arguments passed to CBOREncoder_EncodeTree_ToBuffer is NULL then CBOR_ENCODER_INVALID_ARG shall be returned. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_with_NULL_destination_fails)
+    {
+        ///arrange
+        TEST_NODE root = { NULL, NULL, 0, NULL };
+        size_t destinationSize;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer((MULTITREE_HANDLE)&root, NULL, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_001: [ If any of the arguments passed to CBOREncoder_EncodeTree_ToBuffer is NULL then CBOR_ENCODER_INVALID_ARG shall be returned. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_with_NULL_destinationSize_fails)
+    {
+        ///arrange
+        TEST_NODE root = { NULL, NULL, 0, NULL };
+        unsigned char* destination;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer((MULTITREE_HANDLE)&root, &destination, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_002: [ CBOREncoder_EncodeTree_ToBuffer shall encode the tree as a single CBOR data item with the same structure as the JSON produced by JSONEncoder_EncodeTree. ]*/
+    /*Tests_SRS_CBOR_ENCODER_41_004: [ On success, CBOREncoder_EncodeTree_ToBuffer shall hand the output buffer to the caller in *destination and its length in *destinationSize, and return CBOR_ENCODER_OK. ]*/
+    /*Tests_SRS_CBOR_ENCODER_41_005: [ Every node of the tree shall be encoded as a map from the names of its children to their encoding. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_with_one_leaf_succeeds)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        TEST_NODE leaf = { "a", &value, 0, NULL };
+        TEST_NODE root = { NULL, NULL, 1, &leaf };
+        unsigned char* destination;
+        size_t destinationSize;
+        const unsigned char expected[] = { 0xA1, 0x61, 'a', 0x01 };
+        value.type = EDM_INT32_TYPE;
+        value.value.edmInt32.value = 1;
+
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(MultiTree_GetChildCount((MULTITREE_HANDLE)&root, IGNORED_PTR_ARG))
+            .IgnoreArgument_count();
+        STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MultiTree_GetChild((MULTITREE_HANDLE)&root, 0, IGNORED_PTR_ARG))
+            .IgnoreArgument_childHandle();
+        STRICT_EXPECTED_CALL(STRING_empty(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(MultiTree_GetName((MULTITREE_HANDLE)&leaf, IGNORED_PTR_ARG))
+            .IgnoreArgument_destination();
+        STRICT_EXPECTED_CALL(MultiTree_GetChildCount((MULTITREE_HANDLE)&leaf, IGNORED_PTR_ARG))
+            .IgnoreArgument_count();
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(MultiTree_GetValue((MULTITREE_HANDLE)&leaf, IGNORED_PTR_ARG))
+            .IgnoreArgument_destination();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer((MULTITREE_HANDLE)&root, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, sizeof(expected), destinationSize);
+        ASSERT_IS_TRUE(memcmp(expected, destination, destinationSize) == 0);
+
+        ///cleanup
+        free(destination);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_005: [ Every node of the tree shall be encoded as a map from the names of its children to their encoding. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_with_a_nested_node_succeeds)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        TEST_NODE leaves[] = { { "x", &value, 0, NULL }, { "y", &value, 0, NULL } };
+        TEST_NODE inner = { "in", NULL, 2, leaves };
+        TEST_NODE root = { NULL, NULL, 1, &inner };
+        unsigned char* destination;
+        size_t destinationSize;
+        const unsigned char expected[] = { 0xA1, 0x62, 'i', 'n', 0xA2, 0x61, 'x', 0xF6, 0x61, 'y', 0xF6 };
+        value.type = EDM_NULL_TYPE;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer((MULTITREE_HANDLE)&root, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, result);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expected), destinationSize);
+        ASSERT_IS_TRUE(memcmp(expected, destination, destinationSize) == 0);
+
+        ///cleanup
+        free(destination);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_006: [ Integers, lengths, counts and tags shall be written in the shortest form RFC 7049 allows. ]*/
+    /*Tests_SRS_CBOR_ENCODER_41_009: [ EDM_BYTE_TYPE, EDM_SBYTE_TYPE, EDM_INT16_TYPE, EDM_INT32_TYPE and EDM_INT64_TYPE shall be encoded as integers. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_encodes_integers_in_the_shortest_form)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        const unsigned char expected23[] = { 0x17 };
+        const unsigned char expected24[] = { 0x18, 0x18 };
+        const unsigned char expectedMinus1[] = { 0x20 };
+        const unsigned char expectedMinus500[] = { 0x39, 0x01, 0xF3 };
+        const unsigned char expected70000[] = { 0x1A, 0x00, 0x01, 0x11, 0x70 };
+        const unsigned char expectedInt64Min[] = { 0x3B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+        ///act & assert
+        value.type = EDM_BYTE_TYPE;
+        value.value.edmByte.value = 23;
+        assert_leaf_encodes_to(&value, expected23, sizeof(expected23));
+
+        value.type = EDM_INT16_TYPE;
+        value.value.edmInt16.value = 24;
+        assert_leaf_encodes_to(&value, expected24, sizeof(expected24));
+
+        value.type = EDM_SBYTE_TYPE;
+        value.value.edmSbyte.value = -1;
+        assert_leaf_encodes_to(&value, expectedMinus1, sizeof(expectedMinus1));
+
+        value.type = EDM_INT32_TYPE;
+        value.value.edmInt32.value = -500;
+        assert_leaf_encodes_to(&value, expectedMinus500, sizeof(expectedMinus500));
+
+        value.type = EDM_INT32_TYPE;
+        value.value.edmInt32.value = 70000;
+        assert_leaf_encodes_to(&value, expected70000, sizeof(expected70000));
+
+        value.type = EDM_INT64_TYPE;
+        value.value.edmInt64.value = INT64_MIN;
+        assert_leaf_encodes_to(&value, expectedInt64Min, sizeof(expectedInt64Min));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_008: [ EDM_BOOLEAN_TYPE shall be encoded as true or false. ]*/
+    /*Tests_SRS_CBOR_ENCODER_41_014: [ EDM_NULL_TYPE shall be encoded as null. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_encodes_booleans_and_null)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        const unsigned char expectedTrue[] = { 0xF5 };
+        const unsigned char expectedFalse[] = { 0xF4 };
+        const unsigned char expectedNull[] = { 0xF6 };
+
+        ///act & assert
+        value.type = EDM_BOOLEAN_TYPE;
+        value.value.edmBoolean.value = EDM_TRUE;
+        assert_leaf_encodes_to(&value, expectedTrue, sizeof(expectedTrue));
+
+        value.value.edmBoolean.value = EDM_FALSE;
+        assert_leaf_encodes_to(&value, expectedFalse, sizeof(expectedFalse));
+
+        value.type = EDM_NULL_TYPE;
+        assert_leaf_encodes_to(&value, expectedNull, sizeof(expectedNull));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_010: [ EDM_SINGLE_TYPE shall be encoded as a single precision float and EDM_DOUBLE_TYPE as a double precision float. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_encodes_floats)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        const unsigned char expectedSingle[] = { 0xFA, 0x3F, 0xC0, 0x00, 0x00 };
+        const unsigned char expectedDouble[] = { 0xFB, 0xC0, 0x45, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+        ///act & assert
+        value.type = EDM_SINGLE_TYPE;
+        value.value.edmSingle.value = 1.5f;
+        assert_leaf_encodes_to(&value, expectedSingle, sizeof(expectedSingle));
+
+        value.type = EDM_DOUBLE_TYPE;
+        value.value.edmDouble.value = -42.0;
+        assert_leaf_encodes_to(&value, expectedDouble, sizeof(expectedDouble));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_011: [ EDM_STRING_TYPE and EDM_STRING_NO_QUOTES_TYPE shall be encoded as text strings. ]*/
+    /*Tests_SRS_CBOR_ENCODER_41_012: [ EDM_BINARY_TYPE shall be encoded as a byte string. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_encodes_strings_and_binary)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        char text[] = "hi\"";
+        unsigned char bytes[] = { 0x00, 0xFF };
+        const unsigned char expectedText[] = { 0x63, 'h', 'i', '"' };
+        const unsigned char expectedBytes[] = { 0x42, 0x00, 0xFF };
+
+        ///act & assert
+        value.type = EDM_STRING_TYPE;
+        value.value.edmString.chars = text;
+        value.value.edmString.length = sizeof(text) - 1;
+        assert_leaf_encodes_to(&value, expectedText, sizeof(expectedText));
+
+        value.type = EDM_STRING_NO_QUOTES_TYPE;
+        value.value.edmStringNoQuotes.chars = text;
+        value.value.edmStringNoQuotes.length = sizeof(text) - 1;
+        assert_leaf_encodes_to(&value, expectedText, sizeof(expectedText));
+
+        value.type = EDM_BINARY_TYPE;
+        value.value.edmBinary.data = bytes;
+        value.value.edmBinary.size = sizeof(bytes);
+        assert_leaf_encodes_to(&value, expectedBytes, sizeof(expectedBytes));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_013: [ EDM_GUID_TYPE shall be encoded as a 16 bytes byte string tagged 37. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_encodes_a_guid_as_a_tagged_byte_string)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        unsigned char expected[3 + 16] = { 0xD8, 0x25, 0x50 };
+        size_t i;
+        value.type = EDM_GUID_TYPE;
+        for (i = 0; i < 16; i++)
+        {
+            value.value.edmGuid.GUID[i] = (uint8_t)(0xF0 + i);
+            expected[3 + i] = (unsigned char)(0xF0 + i);
+        }
+
+        ///act & assert
+        assert_leaf_encodes_to(&value, expected, sizeof(expected));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_015: [ EDM_COMPLEX_TYPE_TYPE shall be encoded as a map from the names of the fields to their values. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_encodes_a_complex_type_as_a_map)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        AGENT_DATA_TYPE x;
+        AGENT_DATA_TYPE y;
+        COMPLEX_TYPE_FIELD_TYPE fields[2];
+        const unsigned char expected[] = { 0xA2, 0x61, 'x', 0x01, 0x61, 'y', 0xF5 };
+        x.type = EDM_INT32_TYPE;
+        x.value.edmInt32.value = 1;
+        y.type = EDM_BOOLEAN_TYPE;
+        y.value.edmBoolean.value = EDM_TRUE;
+        fields[0].fieldName = "x";
+        fields[0].value = &x;
+        fields[1].fieldName = "y";
+        fields[1].value = &y;
+        value.type = EDM_COMPLEX_TYPE_TYPE;
+        value.value.edmComplexType.nMembers = 2;
+        value.value.edmComplexType.fields = fields;
+
+        ///act & assert
+        assert_leaf_encodes_to(&value, expected, sizeof(expected));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_019: [ EDM_ARRAY_TYPE shall be encoded as an array of its values, each encoded as a value of its element type. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_encodes_an_array_as_an_array)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        int16_t integers[] = { 1, -1, 500 };
+        float floats[] = { 1.5f };
+        const unsigned char expectedIntegers[] = { 0x83, 0x01, 0x20, 0x19, 0x01, 0xF4 };
+        const unsigned char expectedFloats[] = { 0x81, 0xFA, 0x3F, 0xC0, 0x00, 0x00 };
+        const unsigned char expectedEmpty[] = { 0x80 };
+
+        ///act & assert
+        value.type = EDM_ARRAY_TYPE;
+        value.value.edmArray.elementType = EDM_INT16_TYPE;
+        value.value.edmArray.elementSize = sizeof(int16_t);
+        value.value.edmArray.count = 3;
+        value.value.edmArray.values = integers;
+        assert_leaf_encodes_to(&value, expectedIntegers, sizeof(expectedIntegers));
+
+        value.value.edmArray.elementType = EDM_SINGLE_TYPE;
+        value.value.edmArray.elementSize = sizeof(float);
+        value.value.edmArray.count = 1;
+        value.value.edmArray.values = floats;
+        assert_leaf_encodes_to(&value, expectedFloats, sizeof(expectedFloats));
+
+        value.value.edmArray.count = 0;
+        value.value.edmArray.values = NULL;
+        assert_leaf_encodes_to(&value, expectedEmpty, sizeof(expectedEmpty));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_016: [ EDM_DATE_TIME_OFFSET_TYPE shall be encoded as the text AgentDataTypes_ToString produces, tagged 0. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_encodes_a_date_time_offset_as_tagged_text)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        unsigned char expected[2 + sizeof(TEST_DATE_TIME_TEXT) - 1] = { 0xC0, 0x60 + (sizeof(TEST_DATE_TIME_TEXT) - 1) };
+        (void)memcpy(expected + 2, TEST_DATE_TIME_TEXT, sizeof(TEST_DATE_TIME_TEXT) - 1);
+        value.type = EDM_DATE_TIME_OFFSET_TYPE;
+
+        ///act & assert
+        assert_leaf_encodes_to(&value, expected, sizeof(expected));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_017: [ Values of any other type shall be encoded as the text AgentDataTypes_ToString produces, without enclosing quotes. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_encodes_other_types_as_text)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        unsigned char expected[1 + sizeof(TEST_DATE_TIME_TEXT) - 1] = { 0x60 + (sizeof(TEST_DATE_TIME_TEXT) - 1) };
+        (void)memcpy(expected + 1, TEST_DATE_TIME_TEXT, sizeof(TEST_DATE_TIME_TEXT) - 1);
+        value.type = EDM_DATE_TYPE;
+
+        ///act & assert
+        assert_leaf_encodes_to(&value, expected, sizeof(expected));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_003: [ The output buffer shall grow by doubling its capacity. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_grows_the_buffer_for_long_values)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        char text[300];
+        unsigned char expected[3 + sizeof(text)] = { 0x79, 0x01, 0x2C };
+        (void)memset(text, 'z', sizeof(text));
+        (void)memcpy(expected + 3, text, sizeof(text));
+        value.type = EDM_STRING_TYPE;
+        value.value.edmString.chars = text;
+        value.value.edmString.length = sizeof(text);
+
+        ///act & assert
+        assert_leaf_encodes_to(&value, expected, sizeof(expected));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_018: [ If any failure occurs, CBOREncoder_EncodeTree_ToBuffer shall free the output buffer and return the error. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_when_MultiTree_GetChildCount_fails_then_fails)
+    {
+        ///arrange
+        TEST_NODE root = { NULL, NULL, 0, NULL };
+        unsigned char* destination;
+        size_t destinationSize;
+
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(MultiTree_GetChildCount((MULTITREE_HANDLE)&root, IGNORED_PTR_ARG))
+            .IgnoreArgument_count()
+            .SetReturn(MULTITREE_ERROR);
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer((MULTITREE_HANDLE)&root, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_MULTITREE_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_018: [ If any failure occurs, CBOREncoder_EncodeTree_ToBuffer shall free the output buffer and return the error. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_when_STRING_new_fails_then_fails)
+    {
+        ///arrange
+        TEST_NODE root = { NULL, NULL, 0, NULL };
+        unsigned char* destination;
+        size_t destinationSize;
+
+        STRICT_EXPECTED_CALL(STRING_new())
+            .SetReturn(NULL);
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer((MULTITREE_HANDLE)&root, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_018: [ If any failure occurs, CBOREncoder_EncodeTree_ToBuffer shall free the output buffer and return the error. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_when_growing_the_buffer_fails_then_fails)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        TEST_NODE leaf = { "a", &value, 0, NULL };
+        TEST_NODE root = { NULL, NULL, 1, &leaf };
+        unsigned char* destination;
+        size_t destinationSize;
+        value.type = EDM_NULL_TYPE;
+
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(MultiTree_GetChildCount((MULTITREE_HANDLE)&root, IGNORED_PTR_ARG))
+            .IgnoreArgument_count();
+        STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+            .IgnoreArgument_size()
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer((MULTITREE_HANDLE)&root, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_018: [ If any failure occurs, CBOREncoder_EncodeTree_ToBuffer shall free the output buffer and return the error. ]*/
+    TEST_FUNCTION(CBOREncoder_EncodeTree_ToBuffer_when_AgentDataTypes_ToString_fails_then_fails)
+    {
+        ///arrange
+        AGENT_DATA_TYPE value;
+        TEST_NODE leaf = { "a", &value, 0, NULL };
+        TEST_NODE root = { NULL, NULL, 1, &leaf };
+        unsigned char* destination;
+        size_t destinationSize;
+        value.type = EDM_DATE_TYPE;
+
+        STRICT_EXPECTED_CALL(AgentDataTypes_ToString(IGNORED_PTR_ARG, &value))
+            .IgnoreArgument_destination()
+            .SetReturn(AGENT_DATA_TYPES_ERROR);
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_EncodeTree_ToBuffer((MULTITREE_HANDLE)&root, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_ERROR, result);
+    }
+
+END_TEST_SUITE(CBOREncoder_ut)
@@ -463,6 +463,13 @@ static AGENT_DATA_TYPES_RESULT my_Create_AGENT_DATA_TYPE_from_DOUBLE(AGENT_DATA_
     return AGENT_DATA_TYPES_OK;
 }
 
+static const char* my_AgentDataTypes_ToString_text = "5.5";
+static AGENT_DATA_TYPES_RESULT my_AgentDataTypes_ToString(STRING_HANDLE destination, const AGENT_DATA_TYPE* value)
+{
+    (void)value;
+    return (real_STRING_concat(destination, my_AgentDataTypes_ToString_text) == 0) ? AGENT_DATA_TYPES_OK : AGENT_DATA_TYPES_ERROR;
+}
+
 static DEVICE_RESULT my_Device_PublishTransacted(TRANSACTION_HANDLE transactionHandle, const char* propertyName, const AGENT_DATA_TYPE* data)
 {
     (void)transactionHandle;
@@ -853,6 +860,8 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(Device_CreateTransaction_ReportedProperties, NULL);
 
         REGISTER_GLOBAL_MOCK_RETURNS(Device_PublishTransacted_ReportedProperty,DEVICE_OK, DEVICE_ERROR);
+        REGISTER_GLOBAL_MOCK_HOOK(AgentDataTypes_ToString, my_AgentDataTypes_ToString);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(AgentDataTypes_ToString, AGENT_DATA_TYPES_ERROR);
 
         REGISTER_GLOBAL_MOCK_RETURNS(Device_CommitTransaction_ReportedProperties, DEVICE_OK, DEVICE_ERROR);
         REGISTER_GLOBAL_MOCK_RETURNS(Device_ExecuteMethod, g_MethodReturn, NULL);
@@ -999,6 +1008,7 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
     }
 
     /*Tests_CODEFIRST_002:[ CodeFirst_RegisterSchema shall create the schema information and give it to the Schema module for one schema, identified by the metadata argument. On success, it shall return a handle to the model.]*/
+    /*Tests_SRS_CODEFIRST_41_017: [ CodeFirst_Init shall create the lock that guards the list of devices. If that fails, CodeFirst_Init shall fail and return CODEFIRST_ERROR. ]*/
     TEST_FUNCTION(CodeFirst_Init_succeds)
     {
         
@@ -1946,6 +1956,66 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         CodeFirst_Deinit();
     }
 
+    /*Tests_SRS_CODEFIRST_41_030: [ CodeFirst_CreateDevice shall walk the schema of model for its desired properties only when no other device of model exists, the devices of a model shall share the result. ]*/
+    TEST_FUNCTION(CodeFirst_CreateDevice_second_device_of_a_model_does_not_walk_the_schema_again)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        void* device1 = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, 1, false);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Device_Create(TEST_MODEL_HANDLE, CodeFirst_InvokeAction, TEST_CALLBACK_CONTEXT, CodeFirst_InvokeMethod, TEST_CALLBACK_CONTEXT, false, IGNORED_PTR_ARG))
+            .IgnoreArgument_deviceHandle()
+            .IgnoreArgument_methodCallbackContext()
+            .IgnoreArgument_callbackUserContext();
+        STRICT_EXPECTED_CALL(Schema_AddDeviceRef(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        // act
+        void* device2 = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, 1, false);
+
+        // assert
+        ASSERT_IS_NOT_NULL(device2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device2);
+        CodeFirst_DestroyDevice(device1);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_030: [ CodeFirst_CreateDevice shall walk the schema of model for its desired properties only when no other device of model exists, the devices of a model shall share the result. ]*/
+    TEST_FUNCTION(CodeFirst_CreateDevice_after_the_last_device_of_a_model_is_destroyed_walks_the_schema_again)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        size_t zero = 0;
+        CodeFirst_DestroyDevice(CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, 1, false));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelDesiredPropertyCount(TEST_MODEL_HANDLE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_desiredPropertyCount(&zero, sizeof(zero));
+        STRICT_EXPECTED_CALL(Schema_GetModelModelCount(TEST_MODEL_HANDLE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_modelCount(&zero, sizeof(zero));
+        STRICT_EXPECTED_CALL(Device_Create(TEST_MODEL_HANDLE, CodeFirst_InvokeAction, TEST_CALLBACK_CONTEXT, CodeFirst_InvokeMethod, TEST_CALLBACK_CONTEXT, false, IGNORED_PTR_ARG))
+            .IgnoreArgument_deviceHandle()
+            .IgnoreArgument_methodCallbackContext()
+            .IgnoreArgument_callbackUserContext();
+        STRICT_EXPECTED_CALL(Schema_AddDeviceRef(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        // act
+        void* result = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, 1, false);
+
+        // assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(result);
+        CodeFirst_Deinit();
+    }
+
     /* Tests_SRS_CODEFIRST_99_084:[If Device_Create fails, CodeFirst_CreateDevice shall return NULL.] */
     TEST_FUNCTION(When_Device_Create_Fails_Then_CodeFirst_CreateDevice_Fails)
     {
@@ -2006,10 +2076,6 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, 1, false);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Schema_GetModelDesiredPropertyCount(TEST_MODEL_HANDLE, IGNORED_PTR_ARG))
-            .IgnoreArgument_desiredPropertyCount(); /*0 desired properties*/
-        STRICT_EXPECTED_CALL(Schema_GetModelModelCount(TEST_MODEL_HANDLE, IGNORED_PTR_ARG))
-            .IgnoreArgument_modelCount(); /*0 model in model*/
         STRICT_EXPECTED_CALL(Schema_ReleaseDeviceRef(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(Schema_DestroyIfUnused(IGNORED_PTR_ARG))
@@ -2159,10 +2225,447 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         size_t destinationSize;
 
         // act
-        CODEFIRST_RESULT result = CodeFirst_SendAsync(&destination, &destinationSize, 2, &device->this_is_double_Property, &device->this_is_int_Property);
+        CODEFIRST_RESULT result = CodeFirst_SendAsync(&destination, &destinationSize, 2, &device->this_is_double_Property, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_001: [ CodeFirst_SetDirectSerialization shall set whether CodeFirst_SendAsync serializes top level properties directly to the output buffer. ]*/
+    /* Tests_SRS_CODEFIRST_41_002: [ When direct serialization is on and all the values are top level numeric or boolean properties of the same device, CodeFirst_SendAsync shall write the JSON straight to a buffer sized from the reflected metadata, without calling the Device module. ]*/
+    /* Tests_SRS_CODEFIRST_41_003: [ The JSON shall be the same the Device module produces for the same values. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsync_with_direct_serialization_2_Properties_Succeeds)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char* destination;
+        size_t destinationSize;
+        const char expectedJson[] = "{\"this_is_double_Property\":42.000000000000000, \"this_is_int_Property\":-1}";
+        CodeFirst_SetDirectSerialization(true);
+        device->this_is_double_Property = 42.0;
+        device->this_is_int_Property = -1;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsync(&destination, &destinationSize, 2, &device->this_is_double_Property, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedJson) - 1, destinationSize);
+        ASSERT_IS_TRUE(memcmp(expectedJson, destination, destinationSize) == 0);
+
+        // cleanup
+        free(destination);
+        CodeFirst_SetDirectSerialization(false);
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_003: [ The JSON shall be the same the Device module produces for the same values. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsync_with_direct_serialization_keeps_a_property_passed_twice_once)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char* destination;
+        size_t destinationSize;
+        const char expectedJson[] = "{\"this_is_int_Property\":1}";
+        CodeFirst_SetDirectSerialization(true);
+        device->this_is_int_Property = 1;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsync(&destination, &destinationSize, 2, &device->this_is_int_Property, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedJson) - 1, destinationSize);
+        ASSERT_IS_TRUE(memcmp(expectedJson, destination, destinationSize) == 0);
+
+        // cleanup
+        free(destination);
+        CodeFirst_SetDirectSerialization(false);
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_004: [ Otherwise CodeFirst_SendAsync shall send the values through the Device module. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsync_with_direct_serialization_and_a_value_outside_any_device_Fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char* destination;
+        size_t destinationSize;
+        int notInADevice = 0;
+        CodeFirst_SetDirectSerialization(true);
+        umock_c_reset_all_calls();
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsync(&destination, &destinationSize, 1, &notInADevice);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_SetDirectSerialization(false);
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_007: [ CodeFirst_SetCBOREncoding shall set whether the data sent by CodeFirst_SendAsync is encoded as CBOR; the direct serialization path shall not be used while it is set, since it only writes JSON. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsync_with_direct_serialization_and_CBOR_encoding_goes_through_the_Device_module)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char* destination;
+        size_t destinationSize;
+        CodeFirst_SetDirectSerialization(true);
+        CodeFirst_SetCBOREncoding(true);
+        device->this_is_int_Property = 1;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Device_StartTransaction(TEST_DEVICE_HANDLE));
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .IgnoreArgument_s2();
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, 0));
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(Device_PublishTransacted(IGNORED_PTR_ARG, "this_is_int_Property", IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Device_EndTransaction(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsync(&destination, &destinationSize, 1, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_SetCBOREncoding(false);
+        CodeFirst_SetDirectSerialization(false);
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    static unsigned char* g_handOffDestination;
+    static size_t g_handOffDestinationSize;
+    static int g_handOffResult;
+
+    static int testHandOff(void* handOffContext, unsigned char* destination, size_t destinationSize)
+    {
+        *(int*)handOffContext += 1;
+        g_handOffDestination = destination;
+        g_handOffDestinationSize = destinationSize;
+        return g_handOffResult;
+    }
+
+    /* Tests_SRS_CODEFIRST_41_031: [ If handOff is NULL or numProperties is 0, CodeFirst_SendAsyncHandOff shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncHandOff_with_NULL_handOff_fails)
+    {
+        // arrange
+        int dummy = 0;
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncHandOff(NULL, NULL, 1, &dummy);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_CODEFIRST_41_031: [ If handOff is NULL or numProperties is 0, CodeFirst_SendAsyncHandOff shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncHandOff_with_0_properties_fails)
+    {
+        // arrange
+        int handOffCount = 0;
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncHandOff(testHandOff, &handOffCount, 0);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(int, 0, handOffCount);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_CODEFIRST_41_032: [ CodeFirst_SendAsyncHandOff shall serialize the values as CodeFirst_SendAsync does. ]*/
+    /* Tests_SRS_CODEFIRST_41_033: [ CodeFirst_SendAsyncHandOff shall pass the serialized bytes, without copying them, to handOff, which takes them over when it returns 0. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncHandOff_hands_the_serialized_bytes_off)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        int handOffCount = 0;
+        const char expectedJson[] = "{\"this_is_int_Property\":1}";
+        CodeFirst_SetDirectSerialization(true);
+        device->this_is_int_Property = 1;
+        g_handOffResult = 0;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncHandOff(testHandOff, &handOffCount, 1, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 1, handOffCount);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedJson) - 1, g_handOffDestinationSize);
+        ASSERT_IS_TRUE(memcmp(expectedJson, g_handOffDestination, g_handOffDestinationSize) == 0);
+
+        // cleanup
+        free(g_handOffDestination);
+        CodeFirst_SetDirectSerialization(false);
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_034: [ If handOff returns a non-zero value, CodeFirst_SendAsyncHandOff shall free the serialized bytes and return CODEFIRST_ERROR. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncHandOff_frees_the_serialized_bytes_when_the_hand_off_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        int handOffCount = 0;
+        CodeFirst_SetDirectSerialization(true);
+        device->this_is_int_Property = 1;
+        g_handOffResult = __LINE__;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncHandOff(testHandOff, &handOffCount, 1, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 1, handOffCount);
+
+        // cleanup
+        g_handOffResult = 0;
+        CodeFirst_SetDirectSerialization(false);
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_022: [ If destination, destinationSize or instances is NULL, or instanceCount or numProperties is 0, CodeFirst_SendAsyncBatch shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncBatch_with_NULL_instances_fails)
+    {
+        // arrange
+        unsigned char* destination;
+        size_t destinationSize;
+        int notInADevice = 0;
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncBatch(&destination, &destinationSize, NULL, 1, 1, &notInADevice);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_CODEFIRST_41_022: [ If destination, destinationSize or instances is NULL, or instanceCount or numProperties is 0, CodeFirst_SendAsyncBatch shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncBatch_with_0_instanceCount_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        SimpleDevice_Model* instances[1] = { device };
+        unsigned char* destination;
+        size_t destinationSize;
+        umock_c_reset_all_calls();
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncBatch(&destination, &destinationSize, (void* const*)instances, 0, 1, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    static void SendAsyncBatch_2_instances_inert_path(unsigned char** elements, size_t* elementSizes)
+    {
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .IgnoreArgument_s2();
+        for (size_t i = 0; i < 2; i++)
+        {
+            STRICT_EXPECTED_CALL(Device_StartTransaction(TEST_DEVICE_HANDLE));
+            EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, 0));
+            STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+                .IgnoreArgument_handle();
+            STRICT_EXPECTED_CALL(Device_PublishTransacted(IGNORED_PTR_ARG, "this_is_int_Property", IGNORED_PTR_ARG))
+                .IgnoreArgument_transactionHandle()
+                .IgnoreArgument(3);
+            EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(Device_EndTransaction(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .IgnoreArgument_transactionHandle()
+                .CopyOutArgumentBuffer_destination(&elements[i], sizeof(elements[i]))
+                .CopyOutArgumentBuffer_destinationSize(&elementSizes[i], sizeof(elementSizes[i]));
+        }
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+    }
+
+    static unsigned char* CreateBatchElement(const char* json)
+    {
+        unsigned char* result = (unsigned char*)my_gballoc_malloc(strlen(json));
+        (void)memcpy(result, json, strlen(json));
+        return result;
+    }
+
+    /* Tests_SRS_CODEFIRST_41_025: [ CodeFirst_SendAsyncBatch shall look up the property and build the path of every field only once, for the first instance. ]*/
+    /* Tests_SRS_CODEFIRST_41_026: [ Every instance shall be serialized by its own Device transaction, publishing the value at the offset of each field with the path of that field. ]*/
+    /* Tests_SRS_CODEFIRST_41_027: [ CodeFirst_SendAsyncBatch shall append the serialization of every instance, in order, to one output buffer holding an array: a JSON array, or a CBOR array when CBOR encoding is set. ]*/
+    /* Tests_SRS_CODEFIRST_41_028: [ On success CodeFirst_SendAsyncBatch shall give the buffer to the caller through destination and destinationSize and return CODEFIRST_OK; on failure it shall free it. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncBatch_2_instances_succeeds)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* instances[2];
+        unsigned char* elements[2];
+        size_t elementSizes[2] = { 7, 8 };
+        unsigned char* destination;
+        size_t destinationSize;
+        const char expectedJson[] = "[{\"a\":1}, {\"a\":22}]";
+        instances[0] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        instances[1] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        elements[0] = CreateBatchElement("{\"a\":1}");
+        elements[1] = CreateBatchElement("{\"a\":22}");
+        umock_c_reset_all_calls();
+
+        SendAsyncBatch_2_instances_inert_path(elements, elementSizes);
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncBatch(&destination, &destinationSize, (void* const*)instances, 2, 1, &instances[0]->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedJson) - 1, destinationSize);
+        ASSERT_IS_TRUE(memcmp(expectedJson, destination, destinationSize) == 0);
+
+        // cleanup
+        free(destination);
+        CodeFirst_DestroyDevice(instances[0]);
+        CodeFirst_DestroyDevice(instances[1]);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_027: [ CodeFirst_SendAsyncBatch shall append the serialization of every instance, in order, to one output buffer holding an array: a JSON array, or a CBOR array when CBOR encoding is set. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncBatch_with_CBOR_encoding_produces_a_CBOR_array)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* instances[2];
+        unsigned char* elements[2];
+        size_t elementSizes[2] = { 2, 3 };
+        unsigned char* destination;
+        size_t destinationSize;
+        const unsigned char expectedCbor[] = { 0x82, 0xA1, 0x01, 0xA1, 0x02, 0x03 };
+        instances[0] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        instances[1] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        elements[0] = CreateBatchElement("\xA1\x01");
+        elements[1] = CreateBatchElement("\xA1\x02\x03");
+        CodeFirst_SetCBOREncoding(true);
+        umock_c_reset_all_calls();
+
+        SendAsyncBatch_2_instances_inert_path(elements, elementSizes);
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncBatch(&destination, &destinationSize, (void* const*)instances, 2, 1, &instances[0]->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedCbor), destinationSize);
+        ASSERT_IS_TRUE(memcmp(expectedCbor, destination, destinationSize) == 0);
+
+        // cleanup
+        free(destination);
+        CodeFirst_SetCBOREncoding(false);
+        CodeFirst_DestroyDevice(instances[0]);
+        CodeFirst_DestroyDevice(instances[1]);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_024: [ The fields shall be pointers into the first instance; if one is not, CodeFirst_SendAsyncBatch shall return CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncBatch_with_a_field_of_another_instance_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* instances[2];
+        unsigned char* destination;
+        size_t destinationSize;
+        instances[0] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        instances[1] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncBatch(&destination, &destinationSize, (void* const*)instances, 2, 1, &instances[1]->this_is_int_Property);
 
         // assert
-        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(instances[0]);
+        CodeFirst_DestroyDevice(instances[1]);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_023: [ Every instance shall be a device created by CodeFirst_CreateDevice with the same model and metadata as the first one, otherwise CodeFirst_SendAsyncBatch shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncBatch_with_an_instance_that_is_not_a_device_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        void* instances[1] = { &device->this_is_int_Property };
+        unsigned char* destination;
+        size_t destinationSize;
+        umock_c_reset_all_calls();
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncBatch(&destination, &destinationSize, instances, 1, 1, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         // cleanup
@@ -3056,6 +3559,7 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         STRICT_EXPECTED_CALL(Schema_AddModelActionArgument(SETSPEED_ACTION_HANDLE, "theSpeed", "double"));
         STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_MODEL_HANDLE, "reset_Action"))
             .SetReturn(RESET_ACTION_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_BuildLookupIndexes(TEST_SCHEMA_HANDLE));
 
         ///act
         
@@ -3106,6 +3610,7 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_double2", "double"));
         STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int"));
         STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_int2", "int"));
+        STRICT_EXPECTED_CALL(Schema_BuildLookupIndexes(TEST_SCHEMA_HANDLE));
         
         ///act
         SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testModelInModelReflected));
@@ -3119,6 +3624,26 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
 
     }
 
+    /*Tests_SRS_CODEFIRST_41_005: [ Once the schema has been built, CodeFirst_RegisterSchema shall call Schema_BuildLookupIndexes. ]*/
+    /*Tests_SRS_CODEFIRST_41_006: [ If Schema_BuildLookupIndexes fails, CodeFirst_RegisterSchema shall still succeed. ]*/
+    TEST_FUNCTION(When_Schema_BuildLookupIndexes_Fails_CodeFirst_RegisterSchema_Still_Succeeds)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(Schema_BuildLookupIndexes(TEST_SCHEMA_HANDLE))
+            .SetReturn(SCHEMA_ERROR);
+
+        ///act
+        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, TEST_SCHEMA_HANDLE, result);
+
+        ///cleanup
+        CodeFirst_Deinit();
+    }
+
     /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
     TEST_FUNCTION(When_Schema_Create_Fails_Then_CodeFirst_RegisterSchema_Fails)
     {
@@ -3812,6 +4337,187 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         CodeFirst_Deinit();
     }
 
+    static void CodeFirst_SendAsyncReportedDelta_one_prefix_path(void)
+    {
+        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(TEST_DEVICE_HANDLE));
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "new_reported_this_is_double"))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, 5.5))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(AgentDataTypes_ToString(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_destination()
+            .IgnoreArgument_value();
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_008: [ CodeFirst_SendAsyncReportedDelta shall behave as CodeFirst_SendAsyncReported, publishing only the reported properties that changed. ]*/
+    /*Tests_SRS_CODEFIRST_41_010: [ CodeFirst_SendAsyncReportedDelta shall remember the values it publishes until CodeFirst_AcknowledgeReportedPropertiesDelta is called. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedDelta_first_time_publishes_the_reportedProperty)
+    {
+        /// arrange
+        (void)CodeFirst_Init(NULL);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        umock_c_reset_all_calls();
+
+        device->new_reported_this_is_double = 5.5;
+
+        CodeFirst_SendAsyncReportedDelta_one_prefix_path();
+        STRICT_EXPECTED_CALL(Device_PublishTransacted_ReportedProperty(IGNORED_PTR_ARG, "new_reported_this_is_double", IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument_data();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Device_CommitTransaction_ReportedProperties(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(Device_DestroyTransaction_ReportedProperties(IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle();
+
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedDelta(&destination, &destinationSize, 1, &(device->new_reported_this_is_double));
+
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        /// cleanup
+        CodeFirst_DestroyDevice(device);
+        my_gballoc_free(destination);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_009: [ CodeFirst_SendAsyncReportedDelta shall skip the reported properties whose value is the same as the last acknowledged one. ]*/
+    /*Tests_SRS_CODEFIRST_41_011: [ If no reported property changed, CodeFirst_SendAsyncReportedDelta shall not commit the transaction, shall set *destination to NULL and *destinationSize to 0, and shall return CODEFIRST_OK. ]*/
+    /*Tests_SRS_CODEFIRST_41_013: [ CodeFirst_AcknowledgeReportedPropertiesDelta shall make the values sent by CodeFirst_SendAsyncReportedDelta since the last acknowledgement the acknowledged ones, and return CODEFIRST_OK. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedDelta_after_acknowledge_skips_the_unchanged_reportedProperty)
+    {
+        /// arrange
+        (void)CodeFirst_Init(NULL);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        device->new_reported_this_is_double = 5.5;
+        (void)CodeFirst_SendAsyncReportedDelta(&destination, &destinationSize, 1, &(device->new_reported_this_is_double));
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, CodeFirst_AcknowledgeReportedPropertiesDelta(device));
+        unsigned char* originalDestination = destination;
+        umock_c_reset_all_calls();
+
+        CodeFirst_SendAsyncReportedDelta_one_prefix_path();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Device_DestroyTransaction_ReportedProperties(IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle();
+
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedDelta(&destination, &destinationSize, 1, &(device->new_reported_this_is_double));
+
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_IS_NULL(destination);
+        ASSERT_ARE_EQUAL(size_t, 0, destinationSize);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        /// cleanup
+        CodeFirst_DestroyDevice(device);
+        my_gballoc_free(originalDestination);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_009: [ CodeFirst_SendAsyncReportedDelta shall skip the reported properties whose value is the same as the last acknowledged one. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedDelta_after_acknowledge_publishes_the_changed_reportedProperty)
+    {
+        /// arrange
+        (void)CodeFirst_Init(NULL);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        device->new_reported_this_is_double = 5.5;
+        (void)CodeFirst_SendAsyncReportedDelta(&destination, &destinationSize, 1, &(device->new_reported_this_is_double));
+        (void)CodeFirst_AcknowledgeReportedPropertiesDelta(device);
+        my_AgentDataTypes_ToString_text = "6.5"; /*the value is now serialized differently*/
+        umock_c_reset_all_calls();
+
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedDelta(&destination, &destinationSize, 1, &(device->new_reported_this_is_double));
+
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_IS_TRUE(strstr(umock_c_get_actual_calls(), "[Device_PublishTransacted_ReportedProperty(") != NULL);
+        ASSERT_IS_TRUE(strstr(umock_c_get_actual_calls(), "[Device_CommitTransaction_ReportedProperties(") != NULL);
+
+        /// cleanup
+        my_AgentDataTypes_ToString_text = "5.5";
+        CodeFirst_DestroyDevice(device);
+        my_gballoc_free(destination);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_012: [ If device is NULL or is not a device created by CodeFirst_CreateDevice, CodeFirst_AcknowledgeReportedPropertiesDelta shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_AcknowledgeReportedPropertiesDelta_with_NULL_device_fails)
+    {
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_AcknowledgeReportedPropertiesDelta(NULL);
+
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_CODEFIRST_41_014: [ CodeFirst_CreateDevice shall keep the devices sorted by the address of their data, so that a device can be found by binary search. ]*/
+    /*Tests_SRS_CODEFIRST_41_018: [ CodeFirst_CreateDevice, CodeFirst_DestroyDevice, CodeFirst_RegisterSchema and the lookups of the device a value belongs to shall hold the devices lock, so that different devices can be serialized from different threads. ]*/
+    TEST_FUNCTION(CodeFirst_finds_every_device_after_creating_and_destroying_many)
+    {
+        /// arrange
+        SimpleDevice_Model* devices[16];
+        size_t i;
+        (void)CodeFirst_Init(NULL);
+        for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++)
+        {
+            devices[i] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+            ASSERT_IS_NOT_NULL(devices[i]);
+        }
+        for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i += 3)
+        {
+            CodeFirst_DestroyDevice(devices[i]);
+        }
+
+        /// act and assert
+        for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++)
+        {
+            if (i % 3 != 0)
+            {
+                ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, CodeFirst_AcknowledgeReportedPropertiesDelta(devices[i]));
+                ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, CodeFirst_AcknowledgeReportedPropertiesDelta(&devices[i]->new_reported_this_is_int));
+            }
+        }
+
+        /// cleanup
+        for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++)
+        {
+            if (i % 3 != 0)
+            {
+                CodeFirst_DestroyDevice(devices[i]);
+            }
+        }
+        CodeFirst_Deinit();
+    }
+
     /*Tests_SRS_CODEFIRST_02_027: [ If any error occurs, CodeFirst_SendAsyncReported shall fail and return CODEFIRST_ERROR. ]*/
     TEST_FUNCTION(CodeFirst_SendReportedAsync_one_reportedProperty_unhappy_path)
     {
@@ -3869,6 +4575,7 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         CodeFirst_Deinit();
     }
 
+    /*Tests_SRS_CODEFIRST_41_015: [ CodeFirst_CreateDevice shall index the properties and reported properties of metadata by model name and offset the first time a device uses metadata; if the index cannot be built, lookups shall scan the metadata. ]*/
     TEST_FUNCTION(CodeFirst_SendAsyncReported_Can_Send_The_Last_reportedProperty_From_A_Child_Model)
     {
         /// arrange
@@ -3991,6 +4698,87 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         CodeFirst_Deinit();
     }
 
+    /*Tests_SRS_CODEFIRST_41_019: [ If device is NULL or version is NULL then CodeFirst_GetDesiredPropertiesVersion shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_GetDesiredPropertiesVersion_with_NULL_device_fails)
+    {
+        ///arrange
+        int64_t version;
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_GetDesiredPropertiesVersion(NULL, &version);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CODEFIRST_41_019: [ If device is NULL or version is NULL then CodeFirst_GetDesiredPropertiesVersion shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_GetDesiredPropertiesVersion_with_NULL_version_fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        OuterType* device = (OuterType*)CodeFirst_CreateDevice(TEST_OUTERTYPE_MODEL_HANDLE, &ALL_REFLECTED(testModelInModelReflected), sizeof(OuterType), false);
+        umock_c_reset_all_calls();
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_GetDesiredPropertiesVersion(device, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_021: [ CodeFirst_GetDesiredPropertiesVersion shall call Device_GetDesiredPropertiesVersion and return CODEFIRST_OK when it succeeds. ]*/
+    TEST_FUNCTION(CodeFirst_GetDesiredPropertiesVersion_succeeds)
+    {
+        ///arrange
+        int64_t version;
+        (void)CodeFirst_Init(NULL);
+        OuterType* device = (OuterType*)CodeFirst_CreateDevice(TEST_OUTERTYPE_MODEL_HANDLE, &ALL_REFLECTED(testModelInModelReflected), sizeof(OuterType), false);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Device_GetDesiredPropertiesVersion(TEST_DEVICE_HANDLE, &version));
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_GetDesiredPropertiesVersion(device, &version);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_020: [ If the device cannot be found or Device_GetDesiredPropertiesVersion fails then CodeFirst_GetDesiredPropertiesVersion shall fail and return CODEFIRST_ERROR. ]*/
+    TEST_FUNCTION(CodeFirst_GetDesiredPropertiesVersion_fails_when_Device_GetDesiredPropertiesVersion_fails)
+    {
+        ///arrange
+        int64_t version;
+        (void)CodeFirst_Init(NULL);
+        OuterType* device = (OuterType*)CodeFirst_CreateDevice(TEST_OUTERTYPE_MODEL_HANDLE, &ALL_REFLECTED(testModelInModelReflected), sizeof(OuterType), false);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Device_GetDesiredPropertiesVersion(TEST_DEVICE_HANDLE, &version))
+            .SetReturn(DEVICE_ERROR);
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_GetDesiredPropertiesVersion(device, &version);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
     /* Tests_SRS_CODEFIRST_99_002:[ CodeFirst_RegisterSchema shall create the schema information and give it to the Schema module for one schema, identified by the metadata argument. On success, it shall return a handle to the model.] */
     TEST_FUNCTION(CodeFirst_CreateDevice_passes_onDesiredProperty_callbacks)
     {
@@ -4102,10 +4890,6 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, 1, false);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Schema_GetModelDesiredPropertyCount(TEST_MODEL_HANDLE, IGNORED_PTR_ARG))
-            .IgnoreArgument_desiredPropertyCount(); /*0 desired properties*/
-        STRICT_EXPECTED_CALL(Schema_GetModelModelCount(TEST_MODEL_HANDLE, IGNORED_PTR_ARG))
-            .IgnoreArgument_modelCount(); /*0 model in model*/
         STRICT_EXPECTED_CALL(Schema_ReleaseDeviceRef(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(Schema_DestroyIfUnused(IGNORED_PTR_ARG))
@@ -4292,6 +5076,30 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         CodeFirst_Deinit();
     }
 
+    /*Tests_SRS_CODEFIRST_41_016: [ CodeFirst_InvokeAction and CodeFirst_InvokeMethod shall find the model and the action or method through a table sorted by a hash of the model and command names, built with the metadata index. ]*/
+    TEST_FUNCTION(CodeFirst_InvokeMethod_does_not_find_an_action_with_the_same_name)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        (void)device;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE))
+            .SetReturn("TruckType");
+
+        ///act
+        METHODRETURN_HANDLE result = CodeFirst_InvokeMethod(TEST_DEVICE_HANDLE, g_InvokeActionCallbackArgument, "", "reset", 0, NULL); /*reset is declared WITH_ACTION*/
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_FALSE(DummyDataProvider_reset_wasCalled);
+        ASSERT_IS_NULL(result);
+
+        ///cleanup
+        CodeFirst_Deinit();
+    }
+
     /*Tests_SRS_CODEFIRST_02_059: [ If any of the above fails then CodeFirst_InvokeMethod shall fail and return NULL. ]*/
     TEST_FUNCTION(CodeFirst_InvokeMethod_fails_when_Schema_GetModelName_fails)
     {
@@ -14,6 +14,11 @@ void* my_gballoc_malloc(size_t t)
     return malloc(t);
 }
 
+void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
 void my_gballoc_free(void * t)
 {
     free(t);
@@ -194,6 +199,25 @@ static JSON_DECODER_RESULT my_JSONDecoder_JSON_To_MultiTree(char* json, MULTITRE
     return JSON_DECODER_OK;
 }
 
+/*plays {"<g_streamedMemberName>":3} to the callbacks*/
+static const char* g_streamedMemberName;
+static JSON_DECODER_RESULT my_JSONDecoder_JSON_To_Callbacks(char* json, const JSON_DECODER_CALLBACKS* callbacks, void* callbackContext)
+{
+    JSON_DECODER_RESULT result;
+    (void)json;
+    if ((callbacks->onObjectBegin(callbackContext, NULL) != 0) ||
+        (callbacks->onValue(callbackContext, g_streamedMemberName, "3") != 0) ||
+        (callbacks->onObjectEnd(callbackContext) != 0))
+    {
+        result = JSON_DECODER_ERROR;
+    }
+    else
+    {
+        result = JSON_DECODER_OK;
+    }
+    return result;
+}
+
 static void my_MultiTree_Destroy(MULTITREE_HANDLE treeHandle)
 {
     (void)(treeHandle);
@@ -306,6 +330,7 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
         
         REGISTER_UMOCK_ALIAS_TYPE(SCHEMA_MODEL_TYPE_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(SCHEMA_HANDLE, void*);
@@ -320,6 +345,7 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         REGISTER_UMOCK_ALIAS_TYPE(pfOnDesiredProperty, void*);
         REGISTER_UMOCK_ALIAS_TYPE(SCHEMA_METHOD_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(SCHEMA_METHOD_ARGUMENT_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(const JSON_DECODER_CALLBACKS*, void*);
         
         
         REGISTER_UMOCK_ALIAS_TYPE(JSON_DECODER_RESULT, int);
@@ -339,6 +365,7 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
 
         REGISTER_GLOBAL_MOCK_HOOK(JSONDecoder_JSON_To_MultiTree, my_JSONDecoder_JSON_To_MultiTree);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(JSONDecoder_JSON_To_MultiTree, JSON_DECODER_ERROR);
+        REGISTER_GLOBAL_MOCK_HOOK(JSONDecoder_JSON_To_Callbacks, my_JSONDecoder_JSON_To_Callbacks);
         REGISTER_GLOBAL_MOCK_HOOK(MultiTree_Destroy, my_MultiTree_Destroy);
         
         REGISTER_GLOBAL_MOCK_HOOK(Create_AGENT_DATA_TYPE_from_Members, my_Create_AGENT_DATA_TYPE_from_Members);
@@ -418,6 +445,8 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
     {
+        CommandDecoder_SetStreamingDesiredProperties(false);
+        CommandDecoder_SetChangeOnlyDesiredProperties(false);
         TEST_MUTEX_RELEASE(g_testByTest);
     }
 
@@ -3436,6 +3465,350 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
 
     }
     
+    /*Tests_SRS_COMMAND_DECODER_41_001: [ CommandDecoder_SetStreamingDesiredProperties shall set whether CommandDecoder_IngestDesiredProperties decodes the JSON straight into the model, without building a MULTITREE. ]*/
+    /*Tests_SRS_COMMAND_DECODER_41_009: [ When streaming is on, CommandDecoder_IngestDesiredProperties shall decode the clone of desiredProperties with JSONDecoder_JSON_To_Callbacks. ]*/
+    /*Tests_SRS_COMMAND_DECODER_41_002: [ A value whose name is a desired property of primitive type shall be decoded with CreateAgentDataType_From_String as soon as it is parsed. ]*/
+    /*Tests_SRS_COMMAND_DECODER_41_004: [ A decoded desired property shall be written to the model by pfDesiredPropertyFromAGENT_DATA_TYPE, after which its pfOnDesiredProperty, when not NULL, shall be called. ]*/
+    TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_streaming_with_1_simple_desired_property_happy_path)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        unsigned char deviceMemoryArea[100];
+        const char* desiredPropertiesJSON = "{\"int_field\":3}";
+        CommandDecoder_SetStreamingDesiredProperties(true);
+        g_streamedMemberName = "int_field";
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, desiredPropertiesJSON))
+            .IgnoreArgument_destination();
+        STRICT_EXPECTED_CALL(JSONDecoder_JSON_To_Callbacks(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*the frame of the root object*/
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Schema_GetModelElementByName(TEST_MODEL_HANDLE, "int_field"))
+            .SetReturn(Schema_GetModelElementByName_desiredProperty_int_field);
+        STRICT_EXPECTED_CALL(Schema_GetModelDesiredPropertyType(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD))
+            .SetReturn("int");
+        STRICT_EXPECTED_CALL(CodeFirst_GetPrimitiveType("int"))
+            .SetReturn(EDM_INT32_TYPE);
+        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String("3", EDM_INT32_TYPE, IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD))
+            .SetReturn(int_pfDesiredPropertyFromAGENT_DATA_TYPE);
+        STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_offset(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD))
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(int_pfDesiredPropertyFromAGENT_DATA_TYPE(IGNORED_PTR_ARG, (unsigned char*)deviceMemoryArea + 2))
+            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_pfOnDesiredProperty(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD))
+            .SetReturn(onDesiredPropertySimpleProperty);
+        STRICT_EXPECTED_CALL(onDesiredPropertySimpleProperty(deviceMemoryArea));
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*the frame of the root object*/
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*the clone of the JSON*/
+            .IgnoreArgument_ptr();
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
+
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    /*plays the streaming ingestion of {"int_field":3} when changes-only ingestion is on*/
+    static void CommandDecoder_IngestDesiredProperties_changes_only_inert_path(const char* desiredPropertiesJSON, unsigned char* deviceMemoryArea, bool isFirstIngestion)
+    {
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, desiredPropertiesJSON))
+            .IgnoreArgument_destination();
+        STRICT_EXPECTED_CALL(JSONDecoder_JSON_To_Callbacks(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*the frame of the root object*/
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Schema_GetModelElementByName(TEST_MODEL_HANDLE, "int_field"))
+            .SetReturn(Schema_GetModelElementByName_desiredProperty_int_field);
+        STRICT_EXPECTED_CALL(Schema_GetModelDesiredPropertyType(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD))
+            .SetReturn("int");
+        STRICT_EXPECTED_CALL(CodeFirst_GetPrimitiveType("int"))
+            .SetReturn(EDM_INT32_TYPE);
+        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String("3", EDM_INT32_TYPE, IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD))
+            .SetReturn(int_pfDesiredPropertyFromAGENT_DATA_TYPE);
+        STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_offset(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD))
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(STRING_new())
+            .SetReturn(TEST_STRING_HANDLE_CHILD_NAME);
+        STRICT_EXPECTED_CALL(AgentDataTypes_ToString(TEST_STRING_HANDLE_CHILD_NAME, IGNORED_PTR_ARG))
+            .IgnoreArgument_value()
+            .SetReturn(AGENT_DATA_TYPES_OK);
+        if (isFirstIngestion)
+        {
+            STRICT_EXPECTED_CALL(int_pfDesiredPropertyFromAGENT_DATA_TYPE(IGNORED_PTR_ARG, deviceMemoryArea + 2))
+                .IgnoreArgument_source();
+            STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG)) /*the snapshot of int_field*/
+                .IgnoreArgument_size();
+            STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_pfOnDesiredProperty(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD))
+                .SetReturn(onDesiredPropertySimpleProperty);
+            STRICT_EXPECTED_CALL(onDesiredPropertySimpleProperty(deviceMemoryArea));
+        }
+        else
+        {
+            STRICT_EXPECTED_CALL(STRING_c_str(TEST_STRING_HANDLE_CHILD_NAME)) /*the snapshot*/
+                .SetReturn("3");
+            STRICT_EXPECTED_CALL(STRING_c_str(TEST_STRING_HANDLE_CHILD_NAME)) /*the new value*/
+                .SetReturn("3");
+            STRICT_EXPECTED_CALL(STRING_delete(TEST_STRING_HANDLE_CHILD_NAME));
+        }
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*the frame of the root object*/
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*the clone of the JSON*/
+            .IgnoreArgument_ptr();
+    }
+
+    /*Tests_SRS_COMMAND_DECODER_41_015: [ CommandDecoder_SetChangeOnlyDesiredProperties shall set whether CommandDecoder_IngestDesiredProperties skips the desired properties whose value did not change. ]*/
+    /*Tests_SRS_COMMAND_DECODER_41_016: [ When changes-only ingestion is on, a decoded desired property shall be converted to JSON by AgentDataTypes_ToString and compared with the JSON of the last value written to the same desired property. ]*/
+    TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_changes_only_writes_a_new_value)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        unsigned char deviceMemoryArea[100];
+        const char* desiredPropertiesJSON = "{\"int_field\":3}";
+        CommandDecoder_SetStreamingDesiredProperties(true);
+        CommandDecoder_SetChangeOnlyDesiredProperties(true);
+        g_streamedMemberName = "int_field";
+        umock_c_reset_all_calls();
+
+        CommandDecoder_IngestDesiredProperties_changes_only_inert_path(desiredPropertiesJSON, deviceMemoryArea, true);
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
+
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    /*Tests_SRS_COMMAND_DECODER_41_017: [ A desired property whose JSON is the same as the last one written shall be neither written nor have its pfOnDesiredProperty called. ]*/
+    TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_changes_only_skips_the_same_value)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        unsigned char deviceMemoryArea[100];
+        const char* desiredPropertiesJSON = "{\"int_field\":3}";
+        CommandDecoder_SetStreamingDesiredProperties(true);
+        CommandDecoder_SetChangeOnlyDesiredProperties(true);
+        g_streamedMemberName = "int_field";
+        CommandDecoder_IngestDesiredProperties_changes_only_inert_path(desiredPropertiesJSON, deviceMemoryArea, true);
+        (void)CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON);
+        umock_c_reset_all_calls();
+
+        CommandDecoder_IngestDesiredProperties_changes_only_inert_path(desiredPropertiesJSON, deviceMemoryArea, false);
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
+
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    /*Tests_SRS_COMMAND_DECODER_41_008: [ A name that is not a desired property or a model in model of the model shall stop the decoding and CommandDecoder_IngestDesiredProperties shall return EXECUTE_COMMAND_FAILED. ]*/
+    TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_streaming_with_unknown_name_fails)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        unsigned char deviceMemoryArea[100];
+        const char* desiredPropertiesJSON = "{\"not_a_field\":3}";
+        CommandDecoder_SetStreamingDesiredProperties(true);
+        g_streamedMemberName = "not_a_field";
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, desiredPropertiesJSON))
+            .IgnoreArgument_destination();
+        STRICT_EXPECTED_CALL(JSONDecoder_JSON_To_Callbacks(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*the frame of the root object*/
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Schema_GetModelElementByName(TEST_MODEL_HANDLE, "not_a_field"))
+            .SetReturn(Schema_GetModelElementByName_notFound);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*the frame of the root object*/
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*the clone of the JSON*/
+            .IgnoreArgument_ptr();
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_FAILED, result);
+
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    /*Tests_SRS_COMMAND_DECODER_41_011: [ A "$version" name at the root of desiredProperties shall not be looked up in the model; its value shall be decoded with CreateAgentDataType_From_String as EDM_INT64_TYPE and kept as the version of the desired properties. ]*/
+    /*Tests_SRS_COMMAND_DECODER_41_014: [ Otherwise CommandDecoder_GetDesiredPropertiesVersion shall set *version to the last "$version" ingested and return 0. ]*/
+    TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_with_version_keeps_the_version)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        umock_c_reset_all_calls();
+        unsigned char deviceMemoryArea[100];
+        const char* desiredPropertiesJSON = "{\"$version\":4}";
+        const char* four = "4";
+        size_t one = 1;
+        MULTITREE_HANDLE childHandle = (MULTITREE_HANDLE)0x11;
+        AGENT_DATA_TYPE versionValue;
+        int64_t version = 0;
+        versionValue.type = EDM_INT64_TYPE;
+        versionValue.value.edmInt64.value = 4;
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, desiredPropertiesJSON))
+            .IgnoreArgument_destination();
+        STRICT_EXPECTED_CALL(JSONDecoder_JSON_To_MultiTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_json()
+            .IgnoreArgument_multiTreeHandle();
+        STRICT_EXPECTED_CALL(MultiTree_GetChildCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle()
+            .CopyOutArgumentBuffer_count(&one, sizeof(one));
+        STRICT_EXPECTED_CALL(MultiTree_GetChild(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle()
+            .CopyOutArgumentBuffer_childHandle(&childHandle, sizeof(childHandle));
+        STRICT_EXPECTED_CALL(STRING_new())
+            .SetReturn(TEST_STRING_HANDLE_CHILD_NAME);
+        STRICT_EXPECTED_CALL(MultiTree_GetName(childHandle, TEST_STRING_HANDLE_CHILD_NAME));
+        STRICT_EXPECTED_CALL(STRING_c_str(TEST_STRING_HANDLE_CHILD_NAME))
+            .SetReturn("$version");
+        STRICT_EXPECTED_CALL(MultiTree_GetValue(childHandle, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_destination(&four, sizeof(four));
+        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String(four, EDM_INT64_TYPE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_agentData(&versionValue, sizeof(versionValue));
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(STRING_delete(TEST_STRING_HANDLE_CHILD_NAME));
+        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON);
+        int versionResult = CommandDecoder_GetDesiredPropertiesVersion(commandDecoderHandle, &version);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
+        ASSERT_ARE_EQUAL(int, 0, versionResult);
+        ASSERT_IS_TRUE(version == 4);
+
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    /*Tests_SRS_COMMAND_DECODER_41_011: [ A "$version" name at the root of desiredProperties shall not be looked up in the model; its value shall be decoded with CreateAgentDataType_From_String as EDM_INT64_TYPE and kept as the version of the desired properties. ]*/
+    TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_streaming_with_version_keeps_the_version)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        unsigned char deviceMemoryArea[100];
+        const char* desiredPropertiesJSON = "{\"$version\":3}";
+        AGENT_DATA_TYPE versionValue;
+        int64_t version = 0;
+        versionValue.type = EDM_INT64_TYPE;
+        versionValue.value.edmInt64.value = 3;
+        CommandDecoder_SetStreamingDesiredProperties(true);
+        g_streamedMemberName = "$version";
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, desiredPropertiesJSON))
+            .IgnoreArgument_destination();
+        STRICT_EXPECTED_CALL(JSONDecoder_JSON_To_Callbacks(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*the frame of the root object*/
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String("3", EDM_INT64_TYPE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_agentData(&versionValue, sizeof(versionValue));
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*the frame of the root object*/
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*the clone of the JSON*/
+            .IgnoreArgument_ptr();
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON);
+        int versionResult = CommandDecoder_GetDesiredPropertiesVersion(commandDecoderHandle, &version);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
+        ASSERT_ARE_EQUAL(int, 0, versionResult);
+        ASSERT_IS_TRUE(version == 3);
+
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    /*Tests_SRS_COMMAND_DECODER_41_012: [ If handle is NULL or version is NULL then CommandDecoder_GetDesiredPropertiesVersion shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(CommandDecoder_GetDesiredPropertiesVersion_with_NULL_handle_fails)
+    {
+        ///arrange
+        int64_t version;
+
+        ///act
+        int result = CommandDecoder_GetDesiredPropertiesVersion(NULL, &version);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+    /*Tests_SRS_COMMAND_DECODER_41_012: [ If handle is NULL or version is NULL then CommandDecoder_GetDesiredPropertiesVersion shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(CommandDecoder_GetDesiredPropertiesVersion_with_NULL_version_fails)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+
+        ///act
+        int result = CommandDecoder_GetDesiredPropertiesVersion(commandDecoderHandle, NULL);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    /*Tests_SRS_COMMAND_DECODER_41_013: [ If no ingested desired properties had a "$version" then CommandDecoder_GetDesiredPropertiesVersion shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(CommandDecoder_GetDesiredPropertiesVersion_without_ingested_version_fails)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        int64_t version;
+
+        ///act
+        int result = CommandDecoder_GetDesiredPropertiesVersion(commandDecoderHandle, &version);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
     /*Tests_SRS_COMMAND_DECODER_02_014: [ If handle is NULL then CommandDecoder_ExecuteMethod shall fail and return NULL. ]*/
     TEST_FUNCTION(CommandDecoder_ExecuteMethod_with_NULL_handle_fails)
     {
@@ -32,6 +32,7 @@ static void my_gballoc_free(void* s)
 
 #define ENABLE_MOCKS
 #include "jsonencoder.h"
+#include "cborencoder.h"
 #include "multitree.h"
 #include "schema.h"
 #include "azure_c_shared_utility/optimize_size.h"
@@ -109,6 +110,9 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(MULTITREE_RESULT, MULTITREE_RESULT_VALUES);
 TEST_DEFINE_ENUM_TYPE(JSON_ENCODER_RESULT, JSON_ENCODER_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(JSON_ENCODER_RESULT, JSON_ENCODER_RESULT_VALUES);
 
+TEST_DEFINE_ENUM_TYPE(CBOR_ENCODER_RESULT, CBOR_ENCODER_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(CBOR_ENCODER_RESULT, CBOR_ENCODER_RESULT_VALUES);
+
 #define DEFAULT_PROPERTY_NAME_2 "blahBlah"
 
 static MULTITREE_HANDLE my_MultiTree_Create(MULTITREE_CLONE_FUNCTION cloneFunction, MULTITREE_FREE_FUNCTION freeFunction)
@@ -133,6 +137,30 @@ static void my_STRING_delete(STRING_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+#define TEST_JSON_PAYLOAD "Test"
+static void* g_encodedBuffer;
+
+static JSON_ENCODER_RESULT my_JSONEncoder_EncodeTree_ToBuffer(MULTITREE_HANDLE treeHandle, unsigned char** destination, size_t* destinationSize, JSON_ENCODER_TOSTRING_FUNC toStringFunc)
+{
+    (void)treeHandle;
+    (void)toStringFunc;
+    *destinationSize = sizeof(TEST_JSON_PAYLOAD) - 1;
+    *destination = (unsigned char*)my_gballoc_malloc(*destinationSize);
+    g_encodedBuffer = *destination;
+    (void)memcpy(*destination, TEST_JSON_PAYLOAD, *destinationSize);
+    return JSON_ENCODER_OK;
+}
+
+static CBOR_ENCODER_RESULT my_CBOREncoder_EncodeTree_ToBuffer(MULTITREE_HANDLE treeHandle, unsigned char** destination, size_t* destinationSize)
+{
+    (void)treeHandle;
+    *destinationSize = 1;
+    *destination = (unsigned char*)my_gballoc_malloc(*destinationSize);
+    g_encodedBuffer = *destination;
+    **destination = 0xA0; /*an empty CBOR map*/
+    return CBOR_ENCODER_OK;
+}
+
 static AGENT_DATA_TYPES_RESULT my_AgentDataTypes_ToString(STRING_HANDLE destination, const AGENT_DATA_TYPE* value)
 {
     (void)value;
@@ -183,6 +211,7 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         REGISTER_UMOCK_ALIAS_TYPE(MULTITREE_RESULT, int);
         REGISTER_UMOCK_ALIAS_TYPE(DATA_MARSHALLER_RESULT, int);
         REGISTER_UMOCK_ALIAS_TYPE(JSON_ENCODER_RESULT, int);
+        REGISTER_UMOCK_ALIAS_TYPE(CBOR_ENCODER_RESULT, int);
             
         REGISTER_GLOBAL_MOCK_HOOK(MultiTree_Create, my_MultiTree_Create);
         REGISTER_GLOBAL_MOCK_HOOK(MultiTree_Destroy, my_MultiTree_Destroy);
@@ -191,6 +220,9 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, real_STRING_c_str);
         REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, real_STRING_delete);
 
+        REGISTER_GLOBAL_MOCK_HOOK(JSONEncoder_EncodeTree_ToBuffer, my_JSONEncoder_EncodeTree_ToBuffer);
+        REGISTER_GLOBAL_MOCK_HOOK(CBOREncoder_EncodeTree_ToBuffer, my_CBOREncoder_EncodeTree_ToBuffer);
+
         REGISTER_GLOBAL_MOCK_HOOK(AgentDataTypes_ToString, my_AgentDataTypes_ToString);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(AgentDataTypes_ToString, AGENT_DATA_TYPES_ERROR);
 
@@ -253,6 +285,7 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
     {
+        DataMarshaller_SetCBOREncoding(false);
         TEST_MUTEX_RELEASE(g_testByTest);
     }
 
@@ -643,16 +676,9 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
 
         STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME, &floatValid))
             .IgnoreArgument_treeHandle();
-        STRICT_EXPECTED_CALL(STRING_new());
-        EXPECTED_CALL(JSONEncoder_EncodeTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_treeHandle()
-            .IgnoreArgument_destination()
-            .IgnoreArgument_toStringFunc()
+        EXPECTED_CALL(JSONEncoder_EncodeTree_ToBuffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .SetReturn(JSON_ENCODER_ERROR);
 
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument_handle();
-
         STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle();
 
@@ -678,7 +704,7 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         size_t destinationSize;
         umock_c_reset_all_calls();
         DATA_MARSHALLER_VALUE value[] = { { DEFAULT_PROPERTY_NAME, &floatValid }, { DEFAULT_PROPERTY_NAME_2, &structTypeValue } };
-        char json_payload[] = "Test";
+        char json_payload[] = TEST_JSON_PAYLOAD;
 
         EXPECTED_CALL(MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -686,22 +712,9 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
             .IgnoreArgument_treeHandle();
         STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME_2, &structTypeValue))
             .IgnoreArgument_treeHandle();
-        EXPECTED_CALL(STRING_new());
-        EXPECTED_CALL(JSONEncoder_EncodeTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(JSONEncoder_EncodeTree_ToBuffer(IGNORED_PTR_ARG, &destination, &destinationSize, IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle()
-            .IgnoreArgument_destination()
             .IgnoreArgument_toStringFunc();
-
-        EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG))
-            .SetReturn(strlen(json_payload));
-
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument_size();
-
-        EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-            .SetReturn(json_payload);
-
-        EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle();
 
@@ -729,7 +742,6 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         size_t destinationSize;
         umock_c_reset_all_calls();
         DATA_MARSHALLER_VALUE value[] = { { DEFAULT_PROPERTY_NAME, &floatValid }, { DEFAULT_PROPERTY_NAME_2, &structTypeValue } };
-        char json_payload[] = "Test";
 
         EXPECTED_CALL(MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -737,22 +749,9 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
             .IgnoreArgument_treeHandle();
         STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME_2, &structTypeValue))
             .IgnoreArgument_treeHandle();
-        EXPECTED_CALL(STRING_new());
-        EXPECTED_CALL(JSONEncoder_EncodeTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(JSONEncoder_EncodeTree_ToBuffer(IGNORED_PTR_ARG, &destination, &destinationSize, IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle()
-            .IgnoreArgument_destination()
             .IgnoreArgument_toStringFunc();
-
-        EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG))
-            .SetReturn(strlen(json_payload));
-
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument_size();
-
-        EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-            .SetReturn(json_payload);
-
-        EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle();
 
@@ -777,7 +776,6 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         size_t destinationSize;
         umock_c_reset_all_calls();
         DATA_MARSHALLER_VALUE value[] = { { DEFAULT_PROPERTY_NAME, &floatValid }, { DEFAULT_PROPERTY_NAME_2, &floatValid } };
-        char json_payload[] = "Test";
 
         EXPECTED_CALL(MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -785,22 +783,9 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
             .IgnoreArgument_treeHandle();
         STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME_2, &floatValid))
             .IgnoreArgument_treeHandle();
-        EXPECTED_CALL(STRING_new());
-        EXPECTED_CALL(JSONEncoder_EncodeTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(JSONEncoder_EncodeTree_ToBuffer(IGNORED_PTR_ARG, &destination, &destinationSize, IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle()
-            .IgnoreArgument_destination()
             .IgnoreArgument_toStringFunc();
-
-        EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG))
-            .SetReturn(strlen(json_payload));
-
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument_size();
-
-        EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-            .SetReturn(json_payload);
-
-        EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle();
 
@@ -825,28 +810,14 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         size_t destinationSize;
         umock_c_reset_all_calls();
         DATA_MARSHALLER_VALUE value = { DEFAULT_PROPERTY_NAME, &floatValid };
-        char json_payload[] = "Test";
 
         EXPECTED_CALL(MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
         STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME, &floatValid))
             .IgnoreArgument_treeHandle();
-        EXPECTED_CALL(STRING_new());
-        EXPECTED_CALL(JSONEncoder_EncodeTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(JSONEncoder_EncodeTree_ToBuffer(IGNORED_PTR_ARG, &destination, &destinationSize, IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle()
-            .IgnoreArgument_destination()
             .IgnoreArgument_toStringFunc();
-
-        EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG))
-            .SetReturn(strlen(json_payload));
-
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument_size();
-
-        EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-            .SetReturn(json_payload);
-
-        EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle();
 
@@ -872,7 +843,6 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         size_t destinationSize;
         umock_c_reset_all_calls();
         DATA_MARSHALLER_VALUE value = { DEFAULT_PROPERTY_NAME, &structTypeValue2Members };
-        char json_payload[] = "Test";
 
         EXPECTED_CALL(MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -880,21 +850,9 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
             .IgnoreArgument_treeHandle();
         STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, "y", structTypeValue2Members.value.edmComplexType.fields[1].value))
             .IgnoreArgument_treeHandle();
-        EXPECTED_CALL(STRING_new());
-        EXPECTED_CALL(JSONEncoder_EncodeTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(JSONEncoder_EncodeTree_ToBuffer(IGNORED_PTR_ARG, &destination, &destinationSize, IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle()
-            .IgnoreArgument_destination()
             .IgnoreArgument_toStringFunc();
-
-        EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG))
-            .SetReturn(strlen(json_payload));
-
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument_size();
-
-        EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-            .SetReturn(json_payload);
-        EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle();
 
@@ -972,8 +930,8 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         DataMarshaller_Destroy(handle);
     }
 
-    /* Tests_SRS_DATAMARSHALLER_01_003: [DATA_MARSHALLER_ERROR shall be returned for any errors when calling IoTHubMessage APIs.] */
-    TEST_FUNCTION(when_STRING_new_fails_SendData_Fails)
+    /*Tests_SRS_DATAMARSHALLER_41_001: [ DataMarshaller_SendData shall encode the JSON tree with JSONEncoder_EncodeTree_ToBuffer, which writes it straight into the buffer returned in *destination. ]*/
+    TEST_FUNCTION(DataMarshaller_SendData_returns_the_encoder_buffer_without_copying_it)
     {
         ///arrange
         DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, false);
@@ -986,8 +944,9 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
 
         STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME, &floatValid))
             .IgnoreArgument_treeHandle();
-        EXPECTED_CALL(STRING_new())
-            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(JSONEncoder_EncodeTree_ToBuffer(IGNORED_PTR_ARG, &destination, &destinationSize, IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle()
+            .IgnoreArgument_toStringFunc();
         STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument_treeHandle();
 
@@ -995,8 +954,76 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         DATA_MARSHALLER_RESULT result = DataMarshaller_SendData(handle, 1, &value, &destination, &destinationSize);
 
         ///assert
-        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_ERROR, result);
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_OK, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, (void_ptr)g_encodedBuffer, (void_ptr)destination);
+
+        ///cleanup
+        free(destination);
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATAMARSHALLER_41_002: [ DataMarshaller_SetCBOREncoding shall select whether the data passed to DataMarshaller_SendData is encoded as CBOR (true) or JSON (false); reported properties are always encoded as JSON. ]*/
+    /*Tests_SRS_DATAMARSHALLER_41_003: [ If CBOR encoding has been turned on, DataMarshaller_SendData shall encode the tree with CBOREncoder_EncodeTree_ToBuffer instead of JSONEncoder_EncodeTree_ToBuffer. ]*/
+    TEST_FUNCTION(DataMarshaller_SendData_with_CBOR_encoding_uses_the_CBOR_encoder)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, false);
+        unsigned char* destination;
+        size_t destinationSize;
+        DataMarshaller_SetCBOREncoding(true);
+        umock_c_reset_all_calls();
+        DATA_MARSHALLER_VALUE value = { DEFAULT_PROPERTY_NAME, &floatValid };
+
+        EXPECTED_CALL(MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+        STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME, &floatValid))
+            .IgnoreArgument_treeHandle();
+        STRICT_EXPECTED_CALL(CBOREncoder_EncodeTree_ToBuffer(IGNORED_PTR_ARG, &destination, &destinationSize))
+            .IgnoreArgument_treeHandle();
+        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle();
+
+        ///act
+        DATA_MARSHALLER_RESULT result = DataMarshaller_SendData(handle, 1, &value, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, (void_ptr)g_encodedBuffer, (void_ptr)destination);
+        ASSERT_ARE_EQUAL(size_t, 1, destinationSize);
+
+        ///cleanup
+        free(destination);
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATAMARSHALLER_41_004: [ If CBOREncoder_EncodeTree_ToBuffer fails, DataMarshaller_SendData shall return DATA_MARSHALLER_JSON_ENCODER_ERROR. ]*/
+    TEST_FUNCTION(DataMarshaller_SendData_when_the_CBOR_encoder_fails_then_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, false);
+        unsigned char* destination;
+        size_t destinationSize;
+        DataMarshaller_SetCBOREncoding(true);
+        umock_c_reset_all_calls();
+        DATA_MARSHALLER_VALUE value = { DEFAULT_PROPERTY_NAME, &floatValid };
+
+        EXPECTED_CALL(MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+        STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME, &floatValid))
+            .IgnoreArgument_treeHandle();
+        EXPECTED_CALL(CBOREncoder_EncodeTree_ToBuffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(CBOR_ENCODER_ERROR);
+        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle();
+
+        ///act
+        DATA_MARSHALLER_RESULT result = DataMarshaller_SendData(handle, 1, &value, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_JSON_ENCODER_ERROR, result);
 
         ///cleanup
         DataMarshaller_Destroy(handle);
@@ -43,6 +43,7 @@ void my_gballoc_free(void * t)
 #include "umocktypes_bool.h"
 #include "umocktypes_stdint.h"
 #include "umock_c_negative_tests.h"
+#include "allocation_budget.h"
 
 /*not very nice source level preprocessor mocking... */
 #define GBALLOC_H
@@ -145,6 +146,24 @@ static DATA_MARSHALLER_RESULT my_DataMarshaller_SendData(DATA_MARSHALLER_HANDLE
     return DATA_MARSHALLER_OK;
 }
 
+#define ARENA_TEST_PATH_COUNT 9
+static const char* arenaTestPaths[ARENA_TEST_PATH_COUNT] = { "p0", "p1", "p2", "p3", "p4", "p5", "p6", "p7", "p8" };
+
+static DATA_MARSHALLER_RESULT my_DataMarshaller_SendData_arenaTestPaths(DATA_MARSHALLER_HANDLE dataMarshallerHandle, size_t valueCount, const DATA_MARSHALLER_VALUE* values, unsigned char** destination, size_t* destinationSize)
+{
+    size_t i;
+    (void)destination;
+    (void)destinationSize;
+    (void)dataMarshallerHandle;
+    ASSERT_ARE_EQUAL(size_t, ARENA_TEST_PATH_COUNT, valueCount);
+    for (i = 0; i < valueCount; i++)
+    {
+        ASSERT_ARE_EQUAL(char_ptr, arenaTestPaths[i], values[i].PropertyPath);
+        ASSERT_IS_NOT_NULL(values[i].Value);
+    }
+    return DATA_MARSHALLER_OK;
+}
+
 BEGIN_TEST_SUITE(DataPublisher_ut)
 
     TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -231,6 +250,7 @@ BEGIN_TEST_SUITE(DataPublisher_ut)
         data.type = EDM_SINGLE_TYPE;
         data.value.edmSingle.value = 3.5f;
         g_ExpectedDataSentValues = NULL;
+        DataPublisher_SetTransactionArenaSize(0);
     }
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -1077,6 +1097,193 @@ BEGIN_TEST_SUITE(DataPublisher_ut)
         DataPublisher_SetMaxBufferSize(10*1024);
     }
 
+    /* Tests_SRS_DATA_PUBLISHER_41_002: [ DataPublisher_SetTransactionArenaSize shall set the size of the arena blocks used by the transactions started after the call; 0 shall make the transactions allocate their values one by one. ]*/
+    /* Tests_SRS_DATA_PUBLISHER_41_003: [ Allocations shall be carved out of the current arena block while it has room for them. ]*/
+    TEST_FUNCTION(DataPublisher_PublishTransacted_with_an_arena_allocates_one_block_for_several_values)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_MODEL_HANDLE, true);
+        TRANSACTION_HANDLE transaction;
+        DataPublisher_SetTransactionArenaSize(1024);
+        transaction = DataPublisher_StartTransaction(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Schema_ModelPropertyByPathExists(TEST_MODEL_HANDLE, PropertyPath));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(IGNORED_PTR_ARG, &data))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Schema_ModelPropertyByPathExists(TEST_MODEL_HANDLE, PropertyPath_2));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(IGNORED_PTR_ARG, &data))
+            .IgnoreArgument(1);
+
+        // act
+        DATA_PUBLISHER_RESULT result1 = DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        DATA_PUBLISHER_RESULT result2 = DataPublisher_PublishTransacted(transaction, PropertyPath_2, &data);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result1);
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_004: [ Otherwise a new block of the arena size, or of the allocation size when that is bigger, shall be allocated. ]*/
+    TEST_FUNCTION(DataPublisher_PublishTransacted_with_an_arena_fails_when_allocating_the_block_fails)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_MODEL_HANDLE, true);
+        TRANSACTION_HANDLE transaction;
+        DataPublisher_SetTransactionArenaSize(1024);
+        transaction = DataPublisher_StartTransaction(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size()
+            .SetReturn(NULL);
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_004: [ Otherwise a new block of the arena size, or of the allocation size when that is bigger, shall be allocated. ]*/
+    TEST_FUNCTION(DataPublisher_PublishTransacted_with_a_small_arena_allocates_a_block_for_values_bigger_than_the_arena)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_MODEL_HANDLE, true);
+        TRANSACTION_HANDLE transaction;
+        DataPublisher_SetTransactionArenaSize(1);
+        transaction = DataPublisher_StartTransaction(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Schema_ModelPropertyByPathExists(TEST_MODEL_HANDLE, PropertyPath));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(IGNORED_PTR_ARG, &data))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_005: [ All the arena blocks of a transaction shall be freed at once when the transaction is disposed of. ]*/
+    TEST_FUNCTION(DataPublisher_EndTransaction_with_an_arena_frees_the_block_once)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_MODEL_HANDLE, true);
+        TRANSACTION_HANDLE transaction;
+        unsigned char* destination;
+        size_t destinationSize;
+        DataPublisher_SetTransactionArenaSize(1024);
+        transaction = DataPublisher_StartTransaction(handle);
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath_2, &data);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(DataMarshaller_SendData(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_dataMarshallerHandle()
+            .IgnoreArgument_values()
+            .IgnoreArgument(4)
+            .IgnoreArgument(5);
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_EndTransaction(transaction, &destination, &destinationSize);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_006: [ When the transaction uses an arena, the array of values shall be grown by doubling its capacity, the previous array being left in the arena. ]*/
+    TEST_FUNCTION(DataPublisher_PublishTransacted_with_an_arena_keeps_all_values_when_the_array_grows)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_MODEL_HANDLE, true);
+        TRANSACTION_HANDLE transaction;
+        size_t i;
+        unsigned char* destination;
+        size_t destinationSize;
+        DataPublisher_SetTransactionArenaSize(1024);
+        transaction = DataPublisher_StartTransaction(handle);
+        for (i = 0; i < ARENA_TEST_PATH_COUNT; i++)
+        {
+            ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, DataPublisher_PublishTransacted(transaction, arenaTestPaths[i], &data));
+        }
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, DataPublisher_PublishTransacted(transaction, arenaTestPaths[3], &data));
+        REGISTER_GLOBAL_MOCK_HOOK(DataMarshaller_SendData, my_DataMarshaller_SendData_arenaTestPaths);
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_EndTransaction(transaction, &destination, &destinationSize);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result);
+
+        // cleanup
+        REGISTER_GLOBAL_MOCK_HOOK(DataMarshaller_SendData, my_DataMarshaller_SendData);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_003: [ Allocations shall be carved out of the current arena block while it has room for them. ]*/
+    /* the allocation budget of a SERIALIZE: the transaction and one arena block, whatever the number of values */
+    TEST_FUNCTION(DataPublisher_transaction_with_an_arena_stays_within_its_allocation_budget)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_MODEL_HANDLE, true);
+        unsigned char* destination;
+        size_t destinationSize;
+        DataPublisher_SetTransactionArenaSize(1024);
+        umock_c_reset_all_calls();
+
+        // act
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        DATA_PUBLISHER_RESULT result1 = DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        DATA_PUBLISHER_RESULT result2 = DataPublisher_PublishTransacted(transaction, PropertyPath_2, &data);
+        DATA_PUBLISHER_RESULT result3 = DataPublisher_EndTransaction(transaction, &destination, &destinationSize);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result1);
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result2);
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result3);
+        ASSERT_ALLOCATION_BUDGET(2);
+
+        // cleanup
+        DataPublisher_Destroy(handle);
+    }
+
     /*Tests_SRS_DATA_PUBLISHER_02_027: [ If argument dataPublisherHandle is NULL then DataPublisher_CreateTransaction_ReportedProperties shall fail and return NULL. ]*/
     TEST_FUNCTION(DataPublisher_CreateTransaction_ReportedProperties_with_NULL_dataPublisherHandle_fails)
     {
@@ -1799,4 +2006,84 @@ next_fail:;
         ///clean
         DataPublisher_Destroy(dataPublisherHandle);
     }
+    /* Tests_SRS_DATA_PUBLISHER_41_003: [ Allocations shall be carved out of the current arena block while it has room for them. ]*/
+    TEST_FUNCTION(DataPublisher_PublishTransacted_ReportedProperty_with_an_arena_allocates_the_value_from_the_block)
+    {
+        ///arrange
+        AGENT_DATA_TYPE ag;
+        ag.type = EDM_BYTE_TYPE;
+        ag.value.edmByte.value = 1;
+        DATA_PUBLISHER_HANDLE dataPublisherHandle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        REPORTED_PROPERTIES_TRANSACTION_HANDLE handle;
+        DataPublisher_SetTransactionArenaSize(1024);
+        handle = DataPublisher_CreateTransaction_ReportedProperties(dataPublisherHandle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_ModelReportedPropertyByPathExists(TEST_SCHEMA_MODEL_TYPE_HANDLE, "A"));
+        STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, "A"))
+            .IgnoreArgument_handle()
+            .IgnoreArgument_pred();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(IGNORED_PTR_ARG, &ag))
+            .IgnoreArgument_dest();
+        STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_elements()
+            .IgnoreArgument_handle();
+
+        ///act
+        DATA_PUBLISHER_RESULT result = DataPublisher_PublishTransacted_ReportedProperty(handle, "A", &ag);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        DataPublisher_DestroyTransaction_ReportedProperties(handle);
+        DataPublisher_Destroy(dataPublisherHandle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_005: [ All the arena blocks of a transaction shall be freed at once when the transaction is disposed of. ]*/
+    TEST_FUNCTION(DataPublisher_DestroyTransaction_ReportedProperties_with_an_arena_frees_the_block_once)
+    {
+        ///arrange
+        AGENT_DATA_TYPE ag1;
+        ag1.type = EDM_BYTE_TYPE;
+        ag1.value.edmByte.value = 1;
+
+        DATA_PUBLISHER_HANDLE dataPublisherHandle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        REPORTED_PROPERTIES_TRANSACTION_HANDLE handle;
+        DataPublisher_SetTransactionArenaSize(1024);
+        handle = DataPublisher_CreateTransaction_ReportedProperties(dataPublisherHandle);
+        (void)DataPublisher_PublishTransacted_ReportedProperty(handle, "AAA", &ag1);
+        (void)DataPublisher_PublishTransacted_ReportedProperty(handle, "BBB", &ag1);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        for (size_t i = 0;i < 2;i++)
+        {
+            STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, i))
+                .IgnoreArgument_handle();
+            STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+                .IgnoreArgument_agentData();
+        }
+
+        STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        DataPublisher_DestroyTransaction_ReportedProperties(handle);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        DataPublisher_Destroy(dataPublisherHandle);
+    }
+
 END_TEST_SUITE(DataPublisher_ut)
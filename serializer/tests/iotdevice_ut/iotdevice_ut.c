@@ -1400,6 +1400,88 @@ BEGIN_TEST_SUITE(IoTDevice_ut)
         Device_Destroy(h);
     }
 
+    /*Tests_SRS_DEVICE_41_001: [ If deviceHandle is NULL or version is NULL then Device_GetDesiredPropertiesVersion shall fail and return DEVICE_INVALID_ARG. ]*/
+    TEST_FUNCTION(Device_GetDesiredPropertiesVersion_with_NULL_deviceHandle_fails)
+    {
+        ///arrange
+        int64_t version;
+
+        ///act
+        DEVICE_RESULT result = Device_GetDesiredPropertiesVersion(NULL, &version);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DEVICE_RESULT, DEVICE_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_DEVICE_41_001: [ If deviceHandle is NULL or version is NULL then Device_GetDesiredPropertiesVersion shall fail and return DEVICE_INVALID_ARG. ]*/
+    TEST_FUNCTION(Device_GetDesiredPropertiesVersion_with_NULL_version_fails)
+    {
+        ///arrange
+        DEVICE_HANDLE h;
+        Device_Create(irrelevantModel, DeviceActionCallback, TEST_CALLBACK_CONTEXT, deviceMethodCallback, TEST_CALLBACK_CONTEXT, false, &h);
+        umock_c_reset_all_calls();
+
+        ///act
+        DEVICE_RESULT result = Device_GetDesiredPropertiesVersion(h, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DEVICE_RESULT, DEVICE_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        Device_Destroy(h);
+    }
+
+    /*Tests_SRS_DEVICE_41_002: [ Device_GetDesiredPropertiesVersion shall call CommandDecoder_GetDesiredPropertiesVersion. ]*/
+    /*Tests_SRS_DEVICE_41_004: [ Otherwise, Device_GetDesiredPropertiesVersion shall succeed and return DEVICE_OK. ]*/
+    TEST_FUNCTION(Device_GetDesiredPropertiesVersion_succeeds)
+    {
+        ///arrange
+        DEVICE_HANDLE h;
+        int64_t version;
+        Device_Create(irrelevantModel, DeviceActionCallback, TEST_CALLBACK_CONTEXT, deviceMethodCallback, TEST_CALLBACK_CONTEXT, false, &h);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CommandDecoder_GetDesiredPropertiesVersion(IGNORED_PTR_ARG, &version))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+
+        ///act
+        DEVICE_RESULT result = Device_GetDesiredPropertiesVersion(h, &version);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DEVICE_RESULT, DEVICE_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        Device_Destroy(h);
+    }
+
+    /*Tests_SRS_DEVICE_41_003: [ If CommandDecoder_GetDesiredPropertiesVersion fails then Device_GetDesiredPropertiesVersion shall fail and return DEVICE_ERROR. ]*/
+    TEST_FUNCTION(Device_GetDesiredPropertiesVersion_fails)
+    {
+        ///arrange
+        DEVICE_HANDLE h;
+        int64_t version;
+        Device_Create(irrelevantModel, DeviceActionCallback, TEST_CALLBACK_CONTEXT, deviceMethodCallback, TEST_CALLBACK_CONTEXT, false, &h);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CommandDecoder_GetDesiredPropertiesVersion(IGNORED_PTR_ARG, &version))
+            .IgnoreArgument_handle()
+            .SetReturn(__LINE__);
+
+        ///act
+        DEVICE_RESULT result = Device_GetDesiredPropertiesVersion(h, &version);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DEVICE_RESULT, DEVICE_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        Device_Destroy(h);
+    }
+
     /*Tests_SRS_DEVICE_02_038: [ If deviceHandle is NULL then Device_ExecuteMethod shall fail and return NULL. ]*/
     TEST_FUNCTION(Device_ExecuteMethod_with_NULL_deviceHandle_fails)
     {
@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include "testrunnerswitcher.h"
 #include "micromock.h"
 #include "micromockcharstararenullterminatedstrings.h"
@@ -2589,4 +2591,150 @@ TEST_FUNCTION(JSONDecoder_When_String_Has_Several_Escaped_Chars_Decoding_Succeed
     TestSpecialCharacter_Success(json);
 }
 
+/* JSONDecoder_JSON_To_Callbacks */
+
+static char callbackLog[256];
+static int failOnValueNamed_count;
+static const char* failOnValueNamed;
+
+static int TestOnObjectBegin(void* context, const char* name)
+{
+    (void)context;
+    (void)sprintf(callbackLog + strlen(callbackLog), "{%s", (name == NULL) ? "" : name);
+    return 0;
+}
+
+static int TestOnObjectEnd(void* context)
+{
+    (void)context;
+    (void)strcat(callbackLog, "}");
+    return 0;
+}
+
+static int TestOnArrayBegin(void* context, const char* name)
+{
+    (void)context;
+    (void)sprintf(callbackLog + strlen(callbackLog), "[%s", (name == NULL) ? "" : name);
+    return 0;
+}
+
+static int TestOnArrayEnd(void* context)
+{
+    (void)context;
+    (void)strcat(callbackLog, "]");
+    return 0;
+}
+
+static int TestOnValue(void* context, const char* name, const char* value)
+{
+    int result;
+    (void)context;
+    (void)sprintf(callbackLog + strlen(callbackLog), " %s=%s", name, value);
+    if ((failOnValueNamed != NULL) && (strcmp(name, failOnValueNamed) == 0))
+    {
+        failOnValueNamed_count++;
+        result = 1;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static const JSON_DECODER_CALLBACKS testCallbacks =
+{
+    TestOnObjectBegin,
+    TestOnObjectEnd,
+    TestOnArrayBegin,
+    TestOnArrayEnd,
+    TestOnValue
+};
+
+/* Tests_SRS_JSON_DECODER_41_001: [ If json or callbacks is NULL then JSONDecoder_JSON_To_Callbacks shall return JSON_DECODER_INVALID_ARG. ]*/
+TEST_FUNCTION(JSONDecoder_JSON_To_Callbacks_With_NULL_json_Fails)
+{
+    ///arrange
+    CJSONDecoderMocks mocks;
+
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_JSON_To_Callbacks(NULL, &testCallbacks, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_INVALID_ARG, result);
+}
+
+/* Tests_SRS_JSON_DECODER_41_001: [ If json or callbacks is NULL then JSONDecoder_JSON_To_Callbacks shall return JSON_DECODER_INVALID_ARG. ]*/
+TEST_FUNCTION(JSONDecoder_JSON_To_Callbacks_With_NULL_callbacks_Fails)
+{
+    ///arrange
+    CJSONDecoderMocks mocks;
+    char json[] = "{}";
+
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_JSON_To_Callbacks(json, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_INVALID_ARG, result);
+}
+
+/* Tests_SRS_JSON_DECODER_41_003: [ JSONDecoder_JSON_To_Callbacks shall parse json in place with the same grammar as JSONDecoder_JSON_To_MultiTree, without creating a multi tree. ]*/
+/* Tests_SRS_JSON_DECODER_41_004: [ When an object begins, JSONDecoder_JSON_To_Callbacks shall call onObjectBegin with the name of the object. ]*/
+/* Tests_SRS_JSON_DECODER_41_005: [ When an object ends, JSONDecoder_JSON_To_Callbacks shall call onObjectEnd. ]*/
+/* Tests_SRS_JSON_DECODER_41_006: [ For each value that is not an object or an array, JSONDecoder_JSON_To_Callbacks shall call onValue with the member name and the null terminated value as it appears in the JSON. ]*/
+/* Tests_SRS_JSON_DECODER_41_007: [ When an array begins, JSONDecoder_JSON_To_Callbacks shall call onArrayBegin with the name of the array. ]*/
+/* Tests_SRS_JSON_DECODER_41_008: [ For array elements the name passed to the callbacks shall be the string representation of the array index. ]*/
+/* Tests_SRS_JSON_DECODER_41_009: [ When an array ends, JSONDecoder_JSON_To_Callbacks shall call onArrayEnd. ]*/
+/* Tests_SRS_JSON_DECODER_41_011: [ On success JSONDecoder_JSON_To_Callbacks shall return JSON_DECODER_OK. ]*/
+TEST_FUNCTION(JSONDecoder_JSON_To_Callbacks_Reports_Nested_Elements_In_Order)
+{
+    ///arrange
+    CJSONDecoderMocks mocks;
+    char json[] = "{ \"a\" : 1, \"b\":{\"c\":\"x\", \"d\":true}, \"e\":[2, {\"f\":null}] }";
+    callbackLog[0] = '\0';
+    failOnValueNamed = NULL;
+
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_JSON_To_Callbacks(json, &testCallbacks, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "{ a=1{b c=\"x\" d=true}[e 0=2{1 f=null}]}", callbackLog);
+}
+
+/* Tests_SRS_JSON_DECODER_41_002: [ If parsing the JSON fails due to the JSON string being malformed, JSONDecoder_JSON_To_Callbacks shall return JSON_DECODER_PARSE_ERROR. ]*/
+TEST_FUNCTION(JSONDecoder_JSON_To_Callbacks_With_Malformed_JSON_Fails)
+{
+    ///arrange
+    CJSONDecoderMocks mocks;
+    char json[] = "{\"a\":1";
+    callbackLog[0] = '\0';
+    failOnValueNamed = NULL;
+
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_JSON_To_Callbacks(json, &testCallbacks, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_PARSE_ERROR, result);
+}
+
+/* Tests_SRS_JSON_DECODER_41_010: [ If any callback returns a non-zero value, JSONDecoder_JSON_To_Callbacks shall stop parsing and return JSON_DECODER_ERROR. ]*/
+TEST_FUNCTION(JSONDecoder_JSON_To_Callbacks_Stops_When_A_Callback_Fails)
+{
+    ///arrange
+    CJSONDecoderMocks mocks;
+    char json[] = "{\"a\":1, \"b\":2, \"c\":3}";
+    callbackLog[0] = '\0';
+    failOnValueNamed = "b";
+    failOnValueNamed_count = 0;
+
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_JSON_To_Callbacks(json, &testCallbacks, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_ERROR, result);
+    ASSERT_ARE_EQUAL(int, 1, failOnValueNamed_count);
+    ASSERT_ARE_EQUAL(char_ptr, "{ a=1 b=2", callbackLog);
+}
+
 END_TEST_SUITE(JSONDecoder_ut)
@@ -3,6 +3,7 @@
 
 #include <cstdlib>
 #include <cstddef>
+#include <cstring>
 #include <cstdbool>
 #include "testrunnerswitcher.h"
 #include "azure_c_shared_utility/optimize_size.h"
@@ -563,6 +564,12 @@ public:
 
     MOCK_STATIC_METHOD_1(, const char*, STRING_c_str, STRING_HANDLE, s)
     MOCK_METHOD_END(const char*, BASEIMPLEMENTATION::STRING_c_str(s))
+
+    MOCK_STATIC_METHOD_1(, size_t, STRING_length, STRING_HANDLE, s)
+    MOCK_METHOD_END(size_t, BASEIMPLEMENTATION::STRING_length(s))
+
+    MOCK_STATIC_METHOD_1(, int, STRING_empty, STRING_HANDLE, s)
+    MOCK_METHOD_END(int, BASEIMPLEMENTATION::STRING_empty(s))
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CJSONMocks, , MULTITREE_HANDLE, MultiTree_Create, MULTITREE_CLONE_FUNCTION, cloneFunction, MULTITREE_FREE_FUNCTION, freeFunction);
@@ -578,6 +585,8 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CJSONMocks, , void, STRING_delete, STRING_HANDLE, s
 DECLARE_GLOBAL_MOCK_METHOD_2(CJSONMocks, , int, STRING_concat, STRING_HANDLE, s1, const char*, s2);
 DECLARE_GLOBAL_MOCK_METHOD_2(CJSONMocks, , int, STRING_concat_with_STRING, STRING_HANDLE, s1, STRING_HANDLE, s2);
 DECLARE_GLOBAL_MOCK_METHOD_1(CJSONMocks, , const char*, STRING_c_str, STRING_HANDLE, s);
+DECLARE_GLOBAL_MOCK_METHOD_1(CJSONMocks, , size_t, STRING_length, STRING_HANDLE, s);
+DECLARE_GLOBAL_MOCK_METHOD_1(CJSONMocks, , int, STRING_empty, STRING_HANDLE, s);
 
 /*all (applicable) tests in this file also test this: Tests_SRS_JSON_ENCODER_99_022:[ There is no hierarchy defined in the string. All strings are considered to be "root" level.]
  because they test that the objects created are of type "NUMBER" of "STRING" and not JSON_DATATYPE_OBJECT for example*/
@@ -6368,6 +6377,160 @@ BEGIN_TEST_SUITE(JSONEncoder_ut)
             ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_OK, result);
             ASSERT_ARE_EQUAL(char_ptr, "{\"child1\":\"value1\", \"child2\":\"value2\", \"child3\":\"value3\", \"subtree\":{\"child4\":\"value4\", \"child5\":\"value5\"}}", STRING_c_str(global_bufferTemp));
         }
+
+        /* JSONEncoder_EncodeTree_ToBuffer */
+
+        /*Tests_SRS_JSON_ENCODER_41_001: [ If any of the arguments passed to JSONEncoder_EncodeTree_ToBuffer is NULL then JSON_ENCODER_INVALID_ARG shall be returned. ]*/
+        TEST_FUNCTION(JSONEncoder_EncodeTree_ToBuffer_with_NULL_treeHandle_fails)
+        {
+            ///arrange
+            unsigned char* destination;
+            size_t destinationSize;
+
+            ///act
+            JSON_ENCODER_RESULT result = JSONEncoder_EncodeTree_ToBuffer(NULL, &destination, &destinationSize, TestFunc_NodesAreStrings);
+
+            ///assert
+            ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_INVALID_ARG, result);
+            mocks->AssertActualAndExpectedCalls();
+        }
+
+        /*Tests_SRS_JSON_ENCODER_41_001: [ If any of the arguments passed to JSONEncoder_EncodeTree_ToBuffer is NULL then JSON_ENCODER_INVALID_ARG shall be returned. ]*/
+        TEST_FUNCTION(JSONEncoder_EncodeTree_ToBuffer_with_NULL_destination_fails)
+        {
+            ///arrange
+            size_t destinationSize;
+
+            ///act
+            JSON_ENCODER_RESULT result = JSONEncoder_EncodeTree_ToBuffer(TEST_MULTITREE_HANDLE_1, NULL, &destinationSize, TestFunc_NodesAreStrings);
+
+            ///assert
+            ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_INVALID_ARG, result);
+            mocks->AssertActualAndExpectedCalls();
+        }
+
+        /*Tests_SRS_JSON_ENCODER_41_001: [ If any of the arguments passed to JSONEncoder_EncodeTree_ToBuffer is NULL then JSON_ENCODER_INVALID_ARG shall be returned. ]*/
+        TEST_FUNCTION(JSONEncoder_EncodeTree_ToBuffer_with_NULL_destinationSize_fails)
+        {
+            ///arrange
+            unsigned char* destination;
+
+            ///act
+            JSON_ENCODER_RESULT result = JSONEncoder_EncodeTree_ToBuffer(TEST_MULTITREE_HANDLE_1, &destination, NULL, TestFunc_NodesAreStrings);
+
+            ///assert
+            ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_INVALID_ARG, result);
+            mocks->AssertActualAndExpectedCalls();
+        }
+
+        /*Tests_SRS_JSON_ENCODER_41_001: [ If any of the arguments passed to JSONEncoder_EncodeTree_ToBuffer is NULL then JSON_ENCODER_INVALID_ARG shall be returned. ]*/
+        TEST_FUNCTION(JSONEncoder_EncodeTree_ToBuffer_with_NULL_toStringFunc_fails)
+        {
+            ///arrange
+            unsigned char* destination;
+            size_t destinationSize;
+
+            ///act
+            JSON_ENCODER_RESULT result = JSONEncoder_EncodeTree_ToBuffer(TEST_MULTITREE_HANDLE_1, &destination, &destinationSize, NULL);
+
+            ///assert
+            ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_INVALID_ARG, result);
+            mocks->AssertActualAndExpectedCalls();
+        }
+
+        /*Tests_SRS_JSON_ENCODER_41_002: [ JSONEncoder_EncodeTree_ToBuffer shall produce the same JSON as JSONEncoder_EncodeTree. ]*/
+        /*Tests_SRS_JSON_ENCODER_41_004: [ On success, JSONEncoder_EncodeTree_ToBuffer shall hand the output buffer (not null terminated) to the caller in *destination and its length in *destinationSize, and return JSON_ENCODER_OK. ]*/
+        TEST_FUNCTION(JSONEncoder_EncodeTree_ToBuffer_of_an_empty_tree_succeeds)
+        {
+            ///arrange
+            unsigned char* destination;
+            size_t destinationSize;
+
+            ///act
+            JSON_ENCODER_RESULT result = JSONEncoder_EncodeTree_ToBuffer(TEST_MULTITREE_HANDLE_1, &destination, &destinationSize, TestFunc_NodesAreStrings);
+
+            ///assert
+            ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_OK, result);
+            ASSERT_ARE_EQUAL(size_t, 2, destinationSize);
+            ASSERT_ARE_EQUAL(int, 0, memcmp("{}", destination, destinationSize));
+
+            ///cleanup
+            free(destination);
+        }
+
+        /*Tests_SRS_JSON_ENCODER_41_002: [ JSONEncoder_EncodeTree_ToBuffer shall produce the same JSON as JSONEncoder_EncodeTree. ]*/
+        /*Tests_SRS_JSON_ENCODER_41_003: [ The output buffer shall grow by doubling its capacity. ]*/
+        TEST_FUNCTION(JSONEncoder_EncodeTree_ToBuffer_of_a_tree_with_a_subtree_produces_the_same_JSON_as_EncodeTree)
+        {
+            ///arrange
+            unsigned char* destination;
+            size_t destinationSize;
+            (void)JSONEncoder_EncodeTree(TEST_MULTITREE_HANDLE_5_4_2, global_bufferTemp, TestFunc_NodesAreStrings);
+
+            ///act
+            JSON_ENCODER_RESULT result = JSONEncoder_EncodeTree_ToBuffer(TEST_MULTITREE_HANDLE_5_4_2, &destination, &destinationSize, TestFunc_NodesAreStrings);
+
+            ///assert
+            ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_OK, result);
+            ASSERT_ARE_EQUAL(size_t, strlen(BASEIMPLEMENTATION::STRING_c_str(global_bufferTemp)), destinationSize);
+            ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::STRING_c_str(global_bufferTemp), destination, destinationSize));
+
+            ///cleanup
+            free(destination);
+        }
+
+        /*Tests_SRS_JSON_ENCODER_41_005: [ If any failure occurs, JSONEncoder_EncodeTree_ToBuffer shall free the output buffer and return the error. ]*/
+        TEST_FUNCTION(JSONEncoder_EncodeTree_ToBuffer_when_toString_fails_fails)
+        {
+            ///arrange
+            unsigned char* destination = NULL;
+            size_t destinationSize = 0;
+            EXPECTED_CALL((*mocks), TestFunc_NodesAreStrings(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .SetReturn(JSON_ENCODER_TOSTRING_ERROR);
+
+            ///act
+            JSON_ENCODER_RESULT result = JSONEncoder_EncodeTree_ToBuffer(TEST_MULTITREE_HANDLE_2, &destination, &destinationSize, TestFunc_NodesAreStrings);
+
+            ///assert
+            ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_TOSTRING_FUNCTION_ERROR, result);
+            ASSERT_IS_NULL(destination);
+            ASSERT_ARE_EQUAL(size_t, 0, destinationSize);
+        }
+
+        /*Tests_SRS_JSON_ENCODER_41_005: [ If any failure occurs, JSONEncoder_EncodeTree_ToBuffer shall free the output buffer and return the error. ]*/
+        TEST_FUNCTION(JSONEncoder_EncodeTree_ToBuffer_when_MultiTree_GetName_fails_fails)
+        {
+            ///arrange
+            unsigned char* destination = NULL;
+            size_t destinationSize = 0;
+            EXPECTED_CALL((*mocks), MultiTree_GetName(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .SetReturn(MULTITREE_ERROR);
+
+            ///act
+            JSON_ENCODER_RESULT result = JSONEncoder_EncodeTree_ToBuffer(TEST_MULTITREE_HANDLE_2, &destination, &destinationSize, TestFunc_NodesAreStrings);
+
+            ///assert
+            ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_MULTITREE_ERROR, result);
+            ASSERT_IS_NULL(destination);
+            ASSERT_ARE_EQUAL(size_t, 0, destinationSize);
+        }
+
+        /*Tests_SRS_JSON_ENCODER_41_005: [ If any failure occurs, JSONEncoder_EncodeTree_ToBuffer shall free the output buffer and return the error. ]*/
+        TEST_FUNCTION(JSONEncoder_EncodeTree_ToBuffer_when_STRING_new_fails_fails)
+        {
+            ///arrange
+            unsigned char* destination = NULL;
+            size_t destinationSize = 0;
+            whenShallSTRING_new_fail = currentSTRING_new_call + 1;
+
+            ///act
+            JSON_ENCODER_RESULT result = JSONEncoder_EncodeTree_ToBuffer(TEST_MULTITREE_HANDLE_2, &destination, &destinationSize, TestFunc_NodesAreStrings);
+
+            ///assert
+            ASSERT_ARE_EQUAL(JSON_ENCODER_RESULT, JSON_ENCODER_ERROR, result);
+            ASSERT_IS_NULL(destination);
+        }
+
         /*Tests_SRS_JSON_ENCODER_99_047:[ JSONEncoder_CharPtr_ToString shall return JSON_ENCODER_TOSTRING_INVALID_ARG if destination or value parameters passed to it are NULL.]*/
         TEST_FUNCTION(JSONEncoder_CharPtr_ToString_with_NULL_destination_fails)
         {
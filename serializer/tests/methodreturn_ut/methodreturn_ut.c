@@ -319,4 +319,209 @@ TEST_FUNCTION(MethodReturn_GetReturn_with_non_NULL_handle_succeeds)
     MethodReturn_Destroy(h);
 }
 
+static const char* g_freed_jsonValue;
+static void* g_freed_context;
+static void test_free_callback(const char* jsonValue, void* context)
+{
+    g_freed_jsonValue = jsonValue;
+    g_freed_context = context;
+}
+
+/*Tests_SRS_METHODRETURN_41_001: [ If jsonValue is NULL or size is 0 then MethodReturn_CreateFromBorrowedBuffer shall fail and return NULL. ]*/
+TEST_FUNCTION(MethodReturn_CreateFromBorrowedBuffer_with_NULL_jsonValue_fails)
+{
+    ///arrange
+
+    ///act
+    METHODRETURN_HANDLE h1 = MethodReturn_CreateFromBorrowedBuffer(1, NULL, 1, test_free_callback, NULL);
+    METHODRETURN_HANDLE h2 = MethodReturn_CreateFromBorrowedBuffer(1, "1", 0, test_free_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(h1);
+    ASSERT_IS_NULL(h2);
+}
+
+/*Tests_SRS_METHODRETURN_41_002: [ MethodReturn_CreateFromBorrowedBuffer shall create a non-NULL handle containing statusCode and a reference to the size bytes of jsonValue, without copying or parsing them. ]*/
+TEST_FUNCTION(MethodReturn_CreateFromBorrowedBuffer_succeeds)
+{
+    ///arrange
+    const char* jsonValue = "[1,2]";
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+
+    ///act
+    METHODRETURN_HANDLE h = MethodReturn_CreateFromBorrowedBuffer(2, jsonValue, 3, test_free_callback, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(h);
+    const METHODRETURN_DATA* data = MethodReturn_GetReturn(h);
+    ASSERT_ARE_EQUAL(int, 2, data->statusCode);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)jsonValue, (void*)data->jsonValue);
+    ASSERT_ARE_EQUAL(size_t, 3, data->jsonValueSize);
+
+    ///clean
+    MethodReturn_Destroy(h);
+}
+
+/*Tests_SRS_METHODRETURN_41_003: [ If any failure is encountered then MethodReturn_CreateFromBorrowedBuffer shall return NULL and shall not call freeCallback. ]*/
+TEST_FUNCTION(MethodReturn_CreateFromBorrowedBuffer_fails_when_malloc_fails)
+{
+    ///arrange
+    g_freed_jsonValue = NULL;
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size()
+        .SetReturn(NULL);
+
+    ///act
+    METHODRETURN_HANDLE h = MethodReturn_CreateFromBorrowedBuffer(2, "1", 1, test_free_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(h);
+    ASSERT_IS_NULL(g_freed_jsonValue);
+}
+
+/*Tests_SRS_METHODRETURN_41_010: [ If handle was created by MethodReturn_CreateFromBorrowedBuffer with a non-NULL freeCallback then MethodReturn_Destroy shall call freeCallback passing jsonValue and context. ]*/
+TEST_FUNCTION(MethodReturn_Destroy_calls_the_free_callback_of_a_borrowed_buffer)
+{
+    ///arrange
+    const char* jsonValue = "1";
+    METHODRETURN_HANDLE h = MethodReturn_CreateFromBorrowedBuffer(1, jsonValue, 1, test_free_callback, (void*)0x42);
+    g_freed_jsonValue = NULL;
+    g_freed_context = NULL;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+
+    ///act
+    MethodReturn_Destroy(h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)jsonValue, (void*)g_freed_jsonValue);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, g_freed_context);
+}
+
+/*Tests_SRS_METHODRETURN_41_004: [ If buffer is NULL or size is 0 then MethodReturn_CreateFromSerializedBuffer shall fail and return NULL. ]*/
+TEST_FUNCTION(MethodReturn_CreateFromSerializedBuffer_with_NULL_buffer_fails)
+{
+    ///arrange
+
+    ///act
+    METHODRETURN_HANDLE h = MethodReturn_CreateFromSerializedBuffer(1, NULL, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(h);
+}
+
+/*Tests_SRS_METHODRETURN_41_005: [ MethodReturn_CreateFromSerializedBuffer shall create a non-NULL handle containing statusCode and taking the ownership of buffer, without copying or parsing it. ]*/
+TEST_FUNCTION(MethodReturn_CreateFromSerializedBuffer_takes_the_buffer)
+{
+    ///arrange
+    unsigned char* buffer = (unsigned char*)my_gballoc_malloc(2);
+    buffer[0] = '4';
+    buffer[1] = '2';
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+
+    ///act
+    METHODRETURN_HANDLE h = MethodReturn_CreateFromSerializedBuffer(3, buffer, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(h);
+    const METHODRETURN_DATA* data = MethodReturn_GetReturn(h);
+    ASSERT_ARE_EQUAL(int, 3, data->statusCode);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)buffer, (void*)data->jsonValue);
+    ASSERT_ARE_EQUAL(size_t, 2, data->jsonValueSize);
+
+    ///clean
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_free(buffer));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+    MethodReturn_Destroy(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_METHODRETURN_41_006: [ If any failure is encountered then MethodReturn_CreateFromSerializedBuffer shall return NULL and the caller keeps the ownership of buffer. ]*/
+TEST_FUNCTION(MethodReturn_CreateFromSerializedBuffer_fails_when_malloc_fails)
+{
+    ///arrange
+    unsigned char buffer[1] = { '1' };
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size()
+        .SetReturn(NULL);
+
+    ///act
+    METHODRETURN_HANDLE h = MethodReturn_CreateFromSerializedBuffer(3, buffer, sizeof(buffer));
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(h);
+}
+
+/*Tests_SRS_METHODRETURN_41_007: [ If handle or size is NULL then MethodReturn_DetachBuffer shall fail and return NULL. ]*/
+TEST_FUNCTION(MethodReturn_DetachBuffer_with_NULL_handle_fails)
+{
+    ///arrange
+    size_t size;
+
+    ///act
+    unsigned char* buffer = MethodReturn_DetachBuffer(NULL, &size);
+
+    ///assert
+    ASSERT_IS_NULL(buffer);
+}
+
+/*Tests_SRS_METHODRETURN_41_009: [ Otherwise, MethodReturn_DetachBuffer shall set *size to the size of the JSON value, return it and hand its ownership to the caller, who releases it with free. ]*/
+TEST_FUNCTION(MethodReturn_DetachBuffer_hands_over_the_json_value)
+{
+    ///arrange
+    METHODRETURN_HANDLE h = MethodReturn_Create(1, "1234");
+    size_t size = 0;
+    umock_c_reset_all_calls();
+
+    ///act
+    unsigned char* buffer = MethodReturn_DetachBuffer(h, &size);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(buffer);
+    ASSERT_ARE_EQUAL(size_t, 4, size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp("1234", buffer, 4));
+    ASSERT_IS_NULL(MethodReturn_GetReturn(h)->jsonValue);
+
+    ///clean
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+    MethodReturn_Destroy(h); /*only the handle is freed*/
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    my_gballoc_free(buffer);
+}
+
+/*Tests_SRS_METHODRETURN_41_008: [ If handle does not own its JSON value then MethodReturn_DetachBuffer shall return NULL and leave handle unchanged. ]*/
+TEST_FUNCTION(MethodReturn_DetachBuffer_of_a_borrowed_buffer_returns_NULL)
+{
+    ///arrange
+    const char* jsonValue = "1";
+    METHODRETURN_HANDLE h = MethodReturn_CreateFromBorrowedBuffer(1, jsonValue, 1, NULL, NULL);
+    size_t size = 0;
+    umock_c_reset_all_calls();
+
+    ///act
+    unsigned char* buffer = MethodReturn_DetachBuffer(h, &size);
+
+    ///assert
+    ASSERT_IS_NULL(buffer);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)jsonValue, (void*)MethodReturn_GetReturn(h)->jsonValue);
+
+    ///clean
+    MethodReturn_Destroy(h);
+}
+
 END_TEST_SUITE(methodreturn_ut);
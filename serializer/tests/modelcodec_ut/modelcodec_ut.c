@@ -0,0 +1,495 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* s)
+{
+    free(s);
+}
+
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "modelcodec.h"
+#include "testrunnerswitcher.h"
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+typedef char* ascii_char_ptr;
+
+/*the struct DECLARE_MODEL declares for a model with these fields*/
+typedef struct TestModel_TAG
+{
+    int temperature;
+    double humidity;
+    bool isOn;
+    ascii_char_ptr name;
+    int8_t level;
+} TestModel;
+
+DECLARE_MODEL_CODEC(TestModel, int, temperature, double, humidity, bool, isOn, ascii_char_ptr, name, int8_t, level)
+
+/*the struct DECLARE_MODEL declares for WITH_ARRAY(float, samples, 4) and WITH_ARRAY(int16_t, counts, 2)*/
+typedef struct TestArrays_TAG
+{
+    struct { size_t length; float values[4]; } samples;
+    struct { size_t length; int16_t values[2]; } counts;
+} TestArrays;
+
+DECLARE_MODEL_CODEC(TestArrays, array_float, samples, array_int16_t, counts)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static void assert_encoded(unsigned char* destination, size_t destinationSize, const char* expected)
+{
+    ASSERT_ARE_EQUAL(size_t, strlen(expected), destinationSize);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected, destination, destinationSize));
+    my_gballoc_free(destination);
+}
+
+BEGIN_TEST_SUITE(ModelCodec_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        (void)umock_c_init(on_umock_c_error);
+        (void)umocktypes_charptr_register_types();
+        (void)umocktypes_stdint_register_types();
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        umock_c_deinit();
+
+        TEST_MUTEX_DESTROY(g_testByTest);
+        TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest))
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_010: [ ModelCodec_WriteInt64 shall write value in decimal, preceded by - when it is negative. ]*/
+    TEST_FUNCTION(ModelCodec_WriteInt64_writes_the_limits)
+    {
+        ///arrange
+        char destination[MODEL_CODEC_MAX_INTEGER_LENGTH];
+
+        ///act
+        int minimumLength = ModelCodec_WriteInt64(destination, INT64_MIN);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 20, minimumLength);
+        ASSERT_ARE_EQUAL(int, 0, memcmp("-9223372036854775808", destination, 20));
+        ASSERT_ARE_EQUAL(int, 1, ModelCodec_WriteInt64(destination, 0));
+        ASSERT_ARE_EQUAL(char, '0', destination[0]);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_012: [ ModelCodec_WriteDouble and ModelCodec_WriteFloat shall write NaN, INF and -INF for the values that are not numbers, otherwise the value in fixed notation with DBL_DIG, respectively FLT_DIG, decimals. ]*/
+    TEST_FUNCTION(ModelCodec_WriteDouble_writes_NaN)
+    {
+        ///arrange
+        char destination[MODEL_CODEC_MAX_DOUBLE_LENGTH];
+
+        ///act
+        int result = ModelCodec_WriteDouble(destination, NAN);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 3, result);
+        ASSERT_ARE_EQUAL(int, 0, memcmp("NaN", destination, 3));
+    }
+
+    /*Tests_SRS_MODELCODEC_41_015: [ ModelCodec_WriteString shall write value between quotes, with ", \ and / escaped by \ and the control characters as \u00XX. ]*/
+    TEST_FUNCTION(ModelCodec_WriteString_escapes)
+    {
+        ///arrange
+        char destination[32];
+
+        ///act
+        int result = ModelCodec_WriteString(destination, "a\"\\/\n");
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 15, result);
+        ASSERT_ARE_EQUAL(int, 0, memcmp("\"a\\\"\\\\\\/\\u000A\"", destination, 15));
+    }
+
+    /*Tests_SRS_MODELCODEC_41_016: [ If value has a character that is not ASCII, ModelCodec_WriteString shall fail and return a negative number. ]*/
+    TEST_FUNCTION(ModelCodec_WriteString_with_non_ASCII_fails)
+    {
+        ///arrange
+        char destination[32];
+
+        ///act
+        int result = ModelCodec_WriteString(destination, "\xC3\xA9");
+
+        ///assert
+        ASSERT_IS_TRUE(result < 0);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_002: [ If instance, destination or destinationSize is NULL, ModelCodec_Encode_modelName shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_ENCODE_with_NULL_instance_fails)
+    {
+        ///arrange
+        unsigned char* destination;
+        size_t destinationSize;
+
+        ///act
+        int result = MODEL_CODEC_ENCODE(TestModel, NULL, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODELCODEC_41_003: [ ModelCodec_Encode_modelName shall allocate one buffer, as large as the keys and the longest text of each value. ]*/
+    /*Tests_SRS_MODELCODEC_41_004: [ ModelCodec_Encode_modelName shall write the fields in the order they are listed, as SERIALIZE of the same fields writes them. ]*/
+    /*Tests_SRS_MODELCODEC_41_006: [ On success ModelCodec_Encode_modelName shall give the buffer and its length to the caller, who frees it, and return 0. ]*/
+    TEST_FUNCTION(MODEL_CODEC_ENCODE_writes_the_fields)
+    {
+        ///arrange
+        TestModel model = { -42, 21.5, true, (ascii_char_ptr)"room", 7 };
+        unsigned char* destination;
+        size_t destinationSize;
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+        ///act
+        int result = MODEL_CODEC_ENCODE(TestModel, &model, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        assert_encoded(destination, destinationSize, "{\"temperature\":-42, \"humidity\":21.500000000000000, \"isOn\":true, \"name\":\"room\", \"level\":7}");
+    }
+
+    /*Tests_SRS_MODELCODEC_41_003: [ ModelCodec_Encode_modelName shall allocate one buffer, as large as the keys and the longest text of each value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_ENCODE_when_malloc_fails_fails)
+    {
+        ///arrange
+        TestModel model = { -42, 21.5, true, (ascii_char_ptr)"room", 7 };
+        unsigned char* destination;
+        size_t destinationSize;
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .SetReturn(NULL);
+
+        ///act
+        int result = MODEL_CODEC_ENCODE(TestModel, &model, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODELCODEC_41_005: [ If a value cannot be written, ModelCodec_Encode_modelName shall free the buffer and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_ENCODE_with_NULL_string_fails)
+    {
+        ///arrange
+        TestModel model = { -42, 21.5, true, NULL, 7 };
+        unsigned char* destination;
+        size_t destinationSize;
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        ///act
+        int result = MODEL_CODEC_ENCODE(TestModel, &model, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODELCODEC_41_007: [ If instance or json is NULL, ModelCodec_Decode_modelName shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_with_NULL_json_fails)
+    {
+        ///arrange
+        TestModel model = { 0, 0.0, false, NULL, 0 };
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestModel, &model, NULL);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODELCODEC_41_008: [ ModelCodec_Decode_modelName shall read the value of a key named as a listed field into that field, and skip the value of any other key. ]*/
+    /*Tests_SRS_MODELCODEC_41_021: [ ModelCodec_SkipValue shall move the reader after the value it is at, a string, an object or an array with all they hold, a number or a literal. ]*/
+    /*Tests_SRS_MODELCODEC_41_027: [ ModelCodec_ReadString shall read a JSON string with its escapes, and fail for any other value or for a \u escape of a character that is not ASCII. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_reads_the_fields_and_skips_the_others)
+    {
+        ///arrange
+        TestModel model = { 0, 0.0, false, NULL, 0 };
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestModel, &model, " { \"other\": {\"a\":[1, {\"}\":\"]\"}]}, \"temperature\" : -5, \"isOn\":true, \"name\":\"r\\u0041\\/m\", \"humidity\":1.25 } ");
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, -5, model.temperature);
+        ASSERT_IS_TRUE(model.isOn);
+        ASSERT_ARE_EQUAL(char_ptr, "rA/m", model.name);
+        ASSERT_ARE_EQUAL(double, 1.25, model.humidity);
+
+        ///cleanup
+        my_gballoc_free(model.name);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_028: [ ModelCodec_ReadString shall free the previous string of destination and set it to the string read. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_frees_the_previous_string)
+    {
+        ///arrange
+        TestModel model = { 0, 0.0, false, NULL, 0 };
+        model.name = (ascii_char_ptr)my_gballoc_malloc(2);
+        (void)strcpy(model.name, "x");
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestModel, &model, "{\"name\":\"y\"}");
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(char_ptr, "y", model.name);
+
+        ///cleanup
+        my_gballoc_free(model.name);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_024: [ If the value is not an integer in the range of the type, the integer readers shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_with_out_of_range_integer_fails)
+    {
+        ///arrange
+        TestModel model = { 0, 0.0, false, NULL, 0 };
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestModel, &model, "{\"level\":128}");
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(int, 0, model.level);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_024: [ If the value is not an integer in the range of the type, the integer readers shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_with_fraction_for_integer_fails)
+    {
+        ///arrange
+        TestModel model = { 0, 0.0, false, NULL, 0 };
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestModel, &model, "{\"temperature\":1.5}");
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_019: [ If anything but whitespace follows the end of the object, ModelCodec_NextKey shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_with_trailing_characters_fails)
+    {
+        ///arrange
+        TestModel model = { 0, 0.0, false, NULL, 0 };
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestModel, &model, "{\"temperature\":1} x");
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_017: [ If json is not a JSON object, ModelCodec_BeginObject shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_with_array_fails)
+    {
+        ///arrange
+        TestModel model = { 0, 0.0, false, NULL, 0 };
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestModel, &model, "[1]");
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_004: [ ModelCodec_Encode_modelName shall write the fields in the order they are listed, as SERIALIZE of the same fields writes them. ]*/
+    /*Tests_SRS_MODELCODEC_41_026: [ ModelCodec_ReadDouble and ModelCodec_ReadFloat shall read a JSON number, or the NaN, INF and -INF the writers write, and fail for any other value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_reads_what_MODEL_CODEC_ENCODE_writes)
+    {
+        ///arrange
+        TestModel model = { INT32_MIN, -INFINITY, false, (ascii_char_ptr)"\t\"quoted\"", -128 };
+        TestModel decoded = { 0, 0.0, true, NULL, 0 };
+        unsigned char* destination;
+        size_t destinationSize;
+        char* json;
+        int result;
+
+        ASSERT_ARE_EQUAL(int, 0, MODEL_CODEC_ENCODE(TestModel, &model, &destination, &destinationSize));
+        json = (char*)my_gballoc_malloc(destinationSize + 1);
+        (void)memcpy(json, destination, destinationSize);
+        json[destinationSize] = '\0';
+        umock_c_reset_all_calls();
+
+        ///act
+        result = MODEL_CODEC_DECODE(TestModel, &decoded, json);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(int, INT32_MIN, decoded.temperature);
+        ASSERT_IS_TRUE(ISNEGATIVEINFINITY(decoded.humidity));
+        ASSERT_IS_FALSE(decoded.isOn);
+        ASSERT_ARE_EQUAL(char_ptr, "\t\"quoted\"", decoded.name);
+        ASSERT_ARE_EQUAL(int, -128, decoded.level);
+
+        ///cleanup
+        my_gballoc_free(decoded.name);
+        my_gballoc_free(json);
+        my_gballoc_free(destination);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_031: [ ModelCodec_WriteArray shall write the values between brackets, separated by ", ", each as the writer of its type writes it. ]*/
+    TEST_FUNCTION(MODEL_CODEC_ENCODE_writes_the_arrays)
+    {
+        ///arrange
+        TestArrays arrays = { { 2, { 1.5f, -2.0f } }, { 0, { 0 } } };
+        unsigned char* destination;
+        size_t destinationSize;
+
+        ///act
+        int result = MODEL_CODEC_ENCODE(TestArrays, &arrays, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        assert_encoded(destination, destinationSize, "{\"samples\":[1.500000, -2.000000], \"counts\":[]}");
+    }
+
+    /*Tests_SRS_MODELCODEC_41_030: [ If values is NULL while length is not 0, or elementType and elementSize are not those of an EDM_ARRAY, ModelCodec_WriteArray shall fail and return a negative number. ]*/
+    TEST_FUNCTION(ModelCodec_WriteArray_with_unsupported_elementSize_fails)
+    {
+        ///arrange
+        char destination[64];
+        int16_t values[1] = { 1 };
+
+        ///act
+        int result = ModelCodec_WriteArray(destination, EDM_SINGLE_TYPE, sizeof(int16_t), values, 1);
+
+        ///assert
+        ASSERT_IS_TRUE(result < 0);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_005: [ If a value cannot be written, ModelCodec_Encode_modelName shall free the buffer and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_ENCODE_with_length_over_capacity_fails)
+    {
+        ///arrange
+        TestArrays arrays = { { 5, { 0 } }, { 0, { 0 } } };
+        unsigned char* destination;
+        size_t destinationSize;
+
+        ///act
+        int result = MODEL_CODEC_ENCODE(TestArrays, &arrays, &destination, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_032: [ ModelCodec_ReadArray shall read the values of a JSON array straight into values, each as the reader of its type reads it, and set length to their count. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_reads_the_arrays)
+    {
+        ///arrange
+        TestArrays arrays = { { 0, { 0 } }, { 0, { 0 } } };
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestArrays, &arrays, "{\"samples\": [ 0.5 , -1, 2e1 ], \"counts\":[-32768,32767]}");
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 3, arrays.samples.length);
+        ASSERT_ARE_EQUAL(float, 0.5f, arrays.samples.values[0]);
+        ASSERT_ARE_EQUAL(float, -1.0f, arrays.samples.values[1]);
+        ASSERT_ARE_EQUAL(float, 20.0f, arrays.samples.values[2]);
+        ASSERT_ARE_EQUAL(size_t, 2, arrays.counts.length);
+        ASSERT_ARE_EQUAL(int, -32768, arrays.counts.values[0]);
+        ASSERT_ARE_EQUAL(int, 32767, arrays.counts.values[1]);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_033: [ If the value is not a JSON array, it has more than capacity values or one of them is not of elementType, ModelCodec_ReadArray shall set length to 0 and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_with_more_values_than_capacity_fails)
+    {
+        ///arrange
+        TestArrays arrays = { { 1, { 0 } }, { 0, { 0 } } };
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestArrays, &arrays, "{\"samples\":[1, 2, 3, 4, 5]}");
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 0, arrays.samples.length);
+    }
+
+    /*Tests_SRS_MODELCODEC_41_033: [ If the value is not a JSON array, it has more than capacity values or one of them is not of elementType, ModelCodec_ReadArray shall set length to 0 and return a non-zero value. ]*/
+    TEST_FUNCTION(MODEL_CODEC_DECODE_with_out_of_range_array_value_fails)
+    {
+        ///arrange
+        TestArrays arrays = { { 0, { 0 } }, { 1, { 0 } } };
+
+        ///act
+        int result = MODEL_CODEC_DECODE(TestArrays, &arrays, "{\"counts\":[32768]}");
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 0, arrays.counts.length);
+    }
+
+END_TEST_SUITE(ModelCodec_ut)
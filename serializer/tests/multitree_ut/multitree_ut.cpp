@@ -2244,4 +2244,114 @@ TEST_FUNCTION(MultiTree_SetValue_On_A_Node_That_Has_A_Value_Fails)
     mocks.ResetAllCalls(); /*not caring about what gets called*/
 }
 
+/* Children lookup */
+
+#define MANY_CHILDREN_COUNT 20
+
+static void addManyChildren(MULTITREE_HANDLE treeHandle)
+{
+    size_t i;
+    for (i = 0; i < MANY_CHILDREN_COUNT; i++)
+    {
+        char childName[16];
+        /*names are added in descending order so the index order differs from the insertion order*/
+        (void)sprintf(childName, "child%02u", (unsigned int)(MANY_CHILDREN_COUNT - i));
+        (void)MultiTree_AddLeaf(treeHandle, childName, (void*)childName);
+    }
+}
+
+/* Tests_SRS_MULTITREE_41_001: [ When a node reaches CHILD_INDEX_THRESHOLD children, it shall build an index of its children sorted by name and use it to look up children by name. ]*/
+/* Tests_SRS_MULTITREE_41_002: [ Children added to a node that already has an index shall be inserted in the index. ]*/
+TEST_FUNCTION(MultiTree_GetChildByName_With_Many_Children_Finds_All_Children)
+{
+    ///arrange
+    CMultiTreeMocks mocks;
+    MULTITREE_HANDLE treeHandle = MultiTree_Create(StringClone, StringFree);
+    size_t i;
+    addManyChildren(treeHandle);
+
+    ///act & assert
+    for (i = 1; i <= MANY_CHILDREN_COUNT; i++)
+    {
+        char childName[16];
+        MULTITREE_HANDLE childHandle;
+        const char* childValue;
+        (void)sprintf(childName, "child%02u", (unsigned int)i);
+        ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_GetChildByName(treeHandle, childName, &childHandle));
+        (void)MultiTree_GetValue(childHandle, (const void**)&childValue);
+        ASSERT_ARE_EQUAL(char_ptr, childName, childValue);
+    }
+
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_ALREADY_HAS_A_VALUE, MultiTree_AddLeaf(treeHandle, "child07", (void*)"again"));
+
+    MultiTree_Destroy(treeHandle);
+    mocks.ResetAllCalls(); /*not caring about what gets called*/
+}
+
+/* Tests_SRS_MULTITREE_41_001: [ When a node reaches CHILD_INDEX_THRESHOLD children, it shall build an index of its children sorted by name and use it to look up children by name. ]*/
+TEST_FUNCTION(MultiTree_GetChildByName_With_Many_Children_Does_Not_Find_Missing_Child)
+{
+    ///arrange
+    CMultiTreeMocks mocks;
+    MULTITREE_HANDLE treeHandle = MultiTree_Create(StringClone, StringFree);
+    MULTITREE_HANDLE childHandle;
+    addManyChildren(treeHandle);
+
+    ///act & assert
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_CHILD_NOT_FOUND, MultiTree_GetChildByName(treeHandle, "child00", &childHandle));
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_CHILD_NOT_FOUND, MultiTree_GetChildByName(treeHandle, "child99", &childHandle));
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_CHILD_NOT_FOUND, MultiTree_GetChildByName(treeHandle, "child1", &childHandle));
+
+    MultiTree_Destroy(treeHandle);
+    mocks.ResetAllCalls(); /*not caring about what gets called*/
+}
+
+/* Tests_SRS_MULTITREE_41_004: [ The order of the children as seen by MultiTree_GetChild shall remain the order in which they were added. ]*/
+TEST_FUNCTION(MultiTree_GetChild_With_Many_Children_Keeps_Insertion_Order)
+{
+    ///arrange
+    CMultiTreeMocks mocks;
+    MULTITREE_HANDLE treeHandle = MultiTree_Create(StringClone, StringFree);
+    size_t i;
+    addManyChildren(treeHandle);
+
+    ///act & assert
+    for (i = 0; i < MANY_CHILDREN_COUNT; i++)
+    {
+        char childName[16];
+        MULTITREE_HANDLE childHandle;
+        STRING_HANDLE actualName = STRING_new();
+        (void)sprintf(childName, "child%02u", (unsigned int)(MANY_CHILDREN_COUNT - i));
+        ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_GetChild(treeHandle, i, &childHandle));
+        (void)MultiTree_GetName(childHandle, actualName);
+        ASSERT_ARE_EQUAL(char_ptr, childName, STRING_c_str(actualName));
+        STRING_delete(actualName);
+    }
+
+    MultiTree_Destroy(treeHandle);
+    mocks.ResetAllCalls(); /*not caring about what gets called*/
+}
+
+/* Tests_SRS_MULTITREE_41_003: [ If the index cannot be allocated or grown, the node shall drop the index and look up its children by a linear scan. ]*/
+TEST_FUNCTION(MultiTree_AddLeaf_When_The_Children_Index_Cannot_Be_Allocated_Still_Finds_Children)
+{
+    ///arrange
+    CMultiTreeMocks mocks;
+    MULTITREE_HANDLE treeHandle = MultiTree_Create(StringClone, StringFree);
+    MULTITREE_HANDLE childHandle;
+    /*1 malloc for the root, 3 mallocs (node, name, value) for each of the first 8 children, then the index*/
+    whenShallmalloc_fail = 1 + 8 * 3 + 1;
+
+    ///act
+    addManyChildren(treeHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_GetChildByName(treeHandle, "child13", &childHandle));
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_GetChildByName(treeHandle, "child01", &childHandle));
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_ALREADY_HAS_A_VALUE, MultiTree_AddLeaf(treeHandle, "child20", (void*)"again"));
+
+    MultiTree_Destroy(treeHandle);
+    mocks.ResetAllCalls(); /*not caring about what gets called*/
+}
+
 END_TEST_SUITE(MultiTree_ut)
@@ -6503,4 +6503,296 @@ BEGIN_TEST_SUITE(Schema_ut)
         ///clean
         Schema_Destroy(schemaHandle);
     }
+
+    /* Schema_BuildLookupIndexes */
+
+#define INDEXED_ELEMENT_COUNT 20
+
+    static void addIndexedElements(SCHEMA_HANDLE schemaHandle, SCHEMA_MODEL_TYPE_HANDLE modelType)
+    {
+        size_t i;
+        for (i = 0; i < INDEXED_ELEMENT_COUNT; i++)
+        {
+            char name[32];
+            (void)sprintf(name, "model%u", (unsigned int)i);
+            (void)Schema_CreateModelType(schemaHandle, name);
+            (void)sprintf(name, "property%u", (unsigned int)i);
+            (void)Schema_AddModelProperty(modelType, name, "int");
+            (void)sprintf(name, "reported%u", (unsigned int)i);
+            (void)Schema_AddModelReportedProperty(modelType, name, "int");
+            (void)sprintf(name, "desired%u", (unsigned int)i);
+            (void)Schema_AddModelDesiredProperty(modelType, name, "int", g_pfDesiredPropertyFromAGENT_DATA_TYPE, g_pfDesiredPropertyInitialize, g_pfDesiredPropertyDeinitialize, 0, NULL);
+            (void)sprintf(name, "action%u", (unsigned int)i);
+            (void)Schema_CreateModelAction(modelType, name);
+            (void)sprintf(name, "method%u", (unsigned int)i);
+            (void)Schema_CreateModelMethod(modelType, name);
+        }
+    }
+
+    /*Tests_SRS_SCHEMA_41_001: [ If schemaHandle is NULL then Schema_BuildLookupIndexes shall fail and return SCHEMA_INVALID_ARG. ]*/
+    TEST_FUNCTION(Schema_BuildLookupIndexes_with_NULL_schemaHandle_fails)
+    {
+        ///arrange
+
+        ///act
+        SCHEMA_RESULT result = Schema_BuildLookupIndexes(NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_SCHEMA_41_005: [ Otherwise Schema_BuildLookupIndexes shall succeed and return SCHEMA_OK. ]*/
+    TEST_FUNCTION(Schema_BuildLookupIndexes_on_a_small_schema_does_not_allocate)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        (void)Schema_AddModelProperty(modelType, "a", "int");
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)) /*reported properties*/
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)) /*desired properties*/
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)) /*methods*/
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)) /*models in model*/
+            .IgnoreArgument_handle();
+
+        ///act
+        SCHEMA_RESULT result = Schema_BuildLookupIndexes(schemaHandle);
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
+    /*Tests_SRS_SCHEMA_41_002: [ Lookups by name shall use the index built by Schema_BuildLookupIndexes while the indexed collection has not changed size, otherwise they shall scan the collection. ]*/
+    /*Tests_SRS_SCHEMA_41_003: [ Schema_BuildLookupIndexes shall build a name index for the models and struct types of the schema, and for the properties, reported properties, desired properties, actions, methods and models in model of every model, and for the properties of every struct type, that have at least SCHEMA_NAME_INDEX_THRESHOLD elements. ]*/
+    /*Tests_SRS_SCHEMA_41_005: [ Otherwise Schema_BuildLookupIndexes shall succeed and return SCHEMA_OK. ]*/
+    TEST_FUNCTION(Schema_BuildLookupIndexes_succeeds_and_lookups_find_all_elements)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        size_t i;
+        addIndexedElements(schemaHandle, modelType);
+
+        ///act
+        SCHEMA_RESULT result = Schema_BuildLookupIndexes(schemaHandle);
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_OK, result);
+        for (i = 0; i < INDEXED_ELEMENT_COUNT; i++)
+        {
+            char name[32];
+            (void)sprintf(name, "model%u", (unsigned int)i);
+            ASSERT_IS_NOT_NULL(Schema_GetModelByName(schemaHandle, name));
+            (void)sprintf(name, "property%u", (unsigned int)i);
+            ASSERT_ARE_EQUAL(char_ptr, name, Schema_GetPropertyName(Schema_GetModelPropertyByName(modelType, name)));
+            ASSERT_ARE_EQUAL(int, (int)SCHEMA_PROPERTY, (int)Schema_GetModelElementByName(modelType, name).elementType);
+            (void)sprintf(name, "reported%u", (unsigned int)i);
+            ASSERT_IS_NOT_NULL(Schema_GetModelReportedPropertyByName(modelType, name));
+            (void)sprintf(name, "desired%u", (unsigned int)i);
+            ASSERT_IS_NOT_NULL(Schema_GetModelDesiredPropertyByName(modelType, name));
+            (void)sprintf(name, "action%u", (unsigned int)i);
+            ASSERT_ARE_EQUAL(char_ptr, name, Schema_GetModelActionName(Schema_GetModelActionByName(modelType, name)));
+            ASSERT_ARE_EQUAL(int, (int)SCHEMA_MODEL_ACTION, (int)Schema_GetModelElementByName(modelType, name).elementType);
+            (void)sprintf(name, "method%u", (unsigned int)i);
+            ASSERT_IS_NOT_NULL(Schema_GetModelMethodByName(modelType, name));
+        }
+        ASSERT_IS_NULL(Schema_GetModelByName(schemaHandle, "model99"));
+        ASSERT_IS_NULL(Schema_GetModelPropertyByName(modelType, "property99"));
+        ASSERT_IS_NULL(Schema_GetModelReportedPropertyByName(modelType, "reported99"));
+        ASSERT_IS_NULL(Schema_GetModelDesiredPropertyByName(modelType, "desired99"));
+        ASSERT_IS_NULL(Schema_GetModelActionByName(modelType, "action99"));
+        ASSERT_IS_NULL(Schema_GetModelMethodByName(modelType, "method99"));
+        ASSERT_ARE_EQUAL(int, (int)SCHEMA_NOT_FOUND, (int)Schema_GetModelElementByName(modelType, "property99").elementType);
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
+    /*Tests_SRS_SCHEMA_41_002: [ Lookups by name shall use the index built by Schema_BuildLookupIndexes while the indexed collection has not changed size, otherwise they shall scan the collection. ]*/
+    TEST_FUNCTION(Schema_GetModelPropertyByName_finds_a_property_added_after_Schema_BuildLookupIndexes)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        addIndexedElements(schemaHandle, modelType);
+        (void)Schema_BuildLookupIndexes(schemaHandle);
+        (void)Schema_AddModelProperty(modelType, "lateProperty", "int");
+
+        ///act
+        SCHEMA_PROPERTY_HANDLE lateProperty = Schema_GetModelPropertyByName(modelType, "lateProperty");
+        SCHEMA_PROPERTY_HANDLE earlyProperty = Schema_GetModelPropertyByName(modelType, "property7");
+
+        ///assert
+        ASSERT_IS_NOT_NULL(lateProperty);
+        ASSERT_IS_NOT_NULL(earlyProperty);
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
+    /*Tests_SRS_SCHEMA_41_004: [ If building any index fails then Schema_BuildLookupIndexes shall return SCHEMA_ERROR. Lookups in the collections without an index shall still succeed by scanning the collection. ]*/
+    TEST_FUNCTION(When_an_index_cannot_be_allocated_Schema_BuildLookupIndexes_fails_and_lookups_still_succeed)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        addIndexedElements(schemaHandle, modelType);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*the model types index*/
+            .IgnoreArgument_size()
+            .SetReturn(NULL);
+
+        ///act
+        SCHEMA_RESULT result = Schema_BuildLookupIndexes(schemaHandle);
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_ERROR, result);
+        ASSERT_IS_NOT_NULL(Schema_GetModelByName(schemaHandle, "model13"));
+        ASSERT_IS_NOT_NULL(Schema_GetModelPropertyByName(modelType, "property13"));
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
+    /* Schema_SetModelCommandMetadataCache / Schema_GetModelCommandMetadataCache */
+
+    /*Tests_SRS_SCHEMA_41_006: [ If modelTypeHandle or bytes is NULL, or size is 0, then Schema_SetModelCommandMetadataCache shall fail and return SCHEMA_INVALID_ARG. ]*/
+    TEST_FUNCTION(Schema_SetModelCommandMetadataCache_with_NULL_modelTypeHandle_fails)
+    {
+        ///arrange
+
+        ///act
+        SCHEMA_RESULT result = Schema_SetModelCommandMetadataCache(NULL, false, (const unsigned char*)"[]", 3);
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_SCHEMA_41_010: [ If modelTypeHandle, bytes or size is NULL then Schema_GetModelCommandMetadataCache shall fail and return SCHEMA_INVALID_ARG. ]*/
+    TEST_FUNCTION(Schema_GetModelCommandMetadataCache_with_NULL_bytes_fails)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        size_t size;
+
+        ///act
+        SCHEMA_RESULT result = Schema_GetModelCommandMetadataCache(modelType, false, NULL, &size);
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_INVALID_ARG, result);
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
+    /*Tests_SRS_SCHEMA_41_011: [ If nothing is cached in the form selected by compact then Schema_GetModelCommandMetadataCache shall return SCHEMA_ELEMENT_NOT_FOUND. ]*/
+    TEST_FUNCTION(Schema_GetModelCommandMetadataCache_on_a_new_model_returns_SCHEMA_ELEMENT_NOT_FOUND)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        const unsigned char* bytes;
+        size_t size;
+
+        ///act
+        SCHEMA_RESULT result = Schema_GetModelCommandMetadataCache(modelType, false, &bytes, &size);
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_ELEMENT_NOT_FOUND, result);
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
+    /*Tests_SRS_SCHEMA_41_007: [ Schema_SetModelCommandMetadataCache shall keep a copy of the size bytes at bytes as the command metadata of the model in the form selected by compact, replacing what was cached before, and return SCHEMA_OK. ]*/
+    /*Tests_SRS_SCHEMA_41_012: [ Otherwise Schema_GetModelCommandMetadataCache shall set *bytes and *size to the cached copy, which stays valid until the model is destroyed or an action is added to it, and return SCHEMA_OK. ]*/
+    TEST_FUNCTION(Schema_GetModelCommandMetadataCache_returns_a_copy_of_what_was_set)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        unsigned char json[] = "[]";
+        const unsigned char compact[] = { 0x80 };
+        const unsigned char* bytes;
+        size_t size;
+        SCHEMA_RESULT result1 = Schema_SetModelCommandMetadataCache(modelType, false, json, sizeof(json));
+        SCHEMA_RESULT result2 = Schema_SetModelCommandMetadataCache(modelType, true, compact, sizeof(compact));
+        json[0] = 'x';
+
+        ///act
+        SCHEMA_RESULT result3 = Schema_GetModelCommandMetadataCache(modelType, false, &bytes, &size);
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_OK, result1);
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_OK, result2);
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_OK, result3);
+        ASSERT_ARE_EQUAL(size_t, sizeof(json), size);
+        ASSERT_ARE_EQUAL(char_ptr, "[]", (const char*)bytes);
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_OK, Schema_GetModelCommandMetadataCache(modelType, true, &bytes, &size));
+        ASSERT_ARE_EQUAL(size_t, 1, size);
+        ASSERT_ARE_EQUAL(int, 0x80, bytes[0]);
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
+    /*Tests_SRS_SCHEMA_41_008: [ If any failure occurs, Schema_SetModelCommandMetadataCache shall fail and return SCHEMA_ERROR, keeping what was cached before. ]*/
+    TEST_FUNCTION(When_malloc_fails_Schema_SetModelCommandMetadataCache_fails_and_keeps_the_previous_copy)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        const unsigned char* bytes;
+        size_t size;
+        (void)Schema_SetModelCommandMetadataCache(modelType, false, (const unsigned char*)"[]", 3);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(3))
+            .SetReturn(NULL);
+
+        ///act
+        SCHEMA_RESULT result = Schema_SetModelCommandMetadataCache(modelType, false, (const unsigned char*)"{}", 3);
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        (void)Schema_GetModelCommandMetadataCache(modelType, false, &bytes, &size);
+        ASSERT_ARE_EQUAL(char_ptr, "[]", (const char*)bytes);
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
+    /*Tests_SRS_SCHEMA_41_009: [ Schema_CreateModelAction shall discard the cached command metadata of the model. ]*/
+    TEST_FUNCTION(Schema_CreateModelAction_discards_the_cached_command_metadata)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        const unsigned char* bytes;
+        size_t size;
+        (void)Schema_SetModelCommandMetadataCache(modelType, false, (const unsigned char*)"[]", 3);
+        (void)Schema_SetModelCommandMetadataCache(modelType, true, (const unsigned char*)"\x80", 1);
+
+        ///act
+        (void)Schema_CreateModelAction(modelType, "reset");
+
+        ///assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_ELEMENT_NOT_FOUND, Schema_GetModelCommandMetadataCache(modelType, false, &bytes, &size));
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_ELEMENT_NOT_FOUND, Schema_GetModelCommandMetadataCache(modelType, true, &bytes, &size));
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
 END_TEST_SUITE(Schema_ut)
@@ -281,6 +281,16 @@ public:
     MOCK_METHOD_END(CODEFIRST_RESULT, CODEFIRST_OK)
     MOCK_STATIC_METHOD_0(, void, CodeFirst_Deinit)
     MOCK_VOID_METHOD_END()
+    MOCK_STATIC_METHOD_1(, void, CodeFirst_SetDirectSerialization, bool, directSerialization)
+    MOCK_VOID_METHOD_END()
+    MOCK_STATIC_METHOD_1(, void, CodeFirst_SetCBOREncoding, bool, cborEncoding)
+    MOCK_VOID_METHOD_END()
+
+    /* CommandDecoder mocks */
+    MOCK_STATIC_METHOD_1(, void, CommandDecoder_SetStreamingDesiredProperties, bool, streamDesiredProperties)
+    MOCK_VOID_METHOD_END()
+    MOCK_STATIC_METHOD_1(, void, CommandDecoder_SetChangeOnlyDesiredProperties, bool, changeOnlyDesiredProperties)
+    MOCK_VOID_METHOD_END()
 
     /* Schema mocks */
     MOCK_STATIC_METHOD_1(, SCHEMA_HANDLE, Schema_GetSchemaForModelType, SCHEMA_MODEL_TYPE_HANDLE, modelHandle)
@@ -366,10 +376,14 @@ public:
     /* DataMarshaller mocks */
     MOCK_STATIC_METHOD_1(, void, DataMarshaller_SetMaxBufferSize, size_t, bytes)
     MOCK_VOID_METHOD_END()
+    MOCK_STATIC_METHOD_1(, void, DataMarshaller_SetCBOREncoding, bool, value)
+    MOCK_VOID_METHOD_END()
 
     /* DataPublisher mocks */
     MOCK_STATIC_METHOD_1(, void, DataPublisher_SetMaxBufferSize, size_t, bytes)
     MOCK_VOID_METHOD_END()
+    MOCK_STATIC_METHOD_1(, void, DataPublisher_SetTransactionArenaSize, size_t, value)
+    MOCK_VOID_METHOD_END()
 
     MOCK_STATIC_METHOD_2(, int, mallocAndStrcpy_s, char**, destination, const char*, source);
         int result2 = BASEIMPLEMENTATION::mallocAndStrcpy_s(destination, source);
@@ -378,6 +392,10 @@ public:
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , CODEFIRST_RESULT, CodeFirst_Init, const char*, overrideSchemaNamespace);
 DECLARE_GLOBAL_MOCK_METHOD_0(CIoTHubSchemaClientMocks, , void, CodeFirst_Deinit);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, CodeFirst_SetDirectSerialization, bool, directSerialization);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, CodeFirst_SetCBOREncoding, bool, cborEncoding);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, CommandDecoder_SetStreamingDesiredProperties, bool, streamDesiredProperties);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, CommandDecoder_SetChangeOnlyDesiredProperties, bool, changeOnlyDesiredProperties);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CIoTHubSchemaClientMocks, , STRING_HANDLE, STRING_new);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, STRING_delete, STRING_HANDLE, s);
@@ -404,7 +422,9 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubSchemaClientMocks, , AGENT_DATA_TYPES_RESULT
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubSchemaClientMocks, , AGENT_DATA_TYPES_RESULT, Create_AGENT_DATA_TYPE_from_EDM_BINARY, AGENT_DATA_TYPE*, agentData, EDM_BINARY, v);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, BufferProcess_SetRetryInterval, uint64_t, milliseconds);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, DataMarshaller_SetMaxBufferSize, size_t, bytes);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, DataMarshaller_SetCBOREncoding, bool, value);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, DataPublisher_SetMaxBufferSize, size_t, bytes);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubSchemaClientMocks, , void, DataPublisher_SetTransactionArenaSize, size_t, value);
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubSchemaClientMocks, , int, mallocAndStrcpy_s, char**, destination, const char*, source);
 
@@ -647,4 +667,85 @@ BEGIN_TEST_SUITE(serializer_ut)
             ASSERT_ARE_EQUAL(SERIALIZER_RESULT, SERIALIZER_OK, result);
         }
 
+        /* Tests_SRS_SCHEMALIB_41_001: [ When the which argument is SerializeDirectToBuffer, serializer_setconfig shall invoke CodeFirst_SetDirectSerialization with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+        TEST_FUNCTION(serializer_setconfig_passes_direct_serialization_to_codefirst)
+        {
+            // arrange
+            CNiceCallComparer<CIoTHubSchemaClientMocks> mocks;
+            bool directSerialization = true;
+
+            STRICT_EXPECTED_CALL(mocks, CodeFirst_SetDirectSerialization(true));
+
+            // act
+            SERIALIZER_RESULT result = serializer_setconfig(SerializeDirectToBuffer, &directSerialization);
+
+            // assert
+            ASSERT_ARE_EQUAL(SERIALIZER_RESULT, SERIALIZER_OK, result);
+        }
+
+        /* Tests_SRS_SCHEMALIB_41_002: [ When the which argument is IngestDesiredPropertiesStreaming, serializer_setconfig shall invoke CommandDecoder_SetStreamingDesiredProperties with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+        TEST_FUNCTION(serializer_setconfig_passes_streaming_desired_properties_to_commanddecoder)
+        {
+            // arrange
+            CNiceCallComparer<CIoTHubSchemaClientMocks> mocks;
+            bool streamDesiredProperties = true;
+
+            STRICT_EXPECTED_CALL(mocks, CommandDecoder_SetStreamingDesiredProperties(true));
+
+            // act
+            SERIALIZER_RESULT result = serializer_setconfig(IngestDesiredPropertiesStreaming, &streamDesiredProperties);
+
+            // assert
+            ASSERT_ARE_EQUAL(SERIALIZER_RESULT, SERIALIZER_OK, result);
+        }
+
+        /* Tests_SRS_SCHEMALIB_41_003: [ When the which argument is SerializeTransactionArenaSize, serializer_setconfig shall invoke DataPublisher_SetTransactionArenaSize with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+        TEST_FUNCTION(serializer_setconfig_passes_the_transaction_arena_size_to_datapublisher)
+        {
+            // arrange
+            CNiceCallComparer<CIoTHubSchemaClientMocks> mocks;
+            size_t arenaSize = 1024;
+
+            STRICT_EXPECTED_CALL(mocks, DataPublisher_SetTransactionArenaSize(1024));
+
+            // act
+            SERIALIZER_RESULT result = serializer_setconfig(SerializeTransactionArenaSize, &arenaSize);
+
+            // assert
+            ASSERT_ARE_EQUAL(SERIALIZER_RESULT, SERIALIZER_OK, result);
+        }
+
+        /* Tests_SRS_SCHEMALIB_41_004: [ When the which argument is SerializeAsCBOR, serializer_setconfig shall invoke DataMarshaller_SetCBOREncoding and CodeFirst_SetCBOREncoding with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+        TEST_FUNCTION(serializer_setconfig_turns_on_cbor_in_datamarshaller_and_codefirst)
+        {
+            // arrange
+            CNiceCallComparer<CIoTHubSchemaClientMocks> mocks;
+            bool asCBOR = true;
+
+            STRICT_EXPECTED_CALL(mocks, DataMarshaller_SetCBOREncoding(true));
+            STRICT_EXPECTED_CALL(mocks, CodeFirst_SetCBOREncoding(true));
+
+            // act
+            SERIALIZER_RESULT result = serializer_setconfig(SerializeAsCBOR, &asCBOR);
+
+            // assert
+            ASSERT_ARE_EQUAL(SERIALIZER_RESULT, SERIALIZER_OK, result);
+        }
+
+        /* Tests_SRS_SCHEMALIB_41_005: [ When the which argument is IngestDesiredPropertiesChangesOnly, serializer_setconfig shall invoke CommandDecoder_SetChangeOnlyDesiredProperties with the dereferenced value argument, and shall return SERIALIZER_OK. ]*/
+        TEST_FUNCTION(serializer_setconfig_turns_on_changes_only_desired_properties)
+        {
+            // arrange
+            CNiceCallComparer<CIoTHubSchemaClientMocks> mocks;
+            bool changesOnly = true;
+
+            STRICT_EXPECTED_CALL(mocks, CommandDecoder_SetChangeOnlyDesiredProperties(true));
+
+            // act
+            SERIALIZER_RESULT result = serializer_setconfig(IngestDesiredPropertiesChangesOnly, &changesOnly);
+
+            // assert
+            ASSERT_ARE_EQUAL(SERIALIZER_RESULT, SERIALIZER_OK, result);
+        }
+
 END_TEST_SUITE(serializer_ut)
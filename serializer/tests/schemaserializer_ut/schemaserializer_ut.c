@@ -4,9 +4,11 @@
 #ifdef __cplusplus
 #include <cstdlib>
 #include <cstddef>
+#include <cstring>
 #else
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #endif
 
 static void* my_gballoc_malloc(size_t t)
@@ -59,6 +61,19 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
     ASSERT_FAIL(temp_str); 
 }
 
+/*what SchemaSerializer handed to Schema_SetModelCommandMetadataCache the last time*/
+static unsigned char g_cachedBytes[256];
+static size_t g_cachedSize;
+static SCHEMA_RESULT my_Schema_SetModelCommandMetadataCache(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle, bool compact, const unsigned char* bytes, size_t size)
+{
+    (void)modelTypeHandle;
+    (void)compact;
+    ASSERT_IS_TRUE(size <= sizeof(g_cachedBytes));
+    (void)memcpy(g_cachedBytes, bytes, size);
+    g_cachedSize = size;
+    return SCHEMA_OK;
+}
+
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -92,6 +107,12 @@ BEGIN_TEST_SUITE(SchemaSerializer_ut)
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(Schema_GetModelActionArgumentByIndex, NULL);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(Schema_GetActionArgumentName, NULL);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(Schema_GetActionArgumentType, NULL);
+        REGISTER_GLOBAL_MOCK_RETURN(Schema_GetModelCommandMetadataCache, SCHEMA_ELEMENT_NOT_FOUND);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Schema_GetModelCommandMetadataCache, SCHEMA_ERROR);
+        REGISTER_GLOBAL_MOCK_HOOK(Schema_SetModelCommandMetadataCache, my_Schema_SetModelCommandMetadataCache);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Schema_SetModelCommandMetadataCache, SCHEMA_ERROR);
+        REGISTER_GLOBAL_MOCK_RETURN(STRING_new, TEST_STRING_HANDLE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_new, NULL);
 
     }
 
@@ -110,6 +131,7 @@ BEGIN_TEST_SUITE(SchemaSerializer_ut)
         }
 
         umock_c_reset_all_calls();
+        g_cachedSize = 0;
     }
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -645,5 +667,251 @@ BEGIN_TEST_SUITE(SchemaSerializer_ut)
         /// cleanup
         umock_c_negative_tests_deinit();
     }
+
+    /* SchemaSerializer_GetCommandMetadata */
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_001: [If modelHandle or schemaText is NULL, SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_INVALID_ARG.] */
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_With_NULL_model_handle_fails)
+    {
+        // arrange
+        const char* schemaText;
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(NULL, &schemaText);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_001: [If modelHandle or schemaText is NULL, SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_INVALID_ARG.] */
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_With_NULL_schemaText_fails)
+    {
+        // arrange
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(TEST_MODEL_HANDLE, NULL);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_002: [If the JSON command metadata of the model is cached by Schema_GetModelCommandMetadataCache, SchemaSerializer_GetCommandMetadata shall set *schemaText to it and return SCHEMA_SERIALIZER_OK.] */
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_returns_the_cached_text_without_walking_the_schema)
+    {
+        // arrange
+        static const unsigned char cachedText[] = "[]";
+        const unsigned char* cached = cachedText;
+        size_t cachedSize = sizeof(cachedText);
+        const char* schemaText;
+
+        STRICT_EXPECTED_CALL(Schema_GetModelCommandMetadataCache(TEST_MODEL_HANDLE, false, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &cached, sizeof(cached))
+            .CopyOutArgumentBuffer(4, &cachedSize, sizeof(cachedSize))
+            .SetReturn(SCHEMA_OK);
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(TEST_MODEL_HANDLE, &schemaText);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_OK, result);
+        ASSERT_ARE_EQUAL(void_ptr, (const void*)cachedText, (const void*)schemaText);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    static void SchemaSerializer_GetCommandMetadata_builds_and_caches_the_text_inert_path(const size_t* commandCount, const unsigned char** cached, const size_t* cachedSize)
+    {
+        STRICT_EXPECTED_CALL(Schema_GetModelCommandMetadataCache(TEST_MODEL_HANDLE, false, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(STRING_new());
+        SchemaSerializer_SerializeCommandMetadata_When_Command_Count_Is_0_Should_Yield_An_Empty_Commands_Array_inert_path(commandCount);
+        STRICT_EXPECTED_CALL(STRING_c_str(TEST_STRING_HANDLE))
+            .SetReturn("[]");
+        STRICT_EXPECTED_CALL(STRING_length(TEST_STRING_HANDLE))
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(Schema_SetModelCommandMetadataCache(TEST_MODEL_HANDLE, false, IGNORED_PTR_ARG, 3));
+        STRICT_EXPECTED_CALL(Schema_GetModelCommandMetadataCache(TEST_MODEL_HANDLE, false, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, cached, sizeof(*cached))
+            .CopyOutArgumentBuffer(4, cachedSize, sizeof(*cachedSize))
+            .SetReturn(SCHEMA_OK);
+        STRICT_EXPECTED_CALL(STRING_delete(TEST_STRING_HANDLE));
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_003: [Otherwise SchemaSerializer_GetCommandMetadata shall build the text with SchemaSerializer_SerializeCommandMetadata, cache it (including the '\0') with Schema_SetModelCommandMetadataCache and set *schemaText to the cached copy.] */
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_builds_and_caches_the_text)
+    {
+        // arrange
+        static const unsigned char cachedText[] = "[]";
+        const unsigned char* cached = cachedText;
+        size_t cachedSize = sizeof(cachedText);
+        size_t commandCount = 0;
+        const char* schemaText;
+
+        SchemaSerializer_GetCommandMetadata_builds_and_caches_the_text_inert_path(&commandCount, &cached, &cachedSize);
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(TEST_MODEL_HANDLE, &schemaText);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, (const void*)cachedText, (const void*)schemaText);
+        ASSERT_ARE_EQUAL(size_t, 3, g_cachedSize);
+        ASSERT_ARE_EQUAL(char_ptr, "[]", (const char*)g_cachedBytes);
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_004: [If any of the Schema or String APIs fail then SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_ERROR.] */
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_builds_and_caches_the_text_unhappy_paths)
+    {
+        // arrange
+        static const unsigned char cachedText[] = "[]";
+        const unsigned char* cached = cachedText;
+        size_t cachedSize = sizeof(cachedText);
+        size_t commandCount = 0;
+        umock_c_negative_tests_init();
+        SchemaSerializer_GetCommandMetadata_builds_and_caches_the_text_inert_path(&commandCount, &cached, &cachedSize);
+        umock_c_negative_tests_snapshot();
+
+        for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+        {
+            /*the first lookup failing only means "not cached", STRING_c_str, STRING_length and STRING_delete cannot fail*/
+            if ((i == 0) || (i == 5) || (i == 6) || (i == 9))
+            {
+                continue;
+            }
+
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+            char temp_str[128];
+            sprintf(temp_str, "On failed call %zu", i);
+            const char* schemaText;
+
+            ///act
+            SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(TEST_MODEL_HANDLE, &schemaText);
+
+            /// assert
+            ASSERT_ARE_EQUAL_WITH_MSG(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_ERROR, result, temp_str);
+        }
+
+        /// cleanup
+        umock_c_negative_tests_deinit();
+    }
+
+    /* SchemaSerializer_GetCommandMetadataCompact */
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_005: [If modelHandle, bytes or size is NULL, SchemaSerializer_GetCommandMetadataCompact shall return SCHEMA_SERIALIZER_INVALID_ARG.] */
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadataCompact_With_NULL_size_fails)
+    {
+        // arrange
+        const unsigned char* bytes;
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadataCompact(TEST_MODEL_HANDLE, &bytes, NULL);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_006: [If the compact command metadata of the model is cached by Schema_GetModelCommandMetadataCache, SchemaSerializer_GetCommandMetadataCompact shall set *bytes and *size to it and return SCHEMA_SERIALIZER_OK.] */
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadataCompact_returns_the_cached_bytes_without_walking_the_schema)
+    {
+        // arrange
+        static const unsigned char cachedBytes[] = { 0x80 };
+        const unsigned char* cached = cachedBytes;
+        size_t cachedSize = sizeof(cachedBytes);
+        const unsigned char* bytes;
+        size_t size;
+
+        STRICT_EXPECTED_CALL(Schema_GetModelCommandMetadataCache(TEST_MODEL_HANDLE, true, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &cached, sizeof(cached))
+            .CopyOutArgumentBuffer(4, &cachedSize, sizeof(cachedSize))
+            .SetReturn(SCHEMA_OK);
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadataCompact(TEST_MODEL_HANDLE, &bytes, &size);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_OK, result);
+        ASSERT_ARE_EQUAL(void_ptr, (const void*)cachedBytes, (const void*)bytes);
+        ASSERT_ARE_EQUAL(size_t, 1, size);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    static void SchemaSerializer_GetCommandMetadataCompact_1_Command_With_1_Argument_inert_path(const size_t* commandCount, const size_t* argCount)
+    {
+        STRICT_EXPECTED_CALL(Schema_GetModelCommandMetadataCache(TEST_MODEL_HANDLE, true, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Schema_GetModelActionCount(TEST_MODEL_HANDLE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, commandCount, sizeof(*commandCount));
+        STRICT_EXPECTED_CALL(Schema_GetModelActionByIndex(TEST_MODEL_HANDLE, 0))
+            .SetReturn(TEST_ACTION_1);
+        STRICT_EXPECTED_CALL(Schema_GetModelActionName(TEST_ACTION_1))
+            .SetReturn("Reset");
+        STRICT_EXPECTED_CALL(Schema_GetModelActionArgumentCount(TEST_ACTION_1, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, argCount, sizeof(*argCount));
+        STRICT_EXPECTED_CALL(Schema_GetModelActionArgumentByIndex(TEST_ACTION_1, 0))
+            .SetReturn(TEST_ARG_1);
+        STRICT_EXPECTED_CALL(Schema_GetActionArgumentName(TEST_ARG_1))
+            .SetReturn("v");
+        STRICT_EXPECTED_CALL(Schema_GetActionArgumentType(TEST_ARG_1))
+            .SetReturn("ascii_char_ptr");
+        STRICT_EXPECTED_CALL(Schema_SetModelCommandMetadataCache(TEST_MODEL_HANDLE, true, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(Schema_GetModelCommandMetadataCache(TEST_MODEL_HANDLE, true, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .SetReturn(SCHEMA_OK);
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_007: [Otherwise SchemaSerializer_GetCommandMetadataCompact shall encode the commands as a CBOR array holding, for every command, an array of its name and an array of [name, type] arrays for its arguments, with the types converted as for the JSON form.] */
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_008: [The encoding shall be cached with Schema_SetModelCommandMetadataCache and *bytes and *size shall be set to the cached copy.] */
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadataCompact_1_Command_With_1_Argument_Yields_The_Proper_CBOR)
+    {
+        // arrange
+        const unsigned char expected[] = { 0x81, 0x82, 0x65, 'R', 'e', 's', 'e', 't', 0x81, 0x82, 0x61, 'v', 0x66, 's', 't', 'r', 'i', 'n', 'g' };
+        size_t commandCount = 1;
+        size_t argCount = 1;
+        const unsigned char* bytes;
+        size_t size;
+
+        SchemaSerializer_GetCommandMetadataCompact_1_Command_With_1_Argument_inert_path(&commandCount, &argCount);
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadataCompact(TEST_MODEL_HANDLE, &bytes, &size);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, sizeof(expected), g_cachedSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expected, g_cachedBytes, sizeof(expected)));
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_009: [If any of the Schema APIs or memory allocation fail then SchemaSerializer_GetCommandMetadataCompact shall return SCHEMA_SERIALIZER_ERROR.] */
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadataCompact_1_Command_With_1_Argument_unhappy_paths)
+    {
+        // arrange
+        size_t commandCount = 1;
+        size_t argCount = 1;
+        umock_c_negative_tests_init();
+        SchemaSerializer_GetCommandMetadataCompact_1_Command_With_1_Argument_inert_path(&commandCount, &argCount);
+        umock_c_negative_tests_snapshot();
+
+        /*the first lookup failing only means "not cached"*/
+        for (size_t i = 1; i < umock_c_negative_tests_call_count(); i++)
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+            char temp_str[128];
+            sprintf(temp_str, "On failed call %zu", i);
+            const unsigned char* bytes;
+            size_t size;
+
+            ///act
+            SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadataCompact(TEST_MODEL_HANDLE, &bytes, &size);
+
+            /// assert
+            ASSERT_ARE_EQUAL_WITH_MSG(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_ERROR, result, temp_str);
+        }
+
+        /// cleanup
+        umock_c_negative_tests_deinit();
+    }
 END_TEST_SUITE(SchemaSerializer_ut)
 
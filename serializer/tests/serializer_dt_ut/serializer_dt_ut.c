@@ -229,8 +229,17 @@ static void reportedStateCallback(int status_code, void* userContextCallback)
     (void)userContextCallback;
 }
 
-static const METHODRETURN_DATA data1 = { 10, NULL };
-static const METHODRETURN_DATA data2 = { 11, "1234"};
+static const METHODRETURN_DATA data1 = { 10, NULL, 0 };
+static const METHODRETURN_DATA data2 = { 11, "1234", 4 };
+
+static unsigned char* my_MethodReturn_DetachBuffer(METHODRETURN_HANDLE handle, size_t* size)
+{
+    unsigned char* result = (unsigned char*)my_gballoc_malloc(4);
+    (void)handle;
+    (void)memcpy(result, "1234", 4);
+    *size = 4;
+    return result;
+}
 
 BEGIN_TEST_SUITE(serializer_dt_ut)
 
@@ -518,7 +527,7 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
     }
 
     /*Tests_SRS_SERIALIZERDEVICETWIN_02_001: [ serializer_ingest shall clone the payload into a null terminated string. ]*/
-    /*Tests_SRS_SERIALIZERDEVICETWIN_02_002: [ serializer_ingest shall parse the null terminated string into parson data types. ]*/
+    /*Tests_SRS_SERIALIZERDEVICETWIN_02_002: [ If update_state is not DEVICE_TWIN_UPDATE_PARTIAL then serializer_ingest shall parse the null terminated string into parson data types. ]*/
     /*Tests_SRS_SERIALIZERDEVICETWIN_02_003: [ If update_state is DEVICE_TWIN_UPDATE_COMPLETE then serializer_ingest shall locate "desired" json name. ]*/
     /*Tests_SRS_SERIALIZERDEVICETWIN_02_004: [ If "desired" contains "$version" then serializer_ingest shall remove it. ]*/
     /*Tests_SRS_SERIALIZERDEVICETWIN_02_005: [ The "desired" value shall be outputed to a null terminated string and serializer_ingest shall call CodeFirst_IngestDesiredProperties. ]*/
@@ -578,28 +587,14 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
     void serializer_ingest_DEVICE_TWIN_UPDATE_PARTIAL_inert_path(size_t payloadSize)
     {
         STRICT_EXPECTED_CALL(gballoc_malloc(payloadSize + 1));
-        STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
-            .IgnoreArgument_string();
-        STRICT_EXPECTED_CALL(json_value_get_object(IGNORED_PTR_ARG))
-            .IgnoreArgument_value();
-        STRICT_EXPECTED_CALL(json_object_remove(IGNORED_PTR_ARG, "$version"))
-            .IgnoreArgument_object();
-        STRICT_EXPECTED_CALL(json_serialize_to_string(IGNORED_PTR_ARG))
-            .IgnoreArgument_value();
         STRICT_EXPECTED_CALL(CodeFirst_IngestDesiredProperties(TEST_SERIALIZER_INGEST_CONTEXT, IGNORED_PTR_ARG))
             .IgnoreArgument_desiredProperties();
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument_ptr();
-        STRICT_EXPECTED_CALL(json_value_free(IGNORED_PTR_ARG))
-            .IgnoreArgument_value();
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument_ptr();
     }
 
     /*Tests_SRS_SERIALIZERDEVICETWIN_02_001: [ serializer_ingest shall clone the payload into a null terminated string. ]*/
-    /*Tests_SRS_SERIALIZERDEVICETWIN_02_002: [ serializer_ingest shall parse the null terminated string into parson data types. ]*/
-    /*Tests_SRS_SERIALIZERDEVICETWIN_02_006: [ If update_state is DEVICE_TWIN_UPDATE_PARTIAL then serializer_ingest shall remove "$version" (if it exists). ]*/
-    /*Tests_SRS_SERIALIZERDEVICETWIN_02_007: [ The JSON shall be outputed to a null terminated string and serializer_ingest shall call CodeFirst_IngestDesiredProperties. ]*/
+    /*Tests_SRS_SERIALIZERDEVICETWIN_41_001: [ If update_state is DEVICE_TWIN_UPDATE_PARTIAL then serializer_ingest shall call CodeFirst_IngestDesiredProperties with the null terminated string as is, without parsing it. ]*/
     TEST_FUNCTION(serializer_ingest_DEVICE_TWIN_UPDATE_PARTIAL_happy_path)
     {
         ///arrange
@@ -636,9 +631,7 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
             umock_c_negative_tests_fail_call(i);
 
             if (
-                (i != 8) && /*gballoc_free*/
-                (i != 9) && /*json_value_free*/
-                (i != 10)  /*gballoc_free*/
+                (i != 2) /*gballoc_free*/
                 )
             {
                 /// act
@@ -739,6 +732,9 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
         STRICT_EXPECTED_CALL(CodeFirst_ExecuteMethod(TEST_METHOD_CALLBACK_CONTEXT, "methodA", "3")); /*0x33 is the character '3'*/
         STRICT_EXPECTED_CALL(MethodReturn_GetReturn(TEST_METHODRETURN_HANDLE))
             .SetReturn(&data2);
+        STRICT_EXPECTED_CALL(MethodReturn_DetachBuffer(TEST_METHODRETURN_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument_size()
+            .SetReturn(NULL);
         STRICT_EXPECTED_CALL(gballoc_malloc(4)); /*answer is "1234"*/
         STRICT_EXPECTED_CALL(MethodReturn_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument_handle();
@@ -796,9 +792,10 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
         for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
         {
             if (
-                (i != 2) &&
-                (i != 4) &&
-                (i != 5)
+                (i != 2) && /*MethodReturn_GetReturn*/
+                (i != 3) && /*MethodReturn_DetachBuffer, returning NULL means "copy"*/
+                (i != 5) && /*MethodReturn_Destroy*/
+                (i != 6) /*gballoc_free*/
                 )
             {
                 umock_c_negative_tests_reset();
@@ -818,6 +815,40 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
         umock_c_negative_tests_deinit();
     }
 
+    /*Tests_SRS_SERIALIZERDEVICETWIN_41_002: [ If the METHODRETURN_HANDLE owns its JSON value then deviceMethodCallback shall hand that buffer over as *response by calling MethodReturn_DetachBuffer instead of copying it. ]*/
+    TEST_FUNCTION(deviceMethodCallback_hands_over_the_owned_buffer_without_copying)
+    {
+        ///arrange
+        const unsigned char payload = 0x33;
+        const size_t size = 1;
+        unsigned char* response;
+        size_t response_size;
+
+        REGISTER_GLOBAL_MOCK_HOOK(MethodReturn_DetachBuffer, my_MethodReturn_DetachBuffer);
+        STRICT_EXPECTED_CALL(gballoc_malloc(size + 1));
+        STRICT_EXPECTED_CALL(CodeFirst_ExecuteMethod(TEST_METHOD_CALLBACK_CONTEXT, "methodA", "3"));
+        STRICT_EXPECTED_CALL(MethodReturn_GetReturn(TEST_METHODRETURN_HANDLE))
+            .SetReturn(&data2);
+        STRICT_EXPECTED_CALL(MethodReturn_DetachBuffer(TEST_METHODRETURN_HANDLE, IGNORED_PTR_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MethodReturn_Destroy(TEST_METHODRETURN_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        int result = deviceMethodCallback("methodA", &payload, size, &response, &response_size, TEST_METHOD_CALLBACK_CONTEXT);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 11, result);
+        ASSERT_ARE_EQUAL(size_t, 4, response_size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp("1234", response, 4));
+
+        ///clean
+        REGISTER_GLOBAL_MOCK_HOOK(MethodReturn_DetachBuffer, NULL);
+        my_gballoc_free(response); /*normally the SDK does this*/
+    }
+
     static void IoTHubDeviceTwin_SendReportedState_Impl_inert_path(void* model)
     {
         //STRICT_EXPECTED_CALL(CodeFirst_SendAsyncReported) - this function cannot be mocked because it has ... arguments, therefore the poor version mock is used
@@ -0,0 +1,553 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "testrunnerswitcher.h"
+
+#include "serializer.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+/* The serializer perf tests time the hot paths of the serializer on the models of the serializer samples: SERIALIZE,
+   SERIALIZE_REPORTED_PROPERTIES, the ingestion of desired properties and the dispatch of actions and methods. Each
+   benchmark runs PERF_ITERATIONS operations after PERF_WARMUP_ITERATIONS unmeasured ones and prints one CSV line:
+
+       benchmark,config,iterations,ns/op,allocs/op,bytes/op
+
+   ns/op is CPU time (clock). allocs/op and bytes/op count the gballoc allocations, which are wrapped at link time where
+   the linker supports it; elsewhere those two columns are left empty. */
+
+#define PERF_ITERATIONS 10000
+#define PERF_WARMUP_ITERATIONS 100
+
+#ifdef PERF_COUNT_ALLOCATIONS
+/* the perf target is linked with --wrap for the gballoc allocation functions, so every allocation made by the
+   serializer and its dependencies lands here first */
+static size_t g_allocation_count;
+static size_t g_allocated_bytes;
+
+extern void* __real_gballoc_malloc(size_t size);
+extern void* __real_gballoc_calloc(size_t nmemb, size_t size);
+extern void* __real_gballoc_realloc(void* ptr, size_t size);
+
+void* __wrap_gballoc_malloc(size_t size)
+{
+    g_allocation_count++;
+    g_allocated_bytes += size;
+    return __real_gballoc_malloc(size);
+}
+
+void* __wrap_gballoc_calloc(size_t nmemb, size_t size)
+{
+    g_allocation_count++;
+    g_allocated_bytes += nmemb * size;
+    return __real_gballoc_calloc(nmemb, size);
+}
+
+void* __wrap_gballoc_realloc(void* ptr, size_t size)
+{
+    g_allocation_count++;
+    g_allocated_bytes += size;
+    return __real_gballoc_realloc(ptr, size);
+}
+#endif
+
+/* simplesample_amqp: the small model */
+BEGIN_NAMESPACE(WeatherStation);
+
+DECLARE_MODEL(ContosoAnemometer,
+WITH_DATA(ascii_char_ptr, DeviceId),
+WITH_DATA(int, WindSpeed),
+WITH_DATA(float, Temperature),
+WITH_DATA(float, Humidity),
+WITH_ACTION(TurnFanOn),
+WITH_ACTION(TurnFanOff),
+WITH_ACTION(SetAirResistance, int, Position)
+);
+
+/* devicemethod_simplesample, renamed so it can live next to the model of simplesample_amqp */
+DECLARE_MODEL(ContosoAnemometerWithMethods,
+WITH_DATA(ascii_char_ptr, DeviceId),
+WITH_DATA(int, WindSpeed),
+WITH_ACTION(TurnFanOn_with_Action),
+WITH_ACTION(TurnFanOff_with_Action),
+WITH_METHOD(TurnFanOn_with_Method),
+WITH_METHOD(TurnFanOff_with_Method)
+);
+
+END_NAMESPACE(WeatherStation);
+
+BEGIN_NAMESPACE(Contoso);
+
+/* remote_monitoring: the wide model */
+DECLARE_STRUCT(DeviceProperties,
+ascii_char_ptr, DeviceID,
+_Bool, HubEnabledState
+);
+
+DECLARE_MODEL(Thermostat,
+    WITH_DATA(int, Temperature),
+    WITH_DATA(int, ExternalTemperature),
+    WITH_DATA(int, Humidity),
+    WITH_DATA(ascii_char_ptr, DeviceId),
+    WITH_DATA(ascii_char_ptr, ObjectType),
+    WITH_DATA(_Bool, IsSimulatedDevice),
+    WITH_DATA(ascii_char_ptr, Version),
+    WITH_DATA(DeviceProperties, DeviceProperties),
+    WITH_DATA(ascii_char_ptr_no_quotes, Commands),
+    WITH_ACTION(SetTemperature, int, temperature),
+    WITH_ACTION(SetHumidity, int, humidity)
+);
+
+/* devicetwin_simplesample: the nested model. It is declared with DECLARE_MODEL rather than DECLARE_DEVICETWIN_MODEL
+   so that the perf tests do not need a device client */
+DECLARE_STRUCT(Maker,
+    ascii_char_ptr, makerName,
+    ascii_char_ptr, style,
+    int, year
+);
+
+DECLARE_STRUCT(Geo,
+    double, longitude,
+    double, latitude
+);
+
+DECLARE_MODEL(CarState,
+    WITH_REPORTED_PROPERTY(int32_t, softwareVersion),
+    WITH_REPORTED_PROPERTY(uint8_t, reported_maxSpeed),
+    WITH_REPORTED_PROPERTY(ascii_char_ptr, vanityPlate)
+);
+
+DECLARE_MODEL(CarSettings,
+    WITH_DESIRED_PROPERTY(uint8_t, desired_maxSpeed, onDesiredMaxSpeed),
+    WITH_DESIRED_PROPERTY(Geo, location)
+);
+
+DECLARE_MODEL(Car,
+    WITH_REPORTED_PROPERTY(ascii_char_ptr, lastOilChangeDate),
+    WITH_DESIRED_PROPERTY(ascii_char_ptr, changeOilReminder),
+    WITH_REPORTED_PROPERTY(Maker, maker),
+    WITH_REPORTED_PROPERTY(CarState, state),
+    WITH_DESIRED_PROPERTY(CarSettings, settings),
+    WITH_METHOD(getCarVIN)
+);
+
+END_NAMESPACE(Contoso);
+
+EXECUTE_COMMAND_RESULT TurnFanOn(ContosoAnemometer* device)
+{
+    (void)device;
+    return EXECUTE_COMMAND_SUCCESS;
+}
+
+EXECUTE_COMMAND_RESULT TurnFanOff(ContosoAnemometer* device)
+{
+    (void)device;
+    return EXECUTE_COMMAND_SUCCESS;
+}
+
+EXECUTE_COMMAND_RESULT SetAirResistance(ContosoAnemometer* device, int Position)
+{
+    (void)device;
+    (void)Position;
+    return EXECUTE_COMMAND_SUCCESS;
+}
+
+EXECUTE_COMMAND_RESULT TurnFanOn_with_Action(ContosoAnemometerWithMethods* device)
+{
+    (void)device;
+    return EXECUTE_COMMAND_SUCCESS;
+}
+
+EXECUTE_COMMAND_RESULT TurnFanOff_with_Action(ContosoAnemometerWithMethods* device)
+{
+    (void)device;
+    return EXECUTE_COMMAND_SUCCESS;
+}
+
+METHODRETURN_HANDLE TurnFanOn_with_Method(ContosoAnemometerWithMethods* device)
+{
+    (void)device;
+    return MethodReturn_Create(1, "{\"Message\":\"Turning fan on with Method\"}");
+}
+
+METHODRETURN_HANDLE TurnFanOff_with_Method(ContosoAnemometerWithMethods* device)
+{
+    (void)device;
+    return MethodReturn_Create(0, "{\"Message\":\"Turning fan off with Method\"}");
+}
+
+EXECUTE_COMMAND_RESULT SetTemperature(Thermostat* thermostat, int temperature)
+{
+    thermostat->Temperature = temperature;
+    return EXECUTE_COMMAND_SUCCESS;
+}
+
+EXECUTE_COMMAND_RESULT SetHumidity(Thermostat* thermostat, int humidity)
+{
+    thermostat->Humidity = humidity;
+    return EXECUTE_COMMAND_SUCCESS;
+}
+
+METHODRETURN_HANDLE getCarVIN(Car* car)
+{
+    (void)car;
+    return MethodReturn_Create(201, "\"1HGCM82633A004352\"");
+}
+
+void onDesiredMaxSpeed(void* argument)
+{
+    (void)argument;
+}
+
+static const char* CAR_DESIRED_PROPERTIES = "{\"changeOilReminder\":\"LOW\",\"settings\":{\"desired_maxSpeed\":126,\"location\":{\"longitude\":47.64263,\"latitude\":-122.13035}},\"$version\":3}";
+static const char* SET_AIR_RESISTANCE_COMMAND = "{\"Name\":\"SetAirResistance\",\"Parameters\":{\"Position\":5}}";
+static const char* SET_TEMPERATURE_COMMAND = "{\"Name\":\"SetTemperature\",\"Parameters\":{\"temperature\":21}}";
+
+typedef int(*PERF_OPERATION)(void* device);
+
+static bool g_false = false;
+static bool g_true = true;
+
+typedef struct PERF_CONFIG_TAG
+{
+    const char* name;
+    SERIALIZER_CONFIG which;
+    bool* value;
+} PERF_CONFIG;
+
+/* every SERIALIZE and SERIALIZE_REPORTED_PROPERTIES benchmark runs once per encoding path, the first entry puts the serializer back to its defaults */
+static const PERF_CONFIG PERF_SERIALIZE_CONFIGS[] =
+{
+    { "default", SerializeDirectToBuffer, &g_false },
+    { "direct", SerializeDirectToBuffer, &g_true },
+    { "cbor", SerializeAsCBOR, &g_true }
+};
+
+static const PERF_CONFIG PERF_INGEST_CONFIGS[] =
+{
+    { "multitree", IngestDesiredPropertiesStreaming, &g_false },
+    { "streaming", IngestDesiredPropertiesStreaming, &g_true }
+};
+
+static void reset_config(void)
+{
+    (void)serializer_setconfig(SerializeDirectToBuffer, &g_false);
+    (void)serializer_setconfig(SerializeAsCBOR, &g_false);
+    (void)serializer_setconfig(IngestDesiredPropertiesStreaming, &g_false);
+}
+
+static int run_benchmark(const char* benchmark, const char* config, PERF_OPERATION operation, void* device)
+{
+    int result = 0;
+    size_t iteration;
+    clock_t start;
+    double cpu_seconds;
+#ifdef PERF_COUNT_ALLOCATIONS
+    size_t allocations_at_start;
+    size_t bytes_at_start;
+#endif
+
+    for (iteration = 0; iteration < PERF_WARMUP_ITERATIONS && result == 0; iteration++)
+    {
+        result = operation(device);
+    }
+
+#ifdef PERF_COUNT_ALLOCATIONS
+    allocations_at_start = g_allocation_count;
+    bytes_at_start = g_allocated_bytes;
+#endif
+    start = clock();
+    for (iteration = 0; iteration < PERF_ITERATIONS && result == 0; iteration++)
+    {
+        result = operation(device);
+    }
+    cpu_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    (void)printf("%s,%s,%u,%.1f,", benchmark, config, (unsigned int)PERF_ITERATIONS, cpu_seconds * 1000000000.0 / PERF_ITERATIONS);
+#ifdef PERF_COUNT_ALLOCATIONS
+    (void)printf("%.2f,%.1f", (double)(g_allocation_count - allocations_at_start) / PERF_ITERATIONS, (double)(g_allocated_bytes - bytes_at_start) / PERF_ITERATIONS);
+#else
+    (void)printf(",");
+#endif
+    (void)printf("\r\n");
+
+    return result;
+}
+
+static int serialize_small(void* device)
+{
+    ContosoAnemometer* anemometer = (ContosoAnemometer*)device;
+    unsigned char* destination;
+    size_t destinationSize;
+    int result;
+
+    if (SERIALIZE(&destination, &destinationSize, anemometer->DeviceId, anemometer->WindSpeed, anemometer->Temperature, anemometer->Humidity) != CODEFIRST_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        free(destination);
+        result = 0;
+    }
+    return result;
+}
+
+static int serialize_wide(void* device)
+{
+    Thermostat* thermostat = (Thermostat*)device;
+    unsigned char* destination;
+    size_t destinationSize;
+    int result;
+
+    if (SERIALIZE(&destination, &destinationSize, thermostat->Temperature, thermostat->ExternalTemperature, thermostat->Humidity, thermostat->DeviceId,
+        thermostat->ObjectType, thermostat->IsSimulatedDevice, thermostat->Version, thermostat->DeviceProperties, thermostat->Commands) != CODEFIRST_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        free(destination);
+        result = 0;
+    }
+    return result;
+}
+
+static int serialize_nested(void* device)
+{
+    Thermostat* thermostat = (Thermostat*)device;
+    unsigned char* destination;
+    size_t destinationSize;
+    int result;
+
+    if (SERIALIZE(&destination, &destinationSize, thermostat->DeviceId, thermostat->DeviceProperties) != CODEFIRST_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        free(destination);
+        result = 0;
+    }
+    return result;
+}
+
+static int serialize_reported_nested(void* device)
+{
+    Car* car = (Car*)device;
+    unsigned char* destination;
+    size_t destinationSize;
+    int result;
+
+    if (SERIALIZE_REPORTED_PROPERTIES(&destination, &destinationSize, *car) != CODEFIRST_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        free(destination);
+        result = 0;
+    }
+    return result;
+}
+
+static int serialize_reported_properties(void* device)
+{
+    Car* car = (Car*)device;
+    unsigned char* destination;
+    size_t destinationSize;
+    int result;
+
+    if (SERIALIZE_REPORTED_PROPERTIES(&destination, &destinationSize, car->lastOilChangeDate, car->maker) != CODEFIRST_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        free(destination);
+        result = 0;
+    }
+    return result;
+}
+
+static int ingest_desired_properties(void* device)
+{
+    return (INGEST_DESIRED_PROPERTIES(device, CAR_DESIRED_PROPERTIES) == CODEFIRST_OK) ? 0 : __FAILURE__;
+}
+
+static int dispatch_method(void* device)
+{
+    int result;
+    METHODRETURN_HANDLE methodReturn = EXECUTE_METHOD(device, "TurnFanOn_with_Method", NULL);
+
+    if (methodReturn == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        MethodReturn_Destroy(methodReturn);
+        result = 0;
+    }
+    return result;
+}
+
+static int dispatch_action_small(void* device)
+{
+    return (EXECUTE_COMMAND(device, SET_AIR_RESISTANCE_COMMAND) == EXECUTE_COMMAND_SUCCESS) ? 0 : __FAILURE__;
+}
+
+static int dispatch_action_wide(void* device)
+{
+    return (EXECUTE_COMMAND(device, SET_TEMPERATURE_COMMAND) == EXECUTE_COMMAND_SUCCESS) ? 0 : __FAILURE__;
+}
+
+static void fill_car(Car* car)
+{
+    car->lastOilChangeDate = "2016";
+    car->maker.makerName = "Fabrikam";
+    car->maker.style = "sedan";
+    car->maker.year = 2014;
+    car->state.reported_maxSpeed = 100;
+    car->state.softwareVersion = 1;
+    car->state.vanityPlate = "1I1";
+}
+
+static void fill_thermostat(Thermostat* thermostat)
+{
+    thermostat->Temperature = 50;
+    thermostat->ExternalTemperature = 55;
+    thermostat->Humidity = 50;
+    thermostat->DeviceId = "perfdevice";
+    thermostat->ObjectType = "DeviceInfo";
+    thermostat->IsSimulatedDevice = false;
+    thermostat->Version = "1.0";
+    thermostat->DeviceProperties.DeviceID = "perfdevice";
+    thermostat->DeviceProperties.HubEnabledState = true;
+    thermostat->Commands = "[{\"Name\":\"SetTemperature\",\"Parameters\":[{\"Name\":\"temperature\",\"Type\":\"double\"}]}]";
+}
+
+BEGIN_TEST_SUITE(serializer_perf)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    (void)printf("benchmark,config,iterations,ns/op,allocs/op,bytes/op\r\n");
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    reset_config();
+}
+
+TEST_FUNCTION(serializer_perf_SERIALIZE)
+{
+    int failures = 0;
+    size_t config_index;
+    ContosoAnemometer* anemometer = CREATE_MODEL_INSTANCE(WeatherStation, ContosoAnemometer);
+    Thermostat* thermostat = CREATE_MODEL_INSTANCE(Contoso, Thermostat);
+    ASSERT_IS_NOT_NULL(anemometer);
+    ASSERT_IS_NOT_NULL(thermostat);
+
+    anemometer->DeviceId = "perfdevice";
+    anemometer->WindSpeed = 10;
+    anemometer->Temperature = 20.5f;
+    anemometer->Humidity = 60.25f;
+    fill_thermostat(thermostat);
+
+    for (config_index = 0; config_index < sizeof(PERF_SERIALIZE_CONFIGS) / sizeof(PERF_SERIALIZE_CONFIGS[0]); config_index++)
+    {
+        const PERF_CONFIG* config = &PERF_SERIALIZE_CONFIGS[config_index];
+
+        reset_config();
+        ASSERT_ARE_EQUAL(int, (int)SERIALIZER_OK, (int)serializer_setconfig(config->which, config->value));
+
+        failures += (run_benchmark("serialize/small", config->name, serialize_small, anemometer) != 0);
+        failures += (run_benchmark("serialize/wide", config->name, serialize_wide, thermostat) != 0);
+        failures += (run_benchmark("serialize/nested", config->name, serialize_nested, thermostat) != 0);
+    }
+    reset_config();
+
+    DESTROY_MODEL_INSTANCE(thermostat);
+    DESTROY_MODEL_INSTANCE(anemometer);
+
+    ASSERT_ARE_EQUAL(int, 0, failures);
+}
+
+TEST_FUNCTION(serializer_perf_SERIALIZE_REPORTED_PROPERTIES)
+{
+    int failures = 0;
+    size_t config_index;
+    Car* car = CREATE_MODEL_INSTANCE(Contoso, Car);
+    ASSERT_IS_NOT_NULL(car);
+    fill_car(car);
+
+    for (config_index = 0; config_index < sizeof(PERF_SERIALIZE_CONFIGS) / sizeof(PERF_SERIALIZE_CONFIGS[0]); config_index++)
+    {
+        const PERF_CONFIG* config = &PERF_SERIALIZE_CONFIGS[config_index];
+
+        reset_config();
+        ASSERT_ARE_EQUAL(int, (int)SERIALIZER_OK, (int)serializer_setconfig(config->which, config->value));
+
+        failures += (run_benchmark("serialize_reported/flat", config->name, serialize_reported_properties, car) != 0);
+        failures += (run_benchmark("serialize_reported/nested", config->name, serialize_reported_nested, car) != 0);
+    }
+    reset_config();
+
+    DESTROY_MODEL_INSTANCE(car);
+
+    ASSERT_ARE_EQUAL(int, 0, failures);
+}
+
+TEST_FUNCTION(serializer_perf_INGEST_DESIRED_PROPERTIES)
+{
+    int failures = 0;
+    size_t config_index;
+    Car* car = CREATE_MODEL_INSTANCE(Contoso, Car);
+    ASSERT_IS_NOT_NULL(car);
+
+    for (config_index = 0; config_index < sizeof(PERF_INGEST_CONFIGS) / sizeof(PERF_INGEST_CONFIGS[0]); config_index++)
+    {
+        const PERF_CONFIG* config = &PERF_INGEST_CONFIGS[config_index];
+
+        reset_config();
+        ASSERT_ARE_EQUAL(int, (int)SERIALIZER_OK, (int)serializer_setconfig(config->which, config->value));
+
+        failures += (run_benchmark("ingest_desired/nested", config->name, ingest_desired_properties, car) != 0);
+    }
+    reset_config();
+
+    ASSERT_ARE_EQUAL(int, 126, (int)car->settings.desired_maxSpeed);
+
+    DESTROY_MODEL_INSTANCE(car);
+
+    ASSERT_ARE_EQUAL(int, 0, failures);
+}
+
+TEST_FUNCTION(serializer_perf_dispatch)
+{
+    int failures = 0;
+    ContosoAnemometerWithMethods* anemometerWithMethods = CREATE_MODEL_INSTANCE(WeatherStation, ContosoAnemometerWithMethods);
+    ContosoAnemometer* anemometer = CREATE_MODEL_INSTANCE(WeatherStation, ContosoAnemometer);
+    Thermostat* thermostat = CREATE_MODEL_INSTANCE(Contoso, Thermostat);
+    ASSERT_IS_NOT_NULL(anemometerWithMethods);
+    ASSERT_IS_NOT_NULL(anemometer);
+    ASSERT_IS_NOT_NULL(thermostat);
+
+    reset_config();
+    failures += (run_benchmark("dispatch/method", "default", dispatch_method, anemometerWithMethods) != 0);
+    failures += (run_benchmark("dispatch/action_small", "default", dispatch_action_small, anemometer) != 0);
+    failures += (run_benchmark("dispatch/action_wide", "default", dispatch_action_wide, thermostat) != 0);
+
+    DESTROY_MODEL_INSTANCE(thermostat);
+    DESTROY_MODEL_INSTANCE(anemometer);
+    DESTROY_MODEL_INSTANCE(anemometerWithMethods);
+
+    ASSERT_ARE_EQUAL(int, 0, failures);
+}
+
+END_TEST_SUITE(serializer_perf)